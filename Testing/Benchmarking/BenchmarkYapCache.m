@@ -7,6 +7,134 @@
 #define TEST_COLLECTION_KEY 1 // 0:Key=NSString, 1:Key=YapCollectionKey
 
 
+/**
+ * The previous YapCache design (a CFDictionary of objc linked-list nodes),
+ * kept here as the baseline for the head-to-head comparison with the current (flat table) design.
+ * Only the methods used by the benchmark are implemented.
+**/
+@interface LinkedListCacheItem : NSObject {
+@public
+	__unsafe_unretained LinkedListCacheItem *prev;
+	__unsafe_unretained LinkedListCacheItem *next;
+	__unsafe_unretained id key;
+	__strong id value;
+}
+@end
+
+@implementation LinkedListCacheItem
+@end
+
+@interface LinkedListCache : NSObject
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit keyCallbacks:(CFDictionaryKeyCallBacks)keyCallbacks;
+- (id)objectForKey:(id)key;
+- (void)setObject:(id)object forKey:(id)key;
+@end
+
+@implementation LinkedListCache
+{
+	CFMutableDictionaryRef cfdict;
+	NSUInteger countLimit;
+	
+	__unsafe_unretained LinkedListCacheItem *mostRecentCacheItem;
+	__unsafe_unretained LinkedListCacheItem *leastRecentCacheItem;
+	
+	__strong LinkedListCacheItem *evictedCacheItem;
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)inCountLimit keyCallbacks:(CFDictionaryKeyCallBacks)keyCallbacks
+{
+	if ((self = [super init]))
+	{
+		countLimit = inCountLimit;
+		cfdict = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &keyCallbacks, &kCFTypeDictionaryValueCallBacks);
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (cfdict) CFRelease(cfdict);
+}
+
+- (void)moveToFront:(__unsafe_unretained LinkedListCacheItem *)item
+{
+	if (item == mostRecentCacheItem) return;
+	
+	item->prev->next = item->next;
+	
+	if (item == leastRecentCacheItem)
+		leastRecentCacheItem = item->prev;
+	else
+		item->next->prev = item->prev;
+	
+	item->prev = nil;
+	item->next = mostRecentCacheItem;
+	
+	mostRecentCacheItem->prev = item;
+	mostRecentCacheItem = item;
+}
+
+- (id)objectForKey:(id)key
+{
+	__unsafe_unretained LinkedListCacheItem *item = CFDictionaryGetValue(cfdict, (const void *)key);
+	if (item == nil) return nil;
+	
+	[self moveToFront:item];
+	return item->value;
+}
+
+- (void)setObject:(id)object forKey:(id)key
+{
+	__unsafe_unretained LinkedListCacheItem *existingItem = CFDictionaryGetValue(cfdict, (const void *)key);
+	if (existingItem)
+	{
+		existingItem->value = object;
+		[self moveToFront:existingItem];
+		return;
+	}
+	
+	__strong LinkedListCacheItem *newItem = evictedCacheItem ?: [[LinkedListCacheItem alloc] init];
+	evictedCacheItem = nil;
+	
+	newItem->key = key;
+	newItem->value = object;
+	
+	CFDictionarySetValue(cfdict, (const void *)key, (const void *)newItem);
+	
+	newItem->prev = nil;
+	newItem->next = mostRecentCacheItem;
+	
+	if (mostRecentCacheItem)
+		mostRecentCacheItem->prev = newItem;
+	
+	mostRecentCacheItem = newItem;
+	
+	if (leastRecentCacheItem == nil)
+		leastRecentCacheItem = newItem;
+	
+	if (countLimit != 0 && CFDictionaryGetCount(cfdict) > (CFIndex)countLimit)
+	{
+		__unsafe_unretained LinkedListCacheItem *itemToEvict = leastRecentCacheItem;
+		
+		leastRecentCacheItem = itemToEvict->prev;
+		leastRecentCacheItem->next = nil;
+		
+		evictedCacheItem = itemToEvict;
+		evictedCacheItem->prev = nil;
+		evictedCacheItem->value = nil;
+		
+		CFDictionaryRemoveValue(cfdict, (const void *)(itemToEvict->key));
+		evictedCacheItem->key = nil;
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
 /**
  * Head-to-head stress test.
  * We generate the exact same sequence of keys, and iterate over them as fast as possible.
@@ -71,6 +199,165 @@ static NSMutableArray *keys;
 	}
 }
 
+/**
+ * Returns a random index in the range [0, count), following a zipf distribution (with the given exponent).
+ * The cumulative weights are passed in, so they only need to be calculated once.
+**/
++ (NSUInteger)zipfIndex:(const double *)cumulativeWeights count:(NSUInteger)count
+{
+	double total = cumulativeWeights[count - 1];
+	double target = ((double)arc4random() / (double)UINT32_MAX) * total;
+	
+	NSUInteger min = 0;
+	NSUInteger max = count - 1;
+	
+	while (min < max)
+	{
+		NSUInteger mid = (min + max) / 2;
+		
+		if (cumulativeWeights[mid] < target)
+			min = mid + 1;
+		else
+			max = mid;
+	}
+	
+	return min;
+}
+
++ (id)keyWithString:(NSString *)key
+{
+#if TEST_COLLECTION_KEY
+	return [[YapCollectionKey alloc] initWithCollection:@"" key:key];
+#else
+	return key;
+#endif
+}
+
+/**
+ * Skewed workload:
+ * Keys are drawn from a universe 10 times the size of the cache, following a zipf distribution.
+ * (A few keys are very popular, and there's a long tail of keys that are rarely accessed.)
+**/
++ (void)generateSkewedKeysWithCacheSize:(NSUInteger)cacheSize
+{
+	NSUInteger universeSize = cacheSize * 10;
+	
+	NSMutableArray *universe = [NSMutableArray arrayWithCapacity:universeSize];
+	double *cumulativeWeights = malloc(sizeof(double) * universeSize);
+	
+	double total = 0.0;
+	for (NSUInteger i = 0; i < universeSize; i++)
+	{
+		[universe addObject:[self keyWithString:[self randomLetters:24]]];
+		
+		total += 1.0 / pow((double)(i + 1), 0.9);
+		cumulativeWeights[i] = total;
+	}
+	
+	keys = [NSMutableArray arrayWithCapacity:LOOP_COUNT];
+	
+	for (NSUInteger i = 0; i < LOOP_COUNT; i++)
+	{
+		[keys addObject:universe[[self zipfIndex:cumulativeWeights count:universeSize]]];
+	}
+	
+	free(cumulativeWeights);
+}
+
+/**
+ * Scan-mixed workload:
+ * A skewed working set (the size of the cache), which is periodically interrupted by a scan
+ * over keys that are never accessed again (e.g. a background enumeration of a large collection).
+**/
++ (void)generateScanMixedKeysWithCacheSize:(NSUInteger)cacheSize
+{
+	NSUInteger hotSize = cacheSize;
+	NSUInteger scanLength = cacheSize * 2;
+	
+	NSMutableArray *hotKeys = [NSMutableArray arrayWithCapacity:hotSize];
+	double *cumulativeWeights = malloc(sizeof(double) * hotSize);
+	
+	double total = 0.0;
+	for (NSUInteger i = 0; i < hotSize; i++)
+	{
+		[hotKeys addObject:[self keyWithString:[self randomLetters:24]]];
+		
+		total += 1.0 / pow((double)(i + 1), 0.9);
+		cumulativeWeights[i] = total;
+	}
+	
+	keys = [NSMutableArray arrayWithCapacity:LOOP_COUNT];
+	
+	NSUInteger scanCount = 0;
+	
+	while ([keys count] < LOOP_COUNT)
+	{
+		// Hot phase
+		
+		for (NSUInteger i = 0; i < (cacheSize * 4) && [keys count] < LOOP_COUNT; i++)
+		{
+			[keys addObject:hotKeys[[self zipfIndex:cumulativeWeights count:hotSize]]];
+		}
+		
+		// Scan phase
+		
+		for (NSUInteger i = 0; i < scanLength && [keys count] < LOOP_COUNT; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"scan-%lu-%lu", (unsigned long)scanCount, (unsigned long)i];
+			[keys addObject:[self keyWithString:key]];
+		}
+		
+		scanCount++;
+	}
+	
+	free(cumulativeWeights);
+}
+
+/**
+ * Returns the hit percentage of a YapCache (with the given admission policy) for the current keys.
+**/
++ (double)hitPercentageForYapCache:(NSUInteger)cacheSize admissionPolicy:(YapCacheAdmissionPolicy)admissionPolicy
+{
+#if TEST_COLLECTION_KEY
+	YapCache *cache = [[YapCache alloc] initWithCountLimit:cacheSize keyCallbacks:[YapCollectionKey keyCallbacks]];
+#else
+	YapCache *cache = [[YapCache alloc] initWithCountLimit:cacheSize];
+#endif
+	cache.admissionPolicy = admissionPolicy;
+	
+	NSUInteger hitCount = 0;
+	
+	NSDate *start = [NSDate date];
+	
+	for (id key in keys)
+	{
+		if ([cache objectForKey:key] == nil)
+		{
+			[cache setObject:[NSNull null] forKey:key];
+		}
+		else
+		{
+			hitCount++;
+		}
+	}
+	
+	NSTimeInterval elapsed = [start timeIntervalSinceNow] * -1.0;
+	double hitPercentage = (double)hitCount / (double)[keys count];
+	
+	NSLog(@"YapCache(%@): elapsed = %.6f (hit percentage = %.2f)",
+	      (admissionPolicy == YapCacheAdmissionPolicyTinyLFU) ? @"TinyLFU" : @"LRU", elapsed, hitPercentage);
+	
+	return hitPercentage;
+}
+
++ (void)compareAdmissionPoliciesWithCacheSize:(NSUInteger)cacheSize
+{
+	double lru     = [self hitPercentageForYapCache:cacheSize admissionPolicy:YapCacheAdmissionPolicyLRU];
+	double tinyLFU = [self hitPercentageForYapCache:cacheSize admissionPolicy:YapCacheAdmissionPolicyTinyLFU];
+	
+	NSLog(@"Hit percentage: LRU = %.2f, TinyLFU = %.2f (%+.2f) \n ", lru, tinyLFU, (tinyLFU - lru));
+}
+
 + (NSTimeInterval)testNSCache:(NSUInteger)cacheSize
 {
 	NSCache *cache = [[NSCache alloc] init];
@@ -136,6 +423,70 @@ static NSMutableArray *keys;
 	return elapsed;
 }
 
++ (NSTimeInterval)testLinkedListCache:(NSUInteger)cacheSize
+{
+#if TEST_COLLECTION_KEY
+	LinkedListCache *cache = [[LinkedListCache alloc] initWithCountLimit:cacheSize
+	                                                        keyCallbacks:[YapCollectionKey keyCallbacks]];
+#else
+	LinkedListCache *cache = [[LinkedListCache alloc] initWithCountLimit:cacheSize
+	                                                        keyCallbacks:kCFTypeDictionaryKeyCallBacks];
+#endif
+	
+	NSUInteger hitCount = 0;
+	
+	NSDate *start = [NSDate date];
+	
+	for (id key in keys)
+	{
+		if ([cache objectForKey:key] == nil)
+		{
+			[cache setObject:[NSNull null] forKey:key];
+		}
+		else
+		{
+			hitCount++;
+		}
+	}
+	
+	NSTimeInterval elapsed = [start timeIntervalSinceNow] * -1.0;
+	double hitPercentage = (double)hitCount / (double)[keys count];
+	
+	NSLog(@"LinkedListCache: elapsed = %.6f (actual hit percentage = %.2f)", elapsed, hitPercentage);
+	
+	return elapsed;
+}
+
+/**
+ * Head-to-head: the current YapCache (flat tables) vs the previous design (CFDictionary + objc linked-list nodes).
+**/
++ (void)compareWithLinkedListCache:(NSUInteger)cacheSize targetHitPercentage:(double)targetHitPercentage
+{
+	NSLog(@"CACHE SIZE: %lu, TARGET HIT PERCENTAGE: %.0f%%: YapCache vs LinkedListCache \n\n",
+	      (unsigned long)cacheSize, (targetHitPercentage * 100));
+	
+	NSTimeInterval old = 0.0;
+	NSTimeInterval yap = 0.0;
+	
+	[self generateKeysWithCacheSize:cacheSize targetHitPercentage:targetHitPercentage];
+	
+	for (NSUInteger i = 0; i < 3; i++)
+	{
+		old += [self testLinkedListCache:cacheSize];
+		yap += [self testYapCache:cacheSize];
+	}
+	
+	old = old / 3.0;
+	yap = yap / 3.0;
+	
+	if (old < yap)
+		NSLog(@"Winner: LinkedListCache (%.2f%% faster) \n ", ((1.0-(old/yap))*100) );
+	else
+		NSLog(@"Winner: YapCache (%.2f%% faster) \n ", ((1.0-(yap/old))*100) );
+	
+	NSLog(@"====================================================");
+}
+
 + (void)testWithCompletion:(dispatch_block_t)completionBlock;
 {
 	if ([cacheSizes count] == 0)
@@ -276,6 +627,32 @@ static NSMutableArray *keys;
 		NSLog(@"====================================================");
 	});
 	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		
+		[self compareWithLinkedListCache:cacheSize targetHitPercentage:0.05];
+		[self compareWithLinkedListCache:cacheSize targetHitPercentage:0.50];
+		[self compareWithLinkedListCache:cacheSize targetHitPercentage:0.95];
+	});
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		
+		NSLog(@"CACHE SIZE: %lu, SKEWED (ZIPF) WORKLOAD: LRU vs TinyLFU \n\n", (unsigned long)cacheSize);
+		
+		[self generateSkewedKeysWithCacheSize:cacheSize];
+		[self compareAdmissionPoliciesWithCacheSize:cacheSize];
+		
+		NSLog(@"====================================================");
+	});
+	dispatch_async(dispatch_get_main_queue(), ^{
+		
+		NSLog(@"CACHE SIZE: %lu, SCAN-MIXED WORKLOAD: LRU vs TinyLFU \n\n", (unsigned long)cacheSize);
+		
+		[self generateScanMixedKeysWithCacheSize:cacheSize];
+		[self compareAdmissionPoliciesWithCacheSize:cacheSize];
+		
+		NSLog(@"====================================================");
+	});
+	
 	dispatch_async(dispatch_get_main_queue(), ^{
 		
 		// Run the next test (with a different cacheSize)
@@ -1,5 +1,6 @@
 #import "BenchmarkYapDatabase.h"
 #import "YapDatabase.h"
+#import "YapDatabaseBinaryCodec.h"
 
 #import <stdlib.h>
 
@@ -205,6 +206,39 @@ static NSMutableArray *keys;
 	}
 }
 
++ (void)asyncReadTransactionOverhead:(NSUInteger)loopCount coalesced:(BOOL)coalesced
+{
+	connection.coalescesAsyncReads = coalesced;
+	
+	dispatch_queue_t completionQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	dispatch_group_t group = dispatch_group_create();
+	
+	NSDate *start = [NSDate date];
+	
+	for (NSUInteger i = 0; i < loopCount; i++)
+	{
+		dispatch_group_enter(group);
+		[connection asyncReadWithBlock:^(YapDatabaseReadTransaction __unused *transaction) {
+			
+			// Nothing to do, just testing overhead
+			
+		} completionQueue:completionQueue completionBlock:^{
+			
+			dispatch_group_leave(group);
+		}];
+	}
+	
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	
+	NSTimeInterval elapsed = [start timeIntervalSinceNow] * -1.0;
+	if (coalesced)
+		NSLog(@"Async ReadOnly transaction overhead : %.8f  (using coalescesAsyncReads)", (elapsed / loopCount));
+	else
+		NSLog(@"Async ReadOnly transaction overhead : %.8f", (elapsed / loopCount));
+	
+	connection.coalescesAsyncReads = NO;
+}
+
 + (void)readWriteTransactionOverhead:(NSUInteger)loopCount
 {
 	NSDate *start = [NSDate date];
@@ -221,6 +255,54 @@ static NSMutableArray *keys;
 	NSLog(@"ReadWrite transaction overhead: %.8f", (elapsed / loopCount));
 }
 
++ (void)serializeObjects:(NSUInteger)loopCount
+              withName:(NSString *)name
+            serializer:(YapDatabaseSerializer)serializer
+          deserializer:(YapDatabaseDeserializer)deserializer
+{
+	// A typical model object graph
+	
+	NSMutableArray *objects = [NSMutableArray arrayWithCapacity:loopCount];
+	for (NSUInteger i = 0; i < loopCount; i++)
+	{
+		[objects addObject:@{
+			@"uuid"     : [[NSUUID UUID] UUIDString],
+			@"name"     : [self randomLetters:24],
+			@"created"  : [NSDate date],
+			@"count"    : @(arc4random()),
+			@"score"    : @(drand48()),
+			@"archived" : @NO,
+			@"tags"     : @[ [self randomLetters:8], [self randomLetters:8], [self randomLetters:8] ],
+		}];
+	}
+	
+	NSMutableArray *datas = [NSMutableArray arrayWithCapacity:loopCount];
+	NSUInteger totalLength = 0;
+	
+	NSDate *start = [NSDate date];
+	
+	for (id object in objects)
+	{
+		NSData *data = serializer(@"", @"", object);
+		
+		totalLength += [data length];
+		[datas addObject:data];
+	}
+	
+	NSTimeInterval encodeElapsed = [start timeIntervalSinceNow] * -1.0;
+	start = [NSDate date];
+	
+	for (NSData *data in datas)
+	{
+		(void)deserializer(@"", @"", data);
+	}
+	
+	NSTimeInterval decodeElapsed = [start timeIntervalSinceNow] * -1.0;
+	
+	NSLog(@"%@: encode: %.6f, decode: %.6f, avg size: %lu", name, encodeElapsed, decodeElapsed,
+	      (unsigned long)(totalLength / loopCount));
+}
+
 + (void)removeAllValues
 {
 	NSDate *start = [NSDate date];
@@ -311,10 +393,33 @@ static NSMutableArray *keys;
 		
 		[self readTransactionOverhead:1000 withLongLivedReadTransaction:YES];
 		[self readTransactionOverhead:1000 withLongLivedReadTransaction:NO];
+		[self asyncReadTransactionOverhead:1000 coalesced:NO];
+		[self asyncReadTransactionOverhead:1000 coalesced:YES];
 		[self readWriteTransactionOverhead:1000];
 		
 		NSLog(@"====================================================");
 	});
+	dispatch_async(dispatch_get_main_queue(), ^{
+		
+		NSLog(@"SERIALIZERS");
+		
+		[self serializeObjects:1000
+		              withName:@"NSKeyedArchiver"
+		            serializer:[YapDatabase defaultSerializer]
+		          deserializer:[YapDatabase defaultDeserializer]];
+		
+		[self serializeObjects:1000
+		              withName:@"Property List  "
+		            serializer:[YapDatabase propertyListSerializer]
+		          deserializer:[YapDatabase propertyListDeserializer]];
+		
+		[self serializeObjects:1000
+		              withName:@"Binary codec   "
+		            serializer:[YapDatabaseBinaryCodec serializer]
+		          deserializer:[YapDatabaseBinaryCodec deserializer]];
+		
+		NSLog(@"====================================================");
+	});
 	dispatch_async(dispatch_get_main_queue(), ^{
 		
 		NSLog(@"REMOVE ALL");
@@ -0,0 +1,506 @@
+#import "BenchmarkYapDatabaseContention.h"
+#import "YapDatabase.h"
+
+#import <stdlib.h>
+
+/**
+ * The number of rows in the database (before the writers start).
+**/
+#define BENCHMARK_ROW_COUNT 10000
+
+/**
+ * The number of random objects fetched by a short read transaction.
+**/
+#define BENCHMARK_SHORT_READ_SIZE 10
+
+/**
+ * Every Nth read transaction (of each reader) is a long read, which enumerates the entire collection.
+ * Long reads hold onto their snapshot, and so they interfere with checkpoints.
+**/
+#define BENCHMARK_LONG_READ_INTERVAL 50
+
+/**
+ * How often the size of the WAL is sampled (in seconds).
+**/
+#define BENCHMARK_WAL_SAMPLE_INTERVAL 0.1
+
+static NSString *const Collection = @"benchmark";
+
+/**
+ * Runs N reader connections against M writer connections (all concurrently), for a fixed duration,
+ * in order to measure how the database behaves under contention as the number of connections grows.
+ *
+ * Readers mix short read transactions (a few random objects) with long reads (enumerating everything).
+ * Writers commit a configurable number of rows per transaction.
+ * Every transaction begins by processing the changesets of the commits made by the other connections,
+ * so both the snapshot/write queue waits & processChangeset: are included in the latencies.
+ *
+ * The configuration can be changed via environment variables (comma-separated lists):
+ * - YDB_BENCHMARK_READERS     : number of reader connections (default "1,2,4,8")
+ * - YDB_BENCHMARK_WRITERS     : number of writer connections (default "1,2")
+ * - YDB_BENCHMARK_COMMIT_SIZE : number of rows per write transaction (default "1,100")
+ * - YDB_BENCHMARK_DURATION    : seconds per configuration (default "5")
+ *
+ * For every configuration, we report read & write throughput, latency distributions (p50/p90/p99/max),
+ * time spent waiting for the write lock, WAL size over time, checkpoint counts & bytes written.
+ * The results are logged, and written as JSON to BenchmarkYapDatabaseContention.json (in the caches directory).
+**/
+@implementation BenchmarkYapDatabaseContention
+
+static NSMutableArray *keys;
+static NSMutableArray *results;
+
++ (NSString *)baseDirectory
+{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+	return ([paths count] > 0) ? [paths objectAtIndex:0] : NSTemporaryDirectory();
+}
+
++ (NSString *)databasePath
+{
+	return [[self baseDirectory] stringByAppendingPathComponent:@"BenchmarkYapDatabaseContention.sqlite"];
+}
+
++ (NSString *)resultsPath
+{
+	return [[self baseDirectory] stringByAppendingPathComponent:@"BenchmarkYapDatabaseContention.json"];
+}
+
++ (void)deleteDatabaseAtPath:(NSString *)databasePath
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	
+	[fileManager removeItemAtPath:databasePath error:NULL];
+	[fileManager removeItemAtPath:[databasePath stringByAppendingString:@"-wal"] error:NULL];
+	[fileManager removeItemAtPath:[databasePath stringByAppendingString:@"-shm"] error:NULL];
+}
+
++ (NSArray<NSNumber *> *)numbersForEnvironmentVariable:(NSString *)name defaultValue:(NSArray<NSNumber *> *)defaultValue
+{
+	NSString *str = [[[NSProcessInfo processInfo] environment] objectForKey:name];
+	
+	NSMutableArray<NSNumber *> *numbers = [NSMutableArray array];
+	for (NSString *component in [str componentsSeparatedByString:@","])
+	{
+		double number = [component doubleValue];
+		if (number > 0) {
+			[numbers addObject:@(number)];
+		}
+	}
+	
+	if ([numbers count] == 0)
+		return defaultValue;
+	else
+		return numbers;
+}
+
++ (void)generateKeys
+{
+	keys = [[NSMutableArray alloc] initWithCapacity:BENCHMARK_ROW_COUNT];
+	
+	for (NSUInteger i = 0; i < BENCHMARK_ROW_COUNT; i++)
+	{
+		[keys addObject:[NSString stringWithFormat:@"%010lu", (unsigned long)i]];
+	}
+}
+
++ (NSString *)randomKey
+{
+	return [keys objectAtIndex:arc4random_uniform((uint32_t)[keys count])];
+}
+
++ (void)populateDatabase:(YapDatabase *)database
+{
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSString *key in keys)
+		{
+			[transaction setObject:key forKey:key inCollection:Collection];
+		}
+	}];
+}
+
++ (uint64_t)walSizeForDatabasePath:(NSString *)databasePath
+{
+	NSString *walPath = [databasePath stringByAppendingString:@"-wal"];
+	NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:walPath error:NULL];
+	
+	return [attributes fileSize];
+}
+
+#pragma mark Statistics
+
++ (double)percentile:(double)percentile ofSortedLatencies:(NSArray<NSNumber *> *)sortedLatencies
+{
+	NSUInteger count = [sortedLatencies count];
+	if (count == 0) return 0.0;
+	
+	NSUInteger index = (NSUInteger)ceil(percentile * count);
+	if (index > 0) index--;
+	if (index >= count) index = count - 1;
+	
+	return [[sortedLatencies objectAtIndex:index] doubleValue];
+}
+
++ (NSDictionary *)summaryOfLatencies:(NSArray<NSNumber *> *)latencies
+{
+	NSArray<NSNumber *> *sortedLatencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+	
+	return @{
+		@"count" : @([sortedLatencies count]),
+		@"p50"   : @([self percentile:0.50 ofSortedLatencies:sortedLatencies]),
+		@"p90"   : @([self percentile:0.90 ofSortedLatencies:sortedLatencies]),
+		@"p99"   : @([self percentile:0.99 ofSortedLatencies:sortedLatencies]),
+		@"max"   : @([self percentile:1.00 ofSortedLatencies:sortedLatencies]),
+	};
+}
+
++ (NSString *)descriptionOfSummary:(NSDictionary *)summary
+{
+	return [NSString stringWithFormat:@"count: %lu, p50: %.6f, p90: %.6f, p99: %.6f, max: %.6f",
+	  (unsigned long)[summary[@"count"] unsignedIntegerValue],
+	  [summary[@"p50"] doubleValue],
+	  [summary[@"p90"] doubleValue],
+	  [summary[@"p99"] doubleValue],
+	  [summary[@"max"] doubleValue]];
+}
+
+#pragma mark Workers
+
++ (void)runReaderWithConnection:(YapDatabaseConnection *)connection
+                       deadline:(NSDate *)deadline
+                 shortLatencies:(NSMutableArray<NSNumber *> *)shortLatencies
+                  longLatencies:(NSMutableArray<NSNumber *> *)longLatencies
+{
+	NSUInteger iteration = 0;
+	
+	while ([deadline timeIntervalSinceNow] > 0) { @autoreleasepool {
+		
+		BOOL isLongRead = (++iteration % BENCHMARK_LONG_READ_INTERVAL) == 0;
+		
+		NSDate *start = [NSDate date];
+		
+		if (isLongRead)
+		{
+			[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+				
+				[transaction enumerateKeysAndObjectsInCollection:Collection
+				                                      usingBlock:^(NSString *key, id object, BOOL *stop)
+				{
+					// Nothing to do here
+				}];
+			}];
+		}
+		else
+		{
+			[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+				
+				for (NSUInteger i = 0; i < BENCHMARK_SHORT_READ_SIZE; i++)
+				{
+					(void)[transaction objectForKey:[self randomKey] inCollection:Collection];
+				}
+			}];
+		}
+		
+		NSTimeInterval elapsed = [start timeIntervalSinceNow] * -1.0;
+		
+		if (isLongRead)
+			[longLatencies addObject:@(elapsed)];
+		else
+			[shortLatencies addObject:@(elapsed)];
+	}}
+}
+
++ (void)runWriterWithConnection:(YapDatabaseConnection *)connection
+                       deadline:(NSDate *)deadline
+                     commitSize:(NSUInteger)commitSize
+                      latencies:(NSMutableArray<NSNumber *> *)latencies
+{
+	NSUInteger iteration = 0;
+	
+	while ([deadline timeIntervalSinceNow] > 0) { @autoreleasepool {
+		
+		NSString *value = [NSString stringWithFormat:@"%lu", (unsigned long)(++iteration)];
+		
+		NSDate *start = [NSDate date];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger i = 0; i < commitSize; i++)
+			{
+				[transaction setObject:value forKey:[self randomKey] inCollection:Collection];
+			}
+		}];
+		
+		[latencies addObject:@([start timeIntervalSinceNow] * -1.0)];
+	}}
+}
+
+#pragma mark Benchmark
+
++ (void)benchmarkWithReaderCount:(NSUInteger)readerCount
+                     writerCount:(NSUInteger)writerCount
+                      commitSize:(NSUInteger)commitSize
+                        duration:(NSTimeInterval)duration
+{
+	NSString *databasePath = [self databasePath];
+	[self deleteDatabaseAtPath:databasePath];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableIOStatistics = YES;
+	options.checkpointPolicy = [[YapDatabaseAdaptiveCheckpointPolicy alloc] init]; // for the checkpoint statistics
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	[self populateDatabase:database];
+	
+	// Setup connections
+	//
+	// We create all the connections up front, so connection creation isn't part of the measurement.
+	
+	NSMutableArray<YapDatabaseConnection *> *readers = [NSMutableArray arrayWithCapacity:readerCount];
+	NSMutableArray<YapDatabaseConnection *> *writers = [NSMutableArray arrayWithCapacity:writerCount];
+	
+	NSMutableArray<NSNumber *> *lockWaitDurations = [NSMutableArray array];
+	NSMutableArray<NSNumber *> *checkpointDurations = [NSMutableArray array];
+	
+	dispatch_queue_t metricsQueue = dispatch_queue_create("BenchmarkYapDatabaseContention.metrics", DISPATCH_QUEUE_SERIAL);
+	
+	for (NSUInteger i = 0; i < readerCount; i++)
+	{
+		[readers addObject:[database newConnection]];
+	}
+	for (NSUInteger i = 0; i < writerCount; i++)
+	{
+		YapDatabaseConnection *writer = [database newConnection];
+		
+		[writer setTransactionMetricsBlock:^(YapDatabaseConnection *connection, YapDatabaseTransactionMetrics *metrics) {
+			
+			[lockWaitDurations addObject:@(metrics.writeLockWaitDuration)];
+			
+			if (metrics.checkpointDuration > 0) {
+				[checkpointDurations addObject:@(metrics.checkpointDuration)];
+			}
+			
+		} queue:metricsQueue];
+		
+		[writers addObject:writer];
+	}
+	
+	YapDatabaseCheckpointStatistics *checkpointsBefore = database.checkpointStatistics;
+	[database resetIOStatistics];
+	
+	// Sample the WAL size
+	
+	NSMutableArray<NSArray<NSNumber *> *> *walSamples = [NSMutableArray array];
+	NSDate *start = [NSDate date];
+	
+	dispatch_queue_t samplerQueue = dispatch_queue_create("BenchmarkYapDatabaseContention.wal", DISPATCH_QUEUE_SERIAL);
+	dispatch_source_t sampler = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, samplerQueue);
+	
+	uint64_t sampleInterval = (uint64_t)(BENCHMARK_WAL_SAMPLE_INTERVAL * NSEC_PER_SEC);
+	dispatch_source_set_timer(sampler, dispatch_time(DISPATCH_TIME_NOW, 0), sampleInterval, (sampleInterval / 10));
+	dispatch_source_set_event_handler(sampler, ^{
+		
+		NSTimeInterval elapsed = [start timeIntervalSinceNow] * -1.0;
+		uint64_t walSize = [self walSizeForDatabasePath:databasePath];
+		
+		[walSamples addObject:@[ @(elapsed), @(walSize) ]];
+	});
+	dispatch_resume(sampler);
+	
+	// Run readers & writers
+	
+	NSDate *deadline = [start dateByAddingTimeInterval:duration];
+	
+	NSMutableArray<NSNumber *> *shortReadLatencies = [NSMutableArray array];
+	NSMutableArray<NSNumber *> *longReadLatencies = [NSMutableArray array];
+	NSMutableArray<NSNumber *> *writeLatencies = [NSMutableArray array];
+	
+	dispatch_queue_t workerQueue = dispatch_queue_create("BenchmarkYapDatabaseContention", DISPATCH_QUEUE_CONCURRENT);
+	dispatch_group_t group = dispatch_group_create();
+	
+	for (YapDatabaseConnection *reader in readers)
+	{
+		dispatch_group_async(group, workerQueue, ^{
+			
+			NSMutableArray<NSNumber *> *shortLatencies = [NSMutableArray array];
+			NSMutableArray<NSNumber *> *longLatencies = [NSMutableArray array];
+			
+			[self runReaderWithConnection:reader
+			                     deadline:deadline
+			               shortLatencies:shortLatencies
+			                longLatencies:longLatencies];
+			
+			@synchronized(shortReadLatencies)
+			{
+				[shortReadLatencies addObjectsFromArray:shortLatencies];
+				[longReadLatencies addObjectsFromArray:longLatencies];
+			}
+		});
+	}
+	for (YapDatabaseConnection *writer in writers)
+	{
+		dispatch_group_async(group, workerQueue, ^{
+			
+			NSMutableArray<NSNumber *> *latencies = [NSMutableArray array];
+			
+			[self runWriterWithConnection:writer
+			                     deadline:deadline
+			                   commitSize:commitSize
+			                    latencies:latencies];
+			
+			@synchronized(writeLatencies)
+			{
+				[writeLatencies addObjectsFromArray:latencies];
+			}
+		});
+	}
+	
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	
+	NSTimeInterval elapsed = [start timeIntervalSinceNow] * -1.0;
+	
+	dispatch_source_cancel(sampler);
+	dispatch_sync(samplerQueue, ^{ /* wait for last sample */ });
+	dispatch_sync(metricsQueue, ^{ /* wait for pending metrics */ });
+	
+	// Results
+	
+	YapDatabaseCheckpointStatistics *checkpointsAfter = database.checkpointStatistics;
+	YapDatabaseIOStatistics *ioStatistics = database.ioStatistics;
+	
+	NSUInteger checkpointCount =
+	  (checkpointsAfter.passiveCount  - checkpointsBefore.passiveCount)  +
+	  (checkpointsAfter.fullCount     - checkpointsBefore.fullCount)     +
+	  (checkpointsAfter.restartCount  - checkpointsBefore.restartCount)  +
+	  (checkpointsAfter.truncateCount - checkpointsBefore.truncateCount);
+	
+	NSUInteger busyCheckpointCount = checkpointsAfter.busyCount - checkpointsBefore.busyCount;
+	
+	uint64_t maxWALSize = 0;
+	for (NSArray<NSNumber *> *sample in walSamples)
+	{
+		maxWALSize = MAX(maxWALSize, [[sample objectAtIndex:1] unsignedLongLongValue]);
+	}
+	
+	NSUInteger readCount = [shortReadLatencies count] + [longReadLatencies count];
+	NSUInteger writeCount = [writeLatencies count];
+	
+	NSDictionary *shortReadSummary = [self summaryOfLatencies:shortReadLatencies];
+	NSDictionary *longReadSummary = [self summaryOfLatencies:longReadLatencies];
+	NSDictionary *writeSummary = [self summaryOfLatencies:writeLatencies];
+	NSDictionary *lockWaitSummary = [self summaryOfLatencies:lockWaitDurations];
+	NSDictionary *checkpointSummary = [self summaryOfLatencies:checkpointDurations];
+	
+	NSLog(@"readers: %lu, writers: %lu, commit size: %lu",
+	      (unsigned long)readerCount, (unsigned long)writerCount, (unsigned long)commitSize);
+	NSLog(@" - reads/sec: %.1f, write transactions/sec: %.1f, rows written/sec: %.1f",
+	      (readCount / elapsed), (writeCount / elapsed), ((writeCount * commitSize) / elapsed));
+	NSLog(@" - short reads: %@", [self descriptionOfSummary:shortReadSummary]);
+	NSLog(@" - long reads : %@", [self descriptionOfSummary:longReadSummary]);
+	NSLog(@" - writes     : %@", [self descriptionOfSummary:writeSummary]);
+	NSLog(@" - lock waits : %@", [self descriptionOfSummary:lockWaitSummary]);
+	NSLog(@" - checkpoints: %lu (busy: %lu), max WAL size: %llu, bytes written: %llu",
+	      (unsigned long)checkpointCount, (unsigned long)busyCheckpointCount,
+	      maxWALSize, ioStatistics.totalBytesWritten);
+	
+	[results addObject:@{
+		@"readers"              : @(readerCount),
+		@"writers"              : @(writerCount),
+		@"commitSize"           : @(commitSize),
+		@"seconds"              : @(elapsed),
+		@"readsPerSecond"       : @(readCount / elapsed),
+		@"writesPerSecond"      : @(writeCount / elapsed),
+		@"rowsPerSecond"        : @((writeCount * commitSize) / elapsed),
+		@"shortReads"           : shortReadSummary,
+		@"longReads"            : longReadSummary,
+		@"writes"               : writeSummary,
+		@"writeLockWaits"       : lockWaitSummary,
+		@"aggressiveCheckpoints": checkpointSummary,
+		@"checkpoints"          : @(checkpointCount),
+		@"busyCheckpoints"      : @(busyCheckpointCount),
+		@"maxWALSize"           : @(maxWALSize),
+		@"walSamples"           : walSamples,
+		@"bytesWritten"         : @(ioStatistics.totalBytesWritten),
+	}];
+	
+	[readers removeAllObjects];
+	[writers removeAllObjects];
+	database = nil;
+	
+	[self deleteDatabaseAtPath:databasePath];
+}
+
+#pragma mark Results
+
++ (void)writeResults
+{
+	NSError *error = nil;
+	NSData *data = [NSJSONSerialization dataWithJSONObject:@{ @"results" : results }
+	                                               options:NSJSONWritingPrettyPrinted
+	                                                 error:&error];
+	
+	NSString *resultsPath = [self resultsPath];
+	
+	if (data && [data writeToFile:resultsPath options:NSDataWritingAtomic error:&error])
+		NSLog(@"Results written to: %@", resultsPath);
+	else
+		NSLog(@"Error writing results: %@", error);
+}
+
++ (void)runTestsWithCompletion:(dispatch_block_t)completionBlock
+{
+	results = [NSMutableArray array];
+	[self generateKeys];
+	
+	NSArray<NSNumber *> *readerCounts =
+	  [self numbersForEnvironmentVariable:@"YDB_BENCHMARK_READERS" defaultValue:@[ @(1), @(2), @(4), @(8) ]];
+	NSArray<NSNumber *> *writerCounts =
+	  [self numbersForEnvironmentVariable:@"YDB_BENCHMARK_WRITERS" defaultValue:@[ @(1), @(2) ]];
+	NSArray<NSNumber *> *commitSizes =
+	  [self numbersForEnvironmentVariable:@"YDB_BENCHMARK_COMMIT_SIZE" defaultValue:@[ @(1), @(100) ]];
+	
+	NSTimeInterval duration =
+	  [[[self numbersForEnvironmentVariable:@"YDB_BENCHMARK_DURATION" defaultValue:@[ @(5) ]] firstObject] doubleValue];
+	
+	// The readers & writers block while they wait on each other, so we don't run on the main thread.
+	
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		
+		NSLog(@" \n\n\n ");
+		NSLog(@"YapDatabase Contention Benchmarks:");
+		NSLog(@" - readers     = %@", [readerCounts componentsJoinedByString:@", "]);
+		NSLog(@" - writers     = %@", [writerCounts componentsJoinedByString:@", "]);
+		NSLog(@" - commit size = %@", [commitSizes componentsJoinedByString:@", "]);
+		NSLog(@" - duration    = %.1f", duration);
+		NSLog(@"====================================================");
+		
+		for (NSNumber *commitSize in commitSizes)
+		{
+			for (NSNumber *writerCount in writerCounts)
+			{
+				for (NSNumber *readerCount in readerCounts)
+				{
+					[self benchmarkWithReaderCount:[readerCount unsignedIntegerValue]
+					                   writerCount:[writerCount unsignedIntegerValue]
+					                    commitSize:[commitSize unsignedIntegerValue]
+					                      duration:duration];
+					
+					NSLog(@"====================================================");
+				}
+			}
+		}
+		
+		[self writeResults];
+		
+		dispatch_async(dispatch_get_main_queue(), ^{
+			
+			if (completionBlock) completionBlock();
+		});
+	});
+}
+
+@end
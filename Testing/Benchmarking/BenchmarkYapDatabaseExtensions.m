@@ -0,0 +1,711 @@
+#import "BenchmarkYapDatabaseExtensions.h"
+#import "YapDatabase.h"
+#import "YapDatabaseAutoView.h"
+#import "YapDatabaseFilteredView.h"
+#import "YapDatabaseSecondaryIndex.h"
+#import "YapDatabaseFullTextSearch.h"
+#import "YapDatabaseRelationship.h"
+#import "YapDatabaseCloudCore.h"
+
+#import <stdlib.h>
+
+/**
+ * The number of rows inserted/processed per read-write transaction.
+ * The latency percentiles (p50 & p99) are calculated over the individual transactions (or queries).
+**/
+#define BENCHMARK_BATCH_SIZE  1000
+
+/**
+ * The number of queries run against the secondary index (per row count).
+**/
+#define BENCHMARK_QUERY_COUNT 1000
+
+static NSString *const Collection         = @"benchmark";
+static NSString *const ParentCollection   = @"parents";
+
+static NSString *const Ext_View           = @"view";
+static NSString *const Ext_FilteredView   = @"filteredView";
+static NSString *const Ext_SecondaryIndex = @"secondaryIndex";
+static NSString *const Ext_FullTextSearch = @"fts";
+static NSString *const Ext_Relationship   = @"relationship";
+static NSString *const Ext_CloudCore      = @"cloudCore";
+
+/**
+ * The pipeline is kept suspended, so this is never asked to start an operation.
+ * The benchmark only measures the throughput of adding & completing operations within the database.
+**/
+@interface BenchmarkCloudCorePipelineDelegate : NSObject <YapDatabaseCloudCorePipelineDelegate>
+@end
+
+@implementation BenchmarkCloudCorePipelineDelegate
+
+- (void)startOperation:(YapDatabaseCloudCoreOperation *)operation forPipeline:(YapDatabaseCloudCorePipeline *)pipeline
+{
+	// Nothing to do here
+}
+
+@end
+
+#pragma mark -
+
+/**
+ * Benchmarks the extensions (as opposed to BenchmarkYapDatabase, which covers the core get/set operations).
+ *
+ * Each scenario is run with 10K, 100K & 1M rows.
+ * The row counts can be overriden via the YDB_BENCHMARK_ROWS environment variable (e.g. "10000,50000").
+ *
+ * The results (ops/sec, p50 & p99 latency, bytes written) are logged,
+ * and written as JSON to BenchmarkYapDatabaseExtensions.json (in the caches directory),
+ * so that runs can be compared across commits.
+**/
+@implementation BenchmarkYapDatabaseExtensions
+
+static NSMutableArray *results;
+static NSString *sqliteVersion;
+static NSArray *words;
+static NSArray *groups;
+
++ (NSString *)baseDirectory
+{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+	return ([paths count] > 0) ? [paths objectAtIndex:0] : NSTemporaryDirectory();
+}
+
++ (NSString *)databasePathForScenario:(NSString *)scenario
+{
+	NSString *databaseName = [NSString stringWithFormat:@"BenchmarkYapDatabaseExtensions-%@.sqlite", scenario];
+	
+	return [[self baseDirectory] stringByAppendingPathComponent:databaseName];
+}
+
++ (NSString *)resultsPath
+{
+	return [[self baseDirectory] stringByAppendingPathComponent:@"BenchmarkYapDatabaseExtensions.json"];
+}
+
++ (void)deleteDatabaseAtPath:(NSString *)databasePath
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	
+	[fileManager removeItemAtPath:databasePath error:NULL];
+	[fileManager removeItemAtPath:[databasePath stringByAppendingString:@"-wal"] error:NULL];
+	[fileManager removeItemAtPath:[databasePath stringByAppendingString:@"-shm"] error:NULL];
+}
+
++ (YapDatabase *)newDatabaseAtPath:(NSString *)databasePath
+{
+	[self deleteDatabaseAtPath:databasePath];
+	
+	// The bytes written (by sqlite, to the database file & WAL) come from the I/O statistics.
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableIOStatistics = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	if (sqliteVersion == nil)
+		sqliteVersion = database.sqliteVersion;
+	
+	return database;
+}
+
++ (NSArray<NSNumber *> *)rowCounts
+{
+	NSString *str = [[[NSProcessInfo processInfo] environment] objectForKey:@"YDB_BENCHMARK_ROWS"];
+	
+	NSMutableArray<NSNumber *> *rowCounts = [NSMutableArray array];
+	for (NSString *component in [str componentsSeparatedByString:@","])
+	{
+		long long rowCount = [component longLongValue];
+		if (rowCount > 0) {
+			[rowCounts addObject:@((NSUInteger)rowCount)];
+		}
+	}
+	
+	if ([rowCounts count] == 0)
+		return @[ @(10000), @(100000), @(1000000) ];
+	else
+		return rowCounts;
+}
+
++ (double)percentile:(double)percentile ofSortedLatencies:(NSArray<NSNumber *> *)sortedLatencies
+{
+	NSUInteger count = [sortedLatencies count];
+	if (count == 0) return 0.0;
+	
+	NSUInteger index = (NSUInteger)ceil(percentile * count);
+	if (index > 0) index--;
+	if (index >= count) index = count - 1;
+	
+	return [[sortedLatencies objectAtIndex:index] doubleValue];
+}
+
++ (void)recordScenario:(NSString *)scenario
+              rowCount:(NSUInteger)rowCount
+            operations:(NSUInteger)operations
+             latencies:(NSArray<NSNumber *> *)latencies
+          bytesWritten:(uint64_t)bytesWritten
+{
+	NSArray<NSNumber *> *sortedLatencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+	
+	double elapsed = 0.0;
+	for (NSNumber *latency in latencies)
+	{
+		elapsed += [latency doubleValue];
+	}
+	
+	double opsPerSecond = (elapsed > 0.0) ? ((double)operations / elapsed) : 0.0;
+	double p50 = [self percentile:0.50 ofSortedLatencies:sortedLatencies];
+	double p99 = [self percentile:0.99 ofSortedLatencies:sortedLatencies];
+	
+	NSLog(@"%@ (%lu rows): total time: %.6f, ops/sec: %.1f, p50: %.6f, p99: %.6f, bytes written: %llu",
+	      scenario, (unsigned long)rowCount, elapsed, opsPerSecond, p50, p99, bytesWritten);
+	
+	[results addObject:@{
+		@"scenario"     : scenario,
+		@"rows"         : @(rowCount),
+		@"operations"   : @(operations),
+		@"seconds"      : @(elapsed),
+		@"opsPerSecond" : @(opsPerSecond),
+		@"p50"          : @(p50),
+		@"p99"          : @(p99),
+		@"bytesWritten" : @(bytesWritten),
+	}];
+}
+
+#pragma mark Data
+
++ (void)generateWords
+{
+	NSString *alphabet = @"abcdefghijklmnopqrstuvwxyz";
+	NSUInteger alphabetLength = [alphabet length];
+	
+	NSMutableArray *result = [NSMutableArray arrayWithCapacity:1024];
+	for (NSUInteger i = 0; i < 1024; i++)
+	{
+		NSUInteger length = 3 + arc4random_uniform(8);
+		NSMutableString *word = [NSMutableString stringWithCapacity:length];
+		
+		for (NSUInteger j = 0; j < length; j++)
+		{
+			uint32_t randomIndex = arc4random_uniform((uint32_t)alphabetLength);
+			[word appendFormat:@"%C", [alphabet characterAtIndex:(NSUInteger)randomIndex]];
+		}
+		
+		[result addObject:word];
+	}
+	words = [result copy];
+	
+	NSMutableArray *groupNames = [NSMutableArray arrayWithCapacity:16];
+	for (NSUInteger i = 0; i < 16; i++)
+	{
+		[groupNames addObject:[NSString stringWithFormat:@"group-%lu", (unsigned long)i]];
+	}
+	groups = [groupNames copy];
+}
+
++ (NSString *)keyForRow:(NSUInteger)row
+{
+	return [NSString stringWithFormat:@"%010lu", (unsigned long)row];
+}
+
++ (NSDictionary *)objectForRow:(NSUInteger)row
+{
+	NSUInteger wordCount = [words count];
+	
+	NSString *text = [NSString stringWithFormat:@"%@ %@ %@ %@",
+	  [words objectAtIndex:arc4random_uniform((uint32_t)wordCount)],
+	  [words objectAtIndex:arc4random_uniform((uint32_t)wordCount)],
+	  [words objectAtIndex:arc4random_uniform((uint32_t)wordCount)],
+	  [words objectAtIndex:arc4random_uniform((uint32_t)wordCount)]];
+	
+	return @{
+		@"value" : @(row % 1000),
+		@"text"  : text,
+	};
+}
+
+/**
+ * Inserts the rows in batches (one read-write transaction per batch).
+ * If latencies is non-nil, the duration of each transaction is appended to it.
+**/
++ (void)populateWithConnection:(YapDatabaseConnection *)connection
+                      rowCount:(NSUInteger)rowCount
+                     latencies:(NSMutableArray<NSNumber *> *)latencies
+{
+	for (NSUInteger offset = 0; offset < rowCount; offset += BENCHMARK_BATCH_SIZE)
+	{
+		NSUInteger end = MIN(offset + BENCHMARK_BATCH_SIZE, rowCount);
+		
+		NSDate *start = [NSDate date];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger row = offset; row < end; row++) { @autoreleasepool {
+				
+				[transaction setObject:[self objectForRow:row] forKey:[self keyForRow:row] inCollection:Collection];
+			}}
+		}];
+		
+		[latencies addObject:@([start timeIntervalSinceNow] * -1.0)];
+	}
+}
+
+#pragma mark Extensions
+
++ (YapDatabaseAutoView *)autoView
+{
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		NSUInteger value = [[(NSDictionary *)object objectForKey:@"value"] unsignedIntegerValue];
+		
+		return [groups objectAtIndex:(value % [groups count])];
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+	    ^NSComparisonResult (YapDatabaseReadTransaction *transaction, NSString *group,
+	                         NSString *collection1, NSString *key1, id object1,
+	                         NSString *collection2, NSString *key2, id object2)
+	{
+		NSString *text1 = [(NSDictionary *)object1 objectForKey:@"text"];
+		NSString *text2 = [(NSDictionary *)object2 objectForKey:@"text"];
+		
+		return [text1 compare:text2];
+	}];
+	
+	return [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+}
+
++ (YapDatabaseViewFiltering *)filteringWithModulus:(NSUInteger)modulus
+{
+	return [YapDatabaseViewFiltering withObjectBlock:
+	    ^BOOL (YapDatabaseReadTransaction *transaction, NSString *group,
+	           NSString *collection, NSString *key, id object)
+	{
+		NSUInteger value = [[(NSDictionary *)object objectForKey:@"value"] unsignedIntegerValue];
+		
+		return (value % modulus) == 0;
+	}];
+}
+
+#pragma mark Scenarios
+
++ (void)benchmarkAutoViewInsertWithRowCount:(NSUInteger)rowCount
+{
+	NSString *databasePath = [self databasePathForScenario:@"autoView"];
+	
+	YapDatabase *database = [self newDatabaseAtPath:databasePath];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[database registerExtension:[self autoView] withName:Ext_View];
+	
+	NSMutableArray<NSNumber *> *latencies = [NSMutableArray array];
+	uint64_t bytesBefore = database.ioStatistics.totalBytesWritten;
+	
+	[self populateWithConnection:connection rowCount:rowCount latencies:latencies];
+	
+	uint64_t bytesAfter = database.ioStatistics.totalBytesWritten;
+	
+	[self recordScenario:@"autoview_insert"
+	            rowCount:rowCount
+	          operations:rowCount
+	           latencies:latencies
+	        bytesWritten:(bytesAfter - bytesBefore)];
+	
+	connection = nil;
+	database = nil;
+	[self deleteDatabaseAtPath:databasePath];
+}
+
++ (void)benchmarkFilteredViewRepopulateWithRowCount:(NSUInteger)rowCount
+{
+	NSString *databasePath = [self databasePathForScenario:@"filteredView"];
+	
+	YapDatabase *database = [self newDatabaseAtPath:databasePath];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[database registerExtension:[self autoView] withName:Ext_View];
+	
+	[self populateWithConnection:connection rowCount:rowCount latencies:nil];
+	
+	YapDatabaseFilteredView *filteredView =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:Ext_View
+	                                                filtering:[self filteringWithModulus:2]
+	                                               versionTag:@"2"];
+	
+	[database registerExtension:filteredView withName:Ext_FilteredView];
+	
+	// Each repopulate re-runs the filter over every row in the parent view.
+	
+	NSArray<NSNumber *> *moduli = @[ @(3), @(5), @(2), @(7) ];
+	
+	NSMutableArray<NSNumber *> *latencies = [NSMutableArray array];
+	uint64_t bytesBefore = database.ioStatistics.totalBytesWritten;
+	
+	for (NSNumber *modulus in moduli)
+	{
+		YapDatabaseViewFiltering *filtering = [self filteringWithModulus:[modulus unsignedIntegerValue]];
+		NSString *versionTag = [modulus stringValue];
+		
+		NSDate *start = [NSDate date];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[[transaction ext:Ext_FilteredView] setFiltering:filtering versionTag:versionTag];
+		}];
+		
+		[latencies addObject:@([start timeIntervalSinceNow] * -1.0)];
+	}
+	
+	uint64_t bytesAfter = database.ioStatistics.totalBytesWritten;
+	
+	[self recordScenario:@"filteredview_repopulate"
+	            rowCount:rowCount
+	          operations:(rowCount * [moduli count])
+	           latencies:latencies
+	        bytesWritten:(bytesAfter - bytesBefore)];
+	
+	connection = nil;
+	database = nil;
+	[self deleteDatabaseAtPath:databasePath];
+}
+
++ (void)benchmarkSecondaryIndexQueryWithRowCount:(NSUInteger)rowCount
+{
+	NSString *databasePath = [self databasePathForScenario:@"secondaryIndex"];
+	
+	YapDatabase *database = [self newDatabaseAtPath:databasePath];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict,
+	      NSString *collection, NSString *key, id object)
+	{
+		[dict setObject:[(NSDictionary *)object objectForKey:@"value"] forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler];
+	
+	[database registerExtension:secondaryIndex withName:Ext_SecondaryIndex];
+	
+	[self populateWithConnection:connection rowCount:rowCount latencies:nil];
+	
+	NSMutableArray<NSNumber *> *latencies = [NSMutableArray arrayWithCapacity:BENCHMARK_QUERY_COUNT];
+	__block NSUInteger matchCount = 0;
+	
+	uint64_t bytesBefore = database.ioStatistics.totalBytesWritten;
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < BENCHMARK_QUERY_COUNT; i++) { @autoreleasepool {
+			
+			YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value = ?", @(i % 1000)];
+			
+			NSDate *start = [NSDate date];
+			
+			[[transaction ext:Ext_SecondaryIndex] enumerateKeysMatchingQuery:query
+			                                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop)
+			{
+				matchCount++;
+			}];
+			
+			[latencies addObject:@([start timeIntervalSinceNow] * -1.0)];
+		}}
+	}];
+	
+	uint64_t bytesAfter = database.ioStatistics.totalBytesWritten;
+	
+	NSLog(@"secondaryindex_query (%lu rows): matched keys: %lu", (unsigned long)rowCount, (unsigned long)matchCount);
+	
+	[self recordScenario:@"secondaryindex_query"
+	            rowCount:rowCount
+	          operations:BENCHMARK_QUERY_COUNT
+	           latencies:latencies
+	        bytesWritten:(bytesAfter - bytesBefore)];
+	
+	connection = nil;
+	database = nil;
+	[self deleteDatabaseAtPath:databasePath];
+}
+
++ (void)benchmarkFullTextSearchIndexWithRowCount:(NSUInteger)rowCount
+{
+	NSString *databasePath = [self databasePathForScenario:@"fts"];
+	
+	YapDatabase *database = [self newDatabaseAtPath:databasePath];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict,
+	      NSString *collection, NSString *key, id object)
+	{
+		[dict setObject:[(NSDictionary *)object objectForKey:@"text"] forKey:@"text"];
+	}];
+	
+	YapDatabaseFullTextSearch *fts = [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[ @"text" ]
+	                                                                                handler:handler];
+	
+	[database registerExtension:fts withName:Ext_FullTextSearch];
+	
+	NSMutableArray<NSNumber *> *latencies = [NSMutableArray array];
+	uint64_t bytesBefore = database.ioStatistics.totalBytesWritten;
+	
+	[self populateWithConnection:connection rowCount:rowCount latencies:latencies];
+	
+	uint64_t bytesAfter = database.ioStatistics.totalBytesWritten;
+	
+	[self recordScenario:@"fts_index"
+	            rowCount:rowCount
+	          operations:rowCount
+	           latencies:latencies
+	        bytesWritten:(bytesAfter - bytesBefore)];
+	
+	connection = nil;
+	database = nil;
+	[self deleteDatabaseAtPath:databasePath];
+}
+
++ (void)benchmarkRelationshipCascadeWithRowCount:(NSUInteger)rowCount
+{
+	NSString *databasePath = [self databasePathForScenario:@"relationship"];
+	
+	YapDatabase *database = [self newDatabaseAtPath:databasePath];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[database registerExtension:[[YapDatabaseRelationship alloc] init] withName:Ext_Relationship];
+	
+	// Half the rows are parents, and every parent has an edge to a child.
+	// Deleting a parent cascades to its child.
+	
+	NSUInteger parentCount = MAX(rowCount / 2, (NSUInteger)1);
+	
+	for (NSUInteger offset = 0; offset < parentCount; offset += BENCHMARK_BATCH_SIZE)
+	{
+		NSUInteger end = MIN(offset + BENCHMARK_BATCH_SIZE, parentCount);
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger row = offset; row < end; row++) { @autoreleasepool {
+				
+				NSString *key = [self keyForRow:row];
+				
+				[transaction setObject:[self objectForRow:row] forKey:key inCollection:ParentCollection];
+				[transaction setObject:[self objectForRow:row] forKey:key inCollection:Collection];
+				
+				YapDatabaseRelationshipEdge *edge =
+				  [YapDatabaseRelationshipEdge edgeWithName:@"child"
+				                                  sourceKey:key
+				                                 collection:ParentCollection
+				                             destinationKey:key
+				                                 collection:Collection
+				                            nodeDeleteRules:YDB_DeleteDestinationIfSourceDeleted];
+				
+				[[transaction ext:Ext_Relationship] addEdge:edge];
+			}}
+		}];
+	}
+	
+	NSMutableArray<NSNumber *> *latencies = [NSMutableArray array];
+	uint64_t bytesBefore = database.ioStatistics.totalBytesWritten;
+	
+	for (NSUInteger offset = 0; offset < parentCount; offset += BENCHMARK_BATCH_SIZE)
+	{
+		NSUInteger end = MIN(offset + BENCHMARK_BATCH_SIZE, parentCount);
+		
+		NSMutableArray *keys = [NSMutableArray arrayWithCapacity:(end - offset)];
+		for (NSUInteger row = offset; row < end; row++)
+		{
+			[keys addObject:[self keyForRow:row]];
+		}
+		
+		NSDate *start = [NSDate date];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction removeObjectsForKeys:keys inCollection:ParentCollection];
+		}];
+		
+		[latencies addObject:@([start timeIntervalSinceNow] * -1.0)];
+	}
+	
+	uint64_t bytesAfter = database.ioStatistics.totalBytesWritten;
+	
+	__block NSUInteger remainingChildren = 0;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		remainingChildren = [transaction numberOfKeysInCollection:Collection];
+	}];
+	
+	if (remainingChildren > 0) {
+		NSLog(@"relationship_cascade (%lu rows): %lu children were NOT deleted !",
+		      (unsigned long)rowCount, (unsigned long)remainingChildren);
+	}
+	
+	// Every deleted parent, plus every cascaded child
+	
+	[self recordScenario:@"relationship_cascade"
+	            rowCount:rowCount
+	          operations:(parentCount * 2)
+	           latencies:latencies
+	        bytesWritten:(bytesAfter - bytesBefore)];
+	
+	connection = nil;
+	database = nil;
+	[self deleteDatabaseAtPath:databasePath];
+}
+
++ (void)benchmarkCloudCorePipelineWithRowCount:(NSUInteger)rowCount
+{
+	NSString *databasePath = [self databasePathForScenario:@"cloudCore"];
+	
+	YapDatabase *database = [self newDatabaseAtPath:databasePath];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	BenchmarkCloudCorePipelineDelegate *delegate = [[BenchmarkCloudCorePipelineDelegate alloc] init];
+	
+	YapDatabaseCloudCorePipeline *pipeline =
+	  [[YapDatabaseCloudCorePipeline alloc] initWithName:YapDatabaseCloudCoreDefaultPipelineName delegate:delegate];
+	[pipeline suspend];
+	
+	YapDatabaseCloudCore *cloudCore = [[YapDatabaseCloudCore alloc] initWithVersionTag:@"1" options:nil];
+	[cloudCore registerPipeline:pipeline];
+	
+	[database registerExtension:cloudCore withName:Ext_CloudCore];
+	
+	NSMutableArray<NSUUID *> *uuids = [NSMutableArray arrayWithCapacity:rowCount];
+	
+	// Add operations
+	
+	NSMutableArray<NSNumber *> *latencies = [NSMutableArray array];
+	uint64_t bytesBefore = database.ioStatistics.totalBytesWritten;
+	
+	for (NSUInteger offset = 0; offset < rowCount; offset += BENCHMARK_BATCH_SIZE)
+	{
+		NSUInteger end = MIN(offset + BENCHMARK_BATCH_SIZE, rowCount);
+		
+		NSDate *start = [NSDate date];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger i = offset; i < end; i++) { @autoreleasepool {
+				
+				YapDatabaseCloudCoreOperation *operation = [[YapDatabaseCloudCoreOperation alloc] init];
+				
+				[[transaction ext:Ext_CloudCore] addOperation:operation];
+				[uuids addObject:operation.uuid];
+			}}
+		}];
+		
+		[latencies addObject:@([start timeIntervalSinceNow] * -1.0)];
+	}
+	
+	uint64_t bytesAfter = database.ioStatistics.totalBytesWritten;
+	
+	[self recordScenario:@"cloudcore_add"
+	            rowCount:rowCount
+	          operations:rowCount
+	           latencies:latencies
+	        bytesWritten:(bytesAfter - bytesBefore)];
+	
+	// Complete operations
+	
+	latencies = [NSMutableArray array];
+	bytesBefore = database.ioStatistics.totalBytesWritten;
+	
+	for (NSUInteger offset = 0; offset < rowCount; offset += BENCHMARK_BATCH_SIZE)
+	{
+		NSUInteger end = MIN(offset + BENCHMARK_BATCH_SIZE, rowCount);
+		
+		NSDate *start = [NSDate date];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger i = offset; i < end; i++)
+			{
+				[[transaction ext:Ext_CloudCore] completeOperationWithUUID:[uuids objectAtIndex:i]];
+			}
+		}];
+		
+		[latencies addObject:@([start timeIntervalSinceNow] * -1.0)];
+	}
+	
+	bytesAfter = database.ioStatistics.totalBytesWritten;
+	
+	[self recordScenario:@"cloudcore_complete"
+	            rowCount:rowCount
+	          operations:rowCount
+	           latencies:latencies
+	        bytesWritten:(bytesAfter - bytesBefore)];
+	
+	connection = nil;
+	database = nil;
+	[self deleteDatabaseAtPath:databasePath];
+}
+
+#pragma mark Results
+
++ (void)writeResults
+{
+	NSDictionary *json = @{
+		@"sqliteVersion" : (sqliteVersion ?: @""),
+		@"batchSize"     : @(BENCHMARK_BATCH_SIZE),
+		@"results"       : results,
+	};
+	
+	NSError *error = nil;
+	NSData *data = [NSJSONSerialization dataWithJSONObject:json options:NSJSONWritingPrettyPrinted error:&error];
+	
+	NSString *resultsPath = [self resultsPath];
+	
+	if (data && [data writeToFile:resultsPath options:NSDataWritingAtomic error:&error])
+		NSLog(@"Results written to: %@", resultsPath);
+	else
+		NSLog(@"Error writing results: %@", error);
+}
+
++ (void)runTestsWithCompletion:(dispatch_block_t)completionBlock
+{
+	results = [NSMutableArray array];
+	[self generateWords];
+	
+	NSArray<NSNumber *> *rowCounts = [self rowCounts];
+	
+	// The larger row counts take a while, so we don't block the main thread.
+	
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		
+		NSLog(@" \n\n\n ");
+		NSLog(@"YapDatabase Extension Benchmarks:");
+		NSLog(@" - row counts = %@", [rowCounts componentsJoinedByString:@", "]);
+		NSLog(@" - batch size = %d", BENCHMARK_BATCH_SIZE);
+		NSLog(@"====================================================");
+		
+		for (NSNumber *number in rowCounts)
+		{
+			NSUInteger rowCount = [number unsignedIntegerValue];
+			
+			[self benchmarkAutoViewInsertWithRowCount:rowCount];
+			[self benchmarkFilteredViewRepopulateWithRowCount:rowCount];
+			[self benchmarkSecondaryIndexQueryWithRowCount:rowCount];
+			[self benchmarkFullTextSearchIndexWithRowCount:rowCount];
+			[self benchmarkRelationshipCascadeWithRowCount:rowCount];
+			[self benchmarkCloudCorePipelineWithRowCount:rowCount];
+			
+			NSLog(@"====================================================");
+		}
+		
+		[self writeResults];
+		
+		dispatch_async(dispatch_get_main_queue(), ^{
+			
+			if (completionBlock) completionBlock();
+		});
+	});
+}
+
+@end
@@ -0,0 +1,298 @@
+#import "BenchmarkYapDatabaseViewChange.h"
+#import "YapDatabaseViewChangePrivate.h"
+#import "YapCollectionKey.h"
+
+#import <stdlib.h>
+
+
+/**
+ * Replays "change storms" (the row changes recorded by a view during a large read-write transaction)
+ * through the post-processing of YapDatabaseViewChange.
+ *
+ * The previous (quadratic) index adjustment algorithm is kept here as the baseline,
+ * for the head-to-head comparison with the current (tree based) algorithm.
+ * Both results are consolidated and compared, so the benchmark doubles as a consistency check.
+**/
+@implementation BenchmarkYapDatabaseViewChange
+
+static NSMutableArray *storm;
+
+/**
+ * The previous design of steps 1 & 2 of +[YapDatabaseViewChange processRowChanges:withOriginalMappings:finalMappings:]
+ * Every operation adjusts the index values of every other operation.
+**/
++ (void)quadraticProcessRowChanges:(NSArray *)rowChanges
+{
+	NSUInteger rowChangesCount = [rowChanges count];
+	
+	for (NSUInteger i = rowChangesCount; i > 0; i--)
+	{
+		YapDatabaseViewRowChange *rowChange = rowChanges[i-1];
+		
+		for (NSUInteger j = i; j < rowChangesCount; j++)
+		{
+			YapDatabaseViewRowChange *laterRowChange = rowChanges[j];
+			
+			if (laterRowChange->type != YapDatabaseViewChangeDelete &&
+			    laterRowChange->type != YapDatabaseViewChangeUpdate) continue;
+			
+			if (rowChange->type == YapDatabaseViewChangeDelete)
+			{
+				if (laterRowChange->originalIndex >= rowChange->opOriginalIndex &&
+				   [laterRowChange->originalGroup isEqualToString:rowChange->originalGroup])
+				{
+					laterRowChange->originalIndex += 1;
+				}
+			}
+			else if (rowChange->type == YapDatabaseViewChangeInsert)
+			{
+				if (laterRowChange->originalIndex > rowChange->opFinalIndex &&
+				   [laterRowChange->originalGroup isEqualToString:rowChange->finalGroup])
+				{
+					laterRowChange->originalIndex -= 1;
+				}
+			}
+		}
+	}
+	
+	for (NSUInteger i = 1; i < rowChangesCount; i++)
+	{
+		YapDatabaseViewRowChange *rowChange = rowChanges[i];
+		
+		for (NSUInteger j = i; j > 0; j--)
+		{
+			YapDatabaseViewRowChange *earlierRowChange = rowChanges[j-1];
+			
+			if (earlierRowChange->type != YapDatabaseViewChangeInsert &&
+			    earlierRowChange->type != YapDatabaseViewChangeUpdate) continue;
+			
+			if (rowChange->type == YapDatabaseViewChangeDelete)
+			{
+				if (earlierRowChange->finalIndex > rowChange->opOriginalIndex &&
+				   [earlierRowChange->finalGroup isEqualToString:rowChange->originalGroup])
+				{
+					earlierRowChange->finalIndex -= 1;
+				}
+			}
+			else if (rowChange->type == YapDatabaseViewChangeInsert)
+			{
+				if (earlierRowChange->finalIndex >= rowChange->opFinalIndex &&
+				   [earlierRowChange->finalGroup isEqualToString:rowChange->finalGroup])
+				{
+					earlierRowChange->finalIndex += 1;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Generates the row changes for the given number of operations, applied to a set of groups.
+ * The operations are applied to an actual model of the groups, so the storm is consistent (like a real view).
+ *
+ * The percentages are for inserts, deletes & moves. The remainder is updates.
+ * Bulk operations (such as appending rows) are simulated by using a single group and position for every operation.
+**/
++ (void)generateStormWithOperations:(NSUInteger)operationCount
+                             groups:(NSUInteger)groupCount
+                       initialCount:(NSUInteger)initialCount
+                      insertPercent:(uint32_t)insertPercent
+                      deletePercent:(uint32_t)deletePercent
+                        movePercent:(uint32_t)movePercent
+                               bulk:(BOOL)bulk
+{
+	storm = [NSMutableArray arrayWithCapacity:(operationCount * 2)];
+	
+	NSMutableArray *groups = [NSMutableArray arrayWithCapacity:groupCount];
+	NSMutableArray *groupRows = [NSMutableArray arrayWithCapacity:groupCount];
+	
+	NSUInteger keyCount = 0;
+	
+	for (NSUInteger g = 0; g < groupCount; g++)
+	{
+		[groups addObject:[NSString stringWithFormat:@"group%lu", (unsigned long)g]];
+		
+		NSMutableArray *rows = [NSMutableArray arrayWithCapacity:initialCount];
+		for (NSUInteger r = 0; r < initialCount; r++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)keyCount++];
+			[rows addObject:YapCollectionKeyCreate(@"", key)];
+		}
+		
+		[groupRows addObject:rows];
+	}
+	
+	for (NSUInteger i = 0; i < operationCount; i++)
+	{
+		NSUInteger g = bulk ? 0 : (NSUInteger)arc4random_uniform((uint32_t)groupCount);
+		NSString *group = groups[g];
+		NSMutableArray *rows = groupRows[g];
+		
+		uint32_t rand = arc4random_uniform(100);
+		
+		if (rand < insertPercent || [rows count] == 0)
+		{
+			NSUInteger index = bulk ? [rows count] : (NSUInteger)arc4random_uniform((uint32_t)[rows count] + 1);
+			
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)keyCount++];
+			YapCollectionKey *ck = YapCollectionKeyCreate(@"", key);
+			
+			[rows insertObject:ck atIndex:index];
+			[storm addObject:[YapDatabaseViewRowChange insertCollectionKey:ck inGroup:group atIndex:index]];
+		}
+		else if (rand < (insertPercent + deletePercent + movePercent))
+		{
+			NSUInteger index = bulk ? 0 : (NSUInteger)arc4random_uniform((uint32_t)[rows count]);
+			
+			YapCollectionKey *ck = rows[index];
+			
+			[rows removeObjectAtIndex:index];
+			[storm addObject:[YapDatabaseViewRowChange deleteCollectionKey:ck inGroup:group atIndex:index]];
+			
+			if (rand >= (insertPercent + deletePercent))
+			{
+				// Move (to a random group & position)
+				
+				NSUInteger g2 = (NSUInteger)arc4random_uniform((uint32_t)groupCount);
+				NSString *group2 = groups[g2];
+				NSMutableArray *rows2 = groupRows[g2];
+				
+				NSUInteger index2 = (NSUInteger)arc4random_uniform((uint32_t)[rows2 count] + 1);
+				
+				[rows2 insertObject:ck atIndex:index2];
+				[storm addObject:[YapDatabaseViewRowChange insertCollectionKey:ck inGroup:group2 atIndex:index2]];
+			}
+		}
+		else
+		{
+			NSUInteger index = (NSUInteger)arc4random_uniform((uint32_t)[rows count]);
+			
+			YapCollectionKey *ck = rows[index];
+			
+			[storm addObject:[YapDatabaseViewRowChange updateCollectionKey:ck
+			                                                       inGroup:group
+			                                                       atIndex:index
+			                                                   withChanges:YapDatabaseViewChangedObject]];
+		}
+	}
+}
+
++ (NSMutableArray *)copyOfStorm
+{
+	NSMutableArray *copy = [NSMutableArray arrayWithCapacity:[storm count]];
+	for (YapDatabaseViewRowChange *rowChange in storm)
+	{
+		[copy addObject:[rowChange copy]];
+	}
+	
+	return copy;
+}
+
++ (BOOL)rowChanges:(NSArray *)rowChangesA isEqualToRowChanges:(NSArray *)rowChangesB
+{
+	if ([rowChangesA count] != [rowChangesB count]) return NO;
+	
+	for (NSUInteger i = 0; i < [rowChangesA count]; i++)
+	{
+		YapDatabaseViewRowChange *a = rowChangesA[i];
+		YapDatabaseViewRowChange *b = rowChangesB[i];
+		
+		if (a->type != b->type) return NO;
+		if (a->originalIndex != b->originalIndex) return NO;
+		if (a->finalIndex != b->finalIndex) return NO;
+		if (!YapCollectionKeyEqual(a->collectionKey, b->collectionKey)) return NO;
+	}
+	
+	return YES;
+}
+
++ (void)runStormWithName:(NSString *)name
+{
+	NSMutableArray *quadraticChanges = [self copyOfStorm];
+	NSMutableArray *rowChanges = [self copyOfStorm];
+	
+	NSDate *start = [NSDate date];
+	
+	[self quadraticProcessRowChanges:quadraticChanges];
+	[YapDatabaseViewChange consolidateRowChanges:quadraticChanges];
+	
+	NSTimeInterval quadratic = [start timeIntervalSinceNow] * -1.0;
+	
+	start = [NSDate date];
+	
+	[YapDatabaseViewChange processRowChanges:rowChanges withOriginalMappings:nil finalMappings:nil];
+	[YapDatabaseViewChange consolidateRowChanges:rowChanges];
+	
+	NSTimeInterval current = [start timeIntervalSinceNow] * -1.0;
+	
+	BOOL match = [self rowChanges:quadraticChanges isEqualToRowChanges:rowChanges];
+	
+	NSLog(@"%@ (%lu row changes -> %lu): quadratic = %.6f, current = %.6f (%.2fx)%@",
+	      name, (unsigned long)[storm count], (unsigned long)[rowChanges count],
+	      quadratic, current, (current > 0.0 ? (quadratic / current) : 0.0),
+	      (match ? @"" : @" !!! RESULTS DON'T MATCH !!!"));
+}
+
++ (void)runTestsWithCompletion:(dispatch_block_t)completionBlock
+{
+	NSArray *operationCounts = @[ @(1000), @(5000), @(10000) ];
+	
+	for (NSNumber *number in operationCounts)
+	{
+		NSUInteger operationCount = [number unsignedIntegerValue];
+		
+		dispatch_async(dispatch_get_main_queue(), ^{
+			
+			NSLog(@"OPERATIONS: %lu \n\n", (unsigned long)operationCount);
+			
+			// Appending a batch of rows (e.g. the initial sync of a list)
+			[self generateStormWithOperations:operationCount
+			                           groups:1
+			                     initialCount:100
+			                    insertPercent:100
+			                    deletePercent:0
+			                      movePercent:0
+			                             bulk:YES];
+			[self runStormWithName:@"Bulk insert"];
+			
+			// Deleting a batch of rows from the top (e.g. pruning old messages)
+			[self generateStormWithOperations:operationCount
+			                           groups:1
+			                     initialCount:operationCount
+			                    insertPercent:0
+			                    deletePercent:100
+			                      movePercent:0
+			                             bulk:YES];
+			[self runStormWithName:@"Bulk delete"];
+			
+			// Mixed changes scattered across groups (e.g. a sync that touches everything)
+			[self generateStormWithOperations:operationCount
+			                           groups:10
+			                     initialCount:1000
+			                    insertPercent:30
+			                    deletePercent:20
+			                      movePercent:30
+			                             bulk:NO];
+			[self runStormWithName:@"Mixed storm"];
+			
+			// Mostly moves within a few groups (e.g. re-sorting by a changing timestamp)
+			[self generateStormWithOperations:operationCount
+			                           groups:2
+			                     initialCount:500
+			                    insertPercent:5
+			                    deletePercent:5
+			                      movePercent:80
+			                             bulk:NO];
+			[self runStormWithName:@"Move storm"];
+			
+			NSLog(@"====================================================");
+		});
+	}
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		
+		if (completionBlock) completionBlock();
+	});
+}
+
+@end
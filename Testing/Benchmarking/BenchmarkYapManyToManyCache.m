@@ -0,0 +1,129 @@
+#import "BenchmarkYapManyToManyCache.h"
+#import "YapManyToManyCache.h"
+
+#define LOOP_COUNT 25000
+
+
+/**
+ * Replays the access pattern of the CloudCore mapping caches (rowid <-> cloudURI).
+ *
+ * - Every object write looks up the cloudURIs attached to the rowid (enumerateValuesForKey),
+ *   and inserts the mapping on a miss (e.g. allAttachedCloudURIsForRowid:).
+ * - Some writes check whether a cloudURI is attached to anything (containsValue),
+ *   or enumerate the rowids for a cloudURI (enumerateKeysForValue).
+ * - A few writes detach a cloudURI from everything (removeAllItemsWithValue).
+ *
+ * The cost per operation should stay flat as the number of entries grows.
+**/
+@implementation BenchmarkYapManyToManyCache
+
+static NSMutableArray<NSNumber *> *rowids;
+static NSMutableArray<NSString *> *cloudURIs;
+
++ (void)generateMappingsWithCount:(NSUInteger)mappingCount
+{
+	rowids = [NSMutableArray arrayWithCapacity:LOOP_COUNT];
+	cloudURIs = [NSMutableArray arrayWithCapacity:LOOP_COUNT];
+	
+	for (NSUInteger i = 0; i < LOOP_COUNT; i++)
+	{
+		// Most rowids map to a single cloudURI, but a few of them share the same cloudURI.
+		
+		uint32_t rowid = arc4random_uniform((uint32_t)mappingCount);
+		uint32_t uriIndex = (arc4random_uniform(10) == 0) ? (rowid / 4) : rowid;
+		
+		[rowids addObject:@(rowid)];
+		[cloudURIs addObject:[NSString stringWithFormat:@"/records/%u.json", uriIndex]];
+	}
+}
+
++ (NSTimeInterval)testCacheWithCountLimit:(NSUInteger)countLimit
+{
+	YapManyToManyCache *cache = [[YapManyToManyCache alloc] initWithCountLimit:countLimit];
+	
+	__block NSUInteger hitCount = 0;
+	
+	NSDate *start = [NSDate date];
+	
+	for (NSUInteger i = 0; i < LOOP_COUNT; i++)
+	{
+		NSNumber *rowid = rowids[i];
+		NSString *cloudURI = cloudURIs[i];
+		
+		__block BOOL found = NO;
+		[cache enumerateValuesForKey:rowid withBlock:^(id value, id metadata, BOOL *stop) {
+			
+			found = YES;
+		}];
+		
+		if (found)
+			hitCount++;
+		else
+			[cache insertKey:rowid value:cloudURI];
+		
+		switch (i % 10)
+		{
+			case 3 : {
+				[cache containsValue:cloudURI];
+				break;
+			}
+			case 6 : {
+				[cache enumerateKeysForValue:cloudURI withBlock:^(id key, id metadata, BOOL *stop) {}];
+				break;
+			}
+			case 9 : {
+				if ((i % 100) == 99) {
+					[cache removeAllItemsWithValue:cloudURI];
+				}
+				break;
+			}
+		}
+	}
+	
+	NSTimeInterval elapsed = [start timeIntervalSinceNow] * -1.0;
+	double hitPercentage = (double)hitCount / (double)LOOP_COUNT;
+	
+	NSLog(@"YapManyToManyCache(countLimit = %lu): elapsed = %.6f (hit percentage = %.2f, final count = %lu)",
+	      (unsigned long)countLimit, elapsed, hitPercentage, (unsigned long)cache.count);
+	
+	return elapsed;
+}
+
++ (void)runTestsWithCompletion:(dispatch_block_t)completionBlock
+{
+	NSArray *mappingCounts = @[ @(1000), @(10000), @(100000) ];
+	
+	for (NSNumber *number in mappingCounts)
+	{
+		NSUInteger mappingCount = [number unsignedIntegerValue];
+		
+		dispatch_async(dispatch_get_main_queue(), ^{
+			
+			NSLog(@"MAPPINGS: %lu \n\n", (unsigned long)mappingCount);
+			
+			[self generateMappingsWithCount:mappingCount];
+			
+			NSTimeInterval limited = 0.0;
+			NSTimeInterval unlimited = 0.0;
+			
+			// - countLimit 64 : the size of the clean mapping cache (YapDatabaseCloudCoreConnection)
+			// - countLimit 0  : unlimited (e.g. the dirty mapping info during a large transaction)
+			
+			for (NSUInteger i = 0; i < 3; i++)
+			{
+				limited   += [self testCacheWithCountLimit:64];
+				unlimited += [self testCacheWithCountLimit:0];
+			}
+			
+			NSLog(@"Average: countLimit(64) = %.6f, unlimited = %.6f \n ", (limited / 3.0), (unlimited / 3.0));
+			NSLog(@"====================================================");
+		});
+	}
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		
+		if (completionBlock) completionBlock();
+	});
+}
+
+@end
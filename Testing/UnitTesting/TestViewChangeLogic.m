@@ -2922,4 +2922,185 @@ static YapDatabaseViewRowChange* (^RowOp)(NSArray*, NSUInteger) = ^(NSArray *rCh
 	XCTAssertTrue(RowOp(rowChanges, 1).originalIndex == 1, @"");
 }
 
+/**
+ * A bulk insert (appending rows), followed by a bulk delete (of the first rows).
+**/
+- (void)testBulkInsertAndDeleteRanges
+{
+	//     orig     insert x100   delete x3
+	//
+	// 0   | o0   | o0          | o3
+	// ... | ...  | ...         | ...
+	// 9   | o9   | o9          | o9
+	// 10  |      | k0          | k0  (final index 7)
+	// ... |      | ...         | ...
+	// 109 |      | k99         |
+	
+	for (NSUInteger i = 0; i < 100; i++)
+	{
+		NSString *key = [NSString stringWithFormat:@"k%lu", (unsigned long)i];
+		[changes addObject:[YapDatabaseViewRowChange insertCollectionKey:YCK(nil, key) inGroup:@"A" atIndex:(10 + i)]];
+	}
+	for (NSUInteger i = 0; i < 3; i++)
+	{
+		NSString *key = [NSString stringWithFormat:@"o%lu", (unsigned long)i];
+		[changes addObject:[YapDatabaseViewRowChange deleteCollectionKey:YCK(nil, key) inGroup:@"A" atIndex:0]];
+	}
+	
+	// Process
+	
+	NSArray *sectionChanges;
+	NSArray *rowChanges;
+	
+	YapDatabaseViewMappings *mappings = [[YapDatabaseViewMappings alloc] initWithGroups:@[@"A"] view:@""];
+	
+	[mappings updateWithCounts:@{ @"A": @(10) } forceUpdateRangeOptions:NO];
+	YapDatabaseViewMappings *originalMappings = [mappings copy];
+	
+	[mappings updateWithCounts:@{ @"A": @(107) } forceUpdateRangeOptions:NO];
+	[YapDatabaseViewChange getSectionChanges:&sectionChanges
+	                              rowChanges:&rowChanges
+	                    withOriginalMappings:originalMappings
+	                           finalMappings:mappings
+	                             fromChanges:changes];
+	
+	// Expecting:
+	//
+	// Row Delete : [0, 0], [0, 1], [0, 2]
+	// Row Insert : [0, 7] ... [0, 106]
+	
+	XCTAssertTrue([sectionChanges count] == 0, @"");
+	XCTAssertTrue([rowChanges count] == 103, @"");
+	
+	for (NSUInteger i = 0; i < 100; i++)
+	{
+		XCTAssertTrue(RowOp(rowChanges, i).type == YapDatabaseViewChangeInsert, @"");
+		XCTAssertTrue(RowOp(rowChanges, i).finalIndex == (7 + i), @"");
+	}
+	for (NSUInteger i = 0; i < 3; i++)
+	{
+		XCTAssertTrue(RowOp(rowChanges, 100 + i).type == YapDatabaseViewChangeDelete, @"");
+		XCTAssertTrue(RowOp(rowChanges, 100 + i).originalIndex == i, @"");
+	}
+	
+	// Range changes
+	
+	NSArray *rangeChanges = [YapDatabaseViewRangeChange rangeChangesForRowChanges:rowChanges];
+	
+	XCTAssertTrue([rangeChanges count] == 2, @"");
+	
+	YapDatabaseViewRangeChange *deleteRange = rangeChanges[0];
+	XCTAssertTrue(deleteRange.type == YapDatabaseViewChangeDelete, @"");
+	XCTAssertTrue(deleteRange.section == 0, @"");
+	XCTAssertTrue(NSEqualRanges(deleteRange.range, NSMakeRange(0, 3)), @"");
+	XCTAssertTrue([deleteRange.indexPaths count] == 3, @"");
+	
+	YapDatabaseViewRangeChange *insertRange = rangeChanges[1];
+	XCTAssertTrue(insertRange.type == YapDatabaseViewChangeInsert, @"");
+	XCTAssertTrue(insertRange.section == 0, @"");
+	XCTAssertTrue(NSEqualRanges(insertRange.range, NSMakeRange(7, 100)), @"");
+	XCTAssertTrue([insertRange.indexPaths count] == 100, @"");
+}
+
+/**
+ * A large storm of random changes (inserts, deletes, moves & updates across several groups),
+ * recorded against an actual model of the groups.
+ * The processed changes must match the original & final positions of the rows in the model.
+**/
+- (void)testRandomStorm
+{
+	NSArray *groups = @[ @"A", @"B", @"C" ];
+	
+	NSMutableDictionary *originalRows = [NSMutableDictionary dictionary]; // group -> rows (at the start)
+	NSMutableDictionary *rows = [NSMutableDictionary dictionary];         // group -> rows (current)
+	
+	NSUInteger keyCount = 0;
+	for (NSString *group in groups)
+	{
+		NSMutableArray *groupRows = [NSMutableArray array];
+		for (NSUInteger i = 0; i < 50; i++)
+		{
+			[groupRows addObject:YCK(@"", ([NSString stringWithFormat:@"%lu", (unsigned long)keyCount++]))];
+		}
+		
+		originalRows[group] = [groupRows copy];
+		rows[group] = groupRows;
+	}
+	
+	__block uint32_t seed = 12345;
+	uint32_t (^Random)(uint32_t) = ^uint32_t (uint32_t upperBound){
+		
+		return (uint32_t)((seed = (seed * 1103515245) + 12345) >> 8) % upperBound;
+	};
+	
+	for (NSUInteger i = 0; i < 2000; i++)
+	{
+		NSString *group = groups[Random((uint32_t)[groups count])];
+		NSMutableArray *groupRows = rows[group];
+		
+		uint32_t op = Random(4);
+		
+		if (op == 0 || [groupRows count] == 0)
+		{
+			NSUInteger index = Random((uint32_t)[groupRows count] + 1);
+			YapCollectionKey *ck = YCK(@"", ([NSString stringWithFormat:@"%lu", (unsigned long)keyCount++]));
+			
+			[groupRows insertObject:ck atIndex:index];
+			[changes addObject:[YapDatabaseViewRowChange insertCollectionKey:ck inGroup:group atIndex:index]];
+		}
+		else if (op == 3)
+		{
+			NSUInteger index = Random((uint32_t)[groupRows count]);
+			
+			[changes addObject:[YapDatabaseViewRowChange updateCollectionKey:groupRows[index]
+			                                                         inGroup:group
+			                                                         atIndex:index
+			                                                     withChanges:YapDatabaseViewChangedObject]];
+		}
+		else
+		{
+			NSUInteger index = Random((uint32_t)[groupRows count]);
+			YapCollectionKey *ck = groupRows[index];
+			
+			[groupRows removeObjectAtIndex:index];
+			[changes addObject:[YapDatabaseViewRowChange deleteCollectionKey:ck inGroup:group atIndex:index]];
+			
+			if (op == 2)
+			{
+				// Move
+				
+				NSString *group2 = groups[Random((uint32_t)[groups count])];
+				NSMutableArray *groupRows2 = rows[group2];
+				NSUInteger index2 = Random((uint32_t)[groupRows2 count] + 1);
+				
+				[groupRows2 insertObject:ck atIndex:index2];
+				[changes addObject:[YapDatabaseViewRowChange insertCollectionKey:ck inGroup:group2 atIndex:index2]];
+			}
+		}
+	}
+	
+	// Process
+	
+	[YapDatabaseViewChange processRowChanges:changes withOriginalMappings:nil finalMappings:nil];
+	[YapDatabaseViewChange consolidateRowChanges:changes];
+	
+	// Verify
+	
+	for (YapDatabaseViewRowChange *rowChange in changes)
+	{
+		if (rowChange.type != YapDatabaseViewChangeInsert)
+		{
+			NSArray *groupRows = originalRows[rowChange.originalGroup];
+			XCTAssertTrue([groupRows indexOfObject:rowChange.collectionKey] == rowChange.originalIndex,
+			              @"Bad originalIndex: %@", rowChange);
+		}
+		if (rowChange.type != YapDatabaseViewChangeDelete)
+		{
+			NSArray *groupRows = rows[rowChange.finalGroup];
+			XCTAssertTrue([groupRows indexOfObject:rowChange.collectionKey] == rowChange.finalIndex,
+			              @"Bad finalIndex: %@", rowChange);
+		}
+	}
+}
+
 @end
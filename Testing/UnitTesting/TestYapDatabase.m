@@ -4,11 +4,121 @@
 
 #import "TestObject.h"
 #import "YapDatabase.h"
+#import "YapCache.h"
+#import "YapWhitelistBlacklist.h"
+#import "YapShardedDatabase.h"
+#import "YapDatabaseBinaryCodec.h"
+#import "YapDatabaseQuery.h"
 
 #import "YapProxyObject.h"
 #import "YapProxyObjectPrivate.h"
+#import "YapDatabasePrivate.h"
+#import "yap_shared_changelog.h"
+#import "yap_shared_snapshot.h"
+#import "YapRowidSet.h"
+#import "YapMemoryTable.h"
 
 
+@interface TestBinaryCodingObject : NSObject <YapDatabaseBinaryCoding>
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, copy) NSArray *children;
+@property (nonatomic, assign) int64_t count;
+@property (nonatomic, assign) BOOL flag;
+@end
+
+@implementation TestBinaryCodingObject
+
+- (void)encodeWithBinaryEncoder:(YapDatabaseBinaryEncoder *)encoder
+{
+	[encoder encodeObject:_name forKey:@"name"];
+	[encoder encodeObject:_children forKey:@"children"];
+	[encoder encodeInt64:_count forKey:@"count"];
+	[encoder encodeBool:_flag forKey:@"flag"];
+}
+
+- (instancetype)initWithBinaryDecoder:(YapDatabaseBinaryDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		_name = [decoder decodeObjectOfClass:[NSString class] forKey:@"name"];
+		_children = [decoder decodeObjectOfClass:[NSArray class] forKey:@"children"];
+		_count = [decoder decodeInt64ForKey:@"count"];
+		_flag = [decoder decodeBoolForKey:@"flag"];
+	}
+	return self;
+}
+
+@end
+
+@interface TestImmutableObject : NSObject <NSCoding, YapDatabaseImmutable>
+@property (nonatomic, copy, readonly) NSString *name;
+- (instancetype)initWithName:(NSString *)name;
+@end
+
+@implementation TestImmutableObject
+
+- (instancetype)initWithName:(NSString *)name
+{
+	if ((self = [super init]))
+	{
+		_name = [name copy];
+	}
+	return self;
+}
+
+- (instancetype)initWithCoder:(NSCoder *)decoder
+{
+	return [self initWithName:[decoder decodeObjectForKey:@"name"]];
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder
+{
+	[coder encodeObject:_name forKey:@"name"];
+}
+
+@end
+
+#pragma mark -
+
+/**
+ * A key whose hash always collides, to exercise the collision nodes of YapMemoryTable.
+**/
+@interface TestCollidingKey : NSObject <NSCopying>
+@property (nonatomic, assign, readonly) NSUInteger value;
++ (instancetype)keyWithValue:(NSUInteger)value;
+@end
+
+@implementation TestCollidingKey
+
++ (instancetype)keyWithValue:(NSUInteger)value
+{
+	TestCollidingKey *key = [[TestCollidingKey alloc] init];
+	key->_value = value;
+	
+	return key;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // immutable
+}
+
+- (NSUInteger)hash
+{
+	return 42;
+}
+
+- (BOOL)isEqual:(id)object
+{
+	if (![object isKindOfClass:[TestCollidingKey class]]) return NO;
+	
+	return (_value == ((TestCollidingKey *)object).value);
+}
+
+@end
+
+#pragma mark -
+
 @interface TestYapDatabase : XCTestCase
 @end
 
@@ -1037,6 +1147,74 @@
 	XCTAssertTrue(progress.fractionCompleted >= 1.0, @"progress: %@", progress);
 }
 
+- (void)testBackup_clone
+{
+	NSUInteger count = 1000;
+	
+	NSString *databaseBackupName = [NSString stringWithFormat:@"%@.backup", NSStringFromSelector(_cmd)];
+	NSString *databaseBackupPath = [self databasePath:databaseBackupName];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databaseBackupPath error:NULL];
+	
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	YapDatabaseConnection *readConnection = [database newConnection];
+	
+	// Commits in the WAL must be included in the clone.
+	// (Whether or not the filesystem supports cloning, the result must be the same.)
+	
+	[readConnection beginLongLivedReadTransaction];
+	
+	for (int round = 1; round <= 2; round++)
+	{
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger i = 0; i < count; i++)
+			{
+				NSString *str = [self randomLetters:100];
+				
+				[transaction setObject:str forKey:str inCollection:nil];
+			}
+		}];
+		
+		// The second round replaces the backup from the first round.
+		
+		NSError *error = [connection cloneBackupToPath:databaseBackupPath];
+		
+		XCTAssertNil(error, @"Error: %@", error);
+		
+		@autoreleasepool {
+			
+			YapDatabase *backupDatabase = [[YapDatabase alloc] initWithPath:databaseBackupPath];
+			
+			XCTAssertNotNil(backupDatabase);
+			
+			[[backupDatabase newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+				
+				NSUInteger num = [transaction numberOfKeysInCollection:nil];
+				NSUInteger expected = count * round;
+				
+				XCTAssertTrue(num == expected, @"num(%lu) != expected(%lu)", (unsigned long)num, (unsigned long)expected);
+			}];
+		}
+	}
+	
+	// The original database is untouched
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:nil] == (count * 2));
+	}];
+	
+	[readConnection endLongLivedReadTransaction];
+}
+
 - (void)testVFS_standard
 {
 	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
@@ -1211,4 +1389,5610 @@
 	XCTAssert(count == 4);
 }
 
+- (void)testMultiGet
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"Mickey Mantle" forKey:@"1" inCollection:@"nyy" withMetadata:@(7)];
+		[transaction setObject:@"Derek Jeter"   forKey:@"2" inCollection:@"nyy" withMetadata:nil];
+		[transaction setObject:@"Babe Ruth"     forKey:@"3" inCollection:@"nyy" withMetadata:@(3)];
+		
+		[transaction setObject:@"Ted Williams" forKey:@"1" inCollection:@"brs"];
+	}];
+	
+	NSArray *keys = @[ @"1", @"2", @"3", @"4" ];
+	
+	// connection1 has everything in the cache, connection2 must go to disk.
+	// Both should produce identical results.
+	
+	for (YapDatabaseConnection *connection in @[ connection1, connection2 ])
+	{
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			NSDictionary *objects = nil;
+			NSDictionary *metadata = nil;
+			
+			[transaction getObjects:&objects metadata:&metadata forKeys:keys inCollection:@"nyy"];
+			
+			XCTAssert(objects.count == 3);
+			XCTAssertEqualObjects(objects[@"1"], @"Mickey Mantle");
+			XCTAssertEqualObjects(objects[@"2"], @"Derek Jeter");
+			XCTAssertEqualObjects(objects[@"3"], @"Babe Ruth");
+			XCTAssertNil(objects[@"4"]);
+			
+			XCTAssert(metadata.count == 2);
+			XCTAssertEqualObjects(metadata[@"1"], @(7));
+			XCTAssertNil(metadata[@"2"]);
+			XCTAssertEqualObjects(metadata[@"3"], @(3));
+			
+			NSDictionary *objectsOnly = nil;
+			[transaction getObjects:&objectsOnly metadata:NULL forKeys:keys inCollection:@"brs"];
+			
+			XCTAssert(objectsOnly.count == 1);
+			XCTAssertEqualObjects(objectsOnly[@"1"], @"Ted Williams");
+		}];
+	}
+}
+
+- (void)testBulkSet
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"old" forKey:@"2" inCollection:@"test"];
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObjects:@[ @"a", @"b", @"c", @"d" ]
+		                forKeys:@[ @"1", @"2", @"3", @"1" ]
+		           inCollection:@"test"
+		           withMetadata:@[ @(1), [NSNull null], @(3), @(4) ]];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssert([transaction numberOfKeysInCollection:@"test"] == 3);
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"1" inCollection:@"test"], @"d");
+		XCTAssertEqualObjects([transaction objectForKey:@"2" inCollection:@"test"], @"b");
+		XCTAssertEqualObjects([transaction objectForKey:@"3" inCollection:@"test"], @"c");
+		
+		XCTAssertEqualObjects([transaction metadataForKey:@"1" inCollection:@"test"], @(4));
+		XCTAssertNil([transaction metadataForKey:@"2" inCollection:@"test"]);
+		XCTAssertEqualObjects([transaction metadataForKey:@"3" inCollection:@"test"], @(3));
+	}];
+}
+
+- (void)testCollectionIds
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	// Create the database using the default schema
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database);
+		
+		[[database newConnection] readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@"a1" forKey:@"1" inCollection:@"a" withMetadata:@"m"];
+			[transaction setObject:@"a2" forKey:@"2" inCollection:@"a"];
+			[transaction setObject:@"b1" forKey:@"1" inCollection:@"b"];
+		}];
+	}
+	
+	// Re-open the database, which upgrades it to the collection-id schema
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableCollectionIds = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssert([transaction numberOfCollections] == 2);
+		XCTAssert([transaction numberOfKeysInCollection:@"a"] == 2);
+		XCTAssert([transaction numberOfKeysInAllCollections] == 3);
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"1" inCollection:@"a"], @"a1");
+		XCTAssertEqualObjects([transaction metadataForKey:@"1" inCollection:@"a"], @"m");
+		XCTAssertEqualObjects([transaction objectForKey:@"1" inCollection:@"b"], @"b1");
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"c1" forKey:@"1" inCollection:@"c"];
+		[transaction rollback];
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"c1" forKey:@"1" inCollection:@"c"];
+		[transaction setObject:@"a3" forKey:@"3" inCollection:@"a"];
+		[transaction removeAllObjectsInCollection:@"b"];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSArray *collections = [[transaction allCollections] sortedArrayUsingSelector:@selector(compare:)];
+		XCTAssertEqualObjects(collections, (@[ @"a", @"c" ]));
+		
+		XCTAssert([transaction numberOfKeysInCollection:@"a"] == 3);
+		XCTAssert([transaction numberOfKeysInCollection:@"b"] == 0);
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"1" inCollection:@"c"], @"c1");
+		XCTAssertEqualObjects([transaction objectForKey:@"3" inCollection:@"a"], @"a3");
+	}];
+}
+
+- (void)testMetadataBeforeData
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	// Create the database using the default layout
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database);
+		
+		[[database newConnection] readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@"object" forKey:@"key" inCollection:@"test" withMetadata:@"metadata"];
+		}];
+	}
+	
+	// Re-open the database, which rebuilds the table with metadata before data
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.storeMetadataBeforeData = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @"object");
+		XCTAssertEqualObjects([transaction metadataForKey:@"key" inCollection:@"test"], @"metadata");
+		
+		[transaction replaceMetadata:@"metadata2" forKey:@"key" inCollection:@"test"];
+	}];
+	
+	[connection flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Caches];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @"object");
+		XCTAssertEqualObjects([transaction metadataForKey:@"key" inCollection:@"test"], @"metadata2");
+	}];
+}
+
+- (void)testConcurrentDeserialization
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.enumerationWindowSize = 3;
+	
+	NSUInteger count = 100;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%03lu", (unsigned long)i];
+			[transaction setObject:@(i) forKey:key inCollection:@"test" withMetadata:key];
+		}
+	}];
+	
+	[connection flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Caches];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		// Ordered: must match the regular enumeration
+		
+		NSMutableArray *expected = [NSMutableArray arrayWithCapacity:count];
+		[transaction enumerateKeysInCollection:@"test" usingBlock:^(NSString *key, BOOL *stop) {
+			[expected addObject:key];
+		}];
+		
+		NSMutableArray *ordered = [NSMutableArray arrayWithCapacity:count];
+		[transaction enumerateRowsInCollection:@"test"
+		                           withOptions:YapDatabaseEnumerationConcurrentDeserialization
+		                            usingBlock:^(NSString *key, id object, id metadata, BOOL *stop)
+		{
+			XCTAssertEqualObjects(object, @([key integerValue]));
+			XCTAssertEqualObjects(metadata, key);
+			[ordered addObject:key];
+			
+		} withFilter:NULL];
+		
+		XCTAssertEqualObjects(ordered, expected);
+		
+		// Unordered: every row exactly once
+		
+		NSMutableSet *unordered = [NSMutableSet setWithCapacity:count];
+		[transaction enumerateKeysAndObjectsInCollection:@"test"
+		                                     withOptions:(YapDatabaseEnumerationConcurrentDeserialization |
+		                                                  YapDatabaseEnumerationUnordered)
+		                                      usingBlock:^(NSString *key, id object, BOOL *stop)
+		{
+			XCTAssertEqualObjects(object, @([key integerValue]));
+			[unordered addObject:key];
+			
+		} withFilter:^BOOL(NSString *key) {
+			
+			return ([key integerValue] % 2) == 0;
+		}];
+		
+		XCTAssert(unordered.count == count / 2);
+		
+		// Stop
+		
+		__block NSUInteger invocations = 0;
+		[transaction enumerateKeysAndObjectsInCollection:@"test"
+		                                     withOptions:YapDatabaseEnumerationConcurrentDeserialization
+		                                      usingBlock:^(NSString *key, id object, BOOL *stop)
+		{
+			if (++invocations == 10) *stop = YES;
+			
+		} withFilter:NULL];
+		
+		XCTAssert(invocations == 10);
+	}];
+}
+
+- (void)testBytesDeserializer
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	__block NSUInteger bytesInvocations = 0;
+	
+	YapDatabaseDeserializer deserializer = [YapDatabase deserializerWithBytesDeserializer:
+	    ^id (NSString *collection, NSString *key, const void *bytes, size_t length) {
+		
+		bytesInvocations++;
+		return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+	}];
+	
+	YapDatabaseSerializer serializer = ^NSData *(NSString *collection, NSString *key, id object) {
+		
+		return [(NSString *)object dataUsingEncoding:NSUTF8StringEncoding];
+	};
+	
+	// The wrapped deserializer is still a regular deserializer
+	
+	NSData *data = serializer(@"", @"", @"abc");
+	XCTAssertEqualObjects(deserializer(@"", @"", data), @"abc");
+	XCTAssert(bytesInvocations == 1);
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:serializer
+	                                             deserializer:deserializer];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.objectCacheEnabled = NO;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"value" forKey:@"key" inCollection:@"test"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @"value");
+	}];
+	
+	XCTAssert(bytesInvocations == 2);
+}
+
+
+- (void)testCompression
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseSerializer serializer = ^NSData *(NSString *collection, NSString *key, id object) {
+		
+		return [(NSString *)object dataUsingEncoding:NSUTF8StringEncoding];
+	};
+	YapDatabaseDeserializer deserializer = ^id (NSString *collection, NSString *key, NSData *data) {
+		
+		return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+	};
+	
+	NSString* (^objectForIndex)(NSUInteger) = ^NSString *(NSUInteger i){
+		
+		return [NSString stringWithFormat:
+		  @"{\"type\":\"message\",\"id\":%lu,\"sender\":\"user-%lu\",\"body\":\"This is message number %lu\","
+		  @"\"flags\":{\"read\":true,\"starred\":false,\"archived\":false}}", (unsigned long)i, (unsigned long)(i % 7),
+		  (unsigned long)i];
+	};
+	
+	@autoreleasepool {
+		
+		YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+		options.compressionConfigs = @{ @"test": [YapDatabaseCompressionConfig zlibWithLevel:6] };
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+		                                               serializer:serializer
+		                                             deserializer:deserializer
+		                                                  options:options];
+		XCTAssertNotNil(database);
+		
+		YapDatabaseConnection *connection = [database newConnection];
+		connection.objectCacheEnabled = NO;
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger i = 0; i < 200; i++)
+			{
+				NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+				
+				[transaction setObject:objectForIndex(i) forKey:key inCollection:@"test"];
+				[transaction setObject:objectForIndex(i) forKey:key inCollection:@"plain"];
+			}
+		}];
+		
+		// Train & rotate a dictionary
+		
+		dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+		__block BOOL rotated = NO;
+		
+		[connection asyncTrainCompressionDictionaryForCollection:@"test"
+		                                         completionQueue:dispatch_get_global_queue(0, 0)
+		                                         completionBlock:^(BOOL result)
+		{
+			rotated = result;
+			dispatch_semaphore_signal(semaphore);
+		}];
+		
+		dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+		XCTAssertTrue(rotated);
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger i = 200; i < 300; i++)
+			{
+				NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+				[transaction setObject:objectForIndex(i) forKey:key inCollection:@"test"];
+			}
+		}];
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			for (NSUInteger i = 0; i < 300; i++)
+			{
+				NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+				XCTAssertEqualObjects([transaction objectForKey:key inCollection:@"test"], objectForIndex(i));
+			}
+			
+			// The primitive accessors return the serialized (uncompressed) form
+			
+			NSData *serializedObject = [transaction serializedObjectForKey:@"0" inCollection:@"test"];
+			XCTAssertEqualObjects(serializedObject, serializer(@"test", @"0", objectForIndex(0)));
+		}];
+	}
+	
+	// Rows remain readable after compression is disabled
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:serializer
+	                                             deserializer:deserializer];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < 300; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			XCTAssertEqualObjects([transaction objectForKey:key inCollection:@"test"], objectForIndex(i));
+		}
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"10" inCollection:@"plain"], objectForIndex(10));
+	}];
+}
+
+- (void)testCompression_legacyRowsWithMagic
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseSerializer serializer = ^NSData *(NSString *collection, NSString *key, id object) {
+		
+		return (NSData *)object;
+	};
+	YapDatabaseDeserializer deserializer = ^id (NSString *collection, NSString *key, NSData *data) {
+		
+		return data;
+	};
+	
+	// Rows written before compression was enabled, which happen to start with the magic bytes,
+	// but don't have a valid header.
+	
+	uint8_t zlibWithoutLength[] = { 0xFA, 0xDB, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 'a', 'b', 'c' };
+	uint8_t noneWithWrongLength[] = { 0xFA, 0xDB, 0x00, 0, 0, 0, 0, 99, 0, 0, 0, 'a', 'b', 'c' };
+	uint8_t unknownAlgorithm[] = { 0xFA, 0xDB, 0x07, 0, 0, 0, 0, 3, 0, 0, 0, 'a', 'b', 'c' };
+	
+	NSDictionary<NSString *, NSData *> *rows = @{
+		@"zlib"    : [NSData dataWithBytes:zlibWithoutLength length:sizeof(zlibWithoutLength)],
+		@"none"    : [NSData dataWithBytes:noneWithWrongLength length:sizeof(noneWithWrongLength)],
+		@"unknown" : [NSData dataWithBytes:unknownAlgorithm length:sizeof(unknownAlgorithm)],
+	};
+	
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+		                                               serializer:serializer
+		                                             deserializer:deserializer];
+		XCTAssertNotNil(database);
+		
+		[[database newConnection] readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[rows enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+				
+				[transaction setObject:data forKey:key inCollection:@"legacy"];
+			}];
+		}];
+	}
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.compressionConfigs = @{ @"test": [YapDatabaseCompressionConfig zlibWithLevel:6] };
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:serializer
+	                                             deserializer:deserializer
+	                                                  options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.objectCacheEnabled = NO;
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[rows enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+			
+			XCTAssertEqualObjects([transaction objectForKey:key inCollection:@"legacy"], data, @"key: %@", key);
+			XCTAssertEqualObjects([transaction serializedObjectForKey:key inCollection:@"legacy"], data, @"key: %@", key);
+		}];
+	}];
+	
+	// And they're still read as-is after being rewritten with compression enabled
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[rows enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+			
+			[transaction setObject:data forKey:key inCollection:@"test"];
+		}];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[rows enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+			
+			XCTAssertEqualObjects([transaction objectForKey:key inCollection:@"test"], data, @"key: %@", key);
+		}];
+	}];
+}
+
+- (void)testGroupCommit
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableGroupCommit = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	NSUInteger connectionCount = 4;
+	NSUInteger transactionCount = 25;
+	
+	NSMutableArray<YapDatabaseConnection *> *connections = [NSMutableArray arrayWithCapacity:connectionCount];
+	for (NSUInteger i = 0; i < connectionCount; i++)
+	{
+		[connections addObject:[database newConnection]];
+	}
+	
+	dispatch_queue_t completionQueue = dispatch_queue_create("testGroupCommit", DISPATCH_QUEUE_SERIAL);
+	dispatch_group_t group = dispatch_group_create();
+	
+	__block NSUInteger completionCount = 0;
+	
+	for (NSUInteger t = 0; t < transactionCount; t++)
+	{
+		for (NSUInteger c = 0; c < connectionCount; c++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu-%lu", (unsigned long)c, (unsigned long)t];
+			BOOL rollback = (t % 10) == 5;
+			
+			dispatch_group_enter(group);
+			[connections[c] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+				
+				[transaction setObject:key forKey:key inCollection:@"test"];
+				
+				if (rollback) {
+					[transaction rollback];
+				}
+				
+			} completionQueue:completionQueue completionBlock:^{
+				
+				// When the completionBlock fires, the transaction has been committed (and synced).
+				[connections[c] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+					
+					if (rollback)
+						XCTAssertNil([transaction objectForKey:key inCollection:@"test"]);
+					else
+						XCTAssertEqualObjects([transaction objectForKey:key inCollection:@"test"], key);
+				}];
+				
+				completionCount++;
+				dispatch_group_leave(group);
+			}];
+		}
+	}
+	
+	long result = dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(30 * NSEC_PER_SEC)));
+	XCTAssertTrue(result == 0, @"Timed out waiting for completionBlocks");
+	XCTAssertTrue(completionCount == (connectionCount * transactionCount));
+	
+	[connections[0] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"test"] == (connectionCount * (transactionCount - 2)));
+	}];
+	
+	// Synchronous transactions are never grouped, but must still work alongside the group.
+	
+	[connections[1] readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"sync" forKey:@"sync" inCollection:@"test"];
+	}];
+	
+	[connections[2] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"sync" inCollection:@"test"], @"sync");
+	}];
+}
+
+- (void)testRelaxedDurability
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.relaxedDurabilityTransactionLimit = 10;
+	options.relaxedDurabilityInterval = 0.1;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	// Relaxed commits are immediately visible to other connections.
+	
+	for (NSUInteger i = 0; i < 25; i++)
+	{
+		[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)i] inCollection:@"telemetry"];
+			
+		} durability:YapDatabaseDurabilityRelaxed];
+	}
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"telemetry"] == 25);
+	}];
+	
+	// Relaxed rollbacks behave like any other rollback.
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"rollback" forKey:@"rollback" inCollection:@"telemetry"];
+		[transaction rollback];
+		
+	} durability:YapDatabaseDurabilityRelaxed];
+	
+	// Async relaxed transactions, followed by a durability barrier (from another connection).
+	
+	dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+	dispatch_queue_t completionQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	[connection1 asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"async" forKey:@"async" inCollection:@"telemetry"];
+		
+	} durability:YapDatabaseDurabilityRelaxed completionQueue:completionQueue completionBlock:^{
+		
+		[connection2 flushDurabilityWithCompletionQueue:completionQueue completionBlock:^{
+			
+			dispatch_semaphore_signal(semaphore);
+		}];
+	}];
+	
+	long result = dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10 * NSEC_PER_SEC)));
+	XCTAssertTrue(result == 0, @"Timed out waiting for durability barrier");
+	
+	// Mixing in full transactions
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"full" forKey:@"full" inCollection:@"important"];
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"relaxed" forKey:@"relaxed" inCollection:@"telemetry"];
+		
+	} durability:YapDatabaseDurabilityRelaxed];
+	
+	// Give the interval-based sync a chance to run
+	[NSThread sleepForTimeInterval:0.3];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"telemetry"] == 27);
+		XCTAssertNil([transaction objectForKey:@"rollback" inCollection:@"telemetry"]);
+		XCTAssertEqualObjects([transaction objectForKey:@"full" inCollection:@"important"], @"full");
+	}];
+}
+
+- (void)testCheckpointPolicy
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseAdaptiveCheckpointPolicy *policy = [[YapDatabaseAdaptiveCheckpointPolicy alloc] init];
+	policy.minimumFrameCount = 1;
+	policy.burstWriteRate = 1000000;
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.checkpointPolicy = policy;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	for (NSUInteger i = 0; i < 10; i++)
+	{
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)i] inCollection:nil];
+		}];
+	}
+	
+	// Give the checkpointQueue a chance to run
+	[NSThread sleepForTimeInterval:0.5];
+	
+	YapDatabaseCheckpointStatistics *stats = database.checkpointStatistics;
+	XCTAssertNotNil(stats);
+	XCTAssertTrue(stats.evaluationCount > 0);
+	XCTAssertTrue(stats.passiveCount > 0);
+	XCTAssertTrue(stats.checkpointedFrameCount > 0);
+	
+	// During a burst of writes, the policy should defer the checkpoint.
+	
+	policy.minimumFrameCount = 1000000;
+	policy.maximumInterval = 1000000;
+	policy.burstWriteRate = 1;
+	
+	NSUInteger skippedCount = stats.skippedCount;
+	
+	for (NSUInteger i = 0; i < 10; i++)
+	{
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"burst-%lu", (unsigned long)i] inCollection:nil];
+		}];
+	}
+	
+	[NSThread sleepForTimeInterval:0.2];
+	
+	stats = database.checkpointStatistics;
+	XCTAssertTrue(stats.skippedCount > skippedCount);
+	XCTAssertTrue(stats.lastMode == YapDatabaseCheckpointModeNone);
+	
+	// No policy configured
+	
+	YapDatabase *database2 = [[YapDatabase alloc] initWithPath:[self databasePath:@"testCheckpointPolicy2"]];
+	XCTAssertNil(database2.checkpointStatistics);
+}
+
+- (void)testCacheCostLimit
+{
+	// YapCache
+	
+	YapCache<NSString *, NSData *> *cache = [[YapCache alloc] initWithCountLimit:0];
+	cache.costLimit = 100;
+	cache.costBlock = ^NSUInteger (NSString *key, NSData *data) {
+		return data.length;
+	};
+	
+	[cache setObject:[NSMutableData dataWithLength:40] forKey:@"a"];
+	[cache setObject:[NSMutableData dataWithLength:40] forKey:@"b"];
+	
+	XCTAssertTrue(cache.totalCost == 80, @"Bad totalCost: %lu", (unsigned long)cache.totalCost);
+	XCTAssertTrue([cache count] == 2);
+	
+	[cache objectForKey:@"a"]; // "b" is now the least recently used
+	[cache setObject:[NSMutableData dataWithLength:40] forKey:@"c"];
+	
+	XCTAssertTrue(cache.totalCost == 80, @"Bad totalCost: %lu", (unsigned long)cache.totalCost);
+	XCTAssertTrue([cache containsKey:@"a"]);
+	XCTAssertFalse([cache containsKey:@"b"]);
+	XCTAssertTrue([cache containsKey:@"c"]);
+	
+	// An item that exceeds the costLimit all by itself is not retained.
+	
+	[cache setObject:[NSMutableData dataWithLength:200] forKey:@"d"];
+	
+	XCTAssertFalse([cache containsKey:@"d"]);
+	XCTAssertTrue(cache.totalCost <= 100, @"Bad totalCost: %lu", (unsigned long)cache.totalCost);
+	
+	// Explicit cost
+	
+	[cache removeAllObjects];
+	XCTAssertTrue(cache.totalCost == 0);
+	
+	[cache setObject:[NSData data] forKey:@"e" cost:60];
+	[cache setObject:[NSData data] forKey:@"f" cost:30];
+	XCTAssertTrue(cache.totalCost == 90);
+	
+	[cache removeObjectForKey:@"e"];
+	XCTAssertTrue(cache.totalCost == 30);
+	
+	// Both limits are enforced
+	
+	cache.countLimit = 2;
+	[cache setObject:[NSData data] forKey:@"g" cost:1];
+	[cache setObject:[NSData data] forKey:@"h" cost:1];
+	
+	XCTAssertTrue([cache count] == 2);
+	XCTAssertFalse([cache containsKey:@"f"]);
+	XCTAssertTrue(cache.totalCost == 2);
+	
+	// YapDatabaseConnection
+	
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	database.connectionDefaults.objectCacheCostLimit = 1000;
+	database.connectionDefaults.objectCacheCostBlock = ^NSUInteger (NSString *collection, NSString *key, id object) {
+		
+		return [collection isEqualToString:@"large"] ? 600 : 1;
+	};
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	XCTAssertTrue(connection.objectCacheCostLimit == 1000);
+	XCTAssertNotNil(connection.objectCacheCostBlock);
+	XCTAssertTrue(connection.metadataCacheCostLimit == 0);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"small" forKey:@"key" inCollection:@"small"];
+		[transaction setObject:@"large1" forKey:@"key1" inCollection:@"large"];
+		[transaction setObject:@"large2" forKey:@"key2" inCollection:@"large"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		// Everything is still readable, even if it no longer fits in the cache.
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"small"], @"small");
+		XCTAssertEqualObjects([transaction objectForKey:@"key1" inCollection:@"large"], @"large1");
+		XCTAssertEqualObjects([transaction objectForKey:@"key2" inCollection:@"large"], @"large2");
+	}];
+	
+	connection.objectCacheCostLimit = 0;
+	XCTAssertTrue(connection.objectCacheCostLimit == 0);
+}
+
+- (void)testCacheAdmissionPolicy
+{
+	NSArray<NSString *> *hotKeys = @[ @"a", @"b", @"c", @"d" ];
+	
+	YapCache<NSString *, NSString *> *(^runWorkload)(YapCacheAdmissionPolicy) = ^(YapCacheAdmissionPolicy policy){
+		
+		YapCache<NSString *, NSString *> *cache = [[YapCache alloc] initWithCountLimit:4];
+		cache.admissionPolicy = policy;
+		
+		// Build up the hot working set
+		
+		for (NSUInteger i = 0; i < 5; i++)
+		{
+			for (NSString *key in hotKeys)
+			{
+				if ([cache objectForKey:key] == nil) {
+					[cache setObject:key forKey:key];
+				}
+			}
+		}
+		
+		// Scan (each key is only seen once)
+		
+		for (NSUInteger i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"scan-%lu", (unsigned long)i];
+			
+			if ([cache objectForKey:key] == nil) {
+				[cache setObject:key forKey:key];
+			}
+		}
+		
+		return cache;
+	};
+	
+	YapCache *lruCache = runWorkload(YapCacheAdmissionPolicyLRU);
+	YapCache *tinyLFUCache = runWorkload(YapCacheAdmissionPolicyTinyLFU);
+	
+	XCTAssertTrue([lruCache count] == 4);
+	XCTAssertTrue([tinyLFUCache count] == 4);
+	
+	for (NSString *key in hotKeys)
+	{
+		XCTAssertFalse([lruCache containsKey:key], @"Scan should have flushed the LRU cache");
+		XCTAssertTrue([tinyLFUCache containsKey:key], @"Scan flushed the hot working set: %@", key);
+	}
+	
+	// A new key that becomes popular should eventually be admitted
+	
+	for (NSUInteger i = 0; i < 10; i++)
+	{
+		if ([tinyLFUCache objectForKey:@"e"] == nil) {
+			[tinyLFUCache setObject:@"e" forKey:@"e"];
+		}
+	}
+	XCTAssertTrue([tinyLFUCache containsKey:@"e"]);
+	
+	// Switching back to LRU admits everything
+	
+	tinyLFUCache.admissionPolicy = YapCacheAdmissionPolicyLRU;
+	[tinyLFUCache setObject:@"f" forKey:@"f"];
+	XCTAssertTrue([tinyLFUCache containsKey:@"f"]);
+	
+	// YapDatabaseConnection
+	
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	XCTAssertTrue(database.connectionDefaults.objectCacheAdmissionPolicy == YapCacheAdmissionPolicyLRU);
+	database.connectionDefaults.objectCacheAdmissionPolicy = YapCacheAdmissionPolicyTinyLFU;
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	XCTAssertTrue(connection.objectCacheAdmissionPolicy == YapCacheAdmissionPolicyTinyLFU);
+	XCTAssertTrue(connection.metadataCacheAdmissionPolicy == YapCacheAdmissionPolicyLRU);
+	
+	connection.objectCacheLimit = 10;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			[transaction setObject:key forKey:key inCollection:nil];
+		}
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			XCTAssertEqualObjects([transaction objectForKey:key inCollection:nil], key);
+		}
+	}];
+}
+
+- (void)testTransactionCachePolicy
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < 10; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			[transaction setObject:[TestObject generateTestObject] forKey:key inCollection:@"test"];
+		}
+	}];
+	
+	// Bypass: objects aren't added to the cache, so each read deserializes a new instance.
+	
+	__block id object1 = nil;
+	__block id object2 = nil;
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue(transaction.cachePolicy == YapDatabaseTransactionCachePolicyDefault);
+		transaction.cachePolicy = YapDatabaseTransactionCachePolicyBypass;
+		
+		__block NSUInteger count = 0;
+		[transaction enumerateKeysAndObjectsInCollection:@"test"
+		                                      usingBlock:^(NSString *key, id object, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 10);
+		
+		object1 = [transaction objectForKey:@"0" inCollection:@"test"];
+		object2 = [transaction objectForKey:@"0" inCollection:@"test"];
+	}];
+	
+	XCTAssertNotNil(object1);
+	XCTAssertTrue(object1 != object2, @"Object was cached despite YapDatabaseTransactionCachePolicyBypass");
+	
+	// Each transaction starts with the default policy.
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue(transaction.cachePolicy == YapDatabaseTransactionCachePolicyDefault);
+		
+		object1 = [transaction objectForKey:@"0" inCollection:@"test"];
+		object2 = [transaction objectForKey:@"0" inCollection:@"test"];
+	}];
+	
+	XCTAssertTrue(object1 == object2, @"Object wasn't cached with YapDatabaseTransactionCachePolicyDefault");
+	
+	// Cached items are still used while bypassing.
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		transaction.cachePolicy = YapDatabaseTransactionCachePolicyBypass;
+		
+		XCTAssertTrue([transaction objectForKey:@"0" inCollection:@"test"] == object1);
+	}];
+}
+
+- (void)testSharedObjectCache
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableSharedObjectCache = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	database.connectionDefaults.objectPolicy = YapDatabasePolicyShare;
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	YapDatabaseConnection *connection3 = [database newConnection];
+	
+	TestObject *objectA = [TestObject generateTestObject];
+	TestObject *objectB = [TestObject generateTestObject];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:objectA forKey:@"key" inCollection:@"test"];
+	}];
+	
+	// connection2 reads the object from disk, and connection3 gets the same instance from the shared cache.
+	
+	__block id object2 = nil;
+	__block id object3 = nil;
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		object2 = [transaction objectForKey:@"key" inCollection:@"test"];
+	}];
+	[connection3 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		object3 = [transaction objectForKey:@"key" inCollection:@"test"];
+	}];
+	
+	XCTAssertNotNil(object2);
+	XCTAssertTrue(object2 == object3, @"Expected the shared instance");
+	
+	// A commit (from a Share connection) publishes the new object.
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:objectB forKey:@"key" inCollection:@"test"];
+	}];
+	
+	YapDatabaseConnection *connection4 = [database newConnection];
+	
+	__block id object4 = nil;
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		object2 = [transaction objectForKey:@"key" inCollection:@"test"];
+	}];
+	[connection4 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		object4 = [transaction objectForKey:@"key" inCollection:@"test"];
+	}];
+	
+	XCTAssertTrue(object2 == objectB, @"Stale object");
+	XCTAssertTrue(object4 == objectB, @"Expected the published instance");
+}
+
+- (void)testPrefetch
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	__block NSUInteger deserializeCount = 0;
+	
+	YapDatabaseDeserializer defaultDeserializer = [YapDatabase defaultDeserializer];
+	YapDatabaseDeserializer deserializer = ^id (NSString *collection, NSString *key, NSData *data) {
+		
+		@synchronized (self) { deserializeCount++; }
+		return defaultDeserializer(collection, key, data);
+	};
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:[YapDatabase defaultSerializer]
+	                                             deserializer:deserializer];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	YapDatabaseConnection *connection3 = [database newConnection];
+	
+	NSMutableArray *keys = [NSMutableArray array];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < 120; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			[transaction setObject:[TestObject generateTestObject] forKey:key inCollection:@"test"];
+			
+			[keys addObject:key];
+		}
+	}];
+	
+	dispatch_queue_t completionQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+	
+	// Prefetch by key
+	
+	[connection2 prefetchObjectsForKeys:keys inCollection:@"test" completionQueue:completionQueue completionBlock:^{
+		
+		dispatch_semaphore_signal(semaphore);
+	}];
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+	
+	NSUInteger countBefore;
+	@synchronized (self) { countBefore = deserializeCount; }
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSString *key in keys) {
+			XCTAssertNotNil([transaction objectForKey:key inCollection:@"test"]);
+		}
+	}];
+	
+	@synchronized (self) {
+		XCTAssertTrue(deserializeCount == countBefore, @"Expected prefetched objects to be in the cache");
+	}
+	
+	// Prefetch collection (with limit)
+	
+	[connection3 prefetchCollection:@"test" limit:20 completionQueue:completionQueue completionBlock:^{
+		
+		dispatch_semaphore_signal(semaphore);
+	}];
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+	
+	@synchronized (self) { countBefore = deserializeCount; }
+	
+	[connection3 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSString *key in keys) {
+			XCTAssertNotNil([transaction objectForKey:key inCollection:@"test"]);
+		}
+	}];
+	
+	@synchronized (self) {
+		XCTAssertTrue(deserializeCount == (countBefore + 100), @"Expected 20 prefetched objects");
+	}
+}
+
+- (void)testCacheConsistency
+{
+	// Random operations, checked against a simple (array-based) LRU.
+	
+	YapCache *cache = [[YapCache alloc] initWithCountLimit:50 keyCallbacks:[YapCollectionKey keyCallbacks]];
+	cache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
+	
+	NSMutableArray *lru = [NSMutableArray array]; // most recent first
+	
+	for (NSUInteger i = 0; i < 20000; i++)
+	{
+		NSString *key = [NSString stringWithFormat:@"%u", arc4random_uniform(150)];
+		YapCollectionKey *ck = YapCollectionKeyCreate(@"test", key);
+		
+		uint32_t op = arc4random_uniform(10);
+		if (op < 5)
+		{
+			BOOL found = ([cache objectForKey:ck] != nil);
+			XCTAssertTrue(found == [lru containsObject:ck]);
+			
+			if (found) {
+				[lru removeObject:ck];
+				[lru insertObject:ck atIndex:0];
+			}
+		}
+		else if (op < 9)
+		{
+			[cache setObject:key forKey:ck];
+			
+			[lru removeObject:ck];
+			[lru insertObject:ck atIndex:0];
+			if (lru.count > 50) {
+				[lru removeLastObject];
+			}
+		}
+		else
+		{
+			[cache removeObjectForKey:ck];
+			[lru removeObject:ck];
+		}
+		
+		XCTAssertTrue(cache.count == lru.count);
+	}
+	
+	__block NSUInteger index = 0;
+	[cache enumerateKeysAndObjectsWithBlock:^(YapCollectionKey *ck, NSString *obj, BOOL *stop) {
+		
+		XCTAssertEqualObjects(ck, lru[index]);
+		XCTAssertEqualObjects(obj, ck.key);
+		index++;
+	}];
+	XCTAssertTrue(index == lru.count);
+	
+	cache.countLimit = 10;
+	XCTAssertTrue(cache.count == MIN(lru.count, (NSUInteger)10));
+	
+	[cache removeAllObjects];
+	XCTAssertTrue(cache.count == 0);
+}
+
+- (void)testReadTransactionRecycling
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	__block __unsafe_unretained YapDatabaseReadTransaction *firstTransaction = nil;
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		firstTransaction = transaction;
+		
+		transaction.userInfo = @"userInfo";
+		transaction.cachePolicy = YapDatabaseTransactionCachePolicyBypass;
+	}];
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		// The transaction object is recycled, but its state is reset.
+		
+		XCTAssertTrue(transaction == firstTransaction);
+		XCTAssertNil(transaction.userInfo);
+		XCTAssertTrue(transaction.cachePolicy == YapDatabaseTransactionCachePolicyDefault);
+		
+		XCTAssertNil([transaction objectForKey:@"key" inCollection:@"test"]);
+	}];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"key" inCollection:@"test"];
+	}];
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @"object");
+	}];
+	
+	[connection1 flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_All];
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @"object");
+	}];
+}
+
+- (void)testMemoryReport
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"key-%d", i];
+			NSString *object = [@"" stringByPaddingToLength:1024 withString:key startingAtIndex:0];
+			
+			[transaction setObject:object forKey:key inCollection:@"test"];
+		}
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"key-%d", i];
+			XCTAssertNotNil([transaction objectForKey:key inCollection:@"test"]);
+		}
+	}];
+	
+	YapDatabaseMemoryReport *report = [connection2 memoryReport];
+	
+	uint64_t objectCacheBytes = [report bytesForComponent:YapDatabaseMemoryComponentObjectCache];
+	
+	XCTAssertTrue(objectCacheBytes >= (100 * 1024));
+	XCTAssertTrue(report.totalBytes >= objectCacheBytes);
+	XCTAssertTrue([[report sortedComponents] count] == [report.components count]);
+	
+	YapDatabaseMemoryReport *databaseReport = [database memoryReport];
+	
+	XCTAssertTrue([databaseReport bytesForComponent:YapDatabaseMemoryComponentObjectCache] >= objectCacheBytes);
+	XCTAssertTrue(databaseReport.totalBytes >= report.totalBytes);
+	
+	// The caches are the only allowed holders, so they're all flushed (trying to reach the target).
+	
+	[connection2 flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Caches targetBytes:1];
+	
+	YapDatabaseMemoryReport *flushedReport = [connection2 memoryReport];
+	
+	XCTAssertTrue([flushedReport bytesForComponent:YapDatabaseMemoryComponentObjectCache] < (100 * 1024));
+	XCTAssertTrue(flushedReport.totalBytes < report.totalBytes);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNotNil([transaction objectForKey:@"key-0" inCollection:@"test"]);
+	}];
+}
+
+- (void)testStatistics
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 10; i++)
+		{
+			[transaction setObject:@"object" forKey:[NSString stringWithFormat:@"key-%d", i] inCollection:@"test"];
+		}
+	}];
+	
+	// First pass misses the objectCache, second pass hits it.
+	
+	for (int pass = 0; pass < 2; pass++)
+	{
+		[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			for (int i = 0; i < 10; i++)
+			{
+				XCTAssertNotNil([transaction objectForKey:[NSString stringWithFormat:@"key-%d", i] inCollection:@"test"]);
+			}
+		}];
+	}
+	
+	YapDatabaseConnectionStatistics *statistics = [connection2 statistics];
+	
+	XCTAssertTrue(statistics.objectCache.misses >= 10);
+	XCTAssertTrue(statistics.objectCache.hits >= 10);
+	XCTAssertTrue(statistics.objectCache.count == 10);
+	XCTAssertTrue(statistics.objectCache.hitRate > 0.0 && statistics.objectCache.hitRate < 1.0);
+	XCTAssertTrue(statistics.preparedStatementCount > 0);
+	XCTAssertTrue(statistics.snapshotLag == 0);
+	XCTAssertFalse(statistics.hasLongLivedReadTransaction);
+	
+	NSDictionary *dict = [statistics dictionaryRepresentation];
+	XCTAssertEqualObjects(dict[@"objectCache.hits"], @(statistics.objectCache.hits));
+	
+	// A long-lived read transaction falls behind as the other connection commits.
+	
+	[connection2 beginLongLivedReadTransaction];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"another" inCollection:@"test"];
+	}];
+	
+	YapDatabaseStatistics *databaseStatistics = [database statistics];
+	
+	XCTAssertTrue(databaseStatistics.connections.count == 2);
+	XCTAssertTrue(databaseStatistics.maxSnapshotLag >= 1);
+	XCTAssertTrue(databaseStatistics.objectCache.hits >= statistics.objectCache.hits);
+	XCTAssertTrue(databaseStatistics.walSize > 0);
+	
+	XCTAssertTrue([connection2 statistics].hasLongLivedReadTransaction);
+	
+	[connection2 endLongLivedReadTransaction];
+}
+
+- (void)testQueueWaitStatistics
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	connection1.name = @"connection1";
+	connection2.name = @"connection2";
+	
+	__block YapDatabaseQueueWaitEvent *writeQueueEvent = nil;
+	
+	dispatch_queue_t eventQueue = dispatch_queue_create("testQueueWaitStatistics", DISPATCH_QUEUE_SERIAL);
+	XCTestExpectation *expectation = [self expectationWithDescription:@"writeQueue wait"];
+	
+	[connection2 setQueueWaitThreshold:0.05 block:^(YapDatabaseConnection __unused *connection, YapDatabaseQueueWaitEvent *event) {
+		
+		if (event.wait == YapDatabaseQueueWaitWriteQueue && writeQueueEvent == nil)
+		{
+			writeQueueEvent = event;
+			[expectation fulfill];
+		}
+		
+	} queue:eventQueue];
+	
+	// connection1 holds the writeQueue, while connection2 waits for it.
+	
+	dispatch_semaphore_t didEnterWriteQueue = dispatch_semaphore_create(0);
+	
+	[connection1 asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		dispatch_semaphore_signal(didEnterWriteQueue);
+		[NSThread sleepForTimeInterval:0.2];
+		
+		[transaction setObject:@"object1" forKey:@"key1" inCollection:@"test"];
+	}];
+	
+	dispatch_semaphore_wait(didEnterWriteQueue, DISPATCH_TIME_FOREVER);
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object2" forKey:@"key2" inCollection:@"test"];
+	}];
+	
+	[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+	
+	XCTAssertEqualObjects(writeQueueEvent.connectionName, @"connection2");
+	XCTAssertEqualObjects(writeQueueEvent.blockingConnectionName, @"connection1");
+	XCTAssertTrue(writeQueueEvent.blockingReadWrite);
+	XCTAssertTrue(writeQueueEvent.blockingTransactionID > 0);
+	XCTAssertTrue(writeQueueEvent.blockingTransactionID < writeQueueEvent.transactionID);
+	XCTAssertTrue(writeQueueEvent.duration >= 0.05);
+	
+	YapDatabaseQueueWaitStatistics *statistics = [connection2 queueWaitStatistics];
+	
+	XCTAssertTrue([statistics countForWait:YapDatabaseQueueWaitConnectionQueue] == 1);
+	XCTAssertTrue([statistics countForWait:YapDatabaseQueueWaitWriteQueue] == 1);
+	XCTAssertTrue([statistics countForWait:YapDatabaseQueueWaitSnapshotQueue] >= 2);
+	XCTAssertTrue([statistics countForWait:YapDatabaseQueueWaitSnapshotQueueHold] ==
+	              [statistics countForWait:YapDatabaseQueueWaitSnapshotQueue]);
+	XCTAssertTrue([statistics maxDurationForWait:YapDatabaseQueueWaitWriteQueue] >= 0.05);
+	
+	NSArray<NSNumber *> *histogram = [statistics histogramForWait:YapDatabaseQueueWaitWriteQueue];
+	XCTAssertTrue(histogram.count == YapDatabaseQueueWaitBucketCount);
+	XCTAssertTrue([[histogram valueForKeyPath:@"@sum.self"] unsignedLongLongValue] == 1);
+	
+	[connection2 resetQueueWaitStatistics];
+	
+	XCTAssertTrue([[connection2 queueWaitStatistics] countForWait:YapDatabaseQueueWaitWriteQueue] == 0);
+}
+
+- (void)testPageCacheBudget
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.pageCacheBudget = 512 * 1024;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	connection1.objectCacheEnabled = NO;
+	connection2.objectCacheEnabled = NO;
+	
+	NSMutableString *largeObject = [NSMutableString string];
+	for (int i = 0; i < 200; i++) {
+		[largeObject appendFormat:@"object %d ", i];
+	}
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 2000; i++)
+		{
+			[transaction setObject:largeObject forKey:[NSString stringWithFormat:@"%d", i] inCollection:nil];
+		}
+	}];
+	
+	// Reading every row would fill a default sized page cache (~2 MB) in each connection
+	
+	void (^readAll)(YapDatabaseReadTransaction *) = ^(YapDatabaseReadTransaction *transaction) {
+		
+		__block NSUInteger count = 0;
+		[transaction enumerateKeysAndObjectsInCollection:nil usingBlock:^(NSString *key, id object, BOOL *stop) {
+			count++;
+		}];
+		
+		XCTAssertTrue(count == 2000);
+	};
+	
+	[connection1 readWithBlock:readAll];
+	[connection2 readWithBlock:readAll];
+	
+	// Each connection only gets a share of the budget (some overhead per page aside)
+	
+	XCTAssertTrue([connection1 statistics].pageCacheUsed > 0);
+	XCTAssertTrue([connection1 statistics].pageCacheUsed < options.pageCacheBudget);
+	XCTAssertTrue([connection2 statistics].pageCacheUsed < options.pageCacheBudget);
+	
+	YapDatabaseStatistics *statistics = [database statistics];
+	
+	XCTAssertTrue(statistics.pageCacheUsed < options.pageCacheBudget * 3 / 2);
+}
+
+- (void)testConnectionPageCacheSize
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	XCTAssertTrue(database.connectionDefaults.pageCacheSpillEnabled);
+	XCTAssertTrue(connection1.pageCacheSize == 0);
+	XCTAssertTrue(connection1.pageCacheSpillEnabled);
+	
+	connection1.objectCacheEnabled = NO;
+	connection1.pageCacheSize = 128 * 1024;
+	
+	connection2.objectCacheEnabled = NO;
+	connection2.pageCacheSize = 128 * 1024;
+	connection2.pageCacheMaximumSize = 1024 * 1024;
+	connection2.pageCacheSpillEnabled = NO;
+	
+	NSMutableString *largeObject = [NSMutableString string];
+	for (int i = 0; i < 200; i++) {
+		[largeObject appendFormat:@"object %d ", i];
+	}
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 2000; i++)
+		{
+			[transaction setObject:largeObject forKey:[NSString stringWithFormat:@"%d", i] inCollection:nil];
+		}
+	}];
+	
+	void (^readAll)(YapDatabaseReadTransaction *) = ^(YapDatabaseReadTransaction *transaction) {
+		
+		__block NSUInteger count = 0;
+		[transaction enumerateKeysAndObjectsInCollection:nil usingBlock:^(NSString *key, id object, BOOL *stop) {
+			count++;
+		}];
+		
+		XCTAssertTrue(count == 2000);
+	};
+	
+	// The fixed size cache stays small, while the adaptive one grows (as every read misses)
+	
+	for (int i = 0; i < 6; i++)
+	{
+		[connection1 readWithBlock:readAll];
+		[connection2 readWithBlock:readAll];
+	}
+	
+	uint64_t fixedUsed = [connection1 statistics].pageCacheUsed;
+	uint64_t adaptiveUsed = [connection2 statistics].pageCacheUsed;
+	
+	XCTAssertTrue(fixedUsed < (192 * 1024));
+	XCTAssertTrue(adaptiveUsed > (256 * 1024));
+	XCTAssertTrue(adaptiveUsed < (1536 * 1024));
+	
+	// And shrinks again when flushed
+	
+	[connection2 flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Internal];
+	[connection2 readWithBlock:readAll];
+	
+	XCTAssertTrue([connection2 statistics].pageCacheUsed < (192 * 1024));
+}
+
+- (void)testAdaptiveMMapSize
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.pragmaMMapSizeMaximum = 1024 * 1024 * 1024;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSMutableString *largeObject = [NSMutableString string];
+	for (int i = 0; i < 1000; i++) {
+		[largeObject appendFormat:@"object %d ", i];
+	}
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:largeObject forKey:[NSString stringWithFormat:@"%d", i] inCollection:nil];
+		}
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNotNil([transaction objectForKey:@"0" inCollection:nil]);
+	}];
+	
+	// Memory mapping may be disabled by sqlite itself (as it is on iOS),
+	// in which case sqlite reports an mmap_size of zero.
+	
+	YapDatabaseStatistics *statistics = [database statistics];
+	
+	XCTAssertTrue(statistics.databaseSize > 0);
+	XCTAssertTrue(statistics.mmapSize <= (uint64_t)options.pragmaMMapSizeMaximum);
+	XCTAssertTrue(statistics.mappedFraction >= 0.0 && statistics.mappedFraction <= 1.0);
+	
+	if (statistics.mmapSize > 0)
+	{
+		// The mapping has headroom beyond the size of the file
+		
+		XCTAssertTrue(statistics.mmapSize > statistics.databaseSize);
+		XCTAssertEqual(statistics.mappedFraction, 1.0);
+	}
+	
+	XCTAssertNotNil([statistics dictionaryRepresentation][@"mappedFraction"]);
+	XCTAssertTrue([connection statistics].mmapSize >= statistics.mmapSize);
+}
+
+- (void)testObjectsForCollectionKeys
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"post1" forKey:@"1" inCollection:@"posts"];
+		[transaction setObject:@"post2" forKey:@"2" inCollection:@"posts"];
+		[transaction setObject:@"user1" forKey:@"1" inCollection:@"users"];
+		[transaction setObject:@"default" forKey:@"1" inCollection:nil];
+	}];
+	
+	NSArray<YapCollectionKey *> *collectionKeys = @[
+		YapCollectionKeyCreate(@"users", @"1"),
+		YapCollectionKeyCreate(@"posts", @"2"),
+		YapCollectionKeyCreate(@"posts", @"missing"),
+		YapCollectionKeyCreate(@"", @"1"),
+		YapCollectionKeyCreate(@"posts", @"1"),
+		YapCollectionKeyCreate(@"users", @"1"),
+	];
+	
+	NSArray *expected = @[ @"user1", @"post2", [NSNull null], @"default", @"post1", @"user1" ];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectsForCollectionKeys:@[]], @[]);
+		
+		// From the database
+		XCTAssertEqualObjects([transaction objectsForCollectionKeys:collectionKeys], expected);
+		
+		// From the cache
+		XCTAssertEqualObjects([transaction objectsForCollectionKeys:collectionKeys], expected);
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"2" inCollection:@"posts"];
+		[transaction setObject:@"user1+" forKey:@"1" inCollection:@"users"];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSArray *objects = [transaction objectsForCollectionKeys:collectionKeys];
+		
+		XCTAssertEqualObjects(objects, (@[ @"user1+", [NSNull null], [NSNull null], @"default", @"post1", @"user1+" ]));
+	}];
+}
+
+- (void)testEnumerateProxyObjects
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 10; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%@%d", ((i < 2) ? @"keep-" : @"skip-"), i];
+			
+			[transaction setObject:[NSString stringWithFormat:@"object %d", i]
+			                forKey:key
+			          inCollection:@"test"
+			          withMetadata:@(i)];
+		}
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		__block NSUInteger count = 0;
+		__block NSUInteger loadedCount = 0;
+		
+		[transaction enumerateKeysAndProxyObjectsInCollection:@"test"
+		                                           usingBlock:^(NSString *key, YapProxyObject *object, BOOL *stop)
+		{
+			count++;
+			XCTAssertFalse(object.isRealObjectLoaded);
+			
+			if ([key hasPrefix:@"keep-"])
+			{
+				NSString *expected = [NSString stringWithFormat:@"object %@", [key substringFromIndex:5]];
+				
+				XCTAssertTrue([(NSString *)object isEqualToString:expected]);
+				XCTAssertTrue(object.isRealObjectLoaded);
+				XCTAssertEqualObjects(object.realObject, expected);
+				
+				loadedCount++;
+			}
+		}];
+		
+		XCTAssertTrue(count == 10);
+		XCTAssertTrue(loadedCount == 2);
+		
+		__block NSUInteger rowCount = 0;
+		
+		[transaction enumerateRowsWithProxiesInCollection:@"test"
+		                                       usingBlock:^(NSString *key, YapProxyObject *object,
+		                                                    YapProxyObject *metadata, BOOL *stop)
+		{
+			rowCount++;
+			
+			XCTAssertFalse(object.isRealObjectLoaded);
+			XCTAssertFalse(metadata.isRealObjectLoaded);
+			
+			XCTAssertEqualObjects(metadata.realObject, @([[key substringFromIndex:5] intValue]));
+			XCTAssertTrue(metadata.isRealObjectLoaded);
+			XCTAssertFalse(object.isRealObjectLoaded);
+			
+			*stop = YES;
+		}];
+		
+		XCTAssertTrue(rowCount == 1);
+	}];
+}
+
+- (void)testColdStorage
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:[databasePath stringByAppendingString:@"-cold"] error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.coldCollections = [NSSet setWithObject:@"archive"];
+	options.coldStorageAge = 0;                 // everything is old enough
+	options.coldStorageMigrationInterval = 0;   // migrate manually
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.objectCacheEnabled = NO;
+	
+	NSMutableString *largeObject = [NSMutableString string];
+	for (int i = 0; i < 1000; i++) {
+		[largeObject appendFormat:@"message %d ", i];
+	}
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:largeObject forKey:@"old" inCollection:@"archive" withMetadata:@"meta"];
+		[transaction setObject:@"other" forKey:@"other" inCollection:@"archive"];
+		[transaction setObject:largeObject forKey:@"hot" inCollection:nil];
+	}];
+	
+	XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:database.databasePath_cold]);
+	
+	// A rolled back migration doesn't move anything
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		XCTAssertTrue([transaction moveObjectsToColdStorageWithLimit:100] == 2);
+		[transaction rollback];
+	}];
+	
+	__block NSUInteger movedCount = 0;
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		movedCount = [transaction moveObjectsToColdStorageWithLimit:100];
+	}];
+	
+	XCTAssertTrue(movedCount == 2);
+	XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:database.databasePath_cold]);
+	
+	// Objects are only moved once
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		XCTAssertTrue([transaction moveObjectsToColdStorageWithLimit:100] == 0);
+	}];
+	
+	// Reads are transparent (and the rows, metadata & counts are unchanged)
+	
+	[[database newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"old" inCollection:@"archive"], largeObject);
+		XCTAssertEqualObjects([transaction objectForKey:@"other" inCollection:@"archive"], @"other");
+		XCTAssertEqualObjects([transaction metadataForKey:@"old" inCollection:@"archive"], @"meta");
+		XCTAssertEqualObjects([transaction objectForKey:@"hot" inCollection:nil], largeObject);
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"archive"] == 2);
+		
+		NSData *serializedObject = [transaction serializedObjectForKey:@"old" inCollection:@"archive"];
+		XCTAssertEqualObjects([YapDatabase defaultDeserializer](@"archive", @"old", serializedObject), largeObject);
+	}];
+	
+	// Overwriting a cold object stores the new object in the main file again
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"new" forKey:@"other" inCollection:@"archive"];
+		[transaction removeObjectForKey:@"old" inCollection:@"archive"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"other" inCollection:@"archive"], @"new");
+		XCTAssertNil([transaction objectForKey:@"old" inCollection:@"archive"]);
+	}];
+	
+	// The cold file survives reopening the database
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:largeObject forKey:@"old" inCollection:@"archive"];
+		XCTAssertTrue([transaction moveObjectsToColdStorageWithLimit:100] == 2); // "old" & the overwritten "other"
+	}];
+	
+	connection = nil;
+	database = nil;
+	
+	database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	[[database newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"old" inCollection:@"archive"], largeObject);
+	}];
+}
+
+- (void)testCollectionArchive
+{
+	NSString *databasePath1 = [self databasePath:[NSStringFromSelector(_cmd) stringByAppendingString:@"1"]];
+	NSString *databasePath2 = [self databasePath:[NSStringFromSelector(_cmd) stringByAppendingString:@"2"]];
+	NSString *archivePath = [self databasePath:[NSStringFromSelector(_cmd) stringByAppendingString:@".archive"]];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath1 error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath2 error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:archivePath error:NULL];
+	
+	YapDatabase *database1 = [[YapDatabase alloc] initWithPath:databasePath1];
+	YapDatabase *database2 = [[YapDatabase alloc] initWithPath:databasePath2];
+	
+	XCTAssertNotNil(database1);
+	XCTAssertNotNil(database2);
+	
+	YapDatabaseConnection *connection1 = [database1 newConnection];
+	YapDatabaseConnection *connection2 = [database2 newConnection];
+	
+	const NSUInteger rowCount = 5000;
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < rowCount; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			id metadata = (i % 2) ? key : nil;
+			
+			[transaction setObject:[@"object-" stringByAppendingString:key] forKey:key inCollection:@"archived" withMetadata:metadata];
+			[transaction setObject:key forKey:key inCollection:@"other"];
+		}
+	}];
+	
+	__block NSError *error = nil;
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		error = [transaction exportCollection:@"archived" toPath:archivePath compressed:YES];
+	}];
+	
+	XCTAssertNil(error);
+	
+	YapDatabaseCollectionArchive *archive = [[YapDatabaseCollectionArchive alloc] initWithPath:archivePath];
+	
+	XCTAssertNotNil(archive);
+	XCTAssertTrue([archive.collection isEqualToString:@"archived"]);
+	XCTAssertTrue(archive.isCompressed);
+	
+	// Import (replacing an existing key, and leaving other keys untouched)
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		[transaction setObject:@"stale" forKey:@"0" inCollection:@"archived"];
+		[transaction setObject:@"untouched" forKey:@"extra" inCollection:@"archived"];
+	}];
+	
+	YapDatabaseConnection *observer = [database2 newConnection];
+	[observer beginLongLivedReadTransaction];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		error = [transaction importCollectionFromPath:archivePath];
+	}];
+	
+	XCTAssertNil(error);
+	
+	NSArray *notifications = [observer beginLongLivedReadTransaction];
+	XCTAssertTrue([observer didResetCollection:@"archived" inNotifications:notifications]);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"archived"] == (rowCount + 1));
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"other"] == 0);
+		
+		XCTAssertTrue([[transaction objectForKey:@"extra" inCollection:@"archived"] isEqual:@"untouched"]);
+		
+		for (NSUInteger i = 0; i < rowCount; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			
+			id object = nil;
+			id metadata = nil;
+			[transaction getObject:&object metadata:&metadata forKey:key inCollection:@"archived"];
+			
+			XCTAssertTrue([object isEqual:[@"object-" stringByAppendingString:key]], @"key(%@) object(%@)", key, object);
+			
+			if (i % 2)
+				XCTAssertTrue([metadata isEqual:key], @"key(%@) metadata(%@)", key, metadata);
+			else
+				XCTAssertNil(metadata, @"key(%@)", key);
+		}
+	}];
+	
+	// A corrupt archive is rejected
+	
+	[[NSData dataWithBytes:"not an archive" length:14] writeToFile:archivePath atomically:YES];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		error = [transaction importCollectionFromPath:archivePath];
+	}];
+	
+	XCTAssertNotNil(error);
+	
+	[[NSFileManager defaultManager] removeItemAtPath:archivePath error:NULL];
+}
+
+- (void)testParallelEnumerateCollection
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	const NSUInteger rowCount = 1000;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// Interleave the collections, so the rowid ranges of the scanned collection contain other rows.
+		for (NSUInteger i = 0; i < rowCount; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+			
+			[transaction setObject:@(i) forKey:key inCollection:@"scanned" withMetadata:key];
+			[transaction setObject:@(i) forKey:key inCollection:@"other"];
+		}
+	}];
+	
+	NSMutableSet<NSString *> *keys = [NSMutableSet set];
+	__block BOOL mismatch = NO;
+	
+	[database parallelEnumerateCollection:@"scanned" workers:4 block:^(NSString *key, id object, id metadata, BOOL *stop) {
+		
+		@synchronized (keys)
+		{
+			[keys addObject:key];
+			
+			if (![[object stringValue] isEqualToString:key] || ![metadata isEqual:key])
+				mismatch = YES;
+		}
+	}];
+	
+	XCTAssertTrue([keys count] == rowCount, @"Expected %lu, found %lu", (unsigned long)rowCount, (unsigned long)[keys count]);
+	XCTAssertFalse(mismatch);
+	
+	// Stop
+	
+	__block NSUInteger enumerated = 0;
+	
+	[database parallelEnumerateCollection:@"scanned" workers:4 block:^(NSString *key, id object, id metadata, BOOL *stop) {
+		
+		@synchronized (keys)
+		{
+			enumerated++;
+		}
+		*stop = YES;
+	}];
+	
+	XCTAssertTrue(enumerated >= 1 && enumerated <= 4, @"Expected each worker to stop, enumerated %lu", (unsigned long)enumerated);
+	
+	// Empty collection
+	
+	__block BOOL invoked = NO;
+	[database parallelEnumerateCollection:@"empty" workers:0 block:^(NSString *key, id object, id metadata, BOOL *stop) {
+		invoked = YES;
+	}];
+	
+	XCTAssertFalse(invoked);
+}
+
+- (void)testCoalescedAsyncReads
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.coalescesAsyncReads = YES;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		[transaction setObject:@(1) forKey:@"key" inCollection:nil];
+	}];
+	
+	dispatch_queue_t completionQueue = dispatch_queue_create("testCoalescedAsyncReads", DISPATCH_QUEUE_SERIAL);
+	XCTestExpectation *expectation = [self expectationWithDescription:@"coalesced reads"];
+	
+	NSMutableArray<NSNumber *> *results = [NSMutableArray array];
+	
+	const int readCount = 100;
+	__block int completionCount = 0;
+	
+	for (int i = 0; i < (readCount * 2); i++)
+	{
+		if (i == readCount)
+		{
+			// The reads queued after this write must see it (i.e. they can't join the batch queued before it).
+			
+			[connection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+				[transaction setObject:@(2) forKey:@"key" inCollection:nil];
+			}];
+		}
+		
+		__block NSNumber *value = nil;
+		[connection asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			value = [transaction objectForKey:@"key" inCollection:nil];
+			
+		} completionQueue:completionQueue completionBlock:^{
+			
+			[results addObject:value];
+			
+			if (++completionCount == (readCount * 2)) {
+				[expectation fulfill];
+			}
+		}];
+	}
+	
+	[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+	
+	for (int i = 0; i < (readCount * 2); i++)
+	{
+		XCTAssertEqualObjects(results[i], (i < readCount) ? @(1) : @(2));
+	}
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction __unused *transaction) {}];
+	XCTAssertTrue(connection.pendingTransactionCount == 0);
+}
+
+- (void)testSnapshotPublication
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *writeConnection = [database newConnection];
+	NSArray<YapDatabaseConnection *> *readConnections = @[ [database newConnection], [database newConnection] ];
+	
+	const int writeCount = 200;
+	
+	dispatch_group_t group = dispatch_group_create();
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	dispatch_group_async(group, queue, ^{
+		
+		for (int i = 1; i <= writeCount; i++)
+		{
+			[writeConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+				[transaction setObject:@(i) forKey:@"counter" inCollection:nil];
+			}];
+		}
+	});
+	
+	// Each read transaction fast-forwards through the changesets it missed (fetched outside the snapshotQueue).
+	// So the (cached) counter must never go backwards.
+	
+	for (YapDatabaseConnection *readConnection in readConnections)
+	{
+		dispatch_group_async(group, queue, ^{
+			
+			__block int last = 0;
+			while (last < writeCount)
+			{
+				[readConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+					
+					int counter = [[transaction objectForKey:@"counter" inCollection:nil] intValue];
+					XCTAssertTrue(counter >= last);
+					
+					last = counter;
+				}];
+			}
+		});
+	}
+	
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	
+	XCTAssertTrue([database snapshot] >= (uint64_t)writeCount);
+}
+
+- (void)testStorageReport
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSMutableData *largeObject = [NSMutableData dataWithLength:(16 * 1024)];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%d", i];
+			[transaction setObject:key forKey:key inCollection:@"small"];
+		}
+		
+		for (int i = 0; i < 10; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%d", i];
+			[transaction setObject:largeObject forKey:key inCollection:@"large" withMetadata:key];
+		}
+	}];
+	
+	YapDatabaseStorageReport *report = [connection storageReport];
+	
+	XCTAssertTrue(report.consistent);
+	XCTAssertTrue(report.pageSize > 0);
+	XCTAssertTrue(report.fileSize == (report.pageSize * report.pageCount));
+	
+	YapDatabaseStorageCollectionReport *small = [report collectionReportForCollection:@"small"];
+	YapDatabaseStorageCollectionReport *large = [report collectionReportForCollection:@"large"];
+	
+	XCTAssertTrue(small.rowCount == 100);
+	XCTAssertTrue(large.rowCount == 10);
+	XCTAssertTrue(large.objectBytes >= (10 * 16 * 1024));
+	XCTAssertTrue(large.metadataBytes > 0);
+	XCTAssertTrue(small.metadataBytes == 0);
+	XCTAssertTrue(report.collections[0] == large); // sorted by size
+	
+	if (report.dbstatAvailable)
+	{
+		YapDatabaseStorageTableReport *table = [report tableReportForName:@"database2"];
+		YapDatabaseStorageTableReport *index = [report tableReportForName:@"true_primary_key"];
+		
+		XCTAssertTrue(table.entryCount == 110);
+		XCTAssertTrue(table.overflowPageCount > 0); // the large objects don't fit within a page
+		XCTAssertTrue(index.isIndex);
+		XCTAssertNil(index.extensionName);
+	}
+	
+	XCTestExpectation *expectation = [self expectationWithDescription:@"async storage report"];
+	
+	[connection asyncStorageReportWithCompletionQueue:NULL completionBlock:^(YapDatabaseStorageReport *asyncReport) {
+		
+		XCTAssertNotNil(asyncReport);
+		XCTAssertTrue([asyncReport collectionReportForCollection:@"small"].rowCount == 100);
+		XCTAssertTrue(asyncReport.tables.count == report.tables.count);
+		
+		[expectation fulfill];
+	}];
+	
+	[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+}
+
+- (void)testCacheSimulation
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSString *tracePath = [databasePath stringByAppendingPathExtension:@"trace"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseWorkloadTraceRecorder *recorder = [[YapDatabaseWorkloadTraceRecorder alloc] initWithPath:tracePath];
+	XCTAssertNotNil(recorder);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.workloadTraceRecorder = recorder;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%d", i];
+			[transaction setObject:key forKey:key inCollection:@"test"];
+		}
+	}];
+	
+	// Cycle through 10 keys (which were written first, and thus are least recently used).
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (int round = 0; round < 10; round++)
+		{
+			for (int i = 0; i < 10; i++)
+			{
+				(void)[transaction objectForKey:[NSString stringWithFormat:@"%d", i] inCollection:@"test"];
+			}
+		}
+	}];
+	
+	[recorder close];
+	
+	YapDatabaseCacheSimulation *simulation = [[YapDatabaseCacheSimulation alloc] initWithPath:tracePath];
+	XCTAssertNotNil(simulation);
+	
+	simulation.countLimits = @[ @5, @10, @200 ];
+	
+	YapDatabaseCacheSimulationResult *result = [simulation run];
+	YapDatabaseCacheSimulationCurve *curve = result.objectCurve;
+	
+	XCTAssertTrue(result.transactionCount == 2);
+	XCTAssertTrue(result.connectionCount == 1);
+	
+	XCTAssertTrue(curve.lookupCount == 100);
+	XCTAssertTrue(curve.distinctKeyCount == 10);
+	
+	// LRU thrashes when the keys don't fit, and only misses the first round when they do.
+	
+	XCTAssertEqualWithAccuracy([curve.lruHitRates[0] doubleValue], 0.0, 0.0001);
+	XCTAssertEqualWithAccuracy([curve.lruHitRates[1] doubleValue], 0.9, 0.0001);
+	XCTAssertEqualWithAccuracy([curve.lruHitRates[2] doubleValue], 1.0, 0.0001);
+	
+	XCTAssertTrue([curve countLimitForHitRate:0.9] == 10);
+	XCTAssertTrue([curve countLimitForHitRate:0.95] == 200);
+	
+	XCTAssertTrue([curve.memoryUsages[0] unsignedLongLongValue] < [curve.memoryUsages[2] unsignedLongLongValue]);
+	
+	uint64_t collectionHash = [recorder hashForCollection:@"test"];
+	XCTAssertNotNil(result.objectCurvesByCollection[@(collectionHash)]);
+	
+	XCTAssertTrue([[result csvRepresentation] length] > 0);
+	
+	[[NSFileManager defaultManager] removeItemAtPath:tracePath error:NULL];
+}
+
+- (void)testTransactionBudget
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.name = @"budgeted";
+	
+	NSMutableArray<YapDatabaseTransactionBudgetReport *> *reports = [NSMutableArray array];
+	
+	dispatch_queue_t reportQueue = dispatch_queue_create("testTransactionBudget", DISPATCH_QUEUE_SERIAL);
+	
+	[connection setTransactionBudgetForReads:0.05 writes:0.2 block:^(YapDatabaseConnection *c,
+	                                                                   YapDatabaseTransactionBudgetReport *report) {
+		[reports addObject:report];
+		
+	} queue:reportQueue];
+	
+	// Within budget
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"key" inCollection:@"test"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		(void)[transaction objectForKey:@"key" inCollection:@"test"];
+	}];
+	
+	// Over budget
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		(void)[transaction objectForKey:@"key" inCollection:@"test"];
+		[NSThread sleepForTimeInterval:0.2];
+	}];
+	
+	dispatch_sync(reportQueue, ^{});
+	
+	XCTAssertTrue(reports.count == 1);
+	
+	YapDatabaseTransactionBudgetReport *report = [reports firstObject];
+	
+	XCTAssertEqualObjects(report.connectionName, @"budgeted");
+	XCTAssertFalse(report.readWrite);
+	XCTAssertTrue(report.budget == 0.05);
+	XCTAssertTrue(report.duration >= 0.2);
+	XCTAssertTrue(report.phase == YapDatabaseTransactionPhaseBlock);
+	XCTAssertTrue([report durationForPhase:YapDatabaseTransactionPhaseBlock] >= 0.15);
+	XCTAssertTrue(report.metrics.objectCacheHitCount + report.metrics.objectCacheMissCount == 1);
+	XCTAssertTrue(report.callStackSymbols.count > 0);
+	
+	// Disabled
+	
+	[connection setTransactionBudgetForReads:0 writes:0 block:nil queue:NULL];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[NSThread sleepForTimeInterval:0.1];
+	}];
+	
+	dispatch_sync(reportQueue, ^{});
+	
+	XCTAssertTrue(reports.count == 1);
+}
+
+- (void)testWALPinning
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	connection1.name = @"connection1";
+	connection2.name = @"connection2";
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object0" forKey:@"key0" inCollection:@"test"];
+	}];
+	
+	[connection2 beginLongLivedReadTransaction];
+	XCTAssertNil([database walPinningReport]);
+	
+	__block YapDatabaseWALPinningReport *pinningReport = nil;
+	
+	dispatch_queue_t reportQueue = dispatch_queue_create("testWALPinning", DISPATCH_QUEUE_SERIAL);
+	XCTestExpectation *reportExpectation = [self expectationWithDescription:@"WAL pinning report"];
+	
+	[database setWALPinningDurationThreshold:0.0 frameThreshold:1 block:^(YapDatabaseWALPinningReport *report) {
+		
+		if (pinningReport == nil)
+		{
+			pinningReport = report;
+			[reportExpectation fulfill];
+		}
+		
+	} queue:reportQueue];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object1" forKey:@"key1" inCollection:@"test"];
+	}];
+	
+	[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+	
+	XCTAssertEqualObjects(pinningReport.connectionName, @"connection2");
+	XCTAssertTrue(pinningReport.longLivedReadTransaction);
+	XCTAssertTrue(pinningReport.snapshot < pinningReport.databaseSnapshot);
+	XCTAssertTrue(pinningReport.walFrameCount > 0);
+	
+	XCTAssertEqualObjects([database walPinningReport].connectionName, @"connection2");
+	
+	// Once idle, the long-lived read transaction is moved forward automatically.
+	
+	[self expectationForNotification:YapDatabaseLongLivedReadTransactionAdvancedNotification
+	                          object:connection2
+	                         handler:^BOOL(NSNotification *notification) {
+		
+		NSArray *notifications = notification.userInfo[YapDatabaseModifiedNotificationsKey];
+		return (notifications.count == 2);
+	}];
+	
+	connection2.longLivedReadTransactionIdleTimeout = 0.1;
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object2" forKey:@"key2" inCollection:@"test"];
+	}];
+	
+	[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+	
+	XCTAssertNil([database walPinningReport]);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key2" inCollection:@"test"], @"object2");
+	}];
+	
+	[database setWALPinningDurationThreshold:0.0 frameThreshold:0 block:nil queue:NULL];
+	[connection2 endLongLivedReadTransaction];
+}
+
+- (void)testDetachedLongLivedReadTransaction
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	connection1.detachesLongLivedReadTransactions = YES;
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@(0) forKey:@"key" inCollection:@"test"];
+	}];
+	
+	[connection1 beginLongLivedReadTransaction];
+	
+	for (int i = 1; i <= 5; i++)
+	{
+		[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:@"key" inCollection:@"test"];
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"test"];
+		}];
+		
+		// The long-lived read transaction remains on its (stable) snapshot,
+		// even when the value must be read from disk.
+		
+		[connection1 flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Caches];
+		
+		[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(0));
+			XCTAssertNil([transaction objectForKey:@"key1" inCollection:@"test"]);
+		}];
+	}
+	
+	NSArray *notifications = [connection1 beginLongLivedReadTransaction];
+	XCTAssertTrue([notifications count] == 5);
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(5));
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"test"] == 6);
+	}];
+	
+	[connection1 endLongLivedReadTransaction];
+	XCTAssertFalse([connection1 isInLongLivedReadTransaction]);
+}
+
+- (void)testAttachedLongLivedReadTransaction
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	XCTAssertFalse(connection1.detachesLongLivedReadTransactions);
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@(0) forKey:@"key" inCollection:@"test"];
+	}];
+	
+	[connection1 beginLongLivedReadTransaction];
+	
+	// Without detachesLongLivedReadTransactions, the sqlite read transaction remains open
+	// for the lifetime of the long-lived read transaction (i.e. it's never detached after a read).
+	
+	XCTAssertTrue(sqlite3_get_autocommit(connection1->db) == 0);
+	
+	for (int i = 1; i <= 3; i++)
+	{
+		[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:@"key" inCollection:@"test"];
+		}];
+		
+		[connection1 flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Caches];
+		
+		[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(0));
+		}];
+		
+		XCTAssertTrue(sqlite3_get_autocommit(connection1->db) == 0);
+		
+		XCTestExpectation *expectation = [self expectationWithDescription:@"asyncRead"];
+		
+		[connection1 asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(0));
+			
+		} completionBlock:^{
+			
+			[expectation fulfill];
+		}];
+		
+		[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+		
+		XCTAssertTrue(sqlite3_get_autocommit(connection1->db) == 0);
+	}
+	
+	NSArray *notifications = [connection1 beginLongLivedReadTransaction];
+	XCTAssertTrue([notifications count] == 3);
+	XCTAssertTrue(sqlite3_get_autocommit(connection1->db) == 0);
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(3));
+	}];
+	
+	[connection1 endLongLivedReadTransaction];
+	XCTAssertFalse([connection1 isInLongLivedReadTransaction]);
+	XCTAssertTrue(sqlite3_get_autocommit(connection1->db) != 0);
+}
+
+- (void)testMultiProcessSharedSnapshot
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSString *sharedSnapshotPath = [databasePath stringByAppendingString:@"-yapshm"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:sharedSnapshotPath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableMultiProcessSupport = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	XCTAssertNotNil(database);
+	XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:sharedSnapshotPath]);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	for (int i = 0; i < 5; i++)
+	{
+		YapDatabaseConnection *connection = (i % 2 == 0) ? connection1 : connection2;
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:nil], (i > 0 ? @(i - 1) : nil));
+			
+			[transaction setObject:@(i) forKey:@"key" inCollection:nil];
+		}];
+	}
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:nil], @(4));
+	}];
+}
+
+- (void)testIOStatistics
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	{
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNil([database ioStatistics]);
+	}
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableIOStatistics = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil([database ioStatistics]);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[database resetIOStatistics];
+	
+	YapDatabaseIOStatistics *stats = [database ioStatistics];
+	XCTAssertTrue(stats.totalBytesWritten == 0);
+	XCTAssertTrue(stats.totalSyncCount == 0);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"%d", i] inCollection:nil];
+		}
+	}];
+	
+	stats = [database ioStatistics];
+	
+	uint64_t walWrites = [stats countForOperation:YapDatabaseIOOperationWrite file:YapDatabaseIOFileWAL];
+	XCTAssertTrue(walWrites > 0);
+	XCTAssertTrue([stats bytesForOperation:YapDatabaseIOOperationWrite file:YapDatabaseIOFileWAL] > 0);
+	XCTAssertTrue([stats bytesForOperation:YapDatabaseIOOperationSync file:YapDatabaseIOFileWAL] == 0);
+	XCTAssertTrue(stats.totalBytesWritten > 0);
+	
+	// pragmaSynchronous defaults to Full, so the commit syncs the WAL
+	XCTAssertTrue([stats countForOperation:YapDatabaseIOOperationSync file:YapDatabaseIOFileWAL] > 0);
+	
+	NSArray<NSNumber *> *histogram =
+	  [stats latencyHistogramForOperation:YapDatabaseIOOperationWrite file:YapDatabaseIOFileWAL];
+	XCTAssertTrue([histogram count] == YapDatabaseIOLatencyBucketCount);
+	
+	uint64_t histogramTotal = 0;
+	for (NSNumber *bucket in histogram)
+	{
+		histogramTotal += [bucket unsignedLongLongValue];
+	}
+	XCTAssertTrue(histogramTotal == walWrites);
+	
+	XCTAssertTrue([YapDatabaseIOStatistics lowerBoundForLatencyBucket:0] == 0.0);
+	XCTAssertTrue([YapDatabaseIOStatistics lowerBoundForLatencyBucket:1] > 0.0);
+	
+	[database resetIOStatistics];
+	
+	stats = [database ioStatistics];
+	XCTAssertTrue([stats countForOperation:YapDatabaseIOOperationWrite file:YapDatabaseIOFileWAL] == 0);
+	XCTAssertTrue(stats.totalBytesWritten == 0);
+}
+
+- (void)testTransactionMetrics
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	dispatch_queue_t metricsQueue = dispatch_queue_create("testTransactionMetrics", DISPATCH_QUEUE_SERIAL);
+	__block YapDatabaseTransactionMetrics *lastMetrics = nil;
+	
+	[connection setTransactionMetricsBlock:^(YapDatabaseConnection *metricsConnection, YapDatabaseTransactionMetrics *metrics) {
+		
+		XCTAssertTrue(metricsConnection == connection);
+		lastMetrics = metrics;
+		
+	} queue:metricsQueue];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:[TestObject generateTestObject] forKey:[NSString stringWithFormat:@"%d", i] inCollection:nil];
+		}
+		
+		for (int i = 0; i < 100; i++)
+		{
+			(void)[transaction objectForKey:[NSString stringWithFormat:@"%d", i] inCollection:nil];
+		}
+	}];
+	
+	dispatch_sync(metricsQueue, ^{});
+	
+	XCTAssertNotNil(lastMetrics);
+	XCTAssertFalse(lastMetrics.didRollback);
+	XCTAssertTrue(lastMetrics.totalDuration > 0.0);
+	XCTAssertTrue(lastMetrics.totalDuration >= lastMetrics.blockDuration);
+	XCTAssertTrue(lastMetrics.commitDuration > 0.0);
+	XCTAssertTrue(lastMetrics.serializationCount == 100);
+	XCTAssertTrue((lastMetrics.objectCacheHitCount + lastMetrics.objectCacheMissCount) >= 100);
+	
+	[connection setTransactionMetricsBlock:nil queue:nil];
+	lastMetrics = nil;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeAllObjectsInAllCollections];
+	}];
+	
+	dispatch_sync(metricsQueue, ^{});
+	XCTAssertNil(lastMetrics);
+}
+
+- (void)testExternalStorage
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:[databasePath stringByAppendingString:@"-blobs"] error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.externalStorageThresholds = @{ @"blobs": @(1024) };
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	NSUInteger (^blobCount)(void) = ^NSUInteger (void){
+		
+		NSArray *fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:database.databasePath_blobs
+		                                                                         error:NULL];
+		return fileNames.count;
+	};
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.objectCacheEnabled = NO;
+	
+	NSMutableData *largeObject = [NSMutableData dataWithLength:(1024 * 100)];
+	arc4random_buf(largeObject.mutableBytes, largeObject.length);
+	
+	NSData *smallObject = [@"small" dataUsingEncoding:NSUTF8StringEncoding];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:largeObject forKey:@"large" inCollection:@"blobs"];
+		[transaction setObject:largeObject forKey:@"large-copy" inCollection:@"blobs"]; // shares the same file
+		[transaction setObject:smallObject forKey:@"small" inCollection:@"blobs"];
+		[transaction setObject:largeObject forKey:@"large" inCollection:nil];           // no threshold
+	}];
+	
+	XCTAssertTrue(blobCount() == 1);
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"large" inCollection:@"blobs"], largeObject);
+		XCTAssertEqualObjects([transaction objectForKey:@"large-copy" inCollection:@"blobs"], largeObject);
+		XCTAssertEqualObjects([transaction objectForKey:@"small" inCollection:@"blobs"], smallObject);
+		XCTAssertEqualObjects([transaction objectForKey:@"large" inCollection:nil], largeObject);
+	}];
+	
+	// A rolled back transaction shouldn't leave any files behind
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		NSMutableData *otherObject = [NSMutableData dataWithLength:(1024 * 10)];
+		arc4random_buf(otherObject.mutableBytes, otherObject.length);
+		
+		[transaction setObject:otherObject forKey:@"other" inCollection:@"blobs"];
+		[transaction rollback];
+	}];
+	
+	XCTAssertTrue(blobCount() == 1);
+	
+	// The file is shared, so it isn't deleted until the last reference is removed
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"large" inCollection:@"blobs"];
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"large-copy" inCollection:@"blobs"], largeObject);
+		[transaction removeAllObjectsInCollection:@"blobs"];
+	}];
+	
+	// Unreferenced files are deleted asynchronously (once every connection has moved past the commit)
+	
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+	while (blobCount() > 0 && [timeout timeIntervalSinceNow] > 0)
+	{
+		[NSThread sleepForTimeInterval:0.05];
+	}
+	
+	XCTAssertTrue(blobCount() == 0);
+}
+
+- (void)testBlobStreams
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSMutableData *largeObject = [NSMutableData dataWithLength:(1024 * 256)];
+	arc4random_buf(largeObject.mutableBytes, largeObject.length);
+	
+	NSData *serializedObject = [YapDatabase defaultSerializer](@"blobs", @"large", largeObject);
+	
+	// Write the serialized object in chunks
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		YapDatabaseBlobWriteStream *stream =
+		  [transaction openWriteStreamForKey:@"large" inCollection:@"blobs" length:serializedObject.length];
+		XCTAssertNotNil(stream);
+		
+		NSUInteger offset = 0;
+		while (offset < serializedObject.length)
+		{
+			NSUInteger chunkSize = MIN((NSUInteger)4096, serializedObject.length - offset);
+			XCTAssertTrue([stream writeData:[serializedObject subdataWithRange:NSMakeRange(offset, chunkSize)]]);
+			
+			offset += chunkSize;
+		}
+		
+		XCTAssertTrue(stream.offset == stream.length);
+		XCTAssertFalse([stream writeData:[NSData dataWithBytes:"x" length:1]]); // past the reserved length
+		
+		[stream close];
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"large" inCollection:@"blobs"], largeObject);
+	}];
+	
+	// Read it back in chunks
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"large" inCollection:@"blobs"], largeObject);
+		
+		YapDatabaseBlobReadStream *stream = [transaction openReadStreamForKey:@"large" inCollection:@"blobs"];
+		XCTAssertNotNil(stream);
+		XCTAssertTrue(stream.length == serializedObject.length);
+		
+		NSMutableData *result = [NSMutableData data];
+		uint8_t buffer[4096];
+		
+		NSInteger read;
+		while ((read = [stream read:buffer maxLength:sizeof(buffer)]) > 0)
+		{
+			[result appendBytes:buffer length:(NSUInteger)read];
+		}
+		
+		XCTAssertTrue(read == 0);
+		XCTAssertEqualObjects(result, serializedObject);
+		
+		XCTAssertNil([transaction openReadStreamForKey:@"missing" inCollection:@"blobs"]);
+	}];
+	
+	// An incomplete write removes the row
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		YapDatabaseBlobWriteStream *stream =
+		  [transaction openWriteStreamForKey:@"large" inCollection:@"blobs" length:serializedObject.length];
+		
+		[stream writeData:[serializedObject subdataWithRange:NSMakeRange(0, 100)]];
+		
+		// Not closed explicitly (closed automatically during the commit)
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNil([transaction objectForKey:@"large" inCollection:@"blobs"]);
+	}];
+}
+
+- (void)testKeyRangeEnumeration
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSString *key in @[ @"a", @"ab", @"abc", @"abd", @"b", @"ba" ])
+		{
+			[transaction setObject:key forKey:key inCollection:@"test"];
+		}
+		[transaction setObject:@"other" forKey:@"abe" inCollection:@"other"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSMutableArray *keys = [NSMutableArray array];
+		
+		[transaction enumerateKeysInCollection:@"test" withPrefix:@"ab" usingBlock:^(NSString *key, BOOL *stop) {
+			[keys addObject:key];
+		}];
+		XCTAssertEqualObjects(keys, (@[ @"ab", @"abc", @"abd" ]));
+		
+		[keys removeAllObjects];
+		[transaction enumerateKeysInCollection:@"test" withPrefix:@"" usingBlock:^(NSString *key, BOOL *stop) {
+			[keys addObject:key];
+		}];
+		XCTAssertTrue(keys.count == 6);
+		
+		[keys removeAllObjects];
+		[transaction enumerateKeysAndObjectsInCollection:@"test"
+		                                         fromKey:@"ab"
+		                                           toKey:@"b"
+		                                     withOptions:0
+		                                           limit:0
+		                                      usingBlock:^(NSString *key, id object, BOOL *stop)
+		{
+			XCTAssertEqualObjects(key, object);
+			[keys addObject:key];
+		}];
+		XCTAssertEqualObjects(keys, (@[ @"ab", @"abc", @"abd" ]));
+		
+		[keys removeAllObjects];
+		[transaction enumerateKeysAndObjectsInCollection:@"test"
+		                                         fromKey:nil
+		                                           toKey:nil
+		                                     withOptions:YapDatabaseEnumerationReverse
+		                                           limit:2
+		                                      usingBlock:^(NSString *key, id object, BOOL *stop)
+		{
+			[keys addObject:key];
+		}];
+		XCTAssertEqualObjects(keys, (@[ @"ba", @"b" ]));
+		
+		[keys removeAllObjects];
+		[transaction enumerateKeysInCollection:@"test"
+		                               fromKey:@"abc"
+		                                 toKey:nil
+		                           withOptions:0
+		                                 limit:0
+		                            usingBlock:^(NSString *key, BOOL *stop)
+		{
+			[keys addObject:key];
+		}];
+		XCTAssertEqualObjects(keys, (@[ @"abc", @"abd", @"b", @"ba" ]));
+	}];
+}
+
+- (void)testCursorPagination
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 25; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%02d", (24 - i)];
+			[transaction setObject:key forKey:key inCollection:@"test"];
+		}
+	}];
+	
+	for (NSNumber *order in @[ @(YapDatabaseCursorOrderRowid), @(YapDatabaseCursorOrderKey) ])
+	{
+		YapDatabaseCursor *cursor =
+		  [[YapDatabaseCursor alloc] initWithCollection:@"test" order:(YapDatabaseCursorOrder)[order integerValue]];
+		
+		NSMutableArray *keys = [NSMutableArray array];
+		NSUInteger pages = 0;
+		
+		while (!cursor.isExhausted)
+		{
+			// Round trip the cursor through an archive between pages
+			
+			NSData *archive = [NSKeyedArchiver archivedDataWithRootObject:cursor];
+			cursor = [NSKeyedUnarchiver unarchiveObjectWithData:archive];
+			
+			[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+				
+				[transaction enumerateKeysAndObjectsWithCursor:cursor
+				                                         limit:10
+				                                    usingBlock:^(NSString *key, id object, BOOL *stop)
+				{
+					XCTAssertEqualObjects(key, object);
+					[keys addObject:key];
+				}];
+			}];
+			
+			pages++;
+			XCTAssertTrue(pages <= 3);
+		}
+		
+		XCTAssertTrue(pages == 3);
+		XCTAssertTrue(keys.count == 25);
+		XCTAssertTrue([[NSSet setWithArray:keys] count] == 25);
+		
+		if (cursor.order == YapDatabaseCursorOrderKey)
+		{
+			XCTAssertEqualObjects([keys firstObject], @"00");
+			XCTAssertEqualObjects([keys lastObject], @"24");
+		}
+		else
+		{
+			XCTAssertEqualObjects([keys firstObject], @"24");
+			XCTAssertEqualObjects([keys lastObject], @"00");
+		}
+		
+		// Rows added beyond the position of an exhausted cursor are returned by the next page
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@"99" forKey:@"99" inCollection:@"test"];
+		}];
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			NSUInteger count = [transaction enumerateKeysAndObjectsWithCursor:cursor
+			                                                            limit:10
+			                                                       usingBlock:^(NSString *key, id object, BOOL *stop)
+			{
+				XCTAssertEqualObjects(key, @"99");
+			}];
+			XCTAssertTrue(count == 1);
+		}];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction removeObjectForKey:@"99" inCollection:@"test"];
+		}];
+	}
+}
+
+- (void)testCoarseChangeset
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 10; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"sync"];
+		}
+		[transaction setObject:@(0) forKey:@"key" inCollection:@"other"];
+	}];
+	
+	[connection1 beginLongLivedReadTransaction];
+	
+	// Populate connection1's cache
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key0" inCollection:@"sync"], @(0));
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"other"], @(0));
+	}];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		transaction.coarseChangeset = YES;
+		
+		for (int i = 0; i < 10; i++)
+		{
+			[transaction setObject:@(i + 100) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"sync"];
+		}
+		[transaction removeObjectForKey:@"key9" inCollection:@"sync"];
+	}];
+	
+	NSArray *notifications = [connection1 beginLongLivedReadTransaction];
+	XCTAssertTrue([notifications count] == 1);
+	
+	XCTAssertTrue([connection1 didResetCollection:@"sync" inNotifications:notifications]);
+	XCTAssertFalse([connection1 didResetCollection:@"other" inNotifications:notifications]);
+	XCTAssertFalse([connection1 didClearCollection:@"sync" inNotifications:notifications]);
+	
+	XCTAssertTrue([connection1 hasChangeForCollection:@"sync" inNotifications:notifications]);
+	XCTAssertTrue([connection1 hasChangeForKey:@"key0" inCollection:@"sync" inNotifications:notifications]);
+	XCTAssertFalse([connection1 hasChangeForCollection:@"other" inNotifications:notifications]);
+	
+	__block NSUInteger changedKeyCount = 0;
+	[connection1 enumerateChangedKeysInCollection:@"sync"
+	                              inNotifications:notifications
+	                                   usingBlock:^(NSString *key, BOOL *stop)
+	{
+		changedKeyCount++;
+	}];
+	XCTAssertTrue(changedKeyCount == 0);
+	
+	// The cached values must have been dropped
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key0" inCollection:@"sync"], @(100));
+		XCTAssertNil([transaction objectForKey:@"key9" inCollection:@"sync"]);
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"other"], @(0));
+	}];
+	
+	[connection1 endLongLivedReadTransaction];
+}
+
+- (void)testChangesetSpillThreshold
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 beginLongLivedReadTransaction];
+	
+	// Below the threshold: regular (per-key) changeset
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		transaction.changesetSpillThreshold = 100;
+		
+		for (int i = 0; i < 10; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"sync"];
+		}
+		
+		XCTAssertFalse(transaction.changesetSpilled);
+	}];
+	
+	NSArray *notifications = [connection1 beginLongLivedReadTransaction];
+	XCTAssertTrue([notifications count] == 1);
+	
+	XCTAssertFalse([connection1 didResetCollection:@"sync" inNotifications:notifications]);
+	XCTAssertTrue([connection1 hasChangeForKey:@"key0" inCollection:@"sync" inNotifications:notifications]);
+	XCTAssertFalse([connection1 hasChangeForKey:@"key10" inCollection:@"sync" inNotifications:notifications]);
+	
+	// Populate connection1's cache
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key0" inCollection:@"sync"], @(0));
+	}];
+	
+	// Above the threshold: the changeset is spilled (collections reset)
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		transaction.changesetSpillThreshold = 10;
+		
+		for (int i = 0; i < 50; i++)
+		{
+			[transaction setObject:@(i + 100) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"sync"];
+		}
+		[transaction removeObjectForKey:@"key9" inCollection:@"sync"];
+		[transaction setObject:@(0) forKey:@"key" inCollection:@"other"];
+		
+		XCTAssertTrue(transaction.changesetSpilled);
+		
+		// Reads within the transaction are unaffected
+		XCTAssertEqualObjects([transaction objectForKey:@"key0" inCollection:@"sync"], @(100));
+		XCTAssertNil([transaction objectForKey:@"key9" inCollection:@"sync"]);
+	}];
+	
+	notifications = [connection1 beginLongLivedReadTransaction];
+	XCTAssertTrue([notifications count] == 1);
+	
+	XCTAssertTrue([connection1 didResetCollection:@"sync" inNotifications:notifications]);
+	XCTAssertTrue([connection1 didResetCollection:@"other" inNotifications:notifications]);
+	XCTAssertTrue([connection1 hasChangeForKey:@"key0" inCollection:@"sync" inNotifications:notifications]);
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key0" inCollection:@"sync"], @(100));
+		XCTAssertEqualObjects([transaction objectForKey:@"key49" inCollection:@"sync"], @(149));
+		XCTAssertNil([transaction objectForKey:@"key9" inCollection:@"sync"]);
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"sync"] == 49);
+	}];
+	
+	[connection1 endLongLivedReadTransaction];
+}
+
+- (void)testChangesetCacheInvalidation
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"test"];
+		}
+	}];
+	
+	// Populate connection1's caches (including the rowid => key cache)
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[transaction enumerateKeysAndObjectsInCollection:@"test" usingBlock:^(NSString *key, id object, BOOL *stop) {}];
+	}];
+	
+	// A few removals (fewer than the cached entries), including a key that gets set again
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"key0" inCollection:@"test"];
+		[transaction removeObjectForKey:@"key1" inCollection:@"test"];
+		[transaction setObject:@(1001) forKey:@"key1" inCollection:@"test"];
+		[transaction setObject:@(1002) forKey:@"key2" inCollection:@"test"];
+	}];
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNil([transaction objectForKey:@"key0" inCollection:@"test"]);
+		XCTAssertEqualObjects([transaction objectForKey:@"key1" inCollection:@"test"], @(1001));
+		XCTAssertEqualObjects([transaction objectForKey:@"key2" inCollection:@"test"], @(1002));
+		XCTAssertEqualObjects([transaction objectForKey:@"key3" inCollection:@"test"], @(3));
+	}];
+	
+	// Lots of removals (more than the cached entries)
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 1; i < 100; i++)
+		{
+			[transaction removeObjectForKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"test"];
+		}
+		[transaction setObject:@"new" forKey:@"key50" inCollection:@"test"];
+	}];
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"test"] == 1);
+		XCTAssertNil([transaction objectForKey:@"key1" inCollection:@"test"]);
+		XCTAssertEqualObjects([transaction objectForKey:@"key50" inCollection:@"test"], @"new");
+		
+		__block NSUInteger count = 0;
+		[transaction enumerateKeysAndObjectsInCollection:@"test" usingBlock:^(NSString *key, id object, BOOL *stop) {
+			
+			XCTAssertEqualObjects(key, @"key50");
+			XCTAssertEqualObjects(object, @"new");
+			count++;
+		}];
+		XCTAssertTrue(count == 1);
+	}];
+}
+
+- (void)testChangesetBacklogFlush
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	connection1.changesetBacklogFlushThreshold = 10;
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@(0) forKey:@"key" inCollection:@"test"];
+		[transaction setObject:@"unchanged" forKey:@"other" inCollection:@"test"];
+	}];
+	
+	[connection1 beginLongLivedReadTransaction];
+	
+	// Populate connection1's cache
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(0));
+		XCTAssertEqualObjects([transaction objectForKey:@"other" inCollection:@"test"], @"unchanged");
+	}];
+	
+	// More commits than the threshold
+	
+	for (int i = 1; i <= 20; i++)
+	{
+		[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:@"key" inCollection:@"test"];
+		}];
+	}
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"other" inCollection:@"test"];
+	}];
+	
+	NSArray *notifications = [connection1 beginLongLivedReadTransaction];
+	XCTAssertTrue([notifications count] == 21);
+	
+	XCTAssertTrue([connection1 hasChangeForKey:@"key" inCollection:@"test" inNotifications:notifications]);
+	XCTAssertTrue([connection1 hasChangeForKey:@"other" inCollection:@"test" inNotifications:notifications]);
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(20));
+		XCTAssertNil([transaction objectForKey:@"other" inCollection:@"test"]);
+	}];
+	
+	[connection1 endLongLivedReadTransaction];
+	
+	// Without a long-lived read transaction, changesets are processed as they arrive
+	
+	for (int i = 21; i <= 40; i++)
+	{
+		[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:@"key" inCollection:@"test"];
+		}];
+	}
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @(40));
+	}];
+}
+
+- (void)testChangeSummary
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"a" forKey:@"key1" inCollection:@"test"];
+		[transaction setObject:@"b" forKey:@"key2" inCollection:@"test"];
+		[transaction setObject:@"c" forKey:@"key" inCollection:@"cleared"];
+	}];
+	
+	[connection1 beginLongLivedReadTransaction];
+	
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"a2" forKey:@"key1" inCollection:@"test"];
+	}];
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction replaceMetadata:@"meta" forKey:@"key2" inCollection:@"test"];
+		[transaction removeObjectForKey:@"key1" inCollection:@"test"];
+	}];
+	[connection2 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeAllObjectsInCollection:@"cleared"];
+	}];
+	
+	NSArray *notifications = [connection1 beginLongLivedReadTransaction];
+	XCTAssertTrue([notifications count] == 3);
+	
+	YapDatabaseChangeSummary *summary = [[YapDatabaseChangeSummary alloc] initWithNotifications:notifications];
+	
+	XCTAssertTrue([summary hasChangeForKey:@"key1" inCollection:@"test"]);
+	XCTAssertTrue([summary hasObjectChangeForKey:@"key1" inCollection:@"test"]);
+	XCTAssertTrue([summary hasMetadataChangeForKey:@"key1" inCollection:@"test"]); // removed
+	XCTAssertFalse([summary hasObjectChangeForKey:@"key2" inCollection:@"test"]);
+	XCTAssertTrue([summary hasMetadataChangeForKey:@"key2" inCollection:@"test"]);
+	XCTAssertFalse([summary hasChangeForKey:@"key3" inCollection:@"test"]);
+	
+	XCTAssertTrue([summary hasChangeForAnyKeys:[NSSet setWithObjects:@"key2", @"key3", nil] inCollection:@"test"]);
+	XCTAssertFalse([summary hasObjectChangeForAnyKeys:[NSSet setWithObjects:@"key2", @"key3", nil] inCollection:@"test"]);
+	
+	XCTAssertTrue([summary hasChangeForKey:@"anything" inCollection:@"cleared"]);
+	XCTAssertTrue([summary didClearCollection:@"cleared"]);
+	XCTAssertFalse([summary didClearCollection:@"test"]);
+	XCTAssertFalse([summary hasChangeForCollection:@"other"]);
+	XCTAssertFalse(summary.didClearAllCollections);
+	
+	NSMutableSet *changedKeys = [NSMutableSet set];
+	[summary enumerateChangedKeysInCollection:@"test" usingBlock:^(NSString *key, BOOL *stop) {
+		
+		XCTAssertFalse([changedKeys containsObject:key]);
+		[changedKeys addObject:key];
+	}];
+	XCTAssertEqualObjects(changedKeys, ([NSSet setWithObjects:@"key1", @"key2", nil]));
+	
+	// The connection methods report the same results (and reuse the summary)
+	
+	XCTAssertTrue([connection1 changeSummaryForNotifications:notifications] ==
+	              [connection1 changeSummaryForNotifications:notifications]);
+	
+	XCTAssertTrue([connection1 hasChangeForKey:@"key1" inCollection:@"test" inNotifications:notifications]);
+	XCTAssertFalse([connection1 hasObjectChangeForKey:@"key2" inCollection:@"test" inNotifications:notifications]);
+	XCTAssertFalse([connection1 hasChangeForKey:@"key3" inCollection:@"test" inNotifications:notifications]);
+	XCTAssertTrue([connection1 didClearCollection:@"cleared" inNotifications:notifications]);
+	
+	NSArray *subset = [notifications subarrayWithRange:NSMakeRange(0, 1)];
+	XCTAssertFalse([connection1 hasChangeForKey:@"key2" inCollection:@"test" inNotifications:subset]);
+	XCTAssertTrue([connection1 hasChangeForKey:@"key2" inCollection:@"test" inNotifications:notifications]);
+	
+	[connection1 endLongLivedReadTransaction];
+}
+
+- (void)testCoalescedModifiedNotification
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	XCTAssertTrue(database.modifiedNotificationCoalescingInterval == 0.0);
+	
+	database.modifiedNotificationCoalescingInterval = 0.1;
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	__block NSUInteger coalescedCount = 0;
+	__block NSArray *coalesced = nil;
+	
+	[self expectationForNotification:YapDatabaseModifiedCoalescedNotification
+	                          object:database
+	                         handler:^BOOL(NSNotification *notification)
+	{
+		coalescedCount++;
+		coalesced = notification.userInfo[YapDatabaseModifiedNotificationsKey];
+		return YES;
+	}];
+	
+	for (int i = 0; i < 10; i++)
+	{
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(i) forKey:@"key" inCollection:@"test"];
+		}];
+	}
+	
+	[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+	
+	// The commits were all made before the main thread was able to deliver any of the notifications.
+	// So they all end up in the same batch.
+	
+	XCTAssertTrue(coalescedCount == 1);
+	XCTAssertTrue([coalesced count] == 10);
+	
+	uint64_t lastSnapshot = 0;
+	for (NSNotification *notification in coalesced)
+	{
+		XCTAssertEqualObjects(notification.name, YapDatabaseModifiedNotification);
+		
+		uint64_t snapshot = [notification.userInfo[YapDatabaseSnapshotKey] unsignedLongLongValue];
+		XCTAssertTrue(snapshot > lastSnapshot);
+		lastSnapshot = snapshot;
+	}
+}
+
+- (void)testWritePriority
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *backgroundConnection = [database newConnection];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	backgroundConnection.writePriority = YapDatabaseWritePriorityBackground;
+	XCTAssertTrue(connection.writePriority == YapDatabaseWritePriorityDefault);
+	
+	dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+	dispatch_queue_t completionQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	__block int chunk = 0;
+	__block BOOL didYield = NO;
+	__block id valueSeenInSecondChunk = nil;
+	
+	[backgroundConnection asyncIncrementalReadWriteWithBlock:^BOOL (YapDatabaseReadWriteTransaction *transaction) {
+		
+		chunk++;
+		[transaction setObject:@(chunk) forKey:@"chunk" inCollection:@"background"];
+		
+		if (chunk == 1)
+		{
+			// A user-initiated write arrives while we're busy
+			
+			[connection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *urgentTransaction) {
+				
+				[urgentTransaction setObject:@"urgent" forKey:@"key" inCollection:@"default"];
+			}];
+			
+			NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+			while (![transaction shouldYield] && ([timeout timeIntervalSinceNow] > 0))
+			{
+				[NSThread sleepForTimeInterval:0.001];
+			}
+			
+			didYield = [transaction shouldYield];
+			return NO;
+		}
+		else
+		{
+			// The waiting transaction went first
+			
+			valueSeenInSecondChunk = [transaction objectForKey:@"key" inCollection:@"default"];
+			return YES;
+		}
+		
+	} completionQueue:completionQueue completionBlock:^{
+		
+		dispatch_semaphore_signal(semaphore);
+	}];
+	
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+	
+	XCTAssertTrue(didYield);
+	XCTAssertTrue(chunk == 2);
+	XCTAssertEqualObjects(valueSeenInSecondChunk, @"urgent");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"chunk" inCollection:@"background"], @(2));
+	}];
+}
+
+- (void)testChunkedReadWrite
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSMutableArray *items = [NSMutableArray arrayWithCapacity:1000];
+	for (int i = 0; i < 1000; i++)
+	{
+		[items addObject:@(i)];
+	}
+	
+	uint64_t snapshotBefore = database.snapshot;
+	
+	dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+	
+	NSProgress *progress =
+	  [connection asyncReadWriteWithItems:[items objectEnumerator]
+	                        chunkDuration:0.0001
+	                           usingBlock:^(YapDatabaseReadWriteTransaction *transaction, id item)
+	{
+		[NSThread sleepForTimeInterval:0.00005];
+		[transaction setObject:item forKey:[item description] inCollection:@"items"];
+		
+	} completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0) completionBlock:^{
+		
+		dispatch_semaphore_signal(semaphore);
+	}];
+	
+	XCTAssertNotNil(progress);
+	
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+	
+	XCTAssertTrue(progress.completedUnitCount == 1000);
+	XCTAssertTrue(progress.totalUnitCount == 1000);
+	
+	// Each chunk is committed as its own transaction
+	XCTAssertTrue(database.snapshot > (snapshotBefore + 1));
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"items"] == 1000);
+		XCTAssertEqualObjects([transaction objectForKey:@"999" inCollection:@"items"], @(999));
+	}];
+	
+	// Cancelling stops the work
+	
+	progress = [connection asyncReadWriteWithItems:[items objectEnumerator]
+	                                 chunkDuration:0
+	                                    usingBlock:^(YapDatabaseReadWriteTransaction *transaction, id item)
+	{
+		[NSThread sleepForTimeInterval:0.001];
+		[transaction removeObjectForKey:[item description] inCollection:@"items"];
+		
+	} completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0) completionBlock:^{
+		
+		dispatch_semaphore_signal(semaphore);
+	}];
+	
+	[progress cancel];
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+	
+	XCTAssertTrue(progress.completedUnitCount < 1000);
+}
+
+- (void)testIncrementalVacuum
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.pragmaAutoVacuum = YapDatabasePragmaAutoVacuum_Incremental;
+	options.incrementalVacuumPageBudget = 0; // we drive the steps manually
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	XCTAssertEqualObjects([connection pragmaAutoVacuum], @"INCREMENTAL");
+	
+	NSMutableData *data = [NSMutableData dataWithLength:(1024 * 8)];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 200; i++)
+		{
+			[transaction setObject:data forKey:[NSString stringWithFormat:@"%d", i] inCollection:nil];
+		}
+	}];
+	
+	NSUInteger pageCount = [connection pragmaPageCount];
+	XCTAssertTrue([connection pragmaFreelistCount] == 0);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeAllObjectsInAllCollections];
+	}];
+	
+	// The pages are kept in the freelist (the file isn't truncated on commit)
+	
+	NSUInteger freelistCount = [connection pragmaFreelistCount];
+	XCTAssertTrue(freelistCount > 10);
+	XCTAssertTrue([connection pragmaPageCount] == pageCount);
+	
+	NSUInteger reclaimed = [connection incrementalVacuumWithPageBudget:10];
+	
+	XCTAssertTrue(reclaimed == 10);
+	XCTAssertTrue([connection pragmaFreelistCount] == (freelistCount - 10));
+	XCTAssertTrue([connection pragmaPageCount] <= (pageCount - 10));
+	
+	// A budget of zero reclaims everything
+	
+	reclaimed = [connection incrementalVacuumWithPageBudget:0];
+	
+	XCTAssertTrue(reclaimed == (freelistCount - 10));
+	XCTAssertTrue([connection pragmaFreelistCount] == 0);
+}
+
+- (void)testIncrementalBackup
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSString *fullBackupPath = [databasePath stringByAppendingString:@".backup0"];
+	NSString *deltaBackupPath = [databasePath stringByAppendingString:@".backup1"];
+	NSString *rebuiltPath = [databasePath stringByAppendingString:@".rebuilt"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableIncrementalBackup = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 1000; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%d", i];
+			[transaction setObject:[NSMutableData dataWithLength:512] forKey:key inCollection:nil];
+		}
+	}];
+	
+	NSError *error = [connection incrementalBackupToPath:fullBackupPath];
+	if ([[error localizedDescription] containsString:@"SQLITE_ENABLE_DBPAGE_VTAB"])
+	{
+		NSLog(@"Skipping %@: sqlite_dbpage isn't available", NSStringFromSelector(_cmd));
+		return;
+	}
+	XCTAssertNil(error);
+	
+	YapDatabaseIncrementalBackup *fullBackup = [[YapDatabaseIncrementalBackup alloc] initWithPath:fullBackupPath];
+	
+	XCTAssertTrue(fullBackup.isFullBackup);
+	XCTAssertTrue(fullBackup.pageCount == fullBackup.databasePageCount);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"changed" forKey:@"500" inCollection:nil];
+	}];
+	
+	error = [connection incrementalBackupToPath:deltaBackupPath];
+	XCTAssertNil(error);
+	
+	YapDatabaseIncrementalBackup *deltaBackup = [[YapDatabaseIncrementalBackup alloc] initWithPath:deltaBackupPath];
+	
+	XCTAssertFalse(deltaBackup.isFullBackup);
+	XCTAssertEqualObjects(deltaBackup.parentBackupId, fullBackup.backupId);
+	XCTAssertTrue(deltaBackup.pageCount > 0);
+	XCTAssertTrue(deltaBackup.pageCount < (fullBackup.pageCount / 4));
+	
+	// Out of order chains are rejected
+	
+	error = [YapDatabaseIncrementalBackup rebuildDatabaseAtPath:rebuiltPath
+	                                         fromBackupsAtPaths:@[ deltaBackupPath, fullBackupPath ]];
+	XCTAssertNotNil(error);
+	
+	error = [YapDatabaseIncrementalBackup rebuildDatabaseAtPath:rebuiltPath
+	                                         fromBackupsAtPaths:@[ fullBackupPath, deltaBackupPath ]];
+	XCTAssertNil(error);
+	
+	YapDatabase *rebuiltDatabase = [[YapDatabase alloc] initWithPath:rebuiltPath];
+	YapDatabaseConnection *rebuiltConnection = [rebuiltDatabase newConnection];
+	
+	[rebuiltConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:nil] == 1000);
+		XCTAssertEqualObjects([transaction objectForKey:@"500" inCollection:nil], @"changed");
+	}];
+}
+
+- (void)testReadOnlyImmutable
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSString *prebuiltPath = [databasePath stringByAppendingString:@".prebuilt"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:prebuiltPath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%d", i];
+			[transaction setObject:key forKey:key inCollection:@"prebuilt"];
+		}
+	}];
+	
+	// The backup is a complete database file (without a WAL)
+	
+	XCTAssertNil([connection backupToPath:prebuiltPath]);
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.readOnlyImmutable = YES;
+	
+	// The file is never created
+	
+	NSString *missingPath = [databasePath stringByAppendingString:@".missing"];
+	[[NSFileManager defaultManager] removeItemAtPath:missingPath error:NULL];
+	
+	XCTAssertNil([[YapDatabase alloc] initWithPath:missingPath options:options]);
+	XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:missingPath]);
+	
+	YapDatabase *prebuiltDatabase = [[YapDatabase alloc] initWithPath:prebuiltPath options:options];
+	
+	XCTAssertNotNil(prebuiltDatabase, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [prebuiltDatabase newConnection];
+	YapDatabaseConnection *connection2 = [prebuiltDatabase newConnection];
+	
+	dispatch_group_t group = dispatch_group_create();
+	
+	for (YapDatabaseConnection *readConnection in @[ connection1, connection2 ])
+	{
+		dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+			
+			[readConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+				
+				XCTAssertTrue([transaction numberOfKeysInCollection:@"prebuilt"] == 100);
+				XCTAssertEqualObjects([transaction objectForKey:@"42" inCollection:@"prebuilt"], @"42");
+			}];
+		});
+	}
+	
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	
+	// Nothing is written, not even a WAL file
+	
+	XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[prebuiltPath stringByAppendingString:@"-wal"]]);
+}
+
+- (void)testShardedDatabase
+{
+	NSString *mainPath = [self databasePath:@"testShardedDatabase-main"];
+	NSString *messagesPath = [self databasePath:@"testShardedDatabase-messages"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:mainPath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:messagesPath error:NULL];
+	
+	NSDictionary *shardPaths = @{ @"main": mainPath, @"messages": messagesPath };
+	
+	// Mapping a collection to an unknown shard fails
+	
+	XCTAssertNil([[YapShardedDatabase alloc] initWithShardPaths:shardPaths
+	                                           collectionShards:@{ @"messages": @"unknown" }
+	                                               defaultShard:@"main"
+	                                                    options:nil]);
+	
+	YapShardedDatabase *database = [[YapShardedDatabase alloc] initWithShardPaths:shardPaths
+	                                                             collectionShards:@{ @"messages": @"messages" }
+	                                                                 defaultShard:@"main"
+	                                                                      options:nil];
+	
+	XCTAssertNotNil(database, @"Oops");
+	XCTAssertEqualObjects([database shardForCollection:@"messages"], @"messages");
+	XCTAssertEqualObjects([database shardForCollection:@"contacts"], @"main");
+	XCTAssertEqualObjects([database shardForCollection:nil], @"main");
+	
+	YapShardedDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteForCollections:@[ @"messages", @"contacts" ]
+	                          withBlock:^(YapShardedReadWriteTransaction *transaction)
+	{
+		XCTAssertEqualObjects(transaction.shardNames, (@[ @"main", @"messages" ]));
+		
+		[[transaction transactionForCollection:@"messages"] setObject:@"hello" forKey:@"m1" inCollection:@"messages"];
+		[[transaction transactionForCollection:@"contacts"] setObject:@"alice" forKey:@"c1" inCollection:@"contacts"];
+	}];
+	
+	// Each collection is stored in its own shard
+	
+	[[[database databaseForShard:@"messages"] newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"m1" inCollection:@"messages"], @"hello");
+		XCTAssertTrue([transaction numberOfKeysInAllCollections] == 1);
+	}];
+	
+	[[[database databaseForShard:@"main"] newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"c1" inCollection:@"contacts"], @"alice");
+		XCTAssertTrue([transaction numberOfKeysInAllCollections] == 1);
+	}];
+	
+	// Rolling back a single shard rolls back every shard
+	
+	[connection readWriteForCollections:@[ @"messages", @"contacts" ]
+	                          withBlock:^(YapShardedReadWriteTransaction *transaction)
+	{
+		[[transaction transactionForCollection:@"messages"] setObject:@"bye" forKey:@"m2" inCollection:@"messages"];
+		[[transaction transactionForCollection:@"contacts"] setObject:@"bob" forKey:@"c2" inCollection:@"contacts"];
+		
+		[[transaction transactionForShard:@"main"] rollback];
+	}];
+	
+	[connection readForCollection:@"messages" withBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNil([transaction objectForKey:@"m2" inCollection:@"messages"]);
+	}];
+	
+	[connection readForCollection:@"contacts" withBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNil([transaction objectForKey:@"c2" inCollection:@"contacts"]);
+	}];
+	
+	// Writes to different shards run in parallel
+	
+	dispatch_semaphore_t messagesWriting = dispatch_semaphore_create(0);
+	dispatch_semaphore_t contactsWritten = dispatch_semaphore_create(0);
+	
+	YapShardedDatabaseConnection *connection2 = [database newConnection];
+	
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		
+		[connection2 readWriteForCollection:@"messages" withBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@"waiting" forKey:@"m3" inCollection:@"messages"];
+			
+			dispatch_semaphore_signal(messagesWriting);
+			dispatch_semaphore_wait(contactsWritten, DISPATCH_TIME_FOREVER);
+		}];
+	});
+	
+	dispatch_semaphore_wait(messagesWriting, DISPATCH_TIME_FOREVER);
+	
+	[connection readWriteForCollection:@"contacts" withBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"carol" forKey:@"c3" inCollection:@"contacts"];
+	}];
+	
+	dispatch_semaphore_signal(contactsWritten);
+	
+	[connection2 readForCollection:@"messages" withBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"m3" inCollection:@"messages"], @"waiting");
+	}];
+}
+
+- (void)testExpiration
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.expiringCollections = [NSSet setWithObject:@"cache"];
+	options.expirationSweepInterval = 0; // Sweep manually
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSDate *past = [NSDate dateWithTimeIntervalSinceNow:-60];
+	NSDate *future = [NSDate dateWithTimeIntervalSinceNow:3600];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"expired" forKey:@"a" inCollection:@"cache" withMetadata:@"meta" expiration:past];
+		[transaction setObject:@"fresh" forKey:@"b" inCollection:@"cache" withMetadata:nil expiration:future];
+		[transaction setObject:@"forever" forKey:@"c" inCollection:@"cache"];
+		
+		// Only the expiringCollections support expiration
+		
+		[transaction setObject:@"other" forKey:@"a" inCollection:@"other"];
+		[transaction setExpiration:past forKey:@"a" inCollection:@"other"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		// Expired objects are treated as missing, even though they haven't been removed yet
+		
+		XCTAssertNil([transaction objectForKey:@"a" inCollection:@"cache"]);
+		XCTAssertNil([transaction metadataForKey:@"a" inCollection:@"cache"]);
+		XCTAssertFalse([transaction hasObjectForKey:@"a" inCollection:@"cache"]);
+		XCTAssertFalse([transaction getObject:NULL metadata:NULL forKey:@"a" inCollection:@"cache"]);
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"cache"] == 3);
+		
+		XCTAssertNotNil([transaction expirationForKey:@"a" inCollection:@"cache"]);
+		XCTAssertNil([transaction expirationForKey:@"c" inCollection:@"cache"]);
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"b" inCollection:@"cache"], @"fresh");
+		XCTAssertEqualObjects([transaction objectForKey:@"c" inCollection:@"cache"], @"forever");
+		XCTAssertEqualObjects([transaction objectForKey:@"a" inCollection:@"other"], @"other");
+		
+		NSDictionary *objects = nil;
+		[transaction getObjects:&objects metadata:NULL forKeys:@[ @"a", @"b", @"c" ] inCollection:@"cache"];
+		
+		XCTAssertEqualObjects([NSSet setWithArray:[objects allKeys]], ([NSSet setWithObjects:@"b", @"c", nil]));
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		XCTAssertTrue([transaction removeExpiredObjectsWithLimit:100] == 1);
+		XCTAssertTrue([transaction removeExpiredObjectsWithLimit:100] == 0);
+		
+		// Removing an object removes its expiration
+		
+		[transaction removeObjectForKey:@"b" inCollection:@"cache"];
+		[transaction setObject:@"fresh" forKey:@"b" inCollection:@"cache"];
+		
+		XCTAssertNil([transaction expirationForKey:@"b" inCollection:@"cache"]);
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"cache"] == 2);
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"other"] == 1);
+	}];
+}
+
+- (void)testConnectionPrewarm
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.connectionPrewarmCount = 3;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	// Give the background queues a chance to fill the pool
+	[NSThread sleepForTimeInterval:0.25];
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	YapDatabaseConnection *connection3 = [database newConnection];
+	YapDatabaseConnection *connection4 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"value" forKey:@"key" inCollection:nil];
+	}];
+	
+	for (YapDatabaseConnection *connection in @[ connection1, connection2, connection3, connection4 ])
+	{
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:nil], @"value");
+		}];
+	}
+	
+	[connection3 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"value3" forKey:@"key" inCollection:nil];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:nil], @"value3");
+	}];
+}
+
+- (void)testFastOpen
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableFastOpen = YES;
+	
+	// Create the database (slow path), which writes the fingerprint
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+		XCTAssertNotNil(database);
+		
+		[[database newConnection] readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@"a1" forKey:@"1" inCollection:@"a" withMetadata:@"m"];
+			[transaction setObject:@"b1" forKey:@"1" inCollection:@"b"];
+		}];
+	}
+	
+	// Re-open the database (fast path)
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+		XCTAssertNotNil(database);
+		
+		YapDatabaseConnection *connection = [database newConnection];
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssert([transaction numberOfCollections] == 2);
+			XCTAssertEqualObjects([transaction objectForKey:@"1" inCollection:@"a"], @"a1");
+			XCTAssertEqualObjects([transaction metadataForKey:@"1" inCollection:@"a"], @"m");
+		}];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@"c1" forKey:@"1" inCollection:@"c"];
+		}];
+	}
+	
+	// Re-open the database with different options.
+	// The fingerprint no longer matches, so the database is upgraded as usual.
+	
+	options.enableCollectionIds = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	[[database newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssert([transaction numberOfCollections] == 3);
+		XCTAssert([transaction numberOfKeysInAllCollections] == 3);
+		XCTAssertEqualObjects([transaction objectForKey:@"1" inCollection:@"c"], @"c1");
+	}];
+}
+
+- (void)testBinaryCodec
+{
+	NSDictionary *plist = @{
+		@"string" : @"hello \u00e9\u00e8",
+		@"int"    : @(-42),
+		@"big"    : @(UINT64_MAX),
+		@"double" : @(3.25),
+		@"bool"   : @YES,
+		@"data"   : [@"abc" dataUsingEncoding:NSUTF8StringEncoding],
+		@"date"   : [NSDate dateWithTimeIntervalSinceReferenceDate:123456.5],
+		@"null"   : [NSNull null],
+		@"array"  : @[ @"hello \u00e9\u00e8", @1, @[ @2 ] ],
+		@"set"    : [NSSet setWithObjects:@"a", @"b", nil],
+		@"url"    : [NSURL URLWithString:@"https://github.com/yapstudios/YapDatabase"], // NSCoding
+	};
+	
+	NSData *data = [YapDatabaseBinaryCodec dataWithObject:plist];
+	XCTAssertTrue([YapDatabaseBinaryCodec isBinaryCodecData:data]);
+	XCTAssertEqualObjects([YapDatabaseBinaryCodec objectWithData:data], plist);
+	XCTAssert([[YapDatabaseBinaryCodec objectWithData:data][@"bool"] isEqual:@YES]);
+	
+	// Truncated data must fail gracefully
+	for (NSUInteger length = 0; length < data.length; length++)
+	{
+		XCTAssertNoThrow([YapDatabaseBinaryCodec objectWithBytes:data.bytes length:length]);
+	}
+	
+	// Objects that adopt YapDatabaseBinaryCoding
+	
+	TestBinaryCodingObject *child = [[TestBinaryCodingObject alloc] init];
+	child.name = @"child";
+	
+	TestBinaryCodingObject *parent = [[TestBinaryCodingObject alloc] init];
+	parent.name = @"parent";
+	parent.children = @[ child, child ];
+	parent.count = INT64_MIN;
+	parent.flag = YES;
+	
+	TestBinaryCodingObject *decoded =
+	  [YapDatabaseBinaryCodec objectWithData:[YapDatabaseBinaryCodec dataWithObject:parent]];
+	
+	XCTAssertEqualObjects(decoded.name, @"parent");
+	XCTAssert(decoded.count == INT64_MIN);
+	XCTAssert(decoded.flag == YES);
+	XCTAssert(decoded.children.count == 2);
+	XCTAssertEqualObjects([decoded.children[1] name], @"child");
+	XCTAssert([decoded.children[1] flag] == NO);
+	
+	// Cycles can't be encoded
+	
+	NSMutableArray *cycle = [NSMutableArray array];
+	[cycle addObject:cycle];
+	XCTAssertThrows([YapDatabaseBinaryCodec dataWithObject:cycle]);
+	
+	// Switch an existing database from the defaultSerializer
+	
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		
+		[[database newConnection] readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:plist forKey:@"legacy" inCollection:nil];
+		}];
+	}
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:[YapDatabaseBinaryCodec serializer]
+	                                             deserializer:[YapDatabaseBinaryCodec deserializer]
+	                                                  options:nil];
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.objectCacheEnabled = NO;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:parent forKey:@"binary" inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"legacy" inCollection:nil], plist);
+		XCTAssertEqualObjects([[transaction objectForKey:@"binary" inCollection:nil] name], @"parent");
+	}];
+}
+
+- (void)testBinaryCodecFieldAccess
+{
+	TestBinaryCodingObject *child = [[TestBinaryCodingObject alloc] init];
+	child.name = @"child";
+	
+	TestBinaryCodingObject *object = [[TestBinaryCodingObject alloc] init];
+	object.name = @"parent";
+	object.children = @[ child ];
+	object.count = 42;
+	
+	NSData *data = [YapDatabaseBinaryCodec dataWithObject:object];
+	id value = nil;
+	
+	XCTAssertTrue([YapDatabaseBinaryCodec getValue:&value forField:@"name" inData:data]);
+	XCTAssertEqualObjects(value, @"parent");
+	
+	XCTAssertTrue([YapDatabaseBinaryCodec getValue:&value forField:@"count" inData:data]);
+	XCTAssertEqualObjects(value, @42);
+	
+	XCTAssertTrue([YapDatabaseBinaryCodec getValue:&value forField:@"children" inData:data]);
+	XCTAssertEqualObjects([[value firstObject] name], @"child");
+	
+	XCTAssertTrue([YapDatabaseBinaryCodec getValue:&value forField:@"missing" inData:data]);
+	XCTAssertNil(value);
+	
+	data = [YapDatabaseBinaryCodec dataWithObject:@{ @"date": [NSDate dateWithTimeIntervalSinceReferenceDate:1] }];
+	XCTAssertTrue([YapDatabaseBinaryCodec getValue:&value forField:@"date" inData:data]);
+	XCTAssertEqualObjects(value, [NSDate dateWithTimeIntervalSinceReferenceDate:1]);
+	
+	data = [NSKeyedArchiver archivedDataWithRootObject:@{ @"date": [NSDate date] }];
+	XCTAssertFalse([YapDatabaseBinaryCodec getValue:&value forField:@"date" inData:data]);
+	
+	// Via the transaction
+	
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:[YapDatabaseBinaryCodec serializer]
+	                                             deserializer:[YapDatabaseBinaryCodec deserializer]
+	                                                  options:nil];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:object forKey:@"object" inCollection:@"test"];
+		[transaction setObject:@{ @"count": @7 } forKey:@"dict" inCollection:@"test"];
+	}];
+	
+	[connection flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_All];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction valueForField:@"name" forKey:@"object" inCollection:@"test"], @"parent");
+		XCTAssertEqualObjects([transaction valueForField:@"count" forKey:@"dict" inCollection:@"test"], @7);
+		XCTAssertNil([transaction valueForField:@"name" forKey:@"missing" inCollection:@"test"]);
+	}];
+}
+
+- (void)testNativeMetadata
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.nativeMetadataTypes = @{
+		@"scores" : @(YapDatabaseNativeMetadataType_Integer),
+		@"dates"  : @(YapDatabaseNativeMetadataType_Date)
+	};
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	connection.objectCacheEnabled = NO;
+	connection.metadataCacheEnabled = NO;
+	
+	NSDate *date = [NSDate dateWithTimeIntervalSinceReferenceDate:1000];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"a" forKey:@"a" inCollection:@"scores" withMetadata:@(1)];
+		[transaction setObject:@"b" forKey:@"b" inCollection:@"scores" withMetadata:@(5)];
+		[transaction setObject:@"c" forKey:@"c" inCollection:@"scores" withMetadata:@{ @"not": @"native" }];
+		[transaction setObject:@"d" forKey:@"d" inCollection:@"scores" withMetadata:@(3)];
+		
+		[transaction setObject:@"now" forKey:@"now" inCollection:@"dates" withMetadata:date];
+		
+		[transaction replaceMetadata:@(10) forKey:@"a" inCollection:@"scores"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction metadataForKey:@"a" inCollection:@"scores"], @(10));
+		XCTAssertEqualObjects([transaction metadataForKey:@"b" inCollection:@"scores"], @(5));
+		XCTAssertEqualObjects([transaction metadataForKey:@"c" inCollection:@"scores"], @{ @"not": @"native" });
+		XCTAssertEqualObjects([transaction metadataForKey:@"now" inCollection:@"dates"], date);
+		
+		XCTAssertNotNil([transaction serializedMetadataForKey:@"b" inCollection:@"scores"]);
+		
+		NSMutableArray *keys = [NSMutableArray array];
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE metadata >= ? ORDER BY metadata", @(3)];
+		
+		[transaction enumerateKeysInCollection:@"scores" matchingMetadataQuery:query usingBlock:^(NSString *key, BOOL *stop) {
+			[keys addObject:key];
+		}];
+		
+		XCTAssertEqualObjects(keys, (@[ @"d", @"b", @"a" ]));
+		
+		[keys removeAllObjects];
+		query = [YapDatabaseQuery queryWithFormat:@"WHERE metadata <= ?", date];
+		
+		[transaction enumerateKeysInCollection:@"dates" matchingMetadataQuery:query usingBlock:^(NSString *key, BOOL *stop) {
+			[keys addObject:key];
+		}];
+		
+		XCTAssertEqualObjects(keys, (@[ @"now" ]));
+	}];
+}
+
+- (void)testCollectionKeyInterning
+{
+	NSString *collection1 = [[NSMutableString stringWithString:@"a rather long collection name"] copy];
+	NSString *collection2 = [[NSMutableString stringWithString:@"a rather long collection name"] copy];
+	
+	YapCollectionKey *ck1 = YapCollectionKeyCreate(collection1, @"key");
+	YapCollectionKey *ck2 = YapCollectionKeyCreate(collection2, [@"k" stringByAppendingString:@"ey"]);
+	YapCollectionKey *ck3 = YapCollectionKeyCreate(@"another collection name", @"key");
+	
+	XCTAssertTrue(ck1.collection == ck2.collection, @"Collection should be interned");
+	
+	XCTAssertEqualObjects(ck1, ck2);
+	XCTAssertEqual([ck1 hash], [ck2 hash]);
+	XCTAssertTrue(YapCollectionKeyEqual(ck1, ck2));
+	
+	XCTAssertNotEqualObjects(ck1, ck3);
+	XCTAssertFalse([ck1 isEqualToCollectionKey:ck3]);
+	
+	YapCollectionKey *ck4 = YapCollectionKeyCreate(nil, @"key");
+	XCTAssertEqualObjects(ck4.collection, @"");
+	XCTAssertEqualObjects(ck4, YapCollectionKeyCreate(@"", @"key"));
+	
+	NSData *data = [NSKeyedArchiver archivedDataWithRootObject:ck1];
+	YapCollectionKey *ck5 = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+	
+	XCTAssertEqualObjects(ck1, ck5);
+	XCTAssertTrue(ck1.collection == ck5.collection, @"Decoded collection should be interned");
+}
+
+- (void)testCollectionIndexes
+{
+	YapCollectionKey *ck1 = YapCollectionKeyCreate(@"allowed", @"key1");
+	YapCollectionKey *ck2 = YapCollectionKeyCreate(@"allowed", @"key2");
+	YapCollectionKey *ck3 = YapCollectionKeyCreate(@"disallowed", @"key1");
+	
+	XCTAssertTrue(ck1.collectionIndex != NSNotFound);
+	XCTAssertTrue(ck1.collectionIndex == ck2.collectionIndex);
+	XCTAssertTrue(ck1.collectionIndex != ck3.collectionIndex);
+	XCTAssertTrue(YapCollectionIndex(@"allowed") == ck1.collectionIndex);
+	
+	YapWhitelistBlacklist *whitelist = [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:@"allowed"]];
+	YapWhitelistBlacklist *blacklist = [[YapWhitelistBlacklist alloc] initWithBlacklist:[NSSet setWithObject:@"allowed"]];
+	
+	__block NSUInteger filterCount = 0;
+	YapWhitelistBlacklist *filter = [[YapWhitelistBlacklist alloc] initWithFilterBlock:^BOOL(id item) {
+		
+		filterCount++;
+		return [item hasPrefix:@"allow"];
+	}];
+	
+	for (int i = 0; i < 2; i++) // the second time around, the results are remembered
+	{
+		XCTAssertTrue([whitelist isAllowedCollectionKey:ck1]);
+		XCTAssertTrue([whitelist isAllowedCollectionKey:ck2]);
+		XCTAssertFalse([whitelist isAllowedCollectionKey:ck3]);
+		
+		XCTAssertFalse([blacklist isAllowedCollectionKey:ck1]);
+		XCTAssertTrue([blacklist isAllowedCollectionKey:ck3]);
+		
+		XCTAssertTrue([filter isAllowedCollectionKey:ck1]);
+		XCTAssertTrue([filter isAllowedCollectionKey:ck2]);
+		XCTAssertFalse([filter isAllowedCollectionKey:ck3]);
+	}
+	
+	XCTAssertTrue(filterCount == 2); // once per collection
+}
+
+- (void)testImmutableObjectSharing
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	connection1.objectPolicy = YapDatabasePolicyContainment;
+	connection2.objectPolicy = YapDatabasePolicyContainment;
+	
+	TestImmutableObject *object1 = [[TestImmutableObject alloc] initWithName:@"first"];
+	TestImmutableObject *object2 = [[TestImmutableObject alloc] initWithName:@"second"];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:object1 forKey:@"immutable" inCollection:nil];
+		[transaction setObject:@"mutable" forKey:@"regular" inCollection:nil];
+	}];
+	
+	// Populate the cache of connection2
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([[transaction objectForKey:@"immutable" inCollection:nil] name], @"first");
+		XCTAssertNotNil([transaction objectForKey:@"regular" inCollection:nil]);
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:object2 forKey:@"immutable" inCollection:nil];
+		[transaction setObject:[NSMutableString stringWithString:@"changed"] forKey:@"regular" inCollection:nil];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		// Passed by reference (no copy, and no deserialization)
+		XCTAssertTrue([transaction objectForKey:@"immutable" inCollection:nil] == object2);
+		
+		// Containment still applies to everything else
+		XCTAssertEqualObjects([transaction objectForKey:@"regular" inCollection:nil], @"changed");
+	}];
+}
+
+- (void)testEnumerateKeysAndHeaders
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.objectHeaderLength = 2;
+	options.objectHeaderExtractor = ^id (NSString *collection, NSString *key, const void *bytes, size_t length) {
+		
+		return [[NSString alloc] initWithBytes:bytes length:length encoding:NSASCIIStringEncoding];
+	};
+	
+	YapDatabaseSerializer serializer = ^NSData *(NSString *collection, NSString *key, id object) {
+		return [object dataUsingEncoding:NSASCIIStringEncoding];
+	};
+	YapDatabaseDeserializer deserializer = ^id (NSString *collection, NSString *key, NSData *data) {
+		return [[NSString alloc] initWithData:data encoding:NSASCIIStringEncoding];
+	};
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:serializer
+	                                             deserializer:deserializer
+	                                                  options:options];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"v1:old" forKey:@"a" inCollection:@"items"];
+		[transaction setObject:@"v2:new" forKey:@"b" inCollection:@"items"];
+		[transaction setObject:@"v"      forKey:@"c" inCollection:@"items"];
+		[transaction setObject:@"v1:old" forKey:@"d" inCollection:@"other"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSMutableDictionary *headers = [NSMutableDictionary dictionary];
+		
+		[transaction enumerateKeysAndHeadersInCollection:@"items" usingBlock:^(NSString *key, id header, BOOL *stop) {
+			headers[key] = header;
+		}];
+		
+		XCTAssertEqualObjects(headers, (@{ @"a": @"v1", @"b": @"v2", @"c": @"v" }));
+	}];
+}
+
+- (void)testContentHashedCollections
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.contentHashedCollections = [NSSet setWithObject:@"synced"];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"key1" inCollection:@"synced" withMetadata:@"metadata"];
+		[transaction setObject:@"object" forKey:@"key2" inCollection:@"synced"];
+		[transaction setObject:@"object" forKey:@"key3" inCollection:@"other"];
+	}];
+	
+	[connection2 beginLongLivedReadTransaction];
+	
+	// Identical writes within the hashed collection are skipped (singly & in bulk).
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"key1" inCollection:@"synced" withMetadata:@"metadata"];
+		[transaction setObjects:@[ @"object", @"object" ]
+		                forKeys:@[ @"key1", @"key2" ]
+		           inCollection:@"synced"
+		           withMetadata:@[ @"metadata", [NSNull null] ]];
+	}];
+	
+	NSArray *notifications = [connection2 beginLongLivedReadTransaction];
+	XCTAssertFalse([connection2 hasChangeForCollection:@"synced" inNotifications:notifications]);
+	
+	// But not in other collections
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"key3" inCollection:@"other"];
+	}];
+	
+	notifications = [connection2 beginLongLivedReadTransaction];
+	XCTAssertTrue([connection2 hasChangeForKey:@"key3" inCollection:@"other" inNotifications:notifications]);
+	
+	// Changes to the object or metadata are written
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"key1" inCollection:@"synced" withMetadata:@"new metadata"];
+		[transaction setObjects:@[ @"new object", @"object" ]
+		                forKeys:@[ @"key2", @"key4" ]
+		           inCollection:@"synced"];
+	}];
+	
+	notifications = [connection2 beginLongLivedReadTransaction];
+	XCTAssertTrue([connection2 hasChangeForKey:@"key1" inCollection:@"synced" inNotifications:notifications]);
+	XCTAssertTrue([connection2 hasChangeForKey:@"key2" inCollection:@"synced" inNotifications:notifications]);
+	XCTAssertTrue([connection2 hasChangeForKey:@"key4" inCollection:@"synced" inNotifications:notifications]);
+	
+	// Any other write forgets the hash, so the same row is written again afterwards
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction replaceObject:@"replaced" forKey:@"key4" inCollection:@"synced"];
+	}];
+	
+	[connection2 beginLongLivedReadTransaction];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object" forKey:@"key4" inCollection:@"synced"];
+	}];
+	
+	notifications = [connection2 beginLongLivedReadTransaction];
+	XCTAssertTrue([connection2 hasChangeForKey:@"key4" inCollection:@"synced" inNotifications:notifications]);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key1" inCollection:@"synced"], @"object");
+		XCTAssertEqualObjects([transaction metadataForKey:@"key1" inCollection:@"synced"], @"new metadata");
+		XCTAssertEqualObjects([transaction objectForKey:@"key2" inCollection:@"synced"], @"new object");
+		XCTAssertEqualObjects([transaction objectForKey:@"key4" inCollection:@"synced"], @"object");
+	}];
+}
+
+- (void)testMultiProcessSharedChangelog
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSString *sharedChangelogPath = [databasePath stringByAppendingString:@"-yapchg"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:sharedChangelogPath error:NULL];
+	
+	yap_shared_changelog *log = yap_shared_changelog_open([sharedChangelogPath UTF8String], true);
+	XCTAssertTrue(log != NULL);
+	
+	size_t capacity = yap_shared_changelog_capacity(log);
+	NSMutableData *buffer = [NSMutableData dataWithLength:capacity];
+	size_t length = 0;
+	
+	const char *summary = "summary";
+	
+	// Not readable until committed
+	
+	yap_shared_changelog_will_commit(log, 5, summary, strlen(summary));
+	XCTAssertFalse(yap_shared_changelog_read(log, 5, [buffer mutableBytes], &length));
+	
+	yap_shared_changelog_did_commit(log, 5, true);
+	XCTAssertTrue(yap_shared_changelog_read(log, 5, [buffer mutableBytes], &length));
+	XCTAssertTrue(length == strlen(summary));
+	XCTAssertTrue(memcmp([buffer bytes], summary, length) == 0);
+	
+	// Only readable for the exact snapshot
+	
+	XCTAssertFalse(yap_shared_changelog_read(log, 4, [buffer mutableBytes], &length));
+	
+	// Overwritten by a later snapshot (in the same slot), whose commit failed
+	
+	yap_shared_changelog_will_commit(log, 5 + 64, summary, strlen(summary));
+	yap_shared_changelog_did_commit(log, 5 + 64, false);
+	
+	XCTAssertFalse(yap_shared_changelog_read(log, 5, [buffer mutableBytes], &length));
+	XCTAssertFalse(yap_shared_changelog_read(log, 5 + 64, [buffer mutableBytes], &length));
+	
+	// Too large
+	
+	NSMutableData *large = [NSMutableData dataWithLength:(capacity + 1)];
+	
+	yap_shared_changelog_will_commit(log, 6, [large bytes], [large length]);
+	yap_shared_changelog_did_commit(log, 6, true);
+	XCTAssertFalse(yap_shared_changelog_read(log, 6, [buffer mutableBytes], &length));
+	
+	yap_shared_changelog_close(&log);
+	XCTAssertTrue(log == NULL);
+	
+	// The database maps the file (and resets it, since the database file is new)
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.enableMultiProcessSupport = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"value" forKey:@"key" inCollection:@"test"];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key" inCollection:@"test"], @"value");
+	}];
+	
+	XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:sharedChangelogPath]);
+}
+
+- (void)testWorkloadTrace
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSString *replayDatabasePath = [self databasePath:[NSStringFromSelector(_cmd) stringByAppendingString:@"-replay"]];
+	NSString *tracePath = [databasePath stringByAppendingString:@".trace"];
+	NSString *corruptTracePath = [databasePath stringByAppendingString:@"-corrupt.trace"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:replayDatabasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:tracePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:corruptTracePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseWorkloadTraceRecorder *recorder = [[YapDatabaseWorkloadTraceRecorder alloc] initWithPath:tracePath];
+	XCTAssertNotNil(recorder);
+	
+	connection.workloadTraceRecorder = recorder;
+	
+	// Record a few transactions
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"object1" forKey:@"key1" inCollection:@"test"];
+		[transaction setObject:@"object2" forKey:@"key2" inCollection:@"test"];
+		[transaction setObject:@"object3" forKey:@"key3" inCollection:@"test" withMetadata:@"metadata3"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([transaction objectForKey:@"key1" inCollection:@"test"], @"object1");
+		XCTAssertNil([transaction objectForKey:@"missing" inCollection:@"test"]);
+		XCTAssertTrue([transaction hasObjectForKey:@"key2" inCollection:@"test"]);
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		__block NSUInteger count = 0;
+		[transaction enumerateKeysInCollection:@"test" usingBlock:^(NSString *key, BOOL *stop) {
+			count++;
+		}];
+		
+		XCTAssertTrue(count == 3);
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"key2" inCollection:@"test"];
+	}];
+	
+	connection.workloadTraceRecorder = nil;
+	
+	// Not recorded
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNil([transaction objectForKey:@"key2" inCollection:@"test"]);
+	}];
+	
+	[recorder close];
+	XCTAssertTrue(recorder.transactionCount == 4);
+	
+	// Load the trace
+	
+	YapDatabaseWorkloadTraceReplay *replay = [[YapDatabaseWorkloadTraceReplay alloc] initWithPath:tracePath];
+	XCTAssertNotNil(replay);
+	
+	XCTAssertTrue(replay.transactionCount == 4);
+	XCTAssertTrue(replay.operationCount == 8);
+	
+	XCTAssertTrue([replay countOfOperation:YapDatabaseWorkloadTraceOperationSetRow] == 3);
+	XCTAssertTrue([replay countOfOperation:YapDatabaseWorkloadTraceOperationGetObject] == 2);
+	XCTAssertTrue([replay countOfOperation:YapDatabaseWorkloadTraceOperationHasKey] == 1);
+	XCTAssertTrue([replay countOfOperation:YapDatabaseWorkloadTraceOperationEnumerate] == 1);
+	XCTAssertTrue([replay countOfOperation:YapDatabaseWorkloadTraceOperationRemove] == 1);
+	XCTAssertTrue([replay countOfOperation:YapDatabaseWorkloadTraceOperationReplaceObject] == 0);
+	
+	// Replay the trace (against a fresh database)
+	
+	YapDatabase *replayDatabase = [[YapDatabase alloc] initWithPath:replayDatabasePath];
+	XCTAssertNotNil(replayDatabase);
+	
+	YapDatabaseWorkloadTraceReplayStatistics *statistics = [replay replayWithDatabase:replayDatabase];
+	
+	XCTAssertTrue(statistics.transactionCount == 4);
+	XCTAssertTrue(statistics.readWriteTransactionCount == 2);
+	XCTAssertTrue(statistics.operationCount == 8);
+	XCTAssertTrue(statistics.maxDuration >= statistics.p50Duration);
+	
+	[[replayDatabase newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([transaction numberOfCollections] == 1);
+		XCTAssertTrue([transaction numberOfKeysInAllCollections] == 2);
+	}];
+	
+	// An empty trace (just the header) is valid
+	
+	NSData *traceData = [NSData dataWithContentsOfFile:tracePath];
+	XCTAssertTrue(traceData.length > 9);
+	
+	[[traceData subdataWithRange:NSMakeRange(0, 9)] writeToFile:corruptTracePath atomically:YES];
+	
+	replay = [[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath];
+	XCTAssertNotNil(replay);
+	XCTAssertTrue(replay.transactionCount == 0);
+	
+	// Truncated traces
+	
+	[[traceData subdataWithRange:NSMakeRange(0, 5)] writeToFile:corruptTracePath atomically:YES];
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath]);
+	
+	[[traceData subdataWithRange:NSMakeRange(0, traceData.length - 1)] writeToFile:corruptTracePath atomically:YES];
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath]);
+	
+	[[traceData subdataWithRange:NSMakeRange(0, 12)] writeToFile:corruptTracePath atomically:YES];
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath]);
+	
+	// Corrupt traces
+	
+	NSMutableData *corruptData = [traceData mutableCopy];
+	((uint8_t *)corruptData.mutableBytes)[0] = 'X'; // magic
+	[corruptData writeToFile:corruptTracePath atomically:YES];
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath]);
+	
+	corruptData = [traceData mutableCopy];
+	((uint8_t *)corruptData.mutableBytes)[8] = 0xFF; // version
+	[corruptData writeToFile:corruptTracePath atomically:YES];
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath]);
+	
+	corruptData = [traceData mutableCopy];
+	((uint8_t *)corruptData.mutableBytes)[9] = 0x7F; // record kind
+	[corruptData writeToFile:corruptTracePath atomically:YES];
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath]);
+	
+	corruptData = [traceData mutableCopy];
+	uint8_t garbage[] = { 0x01, 0x01, 0x00, 0x00, 0x00, 0x01, 0xEE }; // a transaction with an unknown operation
+	[corruptData appendBytes:garbage length:sizeof(garbage)];
+	[corruptData writeToFile:corruptTracePath atomically:YES];
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:corruptTracePath]);
+	
+	XCTAssertNil([[YapDatabaseWorkloadTraceReplay alloc] initWithPath:[tracePath stringByAppendingString:@"-missing"]]);
+}
+
+- (void)testMultiProcessSharedSnapshotEncoding
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSString *sharedSnapshotPath = [databasePath stringByAppendingString:@"-yapshm"];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:sharedSnapshotPath error:NULL];
+	
+	// A zero-filled file (e.g. one that another process has just created) is dirty
+	
+	yap_shared_snapshot *shared = yap_shared_snapshot_open([sharedSnapshotPath UTF8String]);
+	XCTAssertTrue(shared != NULL);
+	
+	uint64_t snapshot = 99;
+	XCTAssertFalse(yap_shared_snapshot_get(shared, &snapshot));
+	
+	// Snapshot zero is a valid (clean) snapshot
+	
+	yap_shared_snapshot_set(shared, 0);
+	XCTAssertTrue(yap_shared_snapshot_get(shared, &snapshot));
+	XCTAssertTrue(snapshot == 0);
+	
+	// Dirty during a commit
+	
+	yap_shared_snapshot_will_commit(shared, 0);
+	XCTAssertFalse(yap_shared_snapshot_get(shared, &snapshot));
+	
+	yap_shared_snapshot_did_commit(shared, 0, 1);
+	XCTAssertTrue(yap_shared_snapshot_get(shared, &snapshot));
+	XCTAssertTrue(snapshot == 1);
+	
+	// A failed commit leaves the value dirty
+	
+	yap_shared_snapshot_will_commit(shared, 1);
+	yap_shared_snapshot_did_commit(shared, 1, 0);
+	XCTAssertFalse(yap_shared_snapshot_get(shared, &snapshot));
+	
+	// A late writer can't overwrite the value stored by a subsequent writer
+	
+	yap_shared_snapshot_set(shared, 5);
+	yap_shared_snapshot_did_commit(shared, 1, 2);
+	XCTAssertTrue(yap_shared_snapshot_get(shared, &snapshot));
+	XCTAssertTrue(snapshot == 5);
+	
+	// The value is shared with other mappings of the file
+	
+	yap_shared_snapshot *shared2 = yap_shared_snapshot_open([sharedSnapshotPath UTF8String]);
+	XCTAssertTrue(shared2 != NULL);
+	XCTAssertTrue(yap_shared_snapshot_get(shared2, &snapshot));
+	XCTAssertTrue(snapshot == 5);
+	
+	yap_shared_snapshot_close(&shared2);
+	yap_shared_snapshot_close(&shared);
+	XCTAssertTrue(shared == NULL);
+}
+
+static NSArray<NSNumber *> *RowidSetToArray(YapRowidSet *set)
+{
+	NSMutableArray<NSNumber *> *result = [NSMutableArray arrayWithCapacity:YapRowidSetCount(set)];
+	
+	YapRowidSetEnumerate(set, ^(int64_t rowid, BOOL __unused *stop) {
+		
+		[result addObject:@(rowid)];
+	});
+	
+	return result;
+}
+
+static NSArray<NSNumber *> *SortedRowids(NSSet<NSNumber *> *set)
+{
+	return [[set allObjects] sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (void)testRowidSet_algebra
+{
+	// A dense range (bitmap containers) & sparse ranges (array containers), in several high 48-bit ranges.
+	
+	YapRowidSet *set1 = YapRowidSetCreate(0);
+	YapRowidSet *set2 = YapRowidSetCreate(0);
+	
+	NSMutableSet<NSNumber *> *expected1 = [NSMutableSet set];
+	NSMutableSet<NSNumber *> *expected2 = [NSMutableSet set];
+	
+	uint64_t seed = 42;
+	
+	for (int i = 0; i < 20000; i++)
+	{
+		seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+		
+		int64_t rowid1 = (int64_t)((seed >> 33) % 30000);   // dense  -> bitmap containers
+		int64_t rowid2 = (int64_t)((seed >> 33) % 3000000); // sparse -> array containers
+		
+		if (i % 2 == 0)
+		{
+			YapRowidSetAdd(set1, rowid1);
+			[expected1 addObject:@(rowid1)];
+			
+			YapRowidSetAdd(set2, rowid2);
+			[expected2 addObject:@(rowid2)];
+		}
+		else
+		{
+			YapRowidSetAdd(set1, rowid2);
+			[expected1 addObject:@(rowid2)];
+			
+			YapRowidSetAdd(set2, rowid1);
+			[expected2 addObject:@(rowid1)];
+		}
+	}
+	
+	XCTAssertTrue(YapRowidSetCount(set1) == [expected1 count]);
+	XCTAssertTrue(YapRowidSetCount(set2) == [expected2 count]);
+	XCTAssertEqualObjects(RowidSetToArray(set1), SortedRowids(expected1));
+	XCTAssertEqualObjects(RowidSetToArray(set2), SortedRowids(expected2));
+	
+	// Union
+	
+	YapRowidSet *unionSet = YapRowidSetCopy(set1);
+	YapRowidSetUnion(unionSet, set2);
+	
+	NSMutableSet<NSNumber *> *expectedUnion = [expected1 mutableCopy];
+	[expectedUnion unionSet:expected2];
+	
+	XCTAssertTrue(YapRowidSetCount(unionSet) == [expectedUnion count]);
+	XCTAssertEqualObjects(RowidSetToArray(unionSet), SortedRowids(expectedUnion));
+	
+	// Intersect
+	
+	YapRowidSet *intersectSet = YapRowidSetCopy(set1);
+	YapRowidSetIntersect(intersectSet, set2);
+	
+	NSMutableSet<NSNumber *> *expectedIntersect = [expected1 mutableCopy];
+	[expectedIntersect intersectSet:expected2];
+	
+	XCTAssertTrue([expectedIntersect count] > 0);
+	XCTAssertTrue(YapRowidSetCount(intersectSet) == [expectedIntersect count]);
+	XCTAssertEqualObjects(RowidSetToArray(intersectSet), SortedRowids(expectedIntersect));
+	
+	// Minus
+	
+	YapRowidSet *minusSet = YapRowidSetCopy(set1);
+	YapRowidSetMinus(minusSet, set2);
+	
+	NSMutableSet<NSNumber *> *expectedMinus = [expected1 mutableCopy];
+	[expectedMinus minusSet:expected2];
+	
+	XCTAssertTrue(YapRowidSetCount(minusSet) == [expectedMinus count]);
+	XCTAssertEqualObjects(RowidSetToArray(minusSet), SortedRowids(expectedMinus));
+	
+	for (NSNumber *number in expectedIntersect)
+	{
+		XCTAssertFalse(YapRowidSetContains(minusSet, [number longLongValue]));
+	}
+	
+	// The operands are unchanged
+	
+	XCTAssertEqualObjects(RowidSetToArray(set1), SortedRowids(expected1));
+	XCTAssertEqualObjects(RowidSetToArray(set2), SortedRowids(expected2));
+	
+	// Empty operands
+	
+	YapRowidSet *empty = YapRowidSetCreate(0);
+	
+	YapRowidSetUnion(empty, set1);
+	XCTAssertEqualObjects(RowidSetToArray(empty), SortedRowids(expected1));
+	
+	YapRowidSetRemoveAll(empty);
+	YapRowidSetIntersect(set2, empty);
+	XCTAssertTrue(YapRowidSetCount(set2) == 0);
+	
+	YapRowidSetMinus(set1, empty);
+	XCTAssertTrue(YapRowidSetCount(set1) == [expected1 count]);
+	
+	YapRowidSetRelease(empty);
+	YapRowidSetRelease(minusSet);
+	YapRowidSetRelease(intersectSet);
+	YapRowidSetRelease(unionSet);
+	YapRowidSetRelease(set2);
+	YapRowidSetRelease(set1);
+}
+
+- (void)testRowidSet_containerBoundaries
+{
+	YapRowidSet *set = YapRowidSetCreate(0);
+	
+	// 4096 values fit in an array container
+	
+	for (int64_t rowid = 0; rowid < 4096 * 2; rowid += 2)
+	{
+		YapRowidSetAdd(set, rowid);
+	}
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 4096);
+	
+	// The 4097th value converts it to a bitmap container
+	
+	YapRowidSetAdd(set, 1);
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 4097);
+	XCTAssertTrue(YapRowidSetContains(set, 0));
+	XCTAssertTrue(YapRowidSetContains(set, 1));
+	XCTAssertTrue(YapRowidSetContains(set, 8190));
+	XCTAssertFalse(YapRowidSetContains(set, 3));
+	XCTAssertFalse(YapRowidSetContains(set, 8192));
+	
+	// Adding a duplicate doesn't change anything
+	
+	YapRowidSetAdd(set, 1);
+	XCTAssertTrue(YapRowidSetCount(set) == 4097);
+	
+	// Removing it again converts it back to an array container
+	
+	YapRowidSetRemove(set, 1);
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 4096);
+	XCTAssertFalse(YapRowidSetContains(set, 1));
+	
+	__block int64_t expectedRowid = 0;
+	YapRowidSetEnumerate(set, ^(int64_t rowid, BOOL __unused *stop) {
+		
+		XCTAssertTrue(rowid == expectedRowid);
+		expectedRowid += 2;
+	});
+	XCTAssertTrue(expectedRowid == 4096 * 2);
+	
+	// The edges of a container (low 16 bits), and the neighbouring containers
+	
+	YapRowidSetRemoveAll(set);
+	XCTAssertTrue(YapRowidSetCount(set) == 0);
+	
+	int64_t edges[] = { 65535, 65536, 0, 131071, 131072, 65537 };
+	
+	for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+	{
+		YapRowidSetAdd(set, edges[i]);
+	}
+	
+	NSArray *expected = @[ @(0), @(65535), @(65536), @(65537), @(131071), @(131072) ];
+	XCTAssertEqualObjects(RowidSetToArray(set), expected);
+	
+	YapRowidSetRemove(set, 65536);
+	YapRowidSetRemove(set, 65537);
+	
+	expected = @[ @(0), @(65535), @(131071), @(131072) ];
+	XCTAssertEqualObjects(RowidSetToArray(set), expected);
+	
+	// A full container
+	
+	YapRowidSetRemoveAll(set);
+	
+	for (int64_t rowid = 65536; rowid < 65536 * 2; rowid++)
+	{
+		YapRowidSetAdd(set, rowid);
+	}
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 65536);
+	XCTAssertFalse(YapRowidSetContains(set, 65535));
+	XCTAssertTrue(YapRowidSetContains(set, 65536));
+	XCTAssertTrue(YapRowidSetContains(set, 131071));
+	XCTAssertFalse(YapRowidSetContains(set, 131072));
+	
+	YapRowidSetRelease(set);
+}
+
+- (void)testRowidSet_negativeAnd64Bit
+{
+	YapRowidSet *set = YapRowidSetCreate(0);
+	
+	int64_t rowids[] = { INT64_MAX, 1, -1, (1LL << 40), INT64_MIN, 0, -(1LL << 40), (INT64_MAX - 1), (INT64_MIN + 1) };
+	
+	for (size_t i = 0; i < sizeof(rowids) / sizeof(rowids[0]); i++)
+	{
+		YapRowidSetAdd(set, rowids[i]);
+	}
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 9);
+	
+	NSArray *expected = @[ @(INT64_MIN), @(INT64_MIN + 1), @(-(1LL << 40)), @(-1), @(0), @(1),
+	                       @(1LL << 40), @(INT64_MAX - 1), @(INT64_MAX) ];
+	
+	XCTAssertEqualObjects(RowidSetToArray(set), expected);
+	
+	for (size_t i = 0; i < sizeof(rowids) / sizeof(rowids[0]); i++)
+	{
+		XCTAssertTrue(YapRowidSetContains(set, rowids[i]));
+	}
+	
+	XCTAssertFalse(YapRowidSetContains(set, -2));
+	XCTAssertFalse(YapRowidSetContains(set, (1LL << 40) + 1));
+	XCTAssertFalse(YapRowidSetContains(set, (1LL << 40) - 65536));
+	
+	// Set algebra across the sign boundary
+	
+	YapRowidSet *other = YapRowidSetCreate(0);
+	YapRowidSetAdd(other, -1);
+	YapRowidSetAdd(other, INT64_MIN);
+	YapRowidSetAdd(other, INT64_MAX);
+	YapRowidSetAdd(other, -2);
+	
+	YapRowidSet *intersectSet = YapRowidSetCopy(set);
+	YapRowidSetIntersect(intersectSet, other);
+	
+	expected = @[ @(INT64_MIN), @(-1), @(INT64_MAX) ];
+	XCTAssertEqualObjects(RowidSetToArray(intersectSet), expected);
+	
+	YapRowidSetMinus(set, other);
+	
+	expected = @[ @(INT64_MIN + 1), @(-(1LL << 40)), @(0), @(1), @(1LL << 40), @(INT64_MAX - 1) ];
+	XCTAssertEqualObjects(RowidSetToArray(set), expected);
+	
+	YapRowidSetRelease(intersectSet);
+	YapRowidSetRelease(other);
+	YapRowidSetRelease(set);
+}
+
+- (void)testRowidSet_removals
+{
+	YapRowidSet *set = YapRowidSetCreate(0);
+	
+	for (int64_t rowid = 0; rowid < 10000; rowid++)
+	{
+		YapRowidSetAdd(set, rowid * 7);
+	}
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 10000);
+	
+	// Remove every other rowid (plus some rowids that aren't in the set)
+	
+	for (int64_t rowid = 0; rowid < 10000; rowid += 2)
+	{
+		YapRowidSetRemove(set, rowid * 7);
+		YapRowidSetRemove(set, (rowid * 7) + 1);
+	}
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 5000);
+	
+	__block int64_t expectedRowid = 7;
+	__block NSUInteger enumCount = 0;
+	
+	YapRowidSetEnumerate(set, ^(int64_t rowid, BOOL __unused *stop) {
+		
+		XCTAssertTrue(rowid == expectedRowid);
+		expectedRowid += 14;
+		enumCount++;
+	});
+	
+	XCTAssertTrue(enumCount == 5000);
+	
+	// Stopping the enumeration early
+	
+	enumCount = 0;
+	YapRowidSetEnumerate(set, ^(int64_t __unused rowid, BOOL *stop) {
+		
+		if (++enumCount == 10) *stop = YES;
+	});
+	
+	XCTAssertTrue(enumCount == 10);
+	
+	// A copy is independent of the original
+	
+	YapRowidSet *copy = YapRowidSetCopy(set);
+	YapRowidSetRemoveAll(set);
+	
+	XCTAssertTrue(YapRowidSetCount(set) == 0);
+	XCTAssertTrue(YapRowidSetCount(copy) == 5000);
+	XCTAssertTrue(YapRowidSetContains(copy, 7));
+	
+	enumCount = 0;
+	YapRowidSetEnumerate(set, ^(int64_t __unused rowid, BOOL __unused *stop) {
+		
+		enumCount++;
+	});
+	
+	XCTAssertTrue(enumCount == 0);
+	
+	// Remove everything, one at a time
+	
+	for (int64_t rowid = 0; rowid < 10000; rowid++)
+	{
+		YapRowidSetRemove(copy, rowid * 7);
+	}
+	
+	XCTAssertTrue(YapRowidSetCount(copy) == 0);
+	XCTAssertTrue([RowidSetToArray(copy) count] == 0);
+	
+	YapRowidSetAdd(copy, 5);
+	XCTAssertEqualObjects(RowidSetToArray(copy), @[ @(5) ]);
+	
+	YapRowidSetRelease(copy);
+	YapRowidSetRelease(set);
+}
+
+- (void)testMemoryTable_snapshotIsolation
+{
+	YapMemoryTable *table = [[YapMemoryTable alloc] initWithKeyClass:[NSNumber class]];
+	
+	const NSUInteger keyCount = 2000;
+	
+	YapMemoryTableTransaction *rwTransaction1 = [table newReadWriteTransactionWithSnapshot:1];
+	for (NSUInteger i = 0; i < keyCount; i++)
+	{
+		[rwTransaction1 setObject:@"v1" forKey:@(i)];
+	}
+	[rwTransaction1 commit];
+	
+	// Readers (at snapshot 1) run concurrently with a writer (at snapshot 2).
+	
+	dispatch_queue_t concurrentQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	dispatch_group_t group = dispatch_group_create();
+	
+	NSMutableArray<YapMemoryTableTransaction *> *readers = [NSMutableArray array];
+	for (int r = 0; r < 4; r++)
+	{
+		[readers addObject:[table newReadTransactionWithSnapshot:1]];
+	}
+	
+	__block int32_t mismatchCount = 0;
+	
+	for (YapMemoryTableTransaction *reader in readers)
+	{
+		dispatch_group_async(group, concurrentQueue, ^{
+			
+			for (int pass = 0; pass < 20; pass++)
+			{
+				for (NSUInteger i = 0; i < keyCount; i++)
+				{
+					if (![[reader objectForKey:@(i)] isEqual:@"v1"]) {
+						OSAtomicIncrement32(&mismatchCount);
+					}
+				}
+				
+				__block NSUInteger count = 0;
+				[reader enumerateKeysAndObjectsWithBlock:^(id __unused key, id obj, BOOL __unused *stop) {
+					
+					if (![obj isEqual:@"v1"]) {
+						OSAtomicIncrement32(&mismatchCount);
+					}
+					count++;
+				}];
+				
+				if (count != keyCount) {
+					OSAtomicIncrement32(&mismatchCount);
+				}
+			}
+		});
+	}
+	
+	dispatch_group_async(group, concurrentQueue, ^{
+		
+		YapMemoryTableTransaction *rwTransaction2 = [table newReadWriteTransactionWithSnapshot:2];
+		for (NSUInteger i = 0; i < keyCount; i++)
+		{
+			[rwTransaction2 setObject:@"v2" forKey:@(i)];
+			
+			if (![[rwTransaction2 objectForKey:@(i)] isEqual:@"v2"]) {
+				OSAtomicIncrement32(&mismatchCount);
+			}
+		}
+		[rwTransaction2 setObject:@"v2" forKey:@(keyCount)];
+		[rwTransaction2 commit];
+	});
+	
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	
+	XCTAssertTrue(mismatchCount == 0);
+	
+	// Old readers are unaffected by the commit
+	
+	YapMemoryTableTransaction *oldReader = [readers firstObject];
+	XCTAssertEqualObjects([oldReader objectForKey:@(0)], @"v1");
+	XCTAssertNil([oldReader objectForKey:@(keyCount)]);
+	
+	// New readers at snapshot 1 still see snapshot 1
+	
+	YapMemoryTableTransaction *reader1 = [table newReadTransactionWithSnapshot:1];
+	XCTAssertEqualObjects([reader1 objectForKey:@(0)], @"v1");
+	XCTAssertNil([reader1 objectForKey:@(keyCount)]);
+	
+	// New readers at snapshot 2 see the commit
+	
+	YapMemoryTableTransaction *reader2 = [table newReadTransactionWithSnapshot:2];
+	XCTAssertEqualObjects([reader2 objectForKey:@(0)], @"v2");
+	XCTAssertEqualObjects([reader2 objectForKey:@(keyCount - 1)], @"v2");
+	XCTAssertEqualObjects([reader2 objectForKey:@(keyCount)], @"v2");
+	
+	// Readers at a snapshot before the first commit see nothing
+	
+	YapMemoryTableTransaction *reader0 = [table newReadTransactionWithSnapshot:0];
+	XCTAssertNil([reader0 objectForKey:@(0)]);
+}
+
+- (void)testMemoryTable_rollback
+{
+	YapMemoryTable *table = [[YapMemoryTable alloc] initWithKeyClass:[NSString class]];
+	
+	YapMemoryTableTransaction *rwTransaction1 = [table newReadWriteTransactionWithSnapshot:1];
+	[rwTransaction1 setObject:@"a1" forKey:@"a"];
+	[rwTransaction1 setObject:@"b1" forKey:@"b"];
+	[rwTransaction1 commit];
+	
+	YapMemoryTableTransaction *rwTransaction2 = [table newReadWriteTransactionWithSnapshot:2];
+	[rwTransaction2 setObject:@"a2" forKey:@"a"];
+	[rwTransaction2 removeObjectForKey:@"b"];
+	[rwTransaction2 setObject:@"c2" forKey:@"c"];
+	
+	XCTAssertEqualObjects([rwTransaction2 objectForKey:@"a"], @"a2");
+	XCTAssertNil([rwTransaction2 objectForKey:@"b"]);
+	XCTAssertEqualObjects([rwTransaction2 objectForKey:@"c"], @"c2");
+	
+	// Uncommitted changes aren't visible to readers
+	
+	YapMemoryTableTransaction *reader = [table newReadTransactionWithSnapshot:2];
+	XCTAssertEqualObjects([reader objectForKey:@"a"], @"a1");
+	XCTAssertEqualObjects([reader objectForKey:@"b"], @"b1");
+	XCTAssertNil([reader objectForKey:@"c"]);
+	
+	[rwTransaction2 rollback];
+	
+	XCTAssertEqualObjects([rwTransaction2 objectForKey:@"a"], @"a1");
+	XCTAssertEqualObjects([rwTransaction2 objectForKey:@"b"], @"b1");
+	XCTAssertNil([rwTransaction2 objectForKey:@"c"]);
+	
+	// A rollback publishes nothing
+	
+	[rwTransaction2 commit];
+	
+	reader = [table newReadTransactionWithSnapshot:2];
+	XCTAssertEqualObjects([reader objectForKey:@"a"], @"a1");
+	XCTAssertEqualObjects([reader objectForKey:@"b"], @"b1");
+	XCTAssertNil([reader objectForKey:@"c"]);
+	
+	// removeAllObjects can be rolled back too
+	
+	YapMemoryTableTransaction *rwTransaction3 = [table newReadWriteTransactionWithSnapshot:3];
+	[rwTransaction3 removeAllObjects];
+	XCTAssertNil([rwTransaction3 objectForKey:@"a"]);
+	
+	[rwTransaction3 rollback];
+	XCTAssertEqualObjects([rwTransaction3 objectForKey:@"a"], @"a1");
+	
+	// The transaction remains usable after a rollback
+	
+	[rwTransaction3 setObject:@"a3" forKey:@"a"];
+	[rwTransaction3 commit];
+	
+	reader = [table newReadTransactionWithSnapshot:3];
+	XCTAssertEqualObjects([reader objectForKey:@"a"], @"a3");
+	XCTAssertEqualObjects([reader objectForKey:@"b"], @"b1");
+}
+
+- (void)testMemoryTable_checkpoint
+{
+	YapMemoryTable *table = [[YapMemoryTable alloc] initWithKeyClass:[NSNumber class]];
+	
+	const NSUInteger keyCount = 5000;
+	
+	for (uint64_t snapshot = 1; snapshot <= 3; snapshot++)
+	{
+		YapMemoryTableTransaction *rwTransaction = [table newReadWriteTransactionWithSnapshot:snapshot];
+		for (NSUInteger i = 0; i < keyCount; i++)
+		{
+			[rwTransaction setObject:[NSString stringWithFormat:@"%llu-%lu", snapshot, (unsigned long)i] forKey:@(i)];
+		}
+		[rwTransaction commit];
+	}
+	
+	uint64_t usage3 = [table estimatedMemoryUsage];
+	
+	// A transaction still using snapshot 2 keeps version 2 (and thus version 3) alive
+	
+	YapMemoryTableTransaction *reader2 = [table newReadTransactionWithSnapshot:2];
+	
+	[table asyncCheckpoint:2];
+	uint64_t usage2 = [table estimatedMemoryUsage]; // waits for the checkpoint
+	
+	XCTAssertTrue(usage2 < usage3, @"usage2(%llu) >= usage3(%llu)", usage2, usage3);
+	
+	XCTAssertEqualObjects([reader2 objectForKey:@(0)], @"2-0");
+	XCTAssertEqualObjects([[table newReadTransactionWithSnapshot:2] objectForKey:@(7)], @"2-7");
+	XCTAssertEqualObjects([[table newReadTransactionWithSnapshot:3] objectForKey:@(7)], @"3-7");
+	
+	// Checkpointing at the latest snapshot leaves a single version
+	
+	[table asyncCheckpoint:3];
+	uint64_t usage1 = [table estimatedMemoryUsage];
+	
+	XCTAssertTrue(usage1 < usage2, @"usage1(%llu) >= usage2(%llu)", usage1, usage2);
+	
+	XCTAssertEqualObjects([[table newReadTransactionWithSnapshot:3] objectForKey:@(keyCount - 1)],
+	                      ([NSString stringWithFormat:@"3-%lu", (unsigned long)(keyCount - 1)]));
+	
+	// Checkpointing again (or with an older snapshot) doesn't discard the remaining version
+	
+	[table asyncCheckpoint:3];
+	[table asyncCheckpoint:1];
+	
+	XCTAssertTrue([table estimatedMemoryUsage] == usage1);
+	XCTAssertEqualObjects([[table newReadTransactionWithSnapshot:4] objectForKey:@(0)], @"3-0");
+	
+	// Unmodified nodes are shared between versions, and only counted once
+	
+	YapMemoryTableTransaction *rwTransaction4 = [table newReadWriteTransactionWithSnapshot:4];
+	[rwTransaction4 setObject:@"4-0" forKey:@(0)];
+	[rwTransaction4 commit];
+	
+	uint64_t usage1b = [table estimatedMemoryUsage];
+	XCTAssertTrue(usage1b < (usage1 + (usage1 / 10)), @"usage1b(%llu) usage1(%llu)", usage1b, usage1);
+}
+
+- (void)testMemoryTable_hashCollisions
+{
+	YapMemoryTable *table = [[YapMemoryTable alloc] initWithKeyClass:[TestCollidingKey class]];
+	
+	const NSUInteger keyCount = 50;
+	
+	YapMemoryTableTransaction *rwTransaction1 = [table newReadWriteTransactionWithSnapshot:1];
+	for (NSUInteger i = 0; i < keyCount; i++)
+	{
+		[rwTransaction1 setObject:@(i) forKey:[TestCollidingKey keyWithValue:i]];
+	}
+	
+	for (NSUInteger i = 0; i < keyCount; i++)
+	{
+		XCTAssertEqualObjects([rwTransaction1 objectForKey:[TestCollidingKey keyWithValue:i]], @(i));
+	}
+	XCTAssertNil([rwTransaction1 objectForKey:[TestCollidingKey keyWithValue:keyCount]]);
+	
+	[rwTransaction1 commit];
+	
+	// Replace some, remove some (in a new version)
+	
+	YapMemoryTableTransaction *rwTransaction2 = [table newReadWriteTransactionWithSnapshot:2];
+	for (NSUInteger i = 0; i < keyCount; i++)
+	{
+		if (i % 3 == 0)
+			[rwTransaction2 removeObjectForKey:[TestCollidingKey keyWithValue:i]];
+		else if (i % 3 == 1)
+			[rwTransaction2 setObject:@(i * 100) forKey:[TestCollidingKey keyWithValue:i]];
+	}
+	[rwTransaction2 commit];
+	
+	YapMemoryTableTransaction *reader1 = [table newReadTransactionWithSnapshot:1];
+	YapMemoryTableTransaction *reader2 = [table newReadTransactionWithSnapshot:2];
+	
+	NSUInteger expectedCount2 = 0;
+	for (NSUInteger i = 0; i < keyCount; i++)
+	{
+		TestCollidingKey *key = [TestCollidingKey keyWithValue:i];
+		
+		XCTAssertEqualObjects([reader1 objectForKey:key], @(i));
+		
+		if (i % 3 == 0) {
+			XCTAssertNil([reader2 objectForKey:key]);
+		}
+		else if (i % 3 == 1) {
+			XCTAssertEqualObjects([reader2 objectForKey:key], @(i * 100));
+			expectedCount2++;
+		}
+		else {
+			XCTAssertEqualObjects([reader2 objectForKey:key], @(i));
+			expectedCount2++;
+		}
+	}
+	
+	__block NSUInteger count1 = 0;
+	[reader1 enumerateKeysWithBlock:^(id __unused key, BOOL __unused *stop) {
+		count1++;
+	}];
+	
+	__block NSUInteger count2 = 0;
+	[reader2 enumerateKeysAndObjectsWithBlock:^(TestCollidingKey *key, NSNumber *obj, BOOL __unused *stop) {
+		
+		XCTAssertTrue(key.value % 3 != 0);
+		XCTAssertEqualObjects(obj, (key.value % 3 == 1) ? @(key.value * 100) : @(key.value));
+		count2++;
+	}];
+	
+	XCTAssertTrue(count1 == keyCount);
+	XCTAssertTrue(count2 == expectedCount2);
+	
+	// Remove the rest, until a single colliding key remains, and then none
+	
+	YapMemoryTableTransaction *rwTransaction3 = [table newReadWriteTransactionWithSnapshot:3];
+	for (NSUInteger i = 1; i < keyCount; i++)
+	{
+		[rwTransaction3 removeObjectForKey:[TestCollidingKey keyWithValue:i]];
+	}
+	
+	XCTAssertNil([rwTransaction3 objectForKey:[TestCollidingKey keyWithValue:1]]);
+	XCTAssertNil([rwTransaction3 objectForKey:[TestCollidingKey keyWithValue:0]]);
+	
+	[rwTransaction3 setObject:@"last" forKey:[TestCollidingKey keyWithValue:0]];
+	XCTAssertEqualObjects([rwTransaction3 objectForKey:[TestCollidingKey keyWithValue:0]], @"last");
+	
+	[rwTransaction3 removeObjectForKey:[TestCollidingKey keyWithValue:0]];
+	XCTAssertNil([rwTransaction3 objectForKey:[TestCollidingKey keyWithValue:0]]);
+	
+	[rwTransaction3 commit];
+	
+	__block NSUInteger count3 = 0;
+	[[table newReadTransactionWithSnapshot:3] enumerateKeysWithBlock:^(id __unused key, BOOL __unused *stop) {
+		count3++;
+	}];
+	
+	XCTAssertTrue(count3 == 0);
+}
+
+- (void)testMemoryTable_deleteToEmpty
+{
+	YapMemoryTable *table = [[YapMemoryTable alloc] initWithKeyClass:[NSNumber class]];
+	
+	const NSUInteger keyCount = 3000;
+	
+	YapMemoryTableTransaction *rwTransaction1 = [table newReadWriteTransactionWithSnapshot:1];
+	for (NSUInteger i = 0; i < keyCount; i++)
+	{
+		[rwTransaction1 setObject:@(i) forKey:@(i)];
+	}
+	[rwTransaction1 commit];
+	
+	// Remove one at a time (in reverse order), including keys that were never added
+	
+	YapMemoryTableTransaction *rwTransaction2 = [table newReadWriteTransactionWithSnapshot:2];
+	for (NSUInteger i = keyCount; i > 0; i--)
+	{
+		[rwTransaction2 removeObjectForKey:@(i - 1)];
+		[rwTransaction2 removeObjectForKey:@(keyCount + i)];
+		
+		XCTAssertNil([rwTransaction2 objectForKey:@(i - 1)]);
+		
+		if (i > 1) {
+			XCTAssertEqualObjects([rwTransaction2 objectForKey:@(0)], @(0));
+		}
+	}
+	
+	__block NSUInteger count = 0;
+	[rwTransaction2 enumerateKeysWithBlock:^(id __unused key, BOOL __unused *stop) {
+		count++;
+	}];
+	XCTAssertTrue(count == 0);
+	
+	// Removing from an empty table is a no-op
+	
+	[rwTransaction2 removeObjectForKey:@(0)];
+	[rwTransaction2 removeObjectsForKeys:@[ @(1), @(2) ]];
+	[rwTransaction2 removeAllObjects];
+	
+	[rwTransaction2 commit];
+	
+	count = 0;
+	[[table newReadTransactionWithSnapshot:2] enumerateKeysWithBlock:^(id __unused key, BOOL __unused *stop) {
+		count++;
+	}];
+	XCTAssertTrue(count == 0);
+	
+	// The previous version is unaffected
+	
+	count = 0;
+	[[table newReadTransactionWithSnapshot:1] enumerateKeysWithBlock:^(id __unused key, BOOL __unused *stop) {
+		count++;
+	}];
+	XCTAssertTrue(count == keyCount);
+	
+	// The empty table can be refilled
+	
+	YapMemoryTableTransaction *rwTransaction3 = [table newReadWriteTransactionWithSnapshot:3];
+	[rwTransaction3 setObject:@"again" forKey:@(42)];
+	[rwTransaction3 commit];
+	
+	YapMemoryTableTransaction *reader3 = [table newReadTransactionWithSnapshot:3];
+	XCTAssertEqualObjects([reader3 objectForKey:@(42)], @"again");
+	XCTAssertNil([reader3 objectForKey:@(0)]);
+	
+	// removeAllObjects empties the table in one step
+	
+	YapMemoryTableTransaction *rwTransaction4 = [table newReadWriteTransactionWithSnapshot:4];
+	[rwTransaction4 removeAllObjects];
+	XCTAssertNil([rwTransaction4 objectForKey:@(42)]);
+	[rwTransaction4 commit];
+	
+	XCTAssertNil([[table newReadTransactionWithSnapshot:4] objectForKey:@(42)]);
+	XCTAssertEqualObjects([[table newReadTransactionWithSnapshot:3] objectForKey:@(42)], @"again");
+}
+
 @end
@@ -0,0 +1,197 @@
+#import <XCTest/XCTest.h>
+
+#import "YapDatabase.h"
+#import "YapDatabaseCountView.h"
+
+#import <CocoaLumberjack/CocoaLumberjack.h>
+#import <CocoaLumberjack/DDTTYLogger.h>
+
+@interface TestYapDatabaseCountView : XCTestCase
+
+@end
+
+@implementation TestYapDatabaseCountView
+
+- (NSString *)databasePath:(NSString *)suffix
+{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+	NSString *baseDir = ([paths count] > 0) ? [paths objectAtIndex:0] : NSTemporaryDirectory();
+	
+	NSString *databaseName = [NSString stringWithFormat:@"%@-%@.sqlite", THIS_FILE, suffix];
+	
+	return [baseDir stringByAppendingPathComponent:databaseName];
+}
+
+- (void)setUp
+{
+	[super setUp];
+	[DDLog removeAllLoggers];
+	[DDLog addLogger:[DDTTYLogger sharedInstance]];
+}
+
+- (void)tearDown
+{
+	[DDLog flushLog];
+	[super tearDown];
+}
+
+- (YapDatabaseCountView *)unreadCountView
+{
+	// Messages are grouped by conversation, but only the unread messages are counted.
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		if (![object[@"unread"] boolValue]) return nil;
+		
+		return object[@"conversation"];
+	}];
+	
+	YapDatabaseCountViewOptions *options = [[YapDatabaseCountViewOptions alloc] init];
+	options.allowedCollections = [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:@"messages"]];
+	options.sumSource = YapDatabaseViewKeyPathSourceObject;
+	options.sumKeyPath = @"size";
+	
+	return [[YapDatabaseCountView alloc] initWithGrouping:grouping versionTag:@"1" options:options];
+}
+
+- (NSDictionary *)messageInConversation:(NSString *)conversation unread:(BOOL)unread size:(int)size
+{
+	return @{ @"conversation": conversation, @"unread": @(unread), @"size": @(size) };
+}
+
+- (void)testCounts
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	// Populate (some) rows before the extension is registered
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:[self messageInConversation:@"a" unread:YES size:1] forKey:@"m1" inCollection:@"messages"];
+		[transaction setObject:[self messageInConversation:@"a" unread:YES size:2] forKey:@"m2" inCollection:@"messages"];
+		[transaction setObject:[self messageInConversation:@"a" unread:NO  size:4] forKey:@"m3" inCollection:@"messages"];
+		[transaction setObject:[self messageInConversation:@"b" unread:YES size:8] forKey:@"m4" inCollection:@"messages"];
+		
+		// Not an allowed collection
+		[transaction setObject:[self messageInConversation:@"a" unread:YES size:16] forKey:@"m5" inCollection:@"drafts"];
+	}];
+	
+	BOOL registered = [database registerExtension:[self unreadCountView] withName:@"unread"];
+	XCTAssertTrue(registered, @"Oops");
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseCountViewTransaction *countTransaction = [transaction ext:@"unread"];
+		
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"a"], (NSUInteger)2);
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"b"], (NSUInteger)1);
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"c"], (NSUInteger)0);
+		XCTAssertEqual([countTransaction numberOfItemsInAllGroups], (NSUInteger)3);
+		XCTAssertEqual([countTransaction numberOfGroups], (NSUInteger)2);
+		
+		XCTAssertEqual([countTransaction sumInGroup:@"a"], 3.0);
+		XCTAssertEqual([countTransaction sumInGroup:@"b"], 8.0);
+	}];
+	
+	// Insert, update (moving a row between groups), and remove
+	
+	[connection2 beginLongLivedReadTransaction];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:[self messageInConversation:@"c" unread:YES size:32] forKey:@"m6" inCollection:@"messages"];
+		[transaction setObject:[self messageInConversation:@"b" unread:YES size:2] forKey:@"m2" inCollection:@"messages"];
+		[transaction setObject:[self messageInConversation:@"a" unread:NO  size:1] forKey:@"m1" inCollection:@"messages"];
+		[transaction removeObjectForKey:@"m4" inCollection:@"messages"];
+		
+		// Touches don't change anything
+		[transaction touchObjectForKey:@"m3" inCollection:@"messages"];
+		
+		YapDatabaseCountViewTransaction *countTransaction = [transaction ext:@"unread"];
+		
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"a"], (NSUInteger)0);
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"b"], (NSUInteger)1);
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"c"], (NSUInteger)1);
+		XCTAssertEqual([countTransaction numberOfGroups], (NSUInteger)2);
+	}];
+	
+	NSArray *notifications = [connection2 beginLongLivedReadTransaction];
+	
+	XCTAssertTrue([[connection2 ext:@"unread"] hasChangesForNotifications:notifications]);
+	XCTAssertTrue([[connection2 ext:@"unread"] hasChangesForGroup:@"a" inNotifications:notifications]);
+	XCTAssertTrue([[connection2 ext:@"unread"] hasChangesForGroup:@"c" inNotifications:notifications]);
+	XCTAssertFalse([[connection2 ext:@"unread"] hasChangesForGroup:@"d" inNotifications:notifications]);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseCountViewTransaction *countTransaction = [transaction ext:@"unread"];
+		
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"a"], (NSUInteger)0);
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"b"], (NSUInteger)1);
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"c"], (NSUInteger)1);
+		
+		XCTAssertEqual([countTransaction sumInGroup:@"b"], 2.0);
+		XCTAssertEqual([countTransaction sumInGroup:@"c"], 32.0);
+		
+		NSArray *allGroups = [[countTransaction allGroups] sortedArrayUsingSelector:@selector(compare:)];
+		XCTAssertEqualObjects(allGroups, (@[ @"b", @"c" ]));
+	}];
+	
+	[connection2 endLongLivedReadTransaction];
+	
+	// Changes that are rolled back are discarded
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:[self messageInConversation:@"b" unread:YES size:1] forKey:@"m7" inCollection:@"messages"];
+		[transaction rollback];
+	}];
+	
+	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqual([[transaction ext:@"unread"] numberOfItemsInGroup:@"b"], (NSUInteger)1);
+	}];
+	
+	// Remove all
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeAllObjectsInCollection:@"messages"];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqual([[transaction ext:@"unread"] numberOfItemsInAllGroups], (NSUInteger)0);
+		XCTAssertEqual([[transaction ext:@"unread"] numberOfGroups], (NSUInteger)0);
+	}];
+	
+	// The counts are persisted, so a new connection loads them from the table
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:[self messageInConversation:@"d" unread:YES size:5] forKey:@"m8" inCollection:@"messages"];
+		[transaction setObject:[self messageInConversation:@"d" unread:YES size:6] forKey:@"m9" inCollection:@"messages"];
+		[transaction removeAllObjectsInAllCollections];
+		[transaction setObject:[self messageInConversation:@"e" unread:YES size:7] forKey:@"m10" inCollection:@"messages"];
+	}];
+	
+	[[database newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseCountViewTransaction *countTransaction = [transaction ext:@"unread"];
+		
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"d"], (NSUInteger)0);
+		XCTAssertEqual([countTransaction numberOfItemsInGroup:@"e"], (NSUInteger)1);
+		XCTAssertEqual([countTransaction sumInGroup:@"e"], 7.0);
+	}];
+}
+
+@end
@@ -1777,4 +1777,490 @@
 	}];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)testRegisterExtensionsBatch
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"key%d", i];
+			
+			[transaction setObject:@(i) forKey:key inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	        NSString *collection1, NSString *key1, id obj1,
+	        NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseViewFiltering *filtering = [YapDatabaseViewFiltering withObjectBlock:
+		^BOOL (YapDatabaseReadTransaction *transaction, NSString *group, NSString *collection, NSString *key, id object)
+	{
+		return ([(NSNumber *)object intValue] % 2 == 0);
+	}];
+	
+	// The filteredView depends on "order", which is part of the same batch.
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	YapDatabaseFilteredView *filteredView =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"order" filtering:filtering versionTag:@"1"];
+	
+	YapDatabaseAutoView *view2 =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	BOOL result = [database registerExtensions:@{ @"filter": filteredView, @"order": view, @"order2": view2 }
+	                                    config:nil];
+	XCTAssertTrue(result, @"Failure registering extensions");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@""] == 100, @"");
+		XCTAssertTrue([[transaction ext:@"order2"] numberOfItemsInGroup:@""] == 100, @"");
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 50, @"");
+	}];
+	
+	// A batch with an unsatisfied dependency fails as a whole.
+	
+	YapDatabaseAutoView *view3 =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	YapDatabaseFilteredView *orphan =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"non-existent" filtering:filtering versionTag:@"1"];
+	
+	result = [database registerExtensions:@{ @"order3": view3, @"orphan": orphan } config:nil];
+	XCTAssertFalse(result, @"Expected failure");
+	
+	XCTAssertNil([database registeredExtension:@"order3"], @"Expected nil");
+	XCTAssertNil([database registeredExtension:@"orphan"], @"Expected nil");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNil([transaction ext:@"order3"], @"Expected nil");
+	}];
+}
+
+- (void)testDeferredExtensionRegistration
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"key%d", i];
+			
+			[transaction setObject:@(i) forKey:key inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	        NSString *collection1, NSString *key1, id obj1,
+	        NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseViewFiltering *filtering = [YapDatabaseViewFiltering withObjectBlock:
+		^BOOL (YapDatabaseReadTransaction *transaction, NSString *group, NSString *collection, NSString *key, id object)
+	{
+		return ([(NSNumber *)object intValue] % 2 == 0);
+	}];
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	YapDatabaseFilteredView *filteredView =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"order" filtering:filtering versionTag:@"1"];
+	
+	YapDatabaseFilteredView *orphan =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"non-existent" filtering:filtering versionTag:@"1"];
+	
+	XCTAssertTrue([database registerDeferredExtension:filteredView withName:@"filter"], @"");
+	XCTAssertTrue([database registerDeferredExtension:view withName:@"order"], @"");
+	XCTAssertTrue([database registerDeferredExtension:orphan withName:@"orphan"], @"");
+	
+	XCTAssertFalse([database registerDeferredExtension:view withName:@"order"], @"Expected duplicate failure");
+	
+	// ReadWrite transactions wait for the deferred extensions to be registered.
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@""] == 100, @"");
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 50, @"");
+		
+		[transaction setObject:@(100) forKey:@"key100" inCollection:nil];
+	}];
+	
+	XCTAssertNotNil([database registeredExtension:@"order"], @"");
+	XCTAssertNotNil([database registeredExtension:@"filter"], @"");
+	XCTAssertNil([database registeredExtension:@"orphan"], @"Expected nil");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@""] == 101, @"");
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 51, @"");
+	}];
+}
+
+- (void)testSetFilteringWithChange
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+		^(YapDatabaseReadTransaction *transaction, NSString *group,
+		    NSString *collection1, NSString *key1, id obj1,
+		    NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:view withName:@"order"], @"");
+	
+	YapDatabaseViewFiltering* (^FilterByMultiple)(int) = ^(int multiple){
+		
+		return [YapDatabaseViewFiltering withObjectBlock:
+		    ^BOOL (YapDatabaseReadTransaction *transaction, NSString *group, NSString *collection, NSString *key, id object)
+		{
+			return ([(NSNumber *)object intValue] % multiple == 0);
+		}];
+	};
+	
+	YapDatabaseFilteredView *filteredView =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"order"
+	                                                filtering:FilterByMultiple(2)
+	                                               versionTag:@"2"];
+	
+	XCTAssertTrue([database registerExtension:filteredView withName:@"filter"], @"");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+		
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 50, @"");
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// Multiples of 4 are a subset of multiples of 2
+		
+		[[transaction ext:@"filter"] setFiltering:FilterByMultiple(4)
+		                               versionTag:@"4"
+		                                   change:YapDatabaseViewFilteringChangeStricter];
+		
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 25, @"");
+		
+		NSString *key = nil;
+		[[transaction ext:@"filter"] getKey:&key collection:NULL atIndex:1 inGroup:@""];
+		
+		XCTAssertEqualObjects(key, @"key4", @"");
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// Multiples of 1 are a superset of multiples of 4
+		
+		[[transaction ext:@"filter"] setFiltering:FilterByMultiple(1)
+		                               versionTag:@"1"
+		                                   change:YapDatabaseViewFilteringChangeLooser];
+		
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 100, @"");
+		
+		NSString *key = nil;
+		[[transaction ext:@"filter"] getKey:&key collection:NULL atIndex:99 inGroup:@""];
+		
+		XCTAssertEqualObjects(key, @"key99", @"");
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// A looser change never removes rows (which is why the declared change must be correct).
+		
+		[[transaction ext:@"filter"] setFiltering:FilterByMultiple(3)
+		                               versionTag:@"3"
+		                                   change:YapDatabaseViewFilteringChangeLooser];
+		
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 100, @"");
+		
+		[[transaction ext:@"filter"] setFiltering:FilterByMultiple(3)
+		                               versionTag:@"3b"];
+		
+		XCTAssertTrue([[transaction ext:@"filter"] numberOfItemsInGroup:@""] == 34, @"");
+	}];
+}
+
+- (void)testStackedFilteredViews
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+		^(YapDatabaseReadTransaction *transaction, NSString *group,
+		    NSString *collection1, NSString *key1, id obj1,
+		    NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:view withName:@"order"], @"");
+	
+	YapDatabaseViewFiltering* (^FilterByMultiple)(int) = ^(int multiple){
+		
+		return [YapDatabaseViewFiltering withObjectBlock:
+		    ^BOOL (YapDatabaseReadTransaction *transaction, NSString *group, NSString *collection, NSString *key, id object)
+		{
+			return ([(NSNumber *)object intValue] % multiple == 0);
+		}];
+	};
+	
+	__block NSUInteger filter2Count = 0;
+	
+	YapDatabaseViewFiltering *filtering2 = [YapDatabaseViewFiltering withObjectBlock:
+	    ^BOOL (YapDatabaseReadTransaction *transaction, NSString *group, NSString *collection, NSString *key, id object)
+	{
+		filter2Count++;
+		return ([(NSNumber *)object intValue] < 100);
+	}];
+	
+	YapDatabaseFilteredView *filteredView1 =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"order"
+	                                                filtering:FilterByMultiple(2)
+	                                               versionTag:@"2"];
+	
+	YapDatabaseFilteredView *filteredView2 =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"filter1"
+	                                                filtering:filtering2
+	                                               versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:filteredView1 withName:@"filter1"], @"");
+	XCTAssertTrue([database registerExtension:filteredView2 withName:@"filter2"], @"");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 200; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+		
+		XCTAssertTrue([[transaction ext:@"filter1"] numberOfItemsInGroup:@""] == 100, @"");
+		XCTAssertTrue([[transaction ext:@"filter2"] numberOfItemsInGroup:@""] == 50, @"");
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// Rows moving in & out of the bottom filteredView are reflected in the one stacked upon it.
+		
+		[transaction setObject:@(5) forKey:@"key4" inCollection:nil];
+		[transaction setObject:@(6) forKey:@"key5" inCollection:nil];
+		[transaction touchObjectForKey:@"key10" inCollection:nil];
+		
+		XCTAssertNil([[transaction ext:@"filter2"] groupForKey:@"key4" inCollection:nil], @"");
+		XCTAssertNotNil([[transaction ext:@"filter2"] groupForKey:@"key5" inCollection:nil], @"");
+		XCTAssertNotNil([[transaction ext:@"filter2"] groupForKey:@"key10" inCollection:nil], @"");
+		
+		XCTAssertTrue([[transaction ext:@"filter2"] numberOfItemsInGroup:@""] == 50, @"");
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// A stricter change to the bottom filteredView only removes rows from the one stacked upon it,
+		// so its filter doesn't need to be invoked.
+		
+		filter2Count = 0;
+		
+		[[transaction ext:@"filter1"] setFiltering:FilterByMultiple(4)
+		                                versionTag:@"4"
+		                                    change:YapDatabaseViewFilteringChangeStricter];
+		
+		XCTAssertTrue(filter2Count == 0, @"");
+		
+		// Note: key4 is now 5, and key5 is now 6.
+		
+		XCTAssertTrue([[transaction ext:@"filter1"] numberOfItemsInGroup:@""] == 49, @"");
+		XCTAssertTrue([[transaction ext:@"filter2"] numberOfItemsInGroup:@""] == 24, @"");
+		
+		NSString *key = nil;
+		[[transaction ext:@"filter2"] getKey:&key collection:NULL atIndex:1 inGroup:@""];
+		
+		XCTAssertEqualObjects(key, @"key8", @"");
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// A change to the bottom filteredView that doesn't change any of its rows isn't propagated.
+		
+		filter2Count = 0;
+		
+		[[transaction ext:@"filter1"] setFiltering:FilterByMultiple(4) versionTag:@"4b"];
+		
+		XCTAssertTrue(filter2Count == 0, @"");
+		XCTAssertTrue([[transaction ext:@"filter2"] numberOfItemsInGroup:@""] == 24, @"");
+		
+		// But any other change still is.
+		
+		[[transaction ext:@"filter1"] setFiltering:FilterByMultiple(2) versionTag:@"2b"];
+		
+		XCTAssertTrue(filter2Count > 0, @"");
+		XCTAssertTrue([[transaction ext:@"filter2"] numberOfItemsInGroup:@""] == 50, @"");
+	}];
+}
+
+- (void)testConcurrentFiltering
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return ([(NSNumber *)object intValue] % 3 == 0) ? @"fizz" : @"other";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+		^(YapDatabaseReadTransaction *transaction, NSString *group,
+		    NSString *collection1, NSString *key1, id obj1,
+		    NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:view withName:@"order"], @"");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 2000; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseViewFiltering* (^MakeFiltering)(void) = ^{
+		
+		return [YapDatabaseViewFiltering withObjectBlock:
+		    ^BOOL (YapDatabaseReadTransaction *transaction, NSString *group, NSString *collection, NSString *key, id object)
+		{
+			return ([(NSNumber *)object intValue] % 5 != 0);
+		}];
+	};
+	
+	YapDatabaseViewFiltering *concurrentFiltering = MakeFiltering();
+	concurrentFiltering.allowsConcurrentFiltering = YES;
+	
+	YapDatabaseFilteredView *serialView =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"order" filtering:MakeFiltering() versionTag:@"1"];
+	
+	YapDatabaseFilteredView *concurrentView =
+	  [[YapDatabaseFilteredView alloc] initWithParentViewName:@"order" filtering:concurrentFiltering versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:serialView withName:@"serial"], @"");
+	XCTAssertTrue([database registerExtension:concurrentView withName:@"concurrent"], @"");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSString *group in @[ @"fizz", @"other" ])
+		{
+			NSMutableArray *serialKeys = [NSMutableArray array];
+			NSMutableArray *concurrentKeys = [NSMutableArray array];
+			
+			[[transaction ext:@"serial"] enumerateKeysInGroup:group usingBlock:
+			    ^(NSString *collection, NSString *key, NSUInteger index, BOOL *stop) {
+				
+				[serialKeys addObject:key];
+			}];
+			
+			[[transaction ext:@"concurrent"] enumerateKeysInGroup:group usingBlock:
+			    ^(NSString *collection, NSString *key, NSUInteger index, BOOL *stop) {
+				
+				[concurrentKeys addObject:key];
+			}];
+			
+			XCTAssertTrue(serialKeys.count > 0, @"");
+			XCTAssertEqualObjects(serialKeys, concurrentKeys, @"");
+		}
+		
+		XCTAssertTrue([[transaction ext:@"concurrent"] numberOfItemsInAllGroups] == 1600, @"");
+	}];
+}
+
 @end
@@ -2,6 +2,7 @@
 
 #import "YapDatabase.h"
 #import "YapDatabaseFullTextSearch.h"
+#import "YapDatabaseSecondaryIndex.h"
 
 #import <CocoaLumberjack/CocoaLumberjack.h>
 #import <CocoaLumberjack/DDTTYLogger.h>
@@ -227,4 +228,551 @@
 	}];
 }
 
+- (void)testDeferredIndexing
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearchOptions *extensionOptions = [[YapDatabaseFullTextSearchOptions alloc] init];
+	extensionOptions.deferredIndexing = YES;
+	extensionOptions.deferredIndexingBatchSize = 2;
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"]
+	                                                 options:nil
+	                                                 handler:handler
+	                                              ftsVersion:nil
+	                                              versionTag:nil
+	                                        extensionOptions:extensionOptions];
+	
+	[database registerExtension:fts withName:@"fts"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"hello world"       forKey:@"key1" inCollection:nil];
+		[transaction setObject:@"hello coffee shop" forKey:@"key2" inCollection:nil];
+		[transaction setObject:@"hello laptop"      forKey:@"key3" inCollection:nil];
+		[transaction setObject:@"hello work"        forKey:@"key4" inCollection:nil];
+		
+		// The rows are queued, but a readWrite transaction flushes the queue before a query
+		
+		__block NSUInteger count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"coffee"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 1, @"Missing search results");
+		XCTAssertTrue([[transaction ext:@"fts"] numberOfPendingRows] == 0, @"Queue not flushed");
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"hello distraction" forKey:@"key4" inCollection:nil];
+		[transaction setObject:@"hello tea"         forKey:@"key5" inCollection:nil];
+		[transaction setObject:@"hello cake"        forKey:@"key6" inCollection:nil];
+		
+		XCTAssertTrue([[transaction ext:@"fts"] numberOfPendingRows] == 3, @"Rows not queued");
+		
+		// Removing a queued row also removes it from the queue
+		
+		[transaction removeObjectForKey:@"key6" inCollection:nil];
+		
+		XCTAssertTrue([[transaction ext:@"fts"] numberOfPendingRows] == 2, @"Row not dequeued");
+	}];
+	
+	// The queue is indexed (in batches) in the background
+	
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+	
+	__block NSUInteger pendingCount = 0;
+	do
+	{
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			pendingCount = [[transaction ext:@"fts"] numberOfPendingRows];
+		}];
+		
+		if (pendingCount > 0) {
+			[NSThread sleepForTimeInterval:0.05];
+		}
+		
+	} while (pendingCount > 0 && [timeout timeIntervalSinceNow] > 0);
+	
+	XCTAssertTrue(pendingCount == 0, @"Queue not indexed in the background");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		__block NSUInteger count;
+		
+		count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"hello"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 5, @"Missing search results");
+		
+		count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"hello wor*"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 1, @"Missing search results");
+		
+		count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"cake"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 0, @"Unexpected search results");
+	}];
+}
+
+- (void)testTableOptionsAndMerging
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearchOptions *extensionOptions = [[YapDatabaseFullTextSearchOptions alloc] init];
+	extensionOptions.prefixIndexes = @[ @(2), @(3) ];
+	extensionOptions.detail = YapDatabaseFullTextSearchDetailColumn;
+	extensionOptions.automerge = 0; // only merge in the background
+	extensionOptions.mergeSegmentThreshold = 8;
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"]
+	                                                 options:nil
+	                                                 handler:handler
+	                                              ftsVersion:YapDatabaseFullTextSearchFTS5Version
+	                                              versionTag:nil
+	                                        extensionOptions:extensionOptions];
+	
+	[database registerExtension:fts withName:@"fts"];
+	
+	// Every transaction adds a segment
+	
+	for (NSUInteger i = 0; i < 32; i++)
+	{
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			NSString *key = [NSString stringWithFormat:@"key%lu", (unsigned long)i];
+			NSString *object = [NSString stringWithFormat:@"hello coffee number%lu", (unsigned long)i];
+			
+			[transaction setObject:object forKey:key inCollection:nil];
+		}];
+	}
+	
+	// The segments are merged in the background
+	
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+	
+	__block NSUInteger segmentCount = 0;
+	do
+	{
+		[NSThread sleepForTimeInterval:0.05];
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			segmentCount = [[transaction ext:@"fts"] numberOfSegments];
+		}];
+		
+	} while (segmentCount > 8 && [timeout timeIntervalSinceNow] > 0);
+	
+	XCTAssertTrue(segmentCount <= 8, @"Segments not merged in the background: %lu", (unsigned long)segmentCount);
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		__block NSUInteger count;
+		
+		count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"cof*"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 32, @"Missing search results");
+		
+		count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"number1*"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 11, @"Missing search results"); // 1, 10-19
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"fts"] optimize];
+		
+		XCTAssertTrue([[transaction ext:@"fts"] numberOfSegments] == 1, @"Segments not merged");
+	}];
+}
+
+- (void)testContentless
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearchOptions *extensionOptions = [[YapDatabaseFullTextSearchOptions alloc] init];
+	extensionOptions.contentless = YES;
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"]
+	                                                 options:nil
+	                                                 handler:handler
+	                                              ftsVersion:YapDatabaseFullTextSearchFTS5Version
+	                                              versionTag:nil
+	                                        extensionOptions:extensionOptions];
+	
+	[database registerExtension:fts withName:@"fts"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"hello world"       forKey:@"key1" inCollection:nil];
+		[transaction setObject:@"hello coffee shop" forKey:@"key2" inCollection:nil];
+		[transaction setObject:@"hello laptop"      forKey:@"key3" inCollection:nil];
+	}];
+	
+	// Updates & deletes
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"hello coffee cup" forKey:@"key3" inCollection:nil];
+		[transaction removeObjectForKey:@"key1" inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		__block NSUInteger count;
+		
+		count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"hello"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 2, @"Missing search results");
+		
+		count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"laptop"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 0, @"Unexpected search results");
+		
+		// The snippets are generated from the handler
+		
+		YapDatabaseFullTextSearchSnippetOptions *options = [YapDatabaseFullTextSearchSnippetOptions new];
+		options.startMatchText = @"[[";
+		options.endMatchText   = @"]]";
+		
+		NSMutableSet *snippets = [NSMutableSet set];
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"coffee"
+		                             withSnippetOptions:options
+		                                     usingBlock:
+		    ^(NSString *snippet, NSString *collection, NSString *key, BOOL *stop) {
+			
+			[snippets addObject:snippet];
+		}];
+		
+		NSSet *expected = [NSSet setWithObjects:@"hello [[coffee]] shop", @"hello [[coffee]] cup", nil];
+		XCTAssertEqualObjects(snippets, expected, @"Unexpected snippets");
+	}];
+}
+
+- (void)testBm25TopK
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"]
+	                                                 options:nil
+	                                                 handler:handler
+	                                              ftsVersion:YapDatabaseFullTextSearchFTS5Version
+	                                              versionTag:nil];
+	
+	[database registerExtension:fts withName:@"fts"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"coffee"                            forKey:@"key1" inCollection:nil];
+		[transaction setObject:@"coffee coffee"                     forKey:@"key2" inCollection:nil];
+		[transaction setObject:@"coffee coffee coffee"              forKey:@"key3" inCollection:nil];
+		[transaction setObject:@"coffee with a lot of other words"  forKey:@"key4" inCollection:nil];
+		[transaction setObject:@"tea"                               forKey:@"key5" inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		// The top-K page matches the start of the full bm25 ordering
+		
+		NSMutableArray *allKeys = [NSMutableArray array];
+		[[transaction ext:@"fts"] enumerateBm25OrderedKeysMatching:@"coffee"
+		                                               withWeights:nil
+		                                                usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			[allKeys addObject:key];
+		}];
+		XCTAssertTrue(allKeys.count == 4, @"Missing search results");
+		
+		NSMutableArray *pageKeys = [NSMutableArray array];
+		[[transaction ext:@"fts"] enumerateBm25OrderedKeysMatching:@"coffee"
+		                                               withWeights:nil
+		                                                     limit:2
+		                                                    offset:0
+		                                                usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			[pageKeys addObject:key];
+		}];
+		XCTAssertEqualObjects(pageKeys, [allKeys subarrayWithRange:NSMakeRange(0, 2)], @"Unexpected first page");
+		
+		[pageKeys removeAllObjects];
+		[[transaction ext:@"fts"] enumerateBm25OrderedKeysMatching:@"coffee"
+		                                               withWeights:@[ @(1.0) ]
+		                                                     limit:2
+		                                                    offset:2
+		                                                usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			[pageKeys addObject:key];
+		}];
+		XCTAssertEqualObjects(pageKeys, [allKeys subarrayWithRange:NSMakeRange(2, 2)], @"Unexpected second page");
+		
+		// Snippets only for the page
+		
+		YapDatabaseFullTextSearchSnippetOptions *options = [YapDatabaseFullTextSearchSnippetOptions new];
+		options.startMatchText = @"[[";
+		options.endMatchText   = @"]]";
+		
+		__block NSUInteger count = 0;
+		[[transaction ext:@"fts"] enumerateBm25OrderedKeysMatching:@"coffee"
+		                                               withWeights:nil
+		                                                     limit:1
+		                                                    offset:0
+		                                        withSnippetOptions:options
+		                                                usingBlock:
+		    ^(NSString *snippet, NSString *collection, NSString *key, BOOL *stop) {
+			
+			XCTAssertEqualObjects(key, allKeys[0], @"Unexpected key");
+			XCTAssertTrue([snippet rangeOfString:@"[[coffee]]"].location != NSNotFound, @"Unexpected snippet: %@", snippet);
+			count++;
+		}];
+		XCTAssertTrue(count == 1, @"Unexpected page size");
+	}];
+}
+
+- (void)testScope
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"] handler:handler];
+	
+	[database registerExtension:fts withName:@"fts"];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"folder" withType:YapDatabaseSecondaryIndexTypeText];
+	
+	YapDatabaseSecondaryIndexHandler *indexHandler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:collection forKey:@"folder"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:indexHandler];
+	
+	[database registerExtension:secondaryIndex withName:@"idx"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"hello world"   forKey:@"key1" inCollection:@"inbox"];
+		[transaction setObject:@"hello coffee"  forKey:@"key2" inCollection:@"inbox"];
+		[transaction setObject:@"hello world"   forKey:@"key3" inCollection:@"archive"];
+		[transaction setObject:@"goodbye world" forKey:@"key4" inCollection:@"archive"];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE folder = ?", @"inbox"];
+		YapDatabaseFullTextSearchScope *scope =
+		  [YapDatabaseFullTextSearchScope scopeWithSecondaryIndexName:@"idx" query:query];
+		
+		NSMutableSet *keys = [NSMutableSet set];
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"world"
+		                                        inScope:scope
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			[keys addObject:key];
+		}];
+		XCTAssertEqualObjects(keys, [NSSet setWithObject:@"key1"], @"Unexpected scoped results");
+		
+		// The scope doesn't leak into the next (unscoped) query
+		
+		[keys removeAllObjects];
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"world"
+		                                        inScope:nil
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			[keys addObject:key];
+		}];
+		XCTAssertTrue(keys.count == 3, @"Unexpected unscoped results");
+		
+		// Unknown extension
+		
+		scope = [YapDatabaseFullTextSearchScope scopeWithSecondaryIndexName:@"nope" query:query];
+		
+		[keys removeAllObjects];
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"world"
+		                                        inScope:scope
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			[keys addObject:key];
+		}];
+		XCTAssertTrue(keys.count == 0, @"Unexpected results for an unregistered scope");
+	}];
+}
+
+- (void)testUnicodeTokenizer
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearchOptions *options = [[YapDatabaseFullTextSearchOptions alloc] init];
+	options.tokenizer = [YapDatabaseFullTextSearchTokenizer unicodeTokenizer];
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"]
+	                                                 options:nil
+	                                                 handler:handler
+	                                              ftsVersion:YapDatabaseFullTextSearchFTS5Version
+	                                              versionTag:nil
+	                                        extensionOptions:options];
+	
+	[database registerExtension:fts withName:@"fts"];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"Crème Brûlée, s'il vous plaît" forKey:@"key1" inCollection:nil];
+		[transaction setObject:@"東京都に住んでいます"              forKey:@"key2" inCollection:nil];
+		[transaction setObject:@"HELLO World"                    forKey:@"key3" inCollection:nil];
+		[transaction setObject:@"Ｆｕｌｌｗｉｄｔｈ"               forKey:@"key4" inCollection:nil];
+	}];
+	
+	// The tokenizer is registered with every connection that uses the extension
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSDictionary<NSString *, NSString *> *expected = @{
+			@"creme brulee" : @"key1",
+			@"CRÈME"        : @"key1",
+			@"plait"        : @"key1",
+			@"東京"          : @"key2",
+			@"京都"          : @"key2",
+			@"東京都"        : @"key2",
+			@"東"            : @"key2",
+			@"hello world"  : @"key3",
+			@"fullwidth"    : @"key4",
+		};
+		
+		[expected enumerateKeysAndObjectsUsingBlock:^(NSString *query, NSString *expectedKey, BOOL *stop) {
+			
+			NSMutableArray *keys = [NSMutableArray array];
+			[[transaction ext:@"fts"] enumerateKeysMatching:query
+			                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+				[keys addObject:key];
+			}];
+			
+			XCTAssertEqualObjects(keys, @[ expectedKey ], @"Unexpected results for query: %@", query);
+		}];
+		
+		// Not a match
+		
+		__block NSUInteger count = 0;
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"京東"
+		                                     usingBlock:^(NSString *collection, NSString *key, BOOL *stop) {
+			count++;
+		}];
+		XCTAssertTrue(count == 0, @"Unexpected match");
+		
+		// The snippet offsets refer to the original text
+		
+		YapDatabaseFullTextSearchSnippetOptions *snippetOptions = [YapDatabaseFullTextSearchSnippetOptions new];
+		snippetOptions.startMatchText = @"[[";
+		snippetOptions.endMatchText   = @"]]";
+		
+		[[transaction ext:@"fts"] enumerateKeysMatching:@"creme"
+		                             withSnippetOptions:snippetOptions
+		                                     usingBlock:^(NSString *snippet, NSString *collection, NSString *key, BOOL *stop) {
+			
+			XCTAssertTrue([snippet rangeOfString:@"[[Crème]]"].location != NSNotFound, @"Unexpected snippet: %@", snippet);
+		}];
+	}];
+}
+
 @end
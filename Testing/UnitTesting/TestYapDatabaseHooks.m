@@ -257,4 +257,79 @@
 	XCTAssert(invokeCount_didRemoveAllRows == 1);
 }
 
+- (void)testDidCommit
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	XCTAssertNotNil(connection, @"Oops");
+	
+	NSMutableArray<YapDatabaseHooksCommitSummary *> *summaries = [NSMutableArray array];
+	dispatch_queue_t didCommitQueue = dispatch_queue_create("TestYapDatabaseHooks", DISPATCH_QUEUE_SERIAL);
+	
+	XCTestExpectation *expectation = [self expectationWithDescription:@"didCommit"];
+	
+	YapDatabaseHooks *hooks = [[YapDatabaseHooks alloc] init];
+	hooks.allowedCollections = [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:@"+"]];
+	hooks.didCommitQueue = didCommitQueue;
+	hooks.didCommitPolicy = YapDatabaseHooksDidCommitPolicy_Queue;
+	hooks.didCommit = ^(YapDatabaseHooksCommitSummary *summary) {
+		
+		[summaries addObject:summary];
+		if (summaries.count == 2) {
+			[expectation fulfill];
+		}
+	};
+	
+	BOOL result = [database registerExtension:hooks withName:@"hooks"];
+	XCTAssert(result, @"Oops");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"0" forKey:@"0" inCollection:@"+"];
+		[transaction setObject:@"1" forKey:@"1" inCollection:@"+"];
+		[transaction replaceObject:@"1b" forKey:@"1" inCollection:@"+"];
+		[transaction setObject:@"x" forKey:@"x" inCollection:@"x"]; // not in whitelist
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"0b" forKey:@"0" inCollection:@"+"];
+		[transaction removeObjectForKey:@"1" inCollection:@"+"];
+	}];
+	
+	// Rolled back, so no summary
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"2" forKey:@"2" inCollection:@"+"];
+		[transaction rollback];
+	}];
+	
+	[self waitForExpectationsWithTimeout:5.0 handler:NULL];
+	
+	dispatch_sync(didCommitQueue, ^{
+		
+		XCTAssert(summaries.count == 2);
+		
+		YapDatabaseHooksCommitSummary *summary1 = summaries[0];
+		XCTAssert(summary1.commitCount == 1);
+		XCTAssert(summary1.changes.count == 2);
+		XCTAssert([summary1 flagsForKey:@"0" inCollection:@"+"] ==
+		  (YapDatabaseHooksInsertedRow | YapDatabaseHooksChangedObject | YapDatabaseHooksChangedMetadata));
+		XCTAssert([summary1 flagsForKey:@"1" inCollection:@"+"] ==
+		  (YapDatabaseHooksInsertedRow | YapDatabaseHooksChangedObject | YapDatabaseHooksChangedMetadata));
+		XCTAssert([summary1 flagsForKey:@"x" inCollection:@"x"] == 0);
+		
+		YapDatabaseHooksCommitSummary *summary2 = summaries[1];
+		XCTAssert(summary2.snapshot > summary1.snapshot);
+		XCTAssert([summary2 flagsForKey:@"0" inCollection:@"+"] ==
+		  (YapDatabaseHooksUpdatedRow | YapDatabaseHooksChangedObject | YapDatabaseHooksChangedMetadata));
+		XCTAssert([summary2 flagsForKey:@"1" inCollection:@"+"] == YapDatabaseHooksRemovedRow);
+	});
+}
+
 @end
@@ -4397,4 +4397,551 @@
 	XCTAssert([Node_NotifyCount notifyCount] == 1);
 }
 
+- (void)testTraversal
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseRelationship *relationship = [[YapDatabaseRelationship alloc] init];
+	
+	BOOL registered = [database registerExtension:relationship withName:@"relationship"];
+	
+	XCTAssertTrue(registered, @"Error registering extension");
+	
+	// a -> b -> d -> a (cycle)
+	// a -> c -> e
+	// c -(other)-> f
+	
+	NSArray *childEdges = @[ @[@"a", @"b"], @[@"a", @"c"], @[@"b", @"d"], @[@"d", @"a"], @[@"c", @"e"] ];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSString *key in @[ @"a", @"b", @"c", @"d", @"e", @"f" ])
+		{
+			[transaction setObject:key forKey:key inCollection:nil];
+		}
+		
+		for (NSArray *pair in childEdges)
+		{
+			YapDatabaseRelationshipEdge *edge =
+			  [YapDatabaseRelationshipEdge edgeWithName:@"child"
+			                                  sourceKey:pair[0]
+			                                 collection:nil
+			                             destinationKey:pair[1]
+			                                 collection:nil
+			                            nodeDeleteRules:0];
+			
+			[[transaction ext:@"relationship"] addEdge:edge];
+		}
+		
+		YapDatabaseRelationshipEdge *otherEdge =
+		  [YapDatabaseRelationshipEdge edgeWithName:@"other"
+		                                  sourceKey:@"c"
+		                                 collection:nil
+		                             destinationKey:@"f"
+		                                 collection:nil
+		                            nodeDeleteRules:0];
+		
+		[[transaction ext:@"relationship"] addEdge:otherEdge];
+		
+		// Unprocessed changes (edges are looked up per node)
+		
+		NSMutableArray *keys = [NSMutableArray array];
+		
+		[[transaction ext:@"relationship"] enumerateNodesFromKey:@"a"
+		                                              collection:nil
+		                                                edgeName:@"child"
+		                                               direction:YapDatabaseRelationshipTraversalDirectionOutgoing
+		                                                   order:YapDatabaseRelationshipTraversalOrderBreadthFirst
+		                                                maxDepth:0
+		                                              usingBlock:^(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop)
+		{
+			[keys addObject:key];
+		}];
+		
+		XCTAssertTrue(keys.count == 4, @"keys: %@", keys);
+		XCTAssertTrue([[NSSet setWithArray:keys] isEqualToSet:[NSSet setWithArray:@[ @"b", @"c", @"d", @"e" ]]]);
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSMutableDictionary *depths = [NSMutableDictionary dictionary];
+		
+		// Breadth-first: every reachable node once (despite the cycle), in order of increasing depth
+		
+		__block NSUInteger lastDepth = 0;
+		[[transaction ext:@"relationship"] enumerateNodesFromKey:@"a"
+		                                              collection:nil
+		                                                edgeName:@"child"
+		                                               direction:YapDatabaseRelationshipTraversalDirectionOutgoing
+		                                                   order:YapDatabaseRelationshipTraversalOrderBreadthFirst
+		                                                maxDepth:0
+		                                              usingBlock:^(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop)
+		{
+			XCTAssertNil(depths[key]);
+			XCTAssertTrue(depth >= lastDepth);
+			
+			depths[key] = @(depth);
+			lastDepth = depth;
+		}];
+		
+		XCTAssertEqualObjects(depths, (@{ @"b": @1, @"c": @1, @"d": @2, @"e": @2 }));
+		
+		// Max depth
+		
+		[depths removeAllObjects];
+		[[transaction ext:@"relationship"] enumerateNodesFromKey:@"a"
+		                                              collection:nil
+		                                                edgeName:@"child"
+		                                               direction:YapDatabaseRelationshipTraversalDirectionOutgoing
+		                                                   order:YapDatabaseRelationshipTraversalOrderBreadthFirst
+		                                                maxDepth:1
+		                                              usingBlock:^(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop)
+		{
+			depths[key] = @(depth);
+		}];
+		
+		XCTAssertEqualObjects(depths, (@{ @"b": @1, @"c": @1 }));
+		
+		// Any edge name
+		
+		[depths removeAllObjects];
+		[[transaction ext:@"relationship"] enumerateNodesFromKey:@"c"
+		                                              collection:nil
+		                                                edgeName:nil
+		                                               direction:YapDatabaseRelationshipTraversalDirectionOutgoing
+		                                                   order:YapDatabaseRelationshipTraversalOrderBreadthFirst
+		                                                maxDepth:0
+		                                              usingBlock:^(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop)
+		{
+			depths[key] = @(depth);
+		}];
+		
+		XCTAssertEqualObjects(depths, (@{ @"e": @1, @"f": @1 }));
+		
+		// Incoming
+		
+		[depths removeAllObjects];
+		[[transaction ext:@"relationship"] enumerateNodesFromKey:@"e"
+		                                              collection:nil
+		                                                edgeName:@"child"
+		                                               direction:YapDatabaseRelationshipTraversalDirectionIncoming
+		                                                   order:YapDatabaseRelationshipTraversalOrderBreadthFirst
+		                                                maxDepth:0
+		                                              usingBlock:^(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop)
+		{
+			depths[key] = @(depth);
+		}];
+		
+		XCTAssertEqualObjects(depths, (@{ @"c": @1, @"a": @2, @"d": @3, @"b": @4 }));
+		
+		// Depth-first: a path is followed all the way down before backtracking
+		
+		NSMutableArray *keys = [NSMutableArray array];
+		[[transaction ext:@"relationship"] enumerateNodesFromKey:@"a"
+		                                              collection:nil
+		                                                edgeName:@"child"
+		                                               direction:YapDatabaseRelationshipTraversalDirectionOutgoing
+		                                                   order:YapDatabaseRelationshipTraversalOrderDepthFirst
+		                                                maxDepth:0
+		                                              usingBlock:^(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop)
+		{
+			[keys addObject:key];
+		}];
+		
+		XCTAssertTrue(keys.count == 4, @"keys: %@", keys);
+		
+		NSUInteger b = [keys indexOfObject:@"b"];
+		NSUInteger c = [keys indexOfObject:@"c"];
+		NSUInteger d = [keys indexOfObject:@"d"];
+		NSUInteger e = [keys indexOfObject:@"e"];
+		
+		XCTAssertTrue((d == b + 1) || (e == c + 1), @"keys: %@", keys);
+		
+		// Stop
+		
+		__block NSUInteger count = 0;
+		[[transaction ext:@"relationship"] enumerateNodesFromKey:@"a"
+		                                              collection:nil
+		                                                edgeName:@"child"
+		                                               direction:YapDatabaseRelationshipTraversalDirectionOutgoing
+		                                                   order:YapDatabaseRelationshipTraversalOrderBreadthFirst
+		                                                maxDepth:0
+		                                              usingBlock:^(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop)
+		{
+			count++;
+			*stop = YES;
+		}];
+		
+		XCTAssertTrue(count == 1);
+	}];
+}
+
+- (void)testCascadeDelete
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseRelationship *relationship = [[YapDatabaseRelationship alloc] init];
+	
+	BOOL registered = [database registerExtension:relationship withName:@"relationship"];
+	
+	XCTAssertTrue(registered, @"Error registering extension");
+	
+	// root -> c0..c2 -> c0-g0..c2-g1 (DeleteDestinationIfSourceDeleted)
+	//
+	// c0 & c1 -> shared (DeleteDestinationIfAllSourcesDeleted)
+	// c0 & other -> kept (DeleteDestinationIfAllSourcesDeleted)
+	
+	NSMutableArray *edges = [NSMutableArray array];
+	NSMutableArray *deletedKeys = [NSMutableArray arrayWithObject:@"root"];
+	
+	for (NSUInteger i = 0; i < 3; i++)
+	{
+		NSString *child = [NSString stringWithFormat:@"c%lu", (unsigned long)i];
+		
+		[edges addObject:@[ @"root", child, @(YDB_DeleteDestinationIfSourceDeleted) ]];
+		[deletedKeys addObject:child];
+		
+		for (NSUInteger j = 0; j < 2; j++)
+		{
+			NSString *grandchild = [NSString stringWithFormat:@"%@-g%lu", child, (unsigned long)j];
+			
+			[edges addObject:@[ child, grandchild, @(YDB_DeleteDestinationIfSourceDeleted) ]];
+			[deletedKeys addObject:grandchild];
+		}
+	}
+	
+	[edges addObject:@[ @"c0", @"shared", @(YDB_DeleteDestinationIfAllSourcesDeleted) ]];
+	[edges addObject:@[ @"c1", @"shared", @(YDB_DeleteDestinationIfAllSourcesDeleted) ]];
+	[edges addObject:@[ @"c0", @"kept", @(YDB_DeleteDestinationIfAllSourcesDeleted) ]];
+	[edges addObject:@[ @"other", @"kept", @(YDB_DeleteDestinationIfAllSourcesDeleted) ]];
+	
+	[deletedKeys addObject:@"shared"];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSArray *info in edges)
+		{
+			[transaction setObject:info[0] forKey:info[0] inCollection:nil];
+			[transaction setObject:info[1] forKey:info[1] inCollection:nil];
+			
+			YapDatabaseRelationshipEdge *edge =
+			  [YapDatabaseRelationshipEdge edgeWithName:@"child"
+			                                  sourceKey:info[0]
+			                                 collection:nil
+			                             destinationKey:info[1]
+			                                 collection:nil
+			                            nodeDeleteRules:[info[2] unsignedShortValue]];
+			
+			[[transaction ext:@"relationship"] addEdge:edge];
+		}
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"root" inCollection:nil];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSString *key in deletedKeys)
+		{
+			XCTAssertNil([transaction objectForKey:key inCollection:nil], @"key: %@", key);
+		}
+		
+		XCTAssertNotNil([transaction objectForKey:@"kept" inCollection:nil]);
+		XCTAssertNotNil([transaction objectForKey:@"other" inCollection:nil]);
+		
+		NSUInteger count = [[transaction ext:@"relationship"] edgeCountWithName:@"child"];
+		XCTAssertTrue(count == 1, @"Bad count: %lu", (unsigned long)count);
+	}];
+}
+
+- (void)testInternEdgeNames
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseRelationshipOptions *options = [[YapDatabaseRelationshipOptions alloc] init];
+	options.internEdgeNames = YES;
+	
+	YapDatabaseRelationship *relationship = [[YapDatabaseRelationship alloc] initWithVersionTag:nil options:options];
+	
+	BOOL registered = [database registerExtension:relationship withName:@"relationship"];
+	
+	XCTAssertTrue(registered, @"Error registering extension");
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSString *key in @[ @"a", @"b", @"c" ])
+		{
+			[transaction setObject:key forKey:key inCollection:nil];
+		}
+		
+		NSArray *edges = @[ @[@"child", @"a", @"b"], @[@"child", @"a", @"c"], @[@"friend", @"b", @"c"] ];
+		
+		for (NSArray *info in edges)
+		{
+			YapDatabaseRelationshipEdge *edge =
+			  [YapDatabaseRelationshipEdge edgeWithName:info[0]
+			                                  sourceKey:info[1]
+			                                 collection:nil
+			                             destinationKey:info[2]
+			                                 collection:nil
+			                            nodeDeleteRules:YDB_DeleteDestinationIfSourceDeleted];
+			
+			[[transaction ext:@"relationship"] addEdge:edge];
+		}
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count;
+		
+		count = [[transaction ext:@"relationship"] edgeCountWithName:@"child"];
+		XCTAssertTrue(count == 2, @"Bad count: %lu", (unsigned long)count);
+		
+		count = [[transaction ext:@"relationship"] edgeCountWithName:@"friend"];
+		XCTAssertTrue(count == 1, @"Bad count: %lu", (unsigned long)count);
+		
+		count = [[transaction ext:@"relationship"] edgeCountWithName:@"unknown"];
+		XCTAssertTrue(count == 0, @"Bad count: %lu", (unsigned long)count);
+		
+		NSMutableArray *names = [NSMutableArray array];
+		
+		[[transaction ext:@"relationship"] enumerateEdgesWithName:nil
+		                                                sourceKey:@"a"
+		                                               collection:nil
+		                                               usingBlock:^(YapDatabaseRelationshipEdge *edge, BOOL *stop)
+		{
+			[names addObject:edge.name];
+		}];
+		
+		XCTAssertEqualObjects(names, (@[ @"child", @"child" ]));
+		
+		[names removeAllObjects];
+		[[transaction ext:@"relationship"] enumerateEdgesWithName:@"friend"
+		                                           destinationKey:@"c"
+		                                               collection:nil
+		                                               usingBlock:^(YapDatabaseRelationshipEdge *edge, BOOL *stop)
+		{
+			[names addObject:edge.sourceKey];
+		}];
+		
+		XCTAssertEqualObjects(names, (@[ @"b" ]));
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"a" inCollection:nil];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertNil([transaction objectForKey:@"b" inCollection:nil]);
+		XCTAssertNil([transaction objectForKey:@"c" inCollection:nil]);
+		
+		NSUInteger count;
+		
+		count = [[transaction ext:@"relationship"] edgeCountWithName:@"child"];
+		XCTAssertTrue(count == 0, @"Bad count: %lu", (unsigned long)count);
+		
+		count = [[transaction ext:@"relationship"] edgeCountWithName:@"friend"];
+		XCTAssertTrue(count == 0, @"Bad count: %lu", (unsigned long)count);
+	}];
+}
+
+- (void)testAdjacencyCache
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseRelationshipOptions *options = [[YapDatabaseRelationshipOptions alloc] init];
+	options.edgeCacheLimit = 10;
+	
+	YapDatabaseRelationship *relationship = [[YapDatabaseRelationship alloc] initWithVersionTag:nil options:options];
+	
+	BOOL registered = [database registerExtension:relationship withName:@"relationship"];
+	
+	XCTAssertTrue(registered, @"Error registering extension");
+	
+	NSUInteger (^countEdges)(YapDatabaseReadTransaction *, NSString *) =
+	^NSUInteger (YapDatabaseReadTransaction *transaction, NSString *name) {
+		
+		__block NSUInteger count = 0;
+		[[transaction ext:@"relationship"] enumerateEdgesWithName:name
+		                                                sourceKey:@"a"
+		                                               collection:nil
+		                                               usingBlock:^(YapDatabaseRelationshipEdge *edge, BOOL *stop)
+		{
+			count++;
+		}];
+		
+		return count;
+	};
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSString *key in @[ @"a", @"b", @"c" ])
+		{
+			[transaction setObject:key forKey:key inCollection:nil];
+		}
+	}];
+	
+	// Populate the cache of connection2 (with negative entries)
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue(countEdges(transaction, nil) == 0);
+		XCTAssertTrue(countEdges(transaction, @"child") == 0);
+		XCTAssertTrue(countEdges(transaction, nil) == 0);
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSString *key in @[ @"b", @"c" ])
+		{
+			YapDatabaseRelationshipEdge *edge =
+			  [YapDatabaseRelationshipEdge edgeWithName:@"child"
+			                                  sourceKey:@"a"
+			                                 collection:nil
+			                             destinationKey:key
+			                                 collection:nil
+			                            nodeDeleteRules:0];
+			
+			[[transaction ext:@"relationship"] addEdge:edge];
+		}
+	}];
+	
+	// The negative entries must be invalidated by the changeset from connection1
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue(countEdges(transaction, nil) == 2);
+		XCTAssertTrue(countEdges(transaction, @"child") == 2);
+		XCTAssertTrue(countEdges(transaction, @"child") == 2); // cached
+		XCTAssertTrue(countEdges(transaction, @"friend") == 0);
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"b" inCollection:nil];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue(countEdges(transaction, nil) == 1);
+		XCTAssertTrue(countEdges(transaction, @"child") == 1);
+	}];
+}
+
+- (void)testDeferredFileDeletion
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database);
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	
+	__block BOOL deferFileDeletion = YES;
+	
+	YapDatabaseRelationshipOptions *options = [[YapDatabaseRelationshipOptions alloc] init];
+	options.fileDeletionBatchSize = 2;
+	options.fileDeletionConcurrency = 2;
+	options.fileDeletionQualityOfService = NSQualityOfServiceBackground;
+	options.fileDeletionDeferral = ^BOOL (void){
+		
+		@synchronized (self) {
+			return deferFileDeletion;
+		}
+	};
+	
+	YapDatabaseRelationship *relationship = [[YapDatabaseRelationship alloc] initWithVersionTag:nil options:options];
+	
+	BOOL registered = [database registerExtension:relationship withName:@"relationship"];
+	
+	XCTAssertTrue(registered, @"Error registering extension");
+	
+	NSArray<NSURL *> *fileURLs = @[ [self randomFileURL], [self randomFileURL], [self randomFileURL] ];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"key1" forKey:@"key1" inCollection:nil];
+		
+		for (NSURL *fileURL in fileURLs)
+		{
+			YapDatabaseRelationshipEdge *edge =
+			  [YapDatabaseRelationshipEdge edgeWithName:@"file"
+			                                  sourceKey:@"key1"
+			                                 collection:nil
+			                         destinationFileURL:fileURL
+			                            nodeDeleteRules:YDB_DeleteDestinationIfSourceDeleted];
+			
+			[[transaction ext:@"relationship"] addEdge:edge];
+		}
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"key1" inCollection:nil];
+	}];
+	
+	// Make sure the files still exist (deletion is deferred)
+	
+	[NSThread sleepForTimeInterval:1.0];
+	
+	for (NSURL *fileURL in fileURLs)
+	{
+		BOOL exists = [[NSFileManager defaultManager] fileExistsAtPath:[fileURL path]];
+		XCTAssertTrue(exists);
+	}
+	
+	@synchronized (self) {
+		deferFileDeletion = NO;
+	}
+	[relationship resumeFileDeletion];
+	
+	// Make sure the files were deleted
+	
+	[NSThread sleepForTimeInterval:1.0];
+	
+	for (NSURL *fileURL in fileURLs)
+	{
+		BOOL exists = [[NSFileManager defaultManager] fileExistsAtPath:[fileURL path]];
+		XCTAssertTrue(!exists);
+	}
+}
+
 @end
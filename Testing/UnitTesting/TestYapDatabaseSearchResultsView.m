@@ -402,6 +402,25 @@
 		
 		NSUInteger count = [[transaction ext:@"searchResults"] numberOfItemsInGroup:@""];
 		XCTAssertTrue(count == expectedQueryResults, @"Bad count: %lu", (unsigned long)count);
+		
+		if (searchViewOptions.snippetOptions)
+		{
+			// Batched (and cached) snippets must match the ones generated one row at a time
+			
+			[[transaction ext:@"searchResults"] prefetchSnippetsInRange:NSMakeRange(0, count) inGroup:@""];
+			
+			NSMutableArray<YapCollectionKey *> *collectionKeys = [snippets.allKeys mutableCopy];
+			[collectionKeys addObject:YapCollectionKeyCreate(nil, @"3")]; // doesn't match the query
+			
+			NSDictionary *batchSnippets = [[transaction ext:@"searchResults"] snippetsForCollectionKeys:collectionKeys];
+			XCTAssertEqualObjects(batchSnippets, snippets);
+			
+			[snippets enumerateKeysAndObjectsUsingBlock:^(YapCollectionKey *ck, NSString *snippet, BOOL *stop) {
+				
+				NSString *cachedSnippet = [[transaction ext:@"searchResults"] snippetForKey:ck.key inCollection:ck.collection];
+				XCTAssertEqualObjects(cachedSnippet, snippet);
+			}];
+		}
 	}];
 	
 	// Perform another query, and make sure the snippets change
@@ -507,4 +526,232 @@
 	}];
 }
 
+- (void)testRefinedQuery
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"]
+	                                                 handler:handler
+	                                              versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:fts withName:@"fts"], @"");
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	        NSString *collection1, NSString *key1,
+	        NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2];
+	}];
+	
+	YapDatabaseSearchResultsView *searchResultsView =
+	  [[YapDatabaseSearchResultsView alloc] initWithFullTextSearchName:@"fts"
+	                                                          grouping:grouping
+	                                                           sorting:sorting
+	                                                        versionTag:@"1"
+	                                                           options:nil];
+	
+	XCTAssertTrue([database registerExtension:searchResultsView withName:@"searchResults"], @"");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"The duck quacks at midnight" forKey:@"0" inCollection:nil];
+		[transaction setObject:@"How deep the rabbit hole goes" forKey:@"1" inCollection:nil];
+		[transaction setObject:@"Why does he keep doing it" forKey:@"2" inCollection:nil];
+		[transaction setObject:@"I am enjoying my coffee" forKey:@"3" inCollection:nil];
+	}];
+	
+	YapDatabaseSearchQueue *searchQueue = [[YapDatabaseSearchQueue alloc] init];
+	
+	[searchQueue enqueueQuery:@"d*"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"searchResults"] performSearchWithQueue:searchQueue];
+		
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 3, @"");
+	}];
+	
+	// The user types another character
+	
+	[searchQueue enqueueQuery:@"de*" isRefinement:YES];
+	[searchQueue enqueueQuery:@"dee*" isRefinement:YES];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"searchResults"] performSearchWithQueue:searchQueue];
+		
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 1, @"");
+		XCTAssertEqualObjects([[transaction ext:@"searchResults"] query], @"dee*", @"");
+		
+		NSString *key = nil;
+		[[transaction ext:@"searchResults"] getFirstKey:&key collection:NULL inGroup:@""];
+		
+		XCTAssertEqualObjects(key, @"1", @"");
+	}];
+	
+	// A query that isn't a refinement (the user cleared the search field)
+	
+	[searchQueue enqueueQuery:@"the" isRefinement:NO];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"searchResults"] performSearchWithQueue:searchQueue];
+		
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 2, @"");
+	}];
+	
+	// Appending a plain term is detected automatically
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"searchResults"] performSearchFor:@"the rabbit"];
+		
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 1, @"");
+		
+		// New rows matching the refined query still show up
+		
+		[transaction setObject:@"Follow the white rabbit" forKey:@"4" inCollection:nil];
+		
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 2, @"");
+	}];
+}
+
+- (void)testEnqueueAbortsSearchInProgress
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"content"];
+	}];
+	
+	YapDatabaseFullTextSearch *fts =
+	  [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[@"content"]
+	                                                 handler:handler
+	                                              versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:fts withName:@"fts"], @"");
+	
+	YapDatabaseSearchQueue *searchQueue = [[YapDatabaseSearchQueue alloc] init];
+	searchQueue.abortsSearchInProgressOnEnqueue = YES;
+	
+	// The grouping block is invoked (by the search) for rows that aren't yet in the view.
+	// So we use it to simulate the user typing while a search is in progress.
+	
+	__block NSString *typedQuery = nil;
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		if (typedQuery)
+		{
+			[searchQueue enqueueQuery:typedQuery];
+			typedQuery = nil;
+		}
+		
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	        NSString *collection1, NSString *key1,
+	        NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2];
+	}];
+	
+	YapDatabaseSearchResultsView *searchResultsView =
+	  [[YapDatabaseSearchResultsView alloc] initWithFullTextSearchName:@"fts"
+	                                                          grouping:grouping
+	                                                           sorting:sorting
+	                                                        versionTag:@"1"
+	                                                           options:nil];
+	
+	XCTAssertTrue([database registerExtension:searchResultsView withName:@"searchResults"], @"");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@"The duck quacks at midnight" forKey:@"0" inCollection:nil];
+		[transaction setObject:@"How deep the rabbit hole goes" forKey:@"1" inCollection:nil];
+		[transaction setObject:@"Are you gonna stay the night" forKey:@"2" inCollection:nil];
+	}];
+	
+	[searchQueue enqueueQuery:@"duck"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"searchResults"] performSearchWithQueue:searchQueue];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 1, @"");
+	}];
+	
+	// A newer query is enqueued while the search for "the" is in progress
+	
+	[searchQueue enqueueQuery:@"the"];
+	typedQuery = @"rabbit";
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"searchResults"] performSearchWithQueue:searchQueue];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		// The aborted search was rolled back
+		
+		XCTAssertEqualObjects([[transaction ext:@"searchResults"] query], @"duck", @"");
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 1, @"");
+	}];
+	
+	XCTAssertTrue([searchQueue enqueuedQueryCount] == 1, @"");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"searchResults"] performSearchWithQueue:searchQueue];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([[transaction ext:@"searchResults"] query], @"rabbit", @"");
+		XCTAssertTrue([[transaction ext:@"searchResults"] numberOfItemsInGroup:@""] == 1, @"");
+		
+		NSString *key = nil;
+		[[transaction ext:@"searchResults"] getFirstKey:&key collection:NULL inGroup:@""];
+		
+		XCTAssertEqualObjects(key, @"1", @"");
+	}];
+}
+
 @end
@@ -453,4 +453,982 @@
 	}];
 }
 
+- (void)testIncrementalPopulation
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndexOptions *options = [[YapDatabaseSecondaryIndexOptions alloc] init];
+	options.populationChunkSize = 10;
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1" options:options];
+	
+	BOOL registered = [database registerExtension:secondaryIndex withName:@"idx"];
+	XCTAssertTrue(registered, @"Failure registering extension");
+	
+	// Changes made during the population must not be lost (or counted twice)
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 100; i < 110; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+		
+		[transaction setObject:@(1000) forKey:@"key0" inCollection:nil];
+		[transaction removeObjectForKey:@"key99" inCollection:nil];
+	}];
+	
+	__block BOOL isPopulating = YES;
+	NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:10.0];
+	
+	while (isPopulating && [deadline timeIntervalSinceNow] > 0)
+	{
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			isPopulating = [[transaction ext:@"idx"] isPopulating];
+		}];
+		
+		if (isPopulating) {
+			[NSThread sleepForTimeInterval:0.01];
+		}
+	}
+	
+	XCTAssertFalse(isPopulating, @"Population didn't complete");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count = 0;
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value >= 0"];
+		
+		BOOL result = [[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+		XCTAssertTrue(result, @"");
+		XCTAssertTrue(count == 109, @"Expected 109, got %lu", (unsigned long)count);
+		
+		count = 0;
+		query = [YapDatabaseQuery queryWithFormat:@"WHERE value = ?", @(1000)];
+		
+		[[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+		XCTAssertTrue(count == 1, @"Expected 1, got %lu", (unsigned long)count);
+	}];
+}
+
+- (void)testSlowQueryLog
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	XCTAssertTrue(database.slowQueryThreshold == 0.0);
+	XCTAssertTrue(database.slowQuerySampleRate == 1.0);
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object)
+	{
+		[dict setObject:object forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex = [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler];
+	[database registerExtension:secondaryIndex withName:@"idx"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+	}];
+	
+	dispatch_queue_t handlerQueue = dispatch_queue_create("testSlowQueryLog", DISPATCH_QUEUE_SERIAL);
+	NSMutableArray<YapDatabaseSlowQuery *> *slowQueries = [NSMutableArray array];
+	
+	[database setSlowQueryHandler:^(YapDatabaseSlowQuery *slowQuery) {
+		
+		[slowQueries addObject:slowQuery];
+		
+	} queue:handlerQueue];
+	
+	// Every query is slower than a nanosecond
+	
+	database.slowQueryThreshold = 0.000000001;
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count = 0;
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value >= ?", @(50)];
+		
+		[[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+		XCTAssertTrue(count == 50, @"Expected 50, got %lu", (unsigned long)count);
+		
+		__block NSUInteger enumerated = 0;
+		query = [YapDatabaseQuery queryWithFormat:@"WHERE value < ?", @(10)];
+		
+		[[transaction ext:@"idx"] enumerateKeysMatchingQuery:query usingBlock:
+		    ^(NSString *collection, NSString *key, BOOL *stop)
+		{
+			enumerated++;
+		}];
+		XCTAssertTrue(enumerated == 10, @"Expected 10, got %lu", (unsigned long)enumerated);
+	}];
+	
+	dispatch_sync(handlerQueue, ^{});
+	
+	XCTAssertTrue([slowQueries count] == 2, @"Expected 2, got %lu", (unsigned long)[slowQueries count]);
+	
+	YapDatabaseSlowQuery *enumerateQuery = [slowQueries lastObject];
+	XCTAssertEqualObjects(enumerateQuery.extensionName, @"idx");
+	XCTAssertTrue([enumerateQuery.sql rangeOfString:@"value < ?"].location != NSNotFound);
+	XCTAssertEqualObjects(enumerateQuery.parameterShapes, @[ @"integer" ]);
+	XCTAssertTrue([enumerateQuery.queryPlan count] > 0);
+	XCTAssertTrue(enumerateQuery.rowCount == 10);
+	XCTAssertTrue(enumerateQuery.duration > 0.0);
+	
+	// Sampling none of the queries disables the log
+	
+	database.slowQuerySampleRate = 0.0;
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count = 0;
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value >= ?", @(50)];
+		
+		[[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+	}];
+	
+	dispatch_sync(handlerQueue, ^{});
+	XCTAssertTrue([slowQueries count] == 2, @"Expected 2, got %lu", (unsigned long)[slowQueries count]);
+	
+	database.slowQueryThreshold = 0.0;
+	[database setSlowQueryHandler:nil queue:nil];
+}
+
+- (void)testTruncateCollection
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+	
+	BOOL registered = [database registerExtension:secondaryIndex withName:@"idx"];
+	XCTAssertTrue(registered, @"Failure registering extension");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"cache"];
+		}
+		for (int i = 0; i < 10; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:@"keep"];
+		}
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction truncateCollection:@"cache"];
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"cache"] == 0);
+		XCTAssertNil([transaction objectForKey:@"key0" inCollection:@"cache"]);
+		XCTAssertNotNil([transaction objectForKey:@"key0" inCollection:@"keep"]);
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count = 0;
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value >= 0"];
+		
+		BOOL result = [[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+		XCTAssertTrue(result, @"");
+		XCTAssertTrue(count == 10, @"Expected 10, got %lu", (unsigned long)count);
+		
+		XCTAssertTrue([transaction numberOfKeysInCollection:@"keep"] == 10);
+	}];
+}
+
+- (void)testInMemory
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
+	options.inMemory = YES;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath options:options];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+	
+	BOOL registered = [database registerExtension:secondaryIndex withName:@"idx"];
+	XCTAssertTrue(registered, @"Failure registering extension");
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+	}];
+	
+	// Snapshots work as usual
+	
+	[connection2 beginLongLivedReadTransaction];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeObjectForKey:@"key0" inCollection:nil];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count = 0;
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value < 10"];
+		
+		BOOL result = [[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+		XCTAssertTrue(result, @"");
+		XCTAssertTrue(count == 10, @"Expected 10, got %lu", (unsigned long)count);
+	}];
+	
+	[connection2 endLongLivedReadTransaction];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count = 0;
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value < 10"];
+		
+		BOOL result = [[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+		XCTAssertTrue(result, @"");
+		XCTAssertTrue(count == 9, @"Expected 9, got %lu", (unsigned long)count);
+	}];
+	
+	// Nothing is written to the path
+	
+	XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:databasePath]);
+	XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[databasePath stringByAppendingString:@"-wal"]]);
+}
+
+- (void)testCompositeIndexes
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object)
+	{
+		__unsafe_unretained NSDictionary *message = (NSDictionary *)object;
+		
+		dict[@"threadId"] = message[@"threadId"];
+		dict[@"date"]     = message[@"date"];
+		dict[@"unread"]   = message[@"unread"];
+	}];
+	
+	YapDatabaseSecondaryIndexSetup *(^makeSetup)(BOOL) = ^(BOOL withPartialIndex){
+		
+		YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+		[setup addColumn:@"threadId" withType:YapDatabaseSecondaryIndexTypeInteger];
+		[setup addColumn:@"date" withType:YapDatabaseSecondaryIndexTypeReal];
+		[setup addColumn:@"unread" withType:YapDatabaseSecondaryIndexTypeInteger];
+		
+		[setup addIndexWithName:@"thread_date"
+		                columns:@[ @"threadId", @"date" ]
+		             sortOrders:@[ @(YapDatabaseSecondaryIndexSortOrderAscending),
+		                           @(YapDatabaseSecondaryIndexSortOrderDescending) ]
+		        coveringColumns:@[ @"unread" ]
+		              predicate:nil];
+		
+		if (withPartialIndex)
+		{
+			[setup addIndexWithName:@"unread_date"
+			                columns:@[ @"date" ]
+			             sortOrders:nil
+			        coveringColumns:nil
+			              predicate:@"unread = 1"];
+		}
+		
+		return setup;
+	};
+	
+	YapDatabaseSecondaryIndexSetup *setup = makeSetup(YES);
+	XCTAssertTrue([[setup indexes] count] == 2);
+	
+	void (^checkQueries)(YapDatabaseConnection *) = ^(YapDatabaseConnection *connection){
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			NSMutableArray *keys = [NSMutableArray array];
+			
+			YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE threadId = ? ORDER BY date DESC", @(1)];
+			[[transaction ext:@"idx"] enumerateKeysMatchingQuery:query usingBlock:
+			    ^(NSString *collection, NSString *key, BOOL *stop)
+			{
+				[keys addObject:key];
+			}];
+			
+			XCTAssertEqualObjects(keys, (@[ @"m9", @"m7", @"m5", @"m3", @"m1" ]));
+			
+			NSUInteger count = 0;
+			query = [YapDatabaseQuery queryWithFormat:@"WHERE unread = 1"];
+			
+			XCTAssertTrue([[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query]);
+			XCTAssertTrue(count == 4, @"Expected 4, got %lu", (unsigned long)count);
+		}];
+	};
+	
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database, @"Oops");
+		
+		YapDatabaseSecondaryIndex *secondaryIndex =
+		  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+		
+		XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+		
+		YapDatabaseConnection *connection = [database newConnection];
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (int i = 0; i < 10; i++)
+			{
+				NSDictionary *message = @{ @"threadId":@(i % 2), @"date":@(i), @"unread":@((i % 3) == 0) };
+				
+				[transaction setObject:message forKey:[NSString stringWithFormat:@"m%d", i] inCollection:@"messages"];
+			}
+		}];
+		
+		checkQueries(connection);
+	}
+	
+	// Changing the declared indexes doesn't require a new versionTag.
+	// The indexes are migrated when the extension is registered (and the table isn't re-populated).
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	__block NSUInteger handlerCount = 0;
+	YapDatabaseSecondaryIndexHandler *countingHandler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object)
+	{
+		handlerCount++;
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:makeSetup(NO) handler:countingHandler versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+	XCTAssertTrue(handlerCount == 0, @"Table was re-populated");
+	
+	checkQueries([database newConnection]);
+}
+
+- (void)testCompiledQuery
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 100; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseQuery *template = [YapDatabaseQuery queryWithFormat:@"WHERE value < ?", @(0)];
+	YapDatabaseQuery *aggregateTemplate =
+	  [YapDatabaseQuery queryWithAggregateFunction:@"SUM(value)" format:@"WHERE value < ?", @(0)];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (int max = 0; max <= 100; max += 10)
+		{
+			YapDatabaseQuery *query = [template queryWithParameters:@[ @(max) ]];
+			XCTAssertEqualObjects(query.queryString, template.queryString);
+			
+			NSUInteger count = 0;
+			XCTAssertTrue([[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query]);
+			XCTAssertTrue(count == (NSUInteger)max, @"Expected %d, got %lu", max, (unsigned long)count);
+			
+			__block NSUInteger enumerated = 0;
+			[[transaction ext:@"idx"] enumerateKeysMatchingQuery:query usingBlock:
+			    ^(NSString *collection, NSString *key, BOOL *stop)
+			{
+				enumerated++;
+			}];
+			XCTAssertTrue(enumerated == (NSUInteger)max);
+			
+			query = [aggregateTemplate queryWithParameters:@[ @(max) ]];
+			XCTAssertTrue(query.isAggregateQuery);
+			
+			NSNumber *sum = [[transaction ext:@"idx"] performAggregateQuery:query];
+			NSInteger expectedSum = (max > 0) ? ((max - 1) * max / 2) : 0;
+			XCTAssertTrue([sum integerValue] == expectedSum, @"Expected %ld, got %@", (long)expectedSum, sum);
+		}
+	}];
+	
+	// Array parameters expand the queryString, so they get a query of their own
+	
+	YapDatabaseQuery *inTemplate = [YapDatabaseQuery queryWithFormat:@"WHERE value IN (?)", @[ @(1), @(2) ]];
+	XCTAssertEqualObjects(inTemplate.queryString, @"WHERE value IN (?,?)");
+	
+	YapDatabaseQuery *inQuery = [inTemplate queryWithParameters:@[ @[ @(1), @(2), @(3) ] ]];
+	XCTAssertEqualObjects(inQuery.queryString, @"WHERE value IN (?,?,?)");
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger count = 0;
+		XCTAssertTrue([[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:inQuery]);
+		XCTAssertTrue(count == 3, @"Expected 3, got %lu", (unsigned long)count);
+	}];
+}
+
+- (void)testUnchangedValues
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"name" withType:YapDatabaseSecondaryIndexTypeText];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeReal];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		NSDictionary *values = (NSDictionary *)object;
+		
+		if (values[@"name"])  [dict setObject:values[@"name"] forKey:@"name"];
+		if (values[@"value"]) [dict setObject:values[@"value"] forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+	
+	NSUInteger (^countMatching)(YapDatabaseQuery *) = ^NSUInteger (YapDatabaseQuery *query){
+		
+		__block NSUInteger count = 0;
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			[[transaction ext:@"idx"] getNumberOfRows:&count matchingQuery:query];
+		}];
+		
+		return count;
+	};
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"name":@"abc", @"value":@(1.5), @"other":@(1) } forKey:@"key" inCollection:nil];
+	}];
+	
+	// Update unindexed values only (the index row is left as is)
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"name":@"abc", @"value":@(1.5), @"other":@(2) } forKey:@"key" inCollection:nil];
+	}];
+	
+	XCTAssertTrue(countMatching([YapDatabaseQuery queryWithFormat:@"WHERE name = ? AND value = ?", @"abc", @(1.5)]) == 1);
+	
+	// Changes that compare loosely equal must still be written
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"name":@"ABC", @"value":@(1.5) } forKey:@"key" inCollection:nil];
+	}];
+	
+	XCTAssertTrue(countMatching([YapDatabaseQuery queryWithFormat:@"WHERE name = ?", @"abc"]) == 0);
+	XCTAssertTrue(countMatching([YapDatabaseQuery queryWithFormat:@"WHERE name = ?", @"ABC"]) == 1);
+	
+	// A value that's removed becomes NULL
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"name":@"ABC" } forKey:@"key" inCollection:nil];
+	}];
+	
+	XCTAssertTrue(countMatching([YapDatabaseQuery queryWithFormat:@"WHERE value IS NULL"]) == 1);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"name":@"ABC", @"value":@(2.5) } forKey:@"key" inCollection:nil];
+	}];
+	
+	XCTAssertTrue(countMatching([YapDatabaseQuery queryWithFormat:@"WHERE value = ?", @(2.5)]) == 1);
+	
+	// The row was removed from the index (no values), so it must be re-inserted
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"other":@(3) } forKey:@"key" inCollection:nil];
+	}];
+	
+	XCTAssertTrue(countMatching([YapDatabaseQuery queryWithFormat:@"WHERE name = ?", @"ABC"]) == 0);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"name":@"ABC", @"value":@(2.5) } forKey:@"key" inCollection:nil];
+	}];
+	
+	XCTAssertTrue(countMatching([YapDatabaseQuery queryWithFormat:@"WHERE name = ? AND value = ?", @"ABC", @(2.5)]) == 1);
+}
+
+- (void)testBatchedEnumeration
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		[dict setObject:object forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+	
+	int const count = 175; // not a multiple of the batch size
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < count; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%d", i] inCollection:nil
+			          withMetadata:@(-i)];
+		}
+	}];
+	
+	[connection flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Caches];
+	
+	YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value >= ? ORDER BY value DESC", @(0)];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		__block int expected = count - 1;
+		[[transaction ext:@"idx"] enumerateRowsMatchingQuery:query usingBlock:
+		    ^(NSString *collection, NSString *key, id object, id metadata, BOOL *stop)
+		{
+			XCTAssertEqualObjects(key, ([NSString stringWithFormat:@"key%d", expected]));
+			XCTAssertEqualObjects(object, @(expected));
+			XCTAssertEqualObjects(metadata, @(-expected));
+			expected--;
+		}];
+		XCTAssertTrue(expected == -1, @"Enumerated %d rows", (count - 1 - expected));
+		
+		__block NSUInteger enumerated = 0;
+		[[transaction ext:@"idx"] enumerateKeysAndObjectsMatchingQuery:query usingBlock:
+		    ^(NSString *collection, NSString *key, id object, BOOL *stop)
+		{
+			if (++enumerated == 60) *stop = YES;
+		}];
+		XCTAssertTrue(enumerated == 60);
+		
+		__block NSUInteger rowidCount = 0;
+		BOOL result = [[transaction ext:@"idx"] enumerateRowidsMatchingQuery:query usingBlock:
+		    ^(int64_t rowid, BOOL *stop)
+		{
+			rowidCount++;
+		}];
+		XCTAssertTrue(result);
+		XCTAssertTrue(rowidCount == (NSUInteger)count);
+	}];
+}
+
+- (void)testMaterializedAggregates
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"account" withType:YapDatabaseSecondaryIndexTypeText];
+	[setup addColumn:@"amount" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	[setup addAggregateWithName:@"balance"
+	                   function:YapDatabaseSecondaryIndexAggregateFunctionSum
+	                     column:@"amount"
+	              groupByColumn:@"account"];
+	
+	[setup addAggregateWithName:@"count"
+	                   function:YapDatabaseSecondaryIndexAggregateFunctionCount
+	                     column:nil
+	              groupByColumn:@"account"];
+	
+	[setup addAggregateWithName:@"min"
+	                   function:YapDatabaseSecondaryIndexAggregateFunctionMin
+	                     column:@"amount"
+	              groupByColumn:nil];
+	
+	[setup addAggregateWithName:@"max"
+	                   function:YapDatabaseSecondaryIndexAggregateFunctionMax
+	                     column:@"amount"
+	              groupByColumn:nil];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		NSDictionary *values = (NSDictionary *)object;
+		
+		[dict setObject:values[@"account"] forKey:@"account"];
+		[dict setObject:values[@"amount"] forKey:@"amount"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"account":@"a", @"amount":@(10) } forKey:@"1" inCollection:nil];
+		[transaction setObject:@{ @"account":@"a", @"amount":@(-3) } forKey:@"2" inCollection:nil];
+		[transaction setObject:@{ @"account":@"b", @"amount":@(7) }  forKey:@"3" inCollection:nil];
+		[transaction setObject:@{ @"account":@"b", @"amount":@(20) } forKey:@"4" inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseSecondaryIndexTransaction *idx = [transaction ext:@"idx"];
+		
+		XCTAssertEqualObjects([idx valueForAggregate:@"balance" group:@"a"], @(7));
+		XCTAssertEqualObjects([idx valueForAggregate:@"balance" group:@"b"], @(27));
+		XCTAssertNil([idx valueForAggregate:@"balance" group:@"c"]);
+		
+		XCTAssertEqualObjects([idx valueForAggregate:@"count" group:@"a"], @(2));
+		XCTAssertEqualObjects([idx valueForAggregate:@"count" group:@"c"], @(0));
+		
+		XCTAssertEqualObjects([idx valueForAggregate:@"min" group:nil], @(-3));
+		XCTAssertEqualObjects([idx valueForAggregate:@"max" group:nil], @(20));
+		
+		NSMutableDictionary *balances = [NSMutableDictionary dictionary];
+		[idx enumerateGroupsForAggregate:@"balance" usingBlock:^(id group, id value, BOOL *stop) {
+			
+			balances[group] = value;
+		}];
+		
+		XCTAssertEqualObjects(balances, (@{ @"a":@(7), @"b":@(27) }));
+	}];
+	
+	// Update a row (moving it to another group), and remove the rows with the extreme values
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@{ @"account":@"b", @"amount":@(10) } forKey:@"1" inCollection:nil];
+		[transaction removeObjectForKey:@"2" inCollection:nil];
+		[transaction removeObjectForKey:@"4" inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseSecondaryIndexTransaction *idx = [transaction ext:@"idx"];
+		
+		XCTAssertNil([idx valueForAggregate:@"balance" group:@"a"]);
+		XCTAssertEqualObjects([idx valueForAggregate:@"count" group:@"a"], @(0));
+		
+		XCTAssertEqualObjects([idx valueForAggregate:@"balance" group:@"b"], @(17));
+		XCTAssertEqualObjects([idx valueForAggregate:@"count" group:@"b"], @(2));
+		
+		XCTAssertEqualObjects([idx valueForAggregate:@"min" group:nil], @(7));
+		XCTAssertEqualObjects([idx valueForAggregate:@"max" group:nil], @(10));
+	}];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction removeAllObjectsInAllCollections];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseSecondaryIndexTransaction *idx = [transaction ext:@"idx"];
+		
+		XCTAssertEqualObjects([idx valueForAggregate:@"count" group:@"b"], @(0));
+		XCTAssertNil([idx valueForAggregate:@"max" group:nil]);
+	}];
+}
+
+- (void)testConcurrentEvaluation
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		// Odd values aren't indexed
+		if ([object intValue] % 2 == 0) {
+			[dict setObject:object forKey:@"value"];
+		}
+	}];
+	
+	YapDatabaseSecondaryIndexOptions *options = [[YapDatabaseSecondaryIndexOptions alloc] init];
+	options.allowsConcurrentEvaluation = YES;
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1" options:options];
+	
+	XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+	
+	NSUInteger const count = 1000; // multiple chunks, not a multiple of the chunk size
+	
+	NSMutableArray *objects = [NSMutableArray arrayWithCapacity:count];
+	NSMutableArray *keys = [NSMutableArray arrayWithCapacity:count];
+	
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[objects addObject:@(i)];
+		[keys addObject:[NSString stringWithFormat:@"key%lu", (unsigned long)i]];
+	}
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObjects:objects forKeys:keys inCollection:nil];
+	}];
+	
+	YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value >= ?", @(0)];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger matches = 0;
+		XCTAssertTrue([[transaction ext:@"idx"] getNumberOfRows:&matches matchingQuery:query]);
+		XCTAssertTrue(matches == (count / 2), @"matches = %lu", (unsigned long)matches);
+	}];
+	
+	// Update the batch: shift every value by one, so the odd rows are now indexed (and the even rows removed)
+	
+	NSMutableArray *shiftedObjects = [NSMutableArray arrayWithCapacity:count];
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[shiftedObjects addObject:@(i + 1)];
+	}
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObjects:shiftedObjects forKeys:keys inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger matches = 0;
+		XCTAssertTrue([[transaction ext:@"idx"] getNumberOfRows:&matches matchingQuery:query]);
+		XCTAssertTrue(matches == (count / 2), @"matches = %lu", (unsigned long)matches);
+		
+		__block NSUInteger enumerated = 0;
+		[[transaction ext:@"idx"] enumerateKeysAndObjectsMatchingQuery:query usingBlock:
+		    ^(NSString *collection, NSString *key, id object, BOOL *stop)
+		{
+			XCTAssertTrue([object intValue] % 2 == 0);
+			enumerated++;
+		}];
+		XCTAssertTrue(enumerated == (count / 2));
+	}];
+}
+
+- (void)testBulkLoad
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
+	[setup addColumn:@"value" withType:YapDatabaseSecondaryIndexTypeInteger];
+	
+	[setup addAggregateWithName:@"total"
+	                   function:YapDatabaseSecondaryIndexAggregateFunctionSum
+	                     column:@"value"
+	              groupByColumn:nil];
+	
+	__block NSUInteger handlerCount = 0;
+	
+	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object){
+		
+		handlerCount++;
+		[dict setObject:object forKey:@"value"];
+	}];
+	
+	YapDatabaseSecondaryIndex *secondaryIndex =
+	  [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:secondaryIndex withName:@"idx"], @"Failure registering extension");
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@(1) forKey:@"existing1" inCollection:nil];
+		[transaction setObject:@(2) forKey:@"existing2" inCollection:nil];
+	}];
+	
+	NSUInteger const count = 1000;
+	YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:@"WHERE value >= ?", @(0)];
+	
+	handlerCount = 0;
+	
+	[connection1 bulkLoadWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key%lu", (unsigned long)i] inCollection:nil];
+		}
+		[transaction removeObjectForKey:@"existing2" inCollection:nil];
+		
+		// The row hooks are suspended
+		XCTAssertTrue(handlerCount == 0, @"handlerCount = %lu", (unsigned long)handlerCount);
+		
+		// Other connections still see the previous state
+		[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			NSUInteger matches = 0;
+			XCTAssertTrue([[transaction ext:@"idx"] getNumberOfRows:&matches matchingQuery:query]);
+			XCTAssertTrue(matches == 2, @"matches = %lu", (unsigned long)matches);
+		}];
+	}];
+	
+	// Rebuilt from every row
+	XCTAssertTrue(handlerCount == (count + 1), @"handlerCount = %lu", (unsigned long)handlerCount);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseSecondaryIndexTransaction *idx = [transaction ext:@"idx"];
+		
+		NSUInteger matches = 0;
+		XCTAssertTrue([idx getNumberOfRows:&matches matchingQuery:query]);
+		XCTAssertTrue(matches == (count + 1), @"matches = %lu", (unsigned long)matches);
+		
+		NSUInteger expectedTotal = 1 + (count * (count - 1) / 2);
+		XCTAssertEqualObjects([idx valueForAggregate:@"total" group:nil], @(expectedTotal));
+	}];
+	
+	// The row hooks are processed as usual afterwards
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@(-1) forKey:@"key0" inCollection:nil];
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSUInteger matches = 0;
+		XCTAssertTrue([[transaction ext:@"idx"] getNumberOfRows:&matches matchingQuery:query]);
+		XCTAssertTrue(matches == count, @"matches = %lu", (unsigned long)matches);
+	}];
+}
+
 @end
@@ -3,6 +3,8 @@
 #import "YapDatabase.h"
 #import "YapDatabaseView.h"
 #import "YapDatabaseAutoView.h"
+#import "YapDatabaseManualView.h"
+#import "YapDatabaseViewPage.h"
 
 #import <CocoaLumberjack/CocoaLumberjack.h>
 #import <CocoaLumberjack/DDTTYLogger.h>
@@ -603,7 +605,7 @@
 			index++;
 		}
 	}];
-
+	
 	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction){
 		
 		// Test remove multiple objects
@@ -719,7 +721,7 @@
 			index++;
 		}
 	}];
-
+	
 	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction){
 		
 		// Test remove all objects
@@ -732,7 +734,7 @@
 		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@""] == keysCount, @"Wrong count");
 		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInAllGroups] == keysCount, @"Wrong count");
 	}];
-
+	
 	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction){
 		
 		// Read changes from other connection
@@ -1258,6 +1260,43 @@
 	[self _testMultiPage_withPath:databasePath options:options];
 }
 
+- (void)testMultiPage_smallFixedPageSize
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.isPersistent = YES;
+	options.pageSizing = YapDatabaseViewPageSizingFixed;
+	options.pageSize = 4;
+	
+	[self _testMultiPage_withPath:databasePath options:options];
+}
+
+- (void)testMultiPage_adaptivePageSizing
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.isPersistent = YES;
+	options.pageSizing = YapDatabaseViewPageSizingAdaptive;
+	options.pageSize = 2;
+	
+	[self _testMultiPage_withPath:databasePath options:options];
+}
+
+- (void)testMultiPage_rowidMapInMemory
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.isPersistent = YES;
+	options.pageSizing = YapDatabaseViewPageSizingFixed;
+	options.pageSize = 4;
+	options.keepsRowidMapInMemory = YES;
+	
+	[self _testMultiPage_withPath:databasePath options:options];
+}
+
 - (void)_testMultiPage_withPath:(NSString *)databasePath options:(YapDatabaseViewOptions *)options
 {
 	//
@@ -1465,7 +1504,7 @@
 			             @"Key mismatch: expected(%@) fetched(%@)", expectedKey, fetchedKey);
 		}
 	}];
-
+	
 	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		for (int i = 0; i < 150; i++)
@@ -1528,7 +1567,7 @@
 			}
 		}
 	}];
-
+	
 	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		for (int i = 0; i < 150; i++)
@@ -1586,7 +1625,7 @@
 		
 		XCTAssertTrue(count == 0, @"Wrong count. Expected zero, got %lu", (unsigned long)count);
 	}];
-
+	
 	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		NSUInteger count = [[transaction ext:@"order"] numberOfItemsInGroup:@""];
@@ -1621,7 +1660,7 @@
 			[transaction setObject:obj forKey:key inCollection:nil];
 		}
 	}];
-
+	
 	[connection1 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		for (int i = 0; i < 150; i++)
@@ -1634,7 +1673,7 @@
 			             @"Key mismatch: expected(%@) fetched(%@)", expectedKey, fetchedKey);
 		}
 	}];
-
+	
 	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		for (int i = 0; i < 150; i++)
@@ -1647,7 +1686,7 @@
 			             @"Key mismatch: expected(%@) fetched(%@)", expectedKey, fetchedKey);
 		}
 	}];
-
+	
 	[[database newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		for (int i = 0; i < 150; i++)
@@ -1701,7 +1740,7 @@
 			}
 		}
 	}];
-
+	
 	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		for (int i = 0; i < 150; i++)
@@ -1722,7 +1761,7 @@
 			}
 		}
 	}];
-
+	
 	[[database newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		for (int i = 0; i < 150; i++)
@@ -2974,6 +3013,17 @@
 	[self _testInsertAndDelete_withPath:databasePath options:options];
 }
 
+- (void)testInsertAndDelete_rowidMapInMemory
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.isPersistent = YES;
+	options.keepsRowidMapInMemory = YES;
+	
+	[self _testInsertAndDelete_withPath:databasePath options:options];
+}
+
 - (void)_testInsertAndDelete_withPath:(NSString *)databasePath options:(YapDatabaseViewOptions *)options
 {
 	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
@@ -3227,4 +3277,1555 @@
 	}];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)testTouchObjects
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2];
+	}];
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 10; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key-%d", i] inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseViewMappings *mappings = [YapDatabaseViewMappings mappingsWithGroups:@[ @"" ] view:@"order"];
+	
+	[connection2 beginLongLivedReadTransaction];
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[mappings updateWithTransaction:transaction];
+	}];
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction touchObjectsForKeys:@[ @"key-1", @"key-5", @"missing", @"key-9" ] inCollection:nil];
+	}];
+	
+	NSArray *notifications = [connection2 beginLongLivedReadTransaction];
+	
+	NSArray *sectionChanges = nil;
+	NSArray *rowChanges = nil;
+	
+	[[connection2 ext:@"order"] getSectionChanges:&sectionChanges
+	                                   rowChanges:&rowChanges
+	                             forNotifications:notifications
+	                                 withMappings:mappings];
+	
+	XCTAssertTrue([sectionChanges count] == 0, @"Bad count");
+	XCTAssertTrue([rowChanges count] == 3, @"Bad count");
+	
+	for (YapDatabaseViewRowChange *change in rowChanges)
+	{
+		XCTAssertTrue(change.type == YapDatabaseViewChangeUpdate, @"Bad change type");
+	}
+	
+	XCTAssertTrue([connection2 hasChangeForKey:@"key-5" inCollection:nil inNotifications:notifications]);
+}
+
+- (void)testPersistedStateAcrossReopen
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	__block NSUInteger groupingCount = 0;
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		groupingCount++;
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2];
+	}];
+	
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database, @"Oops");
+		
+		YapDatabaseAutoView *databaseView =
+		  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+		
+		XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+		
+		YapDatabaseConnection *connection1 = [database newConnection];
+		YapDatabaseConnection *connection2 = [database newConnection];
+		
+		[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertEqualObjects([[transaction ext:@"order"] versionTag], @"1");
+		}];
+		
+		[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (int i = 0; i < 10; i++)
+			{
+				[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key-%d", i] inCollection:nil];
+			}
+		}];
+		
+		[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@""] == 10, @"Bad count");
+		}];
+	}
+	
+	// The persisted state of the view (class, versionTag, ...) is written to the database during pre-commit.
+	// So re-registering the same view must not repopulate it.
+	
+	groupingCount = 0;
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	XCTAssertTrue(groupingCount == 0, @"View was repopulated");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@""] == 10, @"Bad count");
+	}];
+}
+
+- (void)testIndexLookupsAcrossPages
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id obj1, NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	NSUInteger const count = 1000; // many pages
+	
+	// Insert in (pseudo) random order, to mutate pages all over the group
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			NSUInteger value = (i * 7919) % count;
+			[transaction setObject:@(value) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)value] inCollection:nil];
+		}
+		
+		// Remove every 3rd item
+		
+		for (NSUInteger value = 0; value < count; value += 3)
+		{
+			[transaction removeObjectForKey:[NSString stringWithFormat:@"%lu", (unsigned long)value] inCollection:nil];
+		}
+	}];
+	
+	NSMutableArray *expected = [NSMutableArray array];
+	for (NSUInteger value = 0; value < count; value++)
+	{
+		if ((value % 3) != 0)
+			[expected addObject:[NSString stringWithFormat:@"%lu", (unsigned long)value]];
+	}
+	
+	void (^verify)(YapDatabaseReadTransaction *) = ^(YapDatabaseReadTransaction *transaction){
+		
+		YapDatabaseViewTransaction *viewTransaction = [transaction ext:@"order"];
+		
+		XCTAssertTrue([viewTransaction numberOfItemsInGroup:@""] == expected.count, @"Bad count");
+		XCTAssertNil([viewTransaction keyAtIndex:expected.count inGroup:@""], @"Expected nil");
+		
+		// Walk backwards, so the lookups don't follow the page order
+		
+		for (NSUInteger i = expected.count; i > 0; i--)
+		{
+			NSUInteger index = i - 1;
+			NSString *key = [viewTransaction keyAtIndex:index inGroup:@""];
+			XCTAssertEqualObjects(key, expected[index], @"Bad key at index %lu", (unsigned long)index);
+			
+			NSString *group = nil;
+			NSUInteger foundIndex = NSNotFound;
+			[viewTransaction getGroup:&group index:&foundIndex forKey:expected[index] inCollection:nil];
+			XCTAssertTrue(foundIndex == index, @"Bad index for key %@", expected[index]);
+		}
+	};
+	
+	[connection1 readWithBlock:verify];
+	[connection2 readWithBlock:verify];
+}
+
+- (void)testPageCacheLimitsAndReadahead
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return @"";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id obj1, NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.pageSize = 10;
+	options.pageCacheCountLimit = 8;
+	options.pageCacheCostLimit = 64 * 1024;
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:nil options:options];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	NSUInteger const count = 500;
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)i] inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseViewMappings *mappings = [[YapDatabaseViewMappings alloc] initWithGroups:@[ @"" ] view:@"order"];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[mappings updateWithTransaction:transaction];
+	}];
+	
+	YapDatabaseCacheStatistics *before = [connection2 statistics].extensionCaches[@"order.pageCache"];
+	
+	XCTAssertTrue(before.countLimit == 8);
+	XCTAssertTrue(before.costLimit == 64 * 1024);
+	
+	// Prefetching rows loads their pages (plus the neighbors) without a lookup per row
+	
+	NSRange range = NSMakeRange(200, 10);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSMutableArray<NSIndexPath *> *indexPaths = [NSMutableArray array];
+		for (NSUInteger row = range.location; row < NSMaxRange(range); row++)
+		{
+			[indexPaths addObject:[NSIndexPath indexPathWithIndexes:(NSUInteger[]){ 0, row } length:2]];
+		}
+		
+		[[transaction ext:@"order"] prefetchObjectsAtIndexPaths:indexPaths withMappings:mappings];
+	}];
+	
+	YapDatabaseCacheStatistics *prefetched = [connection2 statistics].extensionCaches[@"order.pageCache"];
+	
+	XCTAssertTrue(prefetched.count >= 3, @"Expected the pages of the range, plus the neighbors");
+	XCTAssertTrue(prefetched.count <= 8);
+	XCTAssertTrue(prefetched.cost > 0 && prefetched.cost <= 64 * 1024);
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseViewTransaction *viewTransaction = [transaction ext:@"order"];
+		
+		for (NSUInteger index = range.location; index < NSMaxRange(range); index++)
+		{
+			NSString *key = [viewTransaction keyAtIndex:index inGroup:@""];
+			XCTAssertEqualObjects(key, ([NSString stringWithFormat:@"%lu", (unsigned long)index]));
+		}
+	}];
+	
+	YapDatabaseCacheStatistics *after = [connection2 statistics].extensionCaches[@"order.pageCache"];
+	
+	XCTAssertTrue(after.misses == prefetched.misses, @"Expected every page lookup to hit the cache");
+	XCTAssertTrue(after.hits >= prefetched.hits + range.length);
+	XCTAssertTrue(after.hitRate > 0.0);
+}
+
+- (void)testPopulateMatchesIncrementalInsertion
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		NSUInteger value = [(NSNumber *)object unsignedIntegerValue];
+		if ((value % 5) == 0) return nil;
+		
+		return (value % 2) ? @"odd" : @"even";
+	}];
+	
+	// Lots of equal values, so the order of equal items matters
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id obj1, NSString *collection2, NSString *key2, id obj2)
+	{
+		NSUInteger value1 = [(NSNumber *)obj1 unsignedIntegerValue] % 17;
+		NSUInteger value2 = [(NSNumber *)obj2 unsignedIntegerValue] % 17;
+		
+		if (value1 < value2) return NSOrderedAscending;
+		if (value1 > value2) return NSOrderedDescending;
+		return NSOrderedSame;
+	}];
+	
+	YapDatabaseAutoView *incrementalView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:incrementalView withName:@"incremental"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSUInteger const count = 2000; // many pages
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			NSUInteger value = (i * 7919) % count;
+			[transaction setObject:@(value) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)i] inCollection:nil];
+		}
+	}];
+	
+	YapDatabaseAutoView *populatedView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:populatedView withName:@"populated"], @"Failure registering extension");
+	
+	void (^verify)(YapDatabaseReadTransaction *) = ^(YapDatabaseReadTransaction *transaction){
+		
+		YapDatabaseViewTransaction *incremental = [transaction ext:@"incremental"];
+		YapDatabaseViewTransaction *populated = [transaction ext:@"populated"];
+		
+		XCTAssertEqualObjects([NSSet setWithArray:[populated allGroups]],
+		                      [NSSet setWithArray:[incremental allGroups]], @"Bad groups");
+		
+		for (NSString *group in [incremental allGroups])
+		{
+			NSUInteger groupCount = [incremental numberOfItemsInGroup:group];
+			XCTAssertTrue([populated numberOfItemsInGroup:group] == groupCount, @"Bad count");
+			
+			for (NSUInteger index = 0; index < groupCount; index++)
+			{
+				XCTAssertEqualObjects([populated keyAtIndex:index inGroup:group],
+				                      [incremental keyAtIndex:index inGroup:group], @"Bad key at index %lu",
+				                      (unsigned long)index);
+			}
+		}
+	};
+	
+	[connection readWithBlock:verify];
+	
+	// The populated pages must support the regular (incremental) code path
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i += 7)
+		{
+			[transaction removeObjectForKey:[NSString stringWithFormat:@"%lu", (unsigned long)i] inCollection:nil];
+		}
+		
+		for (NSUInteger i = count; i < (count + 100); i++)
+		{
+			[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)i] inCollection:nil];
+		}
+	}];
+	
+	[connection readWithBlock:verify];
+	[[database newConnection] readWithBlock:verify];
+}
+
+- (void)testSortKeyBlock
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"";
+	}];
+	
+	__block NSUInteger sortKeyCount = 0;
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withSortKeyObjectBlock:
+	    ^id (YapDatabaseReadTransaction *transaction, NSString *group, NSString *collection, NSString *key, id object)
+	{
+		sortKeyCount++;
+		return ([(NSNumber *)object integerValue] < 0) ? nil : object;
+	}];
+	
+	XCTAssertNotNil(sorting.sortKeyBlock, @"Expected sortKeyBlock");
+	XCTAssertTrue(sorting.blockType == YapDatabaseBlockTypeWithObject, @"Bad blockType");
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSUInteger const count = 500;
+	
+	sortKeyCount = 0;
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			NSUInteger value = (i * 7919) % count;
+			[transaction setObject:@(value) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)value] inCollection:nil];
+		}
+		
+		// A nil sort key goes first
+		
+		[transaction setObject:@(-1) forKey:@"negative" inCollection:nil];
+	}];
+	
+	// Every sort key is only computed once per transaction
+	
+	XCTAssertTrue(sortKeyCount == (count + 1), @"Unexpected sortKeyCount: %lu", (unsigned long)sortKeyCount);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// Move the first item to the end
+		
+		[transaction setObject:@(count) forKey:@"0" inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseViewTransaction *viewTransaction = [transaction ext:@"order"];
+		
+		XCTAssertTrue([viewTransaction numberOfItemsInGroup:@""] == (count + 1), @"Bad count");
+		XCTAssertEqualObjects([viewTransaction keyAtIndex:0 inGroup:@""], @"negative", @"Bad key");
+		
+		for (NSUInteger value = 1; value < count; value++)
+		{
+			NSString *key = [viewTransaction keyAtIndex:value inGroup:@""];
+			XCTAssertEqualObjects(key, ([NSString stringWithFormat:@"%lu", (unsigned long)value]), @"Bad key");
+		}
+		
+		XCTAssertEqualObjects([viewTransaction keyAtIndex:count inGroup:@""], @"0", @"Bad key");
+	}];
+}
+
+- (void)testSortDescriptors
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseViewGrouping *grouping =
+	  [YapDatabaseViewGrouping withSource:YapDatabaseViewKeyPathSourceMetadata keyPath:@"kind"];
+	
+	// By metadata.date (descending), then by key
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withSortDescriptors:@[
+	  [YapDatabaseViewSortDescriptor sortDescriptorWithSource:YapDatabaseViewKeyPathSourceMetadata
+	                                                  keyPath:@"date"
+	                                                ascending:NO],
+	  [YapDatabaseViewSortDescriptor sortDescriptorWithSource:YapDatabaseViewKeyPathSourceKey
+	                                                  keyPath:nil
+	                                                ascending:YES]
+	]];
+	
+	XCTAssertTrue(grouping.blockType == YapDatabaseBlockTypeWithMetadata, @"Bad blockType");
+	XCTAssertTrue(sorting.blockType == YapDatabaseBlockTypeWithMetadata, @"Bad blockType");
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSDate *now = [NSDate dateWithTimeIntervalSinceReferenceDate:1000];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < 100; i++)
+		{
+			NSDictionary *metadata = @{
+			  @"kind": ((i % 2) ? @"odd" : @"even"),
+			  @"date": [now dateByAddingTimeInterval:(i % 10)]
+			};
+			
+			[transaction setObject:@(i)
+			                forKey:[NSString stringWithFormat:@"%03lu", (unsigned long)i]
+			          inCollection:nil
+			          withMetadata:metadata];
+		}
+		
+		// Not in the view (no kind)
+		
+		[transaction setObject:@(0) forKey:@"none" inCollection:nil withMetadata:@{ @"date": now }];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseViewTransaction *viewTransaction = [transaction ext:@"order"];
+		
+		XCTAssertTrue([viewTransaction numberOfItemsInGroup:@"odd"] == 50, @"Bad count");
+		XCTAssertTrue([viewTransaction numberOfItemsInGroup:@"even"] == 50, @"Bad count");
+		XCTAssertNil([viewTransaction groupForKey:@"none" inCollection:nil], @"Expected no group");
+		
+		for (NSString *group in @[ @"odd", @"even" ])
+		{
+			__block NSString *lastKey = nil;
+			__block NSTimeInterval lastDate = 0;
+			
+			[viewTransaction enumerateKeysAndMetadataInGroup:group usingBlock:
+			    ^(NSString *collection, NSString *key, NSDictionary *metadata, NSUInteger index, BOOL *stop)
+			{
+				NSTimeInterval date = [(NSDate *)metadata[@"date"] timeIntervalSinceReferenceDate];
+				
+				if (lastKey)
+				{
+					XCTAssertTrue(date <= lastDate, @"Bad order: date");
+					if (date == lastDate) {
+						XCTAssertTrue([lastKey compare:key] == NSOrderedAscending, @"Bad order: key");
+					}
+				}
+				
+				lastKey = key;
+				lastDate = date;
+			}];
+		}
+	}];
+}
+
+- (void)testResortWithSameGrouping
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	__block NSUInteger groupingCount = 0;
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		groupingCount++;
+		return ([(NSNumber *)object unsignedIntegerValue] % 2) ? @"odd" : @"even";
+	}];
+	
+	YapDatabaseViewSorting *ascending = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id obj1, NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseViewSorting *descending = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id obj1, NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj2 compare:(NSNumber *)obj1];
+	}];
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:ascending versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	NSUInteger const count = 1000; // many pages
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			NSUInteger value = (i * 7919) % count;
+			[transaction setObject:@(value) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)value] inCollection:nil];
+		}
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertEqualObjects([[transaction ext:@"order"] keyAtIndex:0 inGroup:@"odd"], @"1", @"Bad key");
+	}];
+	
+	groupingCount = 0;
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[[transaction ext:@"order"] setGrouping:grouping sorting:descending versionTag:@"2"];
+	}];
+	
+	XCTAssertTrue(groupingCount == 0, @"Grouping block shouldn't be invoked");
+	
+	void (^verify)(YapDatabaseReadTransaction *) = ^(YapDatabaseReadTransaction *transaction){
+		
+		YapDatabaseViewTransaction *viewTransaction = [transaction ext:@"order"];
+		
+		XCTAssertEqualObjects([viewTransaction versionTag], @"2", @"Bad versionTag");
+		
+		for (NSString *group in @[ @"odd", @"even" ])
+		{
+			XCTAssertTrue([viewTransaction numberOfItemsInGroup:group] == (count / 2), @"Bad count");
+			
+			__block NSUInteger lastValue = NSUIntegerMax;
+			[viewTransaction enumerateKeysAndObjectsInGroup:group usingBlock:
+			    ^(NSString *collection, NSString *key, id object, NSUInteger index, BOOL *stop)
+			{
+				NSUInteger value = [(NSNumber *)object unsignedIntegerValue];
+				XCTAssertTrue(value < lastValue, @"Bad order");
+				
+				NSString *foundGroup = nil;
+				NSUInteger foundIndex = NSNotFound;
+				[viewTransaction getGroup:&foundGroup index:&foundIndex forKey:key inCollection:nil];
+				XCTAssertTrue(foundIndex == index, @"Bad index for key %@", key);
+				
+				lastValue = value;
+			}];
+		}
+	};
+	
+	[connection1 readWithBlock:verify];
+	[connection2 readWithBlock:verify];
+	[[database newConnection] readWithBlock:verify];
+}
+
+- (void)testMappingsOnlyFilterAndSortChangedGroups
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return collection;
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2];
+	}];
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (int i = 0; i < 50; i++)
+		{
+			NSString *collection = [NSString stringWithFormat:@"conv-%d", i];
+			
+			[transaction setObject:@(0) forKey:@"key-0" inCollection:collection];
+			[transaction setObject:@(1) forKey:@"key-1" inCollection:collection];
+		}
+	}];
+	
+	__block NSUInteger filterCount = 0;
+	
+	YapDatabaseViewMappings *mappings =
+	  [[YapDatabaseViewMappings alloc] initWithGroupFilterBlock:^BOOL(NSString *group, YapDatabaseReadTransaction *t){
+		
+		filterCount++;
+		return YES;
+		
+	} sortBlock:^NSComparisonResult(NSString *group1, NSString *group2, YapDatabaseReadTransaction *t){
+		
+		return [group1 compare:group2];
+		
+	} view:@"order"];
+	
+	mappings.onlyFilterAndSortChangedGroups = YES;
+	
+	[connection2 beginLongLivedReadTransaction];
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[mappings updateWithTransaction:transaction];
+	}];
+	
+	XCTAssertTrue(filterCount == 50, @"Bad filterCount: %lu", (unsigned long)filterCount);
+	XCTAssertTrue([mappings.allGroups count] == 50, @"Bad count");
+	
+	filterCount = 0;
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@(2) forKey:@"key-2" inCollection:@"conv-7"];
+		[transaction setObject:@(0) forKey:@"key-0" inCollection:@"conv-100"];
+	}];
+	
+	NSArray *notifications = [connection2 beginLongLivedReadTransaction];
+	
+	NSArray *sectionChanges = nil;
+	NSArray *rowChanges = nil;
+	
+	[[connection2 ext:@"order"] getSectionChanges:&sectionChanges
+	                                   rowChanges:&rowChanges
+	                             forNotifications:notifications
+	                                 withMappings:mappings];
+	
+	// Only the 2 changed groups should have been filtered
+	
+	XCTAssertTrue(filterCount == 2, @"Bad filterCount: %lu", (unsigned long)filterCount);
+	
+	NSArray *expectedGroups = [mappings.allGroups sortedArrayUsingSelector:@selector(compare:)];
+	
+	XCTAssertTrue([mappings.allGroups count] == 51, @"Bad count");
+	XCTAssertEqualObjects(mappings.allGroups, expectedGroups, @"Groups not sorted");
+	
+	XCTAssertTrue([mappings sectionForGroup:@"conv-100"] == [expectedGroups indexOfObject:@"conv-100"], @"Bad section");
+	XCTAssertTrue([mappings numberOfItemsInGroup:@"conv-7"] == 3, @"Bad count");
+	XCTAssertTrue([mappings numberOfItemsInGroup:@"conv-100"] == 1, @"Bad count");
+	XCTAssertTrue([mappings numberOfItemsInGroup:@"conv-8"] == 2, @"Bad count");
+}
+
+- (void)testBatchedRangeEnumeration
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	__block NSUInteger deserializeCount = 0;
+	
+	YapDatabaseDeserializer defaultDeserializer = [YapDatabase defaultDeserializer];
+	YapDatabaseDeserializer deserializer = ^id (NSString *collection, NSString *key, NSData *data) {
+		
+		@synchronized (self) { deserializeCount++; }
+		return defaultDeserializer(collection, key, data);
+	};
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath
+	                                               serializer:[YapDatabase defaultSerializer]
+	                                             deserializer:deserializer];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseConnection *connection1 = [database newConnection];
+	YapDatabaseConnection *connection2 = [database newConnection];
+	YapDatabaseConnection *connection3 = [database newConnection];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withKeyBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key)
+	{
+		return @"all";
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2];
+	}];
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1"];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	[connection1 readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < 200; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"%03lu", (unsigned long)i];
+			[transaction setObject:@(i) forKey:key inCollection:nil metadata:@(i * 2)];
+		}
+	}];
+	
+	[connection2 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSRange range = NSMakeRange(10, 120);
+		
+		// Forward (spans several batches)
+		
+		__block NSUInteger expectedIndex = range.location;
+		
+		[[transaction ext:@"order"] enumerateRowsInGroup:@"all"
+		                                     withOptions:0
+		                                           range:range
+		                                      usingBlock:
+		    ^(NSString *collection, NSString *key, id object, id metadata, NSUInteger index, BOOL *stop)
+		{
+			XCTAssertTrue(index == expectedIndex, @"Bad index: %lu != %lu",
+			              (unsigned long)index, (unsigned long)expectedIndex);
+			
+			XCTAssertEqualObjects(object, @(index), @"Bad object");
+			XCTAssertEqualObjects(metadata, @(index * 2), @"Bad metadata");
+			XCTAssertEqualObjects(key, ([NSString stringWithFormat:@"%03lu", (unsigned long)index]), @"Bad key");
+			
+			expectedIndex++;
+		}];
+		
+		XCTAssertTrue(expectedIndex == NSMaxRange(range), @"Bad count");
+		
+		// Reverse
+		
+		expectedIndex = NSMaxRange(range);
+		
+		[[transaction ext:@"order"] enumerateKeysAndObjectsInGroup:@"all"
+		                                               withOptions:NSEnumerationReverse
+		                                                     range:range
+		                                                usingBlock:
+		    ^(NSString *collection, NSString *key, id object, NSUInteger index, BOOL *stop)
+		{
+			expectedIndex--;
+			
+			XCTAssertTrue(index == expectedIndex, @"Bad index: %lu != %lu",
+			              (unsigned long)index, (unsigned long)expectedIndex);
+			XCTAssertEqualObjects(object, @(index), @"Bad object");
+		}];
+		
+		XCTAssertTrue(expectedIndex == range.location, @"Bad count");
+		
+		// Stop (within the first batch)
+		
+		__block NSUInteger enumCount = 0;
+		
+		[[transaction ext:@"order"] enumerateKeysAndMetadataInGroup:@"all"
+		                                                withOptions:0
+		                                                      range:range
+		                                                 usingBlock:
+		    ^(NSString *collection, NSString *key, id metadata, NSUInteger index, BOOL *stop)
+		{
+			enumCount++;
+			if (enumCount == 5) *stop = YES;
+		}];
+		
+		XCTAssertTrue(enumCount == 5, @"Enumeration didn't stop");
+	}];
+	
+	// Prefetch with mappings
+	
+	YapDatabaseViewMappings *mappings = [[YapDatabaseViewMappings alloc] initWithGroups:@[ @"all" ] view:@"order"];
+	
+	[connection3 readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		[mappings updateWithTransaction:transaction];
+		
+		NSMutableArray *indexPaths = [NSMutableArray arrayWithCapacity:30];
+		for (NSUInteger row = 50; row < 80; row++)
+		{
+			[indexPaths addObject:[NSIndexPath indexPathWithIndexes:(NSUInteger[]){ 0, row } length:2]];
+		}
+		
+		NSUInteger countBefore = deserializeCount;
+		
+		[[transaction ext:@"order"] prefetchObjectsAtIndexPaths:indexPaths withMappings:mappings];
+		
+		XCTAssertTrue(deserializeCount == (countBefore + 30), @"Expected 30 prefetched objects");
+		
+		countBefore = deserializeCount;
+		
+		for (NSIndexPath *indexPath in indexPaths)
+		{
+			id object = [[transaction ext:@"order"] objectAtIndexPath:indexPath withMappings:mappings];
+			XCTAssertEqualObjects(object, @([indexPath indexAtPosition:1]), @"Bad object");
+		}
+		
+		XCTAssertTrue(deserializeCount == countBefore, @"Expected prefetched objects to be in the cache");
+	}];
+}
+
+- (void)testMergedEnumerationAcrossGroups
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return [NSString stringWithFormat:@"g%ld", (long)([(NSNumber *)object integerValue] % 4)];
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id obj1,
+	      NSString *collection2, NSString *key2, id obj2)
+	{
+		return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+	}];
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSUInteger const count = 300;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			NSUInteger value = (i * 7919) % count;
+			[transaction setObject:@(value) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)value] inCollection:nil];
+		}
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseAutoViewTransaction *viewTransaction = [transaction ext:@"order"];
+		NSArray *allGroups = @[ @"g0", @"g1", @"g2", @"g3" ];
+		
+		// All groups: every value, in order
+		
+		__block NSUInteger expected = 0;
+		[viewTransaction enumerateKeysInGroups:allGroups withMergedSortingUsingBlock:
+		    ^(NSString *collection, NSString *key, NSString *group, NSUInteger index, BOOL *stop)
+		{
+			XCTAssertTrue(index == expected, @"Bad index");
+			XCTAssertEqualObjects(key, ([NSString stringWithFormat:@"%lu", (unsigned long)expected]), @"Bad key");
+			XCTAssertEqualObjects(group, ([NSString stringWithFormat:@"g%lu", (unsigned long)(expected % 4)]), @"Bad group");
+			expected++;
+		}];
+		
+		XCTAssertTrue(expected == count, @"Bad count");
+		
+		// A window of the merged list
+		
+		expected = 120;
+		[viewTransaction enumerateKeysInGroups:allGroups range:NSMakeRange(120, 30) withMergedSortingUsingBlock:
+		    ^(NSString *collection, NSString *key, NSString *group, NSUInteger index, BOOL *stop)
+		{
+			XCTAssertTrue(index == expected, @"Bad index");
+			XCTAssertEqualObjects(key, ([NSString stringWithFormat:@"%lu", (unsigned long)expected]), @"Bad key");
+			expected++;
+		}];
+		
+		XCTAssertTrue(expected == 150, @"Bad count");
+		
+		// A subset of the groups (ignoring missing & duplicate groups), and stopping early
+		
+		__block NSUInteger enumerated = 0;
+		[viewTransaction enumerateKeysInGroups:@[ @"g3", @"missing", @"g1", @"g3" ] withMergedSortingUsingBlock:
+		    ^(NSString *collection, NSString *key, NSString *group, NSUInteger index, BOOL *stop)
+		{
+			NSUInteger value = (index * 2) + 1;
+			XCTAssertEqualObjects(key, ([NSString stringWithFormat:@"%lu", (unsigned long)value]), @"Bad key");
+			
+			enumerated++;
+			if (index == 99) *stop = YES;
+		}];
+		
+		XCTAssertTrue(enumerated == 100, @"Bad count");
+	}];
+}
+
+- (void)testManualViewBulkOperations
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseManualView *manualView = [[YapDatabaseManualView alloc] init];
+	XCTAssertTrue([database registerExtension:manualView withName:@"manual"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	NSUInteger const count = 500;
+	
+	NSMutableArray<NSString *> *keys = [NSMutableArray arrayWithCapacity:count];
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[keys addObject:[NSString stringWithFormat:@"%lu", (unsigned long)i]];
+	}
+	
+	NSArray<NSString *> *(^KeysInGroup)(YapDatabaseViewTransaction *) = ^(YapDatabaseViewTransaction *viewTransaction){
+		
+		NSMutableArray<NSString *> *result = [NSMutableArray array];
+		[viewTransaction enumerateKeysInGroup:@"group" usingBlock:
+		    ^(NSString *collection, NSString *key, NSUInteger index, BOOL *stop)
+		{
+			[result addObject:key];
+		}];
+		
+		return result;
+	};
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		for (NSString *key in keys)
+		{
+			[transaction setObject:key forKey:key inCollection:nil];
+		}
+		
+		YapDatabaseManualViewTransaction *viewTransaction = [transaction ext:@"manual"];
+		
+		// Insert into a new group, and then splice into the middle.
+		
+		XCTAssertTrue([viewTransaction insertKeys:[keys subarrayWithRange:NSMakeRange(0, 100)]
+		                             inCollection:nil
+		                                  atIndex:0
+		                                  inGroup:@"group"], @"");
+		
+		XCTAssertTrue([viewTransaction insertKeys:[keys subarrayWithRange:NSMakeRange(100, 400)]
+		                             inCollection:nil
+		                                  atIndex:50
+		                                  inGroup:@"group"], @"");
+		
+		NSMutableArray<NSString *> *expected = [[keys subarrayWithRange:NSMakeRange(0, 50)] mutableCopy];
+		[expected addObjectsFromArray:[keys subarrayWithRange:NSMakeRange(100, 400)]];
+		[expected addObjectsFromArray:[keys subarrayWithRange:NSMakeRange(50, 50)]];
+		
+		XCTAssertEqualObjects(KeysInGroup(viewTransaction), expected, @"Bad splice");
+		
+		// Invalid operations leave the view untouched.
+		
+		XCTAssertFalse([viewTransaction insertKeys:@[ @"0" ] inCollection:nil atIndex:0 inGroup:@"other"], @"");
+		XCTAssertFalse([viewTransaction insertKeys:@[ @"missing" ] inCollection:nil atIndex:0 inGroup:@"group"], @"");
+		XCTAssertFalse([viewTransaction removeItemsInRange:NSMakeRange(450, 51) inGroup:@"group"], @"");
+		XCTAssertFalse([viewTransaction moveItemsInRange:NSMakeRange(0, 10) toIndex:491 inGroup:@"group"], @"");
+		
+		XCTAssertEqualObjects(KeysInGroup(viewTransaction), expected, @"");
+		
+		// Remove a range that spans several pages.
+		
+		XCTAssertTrue([viewTransaction removeItemsInRange:NSMakeRange(25, 300) inGroup:@"group"], @"");
+		[expected removeObjectsInRange:NSMakeRange(25, 300)];
+		
+		XCTAssertEqualObjects(KeysInGroup(viewTransaction), expected, @"Bad range removal");
+		
+		// Move a range towards the end, and then towards the beginning.
+		
+		XCTAssertTrue([viewTransaction moveItemsInRange:NSMakeRange(10, 20) toIndex:150 inGroup:@"group"], @"");
+		{
+			NSArray *moved = [expected subarrayWithRange:NSMakeRange(10, 20)];
+			[expected removeObjectsInRange:NSMakeRange(10, 20)];
+			[expected insertObjects:moved atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(150, 20)]];
+		}
+		
+		XCTAssertTrue([viewTransaction moveItemsInRange:NSMakeRange(100, 75) toIndex:0 inGroup:@"group"], @"");
+		{
+			NSArray *moved = [expected subarrayWithRange:NSMakeRange(100, 75)];
+			[expected removeObjectsInRange:NSMakeRange(100, 75)];
+			[expected insertObjects:moved atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 75)]];
+		}
+		
+		XCTAssertEqualObjects(KeysInGroup(viewTransaction), expected, @"Bad move");
+		
+		for (NSString *key in expected)
+		{
+			XCTAssertEqualObjects([viewTransaction groupForKey:key inCollection:nil], @"group", @"");
+		}
+		XCTAssertNil([viewTransaction groupForKey:@"100" inCollection:nil], @"Removed key still in view");
+	}];
+	
+	// Replacing the group in a separate transaction produces contiguous range changes.
+	
+	YapDatabaseConnection *uiConnection = [database newConnection];
+	[uiConnection beginLongLivedReadTransaction];
+	
+	YapDatabaseViewMappings *mappings = [[YapDatabaseViewMappings alloc] initWithGroups:@[ @"group" ] view:@"manual"];
+	[uiConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		[mappings updateWithTransaction:transaction];
+	}];
+	
+	NSUInteger originalCount = [mappings numberOfItemsInGroup:@"group"];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		YapDatabaseManualViewTransaction *viewTransaction = [transaction ext:@"manual"];
+		
+		XCTAssertFalse([viewTransaction replaceAllItemsInGroup:@"group" withKeys:@[ @"1", @"1" ] inCollection:nil], @"");
+		
+		XCTAssertTrue([viewTransaction replaceAllItemsInGroup:@"group"
+		                                             withKeys:[keys subarrayWithRange:NSMakeRange(300, 200)]
+		                                         inCollection:nil], @"");
+		
+		XCTAssertEqualObjects(KeysInGroup(viewTransaction), [keys subarrayWithRange:NSMakeRange(300, 200)], @"");
+	}];
+	
+	NSArray *notifications = [uiConnection beginLongLivedReadTransaction];
+	
+	NSArray *sectionChanges = nil;
+	NSArray *rowChanges = nil;
+	[[uiConnection ext:@"manual"] getSectionChanges:&sectionChanges
+	                                     rowChanges:&rowChanges
+	                               forNotifications:notifications
+	                                   withMappings:mappings];
+	
+	NSUInteger deletedRows = 0;
+	NSUInteger insertedRows = 0;
+	
+	for (YapDatabaseViewRangeChange *rangeChange in [YapDatabaseViewRangeChange rangeChangesForRowChanges:rowChanges])
+	{
+		if (rangeChange.type == YapDatabaseViewChangeDelete) deletedRows += rangeChange.range.length;
+		if (rangeChange.type == YapDatabaseViewChangeInsert) insertedRows += rangeChange.range.length;
+	}
+	
+	XCTAssertTrue((originalCount - deletedRows + insertedRows) == 200, @"Bad row changes");
+	XCTAssertTrue([mappings numberOfItemsInGroup:@"group"] == 200, @"");
+}
+
+- (void)testNonPersistentViewSnapshot
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	NSURL *snapshotURL = [NSURL fileURLWithPath:[databasePath stringByAppendingString:@"-view-snapshot"]];
+	
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	[[NSFileManager defaultManager] removeItemAtURL:snapshotURL error:NULL];
+	
+	__block NSUInteger groupingCount = 0;
+	
+	YapDatabaseAutoView* (^CreateView)(void) = ^{
+		
+		YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+		    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+		{
+			groupingCount++;
+			return ([(NSNumber *)object integerValue] % 2) ? @"odd" : @"even";
+		}];
+		
+		YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+		    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+		      NSString *collection1, NSString *key1, id obj1,
+		      NSString *collection2, NSString *key2, id obj2)
+		{
+			return [(NSNumber *)obj1 compare:(NSNumber *)obj2];
+		}];
+		
+		YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+		options.isPersistent = NO;
+		options.snapshotURL = snapshotURL;
+		
+		return [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1" options:options];
+	};
+	
+	NSUInteger const count = 400;
+	
+	// Populate the view, and write a snapshot
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database, @"Oops");
+		
+		XCTAssertTrue([database registerExtension:CreateView() withName:@"order"], @"Failure registering extension");
+		
+		YapDatabaseConnection *connection = [database newConnection];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (NSUInteger i = 0; i < count; i++)
+			{
+				NSUInteger value = (i * 7919) % count;
+				[transaction setObject:@(value) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)value] inCollection:nil];
+			}
+			
+			XCTAssertFalse([[transaction ext:@"order"] writeSnapshot], @"Not allowed with uncommitted changes");
+		}];
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertTrue([[transaction ext:@"order"] writeSnapshot], @"Failure writing snapshot");
+		}];
+	}
+	
+	// Re-open the database: the view is restored from the snapshot (without invoking the grouping block)
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database, @"Oops");
+		
+		groupingCount = 0;
+		XCTAssertTrue([database registerExtension:CreateView() withName:@"order"], @"Failure registering extension");
+		XCTAssertTrue(groupingCount == 0, @"View was populated instead of restored");
+		
+		YapDatabaseConnection *connection = [database newConnection];
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			YapDatabaseViewTransaction *viewTransaction = [transaction ext:@"order"];
+			
+			XCTAssertTrue([viewTransaction numberOfItemsInGroup:@"even"] == (count / 2), @"");
+			XCTAssertTrue([viewTransaction numberOfItemsInGroup:@"odd"] == (count / 2), @"");
+			
+			[viewTransaction enumerateKeysAndObjectsInGroup:@"odd" usingBlock:
+			    ^(NSString *collection, NSString *key, id object, NSUInteger index, BOOL *stop)
+			{
+				XCTAssertTrue([(NSNumber *)object unsignedIntegerValue] == ((index * 2) + 1), @"Bad order");
+			}];
+			
+			XCTAssertEqualObjects([viewTransaction groupForKey:@"10" inCollection:nil], @"even", @"");
+		}];
+		
+		// Commit a change after the snapshot
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[transaction setObject:@(count) forKey:[NSString stringWithFormat:@"%lu", (unsigned long)count] inCollection:nil];
+		}];
+	}
+	
+	// Re-open the database: the snapshot is stale, so the view is populated
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database, @"Oops");
+		
+		groupingCount = 0;
+		XCTAssertTrue([database registerExtension:CreateView() withName:@"order"], @"Failure registering extension");
+		XCTAssertTrue(groupingCount > 0, @"Stale snapshot was restored");
+		
+		[[database newConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@"even"] == ((count / 2) + 1), @"");
+		}];
+	}
+	
+	[[NSFileManager defaultManager] removeItemAtURL:snapshotURL error:NULL];
+}
+
+- (void)testGroupNamesAcrossReopen
+{
+	NSString *databasePath = [self databasePath:NSStringFromSelector(_cmd)];
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:NULL];
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+	    ^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return [NSString stringWithFormat:@"group-%d", ([object intValue] % 3)];
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2 options:NSNumericSearch];
+	}];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.isPersistent = YES;
+	options.pageSizing = YapDatabaseViewPageSizingFixed;
+	options.pageSize = 4; // multiple pages per group
+	
+	@autoreleasepool {
+		
+		YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+		XCTAssertNotNil(database, @"Oops");
+		
+		YapDatabaseAutoView *databaseView =
+		  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1" options:options];
+		
+		XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+		
+		YapDatabaseConnection *connection = [database newConnection];
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (int i = 0; i < 30; i++)
+			{
+				[transaction setObject:@(i) forKey:[NSString stringWithFormat:@"key-%d", i] inCollection:nil];
+			}
+		}];
+		
+		// Remove every item in group-2 (and thus the group itself)
+		
+		[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			for (int i = 2; i < 30; i += 3)
+			{
+				[transaction removeObjectForKey:[NSString stringWithFormat:@"key-%d", i] inCollection:nil];
+			}
+		}];
+		
+		[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			NSArray *groups = [[[transaction ext:@"order"] allGroups] sortedArrayUsingSelector:@selector(compare:)];
+			XCTAssertEqualObjects(groups, (@[ @"group-0", @"group-1" ]));
+		}];
+	}
+	
+	// The pages reference their group by groupId.
+	// So re-opening the database must map every page back to the proper group name.
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithPath:databasePath];
+	XCTAssertNotNil(database, @"Oops");
+	
+	YapDatabaseAutoView *databaseView =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1" options:options];
+	
+	XCTAssertTrue([database registerExtension:databaseView withName:@"order"], @"Failure registering extension");
+	
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		NSArray *groups = [[[transaction ext:@"order"] allGroups] sortedArrayUsingSelector:@selector(compare:)];
+		XCTAssertEqualObjects(groups, (@[ @"group-0", @"group-1" ]));
+		
+		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@"group-0"] == 10, @"Bad count");
+		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@"group-1"] == 10, @"Bad count");
+		
+		NSString *key = nil;
+		[[transaction ext:@"order"] getKey:&key collection:NULL atIndex:9 inGroup:@"group-1"];
+		XCTAssertEqualObjects(key, @"key-28");
+	}];
+	
+	// And a removed group can come back
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction setObject:@(32) forKey:@"key-32" inCollection:nil];
+	}];
+	
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		XCTAssertTrue([[transaction ext:@"order"] numberOfItemsInGroup:@"group-2"] == 1, @"Bad count");
+	}];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Page Format
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)testPageFormat_roundTrip
+{
+	int64_t rowids[] = {
+		1, 2, 3, 4, 5, 6, 7, 8, 9, 10,      // single-byte deltas (fast path)
+		10, 9, 8, 7, 6, 5, 4, 3, 2, 1,      // negative deltas
+		INT64_MAX, INT64_MIN, INT64_MAX,    // deltas that overflow int64
+		-1, 0, (1LL << 40), -(1LL << 40),
+		(INT64_MIN + 1), (INT64_MAX - 1),
+		127, 128, 16383, 16384              // varint size boundaries
+	};
+	NSUInteger count = sizeof(rowids) / sizeof(rowids[0]);
+	
+	YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] init];
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[page addRowid:rowids[i]];
+	}
+	
+	NSData *data = [page serialize];
+	
+	XCTAssertTrue([data length] % sizeof(int64_t) != 0);
+	XCTAssertTrue(((const uint8_t *)[data bytes])[0] == 2);
+	
+	YapDatabaseViewPage *page2 = [[YapDatabaseViewPage alloc] init];
+	[page2 deserialize:data];
+	
+	XCTAssertTrue([page2 count] == count);
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		XCTAssertTrue([page2 rowidAtIndex:i] == rowids[i], @"index %lu", (unsigned long)i);
+	}
+	
+	// Pages of every length (including those that need a padding byte)
+	
+	YapDatabaseViewPage *page3 = [[YapDatabaseViewPage alloc] init];
+	YapDatabaseViewPage *page4 = [[YapDatabaseViewPage alloc] init];
+	
+	for (NSUInteger length = 0; length < 64; length++)
+	{
+		data = [page3 serialize];
+		XCTAssertTrue([data length] % sizeof(int64_t) != 0);
+		
+		[page4 deserialize:data];
+		
+		XCTAssertTrue([page4 count] == [page3 count]);
+		for (NSUInteger i = 0; i < [page3 count]; i++)
+		{
+			XCTAssertTrue([page4 rowidAtIndex:i] == [page3 rowidAtIndex:i]);
+		}
+		
+		[page3 addRowid:(int64_t)(length * length * 1000)];
+	}
+}
+
+- (void)testPageFormat_legacy
+{
+	int64_t rowids[] = { 1, 100, -5, INT64_MAX, INT64_MIN, 0, 42 };
+	NSUInteger count = sizeof(rowids) / sizeof(rowids[0]);
+	
+	// Version 1: raw little-endian int64 values
+	
+	NSMutableData *data = [NSMutableData dataWithCapacity:(count * sizeof(int64_t))];
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		int64_t littleRowid = (int64_t)CFSwapInt64HostToLittle((uint64_t)rowids[i]);
+		[data appendBytes:&littleRowid length:sizeof(littleRowid)];
+	}
+	
+	YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] init];
+	[page deserialize:data];
+	
+	XCTAssertTrue([page count] == count);
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		XCTAssertTrue([page rowidAtIndex:i] == rowids[i], @"index %lu", (unsigned long)i);
+	}
+	
+	// An empty legacy page
+	
+	[page deserialize:[NSData data]];
+	XCTAssertTrue([page count] == 0);
+	
+	// Legacy pages are re-written in the current format
+	
+	[page deserialize:data];
+	NSData *newData = [page serialize];
+	
+	XCTAssertTrue([newData length] % sizeof(int64_t) != 0);
+	XCTAssertTrue([newData length] < [data length]);
+	
+	YapDatabaseViewPage *page2 = [[YapDatabaseViewPage alloc] init];
+	[page2 deserialize:newData];
+	
+	XCTAssertTrue([page2 count] == count);
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		XCTAssertTrue([page2 rowidAtIndex:i] == rowids[i]);
+	}
+}
+
+- (void)testPageFormat_corrupt
+{
+	YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] init];
+	for (int64_t rowid = 0; rowid < 50; rowid++)
+	{
+		[page addRowid:(rowid * 1000003)]; // multi-byte deltas
+	}
+	
+	NSData *data = [page serialize];
+	
+	// Truncated data
+	// (Lengths that are a multiple of 8 are legacy pages, and the last byte may be padding.)
+	
+	YapDatabaseViewPage *page2 = [[YapDatabaseViewPage alloc] init];
+	
+	for (NSUInteger length = 1; length < ([data length] - 1); length++)
+	{
+		if ((length % sizeof(int64_t)) == 0) continue;
+		
+		[page2 addRowid:1]; // the previous contents are always discarded
+		[page2 deserialize:[data subdataWithRange:NSMakeRange(0, length)]];
+		
+		XCTAssertTrue([page2 count] == 0, @"length %lu", (unsigned long)length);
+	}
+	
+	// A valid page (as a control)
+	
+	uint8_t valid[] = { 2, 2, 2, 2 };
+	[page2 deserialize:[NSData dataWithBytes:valid length:sizeof(valid)]];
+	
+	XCTAssertTrue([page2 count] == 2);
+	XCTAssertTrue([page2 rowidAtIndex:0] == 1);
+	XCTAssertTrue([page2 rowidAtIndex:1] == 2);
+	
+	// Unknown (future) version
+	
+	uint8_t futureVersion[] = { 3, 2, 2, 2 };
+	[page2 deserialize:[NSData dataWithBytes:futureVersion length:sizeof(futureVersion)]];
+	XCTAssertTrue([page2 count] == 0);
+	
+	// Count is larger than the data could possibly hold
+	
+	uint8_t badCount[] = { 2, 100, 2, 2, 2 };
+	[page2 deserialize:[NSData dataWithBytes:badCount length:sizeof(badCount)]];
+	XCTAssertTrue([page2 count] == 0);
+	
+	// Count is a truncated varint
+	
+	uint8_t truncatedCount[] = { 2, 0xFF, 0xFF };
+	[page2 deserialize:[NSData dataWithBytes:truncatedCount length:sizeof(truncatedCount)]];
+	XCTAssertTrue([page2 count] == 0);
+	
+	// Delta is an over-long varint (more than 64 bits)
+	
+	uint8_t overlongDelta[] = { 2, 1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+	[page2 deserialize:[NSData dataWithBytes:overlongDelta length:sizeof(overlongDelta)]];
+	XCTAssertTrue([page2 count] == 0);
+	
+	// Fewer deltas than the count says
+	
+	uint8_t missingDelta[] = { 2, 3, 2, 2, 0 };
+	[page2 deserialize:[NSData dataWithBytes:missingDelta length:sizeof(missingDelta)]];
+	XCTAssertTrue([page2 count] == 3); // the zero byte is a (valid) delta of zero
+	
+	uint8_t missingDelta2[] = { 2, 4, 2, 2, 0 };
+	[page2 deserialize:[NSData dataWithBytes:missingDelta2 length:sizeof(missingDelta2)]];
+	XCTAssertTrue([page2 count] == 0);
+}
+
 @end
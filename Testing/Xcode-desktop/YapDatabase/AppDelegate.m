@@ -2,6 +2,10 @@
 
 #import "BenchmarkYapCache.h"
 #import "BenchmarkYapDatabase.h"
+#import "BenchmarkYapDatabaseContention.h"
+#import "BenchmarkYapDatabaseExtensions.h"
+#import "BenchmarkYapDatabaseViewChange.h"
+#import "BenchmarkYapManyToManyCache.h"
 
 #import <YapDatabase/YapDatabase.h>
 #import <YapDatabase/YapDatabaseFilteredView.h>
@@ -28,8 +32,14 @@
 		
 		[BenchmarkYapDatabase runTestsWithCompletion:^{
 			
-			databaseBenchmarksButton.enabled = YES;
-			cacheBenchmarksButton.enabled = YES;
+			[BenchmarkYapDatabaseExtensions runTestsWithCompletion:^{
+				
+				[BenchmarkYapDatabaseContention runTestsWithCompletion:^{
+					
+					databaseBenchmarksButton.enabled = YES;
+					cacheBenchmarksButton.enabled = YES;
+				}];
+			}];
 		}];
 	});
 }
@@ -45,8 +55,14 @@
 		
 		[BenchmarkYapCache runTestsWithCompletion:^{
 			
-			databaseBenchmarksButton.enabled = YES;
-			cacheBenchmarksButton.enabled = YES;
+			[BenchmarkYapDatabaseViewChange runTestsWithCompletion:^{
+				
+				[BenchmarkYapManyToManyCache runTestsWithCompletion:^{
+					
+					databaseBenchmarksButton.enabled = YES;
+					cacheBenchmarksButton.enabled = YES;
+				}];
+			}];
 		}];
 	});
 }
@@ -1,6 +1,10 @@
 #import "ViewController.h"
 #import "BenchmarkYapCache.h"
 #import "BenchmarkYapDatabase.h"
+#import "BenchmarkYapDatabaseContention.h"
+#import "BenchmarkYapDatabaseExtensions.h"
+#import "BenchmarkYapDatabaseViewChange.h"
+#import "BenchmarkYapManyToManyCache.h"
 
 
 @implementation ViewController
@@ -19,8 +23,14 @@
 		
 		[BenchmarkYapDatabase runTestsWithCompletion:^{
 			
-			yapDatabaseBenchmarksButton.enabled = YES;
-			cacheBenchmarksButton.enabled = YES;
+			[BenchmarkYapDatabaseExtensions runTestsWithCompletion:^{
+				
+				[BenchmarkYapDatabaseContention runTestsWithCompletion:^{
+					
+					yapDatabaseBenchmarksButton.enabled = YES;
+					cacheBenchmarksButton.enabled = YES;
+				}];
+			}];
 		}];
 	});
 }
@@ -36,8 +46,14 @@
 		
 		[BenchmarkYapCache runTestsWithCompletion:^{
 			
-			yapDatabaseBenchmarksButton.enabled = YES;
-			cacheBenchmarksButton.enabled = YES;
+			[BenchmarkYapDatabaseViewChange runTestsWithCompletion:^{
+				
+				[BenchmarkYapManyToManyCache runTestsWithCompletion:^{
+					
+					yapDatabaseBenchmarksButton.enabled = YES;
+					cacheBenchmarksButton.enabled = YES;
+				}];
+			}];
 		}];
 	});
 }
@@ -18,6 +18,25 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+/**
+ * An entry in the schedule (min-heap ordered by time).
+ *
+ * Entries are never removed from the middle of the heap.
+ * Instead, an entry is only valid if it's still the current entry for its collectionKey (in scheduleEntries).
+**/
+@interface YapActionScheduleEntry : NSObject {
+@public
+	NSTimeInterval time;
+	YapCollectionKey *collectionKey;
+}
+@end
+
+@implementation YapActionScheduleEntry
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 @interface YapDatabaseActionManager ()
 
@@ -34,6 +53,14 @@
 	
 	NSMutableDictionary *actionItemsDict;
 	
+	NSMutableArray<YapActionScheduleEntry *> *scheduleHeap;                          // min-heap by time
+	NSMutableDictionary<YapCollectionKey *, YapActionScheduleEntry *> *scheduleEntries; // current entry per ck
+	
+	NSMutableSet<YapCollectionKey *> *collectionKeysToProcess;
+	NSMutableSet<YapCollectionKey *> *pendingInternetCollectionKeys;
+	
+	NSDate *viewHorizonDate;
+	
 	dispatch_source_t timer;
 	dispatch_queue_t timerQueue;
 	BOOL timerSuspended;
@@ -117,6 +144,12 @@
 		
 		actionItemsDict = [[NSMutableDictionary alloc] init];
 		
+		scheduleHeap = [[NSMutableArray alloc] init];
+		scheduleEntries = [[NSMutableDictionary alloc] init];
+		
+		collectionKeysToProcess = [[NSMutableSet alloc] init];
+		pendingInternetCollectionKeys = [[NSMutableSet alloc] init];
+		
 		suspendCount = 0;
 		suspendCountLock = YAP_UNFAIR_LOCK_INIT;
 	}
@@ -455,8 +488,11 @@
 		
 		// Remember: when a timer fires, this may indicate that our last YapActionItem has expired.
 		// So it's important we check the database for more YapActionItems.
+		//
+		// Note: The actionItemsDict is kept up-to-date via databaseModified notifications.
+		// So we only need to check the view for objects we haven't loaded yet (if the viewHorizonDate has passed).
 		
-		[self updateActionItemsDictWithTransaction:transaction databaseModifiedNotification:nil];
+		[self loadDueActionItemsWithTransaction:transaction];
 		[self processActionItemsDictWithTransaction:transaction];
 	}];
 }
@@ -477,7 +513,9 @@
 	[databaseConnection asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction) {
 		
 		// If it's just a reachability change, then there's no need to check the database.
+		// We only need to process the items that were waiting for internet.
 		
+		[collectionKeysToProcess unionSet:pendingInternetCollectionKeys];
 		[self processActionItemsDictWithTransaction:transaction];
 	}];
 }
@@ -500,97 +538,68 @@
 }
 
 /**
- * Populates/updates the actionItemsDict by enumerating the objects in the view,
- * and extracting their list of YapActionItems. The items are then sorted and placed into the actionItemsDict.
+ * Populates/updates the actionItemsDict.
+ *
+ * If there's no dbModifiedNotification, this method enumerates the objects in the view
+ * (at least until it finds an object for which all YapActionItems are set to start in the future),
+ * and then re-checks every object already in the actionItemsDict.
+ *
+ * Otherwise, only the objects that were changed in the commit are checked.
 **/
 - (void)updateActionItemsDictWithTransaction:(YapDatabaseReadTransaction *)transaction
                 databaseModifiedNotification:(NSNotification *)dbModifiedNotification
 {
-	NSArray *dbNotifications = dbModifiedNotification ? @[ dbModifiedNotification ] : nil;
-	NSDate *now = [NSDate date];
-	
-	NSMutableSet *collectionKeysNotChecked = [NSMutableSet setWithArray:actionItemsDict.allKeys];
-	
 	YapDatabaseActionManagerTransaction *extTransaction = [transaction ext:self.registeredName];
 	
-	// STEP 1 of 2
-	//
-	// Enumerate the objects in the view,
-	// at least until we find an object for which all YapActionItems are set to start in the future.
-	
-	{ // limit scope
-		
-		__block YapCollectionKey *collectionKey;
-		
-		NSUInteger count = [extTransaction numberOfItemsInGroup:@""];
+	if (dbModifiedNotification && ![self requiresFullUpdateForNotification:dbModifiedNotification
+	                                                           transaction:transaction])
+	{
+		NSArray *dbNotifications = @[ dbModifiedNotification ];
 		
-		[extTransaction enumerateKeysAndObjectsInGroup:@""
-		                                   withOptions:0
-		                                         range:NSMakeRange(0, count)
-		                                        filter: ^BOOL (NSString *collection, NSString *key)
+		[transaction.connection enumerateChangedCollectionKeysInNotifications:dbNotifications
+		                                                           usingBlock:^(YapCollectionKey *ck, BOOL *stop)
 		{
-			//
-			// Filtering Block (allows us to skip object deserialzation for unneeded rows)
-			//
+		#pragma clang diagnostic push // silence warnings: synchronous access
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 			
-			collectionKey = YapCollectionKeyCreate(collection, key);
-			[collectionKeysNotChecked removeObject:collectionKey];
+			// Skip objects that aren't in the view, and that didn't previously have YapActionItems.
+			// (This allows us to skip object deserialization for unrelated changes.)
 			
-			if (dbNotifications == nil)
-			{
-				return YES; // process row
-			}
-			else
+			if ([actionItemsDict objectForKey:ck] == nil &&
+			    [extTransaction groupForKey:ck.key inCollection:ck.collection] == nil)
 			{
-				if ([transaction.connection hasChangeForKey:key inCollection:collection inNotifications:dbNotifications])
-					return YES; // process row
-				else
-					return NO;  // skip row (no need to process since it hasn't changed)
+				return;
 			}
 			
-		} usingBlock:^(NSString *collection, NSString *key, id object, NSUInteger index, BOOL *stop) {
-		#pragma clang diagnostic push // silence warnings: synchronous access
-		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-			
-			//
-			// Processing Block
-			//
-			
-			NSArray<YapActionItem *> *actionItems = [extTransaction actionItemsForCollectionKey:collectionKey];
+			NSArray<YapActionItem *> *actionItems = [extTransaction actionItemsForCollectionKey:ck];
 			
 			if ([actionItems count] == 0)
 			{
-				[actionItemsDict removeObjectForKey:collectionKey];
+				[self removeCollectionKey:ck];
 			}
 			else
 			{
-				YDBLogVerbose(@"collection(%@) key(%@) actionItems: %@", collection, key, actionItems);
+				YDBLogVerbose(@"collection(%@) key(%@) actionItems: %@", ck.collection, ck.key, actionItems);
 				
-				NSArray *newActionItems = [self mergeUpdatedActionItems:actionItems forCollectionKey:collectionKey];
-				
-				if (dbNotifications == nil)
-				{
-					// There's no need to process every single object in the view.
-					// That is, we don't have to have every single YapActionItem in memory.
-					// If we know that an object has only YapActionItems in the future,
-					// then we can request the YapActionItems at a later date.
-					//
-					// So the idea is, we can stop processing as soon as we find an object with only YapActionItems
-					// in the future.
-					
-					YapActionItem *earliestActionItem = [newActionItems firstObject];
-					if (![earliestActionItem isReadyToStartAtDate:now])
-					{
-						*stop = YES;
-					}
-				}
+				[self mergeUpdatedActionItems:actionItems forCollectionKey:ck];
 			}
 			
 		#pragma clang diagnostic pop
 		}];
 		
+		YDBLogVerbose(@"actionItemsDict: %@", actionItemsDict);
+		return;
 	}
 	
+	NSMutableSet *collectionKeysNotChecked = [NSMutableSet setWithArray:actionItemsDict.allKeys];
+	
+	// STEP 1 of 2
+	//
+	// Enumerate the objects in the view,
+	// at least until we find an object for which all YapActionItems are set to start in the future.
+	
+	[self enumerateViewWithTransaction:transaction skipLoaded:NO collectionKeysNotChecked:collectionKeysNotChecked];
+	
 	// STEP 2 of 2:
 	//
 	// Process any objects that were already in the actionItemsDict, but which didn't get processed above.
@@ -618,7 +627,7 @@
 		
 		if ([actionItems count] == 0)
 		{
-			[actionItemsDict removeObjectForKey:ck];
+			[self removeCollectionKey:ck];
 		}
 		else
 		{
@@ -629,6 +638,243 @@
 	YDBLogVerbose(@"actionItemsDict: %@", actionItemsDict);
 }
 
+/**
+ * Returns YES if the changeset doesn't list every changed key.
+ * That is, if a collection was cleared, or changed by a transaction with a coarse changeset.
+**/
+- (BOOL)requiresFullUpdateForNotification:(NSNotification *)notification
+                              transaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabaseConnection *connection = transaction.connection;
+	NSArray *dbNotifications = @[ notification ];
+	
+	if ([connection didClearAllCollectionsInNotifications:dbNotifications]) {
+		return YES;
+	}
+	
+	NSMutableSet *collections = [NSMutableSet setWithArray:[transaction allCollections]];
+	for (YapCollectionKey *ck in actionItemsDict)
+	{
+		[collections addObject:ck.collection];
+	}
+	
+	for (NSString *collection in collections)
+	{
+		if ([connection didClearCollection:collection inNotifications:dbNotifications] ||
+		    [connection didResetCollection:collection inNotifications:dbNotifications])
+		{
+			return YES;
+		}
+	}
+	
+	return NO;
+}
+
+/**
+ * Invoked when the timer fires.
+ *
+ * The objects we haven't loaded into the actionItemsDict are all scheduled at (or after) the viewHorizonDate.
+ * So, if that date has passed, we continue enumerating the view (skipping the objects we've already loaded).
+**/
+- (void)loadDueActionItemsWithTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (viewHorizonDate == nil) return;
+	
+	if ([[NSDate date] ydb_isBefore:viewHorizonDate]) return;
+	
+	[self enumerateViewWithTransaction:transaction skipLoaded:YES collectionKeysNotChecked:nil];
+}
+
+/**
+ * Enumerates the objects in the view (which is sorted by the earliest YapActionItem.date),
+ * until we find an object for which all YapActionItems are set to start in the future.
+ *
+ * The date of that object becomes the viewHorizonDate.
+ * Or, if we enumerate the entire view, the viewHorizonDate becomes nil (everything is loaded).
+**/
+- (void)enumerateViewWithTransaction:(YapDatabaseReadTransaction *)transaction
+                          skipLoaded:(BOOL)skipLoaded
+            collectionKeysNotChecked:(NSMutableSet *)collectionKeysNotChecked
+{
+	NSDate *now = [NSDate date];
+	
+	YapDatabaseActionManagerTransaction *extTransaction = [transaction ext:self.registeredName];
+	
+	__block YapCollectionKey *collectionKey;
+	__block NSDate *horizonDate = nil;
+	
+	NSUInteger count = [extTransaction numberOfItemsInGroup:@""];
+	
+	// Note: We only enumerate the keys.
+	// The view is already sorted by the earliest YapActionItem.date (and persisted),
+	// so it acts as our index, and the only objects we need to fetch are those we actually load.
+	// (The actionItems are extracted via the extTransaction, which caches them,
+	//  so the object isn't deserialized by the view enumeration as well.)
+	
+	[extTransaction enumerateKeysInGroup:@""
+	                         withOptions:0
+	                               range:NSMakeRange(0, count)
+	                          usingBlock:^(NSString *collection, NSString *key, NSUInteger index, BOOL *stop)
+	{
+	#pragma clang diagnostic push // silence warnings: synchronous access
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		collectionKey = YapCollectionKeyCreate(collection, key);
+		[collectionKeysNotChecked removeObject:collectionKey];
+		
+		if (skipLoaded && [actionItemsDict objectForKey:collectionKey])
+		{
+			return; // skip row (already loaded, and kept up-to-date via databaseModified notifications)
+		}
+		
+		NSArray<YapActionItem *> *actionItems = [extTransaction actionItemsForCollectionKey:collectionKey];
+		
+		if ([actionItems count] == 0)
+		{
+			[self removeCollectionKey:collectionKey];
+		}
+		else
+		{
+			YDBLogVerbose(@"collection(%@) key(%@) actionItems: %@", collection, key, actionItems);
+			
+			NSArray *newActionItems = [self mergeUpdatedActionItems:actionItems forCollectionKey:collectionKey];
+			
+			// There's no need to process every single object in the view.
+			// That is, we don't have to have every single YapActionItem in memory.
+			// If we know that an object has only YapActionItems in the future,
+			// then we can request the YapActionItems at a later date.
+			//
+			// So the idea is, we can stop processing as soon as we find an object with only YapActionItems
+			// in the future.
+			
+			YapActionItem *earliestActionItem = [newActionItems firstObject];
+			if (![earliestActionItem isReadyToStartAtDate:now])
+			{
+				horizonDate = earliestActionItem.date;
+				*stop = YES;
+			}
+		}
+		
+	#pragma clang diagnostic pop
+	}];
+	
+	viewHorizonDate = horizonDate;
+}
+
+/**
+ * Removes all state associated with the given collectionKey.
+**/
+- (void)removeCollectionKey:(YapCollectionKey *)collectionKey
+{
+	[actionItemsDict removeObjectForKey:collectionKey];
+	[scheduleEntries removeObjectForKey:collectionKey]; // heap entry becomes stale
+	
+	[collectionKeysToProcess removeObject:collectionKey];
+	[pendingInternetCollectionKeys removeObject:collectionKey];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Schedule
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Schedules the collectionKey to be processed at the given date,
+ * replacing any previous schedule for it. A nil date simply unschedules it.
+**/
+- (void)scheduleCollectionKey:(YapCollectionKey *)collectionKey atDate:(NSDate *)date
+{
+	if (date == nil)
+	{
+		[scheduleEntries removeObjectForKey:collectionKey];
+		return;
+	}
+	
+	YapActionScheduleEntry *entry = [[YapActionScheduleEntry alloc] init];
+	entry->time = [date timeIntervalSinceReferenceDate];
+	entry->collectionKey = collectionKey;
+	
+	[scheduleEntries setObject:entry forKey:collectionKey];
+	
+	// If there are too many stale entries, rebuild the heap from the valid entries.
+	
+	if (scheduleHeap.count > ((scheduleEntries.count * 2) + 64))
+	{
+		[scheduleHeap setArray:[scheduleEntries allValues]];
+		
+		for (NSUInteger i = scheduleHeap.count / 2; i > 0; i--)
+		{
+			[self siftDownScheduleHeapAtIndex:(i - 1)];
+		}
+		return;
+	}
+	
+	// Sift up
+	
+	NSUInteger index = scheduleHeap.count;
+	[scheduleHeap addObject:entry];
+	
+	while (index > 0)
+	{
+		NSUInteger parentIndex = (index - 1) / 2;
+		if (scheduleHeap[index]->time >= scheduleHeap[parentIndex]->time) break;
+		
+		[scheduleHeap exchangeObjectAtIndex:index withObjectAtIndex:parentIndex];
+		index = parentIndex;
+	}
+}
+
+- (void)siftDownScheduleHeapAtIndex:(NSUInteger)index
+{
+	NSUInteger count = scheduleHeap.count;
+	
+	while (YES)
+	{
+		NSUInteger left = (2 * index) + 1;
+		NSUInteger right = left + 1;
+		NSUInteger best = index;
+		
+		if (left < count && scheduleHeap[left]->time < scheduleHeap[best]->time)
+			best = left;
+		if (right < count && scheduleHeap[right]->time < scheduleHeap[best]->time)
+			best = right;
+		
+		if (best == index) break;
+		
+		[scheduleHeap exchangeObjectAtIndex:index withObjectAtIndex:best];
+		index = best;
+	}
+}
+
+/**
+ * Returns the earliest valid entry (discarding stale entries along the way), or nil if nothing is scheduled.
+**/
+- (YapActionScheduleEntry *)peekScheduleHeap
+{
+	while (scheduleHeap.count > 0)
+	{
+		YapActionScheduleEntry *entry = scheduleHeap[0];
+		if ([scheduleEntries objectForKey:entry->collectionKey] == entry)
+		{
+			return entry;
+		}
+		
+		[self popScheduleHeap];
+	}
+	
+	return nil;
+}
+
+- (void)popScheduleHeap
+{
+	NSUInteger count = scheduleHeap.count;
+	if (count == 0) return;
+	
+	[scheduleHeap exchangeObjectAtIndex:0 withObjectAtIndex:(count - 1)];
+	[scheduleHeap removeLastObject];
+	
+	[self siftDownScheduleHeapAtIndex:0];
+}
+
 /**
  * Helper method for updateActionItemsDictWithTransaction:databaseModifiedNotification:
  *
@@ -701,28 +947,52 @@
 		}
 	}
 	
-	// Put the actionItems array into the actionItemsDict.
+	// Put the actionItems array into the actionItemsDict,
+	// and mark the object for processing (which will reschedule it).
 	
 	[actionItemsDict setObject:newActionItems forKey:collectionKey];
+	[collectionKeysToProcess addObject:collectionKey];
 	
 	return newActionItems;
 }
 
 /**
- * Process each YapctionItem, starting/retrying them if needed.
- * And then start a timer to fire for the next pending YapActionItem.
+ * Process the YapActionItems of each object that is due (according to the schedule),
+ * or that was marked for processing (changed objects, or objects waiting for internet after a reachability change),
+ * starting/retrying them if needed.
+ * Each processed object is then rescheduled for the next date one of its YapActionItems needs attention.
+ * And then start a timer to fire for the next scheduled object.
 **/
 - (void)processActionItemsDictWithTransaction:(YapDatabaseReadTransaction *)transaction
 {
 	YDBLogAutoTrace();
 	
 	NSDate *now = [NSDate date];
+	NSTimeInterval nowTime = [now timeIntervalSinceReferenceDate];
 	BOOL hasInternet = self.hasInternet;
 	
-	__block NSMutableArray *collectionKeysToRemove = nil;
-	__block NSDate *nextTimerFireDate = nil;
+	// Pop every scheduled object that is due
 	
-	[actionItemsDict enumerateKeysAndObjectsUsingBlock:^(YapCollectionKey *ck, NSArray *actionItems, BOOL *dictStop) {
+	YapActionScheduleEntry *entry = nil;
+	while ((entry = [self peekScheduleHeap]) && (entry->time <= nowTime))
+	{
+		[collectionKeysToProcess addObject:entry->collectionKey];
+		
+		[scheduleEntries removeObjectForKey:entry->collectionKey];
+		[self popScheduleHeap];
+	}
+	
+	NSArray *collectionKeys = [collectionKeysToProcess allObjects];
+	[collectionKeysToProcess removeAllObjects];
+	
+	for (YapCollectionKey *ck in collectionKeys)
+	{
+		NSArray *actionItems = [actionItemsDict objectForKey:ck];
+		if (actionItems == nil) continue;
+		
+		__block NSDate *nextActionDate = nil;
+		__block BOOL isPendingInternet = NO;
+		__block BOOL objectRemoved = NO;
 		
 		[actionItems enumerateObjectsUsingBlock:^(YapActionItem *actionItem, NSUInteger idx, BOOL *itemsStop) {
 			
@@ -796,10 +1066,8 @@
 					//
 					// No worries. We just queue the associated YapActionItems to be removed.
 					
-					if (collectionKeysToRemove == nil)
-						collectionKeysToRemove = [NSMutableArray array];
-					
-					[collectionKeysToRemove addObject:ck];
+					objectRemoved = YES;
+					*itemsStop = YES;
 					
 					actionDate = nil;
 				}
@@ -831,17 +1099,47 @@
 			
 			if (actionDate)
 			{
-				if (nextTimerFireDate == nil)
-					nextTimerFireDate = actionDate;
+				if (nextActionDate == nil)
+					nextActionDate = actionDate;
 				else
-					nextTimerFireDate = [nextTimerFireDate earlierDate:actionDate];
+					nextActionDate = [nextActionDate earlierDate:actionDate];
+			}
+			
+			if (actionItem.isPendingInternet) {
+				isPendingInternet = YES;
 			}
 		}];
-	}];
+		
+		if (objectRemoved)
+		{
+			[self removeCollectionKey:ck];
+			continue;
+		}
+		
+		[self scheduleCollectionKey:ck atDate:nextActionDate];
+		
+		if (isPendingInternet)
+			[pendingInternetCollectionKeys addObject:ck];
+		else
+			[pendingInternetCollectionKeys removeObject:ck];
+	}
+	
+	// The next timer fire date is the earliest scheduled object,
+	// or the viewHorizonDate (when we need to load more objects from the view).
+	
+	NSDate *nextTimerFireDate = nil;
 	
-	if (collectionKeysToRemove)
+	entry = [self peekScheduleHeap];
+	if (entry) {
+		nextTimerFireDate = [NSDate dateWithTimeIntervalSinceReferenceDate:entry->time];
+	}
+	
+	if (viewHorizonDate)
 	{
-		[actionItemsDict removeObjectsForKeys:collectionKeysToRemove];
+		if (nextTimerFireDate == nil)
+			nextTimerFireDate = viewHorizonDate;
+		else
+			nextTimerFireDate = [nextTimerFireDate earlierDate:viewHorizonDate];
 	}
 	
 	[self updateTimerWithDate:nextTimerFireDate];
@@ -71,6 +71,17 @@
 	
 	NSSet<YapCollectionKey *> *removedKeys        = [changeset objectForKey:YapDatabaseRemovedKeysKey];
 	NSSet<NSString *>         *removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
+	NSSet<NSString *>         *resetCollections   = [changeset objectForKey:YapDatabaseResetCollectionsKey];
+	
+	if (resetCollections.count > 0)
+	{
+		// A reset collection (see coarseChangeset) may have changed any key within it
+		
+		if (removedCollections.count > 0)
+			removedCollections = [removedCollections setByAddingObjectsFromSet:resetCollections];
+		else
+			removedCollections = resetCollections;
+	}
 	
 	BOOL databaseCleared = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
 	
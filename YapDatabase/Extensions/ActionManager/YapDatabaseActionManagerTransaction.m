@@ -113,6 +113,25 @@
 	[super didTouchObjectForCollectionKey:collectionKey withRowid:rowid];
 }
 
+/**
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - touchObjectsForKeys:inCollection:
+**/
+- (void)didTouchObjectsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                              withRowids:(NSArray<NSNumber *> *)rowids
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseActionManagerConnection *amConnection =
+	  (YapDatabaseActionManagerConnection *)parentConnection;
+	
+	[amConnection->actionItemsCache removeObjectsForKeys:collectionKeys];
+	
+	[super didTouchObjectsForCollectionKeys:collectionKeys withRowids:rowids];
+}
+
 /**
  * Subclasses MUST implement this method.
  * YapDatabaseReadWriteTransaction Hook, invoked post-op.
@@ -38,10 +38,26 @@
 	YapDatabaseViewSortingBlock block;
 	YapDatabaseBlockType        blockType;
 	YapDatabaseBlockInvoke      blockInvokeOptions;
+	
+	YapDatabaseViewSortKeyBlock sortKeyBlock;
 }
 
 @end
 
+/**
+ * Compares the sort keys returned by a YapDatabaseViewSortKeyBlock (nil is ordered first).
+**/
+NS_INLINE NSComparisonResult YapDatabaseViewCompareSortKeys(id sortKey1, id sortKey2)
+{
+	if (sortKey1 == nil || sortKey2 == nil)
+	{
+		if (sortKey1 == sortKey2) return NSOrderedSame;
+		return (sortKey1 == nil) ? NSOrderedAscending : NSOrderedDescending;
+	}
+	
+	return [sortKey1 compare:sortKey2];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -72,6 +88,10 @@
 	
 	BOOL lastInsertWasAtFirstIndex;
 	BOOL lastInsertWasAtLastIndex;
+	
+	// rowid -> sort key (or NSNull, for a nil sort key).
+	// Only used if the sorting has a sortKeyBlock, and cleared at the end of every readWrite transaction.
+	NSMutableDictionary<NSNumber *, id> *sortKeyCache;
 }
 
 - (void)getGrouping:(YapDatabaseViewGrouping **)groupingPtr
@@ -82,6 +82,14 @@
 	return [[YapDatabaseAutoViewConnection alloc] initWithParent:self databaseConnection:databaseConnection];
 }
 
+/**
+ * Rows outside the allowedCollections are never added to the view.
+**/
+- (YapWhitelistBlacklist *)interestedCollections
+{
+	return options.allowedCollections;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Changeset
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
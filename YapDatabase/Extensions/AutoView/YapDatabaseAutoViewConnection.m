@@ -105,6 +105,11 @@
 	
 	groupingChanged = NO;
 	sortingChanged = NO;
+	
+	// The sort keys are only valid for the duration of a readWrite transaction,
+	// as other connections may modify the rows (without moving them within the view).
+	
+	sortKeyCache = nil;
 }
 
 /**
@@ -123,6 +128,11 @@
 	
 	groupingChanged = NO;
 	sortingChanged = NO;
+	
+	// The sort keys are only valid for the duration of a readWrite transaction,
+	// as other connections may modify the rows (without moving them within the view).
+	
+	sortKeyCache = nil;
 }
 
 - (void)getInternalChangeset:(NSMutableDictionary **)internalChangesetPtr
@@ -142,6 +142,40 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (NSUInteger)findFirstMatchInGroup:(NSString *)group using:(YapDatabaseViewFind *)find;
 
+#pragma mark Merged Enumeration
+
+/**
+ * Enumerates the rows of several groups as if they were a single group, ordered by the view's sorting.
+ *
+ * For example, an "all inboxes" list, where each inbox is a group of the same view.
+ * Rather than maintaining a second view (with a single group), the groups are merged on the fly.
+ * Each group is already sorted, so this is a k-way merge: only the first (remaining) row of each group is
+ * compared (using a heap), and the rows are read from the view's pages in batches.
+ * There's no sorting, and the merged list is never materialized.
+ *
+ * The sorting must order rows consistently across the given groups.
+ * If the sorting has a sortKeyBlock, each row's sort key is computed once, and the sort keys are compared.
+ * Otherwise, the sorting block is invoked with the group of the first row being compared.
+ * Rows that are equal are ordered by the position of their group within the given groups.
+ *
+ * @param groups
+ *   The groups to merge. Groups that don't exist (or are empty) are ignored.
+ *
+ * @param range
+ *   The range within the merged list to enumerate. The index passed to the block is the index within the merged list.
+ *   This allows a window of the merged list to be displayed (e.g. by a tableView backed by mappings),
+ *   without enumerating the rows after the window.
+ *   Note that the rows before the window still need to be merged, so the cost is O((location + length) * log(groups)).
+**/
+- (void)enumerateKeysInGroups:(NSArray<NSString *> *)groups
+  withMergedSortingUsingBlock:(void (^)(NSString *collection, NSString *key, NSString *group,
+                                        NSUInteger index, BOOL *stop))block;
+
+- (void)enumerateKeysInGroups:(NSArray<NSString *> *)groups
+                        range:(NSRange)range
+  withMergedSortingUsingBlock:(void (^)(NSString *collection, NSString *key, NSString *group,
+                                        NSUInteger index, BOOL *stop))block;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -159,11 +193,25 @@ NS_ASSUME_NONNULL_BEGIN
  * 
  * Note: You must pass a different versionTag, or this method does nothing.
  * If needed, you can fetch the current versionTag via the [viewTransaction versionTag] method.
+ *
+ * If you pass the current grouping (the same instance), then only the sorting changes.
+ * See setSorting:versionTag:.
 **/
 - (void)setGrouping:(YapDatabaseViewGrouping *)grouping
             sorting:(YapDatabaseViewSorting *)sorting
          versionTag:(nullable NSString *)versionTag;
 
+/**
+ * This method allows you to change only the sorting on-the-fly.
+ *
+ * Every row stays in its group (so the grouping block isn't invoked),
+ * and every group is re-sorted in place, using only the rows that are already in the view.
+ * This is much faster than repopulating the entire view, which is what a change of grouping requires.
+ *
+ * Note: You must pass a different versionTag, or this method does nothing.
+**/
+- (void)setSorting:(YapDatabaseViewSorting *)sorting versionTag:(nullable NSString *)versionTag;
+
 @end
 
 NS_ASSUME_NONNULL_END
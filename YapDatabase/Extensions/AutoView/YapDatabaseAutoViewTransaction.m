@@ -26,6 +26,58 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+/**
+ * A row collected during populateView (to be sorted, in bulk, once the enumeration is complete).
+ * The object & metadata are only retained if the sorting block needs them.
+ * Or, if the sorting has a sortKeyBlock, only the sort key is retained.
+**/
+@interface YapDatabaseAutoViewPopulationItem : NSObject {
+@public
+	
+	int64_t rowid;
+	YapCollectionKey *collectionKey;
+	id object;
+	id metadata;
+	id sortKey;
+}
+@end
+
+@implementation YapDatabaseAutoViewPopulationItem
+@end
+
+/**
+ * The number of rowids read (from the view's pages) at a time, by each cursor of a merged enumeration.
+**/
+#define YapDatabaseAutoViewMergeBatchSize 50
+
+/**
+ * A cursor over a single group, used by the merged enumeration (see enumerateKeysInGroups:...).
+ * It holds the current row of the group (along with whatever the sorting needs to compare it),
+ * and a batch of the upcoming rowids.
+**/
+@interface YapDatabaseAutoViewMergeCursor : NSObject {
+@public
+	
+	NSString *group;
+	NSUInteger order; // position within the given groups (breaks ties)
+	NSUInteger count; // number of rows in the group
+	NSUInteger index; // index (within the group) of the current row
+	
+	int64_t rowids[YapDatabaseAutoViewMergeBatchSize];
+	NSUInteger batchIndex; // index (within the group) of rowids[0]
+	NSUInteger batchCount;
+	
+	int64_t rowid;
+	YapCollectionKey *collectionKey;
+	id object;
+	id metadata;
+	id sortKey;
+}
+@end
+
+@implementation YapDatabaseAutoViewMergeCursor
+@end
+
 
 @implementation YapDatabaseAutoViewTransaction
 
@@ -47,6 +99,8 @@
 	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
 	  (YapDatabaseAutoViewConnection *)parentConnection;
 	
+	viewConnection->sortKeyCache = nil; // the sorting may have changed
+	
 	YapDatabaseViewGrouping *grouping = nil;
 	YapDatabaseViewSorting  *sorting  = nil;
 	
@@ -109,7 +163,94 @@
 		};
 	}
 	
-	YapDatabaseViewChangesBitMask flags = (YapDatabaseViewChangedObject | YapDatabaseViewChangedMetadata);
+	// Rather than inserting each row into its sorted position (a binary search per row),
+	// we collect the rows of every group, and sort each group once the enumeration is complete.
+	// See insertPopulatedItems:.
+	
+	NSMutableDictionary<NSString *, NSMutableArray<YapDatabaseAutoViewPopulationItem *> *> *itemsByGroup =
+	  [[NSMutableDictionary alloc] init];
+	
+	void (^addItem)(int64_t, YapCollectionKey *, id, id, NSString *);
+	addItem = ^(int64_t rowid, YapCollectionKey *collectionKey, id object, id metadata, NSString *group){
+		
+		YapDatabaseAutoViewPopulationItem *item = [[YapDatabaseAutoViewPopulationItem alloc] init];
+		item->rowid = rowid;
+		item->collectionKey = collectionKey;
+		
+		if (sorting->sortKeyBlock)
+		{
+			item->sortKey = [self sortKeyForCollectionKey:collectionKey object:object metadata:metadata inGroup:group];
+		}
+		else
+		{
+			item->object = sortingNeedsObject ? object : nil;
+			item->metadata = sortingNeedsMetadata ? metadata : nil;
+		}
+		
+		NSMutableArray<YapDatabaseAutoViewPopulationItem *> *items = itemsByGroup[group];
+		if (items == nil)
+		{
+			items = [[NSMutableArray alloc] init];
+			itemsByGroup[group] = items;
+		}
+		
+		[items addObject:item];
+	};
+	
+	YapDatabaseExtensionPopulation *population =
+	  ((YapDatabaseReadWriteTransaction *)databaseTransaction)->extensionPopulation;
+	
+	if (population && !isRepopulate)
+	{
+		// Multiple extensions are being registered together.
+		// The rows will be handed to us during a shared enumeration of the database.
+		
+		YapDatabaseBlockType blockType = YapDatabaseBlockTypeWithKey;
+		if (needsObject)   blockType |= YapDatabaseBlockType_ObjectFlag;
+		if (needsMetadata) blockType |= YapDatabaseBlockType_MetadataFlag;
+		
+		BOOL groupingNeedsRow = groupingNeedsObject || groupingNeedsMetadata;
+		
+		__block NSString *group = nil;
+		
+		BOOL (^filter)(int64_t rowid, NSString *collection, NSString *key) = nil;
+		if (!groupingNeedsRow)
+		{
+			// Optimization: Grouping doesn't require the object or metadata.
+			// So we can skip the deserialization step for any rows not in the view.
+			
+			filter = ^BOOL(int64_t __unused rowid, NSString *collection, NSString *key) {
+				
+				group = getGroup(collection, key, nil, nil);
+				return (group != nil);
+			};
+		}
+		
+		YapDatabaseExtensionPopulationBlock block =
+		^(int64_t rowid, NSString *collection, NSString *key, id object, id metadata){
+			
+			if (groupingNeedsRow)
+			{
+				group = getGroup(collection, key, (needsObject ? object : nil), (needsMetadata ? metadata : nil));
+				if (group == nil) return;
+			}
+			
+			YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			
+			addItem(rowid, collectionKey, object, metadata, group);
+		};
+		
+		[population addParticipantWithName:[self registeredName]
+		                allowedCollections:parentConnection->parent->options.allowedCollections
+		                         blockType:blockType
+		                            filter:filter
+		                             block:block
+		                        completion:^{
+			
+			[self insertPopulatedItems:itemsByGroup];
+		}];
+		return YES;
+	}
 	
 	if (needsObject && needsMetadata)
 	{
@@ -123,11 +264,7 @@
 				{
 					YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-					[self insertRowid:rowid
-					    collectionKey:collectionKey
-					           object:object
-					         metadata:metadata
-					          inGroup:group withChanges:flags isNew:YES];
+					addItem(rowid, collectionKey, object, metadata, group);
 				}
 			};
 			
@@ -165,11 +302,7 @@
 				
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:object
-				         metadata:metadata
-				          inGroup:group withChanges:flags isNew:YES];
+				addItem(rowid, collectionKey, object, metadata, group);
 			};
 			
 			YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
@@ -203,11 +336,7 @@
 				{
 					YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-					[self insertRowid:rowid
-					    collectionKey:collectionKey
-					           object:object
-					          metadata:nil
-					           inGroup:group withChanges:flags isNew:YES];
+					addItem(rowid, collectionKey, object, nil, group);
 				}
 			};
 			
@@ -247,11 +376,7 @@
 				
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 				
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:object
-				          metadata:nil
-				        inGroup:group withChanges:flags isNew:YES];
+				addItem(rowid, collectionKey, object, nil, group);
 			};
 			
 			YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
@@ -285,11 +410,7 @@
 				{
 					YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-					[self insertRowid:rowid
-					    collectionKey:collectionKey
-					           object:nil
-					         metadata:metadata
-					          inGroup:group withChanges:flags isNew:YES];
+					addItem(rowid, collectionKey, nil, metadata, group);
 				}
 			};
 			
@@ -330,11 +451,7 @@
 				
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 				
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:nil
-				         metadata:metadata
-				          inGroup:group withChanges:flags isNew:YES];
+				addItem(rowid, collectionKey, nil, metadata, group);
 			};
 			
 			YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
@@ -366,11 +483,7 @@
 			{
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 				
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:nil
-				         metadata:nil
-				          inGroup:group withChanges:flags isNew:YES];
+				addItem(rowid, collectionKey, nil, nil, group);
 			}
 		};
 		
@@ -391,11 +504,135 @@
 		}
 	}
 	
+	[self insertPopulatedItems:itemsByGroup];
 	return YES;
 	
 #pragma clang diagnostic pop
 }
 
+/**
+ * Sorts the given items (of the given group) with a stable sort, using the current sorting.
+**/
+- (void)sortPopulationItems:(NSMutableArray<YapDatabaseAutoViewPopulationItem *> *)items inGroup:(NSString *)group
+{
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	YapDatabaseViewSorting *sorting = nil;
+	[viewConnection getGrouping:NULL sorting:&sorting];
+	
+	NSComparator comparator = nil;
+	
+	if (sorting->sortKeyBlock)
+	{
+		comparator = ^NSComparisonResult (YapDatabaseAutoViewPopulationItem *item1,
+		                                  YapDatabaseAutoViewPopulationItem *item2)
+		{
+			return YapDatabaseViewCompareSortKeys(item1->sortKey, item2->sortKey);
+		};
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithKey)
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithKeyBlock sortingBlock =
+		    (YapDatabaseViewSortingWithKeyBlock)sorting->block;
+		
+		comparator = ^NSComparisonResult (YapDatabaseAutoViewPopulationItem *item1,
+		                                  YapDatabaseAutoViewPopulationItem *item2)
+		{
+			return sortingBlock(databaseTransaction, group,
+			                      item1->collectionKey.collection, item1->collectionKey.key,
+			                      item2->collectionKey.collection, item2->collectionKey.key);
+		};
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithObject)
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithObjectBlock sortingBlock =
+		    (YapDatabaseViewSortingWithObjectBlock)sorting->block;
+		
+		comparator = ^NSComparisonResult (YapDatabaseAutoViewPopulationItem *item1,
+		                                  YapDatabaseAutoViewPopulationItem *item2)
+		{
+			return sortingBlock(databaseTransaction, group,
+			                      item1->collectionKey.collection, item1->collectionKey.key, item1->object,
+			                      item2->collectionKey.collection, item2->collectionKey.key, item2->object);
+		};
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithMetadataBlock sortingBlock =
+		    (YapDatabaseViewSortingWithMetadataBlock)sorting->block;
+		
+		comparator = ^NSComparisonResult (YapDatabaseAutoViewPopulationItem *item1,
+		                                  YapDatabaseAutoViewPopulationItem *item2)
+		{
+			return sortingBlock(databaseTransaction, group,
+			                      item1->collectionKey.collection, item1->collectionKey.key, item1->metadata,
+			                      item2->collectionKey.collection, item2->collectionKey.key, item2->metadata);
+		};
+	}
+	else
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithRowBlock sortingBlock =
+		    (YapDatabaseViewSortingWithRowBlock)sorting->block;
+		
+		comparator = ^NSComparisonResult (YapDatabaseAutoViewPopulationItem *item1,
+		                                  YapDatabaseAutoViewPopulationItem *item2)
+		{
+			return sortingBlock(databaseTransaction, group,
+			    item1->collectionKey.collection, item1->collectionKey.key, item1->object, item1->metadata,
+			    item2->collectionKey.collection, item2->collectionKey.key, item2->object, item2->metadata);
+		};
+	}
+	
+	// Note: The sorting block is handed the transaction, so the sort can't be concurrent.
+	
+	[items sortWithOptions:NSSortStable usingComparator:comparator];
+	
+#pragma clang diagnostic pop
+}
+
+/**
+ * Sorts the rows collected by populateView (one group at a time), and appends them to the view.
+ *
+ * The sort is stable, so rows that compare as equal keep the enumeration order.
+ * This matches the order produced by the binary search in insertRowid:collectionKey:object:metadata:...,
+ * which places a row after any equal rows already in the group.
+**/
+- (void)insertPopulatedItems:(NSDictionary<NSString *, NSMutableArray<YapDatabaseAutoViewPopulationItem *> *> *)itemsByGroup
+{
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+	YDBLogAutoTrace();
+	
+	[itemsByGroup enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *group, NSMutableArray<YapDatabaseAutoViewPopulationItem *> *items, BOOL __unused *stop)
+	{
+		[self sortPopulationItems:items inGroup:group];
+		
+		NSUInteger count = items.count;
+		
+		int64_t *rowids = (int64_t *)malloc(sizeof(int64_t) * count);
+		NSMutableArray<YapCollectionKey *> *collectionKeys = [[NSMutableArray alloc] initWithCapacity:count];
+		
+		NSUInteger i = 0;
+		for (YapDatabaseAutoViewPopulationItem *item in items)
+		{
+			rowids[i++] = item->rowid;
+			[collectionKeys addObject:item->collectionKey];
+		}
+		
+		[self appendRowids:rowids collectionKeys:collectionKeys toGroup:group];
+		
+		free(rowids);
+	}];
+	
+#pragma clang diagnostic pop
+}
+
 - (void)repopulateView
 {
 	YDBLogAutoTrace();
@@ -451,10 +688,191 @@
 	isRepopulate = NO;
 }
 
+/**
+ * Used when only the sorting has changed.
+ *
+ * The groups (and the rows within each group) don't change.
+ * So rather than repopulating the view (invoking the grouping block for every row in the database),
+ * we only fetch the rows that are in the view, and re-sort every group in place.
+ *
+ * The sort is stable, so rows that compare as equal keep their current order.
+**/
+- (void)resortView
+{
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	viewConnection->sortKeyCache = nil; // the sorting has changed
+	
+	YapDatabaseViewSorting *sorting = nil;
+	[viewConnection getGrouping:NULL sorting:&sorting];
+	
+	BOOL sortingNeedsObject   = (sorting->blockType & YapDatabaseBlockType_ObjectFlag);
+	BOOL sortingNeedsMetadata = (sorting->blockType & YapDatabaseBlockType_MetadataFlag);
+	
+	for (NSString *group in [self allGroups])
+	{
+		NSUInteger count = [self numberOfItemsInGroup:group];
+		
+		NSMutableArray<YapDatabaseAutoViewPopulationItem *> *items = [[NSMutableArray alloc] initWithCapacity:count];
+		
+		[self enumerateRowidsInGroup:group usingBlock:^(int64_t rowid, NSUInteger __unused index, BOOL __unused *stop) {
+			
+			YapCollectionKey *collectionKey = nil;
+			id object = nil;
+			id metadata = nil;
+			
+			if (sortingNeedsObject && sortingNeedsMetadata)
+				[databaseTransaction getCollectionKey:&collectionKey object:&object metadata:&metadata forRowid:rowid];
+			else if (sortingNeedsObject)
+				[databaseTransaction getCollectionKey:&collectionKey object:&object forRowid:rowid];
+			else if (sortingNeedsMetadata)
+				[databaseTransaction getCollectionKey:&collectionKey metadata:&metadata forRowid:rowid];
+			else
+				collectionKey = [databaseTransaction collectionKeyForRowid:rowid];
+			
+			YapDatabaseAutoViewPopulationItem *item = [[YapDatabaseAutoViewPopulationItem alloc] init];
+			item->rowid = rowid;
+			item->collectionKey = collectionKey;
+			
+			if (sorting->sortKeyBlock)
+			{
+				item->sortKey = [self sortKeyForCollectionKey:collectionKey object:object metadata:metadata inGroup:group];
+			}
+			else
+			{
+				item->object = object;
+				item->metadata = metadata;
+			}
+			
+			[items addObject:item];
+		}];
+		
+		[self sortPopulationItems:items inGroup:group];
+		
+		int64_t *rowids = (int64_t *)malloc(sizeof(int64_t) * count);
+		NSMutableArray<YapCollectionKey *> *collectionKeys = [[NSMutableArray alloc] initWithCapacity:count];
+		
+		NSUInteger i = 0;
+		for (YapDatabaseAutoViewPopulationItem *item in items)
+		{
+			rowids[i++] = item->rowid;
+			[collectionKeys addObject:item->collectionKey];
+		}
+		
+		[self reorderRowids:rowids collectionKeys:collectionKeys inGroup:group];
+		
+		free(rowids);
+	}
+	
+#pragma clang diagnostic pop
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Logic
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Invokes the sortKeyBlock of the sorting.
+ * The object and metadata parameters must be properly set (if needed by the sortKeyBlock).
+**/
+- (id)sortKeyForCollectionKey:(YapCollectionKey *)collectionKey
+                       object:(id)object
+                     metadata:(id)metadata
+                      inGroup:(NSString *)group
+{
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	YapDatabaseViewSorting *sorting = nil;
+	[viewConnection getGrouping:NULL sorting:&sorting];
+	
+	if (sorting->blockType == YapDatabaseBlockTypeWithKey)
+	{
+		__unsafe_unretained YapDatabaseViewSortKeyWithKeyBlock sortKeyBlock =
+		    (YapDatabaseViewSortKeyWithKeyBlock)sorting->sortKeyBlock;
+		
+		return sortKeyBlock(databaseTransaction, group, collectionKey.collection, collectionKey.key);
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithObject)
+	{
+		__unsafe_unretained YapDatabaseViewSortKeyWithObjectBlock sortKeyBlock =
+		    (YapDatabaseViewSortKeyWithObjectBlock)sorting->sortKeyBlock;
+		
+		return sortKeyBlock(databaseTransaction, group, collectionKey.collection, collectionKey.key, object);
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		__unsafe_unretained YapDatabaseViewSortKeyWithMetadataBlock sortKeyBlock =
+		    (YapDatabaseViewSortKeyWithMetadataBlock)sorting->sortKeyBlock;
+		
+		return sortKeyBlock(databaseTransaction, group, collectionKey.collection, collectionKey.key, metadata);
+	}
+	else
+	{
+		__unsafe_unretained YapDatabaseViewSortKeyWithRowBlock sortKeyBlock =
+		    (YapDatabaseViewSortKeyWithRowBlock)sorting->sortKeyBlock;
+		
+		return sortKeyBlock(databaseTransaction, group, collectionKey.collection, collectionKey.key, object, metadata);
+	}
+}
+
+/**
+ * Returns the sort key for a row that's already in the view.
+ * If the sort key isn't cached, the row is fetched (as needed by the sortKeyBlock), and its sort key is cached.
+**/
+- (id)cachedSortKeyForRowid:(int64_t)rowid inGroup:(NSString *)group
+{
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	NSNumber *rowidNumber = @(rowid);
+	
+	id sortKey = [viewConnection->sortKeyCache objectForKey:rowidNumber];
+	if (sortKey)
+	{
+		return (sortKey == [NSNull null]) ? nil : sortKey;
+	}
+	
+	YapDatabaseViewSorting *sorting = nil;
+	[viewConnection getGrouping:NULL sorting:&sorting];
+	
+	YapCollectionKey *collectionKey = nil;
+	id object = nil;
+	id metadata = nil;
+	
+	if (sorting->blockType == YapDatabaseBlockTypeWithKey)
+	{
+		collectionKey = [databaseTransaction collectionKeyForRowid:rowid];
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithObject)
+	{
+		[databaseTransaction getCollectionKey:&collectionKey object:&object forRowid:rowid];
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		[databaseTransaction getCollectionKey:&collectionKey metadata:&metadata forRowid:rowid];
+	}
+	else
+	{
+		[databaseTransaction getCollectionKey:&collectionKey object:&object metadata:&metadata forRowid:rowid];
+	}
+	
+	sortKey = [self sortKeyForCollectionKey:collectionKey object:object metadata:metadata inGroup:group];
+	
+	if (viewConnection->sortKeyCache == nil)
+		viewConnection->sortKeyCache = [[NSMutableDictionary alloc] init];
+	
+	[viewConnection->sortKeyCache setObject:(sortKey ?: [NSNull null]) forKey:rowidNumber];
+	
+	return sortKey;
+}
+
 /**
  * Use this method after it has been determined that the key should be inserted into the given group.
  * The object and metadata parameters must be properly set (if needed by the sorting block).
@@ -478,6 +896,12 @@
 	YapDatabaseViewSorting *sorting = nil;
 	[viewConnection getGrouping:NULL sorting:&sorting];
 	
+	if (sorting->sortKeyBlock)
+	{
+		// The row is being inserted or updated, so any cached sort key is stale.
+		[viewConnection->sortKeyCache removeObjectForKey:@(rowid)];
+	}
+	
 	// Is the key already in the group?
 	// If so:
 	// - its index within the group may or may not have changed.
@@ -596,6 +1020,27 @@
 	#pragma clang diagnostic pop
 	};
 	
+	if (sorting->sortKeyBlock)
+	{
+		// Compare against the cached sort keys of the other rows,
+		// rather than invoking the sorting block (which would compute both sort keys every time).
+		
+		id sortKey = [self sortKeyForCollectionKey:collectionKey object:object metadata:metadata inGroup:group];
+		
+		if (viewConnection->sortKeyCache == nil)
+			viewConnection->sortKeyCache = [[NSMutableDictionary alloc] init];
+		
+		[viewConnection->sortKeyCache setObject:(sortKey ?: [NSNull null]) forKey:@(rowid)];
+		
+		compare = ^NSComparisonResult (NSUInteger index){
+			
+			int64_t anotherRowid = 0;
+			[self getRowid:&anotherRowid atIndex:index inGroup:group];
+			
+			return YapDatabaseViewCompareSortKeys(sortKey, [self cachedSortKeyForRowid:anotherRowid inGroup:group]);
+		};
+	}
+	
 	NSComparisonResult cmp;
 	
 	// Optimization 1:
@@ -749,7 +1194,7 @@
 	
 	YapWhitelistBlacklist *allowedCollections = view->options.allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -1094,6 +1539,63 @@
 	                    isInsert:NO];
 }
 
+/**
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - touchObjectsForKeys:inCollection:
+ *
+ * If neither the grouping nor the sorting depend on touched objects (the common case),
+ * the touches only need to be recorded as updates. So we skip the per-row setup,
+ * and check the configuration & allowedCollections once for the entire batch.
+**/
+- (void)didTouchObjectsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                              withRowids:(NSArray<NSNumber *> *)rowids
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	YapDatabaseBlockInvoke blockInvokeBitMask = YapDatabaseBlockInvokeIfObjectTouched;
+	
+	YapDatabaseViewGrouping *grouping = nil;
+	YapDatabaseViewSorting *sorting = nil;
+	
+	[viewConnection getGrouping:&grouping sorting:&sorting];
+	
+	BOOL groupingMayHaveChanged = (grouping->blockInvokeOptions & blockInvokeBitMask);
+	BOOL sortingMayHaveChanged  = (sorting->blockInvokeOptions  & blockInvokeBitMask);
+	
+	if (groupingMayHaveChanged || sortingMayHaveChanged)
+	{
+		[super didTouchObjectsForCollectionKeys:collectionKeys withRowids:rowids];
+		return;
+	}
+	
+	__unsafe_unretained YapDatabaseView *view = (YapDatabaseView *)parentConnection->parent;
+	YapWhitelistBlacklist *allowedCollections = view->options.allowedCollections;
+	
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		YapCollectionKey *collectionKey = collectionKeys[i];
+		
+		if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey]) continue;
+		
+		YapDatabaseViewLocator *locator = [self locatorForRowid:[rowids[i] longLongValue]];
+		
+		if (locator.group)
+		{
+			[parentConnection->changes addObject:
+			  [YapDatabaseViewRowChange updateCollectionKey:collectionKey
+			                                        inGroup:locator.group
+			                                        atIndex:locator.index
+			                                    withChanges:YapDatabaseViewChangedObject]];
+		}
+	}
+}
+
 /**
  * Subclasses MUST implement this method.
  * YapDatabaseReadWriteTransaction Hook, invoked post-op.
@@ -1216,7 +1718,7 @@
 	// Should we ignore the row based on the allowedCollections ?
 	
 	YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
-	if (allowedCollections && ![allowedCollections isAllowed:collectionKey.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -1501,6 +2003,284 @@
 	return NSMakeRange(sMin, (eMax - sMin));
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Public API - Merged Enumeration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See header file for extensive documentation for this method.
+**/
+- (void)enumerateKeysInGroups:(NSArray<NSString *> *)groups
+  withMergedSortingUsingBlock:(void (^)(NSString *collection, NSString *key, NSString *group,
+                                        NSUInteger index, BOOL *stop))block
+{
+	[self enumerateKeysInGroups:groups range:NSMakeRange(0, NSUIntegerMax) withMergedSortingUsingBlock:block];
+}
+
+/**
+ * See header file for extensive documentation for this method.
+**/
+- (void)enumerateKeysInGroups:(NSArray<NSString *> *)groups
+                        range:(NSRange)range
+  withMergedSortingUsingBlock:(void (^)(NSString *collection, NSString *key, NSString *group,
+                                        NSUInteger index, BOOL *stop))block
+{
+	if (block == nil) return;
+	if (range.length == 0) return;
+	
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	YapDatabaseViewSorting *sorting = nil;
+	[viewConnection getGrouping:NULL sorting:&sorting];
+	
+	// Create a cursor for every (non-empty) group, and build a min-heap from their first rows.
+	
+	NSMutableArray<YapDatabaseAutoViewMergeCursor *> *heap = [NSMutableArray arrayWithCapacity:[groups count]];
+	NSMutableSet<NSString *> *seenGroups = [NSMutableSet setWithCapacity:[groups count]];
+	
+	for (NSString *group in groups)
+	{
+		if ([seenGroups containsObject:group]) continue;
+		[seenGroups addObject:group];
+		
+		NSUInteger count = [self numberOfItemsInGroup:group];
+		if (count == 0) continue;
+		
+		YapDatabaseAutoViewMergeCursor *cursor = [[YapDatabaseAutoViewMergeCursor alloc] init];
+		cursor->group = group;
+		cursor->order = [heap count];
+		cursor->count = count;
+		cursor->index = 0;
+		
+		[self loadMergeCursor:cursor withSorting:sorting];
+		[heap addObject:cursor];
+	}
+	
+	NSUInteger heapCount = [heap count];
+	if (heapCount == 0) return;
+	
+	for (NSUInteger i = heapCount / 2; i > 0; i--)
+	{
+		[self siftDownMergeHeap:heap fromIndex:(i - 1) withSorting:sorting];
+	}
+	
+	// Repeatedly pop the smallest row, and replace it with the next row of its group.
+	
+	NSUInteger mergedIndex = 0;
+	NSUInteger rangeEnd = (range.length > (NSUIntegerMax - range.location)) ? NSUIntegerMax : NSMaxRange(range);
+	
+	BOOL stop = NO;
+	
+	while ([heap count] > 0 && mergedIndex < rangeEnd)
+	{
+		YapDatabaseAutoViewMergeCursor *cursor = heap[0];
+		
+		if (mergedIndex >= range.location)
+		{
+			YapCollectionKey *ck = cursor->collectionKey;
+			
+			block(ck.collection, ck.key, cursor->group, mergedIndex, &stop);
+			if (stop) break;
+		}
+		
+		mergedIndex++;
+		cursor->index++;
+		
+		if ([self loadMergeCursor:cursor withSorting:sorting])
+		{
+			[self siftDownMergeHeap:heap fromIndex:0 withSorting:sorting];
+		}
+		else
+		{
+			// The group is exhausted.
+			
+			[heap exchangeObjectAtIndex:0 withObjectAtIndex:([heap count] - 1)];
+			[heap removeLastObject];
+			
+			if ([heap count] > 1) {
+				[self siftDownMergeHeap:heap fromIndex:0 withSorting:sorting];
+			}
+		}
+	}
+}
+
+/**
+ * Loads the row at cursor->index (reading the next batch of rowids from the group if needed),
+ * along with whatever is needed to compare it.
+ *
+ * Returns NO if the group is exhausted.
+**/
+- (BOOL)loadMergeCursor:(YapDatabaseAutoViewMergeCursor *)cursor withSorting:(YapDatabaseViewSorting *)sorting
+{
+	cursor->collectionKey = nil;
+	cursor->object = nil;
+	cursor->metadata = nil;
+	cursor->sortKey = nil;
+	
+	if (cursor->index >= cursor->count) return NO;
+	
+	if ((cursor->index < cursor->batchIndex) || (cursor->index >= (cursor->batchIndex + cursor->batchCount)))
+	{
+		NSUInteger length = MIN((NSUInteger)YapDatabaseAutoViewMergeBatchSize, (cursor->count - cursor->index));
+		
+		cursor->batchIndex = cursor->index;
+		cursor->batchCount = 0;
+		
+		[self enumerateRowidsInGroup:cursor->group
+		                 withOptions:0
+		                       range:NSMakeRange(cursor->index, length)
+		                  usingBlock:^(int64_t rowid, NSUInteger __unused index, BOOL __unused *stop)
+		{
+			cursor->rowids[cursor->batchCount] = rowid;
+			cursor->batchCount++;
+		}];
+		
+		if (cursor->batchCount == 0) return NO;
+	}
+	
+	int64_t rowid = cursor->rowids[cursor->index - cursor->batchIndex];
+	cursor->rowid = rowid;
+	
+	YapCollectionKey *collectionKey = nil;
+	id object = nil;
+	id metadata = nil;
+	
+	if (sorting->blockType == YapDatabaseBlockTypeWithKey)
+	{
+		collectionKey = [databaseTransaction collectionKeyForRowid:rowid];
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithObject)
+	{
+		[databaseTransaction getCollectionKey:&collectionKey object:&object forRowid:rowid];
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		[databaseTransaction getCollectionKey:&collectionKey metadata:&metadata forRowid:rowid];
+	}
+	else
+	{
+		[databaseTransaction getCollectionKey:&collectionKey object:&object metadata:&metadata forRowid:rowid];
+	}
+	
+	cursor->collectionKey = collectionKey;
+	
+	if (sorting->sortKeyBlock)
+	{
+		// Only the sort key is needed to compare the row.
+		cursor->sortKey = [self sortKeyForCollectionKey:collectionKey
+		                                         object:object
+		                                       metadata:metadata
+		                                        inGroup:cursor->group];
+	}
+	else
+	{
+		cursor->object = object;
+		cursor->metadata = metadata;
+	}
+	
+	return YES;
+}
+
+/**
+ * Compares the current rows of the given cursors.
+ * Equal rows are ordered by the position of their group (so the merge is stable).
+**/
+- (NSComparisonResult)compareMergeCursor:(YapDatabaseAutoViewMergeCursor *)cursor1
+                              withCursor:(YapDatabaseAutoViewMergeCursor *)cursor2
+                                 sorting:(YapDatabaseViewSorting *)sorting
+{
+	NSComparisonResult cmp;
+	
+	__unsafe_unretained YapCollectionKey *ck1 = cursor1->collectionKey;
+	__unsafe_unretained YapCollectionKey *ck2 = cursor2->collectionKey;
+	
+	if (sorting->sortKeyBlock)
+	{
+		cmp = YapDatabaseViewCompareSortKeys(cursor1->sortKey, cursor2->sortKey);
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithKey)
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithKeyBlock sortingBlock =
+		    (YapDatabaseViewSortingWithKeyBlock)sorting->block;
+		
+		cmp = sortingBlock(databaseTransaction, cursor1->group,
+		                   ck1.collection, ck1.key,
+		                   ck2.collection, ck2.key);
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithObject)
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithObjectBlock sortingBlock =
+		    (YapDatabaseViewSortingWithObjectBlock)sorting->block;
+		
+		cmp = sortingBlock(databaseTransaction, cursor1->group,
+		                   ck1.collection, ck1.key, cursor1->object,
+		                   ck2.collection, ck2.key, cursor2->object);
+	}
+	else if (sorting->blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithMetadataBlock sortingBlock =
+		    (YapDatabaseViewSortingWithMetadataBlock)sorting->block;
+		
+		cmp = sortingBlock(databaseTransaction, cursor1->group,
+		                   ck1.collection, ck1.key, cursor1->metadata,
+		                   ck2.collection, ck2.key, cursor2->metadata);
+	}
+	else
+	{
+		__unsafe_unretained YapDatabaseViewSortingWithRowBlock sortingBlock =
+		    (YapDatabaseViewSortingWithRowBlock)sorting->block;
+		
+		cmp = sortingBlock(databaseTransaction, cursor1->group,
+		                   ck1.collection, ck1.key, cursor1->object, cursor1->metadata,
+		                   ck2.collection, ck2.key, cursor2->object, cursor2->metadata);
+	}
+	
+	if (cmp == NSOrderedSame)
+	{
+		if (cursor1->order < cursor2->order)
+			cmp = NSOrderedAscending;
+		else if (cursor1->order > cursor2->order)
+			cmp = NSOrderedDescending;
+	}
+	
+	return cmp;
+}
+
+/**
+ * Standard binary (min) heap sift-down.
+**/
+- (void)siftDownMergeHeap:(NSMutableArray<YapDatabaseAutoViewMergeCursor *> *)heap
+                fromIndex:(NSUInteger)index
+              withSorting:(YapDatabaseViewSorting *)sorting
+{
+	NSUInteger count = [heap count];
+	
+	while (YES)
+	{
+		NSUInteger left = (2 * index) + 1;
+		NSUInteger right = left + 1;
+		NSUInteger smallest = index;
+		
+		if (left < count &&
+		    [self compareMergeCursor:heap[left] withCursor:heap[smallest] sorting:sorting] == NSOrderedAscending)
+		{
+			smallest = left;
+		}
+		
+		if (right < count &&
+		    [self compareMergeCursor:heap[right] withCursor:heap[smallest] sorting:sorting] == NSOrderedAscending)
+		{
+			smallest = right;
+		}
+		
+		if (smallest == index) break;
+		
+		[heap exchangeObjectAtIndex:index withObjectAtIndex:smallest];
+		index = smallest;
+	}
+}
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1523,6 +2303,49 @@
 	NSAssert(grouping != nil, @"Invalid parameter: grouping == nil");
 	NSAssert(sorting != nil, @"Invalid parameter: sorting == nil");
 	
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	YapDatabaseViewGrouping *currentGrouping = nil;
+	[viewConnection getGrouping:&currentGrouping sorting:NULL];
+	
+	if (grouping == currentGrouping)
+	{
+		// Only the sorting is changing
+		
+		[self setSorting:sorting versionTag:inVersionTag];
+		return;
+	}
+	
+	[self setGrouping:grouping sorting:sorting versionTag:inVersionTag resortOnly:NO];
+}
+
+/**
+ * This method allows you to change only the sorting on-the-fly.
+ * Every row stays in its group, and every group is re-sorted in place.
+ *
+ * Note: You must pass a different versionTag, or this method does nothing.
+**/
+- (void)setSorting:(YapDatabaseViewSorting *)sorting versionTag:(NSString *)inVersionTag
+{
+	YDBLogAutoTrace();
+	
+	NSAssert(sorting != nil, @"Invalid parameter: sorting == nil");
+	
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	YapDatabaseViewGrouping *currentGrouping = nil;
+	[viewConnection getGrouping:&currentGrouping sorting:NULL];
+	
+	[self setGrouping:currentGrouping sorting:sorting versionTag:inVersionTag resortOnly:YES];
+}
+
+- (void)setGrouping:(YapDatabaseViewGrouping *)grouping
+            sorting:(YapDatabaseViewSorting *)sorting
+         versionTag:(NSString *)inVersionTag
+         resortOnly:(BOOL)resortOnly
+{
 	if (!databaseTransaction->isReadWriteTransaction)
 	{
 		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
@@ -1544,7 +2367,10 @@
 	                    sorting:sorting
 	                 versionTag:newVersionTag];
 	
-	[self repopulateView];
+	if (resortOnly)
+		[self resortView];
+	else
+		[self repopulateView];
 	
 	[self setStringValue:newVersionTag
 	     forExtensionKey:ext_key_versionTag
@@ -1568,7 +2394,8 @@
 			
 			if ([extTransaction respondsToSelector:@selector(view:didRepopulateWithFlags:)])
 			{
-				int flags = YDB_GroupingMayHaveChanged | YDB_SortingMayHaveChanged;
+				int flags = resortOnly ? YDB_SortingMayHaveChanged
+				                       : (YDB_GroupingMayHaveChanged | YDB_SortingMayHaveChanged);
 				[(id <YapDatabaseViewDependency>)extTransaction view:registeredName didRepopulateWithFlags:flags];
 			}
 		}
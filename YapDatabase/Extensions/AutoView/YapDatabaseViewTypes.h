@@ -5,6 +5,43 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * The part of a row that a declarative grouping or sorting reads its value from.
+ * See YapDatabaseViewSortDescriptor.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseViewKeyPathSource) {
+	YapDatabaseViewKeyPathSourceCollection = 0,
+	YapDatabaseViewKeyPathSourceKey        = 1,
+	YapDatabaseViewKeyPathSourceObject     = 2,
+	YapDatabaseViewKeyPathSourceMetadata   = 3,
+};
+
+/**
+ * Describes a single sort criteria for a declarative sorting: +[YapDatabaseViewSorting withSortDescriptors:].
+ *
+ * The value is read from the given source (collection, key, object or metadata),
+ * and, if a keyPath is given, via -valueForKeyPath: (so dictionaries are supported too).
+ *
+ * The values are extracted once per row (into native columns), and compared without invoking any blocks:
+ * - NSNumber & NSDate values are compared as numbers (dates by timeIntervalSinceReferenceDate)
+ * - NSString values are compared literally (just like -[NSString compare:])
+ * - nil & NSNull values are ordered before any other value
+ * - any other values are compared using compare:
+**/
+@interface YapDatabaseViewSortDescriptor : NSObject
+
++ (instancetype)sortDescriptorWithSource:(YapDatabaseViewKeyPathSource)source
+                                 keyPath:(nullable NSString *)keyPath
+                               ascending:(BOOL)ascending;
+
+@property (nonatomic, assign, readonly) YapDatabaseViewKeyPathSource source;
+@property (nonatomic, copy,   readonly, nullable) NSString *keyPath;
+@property (nonatomic, assign, readonly) BOOL ascending;
+
+@end
+
+#pragma mark -
+
 /**
  * The grouping block handles both filtering and grouping.
  * 
@@ -56,6 +93,16 @@ typedef NSString* _Nullable (^YapDatabaseViewGroupingWithRowBlock)
 + (instancetype)withOptions:(YapDatabaseBlockInvoke)iops metadataBlock:(YapDatabaseViewGroupingWithMetadataBlock)block;
 + (instancetype)withOptions:(YapDatabaseBlockInvoke)iops rowBlock:(YapDatabaseViewGroupingWithRowBlock)block;
 
+/**
+ * A declarative grouping: the group is the value read from the given source & keyPath.
+ * (An NSString value is used as is, any other value is converted via -description.)
+ * A nil or NSNull value excludes the row from the view.
+**/
++ (instancetype)withSource:(YapDatabaseViewKeyPathSource)source keyPath:(nullable NSString *)keyPath;
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops
+                     source:(YapDatabaseViewKeyPathSource)source
+                    keyPath:(nullable NSString *)keyPath;
+
 @property (nonatomic, copy,   readonly) YapDatabaseViewGroupingBlock block;
 @property (nonatomic, assign, readonly) YapDatabaseBlockType         blockType;
 @property (nonatomic, assign, readonly) YapDatabaseBlockInvoke       blockInvokeOptions;
@@ -109,6 +156,15 @@ typedef NSString* _Nullable (^YapDatabaseViewGroupingWithRowBlock)
  * while adding them to the database. One direction will hit the optimization every time. The other will cause
  * the view to perform a binary search every time.
  * These little one-liner optimzations are easy (given this internal information is known).
+ * 
+ * Another tip: if sorting only depends on one or two properties of the object,
+ * consider using a 'WithKey' block, and fetching those properties via
+ * -[YapDatabaseReadTransaction valueForField:forKey:inCollection:].
+ * When objects are serialized with the YapDatabaseBinaryCodec, this reads the field straight from the stored bytes.
+ * So (re)populating a large view doesn't deserialize every object in it.
+ *
+ * And if rows are sorted by a single comparable value (such as a timestamp or a name),
+ * consider using a sort key block (see below), which allows the view to cache the sort keys.
 **/
 @interface YapDatabaseViewSorting : NSObject
 
@@ -144,10 +200,72 @@ typedef NSComparisonResult (^YapDatabaseViewSortingWithRowBlock)
 + (instancetype)withOptions:(YapDatabaseBlockInvoke)iops metadataBlock:(YapDatabaseViewSortingWithMetadataBlock)block;
 + (instancetype)withOptions:(YapDatabaseBlockInvoke)iops rowBlock:(YapDatabaseViewSortingWithRowBlock)block;
 
+/**
+ * A sort key block returns the sort key for a single row, and rows are sorted by comparing their sort keys:
+ * [sortKey1 compare:sortKey2]
+ *
+ * So a sort key must implement compare: (e.g. NSString, NSNumber, NSDate).
+ * A nil sort key is ordered before any other sort key.
+ *
+ * The sorting is the same as that of the corresponding sorting block,
+ * but the view only computes the sort key of a row once per readWrite transaction.
+ * So the binary search that inserts a row compares (cached) sort keys,
+ * rather than fetching (and possibly deserializing) the neighbouring rows again & again.
+ * And populating the view computes each sort key exactly once.
+ *
+ * The block property is a sorting block (of the same blockType) that compares sort keys,
+ * so the sorting can be used anywhere a sorting block is expected.
+**/
+
+typedef id YapDatabaseViewSortKeyBlock; // One of the YapDatabaseViewSortKeyX types below.
+
+typedef _Nullable id (^YapDatabaseViewSortKeyWithKeyBlock)
+                 (YapDatabaseReadTransaction *transaction, NSString *group,
+                      NSString *collection, NSString *key);
+
+typedef _Nullable id (^YapDatabaseViewSortKeyWithObjectBlock)
+                 (YapDatabaseReadTransaction *transaction, NSString *group,
+                      NSString *collection, NSString *key, id object);
+
+typedef _Nullable id (^YapDatabaseViewSortKeyWithMetadataBlock)
+                 (YapDatabaseReadTransaction *transaction, NSString *group,
+                      NSString *collection, NSString *key, _Nullable id metadata);
+
+typedef _Nullable id (^YapDatabaseViewSortKeyWithRowBlock)
+                 (YapDatabaseReadTransaction *transaction, NSString *group,
+                      NSString *collection, NSString *key, id object, _Nullable id metadata);
+
++ (instancetype)withSortKeyKeyBlock:(YapDatabaseViewSortKeyWithKeyBlock)block;
++ (instancetype)withSortKeyObjectBlock:(YapDatabaseViewSortKeyWithObjectBlock)block;
++ (instancetype)withSortKeyMetadataBlock:(YapDatabaseViewSortKeyWithMetadataBlock)block;
++ (instancetype)withSortKeyRowBlock:(YapDatabaseViewSortKeyWithRowBlock)block;
+
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyKeyBlock:(YapDatabaseViewSortKeyWithKeyBlock)block;
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyObjectBlock:(YapDatabaseViewSortKeyWithObjectBlock)block;
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyMetadataBlock:(YapDatabaseViewSortKeyWithMetadataBlock)block;
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyRowBlock:(YapDatabaseViewSortKeyWithRowBlock)block;
+
+/**
+ * A declarative sorting: rows are sorted by the first sort descriptor, then by the second, and so on.
+ * For example, "by metadata.date (descending), then by key".
+ *
+ * This is compiled into a sort key block (of the minimum blockType required by the descriptors),
+ * whose sort keys hold the extracted values in native columns.
+ * So comparing two rows doesn't invoke any blocks (or -valueForKeyPath:).
+**/
++ (instancetype)withSortDescriptors:(NSArray<YapDatabaseViewSortDescriptor *> *)sortDescriptors;
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops
+            sortDescriptors:(NSArray<YapDatabaseViewSortDescriptor *> *)sortDescriptors;
+
 @property (nonatomic, copy,   readonly) YapDatabaseViewSortingBlock block;
 @property (nonatomic, assign, readonly) YapDatabaseBlockType        blockType;
 @property (nonatomic, assign, readonly) YapDatabaseBlockInvoke      blockInvokeOptions;
 
+/**
+ * Non-nil if the sorting was created with a sort key block (of the same blockType).
+**/
+@property (nonatomic, copy, readonly, nullable) YapDatabaseViewSortKeyBlock sortKeyBlock;
+
 @end
 
 #pragma mark -
@@ -1,5 +1,233 @@
 #import "YapDatabaseViewTypes.h"
 #import "YapDatabaseViewPrivate.h"
+#import "YapDatabaseAutoViewPrivate.h"
+
+static YapDatabaseBlockInvoke YapDatabaseBlockInvokeDefaultForBlockType(YapDatabaseBlockType blockType)
+{
+	switch (blockType)
+	{
+		case YapDatabaseBlockTypeWithKey      : return YapDatabaseBlockInvokeDefaultForBlockTypeWithKey;
+		case YapDatabaseBlockTypeWithObject   : return YapDatabaseBlockInvokeDefaultForBlockTypeWithObject;
+		case YapDatabaseBlockTypeWithMetadata : return YapDatabaseBlockInvokeDefaultForBlockTypeWithMetadata;
+		default                               : return YapDatabaseBlockInvokeDefaultForBlockTypeWithRow;
+	}
+}
+
+static YapDatabaseBlockType YapDatabaseBlockTypeForSource(YapDatabaseViewKeyPathSource source)
+{
+	switch (source)
+	{
+		case YapDatabaseViewKeyPathSourceObject   : return YapDatabaseBlockTypeWithObject;
+		case YapDatabaseViewKeyPathSourceMetadata : return YapDatabaseBlockTypeWithMetadata;
+		default                                   : return YapDatabaseBlockTypeWithKey;
+	}
+}
+
+static id YapDatabaseViewValueForSource(YapDatabaseViewKeyPathSource source, NSString *keyPath,
+                                        NSString *collection, NSString *key, id object, id metadata)
+{
+	id value = nil;
+	switch (source)
+	{
+		case YapDatabaseViewKeyPathSourceCollection : value = collection; break;
+		case YapDatabaseViewKeyPathSourceKey        : value = key;        break;
+		case YapDatabaseViewKeyPathSourceObject     : value = object;     break;
+		case YapDatabaseViewKeyPathSourceMetadata   : value = metadata;   break;
+	}
+	
+	if (keyPath && value && (value != [NSNull null]))
+		value = [value valueForKeyPath:keyPath];
+	
+	return (value == [NSNull null]) ? nil : value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseViewSortDescriptor
+
+@synthesize source = source;
+@synthesize keyPath = keyPath;
+@synthesize ascending = ascending;
+
++ (instancetype)sortDescriptorWithSource:(YapDatabaseViewKeyPathSource)source
+                                 keyPath:(NSString *)keyPath
+                               ascending:(BOOL)ascending
+{
+	YapDatabaseViewSortDescriptor *sortDescriptor = [[YapDatabaseViewSortDescriptor alloc] init];
+	sortDescriptor->source = source;
+	sortDescriptor->keyPath = [keyPath copy];
+	sortDescriptor->ascending = ascending;
+	
+	return sortDescriptor;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YapDatabaseViewSortDescriptor: source(%ld) keyPath(%@) ascending(%@)>",
+	          (long)source, keyPath, (ascending ? @"YES" : @"NO")];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef NS_ENUM(uint8_t, YapDatabaseViewSortColumnType) {
+	YapDatabaseViewSortColumnTypeNull = 0,
+	YapDatabaseViewSortColumnTypeInteger,
+	YapDatabaseViewSortColumnTypeDouble,
+	YapDatabaseViewSortColumnTypeString,
+	YapDatabaseViewSortColumnTypeOther,
+};
+
+typedef struct {
+	YapDatabaseViewSortColumnType type;
+	BOOL descending;
+	int64_t integerValue;
+	double doubleValue;
+	__unsafe_unretained id objectValue; // retained by YapDatabaseViewSortColumns->objects
+} YapDatabaseViewSortColumn;
+
+/**
+ * The sort key produced by a sorting compiled from sort descriptors.
+ * The values are extracted once (when the sort key is created), so compare: is a loop over native columns.
+**/
+@interface YapDatabaseViewSortColumns : NSObject {
+@public
+	
+	YapDatabaseViewSortColumn *columns;
+	NSUInteger count;
+	
+	NSMutableArray *objects;
+}
+
+- (NSComparisonResult)compare:(YapDatabaseViewSortColumns *)another;
+
+@end
+
+@implementation YapDatabaseViewSortColumns
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+	if ((self = [super init]))
+	{
+		columns = (YapDatabaseViewSortColumn *)calloc(MAX(capacity, 1), sizeof(YapDatabaseViewSortColumn));
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	free(columns);
+}
+
+- (void)addValue:(id)value descending:(BOOL)descending
+{
+	YapDatabaseViewSortColumn *column = &columns[count++];
+	column->descending = descending;
+	
+	if (value == nil)
+	{
+		column->type = YapDatabaseViewSortColumnTypeNull;
+	}
+	else if ([value isKindOfClass:[NSNumber class]])
+	{
+		if (CFNumberIsFloatType((__bridge CFNumberRef)value))
+		{
+			column->type = YapDatabaseViewSortColumnTypeDouble;
+			column->doubleValue = [(NSNumber *)value doubleValue];
+		}
+		else
+		{
+			column->type = YapDatabaseViewSortColumnTypeInteger;
+			column->integerValue = [(NSNumber *)value longLongValue];
+			column->doubleValue = (double)column->integerValue;
+		}
+	}
+	else if ([value isKindOfClass:[NSDate class]])
+	{
+		column->type = YapDatabaseViewSortColumnTypeDouble;
+		column->doubleValue = [(NSDate *)value timeIntervalSinceReferenceDate];
+	}
+	else
+	{
+		if ([value isKindOfClass:[NSString class]])
+			column->type = YapDatabaseViewSortColumnTypeString;
+		else
+			column->type = YapDatabaseViewSortColumnTypeOther;
+		
+		if (objects == nil)
+			objects = [[NSMutableArray alloc] initWithCapacity:1];
+		
+		[objects addObject:value];
+		column->objectValue = value;
+	}
+}
+
+static inline BOOL YapDatabaseViewSortColumnIsNumeric(const YapDatabaseViewSortColumn *column)
+{
+	return (column->type == YapDatabaseViewSortColumnTypeInteger) ||
+	       (column->type == YapDatabaseViewSortColumnTypeDouble);
+}
+
+static NSComparisonResult YapDatabaseViewCompareSortColumns(const YapDatabaseViewSortColumn *column1,
+                                                            const YapDatabaseViewSortColumn *column2)
+{
+	if (column1->type == YapDatabaseViewSortColumnTypeInteger && column2->type == YapDatabaseViewSortColumnTypeInteger)
+	{
+		if (column1->integerValue < column2->integerValue) return NSOrderedAscending;
+		if (column1->integerValue > column2->integerValue) return NSOrderedDescending;
+		return NSOrderedSame;
+	}
+	
+	if (YapDatabaseViewSortColumnIsNumeric(column1) && YapDatabaseViewSortColumnIsNumeric(column2))
+	{
+		if (column1->doubleValue < column2->doubleValue) return NSOrderedAscending;
+		if (column1->doubleValue > column2->doubleValue) return NSOrderedDescending;
+		return NSOrderedSame;
+	}
+	
+	if (column1->type == YapDatabaseViewSortColumnTypeString && column2->type == YapDatabaseViewSortColumnTypeString)
+	{
+		return (NSComparisonResult)CFStringCompare((__bridge CFStringRef)column1->objectValue,
+		                                           (__bridge CFStringRef)column2->objectValue, 0);
+	}
+	
+	if (column1->type == YapDatabaseViewSortColumnTypeOther && column2->type == YapDatabaseViewSortColumnTypeOther)
+	{
+		return [column1->objectValue compare:column2->objectValue];
+	}
+	
+	// Different types (including null): order by type
+	
+	if (column1->type < column2->type) return NSOrderedAscending;
+	if (column1->type > column2->type) return NSOrderedDescending;
+	return NSOrderedSame;
+}
+
+- (NSComparisonResult)compare:(YapDatabaseViewSortColumns *)another
+{
+	NSUInteger commonCount = MIN(count, another->count);
+	
+	for (NSUInteger i = 0; i < commonCount; i++)
+	{
+		NSComparisonResult cmp = YapDatabaseViewCompareSortColumns(&columns[i], &another->columns[i]);
+		if (cmp != NSOrderedSame)
+		{
+			if (columns[i].descending)
+				return (cmp == NSOrderedAscending) ? NSOrderedDescending : NSOrderedAscending;
+			else
+				return cmp;
+		}
+	}
+	
+	return NSOrderedSame;
+}
+
+@end
 
 
 /**
@@ -93,6 +321,55 @@
 	return grouping;
 }
 
++ (instancetype)withSource:(YapDatabaseViewKeyPathSource)source keyPath:(NSString *)keyPath
+{
+	YapDatabaseBlockInvoke iops = YapDatabaseBlockInvokeDefaultForBlockType(YapDatabaseBlockTypeForSource(source));
+	return [self withOptions:iops source:source keyPath:keyPath];
+}
+
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops
+                     source:(YapDatabaseViewKeyPathSource)source
+                    keyPath:(NSString *)inKeyPath
+{
+	NSString *keyPath = [inKeyPath copy];
+	
+	NSString* (^groupForValue)(id) = ^NSString *(id value){
+		
+		if (value == nil) return nil;
+		if ([value isKindOfClass:[NSString class]]) return [(NSString *)value copy]; // mutable string protection
+		
+		return [value description];
+	};
+	
+	switch (YapDatabaseBlockTypeForSource(source))
+	{
+		case YapDatabaseBlockTypeWithObject :
+		{
+			return [self withOptions:iops objectBlock:
+			    ^NSString *(YapDatabaseReadTransaction __unused *transaction, NSString *collection, NSString *key, id object)
+			{
+				return groupForValue(YapDatabaseViewValueForSource(source, keyPath, collection, key, object, nil));
+			}];
+		}
+		case YapDatabaseBlockTypeWithMetadata :
+		{
+			return [self withOptions:iops metadataBlock:
+			    ^NSString *(YapDatabaseReadTransaction __unused *transaction, NSString *collection, NSString *key, id metadata)
+			{
+				return groupForValue(YapDatabaseViewValueForSource(source, keyPath, collection, key, nil, metadata));
+			}];
+		}
+		default :
+		{
+			return [self withOptions:iops keyBlock:
+			    ^NSString *(YapDatabaseReadTransaction __unused *transaction, NSString *collection, NSString *key)
+			{
+				return groupForValue(YapDatabaseViewValueForSource(source, keyPath, collection, key, nil, nil));
+			}];
+		}
+	}
+}
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -150,6 +427,7 @@
 @synthesize block = block;
 @synthesize blockType = blockType;
 @synthesize blockInvokeOptions = blockInvokeOptions;
+@synthesize sortKeyBlock = sortKeyBlock;
 
 + (instancetype)withKeyBlock:(YapDatabaseViewSortingWithKeyBlock)block
 {
@@ -223,6 +501,186 @@
 	return sorting;
 }
 
++ (instancetype)withSortKeyKeyBlock:(YapDatabaseViewSortKeyWithKeyBlock)block
+{
+	YapDatabaseBlockInvoke iops = YapDatabaseBlockInvokeDefaultForBlockTypeWithKey;
+	return [self withOptions:iops sortKeyKeyBlock:block];
+}
+
++ (instancetype)withSortKeyObjectBlock:(YapDatabaseViewSortKeyWithObjectBlock)block
+{
+	YapDatabaseBlockInvoke iops = YapDatabaseBlockInvokeDefaultForBlockTypeWithObject;
+	return [self withOptions:iops sortKeyObjectBlock:block];
+}
+
++ (instancetype)withSortKeyMetadataBlock:(YapDatabaseViewSortKeyWithMetadataBlock)block
+{
+	YapDatabaseBlockInvoke iops = YapDatabaseBlockInvokeDefaultForBlockTypeWithMetadata;
+	return [self withOptions:iops sortKeyMetadataBlock:block];
+}
+
++ (instancetype)withSortKeyRowBlock:(YapDatabaseViewSortKeyWithRowBlock)block
+{
+	YapDatabaseBlockInvoke iops = YapDatabaseBlockInvokeDefaultForBlockTypeWithRow;
+	return [self withOptions:iops sortKeyRowBlock:block];
+}
+
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyKeyBlock:(YapDatabaseViewSortKeyWithKeyBlock)block
+{
+	if (block == NULL) return nil;
+	
+	YapDatabaseViewSortKeyWithKeyBlock sortKeyBlock = [block copy];
+	
+	YapDatabaseViewSorting *sorting = [self withOptions:iops keyBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, NSString *collection2, NSString *key2)
+	{
+		return YapDatabaseViewCompareSortKeys(sortKeyBlock(transaction, group, collection1, key1),
+		                                      sortKeyBlock(transaction, group, collection2, key2));
+	}];
+	sorting->sortKeyBlock = sortKeyBlock;
+	
+	return sorting;
+}
+
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyObjectBlock:(YapDatabaseViewSortKeyWithObjectBlock)block
+{
+	if (block == NULL) return nil;
+	
+	YapDatabaseViewSortKeyWithObjectBlock sortKeyBlock = [block copy];
+	
+	YapDatabaseViewSorting *sorting = [self withOptions:iops objectBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id object1, NSString *collection2, NSString *key2, id object2)
+	{
+		return YapDatabaseViewCompareSortKeys(sortKeyBlock(transaction, group, collection1, key1, object1),
+		                                      sortKeyBlock(transaction, group, collection2, key2, object2));
+	}];
+	sorting->sortKeyBlock = sortKeyBlock;
+	
+	return sorting;
+}
+
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyMetadataBlock:(YapDatabaseViewSortKeyWithMetadataBlock)block
+{
+	if (block == NULL) return nil;
+	
+	YapDatabaseViewSortKeyWithMetadataBlock sortKeyBlock = [block copy];
+	
+	YapDatabaseViewSorting *sorting = [self withOptions:iops metadataBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id metadata1, NSString *collection2, NSString *key2, id metadata2)
+	{
+		return YapDatabaseViewCompareSortKeys(sortKeyBlock(transaction, group, collection1, key1, metadata1),
+		                                      sortKeyBlock(transaction, group, collection2, key2, metadata2));
+	}];
+	sorting->sortKeyBlock = sortKeyBlock;
+	
+	return sorting;
+}
+
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops sortKeyRowBlock:(YapDatabaseViewSortKeyWithRowBlock)block
+{
+	if (block == NULL) return nil;
+	
+	YapDatabaseViewSortKeyWithRowBlock sortKeyBlock = [block copy];
+	
+	YapDatabaseViewSorting *sorting = [self withOptions:iops rowBlock:
+	    ^(YapDatabaseReadTransaction *transaction, NSString *group,
+	      NSString *collection1, NSString *key1, id object1, id metadata1,
+	      NSString *collection2, NSString *key2, id object2, id metadata2)
+	{
+		return YapDatabaseViewCompareSortKeys(sortKeyBlock(transaction, group, collection1, key1, object1, metadata1),
+		                                      sortKeyBlock(transaction, group, collection2, key2, object2, metadata2));
+	}];
+	sorting->sortKeyBlock = sortKeyBlock;
+	
+	return sorting;
+}
+
++ (instancetype)withSortDescriptors:(NSArray<YapDatabaseViewSortDescriptor *> *)sortDescriptors
+{
+	YapDatabaseBlockType blockType = YapDatabaseBlockTypeWithKey;
+	for (YapDatabaseViewSortDescriptor *sortDescriptor in sortDescriptors)
+	{
+		blockType |= YapDatabaseBlockTypeForSource(sortDescriptor.source);
+	}
+	
+	YapDatabaseBlockInvoke iops = YapDatabaseBlockInvokeDefaultForBlockType(blockType);
+	return [self withOptions:iops sortDescriptors:sortDescriptors];
+}
+
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)iops
+            sortDescriptors:(NSArray<YapDatabaseViewSortDescriptor *> *)inSortDescriptors
+{
+	if ([inSortDescriptors count] == 0) return nil;
+	
+	NSArray<YapDatabaseViewSortDescriptor *> *sortDescriptors = [inSortDescriptors copy];
+	NSUInteger count = [sortDescriptors count];
+	
+	YapDatabaseBlockType blockType = YapDatabaseBlockTypeWithKey;
+	for (YapDatabaseViewSortDescriptor *sortDescriptor in sortDescriptors)
+	{
+		blockType |= YapDatabaseBlockTypeForSource(sortDescriptor.source);
+	}
+	
+	YapDatabaseViewSortColumns* (^sortKey)(NSString*, NSString*, id, id) =
+	^YapDatabaseViewSortColumns *(NSString *collection, NSString *key, id object, id metadata){
+		
+		YapDatabaseViewSortColumns *columns = [[YapDatabaseViewSortColumns alloc] initWithCapacity:count];
+		
+		for (YapDatabaseViewSortDescriptor *sortDescriptor in sortDescriptors)
+		{
+			id value = YapDatabaseViewValueForSource(sortDescriptor.source, sortDescriptor.keyPath,
+			                                         collection, key, object, metadata);
+			
+			[columns addValue:value descending:!sortDescriptor.ascending];
+		}
+		
+		return columns;
+	};
+	
+	switch (blockType)
+	{
+		case YapDatabaseBlockTypeWithKey :
+		{
+			return [self withOptions:iops sortKeyKeyBlock:
+			    ^id (YapDatabaseReadTransaction __unused *transaction, NSString __unused *group,
+			         NSString *collection, NSString *key)
+			{
+				return sortKey(collection, key, nil, nil);
+			}];
+		}
+		case YapDatabaseBlockTypeWithObject :
+		{
+			return [self withOptions:iops sortKeyObjectBlock:
+			    ^id (YapDatabaseReadTransaction __unused *transaction, NSString __unused *group,
+			         NSString *collection, NSString *key, id object)
+			{
+				return sortKey(collection, key, object, nil);
+			}];
+		}
+		case YapDatabaseBlockTypeWithMetadata :
+		{
+			return [self withOptions:iops sortKeyMetadataBlock:
+			    ^id (YapDatabaseReadTransaction __unused *transaction, NSString __unused *group,
+			         NSString *collection, NSString *key, id metadata)
+			{
+				return sortKey(collection, key, nil, metadata);
+			}];
+		}
+		default :
+		{
+			return [self withOptions:iops sortKeyRowBlock:
+			    ^id (YapDatabaseReadTransaction __unused *transaction, NSString __unused *group,
+			         NSString *collection, NSString *key, id object, id metadata)
+			{
+				return sortKey(collection, key, object, metadata);
+			}];
+		}
+	}
+}
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -22,6 +22,12 @@
 **/
 @property (nonatomic, assign, readwrite) int64_t rowid;
 
+/**
+ * The concurrency calculated by the adaptive concurrency controller.
+ * Zero until the controller has been used.
+**/
+@property (atomic, assign, readwrite) NSUInteger adaptiveConcurrentOperationCount;
+
 - (BOOL)setOwner:(YapDatabaseCloudCore *)owner;
 
 - (NSArray<NSArray<YapDatabaseCloudCoreOperation *> *> *)graphOperations;
@@ -57,11 +63,30 @@
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+@interface YDBCloudCoreConcurrencySample ()
+
+- (instancetype)initWithConcurrentOperationCount:(NSUInteger)concurrentOperationCount
+                                  averageLatency:(NSTimeInterval)averageLatency
+                                     failureRate:(double)failureRate;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @interface YapDatabaseCloudCoreGraph ()
 
 - (instancetype)initWithPersistentOrder:(uint64_t)peristentOrder
                              operations:(NSArray<YapDatabaseCloudCoreOperation *> *)operations;
 
+/**
+ * Used when restoring the operations from the database.
+ * The loader is invoked (once) the first time the operations of the graph are needed.
+**/
+- (instancetype)initWithPersistentOrder:(uint64_t)peristentOrder
+                       operationsLoader:(NSArray<YapDatabaseCloudCoreOperation *> * (^)(void))operationsLoader;
+
 @property (nonatomic, assign, readonly) uint64_t persistentOrder;
 @property (nonatomic, copy, readonly) NSArray<YapDatabaseCloudCoreOperation *> *operations;
 
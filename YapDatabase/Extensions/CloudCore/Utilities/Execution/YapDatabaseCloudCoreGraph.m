@@ -6,11 +6,49 @@
 #import "YapDatabaseCloudCorePrivate.h"
 #import "YapDatabaseCloudCoreOperationPrivate.h"
 
+/**
+ * Scheduling information for an operation within the graph.
+**/
+@interface YDBCloudCoreGraphNode : NSObject {
+@public
+	
+	YapDatabaseCloudCoreOperation *operation;
+	
+	int32_t effectivePriority;  // max(operation.priority, effectivePriority of the operations depending on it)
+	NSUInteger order;           // index within the (priority sorted) operations array, used for tie-breaking
+	
+	NSUInteger remainingDependencyCount; // number of dependencies (within the graph) that aren't completed/skipped
+	NSMutableArray<YDBCloudCoreGraphNode *> *dependents;
+	
+	BOOL isPriorityCalculated;
+	BOOL isRemoved;
+}
+@end
+
+@implementation YDBCloudCoreGraphNode
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 @implementation YapDatabaseCloudCoreGraph
+{
+	NSArray<YapDatabaseCloudCoreOperation *> *operations;
+	NSMutableDictionary<NSUUID *, YapDatabaseCloudCoreOperation *> *operationsByUUID;
+	
+	NSArray<YapDatabaseCloudCoreOperation *> * (^operationsLoader)(void); // non-nil until the operations are loaded
+	
+	// The ready-set.
+	// Built lazily (by the dequeue logic), as the pipeline needs to be set in order to check the status of operations.
+	
+	BOOL needsRebuildReadySet;
+	NSMutableDictionary<NSUUID *, YDBCloudCoreGraphNode *> *nodes;
+	NSMutableArray<YDBCloudCoreGraphNode *> *readyHeap;    // binary heap: operations without remaining dependencies
+	NSMutableArray<YDBCloudCoreGraphNode *> *dequeuedNodes; // operations that were started, or are on hold
+}
 
 @synthesize persistentOrder = persistentOrder;
-@synthesize operations = operations;
 @synthesize pipeline = pipeline;
 
 - (instancetype)initWithPersistentOrder:(uint64_t)inPersistentOrder
@@ -21,7 +59,8 @@
 		persistentOrder = inPersistentOrder;
 		
 		operations = [[self class] sortOperationsByPriority:inOperations];
-	
+		[self operationsDidChange];
+		
 		if ([self hasCircularDependency])
 		{
 			@throw [self circularDependencyException];
@@ -30,6 +69,44 @@
 	return self;
 }
 
+- (instancetype)initWithPersistentOrder:(uint64_t)inPersistentOrder
+                       operationsLoader:(NSArray<YapDatabaseCloudCoreOperation *> * (^)(void))inOperationsLoader
+{
+	if ((self = [super init]))
+	{
+		persistentOrder = inPersistentOrder;
+		operationsLoader = inOperationsLoader;
+	}
+	return self;
+}
+
+/**
+ * Restored graphs are loaded lazily.
+ * The pipeline only needs the operations of a graph when it gets to it (or when the graph is enumerated / modified).
+ * So launching with a large queue doesn't require deserializing every operation up front.
+**/
+- (void)loadOperationsIfNeeded
+{
+	if (operationsLoader == nil) return;
+	
+	NSArray<YapDatabaseCloudCoreOperation *> *loadedOperations = operationsLoader();
+	operationsLoader = nil;
+	
+	operations = [[self class] sortOperationsByPriority:(loadedOperations ?: @[])];
+	[self operationsDidChange];
+	
+	if ([self hasCircularDependency])
+	{
+		@throw [self circularDependencyException];
+	}
+}
+
+- (NSArray<YapDatabaseCloudCoreOperation *> *)operations
+{
+	[self loadOperationsIfNeeded];
+	return operations;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -60,17 +137,24 @@
 	}];
 }
 
-- (YapDatabaseCloudCoreOperation *)operationWithUUID:(NSUUID *)opUUID
+- (void)operationsDidChange
 {
+	operationsByUUID = [[NSMutableDictionary alloc] initWithCapacity:operations.count];
+	
 	for (YapDatabaseCloudCoreOperation *op in operations)
 	{
-		if ([op.uuid isEqual:opUUID])
-		{
-			return op;
-		}
+		operationsByUUID[op.uuid] = op;
 	}
 	
-	return nil;
+	needsRebuildReadySet = YES;
+}
+
+- (YapDatabaseCloudCoreOperation *)operationWithUUID:(NSUUID *)opUUID
+{
+	if (opUUID == nil) return nil;
+	
+	[self loadOperationsIfNeeded];
+	return operationsByUUID[opUUID];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -99,6 +183,8 @@
         modifyOperations:(NSDictionary<NSUUID *, YapDatabaseCloudCoreOperation *> *)modifiedOperations
                 modified:(NSMutableArray<YapDatabaseCloudCoreOperation *> *)matchedModifiedOperations
 {
+	[self loadOperationsIfNeeded];
+	
 	__block NSMutableIndexSet *indexesToReplace = nil;
 	
 	[operations enumerateObjectsUsingBlock:^(YapDatabaseCloudCoreOperation *operation, NSUInteger index, BOOL *stop) {
@@ -133,6 +219,7 @@
 		}];
 		
 		operations = [[self class] sortOperationsByPriority:newOperations];
+		[self operationsDidChange];
 	}
 }
 
@@ -141,6 +228,8 @@
 **/
 - (NSArray *)removeCompletedAndSkippedOperations
 {
+	[self loadOperationsIfNeeded];
+	
 	NSMutableIndexSet *indexesToRemove = [NSMutableIndexSet indexSet];
 	NSMutableArray *operationsToRemove = [NSMutableArray arrayWithCapacity:1];
 	
@@ -165,6 +254,32 @@
 		[newOperations removeObjectsAtIndexes:indexesToRemove];
 		
 		operations = [newOperations copy];
+		
+		// Update the ready-set incrementally:
+		// The dependents of the removed operations may now be ready.
+		
+		for (YapDatabaseCloudCoreOperation *operation in operationsToRemove)
+		{
+			[operationsByUUID removeObjectForKey:operation.uuid];
+			
+			YDBCloudCoreGraphNode *node = nodes[operation.uuid];
+			if (node)
+			{
+				node->isRemoved = YES;
+				[nodes removeObjectForKey:operation.uuid];
+				
+				for (YDBCloudCoreGraphNode *dependent in node->dependents)
+				{
+					if (dependent->remainingDependencyCount > 0)
+					{
+						dependent->remainingDependencyCount--;
+						if (dependent->remainingDependencyCount == 0 && !dependent->isRemoved) {
+							[self pushReadyNode:dependent];
+						}
+					}
+				}
+			}
+		}
 	}
 	
 	return operationsToRemove;
@@ -175,108 +290,225 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * This method searches for the next operation that can immediately be started.
+ * Rebuilds the ready-set from scratch.
+ * This is done after the operations of the graph have changed (e.g. operations were inserted or modified).
  *
- * If found, sets the isStarted property to YES, and returns the next operation.
- * Otherwise returns nil.
+ * Every operation is assigned an effective priority, which is the max of its own priority,
+ * and the effective priority of all the operations that depend on it (directly or indirectly).
+ * This way a high priority operation pulls its dependencies forward.
 **/
-- (YapDatabaseCloudCoreOperation *)dequeueNextOperation
+- (void)rebuildReadySet
 {
-	YapDatabaseCloudCoreOperation *nextOpToStart = nil;
+	needsRebuildReadySet = NO;
+	
+	nodes = [[NSMutableDictionary alloc] initWithCapacity:operations.count];
+	readyHeap = [[NSMutableArray alloc] initWithCapacity:operations.count];
+	dequeuedNodes = [[NSMutableArray alloc] init];
+	
+	NSUInteger order = 0;
+	for (YapDatabaseCloudCoreOperation *op in operations)
+	{
+		YDBCloudCoreGraphNode *node = [[YDBCloudCoreGraphNode alloc] init];
+		node->operation = op;
+		node->order = order++;
+		node->dependents = [[NSMutableArray alloc] init];
+		
+		nodes[op.uuid] = node;
+	}
 	
 	for (YapDatabaseCloudCoreOperation *op in operations)
 	{
-		// Recursive depth-first search.
-		// If this op dependends on another, and that op isn't completed yet, then returns that op.
+		YDBCloudCoreGraphNode *node = nodes[op.uuid];
 		
-		YapDatabaseCloudCoreOperation *opOrDepOp = [self _dequeueNextOperation:op];
-		if (opOrDepOp)
+		for (NSUUID *depUUID in [op dependencyUUIDs])
 		{
-			YDBCloudCoreOperationStatus status = YDBCloudOperationStatus_Pending;
-			BOOL isOnHold = NO;
-			[pipeline getStatus:&status isOnHold:&isOnHold forOperationUUID:opOrDepOp.uuid];
-			
-			if ((status == YDBCloudOperationStatus_Pending) && !isOnHold)
+			YDBCloudCoreGraphNode *depNode = nodes[depUUID];
+			if (depNode)
 			{
-				nextOpToStart = opOrDepOp;
-				break;
+				[depNode->dependents addObject:node];
+				
+				YDBCloudCoreOperationStatus status = [pipeline statusForOperationWithUUID:depUUID];
+				if (status != YDBCloudOperationStatus_Completed &&
+				    status != YDBCloudOperationStatus_Skipped)
+				{
+					node->remainingDependencyCount++;
+				}
 			}
 		}
 	}
 	
-	return nextOpToStart;
+	for (YapDatabaseCloudCoreOperation *op in operations)
+	{
+		YDBCloudCoreGraphNode *node = nodes[op.uuid];
+		
+		[self calculateEffectivePriority:node];
+		
+		if (node->remainingDependencyCount == 0) {
+			[self pushReadyNode:node];
+		}
+	}
 }
 
 /**
- * Recursive helper method.
+ * Recursive helper method (memoized).
+**/
+- (int32_t)calculateEffectivePriority:(YDBCloudCoreGraphNode *)node
+{
+	if (!node->isPriorityCalculated)
+	{
+		int32_t priority = node->operation.priority;
+		
+		for (YDBCloudCoreGraphNode *dependent in node->dependents)
+		{
+			priority = MAX(priority, [self calculateEffectivePriority:dependent]);
+		}
+		
+		node->effectivePriority = priority;
+		node->isPriorityCalculated = YES;
+	}
+	
+	return node->effectivePriority;
+}
+
+/**
+ * Returns YES if node1 should be started before node2.
+**/
+static BOOL YDBCloudCoreGraphNodePrecedes(YDBCloudCoreGraphNode *node1, YDBCloudCoreGraphNode *node2)
+{
+	if (node1->effectivePriority != node2->effectivePriority)
+		return (node1->effectivePriority > node2->effectivePriority);
+	else
+		return (node1->order < node2->order);
+}
+
+- (void)pushReadyNode:(YDBCloudCoreGraphNode *)node
+{
+	if (readyHeap == nil) return; // ready-set not built yet
+	
+	// Sift up
+	
+	NSUInteger index = readyHeap.count;
+	[readyHeap addObject:node];
+	
+	while (index > 0)
+	{
+		NSUInteger parentIndex = (index - 1) / 2;
+		if (!YDBCloudCoreGraphNodePrecedes(readyHeap[index], readyHeap[parentIndex])) break;
+		
+		[readyHeap exchangeObjectAtIndex:index withObjectAtIndex:parentIndex];
+		index = parentIndex;
+	}
+}
+
+- (YDBCloudCoreGraphNode *)popReadyNode
+{
+	NSUInteger count = readyHeap.count;
+	if (count == 0) return nil;
+	
+	YDBCloudCoreGraphNode *result = readyHeap[0];
+	
+	[readyHeap exchangeObjectAtIndex:0 withObjectAtIndex:(count - 1)];
+	[readyHeap removeLastObject];
+	count--;
+	
+	// Sift down
+	
+	NSUInteger index = 0;
+	while (YES)
+	{
+		NSUInteger left = (2 * index) + 1;
+		NSUInteger right = left + 1;
+		NSUInteger best = index;
+		
+		if (left < count && YDBCloudCoreGraphNodePrecedes(readyHeap[left], readyHeap[best]))
+			best = left;
+		if (right < count && YDBCloudCoreGraphNodePrecedes(readyHeap[right], readyHeap[best]))
+			best = right;
+		
+		if (best == index) break;
+		
+		[readyHeap exchangeObjectAtIndex:index withObjectAtIndex:best];
+		index = best;
+	}
+	
+	return result;
+}
+
+/**
+ * This method searches for the next operation that can immediately be started.
  *
- * A baseOperation cannot be started until all of its dependencies have completed (or been skipped).
+ * The operations without remaining dependencies (the ready-set) are kept in a heap,
+ * ordered by effective priority (see rebuildReadySet), and then by the order within the graph.
+ * So the next operation is found without scanning the whole graph.
  *
- * This method searches for a dependent operation that can be started.
- * If found, this dependent operation is returned.
- * 
- * Otherwise it will search for a dependent operation that is not yet completed.
- * If found, this dependent operation is returned.
- * 
- * Otherwise it will return nil, if there are no dependent operations that aren't completed.
+ * If found, returns the next operation (and the pipeline marks it as started).
+ * Otherwise returns nil.
 **/
-- (YapDatabaseCloudCoreOperation *)_dequeueNextOperation:(YapDatabaseCloudCoreOperation *)baseOp
+- (YapDatabaseCloudCoreOperation *)dequeueNextOperation
 {
-	// Recursion - depth first search for dependent operation we can start, or that's blocking us
+	[self loadOperationsIfNeeded];
+	
+	if (needsRebuildReadySet) {
+		[self rebuildReadySet];
+	}
+	
+	// Operations that were previously dequeued may be ready again.
+	// E.g. they failed and were reset to pending, or their hold has expired.
+	
+	if (dequeuedNodes.count > 0)
 	{
-		YapDatabaseCloudCoreOperation *dependentOpToStart = nil;
-		YapDatabaseCloudCoreOperation *dependentOpNotDone = nil;
+		NSMutableArray<YDBCloudCoreGraphNode *> *stillDequeuedNodes = nil;
 		
-		for (NSUUID *depUUID in [baseOp dependencyUUIDs])
+		for (YDBCloudCoreGraphNode *node in dequeuedNodes)
 		{
-			YapDatabaseCloudCoreOperation *dependentOp = [self operationWithUUID:depUUID];
-			if (dependentOp)
+			if (node->isRemoved) continue;
+			
+			YDBCloudCoreOperationStatus status = YDBCloudOperationStatus_Pending;
+			BOOL isOnHold = NO;
+			[pipeline getStatus:&status isOnHold:&isOnHold forOperationUUID:node->operation.uuid];
+			
+			if (status == YDBCloudOperationStatus_Pending && !isOnHold)
+			{
+				[self pushReadyNode:node];
+			}
+			else if (status != YDBCloudOperationStatus_Completed &&
+			         status != YDBCloudOperationStatus_Skipped)
 			{
-				// Recursion step.
-				// Here's where we look for dependencies of dependencies of dependencies...
-				//
-				dependentOp = [self _dequeueNextOperation:dependentOp];
+				if (stillDequeuedNodes == nil)
+					stillDequeuedNodes = [NSMutableArray arrayWithCapacity:dequeuedNodes.count];
 				
-				if (dependentOp)
-				{
-					YDBCloudCoreOperationStatus status = YDBCloudOperationStatus_Pending;
-					BOOL isOnHold = NO;
-					[pipeline getStatus:&status isOnHold:&isOnHold forOperationUUID:dependentOp.uuid];
-					
-					if (status == YDBCloudOperationStatus_Pending && !isOnHold)
-					{
-						if (dependentOpToStart == nil)
-							dependentOpToStart = dependentOp;
-					}
-					else if (status != YDBCloudOperationStatus_Completed &&
-					         status != YDBCloudOperationStatus_Skipped)
-					{
-						if (dependentOpNotDone == nil)
-							dependentOpNotDone = dependentOp;
-					}
-				}
+				[stillDequeuedNodes addObject:node];
 			}
 		}
 		
-		if (dependentOpToStart) return dependentOpToStart;
-		if (dependentOpNotDone) return dependentOpNotDone;
+		dequeuedNodes = stillDequeuedNodes ?: [[NSMutableArray alloc] init];
 	}
 	
-	// Nothing found via recursion - apply algorithm to baseOp
+	YDBCloudCoreGraphNode *node = nil;
+	while ((node = [self popReadyNode]))
 	{
+		if (node->isRemoved) continue;
+		
 		YDBCloudCoreOperationStatus status = YDBCloudOperationStatus_Pending;
 		BOOL isOnHold = NO;
-		[pipeline getStatus:&status isOnHold:&isOnHold forOperationUUID:baseOp.uuid];
+		[pipeline getStatus:&status isOnHold:&isOnHold forOperationUUID:node->operation.uuid];
 		
-		if (status == YDBCloudOperationStatus_Pending && !isOnHold)
-			return baseOp;
+		if (status == YDBCloudOperationStatus_Completed ||
+		    status == YDBCloudOperationStatus_Skipped)
+		{
+			// Will be removed via removeCompletedAndSkippedOperations
+			continue;
+		}
 		
-		if (status != YDBCloudOperationStatus_Completed &&
-		    status != YDBCloudOperationStatus_Skipped)
-			return baseOp;
+		[dequeuedNodes addObject:node];
 		
-		return nil;
+		if (status == YDBCloudOperationStatus_Pending && !isOnHold)
+		{
+			return node->operation;
+		}
 	}
+	
+	return nil;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
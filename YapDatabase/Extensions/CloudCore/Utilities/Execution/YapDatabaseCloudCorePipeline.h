@@ -64,6 +64,27 @@ extern NSString *const YDBCloudCorePipelineSuspendCountChangedNotification;
 **/
 extern NSString *const YDBCloudCorePipelineActiveStatusChangedNotification;
 
+/**
+ * A snapshot of the adaptive concurrency controller, taken whenever it changes the concurrency.
+ *
+ * @see YapDatabaseCloudCorePipeline.adaptsConcurrentOperationCount
+**/
+@interface YDBCloudCoreConcurrencySample : NSObject
+
+/** When the change occurred. **/
+@property (nonatomic, strong, readonly) NSDate *date;
+
+/** The new effectiveConcurrentOperationCount. **/
+@property (nonatomic, assign, readonly) NSUInteger concurrentOperationCount;
+
+/** The moving average of the latency of completed operations (start to completion), in seconds. **/
+@property (nonatomic, assign, readonly) NSTimeInterval averageLatency;
+
+/** The moving average of the failure rate (0.0 - 1.0) of started operations. **/
+@property (nonatomic, assign, readonly) double failureRate;
+
+@end
+
 /**
  * A "pipeline" represents a queue of operations for syncing with a cloud server.
  * It operates by managing a series of "graphs".
@@ -122,6 +143,60 @@ extern NSString *const YDBCloudCorePipelineActiveStatusChangedNotification;
 **/
 @property (atomic, assign, readwrite) NSUInteger maxConcurrentOperationCount;
 
+/**
+ * Enables adaptive concurrency control (additive increase, multiplicative decrease).
+ *
+ * The pipeline measures the outcome of every operation it started:
+ * - An operation succeeds when it's completed (via [YapDatabaseCloudCoreTransaction completeOperation:]).
+ * - An operation fails when the PipelineDelegate gives it back to the pipeline
+ *   (via setStatusAsPendingForOperationWithUUID: or setStatusAsPendingForOperationWithUUID:retryDelay:).
+ * - Skipped operations are ignored.
+ *
+ * After a full "window" of successful operations (i.e. effectiveConcurrentOperationCount operations),
+ * the concurrency is increased by one. After a failure, or a success that took longer than
+ * congestionLatencyThreshold, the concurrency is halved. Operations that were started before the last decrease
+ * don't cause another decrease, so a burst of failures (of operations that were in flight together) only counts once.
+ *
+ * The concurrency starts at 8, and stays within [minConcurrentOperationCount, maxConcurrentOperationCount].
+ * So when enabled, maxConcurrentOperationCount acts as the upper limit (zero meaning no limit).
+ *
+ * This value may be changed at anytime.
+ *
+ * The default value is NO.
+**/
+@property (atomic, assign, readwrite) BOOL adaptsConcurrentOperationCount;
+
+/**
+ * The lower limit for adaptive concurrency control.
+ * Zero is treated as 1.
+ *
+ * The default value is 1.
+**/
+@property (atomic, assign, readwrite) NSUInteger minConcurrentOperationCount;
+
+/**
+ * If non-zero, a completed operation that took longer than this
+ * (from being started, until being completed) is treated as a sign of congestion.
+ * That is, it decreases the concurrency as if the operation failed.
+ *
+ * The default value is zero (disabled).
+**/
+@property (atomic, assign, readwrite) NSTimeInterval congestionLatencyThreshold;
+
+/**
+ * The maximum number of operations that are currently assigned to the delegate at any one time.
+ *
+ * If adaptsConcurrentOperationCount is enabled, this is the value calculated by the controller.
+ * Otherwise it's the same as maxConcurrentOperationCount (with zero meaning no limit).
+**/
+@property (atomic, readonly) NSUInteger effectiveConcurrentOperationCount;
+
+/**
+ * Returns the changes made by the adaptive concurrency controller (the most recent 100), oldest first.
+ * This is useful for telemetry.
+**/
+- (NSArray<YDBCloudCoreConcurrencySample *> *)concurrencyHistory;
+
 #pragma mark Operation Searching
 
 /**
@@ -33,6 +33,44 @@ NSString *const YDBCloudCorePipelineActiveStatusChangedNotification =
 NSString *const YDBCloudCore_EphemeralKey_Status   = @"status";
 NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 
+static NSUInteger const YDBCloudCore_AdaptiveConcurrency_Initial     = 8;
+static NSUInteger const YDBCloudCore_AdaptiveConcurrency_HistorySize = 100;
+static double     const YDBCloudCore_AdaptiveConcurrency_Smoothing   = 0.2; // weight of new value in moving averages
+
+
+@implementation YDBCloudCoreConcurrencySample
+
+@synthesize date = date;
+@synthesize concurrentOperationCount = concurrentOperationCount;
+@synthesize averageLatency = averageLatency;
+@synthesize failureRate = failureRate;
+
+- (instancetype)initWithConcurrentOperationCount:(NSUInteger)inConcurrentOperationCount
+                                  averageLatency:(NSTimeInterval)inAverageLatency
+                                     failureRate:(double)inFailureRate
+{
+	if ((self = [super init]))
+	{
+		date = [NSDate date];
+		concurrentOperationCount = inConcurrentOperationCount;
+		averageLatency = inAverageLatency;
+		failureRate = inFailureRate;
+	}
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YDBCloudCoreConcurrencySample: count=%lu, latency=%.3f, failureRate=%.3f>",
+	          (unsigned long)concurrentOperationCount, averageLatency, failureRate];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 
 @implementation YapDatabaseCloudCorePipeline
 {
@@ -48,6 +86,13 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 	NSMutableArray<YapDatabaseCloudCoreGraph *> *graphs;                 // must only be accessed/modified within queue
 	NSMutableSet<NSUUID *> *startedOpUUIDs;                              // must only be accessed/modified within queue
 	
+	NSMutableDictionary<NSUUID *, NSNumber *> *startTimes;               // must only be accessed/modified within queue
+	NSMutableArray<YDBCloudCoreConcurrencySample *> *concurrencyHistory; // must only be accessed/modified within queue
+	CFAbsoluteTime lastConcurrencyDecrease;                              // must only be accessed/modified within queue
+	NSUInteger concurrencyWindowSuccesses;                               // must only be accessed/modified within queue
+	NSTimeInterval averageLatency;                                       // must only be accessed/modified within queue
+	double failureRate;                                                  // must only be accessed/modified within queue
+	
 	int needsStartNextOperationFlag; // access/modify via OSAtomic
 	
 	dispatch_source_t holdTimer;
@@ -64,6 +109,11 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 
 @synthesize previousNames = previousNames;
 @synthesize maxConcurrentOperationCount = _atomic_maxConcurrentOperationCount;
+@synthesize adaptsConcurrentOperationCount = _atomic_adaptsConcurrentOperationCount;
+@synthesize minConcurrentOperationCount = _atomic_minConcurrentOperationCount;
+@synthesize congestionLatencyThreshold = _atomic_congestionLatencyThreshold;
+@synthesize adaptiveConcurrentOperationCount = _atomic_adaptiveConcurrentOperationCount;
+@dynamic effectiveConcurrentOperationCount;
 
 @synthesize rowid = rowid;
 
@@ -102,7 +152,11 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 		
 		startedOpUUIDs   = [[NSMutableSet alloc] initWithCapacity:8];
 		
+		startTimes         = [[NSMutableDictionary alloc] initWithCapacity:8];
+		concurrencyHistory = [[NSMutableArray alloc] init];
+		
 		self.maxConcurrentOperationCount = 8;
+		self.minConcurrentOperationCount = 1;
 	}
 	return self;
 }
@@ -563,6 +617,7 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 		if ([strongSelf _setStatus:YDBCloudOperationStatus_Started forOperationUUID:opUUID])
 		{
 			[strongSelf->startedOpUUIDs addObject:opUUID];
+			strongSelf->startTimes[opUUID] = @(CFAbsoluteTimeGetCurrent());
 		}
 	}};
 	
@@ -592,6 +647,7 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 		if (changed)
 		{
 			[strongSelf->startedOpUUIDs removeObject:opUUID];
+			[strongSelf adaptConcurrencyForOperationUUID:opUUID succeeded:NO];
 			[strongSelf startNextOperationIfPossible];
 		}
 	}};
@@ -632,6 +688,7 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 			                operationUUID:opUUID];
 			
 			[strongSelf->startedOpUUIDs removeObject:opUUID];
+			[strongSelf adaptConcurrencyForOperationUUID:opUUID succeeded:NO];
 			[strongSelf updateHoldTimer];
 			[strongSelf startNextOperationIfPossible];
 		}
@@ -1158,6 +1215,172 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 		dispatch_sync(queue, block);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Adaptive Concurrency
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the given (adaptive) concurrency, restricted to [minConcurrentOperationCount, maxConcurrentOperationCount].
+**/
+- (NSUInteger)boundedConcurrency:(NSUInteger)count
+{
+	NSUInteger upper = self.maxConcurrentOperationCount;
+	if (upper == 0)
+		upper = NSUIntegerMax;
+	
+	NSUInteger lower = MIN(MAX(self.minConcurrentOperationCount, (NSUInteger)1), upper);
+	
+	if (count == 0)
+		count = YDBCloudCore_AdaptiveConcurrency_Initial;
+	
+	return MIN(MAX(count, lower), upper);
+}
+
+- (NSUInteger)effectiveConcurrentOperationCount
+{
+	if (self.adaptsConcurrentOperationCount)
+		return [self boundedConcurrency:self.adaptiveConcurrentOperationCount];
+	else
+		return self.maxConcurrentOperationCount;
+}
+
+/**
+ * Returns the max number of started operations, as used by the dequeue logic.
+**/
+- (NSUInteger)concurrencyLimit
+{
+	NSAssert(dispatch_get_specific(IsOnQueueKey), @"Must be executed within queue");
+	
+	if (!self.adaptsConcurrentOperationCount)
+	{
+		NSUInteger maxConcurrentOperationCount = self.maxConcurrentOperationCount;
+		if (maxConcurrentOperationCount == 0)
+			maxConcurrentOperationCount = NSUIntegerMax;
+		
+		return maxConcurrentOperationCount;
+	}
+	
+	// The limits may have been changed since the last adjustment
+	
+	NSUInteger count = self.adaptiveConcurrentOperationCount;
+	NSUInteger boundedCount = [self boundedConcurrency:count];
+	
+	if (count != boundedCount) {
+		[self setAdaptiveConcurrency:boundedCount];
+	}
+	
+	return boundedCount;
+}
+
+- (void)setAdaptiveConcurrency:(NSUInteger)count
+{
+	NSAssert(dispatch_get_specific(IsOnQueueKey), @"Must be executed within queue");
+	
+	self.adaptiveConcurrentOperationCount = count;
+	
+	YDBCloudCoreConcurrencySample *sample =
+	  [[YDBCloudCoreConcurrencySample alloc] initWithConcurrentOperationCount:count
+	                                                           averageLatency:averageLatency
+	                                                              failureRate:failureRate];
+	
+	if (concurrencyHistory.count >= YDBCloudCore_AdaptiveConcurrency_HistorySize) {
+		[concurrencyHistory removeObjectAtIndex:0];
+	}
+	[concurrencyHistory addObject:sample];
+	
+	YDBLogVerbose(@"Pipeline(%@): concurrency = %@", name, sample);
+}
+
+/**
+ * Invoked when a started operation is completed (succeeded == YES), or is given back to the pipeline (succeeded == NO).
+ * Operations that weren't started by the pipeline (or via setStatusAsStartedForOperationWithUUID:) are ignored.
+**/
+- (void)adaptConcurrencyForOperationUUID:(NSUUID *)opUUID succeeded:(BOOL)succeeded
+{
+	NSAssert(dispatch_get_specific(IsOnQueueKey), @"Must be executed within queue");
+	
+	NSNumber *startTimeNum = startTimes[opUUID];
+	if (startTimeNum == nil) return;
+	
+	[startTimes removeObjectForKey:opUUID];
+	
+	if (!self.adaptsConcurrentOperationCount) return;
+	
+	CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+	CFAbsoluteTime startTime = [startTimeNum doubleValue];
+	NSTimeInterval latency = now - startTime;
+	
+	double const alpha = YDBCloudCore_AdaptiveConcurrency_Smoothing;
+	
+	failureRate = ((1.0 - alpha) * failureRate) + (alpha * (succeeded ? 0.0 : 1.0));
+	if (succeeded)
+	{
+		if (averageLatency == 0.0)
+			averageLatency = latency;
+		else
+			averageLatency = ((1.0 - alpha) * averageLatency) + (alpha * latency);
+	}
+	
+	NSTimeInterval congestionLatencyThreshold = self.congestionLatencyThreshold;
+	
+	BOOL congested = !succeeded || (congestionLatencyThreshold > 0.0 && latency > congestionLatencyThreshold);
+	
+	NSUInteger count = [self boundedConcurrency:self.adaptiveConcurrentOperationCount];
+	NSUInteger newCount = count;
+	
+	if (congested)
+	{
+		// Multiplicative decrease.
+		// But only once per burst: operations started before the last decrease were running at the old concurrency.
+		
+		if (startTime < lastConcurrencyDecrease) return;
+		
+		newCount = [self boundedConcurrency:MAX(count / 2, (NSUInteger)1)];
+		
+		lastConcurrencyDecrease = now;
+		concurrencyWindowSuccesses = 0;
+	}
+	else
+	{
+		// Additive increase: +1 per window (i.e. after 'count' successful operations)
+		
+		concurrencyWindowSuccesses++;
+		if (concurrencyWindowSuccesses < count) return;
+		
+		concurrencyWindowSuccesses = 0;
+		
+		if (count < NSUIntegerMax) {
+			newCount = [self boundedConcurrency:(count + 1)];
+		}
+	}
+	
+	if (newCount != count || self.adaptiveConcurrentOperationCount == 0)
+	{
+		[self setAdaptiveConcurrency:newCount];
+	}
+}
+
+- (NSArray<YDBCloudCoreConcurrencySample *> *)concurrencyHistory
+{
+	__block NSArray<YDBCloudCoreConcurrencySample *> *history = nil;
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		history = [concurrencyHistory copy];
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnQueueKey))
+		block();
+	else
+		dispatch_sync(queue, block);
+	
+	return history;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Dequeue Logic
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1218,6 +1441,12 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 			
 			for (YapDatabaseCloudCoreOperation *operation in removedOperations)
 			{
+				NSNumber *status = ephemeralInfo[operation.uuid][YDBCloudCore_EphemeralKey_Status];
+				if ([status integerValue] == YDBCloudOperationStatus_Completed)
+					[self adaptConcurrencyForOperationUUID:operation.uuid succeeded:YES];
+				else
+					[startTimes removeObjectForKey:operation.uuid];
+				
 				[startedOpUUIDs removeObject:operation.uuid];
 				[ephemeralInfo removeObjectForKey:operation.uuid];
 			}
@@ -1246,9 +1475,7 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 		return;
 	}
 	
-	NSUInteger maxConcurrentOperationCount = self.maxConcurrentOperationCount;
-	if (maxConcurrentOperationCount == 0)
-		maxConcurrentOperationCount = NSUIntegerMax;
+	NSUInteger maxConcurrentOperationCount = [self concurrencyLimit];
 	
 	if (startedOpUUIDs.count >= maxConcurrentOperationCount)
 	{
@@ -1276,6 +1503,8 @@ NSString *const YDBCloudCore_EphemeralKey_Hold     = @"hold";
 			}});
 			
 			[startedOpUUIDs addObject:nextOp.uuid];
+			startTimes[nextOp.uuid] = @(CFAbsoluteTimeGetCurrent());
+			
 			if (startedOpUUIDs.count >= maxConcurrentOperationCount) {
 				break;
 			}
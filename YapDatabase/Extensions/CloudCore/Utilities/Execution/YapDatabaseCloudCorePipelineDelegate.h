@@ -51,7 +51,7 @@
  * NOTE:
  *   The pipeline will attempt to start as many concurrent operations as it can.
  *   The number of concurrent operations is limited by:
- *   - pipeline.maxConcurrentOperationCount
+ *   - pipeline.effectiveConcurrentOperationCount (see maxConcurrentOperationCount & adaptsConcurrentOperationCount)
  *   - the operations within the pipeline, and their corresponding dependencies
 **/
 - (void)startOperation:(YapDatabaseCloudCoreOperation *)operation forPipeline:(YapDatabaseCloudCorePipeline *)pipeline;
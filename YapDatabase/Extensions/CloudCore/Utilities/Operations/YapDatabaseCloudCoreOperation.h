@@ -121,6 +121,10 @@
  *    And thus, operation B may actually complete before operation A.
  *    For example, if A is a large record, but B is small record.
  * 
+ * 4. Priority propagates to dependencies.
+ *    If operation B depends on operation A, then A is treated as having (at least) the priority of B.
+ *    So a high priority operation pulls its prerequisites forward (within its graph).
+ * 
  * Thus it is best to think of dependencies as hard requirements, and priorities as soft hints.
 **/
 @property (nonatomic, assign, readwrite) int32_t priority;
@@ -16,11 +16,14 @@ NS_ASSUME_NONNULL_BEGIN
  * - strict cache size
  * - eviction based on least-recently-used
  * 
- * The cache maintains a sorted array based on the keys.
- * So a lookup based on the key can be performed in O(log n) using a binary search algoritm.
+ * The cache maintains a hash index based on the keys (key -> {value -> item}).
+ * So a lookup based on the key (or key/value tuple) can be performed in O(1).
  * 
- * Similarly, the cache also maintains a sorted array based on the values.
- * So a lookup based on the value can be performed in O(log n) using a binary search algorithm.
+ * Similarly, the cache also maintains a hash index based on the values (value -> {key -> item}).
+ * So a lookup based on the value can be performed in O(1).
+ * 
+ * Both indexes share the same items. Enumerating (or removing) the items for a key or value
+ * is thus proportional to the number of matches, not to the size of the cache.
  * 
  * Thus, as opposed to a traditional dictionary/hashmap,
  * it is efficient to perform lookups on either the key or value.
@@ -85,7 +88,9 @@ NS_ASSUME_NONNULL_BEGIN
  * The key & value must be non-nil.
  * The key & value must implement the following methods:
  * - (BOOL)isEqual:(id)another
- * - (NSComparisonResult)compare:(id)another
+ * - (NSUInteger)hash
+ * 
+ * The key & value are retained (not copied), so they shouldn't be mutated after insertion.
  * 
  * If the key/value tuple already exists, it's metadata value is used using the given metadata.
  * And then the key/value tuple is moved to the beginning of the most-recently-used linked-list.
@@ -129,6 +134,7 @@ NS_ASSUME_NONNULL_BEGIN
  * - all keys based on a given value
  * 
  * All key/value tuples accessed during enumeration are moved to the beginning of the most-recently-used linked-list.
+ * The order of enumeration is undefined.
 **/
 - (void)enumerateValuesForKey:(id)key withBlock:(void (^)(id value, __nullable id metadata, BOOL *stop))block;
 - (void)enumerateKeysForValue:(id)value withBlock:(void (^)(id value, __nullable id metadata, BOOL *stop))block;
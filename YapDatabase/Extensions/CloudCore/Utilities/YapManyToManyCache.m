@@ -17,9 +17,6 @@
 
 static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 
-#undef NSNotFound
-#define NSNotFound !"NSNotFound is not used by our version of NSRange!"
-
 
 @interface YapManyToManyCacheItem : NSObject {
 @public
@@ -60,17 +57,30 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Both indexes are CFDictionaries, as the keys & values are retained (not copied).
+ *
+ * itemsByKey   : key   -> CFDictionary (value -> item)
+ * itemsByValue : value -> CFDictionary (key   -> item)
+**/
+static CFMutableDictionaryRef YapManyToManyCacheCreateDictionary(void)
+{
+	return CFDictionaryCreateMutable(kCFAllocatorDefault, 0,
+	                                 &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+}
+
 @implementation YapManyToManyCache {
 	
 	NSUInteger countLimit;
+	NSUInteger count;
 	
 	__strong YapManyToManyCacheItem *evictedCacheItem;
 	
 	__strong            YapManyToManyCacheItem *mostRecentCacheItem;
 	__unsafe_unretained YapManyToManyCacheItem *leastRecentCacheItem;
 	
-	NSPointerArray *sortedByKey;
-	NSPointerArray *sortedByValue;
+	CFMutableDictionaryRef itemsByKey;
+	CFMutableDictionaryRef itemsByValue;
 }
 
 @dynamic countLimit;
@@ -87,21 +97,39 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 	{
 		countLimit = inCountLimit;
 		
-		NSPointerFunctionsOptions options = NSPointerFunctionsOpaqueMemory | NSPointerFunctionsObjectPersonality;
-		
-		sortedByKey   = [[NSPointerArray alloc] initWithOptions:options];
-		sortedByValue = [[NSPointerArray alloc] initWithOptions:options];
+		itemsByKey   = YapManyToManyCacheCreateDictionary();
+		itemsByValue = YapManyToManyCacheCreateDictionary();
 	}
 	return self;
 }
 
+- (void)dealloc
+{
+	// Break the (strong) linked-list iteratively,
+	// as releasing a long list recursively could overflow the stack.
+	
+	__strong YapManyToManyCacheItem *item = mostRecentCacheItem;
+	mostRecentCacheItem = nil;
+	
+	while (item)
+	{
+		__strong YapManyToManyCacheItem *next = item->next;
+		item->next = nil;
+		
+		item = next;
+	}
+	
+	if (itemsByKey) CFRelease(itemsByKey);
+	if (itemsByValue) CFRelease(itemsByValue);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Properties
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 - (NSUInteger)count
 {
-	return [sortedByKey count];
+	return count;
 }
 
 - (NSUInteger)countLimit
@@ -114,33 +142,7 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 	if (countLimit != newCountLimit)
 	{
 		countLimit = newCountLimit;
-		
-		if (countLimit != 0)
-		{
-			while ([sortedByKey count] > countLimit)
-			{
-				evictedCacheItem = leastRecentCacheItem;
-				
-				leastRecentCacheItem->prev->next = nil;
-				leastRecentCacheItem = leastRecentCacheItem->prev;
-				
-				evictedCacheItem->prev     = nil;
-				evictedCacheItem->next     = nil;
-				evictedCacheItem->key      = nil;
-				evictedCacheItem->value    = nil;
-				evictedCacheItem->metadata = nil;
-				
-				NSUInteger index;
-				if ([self getIndex:&index ofCacheItem:evictedCacheItem inPointerArray:sortedByKey])
-				{
-					[sortedByKey removePointerAtIndex:index];
-				}
-				if ([self getIndex:&index ofCacheItem:evictedCacheItem inPointerArray:sortedByValue])
-				{
-					[sortedByValue removePointerAtIndex:index];
-				}
-			}
-		}
+		[self evictIfNeeded];
 	}
 }
 
@@ -149,145 +151,203 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Uses binary search algorithm to quickly find the range for a given input.
+ * Returns the bucket (CFDictionary) for the given key (value -> item) or value (key -> item).
 **/
-- (NSRange)findRangeForObject:(id)object isKey:(BOOL)isKey quitAfterOne:(BOOL)quitAfterOne
+- (CFMutableDictionaryRef)bucketForObject:(id)object isKey:(BOOL)isKey
 {
-	__unsafe_unretained NSPointerArray *sorted = isKey ? sortedByKey : sortedByValue;
+	if (object == nil) return NULL;
 	
-	NSUInteger count = [sorted count];
-	if (count == 0)
-	{
-		return NSMakeRange(0, 0); // range.location MUST be insert index, NOT NSNotFound !!!!!!!!!!!!
-	}
+	CFMutableDictionaryRef index = isKey ? itemsByKey : itemsByValue;
 	
-	NSComparisonResult (^compare)(NSUInteger);
+	return (CFMutableDictionaryRef)CFDictionaryGetValue(index, (__bridge const void *)object);
+}
+
+- (YapManyToManyCacheItem *)itemForKey:(id)key value:(id)value
+{
+	if (value == nil) return nil;
 	
-	if (isKey)
+	CFMutableDictionaryRef bucket = [self bucketForObject:key isKey:YES];
+	if (bucket == NULL) return nil;
+	
+	return (__bridge YapManyToManyCacheItem *)CFDictionaryGetValue(bucket, (__bridge const void *)value);
+}
+
+- (void)addItemToIndexes:(YapManyToManyCacheItem *)item
+{
+	CFMutableDictionaryRef keyBucket = [self bucketForObject:item->key isKey:YES];
+	if (keyBucket == NULL)
 	{
-		compare = ^NSComparisonResult (NSUInteger index){
-			
-			__unsafe_unretained YapManyToManyCacheItem *item =
-			          (__bridge YapManyToManyCacheItem *)[sorted pointerAtIndex:index];
-			
-			return [item->key compare:object];
-		};
+		keyBucket = YapManyToManyCacheCreateDictionary();
+		CFDictionarySetValue(itemsByKey, (__bridge const void *)item->key, keyBucket);
+		CFRelease(keyBucket); // retained by itemsByKey
 	}
-	else
+	
+	CFMutableDictionaryRef valueBucket = [self bucketForObject:item->value isKey:NO];
+	if (valueBucket == NULL)
 	{
-		compare = ^NSComparisonResult (NSUInteger index){
-			
-			__unsafe_unretained YapManyToManyCacheItem *item =
-			          (__bridge YapManyToManyCacheItem *)[sorted pointerAtIndex:index];
-			
-			return [item->value compare:object];
-		};
+		valueBucket = YapManyToManyCacheCreateDictionary();
+		CFDictionarySetValue(itemsByValue, (__bridge const void *)item->value, valueBucket);
+		CFRelease(valueBucket); // retained by itemsByValue
 	}
 	
-	// Find first match (first to return NSOrderedSame)
-	
-	NSUInteger mMin = 0;
-	NSUInteger mMax = count;
-	NSUInteger mMid = 0;
-	
-	BOOL found = NO;
-	
-	while (mMin < mMax && !found)
+	CFDictionarySetValue(keyBucket, (__bridge const void *)item->value, (__bridge const void *)item);
+	CFDictionarySetValue(valueBucket, (__bridge const void *)item->key, (__bridge const void *)item);
+}
+
+- (void)removeItemFromIndexes:(YapManyToManyCacheItem *)item
+{
+	CFMutableDictionaryRef keyBucket = [self bucketForObject:item->key isKey:YES];
+	if (keyBucket)
 	{
-		mMid = (mMin + mMax) / 2;
+		CFDictionaryRemoveValue(keyBucket, (__bridge const void *)item->value);
 		
-		NSComparisonResult cmp = compare(mMid);
-		
-		if (cmp == NSOrderedDescending)      // Descending => value is greater than desired range
-			mMax = mMid;
-		else if (cmp == NSOrderedAscending)  // Ascending => value is less than desired range
-			mMin = mMid + 1;
-		else
-			found = YES;
+		if (CFDictionaryGetCount(keyBucket) == 0) {
+			CFDictionaryRemoveValue(itemsByKey, (__bridge const void *)item->key);
+		}
 	}
 	
-	if (!found)
+	CFMutableDictionaryRef valueBucket = [self bucketForObject:item->value isKey:NO];
+	if (valueBucket)
 	{
-		return NSMakeRange(mMin, 0); // range.location MUST be insert index, NOT NSNotFound !!!!!!!!!!!!
+		CFDictionaryRemoveValue(valueBucket, (__bridge const void *)item->key);
+		
+		if (CFDictionaryGetCount(valueBucket) == 0) {
+			CFDictionaryRemoveValue(itemsByValue, (__bridge const void *)item->value);
+		}
 	}
+}
+
+/**
+ * Removes the item from the most-recently-used linked-list.
+**/
+- (void)unlinkItem:(YapManyToManyCacheItem *)item
+{
+	__strong YapManyToManyCacheItem *strongItem = item; // item->prev->next may be the only strong reference
 	
-	if (quitAfterOne)
-	{
-		return NSMakeRange(mMid, 1);
-	}
+	if (leastRecentCacheItem == strongItem)
+		leastRecentCacheItem = strongItem->prev;
+	else
+		strongItem->next->prev = strongItem->prev;
+	
+	if (mostRecentCacheItem == strongItem)
+		mostRecentCacheItem = strongItem->next;
+	else
+		strongItem->prev->next = strongItem->next;
 	
-	// Find start of range
+	strongItem->prev = nil;
+	strongItem->next = nil;
+}
+
+/**
+ * Adds the item to the beginning of the most-recently-used linked-list.
+**/
+- (void)linkItemAsMostRecent:(YapManyToManyCacheItem *)item
+{
+	item->prev = nil;
+	item->next = mostRecentCacheItem;
 	
-	NSUInteger sMin = mMin;
-	NSUInteger sMax = mMid;
-	NSUInteger sMid;
+	if (mostRecentCacheItem)
+		mostRecentCacheItem->prev = item;
+	else
+		leastRecentCacheItem = item;
 	
-	while (sMin < sMax)
+	mostRecentCacheItem = item;
+}
+
+/**
+ * Moves the item to the beginning of the most-recently-used linked-list.
+**/
+- (void)touchItem:(YapManyToManyCacheItem *)item
+{
+	if (item != mostRecentCacheItem)
 	{
-		sMid = (sMin + sMax) / 2;
-		
-		NSComparisonResult cmp = compare(sMid);
+		__strong YapManyToManyCacheItem *strongItem = item;
 		
-		if (cmp == NSOrderedAscending) // Ascending => value is less than desired range
-			sMin = sMid + 1;
-		else
-			sMax = sMid;
+		[self unlinkItem:strongItem];
+		[self linkItemAsMostRecent:strongItem];
 	}
+}
+
+/**
+ * Removes the item from the indexes & the linked-list.
+ * The item may be recycled for a future insert.
+**/
+- (void)removeItem:(YapManyToManyCacheItem *)item
+{
+	__strong YapManyToManyCacheItem *strongItem = item;
 	
-	// Find end of range
+	[self removeItemFromIndexes:strongItem];
+	[self unlinkItem:strongItem];
+	count--;
 	
-	NSUInteger eMin = mMid;
-	NSUInteger eMax = mMax;
-	NSUInteger eMid;
+	strongItem->key      = nil;
+	strongItem->value    = nil;
+	strongItem->metadata = nil;
 	
-	while (eMin < eMax)
+	if (evictedCacheItem == nil) {
+		evictedCacheItem = strongItem;
+	}
+}
+
+- (void)evictIfNeeded
+{
+	if (countLimit == 0) return;
+	
+	while (count > countLimit)
 	{
-		eMid = (eMin + eMax) / 2;
-		
-		NSComparisonResult cmp = compare(eMid);
+		YDBLogVerbose(@"evicting: %@", leastRecentCacheItem);
 		
-		if (cmp == NSOrderedDescending) // Descending => value is greater than desired range
-			eMax = eMid;
-		else
-			eMin = eMid + 1;
+		[self removeItem:leastRecentCacheItem];
 	}
-	
-	return NSMakeRange(sMin, (eMax - sMin));
 }
 
 /**
- * Utility method to quickly find an item in a pointerArray.
- * Similar to [NSArray indexOfObjectIdenticalTo:]
+ * Enumerates the items in the given bucket.
+ *
+ * The items are copied before enumeration (O(matches)), so the block may safely modify the cache.
+ * Items that are removed during enumeration are skipped.
 **/
-- (BOOL)getIndex:(NSUInteger *)indexPtr ofCacheItem:(YapManyToManyCacheItem *)itemToFind
-                                     inPointerArray:(NSPointerArray *)sorted
+- (void)enumerateItemsForObject:(id)object
+                          isKey:(BOOL)isKey
+                      withBlock:(void (^)(YapManyToManyCacheItem *item, BOOL *stop))block
 {
-	BOOL found = NO;
-	NSUInteger foundIndex = 0;
+	CFMutableDictionaryRef bucket = [self bucketForObject:object isKey:isKey];
+	if (bucket == NULL) return;
 	
-	NSUInteger index = 0;
-	for (YapManyToManyCacheItem *item in sorted)
+	NSArray<YapManyToManyCacheItem *> *items = [(__bridge NSDictionary *)bucket allValues];
+	
+	BOOL stop = NO;
+	
+	for (YapManyToManyCacheItem *item in items)
 	{
-		if (item == itemToFind) // pointer comparison
-		{
-			found = YES;
-			foundIndex = index;
-			
-			break;
-		}
+		id itemObject = isKey ? item->key : item->value;
+		
+		if (![itemObject isEqual:object]) continue; // removed (or recycled) during enumeration
 		
-		index++;
+		[self touchItem:item];
+		block(item, &stop);
+		
+		if (stop) break;
 	}
-	
-	if (indexPtr) *indexPtr = foundIndex;
-	return found;
 }
 
 - (void)debug
 {
-	NSAssert([sortedByKey count] == [sortedByValue count], @"Oops");
+	NSUInteger indexedCount = 0;
+	
+	for (NSDictionary *bucket in [(__bridge NSDictionary *)itemsByKey allValues])
+	{
+		indexedCount += bucket.count;
+	}
+	NSAssert(indexedCount == count, @"Oops");
+	
+	indexedCount = 0;
 	
-	NSUInteger count = [sortedByKey count];
+	for (NSDictionary *bucket in [(__bridge NSDictionary *)itemsByValue allValues])
+	{
+		indexedCount += bucket.count;
+	}
+	NSAssert(indexedCount == count, @"Oops");
 	
 	{ // make sure MRU linked-list is the same forwards & backwards
 		
@@ -313,42 +373,16 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 			
 			item = item->prev;
 		}
-	
+		
 		NSAssert([forwards isEqualToString:backwards], @"Oops");
 	}
 	
 	NSMutableString *debugString = [NSMutableString stringWithCapacity:(count * 64)];
 	
-	{ // print sortedByKey
-		
-		[debugString appendString:@"sortedByKey: \n"];
-		
-		for (YapManyToManyCacheItem *item in sortedByKey)
-		{
-			[debugString appendFormat:@"  %@\n", item];
-		}
-		
-		NSLog(@"%@", debugString);
-		[debugString deleteCharactersInRange:NSMakeRange(0, debugString.length)];
-	}
-	
-	{ // print sortedByValue
-		
-		[debugString appendString:@"sortedByValue: \n"];
-		
-		for (YapManyToManyCacheItem *item in sortedByValue)
-		{
-			[debugString appendFormat:@"  %@\n", item];
-		}
-		
-		NSLog(@"%@", debugString);
-		[debugString deleteCharactersInRange:NSMakeRange(0, debugString.length)];
-	}
-	
 	{ // print MRU
 		
 		[debugString appendString:@"MRU order: \n"];
-	
+		
 		__unsafe_unretained YapManyToManyCacheItem *item = mostRecentCacheItem;
 		while (item != nil)
 		{
@@ -372,59 +406,18 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 
 - (void)insertKey:(id)key value:(id)value metadata:(id)metadata
 {
-	NSRange keyRange = [self findRangeForObject:key isKey:YES quitAfterOne:NO];
-	
-	// Remember:
-	// - If the key was NOT found, then the location is the place where it should be inserted.
-	// - Thus, we MUST check range.length, NOT range.location.
+	if (key == nil) return;
+	if (value == nil) return;
 	
-	if (keyRange.length > 0)
+	YapManyToManyCacheItem *foundItem = [self itemForKey:key value:value];
+	if (foundItem)
 	{
-		__strong YapManyToManyCacheItem *foundItem = nil;
+		// key/value pair already exists in cache
 		
-		NSUInteger stop = keyRange.location + keyRange.length;
-		for (NSUInteger index = keyRange.location; index < stop; index++)
-		{
-			__unsafe_unretained YapManyToManyCacheItem *item =
-			          (__bridge YapManyToManyCacheItem *)[sortedByKey pointerAtIndex:index];
-			
-			if ([item->value isEqual:value])
-			{
-				foundItem = item;
-				break;
-			}
-		}
+		[self touchItem:foundItem];
 		
-		if (foundItem)
-		{
-			// key/value pair already exists in cache
-			
-			if (foundItem != mostRecentCacheItem)
-			{
-				// Remove item from current position in linked-list
-				//
-				// Things we already know (based on logic that got us here):
-				//   - count >= 1
-				//   - mostRecentCacheItem  != foundItem
-				//   - mostRecentCacheItem  != nil
-				//   - leastRecentCacheItem != nil
-				
-				if (leastRecentCacheItem == foundItem)       // count == 1
-					leastRecentCacheItem = foundItem->prev;
-				else                                         // count > 1 && foundItem isn't last (leastRecent)
-					foundItem->next->prev = foundItem->prev;
-				
-				foundItem->prev->next = foundItem->next;     // we know foundItem isn't first (mostRecent)
-				
-				// Move item to beginning of linked-list
-				
-				mostRecentCacheItem->prev = foundItem;       // we know mostRecent isn't nil
-				mostRecentCacheItem = foundItem;
-			}
-			
-			foundItem->metadata = metadata;
-			return;
-		}
+		foundItem->metadata = metadata;
+		return;
 	}
 	
 	// Create (or recycle) cacheItem
@@ -444,158 +437,52 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 		cacheItem = [[YapManyToManyCacheItem alloc] initWithKey:key value:value metadata:metadata];
 	}
 	
-	{ // Insert into sortedByKeys array
-		
-		NSUInteger keyIndex = keyRange.location + keyRange.length;
-		
-		[sortedByKey insertPointer:(__bridge void *)cacheItem atIndex:keyIndex];
-	}
-	
-	{ // Insert into sortedByValues array
-		
-		NSRange valueRange = [self findRangeForObject:value isKey:NO quitAfterOne:NO];
-		NSUInteger valueIndex = valueRange.location + valueRange.length;
-		
-		[sortedByValue insertPointer:(__bridge void *)cacheItem atIndex:valueIndex];
-	}
-	
-	// Add item to beginning of linked-list
-	
-	cacheItem->next = mostRecentCacheItem;
-	
-	if (mostRecentCacheItem)
-		mostRecentCacheItem->prev = cacheItem;
-	else
-		leastRecentCacheItem = cacheItem;
-	
-	mostRecentCacheItem = cacheItem;
+	[self addItemToIndexes:cacheItem];
+	[self linkItemAsMostRecent:cacheItem];
+	count++;
 	
 	// Evict leastRecentCacheItem if needed
 	
-	if ((countLimit != 0) && ([sortedByKey count] > countLimit))
-	{
-		YDBLogVerbose(@"evicting: %@", leastRecentCacheItem);
-		
-		// Note: evictedCacheItem is nil (based on logic from above)
-		
-		evictedCacheItem = leastRecentCacheItem;
-		
-		leastRecentCacheItem->prev->next = nil;
-		leastRecentCacheItem = leastRecentCacheItem->prev;
-		
-		evictedCacheItem->prev     = nil;
-		evictedCacheItem->next     = nil;
-		evictedCacheItem->key      = nil;
-		evictedCacheItem->value    = nil;
-		evictedCacheItem->metadata = nil;
-		
-		NSUInteger index;
-		if ([self getIndex:&index ofCacheItem:evictedCacheItem inPointerArray:sortedByKey])
-		{
-			[sortedByKey removePointerAtIndex:index];
-		}
-		if ([self getIndex:&index ofCacheItem:evictedCacheItem inPointerArray:sortedByValue])
-		{
-			[sortedByValue removePointerAtIndex:index];
-		}
-	}
+	[self evictIfNeeded];
 }
 
 - (BOOL)containsKey:(id)key value:(id)value
 {
-	NSRange range = [self findRangeForObject:key isKey:YES quitAfterOne:NO];
-	
-	if (range.length == 0) return NO;
-	
-	NSUInteger stopIndex = range.location + range.length;
-	for (NSUInteger index = range.location; index < stopIndex; index++)
-	{
-		__unsafe_unretained YapManyToManyCacheItem *item =
-		          (__bridge YapManyToManyCacheItem *)[sortedByKey pointerAtIndex:index];
-		
-		if ([item->value isEqual:value]) {
-			return YES;
-		}
-	}
-	
-	return NO;
+	return ([self itemForKey:key value:value] != nil);
 }
 
 - (id)metadataForKey:(id)key value:(id)value
 {
-	NSRange range = [self findRangeForObject:key isKey:YES quitAfterOne:NO];
-	
-	if (range.length == 0) return nil;
-	
-	__strong YapManyToManyCacheItem *foundItem = nil;
-	
-	NSUInteger stopIndex = range.location + range.length;
-	for (NSUInteger index = range.location; index < stopIndex; index++)
-	{
-		__unsafe_unretained YapManyToManyCacheItem *item =
-		(__bridge YapManyToManyCacheItem *)[sortedByKey pointerAtIndex:index];
-		
-		if ([item->value isEqual:value])
-		{
-			foundItem = item;
-			break;
-		}
-	}
+	YapManyToManyCacheItem *foundItem = [self itemForKey:key value:value];
+	if (foundItem == nil) return nil;
 	
-	if (foundItem && (foundItem != mostRecentCacheItem))
-	{
-		// Remove item from current position in linked-list
-		//
-		// Things we already know (based on logic that got us here):
-		//   - count >= 1
-		//   - mostRecentCacheItem  != foundItem
-		//   - mostRecentCacheItem  != nil
-		//   - leastRecentCacheItem != nil
-		
-		if (leastRecentCacheItem == foundItem)       // count == 1
-			leastRecentCacheItem = foundItem->prev;
-		else                                         // count > 1 && foundItem isn't last (isn't leastRecent)
-			foundItem->next->prev = foundItem->prev;
-		
-		foundItem->prev->next = foundItem->next;     // we know foundItem isn't first (isn't mostRecent)
-		
-		// Move item to beginning of linked-list
-		
-		foundItem->prev = nil;
-		foundItem->next = mostRecentCacheItem;
-		
-		mostRecentCacheItem->prev = foundItem;       // we know mostRecent isn't nil
-		mostRecentCacheItem = foundItem;
-	}
+	[self touchItem:foundItem];
 	
-	if (foundItem)
-		return foundItem->metadata;
-	else
-		return nil;
+	return foundItem->metadata;
 }
 
 - (BOOL)containsKey:(id)key
 {
-	NSRange range = [self findRangeForObject:key isKey:YES quitAfterOne:YES];
-	return (range.length > 0);
+	return ([self bucketForObject:key isKey:YES] != NULL);
 }
 
 - (BOOL)containsValue:(id)value
 {
-	NSRange range = [self findRangeForObject:value isKey:NO quitAfterOne:YES];
-	return (range.length > 0);
+	return ([self bucketForObject:value isKey:NO] != NULL);
 }
 
 - (NSUInteger)countForKey:(id)key
 {
-	NSRange range = [self findRangeForObject:key isKey:YES quitAfterOne:NO];
-	return range.length;
+	CFMutableDictionaryRef bucket = [self bucketForObject:key isKey:YES];
+	
+	return bucket ? (NSUInteger)CFDictionaryGetCount(bucket) : 0;
 }
 
 - (NSUInteger)countForValue:(id)value
 {
-	NSRange range = [self findRangeForObject:value isKey:NO quitAfterOne:NO];
-	return range.length;
+	CFMutableDictionaryRef bucket = [self bucketForObject:value isKey:NO];
+	
+	return bucket ? (NSUInteger)CFDictionaryGetCount(bucket) : 0;
 }
 
 - (void)enumerateValuesForKey:(id)key withBlock:(void (^)(id value, id metadata, BOOL *stop))block
@@ -603,61 +490,10 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 	if (key == nil) return;
 	if (block == NULL) return;
 	
-	NSRange range = [self findRangeForObject:key isKey:YES quitAfterOne:NO];
-	
-	if (range.length == 0) return;
-	
-	__unsafe_unretained NSPointerArray *sorted = sortedByKey;
-	
-	NSUInteger enumIndex = range.location;
-	NSUInteger stopIndex = range.location + range.length;
-	
-	BOOL stop = NO;
-	
-	while (enumIndex < stopIndex)
-	{
-		__unsafe_unretained YapManyToManyCacheItem *item =
-		          (__bridge YapManyToManyCacheItem *)[sorted pointerAtIndex:enumIndex];
-		
-		block(item->value, item->metadata, &stop);
-		
-		enumIndex++;
-		if (stop) break;
-	}
-	
-	// For every item that was touched during enumeration,
-	// move it to the beginning of the (most recently used) linked-list.
-	
-	for (NSUInteger index = range.location; index < enumIndex; index++)
-	{
-		__strong YapManyToManyCacheItem *item = (__bridge YapManyToManyCacheItem *)[sorted pointerAtIndex:index];
+	[self enumerateItemsForObject:key isKey:YES withBlock:^(YapManyToManyCacheItem *item, BOOL *stop) {
 		
-		if (item != mostRecentCacheItem)
-		{
-			// Things we already know (based on logic that got us here):
-			//   - count >= 1
-			//   - mostRecentCacheItem  != item
-			//   - mostRecentCacheItem  != nil
-			//   - leastRecentCacheItem != nil
-			
-			// Remove item from current position in linked-list
-			
-			if (leastRecentCacheItem == item)
-				leastRecentCacheItem = item->prev;
-			else
-				item->next->prev = item->prev;
-			
-			item->prev->next = item->next;
-			
-			// Move item to beginning of linked-list
-			
-			item->prev = nil;
-			item->next = mostRecentCacheItem;
-			
-			mostRecentCacheItem->prev = item;
-			mostRecentCacheItem = item;
-		}
-	}
+		block(item->value, item->metadata, stop);
+	}];
 }
 
 - (void)enumerateKeysForValue:(id)value withBlock:(void (^)(id value, id metadata, BOOL *stop))block
@@ -665,61 +501,10 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 	if (value == nil) return;
 	if (block == NULL) return;
 	
-	NSRange range = [self findRangeForObject:value isKey:NO quitAfterOne:NO];
-	
-	if (range.length == 0) return;
-	
-	__unsafe_unretained NSPointerArray *sorted = sortedByValue;
-	
-	NSUInteger enumIndex = range.location;
-	NSUInteger stopIndex = range.location + range.length;
-	
-	BOOL stop = NO;
-	
-	while (enumIndex < stopIndex)
-	{
-		__unsafe_unretained YapManyToManyCacheItem *item =
-		          (__bridge YapManyToManyCacheItem *)[sorted pointerAtIndex:enumIndex];
-		
-		block(item->key, item->metadata, &stop);
-		
-		enumIndex++;
-		if (stop) break;
-	}
-	
-	// For every item that was touched during enumeration,
-	// move it to the beginning of the (most recently used) linked-list.
-	
-	for (NSUInteger index = range.location; index < enumIndex; index++)
-	{
-		__strong YapManyToManyCacheItem *item = (__bridge YapManyToManyCacheItem *)[sorted pointerAtIndex:index];
+	[self enumerateItemsForObject:value isKey:NO withBlock:^(YapManyToManyCacheItem *item, BOOL *stop) {
 		
-		if (item != mostRecentCacheItem)
-		{
-			// Things we already know (based on logic that got us here):
-			//   - count >= 1
-			//   - mostRecentCacheItem  != item
-			//   - mostRecentCacheItem  != nil
-			//   - leastRecentCacheItem != nil
-			
-			// Remove item from current position in linked-list
-			
-			if (leastRecentCacheItem == item)
-				leastRecentCacheItem = item->prev;
-			else
-				item->next->prev = item->prev;
-			
-			item->prev->next = item->next;
-			
-			// Move item to beginning of linked-list
-			
-			item->prev = nil;
-			item->next = mostRecentCacheItem;
-			
-			mostRecentCacheItem->prev = item;
-			mostRecentCacheItem = item;
-		}
-	}
+		block(item->key, item->metadata, stop);
+	}];
 }
 
 /**
@@ -730,75 +515,16 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 **/
 - (void)removeItemWithKey:(id)key value:(id)value
 {
-	if (key == nil) return;
-	if (value == nil) return;
-	
-	NSRange keyRange = [self findRangeForObject:key isKey:YES quitAfterOne:NO];
-	
-	if (keyRange.length == 0) return; // key doesn't exist
-	
-	__strong YapManyToManyCacheItem *foundItem = nil;
-	
-	NSUInteger keyIndex = keyRange.location;
-	NSUInteger stopIndex = keyRange.location + keyRange.length;
-	
-	while (keyIndex < stopIndex)
+	YapManyToManyCacheItem *foundItem = [self itemForKey:key value:value];
+	if (foundItem)
 	{
-		__unsafe_unretained YapManyToManyCacheItem *item =
-		          (__bridge YapManyToManyCacheItem *)[sortedByKey pointerAtIndex:keyIndex];
-		
-		if ([item->value isEqual:value])
-		{
-			foundItem = item;
-			break;
-		}
-		
-		keyIndex++;
-	}
-	
-	if (foundItem == nil) return; // key/value pair doesn't exist
-	
-	{ // remove from sortedKeys
-		
-		[sortedByKey removePointerAtIndex:keyIndex];
-	}
-	{ // remove from sortedValues
-		
-		NSUInteger valueIndex = 0;
-		if ([self getIndex:&valueIndex ofCacheItem:foundItem inPointerArray:sortedByValue])
-		{
-			[sortedByValue removePointerAtIndex:valueIndex];
-		}
-	}
-	{ // remove from MRU linked-list
-		
-		if (mostRecentCacheItem == foundItem)
-			mostRecentCacheItem = foundItem->next;
-		
-		if (leastRecentCacheItem == foundItem)
-			leastRecentCacheItem = foundItem->prev;
-		
-		if (foundItem->next)
-			foundItem->next->prev = foundItem->prev;
-		
-		if (foundItem->prev)
-			foundItem->prev->next = foundItem->next;
-		
-		if (evictedCacheItem == nil)
-		{
-			evictedCacheItem = foundItem;
-			evictedCacheItem->prev     = nil;
-			evictedCacheItem->next     = nil;
-			evictedCacheItem->key      = nil;
-			evictedCacheItem->value    = nil;
-			evictedCacheItem->metadata = nil;
-		}
+		[self removeItem:foundItem];
 	}
 }
 
 /**
  * Enumerates all key/value pairs in the cache.
- * 
+ *
  * As this method is designed to enumerate all values, it ddes not affect the most-recently-used linked-list.
 **/
 - (void)enumerateWithBlock:(void (^)(id key, id value, id metadata, BOOL *stop))block
@@ -824,55 +550,14 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 **/
 - (void)removeAllItemsWithKey:(id)key
 {
-	if (key == nil) return;
+	CFMutableDictionaryRef bucket = [self bucketForObject:key isKey:YES];
+	if (bucket == NULL) return;
 	
-	NSRange range = [self findRangeForObject:key isKey:YES quitAfterOne:NO];
+	NSArray<YapManyToManyCacheItem *> *items = [(__bridge NSDictionary *)bucket allValues];
 	
-	if (range.length == 0) return;
-	
-	NSUInteger keyIndex = range.location; // doesn't change since we remove from array on each iteration
-	
-	for (NSUInteger i = 0; i < range.length; i++)
+	for (YapManyToManyCacheItem *item in items)
 	{
-		__strong YapManyToManyCacheItem *item =
-		    (__bridge YapManyToManyCacheItem *)[sortedByKey pointerAtIndex:keyIndex];
-		
-		{ // remove from sortedKeys
-		
-			[sortedByKey removePointerAtIndex:keyIndex];
-		}
-		{ // remove from sortedValues
-			
-			NSUInteger valueIndex = 0;
-			if ([self getIndex:&valueIndex ofCacheItem:item inPointerArray:sortedByValue])
-			{
-				[sortedByValue removePointerAtIndex:valueIndex];
-			}
-		}
-		{ // remove from MRU linked-list
-			
-			if (mostRecentCacheItem == item)
-				mostRecentCacheItem = item->next;
-			
-			if (leastRecentCacheItem == item)
-				leastRecentCacheItem = item->prev;
-			
-			if (item->next)
-				item->next->prev = item->prev;
-			
-			if (item->prev)
-				item->prev->next = item->next;
-			
-			if (evictedCacheItem == nil)
-			{
-				evictedCacheItem = item;
-				evictedCacheItem->prev     = nil;
-				evictedCacheItem->next     = nil;
-				evictedCacheItem->key      = nil;
-				evictedCacheItem->value    = nil;
-				evictedCacheItem->metadata = nil;
-			}
-		}
+		[self removeItem:item];
 	}
 }
 
@@ -881,55 +566,14 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 **/
 - (void)removeAllItemsWithValue:(id)value
 {
-	if (value == nil) return;
+	CFMutableDictionaryRef bucket = [self bucketForObject:value isKey:NO];
+	if (bucket == NULL) return;
 	
-	NSRange range = [self findRangeForObject:value isKey:NO quitAfterOne:NO];
+	NSArray<YapManyToManyCacheItem *> *items = [(__bridge NSDictionary *)bucket allValues];
 	
-	if (range.length == 0) return;
-	
-	NSUInteger valueIndex = range.location; // doesn't change since we remove from array on each iteration
-	
-	for (NSUInteger i = 0; i < range.length; i++)
+	for (YapManyToManyCacheItem *item in items)
 	{
-		__strong YapManyToManyCacheItem *item =
-		    (__bridge YapManyToManyCacheItem *)[sortedByValue pointerAtIndex:valueIndex];
-		
-		{ // remove from sortedKeys
-			
-			NSUInteger keyIndex = 0;
-			if ([self getIndex:&keyIndex ofCacheItem:item inPointerArray:sortedByKey])
-			{
-				[sortedByKey removePointerAtIndex:keyIndex];
-			}
-		}
-		{ // remove from sortedValues
-			
-			[sortedByValue removePointerAtIndex:valueIndex];
-		}
-		{ // remove from MRU linked-list
-			
-			if (mostRecentCacheItem == item)
-				mostRecentCacheItem = item->next;
-			
-			if (leastRecentCacheItem == item)
-				leastRecentCacheItem = item->prev;
-			
-			if (item->next)
-				item->next->prev = item->prev;
-			
-			if (item->prev)
-				item->prev->next = item->next;
-			
-			if (evictedCacheItem == nil)
-			{
-				evictedCacheItem = item;
-				evictedCacheItem->prev     = nil;
-				evictedCacheItem->next     = nil;
-				evictedCacheItem->key      = nil;
-				evictedCacheItem->value    = nil;
-				evictedCacheItem->metadata = nil;
-			}
-		}
+		[self removeItem:item];
 	}
 }
 
@@ -939,29 +583,35 @@ static const NSUInteger YapManyToManyCacheDefaultCountLimit = 40;
 **/
 - (void)removeAllItems
 {
-	NSUInteger count = [sortedByKey count];
-	
-	for (NSUInteger i = count; i > 0; i--)
-	{
-		[sortedByKey removePointerAtIndex:(i-1)];
-	}
-	for (NSUInteger i = count; i > 0; i--)
-	{
-		[sortedByValue removePointerAtIndex:(i-1)];
-	}
+	CFDictionaryRemoveAllValues(itemsByKey);
+	CFDictionaryRemoveAllValues(itemsByValue);
 	
 	if ((evictedCacheItem == nil) && (mostRecentCacheItem != nil))
 	{
 		evictedCacheItem = mostRecentCacheItem;
-		evictedCacheItem->prev     = nil;
-		evictedCacheItem->next     = nil;
-		evictedCacheItem->key      = nil;
-		evictedCacheItem->value    = nil;
-		evictedCacheItem->metadata = nil;
 	}
 	
+	// Break the (strong) linked-list iteratively (see dealloc)
+	
+	__strong YapManyToManyCacheItem *item = mostRecentCacheItem;
+	
 	mostRecentCacheItem = nil;
 	leastRecentCacheItem = nil;
+	
+	while (item)
+	{
+		__strong YapManyToManyCacheItem *next = item->next;
+		
+		item->prev     = nil;
+		item->next     = nil;
+		item->key      = nil;
+		item->value    = nil;
+		item->metadata = nil;
+		
+		item = next;
+	}
+	
+	count = 0;
 }
 
 @end
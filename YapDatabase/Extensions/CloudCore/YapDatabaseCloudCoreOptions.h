@@ -5,6 +5,26 @@
 #import <Foundation/Foundation.h>
 #import "YapWhitelistBlacklist.h"
 
+@class YapDatabaseCloudCoreOperation;
+
+/**
+ * Returns the key used to identify redundant operations (e.g. the cloudURI the operation targets).
+ * Return nil if the operation should never be coalesced.
+**/
+typedef id (^YDBCloudCoreOperationCoalescingKey)(YapDatabaseCloudCoreOperation *operation);
+
+/**
+ * Invoked with a pending operation, and a new operation with the same coalescing key.
+ *
+ * Return one of the following:
+ * - nil                     : the operations aren't coalesced (the new operation is queued as usual)
+ * - a copy of pendingOperation (modified as needed) : the new operation is merged into the pending operation
+ * - newOperation            : the new operation supersedes the pending operation (which is skipped)
+**/
+typedef YapDatabaseCloudCoreOperation* (^YDBCloudCoreOperationCoalescer)
+                                         (YapDatabaseCloudCoreOperation *pendingOperation,
+                                          YapDatabaseCloudCoreOperation *newOperation);
+
 
 @interface YapDatabaseCloudCoreOptions : NSObject <NSCopying>
 
@@ -39,4 +59,30 @@
 **/
 @property (nonatomic, assign, readwrite) BOOL enableAttachDetachSupport;
 
+/**
+ * Optional coalescing of redundant operations.
+ *
+ * For example, if a record is modified ten times while offline, you'd typically end up with ten upload operations
+ * for the same cloudURI. If all of them are still pending (not yet started), then a single upload is sufficient.
+ *
+ * If both blocks are set, then every operation added via addOperation: is checked against the pending operations
+ * (in the same pipeline) with the same coalescing key. If there are matches, the coalescer is invoked with the
+ * most recently queued one, and decides whether the new operation is merged into it, supersedes it, or neither.
+ *
+ * Only operations with a pending status are considered (not started, failed, completed or skipped).
+ * Operations inserted via insertOperation:inGraph: are never coalesced.
+ *
+ * Keep in mind:
+ * - The pipeline executes operations outside of database transactions.
+ *   So a pending operation may be started before the transaction is committed.
+ *   When merging, the merged changes are then applied just like modifyOperation: would apply them.
+ *   Superseding doesn't have this issue, as the new operation is queued (and the pending one is skipped).
+ * - A skipped (superseded) operation no longer blocks the operations that depend on it.
+ * - Finding the matches requires enumerating the queued operations of the pipeline.
+ *
+ * The default value is nil (disabled).
+**/
+@property (nonatomic, copy, readwrite) YDBCloudCoreOperationCoalescingKey coalescingKey;
+@property (nonatomic, copy, readwrite) YDBCloudCoreOperationCoalescer coalescer;
+
 @end
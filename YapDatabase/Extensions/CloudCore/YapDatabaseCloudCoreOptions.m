@@ -10,6 +10,8 @@
 @synthesize allowedOperationClasses = allowedOperationClasses;
 @synthesize enableAttachDetachSupport = enableAttachDetachSupport;
 @synthesize enableTagSupport = enableTagSupport;
+@synthesize coalescingKey = coalescingKey;
+@synthesize coalescer = coalescer;
 
 
 - (instancetype)init
@@ -28,6 +30,8 @@
 	copy->allowedOperationClasses = allowedOperationClasses;
 	copy->enableAttachDetachSupport = enableAttachDetachSupport;
 	copy->enableTagSupport = enableTagSupport;
+	copy->coalescingKey = coalescingKey;
+	copy->coalescer = coalescer;
 	
 	return copy;
 }
@@ -21,6 +21,8 @@
  *   The operation to be added to the pipeline's queue.
  *   The operation.pipeline property specifies which pipeline to use.
  *   The operation will be added to a new graph for the current commit.
+ *   If coalescing is enabled (see YapDatabaseCloudCoreOptions.coalescer),
+ *   the operation may instead be merged into a pending operation with the same coalescing key.
  *
  * @return
  *   NO if the operation isn't properly configured for use.
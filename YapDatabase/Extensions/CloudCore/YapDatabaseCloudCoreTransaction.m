@@ -711,6 +711,10 @@ static NSString *const ext_key_versionTag   = @"versionTag";
 	// Step 4 of 6:
 	//
 	// Read queue table
+	//
+	// The operations are NOT deserialized here.
+	// We only copy the blobs (per graph), and the graph deserializes them when its operations are first needed.
+	// With a large queue, this means we only pay for the graphs the pipeline actually gets to.
 	
 	NSMutableDictionary *operations = [NSMutableDictionary dictionary];
 	
@@ -760,17 +764,13 @@ static NSString *const ext_key_versionTag   = @"versionTag";
 			uint64_t graphID = (uint64_t)sqlite3_column_int64(statement, column_idx_graphID);
 			
 			// - Extract operation information
-			// - Create operation instance
+			
+			int64_t operationRowid = sqlite3_column_int64(statement, column_idx_rowid);
 			
 			const void *blob = sqlite3_column_blob(statement, column_idx_operation);
 			int blobSize = sqlite3_column_bytes(statement, column_idx_operation);
 			
-			NSData *operationBlob = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			
-			YapDatabaseCloudCoreOperation *operation = [self deserializeOperation:operationBlob];
-			
-			operation.operationRowid = sqlite3_column_int64(statement, column_idx_rowid);
-			operation.pipeline = pipelineName;
+			NSData *operationBlob = [NSData dataWithBytes:blob length:blobSize];
 			
 			// - Add to operationsPerPipeline
 			
@@ -786,7 +786,7 @@ static NSString *const ext_key_versionTag   = @"versionTag";
 				operationsPerGraph = operationsPerPipeline[@(graphID)] = [NSMutableArray array];
 			}
 			
-			[operationsPerGraph addObject:operation];
+			[operationsPerGraph addObject:@[ @(operationRowid), operationBlob ]];
 		}
 		
 		if (status != SQLITE_DONE)
@@ -802,12 +802,14 @@ static NSString *const ext_key_versionTag   = @"versionTag";
 	//
 	// Create the graphs (per pipeline)
 	
+	YDBCloudCoreOperationDeserializer operationDeserializer = parentConnection->parent->operationDeserializer;
+	
 	for (NSString *pipelineName in operations)
 	{
 		NSDictionary *operationsPerPipeline = operations[pipelineName];
 		
 		// key   : @(graphID) (uint64_t)
-		// value : @[operation, ...]
+		// value : @[ @[@(operationRowid), operationBlob], ... ]
 		
 		NSArray *sortedGraphIDs = [[operationsPerPipeline allKeys] sortedArrayUsingSelector:@selector(compare:)];
 		
@@ -815,11 +817,33 @@ static NSString *const ext_key_versionTag   = @"versionTag";
 		
 		for (NSNumber *graphID in sortedGraphIDs)
 		{
-			NSArray<YapDatabaseCloudCoreOperation *> *operationsPerGraph = operationsPerPipeline[graphID];
+			NSArray<NSArray *> *operationsPerGraph = operationsPerPipeline[graphID];
+			
+			NSArray<YapDatabaseCloudCoreOperation *> * (^operationsLoader)(void) = ^{ @autoreleasepool {
+				
+				NSMutableArray<YapDatabaseCloudCoreOperation *> *graphOperations =
+				  [NSMutableArray arrayWithCapacity:operationsPerGraph.count];
+				
+				for (NSArray *row in operationsPerGraph)
+				{
+					NSData *operationBlob = row[1];
+					if (operationBlob.length == 0) continue;
+					
+					YapDatabaseCloudCoreOperation *operation = operationDeserializer(operationBlob);
+					if (operation == nil) continue;
+					
+					operation.operationRowid = [row[0] longLongValue];
+					operation.pipeline = pipelineName;
+					
+					[graphOperations addObject:operation];
+				}
+				
+				return [graphOperations copy];
+			}};
 			
 			YapDatabaseCloudCoreGraph *graph =
 			  [[YapDatabaseCloudCoreGraph alloc] initWithPersistentOrder:[graphID unsignedLongLongValue]
-			                                                  operations:operationsPerGraph];
+			                                            operationsLoader:operationsLoader];
 			
 			[sortedGraphs addObject:graph];
 		}
@@ -1002,6 +1026,90 @@ static NSString *const ext_key_versionTag   = @"versionTag";
 	return YES;
 }
 
+/**
+ * Implements the (optional) coalescing of redundant operations.
+ * See YapDatabaseCloudCoreOptions.coalescingKey & coalescer.
+ *
+ * @return
+ *   The operation to import (either the given operation, or the version returned by the coalescer),
+ *   or nil if the operation was merged into a pending operation.
+**/
+- (YapDatabaseCloudCoreOperation *)coalesceOperation:(YapDatabaseCloudCoreOperation *)operation
+{
+	__unsafe_unretained YapDatabaseCloudCoreOptions *options = parentConnection->parent->options;
+	
+	YDBCloudCoreOperationCoalescingKey coalescingKey = options.coalescingKey;
+	YDBCloudCoreOperationCoalescer coalescer = options.coalescer;
+	
+	if (coalescingKey == nil || coalescer == nil) return operation;
+	
+	id key = coalescingKey(operation);
+	if (key == nil) return operation;
+	
+	YapDatabaseCloudCorePipeline *pipeline = [parentConnection->parent pipelineWithName:operation.pipeline];
+	if (pipeline == nil) {
+		pipeline = [parentConnection->parent defaultPipeline];
+	}
+	
+	// Find the most recently queued (pending) operation with the same key
+	
+	__block YapDatabaseCloudCoreOperation *pendingOp = nil;
+	
+	[self _enumerateOperationsInPipeline:pipeline.name
+	                          usingBlock:^(YapDatabaseCloudCoreOperation *op, NSUInteger graphIdx, BOOL *stop)
+	{
+		if (op.pendingStatusIsCompletedOrSkipped) return;
+		
+		if ([coalescingKey(op) isEqual:key] &&
+		    [pipeline statusForOperationWithUUID:op.uuid] == YDBCloudOperationStatus_Pending)
+		{
+			pendingOp = op;
+		}
+	}];
+	
+	if (pendingOp == nil) return operation;
+	
+	YapDatabaseCloudCoreOperation *result = coalescer([pendingOp copy], operation);
+	if (result == nil) return operation;
+	
+	if ([result.uuid isEqual:pendingOp.uuid])
+	{
+		// Merged into the pending operation
+		
+		result = [result copy];
+		result.pipeline = pendingOp.pipeline;
+		
+		[self addModifiedOperation:result];
+		return nil;
+	}
+	else if ([result.uuid isEqual:operation.uuid])
+	{
+		// Supersedes the pending operation
+		
+		NSMutableArray<YapDatabaseCloudCoreOperation *> *addedOps = parentConnection->operations_added[pipeline.name];
+		
+		NSUInteger addedIdx = [addedOps indexOfObjectIdenticalTo:pendingOp];
+		if (addedIdx != NSNotFound)
+		{
+			// Added during this transaction, so it was never written to disk.
+			[addedOps removeObjectAtIndex:addedIdx];
+		}
+		else
+		{
+			[self skipOperationWithUUID:pendingOp.uuid inPipeline:pipeline.name];
+		}
+		
+		return (result == operation) ? operation : [result copy];
+	}
+	else
+	{
+		YDBLogWarn(@"%@: The coalescer must return either the pending operation, the new operation, or nil."
+		           @" The operations will not be coalesced.", THIS_METHOD);
+		
+		return operation;
+	}
+}
+
 /**
  * Helper method to add a modified operation to the list.
 **/
@@ -1923,6 +2031,8 @@ static NSString *const ext_key_versionTag   = @"versionTag";
  *   The operation to be added to the pipeline's queue.
  *   The operation.pipeline property specifies which pipeline to use.
  *   The operation will be added to a new graph for the current commit.
+ *   If coalescing is enabled (see YapDatabaseCloudCoreOptions.coalescer),
+ *   the operation may instead be merged into a pending operation with the same coalescing key.
  *
  * @return
  *   NO if the operation isn't properly configured for use.
@@ -1954,6 +2064,15 @@ static NSString *const ext_key_versionTag   = @"versionTag";
 	
 	operation = [operation copy];
 	
+	// Optional coalescing logic
+	
+	operation = [self coalesceOperation:operation];
+	if (operation == nil)
+	{
+		// Merged into a pending operation
+		return YES;
+	}
+	
 	// Standard import logic
 	
 	return [self importOperation:operation withGraphIdx:nil];
@@ -136,6 +136,17 @@
 - (void)getNumberOfInFlightChangeSets:(NSUInteger *)numInFlightChangeSetsPtr
                      queuedChangeSets:(NSUInteger *)numQueuedChangeSetsPtr;
 
+/**
+ * Record counts, for monitoring the memory used by the queue.
+ *
+ * - numInFlightRecords: modified records & deleted recordIDs in the inFlight changeSet
+ * - numQueuedRecords: modified records & deleted recordIDs in the other changeSets
+ * - numIndexedRecords: distinct records in the recordID index (across all changeSets)
+**/
+- (void)getNumberOfInFlightRecords:(NSUInteger *)numInFlightRecordsPtr
+                     queuedRecords:(NSUInteger *)numQueuedRecordsPtr
+                    indexedRecords:(NSUInteger *)numIndexedRecordsPtr;
+
 #pragma mark Merge Handling
 
 /**
@@ -146,6 +157,16 @@
                       forRecordID:(CKRecordID *)recordID
                databaseIdentifier:(NSString *)databaseIdentifier;
 
+/**
+ * Same as above, but checks many records at once (acquiring the masterQueueLock only once).
+ * 
+ * On return, the sets contain the given recordIDs that have a pending modification / pending delete.
+**/
+- (void)getRecordIDsWithPendingModification:(NSSet **)outPendingModifications
+                                pendingDelete:(NSSet **)outPendingDeletes
+                                 forRecordIDs:(NSArray *)recordIDs
+                           databaseIdentifier:(NSString *)databaseIdentifier;
+
 /**
  * This method enumerates pendingChangeSetsFromPreviousCommits, from oldest commit to newest commit,
  * and merges the changedKeys & values into the given record.
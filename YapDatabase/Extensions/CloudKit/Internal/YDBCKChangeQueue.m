@@ -16,6 +16,9 @@
 	
 	NSMutableArray *oldChangeSets;
 	
+	NSMutableDictionary *recordIndex;
+	NSUInteger nextQueueSequence;
+	
 	NSArray *newChangeSets;
 	NSMutableDictionary *newChangeSetsDict;
 }
@@ -33,6 +36,7 @@
 		masterQueueLock = [[NSLock alloc] init];
 		
 		oldChangeSets = [[NSMutableArray alloc] init];
+		recordIndex = [[NSMutableDictionary alloc] init];
 	}
 	return self;
 }
@@ -50,7 +54,10 @@
 	// Get lock for access to 'oldChangeSets'
 	[masterQueueLock lock];
 	{
-		[oldChangeSets addObjectsFromArray:inOldChangeSets];
+		for (YDBCKChangeSet *oldChangeSet in inOldChangeSets)
+		{
+			[self appendOldChangeSet:oldChangeSet];
+		}
 	}
 	[masterQueueLock unlock];
 }
@@ -102,6 +109,8 @@
 		{
 			firstChangeSet.isInFlight = NO;
 			[oldChangeSets removeObjectAtIndex:0];
+			
+			[self unindexChangeSet:firstChangeSet];
 		}
 	}
 	[masterQueueLock unlock];
@@ -174,11 +183,15 @@
 		{
 			YDBCKChangeSet *master_oldChangeSet = [self->oldChangeSets objectAtIndex:index];
 			
+			[self unindexChangeSet:master_oldChangeSet];
+			
 			if (pending_oldChangeSet.hasChangesToDeletedRecordIDs)
 				master_oldChangeSet->deletedRecordIDs = pending_oldChangeSet->deletedRecordIDs;
 			
 			if (pending_oldChangeSet.hasChangesToModifiedRecords)
 				master_oldChangeSet->modifiedRecords = pending_oldChangeSet->modifiedRecords;
+			
+			[self indexChangeSet:master_oldChangeSet];
 		}
 	}
 	
@@ -188,7 +201,7 @@
 		pending_newChangeSet.hasChangesToDeletedRecordIDs = NO;
 		pending_newChangeSet.hasChangesToModifiedRecords = NO;
 		
-		[oldChangeSets addObject:pending_newChangeSet];
+		[self appendOldChangeSet:pending_newChangeSet];
 	}
 	
 	self.lockUUID = nil;
@@ -399,6 +412,43 @@
 	if (numQueuedChangeSetsPtr) *numQueuedChangeSetsPtr = queuedCount;
 }
 
+/**
+ * See header file for documentation.
+**/
+- (void)getNumberOfInFlightRecords:(NSUInteger *)numInFlightRecordsPtr
+                     queuedRecords:(NSUInteger *)numQueuedRecordsPtr
+                    indexedRecords:(NSUInteger *)numIndexedRecordsPtr
+{
+	NSAssert(self.isMasterQueue, @"Method can only be invoked on masterQueue");
+	
+	NSUInteger inFlightCount = 0;
+	NSUInteger queuedCount = 0;
+	NSUInteger indexedCount = 0;
+	
+	[masterQueueLock lock];
+	
+	for (YDBCKChangeSet *changeSet in oldChangeSets)
+	{
+		NSUInteger count = changeSet->modifiedRecords.count + changeSet->deletedRecordIDs.count;
+		
+		if (changeSet.isInFlight)
+			inFlightCount += count;
+		else
+			queuedCount += count;
+	}
+	
+	for (NSDictionary *changeSetsByRecordID in [recordIndex objectEnumerator])
+	{
+		indexedCount += changeSetsByRecordID.count;
+	}
+	
+	[masterQueueLock unlock];
+	
+	if (numInFlightRecordsPtr) *numInFlightRecordsPtr = inFlightCount;
+	if (numQueuedRecordsPtr) *numQueuedRecordsPtr = queuedCount;
+	if (numIndexedRecordsPtr) *numIndexedRecordsPtr = indexedCount;
+}
+
 #pragma mark Utilities
 
 - (id)keyForDatabaseIdentifier:(NSString *)databaseIdentifier
@@ -409,16 +459,119 @@
 		return [NSNull null];
 }
 
-static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
+#pragma mark Record Index
+
+/**
+ * The masterQueue maintains an index of: databaseIdentifier -> recordID -> changeSets (oldest to newest),
+ * including every changeSet (in oldChangeSets) that modifies or deletes the record.
+ *
+ * This allows us to find the pending changes for a particular record,
+ * without enumerating every changeSet in the queue (of which there may be thousands after a long offline period).
+**/
+- (void)indexChangeSet:(YDBCKChangeSet *)changeSet
+{
+	id key = [self keyForDatabaseIdentifier:changeSet.databaseIdentifier];
+	
+	NSMutableDictionary *changeSetsByRecordID = [recordIndex objectForKey:key];
+	if (changeSetsByRecordID == nil)
+	{
+		changeSetsByRecordID = [[NSMutableDictionary alloc] init];
+		[recordIndex setObject:changeSetsByRecordID forKey:key];
+	}
+	
+	void (^addRecordID)(CKRecordID *) = ^(CKRecordID *recordID){
+		
+		NSMutableArray *changeSets = [changeSetsByRecordID objectForKey:recordID];
+		if (changeSets == nil)
+		{
+			changeSets = [[NSMutableArray alloc] initWithCapacity:1];
+			[changeSetsByRecordID setObject:changeSets forKey:recordID];
+		}
+		
+		if ([changeSets lastObject] != changeSet)
+		{
+			[changeSets addObject:changeSet];
+		}
+	};
+	
+	for (CKRecordID *recordID in changeSet->modifiedRecords)
+	{
+		addRecordID(recordID);
+	}
+	for (CKRecordID *recordID in changeSet->deletedRecordIDs)
+	{
+		addRecordID(recordID);
+	}
+}
+
+- (void)unindexChangeSet:(YDBCKChangeSet *)changeSet
 {
-	if (dbid1 == nil) {
-		return (dbid2 == nil);
+	id key = [self keyForDatabaseIdentifier:changeSet.databaseIdentifier];
+	
+	NSMutableDictionary *changeSetsByRecordID = [recordIndex objectForKey:key];
+	if (changeSetsByRecordID == nil) return;
+	
+	void (^removeRecordID)(CKRecordID *) = ^(CKRecordID *recordID){
+		
+		NSMutableArray *changeSets = [changeSetsByRecordID objectForKey:recordID];
+		[changeSets removeObjectIdenticalTo:changeSet];
+		
+		if (changeSets && (changeSets.count == 0))
+		{
+			[changeSetsByRecordID removeObjectForKey:recordID];
+		}
+	};
+	
+	for (CKRecordID *recordID in changeSet->modifiedRecords)
+	{
+		removeRecordID(recordID);
+	}
+	for (CKRecordID *recordID in changeSet->deletedRecordIDs)
+	{
+		removeRecordID(recordID);
 	}
-	else {
-		return [dbid1 isEqualToString:dbid2];
+	
+	if (changeSetsByRecordID.count == 0)
+	{
+		[recordIndex removeObjectForKey:key];
 	}
 }
 
+/**
+ * Returns the changeSets (in oldChangeSets, from oldest to newest) that modify or delete the given record.
+ * The caller must hold the masterQueueLock.
+**/
+- (NSArray *)indexedChangeSetsForRecordID:(CKRecordID *)recordID databaseIdentifier:(NSString *)databaseIdentifier
+{
+	NSAssert(self.isMasterQueue, @"Method can only be invoked on masterQueue");
+	
+	id key = [self keyForDatabaseIdentifier:databaseIdentifier];
+	
+	return [[recordIndex objectForKey:key] objectForKey:recordID];
+}
+
+/**
+ * The changeSets in oldChangeSets have consecutive queueSequence numbers.
+ * So the index of a changeSet (in oldChangeSets) is its queueSequence minus that of the first changeSet.
+**/
+- (NSUInteger)firstQueueSequence
+{
+	YDBCKChangeSet *firstChangeSet = [oldChangeSets firstObject];
+	return firstChangeSet ? firstChangeSet->queueSequence : nextQueueSequence;
+}
+
+/**
+ * Adds the changeSet to the end of oldChangeSets, and to the index.
+ * The caller must hold the masterQueueLock.
+**/
+- (void)appendOldChangeSet:(YDBCKChangeSet *)changeSet
+{
+	changeSet->queueSequence = nextQueueSequence++;
+	
+	[oldChangeSets addObject:changeSet];
+	[self indexChangeSet:changeSet];
+}
+
 #pragma mark Merge Handling
 
 /**
@@ -437,18 +590,59 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	
 	@try {
 		
-		for (YDBCKChangeSet *prevChangeSet in oldChangeSets)
+		for (YDBCKChangeSet *prevChangeSet in [self indexedChangeSetsForRecordID:recordID
+		                                                      databaseIdentifier:databaseIdentifier])
+		{
+			if ([prevChangeSet->modifiedRecords objectForKey:recordID])
+			{
+				hasPendingModification = YES;
+			}
+			
+			if ([prevChangeSet->deletedRecordIDs containsObject:recordID])
+			{
+				hasPendingDelete = YES;
+			}
+		}
+		
+	} @finally {
+	
+		[masterQueueLock unlock];
+	}
+	
+	if (outHasPendingModification) *outHasPendingModification = hasPendingModification;
+	if (outHasPendingDelete) *outHasPendingDelete = hasPendingDelete;
+}
+
+/**
+ * Batch version of getHasPendingModification:hasPendingDelete:forRecordID:databaseIdentifier:.
+ * Used when merging many records pulled from the server.
+**/
+- (void)getRecordIDsWithPendingModification:(NSSet **)outPendingModifications
+                                pendingDelete:(NSSet **)outPendingDeletes
+                                 forRecordIDs:(NSArray *)recordIDs
+                           databaseIdentifier:(NSString *)databaseIdentifier
+{
+	NSMutableSet *pendingModifications = [NSMutableSet set];
+	NSMutableSet *pendingDeletes = [NSMutableSet set];
+	
+	// Get lock for access to 'oldChangeSets'
+	[masterQueueLock lock];
+	
+	@try {
+		
+		for (CKRecordID *recordID in recordIDs)
 		{
-			if (CompareDatabaseIdentifiers(databaseIdentifier, prevChangeSet.databaseIdentifier))
+			for (YDBCKChangeSet *prevChangeSet in [self indexedChangeSetsForRecordID:recordID
+			                                                      databaseIdentifier:databaseIdentifier])
 			{
 				if ([prevChangeSet->modifiedRecords objectForKey:recordID])
 				{
-					hasPendingModification = YES;
+					[pendingModifications addObject:recordID];
 				}
 				
 				if ([prevChangeSet->deletedRecordIDs containsObject:recordID])
 				{
-					hasPendingDelete = YES;
+					[pendingDeletes addObject:recordID];
 				}
 			}
 		}
@@ -458,8 +652,8 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 		[masterQueueLock unlock];
 	}
 	
-	if (outHasPendingModification) *outHasPendingModification = hasPendingModification;
-	if (outHasPendingDelete) *outHasPendingDelete = hasPendingDelete;
+	if (outPendingModifications) *outPendingModifications = pendingModifications;
+	if (outPendingDeletes) *outPendingDeletes = pendingDeletes;
 }
 
 /**
@@ -481,17 +675,15 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	// Get lock for access to 'oldChangeSets'
 	[masterQueueLock lock];
 	{
-		for (YDBCKChangeSet *prevChangeSet in oldChangeSets)
+		for (YDBCKChangeSet *prevChangeSet in [self indexedChangeSetsForRecordID:recordID
+		                                                      databaseIdentifier:databaseIdentifier])
 		{
-			if (CompareDatabaseIdentifiers(databaseIdentifier, prevChangeSet.databaseIdentifier))
+			YDBCKChangeRecord *prevRecord = [prevChangeSet->modifiedRecords objectForKey:recordID];
+			if (prevRecord)
 			{
-				YDBCKChangeRecord *prevRecord = [prevChangeSet->modifiedRecords objectForKey:recordID];
-				if (prevRecord)
-				{
-					[mergeInfo mergeNewerRecord:prevRecord.record newerOriginalValues:prevRecord.originalValues];
-					
-					hasPendingChanges = YES;
-				}
+				[mergeInfo mergeNewerRecord:prevRecord.record newerOriginalValues:prevRecord.originalValues];
+				
+				hasPendingChanges = YES;
 			}
 		}
 	}
@@ -574,48 +766,46 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	
 	// Update previous changeSets (if needed)
 	
-	NSUInteger index = 0;
-	for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+	NSUInteger firstSequence = [masterQueue firstQueueSequence];
+	for (YDBCKChangeSet *mqPrevChangeSet in [masterQueue indexedChangeSetsForRecordID:recordID
+	                                                              databaseIdentifier:databaseIdentifier])
 	{
-		if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+		NSUInteger index = mqPrevChangeSet->queueSequence - firstSequence;
+		
+		YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
+		if (mqPrevRecord)
 		{
-			YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
-			if (mqPrevRecord)
+			if (mqPrevRecord.needsStoreFullRecord == NO &&
+			    [mqPrevRecord.changedKeysSet intersectsSet:currentRecord.changedKeysSet])
 			{
-				if (mqPrevRecord.needsStoreFullRecord == NO &&
-				    [mqPrevRecord.changedKeysSet intersectsSet:currentRecord.changedKeysSet])
+				// The prevRecord is configured to only store the changedKeys array to disk.
+				//
+				// However, we're now seeing conflicting changes to the same CKRecord.
+				// For example:
+				// - a previous commit (not yet pushed to the cloud) changed CKRecord.firstName.
+				// - and this commit is also changing CKRecord.firstName.
+				//
+				// We can only use the changedKeys shortcut when it's possible for use to retrieve
+				// the corresponding values from the object. However, when this type of 'conflict' occurs,
+				// we can no longer use that shortcut. So we must modify the persisted information for
+				// the previous commit so that it stores the previous CKRecord in full,
+				// as opposed to just the changedKeys.
+				
+				YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
+				if (pqPrevChangeSet->modifiedRecords == nil)
 				{
-					// The prevRecord is configured to only store the changedKeys array to disk.
-					//
-					// However, we're now seeing conflicting changes to the same CKRecord.
-					// For example:
-					// - a previous commit (not yet pushed to the cloud) changed CKRecord.firstName.
-					// - and this commit is also changing CKRecord.firstName.
-					//
-					// We can only use the changedKeys shortcut when it's possible for use to retrieve
-					// the corresponding values from the object. However, when this type of 'conflict' occurs,
-					// we can no longer use that shortcut. So we must modify the persisted information for
-					// the previous commit so that it stores the previous CKRecord in full,
-					// as opposed to just the changedKeys.
-					
-					YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
-					if (pqPrevChangeSet->modifiedRecords == nil)
-					{
-						pqPrevChangeSet->modifiedRecords =
-						  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
-						                                        copyItems:YES];
-						
-						pqPrevChangeSet.hasChangesToModifiedRecords = YES;
-					}
+					pqPrevChangeSet->modifiedRecords =
+					  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
+					                                        copyItems:YES];
 					
-					YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
-					pqPrevRecord.needsStoreFullRecord = YES;
+					pqPrevChangeSet.hasChangesToModifiedRecords = YES;
 				}
+				
+				YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
+				pqPrevRecord.needsStoreFullRecord = YES;
 			}
 		}
-		
-		index++;
-	} // end for (YDBCKChangeSet *mqPrevChangeSet in changeSets)
+	} // end for (YDBCKChangeSet *mqPrevChangeSet in indexedChangeSets)
 	
 	// Update current changeSet
 	
@@ -654,44 +844,42 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	
 	// Update previous changeSets (if needed)
 	
-	NSUInteger index = 0;
-	for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+	NSUInteger firstSequence = [masterQueue firstQueueSequence];
+	for (YDBCKChangeSet *mqPrevChangeSet in [masterQueue indexedChangeSetsForRecordID:recordID
+	                                                              databaseIdentifier:databaseIdentifier])
 	{
-		if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+		NSUInteger index = mqPrevChangeSet->queueSequence - firstSequence;
+		
+		YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
+		if (mqPrevRecord)
 		{
-			YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
-			if (mqPrevRecord)
+			if (mqPrevRecord.needsStoreFullRecord == NO)
 			{
-				if (mqPrevRecord.needsStoreFullRecord == NO)
+				// The masterPrevRecord is configured to only store the changedKeys array to disk.
+				//
+				// However, we're now detaching the rowid from the CKRecord.
+				//
+				// We can only use the changedKeys shortcut when it's possible for use to retrieve
+				// the corresponding values from the object. However, when the rowid is detached,
+				// we can no longer use that shortcut. So we must modify the persisted information for
+				// the previous commit so that it stores the previous CKRecord in full,
+				// as opposed to just the changedKeys.
+				
+				YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
+				if (pqPrevChangeSet->modifiedRecords == nil)
 				{
-					// The masterPrevRecord is configured to only store the changedKeys array to disk.
-					//
-					// However, we're now detaching the rowid from the CKRecord.
-					//
-					// We can only use the changedKeys shortcut when it's possible for use to retrieve
-					// the corresponding values from the object. However, when the rowid is detached,
-					// we can no longer use that shortcut. So we must modify the persisted information for
-					// the previous commit so that it stores the previous CKRecord in full,
-					// as opposed to just the changedKeys.
-					
-					YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
-					if (pqPrevChangeSet->modifiedRecords == nil)
-					{
-						pqPrevChangeSet->modifiedRecords =
-						  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
-						                                        copyItems:YES];
-						
-						pqPrevChangeSet.hasChangesToModifiedRecords = YES;
-					}
+					pqPrevChangeSet->modifiedRecords =
+					  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
+					                                        copyItems:YES];
 					
-					YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
-					pqPrevRecord.needsStoreFullRecord = YES;
+					pqPrevChangeSet.hasChangesToModifiedRecords = YES;
 				}
+				
+				YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
+				pqPrevRecord.needsStoreFullRecord = YES;
 			}
 		}
-		
-		index++;
-	} // end for (YDBCKChangeSet *mqPrevChangeSet in changeSets)
+	} // end for (YDBCKChangeSet *mqPrevChangeSet in indexedChangeSets)
 }
 
 /**
@@ -717,47 +905,45 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	
 	// Update previous changeSets (if needed)
 	
-	NSUInteger index = 0;
-	for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+	NSUInteger firstSequence = [masterQueue firstQueueSequence];
+	for (YDBCKChangeSet *mqPrevChangeSet in [masterQueue indexedChangeSetsForRecordID:recordID
+	                                                              databaseIdentifier:databaseIdentifier])
 	{
-		if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+		NSUInteger index = mqPrevChangeSet->queueSequence - firstSequence;
+		
+		YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
+		if (mqPrevRecord)
 		{
-			YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
-			if (mqPrevRecord)
+			if (mqPrevRecord.needsStoreFullRecord == NO)
 			{
-				if (mqPrevRecord.needsStoreFullRecord == NO)
+				// The mqPrevRecord is configured to only store the changedKeys array to disk.
+				//
+				// However, we're now seeing conflicting changes to the same CKRecord.
+				// For example:
+				// - a previous commit (not yet pushed to the cloud) changed CKRecord.firstName.
+				// - and this commit is deleting the same CKRecord.
+				//
+				// We can only use the changedKeys shortcut when it's possible for use to retrieve
+				// the corresponding values from the object. However, when this type of 'conflict' occurs,
+				// we can no longer use that shortcut. So we must modify the persisted information for
+				// the previous commit so that it stores the previous CKRecord in full,
+				// as opposed to just the changedKeys.
+				
+				YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
+				if (pqPrevChangeSet->modifiedRecords == nil)
 				{
-					// The mqPrevRecord is configured to only store the changedKeys array to disk.
-					//
-					// However, we're now seeing conflicting changes to the same CKRecord.
-					// For example:
-					// - a previous commit (not yet pushed to the cloud) changed CKRecord.firstName.
-					// - and this commit is deleting the same CKRecord.
-					//
-					// We can only use the changedKeys shortcut when it's possible for use to retrieve
-					// the corresponding values from the object. However, when this type of 'conflict' occurs,
-					// we can no longer use that shortcut. So we must modify the persisted information for
-					// the previous commit so that it stores the previous CKRecord in full,
-					// as opposed to just the changedKeys.
-					
-					YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
-					if (pqPrevChangeSet->modifiedRecords == nil)
-					{
-						pqPrevChangeSet->modifiedRecords =
-						  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
-						                                        copyItems:YES];
-						
-						pqPrevChangeSet.hasChangesToModifiedRecords = YES;
-					}
+					pqPrevChangeSet->modifiedRecords =
+					  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
+					                                        copyItems:YES];
 					
-					YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
-					pqPrevRecord.needsStoreFullRecord = YES;
+					pqPrevChangeSet.hasChangesToModifiedRecords = YES;
 				}
+				
+				YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
+				pqPrevRecord.needsStoreFullRecord = YES;
 			}
 		}
-		
-		index++;
-	} // end for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+	} // end for (YDBCKChangeSet *mqPrevChangeSet in indexedChangeSets)
 	
 	// Update current changeSet
 	
@@ -812,96 +998,94 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	
 	CKRecordID *recordID = mergedRecord.recordID;
 	
-	NSUInteger index = 0;
-	for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+	NSUInteger firstSequence = [masterQueue firstQueueSequence];
+	for (YDBCKChangeSet *mqPrevChangeSet in [masterQueue indexedChangeSetsForRecordID:recordID
+	                                                              databaseIdentifier:databaseIdentifier])
 	{
-		if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+		NSUInteger index = mqPrevChangeSet->queueSequence - firstSequence;
+		
+		YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
+		if (mqPrevRecord)
 		{
-			YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
-			if (mqPrevRecord)
+			CKRecord *localRecord = mqPrevRecord.record;
+			NSSet *localRecordChangedKeysSet = mqPrevRecord.changedKeysSet;
+			
+			if (keysToRemove == nil)
+				keysToRemove = [NSMutableSet setWithCapacity:localRecordChangedKeysSet.count];
+			else
+				[keysToRemove removeAllObjects];
+			
+			if (keysToCompare == nil)
+				keysToCompare = [NSMutableSet setWithCapacity:localRecordChangedKeysSet.count];
+			else
+				[keysToCompare removeAllObjects];
+			
+			for (NSString *key in localRecordChangedKeysSet)
 			{
-				CKRecord *localRecord = mqPrevRecord.record;
-				NSSet *localRecordChangedKeysSet = mqPrevRecord.changedKeysSet;
-				
-				if (keysToRemove == nil)
-					keysToRemove = [NSMutableSet setWithCapacity:localRecordChangedKeysSet.count];
-				else
-					[keysToRemove removeAllObjects];
-				
-				if (keysToCompare == nil)
-					keysToCompare = [NSMutableSet setWithCapacity:localRecordChangedKeysSet.count];
+				if ([mergedRecordChangedKeysSet containsObject:key])
+					[keysToCompare addObject:key];
 				else
-					[keysToCompare removeAllObjects];
-				
-				for (NSString *key in localRecordChangedKeysSet)
-				{
-					if ([mergedRecordChangedKeysSet containsObject:key])
-						[keysToCompare addObject:key];
-					else
-						[keysToRemove addObject:key];
-				}
+					[keysToRemove addObject:key];
+			}
+			
+			for (NSString *key in keysToCompare)
+			{
+				id localValue = [localRecord objectForKey:key];
+				id mergedValue = [mergedRecord objectForKey:key];
 				
-				for (NSString *key in keysToCompare)
+				if ((localValue == nil && mergedValue == nil) || [localValue isEqual:mergedValue])
 				{
-					id localValue = [localRecord objectForKey:key];
-					id mergedValue = [mergedRecord objectForKey:key];
-					
-					if ((localValue == nil && mergedValue == nil) || [localValue isEqual:mergedValue])
-					{
-						[mergedRecordHandledKeys addObject:key];
-					}
-					else
-					{
-						[keysToRemove addObject:key];
-					}
+					[mergedRecordHandledKeys addObject:key];
 				}
-				
-				// We need to get the system metadata from the mergedRecord,
-				// and inject the values from the localRecord.
-				CKRecord *newLocalRecord = [mergedRecord sanitizedCopy];
-				
-				for (NSString *key in localRecord.changedKeys)
+				else
 				{
-					if (![keysToRemove containsObject:key])
-					{
-						// Remember: nil is a valid value.
-						// It indicates removal of the value for the key, which is a valid action.
-						
-						id value = [localRecord objectForKey:key];
-						[newLocalRecord setObject:value forKey:key];
-					}
+					[keysToRemove addObject:key];
 				}
-				
-				YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
-				if (pqPrevChangeSet->modifiedRecords == nil)
+			}
+			
+			// We need to get the system metadata from the mergedRecord,
+			// and inject the values from the localRecord.
+			CKRecord *newLocalRecord = [mergedRecord sanitizedCopy];
+			
+			for (NSString *key in localRecord.changedKeys)
+			{
+				if (![keysToRemove containsObject:key])
 				{
-					pqPrevChangeSet->modifiedRecords =
-					  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
-					                                        copyItems:YES];
+					// Remember: nil is a valid value.
+					// It indicates removal of the value for the key, which is a valid action.
 					
-					pqPrevChangeSet.hasChangesToModifiedRecords = YES;
+					id value = [localRecord objectForKey:key];
+					[newLocalRecord setObject:value forKey:key];
 				}
+			}
+			
+			YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
+			if (pqPrevChangeSet->modifiedRecords == nil)
+			{
+				pqPrevChangeSet->modifiedRecords =
+				  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords
+				                                        copyItems:YES];
 				
-				if (newLocalRecord.changedKeys.count > 0)
-				{
-					// Update the record using the merged newLocalRecord
-					
-					YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
-					pqPrevRecord.record = newLocalRecord;
-				}
-				else
-				{
-					// Remove the record from the change-set.
-					// There's no longer any need to upload it since we've dismissed all the queued changes.
-					
-					[pqPrevChangeSet->modifiedRecords removeObjectForKey:recordID];
-				}
+				pqPrevChangeSet.hasChangesToModifiedRecords = YES;
+			}
 			
-			} // end if (mqPrevRecord)
-		} // end if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+			if (newLocalRecord.changedKeys.count > 0)
+			{
+				// Update the record using the merged newLocalRecord
+				
+				YDBCKChangeRecord *pqPrevRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
+				pqPrevRecord.record = newLocalRecord;
+			}
+			else
+			{
+				// Remove the record from the change-set.
+				// There's no longer any need to upload it since we've dismissed all the queued changes.
+				
+				[pqPrevChangeSet->modifiedRecords removeObjectForKey:recordID];
+			}
 		
-		index++;
-	} // end for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+		} // end if (mqPrevRecord)
+	} // end for (YDBCKChangeSet *mqPrevChangeSet in indexedChangeSets)
 	
 	if (mergedRecordChangedKeysSet.count != mergedRecordHandledKeys.count)
 	{
@@ -964,47 +1148,45 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	
 	// Update previous changeSets (if needed)
 	
-	NSUInteger index = 0;
-	for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+	NSUInteger firstSequence = [masterQueue firstQueueSequence];
+	for (YDBCKChangeSet *mqPrevChangeSet in [masterQueue indexedChangeSetsForRecordID:recordID
+	                                                              databaseIdentifier:databaseIdentifier])
 	{
-		if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+		NSUInteger index = mqPrevChangeSet->queueSequence - firstSequence;
+		
+		// Check to see if we have queued modifications to push for this item
+		
+		YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
+		if (mqPrevRecord)
 		{
-			// Check to see if we have queued modifications to push for this item
-			
-			YDBCKChangeRecord *mqPrevRecord = [mqPrevChangeSet->modifiedRecords objectForKey:recordID];
-			if (mqPrevRecord)
+			YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
+			if (pqPrevChangeSet->modifiedRecords == nil)
 			{
-				YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
-				if (pqPrevChangeSet->modifiedRecords == nil)
-				{
-					pqPrevChangeSet->modifiedRecords =
-					  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords copyItems:YES];
-					
-					pqPrevChangeSet.hasChangesToModifiedRecords = YES;
-				}
+				pqPrevChangeSet->modifiedRecords =
+				  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords copyItems:YES];
 				
-				[pqPrevChangeSet->modifiedRecords removeObjectForKey:recordID];
+				pqPrevChangeSet.hasChangesToModifiedRecords = YES;
 			}
 			
-			// Check to see if we have queued deletion for this item
-			
-			if ([mqPrevChangeSet->deletedRecordIDs containsObject:recordID])
+			[pqPrevChangeSet->modifiedRecords removeObjectForKey:recordID];
+		}
+		
+		// Check to see if we have queued deletion for this item
+		
+		if ([mqPrevChangeSet->deletedRecordIDs containsObject:recordID])
+		{
+			YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
+			if (pqPrevChangeSet->deletedRecordIDs == nil)
 			{
-				YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:index];
-				if (pqPrevChangeSet->deletedRecordIDs == nil)
-				{
-					pqPrevChangeSet->deletedRecordIDs = [mqPrevChangeSet->deletedRecordIDs mutableCopy];
-					pqPrevChangeSet.hasChangesToDeletedRecordIDs = YES;
-				}
-				
-				[pqPrevChangeSet->deletedRecordIDs removeObject:recordID];
-			
+				pqPrevChangeSet->deletedRecordIDs = [mqPrevChangeSet->deletedRecordIDs mutableCopy];
+				pqPrevChangeSet.hasChangesToDeletedRecordIDs = YES;
 			}
 			
-		} // end if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+			[pqPrevChangeSet->deletedRecordIDs removeObject:recordID];
 		
-		index++;
-	} // end for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+		}
+		
+	} // end for (YDBCKChangeSet *mqPrevChangeSet in indexedChangeSets)
 }
 
 /**
@@ -1059,65 +1241,62 @@ static BOOL CompareDatabaseIdentifiers(NSString *dbid1, NSString *dbid2)
 	
 	CKRecord *sanitizedRecord = nil;
 	
-	NSUInteger i = 0;
-	for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+	NSUInteger firstSequence = [masterQueue firstQueueSequence];
+	for (YDBCKChangeSet *mqPrevChangeSet in [masterQueue indexedChangeSetsForRecordID:recordID
+	                                                              databaseIdentifier:databaseIdentifier])
 	{
+		NSUInteger i = mqPrevChangeSet->queueSequence - firstSequence;
+		
 		// Skip inFlight changeSet
 		if (i == 0) {
-			i++;
 			continue;
 		}
 		
 		// Process other previous changeSets
 
-		if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
+		if ([mqPrevChangeSet->modifiedRecords objectForKey:recordID])
 		{
-			if ([mqPrevChangeSet->modifiedRecords objectForKey:recordID])
+			YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:i];
+			
+			if (pqPrevChangeSet->modifiedRecords == nil)
 			{
-				YDBCKChangeSet *pqPrevChangeSet = [pendingQueue->oldChangeSets objectAtIndex:i];
+				pqPrevChangeSet->modifiedRecords =
+				  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords copyItems:YES];
 				
-				if (pqPrevChangeSet->modifiedRecords == nil)
-				{
-					pqPrevChangeSet->modifiedRecords =
-					  [[NSMutableDictionary alloc] initWithDictionary:mqPrevChangeSet->modifiedRecords copyItems:YES];
-					
-					pqPrevChangeSet.hasChangesToModifiedRecords = YES;
-				}
-				
-				if (sanitizedRecord == nil)
-				{
-					sanitizedRecord = [record sanitizedCopy];
-				}
-				
-				YDBCKChangeRecord *pqChangeRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
-				
-				CKRecord *originalRecord = pqChangeRecord.record;
-				CKRecord *mergedRecord = [sanitizedRecord safeCopy];
-				
-				// The 'originalRecord' contains all the values we need to sync to the cloud.
-				// But the 'sanitizedRecord' contains the proper system fields within the CKRecord internals
-				// that reflect the proper sync state we have with the server.
-				//
-				// Because the internal sync-state stuff is private, we cannot access it.
-				// So we copy the needed values from the originalRecord into a new CKRecord container
-				// that already has the updated sync-state fields.
-				
-				for (NSString *changedKey in [originalRecord changedKeys])
-				{
-					// Remember: nil is a valid value.
-					// It indicates removal of the value for the key, which is a valid action.
-					
-					id value = [originalRecord objectForKey:changedKey];
-					[mergedRecord setObject:value forKey:changedKey];
-				}
-				
-				pqChangeRecord.record = mergedRecord;
+				pqPrevChangeSet.hasChangesToModifiedRecords = YES;
+			}
+			
+			if (sanitizedRecord == nil)
+			{
+				sanitizedRecord = [record sanitizedCopy];
+			}
+			
+			YDBCKChangeRecord *pqChangeRecord = [pqPrevChangeSet->modifiedRecords objectForKey:recordID];
+			
+			CKRecord *originalRecord = pqChangeRecord.record;
+			CKRecord *mergedRecord = [sanitizedRecord safeCopy];
+			
+			// The 'originalRecord' contains all the values we need to sync to the cloud.
+			// But the 'sanitizedRecord' contains the proper system fields within the CKRecord internals
+			// that reflect the proper sync state we have with the server.
+			//
+			// Because the internal sync-state stuff is private, we cannot access it.
+			// So we copy the needed values from the originalRecord into a new CKRecord container
+			// that already has the updated sync-state fields.
+			
+			for (NSString *changedKey in [originalRecord changedKeys])
+			{
+				// Remember: nil is a valid value.
+				// It indicates removal of the value for the key, which is a valid action.
 				
-			} // end if ([mqPrevChangeSet->modifiedRecords objectForKey:recordID])
-		} // end if (CompareDatabaseIdentifiers(databaseIdentifier, mqPrevChangeSet.databaseIdentifier))
-		
-		i++;
-	} // end for (YDBCKChangeSet *mqPrevChangeSet in masterQueue->oldChangeSets)
+				id value = [originalRecord objectForKey:changedKey];
+				[mergedRecord setObject:value forKey:changedKey];
+			}
+			
+			pqChangeRecord.record = mergedRecord;
+			
+		} // end if ([mqPrevChangeSet->modifiedRecords objectForKey:recordID])
+	} // end for (YDBCKChangeSet *mqPrevChangeSet in indexedChangeSets)
 }
 
 /**
@@ -91,6 +91,8 @@ static NSString *const changeset_key_reset            = @"reset";
 	YapDatabaseCloudKitOptions *options;
 	
 	YDBCKChangeQueue *masterQueue;
+	
+	NSCache<NSString *, id> *systemFieldsCache; // hash -> @[ recordChangeTag, serialized system fields ]
 }
 
 - (NSString *)mappingTableName;
@@ -213,6 +215,9 @@ static NSString *const changeset_key_reset            = @"reset";
 	NSMutableArray *deletedRecordIDs;
 	
 	NSMutableDictionary<CKRecordID *, YDBCKChangeRecord *> *modifiedRecords;
+	
+	// Position within the masterQueue (consecutive for consecutive changeSets).
+	NSUInteger queueSequence;
 }
 
 - (instancetype)initWithUUID:(NSString *)uuid
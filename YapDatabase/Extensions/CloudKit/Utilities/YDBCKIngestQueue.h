@@ -0,0 +1,118 @@
+#import <Foundation/Foundation.h>
+#import <CloudKit/CloudKit.h>
+
+#import "YapDatabaseConnection.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Statistics reported by YDBCKIngestQueue once all records have been merged.
+**/
+@interface YDBCKIngestStatistics : NSObject
+
+/** The number of records that were merged. */
+@property (nonatomic, assign, readonly) NSUInteger recordCount;
+
+/** The number of readWrite transactions used to merge them. */
+@property (nonatomic, assign, readonly) NSUInteger batchCount;
+
+/** Time from the first enqueued record until the last batch was committed. */
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/** recordCount / duration */
+@property (nonatomic, assign, readonly) double recordsPerSecond;
+
+/**
+ * The most records that were held by the queue at any point (waiting to be merged, or being merged).
+ * This never exceeds maxQueuedRecords.
+**/
+@property (nonatomic, assign, readonly) NSUInteger peakQueuedRecords;
+
+/**
+ * The largest memory footprint of the process (in bytes), sampled after each batch was committed.
+ * This is 0 if it couldn't be determined.
+**/
+@property (nonatomic, assign, readonly) uint64_t peakMemoryFootprint;
+
+@end
+
+/**
+ * YDBCKIngestQueue merges a (potentially huge) stream of records pulled from the server,
+ * such as those delivered by CKFetchRecordZoneChangesOperation after being offline for a long time.
+ *
+ * Merging every record in a single transaction holds the write lock for a long time,
+ * and keeps every record (and every change) in memory until the commit.
+ * Merging every record in its own transaction is slow (a sync per commit),
+ * and floods the app with YapDatabaseModifiedNotifications.
+ *
+ * So the records flow through a bounded queue, and are merged in batches:
+ *
+ * - Each batch is merged (via -[YapDatabaseCloudKitTransaction mergeRecords:databaseIdentifier:])
+ *   in its own readWrite transaction, on a background queue.
+ * - These transactions use a coarse changeset (see YapDatabaseReadWriteTransaction.coarseChangeset).
+ * - If maxQueuedRecords are waiting to be merged, enqueueRecord: blocks until a batch has been committed.
+ *   So memory usage is bounded, no matter how many records are fetched.
+ *
+ * Important: The enqueueRecord: & finish... methods must NOT be invoked from within a transaction.
+**/
+@interface YDBCKIngestQueue : NSObject
+
+/**
+ * @param connection
+ *   The connection used to merge the records. It should be dedicated to this task.
+ *
+ * @param extensionName
+ *   The registered name of the YapDatabaseCloudKit extension.
+ *
+ * @param databaseIdentifier
+ *   The identifying string for the CKDatabase the records are fetched from.
+ *   @see YapDatabaseCloudKitDatabaseIdentifierBlock.
+**/
+- (instancetype)initWithConnection:(YapDatabaseConnection *)connection
+                     extensionName:(NSString *)extensionName
+                databaseIdentifier:(nullable NSString *)databaseIdentifier;
+
+@property (nonatomic, strong, readonly) YapDatabaseConnection *connection;
+@property (nonatomic, copy, readonly) NSString *extensionName;
+@property (nonatomic, copy, readonly, nullable) NSString *databaseIdentifier;
+
+/**
+ * The number of records merged per readWrite transaction.
+ *
+ * The default value is 500.
+ * This may only be changed before the first record is enqueued.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger batchSize;
+
+/**
+ * The maximum number of records held by the queue (waiting to be merged, or being merged).
+ * If the limit is reached, enqueueRecord: blocks until a batch has been committed.
+ *
+ * This value must be at least batchSize. (If it's less, batchSize is used instead.)
+ *
+ * The default value is 2000.
+ * This may only be changed before the first record is enqueued.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger maxQueuedRecords;
+
+/**
+ * Adds a record to the queue.
+ * It's merged once enough records have been enqueued to fill a batch (or when finish is invoked).
+ *
+ * This method is thread-safe.
+ * It blocks if maxQueuedRecords are waiting to be merged.
+**/
+- (void)enqueueRecord:(CKRecord *)record;
+
+/**
+ * Merges any remaining records, and then invokes the completionBlock with the statistics.
+ * No records may be enqueued afterwards.
+ *
+ * The completionQueue defaults to the main queue if nil.
+**/
+- (void)finishWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
+                  completionBlock:(void (^)(YDBCKIngestStatistics *statistics))completionBlock;
+
+@end
+
+NS_ASSUME_NONNULL_END
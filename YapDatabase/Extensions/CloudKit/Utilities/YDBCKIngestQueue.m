@@ -0,0 +1,348 @@
+#import "YDBCKIngestQueue.h"
+#import "YapDatabaseCloudKitTransaction.h"
+#import "YapDatabaseLogging.h"
+
+#import <mach/mach.h>
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+#define YDBCK_INGEST_DEFAULT_BATCH_SIZE         500
+#define YDBCK_INGEST_DEFAULT_MAX_QUEUED_RECORDS 2000
+
+/**
+ * Returns the memory footprint of the process (the figure reported by Xcode & used by jetsam), or 0 on error.
+**/
+static uint64_t YDBCKMemoryFootprint(void)
+{
+	task_vm_info_data_t info;
+	mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+	
+	kern_return_t result = task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count);
+	
+	return (result == KERN_SUCCESS) ? info.phys_footprint : 0;
+}
+
+@interface YDBCKIngestStatistics ()
+
+@property (nonatomic, assign, readwrite) NSUInteger recordCount;
+@property (nonatomic, assign, readwrite) NSUInteger batchCount;
+@property (nonatomic, assign, readwrite) NSTimeInterval duration;
+@property (nonatomic, assign, readwrite) NSUInteger peakQueuedRecords;
+@property (nonatomic, assign, readwrite) uint64_t peakMemoryFootprint;
+
+@end
+
+@implementation YDBCKIngestStatistics
+
+@synthesize recordCount = recordCount;
+@synthesize batchCount = batchCount;
+@synthesize duration = duration;
+@synthesize peakQueuedRecords = peakQueuedRecords;
+@synthesize peakMemoryFootprint = peakMemoryFootprint;
+
+@dynamic recordsPerSecond;
+
+- (double)recordsPerSecond
+{
+	return (duration > 0.0) ? ((double)recordCount / duration) : 0.0;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YDBCKIngestStatistics: records=%lu batches=%lu duration=%.3f records/sec=%.1f"
+	  @" peakQueuedRecords=%lu peakMemoryFootprint=%llu>",
+	  (unsigned long)recordCount, (unsigned long)batchCount, duration, self.recordsPerSecond,
+	  (unsigned long)peakQueuedRecords, peakMemoryFootprint];
+}
+
+@end
+
+#pragma mark -
+
+@implementation YDBCKIngestQueue
+{
+	dispatch_queue_t mergeQueue;
+	
+	NSLock *lock;
+	
+	// Protected by lock
+	
+	NSUInteger batchSize;
+	NSUInteger maxQueuedRecords;
+	
+	dispatch_semaphore_t capacitySemaphore; // created when the first record is enqueued
+	NSMutableArray<CKRecord *> *pendingRecords;
+	NSUInteger queuedRecordCount;
+	NSUInteger peakQueuedRecords;
+	CFAbsoluteTime startTime;
+	CFAbsoluteTime lastCommitTime;
+	BOOL finished;
+	
+	// Only accessed from within mergeQueue
+	
+	NSUInteger mergedRecordCount;
+	NSUInteger batchCount;
+	uint64_t peakMemoryFootprint;
+}
+
+@synthesize connection = connection;
+@synthesize extensionName = extensionName;
+@synthesize databaseIdentifier = databaseIdentifier;
+
+@dynamic batchSize;
+@dynamic maxQueuedRecords;
+
+- (instancetype)initWithConnection:(YapDatabaseConnection *)inConnection
+                     extensionName:(NSString *)inExtensionName
+                databaseIdentifier:(NSString *)inDatabaseIdentifier
+{
+	NSParameterAssert(inConnection != nil);
+	NSParameterAssert(inExtensionName != nil);
+	
+	if ((self = [super init]))
+	{
+		connection = inConnection;
+		extensionName = [inExtensionName copy];
+		databaseIdentifier = [inDatabaseIdentifier copy];
+		
+		mergeQueue = dispatch_queue_create("YDBCKIngestQueue", DISPATCH_QUEUE_SERIAL);
+		
+		lock = [[NSLock alloc] init];
+		
+		batchSize = YDBCK_INGEST_DEFAULT_BATCH_SIZE;
+		maxQueuedRecords = YDBCK_INGEST_DEFAULT_MAX_QUEUED_RECORDS;
+		
+		pendingRecords = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	// A semaphore must not be deallocated with a value lower than it was created with.
+	
+	if (capacitySemaphore && pendingRecords.count > 0)
+	{
+		YDBLogWarn(@"%@ - Deallocated with %lu records that were never merged (finish was never invoked)",
+		           THIS_METHOD, (unsigned long)pendingRecords.count);
+		
+		for (NSUInteger i = 0; i < pendingRecords.count; i++)
+		{
+			dispatch_semaphore_signal(capacitySemaphore);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Configuration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)batchSize
+{
+	[lock lock];
+	NSUInteger result = batchSize;
+	[lock unlock];
+	
+	return result;
+}
+
+- (void)setBatchSize:(NSUInteger)newBatchSize
+{
+	[lock lock];
+	
+	if (capacitySemaphore)
+		YDBLogWarn(@"%@ - Ignored: records have already been enqueued", THIS_METHOD);
+	else
+		batchSize = MAX(newBatchSize, (NSUInteger)1);
+	
+	[lock unlock];
+}
+
+- (NSUInteger)maxQueuedRecords
+{
+	[lock lock];
+	NSUInteger result = maxQueuedRecords;
+	[lock unlock];
+	
+	return result;
+}
+
+- (void)setMaxQueuedRecords:(NSUInteger)newMaxQueuedRecords
+{
+	[lock lock];
+	
+	if (capacitySemaphore)
+		YDBLogWarn(@"%@ - Ignored: records have already been enqueued", THIS_METHOD);
+	else
+		maxQueuedRecords = newMaxQueuedRecords;
+	
+	[lock unlock];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Ingest
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)enqueueRecord:(CKRecord *)record
+{
+	if (record == nil) return;
+	
+	[lock lock];
+	
+	if (finished)
+	{
+		[lock unlock];
+		
+		YDBLogWarn(@"%@ - Ignored: the queue has already been finished", THIS_METHOD);
+		return;
+	}
+	
+	if (capacitySemaphore == nil)
+	{
+		capacitySemaphore = dispatch_semaphore_create((long)MAX(maxQueuedRecords, batchSize));
+		startTime = CFAbsoluteTimeGetCurrent();
+	}
+	
+	dispatch_semaphore_t semaphore = capacitySemaphore;
+	
+	[lock unlock];
+	
+	// Back-pressure: wait until there's room in the queue.
+	
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+	
+	NSArray<CKRecord *> *batch = nil;
+	
+	[lock lock];
+	{
+		[pendingRecords addObject:record];
+		
+		queuedRecordCount++;
+		peakQueuedRecords = MAX(peakQueuedRecords, queuedRecordCount);
+		
+		if (pendingRecords.count >= batchSize)
+		{
+			batch = [pendingRecords copy];
+			[pendingRecords removeAllObjects];
+		}
+	}
+	[lock unlock];
+	
+	if (batch) {
+		[self mergeBatch:batch semaphore:semaphore];
+	}
+}
+
+- (void)finishWithCompletionQueue:(dispatch_queue_t)completionQueue
+                  completionBlock:(void (^)(YDBCKIngestStatistics *statistics))completionBlock
+{
+	NSArray<CKRecord *> *batch = nil;
+	dispatch_semaphore_t semaphore = nil;
+	
+	[lock lock];
+	{
+		finished = YES;
+		
+		if (pendingRecords.count > 0)
+		{
+			batch = [pendingRecords copy];
+			[pendingRecords removeAllObjects];
+		}
+		
+		semaphore = capacitySemaphore;
+	}
+	[lock unlock];
+	
+	if (batch) {
+		[self mergeBatch:batch semaphore:semaphore];
+	}
+	
+	if (completionQueue == NULL)
+		completionQueue = dispatch_get_main_queue();
+	
+	dispatch_async(mergeQueue, ^{ @autoreleasepool {
+	
+		YDBCKIngestStatistics *statistics = [[YDBCKIngestStatistics alloc] init];
+		
+		[self->lock lock];
+		{
+			statistics.peakQueuedRecords = self->peakQueuedRecords;
+			
+			if (self->startTime > 0 && self->lastCommitTime > self->startTime)
+				statistics.duration = self->lastCommitTime - self->startTime;
+		}
+		[self->lock unlock];
+		
+		statistics.recordCount = self->mergedRecordCount;
+		statistics.batchCount = self->batchCount;
+		statistics.peakMemoryFootprint = self->peakMemoryFootprint;
+		
+		YDBLogInfo(@"Ingest finished: %@", statistics);
+		
+		if (completionBlock)
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+			
+				completionBlock(statistics);
+			}});
+		}
+	}});
+}
+
+/**
+ * Merges the batch (in its own transaction) on the mergeQueue,
+ * and then makes room in the queue for the same number of records.
+**/
+- (void)mergeBatch:(NSArray<CKRecord *> *)batch semaphore:(dispatch_semaphore_t)semaphore
+{
+	dispatch_async(mergeQueue, ^{ @autoreleasepool {
+	
+		__block uint64_t footprint = 0;
+		
+		[self->connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+			transaction.coarseChangeset = YES;
+			
+			YapDatabaseCloudKitTransaction *ckTransaction = [transaction ext:self->extensionName];
+			if (ckTransaction)
+			{
+				[ckTransaction mergeRecords:batch databaseIdentifier:self->databaseIdentifier];
+			}
+			else
+			{
+				YDBLogError(@"%@ - Extension not registered: %@", THIS_METHOD, self->extensionName);
+			}
+			
+			// Sampled before the commit, while the changes of the batch are still held in memory.
+			footprint = YDBCKMemoryFootprint();
+		}];
+		
+		self->mergedRecordCount += batch.count;
+		self->batchCount++;
+		self->peakMemoryFootprint = MAX(self->peakMemoryFootprint, footprint);
+		
+		[self->lock lock];
+		{
+			self->queuedRecordCount -= batch.count;
+			self->lastCommitTime = CFAbsoluteTimeGetCurrent();
+		}
+		[self->lock unlock];
+		
+		for (NSUInteger i = 0; i < batch.count; i++)
+		{
+			dispatch_semaphore_signal(semaphore);
+		}
+	}});
+}
+
+@end
@@ -35,6 +35,20 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 + (NSData *)serializeRecord:(CKRecord *)record;
 
+/**
+ * Same as serializeRecord:, but first checks the given cache for the serialized system fields.
+ *
+ * The cache is keyed by the given key (which must uniquely identify the recordID, e.g. the recordTable hash),
+ * and each entry is validated by the record's recordChangeTag.
+ * The system fields only change when the server assigns a new recordChangeTag,
+ * so a record with the same recordChangeTag as the cached entry doesn't need to be encoded again.
+ *
+ * Records without a recordChangeTag (never saved to the server) are not cached.
+**/
++ (NSData *)serializeRecord:(CKRecord *)record
+                      cache:(nullable NSCache<NSString *, id> *)cache
+                        key:(nullable NSString *)key;
+
 /**
  * Deserialize the given record data.
  *
@@ -124,6 +124,34 @@
 	return [NSKeyedArchiver archivedDataWithRootObject:recordWrapper];
 }
 
+/**
+ * See header file for documentation.
+**/
++ (NSData *)serializeRecord:(CKRecord *)record cache:(NSCache *)cache key:(NSString *)key
+{
+	if (record == nil) return nil;
+	
+	NSString *changeTag = record.recordChangeTag;
+	
+	if (cache == nil || key == nil || changeTag == nil) {
+		return [self serializeRecord:record];
+	}
+	
+	NSArray *entry = [cache objectForKey:key]; // @[ recordChangeTag, systemFields ]
+	if (entry && [entry[0] isEqualToString:changeTag])
+	{
+		return entry[1];
+	}
+	
+	NSData *data = [self serializeRecord:record];
+	if (data)
+	{
+		[cache setObject:@[ changeTag, data ] forKey:key cost:data.length];
+	}
+	
+	return data;
+}
+
 /**
  * Deserialized the given record data.
  *
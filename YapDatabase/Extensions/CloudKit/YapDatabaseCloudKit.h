@@ -12,6 +12,7 @@
 #import "YDBCKMergeInfo.h"
 #import "YDBCKRecordInfo.h"
 #import "YDBCKRecord.h"
+#import "YDBCKIngestQueue.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -208,6 +209,24 @@ extern NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification;
 - (void)getNumberOfInFlightChangeSets:(NSUInteger *)numInFlightChangeSetsPtr
                      queuedChangeSets:(NSUInteger *)numQueuedChangeSetsPtr;
 
+/**
+ * The number of records (modified CKRecords & deleted CKRecordIDs) held in memory by the change-sets.
+ * Useful for monitoring the queue after a long offline period.
+ *
+ * - numInFlightRecords:
+ *     Records within the inFlight change-set.
+ *
+ * - numQueuedRecords:
+ *     Records within the queued change-sets.
+ *
+ * - numIndexedRecords:
+ *     Distinct records across all change-sets.
+ *     (If the same record is modified in multiple change-sets, it's only counted once.)
+**/
+- (void)getNumberOfInFlightRecords:(NSUInteger *)numInFlightRecordsPtr
+                     queuedRecords:(NSUInteger *)numQueuedRecordsPtr
+                    indexedRecords:(NSUInteger *)numIndexedRecordsPtr;
+
 @end
 
 NS_ASSUME_NONNULL_END
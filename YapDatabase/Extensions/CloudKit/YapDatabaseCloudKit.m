@@ -17,6 +17,177 @@
 NSString *const YapDatabaseCloudKitSuspendCountChangedNotification = @"YDBCK_SuspendCountChanged";
 NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBCK_InFlightChangeSetChanged";
 
+/**
+ * Rough estimates of the upload size of records & recordIDs.
+ * Used to split a changeSet into batches that fit within options.maxBytesPerOperation.
+**/
+static NSUInteger YDBCKEstimatedSizeOfValue(id value)
+{
+	if ([value isKindOfClass:[NSString class]])
+		return [(NSString *)value lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+	
+	if ([value isKindOfClass:[NSData class]])
+		return [(NSData *)value length];
+	
+	if ([value isKindOfClass:[NSArray class]])
+	{
+		NSUInteger size = 0;
+		for (id item in (NSArray *)value)
+		{
+			size += YDBCKEstimatedSizeOfValue(item);
+		}
+		return size;
+	}
+	
+	if ([value isKindOfClass:[CKReference class]])
+		return 64 + [[[(CKReference *)value recordID] recordName] lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+	
+	// NSNumber, NSDate, CLLocation, CKAsset (the file itself is uploaded separately)
+	return 64;
+}
+
+static NSUInteger YDBCKEstimatedSizeOfRecordID(CKRecordID *recordID)
+{
+	return 128 + [recordID.recordName lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+}
+
+static NSUInteger YDBCKEstimatedSizeOfRecord(CKRecord *record)
+{
+	NSUInteger size = YDBCKEstimatedSizeOfRecordID(record.recordID) + 256; // system fields, recordType, etc
+	
+	for (NSString *key in [record allKeys])
+	{
+		size += [key lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+		size += YDBCKEstimatedSizeOfValue([record objectForKey:key]);
+	}
+	
+	return size;
+}
+
+/**
+ * Tracks the batches (CKModifyRecordsOperations) of a single in-flight changeSet,
+ * and aggregates their results, so the changeSet can be completed once every batch has finished.
+**/
+@interface YDBCKModifyRecordsBatches : NSObject
+
+- (instancetype)initWithChangeSet:(YDBCKChangeSet *)changeSet;
+
+@property (nonatomic, strong, readonly) YDBCKChangeSet *changeSet;
+
+@property (nonatomic, strong, readonly) NSArray *savedRecords;
+@property (nonatomic, strong, readonly) NSArray *deletedRecordIDs;
+
+/**
+ * The first (non-partial) error, if any.
+ * Otherwise a CKErrorPartialFailure error, with the partialErrorsByItemID of every batch, if any.
+**/
+@property (nonatomic, strong, readonly) NSError *error;
+
+- (void)addPendingBatches:(NSUInteger)count;
+
+/**
+ * The given records should only include those that succeeded.
+ * Returns YES if this was the last pending batch.
+**/
+- (BOOL)completeBatchWithSavedRecords:(NSArray *)savedRecords
+                     deletedRecordIDs:(NSArray *)deletedRecordIDs
+                                error:(NSError *)error;
+
+@end
+
+@implementation YDBCKModifyRecordsBatches
+{
+	YAPUnfairLock lock;
+	NSUInteger pendingCount;
+	
+	NSMutableArray *savedRecords;
+	NSMutableArray *deletedRecordIDs;
+	
+	NSError *firstError;
+	NSError *firstPartialError;
+	NSMutableDictionary *partialErrorsByItemID;
+}
+
+@synthesize changeSet = changeSet;
+
+- (instancetype)initWithChangeSet:(YDBCKChangeSet *)inChangeSet
+{
+	if ((self = [super init]))
+	{
+		changeSet = inChangeSet;
+		lock = YAP_UNFAIR_LOCK_INIT;
+		
+		savedRecords = [[NSMutableArray alloc] init];
+		deletedRecordIDs = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (void)addPendingBatches:(NSUInteger)count
+{
+	YAPUnfairLockLock(&lock);
+	{
+		pendingCount += count;
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
+- (BOOL)completeBatchWithSavedRecords:(NSArray *)inSavedRecords
+                     deletedRecordIDs:(NSArray *)inDeletedRecordIDs
+                                error:(NSError *)error
+{
+	BOOL isLast = NO;
+	
+	YAPUnfairLockLock(&lock);
+	{
+		if (inSavedRecords) [savedRecords addObjectsFromArray:inSavedRecords];
+		if (inDeletedRecordIDs) [deletedRecordIDs addObjectsFromArray:inDeletedRecordIDs];
+		
+		if (error.code == CKErrorPartialFailure)
+		{
+			if (firstPartialError == nil)
+				firstPartialError = error;
+			
+			if (partialErrorsByItemID == nil)
+				partialErrorsByItemID = [[NSMutableDictionary alloc] init];
+			
+			NSDictionary *batchErrors = [error.userInfo objectForKey:CKPartialErrorsByItemIDKey];
+			if (batchErrors) [partialErrorsByItemID addEntriesFromDictionary:batchErrors];
+		}
+		else if (error && (firstError == nil))
+		{
+			firstError = error;
+		}
+		
+		pendingCount--;
+		isLast = (pendingCount == 0);
+	}
+	YAPUnfairLockUnlock(&lock);
+	
+	return isLast;
+}
+
+- (NSArray *)savedRecords {
+	return savedRecords;
+}
+
+- (NSArray *)deletedRecordIDs {
+	return deletedRecordIDs;
+}
+
+- (NSError *)error
+{
+	if (firstError) return firstError;
+	if (firstPartialError == nil) return nil;
+	
+	NSMutableDictionary *userInfo = [firstPartialError.userInfo mutableCopy];
+	userInfo[CKPartialErrorsByItemIDKey] = [partialErrorsByItemID copy];
+	
+	return [NSError errorWithDomain:firstPartialError.domain code:firstPartialError.code userInfo:userInfo];
+}
+
+@end
+
 @implementation YapDatabaseCloudKit
 {
 	NSUInteger suspendCount;
@@ -164,8 +335,11 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 		
 		masterQueue = [[YDBCKChangeQueue alloc] initMasterQueue];
 		
+		systemFieldsCache = [[NSCache alloc] init];
+		systemFieldsCache.totalCostLimit = 8 * 1024 * 1024;
+		
 		masterOperationQueue = [[NSOperationQueue alloc] init];
-		masterOperationQueue.maxConcurrentOperationCount = 1;
+		masterOperationQueue.maxConcurrentOperationCount = MAX(options.maxConcurrentOperationCount, (NSUInteger)1);
 		
 		suspendCountLock = YAP_UNFAIR_LOCK_INIT;
 	}
@@ -417,6 +591,14 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 	return [masterQueue getNumberOfInFlightChangeSets:numInFlightChangeSetsPtr
 	                                 queuedChangeSets:numQueuedChangeSetsPtr];
 }
+- (void)getNumberOfInFlightRecords:(NSUInteger *)numInFlightRecordsPtr
+                     queuedRecords:(NSUInteger *)numQueuedRecordsPtr
+                    indexedRecords:(NSUInteger *)numIndexedRecordsPtr
+{
+	return [masterQueue getNumberOfInFlightRecords:numInFlightRecordsPtr
+	                                 queuedRecords:numQueuedRecordsPtr
+	                                indexedRecords:numIndexedRecordsPtr];
+}
 
 - (void)postInFlightChangeSetChangedNotification:(NSString *)newChangeSetUUID
 {
@@ -593,12 +775,74 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 	}
 }
 
+/**
+ * Splits the given records & recordIDs into batches that fit within
+ * options.maxRecordsPerOperation & options.maxBytesPerOperation.
+ *
+ * Each batch is an array of the form @[recordsToSave, recordIDsToDelete].
+**/
+- (NSArray *)batchesWithRecordsToSave:(NSArray *)recordsToSave recordIDsToDelete:(NSArray *)recordIDsToDelete
+{
+	NSUInteger maxCount = options.maxRecordsPerOperation;
+	NSUInteger maxBytes = options.maxBytesPerOperation;
+	
+	if (maxCount == 0) maxCount = NSUIntegerMax;
+	if (maxBytes == 0) maxBytes = NSUIntegerMax;
+	
+	NSUInteger totalCount = recordsToSave.count + recordIDsToDelete.count;
+	
+	if (totalCount <= 1 || (totalCount <= maxCount && maxBytes == NSUIntegerMax))
+	{
+		return @[ @[ (recordsToSave ?: @[]), (recordIDsToDelete ?: @[]) ] ];
+	}
+	
+	NSMutableArray *batches = [NSMutableArray arrayWithCapacity:((totalCount / maxCount) + 1)];
+	
+	__block NSMutableArray *batch_recordsToSave = [NSMutableArray array];
+	__block NSMutableArray *batch_recordIDsToDelete = [NSMutableArray array];
+	__block NSUInteger batch_bytes = 0;
+	
+	void (^addToBatch)(id, NSUInteger, BOOL) = ^(id item, NSUInteger size, BOOL isRecord){
+		
+		NSUInteger batchCount = batch_recordsToSave.count + batch_recordIDsToDelete.count;
+		if ((batchCount > 0) && ((batchCount >= maxCount) || (size > (maxBytes - MIN(batch_bytes, maxBytes)))))
+		{
+			[batches addObject:@[ batch_recordsToSave, batch_recordIDsToDelete ]];
+			
+			batch_recordsToSave = [NSMutableArray array];
+			batch_recordIDsToDelete = [NSMutableArray array];
+			batch_bytes = 0;
+		}
+		
+		if (isRecord)
+			[batch_recordsToSave addObject:item];
+		else
+			[batch_recordIDsToDelete addObject:item];
+		
+		batch_bytes += size;
+	};
+	
+	for (CKRecord *record in recordsToSave)
+	{
+		addToBatch(record, YDBCKEstimatedSizeOfRecord(record), YES);
+	}
+	for (CKRecordID *recordID in recordIDsToDelete)
+	{
+		addToBatch(recordID, YDBCKEstimatedSizeOfRecordID(recordID), NO);
+	}
+	
+	if (batch_recordsToSave.count > 0 || batch_recordIDsToDelete.count > 0)
+	{
+		[batches addObject:@[ batch_recordsToSave, batch_recordIDsToDelete ]];
+	}
+	
+	return batches;
+}
+
 - (void)queueOperationForChangeSet:(YDBCKChangeSet *)changeSet
 {
 	YDBLogAutoTrace();
 	
-	CKDatabase *database = [self databaseForIdentifier:changeSet.databaseIdentifier];
-	
 	NSArray *recordsToSave = changeSet.recordsToSave_noCopy;
 	NSArray *recordIDsToDelete = changeSet.recordIDsToDelete;
 	
@@ -607,6 +851,32 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 				  @"  recordIDsToDelete: %@",
 				  changeSet.databaseIdentifier, recordsToSave, recordIDsToDelete);
 	
+	NSArray *batches = [self batchesWithRecordsToSave:recordsToSave recordIDsToDelete:recordIDsToDelete];
+	
+	if (batches.count > 1)
+	{
+		YDBLogVerbose(@"CKModifyRecordsOperation: databaseIdentifier = %@: split into %lu batches",
+		              changeSet.databaseIdentifier, (unsigned long)batches.count);
+	}
+	
+	YDBCKModifyRecordsBatches *tracker = [[YDBCKModifyRecordsBatches alloc] initWithChangeSet:changeSet];
+	[tracker addPendingBatches:batches.count];
+	
+	CKDatabase *database = [self databaseForIdentifier:changeSet.databaseIdentifier];
+	
+	for (NSArray *batch in batches)
+	{
+		[self queueOperationForBatch:batch database:database tracker:tracker];
+	}
+}
+
+- (void)queueOperationForBatch:(NSArray *)batch
+                      database:(CKDatabase *)database
+                       tracker:(YDBCKModifyRecordsBatches *)tracker
+{
+	NSArray *recordsToSave = batch[0];
+	NSArray *recordIDsToDelete = batch[1];
+	
 	CKModifyRecordsOperation *modifyRecordsOperation =
 	  [[CKModifyRecordsOperation alloc] initWithRecordsToSave:recordsToSave recordIDsToDelete:recordIDsToDelete];
 	modifyRecordsOperation.database = database;
@@ -623,25 +893,58 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 		__strong YapDatabaseCloudKit *strongSelf = weakSelf;
 		if (strongSelf == nil) return;
 		
+		YDBCKChangeSet *changeSet = tracker.changeSet;
+		
 		if (operationError)
 		{
+			NSUInteger batchCount = recordsToSave.count + recordIDsToDelete.count;
+			
+			if (operationError.code == CKErrorLimitExceeded && batchCount > 1)
+			{
+				// The batch was too big for the server (our size estimate was too low).
+				// Split it in half, and try again.
+				
+				YDBLogInfo(@"CKModifyRecordsOperation limit exceeded: databaseIdentifier = %@: splitting batch of %lu",
+				           changeSet.databaseIdentifier, (unsigned long)batchCount);
+				
+				NSArray *halves = [strongSelf halvesOfBatch:batch];
+				
+				[tracker addPendingBatches:halves.count];
+				for (NSArray *half in halves)
+				{
+					[strongSelf queueOperationForBatch:half database:database tracker:tracker];
+				}
+				
+				if ([tracker completeBatchWithSavedRecords:nil deletedRecordIDs:nil error:nil]) {
+					[strongSelf handleCompletedBatches:tracker];
+				}
+				return;
+			}
+			
 			if (operationError.code == CKErrorPartialFailure)
 			{
 				YDBLogInfo(@"CKModifyRecordsOperation partial error: databaseIdentifier = %@\n"
 				           @"  error = %@", changeSet.databaseIdentifier, operationError);
 				
-				[strongSelf handlePartiallyFailedOperationWithChangeSet:changeSet
-				                                           savedRecords:savedRecords
-				                                       deletedRecordIDs:deletedRecordIDs
-				                                                  error:operationError];
+				NSArray *success_savedRecords = nil;
+				NSArray *success_deletedRecordIDs = nil;
+				
+				[strongSelf getSuccessfulSavedRecords:&success_savedRecords
+				                     deletedRecordIDs:&success_deletedRecordIDs
+				            fromAttemptedSavedRecords:savedRecords
+				                     deletedRecordIDs:deletedRecordIDs
+				                                error:operationError];
+				
+				savedRecords = success_savedRecords;
+				deletedRecordIDs = success_deletedRecordIDs;
 			}
 			else
 			{
 				YDBLogInfo(@"CKModifyRecordsOperation error: databaseIdentifier = %@\n"
 				           @"  error = %@", changeSet.databaseIdentifier, operationError);
 				
-				[strongSelf handleFailedOperationWithChangeSet:changeSet
-				                                         error:operationError];
+				savedRecords = nil;
+				deletedRecordIDs = nil;
 			}
 		}
 		else
@@ -650,10 +953,11 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 			              @"  savedRecords: %@\n"
 			              @"  deletedRecordIDs: %@",
 			              changeSet.databaseIdentifier, savedRecords, deletedRecordIDs);
-			
-			[strongSelf handleCompletedOperationWithChangeSet:changeSet
-			                                     savedRecords:savedRecords
-			                                 deletedRecordIDs:deletedRecordIDs];
+		}
+		
+		if ([tracker completeBatchWithSavedRecords:savedRecords deletedRecordIDs:deletedRecordIDs error:operationError])
+		{
+			[strongSelf handleCompletedBatches:tracker];
 		}
 		
 	#pragma clang diagnostic pop
@@ -662,6 +966,64 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 	[masterOperationQueue addOperation:modifyRecordsOperation];
 }
 
+/**
+ * Splits a batch (of at least 2 items) into 2 batches of (roughly) the same count.
+**/
+- (NSArray *)halvesOfBatch:(NSArray *)batch
+{
+	NSArray *recordsToSave = batch[0];
+	NSArray *recordIDsToDelete = batch[1];
+	
+	NSUInteger sCount = recordsToSave.count;
+	NSUInteger dCount = recordIDsToDelete.count;
+	NSUInteger half = (sCount + dCount) / 2;
+	
+	NSArray *first, *second;
+	if (half <= sCount)
+	{
+		first  = @[ [recordsToSave subarrayWithRange:NSMakeRange(0, half)], @[] ];
+		second = @[ [recordsToSave subarrayWithRange:NSMakeRange(half, sCount - half)], recordIDsToDelete ];
+	}
+	else
+	{
+		NSUInteger dHalf = half - sCount;
+		
+		first  = @[ recordsToSave, [recordIDsToDelete subarrayWithRange:NSMakeRange(0, dHalf)] ];
+		second = @[ @[], [recordIDsToDelete subarrayWithRange:NSMakeRange(dHalf, dCount - dHalf)] ];
+	}
+	
+	return @[ first, second ];
+}
+
+/**
+ * Invoked after every batch of the in-flight changeSet has finished.
+**/
+- (void)handleCompletedBatches:(YDBCKModifyRecordsBatches *)tracker
+{
+	YDBCKChangeSet *changeSet = tracker.changeSet;
+	NSError *operationError = tracker.error;
+	
+	if (operationError == nil)
+	{
+		[self handleCompletedOperationWithChangeSet:changeSet
+		                               savedRecords:tracker.savedRecords
+		                           deletedRecordIDs:tracker.deletedRecordIDs];
+	}
+	else if (tracker.savedRecords.count > 0 || tracker.deletedRecordIDs.count > 0 ||
+	         operationError.code == CKErrorPartialFailure)
+	{
+		[self handlePartiallyFailedOperationWithChangeSet:changeSet
+		                                     savedRecords:tracker.savedRecords
+		                                 deletedRecordIDs:tracker.deletedRecordIDs
+		                                            error:operationError];
+	}
+	else
+	{
+		[self handleFailedOperationWithChangeSet:changeSet
+		                                   error:operationError];
+	}
+}
+
 - (void)handleFailedOperationWithChangeSet:(YDBCKChangeSet *)changeSet
                                      error:(NSError *)operationError
 {
@@ -693,16 +1055,15 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 	});
 }
 
-- (void)handlePartiallyFailedOperationWithChangeSet:(YDBCKChangeSet *)changeSet
-                                       savedRecords:(NSArray *)attempted_savedRecords
-                                   deletedRecordIDs:(NSArray *)attempted_deletedRecordIDs
-                                              error:(NSError *)operationError
+/**
+ * Removes the items that failed (according to the CKPartialErrorsByItemIDKey of the error) from the attempted items.
+**/
+- (void)getSuccessfulSavedRecords:(NSArray **)savedRecordsPtr
+                 deletedRecordIDs:(NSArray **)deletedRecordIDsPtr
+        fromAttemptedSavedRecords:(NSArray *)attempted_savedRecords
+                 deletedRecordIDs:(NSArray *)attempted_deletedRecordIDs
+                            error:(NSError *)operationError
 {
-	// First, we suspend ourself.
-	// It is the responsibility of the delegate to resume us at the appropriate time.
-	
-	[self suspend];
-	
 	// We need to figure out what succeeded.
 	// So first we get a set of the recordIDs that failed.
 	
@@ -740,6 +1101,23 @@ NSString *const YapDatabaseCloudKitInFlightChangeSetChangedNotification = @"YDBC
 		}
 	}
 	
+	if (savedRecordsPtr) *savedRecordsPtr = success_savedRecords;
+	if (deletedRecordIDsPtr) *deletedRecordIDsPtr = success_deletedRecordIDs;
+}
+
+/**
+ * The given savedRecords & deletedRecordIDs are those that succeeded (from every batch of the changeSet).
+**/
+- (void)handlePartiallyFailedOperationWithChangeSet:(YDBCKChangeSet *)changeSet
+                                       savedRecords:(NSArray *)success_savedRecords
+                                   deletedRecordIDs:(NSArray *)success_deletedRecordIDs
+                                              error:(NSError *)operationError
+{
+	// First, we suspend ourself.
+	// It is the responsibility of the delegate to resume us at the appropriate time.
+	
+	[self suspend];
+	
 	// Start the database transaction to update the queue(s) by removing those items that have succeeded.
 	
 	NSString *extName = self.registeredName;
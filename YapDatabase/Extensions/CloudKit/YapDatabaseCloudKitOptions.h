@@ -27,6 +27,33 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, strong, readwrite, nullable) YapWhitelistBlacklist *allowedCollections;
 
+/**
+ * A changeSet is uploaded via one or more CKModifyRecordsOperation(s).
+ * If a changeSet exceeds either of the following budgets, it's automatically split into multiple batches,
+ * and the changeSet is only considered complete once every batch has completed.
+ *
+ * The size of a batch is an estimate, based on the values of the records (assets are uploaded separately).
+ * If CloudKit rejects a batch anyways (CKErrorLimitExceeded), the batch is split in half and retried.
+ *
+ * A value of zero means no limit.
+ *
+ * The default maxRecordsPerOperation is 400 (the CloudKit limit).
+ * The default maxBytesPerOperation is 1 MB.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger maxRecordsPerOperation;
+@property (nonatomic, assign, readwrite) NSUInteger maxBytesPerOperation;
+
+/**
+ * The number of batches (of the same changeSet) that may be in-flight at the same time.
+ *
+ * The batches of a changeSet never conflict with each other (every record appears only once within a changeSet),
+ * and the next changeSet isn't started until every batch of the previous changeSet has completed.
+ * So this only affects changeSets that are split into multiple batches.
+ *
+ * The default value is 2.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger maxConcurrentOperationCount;
+
 
 // Todo: Need ability to set default options for CKModifyRecordsOperation
 
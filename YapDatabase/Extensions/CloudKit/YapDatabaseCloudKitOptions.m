@@ -3,11 +3,28 @@
 @implementation YapDatabaseCloudKitOptions
 
 @synthesize allowedCollections = allowedCollections;
+@synthesize maxRecordsPerOperation = maxRecordsPerOperation;
+@synthesize maxBytesPerOperation = maxBytesPerOperation;
+@synthesize maxConcurrentOperationCount = maxConcurrentOperationCount;
+
+- (id)init
+{
+	if ((self = [super init]))
+	{
+		maxRecordsPerOperation = 400;
+		maxBytesPerOperation = 1024 * 1024;
+		maxConcurrentOperationCount = 2;
+	}
+	return self;
+}
 
 - (id)copyWithZone:(NSZone *)zone
 {
 	YapDatabaseCloudKitOptions *copy = [[[self class] alloc] init]; // [self class] required to support subclassing
 	copy->allowedCollections = allowedCollections;
+	copy->maxRecordsPerOperation = maxRecordsPerOperation;
+	copy->maxBytesPerOperation = maxBytesPerOperation;
+	copy->maxConcurrentOperationCount = maxConcurrentOperationCount;
 	
 	return copy;
 }
@@ -314,6 +314,10 @@ NS_ASSUME_NONNULL_BEGIN
  * 
  * Thus, you should use this method, which will invoke your mergeBlock with the appropriate parameters.
  * 
+ * If the remoteRecord has the same recordChangeTag as the record we already have,
+ * and there are no pending changes for the record, then the mergeBlock is NOT invoked.
+ * (We already have this version of the record, so there's nothing to merge.)
+ * 
  * @param remoteRecord
  *   A record that was modified remotely, and discovered via CKFetchRecordChangesOperation (or similar).
  *   This value will be passed as the remoteRecord parameter to the mergeBlock.
@@ -327,6 +331,20 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (void)mergeRecord:(CKRecord *)remoteRecord databaseIdentifier:(nullable NSString *)databaseIdentifer;
 
+/**
+ * Merges a batch of pulled records, in the given order.
+ * 
+ * This is equivalent to invoking mergeRecord:databaseIdentifier: for each record (the mergeBlock is invoked the same way),
+ * but the queue of pending changes is checked once for the entire batch, rather than once per record.
+ * It's designed for large fetches (e.g. catching up after being offline for a long time).
+ * 
+ * @see YDBCKIngestQueue
+ * 
+ * Important: This method only works if within a readWriteTrasaction.
+ * Invoking this method from within a read-only transaction will throw an exception.
+**/
+- (void)mergeRecords:(NSArray<CKRecord *> *)remoteRecords databaseIdentifier:(nullable NSString *)databaseIdentifier;
+
 /**
  * This method allows you to manually modify a CKRecord.
  * 
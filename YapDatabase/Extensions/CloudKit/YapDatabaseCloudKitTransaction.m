@@ -2103,7 +2103,9 @@ static BOOL ClassVersionsAreCompatible(int oldClassVersion, int newClassVersion)
 	sqlite3_bind_int64(statement, bind_idx_ownerCount, dirtyRecordTableInfo.dirty_ownerCount);
 	
 	__attribute__((objc_precise_lifetime)) NSData *recordBlob =
-	  [YDBCKRecord serializeRecord:dirtyRecordTableInfo.dirty_record];
+	  [YDBCKRecord serializeRecord:dirtyRecordTableInfo.dirty_record
+	                         cache:parentConnection->parent->systemFieldsCache
+	                           key:hash];
 	sqlite3_bind_blob(statement, bind_idx_record, recordBlob.bytes, (int)recordBlob.length, SQLITE_STATIC);
 	
 	int status = sqlite3_step(statement);
@@ -2196,7 +2198,10 @@ static BOOL ClassVersionsAreCompatible(int oldClassVersion, int newClassVersion)
 	int const bind_idx_record = SQLITE_BIND_START + 0;
 	int const bind_idx_hash   = SQLITE_BIND_START + 1;
 	
-	__attribute__((objc_precise_lifetime)) NSData *recordBlob = [YDBCKRecord serializeRecord:record];
+	__attribute__((objc_precise_lifetime)) NSData *recordBlob =
+	  [YDBCKRecord serializeRecord:record
+	                         cache:parentConnection->parent->systemFieldsCache
+	                           key:hash];
 	sqlite3_bind_blob(statement, bind_idx_record, recordBlob.bytes, (int)recordBlob.length, SQLITE_STATIC);
 	
 	YapDatabaseString _hash; MakeYapDatabaseString(&_hash, hash);
@@ -3205,7 +3210,7 @@ static BOOL ClassVersionsAreCompatible(int oldClassVersion, int newClassVersion)
 	
 	YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -3894,6 +3899,10 @@ static BOOL ClassVersionsAreCompatible(int oldClassVersion, int newClassVersion)
  *
  * Thus, you should use this method, which will invoke your mergeBlock with the appropriate parameters.
  *
+ * If the remoteRecord has the same recordChangeTag as the record we already have,
+ * and there are no pending changes for the record, then the mergeBlock is NOT invoked.
+ * (We already have this version of the record, so there's nothing to merge.)
+ *
  * @param remoteRecord
  *   A record that was modified remotely, and discovered via CKFetchRecordChangesOperation (or similar).
  *   This value will be passed as the remoteRecord parameter to the mergeBlock.
@@ -3922,6 +3931,64 @@ static BOOL ClassVersionsAreCompatible(int oldClassVersion, int newClassVersion)
 		return;
 	}
 	
+	[self mergeRecord:remoteRecord databaseIdentifier:databaseIdentifier pendingModifications:nil pendingDeletes:nil];
+}
+
+/**
+ * Merges many records pulled from the server, in the given order.
+ * This is equivalent to invoking mergeRecord:databaseIdentifier: for each record,
+ * but checks the queue for pending changes once for the entire batch.
+ *
+ * Important: This method only works if within a readWriteTrasaction.
+ * Invoking this method from within a read-only transaction will throw an exception.
+**/
+- (void)mergeRecords:(NSArray<CKRecord *> *)remoteRecords databaseIdentifier:(NSString *)databaseIdentifier
+{
+	YDBLogAutoTrace();
+	
+	// Proper API usage check
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		@throw [self requiresReadWriteTransactionException:NSStringFromSelector(_cmd)];
+		return;
+	}
+	
+	if (remoteRecords.count == 0) return;
+	
+	NSMutableArray<CKRecordID *> *recordIDs = [NSMutableArray arrayWithCapacity:remoteRecords.count];
+	for (CKRecord *remoteRecord in remoteRecords)
+	{
+		[recordIDs addObject:remoteRecord.recordID];
+	}
+	
+	// The queue only changes during a commit (or when an upload completes, which only removes changeSets).
+	// So the result remains valid for the duration of this batch.
+	
+	NSSet *pendingModifications = nil;
+	NSSet *pendingDeletes = nil;
+	[parentConnection->parent->masterQueue getRecordIDsWithPendingModification:&pendingModifications
+	                                                             pendingDelete:&pendingDeletes
+	                                                              forRecordIDs:recordIDs
+	                                                        databaseIdentifier:databaseIdentifier];
+	
+	for (CKRecord *remoteRecord in remoteRecords)
+	{
+		[self mergeRecord:remoteRecord databaseIdentifier:databaseIdentifier
+		     pendingModifications:pendingModifications pendingDeletes:pendingDeletes];
+	}
+}
+
+/**
+ * Shared implementation of mergeRecord:databaseIdentifier: & mergeRecords:databaseIdentifier:.
+ *
+ * If pendingModifications & pendingDeletes are nil, the queue is checked for the given record.
+ * Otherwise they contain the recordIDs (from the batch) with pending changes.
+**/
+- (void)mergeRecord:(CKRecord *)remoteRecord
+ databaseIdentifier:(NSString *)databaseIdentifier
+pendingModifications:(NSSet *)pendingModifications
+     pendingDeletes:(NSSet *)pendingDeletes
+{
 	CKRecordID *recordID = remoteRecord.recordID;
 	NSString *hash = [self hashRecordID:recordID databaseIdentifier:databaseIdentifier];
 	
@@ -3961,22 +4028,70 @@ static BOOL ClassVersionsAreCompatible(int oldClassVersion, int newClassVersion)
 		// or we'll be stuck on this changeSet forever.
 		
 		BOOL hasPendingModification = NO;
-		 [parentConnection->parent->masterQueue getHasPendingModification:&hasPendingModification
-		                                                 hasPendingDelete:NULL
-		                                                      forRecordID:recordID
-		                                               databaseIdentifier:databaseIdentifier];
+		if (pendingModifications)
+		{
+			hasPendingModification = [pendingModifications containsObject:recordID];
+		}
+		else
+		{
+			[parentConnection->parent->masterQueue getHasPendingModification:&hasPendingModification
+			                                                hasPendingDelete:NULL
+			                                                     forRecordID:recordID
+			                                              databaseIdentifier:databaseIdentifier];
+		}
 		
 		if (!hasPendingModification)
 		{
 			return;
 		}
 	}
+	else if ([recordTableInfo isKindOfClass:[YDBCKCleanRecordTableInfo class]])
+	{
+		// Fast path:
+		// If the remoteRecord has the same recordChangeTag as the record we already have,
+		// then it's the same version of the record that we last synced with the server.
+		// And, if there aren't any pending changes for the record, then there's nothing to merge.
+		
+		NSString *remoteChangeTag = remoteRecord.recordChangeTag;
+		NSString *localChangeTag = [(YDBCKCleanRecordTableInfo *)recordTableInfo record].recordChangeTag;
+		
+		if (remoteChangeTag && [remoteChangeTag isEqualToString:localChangeTag])
+		{
+			BOOL hasPendingModification = NO;
+			BOOL hasPendingDelete = NO;
+			if (pendingModifications)
+			{
+				hasPendingModification = [pendingModifications containsObject:recordID];
+				hasPendingDelete = [pendingDeletes containsObject:recordID];
+			}
+			else
+			{
+				[parentConnection->parent->masterQueue getHasPendingModification:&hasPendingModification
+				                                                hasPendingDelete:&hasPendingDelete
+				                                                     forRecordID:recordID
+				                                              databaseIdentifier:databaseIdentifier];
+			}
+			
+			if (!hasPendingModification && !hasPendingDelete)
+			{
+				return;
+			}
+		}
+	}
 	
 	// Make sanitized copy of the remoteRecord.
 	// Sanitized == copy of the system fields only, without any values.
+	//
+	// Note: We serialize the system fields only once (we need 2 sanitized copies),
+	// and the systemFieldsCache allows the commit to skip encoding them again.
+	
+	__attribute__((objc_precise_lifetime)) NSData *remoteSystemFields =
+	  [YDBCKRecord serializeRecord:remoteRecord
+	                         cache:parentConnection->parent->systemFieldsCache
+	                           key:hash];
 	
 	YDBCKMergeInfo *mergeInfo = [[YDBCKMergeInfo alloc] init];
-	mergeInfo.pendingLocalRecord = [remoteRecord sanitizedCopy];
+	mergeInfo.pendingLocalRecord = [YDBCKRecord deserializeRecord:remoteSystemFields];
 	
 	// And then infuse the pendingLocalRecord with any key/value pairs that are pending upload.
 	//
@@ -4009,7 +4124,7 @@ static BOOL ClassVersionsAreCompatible(int oldClassVersion, int newClassVersion)
 	__unsafe_unretained YapDatabaseReadWriteTransaction *rwTransaction =
 	  (YapDatabaseReadWriteTransaction *)databaseTransaction;
 	
-	mergeInfo.updatedPendingLocalRecord = [remoteRecord sanitizedCopy];
+	mergeInfo.updatedPendingLocalRecord = [YDBCKRecord deserializeRecord:remoteSystemFields];
 	if (!hasPendingChanges) {
 		mergeInfo.pendingLocalRecord = nil;
 	}
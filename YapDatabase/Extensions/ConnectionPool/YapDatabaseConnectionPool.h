@@ -27,9 +27,12 @@ NS_ASSUME_NONNULL_BEGIN
  *
  * The connection pool was designed to increase the performance in these scenarios.
  * It will create connections on demand, up to (but not over) the connectionLimit.
- * And it will vend connections using a simple load balancer that's based on the number of pending
- * transactions that each connection has.
- * (So you'll be handed the connection with the smallest queue of pending "work".)
+ * And it will vend connections using a simple load balancer that's based on the expected wait of each connection.
+ * That is, the number of pending transactions, times the average duration of its transactions.
+ * (So you'll be handed the connection with the shortest queue of pending "work".)
+ *
+ * Connections that sit idle for longer than the connectionLifetime are retired from the pool,
+ * along with their caches and sqlite connections, so a burst of work doesn't keep them around forever.
  *
  * This allows for increased parallelization amongst your background tasks.
 **/
@@ -52,6 +55,30 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (atomic, assign, readwrite) NSUInteger connectionLimit;
 
+/**
+ * Connections that haven't been vended (via the connection method) for longer than the lifetime,
+ * and that don't have any pending/active transactions, are removed from the pool.
+ * The most recently used connection always remains in the pool.
+ *
+ * (If you're still holding a reference to a retired connection, it continues to work as usual.
+ *  The pool just won't vend it anymore.)
+ *
+ * The default value is 90 seconds. (The same as YapDatabase.connectionPoolLifetime for sqlite connections.)
+ * To disable the retirement of idle connections, set the lifetime to zero (or any non-positive value).
+**/
+@property (atomic, assign, readwrite) NSTimeInterval connectionLifetime;
+
+/**
+ * An optional limit on the memory held by the connections of the pool (in bytes).
+ *
+ * The memory of idle connections is measured periodically (via memoryReport), along with the connectionLifetime.
+ * If the total exceeds the budget, the least recently used idle connections are retired (even before their lifetime).
+ * And while the total (as of the last measurement) exceeds the budget, no new connections are created.
+ *
+ * The default value is zero, which means there's no limit.
+**/
+@property (atomic, assign, readwrite) uint64_t memoryBudget;
+
 /**
  * By default, new database connections inherit their default configuration settings via
  * YapDatabase.connectionDefaults, the same way that all connections do when one invokes [database newConnection].
@@ -73,12 +100,46 @@ NS_ASSUME_NONNULL_BEGIN
  * and the number of pending/active transactions for existing connections.
  *
  * - If there's an existing connection in the pool that doesn't have pending/active transactions,
- *   then that connection is returned.
- * - Otherwise, if the connection count is below connectionCount, a new connection is created & returned.
- * - Otherwise, an existing connection will be automatically chosen based on the number of pending/active transactions.
+ *   then that connection is returned. (The most recently used one, so the others can be retired when idle.)
+ * - Otherwise, if the connection count is below connectionLimit (and within the memoryBudget),
+ *   a new connection is created & returned.
+ * - Otherwise, the existing connection with the shortest expected wait is returned.
+ *   The expected wait is the number of pending/active transactions times the averageTransactionDuration.
 **/
 - (YapDatabaseConnection *)connection;
 
+/**
+ * Read-only access to the database, via one of the connections in the pool.
+ *
+ * Unlike [[pool connection] asyncReadWithBlock:], the block isn't bound to a particular connection
+ * at the time it's submitted. Instead it's placed in a work queue that's shared by the pool,
+ * and it's executed by the first connection that becomes available.
+ * So a quick read doesn't get stuck behind a slow enumeration,
+ * while another connection in the pool (or a new connection, within the connectionLimit) is sitting idle.
+ *
+ * Each block gets its own read-only transaction.
+ * Blocks are started in the order they were submitted (aside from the affinity, described below),
+ * but may execute concurrently on different connections.
+ *
+ * The affinity is an optional hint, such as the collection the block is going to read from.
+ * The pool remembers the affinities recently executed by each connection,
+ * and prefers to execute the block on a connection whose cache is likely to hold the relevant objects.
+ * But the hint never causes a block to wait for a busy connection while another connection is available.
+ *
+ * An optional completion block may be used.
+ * If the completionQueue is NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block;
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionQueue:(nullable dispatch_queue_t)completionQueue
+           completionBlock:(nullable dispatch_block_t)completionBlock;
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+                  affinity:(nullable NSString *)affinity
+           completionQueue:(nullable dispatch_queue_t)completionQueue
+           completionBlock:(nullable dispatch_block_t)completionBlock;
+
 @end
 
 NS_ASSUME_NONNULL_END
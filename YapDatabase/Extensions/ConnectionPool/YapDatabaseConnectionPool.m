@@ -1,19 +1,102 @@
 #import "YapDatabaseConnectionPool.h"
+#import "YapDatabaseMemoryReport.h"
 
 #define DEFAULT_CONNECTION_LIMIT ((NSUInteger)3)
+#define DEFAULT_CONNECTION_LIFETIME ((NSTimeInterval)90.0)
+
+/**
+ * The expected duration of a transaction on a connection that hasn't completed any transactions yet.
+**/
+#define DEFAULT_TRANSACTION_DURATION ((NSTimeInterval)0.001)
+
+/**
+ * The number of (distinct) affinities remembered for each connection.
+**/
+#define MAX_RECENT_AFFINITIES 8
+
+/**
+ * The bookkeeping for each connection in the pool.
+**/
+@interface YapDatabaseConnectionPoolEntry : NSObject {
+@public
+	YapDatabaseConnection *connection;
+	NSTimeInterval lastVendedTime; // [NSDate timeIntervalSinceReferenceDate]
+	uint64_t memoryBytes;          // As of the last measurement
+	
+	BOOL isWorking;                // Executing items from the shared work queue
+	NSMutableArray<NSString *> *recentAffinities; // Most recent first
+}
+@end
+
+@implementation YapDatabaseConnectionPoolEntry
+
+- (BOOL)hasAffinity:(NSString *)affinity
+{
+	if (affinity == nil) return NO;
+	
+	for (NSString *recentAffinity in recentAffinities)
+	{
+		if ([recentAffinity isEqualToString:affinity]) return YES;
+	}
+	
+	return NO;
+}
+
+- (void)noteAffinity:(NSString *)affinity
+{
+	if (affinity == nil) return;
+	
+	if (recentAffinities == nil)
+		recentAffinities = [[NSMutableArray alloc] initWithCapacity:MAX_RECENT_AFFINITIES];
+	else
+		[recentAffinities removeObject:affinity];
+	
+	[recentAffinities insertObject:affinity atIndex:0];
+	
+	if (recentAffinities.count > MAX_RECENT_AFFINITIES) {
+		[recentAffinities removeLastObject];
+	}
+}
+
+@end
+
+/**
+ * An item in the shared work queue (see asyncReadWithBlock:).
+**/
+@interface YapDatabaseConnectionPoolWorkItem : NSObject {
+@public
+	void (^block)(YapDatabaseReadTransaction *);
+	NSString *affinity;
+	dispatch_queue_t completionQueue;
+	dispatch_block_t completionBlock;
+}
+@end
+
+@implementation YapDatabaseConnectionPoolWorkItem
+@end
+
 
 @implementation YapDatabaseConnectionPool {
 	
 	YapDatabase *database;
 	
 	dispatch_queue_t queue;
-	NSMutableArray<YapDatabaseConnection *> *connections;
+	NSMutableArray<YapDatabaseConnectionPoolEntry *> *entries;
 	
 	NSUInteger connectionLimit;
+	NSTimeInterval connectionLifetime;
+	uint64_t memoryBudget;
 	YapDatabaseConnectionConfig *connectionDefaults;
+	
+	dispatch_source_t idleTimer;
+	NSTimeInterval idleTimerInterval;
+	
+	NSMutableArray<YapDatabaseConnectionPoolWorkItem *> *workQueue;
 }
 
 @dynamic connectionLimit;
+@dynamic connectionLifetime;
+@dynamic memoryBudget;
 @dynamic connectionDefaults;
 @synthesize didCreateNewConnectionBlock;
 
@@ -26,13 +109,21 @@
 		database = inDatabase;
 		
 		queue = dispatch_queue_create("YapDatabaseConnectionPool", DISPATCH_QUEUE_SERIAL);
-		connections = [[NSMutableArray alloc] init];
+		entries = [[NSMutableArray alloc] init];
+		workQueue = [[NSMutableArray alloc] init];
 		
 		connectionLimit = DEFAULT_CONNECTION_LIMIT;
+		connectionLifetime = DEFAULT_CONNECTION_LIFETIME;
 	}
 	return self;
 }
 
+- (void)dealloc
+{
+	if (idleTimer)
+		dispatch_source_cancel(idleTimer);
+}
+
 - (NSUInteger)connectionLimit
 {
 	__block NSUInteger result = 0;
@@ -55,10 +146,56 @@
 		
 		connectionLimit = limit;
 		
-		while (connections.count > connectionLimit)
+		while (entries.count > connectionLimit)
 		{
-			[connections removeLastObject];
+			[entries removeLastObject];
 		}
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (NSTimeInterval)connectionLifetime
+{
+	__block NSTimeInterval result = 0;
+	dispatch_sync(queue, ^{
+		result = self->connectionLifetime;
+	});
+	
+	return result;
+}
+
+- (void)setConnectionLifetime:(NSTimeInterval)lifetime
+{
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		connectionLifetime = lifetime;
+		[self updateIdleTimer];
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (uint64_t)memoryBudget
+{
+	__block uint64_t result = 0;
+	dispatch_sync(queue, ^{
+		result = self->memoryBudget;
+	});
+	
+	return result;
+}
+
+- (void)setMemoryBudget:(uint64_t)budget
+{
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		memoryBudget = budget;
+		[self updateIdleTimer];
 		
 	#pragma clang diagnostic pop
 	}});
@@ -90,46 +227,67 @@
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		uint64_t minLoad = 0;
+		YapDatabaseConnectionPoolEntry *resultEntry = nil;
+		NSTimeInterval minWait = 0;
 		
-		for (YapDatabaseConnection *connection in connections)
+		for (YapDatabaseConnectionPoolEntry *entry in entries)
 		{
-			uint64_t load = connection.pendingTransactionCount;
+			uint64_t load = entry->connection.pendingTransactionCount;
 			
-			if (!result || load < minLoad)
+			if (load == 0 && !entry->isWorking)
 			{
-				result = connection;
-				minLoad = load;
+				// An idle connection.
+				// We prefer the most recently used one, so the others remain idle (and can be retired).
+				
+				if (resultEntry == nil || minWait > 0 || entry->lastVendedTime > resultEntry->lastVendedTime)
+				{
+					resultEntry = entry;
+					minWait = 0;
+				}
+				continue;
 			}
 			
-			if (minLoad == 0) {
-				// Found what we needed.
-				// We can stop looking now.
-				break;
+			if (resultEntry && minWait == 0) {
+				// We already found an idle connection.
+				continue;
+			}
+			
+			NSTimeInterval duration = entry->connection.averageTransactionDuration;
+			if (duration <= 0) {
+				duration = DEFAULT_TRANSACTION_DURATION;
+			}
+			
+			NSTimeInterval wait = (NSTimeInterval)MAX(load, 1) * duration;
+			
+			if (resultEntry == nil || wait < minWait)
+			{
+				resultEntry = entry;
+				minWait = wait;
 			}
 		}
 		
 		BOOL createNewConnection = NO;
 		
-		if (result == nil)
+		if (resultEntry == nil)
 		{
 			createNewConnection = YES;
 		}
-		else if (minLoad > 0)
+		else if (minWait > 0)
 		{
-			if (connections.count < connectionLimit) {
+			if (entries.count < connectionLimit && ![self isOverMemoryBudget]) {
 				createNewConnection = YES;
 			}
 		}
 		
 		if (createNewConnection)
 		{
-			result = [database newConnection:connectionDefaults];
-			[connections addObject:result];
-			
+			resultEntry = [self addEntry];
 			isNewConnection = YES;
 		}
 		
+		resultEntry->lastVendedTime = [NSDate timeIntervalSinceReferenceDate];
+		result = resultEntry->connection;
+	
 	#pragma clang diagnostic pop
 	}});
 	
@@ -144,4 +302,404 @@
 	return result;
 }
 
+/**
+ * Must be invoked within the queue.
+ * The caller is responsible for invoking the didCreateNewConnectionBlock (outside the queue).
+**/
+- (YapDatabaseConnectionPoolEntry *)addEntry
+{
+	YapDatabaseConnectionPoolEntry *entry = [[YapDatabaseConnectionPoolEntry alloc] init];
+	entry->connection = [database newConnection:connectionDefaults];
+	
+	[entries addObject:entry];
+	[self updateIdleTimer];
+	
+	return entry;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Shared Work Queue
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+{
+	[self asyncReadWithBlock:block affinity:nil completionQueue:NULL completionBlock:NULL];
+}
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionQueue:(dispatch_queue_t)completionQueue
+           completionBlock:(dispatch_block_t)completionBlock
+{
+	[self asyncReadWithBlock:block affinity:nil completionQueue:completionQueue completionBlock:completionBlock];
+}
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+                  affinity:(NSString *)affinity
+           completionQueue:(dispatch_queue_t)completionQueue
+           completionBlock:(dispatch_block_t)completionBlock
+{
+	NSParameterAssert(block != nil);
+	
+	YapDatabaseConnectionPoolWorkItem *item = [[YapDatabaseConnectionPoolWorkItem alloc] init];
+	item->block = block;
+	item->affinity = [affinity copy];
+	item->completionQueue = completionQueue;
+	item->completionBlock = completionBlock;
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		[workQueue addObject:item];
+		[self startWorkers];
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Must be invoked within the queue.
+ *
+ * Puts available connections to work, until there's a worker for every item in the work queue.
+ * A connection is available if it's not already working, and it doesn't have any pending/active transactions.
+**/
+- (void)startWorkers
+{
+	NSUInteger workerCount = 0;
+	for (YapDatabaseConnectionPoolEntry *entry in entries)
+	{
+		if (entry->isWorking) workerCount++;
+	}
+	
+	while (workQueue.count > workerCount)
+	{
+		YapDatabaseConnectionPoolWorkItem *nextItem = workQueue[workerCount];
+		
+		YapDatabaseConnectionPoolEntry *worker = nil;
+		for (YapDatabaseConnectionPoolEntry *entry in entries)
+		{
+			if (entry->isWorking || entry->connection.pendingTransactionCount > 0) continue;
+			
+			// Prefer a connection that recently executed an item with the same affinity,
+			// and otherwise the most recently used one (so the others remain idle, and can be retired).
+			
+			if (worker == nil) {
+				worker = entry;
+				continue;
+			}
+			
+			BOOL entryHasAffinity = [entry hasAffinity:nextItem->affinity];
+			BOOL workerHasAffinity = [worker hasAffinity:nextItem->affinity];
+			
+			if ((entryHasAffinity && !workerHasAffinity) ||
+			   ((entryHasAffinity == workerHasAffinity) && (entry->lastVendedTime > worker->lastVendedTime)))
+			{
+				worker = entry;
+			}
+		}
+		
+		BOOL isNewConnection = NO;
+		
+		if (worker == nil)
+		{
+			if (entries.count < connectionLimit && ![self isOverMemoryBudget])
+			{
+				worker = [self addEntry];
+				isNewConnection = YES;
+			}
+			else if (workerCount == 0 && entries.count > 0)
+			{
+				// Every connection is busy with transactions that weren't submitted through the work queue.
+				// We still need a worker, or the work queue would stall.
+				// So we queue up behind the connection with the shortest expected wait.
+				
+				NSTimeInterval minWait = 0;
+				for (YapDatabaseConnectionPoolEntry *entry in entries)
+				{
+					NSTimeInterval duration = entry->connection.averageTransactionDuration;
+					if (duration <= 0) {
+						duration = DEFAULT_TRANSACTION_DURATION;
+					}
+					
+					NSTimeInterval wait = (NSTimeInterval)entry->connection.pendingTransactionCount * duration;
+					
+					if (worker == nil || wait < minWait)
+					{
+						worker = entry;
+						minWait = wait;
+					}
+				}
+			}
+			else
+			{
+				// The busy connections will steal the remaining items when they finish.
+				break;
+			}
+		}
+		
+		worker->isWorking = YES;
+		workerCount++;
+		
+		if (isNewConnection)
+		{
+			void (^block)(YapDatabaseConnection*) = self.didCreateNewConnectionBlock;
+			if (block)
+			{
+				// The didCreateNewConnectionBlock is invoked outside the queue (just like in the connection method).
+				// The worker doesn't take an item until it's done.
+				
+				dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{ @autoreleasepool {
+					
+					block(worker->connection);
+					
+					dispatch_async(self->queue, ^{ @autoreleasepool {
+						[self executeNextItemOnWorker:worker];
+					}});
+				}});
+				continue;
+			}
+		}
+		
+		[self executeNextItemOnWorker:worker];
+	}
+}
+
+/**
+ * Must be invoked within the queue.
+ *
+ * Takes the next item from the work queue, and executes it (asynchronously) on the given worker.
+ * When the item is complete, the worker comes back for another one, until the work queue is empty.
+ *
+ * The next item is the oldest one with an affinity the worker recently executed.
+ * If there isn't one, the worker steals the oldest item, regardless of its affinity.
+**/
+- (void)executeNextItemOnWorker:(YapDatabaseConnectionPoolEntry *)worker
+{
+	NSUInteger index = NSNotFound;
+	
+	if (worker->recentAffinities.count > 0)
+	{
+		NSUInteger i = 0;
+		for (YapDatabaseConnectionPoolWorkItem *item in workQueue)
+		{
+			if ([worker hasAffinity:item->affinity]) {
+				index = i;
+				break;
+			}
+			i++;
+		}
+	}
+	
+	if (index == NSNotFound && workQueue.count > 0) {
+		index = 0;
+	}
+	
+	if (index == NSNotFound)
+	{
+		worker->isWorking = NO;
+		return;
+	}
+	
+	YapDatabaseConnectionPoolWorkItem *item = workQueue[index];
+	[workQueue removeObjectAtIndex:index];
+	
+	[worker noteAffinity:item->affinity];
+	worker->lastVendedTime = [NSDate timeIntervalSinceReferenceDate];
+	
+	// The worker's completionQueue is a global queue.
+	// So the pool's queue is never blocked on (or by) the connection's queue.
+	
+	[worker->connection asyncReadWithBlock:item->block
+	                       completionQueue:dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0)
+	                       completionBlock:^{ @autoreleasepool {
+		
+		if (item->completionBlock)
+		{
+			dispatch_async(item->completionQueue ?: dispatch_get_main_queue(), item->completionBlock);
+		}
+		
+		dispatch_async(self->queue, ^{ @autoreleasepool {
+			[self executeNextItemOnWorker:worker];
+		}});
+	}}];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Idle Connections
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Must be invoked within the queue.
+ * Returns YES if the memory held by the connections (as of the last measurement) exceeds the memoryBudget.
+**/
+- (BOOL)isOverMemoryBudget
+{
+	if (memoryBudget == 0) return NO;
+	
+	uint64_t total = 0;
+	for (YapDatabaseConnectionPoolEntry *entry in entries)
+	{
+		total += entry->memoryBytes;
+	}
+	
+	return (total > memoryBudget);
+}
+
+/**
+ * Must be invoked within the queue.
+ * The timer only runs while there are connections that could be retired.
+**/
+- (void)updateIdleTimer
+{
+	BOOL needsTimer = ((connectionLifetime > 0) || (memoryBudget > 0)) && (entries.count > 1);
+	
+	if (!needsTimer)
+	{
+		if (idleTimer)
+		{
+			dispatch_source_cancel(idleTimer);
+			idleTimer = NULL;
+		}
+		return;
+	}
+	
+	// Check twice per lifetime, so a connection is retired within 1.5 lifetimes of its last use.
+	
+	NSTimeInterval lifetime = (connectionLifetime > 0) ? connectionLifetime : DEFAULT_CONNECTION_LIFETIME;
+	NSTimeInterval interval = MAX(lifetime / 2.0, 1.0);
+	
+	if (idleTimer && (interval == idleTimerInterval)) return;
+	
+	if (idleTimer == NULL)
+	{
+		// The timer doesn't fire on our queue.
+		// Measuring the memory of a connection requires its queue,
+		// and a transaction on that connection may be waiting on our queue (via the connection method).
+		
+		idleTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+		
+		__weak YapDatabaseConnectionPool *weakSelf = self;
+		dispatch_source_set_event_handler(idleTimer, ^{ @autoreleasepool {
+			
+			__strong YapDatabaseConnectionPool *strongSelf = weakSelf;
+			if (strongSelf)
+			{
+				[strongSelf retireIdleConnections];
+			}
+		}});
+		
+		#if !OS_OBJECT_USE_OBJC
+		dispatch_source_t timer = idleTimer;
+		dispatch_source_set_cancel_handler(idleTimer, ^{
+			dispatch_release(timer);
+		});
+		#endif
+		
+		dispatch_resume(idleTimer);
+	}
+	
+	idleTimerInterval = interval;
+	
+	uint64_t intervalNanos = (uint64_t)(interval * NSEC_PER_SEC);
+	dispatch_source_set_timer(idleTimer, dispatch_time(DISPATCH_TIME_NOW, intervalNanos), intervalNanos, NSEC_PER_SEC);
+}
+
+/**
+ * Invoked by the idleTimer (outside the queue).
+**/
+- (void)retireIdleConnections
+{
+	__block NSArray<YapDatabaseConnectionPoolEntry *> *idleEntries = nil;
+	__block uint64_t budget = 0;
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		NSMutableArray *idle = [NSMutableArray arrayWithCapacity:entries.count];
+		for (YapDatabaseConnectionPoolEntry *entry in entries)
+		{
+			if (!entry->isWorking && entry->connection.pendingTransactionCount == 0) {
+				[idle addObject:entry];
+			}
+		}
+		
+		idleEntries = idle;
+		budget = memoryBudget;
+	
+	#pragma clang diagnostic pop
+	}});
+	
+	if (budget > 0)
+	{
+		// Measured outside the queue (see updateIdleTimer).
+		// The connections are idle, so the reports don't wait for any transactions (unless one just started).
+		
+		for (YapDatabaseConnectionPoolEntry *entry in idleEntries)
+		{
+			uint64_t bytes = [entry->connection memoryReport].totalBytes;
+			
+			dispatch_sync(queue, ^{
+				entry->memoryBytes = bytes;
+			});
+		}
+	}
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (entries.count <= 1) {
+			[self updateIdleTimer];
+			return;
+		}
+		
+		// The most recently used connection always remains in the pool.
+		
+		YapDatabaseConnectionPoolEntry *mostRecentEntry = nil;
+		for (YapDatabaseConnectionPoolEntry *entry in entries)
+		{
+			if (mostRecentEntry == nil || entry->lastVendedTime > mostRecentEntry->lastVendedTime) {
+				mostRecentEntry = entry;
+			}
+		}
+		
+		// Retire the connections that have been idle for longer than the lifetime,
+		// and then the least recently used ones, until we're back within the memory budget.
+		
+		NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+		
+		NSMutableArray<YapDatabaseConnectionPoolEntry *> *candidates =
+		  [NSMutableArray arrayWithCapacity:entries.count];
+		
+		for (YapDatabaseConnectionPoolEntry *entry in entries)
+		{
+			if (entry != mostRecentEntry && !entry->isWorking && entry->connection.pendingTransactionCount == 0) {
+				[candidates addObject:entry];
+			}
+		}
+		
+		[candidates sortUsingComparator:^NSComparisonResult(YapDatabaseConnectionPoolEntry *a,
+		                                                    YapDatabaseConnectionPoolEntry *b)
+		{
+			if (a->lastVendedTime < b->lastVendedTime) return NSOrderedAscending;
+			if (a->lastVendedTime > b->lastVendedTime) return NSOrderedDescending;
+			return NSOrderedSame;
+		}];
+		
+		for (YapDatabaseConnectionPoolEntry *entry in candidates)
+		{
+			BOOL expired = (connectionLifetime > 0) && ((now - entry->lastVendedTime) >= connectionLifetime);
+			
+			if (expired || [self isOverMemoryBudget]) {
+				[entries removeObjectIdenticalTo:entry];
+			}
+		}
+		
+		[self updateIdleTimer];
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
 @end
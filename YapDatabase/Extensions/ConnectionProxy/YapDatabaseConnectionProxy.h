@@ -5,6 +5,35 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class YapDatabaseConnectionProxyFlushStatistics;
+
+/**
+ * What the proxy does when a change pushes its pending values over the pendingValueLimit or pendingByteLimit.
+ * (For example, because the readWriteConnection has fallen behind.)
+ *
+ * - Block:
+ *     The thread that made the change waits (synchronously) until enough pending values have been written,
+ *     and the proxy is back within its limits.
+ *
+ * - DropOldest:
+ *     The oldest pending changes that haven't been handed to a read-write transaction yet are discarded
+ *     (as if resetObjectForKey:inCollection: was invoked for them), until the proxy is back within its limits.
+ *     The change that was just made is never discarded.
+ *     This is only appropriate for values you can afford to lose (which is the premise of a proxy).
+ *
+ * - Flush:
+ *     The thread that made the change forces a flush of all pending changes (regardless of the flushInterval),
+ *     and waits (synchronously) until it completes.
+ *
+ * Important: If you use the Block or Flush policy, don't make changes to the proxy from within a transaction
+ * on its readWriteConnection, as the change would wait for that same connection.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseConnectionProxyPendingLimitPolicy) {
+	YapDatabaseConnectionProxyPendingLimitPolicy_Block,
+	YapDatabaseConnectionProxyPendingLimitPolicy_DropOldest,
+	YapDatabaseConnectionProxyPendingLimitPolicy_Flush,
+};
+
 /**
  * A "proxy" connection is a trade-off in terms of the ACID guarantees of the database.
  * 
@@ -86,6 +115,16 @@ NS_ASSUME_NONNULL_BEGIN
  *   - You write a different value (for the same collection/key) using the regular database connection.
  *   - The proxy later performs a readWrite, and writes its value for the collection/key,
  *     overwriting the regular database connection.
+ *
+ * ** Flush policy
+ *
+ * By default, the proxy begins an asyncReadWrite transaction as soon as it becomes "dirty".
+ * Any changes made before the transaction starts are included in the same batch.
+ *
+ * For chatty state (e.g. UI state that changes many times per second), you can configure the proxy
+ * to wait a little before flushing, via the flushInterval, flushWriteCountThreshold & flushByteCountThreshold.
+ * Changes are always coalesced per collection/key (the last write wins),
+ * so a value that changes 50 times within the interval is only written once.
 **/
 @interface YapDatabaseConnectionProxy : NSObject
 
@@ -209,6 +248,101 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (void)reset;
 
+/**
+ * The maximum amount of time the proxy waits, after becoming "dirty", before flushing its pending changes.
+ * A flush is also triggered (sooner) if either the flushWriteCountThreshold or flushByteCountThreshold is reached.
+ *
+ * The default value is zero, which means the proxy flushes as soon as it becomes "dirty".
+ * (The batch still includes any changes made before the read-write transaction starts.)
+**/
+@property (atomic, assign, readwrite) NSTimeInterval flushInterval;
+
+/**
+ * If the number of collection/key tuples in the pending batch reaches this threshold,
+ * the proxy flushes immediately (without waiting for the flushInterval).
+ * 
+ * Since changes are coalesced, repeated writes to the same collection/key only count once.
+ *
+ * The default value is zero, which means there's no threshold.
+**/
+@property (atomic, assign, readwrite) NSUInteger flushWriteCountThreshold;
+
+/**
+ * If the (estimated) number of bytes in the pending batch reaches this threshold,
+ * the proxy flushes immediately (without waiting for the flushInterval).
+ *
+ * The proxy doesn't serialize values until they're written, so it relies on the byteCountBlock for the estimate.
+ * If the byteCountBlock is nil, this threshold is ignored.
+ *
+ * The default value is zero, which means there's no threshold.
+**/
+@property (atomic, assign, readwrite) NSUInteger flushByteCountThreshold;
+
+/**
+ * Returns the estimated size (in bytes) of a change, for the flushByteCountThreshold & pendingByteLimit.
+ *
+ * The block is invoked on the thread that makes the change (before the change is applied to the proxy),
+ * so it should be cheap. For example, the length of a string, or the length of an image's data.
+ * The object or metadata is nil if it's not part of the change (e.g. replaceMetadata:forKey:inCollection:).
+ * Removals are counted as zero bytes.
+**/
+@property (atomic, copy, readwrite, nullable)
+  NSUInteger (^byteCountBlock)(NSString *collection, NSString *key, id _Nullable object, id _Nullable metadata);
+
+/**
+ * If set, the block is invoked (on the main thread) after each batch is written to the database.
+ * The statistics include the size of the batch, and how long it took to flush.
+**/
+@property (atomic, copy, readwrite, nullable)
+  void (^flushStatisticsBlock)(YapDatabaseConnectionProxyFlushStatistics *statistics);
+
+/**
+ * The maximum number of collection/key tuples with pending values.
+ * This includes values in the process of being written, as well as those waiting for the next batch.
+ *
+ * The proxy retains the values you give it (it doesn't copy them),
+ * and releases them once they've been written (unless they've been changed again since).
+ *
+ * The default value is zero, which means there's no limit.
+ * See pendingLimitPolicy for what happens when the limit is reached.
+**/
+@property (atomic, assign, readwrite) NSUInteger pendingValueLimit;
+
+/**
+ * The maximum (estimated) number of bytes of pending values, as reported by the byteCountBlock.
+ * If the byteCountBlock is nil, this limit is ignored.
+ *
+ * The default value is zero, which means there's no limit.
+ * See pendingLimitPolicy for what happens when the limit is reached.
+**/
+@property (atomic, assign, readwrite) NSUInteger pendingByteLimit;
+
+/**
+ * What to do when the pendingValueLimit or pendingByteLimit is reached.
+ *
+ * The default value is YapDatabaseConnectionProxyPendingLimitPolicy_Block.
+**/
+@property (atomic, assign, readwrite) YapDatabaseConnectionProxyPendingLimitPolicy pendingLimitPolicy;
+
+/**
+ * The current number of collection/key tuples with pending values.
+**/
+@property (atomic, assign, readonly) NSUInteger pendingValueCount;
+
+/**
+ * The current (estimated) number of bytes of pending values, as reported by the byteCountBlock.
+**/
+@property (atomic, assign, readonly) NSUInteger pendingByteCount;
+
+/**
+ * Flushes the pending changes immediately, regardless of the flushInterval.
+ * For example, when the application is about to be backgrounded.
+ *
+ * The changes are still written asynchronously.
+ * If the proxy doesn't have any pending changes (that aren't already being written), this method does nothing.
+**/
+- (void)flush;
+
 /**
  * The fetchedCollectionsFilter is useful when you need to delete one or more collections from the database.
  * For example:
@@ -259,4 +393,48 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Describes a single batch written by a YapDatabaseConnectionProxy.
+ * See YapDatabaseConnectionProxy.flushStatisticsBlock.
+**/
+@interface YapDatabaseConnectionProxyFlushStatistics : NSObject
+
+/**
+ * The number of changes made to the proxy (setObject, replaceMetadata, remove, etc) that went into the batch.
+ * This includes changes that were coalesced (i.e. multiple changes to the same collection/key).
+**/
+@property (nonatomic, assign, readonly) NSUInteger writeCount;
+
+/**
+ * The number of collection/key tuples with an object change (set, replace or remove) in the batch.
+**/
+@property (nonatomic, assign, readonly) NSUInteger objectCount;
+
+/**
+ * The number of collection/key tuples with a metadata change in the batch.
+**/
+@property (nonatomic, assign, readonly) NSUInteger metadataCount;
+
+/**
+ * The estimated size of the batch, as reported by the byteCountBlock. (Zero if there's no byteCountBlock.)
+**/
+@property (nonatomic, assign, readonly) NSUInteger byteCount;
+
+/**
+ * The time from the first change in the batch, until the read-write transaction took the batch.
+ * This includes the flushInterval, as well as any time spent waiting for the write lock.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval queueDuration;
+
+/**
+ * The time from when the read-write transaction took the batch, until the transaction completed.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval flushDuration;
+
+@end
+
 NS_ASSUME_NONNULL_END
@@ -2,6 +2,9 @@
 #import "YapDatabaseLogging.h"
 #import "YapCollectionKey.h"
 #import "YapNull.h"
+#import "YapDatabaseTransactionMetricsPrivate.h" // YapDatabaseTicksToSeconds
+
+#import <stdatomic.h>
 
 /**
  * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
@@ -14,6 +17,55 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+@interface YapDatabaseConnectionProxyFlushStatistics () {
+@public
+	
+	NSUInteger writeCount;
+	NSUInteger objectCount;
+	NSUInteger metadataCount;
+	NSUInteger byteCount;
+	
+	uint64_t queueTicks;
+	uint64_t flushStartTime;
+	uint64_t flushTicks;
+}
+@end
+
+@implementation YapDatabaseConnectionProxyFlushStatistics
+
+@synthesize writeCount = writeCount;
+@synthesize objectCount = objectCount;
+@synthesize metadataCount = metadataCount;
+@synthesize byteCount = byteCount;
+
+@dynamic queueDuration;
+@dynamic flushDuration;
+
+- (NSTimeInterval)queueDuration
+{
+	return YapDatabaseTicksToSeconds(queueTicks);
+}
+
+- (NSTimeInterval)flushDuration
+{
+	return YapDatabaseTicksToSeconds(flushTicks);
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseConnectionProxyFlushStatistics[%p]: writes=%lu objects=%lu metadata=%lu bytes=%lu"
+	  @" queue=%.6f flush=%.6f>", self,
+	  (unsigned long)writeCount, (unsigned long)objectCount, (unsigned long)metadataCount, (unsigned long)byteCount,
+	  self.queueDuration, self.flushDuration];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 
 @implementation YapDatabaseConnectionProxy
 {
@@ -50,12 +102,61 @@
 	NSMutableArray<NSMutableSet *> *pendingObjectBatches;
 	NSMutableArray<NSMutableSet *> *pendingMetadataBatches;
 	
+	/**
+	 * Flush policy state, for the current batch:
+	 *
+	 * - flushPending: an asyncReadWrite transaction has been queued, and will take the current batch when it starts.
+	 * - flushTimerPending: a timer (for the flushInterval) has been scheduled for the current batch.
+	 * - batchGeneration: incremented every time the current batch is taken (or reset), to invalidate stale timers.
+	**/
+	
+	BOOL flushPending;
+	BOOL flushTimerPending;
+	uint64_t batchGeneration;
+	
+	uint64_t currentBatchStartTime; // mach_absolute_time of the first change, or zero if the batch is empty
+	NSUInteger currentBatchWriteCount;
+	NSUInteger currentBatchByteCount;
+	NSMutableDictionary<YapCollectionKey *, NSNumber *> *currentBatchByteCounts;
+	NSMutableOrderedSet<YapCollectionKey *> *currentBatchOrder; // Oldest change first (for DropOldest)
+	
+	/**
+	 * Pending value accounting:
+	 *
+	 * - pendingByteCounts: the byte estimate for each tuple in the pendingObjectCache / pendingMetadataCache.
+	 * - flushGroup: entered for every queued read-write transaction, and left when it completes.
+	 *               (Used to wait for the pending values to be written.)
+	 *
+	 * The atomic pendingValueCount (and hasFetchedCollectionsFilter) allow the getter methods to skip the queue
+	 * when there's nothing pending, which is the common case.
+	**/
+	
+	NSMutableDictionary<YapCollectionKey *, NSNumber *> *pendingByteCounts;
+	NSUInteger pendingByteTotal;
+	
+	dispatch_group_t flushGroup;
+	
+	atomic_ulong atomicPendingValueCount;
+	atomic_bool hasFetchedCollectionsFilter;
+	
 	YapWhitelistBlacklist *fetchedCollectionsFilter;
 }
 
 @synthesize readOnlyConnection = readOnlyConnection;
 @synthesize readWriteConnection = readWriteConnection;
 
+@synthesize flushInterval;
+@synthesize flushWriteCountThreshold;
+@synthesize flushByteCountThreshold;
+@synthesize byteCountBlock;
+@synthesize flushStatisticsBlock;
+@synthesize pendingValueLimit;
+@synthesize pendingByteLimit;
+@synthesize pendingLimitPolicy;
+
+@dynamic pendingValueCount;
+@dynamic pendingByteCount;
+
 
 - (instancetype)initWithDatabase:(YapDatabase *)database
 {
@@ -100,6 +201,14 @@
 		pendingObjectBatches   = [[NSMutableArray alloc] initWithCapacity:4];
 		pendingMetadataBatches = [[NSMutableArray alloc] initWithCapacity:4];
 		
+		currentBatchByteCounts = [[NSMutableDictionary alloc] init];
+		currentBatchOrder      = [[NSMutableOrderedSet alloc] init];
+		
+		pendingByteCounts = [[NSMutableDictionary alloc] init];
+		flushGroup = dispatch_group_create();
+		
+		pendingLimitPolicy = YapDatabaseConnectionProxyPendingLimitPolicy_Block;
+		
 		if (inReadOnlyConnection)
 		{
 			readOnlyConnection = inReadOnlyConnection;
@@ -136,13 +245,343 @@
 #pragma mark Batch Logic
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Must be invoked within the queue.
+ * Updates the flush policy state for a change to the current batch. (Invoke after the change has been applied.)
+**/
+- (void)noteWriteForKey:(YapCollectionKey *)ck byteCount:(NSUInteger)byteCount
+{
+	if (currentBatchStartTime == 0) {
+		currentBatchStartTime = mach_absolute_time();
+	}
+	currentBatchWriteCount++;
+	
+	[currentBatchOrder removeObject:ck];
+	[currentBatchOrder addObject:ck];
+	
+	if (self.byteCountBlock)
+	{
+		// The last write wins, so it replaces the estimate for any previous write (to the same key).
+		
+		NSNumber *prevByteCount = currentBatchByteCounts[ck];
+		if (prevByteCount) {
+			currentBatchByteCount -= [prevByteCount unsignedIntegerValue];
+		}
+		
+		currentBatchByteCounts[ck] = @(byteCount);
+		currentBatchByteCount += byteCount;
+		
+		NSNumber *prevPendingByteCount = pendingByteCounts[ck];
+		if (prevPendingByteCount) {
+			pendingByteTotal -= [prevPendingByteCount unsignedIntegerValue];
+		}
+		
+		pendingByteCounts[ck] = @(byteCount);
+		pendingByteTotal += byteCount;
+	}
+	
+	[self updatePendingValueCount];
+}
+
+/**
+ * Must be invoked within the queue.
+ * Invoke after removing a tuple from the pendingObjectCache and/or pendingMetadataCache.
+**/
+- (void)forgetPendingValueForKey:(YapCollectionKey *)ck
+{
+	if (pendingObjectCache[ck] || pendingMetadataCache[ck]) return;
+	
+	NSNumber *byteCount = pendingByteCounts[ck];
+	if (byteCount)
+	{
+		pendingByteTotal -= [byteCount unsignedIntegerValue];
+		[pendingByteCounts removeObjectForKey:ck];
+	}
+}
+
+/**
+ * Must be invoked within the queue, after any change to the pendingObjectCache or pendingMetadataCache.
+**/
+- (void)updatePendingValueCount
+{
+	// A tuple may be in either (or both) of the caches. The larger of the two is a cheap approximation.
+	
+	NSUInteger count = MAX(pendingObjectCache.count, pendingMetadataCache.count);
+	atomic_store(&atomicPendingValueCount, (unsigned long)count);
+}
+
+/**
+ * Returns NO if there are no pending values, and no fetchedCollectionsFilter.
+ * In which case the getter methods can go straight to the readOnlyConnection (without going through the queue).
+**/
+- (BOOL)needsPendingLookup
+{
+	return (atomic_load(&atomicPendingValueCount) > 0) || atomic_load(&hasFetchedCollectionsFilter);
+}
+
+- (NSUInteger)pendingValueCount
+{
+	return (NSUInteger)atomic_load(&atomicPendingValueCount);
+}
+
+- (NSUInteger)pendingByteCount
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(queue, ^{
+		result = self->pendingByteTotal;
+	});
+	
+	return result;
+}
+
+/**
+ * Must be invoked within the queue.
+**/
+- (BOOL)isOverPendingLimit
+{
+	NSUInteger valueLimit = self.pendingValueLimit;
+	if (valueLimit > 0 && MAX(pendingObjectCache.count, pendingMetadataCache.count) > valueLimit) {
+		return YES;
+	}
+	
+	NSUInteger byteLimit = self.pendingByteLimit;
+	if (byteLimit > 0 && self.byteCountBlock && pendingByteTotal > byteLimit) {
+		return YES;
+	}
+	
+	return NO;
+}
+
+/**
+ * Must be invoked within the queue, after a change has been applied (and noted).
+ *
+ * Enforces the pendingValueLimit & pendingByteLimit.
+ * For the DropOldest policy, the oldest changes are discarded immediately.
+ * For the other policies, returns YES if the caller must invoke waitForPendingLimit (outside the queue).
+**/
+- (BOOL)enforcePendingLimitForKey:(YapCollectionKey *)ck
+{
+	if (![self isOverPendingLimit]) return NO;
+	
+	YapDatabaseConnectionProxyPendingLimitPolicy policy = self.pendingLimitPolicy;
+	if (policy != YapDatabaseConnectionProxyPendingLimitPolicy_DropOldest) {
+		return YES;
+	}
+	
+	NSUInteger droppedCount = 0;
+	
+	for (YapCollectionKey *oldestCK in [currentBatchOrder copy])
+	{
+		if (![self isOverPendingLimit]) break;
+		if ([oldestCK isEqual:ck]) continue;
+		
+		// If the tuple is also part of a batch that's being written,
+		// discarding our newer value would expose the (older) in-flight value. So we skip it.
+		
+		BOOL isInFlight = NO;
+		for (NSMutableSet *batch in pendingObjectBatches)
+		{
+			if ([batch containsObject:oldestCK]) { isInFlight = YES; break; }
+		}
+		for (NSMutableSet *batch in pendingMetadataBatches)
+		{
+			if (isInFlight) break;
+			if ([batch containsObject:oldestCK]) { isInFlight = YES; break; }
+		}
+		if (isInFlight) continue;
+		
+		[self discardPendingValueForKey:oldestCK];
+		droppedCount++;
+	}
+	
+	if (droppedCount > 0) {
+		YDBLogWarn(@"%@ - Dropped %lu pending change(s): over pending limit",
+		           THIS_METHOD, (unsigned long)droppedCount);
+	}
+	
+	return NO;
+}
+
+/**
+ * Must be invoked within the queue.
+ * Discards the pending change for the tuple (if any), as in resetObjectForKey:inCollection:.
+**/
+- (void)discardPendingValueForKey:(YapCollectionKey *)ck
+{
+	[pendingObjectCache removeObjectForKey:ck];
+	[currentObjectBatch removeObject:ck];
+	
+	[pendingMetadataCache removeObjectForKey:ck];
+	[currentMetadataBatch removeObject:ck];
+	
+	[currentBatchOrder removeObject:ck];
+	
+	NSNumber *byteCount = currentBatchByteCounts[ck];
+	if (byteCount)
+	{
+		currentBatchByteCount -= [byteCount unsignedIntegerValue];
+		[currentBatchByteCounts removeObjectForKey:ck];
+	}
+	
+	[self forgetPendingValueForKey:ck];
+	[self updatePendingValueCount];
+}
+
+/**
+ * Must be invoked outside the queue.
+ *
+ * Implements the Block & Flush policies (see YapDatabaseConnectionProxyPendingLimitPolicy).
+**/
+- (void)waitForPendingLimit
+{
+	BOOL forceFlush = (self.pendingLimitPolicy == YapDatabaseConnectionProxyPendingLimitPolicy_Flush);
+	
+	while (YES)
+	{
+		__block BOOL needsWrite = NO;
+		__block BOOL needsWait = NO;
+		
+		dispatch_sync(queue, ^{ @autoreleasepool {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			if (![self isOverPendingLimit]) return; // from block
+			
+			// Make sure there's something to wait for.
+			// With the Block policy, we only start the current batch if nothing is in flight.
+			
+			BOOL hasCurrentBatch = (currentObjectBatch.count > 0 || currentMetadataBatch.count > 0);
+			BOOL hasInFlight = (flushPending || pendingObjectBatches.count > 0);
+			
+			if (hasCurrentBatch && !flushPending && (forceFlush || !hasInFlight))
+			{
+				flushPending = YES;
+				needsWrite = YES;
+			}
+			
+			needsWait = (needsWrite || hasInFlight);
+			
+		#pragma clang diagnostic pop
+		}});
+		
+		if (needsWrite) {
+			[self asyncWriteNextBatch];
+		}
+		
+		if (!needsWait) break;
+		
+		dispatch_group_wait(flushGroup, DISPATCH_TIME_FOREVER);
+		
+		if (forceFlush) break;
+	}
+}
+
+/**
+ * Must be invoked within the queue.
+ *
+ * Applies the flush policy to the current batch.
+ * Returns YES if the caller should invoke asyncWriteNextBatch (outside the queue is fine).
+ * Otherwise a timer may be scheduled, which will flush the batch later.
+**/
+- (BOOL)shouldFlushCurrentBatch
+{
+	if (flushPending) {
+		// A transaction has already been queued, and it will take the current batch.
+		return NO;
+	}
+	
+	if (currentObjectBatch.count == 0 && currentMetadataBatch.count == 0) {
+		return NO;
+	}
+	
+	NSTimeInterval interval = self.flushInterval;
+	NSUInteger writeCountThreshold = self.flushWriteCountThreshold;
+	NSUInteger byteCountThreshold = self.byteCountBlock ? self.flushByteCountThreshold : 0;
+	
+	BOOL flushNow = (interval <= 0);
+	
+	if (!flushNow && writeCountThreshold > 0)
+	{
+		NSUInteger writeCount = MAX(currentObjectBatch.count, currentMetadataBatch.count);
+		flushNow = (writeCount >= writeCountThreshold);
+	}
+	if (!flushNow && byteCountThreshold > 0)
+	{
+		flushNow = (currentBatchByteCount >= byteCountThreshold);
+	}
+	
+	if (flushNow)
+	{
+		flushPending = YES;
+		return YES;
+	}
+	
+	if (!flushTimerPending)
+	{
+		flushTimerPending = YES;
+		
+		uint64_t generation = batchGeneration;
+		dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(interval * NSEC_PER_SEC));
+		
+		__weak YapDatabaseConnectionProxy *weakSelf = self;
+		dispatch_after(when, queue, ^{ @autoreleasepool {
+			
+			__strong YapDatabaseConnectionProxy *strongSelf = weakSelf;
+			if (strongSelf)
+			{
+				[strongSelf flushTimerDidFire:generation];
+			}
+		}});
+	}
+	
+	return NO;
+}
+
+/**
+ * Invoked within the queue.
+**/
+- (void)flushTimerDidFire:(uint64_t)generation
+{
+	if (generation != batchGeneration) {
+		// The batch the timer was scheduled for has already been taken (or reset).
+		return;
+	}
+	
+	flushTimerPending = NO;
+	
+	if (flushPending) return;
+	if (currentObjectBatch.count == 0 && currentMetadataBatch.count == 0) return;
+	
+	flushPending = YES;
+	[self asyncWriteNextBatch];
+}
+
+/**
+ * Must be invoked within the queue.
+ * Resets the flush policy state, when the current batch is taken (or reset).
+**/
+- (void)resetCurrentBatchState
+{
+	flushPending = NO;
+	flushTimerPending = NO;
+	batchGeneration++;
+	
+	currentBatchStartTime = 0;
+	currentBatchWriteCount = 0;
+	currentBatchByteCount = 0;
+	[currentBatchByteCounts removeAllObjects];
+	[currentBatchOrder removeAllObjects];
+}
+
 - (void)queueBatchWithObjects:(NSMutableDictionary **)objectBatchPtr
                      metadata:(NSMutableDictionary **)metadataBatchPtr
+                   statistics:(YapDatabaseConnectionProxyFlushStatistics **)statisticsPtr
 {
 	YDBLogAutoTrace();
 	
 	__block NSMutableDictionary *objectBatch = nil;
 	__block NSMutableDictionary *metadataBatch = nil;
+	__block YapDatabaseConnectionProxyFlushStatistics *statistics = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
@@ -153,9 +592,23 @@
 		
 		if (oCount == 0 && mCount == 0) // nothing to write
 		{
+			// E.g. the changes were reset before the transaction started.
+			[self resetCurrentBatchState];
 			return; // from block
 		}
 		
+		statistics = [[YapDatabaseConnectionProxyFlushStatistics alloc] init];
+		statistics->writeCount = currentBatchWriteCount;
+		statistics->objectCount = oCount;
+		statistics->metadataCount = mCount;
+		statistics->byteCount = currentBatchByteCount;
+		statistics->flushStartTime = mach_absolute_time();
+		if (currentBatchStartTime > 0) {
+			statistics->queueTicks = statistics->flushStartTime - currentBatchStartTime;
+		}
+		
+		[self resetCurrentBatchState];
+		
 		objectBatch   = [[NSMutableDictionary alloc] initWithCapacity:oCount];
 		metadataBatch = [[NSMutableDictionary alloc] initWithCapacity:mCount];
 		
@@ -188,6 +641,7 @@
 	
 	if (objectBatchPtr) *objectBatchPtr = objectBatch;
 	if (metadataBatchPtr) *metadataBatchPtr = metadataBatch;
+	if (statisticsPtr) *statisticsPtr = statistics;
 }
 
 - (void)dequeueBatch
@@ -203,6 +657,7 @@
 			if (![currentObjectBatch containsObject:ck])
 			{
 				[pendingObjectCache removeObjectForKey:ck];
+				[self forgetPendingValueForKey:ck];
 			}
 		}
 		for (YapCollectionKey *ck in [pendingMetadataBatches firstObject])
@@ -210,12 +665,15 @@
 			if (![currentMetadataBatch containsObject:ck])
 			{
 				[pendingMetadataCache removeObjectForKey:ck];
+				[self forgetPendingValueForKey:ck];
 			}
 		}
 		
 		[pendingObjectBatches removeObjectAtIndex:0];
 		[pendingMetadataBatches removeObjectAtIndex:0];
 		
+		[self updatePendingValueCount];
+		
 	#pragma clang diagnostic pop
 	}};
 	
@@ -230,6 +688,10 @@
 	YDBLogAutoTrace();
 	
 	__weak YapDatabaseConnectionProxy *weakSelf = self;
+	__block YapDatabaseConnectionProxyFlushStatistics *statistics = nil;
+	
+	dispatch_group_t group = flushGroup;
+	dispatch_group_enter(group);
 	
 	#pragma clang diagnostic push
 	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
@@ -240,7 +702,7 @@
 		
 		NSMutableDictionary *objectBatch = nil;
 		NSMutableDictionary *metadataBatch = nil;
-		[strongSelf queueBatchWithObjects:&objectBatch metadata:&metadataBatch];
+		[strongSelf queueBatchWithObjects:&objectBatch metadata:&metadataBatch statistics:&statistics];
 		
 		YapNull *yapnull = [YapNull null];
 		
@@ -280,10 +742,24 @@
 	} completionQueue:queue completionBlock:^{
 		
 		__strong YapDatabaseConnectionProxy *strongSelf = weakSelf;
-		if (strongSelf)
+		if (strongSelf && statistics)
 		{
+			// Note: If statistics is nil, then the transaction didn't take a batch (there was nothing to write).
+			
 			[strongSelf dequeueBatch];
+			
+			statistics->flushTicks = mach_absolute_time() - statistics->flushStartTime;
+			
+			void (^flushStatisticsBlock)(YapDatabaseConnectionProxyFlushStatistics *) = strongSelf.flushStatisticsBlock;
+			if (flushStatisticsBlock)
+			{
+				dispatch_async(dispatch_get_main_queue(), ^{ @autoreleasepool {
+					flushStatisticsBlock(statistics);
+				}});
+			}
 		}
+		
+		dispatch_group_leave(group);
 	}];
 	#pragma clang diagnostic pop
 }
@@ -307,18 +783,21 @@
 	__block id object = nil;
 	__block BOOL collectionFiltered = NO;
 	
-	dispatch_sync(queue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		object = [pendingObjectCache objectForKey:ck];
-		
-		if (!object && fetchedCollectionsFilter) {
-			collectionFiltered = ![fetchedCollectionsFilter isAllowed:collection];
-		}
-		
-	#pragma clang diagnostic pop
-	}});
+	if ([self needsPendingLookup])
+	{
+		dispatch_sync(queue, ^{ @autoreleasepool {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			object = [pendingObjectCache objectForKey:ck];
+			
+			if (!object && fetchedCollectionsFilter) {
+				collectionFiltered = ![fetchedCollectionsFilter isAllowed:collection];
+			}
+			
+		#pragma clang diagnostic pop
+		}});
+	}
 	
 	if (object)
 	{
@@ -354,18 +833,21 @@
 	__block id metadata = nil;
 	__block BOOL collectionFiltered = NO;
 	
-	dispatch_sync(queue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		metadata = [pendingMetadataCache objectForKey:ck];
-		
-		if (!metadata && fetchedCollectionsFilter) {
-			collectionFiltered = ![fetchedCollectionsFilter isAllowed:collection];
-		}
-		
-	#pragma clang diagnostic pop
-	}});
+	if ([self needsPendingLookup])
+	{
+		dispatch_sync(queue, ^{ @autoreleasepool {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			metadata = [pendingMetadataCache objectForKey:ck];
+			
+			if (!metadata && fetchedCollectionsFilter) {
+				collectionFiltered = ![fetchedCollectionsFilter isAllowed:collection];
+			}
+			
+		#pragma clang diagnostic pop
+		}});
+	}
 	
 	if (metadata)
 	{
@@ -410,19 +892,22 @@
 	__block id metadata = nil;
 	__block BOOL collectionFiltered = NO;
 	
-	dispatch_sync(queue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		object = [pendingObjectCache objectForKey:ck];
-		metadata = [pendingMetadataCache objectForKey:ck];
-		
-		if ((!object || !metadata) && fetchedCollectionsFilter) {
-			collectionFiltered = ![fetchedCollectionsFilter isAllowed:collection];
-		}
-		
-	#pragma clang diagnostic pop
-	}});
+	if ([self needsPendingLookup])
+	{
+		dispatch_sync(queue, ^{ @autoreleasepool {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			object = [pendingObjectCache objectForKey:ck];
+			metadata = [pendingMetadataCache objectForKey:ck];
+			
+			if ((!object || !metadata) && fetchedCollectionsFilter) {
+				collectionFiltered = ![fetchedCollectionsFilter isAllowed:collection];
+			}
+			
+		#pragma clang diagnostic pop
+		}});
+	}
 	
 	if (object && metadata)
 	{
@@ -501,14 +986,14 @@
 	if (key == nil) return;
 	
 	YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	NSUInteger byteCount = [self byteCountForObject:object metadata:metadata key:ck];
 	__block BOOL needsWrite = NO;
+	__block BOOL needsWait = NO;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		needsWrite = ((currentObjectBatch.count == 0) && (currentMetadataBatch.count == 0));
-		
 		[pendingObjectCache setObject:object forKey:ck];
 		[currentObjectBatch addObject:ck];
 		
@@ -521,12 +1006,19 @@
 		
 		[currentMetadataBatch addObject:ck];
 		
+		[self noteWriteForKey:ck byteCount:byteCount];
+		needsWrite = [self shouldFlushCurrentBatch];
+		needsWait = [self enforcePendingLimitForKey:ck];
+		
 	#pragma clang diagnostic pop
 	}});
 	
 	if (needsWrite) {
 		[self asyncWriteNextBatch];
 	}
+	if (needsWait) {
+		[self waitForPendingLimit];
+	}
 }
 
 /**
@@ -575,7 +1067,9 @@
 	}
 	
 	YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	NSUInteger byteCount = [self byteCountForObject:object metadata:nil key:ck];
 	__block BOOL needsWrite = NO;
+	__block BOOL needsWait = NO;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
@@ -600,10 +1094,12 @@
 		
 		if (exists)
 		{
-			needsWrite = ((currentObjectBatch.count == 0) && (currentMetadataBatch.count == 0));
-			
 			[pendingObjectCache setObject:object forKey:ck];
 			[currentObjectBatch addObject:ck];
+			
+			[self noteWriteForKey:ck byteCount:byteCount];
+			needsWrite = [self shouldFlushCurrentBatch];
+			needsWait = [self enforcePendingLimitForKey:ck];
 		}
 		
 	#pragma clang diagnostic pop
@@ -612,6 +1108,9 @@
 	if (needsWrite) {
 		[self asyncWriteNextBatch];
 	}
+	if (needsWait) {
+		[self waitForPendingLimit];
+	}
 }
 
 /**
@@ -654,7 +1153,9 @@
 	}
 	
 	YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	NSUInteger byteCount = [self byteCountForObject:nil metadata:metadata key:ck];
 	__block BOOL needsWrite = NO;
+	__block BOOL needsWait = NO;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
@@ -681,8 +1182,6 @@
 		
 		if (exists)
 		{
-			needsWrite = ((currentObjectBatch.count == 0) && (currentMetadataBatch.count == 0));
-			
 			if (metadata) {
 				[pendingMetadataCache setObject:metadata forKey:ck];
 			}
@@ -691,6 +1190,10 @@
 			}
 			
 			[currentMetadataBatch addObject:ck];
+			
+			[self noteWriteForKey:ck byteCount:byteCount];
+			needsWrite = [self shouldFlushCurrentBatch];
+			needsWait = [self enforcePendingLimitForKey:ck];
 		}
 		
 	#pragma clang diagnostic pop
@@ -699,6 +1202,9 @@
 	if (needsWrite) {
 		[self asyncWriteNextBatch];
 	}
+	if (needsWait) {
+		[self waitForPendingLimit];
+	}
 }
 
 /**
@@ -718,25 +1224,31 @@
 	
 	YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	__block BOOL needsWrite = NO;
+	__block BOOL needsWait = NO;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		needsWrite = ((currentObjectBatch.count == 0) && (currentMetadataBatch.count == 0));
-		
 		[pendingObjectCache setObject:[YapNull null] forKey:ck];
 		[currentObjectBatch addObject:ck];
 		
 		[pendingMetadataCache setObject:[YapNull null] forKey:ck];
 		[currentMetadataBatch addObject:ck];
 		
+		[self noteWriteForKey:ck byteCount:0];
+		needsWrite = [self shouldFlushCurrentBatch];
+		needsWait = [self enforcePendingLimitForKey:ck];
+		
 	#pragma clang diagnostic pop
 	}});
 	
 	if (needsWrite) {
 		[self asyncWriteNextBatch];
 	}
+	if (needsWait) {
+		[self waitForPendingLimit];
+	}
 }
 
 /**
@@ -755,13 +1267,12 @@
 	if (keys.count == 0) return;
 	
 	__block BOOL needsWrite = NO;
+	__block BOOL needsWait = NO;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		needsWrite = ((currentObjectBatch.count == 0) && (currentMetadataBatch.count == 0));
-		
 		for (NSString *key in keys)
 		{
 			YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
@@ -771,14 +1282,22 @@
 			
 			[pendingMetadataCache setObject:[YapNull null] forKey:ck];
 			[currentMetadataBatch addObject:ck];
+			
+			[self noteWriteForKey:ck byteCount:0];
 		}
 		
+		needsWrite = [self shouldFlushCurrentBatch];
+		needsWait = [self enforcePendingLimitForKey:nil];
+		
 	#pragma clang diagnostic pop
 	}});
 	
 	if (needsWrite) {
 		[self asyncWriteNextBatch];
 	}
+	if (needsWait) {
+		[self waitForPendingLimit];
+	}
 }
 
 /**
@@ -795,11 +1314,7 @@
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		[pendingObjectCache removeObjectForKey:ck];
-		[currentObjectBatch removeObject:ck];
-		
-		[pendingMetadataCache removeObjectForKey:ck];
-		[currentMetadataBatch removeObject:ck];
+		[self discardPendingValueForKey:ck];
 		
 	#pragma clang diagnostic pop
 	}});
@@ -823,10 +1338,56 @@
 		[pendingMetadataCache removeAllObjects];
 		[currentMetadataBatch removeAllObjects];
 		
+		[pendingByteCounts removeAllObjects];
+		pendingByteTotal = 0;
+		
+		if (!flushPending) {
+			[self resetCurrentBatchState];
+		}
+		[currentBatchOrder removeAllObjects];
+		[self updatePendingValueCount];
+		
 	#pragma clang diagnostic pop
 	}});
 }
 
+/**
+ * Flushes the pending changes immediately, regardless of the flushInterval.
+ * The changes are still written asynchronously.
+**/
+- (void)flush
+{
+	__block BOOL needsWrite = NO;
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (!flushPending && (currentObjectBatch.count > 0 || currentMetadataBatch.count > 0))
+		{
+			flushPending = YES;
+			needsWrite = YES;
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	if (needsWrite) {
+		[self asyncWriteNextBatch];
+	}
+}
+
+/**
+ * Invoked outside the queue (on the caller's thread), before the change is applied.
+**/
+- (NSUInteger)byteCountForObject:(id)object metadata:(id)metadata key:(YapCollectionKey *)ck
+{
+	NSUInteger (^block)(NSString*, NSString*, id, id) = self.byteCountBlock;
+	if (block == nil) return 0;
+	
+	return block(ck.collection, ck.key, object, metadata);
+}
+
 /**
  * The fetchedCollectionsFilter is useful when you need to delete one or more collections from the database.
  * For example:
@@ -872,6 +1433,7 @@
 {
 	dispatch_block_t block = ^{
 		self->fetchedCollectionsFilter = filter;
+		atomic_store(&self->hasFetchedCollectionsFilter, (filter != nil));
 	};
 	
 	if (dispatch_get_specific(IsOnQueueKey))
@@ -0,0 +1,105 @@
+#import "YapDatabase.h"
+#import "YapDatabaseConnection.h"
+#import "YapDatabaseTransaction.h"
+
+#import "YapDatabaseCountView.h"
+#import "YapDatabaseCountViewOptions.h"
+#import "YapDatabaseCountViewConnection.h"
+#import "YapDatabaseCountViewTransaction.h"
+
+#import "sqlite3.h"
+
+/**
+ * This version number is stored in the yap2 table.
+ * If there is a major re-write to this class, then the version number will be incremented,
+ * and the class can automatically rebuild the table as needed.
+**/
+#define YAP_DATABASE_COUNT_VIEW_CLASS_VERSION 1
+
+/**
+ * Keys for changeset dictionary.
+**/
+static NSString *const changeset_key_dirtyCounts   = @"dirtyCounts";   // internal: group -> counts (or NSNull)
+static NSString *const changeset_key_changedGroups = @"changedGroups"; // external: NSSet of groups
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The (immutable) count & sum of a single group.
+**/
+@interface YapDatabaseCountViewCounts : NSObject {
+@public
+	
+	NSUInteger count;
+	double sum;
+}
+
+- (instancetype)initWithCount:(NSUInteger)count sum:(double)sum;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseCountView () {
+@public
+	
+	YapDatabaseViewGrouping *grouping;
+	YapDatabaseCountViewOptions *options;
+	
+	NSString *versionTag;
+	
+	BOOL needsObject;   // the grouping and/or sum reads the object
+	BOOL needsMetadata; // the grouping and/or sum reads the metadata
+	
+	BOOL processObjectModified;   // a modified object may change the group and/or sum
+	BOOL processMetadataModified; // a modified metadata may change the group and/or sum
+}
+
+- (NSString *)tableName;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseCountViewConnection () {
+@public
+	
+	__strong YapDatabaseCountView *parent;
+	__unsafe_unretained YapDatabaseConnection *databaseConnection;
+	
+	NSMutableDictionary<NSString *, YapDatabaseCountViewCounts *> *counts; // nil until loaded
+	NSMutableSet<NSString *> *dirtyGroups;
+}
+
+- (id)initWithParent:(YapDatabaseCountView *)parent databaseConnection:(YapDatabaseConnection *)databaseConnection;
+
+- (void)postCommitCleanup;
+- (void)postRollbackCleanup;
+
+- (sqlite3_stmt *)enumerateStatement;
+- (sqlite3_stmt *)setStatement;
+- (sqlite3_stmt *)removeStatement;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseCountViewTransaction () {
+@private
+	
+	__unsafe_unretained YapDatabaseCountViewConnection *parentConnection;
+	__unsafe_unretained YapDatabaseReadTransaction *databaseTransaction;
+}
+
+- (id)initWithParentConnection:(YapDatabaseCountViewConnection *)parentConnection
+           databaseTransaction:(YapDatabaseReadTransaction *)databaseTransaction;
+
+@end
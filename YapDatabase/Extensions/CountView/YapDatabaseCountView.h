@@ -0,0 +1,77 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabaseExtension.h"
+#import "YapDatabaseViewTypes.h"
+
+#import "YapDatabaseCountViewOptions.h"
+#import "YapDatabaseCountViewConnection.h"
+#import "YapDatabaseCountViewTransaction.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * The project wiki has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * YapDatabaseCountView is a lightweight alternative to a YapDatabaseAutoView,
+ * for when all you need is the number of rows in each group. (Such as unread badges per folder.)
+ *
+ * It uses the same grouping as a view (YapDatabaseViewGrouping), but there's no sorting.
+ * And rather than storing every rowid (in pages, plus a map entry per row),
+ * it stores only a count (and optionally a sum, see YapDatabaseCountViewOptions) per group.
+ * So the storage is O(groups), instead of O(rows).
+ *
+ * The counts are updated incrementally as rows are inserted, modified & removed.
+ * To do so without storing the group of each row, the extension invokes the grouping block on the row
+ * before it's modified (to find the group it's leaving), and again after (to find the group it's joining).
+ * Thus the grouping block must be a function of the row itself.
+ * It must not depend on other rows, or on any external state.
+ * (Touching a row doesn't change the counts, since the row itself is unchanged.)
+**/
+@interface YapDatabaseCountView : YapDatabaseExtension
+
+/**
+ * Creates a new count view extension.
+ * After creation, you'll need to register the extension with the database system.
+ *
+ * @param grouping
+ *   Determines the group each row belongs to (if any).
+ *   A row for which the grouping block returns nil isn't counted.
+ *
+ * @param versionTag
+ *   If, after creating the count view, you need to change the grouping or options,
+ *   then simply change the versionTag. If you pass a versionTag that is different from the last
+ *   initialization of the extension, then it will automatically re-populate itself.
+ *
+ * @param options
+ *   Allows you to specify extra options to configure the extension.
+ *   See the YapDatabaseCountViewOptions class for more information.
+ *
+ * @see YapDatabase registerExtension:withName:
+**/
+- (instancetype)initWithGrouping:(YapDatabaseViewGrouping *)grouping
+                      versionTag:(nullable NSString *)versionTag;
+
+- (instancetype)initWithGrouping:(YapDatabaseViewGrouping *)grouping
+                      versionTag:(nullable NSString *)versionTag
+                         options:(nullable YapDatabaseCountViewOptions *)options;
+
+@property (nonatomic, strong, readonly) YapDatabaseViewGrouping *grouping;
+
+/**
+ * The versionTag assists in making changes to the extension.
+ *
+ * If you need to change the grouping or options,
+ * then simply pass a different versionTag during the init method,
+ * and the extension will automatically update itself.
+**/
+@property (nonatomic, copy, readonly) NSString *versionTag;
+
+@property (nonatomic, copy, readonly) YapDatabaseCountViewOptions *options;
+
+@end
+
+NS_ASSUME_NONNULL_END
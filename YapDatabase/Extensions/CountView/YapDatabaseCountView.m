@@ -0,0 +1,152 @@
+#import "YapDatabaseCountView.h"
+#import "YapDatabaseCountViewPrivate.h"
+
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseExtensionPrivate.h"
+
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+@implementation YapDatabaseCountViewCounts
+
+- (instancetype)initWithCount:(NSUInteger)inCount sum:(double)inSum
+{
+	if ((self = [super init]))
+	{
+		count = inCount;
+		sum = inSum;
+	}
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YapDatabaseCountViewCounts: count(%lu) sum(%f)>", (unsigned long)count, sum];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseCountView
+
++ (void)dropTablesForRegisteredName:(NSString *)registeredName
+                    withTransaction:(YapDatabaseReadWriteTransaction *)transaction
+                      wasPersistent:(BOOL __unused)wasPersistent
+{
+	sqlite3 *db = transaction->connection->db;
+	NSString *tableName = [self tableNameForRegisteredName:registeredName];
+	
+	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
+	
+	int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed dropping table (%@): %d %s",
+		            THIS_METHOD, tableName, status, sqlite3_errmsg(db));
+	}
+}
+
++ (NSString *)tableNameForRegisteredName:(NSString *)registeredName
+{
+	return [NSString stringWithFormat:@"countView_%@", registeredName];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Instance
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@synthesize grouping = grouping;
+@synthesize versionTag = versionTag;
+
+@dynamic options;
+
+- (id)init
+{
+	NSAssert(NO, @"Must use designated initializer");
+	return nil;
+}
+
+- (instancetype)initWithGrouping:(YapDatabaseViewGrouping *)inGrouping versionTag:(NSString *)inVersionTag
+{
+	return [self initWithGrouping:inGrouping versionTag:inVersionTag options:nil];
+}
+
+- (instancetype)initWithGrouping:(YapDatabaseViewGrouping *)inGrouping
+                      versionTag:(NSString *)inVersionTag
+                         options:(YapDatabaseCountViewOptions *)inOptions
+{
+	if (inGrouping == nil)
+	{
+		NSAssert(NO, @"Invalid grouping: nil");
+		
+		YDBLogError(@"%@: Invalid grouping: nil", THIS_METHOD);
+		return nil;
+	}
+	
+	if ((self = [super init]))
+	{
+		grouping = inGrouping;
+		
+		versionTag = inVersionTag ? [inVersionTag copy] : @"";
+		
+		options = inOptions ? [inOptions copy] : [[YapDatabaseCountViewOptions alloc] init];
+		
+		BOOL sumsObject   = NO;
+		BOOL sumsMetadata = NO;
+		
+		if (options.sumKeyPath)
+		{
+			sumsObject   = (options.sumSource == YapDatabaseViewKeyPathSourceObject);
+			sumsMetadata = (options.sumSource == YapDatabaseViewKeyPathSourceMetadata);
+		}
+		
+		needsObject   = ((grouping.blockType & YapDatabaseBlockType_ObjectFlag) != 0)   || sumsObject;
+		needsMetadata = ((grouping.blockType & YapDatabaseBlockType_MetadataFlag) != 0) || sumsMetadata;
+		
+		processObjectModified =
+		  ((grouping.blockInvokeOptions & YapDatabaseBlockInvokeIfObjectModified) != 0) || sumsObject;
+		
+		processMetadataModified =
+		  ((grouping.blockInvokeOptions & YapDatabaseBlockInvokeIfMetadataModified) != 0) || sumsMetadata;
+	}
+	return self;
+}
+
+- (YapDatabaseCountViewOptions *)options
+{
+	return [options copy];
+}
+
+/**
+ * Subclasses MUST implement this method.
+ * Returns a proper instance of the YapDatabaseExtensionConnection subclass.
+**/
+- (YapDatabaseExtensionConnection *)newConnection:(YapDatabaseConnection *)databaseConnection
+{
+	return [[YapDatabaseCountViewConnection alloc] initWithParent:self databaseConnection:databaseConnection];
+}
+
+- (NSString *)tableName
+{
+	return [[self class] tableNameForRegisteredName:self.registeredName];
+}
+
+@end
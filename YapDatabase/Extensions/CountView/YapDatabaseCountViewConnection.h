@@ -0,0 +1,31 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseExtensionConnection.h"
+
+@class YapDatabaseCountView;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseCountViewConnection : YapDatabaseExtensionConnection
+
+/**
+ * Returns the parent instance.
+**/
+@property (nonatomic, strong, readonly) YapDatabaseCountView *countView;
+
+/**
+ * Returns YES if the count (or sum) of any group changed in the given notifications.
+ *
+ * @param notifications
+ *   An array of YapDatabaseModifiedNotification's.
+ *   (Typically from -[YapDatabaseConnection beginLongLivedReadTransaction].)
+**/
+- (BOOL)hasChangesForNotifications:(NSArray<NSNotification *> *)notifications;
+
+/**
+ * Returns YES if the count (or sum) of the given group changed in the given notifications.
+**/
+- (BOOL)hasChangesForGroup:(NSString *)group inNotifications:(NSArray<NSNotification *> *)notifications;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,325 @@
+#import "YapDatabaseCountViewConnection.h"
+#import "YapDatabaseCountViewPrivate.h"
+
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseExtensionPrivate.h"
+#import "YapDatabaseMemoryReportPrivate.h"
+
+#import "YapDatabaseString.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+@implementation YapDatabaseCountViewConnection
+{
+	sqlite3_stmt *enumerateStatement;
+	sqlite3_stmt *setStatement;
+	sqlite3_stmt *removeStatement;
+}
+
+@synthesize countView = parent;
+
+- (id)initWithParent:(YapDatabaseCountView *)inParent databaseConnection:(YapDatabaseConnection *)inDatabaseConnection
+{
+	if ((self = [super init]))
+	{
+		parent = inParent;
+		databaseConnection = inDatabaseConnection;
+		
+		dirtyGroups = [[NSMutableSet alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[self _flushStatements];
+}
+
+- (void)_flushStatements
+{
+	sqlite_finalize_null(&enumerateStatement);
+	sqlite_finalize_null(&setStatement);
+	sqlite_finalize_null(&removeStatement);
+}
+
+/**
+ * Required override method from YapDatabaseExtensionConnection
+**/
+- (void)_flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags
+{
+	if (flags & YapDatabaseConnectionFlushMemoryFlags_Caches)
+	{
+		// The counts are reloaded from the table on demand.
+		// But only if they're not in the middle of being modified.
+		
+		if ([dirtyGroups count] == 0)
+			counts = nil;
+	}
+	
+	if (flags & YapDatabaseConnectionFlushMemoryFlags_Statements)
+	{
+		[self _flushStatements];
+	}
+}
+
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateMemoryUsageWithBlock:(void (^)(NSString *component,
+                                                uint64_t bytes,
+                                                YapDatabaseConnectionFlushMemoryFlags flushFlags))block
+{
+	uint64_t countsBytes = YapDatabaseEstimatedObjectSize(counts);
+	
+	uint64_t statementBytes = 0;
+	statementBytes += YapDatabaseStatementMemoryUsed(enumerateStatement);
+	statementBytes += YapDatabaseStatementMemoryUsed(setStatement);
+	statementBytes += YapDatabaseStatementMemoryUsed(removeStatement);
+	
+	block(@"counts", countsBytes, YapDatabaseConnectionFlushMemoryFlags_Caches);
+	block(@"statements", statementBytes, YapDatabaseConnectionFlushMemoryFlags_Statements);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Accessors
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Required override method from YapDatabaseExtensionConnection.
+**/
+- (YapDatabaseExtension *)extension
+{
+	return parent;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Transactions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Required override method from YapDatabaseExtensionConnection.
+**/
+- (id)newReadTransaction:(YapDatabaseReadTransaction *)databaseTransaction
+{
+	YapDatabaseCountViewTransaction *transaction =
+	    [[YapDatabaseCountViewTransaction alloc] initWithParentConnection:self
+	                                                  databaseTransaction:databaseTransaction];
+	
+	return transaction;
+}
+
+/**
+ * Required override method from YapDatabaseExtensionConnection.
+**/
+- (id)newReadWriteTransaction:(YapDatabaseReadWriteTransaction *)databaseTransaction
+{
+	YapDatabaseCountViewTransaction *transaction =
+	    [[YapDatabaseCountViewTransaction alloc] initWithParentConnection:self
+	                                                  databaseTransaction:databaseTransaction];
+	
+	return transaction;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Changeset
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)postCommitCleanup
+{
+	[dirtyGroups removeAllObjects];
+}
+
+- (void)postRollbackCleanup
+{
+	// The in-memory counts may include changes that were rolled back.
+	// So we simply reload them (from the table) when next needed.
+	
+	counts = nil;
+	[dirtyGroups removeAllObjects];
+}
+
+/**
+ * Required override method from YapDatabaseExtension
+**/
+- (void)getInternalChangeset:(NSMutableDictionary **)internalChangesetPtr
+           externalChangeset:(NSMutableDictionary **)externalChangesetPtr
+              hasDiskChanges:(BOOL *)hasDiskChangesPtr
+{
+	NSMutableDictionary *internalChangeset = nil;
+	NSMutableDictionary *externalChangeset = nil;
+	BOOL hasDiskChanges = NO;
+	
+	if ([dirtyGroups count] > 0)
+	{
+		NSMutableDictionary *dirtyCounts = [NSMutableDictionary dictionaryWithCapacity:[dirtyGroups count]];
+		
+		for (NSString *group in dirtyGroups)
+		{
+			YapDatabaseCountViewCounts *groupCounts = counts[group];
+			dirtyCounts[group] = groupCounts ?: [NSNull null];
+		}
+		
+		internalChangeset = [NSMutableDictionary dictionaryWithCapacity:1];
+		internalChangeset[changeset_key_dirtyCounts] = [dirtyCounts copy];
+		
+		externalChangeset = [NSMutableDictionary dictionaryWithCapacity:1];
+		externalChangeset[changeset_key_changedGroups] = [dirtyGroups copy];
+		
+		hasDiskChanges = YES;
+	}
+	
+	*internalChangesetPtr = internalChangeset;
+	*externalChangesetPtr = externalChangeset;
+	*hasDiskChangesPtr = hasDiskChanges;
+}
+
+/**
+ * Required override method from YapDatabaseExtension
+**/
+- (void)processChangeset:(NSDictionary *)changeset
+{
+	// If the counts aren't loaded, there's nothing to update.
+	// They'll be loaded from the table (which includes these changes) when next needed.
+	
+	if (counts == nil) return;
+	
+	NSDictionary *changeset_dirtyCounts = changeset[changeset_key_dirtyCounts];
+	
+	[changeset_dirtyCounts enumerateKeysAndObjectsUsingBlock:^(NSString *group, id groupCounts, BOOL __unused *stop) {
+		
+		if (groupCounts == (id)[NSNull null])
+			[self->counts removeObjectForKey:group];
+		else
+			self->counts[group] = groupCounts;
+	}];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Changeset Helpers
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns YES if the count (or sum) of any group changed.
+**/
+- (BOOL)hasChangesForNotifications:(NSArray<NSNotification *> *)notifications
+{
+	NSString *registeredName = parent.registeredName;
+	
+	for (NSNotification *notification in notifications)
+	{
+		NSDictionary *changeset =
+		    [[notification.userInfo objectForKey:YapDatabaseExtensionsKey] objectForKey:registeredName];
+		
+		NSSet *changeset_changedGroups = [changeset objectForKey:changeset_key_changedGroups];
+		
+		if ([changeset_changedGroups count] > 0)
+		{
+			return YES;
+		}
+	}
+	
+	return NO;
+}
+
+/**
+ * Returns YES if the count (or sum) of the given group changed.
+**/
+- (BOOL)hasChangesForGroup:(NSString *)group inNotifications:(NSArray<NSNotification *> *)notifications
+{
+	if (group == nil) return NO;
+	
+	NSString *registeredName = parent.registeredName;
+	
+	for (NSNotification *notification in notifications)
+	{
+		NSDictionary *changeset =
+		    [[notification.userInfo objectForKey:YapDatabaseExtensionsKey] objectForKey:registeredName];
+		
+		NSSet *changeset_changedGroups = [changeset objectForKey:changeset_key_changedGroups];
+		
+		if ([changeset_changedGroups containsObject:group])
+		{
+			return YES;
+		}
+	}
+	
+	return NO;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Statements
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)prepareStatement:(sqlite3_stmt **)statement withString:(NSString *)stmtString caller:(SEL)caller_cmd
+{
+	sqlite3 *db = databaseConnection->db;
+	YapDatabaseString stmt; MakeYapDatabaseString(&stmt, stmtString);
+	
+	int status = sqlite3_prepare_v2(db, stmt.str, stmt.length+1, statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating prepared statement: %d %s",
+					NSStringFromSelector(caller_cmd), status, sqlite3_errmsg(db));
+	}
+	
+	FreeYapDatabaseString(&stmt);
+}
+
+- (sqlite3_stmt *)enumerateStatement
+{
+	sqlite3_stmt **statement = &enumerateStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		  @"SELECT \"group\", \"count\", \"sum\" FROM \"%@\";", [parent tableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)setStatement
+{
+	sqlite3_stmt **statement = &setStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		  @"INSERT OR REPLACE INTO \"%@\" (\"group\", \"count\", \"sum\") VALUES (?, ?, ?);", [parent tableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)removeStatement
+{
+	sqlite3_stmt **statement = &removeStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		  @"DELETE FROM \"%@\" WHERE \"group\" = ?;", [parent tableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
+@end
@@ -0,0 +1,51 @@
+#import <Foundation/Foundation.h>
+#import "YapWhitelistBlacklist.h"
+#import "YapDatabaseViewTypes.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * The project wiki has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * This class provides extra options when initializing YapDatabaseCountView.
+**/
+@interface YapDatabaseCountViewOptions : NSObject <NSCopying>
+
+/**
+ * You can configure the extension to pre-filter all but a subset of collections.
+ *
+ * The primary motivation for this is to reduce the overhead when first populating the count view.
+ * When the extension first populates itself, it will enumerate over just the allowedCollections,
+ * as opposed to enumerating over the entire database.
+ *
+ * In addition to reducing the overhead when first populating the extension,
+ * the allowedCollections will pre-filter while you're making changes to the database.
+ * So if you add a new object to the database, and the associated collection isn't in allowedCollections,
+ * then the grouping block will never be invoked, and the row won't be counted.
+ *
+ * The default value is nil.
+**/
+@property (nonatomic, strong, readwrite, nullable) YapWhitelistBlacklist *allowedCollections;
+
+/**
+ * Besides the number of rows in each group, the count view can track the sum of a value extracted from each row.
+ * For example, the total number of unread messages in each folder.
+ *
+ * The value is read from the sumSource (collection, key, object or metadata), via -valueForKeyPath: (sumKeyPath).
+ * NSNumber values are summed (as doubles). Any other value (including nil) counts as zero.
+ *
+ * If the sumKeyPath is nil, then sums aren't tracked (and -sumInGroup: always returns zero).
+ *
+ * The default sumSource is YapDatabaseViewKeyPathSourceObject.
+ * The default sumKeyPath is nil.
+**/
+@property (nonatomic, assign, readwrite) YapDatabaseViewKeyPathSource sumSource;
+@property (nonatomic, copy, readwrite, nullable) NSString *sumKeyPath;
+
+@end
+
+NS_ASSUME_NONNULL_END
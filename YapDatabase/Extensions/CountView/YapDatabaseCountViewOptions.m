@@ -0,0 +1,37 @@
+#import "YapDatabaseCountViewOptions.h"
+
+/**
+ * Welcome to YapDatabase!
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * The project wiki has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * This class provides extra options when initializing YapDatabaseCountView.
+**/
+@implementation YapDatabaseCountViewOptions
+
+@synthesize allowedCollections = allowedCollections;
+@synthesize sumSource = sumSource;
+@synthesize sumKeyPath = sumKeyPath;
+
+- (id)init
+{
+	if ((self = [super init]))
+	{
+		sumSource = YapDatabaseViewKeyPathSourceObject;
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	YapDatabaseCountViewOptions *copy = [[YapDatabaseCountViewOptions alloc] init];
+	copy->allowedCollections = allowedCollections;
+	copy->sumSource = sumSource;
+	copy->sumKeyPath = sumKeyPath;
+	
+	return copy;
+}
+
+@end
@@ -0,0 +1,42 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseExtensionTransaction.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseCountViewTransaction : YapDatabaseExtensionTransaction
+
+/**
+ * Returns the number of rows in the given group.
+ * Returns zero if there are no rows in the group (or the group doesn't exist).
+**/
+- (NSUInteger)numberOfItemsInGroup:(NSString *)group;
+
+/**
+ * Returns the sum of the extracted values (see YapDatabaseCountViewOptions.sumKeyPath) in the given group.
+ * Returns zero if sums aren't tracked, or if there are no rows in the group.
+**/
+- (double)sumInGroup:(NSString *)group;
+
+/**
+ * Returns the total number of rows, across all groups.
+**/
+- (NSUInteger)numberOfItemsInAllGroups;
+
+/**
+ * Returns the number of (non-empty) groups.
+**/
+- (NSUInteger)numberOfGroups;
+
+/**
+ * Returns the (non-empty) groups, in no particular order.
+**/
+- (NSArray<NSString *> *)allGroups;
+
+/**
+ * Enumerates the (non-empty) groups, in no particular order.
+**/
+- (void)enumerateGroupsUsingBlock:(void (^)(NSString *group, NSUInteger count, double sum, BOOL *stop))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,947 @@
+#import "YapDatabaseCountViewTransaction.h"
+#import "YapDatabaseCountViewPrivate.h"
+
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseString.h"
+#import "YapDatabaseExtensionPrivate.h"
+#import "YapDatabaseExtensionPopulation.h"
+
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+static NSString *const ext_key_classVersion = @"classVersion";
+static NSString *const ext_key_versionTag   = @"versionTag";
+
+
+@implementation YapDatabaseCountViewTransaction
+
+- (id)initWithParentConnection:(YapDatabaseCountViewConnection *)inParentConnection
+           databaseTransaction:(YapDatabaseReadTransaction *)inDatabaseTransaction
+{
+	if ((self = [super init]))
+	{
+		parentConnection = inParentConnection;
+		databaseTransaction = inDatabaseTransaction;
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Extension Lifecycle
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+ *
+ * This method is called to create any necessary tables (if needed),
+ * as well as populate the counts (if needed) by enumerating over the existing rows in the database.
+**/
+- (BOOL)createIfNeeded
+{
+	int oldClassVersion = 0;
+	BOOL hasOldClassVersion = [self getIntValue:&oldClassVersion forExtensionKey:ext_key_classVersion persistent:YES];
+	
+	int classVersion = YAP_DATABASE_COUNT_VIEW_CLASS_VERSION;
+	
+	NSString *versionTag = parentConnection->parent->versionTag;
+	
+	if (oldClassVersion != classVersion)
+	{
+		// First time registration (or at least for this version)
+		
+		if (hasOldClassVersion) {
+			if (![self dropTable]) return NO;
+		}
+		
+		if (![self createTable]) return NO;
+		if (![self populate]) return NO;
+		
+		[self setIntValue:classVersion forExtensionKey:ext_key_classVersion persistent:YES];
+		[self setStringValue:versionTag forExtensionKey:ext_key_versionTag persistent:YES];
+	}
+	else
+	{
+		// Check user-supplied versionTag.
+		// We may need to re-populate the database if it changed.
+		
+		NSString *oldVersionTag = [self stringValueForExtensionKey:ext_key_versionTag persistent:YES];
+		
+		if (![oldVersionTag isEqualToString:versionTag])
+		{
+			if (![self dropTable]) return NO;
+			if (![self createTable]) return NO;
+			if (![self populate]) return NO;
+			
+			[self setStringValue:versionTag forExtensionKey:ext_key_versionTag persistent:YES];
+		}
+	}
+	
+	return YES;
+}
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+ *
+ * This method is called to prepare the transaction for use.
+ *
+ * Remember, an extension transaction is a very short lived object.
+ * Thus it stores the majority of its state within the extension connection (the parent).
+ *
+ * Return YES if completed successfully, or if already prepared.
+ * Return NO if some kind of error occured.
+**/
+- (BOOL)prepareIfNeeded
+{
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * This method is called, if needed, to drop the old table.
+**/
+- (BOOL)dropTable
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *tableName = [self tableName];
+	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
+	
+	int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed dropping count view table (%@): %d %s",
+		            THIS_METHOD, dropTable, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * This method is called, if needed, to create the table for the counts.
+**/
+- (BOOL)createTable
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *tableName = [self tableName];
+	
+	YDBLogVerbose(@"Creating count view table for registeredName(%@): %@", [self registeredName], tableName);
+	
+	NSString *createTable = [NSString stringWithFormat:
+	  @"CREATE TABLE IF NOT EXISTS \"%@\""
+	  @" (\"group\" TEXT PRIMARY KEY,"
+	  @"  \"count\" INTEGER,"
+	  @"  \"sum\" REAL"
+	  @" );", tableName];
+	
+	int status = sqlite3_exec(db, [createTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed creating count view table (%@): %d %s",
+		            THIS_METHOD, tableName, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * This method is called, if needed, to populate the counts.
+ * It does so by enumerating the rows in the database, and invoking the grouping block for each.
+**/
+- (BOOL)populate
+{
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+	// The table was just created, so we start from scratch.
+	// Every group we count is marked as dirty, and written to the table during the flush.
+	
+	parentConnection->counts = [[NSMutableDictionary alloc] init];
+	
+	__unsafe_unretained YapDatabaseCountView *countView = parentConnection->parent;
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = countView->options.allowedCollections;
+	
+	YapDatabaseBlockType blockType = YapDatabaseBlockTypeWithKey;
+	if (countView->needsObject)
+		blockType |= YapDatabaseBlockType_ObjectFlag;
+	if (countView->needsMetadata)
+		blockType |= YapDatabaseBlockType_MetadataFlag;
+	
+	YapDatabaseExtensionPopulation *population =
+	  ((YapDatabaseReadWriteTransaction *)databaseTransaction)->extensionPopulation;
+	
+	if (population)
+	{
+		// Multiple extensions are being registered together.
+		// The rows will be handed to us during a shared enumeration of the database.
+		
+		YapDatabaseExtensionPopulationBlock block =
+		^(int64_t __unused rowid, NSString *collection, NSString *key, id object, id metadata){
+			
+			[self addRowWithCollection:collection key:key object:object metadata:metadata sign:1];
+		};
+		
+		[population addParticipantWithName:[self registeredName]
+		                allowedCollections:allowedCollections
+		                         blockType:blockType
+		                            filter:nil
+		                             block:block
+		                        completion:nil];
+		return YES;
+	}
+	
+	NSArray *collections = nil;
+	if (allowedCollections)
+	{
+		NSMutableArray *allowed = [NSMutableArray array];
+		[databaseTransaction enumerateCollectionsUsingBlock:^(NSString *collection, BOOL __unused *stop) {
+			
+			if ([allowedCollections isAllowed:collection])
+			{
+				[allowed addObject:collection];
+			}
+		}];
+		
+		if ([allowed count] == 0) return YES;
+		collections = allowed;
+	}
+	
+	if (blockType == YapDatabaseBlockTypeWithKey)
+	{
+		void (^enumBlock)(int64_t rowid, NSString *collection, NSString *key, BOOL *stop);
+		enumBlock = ^(int64_t __unused rowid, NSString *collection, NSString *key, BOOL __unused *stop) {
+			
+			[self addRowWithCollection:collection key:key object:nil metadata:nil sign:1];
+		};
+		
+		if (collections)
+			[databaseTransaction _enumerateKeysInCollections:collections usingBlock:enumBlock];
+		else
+			[databaseTransaction _enumerateKeysInAllCollectionsUsingBlock:enumBlock];
+	}
+	else if (blockType == YapDatabaseBlockTypeWithObject)
+	{
+		void (^enumBlock)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop);
+		enumBlock = ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, BOOL __unused *stop) {
+			
+			[self addRowWithCollection:collection key:key object:object metadata:nil sign:1];
+		};
+		
+		if (collections)
+			[databaseTransaction _enumerateKeysAndObjectsInCollections:collections usingBlock:enumBlock];
+		else
+			[databaseTransaction _enumerateKeysAndObjectsInAllCollectionsUsingBlock:enumBlock];
+	}
+	else if (blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		void (^enumBlock)(int64_t rowid, NSString *collection, NSString *key, id metadata, BOOL *stop);
+		enumBlock = ^(int64_t __unused rowid, NSString *collection, NSString *key, id metadata, BOOL __unused *stop) {
+			
+			[self addRowWithCollection:collection key:key object:nil metadata:metadata sign:1];
+		};
+		
+		if (collections)
+			[databaseTransaction _enumerateKeysAndMetadataInCollections:collections usingBlock:enumBlock];
+		else
+			[databaseTransaction _enumerateKeysAndMetadataInAllCollectionsUsingBlock:enumBlock];
+	}
+	else // if (blockType == YapDatabaseBlockTypeWithRow)
+	{
+		void (^enumBlock)(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop);
+		enumBlock = ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, id metadata, BOOL __unused *stop) {
+			
+			[self addRowWithCollection:collection key:key object:object metadata:metadata sign:1];
+		};
+		
+		if (collections)
+			[databaseTransaction _enumerateRowsInCollections:collections usingBlock:enumBlock];
+		else
+			[databaseTransaction _enumerateRowsInAllCollectionsUsingBlock:enumBlock];
+	}
+	
+	return YES;
+	
+#pragma clang diagnostic pop
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Accessors
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+**/
+- (YapDatabaseReadTransaction *)databaseTransaction
+{
+	return databaseTransaction;
+}
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+**/
+- (YapDatabaseExtensionConnection *)extensionConnection
+{
+	return parentConnection;
+}
+
+- (NSString *)registeredName
+{
+	return [parentConnection->parent registeredName];
+}
+
+- (NSString *)tableName
+{
+	return [parentConnection->parent tableName];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Logic
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the counts of every group, loading them from the table if needed.
+ * The table has a single row per group, so this is cheap, regardless of the number of rows in the database.
+**/
+- (NSMutableDictionary<NSString *, YapDatabaseCountViewCounts *> *)counts
+{
+	if (parentConnection->counts) {
+		return parentConnection->counts;
+	}
+	
+	NSMutableDictionary *counts = [[NSMutableDictionary alloc] init];
+	
+	sqlite3_stmt *statement = [parentConnection enumerateStatement];
+	if (statement)
+	{
+		int status;
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			const unsigned char *text = sqlite3_column_text(statement, SQLITE_COLUMN_START);
+			int textSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
+			
+			NSString *group = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+			
+			int64_t count = sqlite3_column_int64(statement, SQLITE_COLUMN_START + 1);
+			double sum = sqlite3_column_double(statement, SQLITE_COLUMN_START + 2);
+			
+			if (group && (count > 0))
+			{
+				counts[group] = [[YapDatabaseCountViewCounts alloc] initWithCount:(NSUInteger)count sum:sum];
+			}
+		}
+		
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		}
+		
+		sqlite3_reset(statement);
+	}
+	
+	parentConnection->counts = counts;
+	return counts;
+}
+
+/**
+ * Invokes the grouping block for the given row.
+**/
+- (NSString *)groupForCollection:(NSString *)collection key:(NSString *)key object:(id)object metadata:(id)metadata
+{
+	__unsafe_unretained YapDatabaseViewGrouping *grouping = parentConnection->parent->grouping;
+	
+	if (grouping.blockType == YapDatabaseBlockTypeWithKey)
+	{
+		__unsafe_unretained YapDatabaseViewGroupingWithKeyBlock groupingBlock =
+		  (YapDatabaseViewGroupingWithKeyBlock)grouping.block;
+		
+		return groupingBlock(databaseTransaction, collection, key);
+	}
+	else if (grouping.blockType == YapDatabaseBlockTypeWithObject)
+	{
+		__unsafe_unretained YapDatabaseViewGroupingWithObjectBlock groupingBlock =
+		  (YapDatabaseViewGroupingWithObjectBlock)grouping.block;
+		
+		return groupingBlock(databaseTransaction, collection, key, object);
+	}
+	else if (grouping.blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		__unsafe_unretained YapDatabaseViewGroupingWithMetadataBlock groupingBlock =
+		  (YapDatabaseViewGroupingWithMetadataBlock)grouping.block;
+		
+		return groupingBlock(databaseTransaction, collection, key, metadata);
+	}
+	else
+	{
+		__unsafe_unretained YapDatabaseViewGroupingWithRowBlock groupingBlock =
+		  (YapDatabaseViewGroupingWithRowBlock)grouping.block;
+		
+		return groupingBlock(databaseTransaction, collection, key, object, metadata);
+	}
+}
+
+/**
+ * Extracts the value to sum (via the options.sumSource & options.sumKeyPath).
+ * Values that aren't numbers count as zero.
+**/
+- (double)sumForCollection:(NSString *)collection key:(NSString *)key object:(id)object metadata:(id)metadata
+{
+	__unsafe_unretained YapDatabaseCountViewOptions *options = parentConnection->parent->options;
+	
+	NSString *keyPath = options.sumKeyPath;
+	if (keyPath == nil) return 0.0;
+	
+	id value = nil;
+	switch (options.sumSource)
+	{
+		case YapDatabaseViewKeyPathSourceCollection : value = collection; break;
+		case YapDatabaseViewKeyPathSourceKey        : value = key;        break;
+		case YapDatabaseViewKeyPathSourceObject     : value = object;     break;
+		case YapDatabaseViewKeyPathSourceMetadata   : value = metadata;   break;
+	}
+	
+	if (value && (value != [NSNull null]))
+		value = [value valueForKeyPath:keyPath];
+	
+	if ([value isKindOfClass:[NSNumber class]])
+		return [(NSNumber *)value doubleValue];
+	else
+		return 0.0;
+}
+
+/**
+ * Adds (sign == 1) or subtracts (sign == -1) the row from the counts of its group.
+**/
+- (void)addRowWithCollection:(NSString *)collection
+                         key:(NSString *)key
+                      object:(id)object
+                    metadata:(id)metadata
+                        sign:(int)sign
+{
+	NSString *group = [self groupForCollection:collection key:key object:object metadata:metadata];
+	if (group == nil) return;
+	
+	double sum = [self sumForCollection:collection key:key object:object metadata:metadata];
+	
+	NSMutableDictionary<NSString *, YapDatabaseCountViewCounts *> *counts = [self counts];
+	YapDatabaseCountViewCounts *oldCounts = counts[group];
+	
+	NSUInteger oldCount = oldCounts ? oldCounts->count : 0;
+	double oldSum = oldCounts ? oldCounts->sum : 0.0;
+	
+	if (sign > 0)
+	{
+		counts[group] = [[YapDatabaseCountViewCounts alloc] initWithCount:(oldCount + 1) sum:(oldSum + sum)];
+	}
+	else if (oldCount > 1)
+	{
+		counts[group] = [[YapDatabaseCountViewCounts alloc] initWithCount:(oldCount - 1) sum:(oldSum - sum)];
+	}
+	else
+	{
+		if (oldCount == 0)
+		{
+			YDBLogWarn(@"%@: Removing row <%@, %@> from empty group(%@)."
+			           @" Is the grouping block a pure function of the row?", THIS_METHOD, collection, key, group);
+		}
+		
+		[counts removeObjectForKey:group];
+	}
+	
+	[parentConnection->dirtyGroups addObject:group];
+}
+
+/**
+ * Subtracts the (not yet modified) row from the counts of its group.
+ * This is invoked from the pre-op hooks, so the database still contains the current values of the row.
+**/
+- (void)removeExistingRowWithCollectionKey:(YapCollectionKey *)collectionKey rowid:(int64_t)rowid
+{
+	__unsafe_unretained YapDatabaseCountView *countView = parentConnection->parent;
+	
+	id object = nil;
+	id metadata = nil;
+	
+	if (countView->needsObject || countView->needsMetadata)
+	{
+		[databaseTransaction getObject:(countView->needsObject ? &object : NULL)
+		                      metadata:(countView->needsMetadata ? &metadata : NULL)
+		              forCollectionKey:collectionKey
+		                     withRowid:rowid];
+	}
+	
+	[self addRowWithCollection:collectionKey.collection
+	                       key:collectionKey.key
+	                    object:object
+	                  metadata:metadata
+	                      sign:-1];
+}
+
+- (BOOL)isAllowedCollection:(NSString *)collection
+{
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections =
+	  parentConnection->parent->options.allowedCollections;
+	
+	return (allowedCollections == nil) || [allowedCollections isAllowed:collection];
+}
+
+- (BOOL)isAllowedCollectionKey:(YapCollectionKey *)collectionKey
+{
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections =
+	  parentConnection->parent->options.allowedCollections;
+	
+	return (allowedCollections == nil) || [allowedCollections isAllowedCollectionKey:collectionKey];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Cleanup & Commit
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+ *
+ * Writes the counts of every modified group to the table.
+**/
+- (void)flushPendingChangesToExtensionTables
+{
+	YDBLogAutoTrace();
+	
+	if ([parentConnection->dirtyGroups count] == 0) return;
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	sqlite3_stmt *setStatement = [parentConnection setStatement];
+	sqlite3_stmt *removeStatement = [parentConnection removeStatement];
+	
+	if (setStatement == NULL || removeStatement == NULL) {
+		return;
+	}
+	
+	NSDictionary<NSString *, YapDatabaseCountViewCounts *> *counts = parentConnection->counts;
+	
+	for (NSString *group in parentConnection->dirtyGroups)
+	{
+		YapDatabaseCountViewCounts *groupCounts = counts[group];
+		
+		sqlite3_stmt *statement = groupCounts ? setStatement : removeStatement;
+		
+		YapDatabaseString _group; MakeYapDatabaseString(&_group, group);
+		sqlite3_bind_text(statement, SQLITE_BIND_START, _group.str, _group.length, SQLITE_STATIC);
+		
+		if (groupCounts)
+		{
+			sqlite3_bind_int64(statement, SQLITE_BIND_START + 1, (sqlite3_int64)groupCounts->count);
+			sqlite3_bind_double(statement, SQLITE_BIND_START + 2, groupCounts->sum);
+		}
+		
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		FreeYapDatabaseString(&_group);
+	}
+}
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+**/
+- (void)didCommitTransaction
+{
+	YDBLogAutoTrace();
+	
+	[parentConnection postCommitCleanup];
+	
+	// An extensionTransaction is only valid within the scope of its encompassing databaseTransaction.
+	// I imagine this may occasionally be misunderstood, and developers may attempt to store the extension in an ivar,
+	// and then use it outside the context of the database transaction block.
+	// Thus, this code is here as a safety net to ensure that such accidental misuse doesn't do any damage.
+	
+	parentConnection = nil;    // Do not remove !
+	databaseTransaction = nil; // Do not remove !
+}
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+**/
+- (void)didRollbackTransaction
+{
+	YDBLogAutoTrace();
+	
+	[parentConnection postRollbackCleanup];
+	
+	// An extensionTransaction is only valid within the scope of its encompassing databaseTransaction.
+	// I imagine this may occasionally be misunderstood, and developers may attempt to store the extension in an ivar,
+	// and then use it outside the context of the database transaction block.
+	// Thus, this code is here as a safety net to ensure that such accidental misuse doesn't do any damage.
+	
+	parentConnection = nil;    // Do not remove !
+	databaseTransaction = nil; // Do not remove !
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Transaction Hooks
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didInsertObject:(id)object
+       forCollectionKey:(YapCollectionKey *)collectionKey
+           withMetadata:(id)metadata
+                  rowid:(int64_t __unused)rowid
+{
+	YDBLogAutoTrace();
+	
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	[self addRowWithCollection:collectionKey.collection
+	                       key:collectionKey.key
+	                    object:object
+	                  metadata:metadata
+	                      sign:1];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (void)willUpdateObject:(id __unused)object
+        forCollectionKey:(YapCollectionKey *)collectionKey
+            withMetadata:(id __unused)metadata
+                   rowid:(int64_t)rowid
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseCountView *countView = parentConnection->parent;
+	
+	if (!countView->processObjectModified && !countView->processMetadataModified) return;
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	[self removeExistingRowWithCollectionKey:collectionKey rowid:rowid];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didUpdateObject:(id)object
+       forCollectionKey:(YapCollectionKey *)collectionKey
+           withMetadata:(id)metadata
+                  rowid:(int64_t __unused)rowid
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseCountView *countView = parentConnection->parent;
+	
+	if (!countView->processObjectModified && !countView->processMetadataModified) return;
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	[self addRowWithCollection:collectionKey.collection
+	                       key:collectionKey.key
+	                    object:object
+	                  metadata:metadata
+	                      sign:1];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (void)willReplaceObject:(id __unused)object forCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid
+{
+	YDBLogAutoTrace();
+	
+	if (!parentConnection->parent->processObjectModified) return;
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	[self removeExistingRowWithCollectionKey:collectionKey rowid:rowid];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didReplaceObject:(id)object forCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseCountView *countView = parentConnection->parent;
+	
+	if (!countView->processObjectModified) return;
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	id metadata = nil;
+	if (countView->needsMetadata)
+	{
+		metadata = [databaseTransaction metadataForCollectionKey:collectionKey withRowid:rowid];
+	}
+	
+	[self addRowWithCollection:collectionKey.collection
+	                       key:collectionKey.key
+	                    object:object
+	                  metadata:metadata
+	                      sign:1];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (void)willReplaceMetadata:(id __unused)metadata
+           forCollectionKey:(YapCollectionKey *)collectionKey
+                  withRowid:(int64_t)rowid
+{
+	YDBLogAutoTrace();
+	
+	if (!parentConnection->parent->processMetadataModified) return;
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	[self removeExistingRowWithCollectionKey:collectionKey rowid:rowid];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didReplaceMetadata:(id)metadata forCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseCountView *countView = parentConnection->parent;
+	
+	if (!countView->processMetadataModified) return;
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	id object = nil;
+	if (countView->needsObject)
+	{
+		object = [databaseTransaction objectForCollectionKey:collectionKey withRowid:rowid];
+	}
+	
+	[self addRowWithCollection:collectionKey.collection
+	                       key:collectionKey.key
+	                    object:object
+	                  metadata:metadata
+	                      sign:1];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+ *
+ * Touching a row doesn't change its values, so it doesn't change any counts.
+**/
+- (void)didTouchObjectForCollectionKey:(YapCollectionKey __unused *)collectionKey withRowid:(int64_t __unused)rowid
+{
+	// Nothing to do for this extension
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didTouchMetadataForCollectionKey:(YapCollectionKey __unused *)collectionKey withRowid:(int64_t __unused)rowid
+{
+	// Nothing to do for this extension
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didTouchRowForCollectionKey:(YapCollectionKey __unused *)collectionKey withRowid:(int64_t __unused)rowid
+{
+	// Nothing to do for this extension
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (void)willRemoveObjectForCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid
+{
+	YDBLogAutoTrace();
+	
+	if (![self isAllowedCollectionKey:collectionKey]) return;
+	
+	[self removeExistingRowWithCollectionKey:collectionKey rowid:rowid];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didRemoveObjectForCollectionKey:(YapCollectionKey __unused *)collectionKey withRowid:(int64_t __unused)rowid
+{
+	// Handled in willRemoveObjectForCollectionKey:withRowid:
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (void)willRemoveObjectsForKeys:(NSArray *)keys inCollection:(NSString *)collection withRowids:(NSArray *)rowids
+{
+	YDBLogAutoTrace();
+	
+	if (![self isAllowedCollection:collection]) return;
+	
+	__unsafe_unretained YapDatabaseCountView *countView = parentConnection->parent;
+	
+	if (!countView->needsObject && !countView->needsMetadata)
+	{
+		for (NSString *key in keys)
+		{
+			[self addRowWithCollection:collection key:key object:nil metadata:nil sign:-1];
+		}
+		return;
+	}
+	
+	// Fetch all the rows at once (rather than a query per row).
+	
+	NSArray<YapCollectionKey *> *collectionKeys = nil;
+	NSArray *objects = nil;
+	NSArray *metadata = nil;
+	
+	[databaseTransaction getCollectionKeys:&collectionKeys
+	                               objects:(countView->needsObject ? &objects : NULL)
+	                              metadata:(countView->needsMetadata ? &metadata : NULL)
+	                             forRowids:rowids];
+	
+	NSNull *null = [NSNull null];
+	NSUInteger count = [rowids count];
+	
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		YapCollectionKey *ck = collectionKeys[i];
+		if ((id)ck == null) continue;
+		
+		id object = objects[i];
+		if (object == null) object = nil;
+		
+		id meta = metadata[i];
+		if (meta == null) meta = nil;
+		
+		[self addRowWithCollection:ck.collection key:ck.key object:object metadata:meta sign:-1];
+	}
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didRemoveObjectsForKeys:(NSArray __unused *)keys
+                   inCollection:(NSString __unused *)collection
+                     withRowids:(NSArray __unused *)rowids
+{
+	// Handled in willRemoveObjectsForKeys:inCollection:withRowids:
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (void)willRemoveAllObjectsInAllCollections
+{
+	YDBLogAutoTrace();
+	
+	NSMutableDictionary<NSString *, YapDatabaseCountViewCounts *> *counts = [self counts];
+	
+	[parentConnection->dirtyGroups addObjectsFromArray:[counts allKeys]];
+	[counts removeAllObjects];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didRemoveAllObjectsInAllCollections
+{
+	// Handled in willRemoveAllObjectsInAllCollections
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Public API
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)numberOfItemsInGroup:(NSString *)group
+{
+	if (group == nil) return 0;
+	
+	YapDatabaseCountViewCounts *groupCounts = [self counts][group];
+	return groupCounts ? groupCounts->count : 0;
+}
+
+- (double)sumInGroup:(NSString *)group
+{
+	if (group == nil) return 0.0;
+	
+	YapDatabaseCountViewCounts *groupCounts = [self counts][group];
+	return groupCounts ? groupCounts->sum : 0.0;
+}
+
+- (NSUInteger)numberOfItemsInAllGroups
+{
+	__block NSUInteger total = 0;
+	
+	[[self counts] enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString __unused *group, YapDatabaseCountViewCounts *groupCounts, BOOL __unused *stop)
+	{
+		total += groupCounts->count;
+	}];
+	
+	return total;
+}
+
+- (NSUInteger)numberOfGroups
+{
+	return [[self counts] count];
+}
+
+- (NSArray<NSString *> *)allGroups
+{
+	return [[self counts] allKeys];
+}
+
+- (void)enumerateGroupsUsingBlock:(void (^)(NSString *group, NSUInteger count, double sum, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	// Enumerate a copy, so the block may modify the database.
+	
+	NSDictionary<NSString *, YapDatabaseCountViewCounts *> *counts = [[self counts] copy];
+	
+	[counts enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *group, YapDatabaseCountViewCounts *groupCounts, BOOL *stop)
+	{
+		block(group, groupCounts->count, groupCounts->sum, stop);
+	}];
+}
+
+@end
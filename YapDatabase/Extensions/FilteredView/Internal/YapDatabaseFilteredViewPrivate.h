@@ -31,6 +31,8 @@ static NSString *const changeset_key_filtering = @"filtering";
 	YapDatabaseViewFilteringBlock block;
 	YapDatabaseBlockType          blockType;
 	YapDatabaseBlockInvoke        blockInvokeOptions;
+	
+	BOOL allowsConcurrentFiltering;
 }
 
 @end
@@ -68,3 +70,36 @@ static NSString *const changeset_key_filtering = @"filtering";
           versionTag:(NSString *)newVersionTag;
 
 @end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Flags for the rowHook ivars of YapDatabaseFilteredViewTransaction.
+**/
+enum {
+	YDB_RowHookHasObject   = 1 << 0,
+	YDB_RowHookHasMetadata = 1 << 1,
+	YDB_RowHookHasGroup    = 1 << 2
+};
+
+@interface YapDatabaseFilteredViewTransaction () {
+@public
+	
+	// What the current row hook learned about the row:
+	// the object & metadata (if fetched), and the group the row ended up in (nil if not in this view).
+	//
+	// Row hooks are invoked on a parentView before its dependents.
+	// So a filteredView stacked on another filteredView reuses these,
+	// and a chain of filteredViews fetches the row (at most) once per change.
+	
+	int64_t rowHookRowid;
+	YapCollectionKey *rowHookCollectionKey;
+	id rowHookObject;
+	id rowHookMetadata;
+	NSString *rowHookGroup;
+	int rowHookFlags;
+}
+
+@end
@@ -36,6 +36,29 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)setFiltering:(YapDatabaseViewFiltering *)filtering
           versionTag:(nullable NSString *)tag;
 
+/**
+ * Same as above, but allows you to declare how the new filter relates to the old one.
+ *
+ * When a filter is refined interactively (e.g. the user types another character into a search field),
+ * the new filter is often known to be stricter (or looser) than the old one.
+ * In which case the view only needs to test the affected rows:
+ *
+ * - YapDatabaseViewFilteringChangeStricter:
+ *     Only the rows currently in the filteredView are passed to the new filter.
+ *     Rows of the parentView that aren't in the filteredView are assumed to still be disallowed.
+ *
+ * - YapDatabaseViewFilteringChangeLooser:
+ *     Only the rows of the parentView that aren't currently in the filteredView are passed to the new filter.
+ *     Rows that are already in the filteredView are assumed to still be allowed.
+ *
+ * Important: If the declared change is wrong, the filteredView will contain rows that the new filter disallows,
+ * or be missing rows that the new filter allows (until the filter is changed again).
+ * When in doubt, use YapDatabaseViewFilteringChangeUnknown (which is what the method above does).
+**/
+- (void)setFiltering:(YapDatabaseViewFiltering *)filtering
+          versionTag:(nullable NSString *)tag
+              change:(YapDatabaseViewFilteringChange)change;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -21,6 +21,28 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+/**
+ * The number of parentView rows per batch, when populating the view with concurrent filtering.
+**/
+static NSUInteger const YapDatabaseFilteredViewConcurrentBatchSize = 512;
+
+/**
+ * A row of the parentView that is being filtered concurrently (see populateViewConcurrently:).
+**/
+@interface YapDatabaseFilteredViewPopulationItem : NSObject {
+@public
+	
+	int64_t rowid;
+	YapCollectionKey *collectionKey;
+	id object;
+	id metadata;
+	BOOL allowed;
+}
+@end
+
+@implementation YapDatabaseFilteredViewPopulationItem
+@end
+
 
 @implementation YapDatabaseFilteredViewTransaction
 
@@ -58,6 +80,12 @@
 	
 	[filteredViewConnection getFiltering:&filtering];
 	
+	if (filtering->allowsConcurrentFiltering)
+	{
+		[self populateViewConcurrently:filtering];
+		return YES;
+	}
+	
 	BOOL (^InvokeFilterBlock)(NSString *group, int64_t rowid, YapCollectionKey *ck);
 	
 	if (filtering->blockType == YapDatabaseBlockTypeWithKey)
@@ -134,6 +162,128 @@
 	return YES;
 }
 
+/**
+ * Used by populateView if the filtering allowsConcurrentFiltering.
+ *
+ * The rows of each parentView group are processed in batches.
+ * For each batch, the objects and/or metadata (as required by the blockType) are fetched on this thread.
+ * Then the filterBlock is invoked concurrently for every row in the batch.
+ * And finally the allowed rows are inserted (in parentView order) on this thread.
+ *
+ * Only the filterBlock runs on other threads. The transaction (and the view) is only touched from this thread.
+**/
+- (void)populateViewConcurrently:(YapDatabaseViewFiltering *)filtering
+{
+	__unsafe_unretained YapDatabaseFilteredView *filteredView =
+	  (YapDatabaseFilteredView *)parentConnection->parent;
+	
+	__unsafe_unretained YapDatabaseViewTransaction *parentViewTransaction =
+	  [databaseTransaction ext:filteredView->parentViewName];
+	
+	YapDatabaseBlockType blockType = filtering->blockType;
+	
+	BOOL needsObject = (blockType == YapDatabaseBlockTypeWithObject) || (blockType == YapDatabaseBlockTypeWithRow);
+	BOOL needsMetadata = (blockType == YapDatabaseBlockTypeWithMetadata) || (blockType == YapDatabaseBlockTypeWithRow);
+	
+	YapDatabaseViewFilteringBlock filterBlock = filtering->block;
+	YapDatabaseReadTransaction *transaction = databaseTransaction;
+	
+	dispatch_queue_t queue = dispatch_get_global_queue(qos_class_self(), 0);
+	
+	for (NSString *group in [parentViewTransaction allGroups])
+	{
+		__block NSUInteger filteredIndex = 0;
+		
+		NSMutableArray<YapDatabaseFilteredViewPopulationItem *> *batch =
+		  [[NSMutableArray alloc] initWithCapacity:YapDatabaseFilteredViewConcurrentBatchSize];
+		
+		void (^FlushBatch)(void) = ^{
+			
+			NSUInteger count = batch.count;
+			if (count == 0) return;
+			
+			dispatch_apply(count, queue, ^(size_t i) {
+				
+				__unsafe_unretained YapDatabaseFilteredViewPopulationItem *item = batch[i];
+				__unsafe_unretained YapCollectionKey *ck = item->collectionKey;
+				
+				if (blockType == YapDatabaseBlockTypeWithKey)
+				{
+					item->allowed = ((YapDatabaseViewFilteringWithKeyBlock)filterBlock)
+					  (transaction, group, ck.collection, ck.key);
+				}
+				else if (blockType == YapDatabaseBlockTypeWithObject)
+				{
+					item->allowed = ((YapDatabaseViewFilteringWithObjectBlock)filterBlock)
+					  (transaction, group, ck.collection, ck.key, item->object);
+				}
+				else if (blockType == YapDatabaseBlockTypeWithMetadata)
+				{
+					item->allowed = ((YapDatabaseViewFilteringWithMetadataBlock)filterBlock)
+					  (transaction, group, ck.collection, ck.key, item->metadata);
+				}
+				else // if (blockType == YapDatabaseBlockTypeWithRow)
+				{
+					item->allowed = ((YapDatabaseViewFilteringWithRowBlock)filterBlock)
+					  (transaction, group, ck.collection, ck.key, item->object, item->metadata);
+				}
+			});
+			
+			for (YapDatabaseFilteredViewPopulationItem *item in batch)
+			{
+				if (item->allowed)
+				{
+					[self insertRowid:item->rowid collectionKey:item->collectionKey
+					                                   inGroup:group
+					                                   atIndex:filteredIndex];
+					
+					filteredIndex++;
+				}
+			}
+			
+			[batch removeAllObjects];
+		};
+		
+		[parentViewTransaction enumerateRowidsInGroup:group
+		                                   usingBlock:^(int64_t rowid, NSUInteger __unused parentIndex, BOOL __unused *stop)
+		{
+			YapDatabaseFilteredViewPopulationItem *item = [[YapDatabaseFilteredViewPopulationItem alloc] init];
+			item->rowid = rowid;
+			item->collectionKey = [transaction collectionKeyForRowid:rowid];
+			
+			if (needsObject && needsMetadata)
+			{
+				id object = nil;
+				id metadata = nil;
+				[transaction getObject:&object metadata:&metadata forCollectionKey:item->collectionKey withRowid:rowid];
+				
+				item->object = object;
+				item->metadata = metadata;
+			}
+			else if (needsObject)
+			{
+				item->object = [transaction objectForCollectionKey:item->collectionKey withRowid:rowid];
+			}
+			else if (needsMetadata)
+			{
+				item->metadata = [transaction metadataForCollectionKey:item->collectionKey withRowid:rowid];
+			}
+			
+			[batch addObject:item];
+			
+			if (batch.count >= YapDatabaseFilteredViewConcurrentBatchSize)
+			{
+				// Inserting into this view, while enumerating the parentView, is fine.
+				// (The existing populate algorithm does the same.)
+				
+				FlushBatch();
+			}
+		}];
+		
+		FlushBatch();
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Repopulate
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -409,12 +559,59 @@
 	}
 }
 
+/**
+ * This method is invoked if:
+ *
+ * - Our parentView is a filteredView, and its filteringBlock was changed to a stricter one.
+ * - A parentView of our parentView is a filteredView, and the same happened to it.
+ *
+ * The parentView only lost rows, so the only thing that can happen to our rows is that they're removed too.
+ * Thus the filterBlock doesn't need to be invoked, and the parentView doesn't need to be enumerated.
+**/
+- (void)repopulateViewDueToStricterParentFiltering
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseFilteredView *filteredView =
+	  (YapDatabaseFilteredView *)parentConnection->parent;
+	
+	YapDatabaseViewTransaction *parentViewTransaction =
+	  [databaseTransaction ext:filteredView->parentViewName];
+	
+	for (NSString *group in [self allGroups])
+	{
+		if (![parentViewTransaction hasGroup:group])
+		{
+			[self removeAllRowidsInGroup:group];
+			continue;
+		}
+		
+		NSUInteger index = 0;
+		int64_t rowid = 0;
+		
+		while ([self getRowid:&rowid atIndex:index inGroup:group])
+		{
+			if ([parentViewTransaction containsRowid:rowid])
+			{
+				index++;
+			}
+			else
+			{
+				YapCollectionKey *ck = [databaseTransaction collectionKeyForRowid:rowid];
+				[self removeRowid:rowid collectionKey:ck atIndex:index inGroup:group];
+			}
+		}
+	}
+}
+
 /**
  * This method is invoked if:
  *
  * - The filteringBlock of this instance is changed
+ *
+ * If the change is known to be stricter (or looser), only the affected rows are passed to the filterBlock.
 **/
-- (void)repopulateViewDueToFilteringBlockChange
+- (void)repopulateViewDueToFilteringBlockChange:(YapDatabaseViewFilteringChange)change
 {
 	YDBLogAutoTrace();
 	
@@ -491,6 +688,43 @@
 	
 	// Start the algorithm.
 	
+	if (change == YapDatabaseViewFilteringChangeStricter)
+	{
+		// The new filter only allows a subset of what the old filter allowed.
+		// So we only need to test the rows that are currently in the view.
+		// And the parentView doesn't need to be enumerated at all.
+		
+		for (NSString *group in [self allGroups])
+		{
+			NSUInteger index = 0;
+			int64_t rowid = 0;
+			
+			while ([self getRowid:&rowid atIndex:index inGroup:group])
+			{
+				YapCollectionKey *ck = [databaseTransaction collectionKeyForRowid:rowid];
+				
+				if (InvokeFilterBlock(group, rowid, ck))
+				{
+					// The row was previously in the view (allowed by previous filter),
+					// and is still in the view (allowed by new filter).
+					
+					index++;
+				}
+				else
+				{
+					// The row was previously in the view (allowed by previous filter),
+					// but is no longer in the view (disallowed by new filter).
+					
+					[self removeRowid:rowid collectionKey:ck atIndex:index inGroup:group];
+				}
+			}
+		}
+		
+		return;
+	}
+	
+	BOOL isLooser = (change == YapDatabaseViewFilteringChangeLooser);
+	
 	for (NSString *group in [parentViewTransaction allGroups])
 	{
 		__block BOOL existing = NO;
@@ -503,6 +737,16 @@
 		[parentViewTransaction enumerateRowidsInGroup:group
 		                                   usingBlock:^(int64_t rowid, NSUInteger __unused parentIndex, BOOL __unused *stop)
 		{
+			if (isLooser && existing && (existingRowid == rowid))
+			{
+				// The row was previously in the view (allowed by previous filter),
+				// and the new filter is looser. So it's still in the view.
+				
+				index++;
+				existing = [self getRowid:&existingRowid atIndex:index inGroup:group];
+				return;
+			}
+			
 			YapCollectionKey *ck = [self->databaseTransaction collectionKeyForRowid:rowid];
 			
 			if (InvokeFilterBlock(group, rowid, ck))
@@ -736,6 +980,97 @@
 #pragma mark Transaction Hooks
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Returns the transaction of our parentView,
+ * if it's a filteredView that has already processed the current row hook.
+**/
+- (YapDatabaseFilteredViewTransaction *)parentRowHookTransaction
+{
+	__unsafe_unretained YapDatabaseFilteredView *filteredView =
+	  (YapDatabaseFilteredView *)parentConnection->parent;
+	
+	id parentViewTransaction = [databaseTransaction ext:filteredView->parentViewName];
+	
+	if (![parentViewTransaction isKindOfClass:[YapDatabaseFilteredViewTransaction class]]) return nil;
+	
+	__unsafe_unretained YapDatabaseFilteredViewTransaction *parentTransaction =
+	  (YapDatabaseFilteredViewTransaction *)parentViewTransaction;
+	
+	if (parentTransaction->rowHookRowid != rowHookRowid) return nil;
+	if (![parentTransaction->rowHookCollectionKey isEqual:rowHookCollectionKey]) return nil;
+	
+	return parentTransaction;
+}
+
+/**
+ * Invoked at the start of every row hook, with whatever the hook was given.
+ * Anything our parentView already fetched for the same row is inherited.
+**/
+- (void)beginRowHookWithCollectionKey:(YapCollectionKey *)collectionKey
+                                rowid:(int64_t)rowid
+                               object:(id)object
+                             metadata:(id)metadata
+                                flags:(int)flags
+{
+	rowHookRowid = rowid;
+	rowHookCollectionKey = collectionKey;
+	rowHookObject = object;
+	rowHookMetadata = metadata;
+	rowHookGroup = nil;
+	rowHookFlags = flags;
+	
+	YapDatabaseFilteredViewTransaction *parentTransaction = [self parentRowHookTransaction];
+	if (parentTransaction)
+	{
+		if (!(rowHookFlags & YDB_RowHookHasObject) && (parentTransaction->rowHookFlags & YDB_RowHookHasObject))
+		{
+			rowHookObject = parentTransaction->rowHookObject;
+			rowHookFlags |= YDB_RowHookHasObject;
+		}
+		
+		if (!(rowHookFlags & YDB_RowHookHasMetadata) && (parentTransaction->rowHookFlags & YDB_RowHookHasMetadata))
+		{
+			rowHookMetadata = parentTransaction->rowHookMetadata;
+			rowHookFlags |= YDB_RowHookHasMetadata;
+		}
+	}
+}
+
+/**
+ * Invoked by the remove hooks, as the row (and thus its rowid) no longer refers to the same thing.
+**/
+- (void)clearRowHook
+{
+	rowHookRowid = 0;
+	rowHookCollectionKey = nil;
+	rowHookObject = nil;
+	rowHookMetadata = nil;
+	rowHookGroup = nil;
+	rowHookFlags = 0;
+}
+
+- (id)objectForRowHook
+{
+	if (!(rowHookFlags & YDB_RowHookHasObject))
+	{
+		rowHookObject = [databaseTransaction objectForCollectionKey:rowHookCollectionKey withRowid:rowHookRowid];
+		rowHookFlags |= YDB_RowHookHasObject;
+	}
+	
+	return rowHookObject;
+}
+
+- (id)metadataForRowHook
+{
+	if (!(rowHookFlags & YDB_RowHookHasMetadata))
+	{
+		rowHookMetadata = [databaseTransaction metadataForCollectionKey:rowHookCollectionKey withRowid:rowHookRowid];
+		rowHookFlags |= YDB_RowHookHasMetadata;
+	}
+	
+	return rowHookMetadata;
+}
+
 - (void)_didChangeWithRowid:(int64_t)rowid
               collectionKey:(YapCollectionKey *)collectionKey
                      object:(id)object
@@ -757,18 +1092,34 @@
 	
 	YapWhitelistBlacklist *allowedCollections = filteredView->options.allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
+		rowHookFlags |= YDB_RowHookHasGroup;
 		return;
 	}
 	
 	// Since our groupingBlock is the same as the parent's groupingBlock,
 	// just ask the parentViewTransaction for the group (which is cached info).
+	//
+	// If the parentView is a filteredView, it has just processed this very change,
+	// and already knows which group (if any) the row ended up in.
 	
-	YapDatabaseViewTransaction *parentViewTransaction =
-	  [databaseTransaction ext:filteredView->parentViewName];
+	NSString *group = nil;
+	
+	YapDatabaseFilteredViewTransaction *parentRowHookTransaction = [self parentRowHookTransaction];
+	if (parentRowHookTransaction && (parentRowHookTransaction->rowHookFlags & YDB_RowHookHasGroup))
+	{
+		group = parentRowHookTransaction->rowHookGroup;
+	}
+	else
+	{
+		YapDatabaseViewTransaction *parentViewTransaction =
+		  [databaseTransaction ext:filteredView->parentViewName];
+		
+		group = [parentViewTransaction groupForRowid:rowid];
+	}
 	
-	NSString *group = [parentViewTransaction groupForRowid:rowid];
+	rowHookFlags |= YDB_RowHookHasGroup;
 	
 	if (group == nil)
 	{
@@ -841,6 +1192,8 @@
 	{
 		// Add row to view (or update position).
 		
+		rowHookGroup = group;
+		
 		[self insertRowid:rowid
 			 collectionKey:collectionKey
 		          inGroup:group
@@ -881,6 +1234,12 @@
 	YapDatabaseViewFiltering *filtering = nil;
 	[filteredViewConnection getFiltering:&filtering];
 	
+	[self beginRowHookWithCollectionKey:collectionKey
+	                              rowid:rowid
+	                             object:object
+	                           metadata:metadata
+	                              flags:(YDB_RowHookHasObject | YDB_RowHookHasMetadata)];
+	
 	[self _didChangeWithRowid:rowid
 	            collectionKey:collectionKey
 	                   object:object
@@ -914,6 +1273,12 @@
 	YapDatabaseViewFiltering *filtering = nil;
 	[filteredViewConnection getFiltering:&filtering];
 	
+	[self beginRowHookWithCollectionKey:collectionKey
+	                              rowid:rowid
+	                             object:object
+	                           metadata:metadata
+	                              flags:(YDB_RowHookHasObject | YDB_RowHookHasMetadata)];
+	
 	[self _didChangeWithRowid:rowid
 	            collectionKey:collectionKey
 	                   object:object
@@ -949,10 +1314,16 @@
 	BOOL filteringMayHaveChanged = (filtering->blockInvokeOptions & blockInvokeBitMask);
 	BOOL filteringNeedsMetadata = (filtering->blockType & YapDatabaseBlockType_MetadataFlag);
 	
+	[self beginRowHookWithCollectionKey:collectionKey
+	                              rowid:rowid
+	                             object:object
+	                           metadata:nil
+	                              flags:YDB_RowHookHasObject];
+	
 	id metadata = nil;
 	if (filteringMayHaveChanged && filteringNeedsMetadata)
 	{
-		metadata = [databaseTransaction metadataForCollectionKey:collectionKey withRowid:rowid];
+		metadata = [self metadataForRowHook];
 	}
 	
 	[self _didChangeWithRowid:rowid
@@ -990,10 +1361,16 @@
 	BOOL filteringMayHaveChanged = (filtering->blockInvokeOptions & blockInvokeBitMask);
 	BOOL filteringNeedsObject    = (filtering->blockType & YapDatabaseBlockType_ObjectFlag);
 	
+	[self beginRowHookWithCollectionKey:collectionKey
+	                              rowid:rowid
+	                             object:nil
+	                           metadata:metadata
+	                              flags:YDB_RowHookHasMetadata];
+	
 	id object = nil;
 	if (filteringMayHaveChanged && filteringNeedsObject)
 	{
-		object = [databaseTransaction objectForCollectionKey:collectionKey withRowid:rowid];
+		object = [self objectForRowHook];
 	}
 	
 	[self _didChangeWithRowid:rowid
@@ -1034,16 +1411,18 @@
 	BOOL filteringNeedsObject    = (filtering->blockType & YapDatabaseBlockType_ObjectFlag);
 	BOOL filteringNeedsMetadata  = (filtering->blockType & YapDatabaseBlockType_MetadataFlag);
 	
+	[self beginRowHookWithCollectionKey:collectionKey rowid:rowid object:nil metadata:nil flags:0];
+	
 	id object = nil;
 	if (filteringMayHaveChanged && filteringNeedsObject)
 	{
-		object = [databaseTransaction objectForCollectionKey:collectionKey withRowid:rowid];
+		object = [self objectForRowHook];
 	}
 	
 	id metadata = nil;
 	if (filteringMayHaveChanged && filteringNeedsMetadata)
 	{
-		metadata = [databaseTransaction metadataForCollectionKey:collectionKey withRowid:rowid];
+		metadata = [self metadataForRowHook];
 	}
 	
 	[self _didChangeWithRowid:rowid
@@ -1084,16 +1463,18 @@
 	BOOL filteringNeedsObject    = (filtering->blockType & YapDatabaseBlockType_ObjectFlag);
 	BOOL filteringNeedsMetadata  = (filtering->blockType & YapDatabaseBlockType_MetadataFlag);
 	
+	[self beginRowHookWithCollectionKey:collectionKey rowid:rowid object:nil metadata:nil flags:0];
+	
 	id object = nil;
 	if (filteringMayHaveChanged && filteringNeedsObject)
 	{
-		object = [databaseTransaction objectForCollectionKey:collectionKey withRowid:rowid];
+		object = [self objectForRowHook];
 	}
 	
 	id metadata = nil;
 	if (filteringMayHaveChanged && filteringNeedsMetadata)
 	{
-		metadata = [databaseTransaction metadataForCollectionKey:collectionKey withRowid:rowid];
+		metadata = [self metadataForRowHook];
 	}
 	
 	[self _didChangeWithRowid:rowid
@@ -1135,16 +1516,18 @@
 	BOOL filteringNeedsObject    = (filtering->blockType & YapDatabaseBlockType_ObjectFlag);
 	BOOL filteringNeedsMetadata  = (filtering->blockType & YapDatabaseBlockType_MetadataFlag);
 	
+	[self beginRowHookWithCollectionKey:collectionKey rowid:rowid object:nil metadata:nil flags:0];
+	
 	id object = nil;
 	if (filteringMayHaveChanged && filteringNeedsObject)
 	{
-		object = [databaseTransaction objectForCollectionKey:collectionKey withRowid:rowid];
+		object = [self objectForRowHook];
 	}
 	
 	id metadata = nil;
 	if (filteringMayHaveChanged && filteringNeedsMetadata)
 	{
-		metadata = [databaseTransaction metadataForCollectionKey:collectionKey withRowid:rowid];
+		metadata = [self metadataForRowHook];
 	}
 	
 	[self _didChangeWithRowid:rowid
@@ -1165,10 +1548,12 @@
 {
 	YDBLogAutoTrace();
 	
+	[self clearRowHook];
+	
 	// Should we ignore the row based on the allowedCollections ?
 	
 	YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
-	if (allowedCollections && ![allowedCollections isAllowed:collectionKey.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -1186,6 +1571,8 @@
 {
 	YDBLogAutoTrace();
 	
+	[self clearRowHook];
+	
 	// Should we ignore the rows based on the allowedCollections ?
 	
 	YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
@@ -1218,6 +1605,8 @@
 {
 	YDBLogAutoTrace();
 	
+	[self clearRowHook];
+	
 	[self removeAllRowids];
 }
 
@@ -1260,17 +1649,33 @@
 	
 	BOOL groupingMayHaveChanged = (flags & YDB_GroupingMayHaveChanged) ? YES : NO;
 	BOOL sortingMayHaveChanged  = (flags & YDB_SortingMayHaveChanged) ? YES : NO;
+	BOOL filteringIsStricter    = (flags & YDB_FilteringIsStricter) ? YES : NO;
+	
+	NSUInteger changesCount = [parentConnection->changes count];
 	
 	if (groupingMayHaveChanged || sortingMayHaveChanged)
 	{
 		[self repopulateViewDueToParentGroupingSortingChange];
 	}
+	else if (filteringIsStricter)
+	{
+		[self repopulateViewDueToStricterParentFiltering];
+	}
 	else
 	{
 		[self repopulateViewDueToParentFilteringChange];
 	}
 	
+	// If only the filtering changed (somewhere below us), and none of our rows were affected,
+	// then the extensions dependent upon this one are unaffected too.
+	
+	if (!groupingMayHaveChanged && !sortingMayHaveChanged && ([parentConnection->changes count] == changesCount))
+	{
+		return;
+	}
+	
 	// Propogate the notification onward to any extensions dependent upon this one.
+	// The flags still apply: if the parentView only lost rows, so did we.
 	
 	__unsafe_unretained NSString *registeredName = [self registeredName];
 	__unsafe_unretained NSDictionary *extensionDependencies = databaseTransaction->connection->extensionDependencies;
@@ -1302,6 +1707,13 @@
 
 - (void)setFiltering:(YapDatabaseViewFiltering *)filtering
           versionTag:(NSString *)inVersionTag
+{
+	[self setFiltering:filtering versionTag:inVersionTag change:YapDatabaseViewFilteringChangeUnknown];
+}
+
+- (void)setFiltering:(YapDatabaseViewFiltering *)filtering
+          versionTag:(NSString *)inVersionTag
+              change:(YapDatabaseViewFilteringChange)change
 {
 	YDBLogAutoTrace();
 	
@@ -1327,13 +1739,22 @@
 	[filteredViewConnection setFiltering:filtering
 	                          versionTag:newVersionTag];
 	
-	[self repopulateViewDueToFilteringBlockChange];
+	NSUInteger changesCount = [parentConnection->changes count];
+	
+	[self repopulateViewDueToFilteringBlockChange:change];
 	
 	[self setStringValue:newVersionTag
 	     forExtensionKey:ext_key_versionTag
 	          persistent:[self isPersistentView]];
 	
 	// Notify any extensions dependent upon this one that we repopulated.
+	// Unless the new filter didn't change any rows, in which case there's nothing for them to do.
+	
+	if ([parentConnection->changes count] == changesCount) return;
+	
+	int flags = YDB_FilteringMayHaveChanged;
+	if (change == YapDatabaseViewFilteringChangeStricter)
+		flags |= YDB_FilteringIsStricter;
 	
 	NSString *registeredName = [self registeredName];
 	NSDictionary *extensionDependencies = databaseTransaction->connection->extensionDependencies;
@@ -1349,7 +1770,6 @@
 			
 			if ([extTransaction respondsToSelector:@selector(view:didRepopulateWithFlags:)])
 			{
-				int flags = YDB_FilteringMayHaveChanged;
 				[(id <YapDatabaseViewDependency>)extTransaction view:registeredName didRepopulateWithFlags:flags];
 			}
 		}
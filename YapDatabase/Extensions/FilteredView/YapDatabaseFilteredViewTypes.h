@@ -5,6 +5,25 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * Describes how a new filter relates to the filter it replaces.
+ * See -[YapDatabaseFilteredViewTransaction setFiltering:versionTag:change:].
+ *
+ * - Unknown : No assumptions are made. Every row in the parentView is tested against the new filter.
+ *
+ * - Stricter : The new filter only allows a subset of what the old filter allowed.
+ *              So only the rows currently in the filteredView are tested (and removed if they don't pass).
+ *
+ * - Looser : The new filter allows everything the old filter allowed (and possibly more).
+ *            So only the rows of the parentView that are NOT currently in the filteredView are tested
+ *            (and inserted if they pass).
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseViewFilteringChange) {
+	YapDatabaseViewFilteringChangeUnknown = 0,
+	YapDatabaseViewFilteringChangeStricter,
+	YapDatabaseViewFilteringChangeLooser,
+};
+
 /**
  * The filtering block removes items from this view that are in the parent view.
  *
@@ -57,6 +76,23 @@ typedef BOOL (^YapDatabaseViewFilteringWithRowBlock)
 @property (nonatomic, assign, readonly) YapDatabaseBlockType          blockType;
 @property (nonatomic, assign, readonly) YapDatabaseBlockInvoke        blockInvokeOptions;
 
+/**
+ * Opt-in concurrent filtering, for filter blocks that are CPU-bound (e.g. predicate checks on decoded objects).
+ *
+ * If YES, then when the filteredView is populated (e.g. the initial build of the view),
+ * the rows of the parentView are processed in batches:
+ * - the objects and/or metadata (as required by the blockType) are fetched on the transaction thread
+ * - the filter block is invoked concurrently (on background threads) for every row in the batch
+ * - the allowed rows are then inserted into the view, in order, on the transaction thread
+ *
+ * IMPORTANT:
+ * The filter block must be thread-safe to use this option.
+ * And it must NOT use the transaction parameter, as database transactions are not thread-safe.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL allowsConcurrentFiltering;
+
 @end
 
 NS_ASSUME_NONNULL_END
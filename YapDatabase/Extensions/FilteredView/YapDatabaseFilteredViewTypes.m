@@ -7,6 +7,7 @@
 @synthesize block = block;
 @synthesize blockType = blockType;
 @synthesize blockInvokeOptions = blockInvokeOptions;
+@synthesize allowsConcurrentFiltering = allowsConcurrentFiltering;
 
 + (instancetype)withKeyBlock:(YapDatabaseViewFilteringWithKeyBlock)block
 {
@@ -2,15 +2,20 @@
 #import "YapDatabaseFullTextSearchHandler.h"
 #import "YapDatabaseFullTextSearchConnection.h"
 #import "YapDatabaseFullTextSearchTransaction.h"
+#import "YapDatabaseFullTextSearchScope.h"
+#import "YapDatabaseFullTextSearchTokenizer.h"
 
 #import "YapDatabase.h"
 #import "YapDatabaseConnection.h"
 #import "YapDatabaseTransaction.h"
 
 #import "YapMutationStack.h"
+#import "YapRowidSet.h"
 
 #import "sqlite3.h"
 
+#import <stdatomic.h>
+
 /**
  * This version number is stored in the yap2 table.
  * If there is a major re-write to this class, then the version number will be incremented,
@@ -45,11 +50,22 @@
 	NSDictionary *options;
 	NSString *ftsVersion;
 	NSString *versionTag;
+	YapDatabaseFullTextSearchOptions *extensionOptions;
 	
 	id columnNamesSharedKeySet;
+	
+	// YES while the background work (indexing the queued rows, merging segments) is in progress,
+	// or once it's requested. See YapDatabaseFullTextSearchOptions.deferredIndexing & mergeSegmentThreshold.
+	atomic_bool backgroundWorkScheduled;
+	
+	atomic_bool mergeNeeded;
+	atomic_uint writesSinceMergeCheck;
 }
 
 - (NSString *)tableName;
+- (NSString *)pendingTableName;
+- (NSString *)snippetTableName; // temp table (per connection), for the snippets of a contentless table
+- (NSString *)scopeTableName;   // temp table (per connection), for the rowids of a YapDatabaseFullTextSearchScope
 
 @end
 
@@ -66,6 +82,12 @@
 	NSMutableDictionary *blockDict;
 	
 	YapMutationStack_Bool *mutationStack;
+	
+	BOOL didQueueRowids;        // rows were queued by the current read-write transaction
+	BOOL didIndexQueuedRowids;  // queued rows were indexed by the current read-write transaction
+	BOOL didModifyIndex;        // the FTS table was modified by the current read-write transaction
+	BOOL didRequestMerge;       // segments need to be merged (see mergeSegmentThreshold)
+	BOOL didMergeSegments;      // segments were merged by the current read-write transaction
 }
 
 - (id)initWithParent:(YapDatabaseFullTextSearch *)parent databaseConnection:(YapDatabaseConnection *)databaseConnection;
@@ -75,15 +97,33 @@
 
 - (sqlite3_stmt *)insertRowidStatement;
 - (sqlite3_stmt *)setRowidStatement;
+- (sqlite3_stmt *)compareRowidStatement;
 - (sqlite3_stmt *)removeRowidStatement;
 - (sqlite3_stmt *)removeAllStatement;
 - (sqlite3_stmt *)queryStatement;
 - (sqlite3_stmt *)bm25QueryStatement;
 - (sqlite3_stmt *)bm25QueryStatementWithWeights:(NSArray<NSNumber *> *)weights;
+- (sqlite3_stmt *)bm25TopQueryStatement;
 - (sqlite3_stmt *)querySnippetStatement;
 - (sqlite3_stmt *)rowidQueryStatement;
 - (sqlite3_stmt *)rowidQuerySnippetStatement;
 
+- (NSString *)snippetFunction;
+
+- (sqlite3_stmt *)queueRowidStatement;
+- (sqlite3_stmt *)dequeueRowidStatement;
+- (sqlite3_stmt *)dequeueAllStatement;
+- (sqlite3_stmt *)queuedRowidsStatement;
+- (sqlite3_stmt *)queueCountStatement;
+
+- (sqlite3_stmt *)snippetTableInsertStatement;
+- (sqlite3_stmt *)snippetTableQueryStatement;
+- (sqlite3_stmt *)snippetTableRemoveAllStatement;
+
+- (sqlite3_stmt *)scopeTableInsertStatement;
+- (sqlite3_stmt *)scopeTableRemoveAllStatement;
+- (sqlite3_stmt *)scopedQueryStatement;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -108,8 +148,73 @@
                      usingBlock:
             (void (^)(NSString *snippet, int64_t rowid, BOOL *stop))block;
 
+- (void)enumerateRowidsMatching:(NSString *)query
+                        inScope:(YapDatabaseFullTextSearchScope *)scope
+                     usingBlock:(void (^)(int64_t rowid, BOOL *stop))block;
+
 - (BOOL)rowid:(int64_t)rowid matches:(NSString *)query;
 - (NSString *)rowid:(int64_t)rowid matches:(NSString *)query
                         withSnippetOptions:(YapDatabaseFullTextSearchSnippetOptions *)options;
 
+- (NSDictionary<NSNumber *, NSString *> *)snippetsForRowids:(NSArray<NSNumber *> *)rowids
+                                                   matching:(NSString *)query
+                                         withSnippetOptions:(YapDatabaseFullTextSearchSnippetOptions *)options;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseFullTextSearchScope () {
+@public
+	
+	NSString *extensionName;
+	NSArray<NSString *> *groups;   // view scope
+	YapDatabaseQuery *query;       // secondary index scope
+	YapRowidSetBox *rowidSet;      // rowid set scope
+}
+
+/**
+ * The scope copies the given set.
+**/
++ (instancetype)scopeWithRowidSet:(YapRowidSet *)rowidSet;
+
+/**
+ * Returns NO if the extension of the scope isn't registered (or isn't a view / secondary index).
+**/
+- (BOOL)enumerateRowidsWithTransaction:(YapDatabaseReadTransaction *)transaction
+                            usingBlock:(void (^)(int64_t rowid, BOOL *stop))block;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseFullTextSearchTokenizer () {
+@public
+	
+	fts5_tokenizer module;
+	void *userData;
+	void (*destroy)(void *userData);
+}
+
+/**
+ * The tokenize option for the CREATE VIRTUAL TABLE, e.g. "tokenize='yap_unicode'"
+**/
+- (NSString *)tableOption;
+
+/**
+ * Registers the tokenizer with the given sqlite connection (via the fts5_api).
+ * The connection retains the tokenizer.
+**/
+- (BOOL)registerWithDatabase:(sqlite3 *)db;
+
+/**
+ * Registers the built-in tokenizers (if FTS5 is available).
+ * This allows tables that use them to be dropped, even if the extension is no longer registered.
+**/
++ (BOOL)registerBuiltInTokenizersWithDatabase:(sqlite3 *)db;
+
 @end
@@ -4,6 +4,9 @@
 #import "YapDatabaseFullTextSearchHandler.h"
 #import "YapDatabaseFullTextSearchConnection.h"
 #import "YapDatabaseFullTextSearchTransaction.h"
+#import "YapDatabaseFullTextSearchOptions.h"
+#import "YapDatabaseFullTextSearchScope.h"
+#import "YapDatabaseFullTextSearchTokenizer.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -45,6 +48,22 @@ extern NSString *const YapDatabaseFullTextSearchFTS3Version;
                ftsVersion:(nullable NSString *)ftsVersion
                versionTag:(nullable NSString *)versionTag;
 
+/**
+ * @param options
+ *   The options of the sqlite FTS module, which are appended to the "CREATE VIRTUAL TABLE" statement.
+ *   For example: @{ @"tokenize": @"porter" }
+ * 
+ * @param extensionOptions
+ *   The options of the extension itself (e.g. deferredIndexing).
+ *   See YapDatabaseFullTextSearchOptions for more information.
+**/
+- (id)initWithColumnNames:(NSArray<NSString *> *)columnNames
+                  options:(nullable NSDictionary *)options
+                  handler:(YapDatabaseFullTextSearchHandler *)handler
+               ftsVersion:(nullable NSString *)ftsVersion
+               versionTag:(nullable NSString *)versionTag
+         extensionOptions:(nullable YapDatabaseFullTextSearchOptions *)extensionOptions;
+
 
 /* Inherited from YapDatabaseExtension
  
@@ -64,6 +83,8 @@ extern NSString *const YapDatabaseFullTextSearchFTS3Version;
 @property (nonatomic, copy, readonly, nullable) NSString *versionTag;
 @property (nonatomic, copy, readonly, nullable) NSString *ftsVersion;
 
+@property (nonatomic, copy, readonly) YapDatabaseFullTextSearchOptions *extensionOptions;
+
 @end
 
 NS_ASSUME_NONNULL_END
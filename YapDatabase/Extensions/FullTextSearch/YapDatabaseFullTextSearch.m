@@ -35,6 +35,9 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
 {
 	sqlite3 *db = transaction->connection->db;
 	
+	// FTS5 has to load the tokenizer of the table in order to drop it
+	[YapDatabaseFullTextSearchTokenizer registerBuiltInTokenizersWithDatabase:db];
+	
 	NSString *tableName = [self tableNameForRegisteredName:registeredName];
 	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
 	
@@ -46,6 +49,16 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
 		YDBLogError(@"%@ - Failed dropping FTS table (%@): %d %s",
 		            THIS_METHOD, dropTable, status, sqlite3_errmsg(db));
 	}
+	
+	NSString *pendingTableName = [self pendingTableNameForRegisteredName:registeredName];
+	NSString *dropPendingTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", pendingTableName];
+	
+	status = sqlite3_exec(db, [dropPendingTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed dropping FTS pending table (%@): %d %s",
+		            THIS_METHOD, dropPendingTable, status, sqlite3_errmsg(db));
+	}
 }
 
 + (NSArray *)previousClassNames
@@ -58,6 +71,11 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
 	return [NSString stringWithFormat:@"fts_%@", registeredName];
 }
 
++ (NSString *)pendingTableNameForRegisteredName:(NSString *)registeredName
+{
+	return [NSString stringWithFormat:@"fts_%@_pending", registeredName];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Instance
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -65,6 +83,7 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
 @synthesize handler = handler;
 @synthesize versionTag = versionTag;
 @synthesize ftsVersion = ftsVersion;
+@synthesize extensionOptions = extensionOptions;
 
 - (id)initWithColumnNames:(NSArray *)inColumnNames
                   handler:(YapDatabaseFullTextSearchHandler *)inHandler
@@ -98,7 +117,23 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
                   options:(NSDictionary *)inOptions
                   handler:(YapDatabaseFullTextSearchHandler *)inHandler
                ftsVersion:(NSString *)inFtsVersion
-               versionTag:(NSString *)inVersionTag {
+               versionTag:(NSString *)inVersionTag
+{
+    return [self initWithColumnNames:inColumnNames
+                             options:inOptions
+                             handler:inHandler
+                          ftsVersion:inFtsVersion
+                          versionTag:inVersionTag
+                    extensionOptions:nil];
+}
+
+- (id)initWithColumnNames:(NSArray *)inColumnNames
+                  options:(NSDictionary *)inOptions
+                  handler:(YapDatabaseFullTextSearchHandler *)inHandler
+               ftsVersion:(NSString *)inFtsVersion
+               versionTag:(NSString *)inVersionTag
+         extensionOptions:(YapDatabaseFullTextSearchOptions *)inExtensionOptions
+{
     if ([inColumnNames count] == 0)
     {
         NSAssert(NO, @"Empty columnNames array");
@@ -134,6 +169,8 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
         
         versionTag = inVersionTag ? [inVersionTag copy] : @"";
         ftsVersion = inFtsVersion ? [inFtsVersion copy] : YapDatabaseFullTextSearchFTS4Version;
+        
+        extensionOptions = inExtensionOptions ? [inExtensionOptions copy] : [[YapDatabaseFullTextSearchOptions alloc] init];
     }
     return self;
 }
@@ -143,9 +180,33 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
 	return [[YapDatabaseFullTextSearchConnection alloc] initWithParent:self databaseConnection:databaseConnection];
 }
 
+/**
+ * YapDatabaseExtension subclass hook.
+ * Returns YES if there are queued rows to index (see YapDatabaseFullTextSearchOptions.deferredIndexing).
+**/
+- (BOOL)hasPendingPopulation
+{
+	return atomic_load(&backgroundWorkScheduled);
+}
+
 - (NSString *)tableName
 {
 	return [[self class] tableNameForRegisteredName:self.registeredName];
 }
 
+- (NSString *)pendingTableName
+{
+	return [[self class] pendingTableNameForRegisteredName:self.registeredName];
+}
+
+- (NSString *)snippetTableName
+{
+	return [NSString stringWithFormat:@"fts_%@_snippets", self.registeredName];
+}
+
+- (NSString *)scopeTableName
+{
+	return [NSString stringWithFormat:@"fts_%@_scope", self.registeredName];
+}
+
 @end
@@ -3,6 +3,7 @@
 
 #import "YapDatabasePrivate.h"
 #import "YapDatabaseExtensionPrivate.h"
+#import "YapDatabaseMemoryReportPrivate.h"
 
 #import "YapDatabaseLogging.h"
 
@@ -27,13 +28,30 @@
 	
 	sqlite3_stmt *insertRowidStatement;
 	sqlite3_stmt *setRowidStatement;
+	sqlite3_stmt *compareRowidStatement;
 	sqlite3_stmt *removeRowidStatement;
 	sqlite3_stmt *removeAllStatement;
 	sqlite3_stmt *queryStatement;
 	sqlite3_stmt *bm25QueryStatement;
+	sqlite3_stmt *bm25TopQueryStatement;
 	sqlite3_stmt *querySnippetStatement;
 	sqlite3_stmt *rowidQueryStatement;
 	sqlite3_stmt *rowidQuerySnippetStatement;
+	sqlite3_stmt *queueRowidStatement;
+	sqlite3_stmt *dequeueRowidStatement;
+	sqlite3_stmt *dequeueAllStatement;
+	sqlite3_stmt *queuedRowidsStatement;
+	sqlite3_stmt *queueCountStatement;
+	sqlite3_stmt *snippetTableInsertStatement;
+	sqlite3_stmt *snippetTableQueryStatement;
+	sqlite3_stmt *snippetTableRemoveAllStatement;
+	sqlite3_stmt *scopeTableInsertStatement;
+	sqlite3_stmt *scopeTableRemoveAllStatement;
+	sqlite3_stmt *scopedQueryStatement;
+	
+	BOOL hasSnippetTable;
+	BOOL hasScopeTable;
+	BOOL hasRegisteredTokenizer;
 }
 
 @synthesize fullTextSearch = parent;
@@ -58,13 +76,26 @@
 {
 	sqlite_finalize_null(&insertRowidStatement);
 	sqlite_finalize_null(&setRowidStatement);
+	sqlite_finalize_null(&compareRowidStatement);
 	sqlite_finalize_null(&removeRowidStatement);
 	sqlite_finalize_null(&removeAllStatement);
 	sqlite_finalize_null(&queryStatement);
 	sqlite_finalize_null(&bm25QueryStatement);
+	sqlite_finalize_null(&bm25TopQueryStatement);
 	sqlite_finalize_null(&querySnippetStatement);
 	sqlite_finalize_null(&rowidQueryStatement);
 	sqlite_finalize_null(&rowidQuerySnippetStatement);
+	sqlite_finalize_null(&queueRowidStatement);
+	sqlite_finalize_null(&dequeueRowidStatement);
+	sqlite_finalize_null(&dequeueAllStatement);
+	sqlite_finalize_null(&queuedRowidsStatement);
+	sqlite_finalize_null(&queueCountStatement);
+	sqlite_finalize_null(&snippetTableInsertStatement);
+	sqlite_finalize_null(&snippetTableQueryStatement);
+	sqlite_finalize_null(&snippetTableRemoveAllStatement);
+	sqlite_finalize_null(&scopeTableInsertStatement);
+	sqlite_finalize_null(&scopeTableRemoveAllStatement);
+	sqlite_finalize_null(&scopedQueryStatement);
 }
 
 /**
@@ -78,6 +109,41 @@
 	}
 }
 
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateMemoryUsageWithBlock:(void (^)(NSString *component,
+                                                uint64_t bytes,
+                                                YapDatabaseConnectionFlushMemoryFlags flushFlags))block
+{
+	uint64_t bytes = 0;
+	
+	bytes += YapDatabaseStatementMemoryUsed(insertRowidStatement);
+	bytes += YapDatabaseStatementMemoryUsed(setRowidStatement);
+	bytes += YapDatabaseStatementMemoryUsed(compareRowidStatement);
+	bytes += YapDatabaseStatementMemoryUsed(removeRowidStatement);
+	bytes += YapDatabaseStatementMemoryUsed(removeAllStatement);
+	bytes += YapDatabaseStatementMemoryUsed(queryStatement);
+	bytes += YapDatabaseStatementMemoryUsed(bm25QueryStatement);
+	bytes += YapDatabaseStatementMemoryUsed(bm25TopQueryStatement);
+	bytes += YapDatabaseStatementMemoryUsed(querySnippetStatement);
+	bytes += YapDatabaseStatementMemoryUsed(rowidQueryStatement);
+	bytes += YapDatabaseStatementMemoryUsed(rowidQuerySnippetStatement);
+	bytes += YapDatabaseStatementMemoryUsed(queueRowidStatement);
+	bytes += YapDatabaseStatementMemoryUsed(dequeueRowidStatement);
+	bytes += YapDatabaseStatementMemoryUsed(dequeueAllStatement);
+	bytes += YapDatabaseStatementMemoryUsed(queuedRowidsStatement);
+	bytes += YapDatabaseStatementMemoryUsed(queueCountStatement);
+	bytes += YapDatabaseStatementMemoryUsed(snippetTableInsertStatement);
+	bytes += YapDatabaseStatementMemoryUsed(snippetTableQueryStatement);
+	bytes += YapDatabaseStatementMemoryUsed(snippetTableRemoveAllStatement);
+	bytes += YapDatabaseStatementMemoryUsed(scopeTableInsertStatement);
+	bytes += YapDatabaseStatementMemoryUsed(scopeTableRemoveAllStatement);
+	bytes += YapDatabaseStatementMemoryUsed(scopedQueryStatement);
+	
+	block(@"statements", bytes, YapDatabaseConnectionFlushMemoryFlags_Statements);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -99,6 +165,8 @@
 **/
 - (id)newReadTransaction:(YapDatabaseReadTransaction *)databaseTransaction
 {
+	[self registerTokenizerIfNeeded];
+	
 	YapDatabaseFullTextSearchTransaction *transaction =
 	  [[YapDatabaseFullTextSearchTransaction alloc] initWithParentConnection:self
 	                                                     databaseTransaction:databaseTransaction];
@@ -111,6 +179,8 @@
 **/
 - (id)newReadWriteTransaction:(YapDatabaseReadWriteTransaction *)databaseTransaction
 {
+	[self registerTokenizerIfNeeded];
+	
 	YapDatabaseFullTextSearchTransaction *transaction =
 	  [[YapDatabaseFullTextSearchTransaction alloc] initWithParentConnection:self
 	                                                     databaseTransaction:databaseTransaction];
@@ -119,6 +189,23 @@
 	return transaction;
 }
 
+/**
+ * The tokenizer (see YapDatabaseFullTextSearchOptions.tokenizer) has to be registered with the sqlite connection
+ * before any statement accesses the table.
+**/
+- (void)registerTokenizerIfNeeded
+{
+	if (hasRegisteredTokenizer) return;
+	
+	YapDatabaseFullTextSearchTokenizer *tokenizer = parent->extensionOptions.tokenizer;
+	if (tokenizer && [parent->ftsVersion isEqualToString:YapDatabaseFullTextSearchFTS5Version])
+	{
+		[tokenizer registerWithDatabase:databaseConnection->db];
+	}
+	
+	hasRegisteredTokenizer = YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Changeset
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -138,11 +225,33 @@
 - (void)postCommitCleanup
 {
 	[mutationStack clear];
+	
+	if (didQueueRowids || didRequestMerge)
+	{
+		// Index the queued rows / merge the segments in the background (unless that's already in progress).
+		
+		if (!atomic_exchange(&parent->backgroundWorkScheduled, true))
+		{
+			[parent.registeredDatabase asyncPopulateExtension:parent];
+		}
+	}
+	
+	didQueueRowids = NO;
+	didIndexQueuedRowids = NO;
+	didModifyIndex = NO;
+	didRequestMerge = NO;
+	didMergeSegments = NO;
 }
 
 - (void)postRollbackCleanup
 {
 	[mutationStack clear];
+	
+	didQueueRowids = NO;
+	didIndexQueuedRowids = NO;
+	didModifyIndex = NO;
+	didRequestMerge = NO;
+	didMergeSegments = NO;
 }
 
 /**
@@ -150,12 +259,17 @@
 **/
 - (void)getInternalChangeset:(NSMutableDictionary __unused **)internalChangesetPtr
            externalChangeset:(NSMutableDictionary __unused **)externalChangesetPtr
-              hasDiskChanges:(BOOL __unused *)hasDiskChangesPtr
+              hasDiskChanges:(BOOL *)hasDiskChangesPtr
 {
-	// Nothing to do for this particular extension.
+	// There's no changeset for this particular extension.
 	//
-	// YapDatabaseExtension rows a "not implemented" exception
-	// to ensure extensions have implementations of all required methods.
+	// But indexing queued rows & merging segments (in the background) only modifies our tables,
+	// so the database needs to know the file was modified.
+	
+	if (didIndexQueuedRowids || didMergeSegments)
+	{
+		*hasDiskChangesPtr = YES;
+	}
 }
 
 /**
@@ -245,6 +359,44 @@
 	return *statement;
 }
 
+/**
+ * Returns a single row (if the rowid is in the table) with a single column:
+ * 1 if every column matches the bound value, 0 otherwise.
+ *
+ * The parameters are numbered so they're bound exactly like the insertRowidStatement & setRowidStatement.
+**/
+- (sqlite3_stmt *)compareRowidStatement
+{
+	sqlite3_stmt **statement = &compareRowidStatement;
+	if (*statement == NULL)
+	{
+		NSMutableString *string = [NSMutableString stringWithCapacity:100];
+		[string appendString:@"SELECT "];
+		
+		int bind_idx = SQLITE_BIND_START + 1;
+		for (NSString *columnName in parent->columnNames)
+		{
+			if (bind_idx > (SQLITE_BIND_START + 1))
+				[string appendString:@" AND "];
+			
+			[string appendFormat:@"(\"%@\" IS ?%d)", columnName, bind_idx];
+			bind_idx++;
+		}
+		
+		[string appendFormat:@" FROM \"%@\" WHERE \"rowid\" = ?%d;", [parent tableName], SQLITE_BIND_START];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
 - (sqlite3_stmt *)removeRowidStatement
 {
 	sqlite3_stmt **statement = &removeRowidStatement;
@@ -346,14 +498,56 @@
     return statement;
 }
 
+/**
+ * The weights are bound (as the rank function: "bm25(w1, w2, ...)"), rather than being part of the sql,
+ * so a single statement is used for every query.
+ * And ordering by "rank" (with a LIMIT) allows fts5 to only keep the top rows while it scores the matches.
+**/
+- (sqlite3_stmt *)bm25TopQueryStatement
+{
+	sqlite3_stmt **statement = &bm25TopQueryStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		  @"SELECT \"rowid\" FROM \"%1$@\" WHERE \"%1$@\" MATCH ? AND \"rank\" MATCH ?"
+		  @" ORDER BY \"rank\" LIMIT ? OFFSET ?;", [parent tableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+/**
+ * The snippet parameters are always bound in the same order:
+ * ?1 startMatchText, ?2 endMatchText, ?3 ellipsesText, ?4 columnIndex, ?5 numberOfTokens
+ *
+ * But the arguments of the fts5 snippet function are in a different order than those of fts3/fts4:
+ * fts4 : snippet(table, start, end, ellipses, column, tokens)
+ * fts5 : snippet(table, column, start, end, ellipses, tokens)
+**/
+- (NSString *)snippetFunction
+{
+	if ([parent->ftsVersion isEqualToString:YapDatabaseFullTextSearchFTS5Version])
+		return [NSString stringWithFormat:@"snippet(\"%@\", ?4, ?1, ?2, ?3, ?5)", [parent tableName]];
+	else
+		return [NSString stringWithFormat:@"snippet(\"%@\", ?1, ?2, ?3, ?4, ?5)", [parent tableName]];
+}
+
 - (sqlite3_stmt *)querySnippetStatement
 {
 	sqlite3_stmt **statement = &querySnippetStatement;
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", snippet(\"%1$@\", ?, ?, ?, ?, ?) FROM \"%1$@\" WHERE \"%1$@\" MATCH ?;",
-		  [parent tableName]];
+		  @"SELECT \"rowid\", %2$@ FROM \"%1$@\" WHERE \"%1$@\" MATCH ?6;",
+		  [parent tableName], [self snippetFunction]];
 		
 		sqlite3 *db = databaseConnection->db;
 		
@@ -393,8 +587,333 @@
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", snippet(\"%1$@\", ?, ?, ?, ?, ?) FROM \"%1$@\" WHERE \"rowid\" = ? AND \"%1$@\" MATCH ?;",
-		  [parent tableName]];
+		  @"SELECT \"rowid\", %2$@ FROM \"%1$@\" WHERE \"rowid\" = ?6 AND \"%1$@\" MATCH ?7;",
+		  [parent tableName], [self snippetFunction]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)queueRowidStatement
+{
+	sqlite3_stmt **statement = &queueRowidStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:@"INSERT OR IGNORE INTO \"%@\" (\"rowid\") VALUES (?);", [parent pendingTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)dequeueRowidStatement
+{
+	sqlite3_stmt **statement = &dequeueRowidStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE \"rowid\" = ?;", [parent pendingTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)dequeueAllStatement
+{
+	sqlite3_stmt **statement = &dequeueAllStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:@"DELETE FROM \"%@\";", [parent pendingTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)queuedRowidsStatement
+{
+	sqlite3_stmt **statement = &queuedRowidsStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:@"SELECT \"rowid\" FROM \"%@\" ORDER BY \"rowid\" ASC LIMIT ?;", [parent pendingTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)queueCountStatement
+{
+	sqlite3_stmt **statement = &queueCountStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:@"SELECT COUNT(*) AS NumberOfRows FROM \"%@\";", [parent pendingTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+/**
+ * A contentless table doesn't store the text, so its snippets are generated from a temporary (per connection) table,
+ * which only ever contains the row for which the snippet is generated.
+ * It uses the same options as the FTS table (e.g. the tokenizer), so the query matches the same way.
+**/
+- (BOOL)createSnippetTableIfNeeded
+{
+	if (hasSnippetTable) return YES;
+	
+	// CREATE VIRTUAL TABLE IF NOT EXISTS temp."snippetTableName" USING fts5("column1", "column2", ..., option=value);
+	
+	NSMutableString *createTable = [NSMutableString stringWithCapacity:100];
+	[createTable appendFormat:@"CREATE VIRTUAL TABLE IF NOT EXISTS temp.\"%@\" USING %@(",
+	                          [parent snippetTableName], parent->ftsVersion];
+	
+	__block NSUInteger i = 0;
+	
+	for (NSString *columnName in parent->columnNames)
+	{
+		if (i == 0)
+			[createTable appendFormat:@"\"%@\"", columnName];
+		else
+			[createTable appendFormat:@", \"%@\"", columnName];
+		
+		i++;
+	}
+	
+	[parent->options enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
+		
+		[createTable appendFormat:@", %@=%@", key, obj];
+	}];
+	
+	if (parent->extensionOptions.tokenizer)
+	{
+		[createTable appendFormat:@", %@", [parent->extensionOptions.tokenizer tableOption]];
+	}
+	
+	[createTable appendString:@");"];
+	
+	sqlite3 *db = databaseConnection->db;
+	
+	int status = sqlite3_exec(db, [createTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed creating FTS snippet table (%@): %d %s",
+		            THIS_METHOD, [parent snippetTableName], status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	hasSnippetTable = YES;
+	return YES;
+}
+
+- (sqlite3_stmt *)snippetTableInsertStatement
+{
+	sqlite3_stmt **statement = &snippetTableInsertStatement;
+	if (*statement == NULL)
+	{
+		if (![self createSnippetTableIfNeeded]) return NULL;
+		
+		NSMutableString *string = [NSMutableString stringWithCapacity:100];
+		[string appendFormat:@"INSERT INTO temp.\"%@\" (\"rowid\"", [parent snippetTableName]];
+		
+		for (NSString *columnName in parent->columnNames)
+		{
+			[string appendFormat:@", \"%@\"", columnName];
+		}
+		
+		[string appendString:@") VALUES (?"];
+		
+		NSUInteger count = [parent->columnNames count];
+		NSUInteger i;
+		for (i = 0; i < count; i++)
+		{
+			[string appendString:@", ?"];
+		}
+		
+		[string appendString:@");"];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)snippetTableQueryStatement
+{
+	sqlite3_stmt **statement = &snippetTableQueryStatement;
+	if (*statement == NULL)
+	{
+		if (![self createSnippetTableIfNeeded]) return NULL;
+		
+		// Same parameters as the querySnippetStatement (startMatchText, endMatchText, ellipsesText, column, tokens),
+		// but in the order of the fts5 snippet function: snippet(table, column, start, end, ellipses, tokens)
+		
+		NSString *string = [NSString stringWithFormat:
+		  @"SELECT snippet(\"%1$@\", ?4, ?1, ?2, ?3, ?5) FROM temp.\"%1$@\" WHERE \"%1$@\" MATCH ?6;",
+		  [parent snippetTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)snippetTableRemoveAllStatement
+{
+	sqlite3_stmt **statement = &snippetTableRemoveAllStatement;
+	if (*statement == NULL)
+	{
+		if (![self createSnippetTableIfNeeded]) return NULL;
+		
+		NSString *string = [NSString stringWithFormat:@"DELETE FROM temp.\"%@\";", [parent snippetTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+/**
+ * The rowids of a YapDatabaseFullTextSearchScope are collected into a temporary (per connection) table,
+ * which is then part of the scopedQueryStatement.
+**/
+- (BOOL)createScopeTableIfNeeded
+{
+	if (hasScopeTable) return YES;
+	
+	NSString *createTable = [NSString stringWithFormat:
+	  @"CREATE TEMP TABLE IF NOT EXISTS \"%@\" (\"rowid\" INTEGER PRIMARY KEY);", [parent scopeTableName]];
+	
+	sqlite3 *db = databaseConnection->db;
+	
+	int status = sqlite3_exec(db, [createTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed creating FTS scope table (%@): %d %s",
+		            THIS_METHOD, [parent scopeTableName], status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	hasScopeTable = YES;
+	return YES;
+}
+
+- (sqlite3_stmt *)scopeTableInsertStatement
+{
+	sqlite3_stmt **statement = &scopeTableInsertStatement;
+	if (*statement == NULL)
+	{
+		if (![self createScopeTableIfNeeded]) return NULL;
+		
+		NSString *string = [NSString stringWithFormat:
+		  @"INSERT OR IGNORE INTO temp.\"%@\" (\"rowid\") VALUES (?);", [parent scopeTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)scopeTableRemoveAllStatement
+{
+	sqlite3_stmt **statement = &scopeTableRemoveAllStatement;
+	if (*statement == NULL)
+	{
+		if (![self createScopeTableIfNeeded]) return NULL;
+		
+		NSString *string = [NSString stringWithFormat:@"DELETE FROM temp.\"%@\";", [parent scopeTableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)scopedQueryStatement
+{
+	sqlite3_stmt **statement = &scopedQueryStatement;
+	if (*statement == NULL)
+	{
+		if (![self createScopeTableIfNeeded]) return NULL;
+		
+		NSString *string = [NSString stringWithFormat:
+		  @"SELECT \"rowid\" FROM \"%1$@\" WHERE \"%1$@\" MATCH ?"
+		  @" AND \"rowid\" IN (SELECT \"rowid\" FROM temp.\"%2$@\");",
+		  [parent tableName], [parent scopeTableName]];
 		
 		sqlite3 *db = databaseConnection->db;
 		
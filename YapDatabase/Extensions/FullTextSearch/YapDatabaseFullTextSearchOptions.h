@@ -0,0 +1,184 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabaseFullTextSearchTokenizer.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The FTS5 detail option, which defines how much information is stored in the index (for each token).
+ *
+ * - Full   : the rowid, column & offset of every token (the sqlite default)
+ * - Column : only the rowid & column, so phrase & NEAR queries aren't supported
+ * - None   : only the rowid, so column filters, phrase & NEAR queries aren't supported
+ *
+ * The smaller the index, the faster the writes (and merges).
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseFullTextSearchDetail) {
+	YapDatabaseFullTextSearchDetailFull = 0,
+	YapDatabaseFullTextSearchDetailColumn,
+	YapDatabaseFullTextSearchDetailNone,
+};
+
+/**
+ * Welcome to YapDatabase!
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * The project wiki has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * This class provides extra options when initializing YapDatabaseFullTextSearch.
+ * 
+ * Note: These are options of the extension itself.
+ * The options dictionary (passed to the init method) is for the options of the sqlite FTS module (e.g. tokenize).
+**/
+@interface YapDatabaseFullTextSearchOptions : NSObject <NSCopying>
+
+/**
+ * By default, the FTS block is invoked (and the text is tokenized & inserted into the FTS table)
+ * within the readWriteTransaction that modifies the row.
+ * For large text (e.g. message bodies) this can be a significant part of the commit time.
+ *
+ * If you enable deferredIndexing, then the readWriteTransaction only adds the rowid to a small queue table.
+ * The queued rows are then indexed in the background, in batches of (at most) deferredIndexingBatchSize rows,
+ * with each batch executing in its own short readWriteTransaction (right after the transaction that queued them).
+ * The FTS block is invoked at that point, with the current object & metadata of the row.
+ *
+ * The queue is persisted, so any rows that weren't indexed yet (e.g. if the app is terminated)
+ * get indexed the next time the extension is registered.
+ * This also applies to the initial population, which only queues every rowid within the registration transaction.
+ *
+ * Queries may therefore be (slightly) stale:
+ * - Within a readWriteTransaction, if flushesBeforeQueries is set, the queue is processed before the query executes.
+ *   (And -[YapDatabaseFullTextSearchTransaction rowid:matches:] only indexes the given row, if it's queued.)
+ *   This way a readWriteTransaction always sees its own changes, and extensions that depend on this extension
+ *   (e.g. YapDatabaseSearchResultsView) keep working as usual.
+ * - Within a readOnlyTransaction, rows that are still queued won't match.
+ *   Use -[YapDatabaseFullTextSearchTransaction numberOfPendingRows] to detect this state.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL deferredIndexing;
+
+/**
+ * The maximum number of queued rows that are indexed per (background) readWriteTransaction,
+ * if deferredIndexing is enabled.
+ *
+ * The default value is 200.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger deferredIndexingBatchSize;
+
+/**
+ * If deferredIndexing is enabled, whether or not queries within a readWriteTransaction process the queue first.
+ *
+ * The default value is YES.
+**/
+@property (nonatomic, assign, readwrite) BOOL flushesBeforeQueries;
+
+// Table options
+//
+// These options are part of the FTS table itself.
+// If they change (between app launches), the table is automatically dropped & re-populated.
+// Don't specify the same option in the options dictionary (passed to the init method).
+
+/**
+ * The prefix lengths to index (FTS4 & FTS5), e.g. @[ @(2), @(3) ].
+ *
+ * Without a prefix index, a prefix query (e.g. "abc*") has to scan every token that starts with the prefix.
+ * With a prefix index (for the length of the prefix), it's a single lookup, just like a regular token.
+ * However, every prefix index (roughly) adds the size of the index, and the corresponding write cost.
+ *
+ * The default value is nil (no prefix indexes).
+**/
+@property (nonatomic, copy, readwrite, nullable) NSArray<NSNumber *> *prefixIndexes;
+
+/**
+ * The detail option (FTS5 only).
+ *
+ * The default value is YapDatabaseFullTextSearchDetailFull.
+**/
+@property (nonatomic, assign, readwrite) YapDatabaseFullTextSearchDetail detail;
+
+/**
+ * Whether or not the size (in tokens) of every column is stored (FTS5 only).
+ * If disabled (columnsize=0), the index is smaller, but bm25 queries are slower.
+ *
+ * The default value is YES.
+**/
+@property (nonatomic, assign, readwrite) BOOL storesColumnSizes;
+
+/**
+ * If enabled, the FTS table is contentless (FTS5 only), i.e. it only stores the index, and not a copy of the text.
+ * The text typically already lives in the (serialized) objects, so this roughly halves the size of the index.
+ *
+ * The text is generated on demand, when it's needed for a snippet:
+ * the FTS block is invoked for the matching row, and the snippet is generated from the text it returns.
+ * So snippet queries invoke the FTS block once per enumerated row (i.e. only for the rows you actually display).
+ *
+ * This requires sqlite 3.43 or later (contentless_delete=1), as the index needs to support updates & deletes.
+ * With an older sqlite version, this option is ignored (with a warning), and the table stores the text.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL contentless;
+
+/**
+ * A native tokenizer (FTS5 only), e.g. +[YapDatabaseFullTextSearchTokenizer unicodeTokenizer].
+ *
+ * The tokenizer is registered with every sqlite connection that uses the extension,
+ * and the table is created with the corresponding tokenize option.
+ * So don't specify a tokenize option in the options dictionary as well.
+ *
+ * Note: A custom tokenizer must remain available (i.e. the extension registered with it) as long as the table exists,
+ * as sqlite needs the tokenizer to read, write (and even drop) the table.
+ * The built-in tokenizer is always available when dropping the table.
+ *
+ * The default value is nil (the tokenizer of the options dictionary, or the sqlite default).
+**/
+@property (nonatomic, strong, readwrite, nullable) YapDatabaseFullTextSearchTokenizer *tokenizer;
+
+// Merge options
+//
+// Every write transaction adds a (small) segment to the index.
+// Queries have to search every segment, so segments are merged (into larger ones) over time.
+
+/**
+ * The automerge setting of the FTS table (FTS4 & FTS5), which is persisted in the table.
+ * For FTS5, it's the number of segments (on the same level) that triggers a merge within a write (default 4).
+ * For FTS4, see the sqlite documentation ("automerge=N").
+ *
+ * Zero disables the automatic merges, in which case you should enable mergeSegmentThreshold.
+ *
+ * The default value is -1, which means the setting is left untouched.
+**/
+@property (nonatomic, assign, readwrite) NSInteger automerge;
+
+/**
+ * The crisismerge setting of the FTS table (FTS5 only), which is persisted in the table.
+ * It's the number of segments (on the same level) that forces a merge within a write (default 16).
+ *
+ * The default value is -1, which means the setting is left untouched.
+**/
+@property (nonatomic, assign, readwrite) NSInteger crisismerge;
+
+/**
+ * If non-zero, the segments are merged in the background (off the write path),
+ * once the number of segments (in total) exceeds this threshold.
+ *
+ * The merge runs in small readWriteTransactions, each one doing (at most)
+ * mergeBatchSize pages worth of work, until the number of segments drops to the threshold.
+ * To keep the writes cheap, the number of segments is only checked every (threshold / 8) write transactions.
+ *
+ * The default value is 0 (disabled).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger mergeSegmentThreshold;
+
+/**
+ * The amount of work (in pages) per background merge transaction (see mergeSegmentThreshold).
+ *
+ * The default value is 256.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger mergeBatchSize;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,66 @@
+#import "YapDatabaseFullTextSearchOptions.h"
+
+/**
+ * Welcome to YapDatabase!
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * The project wiki has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * This class provides extra options when initializing YapDatabaseFullTextSearch.
+**/
+@implementation YapDatabaseFullTextSearchOptions
+
+@synthesize deferredIndexing = deferredIndexing;
+@synthesize deferredIndexingBatchSize = deferredIndexingBatchSize;
+@synthesize flushesBeforeQueries = flushesBeforeQueries;
+@synthesize prefixIndexes = prefixIndexes;
+@synthesize detail = detail;
+@synthesize storesColumnSizes = storesColumnSizes;
+@synthesize contentless = contentless;
+@synthesize tokenizer = tokenizer;
+@synthesize automerge = automerge;
+@synthesize crisismerge = crisismerge;
+@synthesize mergeSegmentThreshold = mergeSegmentThreshold;
+@synthesize mergeBatchSize = mergeBatchSize;
+
+- (id)init
+{
+	if ((self = [super init]))
+	{
+		deferredIndexing = NO;
+		deferredIndexingBatchSize = 200;
+		flushesBeforeQueries = YES;
+		prefixIndexes = nil;
+		detail = YapDatabaseFullTextSearchDetailFull;
+		storesColumnSizes = YES;
+		contentless = NO;
+		tokenizer = nil;
+		automerge = -1;
+		crisismerge = -1;
+		mergeSegmentThreshold = 0;
+		mergeBatchSize = 256;
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	YapDatabaseFullTextSearchOptions *copy = [[YapDatabaseFullTextSearchOptions alloc] init];
+	copy->deferredIndexing = deferredIndexing;
+	copy->deferredIndexingBatchSize = deferredIndexingBatchSize;
+	copy->flushesBeforeQueries = flushesBeforeQueries;
+	copy->prefixIndexes = prefixIndexes;
+	copy->detail = detail;
+	copy->storesColumnSizes = storesColumnSizes;
+	copy->contentless = contentless;
+	copy->tokenizer = tokenizer;
+	copy->automerge = automerge;
+	copy->crisismerge = crisismerge;
+	copy->mergeSegmentThreshold = mergeSegmentThreshold;
+	copy->mergeBatchSize = mergeBatchSize;
+	
+	return copy;
+}
+
+@end
@@ -0,0 +1,38 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabaseQuery.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * The project wiki has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A scope restricts an FTS query to a subset of the rows, e.g. "within this conversation" or "within this folder".
+ *
+ * The rows of the scope are collected (as rowids) into a temporary table,
+ * which is part of the FTS statement. So sqlite only matches & scores the rows within the scope,
+ * instead of matching against the entire FTS table (and having to discard most of the results).
+ *
+ * Collecting the scope is proportional to the size of the scope,
+ * so a scope is worthwhile when it's small compared to the number of matches of the query.
+**/
+@interface YapDatabaseFullTextSearchScope : NSObject
+
+/**
+ * The rows in the given group(s) of a view (any YapDatabaseView subclass, e.g. an AutoView).
+**/
++ (instancetype)scopeWithViewName:(NSString *)viewName group:(NSString *)group;
++ (instancetype)scopeWithViewName:(NSString *)viewName groups:(NSArray<NSString *> *)groups;
+
+/**
+ * The rows matching the given query of a YapDatabaseSecondaryIndex.
+**/
++ (instancetype)scopeWithSecondaryIndexName:(NSString *)secondaryIndexName query:(YapDatabaseQuery *)query;
+
+@end
+
+NS_ASSUME_NONNULL_END
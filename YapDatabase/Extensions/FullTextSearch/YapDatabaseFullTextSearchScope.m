@@ -0,0 +1,97 @@
+#import "YapDatabaseFullTextSearchScope.h"
+#import "YapDatabaseFullTextSearchPrivate.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * The FullTextSearch extension doesn't depend on the View & SecondaryIndex extensions,
+ * so their transactions are only used thru the methods declared here.
+ * (See YapDatabaseViewPrivate.h & YapDatabaseSecondaryIndexTransaction.h)
+**/
+@protocol YapDatabaseFullTextSearchScopeViewTransaction <NSObject>
+- (void)enumerateRowidsInGroup:(NSString *)group
+                    usingBlock:(void (^)(int64_t rowid, NSUInteger index, BOOL *stop))block;
+@end
+
+@protocol YapDatabaseFullTextSearchScopeSecondaryIndexTransaction <NSObject>
+- (BOOL)enumerateRowidsMatchingQuery:(YapDatabaseQuery *)query
+                          usingBlock:(void (^)(int64_t rowid, BOOL *stop))block;
+@end
+
+
+@implementation YapDatabaseFullTextSearchScope
+
++ (instancetype)scopeWithViewName:(NSString *)viewName group:(NSString *)group
+{
+	return [self scopeWithViewName:viewName groups:(group ? @[ group ] : @[])];
+}
+
++ (instancetype)scopeWithViewName:(NSString *)viewName groups:(NSArray<NSString *> *)groups
+{
+	YapDatabaseFullTextSearchScope *scope = [[YapDatabaseFullTextSearchScope alloc] init];
+	scope->extensionName = [viewName copy];
+	scope->groups = [groups copy];
+	
+	return scope;
+}
+
++ (instancetype)scopeWithSecondaryIndexName:(NSString *)secondaryIndexName query:(YapDatabaseQuery *)query
+{
+	YapDatabaseFullTextSearchScope *scope = [[YapDatabaseFullTextSearchScope alloc] init];
+	scope->extensionName = [secondaryIndexName copy];
+	scope->query = query;
+	
+	return scope;
+}
+
++ (instancetype)scopeWithRowidSet:(YapRowidSet *)rowidSet
+{
+	YapDatabaseFullTextSearchScope *scope = [[YapDatabaseFullTextSearchScope alloc] init];
+	scope->rowidSet = [[YapRowidSetBox alloc] initWithRowidSet:YapRowidSetCopy(rowidSet)];
+	
+	return scope;
+}
+
+- (BOOL)enumerateRowidsWithTransaction:(YapDatabaseReadTransaction *)transaction
+                            usingBlock:(void (^)(int64_t rowid, BOOL *stop))block
+{
+	if (rowidSet)
+	{
+		YapRowidSetEnumerate(rowidSet->set, block);
+		return YES;
+	}
+	
+	id ext = [transaction ext:extensionName];
+	
+	if (query)
+	{
+		if (![ext respondsToSelector:@selector(enumerateRowidsMatchingQuery:usingBlock:)]) return NO;
+		
+		return [(id <YapDatabaseFullTextSearchScopeSecondaryIndexTransaction>)ext enumerateRowidsMatchingQuery:query
+		                                                                                            usingBlock:block];
+	}
+	else
+	{
+		if (![ext respondsToSelector:@selector(enumerateRowidsInGroup:usingBlock:)]) return NO;
+		
+		__block BOOL stop = NO;
+		for (NSString *group in groups)
+		{
+			[(id <YapDatabaseFullTextSearchScopeViewTransaction>)ext enumerateRowidsInGroup:group
+			                                                                     usingBlock:
+			    ^(int64_t rowid, NSUInteger __unused index, BOOL *innerStop)
+			{
+				block(rowid, &stop);
+				if (stop) *innerStop = YES;
+			}];
+			
+			if (stop) break;
+		}
+		
+		return YES;
+	}
+}
+
+@end
@@ -0,0 +1,91 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The fts5_tokenizer struct, as defined in sqlite3.h (or fts5.h).
+**/
+struct fts5_tokenizer;
+
+/**
+ * The name of the built-in tokenizer. (See +[YapDatabaseFullTextSearchTokenizer unicodeTokenizer])
+**/
+extern NSString *const YapDatabaseFullTextSearchUnicodeTokenizerName;
+
+/**
+ * Welcome to YapDatabase!
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * The project wiki has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A native (C-level) FTS5 tokenizer, to use with YapDatabaseFullTextSearchOptions.tokenizer.
+ *
+ * The tokenizer is registered (via the fts5_api xCreateTokenizer) with every sqlite connection
+ * that uses the extension, before the connection accesses the FTS table.
+ * And the FTS table is created with "tokenize='name arguments...'".
+ *
+ * This way the text is tokenized once, inside sqlite, instead of pre-processing the text within the FTS block.
+ * Tokenizers require FTS5.
+**/
+@interface YapDatabaseFullTextSearchTokenizer : NSObject
+
+/**
+ * The built-in tokenizer ("yap_unicode").
+ *
+ * - Letters & digits (in any script) form tokens, everything else (whitespace, punctuation, symbols) separates them.
+ * - Tokens are case folded (Latin, Greek, Cyrillic & fullwidth forms).
+ * - Diacritics are removed (e.g. "Crème Brûlée" matches "creme brulee"),
+ *   for the Latin-1 & Latin Extended-A letters, Greek tonos, and any combining marks.
+ * - Chinese & Japanese text (which doesn't separate words with spaces) is segmented into overlapping bigrams.
+ *   Queries are tokenized the same way, so a (multi character) query matches as a phrase of bigrams,
+ *   and single characters are indexed as well, so single character queries match too.
+ *
+ * Letters outside the tables above are indexed as-is.
+**/
++ (instancetype)unicodeTokenizer;
+
+/**
+ * The built-in tokenizer, with the given options:
+ *
+ * @param removesDiacritics
+ *   Whether or not diacritics are removed (as described above). The default is YES.
+ *
+ * @param segmentsCJK
+ *   Whether or not Chinese & Japanese text is segmented into bigrams.
+ *   If NO, a run of Chinese / Japanese characters is a single token (like the unicode61 tokenizer). The default is YES.
+**/
++ (instancetype)unicodeTokenizerRemovingDiacritics:(BOOL)removesDiacritics segmentingCJK:(BOOL)segmentsCJK;
+
+/**
+ * A custom tokenizer.
+ *
+ * @param name
+ *   The name of the tokenizer (for the tokenize option of the table).
+ *
+ * @param arguments
+ *   The arguments (for the tokenize option of the table), which are passed to the xCreate function.
+ *   They may not contain quotes.
+ *
+ * @param tokenizer
+ *   The xCreate, xDelete & xTokenize functions. The struct is copied.
+ *
+ * @param userData
+ *   Passed to the xCreate function.
+ *
+ * @param destroy
+ *   Invoked with the userData when the YapDatabaseFullTextSearchTokenizer is deallocated.
+ *   (The tokenizer is retained by every sqlite connection it's registered with.)
+**/
++ (instancetype)tokenizerWithName:(NSString *)name
+                        arguments:(nullable NSArray<NSString *> *)arguments
+                        tokenizer:(const struct fts5_tokenizer *)tokenizer
+                         userData:(nullable void *)userData
+                          destroy:(nullable void (*)(void *userData))destroy;
+
+@property (nonatomic, copy, readonly) NSString *name;
+@property (nonatomic, copy, readonly) NSArray<NSString *> *arguments;
+
+@end
+
+NS_ASSUME_NONNULL_END
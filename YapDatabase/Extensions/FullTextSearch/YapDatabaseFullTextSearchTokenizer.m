@@ -0,0 +1,618 @@
+#import "YapDatabaseFullTextSearchTokenizer.h"
+#import "YapDatabaseFullTextSearchPrivate.h"
+
+#import "YapDatabasePrivate.h"
+
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+NSString *const YapDatabaseFullTextSearchUnicodeTokenizerName = @"yap_unicode";
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Unicode Tokenizer
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef NS_ENUM(int, YapUnicodeClass) {
+	YapUnicodeClassSeparator = 0,
+	YapUnicodeClassWord,
+	YapUnicodeClassCJK,
+};
+
+typedef struct {
+	int removesDiacritics;
+	int segmentsCJK;
+} YapUnicodeTokenizer;
+
+/**
+ * The base letters of U+00C0 - U+017F (Latin-1 Supplement & Latin Extended-A), for removing diacritics.
+ * A '.' means the letter has no (single) base letter, e.g. 'æ' or 'ß'.
+**/
+static const char YapLatinBaseLetters[] =
+	"aaaaaa.ceeeeiiii.nooooo.ouuuuy.."   // U+00C0 - U+00DF
+	"aaaaaa.ceeeeiiii.nooooo.ouuuuy.y"   // U+00E0 - U+00FF
+	"aaaaaaccccccccddddeeeeeeeeeegggg"   // U+0100 - U+011F
+	"gggghhhhiiiiiiiiii..jjkkklllllll"   // U+0120 - U+013F
+	"lllnnnnnnnnnoooooo..rrrrrrssssss"   // U+0140 - U+015F
+	"ssttttttuuuuuuuuuuuuwwyyyzzzzzzs";  // U+0160 - U+017F
+
+/**
+ * Decodes the UTF-8 character at *indexPtr, and advances the index.
+ * Malformed sequences decode (one byte at a time) as U+FFFD.
+**/
+static uint32_t YapUnicodeDecode(const unsigned char *text, int length, int *indexPtr)
+{
+	int i = *indexPtr;
+	uint32_t c = text[i++];
+	
+	if (c >= 0x80)
+	{
+		int extra;
+		if      ((c & 0xE0) == 0xC0) { extra = 1; c &= 0x1F; }
+		else if ((c & 0xF0) == 0xE0) { extra = 2; c &= 0x0F; }
+		else if ((c & 0xF8) == 0xF0) { extra = 3; c &= 0x07; }
+		else                         { extra = -1; }
+		
+		if ((extra < 0) || ((i + extra) > length))
+		{
+			*indexPtr = i;
+			return 0xFFFD;
+		}
+		
+		for (int k = 0; k < extra; k++)
+		{
+			uint32_t b = text[i + k];
+			if ((b & 0xC0) != 0x80)
+			{
+				*indexPtr = i;
+				return 0xFFFD;
+			}
+			
+			c = (c << 6) | (b & 0x3F);
+		}
+		
+		i += extra;
+	}
+	
+	*indexPtr = i;
+	return c;
+}
+
+static int YapUnicodeEncode(uint32_t c, char *buffer)
+{
+	if (c < 0x80) {
+		buffer[0] = (char)c;
+		return 1;
+	}
+	if (c < 0x800) {
+		buffer[0] = (char)(0xC0 | (c >> 6));
+		buffer[1] = (char)(0x80 | (c & 0x3F));
+		return 2;
+	}
+	if (c < 0x10000) {
+		buffer[0] = (char)(0xE0 | (c >> 12));
+		buffer[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+		buffer[2] = (char)(0x80 | (c & 0x3F));
+		return 3;
+	}
+	
+	buffer[0] = (char)(0xF0 | (c >> 18));
+	buffer[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+	buffer[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+	buffer[3] = (char)(0x80 | (c & 0x3F));
+	return 4;
+}
+
+static BOOL YapUnicodeIsCJK(uint32_t c)
+{
+	return (c >= 0x2E80 && c <= 0x2FDF)   || // CJK radicals
+	       (c >= 0x3005 && c <= 0x3007)   || // Ideographic iteration & number marks
+	       (c >= 0x3040 && c <= 0x30FF)   || // Hiragana & Katakana
+	       (c >= 0x31F0 && c <= 0x31FF)   || // Katakana phonetic extensions
+	       (c >= 0x3400 && c <= 0x4DBF)   || // CJK unified ideographs extension A
+	       (c >= 0x4E00 && c <= 0x9FFF)   || // CJK unified ideographs
+	       (c >= 0xF900 && c <= 0xFAFF)   || // CJK compatibility ideographs
+	       (c >= 0xFF66 && c <= 0xFF9F)   || // Halfwidth Katakana
+	       (c >= 0x20000 && c <= 0x2FA1F);   // CJK unified ideographs extension B+
+}
+
+static YapUnicodeClass YapUnicodeClassify(uint32_t c, const YapUnicodeTokenizer *tokenizer)
+{
+	if (c < 0x80)
+	{
+		if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+			return YapUnicodeClassWord;
+		else
+			return YapUnicodeClassSeparator;
+	}
+	
+	if (c < 0xC0)
+	{
+		// Latin-1 punctuation & symbols, except for: ª ² ³ µ ¹ º ¼ ½ ¾
+		
+		switch (c)
+		{
+			case 0xAA: case 0xB2: case 0xB3: case 0xB5: case 0xB9: case 0xBA: case 0xBC: case 0xBD: case 0xBE:
+				return YapUnicodeClassWord;
+			default:
+				return YapUnicodeClassSeparator;
+		}
+	}
+	
+	if (c == 0xD7 || c == 0xF7) return YapUnicodeClassSeparator; // × ÷
+	
+	if (tokenizer->segmentsCJK && YapUnicodeIsCJK(c)) return YapUnicodeClassCJK;
+	
+	if ((c >= 0x2000 && c <= 0x206F) || // General punctuation
+	    (c >= 0x20A0 && c <= 0x20CF) || // Currency symbols
+	    (c >= 0x2190 && c <= 0x2BFF) || // Arrows, math operators, box drawing, misc symbols, dingbats ...
+	    (c >= 0x2E00 && c <= 0x2E7F) || // Supplemental punctuation
+	    (c >= 0x3000 && c <= 0x3004) || // CJK symbols & punctuation
+	    (c >= 0x3008 && c <= 0x303F) ||
+	    (c >= 0xD800 && c <= 0xF8FF) || // Surrogates & private use
+	    (c >= 0xFE30 && c <= 0xFE6F) || // CJK compatibility forms & small forms
+	    (c >= 0xFF00 && c <= 0xFF0F) || // Fullwidth punctuation
+	    (c >= 0xFF1A && c <= 0xFF20) ||
+	    (c >= 0xFF3B && c <= 0xFF40) ||
+	    (c >= 0xFF5B && c <= 0xFF65) ||
+	    (c >= 0xFFF0 && c <= 0xFFFF) || // Specials (including U+FFFD)
+	    (c == 0xFEFF)                || // BOM
+	    (c >= 0x1F000 && c <= 0x1FAFF)) // Emoji & pictographs
+	{
+		return YapUnicodeClassSeparator;
+	}
+	
+	return YapUnicodeClassWord;
+}
+
+/**
+ * Returns the folded (lowercase, and optionally without diacritics) character,
+ * or zero if the character should be dropped from the token (a combining mark, when removing diacritics).
+**/
+static uint32_t YapUnicodeFold(uint32_t c, const YapUnicodeTokenizer *tokenizer)
+{
+	if (c < 0x80)
+	{
+		return (c >= 'A' && c <= 'Z') ? (c + 0x20) : c;
+	}
+	
+	if (c >= 0xC0 && c <= 0x17F)
+	{
+		if (tokenizer->removesDiacritics)
+		{
+			char base = YapLatinBaseLetters[c - 0xC0];
+			if (base != '.') return (uint32_t)base;
+		}
+		
+		if (c <= 0xDE)                        return (c == 0xD7) ? c : (c + 0x20);
+		if (c < 0x100)                        return c;
+		if (c == 0x130)                       return 'i';
+		if (c == 0x178)                       return 0xFF;
+		if ((c <= 0x137) || (c >= 0x14A && c <= 0x177))
+			return (c & 1) ? c : (c + 1);
+		if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E))
+			return (c & 1) ? (c + 1) : c;
+		
+		return c;
+	}
+	
+	if (c >= 0x300 && c <= 0x36F)
+	{
+		return tokenizer->removesDiacritics ? 0 : c; // Combining diacritical marks
+	}
+	
+	if (c >= 0x370 && c <= 0x3FF)
+	{
+		// Greek
+		
+		if      (c >= 0x391 && c <= 0x3AB && c != 0x3A2) c += 0x20;
+		else if (c == 0x386)                             c = 0x3AC;
+		else if (c >= 0x388 && c <= 0x38A)               c += 0x25;
+		else if (c == 0x38C)                             c = 0x3CC;
+		else if (c == 0x38E || c == 0x38F)               c += 0x3F;
+		
+		if (tokenizer->removesDiacritics)
+		{
+			switch (c)
+			{
+				case 0x3AC: return 0x3B1;
+				case 0x3AD: return 0x3B5;
+				case 0x3AE: return 0x3B7;
+				case 0x3AF: return 0x3B9;
+				case 0x3CC: return 0x3BF;
+				case 0x3CD: return 0x3C5;
+				case 0x3CE: return 0x3C9;
+				case 0x3CA: case 0x390: return 0x3B9;
+				case 0x3CB: case 0x3B0: return 0x3C5;
+			}
+		}
+		
+		return c;
+	}
+	
+	if (c >= 0x400 && c <= 0x42F)
+	{
+		// Cyrillic
+		
+		c += (c < 0x410) ? 0x50 : 0x20;
+		
+		if (tokenizer->removesDiacritics && c == 0x451) return 0x435; // ё -> е
+		return c;
+	}
+	
+	if (c == 0x451 && tokenizer->removesDiacritics)
+	{
+		return 0x435;
+	}
+	
+	if (c >= 0xFF10 && c <= 0xFF19) return '0' + (c - 0xFF10); // Fullwidth digits
+	if (c >= 0xFF21 && c <= 0xFF3A) return 'a' + (c - 0xFF21); // Fullwidth uppercase
+	if (c >= 0xFF41 && c <= 0xFF5A) return 'a' + (c - 0xFF41); // Fullwidth lowercase
+	
+	return c;
+}
+
+static int YapUnicodeTokenizerCreate(void __unused *userData, const char **args, int argCount, Fts5Tokenizer **outTokenizer)
+{
+	YapUnicodeTokenizer *tokenizer = sqlite3_malloc(sizeof(YapUnicodeTokenizer));
+	if (tokenizer == NULL) return SQLITE_NOMEM;
+	
+	tokenizer->removesDiacritics = 1;
+	tokenizer->segmentsCJK = 1;
+	
+	// Arguments are key/value pairs, e.g. "remove_diacritics 0 cjk 1"
+	
+	int status = (argCount % 2 == 0) ? SQLITE_OK : SQLITE_ERROR;
+	
+	for (int i = 0; (i + 1) < argCount && status == SQLITE_OK; i += 2)
+	{
+		const char *key = args[i];
+		const char *value = args[i + 1];
+		
+		int flag;
+		if      (strcmp(value, "0") == 0) flag = 0;
+		else if (strcmp(value, "1") == 0) flag = 1;
+		else
+		{
+			status = SQLITE_ERROR;
+			break;
+		}
+		
+		if      (strcmp(key, "remove_diacritics") == 0) tokenizer->removesDiacritics = flag;
+		else if (strcmp(key, "cjk") == 0)               tokenizer->segmentsCJK = flag;
+		else                                            status = SQLITE_ERROR;
+	}
+	
+	if (status != SQLITE_OK)
+	{
+		sqlite3_free(tokenizer);
+		tokenizer = NULL;
+	}
+	
+	*outTokenizer = (Fts5Tokenizer *)tokenizer;
+	return status;
+}
+
+static void YapUnicodeTokenizerDelete(Fts5Tokenizer *tokenizer)
+{
+	sqlite3_free(tokenizer);
+}
+
+/**
+ * Words are folded into a buffer, which starts on the stack, and only grows (on the heap) for very long words.
+ * CJK tokens are passed straight from the text (they're never folded).
+**/
+static int YapUnicodeTokenizerTokenize(Fts5Tokenizer *fts5Tokenizer,
+                                       void *context,
+                                       int flags,
+                                       const char *text,
+                                       int length,
+                                       int (*tokenCallback)(void *context, int tokenFlags,
+                                                            const char *token, int tokenLength,
+                                                            int start, int end))
+{
+	const YapUnicodeTokenizer *tokenizer = (const YapUnicodeTokenizer *)fts5Tokenizer;
+	const unsigned char *utf8 = (const unsigned char *)text;
+	
+	BOOL isQuery = (flags & FTS5_TOKENIZE_QUERY) != 0;
+	
+	char stackBuffer[128];
+	char *buffer = stackBuffer;
+	int bufferCapacity = sizeof(stackBuffer);
+	
+	int status = SQLITE_OK;
+	int i = 0;
+	
+	while ((i < length) && (status == SQLITE_OK))
+	{
+		int start = i;
+		uint32_t c = YapUnicodeDecode(utf8, length, &i);
+		
+		YapUnicodeClass charClass = YapUnicodeClassify(c, tokenizer);
+		
+		if (charClass == YapUnicodeClassWord)
+		{
+			int end = i;
+			int bufferLength = 0;
+			
+			while (YES)
+			{
+				uint32_t folded = YapUnicodeFold(c, tokenizer);
+				if (folded)
+				{
+					if ((bufferLength + 4) > bufferCapacity)
+					{
+						int newCapacity = bufferCapacity * 2;
+						char *newBuffer = sqlite3_malloc(newCapacity);
+						if (newBuffer == NULL)
+						{
+							status = SQLITE_NOMEM;
+							break;
+						}
+						
+						memcpy(newBuffer, buffer, bufferLength);
+						if (buffer != stackBuffer) sqlite3_free(buffer);
+						
+						buffer = newBuffer;
+						bufferCapacity = newCapacity;
+					}
+					
+					bufferLength += YapUnicodeEncode(folded, buffer + bufferLength);
+				}
+				
+				end = i;
+				if (i >= length) break;
+				
+				int next = i;
+				c = YapUnicodeDecode(utf8, length, &next);
+				
+				if (YapUnicodeClassify(c, tokenizer) != YapUnicodeClassWord) break;
+				i = next;
+			}
+			
+			if ((status == SQLITE_OK) && (bufferLength > 0))
+			{
+				status = tokenCallback(context, 0, buffer, bufferLength, start, end);
+			}
+		}
+		else if (charClass == YapUnicodeClassCJK)
+		{
+			// Bigrams:
+			//
+			// Document : every character (so single character queries match),
+			//            plus the bigram it starts (colocated, i.e. at the same position)
+			// Query    : the bigrams, which match as a phrase
+			//            (or the character itself, if it's a single character)
+			
+			int charStart = start;
+			int charEnd = i;
+			BOOL isFirst = YES;
+			
+			while (status == SQLITE_OK)
+			{
+				int nextEnd = charEnd;
+				BOOL nextIsCJK = NO;
+				
+				if (nextEnd < length)
+				{
+					uint32_t next = YapUnicodeDecode(utf8, length, &nextEnd);
+					nextIsCJK = (YapUnicodeClassify(next, tokenizer) == YapUnicodeClassCJK);
+				}
+				
+				if (isQuery)
+				{
+					if (nextIsCJK)
+						status = tokenCallback(context, 0, text + charStart, nextEnd - charStart, charStart, nextEnd);
+					else if (isFirst)
+						status = tokenCallback(context, 0, text + charStart, charEnd - charStart, charStart, charEnd);
+				}
+				else
+				{
+					status = tokenCallback(context, 0, text + charStart, charEnd - charStart, charStart, charEnd);
+					
+					if (nextIsCJK && (status == SQLITE_OK))
+					{
+						status = tokenCallback(context, FTS5_TOKEN_COLOCATED,
+						                       text + charStart, nextEnd - charStart, charStart, nextEnd);
+					}
+				}
+				
+				if (!nextIsCJK) break;
+				
+				charStart = charEnd;
+				charEnd = nextEnd;
+				isFirst = NO;
+			}
+			
+			i = charEnd;
+		}
+	}
+	
+	if (buffer != stackBuffer) {
+		sqlite3_free(buffer);
+	}
+	
+	return status;
+}
+
+static const fts5_tokenizer YapUnicodeTokenizerModule = {
+	YapUnicodeTokenizerCreate,
+	YapUnicodeTokenizerDelete,
+	YapUnicodeTokenizerTokenize,
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Registration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the fts5_api of the given connection, or NULL if FTS5 isn't available.
+**/
+static fts5_api* YapFts5Api(sqlite3 *db)
+{
+	fts5_api *api = NULL;
+	sqlite3_stmt *statement = NULL;
+	
+	if (sqlite3_libversion_number() >= 3020000)
+	{
+		// SELECT fts5(?1), with the pointer bound to ?1
+		
+		if (sqlite3_prepare_v2(db, "SELECT fts5(?1);", -1, &statement, NULL) == SQLITE_OK)
+		{
+			sqlite3_bind_pointer(statement, SQLITE_BIND_START, (void *)&api, "fts5_api_ptr", NULL);
+			sqlite3_step(statement);
+		}
+	}
+	else
+	{
+		// Older versions return the pointer as a blob
+		
+		if (sqlite3_prepare_v2(db, "SELECT fts5();", -1, &statement, NULL) == SQLITE_OK)
+		{
+			if ((sqlite3_step(statement) == SQLITE_ROW) &&
+			    (sqlite3_column_bytes(statement, SQLITE_COLUMN_START) == sizeof(api)))
+			{
+				memcpy(&api, sqlite3_column_blob(statement, SQLITE_COLUMN_START), sizeof(api));
+			}
+		}
+	}
+	
+	sqlite3_finalize(statement);
+	return api;
+}
+
+/**
+ * The xCreate function that's registered with sqlite, which forwards to the xCreate function of the tokenizer.
+ * The userData (for sqlite) is the YapDatabaseFullTextSearchTokenizer, retained by the connection.
+**/
+static int YapTokenizerCreate(void *userData, const char **args, int argCount, Fts5Tokenizer **outTokenizer)
+{
+	__unsafe_unretained YapDatabaseFullTextSearchTokenizer *tokenizer =
+	  (__bridge YapDatabaseFullTextSearchTokenizer *)userData;
+	
+	return tokenizer->module.xCreate(tokenizer->userData, args, argCount, outTokenizer);
+}
+
+static void YapTokenizerRelease(void *userData)
+{
+	CFRelease(userData);
+}
+
+
+@implementation YapDatabaseFullTextSearchTokenizer
+
+@synthesize name = name;
+@synthesize arguments = arguments;
+
++ (instancetype)unicodeTokenizer
+{
+	return [self unicodeTokenizerRemovingDiacritics:YES segmentingCJK:YES];
+}
+
++ (instancetype)unicodeTokenizerRemovingDiacritics:(BOOL)removesDiacritics segmentingCJK:(BOOL)segmentsCJK
+{
+	NSMutableArray<NSString *> *arguments = [NSMutableArray arrayWithCapacity:4];
+	
+	if (!removesDiacritics) {
+		[arguments addObjectsFromArray:@[ @"remove_diacritics", @"0" ]];
+	}
+	if (!segmentsCJK) {
+		[arguments addObjectsFromArray:@[ @"cjk", @"0" ]];
+	}
+	
+	return [self tokenizerWithName:YapDatabaseFullTextSearchUnicodeTokenizerName
+	                     arguments:arguments
+	                     tokenizer:&YapUnicodeTokenizerModule
+	                      userData:NULL
+	                       destroy:NULL];
+}
+
++ (instancetype)tokenizerWithName:(NSString *)name
+                        arguments:(NSArray<NSString *> *)arguments
+                        tokenizer:(const struct fts5_tokenizer *)tokenizer
+                         userData:(void *)userData
+                          destroy:(void (*)(void *userData))destroy
+{
+	NSParameterAssert([name length] > 0);
+	NSParameterAssert(tokenizer != NULL);
+	
+	YapDatabaseFullTextSearchTokenizer *result = [[YapDatabaseFullTextSearchTokenizer alloc] init];
+	
+	result->name = [name copy];
+	result->arguments = arguments ? [arguments copy] : @[];
+	result->module = *tokenizer;
+	result->userData = userData;
+	result->destroy = destroy;
+	
+	return result;
+}
+
+- (void)dealloc
+{
+	if (destroy) {
+		destroy(userData);
+	}
+}
+
+/**
+ * Returns the tokenize option for the table, e.g. "tokenize='yap_unicode remove_diacritics 0'"
+**/
+- (NSString *)tableOption
+{
+	NSMutableArray<NSString *> *components = [NSMutableArray arrayWithCapacity:(1 + [arguments count])];
+	[components addObject:name];
+	[components addObjectsFromArray:arguments];
+	
+	NSString *tokenize = [components componentsJoinedByString:@" "];
+	tokenize = [tokenize stringByReplacingOccurrencesOfString:@"'" withString:@"''"];
+	
+	return [NSString stringWithFormat:@"tokenize='%@'", tokenize];
+}
+
+- (BOOL)registerWithDatabase:(sqlite3 *)db
+{
+	fts5_api *api = YapFts5Api(db);
+	if (api == NULL)
+	{
+		YDBLogError(@"%@ - Unable to register tokenizer (%@): FTS5 isn't available", THIS_METHOD, name);
+		return NO;
+	}
+	
+	fts5_tokenizer forwardingModule = module;
+	forwardingModule.xCreate = YapTokenizerCreate;
+	
+	void *retainedSelf = (void *)CFBridgingRetain(self);
+	
+	int status = api->xCreateTokenizer(api, [name UTF8String], retainedSelf, &forwardingModule, YapTokenizerRelease);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Error registering tokenizer (%@): %d %s", THIS_METHOD, name, status, sqlite3_errmsg(db));
+		
+		CFRelease(retainedSelf);
+		return NO;
+	}
+	
+	return YES;
+}
+
++ (BOOL)registerBuiltInTokenizersWithDatabase:(sqlite3 *)db
+{
+	if (YapFts5Api(db) == NULL) return NO;
+	
+	return [[self unicodeTokenizer] registerWithDatabase:db];
+}
+
+@end
@@ -3,6 +3,8 @@
 #import "YapDatabaseExtensionTransaction.h"
 #import "YapDatabaseFullTextSearchSnippetOptions.h"
 
+@class YapDatabaseFullTextSearchScope;
+
 NS_ASSUME_NONNULL_BEGIN
 
 /**
@@ -44,6 +46,22 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)enumerateRowsMatching:(NSString *)query
                    usingBlock:(void (^)(NSString *collection, NSString *key, id object, __nullable id metadata, BOOL *stop))block;
 
+// Query matching, within a scope (e.g. a view group, or a secondary index query).
+// See YapDatabaseFullTextSearchScope.
+// A nil scope is the same as the non-scoped methods above.
+
+- (void)enumerateKeysMatching:(NSString *)query
+                      inScope:(nullable YapDatabaseFullTextSearchScope *)scope
+                   usingBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block;
+
+- (void)enumerateKeysAndObjectsMatching:(NSString *)query
+                                inScope:(nullable YapDatabaseFullTextSearchScope *)scope
+                             usingBlock:(void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block;
+
+- (void)enumerateRowsMatching:(NSString *)query
+                      inScope:(nullable YapDatabaseFullTextSearchScope *)scope
+                   usingBlock:(void (^)(NSString *collection, NSString *key, id object, __nullable id metadata, BOOL *stop))block;
+
 // FTS5 bm25 ordering
 
 - (void)enumerateBm25OrderedKeysMatching:(NSString *)query
@@ -62,6 +80,44 @@ NS_ASSUME_NONNULL_BEGIN
                              withWeights:(nullable NSArray<NSNumber *> *)weights
                               usingBlock:(void (^)(NSString *collection, NSString *key, id object, __nullable id metadata, BOOL *stop))block;
 
+// FTS5 bm25 ordering, top-K (e.g. the first page of search results)
+//
+// The limit & offset are part of the query, so only the top (limit + offset) rows are kept (and sorted)
+// while the matches are scored, and the enumeration stops after (at most) limit rows.
+// A limit of zero means no limit.
+//
+// The snippet variants only generate the snippets for the enumerated rows,
+// rather than for every match.
+
+- (void)enumerateBm25OrderedKeysMatching:(NSString *)query
+                             withWeights:(nullable NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                              usingBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block;
+
+- (void)enumerateBm25OrderedRowsMatching:(NSString *)query
+                             withWeights:(nullable NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                              usingBlock:
+            (void (^)(NSString *collection, NSString *key, id object, __nullable id metadata, BOOL *stop))block;
+
+- (void)enumerateBm25OrderedKeysMatching:(NSString *)query
+                             withWeights:(nullable NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                      withSnippetOptions:(nullable YapDatabaseFullTextSearchSnippetOptions *)options
+                              usingBlock:
+            (void (^)(NSString *snippet, NSString *collection, NSString *key, BOOL *stop))block;
+
+- (void)enumerateBm25OrderedRowsMatching:(NSString *)query
+                             withWeights:(nullable NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                      withSnippetOptions:(nullable YapDatabaseFullTextSearchSnippetOptions *)options
+                              usingBlock:
+            (void (^)(NSString *snippet, NSString *collection, NSString *key, id object, __nullable id metadata, BOOL *stop))block;
+
 // Query matching + Snippets
 
 - (void)enumerateKeysMatching:(NSString *)query
@@ -84,6 +140,37 @@ NS_ASSUME_NONNULL_BEGIN
                    usingBlock:
             (void (^)(NSString *snippet, NSString *collection, NSString *key, id object, __nullable id metadata, BOOL *stop))block;
 
+// Deferred indexing (see YapDatabaseFullTextSearchOptions.deferredIndexing)
+
+/**
+ * Returns the number of modified rows that are waiting to be indexed (in the background).
+ * Always returns zero if deferredIndexing isn't enabled.
+**/
+- (NSUInteger)numberOfPendingRows;
+
+/**
+ * Indexes every row that's waiting to be indexed, so the index is up-to-date when the transaction commits.
+ * This method is only allowed within a readWriteTransaction.
+**/
+- (void)flushPendingRows;
+
+// Merging (see YapDatabaseFullTextSearchOptions.mergeSegmentThreshold)
+
+/**
+ * Returns the number of segments in the FTS index.
+ * Every write adds a (small) segment, and queries have to search every segment.
+**/
+- (NSUInteger)numberOfSegments;
+
+/**
+ * Merges every segment of the FTS index into a single one (the FTS 'optimize' command).
+ * This is the optimal state for queries, but it's expensive for a large index,
+ * so you'll want to run it within an asyncReadWriteTransaction (e.g. after a bulk import).
+ *
+ * This method is only allowed within a readWriteTransaction.
+**/
+- (void)optimize;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -23,6 +23,7 @@
 static NSString *const ext_key__classVersion       = @"classVersion";
 static NSString *const ext_key__versionTag         = @"versionTag";
 static NSString *const ext_key__ftsVersion         = @"ftsVersion";
+static NSString *const ext_key__tableOptions       = @"tableOptions";
 static NSString *const ext_key__version_deprecated = @"version";
 
 
@@ -73,6 +74,8 @@ static NSString *const ext_key__version_deprecated = @"version";
         
         NSString *ftsVersion = parentConnection->parent->ftsVersion;
         [self setStringValue:ftsVersion forExtensionKey:ext_key__ftsVersion persistent:YES];
+		
+		[self setStringValue:[self tableOptions] forExtensionKey:ext_key__tableOptions persistent:YES];
 	}
 	else
 	{
@@ -87,6 +90,13 @@ static NSString *const ext_key__version_deprecated = @"version";
         
         NSString *oldFtsVesrion = [self stringValueForExtensionKey:ext_key__ftsVersion persistent:YES];
 		
+		// The table options (e.g. prefix indexes) are part of the table,
+		// so the table needs to be re-created if they changed.
+		// Tables created before the table options existed don't have any.
+		
+		NSString *tableOptions = [self tableOptions];
+		NSString *oldTableOptions = [self stringValueForExtensionKey:ext_key__tableOptions persistent:YES] ?: @"";
+		
 		BOOL hasOldVersion_deprecated = NO;
 		if (oldVersionTag == nil)
 		{
@@ -101,7 +111,9 @@ static NSString *const ext_key__version_deprecated = @"version";
 			}
 		}
 		
-		if (![oldVersionTag isEqualToString:versionTag] || ![oldFtsVesrion isEqualToString:ftsVersion])
+		if (![oldVersionTag isEqualToString:versionTag] ||
+		    ![oldFtsVesrion isEqualToString:ftsVersion] ||
+		    ![oldTableOptions isEqualToString:tableOptions])
 		{
 			if (![self dropTable]) return NO;
 			if (![self createTable]) return NO;
@@ -109,6 +121,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 			
 			[self setStringValue:versionTag forExtensionKey:ext_key__versionTag persistent:YES];
 			[self setStringValue:ftsVersion forExtensionKey:ext_key__ftsVersion persistent:YES];
+			[self setStringValue:tableOptions forExtensionKey:ext_key__tableOptions persistent:YES];
 			
 			if (hasOldVersion_deprecated)
 				[self removeValueForExtensionKey:ext_key__version_deprecated persistent:YES];
@@ -120,6 +133,10 @@ static NSString *const ext_key__version_deprecated = @"version";
 		}
 	}
 	
+	if (![self updatePendingTable]) return NO;
+	
+	[self updateMergeSettings];
+	
 	return YES;
 }
 
@@ -159,6 +176,29 @@ static NSString *const ext_key__version_deprecated = @"version";
 		return NO;
 	}
 	
+	return [self dropPendingTable];
+}
+
+/**
+ * Internal method.
+ *
+ * This method is called, if needed, to drop the queue of rows waiting to be indexed.
+**/
+- (BOOL)dropPendingTable
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *pendingTableName = [parentConnection->parent pendingTableName];
+	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", pendingTableName];
+	
+	int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed dropping FTS pending table (%@): %d %s",
+		            THIS_METHOD, dropTable, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
 	return YES;
 }
 
@@ -209,6 +249,15 @@ static NSString *const ext_key__version_deprecated = @"version";
 		i++;
 	}];
 	
+	NSString *tableOptions = [self tableOptions];
+	if ([tableOptions length] > 0)
+	{
+		if (i == 0)
+			[createTable appendString:tableOptions];
+		else
+			[createTable appendFormat:@", %@", tableOptions];
+	}
+	
 	[createTable appendString:@");"];
 	
 	int status = sqlite3_exec(db, [createTable UTF8String], NULL, NULL, NULL);
@@ -219,6 +268,69 @@ static NSString *const ext_key__version_deprecated = @"version";
 		return NO;
 	}
 	
+	if ([self isDeferred])
+	{
+		// The population (below) only queues the rows
+		
+		if (![self createPendingTable]) return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * Creates the queue of rows waiting to be indexed (see YapDatabaseFullTextSearchOptions.deferredIndexing).
+**/
+- (BOOL)createPendingTable
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *pendingTableName = [parentConnection->parent pendingTableName];
+	NSString *createTable = [NSString stringWithFormat:
+	  @"CREATE TABLE IF NOT EXISTS \"%@\" (\"rowid\" INTEGER PRIMARY KEY);", pendingTableName];
+	
+	int status = sqlite3_exec(db, [createTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed creating FTS pending table (%@): %d %s",
+		            THIS_METHOD, pendingTableName, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * This method is called (at the end of createIfNeeded) to sync the queue with the deferredIndexing option.
+ *
+ * If deferredIndexing is enabled, any rows left in the queue (e.g. from a previous app launch) get indexed
+ * in the background, once the extension is registered.
+ * If deferredIndexing was disabled, then the rows left in the queue are indexed now, and the queue is dropped.
+**/
+- (BOOL)updatePendingTable
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	if ([self isDeferred])
+	{
+		if (![self createPendingTable]) return NO;
+		
+		if ([self numberOfPendingRows] > 0)
+		{
+			atomic_store(&parentConnection->parent->backgroundWorkScheduled, true);
+		}
+	}
+	else if ([YapDatabase tableExists:[parentConnection->parent pendingTableName] using:db])
+	{
+		[self indexQueuedRowidsWithLimit:0];
+		
+		if (![self dropPendingTable]) return NO;
+	}
+	
 	return YES;
 }
 
@@ -234,10 +346,81 @@ static NSString *const ext_key__version_deprecated = @"version";
 	
 	[self removeAllRowids];
 	
+	if ([self isDeferred])
+	{
+		// Queue every row, and index them (in batches) in the background.
+		
+		return [self queueAllRowids];
+	}
+	
 	// Enumerate the existing rows in the database and populate the indexes
 	
 	__unsafe_unretained YapDatabaseFullTextSearchHandler *handler = parentConnection->parent->handler;
 	
+	YapDatabaseExtensionPopulation *population =
+	  ((YapDatabaseReadWriteTransaction *)databaseTransaction)->extensionPopulation;
+	
+	if (population)
+	{
+		// Multiple extensions are being registered together.
+		// The rows will be handed to us during a shared enumeration of the database.
+		
+		YapDatabaseFullTextSearchHandler *strongHandler = handler;
+		
+		YapDatabaseExtensionPopulationBlock block =
+		^(int64_t rowid, NSString *collection, NSString *key, id object, id metadata){
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			YapDatabaseBlockType blockType = strongHandler->blockType;
+			
+			if (blockType == YapDatabaseBlockTypeWithKey)
+			{
+				__unsafe_unretained YapDatabaseFullTextSearchWithKeyBlock ftsBlock =
+				  (YapDatabaseFullTextSearchWithKeyBlock)strongHandler->block;
+				
+				ftsBlock(databaseTransaction, parentConnection->blockDict, collection, key);
+			}
+			else if (blockType == YapDatabaseBlockTypeWithObject)
+			{
+				__unsafe_unretained YapDatabaseFullTextSearchWithObjectBlock ftsBlock =
+				  (YapDatabaseFullTextSearchWithObjectBlock)strongHandler->block;
+				
+				ftsBlock(databaseTransaction, parentConnection->blockDict, collection, key, object);
+			}
+			else if (blockType == YapDatabaseBlockTypeWithMetadata)
+			{
+				__unsafe_unretained YapDatabaseFullTextSearchWithMetadataBlock ftsBlock =
+				  (YapDatabaseFullTextSearchWithMetadataBlock)strongHandler->block;
+				
+				ftsBlock(databaseTransaction, parentConnection->blockDict, collection, key, metadata);
+			}
+			else
+			{
+				__unsafe_unretained YapDatabaseFullTextSearchWithRowBlock ftsBlock =
+				  (YapDatabaseFullTextSearchWithRowBlock)strongHandler->block;
+				
+				ftsBlock(databaseTransaction, parentConnection->blockDict, collection, key, object, metadata);
+			}
+			
+			if ([parentConnection->blockDict count] > 0)
+			{
+				[self addRowid:rowid isNew:YES];
+				[parentConnection->blockDict removeAllObjects];
+			}
+			
+		#pragma clang diagnostic pop
+		};
+		
+		[population addParticipantWithName:[self registeredName]
+		                allowedCollections:nil
+		                         blockType:handler->blockType
+		                            filter:nil
+		                             block:block
+		                        completion:nil];
+		return YES;
+	}
+	
 	if (handler->blockType == YapDatabaseBlockTypeWithKey)
 	{
 		__unsafe_unretained YapDatabaseFullTextSearchWithKeyBlock block =
@@ -330,6 +513,38 @@ static NSString *const ext_key__version_deprecated = @"version";
 	return YES;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Bulk Load
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+ *
+ * With deferredIndexing, the row hooks only queue the rowids, which is already cheap.
+ * Whereas rebuilding would queue every row, leaving the whole index stale until the queue has been drained.
+**/
+- (BOOL)supportsBulkLoad
+{
+	return ![self isDeferred];
+}
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+ *
+ * Repopulates the table, and then merges all of the segments created by the inserts into one.
+**/
+- (BOOL)rebuildAfterBulkLoad
+{
+	if (![self populate]) return NO;
+	
+	if ([self executeCommand:@"optimize" value:nil changes:NULL])
+	{
+		parentConnection->didMergeSegments = YES;
+	}
+	
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -360,14 +575,174 @@ static NSString *const ext_key__version_deprecated = @"version";
 	return [parentConnection->parent tableName];
 }
 
+- (BOOL)isDeferred
+{
+	return parentConnection->parent->extensionOptions.deferredIndexing;
+}
+
+- (BOOL)isFTS5
+{
+	return [parentConnection->parent->ftsVersion isEqualToString:YapDatabaseFullTextSearchFTS5Version];
+}
+
+/**
+ * Contentless tables require FTS5, and contentless_delete=1 (sqlite 3.43) to support updates & deletes.
+**/
+- (BOOL)isContentless
+{
+	return parentConnection->parent->extensionOptions.contentless && [self isFTS5] &&
+	       (sqlite3_libversion_number() >= 3043000);
+}
+
+/**
+ * Returns the table options (from the YapDatabaseFullTextSearchOptions) to append to the CREATE VIRTUAL TABLE,
+ * e.g. "prefix='2 3', detail=column"
+**/
+- (NSString *)tableOptions
+{
+	YapDatabaseFullTextSearchOptions *options = parentConnection->parent->extensionOptions;
+	
+	BOOL isFTS5 = [self isFTS5];
+	BOOL isFTS4 = [parentConnection->parent->ftsVersion isEqualToString:YapDatabaseFullTextSearchFTS4Version];
+	
+	NSMutableArray<NSString *> *tableOptions = [NSMutableArray arrayWithCapacity:3];
+	
+	if ([options.prefixIndexes count] > 0)
+	{
+		if (isFTS5 || isFTS4)
+		{
+			NSMutableArray<NSString *> *lengths = [NSMutableArray arrayWithCapacity:[options.prefixIndexes count]];
+			for (NSNumber *length in options.prefixIndexes)
+			{
+				[lengths addObject:[NSString stringWithFormat:@"%lu", (unsigned long)[length unsignedIntegerValue]]];
+			}
+			
+			// FTS5 : prefix='2 3'
+			// FTS4 : prefix="2,3"
+			
+			if (isFTS5)
+				[tableOptions addObject:[NSString stringWithFormat:@"prefix='%@'", [lengths componentsJoinedByString:@" "]]];
+			else
+				[tableOptions addObject:[NSString stringWithFormat:@"prefix=\"%@\"", [lengths componentsJoinedByString:@","]]];
+		}
+		else
+		{
+			YDBLogWarn(@"%@ (%@): prefixIndexes require FTS4 or FTS5", THIS_METHOD, [self registeredName]);
+		}
+	}
+	
+	if (isFTS5)
+	{
+		if (options.detail == YapDatabaseFullTextSearchDetailColumn)
+			[tableOptions addObject:@"detail=column"];
+		else if (options.detail == YapDatabaseFullTextSearchDetailNone)
+			[tableOptions addObject:@"detail=none"];
+		
+		if (!options.storesColumnSizes)
+			[tableOptions addObject:@"columnsize=0"];
+	}
+	else if ((options.detail != YapDatabaseFullTextSearchDetailFull) || !options.storesColumnSizes)
+	{
+		YDBLogWarn(@"%@ (%@): detail & storesColumnSizes require FTS5", THIS_METHOD, [self registeredName]);
+	}
+	
+	if (options.tokenizer)
+	{
+		if (isFTS5)
+			[tableOptions addObject:[options.tokenizer tableOption]];
+		else
+			YDBLogWarn(@"%@ (%@): tokenizer requires FTS5", THIS_METHOD, [self registeredName]);
+	}
+	
+	if ([self isContentless])
+	{
+		[tableOptions addObject:@"content=''"];
+		[tableOptions addObject:@"contentless_delete=1"];
+	}
+	else if (options.contentless)
+	{
+		YDBLogWarn(@"%@ (%@): contentless requires FTS5 & sqlite 3.43 (or later)", THIS_METHOD, [self registeredName]);
+	}
+	
+	return [tableOptions componentsJoinedByString:@", "];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Logic
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Binds the given rowid, along with the values in the 'blockDict' ivar, to the given statement.
+ * The rowid is bound to the first parameter, followed by one parameter per column.
+**/
+- (void)bindRowid:(int64_t)rowid toStatement:(sqlite3_stmt *)statement
+{
+	sqlite3_bind_int64(statement, SQLITE_BIND_START, rowid);
+	
+	int i = SQLITE_BIND_START + 1;
+	for (NSString *columnName in parentConnection->parent->columnNames)
+	{
+		NSString *columnValue = [parentConnection->blockDict objectForKey:columnName];
+		if (columnValue)
+		{
+			sqlite3_bind_text(statement, i, [columnValue UTF8String], -1, SQLITE_TRANSIENT);
+		}
+		
+		i++;
+	}
+}
+
+/**
+ * Returns YES if the table already contains a row for the given rowid,
+ * and every column of that row matches the values in the 'blockDict' ivar.
+**/
+- (BOOL)isUnchangedRowid:(int64_t)rowid
+{
+	// A contentless table doesn't store the values to compare against
+	
+	if ([self isContentless])
+		return NO;
+	
+	sqlite3_stmt *statement = [parentConnection compareRowidStatement];
+	if (statement == NULL)
+		return NO;
+	
+	// SELECT ("column1" IS ?2) AND ("column2" IS ?3) ... FROM "tableName" WHERE "rowid" = ?1;
+	
+	[self bindRowid:rowid toStatement:statement];
+	
+	BOOL isUnchanged = NO;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		isUnchanged = (sqlite3_column_int(statement, SQLITE_COLUMN_START) != 0);
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'compareRowidStatement': %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return isUnchanged;
+}
+
+/**
+ * Adds a row to the table, using the given rowid along with the values in the 'blockDict' ivar.
+ * When updating an existing row, the write (and thus the re-tokenizing) is skipped if none of the values changed.
+**/
 - (void)addRowid:(int64_t)rowid isNew:(BOOL)isNew
 {
 	YDBLogAutoTrace();
 	
+	if (!isNew && [self isUnchangedRowid:rowid])
+	{
+		return;
+	}
+	
 	sqlite3_stmt *statement = NULL;
 	if (isNew)
 		statement = [parentConnection insertRowidStatement];
@@ -380,19 +755,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 	//  isNew : INSERT INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...)
 	// !isNew : INSERT OR REPLACE INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...)
 	
-	sqlite3_bind_int64(statement, SQLITE_BIND_START, rowid);
-	
-	int i = SQLITE_BIND_START + 1;
-	for (NSString *columnName in parentConnection->parent->columnNames)
-	{
-		NSString *columnValue = [parentConnection->blockDict objectForKey:columnName];
-		if (columnValue)
-		{
-			sqlite3_bind_text(statement, i, [columnValue UTF8String], -1, SQLITE_TRANSIENT);
-		}
-		
-		i++;
-	}
+	[self bindRowid:rowid toStatement:statement];
 	
 	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
@@ -406,6 +769,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 	sqlite3_reset(statement);
 	
 	[parentConnection->mutationStack markAsMutated];
+	parentConnection->didModifyIndex = YES;
 }
 
 - (void)removeRowid:(int64_t)rowid
@@ -431,7 +795,13 @@ static NSString *const ext_key__version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
+	if ([self isDeferred])
+	{
+		[self dequeueRowid:rowid];
+	}
+	
 	[parentConnection->mutationStack markAsMutated];
+	parentConnection->didModifyIndex = YES;
 }
 
 - (void)removeRowids:(NSArray *)rowids
@@ -496,39 +866,620 @@ static NSString *const ext_key__version_deprecated = @"version";
 	
 	sqlite3_finalize(statement);
 	
+	if ([self isDeferred])
+	{
+		for (NSNumber *rowidNumber in rowids)
+		{
+			[self dequeueRowid:[rowidNumber longLongValue]];
+		}
+	}
+	
 	[parentConnection->mutationStack markAsMutated];
+	parentConnection->didModifyIndex = YES;
 }
 
-- (void)removeAllRowids
+- (void)removeRowidsInCollection:(NSString *)collection
 {
 	YDBLogAutoTrace();
 	
-	sqlite3_stmt *statement = [parentConnection removeAllStatement];
-	if (statement == NULL)
-		return;
-	
-	int status;
-	
-	// DELETE FROM "tableName";
-	
-	YDBLogVerbose(@"DELETE FROM '%@';", [self tableName]);
+	[self removeRowidsInCollection:collection fromTable:[self tableName]];
 	
-	status = sqlite3_step(statement);
-	if (status != SQLITE_DONE)
+	if ([self isDeferred])
 	{
-		YDBLogError(@"%@ (%@): Error in removeAllStatement: %d %s",
-		            THIS_METHOD, [self registeredName],
-		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		[self removeRowidsInCollection:collection fromTable:[parentConnection->parent pendingTableName]];
 	}
 	
-	sqlite3_reset(statement);
-	
 	[parentConnection->mutationStack markAsMutated];
+	parentConnection->didModifyIndex = YES;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Cleanup & Commit
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+- (void)removeRowidsInCollection:(NSString *)collection fromTable:(NSString *)tableName
+{
+	// DELETE FROM "tableName" WHERE "rowid" IN (SELECT "rowid" FROM "database2" WHERE "collection" = ?);
+	
+	NSString *query = [NSString stringWithFormat:
+	  @"DELETE FROM \"%@\" WHERE \"rowid\" IN (SELECT \"rowid\" FROM \"database2\" WHERE \"collection\" = ?);",
+	  tableName];
+	
+	sqlite3_stmt *statement;
+	
+	int status = sqlite3_prepare_v2(databaseTransaction->connection->db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating 'removeRowidsInCollection' statement: %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		return;
+	}
+	
+	int const bind_idx_collection = SQLITE_BIND_START;
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'removeRowidsInCollection' statement: %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
+}
+
+- (void)removeAllRowids
+{
+	YDBLogAutoTrace();
+	
+	sqlite3_stmt *statement = [parentConnection removeAllStatement];
+	if (statement == NULL)
+		return;
+	
+	int status;
+	
+	// DELETE FROM "tableName";
+	
+	YDBLogVerbose(@"DELETE FROM '%@';", [self tableName]);
+	
+	status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ (%@): Error in removeAllStatement: %d %s",
+		            THIS_METHOD, [self registeredName],
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_reset(statement);
+	
+	if ([self isDeferred])
+	{
+		sqlite3_stmt *dequeueAllStatement = [parentConnection dequeueAllStatement];
+		if (dequeueAllStatement)
+		{
+			// DELETE FROM "pendingTableName";
+			
+			status = sqlite3_step(dequeueAllStatement);
+			if (status != SQLITE_DONE)
+			{
+				YDBLogError(@"%@ (%@): Error in dequeueAllStatement: %d %s",
+				            THIS_METHOD, [self registeredName],
+				            status, sqlite3_errmsg(databaseTransaction->connection->db));
+			}
+			
+			sqlite3_reset(dequeueAllStatement);
+		}
+	}
+	
+	[parentConnection->mutationStack markAsMutated];
+	parentConnection->didModifyIndex = YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Deferred Indexing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Adds the rowid to the queue of rows waiting to be indexed (if it's not already queued).
+**/
+- (void)queueRowid:(int64_t)rowid
+{
+	sqlite3_stmt *statement = [parentConnection queueRowidStatement];
+	if (statement == NULL) return;
+	
+	// INSERT OR IGNORE INTO "pendingTableName" ("rowid") VALUES (?);
+	
+	sqlite3_bind_int64(statement, SQLITE_BIND_START, rowid);
+	
+	int status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'queueRowidStatement': %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	parentConnection->didQueueRowids = YES;
+}
+
+/**
+ * Queues every row in the database (used to populate the extension).
+**/
+- (BOOL)queueAllRowids
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *query = [NSString stringWithFormat:
+	  @"INSERT OR IGNORE INTO \"%@\" (\"rowid\") SELECT \"rowid\" FROM \"database2\";",
+	  [parentConnection->parent pendingTableName]];
+	
+	int status = sqlite3_exec(db, [query UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed queueing rows (%@): %d %s",
+		            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	parentConnection->didQueueRowids = YES;
+	return YES;
+}
+
+/**
+ * Removes the rowid from the queue, and returns whether or not it was queued.
+**/
+- (BOOL)dequeueRowid:(int64_t)rowid
+{
+	sqlite3_stmt *statement = [parentConnection dequeueRowidStatement];
+	if (statement == NULL) return NO;
+	
+	// DELETE FROM "pendingTableName" WHERE "rowid" = ?;
+	
+	sqlite3_bind_int64(statement, SQLITE_BIND_START, rowid);
+	
+	BOOL wasQueued = NO;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_DONE)
+	{
+		wasQueued = (sqlite3_changes(databaseTransaction->connection->db) > 0);
+	}
+	else
+	{
+		YDBLogError(@"Error executing 'dequeueRowidStatement': %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return wasQueued;
+}
+
+/**
+ * Indexes the (previously queued) row, using its current object & metadata.
+**/
+- (void)indexQueuedRowid:(int64_t)rowid
+{
+	[self invokeBlockForRowid:rowid];
+	
+	if ([parentConnection->blockDict count] > 0)
+	{
+		[self addRowid:rowid isNew:NO];
+		[parentConnection->blockDict removeAllObjects];
+	}
+	else
+	{
+		// The row may have been indexed before it was modified (& queued)
+		
+		[self removeRowid:rowid];
+	}
+	
+	parentConnection->didIndexQueuedRowids = YES;
+}
+
+/**
+ * Fetches the row (as needed by the handler), and invokes the block, which fills the 'blockDict' ivar.
+ * Returns NO if the row doesn't exist.
+**/
+- (BOOL)invokeBlockForRowid:(int64_t)rowid
+{
+	__unsafe_unretained YapDatabaseFullTextSearchHandler *handler = parentConnection->parent->handler;
+	
+	YapCollectionKey *collectionKey = nil;
+	id object = nil;
+	id metadata = nil;
+	
+	BOOL found = NO;
+	if (handler->blockType == YapDatabaseBlockTypeWithKey)
+	{
+		collectionKey = [databaseTransaction collectionKeyForRowid:rowid];
+		found = (collectionKey != nil);
+	}
+	else if (handler->blockType == YapDatabaseBlockTypeWithObject)
+	{
+		found = [databaseTransaction getCollectionKey:&collectionKey object:&object forRowid:rowid];
+	}
+	else if (handler->blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		found = [databaseTransaction getCollectionKey:&collectionKey metadata:&metadata forRowid:rowid];
+	}
+	else
+	{
+		found = [databaseTransaction getCollectionKey:&collectionKey object:&object metadata:&metadata forRowid:rowid];
+	}
+	
+	if (found)
+	{
+		[self invokeBlockWithCollectionKey:collectionKey object:object metadata:metadata];
+	}
+	
+	return found;
+}
+
+/**
+ * Indexes (at most) limit queued rows, in rowid order. A limit of zero indexes every queued row.
+ * Returns YES if the queue is empty afterwards.
+**/
+- (BOOL)indexQueuedRowidsWithLimit:(NSUInteger)limit
+{
+	sqlite3_stmt *statement = [parentConnection queuedRowidsStatement];
+	if (statement == NULL) return YES;
+	
+	// SELECT "rowid" FROM "pendingTableName" ORDER BY "rowid" ASC LIMIT ?;
+	
+	sqlite3_bind_int64(statement, SQLITE_BIND_START, (limit > 0) ? (int64_t)limit : -1);
+	
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray array];
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		[rowids addObject:@(sqlite3_column_int64(statement, SQLITE_COLUMN_START))];
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	for (NSNumber *rowidNumber in rowids)
+	{
+		int64_t rowid = [rowidNumber longLongValue];
+		
+		[self dequeueRowid:rowid];
+		[self indexQueuedRowid:rowid];
+	}
+	
+	return (limit == 0) || ([rowids count] < limit);
+}
+
+/**
+ * Invoked before a query, so a readWriteTransaction sees its own changes (see flushesBeforeQueries).
+**/
+- (void)flushQueuedRowidsIfNeeded
+{
+	if (!databaseTransaction->isReadWriteTransaction) return;
+	
+	YapDatabaseFullTextSearchOptions *options = parentConnection->parent->extensionOptions;
+	if (options.deferredIndexing && options.flushesBeforeQueries)
+	{
+		[self indexQueuedRowidsWithLimit:0];
+	}
+}
+
+/**
+ * Invoked before a single row query, which only needs that particular row to be indexed.
+**/
+- (void)flushQueuedRowidIfNeeded:(int64_t)rowid
+{
+	if (!databaseTransaction->isReadWriteTransaction) return;
+	
+	YapDatabaseFullTextSearchOptions *options = parentConnection->parent->extensionOptions;
+	if (options.deferredIndexing && options.flushesBeforeQueries)
+	{
+		if ([self dequeueRowid:rowid])
+		{
+			[self indexQueuedRowid:rowid];
+		}
+	}
+}
+
+/**
+ * YapDatabaseExtensionTransaction subclass hook.
+ *
+ * Indexes the next batch of queued rows (see YapDatabaseFullTextSearchOptions.deferredIndexing).
+**/
+- (BOOL)populateNextChunk
+{
+	__unsafe_unretained YapDatabaseFullTextSearch *parent = parentConnection->parent;
+	
+	BOOL isComplete = YES;
+	
+	if ([self isDeferred])
+	{
+		NSUInteger batchSize = MAX(parent->extensionOptions.deferredIndexingBatchSize, (NSUInteger)1);
+		
+		isComplete = [self indexQueuedRowidsWithLimit:batchSize];
+	}
+	
+	if (isComplete && atomic_load(&parent->mergeNeeded))
+	{
+		// The queue is drained (or not used), so merge the segments (see mergeSegmentThreshold).
+		
+		if ([self mergeNextSegments])
+			atomic_store(&parent->mergeNeeded, false);
+		else
+			isComplete = NO;
+	}
+	
+	if (isComplete)
+	{
+		// Any rows queued (or merges requested) after this transaction
+		// will schedule the background work again (see postCommitCleanup).
+		
+		atomic_store(&parent->backgroundWorkScheduled, false);
+	}
+	
+	return isComplete;
+}
+
+- (NSUInteger)numberOfPendingRows
+{
+	if (![self isDeferred]) return 0;
+	
+	sqlite3_stmt *statement = [parentConnection queueCountStatement];
+	if (statement == NULL) return 0;
+	
+	// SELECT COUNT(*) AS NumberOfRows FROM "pendingTableName";
+	
+	NSUInteger count = 0;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		count = (NSUInteger)sqlite3_column_int64(statement, SQLITE_COLUMN_START);
+	}
+	else
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_reset(statement);
+	
+	return count;
+}
+
+- (void)flushPendingRows
+{
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
+		return;
+	}
+	
+	if ([self isDeferred])
+	{
+		[self indexQueuedRowidsWithLimit:0];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Merging
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Executes an FTS special command (e.g. 'merge', 'automerge', 'optimize'), with an optional value.
+ *
+ * FTS5 : INSERT INTO "tableName"("tableName", "rank") VALUES('command', value);
+ * FTS4 : INSERT INTO "tableName"("tableName") VALUES('command=value');
+ *
+ * If changesPtr is non-NULL, it's set to the number of changes made by the command.
+ * For a merge, sqlite uses this to indicate whether or not there's any work left (fewer than 2 changes means none).
+**/
+- (BOOL)executeCommand:(NSString *)command value:(NSString *)value changes:(int *)changesPtr
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *tableName = [self tableName];
+	NSString *sql = nil;
+	
+	if (value == nil)
+		sql = [NSString stringWithFormat:@"INSERT INTO \"%@\"(\"%@\") VALUES('%@');", tableName, tableName, command];
+	else if ([self isFTS5])
+		sql = [NSString stringWithFormat:@"INSERT INTO \"%@\"(\"%@\", \"rank\") VALUES('%@', %@);",
+		                                 tableName, tableName, command, value];
+	else
+		sql = [NSString stringWithFormat:@"INSERT INTO \"%@\"(\"%@\") VALUES('%@=%@');",
+		                                 tableName, tableName, command, value];
+	
+	int totalChanges = sqlite3_total_changes(db);
+	
+	int status = sqlite3_exec(db, [sql UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ (%@): Error executing '%@': %d %s",
+		            THIS_METHOD, [self registeredName], sql, status, sqlite3_errmsg(db));
+		
+		if (changesPtr) *changesPtr = 0;
+		return NO;
+	}
+	
+	if (changesPtr) *changesPtr = sqlite3_total_changes(db) - totalChanges;
+	return YES;
+}
+
+/**
+ * Applies the automerge & crisismerge options (which are persisted by sqlite in the FTS table).
+**/
+- (void)updateMergeSettings
+{
+	YapDatabaseFullTextSearchOptions *options = parentConnection->parent->extensionOptions;
+	
+	if (options.automerge >= 0)
+	{
+		[self executeCommand:@"automerge"
+		               value:[NSString stringWithFormat:@"%ld", (long)options.automerge]
+		             changes:NULL];
+	}
+	
+	if (options.crisismerge >= 0)
+	{
+		if ([self isFTS5])
+		{
+			[self executeCommand:@"crisismerge"
+			               value:[NSString stringWithFormat:@"%ld", (long)options.crisismerge]
+			             changes:NULL];
+		}
+		else
+		{
+			YDBLogWarn(@"%@ (%@): crisismerge requires FTS5", THIS_METHOD, [self registeredName]);
+		}
+	}
+}
+
+/**
+ * Merges (at most) mergeBatchSize pages worth of segments.
+ * Returns YES if there's no merge work left, or if the number of segments dropped to the mergeSegmentThreshold.
+**/
+- (BOOL)mergeNextSegments
+{
+	YapDatabaseFullTextSearchOptions *options = parentConnection->parent->extensionOptions;
+	
+	unsigned long batchSize = (unsigned long)MAX(options.mergeBatchSize, (NSUInteger)1);
+	
+	// FTS5 : 'merge', N
+	// FTS4 : 'merge=N,2' (merge any level with at least 2 segments)
+	
+	NSString *value = nil;
+	if ([self isFTS5])
+		value = [NSString stringWithFormat:@"%lu", batchSize];
+	else
+		value = [NSString stringWithFormat:@"%lu,2", batchSize];
+	
+	int changes = 0;
+	if (![self executeCommand:@"merge" value:value changes:&changes])
+	{
+		return YES;
+	}
+	
+	parentConnection->didMergeSegments = YES;
+	
+	if (changes < 2)
+	{
+		return YES;
+	}
+	
+	return ([self numberOfSegments] <= options.mergeSegmentThreshold);
+}
+
+/**
+ * Invoked (at the end of every readWriteTransaction that modified the index)
+ * to find out if the segments need to be merged (see mergeSegmentThreshold).
+**/
+- (void)checkSegmentsIfNeeded
+{
+	__unsafe_unretained YapDatabaseFullTextSearch *parent = parentConnection->parent;
+	
+	NSUInteger threshold = parent->extensionOptions.mergeSegmentThreshold;
+	if (threshold == 0) return;
+	
+	if (!parentConnection->didModifyIndex) return;
+	
+	if (atomic_load(&parent->mergeNeeded))
+	{
+		// Already requested (postCommitCleanup ignores this if the merge is in progress)
+		
+		parentConnection->didRequestMerge = YES;
+		return;
+	}
+	
+	// Every write transaction adds (at most) a segment,
+	// so checking every (threshold / 8) transactions bounds the overshoot to 1/8 of the threshold.
+	
+	unsigned int interval = (unsigned int)MAX(threshold / 8, (NSUInteger)1);
+	
+	if ((atomic_fetch_add(&parent->writesSinceMergeCheck, 1) + 1) < interval) return;
+	atomic_store(&parent->writesSinceMergeCheck, 0);
+	
+	if ([self numberOfSegments] > threshold)
+	{
+		atomic_store(&parent->mergeNeeded, true);
+		parentConnection->didRequestMerge = YES;
+	}
+}
+
+- (NSUInteger)numberOfSegments
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	// FTS5 : SELECT COUNT(DISTINCT "segid") FROM "tableName_idx";
+	// FTS4 : SELECT COUNT(*) FROM "tableName_segdir";
+	
+	NSString *query = nil;
+	if ([self isFTS5])
+		query = [NSString stringWithFormat:@"SELECT COUNT(DISTINCT \"segid\") FROM \"%@_idx\";", [self tableName]];
+	else
+		query = [NSString stringWithFormat:@"SELECT COUNT(*) FROM \"%@_segdir\";", [self tableName]];
+	
+	sqlite3_stmt *statement;
+	int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ (%@): Error creating statement: %d %s",
+		            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+		return 0;
+	}
+	
+	NSUInteger count = 0;
+	
+	status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		count = (NSUInteger)sqlite3_column_int64(statement, SQLITE_COLUMN_START);
+	}
+	else
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_finalize(statement);
+	
+	return count;
+}
+
+- (void)optimize
+{
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
+		return;
+	}
+	
+	if ([self executeCommand:@"optimize" value:nil changes:NULL])
+	{
+		parentConnection->didMergeSegments = YES;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Cleanup & Commit
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * YapDatabaseExtensionTransaction subclass hook.
+ * Invoked right before the readWriteTransaction commits.
+**/
+- (void)flushPendingChangesToExtensionTables
+{
+	[self checkSegmentsIfNeeded];
+}
 
 /**
  * Required override method from YapDatabaseExtension
@@ -571,21 +1522,13 @@ static NSString *const ext_key__version_deprecated = @"version";
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Private helper method for other handleXXX hook methods.
+ * Invokes the block (of the handler), which fills the 'blockDict' ivar with the values to index.
 **/
-- (void)_handleChangeWithRowid:(int64_t)rowid
-                 collectionKey:(YapCollectionKey *)collectionKey
-                        object:(id)object
-                      metadata:(id)metadata
-                      isInsert:(BOOL)isInsert
+- (void)invokeBlockWithCollectionKey:(YapCollectionKey *)collectionKey object:(id)object metadata:(id)metadata
 {
-	YDBLogAutoTrace();
-	
 	__unsafe_unretained NSString *collection = collectionKey.collection;
 	__unsafe_unretained NSString *key = collectionKey.key;
 	
-	// Invoke the block to find out if the object should be included in the index.
-	
 	__unsafe_unretained YapDatabaseFullTextSearchHandler *handler = parentConnection->parent->handler;
 	
 	if (handler->blockType == YapDatabaseBlockTypeWithKey)
@@ -611,12 +1554,36 @@ static NSString *const ext_key__version_deprecated = @"version";
 	}
 	else
 	{
-		__unsafe_unretained YapDatabaseFullTextSearchWithRowBlock block =
-		    (YapDatabaseFullTextSearchWithRowBlock)handler->block;
+		__unsafe_unretained YapDatabaseFullTextSearchWithRowBlock block =
+		    (YapDatabaseFullTextSearchWithRowBlock)handler->block;
+		
+		block(databaseTransaction, parentConnection->blockDict, collection, key, object, metadata);
+	}
+}
+
+/**
+ * Private helper method for other handleXXX hook methods.
+**/
+- (void)_handleChangeWithRowid:(int64_t)rowid
+                 collectionKey:(YapCollectionKey *)collectionKey
+                        object:(id)object
+                      metadata:(id)metadata
+                      isInsert:(BOOL)isInsert
+{
+	YDBLogAutoTrace();
+	
+	if ([self isDeferred])
+	{
+		// The block is invoked once the row is indexed (in the background)
 		
-		block(databaseTransaction, parentConnection->blockDict, collection, key, object, metadata);
+		[self queueRowid:rowid];
+		return;
 	}
 	
+	// Invoke the block to find out if the object should be included in the index.
+	
+	[self invokeBlockWithCollectionKey:collectionKey object:object metadata:metadata];
+	
 	if ([parentConnection->blockDict count] == 0)
 	{
 		// This was an insert operation, so we don't have to worry about removing anything.
@@ -879,6 +1846,18 @@ static NSString *const ext_key__version_deprecated = @"version";
 	[self removeAllRowids];
 }
 
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (BOOL)handleRemoveAllObjectsInCollection:(NSString *)collection
+{
+	YDBLogAutoTrace();
+	
+	[self removeRowidsInCollection:collection];
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Queries
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -889,9 +1868,11 @@ static NSString *const ext_key__version_deprecated = @"version";
 	if (block == nil) return;
 	if ([query length] == 0) return;
 	
+	[self flushQueuedRowidsIfNeeded];
+	
 	sqlite3_stmt *statement = [parentConnection queryStatement];
 	if (statement == NULL) return;
-
+	
 	BOOL stop = NO;
 	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
 	
@@ -903,8 +1884,11 @@ static NSString *const ext_key__version_deprecated = @"version";
 	YapDatabaseString _query; MakeYapDatabaseString(&_query, query);
 	sqlite3_bind_text(statement, bind_idx_query, _query.str, _query.length, SQLITE_STATIC);
 	
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+	
 	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
 	{
 		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
@@ -913,7 +1897,10 @@ static NSString *const ext_key__version_deprecated = @"version";
 		if (stop || mutation.isMutated) break;
 	}
 	
-	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	// Note: SQLITE_INTERRUPT isn't an error.
+	// It means the query was interrupted by a progress handler (e.g. an aborted YapDatabaseSearchQueue search).
+	
+	if ((status != SQLITE_DONE) && (status != SQLITE_INTERRUPT) && !stop && !mutation.isMutated)
 	{
 		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
 		            status, sqlite3_errmsg(databaseTransaction->connection->db));
@@ -921,6 +1908,10 @@ static NSString *const ext_key__version_deprecated = @"version";
 	
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
+	
+	if (YapDatabaseQueryProfileIsSlow(&profile)) {
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, @[ query ], [self registeredName]);
+	}
 	FreeYapDatabaseString(&_query);
 	
 	if (!stop && mutation.isMutated)
@@ -980,6 +1971,183 @@ static NSString *const ext_key__version_deprecated = @"version";
 	}];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Scoped Queries
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Collects the rowids of the scope into the (temporary) scope table.
+**/
+- (BOOL)prepareScopeTable:(YapDatabaseFullTextSearchScope *)scope
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	sqlite3_stmt *removeAllStatement = [parentConnection scopeTableRemoveAllStatement];
+	sqlite3_stmt *insertStatement = [parentConnection scopeTableInsertStatement];
+	
+	if (!removeAllStatement || !insertStatement) return NO;
+	
+	// DELETE FROM temp."scopeTableName";
+	
+	int status = sqlite3_step(removeAllStatement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'scopeTableRemoveAllStatement': %d %s", status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_reset(removeAllStatement);
+	
+	// INSERT OR IGNORE INTO temp."scopeTableName" ("rowid") VALUES (?);
+	
+	__block BOOL failed = NO;
+	BOOL found = [scope enumerateRowidsWithTransaction:databaseTransaction usingBlock:^(int64_t rowid, BOOL *stop) {
+		
+		sqlite3_bind_int64(insertStatement, SQLITE_BIND_START, rowid);
+		
+		int status = sqlite3_step(insertStatement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'scopeTableInsertStatement': %d %s", status, sqlite3_errmsg(db));
+			
+			failed = YES;
+			*stop = YES;
+		}
+		
+		sqlite3_clear_bindings(insertStatement);
+		sqlite3_reset(insertStatement);
+	}];
+	
+	if (!found)
+	{
+		YDBLogWarn(@"%@ (%@): The extension of the scope (%@) isn't a registered view or secondary index",
+		           THIS_METHOD, [self registeredName], scope->extensionName);
+	}
+	
+	return (found && !failed);
+}
+
+- (void)enumerateRowidsMatching:(NSString *)query
+                        inScope:(YapDatabaseFullTextSearchScope *)scope
+                     usingBlock:(void (^)(int64_t rowid, BOOL *stop))block
+{
+	if (block == nil) return;
+	if ([query length] == 0) return;
+	
+	if (scope == nil)
+	{
+		[self enumerateRowidsMatching:query usingBlock:block];
+		return;
+	}
+	
+	[self flushQueuedRowidsIfNeeded];
+	
+	if (![self prepareScopeTable:scope]) return;
+	
+	sqlite3_stmt *statement = [parentConnection scopedQueryStatement];
+	if (statement == NULL) return;
+	
+	BOOL stop = NO;
+	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
+	
+	// SELECT "rowid" FROM "tableName" WHERE "tableName" MATCH ? AND "rowid" IN (SELECT "rowid" FROM temp."scope");
+	
+	int const column_idx_rowid = SQLITE_COLUMN_START;
+	int const bind_idx_query   = SQLITE_BIND_START;
+	
+	YapDatabaseString _query; MakeYapDatabaseString(&_query, query);
+	sqlite3_bind_text(statement, bind_idx_query, _query.str, _query.length, SQLITE_STATIC);
+	
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+	
+	int status;
+	while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		block(rowid, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	if (YapDatabaseQueryProfileIsSlow(&profile))
+	{
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, @[ query ], [self registeredName]);
+	}
+	
+	FreeYapDatabaseString(&_query);
+	
+	// Don't keep the scope around (it may be large)
+	
+	sqlite3_stmt *removeAllStatement = [parentConnection scopeTableRemoveAllStatement];
+	if (removeAllStatement)
+	{
+		sqlite3_step(removeAllStatement);
+		sqlite3_reset(removeAllStatement);
+	}
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [databaseTransaction mutationDuringEnumerationException];
+	}
+}
+
+- (void)enumerateKeysMatching:(NSString *)query
+                      inScope:(YapDatabaseFullTextSearchScope *)scope
+                   usingBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	[self enumerateRowidsMatching:query inScope:scope usingBlock:^(int64_t rowid, BOOL *stop) {
+		
+		YapCollectionKey *ck = [self->databaseTransaction collectionKeyForRowid:rowid];
+		
+		block(ck.collection, ck.key, stop);
+	}];
+}
+
+- (void)enumerateKeysAndObjectsMatching:(NSString *)query
+                                inScope:(YapDatabaseFullTextSearchScope *)scope
+                             usingBlock:(void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	[self enumerateRowidsMatching:query inScope:scope usingBlock:^(int64_t rowid, BOOL *stop) {
+		
+		YapCollectionKey *ck = nil;
+		id object = nil;
+		[self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
+		
+		block(ck.collection, ck.key, object, stop);
+	}];
+}
+
+- (void)enumerateRowsMatching:(NSString *)query
+                      inScope:(YapDatabaseFullTextSearchScope *)scope
+                   usingBlock:(void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	[self enumerateRowidsMatching:query inScope:scope usingBlock:^(int64_t rowid, BOOL *stop) {
+		
+		YapCollectionKey *ck = nil;
+		id object = nil;
+		id metadata = nil;
+		[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
+		
+		block(ck.collection, ck.key, object, metadata, stop);
+	}];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark bm25  Queries
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1002,6 +2170,8 @@ static NSString *const ext_key__version_deprecated = @"version";
     if (block == nil) return;
     if ([query length] == 0) return;
     
+    [self flushQueuedRowidsIfNeeded];
+    
     sqlite3_stmt *statement = [parentConnection bm25QueryStatementWithWeights:weights];
     if (statement == NULL) return;
     
@@ -1016,8 +2186,11 @@ static NSString *const ext_key__version_deprecated = @"version";
     YapDatabaseString _query; MakeYapDatabaseString(&_query, query);
     sqlite3_bind_text(statement, bind_idx_query, _query.str, _query.length, SQLITE_STATIC);
     
+    YapDatabaseQueryProfile profile;
+    YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+    
     int status;
-    while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+    while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
     {
         int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
         
@@ -1034,8 +2207,16 @@ static NSString *const ext_key__version_deprecated = @"version";
     
     sqlite3_clear_bindings(statement);
     sqlite3_reset(statement);
+    
+    if (YapDatabaseQueryProfileIsSlow(&profile)) {
+        YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, @[ query ], [self registeredName]);
+    }
     FreeYapDatabaseString(&_query);
     
+    if (weights.count > 0) {
+        sqlite3_finalize(statement); // not cached (see bm25QueryStatementWithWeights:)
+    }
+    
     if (!stop && mutation.isMutated)
     {
         @throw [databaseTransaction mutationDuringEnumerationException];
@@ -1066,31 +2247,227 @@ static NSString *const ext_key__version_deprecated = @"version";
     }];
 }
 
-- (void)enumerateBm25OrderedKeysAndObjectsMatching:(NSString *)query
-                                       withWeights:(nullable NSArray<NSNumber *> *)weights
-                                        usingBlock:(void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block {
-    [self enumerateBm25OrderedRowidsMatching:query withWeights:weights usingBlock:^(int64_t rowid, BOOL *stop) {
-        
-        YapCollectionKey *ck = nil;
-        id object = nil;
-        [self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
-        
-        block(ck.collection, ck.key, object, stop);
-    }];
+- (void)enumerateBm25OrderedKeysAndObjectsMatching:(NSString *)query
+                                       withWeights:(nullable NSArray<NSNumber *> *)weights
+                                        usingBlock:(void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block {
+    [self enumerateBm25OrderedRowidsMatching:query withWeights:weights usingBlock:^(int64_t rowid, BOOL *stop) {
+        
+        YapCollectionKey *ck = nil;
+        id object = nil;
+        [self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
+        
+        block(ck.collection, ck.key, object, stop);
+    }];
+}
+
+- (void)enumerateBm25OrderedRowsMatching:(NSString *)query
+                             withWeights:(nullable NSArray<NSNumber *> *)weights
+                              usingBlock:(void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block {
+    [self enumerateBm25OrderedRowidsMatching:query withWeights:weights usingBlock:^(int64_t rowid, BOOL *stop) {
+        
+        YapCollectionKey *ck = nil;
+        id object = nil;
+        id metadata = nil;
+        [self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
+        
+        block(ck.collection, ck.key, object, metadata, stop);
+    }];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark bm25 Top-K Queries
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)enumerateBm25OrderedRowidsMatching:(NSString *)query
+                               withWeights:(NSArray<NSNumber *> *)weights
+                                     limit:(NSUInteger)limit
+                                    offset:(NSUInteger)offset
+                                usingBlock:(void (^)(int64_t rowid, BOOL *stop))block
+{
+	if (![parentConnection->parent.ftsVersion isEqualToString:YapDatabaseFullTextSearchFTS5Version])
+	{
+		NSString *reason = [NSString stringWithFormat:
+		  @"bm25 ordering used on non fts5 extension %@", parentConnection->parent.registeredName];
+		
+		NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
+		  @"You may want to initialize that extension with YapDatabaseFullTextSearchFTS5Version" };
+		
+		@throw [NSException exceptionWithName:@"YapDatabaseFullTextSearch" reason:reason userInfo:userInfo];
+	}
+	
+	if (block == nil) return;
+	if ([query length] == 0) return;
+	
+	[self flushQueuedRowidsIfNeeded];
+	
+	sqlite3_stmt *statement = [parentConnection bm25TopQueryStatement];
+	if (statement == NULL) return;
+	
+	// SELECT "rowid" FROM "tableName" WHERE "tableName" MATCH ? AND "rank" MATCH ? ORDER BY "rank" LIMIT ? OFFSET ?;
+	
+	int const column_idx_rowid = SQLITE_COLUMN_START;
+	
+	int const bind_idx_query   = SQLITE_BIND_START + 0;
+	int const bind_idx_rank    = SQLITE_BIND_START + 1;
+	int const bind_idx_limit   = SQLITE_BIND_START + 2;
+	int const bind_idx_offset  = SQLITE_BIND_START + 3;
+	
+	NSString *rank = [NSString stringWithFormat:@"bm25(%@)", ([weights componentsJoinedByString:@", "] ?: @"")];
+	
+	YapDatabaseString _query; MakeYapDatabaseString(&_query, query);
+	sqlite3_bind_text(statement, bind_idx_query, _query.str, _query.length, SQLITE_STATIC);
+	
+	YapDatabaseString _rank; MakeYapDatabaseString(&_rank, rank);
+	sqlite3_bind_text(statement, bind_idx_rank, _rank.str, _rank.length, SQLITE_STATIC);
+	
+	sqlite3_bind_int64(statement, bind_idx_limit, (limit > 0) ? (int64_t)limit : -1);
+	sqlite3_bind_int64(statement, bind_idx_offset, (int64_t)offset);
+	
+	// The result set is small (at most limit rows), so we collect the rowids first.
+	// This way the block may execute other queries (e.g. snippets) without keeping this statement open.
+	
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray arrayWithCapacity:(limit > 0 ? MIN(limit, 1000) : 100)];
+	
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+	
+	int status;
+	while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
+	{
+		[rowids addObject:@(sqlite3_column_int64(statement, column_idx_rowid))];
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	if (YapDatabaseQueryProfileIsSlow(&profile))
+	{
+		NSArray *params = @[ query, rank, @(limit), @(offset) ];
+		
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, params, [self registeredName]);
+	}
+	
+	FreeYapDatabaseString(&_query);
+	FreeYapDatabaseString(&_rank);
+	
+	BOOL stop = NO;
+	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
+	
+	for (NSNumber *rowidNumber in rowids)
+	{
+		block([rowidNumber longLongValue], &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [databaseTransaction mutationDuringEnumerationException];
+	}
+}
+
+- (void)enumerateBm25OrderedKeysMatching:(NSString *)query
+                             withWeights:(NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                              usingBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	[self enumerateBm25OrderedRowidsMatching:query
+	                             withWeights:weights
+	                                   limit:limit
+	                                  offset:offset
+	                              usingBlock:^(int64_t rowid, BOOL *stop)
+	{
+		YapCollectionKey *ck = [self->databaseTransaction collectionKeyForRowid:rowid];
+		
+		block(ck.collection, ck.key, stop);
+	}];
+}
+
+- (void)enumerateBm25OrderedRowsMatching:(NSString *)query
+                             withWeights:(NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                              usingBlock:
+            (void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	[self enumerateBm25OrderedRowidsMatching:query
+	                             withWeights:weights
+	                                   limit:limit
+	                                  offset:offset
+	                              usingBlock:^(int64_t rowid, BOOL *stop)
+	{
+		YapCollectionKey *ck = nil;
+		id object = nil;
+		id metadata = nil;
+		[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
+		
+		block(ck.collection, ck.key, object, metadata, stop);
+	}];
+}
+
+- (void)enumerateBm25OrderedKeysMatching:(NSString *)query
+                             withWeights:(NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                      withSnippetOptions:(YapDatabaseFullTextSearchSnippetOptions *)options
+                              usingBlock:
+            (void (^)(NSString *snippet, NSString *collection, NSString *key, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	// The snippets are only generated for the (at most) limit rows of the page
+	
+	[self enumerateBm25OrderedRowidsMatching:query
+	                             withWeights:weights
+	                                   limit:limit
+	                                  offset:offset
+	                              usingBlock:^(int64_t rowid, BOOL *stop)
+	{
+		NSString *snippet = [self rowid:rowid matches:query withSnippetOptions:options];
+		YapCollectionKey *ck = [self->databaseTransaction collectionKeyForRowid:rowid];
+		
+		block((snippet ?: @""), ck.collection, ck.key, stop);
+	}];
 }
 
 - (void)enumerateBm25OrderedRowsMatching:(NSString *)query
-                             withWeights:(nullable NSArray<NSNumber *> *)weights
-                              usingBlock:(void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block {
-    [self enumerateBm25OrderedRowidsMatching:query withWeights:weights usingBlock:^(int64_t rowid, BOOL *stop) {
-        
-        YapCollectionKey *ck = nil;
-        id object = nil;
-        id metadata = nil;
-        [self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
-        
-        block(ck.collection, ck.key, object, metadata, stop);
-    }];
+                             withWeights:(NSArray<NSNumber *> *)weights
+                                   limit:(NSUInteger)limit
+                                  offset:(NSUInteger)offset
+                      withSnippetOptions:(YapDatabaseFullTextSearchSnippetOptions *)options
+                              usingBlock:
+            (void (^)(NSString *snippet, NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	// The snippets are only generated for the (at most) limit rows of the page
+	
+	[self enumerateBm25OrderedRowidsMatching:query
+	                             withWeights:weights
+	                                   limit:limit
+	                                  offset:offset
+	                              usingBlock:^(int64_t rowid, BOOL *stop)
+	{
+		NSString *snippet = [self rowid:rowid matches:query withSnippetOptions:options];
+		
+		YapCollectionKey *ck = nil;
+		id object = nil;
+		id metadata = nil;
+		[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
+		
+		block((snippet ?: @""), ck.collection, ck.key, object, metadata, stop);
+	}];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1105,8 +2482,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 	if (block == nil) return;
 	if ([query length] == 0) return;
 	
-	sqlite3_stmt *statement = [parentConnection querySnippetStatement];
-	if (statement == NULL) return;
+	[self flushQueuedRowidsIfNeeded];
 	
 	YapDatabaseFullTextSearchSnippetOptions *options;
 	if (inOptions)
@@ -1114,6 +2490,22 @@ static NSString *const ext_key__version_deprecated = @"version";
 	else
 		options = [[YapDatabaseFullTextSearchSnippetOptions alloc] init]; // default snippet options
 	
+	if ([self isContentless])
+	{
+		// The snippets are generated on demand (see contentlessSnippetForRowid:matching:withSnippetOptions:)
+		
+		[self enumerateRowidsMatching:query usingBlock:^(int64_t rowid, BOOL *stop) {
+			
+			NSString *snippet = [self contentlessSnippetForRowid:rowid matching:query withSnippetOptions:options];
+			
+			block((snippet ?: @""), rowid, stop);
+		}];
+		return;
+	}
+	
+	sqlite3_stmt *statement = [parentConnection querySnippetStatement];
+	if (statement == NULL) return;
+	
 	BOOL stop = NO;
 	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
 	
@@ -1137,7 +2529,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 	
 	YapDatabaseString _ellipsesText; MakeYapDatabaseString(&_ellipsesText, options.ellipsesText);
 	sqlite3_bind_text(statement, bind_idx_ellipsesText, _ellipsesText.str, _ellipsesText.length, SQLITE_STATIC);
-
+	
 	int columnIndex = -1;
 	if (options.columnName)
 	{
@@ -1157,8 +2549,11 @@ static NSString *const ext_key__version_deprecated = @"version";
 	YapDatabaseString _query; MakeYapDatabaseString(&_query, query);
 	sqlite3_bind_text(statement, bind_idx_query, _query.str, _query.length, SQLITE_STATIC);
 	
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+	
 	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
 	{
 		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
@@ -1181,6 +2576,14 @@ static NSString *const ext_key__version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
+	if (YapDatabaseQueryProfileIsSlow(&profile))
+	{
+		NSArray *params = @[ (options.startMatchText ?: @""), (options.endMatchText ?: @""), (options.ellipsesText ?: @""),
+		                     @(columnIndex), @(options.numberOfTokens), query ];
+		
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, params, [self registeredName]);
+	}
+	
 	FreeYapDatabaseString(&_startMatchText);
 	FreeYapDatabaseString(&_endMatchText);
 	FreeYapDatabaseString(&_ellipsesText);
@@ -1259,6 +2662,117 @@ static NSString *const ext_key__version_deprecated = @"version";
 	}];
 }
 
+/**
+ * A contentless table doesn't store the text, so the snippet is generated from the text returned by the FTS block:
+ * the row is inserted into a temporary (per connection) FTS table, which generates the snippet.
+**/
+- (NSString *)contentlessSnippetForRowid:(int64_t)rowid
+                                matching:(NSString *)query
+                      withSnippetOptions:(YapDatabaseFullTextSearchSnippetOptions *)options
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	sqlite3_stmt *insertStatement = [parentConnection snippetTableInsertStatement];
+	sqlite3_stmt *queryStatement = [parentConnection snippetTableQueryStatement];
+	sqlite3_stmt *removeAllStatement = [parentConnection snippetTableRemoveAllStatement];
+	
+	if (!insertStatement || !queryStatement || !removeAllStatement) return nil;
+	
+	[self invokeBlockForRowid:rowid];
+	
+	if ([parentConnection->blockDict count] == 0) return nil;
+	
+	// INSERT INTO temp."snippetTableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	
+	[self bindRowid:rowid toStatement:insertStatement];
+	[parentConnection->blockDict removeAllObjects];
+	
+	int status = sqlite3_step(insertStatement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'snippetTableInsertStatement': %d %s", status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_clear_bindings(insertStatement);
+	sqlite3_reset(insertStatement);
+	
+	if (status != SQLITE_DONE) return nil;
+	
+	// SELECT snippet("snippetTableName", ?4, ?1, ?2, ?3, ?5) FROM temp."snippetTableName" WHERE ... MATCH ?6;
+	
+	int const column_idx_snippet      = SQLITE_COLUMN_START;
+	
+	int const bind_idx_startMatchText = SQLITE_BIND_START + 0;
+	int const bind_idx_endMatchText   = SQLITE_BIND_START + 1;
+	int const bind_idx_ellipsesText   = SQLITE_BIND_START + 2;
+	int const bind_idx_columnIndex    = SQLITE_BIND_START + 3;
+	int const bind_idx_numTokens      = SQLITE_BIND_START + 4;
+	int const bind_idx_query          = SQLITE_BIND_START + 5;
+	
+	YapDatabaseString _startMatchText; MakeYapDatabaseString(&_startMatchText, options.startMatchText);
+	sqlite3_bind_text(queryStatement, bind_idx_startMatchText, _startMatchText.str, _startMatchText.length, SQLITE_STATIC);
+	
+	YapDatabaseString _endMatchText; MakeYapDatabaseString(&_endMatchText, options.endMatchText);
+	sqlite3_bind_text(queryStatement, bind_idx_endMatchText, _endMatchText.str, _endMatchText.length, SQLITE_STATIC);
+	
+	YapDatabaseString _ellipsesText; MakeYapDatabaseString(&_ellipsesText, options.ellipsesText);
+	sqlite3_bind_text(queryStatement, bind_idx_ellipsesText, _ellipsesText.str, _ellipsesText.length, SQLITE_STATIC);
+	
+	int columnIndex = -1;
+	if (options.columnName)
+	{
+		NSUInteger index = [parentConnection->parent->columnNames indexOfObject:options.columnName];
+		if (index == NSNotFound)
+		{
+			YDBLogWarn(@"Invalid snippet option: columnName(%@) not found", options.columnName);
+		}
+		else
+		{
+			columnIndex = (int)index;
+		}
+	}
+	sqlite3_bind_int(queryStatement, bind_idx_columnIndex, columnIndex);
+	sqlite3_bind_int(queryStatement, bind_idx_numTokens, options.numberOfTokens);
+	
+	YapDatabaseString _query; MakeYapDatabaseString(&_query, query);
+	sqlite3_bind_text(queryStatement, bind_idx_query, _query.str, _query.length, SQLITE_STATIC);
+	
+	NSString *snippet = nil;
+	
+	status = sqlite3_step(queryStatement);
+	if (status == SQLITE_ROW)
+	{
+		const unsigned char *text = sqlite3_column_text(queryStatement, column_idx_snippet);
+		int textSize = sqlite3_column_bytes(queryStatement, column_idx_snippet);
+		
+		snippet = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_clear_bindings(queryStatement);
+	sqlite3_reset(queryStatement);
+	
+	FreeYapDatabaseString(&_startMatchText);
+	FreeYapDatabaseString(&_endMatchText);
+	FreeYapDatabaseString(&_ellipsesText);
+	FreeYapDatabaseString(&_query);
+	
+	// DELETE FROM temp."snippetTableName";
+	
+	status = sqlite3_step(removeAllStatement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'snippetTableRemoveAllStatement': %d %s", status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_reset(removeAllStatement);
+	
+	return snippet;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Individual Query
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1267,6 +2781,8 @@ static NSString *const ext_key__version_deprecated = @"version";
 {
 	if ([query length] == 0) return NO;
 	
+	[self flushQueuedRowidIfNeeded:rowid];
+	
 	sqlite3_stmt *statement = [parentConnection rowidQueryStatement];
 	if (statement == NULL) return NO;
 	
@@ -1305,8 +2821,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 {
 	if ([query length] == 0) return nil;
 	
-	sqlite3_stmt *statement = [parentConnection rowidQuerySnippetStatement];
-	if (statement == NULL) return nil;
+	[self flushQueuedRowidIfNeeded:rowid];
 	
 	YapDatabaseFullTextSearchSnippetOptions *options;
 	if (inOptions)
@@ -1314,6 +2829,17 @@ static NSString *const ext_key__version_deprecated = @"version";
 	else
 		options = [[YapDatabaseFullTextSearchSnippetOptions alloc] init]; // default snippet options
 	
+	if ([self isContentless])
+	{
+		if (![self rowid:rowid matches:query]) return nil;
+		
+		NSString *snippet = [self contentlessSnippetForRowid:rowid matching:query withSnippetOptions:options];
+		return (snippet ?: @"");
+	}
+	
+	sqlite3_stmt *statement = [parentConnection rowidQuerySnippetStatement];
+	if (statement == NULL) return nil;
+	
 	// SELECT "rowid", snippet("tableName", ?, ?, ?, ?, ?) FROM "tableName" WHERE "rowid" = ? AND "tableName" MATCH ?;
 	
 //	int const column_idx_rowid        = SQLITE_COLUMN_START + 0;
@@ -1335,7 +2861,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 	
 	YapDatabaseString _ellipsesText; MakeYapDatabaseString(&_ellipsesText, options.ellipsesText);
 	sqlite3_bind_text(statement, bind_idx_ellipsesText, _ellipsesText.str, _ellipsesText.length, SQLITE_STATIC);
-
+	
 	int columnIndex = -1;
 	if (options.columnName)
 	{
@@ -1385,4 +2911,141 @@ static NSString *const ext_key__version_deprecated = @"version";
 	return snippet;
 }
 
+/**
+ * Returns the snippets of the given rowids (only those that match the query), keyed by rowid.
+ *
+ * This is the batch version of rowid:matches:withSnippetOptions:.
+ * The snippets are generated by a single query (per chunk of host parameters), restricted to the given rowids,
+ * rather than one query per row.
+**/
+- (NSDictionary<NSNumber *, NSString *> *)snippetsForRowids:(NSArray<NSNumber *> *)rowids
+                                                   matching:(NSString *)query
+                                         withSnippetOptions:(YapDatabaseFullTextSearchSnippetOptions *)inOptions
+{
+	if ([query length] == 0 || rowids.count == 0) return [NSDictionary dictionary];
+	
+	YapDatabaseFullTextSearchSnippetOptions *options;
+	if (inOptions)
+		options = [inOptions copy];
+	else
+		options = [[YapDatabaseFullTextSearchSnippetOptions alloc] init]; // default snippet options
+	
+	NSMutableDictionary<NSNumber *, NSString *> *snippets = [NSMutableDictionary dictionaryWithCapacity:rowids.count];
+	
+	if ([self isContentless])
+	{
+		// The snippets are generated from the text returned by the FTS block, one row at a time.
+		
+		for (NSNumber *rowidNumber in rowids)
+		{
+			NSString *snippet = [self rowid:[rowidNumber longLongValue] matches:query withSnippetOptions:options];
+			if (snippet) {
+				snippets[rowidNumber] = snippet;
+			}
+		}
+		
+		return snippets;
+	}
+	
+	for (NSNumber *rowidNumber in rowids)
+	{
+		[self flushQueuedRowidIfNeeded:[rowidNumber longLongValue]];
+	}
+	
+	int columnIndex = -1;
+	if (options.columnName)
+	{
+		NSUInteger index = [parentConnection->parent->columnNames indexOfObject:options.columnName];
+		if (index == NSNotFound)
+		{
+			YDBLogWarn(@"Invalid snippet option: columnName(%@) not found", options.columnName);
+		}
+		else
+		{
+			columnIndex = (int)index;
+		}
+	}
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	NSString *tableName = [parentConnection->parent tableName];
+	
+	// SELECT "rowid", snippet("tableName", ?, ?, ?, ?, ?) FROM "tableName"
+	//   WHERE "tableName" MATCH ?6 AND "rowid" IN (?7, ?8, ...);
+	
+	int const column_idx_rowid        = SQLITE_COLUMN_START + 0;
+	int const column_idx_snippet      = SQLITE_COLUMN_START + 1;
+	
+	int const bind_idx_startMatchText = SQLITE_BIND_START + 0;
+	int const bind_idx_endMatchText   = SQLITE_BIND_START + 1;
+	int const bind_idx_ellipsesText   = SQLITE_BIND_START + 2;
+	int const bind_idx_columnIndex    = SQLITE_BIND_START + 3;
+	int const bind_idx_numTokens      = SQLITE_BIND_START + 4;
+	int const bind_idx_query          = SQLITE_BIND_START + 5;
+	int const bind_idx_firstRowid     = SQLITE_BIND_START + 6;
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger maxRowidParams = maxHostParams - 6;
+	
+	NSUInteger offset = 0;
+	while (offset < rowids.count)
+	{
+		NSUInteger count = MIN(rowids.count - offset, maxRowidParams);
+		
+		NSMutableString *string = [NSMutableString stringWithCapacity:(200 + (count * 6))];
+		[string appendFormat:@"SELECT \"rowid\", %2$@ FROM \"%1$@\" WHERE \"%1$@\" MATCH ?6 AND \"rowid\" IN (",
+		                     tableName, [parentConnection snippetFunction]];
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			if (i == 0)
+				[string appendFormat:@"?%d", (int)(bind_idx_firstRowid + i)];
+			else
+				[string appendFormat:@", ?%d", (int)(bind_idx_firstRowid + i)];
+		}
+		
+		[string appendString:@");"];
+		
+		sqlite3_stmt *statement = NULL;
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			break;
+		}
+		
+		sqlite3_bind_text(statement, bind_idx_startMatchText, [options.startMatchText UTF8String], -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(statement, bind_idx_endMatchText, [options.endMatchText UTF8String], -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(statement, bind_idx_ellipsesText, [options.ellipsesText UTF8String], -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int(statement, bind_idx_columnIndex, columnIndex);
+		sqlite3_bind_int(statement, bind_idx_numTokens, options.numberOfTokens);
+		sqlite3_bind_text(statement, bind_idx_query, [query UTF8String], -1, SQLITE_TRANSIENT);
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			sqlite3_bind_int64(statement, (int)(bind_idx_firstRowid + i), [rowids[offset + i] longLongValue]);
+		}
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+			
+			const unsigned char *text = sqlite3_column_text(statement, column_idx_snippet);
+			int textSize = sqlite3_column_bytes(statement, column_idx_snippet);
+			
+			snippets[@(rowid)] = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		}
+		
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_finalize(statement);
+		
+		offset += count;
+	}
+	
+	return snippets;
+}
+
 @end
@@ -15,6 +15,40 @@
 	YapWhitelistBlacklist *allowedCollections;
 }
 
+/**
+ * Invoked by YapDatabaseHooksTransaction after a commit.
+ * Queues the summary for delivery to the didCommit block (according to the didCommitPolicy).
+**/
+- (void)enqueueCommitSummary:(YapDatabaseHooksCommitSummary *)summary;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseHooksCommitSummary () {
+@public
+	
+	NSUInteger commitCount;
+	uint64_t snapshot;
+	BOOL didRemoveAllRows;
+	
+	NSMutableDictionary<YapCollectionKey *, NSNumber *> *mutableChanges;
+}
+
+/**
+ * Records a change to the given row, merging it with any previous change (see YapDatabaseHooksCommitSummary).
+**/
+- (void)noteChange:(YapDatabaseHooksBitMask)flags forCollectionKey:(YapCollectionKey *)ck;
+
+- (void)noteRemoveAllRows;
+
+/**
+ * Merges a later summary into the receiver.
+**/
+- (void)mergeSummary:(YapDatabaseHooksCommitSummary *)laterSummary;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -44,6 +78,8 @@
 	
 	YapProxyObject *proxyObject;
 	YapProxyObject *proxyMetadata;
+	
+	YapDatabaseHooksCommitSummary *commitSummary; // Only if there's a didCommit block
 }
 
 - (id)initWithParentConnection:(YapDatabaseHooksConnection *)parentConnection
@@ -8,6 +8,7 @@
 
 #import "YapProxyObject.h"
 #import "YapWhitelistBlacklist.h"
+#import "YapCollectionKey.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -56,6 +57,30 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseHooksBitMask) {
 	
 	// The object is being explicitly touched.
 	YapDatabaseHooksTouchedMetadata = 1 << 5, // 0100000
+	
+	// The row was removed.
+	// This flag is only used by YapDatabaseHooksCommitSummary (see didCommit),
+	// and is never combined with any of the other flags.
+	YapDatabaseHooksRemovedRow      = 1 << 6, // 1000000
+};
+
+/**
+ * How the didCommit block handles summaries that arrive faster than it can process them.
+ *
+ * - Coalesce:
+ *     While the didCommit block is busy, the summaries of any further commits are merged into a single summary.
+ *     So the block is never more than one summary behind, no matter how slow it is.
+ *
+ * - Queue:
+ *     Every commit gets its own summary, delivered in commit order.
+ *     If the number of undelivered summaries reaches the didCommitMaxPendingSummaries,
+ *     then further commits are merged into the last undelivered summary.
+ *
+ * In both cases, the committing transaction never waits for the didCommit block.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseHooksDidCommitPolicy) {
+	YapDatabaseHooksDidCommitPolicy_Coalesce,
+	YapDatabaseHooksDidCommitPolicy_Queue,
 };
 
 /**
@@ -119,6 +144,23 @@ typedef void (^YDBHooks_WillRemoveAllRows)
 typedef void (^YDBHooks_DidRemoveAllRows)
   (YapDatabaseReadWriteTransaction *transaction);
 
+@class YapDatabaseHooksCommitSummary;
+
+/**
+ * DidCommit
+ *
+ * Invoked after a read-write transaction, which changed rows within the allowedCollections, has been committed.
+ * The block runs on the didCommitQueue, outside of the transaction (and outside of the write lock).
+ *
+ * This is the place for anything that doesn't need to be part of the transaction itself,
+ * such as logging, analytics or cache warming.
+ * Since the transaction has already completed, you can't make changes as part of it.
+ * (But you're free to read from, or write to, the database via your own connection.)
+**/
+
+typedef void (^YDBHooks_DidCommit)
+  (YapDatabaseHooksCommitSummary *summary);
+
 
 
 
@@ -137,6 +179,74 @@ typedef void (^YDBHooks_DidRemoveAllRows)
 @property (atomic, strong, readwrite, nullable) YDBHooks_WillRemoveAllRows willRemoveAllRows;
 @property (atomic, strong, readwrite, nullable) YDBHooks_DidRemoveAllRows didRemoveAllRows;
 
+/**
+ * The post-commit hook. See YDBHooks_DidCommit.
+ *
+ * The summaries are delivered serially (one at a time, in commit order), even if the didCommitQueue is concurrent.
+**/
+@property (atomic, strong, readwrite, nullable) YDBHooks_DidCommit didCommit;
+
+/**
+ * The queue on which the didCommit block is invoked.
+ * If nil, a global utility queue is used (with the summaries still delivered serially).
+**/
+@property (atomic, strong, readwrite, nullable) dispatch_queue_t didCommitQueue;
+
+/**
+ * See YapDatabaseHooksDidCommitPolicy.
+ * The default value is YapDatabaseHooksDidCommitPolicy_Coalesce.
+**/
+@property (atomic, assign, readwrite) YapDatabaseHooksDidCommitPolicy didCommitPolicy;
+
+/**
+ * Only used with YapDatabaseHooksDidCommitPolicy_Queue.
+ * The default value is zero, which means there's no limit.
+**/
+@property (atomic, assign, readwrite) NSUInteger didCommitMaxPendingSummaries;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A summary of the rows changed by one or more (coalesced) read-write transactions.
+ * Only rows within the allowedCollections are included.
+ *
+ * When summaries are coalesced, the flags for a row are merged. For example:
+ * - a row that was inserted, and then updated, has the YapDatabaseHooksInsertedRow flag (but not UpdatedRow)
+ * - a row that was changed, and then removed, has only the YapDatabaseHooksRemovedRow flag
+ * - a row that was removed, and then set again, has the flags of the set
+**/
+@interface YapDatabaseHooksCommitSummary : NSObject
+
+/**
+ * The number of read-write transactions that are included in this summary.
+**/
+@property (nonatomic, assign, readonly) NSUInteger commitCount;
+
+/**
+ * The snapshot of the (last) included commit.
+**/
+@property (nonatomic, assign, readonly) uint64_t snapshot;
+
+/**
+ * YES if removeAllObjectsInAllCollections was invoked (by any of the included commits).
+ * In which case the changes only include the rows changed after the (last) removeAll.
+**/
+@property (nonatomic, assign, readonly) BOOL didRemoveAllRows;
+
+/**
+ * The changed rows, and the YapDatabaseHooksBitMask for each (as an NSNumber).
+**/
+@property (nonatomic, copy, readonly) NSDictionary<YapCollectionKey *, NSNumber *> *changes;
+
+- (YapDatabaseHooksBitMask)flagsForKey:(NSString *)key inCollection:(nullable NSString *)collection;
+
+- (void)enumerateChangesUsingBlock:
+    (void (NS_NOESCAPE^)(NSString *collection, NSString *key, YapDatabaseHooksBitMask flags, BOOL *stop))block;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -3,6 +3,11 @@
 
 
 @implementation YapDatabaseHooks
+{
+	dispatch_queue_t didCommitStateQueue;
+	NSMutableArray<YapDatabaseHooksCommitSummary *> *pendingCommitSummaries;
+	BOOL isDeliveringCommitSummary;
+}
 
 /**
  * Subclasses MUST implement this method.
@@ -31,7 +36,10 @@
 {
 	if ((self = [super init]))
 	{
-		// Nothing to do here...
+		didCommitStateQueue = dispatch_queue_create("YapDatabaseHooks.didCommit", DISPATCH_QUEUE_SERIAL);
+		pendingCommitSummaries = [[NSMutableArray alloc] init];
+		
+		didCommitPolicy = YapDatabaseHooksDidCommitPolicy_Coalesce;
 	}
 	return self;
 }
@@ -54,6 +62,14 @@
 	return [[YapDatabaseHooksConnection alloc] initWithParent:self databaseConnection:databaseConnection];
 }
 
+/**
+ * The blocks are never invoked for rows outside the allowedCollections.
+**/
+- (YapWhitelistBlacklist *)interestedCollections
+{
+	return self.allowedCollections;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Properties
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,4 +85,184 @@
 @synthesize willRemoveAllRows = willRemoveAllRows;
 @synthesize didRemoveAllRows = didRemoveAllRows;
 
+@synthesize didCommit = didCommit;
+@synthesize didCommitQueue = didCommitQueue;
+@synthesize didCommitPolicy = didCommitPolicy;
+@synthesize didCommitMaxPendingSummaries = didCommitMaxPendingSummaries;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark DidCommit
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)enqueueCommitSummary:(YapDatabaseHooksCommitSummary *)summary
+{
+	dispatch_async(didCommitStateQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		NSUInteger maxPending = 0;
+		if (self.didCommitPolicy == YapDatabaseHooksDidCommitPolicy_Coalesce)
+			maxPending = 1;
+		else
+			maxPending = self.didCommitMaxPendingSummaries;
+		
+		if (maxPending > 0 && pendingCommitSummaries.count >= maxPending)
+		{
+			[[pendingCommitSummaries lastObject] mergeSummary:summary];
+		}
+		else
+		{
+			[pendingCommitSummaries addObject:summary];
+		}
+		
+		if (!isDeliveringCommitSummary) {
+			[self deliverNextCommitSummary];
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Must be invoked within the didCommitStateQueue.
+**/
+- (void)deliverNextCommitSummary
+{
+	YapDatabaseHooksCommitSummary *summary = [pendingCommitSummaries firstObject];
+	if (summary == nil)
+	{
+		isDeliveringCommitSummary = NO;
+		return;
+	}
+	
+	[pendingCommitSummaries removeObjectAtIndex:0];
+	isDeliveringCommitSummary = YES;
+	
+	YDBHooks_DidCommit block = self.didCommit;
+	dispatch_queue_t queue = self.didCommitQueue ?: dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+		
+		if (block) {
+			block(summary);
+		}
+		
+		dispatch_async(self->didCommitStateQueue, ^{ @autoreleasepool {
+			
+			[self deliverNextCommitSummary];
+		}});
+	}});
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseHooksCommitSummary
+
+@synthesize commitCount = commitCount;
+@synthesize snapshot = snapshot;
+@synthesize didRemoveAllRows = didRemoveAllRows;
+
+@dynamic changes;
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		mutableChanges = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (NSDictionary<YapCollectionKey *, NSNumber *> *)changes
+{
+	return [mutableChanges copy];
+}
+
+- (YapDatabaseHooksBitMask)flagsForKey:(NSString *)key inCollection:(NSString *)collection
+{
+	if (key == nil) return 0;
+	
+	YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	return (YapDatabaseHooksBitMask)[mutableChanges[ck] unsignedIntegerValue];
+}
+
+- (void)enumerateChangesUsingBlock:
+    (void (NS_NOESCAPE^)(NSString *collection, NSString *key, YapDatabaseHooksBitMask flags, BOOL *stop))block
+{
+	[mutableChanges enumerateKeysAndObjectsUsingBlock:^(YapCollectionKey *ck, NSNumber *flags, BOOL *stop) {
+		
+		block(ck.collection, ck.key, (YapDatabaseHooksBitMask)[flags unsignedIntegerValue], stop);
+	}];
+}
+
+- (void)noteChange:(YapDatabaseHooksBitMask)flags forCollectionKey:(YapCollectionKey *)ck
+{
+	NSNumber *prevFlagsNum = mutableChanges[ck];
+	if (prevFlagsNum == nil)
+	{
+		mutableChanges[ck] = @(flags);
+		return;
+	}
+	
+	YapDatabaseHooksBitMask prevFlags = (YapDatabaseHooksBitMask)[prevFlagsNum unsignedIntegerValue];
+	YapDatabaseHooksBitMask newFlags;
+	
+	if ((flags & YapDatabaseHooksRemovedRow) || (prevFlags & YapDatabaseHooksRemovedRow))
+	{
+		// Removed (after whatever happened before), or set again after being removed.
+		newFlags = flags;
+	}
+	else
+	{
+		newFlags = prevFlags | flags;
+		
+		// A row inserted (by this summary) is still an insert, no matter how many times it was updated since.
+		if (newFlags & YapDatabaseHooksInsertedRow) {
+			newFlags &= ~YapDatabaseHooksUpdatedRow;
+		}
+		
+		// Changed supersedes touched.
+		if (newFlags & YapDatabaseHooksChangedObject) {
+			newFlags &= ~YapDatabaseHooksTouchedObject;
+		}
+		if (newFlags & YapDatabaseHooksChangedMetadata) {
+			newFlags &= ~YapDatabaseHooksTouchedMetadata;
+		}
+	}
+	
+	mutableChanges[ck] = @(newFlags);
+}
+
+- (void)noteRemoveAllRows
+{
+	didRemoveAllRows = YES;
+	[mutableChanges removeAllObjects];
+}
+
+- (void)mergeSummary:(YapDatabaseHooksCommitSummary *)laterSummary
+{
+	if (laterSummary->didRemoveAllRows) {
+		[self noteRemoveAllRows];
+	}
+	
+	[laterSummary->mutableChanges enumerateKeysAndObjectsUsingBlock:^(YapCollectionKey *ck, NSNumber *flags, BOOL *stop) {
+		
+		[self noteChange:(YapDatabaseHooksBitMask)[flags unsignedIntegerValue] forCollectionKey:ck];
+	}];
+	
+	commitCount += laterSummary->commitCount;
+	snapshot = MAX(snapshot, laterSummary->snapshot);
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YapDatabaseHooksCommitSummary[%p]: commits=%lu snapshot=%llu changes=%lu%@>",
+	  self, (unsigned long)commitCount, snapshot, (unsigned long)mutableChanges.count,
+	  (didRemoveAllRows ? @" removedAll" : @"")];
+}
+
 @end
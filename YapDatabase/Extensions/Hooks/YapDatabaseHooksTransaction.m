@@ -47,6 +47,15 @@
 **/
 - (void)didCommitTransaction
 {
+	if (commitSummary)
+	{
+		commitSummary->commitCount = 1;
+		commitSummary->snapshot = databaseTransaction.connection.snapshot;
+		
+		[parentConnection->parent enqueueCommitSummary:commitSummary];
+		commitSummary = nil;
+	}
+	
 	parentConnection = nil;
 	databaseTransaction = nil;
 }
@@ -56,10 +65,32 @@
 **/
 - (void)didRollbackTransaction
 {
+	commitSummary = nil;
+	
 	parentConnection = nil;
 	databaseTransaction = nil;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark DidCommit
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Records the change for the post-commit summary, if there's a didCommit block.
+ * (Invoke after checking the allowedCollections.)
+**/
+- (void)noteCommitChange:(YapDatabaseHooksBitMask)flags forCollectionKey:(YapCollectionKey *)ck
+{
+	if (commitSummary == nil)
+	{
+		if (parentConnection->parent.didCommit == nil) return;
+		
+		commitSummary = [[YapDatabaseHooksCommitSummary alloc] init];
+	}
+	
+	[commitSummary noteChange:flags forCollectionKey:ck];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Generic Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -104,11 +135,14 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:(YapDatabaseHooksInsertedRow | YapDatabaseHooksChangedObject | YapDatabaseHooksChangedMetadata)
+	      forCollectionKey:ck];
+	
 	YDBHooks_DidModifyRow didModifyRow = parentConnection->parent.didModifyRow;
 	if (didModifyRow)
 	{
@@ -152,11 +186,14 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:(YapDatabaseHooksUpdatedRow | YapDatabaseHooksChangedObject | YapDatabaseHooksChangedMetadata)
+	      forCollectionKey:ck];
+	
 	YDBHooks_DidModifyRow didModifyRow = parentConnection->parent.didModifyRow;
 	if (didModifyRow)
 	{
@@ -182,6 +219,44 @@
 	}
 }
 
+/**
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - setObjects:forKeys:inCollection:
+ * - setObjects:forKeys:inCollection:withMetadata:
+ *
+ * If there's neither a didModifyRow nor a didCommit block, there's nothing to do for any of the rows.
+**/
+- (void)didInsertObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids
+{
+	if (parentConnection->parent.didModifyRow == nil && parentConnection->parent.didCommit == nil) return;
+	
+	[super didInsertObjects:objects forCollectionKeys:collectionKeys withMetadata:metadata rowids:rowids];
+}
+
+/**
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - setObjects:forKeys:inCollection:
+ * - setObjects:forKeys:inCollection:withMetadata:
+ *
+ * If there's neither a didModifyRow nor a didCommit block, there's nothing to do for any of the rows.
+**/
+- (void)didUpdateObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids
+{
+	if (parentConnection->parent.didModifyRow == nil && parentConnection->parent.didCommit == nil) return;
+	
+	[super didUpdateObjects:objects forCollectionKeys:collectionKeys withMetadata:metadata rowids:rowids];
+}
+
 /**
  * Subclasses MUST implement this method.
  * YapDatabaseReadWriteTransaction Hook, invoked post-op.
@@ -198,11 +273,13 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:(YapDatabaseHooksUpdatedRow | YapDatabaseHooksChangedObject) forCollectionKey:ck];
+	
 	YDBHooks_DidModifyRow didModifyRow = parentConnection->parent.didModifyRow;
 	if (didModifyRow)
 	{
@@ -243,11 +320,13 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:(YapDatabaseHooksUpdatedRow | YapDatabaseHooksChangedMetadata) forCollectionKey:ck];
+	
 	YDBHooks_DidModifyRow didModifyRow = parentConnection->parent.didModifyRow;
 	if (didModifyRow)
 	{
@@ -283,11 +362,13 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:YapDatabaseHooksTouchedObject forCollectionKey:ck];
+	
 	YDBHooks_DidModifyRow didModifyRow = parentConnection->parent.didModifyRow;
 	if (didModifyRow)
 	{
@@ -323,11 +404,13 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:YapDatabaseHooksTouchedMetadata forCollectionKey:ck];
+	
 	YDBHooks_DidModifyRow didModifyRow = parentConnection->parent.didModifyRow;
 	if (didModifyRow)
 	{
@@ -363,11 +446,14 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:(YapDatabaseHooksTouchedObject | YapDatabaseHooksTouchedMetadata)
+	      forCollectionKey:ck];
+	
 	YDBHooks_DidModifyRow didModifyRow = parentConnection->parent.didModifyRow;
 	if (didModifyRow)
 	{
@@ -403,11 +489,13 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
 	
+	[self noteCommitChange:YapDatabaseHooksRemovedRow forCollectionKey:ck];
+	
 	YDBHooks_DidRemoveRow didRemoveRow = parentConnection->parent.didRemoveRow;
 	if (didRemoveRow)
 	{
@@ -442,6 +530,15 @@
 		return;
 	}
 	
+	if (commitSummary || parentConnection->parent.didCommit)
+	{
+		for (NSString *key in keys)
+		{
+			YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			[self noteCommitChange:YapDatabaseHooksRemovedRow forCollectionKey:ck];
+		}
+	}
+	
 	YDBHooks_DidRemoveRow didRemoveRow = parentConnection->parent.didRemoveRow;
 	if (didRemoveRow)
 	{
@@ -463,6 +560,11 @@
 **/
 - (void)didRemoveAllObjectsInAllCollections
 {
+	if (commitSummary == nil && parentConnection->parent.didCommit) {
+		commitSummary = [[YapDatabaseHooksCommitSummary alloc] init];
+	}
+	[commitSummary noteRemoveAllRows];
+	
 	YDBHooks_DidRemoveAllRows didRemoveAllRows = parentConnection->parent.didRemoveAllRows;
 	if (didRemoveAllRows)
 	{
@@ -494,7 +596,7 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
@@ -542,7 +644,7 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
@@ -588,7 +690,7 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
@@ -634,7 +736,7 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
@@ -675,7 +777,7 @@
 {
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:ck.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:ck])
 	{
 		return;
 	}
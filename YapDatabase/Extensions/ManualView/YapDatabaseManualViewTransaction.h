@@ -81,6 +81,58 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (void)removeAllItemsInGroup:(NSString *)group;
 
+/**
+ * Inserts the <collection, key> tuples in the group (in order), placing the first one at the given index.
+ *
+ * This is much faster than inserting the keys one at a time,
+ * as the keys are spliced into the group in a single operation.
+ *
+ * The operation will fail if any <collection, key> already exists in the view,
+ * regardless of whether it's in the given group, or another group.
+ * It will also fail if a key doesn't exist in the database, or appears more than once.
+ * If the operation fails, the view isn't modified.
+ *
+ * @return
+ *   YES if the operation was successful. NO otherwise.
+**/
+- (BOOL)insertKeys:(NSArray<NSString *> *)keys
+      inCollection:(nullable NSString *)collection
+           atIndex:(NSUInteger)index
+           inGroup:(NSString *)group;
+
+/**
+ * Removes the items currently located within the range in the given group.
+ *
+ * @return
+ *   YES if the operation was successful (the group + range was valid). NO otherwise.
+**/
+- (BOOL)removeItemsInRange:(NSRange)range inGroup:(NSString *)group;
+
+/**
+ * Moves the items currently located within the range in the given group,
+ * such that the first item ends up at the given index (and the items keep their relative order).
+ *
+ * The index is the final index, so it must be in the range [0, numberOfItemsInGroup - range.length].
+ *
+ * @return
+ *   YES if the operation was successful (the group + range + index was valid). NO otherwise.
+**/
+- (BOOL)moveItemsInRange:(NSRange)range toIndex:(NSUInteger)index inGroup:(NSString *)group;
+
+/**
+ * Replaces all the items in the given group with the <collection, key> tuples (in order).
+ *
+ * The operation will fail if any <collection, key> already exists in another group of the view.
+ * It will also fail if a key doesn't exist in the database, or appears more than once.
+ * If the operation fails, the view isn't modified.
+ *
+ * @return
+ *   YES if the operation was successful. NO otherwise.
+**/
+- (BOOL)replaceAllItemsInGroup:(NSString *)group
+                      withKeys:(NSArray<NSString *> *)keys
+                  inCollection:(nullable NSString *)collection;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -41,7 +41,7 @@
 	
 	YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:collectionKey.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -187,7 +187,7 @@
 	// Should we ignore the row based on the allowedCollections ?
 	
 	YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
-	if (allowedCollections && ![allowedCollections isAllowed:collectionKey.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -406,4 +406,248 @@
 	[self removeAllRowidsInGroup:group];
 }
 
+/**
+ * Inserts the <collection, key> tuples in the group (in order), placing the first one at the given index.
+ *
+ * The operation will fail if any <collection, key> already exists in the view,
+ * regardless of whether it's in the given group, or another group.
+ * It will also fail if a key doesn't exist in the database, or appears more than once.
+ * If the operation fails, the view isn't modified.
+ *
+ * @return
+ *   YES if the operation was successful. NO otherwise.
+**/
+- (BOOL)insertKeys:(NSArray<NSString *> *)keys
+      inCollection:(NSString *)collection
+           atIndex:(NSUInteger)index
+           inGroup:(NSString *)group
+{
+	YDBLogAutoTrace();
+	
+	if (keys == nil) return NO;
+	if (group == nil) return NO;
+	
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
+		return NO;
+	}
+	
+	NSUInteger count = [self numberOfItemsInGroup:group];
+	if (index > count) {
+		return NO;
+	}
+	
+	if (keys.count == 0) {
+		return YES;
+	}
+	
+	NSArray<YapCollectionKey *> *collectionKeys = nil;
+	int64_t *rowids = [self rowidsForKeys:keys inCollection:collection existingGroup:nil collectionKeys:&collectionKeys];
+	
+	if (rowids == NULL) {
+		return NO;
+	}
+	
+	[self insertRowids:rowids collectionKeys:collectionKeys inGroup:group atIndex:index];
+	
+	free(rowids);
+	return YES;
+}
+
+/**
+ * Removes the items currently located within the range in the given group.
+ *
+ * @return
+ *   YES if the operation was successful (the group + range was valid). NO otherwise.
+**/
+- (BOOL)removeItemsInRange:(NSRange)range inGroup:(NSString *)group
+{
+	YDBLogAutoTrace();
+	
+	if (group == nil) return NO;
+	
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
+		return NO;
+	}
+	
+	NSUInteger count = [self numberOfItemsInGroup:group];
+	if (range.location > count || range.length > (count - range.location)) {
+		return NO;
+	}
+	
+	[self removeRowidsInRange:range inGroup:group];
+	
+	return YES;
+}
+
+/**
+ * Moves the items currently located within the range in the given group,
+ * such that the first item ends up at the given index (and the items keep their relative order).
+ *
+ * The index is the final index, so it must be in the range [0, numberOfItemsInGroup - range.length].
+ *
+ * @return
+ *   YES if the operation was successful (the group + range + index was valid). NO otherwise.
+**/
+- (BOOL)moveItemsInRange:(NSRange)range toIndex:(NSUInteger)index inGroup:(NSString *)group
+{
+	YDBLogAutoTrace();
+	
+	if (group == nil) return NO;
+	
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
+		return NO;
+	}
+	
+	NSUInteger count = [self numberOfItemsInGroup:group];
+	if (range.location > count || range.length > (count - range.location)) {
+		return NO;
+	}
+	
+	if (index > (count - range.length)) {
+		return NO;
+	}
+	
+	if (range.length == 0 || index == range.location) {
+		return YES;
+	}
+	
+	// Grab the rowids (and collection/key tuples) before the range is spliced out of the group
+	
+	int64_t *rowids = (int64_t *)malloc(sizeof(int64_t) * range.length);
+	NSMutableArray<YapCollectionKey *> *collectionKeys = [NSMutableArray arrayWithCapacity:range.length];
+	
+	__block NSUInteger i = 0;
+	[self enumerateRowidsInGroup:group
+	                 withOptions:0
+	                       range:range
+	                  usingBlock:^(int64_t rowid, NSUInteger __unused idx, BOOL __unused *stop)
+	{
+		rowids[i++] = rowid;
+		[collectionKeys addObject:[self->databaseTransaction collectionKeyForRowid:rowid]];
+	}];
+	
+	[self removeRowidsInRange:range inGroup:group];
+	[self insertRowids:rowids collectionKeys:collectionKeys inGroup:group atIndex:index];
+	
+	free(rowids);
+	return YES;
+}
+
+/**
+ * Replaces all the items in the given group with the <collection, key> tuples (in order).
+ *
+ * The operation will fail if any <collection, key> already exists in another group of the view.
+ * It will also fail if a key doesn't exist in the database, or appears more than once.
+ * If the operation fails, the view isn't modified.
+ *
+ * @return
+ *   YES if the operation was successful. NO otherwise.
+**/
+- (BOOL)replaceAllItemsInGroup:(NSString *)group
+                      withKeys:(NSArray<NSString *> *)keys
+                  inCollection:(NSString *)collection
+{
+	YDBLogAutoTrace();
+	
+	if (group == nil) return NO;
+	if (keys == nil) return NO;
+	
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
+		return NO;
+	}
+	
+	NSArray<YapCollectionKey *> *collectionKeys = nil;
+	int64_t *rowids = NULL;
+	
+	if (keys.count > 0)
+	{
+		rowids = [self rowidsForKeys:keys inCollection:collection existingGroup:group collectionKeys:&collectionKeys];
+		if (rowids == NULL) {
+			return NO;
+		}
+	}
+	
+	NSUInteger count = [self numberOfItemsInGroup:group];
+	if (count > 0)
+	{
+		[self removeRowidsInRange:NSMakeRange(0, count) inGroup:group];
+	}
+	
+	if (rowids)
+	{
+		[self insertRowids:rowids collectionKeys:collectionKeys inGroup:group atIndex:0];
+		free(rowids);
+	}
+	
+	return YES;
+}
+
+/**
+ * Fetches the rowid of every key, and checks that the keys may be added to a group.
+ * That is, every key exists in the database, appears only once,
+ * and isn't in the view (unless it's in the existingGroup, which is about to be replaced).
+ *
+ * On success, returns a malloc'd array of rowids (which the caller must free), and sets collectionKeysPtr.
+ * Otherwise returns NULL.
+**/
+- (int64_t *)rowidsForKeys:(NSArray<NSString *> *)keys
+              inCollection:(NSString *)collection
+             existingGroup:(NSString *)existingGroup
+            collectionKeys:(NSArray<YapCollectionKey *> **)collectionKeysPtr
+{
+	NSUInteger count = keys.count;
+	
+	int64_t *rowids = (int64_t *)malloc(sizeof(int64_t) * count);
+	NSMutableArray<YapCollectionKey *> *collectionKeys = [NSMutableArray arrayWithCapacity:count];
+	NSMutableSet<NSNumber *> *seenRowids = [NSMutableSet setWithCapacity:count];
+	
+	NSUInteger i = 0;
+	for (NSString *key in keys)
+	{
+		YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		int64_t rowid = 0;
+		BOOL valid = [databaseTransaction getRowid:&rowid forCollectionKey:collectionKey];
+		
+		if (valid)
+		{
+			NSString *currentGroup = [self groupForRowid:rowid];
+			if (currentGroup && !(existingGroup && [currentGroup isEqualToString:existingGroup])) {
+				valid = NO;
+			}
+		}
+		
+		if (valid)
+		{
+			NSNumber *rowidNumber = @(rowid);
+			if ([seenRowids containsObject:rowidNumber]) {
+				valid = NO;
+			}
+			else {
+				[seenRowids addObject:rowidNumber];
+			}
+		}
+		
+		if (!valid)
+		{
+			free(rowids);
+			return NULL;
+		}
+		
+		rowids[i++] = rowid;
+		[collectionKeys addObject:collectionKey];
+	}
+	
+	*collectionKeysPtr = collectionKeys;
+	return rowids;
+}
+
 @end
@@ -0,0 +1,73 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabaseExtensionTypes.h"
+#import "YapWhitelistBlacklist.h"
+
+@class YapDatabaseReadTransaction;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef BOOL (^YapDatabaseExtensionPopulationFilter)(int64_t rowid, NSString *collection, NSString *key);
+
+typedef void (^YapDatabaseExtensionPopulationBlock)
+                         (int64_t rowid, NSString *collection, NSString *key, id _Nullable object, id _Nullable metadata);
+
+/**
+ * When multiple extensions are registered together (see -[YapDatabase registerExtensions:]),
+ * the read-write transaction has an extensionPopulation.
+ *
+ * Instead of enumerating the database themselves, extensions that need to populate from the existing rows
+ * may add themselves as a participant (from within their populate method), and return immediately.
+ * Once all the extensions in the batch have been created, the database is enumerated a single time,
+ * and each row is handed to every participant that's interested in it.
+ * So each row is fetched (and each object & metadata is deserialized) only once, no matter how many extensions.
+ *
+ * Extensions that don't support this simply populate themselves, as usual.
+**/
+@interface YapDatabaseExtensionPopulation : NSObject
+
+/**
+ * Adds an extension to the pending population.
+ *
+ * @param extensionName
+ *   The registeredName of the extension.
+ *   Used to ensure dependent extensions (e.g. a filteredView) aren't created until their parent is populated.
+ *
+ * @param allowedCollections
+ *   If non-nil, the participant is only invoked for rows within the allowed collections.
+ *
+ * @param blockType
+ *   Whether the block needs the object and/or metadata.
+ *   If it doesn't, the block may (or may not) be passed nil.
+ *
+ * @param filter
+ *   Optional. If the filter returns NO for a row, the block isn't invoked for the row.
+ *   It's invoked immediately before the block (for the same row), so it may pass information to the block.
+ *
+ * @param block
+ *   Invoked for every row in the allowed collections (that passes the filter).
+ *
+ * @param completion
+ *   Optional. Invoked after the enumeration completes.
+**/
+- (void)addParticipantWithName:(NSString *)extensionName
+            allowedCollections:(nullable YapWhitelistBlacklist *)allowedCollections
+                     blockType:(YapDatabaseBlockType)blockType
+                        filter:(nullable YapDatabaseExtensionPopulationFilter)filter
+                         block:(YapDatabaseExtensionPopulationBlock)block
+                    completion:(nullable dispatch_block_t)completion;
+
+/**
+ * Returns YES if the extension with the given name is waiting to be populated.
+**/
+- (BOOL)hasParticipantWithName:(NSString *)extensionName;
+
+/**
+ * Enumerates the database (once), populating all pending participants.
+ * Afterwards the list of participants is empty.
+**/
+- (void)populateWithTransaction:(YapDatabaseReadTransaction *)transaction;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -9,6 +9,8 @@
 #import "YapDatabaseTransaction.h"
 
 #import "YapCollectionKey.h"
+#import "YapCache.h"
+#import "YapWhitelistBlacklist.h"
 #import "YapMemoryTable.h"
 
 #import "sqlite3.h"
@@ -45,9 +47,13 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 - (NSSet *)dependencies;
 - (BOOL)isPersistent;
 
+- (YapWhitelistBlacklist *)interestedCollections;
+
 - (BOOL)supportsDatabaseWithRegisteredExtensions:(NSDictionary<NSString*, YapDatabaseExtension*> *)registeredExtensions;
 - (void)didRegisterExtension;
 
+- (BOOL)hasPendingPopulation;
+
 - (YapDatabaseExtensionConnection *)newConnection:(YapDatabaseConnection *)databaseConnection;
 
 - (void)processChangeset:(NSDictionary *)changeset;
@@ -72,6 +78,12 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 
 - (void)_flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags;
 
+- (void)enumerateMemoryUsageWithBlock:(void (^)(NSString *component,
+                                                uint64_t bytes,
+                                                YapDatabaseConnectionFlushMemoryFlags flushFlags))block;
+
+- (void)enumerateCachesWithBlock:(void (^)(NSString *cacheName, YapCache *cache))block;
+
 - (void)getInternalChangeset:(NSMutableDictionary **)internalPtr
            externalChangeset:(NSMutableDictionary **)externalPtr
               hasDiskChanges:(BOOL *)hasDiskChangesPtr;
@@ -99,11 +111,18 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 - (BOOL)prepareIfNeeded;
 
 - (BOOL)flushPendingChangesToMainDatabaseTable;
+- (void)prepareChangesForExtensionTables;
 - (void)flushPendingChangesToExtensionTables;
 
+- (BOOL)overridesHook:(SEL)selector;
+
 - (void)didCommitTransaction;
 - (void)didRollbackTransaction;
 
+- (BOOL)populateNextChunk;
+
+- (BOOL)prepareForReuse;
+
 #pragma mark Hooks
 
 /**
@@ -120,6 +139,16 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
            withMetadata:(id)metadata
                   rowid:(int64_t)rowid;
 
+- (void)didInsertObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids;
+
+- (void)didUpdateObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids;
+
 - (void)didReplaceObject:(id)object
         forCollectionKey:(YapCollectionKey *)collectionKey
                withRowid:(int64_t)rowid;
@@ -132,10 +161,31 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 - (void)didTouchMetadataForCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid;
 - (void)didTouchRowForCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid;
 
+- (void)didTouchObjectsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                              withRowids:(NSArray<NSNumber *> *)rowids;
+
 - (void)didRemoveObjectForCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid;
 
 - (void)didRemoveObjectsForKeys:(NSArray *)keys inCollection:(NSString *)collection withRowids:(NSArray *)rowids;
 
+// Concurrent handler evaluation (for the batch hooks)
+
+- (BOOL)supportsConcurrentHandlerEvaluation;
+
+- (void)evaluateHandlersForObjects:(NSArray *)objects
+                 forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                      withMetadata:(NSArray *)metadata
+                             range:(NSRange)range
+                          isInsert:(BOOL)isInsert
+                           results:(NSMutableArray *)results;
+
+- (void)setEvaluatedHandlerResults:(NSArray *)results;
+
+// Bulk load (the row hooks are skipped, and the extension is rebuilt before the commit)
+
+- (BOOL)supportsBulkLoad;
+- (BOOL)rebuildAfterBulkLoad;
+
 - (void)didRemoveAllObjectsInAllCollections;
 
 // Pre-op versions
@@ -149,6 +199,15 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
             withMetadata:(id)metadata
                    rowid:(int64_t)rowid;
 
+- (void)willInsertObjects:(NSArray *)objects
+        forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+             withMetadata:(NSArray *)metadata;
+
+- (void)willUpdateObjects:(NSArray *)objects
+        forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+             withMetadata:(NSArray *)metadata
+                   rowids:(NSArray<NSNumber *> *)rowids;
+
 - (void)willReplaceObject:(id)object
          forCollectionKey:(YapCollectionKey *)collectionKey
                 withRowid:(int64_t)rowid;
@@ -163,6 +222,10 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 
 - (void)willRemoveAllObjectsInAllCollections;
 
+// Bulk versions
+
+- (BOOL)handleRemoveAllObjectsInCollection:(NSString *)collection;
+
 
 #pragma mark Configuration Values
 
@@ -178,6 +241,10 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 - (int)intValueForExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 - (void)setIntValue:(int)value forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 
+- (BOOL)getInt64Value:(int64_t *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
+- (int64_t)int64ValueForExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
+- (void)setInt64Value:(int64_t)value forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
+
 - (BOOL)getDoubleValue:(double *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 - (double)doubleValueForExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 - (void)setDoubleValue:(double)value forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
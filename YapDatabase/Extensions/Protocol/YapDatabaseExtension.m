@@ -125,6 +125,35 @@
 	return YES;
 }
 
+/**
+ * Subclasses MAY implement this method IF they only process rows within certain collections.
+ *
+ * If non-nil, the extension promises that every row hook for a collection that isn't allowed is a no-op.
+ * The database then skips the hooks (and the extension's checks of its own allowedCollections) for such rows.
+ * The result is evaluated at most once per collection per transaction.
+ *
+ * The default implementation returns nil (interested in every collection).
+**/
+- (YapWhitelistBlacklist *)interestedCollections
+{
+	return nil;
+}
+
+/**
+ * Subclasses MAY implement this method IF they support incremental population.
+ *
+ * Return YES if the extension still has rows to populate (e.g. from a previous app launch, or a new registration),
+ * in which case the database will invoke -[YapDatabaseExtensionTransaction populateNextChunk] repeatedly,
+ * each time within its own (short) readWriteTransaction, until it returns YES.
+ *
+ * This method is invoked (within the writeQueue) after the extension has been registered.
+ * The default implementation returns NO.
+**/
+- (BOOL)hasPendingPopulation
+{
+	return NO;
+}
+
 /**
  * Subclasses MUST implement this method.
  * Returns a proper instance of the YapDatabaseExtensionConnection subclass.
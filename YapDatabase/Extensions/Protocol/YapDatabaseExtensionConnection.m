@@ -72,6 +72,38 @@
 	NSAssert(NO, @"Missing required override method(%@) in class(%@)", NSStringFromSelector(_cmd), [self class]);
 }
 
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * It is only invoked on the databaseConnection's connectionQueue.
+ *
+ * This method is used by -[YapDatabaseConnection memoryReport] & -[YapDatabaseConnection flushMemoryWithFlags:targetBytes:].
+ * Subclasses should invoke the block once for each (significant) memory holder,
+ * along with the flag that would release it when passed to _flushMemoryWithFlags:.
+ *
+ * The component name should be short (e.g. "pageCache"), as it gets prefixed with the registered name of the extension.
+ *
+ * The default implementation does nothing.
+**/
+- (void)enumerateMemoryUsageWithBlock:(void (__unused ^)(NSString *component,
+                                                         uint64_t bytes,
+                                                         YapDatabaseConnectionFlushMemoryFlags flushFlags))block
+{
+	// Override me (if needed)
+}
+
+/**
+ * Subclasses should invoke the block once for each YapCache they maintain,
+ * so the cache shows up in -[YapDatabaseConnection statistics].
+ *
+ * The cache name should be short (e.g. "pageCache"), as it gets prefixed with the registered name of the extension.
+ *
+ * The default implementation does nothing.
+**/
+- (void)enumerateCachesWithBlock:(void (__unused ^)(NSString *cacheName, YapCache *cache))block
+{
+	// Override me (if needed)
+}
+
 /**
  * Subclasses MUST implement this method.
  * This method is only called if within a readwrite transaction.
@@ -0,0 +1,241 @@
+#import "YapDatabaseExtensionPopulation.h"
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+@interface YapDatabaseExtensionPopulationParticipant : NSObject {
+@public
+	NSString *extensionName;
+	YapWhitelistBlacklist *allowedCollections;
+	YapDatabaseBlockType blockType;
+	
+	YapDatabaseExtensionPopulationFilter filter;
+	YapDatabaseExtensionPopulationBlock block;
+	dispatch_block_t completion;
+}
+@end
+
+@implementation YapDatabaseExtensionPopulationParticipant
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseExtensionPopulation
+{
+	NSMutableArray<YapDatabaseExtensionPopulationParticipant *> *participants;
+}
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		participants = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (void)addParticipantWithName:(NSString *)extensionName
+            allowedCollections:(YapWhitelistBlacklist *)allowedCollections
+                     blockType:(YapDatabaseBlockType)blockType
+                        filter:(YapDatabaseExtensionPopulationFilter)filter
+                         block:(YapDatabaseExtensionPopulationBlock)block
+                    completion:(dispatch_block_t)completion
+{
+	YapDatabaseExtensionPopulationParticipant *participant = [[YapDatabaseExtensionPopulationParticipant alloc] init];
+	participant->extensionName = [extensionName copy];
+	participant->allowedCollections = allowedCollections;
+	participant->blockType = blockType;
+	participant->filter = filter;
+	participant->block = block;
+	participant->completion = completion;
+	
+	[participants addObject:participant];
+}
+
+- (BOOL)hasParticipantWithName:(NSString *)extensionName
+{
+	for (YapDatabaseExtensionPopulationParticipant *participant in participants)
+	{
+		if ([participant->extensionName isEqualToString:extensionName]) return YES;
+	}
+	
+	return NO;
+}
+
+- (void)populateWithTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	if ([participants count] == 0) return;
+	
+	NSArray<YapDatabaseExtensionPopulationParticipant *> *allParticipants = [participants copy];
+	[participants removeAllObjects];
+	
+	YDBLogVerbose(@"Populating %lu extensions with a single enumeration", (unsigned long)[allParticipants count]);
+	
+	// Figure out what the enumeration needs to fetch.
+	// The object (or metadata) is deserialized (once) if any participant needs it.
+	
+	YapDatabaseBlockType blockType = YapDatabaseBlockTypeWithKey;
+	BOOL needsAllCollections = NO;
+	
+	for (YapDatabaseExtensionPopulationParticipant *participant in allParticipants)
+	{
+		blockType |= participant->blockType;
+		
+		if (participant->allowedCollections == nil) {
+			needsAllCollections = YES;
+		}
+	}
+	
+	NSMutableArray<NSString *> *collections = nil;
+	if (!needsAllCollections)
+	{
+		collections = [NSMutableArray array];
+		
+		for (NSString *collection in [transaction allCollections])
+		{
+			for (YapDatabaseExtensionPopulationParticipant *participant in allParticipants)
+			{
+				if ([participant->allowedCollections isAllowed:collection])
+				{
+					[collections addObject:collection];
+					break;
+				}
+			}
+		}
+		
+		if ([collections count] == 0)
+		{
+			// Nothing to enumerate
+			for (YapDatabaseExtensionPopulationParticipant *participant in allParticipants)
+			{
+				if (participant->completion) participant->completion();
+			}
+			return;
+		}
+	}
+	
+	// The enumeration is sorted by collection,
+	// so we only need to recalculate the participants for each collection when the collection changes.
+	
+	__block NSString *lastCollection = nil;
+	__block NSMutableArray<YapDatabaseExtensionPopulationParticipant *> *collectionParticipants = nil;
+	
+	NSMutableArray<YapDatabaseExtensionPopulationParticipant *> *rowParticipants =
+	  [NSMutableArray arrayWithCapacity:[allParticipants count]];
+	
+	BOOL (^filter)(int64_t rowid, NSString *collection, NSString *key);
+	filter = ^BOOL (int64_t rowid, NSString *collection, NSString *key) {
+		
+		if (lastCollection == nil || ![lastCollection isEqualToString:collection])
+		{
+			lastCollection = collection;
+			collectionParticipants = [NSMutableArray arrayWithCapacity:[allParticipants count]];
+			
+			for (YapDatabaseExtensionPopulationParticipant *participant in allParticipants)
+			{
+				if (participant->allowedCollections == nil || [participant->allowedCollections isAllowed:collection]) {
+					[collectionParticipants addObject:participant];
+				}
+			}
+		}
+		
+		[rowParticipants removeAllObjects];
+		
+		for (YapDatabaseExtensionPopulationParticipant *participant in collectionParticipants)
+		{
+			if (participant->filter == nil || participant->filter(rowid, collection, key)) {
+				[rowParticipants addObject:participant];
+			}
+		}
+		
+		return ([rowParticipants count] > 0);
+	};
+	
+	void (^invoke)(int64_t rowid, NSString *collection, NSString *key, id object, id metadata);
+	invoke = ^(int64_t rowid, NSString *collection, NSString *key, id object, id metadata) {
+		
+		for (YapDatabaseExtensionPopulationParticipant *participant in rowParticipants)
+		{
+			participant->block(rowid, collection, key, object, metadata);
+		}
+	};
+	
+	if (blockType == YapDatabaseBlockTypeWithKey)
+	{
+		void (^block)(int64_t rowid, NSString *collection, NSString *key, BOOL *stop);
+		block = ^(int64_t rowid, NSString *collection, NSString *key, BOOL __unused *stop) {
+			
+			if (filter(rowid, collection, key)) {
+				invoke(rowid, collection, key, nil, nil);
+			}
+		};
+		
+		if (collections)
+			[transaction _enumerateKeysInCollections:collections usingBlock:block];
+		else
+			[transaction _enumerateKeysInAllCollectionsUsingBlock:block];
+	}
+	else if (blockType == YapDatabaseBlockTypeWithObject)
+	{
+		void (^block)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop);
+		block = ^(int64_t rowid, NSString *collection, NSString *key, id object, BOOL __unused *stop) {
+			
+			invoke(rowid, collection, key, object, nil);
+		};
+		
+		if (collections)
+			[transaction _enumerateKeysAndObjectsInCollections:collections usingBlock:block withFilter:filter];
+		else
+			[transaction _enumerateKeysAndObjectsInAllCollectionsUsingBlock:block withFilter:filter];
+	}
+	else if (blockType == YapDatabaseBlockTypeWithMetadata)
+	{
+		void (^block)(int64_t rowid, NSString *collection, NSString *key, id metadata, BOOL *stop);
+		block = ^(int64_t rowid, NSString *collection, NSString *key, id metadata, BOOL __unused *stop) {
+			
+			invoke(rowid, collection, key, nil, metadata);
+		};
+		
+		if (collections)
+			[transaction _enumerateKeysAndMetadataInCollections:collections usingBlock:block withFilter:filter];
+		else
+			[transaction _enumerateKeysAndMetadataInAllCollectionsUsingBlock:block withFilter:filter];
+	}
+	else // if (blockType == YapDatabaseBlockTypeWithRow)
+	{
+		void (^block)(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop);
+		block = ^(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL __unused *stop) {
+			
+			invoke(rowid, collection, key, object, metadata);
+		};
+		
+		if (collections)
+			[transaction _enumerateRowsInCollections:collections usingBlock:block withFilter:filter];
+		else
+			[transaction _enumerateRowsInAllCollectionsUsingBlock:block withFilter:filter];
+	}
+	
+	for (YapDatabaseExtensionPopulationParticipant *participant in allParticipants)
+	{
+		if (participant->completion) participant->completion();
+	}
+}
+
+@end
@@ -3,6 +3,7 @@
 #import "YapDatabasePrivate.h"
 #import "YapDatabaseString.h"
 #import "YapDatabaseLogging.h"
+#import "YapNull.h"
 
 #if ! __has_feature(objc_arc)
 #warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
@@ -143,6 +144,23 @@
 	return NO;
 }
 
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * This method is only called if within a readwrite transaction.
+ *
+ * Invoked right before flushPendingChangesToExtensionTables,
+ * and is the place for CPU-bound preparation of the changes (e.g. serialization).
+ *
+ * IMPORTANT:
+ * This method may be invoked concurrently with the same method of other extensions (on a background thread).
+ * So it MUST NOT access the database (sqlite, the databaseTransaction, or other extensions).
+ * It may only touch the state of this extension.
+**/
+- (void)prepareChangesForExtensionTables
+{
+	// Override me if needed
+}
+
 /**
  * Subclasses may OPTIONALLY implement this method.
  * This method is only called if within a readwrite transaction.
@@ -193,6 +211,40 @@
 	// databaseTransaction = nil;
 }
 
+/**
+ * Subclasses MUST implement this method IF the extension returns YES from hasPendingPopulation.
+ * This method is only called for read-write transactions.
+ *
+ * Populates the next (bounded) chunk of rows, and persists the progress such that the population
+ * can be resumed after the transaction commits (or after the app is relaunched).
+ * Each chunk is executed within its own readWriteTransaction,
+ * which allows other readWriteTransactions to proceed in between chunks.
+ *
+ * Return YES if the population is complete, or NO if there are more chunks to process.
+ * The default implementation returns YES.
+**/
+- (BOOL)populateNextChunk
+{
+	return YES;
+}
+
+/**
+ * Subclasses MAY override this method.
+ * This method is only called for read-only transactions.
+ * 
+ * Connections recycle their read-only transactions (including the extension transactions).
+ * This method is invoked after the read-only transaction has completed,
+ * and if it returns YES, this instance may be handed out again by the next read-only transaction
+ * (on the same connection, and at the same snapshot).
+ * 
+ * The default implementation returns YES, as extension transactions typically store their state in the connection.
+ * Subclasses that store per-transaction state should either reset it here, or return NO.
+**/
+- (BOOL)prepareForReuse
+{
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Generic Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -259,6 +311,74 @@
 	NSAssert(NO, @"Missing required override method(%@) in class(%@)", NSStringFromSelector(_cmd), [self class]);
 }
 
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - setObjects:forKeys:inCollection:
+ * - setObjects:forKeys:inCollection:withMetadata:
+ *
+ * The rows are being inserted, meaning there is not currently an entry for any of the collection/key tuples.
+ * The arrays are all the same size. Within the metadata array, nil metadata is represented by YapNull.
+ *
+ * The default implementation simply invokes didInsertObject:forCollectionKey:withMetadata:rowid: for each item.
+ * Subclasses that can process a batch more efficiently (e.g. by amortizing statement preparation or sorting)
+ * should override this method.
+**/
+- (void)didInsertObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids
+{
+	id yapNull = [YapNull null];
+	
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		id meta = metadata[i];
+		if (meta == yapNull) meta = nil;
+		
+		[self didInsertObject:objects[i]
+		     forCollectionKey:collectionKeys[i]
+		         withMetadata:meta
+		                rowid:[rowids[i] longLongValue]];
+	}
+}
+
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - setObjects:forKeys:inCollection:
+ * - setObjects:forKeys:inCollection:withMetadata:
+ *
+ * The rows are being modified, meaning there is already an entry for each of the collection/key tuples.
+ * The arrays are all the same size. Within the metadata array, nil metadata is represented by YapNull.
+ *
+ * The default implementation simply invokes didUpdateObject:forCollectionKey:withMetadata:rowid: for each item.
+**/
+- (void)didUpdateObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids
+{
+	id yapNull = [YapNull null];
+	
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		id meta = metadata[i];
+		if (meta == yapNull) meta = nil;
+		
+		[self didUpdateObject:objects[i]
+		     forCollectionKey:collectionKeys[i]
+		         withMetadata:meta
+		                rowid:[rowids[i] longLongValue]];
+	}
+}
+
 /**
  * Subclasses MUST implement this method.
  * YapDatabaseReadWriteTransaction Hook, invoked post-op.
@@ -329,6 +449,28 @@
 	NSAssert(NO, @"Missing required override method(%@) in class(%@)", NSStringFromSelector(_cmd), [self class]);
 }
 
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - touchObjectsForKeys:inCollection:
+ *
+ * The arrays are the same size, and every row exists.
+ *
+ * The default implementation simply invokes didTouchObjectForCollectionKey:withRowid: for each item.
+ * Subclasses that can process a batch more efficiently should override this method.
+**/
+- (void)didTouchObjectsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                              withRowids:(NSArray<NSNumber *> *)rowids
+{
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[self didTouchObjectForCollectionKey:collectionKeys[i] withRowid:[rowids[i] longLongValue]];
+	}
+}
+
 /**
  * Subclasses MUST implement this method.
  * YapDatabaseReadWriteTransaction Hook, invoked post-op.
@@ -374,6 +516,100 @@
 	NSAssert(NO, @"Missing required override method(%@) in class(%@)", NSStringFromSelector(_cmd), [self class]);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Concurrent Handler Evaluation
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ *
+ * For large batches (setObjects:forKeys:inCollection:...), the YapDatabaseReadWriteTransaction can evaluate
+ * the handler blocks of multiple extensions (and multiple chunks of rows) concurrently,
+ * before invoking the didUpdateObjects:... & didInsertObjects:... hooks (in order, on the transaction thread).
+ *
+ * Return YES if the extension supports this, which means the evaluation is a pure function of the row.
+ * That is, evaluateHandlersForObjects:... doesn't touch the database or any mutable state of the extension.
+ *
+ * Only extensions without dependencies are eligible.
+ * An extension that depends on another extension may read that extension's state from its handler.
+ *
+ * The default implementation returns NO.
+**/
+- (BOOL)supportsConcurrentHandlerEvaluation
+{
+	return NO;
+}
+
+/**
+ * Subclasses may OPTIONALLY implement this method (required if supportsConcurrentHandlerEvaluation returns YES).
+ * Invoked on a background thread, possibly concurrently with other ranges of the same batch.
+ *
+ * The extension should evaluate its handler for each row in the given range of the batch,
+ * and append one result (per row, in order) to the given results array. Use YapNull if there's no result.
+ *
+ * The arrays are the same as the ones that will be passed to didUpdateObjects:... (isInsert == NO)
+ * or didInsertObjects:... (isInsert == YES).
+**/
+- (void)evaluateHandlersForObjects:(NSArray __unused *)objects
+                 forCollectionKeys:(NSArray<YapCollectionKey *> __unused *)collectionKeys
+                      withMetadata:(NSArray __unused *)metadata
+                             range:(NSRange __unused)range
+                          isInsert:(BOOL __unused)isInsert
+                           results:(NSMutableArray __unused *)results
+{
+	// Override me if needed
+}
+
+/**
+ * Subclasses may OPTIONALLY implement this method (required if supportsConcurrentHandlerEvaluation returns YES).
+ *
+ * Invoked on the transaction thread, right before the corresponding didUpdateObjects:... or didInsertObjects:...
+ * The results array has one item per row of the batch (the concatenated results of evaluateHandlersForObjects:...).
+ * Invoked again (with nil) after the hook.
+**/
+- (void)setEvaluatedHandlerResults:(NSArray __unused *)results
+{
+	// Override me if needed
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Bulk Load
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ *
+ * During a bulk load (see -[YapDatabaseConnection bulkLoadWithBlock:]), the YapDatabaseReadWriteTransaction
+ * can skip the row hooks of the extension entirely, and instead have it rebuild its tables once,
+ * right before the transaction commits (via rebuildAfterBulkLoad).
+ *
+ * Return YES if the extension supports this, which means:
+ * - rebuilding from scratch produces the same result as processing every hook would have
+ * - the extension doesn't report (per-row) changes in its changeset
+ *
+ * Extensions that other extensions depend on are never suspended,
+ * as the dependent extension may read the state of the extension from its handler.
+ *
+ * The default implementation returns NO.
+**/
+- (BOOL)supportsBulkLoad
+{
+	return NO;
+}
+
+/**
+ * Subclasses may OPTIONALLY implement this method (required if supportsBulkLoad returns YES).
+ *
+ * Invoked at the end of a bulk load (before the transaction commits), if the row hooks were skipped.
+ * The extension should rebuild its tables from the rows in the database.
+ *
+ * Return NO if the rebuild failed, in which case the transaction is rolled back.
+**/
+- (BOOL)rebuildAfterBulkLoad
+{
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Pre-Hooks
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -415,6 +651,88 @@
 	// Override me if needed
 }
 
+/**
+ * Returns YES if the subclass overrides the given (per-row) hook.
+ * 
+ * The optional pre-op hooks are no-ops by default, and most extensions don't implement them.
+ * So the default batch implementations can skip the per-row loop (and its message sends) entirely.
+**/
+- (BOOL)overridesHook:(SEL)selector
+{
+	IMP baseIMP = [YapDatabaseExtensionTransaction instanceMethodForSelector:selector];
+	return ([self methodForSelector:selector] != baseIMP);
+}
+
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * YapDatabaseReadWriteTransaction Hook, invoked pre-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - setObjects:forKeys:inCollection:
+ * - setObjects:forKeys:inCollection:withMetadata:
+ *
+ * The rows are being inserted, meaning there is not currently an entry for any of the collection/key tuples.
+ * The arrays are all the same size. Within the metadata array, nil metadata is represented by YapNull.
+ *
+ * The default implementation invokes willInsertObject:forCollectionKey:withMetadata: for each item
+ * (if the subclass implements it).
+**/
+- (void)willInsertObjects:(NSArray *)objects
+        forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+             withMetadata:(NSArray *)metadata
+{
+	if (![self overridesHook:@selector(willInsertObject:forCollectionKey:withMetadata:)]) return;
+	
+	id yapNull = [YapNull null];
+	
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		id meta = metadata[i];
+		if (meta == yapNull) meta = nil;
+		
+		[self willInsertObject:objects[i]
+		      forCollectionKey:collectionKeys[i]
+		          withMetadata:meta];
+	}
+}
+
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * YapDatabaseReadWriteTransaction Hook, invoked pre-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - setObjects:forKeys:inCollection:
+ * - setObjects:forKeys:inCollection:withMetadata:
+ *
+ * The rows are being modified, meaning there is already an entry for each of the collection/key tuples.
+ * The arrays are all the same size. Within the metadata array, nil metadata is represented by YapNull.
+ *
+ * The default implementation invokes willUpdateObject:forCollectionKey:withMetadata:rowid: for each item
+ * (if the subclass implements it).
+**/
+- (void)willUpdateObjects:(NSArray *)objects
+        forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+             withMetadata:(NSArray *)metadata
+                   rowids:(NSArray<NSNumber *> *)rowids
+{
+	if (![self overridesHook:@selector(willUpdateObject:forCollectionKey:withMetadata:rowid:)]) return;
+	
+	id yapNull = [YapNull null];
+	
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		id meta = metadata[i];
+		if (meta == yapNull) meta = nil;
+		
+		[self willUpdateObject:objects[i]
+		      forCollectionKey:collectionKeys[i]
+		          withMetadata:meta
+		                 rowid:[rowids[i] longLongValue]];
+	}
+}
+
 /**
  * Subclasses may OPTIONALLY implement this method.
  * YapDatabaseReadWriteTransaction Hook, invoked pre-op.
@@ -493,6 +811,26 @@
 	// Override me if needed
 }
 
+/**
+ * Subclasses may OPTIONALLY implement this method.
+ * YapDatabaseReadWriteTransaction Hook, invoked pre-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - truncateCollection:
+ *
+ * The rows of the collection are still present, so the extension may remove its own rows in bulk,
+ * e.g. via "DELETE FROM ext WHERE rowid IN (SELECT rowid FROM database2 WHERE collection = ?)".
+ *
+ * Return YES if the removal was handled, in which case the extension won't be notified of the removed keys.
+ * Return NO to receive the usual willRemoveObjectsForKeys:... & didRemoveObjectsForKeys:... hooks instead.
+ *
+ * The default implementation returns NO.
+**/
+- (BOOL)handleRemoveAllObjectsInCollection:(NSString *)collection
+{
+	return NO;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Configuration Values
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -647,6 +985,66 @@
 	}
 }
 
+- (BOOL)getInt64Value:(int64_t *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)persistent
+{
+	NSString *registeredName = [[[self extensionConnection] extension] registeredName];
+	
+	if (persistent)
+	{
+		return [[self databaseTransaction] getInt64Value:valuePtr forKey:key extension:registeredName];
+	}
+	else
+	{
+		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:registeredName key:key];
+		
+		id object = [[[self databaseTransaction] yapMemoryTableTransaction] objectForKey:ck];
+		if (object)
+		{
+			if (valuePtr) *valuePtr = [object longLongValue];
+			return YES;
+		}
+		else
+		{
+			if (valuePtr) *valuePtr = 0;
+			return NO;
+		}
+	}
+}
+
+- (int64_t)int64ValueForExtensionKey:(NSString *)key persistent:(BOOL)persistent
+{
+	int64_t value = 0;
+	[self getInt64Value:&value forExtensionKey:key persistent:persistent];
+	return value;
+}
+
+- (void)setInt64Value:(int64_t)value forExtensionKey:(NSString *)key persistent:(BOOL)persistent
+{
+	YapDatabaseReadTransaction *databaseTransaction = [self databaseTransaction];
+	if (databaseTransaction->isReadWriteTransaction)
+	{
+		NSString *registeredName = [[[self extensionConnection] extension] registeredName];
+		
+		if (persistent)
+		{
+			__unsafe_unretained YapDatabaseReadWriteTransaction *rwDatabaseTransaction =
+			  (YapDatabaseReadWriteTransaction *)databaseTransaction;
+			
+			[rwDatabaseTransaction setInt64Value:value forKey:key extension:registeredName];
+		}
+		else
+		{
+			YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:registeredName key:key];
+			
+			[[databaseTransaction yapMemoryTableTransaction] setObject:@(value) forKey:ck];
+		}
+	}
+	else
+	{
+		NSAssert(NO, @"Cannot modify database outside of readWrite transaction!");
+	}
+}
+
 - (BOOL)getDoubleValue:(double *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)persistent
 {
 	NSString *registeredName = [[[self extensionConnection] extension] registeredName];
@@ -0,0 +1,34 @@
+#import <Foundation/Foundation.h>
+
+/**
+ * Collects the bounding boxes of the rows during population, so they can be inserted into the rtree
+ * in Sort-Tile-Recursive (STR) order, rather than in rowid order.
+ *
+ * Each box has one value per column of the setup, i.e. (min, max) pairs: minX, maxX, minY, maxY, ...
+ * The boxes are stored in flat storage (no per-box objects).
+**/
+@interface YapDatabaseRTreeIndexBulkLoad : NSObject
+
+- (id)initWithColumnCount:(NSUInteger)columnCount;
+
+- (NSUInteger)count;
+
+/**
+ * The values array must contain columnCount values.
+**/
+- (void)addRowid:(int64_t)rowid values:(const double *)values;
+
+/**
+ * Sorts the boxes using STR:
+ * The boxes are sorted by the center of the first dimension, and split into slabs.
+ * Each slab is then sorted by the center of the next dimension, and split again, and so on.
+ * Consecutive boxes thus form tiles of (at most) nodeCapacity boxes that are close together.
+**/
+- (void)sortWithNodeCapacity:(NSUInteger)nodeCapacity;
+
+/**
+ * Enumerates the boxes (in sorted order, if sorted).
+**/
+- (void)enumerateUsingBlock:(void (^)(int64_t rowid, const double *values, BOOL *stop))block;
+
+@end
@@ -0,0 +1,114 @@
+#import "YapDatabaseRTreeIndexBulkLoad.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+
+@implementation YapDatabaseRTreeIndexBulkLoad
+{
+	NSUInteger columnCount;
+
+	std::vector<int64_t> rowids;
+	std::vector<double> values;   // columnCount values per box
+	std::vector<uint32_t> order;  // indexes of the boxes, in enumeration order
+}
+
+- (id)initWithColumnCount:(NSUInteger)inColumnCount
+{
+	if ((self = [super init]))
+	{
+		columnCount = inColumnCount;
+	}
+	return self;
+}
+
+- (NSUInteger)count
+{
+	return rowids.size();
+}
+
+- (void)addRowid:(int64_t)rowid values:(const double *)boxValues
+{
+	order.push_back((uint32_t)rowids.size());
+
+	rowids.push_back(rowid);
+	values.insert(values.end(), boxValues, boxValues + columnCount);
+}
+
+/**
+ * Sorts order[begin, end) by the center of the given dimension,
+ * then splits it into slabs, and recursively sorts each slab by the next dimension.
+**/
+- (void)sortRange:(size_t)begin
+              end:(size_t)end
+        dimension:(NSUInteger)dimension
+       dimensions:(NSUInteger)dimensions
+     nodeCapacity:(size_t)nodeCapacity
+{
+	size_t count = end - begin;
+	if (count <= 1) return;
+
+	const double *v = values.data();
+	size_t stride = columnCount;
+	size_t minIdx = dimension * 2;
+
+	// The center of the box, times 2 (which sorts the same)
+
+	std::sort(order.begin() + begin, order.begin() + end, [v, stride, minIdx](uint32_t a, uint32_t b) -> bool {
+
+		const double *boxA = v + (a * stride) + minIdx;
+		const double *boxB = v + (b * stride) + minIdx;
+
+		return (boxA[0] + boxA[1]) < (boxB[0] + boxB[1]);
+	});
+
+	if ((dimension + 1) >= dimensions) return;
+
+	// P = number of leaves, S = number of slabs (in this dimension)
+
+	size_t remainingDimensions = dimensions - dimension;
+
+	size_t leafCount = (count + nodeCapacity - 1) / nodeCapacity;
+	size_t slabCount = (size_t)std::ceil(std::pow((double)leafCount, 1.0 / (double)remainingDimensions));
+	if (slabCount < 1) slabCount = 1;
+
+	size_t leavesPerSlab = (leafCount + slabCount - 1) / slabCount;
+	size_t slabSize = leavesPerSlab * nodeCapacity;
+
+	for (size_t slabBegin = begin; slabBegin < end; slabBegin += slabSize)
+	{
+		size_t slabEnd = std::min(slabBegin + slabSize, end);
+
+		[self sortRange:slabBegin
+		            end:slabEnd
+		      dimension:(dimension + 1)
+		     dimensions:dimensions
+		   nodeCapacity:nodeCapacity];
+	}
+}
+
+- (void)sortWithNodeCapacity:(NSUInteger)nodeCapacity
+{
+	NSUInteger dimensions = columnCount / 2;
+	if (dimensions == 0 || nodeCapacity == 0) return;
+
+	[self sortRange:0 end:order.size() dimension:0 dimensions:dimensions nodeCapacity:nodeCapacity];
+}
+
+- (void)enumerateUsingBlock:(void (^)(int64_t rowid, const double *values, BOOL *stop))block
+{
+	BOOL stop = NO;
+
+	for (uint32_t index : order)
+	{
+		block(rowids[index], values.data() + (index * columnCount), &stop);
+		if (stop) break;
+	}
+}
+
+@end
@@ -13,6 +13,10 @@
 
 #import "sqlite3.h"
 
+#if !defined(_SQLITE3RTREE_H_) && __has_include("sqlite3rtree.h")
+#import "sqlite3rtree.h"
+#endif
+
 /**
  * This version number is stored in the yap2 table.
  * If there is a major re-write to this class, then the version number will be incremented,
@@ -97,8 +101,10 @@
 
 - (sqlite3_stmt *)insertStatement;
 - (sqlite3_stmt *)updateStatement;
+- (sqlite3_stmt *)compareStatement;
 - (sqlite3_stmt *)removeStatement;
 - (sqlite3_stmt *)removeAllStatement;
+- (sqlite3_stmt *)nearestStatement;
 
 @end
 
@@ -135,6 +135,15 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
     return [[YapDatabaseRTreeIndexConnection alloc] initWithParent:self databaseConnection:databaseConnection];
 }
 
+/**
+ * YapDatabaseExtension subclass hook.
+ * Rows outside the allowedCollections are never indexed.
+**/
+- (YapWhitelistBlacklist *)interestedCollections
+{
+    return options.allowedCollections;
+}
+
 - (NSString *)tableName
 {
     return [[self class] tableNameForRegisteredName:self.registeredName];
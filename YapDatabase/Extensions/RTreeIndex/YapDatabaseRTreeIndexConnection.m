@@ -22,12 +22,228 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 #endif
 
+/**
+ * The name of the rtree query function used by the nearestStatement.
+**/
+static NSString *const YapDatabaseRTreeIndexNearestFunctionName = @"yap_rtree_nearest";
+
+NSString *const YapDatabaseRTreeIndexCircleFunctionName  = @"yap_rtree_circle";
+NSString *const YapDatabaseRTreeIndexPolygonFunctionName = @"yap_rtree_polygon";
+
+#ifdef _SQLITE3RTREE_H_
+
+/**
+ * The rtree query callback for nearest neighbour queries.
+ * The parameters are the coordinates of the point (one per dimension).
+ *
+ * The score of every node & entry is its (squared) minimum distance to the point.
+ * The rtree module processes the nodes & entries in order of increasing score (via its priority queue),
+ * so the entries are returned in order of increasing distance,
+ * and only the nodes that may contain the next nearest entry are ever loaded.
+**/
+static int YapDatabaseRTreeIndexNearestQuery(sqlite3_rtree_query_info *info)
+{
+	int dimensions = info->nCoord / 2;
+	if (info->nParam != dimensions) return SQLITE_ERROR;
+
+	double score = 0.0;
+
+	for (int i = 0; i < dimensions; i++)
+	{
+		double point = (double)info->aParam[i];
+		double min = (double)info->aCoord[(i * 2)];
+		double max = (double)info->aCoord[(i * 2) + 1];
+
+		double delta = 0.0;
+		if (point < min)
+			delta = min - point;
+		else if (point > max)
+			delta = point - max;
+
+		score += (delta * delta);
+	}
+
+	info->rScore = score;
+	info->eWithin = (info->iLevel == 0) ? FULLY_WITHIN : PARTLY_WITHIN;
+
+	return SQLITE_OK;
+}
+
+/**
+ * The rtree query callback for yap_rtree_circle(center..., radius).
+ * The parameters are the coordinates of the center (one per dimension), followed by the radius.
+ *
+ * Matches the entries whose box intersects the circle (or sphere, in 3+ dimensions).
+ * Nodes that don't intersect the circle are skipped (along with all their children),
+ * and nodes that are fully within the circle aren't tested further.
+**/
+static int YapDatabaseRTreeIndexCircleQuery(sqlite3_rtree_query_info *info)
+{
+	int dimensions = info->nCoord / 2;
+	if (info->nParam != (dimensions + 1)) return SQLITE_ERROR;
+
+	double radius = (double)info->aParam[dimensions];
+
+	double minDistance = 0.0; // squared distance to the nearest point of the box
+	double maxDistance = 0.0; // squared distance to the farthest corner of the box
+
+	for (int i = 0; i < dimensions; i++)
+	{
+		double center = (double)info->aParam[i];
+		double min = (double)info->aCoord[(i * 2)];
+		double max = (double)info->aCoord[(i * 2) + 1];
+
+		double nearDelta = 0.0;
+		if (center < min)
+			nearDelta = min - center;
+		else if (center > max)
+			nearDelta = center - max;
+
+		double farDelta = MAX(fabs(center - min), fabs(center - max));
+
+		minDistance += (nearDelta * nearDelta);
+		maxDistance += (farDelta * farDelta);
+	}
+
+	double radiusSquared = radius * radius;
+
+	if (minDistance > radiusSquared)
+		info->eWithin = NOT_WITHIN;
+	else if (maxDistance <= radiusSquared)
+		info->eWithin = FULLY_WITHIN;
+	else
+		info->eWithin = PARTLY_WITHIN;
+
+	info->rScore = info->iLevel;
+	return SQLITE_OK;
+}
+
+/**
+ * Returns YES if any part of the segment (x0, y0) -> (x1, y1) is within the box (Liang-Barsky clipping).
+**/
+static BOOL YapDatabaseRTreeIndexSegmentIntersectsBox(double x0, double y0, double x1, double y1,
+                                                      double minX, double maxX, double minY, double maxY)
+{
+	double dx = x1 - x0;
+	double dy = y1 - y0;
+
+	double p[4] = { -dx, dx, -dy, dy };
+	double q[4] = { x0 - minX, maxX - x0, y0 - minY, maxY - y0 };
+
+	double t0 = 0.0;
+	double t1 = 1.0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (p[i] == 0.0)
+		{
+			if (q[i] < 0.0) return NO; // parallel & outside
+		}
+		else
+		{
+			double t = q[i] / p[i];
+
+			if (p[i] < 0.0)
+			{
+				if (t > t1) return NO;
+				if (t > t0) t0 = t;
+			}
+			else
+			{
+				if (t < t0) return NO;
+				if (t < t1) t1 = t;
+			}
+		}
+	}
+
+	return YES;
+}
+
+/**
+ * Returns YES if the point is inside the polygon (even-odd rule).
+ * The vertices are (x, y) pairs.
+**/
+static BOOL YapDatabaseRTreeIndexPolygonContainsPoint(const sqlite3_rtree_dbl *vertices, int vertexCount,
+                                                      double x, double y)
+{
+	BOOL inside = NO;
+
+	for (int i = 0, j = vertexCount - 1; i < vertexCount; j = i++)
+	{
+		double xi = (double)vertices[(i * 2)];
+		double yi = (double)vertices[(i * 2) + 1];
+		double xj = (double)vertices[(j * 2)];
+		double yj = (double)vertices[(j * 2) + 1];
+
+		if (((yi > y) != (yj > y)) && (x < (((xj - xi) * (y - yi)) / (yj - yi)) + xi))
+		{
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+/**
+ * The rtree query callback for yap_rtree_polygon(x1, y1, x2, y2, x3, y3, ...).
+ * The parameters are the vertices of the polygon (at least 3), in the first two dimensions of the rtree.
+ *
+ * Matches the entries whose box intersects the polygon.
+ * Nodes that don't intersect the polygon are skipped (along with all their children),
+ * and nodes that are fully within the polygon aren't tested further.
+**/
+static int YapDatabaseRTreeIndexPolygonQuery(sqlite3_rtree_query_info *info)
+{
+	if (info->nCoord < 4) return SQLITE_ERROR;
+	if ((info->nParam < 6) || ((info->nParam % 2) != 0)) return SQLITE_ERROR;
+
+	const sqlite3_rtree_dbl *vertices = info->aParam;
+	int vertexCount = info->nParam / 2;
+
+	double minX = (double)info->aCoord[0];
+	double maxX = (double)info->aCoord[1];
+	double minY = (double)info->aCoord[2];
+	double maxY = (double)info->aCoord[3];
+
+	info->rScore = info->iLevel;
+
+	// If an edge of the polygon passes through the box, the box is partly within the polygon.
+	// (This includes the case where the polygon is entirely inside the box.)
+
+	for (int i = 0, j = vertexCount - 1; i < vertexCount; j = i++)
+	{
+		if (YapDatabaseRTreeIndexSegmentIntersectsBox((double)vertices[(j * 2)], (double)vertices[(j * 2) + 1],
+		                                              (double)vertices[(i * 2)], (double)vertices[(i * 2) + 1],
+		                                              minX, maxX, minY, maxY))
+		{
+			info->eWithin = PARTLY_WITHIN;
+			return SQLITE_OK;
+		}
+	}
+
+	// Otherwise the box is either entirely inside the polygon, or entirely outside of it.
+
+	if (YapDatabaseRTreeIndexPolygonContainsPoint(vertices, vertexCount, minX, minY))
+		info->eWithin = FULLY_WITHIN;
+	else
+		info->eWithin = NOT_WITHIN;
+
+	return SQLITE_OK;
+}
+
+#endif
+
 @implementation YapDatabaseRTreeIndexConnection
 {
 	sqlite3_stmt *insertStatement;
 	sqlite3_stmt *updateStatement;
+	sqlite3_stmt *compareStatement;
 	sqlite3_stmt *removeStatement;
 	sqlite3_stmt *removeAllStatement;
+	sqlite3_stmt *nearestStatement;
+
+	BOOL hasRegisteredQueryFunctions;
+	BOOL supportsQueryFunctions;
 }
 
 @synthesize rTreeIndex = parent;
@@ -57,8 +273,10 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 {
 	sqlite_finalize_null(&insertStatement);
 	sqlite_finalize_null(&updateStatement);
+	sqlite_finalize_null(&compareStatement);
 	sqlite_finalize_null(&removeStatement);
 	sqlite_finalize_null(&removeAllStatement);
+	sqlite_finalize_null(&nearestStatement);
 }
 
 /**
@@ -77,6 +295,16 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 	}
 }
 
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateCachesWithBlock:(void (^)(NSString *cacheName, YapCache *cache))block
+{
+	if (queryCache) {
+		block(@"queryCache", queryCache);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -175,6 +403,8 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 **/
 - (id)newReadTransaction:(YapDatabaseReadTransaction *)databaseTransaction
 {
+	[self registerQueryFunctionsIfNeeded];
+
 	YapDatabaseRTreeIndexTransaction *transaction =
 	    [[YapDatabaseRTreeIndexTransaction alloc] initWithParentConnection:self
 	                                                   databaseTransaction:databaseTransaction];
@@ -187,6 +417,8 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 **/
 - (id)newReadWriteTransaction:(YapDatabaseReadWriteTransaction *)databaseTransaction
 {
+	[self registerQueryFunctionsIfNeeded];
+
 	YapDatabaseRTreeIndexTransaction *transaction =
 	    [[YapDatabaseRTreeIndexTransaction alloc] initWithParentConnection:self
 	                                                   databaseTransaction:databaseTransaction];
@@ -324,6 +556,38 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 	return *statement;
 }
 
+/**
+ * Returns a single row (if the rowid is in the table) with a single column:
+ * 1 if every column matches the bound value, 0 otherwise.
+ *
+ * The parameters are numbered so they're bound exactly like the insertStatement & updateStatement.
+**/
+- (sqlite3_stmt *)compareStatement
+{
+	sqlite3_stmt **statement = &compareStatement;
+	if (*statement == NULL)
+	{
+		NSMutableString *string = [NSMutableString stringWithCapacity:100];
+		[string appendString:@"SELECT "];
+
+		int bind_idx = SQLITE_BIND_START + 1;
+		for (NSString *columnName in parent->setup)
+		{
+			if (bind_idx > (SQLITE_BIND_START + 1))
+				[string appendString:@" AND "];
+
+			[string appendFormat:@"(\"%@\" IS ?%d)", columnName, bind_idx];
+			bind_idx++;
+		}
+
+		[string appendFormat:@" FROM \"%@\" WHERE \"rowid\" = ?%d;", [parent tableName], SQLITE_BIND_START];
+
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+
+	return *statement;
+}
+
 - (sqlite3_stmt *)removeStatement
 {
 	sqlite3_stmt **statement = &removeStatement;
@@ -352,4 +616,98 @@ static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
 	return *statement;
 }
 
+/**
+ * Registers the rtree query functions (yap_rtree_nearest, yap_rtree_circle & yap_rtree_polygon)
+ * with the sqlite connection. This only needs to be done once per connection,
+ * but it has to be done before any statement that uses the functions is prepared.
+ *
+ * Rtree query callbacks require sqlite 3.8.5+.
+**/
+- (void)registerQueryFunctionsIfNeeded
+{
+	if (hasRegisteredQueryFunctions) return;
+	hasRegisteredQueryFunctions = YES;
+
+#ifdef _SQLITE3RTREE_H_
+
+	if (sqlite3_libversion_number() < 3008005)
+	{
+		YDBLogVerbose(@"%@: Rtree query functions require sqlite 3.8.5 or later (current version: %s)",
+		              THIS_METHOD, sqlite3_libversion());
+		return;
+	}
+
+	sqlite3 *db = databaseConnection->db;
+
+	NSArray<NSString *> *names = @[
+	  YapDatabaseRTreeIndexNearestFunctionName,
+	  YapDatabaseRTreeIndexCircleFunctionName,
+	  YapDatabaseRTreeIndexPolygonFunctionName
+	];
+	int (*callbacks[3])(sqlite3_rtree_query_info *) = {
+	  YapDatabaseRTreeIndexNearestQuery,
+	  YapDatabaseRTreeIndexCircleQuery,
+	  YapDatabaseRTreeIndexPolygonQuery
+	};
+
+	for (NSUInteger i = 0; i < [names count]; i++)
+	{
+		int status = sqlite3_rtree_query_callback(db, [names[i] UTF8String], callbacks[i], NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error registering rtree query function (%@): %d %s",
+			            THIS_METHOD, names[i], status, sqlite3_errmsg(db));
+			return;
+		}
+	}
+
+	supportsQueryFunctions = YES;
+
+#endif
+}
+
+/**
+ * Returns the rowid & every column (in setup order) of the entries nearest to the point,
+ * in order of increasing distance.
+ *
+ * The parameters are the coordinates of the point (one per dimension), followed by the limit.
+**/
+- (sqlite3_stmt *)nearestStatement
+{
+	sqlite3_stmt **statement = &nearestStatement;
+	if (*statement == NULL)
+	{
+		[self registerQueryFunctionsIfNeeded];
+		if (!supportsQueryFunctions)
+		{
+			YDBLogError(@"%@: Nearest neighbour queries require rtree query callbacks (sqlite 3.8.5+)", THIS_METHOD);
+			return NULL;
+		}
+
+		NSMutableString *string = [NSMutableString stringWithCapacity:100];
+		[string appendString:@"SELECT \"rowid\""];
+
+		for (NSString *columnName in parent->setup)
+		{
+			[string appendFormat:@", \"%@\"", columnName];
+		}
+
+		[string appendFormat:@" FROM \"%@\" WHERE \"rowid\" MATCH %@(",
+		  [parent tableName], YapDatabaseRTreeIndexNearestFunctionName];
+
+		NSUInteger dimensions = [parent->setup count] / 2;
+		NSUInteger i;
+		for (i = 0; i < dimensions; i++)
+		{
+			[string appendString:(i == 0) ? @"?" : @", ?"];
+		}
+
+		[string appendString:@") LIMIT ?;"];
+
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+
+	return *statement;
+}
+
 @end
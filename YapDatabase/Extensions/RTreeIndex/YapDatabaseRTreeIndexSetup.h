@@ -12,4 +12,17 @@
 - (NSUInteger)count;
 - (NSArray *)columnNames;
 
+/**
+ * If YES, the table is created as an "rtree_i32" table, which stores the coordinates as 32-bit integers.
+ * If NO, the table is a (regular) "rtree" table, which stores the coordinates as 32-bit floats.
+ *
+ * Integer coordinates are exact (e.g. tile coordinates), whereas floats have only 24 bits of precision.
+ * Both use the same amount of space per coordinate.
+ * The values must fit in an int32. Non-integral values are rounded outward
+ * (the min columns down, the max columns up), so the boxes are never smaller than specified.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL usesIntegerCoordinates;
+
 @end
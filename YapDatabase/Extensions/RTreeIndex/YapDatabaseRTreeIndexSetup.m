@@ -25,6 +25,8 @@
 	NSMutableArray *setup;
 }
 
+@synthesize usesIntegerCoordinates = usesIntegerCoordinates;
+
 - (id)init
 {
 	return [self initWithCapacity:0];
@@ -136,6 +138,7 @@
 {
 	YapDatabaseRTreeIndexSetup *copy = [[YapDatabaseRTreeIndexSetup alloc] initForCopy];
 	copy->setup = [setup mutableCopy];
+	copy->usesIntegerCoordinates = usesIntegerCoordinates;
 
 	return copy;
 }
@@ -160,6 +163,8 @@
 		return NO;
 	}
 
+	NSString *affinity = usesIntegerCoordinates ? @"INT" : @"REAL";
+
 	for (NSString *columnName in setup)
 	{
 		NSString *existingAffinity = [columns objectForKey:columnName];
@@ -169,7 +174,7 @@
 		}
 		else
 		{
-            if ([existingAffinity caseInsensitiveCompare:@"REAL"] != NSOrderedSame)
+            if ([existingAffinity caseInsensitiveCompare:affinity] != NSOrderedSame)
                 return NO;
 		}
 	}
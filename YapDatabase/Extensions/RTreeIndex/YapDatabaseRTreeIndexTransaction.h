@@ -5,6 +5,29 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * The names of the rtree query functions (geometry callbacks) that can be used within queries.
+ * They're registered with every connection that uses the extension (requires sqlite 3.8.5+).
+ *
+ * yap_rtree_circle(center..., radius)
+ *   Matches the rows whose box intersects the circle (or sphere, in 3+ dimensions).
+ *   The parameters are the coordinates of the center (one per dimension), followed by the radius.
+ *
+ * yap_rtree_polygon(x1, y1, x2, y2, x3, y3, ...)
+ *   Matches the rows whose box intersects the polygon (in the first two dimensions).
+ *   The parameters are the vertices of the polygon (at least 3).
+ *
+ * For example:
+ *
+ * query = [YapDatabaseQuery queryWithFormat:@"WHERE rowid MATCH yap_rtree_circle(?, ?, ?)", @(x), @(y), @(radius)];
+ *
+ * The filtering is done during the traversal of the rtree:
+ * Nodes outside the shape are skipped (along with all their children),
+ * rather than fetching everything within the bounding box of the shape, and filtering it afterwards.
+**/
+extern NSString *const YapDatabaseRTreeIndexCircleFunctionName;  // yap_rtree_circle
+extern NSString *const YapDatabaseRTreeIndexPolygonFunctionName; // yap_rtree_polygon
+
 @interface YapDatabaseRTreeIndexTransaction : YapDatabaseExtensionTransaction
 
 /**
@@ -50,6 +73,50 @@ NS_ASSUME_NONNULL_BEGIN
 - (BOOL)enumerateRowsMatchingQuery:(YapDatabaseQuery *)query
                         usingBlock:
                             (void (^)(NSString *collection, NSString *key, id object, _Nullable id metadata, BOOL *stop))block;
+
+/**
+ * These methods enumerate the (up to) limit rows nearest to the given point, in order of increasing distance.
+ *
+ * The point has one coordinate per dimension, in the order of the setup columns.
+ * For example, if the setup columns are @[ @"minLon", @"maxLon", @"minLat", @"maxLat" ]:
+ *
+ * [[transaction ext:@"idx"] enumerateKeysNearestToPoint:@[ @(lon), @(lat) ]
+ *                                                 limit:10
+ *                                            usingBlock:^(NSString *collection, NSString *key, double distance, BOOL *stop) {
+ *
+ *     // ...
+ * }];
+ *
+ * The distance is the euclidean distance (in the units of the columns) from the point to the nearest edge
+ * of the row's box, and is zero if the point is inside the box.
+ *
+ * The search is a best-first traversal of the rtree (via an rtree query callback):
+ * Only the nodes that may contain the next nearest row are read,
+ * so the cost depends on the limit rather than the size of the index.
+ * Requires sqlite 3.8.5 or later.
+ *
+ * @return NO if the point doesn't match the setup, or if there was a problem with the query. YES otherwise.
+**/
+
+- (BOOL)enumerateKeysNearestToPoint:(NSArray<NSNumber *> *)point
+                              limit:(NSUInteger)limit
+                         usingBlock:(void (^)(NSString *collection, NSString *key, double distance, BOOL *stop))block;
+
+- (BOOL)enumerateKeysAndMetadataNearestToPoint:(NSArray<NSNumber *> *)point
+                                         limit:(NSUInteger)limit
+                                    usingBlock:
+          (void (^)(NSString *collection, NSString *key, _Nullable id metadata, double distance, BOOL *stop))block;
+
+- (BOOL)enumerateKeysAndObjectsNearestToPoint:(NSArray<NSNumber *> *)point
+                                        limit:(NSUInteger)limit
+                                   usingBlock:
+                    (void (^)(NSString *collection, NSString *key, id object, double distance, BOOL *stop))block;
+
+- (BOOL)enumerateRowsNearestToPoint:(NSArray<NSNumber *> *)point
+                              limit:(NSUInteger)limit
+                         usingBlock:
+(void (^)(NSString *collection, NSString *key, id object, _Nullable id metadata, double distance, BOOL *stop))block;
+
 /**
  * Skips the enumeration process, and just gives you the count of matching rows.
 **/
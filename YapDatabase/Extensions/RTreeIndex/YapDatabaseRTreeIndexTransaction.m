@@ -1,9 +1,11 @@
 #import "YapDatabaseRTreeIndexTransaction.h"
 #import "YapDatabaseRTreeIndexPrivate.h"
+#import "YapDatabaseRTreeIndexBulkLoad.h"
 #import "YapDatabaseStatement.h"
 
 #import "YapDatabasePrivate.h"
 #import "YapDatabaseExtensionPrivate.h"
+#import "YapDatabaseQueryPrivate.h"
 
 #import "YapDatabaseLogging.h"
 
@@ -215,13 +217,19 @@ static NSString *const ext_key_version_deprecated = @"version";
 	YDBLogVerbose(@"Creating rtree index table for registeredName(%@): %@", [self registeredName], tableName);
 
 	// CREATE TABLE  IF NOT EXISTS "tableName" ("rowid" INTEGER PRIMARY KEY, index1, index2...);
+	//
+	// Integer setups use the rtree_i32 module (with INT columns).
+
+	NSString *module = setup.usesIntegerCoordinates ? @"rtree_i32" : @"rtree";
+	NSString *affinity = setup.usesIntegerCoordinates ? @"INT" : @"REAL";
 
 	NSMutableString *createTable = [NSMutableString stringWithCapacity:100];
-	[createTable appendFormat:@"CREATE VIRTUAL TABLE IF NOT EXISTS \"%@\" USING rtree(\"rowid\" INTEGER PRIMARY KEY", tableName];
+	[createTable appendFormat:@"CREATE VIRTUAL TABLE IF NOT EXISTS \"%@\" USING %@(\"rowid\" INTEGER PRIMARY KEY",
+	  tableName, module];
 
 	for (NSString *columnName in setup)
 	{
-        [createTable appendFormat:@", \"%@\" REAL", columnName];
+        [createTable appendFormat:@", \"%@\" %@", columnName, affinity];
 	}
 
 	[createTable appendString:@");"];
@@ -240,8 +248,12 @@ static NSString *const ext_key_version_deprecated = @"version";
 /**
  * Internal method.
  *
- * This method is called, if needed, to populate the FTS indexes.
- * It does so by enumerating the rows in the database, and invoking the usual blocks and insertion methods.
+ * This method is called, if needed, to populate the rtree index.
+ * It does so by enumerating the rows in the database, and invoking the usual blocks.
+ *
+ * Rather than inserting the boxes in rowid order, they're collected first, and then inserted in STR order.
+ * This way consecutive inserts land in the same (or neighboring) nodes, which makes the build faster,
+ * and produces a well clustered tree (with much less overlap between the nodes) for the queries.
 **/
 - (BOOL)populate
 {
@@ -258,6 +270,9 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 	__unsafe_unretained YapDatabaseRTreeIndexHandler *handler = rTreeIndex->handler;
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = rTreeIndex->options.allowedCollections;
+
+	YapDatabaseRTreeIndexBulkLoad *bulkLoad =
+	  [[YapDatabaseRTreeIndexBulkLoad alloc] initWithColumnCount:[rTreeIndex->setup count]];
 	
 	if (handler->blockType == YapDatabaseBlockTypeWithKey)
 	{
@@ -271,7 +286,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 			if ([parentConnection->blockDict count] > 0)
 			{
-				[self addRowid:rowid isNew:YES];
+				[self addRowid:rowid toBulkLoad:bulkLoad];
 				[parentConnection->blockDict removeAllObjects];
 			}
 		};
@@ -303,7 +318,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 			if ([parentConnection->blockDict count] > 0)
 			{
-				[self addRowid:rowid isNew:YES];
+				[self addRowid:rowid toBulkLoad:bulkLoad];
 				[parentConnection->blockDict removeAllObjects];
 			}
 		};
@@ -336,7 +351,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 			if ([parentConnection->blockDict count] > 0)
 			{
-				[self addRowid:rowid isNew:YES];
+				[self addRowid:rowid toBulkLoad:bulkLoad];
 				[parentConnection->blockDict removeAllObjects];
 			}
 		};
@@ -369,7 +384,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 			if ([parentConnection->blockDict count] > 0)
 			{
-				[self addRowid:rowid isNew:YES];
+				[self addRowid:rowid toBulkLoad:bulkLoad];
 				[parentConnection->blockDict removeAllObjects];
 			}
 		};
@@ -390,11 +405,101 @@ static NSString *const ext_key_version_deprecated = @"version";
 		}
 	}
 
+	[bulkLoad sortWithNodeCapacity:[self nodeCapacity]];
+	[self insertBulkLoad:bulkLoad];
+
 	return YES;
 	
 #pragma clang diagnostic pop
 }
 
+/**
+ * The (maximum) number of cells per rtree node, using the same formula as sqlite:
+ * a node is (page_size - 64) bytes, with a 4 byte header,
+ * and each cell is a 64-bit rowid plus a pair of 32-bit floats per dimension. (At most 51 cells.)
+**/
+- (NSUInteger)nodeCapacity
+{
+	NSUInteger dimensions = [parentConnection->parent->setup count] / 2;
+	if (dimensions == 0) return 0;
+
+	int64_t pageSize = [YapDatabase pragma:@"page_size" using:databaseTransaction->connection->db];
+	if (pageSize <= 128) pageSize = 4096;
+
+	NSUInteger cellSize = 8 + (dimensions * 2 * 4);
+	NSUInteger capacity = (NSUInteger)(pageSize - 64 - 4) / cellSize;
+
+	return MIN(capacity, (NSUInteger)51);
+}
+
+/**
+ * Adds the box (from the values in the 'blockDict' ivar) to the bulk load.
+**/
+- (void)addRowid:(int64_t)rowid toBulkLoad:(YapDatabaseRTreeIndexBulkLoad *)bulkLoad
+{
+	NSUInteger columnCount = [parentConnection->parent->setup count];
+	double values[MAX(columnCount, (NSUInteger)1)];
+
+	if ([self getColumnValues:values])
+	{
+		[bulkLoad addRowid:rowid values:values];
+	}
+}
+
+/**
+ * Inserts every box of the bulk load (in its order) into the table.
+**/
+- (void)insertBulkLoad:(YapDatabaseRTreeIndexBulkLoad *)bulkLoad
+{
+	if ([bulkLoad count] == 0) return;
+
+	sqlite3_stmt *statement = [parentConnection insertStatement];
+	if (statement == NULL)
+		return;
+
+	sqlite3 *db = databaseTransaction->connection->db;
+
+	// INSERT INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+
+	[bulkLoad enumerateUsingBlock:^(int64_t rowid, const double *values, BOOL __unused *stop) {
+
+		[self bindRowid:rowid values:values toStatement:statement];
+
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'insertStatement': %d %s", status, sqlite3_errmsg(db));
+		}
+
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+	}];
+
+	[parentConnection->mutationStack markAsMutated];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Bulk Load
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+**/
+- (BOOL)supportsBulkLoad
+{
+	return YES;
+}
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+ *
+ * Repopulates the rtree, which inserts every box in STR order (see populate).
+**/
+- (BOOL)rebuildAfterBulkLoad
+{
+	return [self populate];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -430,28 +535,18 @@ static NSString *const ext_key_version_deprecated = @"version";
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Adds a row to the table, using the given rowid along with the values in the 'blockDict' ivar.
+ * Extracts the column values (in setup order) from the 'blockDict' ivar.
+ * The values array must have room for one value per column.
+ *
+ * For integer setups, the values are rounded outward (like the rtree module does for floats),
+ * so the stored box is never smaller than the given box.
+ *
+ * Returns NO if a column value is missing or isn't a number.
 **/
-- (void)addRowid:(int64_t)rowid isNew:(BOOL)isNew
+- (BOOL)getColumnValues:(double *)values
 {
-	YDBLogAutoTrace();
-
-	sqlite3_stmt *statement = NULL;
-	if (isNew)
-		statement = [parentConnection insertStatement];
-	else
-		statement = [parentConnection updateStatement];
-
-	if (statement == NULL)
-		return;
-
-	//  isNew : INSERT            INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
-	// !isNew : INSERT OR REPLACE INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
-
-	int bind_idx = SQLITE_BIND_START;
-
-	sqlite3_bind_int64(statement, bind_idx, rowid);
-	bind_idx++;
+	BOOL usesIntegerCoordinates = parentConnection->parent->setup.usesIntegerCoordinates;
+	NSUInteger i = 0;
 
 	for (NSString *columnName in parentConnection->parent->setup)
 	{
@@ -462,26 +557,139 @@ static NSString *const ext_key_version_deprecated = @"version";
             {
                 __unsafe_unretained NSNumber *cast = (NSNumber *)columnValue;
 
-                double num = [cast doubleValue];
-                sqlite3_bind_double(statement, bind_idx, num);
+                values[i] = [cast doubleValue];
+
+                if (usesIntegerCoordinates)
+                {
+                    // Columns alternate: min, max, min, max, ...
+                    values[i] = ((i % 2) == 0) ? floor(values[i]) : ceil(values[i]);
+                }
             }
             else
             {
                 YDBLogWarn(@"Unable to bind value for column(name=%@, type=real) with unsupported class: %@."
                            @" Column requires NSNumber.",
                            columnName, NSStringFromClass([columnValue class]));
-                return;
+                return NO;
             }
 		}
         else {
             YDBLogWarn(@"Unable to find value for column(name=%@, type=real)."
                        @" Column required.",
                        columnName);
-            return;
+            return NO;
         }
 
+		i++;
+	}
+
+	return YES;
+}
+
+/**
+ * Binds the given rowid, followed by one parameter per column (in setup order), to the given statement.
+**/
+- (void)bindRowid:(int64_t)rowid values:(const double *)values toStatement:(sqlite3_stmt *)statement
+{
+	int bind_idx = SQLITE_BIND_START;
+
+	sqlite3_bind_int64(statement, bind_idx, rowid);
+	bind_idx++;
+
+	NSUInteger columnCount = [parentConnection->parent->setup count];
+
+	for (NSUInteger i = 0; i < columnCount; i++)
+	{
+		sqlite3_bind_double(statement, bind_idx, values[i]);
 		bind_idx++;
 	}
+}
+
+/**
+ * Binds the given rowid, along with the values in the 'blockDict' ivar, to the given statement.
+ * The rowid is bound to the first parameter, followed by one parameter per column (in setup order).
+ *
+ * Returns NO if a column value is missing or isn't a number.
+**/
+- (BOOL)bindRowid:(int64_t)rowid toStatement:(sqlite3_stmt *)statement
+{
+	NSUInteger columnCount = [parentConnection->parent->setup count];
+	double values[MAX(columnCount, (NSUInteger)1)];
+
+	if (![self getColumnValues:values])
+		return NO;
+
+	[self bindRowid:rowid values:values toStatement:statement];
+	return YES;
+}
+
+/**
+ * Returns YES if the table already contains a row for the given rowid,
+ * and every column of that row matches the values in the 'blockDict' ivar.
+**/
+- (BOOL)isUnchangedRowid:(int64_t)rowid
+{
+	sqlite3_stmt *statement = [parentConnection compareStatement];
+	if (statement == NULL)
+		return NO;
+
+	// SELECT ("column1" IS ?2) AND ("column2" IS ?3) ... FROM "tableName" WHERE "rowid" = ?1;
+
+	BOOL isUnchanged = NO;
+
+	if ([self bindRowid:rowid toStatement:statement])
+	{
+		int status = sqlite3_step(statement);
+		if (status == SQLITE_ROW)
+		{
+			isUnchanged = (sqlite3_column_int(statement, SQLITE_COLUMN_START) != 0);
+		}
+		else if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'compareStatement': %d %s",
+			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		}
+	}
+
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+
+	return isUnchanged;
+}
+
+/**
+ * Adds a row to the table, using the given rowid along with the values in the 'blockDict' ivar.
+ *
+ * When updating an existing row, the write is skipped if none of the values changed.
+ * (The rtree stores 32-bit floats, so values that a float can't represent exactly are always rewritten.)
+**/
+- (void)addRowid:(int64_t)rowid isNew:(BOOL)isNew
+{
+	YDBLogAutoTrace();
+
+	if (!isNew && [self isUnchangedRowid:rowid])
+	{
+		return;
+	}
+
+	sqlite3_stmt *statement = NULL;
+	if (isNew)
+		statement = [parentConnection insertStatement];
+	else
+		statement = [parentConnection updateStatement];
+
+	if (statement == NULL)
+		return;
+
+	//  isNew : INSERT            INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	// !isNew : INSERT OR REPLACE INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+
+	if (![self bindRowid:rowid toStatement:statement])
+	{
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		return;
+	}
 
 	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
@@ -674,7 +882,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 	__unsafe_unretained NSString *key = collectionKey.key;
 
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = rTreeIndex->options.allowedCollections;
-	if (allowedCollections && ![allowedCollections isAllowed:collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -951,7 +1159,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 	__unsafe_unretained YapDatabaseRTreeIndex *rTreeIndex = parentConnection->parent;
 
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = rTreeIndex->options.allowedCollections;
-	if (allowedCollections && ![allowedCollections isAllowed:collectionKey.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -999,7 +1207,12 @@ static NSString *const ext_key_version_deprecated = @"version";
 	// Create full query using given filtering clause(s)
 
 	NSString *fullQueryString =
-	    [NSString stringWithFormat:@"SELECT \"rowid\" FROM \"%@\" %@;", [self tableName], query.queryString];
+	  [query fullQueryStringForKind:@"YapDatabaseRTreeIndex.rowid"
+	                 registeredName:[self registeredName]
+	                     usingBlock:^NSString *{
+		
+		return [NSString stringWithFormat:@"SELECT \"rowid\" FROM \"%@\" %@;", [self tableName], query.queryString];
+	}];
 
 	// Turn query into compiled sqlite statement.
 	// Use cache if possible.
@@ -1083,8 +1296,11 @@ static NSString *const ext_key_version_deprecated = @"version";
 	BOOL stop = NO;
 	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
 
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+
 	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
 	{
 		int64_t rowid = sqlite3_column_int64(statement, SQLITE_COLUMN_START);
 
@@ -1102,6 +1318,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 
+	if (YapDatabaseQueryProfileIsSlow(&profile)) {
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, query.queryParameters, [self registeredName]);
+	}
+
 	if (!stop && mutation.isMutated)
 	{
 		@throw [self mutationDuringEnumerationException];
@@ -1184,6 +1404,181 @@ static NSString *const ext_key_version_deprecated = @"version";
 	return result;
 }
 
+/**
+ * Enumerates (up to limit) rowids nearest to the given point, in order of increasing distance.
+ * The distance is the (euclidean) distance from the point to the nearest edge of the box (zero if inside the box).
+**/
+- (BOOL)_enumerateRowidsNearestToPoint:(NSArray<NSNumber *> *)point
+                                 limit:(NSUInteger)limit
+                            usingBlock:(void (^)(int64_t rowid, double distance, BOOL *stop))block
+{
+	NSUInteger columnCount = [parentConnection->parent->setup count];
+	NSUInteger dimensions = columnCount / 2;
+
+	if ([point count] != dimensions)
+	{
+		YDBLogWarn(@"%@: The point has %lu coordinates, but the rtree has %lu dimensions",
+		           THIS_METHOD, (unsigned long)[point count], (unsigned long)dimensions);
+		return NO;
+	}
+
+	if (limit == 0) return YES;
+
+	sqlite3_stmt *statement = [parentConnection nearestStatement];
+	if (statement == NULL) return NO;
+
+	double coordinates[MAX(dimensions, (NSUInteger)1)];
+
+	int bind_idx = SQLITE_BIND_START;
+	NSUInteger i = 0;
+
+	for (NSNumber *coordinate in point)
+	{
+		coordinates[i] = [coordinate doubleValue];
+		sqlite3_bind_double(statement, bind_idx, coordinates[i]);
+
+		bind_idx++;
+		i++;
+	}
+
+	sqlite3_bind_int64(statement, bind_idx, (sqlite3_int64)MIN(limit, (NSUInteger)INT64_MAX));
+
+	// Enumerate query results
+
+	BOOL stop = NO;
+	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
+
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, SQLITE_COLUMN_START);
+
+		double distanceSquared = 0.0;
+
+		for (i = 0; i < dimensions; i++)
+		{
+			int column_idx = SQLITE_COLUMN_START + 1 + (int)(i * 2);
+
+			double min = sqlite3_column_double(statement, column_idx);
+			double max = sqlite3_column_double(statement, column_idx + 1);
+
+			double delta = 0.0;
+			if (coordinates[i] < min)
+				delta = min - coordinates[i];
+			else if (coordinates[i] > max)
+				delta = coordinates[i] - max;
+
+			distanceSquared += (delta * delta);
+		}
+
+		block(rowid, sqrt(distanceSquared), &stop);
+
+		if (stop || mutation.isMutated) break;
+	}
+
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+
+	return (status == SQLITE_DONE);
+}
+
+- (BOOL)enumerateKeysNearestToPoint:(NSArray<NSNumber *> *)point
+                              limit:(NSUInteger)limit
+                         usingBlock:(void (^)(NSString *collection, NSString *key, double distance, BOOL *stop))block
+{
+	if (point == nil) return NO;
+	if (block == nil) return NO;
+
+	BOOL result = [self _enumerateRowidsNearestToPoint:point
+	                                             limit:limit
+	                                        usingBlock:^(int64_t rowid, double distance, BOOL *stop)
+	{
+		YapCollectionKey *ck = [self->databaseTransaction collectionKeyForRowid:rowid];
+
+		block(ck.collection, ck.key, distance, stop);
+	}];
+
+	return result;
+}
+
+- (BOOL)enumerateKeysAndMetadataNearestToPoint:(NSArray<NSNumber *> *)point
+                                         limit:(NSUInteger)limit
+                                    usingBlock:
+                    (void (^)(NSString *collection, NSString *key, id metadata, double distance, BOOL *stop))block
+{
+	if (point == nil) return NO;
+	if (block == nil) return NO;
+
+	BOOL result = [self _enumerateRowidsNearestToPoint:point
+	                                             limit:limit
+	                                        usingBlock:^(int64_t rowid, double distance, BOOL *stop)
+	{
+		YapCollectionKey *ck = nil;
+		id metadata = nil;
+		[self->databaseTransaction getCollectionKey:&ck metadata:&metadata forRowid:rowid];
+
+		block(ck.collection, ck.key, metadata, distance, stop);
+	}];
+
+	return result;
+}
+
+- (BOOL)enumerateKeysAndObjectsNearestToPoint:(NSArray<NSNumber *> *)point
+                                        limit:(NSUInteger)limit
+                                   usingBlock:
+                    (void (^)(NSString *collection, NSString *key, id object, double distance, BOOL *stop))block
+{
+	if (point == nil) return NO;
+	if (block == nil) return NO;
+
+	BOOL result = [self _enumerateRowidsNearestToPoint:point
+	                                             limit:limit
+	                                        usingBlock:^(int64_t rowid, double distance, BOOL *stop)
+	{
+		YapCollectionKey *ck = nil;
+		id object = nil;
+		[self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
+
+		block(ck.collection, ck.key, object, distance, stop);
+	}];
+
+	return result;
+}
+
+- (BOOL)enumerateRowsNearestToPoint:(NSArray<NSNumber *> *)point
+                              limit:(NSUInteger)limit
+                         usingBlock:
+        (void (^)(NSString *collection, NSString *key, id object, id metadata, double distance, BOOL *stop))block
+{
+	if (point == nil) return NO;
+	if (block == nil) return NO;
+
+	BOOL result = [self _enumerateRowidsNearestToPoint:point
+	                                             limit:limit
+	                                        usingBlock:^(int64_t rowid, double distance, BOOL *stop)
+	{
+		YapCollectionKey *ck = nil;
+		id object = nil;
+		id metadata = nil;
+		[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
+
+		block(ck.collection, ck.key, object, metadata, distance, stop);
+	}];
+
+	return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Count
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1193,8 +1588,13 @@ static NSString *const ext_key_version_deprecated = @"version";
 	// Create full query using given filtering clause(s)
 
 	NSString *fullQueryString =
-	    [NSString stringWithFormat:@"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" %@;",
-	                                                           [self tableName], query.queryString];
+	  [query fullQueryStringForKind:@"YapDatabaseRTreeIndex.count"
+	                 registeredName:[self registeredName]
+	                     usingBlock:^NSString *{
+		
+		return [NSString stringWithFormat:@"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" %@;",
+		                                                         [self tableName], query.queryString];
+	}];
 
 	// Turn query into compiled sqlite statement.
 	// Use cache if possible.
@@ -1278,7 +1678,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	BOOL result = YES;
 	NSUInteger count = 0;
 
-	int status = sqlite3_step(statement);
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+
+	int status = YapDatabaseQueryProfileStep(&profile, statement);
 	if (status == SQLITE_ROW)
 	{
 		count = (NSUInteger)sqlite3_column_int64(statement, SQLITE_COLUMN_START);
@@ -1293,6 +1696,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 
+	if (YapDatabaseQueryProfileIsSlow(&profile)) {
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, query.queryParameters, [self registeredName]);
+	}
+
 	if (countPtr) *countPtr = count;
 	return result;
 }
@@ -28,6 +28,7 @@
 static NSString *const ext_key_classVersion       = @"classVersion";
 static NSString *const ext_key_versionTag         = @"versionTag";
 static NSString *const ext_key_version_deprecated = @"version";
+static NSString *const ext_key_internEdgeNames    = @"internEdgeNames";
 
 /**
  * Keys for changeset dictionary.
@@ -35,6 +36,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 static NSString *const changeset_key_deletedEdges  = @"deletedEdges";
 static NSString *const changeset_key_modifiedEdges = @"modifiedEdges";
+static NSString *const changeset_key_changedSources = @"changedSources";
 static NSString *const changeset_key_reset         = @"reset";
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -49,13 +51,36 @@ static NSString *const changeset_key_reset         = @"reset";
 }
 
 - (NSString *)tableName;
+- (NSString *)namesTableName;
+- (NSString *)filesTableName;
 
 /**
- * The dispatch queue for performing file deletion operations.
- * Note: This method is not thread-safe, as it expects to only be invoked from within a read-write transaction.
+ * SQL snippets for the "name" column of the edge table.
+ *
+ * If options.internEdgeNames is enabled, the "name" column stores the id of the name (in the names table).
+ * So the name needs to be translated, both when reading the column, and when binding a name parameter.
+ *
+ * edgeNameColumn    - use in place of "name" within a result column list
+ * edgeNameParameter - use in place of the "?" for a (bound) name, e.g. WHERE "name" = ?, or INSERT ... VALUES (?)
+**/
+- (NSString *)edgeNameColumn;
+- (NSString *)edgeNameParameter;
+
+/**
+ * The (serial) dispatch queue for performing file deletion operations.
+ * The queue uses the QoS class of options.fileDeletionQualityOfService.
 **/
 - (dispatch_queue_t)fileManagerQueue;
 
+/**
+ * Queues the files for deletion (after a commit).
+ * The files must already be stored in the files table (the list of files pending deletion).
+ *
+ * The files are deleted in batches on the fileManagerQueue, according to the options.
+ * After each batch, the files are removed from the files table.
+**/
+- (void)deleteFiles:(NSSet<NSURL *> *)fileURLs;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -67,6 +92,12 @@ static NSString *const changeset_key_reset         = @"reset";
 	
 	BOOL disableYapDatabaseRelationshipNodeProtocol;
 	YapWhitelistBlacklist *allowedCollections;
+	BOOL internEdgeNames;
+	NSUInteger edgeCacheLimit;
+	NSUInteger fileDeletionBatchSize;
+	NSUInteger fileDeletionConcurrency;
+	NSQualityOfService fileDeletionQualityOfService;
+	YapDatabaseRelationshipFileDeletionDeferral fileDeletionDeferral;
 }
 
 @end
@@ -86,6 +117,7 @@ static NSString *const changeset_key_reset         = @"reset";
 	__unsafe_unretained YapDatabaseConnection *databaseConnection;
 	
 	YapCache<NSNumber*, YapDatabaseRelationshipEdge*> *edgeCache;                // key:edgeRowid, value:edge
+	YapCache<NSNumber*, NSMutableDictionary*> *adjacencyCache;                   // key:srcRowid, value:(see below)
 	
 	NSMutableDictionary<NSNumber*, NSMutableArray*> *protocolChanges;            // key:srcRowid, value:edges
 	NSMutableDictionary<NSString*, NSMutableArray*> *manualChanges;              // key:edgeName, value:edges
@@ -99,6 +131,7 @@ static NSString *const changeset_key_reset         = @"reset";
 	
 	NSMutableSet<NSNumber *> *deletedEdges;                                      // values:edgeRowid
 	NSMutableDictionary<NSNumber*, YapDatabaseRelationshipEdge*> *modifiedEdges; // key:edgeRowid, value:edge
+	NSMutableSet<NSNumber *> *changedSources;                                    // values:srcRowid
 	
 	NSMutableSet<NSURL *> *filesToDelete;
 }
@@ -108,13 +141,25 @@ static NSString *const changeset_key_reset         = @"reset";
 - (void)postCommitCleanup;
 - (void)postRollbackCleanup;
 
-- (sqlite3_stmt *)findEdgesWithNodeStatement;
+/**
+ * The adjacencyCache stores the rowids of the edges (on disk) for recently enumerated source nodes.
+ * That is, for each srcRowid: a dictionary with key:edgeName (or NSNull for all names), value:edgeRowids.
+ * An empty array is a negative entry (the node has no such edges).
+ *
+ * The entries are invalidated per source node:
+ * whenever an edge is inserted or deleted (on disk) by this connection, or by a changeset from another connection.
+**/
+- (NSArray<NSNumber *> *)cachedEdgeRowidsWithSource:(int64_t)srcRowid name:(NSString *)name;
+- (void)setCachedEdgeRowids:(NSArray<NSNumber *> *)edgeRowids withSource:(int64_t)srcRowid name:(NSString *)name;
+
+- (void)didChangeEdgesWithSource:(int64_t)srcRowid;
+
 - (sqlite3_stmt *)findManualEdgeWithDstStatement;
 - (sqlite3_stmt *)findManualEdgeWithDstFileURLStatement;
+- (sqlite3_stmt *)internEdgeNameStatement;
 - (sqlite3_stmt *)insertEdgeStatement;
 - (sqlite3_stmt *)updateEdgeStatement;
 - (sqlite3_stmt *)deleteEdgeStatement;
-- (sqlite3_stmt *)deleteEdgesWithNodeStatement;
 - (sqlite3_stmt *)enumerateDstFileURLWithSrcStatement:(BOOL *)needsFinalizePtr;
 - (sqlite3_stmt *)enumerateDstFileURLWithSrcNameStatement:(BOOL *)needsFinalizePtr;
 - (sqlite3_stmt *)enumerateDstFileURLWithNameStatement:(BOOL *)needsFinalizePtr;
@@ -138,6 +183,8 @@ static NSString *const changeset_key_reset         = @"reset";
 - (sqlite3_stmt *)countForSrcDstNameStatement;
 - (sqlite3_stmt *)removeAllStatement;
 - (sqlite3_stmt *)removeAllProtocolStatement;
+- (sqlite3_stmt *)insertFileStatement;
+- (sqlite3_stmt *)removeFileStatement;
 
 @end
 
@@ -155,4 +202,11 @@ static NSString *const changeset_key_reset         = @"reset";
 - (id)initWithParentConnection:(YapDatabaseRelationshipConnection *)parentConnection
            databaseTransaction:(YapDatabaseReadTransaction *)databaseTransaction;
 
+/**
+ * The files table stores the list of files pending deletion.
+ * Used by the parent, from within the fileManagerQueue.
+**/
+- (NSArray<NSURL *> *)pendingFileURLs;
+- (void)removePendingFileURLs:(NSArray<NSURL *> *)fileURLs;
+
 @end
@@ -51,6 +51,14 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, copy, readonly) YapDatabaseRelationshipOptions *options;
 
+/**
+ * Resumes the deletion of files, if it was deferred by options.fileDeletionDeferral.
+ *
+ * For example, you may invoke this method when the app becomes idle, or the device starts charging.
+ * (The fileDeletionDeferral block is still consulted before each batch.)
+**/
+- (void)resumeFileDeletion;
+
 @end
 
 NS_ASSUME_NONNULL_END
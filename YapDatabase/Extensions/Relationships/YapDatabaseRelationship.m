@@ -25,6 +25,11 @@
 @implementation YapDatabaseRelationship
 {
 	dispatch_queue_t fileManagerQueue;
+	
+	// Only accessed from within the fileManagerQueue
+	NSMutableOrderedSet<NSURL *> *pendingFileURLs;
+	YapDatabaseConnection *fileDeletionConnection;
+	BOOL fileDeletionScheduled;
 }
 
 /**
@@ -39,13 +44,19 @@
 	sqlite3 *db = transaction->connection->db;
 	
 	NSString *tableName = [self tableNameForRegisteredName:registeredName];
-	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
+	NSString *namesTableName = [self namesTableNameForRegisteredName:registeredName];
+	NSString *filesTableName = [self filesTableNameForRegisteredName:registeredName];
 	
-	int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
-	if (status != SQLITE_OK)
+	for (NSString *name in @[ tableName, namesTableName, filesTableName ])
 	{
-		YDBLogError(@"%@ - Failed dropping table (%@): %d %s",
-		            THIS_METHOD, tableName, status, sqlite3_errmsg(db));
+		NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", name];
+		
+		int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed dropping table (%@): %d %s",
+			            THIS_METHOD, name, status, sqlite3_errmsg(db));
+		}
 	}
 }
 
@@ -54,6 +65,22 @@
 	return [NSString stringWithFormat:@"relationship_%@", registeredName];
 }
 
+/**
+ * The table storing the (interned) edge names, if options.internEdgeNames is enabled.
+**/
++ (NSString *)namesTableNameForRegisteredName:(NSString *)registeredName
+{
+	return [NSString stringWithFormat:@"relationship_%@_names", registeredName];
+}
+
+/**
+ * The table storing the files pending deletion.
+**/
++ (NSString *)filesTableNameForRegisteredName:(NSString *)registeredName
+{
+	return [NSString stringWithFormat:@"relationship_%@_files", registeredName];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Instance
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -77,6 +104,12 @@
 	{
 		versionTag = inVersionTag ? [inVersionTag copy] : @"";
 		options = inOptions ? [inOptions copy] : [[YapDatabaseRelationshipOptions alloc] init];
+		
+		dispatch_queue_attr_t attr =
+		  dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, [self fileDeletionQoSClass], 0);
+		
+		fileManagerQueue = dispatch_queue_create("YapDatabaseRelationship.fileManager", attr);
+		pendingFileURLs = [[NSMutableOrderedSet alloc] init];
 	}
 	return self;
 }
@@ -124,6 +157,32 @@
 	return supported;
 }
 
+/**
+ * YapDatabaseExtension subclasses may OPTIONALLY implement this method.
+ *
+ * This method is invoked after the readWriteTransaction (that registered the extension) has been committed.
+ * It's invoked within the writeQueue, so the (pending) files are loaded within the fileManagerQueue.
+**/
+- (void)didRegisterExtension
+{
+	// Resume the deletion of files that were pending when the app was last terminated (if any).
+	
+	NSString *registeredName = self.registeredName;
+	
+	dispatch_async(fileManagerQueue, ^{ @autoreleasepool {
+		
+		__block NSArray<NSURL *> *fileURLs = nil;
+		
+		[[self fileDeletionConnection] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+			fileURLs = [(YapDatabaseRelationshipTransaction *)[transaction ext:registeredName] pendingFileURLs];
+		}];
+		
+		[self->pendingFileURLs addObjectsFromArray:fileURLs];
+		[self scheduleFileDeletion];
+	}});
+}
+
 - (YapDatabaseExtensionConnection *)newConnection:(YapDatabaseConnection *)databaseConnection
 {
 	return [[YapDatabaseRelationshipConnection alloc] initWithParent:self databaseConnection:databaseConnection];
@@ -134,18 +193,195 @@
 	return [[self class] tableNameForRegisteredName:self.registeredName];
 }
 
+- (NSString *)filesTableName
+{
+	return [[self class] filesTableNameForRegisteredName:self.registeredName];
+}
+
+- (NSString *)namesTableName
+{
+	return [[self class] namesTableNameForRegisteredName:self.registeredName];
+}
+
+- (NSString *)edgeNameColumn
+{
+	if (options->internEdgeNames)
+		return [NSString stringWithFormat:
+		  @"(SELECT \"string\" FROM \"%@\" WHERE \"id\" = \"name\")", [self namesTableName]];
+	else
+		return @"\"name\"";
+}
+
+- (NSString *)edgeNameParameter
+{
+	if (options->internEdgeNames)
+		return [NSString stringWithFormat:
+		  @"(SELECT \"id\" FROM \"%@\" WHERE \"string\" = ?)", [self namesTableName]];
+	else
+		return @"?";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark File Deletion
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
  * The dispatch queue for performing file deletion operations.
- * Note: This method is not thread-safe, as it expects to only be invoked from within a read-write transaction.
 **/
 - (dispatch_queue_t)fileManagerQueue
 {
-	if (fileManagerQueue == NULL)
+	return fileManagerQueue;
+}
+
+- (qos_class_t)fileDeletionQoSClass
+{
+	switch (options->fileDeletionQualityOfService)
+	{
+		case NSQualityOfServiceUserInteractive : return QOS_CLASS_USER_INTERACTIVE;
+		case NSQualityOfServiceUserInitiated   : return QOS_CLASS_USER_INITIATED;
+		case NSQualityOfServiceUtility         : return QOS_CLASS_UTILITY;
+		case NSQualityOfServiceBackground      : return QOS_CLASS_BACKGROUND;
+		default                                : return QOS_CLASS_DEFAULT;
+	}
+}
+
+/**
+ * The connection used to read & update the files table (from within the fileManagerQueue).
+ *
+ * Since the connection retains the database, it's only kept while there are files to delete.
+**/
+- (YapDatabaseConnection *)fileDeletionConnection
+{
+	if (fileDeletionConnection == nil)
 	{
-		fileManagerQueue = dispatch_queue_create("YapDatabaseRelationship.fileManager", DISPATCH_QUEUE_SERIAL);
+		fileDeletionConnection = [self.registeredDatabase newConnection];
+		fileDeletionConnection.objectCacheEnabled = NO;
+		fileDeletionConnection.metadataCacheEnabled = NO;
 	}
 	
-	return fileManagerQueue;
+	return fileDeletionConnection;
+}
+
+- (void)deleteFiles:(NSSet<NSURL *> *)fileURLs
+{
+	dispatch_async(fileManagerQueue, ^{ @autoreleasepool {
+		
+		for (NSURL *fileURL in fileURLs)
+		{
+			[self->pendingFileURLs addObject:fileURL];
+		}
+		
+		[self scheduleFileDeletion];
+	}});
+}
+
+- (void)resumeFileDeletion
+{
+	dispatch_async(fileManagerQueue, ^{ @autoreleasepool {
+		
+		[self scheduleFileDeletion];
+	}});
+}
+
+/**
+ * Must be invoked from within the fileManagerQueue.
+ *
+ * Each batch is dispatched separately, so new files (and resume requests) are interleaved with the batches.
+**/
+- (void)scheduleFileDeletion
+{
+	if (fileDeletionScheduled) return;
+	
+	if (pendingFileURLs.count == 0)
+	{
+		fileDeletionConnection = nil;
+		return;
+	}
+	
+	fileDeletionScheduled = YES;
+	dispatch_async(fileManagerQueue, ^{ @autoreleasepool {
+		
+		[self deleteNextFileBatch];
+	}});
+}
+
+/**
+ * Must be invoked from within the fileManagerQueue.
+**/
+- (void)deleteNextFileBatch
+{
+	fileDeletionScheduled = NO;
+	
+	NSUInteger pendingCount = pendingFileURLs.count;
+	if (pendingCount == 0)
+	{
+		fileDeletionConnection = nil;
+		return;
+	}
+	
+	YapDatabaseRelationshipFileDeletionDeferral fileDeletionDeferral = options->fileDeletionDeferral;
+	if (fileDeletionDeferral && fileDeletionDeferral())
+	{
+		YDBLogVerbose(@"Deferring deletion of %lu file(s)", (unsigned long)pendingCount);
+		
+		// The files remain in the files table.
+		// We'll try again after the next commit that deletes files, or when resumeFileDeletion is invoked.
+		
+		fileDeletionConnection = nil;
+		return;
+	}
+	
+	NSUInteger batchSize = options->fileDeletionBatchSize;
+	if (batchSize == 0 || batchSize > pendingCount) {
+		batchSize = pendingCount;
+	}
+	
+	NSRange range = NSMakeRange(0, batchSize);
+	NSArray<NSURL *> *batch = [pendingFileURLs objectsAtIndexes:[NSIndexSet indexSetWithIndexesInRange:range]];
+	[pendingFileURLs removeObjectsInRange:range];
+	
+	void (^deleteFile)(NSURL *) = ^(NSURL *fileURL){ @autoreleasepool {
+		
+		NSError *error = nil;
+		if (![[NSFileManager defaultManager] removeItemAtURL:fileURL error:&error])
+		{
+			YDBLogWarn(@"Error removing file (%@): %@", [fileURL path], error);
+		}
+	}};
+	
+	size_t concurrency = MIN(MAX(options->fileDeletionConcurrency, (NSUInteger)1), batchSize);
+	if (concurrency == 1)
+	{
+		for (NSURL *fileURL in batch)
+		{
+			deleteFile(fileURL);
+		}
+	}
+	else
+	{
+		dispatch_queue_t workQueue = dispatch_get_global_queue([self fileDeletionQoSClass], 0);
+		
+		dispatch_apply(concurrency, workQueue, ^(size_t worker) {
+			
+			for (NSUInteger i = worker; i < batchSize; i += concurrency)
+			{
+				deleteFile(batch[i]);
+			}
+		});
+	}
+	
+	// Remove the files from the files table (i.e. the list of files pending deletion)
+	
+	NSString *registeredName = self.registeredName;
+	if (registeredName)
+	{
+		[[self fileDeletionConnection] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+			
+			[(YapDatabaseRelationshipTransaction *)[transaction ext:registeredName] removePendingFileURLs:batch];
+		}];
+	}
+	
+	[self scheduleFileDeletion];
 }
 
 @end
@@ -26,13 +26,12 @@
 
 @implementation YapDatabaseRelationshipConnection
 {
-	sqlite3_stmt *findEdgesWithNodeStatement;
 	sqlite3_stmt *findManualEdgeWithDstStatement;
 	sqlite3_stmt *findManualEdgeWithDstFileURLStatement;
+	sqlite3_stmt *internEdgeNameStatement;
 	sqlite3_stmt *insertEdgeStatement;
 	sqlite3_stmt *updateEdgeStatement;
 	sqlite3_stmt *deleteEdgeStatement;
-	sqlite3_stmt *deleteEdgesWithNodeStatement;
 	sqlite3_stmt *enumerateDstFileURLWithSrcStatement;
 	sqlite3_stmt *enumerateDstFileURLWithSrcNameStatement;
 	sqlite3_stmt *enumerateDstFileURLWithNameStatement;
@@ -56,6 +55,8 @@
 	sqlite3_stmt *countForDstExcludingSrcStatement;
 	sqlite3_stmt *removeAllStatement;
 	sqlite3_stmt *removeAllProtocolStatement;
+	sqlite3_stmt *insertFileStatement;
+	sqlite3_stmt *removeFileStatement;
 }
 
 @synthesize relationship = parent;
@@ -67,10 +68,16 @@
 		parent = inParent;
 		databaseConnection = inDbConnection;
 		
-		edgeCache = [[YapCache alloc] initWithCountLimit:500];
+		NSUInteger edgeCacheLimit = parent->options->edgeCacheLimit;
+		
+		edgeCache = [[YapCache alloc] initWithCountLimit:edgeCacheLimit];
 		edgeCache.allowedKeyClasses = [NSSet setWithObject:[NSNumber class]];
 		edgeCache.allowedObjectClasses = [NSSet setWithObject:[YapDatabaseRelationshipEdge class]];
 		
+		adjacencyCache = [[YapCache alloc] initWithCountLimit:edgeCacheLimit];
+		adjacencyCache.allowedKeyClasses = [NSSet setWithObject:[NSNumber class]];
+		adjacencyCache.allowedObjectClasses = [NSSet setWithObject:[NSMutableDictionary class]];
+		
 		sharedKeySetForInternalChangeset = [NSDictionary sharedKeySetForKeys:[self internalChangesetKeys]];
 	}
 	return self;
@@ -83,13 +90,12 @@
 
 - (void)_flushStatements
 {
-	sqlite_finalize_null(&findEdgesWithNodeStatement);
 	sqlite_finalize_null(&findManualEdgeWithDstStatement);
 	sqlite_finalize_null(&findManualEdgeWithDstFileURLStatement);
+	sqlite_finalize_null(&internEdgeNameStatement);
 	sqlite_finalize_null(&insertEdgeStatement);
 	sqlite_finalize_null(&updateEdgeStatement);
 	sqlite_finalize_null(&deleteEdgeStatement);
-	sqlite_finalize_null(&deleteEdgesWithNodeStatement);
 	sqlite_finalize_null(&enumerateDstFileURLWithSrcStatement);
 	sqlite_finalize_null(&enumerateDstFileURLWithSrcNameStatement);
 	sqlite_finalize_null(&enumerateDstFileURLWithNameStatement);
@@ -113,6 +119,8 @@
 	sqlite_finalize_null(&countForDstExcludingSrcStatement);
 	sqlite_finalize_null(&removeAllStatement);
 	sqlite_finalize_null(&removeAllProtocolStatement);
+	sqlite_finalize_null(&insertFileStatement);
+	sqlite_finalize_null(&removeFileStatement);
 }
 
 /**
@@ -128,9 +136,30 @@
 	if (flags & YapDatabaseConnectionFlushMemoryFlags_Caches)
 	{
 		[edgeCache removeAllObjects];
+		[adjacencyCache removeAllObjects];
 	}
 }
 
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateMemoryUsageWithBlock:(void (^)(NSString *component,
+                                                uint64_t bytes,
+                                                YapDatabaseConnectionFlushMemoryFlags flushFlags))block
+{
+	block(@"edgeCache", [edgeCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+	block(@"adjacencyCache", [adjacencyCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+}
+
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateCachesWithBlock:(void (^)(NSString *cacheName, YapCache *cache))block
+{
+	block(@"edgeCache", edgeCache);
+	block(@"adjacencyCache", adjacencyCache);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -202,6 +231,9 @@
 	if (modifiedEdges == nil)
 		modifiedEdges = [[NSMutableDictionary alloc] init];
 	
+	if (changedSources == nil)
+		changedSources = [[NSMutableSet alloc] init];
+	
 	if (filesToDelete == nil)
 		filesToDelete = [[NSMutableSet alloc] init];
 }
@@ -224,6 +256,7 @@
 	// The following may be stored in the changeset notification:
 	// - deletedEdges
 	// - modifiedEdges
+	// - changedSources
 	// - reset
 	//
 	// The following are used post-transaction:
@@ -237,6 +270,9 @@
 	if (modifiedEdges.count > 0)
 		modifiedEdges = nil;
 	
+	if (changedSources.count > 0)
+		changedSources = nil;
+	
 	if ([filesToDelete count] > 0)
 		filesToDelete = nil;
 }
@@ -258,13 +294,19 @@
 	
 	[deletedEdges removeAllObjects];
 	[modifiedEdges removeAllObjects];
+	[changedSources removeAllObjects];
 	[filesToDelete removeAllObjects];
+	
+	// The adjacencyCache may contain entries that were read (from disk) during the rolled back transaction.
+	
+	[adjacencyCache removeAllObjects];
 }
 
 - (NSArray *)internalChangesetKeys
 {
 	return @[ changeset_key_deletedEdges,
 	          changeset_key_modifiedEdges,
+	          changeset_key_changedSources,
 	          changeset_key_reset ];
 }
 
@@ -278,8 +320,9 @@
 	NSMutableDictionary *externalChangeset = nil;
 	BOOL hasDiskChanges = NO;
 	
-	if (deletedEdges.count  > 0 ||
-	    modifiedEdges.count > 0 ||
+	if (deletedEdges.count   > 0 ||
+	    modifiedEdges.count  > 0 ||
+	    changedSources.count > 0 ||
 		reset)
 	{
 		internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
@@ -294,6 +337,11 @@
 			internalChangeset[changeset_key_modifiedEdges] = modifiedEdges;
 		}
 		
+		if (changedSources.count > 0)
+		{
+			internalChangeset[changeset_key_changedSources] = changedSources;
+		}
+		
 		if (reset)
 		{
 			internalChangeset[changeset_key_reset] = @(reset);
@@ -311,19 +359,29 @@
 {
 	YDBLogAutoTrace();
 	
-	NSSet        *changeset_deletedEdges  = changeset[changeset_key_deletedEdges];
-	NSDictionary *changeset_modifiedEdges = changeset[changeset_key_modifiedEdges];
+	NSSet        *changeset_deletedEdges   = changeset[changeset_key_deletedEdges];
+	NSDictionary *changeset_modifiedEdges  = changeset[changeset_key_modifiedEdges];
+	NSSet        *changeset_changedSources = changeset[changeset_key_changedSources];
 	
 	BOOL changeset_reset = [changeset[changeset_key_reset] boolValue];
 	
+	// Update adjacencyCache
+	
+	if (changeset_reset)
+		[adjacencyCache removeAllObjects];
+	else if (changeset_changedSources.count > 0)
+		[adjacencyCache removeObjectsForKeys:changeset_changedSources];
+	
 	// Update edgeCache
 	
 	if (changeset_reset && (changeset_modifiedEdges.count == 0))
 	{
 		[edgeCache removeAllObjects];
 	}
-	else
+	else if (changeset_reset || ([changeset_deletedEdges count] + [changeset_modifiedEdges count]) > [edgeCache count])
 	{
+		// Scan the cache (it's smaller than the changeset)
+		
 		NSUInteger removeCapacity = changeset_reset ? [edgeCache count] : 0;
 		NSUInteger updateCapacity = MIN([edgeCache count], [changeset_modifiedEdges count]);
 		
@@ -356,6 +414,56 @@
 			[edgeCache setObject:[edge copy] forKey:edgeRowid];
 		}
 	}
+	else
+	{
+		// Lookup the changed edges (the changeset is smaller than the cache)
+		
+		[edgeCache removeObjectsForKeys:changeset_deletedEdges];
+		
+		[changeset_modifiedEdges enumerateKeysAndObjectsUsingBlock:
+		    ^(NSNumber *edgeRowid, YapDatabaseRelationshipEdge *edge, BOOL __unused *stop)
+		{
+			if ([self->edgeCache containsKey:edgeRowid])
+			{
+				// Important: each connection should have its own mutable copy of the edge
+				[self->edgeCache setObject:[edge copy] forKey:edgeRowid];
+			}
+		}];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Adjacency Cache
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSArray<NSNumber *> *)cachedEdgeRowidsWithSource:(int64_t)srcRowid name:(NSString *)name
+{
+	NSMutableDictionary *edgeRowidsByName = [adjacencyCache objectForKey:@(srcRowid)];
+	
+	return [edgeRowidsByName objectForKey:(name ?: [NSNull null])];
+}
+
+- (void)setCachedEdgeRowids:(NSArray<NSNumber *> *)edgeRowids withSource:(int64_t)srcRowid name:(NSString *)name
+{
+	NSMutableDictionary *edgeRowidsByName = [adjacencyCache objectForKey:@(srcRowid)];
+	if (edgeRowidsByName == nil)
+	{
+		edgeRowidsByName = [NSMutableDictionary dictionaryWithCapacity:1];
+		[adjacencyCache setObject:edgeRowidsByName forKey:@(srcRowid)];
+	}
+	
+	[edgeRowidsByName setObject:[edgeRowids copy] forKey:(name ?: [NSNull null])];
+}
+
+/**
+ * Invoked by the transaction whenever it inserts or deletes an edge (on disk) with the given source.
+**/
+- (void)didChangeEdgesWithSource:(int64_t)srcRowid
+{
+	NSNumber *srcRowidNumber = @(srcRowid);
+	
+	[adjacencyCache removeObjectForKey:srcRowidNumber];
+	[changedSources addObject:srcRowidNumber];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -388,13 +496,15 @@
 	FreeYapDatabaseString(&stmt);
 }
 
-- (sqlite3_stmt *)findEdgesWithNodeStatement
+- (sqlite3_stmt *)findManualEdgeWithDstStatement
 {
-	sqlite3_stmt **statement = &findEdgesWithNodeStatement;
+	sqlite3_stmt **statement = &findManualEdgeWithDstStatement;
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\" FROM \"%@\" WHERE \"src\" = ? OR \"dst\" = ?;", [parent tableName]];
+		  @"SELECT \"rowid\", \"rules\" FROM \"%@\" "
+		  @" WHERE \"src\" = ? AND \"dst\" = ? AND \"name\" = %@ AND \"manual\" = 1 LIMIT 1;",
+		  [parent tableName], [parent edgeNameParameter]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -402,16 +512,15 @@
 	return *statement;
 }
 
-
-- (sqlite3_stmt *)findManualEdgeWithDstStatement
+- (sqlite3_stmt *)findManualEdgeWithDstFileURLStatement
 {
-	sqlite3_stmt **statement = &findManualEdgeWithDstStatement;
+	sqlite3_stmt **statement = &findManualEdgeWithDstFileURLStatement;
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"rules\" FROM \"%@\" "
-		  @" WHERE \"src\" = ? AND \"dst\" = ? AND \"name\" = ? AND \"manual\" = 1 LIMIT 1;",
-		  [parent tableName]];
+		  @"SELECT \"rowid\", \"dst\", \"rules\" FROM \"%@\" "
+		  @" WHERE \"src\" = ? AND \"name\" = %@ AND \"dst\" > %lld AND \"manual\" = 1;",
+		  [parent tableName], [parent edgeNameParameter], INT64_MAX];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -419,15 +528,13 @@
 	return *statement;
 }
 
-- (sqlite3_stmt *)findManualEdgeWithDstFileURLStatement
+- (sqlite3_stmt *)internEdgeNameStatement
 {
-	sqlite3_stmt **statement = &findManualEdgeWithDstFileURLStatement;
+	sqlite3_stmt **statement = &internEdgeNameStatement;
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"dst\", \"rules\" FROM \"%@\" "
-		  @" WHERE \"src\" = ? AND \"name\" = ? AND \"dst\" > %lld AND \"manual\" = 1;",
-		  [parent tableName], INT64_MAX];
+		  @"INSERT OR IGNORE INTO \"%@\" (\"string\") VALUES (?);", [parent namesTableName]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -441,8 +548,8 @@
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"INSERT INTO \"%@\" (\"name\", \"src\", \"dst\", \"rules\", \"manual\") VALUES (?, ?, ?, ?, ?);",
-		  [parent tableName]];
+		  @"INSERT INTO \"%@\" (\"name\", \"src\", \"dst\", \"rules\", \"manual\") VALUES (%@, ?, ?, ?, ?);",
+		  [parent tableName], [parent edgeNameParameter]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -478,20 +585,6 @@
 	return *statement;
 }
 
-- (sqlite3_stmt *)deleteEdgesWithNodeStatement
-{
-	sqlite3_stmt **statement = &deleteEdgesWithNodeStatement;
-	if (*statement == NULL)
-	{
-		NSString *string = [NSString stringWithFormat:
-		  @"DELETE FROM \"%@\" WHERE \"src\" = ? OR \"dst\" = ?;", [parent tableName]];
-		
-		[self prepareStatement:statement withString:string caller:_cmd];
-	}
-	
-	return *statement;
-}
-
 - (sqlite3_stmt *)enumerateDstFileURLWithSrcStatement:(BOOL *)needsFinalizePtr
 {
 	sqlite3_stmt **statement = &enumerateDstFileURLWithSrcStatement;
@@ -513,9 +606,9 @@
 		// For more information, see the documentation: http://www.sqlite.org/datatype3.html
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"name\", \"dst\", \"rules\", \"manual\" FROM \"%@\""
+		  @"SELECT \"rowid\", %@, \"dst\", \"rules\", \"manual\" FROM \"%@\""
 		  @" WHERE \"dst\" > %lld AND \"src\" = ?;",
-		  [self->parent tableName], INT64_MAX];
+		  [self->parent edgeNameColumn], [self->parent tableName], INT64_MAX];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -567,8 +660,8 @@
 		
 		NSString *string = [NSString stringWithFormat:
 		  @"SELECT \"rowid\", \"dst\", \"rules\", \"manual\" FROM \"%@\""
-		  @" WHERE \"dst\" > %lld AND \"src\" = ? AND \"name\" = ?;",
-		  [self->parent tableName], INT64_MAX];
+		  @" WHERE \"dst\" > %lld AND \"src\" = ? AND \"name\" = %@;",
+		  [self->parent tableName], INT64_MAX, [self->parent edgeNameParameter]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -620,8 +713,8 @@
 		
 		NSString *string = [NSString stringWithFormat:
 		  @"SELECT \"rowid\", \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\""
-		  @" WHERE \"dst\" > %lld AND \"name\" = ?;",
-		  [self->parent tableName], INT64_MAX];
+		  @" WHERE \"dst\" > %lld AND \"name\" = %@;",
+		  [self->parent tableName], INT64_MAX, [self->parent edgeNameParameter]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -672,9 +765,9 @@
 		// For more information, see the documentation: http://www.sqlite.org/datatype3.html
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"name\", \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\""
+		  @"SELECT \"rowid\", %@, \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\""
 		  @" WHERE \"dst\" > %lld AND \"src\" != ?;",
-		  [self->parent tableName], INT64_MAX];
+		  [self->parent edgeNameColumn], [self->parent tableName], INT64_MAX];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -725,8 +818,8 @@
 		// For more information, see the documentation: http://www.sqlite.org/datatype3.html
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"name\", \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"dst\" > %lld;",
-		  [self->parent tableName], INT64_MAX];
+		  @"SELECT \"rowid\", %@, \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"dst\" > %lld;",
+		  [self->parent edgeNameColumn], [self->parent tableName], INT64_MAX];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -763,8 +856,8 @@
 	sqlite3_stmt* (^CreateStatement)(void) = ^{
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"name\", \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ?;",
-		  [self->parent tableName]];
+		  @"SELECT \"rowid\", %@, \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ?;",
+		  [self->parent edgeNameColumn], [self->parent tableName]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -801,8 +894,8 @@
 	sqlite3_stmt* (^CreateStatement)(void) = ^{
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"name\", \"src\", \"rules\", \"manual\" FROM \"%@\" WHERE \"dst\" = ?;",
-		  [self->parent tableName]];
+		  @"SELECT \"rowid\", %@, \"src\", \"rules\", \"manual\" FROM \"%@\" WHERE \"dst\" = ?;",
+		  [self->parent edgeNameColumn], [self->parent tableName]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -839,8 +932,8 @@
 	sqlite3_stmt* (^CreateStatement)(void) = ^{
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ? AND \"name\" = ?;",
-		  [self->parent tableName]];
+		  @"SELECT \"rowid\", \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ? AND \"name\" = %@;",
+		  [self->parent tableName], [self->parent edgeNameParameter]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -877,8 +970,8 @@
 	sqlite3_stmt* (^CreateStatement)(void) = ^{
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"src\", \"rules\", \"manual\" FROM \"%@\" WHERE \"dst\" = ? AND \"name\" = ?;",
-		  [self->parent tableName]];
+		  @"SELECT \"rowid\", \"src\", \"rules\", \"manual\" FROM \"%@\" WHERE \"dst\" = ? AND \"name\" = %@;",
+		  [self->parent tableName], [self->parent edgeNameParameter]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -915,8 +1008,8 @@
 	sqlite3_stmt* (^CreateStatement)(void) = ^{
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"name\" = ?;",
-		  [self->parent tableName]];
+		  @"SELECT \"rowid\", \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\" WHERE \"name\" = %@;",
+		  [self->parent tableName], [self->parent edgeNameParameter]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -953,8 +1046,8 @@
 	sqlite3_stmt* (^CreateStatement)(void) = ^{
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"name\", \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ? AND \"dst\" = ?;",
-		  [self->parent tableName]];
+		  @"SELECT \"rowid\", %@, \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ? AND \"dst\" = ?;",
+		  [self->parent edgeNameColumn], [self->parent tableName]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -991,8 +1084,8 @@
 	sqlite3_stmt* (^CreateStatement)(void) = ^{
 		
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT \"rowid\", \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ? AND \"dst\" = ? AND \"name\" = ?;",
-		  [self->parent tableName]];
+		  @"SELECT \"rowid\", \"rules\", \"manual\" FROM \"%@\" WHERE \"src\" = ? AND \"dst\" = ? AND \"name\" = %@;",
+		  [self->parent tableName], [self->parent edgeNameParameter]];
 		
 		sqlite3_stmt *stmt = NULL;
 		[self prepareStatement:&stmt withString:string caller:_cmd];
@@ -1088,8 +1181,8 @@
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"src\" = ? AND \"name\" = ?;",
-		  [parent tableName]];
+		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"src\" = ? AND \"name\" = %@;",
+		  [parent tableName], [parent edgeNameParameter]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -1103,8 +1196,8 @@
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"dst\" = ? AND \"name\" = ?;",
-		  [parent tableName]];
+		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"dst\" = ? AND \"name\" = %@;",
+		  [parent tableName], [parent edgeNameParameter]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -1118,8 +1211,8 @@
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"name\" = ?;",
-		  [parent tableName]];
+		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"name\" = %@;",
+		  [parent tableName], [parent edgeNameParameter]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -1148,8 +1241,8 @@
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
-		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"src\" = ? AND \"dst\" = ? AND \"name\" = ?;",
-		  [parent tableName]];
+		  @"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" WHERE \"src\" = ? AND \"dst\" = ? AND \"name\" = %@;",
+		  [parent tableName], [parent edgeNameParameter]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
 	}
@@ -1184,4 +1277,32 @@
 	return *statement;
 }
 
+- (sqlite3_stmt *)insertFileStatement
+{
+	sqlite3_stmt **statement = &insertFileStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		  @"INSERT OR IGNORE INTO \"%@\" (\"url\") VALUES (?);", [parent filesTableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)removeFileStatement
+{
+	sqlite3_stmt **statement = &removeFileStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		  @"DELETE FROM \"%@\" WHERE \"url\" = ?;", [parent filesTableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
 @end
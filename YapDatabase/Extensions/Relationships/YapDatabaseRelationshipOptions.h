@@ -53,6 +53,14 @@ typedef NSURL* _Nullable (^YapDatabaseRelationshipFileURLDeserializer)(YapDataba
 **/
 typedef NSURL* _Nullable (^YapDatabaseRelationshipMigration)(NSString *_Nullable filePath, NSData *_Nullable data);
 
+/**
+ * Allows the deletion of files (see fileDeletionDeferral) to be postponed.
+ *
+ * Return YES to defer the deletion (e.g. if the app is busy, or the device isn't charging).
+ * Return NO to proceed with the deletion.
+**/
+typedef BOOL (^YapDatabaseRelationshipFileDeletionDeferral)(void);
+
 
 /**
  * This class allows for various customizations to the YapDatabaseRelationship extension.
@@ -97,6 +105,75 @@ typedef NSURL* _Nullable (^YapDatabaseRelationshipMigration)(NSString *_Nullable
 **/
 @property (nonatomic, strong, readwrite, nullable) YapWhitelistBlacklist *allowedCollections;
 
+/**
+ * Every edge stores its name, both in the edge table and in its two indexes (src, name) & (dst, name).
+ * 
+ * If you enable this option, each distinct edge name is stored only once (in a separate names table),
+ * and the edge table (and its indexes) store the integer id of the name instead.
+ * This significantly reduces the size of the edge table & indexes, especially when using long edge names,
+ * which in turn speeds up edge lookups & enumerations.
+ *
+ * The public API is unaffected (edges are still queried & returned by name).
+ * If you change this option for an existing extension, the edge table is migrated when the extension is registered.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL internEdgeNames;
+
+/**
+ * Each connection keeps a cache of recently used edges (keyed by edge rowid),
+ * along with a cache of the edges of recently enumerated source nodes (per edge name).
+ * The cache of source nodes also remembers nodes without any edges,
+ * so repeated enumerations for the same node don't hit the disk.
+ *
+ * The edgeCacheLimit is the countLimit of both caches, i.e. max number of edges, and max number of source nodes.
+ * Set to zero to disable the limit. (Not recommended for very large graphs.)
+ *
+ * The default value is 500.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger edgeCacheLimit;
+
+/**
+ * When nodes with file-URL destinations are deleted (according to the nodeDeleteRules),
+ * the files are deleted in the background after the transaction commits.
+ *
+ * The files are deleted in batches of (at most) fileDeletionBatchSize files.
+ * Set to zero to delete all the files of a commit in a single batch.
+ *
+ * The default value is 100.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger fileDeletionBatchSize;
+
+/**
+ * The maximum number of files that are deleted concurrently (within a batch).
+ * Zero is treated as 1.
+ *
+ * The default value is 1.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger fileDeletionConcurrency;
+
+/**
+ * The quality of service of the background file deletion.
+ * Lower QoS classes (e.g. NSQualityOfServiceBackground) are subject to I/O throttling by the system.
+ *
+ * The default value is NSQualityOfServiceUtility.
+**/
+@property (nonatomic, assign, readwrite) NSQualityOfService fileDeletionQualityOfService;
+
+/**
+ * If set, this block is invoked (on a background queue) before each batch of files is deleted.
+ * If it returns YES, the deletion is paused until the next commit that deletes files,
+ * or until -[YapDatabaseRelationship resumeFileDeletion] is invoked (e.g. when the app becomes idle,
+ * or the device starts charging).
+ *
+ * The list of files pending deletion is stored in the database (within the same transaction that deleted the edges),
+ * so files aren't leaked if the app is terminated before they're deleted.
+ * The remaining files are deleted after the extension is registered again.
+ *
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable) YapDatabaseRelationshipFileDeletionDeferral fileDeletionDeferral;
+
 /**
  * The relationship extension allows you to create relationships between objects in the database & files on disk.
  * This allows you to use the relationship extension to automatically delete files
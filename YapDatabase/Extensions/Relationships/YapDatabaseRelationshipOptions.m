@@ -22,6 +22,12 @@ static NSString *const kPlistKey_PathComponents = @"pathComponents";
 
 @synthesize disableYapDatabaseRelationshipNodeProtocol = disableYapDatabaseRelationshipNodeProtocol;
 @synthesize allowedCollections = allowedCollections;
+@synthesize internEdgeNames = internEdgeNames;
+@synthesize edgeCacheLimit = edgeCacheLimit;
+@synthesize fileDeletionBatchSize = fileDeletionBatchSize;
+@synthesize fileDeletionConcurrency = fileDeletionConcurrency;
+@synthesize fileDeletionQualityOfService = fileDeletionQualityOfService;
+@synthesize fileDeletionDeferral = fileDeletionDeferral;
 @synthesize fileURLSerializer = fileURLSerializer;
 @synthesize fileURLDeserializer = fileURLDeserializer;
 @synthesize migration = migration;
@@ -32,6 +38,12 @@ static NSString *const kPlistKey_PathComponents = @"pathComponents";
 	{
 		disableYapDatabaseRelationshipNodeProtocol = NO;
 		allowedCollections = nil;
+		internEdgeNames = NO;
+		edgeCacheLimit = 500;
+		fileDeletionBatchSize = 100;
+		fileDeletionConcurrency = 1;
+		fileDeletionQualityOfService = NSQualityOfServiceUtility;
+		fileDeletionDeferral = nil;
 		fileURLSerializer = [[self class] defaultFileURLSerializer];
 		fileURLDeserializer = [[self class] defaultFileURLDeserializer];
 		migration = [[self class] defaultMigration];
@@ -68,6 +80,12 @@ static NSString *const kPlistKey_PathComponents = @"pathComponents";
 	YapDatabaseRelationshipOptions *copy = [[YapDatabaseRelationshipOptions alloc] init];
 	copy->disableYapDatabaseRelationshipNodeProtocol = disableYapDatabaseRelationshipNodeProtocol;
 	copy->allowedCollections = allowedCollections;
+	copy->internEdgeNames = internEdgeNames;
+	copy->edgeCacheLimit = edgeCacheLimit;
+	copy->fileDeletionBatchSize = fileDeletionBatchSize;
+	copy->fileDeletionConcurrency = fileDeletionConcurrency;
+	copy->fileDeletionQualityOfService = fileDeletionQualityOfService;
+	copy->fileDeletionDeferral = fileDeletionDeferral;
 	copy->fileURLSerializer = fileURLSerializer;
 	copy->fileURLDeserializer = fileURLDeserializer;
 	copy->migration = migration;
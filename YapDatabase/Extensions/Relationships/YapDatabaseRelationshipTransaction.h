@@ -6,6 +6,28 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * The direction in which edges are followed during a traversal.
+ *
+ * - Outgoing : from the source of an edge to its destination
+ * - Incoming : from the destination of an edge to its source
+ *
+ * For example, if every child node has an edge to its parent (the typical setup for cascading deletes),
+ * then the descendants of a node are found by following the Incoming edges.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseRelationshipTraversalDirection) {
+	YapDatabaseRelationshipTraversalDirectionOutgoing,
+	YapDatabaseRelationshipTraversalDirectionIncoming,
+};
+
+/**
+ * The order in which nodes are visited during a traversal.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseRelationshipTraversalOrder) {
+	YapDatabaseRelationshipTraversalOrderBreadthFirst,
+	YapDatabaseRelationshipTraversalOrderDepthFirst,
+};
+
 /**
  * Welcome to YapDatabase!
  *
@@ -192,6 +214,55 @@ NS_ASSUME_NONNULL_BEGIN
             destinationFileURL:(nullable NSURL *)destinationFileURL
                     usingBlock:(void (^)(YapDatabaseRelationshipEdge *edge, BOOL *stop))block;
 
+#pragma mark Traversal
+
+/**
+ * Enumerates every node reachable from the given node, by following edges (with the given name) in the given direction.
+ * 
+ * Every node is visited once (even if there are multiple paths to it, or cycles in the graph),
+ * and the given node itself isn't visited. Edges with a destinationFileURL are ignored.
+ * 
+ * The edges are loaded in batches, rather than one query per node:
+ * a single "IN (?, ?, ...)" query loads the edges of up to SQLITE_LIMIT_VARIABLE_NUMBER pending nodes at once.
+ * For a breadth-first traversal, that's (generally) a single query per level of the graph.
+ * 
+ * Note: Within a readwrite transaction, changes to the graph aren't processed until the end of the transaction
+ * (or until you invoke flush). If there are unprocessed changes, the edges are looked up per node instead,
+ * so that the traversal reflects those changes.
+ * 
+ * @param key
+ *   The key of the node to start from.
+ * 
+ * @param collection (optional)
+ *   The collection of the node to start from.
+ *   If nil, the collection is treated as the empty string, just like the rest of the YapDatabase framework.
+ * 
+ * @param name (optional)
+ *   Only edges with this name (case sensitive) are followed.
+ *   If nil, every edge is followed.
+ * 
+ * @param direction
+ *   Whether to follow edges from source to destination (Outgoing), or from destination to source (Incoming).
+ * 
+ * @param order
+ *   Breadth-first visits the nodes in order of increasing depth.
+ *   Depth-first follows each path as deep as it goes before backtracking.
+ * 
+ * @param maxDepth
+ *   The maximum number of edges between the given node and a visited node.
+ *   Pass zero for no limit.
+ * 
+ * @param block
+ *   Invoked for each visited node, along with its depth (the number of edges followed to reach it, starting at 1).
+**/
+- (void)enumerateNodesFromKey:(NSString *)key
+                   collection:(nullable NSString *)collection
+                     edgeName:(nullable NSString *)name
+                    direction:(YapDatabaseRelationshipTraversalDirection)direction
+                        order:(YapDatabaseRelationshipTraversalOrder)order
+                     maxDepth:(NSUInteger)maxDepth
+                   usingBlock:(void (^)(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop))block;
+
 #pragma mark Count
 
 /**
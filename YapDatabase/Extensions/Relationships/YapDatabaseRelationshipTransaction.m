@@ -204,12 +204,34 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 		
 		[self setIntValue:classVersion forExtensionKey:ext_key_classVersion persistent:YES];
 		
+		int internEdgeNames = parentConnection->parent->options->internEdgeNames ? 1 : 0;
+		[self setIntValue:internEdgeNames forExtensionKey:ext_key_internEdgeNames persistent:YES];
+		
 		NSString *versionTag = parentConnection->parent->versionTag;
 		[self setStringValue:versionTag forExtensionKey:ext_key_versionTag persistent:YES];
 		
 		return YES;
 	}
 	
+	// The files table (list of files pending deletion) was added after classVersion 4.
+	
+	if (![self createFilesTable]) return NO;
+	
+	// Check the storage format of the edge names (options.internEdgeNames).
+	// If the option was changed, we need to migrate the table.
+	
+	int oldInternEdgeNames = 0;
+	[self getIntValue:&oldInternEdgeNames forExtensionKey:ext_key_internEdgeNames persistent:YES];
+	
+	int internEdgeNames = parentConnection->parent->options->internEdgeNames ? 1 : 0;
+	
+	if (oldInternEdgeNames != internEdgeNames)
+	{
+		if (![self migrateTableForInternEdgeNames]) return NO;
+		
+		[self setIntValue:internEdgeNames forExtensionKey:ext_key_internEdgeNames persistent:YES];
+	}
+	
 	// Check user-supplied config version.
 	// If the version gets changed, this indicates that YapDatabaseRelationshipNode objects changed.
 	// In other words, their yapDatabaseRelationshipEdges methods were channged.
@@ -275,14 +297,95 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	sqlite3 *db = databaseTransaction->connection->db;
 	
 	NSString *tableName = [self tableName];
-	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
+	NSString *namesTableName = [parentConnection->parent namesTableName];
 	
-	int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
-	if (status != SQLITE_OK)
+	for (NSString *name in @[ tableName, namesTableName ])
 	{
-		YDBLogError(@"%@ - Failed dropping relationship table (%@): %d %s",
-		            THIS_METHOD, dropTable, status, sqlite3_errmsg(db));
-		return NO;
+		NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", name];
+		
+		int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed dropping relationship table (%@): %d %s",
+			            THIS_METHOD, dropTable, status, sqlite3_errmsg(db));
+			return NO;
+		}
+	}
+	
+	return YES;
+}
+
+/**
+ * Migrates the table between the two storage formats of the "name" column (see options.internEdgeNames).
+ * The edges (including their rowids) are copied into a new table, which is created according to the options.
+**/
+- (BOOL)migrateTableForInternEdgeNames
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	BOOL internEdgeNames = parentConnection->parent->options->internEdgeNames;
+	
+	NSString *tableName = [self tableName];
+	NSString *namesTableName = [parentConnection->parent namesTableName];
+	NSString *oldTableName = [tableName stringByAppendingString:@"_old"];
+	
+	NSMutableArray<NSString *> *queries = [NSMutableArray arrayWithCapacity:4];
+	
+	// The indexes move along with the renamed table, and index names are unique within the database.
+	// So they need to be dropped before the new table (and its indexes) can be created.
+	
+	[queries addObject:[NSString stringWithFormat:
+	  @"ALTER TABLE \"%@\" RENAME TO \"%@\";", tableName, oldTableName]];
+	[queries addObject:@"DROP INDEX IF EXISTS \"src_name\";"];
+	[queries addObject:@"DROP INDEX IF EXISTS \"dst_name\";"];
+	
+	for (NSString *query in queries)
+	{
+		int status = sqlite3_exec(db, [query UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed migrating table (%@): %d %s", THIS_METHOD, query, status, sqlite3_errmsg(db));
+			return NO;
+		}
+	}
+	
+	if (![self createTable]) return NO;
+	
+	[queries removeAllObjects];
+	
+	if (internEdgeNames)
+	{
+		[queries addObject:[NSString stringWithFormat:
+		  @"INSERT OR IGNORE INTO \"%@\" (\"string\") SELECT DISTINCT \"name\" FROM \"%@\";",
+		  namesTableName, oldTableName]];
+		
+		[queries addObject:[NSString stringWithFormat:
+		  @"INSERT INTO \"%@\" (\"rowid\", \"name\", \"src\", \"dst\", \"rules\", \"manual\")"
+		  @" SELECT \"rowid\", (SELECT \"id\" FROM \"%@\" WHERE \"string\" = \"name\"),"
+		  @"  \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\";",
+		  tableName, namesTableName, oldTableName]];
+	}
+	else
+	{
+		[queries addObject:[NSString stringWithFormat:
+		  @"INSERT INTO \"%@\" (\"rowid\", \"name\", \"src\", \"dst\", \"rules\", \"manual\")"
+		  @" SELECT \"rowid\", (SELECT \"string\" FROM \"%@\" WHERE \"id\" = \"name\"),"
+		  @"  \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\";",
+		  tableName, namesTableName, oldTableName]];
+		
+		[queries addObject:[NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", namesTableName]];
+	}
+	
+	[queries addObject:[NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", oldTableName]];
+	
+	for (NSString *query in queries)
+	{
+		int status = sqlite3_exec(db, [query UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed migrating table (%@): %d %s", THIS_METHOD, query, status, sqlite3_errmsg(db));
+			return NO;
+		}
 	}
 	
 	return YES;
@@ -437,15 +540,19 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	
 	YDBLogVerbose(@"Creating relationship table for registeredName(%@): %@", [self registeredName], tableName);
 	
+	// If the edge names are interned, the "name" column stores the id of the name (in the names table).
+	
+	BOOL internEdgeNames = parentConnection->parent->options->internEdgeNames;
+	
 	NSString *createTable = [NSString stringWithFormat:
 	  @"CREATE TABLE IF NOT EXISTS \"%@\""
 	  @" (\"rowid\" INTEGER PRIMARY KEY,"
-	  @"  \"name\" CHAR NOT NULL,"
+	  @"  \"name\" %@ NOT NULL,"
 	  @"  \"src\" INTEGER NOT NULL,"
 	  @"  \"dst\" BLOB NOT NULL," // affinity==NONE (to better support rowid's or filepath's without type casting)
 	  @"  \"rules\" INTEGER,"
 	  @"  \"manual\" INTEGER"
-	  @" );", tableName];
+	  @" );", tableName, (internEdgeNames ? @"INTEGER" : @"CHAR")];
 	
 	// Discussion on index optimizations:
 	//
@@ -467,6 +574,23 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 		return NO;
 	}
 	
+	if (internEdgeNames)
+	{
+		NSString *createNamesTable = [NSString stringWithFormat:
+		  @"CREATE TABLE IF NOT EXISTS \"%@\""
+		  @" (\"id\" INTEGER PRIMARY KEY,"
+		  @"  \"string\" TEXT NOT NULL UNIQUE"
+		  @" );", [parentConnection->parent namesTableName]];
+		
+		status = sqlite3_exec(db, [createNamesTable UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed creating names table (%@): %d %s",
+			            THIS_METHOD, createNamesTable, status, sqlite3_errmsg(db));
+			return NO;
+		}
+	}
+	
 	status = sqlite3_exec(db, [createSrcNameIndex UTF8String], NULL, NULL, NULL);
 	if (status != SQLITE_OK)
 	{
@@ -483,6 +607,33 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 		return NO;
 	}
 	
+	return [self createFilesTable];
+}
+
+/**
+ * Internal method.
+ *
+ * The files table stores the files pending deletion.
+ * That is, files that are deleted (in the background) after the transaction that deleted their edges commits.
+ * This way the files aren't leaked if the app is terminated before they're deleted.
+ *
+ * Note: The table isn't dropped by dropTable, as the pending files still need to be deleted.
+**/
+- (BOOL)createFilesTable
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *createFilesTable = [NSString stringWithFormat:
+	  @"CREATE TABLE IF NOT EXISTS \"%@\" (\"url\" TEXT PRIMARY KEY);", [parentConnection->parent filesTableName]];
+	
+	int status = sqlite3_exec(db, [createFilesTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed creating files table (%@): %d %s",
+		            THIS_METHOD, createFilesTable, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
 	return YES;
 }
 
@@ -535,6 +686,29 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections =
 	    parentConnection->parent->options->allowedCollections;
 	
+	YapDatabaseExtensionPopulation *population =
+	  ((YapDatabaseReadWriteTransaction *)databaseTransaction)->extensionPopulation;
+	
+	if (population)
+	{
+		// Multiple extensions are being registered together.
+		// The rows will be handed to us during a shared enumeration of the database.
+		
+		[population addParticipantWithName:[self registeredName]
+		                allowedCollections:allowedCollections
+		                         blockType:YapDatabaseBlockTypeWithObject
+		                            filter:nil
+		                             block:^(int64_t rowid, NSString *collection, NSString *key, id object, id __unused metadata)
+		{
+			ProcessRow(rowid, collection, key, object);
+			
+		} completion:^{
+			
+			[self flush];
+		}];
+		return YES;
+	}
+	
 	if (allowedCollections)
 	{
 		[databaseTransaction enumerateCollectionsUsingBlock:^(NSString *collection, BOOL __unused *outerStop) {
@@ -1914,72 +2088,135 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 /**
  * Simple enumeration of existing data in database, via a SELECT query.
  * Does not take into account anything in memory (parentConnection->changes dictionary).
+ *
+ * Enumerates every edge where either the source or the destination is one of the given nodes,
+ * using a single "IN (?, ?, ...)" query per (SQLITE_LIMIT_VARIABLE_NUMBER / 2) nodes.
 **/
-- (void)enumerateExistingEdgesWithDestination:(int64_t)dstRowid
-                                   usingBlock:(void (^)(YapDatabaseRelationshipEdge *edge))block
+- (void)enumerateExistingEdgesWithNodes:(NSArray<NSNumber *> *)rowids
+                             usingBlock:(void (^)(YapDatabaseRelationshipEdge *edge))block
 {
-	BOOL needsFinalize;
-	sqlite3_stmt *statement = [parentConnection enumerateForDstStatement:&needsFinalize];
-	if (statement == NULL) return;
-	
-	// SELECT "rowid", "name", "src", "rules", "manual" FROM "tableName" WHERE "dst" = ?;
+	sqlite3 *db = databaseTransaction->connection->db;
 	
 	int const column_idx_rowid  = SQLITE_COLUMN_START + 0;
 	int const column_idx_name   = SQLITE_COLUMN_START + 1;
 	int const column_idx_src    = SQLITE_COLUMN_START + 2;
-	int const column_idx_rules  = SQLITE_COLUMN_START + 3;
-	int const column_idx_manual = SQLITE_COLUMN_START + 4;
-	int const bind_idx_dst      = SQLITE_BIND_START;
+	int const column_idx_dst    = SQLITE_COLUMN_START + 3;
+	int const column_idx_rules  = SQLITE_COLUMN_START + 4;
+	int const column_idx_manual = SQLITE_COLUMN_START + 5;
 	
-	sqlite3_bind_int64(statement, bind_idx_dst, dstRowid);
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// We need to watch out for this in case a large array of rowids is passed.
 	
-	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger offset = 0;
+	
+	while (offset < rowids.count)
 	{
-		int64_t edgeRowid = sqlite3_column_int64(statement, column_idx_rowid);
+		NSUInteger left = rowids.count - offset;
+		NSUInteger numRowidParams = MIN(left, (maxHostParams / 2)); // each rowid is bound twice (src & dst)
 		
-		YapDatabaseRelationshipEdge *edge = [parentConnection->edgeCache objectForKey:@(edgeRowid)];
-		if (edge)
+		// SELECT "rowid", "name", "src", "dst", "rules", "manual" FROM "tableName"
+		//   WHERE "src" IN (?, ?, ...) OR "dst" IN (?, ?, ...);
+		
+		NSMutableString *inClause = [NSMutableString stringWithCapacity:(numRowidParams * 3)];
+		
+		NSUInteger i;
+		for (i = 0; i < numRowidParams; i++)
 		{
-			edge->sourceRowid = sqlite3_column_int64(statement, column_idx_src);
-			edge->state |= YDB_EdgeState_HasSourceRowid;
-			
-			edge->destinationRowid = dstRowid;
-			edge->state |= YDB_EdgeState_HasDestinationRowid;
+			if (i == 0)
+				[inClause appendString:@"?"];
+			else
+				[inClause appendString:@", ?"];
 		}
-		else
+		
+		NSString *query = [NSString stringWithFormat:
+		  @"SELECT \"rowid\", %@, \"src\", \"dst\", \"rules\", \"manual\" FROM \"%@\""
+		  @" WHERE \"src\" IN (%@) OR \"dst\" IN (%@);",
+		  [parentConnection->parent edgeNameColumn], [self tableName], inClause, inClause];
+		
+		sqlite3_stmt *statement = NULL;
+		
+		int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
 		{
-			const unsigned char *text = sqlite3_column_text(statement, column_idx_name);
-			int textSize = sqlite3_column_bytes(statement, column_idx_name);
-			
-			NSString *name = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+			YDBLogError(@"%@ - Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			break;
+		}
+		
+		for (i = 0; i < numRowidParams; i++)
+		{
+			int64_t rowid = [rowids[offset + i] longLongValue];
 			
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + numRowidParams + i), rowid);
+		}
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			int64_t edgeRowid = sqlite3_column_int64(statement, column_idx_rowid);
 			int64_t srcRowid = sqlite3_column_int64(statement, column_idx_src);
 			
-			int rules = sqlite3_column_int(statement, column_idx_rules);
-			BOOL manual = (BOOL)sqlite3_column_int(statement, column_idx_manual);
-			
-			edge = [[YapDatabaseRelationshipEdge alloc] initWithEdgeRowid:edgeRowid
-			                                                         name:name
-			                                                     srcRowid:srcRowid
-			                                                     dstRowid:dstRowid
-			                                                      dstData:nil
-			                                                        rules:rules
-			                                                       manual:manual];
+			YapDatabaseRelationshipEdge *edge = [parentConnection->edgeCache objectForKey:@(edgeRowid)];
+			if (edge)
+			{
+				edge->sourceRowid = srcRowid;
+				edge->state |= YDB_EdgeState_HasSourceRowid;
+				
+				if (sqlite3_column_type(statement, column_idx_dst) == SQLITE_INTEGER)
+				{
+					edge->destinationRowid = sqlite3_column_int64(statement, column_idx_dst);
+					edge->state |= YDB_EdgeState_HasDestinationRowid;
+				}
+			}
+			else
+			{
+				const unsigned char *text = sqlite3_column_text(statement, column_idx_name);
+				int textSize = sqlite3_column_bytes(statement, column_idx_name);
+				
+				NSString *name = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+				
+				int64_t dstRowid = 0;
+				NSData *dstFileURLData = nil;
+				
+				int column_type = sqlite3_column_type(statement, column_idx_dst);
+				if (column_type == SQLITE_INTEGER)
+				{
+					dstRowid = sqlite3_column_int64(statement, column_idx_dst);
+				}
+				else if (column_type == SQLITE_BLOB)
+				{
+					const void *blob = sqlite3_column_blob(statement, column_idx_dst);
+					int blobSize = sqlite3_column_bytes(statement, column_idx_dst);
+					
+					dstFileURLData = [NSData dataWithBytes:(void *)blob length:blobSize];
+				}
+				
+				int rules = sqlite3_column_int(statement, column_idx_rules);
+				BOOL manual = (BOOL)sqlite3_column_int(statement, column_idx_manual);
+				
+				edge = [[YapDatabaseRelationshipEdge alloc] initWithEdgeRowid:edgeRowid
+				                                                         name:name
+				                                                     srcRowid:srcRowid
+				                                                     dstRowid:dstRowid
+				                                                      dstData:dstFileURLData
+				                                                        rules:rules
+				                                                       manual:manual];
+				
+				[parentConnection->edgeCache setObject:edge forKey:@(edgeRowid)];
+			}
 			
-			[parentConnection->edgeCache setObject:edge forKey:@(edgeRowid)];
+			block(edge);
 		}
 		
-		block(edge);
-	}
-	
-	if (status != SQLITE_DONE)
-	{
-		YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD,
-		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_finalize(statement);
+		
+		offset += numRowidParams;
 	}
-	
-	sqlite_enum_reset(statement, needsFinalize);
 }
 
 /**
@@ -2691,6 +2928,35 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	sqlite3_stmt *statement = [parentConnection insertEdgeStatement];
 	if (statement == NULL) return;
 	
+	YapDatabaseString _name; MakeYapDatabaseString(&_name, edge->name);
+	
+	if (parentConnection->parent->options->internEdgeNames)
+	{
+		// The name needs to be in the names table first (the insert statement looks up its id).
+		
+		sqlite3_stmt *internStatement = [parentConnection internEdgeNameStatement];
+		if (internStatement == NULL) {
+			FreeYapDatabaseString(&_name);
+			return;
+		}
+		
+		// INSERT OR IGNORE INTO "namesTableName" ("string") VALUES (?);
+		
+		int const bind_idx_string = SQLITE_BIND_START;
+		
+		sqlite3_bind_text(internStatement, bind_idx_string, _name.str, _name.length, SQLITE_STATIC);
+		
+		int status = sqlite3_step(internStatement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - Error executing intern statement: %d %s", THIS_METHOD,
+			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		}
+		
+		sqlite3_clear_bindings(internStatement);
+		sqlite3_reset(internStatement);
+	}
+	
 	__attribute__((objc_precise_lifetime)) NSData *dstBlob = nil;
 	
 	// INSERT INTO "tableName" ("name", "src", "dst", "rules", "manual") VALUES (?, ?, ?, ?, ?);
@@ -2701,7 +2967,6 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	int const bind_idx_rules  = SQLITE_BIND_START + 3;
 	int const bind_idx_manual = SQLITE_BIND_START + 4;
 	
-	YapDatabaseString _name; MakeYapDatabaseString(&_name, edge->name);
 	sqlite3_bind_text(statement, bind_idx_name, _name.str, _name.length, SQLITE_STATIC);
 	
 	sqlite3_bind_int64(statement, bind_idx_src, edge->sourceRowid);
@@ -2733,6 +2998,7 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 		edge->flags = 0;
 		
 		[parentConnection->edgeCache setObject:edge forKey:@(edge->edgeRowid)];
+		[parentConnection didChangeEdgesWithSource:edge->sourceRowid];
 	}
 	else
 	{
@@ -2805,6 +3071,11 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	{
 		[parentConnection->edgeCache removeObjectForKey:@(edge->edgeRowid)];
 		
+		if (edge->state & YDB_EdgeState_HasSourceRowid)
+			[parentConnection didChangeEdgesWithSource:edge->sourceRowid];
+		else
+			[parentConnection->adjacencyCache removeAllObjects];
+		
 		[parentConnection->deletedEdges addObject:@(edge->edgeRowid)];
 		[parentConnection->modifiedEdges removeObjectForKey:@(edge->edgeRowid)];
 	}
@@ -2819,67 +3090,78 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 }
 
 /**
- * Helper method for executing the sqlite statement to delete all edges touching the given rowid.
+ * Helper method for executing the sqlite statement to delete all edges touching the given nodes.
+ * The given edges are the (previously enumerated) edges touching these nodes, which get recorded as deleted.
 **/
-- (void)deleteEdgesWithSourceOrDestination:(int64_t)rowid
+- (void)deleteEdges:(NSArray<YapDatabaseRelationshipEdge *> *)edges withNodes:(NSArray<NSNumber *> *)rowids
 {
 	// Step 1:
 	// First record the edges that are getting deleted
+	
+	for (YapDatabaseRelationshipEdge *edge in edges)
+	{
+		[parentConnection->deletedEdges addObject:@(edge->edgeRowid)];
+		[parentConnection didChangeEdgesWithSource:edge->sourceRowid];
+	}
+	
+	// Step 2:
+	// Then actually go ahead and delete the edges
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// We need to watch out for this in case a large array of rowids is passed.
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger offset = 0;
+	
+	while (offset < rowids.count)
 	{
-		sqlite3_stmt *statement = [parentConnection findEdgesWithNodeStatement];
-		if (statement == NULL) return;
+		NSUInteger left = rowids.count - offset;
+		NSUInteger numRowidParams = MIN(left, (maxHostParams / 2)); // each rowid is bound twice (src & dst)
 		
-		// SELECT "rowid" FROM "tableName" WHERE "src" = ? OR "dst" = ?;
+		// DELETE FROM "tableName" WHERE "src" IN (?, ?, ...) OR "dst" IN (?, ?, ...);
 		
-		int const column_idx_rowid = SQLITE_COLUMN_START;
+		NSMutableString *inClause = [NSMutableString stringWithCapacity:(numRowidParams * 3)];
 		
-		int const bind_idx_src = SQLITE_BIND_START + 0;
-		int const bind_idx_dst = SQLITE_BIND_START + 1;
+		NSUInteger i;
+		for (i = 0; i < numRowidParams; i++)
+		{
+			if (i == 0)
+				[inClause appendString:@"?"];
+			else
+				[inClause appendString:@", ?"];
+		}
 		
-		sqlite3_bind_int64(statement, bind_idx_src, rowid);
-		sqlite3_bind_int64(statement, bind_idx_dst, rowid);
+		NSString *query = [NSString stringWithFormat:
+		  @"DELETE FROM \"%@\" WHERE \"src\" IN (%@) OR \"dst\" IN (%@);", [self tableName], inClause, inClause];
 		
-		int status;
-		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		sqlite3_stmt *statement = NULL;
+		
+		int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
 		{
-			int64_t edgeRowid = sqlite3_column_int64(statement, column_idx_rowid);
+			YDBLogError(@"%@ - Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			break;
+		}
+		
+		for (i = 0; i < numRowidParams; i++)
+		{
+			int64_t rowid = [rowids[offset + i] longLongValue];
 			
-			[parentConnection->deletedEdges addObject:@(edgeRowid)];
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + numRowidParams + i), rowid);
 		}
 		
+		status = sqlite3_step(statement);
 		if (status != SQLITE_DONE)
 		{
-			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
-			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		sqlite3_clear_bindings(statement);
-		sqlite3_reset(statement);
-	}
-	
-	// Step 2:
-	// Then actually go ahead and delete the edges
-	{
-		sqlite3_stmt *statement = [parentConnection deleteEdgesWithNodeStatement];
-		if (statement == NULL) return;
-		
-		// DELETE FROM "tableName" WHERE "src" = ? OR "dst" = ?;
-		
-		int const bind_idx_src = SQLITE_BIND_START + 0;
-		int const bind_idx_dst = SQLITE_BIND_START + 1;
-		
-		sqlite3_bind_int64(statement, bind_idx_src, rowid);
-		sqlite3_bind_int64(statement, bind_idx_dst, rowid);
-		
-		int status = sqlite3_step(statement);
-		if (status != SQLITE_DONE)
-		{
-			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD,
-						status, sqlite3_errmsg(databaseTransaction->connection->db));
-		}
+		sqlite3_finalize(statement);
 		
-		sqlite3_clear_bindings(statement);
-		sqlite3_reset(statement);
+		offset += numRowidParams;
 	}
 }
 
@@ -2910,6 +3192,7 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	
 	sqlite3_reset(statement);
 	
+	[parentConnection->adjacencyCache removeAllObjects];
 	[parentConnection->protocolChanges removeAllObjects];
 }
 
@@ -3028,6 +3311,7 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	// Step 3: Flush pending change lists
 	
 	[parentConnection->edgeCache removeAllObjects];
+	[parentConnection->adjacencyCache removeAllObjects];
 	
 	[parentConnection->protocolChanges removeAllObjects];
 	[parentConnection->manualChanges removeAllObjects];
@@ -3037,10 +3321,335 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	
 	[parentConnection->modifiedEdges removeAllObjects];
 	[parentConnection->deletedEdges removeAllObjects];
+	[parentConnection->changedSources removeAllObjects];
 	
 	parentConnection->reset = YES;
 }
 
+/**
+ * Processes the nodeDeleteRules of an edge, where the source node (src) has been deleted.
+ * Destination nodes that should be deleted are added to nodesToDelete (rowid -> collectionKey).
+ *
+ * Reminder:
+ * The edge is only guaranteed to contain the information that's in the database row.
+ * To be more specific, it'll have the rowid's but the following values may be nil:
+ * - sourceKey/sourceCollection
+ * - destinationKey/destinationCollection
+ * - destinationFileURL
+**/
+- (void)processEdge:(YapDatabaseRelationshipEdge *)edge
+  withDeletedSource:(YapCollectionKey *)src
+      nodesToDelete:(NSMutableDictionary<NSNumber *, YapCollectionKey *> *)nodesToDelete
+{
+	int64_t srcRowid = edge->sourceRowid;
+	
+	if (edge->state & YDB_EdgeState_DestinationFileURL)
+	{
+		if (edge->nodeDeleteRules & YDB_DeleteDestinationIfAllSourcesDeleted)
+		{
+			// Delete the destination file IF there are no other edges pointing to it
+			
+			if (!(edge->state & YDB_EdgeState_HasDestinationFileURL))
+			{
+				[self lookupEdgeDestinationFileURL:edge];
+			}
+			
+			if (edge->destinationFileURL)
+			{
+				int64_t count = [self edgeCountWithDestinationFileURL:edge->destinationFileURL
+				                                      excludingSource:srcRowid];
+				if (count == 0)
+				{
+					// Mark the file for deletion
+					
+					[parentConnection->filesToDelete addObject:edge->destinationFileURL];
+				}
+			}
+		}
+		else if (edge->nodeDeleteRules & YDB_DeleteDestinationIfSourceDeleted)
+		{
+			// Mark the file for deletion
+			
+			if (!(edge->state & YDB_EdgeState_HasDestinationFileURL))
+			{
+				[self lookupEdgeDestinationFileURL:edge];
+			}
+			
+			if (edge->destinationFileURL) {
+				[parentConnection->filesToDelete addObject:edge->destinationFileURL];
+			}
+		}
+	}
+	else // if (!(edge->state & YDB_EdgeState_DestinationFileURL))
+	{
+		NSNumber *dstRowidNumber = @(edge->destinationRowid);
+		
+		if ([parentConnection->deletedInfo ydb_containsKey:dstRowidNumber] ||
+		    [nodesToDelete ydb_containsKey:dstRowidNumber])
+		{
+			// Both source and destination node have been deleted
+		}
+		else
+		{
+			BOOL shouldDeleteDestination = NO;
+			
+			if (edge->nodeDeleteRules & YDB_DeleteDestinationIfAllSourcesDeleted)
+			{
+				// Delete the destination node IF there are no other edges pointing to it
+				
+				int64_t count = [self edgeCountWithDestination:edge->destinationRowid
+				                               excludingSource:srcRowid];
+				if (count == 0)
+				{
+					shouldDeleteDestination = YES;
+				}
+			}
+			else if (edge->nodeDeleteRules & YDB_DeleteDestinationIfSourceDeleted)
+			{
+				shouldDeleteDestination = YES;
+			}
+			
+			// Note: YDB_NotifyIfSourceDeleted may be set in addition to the delete rules.
+			
+			if (edge->nodeDeleteRules & YDB_NotifyIfSourceDeleted)
+			{
+				// Notify the destination node
+				
+				if (edge->sourceKey == nil)
+				{
+					edge->sourceKey = src.key;
+					edge->sourceCollection = src.collection;
+				}
+				
+				YapCollectionKey *dst = nil;
+				
+				if (edge->destinationKey == nil)
+				{
+					dst = [databaseTransaction collectionKeyForRowid:edge->destinationRowid];
+					
+					edge->destinationKey = dst.key;
+					edge->destinationCollection = dst.collection;
+				}
+				
+				id dstNode = nil;
+				
+				if (dst)
+					dstNode = [databaseTransaction objectForCollectionKey:dst
+					                                            withRowid:edge->destinationRowid];
+				else
+					dstNode = [databaseTransaction objectForKey:edge->destinationKey
+					                               inCollection:edge->destinationCollection
+					                                  withRowid:edge->destinationRowid];
+				
+				SEL selector = @selector(yapDatabaseRelationshipEdgeDeleted:withReason:);
+				if ([dstNode respondsToSelector:selector])
+				{
+					id updatedDstNode =
+					  [dstNode yapDatabaseRelationshipEdgeDeleted:edge withReason:YDB_SourceNodeDeleted];
+					
+					if (shouldDeleteDestination)
+					{
+						// Don't bother writing the updated node to the database,
+						// since we're going to immediately delete it.
+					}
+					else if (updatedDstNode)
+					{
+						__unsafe_unretained YapDatabaseReadWriteTransaction *databaseRwTransaction =
+						  (YapDatabaseReadWriteTransaction *)databaseTransaction;
+						
+						[databaseRwTransaction replaceObject:updatedDstNode
+						                              forKey:edge->destinationKey
+						                        inCollection:edge->destinationCollection
+						                           withRowid:edge->destinationRowid
+						                    serializedObject:nil];
+					}
+				}
+			}
+			
+			if (shouldDeleteDestination)
+			{
+				// Schedule the destination node for deletion
+				
+				if (edge->destinationKey == nil)
+				{
+					YapCollectionKey *dst = [databaseTransaction collectionKeyForRowid:edge->destinationRowid];
+					
+					edge->destinationKey = dst.key;
+					edge->destinationCollection = dst.collection;
+				}
+				
+				if (edge->destinationKey)
+				{
+					YapCollectionKey *dst = [[YapCollectionKey alloc] initWithCollection:edge->destinationCollection
+					                                                                 key:edge->destinationKey];
+					
+					[nodesToDelete setObject:dst forKey:dstRowidNumber];
+				}
+			}
+		}
+	} // end else if (!dstFilePath)
+}
+
+/**
+ * Processes the nodeDeleteRules of an edge, where the destination node (dst) has been deleted.
+ * Source nodes that should be deleted are added to nodesToDelete (rowid -> collectionKey).
+ *
+ * Reminder:
+ * The edge is only guaranteed to contain the information that's in the database row.
+ * To be more specific, it'll have the rowid's but the following values may be nil:
+ * - sourceKey/sourceCollection
+ * - destinationKey/destinationCollection
+**/
+- (void)processEdge:(YapDatabaseRelationshipEdge *)edge
+  withDeletedDestination:(YapCollectionKey *)dst
+           nodesToDelete:(NSMutableDictionary<NSNumber *, YapCollectionKey *> *)nodesToDelete
+{
+	int64_t dstRowid = edge->destinationRowid;
+	
+	NSNumber *srcRowidNumber = @(edge->sourceRowid);
+	
+	if ([parentConnection->deletedInfo ydb_containsKey:srcRowidNumber] ||
+	    [nodesToDelete ydb_containsKey:srcRowidNumber])
+	{
+		// Both source and destination node have been deleted
+	}
+	else
+	{
+		BOOL shouldDeleteSource = NO;
+		
+		if (edge->nodeDeleteRules & YDB_DeleteSourceIfAllDestinationsDeleted)
+		{
+			// Delete the source node IF there are no other edges pointing from it
+			
+			int64_t count = [self edgeCountWithSource:edge->sourceRowid
+			                     excludingDestination:dstRowid];
+			if (count == 0)
+			{
+				shouldDeleteSource = YES;
+			}
+		}
+		else if (edge->nodeDeleteRules & YDB_DeleteSourceIfDestinationDeleted)
+		{
+			shouldDeleteSource = YES;
+		}
+		
+		// Note: YDB_NotifyIfDestinationDeleted may be set in addition to the delete rules.
+		
+		if (edge->nodeDeleteRules & YDB_NotifyIfDestinationDeleted)
+		{
+			// Notify the source node
+			
+			if (edge->destinationKey == nil)
+			{
+				edge->destinationKey = dst.key;
+				edge->destinationCollection = dst.collection;
+			}
+			
+			YapCollectionKey *src = nil;
+			
+			if (edge->sourceKey == nil)
+			{
+				src = [databaseTransaction collectionKeyForRowid:edge->sourceRowid];
+				
+				edge->sourceKey = src.key;
+				edge->sourceCollection = src.collection;
+			}
+			
+			id srcNode = nil;
+			
+			if (src)
+				srcNode = [databaseTransaction objectForCollectionKey:src withRowid:edge->sourceRowid];
+			else
+				srcNode = [databaseTransaction objectForKey:edge->sourceKey
+				                               inCollection:edge->sourceCollection
+				                                  withRowid:edge->sourceRowid];
+			
+			SEL selector = @selector(yapDatabaseRelationshipEdgeDeleted:withReason:);
+			if ([srcNode respondsToSelector:selector])
+			{
+				id updatedSrcNode =
+				  [srcNode yapDatabaseRelationshipEdgeDeleted:edge withReason:YDB_DestinationNodeDeleted];
+				
+				if (shouldDeleteSource)
+				{
+					// Don't bother writing the updated node to the database,
+					// since we're going to immediately delete it.
+				}
+				else if (updatedSrcNode)
+				{
+					__unsafe_unretained YapDatabaseReadWriteTransaction *databaseRwTransaction =
+					  (YapDatabaseReadWriteTransaction *)databaseTransaction;
+					
+					[databaseRwTransaction replaceObject:updatedSrcNode
+					                              forKey:edge->sourceKey
+					                        inCollection:edge->sourceCollection
+					                           withRowid:edge->sourceRowid
+					                    serializedObject:nil];
+				}
+			}
+		}
+		
+		if (shouldDeleteSource)
+		{
+			// Schedule the source node for deletion
+			
+			if (edge->sourceKey == nil)
+			{
+				YapCollectionKey *src = [databaseTransaction collectionKeyForRowid:edge->sourceRowid];
+				
+				edge->sourceKey = src.key;
+				edge->sourceCollection = src.collection;
+			}
+			
+			if (edge->sourceKey)
+			{
+				YapCollectionKey *src = [[YapCollectionKey alloc] initWithCollection:edge->sourceCollection
+				                                                                 key:edge->sourceKey];
+				
+				[nodesToDelete setObject:src forKey:srcRowidNumber];
+			}
+		}
+	}
+}
+
+/**
+ * Removes the given nodes (rowid -> collectionKey) from the database,
+ * using a single multi-remove per collection.
+ *
+ * The multi-remove hook appends the nodes to deletedOrder,
+ * so their edges get processed by the next batch of STEP 4.
+**/
+- (void)removeNodes:(NSDictionary<NSNumber *, YapCollectionKey *> *)nodes
+{
+	if (nodes.count == 0) return;
+	
+	NSMutableDictionary<NSString *, NSMutableArray<NSString *> *> *keysByCollection =
+	  [NSMutableDictionary dictionaryWithCapacity:1];
+	
+	for (YapCollectionKey *ck in [nodes objectEnumerator])
+	{
+		YDBLogVerbose(@"Deleting node: key(%@) collection(%@)", ck.key, ck.collection);
+		
+		NSMutableArray<NSString *> *keys = [keysByCollection objectForKey:ck.collection];
+		if (keys == nil)
+		{
+			keys = [NSMutableArray array];
+			[keysByCollection setObject:keys forKey:ck.collection];
+		}
+		
+		[keys addObject:ck.key];
+	}
+	
+	__unsafe_unretained YapDatabaseReadWriteTransaction *databaseRwTransaction =
+	  (YapDatabaseReadWriteTransaction *)databaseTransaction;
+	
+	for (NSString *collection in keysByCollection)
+	{
+		[databaseRwTransaction removeObjectsForKeys:[keysByCollection objectForKey:collection]
+		                               inCollection:collection];
+	}
+}
+
 - (void)flush
 {
 	YDBLogAutoTrace();
@@ -3525,335 +4134,82 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	//
 	// Process all the deleted nodes.
 	// For each deleted node we're going to enumerate all connected edges.
-	// First the edges where the deleted node is the source.
-	// Then the edges where the deleted node is the destination.
+	// That is, the edges where the deleted node is the source, and the edges where it's the destination.
 	//
 	// Note that at this point, the database is up-to-date (we've written all changes).
 	// So we can simply enumerate and query the database without any fuss.
+	//
+	// The deleted nodes are processed in batches:
+	// - a single query fetches the edges connected to any node in the batch
+	// - a single statement deletes all these edges
+	// - the nodeDeleteRules of the fetched edges are processed
+	// - the nodes that need to be deleted (due to the rules) are removed in bulk
+	//
+	// Removing the nodes appends them to deletedOrder,
+	// so cascading deletes are processed by the next batch (one batch per level of the cascade).
+	
+	NSUInteger maxBatchSize = (NSUInteger) sqlite3_limit(databaseTransaction->connection->db,
+	                                                     SQLITE_LIMIT_VARIABLE_NUMBER, -1);
 	
 	NSUInteger i = 0;
 	while (i < [parentConnection->deletedOrder count])
-	{
-		NSNumber *deletedRowidNumber = [parentConnection->deletedOrder objectAtIndex:i];
-		int64_t deletedRowid = deletedRowidNumber.longLongValue;
+	{ @autoreleasepool {
 		
-		YapCollectionKey *deletedCollectionKey = [parentConnection->deletedInfo objectForKey:deletedRowidNumber];
+		NSUInteger batchSize = MIN([parentConnection->deletedOrder count] - i, maxBatchSize);
 		
-		{ // Enumerate all edges where source node is the deleted node
-	
-			int64_t srcRowid = deletedRowid;
-			YapCollectionKey *src = deletedCollectionKey;
+		NSArray<NSNumber *> *batch = [parentConnection->deletedOrder subarrayWithRange:NSMakeRange(i, batchSize)];
+		NSSet<NSNumber *> *batchSet = [NSSet setWithArray:batch];
+		
+		NSMutableArray<YapDatabaseRelationshipEdge *> *edges = [NSMutableArray array];
+		
+		[self enumerateExistingEdgesWithNodes:batch usingBlock:^(YapDatabaseRelationshipEdge *edge) {
 			
-			[self enumerateExistingEdgesWithSource:srcRowid usingBlock:^(YapDatabaseRelationshipEdge *edge) {
-			#pragma clang diagnostic push
-			#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-				
-				// Reminder:
-				//
-				// When using the enumerateExistingEdges...:: method,
-				// the 'edges' parameter is only guaranteed to contain the information that's in the database row.
-				//
-				// To be more specific, they'll have the rowid's but the following values may be nil:
-				// - sourceKey/sourceCollection
-				// - destinationKey/destinationCollection
-				// - destinationFileURL
-				
-				if (edge->state & YDB_EdgeState_DestinationFileURL)
-				{
-					if (edge->nodeDeleteRules & YDB_DeleteDestinationIfAllSourcesDeleted)
-					{
-						// Delete the destination file IF there are no other edges pointing to it
-						
-						if (!(edge->state & YDB_EdgeState_HasDestinationFileURL))
-						{
-							[self lookupEdgeDestinationFileURL:edge];
-						}
-						
-						if (edge->destinationFileURL)
-						{
-							int64_t count = [self edgeCountWithDestinationFileURL:edge->destinationFileURL
-							                                      excludingSource:srcRowid];
-							if (count == 0)
-							{
-								// Mark the file for deletion
-								
-								[parentConnection->filesToDelete addObject:edge->destinationFileURL];
-							}
-						}
-					}
-					else if (edge->nodeDeleteRules & YDB_DeleteDestinationIfSourceDeleted)
-					{
-						// Mark the file for deletion
-						
-						if (!(edge->state & YDB_EdgeState_HasDestinationFileURL))
-						{
-							[self lookupEdgeDestinationFileURL:edge];
-						}
-						
-						if (edge->destinationFileURL) {
-							[parentConnection->filesToDelete addObject:edge->destinationFileURL];
-						}
-					}
-				}
-				else // if (!(edge->state & YDB_EdgeState_DestinationFileURL))
-				{
-					if ([parentConnection->deletedInfo ydb_containsKey:@(edge->destinationRowid)])
-					{
-						// Both source and destination node have been deleted
-					}
-					else
-					{
-						BOOL shouldDeleteDestination = NO;
-						
-						if (edge->nodeDeleteRules & YDB_DeleteDestinationIfAllSourcesDeleted)
-						{
-							// Delete the destination node IF there are no other edges pointing to it
-							
-							int64_t count = [self edgeCountWithDestination:edge->destinationRowid
-                                                           excludingSource:srcRowid];
-							if (count == 0)
-							{
-								shouldDeleteDestination = YES;
-							}
-						}
-						else if (edge->nodeDeleteRules & YDB_DeleteDestinationIfSourceDeleted)
-						{
-							shouldDeleteDestination = YES;
-						}
-						
-						// Note: YDB_NotifyIfSourceDeleted may be set in addition to the delete rules.
-						
-						if (edge->nodeDeleteRules & YDB_NotifyIfSourceDeleted)
-						{
-							// Notify the destination node
-							
-							if (edge->sourceKey == nil)
-							{
-								edge->destinationKey = src.key;
-								edge->destinationCollection = src.collection;
-							}
-							
-							YapCollectionKey *dst = nil;
-							
-							if (edge->destinationKey == nil)
-							{
-								dst = [databaseTransaction collectionKeyForRowid:edge->destinationRowid];
-								
-								edge->destinationKey = dst.key;
-								edge->destinationCollection = dst.collection;
-							}
-							
-							id dstNode = nil;
-							
-							if (dst)
-								dstNode = [databaseTransaction objectForCollectionKey:dst
-								                                            withRowid:edge->destinationRowid];
-							else
-								dstNode = [databaseTransaction objectForKey:edge->destinationKey
-								                               inCollection:edge->destinationCollection
-								                                  withRowid:edge->destinationRowid];
-							
-							SEL selector = @selector(yapDatabaseRelationshipEdgeDeleted:withReason:);
-							if ([dstNode respondsToSelector:selector])
-							{
-								id updatedDstNode =
-								  [dstNode yapDatabaseRelationshipEdgeDeleted:edge withReason:YDB_SourceNodeDeleted];
-								
-								if (shouldDeleteDestination)
-								{
-									// Don't bother writing the updated node to the database,
-									// since we're going to immediately delete it.
-								}
-								else if (updatedDstNode)
-								{
-									__unsafe_unretained YapDatabaseReadWriteTransaction *databaseRwTransaction =
-									  (YapDatabaseReadWriteTransaction *)databaseTransaction;
-									
-									[databaseRwTransaction replaceObject:updatedDstNode
-									                              forKey:edge->destinationKey
-									                        inCollection:edge->destinationCollection
-									                           withRowid:edge->destinationRowid
-									                    serializedObject:nil];
-								}
-							}
-						}
-						
-						if (shouldDeleteDestination)
-						{
-							// Delete the destination node
-							
-							YapCollectionKey *dst = nil;
-							
-							if (edge->destinationKey == nil)
-							{
-								dst = [databaseTransaction collectionKeyForRowid:edge->destinationRowid];
-								
-								edge->destinationKey = dst.key;
-								edge->destinationCollection = dst.collection;
-							}
-							
-							YDBLogVerbose(@"Deleting destination node: key(%@) collection(%@)",
-							              edge->destinationKey, edge->destinationCollection);
-							
-							__unsafe_unretained YapDatabaseReadWriteTransaction *databaseRwTransaction =
-							  (YapDatabaseReadWriteTransaction *)databaseTransaction;
-							
-							if (dst)
-								[databaseRwTransaction removeObjectForCollectionKey:dst
-								                                          withRowid:edge->destinationRowid];
-							else
-								[databaseRwTransaction removeObjectForKey:edge->destinationKey
-								                             inCollection:edge->destinationCollection
-								                                withRowid:edge->destinationRowid];
-						}
-					}
-				} // end else if (!dstFilePath)
-				
-			#pragma clang diagnostic pop
-			}]; // end enumerateExistingRowsWithSrc:usingBlock:
+			[edges addObject:edge];
+		}];
 		
-		} // end "Enumerate all edges where source node is the deleted node"
+		// Delete all the edges from the database where src or dst is one of the deleted nodes.
+		//
+		// This is done before processing the rules,
+		// so the edge counts (for the "IfAll...Deleted" rules) exclude every edge of the batch.
 		
+		[self deleteEdges:edges withNodes:batch];
 		
-		{ // Enumerate all edges where destination node is the deleted node
-
-			int64_t dstRowid = deletedRowid;
-			YapCollectionKey *dst = deletedCollectionKey;
+		NSMutableDictionary<NSNumber *, YapCollectionKey *> *nodesToDelete = [NSMutableDictionary dictionary];
+		
+		// Process all edges where the source node is a deleted node
+		
+		for (YapDatabaseRelationshipEdge *edge in edges)
+		{
+			NSNumber *srcRowidNumber = @(edge->sourceRowid);
 			
-			[self enumerateExistingEdgesWithDestination:dstRowid usingBlock:^(YapDatabaseRelationshipEdge *edge) {
-			#pragma clang diagnostic push
-			#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-				
-				// Reminder:
-				//
-				// When using the enumerateExistingEdges...:: method,
-				// the 'edges' parameter is only guaranteed to contain the information that's in the database row.
-				//
-				// To be more specific, they'll have the rowid's but the following values may be nil:
-				// - sourceKey/sourceCollection
-				// - destinationKey/destinationCollection
-				// - destinationFileURL
+			if ([batchSet containsObject:srcRowidNumber])
+			{
+				YapCollectionKey *src = [parentConnection->deletedInfo objectForKey:srcRowidNumber];
 				
-				if ([parentConnection->deletedInfo ydb_containsKey:@(edge->sourceRowid)])
-				{
-					// Both source and destination node have been deleted
-				}
-				else
-				{
-					BOOL shouldDeleteSource = NO;
-					
-					if (edge->nodeDeleteRules & YDB_DeleteSourceIfAllDestinationsDeleted)
-					{
-						// Delete the source node IF there are no other edges pointing from it
-						
-						int64_t count = [self edgeCountWithSource:edge->sourceRowid
-                                             excludingDestination:dstRowid];
-						if (count == 0)
-						{
-							shouldDeleteSource = YES;
-						}
-					}
-					else if (edge->nodeDeleteRules & YDB_DeleteSourceIfDestinationDeleted)
-					{
-						shouldDeleteSource = YES;
-					}
-					
-					// Note: YDB_NotifyIfDestinationDeleted may be set in addition to the delete rules.
-					
-					if (edge->nodeDeleteRules & YDB_NotifyIfDestinationDeleted)
-					{
-						// Notify the source node
-						
-						if (edge->destinationKey == nil)
-						{
-							edge->destinationKey = dst.key;
-							edge->destinationCollection = dst.collection;
-						}
-						
-						YapCollectionKey *src = nil;
-						
-						if (edge->sourceKey == nil)
-						{
-							src = [databaseTransaction collectionKeyForRowid:edge->sourceRowid];
-							
-							edge->sourceKey = src.key;
-							edge->sourceCollection = src.collection;
-						}
-						
-						id srcNode = nil;
-						
-						if (src)
-							srcNode = [databaseTransaction objectForCollectionKey:src withRowid:edge->sourceRowid];
-						else
-							srcNode = [databaseTransaction objectForKey:edge->sourceKey
-						                                   inCollection:edge->sourceCollection
-						                                      withRowid:edge->sourceRowid];
-						
-						SEL selector = @selector(yapDatabaseRelationshipEdgeDeleted:withReason:);
-						if ([srcNode respondsToSelector:selector])
-						{
-							id updatedSrcNode =
-							  [srcNode yapDatabaseRelationshipEdgeDeleted:edge withReason:YDB_DestinationNodeDeleted];
-							
-							if (shouldDeleteSource)
-							{
-								// Don't bother writing the updated node to the database,
-								// since we're going to immediately delete it.
-							}
-							else if (updatedSrcNode)
-							{
-								__unsafe_unretained YapDatabaseReadWriteTransaction *databaseRwTransaction =
-								  (YapDatabaseReadWriteTransaction *)databaseTransaction;
-								
-								[databaseRwTransaction replaceObject:updatedSrcNode
-								                              forKey:edge->sourceKey
-								                        inCollection:edge->sourceCollection
-								                           withRowid:edge->sourceRowid
-								                    serializedObject:nil];
-							}
-						}
-					}
-					
-					if (shouldDeleteSource)
-					{
-						// Delete the source node
-						
-						YapCollectionKey *src = nil;
-						
-						if (edge->sourceKey == nil)
-						{
-							src = [databaseTransaction collectionKeyForRowid:edge->sourceRowid];
-							
-							edge->sourceKey = src.key;
-							edge->sourceCollection = src.collection;
-						}
-						
-						YDBLogVerbose(@"Deleting source node: key(%@) collection(%@)",
-						              edge->sourceKey, edge->sourceCollection);
-						
-						__unsafe_unretained YapDatabaseReadWriteTransaction *databaseRwTransaction =
-						  (YapDatabaseReadWriteTransaction *)databaseTransaction;
-						
-						if (src)
-							[databaseRwTransaction removeObjectForCollectionKey:src
-							                                          withRowid:edge->sourceRowid];
-						else
-							[databaseRwTransaction removeObjectForKey:edge->sourceKey
-							                             inCollection:edge->sourceCollection
-							                                withRowid:edge->sourceRowid];
-					}
-				}
-			
-			#pragma clang diagnostic pop
-			}]; // end enumerateExistingRowsWithDst:usingBlock:
+				[self processEdge:edge withDeletedSource:src nodesToDelete:nodesToDelete];
+			}
+		}
+		
+		// Process all edges where the destination node is a deleted node
 		
-		} // end "Enumerate all edges where destination node is the deleted node"
+		for (YapDatabaseRelationshipEdge *edge in edges)
+		{
+			if (edge->state & YDB_EdgeState_DestinationFileURL) continue;
+			
+			NSNumber *dstRowidNumber = @(edge->destinationRowid);
+			
+			if ([batchSet containsObject:dstRowidNumber])
+			{
+				YapCollectionKey *dst = [parentConnection->deletedInfo objectForKey:dstRowidNumber];
+				
+				[self processEdge:edge withDeletedDestination:dst nodesToDelete:nodesToDelete];
+			}
+		}
 		
-		// Delete all the edges from the database where src or dst is the deleted node
-		[self deleteEdgesWithSourceOrDestination:deletedRowid];
+		[self removeNodes:nodesToDelete];
 		
-		i++;
-	}
+		i += batchSize;
+	}}
 	
 	[parentConnection->inserted removeAllObjects];
 	[parentConnection->deletedInfo removeAllObjects];
@@ -3898,6 +4254,43 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	return YES;
 }
 
+/**
+ * YapDatabaseExtensionTransaction subclass hook.
+ * Invoked right before the readWriteTransaction commits.
+ *
+ * Stores the files to delete in the files table, within the same transaction that deleted the edges.
+**/
+- (void)flushPendingChangesToExtensionTables
+{
+	YDBLogAutoTrace();
+	
+	if ([parentConnection->filesToDelete count] == 0) return;
+	
+	sqlite3_stmt *statement = [parentConnection insertFileStatement];
+	if (statement == NULL) return;
+	
+	// INSERT OR IGNORE INTO "filesTableName" ("url") VALUES (?);
+	
+	int const bind_idx_url = SQLITE_BIND_START;
+	
+	for (NSURL *fileURL in parentConnection->filesToDelete)
+	{
+		YapDatabaseString _url; MakeYapDatabaseString(&_url, [fileURL absoluteString]);
+		sqlite3_bind_text(statement, bind_idx_url, _url.str, _url.length, SQLITE_STATIC);
+		
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD,
+			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		FreeYapDatabaseString(&_url);
+	}
+}
+
 /**
  * This method is only called if within a readwrite transaction.
 **/
@@ -3914,22 +4307,7 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 		//
 		// See: [parentConnection postCommitCleanup];
 		
-		NSSet *filesToDelete = parentConnection->filesToDelete;
-		
-		dispatch_queue_t fileManagerQueue = [parentConnection->parent fileManagerQueue];
-		dispatch_async(fileManagerQueue, ^{ @autoreleasepool {
-			
-			NSFileManager *fileManager = [NSFileManager defaultManager];
-			
-			for (NSURL *fileURL in filesToDelete)
-			{
-				NSError *error = nil;
-				if (![fileManager removeItemAtURL:fileURL error:&error])
-				{
-					YDBLogWarn(@"Error removing file (%@): %@", [fileURL path], error);
-				}
-			}
-		}});
+		[parentConnection->parent deleteFiles:parentConnection->filesToDelete];
 	}
 	
 	// Commit is complete.
@@ -3989,7 +4367,7 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	if (options->disableYapDatabaseRelationshipNodeProtocol) {
 		return;
 	}
-	if (options->allowedCollections && ![options->allowedCollections isAllowed:collectionKey.collection]) {
+	if (options->allowedCollections && ![options->allowedCollections isAllowedCollectionKey:collectionKey]) {
 		return;
 	}
 	
@@ -4058,7 +4436,7 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	if (options->disableYapDatabaseRelationshipNodeProtocol) {
 		return;
 	}
-	if (options->allowedCollections && ![options->allowedCollections isAllowed:collectionKey.collection]) {
+	if (options->allowedCollections && ![options->allowedCollections isAllowedCollectionKey:collectionKey]) {
 		return;
 	}
 	
@@ -4116,7 +4494,7 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	if (options->disableYapDatabaseRelationshipNodeProtocol) {
 		return;
 	}
-	if (options->allowedCollections && ![options->allowedCollections isAllowed:collectionKey.collection]) {
+	if (options->allowedCollections && ![options->allowedCollections isAllowedCollectionKey:collectionKey]) {
 		return;
 	}
 	
@@ -4228,40 +4606,118 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 {
 	YDBLogAutoTrace();
 	
-	if (isFlushing)
+	// Note: This method may be called during flush processing due to an edge's nodeDeleteRules.
+	
+	NSUInteger i = 0;
+	for (NSNumber *srcRowidNumber in rowids)
+	{
+		NSString *key = [keys objectAtIndex:i];
+		YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		[parentConnection->deletedOrder addObject:srcRowidNumber];
+		[parentConnection->deletedInfo setObject:collectionKey forKey:srcRowidNumber];
+		
+		i++;
+	}
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didRemoveAllObjectsInAllCollections
+{
+	YDBLogAutoTrace();
+	
+	if (isFlushing)
+	{
+		YDBLogError(@"Unable to handle remove-all hook during flush processing");
+		return;
+	}
+	
+	[self removeAllEdges];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Private API - Files
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the list of files pending deletion (stored in the files table).
+**/
+- (NSArray<NSURL *> *)pendingFileURLs
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *query = [NSString stringWithFormat:
+	  @"SELECT \"url\" FROM \"%@\";", [parentConnection->parent filesTableName]];
+	
+	sqlite3_stmt *statement = NULL;
+	
+	int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
 	{
-		YDBLogError(@"Unable to handle multi-remove hook during flush processing");
-		return;
+		YDBLogError(@"%@ - Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return nil;
 	}
 	
-	NSUInteger i = 0;
-	for (NSNumber *srcRowidNumber in rowids)
+	NSMutableArray<NSURL *> *fileURLs = [NSMutableArray array];
+	
+	int const column_idx_url = SQLITE_COLUMN_START;
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
-		NSString *key = [keys objectAtIndex:i];
-		YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_url);
+		int textSize = sqlite3_column_bytes(statement, column_idx_url);
 		
-		[parentConnection->deletedOrder addObject:srcRowidNumber];
-		[parentConnection->deletedInfo setObject:collectionKey forKey:srcRowidNumber];
+		NSString *urlString = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		NSURL *fileURL = urlString ? [NSURL URLWithString:urlString] : nil;
 		
-		i++;
+		if (fileURL) {
+			[fileURLs addObject:fileURL];
+		}
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 	}
+	
+	sqlite3_finalize(statement);
+	
+	return fileURLs;
 }
 
 /**
- * YapDatabase extension hook.
- * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+ * Removes the given files from the files table (after they've been deleted).
 **/
-- (void)didRemoveAllObjectsInAllCollections
+- (void)removePendingFileURLs:(NSArray<NSURL *> *)fileURLs
 {
-	YDBLogAutoTrace();
+	if (!databaseTransaction->isReadWriteTransaction) return;
 	
-	if (isFlushing)
+	sqlite3_stmt *statement = [parentConnection removeFileStatement];
+	if (statement == NULL) return;
+	
+	// DELETE FROM "filesTableName" WHERE "url" = ?;
+	
+	int const bind_idx_url = SQLITE_BIND_START;
+	
+	for (NSURL *fileURL in fileURLs)
 	{
-		YDBLogError(@"Unable to handle remove-all hook during flush processing");
-		return;
+		YapDatabaseString _url; MakeYapDatabaseString(&_url, [fileURL absoluteString]);
+		sqlite3_bind_text(statement, bind_idx_url, _url.str, _url.length, SQLITE_STATIC);
+		
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD,
+			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		FreeYapDatabaseString(&_url);
 	}
-	
-	[self removeAllEdges];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -4502,6 +4958,32 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	}
 }
 
+/**
+ * Returns the (disk) edges with the given source & name, if they're all in memory.
+ * That is, if the adjacencyCache has an entry for the source & name, and all the edges are in the edgeCache.
+ * Otherwise returns nil, and the edges need to be fetched from disk.
+ *
+ * Edges deleted by other connections are removed from the edgeCache,
+ * so a stale entry for a deleted edge always results in a cache miss.
+**/
+- (NSArray<YapDatabaseRelationshipEdge *> *)cachedEdgesWithSource:(int64_t)srcRowid name:(NSString *)name
+{
+	NSArray<NSNumber *> *edgeRowids = [parentConnection cachedEdgeRowidsWithSource:srcRowid name:name];
+	if (edgeRowids == nil) return nil;
+	
+	NSMutableArray<YapDatabaseRelationshipEdge *> *edges = [NSMutableArray arrayWithCapacity:edgeRowids.count];
+	
+	for (NSNumber *edgeRowid in edgeRowids)
+	{
+		YapDatabaseRelationshipEdge *edge = [parentConnection->edgeCache objectForKey:edgeRowid];
+		if (edge == nil) return nil;
+		
+		[edges addObject:edge];
+	}
+	
+	return edges;
+}
+
 /**
  * Enumerates every edge that matches any parameters you specify.
  * You can specify any combination of the following:
@@ -4555,11 +5037,23 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	// Enumerate the items already in the database
 	if (hasSrcRowid)
 	{
-		BOOL needsFinalize;
-		sqlite3_stmt *statement;
+		// Check the adjacencyCache first.
+		// If we know the rowids of the edges, and all these edges are in the edgeCache, we can skip the query.
+		
+		NSArray<YapDatabaseRelationshipEdge *> *cachedEdges = [self cachedEdgesWithSource:srcRowid name:name];
+		NSUInteger cachedEdgesIndex = 0;
+		
+		NSMutableArray<NSNumber *> *edgeRowids = cachedEdges ? nil : [NSMutableArray array];
+		
+		BOOL needsFinalize = NO;
+		sqlite3_stmt *statement = NULL;
 		YapDatabaseString _name;
 		
-		if (name)
+		if (cachedEdges)
+		{
+			// Nothing to prepare
+		}
+		else if (name)
 		{
 			statement = [parentConnection enumerateForSrcNameStatement:&needsFinalize];
 			if (statement == NULL)
@@ -4588,12 +5082,17 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 			sqlite3_bind_int64(statement, bind_idx_src, srcRowid);
 		}
 		
-		int status;
-		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		int status = SQLITE_DONE;
+		while (cachedEdges ? (cachedEdgesIndex < cachedEdges.count)
+		                   : ((status = sqlite3_step(statement)) == SQLITE_ROW))
 		{
 			YapDatabaseRelationshipEdge *edge = nil;
 			
-			if (name)
+			if (cachedEdges)
+			{
+				edge = cachedEdges[cachedEdgesIndex++];
+			}
+			else if (name)
 			{
 				// SELECT "rowid", "dst", "rules", "manual" FROM "tableName" WHERE "src" = ? AND "name" = ?;",
 				
@@ -4715,6 +5214,8 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 				}
 			}
 			
+			[edgeRowids addObject:@(edge->edgeRowid)];
+			
 			// Fill out known edge information (if missing)
 			
 			if (edge->sourceKey == nil)
@@ -4777,15 +5278,25 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 			if (stop) break;
 		}
 		
-		if (status != SQLITE_DONE && !stop)
+		if (cachedEdges == nil)
 		{
-			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD,
-			            status, sqlite3_errmsg(databaseTransaction->connection->db));
-		}
-		
-		sqlite_enum_reset(statement,needsFinalize);
-		if (name) {
-			FreeYapDatabaseString(&_name);
+			if (status != SQLITE_DONE && !stop)
+			{
+				YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD,
+				            status, sqlite3_errmsg(databaseTransaction->connection->db));
+			}
+			
+			sqlite_enum_reset(statement,needsFinalize);
+			if (name) {
+				FreeYapDatabaseString(&_name);
+			}
+			
+			// Remember the edges of the source node (including when there aren't any)
+			
+			if (status == SQLITE_DONE)
+			{
+				[parentConnection setCachedEdgeRowids:edgeRowids withSource:srcRowid name:name];
+			}
 		}
 		
 		if (stop) return;
@@ -6220,6 +6731,327 @@ NS_INLINE BOOL URLMatchesURL(NSURL *url1, NSURL *url2)
 	}];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Private API - Traversal
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns YES if there are changes to the graph (in memory) that haven't been written to disk yet.
+ * These are processed during the next flush.
+**/
+- (BOOL)hasUnprocessedChanges
+{
+	if (!databaseTransaction->isReadWriteTransaction)
+		return NO;
+	
+	return ([parentConnection->protocolChanges count] > 0 ||
+	        [parentConnection->manualChanges   count] > 0 ||
+	        [parentConnection->deletedInfo     count] > 0 ||
+	        [parentConnection->deletedOrder    count] > 0  );
+}
+
+/**
+ * Loads the neighbors (rowids) of each of the given nodes into the given dictionary.
+ * Every given node gets an entry, even if it doesn't have any neighbors.
+ * 
+ * This method reads the edges directly from disk,
+ * using a single "IN (?, ?, ...)" query per SQLITE_LIMIT_VARIABLE_NUMBER nodes.
+ * So it must only be used if there aren't any unprocessed changes.
+**/
+- (void)loadNeighborsFromDiskForRowids:(NSArray<NSNumber *> *)rowids
+                              edgeName:(NSString *)name
+                             direction:(YapDatabaseRelationshipTraversalDirection)direction
+                                  into:(NSMutableDictionary<NSNumber *, NSMutableArray<NSNumber *> *> *)neighbors
+{
+	for (NSNumber *rowid in rowids)
+	{
+		[neighbors setObject:[NSMutableArray array] forKey:rowid];
+	}
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *nodeColumn     = (direction == YapDatabaseRelationshipTraversalDirectionOutgoing) ? @"src" : @"dst";
+	NSString *neighborColumn = (direction == YapDatabaseRelationshipTraversalDirectionOutgoing) ? @"dst" : @"src";
+	
+	int const column_idx_node     = SQLITE_COLUMN_START + 0;
+	int const column_idx_neighbor = SQLITE_COLUMN_START + 1;
+	
+	YapDatabaseString _name; MakeYapDatabaseString(&_name, name);
+	
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// We need to watch out for this in case a large array of rowids is passed.
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger offset = 0;
+	
+	while (offset < rowids.count)
+	{
+		NSUInteger left = rowids.count - offset;
+		NSUInteger numRowidParams = MIN(left, (maxHostParams-1)); // minus 1 for name param
+		
+		// SELECT "src", "dst" FROM "tableName" WHERE "src" IN (?, ?, ...) AND "name" = ?;
+		
+		NSMutableString *query = [NSMutableString stringWithCapacity:(100 + (numRowidParams * 3))];
+		[query appendFormat:@"SELECT \"%@\", \"%@\" FROM \"%@\" WHERE \"%@\" IN (",
+		  nodeColumn, neighborColumn, [self tableName], nodeColumn];
+		
+		NSUInteger i;
+		for (i = 0; i < numRowidParams; i++)
+		{
+			if (i == 0)
+				[query appendString:@"?"];
+			else
+				[query appendString:@", ?"];
+		}
+		
+		[query appendString:@")"];
+		
+		if (name)
+			[query appendFormat:@" AND \"name\" = %@", [parentConnection->parent edgeNameParameter]];
+		
+		[query appendString:@";"];
+		
+		sqlite3_stmt *statement = NULL;
+		
+		int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			break;
+		}
+		
+		for (i = 0; i < numRowidParams; i++)
+		{
+			int64_t rowid = [rowids[offset + i] longLongValue];
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
+		}
+		
+		if (name)
+		{
+			int bind_idx_name = (int)(SQLITE_BIND_START + numRowidParams);
+			sqlite3_bind_text(statement, bind_idx_name, _name.str, _name.length, SQLITE_STATIC);
+		}
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			// The dst column may also contain a fileURL (blob), which isn't a node.
+			
+			if (sqlite3_column_type(statement, column_idx_neighbor) != SQLITE_INTEGER)
+				continue;
+			
+			int64_t nodeRowid = sqlite3_column_int64(statement, column_idx_node);
+			int64_t neighborRowid = sqlite3_column_int64(statement, column_idx_neighbor);
+			
+			[[neighbors objectForKey:@(nodeRowid)] addObject:@(neighborRowid)];
+		}
+		
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - Error executing statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_finalize(statement);
+		
+		offset += numRowidParams;
+	}
+	
+	FreeYapDatabaseString(&_name);
+}
+
+/**
+ * Loads the neighbors (rowids) of the given node into the given dictionary.
+ * 
+ * This method takes the in-memory changes into account (at the cost of a query per node).
+**/
+- (void)loadNeighborsForRowid:(NSNumber *)rowidNumber
+                     edgeName:(NSString *)name
+                    direction:(YapDatabaseRelationshipTraversalDirection)direction
+                         into:(NSMutableDictionary<NSNumber *, NSMutableArray<NSNumber *> *> *)neighbors
+{
+	NSMutableArray<NSNumber *> *nodeNeighbors = [NSMutableArray array];
+	[neighbors setObject:nodeNeighbors forKey:rowidNumber];
+	
+	YapCollectionKey *ck = [databaseTransaction collectionKeyForRowid:[rowidNumber longLongValue]];
+	if (ck == nil) return;
+	
+	if (direction == YapDatabaseRelationshipTraversalDirectionOutgoing)
+	{
+		[self _enumerateEdgesWithName:name
+		                    sourceKey:ck.key
+		                   collection:ck.collection
+		                   usingBlock:^(YapDatabaseRelationshipEdge *edge, BOOL __unused *stop)
+		{
+			if (!(edge->state & YDB_EdgeState_DestinationFileURL) &&
+			     (edge->state & YDB_EdgeState_HasDestinationRowid))
+			{
+				[nodeNeighbors addObject:@(edge->destinationRowid)];
+			}
+		}];
+	}
+	else
+	{
+		[self _enumerateEdgesWithName:name
+		               destinationKey:ck.key
+		                   collection:ck.collection
+		                   usingBlock:^(YapDatabaseRelationshipEdge *edge, BOOL __unused *stop)
+		{
+			if (edge->state & YDB_EdgeState_HasSourceRowid)
+			{
+				[nodeNeighbors addObject:@(edge->sourceRowid)];
+			}
+		}];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Public API - Traversal
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Enumerates every node reachable from the given node, by following edges (with the given name) in the given direction.
+ * See the header file for the full documentation.
+**/
+- (void)enumerateNodesFromKey:(NSString *)key
+                   collection:(NSString *)collection
+                     edgeName:(NSString *)name
+                    direction:(YapDatabaseRelationshipTraversalDirection)direction
+                        order:(YapDatabaseRelationshipTraversalOrder)order
+                     maxDepth:(NSUInteger)maxDepth
+                   usingBlock:(void (^)(NSString *collection, NSString *key, NSUInteger depth, BOOL *stop))block
+{
+	if (key == nil) return;
+	if (block == NULL) return;
+	
+	if (collection == nil)
+		collection = @"";
+	
+	int64_t startRowid = 0;
+	if (![databaseTransaction getRowid:&startRowid forKey:key inCollection:collection])
+		return;
+	
+	BOOL hasUnprocessedChanges = [self hasUnprocessedChanges];
+	BOOL depthFirst = (order == YapDatabaseRelationshipTraversalOrderDepthFirst);
+	
+	NSUInteger maxBatchSize = 1;
+	if (!hasUnprocessedChanges)
+	{
+		sqlite3 *db = databaseTransaction->connection->db;
+		maxBatchSize = (NSUInteger) sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1) - 1; // minus 1 for name param
+	}
+	
+	// The depth of every discovered node (key:rowid, value:depth).
+	// A node is discovered (and thus visited) only once.
+	
+	NSMutableDictionary<NSNumber *, NSNumber *> *depths = [NSMutableDictionary dictionary];
+	
+	// The neighbors of the pending nodes that have been loaded (key:rowid, value:rowids).
+	
+	NSMutableDictionary<NSNumber *, NSMutableArray<NSNumber *> *> *neighbors = [NSMutableDictionary dictionary];
+	
+	// The discovered nodes that are waiting to be visited.
+	// Breadth-first takes them from the front (queue), depth-first from the back (stack).
+	
+	NSMutableArray<NSNumber *> *pending = [NSMutableArray array];
+	
+	[depths setObject:@(0) forKey:@(startRowid)];
+	[pending addObject:@(startRowid)];
+	
+	BOOL stop = NO;
+	
+	while (pending.count > 0)
+	{ @autoreleasepool {
+		
+		NSNumber *rowidNumber = nil;
+		if (depthFirst)
+		{
+			rowidNumber = [pending lastObject];
+			[pending removeLastObject];
+		}
+		else
+		{
+			rowidNumber = [pending firstObject];
+			[pending removeObjectAtIndex:0];
+		}
+		
+		NSUInteger depth = [[depths objectForKey:rowidNumber] unsignedIntegerValue];
+		
+		if (depth > 0)
+		{
+			YapCollectionKey *ck = [databaseTransaction collectionKeyForRowid:[rowidNumber longLongValue]];
+			if (ck == nil)
+			{
+				// Edge to a node that no longer exists
+				[neighbors removeObjectForKey:rowidNumber];
+				continue;
+			}
+			
+			block(ck.collection, ck.key, depth, &stop);
+			if (stop) break;
+		}
+		
+		if ((maxDepth > 0) && (depth >= maxDepth))
+		{
+			continue;
+		}
+		
+		NSArray<NSNumber *> *nodeNeighbors = [neighbors objectForKey:rowidNumber];
+		if (nodeNeighbors == nil)
+		{
+			if (hasUnprocessedChanges)
+			{
+				[self loadNeighborsForRowid:rowidNumber edgeName:name direction:direction into:neighbors];
+			}
+			else
+			{
+				// Load the neighbors of this node, along with the neighbors of the next pending nodes
+				// (the ones that will be visited next), all in one go.
+				
+				NSMutableArray<NSNumber *> *batch = [NSMutableArray arrayWithObject:rowidNumber];
+				
+				NSEnumerationOptions options = depthFirst ? NSEnumerationReverse : 0;
+				[pending enumerateObjectsWithOptions:options usingBlock:
+				    ^(NSNumber *pendingRowidNumber, NSUInteger __unused idx, BOOL *innerStop)
+				{
+					if (batch.count >= maxBatchSize)
+					{
+						*innerStop = YES;
+						return;
+					}
+					
+					if ([neighbors objectForKey:pendingRowidNumber] != nil)
+						return;
+					
+					NSUInteger pendingDepth = [[depths objectForKey:pendingRowidNumber] unsignedIntegerValue];
+					if ((maxDepth > 0) && (pendingDepth >= maxDepth))
+						return;
+					
+					[batch addObject:pendingRowidNumber];
+				}];
+				
+				[self loadNeighborsFromDiskForRowids:batch edgeName:name direction:direction into:neighbors];
+			}
+			
+			nodeNeighbors = [neighbors objectForKey:rowidNumber];
+		}
+		
+		// For depth-first, the neighbors are pushed in reverse,
+		// so the first neighbor is visited first.
+		
+		NSEnumerationOptions options = depthFirst ? NSEnumerationReverse : 0;
+		[nodeNeighbors enumerateObjectsWithOptions:options usingBlock:
+		    ^(NSNumber *neighborRowidNumber, NSUInteger __unused idx, BOOL __unused *innerStop)
+		{
+			if ([depths objectForKey:neighborRowidNumber] == nil)
+			{
+				[depths setObject:@(depth + 1) forKey:neighborRowidNumber];
+				[pending addObject:neighborRowidNumber];
+			}
+		}];
+		
+		[neighbors removeObjectForKey:rowidNumber];
+	}}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Public API - Count
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
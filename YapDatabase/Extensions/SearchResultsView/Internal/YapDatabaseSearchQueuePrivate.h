@@ -7,6 +7,7 @@
 @interface YapDatabaseSearchQueue ()
 
 - (NSString *)flushQueue;
+- (NSString *)flushQueueIsRefinement:(BOOL *)isRefinementPtr;
 
 - (BOOL)shouldAbortSearchInProgressAndRollback:(BOOL *)shouldRollbackPtr;
 
@@ -39,12 +39,18 @@ static NSString *const changeset_key_query = @"query";
 	
 	NSString *query;
 	BOOL queryChanged;
+	
+	YapCache *snippetCache;   // rowid -> snippet (or NSNull if the row doesn't match)
+	NSString *snippetCacheQuery;
+	uint64_t snippetCacheSnapshot;
 }
 
 - (NSString *)query;
 - (void)getQuery:(NSString **)queryPtr wasChanged:(BOOL *)wasChangedPtr;
 - (void)setQuery:(NSString *)newQuery isChange:(BOOL)isChange;
 
+- (YapCache *)snippetCacheForQuery:(NSString *)query snapshot:(uint64_t)snapshot;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -56,4 +62,6 @@ static NSString *const changeset_key_query = @"query";
 	
 }
 
+- (NSDictionary<NSNumber *, NSString *> *)snippetsForRowids:(NSArray<NSNumber *> *)rowids;
+
 @end
@@ -27,6 +27,20 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (void)enqueueQuery:(NSString *)query;
 
+/**
+ * Same as enqueueQuery:, but allows you to declare that the query is a refinement of the previous query.
+ * That is, every row that matches the new query also matches the previous query.
+ * For example: "ab*" -> "abc*" (the user typed another character).
+ *
+ * If every query enqueued since the last search is a refinement, then the searchResultsView
+ * only tests the rows that are currently in the view, rather than running the query against the entire FTS index.
+ * So the cost of the search is proportional to the size of the current search results.
+ *
+ * Note: If a search is aborted, the following search is never treated as a refinement.
+ * (The view may not reflect the aborted query.)
+**/
+- (void)enqueueQuery:(NSString *)query isRefinement:(BOOL)isRefinement;
+
 /**
  * These methods allow you to inspect the queue.
  * This is generally done to see how backed up the queue is.
@@ -65,6 +79,21 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (void)abortSearchInProgressAndRollback:(BOOL)shouldRollback;
 
+/**
+ * If YES, then enqueueing a query also aborts (and rolls back) any search in progress.
+ * That is, enqueueQuery: behaves as if abortSearchInProgressAndRollback:YES was invoked just before it.
+ *
+ * This is designed for search-as-you-type, where the results of a stale query are never wanted.
+ * Rather than keeping the readWrite queue busy until the stale search completes,
+ * the search is abandoned as soon as possible, and the next performSearchWithQueue: starts on the newest query.
+ *
+ * An aborted search also interrupts the FTS query while it's still executing within sqlite
+ * (a slow MATCH may take a while before it returns its first row).
+ *
+ * The default value is NO.
+**/
+@property (atomic, assign, readwrite) BOOL abortsSearchInProgressOnEnqueue;
+
 @end
 
 NS_ASSUME_NONNULL_END
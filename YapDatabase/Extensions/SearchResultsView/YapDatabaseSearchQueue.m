@@ -36,13 +36,20 @@
 
 @implementation YapDatabaseSearchQueue
 {
+	BOOL abortsSearchInProgressOnEnqueue;
+	
 	NSMutableArray *queue;
 	YAPUnfairLock lock;
 	
 	BOOL queueHasAbort;
 	BOOL queueHasRollback;
+	
+	BOOL queueHasQuery;
+	BOOL queueIsRefinement;
 }
 
+@synthesize abortsSearchInProgressOnEnqueue = abortsSearchInProgressOnEnqueue;
+
 - (id)init
 {
 	if ((self = [super init]))
@@ -58,12 +65,40 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 - (void)enqueueQuery:(NSString *)query
+{
+	[self enqueueQuery:query isRefinement:NO];
+}
+
+- (void)enqueueQuery:(NSString *)query isRefinement:(BOOL)isRefinement
 {
 	if (query == nil) return;
 	
+	BOOL abortSearchInProgress = self.abortsSearchInProgressOnEnqueue;
+	
 	YAPUnfairLockLock(&lock);
 	{
+		if (abortSearchInProgress)
+		{
+			[queue addObject:[[YapDatabaseSearchQueueControl alloc] initWithRollback:YES]];
+			
+			queueHasAbort = YES;
+			queueHasRollback = YES;
+		}
+		
 		[queue addObject:[query copy]];
+		
+		// Intermediate queries are skipped.
+		// So the flushed query is only a refinement if every query since the last flush is.
+		
+		if (queueHasQuery)
+		{
+			queueIsRefinement = queueIsRefinement && isRefinement;
+		}
+		else
+		{
+			queueHasQuery = YES;
+			queueIsRefinement = isRefinement;
+		}
 	}
 	YAPUnfairLockUnlock(&lock);
 }
@@ -128,17 +163,28 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 - (NSString *)flushQueue
+{
+	return [self flushQueueIsRefinement:NULL];
+}
+
+- (NSString *)flushQueueIsRefinement:(BOOL *)isRefinementPtr
 {
 	NSString *lastQuery = nil;
+	BOOL isRefinement = NO;
 	
 	YAPUnfairLockLock(&lock);
 	{
 		id lastObject = [queue lastObject];
 		[queue removeAllObjects];
 		
+		isRefinement = queueHasQuery && queueIsRefinement && !queueHasAbort;
+		
 		queueHasAbort = NO;
 		queueHasRollback = NO;
 		
+		queueHasQuery = NO;
+		queueIsRefinement = NO;
+		
 		if ([lastObject isKindOfClass:[NSString class]])
 		{
 			lastQuery = (NSString *)lastObject;
@@ -146,6 +192,7 @@
 	}
 	YAPUnfairLockUnlock(&lock);
 	
+	if (isRefinementPtr) *isRefinementPtr = isRefinement;
 	return lastQuery;
 }
 
@@ -150,6 +150,15 @@
 	return YES;
 }
 
+/**
+ * The search results are driven by the fullTextSearch (and parentView) extensions,
+ * so the allowedCollections (of the AutoView) can't be used to skip hooks.
+**/
+- (YapWhitelistBlacklist *)interestedCollections
+{
+	return nil;
+}
+
 - (NSSet *)dependencies
 {
 	if (parentViewName) {
@@ -4,6 +4,7 @@
 #import "YapDatabasePrivate.h"
 #import "YapDatabaseString.h"
 #import "YapDatabaseLogging.h"
+#import "YapCache.h"
 
 #if ! __has_feature(objc_arc)
 #warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
@@ -28,6 +29,45 @@
 	return (YapDatabaseSearchResultsView *)parent;
 }
 
+/**
+ * Required override method from YapDatabaseExtensionConnection
+**/
+- (void)_flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags
+{
+	[super _flushMemoryWithFlags:flags];
+	
+	if (flags & YapDatabaseConnectionFlushMemoryFlags_Caches)
+	{
+		[snippetCache removeAllObjects];
+	}
+}
+
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateMemoryUsageWithBlock:(void (^)(NSString *component,
+                                                uint64_t bytes,
+                                                YapDatabaseConnectionFlushMemoryFlags flushFlags))block
+{
+	[super enumerateMemoryUsageWithBlock:block];
+	
+	if (snippetCache) {
+		block(@"snippetCache", [snippetCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+	}
+}
+
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateCachesWithBlock:(void (^)(NSString *cacheName, YapCache *cache))block
+{
+	[super enumerateCachesWithBlock:block];
+	
+	if (snippetCache) {
+		block(@"snippetCache", snippetCache);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Transactions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -82,6 +122,8 @@
 	
 	query = nil;
 	queryChanged = NO;
+	
+	[snippetCache removeAllObjects];
 }
 
 - (NSArray *)internalChangesetKeys
@@ -168,4 +210,29 @@
 	queryChanged = queryChanged || isChange;
 }
 
+/**
+ * Returns the snippet cache, which only holds snippets for the given query, at the given snapshot.
+ * (A snippet depends on the text of the row, so every commit may change it.)
+ * The cache is cleared if either differs from the last time it was used.
+**/
+- (YapCache *)snippetCacheForQuery:(NSString *)inQuery snapshot:(uint64_t)snapshot
+{
+	if (snippetCache == nil)
+	{
+		snippetCache = [[YapCache alloc] initWithCountLimit:250];
+		snippetCache.allowedKeyClasses = [NSSet setWithObject:[NSNumber class]];
+		snippetCache.allowedObjectClasses = [NSSet setWithObjects:[NSString class], [NSNull class], nil];
+	}
+	
+	if (snippetCacheSnapshot != snapshot || ![snippetCacheQuery isEqualToString:inQuery])
+	{
+		[snippetCache removeAllObjects];
+		
+		snippetCacheQuery = [inQuery copy];
+		snippetCacheSnapshot = snapshot;
+	}
+	
+	return snippetCache;
+}
+
 @end
@@ -32,6 +32,21 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, strong, readwrite, nullable) YapWhitelistBlacklist *allowedGroups;
 
+/**
+ * If enabled, the FTS query is scoped to the rows of the parentView (within the allowedGroups).
+ * That is, sqlite only matches the rows in the parentView, rather than the entire FTS table.
+ * (See YapDatabaseFullTextSearchScope)
+ *
+ * This is worthwhile if the parentView is small compared to the number of matches,
+ * e.g. searching a single conversation within a large database.
+ * The search results are the same either way.
+ *
+ * Note: This property only applies if using a parentView.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL scopesQueryToParentView;
+
 /**
  * Set this option to include snippets with the search results.
  *
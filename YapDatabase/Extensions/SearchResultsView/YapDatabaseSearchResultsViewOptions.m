@@ -6,6 +6,7 @@
 
 @synthesize allowedGroups = allowedGroups;
 @synthesize snippetOptions = snippetOptions;
+@synthesize scopesQueryToParentView = scopesQueryToParentView;
 
 - (id)init
 {
@@ -37,6 +38,7 @@
 	
 	copy->allowedGroups = allowedGroups;
 	copy->snippetOptions = snippetOptions;
+	copy->scopesQueryToParentView = scopesQueryToParentView;
 	
 	return copy;
 }
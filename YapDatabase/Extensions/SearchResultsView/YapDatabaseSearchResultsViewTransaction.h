@@ -2,6 +2,7 @@
 
 #import "YapDatabaseAutoViewTransaction.h"
 #import "YapDatabaseSearchQueue.h"
+#import "YapCollectionKey.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -12,7 +13,26 @@ NS_ASSUME_NONNULL_BEGIN
  *
  * Note: snippets must be enabled via YapDatabaseSearchResultsViewOptions.
 **/
-- (NSString *)snippetForKey:(NSString *)key inCollection:(nullable NSString *)collection;
+- (nullable NSString *)snippetForKey:(NSString *)key inCollection:(nullable NSString *)collection;
+
+/**
+ * Returns the snippets for the given collection/key tuples, generated with a single query.
+ * Tuples that don't match the current query (or don't exist) aren't included in the result.
+ *
+ * Snippets are only generated on demand (never during the search itself), so ask for the rows you display.
+ * Within read-only transactions, snippets are cached per connection, for as long as the query & snapshot don't change.
+ *
+ * Note: snippets must be enabled via YapDatabaseSearchResultsViewOptions.
+**/
+- (NSDictionary<YapCollectionKey *, NSString *> *)snippetsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys;
+
+/**
+ * Generates (and caches) the snippets for the given range of the group, e.g. the visible rows.
+ * The subsequent snippetForKey:inCollection: calls for these rows (within read-only transactions) hit the cache.
+ *
+ * Note: snippets must be enabled via YapDatabaseSearchResultsViewOptions.
+**/
+- (void)prefetchSnippetsInRange:(NSRange)range inGroup:(NSString *)group;
 
 @end
 
@@ -33,6 +53,19 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (void)performSearchFor:(NSString *)query;
 
+/**
+ * Same as performSearchFor:, but allows you to declare that the query is a refinement of the current query.
+ * That is, every row that matches the new query also matches the current query. For example: "ab*" -> "abc*".
+ *
+ * In which case, the new results must be a subset of the current results.
+ * So rather than running the query against the entire FTS index,
+ * only the rows currently in the view are tested against the new query.
+ *
+ * Note: Some refinements are detected automatically (even if isRefinement is NO).
+ * Namely, when the new query simply appends additional plain terms to the current query (e.g. "the" -> "the duck").
+**/
+- (void)performSearchFor:(NSString *)query isRefinement:(BOOL)isRefinement;
+
 /**
  * This method works similar to performSearchFor:,
  * but allows you to use a special search "queue" that gives you more control over how the search progresses.
@@ -29,6 +29,59 @@
 static NSString *const ext_key_subclassVersion = @"searchResultViewClassVersion";
 static NSString *const ext_key_query           = @"query";
 
+/**
+ * Returns YES if the new query is (trivially) a refinement of the previous query.
+ *
+ * That is, the new query only appends additional plain terms to the previous query.
+ * Since FTS implicitly ANDs terms together, every row matching the new query also matches the previous one.
+ *
+ * Any query containing FTS syntax (phrases, operators, column filters, prefix tokens, etc) is rejected,
+ * even if it may be a refinement. Applications can declare such refinements explicitly.
+**/
+static BOOL YapDatabaseSearchQueryIsRefinement(NSString *previousQuery, NSString *query)
+{
+	NSCharacterSet *whitespace = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+	NSCharacterSet *invalid = [[NSCharacterSet alphanumericCharacterSet] invertedSet];
+	
+	NSArray<NSString *> * (^Terms)(NSString *) = ^NSArray<NSString *> *(NSString *string){
+		
+		NSMutableArray<NSString *> *terms = [NSMutableArray array];
+		
+		for (NSString *term in [string componentsSeparatedByCharactersInSet:whitespace])
+		{
+			if (term.length == 0) continue;
+			
+			if ([term rangeOfCharacterFromSet:invalid].location != NSNotFound) return nil;
+			if ([term isEqualToString:@"OR"] || [term isEqualToString:@"AND"] ||
+			    [term isEqualToString:@"NOT"] || [term isEqualToString:@"NEAR"]) return nil;
+			
+			[terms addObject:term];
+		}
+		
+		return terms;
+	};
+	
+	NSArray<NSString *> *previousTerms = Terms(previousQuery ?: @"");
+	NSArray<NSString *> *terms = Terms(query ?: @"");
+	
+	if (previousTerms.count == 0 || terms.count < previousTerms.count) return NO;
+	
+	return [[terms subarrayWithRange:NSMakeRange(0, previousTerms.count)] isEqualToArray:previousTerms];
+}
+
+/**
+ * Installed (via sqlite3_progress_handler) while the FTS query is executing.
+ *
+ * A slow MATCH may spend a long time within sqlite before it returns its first row.
+ * So this allows an aborted search to interrupt the statement (which then returns SQLITE_INTERRUPT).
+**/
+static int YapDatabaseSearchResultsViewProgressHandler(void *context)
+{
+	__unsafe_unretained YapDatabaseSearchQueue *searchQueue = (__bridge YapDatabaseSearchQueue *)context;
+	
+	return [searchQueue shouldAbortSearchInProgressAndRollback:NULL] ? 1 : 0;
+}
+
 
 @implementation YapDatabaseSearchResultsViewTransaction
 {
@@ -202,11 +255,23 @@ static NSString *const ext_key_query           = @"query";
 	else
 		ftsRowids = YapRowidSetCreate(0);
 	
+	YapDatabaseFullTextSearchScope *scope = [self parentViewScope];
+	
 	// Perform search
+	//
+	// If there's a search queue, the statement can be interrupted (from within sqlite) if the search is aborted.
+	// The progress handler is only installed while the FTS query is executing,
+	// as interrupting any other statement (e.g. loading a view page) isn't safe.
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	if (searchQueue) {
+		sqlite3_progress_handler(db, 1000, YapDatabaseSearchResultsViewProgressHandler, (__bridge void *)searchQueue);
+	}
 	
 	__block int processed = 0;
 	
-	[ftsTransaction enumerateRowidsMatching:[self query] usingBlock:^(int64_t rowid, BOOL *stop) {
+	[ftsTransaction enumerateRowidsMatching:[self query] inScope:scope usingBlock:^(int64_t rowid, BOOL *stop) {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
@@ -222,6 +287,107 @@ static NSString *const ext_key_query           = @"query";
 		
 	#pragma clang diagnostic pop
 	}];
+	
+	if (searchQueue) {
+		sqlite3_progress_handler(db, 0, NULL, NULL);
+	}
+}
+
+/**
+ * If the scopesQueryToParentView option is enabled, returns a scope with the rowids of the parentView
+ * (within the allowedGroups). Otherwise returns nil (meaning the FTS query isn't scoped).
+ *
+ * Rows outside the parentView are never part of the view, so this doesn't change the search results.
+**/
+- (YapDatabaseFullTextSearchScope *)parentViewScope
+{
+	__unsafe_unretained YapDatabaseSearchResultsView *searchResultsView =
+	  (YapDatabaseSearchResultsView *)parentConnection->parent;
+	
+	__unsafe_unretained YapDatabaseSearchResultsViewOptions *searchResultsOptions =
+	  (YapDatabaseSearchResultsViewOptions *)searchResultsView->options;
+	
+	if (searchResultsView->parentViewName == nil) return nil;
+	if (!searchResultsOptions.scopesQueryToParentView) return nil;
+	
+	YapDatabaseViewTransaction *parentViewTransaction =
+	  [databaseTransaction ext:searchResultsView->parentViewName];
+	
+	__unsafe_unretained YapWhitelistBlacklist *allowedGroups = searchResultsOptions.allowedGroups;
+	
+	YapRowidSet *rowids = YapRowidSetCreate(0);
+	
+	for (NSString *group in [parentViewTransaction allGroups])
+	{
+		if (allowedGroups && ![allowedGroups isAllowed:group]) continue;
+		
+		[parentViewTransaction enumerateRowidsInGroup:group usingBlock:
+			^(int64_t rowid, NSUInteger __unused index, BOOL __unused *stop)
+		{
+			YapRowidSetAdd(rowids, rowid);
+		}];
+	}
+	
+	YapDatabaseFullTextSearchScope *scope = [YapDatabaseFullTextSearchScope scopeWithRowidSet:rowids];
+	
+	YapRowidSetRelease(rowids);
+	return scope;
+}
+
+/**
+ * Used instead of repopulateFtsRowids when the new query is a refinement of the previous query.
+ *
+ * Every row that matches the new query also matches the previous query,
+ * so the only rows that can match are those currently in the view.
+ * Each of them is tested individually, rather than running the query against the entire FTS index.
+**/
+- (void)refineFtsRowids
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseSearchResultsView *searchResultsView =
+	  (YapDatabaseSearchResultsView *)parentConnection->parent;
+	
+	YapDatabaseFullTextSearchTransaction *ftsTransaction =
+	  (YapDatabaseFullTextSearchTransaction *)[databaseTransaction ext:searchResultsView->fullTextSearchName];
+	
+	// Prepare ftsRowids ivar
+	
+	if (ftsRowids)
+		YapRowidSetRemoveAll(ftsRowids);
+	else
+		ftsRowids = YapRowidSetCreate(0);
+	
+	// Test the current search results
+	
+	NSString *query = [self query];
+	__block int processed = 0;
+	
+	for (NSString *group in [self allGroups])
+	{
+		[self enumerateRowidsInGroup:group usingBlock:^(int64_t rowid, NSUInteger __unused index, BOOL *stop) {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			if ([ftsTransaction rowid:rowid matches:query]) {
+				YapRowidSetAdd(ftsRowids, rowid);
+			}
+			
+			if (++processed == 500)
+			{
+				processed = 0;
+				if ([searchQueue shouldAbortSearchInProgressAndRollback:NULL]) {
+					*stop = YES;
+				}
+			}
+			
+		#pragma clang diagnostic pop
+		}];
+		
+		if ([searchQueue shouldAbortSearchInProgressAndRollback:NULL]) {
+			return;
+		}
+	}
 }
 
 /**
@@ -516,6 +682,16 @@ static NSString *const ext_key_query           = @"query";
 	[super flushPendingChangesToExtensionTables];
 }
 
+/**
+ * Optional override method from YapDatabaseExtensionTransaction.
+ *
+ * The ftsRowids & searchQueue are per-transaction state, so we don't participate in transaction recycling.
+**/
+- (BOOL)prepareForReuse
+{
+	return NO;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Logic
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -731,7 +907,7 @@ static NSString *const ext_key_query           = @"query";
 	
 	YapWhitelistBlacklist *allowedCollections = searchResultsOptions.allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:collectionKey.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -806,7 +982,7 @@ static NSString *const ext_key_query           = @"query";
 	
 	YapWhitelistBlacklist *allowedCollections = searchResultsOptions.allowedCollections;
 	
-	if (allowedCollections && ![allowedCollections isAllowed:collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -1165,6 +1341,26 @@ static NSString *const ext_key_query           = @"query";
 	}
 }
 
+/**
+ * YapDatabaseReadWriteTransaction Hook, invoked post-op.
+ *
+ * Corresponds to the following method(s) in YapDatabaseReadWriteTransaction:
+ * - touchObjectsForKeys:inCollection:
+ *
+ * Touched rows may need to be re-run through the search, so we don't use the AutoView batch shortcut.
+**/
+- (void)didTouchObjectsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                              withRowids:(NSArray<NSNumber *> *)rowids
+{
+	YDBLogAutoTrace();
+	
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[self didTouchObjectForCollectionKey:collectionKeys[i] withRowid:[rowids[i] longLongValue]];
+	}
+}
+
 /**
  * Subclasses MUST implement this method.
  * YapDatabaseReadWriteTransaction Hook, invoked post-op.
@@ -1782,7 +1978,7 @@ static NSString *const ext_key_query           = @"query";
 		NSString *group = nil;
 		YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
 		
-		if (!allowedCollections || [allowedCollections isAllowed:ck.collection])
+		if (!allowedCollections || [allowedCollections isAllowedCollectionKey:ck])
 		{
 			if (grouping->blockType == YapDatabaseBlockTypeWithKey)
 			{
@@ -1882,6 +2078,15 @@ static NSString *const ext_key_query           = @"query";
  * @see performSearchWithQueue:
 **/
 - (void)performSearchFor:(NSString *)query
+{
+	[self performSearchFor:query isRefinement:NO];
+}
+
+/**
+ * Same as performSearchFor:, but if the query is a refinement of the current query,
+ * then only the rows currently in the view are tested against the new query.
+**/
+- (void)performSearchFor:(NSString *)query isRefinement:(BOOL)isRefinement
 {
 	YDBLogAutoTrace();
 	
@@ -1896,11 +2101,19 @@ static NSString *const ext_key_query           = @"query";
 	__unsafe_unretained YapDatabaseSearchResultsViewConnection *searchResultsViewConnection =
 	  (YapDatabaseSearchResultsViewConnection *)parentConnection;
 	
+	if (!isRefinement) {
+		isRefinement = YapDatabaseSearchQueryIsRefinement([self query], query);
+	}
+	
 	[searchResultsViewConnection setQuery:query isChange:YES];
 	
-	// Run the query against the FTS extension, and populate the ftsRowids & snippets ivars
+	// Run the query against the FTS extension, and populate the ftsRowids & snippets ivars.
+	// Or, if the query is a refinement, only test the current search results.
 	
-	[self repopulateFtsRowids];
+	if (isRefinement)
+		[self refineFtsRowids];
+	else
+		[self repopulateFtsRowids];
 	
 	// Update the view (using FTS results stored in ftsRowids)
 	
@@ -1934,10 +2147,12 @@ static NSString *const ext_key_query           = @"query";
 	
 	searchQueue = inSearchQueue;
 	
-	NSString *query = [searchQueue flushQueue];
+	BOOL isRefinement = NO;
+	
+	NSString *query = [searchQueue flushQueueIsRefinement:&isRefinement];
 	if (query)
 	{
-		[self performSearchFor:query];
+		[self performSearchFor:query isRefinement:isRefinement];
 		
 		BOOL rollback = NO;
 		BOOL abort = [searchQueue shouldAbortSearchInProgressAndRollback:&rollback];
@@ -1971,12 +2186,131 @@ static NSString *const ext_key_query           = @"query";
 		return nil;
 	}
 	
-	YapDatabaseFullTextSearchTransaction *ftsTransaction =
-	  [databaseTransaction ext:searchResultsView->fullTextSearchName];
+	return [self snippetsForRowids:@[ @(rowid) ]][@(rowid)];
+}
+
+- (NSDictionary<YapCollectionKey *, NSString *> *)snippetsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+{
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray arrayWithCapacity:collectionKeys.count];
+	NSMutableDictionary<NSNumber *, YapCollectionKey *> *collectionKeysByRowid =
+	  [NSMutableDictionary dictionaryWithCapacity:collectionKeys.count];
+	
+	for (YapCollectionKey *ck in collectionKeys)
+	{
+		int64_t rowid = 0;
+		if ([databaseTransaction getRowid:&rowid forKey:ck.key inCollection:ck.collection])
+		{
+			[rowids addObject:@(rowid)];
+			collectionKeysByRowid[@(rowid)] = ck;
+		}
+	}
+	
+	NSDictionary<NSNumber *, NSString *> *snippets = [self snippetsForRowids:rowids];
+	
+	NSMutableDictionary<YapCollectionKey *, NSString *> *result =
+	  [NSMutableDictionary dictionaryWithCapacity:snippets.count];
+	
+	[snippets enumerateKeysAndObjectsUsingBlock:^(NSNumber *rowid, NSString *snippet, BOOL __unused *stop) {
+		
+		result[collectionKeysByRowid[rowid]] = snippet;
+	}];
+	
+	return result;
+}
+
+- (void)prefetchSnippetsInRange:(NSRange)range inGroup:(NSString *)group
+{
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray arrayWithCapacity:range.length];
+	
+	[self enumerateRowidsInGroup:group
+	                 withOptions:0
+	                       range:range
+	                  usingBlock:^(int64_t rowid, NSUInteger __unused index, BOOL __unused *stop)
+	{
+		[rowids addObject:@(rowid)];
+	}];
+	
+	[self snippetsForRowids:rowids];
+}
+
+/**
+ * Returns the snippets for the given rowids (only those that match the current query), keyed by rowid.
+ *
+ * Snippets are only generated for the rows that are asked for (typically the visible rows),
+ * using a single FTS query restricted to those rowids.
+ *
+ * Within read-only transactions, the snippets are cached (per connection) for the current query & snapshot.
+ * Read-write transactions may modify the rows, so they always generate the snippets.
+**/
+- (NSDictionary<NSNumber *, NSString *> *)snippetsForRowids:(NSArray<NSNumber *> *)rowids
+{
+	__unsafe_unretained YapDatabaseSearchResultsView *searchResultsView =
+	  (YapDatabaseSearchResultsView *)parentConnection->parent;
+	
+	__unsafe_unretained YapDatabaseSearchResultsViewOptions *searchResultsOptions =
+	  (YapDatabaseSearchResultsViewOptions *)searchResultsView->options;
+	
+	__unsafe_unretained YapDatabaseFullTextSearchSnippetOptions *snippetOptions =
+	  searchResultsOptions.snippetOptions_NoCopy;
 	
-	NSString *snippet = [ftsTransaction rowid:rowid matches:[self query] withSnippetOptions:snippetOptions];
+	if (snippetOptions == nil) {
+		// Ignore - snippets not being used
+		return nil;
+	}
+	
+	NSString *query = [self query];
+	
+	YapCache *snippetCache = nil;
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		__unsafe_unretained YapDatabaseSearchResultsViewConnection *searchResultsViewConnection =
+		  (YapDatabaseSearchResultsViewConnection *)parentConnection;
+		
+		snippetCache = [searchResultsViewConnection snippetCacheForQuery:query
+		                                                        snapshot:[databaseTransaction->connection snapshot]];
+	}
+	
+	NSMutableDictionary<NSNumber *, NSString *> *snippets = [NSMutableDictionary dictionaryWithCapacity:rowids.count];
+	NSMutableArray<NSNumber *> *missingRowids = nil;
+	
+	for (NSNumber *rowid in rowids)
+	{
+		id cached = [snippetCache objectForKey:rowid];
+		if (cached)
+		{
+			if (cached != [NSNull null]) {
+				snippets[rowid] = (NSString *)cached;
+			}
+		}
+		else
+		{
+			if (missingRowids == nil)
+				missingRowids = [NSMutableArray arrayWithCapacity:rowids.count];
+			
+			[missingRowids addObject:rowid];
+		}
+	}
+	
+	if (missingRowids.count > 0)
+	{
+		YapDatabaseFullTextSearchTransaction *ftsTransaction =
+		  [databaseTransaction ext:searchResultsView->fullTextSearchName];
+		
+		NSDictionary<NSNumber *, NSString *> *fetched =
+		  [ftsTransaction snippetsForRowids:missingRowids matching:query withSnippetOptions:snippetOptions];
+		
+		for (NSNumber *rowid in missingRowids)
+		{
+			NSString *snippet = fetched[rowid];
+			
+			if (snippet) {
+				snippets[rowid] = snippet;
+			}
+			[snippetCache setObject:(snippet ?: (id)[NSNull null]) forKey:rowid];
+		}
+	}
 	
-	return snippet;
+	return snippets;
 }
 
 @end
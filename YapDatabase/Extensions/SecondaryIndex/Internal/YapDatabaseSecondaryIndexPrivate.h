@@ -14,6 +14,8 @@
 
 #import "sqlite3.h"
 
+#import <stdatomic.h>
+
 /**
  * This version number is stored in the yap2 table.
  * If there is a major re-write to this class, then the version number will be incremented,
@@ -52,6 +54,21 @@
 **/
 - (BOOL)matchesExistingColumnNamesAndAffinity:(NSDictionary *)columns;
 
+/**
+ * Returns the "CREATE INDEX" statement (without "IF NOT EXISTS" or a trailing semicolon) for every index,
+ * keyed by index name. This includes the single column index of every column.
+ *
+ * The statements match the (normalized) sql that sqlite stores in sqlite_master,
+ * so they can be compared to the existing indexes of the table.
+**/
+- (NSDictionary<NSString *, NSString *> *)createIndexStatementsForTable:(NSString *)tableName;
+
+/**
+ * A string that describes the declared aggregates.
+ * It's stored in the yap2 table, so changes to the aggregates can be detected (which requires a rebuild).
+**/
+- (NSString *)aggregatesSignature;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,9 +86,18 @@
 	NSString *versionTag;
 	
 	id columnNamesSharedKeySet;
+	
+	NSArray<YapDatabaseSecondaryIndexAggregate *> *aggregates;
+	
+	// Transactions with a snapshot below this value may observe a partially populated index.
+	// It's UINT64_MAX while an incremental population is in progress (see options.populationChunkSize).
+	atomic_uint_fast64_t populationSnapshot;
 }
 
++ (NSString *)aggregateTableNameForRegisteredName:(NSString *)registeredName;
+
 - (NSString *)tableName;
+- (NSString *)aggregateTableName;
 
 @end
 
@@ -90,6 +116,8 @@
 	YapCache<NSString *, YapDatabaseStatement *> *queryCache;
 	NSUInteger queryCacheLimit;
 	
+	NSMutableDictionary<NSString *, YapDatabaseStatement *> *aggregateStatements;
+	
 	YapMutationStack_Bool *mutationStack;
 }
 
@@ -101,6 +129,7 @@
 
 - (sqlite3_stmt *)insertStatement;
 - (sqlite3_stmt *)updateStatement;
+- (sqlite3_stmt *)compareStatement;
 - (sqlite3_stmt *)removeStatement;
 - (sqlite3_stmt *)removeAllStatement;
 
@@ -115,6 +144,15 @@
 	
 	__unsafe_unretained YapDatabaseSecondaryIndexConnection *parentConnection;
 	__unsafe_unretained YapDatabaseReadTransaction *databaseTransaction;
+	
+	BOOL loadedPopulationState;
+	BOOL isPopulating;
+	BOOL didCompletePopulation;
+	int64_t populationRowid; // If isPopulating, rows with a greater rowid haven't been populated yet
+	
+	BOOL isRebuilding; // Set while rebuilding after a bulk load (see rebuildAfterBulkLoad)
+	
+	NSArray *evaluatedHandlerResults; // Results of concurrent evaluation for the current batch hook (if any)
 }
 
 - (id)initWithParentConnection:(YapDatabaseSecondaryIndexConnection *)parentConnection
@@ -29,15 +29,22 @@
                       wasPersistent:(BOOL __unused)wasPersistent
 {
 	sqlite3 *db = transaction->connection->db;
-	NSString *tableName = [self tableNameForRegisteredName:registeredName];
 	
-	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
+	NSArray *tableNames = @[
+	  [self tableNameForRegisteredName:registeredName],
+	  [self aggregateTableNameForRegisteredName:registeredName]
+	];
 	
-	int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
-	if (status != SQLITE_OK)
+	for (NSString *tableName in tableNames)
 	{
-		YDBLogError(@"%@ - Failed dropping table (%@): %d %s",
-		            THIS_METHOD, tableName, status, sqlite3_errmsg(db));
+		NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
+		
+		int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed dropping table (%@): %d %s",
+			            THIS_METHOD, tableName, status, sqlite3_errmsg(db));
+		}
 	}
 }
 
@@ -51,6 +58,11 @@
 	return [NSString stringWithFormat:@"secondaryIndex_%@", registeredName];
 }
 
++ (NSString *)aggregateTableNameForRegisteredName:(NSString *)registeredName
+{
+	return [NSString stringWithFormat:@"secondaryIndex_%@_aggregates", registeredName];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Instance
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -116,6 +128,8 @@
 		
 		columnNamesSharedKeySet = [NSDictionary sharedKeySetForKeys:[setup columnNames]];
 		
+		aggregates = [setup aggregates];
+		
 		versionTag = inVersionTag ? [inVersionTag copy] : @"";
 		
 		options = inOptions ? [inOptions copy] : [[YapDatabaseSecondaryIndexOptions alloc] init];
@@ -128,9 +142,32 @@
 	return [[YapDatabaseSecondaryIndexConnection alloc] initWithParent:self databaseConnection:databaseConnection];
 }
 
+/**
+ * YapDatabaseExtension subclass hook.
+ * Rows outside the allowedCollections are never indexed.
+**/
+- (YapWhitelistBlacklist *)interestedCollections
+{
+	return options.allowedCollections;
+}
+
+/**
+ * YapDatabaseExtension subclass hook.
+ * Returns YES if an incremental population is in progress (see YapDatabaseSecondaryIndexOptions.populationChunkSize).
+**/
+- (BOOL)hasPendingPopulation
+{
+	return (atomic_load(&populationSnapshot) == UINT64_MAX);
+}
+
 - (NSString *)tableName
 {
 	return [[self class] tableNameForRegisteredName:self.registeredName];
 }
 
+- (NSString *)aggregateTableName
+{
+	return [[self class] aggregateTableNameForRegisteredName:self.registeredName];
+}
+
 @end
@@ -4,6 +4,7 @@
 
 #import "YapDatabasePrivate.h"
 #import "YapDatabaseExtensionPrivate.h"
+#import "YapDatabaseMemoryReportPrivate.h"
 
 #import "YapDatabaseString.h"
 #import "YapDatabaseLogging.h"
@@ -28,6 +29,7 @@
 {
 	sqlite3_stmt *insertStatement;
 	sqlite3_stmt *updateStatement;
+	sqlite3_stmt *compareStatement;
 	sqlite3_stmt *removeStatement;
 	sqlite3_stmt *removeAllStatement;
 }
@@ -46,6 +48,8 @@
 		queryCache = [[YapCache alloc] initWithCountLimit:queryCacheLimit];
 		queryCache.allowedKeyClasses = [NSSet setWithObject:[NSString class]];
 		queryCache.allowedObjectClasses = [NSSet setWithObject:[YapDatabaseStatement class]];
+		
+		aggregateStatements = [[NSMutableDictionary alloc] init];
 	}
 	return self;
 }
@@ -60,8 +64,11 @@
 {
 	sqlite_finalize_null(&insertStatement);
 	sqlite_finalize_null(&updateStatement);
+	sqlite_finalize_null(&compareStatement);
 	sqlite_finalize_null(&removeStatement);
 	sqlite_finalize_null(&removeAllStatement);
+	
+	[aggregateStatements removeAllObjects];
 }
 
 /**
@@ -80,6 +87,45 @@
 	}
 }
 
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateMemoryUsageWithBlock:(void (^)(NSString *component,
+                                                uint64_t bytes,
+                                                YapDatabaseConnectionFlushMemoryFlags flushFlags))block
+{
+	__block uint64_t queryCacheBytes = 0;
+	[queryCache enumerateKeysAndObjectsWithBlock:^(NSString __unused *key, YapDatabaseStatement *statement, BOOL __unused *stop) {
+		
+		queryCacheBytes += YapDatabaseStatementMemoryUsed(statement.stmt);
+	}];
+	
+	uint64_t statementBytes = 0;
+	statementBytes += YapDatabaseStatementMemoryUsed(insertStatement);
+	statementBytes += YapDatabaseStatementMemoryUsed(updateStatement);
+	statementBytes += YapDatabaseStatementMemoryUsed(compareStatement);
+	statementBytes += YapDatabaseStatementMemoryUsed(removeStatement);
+	statementBytes += YapDatabaseStatementMemoryUsed(removeAllStatement);
+	
+	for (YapDatabaseStatement *statement in [aggregateStatements objectEnumerator])
+	{
+		statementBytes += YapDatabaseStatementMemoryUsed(statement.stmt);
+	}
+	
+	block(@"queryCache", queryCacheBytes, YapDatabaseConnectionFlushMemoryFlags_Caches);
+	block(@"statements", statementBytes, YapDatabaseConnectionFlushMemoryFlags_Statements);
+}
+
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateCachesWithBlock:(void (^)(NSString *cacheName, YapCache *cache))block
+{
+	if (queryCache) {
+		block(@"queryCache", queryCache);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -327,6 +373,38 @@
 	return *statement;
 }
 
+/**
+ * Returns a single row (if the rowid is in the table) with a single column:
+ * 1 if every column matches the bound value, 0 otherwise.
+ *
+ * The parameters are numbered so they're bound exactly like the insertStatement & updateStatement.
+**/
+- (sqlite3_stmt *)compareStatement
+{
+	sqlite3_stmt **statement = &compareStatement;
+	if (*statement == NULL)
+	{
+		NSMutableString *string = [NSMutableString stringWithCapacity:100];
+		[string appendString:@"SELECT "];
+		
+		int bind_idx = SQLITE_BIND_START + 1;
+		for (YapDatabaseSecondaryIndexColumn *column in parent->setup)
+		{
+			if (bind_idx > (SQLITE_BIND_START + 1))
+				[string appendString:@" AND "];
+			
+			[string appendFormat:@"(\"%@\" IS ?%d)", column.name, bind_idx];
+			bind_idx++;
+		}
+		
+		[string appendFormat:@" FROM \"%@\" WHERE \"rowid\" = ?%d;", [parent tableName], SQLITE_BIND_START];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
 - (sqlite3_stmt *)removeStatement
 {
 	sqlite3_stmt **statement = &removeStatement;
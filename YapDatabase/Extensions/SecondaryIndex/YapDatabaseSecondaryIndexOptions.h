@@ -40,6 +40,43 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, strong, readwrite, nullable) YapWhitelistBlacklist *allowedCollections;
 
+/**
+ * Populating a secondary index for a large database may take a while.
+ * And, by default, the population happens within the readWriteTransaction that registers the extension.
+ * Which means every other readWriteTransaction is blocked until the population completes.
+ *
+ * If you set a non-zero populationChunkSize, then the registration transaction only creates the table.
+ * The existing rows are then populated in the background, in chunks of (at most) populationChunkSize rows,
+ * with each chunk executing in its own short readWriteTransaction.
+ * Other readWriteTransactions are free to proceed in between chunks,
+ * and any changes they make are processed by the extension as usual.
+ *
+ * The progress is persisted after each chunk.
+ * So if the app is terminated mid-population, then the population resumes (rather than restarts)
+ * the next time the extension is registered.
+ *
+ * While the population is in progress, queries only reflect the rows that have been populated so far.
+ * Use -[YapDatabaseSecondaryIndexTransaction isPopulating] to detect this state.
+ *
+ * The default value is zero (populate within the registration transaction).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger populationChunkSize;
+
+/**
+ * Opt-in concurrent evaluation, for secondaryIndex blocks that are CPU-bound (e.g. extracting values from objects).
+ *
+ * If YES, then for large batches (setObjects:forKeys:inCollection:...), the block is invoked concurrently
+ * (on background threads) for the rows of the batch, and possibly alongside the handlers of other extensions.
+ * The resulting values are then written to the index, in order, on the transaction thread.
+ *
+ * IMPORTANT:
+ * The block must be thread-safe to use this option.
+ * And it must NOT use the transaction parameter, as database transactions are not thread-safe.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL allowsConcurrentEvaluation;
+
 @end
 
 NS_ASSUME_NONNULL_END
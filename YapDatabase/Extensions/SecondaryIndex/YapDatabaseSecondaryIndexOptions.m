@@ -15,11 +15,15 @@
 @implementation YapDatabaseSecondaryIndexOptions
 
 @synthesize allowedCollections = allowedCollections;
+@synthesize populationChunkSize = populationChunkSize;
+@synthesize allowsConcurrentEvaluation = allowsConcurrentEvaluation;
 
 - (id)copyWithZone:(NSZone __unused *)zone
 {
 	YapDatabaseSecondaryIndexOptions *copy = [[YapDatabaseSecondaryIndexOptions alloc] init];
 	copy->allowedCollections = allowedCollections;
+	copy->populationChunkSize = populationChunkSize;
+	copy->allowsConcurrentEvaluation = allowsConcurrentEvaluation;
 	
 	return copy;
 }
@@ -1,6 +1,8 @@
 #import <Foundation/Foundation.h>
 
 @class YapDatabaseSecondaryIndexColumn;
+@class YapDatabaseSecondaryIndexCompositeIndex;
+@class YapDatabaseSecondaryIndexAggregate;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -18,6 +20,25 @@ typedef NS_ENUM(NSInteger, YapDatabaseSecondaryIndexType) {
 
 NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexType type);
 
+/**
+ * The order of a column within a composite index.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseSecondaryIndexSortOrder) {
+	YapDatabaseSecondaryIndexSortOrderAscending,
+	YapDatabaseSecondaryIndexSortOrderDescending
+};
+
+/**
+ * The function of a materialized aggregate.
+ * Each function has the same semantics as the corresponding sqlite aggregate function.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseSecondaryIndexAggregateFunction) {
+	YapDatabaseSecondaryIndexAggregateFunctionCount,
+	YapDatabaseSecondaryIndexAggregateFunctionSum,
+	YapDatabaseSecondaryIndexAggregateFunctionMin,
+	YapDatabaseSecondaryIndexAggregateFunctionMax
+};
+
 
 @interface YapDatabaseSecondaryIndexSetup : NSObject <NSCopying, NSFastEnumeration>
 
@@ -31,6 +52,94 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
 
 - (NSArray<NSString *> *)columnNames;
 
+/**
+ * Every column gets its own (single column) index.
+ * In addition, you can declare indexes that span multiple columns.
+ *
+ * For example, if your queries look like "WHERE threadId = ? ORDER BY date DESC",
+ * then an index on (threadId, date DESC) allows sqlite to find & order the rows using only the index.
+ * Whereas, with single column indexes, sqlite picks one of them, and then has to sort (or filter) the remaining rows.
+ *
+ * @param name
+ *   The name of the index. Must be unique within the setup.
+ *
+ * @param columns
+ *   The indexed columns, in order. Every column must have been added to the setup (via addColumn:withType:).
+ *
+ * @param sortOrders
+ *   The YapDatabaseSecondaryIndexSortOrder of each column (as NSNumbers), in the same order as columns.
+ *   Pass nil if every column is ascending.
+ *
+ * @param coveringColumns
+ *   Additional columns, which are stored in the index, but are not used to find or order the rows.
+ *   If a query only references indexed & covering columns, then sqlite can answer it from the index alone,
+ *   without reading the table. (SQLite doesn't support INCLUDE, so these are appended to the indexed columns.)
+ *
+ * @param predicate
+ *   An optional WHERE clause (without the WHERE keyword), which turns the index into a partial index.
+ *   For example: @"unread = 1". Only the matching rows are stored in the index (which keeps it small),
+ *   and sqlite only uses it for queries whose WHERE clause implies the predicate.
+ *
+ * Indexes don't affect the content of the table.
+ * So you can change the declared indexes without changing the versionTag.
+ * When the extension is registered, any index that no longer matches the setup is dropped,
+ * and any missing index is created (without re-populating the table).
+**/
+- (void)addIndexWithName:(NSString *)name columns:(NSArray<NSString *> *)columns;
+
+- (void)addIndexWithName:(NSString *)name
+                 columns:(NSArray<NSString *> *)columns
+              sortOrders:(nullable NSArray<NSNumber *> *)sortOrders
+         coveringColumns:(nullable NSArray<NSString *> *)coveringColumns
+               predicate:(nullable NSString *)predicate;
+
+- (NSArray<YapDatabaseSecondaryIndexCompositeIndex *> *)indexes;
+
+/**
+ * A materialized aggregate is the equivalent of:
+ * "SELECT groupByColumn, FUNCTION(column) FROM tableName GROUP BY groupByColumn"
+ *
+ * But rather than running the query (over every row of the table) each time you need the result,
+ * the result of every group is stored in a side table, and is updated incrementally as rows are
+ * inserted, updated & removed. Reading the value of a group is thus a single lookup.
+ * See -[YapDatabaseSecondaryIndexTransaction valueForAggregate:group:].
+ *
+ * For example, to keep the balance of every account:
+ *
+ * [setup addColumn:@"accountId" withType:YapDatabaseSecondaryIndexTypeText];
+ * [setup addColumn:@"amount" withType:YapDatabaseSecondaryIndexTypeInteger];
+ * [setup addAggregateWithName:@"balance"
+ *                    function:YapDatabaseSecondaryIndexAggregateFunctionSum
+ *                      column:@"amount"
+ *               groupByColumn:@"accountId"];
+ *
+ * A MIN or MAX value is updated as rows are added. But if the row holding the extreme value is removed (or changed),
+ * the value of its group is recomputed (from the index on the column) the next time it's read.
+ *
+ * @param name
+ *   The name of the aggregate. Must be unique within the setup.
+ *
+ * @param function
+ *   The aggregate function.
+ *
+ * @param column
+ *   The aggregated column. Must have been added to the setup (via addColumn:withType:).
+ *   For YapDatabaseSecondaryIndexAggregateFunctionCount you may pass nil, which counts every row (i.e. COUNT(*)).
+ *
+ * @param groupByColumn
+ *   The column to group by, or nil to aggregate every row of the table (as a single group).
+ *
+ * Aggregates don't affect the content of the table.
+ * So you can change the declared aggregates without changing the versionTag.
+ * When the extension is registered, the stored aggregates are rebuilt if the declared aggregates changed.
+**/
+- (void)addAggregateWithName:(NSString *)name
+                    function:(YapDatabaseSecondaryIndexAggregateFunction)function
+                      column:(nullable NSString *)column
+               groupByColumn:(nullable NSString *)groupByColumn;
+
+- (NSArray<YapDatabaseSecondaryIndexAggregate *> *)aggregates;
+
 @end
 
 #pragma mark -
@@ -42,4 +151,30 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
 
 @end
 
+#pragma mark -
+
+@interface YapDatabaseSecondaryIndexCompositeIndex : NSObject
+
+@property (nonatomic, copy, readonly) NSString *name;
+
+@property (nonatomic, copy, readonly) NSArray<NSString *> *columns;
+@property (nonatomic, copy, readonly) NSArray<NSNumber *> *sortOrders;
+
+@property (nonatomic, copy, readonly) NSArray<NSString *> *coveringColumns;
+@property (nonatomic, copy, readonly, nullable) NSString *predicate;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseSecondaryIndexAggregate : NSObject
+
+@property (nonatomic, copy, readonly) NSString *name;
+@property (nonatomic, assign, readonly) YapDatabaseSecondaryIndexAggregateFunction function;
+
+@property (nonatomic, copy, readonly, nullable) NSString *column;
+@property (nonatomic, copy, readonly, nullable) NSString *groupByColumn;
+
+@end
+
 NS_ASSUME_NONNULL_END
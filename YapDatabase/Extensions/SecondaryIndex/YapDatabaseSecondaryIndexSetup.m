@@ -34,6 +34,21 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
 - (id)initWithName:(NSString *)name type:(YapDatabaseSecondaryIndexType)type;
 @end
 
+@interface YapDatabaseSecondaryIndexCompositeIndex ()
+- (id)initWithName:(NSString *)name
+           columns:(NSArray<NSString *> *)columns
+        sortOrders:(NSArray<NSNumber *> *)sortOrders
+   coveringColumns:(NSArray<NSString *> *)coveringColumns
+         predicate:(NSString *)predicate;
+@end
+
+@interface YapDatabaseSecondaryIndexAggregate ()
+- (id)initWithName:(NSString *)name
+          function:(YapDatabaseSecondaryIndexAggregateFunction)function
+            column:(NSString *)column
+     groupByColumn:(NSString *)groupByColumn;
+@end
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,6 +56,8 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
 @implementation YapDatabaseSecondaryIndexSetup
 {
 	NSMutableArray *setup;
+	NSMutableArray<YapDatabaseSecondaryIndexCompositeIndex *> *indexes;
+	NSMutableArray<YapDatabaseSecondaryIndexAggregate *> *aggregates;
 }
 
 - (id)init
@@ -56,6 +73,9 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
 			setup = [[NSMutableArray alloc] initWithCapacity:capacity];
 		else
 			setup = [[NSMutableArray alloc] init];
+		
+		indexes = [[NSMutableArray alloc] init];
+		aggregates = [[NSMutableArray alloc] init];
 	}
 	return self;
 }
@@ -164,10 +184,273 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
 	return [columnNames copy];
 }
 
+- (BOOL)isExistingIndexName:(NSString *)indexName
+{
+	// SQLite index names are not case sensitive.
+	
+	for (YapDatabaseSecondaryIndexCompositeIndex *index in indexes)
+	{
+		if ([index.name caseInsensitiveCompare:indexName] == NSOrderedSame)
+		{
+			return YES;
+		}
+	}
+	
+	return NO;
+}
+
+- (void)addIndexWithName:(NSString *)name columns:(NSArray<NSString *> *)columns
+{
+	[self addIndexWithName:name columns:columns sortOrders:nil coveringColumns:nil predicate:nil];
+}
+
+- (void)addIndexWithName:(NSString *)name
+                 columns:(NSArray<NSString *> *)columns
+              sortOrders:(NSArray<NSNumber *> *)sortOrders
+         coveringColumns:(NSArray<NSString *> *)coveringColumns
+               predicate:(NSString *)predicate
+{
+	if (name == nil)
+	{
+		NSAssert(NO, @"Invalid index name: nil");
+		
+		YDBLogError(@"%@: Invalid index name: nil", THIS_METHOD);
+		return;
+	}
+	
+	if ([self isExistingIndexName:name])
+	{
+		NSAssert(NO, @"Invalid index name: name already exists");
+		
+		YDBLogError(@"%@: Invalid index name: name already exists", THIS_METHOD);
+		return;
+	}
+	
+	if ([columns count] == 0)
+	{
+		NSAssert(NO, @"Invalid columns: empty");
+		
+		YDBLogError(@"%@: Invalid columns: empty", THIS_METHOD);
+		return;
+	}
+	
+	if (sortOrders && ([sortOrders count] != [columns count]))
+	{
+		NSAssert(NO, @"Invalid sortOrders: count doesn't match columns");
+		
+		YDBLogError(@"%@: Invalid sortOrders: count doesn't match columns", THIS_METHOD);
+		return;
+	}
+	
+	NSMutableSet<NSString *> *seen = [NSMutableSet setWithCapacity:([columns count] + [coveringColumns count])];
+	
+	for (NSArray<NSString *> *list in @[ columns, (coveringColumns ?: @[]) ])
+	{
+		for (NSString *columnName in list)
+		{
+			if (![self isExistingName:columnName])
+			{
+				NSAssert(NO, @"Invalid index column: column doesn't exist in setup");
+				
+				YDBLogError(@"%@: Invalid index column (%@): column doesn't exist in setup", THIS_METHOD, columnName);
+				return;
+			}
+			
+			NSString *lowercaseName = [columnName lowercaseString];
+			if ([seen containsObject:lowercaseName])
+			{
+				NSAssert(NO, @"Invalid index column: column is listed twice");
+				
+				YDBLogError(@"%@: Invalid index column (%@): column is listed twice", THIS_METHOD, columnName);
+				return;
+			}
+			
+			[seen addObject:lowercaseName];
+		}
+	}
+	
+	if (sortOrders == nil)
+	{
+		NSMutableArray *ascending = [NSMutableArray arrayWithCapacity:[columns count]];
+		for (NSUInteger i = 0; i < [columns count]; i++)
+		{
+			[ascending addObject:@(YapDatabaseSecondaryIndexSortOrderAscending)];
+		}
+		
+		sortOrders = ascending;
+	}
+	
+	YapDatabaseSecondaryIndexCompositeIndex *index =
+	  [[YapDatabaseSecondaryIndexCompositeIndex alloc] initWithName:name
+	                                                        columns:columns
+	                                                     sortOrders:sortOrders
+	                                                coveringColumns:(coveringColumns ?: @[])
+	                                                      predicate:predicate];
+	
+	[indexes addObject:index];
+}
+
+- (NSArray<YapDatabaseSecondaryIndexCompositeIndex *> *)indexes
+{
+	return [indexes copy];
+}
+
+- (BOOL)isExistingAggregateName:(NSString *)aggregateName
+{
+	for (YapDatabaseSecondaryIndexAggregate *aggregate in aggregates)
+	{
+		if ([aggregate.name isEqualToString:aggregateName])
+		{
+			return YES;
+		}
+	}
+	
+	return NO;
+}
+
+- (void)addAggregateWithName:(NSString *)name
+                    function:(YapDatabaseSecondaryIndexAggregateFunction)function
+                      column:(NSString *)column
+               groupByColumn:(NSString *)groupByColumn
+{
+	if (name == nil)
+	{
+		NSAssert(NO, @"Invalid aggregate name: nil");
+		
+		YDBLogError(@"%@: Invalid aggregate name: nil", THIS_METHOD);
+		return;
+	}
+	
+	if ([self isExistingAggregateName:name])
+	{
+		NSAssert(NO, @"Invalid aggregate name: name already exists");
+		
+		YDBLogError(@"%@: Invalid aggregate name: name already exists", THIS_METHOD);
+		return;
+	}
+	
+	if (function != YapDatabaseSecondaryIndexAggregateFunctionCount &&
+	    function != YapDatabaseSecondaryIndexAggregateFunctionSum   &&
+	    function != YapDatabaseSecondaryIndexAggregateFunctionMin   &&
+	    function != YapDatabaseSecondaryIndexAggregateFunctionMax    )
+	{
+		NSAssert(NO, @"Invalid aggregate function");
+		
+		YDBLogError(@"%@: Invalid aggregate function", THIS_METHOD);
+		return;
+	}
+	
+	if (column == nil && function != YapDatabaseSecondaryIndexAggregateFunctionCount)
+	{
+		NSAssert(NO, @"Invalid aggregate column: nil");
+		
+		YDBLogError(@"%@: Invalid aggregate column: nil (only a count may omit the column)", THIS_METHOD);
+		return;
+	}
+	
+	if (column && ![self isExistingName:column])
+	{
+		NSAssert(NO, @"Invalid aggregate column: column doesn't exist in setup");
+		
+		YDBLogError(@"%@: Invalid aggregate column (%@): column doesn't exist in setup", THIS_METHOD, column);
+		return;
+	}
+	
+	if (groupByColumn && ![self isExistingName:groupByColumn])
+	{
+		NSAssert(NO, @"Invalid aggregate groupByColumn: column doesn't exist in setup");
+		
+		YDBLogError(@"%@: Invalid aggregate groupByColumn (%@): column doesn't exist in setup",
+		            THIS_METHOD, groupByColumn);
+		return;
+	}
+	
+	YapDatabaseSecondaryIndexAggregate *aggregate =
+	  [[YapDatabaseSecondaryIndexAggregate alloc] initWithName:name
+	                                                  function:function
+	                                                    column:column
+	                                             groupByColumn:groupByColumn];
+	
+	[aggregates addObject:aggregate];
+}
+
+- (NSArray<YapDatabaseSecondaryIndexAggregate *> *)aggregates
+{
+	return [aggregates copy];
+}
+
+- (NSString *)aggregatesSignature
+{
+	NSMutableString *signature = [NSMutableString stringWithCapacity:(32 * [aggregates count])];
+	
+	for (YapDatabaseSecondaryIndexAggregate *aggregate in aggregates)
+	{
+		[signature appendFormat:@"%@|%ld|%@|%@;",
+		  aggregate.name, (long)aggregate.function, (aggregate.column ?: @""), (aggregate.groupByColumn ?: @"")];
+	}
+	
+	return signature;
+}
+
+- (NSDictionary<NSString *, NSString *> *)createIndexStatementsForTable:(NSString *)tableName
+{
+	NSMutableDictionary *statements = [NSMutableDictionary dictionaryWithCapacity:([setup count] + [indexes count])];
+	
+	// Single column indexes.
+	// These use the column name as the index name (as they always have).
+	
+	for (YapDatabaseSecondaryIndexColumn *column in setup)
+	{
+		statements[column.name] =
+		  [NSString stringWithFormat:@"CREATE INDEX \"%@\" ON \"%@\" (\"%@\")", column.name, tableName, column.name];
+	}
+	
+	// Composite indexes.
+	// Index names are shared by every table in the database, so these are prefixed with the table name.
+	
+	for (YapDatabaseSecondaryIndexCompositeIndex *index in indexes)
+	{
+		NSString *indexName = [NSString stringWithFormat:@"%@_%@", tableName, index.name];
+		
+		NSMutableString *statement = [NSMutableString stringWithCapacity:100];
+		[statement appendFormat:@"CREATE INDEX \"%@\" ON \"%@\" (", indexName, tableName];
+		
+		NSUInteger i = 0;
+		for (NSString *columnName in index.columns)
+		{
+			if (i > 0) [statement appendString:@", "];
+			[statement appendFormat:@"\"%@\"", columnName];
+			
+			if ([index.sortOrders[i] integerValue] == YapDatabaseSecondaryIndexSortOrderDescending)
+				[statement appendString:@" DESC"];
+			
+			i++;
+		}
+		
+		for (NSString *columnName in index.coveringColumns)
+		{
+			[statement appendFormat:@", \"%@\"", columnName];
+		}
+		
+		[statement appendString:@")"];
+		
+		if ([index.predicate length] > 0)
+		{
+			[statement appendFormat:@" WHERE %@", index.predicate];
+		}
+		
+		statements[indexName] = statement;
+	}
+	
+	return statements;
+}
+
 - (id)copyWithZone:(NSZone __unused *)zone
 {
 	YapDatabaseSecondaryIndexSetup *copy = [[YapDatabaseSecondaryIndexSetup alloc] initForCopy];
 	copy->setup = [setup mutableCopy];
+	copy->indexes = [indexes mutableCopy];
+	copy->aggregates = [aggregates mutableCopy];
 	
 	return copy;
 }
@@ -261,3 +544,76 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
 }
 
 @end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseSecondaryIndexCompositeIndex
+
+@synthesize name = name;
+@synthesize columns = columns;
+@synthesize sortOrders = sortOrders;
+@synthesize coveringColumns = coveringColumns;
+@synthesize predicate = predicate;
+
+- (id)initWithName:(NSString *)inName
+           columns:(NSArray<NSString *> *)inColumns
+        sortOrders:(NSArray<NSNumber *> *)inSortOrders
+   coveringColumns:(NSArray<NSString *> *)inCoveringColumns
+         predicate:(NSString *)inPredicate
+{
+	if ((self = [super init]))
+	{
+		name = [inName copy];
+		columns = [inColumns copy];
+		sortOrders = [inSortOrders copy];
+		coveringColumns = [inCoveringColumns copy];
+		predicate = [inPredicate copy];
+	}
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseSecondaryIndexCompositeIndex: name(%@), columns(%@), coveringColumns(%@), predicate(%@)>",
+	  name, [columns componentsJoinedByString:@", "], [coveringColumns componentsJoinedByString:@", "], predicate];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseSecondaryIndexAggregate
+
+@synthesize name = name;
+@synthesize function = function;
+@synthesize column = column;
+@synthesize groupByColumn = groupByColumn;
+
+- (id)initWithName:(NSString *)inName
+          function:(YapDatabaseSecondaryIndexAggregateFunction)inFunction
+            column:(NSString *)inColumn
+     groupByColumn:(NSString *)inGroupByColumn
+{
+	if ((self = [super init]))
+	{
+		name = [inName copy];
+		function = inFunction;
+		column = [inColumn copy];
+		groupByColumn = [inGroupByColumn copy];
+	}
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseSecondaryIndexAggregate: name(%@), function(%ld), column(%@), groupByColumn(%@)>",
+	  name, (long)function, column, groupByColumn];
+}
+
+@end
@@ -51,6 +51,18 @@ NS_ASSUME_NONNULL_BEGIN
                         usingBlock:
                             (void (^)(NSString *collection, NSString *key, id object, __nullable id metadata, BOOL *stop))block;
 
+/**
+ * Enumerates the rowids of the matching rows, without fetching anything from the database table.
+ *
+ * This is useful when you only need to collect or intersect the matches,
+ * or to pass them on to another query (e.g. "WHERE rowid IN (?)", as with rowidsForKeys:inCollection:).
+ *
+ * Note: The other enumerate methods already fetch the rows in batches (in read-only transactions),
+ * so there's no need to use this method just to speed up enumerateKeysAndObjectsMatchingQuery:.
+**/
+- (BOOL)enumerateRowidsMatchingQuery:(YapDatabaseQuery *)query
+                          usingBlock:(void (^)(int64_t rowid, BOOL *stop))block;
+
 - (BOOL)enumerateIndexedValuesInColumn:(NSString *)column matchingQuery:(YapDatabaseQuery *)query usingBlock:(void(^)(id indexedValue, BOOL *stop))block;
 
 /**
@@ -68,6 +80,33 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (id)performAggregateQuery:(YapDatabaseQuery *)query;
 
+/**
+ * Returns the value of a materialized aggregate for the given group.
+ * See -[YapDatabaseSecondaryIndexSetup addAggregateWithName:function:column:groupByColumn:].
+ *
+ * This is the equivalent of performing the aggregate query for the group,
+ * e.g. "SELECT SUM(amount) FROM tableName WHERE accountId IS ?", but it's a single lookup in the aggregates table.
+ *
+ * @param aggregateName
+ *   The name of the aggregate (as declared in the setup).
+ *
+ * @param group
+ *   The value of the groupByColumn (bound just like a query parameter).
+ *   Pass nil if the aggregate doesn't have a groupByColumn, or for the group of rows without a value.
+ *
+ * @return
+ *   The value of the aggregate. A count returns zero for an unknown group.
+ *   A SUM, MIN or MAX returns nil for an unknown group (or if every value of the group is NULL).
+**/
+- (nullable id)valueForAggregate:(NSString *)aggregateName group:(nullable id)group;
+
+/**
+ * Enumerates every group of a materialized aggregate (in no particular order),
+ * which is the equivalent of "SELECT groupByColumn, FUNCTION(column) FROM tableName GROUP BY groupByColumn".
+**/
+- (void)enumerateGroupsForAggregate:(NSString *)aggregateName
+                         usingBlock:(void (^)(id _Nullable group, id _Nullable value, BOOL *stop))block;
+
 /**
  * This method assists in performing a query over a subset of rows,
  * where the subset is a known set of keys.
@@ -87,6 +126,16 @@ NS_ASSUME_NONNULL_BEGIN
 - (NSDictionary<NSString*, NSNumber*> *)rowidsForKeys:(NSArray<NSString *> *)keys
                                          inCollection:(nullable NSString *)collection;
 
+/**
+ * Returns YES if the secondary index is still being populated incrementally,
+ * as configured via YapDatabaseSecondaryIndexOptions.populationChunkSize.
+ *
+ * While this is the case, queries only reflect the rows that have been populated so far.
+ * (Changes made to populated rows are reflected immediately, as usual.)
+ * The return value is consistent for the lifetime of the transaction.
+**/
+- (BOOL)isPopulating;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -3,7 +3,9 @@
 #import "YapDatabaseStatement.h"
 
 #import "YapDatabasePrivate.h"
+#import "YapDatabaseString.h"
 #import "YapDatabaseExtensionPrivate.h"
+#import "YapDatabaseQueryPrivate.h"
 
 #import "YapDatabaseLogging.h"
 
@@ -25,6 +27,67 @@
 static NSString *const ext_key_classVersion       = @"classVersion";
 static NSString *const ext_key_versionTag         = @"versionTag";
 static NSString *const ext_key_version_deprecated = @"version";
+static NSString *const ext_key_populationRowid    = @"populationRowid";
+static NSString *const ext_key_aggregates         = @"aggregates";
+
+/**
+ * The chunk size used when resuming an incremental population,
+ * if the extension is no longer configured with a populationChunkSize.
+**/
+static NSUInteger const YapDatabaseSecondaryIndexDefaultPopulationChunkSize = 1000;
+
+/**
+ * The statements used to maintain & read the materialized aggregates.
+ * Every statement binds the name of the aggregate to ?1.
+ * The maintenance statements bind the rowid of the (index table) row to ?2, the read statements bind the group.
+**/
+typedef NS_ENUM(NSInteger, YDBSecondaryIndexAggregateStatement) {
+	YDBSecondaryIndexAggregateStatementEnsure,    // inserts the group of the row (if missing)
+	YDBSecondaryIndexAggregateStatementAdd,       // adds the row to its group
+	YDBSecondaryIndexAggregateStatementRemove,    // removes the row from its group
+	YDBSecondaryIndexAggregateStatementPrune,     // deletes the group of the row (if empty)
+	YDBSecondaryIndexAggregateStatementClear,     // deletes every group
+	YDBSecondaryIndexAggregateStatementRebuild,   // inserts every group (computed from the index table)
+	YDBSecondaryIndexAggregateStatementGet,       // reads a group
+	YDBSecondaryIndexAggregateStatementEnumerate, // reads every group
+	YDBSecondaryIndexAggregateStatementRecompute, // computes the value of a group (from the index table)
+	YDBSecondaryIndexAggregateStatementRefresh    // stores a recomputed value (binds the value to ?3)
+};
+
+/**
+ * Converts a column of the current row to an object (nil for NULL).
+**/
+static id YDBSecondaryIndexColumnValue(sqlite3_stmt *statement, int column_idx)
+{
+	int column_type = sqlite3_column_type(statement, column_idx);
+	
+	if (column_type == SQLITE_INTEGER)
+	{
+		int64_t num = sqlite3_column_int64(statement, column_idx);
+		return @(num);
+	}
+	else if (column_type == SQLITE_FLOAT)
+	{
+		double num = sqlite3_column_double(statement, column_idx);
+		return @(num);
+	}
+	else if (column_type == SQLITE_TEXT)
+	{
+		const unsigned char *text = sqlite3_column_text(statement, column_idx);
+		int textSize = sqlite3_column_bytes(statement, column_idx);
+		
+		return [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+	}
+	else if (column_type == SQLITE_BLOB)
+	{
+		const void *blob = sqlite3_column_blob(statement, column_idx);
+		int blobSize = sqlite3_column_bytes(statement, column_idx);
+		
+		return [[NSData alloc] initWithBytes:blob length:blobSize];
+	}
+	
+	return nil;
+}
 
 
 @implementation YapDatabaseSecondaryIndexTransaction
@@ -159,6 +222,24 @@ static NSString *const ext_key_version_deprecated = @"version";
 		#endif
 	}
 	
+	// Create, drop or re-create indexes (if the declared indexes changed).
+	// This doesn't require the table to be re-populated.
+	
+	if (![self updateIndexes]) return NO;
+	
+	// Create, drop or rebuild the materialized aggregates (if the declared aggregates changed).
+	// This doesn't require the table to be re-populated either.
+	
+	if (![self updateAggregates]) return NO;
+	
+	// Check for an incremental population that's in progress.
+	// This may be one we just started (above), or one that was interrupted during a previous app launch.
+	
+	if ([self getInt64Value:NULL forExtensionKey:ext_key_populationRowid persistent:YES])
+	{
+		atomic_store(&parentConnection->parent->populationSnapshot, UINT64_MAX);
+	}
+	
 	return YES;
 }
 
@@ -198,6 +279,17 @@ static NSString *const ext_key_version_deprecated = @"version";
 		return NO;
 	}
 	
+	NSString *aggregateTableName = [parentConnection->parent aggregateTableName];
+	NSString *dropAggregateTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", aggregateTableName];
+	
+	status = sqlite3_exec(db, [dropAggregateTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed dropping secondary index aggregate table (%@): %d %s",
+		            THIS_METHOD, dropAggregateTable, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
 	return YES;
 }
 
@@ -254,16 +346,242 @@ static NSString *const ext_key_version_deprecated = @"version";
 		return NO;
 	}
 	
-	for (YapDatabaseSecondaryIndexColumn *column in setup)
+	// The indexes are created by updateIndexes
+	
+	if ([parentConnection->parent->aggregates count] > 0)
+	{
+		// The aggregates are maintained as the table is populated (below)
+		
+		if (![self createAggregateTable]) return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * Creates the side table that stores the materialized aggregates.
+ * It has a row per (aggregate, group):
+ *
+ * - rows  : the number of rows in the group
+ * - count : the number of non-NULL values (of the aggregated column) in the group
+ * - value : the SUM / MIN / MAX of the group (NULL for a COUNT)
+ * - stale : YES if the MIN / MAX needs to be recomputed (because the row with the extreme value was removed)
+ *
+ * The "group" & "value" columns don't have an affinity, so the values are stored exactly as they are in the index table.
+**/
+- (BOOL)createAggregateTable
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *aggregateTableName = [parentConnection->parent aggregateTableName];
+	
+	NSString *createTable = [NSString stringWithFormat:
+	  @"CREATE TABLE IF NOT EXISTS \"%@\""
+	  @" (\"name\" TEXT NOT NULL,"
+	  @"  \"group\","
+	  @"  \"rows\" INTEGER NOT NULL,"
+	  @"  \"count\" INTEGER NOT NULL,"
+	  @"  \"value\","
+	  @"  \"stale\" INTEGER NOT NULL"
+	  @" );", aggregateTableName];
+	
+	NSString *createIndex = [NSString stringWithFormat:
+	  @"CREATE INDEX IF NOT EXISTS \"%@_name_group\" ON \"%@\" (\"name\", \"group\");",
+	  aggregateTableName, aggregateTableName];
+	
+	int status = sqlite3_exec(db, [createTable UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed creating secondary index aggregate table (%@): %d %s",
+		            THIS_METHOD, aggregateTableName, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	status = sqlite3_exec(db, [createIndex UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Failed creating secondary index aggregate index (%@): %d %s",
+		            THIS_METHOD, aggregateTableName, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * This method is called (after the table has been created & populated) to sync the aggregates with the setup.
+ * If the declared aggregates changed, every aggregate is rebuilt from the index table.
+**/
+- (BOOL)updateAggregates
+{
+	YapDatabaseSecondaryIndexSetup *setup = parentConnection->parent->setup;
+	
+	NSString *signature = [setup aggregatesSignature];
+	NSString *oldSignature = [self stringValueForExtensionKey:ext_key_aggregates persistent:YES];
+	
+	if ([parentConnection->parent->aggregates count] == 0)
+	{
+		if (oldSignature)
+		{
+			sqlite3 *db = databaseTransaction->connection->db;
+			
+			NSString *aggregateTableName = [parentConnection->parent aggregateTableName];
+			NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", aggregateTableName];
+			
+			int status = sqlite3_exec(db, [dropTable UTF8String], NULL, NULL, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"%@ - Failed dropping secondary index aggregate table (%@): %d %s",
+				            THIS_METHOD, aggregateTableName, status, sqlite3_errmsg(db));
+				return NO;
+			}
+			
+			[self removeValueForExtensionKey:ext_key_aggregates persistent:YES];
+		}
+		
+		return YES;
+	}
+	
+	if (![self createAggregateTable]) return NO;
+	
+	if (![oldSignature isEqualToString:signature])
+	{
+		YDBLogInfo(@"%@ (%@): Rebuilding aggregates", THIS_METHOD, [self registeredName]);
+		
+		[self rebuildAggregates];
+		[self setStringValue:signature forExtensionKey:ext_key_aggregates persistent:YES];
+	}
+	
+	return YES;
+}
+
+/**
+ * Internal method.
+ *
+ * Returns the indexes of the table (name -> sql), as listed in sqlite_master, or nil on error.
+ * Indexes that sqlite creates automatically (e.g. for UNIQUE constraints) aren't included.
+**/
+- (NSMutableDictionary<NSString *, NSString *> *)existingIndexes
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *tableName = [self tableName];
+	NSMutableDictionary<NSString *, NSString *> *existingIndexes = [NSMutableDictionary dictionary];
+	
+	// SELECT "name", "sql" FROM "sqlite_master" WHERE "type" = 'index' AND "tbl_name" = ?;
+	
+	sqlite3_stmt *statement = NULL;
+	char *stmt = "SELECT \"name\", \"sql\" FROM \"sqlite_master\" WHERE \"type\" = 'index' AND \"tbl_name\" = ?;";
+	
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return nil;
+	}
+	
+	YapDatabaseString _tableName; MakeYapDatabaseString(&_tableName, tableName);
+	sqlite3_bind_text(statement, SQLITE_BIND_START, _tableName.str, _tableName.length, SQLITE_STATIC);
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		const unsigned char *text0 = sqlite3_column_text(statement, SQLITE_COLUMN_START + 0);
+		int textSize0 = sqlite3_column_bytes(statement, SQLITE_COLUMN_START + 0);
+		
+		const unsigned char *text1 = sqlite3_column_text(statement, SQLITE_COLUMN_START + 1);
+		int textSize1 = sqlite3_column_bytes(statement, SQLITE_COLUMN_START + 1);
+		
+		// Indexes that sqlite creates automatically (e.g. for UNIQUE constraints) don't have any sql.
+		
+		if (text1 == NULL) continue;
+		
+		NSString *name = [[NSString alloc] initWithBytes:text0 length:textSize0 encoding:NSUTF8StringEncoding];
+		NSString *sql = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+		
+		existingIndexes[name] = sql;
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_tableName);
+	
+	if (status != SQLITE_DONE) return nil;
+	
+	return existingIndexes;
+}
+
+/**
+ * Internal method.
+ *
+ * This method is called (after the table has been created) to sync the indexes of the table with the setup.
+ * It compares the declared indexes to the existing ones (in sqlite_master),
+ * drops any index that's no longer declared (or whose declaration changed), and creates the missing ones.
+**/
+- (BOOL)updateIndexes
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *tableName = [self tableName];
+	YapDatabaseSecondaryIndexSetup *setup = parentConnection->parent->setup;
+	
+	NSDictionary<NSString *, NSString *> *declaredIndexes = [setup createIndexStatementsForTable:tableName];
+	
+	NSMutableDictionary<NSString *, NSString *> *existingIndexes = [self existingIndexes];
+	if (existingIndexes == nil) return NO;
+	
+	int status;
+	NSCharacterSet *trim = [NSCharacterSet characterSetWithCharactersInString:@" \t\n;"];
+	
+	// Drop the indexes that are no longer declared (or whose declaration changed)
+	
+	for (NSString *name in [existingIndexes allKeys])
+	{
+		NSString *existingSQL = [existingIndexes[name] stringByTrimmingCharactersInSet:trim];
+		NSString *declaredSQL = declaredIndexes[name];
+		
+		if (declaredSQL && [existingSQL isEqualToString:declaredSQL]) continue;
+		
+		YDBLogInfo(@"%@ (%@): Dropping index: %@", THIS_METHOD, [self registeredName], name);
+		
+		NSString *dropIndex = [NSString stringWithFormat:@"DROP INDEX IF EXISTS \"%@\";", name];
+		
+		status = sqlite3_exec(db, [dropIndex UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed dropping index (%@): %d %s", THIS_METHOD, name, status, sqlite3_errmsg(db));
+			return NO;
+		}
+		
+		[existingIndexes removeObjectForKey:name];
+	}
+	
+	// Create the missing indexes
+	
+	for (NSString *name in declaredIndexes)
 	{
-		NSString *createIndex =
-		    [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS \"%@\" ON \"%@\" (\"%@\");",
-		        column.name, tableName, column.name];
+		if (existingIndexes[name]) continue;
+		
+		// Index names are shared by every table in the database.
+		// And a single column index is named after its column, so another table may already have one with this name.
+		// Which is why we use "IF NOT EXISTS" (as we always have).
+		
+		NSString *declaredSQL = declaredIndexes[name];
+		NSString *createIndex = [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS%@;",
+		                         [declaredSQL substringFromIndex:[@"CREATE INDEX" length]]];
 		
 		status = sqlite3_exec(db, [createIndex UTF8String], NULL, NULL, NULL);
 		if (status != SQLITE_OK)
 		{
-			YDBLogError(@"Failed creating index on '%@': %d %s", column.name, status, sqlite3_errmsg(db));
+			YDBLogError(@"%@ - Failed creating index (%@): %d %s", THIS_METHOD, name, status, sqlite3_errmsg(db));
 			return NO;
 		}
 	}
@@ -285,15 +603,87 @@ static NSString *const ext_key_version_deprecated = @"version";
 	// Remove everything from the database
 	
 	[self removeAllRowids];
+	[self removeValueForExtensionKey:ext_key_populationRowid persistent:YES];
+	
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	
+	if (secondaryIndex->options.populationChunkSize > 0 && !isRebuilding)
+	{
+		// The existing rows will be populated incrementally, after the extension has been registered.
+		// See populateNextChunk.
+		
+		[self setInt64Value:0 forExtensionKey:ext_key_populationRowid persistent:YES];
+		
+		loadedPopulationState = YES;
+		isPopulating = YES;
+		populationRowid = 0;
+		
+		return YES;
+	}
 	
 	// Enumerate the existing rows in the database and populate the indexes
 	
-	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
 	
 	YapDatabaseSecondaryIndexHandler *handler = secondaryIndex->handler;
 	YapDatabaseBlockType blockType = handler->blockType;
 	
+	YapDatabaseExtensionPopulation *population =
+	  ((YapDatabaseReadWriteTransaction *)databaseTransaction)->extensionPopulation;
+	
+	if (population)
+	{
+		// Multiple extensions are being registered together.
+		// The rows will be handed to us during a shared enumeration of the database.
+		
+		YapDatabaseExtensionPopulationBlock block =
+		^(int64_t rowid, NSString *collection, NSString *key, id object, id metadata){
+			
+			if (blockType == YapDatabaseBlockTypeWithKey)
+			{
+				__unsafe_unretained YapDatabaseSecondaryIndexWithKeyBlock secondaryIndexBlock =
+				  (YapDatabaseSecondaryIndexWithKeyBlock)handler->block;
+				
+				secondaryIndexBlock(databaseTransaction, parentConnection->blockDict, collection, key);
+			}
+			else if (blockType == YapDatabaseBlockTypeWithObject)
+			{
+				__unsafe_unretained YapDatabaseSecondaryIndexWithObjectBlock secondaryIndexBlock =
+				  (YapDatabaseSecondaryIndexWithObjectBlock)handler->block;
+				
+				secondaryIndexBlock(databaseTransaction, parentConnection->blockDict, collection, key, object);
+			}
+			else if (blockType == YapDatabaseBlockTypeWithMetadata)
+			{
+				__unsafe_unretained YapDatabaseSecondaryIndexWithMetadataBlock secondaryIndexBlock =
+				  (YapDatabaseSecondaryIndexWithMetadataBlock)handler->block;
+				
+				secondaryIndexBlock(databaseTransaction, parentConnection->blockDict, collection, key, metadata);
+			}
+			else
+			{
+				__unsafe_unretained YapDatabaseSecondaryIndexWithRowBlock secondaryIndexBlock =
+				  (YapDatabaseSecondaryIndexWithRowBlock)handler->block;
+				
+				secondaryIndexBlock(databaseTransaction, parentConnection->blockDict, collection, key, object, metadata);
+			}
+			
+			if ([parentConnection->blockDict count] > 0)
+			{
+				[self addRowid:rowid isNew:YES];
+				[parentConnection->blockDict removeAllObjects];
+			}
+		};
+		
+		[population addParticipantWithName:[self registeredName]
+		                allowedCollections:allowedCollections
+		                         blockType:blockType
+		                            filter:nil
+		                             block:block
+		                        completion:nil];
+		return YES;
+	}
+	
 	if (blockType == YapDatabaseBlockTypeWithKey)
 	{
 		__unsafe_unretained YapDatabaseSecondaryIndexWithKeyBlock secondaryIndexBlock =
@@ -430,59 +820,202 @@ static NSString *const ext_key_version_deprecated = @"version";
 #pragma clang diagnostic pop
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Accessors
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-/**
- * Required override method from YapDatabaseExtensionTransaction.
-**/
-- (YapDatabaseReadTransaction *)databaseTransaction
-{
-	return databaseTransaction;
-}
-
 /**
- * Required override method from YapDatabaseExtensionTransaction.
+ * Internal method.
+ *
+ * Fetches the progress of an incremental population (if there is one) as of this transaction's snapshot.
+ * If no incremental population is in progress, this requires only an atomic read.
 **/
-- (YapDatabaseExtensionConnection *)extensionConnection
-{
-	return parentConnection;
-}
-
-- (NSString *)registeredName
-{
-	return [parentConnection->parent registeredName];
-}
-
-- (NSString *)tableName
+- (void)loadPopulationStateIfNeeded
 {
-	return [parentConnection->parent tableName];
+	if (loadedPopulationState) return;
+	loadedPopulationState = YES;
+	
+	uint64_t snapshot = [databaseTransaction->connection snapshot];
+	
+	if (snapshot < atomic_load(&parentConnection->parent->populationSnapshot))
+	{
+		isPopulating = [self getInt64Value:&populationRowid forExtensionKey:ext_key_populationRowid persistent:YES];
+	}
+	else
+	{
+		isPopulating = NO;
+	}
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Logic
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Adds a row to the table, using the given rowid along with the values in the 'blockDict' ivar.
+ * YapDatabaseExtensionTransaction subclass hook.
+ *
+ * Populates the next chunk of rows (in rowid order), and persists the progress.
+ * Rows that haven't been reached yet are ignored by the transaction hooks,
+ * and are instead processed (with their current values) once the population gets to them.
 **/
-- (void)addRowid:(int64_t)rowid isNew:(BOOL)isNew
+- (BOOL)populateNextChunk
 {
-	YDBLogAutoTrace();
-	
-	sqlite3_stmt *statement = NULL;
-	if (isNew)
-		statement = [parentConnection insertStatement];
-	else
-		statement = [parentConnection updateStatement];
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 	
-	if (statement == NULL)
-		return;
+	[self loadPopulationStateIfNeeded];
+	if (!isPopulating) return YES;
 	
-	//  isNew : INSERT            INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
-	// !isNew : INSERT OR REPLACE INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
+	
+	NSUInteger chunkSize = secondaryIndex->options.populationChunkSize;
+	if (chunkSize == 0)
+		chunkSize = YapDatabaseSecondaryIndexDefaultPopulationChunkSize;
+	
+	YapDatabaseBlockType blockType = secondaryIndex->handler->blockType;
+	
+	BOOL (^filter)(int64_t rowid, NSString *collection, NSString *key) = NULL;
+	if (allowedCollections)
+	{
+		filter = ^BOOL (int64_t __unused rowid, NSString *collection, NSString __unused *key) {
+			
+			return [allowedCollections isAllowed:collection];
+		};
+	}
+	
+	int64_t lastRowid = populationRowid;
+	NSUInteger count =
+	  [databaseTransaction _enumerateRowsAfterRowid:populationRowid
+	                                          limit:chunkSize
+	                                    withObjects:(blockType & YapDatabaseBlockType_ObjectFlag) ? YES : NO
+	                                       metadata:(blockType & YapDatabaseBlockType_MetadataFlag) ? YES : NO
+	                                      lastRowid:&lastRowid
+	                                     usingBlock:
+	    ^(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL __unused *stop)
+	{
+		populationRowid = rowid;
+		
+		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		[self _handleChangeWithRowid:rowid collectionKey:ck object:object metadata:metadata isInsert:YES];
+		
+	} withFilter:filter];
+	
+	populationRowid = lastRowid;
+	
+	if (count < chunkSize)
+	{
+		YDBLogVerbose(@"Completed incremental population of secondary index(%@)", [self registeredName]);
+		
+		[self removeValueForExtensionKey:ext_key_populationRowid persistent:YES];
+		
+		isPopulating = NO;
+		didCompletePopulation = YES;
+		return YES;
+	}
+	else
+	{
+		[self setInt64Value:populationRowid forExtensionKey:ext_key_populationRowid persistent:YES];
+		return NO;
+	}
+	
+#pragma clang diagnostic pop
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Bulk Load
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+**/
+- (BOOL)supportsBulkLoad
+{
+	return YES;
+}
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+ *
+ * Repopulates the table (in full, even if the extension is configured with a populationChunkSize),
+ * with the indexes of the table dropped. Each index is then created in a single pass over the sorted values,
+ * rather than being updated with every insert. The aggregates are likewise rebuilt once, at the end.
+**/
+- (BOOL)rebuildAfterBulkLoad
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSDictionary<NSString *, NSString *> *existingIndexes = [self existingIndexes];
+	if (existingIndexes == nil) return NO;
+	
+	for (NSString *name in existingIndexes)
+	{
+		NSString *dropIndex = [NSString stringWithFormat:@"DROP INDEX IF EXISTS \"%@\";", name];
+		
+		int status = sqlite3_exec(db, [dropIndex UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed dropping index (%@): %d %s", THIS_METHOD, name, status, sqlite3_errmsg(db));
+			return NO;
+		}
+	}
+	
+	[self loadPopulationStateIfNeeded];
+	BOOL wasPopulating = isPopulating;
+	
+	isRebuilding = YES;
+	BOOL result = [self populate];
+	isRebuilding = NO;
+	
+	if (!result) return NO;
+	if (![self updateIndexes]) return NO;
+	
+	[self rebuildAggregates];
 	
+	if (wasPopulating)
+	{
+		// The rows that an incremental population hadn't reached yet were populated as well.
+		
+		isPopulating = NO;
+		didCompletePopulation = YES;
+	}
+	
+	return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Accessors
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+**/
+- (YapDatabaseReadTransaction *)databaseTransaction
+{
+	return databaseTransaction;
+}
+
+/**
+ * Required override method from YapDatabaseExtensionTransaction.
+**/
+- (YapDatabaseExtensionConnection *)extensionConnection
+{
+	return parentConnection;
+}
+
+- (NSString *)registeredName
+{
+	return [parentConnection->parent registeredName];
+}
+
+- (NSString *)tableName
+{
+	return [parentConnection->parent tableName];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Logic
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Binds the given rowid, along with the values in the 'blockDict' ivar, to the given statement.
+ * The rowid is bound to the first parameter, followed by one parameter per column (in setup order).
+**/
+- (void)bindRowid:(int64_t)rowid toStatement:(sqlite3_stmt *)statement
+{
 	int bind_idx = SQLITE_BIND_START;
 	
 	sqlite3_bind_int64(statement, bind_idx, rowid);
@@ -568,6 +1101,75 @@ static NSString *const ext_key_version_deprecated = @"version";
 		
 		bind_idx++;
 	}
+}
+
+/**
+ * Returns YES if the table already contains a row for the given rowid,
+ * and every column of that row matches the values in the 'blockDict' ivar.
+**/
+- (BOOL)isUnchangedRowid:(int64_t)rowid
+{
+	sqlite3_stmt *statement = [parentConnection compareStatement];
+	if (statement == NULL)
+		return NO;
+	
+	// SELECT ("column1" IS ?2) AND ("column2" IS ?3) ... FROM "tableName" WHERE "rowid" = ?1;
+	
+	[self bindRowid:rowid toStatement:statement];
+	
+	BOOL isUnchanged = NO;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		isUnchanged = (sqlite3_column_int(statement, SQLITE_COLUMN_START) != 0);
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'compareStatement': %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return isUnchanged;
+}
+
+/**
+ * Adds a row to the table, using the given rowid along with the values in the 'blockDict' ivar.
+ *
+ * When updating an existing row, the write is skipped if none of the indexed values changed.
+ * (Most updates only touch properties that aren't indexed,
+ *  and rewriting an identical row would still dirty the index pages & grow the WAL.)
+**/
+- (void)addRowid:(int64_t)rowid isNew:(BOOL)isNew
+{
+	YDBLogAutoTrace();
+	
+	if (!isNew && [self isUnchangedRowid:rowid])
+	{
+		return;
+	}
+	
+	sqlite3_stmt *statement = NULL;
+	if (isNew)
+		statement = [parentConnection insertStatement];
+	else
+		statement = [parentConnection updateStatement];
+	
+	if (statement == NULL)
+		return;
+	
+	//  isNew : INSERT            INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	// !isNew : INSERT OR REPLACE INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	
+	[self bindRowid:rowid toStatement:statement];
+	
+	if (!isNew)
+	{
+		[self removeRowidFromAggregates:rowid];
+	}
 	
 	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
@@ -580,6 +1182,11 @@ static NSString *const ext_key_version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
+	if (status == SQLITE_DONE && !isRebuilding)
+	{
+		[self addRowidToAggregates:rowid];
+	}
+	
 	[parentConnection->mutationStack markAsMutated];
 }
 
@@ -596,6 +1203,8 @@ static NSString *const ext_key_version_deprecated = @"version";
 	
 	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
 	
+	[self removeRowidFromAggregates:rowid];
+	
 	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
 	{
@@ -624,6 +1233,11 @@ static NSString *const ext_key_version_deprecated = @"version";
 		return;
 	}
 	
+	for (NSNumber *rowidNumber in rowids)
+	{
+		[self removeRowidFromAggregates:[rowidNumber longLongValue]];
+	}
+	
 	// DELETE FROM "tableName" WHERE "rowid" in (?, ?, ...);
 	//
 	// Note: We don't have to worry sqlite's max number of host parameters.
@@ -674,6 +1288,48 @@ static NSString *const ext_key_version_deprecated = @"version";
 	[parentConnection->mutationStack markAsMutated];
 }
 
+- (void)removeRowidsInCollection:(NSString *)collection
+{
+	YDBLogAutoTrace();
+	
+	// DELETE FROM "tableName" WHERE "rowid" IN (SELECT "rowid" FROM "database2" WHERE "collection" = ?);
+	
+	NSString *query = [NSString stringWithFormat:
+	  @"DELETE FROM \"%@\" WHERE \"rowid\" IN (SELECT \"rowid\" FROM \"database2\" WHERE \"collection\" = ?);",
+	  [self tableName]];
+	
+	sqlite3_stmt *statement;
+	
+	int status = sqlite3_prepare_v2(databaseTransaction->connection->db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating 'removeRowidsInCollection' statement: %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		return;
+	}
+	
+	int const bind_idx_collection = SQLITE_BIND_START;
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'removeRowidsInCollection' statement: %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
+	
+	// The rows were removed in bulk (without reading their values), so rebuild the aggregates from what remains.
+	
+	[self rebuildAggregates];
+	
+	[parentConnection->mutationStack markAsMutated];
+}
+
 - (void)removeAllRowids
 {
 	YDBLogAutoTrace();
@@ -698,9 +1354,485 @@ static NSString *const ext_key_version_deprecated = @"version";
 	
 	sqlite3_reset(statement);
 	
+	for (YapDatabaseSecondaryIndexAggregate *aggregate in parentConnection->parent->aggregates)
+	{
+		[self executeAggregateStatement:YDBSecondaryIndexAggregateStatementClear forAggregate:aggregate rowid:0];
+	}
+	
 	[parentConnection->mutationStack markAsMutated];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Aggregates
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the sql for the given aggregate statement.
+ * See YDBSecondaryIndexAggregateStatement for the parameters of each statement.
+**/
+- (NSString *)sqlForAggregateStatement:(YDBSecondaryIndexAggregateStatement)kind
+                          forAggregate:(YapDatabaseSecondaryIndexAggregate *)aggregate
+{
+	NSString *tableName = [self tableName];
+	NSString *aggregateTableName = [parentConnection->parent aggregateTableName];
+	
+	NSString *column = aggregate.column;
+	NSString *groupByColumn = aggregate.groupByColumn;
+	
+	NSString *function = nil;
+	switch (aggregate.function)
+	{
+		case YapDatabaseSecondaryIndexAggregateFunctionSum : function = @"SUM"; break;
+		case YapDatabaseSecondaryIndexAggregateFunctionMin : function = @"MIN"; break;
+		case YapDatabaseSecondaryIndexAggregateFunctionMax : function = @"MAX"; break;
+		default                                            : function = nil;    break;
+	}
+	
+	// The value (X) & group (G) of the row with the bound rowid.
+	// A count without a column counts every row, so its "value" is never NULL.
+	
+	NSString *(^valueOfRow)(NSString *) = ^NSString *(NSString *columnName){
+		return [NSString stringWithFormat:@"(SELECT i.\"%@\" FROM \"%@\" AS i WHERE i.\"rowid\" = ?2)",
+		                                  columnName, tableName];
+	};
+	
+	NSString *X = column ? valueOfRow(column) : @"1";
+	NSString *G = groupByColumn ? valueOfRow(groupByColumn) : @"NULL";
+	
+	NSString *rowExists =
+	  [NSString stringWithFormat:@"EXISTS (SELECT 1 FROM \"%@\" AS i WHERE i.\"rowid\" = ?2)", tableName];
+	
+	switch (kind)
+	{
+		case YDBSecondaryIndexAggregateStatementEnsure :
+		{
+			NSString *iG = groupByColumn ? [NSString stringWithFormat:@"i.\"%@\"", groupByColumn] : @"NULL";
+			
+			return [NSString stringWithFormat:
+			  @"INSERT INTO \"%@\" (\"name\", \"group\", \"rows\", \"count\", \"value\", \"stale\")"
+			  @" SELECT ?1, %@, 0, 0, NULL, 0 FROM \"%@\" AS i WHERE i.\"rowid\" = ?2"
+			  @" AND NOT EXISTS (SELECT 1 FROM \"%@\" WHERE \"name\" = ?1 AND \"group\" IS %@);",
+			  aggregateTableName, iG, tableName, aggregateTableName, iG];
+		}
+		case YDBSecondaryIndexAggregateStatementAdd :
+		case YDBSecondaryIndexAggregateStatementRemove :
+		{
+			BOOL isAdd = (kind == YDBSecondaryIndexAggregateStatementAdd);
+			
+			NSString *value = @"\"value\"";
+			NSString *stale = @"\"stale\"";
+			
+			if (aggregate.function == YapDatabaseSecondaryIndexAggregateFunctionSum)
+			{
+				if (isAdd)
+					value = [NSString stringWithFormat:
+					  @"CASE WHEN %1$@ IS NULL THEN \"value\" WHEN \"count\" = 0 THEN %1$@"
+					  @" ELSE \"value\" + %1$@ END", X];
+				else
+					value = [NSString stringWithFormat:
+					  @"CASE WHEN %1$@ IS NULL THEN \"value\" WHEN \"count\" = 1 THEN NULL"
+					  @" ELSE \"value\" - %1$@ END", X];
+			}
+			else if (function) // MIN or MAX
+			{
+				// Adding a row can only extend the extreme (unless it's already stale).
+				// Removing the row that holds the extreme makes the value stale (it's recomputed lazily).
+				
+				if (isAdd)
+				{
+					value = [NSString stringWithFormat:
+					  @"CASE WHEN %1$@ IS NULL THEN \"value\" WHEN \"count\" = 0 THEN %1$@"
+					  @" WHEN \"stale\" THEN \"value\" ELSE %2$@(\"value\", %1$@) END", X, [function lowercaseString]];
+					stale = [NSString stringWithFormat:
+					  @"CASE WHEN %1$@ IS NOT NULL AND \"count\" = 0 THEN 0 ELSE \"stale\" END", X];
+				}
+				else
+				{
+					value = [NSString stringWithFormat:
+					  @"CASE WHEN %1$@ IS NULL THEN \"value\" WHEN \"count\" = 1 THEN NULL"
+					  @" WHEN \"stale\" THEN \"value\" WHEN %1$@ IS \"value\" THEN NULL ELSE \"value\" END", X];
+					stale = [NSString stringWithFormat:
+					  @"CASE WHEN %1$@ IS NULL THEN \"stale\" WHEN \"count\" = 1 THEN 0"
+					  @" WHEN %1$@ IS \"value\" THEN 1 ELSE \"stale\" END", X];
+				}
+			}
+			
+			return [NSString stringWithFormat:
+			  @"UPDATE \"%@\" SET \"rows\" = \"rows\" %@ 1, \"count\" = \"count\" %@ (%@ IS NOT NULL),"
+			  @" \"value\" = %@, \"stale\" = %@"
+			  @" WHERE \"name\" = ?1 AND \"group\" IS %@ AND %@;",
+			  aggregateTableName, (isAdd ? @"+" : @"-"), (isAdd ? @"+" : @"-"), X, value, stale, G, rowExists];
+		}
+		case YDBSecondaryIndexAggregateStatementPrune :
+		{
+			return [NSString stringWithFormat:
+			  @"DELETE FROM \"%@\" WHERE \"name\" = ?1 AND \"group\" IS %@ AND \"rows\" <= 0;",
+			  aggregateTableName, G];
+		}
+		case YDBSecondaryIndexAggregateStatementClear :
+		{
+			return [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE \"name\" = ?1;", aggregateTableName];
+		}
+		case YDBSecondaryIndexAggregateStatementRebuild :
+		{
+			NSString *groupExpr = groupByColumn ? [NSString stringWithFormat:@"\"%@\"", groupByColumn] : @"NULL";
+			NSString *countExpr = column ? [NSString stringWithFormat:@"COUNT(\"%@\")", column] : @"COUNT(*)";
+			NSString *valueExpr = function ? [NSString stringWithFormat:@"%@(\"%@\")", function, column] : @"NULL";
+			NSString *groupBy = groupByColumn ? [NSString stringWithFormat:@" GROUP BY \"%@\"", groupByColumn] : @"";
+			
+			// The subquery filters out the (empty) group that an aggregate without a GROUP BY returns for an empty table.
+			
+			return [NSString stringWithFormat:
+			  @"INSERT INTO \"%@\" (\"name\", \"group\", \"rows\", \"count\", \"value\", \"stale\")"
+			  @" SELECT * FROM (SELECT ?1, %@, COUNT(*) AS \"r\", %@, %@, 0 FROM \"%@\"%@) WHERE \"r\" > 0;",
+			  aggregateTableName, groupExpr, countExpr, valueExpr, tableName, groupBy];
+		}
+		case YDBSecondaryIndexAggregateStatementGet :
+		{
+			return [NSString stringWithFormat:
+			  @"SELECT \"count\", \"value\", \"stale\" FROM \"%@\" WHERE \"name\" = ?1 AND \"group\" IS ?2;",
+			  aggregateTableName];
+		}
+		case YDBSecondaryIndexAggregateStatementEnumerate :
+		{
+			return [NSString stringWithFormat:
+			  @"SELECT \"group\", \"count\", \"value\", \"stale\" FROM \"%@\" WHERE \"name\" = ?1;",
+			  aggregateTableName];
+		}
+		case YDBSecondaryIndexAggregateStatementRecompute :
+		{
+			// Only a MIN or MAX is recomputed. The name isn't used, but ?1 is still declared (for consistent binding).
+			
+			NSString *where = groupByColumn ? [NSString stringWithFormat:@"\"%@\" IS ?2", groupByColumn] : @"?2 IS NULL";
+			
+			return [NSString stringWithFormat:@"SELECT %@(\"%@\") FROM \"%@\" WHERE %@ AND ?1 IS NOT NULL;",
+			                                  function, column, tableName, where];
+		}
+		case YDBSecondaryIndexAggregateStatementRefresh :
+		{
+			return [NSString stringWithFormat:
+			  @"UPDATE \"%@\" SET \"value\" = ?3, \"stale\" = 0 WHERE \"name\" = ?1 AND \"group\" IS ?2;",
+			  aggregateTableName];
+		}
+	}
+	
+	return nil;
+}
+
+/**
+ * Returns the prepared statement (cached by the connection), with the name of the aggregate bound to ?1.
+**/
+- (sqlite3_stmt *)aggregateStatement:(YDBSecondaryIndexAggregateStatement)kind
+                        forAggregate:(YapDatabaseSecondaryIndexAggregate *)aggregate
+{
+	NSString *cacheKey = [NSString stringWithFormat:@"%ld|%@", (long)kind, aggregate.name];
+	
+	sqlite3_stmt *statement = NULL;
+	
+	YapDatabaseStatement *wrapper = parentConnection->aggregateStatements[cacheKey];
+	if (wrapper)
+	{
+		statement = wrapper.stmt;
+	}
+	else
+	{
+		sqlite3 *db = databaseTransaction->connection->db;
+		NSString *sql = [self sqlForAggregateStatement:kind forAggregate:aggregate];
+		
+		int status = sqlite3_prepare_v2(db, [sql UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating aggregate statement:\n sql: '%@'\n error: %d %s",
+			            THIS_METHOD, sql, status, sqlite3_errmsg(db));
+			return NULL;
+		}
+		
+		parentConnection->aggregateStatements[cacheKey] = [[YapDatabaseStatement alloc] initWithStatement:statement];
+	}
+	
+	YapDatabaseString _name; MakeYapDatabaseString(&_name, aggregate.name);
+	sqlite3_bind_text(statement, SQLITE_BIND_START, _name.str, _name.length, SQLITE_TRANSIENT);
+	FreeYapDatabaseString(&_name);
+	
+	return statement;
+}
+
+/**
+ * Executes one of the maintenance statements, which bind the rowid to ?2.
+**/
+- (void)executeAggregateStatement:(YDBSecondaryIndexAggregateStatement)kind
+                     forAggregate:(YapDatabaseSecondaryIndexAggregate *)aggregate
+                            rowid:(int64_t)rowid
+{
+	sqlite3_stmt *statement = [self aggregateStatement:kind forAggregate:aggregate];
+	if (statement == NULL) return;
+	
+	sqlite3_bind_int64(statement, SQLITE_BIND_START + 1, rowid);
+	
+	int status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ (%@): Error executing aggregate statement (%ld) for aggregate (%@): %d %s",
+		            THIS_METHOD, [self registeredName], (long)kind, aggregate.name,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+}
+
+/**
+ * Adds the (just written) row to every aggregate.
+**/
+- (void)addRowidToAggregates:(int64_t)rowid
+{
+	for (YapDatabaseSecondaryIndexAggregate *aggregate in parentConnection->parent->aggregates)
+	{
+		[self executeAggregateStatement:YDBSecondaryIndexAggregateStatementEnsure forAggregate:aggregate rowid:rowid];
+		[self executeAggregateStatement:YDBSecondaryIndexAggregateStatementAdd forAggregate:aggregate rowid:rowid];
+	}
+}
+
+/**
+ * Removes the row from every aggregate.
+ * This must be invoked BEFORE the row is removed (or replaced), as the statements read the current values of the row.
+**/
+- (void)removeRowidFromAggregates:(int64_t)rowid
+{
+	for (YapDatabaseSecondaryIndexAggregate *aggregate in parentConnection->parent->aggregates)
+	{
+		[self executeAggregateStatement:YDBSecondaryIndexAggregateStatementRemove forAggregate:aggregate rowid:rowid];
+		[self executeAggregateStatement:YDBSecondaryIndexAggregateStatementPrune forAggregate:aggregate rowid:rowid];
+	}
+}
+
+/**
+ * Recomputes every aggregate from the index table.
+**/
+- (void)rebuildAggregates
+{
+	for (YapDatabaseSecondaryIndexAggregate *aggregate in parentConnection->parent->aggregates)
+	{
+		[self executeAggregateStatement:YDBSecondaryIndexAggregateStatementClear forAggregate:aggregate rowid:0];
+		[self executeAggregateStatement:YDBSecondaryIndexAggregateStatementRebuild forAggregate:aggregate rowid:0];
+	}
+}
+
+- (YapDatabaseSecondaryIndexAggregate *)aggregateWithName:(NSString *)aggregateName
+{
+	for (YapDatabaseSecondaryIndexAggregate *aggregate in parentConnection->parent->aggregates)
+	{
+		if ([aggregate.name isEqualToString:aggregateName]) return aggregate;
+	}
+	
+	return nil;
+}
+
+/**
+ * Recomputes the value of a stale MIN / MAX, with the group already bound (to ?2) by the caller.
+ * Within a read-write transaction, the recomputed value is also stored (if the refresh flag is set).
+**/
+- (id)recomputeAggregate:(YapDatabaseSecondaryIndexAggregate *)aggregate
+                   group:(id)group
+              groupValue:(sqlite3_value *)groupValue
+                 refresh:(BOOL)refresh
+{
+	sqlite3_stmt *statement = [self aggregateStatement:YDBSecondaryIndexAggregateStatementRecompute
+	                                      forAggregate:aggregate];
+	if (statement == NULL) return nil;
+	
+	if (groupValue)
+		sqlite3_bind_value(statement, SQLITE_BIND_START + 1, groupValue);
+	else if (group)
+		[self bindQueryParameters:@[ group ] forStatement:statement withOffset:(SQLITE_BIND_START + 1)];
+	
+	id result = nil;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		result = YDBSecondaryIndexColumnValue(statement, SQLITE_COLUMN_START);
+		
+		if (refresh && databaseTransaction->isReadWriteTransaction)
+		{
+			sqlite3_stmt *refreshStatement = [self aggregateStatement:YDBSecondaryIndexAggregateStatementRefresh
+			                                             forAggregate:aggregate];
+			if (refreshStatement)
+			{
+				if (group)
+					[self bindQueryParameters:@[ group ] forStatement:refreshStatement withOffset:(SQLITE_BIND_START + 1)];
+				
+				sqlite3_bind_value(refreshStatement, SQLITE_BIND_START + 2,
+				                   sqlite3_column_value(statement, SQLITE_COLUMN_START));
+				
+				int refreshStatus = sqlite3_step(refreshStatement);
+				if (refreshStatus != SQLITE_DONE)
+				{
+					YDBLogError(@"%@ - Error refreshing aggregate (%@): %d %s", THIS_METHOD, aggregate.name,
+					            refreshStatus, sqlite3_errmsg(databaseTransaction->connection->db));
+				}
+				
+				sqlite3_clear_bindings(refreshStatement);
+				sqlite3_reset(refreshStatement);
+			}
+		}
+	}
+	else
+	{
+		YDBLogError(@"%@ - Error recomputing aggregate (%@): %d %s", THIS_METHOD, aggregate.name,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return result;
+}
+
+/**
+ * Returns the value of the aggregate, given the (count, value, stale) columns of a group.
+**/
+- (id)valueForAggregate:(YapDatabaseSecondaryIndexAggregate *)aggregate
+              statement:(sqlite3_stmt *)statement
+            columnIndex:(int)column_idx
+                  group:(id)group
+             groupValue:(sqlite3_value *)groupValue
+                refresh:(BOOL)refresh
+{
+	int64_t count = sqlite3_column_int64(statement, column_idx);
+	
+	if (aggregate.function == YapDatabaseSecondaryIndexAggregateFunctionCount)
+	{
+		return @(count);
+	}
+	
+	if (count == 0)
+	{
+		return nil;
+	}
+	
+	BOOL stale = (sqlite3_column_int(statement, column_idx + 2) != 0);
+	if (stale)
+	{
+		return [self recomputeAggregate:aggregate group:group groupValue:groupValue refresh:refresh];
+	}
+	
+	return YDBSecondaryIndexColumnValue(statement, column_idx + 1);
+}
+
+- (id)valueForAggregate:(NSString *)aggregateName group:(id)group
+{
+	YapDatabaseSecondaryIndexAggregate *aggregate = [self aggregateWithName:aggregateName];
+	if (aggregate == nil)
+	{
+		YDBLogWarn(@"%@ - No such aggregate: %@", THIS_METHOD, aggregateName);
+		return nil;
+	}
+	
+	sqlite3_stmt *statement = [self aggregateStatement:YDBSecondaryIndexAggregateStatementGet forAggregate:aggregate];
+	if (statement == NULL) return nil;
+	
+	// SELECT "count", "value", "stale" FROM "aggregateTableName" WHERE "name" = ?1 AND "group" IS ?2;
+	
+	if (group)
+		[self bindQueryParameters:@[ group ] forStatement:statement withOffset:(SQLITE_BIND_START + 1)];
+	
+	id result = nil;
+	BOOL found = NO;
+	BOOL stale = NO;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		found = YES;
+		stale = (sqlite3_column_int(statement, SQLITE_COLUMN_START + 2) != 0);
+		
+		if (!stale)
+		{
+			result = [self valueForAggregate:aggregate
+			                       statement:statement
+			                     columnIndex:SQLITE_COLUMN_START
+			                           group:group
+			                      groupValue:NULL
+			                         refresh:NO];
+		}
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	if (stale)
+	{
+		// The statement has been reset, so the recomputed value can be stored.
+		result = [self recomputeAggregate:aggregate group:group groupValue:NULL refresh:YES];
+	}
+	
+	if (!found && aggregate.function == YapDatabaseSecondaryIndexAggregateFunctionCount)
+	{
+		result = @(0);
+	}
+	
+	return result;
+}
+
+- (void)enumerateGroupsForAggregate:(NSString *)aggregateName
+                         usingBlock:(void (^)(id group, id value, BOOL *stop))block
+{
+	if (block == NULL) return;
+	
+	YapDatabaseSecondaryIndexAggregate *aggregate = [self aggregateWithName:aggregateName];
+	if (aggregate == nil)
+	{
+		YDBLogWarn(@"%@ - No such aggregate: %@", THIS_METHOD, aggregateName);
+		return;
+	}
+	
+	sqlite3_stmt *statement = [self aggregateStatement:YDBSecondaryIndexAggregateStatementEnumerate
+	                                      forAggregate:aggregate];
+	if (statement == NULL) return;
+	
+	// SELECT "group", "count", "value", "stale" FROM "aggregateTableName" WHERE "name" = ?1;
+	
+	BOOL stop = NO;
+	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		id group = YDBSecondaryIndexColumnValue(statement, SQLITE_COLUMN_START);
+		
+		id value = [self valueForAggregate:aggregate
+		                         statement:statement
+		                       columnIndex:(SQLITE_COLUMN_START + 1)
+		                             group:group
+		                        groupValue:sqlite3_column_value(statement, SQLITE_COLUMN_START)
+		                           refresh:NO];
+		
+		block(group, value, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Cleanup & Commit
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -712,6 +1844,14 @@ static NSString *const ext_key_version_deprecated = @"version";
 {
 	YDBLogAutoTrace();
 	
+	if (didCompletePopulation)
+	{
+		// Transactions at (or after) this snapshot see the fully populated index.
+		
+		uint64_t snapshot = [databaseTransaction->connection snapshot];
+		atomic_store(&parentConnection->parent->populationSnapshot, snapshot);
+	}
+	
 	[parentConnection postCommitCleanup];
 	
 	// An extensionTransaction is only valid within the scope of its encompassing databaseTransaction.
@@ -754,19 +1894,45 @@ static NSString *const ext_key_version_deprecated = @"version";
                       metadata:(id)metadata
                       isInsert:(BOOL)isInsert
 {
-	YDBLogAutoTrace();
-	
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
+	{
+		return;
+	}
+	
+	[self loadPopulationStateIfNeeded];
+	if (isPopulating && (rowid > populationRowid))
+	{
+		// An incremental population is in progress, and it hasn't reached this row yet.
+		// The row will be processed (with its current values) once the population gets to it.
+		return;
+	}
+	
+	[self _processChangeWithRowid:rowid
+	                collectionKey:collectionKey
+	                       object:object
+	                     metadata:metadata
+	                     isInsert:isInsert];
+}
+
+/**
+ * The second half of _handleChangeWithRowid:..., after the allowedCollections & population checks.
+**/
+- (void)_processChangeWithRowid:(int64_t)rowid
+                  collectionKey:(YapCollectionKey *)collectionKey
+                         object:(id)object
+                       metadata:(id)metadata
+                       isInsert:(BOOL)isInsert
+{
 	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
 	
 	__unsafe_unretained NSString *collection = collectionKey.collection;
 	__unsafe_unretained NSString *key = collectionKey.key;
 	
-	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
-	if (allowedCollections && ![allowedCollections isAllowed:collection])
-	{
-		return;
-	}
-	
 	// Invoke the block to find out if the object should be included in the index.
 	
 	YapDatabaseSecondaryIndexHandler *handler = secondaryIndex->handler;
@@ -801,6 +1967,14 @@ static NSString *const ext_key_version_deprecated = @"version";
 		block(databaseTransaction, parentConnection->blockDict, collection, key, object, metadata);
 	}
 	
+	[self _applyBlockDictWithRowid:rowid isInsert:isInsert];
+}
+
+/**
+ * Writes the values in the blockDict to the index (or removes the row from the index if the blockDict is empty).
+**/
+- (void)_applyBlockDictWithRowid:(int64_t)rowid isInsert:(BOOL)isInsert
+{
 	if ([parentConnection->blockDict count] == 0)
 	{
 		// Remove associated values from index (if needed).
@@ -867,6 +2041,217 @@ static NSString *const ext_key_version_deprecated = @"version";
 	                    isInsert:NO];
 }
 
+/**
+ * The batched version of _handleChangeWithRowid:...
+ *
+ * The allowedCollections is checked once per collection (rather than once per row),
+ * and the population state is loaded once.
+ * So the per-row work is just the block & the index statement.
+**/
+- (void)_handleChangesWithRowids:(NSArray<NSNumber *> *)rowids
+                  collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                         objects:(NSArray *)objects
+                        metadata:(NSArray *)metadata
+                        isInsert:(BOOL)isInsert
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
+	
+	[self loadPopulationStateIfNeeded];
+	
+	id yapNull = [YapNull null];
+	
+	NSString *lastCollection = nil;
+	BOOL lastCollectionAllowed = NO;
+	
+	NSUInteger count = collectionKeys.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		YapCollectionKey *collectionKey = collectionKeys[i];
+		
+		// The batch is (almost always) a single collection.
+		
+		NSString *collection = collectionKey.collection;
+		if (lastCollection == nil || ![lastCollection isEqualToString:collection])
+		{
+			lastCollection = collection;
+			lastCollectionAllowed = (allowedCollections == nil) || [allowedCollections isAllowed:collection];
+		}
+		
+		if (!lastCollectionAllowed) continue;
+		
+		int64_t rowid = [rowids[i] longLongValue];
+		if (isPopulating && (rowid > populationRowid)) continue;
+		
+		if (evaluatedHandlerResults)
+		{
+			// The block was already invoked (concurrently) for this row.
+			
+			id result = evaluatedHandlerResults[i];
+			if (result != yapNull)
+			{
+				[parentConnection->blockDict addEntriesFromDictionary:(NSDictionary *)result];
+			}
+			
+			[self _applyBlockDictWithRowid:rowid isInsert:isInsert];
+			continue;
+		}
+		
+		id meta = metadata[i];
+		if (meta == yapNull) meta = nil;
+		
+		[self _processChangeWithRowid:rowid
+		                collectionKey:collectionKey
+		                       object:objects[i]
+		                     metadata:meta
+		                     isInsert:isInsert];
+	}
+}
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+ * Concurrent evaluation is opt-in, via YapDatabaseSecondaryIndexOptions.allowsConcurrentEvaluation.
+**/
+- (BOOL)supportsConcurrentHandlerEvaluation
+{
+	return parentConnection->parent->options.allowsConcurrentEvaluation;
+}
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+ * Invoked on a background thread, so this only reads the (immutable) configuration of the extension.
+ *
+ * Each row gets its own dictionary (as opposed to the connection's blockDict, which isn't thread-safe).
+**/
+- (void)evaluateHandlersForObjects:(NSArray *)objects
+                 forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                      withMetadata:(NSArray *)metadata
+                             range:(NSRange)range
+                          isInsert:(BOOL)isInsert
+                           results:(NSMutableArray *)results
+{
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	__unsafe_unretained YapDatabaseSecondaryIndexHandler *handler = secondaryIndex->handler;
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
+	
+	YapDatabaseBlockType blockType = handler->blockType;
+	id yapNull = [YapNull null];
+	
+	YapDatabaseBlockInvoke blockInvokeBitMask = YapDatabaseBlockInvokeIfObjectModified |
+	                                            YapDatabaseBlockInvokeIfMetadataModified;
+	
+	BOOL skipAll = !isInsert && !(handler->blockInvokeOptions & blockInvokeBitMask);
+	
+	for (NSUInteger i = range.location; i < NSMaxRange(range); i++)
+	{
+		if (skipAll)
+		{
+			// didUpdateObjects:... won't process the rows
+			[results addObject:yapNull];
+			continue;
+		}
+		
+		__unsafe_unretained YapCollectionKey *collectionKey = collectionKeys[i];
+		
+		__unsafe_unretained NSString *collection = collectionKey.collection;
+		__unsafe_unretained NSString *key = collectionKey.key;
+		
+		if (allowedCollections && ![allowedCollections isAllowed:collection])
+		{
+			[results addObject:yapNull];
+			continue;
+		}
+		
+		id object = objects[i];
+		id meta = metadata[i];
+		if (meta == yapNull) meta = nil;
+		
+		NSMutableDictionary *dict =
+		  [NSMutableDictionary dictionaryWithSharedKeySet:secondaryIndex->columnNamesSharedKeySet];
+		
+		if (blockType == YapDatabaseBlockTypeWithKey)
+		{
+			((YapDatabaseSecondaryIndexWithKeyBlock)handler->block)
+			  (databaseTransaction, dict, collection, key);
+		}
+		else if (blockType == YapDatabaseBlockTypeWithObject)
+		{
+			((YapDatabaseSecondaryIndexWithObjectBlock)handler->block)
+			  (databaseTransaction, dict, collection, key, object);
+		}
+		else if (blockType == YapDatabaseBlockTypeWithMetadata)
+		{
+			((YapDatabaseSecondaryIndexWithMetadataBlock)handler->block)
+			  (databaseTransaction, dict, collection, key, meta);
+		}
+		else
+		{
+			((YapDatabaseSecondaryIndexWithRowBlock)handler->block)
+			  (databaseTransaction, dict, collection, key, object, meta);
+		}
+		
+		[results addObject:dict];
+	}
+}
+
+/**
+ * YapDatabaseExtensionTransaction hook.
+ * The results are consumed by the next didUpdateObjects:... or didInsertObjects:...
+**/
+- (void)setEvaluatedHandlerResults:(NSArray *)results
+{
+	evaluatedHandlerResults = results;
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didInsertObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids
+{
+	YDBLogAutoTrace();
+	
+	[self _handleChangesWithRowids:rowids
+	                collectionKeys:collectionKeys
+	                       objects:objects
+	                      metadata:metadata
+	                      isInsert:YES];
+}
+
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
+**/
+- (void)didUpdateObjects:(NSArray *)objects
+       forCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+            withMetadata:(NSArray *)metadata
+                  rowids:(NSArray<NSNumber *> *)rowids
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	__unsafe_unretained YapDatabaseSecondaryIndexHandler *handler = secondaryIndex->handler;
+	
+	YapDatabaseBlockInvoke blockInvokeBitMask = YapDatabaseBlockInvokeIfObjectModified |
+	                                            YapDatabaseBlockInvokeIfMetadataModified;
+	
+	if (!(handler->blockInvokeOptions & blockInvokeBitMask))
+	{
+		return;
+	}
+	
+	[self _handleChangesWithRowids:rowids
+	                collectionKeys:collectionKeys
+	                       objects:objects
+	                      metadata:metadata
+	                      isInsert:NO];
+}
+
 /**
  * YapDatabase extension hook.
  * This method is invoked by a YapDatabaseReadWriteTransaction as a post-operation-hook.
@@ -1046,7 +2431,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
 	
 	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
-	if (allowedCollections && ![allowedCollections isAllowed:collectionKey.collection])
+	if (allowedCollections && ![allowedCollections isAllowedCollectionKey:collectionKey])
 	{
 		return;
 	}
@@ -1084,6 +2469,26 @@ static NSString *const ext_key_version_deprecated = @"version";
 	[self removeAllRowids];
 }
 
+/**
+ * YapDatabase extension hook.
+ * This method is invoked by a YapDatabaseReadWriteTransaction as a pre-operation-hook.
+**/
+- (BOOL)handleRemoveAllObjectsInCollection:(NSString *)collection
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = secondaryIndex->options.allowedCollections;
+	if (allowedCollections && ![allowedCollections isAllowed:collection])
+	{
+		return YES;
+	}
+	
+	[self removeRowidsInCollection:collection];
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1184,7 +2589,12 @@ static NSString *const ext_key_version_deprecated = @"version";
 	// Create full query using given filtering clause(s)
 	
 	NSString *fullQueryString =
-	    [NSString stringWithFormat:@"SELECT \"rowid\" FROM \"%@\" %@;", [self tableName], query.queryString];
+	  [query fullQueryStringForKind:@"YapDatabaseSecondaryIndex.rowid"
+	                 registeredName:[self registeredName]
+	                     usingBlock:^NSString *{
+		
+		return [NSString stringWithFormat:@"SELECT \"rowid\" FROM \"%@\" %@;", [self tableName], query.queryString];
+	}];
 	
 	// Turn query into compiled sqlite statement (using cache if possible)
 	
@@ -1203,8 +2613,11 @@ static NSString *const ext_key_version_deprecated = @"version";
 	BOOL stop = NO;
 	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
 	
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+	
 	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
 	{
 		int64_t rowid = sqlite3_column_int64(statement, SQLITE_COLUMN_START);
 		
@@ -1222,6 +2635,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
+	if (YapDatabaseQueryProfileIsSlow(&profile)) {
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, query.queryParameters, [self registeredName]);
+	}
+	
 	if (!stop && mutation.isMutated)
 	{
 		@throw [self mutationDuringEnumerationException];
@@ -1249,9 +2666,8 @@ static NSString *const ext_key_version_deprecated = @"version";
 	return result;
 }
 
-- (BOOL)enumerateKeysAndMetadataMatchingQuery:(YapDatabaseQuery *)query
-                                   usingBlock:
-                            (void (^)(NSString *collection, NSString *key, id metadata, BOOL *stop))block
+- (BOOL)enumerateRowidsMatchingQuery:(YapDatabaseQuery *)query
+                          usingBlock:(void (^)(int64_t rowid, BOOL *stop))block
 {
 	BOOL result = [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *stop) {
 		
@@ -1261,59 +2677,154 @@ static NSString *const ext_key_version_deprecated = @"version";
 			return; // from block
 		}
 		
-		YapCollectionKey *ck = nil;
-		id metadata = nil;
-		[self->databaseTransaction getCollectionKey:&ck metadata:&metadata forRowid:rowid];
-		
-		block(ck.collection, ck.key, metadata, stop);
+		block(rowid, stop);
 	}];
 	
 	return result;
 }
 
-- (BOOL)enumerateKeysAndObjectsMatchingQuery:(YapDatabaseQuery *)query
-                                  usingBlock:
-                            (void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
+/**
+ * Private helper method for the enumerateKeysAndMetadata / KeysAndObjects / Rows methods.
+ *
+ * In a read-only transaction, the matching rowids are gathered in batches,
+ * and each batch is resolved with a single "rowid IN (?, ?, ...)" query (for all the cache misses),
+ * rather than with separate key & object/metadata lookups per row.
+ *
+ * In a read-write transaction every row is fetched on demand,
+ * as the block may modify rows that would otherwise already be sitting in the batch.
+**/
+- (BOOL)_enumerateRowsMatchingQuery:(YapDatabaseQuery *)query
+                        withObjects:(BOOL)withObjects
+                           metadata:(BOOL)withMetadata
+                         usingBlock:(void (^)(YapCollectionKey *ck, id object, id metadata, BOOL *stop))block
 {
-	BOOL result = [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *stop) {
+	if (block == NULL) // Query test : caller still wants BOOL result
+	{
+		return [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t __unused rowid, BOOL *stop) {
+			
+			*stop = YES;
+		}];
+	}
+	
+	if (databaseTransaction->isReadWriteTransaction)
+	{
+		return [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *stop) {
+			
+			YapCollectionKey *ck = nil;
+			id object = nil;
+			id metadata = nil;
+			
+			if (withObjects && withMetadata)
+				[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
+			else if (withObjects)
+				[self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
+			else
+				[self->databaseTransaction getCollectionKey:&ck metadata:&metadata forRowid:rowid];
+			
+			block(ck, object, metadata, stop);
+		}];
+	}
+	
+	NSUInteger const batchSize = 50;
+	
+	NSMutableArray<NSNumber *> *batch = [NSMutableArray arrayWithCapacity:batchSize];
+	
+	__block BOOL stop = NO;
+	
+	void (^processBatch)(void) = ^{
 		
-		if (block == NULL) // Query test : caller still wants BOOL result
+		NSArray *collectionKeys = nil;
+		NSArray *objects = nil;
+		NSArray *metadata = nil;
+		
+		[self->databaseTransaction getCollectionKeys:&collectionKeys
+		                                     objects:(withObjects ? &objects : NULL)
+		                                    metadata:(withMetadata ? &metadata : NULL)
+		                                   forRowids:batch];
+		
+		[batch removeAllObjects];
+		
+		NSUInteger count = collectionKeys.count;
+		for (NSUInteger i = 0; i < count && !stop; i++)
 		{
-			*stop = YES;
-			return; // from block
+			YapCollectionKey *ck = collectionKeys[i];
+			if ((id)ck == [NSNull null]) continue;
+			
+			id object = objects[i];
+			if (object == [NSNull null]) object = nil;
+			
+			id meta = metadata[i];
+			if (meta == [NSNull null]) meta = nil;
+			
+			block(ck, object, meta, &stop);
 		}
+	};
+	
+	BOOL result = [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *innerStop) {
 		
-		YapCollectionKey *ck = nil;
-		id object = nil;
-		[self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
+		[batch addObject:@(rowid)];
 		
-		block(ck.collection, ck.key, object, stop);
+		if (batch.count == batchSize)
+		{
+			processBatch();
+			if (stop) *innerStop = YES;
+		}
 	}];
 	
+	if (result && !stop && batch.count > 0)
+	{
+		processBatch();
+	}
+	
 	return result;
 }
 
+- (BOOL)enumerateKeysAndMetadataMatchingQuery:(YapDatabaseQuery *)query
+                                   usingBlock:
+                            (void (^)(NSString *collection, NSString *key, id metadata, BOOL *stop))block
+{
+	void (^rowBlock)(YapCollectionKey*, id, id, BOOL*) = NULL;
+	if (block)
+	{
+		rowBlock = ^(YapCollectionKey *ck, id __unused object, id metadata, BOOL *stop) {
+			
+			block(ck.collection, ck.key, metadata, stop);
+		};
+	}
+	
+	return [self _enumerateRowsMatchingQuery:query withObjects:NO metadata:YES usingBlock:rowBlock];
+}
+
+- (BOOL)enumerateKeysAndObjectsMatchingQuery:(YapDatabaseQuery *)query
+                                  usingBlock:
+                            (void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
+{
+	void (^rowBlock)(YapCollectionKey*, id, id, BOOL*) = NULL;
+	if (block)
+	{
+		rowBlock = ^(YapCollectionKey *ck, id object, id __unused metadata, BOOL *stop) {
+			
+			block(ck.collection, ck.key, object, stop);
+		};
+	}
+	
+	return [self _enumerateRowsMatchingQuery:query withObjects:YES metadata:NO usingBlock:rowBlock];
+}
+
 - (BOOL)enumerateRowsMatchingQuery:(YapDatabaseQuery *)query
                         usingBlock:
                             (void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
 {
-	BOOL result = [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *stop) {
-		
-		if (block == NULL) // Query test : caller still wants BOOL result
-		{
-			*stop = YES;
-			return; // from block
-		}
-		
-		YapCollectionKey *ck = nil;
-		id object = nil;
-		id metadata = nil;
-		[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
-		
-		block(ck.collection, ck.key, object, metadata, stop);
-	}];
+	void (^rowBlock)(YapCollectionKey*, id, id, BOOL*) = NULL;
+	if (block)
+	{
+		rowBlock = ^(YapCollectionKey *ck, id object, id metadata, BOOL *stop) {
+			
+			block(ck.collection, ck.key, object, metadata, stop);
+		};
+	}
 	
-	return result;
+	return [self _enumerateRowsMatchingQuery:query withObjects:YES metadata:YES usingBlock:rowBlock];
 }
 
 - (BOOL)_enumerateIndexedValuesInColumn:(NSString *)column
@@ -1347,8 +2858,11 @@ static NSString *const ext_key_version_deprecated = @"version";
 	BOOL stop = NO;
 	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
 
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+
 	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW)
 	{
 		int columnType = sqlite3_column_type(statement, SQLITE_COLUMN_START);
 		id indexedValue = nil;
@@ -1399,6 +2913,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 
+	if (YapDatabaseQueryProfileIsSlow(&profile)) {
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, query.queryParameters, [self registeredName]);
+	}
+
 	if (!stop && mutation.isMutated)
 	{
 		@throw [self mutationDuringEnumerationException];
@@ -1436,8 +2954,13 @@ static NSString *const ext_key_version_deprecated = @"version";
 	// Create full query using given filtering clause(s)
 	
 	NSString *fullQueryString =
-	    [NSString stringWithFormat:@"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" %@;",
-	                                                           [self tableName], query.queryString];
+	  [query fullQueryStringForKind:@"YapDatabaseSecondaryIndex.count"
+	                 registeredName:[self registeredName]
+	                     usingBlock:^NSString *{
+		
+		return [NSString stringWithFormat:@"SELECT COUNT(*) AS NumberOfRows FROM \"%@\" %@;",
+		                                                         [self tableName], query.queryString];
+	}];
 	
 	// Turn query into compiled sqlite statement (using cache if possible)
 	
@@ -1456,7 +2979,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	BOOL result = YES;
 	NSUInteger count = 0;
 	
-	int status = sqlite3_step(statement);
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+	
+	int status = YapDatabaseQueryProfileStep(&profile, statement);
 	if (status == SQLITE_ROW)
 	{
 		count = (NSUInteger)sqlite3_column_int64(statement, SQLITE_COLUMN_START);
@@ -1471,6 +2997,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
+	if (YapDatabaseQueryProfileIsSlow(&profile)) {
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, query.queryParameters, [self registeredName]);
+	}
+	
 	if (countPtr) *countPtr = count;
 	return result;
 }
@@ -1485,8 +3015,13 @@ static NSString *const ext_key_version_deprecated = @"version";
 	if (query.isAggregateQuery == NO) return nil;
 	
 	NSString *fullQueryString =
-	    [NSString stringWithFormat:@"SELECT %@ AS Result FROM \"%@\" %@;",
-	                                        query.aggregateFunction, [self tableName], query.queryString];
+	  [query fullQueryStringForKind:@"YapDatabaseSecondaryIndex.aggregate"
+	                 registeredName:[self registeredName]
+	                     usingBlock:^NSString *{
+		
+		return [NSString stringWithFormat:@"SELECT %@ AS Result FROM \"%@\" %@;",
+		                                      query.aggregateFunction, [self tableName], query.queryString];
+	}];
 	
 	// Turn query into compiled sqlite statement (using cache if possible)
 	
@@ -1504,40 +3039,13 @@ static NSString *const ext_key_version_deprecated = @"version";
 	
 	id result = nil;
 	
-	int status = sqlite3_step(statement);
+	YapDatabaseQueryProfile profile;
+	YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+	
+	int status = YapDatabaseQueryProfileStep(&profile, statement);
 	if (status == SQLITE_ROW)
 	{
-		int column_idx = SQLITE_COLUMN_START;
-		int column_type = sqlite3_column_type(statement, column_idx);
-		
-		if (column_type == SQLITE_INTEGER)
-		{
-			int64_t num = sqlite3_column_int64(statement, column_idx);
-			result = @(num);
-		}
-		else if (column_type == SQLITE_FLOAT)
-		{
-			double num = sqlite3_column_double(statement, column_idx);
-			result = @(num);
-		}
-		else if (column_type == SQLITE_TEXT)
-		{
-			const unsigned char *text = sqlite3_column_text(statement, column_idx);
-			int textSize = sqlite3_column_bytes(statement, column_idx);
-			
-			result = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
-		}
-		else if (column_type == SQLITE_BLOB)
-		{
-			const void *blob = sqlite3_column_blob(statement, column_idx);
-			int blobSize = sqlite3_column_bytes(statement, column_idx);
-			
-			result = [[NSData alloc] initWithBytes:blob length:blobSize];
-		}
-		else if (column_type == SQLITE_NULL)
-		{
-			result = [NSNull null];
-		}
+		result = YDBSecondaryIndexColumnValue(statement, SQLITE_COLUMN_START) ?: [NSNull null];
 	}
 	else if (status == SQLITE_ERROR)
 	{
@@ -1548,6 +3056,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
+	if (YapDatabaseQueryProfileIsSlow(&profile)) {
+		YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, query.queryParameters, [self registeredName]);
+	}
+	
 	return result;
 }
 
@@ -1571,6 +3083,12 @@ static NSString *const ext_key_version_deprecated = @"version";
  * YapDatabaseQuery *query =
  *   [YapDatabaseQuery queryWithAggregateFunction:@"SUM(duration)" format:@"WHERE rowid IN (?)", rowids];
 **/
+- (BOOL)isPopulating
+{
+	[self loadPopulationStateIfNeeded];
+	return isPopulating;
+}
+
 - (NSDictionary<NSString*, NSNumber*> *)rowidsForKeys:(NSArray<NSString *> *)keys
                                          inCollection:(nullable NSString *)collection
 {
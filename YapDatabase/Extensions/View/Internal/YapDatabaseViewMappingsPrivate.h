@@ -17,6 +17,16 @@
 - (void)updateWithTransaction:(YapDatabaseReadTransaction *)transaction
       forceUpdateRangeOptions:(BOOL)forceUpdateRangeOptions;
 
+/**
+ * Same as above, but only the given groups are refreshed (counts, and filter/sort if so configured).
+ * The changedGroups are the groups touched by the changesets since the last update.
+ *
+ * Passing nil refreshes every group.
+**/
+- (void)updateWithTransaction:(YapDatabaseReadTransaction *)transaction
+      forceUpdateRangeOptions:(BOOL)forceUpdateRangeOptions
+                changedGroups:(NSSet<NSString *> *)changedGroups;
+
 /**
  * During processing we need to disable the the isUsingConsolidatedGroup flag
  * in order to access the raw mappings.
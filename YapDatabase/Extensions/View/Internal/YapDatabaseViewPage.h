@@ -1,11 +1,21 @@
 #import <Foundation/Foundation.h>
+#import "YapCache.h"
 
-@interface YapDatabaseViewPage : NSObject <NSCopying>
+/**
+ * Pages report their (approximate) memory footprint as their YapCacheCost,
+ * so the pageCache can be limited in bytes. See YapDatabaseViewOptions.pageCacheCostLimit.
+**/
+@interface YapDatabaseViewPage : NSObject <NSCopying, YapCacheCost>
 
 - (id)init;
 - (id)initWithCapacity:(NSUInteger)capacity;
 
 - (NSData *)serialize;
+
+/**
+ * Decodes either page format (see YapDatabaseViewPage.mm).
+ * If the data is truncated or corrupt (or from an unknown future format), the page is left empty.
+**/
 - (void)deserialize:(NSData *)data;
 
 - (NSUInteger)count;
@@ -14,6 +24,7 @@
 
 - (void)addRowid:(int64_t)rowid;
 - (void)insertRowid:(int64_t)rowid atIndex:(NSUInteger)index;
+- (void)insertRowids:(const int64_t *)rowids count:(NSUInteger)count atIndex:(NSUInteger)index;
 
 - (void)removeRowidAtIndex:(NSUInteger)index;
 - (void)removeRange:(NSRange)range;
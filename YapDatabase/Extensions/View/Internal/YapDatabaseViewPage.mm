@@ -1,6 +1,144 @@
 #import "YapDatabaseViewPage.h"
 #include <vector>
 
+/**
+ * Page serialization formats:
+ *
+ * Version 1 (legacy):
+ *   The rowids as raw little-endian int64 values. So the length is always a multiple of 8.
+ *
+ * Version 2:
+ *   [version byte = 2] [varint count] [varint zigzag(rowid[i] - rowid[i-1]) ...] [padding]
+ *
+ *   Rowids within a page are usually close together, so most deltas fit in a single byte.
+ *   A zero padding byte is appended if needed, so that the length is never a multiple of 8.
+ *   This is how deserialize: tells the 2 formats apart.
+**/
+static uint8_t const YapDatabaseViewPageFormatVersion = 2;
+
+static inline uint64_t ZigZagEncode(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t ZigZagDecode(uint64_t value)
+{
+	return (int64_t)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+static inline uint8_t *WriteVarint(uint8_t *p, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		*p++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (uint8_t)value;
+	
+	return p;
+}
+
+/**
+ * Returns the position after the varint, or NULL if the varint is truncated or malformed.
+**/
+static inline const uint8_t *ReadVarint(const uint8_t *p, const uint8_t *end, uint64_t *valuePtr)
+{
+	uint64_t value = 0;
+	unsigned int shift = 0;
+	
+	while ((p < end) && (shift < 64))
+	{
+		uint8_t byte = *p++;
+		value |= ((uint64_t)(byte & 0x7F) << shift);
+		
+		if ((byte & 0x80) == 0)
+		{
+			*valuePtr = value;
+			return p;
+		}
+		
+		shift += 7;
+	}
+	
+	return NULL;
+}
+
+/**
+ * Encodes the rowids into the buffer, which must have room for (count * 10) + 12 bytes.
+ * Returns the number of bytes written.
+**/
+static size_t YapDatabaseViewPageEncode(const int64_t *rowids, size_t count, uint8_t *buffer)
+{
+	uint8_t *p = buffer;
+	
+	*p++ = YapDatabaseViewPageFormatVersion;
+	p = WriteVarint(p, (uint64_t)count);
+	
+	uint64_t prev = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t rowid = (uint64_t)rowids[i];
+		p = WriteVarint(p, ZigZagEncode((int64_t)(rowid - prev)));
+		prev = rowid;
+	}
+	
+	if (((size_t)(p - buffer) % sizeof(int64_t)) == 0)
+	{
+		*p++ = 0; // padding
+	}
+	
+	return (size_t)(p - buffer);
+}
+
+/**
+ * Decodes (version 2) bytes into the output, which must have room for count rowids.
+ * Returns the number of rowids decoded (which is less than count if the bytes are malformed).
+**/
+static size_t YapDatabaseViewPageDecode(const uint8_t *p, const uint8_t *end, size_t count, int64_t *output)
+{
+	uint64_t prev = 0;
+	size_t i = 0;
+	
+	while (i < count)
+	{
+		// Fast path:
+		// If the next 8 bytes are all single-byte varints (no continuation bits),
+		// then decode all 8 deltas at once, without any branches in the loop body.
+		// The compiler can unroll & vectorize this.
+		
+		if (((count - i) >= 8) && ((end - p) >= 8))
+		{
+			uint64_t word;
+			memcpy(&word, p, sizeof(word));
+			
+			if ((word & 0x8080808080808080ULL) == 0)
+			{
+				for (size_t k = 0; k < 8; k++)
+				{
+					prev += (uint64_t)ZigZagDecode(p[k]);
+					output[i + k] = (int64_t)prev;
+				}
+				
+				p += 8;
+				i += 8;
+				continue;
+			}
+		}
+		
+		uint64_t value = 0;
+		p = ReadVarint(p, end, &value);
+		if (p == NULL) break;
+		
+		prev += (uint64_t)ZigZagDecode(value);
+		output[i++] = (int64_t)prev;
+	}
+	
+	return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 @implementation YapDatabaseViewPage
 {
@@ -41,41 +179,72 @@
 
 - (NSData *)serialize
 {
-	NSUInteger count = vector->size();
-	NSUInteger numBytes = count * sizeof(int64_t);
+	size_t count = vector->size();
 	
-	int64_t *buffer = (int64_t *)malloc(numBytes);
-	memcpy(buffer, vector->data(), numBytes);
+	uint8_t *buffer = (uint8_t *)malloc((count * 10) + 12);
+	size_t length = YapDatabaseViewPageEncode(vector->data(), count, buffer);
 	
-	if (CFByteOrderGetCurrent() == CFByteOrderBigEndian)
-	{
-		for (NSUInteger i = 0; i < count; i++)
-		{
-			buffer[i] = CFSwapInt64HostToLittle(buffer[i]);
-		}
-	}
+	buffer = (uint8_t *)realloc(buffer, length);
 	
-	return [NSData dataWithBytesNoCopy:buffer length:numBytes freeWhenDone:YES];
+	return [NSData dataWithBytesNoCopy:buffer length:length freeWhenDone:YES];
 }
 
 - (void)deserialize:(NSData *)data
 {
 	vector->clear();
 	
-	NSUInteger count = [data length] / sizeof(int64_t);
-	int64_t *bytes = (int64_t *)[data bytes];
+	NSUInteger length = [data length];
 	
-	if (vector->capacity() < count)
-		vector->reserve(count);
+	if ((length % sizeof(int64_t)) == 0)
+	{
+		// Version 1 (legacy): raw little-endian int64 rowids
+		
+		NSUInteger count = length / sizeof(int64_t);
+		int64_t *bytes = (int64_t *)[data bytes];
+		
+		if (vector->capacity() < count)
+			vector->reserve(count);
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			int64_t rowid = bytes[i];
+			
+			if (CFByteOrderGetCurrent() == CFByteOrderBigEndian)
+				vector->push_back(CFSwapInt64LittleToHost(rowid));
+			else
+				vector->push_back(rowid);
+		}
+		
+		return;
+	}
+	
+	const uint8_t *bytes = (const uint8_t *)[data bytes];
+	const uint8_t *end = bytes + length;
 	
-	for (NSUInteger i = 0; i < count; i++)
+	if (bytes[0] != YapDatabaseViewPageFormatVersion)
 	{
-		int64_t rowid = bytes[i];
+		// Unknown format (written by a future version)
+		return;
+	}
+	
+	uint64_t count = 0;
+	const uint8_t *p = ReadVarint(bytes + 1, end, &count);
+	if (p == NULL) return;
+	
+	// Every rowid takes at least 1 byte.
+	// So a larger count means the data is truncated or corrupt.
+	
+	if (count > (uint64_t)(end - p)) return;
+	
+	vector->resize((size_t)count);
+	
+	size_t decodedCount = YapDatabaseViewPageDecode(p, end, (size_t)count, vector->data());
+	if (decodedCount < count)
+	{
+		// Truncated or corrupt data.
+		// A partial page would silently drop rowids, so we reject the page entirely.
 		
-		if (CFByteOrderGetCurrent() == CFByteOrderBigEndian)
-			vector->push_back(CFSwapInt64LittleToHost(rowid));
-		else
-			vector->push_back(rowid);
+		vector->clear();
 	}
 }
 
@@ -84,6 +253,13 @@
 	return (NSUInteger)(vector->size());
 }
 
+- (NSUInteger)yapCacheCost
+{
+	// The object & the vector, plus the (possibly over-allocated) buffer.
+	
+	return 48 + (NSUInteger)(vector->capacity() * sizeof(int64_t));
+}
+
 - (int64_t)rowidAtIndex:(NSUInteger)index
 {
 	return vector->at(index);
@@ -99,6 +275,11 @@
 	vector->insert(vector->begin() + index, rowid);
 }
 
+- (void)insertRowids:(const int64_t *)rowids count:(NSUInteger)count atIndex:(NSUInteger)index
+{
+	vector->insert(vector->begin() + index, rowids, rowids + count);
+}
+
 - (void)removeRowidAtIndex:(NSUInteger)index
 {
 	vector->erase(vector->begin() + index);
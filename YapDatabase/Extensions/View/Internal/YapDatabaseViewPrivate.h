@@ -8,6 +8,7 @@
 #import "YapDatabaseViewLocator.h"
 #import "YapDatabaseViewPage.h"
 #import "YapDatabaseViewPageMetadata.h"
+#import "YapDatabaseViewRowidMap.h"
 #import "YapDatabaseViewState.h"
 
 #import "YapDatabaseViewChangePrivate.h"
@@ -17,14 +18,14 @@
 #import "YapDatabaseExtensionPrivate.h"
 #import "YapDatabasePrivate.h"
 
-#import "YapDirtyDictionary.h"
+#import "YapRowidDirtyDictionary.h"
 
 /**
  * This version number is stored in the yap2 table.
  * If there is a major re-write to this class, then the version number will be incremented,
  * and the class can automatically rebuild the tables as needed.
 **/
-#define YAP_DATABASE_VIEW_CLASS_VERSION 3
+#define YAP_DATABASE_VIEW_CLASS_VERSION 4
 
 /**
  * The view is tasked with storing ordered arrays of rowids.
@@ -34,6 +35,13 @@
 **/
 #define YAP_DATABASE_VIEW_MAX_PAGE_SIZE 50
 
+/**
+ * With YapDatabaseViewPageSizingAdaptive, the page size of a group is doubled (up to the max multiplier)
+ * for as long as the group would need more than the given number of pages.
+**/
+#define YAP_DATABASE_VIEW_ADAPTIVE_PAGES_PER_GROUP   64
+#define YAP_DATABASE_VIEW_ADAPTIVE_MAX_MULTIPLIER    32
+
 /**
  * Keys for yap2 extension configuration table.
 **/
@@ -76,6 +84,7 @@ static NSString *const changeset_key_changes    = @"changes";
 
 - (NSString *)mapTableName;
 - (NSString *)pageTableName;
+- (NSString *)groupTableName;
 - (NSString *)pageMetadataTableName;
 
 - (BOOL)getState:(YapDatabaseViewState **)statePtr
@@ -107,7 +116,9 @@ static NSString *const changeset_key_changes    = @"changes";
 	YapCache *mapCache;
 	YapCache *pageCache;
 	
-	YapDirtyDictionary  *dirtyMaps;
+	YapDatabaseViewRowidMap *rowidMap; // Only if options.keepsRowidMapInMemory (nil until loaded)
+	
+	YapRowidDirtyDictionary  *dirtyMaps;
 	NSMutableDictionary *dirtyPages;
 	NSMutableDictionary *dirtyLinks;
 	BOOL reset;
@@ -143,6 +154,11 @@ static NSString *const changeset_key_changes    = @"changes";
 - (sqlite3_stmt *)pageTable_removeForPageKeyStatement;
 - (sqlite3_stmt *)pageTable_removeAllStatement;
 
+- (sqlite3_stmt *)groupTable_getGroupIdForGroupStatement;
+- (sqlite3_stmt *)groupTable_insertGroupStatement;
+- (sqlite3_stmt *)groupTable_removeForGroupStatement;
+- (sqlite3_stmt *)groupTable_removeAllStatement;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -156,6 +172,9 @@ static NSString *const changeset_key_changes    = @"changes";
 	YapMemoryTableTransaction *pageTableTransaction;
 	YapMemoryTableTransaction *pageMetadataTableTransaction;
 	
+	NSMutableDictionary<NSString *, NSData *> *preparedPageData;     // pageKey -> serialized page
+	NSMutableDictionary<NSString *, NSNumber *> *preparedPageCounts; // pageKey -> page count (when serialized)
+	
 @protected
 	
 	__unsafe_unretained YapDatabaseViewConnection *parentConnection;
@@ -177,6 +196,7 @@ static NSString *const changeset_key_changes    = @"changes";
 
 - (NSString *)mapTableName;
 - (NSString *)pageTableName;
+- (NSString *)groupTableName;
 - (NSString *)pageMetadataTableName;
 
 - (void)enumerateRowidsInGroup:(NSString *)group
@@ -199,12 +219,25 @@ static NSString *const changeset_key_changes    = @"changes";
 
 - (BOOL)getRowid:(int64_t *)rowidPtr atIndex:(NSUInteger)index inGroup:(NSString *)group;
 
+- (void)readaheadPagesForRange:(NSRange)range inGroup:(NSString *)group;
+- (void)readaheadPagesForIndexes:(NSDictionary<NSString *, NSIndexSet *> *)indexesByGroup;
+
 // Logic - ReadWrite
 
 - (void)insertRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey
                                          inGroup:(NSString *)group
                                          atIndex:(NSUInteger)index;
 
+- (void)appendRowids:(const int64_t *)rowids collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                                                    toGroup:(NSString *)group;
+
+- (void)insertRowids:(const int64_t *)rowids collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                                                    inGroup:(NSString *)group
+                                                    atIndex:(NSUInteger)index;
+
+- (void)reorderRowids:(const int64_t *)rowids collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                                                     inGroup:(NSString *)group;
+
 - (void)removeRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey;
 
 - (void)removeRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey
@@ -217,6 +250,8 @@ static NSString *const changeset_key_changes    = @"changes";
 - (void)removeRowidsWithCollectionKeys:(NSDictionary<NSNumber *, YapCollectionKey *> *)collectionKeys
                               locators:(NSDictionary<NSNumber *, YapDatabaseViewLocator *> *)locators;
 
+- (void)removeRowidsInRange:(NSRange)range inGroup:(NSString *)group;
+
 - (void)removeAllRowidsInGroup:(NSString *)group;
 - (void)removeAllRowids;
 
@@ -229,7 +264,11 @@ static NSString *const changeset_key_changes    = @"changes";
 enum {
 	YDB_GroupingMayHaveChanged  = 1 << 0,
 	YDB_SortingMayHaveChanged   = 1 << 1,
-	YDB_FilteringMayHaveChanged = 1 << 2
+	YDB_FilteringMayHaveChanged = 1 << 2,
+	
+	// Set along with YDB_FilteringMayHaveChanged if the filter only removed rows from the view.
+	// A filteredView stacked on top then only has to drop rows, without invoking its own filter.
+	YDB_FilteringIsStricter     = 1 << 3
 };
 
 @protocol YapDatabaseViewDependency <NSObject>
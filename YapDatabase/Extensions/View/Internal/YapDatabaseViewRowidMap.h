@@ -0,0 +1,41 @@
+#import <Foundation/Foundation.h>
+
+@class YapRowidDirtyDictionary;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The complete rowid -> pageKey mapping of a (persistent) view, held in memory.
+ * See YapDatabaseViewOptions.keepsRowidMapInMemory.
+ *
+ * Rowids are stored in a YapRowidMap, with a 32-bit page index as value.
+ * Every pageKey is stored once, and refcounted, so the index of a page is reused once the page is gone.
+ *
+ * Unlike the mapCache, the mapping is authoritative:
+ * if a rowid isn't in the map, then it isn't in the view.
+**/
+@interface YapDatabaseViewRowidMap : NSObject
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+- (NSUInteger)count;
+
+/**
+ * Returns nil if the rowid isn't in the view.
+**/
+- (nullable NSString *)pageKeyForRowid:(int64_t)rowid;
+
+- (void)setPageKey:(NSString *)pageKey forRowid:(int64_t)rowid;
+- (void)removeRowid:(int64_t)rowid;
+- (void)removeAllRowids;
+
+/**
+ * Applies the dirtyMaps of a transaction (values are either a pageKey, or NSNull if the rowid was removed).
+**/
+- (void)applyDirtyMaps:(YapRowidDirtyDictionary *)dirtyMaps;
+
+- (uint64_t)estimatedMemoryUsage;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,158 @@
+#import "YapDatabaseViewRowidMap.h"
+#import "YapRowidDirtyDictionary.h"
+#import "YapRowidMap.h"
+
+#include <vector>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+
+@implementation YapDatabaseViewRowidMap
+{
+	YapRowidMap<uint32_t> map;
+	
+	NSMutableArray<id> *pageKeys;                             // index -> pageKey (or NSNull if the index is free)
+	NSMutableDictionary<NSString *, NSNumber *> *pageIndexes; // pageKey -> index
+	
+	std::vector<uint32_t> refCounts;                          // index -> number of rowids
+	std::vector<uint32_t> freeIndexes;
+}
+
+- (instancetype)init
+{
+	return [self initWithCapacity:0];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+	if ((self = [super init]))
+	{
+		if (capacity > 0) {
+			map.reserve(capacity);
+		}
+		
+		pageKeys = [[NSMutableArray alloc] init];
+		pageIndexes = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (NSUInteger)count
+{
+	return map.size();
+}
+
+- (NSString *)pageKeyForRowid:(int64_t)rowid
+{
+	const uint32_t *pageIndex = map.find(rowid);
+	
+	return pageIndex ? pageKeys[*pageIndex] : nil;
+}
+
+- (uint32_t)retainIndexForPageKey:(NSString *)pageKey
+{
+	NSNumber *number = pageIndexes[pageKey];
+	uint32_t pageIndex;
+	
+	if (number)
+	{
+		pageIndex = [number unsignedIntValue];
+	}
+	else if (!freeIndexes.empty())
+	{
+		pageIndex = freeIndexes.back();
+		freeIndexes.pop_back();
+		
+		pageKeys[pageIndex] = [pageKey copy];
+		pageIndexes[pageKey] = @(pageIndex);
+	}
+	else
+	{
+		pageIndex = (uint32_t)pageKeys.count;
+		
+		[pageKeys addObject:[pageKey copy]];
+		pageIndexes[pageKey] = @(pageIndex);
+		refCounts.push_back(0);
+	}
+	
+	refCounts[pageIndex]++;
+	return pageIndex;
+}
+
+- (void)releaseIndex:(uint32_t)pageIndex
+{
+	if (--refCounts[pageIndex] > 0) return;
+	
+	[pageIndexes removeObjectForKey:pageKeys[pageIndex]];
+	pageKeys[pageIndex] = [NSNull null];
+	
+	freeIndexes.push_back(pageIndex);
+}
+
+- (void)setPageKey:(NSString *)pageKey forRowid:(int64_t)rowid
+{
+	uint32_t newIndex = [self retainIndexForPageKey:pageKey];
+	
+	bool inserted = false;
+	uint32_t &pageIndex = map.findOrInsert(rowid, &inserted);
+	
+	uint32_t oldIndex = pageIndex;
+	pageIndex = newIndex;
+	
+	if (!inserted) {
+		[self releaseIndex:oldIndex];
+	}
+}
+
+- (void)removeRowid:(int64_t)rowid
+{
+	const uint32_t *pageIndex = map.find(rowid);
+	if (pageIndex == NULL) return;
+	
+	uint32_t oldIndex = *pageIndex;
+	
+	map.erase(rowid);
+	[self releaseIndex:oldIndex];
+}
+
+- (void)removeAllRowids
+{
+	map.clear();
+	
+	[pageKeys removeAllObjects];
+	[pageIndexes removeAllObjects];
+	
+	refCounts.clear();
+	freeIndexes.clear();
+}
+
+- (void)applyDirtyMaps:(YapRowidDirtyDictionary *)dirtyMaps
+{
+	NSNull *nsnull = [NSNull null];
+	
+	[dirtyMaps enumerateRowidsAndObjectsUsingBlock:^(int64_t rowid, id pageKey, BOOL __unused *stop) {
+		
+		if (pageKey == nsnull)
+			[self removeRowid:rowid];
+		else
+			[self setPageKey:(NSString *)pageKey forRowid:rowid];
+	}];
+}
+
+- (uint64_t)estimatedMemoryUsage
+{
+	uint64_t total = (uint64_t)map.capacity() * YapRowidMap<uint32_t>::slotSize();
+	
+	total += (uint64_t)refCounts.capacity() * sizeof(uint32_t);
+	total += (uint64_t)freeIndexes.capacity() * sizeof(uint32_t);
+	
+	// Each pageKey is a UUID string (~64 bytes), referenced from the array & the dictionary (~48 bytes).
+	
+	total += (uint64_t)pageIndexes.count * 112;
+	
+	return total;
+}
+
+@end
@@ -16,6 +16,47 @@
 - (void)enumerateGroupsWithBlock:(void (^)(NSString *group, BOOL *stop))block;
 - (void)enumerateWithBlock:(void (^)(NSString *group, NSArray *pagesMetadataForGroup, BOOL *stop))block;
 
+#pragma mark Index
+
+/**
+ * The state maintains an order-statistic index (a Fenwick tree over the page counts) for each group.
+ * So the following lookups are O(log n) in the number of pages, rather than a walk over the pagesMetadata array.
+ *
+ * The index of a mutable state is built lazily (per group), and is maintained incrementally as counts change.
+ * An immutable copy builds its index upfront, as it may be shared between connections.
+**/
+
+- (NSUInteger)numberOfItemsInGroup:(NSString *)group;
+
+/**
+ * Returns the (non-empty) page that contains the given index within the group,
+ * or nil if the index is beyond the end of the group.
+ *
+ * @param pageOffsetPtr
+ *   Set to the index (within the group) of the first item in the page.
+ *
+ * @param pageIndexPtr
+ *   Set to the index of the page within the pagesMetadata array for the group.
+**/
+- (YapDatabaseViewPageMetadata *)pageMetadataForIndex:(NSUInteger)index
+                                              inGroup:(NSString *)group
+                                           pageOffset:(NSUInteger *)pageOffsetPtr
+                                            pageIndex:(NSUInteger *)pageIndexPtr;
+
+/**
+ * Returns the page with the given pageKey, or nil if the group has no such page.
+ *
+ * @param pageOffsetPtr
+ *   Set to the index (within the group) of the first item in the page.
+ *
+ * @param pageIndexPtr
+ *   Set to the index of the page within the pagesMetadata array for the group.
+**/
+- (YapDatabaseViewPageMetadata *)pageMetadataForPageKey:(NSString *)pageKey
+                                                inGroup:(NSString *)group
+                                             pageOffset:(NSUInteger *)pageOffsetPtr
+                                              pageIndex:(NSUInteger *)pageIndexPtr;
+
 #pragma mark Mutation
 
 - (NSArray *)createGroup:(NSString *)group;
@@ -30,6 +71,12 @@
 
 - (NSArray *)removePageMetadataAtIndex:(NSUInteger)index inGroup:(NSString *)group;
 
+/**
+ * Changes to the count of a page (that's already in the state) must go through this method,
+ * so the index for the group stays in sync.
+**/
+- (void)setCount:(NSUInteger)count forPageMetadata:(YapDatabaseViewPageMetadata *)pageMetadata;
+
 - (void)removeGroup:(NSString *)group;
 - (void)removeAllGroups;
 
@@ -2,13 +2,145 @@
 
 #define AssertIsMutable() NSAssert(!isImmutable, @"Attempting to mutate immutable state")
 
+static inline NSUInteger LowestBit(NSUInteger i)
+{
+	return i & (~i + 1);
+}
+
+/**
+ * A Fenwick tree (binary indexed tree) over the page counts of a single group.
+ *
+ * tree[i] (1-based) holds the sum of the counts of the pages in the range (i - LowestBit(i), i].
+ * So both prefix sums & count updates touch at most log2(pageCount) nodes.
+**/
+@interface YapDatabaseViewPagesIndex : NSObject {
+@public
+	
+	NSUInteger *tree;
+	NSUInteger pageCount;
+	NSUInteger total;
+	
+	NSMutableDictionary<NSString *, NSNumber *> *pageKey_pageIndex_dict;
+}
+
+- (instancetype)initWithPagesMetadata:(NSArray<YapDatabaseViewPageMetadata *> *)pagesMetadata;
+
+@end
+
+@implementation YapDatabaseViewPagesIndex
+
+- (instancetype)initWithPagesMetadata:(NSArray<YapDatabaseViewPageMetadata *> *)pagesMetadata
+{
+	if ((self = [super init]))
+	{
+		pageCount = pagesMetadata.count;
+		tree = calloc(pageCount + 1, sizeof(NSUInteger));
+		
+		pageKey_pageIndex_dict = [[NSMutableDictionary alloc] initWithCapacity:pageCount];
+		
+		// Linear time construction:
+		// By the time we get to node i, all of its children have already been added to it.
+		
+		NSUInteger i = 0;
+		for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadata)
+		{
+			i++;
+			
+			tree[i] += pageMetadata->count;
+			total += pageMetadata->count;
+			
+			NSUInteger parent = i + LowestBit(i);
+			if (parent <= pageCount) {
+				tree[parent] += tree[i];
+			}
+			
+			pageKey_pageIndex_dict[pageMetadata->pageKey] = @(i - 1);
+		}
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	free(tree);
+}
+
+/**
+ * The delta is applied using unsigned (modular) arithmetic, so it may be "negative".
+**/
+- (void)addDelta:(NSUInteger)delta atPageIndex:(NSUInteger)pageIndex
+{
+	for (NSUInteger i = pageIndex + 1; i <= pageCount; i += LowestBit(i))
+	{
+		tree[i] += delta;
+	}
+	
+	total += delta;
+}
+
+/**
+ * Returns the sum of the counts of all the pages before the given pageIndex.
+**/
+- (NSUInteger)offsetOfPageIndex:(NSUInteger)pageIndex
+{
+	NSUInteger offset = 0;
+	
+	for (NSUInteger i = pageIndex; i > 0; i -= LowestBit(i))
+	{
+		offset += tree[i];
+	}
+	
+	return offset;
+}
+
+/**
+ * Returns the index of the first page whose cumulative count exceeds the given index (skipping empty pages),
+ * or NSNotFound if the index is beyond the end of the group.
+**/
+- (NSUInteger)pageIndexForIndex:(NSUInteger)index pageOffset:(NSUInteger *)pageOffsetPtr
+{
+	if (index >= total) return NSNotFound;
+	
+	NSUInteger step = 1;
+	while ((step << 1) <= pageCount) {
+		step <<= 1;
+	}
+	
+	NSUInteger pos = 0;
+	NSUInteger remaining = index;
+	
+	for (; step > 0; step >>= 1)
+	{
+		if (((pos + step) <= pageCount) && (tree[pos + step] <= remaining))
+		{
+			pos += step;
+			remaining -= tree[pos];
+		}
+	}
+	
+	if (pageOffsetPtr) *pageOffsetPtr = index - remaining;
+	return pos;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @implementation YapDatabaseViewState
 {
 	NSMutableDictionary<NSString *, NSMutableArray<YapDatabaseViewPageMetadata *> *> *group_pagesMetadata_dict;
 	NSMutableDictionary<NSString *, NSString *> *pageKey_group_dict;
+	NSMutableDictionary<NSString *, YapDatabaseViewPagesIndex *> *group_index_dict;
 	
 	// - group_pagesMetadata_dict : group -> @[ YapDatabaseViewPageMetadata, ... ]
 	// - pageKey_group_dict       : pageKey -> group
+	// - group_index_dict         : group -> YapDatabaseViewPagesIndex (lazily built, if mutable)
+	//
+	// Group names are interned:
+	// Every pageMetadata (and every entry in pageKey_group_dict) references the key of group_pagesMetadata_dict,
+	// so there's a single string instance per group, no matter how many pages the group has.
 }
 
 @synthesize isImmutable = isImmutable;
@@ -21,6 +153,7 @@
 		
 		group_pagesMetadata_dict = [[NSMutableDictionary alloc] init];
 		pageKey_group_dict = [[NSMutableDictionary alloc] init];
+		group_index_dict = [[NSMutableDictionary alloc] init];
 	}
 	return self;
 }
@@ -53,6 +186,19 @@
 	return deepCopy;
 }
 
+- (NSMutableDictionary *)group_index_dict_build
+{
+	NSMutableDictionary *indexes = [NSMutableDictionary dictionaryWithCapacity:[group_pagesMetadata_dict count]];
+	
+	[group_pagesMetadata_dict enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *group, NSMutableArray *pagesMetadata, BOOL __unused *stop)
+	{
+		indexes[group] = [[YapDatabaseViewPagesIndex alloc] initWithPagesMetadata:pagesMetadata];
+	}];
+	
+	return indexes;
+}
+
 - (id)copyWithZone:(NSZone __unused *)zone
 {
 	if (isImmutable)
@@ -66,6 +212,10 @@
 		copy->group_pagesMetadata_dict = [self group_pagesMetadata_dict_deepCopy];
 		copy->pageKey_group_dict = [pageKey_group_dict mutableCopy];
 		
+		// The immutable copy may be shared between connections (on different threads).
+		// So it can't build its index lazily.
+		copy->group_index_dict = [copy group_index_dict_build];
+		
 		return copy;
 	}
 }
@@ -76,6 +226,7 @@
 	copy->isImmutable = NO;
 	copy->group_pagesMetadata_dict = [self group_pagesMetadata_dict_deepCopy];
 	copy->pageKey_group_dict = [pageKey_group_dict mutableCopy];
+	copy->group_index_dict = [[NSMutableDictionary alloc] init];
 	
 	return copy;
 }
@@ -115,10 +266,96 @@
 	[group_pagesMetadata_dict enumerateKeysAndObjectsUsingBlock:block];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Index
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (YapDatabaseViewPagesIndex *)indexForGroup:(NSString *)group
+{
+	YapDatabaseViewPagesIndex *index = [group_index_dict objectForKey:group];
+	if (index == nil && !isImmutable)
+	{
+		NSArray *pagesMetadataForGroup = [group_pagesMetadata_dict objectForKey:group];
+		if (pagesMetadataForGroup)
+		{
+			index = [[YapDatabaseViewPagesIndex alloc] initWithPagesMetadata:pagesMetadataForGroup];
+			[group_index_dict setObject:index forKey:group];
+		}
+	}
+	
+	return index;
+}
+
+- (NSUInteger)numberOfItemsInGroup:(NSString *)group
+{
+	YapDatabaseViewPagesIndex *index = [self indexForGroup:group];
+	
+	return index ? index->total : 0;
+}
+
+- (YapDatabaseViewPageMetadata *)pageMetadataForIndex:(NSUInteger)index
+                                              inGroup:(NSString *)group
+                                           pageOffset:(NSUInteger *)pageOffsetPtr
+                                            pageIndex:(NSUInteger *)pageIndexPtr
+{
+	YapDatabaseViewPagesIndex *groupIndex = [self indexForGroup:group];
+	
+	NSUInteger pageOffset = 0;
+	NSUInteger pageIndex = groupIndex ? [groupIndex pageIndexForIndex:index pageOffset:&pageOffset] : NSNotFound;
+	
+	if (pageIndex == NSNotFound)
+	{
+		if (pageOffsetPtr) *pageOffsetPtr = 0;
+		if (pageIndexPtr) *pageIndexPtr = NSNotFound;
+		return nil;
+	}
+	
+	if (pageOffsetPtr) *pageOffsetPtr = pageOffset;
+	if (pageIndexPtr) *pageIndexPtr = pageIndex;
+	return [[group_pagesMetadata_dict objectForKey:group] objectAtIndex:pageIndex];
+}
+
+- (YapDatabaseViewPageMetadata *)pageMetadataForPageKey:(NSString *)pageKey
+                                                inGroup:(NSString *)group
+                                             pageOffset:(NSUInteger *)pageOffsetPtr
+                                              pageIndex:(NSUInteger *)pageIndexPtr
+{
+	YapDatabaseViewPagesIndex *groupIndex = [self indexForGroup:group];
+	NSNumber *pageIndexNumber = groupIndex ? [groupIndex->pageKey_pageIndex_dict objectForKey:pageKey] : nil;
+	
+	if (pageIndexNumber == nil)
+	{
+		if (pageOffsetPtr) *pageOffsetPtr = 0;
+		if (pageIndexPtr) *pageIndexPtr = NSNotFound;
+		return nil;
+	}
+	
+	NSUInteger pageIndex = [pageIndexNumber unsignedIntegerValue];
+	
+	if (pageOffsetPtr) *pageOffsetPtr = [groupIndex offsetOfPageIndex:pageIndex];
+	if (pageIndexPtr) *pageIndexPtr = pageIndex;
+	return [[group_pagesMetadata_dict objectForKey:group] objectAtIndex:pageIndex];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Mutation
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Returns the string instance used as the key for the group (or the given group, if it doesn't exist).
+**/
+- (NSString *)internedGroup:(NSString *)group
+{
+	const void *key = NULL;
+	if (CFDictionaryGetKeyIfPresent((__bridge CFDictionaryRef)group_pagesMetadata_dict,
+	                                (__bridge const void *)group, &key))
+	{
+		return (__bridge NSString *)key;
+	}
+	
+	return group;
+}
+
 - (NSArray *)createGroup:(NSString *)group
 {
 	return [self createGroup:group withCapacity:0];
@@ -148,11 +385,16 @@
 	AssertIsMutable();
 	NSParameterAssert(pageMetadata != nil);
 	
+	group = [self internedGroup:group];
+	pageMetadata->group = group;
+	
 	[pageKey_group_dict setObject:group forKey:pageMetadata->pageKey];
 	
 	NSMutableArray *pagesMetadataForGroup = [group_pagesMetadata_dict objectForKey:group];
 	[pagesMetadataForGroup addObject:pageMetadata];
 	
+	[group_index_dict removeObjectForKey:group];
+	
 	return pagesMetadataForGroup;
 }
 
@@ -163,11 +405,16 @@
 	AssertIsMutable();
 	NSParameterAssert(pageMetadata != nil);
 	
+	group = [self internedGroup:group];
+	pageMetadata->group = group;
+	
 	[pageKey_group_dict setObject:group forKey:pageMetadata->pageKey];
 	
 	NSMutableArray *pagesMetadataForGroup = [group_pagesMetadata_dict objectForKey:group];
 	[pagesMetadataForGroup insertObject:pageMetadata atIndex:index];
 	
+	[group_index_dict removeObjectForKey:group]; // page indexes have shifted (rebuilt on demand)
+	
 	return pagesMetadataForGroup;
 }
 
@@ -181,9 +428,30 @@
 	[pageKey_group_dict removeObjectForKey:pageMetadata->pageKey];
 	[pagesMetadataForGroup removeObjectAtIndex:index];
 	
+	[group_index_dict removeObjectForKey:group]; // page indexes have shifted (rebuilt on demand)
+	
 	return pagesMetadataForGroup;
 }
 
+- (void)setCount:(NSUInteger)count forPageMetadata:(YapDatabaseViewPageMetadata *)pageMetadata
+{
+	AssertIsMutable();
+	
+	if (pageMetadata->count == count) return;
+	
+	YapDatabaseViewPagesIndex *index = [group_index_dict objectForKey:pageMetadata->group];
+	if (index)
+	{
+		NSNumber *pageIndex = [index->pageKey_pageIndex_dict objectForKey:pageMetadata->pageKey];
+		if (pageIndex)
+		{
+			[index addDelta:(count - pageMetadata->count) atPageIndex:[pageIndex unsignedIntegerValue]];
+		}
+	}
+	
+	pageMetadata->count = count;
+}
+
 - (void)removeGroup:(NSString *)group
 {
 	AssertIsMutable();
@@ -194,6 +462,7 @@
 	if (count == 0)
 	{
 		[group_pagesMetadata_dict removeObjectForKey:group];
+		[group_index_dict removeObjectForKey:group];
 	}
 }
 
@@ -203,6 +472,7 @@
 	
 	[group_pagesMetadata_dict removeAllObjects];
 	[pageKey_group_dict removeAllObjects];
+	[group_index_dict removeAllObjects];
 }
 
 @end
@@ -319,4 +319,54 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseViewChangesBitMask) {
 
 @end
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A compact representation of row changes, which coalesces contiguous rows into ranges.
+ *
+ * When a transaction inserts or deletes a large batch of rows,
+ * creating (and animating) one index path per row can be expensive.
+ * But rows inserted (or deleted) in bulk are often adjacent,
+ * and can be handed to a tableView / collectionView as a handful of ranges instead.
+ *
+ * NSArray *rangeChanges = [YapDatabaseViewRangeChange rangeChangesForRowChanges:rowChanges];
+ *
+ * The range changes follow the rules of a batch update (beginUpdates / performBatchUpdates):
+ * - Delete ranges are expressed using the ORIGINAL indexes (as they existed before the changes).
+ * - Insert ranges are expressed using the FINAL indexes (as they exist after the changes).
+ * - Update ranges are expressed using the ORIGINAL indexes (the same as rowChange.indexPath).
+ * - A move is represented as a delete (of its original index) and an insert (of its final index).
+ *
+ * The range changes are ordered: deletes, then inserts, then updates.
+ * Within each type, they're ordered by section, and then by range.
+ *
+ * If you need per-row changes, the indexPaths property expands any range back into individual rows.
+**/
+@interface YapDatabaseViewRangeChange : NSObject
+
+/**
+ * Coalesces the given row changes, as returned from getSectionChanges:rowChanges:forNotifications:withMappings:.
+**/
++ (NSArray<YapDatabaseViewRangeChange *> *)rangeChangesForRowChanges:(NSArray<YapDatabaseViewRowChange *> *)rowChanges;
+
+/**
+ * The type will be one of:
+ * - YapDatabaseViewChangeInsert
+ * - YapDatabaseViewChangeDelete
+ * - YapDatabaseViewChangeUpdate
+**/
+@property (nonatomic, readonly) YapDatabaseViewChangeType type;
+
+@property (nonatomic, readonly) NSUInteger section;
+@property (nonatomic, readonly) NSRange range;
+
+/**
+ * One indexPath per row in the range.
+**/
+@property (nonatomic, readonly) NSArray<NSIndexPath *> *indexPaths;
+
+@end
+
 NS_ASSUME_NONNULL_END
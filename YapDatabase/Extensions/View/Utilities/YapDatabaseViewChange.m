@@ -369,6 +369,125 @@
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+@implementation YapDatabaseViewRangeChange
+
+@synthesize type = type;
+@synthesize section = section;
+@synthesize range = range;
+
++ (NSArray<YapDatabaseViewRangeChange *> *)rangeChangesForRowChanges:(NSArray<YapDatabaseViewRowChange *> *)rowChanges
+{
+	// section (NSNumber) -> rows (NSMutableIndexSet)
+	NSMutableDictionary *deletes = [NSMutableDictionary dictionary];
+	NSMutableDictionary *inserts = [NSMutableDictionary dictionary];
+	NSMutableDictionary *updates = [NSMutableDictionary dictionary];
+	
+	void (^AddRow)(NSMutableDictionary*, NSUInteger, NSUInteger) =
+	^(NSMutableDictionary *dict, NSUInteger rowSection, NSUInteger row){
+		
+		NSMutableIndexSet *rows = dict[@(rowSection)];
+		if (rows == nil)
+		{
+			rows = [NSMutableIndexSet indexSet];
+			dict[@(rowSection)] = rows;
+		}
+		
+		[rows addIndex:row];
+	};
+	
+	for (YapDatabaseViewRowChange *rowChange in rowChanges)
+	{
+		switch (rowChange->type)
+		{
+			case YapDatabaseViewChangeDelete :
+			{
+				AddRow(deletes, rowChange->originalSection, rowChange->originalIndex);
+				break;
+			}
+			case YapDatabaseViewChangeInsert :
+			{
+				AddRow(inserts, rowChange->finalSection, rowChange->finalIndex);
+				break;
+			}
+			case YapDatabaseViewChangeMove :
+			{
+				AddRow(deletes, rowChange->originalSection, rowChange->originalIndex);
+				AddRow(inserts, rowChange->finalSection, rowChange->finalIndex);
+				break;
+			}
+			case YapDatabaseViewChangeUpdate :
+			{
+				AddRow(updates, rowChange->originalSection, rowChange->originalIndex);
+				break;
+			}
+		}
+	}
+	
+	NSMutableArray *rangeChanges = [NSMutableArray array];
+	
+	void (^AddRanges)(NSDictionary*, YapDatabaseViewChangeType) =
+	^(NSDictionary *dict, YapDatabaseViewChangeType rangeType){
+		
+		NSArray *sections = [[dict allKeys] sortedArrayUsingSelector:@selector(compare:)];
+		for (NSNumber *sectionNumber in sections)
+		{
+			NSIndexSet *rows = dict[sectionNumber];
+			[rows enumerateRangesUsingBlock:^(NSRange rowRange, BOOL __unused *stop) {
+				
+				YapDatabaseViewRangeChange *rangeChange = [[YapDatabaseViewRangeChange alloc] init];
+				rangeChange->type = rangeType;
+				rangeChange->section = [sectionNumber unsignedIntegerValue];
+				rangeChange->range = rowRange;
+				
+				[rangeChanges addObject:rangeChange];
+			}];
+		}
+	};
+	
+	AddRanges(deletes, YapDatabaseViewChangeDelete);
+	AddRanges(inserts, YapDatabaseViewChangeInsert);
+	AddRanges(updates, YapDatabaseViewChangeUpdate);
+	
+	return rangeChanges;
+}
+
+- (NSArray<NSIndexPath *> *)indexPaths
+{
+	NSMutableArray *indexPaths = [NSMutableArray arrayWithCapacity:range.length];
+	
+	for (NSUInteger row = range.location; row < NSMaxRange(range); row++)
+	{
+	#if TARGET_OS_IOS
+		[indexPaths addObject:[NSIndexPath indexPathForRow:row inSection:section]];
+	#else
+		NSUInteger indexes[] = {section, row};
+		[indexPaths addObject:[NSIndexPath indexPathWithIndexes:indexes length:2]];
+	#endif
+	}
+	
+	return indexPaths;
+}
+
+- (NSString *)description
+{
+	NSString *typeStr;
+	switch (type)
+	{
+		case YapDatabaseViewChangeInsert : typeStr = @"Insert"; break;
+		case YapDatabaseViewChangeDelete : typeStr = @"Delete"; break;
+		default                          : typeStr = @"Update"; break;
+	}
+	
+	return [NSString stringWithFormat:@"<YapDatabaseViewRangeChange: %@ section(%lu) range(%lu, %lu)>",
+	    typeStr, (unsigned long)section, (unsigned long)range.location, (unsigned long)range.length];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @implementation YapDatabaseViewChange
 
 /**
@@ -578,6 +697,177 @@
 }
 
 
+/**
+ * A node in the model of a group, used by processRowChanges.
+ *
+ * The model is an implicit treap: a randomized balanced binary tree, ordered by position within the group.
+ * Each node represents one of:
+ * - a run of rows that were in the group at the start of the transaction (and haven't been touched)
+ * - a single row that was inserted, or that was in the group at the start of the transaction
+ * - a single row that was deleted (a tombstone)
+**/
+typedef struct YapDatabaseViewRowNode YapDatabaseViewRowNode;
+struct YapDatabaseViewRowNode {
+	
+	NSUInteger live;     // number of rows currently in the group
+	NSUInteger original; // number of rows that were in the group at the start of the transaction
+	
+	NSUInteger liveSum;     // sum of live within the subtree
+	NSUInteger originalSum; // sum of original within the subtree
+	
+	uint32_t priority;
+	
+	YapDatabaseViewRowNode *left;
+	YapDatabaseViewRowNode *right;
+	
+	NSUInteger finalIndex; // set once every change has been applied
+};
+
+/**
+ * The size of a group isn't known during processing.
+ * So every group starts out as a single run of (effectively) unlimited rows.
+**/
+static NSUInteger const YapDatabaseViewRowNodeUnlimited = NSUIntegerMax / 4;
+
+/**
+ * The nodes are allocated up front, from a single buffer.
+ * Every change allocates at most 2 nodes, and every group allocates its initial node.
+**/
+typedef struct {
+	YapDatabaseViewRowNode *nodes;
+	NSUInteger count;
+	uint32_t seed;
+} YapDatabaseViewRowNodePool;
+
+static YapDatabaseViewRowNode* YapDatabaseViewRowNodeCreate(YapDatabaseViewRowNodePool *pool,
+                                                            NSUInteger live, NSUInteger original)
+{
+	// xorshift32
+	pool->seed ^= pool->seed << 13;
+	pool->seed ^= pool->seed >> 17;
+	pool->seed ^= pool->seed << 5;
+	
+	YapDatabaseViewRowNode *node = &pool->nodes[pool->count++];
+	node->live = node->liveSum = live;
+	node->original = node->originalSum = original;
+	node->priority = pool->seed;
+	node->left = node->right = NULL;
+	node->finalIndex = 0;
+	
+	return node;
+}
+
+static inline NSUInteger YapDatabaseViewRowNodeLiveSum(YapDatabaseViewRowNode *node)
+{
+	return node ? node->liveSum : 0;
+}
+
+static inline NSUInteger YapDatabaseViewRowNodeOriginalSum(YapDatabaseViewRowNode *node)
+{
+	return node ? node->originalSum : 0;
+}
+
+static inline void YapDatabaseViewRowNodeUpdate(YapDatabaseViewRowNode *node)
+{
+	node->liveSum = node->live
+	              + YapDatabaseViewRowNodeLiveSum(node->left)
+	              + YapDatabaseViewRowNodeLiveSum(node->right);
+	
+	node->originalSum = node->original
+	                  + YapDatabaseViewRowNodeOriginalSum(node->left)
+	                  + YapDatabaseViewRowNodeOriginalSum(node->right);
+}
+
+static YapDatabaseViewRowNode* YapDatabaseViewRowNodeMerge(YapDatabaseViewRowNode *a, YapDatabaseViewRowNode *b)
+{
+	if (a == NULL) return b;
+	if (b == NULL) return a;
+	
+	if (a->priority > b->priority)
+	{
+		a->right = YapDatabaseViewRowNodeMerge(a->right, b);
+		YapDatabaseViewRowNodeUpdate(a);
+		return a;
+	}
+	else
+	{
+		b->left = YapDatabaseViewRowNodeMerge(a, b->left);
+		YapDatabaseViewRowNodeUpdate(b);
+		return b;
+	}
+}
+
+/**
+ * Splits the tree such that the first 'count' (live) rows end up in the left tree, and the remainder in the right.
+ * A run of original rows that straddles the split is split into 2 nodes.
+ *
+ * Tombstones located exactly at the split go to the left tree if tombstonesGoLeft, and to the right tree otherwise.
+**/
+static void YapDatabaseViewRowNodeSplit(YapDatabaseViewRowNodePool *pool, YapDatabaseViewRowNode *node,
+                                        NSUInteger count, BOOL tombstonesGoLeft,
+                                        YapDatabaseViewRowNode **leftPtr, YapDatabaseViewRowNode **rightPtr)
+{
+	if (node == NULL)
+	{
+		*leftPtr = NULL;
+		*rightPtr = NULL;
+		return;
+	}
+	
+	NSUInteger leftCount = YapDatabaseViewRowNodeLiveSum(node->left);
+	
+	if (count < leftCount || (count == leftCount && (node->live > 0 || !tombstonesGoLeft)))
+	{
+		// The node goes to the right tree
+		
+		YapDatabaseViewRowNodeSplit(pool, node->left, count, tombstonesGoLeft, leftPtr, &node->left);
+		YapDatabaseViewRowNodeUpdate(node);
+		*rightPtr = node;
+	}
+	else if ((count - leftCount) >= node->live)
+	{
+		// The node goes to the left tree
+		
+		NSUInteger remaining = count - leftCount - node->live;
+		
+		YapDatabaseViewRowNodeSplit(pool, node->right, remaining, tombstonesGoLeft, &node->right, rightPtr);
+		YapDatabaseViewRowNodeUpdate(node);
+		*leftPtr = node;
+	}
+	else
+	{
+		// The split occurs within a run of original rows
+		
+		NSUInteger headCount = count - leftCount;
+		NSUInteger tailCount = node->live - headCount;
+		
+		YapDatabaseViewRowNode *tail = YapDatabaseViewRowNodeCreate(pool, tailCount, tailCount);
+		YapDatabaseViewRowNode *right = node->right;
+		
+		node->live = node->original = headCount;
+		node->right = NULL;
+		YapDatabaseViewRowNodeUpdate(node);
+		
+		*leftPtr = node;
+		*rightPtr = YapDatabaseViewRowNodeMerge(tail, right);
+	}
+}
+
+/**
+ * Sets the finalIndex of every node in the tree, and returns the number of (live) rows in the tree.
+**/
+static NSUInteger YapDatabaseViewRowNodeSetFinalIndexes(YapDatabaseViewRowNode *node, NSUInteger offset)
+{
+	if (node == NULL) return offset;
+	
+	offset = YapDatabaseViewRowNodeSetFinalIndexes(node->left, offset);
+	
+	node->finalIndex = offset;
+	offset += node->live;
+	
+	return YapDatabaseViewRowNodeSetFinalIndexes(node->right, offset);
+}
+
 /**
  * During a read-write transaction, every modification to the view results in one or more
  * YapDatabaseViewSectionChange or YapDatabaseViewRowChange objects being appended to an internal array.
@@ -627,115 +917,122 @@
 	// TestViewChangeLogic.m
 	
 	__block NSUInteger i;
-	__block NSUInteger j;
 	
-	// STEP 1
+	// STEP 1 & 2
 	//
-	// First we enumerate the items BACKWARDS,
-	// and update the ORIGINAL index values.
+	// Conceptually, each operation adjusts the ORIGINAL index value of operations that occurred AFTER it,
+	// and the FINAL index value of operations that occurred BEFORE it:
+	//
+	// - A DELETE operation affects the ORIGINAL index value of later operations,
+	//   IF the later operation occurs at a greater or equal index value.  ( +1 )
+	// - An INSERT operation affects the ORIGINAL index value of later operations,
+	//   IF the later operation occurs at a greater (but not equal) index value.  ( -1 )
+	// - A DELETE operation affects the FINAL index value of earlier operations,
+	//   IF the earlier operation occurs at a greater (but not equal) index value. ( -1 )
+	// - An INSERT operation affects the FINAL index value of earlier operations,
+	//   IF the earlier operation occurs at a greater or equal index value ( +1 )
+	//
+	// Rather than adjusting every operation by every other operation (which is quadratic),
+	// we replay the operations against a model of each group (see YapDatabaseViewRowNode).
+	//
+	// - The ORIGINAL index of a row is the number of original rows (including deleted ones) that precede it,
+	//   at the moment the operation took place.
+	// - The FINAL index of a row is the number of rows that precede it, once every operation has been replayed.
+	//
+	// Each operation is O(log n) in the number of operations.
 	
 	NSUInteger rowChangesCount = [rowChanges count];
 	
 	__unsafe_unretained id *_rowChanges = (__unsafe_unretained id *)malloc(sizeof(id) * rowChangesCount);
 	[rowChanges getObjects:_rowChanges range:NSMakeRange(0, rowChangesCount)];
 	
-	for (i = rowChangesCount; i > 0; i--)
+	YapDatabaseViewRowNodePool pool;
+	pool.nodes = malloc(sizeof(YapDatabaseViewRowNode) * ((rowChangesCount * 3) + 1));
+	pool.count = 0;
+	pool.seed = 2463534242;
+	
+	YapDatabaseViewRowNode **roots = malloc(sizeof(YapDatabaseViewRowNode *) * (rowChangesCount + 1));
+	YapDatabaseViewRowNode **rowNodes = calloc(rowChangesCount + 1, sizeof(YapDatabaseViewRowNode *));
+	
+	NSMutableDictionary *rootIndexes = [NSMutableDictionary dictionary]; // group -> index in roots
+	NSUInteger rootsCount = 0;
+	
+	for (i = 0; i < rowChangesCount; i++)
 	{
-		__unsafe_unretained YapDatabaseViewRowChange *rowChange = _rowChanges[i-1];
+		__unsafe_unretained YapDatabaseViewRowChange *rowChange = _rowChanges[i];
 		
-		if (rowChange->type == YapDatabaseViewChangeDelete)
+		BOOL isInsert = (rowChange->type == YapDatabaseViewChangeInsert);
+		
+		__unsafe_unretained NSString *group = isInsert ? rowChange->finalGroup : rowChange->originalGroup;
+		if (group == nil) continue;
+		
+		NSNumber *rootIndex = rootIndexes[group];
+		if (rootIndex == nil)
 		{
-			// A DELETE operation may affect the ORIGINAL index value of operations that occurred AFTER it,
-			//  IF the later operation occurs at a greater or equal index value.  ( +1 )
+			rootIndex = @(rootsCount);
+			rootIndexes[group] = rootIndex;
 			
-			for (j = i; j < rowChangesCount; j++)
-			{
-				__unsafe_unretained YapDatabaseViewRowChange *laterRowChange = _rowChanges[j];
-				
-				if (laterRowChange->type == YapDatabaseViewChangeDelete ||
-					laterRowChange->type == YapDatabaseViewChangeUpdate)
-				{
-					if (laterRowChange->originalIndex >= rowChange->opOriginalIndex &&
-					   [laterRowChange->originalGroup isEqualToString:rowChange->originalGroup])
-					{
-						laterRowChange->originalIndex += 1;
-					}
-				}
-			}
+			roots[rootsCount++] = YapDatabaseViewRowNodeCreate(&pool, YapDatabaseViewRowNodeUnlimited,
+			                                                            YapDatabaseViewRowNodeUnlimited);
 		}
-		else if (rowChange->type == YapDatabaseViewChangeInsert)
+		
+		YapDatabaseViewRowNode **root = &roots[[rootIndex unsignedIntegerValue]];
+		
+		YapDatabaseViewRowNode *before = NULL;
+		YapDatabaseViewRowNode *after = NULL;
+		
+		if (isInsert)
+		{
+			YapDatabaseViewRowNodeSplit(&pool, *root, rowChange->opFinalIndex, YES, &before, &after);
+			
+			YapDatabaseViewRowNode *row = YapDatabaseViewRowNodeCreate(&pool, 1, 0);
+			rowNodes[i] = row;
+			
+			*root = YapDatabaseViewRowNodeMerge(YapDatabaseViewRowNodeMerge(before, row), after);
+		}
+		else
 		{
-			// An INSERT operation may affect the ORIGINAL index value of operations that occurred AFTER it,
-			//   IF the later operation occurs at a greater (but not equal) index value.  ( -1 )
+			// Isolate the row at the index
+			
+			YapDatabaseViewRowNode *row = NULL;
+			
+			YapDatabaseViewRowNodeSplit(&pool, *root, rowChange->opOriginalIndex, YES, &before, &after);
+			YapDatabaseViewRowNodeSplit(&pool, after, 1, NO, &row, &after);
 			
-			for (j = i; j < rowChangesCount; j++)
+			rowChange->originalIndex = YapDatabaseViewRowNodeOriginalSum(before);
+			
+			if (rowChange->type == YapDatabaseViewChangeDelete)
 			{
-				__unsafe_unretained YapDatabaseViewRowChange *laterRowChange = _rowChanges[j];
-				
-				if (laterRowChange->type == YapDatabaseViewChangeDelete ||
-				    laterRowChange->type == YapDatabaseViewChangeUpdate)
-				{
-					if (laterRowChange->originalIndex > rowChange->opFinalIndex &&
-					   [laterRowChange->originalGroup isEqualToString:rowChange->finalGroup])
-					{
-						laterRowChange->originalIndex -= 1;
-					}
-				}
+				row->live = 0;
+				YapDatabaseViewRowNodeUpdate(row);
 			}
+			else
+			{
+				rowNodes[i] = row;
+			}
+			
+			*root = YapDatabaseViewRowNodeMerge(YapDatabaseViewRowNodeMerge(before, row), after);
 		}
 	}
 	
-	// STEP 2
-	//
-	// Next we enumerate the items FORWARDS,
-	// and update the FINAL index values.
+	for (i = 0; i < rootsCount; i++)
+	{
+		YapDatabaseViewRowNodeSetFinalIndexes(roots[i], 0);
+	}
 	
-	for (i = 1; i < rowChangesCount; i++)
+	for (i = 0; i < rowChangesCount; i++)
 	{
-		__unsafe_unretained YapDatabaseViewRowChange *rowChange = _rowChanges[i];
-		
-		if (rowChange->type == YapDatabaseViewChangeDelete)
-		{
-			// A DELETE operation may affect the FINAL index value of operations that occurred BEFORE it,
-			//  IF the earlier operation occurs at a greater (but not equal) index value. ( -1 )
-			
-			for (j = i; j > 0; j--)
-			{
-				__unsafe_unretained YapDatabaseViewRowChange *earlierRowChange = _rowChanges[j-1];
-				
-				if (earlierRowChange->type == YapDatabaseViewChangeInsert ||
-				    earlierRowChange->type == YapDatabaseViewChangeUpdate  )
-				{
-					if (earlierRowChange->finalIndex > rowChange->opOriginalIndex &&
-					   [earlierRowChange->finalGroup isEqualToString:rowChange->originalGroup])
-					{
-						earlierRowChange->finalIndex -= 1;
-					}
-				}
-			}
-		}
-		else if (rowChange->type == YapDatabaseViewChangeInsert)
+		if (rowNodes[i])
 		{
-			// An INSERT operation may affect the FINAL index value of operations that occurred BEFORE it,
-			//   IF the earlier operation occurs at a greater or equal index value ( +1 )
-			
-			for (j = i; j > 0; j--)
-			{
-				__unsafe_unretained YapDatabaseViewRowChange *earlierRowChange = _rowChanges[j-1];
-				
-				if (earlierRowChange->type == YapDatabaseViewChangeInsert ||
-				    earlierRowChange->type == YapDatabaseViewChangeUpdate)
-				{
-					if (earlierRowChange->finalIndex >= rowChange->opFinalIndex &&
-					   [earlierRowChange->finalGroup isEqualToString:rowChange->finalGroup])
-					{
-						earlierRowChange->finalIndex += 1;
-					}
-				}
-			}
+			__unsafe_unretained YapDatabaseViewRowChange *rowChange = _rowChanges[i];
+			rowChange->finalIndex = rowNodes[i]->finalIndex;
 		}
 	}
 	
+	free(pool.nodes);
+	free(roots);
+	free(rowNodes);
+	
 	// STEP 3
 	//
 	// The user may have various range options set for each group.
@@ -1019,11 +1316,30 @@
 	__unsafe_unretained id *_changes = (__unsafe_unretained id *)malloc(sizeof(id) * changesCount);
 	[changes getObjects:_changes range:NSMakeRange(0, changesCount)];
 	
+	// Most of the time, the vast majority of rows are only changed once.
+	// So if every change has a key, we count the changes per key,
+	// and only search for later changes if the key has any.
+	
+	NSCountedSet *keyCounts = [[NSCountedSet alloc] initWithCapacity:changesCount];
+	for (i = 0; i < changesCount; i++)
+	{
+		__unsafe_unretained YapDatabaseViewRowChange *change = _changes[i];
+		if (change->collectionKey == nil)
+		{
+			keyCounts = nil;
+			break;
+		}
+		
+		[keyCounts addObject:change->collectionKey];
+	}
+	
 	for (i = 0; i < changesCount; i++)
 	{
 		if ([indexesToRemove containsIndex:i]) continue;
 		
 		__unsafe_unretained YapDatabaseViewRowChange *firstChangeForKey = _changes[i];
+		
+		if (keyCounts && [keyCounts countForObject:firstChangeForKey->collectionKey] < 2) continue;
 		__unsafe_unretained YapDatabaseViewRowChange *mostRecentChangeForKey = firstChangeForKey;
 		
 		NSUInteger mostRecentChangeForKey_OpIndex = 0;
@@ -496,6 +496,24 @@ typedef NSComparisonResult (^YapDatabaseViewMappingGroupSort)(NSString *group1,
 - (NSUInteger)autoConsolidateGroupsThreshold;
 - (NSString *)consolidatedGroupName;
 
+/**
+ * When using initWithGroupFilterBlock:sortBlock:view:, the filterBlock & sortBlock are run over every group
+ * in the view each time the mappings are updated. With thousands of groups, this can get expensive.
+ *
+ * If the result of your filterBlock & sortBlock for a group only changes when the group itself changes
+ * (e.g. they only depend on the group name, or on the items within the group),
+ * then you can enable this option.
+ *
+ * When enabled, and the mappings are updated via getSectionChanges:rowChanges:forNotifications:withMappings:,
+ * the blocks are only run for the groups that were changed (by the given notifications).
+ * Every other group keeps its current filter result & position.
+ *
+ * The updateWithTransaction: method always runs the blocks over every group.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL onlyFilterAndSortChangedGroups;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Initialization & Updates
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
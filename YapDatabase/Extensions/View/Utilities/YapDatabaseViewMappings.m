@@ -30,6 +30,7 @@
 	NSString *registeredViewName;
     
     NSArray *allGroups;
+	NSSet *allGroupsSet;
     
     BOOL viewGroupsAreDynamic;
     YapDatabaseViewMappingGroupFilter groupFilterBlock;
@@ -37,6 +38,7 @@
     
 	// Mappings and cached counts
 	NSMutableArray *visibleGroups;
+	NSDictionary *visibleGroupSections; // visible group -> section
 	NSMutableDictionary *counts;
 	BOOL isUsingConsolidatedGroup;
 	BOOL autoConsolidationDisabled;
@@ -48,6 +50,7 @@
 	NSMutableDictionary *dependencies;
 	NSUInteger autoConsolidateGroupsThreshold;
 	NSString *consolidatedGroupName;
+	BOOL onlyFilterAndSortChangedGroups;
 	
 	// Snapshot (used for error detection)
 	uint64_t snapshotOfLastUpdate;
@@ -57,6 +60,7 @@
 @synthesize view = registeredViewName;
 
 @synthesize snapshotOfLastUpdate = snapshotOfLastUpdate;
+@synthesize onlyFilterAndSortChangedGroups = onlyFilterAndSortChangedGroups;
 
 + (instancetype)mappingsWithGroups:(NSArray *)inGroups view:(NSString *)inRegisteredViewName
 {
@@ -69,6 +73,7 @@
 	if ((self = [super init]))
 	{
         allGroups = [[NSArray alloc] initWithArray:inGroups copyItems:YES];
+		allGroupsSet = [[NSSet alloc] initWithArray:allGroups];
 		NSUInteger allGroupsCount = [allGroups count];
         viewGroupsAreDynamic = NO;
 		
@@ -118,6 +123,7 @@
 {
 	YapDatabaseViewMappings *copy = [[YapDatabaseViewMappings alloc] init];
 	copy->allGroups = allGroups;
+	copy->allGroupsSet = allGroupsSet;
 	copy->registeredViewName = registeredViewName;
     
     copy->viewGroupsAreDynamic = viewGroupsAreDynamic;
@@ -125,6 +131,7 @@
     copy->groupSortBlock = groupSortBlock;
 	
 	copy->visibleGroups = [visibleGroups mutableCopy];
+	copy->visibleGroupSections = visibleGroupSections;
 	copy->counts = [counts mutableCopy];
 	copy->isUsingConsolidatedGroup = isUsingConsolidatedGroup;
 	copy->autoConsolidationDisabled = autoConsolidationDisabled;
@@ -135,6 +142,7 @@
 	copy->dependencies = [dependencies mutableCopy];
 	copy->autoConsolidateGroupsThreshold = autoConsolidateGroupsThreshold;
 	copy->consolidatedGroupName = consolidatedGroupName;
+	copy->onlyFilterAndSortChangedGroups = onlyFilterAndSortChangedGroups;
 	
 	copy->snapshotOfLastUpdate = snapshotOfLastUpdate;
 	
@@ -150,7 +158,7 @@
 	if (viewGroupsAreDynamic)
 		return YES; // group list changes dynamically, so any group name could be valid
 	else
-		return [allGroups containsObject:group];
+		return [allGroupsSet containsObject:group];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -342,6 +350,13 @@
 
 - (void)updateWithTransaction:(YapDatabaseReadTransaction *)transaction
       forceUpdateRangeOptions:(BOOL)forceUpdateRangeOptions
+{
+	[self updateWithTransaction:transaction forceUpdateRangeOptions:forceUpdateRangeOptions changedGroups:nil];
+}
+
+- (void)updateWithTransaction:(YapDatabaseReadTransaction *)transaction
+      forceUpdateRangeOptions:(BOOL)forceUpdateRangeOptions
+                changedGroups:(NSSet *)changedGroups
 {
 	if (![transaction->connection isInLongLivedReadTransaction])
 	{
@@ -384,22 +399,64 @@
 	}
 	
 	YapDatabaseViewTransaction *viewTransaction = [transaction ext:registeredViewName];
+	
+	BOOL firstUpdate = (snapshotOfLastUpdate == UINT64_MAX);
+	
+	// The changedGroups (if given) are the groups touched by the changesets since the last update.
+	// The counts of every other group are unchanged, so there's no need to fetch them again.
+	
+	BOOL isIncremental = (changedGroups != nil) && !firstUpdate;
+	
 	if (viewGroupsAreDynamic)
 	{
-		NSArray *newGroups = [self filterAndSortGroups:[viewTransaction allGroups] withTransaction:transaction];
+		NSArray *newGroups;
+		if (isIncremental && onlyFilterAndSortChangedGroups)
+			newGroups = [self filterAndSortChangedGroups:changedGroups withTransaction:transaction];
+		else
+			newGroups = [self filterAndSortGroups:[viewTransaction allGroups] withTransaction:transaction];
+		
 		if ([self shouldUpdateAllGroupsWithNewGroups:newGroups]) {
 			[self updateMappingsWithNewGroups:newGroups];
 		}
 	}
-    
-	for (NSString *group in allGroups)
+	
+	if (isIncremental)
 	{
-		NSUInteger count = [viewTransaction numberOfItemsInGroup:group];
+		for (NSString *group in changedGroups)
+		{
+			if ([allGroupsSet containsObject:group])
+			{
+				NSUInteger count = [viewTransaction numberOfItemsInGroup:group];
+				
+				[counts setObject:@(count) forKey:group];
+			}
+		}
 		
-		[counts setObject:@(count) forKey:group];
+		if ([counts count] < [allGroupsSet count])
+		{
+			// Groups that just passed the groupFilterBlock (without being changed)
+			
+			for (NSString *group in allGroups)
+			{
+				if ([counts objectForKey:group] == nil)
+				{
+					NSUInteger count = [viewTransaction numberOfItemsInGroup:group];
+					
+					[counts setObject:@(count) forKey:group];
+				}
+			}
+		}
+	}
+	else
+	{
+		for (NSString *group in allGroups)
+		{
+			NSUInteger count = [viewTransaction numberOfItemsInGroup:group];
+			
+			[counts setObject:@(count) forKey:group];
+		}
 	}
 	
-	BOOL firstUpdate = (snapshotOfLastUpdate == UINT64_MAX);
 	snapshotOfLastUpdate = [transaction->connection snapshot];
 	
 	if (firstUpdate || forceUpdateRangeOptions) {
@@ -415,9 +472,22 @@
 - (void)updateMappingsWithNewGroups:(NSArray *)newAllGroups
 {
 	allGroups = [newAllGroups copy];
+	allGroupsSet = [[NSSet alloc] initWithArray:allGroups];
     [self validateAutoConsolidation];
+    
+	// Carry over the counts of the groups that are still around
+	NSDictionary *oldCounts = counts;
+	
     id sharedKeySet = [NSDictionary sharedKeySetForKeys:allGroups];
     counts = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySet];
+	
+	for (NSString *group in allGroups)
+	{
+		NSNumber *count = [oldCounts objectForKey:group];
+		if (count) {
+			[counts setObject:count forKey:group];
+		}
+	}
 }
 
 - (void)validateAutoConsolidation{
@@ -443,14 +513,85 @@
 		}
 	}
 	
-	[newAllGroups sortUsingComparator:^NSComparisonResult(NSString *group1, NSString *group2) {
+	NSComparator comparator = ^NSComparisonResult(NSString *group1, NSString *group2) {
 		
 		return self->groupSortBlock(group1, group2, transaction);
-	}];
+	};
+	
+	// If the same groups passed the filter, and they're still in order, we can skip the sort.
+	
+	if ([newAllGroups count] == [allGroups count] && [allGroupsSet isEqualToSet:[NSSet setWithArray:newAllGroups]])
+	{
+		BOOL isSorted = YES;
+		
+		NSUInteger count = [allGroups count];
+		for (NSUInteger i = 1; i < count; i++)
+		{
+			if (comparator(allGroups[i-1], allGroups[i]) == NSOrderedDescending)
+			{
+				isSorted = NO;
+				break;
+			}
+		}
+		
+		if (isSorted) {
+			return allGroups;
+		}
+	}
+	
+	[newAllGroups sortUsingComparator:comparator];
     
     return [newAllGroups copy];
 }
 
+/**
+ * Only runs the groupFilterBlock & groupSortBlock for the given (changed) groups.
+ * Every other group keeps its current filter result & position.
+ *
+ * Used if onlyFilterAndSortChangedGroups is enabled.
+**/
+- (NSArray *)filterAndSortChangedGroups:(NSSet *)changedGroups withTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabaseViewTransaction *viewTransaction = [transaction ext:registeredViewName];
+	
+	NSMutableArray *groupsToInsert = [NSMutableArray arrayWithCapacity:[changedGroups count]];
+	for (NSString *group in changedGroups)
+	{
+		if ([viewTransaction hasGroup:group] && groupFilterBlock(group, transaction)) {
+			[groupsToInsert addObject:group];
+		}
+	}
+	
+	NSMutableArray *newAllGroups = [allGroups mutableCopy] ?: [NSMutableArray array];
+	
+	// Remove the changed groups (their position may have changed), and re-insert them.
+	
+	NSIndexSet *indexesToRemove = [newAllGroups indexesOfObjectsPassingTest:
+	    ^BOOL (NSString *group, NSUInteger __unused idx, BOOL __unused *stop)
+	{
+		return [changedGroups containsObject:group];
+	}];
+	
+	[newAllGroups removeObjectsAtIndexes:indexesToRemove];
+	
+	NSComparator comparator = ^NSComparisonResult(NSString *group1, NSString *group2) {
+		
+		return self->groupSortBlock(group1, group2, transaction);
+	};
+	
+	for (NSString *group in groupsToInsert)
+	{
+		NSUInteger index = [newAllGroups indexOfObject:group
+		                                 inSortedRange:NSMakeRange(0, [newAllGroups count])
+		                                       options:NSBinarySearchingInsertionIndex
+		                               usingComparator:comparator];
+		
+		[newAllGroups insertObject:group atIndex:index];
+	}
+	
+	return [newAllGroups copy];
+}
+
 - (BOOL)shouldUpdateAllGroupsWithNewGroups:(NSArray *)newGroups
 {
 	return ![allGroups isEqualToArray:newGroups];
@@ -543,6 +684,8 @@
 	[visibleGroups removeAllObjects];
 	NSUInteger totalCount = 0;
 	
+	NSMutableDictionary *newVisibleGroupSections = [NSMutableDictionary dictionaryWithCapacity:[allGroups count]];
+	
 	for (NSString *group in allGroups)
 	{
 		NSUInteger count;
@@ -554,12 +697,15 @@
 			count = [[counts objectForKey:group] unsignedIntegerValue];
 		
 		if (count > 0 || ![self isGroupDynamic:group]) {
+			[newVisibleGroupSections setObject:@([visibleGroups count]) forKey:group];
 			[visibleGroups addObject:group];
 		}
 		
 		totalCount += count;
 	}
 	
+	visibleGroupSections = [newVisibleGroupSections copy];
+	
 	if (totalCount < autoConsolidateGroupsThreshold)
 		isUsingConsolidatedGroup = YES;
 	else
@@ -1042,27 +1188,16 @@
 		// The thought process here is that the group may be technically visible.
 		// It's just that its consolidated into a bigger group.
 		
-		for (NSString *visibleGroup in visibleGroups)
-		{
-			if ([visibleGroup isEqualToString:group])
-			{
-				return 0;
-			}
-		}
+		if (group && [visibleGroupSections objectForKey:group])
+			return 0;
 		
 		return NSNotFound;
 	}
 	else
 	{
-		NSUInteger section = 0;
-		for (NSString *visibleGroup in visibleGroups)
-		{
-			if ([visibleGroup isEqualToString:group])
-			{
-				return section;
-			}
-			section++;
-		}
+		NSNumber *section = group ? [visibleGroupSections objectForKey:group] : nil;
+		if (section)
+			return [section unsignedIntegerValue];
 		
 		return NSNotFound;
 	}
@@ -30,6 +30,7 @@
 {
 	NSString *mapTableName = [self mapTableNameForRegisteredName:registeredName];
 	NSString *pageTableName = [self pageTableNameForRegisteredName:registeredName];
+	NSString *groupTableName = [self groupTableNameForRegisteredName:registeredName];
 	NSString *pageMetadataTableName = [self pageMetadataTableNameForRegisteredName:registeredName];
 	
 	if (wasPersistent)
@@ -40,6 +41,7 @@
 		
 		NSString *dropKeyTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", mapTableName];
 		NSString *dropPageTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", pageTableName];
+		NSString *dropGroupTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", groupTableName];
 		
 		int status;
 		
@@ -56,6 +58,13 @@
 			YDBLogError(@"%@ - Failed dropping page table (%@): %d %s",
 			            THIS_METHOD, pageTableName, status, sqlite3_errmsg(db));
 		}
+		
+		status = sqlite3_exec(db, [dropGroupTable UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed dropping group table (%@): %d %s",
+			            THIS_METHOD, groupTableName, status, sqlite3_errmsg(db));
+		}
 	}
 	else
 	{
@@ -77,6 +86,11 @@
 	return [NSString stringWithFormat:@"view_%@_page", registeredName];
 }
 
++ (NSString *)groupTableNameForRegisteredName:(NSString *)registeredName
+{
+	return [NSString stringWithFormat:@"view_%@_group", registeredName];
+}
+
 + (NSString *)pageMetadataTableNameForRegisteredName:(NSString *)registeredName
 {
 	return [NSString stringWithFormat:@"view_%@_pageMetadata", registeredName];
@@ -233,6 +247,11 @@
 	return [[self class] pageTableNameForRegisteredName:self.registeredName];
 }
 
+- (NSString *)groupTableName
+{
+	return [[self class] groupTableNameForRegisteredName:self.registeredName];
+}
+
 - (NSString *)pageMetadataTableName
 {
 	return [[self class] pageMetadataTableNameForRegisteredName:self.registeredName];
@@ -193,6 +193,28 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (NSUInteger)numberOfRawChangesForNotifications:(NSArray<NSNotification *> *)notifications;
 
+/**
+ * Warms up the database connection's caches with the objects in the given rows (of the given section).
+ * Typically used with a range around the visible window, so that scrolling hits warm caches.
+ *
+ * For example:
+ *
+ * NSRange range = NSMakeRange(firstVisibleRow - 20, visibleRowCount + 40); // clamped to >= 0
+ * [[uiDatabaseConnection ext:@"myView"] prefetchRowsInRange:range inSection:0 withMappings:mappings];
+ *
+ * Rows that are out of bounds are ignored.
+ * The prefetch runs in the background. @see -[YapDatabaseConnection prefetchObjectsForKeys:inCollection:]
+**/
+- (void)prefetchRowsInRange:(NSRange)range
+                  inSection:(NSUInteger)section
+               withMappings:(YapDatabaseViewMappings *)mappings;
+
+- (void)prefetchRowsInRange:(NSRange)range
+                  inSection:(NSUInteger)section
+               withMappings:(YapDatabaseViewMappings *)mappings
+            completionQueue:(nullable dispatch_queue_t)completionQueue
+            completionBlock:(nullable dispatch_block_t)completionBlock;
+
 @end
 
 NS_ASSUME_NONNULL_END
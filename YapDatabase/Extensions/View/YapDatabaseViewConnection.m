@@ -5,6 +5,7 @@
 #import "YapCache.h"
 #import "YapDatabaseString.h"
 #import "YapDatabaseLogging.h"
+#import "YapDatabaseSignposts.h"
 
 #if ! __has_feature(objc_arc)
 #warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
@@ -37,6 +38,11 @@
 	sqlite3_stmt *pageTable_updateLinkForPageKeyStatement;
 	sqlite3_stmt *pageTable_removeForPageKeyStatement;
 	sqlite3_stmt *pageTable_removeAllStatement;
+	
+	sqlite3_stmt *groupTable_getGroupIdForGroupStatement;
+	sqlite3_stmt *groupTable_insertGroupStatement;
+	sqlite3_stmt *groupTable_removeForGroupStatement;
+	sqlite3_stmt *groupTable_removeAllStatement;
 }
 
 @synthesize parent = parent;
@@ -48,11 +54,14 @@
 		parent = inParent;
 		databaseConnection = inDbC;
 		
+		YapDatabaseViewOptions *options = parent->options;
+		
 		mapCache = [[YapCache alloc] initWithCountLimit:100];
 		mapCache.allowedKeyClasses = [NSSet setWithObject:[NSNumber class]];
 		mapCache.allowedObjectClasses = [NSSet setWithObjects:[NSString class], [NSNull class], nil];
 		
-		pageCache = [[YapCache alloc] initWithCountLimit:40];
+		pageCache = [[YapCache alloc] initWithCountLimit:options.pageCacheCountLimit];
+		pageCache.costLimit = options.pageCacheCostLimit;
 		pageCache.allowedKeyClasses = [NSSet setWithObject:[NSString class]];
 		pageCache.allowedObjectClasses = [NSSet setWithObject:[YapDatabaseViewPage class]];
 		
@@ -81,6 +90,11 @@
 	sqlite_finalize_null(&pageTable_updateLinkForPageKeyStatement);
 	sqlite_finalize_null(&pageTable_removeForPageKeyStatement);
 	sqlite_finalize_null(&pageTable_removeAllStatement);
+	
+	sqlite_finalize_null(&groupTable_getGroupIdForGroupStatement);
+	sqlite_finalize_null(&groupTable_insertGroupStatement);
+	sqlite_finalize_null(&groupTable_removeForGroupStatement);
+	sqlite_finalize_null(&groupTable_removeAllStatement);
 }
 
 /**
@@ -92,6 +106,8 @@
 	{
 		[mapCache removeAllObjects];
 		[pageCache removeAllObjects];
+		
+		rowidMap = nil;
 	}
 	
 	if (flags & YapDatabaseConnectionFlushMemoryFlags_Statements)
@@ -105,6 +121,30 @@
 	}
 }
 
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateMemoryUsageWithBlock:(void (^)(NSString *component,
+                                                uint64_t bytes,
+                                                YapDatabaseConnectionFlushMemoryFlags flushFlags))block
+{
+	block(@"mapCache", [mapCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+	block(@"pageCache", [pageCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+	
+	if (rowidMap) {
+		block(@"rowidMap", [rowidMap estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+	}
+}
+
+/**
+ * Optional override method from YapDatabaseExtensionConnection
+**/
+- (void)enumerateCachesWithBlock:(void (^)(NSString *cacheName, YapCache *cache))block
+{
+	block(@"mapCache", mapCache);
+	block(@"pageCache", pageCache);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -153,7 +193,7 @@
 	YDBLogAutoTrace();
 	
 	if (dirtyMaps == nil)
-		dirtyMaps = [[YapDirtyDictionary alloc] init];
+		dirtyMaps = [[YapRowidDirtyDictionary alloc] init];
 	if (dirtyPages == nil)
 		dirtyPages = [[NSMutableDictionary alloc] init];
 	if (dirtyLinks == nil)
@@ -176,6 +216,17 @@
 	
 	// This code is best understood alongside the getExternalChangeset:internalChangeset: method (below).
 	
+	// The in-memory rowidMap (if loaded) only reflects committed changes.
+	// So apply the changes from this transaction (before dirtyMaps is handed off).
+	
+	if (rowidMap)
+	{
+		if (reset) {
+			[rowidMap removeAllRowids];
+		}
+		[rowidMap applyDirtyMaps:dirtyMaps];
+	}
+	
 	// Both dirtyKeys & dirtyPages are sent in the internalChangeset.
 	// So we need completely new versions of them.
 	
@@ -225,6 +276,8 @@
 	[mapCache removeAllObjects];
 	[pageCache removeAllObjects];
 	
+	rowidMap = nil; // may have been loaded mid-transaction (after changes were written to the map table)
+	
 	[dirtyMaps removeAllObjects];
 	[dirtyPages removeAllObjects];
 	[dirtyLinks removeAllObjects];
@@ -318,7 +371,7 @@
 	
 	YapDatabaseViewState *changeset_state = changeset[changeset_key_state];
 	
-	YapDirtyDictionary *changeset_dirtyMaps  = changeset[changeset_key_dirtyMaps];
+	YapRowidDirtyDictionary *changeset_dirtyMaps  = changeset[changeset_key_dirtyMaps];
 	NSDictionary       *changeset_dirtyPages = changeset[changeset_key_dirtyPages];
 	
 	BOOL changeset_reset = [changeset[changeset_key_reset] boolValue];
@@ -350,7 +403,7 @@
 			// [transaction removeAllObjects];
 			// [transaction setObject:obj forKey:key];
 			
-			if ([changeset_dirtyMaps objectForKey:key])
+			if ([changeset_dirtyMaps objectForRowid:[(NSNumber *)key longLongValue]])
 				[keysToUpdate addObject:key];
 			else if (changeset_reset)
 				[keysToRemove addObject:key];
@@ -360,9 +413,9 @@
 		
 		NSNull *nsnull = [NSNull null];
 		
-		for (NSString *key in keysToUpdate)
+		for (NSNumber *key in keysToUpdate)
 		{
-			NSString *pageKey = [changeset_dirtyMaps objectForKey:key];
+			NSString *pageKey = [changeset_dirtyMaps objectForRowid:[key longLongValue]];
 			
 			if ((id)pageKey == nsnull)
 				[mapCache removeObjectForKey:key];
@@ -371,6 +424,16 @@
 		}
 	}
 	
+	// Update rowidMap
+	
+	if (rowidMap)
+	{
+		if (changeset_reset) {
+			[rowidMap removeAllRowids];
+		}
+		[rowidMap applyDirtyMaps:changeset_dirtyMaps];
+	}
+	
 	// Update pageCache
 	
 	if (changeset_reset && ([changeset_dirtyPages count] == 0))
@@ -477,6 +540,26 @@
 		[all_changes addObjectsFromArray:changeset_changes];
 	}
 	
+	// Only the groups touched by the changes need to be refreshed within the mappings.
+	
+	NSMutableSet *changedGroups = [NSMutableSet set];
+	for (id change in all_changes)
+	{
+		if ([change isKindOfClass:[YapDatabaseViewSectionChange class]])
+		{
+			__unsafe_unretained YapDatabaseViewSectionChange *sectionChange = (YapDatabaseViewSectionChange *)change;
+			
+			if (sectionChange->group) [changedGroups addObject:sectionChange->group];
+		}
+		else
+		{
+			__unsafe_unretained YapDatabaseViewRowChange *rowChange = (YapDatabaseViewRowChange *)change;
+			
+			if (rowChange->originalGroup) [changedGroups addObject:rowChange->originalGroup];
+			if (rowChange->finalGroup) [changedGroups addObject:rowChange->finalGroup];
+		}
+	}
+	
 	YapDatabaseViewMappings *originalMappings = [mappings copy];
 	
 	[databaseConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
@@ -495,7 +578,7 @@
 		// and moves it to the most recent snapshot. If this is the case,
 		// be sure to use a separate connection for your read-write transaction.
 		//
-		[mappings updateWithTransaction:transaction forceUpdateRangeOptions:NO];
+		[mappings updateWithTransaction:transaction forceUpdateRangeOptions:NO changedGroups:changedGroups];
 	}];
 	
 	NSDictionary *firstChangeset = [[notifications objectAtIndex:0] userInfo];
@@ -565,11 +648,15 @@
 		@throw exception;
 	}
 	
+	YDBSignpostID signpost = YDBSignpostBegin("View Changes", "view: %{public}@", registeredName);
+	
 	[YapDatabaseViewChange getSectionChanges:sectionChangesPtr
 	                              rowChanges:rowChangesPtr
 	                    withOriginalMappings:originalMappings
 	                           finalMappings:mappings
 	                             fromChanges:all_changes];
+	
+	YDBSignpostEnd(signpost, "View Changes", "changes: %lu", (unsigned long)all_changes.count);
 }
 
 /**
@@ -705,6 +792,82 @@
 	return count;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Prefetch
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)prefetchRowsInRange:(NSRange)range
+                  inSection:(NSUInteger)section
+               withMappings:(YapDatabaseViewMappings *)mappings
+{
+	[self prefetchRowsInRange:range inSection:section withMappings:mappings completionQueue:NULL completionBlock:NULL];
+}
+
+- (void)prefetchRowsInRange:(NSRange)range
+                  inSection:(NSUInteger)section
+               withMappings:(YapDatabaseViewMappings *)inMappings
+            completionQueue:(dispatch_queue_t)completionQueue
+            completionBlock:(dispatch_block_t)completionBlock
+{
+	// The mappings may be updated (on the main thread) while we're prefetching.
+	YapDatabaseViewMappings *mappings = [inMappings copy];
+	NSString *registeredName = parent.registeredName;
+	
+	[databaseConnection prefetchObjectsWithKeysBlock:^NSArray<YapCollectionKey *> *(YapDatabaseReadTransaction *transaction) {
+		
+		YapDatabaseViewTransaction *viewTransaction = [transaction ext:registeredName];
+		if (viewTransaction == nil) return nil;
+		
+		NSUInteger count = [mappings numberOfItemsInSection:section];
+		NSUInteger end = MIN(NSMaxRange(range), count);
+		
+		NSMutableArray<NSString *> *groups = [NSMutableArray array];
+		NSMutableArray<NSNumber *> *indexes = [NSMutableArray array];
+		
+		NSMutableDictionary<NSString *, NSMutableIndexSet *> *indexesByGroup = [NSMutableDictionary dictionary];
+		
+		for (NSUInteger row = range.location; row < end; row++)
+		{
+			NSString *group = nil;
+			NSUInteger index = 0;
+			
+			if ([mappings getGroup:&group index:&index forRow:row inSection:section])
+			{
+				[groups addObject:group];
+				[indexes addObject:@(index)];
+				
+				NSMutableIndexSet *groupIndexes = indexesByGroup[group];
+				if (groupIndexes == nil)
+					indexesByGroup[group] = groupIndexes = [NSMutableIndexSet indexSet];
+				
+				[groupIndexes addIndex:index];
+			}
+		}
+		
+		// Warm up the pageCache first (including the pages just beyond the range),
+		// so the view doesn't load the pages one at a time, and scrolling doesn't miss at page boundaries.
+		
+		[viewTransaction readaheadPagesForIndexes:indexesByGroup];
+		
+		NSMutableArray<YapCollectionKey *> *collectionKeys = [NSMutableArray arrayWithCapacity:indexes.count];
+		
+		for (NSUInteger i = 0; i < indexes.count; i++)
+		{
+			NSString *key = nil;
+			NSString *collection = nil;
+			
+			if ([viewTransaction getKey:&key collection:&collection atIndex:[indexes[i] unsignedIntegerValue]
+			                                                         inGroup:groups[i]])
+			{
+				[collectionKeys addObject:YapCollectionKeyCreate(collection, key)];
+			}
+		}
+		
+		return collectionKeys;
+		
+	} completionQueue:completionQueue completionBlock:completionBlock];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Statements - Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -747,7 +910,7 @@
 - (sqlite3_stmt *)mapTable_setPageKeyForRowidStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &mapTable_setPageKeyForRowidStatement;
 	if (*statement == NULL)
 	{
@@ -763,7 +926,7 @@
 - (sqlite3_stmt *)mapTable_removeForRowidStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &mapTable_removeForRowidStatement;
 	if (*statement == NULL)
 	{
@@ -779,7 +942,7 @@
 - (sqlite3_stmt *)mapTable_removeAllStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &mapTable_removeAllStatement;
 	if (*statement == NULL)
 	{
@@ -799,7 +962,7 @@
 - (sqlite3_stmt *)pageTable_getDataForPageKeyStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &pageTable_getDataForPageKeyStatement;
 	if (*statement == NULL)
 	{
@@ -815,13 +978,13 @@
 - (sqlite3_stmt *)pageTable_insertForPageKeyStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &pageTable_insertForPageKeyStatement;
 	if (*statement == NULL)
 	{
 		NSString *string = [NSString stringWithFormat:
 			@"INSERT INTO \"%@\""
-			@" (\"pageKey\", \"group\", \"prevPageKey\", \"count\", \"data\") VALUES (?, ?, ?, ?, ?);",
+			@" (\"pageKey\", \"groupId\", \"prevPageKey\", \"count\", \"data\") VALUES (?, ?, ?, ?, ?);",
 			[parent pageTableName]];
 		
 		[self prepareStatement:statement withString:string caller:_cmd];
@@ -833,7 +996,7 @@
 - (sqlite3_stmt *)pageTable_updateAllForPageKeyStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &pageTable_updateAllForPageKeyStatement;
 	if (*statement == NULL)
 	{
@@ -850,7 +1013,7 @@
 - (sqlite3_stmt *)pageTable_updatePageForPageKeyStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &pageTable_updatePageForPageKeyStatement;
 	if (*statement == NULL)
 	{
@@ -866,7 +1029,7 @@
 - (sqlite3_stmt *)pageTable_updateLinkForPageKeyStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &pageTable_updateLinkForPageKeyStatement;
 	if (*statement == NULL)
 	{
@@ -882,7 +1045,7 @@
 - (sqlite3_stmt *)pageTable_removeForPageKeyStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &pageTable_removeForPageKeyStatement;
 	if (*statement == NULL)
 	{
@@ -898,7 +1061,7 @@
 - (sqlite3_stmt *)pageTable_removeAllStatement
 {
 	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
-
+	
 	sqlite3_stmt **statement = &pageTable_removeAllStatement;
 	if (*statement == NULL)
 	{
@@ -911,4 +1074,72 @@
 	return *statement;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Statements - GroupTable
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (sqlite3_stmt *)groupTable_getGroupIdForGroupStatement
+{
+	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
+	
+	sqlite3_stmt **statement = &groupTable_getGroupIdForGroupStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		    @"SELECT \"groupId\" FROM \"%@\" WHERE \"group\" = ?;", [parent groupTableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)groupTable_insertGroupStatement
+{
+	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
+	
+	sqlite3_stmt **statement = &groupTable_insertGroupStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		    @"INSERT INTO \"%@\" (\"group\") VALUES (?);", [parent groupTableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)groupTable_removeForGroupStatement
+{
+	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
+	
+	sqlite3_stmt **statement = &groupTable_removeForGroupStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		    @"DELETE FROM \"%@\" WHERE \"group\" = ?;", [parent groupTableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)groupTable_removeAllStatement
+{
+	NSAssert([self isPersistentView], @"In-memory view accessing sqlite");
+	
+	sqlite3_stmt **statement = &groupTable_removeAllStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:
+		    @"DELETE FROM \"%@\";", [parent groupTableName]];
+		
+		[self prepareStatement:statement withString:string caller:_cmd];
+	}
+	
+	return *statement;
+}
+
 @end
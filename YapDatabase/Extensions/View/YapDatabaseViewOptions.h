@@ -3,6 +3,19 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * How the view sizes the pages of rowids it stores.
+ * See -[YapDatabaseViewOptions pageSizing].
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseViewPageSizing) {
+	
+	/** Every page holds (at most) pageSize rowids. */
+	YapDatabaseViewPageSizingFixed    = 0,
+	
+	/** The page size of each group grows with the number of items in the group. */
+	YapDatabaseViewPageSizingAdaptive = 1,
+};
+
 /**
  * Welcome to YapDatabase!
  *
@@ -70,6 +83,94 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, assign, readwrite) BOOL skipInitialViewPopulation;
 
+/**
+ * The view splits the sorted array of rowids for each group into "pages",
+ * where each page is stored as a single row in the database.
+ *
+ * Small pages are cheap to rewrite, but a big group ends up with thousands of pages,
+ * and a commit that touches many of them writes thousands of small rows (and keeps thousands of pageMetadata in memory).
+ *
+ * With YapDatabaseViewPageSizingFixed, every page holds up to pageSize rowids.
+ *
+ * With YapDatabaseViewPageSizingAdaptive, pageSize is the minimum.
+ * The page size of a group is doubled (up to 32 times pageSize) for as long as the group would need more than 64 pages.
+ * So small groups keep small pages, while big groups get fewer (bigger) pages.
+ *
+ * Changing these options doesn't require the view to be repopulated (or the versionTag to be changed).
+ * Existing pages are migrated lazily: whenever a page is modified, it's split, or merged with a neighbor,
+ * according to the current page size of its group.
+ *
+ * The default pageSizing is YapDatabaseViewPageSizingFixed.
+ * The default pageSize is 50. (Zero is treated as the default.)
+**/
+@property (nonatomic, assign, readwrite) YapDatabaseViewPageSizing pageSizing;
+@property (nonatomic, assign, readwrite) NSUInteger pageSize;
+
+/**
+ * A non-persistent view has to be populated (which means a full scan) every time the app is launched.
+ * To avoid this, you can give the view a snapshotURL (a file outside the database).
+ *
+ * The snapshot is written when you invoke -[YapDatabaseViewTransaction writeSnapshot],
+ * typically when the app moves to the background, or is about to terminate.
+ * It contains the pages of the view, stamped with the snapshot number of the database,
+ * along with the class, classVersion, versionTag & registeredName of the view.
+ *
+ * On the next launch, when the view is registered, it's restored directly from the snapshot file
+ * if the stamp matches. Otherwise (e.g. something was committed after the snapshot was written,
+ * or the versionTag changed) the snapshot is ignored, and the view is populated as usual.
+ *
+ * Keep in mind that the stamp only covers the database and the configuration of the view.
+ * If the view depends on anything else (e.g. another non-persistent view), bump the versionTag when that changes.
+ *
+ * This option is ignored for persistent views.
+ *
+ * The snapshot file is NOT encrypted, and it contains the group names & rowids of the view.
+ * So this option is also ignored if the database is encrypted (i.e. YapDatabaseOptions.cipherKeyBlock
+ * or cipherKeySpecBlock is set): writeSnapshot does nothing, and the view is populated as usual.
+ *
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable) NSURL *snapshotURL;
+
+/**
+ * To find where a row lives within the view (e.g. when the row is modified or removed),
+ * a persistent view looks up the page of the row in its map table, unless it's in a small cache (100 rows).
+ * So random updates across a large view pay a SQL lookup for nearly every row.
+ *
+ * If enabled, each connection keeps the entire rowid -> page mapping of the view in memory instead.
+ * The mapping is loaded (with a single query) the first time it's needed, and kept up-to-date as the view changes.
+ * From then on, the map table is never queried.
+ *
+ * Each row costs a 16 byte slot in a hash table that's kept at most 3/4 full (so 20-40 bytes per row, per connection).
+ * Page keys are stored only once, and referenced by a 32-bit index.
+ * The mapping is dropped when the connection flushes its caches, and reloaded on demand.
+ *
+ * This option is ignored for non-persistent views (whose mapping is always in memory).
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL keepsRowidMapInMemory;
+
+/**
+ * Each connection keeps recently used pages (deserialized) in a pageCache.
+ *
+ * The right size depends on the view. A view with a few huge groups, scrolled from top to bottom,
+ * needs enough pages to cover the visible range plus the readahead (the page on either side).
+ * Whereas a view with thousands of tiny groups touches many small pages.
+ *
+ * pageCacheCountLimit is the maximum number of pages in the cache (zero means no limit).
+ * pageCacheCostLimit is the maximum number of bytes used by the cached pages (zero means no limit).
+ * If both are set, both are enforced.
+ *
+ * The hit rate of the cache is available via -[YapDatabaseConnection statistics],
+ * under the name "<registeredName>.pageCache".
+ *
+ * The default pageCacheCountLimit is 40.
+ * The default pageCacheCostLimit is zero.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger pageCacheCountLimit;
+@property (nonatomic, assign, readwrite) NSUInteger pageCacheCostLimit;
+
 @end
 
 NS_ASSUME_NONNULL_END
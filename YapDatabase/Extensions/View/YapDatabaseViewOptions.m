@@ -6,12 +6,21 @@
 @synthesize isPersistent = isPersistent;
 @synthesize allowedCollections = allowedCollections;
 @synthesize skipInitialViewPopulation = skipInitialViewPopulation;
+@synthesize pageSizing = pageSizing;
+@synthesize pageSize = pageSize;
+@synthesize snapshotURL = snapshotURL;
+@synthesize keepsRowidMapInMemory = keepsRowidMapInMemory;
+@synthesize pageCacheCountLimit = pageCacheCountLimit;
+@synthesize pageCacheCostLimit = pageCacheCostLimit;
 
 - (id)init
 {
 	if ((self = [super init]))
 	{
 		isPersistent = YES;
+		pageSizing = YapDatabaseViewPageSizingFixed;
+		pageSize = 50;
+		pageCacheCountLimit = 40;
 	}
 	return self;
 }
@@ -22,7 +31,13 @@
 	copy->isPersistent = isPersistent;
 	copy->allowedCollections = allowedCollections;
 	copy->skipInitialViewPopulation = skipInitialViewPopulation;
-
+	copy->pageSizing = pageSizing;
+	copy->pageSize = pageSize;
+	copy->snapshotURL = snapshotURL;
+	copy->keepsRowidMapInMemory = keepsRowidMapInMemory;
+	copy->pageCacheCountLimit = pageCacheCountLimit;
+	copy->pageCacheCostLimit = pageCacheCostLimit;
+	
 	return copy;
 }
 
@@ -149,6 +149,29 @@ NS_ASSUME_NONNULL_BEGIN
                        range:(NSRange)range
                   usingBlock:(void (^)(NSString *collection, NSString *key, NSUInteger index, BOOL *stop))block;
 
+#pragma mark Snapshots
+
+/**
+ * For non-persistent views that have a snapshotURL (see YapDatabaseViewOptions).
+ *
+ * Writes a snapshot of the view, as it exists in this transaction, to the snapshotURL.
+ * The next time the view is registered, it's restored from the snapshot (instead of being populated),
+ * provided nothing has been committed to the database in the meantime.
+ *
+ * For example, from applicationDidEnterBackground:
+ *
+ * [databaseConnection readWithBlock:^(YapDatabaseReadTransaction *transaction){
+ *     [[transaction ext:@"myView"] writeSnapshot];
+ * }];
+ *
+ * This method is only allowed in a read-only transaction,
+ * as the changes of a read-write transaction haven't been committed yet.
+ *
+ * @return
+ *   YES if the snapshot was written. NO otherwise.
+**/
+- (BOOL)writeSnapshot;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -384,6 +407,17 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @interface YapDatabaseViewTransaction (Mappings)
 
+/**
+ * Loads the objects at the given indexPaths into the object cache, assuming the given mappings are being used.
+ *
+ * Objects that aren't already in the cache are fetched in bulk (a single query),
+ * rather than one at a time as each cell asks for its object.
+ * This is designed to be invoked from UITableViewDataSourcePrefetching / UICollectionViewDataSourcePrefetching.
+ * Invalid indexPaths are ignored.
+**/
+- (void)prefetchObjectsAtIndexPaths:(NSArray<NSIndexPath *> *)indexPaths
+                       withMappings:(YapDatabaseViewMappings *)mappings;
+
 /**
  * Gets the key & collection at the given indexPath, assuming the given mappings are being used.
  * Returns NO if the indexPath is invalid, or the mappings aren't initialized.
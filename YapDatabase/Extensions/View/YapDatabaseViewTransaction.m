@@ -6,6 +6,7 @@
 
 #import "YapCache.h"
 #import "YapCollectionKey.h"
+#import "YapDatabaseBinaryCodec.h"
 #import "YapDatabaseString.h"
 #import "YapDatabaseLogging.h"
 
@@ -71,7 +72,12 @@
 		if (parentConnection->state == nil)
 			parentConnection->state = [[YapDatabaseViewState alloc] init];
 		
-		if (!parentConnection->parent->options.skipInitialViewPopulation)
+		// If the app wrote a snapshot of the view (at the current database snapshot),
+		// then we can restore the view from it, and skip the (full scan) population.
+		
+		BOOL restored = [self restoreFromSnapshot];
+		
+		if (!restored && !parentConnection->parent->options.skipInitialViewPopulation)
 		{
 			if (![self populateView]) return NO;
 		}
@@ -126,9 +132,17 @@
 		{
 			// Upgrading from older codebase
 			
-			[self dropTablesForOldClassVersion:oldClassVersion];
-			needsCreateTables = YES;
-			needsPopulateView = YES; // Not initialViewPopulation, but rather codebase upgrade.
+			if ((oldClassVersion == 3) && [self upgradeTablesFromClassVersion3])
+			{
+				// The page table was converted in place,
+				// so there's no need to re-populate the view.
+			}
+			else
+			{
+				[self dropTablesForOldClassVersion:oldClassVersion];
+				needsCreateTables = YES;
+				needsPopulateView = YES; // Not initialViewPopulation, but rather codebase upgrade.
+			}
 		}
 	
 		// Create the database tables (if needed)
@@ -240,7 +254,7 @@
 	// Enumerate over the page rows in the database, and populate our data structure.
 	// Each row has the following information:
 	//
-	// - group
+	// - groupId (which references the group table)
 	// - pageKey
 	// - prevPageKey
 	//
@@ -261,16 +275,25 @@
 	NSMutableDictionary<NSString *, NSMutableDictionary *> *groupOrderDict = [[NSMutableDictionary alloc] init];
 	
 	__block BOOL error = NO;
-
+	
 	if ([self isPersistentView])
 	{
 		sqlite3 *db = databaseTransaction->connection->db;
 		
+		// Load the group names first.
+		// Every page of a group then references the same string instance.
+		
+		NSDictionary<NSNumber *, NSString *> *groupIdDict = [self groupsByGroupId];
+		if (groupIdDict == nil)
+		{
+			return NO;
+		}
+		
 		NSString *string = [NSString stringWithFormat:
-			@"SELECT \"pageKey\", \"group\", \"prevPageKey\", \"count\" FROM \"%@\";", [self pageTableName]];
+			@"SELECT \"pageKey\", \"groupId\", \"prevPageKey\", \"count\" FROM \"%@\";", [self pageTableName]];
 		
 		int const column_idx_pageKey     = SQLITE_COLUMN_START + 0;
-		int const column_idx_group       = SQLITE_COLUMN_START + 1;
+		int const column_idx_groupId     = SQLITE_COLUMN_START + 1;
 		int const column_idx_prevPageKey = SQLITE_COLUMN_START + 2;
 		int const column_idx_count       = SQLITE_COLUMN_START + 3;
 		
@@ -295,10 +318,16 @@
 			
 			NSString *pageKey = [[NSString alloc] initWithBytes:text0 length:textSize0 encoding:NSUTF8StringEncoding];
 			
-			const unsigned char *text1 = sqlite3_column_text(statement, column_idx_group);
-			int textSize1 = sqlite3_column_bytes(statement, column_idx_group);
+			int64_t groupId = sqlite3_column_int64(statement, column_idx_groupId);
 			
-			NSString *group = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+			NSString *group = groupIdDict[@(groupId)];
+			if (group == nil)
+			{
+				YDBLogError(@"%@ (%@): Encountered unknown groupId: %lld", THIS_METHOD, [self registeredName], groupId);
+				
+				error = YES;
+				break;
+			}
 			
 			const unsigned char *text2 = sqlite3_column_text(statement, column_idx_prevPageKey);
 			int textSize2 = sqlite3_column_bytes(statement, column_idx_prevPageKey);
@@ -389,7 +418,7 @@
 	
 	// Now that we have all the metadata about each page,
 	// it's time to piece them together in the proper order.
-
+	
 	if (!error)
 	{
 		// Initialize ivars in viewConnection.
@@ -511,13 +540,16 @@
 		}
 	}
 	
-	if (oldClassVersion == 1 || oldClassVersion == 2)
+	if (oldClassVersion == 1 || oldClassVersion == 2 || oldClassVersion == 3)
 	{
 		// In version 3, we changed the columns of the 'view_name_page' table.
 		// The old table stored all metadata in a blob.
 		// The new table stores each metadata item in its own column.
 		//
 		// This new layout reduces the amount of data we have to write to the table.
+		//
+		// In version 4, the 'group' column was replaced by a 'groupId' column (see upgradeTablesFromClassVersion3).
+		// This is only reached if that upgrade failed.
 		
 		sqlite3 *db = databaseTransaction->connection->db;
 		
@@ -532,6 +564,128 @@
 	}
 }
 
+/**
+ * Codebase upgrade helper.
+ *
+ * In version 4, group names are stored only once, in the 'view_name_group' table.
+ * And the 'view_name_page' table references the group via its groupId (rather than storing the group name per page).
+ *
+ * The pages themselves haven't changed, so the upgrade is done in place (without re-populating the view).
+ * Returns NO if the upgrade failed, in which case the caller should drop & re-create the tables.
+**/
+- (BOOL)upgradeTablesFromClassVersion3
+{
+	YDBLogAutoTrace();
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *pageTableName = [self pageTableName];
+	NSString *groupTableName = [self groupTableName];
+	NSString *tmpPageTableName = [NSString stringWithFormat:@"%@_v4", pageTableName];
+	
+	NSArray<NSString *> *statements = @[
+	  
+	  [NSString stringWithFormat:
+	    @"CREATE TABLE IF NOT EXISTS \"%@\""
+	    @" (\"groupId\" INTEGER PRIMARY KEY,"
+	    @"  \"group\" CHAR NOT NULL UNIQUE"
+	    @" );", groupTableName],
+	  
+	  [NSString stringWithFormat:
+	    @"INSERT OR IGNORE INTO \"%@\" (\"group\") SELECT DISTINCT \"group\" FROM \"%@\";",
+	    groupTableName, pageTableName],
+	  
+	  [NSString stringWithFormat:
+	    @"CREATE TABLE \"%@\""
+	    @" (\"pageKey\" CHAR NOT NULL PRIMARY KEY,"
+	    @"  \"groupId\" INTEGER NOT NULL,"
+	    @"  \"prevPageKey\" CHAR,"
+	    @"  \"count\" INTEGER,"
+	    @"  \"data\" BLOB"
+	    @" );", tmpPageTableName],
+	  
+	  [NSString stringWithFormat:
+	    @"INSERT INTO \"%@\" (\"pageKey\", \"groupId\", \"prevPageKey\", \"count\", \"data\")"
+	    @" SELECT p.\"pageKey\", g.\"groupId\", p.\"prevPageKey\", p.\"count\", p.\"data\""
+	    @" FROM \"%@\" AS p INNER JOIN \"%@\" AS g ON p.\"group\" = g.\"group\";",
+	    tmpPageTableName, pageTableName, groupTableName],
+	  
+	  [NSString stringWithFormat:@"DROP TABLE \"%@\";", pageTableName],
+	  
+	  [NSString stringWithFormat:@"ALTER TABLE \"%@\" RENAME TO \"%@\";", tmpPageTableName, pageTableName]
+	];
+	
+	for (NSString *statement in statements)
+	{
+		int status = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ (%@): Failed upgrading page table: %d %s",
+			            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+			
+			NSString *dropTmpPageTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tmpPageTableName];
+			NSString *dropGroupTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", groupTableName];
+			
+			sqlite3_exec(db, [dropTmpPageTable UTF8String], NULL, NULL, NULL);
+			sqlite3_exec(db, [dropGroupTable UTF8String], NULL, NULL, NULL);
+			
+			return NO;
+		}
+	}
+	
+	return YES;
+}
+
+/**
+ * Reads the group table, and returns a dictionary of groupId -> group.
+ * Returns nil if there was an error reading the table.
+**/
+- (NSDictionary<NSNumber *, NSString *> *)groupsByGroupId
+{
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *string = [NSString stringWithFormat:
+	    @"SELECT \"groupId\", \"group\" FROM \"%@\";", [self groupTableName]];
+	
+	int const column_idx_groupId = SQLITE_COLUMN_START + 0;
+	int const column_idx_group   = SQLITE_COLUMN_START + 1;
+	
+	sqlite3_stmt *statement = NULL;
+	
+	int status = sqlite3_prepare_v2(db, [string UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ (%@): Cannot create 'enumerate_stmt': %d %s",
+		            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+		return nil;
+	}
+	
+	NSMutableDictionary<NSNumber *, NSString *> *groupIdDict = [[NSMutableDictionary alloc] init];
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t groupId = sqlite3_column_int64(statement, column_idx_groupId);
+		
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_group);
+		int textSize = sqlite3_column_bytes(statement, column_idx_group);
+		
+		NSString *group = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		groupIdDict[@(groupId)] = group;
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ (%@): Error enumerating group table: %d %s",
+		            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+		
+		groupIdDict = nil;
+	}
+	
+	sqlite3_finalize(statement);
+	return groupIdDict;
+}
+
 /**
  * Subclasses can easily override this method to create their own tables.
  * If overriden, don't forget to invoke [super createTables].
@@ -546,9 +700,10 @@
 		
 		NSString *mapTableName = [self mapTableName];
 		NSString *pageTableName = [self pageTableName];
+		NSString *groupTableName = [self groupTableName];
 		
-		YDBLogVerbose(@"Creating view tables for registeredName(%@): %@, %@",
-		              [self registeredName], mapTableName, pageTableName);
+		YDBLogVerbose(@"Creating view tables for registeredName(%@): %@, %@, %@",
+		              [self registeredName], mapTableName, pageTableName, groupTableName);
 		
 		NSString *createMapTable = [NSString stringWithFormat:
 		    @"CREATE TABLE IF NOT EXISTS \"%@\""
@@ -559,12 +714,18 @@
 		NSString *createPageTable = [NSString stringWithFormat:
 		    @"CREATE TABLE IF NOT EXISTS \"%@\""
 		    @" (\"pageKey\" CHAR NOT NULL PRIMARY KEY,"
-		    @"  \"group\" CHAR NOT NULL,"
+		    @"  \"groupId\" INTEGER NOT NULL,"
 		    @"  \"prevPageKey\" CHAR,"
 		    @"  \"count\" INTEGER,"
 		    @"  \"data\" BLOB"
 		    @" );", pageTableName];
 		
+		NSString *createGroupTable = [NSString stringWithFormat:
+		    @"CREATE TABLE IF NOT EXISTS \"%@\""
+		    @" (\"groupId\" INTEGER PRIMARY KEY,"
+		    @"  \"group\" CHAR NOT NULL UNIQUE"
+		    @" );", groupTableName];
+		
 		int status;
 		
 		status = sqlite3_exec(db, [createMapTable UTF8String], NULL, NULL, NULL);
@@ -583,6 +744,14 @@
 			return NO;
 		}
 		
+		status = sqlite3_exec(db, [createGroupTable UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ - Failed creating group table (%@): %d %s",
+			            THIS_METHOD, groupTableName, status, sqlite3_errmsg(db));
+			return NO;
+		}
+		
 		return YES;
 	}
 	else // if (isNonPersistentView)
@@ -666,6 +835,11 @@
 	return [parentConnection->parent pageTableName];
 }
 
+- (NSString *)groupTableName
+{
+	return [parentConnection->parent groupTableName];
+}
+
 - (NSString *)pageMetadataTableName
 {
 	return [parentConnection->parent pageMetadataTableName];
@@ -685,6 +859,20 @@
 	return [page serialize];
 }
 
+/**
+ * Returns the serialized page, reusing the data from prepareChangesForExtensionTables if the page hasn't changed since.
+**/
+- (NSData *)serializeDirtyPage:(YapDatabaseViewPage *)page withPageKey:(NSString *)pageKey
+{
+	NSData *data = preparedPageData[pageKey];
+	if (data && ([preparedPageCounts[pageKey] unsignedIntegerValue] == [page count]))
+	{
+		return data;
+	}
+	
+	return [self serializePage:page];
+}
+
 - (YapDatabaseViewPage *)deserializePage:(NSData *)data
 {
 	YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] init];
@@ -693,6 +881,272 @@
 	return page;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Snapshots
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static NSString *const snapshot_key_format       = @"format";
+static NSString *const snapshot_key_viewClass    = @"viewClass";
+static NSString *const snapshot_key_classVersion = @"classVersion";
+static NSString *const snapshot_key_versionTag   = @"versionTag";
+static NSString *const snapshot_key_name         = @"name";
+static NSString *const snapshot_key_snapshot     = @"snapshot";
+static NSString *const snapshot_key_groups       = @"groups";
+
+static NSInteger const YapDatabaseViewSnapshotFormat = 1;
+
+/**
+ * Snapshot file format (encoded with the YapDatabaseBinaryCodec):
+ *
+ * {
+ *   format       : 1,
+ *   viewClass    : class name of the view,
+ *   classVersion : YAP_DATABASE_VIEW_CLASS_VERSION,
+ *   versionTag   : versionTag of the view,
+ *   name         : registeredName of the view,
+ *   snapshot     : the database snapshot the view was captured at,
+ *   groups       : { group -> [serialized page, ...] }
+ * }
+ *
+ * The pages (and thus the rowid -> page mappings) are all that's needed to restore the view.
+ * The pageKeys aren't stored. New pageKeys are generated when the snapshot is restored.
+**/
+- (NSDictionary *)snapshotStamp
+{
+	NSString *versionTag = [parentConnection->parent versionTag];
+	
+	return @{
+		snapshot_key_format       : @(YapDatabaseViewSnapshotFormat),
+		snapshot_key_viewClass    : NSStringFromClass([parentConnection->parent class]),
+		snapshot_key_classVersion : @(YAP_DATABASE_VIEW_CLASS_VERSION),
+		snapshot_key_versionTag   : (versionTag ?: @""),
+		snapshot_key_name         : [self registeredName],
+		snapshot_key_snapshot     : @(databaseTransaction->connection.snapshot)
+	};
+}
+
+/**
+ * Returns options.snapshotURL, or nil if the database is encrypted.
+ * 
+ * The snapshot file isn't encrypted, and it contains the group names & rowids of the view.
+ * So for an encrypted database, the snapshotURL is ignored (and the view is populated as usual).
+**/
+- (NSURL *)snapshotURL
+{
+	NSURL *snapshotURL = parentConnection->parent->options.snapshotURL;
+	
+#ifdef SQLITE_HAS_CODEC
+	if (snapshotURL)
+	{
+		YapDatabaseOptions *databaseOptions = parentConnection->parent.registeredDatabase.options;
+		if (databaseOptions.cipherKeyBlock || databaseOptions.cipherKeySpecBlock)
+		{
+			return nil;
+		}
+	}
+#endif
+	
+	return snapshotURL;
+}
+
+/**
+ * Writes a snapshot of the (non-persistent) view to options.snapshotURL.
+ * See the header file for a discussion.
+**/
+- (BOOL)writeSnapshot
+{
+	YDBLogAutoTrace();
+	
+	NSURL *snapshotURL = [self snapshotURL];
+	
+	if ([self isPersistentView] || snapshotURL == nil)
+	{
+		YDBLogWarn(@"%@ - Method only allowed for non-persistent views with a snapshotURL "
+		           @"(of an unencrypted database)", THIS_METHOD);
+		return NO;
+	}
+	
+	if (databaseTransaction->isReadWriteTransaction)
+	{
+		// The view may contain uncommitted changes,
+		// which wouldn't match the snapshot number we'd stamp the file with.
+		
+		YDBLogWarn(@"%@ - Method only allowed in readOnly transaction", THIS_METHOD);
+		return NO;
+	}
+	
+	NSMutableDictionary *snapshot = [[self snapshotStamp] mutableCopy];
+	NSMutableDictionary *groups = [NSMutableDictionary dictionaryWithCapacity:[parentConnection->state numberOfGroups]];
+	
+	[parentConnection->state enumerateGroupsWithBlock:^(NSString *group, BOOL __unused *stop) {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+		NSMutableArray *pages = [NSMutableArray arrayWithCapacity:[pagesMetadataForGroup count]];
+		
+		for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
+		{
+			if (pageMetadata->count == 0) continue;
+			
+			YapDatabaseViewPage *page = [self pageForPageKey:pageMetadata->pageKey];
+			[pages addObject:[self serializePage:page]];
+		}
+		
+		if ([pages count] > 0) {
+			groups[group] = pages;
+		}
+		
+	#pragma clang diagnostic pop
+	}];
+	
+	snapshot[snapshot_key_groups] = groups;
+	
+	NSData *data = [YapDatabaseBinaryCodec dataWithObject:snapshot];
+	
+	NSError *error = nil;
+	if (![data writeToURL:snapshotURL options:NSDataWritingAtomic error:&error])
+	{
+		YDBLogError(@"%@ (%@): Error writing snapshot to %@: %@",
+		            THIS_METHOD, [self registeredName], snapshotURL, error);
+		return NO;
+	}
+	
+	YDBLogVerbose(@"Wrote snapshot of view(%@) at snapshot(%@): %lu bytes",
+	              [self registeredName], snapshot[snapshot_key_snapshot], (unsigned long)[data length]);
+	
+	return YES;
+}
+
+/**
+ * Invoked (for non-persistent views) when the view is being created.
+ *
+ * Restores the view from options.snapshotURL, if the snapshot file exists,
+ * and it was written by this same view (class, classVersion, versionTag & registeredName)
+ * at the current snapshot of the database (i.e. nothing has been committed since).
+ *
+ * Returns NO (without modifying the view) if the view needs to be populated instead.
+**/
+- (BOOL)restoreFromSnapshot
+{
+	YDBLogAutoTrace();
+	
+	NSURL *snapshotURL = [self snapshotURL];
+	if (snapshotURL == nil) return NO;
+	
+	NSData *data = [NSData dataWithContentsOfURL:snapshotURL options:NSDataReadingMappedIfSafe error:NULL];
+	if (data == nil) return NO;
+	
+	// Only decode files written by the binary codec (never fall back to NSKeyedUnarchiver here)
+	
+	NSDictionary *snapshot = nil;
+	if ([YapDatabaseBinaryCodec isBinaryCodecData:data]) {
+		snapshot = [YapDatabaseBinaryCodec objectWithData:data];
+	}
+	
+	if (![snapshot isKindOfClass:[NSDictionary class]])
+	{
+		YDBLogWarn(@"%@ (%@): Ignoring malformed snapshot: %@", THIS_METHOD, [self registeredName], snapshotURL);
+		return NO;
+	}
+	
+	// Check the stamp
+	
+	NSDictionary *stamp = [self snapshotStamp];
+	
+	for (NSString *key in stamp)
+	{
+		if (![stamp[key] isEqual:snapshot[key]])
+		{
+			YDBLogInfo(@"%@ (%@): Ignoring stale snapshot (%@ mismatch)", THIS_METHOD, [self registeredName], key);
+			return NO;
+		}
+	}
+	
+	// Decode (and validate) all the pages before we modify anything
+	
+	NSDictionary *groups = snapshot[snapshot_key_groups];
+	if (![groups isKindOfClass:[NSDictionary class]]) return NO;
+	
+	NSMutableDictionary<NSString *, NSArray<YapDatabaseViewPage *> *> *groupPages =
+	  [NSMutableDictionary dictionaryWithCapacity:[groups count]];
+	
+	for (NSString *group in groups)
+	{
+		NSArray *pagesData = groups[group];
+		
+		if (![group isKindOfClass:[NSString class]] || ![pagesData isKindOfClass:[NSArray class]]) return NO;
+		
+		NSMutableArray<YapDatabaseViewPage *> *pages = [NSMutableArray arrayWithCapacity:[pagesData count]];
+		
+		for (NSData *pageData in pagesData)
+		{
+			if (![pageData isKindOfClass:[NSData class]]) return NO;
+			
+			YapDatabaseViewPage *page = [self deserializePage:pageData];
+			if ([page count] == 0)
+			{
+				YDBLogWarn(@"%@ (%@): Ignoring snapshot with a malformed page", THIS_METHOD, [self registeredName]);
+				return NO;
+			}
+			
+			[pages addObject:page];
+		}
+		
+		if ([pages count] > 0) {
+			groupPages[group] = pages;
+		}
+	}
+	
+	// Rebuild the state, pages & mappings.
+	// The memory tables are then written as usual (in flushPendingChangesToExtensionTables).
+	
+	__block NSUInteger rowCount = 0;
+	
+	[groupPages enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *group, NSArray<YapDatabaseViewPage *> *pages, BOOL __unused *stop)
+	{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		[parentConnection->state createGroup:group withCapacity:[pages count]];
+		
+		NSString *prevPageKey = nil;
+		
+		for (YapDatabaseViewPage *page in pages)
+		{
+			NSString *pageKey = [self generatePageKey];
+			
+			YapDatabaseViewPageMetadata *pageMetadata = [[YapDatabaseViewPageMetadata alloc] init];
+			pageMetadata->pageKey = pageKey;
+			pageMetadata->prevPageKey = prevPageKey;
+			pageMetadata->group = group;
+			pageMetadata->count = [page count];
+			pageMetadata->isNew = YES;
+			
+			[parentConnection->state addPageMetadata:pageMetadata toGroup:group];
+			
+			[page enumerateRowidsUsingBlock:^(int64_t rowid, NSUInteger __unused idx, BOOL __unused *innerStop) {
+				
+				[parentConnection->dirtyMaps setObject:pageKey forRowid:rowid withPreviousValue:nil];
+			}];
+			
+			[parentConnection->dirtyPages setObject:page forKey:pageKey];
+			[parentConnection->pageCache setObject:page forKey:pageKey];
+			
+			rowCount += [page count];
+			prevPageKey = pageKey;
+		}
+		
+	#pragma clang diagnostic pop
+	}];
+	
+	YDBLogVerbose(@"Restored view(%@) from snapshot: %lu groups, %lu rows",
+	              [self registeredName], (unsigned long)[groupPages count], (unsigned long)rowCount);
+	
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -702,6 +1156,62 @@
 	return [[NSUUID UUID] UUIDString];
 }
 
+/**
+ * Returns the in-memory rowid -> pageKey mapping, loading it from the map table if needed.
+ * Returns nil unless options.keepsRowidMapInMemory is set (for a persistent view).
+ *
+ * The mapping reflects the committed state of the view (dirtyMaps must be checked first),
+ * except after removeAllRowids, which clears it immediately.
+**/
+- (YapDatabaseViewRowidMap *)rowidMap
+{
+	if (parentConnection->rowidMap) return parentConnection->rowidMap;
+	
+	if (!parentConnection->parent->options.keepsRowidMapInMemory || ![self isPersistentView]) return nil;
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	NSString *query = [NSString stringWithFormat:@"SELECT \"rowid\", \"pageKey\" FROM \"%@\";", [self mapTableName]];
+	
+	sqlite3_stmt *statement;
+	int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ (%@): Error creating statement: %d %s",
+		            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+		return nil;
+	}
+	
+	int const column_idx_rowid   = SQLITE_COLUMN_START + 0;
+	int const column_idx_pageKey = SQLITE_COLUMN_START + 1;
+	
+	YapDatabaseViewRowidMap *rowidMap = [[YapDatabaseViewRowidMap alloc] init];
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_pageKey);
+		int textSize = sqlite3_column_bytes(statement, column_idx_pageKey);
+		
+		NSString *pageKey = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		[rowidMap setPageKey:pageKey forRowid:rowid]; // pageKey is interned (only the first copy is kept)
+	}
+	
+	sqlite3_finalize(statement);
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ (%@): Error executing statement: %d %s",
+		            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+		return nil;
+	}
+	
+	parentConnection->rowidMap = rowidMap;
+	return rowidMap;
+}
+
 /**
  * If the given rowid is in the view, returns the associated pageKey.
  *
@@ -715,7 +1225,7 @@
 	
 	// Check dirty cache & clean cache
 	
-	pageKey = [parentConnection->dirtyMaps objectForKey:rowidNumber];
+	pageKey = [parentConnection->dirtyMaps objectForRowid:rowid];
 	if (pageKey)
 	{
 		if ((id)pageKey == (id)[NSNull null])
@@ -724,6 +1234,12 @@
 			return pageKey;
 	}
 	
+	YapDatabaseViewRowidMap *rowidMap = [self rowidMap];
+	if (rowidMap)
+	{
+		return [rowidMap pageKeyForRowid:rowid];
+	}
+	
 	pageKey = [parentConnection->mapCache objectForKey:rowidNumber];
 	if (pageKey)
 	{
@@ -846,22 +1362,149 @@
 	return page;
 }
 
-- (NSUInteger)indexForRowid:(int64_t)rowid inGroup:(NSString *)group withPageKey:(NSString *)pageKey
+/**
+ * Loads the pages covering the given range of the group into the pageCache,
+ * along with the page before & the page after (readahead for scrolling in either direction).
+ *
+ * Pages that are already in memory are skipped, and the others are fetched with a single query.
+ * (Non-persistent views keep every page in memory, so there's nothing to read.)
+**/
+- (void)readaheadPagesForRange:(NSRange)range inGroup:(NSString *)group
 {
-	// Calculate the offset of the corresponding page within the group.
+	if (![self isPersistentView] || range.length == 0) return;
 	
-	NSUInteger pageOffset = 0;
-	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+	YapDatabaseViewState *state = parentConnection->state;
 	
-	for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
+	NSUInteger count = [state numberOfItemsInGroup:group];
+	if (range.location >= count) return;
+	
+	NSUInteger lastIndex = MIN(NSMaxRange(range), count) - 1;
+	
+	NSUInteger firstPageIndex = 0;
+	NSUInteger lastPageIndex = 0;
+	
+	[state pageMetadataForIndex:range.location inGroup:group pageOffset:NULL pageIndex:&firstPageIndex];
+	[state pageMetadataForIndex:lastIndex      inGroup:group pageOffset:NULL pageIndex:&lastPageIndex];
+	
+	if (firstPageIndex == NSNotFound || lastPageIndex == NSNotFound) return;
+	
+	NSArray *pagesMetadataForGroup = [state pagesMetadataForGroup:group];
+	
+	if (firstPageIndex > 0) firstPageIndex--;
+	if (lastPageIndex + 1 < pagesMetadataForGroup.count) lastPageIndex++;
+	
+	// Don't let the readahead evict more than half of the cache.
+	
+	NSUInteger maxPageCount = parentConnection->pageCache.countLimit / 2;
+	
+	NSMutableArray<NSString *> *pageKeys = [NSMutableArray arrayWithCapacity:(lastPageIndex - firstPageIndex + 1)];
+	
+	for (NSUInteger i = firstPageIndex; i <= lastPageIndex; i++)
 	{
-		if ([pageMetadata->pageKey isEqualToString:pageKey])
+		if (maxPageCount > 0 && pageKeys.count >= maxPageCount) break;
+		
+		YapDatabaseViewPageMetadata *pageMetadata = pagesMetadataForGroup[i];
+		NSString *pageKey = pageMetadata->pageKey;
+		
+		if ([parentConnection->dirtyPages objectForKey:pageKey]) continue;
+		if ([parentConnection->pageCache containsKey:pageKey]) continue;
+		
+		[pageKeys addObject:pageKey];
+	}
+	
+	if (pageKeys.count == 0) return;
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	// SELECT "pageKey", "data" FROM "pageTableName" WHERE "pageKey" IN (?, ?, ...);
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger offset = 0;
+	
+	while (offset < pageKeys.count)
+	{
+		NSUInteger batchCount = MIN(pageKeys.count - offset, maxHostParams);
+		
+		NSMutableString *query = [NSMutableString stringWithCapacity:(60 + (batchCount * 3))];
+		[query appendFormat:@"SELECT \"pageKey\", \"data\" FROM \"%@\" WHERE \"pageKey\" IN (", [self pageTableName]];
+		
+		for (NSUInteger i = 0; i < batchCount; i++)
 		{
-			break;
+			if (i == 0)
+				[query appendString:@"?"];
+			else
+				[query appendString:@", ?"];
 		}
 		
-		pageOffset += pageMetadata->count;
+		[query appendString:@");"];
+		
+		sqlite3_stmt *statement;
+		int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@ (%@): Error creating statement: %d %s",
+			            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+			return;
+		}
+		
+		int const column_idx_pageKey = SQLITE_COLUMN_START + 0;
+		int const column_idx_data    = SQLITE_COLUMN_START + 1;
+		
+		for (NSUInteger i = 0; i < batchCount; i++)
+		{
+			NSString *pageKey = pageKeys[offset + i];
+			
+			sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + i), [pageKey UTF8String], -1, SQLITE_TRANSIENT);
+		}
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			const unsigned char *text = sqlite3_column_text(statement, column_idx_pageKey);
+			int textSize = sqlite3_column_bytes(statement, column_idx_pageKey);
+			
+			NSString *pageKey = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+			
+			const void *blob = sqlite3_column_blob(statement, column_idx_data);
+			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
+			
+			NSData *data = [[NSData alloc] initWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
+			
+			[parentConnection->pageCache setObject:[self deserializePage:data] forKey:pageKey];
+		}
+		
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ (%@): Error executing statement: %d %s",
+			            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_finalize(statement);
+		
+		offset += batchCount;
 	}
+}
+
+/**
+ * Invokes readaheadPagesForRange:inGroup: with the smallest range covering the given indexes, for each group.
+**/
+- (void)readaheadPagesForIndexes:(NSDictionary<NSString *, NSIndexSet *> *)indexesByGroup
+{
+	[indexesByGroup enumerateKeysAndObjectsUsingBlock:^(NSString *group, NSIndexSet *indexes, BOOL __unused *stop) {
+		
+		if (indexes.count == 0) return;
+		
+		NSRange range = NSMakeRange(indexes.firstIndex, indexes.lastIndex - indexes.firstIndex + 1);
+		[self readaheadPagesForRange:range inGroup:group];
+	}];
+}
+
+- (NSUInteger)indexForRowid:(int64_t)rowid inGroup:(NSString *)group withPageKey:(NSString *)pageKey
+{
+	// Calculate the offset of the corresponding page within the group.
+	// This is O(log n) in the number of pages (see YapDatabaseViewState index).
+	
+	NSUInteger pageOffset = 0;
+	[parentConnection->state pageMetadataForPageKey:pageKey inGroup:group pageOffset:&pageOffset pageIndex:NULL];
 	
 	// Fetch the actual page (ordered array of rowid's)
 	
@@ -951,15 +1594,21 @@
 	//
 	// This is actually a requirement if the information is in dirtyMaps.
 	// If the info is in mapCache, then its just an optimization.
+	// If the rowidMap is loaded, then it has everything else.
+	
+	YapDatabaseViewRowidMap *rowidMap = [self rowidMap];
 	
 	for (NSNumber *rowidNumber in rowids)
 	{
 		NSString *pageKey = nil;
 		
-		pageKey = [parentConnection->dirtyMaps objectForKey:rowidNumber];
+		pageKey = [parentConnection->dirtyMaps objectForRowid:[rowidNumber longLongValue]];
 		if (pageKey == nil)
 		{
-			pageKey = [parentConnection->mapCache objectForKey:rowidNumber];
+			if (rowidMap)
+				pageKey = [rowidMap pageKeyForRowid:[rowidNumber longLongValue]] ?: (id)[NSNull null];
+			else
+				pageKey = [parentConnection->mapCache objectForKey:rowidNumber];
 		}
 		
 		if (pageKey)
@@ -1123,24 +1772,18 @@
 
 - (BOOL)getRowid:(int64_t *)rowidPtr atIndex:(NSUInteger)index inGroup:(NSString *)group
 {
-	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
 	NSUInteger pageOffset = 0;
+	YapDatabaseViewPageMetadata *pageMetadata =
+	  [parentConnection->state pageMetadataForIndex:index inGroup:group pageOffset:&pageOffset pageIndex:NULL];
 	
-	for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
+	if (pageMetadata)
 	{
-		if ((index < (pageOffset + pageMetadata->count)) && (pageMetadata->count > 0))
-		{
-			YapDatabaseViewPage *page = [self pageForPageKey:pageMetadata->pageKey];
-			
-			int64_t rowid = [page rowidAtIndex:(index - pageOffset)];
-			
-			if (rowidPtr) *rowidPtr = rowid;
-			return YES;
-		}
-		else
-		{
-			pageOffset += pageMetadata->count;
-		}
+		YapDatabaseViewPage *page = [self pageForPageKey:pageMetadata->pageKey];
+		
+		int64_t rowid = [page rowidAtIndex:(index - pageOffset)];
+		
+		if (rowidPtr) *rowidPtr = rowid;
+		return YES;
 	}
 	
 	if (rowidPtr) *rowidPtr = 0;
@@ -1246,7 +1889,7 @@
 		
 		// Mark map as dirty
 		
-		[parentConnection->dirtyMaps setObject:pageKey forKey:@(rowid) withPreviousValue:nil];
+		[parentConnection->dirtyMaps setObject:pageKey forRowid:rowid withPreviousValue:nil];
 		[parentConnection->mapCache setObject:pageKey forKey:@(rowid)];
 		
 		// Add change to log
@@ -1264,44 +1907,37 @@
 		NSUInteger pageOffset = 0;
 		NSUInteger pageIndex = 0;
 		
-		NSUInteger lastPageIndex = [pagesMetadataForGroup count] - 1;
-		
-		for (YapDatabaseViewPageMetadata *pm in pagesMetadataForGroup)
+		pageMetadata = [parentConnection->state pageMetadataForIndex:index
+		                                                     inGroup:group
+		                                                  pageOffset:&pageOffset
+		                                                   pageIndex:&pageIndex];
+		if (pageMetadata == nil)
 		{
 			// Edge case: key is being inserted at the very end
 			
-			if ((index < (pageOffset + pm->count)) || (pageIndex == lastPageIndex))
-			{
-				pageMetadata = pm;
-				break;
-			}
-			else if (index == (pageOffset + pm->count))
+			pageMetadata = [pagesMetadataForGroup lastObject];
+			pageOffset = [parentConnection->state numberOfItemsInGroup:group] - pageMetadata->count;
+		}
+		else if ((index == pageOffset) && (pageIndex > 0))
+		{
+			// Optimization:
+			// The insertion index is in-between two pages.
+			// So it could go at the end of the previous page, or the beginning of this page.
+			//
+			// We always place the key in this page, unless:
+			// - the previous page has room AND
+			// - this page is already full
+			//
+			// Related method: splitOversizedPage:
+			
+			NSUInteger maxPageSize = [self maxPageSizeForGroup:group];
+			
+			YapDatabaseViewPageMetadata *prevpm = [pagesMetadataForGroup objectAtIndex:(pageIndex-1)];
+			if ((prevpm->count < maxPageSize) && (pageMetadata->count >= maxPageSize))
 			{
-				// Optimization:
-				// The insertion index is in-between two pages.
-				// So it could go at the end of this page, or the beginning of the next page.
-				//
-				// We always place the key in the next page, unless:
-				// - this page has room AND
-				// - the next page is already full
-				//
-				// Related method: splitOversizedPage:
-				
-				NSUInteger maxPageSize = YAP_DATABASE_VIEW_MAX_PAGE_SIZE;
-				
-				if (pm->count < maxPageSize)
-				{
-					YapDatabaseViewPageMetadata *nextpm = [pagesMetadataForGroup objectAtIndex:(pageIndex+1)];
-					if (nextpm->count >= maxPageSize)
-					{
-						pageMetadata = pm;
-						break;
-					}
-				}
+				pageMetadata = prevpm;
+				pageOffset -= prevpm->count;
 			}
-			
-			pageIndex++;
-			pageOffset += pm->count;
 		}
 		
 		NSAssert(pageMetadata != nil, @"Missing pageMetadata in group(%@)", group);
@@ -1319,7 +1955,7 @@
 		
 		// Update pageMetadata (increment count)
 		
-		pageMetadata->count = [page count];
+		[parentConnection->state setCount:[page count] forPageMetadata:pageMetadata];
 		
 		// Mark page as dirty
 		
@@ -1328,7 +1964,7 @@
 		
 		// Mark map as dirty
 		
-		[parentConnection->dirtyMaps setObject:pageKey forKey:@(rowid)  withPreviousValue:nil];
+		[parentConnection->dirtyMaps setObject:pageKey forRowid:rowid withPreviousValue:nil];
 		[parentConnection->mapCache setObject:pageKey forKey:@(rowid)];
 		
 		// Add change to log
@@ -1345,8 +1981,10 @@
 		// However, we do want to avoid allowing a single page to grow infinitely large.
 		// So we use triggers to ensure pages don't get too big.
 		
-		NSUInteger trigger = YAP_DATABASE_VIEW_MAX_PAGE_SIZE * 32;
-		NSUInteger target = YAP_DATABASE_VIEW_MAX_PAGE_SIZE * 16;
+		NSUInteger maxPageSize = [self maxPageSizeForGroup:group];
+		
+		NSUInteger trigger = maxPageSize * 32;
+		NSUInteger target = maxPageSize * 16;
 		
 		if ([page count] > trigger)
 		{
@@ -1355,6 +1993,353 @@
 	}
 }
 
+/**
+ * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
+ * See the discussion for insertRowid:collectionKey:inGroup:atIndex:.
+ *
+ * Appends the given rowids (in order) to the end of the group.
+ * The rowids array must contain (collectionKeys.count) rowids, which must not already be in the view.
+ *
+ * This is designed for populating a view: if the group doesn't exist yet,
+ * the pages are built directly, already packed to the max page size,
+ * instead of growing (and splitting) pages one rowid at a time.
+**/
+- (void)appendRowids:(const int64_t *)rowids collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                                                    toGroup:(NSString *)group
+{
+	YDBLogAutoTrace();
+	
+	NSParameterAssert(group != nil);
+	
+	NSUInteger count = collectionKeys.count;
+	if (count == 0) return;
+	
+	NSParameterAssert(rowids != NULL);
+	
+	if ([parentConnection->state pagesMetadataForGroup:group] != nil)
+	{
+		// The group already exists, so use the regular code path.
+		
+		NSUInteger index = [self numberOfItemsInGroup:group];
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			[self insertRowid:rowids[i] collectionKey:collectionKeys[i] inGroup:group atIndex:(index + i)];
+		}
+		return;
+	}
+	
+	YDBLogVerbose(@"Appending %lu keys to new group(%@)", (unsigned long)count, group);
+	
+	// Spread the rowids evenly across as few pages as possible.
+	// This way there's no small trailing page (that cleanupPages would want to merge).
+	
+	NSUInteger maxPageSize = [self maxPageSizeForCount:count];
+	
+	NSUInteger pageCount = (count + maxPageSize - 1) / maxPageSize;
+	NSUInteger minPageSize = count / pageCount;
+	NSUInteger remainder = count % pageCount;
+	
+	[parentConnection->state createGroup:group withCapacity:pageCount];
+	
+	[parentConnection->changes addObject:
+	  [YapDatabaseViewSectionChange insertGroup:group]];
+	
+	NSString *prevPageKey = nil;
+	NSUInteger index = 0;
+	
+	for (NSUInteger pageIndex = 0; pageIndex < pageCount; pageIndex++)
+	{
+		NSUInteger pageSize = minPageSize + ((pageIndex < remainder) ? 1 : 0);
+		
+		NSString *pageKey = [self generatePageKey];
+		
+		// Create page (and mark map as dirty)
+		
+		YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] initWithCapacity:pageSize];
+		
+		for (NSUInteger i = index; i < (index + pageSize); i++)
+		{
+			int64_t rowid = rowids[i];
+			
+			[page addRowid:rowid];
+			[parentConnection->dirtyMaps setObject:pageKey forRowid:rowid withPreviousValue:nil];
+			
+			[parentConnection->changes addObject:
+			  [YapDatabaseViewRowChange insertCollectionKey:collectionKeys[i] inGroup:group atIndex:i]];
+		}
+		
+		// Create pageMetadata, and add it to state
+		
+		YapDatabaseViewPageMetadata *pageMetadata = [[YapDatabaseViewPageMetadata alloc] init];
+		pageMetadata->pageKey = pageKey;
+		pageMetadata->prevPageKey = prevPageKey;
+		pageMetadata->group = group;
+		pageMetadata->count = pageSize;
+		pageMetadata->isNew = YES;
+		
+		[parentConnection->state addPageMetadata:pageMetadata toGroup:group];
+		
+		// Mark page as dirty
+		
+		[parentConnection->dirtyPages setObject:page forKey:pageKey];
+		[parentConnection->pageCache setObject:page forKey:pageKey];
+		
+		prevPageKey = pageKey;
+		index += pageSize;
+	}
+	
+	[parentConnection->mutatedGroups addObject:group];
+}
+
+/**
+ * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
+ * See the discussion for insertRowid:collectionKey:inGroup:atIndex:.
+ *
+ * Inserts the given rowids (in order) into the group, with the first rowid placed at the given index.
+ * The rowids array must contain (collectionKeys.count) rowids, which must not already be in the view.
+ *
+ * The rowids are spliced into a single page (the page that contains the index),
+ * instead of being inserted (and having the page located) one rowid at a time.
+ * Oversized pages are split using the same triggers as insertRowid:collectionKey:inGroup:atIndex:.
+**/
+- (void)insertRowids:(const int64_t *)rowids collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                                                    inGroup:(NSString *)group
+                                                    atIndex:(NSUInteger)index
+{
+	YDBLogAutoTrace();
+	
+	NSParameterAssert(group != nil);
+	
+	NSUInteger count = collectionKeys.count;
+	if (count == 0) return;
+	
+	NSParameterAssert(rowids != NULL);
+	
+	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+	
+	if (pagesMetadataForGroup == nil)
+	{
+		// First objects added to group.
+		
+		NSAssert(index == 0, @"Index(%lu) out of bounds in new group(%@)", (unsigned long)index, group);
+		
+		[self appendRowids:rowids collectionKeys:collectionKeys toGroup:group];
+		return;
+	}
+	
+	NSUInteger pageOffset = 0;
+	YapDatabaseViewPageMetadata *pageMetadata =
+	  [parentConnection->state pageMetadataForIndex:index inGroup:group pageOffset:&pageOffset pageIndex:NULL];
+	
+	if (pageMetadata == nil)
+	{
+		// Edge case: keys are being inserted at the very end
+		
+		pageMetadata = [pagesMetadataForGroup lastObject];
+		pageOffset = [parentConnection->state numberOfItemsInGroup:group] - pageMetadata->count;
+	}
+	
+	NSAssert(pageMetadata != nil, @"Missing pageMetadata in group(%@)", group);
+	
+	NSString *pageKey = pageMetadata->pageKey;
+	YapDatabaseViewPage *page = [self pageForPageKey:pageKey];
+	
+	YDBLogVerbose(@"Inserting %lu keys in group(%@) at index(%lu) with page(%@) pageOffset(%lu)",
+	              (unsigned long)count, group, (unsigned long)index, pageKey, (unsigned long)(index - pageOffset));
+	
+	// Update page (splice rowids)
+	
+	[page insertRowids:rowids count:count atIndex:(index - pageOffset)];
+	
+	// Update pageMetadata (increment count)
+	
+	[parentConnection->state setCount:[page count] forPageMetadata:pageMetadata];
+	
+	// Mark page as dirty
+	
+	[parentConnection->dirtyPages setObject:page forKey:pageKey];
+	[parentConnection->pageCache setObject:page forKey:pageKey];
+	
+	// Mark map as dirty, and add changes to log
+	
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		int64_t rowid = rowids[i];
+		
+		[parentConnection->dirtyMaps setObject:pageKey forRowid:rowid withPreviousValue:nil];
+		[parentConnection->mapCache setObject:pageKey forKey:@(rowid)];
+		
+		[parentConnection->changes addObject:
+		  [YapDatabaseViewRowChange insertCollectionKey:collectionKeys[i] inGroup:group atIndex:(index + i)]];
+	}
+	
+	[parentConnection->mutatedGroups addObject:group];
+	
+	// See the discussion in insertRowid:collectionKey:inGroup:atIndex:
+	
+	NSUInteger maxPageSize = [self maxPageSizeForGroup:group];
+	
+	NSUInteger trigger = maxPageSize * 32;
+	NSUInteger target = maxPageSize * 16;
+	
+	if ([page count] > trigger)
+	{
+		[self splitOversizedPage:page withPageKey:pageKey toSize:target];
+	}
+}
+
+typedef struct {
+	int64_t rowid;
+	NSUInteger pageIndex;
+} YapDatabaseViewRowidPageIndex;
+
+static int YapDatabaseViewCompareRowidPageIndex(const void *a, const void *b)
+{
+	int64_t rowid1 = ((const YapDatabaseViewRowidPageIndex *)a)->rowid;
+	int64_t rowid2 = ((const YapDatabaseViewRowidPageIndex *)b)->rowid;
+	
+	return (rowid1 < rowid2) ? -1 : ((rowid1 > rowid2) ? 1 : 0);
+}
+
+/**
+ * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
+ * See the discussion for insertRowid:collectionKey:inGroup:atIndex:.
+ *
+ * Changes the order of the rowids within the group.
+ * The rowids array must contain (collectionKeys.count) rowids,
+ * which must be exactly the rowids that are currently in the group (in their new order).
+ *
+ * The pages of the group (and their sizes) are kept as is.
+ * A page is only rewritten if its contents changed,
+ * and only the rowids that moved to a different page are updated in the map.
+**/
+- (void)reorderRowids:(const int64_t *)rowids collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+                                                     inGroup:(NSString *)group
+{
+	YDBLogAutoTrace();
+	
+	NSParameterAssert(group != nil);
+	
+	NSUInteger count = collectionKeys.count;
+	if (count != [parentConnection->state numberOfItemsInGroup:group])
+	{
+		YDBLogError(@"%@ (%@): Rowids don't match the rowids in group(%@)", THIS_METHOD, [self registeredName], group);
+		return;
+	}
+	
+	if (count == 0) return;
+	
+	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+	NSUInteger pageCount = [pagesMetadataForGroup count];
+	
+	// Record the current page of every rowid (sorted by rowid, for a binary search)
+	
+	YapDatabaseViewRowidPageIndex *currentPages =
+	  (YapDatabaseViewRowidPageIndex *)malloc(sizeof(YapDatabaseViewRowidPageIndex) * count);
+	
+	__block NSUInteger currentIndex = 0;
+	
+	for (NSUInteger pageIndex = 0; pageIndex < pageCount; pageIndex++)
+	{
+		YapDatabaseViewPageMetadata *pageMetadata = [pagesMetadataForGroup objectAtIndex:pageIndex];
+		YapDatabaseViewPage *page = [self pageForPageKey:pageMetadata->pageKey];
+		
+		[page enumerateRowidsUsingBlock:^(int64_t rowid, NSUInteger __unused idx, BOOL *stop) {
+			
+			if (currentIndex == count) { *stop = YES; return; }
+			
+			currentPages[currentIndex].rowid = rowid;
+			currentPages[currentIndex].pageIndex = pageIndex;
+			currentIndex++;
+		}];
+	}
+	
+	qsort(currentPages, currentIndex, sizeof(YapDatabaseViewRowidPageIndex), YapDatabaseViewCompareRowidPageIndex);
+	
+	// Rewrite the pages whose contents changed
+	
+	BOOL changed = NO;
+	NSUInteger offset = 0;
+	
+	for (NSUInteger pageIndex = 0; pageIndex < pageCount; pageIndex++)
+	{
+		YapDatabaseViewPageMetadata *pageMetadata = [pagesMetadataForGroup objectAtIndex:pageIndex];
+		
+		NSString *pageKey = pageMetadata->pageKey;
+		YapDatabaseViewPage *page = [self pageForPageKey:pageKey];
+		
+		NSUInteger pageSize = [page count];
+		
+		BOOL pageChanged = NO;
+		for (NSUInteger i = 0; i < pageSize; i++)
+		{
+			if ([page rowidAtIndex:i] != rowids[offset + i])
+			{
+				pageChanged = YES;
+				break;
+			}
+		}
+		
+		if (pageChanged)
+		{
+			changed = YES;
+			
+			[page removeAllRowids];
+			
+			for (NSUInteger i = offset; i < (offset + pageSize); i++)
+			{
+				int64_t rowid = rowids[i];
+				[page addRowid:rowid];
+				
+				YapDatabaseViewRowidPageIndex key = { .rowid = rowid, .pageIndex = 0 };
+				YapDatabaseViewRowidPageIndex *current =
+				  bsearch(&key, currentPages, currentIndex, sizeof(YapDatabaseViewRowidPageIndex),
+				          YapDatabaseViewCompareRowidPageIndex);
+				
+				NSAssert(current != NULL, @"Rowid(%lld) isn't in group(%@)", rowid, group);
+				
+				if (current && current->pageIndex != pageIndex)
+				{
+					YapDatabaseViewPageMetadata *prevPageMetadata =
+					  [pagesMetadataForGroup objectAtIndex:current->pageIndex];
+					
+					[parentConnection->dirtyMaps setObject:pageKey forRowid:rowid withPreviousValue:prevPageMetadata->pageKey];
+					[parentConnection->mapCache setObject:pageKey forKey:@(rowid)];
+				}
+			}
+			
+			// Mark page as dirty
+			
+			[parentConnection->dirtyPages setObject:page forKey:pageKey];
+			[parentConnection->pageCache setObject:page forKey:pageKey];
+		}
+		
+		offset += pageSize;
+	}
+	
+	free(currentPages);
+	
+	if (!changed) return;
+	
+	YDBLogVerbose(@"Reordered %lu keys in group(%@)", (unsigned long)count, group);
+	
+	// Add changes to log:
+	// All the rows are removed, and then inserted in their new order.
+	// The changeset mechanism will consolidate these changes (into moves).
+	
+	[parentConnection->changes addObject:[YapDatabaseViewSectionChange resetGroup:group]];
+	[parentConnection->changes addObject:[YapDatabaseViewSectionChange insertGroup:group]];
+	
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[parentConnection->changes addObject:
+		  [YapDatabaseViewRowChange insertCollectionKey:collectionKeys[i] inGroup:group atIndex:i]];
+	}
+	
+	[parentConnection->mutatedGroups addObject:group];
+}
+
 /**
  * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
  * These structures are meant to be private, and knowledge of how they work shouldn't be required by subclasses.
@@ -1451,21 +2436,9 @@
 	
 	YapDatabaseViewPage *page = [self pageForPageKey:pageKey];
 	
-	YapDatabaseViewPageMetadata *pageMetadata = nil;
 	NSUInteger pageOffset = 0;
-	
-	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
-	
-	for (YapDatabaseViewPageMetadata *pm in pagesMetadataForGroup)
-	{
-		if ([pm->pageKey isEqualToString:pageKey])
-		{
-			pageMetadata = pm;
-			break;
-		}
-		
-		pageOffset += pm->count;
-	}
+	YapDatabaseViewPageMetadata *pageMetadata =
+	  [parentConnection->state pageMetadataForPageKey:pageKey inGroup:group pageOffset:&pageOffset pageIndex:NULL];
 	
 	NSAssert(pageMetadata != nil, @"Missing pageMetadata in group(%@) withPageKey(%@)", group, pageKey);
 	
@@ -1499,7 +2472,7 @@
 	
 	// Update page metadata (by decrementing count)
 	
-	pageMetadata->count = [page count];
+	[parentConnection->state setCount:[page count] forPageMetadata:pageMetadata];
 	
 	// Mark page as dirty
 	
@@ -1510,7 +2483,7 @@
 	
 	// Mark map as dirty
 	
-	[parentConnection->dirtyMaps setObject:[NSNull null] forKey:@(rowid) withPreviousValue:pageKey];
+	[parentConnection->dirtyMaps setObject:[NSNull null] forRowid:rowid withPreviousValue:pageKey];
 	[parentConnection->mapCache removeObjectForKey:@(rowid)];
 }
 
@@ -1566,6 +2539,103 @@
 	}
 }
 
+/**
+ * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
+ * See the discussion for insertRowid:collectionKey:inGroup:atIndex:.
+ *
+ * Removes the rowids located within the given range of the group.
+ *
+ * Each page that overlaps the range is modified only once (by removing a range from it),
+ * instead of the rowids being located & removed one at a time.
+ * The rowids must still exist in the database, as their collection/key is fetched for the changes.
+**/
+- (void)removeRowidsInRange:(NSRange)range inGroup:(NSString *)group
+{
+	YDBLogAutoTrace();
+	
+	NSParameterAssert(group != nil);
+	
+	if (range.length == 0) return;
+	
+	if (NSMaxRange(range) > [parentConnection->state numberOfItemsInGroup:group])
+	{
+		YDBLogError(@"%@ (%@): Range %@ is out of bounds in group(%@)",
+		            THIS_METHOD, [self registeredName], NSStringFromRange(range), group);
+		return;
+	}
+	
+	YDBLogVerbose(@"Removing range %@ from group(%@)", NSStringFromRange(range), group);
+	
+	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+	
+	int64_t *removedRowids = (int64_t *)malloc(sizeof(int64_t) * range.length);
+	NSUInteger removedCount = 0;
+	
+	NSUInteger pageOffset = 0;
+	
+	for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
+	{
+		NSUInteger pageCount = pageMetadata->count;
+		
+		if ((pageOffset + pageCount) <= range.location)
+		{
+			pageOffset += pageCount;
+			continue;
+		}
+		
+		if (pageOffset >= NSMaxRange(range)) break;
+		
+		NSUInteger start = MAX(range.location, pageOffset) - pageOffset;
+		NSUInteger end = MIN(NSMaxRange(range), pageOffset + pageCount) - pageOffset;
+		
+		NSString *pageKey = pageMetadata->pageKey;
+		YapDatabaseViewPage *page = [self pageForPageKey:pageKey];
+		
+		// Mark map as dirty
+		
+		for (NSUInteger i = start; i < end; i++)
+		{
+			int64_t rowid = [page rowidAtIndex:i];
+			removedRowids[removedCount++] = rowid;
+			
+			[parentConnection->dirtyMaps setObject:[NSNull null] forRowid:rowid withPreviousValue:pageKey];
+			[parentConnection->mapCache removeObjectForKey:@(rowid)];
+		}
+		
+		// Update page (by removing the range from array)
+		
+		[page removeRange:NSMakeRange(start, end - start)];
+		
+		// Update page metadata (by decrementing count)
+		
+		[parentConnection->state setCount:[page count] forPageMetadata:pageMetadata];
+		
+		// Mark page as dirty
+		
+		YDBLogVerbose(@"Dirty page(%@)", pageKey);
+		
+		[parentConnection->dirtyPages setObject:page forKey:pageKey];
+		[parentConnection->pageCache setObject:page forKey:pageKey];
+		
+		pageOffset += pageCount;
+	}
+	
+	// Add changes to log.
+	// The rows are deleted from last to first, so every change uses the original index of its row.
+	
+	for (NSUInteger i = removedCount; i > 0; i--)
+	{
+		YapCollectionKey *collectionKey = [databaseTransaction collectionKeyForRowid:removedRowids[i-1]];
+		
+		[parentConnection->changes addObject:
+		  [YapDatabaseViewRowChange deleteCollectionKey:collectionKey inGroup:group atIndex:(range.location + i - 1)]];
+	}
+	
+	free(removedRowids);
+	
+	[parentConnection->mutatedGroups addObject:group];
+}
+
 /**
  * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
  * These structures are meant to be private, and knowledge of how they work shouldn't be required by subclasses.
@@ -1593,7 +2663,7 @@
 			
 			[removedRowids addObject:@(rowid)];
 			
-			[parentConnection->dirtyMaps setObject:[NSNull null] forKey:@(rowid) withPreviousValue:pageMetadata->pageKey];
+			[parentConnection->dirtyMaps setObject:[NSNull null] forRowid:rowid withPreviousValue:pageMetadata->pageKey];
 			[parentConnection->mapCache removeObjectForKey:@(rowid)];
 			
 		#pragma clang diagnostic pop
@@ -1605,7 +2675,7 @@
 		
 		// Update page metadata (by clearing count)
 		
-		pageMetadata->count = 0;
+		[parentConnection->state setCount:0 forPageMetadata:pageMetadata];
 		
 		// Mark page as dirty
 		
@@ -1637,8 +2707,9 @@
 	{
 		sqlite3_stmt *mapStatement = [parentConnection mapTable_removeAllStatement];
 		sqlite3_stmt *pageStatement = [parentConnection pageTable_removeAllStatement];
+		sqlite3_stmt *groupStatement = [parentConnection groupTable_removeAllStatement];
 		
-		if (mapStatement == NULL || pageStatement == NULL)
+		if (mapStatement == NULL || pageStatement == NULL || groupStatement == NULL)
 			return;
 		
 		int status;
@@ -1667,8 +2738,21 @@
 			            status, sqlite3_errmsg(databaseTransaction->connection->db));
 		}
 		
+		// DELETE FROM 'groupTableName';
+		
+		YDBLogVerbose(@"DELETE FROM '%@';", [self groupTableName]);
+		
+		status = sqlite3_step(groupStatement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ (%@): Error in groupStatement: %d %s",
+			            THIS_METHOD, [self registeredName],
+			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		}
+		
 		sqlite3_reset(mapStatement);
 		sqlite3_reset(pageStatement);
+		sqlite3_reset(groupStatement);
 	}
 	else // if (isNonPersistentView)
 	{
@@ -1693,6 +2777,7 @@
 	
 	[parentConnection->mapCache removeAllObjects];
 	[parentConnection->pageCache removeAllObjects];
+	[parentConnection->rowidMap removeAllRowids];
 	
 	[parentConnection->dirtyMaps removeAllObjects];
 	[parentConnection->dirtyPages removeAllObjects];
@@ -1705,6 +2790,39 @@
 #pragma mark Cleanup & Commit
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Returns the max page size for the given group, according to the pageSizing & pageSize options.
+ * See -[YapDatabaseViewOptions pageSizing].
+**/
+- (NSUInteger)maxPageSizeForGroup:(NSString *)group
+{
+	return [self maxPageSizeForCount:[parentConnection->state numberOfItemsInGroup:group]];
+}
+
+/**
+ * Returns the max page size for a group with the given number of items.
+**/
+- (NSUInteger)maxPageSizeForCount:(NSUInteger)count
+{
+	YapDatabaseViewOptions *options = parentConnection->parent->options;
+	
+	NSUInteger pageSize = options.pageSize;
+	if (pageSize == 0)
+		pageSize = YAP_DATABASE_VIEW_MAX_PAGE_SIZE;
+	
+	if (options.pageSizing == YapDatabaseViewPageSizingAdaptive)
+	{
+		NSUInteger limit = pageSize * YAP_DATABASE_VIEW_ADAPTIVE_MAX_MULTIPLIER;
+		
+		while ((pageSize < limit) && (count > (pageSize * YAP_DATABASE_VIEW_ADAPTIVE_PAGES_PER_GROUP)))
+		{
+			pageSize *= 2;
+		}
+	}
+	
+	return pageSize;
+}
+
 - (void)splitOversizedPage:(YapDatabaseViewPage *)page withPageKey:(NSString *)pageKey toSize:(NSUInteger)maxPageSize
 {
 	YDBLogAutoTrace();
@@ -1714,15 +2832,8 @@
 	NSString *group = [parentConnection->state groupForPageKey:pageKey];
 	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
 	
-	YapDatabaseViewPageMetadata *pageMetadata;
-	for (YapDatabaseViewPageMetadata *pm in pagesMetadataForGroup)
-	{
-		if ([pm->pageKey isEqualToString:pageKey])
-		{
-			pageMetadata = pm;
-			break;
-		}
-	}
+	YapDatabaseViewPageMetadata *pageMetadata =
+	  [parentConnection->state pageMetadataForPageKey:pageKey inGroup:group pageOffset:NULL pageIndex:NULL];
 	
 	NSAssert(pageMetadata != nil, @"Missing pageMetadata in group(%@) withPageKey(%@)", group, pageKey);
 	
@@ -1760,8 +2871,8 @@
 				
 				// Update counts
 				
-				pageMetadata->count = [page count];
-				prevPageMetadata->count = [prevPage count];
+				[parentConnection->state setCount:[page count] forPageMetadata:pageMetadata];
+				[parentConnection->state setCount:[prevPage count] forPageMetadata:prevPageMetadata];
 				
 				// Mark prevPage as dirty.
 				// The page is already marked as dirty.
@@ -1775,7 +2886,7 @@
 				                               range:prevPageRange
 				                          usingBlock:^(int64_t rowid, NSUInteger __unused index, BOOL __unused *stop)
 				{
-					[self->parentConnection->dirtyMaps setObject:prevPageMetadata->pageKey forKey:@(rowid) withPreviousValue:pageMetadata->pageKey];
+					[self->parentConnection->dirtyMaps setObject:prevPageMetadata->pageKey forRowid:rowid withPreviousValue:pageMetadata->pageKey];
 					[self->parentConnection->mapCache setObject:prevPageMetadata->pageKey forKey:@(rowid)];
 				}];
 				
@@ -1808,8 +2919,8 @@
 				
 				// Update counts
 				
-				pageMetadata->count = [page count];
-				nextPageMetadata->count = [nextPage count];
+				[parentConnection->state setCount:[page count] forPageMetadata:pageMetadata];
+				[parentConnection->state setCount:[nextPage count] forPageMetadata:nextPageMetadata];
 				
 				// Mark nextPage as dirty.
 				// The page is already marked as dirty.
@@ -1823,7 +2934,7 @@
 				                               range:nextPageRange
 				                          usingBlock:^(int64_t rowid, NSUInteger __unused index, BOOL __unused *stop) {
 					
-					[self->parentConnection->dirtyMaps setObject:nextPageMetadata->pageKey forKey:@(rowid) withPreviousValue:pageMetadata->pageKey];
+					[self->parentConnection->dirtyMaps setObject:nextPageMetadata->pageKey forRowid:rowid withPreviousValue:pageMetadata->pageKey];
 					[self->parentConnection->mapCache setObject:nextPageMetadata->pageKey forKey:@(rowid)];
 				}];
 				
@@ -1873,8 +2984,8 @@
 		
 		// Update counts
 		
-		pageMetadata->count = [page count];
-		newPageMetadata->count = [newPage count];
+		[parentConnection->state setCount:[page count] forPageMetadata:pageMetadata];
+		[parentConnection->state setCount:[newPage count] forPageMetadata:newPageMetadata];
 		
 		// Mark newPage as dirty.
 		// The page is already marked as dirty.
@@ -1886,13 +2997,100 @@
 		
 		[newPage enumerateRowidsUsingBlock:^(int64_t rowid, NSUInteger __unused idx, BOOL __unused *stop) {
 			
-			[self->parentConnection->dirtyMaps setObject:newPageKey forKey:@(rowid) withPreviousValue:pageMetadata->pageKey];
+			[self->parentConnection->dirtyMaps setObject:newPageKey forRowid:rowid withPreviousValue:pageMetadata->pageKey];
 			[self->parentConnection->mapCache setObject:newPageKey forKey:@(rowid)];
 		}];
 		
 	} // end while (pageMetadata->count > maxPageSize)
 }
 
+/**
+ * Moves all the rowids of an undersized page into a neighboring page (if one has room).
+ * The page is then empty, and gets dropped by cleanupPages.
+ *
+ * This is how existing pages migrate to a bigger page size (see -[YapDatabaseViewOptions pageSizing]).
+**/
+- (void)mergeUndersizedPage:(YapDatabaseViewPage *)page withPageKey:(NSString *)pageKey toSize:(NSUInteger)maxPageSize
+{
+	YDBLogAutoTrace();
+	
+	NSString *group = [parentConnection->state groupForPageKey:pageKey];
+	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+	
+	NSUInteger pageIndex = NSNotFound;
+	YapDatabaseViewPageMetadata *pageMetadata =
+	  [parentConnection->state pageMetadataForPageKey:pageKey inGroup:group pageOffset:NULL pageIndex:&pageIndex];
+	
+	if (pageMetadata == nil) return;
+	
+	NSUInteger count = [page count];
+	
+	// Prefer the previous page (appending is cheaper), and fall back to the next page
+	
+	YapDatabaseViewPageMetadata *neighborMetadata = nil;
+	BOOL isPrevious = NO;
+	
+	if (pageIndex > 0)
+	{
+		YapDatabaseViewPageMetadata *pm = [pagesMetadataForGroup objectAtIndex:(pageIndex - 1)];
+		if ((pm->count + count) <= maxPageSize)
+		{
+			neighborMetadata = pm;
+			isPrevious = YES;
+		}
+	}
+	
+	if (neighborMetadata == nil && (pageIndex + 1) < [pagesMetadataForGroup count])
+	{
+		YapDatabaseViewPageMetadata *pm = [pagesMetadataForGroup objectAtIndex:(pageIndex + 1)];
+		if ((pm->count + count) <= maxPageSize)
+		{
+			neighborMetadata = pm;
+		}
+	}
+	
+	if (neighborMetadata == nil) return;
+	
+	YapDatabaseViewPage *neighborPage = [self pageForPageKey:neighborMetadata->pageKey];
+	
+	NSRange pageRange = NSMakeRange(0, count);
+	NSRange neighborRange;
+	
+	if (isPrevious)
+	{
+		neighborRange = NSMakeRange([neighborPage count], count); // end range
+		[neighborPage appendRange:pageRange ofPage:page];
+	}
+	else
+	{
+		neighborRange = NSMakeRange(0, count);                    // beginning range
+		[neighborPage prependRange:pageRange ofPage:page];
+	}
+	
+	[page removeRange:pageRange];
+	
+	// Update counts
+	
+	[parentConnection->state setCount:0 forPageMetadata:pageMetadata];
+	[parentConnection->state setCount:[neighborPage count] forPageMetadata:neighborMetadata];
+	
+	// Mark neighborPage as dirty.
+	// The page is already marked as dirty.
+	
+	[parentConnection->dirtyPages setObject:neighborPage forKey:neighborMetadata->pageKey];
+	[parentConnection->pageCache setObject:neighborPage forKey:neighborMetadata->pageKey];
+	
+	// Mark rowid mappings as dirty
+	
+	[neighborPage enumerateRowidsWithOptions:0
+	                                   range:neighborRange
+	                              usingBlock:^(int64_t rowid, NSUInteger __unused index, BOOL __unused *stop)
+	{
+		[self->parentConnection->dirtyMaps setObject:neighborMetadata->pageKey forRowid:rowid withPreviousValue:pageKey];
+		[self->parentConnection->mapCache setObject:neighborMetadata->pageKey forKey:@(rowid)];
+	}];
+}
+
 - (void)dropEmptyPage:(YapDatabaseViewPage __unused *)page withPageKey:(NSString *)pageKey
 {
 	YDBLogAutoTrace();
@@ -1969,7 +3167,8 @@
 	// Instead we wait til the transaction has completed
 	// and then we can perform all such cleanup in a single step.
 	
-	NSUInteger maxPageSize = YAP_DATABASE_VIEW_MAX_PAGE_SIZE;
+	// The max page size is per group (see -[YapDatabaseViewOptions pageSizing]).
+	// And existing pages migrate lazily: only the dirty pages are resized.
 	
 	// Get all the dirty pageMetadata objects.
 	// We snapshot the items so we can make modifications as we enumerate.
@@ -1984,6 +3183,10 @@
 	for (NSString *pageKey in pageKeys)
 	{
 		YapDatabaseViewPage *page = [parentConnection->dirtyPages objectForKey:pageKey];
+		if ((id)page == (id)[NSNull null]) continue;
+		
+		NSString *group = [parentConnection->state groupForPageKey:pageKey];
+		NSUInteger maxPageSize = [self maxPageSizeForGroup:group];
 		
 		if ([page count] > maxPageSize)
 		{
@@ -1998,6 +3201,23 @@
 	//
 	// Note: We do this after "expansion" to allow undersized pages to first accomodate overflow.
 	
+	for (NSString *pageKey in pageKeys)
+	{
+		YapDatabaseViewPage *page = [parentConnection->dirtyPages objectForKey:pageKey];
+		if ((id)page == (id)[NSNull null]) continue;
+		
+		NSUInteger count = [page count];
+		if (count == 0) continue;
+		
+		NSString *group = [parentConnection->state groupForPageKey:pageKey];
+		NSUInteger maxPageSize = [self maxPageSizeForGroup:group];
+		
+		if (count < (maxPageSize / 4))
+		{
+			[self mergeUndersizedPage:page withPageKey:pageKey toSize:maxPageSize];
+		}
+	}
+	
 	for (NSString *pageKey in pageKeys)
 	{
 		YapDatabaseViewPage *page = [parentConnection->dirtyPages objectForKey:pageKey];
@@ -2018,6 +3238,142 @@
  *
  * Remember, the changeset is requested immediately after this method is invoked.
 **/
+/**
+ * Returns the groupId for the given group (from the group table), inserting the group if needed.
+ *
+ * The cache is only valid for the duration of a single flush,
+ * as other connections may add & remove groups between our transactions.
+**/
+- (BOOL)getGroupId:(int64_t *)groupIdPtr forGroup:(NSString *)group cache:(NSMutableDictionary *)cache
+{
+	NSNumber *cachedGroupId = cache[group];
+	if (cachedGroupId)
+	{
+		*groupIdPtr = [cachedGroupId longLongValue];
+		return YES;
+	}
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	
+	sqlite3_stmt *statement = [parentConnection groupTable_getGroupIdForGroupStatement];
+	if (statement == NULL) return NO;
+	
+	BOOL found = NO;
+	int64_t groupId = 0;
+	
+	// SELECT "groupId" FROM "groupTableName" WHERE "group" = ?;
+	
+	int const column_idx_groupId = SQLITE_COLUMN_START;
+	int const bind_idx_group     = SQLITE_BIND_START;
+	
+	YapDatabaseString _group; MakeYapDatabaseString(&_group, group);
+	sqlite3_bind_text(statement, bind_idx_group, _group.str, _group.length, SQLITE_STATIC);
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		groupId = sqlite3_column_int64(statement, column_idx_groupId);
+		found = YES;
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ (%@): Error executing 'groupTable_getGroupIdForGroupStatement': %d %s",
+		            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	if (!found && (status == SQLITE_DONE))
+	{
+		// INSERT INTO "groupTableName" ("group") VALUES (?);
+		
+		statement = [parentConnection groupTable_insertGroupStatement];
+		if (statement)
+		{
+			YDBLogVerbose(@"INSERT INTO '%@' ('group') VALUES (?);\n"
+			              @" - group: %@", [self groupTableName], group);
+			
+			sqlite3_bind_text(statement, bind_idx_group, _group.str, _group.length, SQLITE_STATIC);
+			
+			status = sqlite3_step(statement);
+			if (status == SQLITE_DONE)
+			{
+				groupId = sqlite3_last_insert_rowid(db);
+				found = YES;
+			}
+			else
+			{
+				YDBLogError(@"%@ (%@): Error executing 'groupTable_insertGroupStatement': %d %s",
+				            THIS_METHOD, [self registeredName], status, sqlite3_errmsg(db));
+			}
+			
+			sqlite3_clear_bindings(statement);
+			sqlite3_reset(statement);
+		}
+	}
+	
+	FreeYapDatabaseString(&_group);
+	
+	if (found)
+	{
+		cache[group] = @(groupId);
+		*groupIdPtr = groupId;
+	}
+	
+	return found;
+}
+
+/**
+ * YapDatabaseExtensionTransaction subclass hook.
+ * Invoked (possibly concurrently with other extensions) right before flushPendingChangesToExtensionTables.
+ *
+ * Serializes the dirty pages ahead of the (serialized) sqlite writes.
+ * 
+ * The page cleanup can't happen here, as it may need to read neighboring pages from the database.
+ * But a page that's within the size limits is never a source of the cleanup, only a potential destination.
+ * That is, it can only gain rowids. So comparing the count (in flushPendingChangesToExtensionTables)
+ * tells us if the prepared data is still accurate.
+**/
+- (void)prepareChangesForExtensionTables
+{
+	YDBLogAutoTrace();
+	
+	if (![self isPersistentView]) return;
+	
+	NSUInteger dirtyCount = parentConnection->dirtyPages.count;
+	if (dirtyCount == 0) return;
+	
+	preparedPageData = [[NSMutableDictionary alloc] initWithCapacity:dirtyCount];
+	preparedPageCounts = [[NSMutableDictionary alloc] initWithCapacity:dirtyCount];
+	
+	[parentConnection->dirtyPages enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		__unsafe_unretained NSString *pageKey = (NSString *)key;
+		__unsafe_unretained YapDatabaseViewPage *page = (YapDatabaseViewPage *)obj;
+		
+		if ((id)page == (id)[NSNull null]) return;//from block
+		
+		NSUInteger count = [page count];
+		
+		NSString *group = [parentConnection->state groupForPageKey:pageKey];
+		NSUInteger maxPageSize = [self maxPageSizeForGroup:group];
+		
+		if ((count == 0) || (count > maxPageSize) || (count < (maxPageSize / 4)))
+		{
+			// The cleanup will split, merge or drop this page
+			return;//from block
+		}
+		
+		preparedPageData[pageKey] = [self serializePage:page];
+		preparedPageCounts[pageKey] = @(count);
+		
+	#pragma clang diagnostic pop
+	}];
+}
+
 - (void)flushPendingChangesToExtensionTables
 {
 	YDBLogAutoTrace();
@@ -2035,9 +3391,11 @@
 	
 	if ([self isPersistentView])
 	{
-		// Persistent View: Step 1 of 3
+		// Persistent View: Step 1 of 4
 		//
 		// Write dirty pages to table (along with associated dirty metadata)
+		
+		NSMutableDictionary<NSString *, NSNumber *> *groupIdCache = [[NSMutableDictionary alloc] init];
 	
 		[parentConnection->dirtyPages enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
 		#pragma clang diagnostic push
@@ -2059,16 +3417,10 @@
 			else
 			{
 				NSString *group = [parentConnection->state groupForPageKey:pageKey];
-				NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
-				
-				for (YapDatabaseViewPageMetadata *pm in pagesMetadataForGroup)
-				{
-					if ([pm->pageKey isEqualToString:pageKey])
-					{
-						pageMetadata = pm;
-						break;
-					}
-				}
+				pageMetadata = [parentConnection->state pageMetadataForPageKey:pageKey
+				                                                       inGroup:group
+				                                                    pageOffset:NULL
+				                                                     pageIndex:NULL];
 			}
 		
 			if (pageMetadata && pageMetadata->isNew)
@@ -2117,28 +3469,34 @@
 					return;//from block
 				}
 				
+				int64_t groupId = 0;
+				if (![self getGroupId:&groupId forGroup:pageMetadata->group cache:groupIdCache])
+				{
+					NSAssert(NO, @"Cannot get groupId! View will become corrupt!");
+					return;//from block
+				}
+				
 				// INSERT INTO "pageTableName"
-				//   ("pageKey", "group", "prevPageKey", "count", "data") VALUES (?, ?, ?, ?, ?);
+				//   ("pageKey", "groupId", "prevPageKey", "count", "data") VALUES (?, ?, ?, ?, ?);
 				
 				int const bind_idx_pageKey     = SQLITE_BIND_START + 0;
-				int const bind_idx_group       = SQLITE_BIND_START + 1;
+				int const bind_idx_groupId     = SQLITE_BIND_START + 1;
 				int const bind_idx_prevPageKey = SQLITE_BIND_START + 2;
 				int const bind_idx_count       = SQLITE_BIND_START + 3;
 				int const bind_idx_data        = SQLITE_BIND_START + 4;
 				
 				YDBLogVerbose(@"INSERT INTO '%@'"
-				              @" ('pageKey', 'group', 'prevPageKey', 'count', 'data') VALUES (?,?,?,?,?);\n"
+				              @" ('pageKey', 'groupId', 'prevPageKey', 'count', 'data') VALUES (?,?,?,?,?);\n"
 				              @" - pageKey   : %@\n"
-				              @" - group     : %@\n"
+				              @" - groupId   : %lld (%@)\n"
 				              @" - prePageKey: %@\n"
 				              @" - count     : %d", [self pageTableName], pageKey,
-				              pageMetadata->group, pageMetadata->prevPageKey, (int)pageMetadata->count);
+				              groupId, pageMetadata->group, pageMetadata->prevPageKey, (int)pageMetadata->count);
 				
 				YapDatabaseString _pageKey; MakeYapDatabaseString(&_pageKey, pageKey);
 				sqlite3_bind_text(statement, bind_idx_pageKey, _pageKey.str, _pageKey.length, SQLITE_STATIC);
 				
-				YapDatabaseString _group; MakeYapDatabaseString(&_group, pageMetadata->group);
-				sqlite3_bind_text(statement, bind_idx_group, _group.str, _group.length, SQLITE_STATIC);
+				sqlite3_bind_int64(statement, bind_idx_groupId, groupId);
 				
 				YapDatabaseString _prevPageKey; MakeYapDatabaseString(&_prevPageKey, pageMetadata->prevPageKey);
 				if (pageMetadata->prevPageKey) {
@@ -2148,7 +3506,7 @@
 				
 				sqlite3_bind_int(statement, bind_idx_count, (int)(pageMetadata->count));
 				
-				__attribute__((objc_precise_lifetime)) NSData *rawData = [self serializePage:page];
+				__attribute__((objc_precise_lifetime)) NSData *rawData = [self serializeDirtyPage:page withPageKey:pageKey];
 				sqlite3_bind_blob(statement, bind_idx_data, rawData.bytes, (int)rawData.length, SQLITE_STATIC);
 				
 				int status = sqlite3_step(statement);
@@ -2162,7 +3520,6 @@
 				sqlite3_clear_bindings(statement);
 				sqlite3_reset(statement);
 				FreeYapDatabaseString(&_prevPageKey);
-				FreeYapDatabaseString(&_group);
 				FreeYapDatabaseString(&_pageKey);
 			}
 			else if (hasDirtyLink)
@@ -2195,7 +3552,7 @@
 				
 				sqlite3_bind_int(statement, bind_idx_count, (int)(pageMetadata->count));
 				
-				__attribute__((objc_precise_lifetime)) NSData *rawData = [self serializePage:page];
+				__attribute__((objc_precise_lifetime)) NSData *rawData = [self serializeDirtyPage:page withPageKey:pageKey];
 				sqlite3_bind_blob(statement, bind_idx_data, rawData.bytes, (int)rawData.length, SQLITE_STATIC);
 				
 				YapDatabaseString _pageKey; MakeYapDatabaseString(&_pageKey, pageKey);
@@ -2235,7 +3592,7 @@
 				
 				sqlite3_bind_int(statement, bind_idx_count, (int)[page count]);
 				
-				__attribute__((objc_precise_lifetime)) NSData *rawData = [self serializePage:page];
+				__attribute__((objc_precise_lifetime)) NSData *rawData = [self serializeDirtyPage:page withPageKey:pageKey];
 				sqlite3_bind_blob(statement, bind_idx_data, rawData.bytes, (int)rawData.length, SQLITE_STATIC);
 				
 				YapDatabaseString _pageKey; MakeYapDatabaseString(&_pageKey, pageKey);
@@ -2257,7 +3614,7 @@
 		#pragma clang diagnostic pop
 		}];
 		
-		// Persistent View: Step 2 of 3
+		// Persistent View: Step 2 of 4
 		//
 		// Write dirty prevPageKey values to table (those not also associated with dirty pages).
 		// This happens when only the prevPageKey pointer is changed.
@@ -2317,15 +3674,14 @@
 		#pragma clang diagnostic pop
 		}];
 		
-		// Persistent View: Step 3 of 3
+		// Persistent View: Step 3 of 4
 		//
 		// Update the dirty rowid -> pageKey mappings.
 		
-		[parentConnection->dirtyMaps enumerateKeysAndObjectsUsingBlock:^(id rowIdObj, id pageKeyObj, BOOL *stop) {
+		[parentConnection->dirtyMaps enumerateRowidsAndObjectsUsingBlock:^(int64_t rowid, id pageKeyObj, BOOL *stop) {
 		#pragma clang diagnostic push
 		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 			
-			int64_t rowid = [(NSNumber *)rowIdObj longLongValue];
 			__unsafe_unretained NSString *pageKey = (NSString *)pageKeyObj;
 			
 			if ((id)pageKey == (id)[NSNull null])
@@ -2395,6 +3751,43 @@
 			
 		#pragma clang diagnostic pop
 		}];
+		
+		// Persistent View: Step 4 of 4
+		//
+		// Remove the group table rows for groups that were removed (as their last page was dropped).
+		//
+		// Note: mutatedGroups is also reset by the enumeration protection.
+		// A row that's left behind is harmless though, as it's simply reused if the group reappears.
+		
+		for (NSString *group in parentConnection->mutatedGroups)
+		{
+			if ([parentConnection->state pagesMetadataForGroup:group] != nil) continue;
+			
+			sqlite3_stmt *statement = [parentConnection groupTable_removeForGroupStatement];
+			if (statement == NULL) break;
+			
+			// DELETE FROM "groupTableName" WHERE "group" = ?;
+			
+			int const bind_idx_group = SQLITE_BIND_START;
+			
+			YDBLogVerbose(@"DELETE FROM '%@' WHERE 'group' = ?;\n"
+			              @" - group: %@", [self groupTableName], group);
+			
+			YapDatabaseString _group; MakeYapDatabaseString(&_group, group);
+			sqlite3_bind_text(statement, bind_idx_group, _group.str, _group.length, SQLITE_STATIC);
+			
+			int status = sqlite3_step(statement);
+			if (status != SQLITE_DONE)
+			{
+				YDBLogError(@"%@ (%@): Error executing statement[4]: %d %s",
+				            THIS_METHOD, [self registeredName],
+				            status, sqlite3_errmsg(databaseTransaction->connection->db));
+			}
+			
+			sqlite3_clear_bindings(statement);
+			sqlite3_reset(statement);
+			FreeYapDatabaseString(&_group);
+		}
 	}
 	else // if (isNonPersistentView)
 	{
@@ -2458,16 +3851,10 @@
 						if (pageMetadata == nil)
 						{
 							NSString *group = [parentConnection->state groupForPageKey:pageKey];
-							NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
-							
-							for (YapDatabaseViewPageMetadata *pm in pagesMetadataForGroup)
-							{
-								if ([pm->pageKey isEqualToString:pageKey])
-								{
-									pageMetadata = pm;
-									break;
-								}
-							}
+							pageMetadata = [parentConnection->state pageMetadataForPageKey:pageKey
+							                                                       inGroup:group
+							                                                    pageOffset:NULL
+							                                                     pageIndex:NULL];
 						}
 						
 						if (pageMetadata)
@@ -2510,9 +3897,9 @@
 			#pragma clang diagnostic push
 			#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 				
-				[parentConnection->dirtyMaps enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
+				[parentConnection->dirtyMaps enumerateRowidsAndObjectsUsingBlock:^(int64_t rowid, id obj, BOOL __unused *stop) {
 					
-					__unsafe_unretained NSNumber *rowidNumber = (NSNumber *)key;
+					NSNumber *rowidNumber = @(rowid);
 					__unsafe_unretained NSString *pageKey = (NSString *)obj;
 					
 					if ((id)pageKey == (id)[NSNull null])
@@ -2533,6 +3920,9 @@
 		[pageTableTransaction commit];
 		[pageMetadataTableTransaction commit];
 	}
+	
+	preparedPageData = nil;
+	preparedPageCounts = nil;
 }
 
 - (void)didCommitTransaction
@@ -2652,15 +4042,7 @@
 
 - (NSUInteger)numberOfItemsInGroup:(NSString *)group
 {
-	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
-	NSUInteger count = 0;
-	
-	for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
-	{
-		count += pageMetadata->count;
-	}
-	
-	return count;
+	return [parentConnection->state numberOfItemsInGroup:group];
 }
 
 - (NSUInteger)numberOfItemsInAllGroups
@@ -2842,17 +4224,7 @@
 			// Calculate the offset of the corresponding page within the group.
 			
 			NSUInteger pageOffset = 0;
-			NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
-			
-			for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
-			{
-				if ([pageMetadata->pageKey isEqualToString:pageKey])
-				{
-					break;
-				}
-				
-				pageOffset += pageMetadata->count;
-			}
+			[parentConnection->state pageMetadataForPageKey:pageKey inGroup:group pageOffset:&pageOffset pageIndex:NULL];
 			
 			// Fetch the actual page (ordered array of keys)
 			
@@ -3348,6 +4720,109 @@
 	return nil;
 }
 
+/**
+ * Performance boost.
+ *
+ * Enumerates the given range, fetching the collection/key (and object and/or metadata) in batches.
+ * Each batch of rowids is resolved with a single query (for the cache misses), rather than a query per row.
+ *
+ * Batching is only used in read-only transactions.
+ * In a read-write transaction the block may modify the rows that are still pending in the batch,
+ * so each row is fetched separately (right before the block is invoked).
+**/
+- (void)_enumerateRowsInGroup:(NSString *)group
+                  withOptions:(NSEnumerationOptions)options
+                        range:(NSRange)range
+                  withObjects:(BOOL)withObjects
+                     metadata:(BOOL)withMetadata
+                   usingBlock:(void (^)(YapCollectionKey *ck, id object, id metadata, NSUInteger index, BOOL *stop))block
+{
+	if (databaseTransaction->isReadWriteTransaction)
+	{
+		[self enumerateRowidsInGroup:group
+		                 withOptions:options
+		                       range:range
+		                  usingBlock:^(int64_t rowid, NSUInteger index, BOOL *stop)
+		{
+			YapCollectionKey *ck = nil;
+			id object = nil;
+			id metadata = nil;
+			
+			if (withObjects && withMetadata)
+				[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
+			else if (withObjects)
+				[self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
+			else
+				[self->databaseTransaction getCollectionKey:&ck metadata:&metadata forRowid:rowid];
+			
+			block(ck, object, metadata, index, stop);
+		}];
+		return;
+	}
+	
+	NSUInteger const batchSize = 50;
+	BOOL const reverse = ((options & NSEnumerationReverse) != 0);
+	
+	NSMutableArray<NSNumber *> *batch = [NSMutableArray arrayWithCapacity:MIN(range.length, batchSize)];
+	
+	__block NSUInteger batchFirstIndex = 0;
+	__block BOOL stop = NO;
+	
+	void (^processBatch)(void) = ^{
+		
+		NSArray *collectionKeys = nil;
+		NSArray *objects = nil;
+		NSArray *metadata = nil;
+		
+		[self->databaseTransaction getCollectionKeys:&collectionKeys
+		                                     objects:(withObjects ? &objects : NULL)
+		                                    metadata:(withMetadata ? &metadata : NULL)
+		                                   forRowids:batch];
+		
+		[batch removeAllObjects];
+		
+		NSUInteger count = collectionKeys.count;
+		for (NSUInteger i = 0; i < count && !stop; i++)
+		{
+			YapCollectionKey *ck = collectionKeys[i];
+			if ((id)ck == [NSNull null]) continue;
+			
+			id object = objects[i];
+			if (object == [NSNull null]) object = nil;
+			
+			id meta = metadata[i];
+			if (meta == [NSNull null]) meta = nil;
+			
+			// Range enumeration is contiguous, so the indexes of a batch are too.
+			NSUInteger index = reverse ? (batchFirstIndex - i) : (batchFirstIndex + i);
+			
+			block(ck, object, meta, index, &stop);
+		}
+	};
+	
+	[self enumerateRowidsInGroup:group
+	                 withOptions:options
+	                       range:range
+	                  usingBlock:^(int64_t rowid, NSUInteger index, BOOL *innerStop)
+	{
+		if (batch.count == 0) {
+			batchFirstIndex = index;
+		}
+		[batch addObject:@(rowid)];
+		
+		if (batch.count == batchSize)
+		{
+			processBatch();
+			if (stop) *innerStop = YES;
+		}
+	}];
+	
+	if (!stop && batch.count > 0)
+	{
+		processBatch();
+	}
+}
+
 /**
  * The following methods are similar to invoking the enumerateKeysInGroup:... methods,
  * and then fetching the metadata within your own block.
@@ -3396,15 +4871,13 @@
 {
 	if (block == NULL) return;
 	
-	[self enumerateRowidsInGroup:group
-	                 withOptions:options
-	                       range:range
-	                  usingBlock:^(int64_t rowid, NSUInteger index, BOOL *stop)
+	[self _enumerateRowsInGroup:group
+	                withOptions:options
+	                      range:range
+	                withObjects:NO
+	                   metadata:YES
+	                 usingBlock:^(YapCollectionKey *ck, id __unused object, id metadata, NSUInteger index, BOOL *stop)
 	{
-		YapCollectionKey *ck = nil;
-		id metadata = nil;
-		[self->databaseTransaction getCollectionKey:&ck metadata:&metadata forRowid:rowid];
-		
 		block(ck.collection, ck.key, metadata, index, stop);
 	}];
 }
@@ -3486,15 +4959,13 @@
 {
 	if (block == NULL) return;
 	
-	[self enumerateRowidsInGroup:group
-	                 withOptions:options
-	                       range:range
-	                  usingBlock:^(int64_t rowid, NSUInteger index, BOOL *stop)
+	[self _enumerateRowsInGroup:group
+	                withOptions:options
+	                      range:range
+	                withObjects:YES
+	                   metadata:NO
+	                 usingBlock:^(YapCollectionKey *ck, id object, id __unused metadata, NSUInteger index, BOOL *stop)
 	{
-		YapCollectionKey *ck = nil;
-		id object = nil;
-		[self->databaseTransaction getCollectionKey:&ck object:&object forRowid:rowid];
-		
 		block(ck.collection, ck.key, object, index, stop);
 	}];
 }
@@ -3578,16 +5049,13 @@
 {
 	if (block == NULL) return;
 	
-	[self enumerateRowidsInGroup:group
-	                 withOptions:options
-	                       range:range
-	                  usingBlock:^(int64_t rowid, NSUInteger index, BOOL *stop)
+	[self _enumerateRowsInGroup:group
+	                withOptions:options
+	                      range:range
+	                withObjects:YES
+	                   metadata:YES
+	                 usingBlock:^(YapCollectionKey *ck, id object, id metadata, NSUInteger index, BOOL *stop)
 	{
-		YapCollectionKey *ck = nil;
-		id object = nil;
-		id metadata = nil;
-		[self->databaseTransaction getCollectionKey:&ck object:&object metadata:&metadata forRowid:rowid];
-		
 		block(ck.collection, ck.key, object, metadata, index, stop);
 	}];
 }
@@ -3697,6 +5165,62 @@
 	return NO;
 }
 
+/**
+ * Loads the objects at the given indexPaths into the object cache, assuming the given mappings are being used.
+ *
+ * Every object that isn't already cached is fetched using a single query,
+ * so the subsequent objectAtIndexPath:withMappings: calls for these indexPaths are cache hits.
+ * Invalid indexPaths are ignored.
+**/
+- (void)prefetchObjectsAtIndexPaths:(NSArray<NSIndexPath *> *)indexPaths withMappings:(YapDatabaseViewMappings *)mappings
+{
+	if (mappings == nil) return;
+	
+	NSMutableArray<NSString *> *groups = [NSMutableArray arrayWithCapacity:indexPaths.count];
+	NSMutableArray<NSNumber *> *indexes = [NSMutableArray arrayWithCapacity:indexPaths.count];
+	
+	NSMutableDictionary<NSString *, NSMutableIndexSet *> *indexesByGroup = [NSMutableDictionary dictionary];
+	
+	for (NSIndexPath *indexPath in indexPaths)
+	{
+		NSUInteger section = [indexPath indexAtPosition:0];
+		NSUInteger row = [indexPath indexAtPosition:1];
+		
+		NSString *group = nil;
+		NSUInteger index = 0;
+		
+		if ([mappings getGroup:&group index:&index forRow:row inSection:section])
+		{
+			[groups addObject:group];
+			[indexes addObject:@(index)];
+			
+			NSMutableIndexSet *groupIndexes = indexesByGroup[group];
+			if (groupIndexes == nil)
+				indexesByGroup[group] = groupIndexes = [NSMutableIndexSet indexSet];
+			
+			[groupIndexes addIndex:index];
+		}
+	}
+	
+	// Load the pages (and their neighbors) with one query per group, rather than one page at a time.
+	
+	[self readaheadPagesForIndexes:indexesByGroup];
+	
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray arrayWithCapacity:indexes.count];
+	
+	for (NSUInteger i = 0; i < indexes.count; i++)
+	{
+		int64_t rowid = 0;
+		if ([self getRowid:&rowid atIndex:[indexes[i] unsignedIntegerValue] inGroup:groups[i]])
+		{
+			[rowids addObject:@(rowid)];
+		}
+	}
+	
+	NSArray *objects = nil;
+	[databaseTransaction getCollectionKeys:NULL objects:&objects metadata:NULL forRowids:rowids];
+}
+
 /**
  * Gets the key & collection at the given indexPath, assuming the given mappings are being used.
  * Returns NO if the indexPath is invalid, or the mappings aren't initialized.
@@ -0,0 +1,70 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseBlobStream.h"
+#import "YapCollectionKey.h"
+#import "sqlite3.h"
+
+@class YapDatabaseReadTransaction;
+@class YapDatabaseReadWriteTransaction;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Read streams are backed by either:
+ * - an open sqlite3_blob (with an optional offset, to skip a YapDatabaseCompressionAlgorithmNone header)
+ * - an NSData (for externally stored objects, which are memory mapped; or compressed objects, which are decompressed)
+**/
+@interface YapDatabaseBlobReadStream () {
+@public
+	__unsafe_unretained YapDatabaseReadTransaction *transaction;
+}
+
+- (instancetype)initWithTransaction:(YapDatabaseReadTransaction *)transaction
+                               blob:(sqlite3_blob *)blob
+                         baseOffset:(NSUInteger)baseOffset;
+
+- (instancetype)initWithTransaction:(YapDatabaseReadTransaction *)transaction
+                               data:(NSData *)data;
+
+/**
+ * Invoked by the transaction when it completes.
+ * Releases the sqlite3_blob handle (without notifying the transaction).
+**/
+- (void)invalidate;
+
+@end
+
+/**
+ * Write streams are always backed by an open sqlite3_blob
+ * (with an optional offset, to skip a YapDatabaseCompressionAlgorithmNone header).
+**/
+@interface YapDatabaseBlobWriteStream () {
+@public
+	__unsafe_unretained YapDatabaseReadWriteTransaction *transaction;
+	
+	YapCollectionKey *collectionKey;
+	int64_t rowid;
+	BOOL inserted;
+}
+
+- (instancetype)initWithTransaction:(YapDatabaseReadWriteTransaction *)transaction
+                               blob:(sqlite3_blob *)blob
+                         baseOffset:(NSUInteger)baseOffset
+                             length:(NSUInteger)length
+                      collectionKey:(YapCollectionKey *)collectionKey
+                              rowid:(int64_t)rowid
+                           inserted:(BOOL)inserted;
+
+/**
+ * Invoked by the transaction when it's rolled back.
+ * Releases the sqlite3_blob handle (without notifying the transaction).
+**/
+- (void)invalidate;
+
+/**
+ * Whether or not the full length has been written.
+**/
+- (BOOL)isComplete;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,34 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseCheckpointPolicy.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseCheckpointContext ()
+
+@property (nonatomic, assign, readwrite) NSUInteger walFrameCount;
+@property (nonatomic, assign, readwrite) NSUInteger checkpointedFrameCount;
+@property (nonatomic, assign, readwrite) uint64_t walApproximateFileSize;
+@property (nonatomic, assign, readwrite) unsigned long long aggressiveWALTruncationSize;
+@property (nonatomic, assign, readwrite) uint64_t snapshotLag;
+@property (nonatomic, assign, readwrite) double writeRate;
+@property (nonatomic, assign, readwrite) NSTimeInterval timeSinceLastCheckpoint;
+@property (nonatomic, assign, readwrite) BOOL lowPowerModeEnabled;
+
+@end
+
+@interface YapDatabaseCheckpointStatistics () {
+@public
+	NSUInteger evaluationCount;
+	NSUInteger skippedCount;
+	NSUInteger passiveCount;
+	NSUInteger fullCount;
+	NSUInteger restartCount;
+	NSUInteger truncateCount;
+	NSUInteger busyCount;
+	uint64_t checkpointedFrameCount;
+	YapDatabaseCheckpointMode lastMode;
+	NSUInteger lastWALFrameCount;
+}
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,72 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseCompressionPrivate.h"
+#import "sqlite3.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Objects in cold collections are eventually moved into a separate database file
+ * (see YapDatabaseOptions.coldCollections).
+ *
+ * The file has a single table, in which each moved object is stored under a unique id (ids are never reused).
+ * The row in the main database keeps a reference to it, which uses the same header as compressed rows:
+ *
+ * [0,1]   : magic (0xFA 0xDB)
+ * [2]     : YAP_COLD_STORAGE_ALGORITHM
+ * [3-6]   : zero
+ * [7-10]  : length of the stored object (uint32, little endian)
+ * [11-18] : id of the stored object (int64, little endian)
+ *
+ * The stored object is the data of the row as it was before being moved. So it may itself be compressed.
+ *
+ * References that are dropped (by removing or overwriting the row) are recorded in the yap_cold_garbage table,
+ * via triggers on the primary table. The stored objects are deleted after the commit,
+ * once every connection has moved past the commit.
+**/
+// YAP_COLD_STORAGE_ALGORITHM & YAP_COLD_STORAGE_ID_SIZE are defined in YapDatabaseCompressionPrivate.h (which validates the header).
+#define YAP_COLD_STORAGE_REFERENCE_SIZE (YAP_COMPRESSION_HEADER_SIZE + YAP_COLD_STORAGE_ID_SIZE)
+
+NS_INLINE BOOL YapDatabaseIsColdReference(const void *bytes, size_t length)
+{
+	const uint8_t *header = (const uint8_t *)bytes;
+	
+	return (length == YAP_COLD_STORAGE_REFERENCE_SIZE) &&
+	       YapDatabaseCompressionHasHeader(bytes, length) &&
+	       (header[2] == YAP_COLD_STORAGE_ALGORITHM);
+}
+
+/**
+ * Returns the reference to be stored in the row.
+ * Returns nil if the blob is too big to be moved (> UINT32_MAX).
+**/
+NSData *_Nullable YapDatabaseColdReferenceCreate(int64_t blobId, NSUInteger length);
+
+/**
+ * Returns the id & length from the given reference (which must pass YapDatabaseIsColdReference).
+**/
+int64_t YapDatabaseColdReferenceBlobId(const void *bytes);
+uint32_t YapDatabaseColdReferenceLength(const void *bytes);
+
+/**
+ * Configures a freshly opened cold storage file, creating its table if needed.
+ * The file is synced on every commit, so a stored object is durable before the row referencing it is committed.
+**/
+BOOL YapDatabaseColdStorageSetup(sqlite3 *coldDb, BOOL readOnly);
+
+/**
+ * Stores the given blobs within a single transaction, and returns their ids (in the same order).
+ * Returns nil if the transaction failed, in which case none of the blobs were stored.
+**/
+NSArray<NSNumber *> *_Nullable YapDatabaseColdStorageInsert(sqlite3 *coldDb, NSArray<NSData *> *blobs);
+
+/**
+ * Returns the stored blob with the given id, or nil if it doesn't exist.
+**/
+NSData *_Nullable YapDatabaseColdStorageRead(sqlite3 *coldDb, int64_t blobId);
+
+/**
+ * Deletes the stored blobs with the given ids (within a single transaction).
+**/
+void YapDatabaseColdStorageDelete(sqlite3 *coldDb, NSArray<NSNumber *> *blobIds);
+
+NS_ASSUME_NONNULL_END
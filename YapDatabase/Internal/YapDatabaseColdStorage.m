@@ -0,0 +1,221 @@
+#import "YapDatabaseColdStorage.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+NSData *YapDatabaseColdReferenceCreate(int64_t blobId, NSUInteger blobLength)
+{
+	if (blobLength > UINT32_MAX) return nil;
+	
+	NSMutableData *reference = [NSMutableData dataWithLength:YAP_COLD_STORAGE_REFERENCE_SIZE];
+	uint8_t *bytes = (uint8_t *)reference.mutableBytes;
+	
+	uint32_t length = (uint32_t)blobLength;
+	uint64_t uid = (uint64_t)blobId;
+	
+	bytes[0]  = YAP_COMPRESSION_MAGIC_0;
+	bytes[1]  = YAP_COMPRESSION_MAGIC_1;
+	bytes[2]  = YAP_COLD_STORAGE_ALGORITHM;
+	bytes[7]  = (uint8_t)(length);
+	bytes[8]  = (uint8_t)(length >> 8);
+	bytes[9]  = (uint8_t)(length >> 16);
+	bytes[10] = (uint8_t)(length >> 24);
+	
+	for (int i = 0; i < YAP_COLD_STORAGE_ID_SIZE; i++)
+	{
+		bytes[YAP_COMPRESSION_HEADER_SIZE + i] = (uint8_t)(uid >> (i * 8));
+	}
+	
+	return reference;
+}
+
+int64_t YapDatabaseColdReferenceBlobId(const void *bytes)
+{
+	const uint8_t *idBytes = (const uint8_t *)bytes + YAP_COMPRESSION_HEADER_SIZE;
+	uint64_t uid = 0;
+	
+	for (int i = 0; i < YAP_COLD_STORAGE_ID_SIZE; i++)
+	{
+		uid |= ((uint64_t)idBytes[i] << (i * 8));
+	}
+	
+	return (int64_t)uid;
+}
+
+uint32_t YapDatabaseColdReferenceLength(const void *bytes)
+{
+	const uint8_t *header = (const uint8_t *)bytes;
+	
+	return ((uint32_t)header[7])       |
+	       ((uint32_t)header[8]  << 8)  |
+	       ((uint32_t)header[9]  << 16) |
+	       ((uint32_t)header[10] << 24);
+}
+
+BOOL YapDatabaseColdStorageSetup(sqlite3 *coldDb, BOOL readOnly)
+{
+	// A read-only file is used as-is (the table exists if the file does).
+	
+	if (readOnly) return YES;
+	
+	// AUTOINCREMENT ensures the id of a deleted blob is never reused.
+	// Otherwise a reader (at an older snapshot of the main database) could be handed the wrong object.
+	
+	char *statements[] = {
+	
+		"PRAGMA journal_mode = WAL;",
+		"PRAGMA synchronous = FULL;",
+		
+		"CREATE TABLE IF NOT EXISTS \"yap_cold\""
+		" (\"id\" INTEGER PRIMARY KEY AUTOINCREMENT,"
+		"  \"data\" BLOB NOT NULL"
+		" );"
+	};
+	
+	for (size_t i = 0; i < (sizeof(statements) / sizeof(statements[0])); i++)
+	{
+		int status = sqlite3_exec(coldDb, statements[i], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed preparing cold storage: %d %s", status, sqlite3_errmsg(coldDb));
+			return NO;
+		}
+	}
+	
+	return YES;
+}
+
+NSArray<NSNumber *> *YapDatabaseColdStorageInsert(sqlite3 *coldDb, NSArray<NSData *> *blobs)
+{
+	sqlite3_stmt *statement = NULL;
+	char *stmt = "INSERT INTO \"yap_cold\" (\"data\") VALUES (?);";
+	
+	int status = sqlite3_prepare_v2(coldDb, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating cold storage insert statement: %d %s", status, sqlite3_errmsg(coldDb));
+		return nil;
+	}
+	
+	NSMutableArray<NSNumber *> *blobIds = [NSMutableArray arrayWithCapacity:blobs.count];
+	
+	status = sqlite3_exec(coldDb, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, NULL);
+	
+	for (NSData *blob in blobs)
+	{
+		if (status != SQLITE_OK) break;
+		
+		sqlite3_bind_blob(statement, 1, blob.bytes, (int)blob.length, SQLITE_STATIC);
+		
+		status = sqlite3_step(statement);
+		if (status == SQLITE_DONE)
+		{
+			[blobIds addObject:@(sqlite3_last_insert_rowid(coldDb))];
+			status = SQLITE_OK;
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+	}
+	
+	sqlite3_finalize(statement);
+	
+	if (status == SQLITE_OK) {
+		status = sqlite3_exec(coldDb, "COMMIT TRANSACTION;", NULL, NULL, NULL);
+	}
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error storing cold blobs: %d %s", status, sqlite3_errmsg(coldDb));
+		
+		sqlite3_exec(coldDb, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		return nil;
+	}
+	
+	return blobIds;
+}
+
+NSData *YapDatabaseColdStorageRead(sqlite3 *coldDb, int64_t blobId)
+{
+	sqlite3_stmt *statement = NULL;
+	char *stmt = "SELECT \"data\" FROM \"yap_cold\" WHERE \"id\" = ?;";
+	
+	int status = sqlite3_prepare_v2(coldDb, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating cold storage read statement: %d %s", status, sqlite3_errmsg(coldDb));
+		return nil;
+	}
+	
+	sqlite3_bind_int64(statement, 1, blobId);
+	
+	NSData *blob = nil;
+	
+	status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		const void *bytes = sqlite3_column_blob(statement, 0);
+		int length = sqlite3_column_bytes(statement, 0);
+		
+		blob = [NSData dataWithBytes:bytes length:length];
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error reading cold blob: %d %s", status, sqlite3_errmsg(coldDb));
+	}
+	
+	sqlite3_finalize(statement);
+	return blob;
+}
+
+void YapDatabaseColdStorageDelete(sqlite3 *coldDb, NSArray<NSNumber *> *blobIds)
+{
+	sqlite3_stmt *statement = NULL;
+	char *stmt = "DELETE FROM \"yap_cold\" WHERE \"id\" = ?;";
+	
+	int status = sqlite3_prepare_v2(coldDb, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating cold storage delete statement: %d %s", status, sqlite3_errmsg(coldDb));
+		return;
+	}
+	
+	sqlite3_exec(coldDb, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, NULL);
+	
+	for (NSNumber *blobId in blobIds)
+	{
+		sqlite3_bind_int64(statement, 1, [blobId longLongValue]);
+		
+		status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error deleting cold blob: %d %s", status, sqlite3_errmsg(coldDb));
+		}
+		
+		sqlite3_reset(statement);
+	}
+	
+	sqlite3_finalize(statement);
+	
+	status = sqlite3_exec(coldDb, "COMMIT TRANSACTION;", NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error committing cold blob deletions: %d %s", status, sqlite3_errmsg(coldDb));
+		
+		sqlite3_exec(coldDb, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+	}
+}
@@ -0,0 +1,107 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseCollectionArchive.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The file format of a collection archive (all integers are little endian):
+ *
+ * [0-7]   : magic ("YDBCOLAR")
+ * [8-11]  : version (uint32)
+ * [12-15] : flags (uint32)
+ * [16-19] : collection length (uint32)
+ * [20-..] : collection (utf8)
+ *
+ * Followed by the chunks, each of which is:
+ *
+ * [0-3]   : number of rows (uint32)
+ * [4-7]   : stored length (uint32)
+ * [8-11]  : raw length (uint32)
+ * [12-..] : payload (stored length bytes)
+ *
+ * If the archive is compressed, and the stored length differs from the raw length,
+ * the payload is compressed (zlib). Otherwise it's stored as-is.
+ * The archive ends with an empty chunk (all zeros), so a truncated archive is detected.
+ *
+ * The (raw) payload contains the rows, each of which is:
+ *
+ * [0-3]   : key length (uint32)
+ * [4-..]  : key (utf8)
+ * [0-3]   : object length (uint32)
+ * [4-..]  : serialized object
+ * [0]     : has metadata (uint8)
+ * [1-4]   : metadata length (uint32) (only if has metadata)
+ * [5-..]  : serialized metadata (only if has metadata)
+**/
+#define YAP_COLLECTION_ARCHIVE_VERSION         1
+#define YAP_COLLECTION_ARCHIVE_FLAG_COMPRESSED (1 << 0)
+
+/**
+ * Rows are buffered until the chunk reaches this (raw) size.
+**/
+#define YAP_COLLECTION_ARCHIVE_CHUNK_SIZE      (1024 * 1024)
+
+/**
+ * Writes an archive to a stream.
+ *
+ * If the stream isn't open yet, it's opened (and closed when finished).
+ * Streams that are already open are left open.
+**/
+@interface YapDatabaseCollectionArchiveWriter : NSObject
+
+- (instancetype)initWithStream:(NSOutputStream *)stream collection:(NSString *)collection compressed:(BOOL)compressed;
+
+/**
+ * Buffers the row, and writes a chunk whenever the buffer is full.
+ * Returns NO if the stream couldn't be written (see error).
+**/
+- (BOOL)appendRowWithKey:(NSString *)key
+             objectBytes:(const void *)objectBytes
+            objectLength:(NSUInteger)objectLength
+           metadataBytes:(nullable const void *)metadataBytes
+          metadataLength:(NSUInteger)metadataLength;
+
+/**
+ * Writes the last chunk & the end of the archive.
+ * Returns NO if the stream couldn't be written (see error).
+**/
+- (BOOL)finish;
+
+@property (nonatomic, assign, readonly) NSUInteger rowCount;
+@property (nonatomic, strong, readonly, nullable) NSError *error;
+
+@end
+
+/**
+ * Reads an archive from a stream, a chunk at a time.
+ *
+ * If the stream isn't open yet, it's opened (and closed once the end of the archive is reached).
+ * Streams that are already open are left open.
+**/
+@interface YapDatabaseCollectionArchiveReader : NSObject
+
+- (instancetype)initWithStream:(NSInputStream *)stream;
+
+/**
+ * Reads the header. Returns NO if the stream isn't a (supported) collection archive (see error).
+**/
+- (BOOL)readHeader;
+
+@property (nonatomic, copy, readonly, nullable) NSString *collection;
+@property (nonatomic, assign, readonly) BOOL isCompressed;
+
+/**
+ * Reads the next chunk, and invokes the block for each of its rows.
+ * The data objects point into the chunk, so they're only valid until the next chunk is read.
+ *
+ * Returns NO once the end of the archive has been reached, or if an error occurred (see error).
+**/
+- (BOOL)readChunkWithBlock:(void (NS_NOESCAPE ^)(NSString *key, NSData *serializedObject,
+                                                NSData *_Nullable serializedMetadata))block;
+
+@property (nonatomic, assign, readonly) NSUInteger rowCount;
+@property (nonatomic, strong, readonly, nullable) NSError *error;
+
+@end
+
+NS_ASSUME_NONNULL_END
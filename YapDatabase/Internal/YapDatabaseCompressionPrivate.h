@@ -0,0 +1,140 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseCompression.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Compressed rows are prefixed with the following header:
+ *
+ * [0,1]  : magic (0xFA 0xDB)
+ * [2]    : YapDatabaseCompressionAlgorithm
+ * [3-6]  : dictionary_id (uint32, little endian), or zero if no dictionary was used
+ * [7-10] : uncompressed length (uint32, little endian)
+ *
+ * Rows without a (valid) header are passed to the deserializer as-is (backwards compatibility).
+ * A serialized object that happens to begin with the magic bytes is stored with YapDatabaseCompressionAlgorithmNone,
+ * so the header is never ambiguous.
+ *
+ * The same header is used by references to externally stored objects (YapDatabaseExternalStorage.h)
+ * and to objects moved to cold storage (YapDatabaseColdStorage.h), each with its own algorithm value.
+**/
+#define YAP_COMPRESSION_HEADER_SIZE 11
+#define YAP_COMPRESSION_MAGIC_0     0xFA
+#define YAP_COMPRESSION_MAGIC_1     0xDB
+
+#define YAP_EXTERNAL_STORAGE_ALGORITHM 0xEB
+#define YAP_EXTERNAL_STORAGE_HASH_SIZE 32
+
+#define YAP_COLD_STORAGE_ALGORITHM     0xC0
+#define YAP_COLD_STORAGE_ID_SIZE       8
+
+/**
+ * Returns YES if the bytes start with a valid header.
+ *
+ * Compression (like external & cold storage) is enabled database-wide,
+ * so this is checked for rows that were written before it was enabled, and were never wrapped.
+ * Thus the magic bytes alone aren't enough. The rest of the header has to be consistent with the row:
+ *
+ * - None     : no dictionary, and the length matches the payload
+ * - Zlib     : the uncompressed length exceeds the payload (rows are only compressed if that shrinks them)
+ * - External : no dictionary, and the length of a reference
+ * - Cold     : no dictionary, and the length of a reference
+ *
+ * Rows that don't pass are read as-is.
+**/
+NS_INLINE BOOL YapDatabaseCompressionHasHeader(const void *bytes, size_t length)
+{
+	const uint8_t *header = (const uint8_t *)bytes;
+	
+	if ((length < YAP_COMPRESSION_HEADER_SIZE) ||
+	    (header[0] != YAP_COMPRESSION_MAGIC_0) ||
+	    (header[1] != YAP_COMPRESSION_MAGIC_1)) return NO;
+	
+	uint32_t dictionaryId = ((uint32_t)header[3])       |
+	                        ((uint32_t)header[4] << 8)  |
+	                        ((uint32_t)header[5] << 16) |
+	                        ((uint32_t)header[6] << 24);
+	
+	uint32_t uncompressedLength = ((uint32_t)header[7])       |
+	                              ((uint32_t)header[8]  << 8)  |
+	                              ((uint32_t)header[9]  << 16) |
+	                              ((uint32_t)header[10] << 24);
+	
+	size_t payloadLength = length - YAP_COMPRESSION_HEADER_SIZE;
+	
+	switch (header[2])
+	{
+		case YapDatabaseCompressionAlgorithmNone:
+			return (dictionaryId == 0) && (uncompressedLength == payloadLength);
+		
+		case YapDatabaseCompressionAlgorithmZlib:
+			return (uncompressedLength > payloadLength);
+		
+		case YAP_EXTERNAL_STORAGE_ALGORITHM:
+			return (dictionaryId == 0) && (payloadLength == YAP_EXTERNAL_STORAGE_HASH_SIZE);
+		
+		case YAP_COLD_STORAGE_ALGORITHM:
+			return (dictionaryId == 0) && (payloadLength == YAP_COLD_STORAGE_ID_SIZE);
+		
+		default:
+			return NO;
+	}
+}
+
+/**
+ * Parses the header. Returns NO if the bytes don't start with a (valid) header.
+**/
+BOOL YapDatabaseCompressionReadHeader(const void *bytes, size_t length,
+                                      YapDatabaseCompressionAlgorithm *algorithmPtr,
+                                      uint32_t *dictionaryIdPtr,
+                                      uint32_t *uncompressedLengthPtr);
+
+/**
+ * Compresses the serialized object according to the given config.
+ *
+ * Returns nil if the data shouldn't be compressed
+ * (e.g. it's below the config's minimumLength, or compression didn't shrink it).
+**/
+NSData *_Nullable YapDatabaseCompressData(NSData *data,
+                                          YapDatabaseCompressionConfig *config,
+                                          uint32_t dictionaryId,
+                                          NSData *_Nullable dictionary);
+
+/**
+ * Prefixes the data with a YapDatabaseCompressionAlgorithmNone header.
+**/
+NSData *YapDatabaseCompressionWrapData(NSData *data);
+
+/**
+ * Decompresses the given row (which must start with a header).
+ *
+ * The returned pointer is either into the given bytes, or into a buffer owned by the current thread.
+ * Either way, it's only valid until the next call (on the same thread), or until the given bytes become invalid.
+ * This mirrors the lifetime of the sqlite column buffer, so the result may be passed to a deserializer,
+ * but must be copied if it needs to stick around.
+ *
+ * Returns NULL if the row cannot be decompressed (e.g. corrupt, or the wrong dictionary).
+**/
+const void *_Nullable YapDatabaseDecompressBytes(const void *bytes, size_t length,
+                                                 NSData *_Nullable dictionary,
+                                                 size_t *decompressedLengthPtr);
+
+/**
+ * Builds a preset dictionary from the given (uncompressed) samples.
+ *
+ * The dictionary is assembled from the segments of the samples that contain the largest number of
+ * substrings that are shared across samples. The most valuable segments are placed at the end,
+ * as deflate encodes nearby matches more cheaply.
+ *
+ * Returns nil if there wasn't enough shared content to build a dictionary.
+**/
+NSData *_Nullable YapDatabaseTrainCompressionDictionary(NSArray<NSData *> *samples, NSUInteger dictionarySize);
+
+/**
+ * Returns the total size of the samples after compression (used to decide whether a trained dictionary is an improvement).
+**/
+NSUInteger YapDatabaseCompressedLengthOfSamples(NSArray<NSData *> *samples,
+                                                YapDatabaseCompressionConfig *config,
+                                                NSData *_Nullable dictionary);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,17 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseCursor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseCursor () {
+@public
+	
+	int64_t lastRowid;
+	NSString *lastKey;
+	
+	BOOL isExhausted;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,59 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseCompressionPrivate.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Large serialized objects may be stored in external files (see YapDatabaseOptions.externalStorageThresholds).
+ *
+ * The files are content-addressed (named after the SHA-256 of their contents),
+ * and the row stores a reference to the file, which uses the same header as compressed rows:
+ *
+ * [0,1]   : magic (0xFA 0xDB)
+ * [2]     : YAP_EXTERNAL_STORAGE_ALGORITHM
+ * [3-6]   : zero
+ * [7-10]  : length of the file (uint32, little endian)
+ * [11-42] : SHA-256 of the file
+ *
+ * Since the header is shared, a serialized object that happens to begin with the magic bytes is wrapped,
+ * exactly as it is with compression, so a reference is never ambiguous.
+ *
+ * The number of rows referencing each file is tracked (via triggers on the primary table)
+ * in the yap_external_blobs table. Files that are no longer referenced are deleted after the commit,
+ * once every connection has moved past the commit.
+**/
+// YAP_EXTERNAL_STORAGE_ALGORITHM & YAP_EXTERNAL_STORAGE_HASH_SIZE are defined in YapDatabaseCompressionPrivate.h (which validates the header).
+#define YAP_EXTERNAL_STORAGE_REFERENCE_SIZE (YAP_COMPRESSION_HEADER_SIZE + YAP_EXTERNAL_STORAGE_HASH_SIZE)
+
+NS_INLINE BOOL YapDatabaseIsExternalReference(const void *bytes, size_t length)
+{
+	const uint8_t *header = (const uint8_t *)bytes;
+	
+	return (length == YAP_EXTERNAL_STORAGE_REFERENCE_SIZE) &&
+	       YapDatabaseCompressionHasHeader(bytes, length) &&
+	       (header[2] == YAP_EXTERNAL_STORAGE_ALGORITHM);
+}
+
+/**
+ * Hashes the given blob, and returns the reference to be stored in the row.
+ * The name of the file (the hex encoded hash) is returned via fileNamePtr.
+ *
+ * Returns nil if the blob is too big to be externalized (> UINT32_MAX).
+**/
+NSData *_Nullable YapDatabaseExternalReferenceCreate(NSData *blob, NSString *_Nullable *_Nonnull fileNamePtr);
+
+/**
+ * Returns the file name & length from the given reference (which must pass YapDatabaseIsExternalReference).
+**/
+NSString *YapDatabaseExternalReferenceFileName(const void *bytes);
+uint32_t YapDatabaseExternalReferenceLength(const void *bytes);
+
+/**
+ * Writes the blob to the given path.
+ *
+ * The blob is written to a temporary file, which is synced to disk before being (atomically) renamed.
+ * This ensures the file is durable before the transaction that references it is committed.
+**/
+BOOL YapDatabaseExternalBlobWrite(NSString *path, NSData *blob);
+
+NS_ASSUME_NONNULL_END
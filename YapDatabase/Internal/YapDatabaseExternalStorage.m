@@ -0,0 +1,130 @@
+#import "YapDatabaseExternalStorage.h"
+#import "YapDatabaseLogging.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+_Static_assert(YAP_EXTERNAL_STORAGE_HASH_SIZE == CC_SHA256_DIGEST_LENGTH, "Unexpected hash size");
+
+
+NSData *YapDatabaseExternalReferenceCreate(NSData *blob, NSString **fileNamePtr)
+{
+	*fileNamePtr = nil;
+	if (blob.length > UINT32_MAX) return nil;
+	
+	NSMutableData *reference = [NSMutableData dataWithLength:YAP_EXTERNAL_STORAGE_REFERENCE_SIZE];
+	uint8_t *bytes = (uint8_t *)reference.mutableBytes;
+	
+	uint32_t length = (uint32_t)blob.length;
+	
+	bytes[0]  = YAP_COMPRESSION_MAGIC_0;
+	bytes[1]  = YAP_COMPRESSION_MAGIC_1;
+	bytes[2]  = YAP_EXTERNAL_STORAGE_ALGORITHM;
+	bytes[7]  = (uint8_t)(length);
+	bytes[8]  = (uint8_t)(length >> 8);
+	bytes[9]  = (uint8_t)(length >> 16);
+	bytes[10] = (uint8_t)(length >> 24);
+	
+	CC_SHA256(blob.bytes, (CC_LONG)blob.length, bytes + YAP_COMPRESSION_HEADER_SIZE);
+	
+	*fileNamePtr = YapDatabaseExternalReferenceFileName(bytes);
+	return reference;
+}
+
+NSString *YapDatabaseExternalReferenceFileName(const void *bytes)
+{
+	// Uppercase, to match the output of sqlite's hex() function.
+	
+	static const char digits[] = "0123456789ABCDEF";
+	
+	const uint8_t *hash = (const uint8_t *)bytes + YAP_COMPRESSION_HEADER_SIZE;
+	char name[(YAP_EXTERNAL_STORAGE_HASH_SIZE * 2) + 1];
+	
+	for (int i = 0; i < YAP_EXTERNAL_STORAGE_HASH_SIZE; i++)
+	{
+		name[(i * 2) + 0] = digits[hash[i] >> 4];
+		name[(i * 2) + 1] = digits[hash[i] & 0x0F];
+	}
+	name[YAP_EXTERNAL_STORAGE_HASH_SIZE * 2] = '\0';
+	
+	return [[NSString alloc] initWithUTF8String:name];
+}
+
+uint32_t YapDatabaseExternalReferenceLength(const void *bytes)
+{
+	const uint8_t *header = (const uint8_t *)bytes;
+	
+	return ((uint32_t)header[7])       |
+	       ((uint32_t)header[8]  << 8)  |
+	       ((uint32_t)header[9]  << 16) |
+	       ((uint32_t)header[10] << 24);
+}
+
+BOOL YapDatabaseExternalBlobWrite(NSString *path, NSData *blob)
+{
+	NSString *tmpPath = [path stringByAppendingPathExtension:@"tmp"];
+	
+	int fd = open([tmpPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		YDBLogError(@"Unable to create external blob: %@ (errno: %d)", tmpPath, errno);
+		return NO;
+	}
+	
+	BOOL result = YES;
+	
+	const uint8_t *bytes = (const uint8_t *)blob.bytes;
+	size_t remaining = blob.length;
+	
+	while (remaining > 0)
+	{
+		ssize_t written = write(fd, bytes, remaining);
+		if (written < 0)
+		{
+			if (errno == EINTR) continue;
+			
+			YDBLogError(@"Unable to write external blob: %@ (errno: %d)", tmpPath, errno);
+			result = NO;
+			break;
+		}
+		
+		bytes += written;
+		remaining -= (size_t)written;
+	}
+	
+	if (result && fsync(fd) != 0)
+	{
+		YDBLogError(@"Unable to sync external blob: %@ (errno: %d)", tmpPath, errno);
+		result = NO;
+	}
+	
+	close(fd);
+	
+	if (result && rename([tmpPath fileSystemRepresentation], [path fileSystemRepresentation]) != 0)
+	{
+		YDBLogError(@"Unable to rename external blob: %@ (errno: %d)", path, errno);
+		result = NO;
+	}
+	
+	if (!result) {
+		unlink([tmpPath fileSystemRepresentation]);
+	}
+	
+	return result;
+}
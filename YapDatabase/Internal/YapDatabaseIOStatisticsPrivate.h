@@ -0,0 +1,16 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseIOStatistics.h"
+#import "yap_vfs_shim.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseIOStatistics ()
+
+/**
+ * The given array is indexed by yap_file_kind (which matches YapDatabaseIOFile).
+**/
+- (instancetype)initWithFileStats:(const yap_io_file_stats *)fileStats;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,61 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseIncrementalBackup.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The file format of an incremental backup (all integers are little endian):
+ *
+ * [0-7]   : magic ("YDBINCBK")
+ * [8-11]  : version (uint32)
+ * [12-15] : flags (uint32)
+ * [16-19] : page size (uint32)
+ * [20-23] : database page count (uint32)
+ * [24-27] : number of page records (uint32)
+ * [28-31] : zero
+ * [32-47] : backupId (uuid)
+ * [48-63] : parentBackupId (uuid, zero for a full backup)
+ *
+ * Followed by the page records, each of which is:
+ *
+ * [0-3]   : page number (uint32)
+ * [4-...] : page data (page size bytes)
+**/
+#define YAP_INCREMENTAL_BACKUP_HEADER_SIZE 64
+#define YAP_INCREMENTAL_BACKUP_VERSION     1
+#define YAP_INCREMENTAL_BACKUP_FLAG_FULL   (1 << 0)
+
+@interface YapDatabaseIncrementalBackup ()
+
+- (instancetype)initWithPath:(NSString *)path
+                    backupId:(NSUUID *)backupId
+              parentBackupId:(nullable NSUUID *)parentBackupId
+                    pageSize:(NSUInteger)pageSize
+           databasePageCount:(NSUInteger)databasePageCount
+                   pageCount:(NSUInteger)pageCount;
+
+@end
+
+/**
+ * Creates a temporary file (next to the given path), and reserves space for the header.
+ * Returns the file descriptor, or -1 if the file couldn't be created.
+**/
+int YapDatabaseIncrementalBackupCreate(NSString *path);
+
+/**
+ * Appends a page record.
+**/
+BOOL YapDatabaseIncrementalBackupWritePage(int fd, uint32_t pgno, const void *page, uint32_t pageSize);
+
+/**
+ * Writes the header, syncs the file to disk, and (atomically) renames it to backup.path.
+ * The file descriptor is closed, and the temporary file is removed if anything fails.
+**/
+BOOL YapDatabaseIncrementalBackupFinish(int fd, YapDatabaseIncrementalBackup *backup);
+
+/**
+ * Closes the file descriptor, and removes the temporary file.
+**/
+void YapDatabaseIncrementalBackupAbort(int fd, NSString *path);
+
+NS_ASSUME_NONNULL_END
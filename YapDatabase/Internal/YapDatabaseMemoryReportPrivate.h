@@ -0,0 +1,48 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseMemoryReport.h"
+#import "sqlite3.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseMemoryReport ()
+
+- (instancetype)initWithComponents:(NSDictionary<NSString *, NSNumber *> *)components;
+
+/**
+ * Sums the given reports (component by component).
+**/
++ (YapDatabaseMemoryReport *)reportByMergingReports:(NSArray<YapDatabaseMemoryReport *> *)reports;
+
+@end
+
+/**
+ * A single memory holder within a connection (e.g. the objectCache, or a view's pageCache).
+ * Used by -[YapDatabaseConnection flushMemoryWithFlags:targetBytes:] to flush the most expensive holders first.
+**/
+@interface YapDatabaseMemoryHolder : NSObject {
+@public
+	
+	NSString *component;
+	NSString *_Nullable extensionName; // nil for holders owned by the connection itself
+	
+	uint64_t bytes;
+	NSUInteger flushFlags;             // YapDatabaseConnectionFlushMemoryFlags, or zero if not flushable
+}
+@end
+
+/**
+ * Returns the estimated heap footprint of the given object.
+ *
+ * This is the malloc size of the object itself,
+ * plus the length of the contents for NSData & NSString (which are often stored in a separate buffer).
+ * Tagged pointers (and nil) have a size of zero.
+**/
+uint64_t YapDatabaseEstimatedObjectSize(id _Nullable object);
+
+/**
+ * Returns the memory used by the given prepared statement (via SQLITE_STMTSTATUS_MEMUSED),
+ * or zero if the statement is NULL, or if the linked version of sqlite doesn't support it.
+**/
+uint64_t YapDatabaseStatementMemoryUsed(sqlite3_stmt *_Nullable statement);
+
+NS_ASSUME_NONNULL_END
@@ -6,14 +6,30 @@
 #import "YapDatabaseTransaction.h"
 #import "YapDatabaseExtension.h"
 
-#import "YapBidirectionalCache.h"
 #import "YapCache.h"
 #import "YapCollectionKey.h"
 #import "YapMemoryTable.h"
+#import "YapSharedObjectCache.h"
 #import "YapMutationStack.h"
+#import "YapRowidSet.h"
+#import "YapRowidBidirectionalCache.h"
+#import "YapDatabaseCompressionPrivate.h"
+#import "YapDatabaseExternalStorage.h"
+#import "YapDatabaseColdStorage.h"
+#import "YapDatabaseExtensionPopulation.h"
+#import "YapDatabaseTransactionMetricsPrivate.h"
+#import "YapDatabaseWorkloadTracePrivate.h"
+#import "YapDatabaseSlowQueryPrivate.h"
+#import "YapDatabaseQueueWaitStatisticsPrivate.h"
+#import "YapNull.h"
 
 #import "sqlite3.h"
 #import "yap_vfs_shim.h"
+#import "yap_vfs_memory.h"
+#import "yap_shared_snapshot.h"
+#import "yap_shared_changelog.h"
+
+#import <stdatomic.h>
 
 /**
  * Helper method to conditionally invoke sqlite3_finalize on a statement, and then set the ivar to NULL.
@@ -48,6 +64,32 @@ NS_INLINE void sqlite_enum_reset(sqlite3_stmt *stmt, BOOL needsFinalize)
 #define SQLITE_COLUMN_START 0
 #endif
 
+/**
+ * Returns YES if the given object adopts the YapDatabaseImmutable protocol,
+ * and may thus be shared by every connection, regardless of the policy.
+**/
+NS_INLINE BOOL YapDatabaseIsImmutable(id object)
+{
+	return [object conformsToProtocol:@protocol(YapDatabaseImmutable)];
+}
+
+/**
+ * Returns the value to store in the changeset, for an object (or metadata) written with the given policy.
+ * YapNull means other connections can't use the value, and must fetch it from the database again.
+**/
+NS_INLINE id YapDatabaseChangesetValue(YapDatabasePolicy policy, id object)
+{
+	if (policy == YapDatabasePolicyShare || YapDatabaseIsImmutable(object)) {
+		return object;
+	}
+	else if (policy == YapDatabasePolicyCopy && [object conformsToProtocol:@protocol(NSCopying)]) {
+		return [object copy];
+	}
+	else {
+		return [YapNull null];
+	}
+}
+
 /**
  * Keys for changeset dictionary.
 **/
@@ -57,6 +99,8 @@ extern NSString *const YapDatabaseRegisteredMemoryTablesKey;
 extern NSString *const YapDatabaseExtensionsOrderKey;
 extern NSString *const YapDatabaseExtensionDependenciesKey;
 extern NSString *const YapDatabaseRemovedRowidsKey;
+extern NSString *const YapDatabaseExtensionValuesChangedKey;
+extern NSString *const YapDatabaseOtherProcessKey;
 extern NSString *const YapDatabaseNotificationKey;
 
 /**
@@ -73,6 +117,12 @@ static NSString *const ext_key_class = @"class";
 	NSString *yap_vfs_shim_name;
 	yap_vfs *yap_vfs_shim;
 	
+	NSString *memory_vfs_name;  // nil unless options.inMemory
+	yap_vfs_memory *memory_vfs; // NULL unless options.inMemory
+	
+	yap_shared_snapshot *sharedSnapshot;   // Only non-NULL if enableMultiProcessSupport
+	yap_shared_changelog *sharedChangelog; // Only non-NULL if enableMultiProcessSupport
+	
 	void *IsOnSnapshotQueueKey;       // Only to be used by YapDatabaseConnection
 	void *IsOnWriteQueueKey;          // Only to be used by YapDatabaseConnection
 	
@@ -89,11 +139,433 @@ static NSString *const ext_key_class = @"class";
 	YapDatabaseSerializer metadataSerializer;       // Read-only by transactions
 	YapDatabaseDeserializer metadataDeserializer;   // Read-only by transactions
 	
+	YapDatabaseBytesDeserializer objectBytesDeserializer;   // Read-only by transactions (may be nil)
+	YapDatabaseBytesDeserializer metadataBytesDeserializer; // Read-only by transactions (may be nil)
+	
 	YapDatabasePreSanitizer objectPreSanitizer;     // Read-only by transactions
 	YapDatabasePostSanitizer objectPostSanitizer;   // Read-only by transactions
 	
 	YapDatabasePreSanitizer metadataPreSanitizer;   // Read-only by transactions
 	YapDatabasePostSanitizer metadataPostSanitizer; // Read-only by transactions
+	
+	BOOL usesCollectionIds; // Set within snapshot queue (during upgrade). Read-only by connections & transactions.
+	
+	NSDictionary<NSString *, YapDatabaseCompressionConfig *> *compressionConfigs; // Read-only by transactions
+	BOOL compressionEnabled; // Set within snapshot queue (during prepare). Read-only by connections & transactions.
+	
+	NSDictionary<NSString *, NSNumber *> *externalStorageThresholds; // Read-only by transactions
+	BOOL externalStorageEnabled; // Set within snapshot queue (during prepare). Read-only by connections & transactions.
+	
+	NSSet<NSString *> *coldCollections; // Read-only by transactions
+	NSTimeInterval coldStorageAge;      // Read-only by transactions
+	BOOL coldStorageEnabled; // Set within snapshot queue (during prepare). Read-only by connections & transactions.
+	
+	NSSet<NSString *> *expiringCollections; // Read-only by transactions
+	
+	NSSet<NSString *> *contentHashedCollections; // Read-only by transactions
+	BOOL contentHashEnabled; // Set within snapshot queue (during prepare). Read-only by connections & transactions.
+	
+	NSDictionary<NSString *, NSNumber *> *nativeMetadataTypes; // Read-only by transactions (nil if none)
+	
+	YapDatabaseHeaderExtractor objectHeaderExtractor; // Read-only by transactions
+	NSUInteger objectHeaderLength;                    // Read-only by transactions
+	BOOL expirationEnabled; // Set within snapshot queue (during prepare). Read-only by connections & transactions.
+	
+	BOOL groupCommitEnabled;                                       // Read-only by connections
+	atomic_uint groupCommitWaitingCount;                           // Only to be used by YapDatabaseConnection
+	NSUInteger groupCommitDeferredCount;                           // Only to be used within writeQueue
+	NSMutableArray<dispatch_queue_t> *groupCommitCompletionQueues; // Only to be used within writeQueue
+	NSMutableArray<dispatch_block_t> *groupCommitCompletionBlocks; // Only to be used within writeQueue
+	
+	atomic_uint priorityWritersWaitingCount; // Only to be used by YapDatabaseConnection (& transactions)
+	NSCondition *priorityWritersCondition;   // Only to be used by YapDatabaseConnection
+	
+	NSUUID *lastIncrementalBackupId; // Only to be used within writeQueue
+	
+	BOOL relaxedDurabilityEnabled;                // Read-only by connections
+	NSUInteger relaxedDurabilityTransactionLimit; // Read-only by connections
+	NSTimeInterval relaxedDurabilityInterval;     // Read-only by connections
+	NSUInteger relaxedDurabilityPendingCount;     // Only to be used within writeQueue
+	uint64_t relaxedDurabilityGeneration;         // Only to be used within writeQueue
+	
+	atomic_uint transactionMetricsConnectionCount; // Only to be used by YapDatabaseConnection (& deserialization)
+	
+	atomic_ullong queueWaitTransactionCount;         // Only to be used by YapDatabaseConnection
+	YapDatabaseQueueHolder *writeQueueHolder;        // Only to be used by YapDatabaseConnection. Thread-safe.
+	YapDatabaseQueueHolder *snapshotQueueHolder;     // Only to be used by YapDatabaseConnection. Thread-safe.
+	
+	atomic_uint_fast64_t slowQueryThresholdTicks;   // Set within internalQueue. Read-only by extensions.
+	atomic_uint_fast32_t slowQuerySampleThreshold;  // Set within internalQueue. Read-only by extensions.
+	
+	YapSharedObjectCache *sharedObjectCache; // May be nil. Thread-safe.
+	
+	atomic_uint_fast64_t mmapSizeTarget; // Set after checkpoints. Read-only by connections. Zero if not adaptive.
+	atomic_uint_fast64_t pageCacheShare; // Set within snapshotQueue. Read-only by connections. Zero if no budget.
+}
+
+/**
+ * Compression support (see YapDatabaseOptions.compressionConfigs).
+ * 
+ * The dictionaries are loaded from the database during prepare, and are thereafter kept in memory.
+ * These methods are thread-safe.
+**/
+- (NSData *)compressionDictionaryWithId:(uint32_t)dictionaryId;
+- (NSData *)activeCompressionDictionaryForCollection:(NSString *)collection dictionaryId:(uint32_t *)dictionaryIdPtr;
+
+/**
+ * Invoked after a (committed) transaction has inserted a new dictionary.
+ * The dictionary becomes the active dictionary for the collection, and is used for all subsequent writes.
+**/
+- (void)didInsertCompressionDictionary:(NSData *)dictionary
+                                withId:(uint32_t)dictionaryId
+                         forCollection:(NSString *)collection;
+
+- (NSData *)compressSerializedObject:(NSData *)serializedObject inCollection:(NSString *)collection;
+- (const void *)decompressBytes:(const void *)bytes
+                                  length:(size_t)length
+                      decompressedLength:(size_t *)decompressedLengthPtr;
+
+/**
+ * External storage support (see YapDatabaseOptions.externalStorageThresholds).
+ * These methods are thread-safe.
+ * 
+ * Writing a blob that's waiting to be deleted (because a previous commit dropped the last reference to it)
+ * cancels the deletion. If the file already exists, it isn't rewritten.
+**/
+- (BOOL)writeExternalBlob:(NSData *)blob withFileName:(NSString *)fileName created:(BOOL *)createdPtr;
+- (NSData *)externalBlobWithReference:(const void *)reference;
+
+/**
+ * Invoked after a rollback, with the files that were created during the (rolled back) transaction.
+**/
+- (void)deleteExternalBlobsWithFileNames:(NSArray<NSString *> *)fileNames;
+
+/**
+ * Invoked after a commit, with the files that are no longer referenced by any row.
+ * The files are deleted once every connection is at or past the given snapshot.
+**/
+- (void)noteUnreferencedExternalBlobs:(NSArray<NSString *> *)fileNames atSnapshot:(uint64_t)snapshot;
+
+/**
+ * Cold storage support (see YapDatabaseOptions.coldCollections).
+ * These methods are thread-safe.
+ * 
+ * The cold storage file is opened on first use, and closed again once it's been idle
+ * for the coldStorageIdleInterval. So databases that rarely touch their cold objects don't pay for it.
+ * 
+ * Blobs are written within their own (synced) transaction, and the ids are returned in the same order.
+ * Returns nil if the blobs couldn't be written.
+**/
+- (NSArray<NSNumber *> *)writeColdBlobs:(NSArray<NSData *> *)blobs;
+- (NSData *)coldBlobWithReference:(const void *)reference;
+
+/**
+ * Invoked after a rollback, with the blobs that were written during the (rolled back) transaction.
+**/
+- (void)deleteColdBlobsWithIds:(NSArray<NSNumber *> *)blobIds;
+
+/**
+ * Invoked after a commit, with the blobs that are no longer referenced by any row.
+ * The blobs are deleted once every connection is at or past the given snapshot.
+**/
+- (void)noteUnreferencedColdBlobs:(NSArray<NSNumber *> *)blobIds atSnapshot:(uint64_t)snapshot;
+
+/**
+ * Invoked by a connection after it commits a read-write transaction (with the number of changed rows).
+ * Once enough rows have changed, the database runs "PRAGMA optimize" (see YapDatabaseOptions.analyzeChangeThreshold).
+**/
+- (void)noteCommittedRowChanges:(uint64_t)changeCount;
+
+/**
+ * Invoked by an extension that has (new) pending work to populate.
+ * The database invokes -[YapDatabaseExtensionTransaction populateNextChunk] repeatedly,
+ * each time within its own (short) readWriteTransaction, until it returns YES.
+ * 
+ * This is the same process that's used after registration if -[YapDatabaseExtension hasPendingPopulation] is YES.
+ * The extension is responsible for not requesting a population while a previous one is still running.
+**/
+- (void)asyncPopulateExtension:(YapDatabaseExtension *)extension;
+
+/**
+ * Compresses a serialized object before it's written to the database (if compression is configured for the collection).
+**/
+NS_INLINE NSData * YapDatabaseCompressObject(YapDatabase *database, NSString *collection, NSData *serializedObject)
+{
+	// Note: External storage shares the compression header.
+	// So objects that happen to look like a header still need to be wrapped.
+	
+	if ((!database->compressionEnabled && !database->externalStorageEnabled && !database->coldStorageEnabled) ||
+	    serializedObject == nil)
+		return serializedObject;
+	
+	return [database compressSerializedObject:serializedObject inCollection:collection];
+}
+
+/**
+ * Deserializes an object/metadata directly from a sqlite column buffer.
+ * 
+ * If the registered deserializer is backed by a YapDatabaseBytesDeserializer, the bytes are passed straight through.
+ * Otherwise they're wrapped in an NSData (without copying), and passed to the regular deserializer.
+ * 
+ * Either way, the bytes are only valid until the statement is stepped or reset.
+ * 
+ * Compressed objects are decompressed into a per-thread buffer first (which has the same lifetime guarantee).
+ * 
+ * Externally stored objects are memory mapped, and the mapped data is passed to the deserializer.
+ * (The mapped data remains valid for as long as it's retained.)
+ * 
+ * Objects in cold storage are read from the cold storage file first.
+ * What's stored there is the original row, so it's then decoded like any other row.
+**/
+NS_INLINE id _YapDatabaseDeserializeObject(YapDatabase *database,
+                                           NSString *collection, NSString *key, const void *bytes, int length)
+{
+	__attribute__((objc_precise_lifetime)) NSData *coldBlob = nil;
+	
+	if (database->coldStorageEnabled && YapDatabaseIsColdReference(bytes, (size_t)length))
+	{
+		coldBlob = [database coldBlobWithReference:bytes];
+		if (coldBlob == nil) return nil;
+		
+		bytes = coldBlob.bytes;
+		length = (int)coldBlob.length;
+	}
+	
+	if ((database->compressionEnabled || database->externalStorageEnabled || database->coldStorageEnabled) &&
+	    YapDatabaseCompressionHasHeader(bytes, (size_t)length))
+	{
+		if (YapDatabaseIsExternalReference(bytes, (size_t)length))
+		{
+			__attribute__((objc_precise_lifetime)) NSData *blob = [database externalBlobWithReference:bytes];
+			if (blob == nil) return nil;
+			
+			if (database->objectBytesDeserializer)
+				return database->objectBytesDeserializer(collection, key, blob.bytes, blob.length);
+			else
+				return database->objectDeserializer(collection, key, blob);
+		}
+		
+		size_t decompressedLength = 0;
+		bytes = [database decompressBytes:bytes length:(size_t)length decompressedLength:&decompressedLength];
+		
+		if (bytes == NULL) return nil;
+		length = (int)decompressedLength;
+	}
+	
+	if (database->objectBytesDeserializer)
+		return database->objectBytesDeserializer(collection, key, bytes, (size_t)length);
+	
+	NSData *data = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+	return database->objectDeserializer(collection, key, data);
+}
+
+NS_INLINE id _YapDatabaseDeserializeMetadata(YapDatabase *database,
+                                             NSString *collection, NSString *key, const void *bytes, int length)
+{
+	if (database->metadataBytesDeserializer)
+		return database->metadataBytesDeserializer(collection, key, bytes, (size_t)length);
+	
+	NSData *data = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+	return database->metadataDeserializer(collection, key, data);
+}
+
+/**
+ * Returns the native metadata type of the given collection, or zero if its metadata is always serialized.
+ * See YapDatabaseOptions.nativeMetadataTypes.
+**/
+NS_INLINE YapDatabaseNativeMetadataType YapDatabaseNativeMetadataTypeForCollection(YapDatabase *database,
+                                                                                   NSString *collection)
+{
+	if (database->nativeMetadataTypes == nil) return (YapDatabaseNativeMetadataType)0;
+	
+	return (YapDatabaseNativeMetadataType)[[database->nativeMetadataTypes objectForKey:collection] integerValue];
+}
+
+/**
+ * Returns YES if the given metadata is stored natively (rather than via the metadataSerializer).
+ * That is, the collection has a native metadata type, and the metadata is of the matching class.
+**/
+NS_INLINE BOOL YapDatabaseIsNativeMetadata(YapDatabase *database, NSString *collection, id metadata)
+{
+	if (metadata == nil) return NO;
+	
+	switch (YapDatabaseNativeMetadataTypeForCollection(database, collection))
+	{
+		case YapDatabaseNativeMetadataType_Integer :
+		case YapDatabaseNativeMetadataType_Real    : return [metadata isKindOfClass:[NSNumber class]];
+		case YapDatabaseNativeMetadataType_Text    : return [metadata isKindOfClass:[NSString class]];
+		case YapDatabaseNativeMetadataType_Date    : return [metadata isKindOfClass:[NSDate class]];
+		default                                    : return NO;
+	}
+}
+
+/**
+ * Binds metadata for which YapDatabaseIsNativeMetadata() returned YES.
+**/
+NS_INLINE void YapDatabaseBindNativeMetadata(YapDatabase *database, NSString *collection, id metadata,
+                                             sqlite3_stmt *statement, int bind_idx)
+{
+	switch (YapDatabaseNativeMetadataTypeForCollection(database, collection))
+	{
+		case YapDatabaseNativeMetadataType_Integer :
+			sqlite3_bind_int64(statement, bind_idx, (sqlite3_int64)[(NSNumber *)metadata longLongValue]);
+			break;
+		case YapDatabaseNativeMetadataType_Real :
+			sqlite3_bind_double(statement, bind_idx, [(NSNumber *)metadata doubleValue]);
+			break;
+		case YapDatabaseNativeMetadataType_Text :
+			sqlite3_bind_text(statement, bind_idx, [(NSString *)metadata UTF8String], -1, SQLITE_TRANSIENT);
+			break;
+		case YapDatabaseNativeMetadataType_Date :
+			sqlite3_bind_double(statement, bind_idx, [(NSDate *)metadata timeIntervalSinceReferenceDate]);
+			break;
+		default :
+			sqlite3_bind_null(statement, bind_idx);
+			break;
+	}
+}
+
+/**
+ * Reads the native value of a metadata column (which isn't a blob).
+**/
+NS_INLINE id YapDatabaseNativeMetadataFromColumn(YapDatabase *database, NSString *collection,
+                                                 sqlite3_stmt *statement, int column_idx, int type)
+{
+	switch (type)
+	{
+		case SQLITE_INTEGER :
+		{
+			return @(sqlite3_column_int64(statement, column_idx));
+		}
+		case SQLITE_FLOAT :
+		{
+			double value = sqlite3_column_double(statement, column_idx);
+			
+			if (YapDatabaseNativeMetadataTypeForCollection(database, collection) == YapDatabaseNativeMetadataType_Date)
+				return [NSDate dateWithTimeIntervalSinceReferenceDate:value];
+			else
+				return @(value);
+		}
+		case SQLITE_TEXT :
+		{
+			const unsigned char *text = sqlite3_column_text(statement, column_idx);
+			int textSize = sqlite3_column_bytes(statement, column_idx);
+			
+			return [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		}
+		default :
+		{
+			return nil;
+		}
+	}
+}
+
+/**
+ * Same as above, but records the time spent within the transaction metrics of the current thread (if any).
+ * Only used if a connection has enabled transaction metrics.
+**/
+id YapDatabaseDeserializeObjectWithMetrics(YapDatabase *database,
+                                           NSString *collection, NSString *key, const void *bytes, int length);
+id YapDatabaseDeserializeMetadataWithMetrics(YapDatabase *database,
+                                             NSString *collection, NSString *key, const void *bytes, int length);
+
+NS_INLINE id YapDatabaseDeserializeObject(YapDatabase *database,
+                                          NSString *collection, NSString *key, const void *bytes, int length)
+{
+	if (atomic_load_explicit(&database->transactionMetricsConnectionCount, memory_order_relaxed) > 0)
+		return YapDatabaseDeserializeObjectWithMetrics(database, collection, key, bytes, length);
+	else
+		return _YapDatabaseDeserializeObject(database, collection, key, bytes, length);
+}
+
+NS_INLINE id YapDatabaseDeserializeMetadata(YapDatabase *database,
+                                            NSString *collection, NSString *key, const void *bytes, int length)
+{
+	if (atomic_load_explicit(&database->transactionMetricsConnectionCount, memory_order_relaxed) > 0)
+		return YapDatabaseDeserializeMetadataWithMetrics(database, collection, key, bytes, length);
+	else
+		return _YapDatabaseDeserializeMetadata(database, collection, key, bytes, length);
+}
+
+/**
+ * Reads the metadata column of a row.
+ * 
+ * Serialized metadata is deserialized straight from the column buffer (avoiding an extra allocation and memcpy).
+ * Native metadata (see YapDatabaseOptions.nativeMetadataTypes) is read directly, without deserialization.
+**/
+NS_INLINE id YapDatabaseMetadataFromColumn(YapDatabase *database, NSString *collection, NSString *key,
+                                           sqlite3_stmt *statement, int column_idx)
+{
+	int type = sqlite3_column_type(statement, column_idx);
+	
+	if (type == SQLITE_BLOB)
+	{
+		const void *blob = sqlite3_column_blob(statement, column_idx);
+		int blobSize = sqlite3_column_bytes(statement, column_idx);
+		
+		if (blobSize > 0)
+			return YapDatabaseDeserializeMetadata(database, collection, key, blob, blobSize);
+		else
+			return nil;
+	}
+	
+	return YapDatabaseNativeMetadataFromColumn(database, collection, statement, column_idx, type);
+}
+
+/**
+ * Copies the serialized metadata out of a sqlite column.
+ * Used by the primitive accessors, so native metadata is run through the metadataSerializer.
+**/
+NS_INLINE NSData * YapDatabaseCopySerializedMetadata(YapDatabase *database, NSString *collection, NSString *key,
+                                                     sqlite3_stmt *statement, int column_idx)
+{
+	int type = sqlite3_column_type(statement, column_idx);
+	
+	if (type == SQLITE_BLOB || type == SQLITE_NULL)
+	{
+		const void *blob = sqlite3_column_blob(statement, column_idx);
+		int blobSize = sqlite3_column_bytes(statement, column_idx);
+		
+		return [NSData dataWithBytes:blob length:blobSize];
+	}
+	
+	id metadata = YapDatabaseNativeMetadataFromColumn(database, collection, statement, column_idx, type);
+	return metadata ? database->metadataSerializer(collection, key, metadata) : nil;
+}
+
+/**
+ * Copies a serialized object out of a sqlite column buffer, decompressing it if needed.
+ * Used by the primitive accessors, which always return the serialized object as produced by the serializer.
+**/
+NS_INLINE NSData * YapDatabaseCopySerializedObject(YapDatabase *database, const void *bytes, int length)
+{
+	__attribute__((objc_precise_lifetime)) NSData *coldBlob = nil;
+	
+	if (database->coldStorageEnabled && YapDatabaseIsColdReference(bytes, (size_t)length))
+	{
+		coldBlob = [database coldBlobWithReference:bytes];
+		if (coldBlob == nil) return nil;
+		
+		bytes = coldBlob.bytes;
+		length = (int)coldBlob.length;
+	}
+	
+	if ((database->compressionEnabled || database->externalStorageEnabled || database->coldStorageEnabled) &&
+	    YapDatabaseCompressionHasHeader(bytes, (size_t)length))
+	{
+		if (YapDatabaseIsExternalReference(bytes, (size_t)length))
+		{
+			return [database externalBlobWithReference:bytes]; // Mapped (no need to copy)
+		}
+		
+		size_t decompressedLength = 0;
+		bytes = [database decompressBytes:bytes length:(size_t)length decompressedLength:&decompressedLength];
+		
+		if (bytes == NULL) return nil;
+		length = (int)decompressedLength;
+	}
+	
+	return [NSData dataWithBytes:bytes length:length];
 }
 
 /**
@@ -107,6 +579,7 @@ static NSString *const ext_key_class = @"class";
 
 
 + (BOOL)tableExists:(NSString *)tableName using:(sqlite3 *)aDb;
++ (NSString *)sqlForTrigger:(NSString *)triggerName using:(sqlite3 *)aDb;
 + (NSArray *)tableNamesUsing:(sqlite3 *)aDb;
 + (NSArray *)columnNamesForTable:(NSString *)tableName using:(sqlite3 *)aDb;
 + (NSDictionary *)columnNamesAndAffinityForTable:(NSString *)tableName using:(sqlite3 *)aDb;
@@ -122,6 +595,13 @@ static NSString *const ext_key_class = @"class";
 - (BOOL)connectionPoolEnqueue:(sqlite3 *)aDb main_file:(yap_file *)main_file wal_file:(yap_file *)wal_file;
 - (BOOL)connectionPoolDequeue:(sqlite3 **)aDb main_file:(yap_file **)main_file wal_file:(yap_file **)wal_file;
 
+/**
+ * The filename & flags that YapDatabaseConnection uses to open its sqlite3 instance.
+ * These differ from the databasePath (& the given read-write flags) if options.readOnlyImmutable is set.
+**/
+- (NSString *)sqliteOpenFilename;
+- (int)sqliteOpenFlags:(int)flags;
+
 /**
  * These methods are only accessible from within the snapshotQueue.
  * Used by [YapDatabaseConnection prepare].
@@ -152,6 +632,36 @@ static NSString *const ext_key_class = @"class";
 **/
 - (NSArray *)pendingAndCommittedChangesetsSince:(uint64_t)connectionSnapshot until:(uint64_t)maxSnapshot;
 
+/**
+ * This method may be invoked from any queue (without going through the snapshotQueue).
+ *
+ * Same as pendingAndCommittedChangesetsSince:until:, but based on the most recently published changesets,
+ * and without the shared changelog. So it's not for use with enableMultiProcessSupport.
+ *
+ * A connection must invoke it from within its connectionQueue,
+ * as that's what prevents the changesets it hasn't processed yet from being dropped.
+**/
+- (NSArray *)publishedChangesetsSince:(uint64_t)connectionSnapshot until:(uint64_t)maxSnapshot;
+
+/**
+ * Only used with enableMultiProcessSupport, while holding the sqlite write lock.
+ * 
+ * Prior to the sqlite commit, the connection passes its changeset to the database,
+ * which stores a summary of it (the keys that changed) in the shared changelog.
+ * After the commit, the summary is published to other processes (if the commit succeeded).
+**/
+- (void)willCommitSharedChangeset:(NSDictionary *)changeset;
+- (void)didCommitSharedChangeset:(NSDictionary *)changeset success:(BOOL)didCommit;
+
+/**
+ * Returns the changesets committed by other processes, for each snapshot in (fromSnapshot, toSnapshot].
+ * Returns nil if any of them isn't available in the shared changelog.
+ * 
+ * The changesets only contain the changed keys (the values are YapNull), and are marked with YapDatabaseOtherProcessKey.
+ * This method is thread-safe (it doesn't need the snapshotQueue).
+**/
+- (NSArray *)sharedChangesetsSince:(uint64_t)fromSnapshot until:(uint64_t)toSnapshot;
+
 /**
  * This method is only accessible from within the snapshotQueue.
  * 
@@ -182,6 +692,40 @@ static NSString *const ext_key_class = @"class";
 - (BOOL)aggressiveCheckpointEnabled;
 - (void)noteCheckpointWithTotalFrames:(int)totalFrameCount checkpointedFrames:(int)checkpointedFrameCount;
 
+/**
+ * Truncates the WAL, and clones the database file to the given path (via clonefile).
+ * Must be invoked within the writeQueue.
+ * Returns NO if the clone couldn't be made, in which case a regular backup should be used instead.
+**/
+- (BOOL)cloneDatabaseFileToPath:(NSString *)clonePath;
+
+/**
+ * Invoked by the WAL hook of each connection, if a checkpointPolicy is configured.
+**/
+- (void)noteCommitWithWALFrameCount:(int)frameCount;
+
+/**
+ * Invoked (via YapDatabaseQueryProfileReport) when an extension query exceeds the slowQueryThreshold.
+ * Hands the report to the slowQueryHandler (asynchronously), or logs it if there isn't a handler.
+ * Thread-safe.
+**/
+- (void)reportSlowQuery:(YapDatabaseSlowQuery *)slowQuery;
+
+/**
+ * Invoked by a connection (on the main thread) after it posts a YapDatabaseModifiedNotification.
+ * Adds the notification to the pending YapDatabaseModifiedCoalescedNotification (if enabled).
+**/
+- (void)coalesceModifiedNotification:(NSNotification *)notification;
+
+/**
+ * Holds a single sqlite read transaction at the oldest snapshot captured by a detached long-lived read transaction.
+ * This prevents checkpoints (and WAL restarts) from invalidating those snapshots.
+ *
+ * These methods return/do nothing unless compiled with SQLITE_ENABLE_SNAPSHOT.
+**/
+- (BOOL)pinSQLiteSnapshot:(sqlite3_snapshot *)sqliteSnapshot;
+- (void)unpinSQLiteSnapshot:(sqlite3_snapshot *)sqliteSnapshot;
+
 #ifdef SQLITE_HAS_CODEC
 /**
  * Configures database encryption via SQLCipher.
@@ -212,14 +756,24 @@ static NSString *const ext_key_class = @"class";
 	
 	BOOL hasDiskChanges;
 	BOOL enableMultiProcessSupport;
+	BOOL readOnlyImmutable;
 	
-	YapBidirectionalCache<NSNumber *, YapCollectionKey *> *keyCache;
+	YapRowidBidirectionalCache<YapCollectionKey *> *keyCache;
 	YapCache<YapCollectionKey *, id> *objectCache;
 	YapCache<YapCollectionKey *, id> *metadataCache;
 	
 	NSUInteger objectCacheLimit;          // Read-only by transaction. Use as consideration of whether to add to cache.
 	NSUInteger metadataCacheLimit;        // Read-only by transaction. Use as consideration of whether to add to cache.
 	
+	NSUInteger objectCacheCostLimit;
+	NSUInteger metadataCacheCostLimit;
+	
+	YapDatabaseCacheCostBlock objectCacheCostBlock;
+	YapDatabaseCacheCostBlock metadataCacheCostBlock;
+	
+	YapCacheAdmissionPolicy objectCacheAdmissionPolicy;
+	YapCacheAdmissionPolicy metadataCacheAdmissionPolicy;
+	
 	YapDatabasePolicy objectPolicy;       // Read-only by transaction. Use to determine what goes in objectChanges.
 	YapDatabasePolicy metadataPolicy;     // Read-only by transaction. Use to determine what goes in metadataChanges.
 	
@@ -230,16 +784,29 @@ static NSString *const ext_key_class = @"class";
 	NSMutableSet *insertedKeys;
 	NSMutableSet *removedKeys;
 	NSMutableSet *removedCollections;
-	NSMutableSet *removedRowids;
+	NSMutableSet *resetCollections; // Only used for transactions with coarseChangeset enabled
+	YapRowidSet *removedRowids;     // Ownership is transferred to the changeset (see getInternalChangeset:)
 	BOOL allKeysRemoved;
 	BOOL externallyModified;
 	
+	NSMutableDictionary<NSString *, NSMutableDictionary *> *extensionValuesCache; // extName -> (key -> yap2 value)
+	NSMutableSet<NSString *> *changedExtensionValues; // Extensions whose yap2 values were modified (readwrite only)
+	
 	YapMutationStack_Bool *mutationStack;
+	
+	YapDatabaseTransactionMetrics *transactionMetrics; // Non-nil during a read-write transaction, if metrics enabled
+	YapDatabaseWorkloadTraceBuffer *workloadTrace;     // Non-nil during a transaction, if a trace is being recorded
 }
 
 - (instancetype)initWithDatabase:(YapDatabase *)database;
 - (instancetype)initWithDatabase:(YapDatabase *)database config:(YapDatabaseConnectionConfig *)config;
 
+/**
+ * Opens and configures a new sqlite3 instance (without a busy handler).
+ * Used by connections, and to prewarm the connection pool.
+**/
++ (int)openDatabaseHandle:(sqlite3 **)pDb forDatabase:(YapDatabase *)database;
+
 - (sqlite3_stmt *)beginTransactionStatement;
 - (sqlite3_stmt *)beginImmediateTransactionStatement;
 - (sqlite3_stmt *)commitTransactionStatement;
@@ -270,6 +837,11 @@ static NSString *const ext_key_class = @"class";
 - (sqlite3_stmt *)removeCollectionStatement;
 - (sqlite3_stmt *)removeAllStatement;
 
+- (sqlite3_stmt *)getCollectionIdStatement;
+- (sqlite3_stmt *)insertCollectionStatement;
+
+- (BOOL)getCollectionId:(int64_t *)collectionIdPtr forCollection:(NSString *)collection;
+
 - (sqlite3_stmt *)enumerateCollectionsStatement:(BOOL *)needsFinalizePtr;
 - (sqlite3_stmt *)enumerateCollectionsForKeyStatement:(BOOL *)needsFinalizePtr;
 - (sqlite3_stmt *)enumerateKeysInCollectionStatement:(BOOL *)needsFinalizePtr;
@@ -280,6 +852,17 @@ static NSString *const ext_key_class = @"class";
 - (sqlite3_stmt *)enumerateKeysAndObjectsInAllCollectionsStatement:(BOOL *)needsFinalizePtr;
 - (sqlite3_stmt *)enumerateRowsInCollectionStatement:(BOOL *)needsFinalizePtr;
 - (sqlite3_stmt *)enumerateRowsInAllCollectionsStatement:(BOOL *)needsFinalizePtr;
+- (sqlite3_stmt *)enumerateKeysInRangeStatement:(BOOL *)needsFinalizePtr reverse:(BOOL)reverse;
+- (sqlite3_stmt *)enumerateKeysAndObjectsInRangeStatement:(BOOL *)needsFinalizePtr reverse:(BOOL)reverse;
+- (sqlite3_stmt *)enumerateRowsInCollectionPageStatement:(BOOL *)needsFinalizePtr;
+
+- (sqlite3_stmt *)getExpirationForRowidStatement;
+- (sqlite3_stmt *)setExpirationForRowidStatement;
+- (sqlite3_stmt *)removeExpirationForRowidStatement;
+- (sqlite3_stmt *)enumerateExpiredRowidsStatement;
+
+- (sqlite3_stmt *)getContentHashForRowidStatement;
+- (sqlite3_stmt *)setContentHashForRowidStatement;
 
 - (void)prepare;
 
@@ -289,6 +872,7 @@ static NSString *const ext_key_class = @"class";
 - (NSDictionary *)extensions;
 
 - (BOOL)registerExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName;
+- (BOOL)registerExtensions:(NSArray<YapDatabaseExtension *> *)extensions withNames:(NSArray<NSString *> *)names;
 - (void)unregisterExtensionWithName:(NSString *)extensionName;
 
 - (NSDictionary *)registeredMemoryTables;
@@ -299,10 +883,17 @@ static NSString *const ext_key_class = @"class";
 - (void)markSqlLevelSharedReadLockAcquired;
 
 - (void)getInternalChangeset:(NSMutableDictionary **)internalPtr externalChangeset:(NSMutableDictionary **)externalPtr;
+- (void)coarsenChangeset;
+- (void)coarsenChangesetForCollection:(NSString *)collection;
 - (void)noteCommittedChangeset:(NSDictionary *)changeset;
+- (void)noteCommittedChangesets:(NSArray<NSDictionary *> *)changesets;
 
 - (BOOL)resetLongLivedReadTransaction;
 
+- (void)prefetchObjectsWithKeysBlock:(NSArray<YapCollectionKey *> * (^)(YapDatabaseReadTransaction *transaction))keysBlock
+                     completionQueue:(dispatch_queue_t)completionQueue
+                     completionBlock:(dispatch_block_t)completionBlock;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -312,12 +903,21 @@ static NSString *const ext_key_class = @"class";
 @interface YapDatabaseReadTransaction () {
 @private
 	NSMutableArray *orderedExtensions;
+	NSMutableDictionary<NSString *, NSArray *> *orderedExtensionsByCollection;
 	BOOL extensionsReady;
+	BOOL extensionsHaveInterestedCollections;
+	uint64_t extensionsSnapshot;
 	
 	YapMemoryTableTransaction *yapMemoryTableTransaction;
 	
 @protected
 	NSMutableDictionary *extensions;
+	NSMutableDictionary<NSString *, NSMutableDictionary *> *prefetchedValues; // extensionName -> (key -> yap2 value)
+	NSMutableDictionary<NSString *, NSMutableDictionary *> *pendingExtensionValues; // Buffered yap2 modifications
+	NSMutableSet<NSString *> *pendingRemovedExtensions; // Buffered removeAllValuesForExtension:
+	BOOL extensionValuesFlushed; // Set during pre-commit, after which yap2 modifications are written immediately
+	NSMutableArray *openBlobStreams; // YapDatabaseBlobReadStream / YapDatabaseBlobWriteStream
+	NSSet<YapDatabaseExtensionTransaction *> *bulkLoadExtensions; // Row hooks suspended (see beginBulkLoad)
 	
 @public
 	__unsafe_unretained YapDatabaseConnection *connection;
@@ -330,21 +930,34 @@ static NSString *const ext_key_class = @"class";
 - (void)beginTransaction;
 - (void)beginImmediateTransaction;
 - (void)preCommitReadWriteTransaction;
-- (void)commitTransaction;
+- (BOOL)commitTransaction;
 - (void)rollbackTransaction;
 
+- (void)prepareForReuse;
+
+- (void)blobStreamDidClose:(id)stream;
+- (void)closeBlobStreams;
+- (void)invalidateBlobStreams;
+
 - (NSDictionary *)extensions;
 - (NSArray *)orderedExtensions;
+- (NSArray *)orderedExtensionsForCollection:(NSString *)collection;
+- (void)setBulkLoadExtensions:(NSSet<YapDatabaseExtensionTransaction *> *)extTransactions;
 
 - (YapMemoryTableTransaction *)memoryTableTransaction:(NSString *)tableName;
 - (YapMemoryTableTransaction *)yapMemoryTableTransaction;
 
 - (BOOL)getBoolValue:(BOOL *)valuePtr forKey:(NSString *)key extension:(NSString *)extension;
 - (BOOL)getIntValue:(int *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName;
+- (BOOL)getInt64Value:(int64_t *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName;
 - (BOOL)getDoubleValue:(double *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName;
 - (NSString *)stringValueForKey:(NSString *)key extension:(NSString *)extensionName;
 - (NSData *)dataValueForKey:(NSString *)key extension:(NSString *)extensionName;
 
+- (void)prefetchValuesForExtensions:(NSArray<NSString *> *)extensionNames;
+- (BOOL)getPrefetchedValue:(id *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName;
+- (void)dropPrefetchedValuesForExtension:(NSString *)extensionName;
+
 - (NSException *)mutationDuringEnumerationException;
 
 - (BOOL)getRowid:(int64_t *)rowidPtr forCollectionKey:(YapCollectionKey *)collectionKey;
@@ -360,8 +973,15 @@ static NSString *const ext_key_class = @"class";
 				metadata:(id *)metadataPtr
 				forRowid:(int64_t)rowid;
 
+- (void)getCollectionKeys:(NSArray<YapCollectionKey *> **)collectionKeysPtr
+                  objects:(NSArray **)objectsPtr
+                 metadata:(NSArray **)metadataPtr
+                forRowids:(NSArray<NSNumber *> *)rowids;
+
 - (BOOL)hasRowid:(int64_t)rowid;
 
+- (BOOL)isExpiredCollectionKey:(YapCollectionKey *)collectionKey;
+
 - (id)objectForKey:(NSString *)key inCollection:(NSString *)collection withRowid:(int64_t)rowid;
 - (id)objectForCollectionKey:(YapCollectionKey *)cacheKey withRowid:(int64_t)rowid;
 
@@ -382,6 +1002,13 @@ static NSString *const ext_key_class = @"class";
 - (void)_enumerateKeysInCollection:(NSString *)collection
                         usingBlock:(void (^)(int64_t rowid, NSString *key, BOOL *stop))block;
 
+- (void)_enumerateKeysInCollection:(NSString *)collection
+                        lowerBound:(NSData *)lowerBound
+                        upperBound:(NSData *)upperBound
+                           reverse:(BOOL)reverse
+                             limit:(NSUInteger)limit
+                        usingBlock:(void (^)(int64_t rowid, NSString *key, BOOL *stop))block;
+
 - (void)_enumerateKeysInCollections:(NSArray *)collections
                          usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, BOOL *stop))block;
 
@@ -412,6 +1039,18 @@ static NSString *const ext_key_class = @"class";
                                   usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block
                                   withFilter:(BOOL (^)(int64_t rowid, NSString *key))filter;
 
+- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                  lowerBound:(NSData *)lowerBound
+                                  upperBound:(NSData *)upperBound
+                                     reverse:(BOOL)reverse
+                                       limit:(NSUInteger)limit
+                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block;
+
+- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                  afterRowid:(int64_t)afterRowid
+                                       limit:(NSUInteger)limit
+                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block;
+
 - (void)_enumerateKeysAndObjectsInCollections:(NSArray *)collections
                  usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop))block;
 - (void)_enumerateKeysAndObjectsInCollections:(NSArray *)collections
@@ -430,6 +1069,13 @@ static NSString *const ext_key_class = @"class";
                         usingBlock:(void (^)(int64_t rowid, NSString *key, id object, id metadata, BOOL *stop))block
                         withFilter:(BOOL (^)(int64_t rowid, NSString *key))filter;
 
+- (void)_concurrentlyEnumerateRowsInCollection:(NSString *)collection
+                               includeMetadata:(BOOL)includeMetadata
+                                     unordered:(BOOL)unordered
+                                    usingBlock:
+                            (void (^)(int64_t rowid, NSString *key, id object, id metadata, BOOL *stop))block
+                                    withFilter:(BOOL (^)(int64_t rowid, NSString *key))filter;
+
 - (void)_enumerateRowsInCollections:(NSArray *)collections
      usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block;
 - (void)_enumerateRowsInCollections:(NSArray *)collections
@@ -442,10 +1088,38 @@ static NSString *const ext_key_class = @"class";
                 (void (^)(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
      withFilter:(BOOL (^)(int64_t rowid, NSString *collection, NSString *key))filter;
 
+- (NSUInteger)_enumerateRowsAfterRowid:(int64_t)rowid
+                                 limit:(NSUInteger)limit
+                           withObjects:(BOOL)withObjects
+                              metadata:(BOOL)withMetadata
+                             lastRowid:(int64_t *)lastRowidPtr
+                            usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key,
+                                                 id object, id metadata, BOOL *stop))block
+                            withFilter:(BOOL (^)(int64_t rowid, NSString *collection, NSString *key))filter;
+
+- (BOOL)_getMinRowid:(int64_t *)minRowidPtr maxRowid:(int64_t *)maxRowidPtr inCollection:(NSString *)collection;
+
+- (void)_enumerateRowsInCollection:(NSString *)collection
+                        afterRowid:(int64_t)afterRowid
+                      throughRowid:(int64_t)throughRowid
+                        usingBlock:(void (^)(int64_t rowid, NSString *key, id object, id metadata, BOOL *stop))block;
+
 - (void)_enumerateRowidsForKeys:(NSArray *)keys
                    inCollection:(NSString *)collection
             unorderedUsingBlock:(void (^)(NSUInteger keyIndex, int64_t rowid, BOOL *stop))block;
 
+- (void)_enumerateRowsForKeys:(NSArray *)keys
+                 inCollection:(NSString *)collection
+                  withObjects:(BOOL)withObjects
+                     metadata:(BOOL)withMetadata
+          unorderedUsingBlock:(void (^)(NSUInteger keyIndex, id object, id metadata, BOOL *stop))block;
+
+- (void)_enumerateRowsForRowids:(NSArray<NSNumber *> *)rowids
+                    withObjects:(BOOL)withObjects
+                       metadata:(BOOL)withMetadata
+            unorderedUsingBlock:(void (^)(NSUInteger rowidIndex, YapCollectionKey *ck,
+                                          id object, id metadata, BOOL *stop))block;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -458,9 +1132,27 @@ static NSString *const ext_key_class = @"class";
 	NSMutableArray<dispatch_block_t> *completionBlockStack;
 	
 	BOOL rollback;
+	BOOL coarseChangeset;
+	NSUInteger changesetSpillThreshold;
+	BOOL changesetSpilled;
 	id customObjectForNotification;
+	
+	YapDatabaseExtensionPopulation *extensionPopulation; // Non-nil while registering a batch of extensions
+	
+	NSMutableArray<NSString *> *createdExternalBlobs; // Files written during the transaction (deleted on rollback)
+	NSArray<NSString *> *externalBlobGarbage;         // Files that became unreferenced (deleted after commit)
+	
+	NSMutableArray<NSNumber *> *createdColdBlobs; // Cold blobs written during the transaction (deleted on rollback)
+	NSArray<NSNumber *> *coldBlobGarbage;         // Cold blobs that became unreferenced (deleted after commit)
 }
 
+- (void)collectUnreferencedExternalBlobs;
+- (void)collectUnreferencedColdBlobs;
+- (void)flushPendingExtensionValues;
+
+- (void)beginBulkLoad;
+- (void)endBulkLoad;
+
 - (void)replaceObject:(id)object
                forKey:(NSString *)key
          inCollection:(NSString *)collection
@@ -473,6 +1165,13 @@ static NSString *const ext_key_class = @"class";
               withRowid:(int64_t)rowid
      serializedMetadata:(NSData *)preSerializedMetadata;
 
+- (void)_setObjects:(NSArray *)objects
+            forKeys:(NSArray<NSString *> *)keys
+       inCollection:(NSString *)collection
+       withMetadata:(NSArray *)metadata
+  serializedObjects:(NSArray<NSData *> *)preSerializedObjects
+ serializedMetadata:(NSArray *)preSerializedMetadata;
+
 - (void)removeObjectForCollectionKey:(YapCollectionKey *)collectionKey withRowid:(int64_t)rowid;
 - (void)removeObjectForKey:(NSString *)key inCollection:(NSString *)collection withRowid:(int64_t)rowid;
 
@@ -481,6 +1180,7 @@ static NSString *const ext_key_class = @"class";
 
 - (void)setBoolValue:(BOOL)value         forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setIntValue:(int)value           forKey:(NSString *)key extension:(NSString *)extensionName;
+- (void)setInt64Value:(int64_t)value     forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setDoubleValue:(double)value     forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setStringValue:(NSString *)value forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setDataValue:(NSData *)value     forKey:(NSString *)key extension:(NSString *)extensionName;
@@ -0,0 +1,29 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseQuery.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseQuery ()
+
+/**
+ * Extensions turn a query into a full SQL statement, which is the key for their (per connection) queryCache.
+ * This method memoizes that SQL, so repeated executions of the same query don't need to format it again.
+ *
+ * The memoized SQL is shared with every query derived via -queryWithParameters: (as they have the same queryString).
+ *
+ * @param kind
+ *   Identifies the extension class & the kind of statement. E.g. @"YapDatabaseSecondaryIndex.rowid".
+ *
+ * @param registeredName
+ *   The registeredName of the extension.
+ *
+ * @param block
+ *   Invoked to create the SQL, if it hasn't been memoized yet.
+**/
+- (NSString *)fullQueryStringForKind:(NSString *)kind
+                      registeredName:(NSString *)registeredName
+                          usingBlock:(NSString * (^)(void))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
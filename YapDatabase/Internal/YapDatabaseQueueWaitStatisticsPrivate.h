@@ -0,0 +1,82 @@
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+#import "YapDatabaseQueueWaitStatistics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The number of kinds of waits (i.e. the number of YapDatabaseQueueWait values).
+**/
+#define YAP_QUEUE_WAIT_COUNT 4
+
+/**
+ * Wait histograms use power-of-two buckets (in microseconds), just like the I/O latency histograms.
+**/
+#define YAP_QUEUE_WAIT_BUCKET_COUNT 24
+
+typedef struct {
+	_Atomic uint64_t count;
+	_Atomic uint64_t ticks;    // mach_absolute_time units
+	_Atomic uint64_t maxTicks; // mach_absolute_time units
+	_Atomic uint64_t buckets[YAP_QUEUE_WAIT_BUCKET_COUNT];
+} yap_queue_wait_stats;
+
+/**
+ * Records a single wait (in mach_absolute_time units).
+ *
+ * Each connection only records from within its own connectionQueue, so there's only one writer at a time.
+ * Readers may load the counters from any thread.
+**/
+void yap_queue_wait_stats_record(yap_queue_wait_stats *stats, uint64_t ticks);
+
+/**
+ * Resets the counters of the given array (with YAP_QUEUE_WAIT_COUNT entries).
+**/
+void yap_queue_wait_stats_reset(yap_queue_wait_stats *stats);
+
+
+@interface YapDatabaseQueueWaitStatistics ()
+
+/**
+ * The given array is indexed by YapDatabaseQueueWait, and has YAP_QUEUE_WAIT_COUNT entries.
+**/
+- (instancetype)initWithStats:(yap_queue_wait_stats *)stats;
+
+@end
+
+@interface YapDatabaseQueueWaitEvent () {
+@public
+	
+	YapDatabaseQueueWait wait;
+	NSTimeInterval duration;
+	
+	NSString *connectionName;
+	uint64_t transactionID;
+	BOOL readWrite;
+	
+	NSString *blockingConnectionName;
+	uint64_t blockingTransactionID;
+	BOOL blockingReadWrite;
+}
+@end
+
+/**
+ * Tracks the transaction currently holding a queue (the connectionQueue, writeQueue or snapshotQueue),
+ * so that a waiting transaction can report what it was waiting on.
+ *
+ * The holder is updated from within the queue, and read from any thread.
+**/
+@interface YapDatabaseQueueHolder : NSObject
+
+- (void)enterWithConnectionName:(nullable NSString *)name transactionID:(uint64_t)transactionID readWrite:(BOOL)readWrite;
+- (void)exit;
+
+/**
+ * Returns a new event, with the blocking fields set to the current holder.
+**/
+- (YapDatabaseQueueWaitEvent *)newWaitEvent;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,92 @@
+#import <Foundation/Foundation.h>
+
+/**
+ * YapDatabase emits os_signpost intervals for its expensive operations,
+ * so they show up as named intervals in Instruments (instead of anonymous blocks on the internal queues):
+ *
+ * - "Read Transaction" / "ReadWrite Transaction" (with the connection name)
+ * - "Commit" & "Sync"
+ * - "Checkpoint" (with the mode: passive, aggressive, full, restart or truncate)
+ * - "Extension Populate" & "Extension Flush" (with the extension name)
+ * - "Process Changeset"
+ * - "View Changes"
+ *
+ * All signposts use the subsystem "com.yapstudios.YapDatabase" & category "Performance".
+ * The YapDatabase.instrpkg package (in the Instruments directory) visualizes them.
+ *
+ * When Instruments isn't recording, each signpost costs a single (cached) os_signpost_enabled check.
+ * To compile the signposts out entirely, define YapDatabaseSignpostsEnabled as 0 in your build settings.
+ *
+ * You are strongly discouraged from modifying this file.
+ * Instead, override the default value in your own application.
+**/
+
+#ifndef YapDatabaseSignpostsEnabled
+#define YapDatabaseSignpostsEnabled 1
+#endif
+
+#if YapDatabaseSignpostsEnabled && !__has_include(<os/signpost.h>)
+#undef  YapDatabaseSignpostsEnabled
+#define YapDatabaseSignpostsEnabled 0
+#endif
+
+/**
+ * An interval id, as returned by YDBSignpostBegin.
+ * Zero means the interval isn't being recorded.
+**/
+typedef uint64_t YDBSignpostID;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#if YapDatabaseSignpostsEnabled
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#import <os/signpost.h>
+
+#define YDBSignpostAvailable @available(macOS 10.14, iOS 12.0, tvOS 12.0, watchOS 5.0, *)
+
+/**
+ * Returns the (shared) log used by all of the signposts,
+ * or NULL if os_signpost isn't available on this version of the OS.
+**/
+os_log_t YapDatabaseSignpostLog(void);
+
+/**
+ * Begins an interval, and evaluates to its id (or zero if the interval isn't being recorded).
+ * The name & format must be string literals.
+ *
+ * YDBSignpostID spid = YDBSignpostBegin("Commit", "snapshot: %llu", snapshot);
+**/
+#define YDBSignpostBegin(name, ...) ({                                                     \
+    YDBSignpostID _spid = 0;                                                             \
+    if (YDBSignpostAvailable) {                                                          \
+        os_log_t _log = YapDatabaseSignpostLog();                                        \
+        if (os_signpost_enabled(_log)) {                                                 \
+            _spid = os_signpost_id_generate(_log);                                       \
+            os_signpost_interval_begin(_log, (os_signpost_id_t)_spid, name, ##__VA_ARGS__); \
+        }                                                                                \
+    }                                                                                    \
+    _spid; })
+
+/**
+ * Ends the interval with the given id (a no-op if the id is zero).
+ * The name must match the name given to YDBSignpostBegin.
+**/
+#define YDBSignpostEnd(spid, name, ...) do {                                             \
+    YDBSignpostID _spid = (spid);                                                        \
+    if (_spid != 0) {                                                                    \
+        if (YDBSignpostAvailable) {                                                      \
+            os_signpost_interval_end(YapDatabaseSignpostLog(), (os_signpost_id_t)_spid, name, ##__VA_ARGS__); \
+        }                                                                                \
+    }                                                                                    \
+} while (0)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#else
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Signposts Disabled
+
+#define YDBSignpostBegin(name, ...)     ((YDBSignpostID)0)
+#define YDBSignpostEnd(spid, name, ...) do { (void)(spid); } while (0)
+
+#endif
@@ -0,0 +1,25 @@
+#import "YapDatabaseSignposts.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+#if YapDatabaseSignpostsEnabled
+
+os_log_t YapDatabaseSignpostLog(void)
+{
+	static os_log_t signpostLog = NULL;
+	static dispatch_once_t onceToken;
+	
+	dispatch_once(&onceToken, ^{
+		
+		if (YDBSignpostAvailable)
+		{
+			signpostLog = os_log_create("com.yapstudios.YapDatabase", "Performance");
+		}
+	});
+	
+	return signpostLog;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseSlowQuery.h"
+#import "sqlite3.h"
+
+#import <mach/mach_time.h>
+
+@class YapDatabase;
+@class YapDatabaseReadTransaction;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseSlowQuery ()
+
+- (instancetype)initWithExtensionName:(NSString *)extensionName
+                                  sql:(NSString *)sql
+                      parameterShapes:(NSArray<NSString *> *)parameterShapes
+                            queryPlan:(NSArray<NSString *> *)queryPlan
+                             rowCount:(NSUInteger)rowCount
+                             duration:(NSTimeInterval)duration;
+
+@end
+
+/**
+ * Converts the given threshold (in seconds) to mach ticks.
+ * Returns zero (disabled) for non-positive values.
+**/
+uint64_t YapDatabaseSlowQueryThresholdTicks(NSTimeInterval threshold);
+
+/**
+ * Used by extensions to profile their (dynamically generated) queries.
+ *
+ * The profile is a simple stack variable. The usage pattern is:
+ *
+ * YapDatabaseQueryProfile profile;
+ * YapDatabaseQueryProfileBegin(&profile, databaseTransaction->connection->database);
+ *
+ * while ((status = YapDatabaseQueryProfileStep(&profile, statement)) == SQLITE_ROW) { ... }
+ *
+ * if (YapDatabaseQueryProfileIsSlow(&profile)) {
+ *     YapDatabaseQueryProfileReport(&profile, databaseTransaction, statement, params, registeredName);
+ * }
+ *
+ * When the slow query log is disabled (or the query isn't sampled),
+ * the step function is simply sqlite3_step (plus a single branch).
+**/
+typedef struct {
+	uint64_t thresholdTicks; // zero if this execution isn't being profiled
+	uint64_t stepTicks;
+	NSUInteger rowCount;
+} YapDatabaseQueryProfile;
+
+/**
+ * Decides (via the database's threshold & sample rate) whether or not the query is to be profiled.
+**/
+void YapDatabaseQueryProfileBegin(YapDatabaseQueryProfile *profile, YapDatabase *database);
+
+NS_INLINE int YapDatabaseQueryProfileStep(YapDatabaseQueryProfile *profile, sqlite3_stmt *statement)
+{
+	if (profile->thresholdTicks == 0) return sqlite3_step(statement);
+	
+	uint64_t start = mach_absolute_time();
+	int status = sqlite3_step(statement);
+	profile->stepTicks += (mach_absolute_time() - start);
+	
+	if (status == SQLITE_ROW) profile->rowCount++;
+	return status;
+}
+
+NS_INLINE BOOL YapDatabaseQueryProfileIsSlow(const YapDatabaseQueryProfile *profile)
+{
+	return (profile->thresholdTicks > 0) && (profile->stepTicks >= profile->thresholdTicks);
+}
+
+/**
+ * Generates the query plan for the statement, and hands the report to the database's slow query handler.
+ *
+ * Must be invoked from within the transaction that executed the statement
+ * (as the query plan is generated using the same sqlite connection).
+ * The statement may have already been reset.
+**/
+void YapDatabaseQueryProfileReport(const YapDatabaseQueryProfile *profile,
+                                   YapDatabaseReadTransaction *transaction,
+                                   sqlite3_stmt *statement,
+                                   NSArray *_Nullable parameters,
+                                   NSString *extensionName);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,47 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseStatistics.h"
+#import "YapCache.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseCacheStatistics ()
+
+- (instancetype)initWithCache:(nullable YapCache *)cache;
+
+/**
+ * Sums the given statistics.
+**/
++ (YapDatabaseCacheStatistics *)statisticsByMergingStatistics:(NSArray<YapDatabaseCacheStatistics *> *)statistics;
+
+@end
+
+@interface YapDatabaseConnectionStatistics () {
+@public
+	
+	NSString *name;
+	
+	uint64_t snapshot;
+	uint64_t snapshotLag;
+	BOOL hasLongLivedReadTransaction;
+	NSUInteger pendingChangesetCount;
+	NSUInteger preparedStatementCount;
+	uint64_t mmapSize;
+	uint64_t pageCacheUsed;
+	
+	YapDatabaseCacheStatistics *objectCache;
+	YapDatabaseCacheStatistics *metadataCache;
+	NSDictionary<NSString *, YapDatabaseCacheStatistics *> *extensionCaches;
+}
+@end
+
+@interface YapDatabaseStatistics ()
+
+- (instancetype)initWithSnapshot:(uint64_t)snapshot
+                         walSize:(uint64_t)walSize
+                    databaseSize:(uint64_t)databaseSize
+                changesetBacklog:(NSUInteger)changesetBacklog
+                     connections:(NSArray<YapDatabaseConnectionStatistics *> *)connections;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,53 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseStorageReport.h"
+#import "sqlite3.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Generates a storage report in small steps, so that the work may be spread over multiple read transactions.
+ *
+ * Steps:
+ * - the first step reads the pragmas, the schema & the names of the extensions
+ * - each btree (table or index) is then measured in its own step (via dbstat)
+ * - the rows are then measured (by collection), a batch of rows per step
+**/
+@interface YapDatabaseStorageReportBuilder : NSObject
+
+/**
+ * @param walPath
+ *   The path of the WAL file (its size is included in the report).
+ *
+ * @param extensionNames
+ *   The names of the registered extensions. The names found in the "yap2" table are added to these,
+ *   so the tables of extensions that are no longer registered are attributed too.
+**/
+- (instancetype)initWithWALPath:(NSString *)walPath extensionNames:(NSArray<NSString *> *)extensionNames;
+
+/**
+ * Performs the next step (within a read transaction on the given database).
+ * Returns YES once the report is complete.
+**/
+- (BOOL)stepWithDatabase:(sqlite3 *)db;
+
+/**
+ * An estimate of the total number of units, and how many have been completed so far.
+ * (Each btree is a unit, and so is each row.)
+**/
+@property (nonatomic, readonly) int64_t totalUnitCount;
+@property (nonatomic, readonly) int64_t completedUnitCount;
+
+/**
+ * Set to NO if the steps span multiple transactions.
+ * The default value is YES.
+**/
+@property (nonatomic, assign, readwrite) BOOL consistent;
+
+/**
+ * The report. Only valid once the final step has completed.
+**/
+- (YapDatabaseStorageReport *)report;
+
+@end
+
+NS_ASSUME_NONNULL_END
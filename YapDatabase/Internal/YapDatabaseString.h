@@ -17,6 +17,10 @@
  * Considering that almost all keys are likely to be relatively small,
  * a much faster technique is to use the stack instead of the heap (with obvious precautions, see below).
  * 
+ * Even better, many strings already have a UTF-8 (ASCII) representation we can point at directly.
+ * For example, string literals such as most collection names & extension names.
+ * For these we skip the copy entirely, and bind the string's own buffer.
+ * 
  * Note: This technique ONLY applies to key names and collection names.
  * It does NOT apply to object/primitiveData or metadata. Those are binded to sqlite3 statements using binary blobs.
 **/
@@ -27,8 +31,10 @@
  * This is possibe if really huge key names or collection names are used.
  *
  * The number below represents the largest amount of memory (in bytes) that will be allocated on the stack per string.
+ * It's deliberately small (keys are typically identifiers, e.g. a UUID is 36 bytes),
+ * as every binding touches this much stack.
 **/
-#define YapDatabaseStringMaxStackLength (1024 * 4)
+#define YapDatabaseStringMaxStackLength 256
 
 /**
  * Struct designed to be allocated on the stack.
@@ -48,7 +54,9 @@
  * str    - Pointer to the char[] string.
  * length - Represents the length (in bytes) of the char[] str (excluding the NULL termination byte, as usual).
  * 
- * The other 2 "private" fields are for internal use:
+ * The other 3 "private" fields are for internal use:
+ * strRef   - If the NSString exposes its own UTF-8 buffer (CFStringGetCStringPtr),
+ *            then str points to it, and strRef retains the string until the teardown.
  * strStack - If the string doesn't exceed YapDatabaseStringMaxStackLength,
  *            then the bytes are copied here (onto stack storage), and str actually points to strStack.
  * strHeap  - If the string exceeds YapDatabaseStringMaxStackLength,
@@ -62,7 +70,8 @@ struct YapDatabaseString {
 	int length;
 	char strStack[YapDatabaseStringMaxStackLength];
 	char *strHeap;
-	char *str; // Pointer to either strStack or strHeap
+	CFStringRef strRef;
+	const char *str; // Pointer to either strStack, strHeap, or the buffer of strRef
 };
 typedef struct YapDatabaseString YapDatabaseString;
 
@@ -80,24 +89,38 @@ NS_INLINE void MakeYapDatabaseString(YapDatabaseString *dbStr, NSString *nsStr)
 		// So we can change it to int here, or we can cast everywhere throughout the project.
 		
 		dbStr->length = (int)[nsStr lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
-	
+		
+		const char *ptr = CFStringGetCStringPtr((__bridge CFStringRef)nsStr, kCFStringEncodingUTF8);
+		if (ptr)
+		{
+			dbStr->strHeap = NULL;
+			dbStr->strRef = (CFStringRef)CFRetain((__bridge CFStringRef)nsStr);
+			dbStr->str = ptr;
+			return;
+		}
+		
+		dbStr->strRef = NULL;
+		
+		char *buffer;
 		if ((dbStr->length + 1) <= YapDatabaseStringMaxStackLength)
 		{
 			dbStr->strHeap = NULL;
-			dbStr->str = dbStr->strStack;
+			buffer = dbStr->strStack;
 		}
 		else
 		{
 			dbStr->strHeap = (char *)malloc((dbStr->length + 1));
-			dbStr->str = dbStr->strHeap;
+			buffer = dbStr->strHeap;
 		}
-	
-		[nsStr getCString:dbStr->str maxLength:(dbStr->length + 1) encoding:NSUTF8StringEncoding];
+		
+		[nsStr getCString:buffer maxLength:(dbStr->length + 1) encoding:NSUTF8StringEncoding];
+		dbStr->str = buffer;
 	}
 	else
 	{
 		dbStr->length = 0;
 		dbStr->strHeap = NULL;
+		dbStr->strRef = NULL;
 		dbStr->str = NULL;
 	}
 }
@@ -105,8 +128,9 @@ NS_INLINE void MakeYapDatabaseString(YapDatabaseString *dbStr, NSString *nsStr)
 /**
  * If heap storage was needed (because the string length exceeded YapDatabaseStringMaxStackLength),
  * this method frees the heap allocated memory.
+ * If the string's own buffer was used, this method releases the string.
  *
- * In the common case of stack storage, strHeap will be NULL, and this method is essentially a no-op.
+ * In the common case of stack storage, strHeap & strRef will be NULL, and this method is essentially a no-op.
  * 
  * This method should be invoked AFTER sqlite3_clear_bindings (assuming SQLITE_STATIC is used).
 **/
@@ -118,4 +142,10 @@ NS_INLINE void FreeYapDatabaseString(YapDatabaseString *dbStr)
 		dbStr->strHeap = NULL;
 		dbStr->str = NULL;
 	}
+	else if (dbStr->strRef)
+	{
+		CFRelease(dbStr->strRef);
+		dbStr->strRef = NULL;
+		dbStr->str = NULL;
+	}
 }
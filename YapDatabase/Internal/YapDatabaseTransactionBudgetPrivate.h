@@ -0,0 +1,39 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseTransactionBudget.h"
+
+#import <mach/mach.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The maximum number of frames captured by YapDatabaseSampleThread.
+**/
+#define YAP_TRANSACTION_BUDGET_MAX_FRAMES 64
+
+/**
+ * Suspends the given thread, walks its stack (via the frame pointers), and resumes it.
+ * Returns the number of return addresses written to the given array (zero if the thread couldn't be sampled).
+ *
+ * Nothing is allocated while the thread is suspended, as it may be holding the malloc lock (or any other lock).
+ * The given thread must not be the current thread.
+**/
+NSUInteger YapDatabaseSampleThread(thread_t thread, uintptr_t *addresses, NSUInteger maxCount);
+
+/**
+ * Symbolicates the given addresses (via dladdr), in the format of +[NSThread callStackSymbols].
+**/
+NSArray<NSString *> * YapDatabaseSymbolicateAddresses(const uintptr_t *addresses, NSUInteger count);
+
+
+@interface YapDatabaseTransactionBudgetReport ()
+
+- (instancetype)initWithConnectionName:(nullable NSString *)connectionName
+                             readWrite:(BOOL)readWrite
+                                budget:(NSTimeInterval)budget
+                              duration:(NSTimeInterval)duration
+                               metrics:(YapDatabaseTransactionMetrics *)metrics
+                      callStackSymbols:(NSArray<NSString *> *)callStackSymbols;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,74 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseTransactionMetrics.h"
+#import "YapCache.h"
+
+#import <mach/mach_time.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface YapDatabaseTransactionMetrics () {
+@public
+	
+	BOOL didRollback;
+	uint64_t snapshot;
+	
+	// All times are in mach_absolute_time units, except for sqliteNanoseconds (reported by sqlite).
+	
+	uint64_t startTime;
+	uint64_t blockStartTime;
+	
+	uint64_t totalTicks;
+	uint64_t blockTicks;
+	uint64_t preCommitTicks;
+	uint64_t changesetTicks;
+	uint64_t writeLockWaitTicks;
+	uint64_t commitTicks;
+	uint64_t checkpointTicks;
+	
+	uint64_t sqliteNanoseconds;
+	NSUInteger sqliteStatementCount;
+	
+	uint64_t serializationTicks;
+	NSUInteger serializationCount;
+	
+	uint64_t deserializationTicks;
+	NSUInteger deserializationCount;
+	
+	YapCacheLookupCounters objectCacheCounters;
+	YapCacheLookupCounters metadataCacheCounters;
+}
+
+- (void)addHookTicks:(uint64_t)ticks forExtension:(NSString *)extensionName;
+- (void)addFlushTicks:(uint64_t)ticks forExtension:(NSString *)extensionName;
+
+@end
+
+/**
+ * The metrics for the transaction that's currently executing on this thread (if any).
+ * 
+ * This is for the code that doesn't have access to the transaction,
+ * such as the deserialization functions, and the sqlite trace callback.
+ * The pointer isn't retained. (The connection retains the metrics for the duration of the transaction.)
+**/
+YapDatabaseTransactionMetrics *_Nullable YapDatabaseTransactionMetricsGetCurrent(void);
+void YapDatabaseTransactionMetricsSetCurrent(YapDatabaseTransactionMetrics *_Nullable metrics);
+
+/**
+ * Returns the start time for a measurement, or zero if there are no metrics to record it in.
+**/
+NS_INLINE uint64_t YapDatabaseTransactionMetricsStart(YapDatabaseTransactionMetrics *_Nullable metrics)
+{
+	return metrics ? mach_absolute_time() : 0;
+}
+
+NS_INLINE uint64_t YapDatabaseTransactionMetricsElapsed(uint64_t startTime)
+{
+	return mach_absolute_time() - startTime;
+}
+
+/**
+ * Converts a duration in mach_absolute_time units to seconds.
+**/
+NSTimeInterval YapDatabaseTicksToSeconds(uint64_t ticks);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,24 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseWALPinning.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Returns the number of frames within a WAL file of the given size.
+ * Each frame is a 24 byte header followed by a page, and the file starts with a 32 byte header.
+**/
+NSUInteger YapDatabaseWALFrameCount(uint64_t walSize, uint64_t pageSize);
+
+@interface YapDatabaseWALPinningReport ()
+
+- (instancetype)initWithConnectionName:(nullable NSString *)connectionName
+                longLivedReadTransaction:(BOOL)longLivedReadTransaction
+                                snapshot:(uint64_t)snapshot
+                        databaseSnapshot:(uint64_t)databaseSnapshot
+                                duration:(NSTimeInterval)duration
+                                 walSize:(uint64_t)walSize
+                           walFrameCount:(NSUInteger)walFrameCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
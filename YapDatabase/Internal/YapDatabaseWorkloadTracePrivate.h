@@ -0,0 +1,111 @@
+#import <Foundation/Foundation.h>
+#import "YapDatabaseWorkloadTrace.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class YapDatabaseWorkloadTraceBuffer;
+
+@interface YapDatabaseWorkloadTraceRecorder ()
+
+/**
+ * Each connection that records into the trace is assigned a unique (per recorder) id.
+**/
+- (uint32_t)nextConnectionID;
+
+/**
+ * Returns a new buffer for the events of a single transaction.
+ * Invoke at the very beginning of the transaction.
+**/
+- (YapDatabaseWorkloadTraceBuffer *)beginTransactionWithConnectionID:(uint32_t)connectionID
+                                                          readWrite:(BOOL)isReadWrite;
+
+@end
+
+/**
+ * Collects the events of a single transaction (on a single connection), so no locking is needed.
+ * When the transaction completes, the events are handed to the recorder as a single record.
+**/
+@interface YapDatabaseWorkloadTraceBuffer : NSObject
+
+- (void)recordOperation:(YapDatabaseWorkloadTraceOperation)operation
+             collection:(NSString *)collection
+                    key:(NSString *)key;
+
+- (void)recordEnumeration:(YapDatabaseWorkloadTraceEnumeration)enumeration
+             inCollection:(NSString *)collection;
+
+/**
+ * If there's no metadata, pass NSNotFound for the metadataSize.
+**/
+- (void)recordSetRowWithCollection:(NSString *)collection
+                               key:(NSString *)key
+                        objectSize:(NSUInteger)objectSize
+                      metadataSize:(NSUInteger)metadataSize;
+
+- (void)recordReplaceObjectWithCollection:(NSString *)collection key:(NSString *)key objectSize:(NSUInteger)size;
+- (void)recordReplaceMetadataWithCollection:(NSString *)collection key:(NSString *)key metadataSize:(NSUInteger)size;
+
+- (void)recordRemoveCollection:(NSString *)collection;
+- (void)recordRemoveAll;
+
+- (void)recordExtension:(NSString *)extensionName;
+
+/**
+ * Hands the transaction record to the recorder. Invoke at the very end of the transaction.
+**/
+- (void)finishWithRollback:(BOOL)didRollback;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Reading
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const uint8_t YapDatabaseWorkloadTraceFlagReadWrite = (1 << 0);
+static const uint8_t YapDatabaseWorkloadTraceFlagRollback  = (1 << 1);
+
+typedef struct {
+	const uint8_t *bytes;
+	size_t length;
+	size_t offset;
+	BOOL failed;
+} YapWorkloadTraceReader;
+
+typedef struct {
+	uint32_t connectionID;
+	uint8_t flags;
+	uint64_t start;    // microseconds
+	uint64_t duration; // microseconds
+	uint64_t eventCount;
+} YapWorkloadTraceTransactionHeader;
+
+typedef struct {
+	uint8_t operation;
+	uint64_t collection;
+	uint64_t key;
+	uint64_t size;         // object size (or metadata size + 1, for ReplaceMetadata)
+	uint64_t metadataSize; // metadata size + 1 (SetRow)
+	uint8_t enumeration;
+	const uint8_t *_Nullable name;
+	size_t nameLength;
+} YapWorkloadTraceEvent;
+
+/**
+ * Loads the trace at the given path (memory mapped if possible).
+ * Returns nil if the file couldn't be read, or isn't a (supported) workload trace.
+**/
+NSData *_Nullable YapWorkloadTraceLoad(NSString *_Nullable path);
+
+/**
+ * Returns a reader positioned at the first transaction record of the given (loaded) trace.
+**/
+YapWorkloadTraceReader YapWorkloadTraceReaderMake(NSData *trace);
+
+/**
+ * Each transaction record is a header, followed by header.eventCount events.
+ * These return NO (and mark the reader as failed) if the record is truncated or malformed.
+**/
+BOOL YapWorkloadTraceReadTransactionHeader(YapWorkloadTraceReader *reader, YapWorkloadTraceTransactionHeader *header);
+BOOL YapWorkloadTraceReadEvent(YapWorkloadTraceReader *reader, YapWorkloadTraceEvent *event);
+
+NS_ASSUME_NONNULL_END
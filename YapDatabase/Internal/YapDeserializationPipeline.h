@@ -0,0 +1,69 @@
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A single row flowing through the pipeline.
+ *
+ * The enumerating thread fills in the rowid, key & (copied) blobs.
+ * A worker thread deserializes the blobs into object & metadata.
+ * If a blob is nil, the corresponding value is considered ready (e.g. it was found in the cache).
+**/
+@interface YapDeserializationItem : NSObject {
+@public
+	int64_t rowid;
+	NSString *key;
+	
+	NSData *_Nullable objectData;
+	NSData *_Nullable metadataData;
+	
+	id _Nullable object;
+	id _Nullable metadata;
+	
+	BOOL cacheObject;   // YES if the object wasn't found in the cache
+	BOOL cacheMetadata; // YES if the metadata wasn't found in the cache
+	
+	atomic_bool finished;
+}
+@end
+
+typedef void (^YapDeserializationPipelineWorker)(YapDeserializationItem *item);
+typedef void (^YapDeserializationPipelineHandler)(YapDeserializationItem *item, BOOL *stop);
+
+/**
+ * Used by the enumeration methods of YapDatabaseReadTransaction
+ * when YapDatabaseEnumerationConcurrentDeserialization is requested.
+ *
+ * The enumerating thread continues stepping the sqlite statement while a bounded number of rows
+ * are deserialized concurrently on the global queue. The handler is always invoked on the enumerating thread,
+ * either in the order in which the rows were enqueued, or (if unordered) as soon as each row is ready.
+ *
+ * This class is not thread-safe. It must be used from a single (enumerating) thread.
+**/
+@interface YapDeserializationPipeline : NSObject
+
+- (instancetype)initWithWindowSize:(NSUInteger)windowSize
+                           ordered:(BOOL)ordered
+                            worker:(YapDeserializationPipelineWorker)worker
+                           handler:(YapDeserializationPipelineHandler)handler;
+
+/**
+ * Enqueues the item, blocking if the window is full.
+ * Any items that are ready are delivered to the handler before this method returns.
+ *
+ * Returns NO if the handler requested a stop, in which case the enumeration should be halted.
+**/
+- (BOOL)enqueue:(YapDeserializationItem *)item;
+
+/**
+ * Waits for all outstanding items, and delivers them to the handler (unless a stop was requested).
+ * This method must be invoked once the enumeration is complete (or halted).
+**/
+- (void)finish;
+
+@property (nonatomic, assign, readonly) BOOL stopped;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,144 @@
+#import "YapDeserializationPipeline.h"
+
+
+@implementation YapDeserializationItem
+@end
+
+@implementation YapDeserializationPipeline
+{
+	NSUInteger windowSize;
+	BOOL ordered;
+	
+	YapDeserializationPipelineWorker worker;
+	YapDeserializationPipelineHandler handler;
+	
+	dispatch_queue_t workQueue;
+	dispatch_group_t group;
+	dispatch_semaphore_t completionSemaphore; // signaled once per finished item
+	
+	NSMutableArray<YapDeserializationItem *> *outstanding; // in enqueue order
+	
+	BOOL stopped;
+}
+
+@synthesize stopped = stopped;
+
+- (instancetype)initWithWindowSize:(NSUInteger)inWindowSize
+                           ordered:(BOOL)inOrdered
+                            worker:(YapDeserializationPipelineWorker)inWorker
+                           handler:(YapDeserializationPipelineHandler)inHandler
+{
+	if ((self = [super init]))
+	{
+		windowSize = MAX(inWindowSize, (NSUInteger)1);
+		ordered = inOrdered;
+		
+		worker = [inWorker copy];
+		handler = [inHandler copy];
+		
+		workQueue = dispatch_get_global_queue(qos_class_self(), 0);
+		group = dispatch_group_create();
+		completionSemaphore = dispatch_semaphore_create(0);
+		
+		outstanding = [[NSMutableArray alloc] initWithCapacity:windowSize];
+	}
+	return self;
+}
+
+- (BOOL)enqueue:(YapDeserializationItem *)item
+{
+	if (stopped) return NO;
+	
+	// Block until there's room in the window
+	
+	while (outstanding.count >= windowSize)
+	{
+		if (![self deliverReadyItems])
+		{
+			dispatch_semaphore_wait(completionSemaphore, DISPATCH_TIME_FOREVER);
+		}
+		
+		if (stopped) return NO;
+	}
+	
+	[outstanding addObject:item];
+	
+	if (item->objectData == nil && item->metadataData == nil)
+	{
+		atomic_store_explicit(&item->finished, true, memory_order_release);
+		dispatch_semaphore_signal(completionSemaphore);
+	}
+	else
+	{
+		YapDeserializationPipelineWorker workerBlock = worker;
+		dispatch_semaphore_t semaphore = completionSemaphore;
+		
+		dispatch_group_async(group, workQueue, ^{ @autoreleasepool {
+			
+			workerBlock(item);
+			
+			// The blobs are no longer needed
+			item->objectData = nil;
+			item->metadataData = nil;
+			
+			atomic_store_explicit(&item->finished, true, memory_order_release);
+			dispatch_semaphore_signal(semaphore);
+		}});
+	}
+	
+	[self deliverReadyItems];
+	
+	return !stopped;
+}
+
+- (void)finish
+{
+	while (!stopped && outstanding.count > 0)
+	{
+		if (![self deliverReadyItems])
+		{
+			dispatch_semaphore_wait(completionSemaphore, DISPATCH_TIME_FOREVER);
+		}
+	}
+	
+	// If the enumeration was halted, the remaining in-flight items are discarded.
+	// But we still wait for them, so no work outlives the enumeration.
+	
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	[outstanding removeAllObjects];
+}
+
+/**
+ * Delivers every item that can be delivered right now.
+ * Returns YES if at least one item was delivered.
+**/
+- (BOOL)deliverReadyItems
+{
+	BOOL delivered = NO;
+	NSUInteger i = 0;
+	
+	while (!stopped && i < outstanding.count)
+	{
+		YapDeserializationItem *item = outstanding[i];
+		
+		if (!atomic_load_explicit(&item->finished, memory_order_acquire))
+		{
+			if (ordered) break;
+			
+			i++;
+			continue;
+		}
+		
+		[outstanding removeObjectAtIndex:i];
+		delivered = YES;
+		
+		BOOL stop = NO;
+		handler(item, &stop);
+		
+		if (stop) stopped = YES;
+	}
+	
+	return delivered;
+}
+
+@end
@@ -10,6 +10,10 @@
  * The memory table is accessed via a YapMemoryTableTransaction instance,
  * which is itself associated with a particular timestamp. Thus the transaction is able to properly identify
  * which version is appropriate for itself.
+ * 
+ * Each commit publishes a new immutable version of the table (sharing unmodified structure with older versions).
+ * So read transactions never block, not even while a read-write transaction is modifying the table.
+ * Modifications are only visible to the read-write transaction itself, until it commits.
 **/
 @interface YapMemoryTable : NSObject
 
@@ -32,6 +36,12 @@
 **/
 - (void)asyncCheckpoint:(int64_t)minSnapshot;
 
+/**
+ * Returns the estimated memory footprint of the table (in bytes), including every retained version.
+ * Nodes that are shared between versions are only counted once.
+**/
+- (uint64_t)estimatedMemoryUsage;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -61,6 +71,7 @@
 
 //
 // Batch access / modifications
+// (Retained for compatibility. These simply invoke the block, as no synchronization is required.)
 
 - (void)accessWithBlock:(dispatch_block_t)block;
 - (void)modifyWithBlock:(dispatch_block_t)block;
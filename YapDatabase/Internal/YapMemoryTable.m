@@ -1,4 +1,13 @@
 #import "YapMemoryTable.h"
+#import "YapDatabaseAtomic.h"
+#import "YapDatabaseMemoryReportPrivate.h"
+
+#import <stdatomic.h>
+#import <malloc/malloc.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
 
 
 /**
@@ -6,30 +15,559 @@
  * In other words, the value in the database at snapshot A may be different than at snapshot B.
  * Each value is correct, and depends entirely on the snapshot being used by the transaction.
  *
- * This presents a unique property of the table:
- * - the table may store multiple values for a single key.
- * - the stored values are associated with a snapshot
+ * The table is stored as an immutable (persistent) hash array mapped trie.
+ * Every commit publishes a new root (a "version"), which shares all unmodified nodes with the previous version.
+ * A read transaction simply grabs the version for its snapshot, and from then on reads are lock-free:
+ * a published node is never modified again.
+ *
+ * The read-write transaction (there's only ever one at a time) builds the next version.
+ * Nodes that were created by the current read-write transaction (and thus aren't yet visible to anybody else)
+ * are modified in place. All other nodes are copied on write.
+ *
+ * Old versions are discarded by asyncCheckpoint:, once no transaction can be using them.
+**/
+
+#define YAP_MEMORY_TABLE_BITS      5
+#define YAP_MEMORY_TABLE_MASK      0x1F
+#define YAP_MEMORY_TABLE_HASH_BITS 64
+
+static inline uint64_t YapMemoryTableHash(id key)
+{
+	// splitmix64 finalizer
+	uint64_t hash = (uint64_t)[key hash];
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+	
+	return hash;
+}
+
+static inline uint32_t YapMemoryTableBit(uint64_t hash, unsigned shift)
+{
+	return (uint32_t)1 << ((hash >> shift) & YAP_MEMORY_TABLE_MASK);
+}
+
+/**
+ * A single node within the trie.
  *
- * This class represents a single stored value and its associated snapshot.
- * It is one value contained within a linked-list of possibly multiple values for the same key.
- * The linked-list remains sorted, with the most recent value at the front of the linked-list.
- **/
-@interface YapMemoryTableValue : NSObject {
+ * Regular nodes are CHAMP-style: the slots array contains the key/object pairs (in bitmap order),
+ * followed by the child nodes (in bitmap order).
+ *
+ * Collision nodes are only used once all hash bits have been consumed,
+ * and contain a (linearly searched) list of key/object pairs.
+**/
+@interface YapMemoryTableNode : NSObject {
 @public
-	YapMemoryTableValue *olderValue;
 	
-	uint64_t snapshot;
-	id object;
+	uint64_t edit;       // The read-write transaction that created the node (and may thus modify it in place)
+	
+	uint32_t dataMap;    // Bits with an inline key/object pair
+	uint32_t nodeMap;    // Bits with a child node
+	
+	uint32_t slotCount;
+	BOOL isCollision;
+	
+	__strong id *slots;
+}
+@end
+
+@implementation YapMemoryTableNode
+
+- (void)dealloc
+{
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		slots[i] = nil;
+	}
+	free(slots);
+}
+
+@end
+
+static YapMemoryTableNode *YapMemoryTableNodeCreate(uint64_t edit, uint32_t slotCount)
+{
+	YapMemoryTableNode *node = [[YapMemoryTableNode alloc] init];
+	node->edit = edit;
+	node->slotCount = slotCount;
+	node->slots = (__strong id *)calloc(slotCount, sizeof(id));
+	
+	return node;
+}
+
+static inline uint32_t YapMemoryTableDataIndex(__unsafe_unretained YapMemoryTableNode *node, uint32_t bit)
+{
+	return (uint32_t)__builtin_popcount(node->dataMap & (bit - 1)) * 2;
+}
+
+static inline uint32_t YapMemoryTableNodeIndex(__unsafe_unretained YapMemoryTableNode *node, uint32_t bit)
+{
+	return ((uint32_t)__builtin_popcount(node->dataMap) * 2) + (uint32_t)__builtin_popcount(node->nodeMap & (bit - 1));
+}
+
+/**
+ * A node containing exactly one key/object pair (and nothing else) gets inlined into its parent.
+**/
+static inline BOOL YapMemoryTableNodeIsSingleEntry(__unsafe_unretained YapMemoryTableNode *node)
+{
+	return (node->slotCount == 2) && (node->isCollision || node->nodeMap == 0);
+}
+
+/**
+ * Returns the node itself if it may be modified in place by the given edit.
+ * Otherwise returns a copy which may be.
+**/
+static YapMemoryTableNode *YapMemoryTableNodeEditable(YapMemoryTableNode *node, uint64_t edit)
+{
+	if (node->edit == edit) return node;
+	
+	YapMemoryTableNode *copy = YapMemoryTableNodeCreate(edit, node->slotCount);
+	copy->dataMap = node->dataMap;
+	copy->nodeMap = node->nodeMap;
+	copy->isCollision = node->isCollision;
+	
+	for (uint32_t i = 0; i < node->slotCount; i++)
+	{
+		copy->slots[i] = node->slots[i];
+	}
+	
+	return copy;
+}
+
+/**
+ * Structural changes always allocate a new slots array.
+ * The following helpers copy the given node, while inserting/removing/replacing slots.
+**/
+static YapMemoryTableNode *YapMemoryTableNodeCopyInsertingPair(YapMemoryTableNode *node, uint64_t edit,
+                                                               uint32_t index, id key, id object)
+{
+	YapMemoryTableNode *copy = YapMemoryTableNodeCreate(edit, node->slotCount + 2);
+	copy->dataMap = node->dataMap;
+	copy->nodeMap = node->nodeMap;
+	copy->isCollision = node->isCollision;
+	
+	for (uint32_t i = 0; i < index; i++) {
+		copy->slots[i] = node->slots[i];
+	}
+	copy->slots[index] = key;
+	copy->slots[index + 1] = object;
+	for (uint32_t i = index; i < node->slotCount; i++) {
+		copy->slots[i + 2] = node->slots[i];
+	}
+	
+	return copy;
+}
+
+static YapMemoryTableNode *YapMemoryTableNodeCopyRemovingPair(YapMemoryTableNode *node, uint64_t edit, uint32_t index)
+{
+	YapMemoryTableNode *copy = YapMemoryTableNodeCreate(edit, node->slotCount - 2);
+	copy->dataMap = node->dataMap;
+	copy->nodeMap = node->nodeMap;
+	copy->isCollision = node->isCollision;
+	
+	for (uint32_t i = 0; i < index; i++) {
+		copy->slots[i] = node->slots[i];
+	}
+	for (uint32_t i = index + 2; i < node->slotCount; i++) {
+		copy->slots[i - 2] = node->slots[i];
+	}
+	
+	return copy;
+}
+
+static YapMemoryTableNode *YapMemoryTableNodeCopyRemovingChild(YapMemoryTableNode *node, uint64_t edit, uint32_t index)
+{
+	YapMemoryTableNode *copy = YapMemoryTableNodeCreate(edit, node->slotCount - 1);
+	copy->dataMap = node->dataMap;
+	copy->nodeMap = node->nodeMap;
+	
+	for (uint32_t i = 0; i < index; i++) {
+		copy->slots[i] = node->slots[i];
+	}
+	for (uint32_t i = index + 1; i < node->slotCount; i++) {
+		copy->slots[i - 1] = node->slots[i];
+	}
+	
+	return copy;
+}
+
+/**
+ * Replaces the pair at dataIndex with the child, which is inserted at nodeIndex (an index into the original slots).
+**/
+static YapMemoryTableNode *YapMemoryTableNodeCopyPairToChild(YapMemoryTableNode *node, uint64_t edit,
+                                                             uint32_t dataIndex, uint32_t nodeIndex,
+                                                             YapMemoryTableNode *child)
+{
+	YapMemoryTableNode *copy = YapMemoryTableNodeCreate(edit, node->slotCount - 1);
+	copy->dataMap = node->dataMap;
+	copy->nodeMap = node->nodeMap;
+	
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < node->slotCount; i++)
+	{
+		if (i == nodeIndex) {
+			copy->slots[j++] = child;
+		}
+		if (i == dataIndex || i == dataIndex + 1) continue;
+		
+		copy->slots[j++] = node->slots[i];
+	}
+	if (nodeIndex == node->slotCount) {
+		copy->slots[j++] = child;
+	}
+	
+	return copy;
+}
+
+/**
+ * Replaces the child at nodeIndex with the pair, which is inserted at dataIndex (an index into the original slots).
+**/
+static YapMemoryTableNode *YapMemoryTableNodeCopyChildToPair(YapMemoryTableNode *node, uint64_t edit,
+                                                             uint32_t nodeIndex, uint32_t dataIndex,
+                                                             id key, id object)
+{
+	YapMemoryTableNode *copy = YapMemoryTableNodeCreate(edit, node->slotCount + 1);
+	copy->dataMap = node->dataMap;
+	copy->nodeMap = node->nodeMap;
+	
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < node->slotCount; i++)
+	{
+		if (i == dataIndex) {
+			copy->slots[j++] = key;
+			copy->slots[j++] = object;
+		}
+		if (i == nodeIndex) continue;
+		
+		copy->slots[j++] = node->slots[i];
+	}
+	
+	return copy;
+}
+
+/**
+ * Creates the subtree containing both pairs (whose hashes match up to the given shift).
+**/
+static YapMemoryTableNode *YapMemoryTableNodeMerge(uint64_t edit, unsigned shift,
+                                                   id key1, uint64_t hash1, id object1,
+                                                   id key2, uint64_t hash2, id object2)
+{
+	if (shift >= YAP_MEMORY_TABLE_HASH_BITS)
+	{
+		YapMemoryTableNode *node = YapMemoryTableNodeCreate(edit, 4);
+		node->isCollision = YES;
+		node->slots[0] = key1;
+		node->slots[1] = object1;
+		node->slots[2] = key2;
+		node->slots[3] = object2;
+		
+		return node;
+	}
+	
+	uint32_t bit1 = YapMemoryTableBit(hash1, shift);
+	uint32_t bit2 = YapMemoryTableBit(hash2, shift);
+	
+	if (bit1 == bit2)
+	{
+		YapMemoryTableNode *node = YapMemoryTableNodeCreate(edit, 1);
+		node->nodeMap = bit1;
+		node->slots[0] = YapMemoryTableNodeMerge(edit, shift + YAP_MEMORY_TABLE_BITS,
+		                                         key1, hash1, object1,
+		                                         key2, hash2, object2);
+		return node;
+	}
+	
+	YapMemoryTableNode *node = YapMemoryTableNodeCreate(edit, 4);
+	node->dataMap = bit1 | bit2;
+	
+	uint32_t i = (bit1 < bit2) ? 0 : 2;
+	node->slots[i]           = key1;
+	node->slots[i + 1]       = object1;
+	node->slots[2 - i]       = key2;
+	node->slots[2 - i + 1]   = object2;
+	
+	return node;
+}
+
+static id YapMemoryTableNodeGet(__unsafe_unretained YapMemoryTableNode *node, id key, uint64_t hash)
+{
+	unsigned shift = 0;
+	
+	while (node)
+	{
+		if (node->isCollision)
+		{
+			for (uint32_t i = 0; i < node->slotCount; i += 2)
+			{
+				if ([node->slots[i] isEqual:key]) return node->slots[i + 1];
+			}
+			return nil;
+		}
+		
+		uint32_t bit = YapMemoryTableBit(hash, shift);
+		
+		if (node->dataMap & bit)
+		{
+			uint32_t index = YapMemoryTableDataIndex(node, bit);
+			
+			if ([node->slots[index] isEqual:key]) return node->slots[index + 1];
+			return nil;
+		}
+		
+		if (node->nodeMap & bit)
+		{
+			node = node->slots[YapMemoryTableNodeIndex(node, bit)];
+			shift += YAP_MEMORY_TABLE_BITS;
+			continue;
+		}
+		
+		return nil;
+	}
+	
+	return nil;
+}
+
+/**
+ * Returns the modified node.
+ * This is the given node if it was modified in place (or if nothing changed).
+**/
+static YapMemoryTableNode *YapMemoryTableNodeSet(YapMemoryTableNode *node, uint64_t edit, unsigned shift,
+                                                 id key, uint64_t hash, id object)
+{
+	if (node == nil)
+	{
+		node = YapMemoryTableNodeCreate(edit, 2);
+		node->dataMap = YapMemoryTableBit(hash, shift);
+		node->slots[0] = [key copy];
+		node->slots[1] = object;
+		
+		return node;
+	}
+	
+	if (node->isCollision)
+	{
+		for (uint32_t i = 0; i < node->slotCount; i += 2)
+		{
+			if ([node->slots[i] isEqual:key])
+			{
+				if (node->slots[i + 1] == object) return node;
+				
+				node = YapMemoryTableNodeEditable(node, edit);
+				node->slots[i + 1] = object;
+				
+				return node;
+			}
+		}
+		
+		return YapMemoryTableNodeCopyInsertingPair(node, edit, node->slotCount, [key copy], object);
+	}
+	
+	uint32_t bit = YapMemoryTableBit(hash, shift);
+	
+	if (node->dataMap & bit)
+	{
+		uint32_t index = YapMemoryTableDataIndex(node, bit);
+		__unsafe_unretained id existingKey = node->slots[index];
+		
+		if ([existingKey isEqual:key])
+		{
+			if (node->slots[index + 1] == object) return node;
+			
+			node = YapMemoryTableNodeEditable(node, edit);
+			node->slots[index + 1] = object;
+			
+			return node;
+		}
+		
+		YapMemoryTableNode *child =
+		  YapMemoryTableNodeMerge(edit, shift + YAP_MEMORY_TABLE_BITS,
+		                          existingKey, YapMemoryTableHash(existingKey), node->slots[index + 1],
+		                          [key copy], hash, object);
+		
+		uint32_t nodeIndex = YapMemoryTableNodeIndex(node, bit);
+		
+		YapMemoryTableNode *copy = YapMemoryTableNodeCopyPairToChild(node, edit, index, nodeIndex, child);
+		copy->dataMap ^= bit;
+		copy->nodeMap |= bit;
+		
+		return copy;
+	}
+	
+	if (node->nodeMap & bit)
+	{
+		uint32_t index = YapMemoryTableNodeIndex(node, bit);
+		
+		YapMemoryTableNode *child = node->slots[index];
+		YapMemoryTableNode *newChild = YapMemoryTableNodeSet(child, edit, shift + YAP_MEMORY_TABLE_BITS, key, hash, object);
+		
+		if (newChild == child) return node;
+		
+		node = YapMemoryTableNodeEditable(node, edit);
+		node->slots[index] = newChild;
+		
+		return node;
+	}
+	
+	YapMemoryTableNode *copy =
+	  YapMemoryTableNodeCopyInsertingPair(node, edit, YapMemoryTableDataIndex(node, bit), [key copy], object);
+	copy->dataMap |= bit;
+	
+	return copy;
+}
+
+/**
+ * Returns the modified node, or nil if the node is now empty.
+ * This is the given node if it was modified in place (or if nothing changed).
+**/
+static YapMemoryTableNode *YapMemoryTableNodeRemove(YapMemoryTableNode *node, uint64_t edit, unsigned shift,
+                                                    id key, uint64_t hash)
+{
+	if (node == nil) return nil;
+	
+	if (node->isCollision)
+	{
+		for (uint32_t i = 0; i < node->slotCount; i += 2)
+		{
+			if ([node->slots[i] isEqual:key])
+			{
+				if (node->slotCount == 2) return nil;
+				
+				return YapMemoryTableNodeCopyRemovingPair(node, edit, i);
+			}
+		}
+		
+		return node;
+	}
+	
+	uint32_t bit = YapMemoryTableBit(hash, shift);
+	
+	if (node->dataMap & bit)
+	{
+		uint32_t index = YapMemoryTableDataIndex(node, bit);
+		
+		if (![node->slots[index] isEqual:key]) return node;
+		if (node->slotCount == 2) return nil;
+		
+		YapMemoryTableNode *copy = YapMemoryTableNodeCopyRemovingPair(node, edit, index);
+		copy->dataMap ^= bit;
+		
+		return copy;
+	}
+	
+	if (node->nodeMap & bit)
+	{
+		uint32_t index = YapMemoryTableNodeIndex(node, bit);
+		
+		YapMemoryTableNode *child = node->slots[index];
+		YapMemoryTableNode *newChild = YapMemoryTableNodeRemove(child, edit, shift + YAP_MEMORY_TABLE_BITS, key, hash);
+		
+		if (newChild == child) return node;
+		
+		if (newChild == nil)
+		{
+			if (node->slotCount == 1) return nil;
+			
+			YapMemoryTableNode *copy = YapMemoryTableNodeCopyRemovingChild(node, edit, index);
+			copy->nodeMap ^= bit;
+			
+			return copy;
+		}
+		
+		if (YapMemoryTableNodeIsSingleEntry(newChild))
+		{
+			// Inline the remaining pair into this node (keeps the trie canonical & shallow)
+			
+			YapMemoryTableNode *copy =
+			  YapMemoryTableNodeCopyChildToPair(node, edit, index, YapMemoryTableDataIndex(node, bit),
+			                                    newChild->slots[0], newChild->slots[1]);
+			copy->nodeMap ^= bit;
+			copy->dataMap |= bit;
+			
+			return copy;
+		}
+		
+		node = YapMemoryTableNodeEditable(node, edit);
+		node->slots[index] = newChild;
+		
+		return node;
+	}
+	
+	return node;
+}
+
+static void YapMemoryTableNodeEnumerate(__unsafe_unretained YapMemoryTableNode *node,
+                                        void (^block)(id key, id obj, BOOL *stop), BOOL *stop)
+{
+	if (node == nil) return;
+	
+	uint32_t dataSlots = node->isCollision ? node->slotCount : ((uint32_t)__builtin_popcount(node->dataMap) * 2);
+	
+	for (uint32_t i = 0; i < dataSlots; i += 2)
+	{
+		block(node->slots[i], node->slots[i + 1], stop);
+		if (*stop) return;
+	}
+	
+	for (uint32_t i = dataSlots; i < node->slotCount; i++)
+	{
+		YapMemoryTableNodeEnumerate(node->slots[i], block, stop);
+		if (*stop) return;
+	}
+}
+
+/**
+ * Adds the size of every node (and every key & object) reachable from the given node,
+ * skipping nodes that were already measured (i.e. nodes shared with another version).
+**/
+static uint64_t YapMemoryTableNodeEstimatedSize(__unsafe_unretained YapMemoryTableNode *node, NSHashTable *visitedNodes)
+{
+	if (node == nil) return 0;
+	if ([visitedNodes containsObject:node]) return 0;
+	
+	[visitedNodes addObject:node];
+	
+	uint64_t size = (uint64_t)malloc_size((__bridge const void *)node);
+	size += (uint64_t)malloc_size((const void *)node->slots);
+	
+	uint32_t dataSlots = node->isCollision ? node->slotCount : ((uint32_t)__builtin_popcount(node->dataMap) * 2);
+	
+	for (uint32_t i = 0; i < dataSlots; i++)
+	{
+		size += YapDatabaseEstimatedObjectSize(node->slots[i]);
+	}
+	
+	for (uint32_t i = dataSlots; i < node->slotCount; i++)
+	{
+		size += YapMemoryTableNodeEstimatedSize(node->slots[i], visitedNodes);
+	}
+	
+	return size;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A committed (and thus immutable) version of the table.
+ * The versions form a linked-list, with the most recent version at the front of the linked-list.
+**/
+@interface YapMemoryTableVersion : NSObject {
+@public
+	YapMemoryTableVersion *olderVersion;
+	
+	uint64_t snapshot;
+	YapMemoryTableNode *root;
+}
 @end
 
-@implementation YapMemoryTableValue
+@implementation YapMemoryTableVersion
 
 - (NSString *)description
 {
-	return [NSString stringWithFormat:@"<YapMemoryTableValue[%p]: snapshot(%llu), olderValue(%p), object(%@)>",
-	        self, snapshot, olderValue, object];
+	return [NSString stringWithFormat:@"<YapMemoryTableVersion[%p]: snapshot(%llu), olderVersion(%p), root(%p)>",
+	        self, snapshot, olderVersion, root];
 }
 
 @end
@@ -43,14 +581,13 @@
 	
 	Class keyClass;
 	
-	NSMutableDictionary *dict;
-	
 	dispatch_queue_t queue;
-	void *IsOnQueueKey;
 	
-	NSMutableArray *snapshots;
-	NSMutableArray *changes;
-	NSLock *lock;
+	YAPUnfairLock lock;
+	YapMemoryTableVersion *latestVersion;   // Modified only within lock
+	_Atomic(void *) publishedVersion;       // Mirror of latestVersion, for lock-free readers
+	
+	uint64_t lastEdit;                      // Modified only within lock
 }
 @end
 
@@ -62,7 +599,10 @@
 	uint64_t snapshot;
 	BOOL isReadWriteTransaction;
 	
-	NSMutableSet *changedKeys;
+	YapMemoryTableNode *root;
+	
+	uint64_t edit;
+	BOOL hasChanges;
 }
 @end
 
@@ -78,24 +618,44 @@
 	{
 		keyClass = inKeyClass;
 		
-		dict = [[NSMutableDictionary alloc] init];
-		queue = dispatch_queue_create("YapMemoryTable", DISPATCH_QUEUE_CONCURRENT);
+		queue = dispatch_queue_create("YapMemoryTable", DISPATCH_QUEUE_SERIAL);
 		
-		IsOnQueueKey = &IsOnQueueKey;
-		dispatch_queue_set_specific(queue, IsOnQueueKey, IsOnQueueKey, NULL);
+		lock = YAP_UNFAIR_LOCK_INIT;
 		
-		snapshots = [[NSMutableArray alloc] init];
-		changes   = [[NSMutableArray alloc] init];
-		lock = [[NSLock alloc] init];
+		latestVersion = [[YapMemoryTableVersion alloc] init];
+		atomic_init(&publishedVersion, (__bridge void *)latestVersion);
 	}
 	return self;
 }
+
+/**
+ * Returns the root of the most recent version that's visible to the given snapshot.
+ *
+ * This doesn't require any locks.
+ * The table retains every version that may be visible to an active transaction (until asyncCheckpoint: says otherwise),
+ * and a transaction's snapshot is never older than the checkpoint's minSnapshot.
+ * So the walk never reaches a version that a concurrent checkpoint is discarding.
+**/
+- (YapMemoryTableNode *)rootForSnapshot:(uint64_t)snapshot
+{
+	__unsafe_unretained YapMemoryTableVersion *version =
+	  (__bridge YapMemoryTableVersion *)atomic_load_explicit(&publishedVersion, memory_order_acquire);
+	
+	while (version && version->snapshot > snapshot)
+	{
+		version = version->olderVersion;
+	}
+	
+	return version ? version->root : nil;
+}
+
 - (YapMemoryTableTransaction *)newReadTransactionWithSnapshot:(uint64_t)snapshot
 {
 	YapMemoryTableTransaction *transaction = [[YapMemoryTableTransaction alloc] init];
 	transaction->table = self;
 	transaction->snapshot = snapshot;
 	transaction->isReadWriteTransaction = NO;
+	transaction->root = [self rootForSnapshot:snapshot];
 	
 	return transaction;
 }
@@ -106,148 +666,104 @@
 	transaction->table = self;
 	transaction->snapshot = snapshot;
 	transaction->isReadWriteTransaction = YES;
+	transaction->root = [self rootForSnapshot:snapshot];
+	
+	YAPUnfairLockLock(&lock);
+	{
+		transaction->edit = ++lastEdit;
+	}
+	YAPUnfairLockUnlock(&lock);
 	
 	return transaction;
 }
 
+- (void)commitRoot:(YapMemoryTableNode *)root withSnapshot:(uint64_t)snapshot
+{
+	YapMemoryTableVersion *version = [[YapMemoryTableVersion alloc] init];
+	version->snapshot = snapshot;
+	version->root = root;
+	
+	YAPUnfairLockLock(&lock);
+	{
+		version->olderVersion = latestVersion;
+		latestVersion = version;
+		
+		atomic_store_explicit(&publishedVersion, (__bridge void *)version, memory_order_release);
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
 - (void)asyncCheckpoint:(int64_t)minSnapshot
 {
 	__weak YapMemoryTable *weakSelf = self;
 	
-	dispatch_barrier_async(queue, ^{ @autoreleasepool {
+	dispatch_async(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
 		
 		__strong YapMemoryTable *strongSelf = weakSelf;
 		if (strongSelf == nil) return;
 		
-		while (YES) // using manual return
+		// Every active transaction uses a snapshot >= minSnapshot.
+		// So the most recent version <= minSnapshot must remain,
+		// but every version older than it can go.
+		
+		YapMemoryTableVersion *discardedVersions = nil;
+		
+		YAPUnfairLockLock(&strongSelf->lock);
 		{
-			int64_t snapshot = 0;
-			NSSet *changedKeys = nil;
-			
-			[strongSelf->lock lock];
+			__unsafe_unretained YapMemoryTableVersion *version = strongSelf->latestVersion;
 			
-			if ([strongSelf->snapshots count] > 0)
+			while (version && version->snapshot > (uint64_t)minSnapshot)
 			{
-				snapshot = [[strongSelf->snapshots objectAtIndex:0] longLongValue];
-				
-				if (snapshot < minSnapshot)
-				{
-					changedKeys = [strongSelf->changes objectAtIndex:0];
-			
-					[strongSelf->snapshots removeObjectAtIndex:0];
-					[strongSelf->changes removeObjectAtIndex:0];
-				}
+				version = version->olderVersion;
 			}
 			
-			[strongSelf->lock unlock];
-			
-			if (changedKeys == nil)
+			if (version)
 			{
-				return; // Done
+				discardedVersions = version->olderVersion;
+				version->olderVersion = nil;
 			}
-			
-			for (id key in changedKeys)
-			{
-				BOOL hasObject = NO;
-				
-				__unsafe_unretained YapMemoryTableValue *prvValue = nil;
-				__unsafe_unretained YapMemoryTableValue *value = [strongSelf->dict objectForKey:key];
-				
-				while (value && value->snapshot >= (uint64_t)minSnapshot)
-				{
-					if (hasObject == NO)
-						hasObject = (value->object != nil);
-					
-					prvValue = value;
-					value = value->olderValue;
-				}
-				
-				if (value)
-				{
-					if (prvValue)
-					{
-						// The 'value' is not the latest value
-						
-						if (!hasObject)
-						{
-							// All values >= minSnapshot represent a deletion.
-							// So we can just dump all values.
-							
-							[strongSelf->dict removeObjectForKey:key];
-						}
-						else
-						{
-							// There are values >= minSnapshot in the table.
-							// So the stay in the dict.
-							// But everything older than minSnapshot can go.
-							
-							prvValue->olderValue = nil;
-						}
-					}
-					else
-					{
-						// The 'value' is the latest value
-						
-						if (value->object == nil)
-						{
-							// The 'value' is the latest value.
-							// And 'value' represents a deletion.
-							// So we can just dump all values.
-							
-							[strongSelf->dict removeObjectForKey:key];
-						}
-						else
-						{
-							// The 'value' is the latest value.
-							// So it stays in the dict.
-							// But everything after it can go (if there is anything).
-							
-							value->olderValue = nil;
-						}
-					}
-					
-				} // end: if (value)
-				
-			} // end: for (id key in changedKeys)
-			
-		} // end: while (YES)
+		}
+		YAPUnfairLockUnlock(&strongSelf->lock);
 		
+		// The discarded versions (and any nodes only they reference) are released here, outside the lock.
+		discardedVersions = nil;
+	
 	#pragma clang diagnostic pop
 	}});
 }
 
-- (void)asyncRollback:(int64_t)snapshot withChanges:(NSSet *)changedKeys
+- (uint64_t)estimatedMemoryUsage
 {
-	__weak YapMemoryTable *weakSelf = self;
+	__block uint64_t size = 0;
 	
-	dispatch_barrier_async(queue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
+	// Versions are only ever discarded on the queue (by asyncCheckpoint:),
+	// and commits only ever prepend to the linked-list.
+	// So, while on the queue, the list we grab is stable.
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
 		
-		__strong YapMemoryTable *strongSelf = weakSelf;
-		if (strongSelf == nil) return;
+		__strong YapMemoryTableVersion *version = nil;
 		
-		for (id key in changedKeys)
+		YAPUnfairLockLock(&lock);
 		{
-			__unsafe_unretained YapMemoryTableValue *value = [strongSelf->dict objectForKey:key];
-			
-			if (value && value->snapshot == (uint64_t)snapshot)
-			{
-				if (value->olderValue == nil)
-				{
-					[strongSelf->dict removeObjectForKey:key];
-				}
-				else
-				{
-					[strongSelf->dict setObject:value->olderValue forKey:key];
-				}
-			}
+			version = latestVersion;
 		}
+		YAPUnfairLockUnlock(&lock);
 		
-	#pragma clang diagnostic pop
+		NSHashTable *visitedNodes = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+		
+		while (version)
+		{
+			size += (uint64_t)malloc_size((__bridge const void *)version);
+			size += YapMemoryTableNodeEstimatedSize(version->root, visitedNodes);
+			
+			version = version->olderVersion;
+		}
 	}});
+	
+	return size;
 }
 
 @end
@@ -266,106 +782,23 @@
 	NSAssert([key isKindOfClass:table->keyClass],
 	         @"Unexpected key class. Expected %@, passed %@", table->keyClass, [key class]);
 	
-	__block id result = nil;
-	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		__unsafe_unretained YapMemoryTableValue *value = [table->dict objectForKey:key];
-		
-		while (value)
-		{
-			if (value->snapshot <= snapshot)
-			{
-				result = value->object;
-				break;
-			}
-			else
-			{
-				value = value->olderValue;
-			}
-		}
-	
-	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(table->IsOnQueueKey))
-		block();
-	else
-		dispatch_sync(table->queue, block);
-	
-	return result;
+	return YapMemoryTableNodeGet(root, key, YapMemoryTableHash(key));
 }
 
 - (void)enumerateKeysWithBlock:(void (^)(id key, BOOL *stop))userBlock
 {
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	BOOL stop = NO;
+	YapMemoryTableNodeEnumerate(root, ^(id key, id __unused obj, BOOL *innerStop) {
 		
-		[table->dict enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
-			
-			__unsafe_unretained YapMemoryTableValue *value = (YapMemoryTableValue *)obj;
-			while (value)
-			{
-				if (value->snapshot <= snapshot)
-				{
-					if (value->object)
-					{
-						userBlock(key, stop);
-					}
-					break;
-				}
-				else
-				{
-					value = value->olderValue;
-				}
-			}
-		}];
+		userBlock(key, innerStop);
 		
-	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(table->IsOnQueueKey))
-		block();
-	else
-		dispatch_sync(table->queue, block);
+	}, &stop);
 }
 
 - (void)enumerateKeysAndObjectsWithBlock:(void (^)(id key, id obj, BOOL *stop))userBlock
 {
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		[table->dict enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
-			
-			__unsafe_unretained YapMemoryTableValue *value = (YapMemoryTableValue *)obj;
-			while (value)
-			{
-				if (value->snapshot <= snapshot)
-				{
-					if (value->object)
-					{
-						userBlock(key, value->object, stop);
-					}
-					break;
-				}
-				else
-				{
-					value = value->olderValue;
-				}
-			}
-		}];
-		
-	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(table->IsOnQueueKey))
-		block();
-	else
-		dispatch_sync(table->queue, block);
+	BOOL stop = NO;
+	YapMemoryTableNodeEnumerate(root, userBlock, &stop);
 }
 
 - (void)setObject:(id)object forKey:(id)key
@@ -378,42 +811,14 @@
 		return;
 	}
 	
-	if (changedKeys == nil)
-		changedKeys = [[NSMutableSet alloc] init];
-	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		__unsafe_unretained YapMemoryTableValue *value = [table->dict objectForKey:key];
-		
-		if (value && value->snapshot == snapshot)
-		{
-			// We've already updated this key during this transaction.
-			
-			value->object = object;
-		}
-		else
-		{
-			// First update for this key during this transaction.
-			
-			YapMemoryTableValue *newValue = [[YapMemoryTableValue alloc] init];
-			newValue->olderValue = value;
-			newValue->object = object;
-			newValue->snapshot = snapshot;
-			
-			[table->dict setObject:newValue forKey:key];
-			
-			[changedKeys addObject:key];
-		}
-		
-	#pragma clang diagnostic pop
-	}};
+	if (object == nil)
+	{
+		[self removeObjectForKey:key];
+		return;
+	}
 	
-	if (dispatch_get_specific(table->IsOnQueueKey))
-		block();
-	else
-		dispatch_barrier_sync(table->queue, block);
+	root = YapMemoryTableNodeSet(root, edit, 0, key, YapMemoryTableHash(key), object);
+	hasChanges = YES;
 }
 
 - (void)removeObjectForKey:(id)key
@@ -426,60 +831,12 @@
 		return;
 	}
 	
-	if (changedKeys == nil)
-		changedKeys = [[NSMutableSet alloc] init];
-	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		__unsafe_unretained YapMemoryTableValue *value = [table->dict objectForKey:key];
-		
-		if (value)
-		{
-			if (value->snapshot == snapshot)
-			{
-				// We've already updated this key during this transaction.
-				
-				if (value->olderValue == nil)
-				{
-					// Removing a previously set value within this transaction.
-					// And there are no other values outside this transaction.
-					
-					[table->dict removeObjectForKey:key];
-					
-					[changedKeys removeObject:key];
-				}
-				else
-				{
-					// Updating a previously set value within this transaction.
-					// But there are other values for older snapshots.
-					
-					value->object = nil;
-				}
-			}
-			else
-			{
-				// First update for this key during this transaction.
-				
-				YapMemoryTableValue *newValue = [[YapMemoryTableValue alloc] init];
-				newValue->olderValue = value;
-				newValue->object = nil;
-				newValue->snapshot = snapshot;
-				
-				[table->dict setObject:newValue forKey:key];
-				
-				[changedKeys addObject:key];
-			}
-		}
-		
-	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(table->IsOnQueueKey))
-		block();
-	else
-		dispatch_barrier_sync(table->queue, block);
+	YapMemoryTableNode *newRoot = YapMemoryTableNodeRemove(root, edit, 0, key, YapMemoryTableHash(key));
+	if (newRoot != root)
+	{
+		root = newRoot;
+		hasChanges = YES;
+	}
 }
 
 - (void)removeObjectsForKeys:(NSArray *)keys
@@ -489,160 +846,58 @@
 		return;
 	}
 	
-	if (changedKeys == nil)
-		changedKeys = [[NSMutableSet alloc] init];
-	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		for (id key in keys)
-		{
-			NSAssert([key isKindOfClass:table->keyClass],
-			         @"Unexpected key class. Expected %@, passed %@", table->keyClass, [key class]);
-			
-			__unsafe_unretained YapMemoryTableValue *value = [table->dict objectForKey:key];
-			
-			if (value)
-			{
-				if (value->snapshot == snapshot)
-				{
-					// We've already updated this key during this transaction.
-					
-					if (value->olderValue == nil)
-					{
-						// Removing a previously set value within this transaction.
-						// And there are no other values outside this transaction.
-						
-						[table->dict removeObjectForKey:key];
-						
-						[changedKeys removeObject:key];
-					}
-					else
-					{
-						// Updating a previously set value within this transaction.
-						// But there are other values for older snapshots.
-						
-						value->object = nil;
-					}
-				}
-				else
-				{
-					// First update for this key during this transaction.
-					
-					YapMemoryTableValue *newValue = [[YapMemoryTableValue alloc] init];
-					newValue->olderValue = value;
-					newValue->object = nil;
-					newValue->snapshot = snapshot;
-					
-					[table->dict setObject:newValue forKey:key];
-					
-					[changedKeys addObject:key];
-				}
-			}
-		}
-		
-	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(table->IsOnQueueKey))
-		block();
-	else
-		dispatch_barrier_sync(table->queue, block);
+	for (id key in keys)
+	{
+		[self removeObjectForKey:key];
+	}
 }
 
 - (void)removeAllObjects
 {
 	NSAssert(isReadWriteTransaction, @"Cannot modify table in read-only transaction.");
 	
-	if (changedKeys == nil)
-		changedKeys = [[NSMutableSet alloc] init];
-	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		// Grab all keys
-		NSArray *keys = [table->dict allKeys];
-		
-		// Mark all keys as changed
-		[changedKeys addObjectsFromArray:keys];
-		
-		// Now enumerate all the keys, and update accordingly
-		for (id key in keys)
-		{
-			__unsafe_unretained YapMemoryTableValue *value = [table->dict objectForKey:key];
-			
-			if (value->snapshot == snapshot)
-			{
-				// We've already updated this key during this transaction.
-				
-				if (value->olderValue == nil)
-				{
-					// Removing a previously set value within this transaction.
-					// And there are no other values outside this transaction.
-					
-					[table->dict removeObjectForKey:key];
-					[changedKeys removeObject:key];
-				}
-				else
-				{
-					// Updating a previously set value within this transaction.
-					// But there are other values for older snapshots.
-					
-					value->object = nil;
-				}
-			}
-			else
-			{
-				// First update for this key during this transaction.
-				
-				YapMemoryTableValue *newValue = [[YapMemoryTableValue alloc] init];
-				newValue->olderValue = value;
-				newValue->object = nil;
-				newValue->snapshot = snapshot;
-				
-				[table->dict setObject:newValue forKey:key];
-			}
-		}
-		
-	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(table->IsOnQueueKey))
-		block();
-	else
-		dispatch_barrier_sync(table->queue, block);
+	if (root)
+	{
+		root = nil;
+		hasChanges = YES;
+	}
 }
 
+/**
+ * Reads never block, and there's only ever a single read-write transaction.
+ * So batching no longer requires any synchronization.
+**/
+
 - (void)accessWithBlock:(dispatch_block_t)block
 {
-	dispatch_sync(table->queue, block);
+	block();
 }
 
 - (void)modifyWithBlock:(dispatch_block_t)block
 {
-	dispatch_barrier_sync(table->queue, block);
+	block();
 }
 
 - (void)commit
 {
-	if (isReadWriteTransaction && [changedKeys count] > 0)
+	if (isReadWriteTransaction && hasChanges)
 	{
-		[table->lock lock];
-		{
-			[table->snapshots addObject:@(snapshot)];
-			[table->changes addObject:changedKeys];
-		}
-		[table->lock unlock];
+		[table commitRoot:root withSnapshot:snapshot];
+		
+		// Our nodes are now visible to other transactions, and must never be modified in place again.
+		edit = 0;
+		hasChanges = NO;
 	}
 }
 
 - (void)rollback
 {
-	if (isReadWriteTransaction && [changedKeys count] > 0)
+	if (isReadWriteTransaction && hasChanges)
 	{
-		[table asyncRollback:snapshot withChanges:changedKeys];
+		// Nothing was published, so we just drop our working copy.
+		
+		root = [table rootForSnapshot:snapshot];
+		hasChanges = NO;
 	}
 }
 
@@ -0,0 +1,88 @@
+#import <Foundation/Foundation.h>
+
+#import "YapBidirectionalCache.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A YapBidirectionalCache specialized for rowid keys.
+ *
+ * It has the same semantics as a YapBidirectionalCache<NSNumber *, ObjectType>:
+ * a single object per rowid, a single rowid per object, O(1) lookups in both directions,
+ * an optional strict countLimit, and least-recently-used eviction.
+ *
+ * But rowids aren't boxed in NSNumbers, and the cache items are stored in flat (C++) storage:
+ * - rowid -> item : a YapRowidMap (open addressing, no per-entry allocation)
+ * - object -> item : a CFDictionary (which doesn't retain the objects, as the items do)
+ * - the linked-list (for eviction) uses item indexes, rather than objects that need to be allocated.
+ *
+ * Unlike the YapBidirectionalCache, the cache must not be modified during enumeration.
+**/
+@interface YapRowidBidirectionalCache<ObjectType> : NSObject
+
+/**
+ * Initializes a cache.
+ * If you don't define a countLimit, then the default countLimit of 40 is used.
+**/
+- (instancetype)init;
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit;
+
+/**
+ * The objectCallbacks define the equal & hash callbacks for the objects (to use for the object -> rowid mapping).
+ * The default value for callbacks is kYapBidirectionalCacheDefaultCallBacks.
+**/
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit
+                   objectCallbacks:(const YapBidirectionalCacheCallBacks * _Nullable)objectCallbacks;
+
+/**
+ * The countLimit specifies the maximum number of items to keep in the cache.
+ * This limit is strictly enforced. Zero means unlimited.
+ *
+ * Changes to the countLimit take immediate effect on the cache (before the set method returns).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger countLimit;
+
+/**
+ * For debugging (only checked if NS_BLOCK_ASSERTIONS is not defined).
+ * See -[YapBidirectionalCache allowedObjectClasses].
+**/
+@property (nonatomic, copy, readwrite, nullable) NSSet<Class> *allowedObjectClasses;
+
+- (nullable ObjectType)objectForRowid:(int64_t)rowid;
+- (BOOL)containsRowid:(int64_t)rowid;
+
+/**
+ * Returns YES if the object is in the cache, in which case rowidPtr is set to its rowid.
+**/
+- (BOOL)getRowid:(int64_t *)rowidPtr forObject:(ObjectType)object;
+- (BOOL)containsObject:(ObjectType)object;
+
+- (NSUInteger)count;
+
+- (void)setObject:(ObjectType)object forRowid:(int64_t)rowid;
+
+- (void)removeAllObjects;
+
+- (void)removeObjectForRowid:(int64_t)rowid;
+- (void)removeObjectsForRowids:(id <NSFastEnumeration>)rowids; // NSNumber rowids
+
+- (void)removeRowidForObject:(ObjectType)object;
+
+/**
+ * Enumerates the cache (in no particular order).
+ * The cache must not be modified during enumeration.
+**/
+- (void)enumerateRowidsWithBlock:(void (^)(int64_t rowid, BOOL *stop))block;
+- (void)enumerateRowidsAndObjectsWithBlock:(void (^)(int64_t rowid, ObjectType obj, BOOL *stop))block;
+
+/**
+ * Returns the estimated memory footprint of the cache (in bytes).
+ * This includes the internal storage, as well as the objects retained by the cache.
+ *
+ * This method enumerates the cache, so it's O(count).
+**/
+- (uint64_t)estimatedMemoryUsage;
+
+@end
+
+NS_ASSUME_NONNULL_END
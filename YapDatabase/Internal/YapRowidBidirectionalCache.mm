@@ -0,0 +1,383 @@
+#import "YapRowidBidirectionalCache.h"
+#import "YapRowidMap.h"
+#import "YapDatabaseMemoryReportPrivate.h"
+
+#import <malloc/malloc.h>
+#include <vector>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+static NSUInteger const YapRowidBidirectionalCache_Default_CountLimit = 40;
+
+static uint32_t const YapRowidCacheNone = UINT32_MAX;
+
+/**
+ * The items are stored in a vector, and are referenced by index.
+ * Unused items (after removal or eviction) form a free list (via next), and are recycled first.
+**/
+struct YapRowidCacheItem {
+	
+	int64_t rowid;
+	__strong id obj;
+	
+	uint32_t prev;
+	uint32_t next;
+	
+	YapRowidCacheItem() : rowid(0), obj(nil), prev(YapRowidCacheNone), next(YapRowidCacheNone) {}
+};
+
+#ifndef NS_BLOCK_ASSERTIONS
+static void AssertAllowedObjectClass(id obj, NSSet *allowedObjectClasses)
+{
+	if (allowedObjectClasses == nil) return;
+	
+	for (Class allowedObjectClass in allowedObjectClasses)
+	{
+		if ([obj isKindOfClass:allowedObjectClass]) return;
+	}
+	
+	NSCAssert(NO, @"Unexpected object class. Passed %@, expected: %@", [obj class], allowedObjectClasses);
+}
+#endif
+
+@implementation YapRowidBidirectionalCache
+{
+	YapBidirectionalCacheCallBacks objCallBacks;
+	
+	std::vector<YapRowidCacheItem> items;
+	YapRowidMap<uint32_t> rowid_item_map;
+	CFMutableDictionaryRef obj_item_dict; // obj -> (item index + 1), doesn't retain the objects
+	
+	uint32_t mostRecentItem;
+	uint32_t leastRecentItem;
+	uint32_t freeItem;
+}
+
+@synthesize countLimit = countLimit;
+@synthesize allowedObjectClasses = allowedObjectClasses;
+
+- (instancetype)init
+{
+	return [self initWithCountLimit:YapRowidBidirectionalCache_Default_CountLimit objectCallbacks:NULL];
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)inCountLimit
+{
+	return [self initWithCountLimit:inCountLimit objectCallbacks:NULL];
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)inCountLimit
+                   objectCallbacks:(const YapBidirectionalCacheCallBacks *)inObjCallBacks
+{
+	if ((self = [super init]))
+	{
+		if (inObjCallBacks == NULL)
+			inObjCallBacks = &kYapBidirectionalCacheDefaultCallBacks;
+		
+		memcpy(&objCallBacks, inObjCallBacks, sizeof(YapBidirectionalCacheCallBacks));
+		
+		CFDictionaryKeyCallBacks kcb = kCFTypeDictionaryKeyCallBacks;
+		kcb.retain  = NULL;
+		kcb.release = NULL;
+		kcb.equal   = objCallBacks.equal;
+		kcb.hash    = objCallBacks.hash;
+		
+		obj_item_dict = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kcb, NULL);
+		
+		mostRecentItem = YapRowidCacheNone;
+		leastRecentItem = YapRowidCacheNone;
+		freeItem = YapRowidCacheNone;
+		
+		// zero is a valid countLimit (it means unlimited)
+		countLimit = inCountLimit;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (obj_item_dict) {
+		CFRelease(obj_item_dict);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Internal
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (uint32_t)itemIndexForObject:(id)object
+{
+	const void *value = CFDictionaryGetValue(obj_item_dict, (__bridge const void *)object);
+	
+	return value ? (uint32_t)((uintptr_t)value - 1) : YapRowidCacheNone;
+}
+
+- (void)unlinkItem:(uint32_t)index
+{
+	YapRowidCacheItem &item = items[index];
+	
+	if (item.prev != YapRowidCacheNone)
+		items[item.prev].next = item.next;
+	else
+		mostRecentItem = item.next;
+	
+	if (item.next != YapRowidCacheNone)
+		items[item.next].prev = item.prev;
+	else
+		leastRecentItem = item.prev;
+	
+	item.prev = YapRowidCacheNone;
+	item.next = YapRowidCacheNone;
+}
+
+- (void)linkItemAsMostRecent:(uint32_t)index
+{
+	YapRowidCacheItem &item = items[index];
+	
+	item.prev = YapRowidCacheNone;
+	item.next = mostRecentItem;
+	
+	if (mostRecentItem != YapRowidCacheNone)
+		items[mostRecentItem].prev = index;
+	else
+		leastRecentItem = index;
+	
+	mostRecentItem = index;
+}
+
+- (void)touchItem:(uint32_t)index
+{
+	if (index != mostRecentItem)
+	{
+		[self unlinkItem:index];
+		[self linkItemAsMostRecent:index];
+	}
+}
+
+/**
+ * Removes the item from the linked-list & both maps, and moves it to the free list.
+**/
+- (void)removeItem:(uint32_t)index
+{
+	[self unlinkItem:index];
+	
+	YapRowidCacheItem &item = items[index];
+	
+	CFDictionaryRemoveValue(obj_item_dict, (__bridge const void *)item.obj); // must be first
+	rowid_item_map.erase(item.rowid);
+	
+	item.obj = nil;
+	item.rowid = 0;
+	
+	item.next = freeItem;
+	freeItem = index;
+}
+
+- (void)evictIfNeeded
+{
+	if (countLimit == 0) return;
+	
+	while (rowid_item_map.size() > countLimit)
+	{
+		[self removeItem:leastRecentItem];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Public API
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)setCountLimit:(NSUInteger)newCountLimit
+{
+	if (countLimit != newCountLimit)
+	{
+		countLimit = newCountLimit;
+		[self evictIfNeeded];
+	}
+}
+
+- (id)objectForRowid:(int64_t)rowid
+{
+	uint32_t *index = rowid_item_map.find(rowid);
+	if (index == NULL) return nil;
+	
+	uint32_t i = *index;
+	[self touchItem:i];
+	
+	return items[i].obj;
+}
+
+- (BOOL)containsRowid:(int64_t)rowid
+{
+	return rowid_item_map.contains(rowid);
+}
+
+- (BOOL)getRowid:(int64_t *)rowidPtr forObject:(id)object
+{
+#ifndef NS_BLOCK_ASSERTIONS
+	AssertAllowedObjectClass(object, allowedObjectClasses);
+#endif
+	
+	uint32_t index = [self itemIndexForObject:object];
+	if (index == YapRowidCacheNone)
+	{
+		if (rowidPtr) *rowidPtr = 0;
+		return NO;
+	}
+	
+	[self touchItem:index];
+	
+	if (rowidPtr) *rowidPtr = items[index].rowid;
+	return YES;
+}
+
+- (BOOL)containsObject:(id)object
+{
+#ifndef NS_BLOCK_ASSERTIONS
+	AssertAllowedObjectClass(object, allowedObjectClasses);
+#endif
+	
+	return CFDictionaryContainsKey(obj_item_dict, (__bridge const void *)object);
+}
+
+- (NSUInteger)count
+{
+	return rowid_item_map.size();
+}
+
+- (void)setObject:(id)object forRowid:(int64_t)rowid
+{
+#ifndef NS_BLOCK_ASSERTIONS
+	AssertAllowedObjectClass(object, allowedObjectClasses);
+#endif
+	
+	// A single rowid per object:
+	// If the object is already cached (for a different rowid), that item is replaced.
+	
+	uint32_t objIndex = [self itemIndexForObject:object];
+	if (objIndex != YapRowidCacheNone && items[objIndex].rowid != rowid)
+	{
+		[self removeItem:objIndex];
+	}
+	
+	uint32_t *existingIndex = rowid_item_map.find(rowid);
+	if (existingIndex)
+	{
+		uint32_t i = *existingIndex;
+		YapRowidCacheItem &item = items[i];
+		
+		if (!objCallBacks.equal((__bridge const void *)item.obj, (__bridge const void *)object))
+		{
+			CFDictionaryRemoveValue(obj_item_dict, (__bridge const void *)item.obj);
+			
+			item.obj = objCallBacks.shouldCopy ? [object copy] : object;
+			
+			CFDictionarySetValue(obj_item_dict, (__bridge const void *)item.obj, (const void *)(uintptr_t)(i + 1));
+		}
+		
+		[self touchItem:i];
+		return;
+	}
+	
+	uint32_t i;
+	if (freeItem != YapRowidCacheNone)
+	{
+		i = freeItem;
+		freeItem = items[i].next;
+	}
+	else
+	{
+		i = (uint32_t)items.size();
+		items.emplace_back();
+	}
+	
+	YapRowidCacheItem &item = items[i];
+	item.rowid = rowid;
+	item.obj = objCallBacks.shouldCopy ? [object copy] : object;
+	
+	rowid_item_map.findOrInsert(rowid) = i;
+	CFDictionarySetValue(obj_item_dict, (__bridge const void *)item.obj, (const void *)(uintptr_t)(i + 1));
+	
+	[self linkItemAsMostRecent:i];
+	[self evictIfNeeded];
+}
+
+- (void)removeAllObjects
+{
+	CFDictionaryRemoveAllValues(obj_item_dict); // must be first
+	
+	rowid_item_map.clear();
+	std::vector<YapRowidCacheItem>().swap(items); // release memory (& objects)
+	
+	mostRecentItem = YapRowidCacheNone;
+	leastRecentItem = YapRowidCacheNone;
+	freeItem = YapRowidCacheNone;
+}
+
+- (void)removeObjectForRowid:(int64_t)rowid
+{
+	uint32_t *index = rowid_item_map.find(rowid);
+	if (index)
+	{
+		[self removeItem:*index];
+	}
+}
+
+- (void)removeObjectsForRowids:(id <NSFastEnumeration>)rowids
+{
+	for (NSNumber *rowidNumber in rowids)
+	{
+		[self removeObjectForRowid:[rowidNumber longLongValue]];
+	}
+}
+
+- (void)removeRowidForObject:(id)object
+{
+	uint32_t index = [self itemIndexForObject:object];
+	if (index != YapRowidCacheNone)
+	{
+		[self removeItem:index];
+	}
+}
+
+- (void)enumerateRowidsWithBlock:(void (^)(int64_t rowid, BOOL *stop))block
+{
+	BOOL stop = NO;
+	
+	rowid_item_map.forEach([&](int64_t rowid, uint32_t &) -> bool {
+		
+		block(rowid, &stop);
+		return stop;
+	});
+}
+
+- (void)enumerateRowidsAndObjectsWithBlock:(void (^)(int64_t rowid, id obj, BOOL *stop))block
+{
+	BOOL stop = NO;
+	
+	rowid_item_map.forEach([&](int64_t rowid, uint32_t &index) -> bool {
+		
+		block(rowid, items[index].obj, &stop);
+		return stop;
+	});
+}
+
+- (uint64_t)estimatedMemoryUsage
+{
+	uint64_t size = (uint64_t)malloc_size((__bridge const void *)self);
+	
+	size += (uint64_t)items.capacity() * sizeof(YapRowidCacheItem);
+	size += (uint64_t)rowid_item_map.capacity() * YapRowidMap<uint32_t>::slotSize();
+	size += (uint64_t)CFDictionaryGetCount(obj_item_dict) * (2 * sizeof(void *));
+	
+	for (const YapRowidCacheItem &item : items)
+	{
+		size += YapDatabaseEstimatedObjectSize(item.obj);
+	}
+	
+	return size;
+}
+
+@end
@@ -0,0 +1,68 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A YapDirtyDictionary specialized for rowid keys.
+ *
+ * It has the same semantics as a YapDirtyDictionary<NSNumber *, ObjectType>:
+ * it tracks both the current value & the original value for every rowid,
+ * so it's easy to see which values have truely changed.
+ *
+ * But rowids aren't boxed in NSNumbers, and there's no item object per entry.
+ * The (current, original) pairs are stored inline in a YapRowidMap.
+ *
+ * Once it's been passed to other connections (e.g. in a changeset), the dictionary must be treated as immutable.
+ * Only the read-only methods may be used then, which are safe to call from multiple threads.
+**/
+@interface YapRowidDirtyDictionary<ObjectType> : NSObject
+
+- (instancetype)init;
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+- (NSUInteger)count;
+
+/**
+ * Returns the current value, regardless of whether it's "dirty" or "clean".
+**/
+- (nullable ObjectType)objectForRowid:(int64_t)rowid;
+
+/**
+ * Returns the current value, but only if it's "dirty" (doesn't match the original value).
+**/
+- (nullable ObjectType)dirtyValueForRowid:(int64_t)rowid;
+
+/**
+ * Returns the original value (the oldest previousValue for the rowid).
+**/
+- (nullable ObjectType)originalValueForRowid:(int64_t)rowid;
+
+/**
+ * Sets the current value for the rowid.
+ * See -[YapDirtyDictionary setObject:forKey:withPreviousValue:].
+**/
+- (void)setObject:(ObjectType)object forRowid:(int64_t)rowid withPreviousValue:(nullable ObjectType)prevObj;
+
+/**
+ * Removes all objects from the dictionary, and all stored original values too.
+**/
+- (void)removeAllObjects;
+
+/**
+ * Removes only those objects from the dictionary for which the current value matches the original value.
+**/
+- (void)removeCleanObjects;
+
+/**
+ * Enumerates all rowid/value pairs, including both "dirty" & "clean" values.
+**/
+- (void)enumerateRowidsAndObjectsUsingBlock:(void (^)(int64_t rowid, ObjectType obj, BOOL *stop))block;
+
+/**
+ * Enumerates only the rowid/value pairs that are dirty (current value differs from original value).
+**/
+- (void)enumerateDirtyRowidsAndObjectsUsingBlock:(void (^)(int64_t rowid, ObjectType obj, BOOL *stop))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,128 @@
+#import "YapRowidDirtyDictionary.h"
+#import "YapRowidMap.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+struct YapRowidDirtyValue {
+	
+	__strong id currentValue;
+	__strong id originalValue;
+	
+	YapRowidDirtyValue() : currentValue(nil), originalValue(nil) {}
+};
+
+static inline BOOL YapRowidDirtyValueIsClean(const YapRowidDirtyValue &value)
+{
+	if (value.originalValue)
+		return [value.originalValue isEqual:value.currentValue];
+	else
+		return (value.currentValue == nil);
+}
+
+@implementation YapRowidDirtyDictionary
+{
+	YapRowidMap<YapRowidDirtyValue> map;
+}
+
+- (instancetype)init
+{
+	return [self initWithCapacity:0];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+	if ((self = [super init]))
+	{
+		if (capacity > 0) {
+			map.reserve(capacity);
+		}
+	}
+	return self;
+}
+
+- (NSUInteger)count
+{
+	return map.size();
+}
+
+- (id)objectForRowid:(int64_t)rowid
+{
+	const YapRowidDirtyValue *value = map.find(rowid);
+	
+	return value ? value->currentValue : nil;
+}
+
+- (id)dirtyValueForRowid:(int64_t)rowid
+{
+	const YapRowidDirtyValue *value = map.find(rowid);
+	
+	if (value && ![value->originalValue isEqual:value->currentValue])
+		return value->currentValue;
+	else
+		return nil;
+}
+
+- (id)originalValueForRowid:(int64_t)rowid
+{
+	const YapRowidDirtyValue *value = map.find(rowid);
+	
+	return value ? value->originalValue : nil;
+}
+
+- (void)setObject:(id)object forRowid:(int64_t)rowid withPreviousValue:(id)prevObj
+{
+	NSParameterAssert(object != nil);
+	
+	if (object == nil) return;
+	
+	bool inserted = false;
+	YapRowidDirtyValue &value = map.findOrInsert(rowid, &inserted);
+	
+	value.currentValue = object;
+	
+	if (inserted) {
+		value.originalValue = prevObj;
+	}
+}
+
+- (void)removeAllObjects
+{
+	map.clear();
+}
+
+- (void)removeCleanObjects
+{
+	map.eraseIf([](int64_t, YapRowidDirtyValue &value) -> bool {
+		
+		return YapRowidDirtyValueIsClean(value);
+	});
+}
+
+- (void)enumerateRowidsAndObjectsUsingBlock:(void (^)(int64_t rowid, id obj, BOOL *stop))block
+{
+	BOOL stop = NO;
+	
+	map.forEach([&](int64_t rowid, YapRowidDirtyValue &value) -> bool {
+		
+		block(rowid, value.currentValue, &stop);
+		return stop;
+	});
+}
+
+- (void)enumerateDirtyRowidsAndObjectsUsingBlock:(void (^)(int64_t rowid, id obj, BOOL *stop))block
+{
+	BOOL stop = NO;
+	
+	map.forEach([&](int64_t rowid, YapRowidDirtyValue &value) -> bool {
+		
+		if (!YapRowidDirtyValueIsClean(value))
+		{
+			block(rowid, value.currentValue, &stop);
+		}
+		return stop;
+	});
+}
+
+@end
@@ -0,0 +1,254 @@
+/**
+ * A compact hash map from rowid (int64_t) to Value (C++ only).
+ *
+ * This is the storage used by YapRowidBidirectionalCache & YapRowidDirtyDictionary,
+ * which replace NSNumber keys (and the CFDictionaries that hash them) on the rowid hot paths.
+**/
+
+#ifndef YapDatabase_YapRowidMap_h
+#define YapDatabase_YapRowidMap_h
+
+#if defined(__cplusplus)
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * YapRowidMap is a flat (open addressing) hash table, using linear probing.
+ *
+ * Every slot is stored inline in a single vector (no per-entry allocations),
+ * and rowids are stored as plain integers (no boxing, no retain/release, no objc_msgSend to hash/compare).
+ * Removal uses backward-shift deletion, so there are no tombstones, and lookups never degrade over time.
+ *
+ * The capacity is always a power of 2, and the table grows once it's 3/4 full.
+ * Any modification may move the values, so pointers returned by find() are only valid until the next modification.
+ * The map must not be modified during enumeration.
+**/
+template <typename Value>
+class YapRowidMap {
+	
+	struct Slot {
+		int64_t rowid;
+		bool occupied;
+		Value value;
+		
+		Slot() : rowid(0), occupied(false), value() {}
+	};
+	
+	std::vector<Slot> slots;
+	size_t count;
+	
+	static inline size_t Hash(int64_t rowid)
+	{
+		// Rowids are mostly sequential, so mix the bits (murmur3 finalizer) before masking.
+		
+		uint64_t h = (uint64_t)rowid;
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		
+		return (size_t)h;
+	}
+	
+	size_t IndexOf(int64_t rowid) const
+	{
+		if (slots.empty()) return SIZE_MAX;
+		
+		size_t mask = slots.size() - 1;
+		size_t index = Hash(rowid) & mask;
+		
+		while (slots[index].occupied)
+		{
+			if (slots[index].rowid == rowid) return index;
+			index = (index + 1) & mask;
+		}
+		
+		return SIZE_MAX;
+	}
+	
+	void Rehash(size_t capacity)
+	{
+		std::vector<Slot> oldSlots(capacity);
+		oldSlots.swap(slots);
+		
+		size_t mask = capacity - 1;
+		
+		for (Slot &oldSlot : oldSlots)
+		{
+			if (!oldSlot.occupied) continue;
+			
+			size_t index = Hash(oldSlot.rowid) & mask;
+			while (slots[index].occupied) {
+				index = (index + 1) & mask;
+			}
+			
+			slots[index].rowid = oldSlot.rowid;
+			slots[index].occupied = true;
+			slots[index].value = std::move(oldSlot.value);
+		}
+	}
+
+public:
+	
+	YapRowidMap() : count(0) {}
+	
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	
+	/**
+	 * The number of slots (for memory estimates).
+	**/
+	size_t capacity() const { return slots.size(); }
+	static size_t slotSize() { return sizeof(Slot); }
+	
+	void reserve(size_t n)
+	{
+		size_t capacity = slots.empty() ? 16 : slots.size();
+		while ((n * 4) > (capacity * 3)) {
+			capacity *= 2;
+		}
+		
+		if (capacity > slots.size()) {
+			Rehash(capacity);
+		}
+	}
+	
+	Value* find(int64_t rowid)
+	{
+		size_t index = IndexOf(rowid);
+		return (index == SIZE_MAX) ? NULL : &slots[index].value;
+	}
+	
+	const Value* find(int64_t rowid) const
+	{
+		size_t index = IndexOf(rowid);
+		return (index == SIZE_MAX) ? NULL : &slots[index].value;
+	}
+	
+	bool contains(int64_t rowid) const
+	{
+		return IndexOf(rowid) != SIZE_MAX;
+	}
+	
+	/**
+	 * Returns the value for the rowid, inserting a default constructed value if needed.
+	 * If inserted is non-NULL, it's set to whether or not the value was inserted.
+	**/
+	Value& findOrInsert(int64_t rowid, bool *inserted = NULL)
+	{
+		reserve(count + 1);
+		
+		size_t mask = slots.size() - 1;
+		size_t index = Hash(rowid) & mask;
+		
+		while (slots[index].occupied)
+		{
+			if (slots[index].rowid == rowid)
+			{
+				if (inserted) *inserted = false;
+				return slots[index].value;
+			}
+			
+			index = (index + 1) & mask;
+		}
+		
+		slots[index].rowid = rowid;
+		slots[index].occupied = true;
+		count++;
+		
+		if (inserted) *inserted = true;
+		return slots[index].value;
+	}
+	
+	/**
+	 * Removes the rowid (if present), and returns whether or not it was present.
+	**/
+	bool erase(int64_t rowid)
+	{
+		size_t index = IndexOf(rowid);
+		if (index == SIZE_MAX) return false;
+		
+		// Backward-shift deletion:
+		// Move subsequent entries of the probe sequence back, so the sequence stays unbroken.
+		
+		size_t mask = slots.size() - 1;
+		size_t hole = index;
+		size_t next = (hole + 1) & mask;
+		
+		while (slots[next].occupied)
+		{
+			size_t home = Hash(slots[next].rowid) & mask;
+			
+			// Can the entry at 'next' move into the hole ?
+			// Only if its home slot isn't (cyclically) within (hole, next].
+			
+			bool canMove = (hole <= next) ? ((home <= hole) || (home > next))
+			                              : ((home <= hole) && (home > next));
+			if (canMove)
+			{
+				slots[hole].rowid = slots[next].rowid;
+				slots[hole].value = std::move(slots[next].value);
+				hole = next;
+			}
+			
+			next = (next + 1) & mask;
+		}
+		
+		slots[hole].occupied = false;
+		slots[hole].rowid = 0;
+		slots[hole].value = Value();
+		count--;
+		
+		return true;
+	}
+	
+	void clear()
+	{
+		std::vector<Slot>().swap(slots); // release memory
+		count = 0;
+	}
+	
+	/**
+	 * Invokes the function with (rowid, value&) for every entry, in no particular order.
+	 * The function returns true to stop the enumeration.
+	**/
+	template <typename Function>
+	void forEach(Function function)
+	{
+		for (Slot &slot : slots)
+		{
+			if (slot.occupied)
+			{
+				if (function(slot.rowid, slot.value)) return;
+			}
+		}
+	}
+	
+	/**
+	 * Removes every entry for which the predicate (rowid, value&) returns true.
+	**/
+	template <typename Predicate>
+	void eraseIf(Predicate predicate)
+	{
+		std::vector<int64_t> rowids;
+		
+		for (Slot &slot : slots)
+		{
+			if (slot.occupied && predicate(slot.rowid, slot.value)) {
+				rowids.push_back(slot.rowid);
+			}
+		}
+		
+		for (int64_t rowid : rowids) {
+			erase(rowid);
+		}
+	}
+};
+
+#endif // __cplusplus
+
+#endif
@@ -1,5 +1,8 @@
 /**
- * Wrapper for C++ code (std::unordered_set<int64_t>)
+ * A compact set of rowids (a roaring bitmap, implemented in C++).
+ * 
+ * Rowids are mostly dense integers, so the set typically costs between 1 bit & 2 bytes per rowid.
+ * Enumeration is in ascending rowid order.
 **/
 
 #import <Foundation/Foundation.h>
@@ -13,7 +16,7 @@ extern "C" {
 
 typedef struct _YapRowidSet YapRowidSet;
 
-YapRowidSet* YapRowidSetCreate(NSUInteger capacity);
+YapRowidSet* YapRowidSetCreate(NSUInteger capacity); // capacity is ignored (storage is allocated on demand)
 
 YapRowidSet* YapRowidSetCopy(YapRowidSet *set);
 
@@ -27,10 +30,45 @@ NSUInteger YapRowidSetCount(YapRowidSet *set);
 
 BOOL YapRowidSetContains(YapRowidSet *set, int64_t rowid);
 
+/**
+ * Set algebra (in place):
+ * 
+ * YapRowidSetUnion     : set = set UNION other
+ * YapRowidSetIntersect : set = set INTERSECT other
+ * YapRowidSetMinus     : set = set MINUS other
+**/
+void YapRowidSetUnion(YapRowidSet *set, YapRowidSet *other);
+void YapRowidSetIntersect(YapRowidSet *set, YapRowidSet *other);
+void YapRowidSetMinus(YapRowidSet *set, YapRowidSet *other);
+
+/**
+ * Enumerates the rowids in ascending order.
+ * The set must not be modified during enumeration.
+**/
 void YapRowidSetEnumerate(YapRowidSet *set, void (^block)(int64_t rowid, BOOL *stop));
 
 #if defined(__cplusplus)
 }
 #endif
 
+#ifdef __OBJC__
+
+/**
+ * An object that owns a YapRowidSet.
+ * This allows a set to be stored in collections, such as the changeset dictionary.
+**/
+@interface YapRowidSetBox : NSObject {
+@public
+	YapRowidSet *set;
+}
+
+/**
+ * The box takes ownership of the given set (which is released when the box is deallocated).
+**/
+- (instancetype)initWithRowidSet:(YapRowidSet *)set;
+
+@end
+
+#endif
+
 #endif
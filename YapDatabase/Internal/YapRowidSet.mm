@@ -1,35 +1,346 @@
 #include "YapRowidSet.h"
-#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+/**
+ * YapRowidSet is a roaring bitmap.
+ *
+ * Each rowid is split into a high part (the upper 48 bits) and a low part (the lower 16 bits).
+ * Every distinct high part gets its own container, which stores the low parts (sorted).
+ * Depending on its cardinality, a container is either:
+ *
+ * - an array container  : a sorted vector<uint16_t>, used for (at most) 4096 values
+ * - a bitmap container  : 65536 bits (8 KB), used for more than 4096 values
+ *
+ * Rowids are mostly dense, so large sets are mostly bitmap containers (1 bit per rowid),
+ * and sparse regions cost (at most) 2 bytes per rowid.
+ * Compare this with std::unordered_set<int64_t>, which costs 32+ bytes per rowid, plus a node allocation.
+ *
+ * Rowids are stored with their sign bit flipped, so that (the rare) negative rowids sort before positive rowids.
+ * Thus enumeration is always in ascending rowid order.
+**/
+
+#define YAP_ROWID_SET_ARRAY_MAX     4096
+#define YAP_ROWID_SET_BITMAP_WORDS  1024 // 65536 bits
+
+struct YapRowidContainer {
+	
+	uint64_t high;
+	uint32_t cardinality;
+	
+	std::vector<uint16_t> array;  // used if bitmap is empty
+	std::vector<uint64_t> bitmap; // YAP_ROWID_SET_BITMAP_WORDS words (if a bitmap container)
+	
+	bool isBitmap() const { return !bitmap.empty(); }
+};
 
 struct _YapRowidSet {
-    std::unordered_set<int64_t> *rowids;
+	std::vector<YapRowidContainer> containers; // sorted by high
+	NSUInteger count;
 };
 
-YapRowidSet* YapRowidSetCreate(NSUInteger capacity)
+static inline uint64_t YapRowidSetKey(int64_t rowid)
 {
-	YapRowidSet *set = (YapRowidSet *)malloc(sizeof(YapRowidSet));
+	return ((uint64_t)rowid) ^ 0x8000000000000000ULL;
+}
+
+static inline int64_t YapRowidSetRowid(uint64_t high, uint16_t low)
+{
+	return (int64_t)(((high << 16) | low) ^ 0x8000000000000000ULL);
+}
+
+static inline uint32_t YapRowidSetPopcount(const std::vector<uint64_t> &bitmap)
+{
+	uint32_t cardinality = 0;
+	for (uint64_t word : bitmap) {
+		cardinality += (uint32_t)__builtin_popcountll(word);
+	}
 	
-	set->rowids = new std::unordered_set<int64_t>();
-	if (capacity > 0) {
-		set->rowids->reserve(capacity);
+	return cardinality;
+}
+
+/**
+ * Converts the container to the proper representation for its (current) cardinality.
+**/
+static void YapRowidContainerNormalize(YapRowidContainer &c)
+{
+	if (c.isBitmap())
+	{
+		if (c.cardinality <= YAP_ROWID_SET_ARRAY_MAX)
+		{
+			std::vector<uint16_t> array;
+			array.reserve(c.cardinality);
+			
+			for (uint32_t i = 0; i < YAP_ROWID_SET_BITMAP_WORDS; i++)
+			{
+				uint64_t word = c.bitmap[i];
+				while (word)
+				{
+					array.push_back((uint16_t)((i * 64) + (uint32_t)__builtin_ctzll(word)));
+					word &= (word - 1);
+				}
+			}
+			
+			c.array.swap(array);
+			std::vector<uint64_t>().swap(c.bitmap); // release memory
+		}
 	}
+	else
+	{
+		if (c.cardinality > YAP_ROWID_SET_ARRAY_MAX)
+		{
+			c.bitmap.assign(YAP_ROWID_SET_BITMAP_WORDS, 0);
+			
+			for (uint16_t low : c.array) {
+				c.bitmap[low >> 6] |= (1ULL << (low & 63));
+			}
+			
+			std::vector<uint16_t>().swap(c.array); // release memory
+		}
+	}
+}
+
+static bool YapRowidContainerAdd(YapRowidContainer &c, uint16_t low)
+{
+	if (c.isBitmap())
+	{
+		uint64_t &word = c.bitmap[low >> 6];
+		uint64_t mask = (1ULL << (low & 63));
+		
+		if (word & mask) return false;
+		
+		word |= mask;
+		c.cardinality++;
+		return true;
+	}
+	else
+	{
+		auto position = std::lower_bound(c.array.begin(), c.array.end(), low);
+		if (position != c.array.end() && *position == low) return false;
+		
+		c.array.insert(position, low);
+		c.cardinality++;
+		
+		YapRowidContainerNormalize(c);
+		return true;
+	}
+}
+
+static bool YapRowidContainerRemove(YapRowidContainer &c, uint16_t low)
+{
+	if (c.isBitmap())
+	{
+		uint64_t &word = c.bitmap[low >> 6];
+		uint64_t mask = (1ULL << (low & 63));
+		
+		if (!(word & mask)) return false;
+		
+		word &= ~mask;
+		c.cardinality--;
+		
+		YapRowidContainerNormalize(c);
+		return true;
+	}
+	else
+	{
+		auto position = std::lower_bound(c.array.begin(), c.array.end(), low);
+		if (position == c.array.end() || *position != low) return false;
+		
+		c.array.erase(position);
+		c.cardinality--;
+		return true;
+	}
+}
+
+static bool YapRowidContainerContains(const YapRowidContainer &c, uint16_t low)
+{
+	if (c.isBitmap())
+		return (c.bitmap[low >> 6] & (1ULL << (low & 63))) != 0;
+	else
+		return std::binary_search(c.array.begin(), c.array.end(), low);
+}
+
+/**
+ * Returns the index of the container with the given high part, or where it would be inserted.
+**/
+static size_t YapRowidSetFindContainer(const YapRowidSet *set, uint64_t high)
+{
+	auto position = std::lower_bound(set->containers.begin(), set->containers.end(), high,
+	  [](const YapRowidContainer &c, uint64_t value) { return c.high < value; });
 	
-	return set;
+	return (size_t)(position - set->containers.begin());
 }
 
-YapRowidSet* YapRowidSetCopy(YapRowidSet *set)
+static void YapRowidSetRecount(YapRowidSet *set)
 {
-	if (set == NULL) return NULL;
+	NSUInteger count = 0;
+	for (const YapRowidContainer &c : set->containers) {
+		count += c.cardinality;
+	}
 	
-	YapRowidSet *copy = (YapRowidSet *)malloc(sizeof(YapRowidSet));
+	set->count = count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Container Algebra
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void YapRowidContainerUnion(YapRowidContainer &c, const YapRowidContainer &other)
+{
+	if (!c.isBitmap() && !other.isBitmap())
+	{
+		std::vector<uint16_t> result;
+		result.reserve(c.array.size() + other.array.size());
+		
+		std::set_union(c.array.begin(), c.array.end(), other.array.begin(), other.array.end(),
+		               std::back_inserter(result));
+		
+		c.array.swap(result);
+		c.cardinality = (uint32_t)c.array.size();
+	}
+	else
+	{
+		if (!c.isBitmap())
+		{
+			// Force conversion
+			uint32_t cardinality = c.cardinality;
+			c.cardinality = YAP_ROWID_SET_ARRAY_MAX + 1;
+			YapRowidContainerNormalize(c);
+			c.cardinality = cardinality;
+		}
+		
+		if (other.isBitmap())
+		{
+			for (uint32_t i = 0; i < YAP_ROWID_SET_BITMAP_WORDS; i++) {
+				c.bitmap[i] |= other.bitmap[i];
+			}
+		}
+		else
+		{
+			for (uint16_t low : other.array) {
+				c.bitmap[low >> 6] |= (1ULL << (low & 63));
+			}
+		}
+		
+		c.cardinality = YapRowidSetPopcount(c.bitmap);
+	}
 	
-	if (set->rowids) {
-		copy->rowids = new std::unordered_set<int64_t>(*(set->rowids));
+	YapRowidContainerNormalize(c);
+}
+
+static void YapRowidContainerIntersect(YapRowidContainer &c, const YapRowidContainer &other)
+{
+	if (!c.isBitmap() && !other.isBitmap())
+	{
+		std::vector<uint16_t> result;
+		
+		std::set_intersection(c.array.begin(), c.array.end(), other.array.begin(), other.array.end(),
+		                      std::back_inserter(result));
+		
+		c.array.swap(result);
+		c.cardinality = (uint32_t)c.array.size();
+	}
+	else if (!c.isBitmap())
+	{
+		auto end = std::remove_if(c.array.begin(), c.array.end(),
+		  [&other](uint16_t low) { return !YapRowidContainerContains(other, low); });
+		
+		c.array.erase(end, c.array.end());
+		c.cardinality = (uint32_t)c.array.size();
+	}
+	else if (!other.isBitmap())
+	{
+		std::vector<uint16_t> result;
+		result.reserve(other.array.size());
+		
+		for (uint16_t low : other.array)
+		{
+			if (YapRowidContainerContains(c, low)) {
+				result.push_back(low);
+			}
+		}
+		
+		std::vector<uint64_t>().swap(c.bitmap);
+		c.array.swap(result);
+		c.cardinality = (uint32_t)c.array.size();
 	}
-	else {
-		copy->rowids = new std::unordered_set<int64_t>();
+	else
+	{
+		for (uint32_t i = 0; i < YAP_ROWID_SET_BITMAP_WORDS; i++) {
+			c.bitmap[i] &= other.bitmap[i];
+		}
+		
+		c.cardinality = YapRowidSetPopcount(c.bitmap);
 	}
 	
+	YapRowidContainerNormalize(c);
+}
+
+static void YapRowidContainerMinus(YapRowidContainer &c, const YapRowidContainer &other)
+{
+	if (!c.isBitmap())
+	{
+		if (!other.isBitmap())
+		{
+			std::vector<uint16_t> result;
+			
+			std::set_difference(c.array.begin(), c.array.end(), other.array.begin(), other.array.end(),
+			                    std::back_inserter(result));
+			
+			c.array.swap(result);
+		}
+		else
+		{
+			auto end = std::remove_if(c.array.begin(), c.array.end(),
+			  [&other](uint16_t low) { return YapRowidContainerContains(other, low); });
+			
+			c.array.erase(end, c.array.end());
+		}
+		
+		c.cardinality = (uint32_t)c.array.size();
+	}
+	else
+	{
+		if (other.isBitmap())
+		{
+			for (uint32_t i = 0; i < YAP_ROWID_SET_BITMAP_WORDS; i++) {
+				c.bitmap[i] &= ~(other.bitmap[i]);
+			}
+		}
+		else
+		{
+			for (uint16_t low : other.array) {
+				c.bitmap[low >> 6] &= ~(1ULL << (low & 63));
+			}
+		}
+		
+		c.cardinality = YapRowidSetPopcount(c.bitmap);
+	}
+	
+	YapRowidContainerNormalize(c);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Public API
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+YapRowidSet* YapRowidSetCreate(NSUInteger __unused capacity)
+{
+	// Note: The capacity isn't needed.
+	// Containers are allocated on demand, and are small (at most 8 KB each).
+	
+	YapRowidSet *set = new _YapRowidSet();
+	set->count = 0;
+	
+	return set;
+}
+
+YapRowidSet* YapRowidSetCopy(YapRowidSet *set)
+{
+	if (set == NULL) return NULL;
+	
+	YapRowidSet *copy = new _YapRowidSet(*set);
 	return copy;
 }
 
@@ -37,53 +348,237 @@ void YapRowidSetRelease(YapRowidSet *set)
 {
 	if (set == NULL) return;
 	
-	if (set->rowids) {
-		free(set->rowids);
-		set->rowids = NULL;
-	}
-	
-	free(set);
+	delete set;
 }
 
 void YapRowidSetAdd(YapRowidSet *set, int64_t rowid)
 {
-	set->rowids->insert(rowid);
+	uint64_t key = YapRowidSetKey(rowid);
+	uint64_t high = key >> 16;
+	uint16_t low = (uint16_t)(key & 0xFFFF);
+	
+	size_t index = YapRowidSetFindContainer(set, high);
+	
+	if (index == set->containers.size() || set->containers[index].high != high)
+	{
+		YapRowidContainer container;
+		container.high = high;
+		container.cardinality = 0;
+		
+		set->containers.insert(set->containers.begin() + index, std::move(container));
+	}
+	
+	if (YapRowidContainerAdd(set->containers[index], low)) {
+		set->count++;
+	}
 }
 
 void YapRowidSetRemove(YapRowidSet *set, int64_t rowid)
 {
-	set->rowids->erase(rowid);
+	uint64_t key = YapRowidSetKey(rowid);
+	uint64_t high = key >> 16;
+	uint16_t low = (uint16_t)(key & 0xFFFF);
+	
+	size_t index = YapRowidSetFindContainer(set, high);
+	
+	if (index < set->containers.size() && set->containers[index].high == high)
+	{
+		YapRowidContainer &container = set->containers[index];
+		
+		if (YapRowidContainerRemove(container, low))
+		{
+			set->count--;
+			
+			if (container.cardinality == 0) {
+				set->containers.erase(set->containers.begin() + index);
+			}
+		}
+	}
 }
 
 void YapRowidSetRemoveAll(YapRowidSet *set)
 {
-	set->rowids->clear();
+	set->containers.clear();
+	set->count = 0;
 }
 
 NSUInteger YapRowidSetCount(YapRowidSet *set)
 {
-	return (NSUInteger)(set->rowids->size());
+	return set->count;
 }
 
 BOOL YapRowidSetContains(YapRowidSet *set, int64_t rowid)
 {
-	return (set->rowids->find(rowid) != set->rowids->end());
+	uint64_t key = YapRowidSetKey(rowid);
+	uint64_t high = key >> 16;
+	uint16_t low = (uint16_t)(key & 0xFFFF);
+	
+	size_t index = YapRowidSetFindContainer(set, high);
+	
+	if (index < set->containers.size() && set->containers[index].high == high)
+		return YapRowidContainerContains(set->containers[index], low) ? YES : NO;
+	else
+		return NO;
 }
 
-void YapRowidSetEnumerate(YapRowidSet *set, void (^block)(int64_t rowid, BOOL *stop))
+void YapRowidSetUnion(YapRowidSet *set, YapRowidSet *other)
+{
+	if (set == other) return;
+	
+	std::vector<YapRowidContainer> result;
+	result.reserve(set->containers.size() + other->containers.size());
+	
+	size_t i = 0;
+	size_t j = 0;
+	
+	while (i < set->containers.size() || j < other->containers.size())
+	{
+		if (j == other->containers.size() ||
+		   (i < set->containers.size() && set->containers[i].high < other->containers[j].high))
+		{
+			result.push_back(std::move(set->containers[i]));
+			i++;
+		}
+		else if (i == set->containers.size() || other->containers[j].high < set->containers[i].high)
+		{
+			result.push_back(other->containers[j]);
+			j++;
+		}
+		else
+		{
+			YapRowidContainerUnion(set->containers[i], other->containers[j]);
+			result.push_back(std::move(set->containers[i]));
+			i++;
+			j++;
+		}
+	}
+	
+	set->containers.swap(result);
+	YapRowidSetRecount(set);
+}
+
+void YapRowidSetIntersect(YapRowidSet *set, YapRowidSet *other)
+{
+	if (set == other) return;
+	
+	std::vector<YapRowidContainer> result;
+	
+	size_t i = 0;
+	size_t j = 0;
+	
+	while (i < set->containers.size() && j < other->containers.size())
+	{
+		if (set->containers[i].high < other->containers[j].high)
+		{
+			i++;
+		}
+		else if (other->containers[j].high < set->containers[i].high)
+		{
+			j++;
+		}
+		else
+		{
+			YapRowidContainerIntersect(set->containers[i], other->containers[j]);
+			
+			if (set->containers[i].cardinality > 0) {
+				result.push_back(std::move(set->containers[i]));
+			}
+			i++;
+			j++;
+		}
+	}
+	
+	set->containers.swap(result);
+	YapRowidSetRecount(set);
+}
+
+void YapRowidSetMinus(YapRowidSet *set, YapRowidSet *other)
 {
-	__block BOOL stop = NO;
+	if (set == other)
+	{
+		YapRowidSetRemoveAll(set);
+		return;
+	}
 	
-	std::unordered_set<int64_t>::iterator iterator = set->rowids->begin();
-	std::unordered_set<int64_t>::iterator end = set->rowids->end();
+	std::vector<YapRowidContainer> result;
+	result.reserve(set->containers.size());
 	
-	while (iterator != end)
+	size_t j = 0;
+	
+	for (size_t i = 0; i < set->containers.size(); i++)
 	{
-		int64_t rowid = *iterator;
+		YapRowidContainer &container = set->containers[i];
+		
+		while (j < other->containers.size() && other->containers[j].high < container.high) {
+			j++;
+		}
 		
-		block(rowid, &stop);
+		if (j < other->containers.size() && other->containers[j].high == container.high)
+		{
+			YapRowidContainerMinus(container, other->containers[j]);
+		}
 		
-		if (stop) break;
-		iterator++;
+		if (container.cardinality > 0) {
+			result.push_back(std::move(container));
+		}
 	}
+	
+	set->containers.swap(result);
+	YapRowidSetRecount(set);
+}
+
+void YapRowidSetEnumerate(YapRowidSet *set, void (^block)(int64_t rowid, BOOL *stop))
+{
+	BOOL stop = NO;
+	
+	for (const YapRowidContainer &container : set->containers)
+	{
+		if (container.isBitmap())
+		{
+			for (uint32_t i = 0; i < YAP_ROWID_SET_BITMAP_WORDS; i++)
+			{
+				uint64_t word = container.bitmap[i];
+				while (word)
+				{
+					uint16_t low = (uint16_t)((i * 64) + (uint32_t)__builtin_ctzll(word));
+					word &= (word - 1);
+					
+					block(YapRowidSetRowid(container.high, low), &stop);
+					if (stop) return;
+				}
+			}
+		}
+		else
+		{
+			for (uint16_t low : container.array)
+			{
+				block(YapRowidSetRowid(container.high, low), &stop);
+				if (stop) return;
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapRowidSetBox
+
+- (instancetype)initWithRowidSet:(YapRowidSet *)inSet
+{
+	if ((self = [super init]))
+	{
+		set = inSet;
+	}
+	return self;
 }
+
+- (void)dealloc
+{
+	if (set) {
+		YapRowidSetRelease(set);
+	}
+}
+
+@end
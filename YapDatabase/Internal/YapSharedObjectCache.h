@@ -0,0 +1,78 @@
+#import <Foundation/Foundation.h>
+
+#import "YapCollectionKey.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The shared object cache is a database-wide (L2) cache of deserialized objects,
+ * which sits behind the per-connection objectCache (L1).
+ *
+ * Like YapMemoryTable, the cache supports versioning.
+ * There may be multiple values for a single key, with each value associated with a different snapshot.
+ * A value stored at snapshot N is valid for every snapshot >= N, until it's superseded by a newer value.
+ * So a connection on an older snapshot continues to see the value that was valid for its snapshot,
+ * while connections on newer snapshots see the newer value.
+ *
+ * Since the same object instance is handed to multiple connections (on multiple threads),
+ * the shared cache may only be used for immutable objects (i.e. connections using YapDatabasePolicyShare).
+ *
+ * The shared cache is thread-safe.
+**/
+@interface YapSharedObjectCache : NSObject
+
+/**
+ * The countLimit is the maximum number of keys stored in the cache.
+ * (Old versions of a key don't count against the limit, as they're discarded via checkpoint.)
+**/
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit;
+
+@property (atomic, assign, readonly) NSUInteger countLimit;
+
+/**
+ * Returns the object that's valid for the given snapshot, or nil if no such object is cached.
+**/
+- (nullable id)objectForKey:(YapCollectionKey *)key snapshot:(uint64_t)snapshot;
+
+/**
+ * Adds an object that was read from the database at the given snapshot.
+ *
+ * If the object was changed by a commit after the given snapshot, then the object is ignored.
+ * (The object is stale, as the reader is lagging behind.)
+**/
+- (void)setObject:(id)object forKey:(YapCollectionKey *)key snapshot:(uint64_t)snapshot;
+
+/**
+ * Invoked by YapDatabase before a changeset is committed (and thus before any connection can see it).
+ *
+ * Changed keys are superseded at the changeset's snapshot, either by the new object
+ * (if publishObjects is YES, or if the object adopts YapDatabaseImmutable),
+ * or by an empty value (meaning the new object is unknown).
+**/
+- (void)noteChangeset:(NSDictionary *)changeset publishObjects:(BOOL)publishObjects;
+
+/**
+ * Invoked once every connection is at or past the given snapshot.
+ * Discards values that are no longer visible to any connection.
+**/
+- (void)checkpoint:(uint64_t)minSnapshot;
+
+/**
+ * Discards everything.
+**/
+- (void)removeAllObjects;
+
+/**
+ * The number of keys in the cache.
+**/
+- (NSUInteger)count;
+
+/**
+ * Returns the estimated memory footprint of the cache (in bytes),
+ * including every cached value (and the older values retained for lagging connections).
+**/
+- (uint64_t)estimatedMemoryUsage;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,361 @@
+#import "YapSharedObjectCache.h"
+#import "YapDatabase.h"
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseAtomic.h"
+#import "YapCache.h"
+#import "YapDatabaseMemoryReportPrivate.h"
+#import "YapNull.h"
+#import "YapTouch.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+
+/**
+ * A single value (for a single key) and its associated snapshot.
+ * It is one value contained within a linked-list of possibly multiple values for the same key.
+ * The linked-list remains sorted, with the most recent value at the front of the linked-list.
+ *
+ * A nil object means the value changed at the snapshot, but the new value is unknown.
+**/
+@interface YapSharedObjectCacheValue : NSObject {
+@public
+	YapSharedObjectCacheValue *olderValue;
+	
+	uint64_t snapshot;
+	id object;
+}
+@end
+
+@implementation YapSharedObjectCacheValue
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YapSharedObjectCacheValue[%p]: snapshot(%llu), olderValue(%p), object(%@)>",
+	        self, snapshot, olderValue, object];
+}
+
+@end
+
+/**
+ * The keys changed by a single commit.
+ *
+ * These are retained until every connection is at or past the commit,
+ * so we can detect (and ignore) stale objects from connections that are lagging behind.
+**/
+@interface YapSharedObjectCacheChange : NSObject {
+@public
+	uint64_t snapshot;
+	
+	NSSet<YapCollectionKey *> *changedKeys;
+	NSSet<NSString *> *removedCollections;
+	BOOL allKeysRemoved;
+}
+@end
+
+@implementation YapSharedObjectCacheChange
+
+- (BOOL)containsKey:(YapCollectionKey *)key
+{
+	return allKeysRemoved || [changedKeys containsObject:key] || [removedCollections containsObject:key.collection];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapSharedObjectCache
+{
+	YAPUnfairLock lock;
+	
+	YapCache<YapCollectionKey *, YapSharedObjectCacheValue *> *cache;
+	NSMutableArray<YapSharedObjectCacheChange *> *changes;
+}
+
+@synthesize countLimit = countLimit;
+
+- (instancetype)initWithCountLimit:(NSUInteger)inCountLimit
+{
+	if ((self = [super init]))
+	{
+		countLimit = inCountLimit;
+		lock = YAP_UNFAIR_LOCK_INIT;
+		
+		cache = [[YapCache alloc] initWithCountLimit:countLimit keyCallbacks:[YapCollectionKey keyCallbacks]];
+		cache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
+		
+		changes = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (id)objectForKey:(YapCollectionKey *)key snapshot:(uint64_t)snapshot
+{
+	id result = nil;
+	
+	YAPUnfairLockLock(&lock);
+	{
+		__unsafe_unretained YapSharedObjectCacheValue *value = [cache objectForKey:key];
+		
+		while (value && value->snapshot > snapshot)
+		{
+			value = value->olderValue;
+		}
+		
+		if (value) {
+			result = value->object;
+		}
+	}
+	YAPUnfairLockUnlock(&lock);
+	
+	return result;
+}
+
+- (void)setObject:(id)object forKey:(YapCollectionKey *)key snapshot:(uint64_t)snapshot
+{
+	if (object == nil) return;
+	
+	YAPUnfairLockLock(&lock);
+	{
+		// Was the object changed by a commit the reader hasn't seen yet ?
+		// If so, the object is only valid for older snapshots, and we don't know for which ones.
+		
+		BOOL isStale = NO;
+		
+		for (YapSharedObjectCacheChange *change in [changes reverseObjectEnumerator])
+		{
+			if (change->snapshot <= snapshot) break;
+			
+			if ([change containsKey:key])
+			{
+				isStale = YES;
+				break;
+			}
+		}
+		
+		if (!isStale)
+		{
+			__unsafe_unretained YapSharedObjectCacheValue *latestValue = [cache objectForKey:key];
+			
+			// Note: Since there are no newer changes, if the latest value is newer than the given snapshot,
+			// then it was added by a reader on a newer snapshot (and thus represents the same object).
+			
+			if (latestValue == nil || (latestValue->snapshot <= snapshot && latestValue->object == nil))
+			{
+				YapSharedObjectCacheValue *value = [[YapSharedObjectCacheValue alloc] init];
+				value->snapshot = snapshot;
+				value->object = object;
+				value->olderValue = latestValue;
+				
+				[cache setObject:value forKey:key];
+			}
+		}
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
+- (void)noteChangeset:(NSDictionary *)changeset publishObjects:(BOOL)publishObjects
+{
+	uint64_t snapshot = [changeset[YapDatabaseSnapshotKey] unsignedLongLongValue];
+	
+	NSDictionary *objectChanges = changeset[YapDatabaseObjectChangesKey];
+	NSSet *removedKeys          = changeset[YapDatabaseRemovedKeysKey];
+	NSSet *removedCollections   = changeset[YapDatabaseRemovedCollectionsKey];
+	BOOL allKeysRemoved         = [changeset[YapDatabaseAllKeysRemovedKey] boolValue];
+	
+	NSSet *resetCollections = changeset[YapDatabaseResetCollectionsKey];
+	if ([resetCollections count] > 0)
+	{
+		// A reset collection (see coarseChangeset) invalidates every object in the collection
+		
+		if ([removedCollections count] > 0)
+			removedCollections = [removedCollections setByAddingObjectsFromSet:resetCollections];
+		else
+			removedCollections = resetCollections;
+	}
+	
+	if ([objectChanges count] == 0 && [removedKeys count] == 0 && [removedCollections count] == 0 && !allKeysRemoved)
+	{
+		// Nothing changed that affects us (e.g. only metadata changes)
+		return;
+	}
+	
+	id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
+	id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
+	
+	NSMutableSet *changedKeys = [NSMutableSet setWithCapacity:([objectChanges count] + [removedKeys count])];
+	
+	[objectChanges enumerateKeysAndObjectsUsingBlock:^(id key, id newObject, BOOL __unused *stop) {
+		
+		if (newObject != yapTouch) {
+			[changedKeys addObject:key];
+		}
+	}];
+	
+	if (removedKeys) {
+		[changedKeys unionSet:removedKeys];
+	}
+	
+	YapSharedObjectCacheChange *change = [[YapSharedObjectCacheChange alloc] init];
+	change->snapshot = snapshot;
+	change->changedKeys = changedKeys;
+	change->removedCollections = [removedCollections copy];
+	change->allKeysRemoved = allKeysRemoved;
+	
+	YAPUnfairLockLock(&lock);
+	{
+		[changes addObject:change];
+		
+		// Order matters.
+		// Consider the following database change:
+		//
+		// [transaction removeAllObjectsInAllCollections];
+		// [transaction setObject:obj forKey:key inCollection:collection];
+		
+		if (allKeysRemoved)
+		{
+			[cache removeAllObjects];
+		}
+		else if ([removedCollections count] > 0)
+		{
+			NSMutableArray *keysToRemove = [NSMutableArray array];
+			
+			[cache enumerateKeysWithBlock:^(YapCollectionKey *key, BOOL __unused *stop) {
+				
+				if ([removedCollections containsObject:key.collection]) {
+					[keysToRemove addObject:key];
+				}
+			}];
+			
+			[cache removeObjectsForKeys:keysToRemove];
+		}
+		
+		for (YapCollectionKey *key in changedKeys)
+		{
+			__unsafe_unretained YapSharedObjectCacheValue *latestValue = [cache objectForKey:key];
+			if (latestValue == nil) continue;
+			
+			id newObject = nil;
+			if (![removedKeys containsObject:key])
+			{
+				newObject = objectChanges[key];
+				if (newObject == yapNull || !(publishObjects || YapDatabaseIsImmutable(newObject))) {
+					newObject = nil;
+				}
+			}
+			
+			if (latestValue->snapshot == snapshot)
+			{
+				latestValue->object = newObject;
+			}
+			else
+			{
+				YapSharedObjectCacheValue *value = [[YapSharedObjectCacheValue alloc] init];
+				value->snapshot = snapshot;
+				value->object = newObject;
+				value->olderValue = latestValue;
+				
+				[cache setObject:value forKey:key];
+			}
+		}
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
+- (void)checkpoint:(uint64_t)minSnapshot
+{
+	YAPUnfairLockLock(&lock);
+	{
+		while ([changes count] > 0)
+		{
+			YapSharedObjectCacheChange *change = changes[0];
+			if (change->snapshot > minSnapshot) break;
+			
+			[changes removeObjectAtIndex:0];
+			
+			// Every connection is at or past this commit.
+			// So, for each changed key, only the newest value <= minSnapshot (and anything newer) remains visible.
+			
+			for (YapCollectionKey *key in change->changedKeys)
+			{
+				__unsafe_unretained YapSharedObjectCacheValue *latestValue = [cache objectForKey:key];
+				__unsafe_unretained YapSharedObjectCacheValue *value = latestValue;
+				
+				while (value && value->snapshot > minSnapshot)
+				{
+					value = value->olderValue;
+				}
+				
+				if (value == nil) continue;
+				
+				if (value == latestValue && value->object == nil)
+				{
+					// The only visible value is unknown.
+					[cache removeObjectForKey:key];
+				}
+				else
+				{
+					value->olderValue = nil;
+				}
+			}
+		}
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
+- (void)removeAllObjects
+{
+	YAPUnfairLockLock(&lock);
+	{
+		[cache removeAllObjects];
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
+- (NSUInteger)count
+{
+	NSUInteger count = 0;
+	
+	YAPUnfairLockLock(&lock);
+	{
+		count = [cache count];
+	}
+	YAPUnfairLockUnlock(&lock);
+	
+	return count;
+}
+
+- (uint64_t)estimatedMemoryUsage
+{
+	__block uint64_t size = 0;
+	
+	YAPUnfairLockLock(&lock);
+	{
+		size += [cache estimatedMemoryUsage];
+		
+		// The cache measured the latest value (for each key), but not the objects within the values.
+		
+		[cache enumerateKeysAndObjectsWithBlock:
+		    ^(YapCollectionKey __unused *key, YapSharedObjectCacheValue *latestValue, BOOL __unused *stop)
+		{
+			__unsafe_unretained YapSharedObjectCacheValue *value = latestValue;
+			while (value)
+			{
+				if (value != latestValue) {
+					size += YapDatabaseEstimatedObjectSize(value);
+				}
+				size += YapDatabaseEstimatedObjectSize(value->object);
+				
+				value = value->olderValue;
+			}
+		}];
+	}
+	YAPUnfairLockUnlock(&lock);
+	
+	return size;
+}
+
+@end
@@ -0,0 +1,78 @@
+#ifndef yap_shared_changelog_h
+#define yap_shared_changelog_h
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+struct yap_shared_changelog;
+typedef struct yap_shared_changelog yap_shared_changelog;
+
+/**
+ * When multi-process support is enabled, a connection only receives the changesets of its own process.
+ * If another process commits changes, the connection can't know what changed,
+ * and it would have to flush all of its caches.
+ *
+ * The yap_shared_changelog is a memory-mapped file (next to the database file),
+ * holding a ring buffer of recent changeset summaries, keyed by snapshot.
+ * The summary for a snapshot is stored in slot (snapshot % slot_count).
+ * So a process that's fallen behind by fewer than slot_count commits can catch up on what changed.
+ *
+ * The writer (holding the sqlite write lock) stores the summary before it commits,
+ * with the slot's sequence marked dirty, and marks it clean after the commit succeeds.
+ * Readers copy the summary without locking, and check the sequence before & after the copy (a seqlock).
+ * So a reader only ever accepts a complete summary of a committed snapshot.
+ *
+ * The summary itself is an opaque blob.
+**/
+
+/**
+ * Opens (or creates) the shared changelog file at the given path, and maps it into memory.
+ * Returns NULL if the file couldn't be opened or mapped.
+ *
+ * If reset is true, any existing summaries are discarded. (E.g. the database file was just created.)
+**/
+yap_shared_changelog* yap_shared_changelog_open(const char *path, bool reset);
+
+/**
+ * Unmaps & closes the shared changelog. The pointer is set to NULL.
+**/
+void yap_shared_changelog_close(yap_shared_changelog **log_in_out);
+
+/**
+ * The maximum length of a summary.
+**/
+size_t yap_shared_changelog_capacity(yap_shared_changelog *log);
+
+/**
+ * Stores the summary for the given (new) snapshot. Invoke before committing the transaction.
+ * Must only be invoked while holding the sqlite write lock.
+ *
+ * If bytes is NULL, or the length exceeds the capacity, the slot is invalidated instead.
+ * That is, other processes will have to flush their caches for this snapshot.
+**/
+void yap_shared_changelog_will_commit(yap_shared_changelog *log, uint64_t snapshot, const void *bytes, size_t length);
+
+/**
+ * Publishes the summary stored via yap_shared_changelog_will_commit, if the commit succeeded.
+ * If the commit failed, the slot is left invalid.
+**/
+void yap_shared_changelog_did_commit(yap_shared_changelog *log, uint64_t snapshot, bool committed);
+
+/**
+ * Copies the summary for the given snapshot into the buffer (which must be at least capacity bytes).
+ *
+ * Returns true if the summary was available, in which case length_out is set to the length of the summary.
+ * Returns false if the summary was overwritten (by a later snapshot), invalidated, or is being written.
+**/
+bool yap_shared_changelog_read(yap_shared_changelog *log, uint64_t snapshot, void *buffer, size_t *length_out);
+
+#if defined __cplusplus
+};
+#endif
+
+#endif /* yap_shared_changelog_h */
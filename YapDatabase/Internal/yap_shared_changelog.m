@@ -0,0 +1,210 @@
+#include "yap_shared_changelog.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define YAP_SHARED_CHANGELOG_MAGIC   0x59415043 // 'YAPC'
+#define YAP_SHARED_CHANGELOG_VERSION 1
+
+/**
+ * 64 slots of 32 KB (2 MB).
+ * The file is sparse, so only the slots that have been written to take up space on disk.
+**/
+#define YAP_SHARED_CHANGELOG_SLOT_COUNT 64
+#define YAP_SHARED_CHANGELOG_SLOT_SIZE  (32 * 1024)
+
+#define YAP_SHARED_CHANGELOG_HEADER_SIZE 64
+
+#define yap_shared_changelog_clean(snapshot) ((snapshot) << 1)
+#define yap_shared_changelog_dirty(snapshot) (((snapshot) << 1) | 1)
+
+/**
+ * The layout of the mapped file:
+ * The header (padded to YAP_SHARED_CHANGELOG_HEADER_SIZE), followed by the slots.
+ *
+ * Lock-free 64-bit atomics work across processes (for memory mapped with MAP_SHARED).
+**/
+typedef struct {
+	_Atomic uint32_t magic;
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t slot_size;
+} yap_shared_changelog_header;
+
+typedef struct {
+	_Atomic uint64_t sequence; // (snapshot << 1) | dirty, or zero if the slot has never been used
+	uint64_t length;
+	uint8_t bytes[];
+} yap_shared_changelog_slot;
+
+struct yap_shared_changelog {
+	int fd;
+	size_t size;
+	void *region;
+};
+
+static inline yap_shared_changelog_header* yap_shared_changelog_get_header(yap_shared_changelog *log)
+{
+	return (yap_shared_changelog_header *)log->region;
+}
+
+static inline yap_shared_changelog_slot* yap_shared_changelog_get_slot(yap_shared_changelog *log, uint64_t snapshot)
+{
+	size_t index = (size_t)(snapshot % YAP_SHARED_CHANGELOG_SLOT_COUNT);
+	size_t offset = YAP_SHARED_CHANGELOG_HEADER_SIZE + (index * YAP_SHARED_CHANGELOG_SLOT_SIZE);
+	
+	return (yap_shared_changelog_slot *)((uint8_t *)log->region + offset);
+}
+
+yap_shared_changelog* yap_shared_changelog_open(const char *path, bool reset)
+{
+	if (path == NULL) return NULL;
+	
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) return NULL;
+	
+	size_t size = YAP_SHARED_CHANGELOG_HEADER_SIZE +
+	              (YAP_SHARED_CHANGELOG_SLOT_COUNT * YAP_SHARED_CHANGELOG_SLOT_SIZE);
+	
+	off_t fileSize = lseek(fd, 0, SEEK_END);
+	if (fileSize < (off_t)size)
+	{
+		// Extending the file fills it with zeros, which is an invalid (uninitialized) header, and empty slots.
+		if (ftruncate(fd, (off_t)size) != 0)
+		{
+			close(fd);
+			return NULL;
+		}
+	}
+	
+	void *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (region == MAP_FAILED)
+	{
+		close(fd);
+		return NULL;
+	}
+	
+	yap_shared_changelog *log = (yap_shared_changelog *)calloc(1, sizeof(yap_shared_changelog));
+	log->fd = fd;
+	log->size = size;
+	log->region = region;
+	
+	yap_shared_changelog_header *header = yap_shared_changelog_get_header(log);
+	
+	uint32_t expected = 0;
+	if (atomic_compare_exchange_strong(&header->magic, &expected, YAP_SHARED_CHANGELOG_MAGIC))
+	{
+		// We're the first to use the file.
+		
+		header->version = YAP_SHARED_CHANGELOG_VERSION;
+		header->slot_count = YAP_SHARED_CHANGELOG_SLOT_COUNT;
+		header->slot_size = YAP_SHARED_CHANGELOG_SLOT_SIZE;
+	}
+	else if (expected != YAP_SHARED_CHANGELOG_MAGIC ||
+	         header->version != YAP_SHARED_CHANGELOG_VERSION ||
+	         header->slot_count != YAP_SHARED_CHANGELOG_SLOT_COUNT ||
+	         header->slot_size != YAP_SHARED_CHANGELOG_SLOT_SIZE)
+	{
+		yap_shared_changelog_close(&log);
+		return NULL;
+	}
+	
+	if (reset)
+	{
+		// The snapshot numbers of a new database file start over.
+		// So any summaries left over from a previous database file (at the same path) must never be read.
+		
+		for (uint64_t i = 0; i < YAP_SHARED_CHANGELOG_SLOT_COUNT; i++)
+		{
+			atomic_store(&yap_shared_changelog_get_slot(log, i)->sequence, 0);
+		}
+	}
+	
+	return log;
+}
+
+void yap_shared_changelog_close(yap_shared_changelog **log_in_out)
+{
+	if (log_in_out == NULL || *log_in_out == NULL) return;
+	
+	yap_shared_changelog *log = *log_in_out;
+	
+	munmap(log->region, log->size);
+	close(log->fd);
+	free(log);
+	
+	*log_in_out = NULL;
+}
+
+size_t yap_shared_changelog_capacity(yap_shared_changelog *log)
+{
+	if (log == NULL) return 0;
+	
+	return YAP_SHARED_CHANGELOG_SLOT_SIZE - sizeof(yap_shared_changelog_slot);
+}
+
+void yap_shared_changelog_will_commit(yap_shared_changelog *log, uint64_t snapshot, const void *bytes, size_t length)
+{
+	if (log == NULL) return;
+	
+	yap_shared_changelog_slot *slot = yap_shared_changelog_get_slot(log, snapshot);
+	
+	// Mark the slot dirty before touching the bytes.
+	// A reader that's copying the previous summary (for an older snapshot) will notice the change of sequence.
+	
+	atomic_store(&slot->sequence, yap_shared_changelog_dirty(snapshot));
+	atomic_thread_fence(memory_order_seq_cst);
+	
+	if (bytes == NULL || length > yap_shared_changelog_capacity(log))
+	{
+		// The slot stays dirty, even after the commit (see yap_shared_changelog_did_commit).
+		slot->length = UINT64_MAX;
+		return;
+	}
+	
+	memcpy(slot->bytes, bytes, length);
+	slot->length = length;
+}
+
+void yap_shared_changelog_did_commit(yap_shared_changelog *log, uint64_t snapshot, bool committed)
+{
+	if (log == NULL) return;
+	
+	yap_shared_changelog_slot *slot = yap_shared_changelog_get_slot(log, snapshot);
+	
+	if (!committed || slot->length == UINT64_MAX) return;
+	
+	// The release ordering ensures the bytes are visible to any reader that sees the clean sequence.
+	
+	uint64_t expected = yap_shared_changelog_dirty(snapshot);
+	atomic_compare_exchange_strong_explicit(&slot->sequence, &expected, yap_shared_changelog_clean(snapshot),
+	                                        memory_order_release, memory_order_relaxed);
+}
+
+bool yap_shared_changelog_read(yap_shared_changelog *log, uint64_t snapshot, void *buffer, size_t *length_out)
+{
+	if (log == NULL || snapshot == 0) return false;
+	
+	yap_shared_changelog_slot *slot = yap_shared_changelog_get_slot(log, snapshot);
+	
+	uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+	if (sequence != yap_shared_changelog_clean(snapshot)) return false;
+	
+	uint64_t length = slot->length;
+	if (length > yap_shared_changelog_capacity(log)) return false;
+	
+	memcpy(buffer, slot->bytes, (size_t)length);
+	
+	// If the writer started overwriting the slot (for a later snapshot) during the copy,
+	// then the sequence has changed, and the copy may be torn.
+	
+	atomic_thread_fence(memory_order_acquire);
+	if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence) return false;
+	
+	if (length_out) *length_out = (size_t)length;
+	return true;
+}
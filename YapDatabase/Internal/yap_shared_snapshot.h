@@ -0,0 +1,70 @@
+#ifndef yap_shared_snapshot_h
+#define yap_shared_snapshot_h
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct yap_shared_snapshot;
+typedef struct yap_shared_snapshot yap_shared_snapshot;
+
+/**
+ * When multi-process support is enabled, a connection cannot trust the in-memory snapshot of its own process.
+ * Another process may have committed changes in the meantime.
+ * So a read-write transaction would need to re-read the 'snapshot' row from the database every time.
+ *
+ * The yap_shared_snapshot is a small memory-mapped file (next to the database file),
+ * which holds the latest committed snapshot number, shared between every process using the database.
+ *
+ * The value is a single 64-bit word: ((snapshot + 1) << 1) when clean, or ((snapshot << 1) | 1) when dirty.
+ * Zero (i.e. a newly created file) is also dirty.
+ * A writer (holding the sqlite write lock) marks the value dirty before it commits,
+ * and stores the new (clean) snapshot after the commit succeeds.
+ * Both are compare-and-swap operations, so a writer that's late (or that crashed) can never overwrite the value
+ * stored by a subsequent writer. A clean value is always the latest committed snapshot.
+ * A dirty value is unknown, in which case the snapshot must be read from the database.
+**/
+
+/**
+ * Opens (or creates) the shared snapshot file at the given path, and maps it into memory.
+ * Returns NULL if the file couldn't be opened or mapped.
+**/
+yap_shared_snapshot* yap_shared_snapshot_open(const char *path);
+
+/**
+ * Unmaps & closes the shared snapshot. The pointer is set to NULL.
+**/
+void yap_shared_snapshot_close(yap_shared_snapshot **shared_in_out);
+
+/**
+ * Returns true if the shared value is clean, in which case snapshot_out is set to the latest committed snapshot.
+ * Returns false if the value is unknown (e.g. a commit is in progress).
+**/
+bool yap_shared_snapshot_get(yap_shared_snapshot *shared, uint64_t *snapshot_out);
+
+/**
+ * Stores the given (clean) snapshot, which the caller has read from the database.
+ * Must only be invoked while holding the sqlite write lock.
+**/
+void yap_shared_snapshot_set(yap_shared_snapshot *shared, uint64_t snapshot);
+
+/**
+ * Marks the value dirty. Invoke before committing a transaction that increments the snapshot.
+ * Must only be invoked while holding the sqlite write lock.
+**/
+void yap_shared_snapshot_will_commit(yap_shared_snapshot *shared, uint64_t old_snapshot);
+
+/**
+ * Stores the new (clean) snapshot, if the value is still dirty as of yap_shared_snapshot_will_commit.
+ * If the commit failed, pass a new_snapshot of zero, which leaves the value dirty.
+**/
+void yap_shared_snapshot_did_commit(yap_shared_snapshot *shared, uint64_t old_snapshot, uint64_t new_snapshot);
+
+#if defined __cplusplus
+};
+#endif
+
+#endif /* yap_shared_snapshot_h */
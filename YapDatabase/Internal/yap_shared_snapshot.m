@@ -0,0 +1,131 @@
+#include "yap_shared_snapshot.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define YAP_SHARED_SNAPSHOT_MAGIC   0x59415053 // 'YAPS'
+#define YAP_SHARED_SNAPSHOT_VERSION 2
+
+/**
+ * A clean value is never zero, so that a zero value (e.g. a newly created file) is always dirty.
+ * Otherwise a process that opens the file concurrently with its creator
+ * could read the (zero-filled) value as a clean snapshot of zero.
+**/
+#define yap_shared_snapshot_clean(snapshot) (((snapshot) + 1) << 1)
+#define yap_shared_snapshot_dirty(snapshot) (((snapshot) << 1) | 1)
+
+#define yap_shared_snapshot_is_clean(value) (((value) != 0) && (((value) & 1) == 0))
+
+/**
+ * The layout of the mapped file.
+ * Lock-free 64-bit atomics work across processes (for memory mapped with MAP_SHARED).
+**/
+typedef struct {
+	_Atomic uint32_t magic;
+	uint32_t version;
+	_Atomic uint64_t value;
+} yap_shared_snapshot_region;
+
+struct yap_shared_snapshot {
+	int fd;
+	yap_shared_snapshot_region *region;
+};
+
+yap_shared_snapshot* yap_shared_snapshot_open(const char *path)
+{
+	if (path == NULL) return NULL;
+	
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) return NULL;
+	
+	size_t size = (size_t)getpagesize();
+	
+	off_t fileSize = lseek(fd, 0, SEEK_END);
+	if (fileSize < (off_t)size)
+	{
+		// Extending the file fills it with zeros, which is an invalid (uninitialized) region.
+		if (ftruncate(fd, (off_t)size) != 0)
+		{
+			close(fd);
+			return NULL;
+		}
+	}
+	
+	void *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (region == MAP_FAILED)
+	{
+		close(fd);
+		return NULL;
+	}
+	
+	yap_shared_snapshot *shared = (yap_shared_snapshot *)calloc(1, sizeof(yap_shared_snapshot));
+	shared->fd = fd;
+	shared->region = (yap_shared_snapshot_region *)region;
+	
+	uint32_t expected = 0;
+	if (atomic_compare_exchange_strong(&shared->region->magic, &expected, YAP_SHARED_SNAPSHOT_MAGIC))
+	{
+		// We're the first to use the file.
+		// The value is zero (dirty) until the first writer stores the snapshot from the database.
+		
+		shared->region->version = YAP_SHARED_SNAPSHOT_VERSION;
+	}
+	else if (expected != YAP_SHARED_SNAPSHOT_MAGIC)
+	{
+		yap_shared_snapshot_close(&shared);
+	}
+	
+	return shared;
+}
+
+void yap_shared_snapshot_close(yap_shared_snapshot **shared_in_out)
+{
+	if (shared_in_out == NULL || *shared_in_out == NULL) return;
+	
+	yap_shared_snapshot *shared = *shared_in_out;
+	
+	munmap(shared->region, (size_t)getpagesize());
+	close(shared->fd);
+	free(shared);
+	
+	*shared_in_out = NULL;
+}
+
+bool yap_shared_snapshot_get(yap_shared_snapshot *shared, uint64_t *snapshot_out)
+{
+	if (shared == NULL) return false;
+	
+	uint64_t value = atomic_load(&shared->region->value);
+	if (!yap_shared_snapshot_is_clean(value)) return false;
+	
+	if (snapshot_out) *snapshot_out = (value >> 1) - 1;
+	return true;
+}
+
+void yap_shared_snapshot_set(yap_shared_snapshot *shared, uint64_t snapshot)
+{
+	if (shared == NULL) return;
+	
+	atomic_store(&shared->region->value, yap_shared_snapshot_clean(snapshot));
+}
+
+void yap_shared_snapshot_will_commit(yap_shared_snapshot *shared, uint64_t old_snapshot)
+{
+	if (shared == NULL) return;
+	
+	atomic_store(&shared->region->value, yap_shared_snapshot_dirty(old_snapshot));
+}
+
+void yap_shared_snapshot_did_commit(yap_shared_snapshot *shared, uint64_t old_snapshot, uint64_t new_snapshot)
+{
+	if (shared == NULL || new_snapshot == 0) return;
+	
+	// If another writer has since stored a value (e.g. after reading the snapshot from the database),
+	// then our value is out-of-date, and the exchange fails.
+	
+	uint64_t expected = yap_shared_snapshot_dirty(old_snapshot);
+	atomic_compare_exchange_strong(&shared->region->value, &expected, yap_shared_snapshot_clean(new_snapshot));
+}
@@ -0,0 +1,72 @@
+#ifndef yap_vfs_memory_h
+#define yap_vfs_memory_h
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include "sqlite3.h"
+
+struct yap_vfs_memory;
+typedef struct yap_vfs_memory yap_vfs_memory;
+
+/**
+ * The yap_vfs_memory is a VFS that stores every file in memory (in the heap),
+ * and shares them amongst every sqlite3 instance (within the process) that uses the VFS.
+ *
+ * Unlike ":memory:" databases (which are private to a single sqlite3 instance),
+ * or the "memdb" VFS (which doesn't support WAL mode),
+ * this VFS supports everything that YapDatabase depends upon:
+ *
+ * - multiple sqlite3 instances per database (each with its own file handles)
+ * - file locking (for the main database file)
+ * - shared memory (xShm methods), which is required for WAL mode
+ *
+ * Thus connections get the exact same snapshot isolation they'd get with a database file.
+ *
+ * Files are identified by name, and the names are scoped to the VFS instance.
+ * A file is freed when it's deleted (and no longer open), or when the VFS is unregistered.
+ *
+ * Typically the yap_vfs_shim is registered atop this VFS.
+**/
+
+/**
+ * Invoke this method to register a yap_vfs_memory with the sqlite system.
+ *
+ * @param vfs_name
+ *   The name to use when registering the VFS with sqlite.
+ *   In order to use the VFS, you pass the same name when opening a database.
+ *   That is, as the last parameter to sqlite3_open_v2() (or as the underlying_vfs_name of a yap_vfs_shim).
+ *
+ * @param vfs_out
+ *   The allocated vfs instance.
+ *   You are responsible for holding onto this pointer,
+ *   and properly unregistering the VFS when you're done using it.
+ *
+ * @return
+ *   SQLITE_OK if everything went right.
+ *   Some other SQLITE error if something went wrong.
+**/
+int yap_vfs_memory_register(const char *vfs_name, yap_vfs_memory **vfs_out);
+
+/**
+ * Invoke this method to unregister the yap_vfs_memory with the sqlite system.
+ * Be sure you don't do this until every sqlite3 instance that uses it has been closed.
+ *
+ * Every file stored within the VFS is freed.
+ *
+ * @param vfs_in_out
+ *   The previous output from yap_vfs_memory_register.
+ *   This memory will be freed within this method, and the pointer will be set to NULL.
+ *
+ * @return
+ *   SQLITE_OK if everything went right.
+ *   Some other SQLITE error if something went wrong.
+**/
+int yap_vfs_memory_unregister(yap_vfs_memory **vfs_in_out);
+
+#if defined __cplusplus
+};
+#endif
+
+#endif /* yap_vfs_memory_h */
@@ -0,0 +1,936 @@
+#include "yap_vfs_memory.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+typedef struct yap_memory_node yap_memory_node;
+typedef struct yap_memory_file yap_memory_file;
+
+struct yap_vfs_memory {
+	sqlite3_vfs base;         // Base class. Must be first in struct.
+	sqlite3_vfs *pDefault;    // The default VFS. Used for randomness, time, etc.
+	
+	sqlite3_mutex *mutex;     // Protects the list of nodes, as well as the locks & shared memory of every node.
+	yap_memory_node *nodes;   // Must hold mutex
+};
+
+/**
+ * A node is the storage for a single file.
+ * Every handle that's opened for the same file (by name) shares the same node.
+**/
+struct yap_memory_node {
+	yap_memory_node *next;    // Must hold vfs->mutex
+	char *name;               // NULL for temp files (which are never in the list)
+	
+	int openCount;            // Must hold vfs->mutex
+	bool deleted;             // Must hold vfs->mutex. If set, the node is freed when the last handle is closed.
+	
+	sqlite3_mutex *dataMutex; // Protects data, size & capacity
+	uint8_t *data;
+	sqlite3_int64 size;
+	sqlite3_int64 capacity;
+	
+	// File locks (must hold vfs->mutex)
+	
+	int sharedCount;          // Number of handles holding (at least) a SHARED lock
+	yap_memory_file *writer;  // The handle holding a RESERVED, PENDING or EXCLUSIVE lock (if any)
+	int writerLock;           // The lock held by the writer
+	
+	// Shared memory, i.e. the wal-index (must hold vfs->mutex)
+	
+	void **shmRegions;
+	int shmRegionCount;
+	int shmAttachedCount;
+	int shmSharedLocks[SQLITE_SHM_NLOCK];
+	bool shmExclusiveLocks[SQLITE_SHM_NLOCK];
+};
+
+struct yap_memory_file {
+	sqlite3_file base;        // Base class. Must be first in struct.
+	
+	yap_vfs_memory *vfs;
+	yap_memory_node *node;
+	
+	int lock;                 // Must hold vfs->mutex
+	bool shmAttached;         // Must hold vfs->mutex
+	uint16_t shmSharedMask;   // Must hold vfs->mutex
+	uint16_t shmExclusiveMask;// Must hold vfs->mutex
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Nodes
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static yap_memory_node* yap_memory_node_alloc(const char *zName)
+{
+	size_t nameLen = zName ? (strlen(zName) + 1) : 0;
+	
+	// node memory = {struct yap_memory_node, char[nameLen]}
+	
+	yap_memory_node *node = sqlite3_malloc64(sizeof(yap_memory_node) + nameLen);
+	if (node == NULL) {
+		return NULL;
+	}
+	memset(node, 0, sizeof(yap_memory_node) + nameLen);
+	
+	if (zName)
+	{
+		node->name = (char *)&node[1];
+		memcpy(node->name, zName, nameLen);
+	}
+	
+	node->dataMutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+	node->writerLock = SQLITE_LOCK_NONE;
+	
+	return node;
+}
+
+static void yap_memory_node_free_shm(yap_memory_node *node)
+{
+	for (int i = 0; i < node->shmRegionCount; i++)
+	{
+		sqlite3_free(node->shmRegions[i]);
+	}
+	
+	sqlite3_free(node->shmRegions);
+	node->shmRegions = NULL;
+	node->shmRegionCount = 0;
+}
+
+static void yap_memory_node_free(yap_memory_node *node)
+{
+	yap_memory_node_free_shm(node);
+	
+	sqlite3_free(node->data);
+	
+	if (node->dataMutex) {
+		sqlite3_mutex_free(node->dataMutex);
+	}
+	
+	sqlite3_free(node);
+}
+
+/**
+ * Must hold vfs->mutex.
+**/
+static yap_memory_node* yap_vfs_memory_find(yap_vfs_memory *memVFS, const char *zName)
+{
+	for (yap_memory_node *node = memVFS->nodes; node; node = node->next)
+	{
+		if (strcmp(node->name, zName) == 0) {
+			return node;
+		}
+	}
+	
+	return NULL;
+}
+
+/**
+ * Must hold vfs->mutex.
+**/
+static void yap_vfs_memory_unlink(yap_vfs_memory *memVFS, yap_memory_node *node)
+{
+	yap_memory_node **nodePtr = &memVFS->nodes;
+	
+	while (*nodePtr && (*nodePtr != node)) {
+		nodePtr = &(*nodePtr)->next;
+	}
+	
+	if (*nodePtr) {
+		*nodePtr = node->next;
+	}
+	
+	node->next = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Locks
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Must hold vfs->mutex.
+**/
+static void yap_memory_file_unlock_locked(yap_memory_file *memFile, int eLock)
+{
+	yap_memory_node *node = memFile->node;
+	
+	if (memFile->lock <= eLock) return;
+	
+	if (node->writer == memFile)
+	{
+		node->writer = NULL;
+		node->writerLock = SQLITE_LOCK_NONE;
+	}
+	
+	if (eLock == SQLITE_LOCK_NONE) {
+		node->sharedCount--;
+	}
+	
+	memFile->lock = eLock;
+}
+
+/**
+ * Must hold vfs->mutex.
+**/
+static void yap_memory_file_shm_unlock_locked(yap_memory_file *memFile, int offset, int n)
+{
+	yap_memory_node *node = memFile->node;
+	
+	for (int i = offset; i < (offset + n); i++)
+	{
+		uint16_t bit = (uint16_t)(1 << i);
+		
+		if (memFile->shmSharedMask & bit) {
+			node->shmSharedLocks[i]--;
+		}
+		if (memFile->shmExclusiveMask & bit) {
+			node->shmExclusiveLocks[i] = false;
+		}
+		
+		memFile->shmSharedMask &= ~bit;
+		memFile->shmExclusiveMask &= ~bit;
+	}
+}
+
+/**
+ * Must hold vfs->mutex.
+**/
+static void yap_memory_file_shm_detach_locked(yap_memory_file *memFile)
+{
+	yap_memory_node *node = memFile->node;
+	
+	yap_memory_file_shm_unlock_locked(memFile, 0, SQLITE_SHM_NLOCK);
+	
+	if (memFile->shmAttached)
+	{
+		memFile->shmAttached = false;
+		node->shmAttachedCount--;
+		
+		// Once nobody is attached, the wal-index is discarded.
+		// The next handle to open the WAL rebuilds it (from the WAL) as part of the usual recovery.
+		
+		if (node->shmAttachedCount == 0) {
+			yap_memory_node_free_shm(node);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark sqlite3_io_methods
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int yap_memory_file_close(sqlite3_file *file)
+{
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	yap_memory_node *node = memFile->node;
+	yap_vfs_memory *memVFS = memFile->vfs;
+	
+	sqlite3_mutex_enter(memVFS->mutex);
+	
+	yap_memory_file_shm_detach_locked(memFile);
+	yap_memory_file_unlock_locked(memFile, SQLITE_LOCK_NONE);
+	
+	node->openCount--;
+	bool freeNode = node->deleted && (node->openCount == 0);
+	
+	sqlite3_mutex_leave(memVFS->mutex);
+	
+	if (freeNode) {
+		yap_memory_node_free(node);
+	}
+	
+	memFile->node = NULL;
+	memFile->base.pMethods = NULL;
+	
+	return SQLITE_OK;
+}
+
+static int yap_memory_file_read(sqlite3_file *file, void *zBuf, int iAmt, sqlite3_int64 iOfst)
+{
+	yap_memory_node *node = ((yap_memory_file *)file)->node;
+	int result = SQLITE_OK;
+	
+	sqlite3_mutex_enter(node->dataMutex);
+	
+	if ((iOfst + iAmt) <= node->size)
+	{
+		memcpy(zBuf, node->data + iOfst, (size_t)iAmt);
+	}
+	else
+	{
+		// From the SQLite docs:
+		//
+		// > If xRead() returns SQLITE_IOERR_SHORT_READ it must also fill in the unread portions
+		// > of the buffer with zeros.
+		
+		sqlite3_int64 available = (iOfst < node->size) ? (node->size - iOfst) : 0;
+		
+		if (available > 0) {
+			memcpy(zBuf, node->data + iOfst, (size_t)available);
+		}
+		memset((uint8_t *)zBuf + available, 0, (size_t)(iAmt - available));
+		
+		result = SQLITE_IOERR_SHORT_READ;
+	}
+	
+	sqlite3_mutex_leave(node->dataMutex);
+	return result;
+}
+
+static int yap_memory_file_write(sqlite3_file *file, const void *zBuf, int iAmt, sqlite3_int64 iOfst)
+{
+	yap_memory_node *node = ((yap_memory_file *)file)->node;
+	sqlite3_int64 end = iOfst + iAmt;
+	
+	sqlite3_mutex_enter(node->dataMutex);
+	
+	if (end > node->capacity)
+	{
+		sqlite3_int64 newCapacity = (node->capacity > 0) ? (node->capacity * 2) : 8192;
+		while (newCapacity < end) {
+			newCapacity *= 2;
+		}
+		
+		uint8_t *newData = sqlite3_realloc64(node->data, (sqlite3_uint64)newCapacity);
+		if (newData == NULL)
+		{
+			sqlite3_mutex_leave(node->dataMutex);
+			return SQLITE_IOERR_NOMEM;
+		}
+		
+		node->data = newData;
+		node->capacity = newCapacity;
+	}
+	
+	if (iOfst > node->size) {
+		memset(node->data + node->size, 0, (size_t)(iOfst - node->size));
+	}
+	memcpy(node->data + iOfst, zBuf, (size_t)iAmt);
+	
+	if (end > node->size) {
+		node->size = end;
+	}
+	
+	sqlite3_mutex_leave(node->dataMutex);
+	return SQLITE_OK;
+}
+
+static int yap_memory_file_truncate(sqlite3_file *file, sqlite3_int64 size)
+{
+	yap_memory_node *node = ((yap_memory_file *)file)->node;
+	
+	sqlite3_mutex_enter(node->dataMutex);
+	
+	if (size < node->size) {
+		node->size = size;
+	}
+	
+	// Release the memory if the file shrinks considerably.
+	// E.g. when the WAL is truncated after a checkpoint (see journal_size_limit).
+	
+	if (node->capacity > (node->size * 2))
+	{
+		if (node->size == 0)
+		{
+			sqlite3_free(node->data);
+			node->data = NULL;
+			node->capacity = 0;
+		}
+		else
+		{
+			uint8_t *newData = sqlite3_realloc64(node->data, (sqlite3_uint64)node->size);
+			if (newData)
+			{
+				node->data = newData;
+				node->capacity = node->size;
+			}
+		}
+	}
+	
+	sqlite3_mutex_leave(node->dataMutex);
+	return SQLITE_OK;
+}
+
+static int yap_memory_file_sync(sqlite3_file *file, int flags)
+{
+	// There's nothing to sync
+	return SQLITE_OK;
+}
+
+static int yap_memory_file_fileSize(sqlite3_file *file, sqlite3_int64 *pSize)
+{
+	yap_memory_node *node = ((yap_memory_file *)file)->node;
+	
+	sqlite3_mutex_enter(node->dataMutex);
+	*pSize = node->size;
+	sqlite3_mutex_leave(node->dataMutex);
+	
+	return SQLITE_OK;
+}
+
+static int yap_memory_file_lock(sqlite3_file *file, int eLock)
+{
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	yap_memory_node *node = memFile->node;
+	
+	if (memFile->lock >= eLock) return SQLITE_OK;
+	
+	int result = SQLITE_OK;
+	sqlite3_mutex_enter(memFile->vfs->mutex);
+	
+	if (node->writer && (node->writer != memFile))
+	{
+		// Another handle is writing.
+		// Its RESERVED lock still allows new readers, but a PENDING (or EXCLUSIVE) lock does not.
+		
+		if ((eLock > SQLITE_LOCK_SHARED) || (node->writerLock >= SQLITE_LOCK_PENDING))
+		{
+			result = SQLITE_BUSY;
+			goto done;
+		}
+	}
+	
+	if (memFile->lock == SQLITE_LOCK_NONE)
+	{
+		node->sharedCount++;
+		memFile->lock = SQLITE_LOCK_SHARED;
+	}
+	
+	if (eLock == SQLITE_LOCK_SHARED) goto done;
+	
+	node->writer = memFile;
+	
+	if (eLock == SQLITE_LOCK_RESERVED)
+	{
+		memFile->lock = node->writerLock = SQLITE_LOCK_RESERVED;
+	}
+	else // if (eLock == SQLITE_LOCK_EXCLUSIVE)
+	{
+		// The PENDING lock prevents new readers, while we wait for the existing readers to finish.
+		
+		if (node->sharedCount > 1)
+		{
+			memFile->lock = node->writerLock = SQLITE_LOCK_PENDING;
+			result = SQLITE_BUSY;
+		}
+		else
+		{
+			memFile->lock = node->writerLock = SQLITE_LOCK_EXCLUSIVE;
+		}
+	}
+
+done:
+	
+	sqlite3_mutex_leave(memFile->vfs->mutex);
+	return result;
+}
+
+static int yap_memory_file_unlock(sqlite3_file *file, int eLock)
+{
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	
+	sqlite3_mutex_enter(memFile->vfs->mutex);
+	yap_memory_file_unlock_locked(memFile, eLock);
+	sqlite3_mutex_leave(memFile->vfs->mutex);
+	
+	return SQLITE_OK;
+}
+
+static int yap_memory_file_checkReservedLock(sqlite3_file *file, int *pResOut)
+{
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	
+	sqlite3_mutex_enter(memFile->vfs->mutex);
+	*pResOut = (memFile->node->writer != NULL) ? 1 : 0;
+	sqlite3_mutex_leave(memFile->vfs->mutex);
+	
+	return SQLITE_OK;
+}
+
+static int yap_memory_file_fileControl(sqlite3_file *file, int op, void *pArg)
+{
+	return SQLITE_NOTFOUND;
+}
+
+static int yap_memory_file_sectorSize(sqlite3_file *file)
+{
+	return 512;
+}
+
+static int yap_memory_file_deviceCharacteristics(sqlite3_file *file)
+{
+	return SQLITE_IOCAP_SAFE_APPEND | SQLITE_IOCAP_SEQUENTIAL | SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+}
+
+static int yap_memory_file_shmMap(sqlite3_file *file, int iRegion, int szRegion, int bExtend, void volatile **pp)
+{
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	yap_memory_node *node = memFile->node;
+	
+	int result = SQLITE_OK;
+	*pp = NULL;
+	
+	sqlite3_mutex_enter(memFile->vfs->mutex);
+	
+	if (!memFile->shmAttached)
+	{
+		memFile->shmAttached = true;
+		node->shmAttachedCount++;
+	}
+	
+	if (iRegion >= node->shmRegionCount)
+	{
+		if (!bExtend) goto done;
+		
+		void **newRegions = sqlite3_realloc64(node->shmRegions, (sqlite3_uint64)(iRegion + 1) * sizeof(void *));
+		if (newRegions == NULL)
+		{
+			result = SQLITE_IOERR_NOMEM;
+			goto done;
+		}
+		node->shmRegions = newRegions;
+		
+		while (node->shmRegionCount <= iRegion)
+		{
+			void *region = sqlite3_malloc(szRegion);
+			if (region == NULL)
+			{
+				result = SQLITE_IOERR_NOMEM;
+				goto done;
+			}
+			memset(region, 0, (size_t)szRegion);
+			
+			node->shmRegions[node->shmRegionCount] = region;
+			node->shmRegionCount++;
+		}
+	}
+	
+	*pp = node->shmRegions[iRegion];
+
+done:
+	
+	sqlite3_mutex_leave(memFile->vfs->mutex);
+	return result;
+}
+
+static int yap_memory_file_shmLock(sqlite3_file *file, int offset, int n, int flags)
+{
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	yap_memory_node *node = memFile->node;
+	
+	uint16_t mask = (uint16_t)((1 << (offset + n)) - (1 << offset));
+	int result = SQLITE_OK;
+	
+	sqlite3_mutex_enter(memFile->vfs->mutex);
+	
+	if (flags & SQLITE_SHM_UNLOCK)
+	{
+		yap_memory_file_shm_unlock_locked(memFile, offset, n);
+	}
+	else if (flags & SQLITE_SHM_SHARED)
+	{
+		// Shared locks are always for a single slot (i.e. n == 1)
+		
+		if ((memFile->shmSharedMask & mask) == 0)
+		{
+			if (node->shmExclusiveLocks[offset])
+			{
+				result = SQLITE_BUSY;
+			}
+			else
+			{
+				node->shmSharedLocks[offset]++;
+				memFile->shmSharedMask |= mask;
+			}
+		}
+	}
+	else // if (flags & SQLITE_SHM_EXCLUSIVE)
+	{
+		for (int i = offset; i < (offset + n); i++)
+		{
+			bool heldByOther = node->shmExclusiveLocks[i] && !(memFile->shmExclusiveMask & (1 << i));
+			
+			if (heldByOther || (node->shmSharedLocks[i] > 0))
+			{
+				result = SQLITE_BUSY;
+				break;
+			}
+		}
+		
+		if (result == SQLITE_OK)
+		{
+			for (int i = offset; i < (offset + n); i++) {
+				node->shmExclusiveLocks[i] = true;
+			}
+			memFile->shmExclusiveMask |= mask;
+		}
+	}
+	
+	sqlite3_mutex_leave(memFile->vfs->mutex);
+	return result;
+}
+
+static void yap_memory_file_shmBarrier(sqlite3_file *file)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+static int yap_memory_file_shmUnmap(sqlite3_file *file, int deleteFlag)
+{
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	
+	sqlite3_mutex_enter(memFile->vfs->mutex);
+	yap_memory_file_shm_detach_locked(memFile);
+	sqlite3_mutex_leave(memFile->vfs->mutex);
+	
+	return SQLITE_OK;
+}
+
+static const sqlite3_io_methods yap_memory_io_methods = {
+	2,                                      // iVersion (shared memory, but no memory mapped I/O)
+	yap_memory_file_close,
+	yap_memory_file_read,
+	yap_memory_file_write,
+	yap_memory_file_truncate,
+	yap_memory_file_sync,
+	yap_memory_file_fileSize,
+	yap_memory_file_lock,
+	yap_memory_file_unlock,
+	yap_memory_file_checkReservedLock,
+	yap_memory_file_fileControl,
+	yap_memory_file_sectorSize,
+	yap_memory_file_deviceCharacteristics,
+	yap_memory_file_shmMap,
+	yap_memory_file_shmLock,
+	yap_memory_file_shmBarrier,
+	yap_memory_file_shmUnmap,
+	NULL,                                   // xFetch
+	NULL                                    // xUnfetch
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark sqlite3_vfs methods
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int yap_vfs_memory_open(sqlite3_vfs *vfs, const char *zName, sqlite3_file *file, int flags, int *pOutFlags)
+{
+	yap_vfs_memory *memVFS = (yap_vfs_memory *)vfs;
+	yap_memory_file *memFile = (yap_memory_file *)file;
+	
+	// From the SQLite docs:
+	//
+	// > If the xOpen method sets the sqlite3_file.pMethods element to a non-NULL value,
+	// > then the xClose method will be invoked even if the xOpen reported that it failed.
+	
+	memset(memFile, 0, sizeof(yap_memory_file));
+	
+	int result = SQLITE_OK;
+	sqlite3_mutex_enter(memVFS->mutex);
+	
+	yap_memory_node *node = zName ? yap_vfs_memory_find(memVFS, zName) : NULL;
+	if (node == NULL)
+	{
+		if (zName && !(flags & SQLITE_OPEN_CREATE))
+		{
+			result = SQLITE_CANTOPEN;
+			goto done;
+		}
+		
+		node = yap_memory_node_alloc(zName);
+		if (node == NULL)
+		{
+			result = SQLITE_NOMEM;
+			goto done;
+		}
+		
+		if (zName)
+		{
+			node->next = memVFS->nodes;
+			memVFS->nodes = node;
+		}
+		else
+		{
+			// Temp files are anonymous, and are freed when closed.
+			node->deleted = true;
+		}
+	}
+	
+	if ((flags & SQLITE_OPEN_DELETEONCLOSE) && !node->deleted)
+	{
+		yap_vfs_memory_unlink(memVFS, node);
+		node->deleted = true;
+	}
+	
+	node->openCount++;
+	
+	memFile->base.pMethods = &yap_memory_io_methods;
+	memFile->vfs = memVFS;
+	memFile->node = node;
+	memFile->lock = SQLITE_LOCK_NONE;
+	
+	if (pOutFlags) {
+		*pOutFlags = flags;
+	}
+
+done:
+	
+	sqlite3_mutex_leave(memVFS->mutex);
+	return result;
+}
+
+static int yap_vfs_memory_delete(sqlite3_vfs *vfs, const char *zName, int syncDir)
+{
+	yap_vfs_memory *memVFS = (yap_vfs_memory *)vfs;
+	yap_memory_node *nodeToFree = NULL;
+	
+	sqlite3_mutex_enter(memVFS->mutex);
+	
+	yap_memory_node *node = yap_vfs_memory_find(memVFS, zName);
+	if (node)
+	{
+		yap_vfs_memory_unlink(memVFS, node);
+		
+		if (node->openCount == 0)
+			nodeToFree = node;
+		else
+			node->deleted = true;
+	}
+	
+	sqlite3_mutex_leave(memVFS->mutex);
+	
+	if (nodeToFree) {
+		yap_memory_node_free(nodeToFree);
+	}
+	
+	return SQLITE_OK;
+}
+
+static int yap_vfs_memory_access(sqlite3_vfs *vfs, const char *zName, int flags, int *pResOut)
+{
+	yap_vfs_memory *memVFS = (yap_vfs_memory *)vfs;
+	
+	sqlite3_mutex_enter(memVFS->mutex);
+	*pResOut = (yap_vfs_memory_find(memVFS, zName) != NULL) ? 1 : 0;
+	sqlite3_mutex_leave(memVFS->mutex);
+	
+	return SQLITE_OK;
+}
+
+static int yap_vfs_memory_fullPathname(sqlite3_vfs *vfs, const char *zName, int nOut, char *zOut)
+{
+	// Names are used as-is
+	
+	sqlite3_snprintf(nOut, zOut, "%s", zName);
+	return SQLITE_OK;
+}
+
+static void* yap_vfs_memory_dlOpen(sqlite3_vfs *vfs, const char *zFilename)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	return defaultVFS->xDlOpen(defaultVFS, zFilename);
+}
+
+static void yap_vfs_memory_dlError(sqlite3_vfs *vfs, int nByte, char *zErrMsg)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	defaultVFS->xDlError(defaultVFS, nByte, zErrMsg);
+}
+
+static void (*yap_vfs_memory_dlSym(sqlite3_vfs *vfs, void *ptr, const char *zSym))(void)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	return defaultVFS->xDlSym(defaultVFS, ptr, zSym);
+}
+
+static void yap_vfs_memory_dlClose(sqlite3_vfs *vfs, void *ptr)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	defaultVFS->xDlClose(defaultVFS, ptr);
+}
+
+static int yap_vfs_memory_randomness(sqlite3_vfs *vfs, int nByte, char *zOut)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	return defaultVFS->xRandomness(defaultVFS, nByte, zOut);
+}
+
+static int yap_vfs_memory_sleep(sqlite3_vfs *vfs, int microseconds)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	return defaultVFS->xSleep(defaultVFS, microseconds);
+}
+
+static int yap_vfs_memory_currentTime(sqlite3_vfs *vfs, double *pTimeOut)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	return defaultVFS->xCurrentTime(defaultVFS, pTimeOut);
+}
+
+static int yap_vfs_memory_getLastError(sqlite3_vfs *vfs, int iErr, char *zErr)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	return defaultVFS->xGetLastError(defaultVFS, iErr, zErr);
+}
+
+static int yap_vfs_memory_currentTimeInt64(sqlite3_vfs *vfs, sqlite3_int64 *pTimeOut)
+{
+	sqlite3_vfs *defaultVFS = ((yap_vfs_memory *)vfs)->pDefault;
+	
+	return defaultVFS->xCurrentTimeInt64(defaultVFS, pTimeOut);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark yap_vfs_memory
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoke this method to register a yap_vfs_memory with the sqlite system.
+ *
+ * @param vfs_name
+ *   The name to use when registering the VFS with sqlite.
+ *
+ * @param vfs_out
+ *   The allocated vfs instance.
+ *   You are responsible for holding onto this pointer,
+ *   and properly unregistering the VFS when you're done using it.
+ *
+ * @return
+ *   SQLITE_OK if everything went right.
+ *   Some other SQLITE error if something went wrong.
+**/
+int yap_vfs_memory_register(const char *vfs_name, yap_vfs_memory **vfs_out)
+{
+	int result = SQLITE_OK;
+	yap_vfs_memory *memVFS = NULL;
+	
+	if (vfs_name == NULL)
+	{
+		// vfs_name is required
+		result = SQLITE_MISUSE;
+		goto done;
+	}
+	
+	sqlite3_vfs *defaultVFS = sqlite3_vfs_find(NULL);
+	if (defaultVFS == NULL)
+	{
+		result = SQLITE_NOTFOUND;
+		goto done;
+	}
+	
+	size_t baseLen = sizeof(yap_vfs_memory);
+	size_t nameLen = strlen(vfs_name) + 1;
+	
+	memVFS = sqlite3_malloc((int)(baseLen + nameLen));
+	if (memVFS == NULL)
+	{
+		result = SQLITE_NOMEM;
+		goto done;
+	}
+	memset(memVFS, 0, (int)(baseLen + nameLen));
+	
+	// memVFS memory = {struct yap_vfs_memory, char[nameLen]}
+	
+	char *name = (char *)&memVFS[1];
+	strncpy(name, vfs_name, nameLen);
+	
+	memVFS->base.iVersion   = 2;
+	memVFS->base.szOsFile   = sizeof(yap_memory_file);
+	memVFS->base.mxPathname = 1024;
+	memVFS->base.zName      = name;
+	
+	memVFS->base.xOpen             = yap_vfs_memory_open;
+	memVFS->base.xDelete           = yap_vfs_memory_delete;
+	memVFS->base.xAccess           = yap_vfs_memory_access;
+	memVFS->base.xFullPathname     = yap_vfs_memory_fullPathname;
+	memVFS->base.xDlOpen           = defaultVFS->xDlOpen  ? yap_vfs_memory_dlOpen  : NULL;
+	memVFS->base.xDlError          = defaultVFS->xDlError ? yap_vfs_memory_dlError : NULL;
+	memVFS->base.xDlSym            = defaultVFS->xDlSym   ? yap_vfs_memory_dlSym   : NULL;
+	memVFS->base.xDlClose          = defaultVFS->xDlClose ? yap_vfs_memory_dlClose : NULL;
+	memVFS->base.xRandomness       = yap_vfs_memory_randomness;
+	memVFS->base.xSleep            = yap_vfs_memory_sleep;
+	memVFS->base.xCurrentTime      = yap_vfs_memory_currentTime;
+	memVFS->base.xGetLastError     = defaultVFS->xGetLastError ? yap_vfs_memory_getLastError : NULL;
+	memVFS->base.xCurrentTimeInt64 = (defaultVFS->iVersion >= 2 && defaultVFS->xCurrentTimeInt64)
+	                               ? yap_vfs_memory_currentTimeInt64
+	                               : NULL;
+	
+	memVFS->pDefault = defaultVFS;
+	memVFS->mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+	
+	int makeDefault = 0; // NO
+	result = sqlite3_vfs_register((sqlite3_vfs *)memVFS, makeDefault);
+
+done:
+	
+	if (result != SQLITE_OK)
+	{
+		if (memVFS)
+		{
+			if (memVFS->mutex) {
+				sqlite3_mutex_free(memVFS->mutex);
+			}
+			sqlite3_free(memVFS);
+			memVFS = NULL;
+		}
+	}
+	
+	*vfs_out = memVFS;
+	return result;
+}
+
+/**
+ * Invoke this method to unregister the yap_vfs_memory with the sqlite system.
+ * Be sure you don't do this until every sqlite3 instance that uses it has been closed.
+ *
+ * @param vfs_in_out
+ *   The previous output from yap_vfs_memory_register.
+ *   This memory will be freed within this method, and the pointer will be set to NULL.
+ *
+ * @return
+ *   SQLITE_OK if everything went right.
+ *   Some other SQLITE error if something went wrong.
+**/
+int yap_vfs_memory_unregister(yap_vfs_memory **vfs_in_out)
+{
+	if (vfs_in_out == NULL) {
+		return SQLITE_MISUSE;
+	}
+	
+	yap_vfs_memory *memVFS = *vfs_in_out;
+	
+	if (memVFS == NULL) {
+		return SQLITE_MISUSE;
+	}
+	
+	int result = sqlite3_vfs_unregister((sqlite3_vfs *)memVFS);
+	
+	yap_memory_node *node = memVFS->nodes;
+	while (node)
+	{
+		yap_memory_node *next = node->next;
+		yap_memory_node_free(node);
+		
+		node = next;
+	}
+	memVFS->nodes = NULL;
+	
+	if (memVFS->mutex) {
+		sqlite3_mutex_free(memVFS->mutex);
+		memVFS->mutex = NULL;
+	}
+	
+	sqlite3_free(memVFS);
+	*vfs_in_out = NULL;
+	
+	return result;
+}
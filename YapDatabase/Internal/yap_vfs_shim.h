@@ -7,12 +7,56 @@ extern "C" {
 	
 #include "sqlite3.h"
 #include "stdbool.h"
+#include "stdint.h"
 
 struct yap_vfs;
 struct yap_file;
+struct yap_io_stats;
+struct yap_page_tracker;
 
 typedef struct yap_vfs yap_vfs;
 typedef struct yap_file yap_file;
+typedef struct yap_io_stats yap_io_stats;
+typedef struct yap_page_tracker yap_page_tracker;
+
+/**
+ * The kind of file, as determined by the flags passed to xOpen.
+ * I/O statistics are aggregated per kind (across every connection using the shim).
+**/
+typedef enum {
+	yap_file_kind_main = 0, // SQLITE_OPEN_MAIN_DB
+	yap_file_kind_wal,      // SQLITE_OPEN_WAL
+	yap_file_kind_journal,  // SQLITE_OPEN_MAIN_JOURNAL
+	yap_file_kind_other,    // Temp databases, sub-journals, etc
+	yap_file_kind_count
+} yap_file_kind;
+
+typedef enum {
+	yap_io_op_read = 0,
+	yap_io_op_write,
+	yap_io_op_sync,
+	yap_io_op_truncate,
+	yap_io_op_count
+} yap_io_op;
+
+/**
+ * Latency histograms use power-of-two buckets (in microseconds).
+ * Bucket 0 holds everything under 2 microseconds.
+ * Bucket N holds [2^N, 2^(N+1)) microseconds.
+ * The last bucket also holds everything above it.
+**/
+#define YAP_IO_LATENCY_BUCKET_COUNT 24
+
+typedef struct {
+	uint64_t count;        // number of calls (i.e. syscalls issued by the underlying vfs)
+	uint64_t bytes;        // bytes transferred (read & write only)
+	uint64_t nanoseconds;  // total time spent within the underlying vfs
+	uint64_t latency[YAP_IO_LATENCY_BUCKET_COUNT];
+} yap_io_op_stats;
+
+typedef struct {
+	yap_io_op_stats ops[yap_io_op_count];
+} yap_io_file_stats;
 	
 /**
  * From the SQLite Docs:
@@ -35,6 +79,10 @@ struct yap_vfs {
 	
 	sqlite3_mutex *last_opened_wal_mutex;
 	yap_file *last_opened_wal;
+	
+	yap_io_stats *io_stats;   // NULL unless enabled via yap_vfs_enable_io_stats()
+	
+	yap_page_tracker *page_tracker; // NULL unless enabled via yap_vfs_enable_page_tracking()
 };
 
 struct yap_file {
@@ -46,6 +94,7 @@ struct yap_file {
 	
 	const char *filename;
 	bool isWAL;
+	yap_file_kind kind;
 	
 	void *yap_database_connection;
 	void (*xNotifyDidRead)(yap_file*);
@@ -105,6 +154,70 @@ int yap_vfs_shim_unregister(yap_vfs **vfs_in_out);
 **/
 yap_file* yap_vfs_last_opened_wal(yap_vfs *vfs);
 
+/**
+ * Enables I/O statistics for every file opened through the shim.
+ * When enabled, every read, write, sync & truncate is counted & timed (per yap_file_kind).
+ * 
+ * This must be invoked before the shim is used to open any files,
+ * and the statistics can't be disabled afterwards.
+ * 
+ * @return
+ *   SQLITE_OK if everything went right.
+ *   Some other SQLITE error if something went wrong.
+**/
+int yap_vfs_enable_io_stats(yap_vfs *vfs);
+
+/**
+ * Copies the current I/O statistics into the given array (indexed by yap_file_kind).
+ * 
+ * Each counter is read atomically, but the counters aren't read atomically as a group.
+ * So if I/O is happening concurrently, the result may be very slightly inconsistent.
+ * 
+ * @return
+ *   true if I/O statistics are enabled (and stats_out was filled in), false otherwise.
+**/
+bool yap_vfs_get_io_stats(yap_vfs *vfs, yap_io_file_stats stats_out[yap_file_kind_count]);
+
+/**
+ * Resets every I/O counter to zero.
+**/
+void yap_vfs_reset_io_stats(yap_vfs *vfs);
+
+/**
+ * Enables page tracking for every file opened through the shim.
+ * When enabled, the page number of every frame written to a WAL is recorded (in a bitmap).
+ * 
+ * Since every change to the database goes through the WAL,
+ * the recorded pages are a superset of the pages that have changed.
+ * (Frames of transactions that were rolled back are recorded too.)
+ * 
+ * This must be invoked before the shim is used to open any files,
+ * and page tracking can't be disabled afterwards.
+ * 
+ * @return
+ *   SQLITE_OK if everything went right.
+ *   Some other SQLITE error if something went wrong.
+**/
+int yap_vfs_enable_page_tracking(yap_vfs *vfs);
+
+/**
+ * Hands over the bitmap of pages that have been recorded since the previous invocation,
+ * and starts recording into a new (empty) bitmap.
+ * 
+ * Bit (pgno - 1) is set for each recorded page.
+ * The bitmap must be freed with sqlite3_free(). It may be NULL if no pages were recorded.
+ * 
+ * @param bitmap_out
+ *   The recorded pages.
+ * 
+ * @param page_capacity_out
+ *   The number of pages covered by the bitmap (i.e. the number of bits).
+ * 
+ * @return
+ *   true if page tracking is enabled (and the output parameters were filled in), false otherwise.
+**/
+bool yap_vfs_take_dirty_pages(yap_vfs *vfs, uint8_t **bitmap_out, uint32_t *page_capacity_out);
+
 #if defined __cplusplus
 };
 #endif
@@ -1,12 +1,136 @@
 #include "yap_vfs_shim.h"
+#include "YapDatabaseSignposts.h"
 
 #include <stdio.h>
 #include <stddef.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
 
 static void yap_vfs_set_last_opened_wal(yap_vfs *yapVFS, yap_file *yapFile);
 static void yap_vfs_unset_last_opened_wal(yap_vfs *yapVFS, yap_file *yapFile);
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark I/O Statistics
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+	_Atomic uint64_t count;
+	_Atomic uint64_t bytes;
+	_Atomic uint64_t nanoseconds;
+	_Atomic uint64_t latency[YAP_IO_LATENCY_BUCKET_COUNT];
+} yap_io_op_atomic_stats;
+
+struct yap_io_stats {
+	uint32_t timebase_numer;
+	uint32_t timebase_denom;
+	
+	yap_io_op_atomic_stats ops[yap_file_kind_count][yap_io_op_count];
+};
+
+/**
+ * Returns the start time for an I/O operation, or zero if I/O statistics aren't enabled.
+**/
+static inline uint64_t yap_io_stats_start(yap_file *yapFile)
+{
+	return (yapFile->vfs && yapFile->vfs->io_stats) ? mach_absolute_time() : 0;
+}
+
+static void yap_io_stats_record(yap_file *yapFile, yap_io_op op, uint64_t bytes, uint64_t startTime)
+{
+	yap_io_stats *stats = yapFile->vfs ? yapFile->vfs->io_stats : NULL;
+	if (stats == NULL || startTime == 0) return;
+	
+	uint64_t elapsed = mach_absolute_time() - startTime;
+	uint64_t nanoseconds = elapsed * stats->timebase_numer / stats->timebase_denom;
+	uint64_t microseconds = nanoseconds / 1000;
+	
+	int bucket = (microseconds > 0) ? (63 - __builtin_clzll(microseconds)) : 0;
+	if (bucket >= YAP_IO_LATENCY_BUCKET_COUNT) {
+		bucket = YAP_IO_LATENCY_BUCKET_COUNT - 1;
+	}
+	
+	// Relaxed ordering is fine here: the counters are independent, and only need to be eventually visible.
+	
+	yap_io_op_atomic_stats *opStats = &stats->ops[yapFile->kind][op];
+	
+	atomic_fetch_add_explicit(&opStats->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&opStats->nanoseconds, nanoseconds, memory_order_relaxed);
+	atomic_fetch_add_explicit(&opStats->latency[bucket], 1, memory_order_relaxed);
+	
+	if (bytes > 0) {
+		atomic_fetch_add_explicit(&opStats->bytes, bytes, memory_order_relaxed);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Page Tracking
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct yap_page_tracker {
+	sqlite3_mutex *mutex;
+	
+	uint8_t *bitmap;   // Must hold mutex
+	uint32_t capacity; // Must hold mutex (in pages, always a multiple of 8)
+};
+
+static void yap_page_tracker_record(yap_page_tracker *tracker, uint32_t pgno)
+{
+	if (pgno == 0) return;
+	uint32_t index = pgno - 1;
+	
+	sqlite3_mutex_enter(tracker->mutex);
+	{
+		if (index >= tracker->capacity)
+		{
+			uint32_t newCapacity = (tracker->capacity > 0) ? tracker->capacity : (1024 * 8);
+			while (index >= newCapacity) {
+				newCapacity *= 2;
+			}
+			
+			uint8_t *newBitmap = sqlite3_realloc(tracker->bitmap, (int)(newCapacity / 8));
+			if (newBitmap)
+			{
+				memset(newBitmap + (tracker->capacity / 8), 0, (newCapacity - tracker->capacity) / 8);
+				
+				tracker->bitmap = newBitmap;
+				tracker->capacity = newCapacity;
+			}
+		}
+		
+		if (index < tracker->capacity) {
+			tracker->bitmap[index / 8] |= (uint8_t)(1 << (index % 8));
+		}
+	}
+	sqlite3_mutex_leave(tracker->mutex);
+}
+
+/**
+ * From the WAL file format (https://www.sqlite.org/fileformat2.html#walformat):
+ * 
+ * > A WAL file consists of a header followed by zero or more "frames".
+ * > The header is 32 bytes. Each frame consists of a 24-byte frame-header followed by a page-size bytes of page data.
+ * > The first 4 bytes of the frame-header are the page number (big-endian).
+ * 
+ * SQLite writes the frame-header & the page data separately,
+ * so every 24-byte write (past the WAL header) is a frame-header.
+**/
+static void yap_page_tracker_did_write_wal(yap_file *yapFile, const void *zBuf, int iAmt, sqlite3_int64 iOfst)
+{
+	yap_page_tracker *tracker = yapFile->vfs ? yapFile->vfs->page_tracker : NULL;
+	if (tracker == NULL) return;
+	
+	if (iAmt != 24 || iOfst < 32) return;
+	
+	const uint8_t *frameHeader = (const uint8_t *)zBuf;
+	uint32_t pgno = ((uint32_t)frameHeader[0] << 24) |
+	                ((uint32_t)frameHeader[1] << 16) |
+	                ((uint32_t)frameHeader[2] <<  8) |
+	                ((uint32_t)frameHeader[3]);
+	
+	yap_page_tracker_record(tracker, pgno);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark sqlite3_io_methods
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -37,8 +161,16 @@ static int yap_file_read(sqlite3_file *file, void *zBuf, int iAmt, sqlite3_int64
 	yap_file *yapFile = (yap_file *)file;
 	const sqlite3_file *realFile = yapFile->pReal;
 	
+	uint64_t startTime = yap_io_stats_start(yapFile);
+	
 	int result = realFile->pMethods->xRead((sqlite3_file *)realFile, zBuf, iAmt, iOfst);
 	
+	if (startTime)
+	{
+		uint64_t bytes = (result == SQLITE_OK) ? (uint64_t)iAmt : 0;
+		yap_io_stats_record(yapFile, yap_io_op_read, bytes, startTime);
+	}
+	
 	if (yapFile->xNotifyDidRead && (result == SQLITE_OK))
 	{
 		yapFile->xNotifyDidRead(yapFile);
@@ -52,7 +184,22 @@ static int yap_file_write(sqlite3_file *file, const void *zBuf, int iAmt, sqlite
 	yap_file *yapFile = (yap_file *)file;
 	const sqlite3_file *realFile = yapFile->pReal;
 	
-	return realFile->pMethods->xWrite((sqlite3_file *)realFile, zBuf, iAmt, iOfst);
+	uint64_t startTime = yap_io_stats_start(yapFile);
+	
+	int result = realFile->pMethods->xWrite((sqlite3_file *)realFile, zBuf, iAmt, iOfst);
+	
+	if (startTime)
+	{
+		uint64_t bytes = (result == SQLITE_OK) ? (uint64_t)iAmt : 0;
+		yap_io_stats_record(yapFile, yap_io_op_write, bytes, startTime);
+	}
+	
+	if (yapFile->isWAL && (result == SQLITE_OK))
+	{
+		yap_page_tracker_did_write_wal(yapFile, zBuf, iAmt, iOfst);
+	}
+	
+	return result;
 }
 
 static int yap_file_truncate(sqlite3_file *file, sqlite3_int64 size)
@@ -60,7 +207,15 @@ static int yap_file_truncate(sqlite3_file *file, sqlite3_int64 size)
 	yap_file *yapFile = (yap_file *)file;
 	const sqlite3_file *realFile = yapFile->pReal;
 	
-	return realFile->pMethods->xTruncate((sqlite3_file *)realFile, size);
+	uint64_t startTime = yap_io_stats_start(yapFile);
+	
+	int result = realFile->pMethods->xTruncate((sqlite3_file *)realFile, size);
+	
+	if (startTime) {
+		yap_io_stats_record(yapFile, yap_io_op_truncate, 0, startTime);
+	}
+	
+	return result;
 }
 
 static int yap_file_sync(sqlite3_file *file, int flags)
@@ -68,7 +223,18 @@ static int yap_file_sync(sqlite3_file *file, int flags)
 	yap_file *yapFile = (yap_file *)file;
 	const sqlite3_file *realFile = yapFile->pReal;
 	
-	return realFile->pMethods->xSync((sqlite3_file *)realFile, flags);
+	uint64_t startTime = yap_io_stats_start(yapFile);
+	YDBSignpostID signpost = YDBSignpostBegin("Sync", "flags: %d", flags);
+	
+	int result = realFile->pMethods->xSync((sqlite3_file *)realFile, flags);
+	
+	YDBSignpostEnd(signpost, "Sync");
+	
+	if (startTime) {
+		yap_io_stats_record(yapFile, yap_io_op_sync, 0, startTime);
+	}
+	
+	return result;
 }
 
 static int yap_file_fileSize(sqlite3_file *file, sqlite3_int64 *pSize)
@@ -207,6 +373,15 @@ static int yap_vfs_open(sqlite3_vfs *vfs, const char *zName, sqlite3_file *file,
 	yapFile->filename = zName;
 	yapFile->isWAL = (flags & SQLITE_OPEN_WAL) ? true : false;
 	
+	if (flags & SQLITE_OPEN_MAIN_DB)
+		yapFile->kind = yap_file_kind_main;
+	else if (flags & SQLITE_OPEN_WAL)
+		yapFile->kind = yap_file_kind_wal;
+	else if (flags & SQLITE_OPEN_MAIN_JOURNAL)
+		yapFile->kind = yap_file_kind_journal;
+	else
+		yapFile->kind = yap_file_kind_other;
+	
 	// yapFile memory = {struct yap_file, byte[realVFS->szOsFile]}
 	
 	sqlite3_file *realFile = (sqlite3_file *)&yapFile[1];
@@ -432,6 +607,155 @@ yap_file* yap_vfs_last_opened_wal(yap_vfs *yapVFS)
 	return last_opened_wal;
 }
 
+/**
+ * Enables I/O statistics for every file opened through the shim.
+ * When enabled, every read, write, sync & truncate is counted & timed (per yap_file_kind).
+ *
+ * This must be invoked before the shim is used to open any files,
+ * and the statistics can't be disabled afterwards.
+**/
+int yap_vfs_enable_io_stats(yap_vfs *yapVFS)
+{
+	if (yapVFS == NULL) return SQLITE_MISUSE;
+	if (yapVFS->io_stats) return SQLITE_OK;
+	
+	yap_io_stats *stats = sqlite3_malloc((int)sizeof(yap_io_stats));
+	if (stats == NULL) {
+		return SQLITE_NOMEM;
+	}
+	memset(stats, 0, sizeof(yap_io_stats));
+	
+	mach_timebase_info_data_t timebase;
+	if (mach_timebase_info(&timebase) != KERN_SUCCESS || timebase.denom == 0)
+	{
+		timebase.numer = 1;
+		timebase.denom = 1;
+	}
+	
+	stats->timebase_numer = timebase.numer;
+	stats->timebase_denom = timebase.denom;
+	
+	yapVFS->io_stats = stats;
+	return SQLITE_OK;
+}
+
+/**
+ * Copies the current I/O statistics into the given array (indexed by yap_file_kind).
+ *
+ * Each counter is read atomically, but the counters aren't read atomically as a group.
+ * So if I/O is happening concurrently, the result may be very slightly inconsistent.
+**/
+bool yap_vfs_get_io_stats(yap_vfs *yapVFS, yap_io_file_stats stats_out[yap_file_kind_count])
+{
+	yap_io_stats *stats = yapVFS ? yapVFS->io_stats : NULL;
+	if (stats == NULL) return false;
+	
+	for (int kind = 0; kind < yap_file_kind_count; kind++)
+	{
+		for (int op = 0; op < yap_io_op_count; op++)
+		{
+			yap_io_op_atomic_stats *src = &stats->ops[kind][op];
+			yap_io_op_stats *dst = &stats_out[kind].ops[op];
+			
+			dst->count       = atomic_load_explicit(&src->count,       memory_order_relaxed);
+			dst->bytes       = atomic_load_explicit(&src->bytes,       memory_order_relaxed);
+			dst->nanoseconds = atomic_load_explicit(&src->nanoseconds, memory_order_relaxed);
+			
+			for (int bucket = 0; bucket < YAP_IO_LATENCY_BUCKET_COUNT; bucket++)
+			{
+				dst->latency[bucket] = atomic_load_explicit(&src->latency[bucket], memory_order_relaxed);
+			}
+		}
+	}
+	
+	return true;
+}
+
+/**
+ * Resets every I/O counter to zero.
+**/
+void yap_vfs_reset_io_stats(yap_vfs *yapVFS)
+{
+	yap_io_stats *stats = yapVFS ? yapVFS->io_stats : NULL;
+	if (stats == NULL) return;
+	
+	for (int kind = 0; kind < yap_file_kind_count; kind++)
+	{
+		for (int op = 0; op < yap_io_op_count; op++)
+		{
+			yap_io_op_atomic_stats *opStats = &stats->ops[kind][op];
+			
+			atomic_store_explicit(&opStats->count,       0, memory_order_relaxed);
+			atomic_store_explicit(&opStats->bytes,       0, memory_order_relaxed);
+			atomic_store_explicit(&opStats->nanoseconds, 0, memory_order_relaxed);
+			
+			for (int bucket = 0; bucket < YAP_IO_LATENCY_BUCKET_COUNT; bucket++)
+			{
+				atomic_store_explicit(&opStats->latency[bucket], 0, memory_order_relaxed);
+			}
+		}
+	}
+}
+
+/**
+ * Enables page tracking for every file opened through the shim.
+ * When enabled, the page number of every frame written to a WAL is recorded (in a bitmap).
+ *
+ * This must be invoked before the shim is used to open any files,
+ * and page tracking can't be disabled afterwards.
+**/
+int yap_vfs_enable_page_tracking(yap_vfs *yapVFS)
+{
+	if (yapVFS == NULL) return SQLITE_MISUSE;
+	if (yapVFS->page_tracker) return SQLITE_OK;
+	
+	yap_page_tracker *tracker = sqlite3_malloc((int)sizeof(yap_page_tracker));
+	if (tracker == NULL) {
+		return SQLITE_NOMEM;
+	}
+	memset(tracker, 0, sizeof(yap_page_tracker));
+	
+	tracker->mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+	if (tracker->mutex == NULL)
+	{
+		sqlite3_free(tracker);
+		return SQLITE_NOMEM;
+	}
+	
+	yapVFS->page_tracker = tracker;
+	return SQLITE_OK;
+}
+
+/**
+ * Hands over the bitmap of pages that have been recorded since the previous invocation,
+ * and starts recording into a new (empty) bitmap.
+**/
+bool yap_vfs_take_dirty_pages(yap_vfs *yapVFS, uint8_t **bitmap_out, uint32_t *page_capacity_out)
+{
+	yap_page_tracker *tracker = yapVFS ? yapVFS->page_tracker : NULL;
+	if (tracker == NULL) return false;
+	
+	sqlite3_mutex_enter(tracker->mutex);
+	{
+		if (bitmap_out) {
+			*bitmap_out = tracker->bitmap;
+		}
+		else {
+			sqlite3_free(tracker->bitmap);
+		}
+		
+		if (page_capacity_out) {
+			*page_capacity_out = tracker->capacity;
+		}
+		
+		tracker->bitmap = NULL;
+		tracker->capacity = 0;
+	}
+	sqlite3_mutex_leave(tracker->mutex);
+	
+	return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark sqlite3_vfs_shim
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -575,6 +899,18 @@ int yap_vfs_shim_unregister(yap_vfs **vfs_in_out)
 	
 	int result = sqlite3_vfs_unregister((sqlite3_vfs *)yapVFS);
 	
+	if (yapVFS->io_stats) {
+		sqlite3_free(yapVFS->io_stats);
+		yapVFS->io_stats = NULL;
+	}
+	
+	if (yapVFS->page_tracker) {
+		sqlite3_mutex_free(yapVFS->page_tracker->mutex);
+		sqlite3_free(yapVFS->page_tracker->bitmap);
+		sqlite3_free(yapVFS->page_tracker);
+		yapVFS->page_tracker = NULL;
+	}
+	
 	sqlite3_free(yapVFS);
 	*vfs_in_out = NULL;
 	
@@ -140,6 +140,14 @@ extern const YapBidirectionalCacheCallBacks kYapBidirectionalCacheDefaultCallBac
 - (void)enumerateObjectsWithBlock:(void (^)(ObjectType object, BOOL *stop))block;
 - (void)enumerateKeysAndObjectsWithBlock:(void (^)(KeyType key, ObjectType obj, BOOL *stop))block;
 
+/**
+ * Returns the estimated memory footprint of the cache (in bytes).
+ * This includes the internal dictionaries & cache items, as well as the keys & objects retained by the cache.
+ *
+ * This method enumerates the cache, so it's O(count).
+**/
+- (uint64_t)estimatedMemoryUsage;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -1,5 +1,8 @@
 #import "YapBidirectionalCache.h"
 #import "YapDatabaseLogging.h"
+#import "YapDatabaseMemoryReportPrivate.h"
+
+#import <malloc/malloc.h>
 
 static NSUInteger const YapBidirectionalCache_Default_CountLimit = 40;
 
@@ -662,6 +665,28 @@ const YapBidirectionalCacheCallBacks kYapBidirectionalCacheDefaultCallBacks = (Y
 	}];
 }
 
+- (uint64_t)estimatedMemoryUsage
+{
+	// Each dictionary entry is estimated as a hash slot (key & value pointers).
+	CFIndex count = CFDictionaryGetCount(key_obj_dict);
+	
+	__block uint64_t size = (uint64_t)malloc_size((__bridge const void *)self);
+	size += (uint64_t)count * 2 * (2 * sizeof(void *));
+	
+	NSDictionary *nsdict = (__bridge NSDictionary *)key_obj_dict;
+	
+	[nsdict enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
+		
+		__unsafe_unretained YapBidirectionalCacheItem *cacheItem = (YapBidirectionalCacheItem *)obj;
+		
+		size += YapDatabaseEstimatedObjectSize(cacheItem);
+		size += YapDatabaseEstimatedObjectSize(key);
+		size += YapDatabaseEstimatedObjectSize(cacheItem->obj);
+	}];
+	
+	return size;
+}
+
 #ifndef NS_BLOCK_ASSERTIONS
 static void AssertAllowedKeyClass(id key, NSSet *allowedKeyClasses)
 {
@@ -6,6 +6,63 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * Objects stored in a YapCache may optionally implement this protocol, in order to report their cost.
+ * See YapCache.costLimit.
+**/
+@protocol YapCacheCost <NSObject>
+
+/**
+ * The cost of the object (in whatever unit the costLimit uses, typically bytes).
+**/
+- (NSUInteger)yapCacheCost;
+
+@end
+
+/**
+ * The admission policy decides whether a new item is allowed into a full cache.
+ * (Eviction order is always least recently used.)
+**/
+typedef NS_ENUM(NSInteger, YapCacheAdmissionPolicy) {
+	
+	/**
+	 * Every new item is admitted, and the least recently used item is evicted to make room for it.
+	 * This is the classic LRU cache, and is the default.
+	**/
+	YapCacheAdmissionPolicyLRU = 0,
+	
+	/**
+	 * TinyLFU:
+	 * The cache keeps an approximate (and periodically aged) access frequency for recently seen keys,
+	 * including keys that are no longer in the cache, using a compact count-min sketch.
+	 * 
+	 * When the cache is full, a new item is only admitted if it has been accessed more frequently
+	 * than the item that would be evicted to make room for it. Otherwise the new item is dropped.
+	 * 
+	 * This makes the cache scan-resistant.
+	 * For example, a one-time enumeration of a large collection no longer flushes the hot working set,
+	 * as the items being scanned are only seen once.
+	**/
+	YapCacheAdmissionPolicyTinyLFU = 1,
+};
+
+/**
+ * Optional lookup counters. See YapCache.lookupCounters.
+**/
+typedef struct {
+	NSUInteger hits;
+	NSUInteger misses;
+} YapCacheLookupCounters;
+
+/**
+ * Lifetime statistics. See YapCache.lifetimeStatistics.
+**/
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+} YapCacheLifetimeStatistics;
+
 /**
  * YapCache implements a simple strict cache.
  *
@@ -22,6 +79,10 @@ NS_ASSUME_NONNULL_BEGIN
  * and the least recently accessed key is at the back.
  * So it's very quick and efficient to evict items based on recent usage.
  *
+ * Internally, the items (along with the linked-list indexes) are stored in a flat table,
+ * which is indexed by an open-addressed hash table. Each item's hash is calculated once, and stored alongside it.
+ * Once the cache is warm, adding & evicting items doesn't allocate any memory.
+ *
  * YapCache is considerably faster than NSCache.
  * The project even comes with a benchmarking tool for comparing the speed of YapCache vs NSCache.
  * 
@@ -46,7 +107,8 @@ NS_ASSUME_NONNULL_BEGIN
 - (instancetype)initWithCountLimit:(NSUInteger)countLimit;
 
 /**
- * This init method allows you to define the keyCallbacks to be used by the internal CFDictionary.
+ * This init method allows you to define the keyCallbacks to be used by the internal hash table.
+ * (The retain, release, equal & hash callbacks are used. As with CFDictionary.)
  * This is useful for a number of reasons.
  * 
  * By default (if you use the other init methods), YapCache will use kCFTypeDictionaryKeyCallBacks.
@@ -85,6 +147,47 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, assign, readwrite) NSUInteger countLimit;
 
+/**
+ * The costLimit specifies the maximum total cost of the items in the cache.
+ * Like the countLimit, this limit is strictly enforced (least recently used items are evicted first).
+ * If both limits are set, then both are enforced.
+ * 
+ * The cost of each item is determined by:
+ * - the cost passed to setObject:forKey:cost:, or else
+ * - the costBlock (if set), or else
+ * - the object's yapCacheCost (if the object implements the YapCacheCost protocol), or else
+ * - zero
+ *
+ * An item whose cost exceeds the costLimit by itself is not retained by the cache.
+ *
+ * The default costLimit is zero, which means there is no cost limit.
+ * (And costs are only calculated if a costLimit or costBlock has been set.)
+ *
+ * You may change the costLimit at any time.
+ * Changes to the costLimit take immediate effect on the cache (before the set method returns).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger costLimit;
+
+/**
+ * The admission policy determines whether new items are admitted into a full cache.
+ * See YapCacheAdmissionPolicy for the details.
+ * 
+ * The default admissionPolicy is YapCacheAdmissionPolicyLRU.
+ *
+ * You may change the admissionPolicy at any time. (It doesn't affect items already in the cache.)
+**/
+@property (nonatomic, assign, readwrite) YapCacheAdmissionPolicy admissionPolicy;
+
+/**
+ * An optional block used to calculate the cost of items added via setObject:forKey:.
+**/
+@property (nonatomic, copy, readwrite, nullable) NSUInteger (^costBlock)(KeyType key, ObjectType object);
+
+/**
+ * The total cost of all items currently in the cache.
+**/
+@property (nonatomic, readonly) NSUInteger totalCost;
+
 /**
  * These methods are for "debugging".
  * 
@@ -106,6 +209,7 @@ NS_ASSUME_NONNULL_BEGIN
 //
 
 - (void)setObject:(ObjectType)object forKey:(KeyType)key;
+- (void)setObject:(ObjectType)object forKey:(KeyType)key cost:(NSUInteger)cost;
 
 - (nullable ObjectType)objectForKey:(KeyType)key;
 - (BOOL)containsKey:(KeyType)key;
@@ -119,6 +223,35 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)enumerateKeysWithBlock:(void (^)(KeyType key, BOOL *stop))block;
 - (void)enumerateKeysAndObjectsWithBlock:(void (^)(KeyType key, ObjectType obj, BOOL *stop))block;
 
+/**
+ * Returns the estimated memory footprint of the cache (in bytes).
+ * This includes the internal tables, as well as the keys & objects retained by the cache.
+ *
+ * This method enumerates the cache, so it's O(count).
+**/
+- (uint64_t)estimatedMemoryUsage;
+
+/**
+ * If set, every objectForKey: invocation increments either the hits or the misses of the given counters.
+ * 
+ * This is independent of the (compiled out) statistics below, and costs nothing when NULL.
+ * It allows the owner to attribute lookups to a particular unit of work (e.g. a single transaction),
+ * by pointing the cache at fresh counters before the work, and setting it back to NULL afterwards.
+ * 
+ * The counters aren't retained or copied. The pointer must remain valid until it's reset to NULL.
+**/
+@property (nonatomic, assign, readwrite, nullable) YapCacheLookupCounters *lookupCounters;
+
+/**
+ * The number of objectForKey: hits & misses, and the number of evictions, since the cache was created.
+ * 
+ * Unlike the (compiled out) debugging statistics below, these are always maintained (a single increment each).
+ * They're never reset (not even by removeAllObjects), so samples can be diffed to get rates.
+ * 
+ * YapCache isn't thread-safe, so this must be read from the same queue as the cache is used on.
+**/
+@property (nonatomic, readonly) YapCacheLifetimeStatistics lifetimeStatistics;
+
 //
 // Some debugging stuff that gets compiled out
 //
@@ -140,6 +273,18 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, readonly) NSUInteger evictionCount;
 
+/**
+ * The total cost of all the items that have been evicted
+ * (either due to the countLimit or the costLimit).
+**/
+@property (nonatomic, readonly) NSUInteger evictedCost;
+
+/**
+ * When using YapCacheAdmissionPolicyTinyLFU,
+ * the rejectionCount is incremented each time a new item isn't admitted into the (full) cache.
+**/
+@property (nonatomic, readonly) NSUInteger rejectionCount;
+
 #endif
 
 @end
@@ -1,5 +1,8 @@
 #import "YapCache.h"
 #import "YapDatabaseLogging.h"
+#import "YapDatabaseMemoryReportPrivate.h"
+
+#import <malloc/malloc.h>
 
 /**
  * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
@@ -16,51 +19,63 @@
 **/
 static const NSUInteger YapCache_Default_CountLimit = 40;
 
+/**
+ * TinyLFU frequency sketch configuration.
+ *
+ * The sketch is a count-min sketch with 4 rows of saturating 4-bit counters (stored in a byte each).
+ * Its width is the countLimit rounded up to a power of 2 (with a minimum),
+ * and all counters are halved after (width * 10) accesses, so old popularity fades over time.
+**/
+#define YAP_CACHE_SKETCH_DEPTH         4
+#define YAP_CACHE_SKETCH_MAX_COUNT     15
+#define YAP_CACHE_SKETCH_MIN_WIDTH     64
+#define YAP_CACHE_SKETCH_DEFAULT_WIDTH 1024
+#define YAP_CACHE_SKETCH_SAMPLE_FACTOR 10
 
-@interface YapCacheItem : NSObject {
-@public
-	
-	// Memory Management Architecture & Performance note:
-	//
-	// The prev & next pointers are updated regularly, so it's critical that they
-	// don't have the overhead of memory management (__strong).
-	// The end goal is to have the following retained once, and only once:
-	// - key
-	// - value
-	// - YapCacheItem
-	//
-	// To achieve this, the cfdict retains the key & YapCacheItem.
-	// And the YapCacheItem retains the value.
-	
-	__unsafe_unretained YapCacheItem *prev; // retained by cfdict as a value
-	__unsafe_unretained YapCacheItem *next; // retained by cfdict as a value
-
-	__unsafe_unretained id key; // retained by cfdict as key
-	__strong id value;          // retained only by us
-}
-
-- (id)initWithKey:(id)key value:(id)value;
-
-@end
-
-@implementation YapCacheItem
-
-- (id)initWithKey:(id <NSCopying>)aKey value:(id)aValue
+static inline uint64_t YapCacheSpreadHash(uint64_t hash)
 {
-	if ((self = [super init]))
-	{
-		key = aKey;
-		value = aValue;
-	}
-	return self;
+	// splitmix64 finalizer
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+	
+	return hash;
 }
 
-- (NSString *)description
-{
-	return [NSString stringWithFormat:@"<YapCacheItem[%p] key(%@)>", self, key];
-}
 
-@end
+/**
+ * The cache is stored in flat (contiguous) tables:
+ *
+ * - entries : Each entry holds the key, value, hash & cost.
+ *             Along with the prev & next indexes of the doubly linked-list, which is ordered by access.
+ *             Unused entries are kept in a free-list (linked via the next index).
+ *
+ * - buckets : An open-addressed hash table (linear probing) that maps keys to entries.
+ *             Each bucket holds (entryIndex + 1), or zero if the bucket is empty.
+ *             Removals use backward-shift deletion, so there are no tombstones.
+ *
+ * The tables grow (geometrically) until they can hold countLimit items, and are then reused.
+ * So a warm cache doesn't allocate memory. And a cache hit doesn't require any objc_msgSend or retain/release.
+ * (The key's equal callback is only invoked if the stored hash matches.)
+**/
+#define YAP_CACHE_NIL              UINT32_MAX
+#define YAP_CACHE_MIN_CAPACITY     16
+#define YAP_CACHE_MAX_PREALLOCATED 1024
+#define YAP_CACHE_MIN_BUCKETS      32
+
+typedef struct {
+	const void *key;   // retained via the keyCallbacks
+	const void *value; // retained via CFRetain
+	
+	uint64_t hash;     // YapCacheSpreadHash(keyCallbacks.hash(key))
+	NSUInteger cost;
+	
+	uint32_t prev;     // towards the mostRecent entry
+	uint32_t next;     // towards the leastRecent entry (or the next free entry)
+	
+} YapCacheEntry;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
@@ -68,22 +83,47 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 
 @implementation YapCache
 {
-	CFMutableDictionaryRef cfdict;
+	CFDictionaryKeyCallBacks keyCallbacks;
+	
+	YapCacheEntry *entries;
+	uint32_t entryCapacity; // number of allocated entries
+	uint32_t entryHighWater; // entries beyond this index have never been used
+	uint32_t freeEntry;     // head of the free-list
+	uint32_t entryCount;
+	
+	uint32_t *buckets;
+	uint64_t bucketMask;    // bucketCount - 1 (bucketCount is a power of 2)
+	
+	uint32_t mostRecent;
+	uint32_t leastRecent;
+	
 	NSUInteger countLimit;
+	NSUInteger costLimit;
+	NSUInteger totalCost;
 	
-	__unsafe_unretained YapCacheItem *mostRecentCacheItem;
-	__unsafe_unretained YapCacheItem *leastRecentCacheItem;
+	YapCacheAdmissionPolicy admissionPolicy;
+	uint8_t *sketch;
+	NSUInteger sketchWidth;
+	NSUInteger sketchAdditions;
+	uint64_t sketchLastMissHash;
 	
-	__strong YapCacheItem *evictedCacheItem;
+	YapCacheLookupCounters *lookupCounters;
+	YapCacheLifetimeStatistics lifetimeStatistics;
 }
 
 @synthesize allowedKeyClasses = allowedKeyClasses;
 @synthesize allowedObjectClasses = allowedObjectClasses;
+@synthesize costBlock = costBlock;
+@synthesize totalCost = totalCost;
+@synthesize lookupCounters = lookupCounters;
+@synthesize lifetimeStatistics = lifetimeStatistics;
 
 #if YapCache_Enable_Statistics
 @synthesize hitCount = hitCount;
 @synthesize missCount = missCount;
 @synthesize evictionCount = evictionCount;
+@synthesize evictedCost = evictedCost;
+@synthesize rejectionCount = rejectionCount;
 #endif
 
 - (instancetype)init
@@ -104,18 +144,29 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 	{
 		// zero is a valid countLimit (it means unlimited)
 		countLimit = inCountLimit;
+		keyCallbacks = inKeyCallbacks;
+		
+		freeEntry = YAP_CACHE_NIL;
+		mostRecent = YAP_CACHE_NIL;
+		leastRecent = YAP_CACHE_NIL;
+		
+		NSUInteger initialCapacity = YAP_CACHE_MIN_CAPACITY;
+		if (countLimit != 0) {
+			initialCapacity = MIN(countLimit, (NSUInteger)YAP_CACHE_MAX_PREALLOCATED);
+		}
 		
-		cfdict = CFDictionaryCreateMutable(kCFAllocatorDefault,
-		                                   0,
-		                                   &inKeyCallbacks,
-		                                   &kCFTypeDictionaryValueCallBacks);
+		[self resizeToCapacity:(uint32_t)initialCapacity];
 	}
 	return self;
 }
 
 - (void)dealloc
 {
-	if (cfdict) CFRelease(cfdict);
+	[self removeAllObjects];
+	
+	if (entries) free(entries);
+	if (buckets) free(buckets);
+	if (sketch) free(sketch);
 }
 
 - (NSUInteger)countLimit
@@ -128,37 +179,432 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 	if (countLimit != newCountLimit)
 	{
 		countLimit = newCountLimit;
-		if (countLimit != 0)
+		
+		if (sketch) {
+			[self resizeSketchIfNeeded];
+		}
+		
+		[self evictIfNeeded];
+	}
+}
+
+- (NSUInteger)costLimit
+{
+	return costLimit;
+}
+
+- (void)setCostLimit:(NSUInteger)newCostLimit
+{
+	if (costLimit != newCostLimit)
+	{
+		BOOL wasTrackingCost = (costLimit != 0) || (costBlock != nil);
+		
+		costLimit = newCostLimit;
+		
+		if (!wasTrackingCost && (costLimit != 0))
 		{
-			while (CFDictionaryGetCount(cfdict) > (CFIndex)countLimit)
+			// We weren't calculating costs before, so we need to do so now.
+			
+			totalCost = 0;
+			
+			uint32_t index = mostRecent;
+			while (index != YAP_CACHE_NIL)
 			{
-				__unsafe_unretained id keyToEvict = leastRecentCacheItem->key;
+				NSUInteger cost = [self costForKey:(__bridge id)entries[index].key
+				                            object:(__bridge id)entries[index].value];
 				
-				if (evictedCacheItem == nil)
-				{
-					evictedCacheItem = leastRecentCacheItem;
-					
-					leastRecentCacheItem = leastRecentCacheItem->prev;
-					leastRecentCacheItem->next = nil;
-					
-					evictedCacheItem->prev = nil;
-					evictedCacheItem->next = nil;
-					evictedCacheItem->key = nil;
-					evictedCacheItem->value = nil;
-				}
-				else
-				{
-					leastRecentCacheItem = leastRecentCacheItem->prev;
-					leastRecentCacheItem->next = nil;
-				}
-				
-				CFDictionaryRemoveValue(cfdict, (const void *)(keyToEvict));
+				entries[index].cost = cost;
+				totalCost += cost;
 				
-				#if YapCache_Enable_Statistics
-				evictionCount++;
-				#endif
+				index = entries[index].next;
 			}
 		}
+		
+		[self evictIfNeeded];
+	}
+}
+
+- (YapCacheAdmissionPolicy)admissionPolicy
+{
+	return admissionPolicy;
+}
+
+- (void)setAdmissionPolicy:(YapCacheAdmissionPolicy)newAdmissionPolicy
+{
+	if (admissionPolicy != newAdmissionPolicy)
+	{
+		admissionPolicy = newAdmissionPolicy;
+		
+		if (admissionPolicy == YapCacheAdmissionPolicyTinyLFU)
+		{
+			[self resizeSketchIfNeeded];
+		}
+		else if (sketch)
+		{
+			free(sketch);
+			sketch = NULL;
+			sketchWidth = 0;
+			sketchAdditions = 0;
+			sketchLastMissHash = 0;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Tables
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t YapCacheHashKey(__unsafe_unretained YapCache *cache, const void *key)
+{
+	CFHashCode hash = cache->keyCallbacks.hash ? cache->keyCallbacks.hash(key) : (CFHashCode)key;
+	
+	return YapCacheSpreadHash((uint64_t)hash);
+}
+
+/**
+ * Returns the index of the entry for the given key, or YAP_CACHE_NIL if the key isn't in the cache.
+**/
+static inline uint32_t YapCacheFind(__unsafe_unretained YapCache *cache, const void *key, uint64_t hash)
+{
+	uint64_t mask = cache->bucketMask;
+	uint64_t i = hash & mask;
+	uint32_t slot;
+	
+	while ((slot = cache->buckets[i]) != 0)
+	{
+		YapCacheEntry *entry = &cache->entries[slot - 1];
+		
+		if (entry->hash == hash)
+		{
+			if (entry->key == key) return (slot - 1);
+			if (cache->keyCallbacks.equal && cache->keyCallbacks.equal(entry->key, key)) return (slot - 1);
+		}
+		
+		i = (i + 1) & mask;
+	}
+	
+	return YAP_CACHE_NIL;
+}
+
+static inline void YapCacheBucketInsert(__unsafe_unretained YapCache *cache, uint32_t index)
+{
+	uint64_t mask = cache->bucketMask;
+	uint64_t i = cache->entries[index].hash & mask;
+	
+	while (cache->buckets[i] != 0)
+	{
+		i = (i + 1) & mask;
+	}
+	
+	cache->buckets[i] = index + 1;
+}
+
+static void YapCacheBucketRemove(__unsafe_unretained YapCache *cache, uint32_t index)
+{
+	uint64_t mask = cache->bucketMask;
+	uint64_t i = cache->entries[index].hash & mask;
+	
+	while (cache->buckets[i] != (index + 1))
+	{
+		i = (i + 1) & mask;
+	}
+	
+	// Backward-shift deletion:
+	// Move subsequent entries (in the same probe sequence) back into the hole.
+	// An entry can fill the hole, unless its home bucket lies (cyclically) within (hole, j].
+	
+	uint64_t j = i;
+	for (;;)
+	{
+		j = (j + 1) & mask;
+		
+		uint32_t slot = cache->buckets[j];
+		if (slot == 0) break;
+		
+		uint64_t home = cache->entries[slot - 1].hash & mask;
+		
+		BOOL stays = (i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j));
+		if (!stays)
+		{
+			cache->buckets[i] = slot;
+			i = j;
+		}
+	}
+	
+	cache->buckets[i] = 0;
+}
+
+static inline void YapCacheUnlink(__unsafe_unretained YapCache *cache, uint32_t index)
+{
+	YapCacheEntry *entry = &cache->entries[index];
+	
+	if (entry->prev != YAP_CACHE_NIL)
+		cache->entries[entry->prev].next = entry->next;
+	else
+		cache->mostRecent = entry->next;
+	
+	if (entry->next != YAP_CACHE_NIL)
+		cache->entries[entry->next].prev = entry->prev;
+	else
+		cache->leastRecent = entry->prev;
+}
+
+static inline void YapCacheLinkFront(__unsafe_unretained YapCache *cache, uint32_t index)
+{
+	YapCacheEntry *entry = &cache->entries[index];
+	
+	entry->prev = YAP_CACHE_NIL;
+	entry->next = cache->mostRecent;
+	
+	if (cache->mostRecent != YAP_CACHE_NIL)
+		cache->entries[cache->mostRecent].prev = index;
+	else
+		cache->leastRecent = index;
+	
+	cache->mostRecent = index;
+}
+
+static inline void YapCacheMoveToFront(__unsafe_unretained YapCache *cache, uint32_t index)
+{
+	if (index != cache->mostRecent)
+	{
+		YapCacheUnlink(cache, index);
+		YapCacheLinkFront(cache, index);
+	}
+}
+
+/**
+ * Returns an unused entry, growing the tables if needed.
+**/
+static inline uint32_t YapCacheAllocEntry(__unsafe_unretained YapCache *cache)
+{
+	if (cache->freeEntry != YAP_CACHE_NIL)
+	{
+		uint32_t index = cache->freeEntry;
+		cache->freeEntry = cache->entries[index].next;
+		
+		return index;
+	}
+	
+	if (cache->entryHighWater == cache->entryCapacity)
+	{
+		uint32_t newCapacity = (cache->entryCapacity > 0) ? (cache->entryCapacity * 2) : YAP_CACHE_MIN_CAPACITY;
+		
+		if (cache->countLimit != 0 && newCapacity > cache->countLimit)
+		{
+			newCapacity = (uint32_t)MIN(cache->countLimit, (NSUInteger)(UINT32_MAX - 1));
+			newCapacity = MAX(newCapacity, cache->entryCapacity + 1);
+		}
+		
+		[cache resizeToCapacity:newCapacity];
+	}
+	
+	return cache->entryHighWater++;
+}
+
+/**
+ * Removes the entry from the hash table & linked-list, and releases its key & value.
+**/
+static void YapCacheRemoveEntry(__unsafe_unretained YapCache *cache, uint32_t index)
+{
+	YapCacheBucketRemove(cache, index);
+	YapCacheUnlink(cache, index);
+	
+	YapCacheEntry *entry = &cache->entries[index];
+	
+	const void *key = entry->key;
+	const void *value = entry->value;
+	
+	cache->totalCost -= entry->cost;
+	cache->entryCount--;
+	
+	entry->key = NULL;
+	entry->value = NULL;
+	entry->cost = 0;
+	entry->prev = YAP_CACHE_NIL;
+	entry->next = cache->freeEntry;
+	cache->freeEntry = index;
+	
+	// Release last, as releasing the value may have side effects (e.g. the object is deallocated).
+	
+	if (cache->keyCallbacks.release) {
+		cache->keyCallbacks.release(kCFAllocatorDefault, key);
+	}
+	CFRelease(value);
+}
+
+/**
+ * Grows the entries table (which preserves entry indexes), and rehashes if the hash table needs to grow too.
+ * The hash table is kept at a load factor of (at most) 50%.
+**/
+- (void)resizeToCapacity:(uint32_t)newCapacity
+{
+	entries = reallocf(entries, (size_t)newCapacity * sizeof(YapCacheEntry));
+	entryCapacity = newCapacity;
+	
+	uint64_t bucketCount = YAP_CACHE_MIN_BUCKETS;
+	while (bucketCount < ((uint64_t)newCapacity * 2)) {
+		bucketCount <<= 1;
+	}
+	
+	if (buckets == NULL || bucketCount > (bucketMask + 1))
+	{
+		if (buckets) free(buckets);
+		
+		buckets = calloc((size_t)bucketCount, sizeof(uint32_t));
+		bucketMask = bucketCount - 1;
+		
+		uint32_t index = mostRecent;
+		while (index != YAP_CACHE_NIL)
+		{
+			YapCacheBucketInsert(self, index);
+			index = entries[index].next;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Frequency Sketch
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * (Re)allocates the sketch if its width doesn't match the current countLimit.
+ * Resizing discards the recorded frequencies.
+**/
+- (void)resizeSketchIfNeeded
+{
+	NSUInteger targetWidth = YAP_CACHE_SKETCH_DEFAULT_WIDTH;
+	if (countLimit != 0)
+	{
+		targetWidth = YAP_CACHE_SKETCH_MIN_WIDTH;
+		while (targetWidth < countLimit) {
+			targetWidth <<= 1;
+		}
+	}
+	
+	if (sketch && (sketchWidth == targetWidth)) return;
+	
+	if (sketch) free(sketch);
+	
+	sketch = calloc(targetWidth * YAP_CACHE_SKETCH_DEPTH, sizeof(uint8_t));
+	sketchWidth = targetWidth;
+	sketchAdditions = 0;
+}
+
+/**
+ * Increments the (approximate) access frequency of the key.
+**/
+- (void)sketchIncrement:(uint64_t)hash
+{
+	// Double hashing: index(i) = h1 + (i * h2)
+	
+	uint32_t h1 = (uint32_t)hash;
+	uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+	NSUInteger mask = sketchWidth - 1;
+	
+	for (NSUInteger i = 0; i < YAP_CACHE_SKETCH_DEPTH; i++)
+	{
+		uint8_t *counter = sketch + (i * sketchWidth) + ((h1 + (i * h2)) & mask);
+		if (*counter < YAP_CACHE_SKETCH_MAX_COUNT) {
+			(*counter)++;
+		}
+	}
+	
+	if (++sketchAdditions >= (sketchWidth * YAP_CACHE_SKETCH_SAMPLE_FACTOR))
+	{
+		// Aging: halve every counter, so the sketch reflects recent popularity.
+		
+		NSUInteger total = sketchWidth * YAP_CACHE_SKETCH_DEPTH;
+		for (NSUInteger i = 0; i < total; i++) {
+			sketch[i] >>= 1;
+		}
+		
+		sketchAdditions /= 2;
+	}
+}
+
+/**
+ * Returns the (approximate) access frequency of the key.
+**/
+- (uint8_t)sketchFrequency:(uint64_t)hash
+{
+	uint32_t h1 = (uint32_t)hash;
+	uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+	NSUInteger mask = sketchWidth - 1;
+	
+	uint8_t frequency = YAP_CACHE_SKETCH_MAX_COUNT;
+	
+	for (NSUInteger i = 0; i < YAP_CACHE_SKETCH_DEPTH; i++)
+	{
+		uint8_t counter = sketch[(i * sketchWidth) + ((h1 + (i * h2)) & mask)];
+		if (counter < frequency) {
+			frequency = counter;
+		}
+	}
+	
+	return frequency;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Cache
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)costForKey:(id)key object:(id)object
+{
+	if (costBlock) {
+		return costBlock(key, object);
+	}
+	
+	if (costLimit == 0) {
+		return 0;
+	}
+	
+	if ([object respondsToSelector:@selector(yapCacheCost)]) {
+		return [(id <YapCacheCost>)object yapCacheCost];
+	}
+	
+	return 0;
+}
+
+/**
+ * Evicts the least recently used item.
+ * The cache must not be empty.
+**/
+- (void)evictLeastRecentEntry
+{
+	uint32_t index = leastRecent;
+	
+	YDBLogVerbose(@"out(%@)", (__bridge id)entries[index].key);
+	
+	lifetimeStatistics.evictions++;
+	
+	#if YapCache_Enable_Statistics
+	evictionCount++;
+	evictedCost += entries[index].cost;
+	#endif
+	
+	YapCacheRemoveEntry(self, index);
+}
+
+/**
+ * Evicts least recently used items until both the countLimit & costLimit are satisfied.
+**/
+- (void)evictIfNeeded
+{
+	if (countLimit != 0)
+	{
+		while (entryCount > countLimit)
+		{
+			[self evictLeastRecentEntry];
+		}
+	}
+	
+	if (costLimit != 0)
+	{
+		while ((totalCost > costLimit) && (leastRecent != YAP_CACHE_NIL))
+		{
+			[self evictLeastRecentEntry];
+		}
 	}
 }
 
@@ -168,41 +614,34 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 	AssertAllowedKeyClass(key, allowedKeyClasses);
 	#endif
 	
-	__unsafe_unretained YapCacheItem *item = CFDictionaryGetValue(cfdict, (const void *)key);
-	if (item)
+	uint64_t hash = YapCacheHashKey(self, (__bridge const void *)key);
+	
+	if (sketch) {
+		[self sketchIncrement:hash];
+	}
+	
+	uint32_t index = YapCacheFind(self, (__bridge const void *)key, hash);
+	if (index != YAP_CACHE_NIL)
 	{
-		if (item != mostRecentCacheItem)
-		{
-			// Remove item from current position in linked-list.
-			//
-			// Notes:
-			// We fetched the item from the list,
-			// so we know there's a valid mostRecentCacheItem & leastRecentCacheItem.
-			// Furthermore, we know the item isn't the mostRecentCacheItem.
-			
-			item->prev->next = item->next;
-			
-			if (item == leastRecentCacheItem)
-				leastRecentCacheItem = item->prev;
-			else
-				item->next->prev = item->prev;
-			
-			// Move item to beginning of linked-list
-			
-			item->prev = nil;
-			item->next = mostRecentCacheItem;
-			
-			mostRecentCacheItem->prev = item;
-			mostRecentCacheItem = item;
-		}
+		YapCacheMoveToFront(self, index);
+		
+		if (lookupCounters) lookupCounters->hits++;
+		lifetimeStatistics.hits++;
 		
 		#if YapCache_Enable_Statistics
 		hitCount++;
 		#endif
-		return item->value;
+		return (__bridge id)entries[index].value;
 	}
 	else
 	{
+		// The typical pattern is a miss, followed by a setObject:forKey: (for the same key).
+		// Remember the miss, so the pair is only counted once by the sketch.
+		sketchLastMissHash = hash;
+		
+		if (lookupCounters) lookupCounters->misses++;
+		lifetimeStatistics.misses++;
+		
 		#if YapCache_Enable_Statistics
 		missCount++;
 		#endif
@@ -216,155 +655,171 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 	AssertAllowedKeyClass(key, allowedKeyClasses);
 	#endif
 	
-	return CFDictionaryContainsKey(cfdict, (const void *)key);
+	uint64_t hash = YapCacheHashKey(self, (__bridge const void *)key);
+	
+	return (YapCacheFind(self, (__bridge const void *)key, hash) != YAP_CACHE_NIL);
 }
 
 - (void)setObject:(id)object forKey:(id)key
+{
+	NSUInteger cost = 0;
+	if ((costLimit != 0) || (costBlock != nil)) {
+		cost = [self costForKey:key object:object];
+	}
+	
+	[self setObject:object forKey:key cost:cost];
+}
+
+- (void)setObject:(id)object forKey:(id)key cost:(NSUInteger)cost
 {
 	#ifndef NS_BLOCK_ASSERTIONS
 	AssertAllowedKeyClass(key, allowedKeyClasses);
 	AssertAllowedObjectClass(object, allowedObjectClasses);
 	#endif
 	
-	__unsafe_unretained YapCacheItem *existingItem = CFDictionaryGetValue(cfdict, (const void *)key);
-	if (existingItem)
+	if (object == nil)
+	{
+		[self removeObjectForKey:key];
+		return;
+	}
+	
+	uint64_t hash = YapCacheHashKey(self, (__bridge const void *)key);
+	
+	uint32_t index = YapCacheFind(self, (__bridge const void *)key, hash);
+	if (index != YAP_CACHE_NIL)
 	{
-		// Update item value
-		existingItem->value = object;
+		// Update item value (and cost)
 		
-		if (existingItem != mostRecentCacheItem)
-		{
-			// Remove item from current position in linked-list
-			//
-			// Notes:
-			// We fetched the item from the list,
-			// so we know there's a valid mostRecentCacheItem & leastRecentCacheItem.
-			// Furthermore, we know the item isn't the mostRecentCacheItem.
-			
-			existingItem->prev->next = existingItem->next;
-			
-			if (existingItem == leastRecentCacheItem)
-				leastRecentCacheItem = existingItem->prev;
-			else
-				existingItem->next->prev = existingItem->prev;
-			
-			// Move item to beginning of linked-list
-			
-			existingItem->prev = nil;
-			existingItem->next = mostRecentCacheItem;
-			
-			mostRecentCacheItem->prev = existingItem;
-			mostRecentCacheItem = existingItem;
-			
-			YDBLogVerbose(@"key(%@) <- existing, new mostRecent", key);
-		}
-		else
+		YapCacheEntry *entry = &entries[index];
+		
+		const void *oldValue = entry->value;
+		entry->value = CFBridgingRetain(object);
+		
+		totalCost -= entry->cost;
+		totalCost += cost;
+		entry->cost = cost;
+		
+		YapCacheMoveToFront(self, index);
+		
+		YDBLogVerbose(@"key(%@) <- existing, new mostRecent", key);
+		
+		// The cost may have increased
+		
+		if (costLimit != 0 && totalCost > costLimit)
 		{
-			YDBLogVerbose(@"key(%@) <- existing, already mostRecent", key);
+			[self evictIfNeeded];
 		}
+		
+		CFRelease(oldValue);
 	}
 	else
 	{
-		// Create new item (or recycle old evicted item)
-		
-		__strong YapCacheItem *newItem = nil;
-		
-		if (evictedCacheItem)
+		if (sketch)
 		{
-			newItem = evictedCacheItem;
-			newItem->key = key;
-			newItem->value = object;
+			if (hash != sketchLastMissHash) {
+				[self sketchIncrement:hash];
+			}
+			sketchLastMissHash = 0;
 			
-			evictedCacheItem = nil;
+			// TinyLFU admission:
+			// If the cache is full, only admit the new item if it's more popular than the item it would replace.
+			
+			BOOL isFull = ((countLimit != 0) && (entryCount >= countLimit)) ||
+			              ((costLimit != 0) && ((totalCost + cost) > costLimit));
+			
+			if (isFull && (leastRecent != YAP_CACHE_NIL))
+			{
+				uint8_t candidateFrequency = [self sketchFrequency:hash];
+				uint8_t victimFrequency = [self sketchFrequency:entries[leastRecent].hash];
+				
+				if (candidateFrequency <= victimFrequency)
+				{
+					YDBLogVerbose(@"key(%@) <- rejected (frequency %d <= %d)",
+					              key, (int)candidateFrequency, (int)victimFrequency);
+					
+					#if YapCache_Enable_Statistics
+					rejectionCount++;
+					#endif
+					return;
+				}
+			}
 		}
-		else
+		
+		// Evict the leastRecent item first (if needed),
+		// so the tables never need to hold more than countLimit items.
+		
+		if (countLimit != 0)
 		{
-			newItem = [[YapCacheItem alloc] initWithKey:key value:object];
+			while ((entryCount >= countLimit) && (leastRecent != YAP_CACHE_NIL))
+			{
+				[self evictLeastRecentEntry];
+			}
 		}
 		
-		// Add item to set
-		CFDictionarySetValue(cfdict, (const void *)key, (const void *)newItem);
+		index = YapCacheAllocEntry(self);
 		
-		// Add item to beginning of linked-list
+		YapCacheEntry *entry = &entries[index];
 		
-		newItem->next = mostRecentCacheItem;
+		const void *rawKey = (__bridge const void *)key;
+		entry->key = keyCallbacks.retain ? keyCallbacks.retain(kCFAllocatorDefault, rawKey) : rawKey;
+		entry->value = CFBridgingRetain(object);
+		entry->hash = hash;
+		entry->cost = cost;
 		
-		if (mostRecentCacheItem)
-			mostRecentCacheItem->prev = newItem;
+		totalCost += cost;
+		entryCount++;
 		
-		mostRecentCacheItem = newItem;
+		YapCacheBucketInsert(self, index);
+		YapCacheLinkFront(self, index);
 		
-		// Evict leastRecentCacheItem if needed
+		// Evict leastRecent item(s) if needed
 		
-		if ((countLimit != 0) && (CFDictionaryGetCount(cfdict) > (CFIndex)countLimit))
+		if ((costLimit != 0) && (totalCost > costLimit))
 		{
-			YDBLogVerbose(@"key(%@), out(%@)", key, leastRecentCacheItem->key);
-			
-			__unsafe_unretained id keyToEvict = leastRecentCacheItem->key;
-			
-			if (evictedCacheItem == nil)
-			{
-				evictedCacheItem = leastRecentCacheItem;
-				
-				leastRecentCacheItem = leastRecentCacheItem->prev;
-				leastRecentCacheItem->next = nil;
-			
-				evictedCacheItem->prev = nil;
-				evictedCacheItem->next = nil;
-				evictedCacheItem->key = nil;
-				evictedCacheItem->value = nil;
-			}
-			else
-			{
-				leastRecentCacheItem = leastRecentCacheItem->prev;
-				leastRecentCacheItem->next = nil;
-			}
-			
-			CFDictionaryRemoveValue(cfdict, (const void *)(keyToEvict));
-			
-			#if YapCache_Enable_Statistics
-			evictionCount++;
-			#endif
+			[self evictIfNeeded];
 		}
 		else
 		{
-			if (leastRecentCacheItem == nil)
-				leastRecentCacheItem = newItem;
-			
-			YDBLogVerbose(@"key(%@) <- new, new mostRecent [%ld of %lu]",
-			              key, CFDictionaryGetCount(cfdict), (unsigned long)countLimit);
+			YDBLogVerbose(@"key(%@) <- new, new mostRecent [%lu of %lu]",
+			              key, (unsigned long)entryCount, (unsigned long)countLimit);
 		}
 	}
 	
 	if (ydbLogLevel & YDB_LOG_FLAG_VERBOSE)
 	{
-		YDBLogVerbose(@"cfdict: %@", cfdict);
-		
-		YapCacheItem *loopItem = mostRecentCacheItem;
-		NSUInteger i = 0;
-		
-		while (loopItem != nil)
-		{
-			YDBLogVerbose(@"%lu: %@", (unsigned long)i, loopItem);
-			
-			loopItem = loopItem->next;
-			i++;
-		}
+		YDBLogVerbose(@"%@", [self description]);
 	}
 }
 
 - (NSUInteger)count
 {
-	return CFDictionaryGetCount(cfdict);
+	return entryCount;
 }
 
 - (void)removeAllObjects
 {
-	mostRecentCacheItem = nil;
-	leastRecentCacheItem = nil;
-	evictedCacheItem = nil;
+	uint32_t index = mostRecent;
+	while (index != YAP_CACHE_NIL)
+	{
+		YapCacheEntry *entry = &entries[index];
+		index = entry->next;
+		
+		if (keyCallbacks.release) {
+			keyCallbacks.release(kCFAllocatorDefault, entry->key);
+		}
+		CFRelease(entry->value);
+	}
 	
-	CFDictionaryRemoveAllValues(cfdict);
+	if (buckets) {
+		memset(buckets, 0, (size_t)(bucketMask + 1) * sizeof(uint32_t));
+	}
+	
+	entryHighWater = 0;
+	entryCount = 0;
+	freeEntry = YAP_CACHE_NIL;
+	mostRecent = YAP_CACHE_NIL;
+	leastRecent = YAP_CACHE_NIL;
+	totalCost = 0;
 }
 
 - (void)removeObjectForKey:(id)key
@@ -373,20 +828,12 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 	AssertAllowedKeyClass(key, allowedKeyClasses);
 	#endif
 	
-	__unsafe_unretained YapCacheItem *item = CFDictionaryGetValue(cfdict, (const void *)key);
-	if (item)
+	uint64_t hash = YapCacheHashKey(self, (__bridge const void *)key);
+	
+	uint32_t index = YapCacheFind(self, (__bridge const void *)key, hash);
+	if (index != YAP_CACHE_NIL)
 	{
-		if (mostRecentCacheItem == item)
-			mostRecentCacheItem = item->next;
-		else if (item->prev)
-			item->prev->next = item->next;
-		
-		if (leastRecentCacheItem == item)
-			leastRecentCacheItem = item->prev;
-		else if (item->next)
-			item->next->prev = item->prev;
-		
-		CFDictionaryRemoveValue(cfdict, (const void *)key);
+		YapCacheRemoveEntry(self, index);
 	}
 }
 
@@ -394,66 +841,79 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 {
 	for (id key in keys)
 	{
-		#ifndef NS_BLOCK_ASSERTIONS
-		AssertAllowedKeyClass(key, allowedKeyClasses);
-		#endif
-		
-		__unsafe_unretained YapCacheItem *item = CFDictionaryGetValue(cfdict, (const void *)key);
-		if (item)
-		{
-			if (mostRecentCacheItem == item)
-				mostRecentCacheItem = item->next;
-			else if (item->prev)
-				item->prev->next = item->next;
-			
-			if (leastRecentCacheItem == item)
-				leastRecentCacheItem = item->prev;
-			else if (item->next)
-				item->next->prev = item->prev;
-			
-			CFDictionaryRemoveValue(cfdict, (const void *)key);
-		}
+		[self removeObjectForKey:key];
 	}
 }
 
+/**
+ * Enumerates from the most recently used item to the least recently used item.
+ * The cache must not be modified during enumeration.
+**/
 - (void)enumerateKeysWithBlock:(void (^)(id key, BOOL *stop))block
 {
-	NSDictionary *nsdict = (__bridge NSDictionary *)cfdict;
 	BOOL stop = NO;
 	
-	for (id key in [nsdict keyEnumerator])
+	uint32_t index = mostRecent;
+	while (index != YAP_CACHE_NIL)
 	{
-		block(key, &stop);
+		uint32_t next = entries[index].next;
 		
+		block((__bridge id)entries[index].key, &stop);
 		if (stop) break;
+		
+		index = next;
 	}
 }
 
 - (void)enumerateKeysAndObjectsWithBlock:(void (^)(id key, id obj, BOOL *stop))block
 {
-	NSDictionary *nsdict = (__bridge NSDictionary *)cfdict;
+	BOOL stop = NO;
 	
-	[nsdict enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
+	uint32_t index = mostRecent;
+	while (index != YAP_CACHE_NIL)
+	{
+		uint32_t next = entries[index].next;
 		
-		__unsafe_unretained YapCacheItem *cacheItem = (YapCacheItem *)obj;
+		block((__bridge id)entries[index].key, (__bridge id)entries[index].value, &stop);
+		if (stop) break;
+		
+		index = next;
+	}
+}
+
+- (uint64_t)estimatedMemoryUsage
+{
+	uint64_t size = (uint64_t)malloc_size((__bridge const void *)self);
+	
+	size += (uint64_t)entryCapacity * sizeof(YapCacheEntry);
+	size += (bucketMask + 1) * sizeof(uint32_t);
+	size += (uint64_t)sketchWidth * YAP_CACHE_SKETCH_DEPTH;
+	
+	uint32_t index = mostRecent;
+	while (index != YAP_CACHE_NIL)
+	{
+		size += YapDatabaseEstimatedObjectSize((__bridge id)entries[index].key);
+		size += YapDatabaseEstimatedObjectSize((__bridge id)entries[index].value);
 		
-		block(key, cacheItem->value, stop);
-	}];
+		index = entries[index].next;
+	}
+	
+	return size;
 }
 
 - (NSString *)description
 {
 	NSMutableString *description = [NSMutableString string];
-	[description appendFormat:@"%@, count=%ld, keys=\n", NSStringFromClass([self class]), CFDictionaryGetCount(cfdict)];
+	[description appendFormat:@"%@, count=%lu, keys=\n", NSStringFromClass([self class]), (unsigned long)entryCount];
 	
-	YapCacheItem *item = mostRecentCacheItem;
+	uint32_t index = mostRecent;
 	NSUInteger itemIndex = 0;
 	
-	while (item != nil)
+	while (index != YAP_CACHE_NIL)
 	{
-		[description appendFormat:@"  %lu: %@\n", (unsigned long)itemIndex, item->key];
+		[description appendFormat:@"  %lu: %@\n", (unsigned long)itemIndex, (__bridge id)entries[index].key];
 		
-		item = item->next;
+		index = entries[index].next;
 		itemIndex++;
 	}
 	
@@ -464,7 +924,7 @@ static const NSUInteger YapCache_Default_CountLimit = 40;
 static void AssertAllowedKeyClass(id key, NSSet *allowedKeyClasses)
 {
 	if (allowedKeyClasses == nil) return;
-
+	
 	// This doesn't work.
 	// For example, @(number) gives us class '__NSCFNumber', which is not NSNumber.
 	// And there are also class clusters which break this technique too.
@@ -509,28 +969,30 @@ static void AssertAllowedObjectClass(id obj, NSSet *allowedObjectClasses)
 /*
 - (void)debug
 {
-	CFIndex count = CFDictionaryGetCount(cfdict);
-	NSAssert(count <= countLimit, @"Invalid count");
+	NSAssert(countLimit == 0 || entryCount <= countLimit, @"Invalid count");
 	
-	NSMutableArray *forwardsKeys = [NSMutableArray arrayWithCapacity:count];
-	NSMutableArray *backwardsKeys = [NSMutableArray arrayWithCapacity:count];
+	NSMutableArray *forwardsKeys = [NSMutableArray arrayWithCapacity:entryCount];
+	NSMutableArray *backwardsKeys = [NSMutableArray arrayWithCapacity:entryCount];
 	
-	__unsafe_unretained YapCacheItem *loopItem;
+	uint32_t index;
 	
-	loopItem = mostRecentCacheItem;
-	while (loopItem != nil)
+	index = mostRecent;
+	while (index != YAP_CACHE_NIL)
 	{
-		[forwardsKeys addObject:loopItem->key];
-		loopItem = loopItem->next;
+		[forwardsKeys addObject:(__bridge id)entries[index].key];
+		NSAssert(YapCacheFind(self, entries[index].key, entries[index].hash) == index, @"Invalid bucket");
+		
+		index = entries[index].next;
 	}
 	
-	loopItem = leastRecentCacheItem;
-	while (loopItem != nil)
+	index = leastRecent;
+	while (index != YAP_CACHE_NIL)
 	{
-		[backwardsKeys insertObject:loopItem->key atIndex:0];
-		loopItem = loopItem->prev;
+		[backwardsKeys insertObject:(__bridge id)entries[index].key atIndex:0];
+		index = entries[index].prev;
 	}
 	
+	NSAssert([forwardsKeys count] == entryCount, @"Invalid count");
 	NSAssert([forwardsKeys isEqual:backwardsKeys], @"Invalid order");
 }
 */
@@ -5,11 +5,23 @@ NS_ASSUME_NONNULL_BEGIN
 // Macro for lazy programmer (less typing than alloc/init)
 #define YapCollectionKeyCreate(_collection, _key) [[YapCollectionKey alloc] initWithCollection:_collection key:_key]
 
+// The maximum number of interned collections (see YapCollectionKey.collectionIndex)
+#define YAP_COLLECTION_INTERN_LIMIT 512
+
+/**
+ * Returns the index of the given collection (interning it, if needed), or NSNotFound if it can't be interned.
+ * See YapCollectionKey.collectionIndex.
+**/
+NSUInteger YapCollectionIndex(NSString *_Nullable collection);
+
 /**
  * An efficient collection/key tuple class.
  *
  * Combines collection & key into a single object,
  * and provides the proper methods to use the object in various classes (such as NSDictionary, NSSet, etc).
+ *
+ * The hash is computed once (during init), and collection names are interned.
+ * So hashing is free, and comparing collections is typically a pointer comparison.
 **/
 @interface YapCollectionKey : NSObject <NSCopying, NSCoding>
 
@@ -18,6 +30,14 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, strong, readonly) NSString *collection;
 @property (nonatomic, strong, readonly) NSString *key;
 
+/**
+ * The index assigned to the (interned) collection, which is the same for every key in the collection.
+ * Indexes are small (< YAP_COLLECTION_INTERN_LIMIT), and assigned in the order collections are first seen.
+ * 
+ * This is NSNotFound if the collection couldn't be interned (there are too many distinct collections).
+**/
+@property (nonatomic, assign, readonly) NSUInteger collectionIndex;
+
 - (BOOL)isEqualToCollectionKey:(YapCollectionKey *)collectionKey;
 
 // These methods are overriden and optimized:
@@ -1,5 +1,89 @@
 #import "YapCollectionKey.h"
 #import "YapMurmurHash.h"
+#import "YapDatabaseAtomic.h"
+
+/**
+ * Collection names are interned.
+ * 
+ * An app typically has only a handful of collections, but creates a YapCollectionKey for almost every read,
+ * cache lookup & changeset entry. Interning means every key for a collection shares the same string instance,
+ * so comparing collections is (usually) a pointer comparison, and the hash of the collection is only computed once.
+ * 
+ * Each interned collection is also assigned a small index (in the order they're first seen),
+ * which lets a set of collections be represented as a bitset (see YapWhitelistBlacklist).
+ * 
+ * The table is bounded, in case an app (ab)uses collections as identifiers.
+ * Collections that don't fit are simply not interned, and are compared the regular way.
+**/
+
+static YAPUnfairLock internLock = YAP_UNFAIR_LOCK_INIT;
+static CFMutableDictionaryRef internTable = NULL;                // collection -> (NSUInteger)index
+static NSUInteger internHashes[YAP_COLLECTION_INTERN_LIMIT];     // index -> hash
+
+/**
+ * Returns the interned instance of the given (immutable) collection string,
+ * or the given string itself if the table is full (in which case the index is NSNotFound).
+**/
+static NSString *YapCollectionKeyIntern(NSString *collection, NSUInteger *hashPtr, NSUInteger *indexPtr)
+{
+	const void *interned = NULL;
+	NSUInteger index = NSNotFound;
+	NSUInteger hashValue = 0;
+	BOOL isInterned = NO;
+	
+	YAPUnfairLockLock(&internLock);
+	{
+		if (internTable == NULL)
+		{
+			CFDictionaryValueCallBacks valueCallbacks = { 0, NULL, NULL, NULL, NULL };
+			internTable = CFDictionaryCreateMutable(kCFAllocatorDefault, 0,
+			                                        &kCFTypeDictionaryKeyCallBacks, &valueCallbacks);
+		}
+		
+		if (CFDictionaryGetKeyIfPresent(internTable, (__bridge const void *)collection, &interned))
+		{
+			index = (NSUInteger)CFDictionaryGetValue(internTable, interned);
+			hashValue = internHashes[index];
+			isInterned = YES;
+		}
+		else if (CFDictionaryGetCount(internTable) < YAP_COLLECTION_INTERN_LIMIT)
+		{
+			interned = (__bridge const void *)collection;
+			index = (NSUInteger)CFDictionaryGetCount(internTable);
+			hashValue = [collection hash];
+			
+			internHashes[index] = hashValue;
+			CFDictionarySetValue(internTable, interned, (const void *)index);
+			isInterned = YES;
+		}
+	}
+	YAPUnfairLockUnlock(&internLock);
+	
+	if (isInterned)
+	{
+		*hashPtr = hashValue;
+		*indexPtr = index;
+		
+		// Safe: entries are never removed from the table, so the interned instance lives forever.
+		return (__bridge NSString *)interned;
+	}
+	else
+	{
+		*hashPtr = [collection hash];
+		*indexPtr = NSNotFound;
+		
+		return collection;
+	}
+}
+
+NSUInteger YapCollectionIndex(NSString *collection)
+{
+	NSUInteger hash = 0;
+	NSUInteger index = NSNotFound;
+	
+	YapCollectionKeyIntern([collection copy] ?: @"", &hash, &index);
+	return index;
+}
 
 
 @implementation YapCollectionKey
@@ -12,26 +96,30 @@
 	// This decision was made after significant profiling.
 	
 	NSUInteger hash;
+	
+	// If not NSNotFound, the collection is the interned instance,
+	// and thus differs from any other interned collection by pointer.
+	NSUInteger collectionIndex;
 }
 
 @synthesize collection = collection;
 @synthesize key = key;
+@synthesize collectionIndex = collectionIndex;
 
 - (id)initWithCollection:(NSString *)aCollection key:(NSString *)aKey
 {
 	if ((self = [super init]))
 	{
-		if (aCollection == nil)
-			collection = @"";
-		else
-			collection = [aCollection copy]; // copy == retain if aCollection is immutable
-		
 		if (aKey == nil)
 			return nil;
 		else
 			key = [aKey copy];               // copy == retain if aKey is immutable
 		
-		hash = YapMurmurHash2([collection hash], [key hash]);
+		NSUInteger collectionHash = 0;
+		collection = YapCollectionKeyIntern((aCollection ? [aCollection copy] : @""),
+		                                    &collectionHash, &collectionIndex);
+		
+		hash = YapMurmurHash2(collectionHash, [key hash]);
 	}
 	return self;
 }
@@ -43,7 +131,10 @@
 		collection = [decoder decodeObjectForKey:@"collection"];
 		key        = [decoder decodeObjectForKey:@"key"];
 		
-		hash = YapMurmurHash2([collection hash], [key hash]);
+		NSUInteger collectionHash = 0;
+		collection = YapCollectionKeyIntern((collection ?: @""), &collectionHash, &collectionIndex);
+		
+		hash = YapMurmurHash2(collectionHash, [key hash]);
 	}
 	return self;
 }
@@ -59,24 +150,47 @@
 	return self; // Immutable
 }
 
-- (BOOL)isEqualToCollectionKey:(YapCollectionKey *)collectionKey
+/**
+ * The common implementation of every equality check.
+ * 
+ * Most comparisons are resolved without any string comparison:
+ * - different hashes => not equal
+ * - same instance, or same key & (interned) collection instances => equal
+ * - different interned collection instances => not equal
+**/
+static inline BOOL YapCollectionKeyIsEqual(const __unsafe_unretained YapCollectionKey *ck1,
+                                           const __unsafe_unretained YapCollectionKey *ck2)
 {
-	if (hash != collectionKey->hash)
+	if (ck1 == ck2)
+		return YES;
+	
+	if (ck1->hash != ck2->hash)
 		return NO;
-	else
-		return [key isEqualToString:collectionKey->key] && [collection isEqualToString:collectionKey->collection];
+	
+	if (ck1->collection != ck2->collection)
+	{
+		if ((ck1->collectionIndex != NSNotFound) && (ck2->collectionIndex != NSNotFound))
+			return NO;
+		
+		if (![ck1->collection isEqualToString:ck2->collection])
+			return NO;
+	}
+	
+	return (ck1->key == ck2->key) || [ck1->key isEqualToString:ck2->key];
+}
+
+- (BOOL)isEqualToCollectionKey:(YapCollectionKey *)collectionKey
+{
+	if (collectionKey == nil) return NO;
+	
+	return YapCollectionKeyIsEqual(self, collectionKey);
 }
 
 - (BOOL)isEqual:(id)obj
 {
 	if ([obj isMemberOfClass:[YapCollectionKey class]])
 	{
-		__unsafe_unretained YapCollectionKey *collectionKey = (YapCollectionKey *)obj;
-		
-		if (hash != collectionKey->hash)
-			return NO;
-		else
-			return [key isEqualToString:collectionKey->key] && [collection isEqualToString:collectionKey->collection];
+		return YapCollectionKeyIsEqual(self, (YapCollectionKey *)obj);
 	}
 	
 	return NO;
@@ -85,10 +199,7 @@
 BOOL YapCollectionKeyEqual(const __unsafe_unretained YapCollectionKey *ck1,
                            const __unsafe_unretained YapCollectionKey *ck2)
 {
-	if (ck1->hash != ck2->hash)
-		return NO;
-	else
-		return [ck1->key isEqualToString:ck2->key] && [ck1->collection isEqualToString:ck2->collection];
+	return YapCollectionKeyIsEqual(ck1, ck2);
 }
 
 - (NSUInteger)hash
@@ -0,0 +1,148 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabase.h"
+
+@class YapDatabaseBinaryEncoder;
+@class YapDatabaseBinaryDecoder;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * Model classes adopt this protocol to be encoded (field by field) by the YapDatabaseBinaryCodec.
+ *
+ * Fields are identified by key (just like NSCoding), so the format of a class can evolve over time:
+ * - fields that are no longer encoded are simply ignored when decoding
+ * - fields that didn't exist when the object was encoded decode as nil / zero
+ *   (use -[YapDatabaseBinaryDecoder containsValueForKey:] to detect this)
+**/
+@protocol YapDatabaseBinaryCoding <NSObject>
+@required
+
+- (void)encodeWithBinaryEncoder:(YapDatabaseBinaryEncoder *)encoder;
+- (nullable instancetype)initWithBinaryDecoder:(YapDatabaseBinaryDecoder *)decoder;
+
+@end
+
+/**
+ * A compact binary serializer & deserializer, designed to be much faster than NSKeyedArchiver.
+ *
+ * The following are encoded natively:
+ * NSString, NSNumber, NSData, NSDate, NSNull, NSArray, NSSet, NSDictionary,
+ * and any class that adopts the YapDatabaseBinaryCoding protocol.
+ *
+ * Every other object that supports NSCoding is embedded as a (nested) NSKeyedArchiver archive.
+ *
+ * The format:
+ * - starts with a versioned header, so the deserializer can tell its rows apart from legacy rows.
+ *   Rows without the header are decoded with NSKeyedUnarchiver,
+ *   so you can switch an existing database (from the defaultSerializer) to the binary codec.
+ * - integers (including lengths & counts) are stored as varints
+ * - every string (including class names & field keys) is stored only once per row, in a string table
+ * - the fields of an object are followed by an offset table, so a single field can be read lazily
+ *
+ * Important:
+ * - Object identity isn't preserved. If the same object is referenced twice, it's encoded (and decoded) twice.
+ *   And thus the object graph must not contain cycles.
+ * - Arrays, sets & dictionaries are always decoded as immutable instances.
+**/
+@interface YapDatabaseBinaryCodec : NSObject
+
+/**
+ * Serializer & deserializer which may be passed to any YapDatabase init method.
+ * The deserializer is backed by a bytes deserializer, so it decodes straight from the sqlite column buffer.
+**/
++ (YapDatabaseSerializer)serializer;
++ (YapDatabaseDeserializer)deserializer;
+
+/**
+ * Encodes the given object.
+ *
+ * Throws an exception if the object (or any object within it) can't be encoded,
+ * or if the object graph is too deep (which typically means it contains a cycle).
+**/
++ (NSData *)dataWithObject:(nullable id)object;
+
+/**
+ * Decodes the given data.
+ * Data that doesn't start with the binary codec header is decoded with NSKeyedUnarchiver.
+ *
+ * Returns nil if the data is malformed.
+**/
++ (nullable id)objectWithData:(NSData *)data;
++ (nullable id)objectWithBytes:(const void *)bytes length:(size_t)length;
+
+/**
+ * Reads a single field straight from the encoded bytes, without decoding the rest of the object.
+ *
+ * The root of the encoded object must be either an object that adopts YapDatabaseBinaryCoding
+ * (in which case the field is one of its keys), or a dictionary (in which case the field is a string key).
+ * Every object is encoded with an offset table, so finding the field is very cheap,
+ * and only the value of the field itself is decoded.
+ *
+ * @return
+ *   NO if the bytes weren't encoded by the binary codec (e.g. a legacy row), or are malformed.
+ *   Otherwise YES, and valuePtr is set to the value of the field (nil if there's no such field).
+**/
++ (BOOL)getValue:(id _Nullable * _Nonnull)valuePtr
+        forField:(NSString *)field
+         inBytes:(const void *)bytes
+          length:(size_t)length;
+
++ (BOOL)getValue:(id _Nullable * _Nonnull)valuePtr forField:(NSString *)field inData:(NSData *)data;
+
+/**
+ * Returns YES if the given data starts with the binary codec header.
+**/
++ (BOOL)isBinaryCodecData:(NSData *)data;
+
+@end
+
+#pragma mark -
+
+/**
+ * Passed to -[YapDatabaseBinaryCoding encodeWithBinaryEncoder:].
+**/
+@interface YapDatabaseBinaryEncoder : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+- (void)encodeObject:(nullable id)object forKey:(NSString *)key;
+- (void)encodeBool:(BOOL)value forKey:(NSString *)key;
+- (void)encodeInt64:(int64_t)value forKey:(NSString *)key;
+- (void)encodeInteger:(NSInteger)value forKey:(NSString *)key;
+- (void)encodeDouble:(double)value forKey:(NSString *)key;
+
+@end
+
+#pragma mark -
+
+/**
+ * Passed to -[YapDatabaseBinaryCoding initWithBinaryDecoder:].
+ *
+ * Fields are decoded lazily, when requested.
+ * Scalar fields (bool, integer, double) are decoded without creating an NSNumber.
+**/
+@interface YapDatabaseBinaryDecoder : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+- (BOOL)containsValueForKey:(NSString *)key;
+
+- (nullable id)decodeObjectForKey:(NSString *)key;
+- (nullable id)decodeObjectOfClass:(Class)aClass forKey:(NSString *)key;
+- (BOOL)decodeBoolForKey:(NSString *)key;
+- (int64_t)decodeInt64ForKey:(NSString *)key;
+- (NSInteger)decodeIntegerForKey:(NSString *)key;
+- (double)decodeDoubleForKey:(NSString *)key;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,1224 @@
+#import "YapDatabaseBinaryCodec.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+/**
+ * Every encoded row starts with this header: "YBC" + version.
+ * (NSKeyedArchiver data always starts with "bplist".)
+**/
+static const uint8_t YDBBinaryCodecHeader[] = { 'Y', 'B', 'C', 1 };
+#define YDB_BINARY_CODEC_HEADER_LENGTH sizeof(YDBBinaryCodecHeader)
+
+/**
+ * Limits the nesting of arrays/dictionaries/objects.
+ * When encoding, exceeding the limit almost certainly means the object graph contains a cycle.
+**/
+#define YDB_BINARY_CODEC_MAX_DEPTH 256
+
+enum {
+	YDBBinaryTag_Nil        = 0,
+	YDBBinaryTag_Null       = 1,
+	YDBBinaryTag_False      = 2,
+	YDBBinaryTag_True       = 3,
+	YDBBinaryTag_Int        = 4,  // zigzag varint
+	YDBBinaryTag_UInt       = 5,  // varint (only for values above INT64_MAX)
+	YDBBinaryTag_Double     = 6,  // 8 bytes (little endian)
+	YDBBinaryTag_String     = 7,  // varint (string table index)
+	YDBBinaryTag_Data       = 8,  // varint (length) + bytes
+	YDBBinaryTag_Date       = 9,  // 8 bytes (little endian), timeIntervalSinceReferenceDate
+	YDBBinaryTag_Array      = 10, // varint (count) + values
+	YDBBinaryTag_Set        = 11, // varint (count) + values
+	YDBBinaryTag_Dictionary = 12, // varint (count) + key/value pairs
+	YDBBinaryTag_Object     = 13, // varint (class name index) + uint32 (values length) + values + offset table
+	YDBBinaryTag_Archive    = 14, // varint (length) + NSKeyedArchiver data
+};
+
+/**
+ * The values of an object are followed by its offset table:
+ * varint (field count) + for each field: varint (key index) + varint (offset of value, relative to first value)
+ *
+ * Thus a single field can be read without decoding (or even skipping over) any of the other fields.
+**/
+typedef struct {
+	uint32_t keyIndex;
+	uint32_t offset;
+} ydb_binary_field;
+
+/**
+ * The state of a decode operation.
+ * The bytes are only valid for the duration of the operation.
+ *
+ * The strings array is only created when decoding an entire object graph.
+ * When reading a single field, strings are created on demand (from the stringOffsets).
+**/
+typedef struct {
+	const uint8_t *bytes;
+	size_t length;
+	const uint32_t *stringOffsets;
+	NSUInteger stringCount;
+	__unsafe_unretained NSArray<NSString *> *strings;
+} ydb_binary_reader;
+
+static id ydb_binary_read_value(const ydb_binary_reader *reader, size_t *offset, NSUInteger depth);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Primitives
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void ydb_binary_append_varint(NSMutableData *data, uint64_t value)
+{
+	uint8_t buffer[10];
+	size_t length = 0;
+	
+	while (value >= 0x80)
+	{
+		buffer[length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	buffer[length++] = (uint8_t)value;
+	
+	[data appendBytes:buffer length:length];
+}
+
+static inline void ydb_binary_append_double(NSMutableData *data, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = CFSwapInt64HostToLittle(bits);
+	
+	[data appendBytes:&bits length:sizeof(bits)];
+}
+
+/**
+ * Returns NO if the varint is truncated or malformed.
+**/
+static inline BOOL ydb_binary_read_varint(const ydb_binary_reader *reader, size_t *offset, uint64_t *value)
+{
+	uint64_t result = 0;
+	int shift = 0;
+	
+	while (*offset < reader->length && shift < 64)
+	{
+		uint8_t byte = reader->bytes[(*offset)++];
+		
+		result |= ((uint64_t)(byte & 0x7F) << shift);
+		if ((byte & 0x80) == 0)
+		{
+			*value = result;
+			return YES;
+		}
+		shift += 7;
+	}
+	
+	return NO;
+}
+
+static inline BOOL ydb_binary_read_double(const ydb_binary_reader *reader, size_t *offset, double *value)
+{
+	uint64_t bits;
+	if ((reader->length - *offset) < sizeof(bits)) return NO;
+	
+	memcpy(&bits, reader->bytes + *offset, sizeof(bits));
+	bits = CFSwapInt64LittleToHost(bits);
+	memcpy(value, &bits, sizeof(bits));
+	
+	*offset += sizeof(bits);
+	return YES;
+}
+
+static inline BOOL ydb_binary_read_uint32(const ydb_binary_reader *reader, size_t *offset, uint32_t *value)
+{
+	uint32_t result;
+	if ((reader->length - *offset) < sizeof(result)) return NO;
+	
+	memcpy(&result, reader->bytes + *offset, sizeof(result));
+	*value = CFSwapInt32LittleToHost(result);
+	
+	*offset += sizeof(result);
+	return YES;
+}
+
+static inline uint64_t ydb_zigzag_encode(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t ydb_zigzag_decode(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * Each string in the string table is stored as: varint (length) + UTF-8 bytes.
+ * The string table has already been validated, so this can't fail.
+**/
+static inline const uint8_t* ydb_binary_string_bytes(const ydb_binary_reader *reader, NSUInteger index, size_t *length)
+{
+	size_t offset = reader->stringOffsets[index];
+	uint64_t len = 0;
+	ydb_binary_read_varint(reader, &offset, &len);
+	
+	*length = (size_t)len;
+	return reader->bytes + offset;
+}
+
+/**
+ * Compares the string at the given index of the string table, without creating an NSString.
+**/
+static inline BOOL ydb_binary_string_equals(const ydb_binary_reader *reader, NSUInteger index,
+                                            const char *utf8, size_t utf8Length)
+{
+	size_t length = 0;
+	const uint8_t *bytes = ydb_binary_string_bytes(reader, index, &length);
+	
+	return (length == utf8Length) && (memcmp(bytes, utf8, length) == 0);
+}
+
+/**
+ * Returns the string at the given index of the string table (or nil if invalid).
+**/
+static inline NSString* ydb_binary_read_string(const ydb_binary_reader *reader, size_t *offset)
+{
+	uint64_t index = 0;
+	if (!ydb_binary_read_varint(reader, offset, &index)) return nil;
+	if (index >= reader->stringCount) return nil;
+	
+	if (reader->strings)
+	{
+		return reader->strings[(NSUInteger)index];
+	}
+	else
+	{
+		size_t length = 0;
+		const uint8_t *bytes = ydb_binary_string_bytes(reader, (NSUInteger)index, &length);
+		
+		return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+	}
+}
+
+/**
+ * Reads a length-prefixed run of bytes.
+**/
+static inline BOOL ydb_binary_read_bytes(const ydb_binary_reader *reader, size_t *offset,
+                                         const uint8_t **bytes, size_t *length)
+{
+	uint64_t len = 0;
+	if (!ydb_binary_read_varint(reader, offset, &len)) return NO;
+	if (len > (reader->length - *offset)) return NO;
+	
+	*bytes = reader->bytes + *offset;
+	*length = (size_t)len;
+	
+	*offset += (size_t)len;
+	return YES;
+}
+
+/**
+ * Skips over the value at the given offset, without decoding it.
+ * Returns NO if the value is malformed.
+**/
+static BOOL ydb_binary_skip_value(const ydb_binary_reader *reader, size_t *offset, NSUInteger depth)
+{
+	if (depth > YDB_BINARY_CODEC_MAX_DEPTH) return NO;
+	if (*offset >= reader->length) return NO;
+	
+	uint8_t tag = reader->bytes[(*offset)++];
+	uint64_t value = 0;
+	
+	switch (tag)
+	{
+		case YDBBinaryTag_Nil   :
+		case YDBBinaryTag_Null  :
+		case YDBBinaryTag_False :
+		case YDBBinaryTag_True  :
+			return YES;
+		
+		case YDBBinaryTag_Int    :
+		case YDBBinaryTag_UInt   :
+		case YDBBinaryTag_String :
+			return ydb_binary_read_varint(reader, offset, &value);
+		
+		case YDBBinaryTag_Double :
+		case YDBBinaryTag_Date   :
+		{
+			double d;
+			return ydb_binary_read_double(reader, offset, &d);
+		}
+		case YDBBinaryTag_Data    :
+		case YDBBinaryTag_Archive :
+		{
+			const uint8_t *bytes;
+			size_t length;
+			return ydb_binary_read_bytes(reader, offset, &bytes, &length);
+		}
+		case YDBBinaryTag_Array :
+		case YDBBinaryTag_Set   :
+		case YDBBinaryTag_Dictionary :
+		{
+			if (!ydb_binary_read_varint(reader, offset, &value)) return NO;
+			
+			uint64_t count = (tag == YDBBinaryTag_Dictionary) ? (value * 2) : value;
+			for (uint64_t i = 0; i < count; i++)
+			{
+				if (!ydb_binary_skip_value(reader, offset, depth + 1)) return NO;
+			}
+			return YES;
+		}
+		case YDBBinaryTag_Object :
+		{
+			if (!ydb_binary_read_varint(reader, offset, &value)) return NO; // class name
+			
+			uint32_t valuesLength = 0;
+			if (!ydb_binary_read_uint32(reader, offset, &valuesLength)) return NO;
+			if (valuesLength > (reader->length - *offset)) return NO;
+			
+			*offset += valuesLength;
+			
+			uint64_t fieldCount = 0;
+			if (!ydb_binary_read_varint(reader, offset, &fieldCount)) return NO;
+			
+			for (uint64_t i = 0; i < fieldCount; i++)
+			{
+				if (!ydb_binary_read_varint(reader, offset, &value)) return NO; // key index
+				if (!ydb_binary_read_varint(reader, offset, &value)) return NO; // value offset
+			}
+			return YES;
+		}
+		default:
+			return NO;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Encoder
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseBinaryEncoder
+{
+	NSMutableData *body;
+	
+	NSMutableDictionary<NSString *, NSNumber *> *stringIndexes;
+	NSMutableArray<NSString *> *strings;
+	
+	NSMutableData *fieldTable; // offset table of the object currently being encoded
+	NSUInteger fieldCount;
+	NSUInteger valuesOffset;
+	
+	NSUInteger depth;
+}
+
+- (instancetype)initInternal
+{
+	if ((self = [super init]))
+	{
+		body = [[NSMutableData alloc] initWithCapacity:256];
+		
+		stringIndexes = [[NSMutableDictionary alloc] init];
+		strings = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (uint64_t)indexForString:(NSString *)string
+{
+	NSNumber *index = stringIndexes[string];
+	if (index == nil)
+	{
+		NSString *copy = [string copy];
+		
+		index = @(strings.count);
+		stringIndexes[copy] = index;
+		[strings addObject:copy];
+	}
+	
+	return [index unsignedLongLongValue];
+}
+
+- (void)appendTag:(uint8_t)tag
+{
+	[body appendBytes:&tag length:1];
+}
+
+- (void)appendValue:(id)object
+{
+	if (object == nil)
+	{
+		[self appendTag:YDBBinaryTag_Nil];
+		return;
+	}
+	
+	if (++depth > YDB_BINARY_CODEC_MAX_DEPTH)
+	{
+		@throw [self maxDepthException];
+	}
+	
+	if ([object conformsToProtocol:@protocol(YapDatabaseBinaryCoding)])
+	{
+		[self appendObject:(id <YapDatabaseBinaryCoding>)object];
+	}
+	else if ([object isKindOfClass:[NSString class]])
+	{
+		[self appendTag:YDBBinaryTag_String];
+		ydb_binary_append_varint(body, [self indexForString:(NSString *)object]);
+	}
+	else if ([object isKindOfClass:[NSNumber class]])
+	{
+		[self appendNumber:(NSNumber *)object];
+	}
+	else if ([object isKindOfClass:[NSData class]])
+	{
+		NSData *data = (NSData *)object;
+		
+		[self appendTag:YDBBinaryTag_Data];
+		ydb_binary_append_varint(body, data.length);
+		[body appendData:data];
+	}
+	else if ([object isKindOfClass:[NSDate class]])
+	{
+		[self appendTag:YDBBinaryTag_Date];
+		ydb_binary_append_double(body, [(NSDate *)object timeIntervalSinceReferenceDate]);
+	}
+	else if ([object isKindOfClass:[NSNull class]])
+	{
+		[self appendTag:YDBBinaryTag_Null];
+	}
+	else if ([object isKindOfClass:[NSArray class]] || [object isKindOfClass:[NSSet class]])
+	{
+		BOOL isArray = [object isKindOfClass:[NSArray class]];
+		
+		[self appendTag:(isArray ? YDBBinaryTag_Array : YDBBinaryTag_Set)];
+		ydb_binary_append_varint(body, [(NSArray *)object count]);
+		
+		for (id value in (id <NSFastEnumeration>)object)
+		{
+			[self appendValue:value];
+		}
+	}
+	else if ([object isKindOfClass:[NSDictionary class]])
+	{
+		NSDictionary *dict = (NSDictionary *)object;
+		
+		[self appendTag:YDBBinaryTag_Dictionary];
+		ydb_binary_append_varint(body, dict.count);
+		
+		[dict enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL __unused *stop) {
+			
+			[self appendValue:key];
+			[self appendValue:value];
+		}];
+	}
+	else if ([object conformsToProtocol:@protocol(NSCoding)])
+	{
+		NSData *archive = [NSKeyedArchiver archivedDataWithRootObject:object];
+		
+		[self appendTag:YDBBinaryTag_Archive];
+		ydb_binary_append_varint(body, archive.length);
+		[body appendData:archive];
+	}
+	else
+	{
+		@throw [self unsupportedObjectException:object];
+	}
+	
+	depth--;
+}
+
+- (void)appendObject:(id <YapDatabaseBinaryCoding>)object
+{
+	[self appendTag:YDBBinaryTag_Object];
+	ydb_binary_append_varint(body, [self indexForString:NSStringFromClass([object class])]);
+	
+	// The values length is patched once the fields have been encoded
+	
+	NSUInteger lengthOffset = body.length;
+	uint32_t valuesLength = 0;
+	[body appendBytes:&valuesLength length:sizeof(valuesLength)];
+	
+	// Objects may be nested, so save the state of the parent object
+	
+	NSMutableData *parentFieldTable = fieldTable;
+	NSUInteger parentFieldCount = fieldCount;
+	NSUInteger parentValuesOffset = valuesOffset;
+	
+	fieldTable = [[NSMutableData alloc] initWithCapacity:32];
+	fieldCount = 0;
+	valuesOffset = body.length;
+	
+	[object encodeWithBinaryEncoder:self];
+	
+	if ((body.length - valuesOffset) > UINT32_MAX)
+	{
+		@throw [self maxLengthException];
+	}
+	
+	valuesLength = CFSwapInt32HostToLittle((uint32_t)(body.length - valuesOffset));
+	[body replaceBytesInRange:NSMakeRange(lengthOffset, sizeof(valuesLength)) withBytes:&valuesLength];
+	
+	ydb_binary_append_varint(body, fieldCount);
+	[body appendData:fieldTable];
+	
+	fieldTable = parentFieldTable;
+	fieldCount = parentFieldCount;
+	valuesOffset = parentValuesOffset;
+}
+
+- (void)appendNumber:(NSNumber *)number
+{
+	CFNumberRef cfNumber = (__bridge CFNumberRef)number;
+	
+	if (cfNumber == (CFNumberRef)kCFBooleanTrue)
+	{
+		[self appendTag:YDBBinaryTag_True];
+	}
+	else if (cfNumber == (CFNumberRef)kCFBooleanFalse)
+	{
+		[self appendTag:YDBBinaryTag_False];
+	}
+	else if (CFNumberIsFloatType(cfNumber))
+	{
+		[self appendTag:YDBBinaryTag_Double];
+		ydb_binary_append_double(body, [number doubleValue]);
+	}
+	else
+	{
+		const char *type = [number objCType];
+		BOOL isUnsigned = (type[0] == 'Q' || type[0] == 'L');
+		
+		if (isUnsigned && [number unsignedLongLongValue] > INT64_MAX)
+		{
+			[self appendTag:YDBBinaryTag_UInt];
+			ydb_binary_append_varint(body, [number unsignedLongLongValue]);
+		}
+		else
+		{
+			[self appendTag:YDBBinaryTag_Int];
+			ydb_binary_append_varint(body, ydb_zigzag_encode([number longLongValue]));
+		}
+	}
+}
+
+/**
+ * Adds an entry to the offset table, for the value that's about to be appended.
+**/
+- (void)appendKey:(NSString *)key
+{
+	ydb_binary_append_varint(fieldTable, [self indexForString:key]);
+	ydb_binary_append_varint(fieldTable, body.length - valuesOffset);
+	fieldCount++;
+}
+
+- (void)encodeObject:(id)object forKey:(NSString *)key
+{
+	[self appendKey:key];
+	[self appendValue:object];
+}
+
+- (void)encodeBool:(BOOL)value forKey:(NSString *)key
+{
+	[self appendKey:key];
+	[self appendTag:(value ? YDBBinaryTag_True : YDBBinaryTag_False)];
+}
+
+- (void)encodeInt64:(int64_t)value forKey:(NSString *)key
+{
+	[self appendKey:key];
+	[self appendTag:YDBBinaryTag_Int];
+	ydb_binary_append_varint(body, ydb_zigzag_encode(value));
+}
+
+- (void)encodeInteger:(NSInteger)value forKey:(NSString *)key
+{
+	[self encodeInt64:(int64_t)value forKey:key];
+}
+
+- (void)encodeDouble:(double)value forKey:(NSString *)key
+{
+	[self appendKey:key];
+	[self appendTag:YDBBinaryTag_Double];
+	ydb_binary_append_double(body, value);
+}
+
+/**
+ * Assembles the header, string table & body.
+**/
+- (NSData *)finish
+{
+	NSMutableData *result = [[NSMutableData alloc] initWithCapacity:(body.length + (strings.count * 16) + 16)];
+	
+	[result appendBytes:YDBBinaryCodecHeader length:YDB_BINARY_CODEC_HEADER_LENGTH];
+	
+	ydb_binary_append_varint(result, strings.count);
+	for (NSString *string in strings)
+	{
+		const char *utf8 = [string UTF8String];
+		NSUInteger utf8Length = [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+		
+		ydb_binary_append_varint(result, utf8Length);
+		[result appendBytes:utf8 length:utf8Length];
+	}
+	
+	[result appendData:body];
+	return result;
+}
+
+- (NSException *)maxDepthException
+{
+	NSString *reason = [NSString stringWithFormat:
+	  @"YapDatabaseBinaryCodec: Object graph exceeds the maximum depth (%d).", YDB_BINARY_CODEC_MAX_DEPTH];
+	
+	NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
+	  @"The binary codec doesn't preserve object identity, so the object graph must not contain cycles." };
+	
+	return [NSException exceptionWithName:@"YapDatabaseException" reason:reason userInfo:userInfo];
+}
+
+- (NSException *)maxLengthException
+{
+	NSString *reason = @"YapDatabaseBinaryCodec: Encoded object exceeds the maximum length (4 GB).";
+	
+	NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
+	  @"Large blobs of data should be stored outside of the object (e.g. as separate files)." };
+	
+	return [NSException exceptionWithName:@"YapDatabaseException" reason:reason userInfo:userInfo];
+}
+
+- (NSException *)unsupportedObjectException:(id)object
+{
+	NSString *reason = [NSString stringWithFormat:
+	  @"YapDatabaseBinaryCodec: Unable to encode object of class %@.", NSStringFromClass([object class])];
+	
+	NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
+	  @"The class must adopt either the YapDatabaseBinaryCoding or NSCoding protocol." };
+	
+	return [NSException exceptionWithName:@"YapDatabaseException" reason:reason userInfo:userInfo];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Decoder
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseBinaryDecoder
+{
+@public
+	const ydb_binary_reader *reader; // NULL once decoding of the object has completed
+	
+	ydb_binary_field *fields;
+	NSUInteger fieldCount;
+	
+	NSUInteger depth;
+}
+
+- (instancetype)initInternal
+{
+	return [super init];
+}
+
+- (void)dealloc
+{
+	if (fields) {
+		free(fields);
+	}
+}
+
+/**
+ * Returns the offset of the value for the given key, or NO if there's no such field.
+**/
+- (BOOL)getOffset:(size_t *)offsetPtr forKey:(NSString *)key
+{
+	if (reader == NULL)
+	{
+		YDBLogWarn(@"YapDatabaseBinaryDecoder: Fields can only be decoded within initWithBinaryDecoder:");
+		return NO;
+	}
+	
+	const char *utf8 = [key UTF8String];
+	size_t utf8Length = strlen(utf8);
+	
+	for (NSUInteger i = 0; i < fieldCount; i++)
+	{
+		if (ydb_binary_string_equals(reader, fields[i].keyIndex, utf8, utf8Length))
+		{
+			*offsetPtr = fields[i].offset;
+			return YES;
+		}
+	}
+	
+	return NO;
+}
+
+- (BOOL)containsValueForKey:(NSString *)key
+{
+	size_t offset = 0;
+	return [self getOffset:&offset forKey:key];
+}
+
+- (id)decodeObjectForKey:(NSString *)key
+{
+	size_t offset = 0;
+	if (![self getOffset:&offset forKey:key]) return nil;
+	
+	return ydb_binary_read_value(reader, &offset, depth + 1);
+}
+
+- (id)decodeObjectOfClass:(Class)aClass forKey:(NSString *)key
+{
+	id object = [self decodeObjectForKey:key];
+	
+	return [object isKindOfClass:aClass] ? object : nil;
+}
+
+/**
+ * Decodes a scalar field (bool, int or double), without creating an NSNumber.
+**/
+- (BOOL)decodeScalarForKey:(NSString *)key int64:(int64_t *)intPtr double:(double *)doublePtr
+{
+	size_t offset = 0;
+	if (![self getOffset:&offset forKey:key]) return NO;
+	
+	uint8_t tag = reader->bytes[offset++];
+	uint64_t value = 0;
+	double d = 0.0;
+	
+	switch (tag)
+	{
+		case YDBBinaryTag_False :
+			*intPtr = 0; *doublePtr = 0.0;
+			return YES;
+		case YDBBinaryTag_True :
+			*intPtr = 1; *doublePtr = 1.0;
+			return YES;
+		case YDBBinaryTag_Int :
+			if (!ydb_binary_read_varint(reader, &offset, &value)) return NO;
+			*intPtr = ydb_zigzag_decode(value);
+			*doublePtr = (double)*intPtr;
+			return YES;
+		case YDBBinaryTag_UInt :
+			if (!ydb_binary_read_varint(reader, &offset, &value)) return NO;
+			*intPtr = (int64_t)value;
+			*doublePtr = (double)value;
+			return YES;
+		case YDBBinaryTag_Double :
+			if (!ydb_binary_read_double(reader, &offset, &d)) return NO;
+			*intPtr = (int64_t)d;
+			*doublePtr = d;
+			return YES;
+		default :
+			return NO;
+	}
+}
+
+- (BOOL)decodeBoolForKey:(NSString *)key
+{
+	int64_t i = 0;
+	double d = 0.0;
+	
+	return [self decodeScalarForKey:key int64:&i double:&d] ? (d != 0.0) : NO;
+}
+
+- (int64_t)decodeInt64ForKey:(NSString *)key
+{
+	int64_t i = 0;
+	double d = 0.0;
+	
+	return [self decodeScalarForKey:key int64:&i double:&d] ? i : 0;
+}
+
+- (NSInteger)decodeIntegerForKey:(NSString *)key
+{
+	return (NSInteger)[self decodeInt64ForKey:key];
+}
+
+- (double)decodeDoubleForKey:(NSString *)key
+{
+	int64_t i = 0;
+	double d = 0.0;
+	
+	return [self decodeScalarForKey:key int64:&i double:&d] ? d : 0.0;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Decoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Reads the offset table of an object (the tag has already been read).
+ * On success, the offset points to the end of the object.
+ *
+ * The returned fields must be freed.
+**/
+static ydb_binary_field* ydb_binary_read_fields(const ydb_binary_reader *reader, size_t *offset,
+                                                NSString **classNamePtr, NSUInteger *countPtr)
+{
+	NSString *className = ydb_binary_read_string(reader, offset);
+	if (className == nil) return NULL;
+	
+	uint32_t valuesLength = 0;
+	if (!ydb_binary_read_uint32(reader, offset, &valuesLength)) return NULL;
+	if (valuesLength > (reader->length - *offset)) return NULL;
+	
+	size_t valuesOffset = *offset;
+	*offset += valuesLength;
+	
+	// Every field takes at least 2 bytes
+	
+	uint64_t count = 0;
+	if (!ydb_binary_read_varint(reader, offset, &count)) return NULL;
+	if (count > ((reader->length - *offset) / 2)) return NULL;
+	
+	ydb_binary_field *fields = malloc(MAX((size_t)count, 1) * sizeof(ydb_binary_field));
+	
+	for (uint64_t i = 0; i < count; i++)
+	{
+		uint64_t keyIndex = 0;
+		uint64_t valueOffset = 0;
+		
+		if (!ydb_binary_read_varint(reader, offset, &keyIndex)    || keyIndex >= reader->stringCount ||
+		    !ydb_binary_read_varint(reader, offset, &valueOffset) || valueOffset >= valuesLength)
+		{
+			free(fields);
+			return NULL;
+		}
+		
+		fields[i].keyIndex = (uint32_t)keyIndex;
+		fields[i].offset = (uint32_t)(valuesOffset + valueOffset);
+	}
+	
+	*classNamePtr = className;
+	*countPtr = (NSUInteger)count;
+	return fields;
+}
+
+/**
+ * Decodes an object (the tag has already been read).
+**/
+static id ydb_binary_read_object(const ydb_binary_reader *reader, size_t *offset, NSUInteger depth)
+{
+	NSString *className = nil;
+	NSUInteger count = 0;
+	
+	ydb_binary_field *fields = ydb_binary_read_fields(reader, offset, &className, &count);
+	if (fields == NULL) return nil;
+	
+	Class cls = NSClassFromString(className);
+	if (cls == Nil || ![cls conformsToProtocol:@protocol(YapDatabaseBinaryCoding)])
+	{
+		YDBLogWarn(@"YapDatabaseBinaryCodec: Unable to decode object of class %@", className);
+		
+		free(fields);
+		return nil;
+	}
+	
+	YapDatabaseBinaryDecoder *decoder = [[YapDatabaseBinaryDecoder alloc] initInternal];
+	decoder->reader = reader;
+	decoder->fields = fields;
+	decoder->fieldCount = count;
+	decoder->depth = depth;
+	
+	id object = [(id <YapDatabaseBinaryCoding>)[cls alloc] initWithBinaryDecoder:decoder];
+	
+	// The bytes are only valid during the decode operation
+	decoder->reader = NULL;
+	
+	return object;
+}
+
+static id ydb_binary_read_value(const ydb_binary_reader *reader, size_t *offset, NSUInteger depth)
+{
+	if (depth > YDB_BINARY_CODEC_MAX_DEPTH) return nil;
+	if (*offset >= reader->length) return nil;
+	
+	uint8_t tag = reader->bytes[(*offset)++];
+	uint64_t value = 0;
+	
+	switch (tag)
+	{
+		case YDBBinaryTag_Nil   : return nil;
+		case YDBBinaryTag_Null  : return [NSNull null];
+		case YDBBinaryTag_False : return @NO;
+		case YDBBinaryTag_True  : return @YES;
+		
+		case YDBBinaryTag_Int :
+		{
+			if (!ydb_binary_read_varint(reader, offset, &value)) return nil;
+			return @(ydb_zigzag_decode(value));
+		}
+		case YDBBinaryTag_UInt :
+		{
+			if (!ydb_binary_read_varint(reader, offset, &value)) return nil;
+			return @(value);
+		}
+		case YDBBinaryTag_Double :
+		{
+			double d = 0.0;
+			if (!ydb_binary_read_double(reader, offset, &d)) return nil;
+			return @(d);
+		}
+		case YDBBinaryTag_Date :
+		{
+			double d = 0.0;
+			if (!ydb_binary_read_double(reader, offset, &d)) return nil;
+			return [[NSDate alloc] initWithTimeIntervalSinceReferenceDate:d];
+		}
+		case YDBBinaryTag_String :
+		{
+			return ydb_binary_read_string(reader, offset);
+		}
+		case YDBBinaryTag_Data :
+		case YDBBinaryTag_Archive :
+		{
+			const uint8_t *bytes = NULL;
+			size_t length = 0;
+			if (!ydb_binary_read_bytes(reader, offset, &bytes, &length)) return nil;
+			
+			NSData *data = [[NSData alloc] initWithBytes:bytes length:length];
+			
+			if (tag == YDBBinaryTag_Data)
+				return data;
+			else
+				return [NSKeyedUnarchiver unarchiveObjectWithData:data];
+		}
+		case YDBBinaryTag_Array :
+		case YDBBinaryTag_Set   :
+		case YDBBinaryTag_Dictionary :
+		{
+			if (!ydb_binary_read_varint(reader, offset, &value)) return nil;
+			
+			// Every value is at least 1 byte
+			if (value > (reader->length - *offset)) return nil;
+			
+			NSUInteger count = (NSUInteger)value;
+			NSUInteger objectsCount = (tag == YDBBinaryTag_Dictionary) ? (count * 2) : count;
+			
+			__strong id *objects = (__strong id *)calloc(MAX(objectsCount, 1), sizeof(id));
+			NSUInteger decodedCount = 0;
+			BOOL failed = NO;
+			
+			for (NSUInteger i = 0; i < objectsCount && !failed; i++)
+			{
+				size_t prevOffset = *offset;
+				objects[i] = ydb_binary_read_value(reader, offset, depth + 1);
+				
+				// A nil value (e.g. an object whose class no longer exists) is dropped.
+				// But a malformed value fails the decode.
+				if (objects[i] == nil)
+				{
+					if (ydb_binary_skip_value(reader, &prevOffset, depth + 1))
+						*offset = prevOffset;
+					else
+						failed = YES;
+				}
+				decodedCount = i + 1;
+			}
+			
+			id result = nil;
+			if (!failed)
+			{
+				if (tag == YDBBinaryTag_Dictionary)
+				{
+					NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithCapacity:count];
+					for (NSUInteger i = 0; i < count; i++)
+					{
+						id key = objects[i * 2];
+						id obj = objects[(i * 2) + 1];
+						
+						if (key && obj) {
+							dict[key] = obj;
+						}
+					}
+					result = [dict copy];
+				}
+				else
+				{
+					// Compact (to drop any nil values)
+					NSUInteger compactCount = 0;
+					for (NSUInteger i = 0; i < count; i++)
+					{
+						if (objects[i]) {
+							objects[compactCount++] = objects[i];
+						}
+					}
+					
+					if (tag == YDBBinaryTag_Array)
+						result = [[NSArray alloc] initWithObjects:objects count:compactCount];
+					else
+						result = [[NSSet alloc] initWithObjects:objects count:compactCount];
+				}
+			}
+			
+			for (NSUInteger i = 0; i < decodedCount; i++) {
+				objects[i] = nil;
+			}
+			free(objects);
+			
+			return result;
+		}
+		case YDBBinaryTag_Object :
+		{
+			return ydb_binary_read_object(reader, offset, depth);
+		}
+		default:
+			return nil;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Codec
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseBinaryCodec
+
++ (YapDatabaseSerializer)serializer
+{
+	return ^ NSData* (NSString __unused *collection, NSString __unused *key, id object){
+		return [YapDatabaseBinaryCodec dataWithObject:object];
+	};
+}
+
++ (YapDatabaseDeserializer)deserializer
+{
+	return [YapDatabase deserializerWithBytesDeserializer:
+	    ^ id (NSString __unused *collection, NSString __unused *key, const void *bytes, size_t length) {
+		
+		return [YapDatabaseBinaryCodec objectWithBytes:bytes length:length];
+	}];
+}
+
++ (NSData *)dataWithObject:(id)object
+{
+	YapDatabaseBinaryEncoder *encoder = [[YapDatabaseBinaryEncoder alloc] initInternal];
+	[encoder appendValue:object];
+	
+	return [encoder finish];
+}
+
++ (id)objectWithData:(NSData *)data
+{
+	return [self objectWithBytes:data.bytes length:data.length];
+}
+
++ (BOOL)isBinaryCodecBytes:(const void *)bytes length:(size_t)length
+{
+	if (bytes == NULL || length < YDB_BINARY_CODEC_HEADER_LENGTH) return NO;
+	
+	return (memcmp(bytes, YDBBinaryCodecHeader, YDB_BINARY_CODEC_HEADER_LENGTH) == 0);
+}
+
++ (BOOL)isBinaryCodecData:(NSData *)data
+{
+	return [self isBinaryCodecBytes:data.bytes length:data.length];
+}
+
+/**
+ * Validates the header & string table, and prepares the reader.
+ * On success, the offset points to the root value, and the reader's stringOffsets must be freed.
+ *
+ * If a strings array is requested, every string is created up front.
+**/
++ (BOOL)openReader:(ydb_binary_reader *)reader
+            offset:(size_t *)offsetPtr
+         withBytes:(const void *)bytes
+            length:(size_t)length
+           strings:(NSMutableArray<NSString *> **)stringsPtr
+{
+	if (length > UINT32_MAX)
+	{
+		YDBLogError(@"YapDatabaseBinaryCodec: Data too large to decode (%lu bytes)", (unsigned long)length);
+		return NO;
+	}
+	
+	*reader = (ydb_binary_reader){ (const uint8_t *)bytes, length, NULL, 0, nil };
+	size_t offset = YDB_BINARY_CODEC_HEADER_LENGTH;
+	
+	// Every string takes at least 1 byte
+	
+	uint64_t stringCount = 0;
+	if (!ydb_binary_read_varint(reader, &offset, &stringCount) || stringCount > (length - offset))
+	{
+		YDBLogWarn(@"YapDatabaseBinaryCodec: Malformed data (string table)");
+		return NO;
+	}
+	
+	uint32_t *stringOffsets = malloc(MAX((size_t)stringCount, 1) * sizeof(uint32_t));
+	NSMutableArray<NSString *> *strings = nil;
+	
+	if (stringsPtr) {
+		strings = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)stringCount];
+	}
+	
+	for (uint64_t i = 0; i < stringCount; i++)
+	{
+		stringOffsets[i] = (uint32_t)offset;
+		
+		const uint8_t *utf8 = NULL;
+		size_t utf8Length = 0;
+		
+		BOOL valid = ydb_binary_read_bytes(reader, &offset, &utf8, &utf8Length);
+		if (valid && strings)
+		{
+			NSString *string = [[NSString alloc] initWithBytes:utf8 length:utf8Length encoding:NSUTF8StringEncoding];
+			if (string)
+				[strings addObject:string];
+			else
+				valid = NO;
+		}
+		
+		if (!valid)
+		{
+			YDBLogWarn(@"YapDatabaseBinaryCodec: Malformed data (string table)");
+			
+			free(stringOffsets);
+			return NO;
+		}
+	}
+	
+	reader->stringOffsets = stringOffsets;
+	reader->stringCount = (NSUInteger)stringCount;
+	
+	if (stringsPtr) *stringsPtr = strings;
+	*offsetPtr = offset;
+	return YES;
+}
+
++ (id)objectWithBytes:(const void *)bytes length:(size_t)length
+{
+	if (bytes == NULL || length == 0) return nil;
+	
+	if (![self isBinaryCodecBytes:bytes length:length])
+	{
+		// Legacy row (e.g. from the defaultSerializer)
+		
+		NSData *data = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+		return [NSKeyedUnarchiver unarchiveObjectWithData:data];
+	}
+	
+	ydb_binary_reader reader;
+	size_t offset = 0;
+	NSMutableArray<NSString *> *strings = nil;
+	
+	if (![self openReader:&reader offset:&offset withBytes:bytes length:length strings:&strings]) return nil;
+	
+	reader.strings = strings;
+	
+	id object = ydb_binary_read_value(&reader, &offset, 0);
+	
+	free((void *)reader.stringOffsets);
+	return object;
+}
+
++ (BOOL)getValue:(id *)valuePtr forField:(NSString *)field inBytes:(const void *)bytes length:(size_t)length
+{
+	*valuePtr = nil;
+	
+	if (![self isBinaryCodecBytes:bytes length:length]) return NO;
+	
+	ydb_binary_reader reader;
+	size_t offset = 0;
+	
+	if (![self openReader:&reader offset:&offset withBytes:bytes length:length strings:NULL]) return NO;
+	
+	// Find the field name in the string table.
+	// If it's not there, then the row doesn't have the field.
+	
+	const char *utf8 = [field UTF8String];
+	size_t utf8Length = strlen(utf8);
+	
+	NSUInteger fieldIndex = NSNotFound;
+	for (NSUInteger i = 0; i < reader.stringCount; i++)
+	{
+		if (ydb_binary_string_equals(&reader, i, utf8, utf8Length))
+		{
+			fieldIndex = i;
+			break;
+		}
+	}
+	
+	BOOL result = YES;
+	
+	if ((fieldIndex != NSNotFound) && (offset < length))
+	{
+		uint8_t tag = reader.bytes[offset++];
+		
+		if (tag == YDBBinaryTag_Object)
+		{
+			NSString *className = nil;
+			NSUInteger count = 0;
+			
+			ydb_binary_field *fields = ydb_binary_read_fields(&reader, &offset, &className, &count);
+			if (fields)
+			{
+				for (NSUInteger i = 0; i < count; i++)
+				{
+					if (fields[i].keyIndex == fieldIndex)
+					{
+						size_t valueOffset = fields[i].offset;
+						*valuePtr = ydb_binary_read_value(&reader, &valueOffset, 1);
+						break;
+					}
+				}
+				free(fields);
+			}
+			else
+			{
+				result = NO;
+			}
+		}
+		else if (tag == YDBBinaryTag_Dictionary)
+		{
+			uint64_t count = 0;
+			result = ydb_binary_read_varint(&reader, &offset, &count);
+			
+			for (uint64_t i = 0; result && i < count; i++)
+			{
+				uint64_t keyIndex = NSNotFound;
+				
+				if ((offset < length) && (reader.bytes[offset] == YDBBinaryTag_String))
+				{
+					offset++;
+					result = ydb_binary_read_varint(&reader, &offset, &keyIndex);
+				}
+				else
+				{
+					result = ydb_binary_skip_value(&reader, &offset, 1);
+				}
+				
+				if (result && (keyIndex == fieldIndex))
+				{
+					*valuePtr = ydb_binary_read_value(&reader, &offset, 1);
+					break;
+				}
+				else if (result)
+				{
+					result = ydb_binary_skip_value(&reader, &offset, 1);
+				}
+			}
+		}
+	}
+	
+	free((void *)reader.stringOffsets);
+	return result;
+}
+
++ (BOOL)getValue:(id *)valuePtr forField:(NSString *)field inData:(NSData *)data
+{
+	return [self getValue:valuePtr forField:field inBytes:data.bytes length:data.length];
+}
+
+@end
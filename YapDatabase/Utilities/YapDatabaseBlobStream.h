@@ -0,0 +1,116 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * Blob streams provide incremental access to the serialized object of a single row (via sqlite3_blob).
+ * This allows you to hash, upload or decode a large value progressively,
+ * without ever holding the full value in memory.
+ *
+ * A stream may only be used within the transaction that opened it (and on the same thread/queue).
+ * Any open streams are closed automatically when the transaction completes.
+ *
+ * If the row is modified while a read stream is open (e.g. via setObject:forKey:inCollection:),
+ * the stream is invalidated by sqlite, and subsequent reads fail.
+**/
+@interface YapDatabaseBlobReadStream : NSObject
+
+/**
+ * The length of the serialized object (in bytes).
+**/
+@property (nonatomic, assign, readonly) NSUInteger length;
+
+/**
+ * The number of bytes that have been read so far.
+**/
+@property (nonatomic, assign, readonly) NSUInteger offset;
+
+/**
+ * Reads up to maxLength bytes into the given buffer.
+ *
+ * @return
+ *   The number of bytes read, zero if the end of the stream was reached,
+ *   or -1 if an error occurred (or the stream is closed).
+**/
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)maxLength;
+
+/**
+ * Reads up to maxLength bytes.
+ *
+ * @return
+ *   The bytes read, an empty data if the end of the stream was reached,
+ *   or nil if an error occurred (or the stream is closed).
+**/
+- (nullable NSData *)readDataOfMaxLength:(NSUInteger)maxLength;
+
+/**
+ * Releases the underlying sqlite3_blob handle.
+ * It's safe to invoke this method multiple times.
+**/
+- (void)close;
+
+@end
+
+/**
+ * A write stream is opened with the exact length of the serialized object that's going to be written,
+ * as sqlite reserves the space for the blob upfront (via zeroblob), and then fills it in place.
+ *
+ * The object isn't considered to be changed until the stream is closed.
+ * At that point the caches are updated, and the change is included in the changeset.
+ *
+ * If any extensions are registered, they need the object in order to process the change.
+ * So in this case, the object is deserialized (once) when the stream is closed.
+ * All the usual extension hooks are invoked at this point (including the "will" hooks,
+ * which are therefore invoked after the serialized object has been written).
+ *
+ * If the stream is closed before `length` bytes have been written, the row is removed,
+ * as its value would otherwise be incomplete.
+ * If the transaction is rolled back, the row is restored to its previous state (as with any other change).
+**/
+@interface YapDatabaseBlobWriteStream : NSObject
+
+/**
+ * The length of the serialized object (in bytes), as given when the stream was opened.
+**/
+@property (nonatomic, assign, readonly) NSUInteger length;
+
+/**
+ * The number of bytes that have been written so far.
+**/
+@property (nonatomic, assign, readonly) NSUInteger offset;
+
+/**
+ * Writes the given bytes (appending them to the previously written bytes).
+ *
+ * @return
+ *   The number of bytes written (which may be less than the given length if it would exceed the reserved length),
+ *   or -1 if an error occurred (or the stream is closed).
+**/
+- (NSInteger)write:(const uint8_t *)buffer maxLength:(NSUInteger)length;
+
+/**
+ * Writes the given data (appending it to the previously written bytes).
+ *
+ * @return
+ *   YES if all the data was written.
+ *   NO if an error occurred, the stream is closed, or the data would exceed the reserved length.
+**/
+- (BOOL)writeData:(NSData *)data;
+
+/**
+ * Finishes the write, and releases the underlying sqlite3_blob handle.
+ * It's safe to invoke this method multiple times.
+**/
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,249 @@
+#import "YapDatabaseBlobStream.h"
+#import "YapDatabaseBlobStreamPrivate.h"
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+@implementation YapDatabaseBlobReadStream
+{
+	sqlite3_blob *blob;
+	NSUInteger baseOffset;
+	
+	NSData *data;
+	
+	BOOL closed;
+}
+
+@synthesize length = length;
+@synthesize offset = offset;
+
+- (instancetype)initWithTransaction:(YapDatabaseReadTransaction *)inTransaction
+                               blob:(sqlite3_blob *)inBlob
+                         baseOffset:(NSUInteger)inBaseOffset
+{
+	if ((self = [super init]))
+	{
+		transaction = inTransaction;
+		
+		blob = inBlob;
+		baseOffset = inBaseOffset;
+		
+		length = (NSUInteger)sqlite3_blob_bytes(blob) - baseOffset;
+	}
+	return self;
+}
+
+- (instancetype)initWithTransaction:(YapDatabaseReadTransaction *)inTransaction
+                               data:(NSData *)inData
+{
+	if ((self = [super init]))
+	{
+		transaction = inTransaction;
+		
+		data = inData;
+		length = data.length;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (blob) {
+		sqlite3_blob_close(blob);
+	}
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)maxLength
+{
+	if (closed) return -1;
+	
+	NSUInteger count = MIN(maxLength, length - offset);
+	if (count == 0) return 0;
+	
+	if (blob)
+	{
+		int status = sqlite3_blob_read(blob, buffer, (int)count, (int)(baseOffset + offset));
+		if (status != SQLITE_OK)
+		{
+			// SQLITE_ABORT : The row was modified since the stream was opened.
+			
+			YDBLogError(@"Error reading blob: %d %s", status, sqlite3_errstr(status));
+			return -1;
+		}
+	}
+	else
+	{
+		[data getBytes:buffer range:NSMakeRange(offset, count)];
+	}
+	
+	offset += count;
+	return (NSInteger)count;
+}
+
+- (NSData *)readDataOfMaxLength:(NSUInteger)maxLength
+{
+	if (closed) return nil;
+	
+	NSUInteger count = MIN(maxLength, length - offset);
+	
+	if (data)
+	{
+		// The data is either memory mapped, or already in memory.
+		// Either way, a subdata doesn't need to copy the bytes.
+		
+		NSData *result = [data subdataWithRange:NSMakeRange(offset, count)];
+		offset += count;
+		
+		return result;
+	}
+	
+	NSMutableData *result = [NSMutableData dataWithLength:count];
+	
+	NSInteger read = [self read:(uint8_t *)result.mutableBytes maxLength:count];
+	if (read < 0) return nil;
+	
+	return result;
+}
+
+- (void)invalidate
+{
+	if (blob)
+	{
+		sqlite3_blob_close(blob);
+		blob = NULL;
+	}
+	
+	data = nil;
+	closed = YES;
+	transaction = nil;
+}
+
+- (void)close
+{
+	if (closed) return;
+	
+	__unsafe_unretained YapDatabaseReadTransaction *_transaction = transaction;
+	
+	[self invalidate];
+	[_transaction blobStreamDidClose:self];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseBlobWriteStream
+{
+	sqlite3_blob *blob;
+	NSUInteger baseOffset;
+	
+	BOOL closed;
+}
+
+@synthesize length = length;
+@synthesize offset = offset;
+
+- (instancetype)initWithTransaction:(YapDatabaseReadWriteTransaction *)inTransaction
+                               blob:(sqlite3_blob *)inBlob
+                         baseOffset:(NSUInteger)inBaseOffset
+                             length:(NSUInteger)inLength
+                      collectionKey:(YapCollectionKey *)inCollectionKey
+                              rowid:(int64_t)inRowid
+                           inserted:(BOOL)inInserted
+{
+	if ((self = [super init]))
+	{
+		transaction = inTransaction;
+		
+		blob = inBlob;
+		baseOffset = inBaseOffset;
+		length = inLength;
+		
+		collectionKey = inCollectionKey;
+		rowid = inRowid;
+		inserted = inInserted;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (blob) {
+		sqlite3_blob_close(blob);
+	}
+}
+
+- (NSInteger)write:(const uint8_t *)buffer maxLength:(NSUInteger)maxLength
+{
+	if (closed) return -1;
+	
+	NSUInteger count = MIN(maxLength, length - offset);
+	if (count == 0) return 0;
+	
+	int status = sqlite3_blob_write(blob, buffer, (int)count, (int)(baseOffset + offset));
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error writing blob: %d %s", status, sqlite3_errstr(status));
+		return -1;
+	}
+	
+	offset += count;
+	return (NSInteger)count;
+}
+
+- (BOOL)writeData:(NSData *)inData
+{
+	if (inData.length > (length - offset))
+	{
+		YDBLogWarn(@"Attempting to write past the reserved length (%lu)", (unsigned long)length);
+		return NO;
+	}
+	
+	return ([self write:(const uint8_t *)inData.bytes maxLength:inData.length] == (NSInteger)inData.length);
+}
+
+- (BOOL)isComplete
+{
+	return (offset == length);
+}
+
+- (void)invalidate
+{
+	if (blob)
+	{
+		sqlite3_blob_close(blob);
+		blob = NULL;
+	}
+	
+	closed = YES;
+	transaction = nil;
+}
+
+- (void)close
+{
+	if (closed) return;
+	
+	__unsafe_unretained YapDatabaseReadWriteTransaction *_transaction = transaction;
+	
+	[self invalidate];
+	[_transaction blobStreamDidClose:self];
+}
+
+@end
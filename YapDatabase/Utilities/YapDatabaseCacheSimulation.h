@@ -0,0 +1,151 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabaseConnection.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A cache simulation replays the key accesses of a workload trace (see YapDatabaseWorkloadTraceRecorder)
+ * against simulated object & metadata caches, in order to choose the objectCacheLimit & metadataCacheLimit
+ * of your connections from data, rather than guesswork.
+ *
+ * The LRU hit rates are computed for every count limit in a single pass (via stack distances).
+ * That is, the hit rate for a limit of N is the fraction of accesses whose key was among the N most
+ * recently used keys of the connection. The TinyLFU hit rates (see YapCacheAdmissionPolicy)
+ * aren't stack-based, so a YapCache is simulated for each count limit (still within the same pass).
+ *
+ * The simulation mirrors how a connection uses its caches:
+ * - reads are lookups (a miss inserts the value)
+ * - writes insert the new value (without counting as a lookup)
+ * - removes evict the key
+ * - commits update the caches of the other connections, according to the objectPolicy & metadataPolicy
+ * - enumerations of objects / metadata / rows look up every key of the collection that's known
+ *   (from earlier events in the trace), as the trace doesn't record which keys were enumerated
+ *
+ * The key cache (whose limit is derived from the objectCacheLimit) isn't simulated.
+**/
+
+@interface YapDatabaseCacheSimulationCurve : NSObject
+
+/**
+ * The simulated count limits, in ascending order. (Same as YapDatabaseCacheSimulation.countLimits.)
+ * The arrays below contain a value for each count limit.
+**/
+@property (nonatomic, copy, readonly) NSArray<NSNumber *> *countLimits;
+
+/**
+ * The hit rates (from 0.0 to 1.0) of an LRU cache (YapCacheAdmissionPolicyLRU, the default).
+**/
+@property (nonatomic, copy, readonly) NSArray<NSNumber *> *lruHitRates;
+
+/**
+ * The hit rates (from 0.0 to 1.0) of a YapCache using YapCacheAdmissionPolicyTinyLFU.
+**/
+@property (nonatomic, copy, readonly) NSArray<NSNumber *> *tinyLFUHitRates;
+
+/**
+ * The estimated memory (in bytes) held by an LRU cache at the end of the trace (for the largest connection).
+ *
+ * This is the sum of the serialized sizes of the cached values, as recorded in the trace.
+ * Values that were never written during the trace are assumed to have the average size of their collection.
+ * The deserialized objects are typically larger, but the relative shape of the curve is what matters.
+**/
+@property (nonatomic, copy, readonly) NSArray<NSNumber *> *memoryUsages;
+
+/**
+ * The number of lookups, and the number of distinct keys that were looked up.
+**/
+@property (nonatomic, assign, readonly) NSUInteger lookupCount;
+@property (nonatomic, assign, readonly) NSUInteger distinctKeyCount;
+
+/**
+ * The average serialized size of the values written during the trace (zero if none were written).
+**/
+@property (nonatomic, assign, readonly) NSUInteger averageValueSize;
+
+/**
+ * Returns the smallest (simulated) count limit whose LRU hit rate is at least the given hit rate.
+ * Returns zero (i.e. unlimited) if none of the simulated count limits reach it.
+**/
+- (NSUInteger)countLimitForHitRate:(double)hitRate;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseCacheSimulationResult : NSObject
+
+@property (nonatomic, assign, readonly) NSUInteger transactionCount;
+@property (nonatomic, assign, readonly) NSUInteger connectionCount;
+
+/**
+ * The curves of the object cache & metadata cache, for all collections.
+**/
+@property (nonatomic, strong, readonly) YapDatabaseCacheSimulationCurve *objectCurve;
+@property (nonatomic, strong, readonly) YapDatabaseCacheSimulationCurve *metadataCurve;
+
+/**
+ * The curves for the lookups of each collection (within the shared cache),
+ * keyed by collection hash (see -[YapDatabaseWorkloadTraceRecorder hashForCollection:]).
+ *
+ * For example, if a single collection has a poor hit rate at every limit, its values are only evicting
+ * everything else. So it may be better read via a separate connection (with objectCacheEnabled set to NO).
+**/
+@property (nonatomic, copy, readonly) NSDictionary<NSNumber *, YapDatabaseCacheSimulationCurve *> *objectCurvesByCollection;
+@property (nonatomic, copy, readonly) NSDictionary<NSNumber *, YapDatabaseCacheSimulationCurve *> *metadataCurvesByCollection;
+
+/**
+ * Returns the curves as CSV, one row per (cache, collection, count limit), with the columns:
+ * cache, collection, countLimit, lruHitRate, tinyLFUHitRate, memoryUsage
+ *
+ * The collection column is the collection hash, or "*" for the combined curve.
+**/
+- (NSString *)csvRepresentation;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseCacheSimulation : NSObject
+
+/**
+ * Loads the workload trace at the given path.
+ * Returns nil if the file couldn't be read, or isn't a (supported) workload trace.
+**/
+- (nullable instancetype)initWithPath:(NSString *)path;
+
+/**
+ * The count limits to simulate.
+ *
+ * The default value is: 10, 20, 40 (the default objectCacheLimit), 80, 160, 320, 640, 1280, 2560 & 5120.
+**/
+@property (nonatomic, copy, readwrite) NSArray<NSNumber *> *countLimits;
+
+/**
+ * How commits update the caches of the other connections. (See YapDatabaseConnection.objectPolicy.)
+ *
+ * YapDatabasePolicyContainment evicts the key, while YapDatabasePolicyShare & YapDatabasePolicyCopy
+ * update it in place. (Which the simulation models as a use of the key, if the connection had used it before.)
+ *
+ * The default value is YapDatabasePolicyContainment (same as a connection).
+**/
+@property (nonatomic, assign, readwrite) YapDatabasePolicy objectPolicy;
+@property (nonatomic, assign, readwrite) YapDatabasePolicy metadataPolicy;
+
+/**
+ * Runs the simulation (in a single pass over the trace).
+ * This method is synchronous.
+**/
+- (YapDatabaseCacheSimulationResult *)run;
+
+@end
+
+NS_ASSUME_NONNULL_END
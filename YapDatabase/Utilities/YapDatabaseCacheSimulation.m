@@ -0,0 +1,1091 @@
+#import "YapDatabaseCacheSimulation.h"
+#import "YapDatabaseWorkloadTracePrivate.h"
+#import "YapCache.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Both caches are keyed by (collection, key).
+ * Since the trace contains hashes, the cache key is a (64-bit) combination of both hashes.
+**/
+static inline uint64_t YapCacheSimulationKey(uint64_t collection, uint64_t key)
+{
+	return (collection * 1099511628211ULL) ^ key;
+}
+
+typedef NS_ENUM(NSUInteger, YapCacheSimulationKind) {
+	YapCacheSimulationKindObject   = 0,
+	YapCacheSimulationKindMetadata = 1,
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * An LRU stack (for a single cache on a single connection), which computes the stack distance of each use.
+ *
+ * Each key is stamped with the time of its last use. A Fenwick tree over the stamps counts
+ * how many keys were used more recently than a given key, which is the depth of the key within the stack.
+ * Thus a use of a key at depth D is a hit for every LRU cache with a countLimit greater than D.
+**/
+@interface YapCacheSimulationStack : NSObject
+
+/**
+ * Moves the key to the top of the stack.
+ * Returns its previous depth, or NSNotFound if it wasn't in the stack.
+**/
+- (NSUInteger)useKey:(uint64_t)key;
+
+/**
+ * Moves the key to the top of the stack, but only if it's already in the stack.
+**/
+- (void)touchKey:(uint64_t)key;
+
+- (void)removeKey:(uint64_t)key;
+- (void)removeAllKeys;
+
+/**
+ * Enumerates the keys, from the most recently used to the least recently used.
+**/
+- (void)enumerateKeysWithBlock:(void (^)(uint64_t key, BOOL *stop))block;
+
+@end
+
+@implementation YapCacheSimulationStack
+{
+	NSMutableDictionary<NSNumber *, NSNumber *> *stamps; // key -> stamp
+	
+	NSUInteger capacity;  // stamps are 1-based, so valid stamps are [1, capacity]
+	NSUInteger nextStamp;
+	
+	int32_t *tree;        // Fenwick tree (capacity + 1)
+	uint64_t *slotKeys;   // stamp -> key (capacity + 1)
+	uint8_t *slotUsed;    // stamp -> in use (capacity + 1)
+}
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		stamps = [[NSMutableDictionary alloc] init];
+		[self resizeToCapacity:1024];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	free(tree);
+	free(slotKeys);
+	free(slotUsed);
+}
+
+- (void)resizeToCapacity:(NSUInteger)newCapacity
+{
+	free(tree);
+	free(slotKeys);
+	free(slotUsed);
+	
+	capacity = newCapacity;
+	nextStamp = 1;
+	
+	tree = calloc(capacity + 1, sizeof(int32_t));
+	slotKeys = calloc(capacity + 1, sizeof(uint64_t));
+	slotUsed = calloc(capacity + 1, sizeof(uint8_t));
+}
+
+- (void)add:(int32_t)delta atStamp:(NSUInteger)stamp
+{
+	for (NSUInteger i = stamp; i <= capacity; i += (i & (~i + 1)))
+	{
+		tree[i] += delta;
+	}
+}
+
+- (NSUInteger)countThroughStamp:(NSUInteger)stamp
+{
+	int64_t sum = 0;
+	for (NSUInteger i = stamp; i > 0; i -= (i & (~i + 1)))
+	{
+		sum += tree[i];
+	}
+	
+	return (NSUInteger)sum;
+}
+
+/**
+ * Renumbers the stamps of the keys in the stack (in order) from 1,
+ * once we've run out of stamps.
+**/
+- (void)compact
+{
+	NSUInteger count = stamps.count;
+	uint64_t *keys = malloc(MAX(count, (NSUInteger)1) * sizeof(uint64_t));
+	
+	NSUInteger index = 0;
+	for (NSUInteger stamp = 1; stamp < nextStamp; stamp++)
+	{
+		if (slotUsed[stamp]) {
+			keys[index++] = slotKeys[stamp];
+		}
+	}
+	
+	[self resizeToCapacity:MAX((NSUInteger)1024, count * 2)];
+	
+	for (NSUInteger i = 0; i < index; i++)
+	{
+		[self pushKey:keys[i]];
+	}
+	
+	free(keys);
+}
+
+- (void)pushKey:(uint64_t)key
+{
+	if (nextStamp > capacity) {
+		[self compact];
+	}
+	
+	NSUInteger stamp = nextStamp++;
+	
+	slotKeys[stamp] = key;
+	slotUsed[stamp] = 1;
+	[self add:1 atStamp:stamp];
+	
+	stamps[@(key)] = @(stamp);
+}
+
+- (NSUInteger)popKey:(uint64_t)key
+{
+	NSNumber *number = @(key);
+	NSNumber *stampNumber = stamps[number];
+	
+	if (stampNumber == nil) return NSNotFound;
+	
+	NSUInteger stamp = [stampNumber unsignedIntegerValue];
+	NSUInteger depth = stamps.count - [self countThroughStamp:stamp];
+	
+	slotUsed[stamp] = 0;
+	[self add:-1 atStamp:stamp];
+	
+	[stamps removeObjectForKey:number];
+	
+	return depth;
+}
+
+- (NSUInteger)useKey:(uint64_t)key
+{
+	NSUInteger depth = [self popKey:key];
+	[self pushKey:key];
+	
+	return depth;
+}
+
+- (void)touchKey:(uint64_t)key
+{
+	if ([self popKey:key] != NSNotFound) {
+		[self pushKey:key];
+	}
+}
+
+- (void)removeKey:(uint64_t)key
+{
+	[self popKey:key];
+}
+
+- (void)removeAllKeys
+{
+	[stamps removeAllObjects];
+	[self resizeToCapacity:1024];
+}
+
+- (void)enumerateKeysWithBlock:(void (^)(uint64_t key, BOOL *stop))block
+{
+	BOOL stop = NO;
+	
+	for (NSUInteger stamp = nextStamp - 1; stamp > 0; stamp--)
+	{
+		if (slotUsed[stamp])
+		{
+			block(slotKeys[stamp], &stop);
+			if (stop) break;
+		}
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The lookups of a single cache (either for all collections, or a single collection).
+**/
+@interface YapCacheSimulationCounter : NSObject
+{
+@public
+	NSUInteger lookupCount;
+	NSUInteger *lruBuckets;   // lruBuckets[i] : lookups with a depth within [limit[i-1], limit[i])
+	NSUInteger *tinyLFUHits;  // tinyLFUHits[i] : hits of the TinyLFU cache with limit[i]
+	double *memoryUsages;     // memoryUsages[i] : bytes held by the LRU cache with limit[i] (largest connection)
+	NSMutableSet<NSNumber *> *keys;
+}
+
+- (instancetype)initWithLimitCount:(NSUInteger)limitCount;
+
+@end
+
+@implementation YapCacheSimulationCounter
+
+- (instancetype)initWithLimitCount:(NSUInteger)limitCount
+{
+	if ((self = [super init]))
+	{
+		lruBuckets = calloc(MAX(limitCount, (NSUInteger)1), sizeof(NSUInteger));
+		tinyLFUHits = calloc(MAX(limitCount, (NSUInteger)1), sizeof(NSUInteger));
+		memoryUsages = calloc(MAX(limitCount, (NSUInteger)1), sizeof(double));
+		keys = [[NSMutableSet alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	free(lruBuckets);
+	free(tinyLFUHits);
+	free(memoryUsages);
+}
+
+@end
+
+/**
+ * The simulated caches of a single (recorded) connection.
+**/
+@interface YapCacheSimulationConnection : NSObject
+{
+@public
+	YapCacheSimulationStack *stacks[2];                        // index: YapCacheSimulationKind
+	NSArray<YapCache<NSNumber *, NSNumber *> *> *tinyLFUCaches[2]; // one per count limit
+}
+@end
+
+@implementation YapCacheSimulationConnection
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseCacheSimulationCurve ()
+
+- (instancetype)initWithCountLimits:(NSArray<NSNumber *> *)countLimits
+                            counter:(YapCacheSimulationCounter *)counter
+                   averageValueSize:(NSUInteger)averageValueSize;
+
+@end
+
+@implementation YapDatabaseCacheSimulationCurve
+
+@synthesize countLimits = countLimits;
+@synthesize lruHitRates = lruHitRates;
+@synthesize tinyLFUHitRates = tinyLFUHitRates;
+@synthesize memoryUsages = memoryUsages;
+@synthesize lookupCount = lookupCount;
+@synthesize distinctKeyCount = distinctKeyCount;
+@synthesize averageValueSize = averageValueSize;
+
+- (instancetype)initWithCountLimits:(NSArray<NSNumber *> *)inCountLimits
+                            counter:(YapCacheSimulationCounter *)counter
+                   averageValueSize:(NSUInteger)inAverageValueSize
+{
+	if ((self = [super init]))
+	{
+		countLimits = [inCountLimits copy];
+		lookupCount = counter->lookupCount;
+		distinctKeyCount = counter->keys.count;
+		averageValueSize = inAverageValueSize;
+		
+		NSUInteger limitCount = countLimits.count;
+		
+		NSMutableArray<NSNumber *> *lru = [NSMutableArray arrayWithCapacity:limitCount];
+		NSMutableArray<NSNumber *> *tinyLFU = [NSMutableArray arrayWithCapacity:limitCount];
+		NSMutableArray<NSNumber *> *memory = [NSMutableArray arrayWithCapacity:limitCount];
+		
+		NSUInteger lruHits = 0;
+		double total = (double)MAX(lookupCount, (NSUInteger)1);
+		
+		for (NSUInteger i = 0; i < limitCount; i++)
+		{
+			lruHits += counter->lruBuckets[i];
+			
+			[lru addObject:@((double)lruHits / total)];
+			[tinyLFU addObject:@((double)counter->tinyLFUHits[i] / total)];
+			[memory addObject:@((unsigned long long)counter->memoryUsages[i])];
+		}
+		
+		lruHitRates = [lru copy];
+		tinyLFUHitRates = [tinyLFU copy];
+		memoryUsages = [memory copy];
+	}
+	return self;
+}
+
+- (NSUInteger)countLimitForHitRate:(double)hitRate
+{
+	NSUInteger i = 0;
+	for (NSNumber *rate in lruHitRates)
+	{
+		if ([rate doubleValue] >= hitRate) {
+			return [countLimits[i] unsignedIntegerValue];
+		}
+		i++;
+	}
+	
+	return 0;
+}
+
+- (NSString *)description
+{
+	NSMutableString *description = [NSMutableString stringWithFormat:
+	  @"<YapDatabaseCacheSimulationCurve[%p]: lookups(%lu) keys(%lu) averageValueSize(%lu)",
+	  self, (unsigned long)lookupCount, (unsigned long)distinctKeyCount, (unsigned long)averageValueSize];
+	
+	for (NSUInteger i = 0; i < countLimits.count; i++)
+	{
+		[description appendFormat:@"\n  %6lu: lru(%5.1f%%) tinyLFU(%5.1f%%) memory(%llu)",
+		  (unsigned long)[countLimits[i] unsignedIntegerValue],
+		  ([lruHitRates[i] doubleValue] * 100.0), ([tinyLFUHitRates[i] doubleValue] * 100.0),
+		  [memoryUsages[i] unsignedLongLongValue]];
+	}
+	
+	[description appendString:@">"];
+	return description;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseCacheSimulationResult ()
+
+@property (nonatomic, assign, readwrite) NSUInteger transactionCount;
+@property (nonatomic, assign, readwrite) NSUInteger connectionCount;
+
+@property (nonatomic, strong, readwrite) YapDatabaseCacheSimulationCurve *objectCurve;
+@property (nonatomic, strong, readwrite) YapDatabaseCacheSimulationCurve *metadataCurve;
+
+@property (nonatomic, copy, readwrite) NSDictionary<NSNumber *, YapDatabaseCacheSimulationCurve *> *objectCurvesByCollection;
+@property (nonatomic, copy, readwrite) NSDictionary<NSNumber *, YapDatabaseCacheSimulationCurve *> *metadataCurvesByCollection;
+
+@end
+
+@implementation YapDatabaseCacheSimulationResult
+
+- (NSString *)csvRepresentation
+{
+	NSMutableString *csv = [NSMutableString stringWithString:
+	  @"cache,collection,countLimit,lruHitRate,tinyLFUHitRate,memoryUsage\n"];
+	
+	void (^appendCurve)(NSString *, NSString *, YapDatabaseCacheSimulationCurve *) =
+	^(NSString *cache, NSString *collection, YapDatabaseCacheSimulationCurve *curve) {
+	
+		for (NSUInteger i = 0; i < curve.countLimits.count; i++)
+		{
+			[csv appendFormat:@"%@,%@,%lu,%.4f,%.4f,%llu\n", cache, collection,
+			  (unsigned long)[curve.countLimits[i] unsignedIntegerValue],
+			  [curve.lruHitRates[i] doubleValue], [curve.tinyLFUHitRates[i] doubleValue],
+			  [curve.memoryUsages[i] unsignedLongLongValue]];
+		}
+	};
+	
+	appendCurve(@"object", @"*", _objectCurve);
+	for (NSNumber *collection in [[_objectCurvesByCollection allKeys] sortedArrayUsingSelector:@selector(compare:)])
+	{
+		appendCurve(@"object", [collection stringValue], _objectCurvesByCollection[collection]);
+	}
+	
+	appendCurve(@"metadata", @"*", _metadataCurve);
+	for (NSNumber *collection in [[_metadataCurvesByCollection allKeys] sortedArrayUsingSelector:@selector(compare:)])
+	{
+		appendCurve(@"metadata", [collection stringValue], _metadataCurvesByCollection[collection]);
+	}
+	
+	return csv;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseCacheSimulationResult[%p]: transactions(%lu) connections(%lu) collections(%lu)\n"
+	  @" object: %@\n metadata: %@>", self,
+	  (unsigned long)_transactionCount, (unsigned long)_connectionCount,
+	  (unsigned long)_objectCurvesByCollection.count, _objectCurve, _metadataCurve];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseCacheSimulation
+{
+	NSData *data;
+	
+	// Simulation state (only valid during run)
+	
+	NSArray<NSNumber *> *limits;
+	NSUInteger *limitValues;
+	NSUInteger limitCount;
+	
+	NSMutableDictionary<NSNumber *, YapCacheSimulationConnection *> *connections;
+	
+	YapCacheSimulationCounter *counters[2];
+	NSMutableDictionary<NSNumber *, YapCacheSimulationCounter *> *collectionCounters[2];
+	
+	NSMutableDictionary<NSNumber *, NSNumber *> *valueSizes[2];      // cache key -> serialized size
+	NSMutableDictionary<NSNumber *, NSNumber *> *sizeTotals[2];      // collection -> total of written sizes
+	NSMutableDictionary<NSNumber *, NSNumber *> *sizeCounts[2];      // collection -> number of written sizes
+	
+	NSMutableDictionary<NSNumber *, NSNumber *> *keyCollections;     // cache key -> collection
+	NSMutableDictionary<NSNumber *, NSMutableOrderedSet<NSNumber *> *> *collectionKeys; // collection -> cache keys
+	
+	// The changes of the current read-write transaction, which are applied to the other connections on commit.
+	
+	NSMutableSet<NSNumber *> *changedKeys[2];
+	NSMutableSet<NSNumber *> *removedKeys;
+	BOOL allKeysRemoved;
+}
+
+@synthesize countLimits = countLimits;
+@synthesize objectPolicy = objectPolicy;
+@synthesize metadataPolicy = metadataPolicy;
+
+- (instancetype)initWithPath:(NSString *)path
+{
+	NSData *fileData = YapWorkloadTraceLoad(path);
+	if (fileData == nil) return nil;
+	
+	if ((self = [super init]))
+	{
+		data = fileData;
+		
+		countLimits = @[ @10, @20, @40, @80, @160, @320, @640, @1280, @2560, @5120 ];
+		objectPolicy = YapDatabasePolicyContainment;
+		metadataPolicy = YapDatabasePolicyContainment;
+	}
+	return self;
+}
+
+- (YapCacheSimulationCounter *)counterForKind:(YapCacheSimulationKind)kind collection:(uint64_t)collection
+{
+	NSNumber *number = @(collection);
+	
+	YapCacheSimulationCounter *counter = collectionCounters[kind][number];
+	if (counter == nil)
+	{
+		counter = [[YapCacheSimulationCounter alloc] initWithLimitCount:limitCount];
+		collectionCounters[kind][number] = counter;
+	}
+	
+	return counter;
+}
+
+- (YapCacheSimulationConnection *)connectionForID:(uint32_t)connectionID
+{
+	NSNumber *number = @(connectionID);
+	
+	YapCacheSimulationConnection *connection = connections[number];
+	if (connection == nil)
+	{
+		connection = [[YapCacheSimulationConnection alloc] init];
+		
+		for (NSUInteger kind = 0; kind < 2; kind++)
+		{
+			connection->stacks[kind] = [[YapCacheSimulationStack alloc] init];
+			
+			NSMutableArray *caches = [NSMutableArray arrayWithCapacity:limitCount];
+			for (NSUInteger i = 0; i < limitCount; i++)
+			{
+				YapCache *cache = [[YapCache alloc] initWithCountLimit:limitValues[i]];
+				cache.admissionPolicy = YapCacheAdmissionPolicyTinyLFU;
+				
+				[caches addObject:cache];
+			}
+			connection->tinyLFUCaches[kind] = caches;
+		}
+		
+		connections[number] = connection;
+	}
+	
+	return connection;
+}
+
+- (void)noteKey:(uint64_t)cacheKey collection:(uint64_t)collection
+{
+	NSNumber *keyNumber = @(cacheKey);
+	if (keyCollections[keyNumber]) return;
+	
+	NSNumber *collectionNumber = @(collection);
+	keyCollections[keyNumber] = collectionNumber;
+	
+	NSMutableOrderedSet *keys = collectionKeys[collectionNumber];
+	if (keys == nil)
+	{
+		keys = [[NSMutableOrderedSet alloc] init];
+		collectionKeys[collectionNumber] = keys;
+	}
+	[keys addObject:keyNumber];
+}
+
+- (void)forgetKey:(uint64_t)cacheKey
+{
+	NSNumber *keyNumber = @(cacheKey);
+	NSNumber *collectionNumber = keyCollections[keyNumber];
+	if (collectionNumber == nil) return;
+	
+	[collectionKeys[collectionNumber] removeObject:keyNumber];
+	[keyCollections removeObjectForKey:keyNumber];
+}
+
+- (void)lookup:(YapCacheSimulationKind)kind
+    connection:(YapCacheSimulationConnection *)connection
+    collection:(uint64_t)collection
+      cacheKey:(uint64_t)cacheKey
+{
+	[self noteKey:cacheKey collection:collection];
+	
+	NSUInteger depth = [connection->stacks[kind] useKey:cacheKey];
+	
+	// The first limit that the depth is within (limitCount if none).
+	NSUInteger bucket = limitCount;
+	if (depth != NSNotFound)
+	{
+		NSUInteger low = 0, high = limitCount;
+		while (low < high)
+		{
+			NSUInteger mid = (low + high) / 2;
+			if (depth < limitValues[mid])
+				high = mid;
+			else
+				low = mid + 1;
+		}
+		bucket = low;
+	}
+	
+	NSNumber *keyNumber = @(cacheKey);
+	NSArray<YapCache *> *caches = connection->tinyLFUCaches[kind];
+	
+	YapCacheSimulationCounter *collectionCounter = [self counterForKind:kind collection:collection];
+	YapCacheSimulationCounter *counter = counters[kind];
+	
+	counter->lookupCount++;
+	collectionCounter->lookupCount++;
+	
+	[counter->keys addObject:keyNumber];
+	[collectionCounter->keys addObject:keyNumber];
+	
+	if (bucket < limitCount)
+	{
+		counter->lruBuckets[bucket]++;
+		collectionCounter->lruBuckets[bucket]++;
+	}
+	
+	for (NSUInteger i = 0; i < limitCount; i++)
+	{
+		YapCache *cache = caches[i];
+		
+		if ([cache objectForKey:keyNumber])
+		{
+			counter->tinyLFUHits[i]++;
+			collectionCounter->tinyLFUHits[i]++;
+		}
+		else
+		{
+			[cache setObject:@(YES) forKey:keyNumber];
+		}
+	}
+}
+
+- (void)write:(YapCacheSimulationKind)kind
+   connection:(YapCacheSimulationConnection *)connection
+   collection:(uint64_t)collection
+     cacheKey:(uint64_t)cacheKey
+         size:(uint64_t)size
+{
+	[self noteKey:cacheKey collection:collection];
+	
+	NSNumber *keyNumber = @(cacheKey);
+	NSNumber *collectionNumber = @(collection);
+	
+	valueSizes[kind][keyNumber] = @(size);
+	sizeTotals[kind][collectionNumber] = @([sizeTotals[kind][collectionNumber] unsignedLongLongValue] + size);
+	sizeCounts[kind][collectionNumber] = @([sizeCounts[kind][collectionNumber] unsignedLongLongValue] + 1);
+	
+	[connection->stacks[kind] useKey:cacheKey];
+	
+	for (YapCache *cache in connection->tinyLFUCaches[kind])
+	{
+		[cache setObject:@(YES) forKey:keyNumber];
+	}
+	
+	[changedKeys[kind] addObject:keyNumber];
+	[removedKeys removeObject:keyNumber];
+}
+
+- (void)remove:(uint64_t)cacheKey fromConnection:(YapCacheSimulationConnection *)connection
+{
+	NSNumber *keyNumber = @(cacheKey);
+	
+	for (NSUInteger kind = 0; kind < 2; kind++)
+	{
+		[connection->stacks[kind] removeKey:cacheKey];
+		
+		for (YapCache *cache in connection->tinyLFUCaches[kind])
+		{
+			[cache removeObjectForKey:keyNumber];
+		}
+	}
+}
+
+- (void)removeAllFromConnection:(YapCacheSimulationConnection *)connection
+{
+	for (NSUInteger kind = 0; kind < 2; kind++)
+	{
+		[connection->stacks[kind] removeAllKeys];
+		
+		for (YapCache *cache in connection->tinyLFUCaches[kind])
+		{
+			[cache removeAllObjects];
+		}
+	}
+}
+
+- (void)removeKey:(uint64_t)cacheKey connection:(YapCacheSimulationConnection *)connection
+{
+	[self remove:cacheKey fromConnection:connection];
+	[self forgetKey:cacheKey];
+	
+	NSNumber *keyNumber = @(cacheKey);
+	
+	[removedKeys addObject:keyNumber];
+	[changedKeys[YapCacheSimulationKindObject] removeObject:keyNumber];
+	[changedKeys[YapCacheSimulationKindMetadata] removeObject:keyNumber];
+}
+
+- (void)simulateEvent:(YapWorkloadTraceEvent *)event
+           connection:(YapCacheSimulationConnection *)connection
+            canModify:(BOOL)canModify
+{
+	uint64_t collection = event->collection;
+	uint64_t cacheKey = YapCacheSimulationKey(collection, event->key);
+	
+	switch (event->operation)
+	{
+		case YapDatabaseWorkloadTraceOperationGetObject :
+		{
+			[self lookup:YapCacheSimulationKindObject connection:connection collection:collection cacheKey:cacheKey];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationGetMetadata :
+		{
+			[self lookup:YapCacheSimulationKindMetadata connection:connection collection:collection cacheKey:cacheKey];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationGetRow :
+		{
+			[self lookup:YapCacheSimulationKindObject connection:connection collection:collection cacheKey:cacheKey];
+			[self lookup:YapCacheSimulationKindMetadata connection:connection collection:collection cacheKey:cacheKey];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationEnumerate :
+		{
+			BOOL objects = (event->enumeration == YapDatabaseWorkloadTraceEnumerationObjects ||
+			                event->enumeration == YapDatabaseWorkloadTraceEnumerationRows);
+			BOOL metadata = (event->enumeration == YapDatabaseWorkloadTraceEnumerationMetadata ||
+			                 event->enumeration == YapDatabaseWorkloadTraceEnumerationRows);
+			
+			if (!objects && !metadata) break;
+			
+			NSArray<NSNumber *> *keys = [collectionKeys[@(collection)] array];
+			for (NSNumber *keyNumber in keys)
+			{
+				uint64_t enumeratedKey = [keyNumber unsignedLongLongValue];
+				
+				if (objects) {
+					[self lookup:YapCacheSimulationKindObject
+					  connection:connection collection:collection cacheKey:enumeratedKey];
+				}
+				if (metadata) {
+					[self lookup:YapCacheSimulationKindMetadata
+					  connection:connection collection:collection cacheKey:enumeratedKey];
+				}
+			}
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationSetRow :
+		{
+			if (!canModify) break;
+			
+			uint64_t metadataSize = (event->metadataSize > 0) ? (event->metadataSize - 1) : 0;
+			
+			[self write:YapCacheSimulationKindObject
+			 connection:connection collection:collection cacheKey:cacheKey size:event->size];
+			[self write:YapCacheSimulationKindMetadata
+			 connection:connection collection:collection cacheKey:cacheKey size:metadataSize];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationReplaceObject :
+		{
+			if (!canModify) break;
+			
+			[self write:YapCacheSimulationKindObject
+			 connection:connection collection:collection cacheKey:cacheKey size:event->size];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationReplaceMetadata :
+		{
+			if (!canModify) break;
+			
+			uint64_t metadataSize = (event->size > 0) ? (event->size - 1) : 0;
+			
+			[self write:YapCacheSimulationKindMetadata
+			 connection:connection collection:collection cacheKey:cacheKey size:metadataSize];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemove :
+		{
+			if (!canModify) break;
+			
+			[self removeKey:cacheKey connection:connection];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemoveCollection :
+		{
+			if (!canModify) break;
+			
+			NSArray<NSNumber *> *keys = [collectionKeys[@(collection)] array];
+			for (NSNumber *keyNumber in keys)
+			{
+				[self removeKey:[keyNumber unsignedLongLongValue] connection:connection];
+			}
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemoveAll :
+		{
+			if (!canModify) break;
+			
+			[self removeAllFromConnection:connection];
+			
+			[keyCollections removeAllObjects];
+			[collectionKeys removeAllObjects];
+			
+			[changedKeys[YapCacheSimulationKindObject] removeAllObjects];
+			[changedKeys[YapCacheSimulationKindMetadata] removeAllObjects];
+			[removedKeys removeAllObjects];
+			allKeysRemoved = YES;
+			break;
+		}
+		default:
+		{
+			// HasKey only uses the key cache, and extensions have their own caches.
+			break;
+		}
+	}
+}
+
+/**
+ * Applies the changes of a (committed) read-write transaction to the caches of the other connections.
+ * This mirrors how a connection processes the changeset of a commit from another connection.
+**/
+- (void)commitFromConnection:(YapCacheSimulationConnection *)writer
+{
+	for (YapCacheSimulationConnection *connection in [connections objectEnumerator])
+	{
+		if (connection == writer) continue;
+		
+		if (allKeysRemoved) {
+			[self removeAllFromConnection:connection];
+		}
+		
+		for (NSNumber *keyNumber in removedKeys)
+		{
+			[self remove:[keyNumber unsignedLongLongValue] fromConnection:connection];
+		}
+		
+		for (NSUInteger kind = 0; kind < 2; kind++)
+		{
+			YapDatabasePolicy policy = (kind == YapCacheSimulationKindObject) ? objectPolicy : metadataPolicy;
+			YapCacheSimulationStack *stack = connection->stacks[kind];
+			NSArray<YapCache *> *caches = connection->tinyLFUCaches[kind];
+			
+			for (NSNumber *keyNumber in changedKeys[kind])
+			{
+				uint64_t cacheKey = [keyNumber unsignedLongLongValue];
+				
+				if (policy == YapDatabasePolicyContainment)
+				{
+					[stack removeKey:cacheKey];
+					
+					for (YapCache *cache in caches) {
+						[cache removeObjectForKey:keyNumber];
+					}
+				}
+				else
+				{
+					[stack touchKey:cacheKey];
+					
+					for (YapCache *cache in caches)
+					{
+						if ([cache containsKey:keyNumber]) {
+							[cache setObject:@(YES) forKey:keyNumber];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Calculates the memory held by the LRU caches of each connection (at the end of the trace),
+ * and records the largest for each limit.
+**/
+- (void)calculateMemoryUsages
+{
+	for (NSUInteger kind = 0; kind < 2; kind++)
+	{
+		NSMutableDictionary<NSNumber *, NSNumber *> *averageSizes = [NSMutableDictionary dictionary];
+		[sizeTotals[kind] enumerateKeysAndObjectsUsingBlock:^(NSNumber *collection, NSNumber *total, BOOL *stop) {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+			uint64_t count = [sizeCounts[kind][collection] unsignedLongLongValue];
+			averageSizes[collection] = @((double)[total unsignedLongLongValue] / (double)MAX(count, 1ULL));
+		
+		#pragma clang diagnostic pop
+		}];
+		
+		for (YapCacheSimulationConnection *connection in [connections objectEnumerator])
+		{
+			// Running totals, for all collections & for each collection.
+			
+			__block double total = 0;
+			NSMutableDictionary<NSNumber *, NSNumber *> *totals = [NSMutableDictionary dictionary];
+			
+			__block NSUInteger depth = 0;
+			__block NSUInteger limitIndex = 0;
+			
+			void (^recordThroughLimit)(NSUInteger) = ^(NSUInteger lastIndex) {
+			#pragma clang diagnostic push
+			#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+				for (; limitIndex < lastIndex; limitIndex++)
+				{
+					YapCacheSimulationCounter *counter = counters[kind];
+					counter->memoryUsages[limitIndex] = MAX(counter->memoryUsages[limitIndex], total);
+					
+					[totals enumerateKeysAndObjectsUsingBlock:^(NSNumber *collection, NSNumber *value, BOOL *stop) {
+					
+						YapCacheSimulationCounter *collectionCounter = collectionCounters[kind][collection];
+						if (collectionCounter)
+						{
+							collectionCounter->memoryUsages[limitIndex] =
+							  MAX(collectionCounter->memoryUsages[limitIndex], [value doubleValue]);
+						}
+					}];
+				}
+			
+			#pragma clang diagnostic pop
+			};
+			
+			[connection->stacks[kind] enumerateKeysWithBlock:^(uint64_t cacheKey, BOOL *stop) {
+			#pragma clang diagnostic push
+			#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+				// The limits that are full (i.e. hold exactly 'depth' keys) are recorded before adding the next key.
+				NSUInteger lastIndex = limitIndex;
+				while (lastIndex < limitCount && limitValues[lastIndex] <= depth) {
+					lastIndex++;
+				}
+				recordThroughLimit(lastIndex);
+				
+				if (limitIndex >= limitCount)
+				{
+					*stop = YES;
+					return;
+				}
+				
+				NSNumber *keyNumber = @(cacheKey);
+				NSNumber *collection = keyCollections[keyNumber];
+				
+				NSNumber *size = valueSizes[kind][keyNumber];
+				double value = size ? [size doubleValue] : (collection ? [averageSizes[collection] doubleValue] : 0.0);
+				
+				total += value;
+				if (collection) {
+					totals[collection] = @([totals[collection] doubleValue] + value);
+				}
+				
+				depth++;
+			
+			#pragma clang diagnostic pop
+			}];
+			
+			// The remaining limits are larger than the stack, so they hold every key.
+			recordThroughLimit(limitCount);
+		}
+	}
+}
+
+- (YapDatabaseCacheSimulationResult *)run
+{
+	limits = [[[NSSet setWithArray:countLimits] allObjects] sortedArrayUsingSelector:@selector(compare:)];
+	limits = [limits filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"unsignedIntegerValue > 0"]];
+	
+	limitCount = limits.count;
+	limitValues = calloc(MAX(limitCount, (NSUInteger)1), sizeof(NSUInteger));
+	for (NSUInteger i = 0; i < limitCount; i++)
+	{
+		limitValues[i] = [limits[i] unsignedIntegerValue];
+	}
+	
+	connections = [[NSMutableDictionary alloc] init];
+	keyCollections = [[NSMutableDictionary alloc] init];
+	collectionKeys = [[NSMutableDictionary alloc] init];
+	removedKeys = [[NSMutableSet alloc] init];
+	
+	for (NSUInteger kind = 0; kind < 2; kind++)
+	{
+		counters[kind] = [[YapCacheSimulationCounter alloc] initWithLimitCount:limitCount];
+		collectionCounters[kind] = [[NSMutableDictionary alloc] init];
+		valueSizes[kind] = [[NSMutableDictionary alloc] init];
+		sizeTotals[kind] = [[NSMutableDictionary alloc] init];
+		sizeCounts[kind] = [[NSMutableDictionary alloc] init];
+		changedKeys[kind] = [[NSMutableSet alloc] init];
+	}
+	
+	// Single pass over the trace.
+	
+	YapWorkloadTraceReader reader = YapWorkloadTraceReaderMake(data);
+	NSUInteger transactionCount = 0;
+	
+	while (reader.offset < reader.length) { @autoreleasepool {
+	
+		YapWorkloadTraceTransactionHeader header;
+		if (!YapWorkloadTraceReadTransactionHeader(&reader, &header)) break;
+		
+		YapCacheSimulationConnection *connection = [self connectionForID:header.connectionID];
+		
+		BOOL isReadWrite = (header.flags & YapDatabaseWorkloadTraceFlagReadWrite) != 0;
+		BOOL didRollback = (header.flags & YapDatabaseWorkloadTraceFlagRollback) != 0;
+		
+		YapWorkloadTraceEvent event;
+		for (uint64_t e = 0; e < header.eventCount; e++)
+		{
+			memset(&event, 0, sizeof(event));
+			if (!YapWorkloadTraceReadEvent(&reader, &event)) break;
+			
+			[self simulateEvent:&event connection:connection canModify:(isReadWrite && !didRollback)];
+		}
+		
+		if (reader.failed) break; // truncated trace
+		
+		if (isReadWrite && !didRollback) {
+			[self commitFromConnection:connection];
+		}
+		
+		[changedKeys[YapCacheSimulationKindObject] removeAllObjects];
+		[changedKeys[YapCacheSimulationKindMetadata] removeAllObjects];
+		[removedKeys removeAllObjects];
+		allKeysRemoved = NO;
+		
+		transactionCount++;
+	}}
+	
+	[self calculateMemoryUsages];
+	
+	// Assemble the curves
+	
+	YapDatabaseCacheSimulationResult *result = [[YapDatabaseCacheSimulationResult alloc] init];
+	result.transactionCount = transactionCount;
+	result.connectionCount = connections.count;
+	
+	for (NSUInteger kind = 0; kind < 2; kind++)
+	{
+		__block uint64_t allTotal = 0;
+		__block uint64_t allCount = 0;
+		
+		NSMutableDictionary<NSNumber *, YapDatabaseCacheSimulationCurve *> *curves = [NSMutableDictionary dictionary];
+		
+		[collectionCounters[kind] enumerateKeysAndObjectsUsingBlock:
+		    ^(NSNumber *collection, YapCacheSimulationCounter *counter, BOOL *stop)
+		{
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+			uint64_t sizeTotal = [sizeTotals[kind][collection] unsignedLongLongValue];
+			uint64_t sizeCount = [sizeCounts[kind][collection] unsignedLongLongValue];
+			
+			curves[collection] =
+			  [[YapDatabaseCacheSimulationCurve alloc] initWithCountLimits:limits
+			                                                       counter:counter
+			                                              averageValueSize:(NSUInteger)(sizeTotal / MAX(sizeCount, 1ULL))];
+		
+		#pragma clang diagnostic pop
+		}];
+		
+		for (NSNumber *collection in sizeTotals[kind])
+		{
+			allTotal += [sizeTotals[kind][collection] unsignedLongLongValue];
+			allCount += [sizeCounts[kind][collection] unsignedLongLongValue];
+		}
+		
+		YapDatabaseCacheSimulationCurve *curve =
+		  [[YapDatabaseCacheSimulationCurve alloc] initWithCountLimits:limits
+		                                                       counter:counters[kind]
+		                                              averageValueSize:(NSUInteger)(allTotal / MAX(allCount, 1ULL))];
+		
+		if (kind == YapCacheSimulationKindObject)
+		{
+			result.objectCurve = curve;
+			result.objectCurvesByCollection = curves;
+		}
+		else
+		{
+			result.metadataCurve = curve;
+			result.metadataCurvesByCollection = curves;
+		}
+	}
+	
+	// Release the simulation state
+	
+	free(limitValues);
+	limitValues = NULL;
+	limits = nil;
+	
+	connections = nil;
+	keyCollections = nil;
+	collectionKeys = nil;
+	removedKeys = nil;
+	
+	for (NSUInteger kind = 0; kind < 2; kind++)
+	{
+		counters[kind] = nil;
+		collectionCounters[kind] = nil;
+		valueSizes[kind] = nil;
+		sizeTotals[kind] = nil;
+		sizeCounts[kind] = nil;
+		changedKeys[kind] = nil;
+	}
+	
+	return result;
+}
+
+@end
@@ -0,0 +1,98 @@
+#import <Foundation/Foundation.h>
+#import "YapCollectionKey.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A change summary merges the changesets of an array of notifications
+ * (e.g. the notifications returned from beginLongLivedReadTransaction) into a single index.
+ *
+ * The notifications are scanned once, when the summary is created.
+ * After that, each query is a hash lookup, regardless of the number of notifications.
+ * This is useful when the same notifications are queried many times,
+ * such as when checking each visible cell of a table view for changes.
+ *
+ * The Changeset Inspection methods of YapDatabaseConnection are built atop this class,
+ * and report the exact same results.
+ *
+ * A summary is immutable, and thus thread-safe.
+**/
+@interface YapDatabaseChangeSummary : NSObject
+
+/**
+ * Creates a summary of the given notifications.
+ * Objects in the array that aren't an NSNotification are ignored.
+**/
+- (instancetype)initWithNotifications:(NSArray<NSNotification *> *)notifications;
+
+/**
+ * The notifications that were summarized.
+**/
+@property (nonatomic, copy, readonly) NSArray<NSNotification *> *notifications;
+
+/**
+ * Returns YES if every collection was cleared, during any of the summarized commits.
+ *
+ * That is, if [transaction removeAllObjectsInAllCollections] was invoked,
+ * or if the database was modified by another process.
+ *
+ * @see -[YapDatabaseConnection didClearAllCollectionsInNotifications:]
+**/
+@property (nonatomic, assign, readonly) BOOL didClearAllCollections;
+
+// Query for any change to a collection
+
+- (BOOL)hasChangeForCollection:(nullable NSString *)collection;
+- (BOOL)hasObjectChangeForCollection:(nullable NSString *)collection;
+- (BOOL)hasMetadataChangeForCollection:(nullable NSString *)collection;
+
+// Query for a change to a particular key/collection tuple
+
+- (BOOL)hasChangeForKey:(NSString *)key inCollection:(nullable NSString *)collection;
+- (BOOL)hasObjectChangeForKey:(NSString *)key inCollection:(nullable NSString *)collection;
+- (BOOL)hasMetadataChangeForKey:(NSString *)key inCollection:(nullable NSString *)collection;
+
+// Query for a change to a particular set of keys in a collection
+
+- (BOOL)hasChangeForAnyKeys:(NSSet<NSString *> *)keys inCollection:(nullable NSString *)collection;
+- (BOOL)hasObjectChangeForAnyKeys:(NSSet<NSString *> *)keys inCollection:(nullable NSString *)collection;
+- (BOOL)hasMetadataChangeForAnyKeys:(NSSet<NSString *> *)keys inCollection:(nullable NSString *)collection;
+
+// Advanced query techniques
+
+/**
+ * @see -[YapDatabaseConnection didClearCollection:inNotifications:]
+**/
+- (BOOL)didClearCollection:(nullable NSString *)collection;
+
+/**
+ * @see -[YapDatabaseConnection didResetCollection:inNotifications:]
+**/
+- (BOOL)didResetCollection:(nullable NSString *)collection;
+
+/**
+ * Enumerates each changed key in the given collection (once).
+ *
+ * @see -[YapDatabaseConnection enumerateChangedKeysInCollection:inNotifications:usingBlock:]
+**/
+- (void)enumerateChangedKeysInCollection:(nullable NSString *)collection
+                              usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
+/**
+ * Enumerates each changed collection/key tuple (once).
+ *
+ * @see -[YapDatabaseConnection enumerateChangedCollectionKeysInNotifications:usingBlock:]
+**/
+- (void)enumerateChangedCollectionKeysUsingBlock:(void (^)(YapCollectionKey *ck, BOOL *stop))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,299 @@
+#import "YapDatabaseChangeSummary.h"
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseLogging.h"
+#import "YapSet.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+@implementation YapDatabaseChangeSummary
+{
+	// Each of these maps: collection -> set of keys
+	
+	NSMutableDictionary<NSString *, NSMutableSet<NSString *> *> *objectChanges;
+	NSMutableDictionary<NSString *, NSMutableSet<NSString *> *> *metadataChanges;
+	NSMutableDictionary<NSString *, NSMutableSet<NSString *> *> *removedKeys;
+	
+	NSMutableSet<NSString *> *removedCollections;
+	NSMutableSet<NSString *> *resetCollections;
+}
+
+@synthesize notifications = notifications;
+@synthesize didClearAllCollections = didClearAllCollections;
+
+static void YapDatabaseChangeSummaryAddKeys(NSMutableDictionary *dict, YapSet *collectionKeys)
+{
+	for (YapCollectionKey *ck in collectionKeys)
+	{
+		NSMutableSet *keys = [dict objectForKey:ck.collection];
+		if (keys == nil)
+		{
+			keys = [[NSMutableSet alloc] init];
+			[dict setObject:keys forKey:ck.collection];
+		}
+		
+		[keys addObject:ck.key];
+	}
+}
+
+- (instancetype)initWithNotifications:(NSArray<NSNotification *> *)inNotifications
+{
+	if ((self = [super init]))
+	{
+		notifications = [inNotifications copy];
+		
+		objectChanges   = [[NSMutableDictionary alloc] init];
+		metadataChanges = [[NSMutableDictionary alloc] init];
+		removedKeys     = [[NSMutableDictionary alloc] init];
+		
+		removedCollections = [[NSMutableSet alloc] init];
+		resetCollections   = [[NSMutableSet alloc] init];
+		
+		for (NSNotification *notification in notifications)
+		{
+			if (![notification isKindOfClass:[NSNotification class]])
+			{
+				YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
+				continue;
+			}
+			
+			NSDictionary *changeset = notification.userInfo;
+			
+			YapDatabaseChangeSummaryAddKeys(objectChanges,   [changeset objectForKey:YapDatabaseObjectChangesKey]);
+			YapDatabaseChangeSummaryAddKeys(metadataChanges, [changeset objectForKey:YapDatabaseMetadataChangesKey]);
+			YapDatabaseChangeSummaryAddKeys(removedKeys,     [changeset objectForKey:YapDatabaseRemovedKeysKey]);
+			
+			for (NSString *collection in (YapSet *)[changeset objectForKey:YapDatabaseRemovedCollectionsKey])
+			{
+				[removedCollections addObject:collection];
+			}
+			
+			for (NSString *collection in (YapSet *)[changeset objectForKey:YapDatabaseResetCollectionsKey])
+			{
+				[resetCollections addObject:collection];
+			}
+			
+			if ([[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue] ||
+			    [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue])
+			{
+				didClearAllCollections = YES;
+			}
+		}
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Queries
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns YES if every key in the collection may have changed (without being individually tracked).
+**/
+- (BOOL)hasWholeCollectionChange:(NSString *)collection
+{
+	return didClearAllCollections ||
+	       [removedCollections containsObject:collection] ||
+	       [resetCollections containsObject:collection];
+}
+
+- (BOOL)hasChangeForCollection:(NSString *)collection
+        includingObjectChanges:(BOOL)includeObjectChanges
+               metadataChanges:(BOOL)includeMetadataChanges
+{
+	if (collection == nil)
+		collection = @"";
+	
+	if (includeObjectChanges && [objectChanges objectForKey:collection])
+		return YES;
+	
+	if (includeMetadataChanges && [metadataChanges objectForKey:collection])
+		return YES;
+	
+	if ([removedKeys objectForKey:collection])
+		return YES;
+	
+	return [self hasWholeCollectionChange:collection];
+}
+
+- (BOOL)hasChangeForCollection:(NSString *)collection
+{
+	return [self hasChangeForCollection:collection includingObjectChanges:YES metadataChanges:YES];
+}
+
+- (BOOL)hasObjectChangeForCollection:(NSString *)collection
+{
+	return [self hasChangeForCollection:collection includingObjectChanges:YES metadataChanges:NO];
+}
+
+- (BOOL)hasMetadataChangeForCollection:(NSString *)collection
+{
+	return [self hasChangeForCollection:collection includingObjectChanges:NO metadataChanges:YES];
+}
+
+- (BOOL)hasChangeForKey:(NSString *)key
+           inCollection:(NSString *)collection
+ includingObjectChanges:(BOOL)includeObjectChanges
+        metadataChanges:(BOOL)includeMetadataChanges
+{
+	if (key == nil) return NO;
+	if (collection == nil)
+		collection = @"";
+	
+	if (includeObjectChanges && [[objectChanges objectForKey:collection] containsObject:key])
+		return YES;
+	
+	if (includeMetadataChanges && [[metadataChanges objectForKey:collection] containsObject:key])
+		return YES;
+	
+	if ([[removedKeys objectForKey:collection] containsObject:key])
+		return YES;
+	
+	return [self hasWholeCollectionChange:collection];
+}
+
+- (BOOL)hasChangeForKey:(NSString *)key inCollection:(NSString *)collection
+{
+	return [self hasChangeForKey:key inCollection:collection includingObjectChanges:YES metadataChanges:YES];
+}
+
+- (BOOL)hasObjectChangeForKey:(NSString *)key inCollection:(NSString *)collection
+{
+	return [self hasChangeForKey:key inCollection:collection includingObjectChanges:YES metadataChanges:NO];
+}
+
+- (BOOL)hasMetadataChangeForKey:(NSString *)key inCollection:(NSString *)collection
+{
+	return [self hasChangeForKey:key inCollection:collection includingObjectChanges:NO metadataChanges:YES];
+}
+
+- (BOOL)hasChangeForAnyKeys:(NSSet<NSString *> *)keys
+               inCollection:(NSString *)collection
+     includingObjectChanges:(BOOL)includeObjectChanges
+            metadataChanges:(BOOL)includeMetadataChanges
+{
+	if ([keys count] == 0) return NO;
+	if (collection == nil)
+		collection = @"";
+	
+	if (includeObjectChanges && [[objectChanges objectForKey:collection] intersectsSet:keys])
+		return YES;
+	
+	if (includeMetadataChanges && [[metadataChanges objectForKey:collection] intersectsSet:keys])
+		return YES;
+	
+	if ([[removedKeys objectForKey:collection] intersectsSet:keys])
+		return YES;
+	
+	return [self hasWholeCollectionChange:collection];
+}
+
+- (BOOL)hasChangeForAnyKeys:(NSSet<NSString *> *)keys inCollection:(NSString *)collection
+{
+	return [self hasChangeForAnyKeys:keys inCollection:collection includingObjectChanges:YES metadataChanges:YES];
+}
+
+- (BOOL)hasObjectChangeForAnyKeys:(NSSet<NSString *> *)keys inCollection:(NSString *)collection
+{
+	return [self hasChangeForAnyKeys:keys inCollection:collection includingObjectChanges:YES metadataChanges:NO];
+}
+
+- (BOOL)hasMetadataChangeForAnyKeys:(NSSet<NSString *> *)keys inCollection:(NSString *)collection
+{
+	return [self hasChangeForAnyKeys:keys inCollection:collection includingObjectChanges:NO metadataChanges:YES];
+}
+
+- (BOOL)didClearCollection:(NSString *)collection
+{
+	if (collection == nil)
+		collection = @"";
+	
+	return didClearAllCollections || [removedCollections containsObject:collection];
+}
+
+- (BOOL)didResetCollection:(NSString *)collection
+{
+	if (collection == nil)
+		collection = @"";
+	
+	return [resetCollections containsObject:collection];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Enumeration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)enumerateChangedKeysInCollection:(NSString *)collection
+                              usingBlock:(void (^)(NSString *key, BOOL *stop))block
+{
+	if (block == NULL) return;
+	if (collection == nil)
+		collection = @"";
+	
+	NSSet *objectKeys   = [objectChanges objectForKey:collection];
+	NSSet *metadataKeys = [metadataChanges objectForKey:collection];
+	NSSet *removed      = [removedKeys objectForKey:collection];
+	
+	// Each key is reported once, even if it appears in multiple sets.
+	
+	BOOL stop = NO;
+	
+	for (NSString *key in objectKeys)
+	{
+		block(key, &stop);
+		if (stop) return;
+	}
+	
+	for (NSString *key in metadataKeys)
+	{
+		if ([objectKeys containsObject:key]) continue;
+		
+		block(key, &stop);
+		if (stop) return;
+	}
+	
+	for (NSString *key in removed)
+	{
+		if ([objectKeys containsObject:key] || [metadataKeys containsObject:key]) continue;
+		
+		block(key, &stop);
+		if (stop) return;
+	}
+}
+
+- (void)enumerateChangedCollectionKeysUsingBlock:(void (^)(YapCollectionKey *ck, BOOL *stop))block
+{
+	if (block == NULL) return;
+	
+	NSMutableSet *collections = [NSMutableSet setWithArray:[objectChanges allKeys]];
+	[collections addObjectsFromArray:[metadataChanges allKeys]];
+	[collections addObjectsFromArray:[removedKeys allKeys]];
+	
+	__block BOOL stop = NO;
+	
+	for (NSString *collection in collections)
+	{
+		[self enumerateChangedKeysInCollection:collection usingBlock:^(NSString *key, BOOL *innerStop) {
+			
+			block([[YapCollectionKey alloc] initWithCollection:collection key:key], &stop);
+			if (stop) *innerStop = YES;
+		}];
+		
+		if (stop) return;
+	}
+}
+
+@end
@@ -0,0 +1,212 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * By default, YapDatabase runs a passive checkpoint whenever the WAL contains frames that can be checkpointed.
+ * And it switches to "aggressive" checkpointing if the WAL grows beyond YapDatabaseOptions.aggressiveWALTruncationSize.
+ *
+ * A checkpoint policy replaces this logic. (See YapDatabaseOptions.checkpointPolicy)
+ * The policy is consulted whenever a checkpoint opportunity arises (e.g. after a commit, or when a reader moves forward),
+ * and decides when to checkpoint, and in which mode.
+**/
+
+typedef NS_ENUM(NSInteger, YapDatabaseCheckpointMode) {
+	
+	/**
+	 * Don't checkpoint (yet).
+	 * The policy may request to be consulted again after a delay.
+	**/
+	YapDatabaseCheckpointModeNone     = 0,
+	
+	/**
+	 * SQLITE_CHECKPOINT_PASSIVE:
+	 * Checkpoints as many frames as possible without waiting for readers or writers.
+	 * Runs in parallel with read-write transactions.
+	**/
+	YapDatabaseCheckpointModePassive  = 1,
+	
+	/**
+	 * SQLITE_CHECKPOINT_FULL:
+	 * Blocks writers (briefly), and waits for readers on old snapshots, so every frame can be checkpointed.
+	**/
+	YapDatabaseCheckpointModeFull     = 2,
+	
+	/**
+	 * SQLITE_CHECKPOINT_RESTART:
+	 * Like full, but also waits for readers to move off the WAL, so the next write restarts the WAL from the beginning.
+	**/
+	YapDatabaseCheckpointModeRestart  = 3,
+	
+	/**
+	 * SQLITE_CHECKPOINT_TRUNCATE:
+	 * Like restart, but also truncates the WAL file to zero bytes.
+	**/
+	YapDatabaseCheckpointModeTruncate = 4,
+};
+
+/**
+ * The information available to a checkpoint policy.
+ * A new (immutable) context is created each time the policy is consulted.
+**/
+@interface YapDatabaseCheckpointContext : NSObject
+
+/**
+ * The number of frames in the WAL (as of the most recent commit or checkpoint).
+**/
+@property (nonatomic, assign, readonly) NSUInteger walFrameCount;
+
+/**
+ * The number of frames in the WAL that have already been copied into the database file.
+**/
+@property (nonatomic, assign, readonly) NSUInteger checkpointedFrameCount;
+
+/**
+ * The number of frames in the WAL that still need to be checkpointed.
+ * That is, walFrameCount - checkpointedFrameCount.
+**/
+@property (nonatomic, assign, readonly) NSUInteger uncheckpointedFrameCount;
+
+/**
+ * The approximate size of the WAL file (in bytes), based on the number of frames & the page size.
+**/
+@property (nonatomic, assign, readonly) uint64_t walApproximateFileSize;
+
+/**
+ * The configured YapDatabaseOptions.aggressiveWALTruncationSize.
+**/
+@property (nonatomic, assign, readonly) unsigned long long aggressiveWALTruncationSize;
+
+/**
+ * The number of commits that cannot be checkpointed (by a passive checkpoint),
+ * because at least one reader is still on an older snapshot.
+ *
+ * A large value typically indicates a long-lived read transaction.
+**/
+@property (nonatomic, assign, readonly) uint64_t snapshotLag;
+
+/**
+ * The recent write rate, in commits per second (exponentially decaying average).
+**/
+@property (nonatomic, assign, readonly) double writeRate;
+
+/**
+ * The amount of time (in seconds) since the last checkpoint that was performed via the policy.
+ * If no checkpoint has been performed yet, this is the time since the database was opened.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval timeSinceLastCheckpoint;
+
+/**
+ * Whether the device is in low power mode (where supported by the OS).
+**/
+@property (nonatomic, assign, readonly) BOOL lowPowerModeEnabled;
+
+@end
+
+/**
+ * A checkpoint policy is consulted on a background queue, and must be thread-safe.
+ * It should be fast, as it may be consulted after every commit.
+**/
+@protocol YapDatabaseCheckpointPolicy <NSObject>
+
+/**
+ * Returns the checkpoint mode to use (or YapDatabaseCheckpointModeNone to skip the checkpoint).
+ *
+ * If the policy returns YapDatabaseCheckpointModeNone, it may also set the delay,
+ * in which case the policy will be consulted again after the delay (unless it has been consulted again in the meantime).
+ * Otherwise the policy is only consulted again at the next checkpoint opportunity.
+**/
+- (YapDatabaseCheckpointMode)checkpointModeForContext:(YapDatabaseCheckpointContext *)context
+                                                delay:(NSTimeInterval *)delayPtr;
+
+@end
+
+/**
+ * The default adaptive policy:
+ *
+ * - If the WAL reaches aggressiveWALTruncationSize, the WAL is truncated.
+ * - If the WAL reaches fullCheckpointSize while readers are lagging behind, a full checkpoint is performed.
+ * - During bursts of writes (writeRate >= burstWriteRate), checkpoints are deferred until the burst subsides,
+ *   so the checkpoint's random I/O doesn't compete with the writes.
+ * - Otherwise, a passive checkpoint is performed once there are at least minimumFrameCount frames to checkpoint,
+ *   or once maximumInterval has elapsed since the last checkpoint.
+ *
+ * In low power mode, minimumFrameCount & maximumInterval are multiplied by lowPowerMultiplier,
+ * so checkpoints happen less often (but with more work per checkpoint).
+**/
+@interface YapDatabaseAdaptiveCheckpointPolicy : NSObject <YapDatabaseCheckpointPolicy>
+
+/**
+ * The default value is 256 (frames).
+**/
+@property (atomic, assign, readwrite) NSUInteger minimumFrameCount;
+
+/**
+ * The default value is 10 (seconds).
+**/
+@property (atomic, assign, readwrite) NSTimeInterval maximumInterval;
+
+/**
+ * The default value is 20 (commits per second).
+**/
+@property (atomic, assign, readwrite) double burstWriteRate;
+
+/**
+ * How long to defer the checkpoint during a burst of writes.
+ * The default value is 0.5 (seconds).
+**/
+@property (atomic, assign, readwrite) NSTimeInterval burstDelay;
+
+/**
+ * The default value is 4 MB.
+**/
+@property (atomic, assign, readwrite) uint64_t fullCheckpointSize;
+
+/**
+ * The default value is 4.
+**/
+@property (atomic, assign, readwrite) NSUInteger lowPowerMultiplier;
+
+@end
+
+/**
+ * A snapshot of the decisions made by the checkpoint policy.
+ * See -[YapDatabase checkpointStatistics].
+**/
+@interface YapDatabaseCheckpointStatistics : NSObject <NSCopying>
+
+/** The number of times the policy was consulted. **/
+@property (nonatomic, assign, readonly) NSUInteger evaluationCount;
+
+/** The number of times the policy decided to skip (or defer) the checkpoint. **/
+@property (nonatomic, assign, readonly) NSUInteger skippedCount;
+
+/** The number of checkpoints performed, per mode. **/
+@property (nonatomic, assign, readonly) NSUInteger passiveCount;
+@property (nonatomic, assign, readonly) NSUInteger fullCount;
+@property (nonatomic, assign, readonly) NSUInteger restartCount;
+@property (nonatomic, assign, readonly) NSUInteger truncateCount;
+
+/** The number of checkpoints that could not complete (SQLITE_BUSY, or spoiled by a long-lived read transaction). **/
+@property (nonatomic, assign, readonly) NSUInteger busyCount;
+
+/** The total number of frames copied into the database file by the checkpoints. **/
+@property (nonatomic, assign, readonly) uint64_t checkpointedFrameCount;
+
+/** The most recent decision. **/
+@property (nonatomic, assign, readonly) YapDatabaseCheckpointMode lastMode;
+
+/** The number of frames in the WAL at the time of the most recent decision. **/
+@property (nonatomic, assign, readonly) NSUInteger lastWALFrameCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
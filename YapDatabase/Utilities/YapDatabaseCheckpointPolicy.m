@@ -0,0 +1,168 @@
+#import "YapDatabaseCheckpointPolicy.h"
+#import "YapDatabaseCheckpointPolicyPrivate.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+
+@implementation YapDatabaseCheckpointContext
+
+@synthesize walFrameCount = walFrameCount;
+@synthesize checkpointedFrameCount = checkpointedFrameCount;
+@synthesize walApproximateFileSize = walApproximateFileSize;
+@synthesize aggressiveWALTruncationSize = aggressiveWALTruncationSize;
+@synthesize snapshotLag = snapshotLag;
+@synthesize writeRate = writeRate;
+@synthesize timeSinceLastCheckpoint = timeSinceLastCheckpoint;
+@synthesize lowPowerModeEnabled = lowPowerModeEnabled;
+
+- (NSUInteger)uncheckpointedFrameCount
+{
+	return (walFrameCount > checkpointedFrameCount) ? (walFrameCount - checkpointedFrameCount) : 0;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseCheckpointContext[%p]: frames(%lu) checkpointed(%lu) lag(%llu) writeRate(%.2f) elapsed(%.2f)>",
+	  self, (unsigned long)walFrameCount, (unsigned long)checkpointedFrameCount,
+	  snapshotLag, writeRate, timeSinceLastCheckpoint];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseAdaptiveCheckpointPolicy
+
+@synthesize minimumFrameCount = minimumFrameCount;
+@synthesize maximumInterval = maximumInterval;
+@synthesize burstWriteRate = burstWriteRate;
+@synthesize burstDelay = burstDelay;
+@synthesize fullCheckpointSize = fullCheckpointSize;
+@synthesize lowPowerMultiplier = lowPowerMultiplier;
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		minimumFrameCount = 256;
+		maximumInterval = 10.0;
+		burstWriteRate = 20.0;
+		burstDelay = 0.5;
+		fullCheckpointSize = (1024 * 1024 * 4); // 4 MB
+		lowPowerMultiplier = 4;
+	}
+	return self;
+}
+
+- (YapDatabaseCheckpointMode)checkpointModeForContext:(YapDatabaseCheckpointContext *)context
+                                                delay:(NSTimeInterval *)delayPtr
+{
+	NSUInteger uncheckpointedFrameCount = context.uncheckpointedFrameCount;
+	if (uncheckpointedFrameCount == 0)
+	{
+		// Nothing to checkpoint.
+		// But if the WAL is too big, we still want to truncate it.
+		
+		if (context.walFrameCount > 0 && context.walApproximateFileSize >= context.aggressiveWALTruncationSize) {
+			return YapDatabaseCheckpointModeTruncate;
+		}
+		return YapDatabaseCheckpointModeNone;
+	}
+	
+	// Is the WAL getting too big ?
+	//
+	// This takes precedence over everything else,
+	// as the WAL would otherwise grow without bound (e.g. under a long-lived read transaction).
+	
+	if (context.walApproximateFileSize >= context.aggressiveWALTruncationSize)
+	{
+		return YapDatabaseCheckpointModeTruncate;
+	}
+	
+	if (context.walApproximateFileSize >= self.fullCheckpointSize && context.snapshotLag > 0)
+	{
+		return YapDatabaseCheckpointModeFull;
+	}
+	
+	// Are we in the middle of a burst of writes ?
+	
+	if (context.writeRate >= self.burstWriteRate)
+	{
+		*delayPtr = self.burstDelay;
+		return YapDatabaseCheckpointModeNone;
+	}
+	
+	// Is there enough work to justify a checkpoint ?
+	
+	NSUInteger frameThreshold = self.minimumFrameCount;
+	NSTimeInterval interval = self.maximumInterval;
+	
+	if (context.lowPowerModeEnabled)
+	{
+		NSUInteger multiplier = MAX(self.lowPowerMultiplier, (NSUInteger)1);
+		
+		frameThreshold *= multiplier;
+		interval *= multiplier;
+	}
+	
+	if (uncheckpointedFrameCount >= frameThreshold || context.timeSinceLastCheckpoint >= interval)
+	{
+		return YapDatabaseCheckpointModePassive;
+	}
+	
+	*delayPtr = interval - context.timeSinceLastCheckpoint;
+	return YapDatabaseCheckpointModeNone;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseCheckpointStatistics
+
+@synthesize evaluationCount = evaluationCount;
+@synthesize skippedCount = skippedCount;
+@synthesize passiveCount = passiveCount;
+@synthesize fullCount = fullCount;
+@synthesize restartCount = restartCount;
+@synthesize truncateCount = truncateCount;
+@synthesize busyCount = busyCount;
+@synthesize checkpointedFrameCount = checkpointedFrameCount;
+@synthesize lastMode = lastMode;
+@synthesize lastWALFrameCount = lastWALFrameCount;
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	YapDatabaseCheckpointStatistics *copy = [[[self class] alloc] init];
+	copy->evaluationCount = evaluationCount;
+	copy->skippedCount = skippedCount;
+	copy->passiveCount = passiveCount;
+	copy->fullCount = fullCount;
+	copy->restartCount = restartCount;
+	copy->truncateCount = truncateCount;
+	copy->busyCount = busyCount;
+	copy->checkpointedFrameCount = checkpointedFrameCount;
+	copy->lastMode = lastMode;
+	copy->lastWALFrameCount = lastWALFrameCount;
+	
+	return copy;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseCheckpointStatistics[%p]: evaluations(%lu) skipped(%lu) passive(%lu) full(%lu)"
+	  @" restart(%lu) truncate(%lu) busy(%lu) checkpointedFrames(%llu)>",
+	  self, (unsigned long)evaluationCount, (unsigned long)skippedCount, (unsigned long)passiveCount,
+	  (unsigned long)fullCount, (unsigned long)restartCount, (unsigned long)truncateCount,
+	  (unsigned long)busyCount, checkpointedFrameCount];
+}
+
+@end
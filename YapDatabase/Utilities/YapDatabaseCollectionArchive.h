@@ -0,0 +1,53 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A collection archive contains every row of a single collection, in serialized form:
+ * the key, the serialized object & the serialized metadata (as returned by the primitive accessors).
+ *
+ * Archives are created via -[YapDatabaseReadTransaction exportCollection:toPath:compressed:],
+ * and loaded via -[YapDatabaseReadWriteTransaction importCollectionFromPath:].
+ *
+ * Neither the export nor the import deserializes the objects,
+ * so moving a collection between databases (or devices) costs little more than copying its bytes.
+ * The rows are written in chunks (optionally compressed), so the archive is streamed rather than held in memory.
+ *
+ * The archive doesn't depend on the options of the database it was exported from.
+ * Rows that were compressed or stored externally are exported in their serialized form,
+ * and re-encoded according to the options of the database they're imported into.
+ * (The serializers of both databases must be compatible, of course.)
+ *
+ * This class allows you to inspect an archive file, e.g. to find out which collection it contains.
+**/
+@interface YapDatabaseCollectionArchive : NSObject
+
+/**
+ * Reads the header of the given archive file.
+ * Returns nil if the file doesn't exist, or isn't a collection archive.
+**/
+- (nullable instancetype)initWithPath:(NSString *)path;
+
+@property (nonatomic, copy, readonly) NSString *path;
+
+/**
+ * The name of the exported collection.
+**/
+@property (nonatomic, copy, readonly) NSString *collection;
+
+/**
+ * Whether the chunks of the archive are compressed (with zlib).
+**/
+@property (nonatomic, assign, readonly) BOOL isCompressed;
+
+@end
+
+NS_ASSUME_NONNULL_END
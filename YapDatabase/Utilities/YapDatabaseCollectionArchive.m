@@ -0,0 +1,522 @@
+#import "YapDatabaseCollectionArchive.h"
+#import "YapDatabaseCollectionArchivePrivate.h"
+#import "YapDatabaseLogging.h"
+
+#import <zlib.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+static const char YapDatabaseCollectionArchiveMagic[8] = { 'Y','D','B','C','O','L','A','R' };
+
+#define YAP_COLLECTION_ARCHIVE_HEADER_SIZE 20
+#define YAP_COLLECTION_ARCHIVE_CHUNK_HEADER_SIZE 12
+
+static void YapWriteUInt32(uint8_t *bytes, uint32_t value)
+{
+	bytes[0] = (uint8_t)(value);
+	bytes[1] = (uint8_t)(value >> 8);
+	bytes[2] = (uint8_t)(value >> 16);
+	bytes[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t YapReadUInt32(const uint8_t *bytes)
+{
+	return ((uint32_t)bytes[0])       |
+	       ((uint32_t)bytes[1] << 8)  |
+	       ((uint32_t)bytes[2] << 16) |
+	       ((uint32_t)bytes[3] << 24);
+}
+
+static void YapAppendUInt32(NSMutableData *data, uint32_t value)
+{
+	uint8_t bytes[4];
+	YapWriteUInt32(bytes, value);
+	
+	[data appendBytes:bytes length:sizeof(bytes)];
+}
+
+static NSError *YapCollectionArchiveError(NSString *description)
+{
+	NSDictionary *userInfo = @{ NSLocalizedDescriptionKey: description };
+	return [NSError errorWithDomain:@"YapDatabase" code:0 userInfo:userInfo];
+}
+
+static BOOL YapStreamWriteFully(NSOutputStream *stream, const void *buffer, NSUInteger length)
+{
+	const uint8_t *bytes = (const uint8_t *)buffer;
+	
+	while (length > 0)
+	{
+		NSInteger written = [stream write:bytes maxLength:length];
+		if (written <= 0) return NO;
+		
+		bytes += written;
+		length -= (NSUInteger)written;
+	}
+	
+	return YES;
+}
+
+/**
+ * Returns NO if the stream ended (or failed) before the buffer was filled.
+**/
+static BOOL YapStreamReadFully(NSInputStream *stream, void *buffer, NSUInteger length)
+{
+	uint8_t *bytes = (uint8_t *)buffer;
+	
+	while (length > 0)
+	{
+		NSInteger read = [stream read:bytes maxLength:length];
+		if (read <= 0) return NO;
+		
+		bytes += read;
+		length -= (NSUInteger)read;
+	}
+	
+	return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseCollectionArchive
+
+@synthesize path = path;
+@synthesize collection = collection;
+@synthesize isCompressed = isCompressed;
+
+- (instancetype)initWithPath:(NSString *)inPath
+{
+	if (inPath == nil) return nil;
+	
+	NSInputStream *stream = [NSInputStream inputStreamWithFileAtPath:inPath];
+	if (stream == nil) return nil;
+	
+	[stream open];
+	
+	YapDatabaseCollectionArchiveReader *reader = [[YapDatabaseCollectionArchiveReader alloc] initWithStream:stream];
+	BOOL result = [reader readHeader];
+	
+	[stream close];
+	
+	if (!result) return nil;
+	
+	if ((self = [super init]))
+	{
+		path = [inPath copy];
+		collection = [reader.collection copy];
+		isCompressed = reader.isCompressed;
+	}
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YapDatabaseCollectionArchive[%p] collection(%@) compressed(%@)>",
+	          self, collection, (isCompressed ? @"YES" : @"NO")];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseCollectionArchiveWriter
+{
+	NSOutputStream *stream;
+	BOOL ownsStream;
+	BOOL finished;
+	BOOL compressed;
+	
+	NSMutableData *chunk;
+	NSUInteger chunkRowCount;
+	NSMutableData *compressedChunk;
+}
+
+@synthesize rowCount = rowCount;
+@synthesize error = error;
+
+- (instancetype)initWithStream:(NSOutputStream *)inStream collection:(NSString *)collection compressed:(BOOL)inCompressed
+{
+	if ((self = [super init]))
+	{
+		stream = inStream;
+		compressed = inCompressed;
+		
+		chunk = [NSMutableData dataWithCapacity:(YAP_COLLECTION_ARCHIVE_CHUNK_SIZE + (64 * 1024))];
+		
+		if ([stream streamStatus] == NSStreamStatusNotOpen)
+		{
+			[stream open];
+			ownsStream = YES;
+		}
+		
+		NSData *collectionData = [collection dataUsingEncoding:NSUTF8StringEncoding];
+		
+		NSMutableData *header = [NSMutableData dataWithCapacity:(YAP_COLLECTION_ARCHIVE_HEADER_SIZE + collectionData.length)];
+		[header appendBytes:YapDatabaseCollectionArchiveMagic length:sizeof(YapDatabaseCollectionArchiveMagic)];
+		YapAppendUInt32(header, YAP_COLLECTION_ARCHIVE_VERSION);
+		YapAppendUInt32(header, (compressed ? YAP_COLLECTION_ARCHIVE_FLAG_COMPRESSED : 0));
+		YapAppendUInt32(header, (uint32_t)collectionData.length);
+		[header appendData:collectionData];
+		
+		if (!YapStreamWriteFully(stream, header.bytes, header.length))
+		{
+			error = YapCollectionArchiveError(@"Unable to write collection archive header");
+		}
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (ownsStream && !finished) {
+		[stream close];
+	}
+}
+
+- (BOOL)appendRowWithKey:(NSString *)key
+             objectBytes:(const void *)objectBytes
+            objectLength:(NSUInteger)objectLength
+           metadataBytes:(const void *)metadataBytes
+          metadataLength:(NSUInteger)metadataLength
+{
+	if (error) return NO;
+	
+	NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+	
+	YapAppendUInt32(chunk, (uint32_t)keyData.length);
+	[chunk appendData:keyData];
+	
+	YapAppendUInt32(chunk, (uint32_t)objectLength);
+	[chunk appendBytes:objectBytes length:objectLength];
+	
+	uint8_t hasMetadata = (metadataBytes != NULL) ? 1 : 0;
+	[chunk appendBytes:&hasMetadata length:1];
+	
+	if (hasMetadata)
+	{
+		YapAppendUInt32(chunk, (uint32_t)metadataLength);
+		[chunk appendBytes:metadataBytes length:metadataLength];
+	}
+	
+	chunkRowCount++;
+	rowCount++;
+	
+	if (chunk.length >= YAP_COLLECTION_ARCHIVE_CHUNK_SIZE)
+	{
+		return [self writeChunk];
+	}
+	
+	return YES;
+}
+
+- (BOOL)writeChunk
+{
+	if (chunkRowCount == 0) return YES;
+	
+	const void *payload = chunk.bytes;
+	uLong payloadLength = (uLong)chunk.length;
+	
+	if (compressed)
+	{
+		uLong bound = compressBound((uLong)chunk.length);
+		
+		if (compressedChunk == nil)
+			compressedChunk = [NSMutableData dataWithLength:bound];
+		else if (compressedChunk.length < bound)
+			compressedChunk.length = bound;
+		
+		uLongf compressedLength = bound;
+		int status = compress2(compressedChunk.mutableBytes, &compressedLength,
+		                       chunk.bytes, (uLong)chunk.length, Z_DEFAULT_COMPRESSION);
+		
+		// If compression doesn't shrink the chunk, it's stored as-is (see the header).
+		if (status == Z_OK && compressedLength < chunk.length)
+		{
+			payload = compressedChunk.bytes;
+			payloadLength = compressedLength;
+		}
+	}
+	
+	uint8_t chunkHeader[YAP_COLLECTION_ARCHIVE_CHUNK_HEADER_SIZE];
+	YapWriteUInt32(chunkHeader + 0, (uint32_t)chunkRowCount);
+	YapWriteUInt32(chunkHeader + 4, (uint32_t)payloadLength);
+	YapWriteUInt32(chunkHeader + 8, (uint32_t)chunk.length);
+	
+	if (!YapStreamWriteFully(stream, chunkHeader, sizeof(chunkHeader)) ||
+	    !YapStreamWriteFully(stream, payload, payloadLength))
+	{
+		error = YapCollectionArchiveError(
+		  [NSString stringWithFormat:@"Unable to write collection archive: %@", [stream streamError]]);
+		return NO;
+	}
+	
+	chunk.length = 0;
+	chunkRowCount = 0;
+	
+	return YES;
+}
+
+- (BOOL)finish
+{
+	if (finished) return (error == nil);
+	
+	if ((error == nil) && [self writeChunk])
+	{
+		uint8_t endChunk[YAP_COLLECTION_ARCHIVE_CHUNK_HEADER_SIZE] = { 0 };
+		
+		if (!YapStreamWriteFully(stream, endChunk, sizeof(endChunk)))
+		{
+			error = YapCollectionArchiveError(
+			  [NSString stringWithFormat:@"Unable to write collection archive: %@", [stream streamError]]);
+		}
+	}
+	
+	finished = YES;
+	if (ownsStream) {
+		[stream close];
+	}
+	
+	return (error == nil);
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseCollectionArchiveReader
+{
+	NSInputStream *stream;
+	BOOL ownsStream;
+	BOOL finished;
+	
+	NSMutableData *chunk;
+	NSMutableData *compressedChunk;
+}
+
+@synthesize collection = collection;
+@synthesize isCompressed = isCompressed;
+@synthesize rowCount = rowCount;
+@synthesize error = error;
+
+- (instancetype)initWithStream:(NSInputStream *)inStream
+{
+	if ((self = [super init]))
+	{
+		stream = inStream;
+		
+		if ([stream streamStatus] == NSStreamStatusNotOpen)
+		{
+			[stream open];
+			ownsStream = YES;
+		}
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (ownsStream && !finished) {
+		[stream close];
+	}
+}
+
+- (BOOL)readHeader
+{
+	uint8_t header[YAP_COLLECTION_ARCHIVE_HEADER_SIZE];
+	
+	if (!YapStreamReadFully(stream, header, sizeof(header)) ||
+	    memcmp(header, YapDatabaseCollectionArchiveMagic, sizeof(YapDatabaseCollectionArchiveMagic)) != 0)
+	{
+		error = YapCollectionArchiveError(@"Not a collection archive");
+		return NO;
+	}
+	
+	uint32_t version = YapReadUInt32(header + 8);
+	if (version != YAP_COLLECTION_ARCHIVE_VERSION)
+	{
+		error = YapCollectionArchiveError(
+		  [NSString stringWithFormat:@"Unsupported collection archive version (%u)", version]);
+		return NO;
+	}
+	
+	uint32_t flags = YapReadUInt32(header + 12);
+	isCompressed = (flags & YAP_COLLECTION_ARCHIVE_FLAG_COMPRESSED) != 0;
+	
+	uint32_t collectionLength = YapReadUInt32(header + 16);
+	NSMutableData *collectionData = [NSMutableData dataWithLength:collectionLength];
+	
+	if (!YapStreamReadFully(stream, collectionData.mutableBytes, collectionLength))
+	{
+		error = YapCollectionArchiveError(@"Truncated collection archive");
+		return NO;
+	}
+	
+	collection = [[NSString alloc] initWithData:collectionData encoding:NSUTF8StringEncoding];
+	if (collection == nil)
+	{
+		error = YapCollectionArchiveError(@"Corrupt collection archive (collection)");
+		return NO;
+	}
+	
+	return YES;
+}
+
+- (BOOL)readChunkWithBlock:(void (NS_NOESCAPE ^)(NSString *key, NSData *serializedObject,
+                                                NSData *serializedMetadata))block
+{
+	if (finished || error) return NO;
+	
+	uint8_t chunkHeader[YAP_COLLECTION_ARCHIVE_CHUNK_HEADER_SIZE];
+	if (!YapStreamReadFully(stream, chunkHeader, sizeof(chunkHeader)))
+	{
+		error = YapCollectionArchiveError(@"Truncated collection archive");
+		return NO;
+	}
+	
+	uint32_t chunkRowCount = YapReadUInt32(chunkHeader + 0);
+	uint32_t storedLength  = YapReadUInt32(chunkHeader + 4);
+	uint32_t rawLength     = YapReadUInt32(chunkHeader + 8);
+	
+	if (chunkRowCount == 0)
+	{
+		finished = YES;
+		if (ownsStream) {
+			[stream close];
+		}
+		
+		return NO;
+	}
+	
+	if (chunk == nil)
+		chunk = [NSMutableData dataWithLength:rawLength];
+	else
+		chunk.length = rawLength;
+	
+	if (storedLength == rawLength)
+	{
+		if (!YapStreamReadFully(stream, chunk.mutableBytes, rawLength))
+		{
+			error = YapCollectionArchiveError(@"Truncated collection archive");
+			return NO;
+		}
+	}
+	else
+	{
+		if (!isCompressed)
+		{
+			error = YapCollectionArchiveError(@"Corrupt collection archive (chunk length)");
+			return NO;
+		}
+		
+		if (compressedChunk == nil)
+			compressedChunk = [NSMutableData dataWithLength:storedLength];
+		else
+			compressedChunk.length = storedLength;
+		
+		if (!YapStreamReadFully(stream, compressedChunk.mutableBytes, storedLength))
+		{
+			error = YapCollectionArchiveError(@"Truncated collection archive");
+			return NO;
+		}
+		
+		uLongf uncompressedLength = rawLength;
+		int status = uncompress(chunk.mutableBytes, &uncompressedLength, compressedChunk.bytes, storedLength);
+		
+		if (status != Z_OK || uncompressedLength != rawLength)
+		{
+			error = YapCollectionArchiveError(@"Corrupt collection archive (compressed chunk)");
+			return NO;
+		}
+	}
+	
+	// Parse the rows
+	
+	const uint8_t *bytes = (const uint8_t *)chunk.bytes;
+	const uint8_t *end = bytes + rawLength;
+	
+	uint32_t parsedRowCount = 0;
+	
+	while (parsedRowCount < chunkRowCount)
+	{
+		uint32_t keyLength;
+		uint32_t objectLength;
+		uint32_t metadataLength = 0;
+		
+		const uint8_t *keyBytes;
+		const uint8_t *objectBytes;
+		const uint8_t *metadataBytes = NULL;
+		
+		if ((end - bytes) < 4) break;
+		keyLength = YapReadUInt32(bytes);
+		bytes += 4;
+		
+		if ((end - bytes) < ((int64_t)keyLength + 4)) break;
+		keyBytes = bytes;
+		bytes += keyLength;
+		
+		objectLength = YapReadUInt32(bytes);
+		bytes += 4;
+		
+		if ((end - bytes) < ((int64_t)objectLength + 1)) break;
+		objectBytes = bytes;
+		bytes += objectLength;
+		
+		uint8_t hasMetadata = *bytes;
+		bytes += 1;
+		
+		if (hasMetadata)
+		{
+			if ((end - bytes) < 4) break;
+			metadataLength = YapReadUInt32(bytes);
+			bytes += 4;
+			
+			if ((end - bytes) < (int64_t)metadataLength) break;
+			metadataBytes = bytes;
+			bytes += metadataLength;
+		}
+		
+		NSString *key = [[NSString alloc] initWithBytes:keyBytes length:keyLength encoding:NSUTF8StringEncoding];
+		if (key == nil) break;
+		
+		NSData *object = [NSData dataWithBytesNoCopy:(void *)objectBytes length:objectLength freeWhenDone:NO];
+		NSData *metadata = nil;
+		
+		if (metadataBytes) {
+			metadata = [NSData dataWithBytesNoCopy:(void *)metadataBytes length:metadataLength freeWhenDone:NO];
+		}
+		
+		block(key, object, metadata);
+	
+		parsedRowCount++;
+		rowCount++;
+	}
+	
+	if (parsedRowCount != chunkRowCount || bytes != end)
+	{
+		error = YapCollectionArchiveError(@"Corrupt collection archive (row)");
+		return NO;
+	}
+	
+	return YES;
+}
+
+@end
@@ -0,0 +1,112 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * YapDatabaseCompressionConfig is used to enable transparent compression of the serialized objects
+ * within a particular collection. (See YapDatabaseOptions.compressionConfigs)
+ *
+ * Compression happens between the serializer & the database:
+ * - objects are serialized (via the registered serializer), and then compressed before being written
+ * - rows are decompressed (directly from the sqlite column buffer), and then passed to the deserializer
+ *
+ * Thus neither your serializer nor deserializer need to know anything about compression.
+**/
+
+typedef NS_ENUM(uint8_t, YapDatabaseCompressionAlgorithm) {
+	
+	/**
+	 * The object is stored as-is.
+	**/
+	YapDatabaseCompressionAlgorithmNone = 0,
+	
+	/**
+	 * The object is compressed using (raw) deflate, optionally with a preset dictionary.
+	 * zlib is available on every supported platform, and doesn't require any additional dependencies.
+	**/
+	YapDatabaseCompressionAlgorithmZlib = 1,
+};
+
+/**
+ * The maximum size of a compression dictionary.
+ * This is the size of the deflate window, meaning larger dictionaries provide no benefit.
+**/
+extern const NSUInteger YapDatabaseCompressionMaxDictionarySize;
+
+
+@interface YapDatabaseCompressionConfig : NSObject <NSCopying>
+
+/**
+ * Returns a config that uses zlib compression, at the given level (1-9), without a preset dictionary.
+**/
++ (instancetype)zlibWithLevel:(int)level;
+
+- (instancetype)initWithAlgorithm:(YapDatabaseCompressionAlgorithm)algorithm
+                            level:(int)level
+                       dictionary:(nullable NSData *)dictionary;
+
+/**
+ * The compression algorithm to use for new rows.
+ *
+ * Changing the algorithm only affects rows written after the change.
+ * Existing rows are always readable, as each row records how it was compressed.
+**/
+@property (nonatomic, assign, readwrite) YapDatabaseCompressionAlgorithm algorithm;
+
+/**
+ * The compression level.
+ * For zlib, this is a value between 1 (fastest) and 9 (smallest). The default value is 6.
+**/
+@property (nonatomic, assign, readwrite) int level;
+
+/**
+ * An optional preset dictionary.
+ *
+ * If the serialized objects within the collection are small, and share a lot of structure
+ * (e.g. keyed archives or JSON), a dictionary can dramatically improve the compression ratio.
+ *
+ * The dictionary is stored within the database (the first time it's seen), so rows compressed with it
+ * can always be decompressed, even if the config is later changed.
+ *
+ * Rather than providing a dictionary, you can also have the database train one from the existing rows.
+ * See -[YapDatabaseConnection asyncTrainCompressionDictionaryForCollection:completionQueue:completionBlock:].
+ * Once a dictionary has been trained for the collection, it takes precedence over this one,
+ * until this dictionary is changed.
+ *
+ * Dictionaries larger than YapDatabaseCompressionMaxDictionarySize are truncated (keeping the tail).
+**/
+@property (nonatomic, copy, readwrite, nullable) NSData *dictionary;
+
+/**
+ * Serialized objects smaller than this are stored uncompressed,
+ * as the compression header would likely eat up most of the savings.
+ *
+ * The default value is 64 (bytes).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger minimumLength;
+
+/**
+ * When training a dictionary, the target size of the dictionary.
+ *
+ * The default value is YapDatabaseCompressionMaxDictionarySize.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger dictionarySize;
+
+/**
+ * When training a dictionary, the maximum number of rows that are sampled (the most recently inserted rows).
+ *
+ * The default value is 1000.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger trainingSampleCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
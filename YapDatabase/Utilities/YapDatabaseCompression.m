@@ -0,0 +1,542 @@
+#import "YapDatabaseCompression.h"
+#import "YapDatabaseCompressionPrivate.h"
+
+#import <pthread.h>
+#import <zlib.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+const NSUInteger YapDatabaseCompressionMaxDictionarySize = (1 << 15); // 32 KB (deflate window size)
+
+/**
+ * Training parameters.
+ *
+ * Substrings are tracked via a hash of their first TRAIN_GRAM_SIZE bytes,
+ * and dictionaries are assembled from segments of TRAIN_SEGMENT_SIZE bytes.
+**/
+#define TRAIN_GRAM_SIZE    8
+#define TRAIN_SEGMENT_SIZE 48
+#define TRAIN_HASH_BITS    18
+
+
+@implementation YapDatabaseCompressionConfig
+
+@synthesize algorithm = algorithm;
+@synthesize level = level;
+@synthesize dictionary = dictionary;
+@synthesize minimumLength = minimumLength;
+@synthesize dictionarySize = dictionarySize;
+@synthesize trainingSampleCount = trainingSampleCount;
+
++ (instancetype)zlibWithLevel:(int)level
+{
+	return [[self alloc] initWithAlgorithm:YapDatabaseCompressionAlgorithmZlib level:level dictionary:nil];
+}
+
+- (instancetype)init
+{
+	return [self initWithAlgorithm:YapDatabaseCompressionAlgorithmZlib level:Z_DEFAULT_COMPRESSION dictionary:nil];
+}
+
+- (instancetype)initWithAlgorithm:(YapDatabaseCompressionAlgorithm)inAlgorithm
+                            level:(int)inLevel
+                       dictionary:(NSData *)inDictionary
+{
+	if ((self = [super init]))
+	{
+		algorithm = inAlgorithm;
+		level = (inLevel == Z_DEFAULT_COMPRESSION) ? 6 : inLevel;
+		dictionary = [inDictionary copy];
+		
+		minimumLength = 64;
+		dictionarySize = YapDatabaseCompressionMaxDictionarySize;
+		trainingSampleCount = 1000;
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	YapDatabaseCompressionConfig *copy = [[[self class] alloc] init];
+	copy->algorithm = algorithm;
+	copy->level = level;
+	copy->dictionary = dictionary;
+	copy->minimumLength = minimumLength;
+	copy->dictionarySize = dictionarySize;
+	copy->trainingSampleCount = trainingSampleCount;
+	
+	return copy;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Thread Context
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Setting up a z_stream allocates a fair amount of memory (especially for deflate).
+ * So rather than doing it for every row, each thread keeps its own streams (and output buffers) around,
+ * and simply resets them between uses.
+**/
+typedef struct {
+	
+	z_stream inflater;
+	BOOL inflaterReady;
+	
+	z_stream deflater;
+	BOOL deflaterReady;
+	int deflaterLevel;
+	
+	uint8_t *inflateBuffer;
+	size_t inflateBufferSize;
+	
+	uint8_t *deflateBuffer;
+	size_t deflateBufferSize;
+	
+} YapCompressionContext;
+
+static pthread_key_t YapCompressionContextKey;
+
+static void YapCompressionContextFree(void *ptr)
+{
+	YapCompressionContext *context = (YapCompressionContext *)ptr;
+	
+	if (context->inflaterReady) inflateEnd(&context->inflater);
+	if (context->deflaterReady) deflateEnd(&context->deflater);
+	
+	free(context->inflateBuffer);
+	free(context->deflateBuffer);
+	free(context);
+}
+
+static YapCompressionContext *YapCompressionContextGet(void)
+{
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		
+		pthread_key_create(&YapCompressionContextKey, YapCompressionContextFree);
+	});
+	
+	YapCompressionContext *context = pthread_getspecific(YapCompressionContextKey);
+	if (context == NULL)
+	{
+		context = calloc(1, sizeof(YapCompressionContext));
+		if (context) {
+			pthread_setspecific(YapCompressionContextKey, context);
+		}
+	}
+	
+	return context;
+}
+
+static BOOL YapCompressionEnsureBuffer(uint8_t **bufferPtr, size_t *bufferSizePtr, size_t size)
+{
+	if (*bufferSizePtr >= size) return YES;
+	
+	size_t newSize = MAX(size, *bufferSizePtr * 2);
+	uint8_t *newBuffer = realloc(*bufferPtr, newSize);
+	if (newBuffer == NULL) return NO;
+	
+	*bufferPtr = newBuffer;
+	*bufferSizePtr = newSize;
+	return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Header
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void YapCompressionWriteUInt32(uint8_t *ptr, uint32_t value)
+{
+	ptr[0] = (uint8_t)(value);
+	ptr[1] = (uint8_t)(value >> 8);
+	ptr[2] = (uint8_t)(value >> 16);
+	ptr[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t YapCompressionReadUInt32(const uint8_t *ptr)
+{
+	return ((uint32_t)ptr[0]) | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static void YapCompressionWriteHeader(uint8_t *header,
+                                      YapDatabaseCompressionAlgorithm algorithm,
+                                      uint32_t dictionaryId,
+                                      uint32_t uncompressedLength)
+{
+	header[0] = YAP_COMPRESSION_MAGIC_0;
+	header[1] = YAP_COMPRESSION_MAGIC_1;
+	header[2] = (uint8_t)algorithm;
+	YapCompressionWriteUInt32(header + 3, dictionaryId);
+	YapCompressionWriteUInt32(header + 7, uncompressedLength);
+}
+
+BOOL YapDatabaseCompressionReadHeader(const void *bytes, size_t length,
+                                      YapDatabaseCompressionAlgorithm *algorithmPtr,
+                                      uint32_t *dictionaryIdPtr,
+                                      uint32_t *uncompressedLengthPtr)
+{
+	if (!YapDatabaseCompressionHasHeader(bytes, length)) return NO;
+	
+	const uint8_t *header = (const uint8_t *)bytes;
+	
+	if (algorithmPtr) *algorithmPtr = (YapDatabaseCompressionAlgorithm)header[2];
+	if (dictionaryIdPtr) *dictionaryIdPtr = YapCompressionReadUInt32(header + 3);
+	if (uncompressedLengthPtr) *uncompressedLengthPtr = YapCompressionReadUInt32(header + 7);
+	
+	return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Compression
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+NSData *YapDatabaseCompressData(NSData *data,
+                                YapDatabaseCompressionConfig *config,
+                                uint32_t dictionaryId,
+                                NSData *dictionary)
+{
+	if (config.algorithm != YapDatabaseCompressionAlgorithmZlib) return nil;
+	if (data.length < MAX(config.minimumLength, (NSUInteger)YAP_COMPRESSION_HEADER_SIZE)) return nil;
+	if (data.length > UINT32_MAX) return nil;
+	
+	YapCompressionContext *context = YapCompressionContextGet();
+	if (context == NULL) return nil;
+	
+	int level = MAX(1, MIN(9, config.level));
+	
+	if (context->deflaterReady && context->deflaterLevel == level)
+	{
+		deflateReset(&context->deflater);
+	}
+	else
+	{
+		if (context->deflaterReady)
+		{
+			deflateEnd(&context->deflater);
+			context->deflaterReady = NO;
+		}
+		
+		// Negative windowBits == raw deflate (no zlib header or adler32 trailer).
+		// Our own header already records everything we need.
+		
+		memset(&context->deflater, 0, sizeof(z_stream));
+		if (deflateInit2(&context->deflater, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			return nil;
+		}
+		
+		context->deflaterReady = YES;
+		context->deflaterLevel = level;
+	}
+	
+	z_stream *stream = &context->deflater;
+	
+	if (dictionary.length > 0)
+	{
+		if (deflateSetDictionary(stream, dictionary.bytes, (uInt)dictionary.length) != Z_OK) {
+			return nil;
+		}
+	}
+	
+	size_t bound = YAP_COMPRESSION_HEADER_SIZE + deflateBound(stream, (uLong)data.length);
+	if (!YapCompressionEnsureBuffer(&context->deflateBuffer, &context->deflateBufferSize, bound)) {
+		return nil;
+	}
+	
+	stream->next_in = (Bytef *)data.bytes;
+	stream->avail_in = (uInt)data.length;
+	stream->next_out = context->deflateBuffer + YAP_COMPRESSION_HEADER_SIZE;
+	stream->avail_out = (uInt)(bound - YAP_COMPRESSION_HEADER_SIZE);
+	
+	if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+		return nil;
+	}
+	
+	size_t compressedLength = YAP_COMPRESSION_HEADER_SIZE + stream->total_out;
+	if (compressedLength >= data.length) {
+		return nil;
+	}
+	
+	YapCompressionWriteHeader(context->deflateBuffer,
+	                          YapDatabaseCompressionAlgorithmZlib, dictionaryId, (uint32_t)data.length);
+	
+	return [NSData dataWithBytes:context->deflateBuffer length:compressedLength];
+}
+
+NSData *YapDatabaseCompressionWrapData(NSData *data)
+{
+	NSMutableData *wrapped = [NSMutableData dataWithLength:YAP_COMPRESSION_HEADER_SIZE];
+	
+	YapCompressionWriteHeader((uint8_t *)wrapped.mutableBytes,
+	                          YapDatabaseCompressionAlgorithmNone, 0, (uint32_t)MIN(data.length, UINT32_MAX));
+	
+	[wrapped appendData:data];
+	return wrapped;
+}
+
+const void *YapDatabaseDecompressBytes(const void *bytes, size_t length,
+                                       NSData *dictionary,
+                                       size_t *decompressedLengthPtr)
+{
+	YapDatabaseCompressionAlgorithm algorithm = YapDatabaseCompressionAlgorithmNone;
+	uint32_t uncompressedLength = 0;
+	
+	if (!YapDatabaseCompressionReadHeader(bytes, length, &algorithm, NULL, &uncompressedLength)) {
+		return NULL;
+	}
+	
+	const uint8_t *payload = (const uint8_t *)bytes + YAP_COMPRESSION_HEADER_SIZE;
+	size_t payloadLength = length - YAP_COMPRESSION_HEADER_SIZE;
+	
+	if (algorithm == YapDatabaseCompressionAlgorithmNone)
+	{
+		if (decompressedLengthPtr) *decompressedLengthPtr = payloadLength;
+		return payload;
+	}
+	
+	if (algorithm != YapDatabaseCompressionAlgorithmZlib) {
+		return NULL;
+	}
+	
+	YapCompressionContext *context = YapCompressionContextGet();
+	if (context == NULL) return NULL;
+	
+	if (context->inflaterReady)
+	{
+		inflateReset(&context->inflater);
+	}
+	else
+	{
+		memset(&context->inflater, 0, sizeof(z_stream));
+		if (inflateInit2(&context->inflater, -15) != Z_OK) {
+			return NULL;
+		}
+		
+		context->inflaterReady = YES;
+	}
+	
+	z_stream *stream = &context->inflater;
+	
+	if (dictionary.length > 0)
+	{
+		if (inflateSetDictionary(stream, dictionary.bytes, (uInt)dictionary.length) != Z_OK) {
+			return NULL;
+		}
+	}
+	
+	if (!YapCompressionEnsureBuffer(&context->inflateBuffer, &context->inflateBufferSize, MAX(uncompressedLength, 1))) {
+		return NULL;
+	}
+	
+	stream->next_in = (Bytef *)payload;
+	stream->avail_in = (uInt)payloadLength;
+	stream->next_out = context->inflateBuffer;
+	stream->avail_out = uncompressedLength;
+	
+	if (inflate(stream, Z_FINISH) != Z_STREAM_END || stream->total_out != uncompressedLength) {
+		return NULL;
+	}
+	
+	if (decompressedLengthPtr) *decompressedLengthPtr = uncompressedLength;
+	return context->inflateBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Training
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+	uint32_t sample;
+	uint32_t offset;
+	uint32_t length;
+	uint64_t score;
+} YapTrainSegment;
+
+NS_INLINE uint32_t YapTrainHash(const uint8_t *ptr)
+{
+	uint64_t value;
+	memcpy(&value, ptr, sizeof(uint64_t));
+	
+	return (uint32_t)((value * 0x9E3779B97F4A7C15ULL) >> (64 - TRAIN_HASH_BITS));
+}
+
+/**
+ * A segment's score is the number of other samples in which each of its substrings appear.
+**/
+static uint64_t YapTrainScore(const uint8_t *ptr, size_t length, const uint32_t *counts)
+{
+	if (length < TRAIN_GRAM_SIZE) return 0;
+	
+	uint64_t score = 0;
+	for (size_t i = 0; i <= (length - TRAIN_GRAM_SIZE); i++)
+	{
+		uint32_t count = counts[YapTrainHash(ptr + i)];
+		if (count > 1) {
+			score += (count - 1);
+		}
+	}
+	
+	return score;
+}
+
+static int YapTrainSegmentCompare(const void *a, const void *b)
+{
+	uint64_t scoreA = ((const YapTrainSegment *)a)->score;
+	uint64_t scoreB = ((const YapTrainSegment *)b)->score;
+	
+	if (scoreA > scoreB) return -1;
+	if (scoreA < scoreB) return  1;
+	return 0;
+}
+
+NSData *YapDatabaseTrainCompressionDictionary(NSArray<NSData *> *samples, NSUInteger dictionarySize)
+{
+	dictionarySize = MIN(dictionarySize, YapDatabaseCompressionMaxDictionarySize);
+	if (dictionarySize == 0 || samples.count < 2) return nil;
+	
+	size_t const tableSize = ((size_t)1 << TRAIN_HASH_BITS);
+	
+	uint32_t *counts   = calloc(tableSize, sizeof(uint32_t));
+	uint32_t *lastSeen = calloc(tableSize, sizeof(uint32_t));
+	
+	if (counts == NULL || lastSeen == NULL)
+	{
+		free(counts);
+		free(lastSeen);
+		return nil;
+	}
+	
+	// Pass 1:
+	// Count the number of samples in which each substring appears.
+	// Repeats within a single sample don't count, as deflate can already find those without a dictionary.
+	
+	uint32_t sampleNum = 0;
+	for (NSData *sample in samples)
+	{
+		sampleNum++;
+		
+		const uint8_t *ptr = (const uint8_t *)sample.bytes;
+		NSUInteger length = sample.length;
+		
+		if (length < TRAIN_GRAM_SIZE) continue;
+		
+		for (NSUInteger i = 0; i <= (length - TRAIN_GRAM_SIZE); i++)
+		{
+			uint32_t hash = YapTrainHash(ptr + i);
+			if (lastSeen[hash] != sampleNum)
+			{
+				lastSeen[hash] = sampleNum;
+				counts[hash]++;
+			}
+		}
+	}
+	
+	free(lastSeen);
+	
+	// Pass 2:
+	// Score every segment of every sample.
+	
+	NSMutableData *segmentsData = [NSMutableData data];
+	
+	uint32_t sampleIdx = 0;
+	for (NSData *sample in samples)
+	{
+		const uint8_t *ptr = (const uint8_t *)sample.bytes;
+		NSUInteger length = MIN(sample.length, (NSUInteger)UINT32_MAX);
+		
+		for (NSUInteger offset = 0; (offset + TRAIN_GRAM_SIZE) <= length; offset += TRAIN_SEGMENT_SIZE)
+		{
+			YapTrainSegment segment;
+			segment.sample = sampleIdx;
+			segment.offset = (uint32_t)offset;
+			segment.length = (uint32_t)MIN((NSUInteger)TRAIN_SEGMENT_SIZE, length - offset);
+			segment.score = YapTrainScore(ptr + offset, segment.length, counts);
+			
+			if (segment.score > 0) {
+				[segmentsData appendBytes:&segment length:sizeof(YapTrainSegment)];
+			}
+		}
+		
+		sampleIdx++;
+	}
+	
+	YapTrainSegment *segments = (YapTrainSegment *)segmentsData.mutableBytes;
+	NSUInteger segmentsCount = segmentsData.length / sizeof(YapTrainSegment);
+	
+	qsort(segments, segmentsCount, sizeof(YapTrainSegment), YapTrainSegmentCompare);
+	
+	// Pass 3:
+	// Greedily select the best segments.
+	//
+	// Once a segment is selected, its substrings no longer count towards the score of other segments.
+	// So (mostly) redundant segments get skipped.
+	
+	NSMutableIndexSet *selected = [NSMutableIndexSet indexSet];
+	NSUInteger selectedLength = 0;
+	
+	for (NSUInteger i = 0; i < segmentsCount && selectedLength < dictionarySize; i++)
+	{
+		YapTrainSegment *segment = &segments[i];
+		const uint8_t *ptr = (const uint8_t *)[samples[segment->sample] bytes] + segment->offset;
+		
+		uint64_t score = YapTrainScore(ptr, segment->length, counts);
+		if (score == 0 || (score * 2) < segment->score) continue;
+		
+		[selected addIndex:i];
+		selectedLength += segment->length;
+		
+		for (uint32_t j = 0; (j + TRAIN_GRAM_SIZE) <= segment->length; j++)
+		{
+			counts[YapTrainHash(ptr + j)] = 0;
+		}
+	}
+	
+	free(counts);
+	
+	if (selectedLength == 0) return nil;
+	
+	// Assemble the dictionary, with the most valuable segments at the end.
+	// If we overshot the target size, trim from the front (the least valuable segment).
+	
+	NSMutableData *dictionary = [NSMutableData dataWithCapacity:MIN(selectedLength, dictionarySize)];
+	__block NSUInteger overflow = (selectedLength > dictionarySize) ? (selectedLength - dictionarySize) : 0;
+	
+	[selected enumerateIndexesWithOptions:NSEnumerationReverse usingBlock:^(NSUInteger idx, BOOL __unused *stop) {
+		
+		YapTrainSegment *segment = &segments[idx];
+		const uint8_t *ptr = (const uint8_t *)[samples[segment->sample] bytes] + segment->offset;
+		NSUInteger length = segment->length;
+		
+		if (overflow > 0)
+		{
+			NSUInteger trim = MIN(overflow, length);
+			ptr += trim;
+			length -= trim;
+			overflow -= trim;
+		}
+		
+		if (length > 0) {
+			[dictionary appendBytes:ptr length:length];
+		}
+	}];
+	
+	return dictionary;
+}
+
+NSUInteger YapDatabaseCompressedLengthOfSamples(NSArray<NSData *> *samples,
+                                                YapDatabaseCompressionConfig *config,
+                                                NSData *dictionary)
+{
+	NSUInteger total = 0;
+	
+	for (NSData *sample in samples)
+	{
+		NSData *compressed = YapDatabaseCompressData(sample, config, 0, dictionary);
+		total += compressed ? compressed.length : sample.length;
+	}
+	
+	return total;
+}
@@ -16,9 +16,21 @@
  * @see YapDatabaseConnection metadataCacheEnabled
  * @see YapDatabaseConnection metadataCacheLimit
  * 
+ * @see YapDatabaseConnection objectCacheCostLimit
+ * @see YapDatabaseConnection metadataCacheCostLimit
+ * @see YapDatabaseConnection objectCacheCostBlock
+ * @see YapDatabaseConnection metadataCacheCostBlock
+ * 
+ * @see YapDatabaseConnection objectCacheAdmissionPolicy
+ * @see YapDatabaseConnection metadataCacheAdmissionPolicy
+ * 
  * @see YapDatabaseConnection objectPolicy
  * @see YapDatabaseConnection metadataPolicy
  * 
+ * @see YapDatabaseConnection pageCacheSize
+ * @see YapDatabaseConnection pageCacheMaximumSize
+ * @see YapDatabaseConnection pageCacheSpillEnabled
+ * 
  * @see YapDatabaseConnection autoFlushMemoryLevel
 **/
 @interface YapDatabaseConnectionConfig : NSObject <NSCopying>
@@ -29,9 +41,22 @@
 @property (atomic, assign, readwrite) BOOL metadataCacheEnabled;
 @property (atomic, assign, readwrite) NSUInteger metadataCacheLimit;
 
+@property (atomic, assign, readwrite) NSUInteger objectCacheCostLimit;
+@property (atomic, assign, readwrite) NSUInteger metadataCacheCostLimit;
+
+@property (atomic, copy, readwrite) YapDatabaseCacheCostBlock objectCacheCostBlock;
+@property (atomic, copy, readwrite) YapDatabaseCacheCostBlock metadataCacheCostBlock;
+
+@property (atomic, assign, readwrite) YapCacheAdmissionPolicy objectCacheAdmissionPolicy;
+@property (atomic, assign, readwrite) YapCacheAdmissionPolicy metadataCacheAdmissionPolicy;
+
 @property (atomic, assign, readwrite) YapDatabasePolicy objectPolicy;
 @property (atomic, assign, readwrite) YapDatabasePolicy metadataPolicy;
 
+@property (atomic, assign, readwrite) NSUInteger pageCacheSize;
+@property (atomic, assign, readwrite) NSUInteger pageCacheMaximumSize;
+@property (atomic, assign, readwrite) BOOL pageCacheSpillEnabled;
+
 #if TARGET_OS_IOS || TARGET_OS_TV
 @property (atomic, assign, readwrite) YapDatabaseConnectionFlushMemoryFlags autoFlushMemoryFlags;
 #endif
@@ -12,9 +12,22 @@ static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
 @synthesize metadataCacheEnabled = metadataCacheEnabled;
 @synthesize metadataCacheLimit = metadataCacheLimit;
 
+@synthesize objectCacheCostLimit = objectCacheCostLimit;
+@synthesize metadataCacheCostLimit = metadataCacheCostLimit;
+
+@synthesize objectCacheCostBlock = objectCacheCostBlock;
+@synthesize metadataCacheCostBlock = metadataCacheCostBlock;
+
+@synthesize objectCacheAdmissionPolicy = objectCacheAdmissionPolicy;
+@synthesize metadataCacheAdmissionPolicy = metadataCacheAdmissionPolicy;
+
 @synthesize objectPolicy = objectPolicy;
 @synthesize metadataPolicy = metadataPolicy;
 
+@synthesize pageCacheSize = pageCacheSize;
+@synthesize pageCacheMaximumSize = pageCacheMaximumSize;
+@synthesize pageCacheSpillEnabled = pageCacheSpillEnabled;
+
 #if TARGET_OS_IOS || TARGET_OS_TV
 @synthesize autoFlushMemoryFlags = autoFlushMemoryFlags;
 #endif
@@ -32,6 +45,8 @@ static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
 		objectPolicy = YapDatabasePolicyContainment;
 		metadataPolicy = YapDatabasePolicyContainment;
 		
+		pageCacheSpillEnabled = YES;
+		
 		#if TARGET_OS_IOS || TARGET_OS_TV
 		autoFlushMemoryFlags = YapDatabaseConnectionFlushMemoryFlags_All;
 		#endif
@@ -49,9 +64,22 @@ static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
 	copy->metadataCacheEnabled = self.metadataCacheEnabled;
 	copy->metadataCacheLimit = self.metadataCacheLimit;
 	
+	copy->objectCacheCostLimit = self.objectCacheCostLimit;
+	copy->metadataCacheCostLimit = self.metadataCacheCostLimit;
+	
+	copy->objectCacheCostBlock = self.objectCacheCostBlock;
+	copy->metadataCacheCostBlock = self.metadataCacheCostBlock;
+	
+	copy->objectCacheAdmissionPolicy = self.objectCacheAdmissionPolicy;
+	copy->metadataCacheAdmissionPolicy = self.metadataCacheAdmissionPolicy;
+	
 	copy->objectPolicy = self.objectPolicy;
 	copy->metadataPolicy = self.metadataPolicy;
 	
+	copy->pageCacheSize = self.pageCacheSize;
+	copy->pageCacheMaximumSize = self.pageCacheMaximumSize;
+	copy->pageCacheSpillEnabled = self.pageCacheSpillEnabled;
+	
 	#if TARGET_OS_IOS || TARGET_OS_TV
 	copy->autoFlushMemoryFlags = self.autoFlushMemoryFlags;
 	#endif
@@ -15,6 +15,8 @@ extern const NSUInteger kSQLCipherKeySpecLength;
 
 typedef void (^YapDatabaseSaltBlock)(NSData *saltData);
 typedef void (^YapDatabaseKeySpecBlock)(NSData *keySpecData);
+typedef void (^YapDatabaseConversionProgressBlock)(double progress);
+typedef void (^YapDatabaseConversionCompletionBlock)(NSError *_Nullable error);
 
 // This class contains utility methods for use with SQLCipher encrypted
 // databases, specifically to address an issue around database files that
@@ -103,6 +105,11 @@ typedef void (^YapDatabaseKeySpecBlock)(NSData *keySpecData);
 //   and keyspec for this database.  These values will be needed when
 //   opening the database, so they should presumably stored in the
 //   keychain (like the database password).
+// * On large databases (or slow devices) the conversion may take a while,
+//   mostly due to key derivation and checkpointing the WAL.
+//   Use asyncConvertDatabaseIfNecessary to convert in the background instead.
+// * If the conversion is interrupted (e.g. the app is terminated),
+//   the next call to either method resumes it.
 //
 //
 // Creating new databases with unencrypted headers:
@@ -140,6 +147,20 @@ typedef void (^YapDatabaseKeySpecBlock)(NSData *keySpecData);
                                        saltBlock:(YapDatabaseSaltBlock)saltBlock
                                     keySpecBlock:(YapDatabaseKeySpecBlock)keySpecBlock;
 
+// Same as above, but the conversion runs asynchronously, on a background (utility QoS) queue.
+//
+// * The saltBlock and keySpecBlock are invoked on the background queue, before the database is modified.
+// * The progressBlock (0.0 - 1.0) and completionBlock are invoked on the completionQueue (main queue if NULL).
+// * The completionBlock receives nil if the conversion succeeded, or wasn't needed.
+// * Don't open the database until the completionBlock has been invoked.
++ (void)asyncConvertDatabaseIfNecessary:(NSString *)databaseFilePath
+                       databasePassword:(NSData *)databasePassword
+                              saltBlock:(YapDatabaseSaltBlock)saltBlock
+                           keySpecBlock:(YapDatabaseKeySpecBlock)keySpecBlock
+                          progressBlock:(nullable YapDatabaseConversionProgressBlock)progressBlock
+                        completionQueue:(nullable dispatch_queue_t)completionQueue
+                        completionBlock:(nullable YapDatabaseConversionCompletionBlock)completionBlock;
+
 // This method can be used to derive a SQLCipher "key spec" from a
 // database password and salt.  Key spec derivation is somewhat costly.
 // The key spec is needed every time the database file is opened
@@ -148,6 +169,15 @@ typedef void (^YapDatabaseKeySpecBlock)(NSData *keySpecData);
 // YapDatabase.
 + (nullable NSData *)databaseKeySpecForPassword:(NSData *)passwordData saltData:(NSData *)saltData;
 
+// Same as above, but with explicit key derivation parameters.
+// These must match the parameters SQLCipher uses to derive the key from the password.
+// That is, the values of "PRAGMA kdf_iter" and "PRAGMA cipher_kdf_algorithm" (e.g. "PBKDF2_HMAC_SHA512").
+// Pass nil for kdfAlgorithm to use PBKDF2_HMAC_SHA1 (the only algorithm before SQLCipher 4).
++ (nullable NSData *)databaseKeySpecForPassword:(NSData *)passwordData
+                                       saltData:(NSData *)saltData
+                                  kdfIterations:(NSUInteger)kdfIterations
+                                   kdfAlgorithm:(nullable NSString *)kdfAlgorithm;
+
 #pragma mark - Utils
 
 + (NSString *)hexadecimalStringForData:(NSData *)data;
@@ -170,52 +170,67 @@ NSError *YDBErrorWithDescription(NSString *description)
     return [self convertDatabase:databaseFilePath
                 databasePassword:databasePassword
                        saltBlock:saltBlock
-                    keySpecBlock:keySpecBlock];
+                    keySpecBlock:keySpecBlock
+                   progressBlock:nil];
 }
 
-+ (nullable NSError *)convertDatabase:(NSString *)databaseFilePath
-                     databasePassword:(NSData *)databasePassword
-                            saltBlock:(YapDatabaseSaltBlock)saltBlock
-                         keySpecBlock:(YapDatabaseKeySpecBlock)keySpecBlock
++ (void)asyncConvertDatabaseIfNecessary:(NSString *)databaseFilePath
+                       databasePassword:(NSData *)databasePassword
+                              saltBlock:(YapDatabaseSaltBlock)saltBlock
+                           keySpecBlock:(YapDatabaseKeySpecBlock)keySpecBlock
+                          progressBlock:(nullable YapDatabaseConversionProgressBlock)progressBlock
+                        completionQueue:(nullable dispatch_queue_t)completionQueue
+                        completionBlock:(nullable YapDatabaseConversionCompletionBlock)completionBlock
 {
-    YapAssert(databaseFilePath.length > 0);
-    YapAssert(databasePassword.length > 0);
-    YapAssert(saltBlock);
-    YapAssert(keySpecBlock);
-
-    NSData *saltData;
-    {
-        NSData *headerData = [self readFirstNBytesOfDatabaseFile:databaseFilePath byteCount:kSqliteHeaderLength];
-        YapAssert(headerData);
-
-        YapAssert(headerData.length >= kSQLCipherSaltLength);
-        saltData = [headerData subdataWithRange:NSMakeRange(0, kSQLCipherSaltLength)];
+    if (completionQueue == NULL) {
+        completionQueue = dispatch_get_main_queue();
+    }
 
-        // Make sure we successfully persist the salt (persumably in the keychain) before
-        // proceeding with the database conversion or we could leave the app in an
-        // unrecoverable state.
-        saltBlock(saltData);
+    YapDatabaseConversionProgressBlock _Nullable reportProgress = nil;
+    if (progressBlock) {
+        reportProgress = ^(double progress) {
+            dispatch_async(completionQueue, ^{
+                progressBlock(progress);
+            });
+        };
     }
 
-    {
-        NSData *_Nullable keySpecData = [self databaseKeySpecForPassword:databasePassword saltData:saltData];
-        if (!keySpecData || keySpecData.length != kSQLCipherKeySpecLength) {
-            YDBLogError(@"Error deriving key spec");
-            return YDBErrorWithDescription(@"Invalid key spec");
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{ @autoreleasepool {
+
+        NSError *_Nullable error = nil;
+        if ([self doesDatabaseNeedToBeConverted:databaseFilePath]) {
+            error = [self convertDatabase:databaseFilePath
+                         databasePassword:databasePassword
+                                saltBlock:saltBlock
+                             keySpecBlock:keySpecBlock
+                            progressBlock:reportProgress];
+        } else if (reportProgress) {
+            reportProgress(1.0);
         }
 
-        YapAssert(keySpecData.length == kSQLCipherKeySpecLength);
+        if (completionBlock) {
+            dispatch_async(completionQueue, ^{
+                completionBlock(error);
+            });
+        }
+    }});
+}
 
-        // Make sure we successfully persist the key spec (persumably in the keychain) before
-        // proceeding with the database conversion or we could leave the app in an
-        // unrecoverable state.
-        keySpecBlock(keySpecData);
-    }
+// Opens the database, keys it with the database password, and verifies the key.
+//
+// If saltData is non-nil, the database is opened as a converted database.
+// That is, with the salt and the unencrypted header (i.e. "Option A").
++ (nullable NSError *)openDatabase:(NSString *)databaseFilePath
+                  databasePassword:(NSData *)databasePassword
+                          saltData:(nullable NSData *)saltData
+                                db:(sqlite3 *_Nullable *_Nonnull)dbOut
+{
+    *dbOut = NULL;
 
     // -----------------------------------------------------------
     //
     // This block was derived from [Yapdatabase openDatabase].
-    sqlite3 *db;
+    sqlite3 *db = NULL;
     int status;
     {
         int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
@@ -225,9 +240,9 @@ NSError *YDBErrorWithDescription(NSString *description)
             // One possibility is if the database file has become corrupt.
 
             // Sometimes the open function returns a db to allow us to query it for the error message.
-            // The openConfigCreate block will close it for us.
             if (db) {
                 YDBLogError(@"Error opening database: %d %s", status, sqlite3_errmsg(db));
+                sqlite3_close(db);
             } else {
                 YDBLogError(@"Error opening database: %d", status);
             }
@@ -245,10 +260,137 @@ NSError *YDBErrorWithDescription(NSString *description)
         status = sqlite3_key(db, [keyData bytes], (int)[keyData length]);
         if (status != SQLITE_OK) {
             YDBLogError(@"Error setting SQLCipher key: %d %s", status, sqlite3_errmsg(db));
+            sqlite3_close(db);
             return YDBErrorWithDescription(@"Failed to set SQLCipher key");
         }
+
+        if (saltData) {
+            NSString *saltPragma =
+                [NSString stringWithFormat:@"PRAGMA cipher_salt = \"x'%@'\";", [self hexadecimalStringForData:saltData]];
+            NSString *headerPragma =
+                [NSString stringWithFormat:@"PRAGMA cipher_plaintext_header_size = %zd;", kSqliteHeaderLength];
+
+            NSError *_Nullable error = [self executeSql:saltPragma db:db label:@"PRAGMA cipher_salt"];
+            if (!error) {
+                error = [self executeSql:headerPragma db:db label:headerPragma];
+            }
+            if (error) {
+                sqlite3_close(db);
+                return error;
+            }
+        }
     }
 
+    // SQLCipher doesn't verify the key until the first page is read.
+    status = sqlite3_exec(db, "SELECT count(*) FROM sqlite_master;", NULL, NULL, NULL);
+    if (status != SQLITE_OK) {
+        sqlite3_close(db);
+        return YDBErrorWithDescription(@"Failed to read database with the given key");
+    }
+
+    *dbOut = db;
+    return nil;
+}
+
+// A previous conversion may have been interrupted after the converted first page was committed to the WAL,
+// but before it was checkpointed into the database file. The database file still has an encrypted header,
+// but the database can now only be read as a converted database.
+//
+// This is only possible if there's a (non-empty) WAL file.
++ (BOOL)mayHaveInterruptedConversion:(NSString *)databaseFilePath
+{
+    NSString *walFilePath = [databaseFilePath stringByAppendingString:@"-wal"];
+
+    NSDictionary *_Nullable attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:walFilePath error:NULL];
+    return ([attributes fileSize] > 0);
+}
+
++ (nullable NSError *)convertDatabase:(NSString *)databaseFilePath
+                     databasePassword:(NSData *)databasePassword
+                            saltBlock:(YapDatabaseSaltBlock)saltBlock
+                         keySpecBlock:(YapDatabaseKeySpecBlock)keySpecBlock
+                        progressBlock:(nullable YapDatabaseConversionProgressBlock)progressBlock
+{
+    YapAssert(databaseFilePath.length > 0);
+    YapAssert(databasePassword.length > 0);
+    YapAssert(saltBlock);
+    YapAssert(keySpecBlock);
+
+    NSData *saltData;
+    {
+        NSData *headerData = [self readFirstNBytesOfDatabaseFile:databaseFilePath byteCount:kSqliteHeaderLength];
+        YapAssert(headerData);
+
+        YapAssert(headerData.length >= kSQLCipherSaltLength);
+        saltData = [headerData subdataWithRange:NSMakeRange(0, kSQLCipherSaltLength)];
+
+        // Make sure we successfully persist the salt (persumably in the keychain) before
+        // proceeding with the database conversion or we could leave the app in an
+        // unrecoverable state.
+        saltBlock(saltData);
+    }
+
+    if (progressBlock) progressBlock(0.1);
+
+    // Every attempt to open the database performs the (costly) key derivation.
+    // So we only attempt to resume an interrupted conversion if it's possible there was one.
+    sqlite3 *db = NULL;
+    BOOL isResuming = NO;
+
+    if ([self mayHaveInterruptedConversion:databaseFilePath]) {
+        NSError *_Nullable error = [self openDatabase:databaseFilePath
+                                     databasePassword:databasePassword
+                                             saltData:saltData
+                                                   db:&db];
+        if (!error) {
+            YDBLogInfo(@"%@ Resuming interrupted database conversion.", self.logTag);
+            isResuming = YES;
+        }
+    }
+
+    if (!isResuming) {
+        NSError *_Nullable error = [self openDatabase:databaseFilePath
+                                     databasePassword:databasePassword
+                                             saltData:nil
+                                                   db:&db];
+        if (error) {
+            YDBLogError(@"%@ Error opening database for conversion: %@", self.logTag, error);
+            return error;
+        }
+    }
+
+    if (progressBlock) progressBlock(0.4);
+
+    {
+        // Derive the key spec with the same parameters SQLCipher uses for this database.
+        NSString *_Nullable kdfIterString =
+            [self executeSingleStringQuery:@"PRAGMA kdf_iter;" db:db label:@"kdf_iter" isOptional:YES];
+        NSString *_Nullable kdfAlgorithm =
+            [self executeSingleStringQuery:@"PRAGMA cipher_kdf_algorithm;" db:db label:@"kdf algorithm" isOptional:YES];
+
+        // See: PBKDF2_ITER.
+        NSUInteger kdfIterations = (kdfIterString.longLongValue > 0) ? (NSUInteger)kdfIterString.longLongValue : 64000;
+
+        NSData *_Nullable keySpecData = [self databaseKeySpecForPassword:databasePassword
+                                                                saltData:saltData
+                                                           kdfIterations:kdfIterations
+                                                            kdfAlgorithm:kdfAlgorithm];
+        if (!keySpecData || keySpecData.length != kSQLCipherKeySpecLength) {
+            YDBLogError(@"Error deriving key spec");
+            sqlite3_close(db);
+            return YDBErrorWithDescription(@"Invalid key spec");
+        }
+
+        YapAssert(keySpecData.length == kSQLCipherKeySpecLength);
+
+        // Make sure we successfully persist the key spec (persumably in the keychain) before
+        // proceeding with the database conversion or we could leave the app in an
+        // unrecoverable state.
+        keySpecBlock(keySpecData);
+    }
+
+    if (progressBlock) progressBlock(0.6);
+
     // -----------------------------------------------------------
     //
     // This block was derived from [Yapdatabase configureDatabase].
@@ -257,6 +399,7 @@ NSError *YDBErrorWithDescription(NSString *description)
                                                  db:db
                                               label:@"PRAGMA journal_mode = WAL"];
         if (error) {
+            sqlite3_close(db);
             return error;
         }
 
@@ -307,10 +450,11 @@ NSError *YDBErrorWithDescription(NSString *description)
     // We can obtain the database salt in two ways: by reading the first 16 bytes of the encrypted
     // header OR by using "PRAGMA cipher_salt".  In DEBUG builds, we verify that these two values
     // match.
-    {
+    if (!isResuming) {
         NSString *_Nullable saltString =
-            [self executeSingleStringQuery:@"PRAGMA cipher_salt;" db:db label:@"extracting database salt"];
+            [self executeSingleStringQuery:@"PRAGMA cipher_salt;" db:db label:@"extracting database salt" isOptional:NO];
 
+        YapAssert(saltString.length == kSqliteHeaderLength);
         YapAssert([[self hexadecimalStringForData:saltData] isEqualToString:saltString]);
     }
 #endif
@@ -318,13 +462,18 @@ NSError *YDBErrorWithDescription(NSString *description)
     // -----------------------------------------------------------
     //
     // SQLCipher migration
-    {
+    //
+    // With cipher_plaintext_header_size, only the format of the first page changes.
+    // Every other page is encrypted exactly as before. So rewriting the first page is all that's needed,
+    // and the WAL serves as the journal: until the checkpoint below completes, the database file is untouched.
+    if (!isResuming) {
         NSString *setPlainTextHeaderPragma =
         [NSString stringWithFormat:@"PRAGMA cipher_plaintext_header_size = %zd;", kSqliteHeaderLength];
         NSError *_Nullable error = [self executeSql:setPlainTextHeaderPragma
                                                  db:db
                                               label:setPlainTextHeaderPragma];
         if (error) {
+            sqlite3_close(db);
             return error;
         }
 
@@ -338,20 +487,30 @@ NSError *YDBErrorWithDescription(NSString *description)
                               db:db
                            label:modificationSQL];
         if (error) {
+            sqlite3_close(db);
             return error;
         }
+    }
+
+    if (progressBlock) progressBlock(0.7);
 
+    {
         // Force a checkpoint so that the plaintext is written to the actual DB file, not just living in the WAL.
+        //
+        // If this is interrupted, the next conversion attempt resumes here.
         int log, ckpt;
-        status = sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_FULL, &log, &ckpt);
+        int status = sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_FULL, &log, &ckpt);
         if (status != SQLITE_OK) {
             YDBLogError(@"%@ Error forcing checkpoint. status: %d, log: %d, ckpt: %d, error: %s", self.logTag, status, log, ckpt, sqlite3_errmsg(db));
+            sqlite3_close(db);
             return YDBErrorWithDescription(@"Error forcing checkpoint.");
         }
 
         sqlite3_close(db);
     }
 
+    if (progressBlock) progressBlock(1.0);
+
     return nil;
 }
 
@@ -373,7 +532,12 @@ NSError *YDBErrorWithDescription(NSString *description)
     return nil;
 }
 
-+ (nullable NSString *)executeSingleStringQuery:(NSString *)sql db:(sqlite3 *)db label:(NSString *)label
+// If isOptional, a missing value isn't an error.
+// E.g. pragmas that don't exist in every version of SQLCipher.
++ (nullable NSString *)executeSingleStringQuery:(NSString *)sql
+                                             db:(sqlite3 *)db
+                                          label:(NSString *)label
+                                     isOptional:(BOOL)isOptional
 {
     sqlite3_stmt *statement;
 
@@ -385,13 +549,15 @@ NSError *YDBErrorWithDescription(NSString *description)
 
     status = sqlite3_step(statement);
     if (status != SQLITE_ROW) {
-        YDBLogError(@"%@ Missing %@: %d, error: %s", self.logTag, label, status, sqlite3_errmsg(db));
+        if (!isOptional) {
+            YDBLogError(@"%@ Missing %@: %d, error: %s", self.logTag, label, status, sqlite3_errmsg(db));
+        }
+        sqlite3_finalize(statement);
         return nil;
     }
 
     const unsigned char *valueBytes = sqlite3_column_text(statement, 0);
     int valueLength = sqlite3_column_bytes(statement, 0);
-    YapAssert(valueLength == kSqliteHeaderLength);
     YapAssert(valueBytes != NULL);
 
     NSString *result =
@@ -403,31 +569,49 @@ NSError *YDBErrorWithDescription(NSString *description)
     return result;
 }
 
-+ (nullable NSData *)deriveDatabaseKeyForPassword:(NSData *)passwordData saltData:(NSData *)saltData
++ (nullable NSData *)deriveDatabaseKeyForPassword:(NSData *)passwordData
+                                         saltData:(NSData *)saltData
+                                    kdfIterations:(NSUInteger)kdfIterations
+                                     kdfAlgorithm:(nullable NSString *)kdfAlgorithm
 {
     YapAssert(passwordData.length > 0);
     YapAssert(saltData.length == kSQLCipherSaltLength);
+    YapAssert(kdfIterations > 0 && kdfIterations <= UINT_MAX);
+
+    // These are the values of "PRAGMA cipher_kdf_algorithm" (SQLCipher 4).
+    // Earlier versions of SQLCipher always use PBKDF2_HMAC_SHA1.
+    CCPseudoRandomAlgorithm prf = kCCPRFHmacAlgSHA1;
+    if ([kdfAlgorithm isEqualToString:@"PBKDF2_HMAC_SHA512"]) {
+        prf = kCCPRFHmacAlgSHA512;
+    } else if ([kdfAlgorithm isEqualToString:@"PBKDF2_HMAC_SHA256"]) {
+        prf = kCCPRFHmacAlgSHA256;
+    } else if (kdfAlgorithm && ![kdfAlgorithm isEqualToString:@"PBKDF2_HMAC_SHA1"]) {
+        YDBLogError(@"Unsupported kdf algorithm: %@", kdfAlgorithm);
+        return nil;
+    }
 
     unsigned char *derivedKeyBytes = malloc((size_t)kSQLCipherDerivedKeyLength);
     YapAssert(derivedKeyBytes);
-    // See: PBKDF2_ITER.
-    const unsigned int workfactor = 64000;
+    const unsigned int workfactor = (unsigned int)kdfIterations;
 
     int result = CCKeyDerivationPBKDF(kCCPBKDF2,
         passwordData.bytes,
         (size_t)passwordData.length,
         saltData.bytes,
         (size_t)saltData.length,
-        kCCPRFHmacAlgSHA1,
+        prf,
         workfactor,
         derivedKeyBytes,
         kSQLCipherDerivedKeyLength);
     if (result != kCCSuccess) {
         YDBLogError(@"Error deriving key: %d", result);
+        free(derivedKeyBytes);
         return nil;
     }
 
     NSData *_Nullable derivedKeyData = [NSData dataWithBytes:derivedKeyBytes length:kSQLCipherDerivedKeyLength];
+    memset_s(derivedKeyBytes, kSQLCipherDerivedKeyLength, 0, kSQLCipherDerivedKeyLength);
+    free(derivedKeyBytes);
     if (!derivedKeyData || derivedKeyData.length != kSQLCipherDerivedKeyLength) {
         YDBLogError(@"Invalid derived key: %d", result);
         return nil;
@@ -441,7 +625,22 @@ NSError *YDBErrorWithDescription(NSString *description)
     YapAssert(passwordData.length > 0);
     YapAssert(saltData.length == kSQLCipherSaltLength);
 
-    NSData *_Nullable derivedKeyData = [self deriveDatabaseKeyForPassword:passwordData saltData:saltData];
+    // See: PBKDF2_ITER.
+    return [self databaseKeySpecForPassword:passwordData saltData:saltData kdfIterations:64000 kdfAlgorithm:nil];
+}
+
++ (nullable NSData *)databaseKeySpecForPassword:(NSData *)passwordData
+                                       saltData:(NSData *)saltData
+                                  kdfIterations:(NSUInteger)kdfIterations
+                                   kdfAlgorithm:(nullable NSString *)kdfAlgorithm
+{
+    YapAssert(passwordData.length > 0);
+    YapAssert(saltData.length == kSQLCipherSaltLength);
+
+    NSData *_Nullable derivedKeyData = [self deriveDatabaseKeyForPassword:passwordData
+                                                                 saltData:saltData
+                                                            kdfIterations:kdfIterations
+                                                             kdfAlgorithm:kdfAlgorithm];
     if (!derivedKeyData || derivedKeyData.length != kSQLCipherDerivedKeyLength) {
         YDBLogError(@"Error deriving key");
         return nil;
@@ -0,0 +1,70 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The order in which a cursor walks its collection.
+ *
+ * YapDatabaseCursorOrderRowid:
+ *   Rows are returned in rowid order (which is roughly insertion order).
+ *   This is the cheapest order, as it walks the table itself.
+ *   Rows inserted after the cursor's position are picked up by later pages.
+ *
+ * YapDatabaseCursorOrderKey:
+ *   Rows are returned in ascending key order (compared bytewise, as UTF-8).
+ *   This walks the (collection, key) index.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseCursorOrder) {
+	YapDatabaseCursorOrderRowid = 0,
+	YapDatabaseCursorOrderKey   = 1,
+};
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A cursor allows you to page through a (potentially very large) collection across multiple transactions.
+ * Each page is fetched via -[YapDatabaseReadTransaction enumerateKeysAndObjectsWithCursor:limit:usingBlock:],
+ * which resumes immediately after the last row returned by the previous page (keyset pagination).
+ *
+ * Since each page is a short transaction, a long running job doesn't hold a snapshot open
+ * (which would otherwise prevent the WAL from being checkpointed).
+ * The tradeoff is that the pages are NOT taken from a single snapshot.
+ * Changes committed between pages will be reflected in later pages (if they're after the cursor's position).
+ *
+ * The cursor supports NSSecureCoding, so its position may be persisted, and resumed later (even after a relaunch).
+**/
+@interface YapDatabaseCursor : NSObject <NSCopying, NSSecureCoding>
+
+/**
+ * Creates a cursor positioned before the first row of the given collection.
+**/
+- (instancetype)initWithCollection:(nullable NSString *)collection order:(YapDatabaseCursorOrder)order;
+
+@property (nonatomic, copy, readonly) NSString *collection;
+@property (nonatomic, assign, readonly) YapDatabaseCursorOrder order;
+
+/**
+ * The position of the cursor, which is the last row returned.
+ *
+ * For YapDatabaseCursorOrderRowid, this is lastRowid (or zero if no rows have been returned yet).
+ * For YapDatabaseCursorOrderKey, this is lastKey (or nil if no rows have been returned yet).
+**/
+@property (nonatomic, assign, readonly) int64_t lastRowid;
+@property (nonatomic, copy, readonly, nullable) NSString *lastKey;
+
+/**
+ * Set to YES once a page returns fewer rows than requested (without being stopped by the block).
+ *
+ * A cursor that's exhausted may still be used. Any rows added beyond its position will be returned.
+**/
+@property (nonatomic, assign, readonly) BOOL isExhausted;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,76 @@
+#import "YapDatabaseCursor.h"
+#import "YapDatabaseCursorPrivate.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+
+@implementation YapDatabaseCursor
+
+@synthesize collection = collection;
+@synthesize order = order;
+@synthesize lastRowid = lastRowid;
+@synthesize lastKey = lastKey;
+@synthesize isExhausted = isExhausted;
+
++ (BOOL)supportsSecureCoding
+{
+	return YES;
+}
+
+- (instancetype)initWithCollection:(NSString *)inCollection order:(YapDatabaseCursorOrder)inOrder
+{
+	if ((self = [super init]))
+	{
+		collection = inCollection ? [inCollection copy] : @"";
+		order = inOrder;
+	}
+	return self;
+}
+
+- (id)initWithCoder:(NSCoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		collection  = [decoder decodeObjectOfClass:[NSString class] forKey:@"collection"];
+		order       = [decoder decodeIntegerForKey:@"order"];
+		lastRowid   = [decoder decodeInt64ForKey:@"lastRowid"];
+		lastKey     = [decoder decodeObjectOfClass:[NSString class] forKey:@"lastKey"];
+		isExhausted = [decoder decodeBoolForKey:@"isExhausted"];
+		
+		if (collection == nil) collection = @"";
+	}
+	return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder
+{
+	[coder encodeObject:collection   forKey:@"collection"];
+	[coder encodeInteger:order       forKey:@"order"];
+	[coder encodeInt64:lastRowid     forKey:@"lastRowid"];
+	[coder encodeObject:lastKey      forKey:@"lastKey"];
+	[coder encodeBool:isExhausted    forKey:@"isExhausted"];
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	YapDatabaseCursor *copy = [[YapDatabaseCursor alloc] initWithCollection:collection order:order];
+	copy->lastRowid = lastRowid;
+	copy->lastKey = lastKey;
+	copy->isExhausted = isExhausted;
+	
+	return copy;
+}
+
+- (NSString *)description
+{
+	if (order == YapDatabaseCursorOrderKey)
+		return [NSString stringWithFormat:@"<YapDatabaseCursor[%p] collection(%@) lastKey(%@)%@>",
+		          self, collection, lastKey, (isExhausted ? @" exhausted" : @"")];
+	else
+		return [NSString stringWithFormat:@"<YapDatabaseCursor[%p] collection(%@) lastRowid(%lld)%@>",
+		          self, collection, lastRowid, (isExhausted ? @" exhausted" : @"")];
+}
+
+@end
@@ -0,0 +1,82 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * I/O statistics count (and time) every read, write, sync & truncate that sqlite issues to the file system.
+ * See YapDatabaseOptions.enableIOStatistics & -[YapDatabase ioStatistics].
+ *
+ * The numbers are aggregated per kind of file (across every connection).
+ * So, for example, you can tell whether a slow commit was spent syncing the WAL,
+ * or copying pages into the database file during a checkpoint.
+**/
+
+typedef NS_ENUM(NSInteger, YapDatabaseIOFile) {
+	YapDatabaseIOFileMain    = 0, // The database file
+	YapDatabaseIOFileWAL     = 1, // The write-ahead log
+	YapDatabaseIOFileJournal = 2, // The rollback journal (not normally used in WAL mode)
+	YapDatabaseIOFileOther   = 3, // Temp databases, statement journals, etc
+};
+
+typedef NS_ENUM(NSInteger, YapDatabaseIOOperation) {
+	YapDatabaseIOOperationRead     = 0,
+	YapDatabaseIOOperationWrite    = 1,
+	YapDatabaseIOOperationSync     = 2, // i.e. fsync / F_FULLFSYNC
+	YapDatabaseIOOperationTruncate = 3,
+};
+
+/**
+ * The number of buckets in each latency histogram.
+ *
+ * The buckets are powers of two (in microseconds).
+ * Bucket 0 holds everything under 2 microseconds, and bucket N holds [2^N, 2^(N+1)) microseconds.
+ * The last bucket also holds everything above it (i.e. everything over ~8 seconds).
+**/
+extern const NSUInteger YapDatabaseIOLatencyBucketCount;
+
+
+@interface YapDatabaseIOStatistics : NSObject <NSCopying>
+
+/**
+ * Returns the number of times the operation was performed on the given kind of file.
+**/
+- (uint64_t)countForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file;
+
+/**
+ * Returns the number of bytes transferred by the operation on the given kind of file.
+ * Only applies to reads & writes (zero for other operations).
+**/
+- (uint64_t)bytesForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file;
+
+/**
+ * Returns the total time spent performing the operation on the given kind of file.
+**/
+- (NSTimeInterval)durationForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file;
+
+/**
+ * Returns the latency histogram for the operation on the given kind of file.
+ * The array has YapDatabaseIOLatencyBucketCount entries; each entry is the number of operations within the bucket.
+**/
+- (NSArray<NSNumber *> *)latencyHistogramForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file;
+
+/**
+ * Returns the lower bound (in seconds) of the given latency bucket.
+**/
++ (NSTimeInterval)lowerBoundForLatencyBucket:(NSUInteger)bucket;
+
+/** Convenience: the sums across every kind of file. **/
+@property (nonatomic, assign, readonly) uint64_t totalBytesRead;
+@property (nonatomic, assign, readonly) uint64_t totalBytesWritten;
+@property (nonatomic, assign, readonly) uint64_t totalSyncCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,146 @@
+#import "YapDatabaseIOStatistics.h"
+#import "YapDatabaseIOStatisticsPrivate.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+const NSUInteger YapDatabaseIOLatencyBucketCount = YAP_IO_LATENCY_BUCKET_COUNT;
+
+// The public enums are simply the shim's enums, so they can be used to index into the stats directly.
+
+_Static_assert((int)YapDatabaseIOFileMain    == (int)yap_file_kind_main,    "YapDatabaseIOFile mismatch");
+_Static_assert((int)YapDatabaseIOFileWAL     == (int)yap_file_kind_wal,     "YapDatabaseIOFile mismatch");
+_Static_assert((int)YapDatabaseIOFileJournal == (int)yap_file_kind_journal, "YapDatabaseIOFile mismatch");
+_Static_assert((int)YapDatabaseIOFileOther   == (int)yap_file_kind_other,   "YapDatabaseIOFile mismatch");
+
+_Static_assert((int)YapDatabaseIOOperationRead     == (int)yap_io_op_read,     "YapDatabaseIOOperation mismatch");
+_Static_assert((int)YapDatabaseIOOperationWrite    == (int)yap_io_op_write,    "YapDatabaseIOOperation mismatch");
+_Static_assert((int)YapDatabaseIOOperationSync     == (int)yap_io_op_sync,     "YapDatabaseIOOperation mismatch");
+_Static_assert((int)YapDatabaseIOOperationTruncate == (int)yap_io_op_truncate, "YapDatabaseIOOperation mismatch");
+
+
+@implementation YapDatabaseIOStatistics
+{
+	yap_io_file_stats stats[yap_file_kind_count];
+}
+
+- (instancetype)initWithFileStats:(const yap_io_file_stats *)fileStats
+{
+	if ((self = [super init]))
+	{
+		memcpy(stats, fileStats, sizeof(stats));
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable
+}
+
+- (const yap_io_op_stats *)statsForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file
+{
+	if (file < 0 || file >= yap_file_kind_count) return NULL;
+	if (operation < 0 || operation >= yap_io_op_count) return NULL;
+	
+	return &stats[file].ops[operation];
+}
+
+- (uint64_t)countForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file
+{
+	const yap_io_op_stats *opStats = [self statsForOperation:operation file:file];
+	return opStats ? opStats->count : 0;
+}
+
+- (uint64_t)bytesForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file
+{
+	const yap_io_op_stats *opStats = [self statsForOperation:operation file:file];
+	return opStats ? opStats->bytes : 0;
+}
+
+- (NSTimeInterval)durationForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file
+{
+	const yap_io_op_stats *opStats = [self statsForOperation:operation file:file];
+	return opStats ? ((double)opStats->nanoseconds / (double)NSEC_PER_SEC) : 0.0;
+}
+
+- (NSArray<NSNumber *> *)latencyHistogramForOperation:(YapDatabaseIOOperation)operation file:(YapDatabaseIOFile)file
+{
+	const yap_io_op_stats *opStats = [self statsForOperation:operation file:file];
+	
+	NSMutableArray<NSNumber *> *histogram = [NSMutableArray arrayWithCapacity:YAP_IO_LATENCY_BUCKET_COUNT];
+	for (NSUInteger bucket = 0; bucket < YAP_IO_LATENCY_BUCKET_COUNT; bucket++)
+	{
+		[histogram addObject:@(opStats ? opStats->latency[bucket] : 0)];
+	}
+	
+	return histogram;
+}
+
++ (NSTimeInterval)lowerBoundForLatencyBucket:(NSUInteger)bucket
+{
+	if (bucket == 0) return 0.0;
+	
+	bucket = MIN(bucket, (NSUInteger)(YAP_IO_LATENCY_BUCKET_COUNT - 1));
+	return (double)(1ULL << bucket) / (double)USEC_PER_SEC;
+}
+
+- (uint64_t)totalBytesRead
+{
+	uint64_t total = 0;
+	for (int kind = 0; kind < yap_file_kind_count; kind++)
+	{
+		total += stats[kind].ops[yap_io_op_read].bytes;
+	}
+	
+	return total;
+}
+
+- (uint64_t)totalBytesWritten
+{
+	uint64_t total = 0;
+	for (int kind = 0; kind < yap_file_kind_count; kind++)
+	{
+		total += stats[kind].ops[yap_io_op_write].bytes;
+	}
+	
+	return total;
+}
+
+- (uint64_t)totalSyncCount
+{
+	uint64_t total = 0;
+	for (int kind = 0; kind < yap_file_kind_count; kind++)
+	{
+		total += stats[kind].ops[yap_io_op_sync].count;
+	}
+	
+	return total;
+}
+
+- (NSString *)description
+{
+	NSArray<NSString *> *fileNames = @[ @"main", @"wal", @"journal", @"other" ];
+	NSArray<NSString *> *opNames = @[ @"read", @"write", @"sync", @"truncate" ];
+	
+	NSMutableString *description = [NSMutableString string];
+	[description appendFormat:@"<YapDatabaseIOStatistics[%p]:", self];
+	
+	for (int kind = 0; kind < yap_file_kind_count; kind++)
+	{
+		for (int op = 0; op < yap_io_op_count; op++)
+		{
+			const yap_io_op_stats *opStats = &stats[kind].ops[op];
+			if (opStats->count == 0) continue;
+			
+			[description appendFormat:@" %@.%@(count=%llu, bytes=%llu, ms=%.3f)",
+			  fileNames[kind], opNames[op], opStats->count, opStats->bytes, (double)opStats->nanoseconds / 1000000.0];
+		}
+	}
+	
+	[description appendString:@">"];
+	return description;
+}
+
+@end
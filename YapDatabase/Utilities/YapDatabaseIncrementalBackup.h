@@ -0,0 +1,83 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * Incremental backups are created via -[YapDatabaseConnection incrementalBackupToPath:].
+ *
+ * Each backup file contains a set of database pages:
+ * - A full backup contains every page of the database.
+ * - Every other backup contains only the pages that changed since the previous backup (its parent).
+ *
+ * A chain of backups (a full backup, followed by each of its descendants, in order)
+ * can be turned back into a database file via rebuildDatabaseAtPath:fromBackupsAtPaths:.
+ *
+ * This class also allows you to inspect a backup file, e.g. in order to manage your chains.
+**/
+@interface YapDatabaseIncrementalBackup : NSObject
+
+/**
+ * Reads the header of the given backup file.
+ * Returns nil if the file doesn't exist, or isn't an incremental backup.
+**/
+- (nullable instancetype)initWithPath:(NSString *)path;
+
+@property (nonatomic, copy, readonly) NSString *path;
+
+/**
+ * Uniquely identifies the backup.
+**/
+@property (nonatomic, strong, readonly) NSUUID *backupId;
+
+/**
+ * The backupId of the previous backup in the chain. (Which must be applied before this one.)
+ * This is nil for a full backup.
+**/
+@property (nonatomic, strong, readonly, nullable) NSUUID *parentBackupId;
+
+@property (nonatomic, assign, readonly) BOOL isFullBackup;
+
+/**
+ * The page size of the database (in bytes).
+**/
+@property (nonatomic, assign, readonly) NSUInteger pageSize;
+
+/**
+ * The size of the database (in pages) at the moment the backup was taken.
+**/
+@property (nonatomic, assign, readonly) NSUInteger databasePageCount;
+
+/**
+ * The number of pages stored in the backup file.
+**/
+@property (nonatomic, assign, readonly) NSUInteger pageCount;
+
+/**
+ * Rebuilds a database file from a chain of backups.
+ *
+ * @param databasePath
+ *   Where to write the database file.
+ *   If a file already exists at this path, it is replaced (along with any -wal & -shm files).
+ *   Thus it's your responsibility to ensure nothing is using the file.
+ *
+ * @param backupPaths
+ *   The chain of backups, in order.
+ *   The first must be a full backup, and each subsequent backup must be a child of the one before it.
+ *   You don't need to pass the entire chain. Any prefix of it rebuilds the database as it was at that point.
+ *
+ * @return
+ *   nil if the database was rebuilt. Otherwise an error describing the problem.
+**/
++ (nullable NSError *)rebuildDatabaseAtPath:(NSString *)databasePath fromBackupsAtPaths:(NSArray<NSString *> *)backupPaths;
+
+@end
+
+NS_ASSUME_NONNULL_END
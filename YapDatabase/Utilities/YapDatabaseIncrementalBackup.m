@@ -0,0 +1,415 @@
+#import "YapDatabaseIncrementalBackup.h"
+#import "YapDatabaseIncrementalBackupPrivate.h"
+#import "YapDatabaseLogging.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+static const char YapDatabaseIncrementalBackupMagic[8] = { 'Y','D','B','I','N','C','B','K' };
+
+static void YapWriteUInt32(uint8_t *bytes, uint32_t value)
+{
+	bytes[0] = (uint8_t)(value);
+	bytes[1] = (uint8_t)(value >> 8);
+	bytes[2] = (uint8_t)(value >> 16);
+	bytes[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t YapReadUInt32(const uint8_t *bytes)
+{
+	return ((uint32_t)bytes[0])       |
+	       ((uint32_t)bytes[1] << 8)  |
+	       ((uint32_t)bytes[2] << 16) |
+	       ((uint32_t)bytes[3] << 24);
+}
+
+static BOOL YapWriteFully(int fd, const void *buffer, size_t length, off_t offset)
+{
+	const uint8_t *bytes = (const uint8_t *)buffer;
+	
+	while (length > 0)
+	{
+		ssize_t written = pwrite(fd, bytes, length, offset);
+		if (written < 0)
+		{
+			if (errno == EINTR) continue;
+			return NO;
+		}
+		
+		bytes += written;
+		offset += written;
+		length -= (size_t)written;
+	}
+	
+	return YES;
+}
+
+static BOOL YapAppendFully(int fd, const void *buffer, size_t length)
+{
+	const uint8_t *bytes = (const uint8_t *)buffer;
+	
+	while (length > 0)
+	{
+		ssize_t written = write(fd, bytes, length);
+		if (written < 0)
+		{
+			if (errno == EINTR) continue;
+			return NO;
+		}
+		
+		bytes += written;
+		length -= (size_t)written;
+	}
+	
+	return YES;
+}
+
+static NSString *YapTemporaryPath(NSString *path)
+{
+	return [path stringByAppendingPathExtension:@"tmp"];
+}
+
+static NSError *YapIncrementalBackupError(NSString *description)
+{
+	NSDictionary *userInfo = @{ NSLocalizedDescriptionKey: description };
+	return [NSError errorWithDomain:@"YapDatabase" code:0 userInfo:userInfo];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Writing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int YapDatabaseIncrementalBackupCreate(NSString *path)
+{
+	NSString *tmpPath = YapTemporaryPath(path);
+	
+	int fd = open([tmpPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		YDBLogError(@"Unable to create incremental backup: %@ (errno: %d)", tmpPath, errno);
+		return -1;
+	}
+	
+	// The header is written last (once the number of pages is known).
+	// So an incomplete file never has a valid header.
+	
+	uint8_t header[YAP_INCREMENTAL_BACKUP_HEADER_SIZE] = { 0 };
+	
+	if (!YapAppendFully(fd, header, sizeof(header)))
+	{
+		YDBLogError(@"Unable to write incremental backup: %@ (errno: %d)", tmpPath, errno);
+		YapDatabaseIncrementalBackupAbort(fd, path);
+		return -1;
+	}
+	
+	return fd;
+}
+
+BOOL YapDatabaseIncrementalBackupWritePage(int fd, uint32_t pgno, const void *page, uint32_t pageSize)
+{
+	uint8_t pgnoBytes[4];
+	YapWriteUInt32(pgnoBytes, pgno);
+	
+	return YapAppendFully(fd, pgnoBytes, sizeof(pgnoBytes)) && YapAppendFully(fd, page, pageSize);
+}
+
+BOOL YapDatabaseIncrementalBackupFinish(int fd, YapDatabaseIncrementalBackup *backup)
+{
+	uint8_t header[YAP_INCREMENTAL_BACKUP_HEADER_SIZE] = { 0 };
+	
+	memcpy(header, YapDatabaseIncrementalBackupMagic, sizeof(YapDatabaseIncrementalBackupMagic));
+	
+	YapWriteUInt32(header + 8,  YAP_INCREMENTAL_BACKUP_VERSION);
+	YapWriteUInt32(header + 12, (backup.isFullBackup ? YAP_INCREMENTAL_BACKUP_FLAG_FULL : 0));
+	YapWriteUInt32(header + 16, (uint32_t)backup.pageSize);
+	YapWriteUInt32(header + 20, (uint32_t)backup.databasePageCount);
+	YapWriteUInt32(header + 24, (uint32_t)backup.pageCount);
+	
+	[backup.backupId getUUIDBytes:(header + 32)];
+	[backup.parentBackupId getUUIDBytes:(header + 48)];
+	
+	NSString *path = backup.path;
+	NSString *tmpPath = YapTemporaryPath(path);
+	
+	BOOL result = YapWriteFully(fd, header, sizeof(header), 0);
+	if (!result)
+	{
+		YDBLogError(@"Unable to write incremental backup: %@ (errno: %d)", tmpPath, errno);
+	}
+	
+	if (result && fsync(fd) != 0)
+	{
+		YDBLogError(@"Unable to sync incremental backup: %@ (errno: %d)", tmpPath, errno);
+		result = NO;
+	}
+	
+	close(fd);
+	
+	if (result && rename([tmpPath fileSystemRepresentation], [path fileSystemRepresentation]) != 0)
+	{
+		YDBLogError(@"Unable to rename incremental backup: %@ (errno: %d)", path, errno);
+		result = NO;
+	}
+	
+	if (!result) {
+		unlink([tmpPath fileSystemRepresentation]);
+	}
+	
+	return result;
+}
+
+void YapDatabaseIncrementalBackupAbort(int fd, NSString *path)
+{
+	if (fd >= 0) {
+		close(fd);
+	}
+	
+	unlink([YapTemporaryPath(path) fileSystemRepresentation]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseIncrementalBackup
+
+@synthesize path = path;
+@synthesize backupId = backupId;
+@synthesize parentBackupId = parentBackupId;
+@synthesize pageSize = pageSize;
+@synthesize databasePageCount = databasePageCount;
+@synthesize pageCount = pageCount;
+
+@dynamic isFullBackup;
+
+- (instancetype)initWithPath:(NSString *)inPath
+                    backupId:(NSUUID *)inBackupId
+              parentBackupId:(NSUUID *)inParentBackupId
+                    pageSize:(NSUInteger)inPageSize
+           databasePageCount:(NSUInteger)inDatabasePageCount
+                   pageCount:(NSUInteger)inPageCount
+{
+	if ((self = [super init]))
+	{
+		path = [inPath copy];
+		backupId = inBackupId;
+		parentBackupId = inParentBackupId;
+		pageSize = inPageSize;
+		databasePageCount = inDatabasePageCount;
+		pageCount = inPageCount;
+	}
+	return self;
+}
+
+- (instancetype)initWithPath:(NSString *)inPath
+{
+	if (inPath == nil) return nil;
+	
+	FILE *file = fopen([inPath fileSystemRepresentation], "rb");
+	if (file == NULL) return nil;
+	
+	uint8_t header[YAP_INCREMENTAL_BACKUP_HEADER_SIZE];
+	size_t headerLength = fread(header, 1, sizeof(header), file);
+	
+	fclose(file);
+	
+	if (headerLength != sizeof(header)) return nil;
+	if (memcmp(header, YapDatabaseIncrementalBackupMagic, sizeof(YapDatabaseIncrementalBackupMagic)) != 0) return nil;
+	
+	uint32_t version = YapReadUInt32(header + 8);
+	if (version != YAP_INCREMENTAL_BACKUP_VERSION)
+	{
+		YDBLogWarn(@"Unsupported incremental backup version (%u): %@", version, inPath);
+		return nil;
+	}
+	
+	uint32_t flags = YapReadUInt32(header + 12);
+	
+	NSUUID *inBackupId = [[NSUUID alloc] initWithUUIDBytes:(header + 32)];
+	NSUUID *inParentBackupId = nil;
+	
+	if ((flags & YAP_INCREMENTAL_BACKUP_FLAG_FULL) == 0) {
+		inParentBackupId = [[NSUUID alloc] initWithUUIDBytes:(header + 48)];
+	}
+	
+	return [self initWithPath:inPath
+	                 backupId:inBackupId
+	           parentBackupId:inParentBackupId
+	                 pageSize:YapReadUInt32(header + 16)
+	        databasePageCount:YapReadUInt32(header + 20)
+	                pageCount:YapReadUInt32(header + 24)];
+}
+
+- (BOOL)isFullBackup
+{
+	return (parentBackupId == nil);
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YapDatabaseIncrementalBackup[%p] %@ full(%@) pages(%lu/%lu)>",
+	          self, [backupId UUIDString], (self.isFullBackup ? @"YES" : @"NO"),
+	          (unsigned long)pageCount, (unsigned long)databasePageCount];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Rebuild
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Copies each page record of the backup into the database file,
+ * and then truncates (or extends) the file to the size of the database at the moment the backup was taken.
+**/
+- (NSError *)applyToFileDescriptor:(int)fd
+{
+	FILE *file = fopen([path fileSystemRepresentation], "rb");
+	if (file == NULL)
+	{
+		return YapIncrementalBackupError([NSString stringWithFormat:@"Unable to open backup: %@", path]);
+	}
+	
+	NSError *error = nil;
+	
+	if (fseeko(file, YAP_INCREMENTAL_BACKUP_HEADER_SIZE, SEEK_SET) != 0)
+	{
+		error = YapIncrementalBackupError([NSString stringWithFormat:@"Unable to read backup: %@", path]);
+	}
+	
+	uint8_t *record = malloc(4 + pageSize);
+	
+	for (NSUInteger i = 0; i < pageCount && error == nil; i++)
+	{
+		if (fread(record, 1, 4 + pageSize, file) != (4 + pageSize))
+		{
+			error = YapIncrementalBackupError([NSString stringWithFormat:@"Truncated backup: %@", path]);
+			break;
+		}
+		
+		uint32_t pgno = YapReadUInt32(record);
+		if (pgno == 0 || pgno > databasePageCount)
+		{
+			error = YapIncrementalBackupError([NSString stringWithFormat:@"Corrupt backup: %@", path]);
+			break;
+		}
+		
+		off_t offset = (off_t)(pgno - 1) * (off_t)pageSize;
+		
+		if (!YapWriteFully(fd, record + 4, pageSize, offset))
+		{
+			error = YapIncrementalBackupError([NSString stringWithFormat:@"Unable to write page (errno: %d)", errno]);
+		}
+	}
+	
+	free(record);
+	fclose(file);
+	
+	if (error == nil && ftruncate(fd, (off_t)databasePageCount * (off_t)pageSize) != 0)
+	{
+		error = YapIncrementalBackupError([NSString stringWithFormat:@"Unable to truncate database (errno: %d)", errno]);
+	}
+	
+	return error;
+}
+
++ (NSError *)rebuildDatabaseAtPath:(NSString *)databasePath fromBackupsAtPaths:(NSArray<NSString *> *)backupPaths
+{
+	// Validate the chain before touching anything.
+	
+	NSMutableArray<YapDatabaseIncrementalBackup *> *backups = [NSMutableArray arrayWithCapacity:backupPaths.count];
+	
+	for (NSString *backupPath in backupPaths)
+	{
+		YapDatabaseIncrementalBackup *backup = [[YapDatabaseIncrementalBackup alloc] initWithPath:backupPath];
+		if (backup == nil)
+		{
+			return YapIncrementalBackupError([NSString stringWithFormat:@"Not an incremental backup: %@", backupPath]);
+		}
+		
+		YapDatabaseIncrementalBackup *previous = [backups lastObject];
+		if (previous == nil)
+		{
+			if (!backup.isFullBackup) {
+				return YapIncrementalBackupError(@"The first backup must be a full backup");
+			}
+		}
+		else
+		{
+			if (![backup.parentBackupId isEqual:previous.backupId]) {
+				return YapIncrementalBackupError(
+				  [NSString stringWithFormat:@"Backup isn't a child of the previous backup: %@", backupPath]);
+			}
+			
+			if (backup.pageSize != previous.pageSize) {
+				return YapIncrementalBackupError(
+				  [NSString stringWithFormat:@"Backup has a different page size: %@", backupPath]);
+			}
+		}
+		
+		[backups addObject:backup];
+	}
+	
+	if (backups.count == 0)
+	{
+		return YapIncrementalBackupError(@"No backups given");
+	}
+	
+	NSString *tmpPath = YapTemporaryPath(databasePath);
+	
+	int fd = open([tmpPath fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		return YapIncrementalBackupError([NSString stringWithFormat:@"Unable to create: %@ (errno: %d)", tmpPath, errno]);
+	}
+	
+	NSError *error = nil;
+	
+	for (YapDatabaseIncrementalBackup *backup in backups)
+	{
+		error = [backup applyToFileDescriptor:fd];
+		if (error) break;
+	}
+	
+	if (error == nil && fsync(fd) != 0)
+	{
+		error = YapIncrementalBackupError([NSString stringWithFormat:@"Unable to sync: %@ (errno: %d)", tmpPath, errno]);
+	}
+	
+	close(fd);
+	
+	if (error == nil)
+	{
+		// A leftover WAL would be applied (by sqlite) on top of the rebuilt database.
+		
+		unlink([[databasePath stringByAppendingString:@"-wal"] fileSystemRepresentation]);
+		unlink([[databasePath stringByAppendingString:@"-shm"] fileSystemRepresentation]);
+		
+		if (rename([tmpPath fileSystemRepresentation], [databasePath fileSystemRepresentation]) != 0)
+		{
+			error = YapIncrementalBackupError(
+			  [NSString stringWithFormat:@"Unable to rename: %@ (errno: %d)", databasePath, errno]);
+		}
+	}
+	
+	if (error) {
+		unlink([tmpPath fileSystemRepresentation]);
+	}
+	
+	return error;
+}
+
+@end
@@ -0,0 +1,71 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A memory report lists the estimated number of bytes held by each subsystem (component).
+ * See -[YapDatabase memoryReport] & -[YapDatabaseConnection memoryReport].
+ *
+ * The numbers are estimates.
+ * Objects are measured via their (shallow) malloc size, plus the contents of NSData & NSString instances.
+ * Memory that's shared between multiple holders (e.g. an object in both the objectCache & a view's pageCache)
+ * is counted by each holder.
+ *
+ * Extension components are prefixed with the registered name of the extension.
+ * For example, "myView.pageCache" or "myFTS.statements".
+**/
+
+/** Connection: the objectCache, metadataCache & keyCache. **/
+extern NSString *const YapDatabaseMemoryComponentObjectCache;
+extern NSString *const YapDatabaseMemoryComponentMetadataCache;
+extern NSString *const YapDatabaseMemoryComponentKeyCache;
+
+/** Connection: sqlite3_db_status(SQLITE_DBSTATUS_CACHE_USED), i.e. cached database pages. **/
+extern NSString *const YapDatabaseMemoryComponentSQLitePageCache;
+
+/** Connection: sqlite3_db_status(SQLITE_DBSTATUS_STMT_USED), minus the statements attributed to extensions. **/
+extern NSString *const YapDatabaseMemoryComponentSQLiteStatements;
+
+/** Connection: sqlite3_db_status(SQLITE_DBSTATUS_SCHEMA_USED). **/
+extern NSString *const YapDatabaseMemoryComponentSQLiteSchema;
+
+/** Database: every registered YapMemoryTable (e.g. non-persistent views), including old versions. **/
+extern NSString *const YapDatabaseMemoryComponentMemoryTables;
+
+/** Database: the shared object cache (see YapDatabaseOptions.enableSharedObjectCache). **/
+extern NSString *const YapDatabaseMemoryComponentSharedObjectCache;
+
+
+@interface YapDatabaseMemoryReport : NSObject <NSCopying>
+
+/**
+ * Maps from component name to estimated bytes.
+**/
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, NSNumber *> *components;
+
+/**
+ * The sum of all components.
+**/
+@property (nonatomic, assign, readonly) uint64_t totalBytes;
+
+/**
+ * Returns the estimated bytes for the given component, or zero if the component isn't in the report.
+**/
+- (uint64_t)bytesForComponent:(NSString *)component;
+
+/**
+ * Returns the component names, sorted by estimated bytes (largest first).
+**/
+- (NSArray<NSString *> *)sortedComponents;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,135 @@
+#import "YapDatabaseMemoryReport.h"
+#import "YapDatabaseMemoryReportPrivate.h"
+
+#import <malloc/malloc.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+NSString *const YapDatabaseMemoryComponentObjectCache       = @"objectCache";
+NSString *const YapDatabaseMemoryComponentMetadataCache     = @"metadataCache";
+NSString *const YapDatabaseMemoryComponentKeyCache          = @"keyCache";
+NSString *const YapDatabaseMemoryComponentSQLitePageCache   = @"sqlite.pageCache";
+NSString *const YapDatabaseMemoryComponentSQLiteStatements  = @"sqlite.statements";
+NSString *const YapDatabaseMemoryComponentSQLiteSchema      = @"sqlite.schema";
+NSString *const YapDatabaseMemoryComponentMemoryTables      = @"memoryTables";
+NSString *const YapDatabaseMemoryComponentSharedObjectCache = @"sharedObjectCache";
+
+
+uint64_t YapDatabaseEstimatedObjectSize(id object)
+{
+	if (object == nil) return 0;
+	
+	// Note: malloc_size returns zero for pointers that weren't allocated via malloc (e.g. tagged pointers).
+	uint64_t size = (uint64_t)malloc_size((__bridge const void *)object);
+	if (size == 0) return 0;
+	
+	if ([object isKindOfClass:[NSData class]])
+	{
+		size += [(NSData *)object length];
+	}
+	else if ([object isKindOfClass:[NSString class]])
+	{
+		size += [(NSString *)object length];
+	}
+	
+	return size;
+}
+
+uint64_t YapDatabaseStatementMemoryUsed(sqlite3_stmt *statement)
+{
+#ifdef SQLITE_STMTSTATUS_MEMUSED
+	if (statement) {
+		return (uint64_t)MAX(sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_MEMUSED, 0), 0);
+	}
+#endif
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseMemoryReport
+
+@synthesize components = components;
+@synthesize totalBytes = totalBytes;
+
+- (instancetype)initWithComponents:(NSDictionary<NSString *, NSNumber *> *)inComponents
+{
+	if ((self = [super init]))
+	{
+		components = [inComponents copy];
+		
+		for (NSNumber *bytes in [components objectEnumerator])
+		{
+			totalBytes += [bytes unsignedLongLongValue];
+		}
+	}
+	return self;
+}
+
++ (YapDatabaseMemoryReport *)reportByMergingReports:(NSArray<YapDatabaseMemoryReport *> *)reports
+{
+	NSMutableDictionary<NSString *, NSNumber *> *merged = [NSMutableDictionary dictionary];
+	
+	for (YapDatabaseMemoryReport *report in reports)
+	{
+		[report->components enumerateKeysAndObjectsUsingBlock:^(NSString *component, NSNumber *bytes, BOOL __unused *stop) {
+			
+			uint64_t total = [merged[component] unsignedLongLongValue] + [bytes unsignedLongLongValue];
+			merged[component] = @(total);
+		}];
+	}
+	
+	return [[YapDatabaseMemoryReport alloc] initWithComponents:merged];
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable
+}
+
+- (uint64_t)bytesForComponent:(NSString *)component
+{
+	return [components[component] unsignedLongLongValue];
+}
+
+- (NSArray<NSString *> *)sortedComponents
+{
+	return [components keysSortedByValueUsingComparator:^NSComparisonResult(NSNumber *bytes1, NSNumber *bytes2) {
+		
+		return [bytes2 compare:bytes1]; // largest first
+	}];
+}
+
+- (NSString *)description
+{
+	NSMutableString *description = [NSMutableString string];
+	[description appendFormat:@"<YapDatabaseMemoryReport[%p]: total(%llu)", self, totalBytes];
+	
+	for (NSString *component in [self sortedComponents])
+	{
+		[description appendFormat:@" %@(%llu)", component, [self bytesForComponent:component]];
+	}
+	
+	[description appendString:@">"];
+	return description;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseMemoryHolder
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<YapDatabaseMemoryHolder[%p]: component(%@), bytes(%llu), flushFlags(%lu)>",
+	        self, component, bytes, (unsigned long)flushFlags];
+}
+
+@end
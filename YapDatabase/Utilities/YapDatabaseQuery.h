@@ -94,6 +94,30 @@ NS_ASSUME_NONNULL_BEGIN
                                 parameters:(NSArray *)queryParameters;
 
 
+#pragma mark Compiled Queries
+
+/**
+ * Returns a query with the same queryString (and aggregateFunction), but with the given parameters.
+ *
+ * Extensions expand a query into a full SQL statement (e.g. 'SELECT "rowid" FROM "table" WHERE ...'),
+ * and keep the prepared sqlite statement in a per-connection cache, keyed by that SQL.
+ * The returned query shares the expanded SQL with the receiver.
+ * So if you run the same query shape repeatedly, create it once, hold onto it,
+ * and derive each execution via this method. The extension then skips formatting the SQL,
+ * and goes straight to the prepared statement (just rebinding the parameters).
+ *
+ * For example:
+ *
+ * self.threadQuery = [YapDatabaseQuery queryWithFormat:@"WHERE threadId = ? ORDER BY date DESC", @(0)];
+ * ...
+ * query = [self.threadQuery queryWithParameters:@[ @(threadId) ]];
+ *
+ * Array parameters change the queryString (as they're expanded to one '?' per element).
+ * So if the receiver, or the given parameters, contain arrays, this method simply creates a new query
+ * (as if it was created via queryWithString:parameters:), which doesn't share anything with the receiver.
+**/
+- (instancetype)queryWithParameters:(NSArray *)queryParameters;
+
 #pragma mark Properties
 
 @property (nonatomic, copy, readonly) NSString *aggregateFunction;
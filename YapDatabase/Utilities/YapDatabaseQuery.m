@@ -1,4 +1,6 @@
 #import "YapDatabaseQuery.h"
+#import "YapDatabaseQueryPrivate.h"
+#import "YapDatabaseAtomic.h"
 #import "YapDatabaseLogging.h"
 
 #if ! __has_feature(objc_arc)
@@ -16,6 +18,44 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+/**
+ * The memoized SQL of a query shape (shared by a query, and all the queries derived from it).
+ * Queries may be used on multiple threads, so access is protected by a lock.
+ *
+ * Only queries that are used as a template (via queryWithParameters:) get a cache.
+ * So one-off queries don't pay for it.
+**/
+@interface YapDatabaseQuerySQLCache : NSObject {
+@public
+	
+	YAPUnfairLock lock;
+	NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSString *> *> *dict; // kind -> name -> sql
+}
+@end
+
+@implementation YapDatabaseQuerySQLCache
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		lock = YAP_UNFAIR_LOCK_INIT;
+		dict = [[NSMutableDictionary alloc] initWithCapacity:2];
+	}
+	return self;
+}
+
+@end
+
+/**
+ * Protects the (lazy) creation of the sqlCache of a query.
+**/
+static YAPUnfairLock sqlCacheCreationLock = YAP_UNFAIR_LOCK_INIT;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 
 /**
  * A YapDatabaseQuery is used to pass SQL style queries into various extension classes.
@@ -45,6 +85,12 @@
  * query = [YapDatabaseQuery queryWithFormat:@"WHERE title = ? AND department IN (?)", @"manager", departments];
 **/
 @implementation YapDatabaseQuery
+{
+	NSString *format;       // the queryString before array parameters were expanded
+	BOOL hasExpandedArrays;
+	
+	YapDatabaseQuerySQLCache *sqlCache;
+}
 
 #pragma mark Standard Queries
 
@@ -316,9 +362,15 @@
 			
 		}];
 		
-		return [[YapDatabaseQuery alloc] initWithAggregateFunction:inAggregateFunction
-		                                               queryString:queryString
-		                                           queryParameters:queryParameters];
+		YapDatabaseQuery *query =
+		  [[YapDatabaseQuery alloc] initWithAggregateFunction:inAggregateFunction
+		                                          queryString:queryString
+		                                      queryParameters:queryParameters];
+		
+		query->format = [inQueryString copy];
+		query->hasExpandedArrays = YES;
+		
+		return query;
 	}
 	else
 	{
@@ -347,6 +399,8 @@
 		aggregateFunction = [inAggregateFunction copy];
 		queryString = [inQueryString copy];
 		queryParameters = [inQueryParameters copy];
+		
+		format = queryString;
 	}
 	return self;
 }
@@ -356,4 +410,100 @@
 	return (aggregateFunction != nil);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Compiled Queries
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (instancetype)queryWithParameters:(NSArray *)inQueryParameters
+{
+	BOOL hasArrays = hasExpandedArrays;
+	if (!hasArrays)
+	{
+		for (id param in inQueryParameters)
+		{
+			if ([param isKindOfClass:[NSArray class]])
+			{
+				hasArrays = YES;
+				break;
+			}
+		}
+	}
+	
+	if (hasArrays)
+	{
+		return [[self class] queryWithAggregateFunction:aggregateFunction
+		                                    queryString:format
+		                                     parameters:inQueryParameters
+		                                 paramLocations:nil];
+	}
+	
+	// The receiver may be used on multiple threads, so its cache is created under a (global) lock.
+	
+	YapDatabaseQuerySQLCache *sharedSQLCache = nil;
+	
+	YAPUnfairLockLock(&sqlCacheCreationLock);
+	{
+		if (sqlCache == nil) {
+			sqlCache = [[YapDatabaseQuerySQLCache alloc] init];
+		}
+		sharedSQLCache = sqlCache;
+	}
+	YAPUnfairLockUnlock(&sqlCacheCreationLock);
+	
+	YapDatabaseQuery *query =
+	  [[YapDatabaseQuery alloc] initWithAggregateFunction:aggregateFunction
+	                                          queryString:queryString
+	                                      queryParameters:inQueryParameters];
+	
+	query->sqlCache = sharedSQLCache;
+	return query;
+}
+
+- (NSString *)fullQueryStringForKind:(NSString *)kind
+                      registeredName:(NSString *)registeredName
+                          usingBlock:(NSString * (^)(void))block
+{
+	YapDatabaseQuerySQLCache *cache = nil;
+	
+	YAPUnfairLockLock(&sqlCacheCreationLock);
+	{
+		cache = sqlCache;
+	}
+	YAPUnfairLockUnlock(&sqlCacheCreationLock);
+	
+	if (cache == nil)
+	{
+		// Not a compiled query
+		return block();
+	}
+	
+	NSString *sql = nil;
+	
+	YAPUnfairLockLock(&cache->lock);
+	{
+		sql = cache->dict[kind][registeredName];
+	}
+	YAPUnfairLockUnlock(&cache->lock);
+	
+	if (sql == nil)
+	{
+		sql = block();
+		
+		YAPUnfairLockLock(&cache->lock);
+		{
+			NSMutableDictionary *kindDict = cache->dict[kind];
+			if (kindDict == nil)
+			{
+				kindDict = [[NSMutableDictionary alloc] initWithCapacity:1];
+				cache->dict[kind] = kindDict;
+			}
+			
+			kindDict[registeredName] = sql;
+		}
+		YAPUnfairLockUnlock(&cache->lock);
+	}
+	
+	return sql;
+}
+
 @end
@@ -0,0 +1,118 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * Queue wait statistics record how long each transaction spent waiting on the internal serial queues,
+ * as opposed to doing actual work. For example, a slow write transaction may have spent most of its time
+ * waiting for the writeQueue (i.e. for read-write transactions on other connections).
+ * See -[YapDatabaseConnection queueWaitStatistics] & -[YapDatabaseConnection setQueueWaitThreshold:block:queue:].
+**/
+
+typedef NS_ENUM(NSInteger, YapDatabaseQueueWait) {
+	
+	/**
+	 * Waiting for the connection's own queue.
+	 * That is, waiting for earlier transactions (or other work) on the same connection.
+	**/
+	YapDatabaseQueueWaitConnectionQueue = 0,
+	
+	/**
+	 * Waiting for the database's writeQueue (read-write transactions only).
+	 * That is, waiting for read-write transactions on other connections.
+	**/
+	YapDatabaseQueueWaitWriteQueue = 1,
+	
+	/**
+	 * Waiting to enter the database's snapshotQueue.
+	 * Every transaction enters it at the start (to sync its snapshot),
+	 * and every read-write transaction enters it again to hand off its changeset.
+	**/
+	YapDatabaseQueueWaitSnapshotQueue = 2,
+	
+	/**
+	 * The time spent inside the snapshotQueue (once entered).
+	 * This is the time other connections may have spent waiting on this connection.
+	**/
+	YapDatabaseQueueWaitSnapshotQueueHold = 3,
+};
+
+/**
+ * The number of buckets in each wait histogram.
+ *
+ * The buckets are powers of two (in microseconds).
+ * Bucket 0 holds everything under 2 microseconds, and bucket N holds [2^N, 2^(N+1)) microseconds.
+ * The last bucket also holds everything above it (i.e. everything over ~8 seconds).
+**/
+extern const NSUInteger YapDatabaseQueueWaitBucketCount;
+
+
+@interface YapDatabaseQueueWaitStatistics : NSObject <NSCopying>
+
+/**
+ * Returns the number of waits of the given kind.
+**/
+- (uint64_t)countForWait:(YapDatabaseQueueWait)wait;
+
+/**
+ * Returns the total (and maximum) time spent waiting.
+**/
+- (NSTimeInterval)durationForWait:(YapDatabaseQueueWait)wait;
+- (NSTimeInterval)maxDurationForWait:(YapDatabaseQueueWait)wait;
+
+/**
+ * Returns the histogram for the given kind of wait.
+ * The array has YapDatabaseQueueWaitBucketCount entries; each entry is the number of waits within the bucket.
+**/
+- (NSArray<NSNumber *> *)histogramForWait:(YapDatabaseQueueWait)wait;
+
+/**
+ * Returns the lower bound (in seconds) of the given bucket.
+**/
++ (NSTimeInterval)lowerBoundForBucket:(NSUInteger)bucket;
+
+@end
+
+#pragma mark -
+
+/**
+ * Describes a single wait that exceeded the threshold.
+ * See -[YapDatabaseConnection setQueueWaitThreshold:block:queue:].
+**/
+@interface YapDatabaseQueueWaitEvent : NSObject
+
+@property (nonatomic, assign, readonly) YapDatabaseQueueWait wait;
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/**
+ * The waiting transaction.
+ * Transaction IDs are unique (per database), and increase in the order the transactions began.
+**/
+@property (nonatomic, copy, readonly, nullable) NSString *connectionName;
+@property (nonatomic, assign, readonly) uint64_t transactionID;
+@property (nonatomic, assign, readonly) BOOL readWrite;
+
+/**
+ * The transaction that was holding the queue when the wait began.
+ *
+ * The blockingTransactionID is zero if the queue wasn't held by a transaction at that moment.
+ * For example, the connectionQueue may be busy with other work (such as processing a changeset),
+ * or the writeQueue may be busy with a checkpoint.
+ *
+ * Note that the blocking transaction may have been followed by others before the wait ended.
+**/
+@property (nonatomic, copy, readonly, nullable) NSString *blockingConnectionName;
+@property (nonatomic, assign, readonly) uint64_t blockingTransactionID;
+@property (nonatomic, assign, readonly) BOOL blockingReadWrite;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,236 @@
+#import "YapDatabaseQueueWaitStatistics.h"
+#import "YapDatabaseQueueWaitStatisticsPrivate.h"
+#import "YapDatabaseTransactionMetricsPrivate.h" // YapDatabaseTicksToSeconds
+#import "YapDatabaseAtomic.h"
+
+#import <mach/mach_time.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+const NSUInteger YapDatabaseQueueWaitBucketCount = YAP_QUEUE_WAIT_BUCKET_COUNT;
+
+_Static_assert((int)YapDatabaseQueueWaitSnapshotQueueHold == (YAP_QUEUE_WAIT_COUNT - 1), "YapDatabaseQueueWait mismatch");
+
+
+void yap_queue_wait_stats_record(yap_queue_wait_stats *stats, uint64_t ticks)
+{
+	uint64_t microseconds = (uint64_t)(YapDatabaseTicksToSeconds(ticks) * (double)USEC_PER_SEC);
+	
+	int bucket = (microseconds > 0) ? (63 - __builtin_clzll(microseconds)) : 0;
+	if (bucket >= YAP_QUEUE_WAIT_BUCKET_COUNT) {
+		bucket = YAP_QUEUE_WAIT_BUCKET_COUNT - 1;
+	}
+	
+	// Relaxed ordering is fine here: the counters are independent, and only need to be eventually visible.
+	// And since there's only one writer, the max doesn't need a compare-and-swap loop.
+	
+	atomic_fetch_add_explicit(&stats->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats->ticks, ticks, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats->buckets[bucket], 1, memory_order_relaxed);
+	
+	if (ticks > atomic_load_explicit(&stats->maxTicks, memory_order_relaxed)) {
+		atomic_store_explicit(&stats->maxTicks, ticks, memory_order_relaxed);
+	}
+}
+
+void yap_queue_wait_stats_reset(yap_queue_wait_stats *stats)
+{
+	for (int wait = 0; wait < YAP_QUEUE_WAIT_COUNT; wait++)
+	{
+		atomic_store_explicit(&stats[wait].count, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats[wait].ticks, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats[wait].maxTicks, 0, memory_order_relaxed);
+		
+		for (int bucket = 0; bucket < YAP_QUEUE_WAIT_BUCKET_COUNT; bucket++)
+		{
+			atomic_store_explicit(&stats[wait].buckets[bucket], 0, memory_order_relaxed);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseQueueWaitStatistics
+{
+	uint64_t counts[YAP_QUEUE_WAIT_COUNT];
+	uint64_t ticks[YAP_QUEUE_WAIT_COUNT];
+	uint64_t maxTicks[YAP_QUEUE_WAIT_COUNT];
+	uint64_t buckets[YAP_QUEUE_WAIT_COUNT][YAP_QUEUE_WAIT_BUCKET_COUNT];
+}
+
+- (instancetype)initWithStats:(yap_queue_wait_stats *)stats
+{
+	if ((self = [super init]))
+	{
+		for (int wait = 0; wait < YAP_QUEUE_WAIT_COUNT; wait++)
+		{
+			counts[wait]   = atomic_load_explicit(&stats[wait].count, memory_order_relaxed);
+			ticks[wait]    = atomic_load_explicit(&stats[wait].ticks, memory_order_relaxed);
+			maxTicks[wait] = atomic_load_explicit(&stats[wait].maxTicks, memory_order_relaxed);
+			
+			for (int bucket = 0; bucket < YAP_QUEUE_WAIT_BUCKET_COUNT; bucket++)
+			{
+				buckets[wait][bucket] = atomic_load_explicit(&stats[wait].buckets[bucket], memory_order_relaxed);
+			}
+		}
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable
+}
+
+- (uint64_t)countForWait:(YapDatabaseQueueWait)wait
+{
+	if (wait < 0 || wait >= YAP_QUEUE_WAIT_COUNT) return 0;
+	
+	return counts[wait];
+}
+
+- (NSTimeInterval)durationForWait:(YapDatabaseQueueWait)wait
+{
+	if (wait < 0 || wait >= YAP_QUEUE_WAIT_COUNT) return 0.0;
+	
+	return YapDatabaseTicksToSeconds(ticks[wait]);
+}
+
+- (NSTimeInterval)maxDurationForWait:(YapDatabaseQueueWait)wait
+{
+	if (wait < 0 || wait >= YAP_QUEUE_WAIT_COUNT) return 0.0;
+	
+	return YapDatabaseTicksToSeconds(maxTicks[wait]);
+}
+
+- (NSArray<NSNumber *> *)histogramForWait:(YapDatabaseQueueWait)wait
+{
+	BOOL valid = (wait >= 0 && wait < YAP_QUEUE_WAIT_COUNT);
+	
+	NSMutableArray<NSNumber *> *histogram = [NSMutableArray arrayWithCapacity:YAP_QUEUE_WAIT_BUCKET_COUNT];
+	for (NSUInteger bucket = 0; bucket < YAP_QUEUE_WAIT_BUCKET_COUNT; bucket++)
+	{
+		[histogram addObject:@(valid ? buckets[wait][bucket] : 0)];
+	}
+	
+	return histogram;
+}
+
++ (NSTimeInterval)lowerBoundForBucket:(NSUInteger)bucket
+{
+	if (bucket == 0) return 0.0;
+	
+	bucket = MIN(bucket, (NSUInteger)(YAP_QUEUE_WAIT_BUCKET_COUNT - 1));
+	return (double)(1ULL << bucket) / (double)USEC_PER_SEC;
+}
+
+- (NSString *)description
+{
+	NSArray<NSString *> *waitNames = @[ @"connectionQueue", @"writeQueue", @"snapshotQueue", @"snapshotQueueHold" ];
+	
+	NSMutableString *description = [NSMutableString string];
+	[description appendFormat:@"<YapDatabaseQueueWaitStatistics[%p]:", self];
+	
+	for (int wait = 0; wait < YAP_QUEUE_WAIT_COUNT; wait++)
+	{
+		if (counts[wait] == 0) continue;
+		
+		[description appendFormat:@" %@(count=%llu, ms=%.3f, max_ms=%.3f)", waitNames[wait], counts[wait],
+		  YapDatabaseTicksToSeconds(ticks[wait]) * 1000.0, YapDatabaseTicksToSeconds(maxTicks[wait]) * 1000.0];
+	}
+	
+	[description appendString:@">"];
+	return description;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseQueueWaitEvent
+
+@synthesize wait = wait;
+@synthesize duration = duration;
+@synthesize connectionName = connectionName;
+@synthesize transactionID = transactionID;
+@synthesize readWrite = readWrite;
+@synthesize blockingConnectionName = blockingConnectionName;
+@synthesize blockingTransactionID = blockingTransactionID;
+@synthesize blockingReadWrite = blockingReadWrite;
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseQueueWaitEvent[%p]: wait(%ld) ms(%.3f) transaction(%llu, %@) blockedBy(%llu, %@)>",
+	  self, (long)wait, duration * 1000.0, transactionID, connectionName,
+	  blockingTransactionID, blockingConnectionName];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseQueueHolder
+{
+	YAPUnfairLock lock;
+	
+	NSString *connectionName;
+	uint64_t transactionID;
+	BOOL readWrite;
+}
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		lock = YAP_UNFAIR_LOCK_INIT;
+	}
+	return self;
+}
+
+- (void)enterWithConnectionName:(NSString *)name transactionID:(uint64_t)inTransactionID readWrite:(BOOL)inReadWrite
+{
+	YAPUnfairLockLock(&lock);
+	{
+		connectionName = name;
+		transactionID = inTransactionID;
+		readWrite = inReadWrite;
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
+- (void)exit
+{
+	YAPUnfairLockLock(&lock);
+	{
+		connectionName = nil;
+		transactionID = 0;
+		readWrite = NO;
+	}
+	YAPUnfairLockUnlock(&lock);
+}
+
+- (YapDatabaseQueueWaitEvent *)newWaitEvent
+{
+	YapDatabaseQueueWaitEvent *event = [[YapDatabaseQueueWaitEvent alloc] init];
+	
+	YAPUnfairLockLock(&lock);
+	{
+		event->blockingConnectionName = connectionName;
+		event->blockingTransactionID = transactionID;
+		event->blockingReadWrite = readWrite;
+	}
+	YAPUnfairLockUnlock(&lock);
+	
+	return event;
+}
+
+@end
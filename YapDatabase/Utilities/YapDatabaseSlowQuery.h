@@ -0,0 +1,72 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A slow query is reported whenever an extension query (e.g. a secondary index query, a FTS match, or a rtree query)
+ * spends more time within sqlite than the configured threshold (see -[YapDatabase slowQueryThreshold]).
+ *
+ * The report includes the query plan, as reported by "EXPLAIN QUERY PLAN".
+ * So if a query unexpectedly falls back to a full table scan, you'll see something like "SCAN TABLE ...",
+ * where you might have expected "SEARCH TABLE ... USING INDEX ...".
+ *
+ * The bound values themselves are NOT included in the report (as they may contain user data).
+ * Only their shapes are. For example: "integer", "real", "text(12)".
+**/
+@interface YapDatabaseSlowQuery : NSObject <NSCopying>
+
+/**
+ * The registeredName of the extension that executed the query.
+**/
+@property (nonatomic, copy, readonly) NSString *extensionName;
+
+/**
+ * The SQL text of the statement (with placeholders for the bound values).
+**/
+@property (nonatomic, copy, readonly) NSString *sql;
+
+/**
+ * The shape of each bound parameter, in order.
+ *
+ * E.g. "integer", "real", "text(12)" (where 12 is the length of the string), or the class name for other types.
+**/
+@property (nonatomic, copy, readonly) NSArray<NSString *> *parameterShapes;
+
+/**
+ * The output of "EXPLAIN QUERY PLAN" for the statement (the detail column of each row).
+ * Nested rows are indented according to their depth in the plan.
+ *
+ * May be empty if the plan couldn't be generated.
+**/
+@property (nonatomic, copy, readonly) NSArray<NSString *> *queryPlan;
+
+/**
+ * The number of rows the statement produced.
+ *
+ * Note that enumerations may be stopped early (by the block),
+ * in which case this is the number of rows produced before the enumeration was stopped.
+**/
+@property (nonatomic, assign, readonly) NSUInteger rowCount;
+
+/**
+ * The time spent within sqlite3_step for the statement.
+ * That is, the time spent within enumeration blocks is NOT included.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+@end
+
+/**
+ * The sink for slow query reports. See -[YapDatabase setSlowQueryHandler:queue:].
+**/
+typedef void (^YapDatabaseSlowQueryHandler)(YapDatabaseSlowQuery *slowQuery);
+
+NS_ASSUME_NONNULL_END
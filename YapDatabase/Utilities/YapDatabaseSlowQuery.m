@@ -0,0 +1,226 @@
+#import "YapDatabaseSlowQuery.h"
+#import "YapDatabaseSlowQueryPrivate.h"
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+static mach_timebase_info_data_t YapDatabaseSlowQueryTimebase(void)
+{
+	static mach_timebase_info_data_t timebase;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		
+		if (mach_timebase_info(&timebase) != KERN_SUCCESS || timebase.denom == 0)
+		{
+			timebase.numer = 1;
+			timebase.denom = 1;
+		}
+	});
+	
+	return timebase;
+}
+
+uint64_t YapDatabaseSlowQueryThresholdTicks(NSTimeInterval threshold)
+{
+	if (threshold <= 0.0) return 0;
+	
+	mach_timebase_info_data_t timebase = YapDatabaseSlowQueryTimebase();
+	
+	double ticks = threshold * (double)NSEC_PER_SEC * (double)timebase.denom / (double)timebase.numer;
+	return MAX((uint64_t)ticks, (uint64_t)1);
+}
+
+void YapDatabaseQueryProfileBegin(YapDatabaseQueryProfile *profile, YapDatabase *database)
+{
+	profile->thresholdTicks = 0;
+	profile->stepTicks = 0;
+	profile->rowCount = 0;
+	
+	uint64_t thresholdTicks = atomic_load_explicit(&database->slowQueryThresholdTicks, memory_order_relaxed);
+	if (thresholdTicks == 0) return;
+	
+	uint32_t sampleThreshold = atomic_load_explicit(&database->slowQuerySampleThreshold, memory_order_relaxed);
+	if (sampleThreshold == 0) return;
+	
+	if (sampleThreshold == UINT32_MAX || arc4random() < sampleThreshold)
+	{
+		profile->thresholdTicks = thresholdTicks;
+	}
+}
+
+static NSString * YapDatabaseParameterShape(id value)
+{
+	if ([value isKindOfClass:[NSNumber class]])
+	{
+		CFNumberType numType = CFNumberGetType((__bridge CFNumberRef)value);
+		
+		if (numType == kCFNumberFloatType   ||
+		    numType == kCFNumberFloat32Type ||
+		    numType == kCFNumberFloat64Type ||
+		    numType == kCFNumberDoubleType  ||
+		    numType == kCFNumberCGFloatType  )
+		{
+			return @"real";
+		}
+		else
+		{
+			return @"integer";
+		}
+	}
+	else if ([value isKindOfClass:[NSDate class]])
+	{
+		return @"real";
+	}
+	else if ([value isKindOfClass:[NSString class]])
+	{
+		return [NSString stringWithFormat:@"text(%lu)", (unsigned long)[(NSString *)value length]];
+	}
+	else
+	{
+		return NSStringFromClass([value class]);
+	}
+}
+
+static NSArray<NSString *> * YapDatabaseQueryPlan(sqlite3 *db, const char *sql)
+{
+	NSMutableArray<NSString *> *plan = [NSMutableArray array];
+	
+	char *explain = sqlite3_mprintf("EXPLAIN QUERY PLAN %s", sql);
+	if (explain == NULL) return plan;
+	
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(db, explain, -1, &statement, NULL);
+	
+	sqlite3_free(explain);
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogWarn(@"Unable to generate query plan: %d %s", status, sqlite3_errmsg(db));
+		return plan;
+	}
+	
+	// EXPLAIN QUERY PLAN => (id, parent, notused, detail)
+	//
+	// Each row references its parent row (by id), which we use to indent nested rows.
+	
+	NSMutableDictionary<NSNumber *, NSNumber *> *depths = [NSMutableDictionary dictionary];
+	
+	while (sqlite3_step(statement) == SQLITE_ROW)
+	{
+		int rowId  = sqlite3_column_int(statement, 0);
+		int parent = sqlite3_column_int(statement, 1);
+		
+		const unsigned char *text = sqlite3_column_text(statement, 3);
+		int textSize = sqlite3_column_bytes(statement, 3);
+		
+		NSString *detail = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		if (detail == nil) continue;
+		
+		NSUInteger depth = 0;
+		NSNumber *parentDepth = depths[@(parent)];
+		if (parentDepth) {
+			depth = [parentDepth unsignedIntegerValue] + 1;
+		}
+		depths[@(rowId)] = @(depth);
+		
+		NSString *indent = [@"" stringByPaddingToLength:(depth * 2) withString:@" " startingAtIndex:0];
+		[plan addObject:[indent stringByAppendingString:detail]];
+	}
+	
+	sqlite3_finalize(statement);
+	return plan;
+}
+
+void YapDatabaseQueryProfileReport(const YapDatabaseQueryProfile *profile,
+                                   YapDatabaseReadTransaction *transaction,
+                                   sqlite3_stmt *statement,
+                                   NSArray *parameters,
+                                   NSString *extensionName)
+{
+	const char *sql = sqlite3_sql(statement);
+	if (sql == NULL) return;
+	
+	NSMutableArray<NSString *> *parameterShapes = [NSMutableArray arrayWithCapacity:[parameters count]];
+	for (id value in parameters)
+	{
+		[parameterShapes addObject:YapDatabaseParameterShape(value)];
+	}
+	
+	YapDatabaseConnection *connection = transaction->connection;
+	
+	mach_timebase_info_data_t timebase = YapDatabaseSlowQueryTimebase();
+	double nanoseconds = (double)profile->stepTicks * (double)timebase.numer / (double)timebase.denom;
+	
+	YapDatabaseSlowQuery *slowQuery =
+	  [[YapDatabaseSlowQuery alloc] initWithExtensionName:(extensionName ?: @"")
+	                                                  sql:@(sql)
+	                                      parameterShapes:parameterShapes
+	                                            queryPlan:YapDatabaseQueryPlan(connection->db, sql)
+	                                             rowCount:profile->rowCount
+	                                             duration:(nanoseconds / (double)NSEC_PER_SEC)];
+	
+	[connection->database reportSlowQuery:slowQuery];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseSlowQuery
+
+@synthesize extensionName = extensionName;
+@synthesize sql = sql;
+@synthesize parameterShapes = parameterShapes;
+@synthesize queryPlan = queryPlan;
+@synthesize rowCount = rowCount;
+@synthesize duration = duration;
+
+- (instancetype)initWithExtensionName:(NSString *)inExtensionName
+                                  sql:(NSString *)inSql
+                      parameterShapes:(NSArray<NSString *> *)inParameterShapes
+                            queryPlan:(NSArray<NSString *> *)inQueryPlan
+                             rowCount:(NSUInteger)inRowCount
+                             duration:(NSTimeInterval)inDuration
+{
+	if ((self = [super init]))
+	{
+		extensionName = [inExtensionName copy];
+		sql = [inSql copy];
+		parameterShapes = [inParameterShapes copy];
+		queryPlan = [inQueryPlan copy];
+		rowCount = inRowCount;
+		duration = inDuration;
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseSlowQuery[%p]: extension(%@), duration(%.3f ms), rows(%lu)\n sql: %@\n parameters: [%@]\n plan:\n  %@>",
+	  self, extensionName, (duration * 1000.0), (unsigned long)rowCount, sql,
+	  [parameterShapes componentsJoinedByString:@", "],
+	  [queryPlan componentsJoinedByString:@"\n  "]];
+}
+
+@end
@@ -0,0 +1,166 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * Statistics are a (cheap) sample of the live state of a database or connection:
+ * cache hit rates, prepared statements, how far behind each connection is, the changeset backlog & the WAL size.
+ * See -[YapDatabase statistics] & -[YapDatabaseConnection statistics].
+ *
+ * The cache counters are cumulative (since the cache was created), and are never reset.
+ * To get rates over an interval, diff two samples.
+ *
+ * Extension caches are prefixed with the registered name of the extension.
+ * For example, "myView.pageCache" or "myRelationship.edgeCache".
+**/
+
+@interface YapDatabaseCacheStatistics : NSObject <NSCopying>
+
+/** The number of lookups that found (hits) or didn't find (misses) the item in the cache. **/
+@property (nonatomic, assign, readonly) uint64_t hits;
+@property (nonatomic, assign, readonly) uint64_t misses;
+
+/** The number of items evicted to make room for other items. **/
+@property (nonatomic, assign, readonly) uint64_t evictions;
+
+/** The number of items in the cache, and the limit (zero means unlimited). **/
+@property (nonatomic, assign, readonly) NSUInteger count;
+@property (nonatomic, assign, readonly) NSUInteger countLimit;
+
+/**
+ * The total cost of the items in the cache, and the limit (zero means unlimited).
+ * Costs are only tracked by caches with a cost limit (e.g. a view's pageCache, in bytes). Otherwise both are zero.
+**/
+@property (nonatomic, assign, readonly) NSUInteger cost;
+@property (nonatomic, assign, readonly) NSUInteger costLimit;
+
+/**
+ * hits / (hits + misses), or zero if there haven't been any lookups.
+**/
+@property (nonatomic, assign, readonly) double hitRate;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseConnectionStatistics : NSObject <NSCopying>
+
+/** The name of the connection (see YapDatabaseConnection.name). **/
+@property (nonatomic, copy, readonly, nullable) NSString *name;
+
+/**
+ * The snapshot of the connection, and how many snapshots it's behind the database.
+ * A connection with a long-lived read transaction falls behind as other connections commit changes.
+**/
+@property (nonatomic, assign, readonly) uint64_t snapshot;
+@property (nonatomic, assign, readonly) uint64_t snapshotLag;
+
+@property (nonatomic, assign, readonly) BOOL hasLongLivedReadTransaction;
+
+/**
+ * The number of changesets queued for the long-lived read transaction.
+ * They're processed when the long-lived read transaction is ended or re-begun.
+**/
+@property (nonatomic, assign, readonly) NSUInteger pendingChangesetCount;
+
+/**
+ * The number of prepared statements held by the connection's sqlite instance (including those of extensions).
+**/
+@property (nonatomic, assign, readonly) NSUInteger preparedStatementCount;
+
+/**
+ * The mmap_size in effect for the connection's sqlite instance (in bytes), or zero if memory mapping isn't used.
+ * This is the value sqlite reports, so it reflects any limit imposed by sqlite itself.
+ * 
+ * @see YapDatabaseOptions.pragmaMMapSizeMaximum
+**/
+@property (nonatomic, assign, readonly) uint64_t mmapSize;
+
+/**
+ * The memory used by the page cache of the connection's sqlite instance (in bytes).
+ * 
+ * @see YapDatabaseOptions.pageCacheBudget
+**/
+@property (nonatomic, assign, readonly) uint64_t pageCacheUsed;
+
+/** The connection's objectCache & metadataCache. **/
+@property (nonatomic, copy, readonly) YapDatabaseCacheStatistics *objectCache;
+@property (nonatomic, copy, readonly) YapDatabaseCacheStatistics *metadataCache;
+
+/**
+ * Maps from cache name (e.g. "myView.pageCache") to its statistics.
+**/
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, YapDatabaseCacheStatistics *> *extensionCaches;
+
+/**
+ * A flat dictionary of the statistics, suitable for shipping to a metrics pipeline.
+ * For example: "objectCache.hits", "myView.pageCache.hitRate", "snapshotLag".
+**/
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseStatistics : NSObject <NSCopying>
+
+/** The most recent snapshot of the database. **/
+@property (nonatomic, assign, readonly) uint64_t snapshot;
+
+/** The size of the WAL file (in bytes). **/
+@property (nonatomic, assign, readonly) uint64_t walSize;
+
+/** The size of the database file (in bytes). **/
+@property (nonatomic, assign, readonly) uint64_t databaseSize;
+
+/**
+ * The smallest mmap_size among the connections (zero if there aren't any),
+ * and the fraction of the database file it covers (from 0.0 to 1.0).
+ * 
+ * Reads of the part of the file that isn't mapped go through read() syscalls.
+ * 
+ * @see YapDatabaseOptions.pragmaMMapSizeMaximum
+**/
+@property (nonatomic, assign, readonly) uint64_t mmapSize;
+@property (nonatomic, assign, readonly) double mappedFraction;
+
+/** The sum of the pageCacheUsed of every connection. **/
+@property (nonatomic, assign, readonly) uint64_t pageCacheUsed;
+
+/**
+ * The number of changesets the database is holding on to,
+ * because at least one connection hasn't processed them yet.
+**/
+@property (nonatomic, assign, readonly) NSUInteger changesetBacklog;
+
+/** The largest snapshotLag among the connections. **/
+@property (nonatomic, assign, readonly) uint64_t maxSnapshotLag;
+
+/** The sum of the preparedStatementCount of every connection. **/
+@property (nonatomic, assign, readonly) NSUInteger preparedStatementCount;
+
+/** The caches, summed across every connection. **/
+@property (nonatomic, copy, readonly) YapDatabaseCacheStatistics *objectCache;
+@property (nonatomic, copy, readonly) YapDatabaseCacheStatistics *metadataCache;
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, YapDatabaseCacheStatistics *> *extensionCaches;
+
+/** The statistics of each open connection. **/
+@property (nonatomic, copy, readonly) NSArray<YapDatabaseConnectionStatistics *> *connections;
+
+/**
+ * A flat dictionary of the (database-wide) statistics, suitable for shipping to a metrics pipeline.
+ * The per-connection statistics aren't included. (See -[YapDatabaseConnectionStatistics dictionaryRepresentation].)
+**/
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation;
+
+@end
+
+NS_ASSUME_NONNULL_END
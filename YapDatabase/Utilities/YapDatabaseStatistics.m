@@ -0,0 +1,317 @@
+#import "YapDatabaseStatistics.h"
+#import "YapDatabaseStatisticsPrivate.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Adds the entries for the given cache to the dictionary representation, prefixed with the given name.
+**/
+static void YapDatabaseStatisticsAddCache(NSMutableDictionary<NSString *, NSNumber *> *dict,
+                                          NSString *name, YapDatabaseCacheStatistics *cache)
+{
+	dict[[name stringByAppendingString:@".hits"]]       = @(cache.hits);
+	dict[[name stringByAppendingString:@".misses"]]     = @(cache.misses);
+	dict[[name stringByAppendingString:@".evictions"]]  = @(cache.evictions);
+	dict[[name stringByAppendingString:@".count"]]      = @(cache.count);
+	dict[[name stringByAppendingString:@".countLimit"]] = @(cache.countLimit);
+	dict[[name stringByAppendingString:@".cost"]]       = @(cache.cost);
+	dict[[name stringByAppendingString:@".costLimit"]]  = @(cache.costLimit);
+	dict[[name stringByAppendingString:@".hitRate"]]    = @(cache.hitRate);
+}
+
+@implementation YapDatabaseCacheStatistics
+{
+	YapCacheLifetimeStatistics lifetime;
+	NSUInteger count;
+	NSUInteger countLimit;
+	NSUInteger cost;
+	NSUInteger costLimit;
+}
+
+@dynamic hits;
+@dynamic misses;
+@dynamic evictions;
+@synthesize count = count;
+@synthesize countLimit = countLimit;
+@synthesize cost = cost;
+@synthesize costLimit = costLimit;
+@dynamic hitRate;
+
+- (instancetype)initWithCache:(YapCache *)cache
+{
+	if ((self = [super init]))
+	{
+		if (cache)
+		{
+			lifetime = cache.lifetimeStatistics;
+			count = [cache count];
+			countLimit = cache.countLimit;
+			cost = cache.totalCost;
+			costLimit = cache.costLimit;
+		}
+	}
+	return self;
+}
+
++ (YapDatabaseCacheStatistics *)statisticsByMergingStatistics:(NSArray<YapDatabaseCacheStatistics *> *)statistics
+{
+	YapDatabaseCacheStatistics *merged = [[YapDatabaseCacheStatistics alloc] initWithCache:nil];
+	BOOL unlimited = NO;
+	BOOL unlimitedCost = NO;
+	
+	for (YapDatabaseCacheStatistics *item in statistics)
+	{
+		merged->lifetime.hits      += item->lifetime.hits;
+		merged->lifetime.misses    += item->lifetime.misses;
+		merged->lifetime.evictions += item->lifetime.evictions;
+		merged->count += item->count;
+		merged->cost += item->cost;
+		
+		if (item->countLimit == 0)
+			unlimited = YES;
+		else
+			merged->countLimit += item->countLimit;
+		
+		if (item->costLimit == 0)
+			unlimitedCost = YES;
+		else
+			merged->costLimit += item->costLimit;
+	}
+	
+	if (unlimited) {
+		merged->countLimit = 0;
+	}
+	if (unlimitedCost) {
+		merged->costLimit = 0;
+	}
+	
+	return merged;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // immutable
+}
+
+- (uint64_t)hits
+{
+	return lifetime.hits;
+}
+
+- (uint64_t)misses
+{
+	return lifetime.misses;
+}
+
+- (uint64_t)evictions
+{
+	return lifetime.evictions;
+}
+
+- (double)hitRate
+{
+	uint64_t lookups = lifetime.hits + lifetime.misses;
+	if (lookups == 0) return 0.0;
+	
+	return (double)lifetime.hits / (double)lookups;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseCacheStatistics[%p]: hits(%llu) misses(%llu) evictions(%llu) count(%lu/%lu) cost(%lu/%lu)"
+	  @" hitRate(%.3f)>",
+	  self, lifetime.hits, lifetime.misses, lifetime.evictions,
+	  (unsigned long)count, (unsigned long)countLimit, (unsigned long)cost, (unsigned long)costLimit, [self hitRate]];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseConnectionStatistics
+
+@synthesize name = name;
+@synthesize snapshot = snapshot;
+@synthesize snapshotLag = snapshotLag;
+@synthesize hasLongLivedReadTransaction = hasLongLivedReadTransaction;
+@synthesize pendingChangesetCount = pendingChangesetCount;
+@synthesize preparedStatementCount = preparedStatementCount;
+@synthesize mmapSize = mmapSize;
+@synthesize pageCacheUsed = pageCacheUsed;
+@synthesize objectCache = objectCache;
+@synthesize metadataCache = metadataCache;
+@synthesize extensionCaches = extensionCaches;
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // immutable
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation
+{
+	NSMutableDictionary<NSString *, NSNumber *> *dict = [NSMutableDictionary dictionary];
+	
+	dict[@"snapshot"] = @(snapshot);
+	dict[@"snapshotLag"] = @(snapshotLag);
+	dict[@"hasLongLivedReadTransaction"] = @(hasLongLivedReadTransaction);
+	dict[@"pendingChangesetCount"] = @(pendingChangesetCount);
+	dict[@"preparedStatementCount"] = @(preparedStatementCount);
+	dict[@"mmapSize"] = @(mmapSize);
+	dict[@"pageCacheUsed"] = @(pageCacheUsed);
+	
+	YapDatabaseStatisticsAddCache(dict, @"objectCache", objectCache);
+	YapDatabaseStatisticsAddCache(dict, @"metadataCache", metadataCache);
+	
+	[extensionCaches enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *cacheName, YapDatabaseCacheStatistics *cache, BOOL __unused *stop)
+	{
+		YapDatabaseStatisticsAddCache(dict, cacheName, cache);
+	}];
+	
+	return dict;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseConnectionStatistics[%p]: name(%@) snapshot(%llu) lag(%llu) pendingChangesets(%lu)"
+	  @" statements(%lu) objectCache(%.3f) metadataCache(%.3f)>", self, name, snapshot, snapshotLag,
+	  (unsigned long)pendingChangesetCount, (unsigned long)preparedStatementCount,
+	  objectCache.hitRate, metadataCache.hitRate];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseStatistics
+
+@synthesize snapshot = snapshot;
+@synthesize walSize = walSize;
+@synthesize databaseSize = databaseSize;
+@synthesize mmapSize = mmapSize;
+@synthesize mappedFraction = mappedFraction;
+@synthesize pageCacheUsed = pageCacheUsed;
+@synthesize changesetBacklog = changesetBacklog;
+@synthesize maxSnapshotLag = maxSnapshotLag;
+@synthesize preparedStatementCount = preparedStatementCount;
+@synthesize objectCache = objectCache;
+@synthesize metadataCache = metadataCache;
+@synthesize extensionCaches = extensionCaches;
+@synthesize connections = connections;
+
+- (instancetype)initWithSnapshot:(uint64_t)inSnapshot
+                         walSize:(uint64_t)inWalSize
+                    databaseSize:(uint64_t)inDatabaseSize
+                changesetBacklog:(NSUInteger)inChangesetBacklog
+                     connections:(NSArray<YapDatabaseConnectionStatistics *> *)inConnections
+{
+	if ((self = [super init]))
+	{
+		snapshot = inSnapshot;
+		walSize = inWalSize;
+		databaseSize = inDatabaseSize;
+		changesetBacklog = inChangesetBacklog;
+		connections = [inConnections copy];
+		
+		NSMutableArray<YapDatabaseCacheStatistics *> *objectCaches = [NSMutableArray arrayWithCapacity:connections.count];
+		NSMutableArray<YapDatabaseCacheStatistics *> *metadataCaches = [NSMutableArray arrayWithCapacity:connections.count];
+		NSMutableDictionary<NSString *, NSMutableArray *> *extCaches = [NSMutableDictionary dictionary];
+		
+		for (YapDatabaseConnectionStatistics *connection in connections)
+		{
+			maxSnapshotLag = MAX(maxSnapshotLag, connection->snapshotLag);
+			preparedStatementCount += connection->preparedStatementCount;
+			pageCacheUsed += connection->pageCacheUsed;
+			
+			if (connection == connections.firstObject)
+				mmapSize = connection->mmapSize;
+			else
+				mmapSize = MIN(mmapSize, connection->mmapSize);
+			
+			[objectCaches addObject:connection->objectCache];
+			[metadataCaches addObject:connection->metadataCache];
+			
+			[connection->extensionCaches enumerateKeysAndObjectsUsingBlock:
+			    ^(NSString *cacheName, YapDatabaseCacheStatistics *cache, BOOL __unused *stop)
+			{
+				NSMutableArray *caches = extCaches[cacheName];
+				if (caches == nil)
+				{
+					caches = [NSMutableArray array];
+					extCaches[cacheName] = caches;
+				}
+				
+				[caches addObject:cache];
+			}];
+		}
+		
+		objectCache = [YapDatabaseCacheStatistics statisticsByMergingStatistics:objectCaches];
+		metadataCache = [YapDatabaseCacheStatistics statisticsByMergingStatistics:metadataCaches];
+		
+		NSMutableDictionary<NSString *, YapDatabaseCacheStatistics *> *mergedExtCaches =
+		  [NSMutableDictionary dictionaryWithCapacity:extCaches.count];
+		
+		[extCaches enumerateKeysAndObjectsUsingBlock:^(NSString *cacheName, NSMutableArray *caches, BOOL __unused *stop) {
+			
+			mergedExtCaches[cacheName] = [YapDatabaseCacheStatistics statisticsByMergingStatistics:caches];
+		}];
+		
+		extensionCaches = [mergedExtCaches copy];
+		
+		if (databaseSize > 0) {
+			mappedFraction = MIN(1.0, (double)mmapSize / (double)databaseSize);
+		}
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // immutable
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation
+{
+	NSMutableDictionary<NSString *, NSNumber *> *dict = [NSMutableDictionary dictionary];
+	
+	dict[@"snapshot"] = @(snapshot);
+	dict[@"walSize"] = @(walSize);
+	dict[@"databaseSize"] = @(databaseSize);
+	dict[@"mmapSize"] = @(mmapSize);
+	dict[@"pageCacheUsed"] = @(pageCacheUsed);
+	dict[@"mappedFraction"] = @(mappedFraction);
+	dict[@"changesetBacklog"] = @(changesetBacklog);
+	dict[@"connectionCount"] = @(connections.count);
+	dict[@"maxSnapshotLag"] = @(maxSnapshotLag);
+	dict[@"preparedStatementCount"] = @(preparedStatementCount);
+	
+	YapDatabaseStatisticsAddCache(dict, @"objectCache", objectCache);
+	YapDatabaseStatisticsAddCache(dict, @"metadataCache", metadataCache);
+	
+	[extensionCaches enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *cacheName, YapDatabaseCacheStatistics *cache, BOOL __unused *stop)
+	{
+		YapDatabaseStatisticsAddCache(dict, cacheName, cache);
+	}];
+	
+	return dict;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseStatistics[%p]: snapshot(%llu) wal(%llu) changesetBacklog(%lu) connections(%lu)"
+	  @" maxSnapshotLag(%llu) statements(%lu) objectCache(%.3f) metadataCache(%.3f)>",
+	  self, snapshot, walSize, (unsigned long)changesetBacklog, (unsigned long)connections.count,
+	  maxSnapshotLag, (unsigned long)preparedStatementCount, objectCache.hitRate, metadataCache.hitRate];
+}
+
+@end
@@ -0,0 +1,159 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A storage report breaks down the space used by the database file:
+ * per table & index (including the tables of each extension), per collection,
+ * as well as the freelist & the WAL.
+ * See -[YapDatabaseConnection storageReport].
+ *
+ * This is the information needed to decide whether to compress, vacuum, or shard a database.
+ * For example:
+ * - a large freelist means a vacuum would shrink the file
+ * - a large fraction of unused bytes (within pages) means the btrees are fragmented
+ * - many overflow pages means the rows are larger than a page (and are good candidates for compression)
+ *
+ * The table & index breakdown uses the "dbstat" virtual table,
+ * which requires sqlite to be compiled with SQLITE_ENABLE_DBSTAT_VTAB (the system sqlite on Apple platforms is).
+ * If it's not available, the tables array is empty.
+**/
+
+@interface YapDatabaseStorageTableReport : NSObject <NSCopying>
+
+/**
+ * The name of the btree (table or index), and for indexes, the name of the table it indexes.
+**/
+@property (nonatomic, copy, readonly) NSString *name;
+@property (nonatomic, copy, readonly) NSString *tableName;
+@property (nonatomic, assign, readonly) BOOL isIndex;
+
+/**
+ * The registered name of the extension that owns the table (based on the table's name),
+ * or nil if the table belongs to the database itself (e.g. "database2" & "true_primary_key").
+**/
+@property (nonatomic, copy, readonly, nullable) NSString *extensionName;
+
+/**
+ * The number of pages used by the btree, and how many of those are overflow pages.
+ * Rows that don't fit within a page spill into (a chain of) overflow pages.
+**/
+@property (nonatomic, assign, readonly) uint64_t pageCount;
+@property (nonatomic, assign, readonly) uint64_t overflowPageCount;
+
+/**
+ * The number of entries (rows for tables, keys for indexes) on the leaf pages.
+**/
+@property (nonatomic, assign, readonly) uint64_t entryCount;
+
+/**
+ * totalBytes    : the size of all the pages (pageCount * pageSize)
+ * payloadBytes  : the bytes used by the content of the entries
+ * unusedBytes   : the bytes that are unused within the pages (fragmentation)
+**/
+@property (nonatomic, assign, readonly) uint64_t totalBytes;
+@property (nonatomic, assign, readonly) uint64_t payloadBytes;
+@property (nonatomic, assign, readonly) uint64_t unusedBytes;
+
+/**
+ * payloadBytes / entryCount (or zero if there are no entries).
+**/
+@property (nonatomic, assign, readonly) double averageEntrySize;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseStorageCollectionReport : NSObject <NSCopying>
+
+@property (nonatomic, copy, readonly) NSString *collection;
+
+@property (nonatomic, assign, readonly) uint64_t rowCount;
+
+/**
+ * The (stored) size of the keys, objects & metadata. Objects & metadata are measured after serialization
+ * (and compression, if enabled), which is what's actually stored in the file.
+**/
+@property (nonatomic, assign, readonly) uint64_t keyBytes;
+@property (nonatomic, assign, readonly) uint64_t objectBytes;
+@property (nonatomic, assign, readonly) uint64_t metadataBytes;
+
+/**
+ * keyBytes + objectBytes + metadataBytes
+**/
+@property (nonatomic, assign, readonly) uint64_t totalBytes;
+
+/**
+ * totalBytes / rowCount (or zero if there are no rows).
+**/
+@property (nonatomic, assign, readonly) double averageRowSize;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseStorageReport : NSObject <NSCopying>
+
+/**
+ * The page size, the total number of pages in the file, and the number of pages on the freelist.
+ * Freelist pages are unused, and are given back to the file system by a (incremental) vacuum.
+**/
+@property (nonatomic, assign, readonly) uint64_t pageSize;
+@property (nonatomic, assign, readonly) uint64_t pageCount;
+@property (nonatomic, assign, readonly) uint64_t freelistPageCount;
+
+/**
+ * The size of the database file (pageCount * pageSize), and of the WAL file.
+**/
+@property (nonatomic, assign, readonly) uint64_t fileSize;
+@property (nonatomic, assign, readonly) uint64_t walSize;
+
+/**
+ * Every table & index, sorted by totalBytes (largest first).
+ * Empty if the dbstat virtual table isn't available.
+**/
+@property (nonatomic, copy, readonly) NSArray<YapDatabaseStorageTableReport *> *tables;
+
+/**
+ * Every collection, sorted by totalBytes (largest first).
+**/
+@property (nonatomic, copy, readonly) NSArray<YapDatabaseStorageCollectionReport *> *collections;
+
+/**
+ * Whether the dbstat virtual table was available. (If not, the tables array is empty.)
+**/
+@property (nonatomic, assign, readonly) BOOL dbstatAvailable;
+
+/**
+ * Whether the report was generated within a single read transaction.
+ * Reports generated incrementally (in the background) span multiple transactions,
+ * so they're only approximate if the database is modified in the meantime.
+**/
+@property (nonatomic, assign, readonly) BOOL consistent;
+
+/**
+ * Returns the total bytes of the tables & indexes owned by each extension (by registered name).
+**/
+- (NSDictionary<NSString *, NSNumber *> *)bytesByExtension;
+
+/**
+ * Returns the report for the given table or index, or nil if there's no such btree.
+**/
+- (nullable YapDatabaseStorageTableReport *)tableReportForName:(NSString *)name;
+
+/**
+ * Returns the report for the given collection, or nil if the collection is empty.
+**/
+- (nullable YapDatabaseStorageCollectionReport *)collectionReportForCollection:(NSString *)collection;
+
+@end
+
+NS_ASSUME_NONNULL_END
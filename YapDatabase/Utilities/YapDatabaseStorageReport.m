@@ -0,0 +1,585 @@
+#import "YapDatabaseStorageReport.h"
+#import "YapDatabaseStorageReportPrivate.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+/**
+ * The number of rows measured per step.
+**/
+#define YAP_STORAGE_REPORT_ROWS_PER_STEP 4096
+
+@interface YapDatabaseStorageTableReport ()
+
+@property (nonatomic, copy, readwrite) NSString *name;
+@property (nonatomic, copy, readwrite) NSString *tableName;
+@property (nonatomic, assign, readwrite) BOOL isIndex;
+@property (nonatomic, copy, readwrite, nullable) NSString *extensionName;
+@property (nonatomic, assign, readwrite) uint64_t pageCount;
+@property (nonatomic, assign, readwrite) uint64_t overflowPageCount;
+@property (nonatomic, assign, readwrite) uint64_t entryCount;
+@property (nonatomic, assign, readwrite) uint64_t totalBytes;
+@property (nonatomic, assign, readwrite) uint64_t payloadBytes;
+@property (nonatomic, assign, readwrite) uint64_t unusedBytes;
+
+@end
+
+@interface YapDatabaseStorageCollectionReport ()
+
+@property (nonatomic, copy, readwrite) NSString *collection;
+@property (nonatomic, assign, readwrite) uint64_t rowCount;
+@property (nonatomic, assign, readwrite) uint64_t keyBytes;
+@property (nonatomic, assign, readwrite) uint64_t objectBytes;
+@property (nonatomic, assign, readwrite) uint64_t metadataBytes;
+
+@end
+
+@interface YapDatabaseStorageReport ()
+
+@property (nonatomic, assign, readwrite) uint64_t pageSize;
+@property (nonatomic, assign, readwrite) uint64_t pageCount;
+@property (nonatomic, assign, readwrite) uint64_t freelistPageCount;
+@property (nonatomic, assign, readwrite) uint64_t walSize;
+@property (nonatomic, copy, readwrite) NSArray<YapDatabaseStorageTableReport *> *tables;
+@property (nonatomic, copy, readwrite) NSArray<YapDatabaseStorageCollectionReport *> *collections;
+@property (nonatomic, assign, readwrite) BOOL dbstatAvailable;
+@property (nonatomic, assign, readwrite) BOOL consistent;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseStorageTableReport
+
+@synthesize name = name;
+@synthesize tableName = tableName;
+@synthesize isIndex = isIndex;
+@synthesize extensionName = extensionName;
+@synthesize pageCount = pageCount;
+@synthesize overflowPageCount = overflowPageCount;
+@synthesize entryCount = entryCount;
+@synthesize totalBytes = totalBytes;
+@synthesize payloadBytes = payloadBytes;
+@synthesize unusedBytes = unusedBytes;
+
+- (double)averageEntrySize
+{
+	if (entryCount == 0) return 0.0;
+	
+	return (double)payloadBytes / (double)entryCount;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable (once returned from the builder)
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseStorageTableReport[%p]: name(%@), index(%@), extension(%@), pages(%llu), overflowPages(%llu),"
+	  @" entries(%llu), bytes(%llu), payload(%llu), unused(%llu)>",
+	  self, name, (isIndex ? @"YES" : @"NO"), (extensionName ?: @"-"),
+	  pageCount, overflowPageCount, entryCount, totalBytes, payloadBytes, unusedBytes];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseStorageCollectionReport
+
+@synthesize collection = collection;
+@synthesize rowCount = rowCount;
+@synthesize keyBytes = keyBytes;
+@synthesize objectBytes = objectBytes;
+@synthesize metadataBytes = metadataBytes;
+
+- (uint64_t)totalBytes
+{
+	return keyBytes + objectBytes + metadataBytes;
+}
+
+- (double)averageRowSize
+{
+	if (rowCount == 0) return 0.0;
+	
+	return (double)[self totalBytes] / (double)rowCount;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable (once returned from the builder)
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseStorageCollectionReport[%p]: collection(%@), rows(%llu), keys(%llu), objects(%llu),"
+	  @" metadata(%llu), averageRowSize(%.1f)>",
+	  self, collection, rowCount, keyBytes, objectBytes, metadataBytes, [self averageRowSize]];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseStorageReport
+
+@synthesize pageSize = pageSize;
+@synthesize pageCount = pageCount;
+@synthesize freelistPageCount = freelistPageCount;
+@synthesize walSize = walSize;
+@synthesize tables = tables;
+@synthesize collections = collections;
+@synthesize dbstatAvailable = dbstatAvailable;
+@synthesize consistent = consistent;
+
+- (uint64_t)fileSize
+{
+	return pageCount * pageSize;
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)bytesByExtension
+{
+	NSMutableDictionary<NSString *, NSNumber *> *result = [NSMutableDictionary dictionary];
+	
+	for (YapDatabaseStorageTableReport *table in tables)
+	{
+		NSString *extensionName = table.extensionName;
+		if (extensionName == nil) continue;
+		
+		uint64_t bytes = [result[extensionName] unsignedLongLongValue] + table.totalBytes;
+		result[extensionName] = @(bytes);
+	}
+	
+	return [result copy];
+}
+
+- (YapDatabaseStorageTableReport *)tableReportForName:(NSString *)name
+{
+	for (YapDatabaseStorageTableReport *table in tables)
+	{
+		if ([table.name isEqualToString:name]) return table;
+	}
+	
+	return nil;
+}
+
+- (YapDatabaseStorageCollectionReport *)collectionReportForCollection:(NSString *)collection
+{
+	if (collection == nil) collection = @"";
+	
+	for (YapDatabaseStorageCollectionReport *report in collections)
+	{
+		if ([report.collection isEqualToString:collection]) return report;
+	}
+	
+	return nil;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable (once returned from the builder)
+}
+
+- (NSString *)description
+{
+	NSMutableString *description = [NSMutableString string];
+	
+	[description appendFormat:
+	  @"<YapDatabaseStorageReport[%p]: pageSize(%llu), pages(%llu), freelistPages(%llu), fileSize(%llu), walSize(%llu),"
+	  @" dbstat(%@), consistent(%@)",
+	  self, pageSize, pageCount, freelistPageCount, [self fileSize], walSize,
+	  (dbstatAvailable ? @"YES" : @"NO"), (consistent ? @"YES" : @"NO")];
+	
+	for (YapDatabaseStorageTableReport *table in tables)
+	{
+		[description appendFormat:@"\n  %@", table];
+	}
+	for (YapDatabaseStorageCollectionReport *collection in collections)
+	{
+		[description appendFormat:@"\n  %@", collection];
+	}
+	
+	[description appendString:@">"];
+	return description;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseStorageReportBuilder
+{
+	NSString *walPath;
+	NSMutableSet<NSString *> *extensionNames;
+	
+	BOOL prepared;
+	BOOL finished;
+	
+	NSMutableArray<YapDatabaseStorageTableReport *> *pendingTables;
+	NSMutableArray<YapDatabaseStorageTableReport *> *tables;
+	NSMutableDictionary<NSString *, YapDatabaseStorageCollectionReport *> *collections;
+	
+	BOOL rowsFinished;
+	int64_t lastRowid;
+	int64_t maxRowid;
+	
+	YapDatabaseStorageReport *report;
+}
+
+@synthesize consistent = consistent;
+
+- (instancetype)initWithWALPath:(NSString *)inWALPath extensionNames:(NSArray<NSString *> *)inExtensionNames
+{
+	if ((self = [super init]))
+	{
+		walPath = [inWALPath copy];
+		extensionNames = [NSMutableSet setWithArray:inExtensionNames];
+		
+		pendingTables = [[NSMutableArray alloc] init];
+		tables = [[NSMutableArray alloc] init];
+		collections = [[NSMutableDictionary alloc] init];
+		
+		report = [[YapDatabaseStorageReport alloc] init];
+		consistent = YES;
+	}
+	return self;
+}
+
+- (int64_t)totalUnitCount
+{
+	return (int64_t)([pendingTables count] + [tables count]) + MAX(maxRowid, 0);
+}
+
+- (int64_t)completedUnitCount
+{
+	return (int64_t)[tables count] + MAX(MIN(lastRowid, maxRowid), 0);
+}
+
+- (BOOL)stepWithDatabase:(sqlite3 *)db
+{
+	if (finished) return YES;
+	
+	if (!prepared)
+	{
+		[self prepareWithDatabase:db];
+		prepared = YES;
+	}
+	else if ([pendingTables count] > 0)
+	{
+		YapDatabaseStorageTableReport *table = [pendingTables firstObject];
+		[pendingTables removeObjectAtIndex:0];
+		
+		[self measureTable:table withDatabase:db];
+		[tables addObject:table];
+	}
+	else if (!rowsFinished)
+	{
+		rowsFinished = [self measureRowsWithDatabase:db];
+	}
+	
+	if (prepared && [pendingTables count] == 0 && rowsFinished)
+	{
+		[self finish];
+		finished = YES;
+	}
+	
+	return finished;
+}
+
+#pragma mark Steps
+
+static int64_t YapDatabaseStorageReportQueryInt64(sqlite3 *db, const char *sql)
+{
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(db, sql, -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating statement (%s): %d %s", sql, status, sqlite3_errmsg(db));
+		return 0;
+	}
+	
+	int64_t result = 0;
+	if (sqlite3_step(statement) == SQLITE_ROW) {
+		result = sqlite3_column_int64(statement, 0);
+	}
+	
+	sqlite3_finalize(statement);
+	return result;
+}
+
+static NSString * YapDatabaseStorageReportColumnText(sqlite3_stmt *statement, int column)
+{
+	const unsigned char *text = sqlite3_column_text(statement, column);
+	int textSize = sqlite3_column_bytes(statement, column);
+	
+	if (text == NULL) return nil;
+	return [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+}
+
+/**
+ * Reads the pragmas & the WAL size, lists every btree (via sqlite_master),
+ * and figures out which extension owns each one.
+**/
+- (void)prepareWithDatabase:(sqlite3 *)db
+{
+	report.pageSize = (uint64_t)YapDatabaseStorageReportQueryInt64(db, "PRAGMA page_size;");
+	report.pageCount = (uint64_t)YapDatabaseStorageReportQueryInt64(db, "PRAGMA page_count;");
+	report.freelistPageCount = (uint64_t)YapDatabaseStorageReportQueryInt64(db, "PRAGMA freelist_count;");
+	
+	NSDictionary *walAttributes = [[NSFileManager defaultManager] attributesOfItemAtPath:walPath error:NULL];
+	report.walSize = [walAttributes fileSize];
+	
+	maxRowid = YapDatabaseStorageReportQueryInt64(db, "SELECT max(\"rowid\") FROM \"database2\";");
+	lastRowid = 0;
+	
+	sqlite3_stmt *statement = NULL;
+	int status;
+	
+	// Extension names
+	//
+	// The registered extensions were given to us.
+	// But extensions that were registered in the past (and not unregistered) still have tables.
+	
+	status = sqlite3_prepare_v2(db, "SELECT DISTINCT \"extension\" FROM \"yap2\";", -1, &statement, NULL);
+	if (status == SQLITE_OK)
+	{
+		while (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			NSString *extensionName = YapDatabaseStorageReportColumnText(statement, 0);
+			if ([extensionName length] > 0) {
+				[extensionNames addObject:extensionName];
+			}
+		}
+		sqlite3_finalize(statement);
+		statement = NULL;
+	}
+	else
+	{
+		YDBLogError(@"Error creating statement (yap2): %d %s", status, sqlite3_errmsg(db));
+	}
+	
+	// Is dbstat available ?
+	//
+	// It's only available if sqlite was compiled with SQLITE_ENABLE_DBSTAT_VTAB.
+	
+	status = sqlite3_prepare_v2(db, "SELECT 1 FROM \"dbstat\" LIMIT 0;", -1, &statement, NULL);
+	report.dbstatAvailable = (status == SQLITE_OK);
+	sqlite3_finalize(statement);
+	statement = NULL;
+	
+	if (!report.dbstatAvailable)
+	{
+		YDBLogWarn(@"The dbstat virtual table isn't available: the storage report won't include tables & indexes");
+		return;
+	}
+	
+	// Every btree (views & virtual tables don't have a root page).
+	
+	status = sqlite3_prepare_v2(db,
+	  "SELECT \"type\", \"name\", \"tbl_name\" FROM \"sqlite_master\""
+	  " WHERE \"type\" IN ('table', 'index') AND \"rootpage\" > 0;", -1, &statement, NULL);
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating statement (sqlite_master): %d %s", status, sqlite3_errmsg(db));
+		return;
+	}
+	
+	while (sqlite3_step(statement) == SQLITE_ROW)
+	{
+		NSString *type = YapDatabaseStorageReportColumnText(statement, 0);
+		NSString *name = YapDatabaseStorageReportColumnText(statement, 1);
+		NSString *tableName = YapDatabaseStorageReportColumnText(statement, 2);
+		
+		if (name == nil) continue;
+		
+		YapDatabaseStorageTableReport *table = [[YapDatabaseStorageTableReport alloc] init];
+		table.name = name;
+		table.tableName = tableName ?: name;
+		table.isIndex = [type isEqualToString:@"index"];
+		table.extensionName = [self extensionNameForTableName:table.tableName];
+		
+		[pendingTables addObject:table];
+	}
+	
+	sqlite3_finalize(statement);
+}
+
+/**
+ * Extensions name their tables by combining a prefix with the registered name,
+ * optionally followed by a suffix. For example:
+ * - "view_<name>_map" & "view_<name>_page"
+ * - "secondaryIndex_<name>"
+ * - "fts_<name>" (and its shadow tables, e.g. "fts_<name>_content")
+ *
+ * When several names match (e.g. "foo" & "foo_bar"), the longest one wins.
+**/
+- (NSString *)extensionNameForTableName:(NSString *)tableName
+{
+	NSString *match = nil;
+	
+	for (NSString *extensionName in extensionNames)
+	{
+		if ([match length] >= [extensionName length]) continue;
+		
+		NSString *component = [@"_" stringByAppendingString:extensionName];
+		
+		if ([tableName hasSuffix:component] ||
+		    [tableName rangeOfString:[component stringByAppendingString:@"_"]].location != NSNotFound)
+		{
+			match = extensionName;
+		}
+	}
+	
+	return match;
+}
+
+- (void)measureTable:(YapDatabaseStorageTableReport *)table withDatabase:(sqlite3 *)db
+{
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(db,
+	  "SELECT count(*),"
+	  " sum(\"pagetype\" = 'overflow'),"
+	  " sum(CASE WHEN \"pagetype\" = 'leaf' THEN \"ncell\" ELSE 0 END),"
+	  " sum(\"payload\"), sum(\"unused\"), sum(\"pgsize\")"
+	  " FROM \"dbstat\" WHERE \"name\" = ?;", -1, &statement, NULL);
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating statement (dbstat): %d %s", status, sqlite3_errmsg(db));
+		return;
+	}
+	
+	const char *name = [table.name UTF8String];
+	sqlite3_bind_text(statement, 1, name, -1, SQLITE_STATIC);
+	
+	if (sqlite3_step(statement) == SQLITE_ROW)
+	{
+		table.pageCount         = (uint64_t)sqlite3_column_int64(statement, 0);
+		table.overflowPageCount = (uint64_t)sqlite3_column_int64(statement, 1);
+		table.entryCount        = (uint64_t)sqlite3_column_int64(statement, 2);
+		table.payloadBytes      = (uint64_t)sqlite3_column_int64(statement, 3);
+		table.unusedBytes       = (uint64_t)sqlite3_column_int64(statement, 4);
+		table.totalBytes        = (uint64_t)sqlite3_column_int64(statement, 5);
+	}
+	
+	sqlite3_finalize(statement);
+}
+
+/**
+ * Measures the next batch of rows (in rowid order), grouped by collection.
+ * Returns YES once every row has been measured.
+ *
+ * This works with both schemas, as the collection-id schema exposes the same columns via the "database2" view.
+**/
+- (BOOL)measureRowsWithDatabase:(sqlite3 *)db
+{
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(db,
+	  "SELECT \"collection\", count(*), sum(\"k\"), sum(\"d\"), sum(\"m\"), max(\"rowid\") FROM"
+	  " (SELECT \"rowid\", \"collection\", length(CAST(\"key\" AS BLOB)) AS \"k\","
+	  "         length(\"data\") AS \"d\", length(\"metadata\") AS \"m\""
+	  "  FROM \"database2\" WHERE \"rowid\" > ? ORDER BY \"rowid\" ASC LIMIT ?)"
+	  " GROUP BY \"collection\";", -1, &statement, NULL);
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating statement (database2): %d %s", status, sqlite3_errmsg(db));
+		return YES;
+	}
+	
+	sqlite3_bind_int64(statement, 1, lastRowid);
+	sqlite3_bind_int(statement, 2, YAP_STORAGE_REPORT_ROWS_PER_STEP);
+	
+	int64_t rowCount = 0;
+	int64_t batchMaxRowid = lastRowid;
+	
+	while (sqlite3_step(statement) == SQLITE_ROW)
+	{
+		NSString *collection = YapDatabaseStorageReportColumnText(statement, 0) ?: @"";
+		
+		YapDatabaseStorageCollectionReport *collectionReport = collections[collection];
+		if (collectionReport == nil)
+		{
+			collectionReport = [[YapDatabaseStorageCollectionReport alloc] init];
+			collectionReport.collection = collection;
+			
+			collections[collection] = collectionReport;
+		}
+		
+		int64_t count = sqlite3_column_int64(statement, 1);
+		
+		collectionReport.rowCount      += (uint64_t)count;
+		collectionReport.keyBytes      += (uint64_t)sqlite3_column_int64(statement, 2);
+		collectionReport.objectBytes   += (uint64_t)sqlite3_column_int64(statement, 3);
+		collectionReport.metadataBytes += (uint64_t)sqlite3_column_int64(statement, 4);
+		
+		rowCount += count;
+		batchMaxRowid = MAX(batchMaxRowid, sqlite3_column_int64(statement, 5));
+	}
+	
+	sqlite3_finalize(statement);
+	
+	lastRowid = batchMaxRowid;
+	maxRowid = MAX(maxRowid, lastRowid); // Rows may have been added since the first step
+	
+	return (rowCount < YAP_STORAGE_REPORT_ROWS_PER_STEP);
+}
+
+- (void)finish
+{
+	[tables sortUsingComparator:^NSComparisonResult(YapDatabaseStorageTableReport *t1, YapDatabaseStorageTableReport *t2) {
+	
+		if (t1.totalBytes > t2.totalBytes) return NSOrderedAscending;
+		if (t1.totalBytes < t2.totalBytes) return NSOrderedDescending;
+		
+		return [t1.name compare:t2.name];
+	}];
+	
+	NSMutableArray<YapDatabaseStorageCollectionReport *> *sortedCollections = [[collections allValues] mutableCopy];
+	[sortedCollections sortUsingComparator:
+	  ^NSComparisonResult(YapDatabaseStorageCollectionReport *c1, YapDatabaseStorageCollectionReport *c2) {
+	
+		if (c1.totalBytes > c2.totalBytes) return NSOrderedAscending;
+		if (c1.totalBytes < c2.totalBytes) return NSOrderedDescending;
+		
+		return [c1.collection compare:c2.collection];
+	}];
+	
+	report.tables = tables;
+	report.collections = sortedCollections;
+	report.consistent = consistent;
+}
+
+- (YapDatabaseStorageReport *)report
+{
+	NSAssert(finished, @"The report isn't complete");
+	
+	return report;
+}
+
+@end
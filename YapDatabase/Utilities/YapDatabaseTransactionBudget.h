@@ -0,0 +1,106 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabaseTransactionMetrics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A transaction budget is the maximum duration you expect a transaction on a connection to take.
+ * For example, 16ms for read transactions on the main thread, or 200ms for write transactions.
+ * A budget report describes a transaction that exceeded its budget.
+ * See -[YapDatabaseConnection setTransactionBudgetForReads:writes:block:queue:].
+**/
+
+typedef NS_ENUM(NSInteger, YapDatabaseTransactionPhase) {
+
+	/**
+	 * Your code, within the transaction block.
+	 * (Excluding the time spent within sqlite & extension hooks. But including deserialization.)
+	**/
+	YapDatabaseTransactionPhaseBlock = 0,
+
+	/**
+	 * Executing sql statements within the transaction block.
+	 * (Statements executed during the preCommit & commit phases are attributed to those phases.)
+	 * Requires sqlite3_trace_v2 (sqlite 3.14+). Otherwise this phase is always zero.
+	**/
+	YapDatabaseTransactionPhaseSQLite = 1,
+
+	/**
+	 * Extension hooks & the preCommit phase (in which extensions flush their pending changes).
+	**/
+	YapDatabaseTransactionPhaseExtensions = 2,
+
+	/**
+	 * Building & handing off the changeset, waiting for the write lock, "COMMIT TRANSACTION",
+	 * and any aggressive checkpoint.
+	**/
+	YapDatabaseTransactionPhaseCommit = 3,
+
+	/**
+	 * Everything else. Mostly waiting on the writeQueue (for read-write transactions on other connections),
+	 * synchronizing the snapshot, and catching up on changesets from other connections.
+	**/
+	YapDatabaseTransactionPhaseOther = 4,
+};
+
+
+@interface YapDatabaseTransactionBudgetReport : NSObject <NSCopying>
+
+/**
+ * The connection that executed the transaction (see YapDatabaseConnection.name).
+**/
+@property (nonatomic, copy, readonly, nullable) NSString *connectionName;
+
+@property (nonatomic, assign, readonly) BOOL readWrite;
+
+/**
+ * The budget that was exceeded, and the duration of the transaction.
+ * The duration starts as soon as the transaction enters the connection's queue,
+ * and thus includes waiting on the writeQueue.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval budget;
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/**
+ * The detailed measurements of the transaction.
+ *
+ * For read-only transactions, only the block, sqlite, deserialization & cache measurements apply,
+ * and the totalDuration covers the block only.
+**/
+@property (nonatomic, strong, readonly) YapDatabaseTransactionMetrics *metrics;
+
+/**
+ * The phase that consumed the most time. See durationForPhase:.
+**/
+@property (nonatomic, assign, readonly) YapDatabaseTransactionPhase phase;
+
+/**
+ * Returns the time attributed to the given phase.
+ * The phases don't overlap, and add up to the duration.
+ * 
+ * Since sqlite only reports the total time spent executing statements,
+ * the split between the block & sqlite phases is an estimate.
+**/
+- (NSTimeInterval)durationForPhase:(YapDatabaseTransactionPhase)phase;
+
+/**
+ * A backtrace of the thread that executed the transaction,
+ * sampled at the moment the transaction exceeded its budget (in the format of +[NSThread callStackSymbols]).
+ *
+ * Empty if the thread couldn't be sampled,
+ * e.g. if the transaction completed right after the budget was exceeded, or on unsupported architectures.
+**/
+@property (nonatomic, copy, readonly) NSArray<NSString *> *callStackSymbols;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,284 @@
+#import "YapDatabaseTransactionBudget.h"
+#import "YapDatabaseTransactionBudgetPrivate.h"
+
+#import <dlfcn.h>
+
+#if __has_include(<ptrauth.h>)
+#import <ptrauth.h>
+#endif
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+#if __has_feature(ptrauth_calls)
+  #define YAP_STRIP_PC(pc) (uintptr_t)ptrauth_strip((void *)(pc), ptrauth_key_return_address)
+#else
+  #define YAP_STRIP_PC(pc) (uintptr_t)(pc)
+#endif
+
+/**
+ * The layout of a stack frame record (on both arm64 & x86_64):
+ * the caller's frame pointer, followed by the return address.
+**/
+typedef struct {
+	uintptr_t fp;
+	uintptr_t pc;
+} yap_frame_record;
+
+/**
+ * Reads memory that may not be valid (without crashing).
+**/
+static BOOL YapDatabaseReadMemory(uintptr_t address, void *buffer, size_t size)
+{
+	vm_size_t outSize = 0;
+	kern_return_t kr = vm_read_overwrite(mach_task_self(), (vm_address_t)address, (vm_size_t)size,
+	                                     (vm_address_t)buffer, &outSize);
+	
+	return (kr == KERN_SUCCESS && outSize == size);
+}
+
+NSUInteger YapDatabaseSampleThread(thread_t thread, uintptr_t *addresses, NSUInteger maxCount)
+{
+#if (defined(__arm64__) && defined(__LP64__)) || defined(__x86_64__)
+
+	if (maxCount == 0) return 0;
+	if (thread_suspend(thread) != KERN_SUCCESS) return 0;
+	
+	// Important: Nothing in here may allocate memory (or take any lock),
+	// as the suspended thread may be holding it.
+	
+	NSUInteger count = 0;
+	uintptr_t pc = 0;
+	uintptr_t fp = 0;
+	BOOL hasState = NO;
+
+#if defined(__arm64__)
+
+	arm_thread_state64_t state;
+	mach_msg_type_number_t stateCount = ARM_THREAD_STATE64_COUNT;
+	
+	if (thread_get_state(thread, ARM_THREAD_STATE64, (thread_state_t)&state, &stateCount) == KERN_SUCCESS)
+	{
+		pc = YAP_STRIP_PC(arm_thread_state64_get_pc(state));
+		fp = (uintptr_t)arm_thread_state64_get_fp(state);
+		hasState = YES;
+		
+		// The frame pointer of a leaf function may not have been pushed yet,
+		// so the link register is the only record of the caller.
+		
+		addresses[count++] = pc;
+		
+		uintptr_t lr = YAP_STRIP_PC(arm_thread_state64_get_lr(state));
+		if (lr && count < maxCount) {
+			addresses[count++] = lr;
+		}
+	}
+
+#else
+
+	x86_thread_state64_t state;
+	mach_msg_type_number_t stateCount = x86_THREAD_STATE64_COUNT;
+	
+	if (thread_get_state(thread, x86_THREAD_STATE64, (thread_state_t)&state, &stateCount) == KERN_SUCCESS)
+	{
+		pc = (uintptr_t)state.__rip;
+		fp = (uintptr_t)state.__rbp;
+		hasState = YES;
+		
+		addresses[count++] = pc;
+	}
+
+#endif
+
+	if (hasState)
+	{
+		yap_frame_record frame;
+		
+		while (fp && (fp % sizeof(uintptr_t)) == 0 && count < maxCount)
+		{
+			if (!YapDatabaseReadMemory(fp, &frame, sizeof(frame))) break;
+			
+			uintptr_t returnAddress = YAP_STRIP_PC(frame.pc);
+			if (returnAddress == 0) break;
+			
+			// Skip the duplicate (on arm64, the first record may match the link register)
+			if (!(count > 0 && addresses[count-1] == returnAddress)) {
+				addresses[count++] = returnAddress;
+			}
+			
+			// The stack grows down, so the frames must move up.
+			if (frame.fp <= fp) break;
+			fp = frame.fp;
+		}
+	}
+	
+	thread_resume(thread);
+	
+	return count;
+
+#else
+
+	return 0;
+
+#endif
+}
+
+NSArray<NSString *> * YapDatabaseSymbolicateAddresses(const uintptr_t *addresses, NSUInteger count)
+{
+	NSMutableArray<NSString *> *symbols = [NSMutableArray arrayWithCapacity:count];
+	
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		uintptr_t address = addresses[i];
+		
+		NSString *image = @"???";
+		NSString *symbol = nil;
+		uintptr_t offset = 0;
+		
+		Dl_info info;
+		if (dladdr((const void *)address, &info) != 0)
+		{
+			if (info.dli_fname) {
+				image = [[NSString stringWithUTF8String:info.dli_fname] lastPathComponent] ?: image;
+			}
+			if (info.dli_sname && info.dli_saddr)
+			{
+				symbol = [NSString stringWithUTF8String:info.dli_sname];
+				offset = address - (uintptr_t)info.dli_saddr;
+			}
+			else if (info.dli_fbase)
+			{
+				offset = address - (uintptr_t)info.dli_fbase;
+			}
+		}
+		
+		NSString *line = [NSString stringWithFormat:@"%-4lu%-35s 0x%016lx %@ + %lu",
+		  (unsigned long)i, [image UTF8String], (unsigned long)address,
+		  (symbol ?: image), (unsigned long)offset];
+		
+		[symbols addObject:line];
+	}
+	
+	return symbols;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define YAP_TRANSACTION_PHASE_COUNT 5
+
+@implementation YapDatabaseTransactionBudgetReport
+{
+	NSTimeInterval phaseDurations[YAP_TRANSACTION_PHASE_COUNT];
+}
+
+@synthesize connectionName = connectionName;
+@synthesize readWrite = readWrite;
+@synthesize budget = budget;
+@synthesize duration = duration;
+@synthesize metrics = metrics;
+@synthesize phase = phase;
+@synthesize callStackSymbols = callStackSymbols;
+
+- (instancetype)initWithConnectionName:(NSString *)inConnectionName
+                             readWrite:(BOOL)inReadWrite
+                                budget:(NSTimeInterval)inBudget
+                              duration:(NSTimeInterval)inDuration
+                               metrics:(YapDatabaseTransactionMetrics *)inMetrics
+                      callStackSymbols:(NSArray<NSString *> *)inCallStackSymbols
+{
+	if ((self = [super init]))
+	{
+		connectionName = [inConnectionName copy];
+		readWrite = inReadWrite;
+		budget = inBudget;
+		duration = inDuration;
+		metrics = inMetrics;
+		callStackSymbols = [inCallStackSymbols copy];
+		
+		[self attributePhases];
+	}
+	return self;
+}
+
+/**
+ * Splits the duration into the (non-overlapping) phases.
+ *
+ * The extension hooks execute within the block, and the sqlite statements execute everywhere.
+ * Sqlite only gives us a total, so we attribute it to the block first,
+ * as the preCommit & commit phases are already measured as a whole.
+**/
+- (void)attributePhases
+{
+	NSTimeInterval hooks = 0;
+	for (NSNumber *hookDuration in [metrics.extensionHookDurations objectEnumerator])
+	{
+		hooks += [hookDuration doubleValue];
+	}
+	
+	NSTimeInterval blockRemainder = MAX(metrics.blockDuration - hooks, 0.0);
+	
+	NSTimeInterval sqlite = MIN(metrics.sqliteDuration, blockRemainder);
+	NSTimeInterval block = blockRemainder - sqlite;
+	NSTimeInterval extensions = MIN(hooks, metrics.blockDuration) + metrics.preCommitDuration;
+	NSTimeInterval commit = metrics.changesetDuration
+	                      + metrics.writeLockWaitDuration
+	                      + metrics.commitDuration
+	                      + metrics.checkpointDuration;
+	
+	NSTimeInterval other = MAX(duration - (block + sqlite + extensions + commit), 0.0);
+	
+	phaseDurations[YapDatabaseTransactionPhaseBlock] = block;
+	phaseDurations[YapDatabaseTransactionPhaseSQLite] = sqlite;
+	phaseDurations[YapDatabaseTransactionPhaseExtensions] = extensions;
+	phaseDurations[YapDatabaseTransactionPhaseCommit] = commit;
+	phaseDurations[YapDatabaseTransactionPhaseOther] = other;
+	
+	phase = YapDatabaseTransactionPhaseBlock;
+	for (NSInteger i = 1; i < YAP_TRANSACTION_PHASE_COUNT; i++)
+	{
+		if (phaseDurations[i] > phaseDurations[phase]) {
+			phase = (YapDatabaseTransactionPhase)i;
+		}
+	}
+}
+
+- (NSTimeInterval)durationForPhase:(YapDatabaseTransactionPhase)inPhase
+{
+	if (inPhase < 0 || inPhase >= YAP_TRANSACTION_PHASE_COUNT) return 0.0;
+	
+	return phaseDurations[inPhase];
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable
+}
+
+- (NSString *)description
+{
+	NSString *phaseName = nil;
+	switch (phase)
+	{
+		case YapDatabaseTransactionPhaseBlock      : phaseName = @"block";      break;
+		case YapDatabaseTransactionPhaseSQLite     : phaseName = @"sqlite";     break;
+		case YapDatabaseTransactionPhaseExtensions : phaseName = @"extensions"; break;
+		case YapDatabaseTransactionPhaseCommit     : phaseName = @"commit";     break;
+		default                                    : phaseName = @"other";      break;
+	}
+	
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseTransactionBudgetReport[%p]: connection(%@), readWrite(%@), duration(%.1f ms) > budget(%.1f ms),"
+	  @" block(%.1f ms), sqlite(%.1f ms), extensions(%.1f ms), commit(%.1f ms), other(%.1f ms), phase(%@), frames(%lu)>",
+	  self, connectionName, (readWrite ? @"YES" : @"NO"), (duration * 1000.0), (budget * 1000.0),
+	  (phaseDurations[YapDatabaseTransactionPhaseBlock] * 1000.0),
+	  (phaseDurations[YapDatabaseTransactionPhaseSQLite] * 1000.0),
+	  (phaseDurations[YapDatabaseTransactionPhaseExtensions] * 1000.0),
+	  (phaseDurations[YapDatabaseTransactionPhaseCommit] * 1000.0),
+	  (phaseDurations[YapDatabaseTransactionPhaseOther] * 1000.0),
+	  phaseName, (unsigned long)[callStackSymbols count]];
+}
+
+@end
@@ -0,0 +1,125 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * Transaction metrics break down where the time went during a single read-write transaction.
+ * See -[YapDatabaseConnection setTransactionMetricsBlock:queue:].
+ *
+ * The phases (blockDuration, preCommitDuration, writeLockWaitDuration, changesetDuration, commitDuration
+ * & checkpointDuration) don't overlap, and together account for nearly all of the totalDuration.
+ * The remaining measurements (sqlite, serialization, deserialization & extension hooks) are cross-cutting.
+ * For example, the sqlite time includes the statements executed within your block,
+ * as well as the statements executed by extensions during the preCommit phase.
+**/
+@interface YapDatabaseTransactionMetrics : NSObject
+
+/**
+ * YES if the transaction was rolled back.
+ * In which case the preCommit, changeset & commit phases are skipped, and the rollback is included in commitDuration.
+**/
+@property (nonatomic, assign, readonly) BOOL didRollback;
+
+/**
+ * The snapshot of the connection after the transaction.
+**/
+@property (nonatomic, assign, readonly) uint64_t snapshot;
+
+/**
+ * The total time, from the start of the transaction (after acquiring the write lock),
+ * until the transaction was completed.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval totalDuration;
+
+/**
+ * The time spent within the transaction block itself (i.e. your code).
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval blockDuration;
+
+/**
+ * The time spent within -[YapDatabaseReadWriteTransaction preCommitReadWriteTransaction].
+ * That is, giving extensions a chance to flush their pending changes, before the changeset is requested.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval preCommitDuration;
+
+/**
+ * The time spent building the changeset, and handing it off to the database.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval changesetDuration;
+
+/**
+ * The time spent waiting for read-only transactions (on other connections) to acquire their sql-level snapshot.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval writeLockWaitDuration;
+
+/**
+ * The time spent executing "COMMIT TRANSACTION".
+ * This is where the WAL is written (and synced, depending on the synchronous level).
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval commitDuration;
+
+/**
+ * The time spent performing an aggressive checkpoint (if the WAL grew too big), after the commit.
+ * Regular checkpoints are performed asynchronously, and aren't included.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval checkpointDuration;
+
+/**
+ * The total time spent executing sql statements, and the number of statements executed.
+ * This includes the statements executed by extensions.
+ *
+ * Note: This requires sqlite3_trace_v2 (sqlite 3.14+). Otherwise these values are zero.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval sqliteDuration;
+@property (nonatomic, assign, readonly) NSUInteger sqliteStatementCount;
+
+/**
+ * The time spent in the object & metadata serializers, and the number of values serialized.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval serializationDuration;
+@property (nonatomic, assign, readonly) NSUInteger serializationCount;
+
+/**
+ * The time spent in the object & metadata deserializers, and the number of values deserialized.
+ *
+ * Note: Values deserialized concurrently on background threads (e.g. via a YapDeserializationPipeline)
+ * aren't included.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval deserializationDuration;
+@property (nonatomic, assign, readonly) NSUInteger deserializationCount;
+
+/**
+ * The time spent within the hooks of each extension (keyed by registered extension name).
+ *
+ * extensionHookDurations:
+ *   The time spent processing modifications to the database.
+ *   E.g. didInsertObject:..., didUpdateObject:..., didRemoveObjectForCollectionKey:..., etc.
+ *
+ * extensionFlushDurations:
+ *   The time spent flushing pending changes during the preCommit phase.
+ *   That is, flushPendingChangesToMainDatabaseTable & flushPendingChangesToExtensionTables.
+ *
+ * Extensions that didn't do anything during the transaction aren't included.
+**/
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, NSNumber *> *extensionHookDurations;
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, NSNumber *> *extensionFlushDurations;
+
+/**
+ * The number of lookups within the connection's objectCache & metadataCache.
+**/
+@property (nonatomic, assign, readonly) NSUInteger objectCacheHitCount;
+@property (nonatomic, assign, readonly) NSUInteger objectCacheMissCount;
+@property (nonatomic, assign, readonly) NSUInteger metadataCacheHitCount;
+@property (nonatomic, assign, readonly) NSUInteger metadataCacheMissCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
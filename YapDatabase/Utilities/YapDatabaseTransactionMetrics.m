@@ -0,0 +1,183 @@
+#import "YapDatabaseTransactionMetrics.h"
+#import "YapDatabaseTransactionMetricsPrivate.h"
+#import "YapDatabasePrivate.h"
+
+#import <pthread.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+static pthread_key_t YapDatabaseTransactionMetricsKey;
+
+static void YapDatabaseTransactionMetricsKeyInit(void)
+{
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		
+		pthread_key_create(&YapDatabaseTransactionMetricsKey, NULL);
+	});
+}
+
+YapDatabaseTransactionMetrics *YapDatabaseTransactionMetricsGetCurrent(void)
+{
+	YapDatabaseTransactionMetricsKeyInit();
+	
+	return (__bridge YapDatabaseTransactionMetrics *)pthread_getspecific(YapDatabaseTransactionMetricsKey);
+}
+
+void YapDatabaseTransactionMetricsSetCurrent(YapDatabaseTransactionMetrics *metrics)
+{
+	YapDatabaseTransactionMetricsKeyInit();
+	
+	pthread_setspecific(YapDatabaseTransactionMetricsKey, (__bridge const void *)metrics);
+}
+
+id YapDatabaseDeserializeObjectWithMetrics(YapDatabase *database,
+                                           NSString *collection, NSString *key, const void *bytes, int length)
+{
+	YapDatabaseTransactionMetrics *metrics = YapDatabaseTransactionMetricsGetCurrent();
+	if (metrics == nil) {
+		return _YapDatabaseDeserializeObject(database, collection, key, bytes, length);
+	}
+	
+	uint64_t startTime = mach_absolute_time();
+	
+	id object = _YapDatabaseDeserializeObject(database, collection, key, bytes, length);
+	
+	metrics->deserializationTicks += YapDatabaseTransactionMetricsElapsed(startTime);
+	metrics->deserializationCount++;
+	
+	return object;
+}
+
+id YapDatabaseDeserializeMetadataWithMetrics(YapDatabase *database,
+                                             NSString *collection, NSString *key, const void *bytes, int length)
+{
+	YapDatabaseTransactionMetrics *metrics = YapDatabaseTransactionMetricsGetCurrent();
+	if (metrics == nil) {
+		return _YapDatabaseDeserializeMetadata(database, collection, key, bytes, length);
+	}
+	
+	uint64_t startTime = mach_absolute_time();
+	
+	id metadata = _YapDatabaseDeserializeMetadata(database, collection, key, bytes, length);
+	
+	metrics->deserializationTicks += YapDatabaseTransactionMetricsElapsed(startTime);
+	metrics->deserializationCount++;
+	
+	return metadata;
+}
+
+NSTimeInterval YapDatabaseTicksToSeconds(uint64_t ticks)
+{
+	static mach_timebase_info_data_t timebase;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		
+		if (mach_timebase_info(&timebase) != KERN_SUCCESS || timebase.denom == 0)
+		{
+			timebase.numer = 1;
+			timebase.denom = 1;
+		}
+	});
+	
+	double nanoseconds = (double)ticks * (double)timebase.numer / (double)timebase.denom;
+	return nanoseconds / (double)NSEC_PER_SEC;
+}
+
+static NSDictionary<NSString *, NSNumber *> *YapDatabaseTicksDictionaryToSeconds(NSDictionary *ticksDict)
+{
+	NSMutableDictionary<NSString *, NSNumber *> *result = [NSMutableDictionary dictionaryWithCapacity:[ticksDict count]];
+	
+	[ticksDict enumerateKeysAndObjectsUsingBlock:^(NSString *extName, NSNumber *ticks, BOOL __unused *stop) {
+		
+		result[extName] = @(YapDatabaseTicksToSeconds([ticks unsignedLongLongValue]));
+	}];
+	
+	return result;
+}
+
+@implementation YapDatabaseTransactionMetrics
+{
+	NSMutableDictionary<NSString *, NSNumber *> *hookTicks;
+	NSMutableDictionary<NSString *, NSNumber *> *flushTicks;
+}
+
+@dynamic extensionHookDurations;
+@dynamic extensionFlushDurations;
+
+- (void)addHookTicks:(uint64_t)ticks forExtension:(NSString *)extensionName
+{
+	if (extensionName == nil) return;
+	
+	if (hookTicks == nil)
+		hookTicks = [[NSMutableDictionary alloc] init];
+	
+	hookTicks[extensionName] = @([hookTicks[extensionName] unsignedLongLongValue] + ticks);
+}
+
+- (void)addFlushTicks:(uint64_t)ticks forExtension:(NSString *)extensionName
+{
+	if (extensionName == nil) return;
+	
+	if (flushTicks == nil)
+		flushTicks = [[NSMutableDictionary alloc] init];
+	
+	flushTicks[extensionName] = @([flushTicks[extensionName] unsignedLongLongValue] + ticks);
+}
+
+- (BOOL)didRollback            { return didRollback; }
+- (uint64_t)snapshot           { return snapshot; }
+
+- (NSTimeInterval)totalDuration         { return YapDatabaseTicksToSeconds(totalTicks); }
+- (NSTimeInterval)blockDuration         { return YapDatabaseTicksToSeconds(blockTicks); }
+- (NSTimeInterval)preCommitDuration     { return YapDatabaseTicksToSeconds(preCommitTicks); }
+- (NSTimeInterval)changesetDuration     { return YapDatabaseTicksToSeconds(changesetTicks); }
+- (NSTimeInterval)writeLockWaitDuration { return YapDatabaseTicksToSeconds(writeLockWaitTicks); }
+- (NSTimeInterval)commitDuration        { return YapDatabaseTicksToSeconds(commitTicks); }
+- (NSTimeInterval)checkpointDuration    { return YapDatabaseTicksToSeconds(checkpointTicks); }
+
+- (NSTimeInterval)sqliteDuration
+{
+	return (double)sqliteNanoseconds / (double)NSEC_PER_SEC;
+}
+
+- (NSUInteger)sqliteStatementCount { return sqliteStatementCount; }
+
+- (NSTimeInterval)serializationDuration   { return YapDatabaseTicksToSeconds(serializationTicks); }
+- (NSUInteger)serializationCount          { return serializationCount; }
+
+- (NSTimeInterval)deserializationDuration { return YapDatabaseTicksToSeconds(deserializationTicks); }
+- (NSUInteger)deserializationCount        { return deserializationCount; }
+
+- (NSDictionary<NSString *, NSNumber *> *)extensionHookDurations
+{
+	return YapDatabaseTicksDictionaryToSeconds(hookTicks);
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)extensionFlushDurations
+{
+	return YapDatabaseTicksDictionaryToSeconds(flushTicks);
+}
+
+- (NSUInteger)objectCacheHitCount    { return objectCacheCounters.hits; }
+- (NSUInteger)objectCacheMissCount   { return objectCacheCounters.misses; }
+- (NSUInteger)metadataCacheHitCount  { return metadataCacheCounters.hits; }
+- (NSUInteger)metadataCacheMissCount { return metadataCacheCounters.misses; }
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseTransactionMetrics[%p]: total(%.3f ms) block(%.3f ms) preCommit(%.3f ms) changeset(%.3f ms)"
+	  @" writeLockWait(%.3f ms) commit(%.3f ms) checkpoint(%.3f ms) sqlite(%.3f ms, %lu)"
+	  @" serialization(%.3f ms, %lu) deserialization(%.3f ms, %lu)>",
+	  self,
+	  self.totalDuration * 1000.0, self.blockDuration * 1000.0, self.preCommitDuration * 1000.0,
+	  self.changesetDuration * 1000.0, self.writeLockWaitDuration * 1000.0, self.commitDuration * 1000.0,
+	  self.checkpointDuration * 1000.0, self.sqliteDuration * 1000.0, (unsigned long)sqliteStatementCount,
+	  self.serializationDuration * 1000.0, (unsigned long)serializationCount,
+	  self.deserializationDuration * 1000.0, (unsigned long)deserializationCount];
+}
+
+@end
@@ -0,0 +1,62 @@
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * The WAL can only be reset (and thus stops growing) once every reader has moved past the frames within it.
+ * A read transaction that stays open on an old snapshot (most often a long-lived read transaction
+ * that isn't updated in response to YapDatabaseModifiedNotification) prevents this,
+ * and the WAL keeps growing for as long as the reader stays put.
+ *
+ * A pinning report describes the reader holding the oldest snapshot.
+ * See -[YapDatabase walPinningReport] & -[YapDatabase setWALPinningDurationThreshold:frameThreshold:block:queue:].
+**/
+@interface YapDatabaseWALPinningReport : NSObject <NSCopying>
+
+/**
+ * The name of the connection holding the oldest snapshot (see YapDatabaseConnection.name).
+**/
+@property (nonatomic, copy, readonly, nullable) NSString *connectionName;
+
+/**
+ * Whether the reader is a long-lived read transaction,
+ * as opposed to a regular (but slow) read transaction.
+**/
+@property (nonatomic, assign, readonly) BOOL longLivedReadTransaction;
+
+/**
+ * The snapshot held by the reader, and the latest snapshot of the database.
+ * The difference is the number of commits the reader has fallen behind.
+**/
+@property (nonatomic, assign, readonly) uint64_t snapshot;
+@property (nonatomic, assign, readonly) uint64_t databaseSnapshot;
+
+/**
+ * How long the reader has held its snapshot.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/**
+ * The size of the WAL file (in bytes), and the number of frames (i.e. pages) within it.
+ * None of these frames can be reclaimed (via a WAL reset) until the reader moves forward.
+**/
+@property (nonatomic, assign, readonly) uint64_t walSize;
+@property (nonatomic, assign, readonly) NSUInteger walFrameCount;
+
+@end
+
+/**
+ * Invoked when a reader exceeds the WAL pinning thresholds.
+ * See -[YapDatabase setWALPinningDurationThreshold:frameThreshold:block:queue:].
+**/
+typedef void (^YapDatabaseWALPinningBlock)(YapDatabaseWALPinningReport *report);
+
+NS_ASSUME_NONNULL_END
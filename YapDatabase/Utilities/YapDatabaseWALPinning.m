@@ -0,0 +1,68 @@
+#import "YapDatabaseWALPinning.h"
+#import "YapDatabaseWALPinningPrivate.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+
+NSUInteger YapDatabaseWALFrameCount(uint64_t walSize, uint64_t pageSize)
+{
+	const uint64_t walHeaderSize = 32;
+	const uint64_t frameHeaderSize = 24;
+	
+	if (walSize <= walHeaderSize || pageSize == 0) return 0;
+	
+	return (NSUInteger)((walSize - walHeaderSize) / (pageSize + frameHeaderSize));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseWALPinningReport
+
+@synthesize connectionName = connectionName;
+@synthesize longLivedReadTransaction = longLivedReadTransaction;
+@synthesize snapshot = snapshot;
+@synthesize databaseSnapshot = databaseSnapshot;
+@synthesize duration = duration;
+@synthesize walSize = walSize;
+@synthesize walFrameCount = walFrameCount;
+
+- (instancetype)initWithConnectionName:(NSString *)inConnectionName
+                longLivedReadTransaction:(BOOL)inLongLivedReadTransaction
+                                snapshot:(uint64_t)inSnapshot
+                        databaseSnapshot:(uint64_t)inDatabaseSnapshot
+                                duration:(NSTimeInterval)inDuration
+                                 walSize:(uint64_t)inWalSize
+                           walFrameCount:(NSUInteger)inWalFrameCount
+{
+	if ((self = [super init]))
+	{
+		connectionName = [inConnectionName copy];
+		longLivedReadTransaction = inLongLivedReadTransaction;
+		snapshot = inSnapshot;
+		databaseSnapshot = inDatabaseSnapshot;
+		duration = inDuration;
+		walSize = inWalSize;
+		walFrameCount = inWalFrameCount;
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	return self; // Immutable
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseWALPinningReport[%p]: connection(%@), longLived(%@), snapshot(%llu of %llu),"
+	  @" duration(%.1f s), wal(%llu bytes, %lu frames)>",
+	  self, connectionName, (longLivedReadTransaction ? @"YES" : @"NO"), snapshot, databaseSnapshot,
+	  duration, walSize, (unsigned long)walFrameCount];
+}
+
+@end
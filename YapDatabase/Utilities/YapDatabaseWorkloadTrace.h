@@ -0,0 +1,184 @@
+#import <Foundation/Foundation.h>
+
+@class YapDatabase;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * A workload trace records the shape of every transaction on one or more connections,
+ * without recording any of the actual data. See -[YapDatabaseConnection setWorkloadTraceRecorder:].
+ *
+ * For each transaction, the trace contains:
+ * - the connection, the kind of transaction (read-only or read-write), when it started & how long it took
+ * - every read, write & remove (collection & key are hashed, values are reduced to their serialized size)
+ * - every enumeration of a collection
+ * - every extension accessed (via [transaction ext:])
+ *
+ * The collections & keys are hashed with a random salt (per recorder).
+ * So the trace preserves the access patterns (e.g. the same key being read by multiple transactions),
+ * but the original names can't be recovered.
+ *
+ * YapDatabaseWorkloadTraceReplay re-runs a trace against a (fresh) database, using synthetic values.
+ * This makes it possible to benchmark proposed optimizations against a real (production) workload.
+ *
+ * The trace is a compact binary file:
+ * - header : "YDBTRACE" (8 bytes), followed by the version (1 byte)
+ * - records: one per transaction, in the order the transactions completed
+ *
+ * Integers are encoded as (unsigned LEB128) varints.
+ * Each transaction record is:
+ * - kind (1 byte, always 1), connection id, flags (1 byte), start (microseconds), duration (microseconds),
+ *   event count, followed by the events
+ *
+ * Each event is an operation (1 byte), followed by the operands listed next to the operation below.
+**/
+
+typedef NS_ENUM(uint8_t, YapDatabaseWorkloadTraceOperation) {
+	YapDatabaseWorkloadTraceOperationGetObject        = 1,  // collection, key
+	YapDatabaseWorkloadTraceOperationGetMetadata      = 2,  // collection, key
+	YapDatabaseWorkloadTraceOperationGetRow           = 3,  // collection, key
+	YapDatabaseWorkloadTraceOperationHasKey           = 4,  // collection, key
+	YapDatabaseWorkloadTraceOperationEnumerate        = 5,  // collection, enumeration (1 byte)
+	YapDatabaseWorkloadTraceOperationSetRow           = 6,  // collection, key, object size, metadata size
+	YapDatabaseWorkloadTraceOperationReplaceObject    = 7,  // collection, key, object size
+	YapDatabaseWorkloadTraceOperationReplaceMetadata  = 8,  // collection, key, metadata size
+	YapDatabaseWorkloadTraceOperationRemove           = 9,  // collection, key
+	YapDatabaseWorkloadTraceOperationRemoveCollection = 10, // collection
+	YapDatabaseWorkloadTraceOperationRemoveAll        = 11, // (nothing)
+	YapDatabaseWorkloadTraceOperationExtension        = 12, // length, UTF-8 name
+};
+
+/**
+ * What was enumerated (for YapDatabaseWorkloadTraceOperationEnumerate).
+**/
+typedef NS_ENUM(uint8_t, YapDatabaseWorkloadTraceEnumeration) {
+	YapDatabaseWorkloadTraceEnumerationKeys     = 0,
+	YapDatabaseWorkloadTraceEnumerationObjects  = 1,
+	YapDatabaseWorkloadTraceEnumerationMetadata = 2,
+	YapDatabaseWorkloadTraceEnumerationRows     = 3,
+};
+
+/**
+ * Collections & keys are encoded as their (salted) 64-bit hash.
+ * Metadata sizes are encoded as (size + 1), where zero means there wasn't any metadata.
+ *
+ * Transaction flags:
+ * - bit 0 : read-write transaction
+ * - bit 1 : the transaction was rolled back
+**/
+
+@interface YapDatabaseWorkloadTraceRecorder : NSObject
+
+/**
+ * Creates the trace file at the given path (replacing any existing file).
+ * Returns nil if the file couldn't be created.
+ *
+ * A single recorder may be shared by multiple connections (of the same database).
+**/
+- (nullable instancetype)initWithPath:(NSString *)path;
+
+@property (nonatomic, copy, readonly) NSString *path;
+
+/**
+ * The number of transactions recorded so far.
+**/
+@property (atomic, assign, readonly) NSUInteger transactionCount;
+
+/**
+ * Returns the hash that identifies the given collection within this trace.
+ * Since the hash is salted, this is the only way to match the collections of a trace to their names.
+ * (For example, to label the per-collection results of YapDatabaseCacheSimulation.)
+**/
+- (uint64_t)hashForCollection:(NSString *)collection;
+
+/**
+ * Transactions are written to the file asynchronously.
+ * This method blocks until every transaction recorded so far has been written to the file.
+**/
+- (void)flush;
+
+/**
+ * Flushes, and closes the file. Transactions that complete after the recorder is closed are discarded.
+ * This is done automatically when the recorder is deallocated.
+**/
+- (void)close;
+
+@end
+
+#pragma mark -
+
+@interface YapDatabaseWorkloadTraceReplayStatistics : NSObject
+
+/** The number of transactions replayed, and how many of those were read-write transactions. **/
+@property (nonatomic, assign, readonly) NSUInteger transactionCount;
+@property (nonatomic, assign, readonly) NSUInteger readWriteTransactionCount;
+
+/** The number of events (reads, writes, enumerations, etc) replayed. **/
+@property (nonatomic, assign, readonly) NSUInteger operationCount;
+
+/** The total time spent within the transactions, when recorded, and when replayed. **/
+@property (nonatomic, assign, readonly) NSTimeInterval recordedDuration;
+@property (nonatomic, assign, readonly) NSTimeInterval replayedDuration;
+
+/** The distribution of the (replayed) transaction durations. **/
+@property (nonatomic, assign, readonly) NSTimeInterval p50Duration;
+@property (nonatomic, assign, readonly) NSTimeInterval p99Duration;
+@property (nonatomic, assign, readonly) NSTimeInterval maxDuration;
+
+@end
+
+@interface YapDatabaseWorkloadTraceReplay : NSObject
+
+/**
+ * Loads the trace at the given path.
+ * Returns nil if the file couldn't be read, isn't a (supported) workload trace, or is truncated or corrupt.
+**/
+- (nullable instancetype)initWithPath:(NSString *)path;
+
+/**
+ * The number of transactions in the trace.
+**/
+@property (nonatomic, assign, readonly) NSUInteger transactionCount;
+
+/**
+ * The number of events (reads, writes, enumerations, etc) in the trace, in total and per operation.
+**/
+@property (nonatomic, assign, readonly) NSUInteger operationCount;
+- (NSUInteger)countOfOperation:(YapDatabaseWorkloadTraceOperation)operation;
+
+/**
+ * If YES, the replay waits between transactions, so that each transaction starts at the same
+ * offset (from the beginning of the trace) as it did when recorded.
+ * If NO, the transactions are replayed back-to-back, as fast as possible.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL preservesTiming;
+
+/**
+ * Replays every transaction against the given database, in the order they were recorded.
+ * The transactions of each recorded connection are replayed on their own connection,
+ * however the transactions are executed one at a time, so the replay is deterministic.
+ *
+ * Collections & keys are replaced with names derived from their hashes,
+ * and values are replaced with (deterministic) NSData values of the recorded sizes.
+ * So the database should use serializers that support NSData (such as the default serializers).
+ *
+ * Extension accesses are replayed using [transaction ext:], which is a no-op if there's no such extension.
+ * The extension queries themselves aren't recorded.
+ *
+ * This method is synchronous.
+**/
+- (YapDatabaseWorkloadTraceReplayStatistics *)replayWithDatabase:(YapDatabase *)database;
+
+@end
+
+NS_ASSUME_NONNULL_END
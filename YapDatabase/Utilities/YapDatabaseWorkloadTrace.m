@@ -0,0 +1,939 @@
+#import "YapDatabaseWorkloadTrace.h"
+#import "YapDatabaseWorkloadTracePrivate.h"
+#import "YapDatabaseTransactionMetricsPrivate.h"
+#import "YapDatabase.h"
+#import "YapDatabaseLogging.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+static const char YapDatabaseWorkloadTraceMagic[8] = { 'Y','D','B','T','R','A','C','E' };
+static const uint8_t YapDatabaseWorkloadTraceVersion = 1;
+
+static const size_t YapDatabaseWorkloadTraceHeaderSize = 9; // magic + version
+
+static const uint8_t YapDatabaseWorkloadTraceRecordTransaction = 1;
+
+static void YapWorkloadTraceAppendVarint(NSMutableData *data, uint64_t value)
+{
+	uint8_t buffer[10];
+	size_t length = 0;
+	
+	do {
+		uint8_t byte = (uint8_t)(value & 0x7F);
+		value >>= 7;
+		if (value) byte |= 0x80;
+		
+		buffer[length++] = byte;
+		
+	} while (value);
+	
+	[data appendBytes:buffer length:length];
+}
+
+static void YapWorkloadTraceAppendByte(NSMutableData *data, uint8_t byte)
+{
+	[data appendBytes:&byte length:1];
+}
+
+/**
+ * FNV-1a (64-bit) over the UTF-16 characters, seeded with the recorder's salt.
+ * The salt is never written to the trace, so the original strings can't be recovered by hashing guesses.
+**/
+static uint64_t YapWorkloadTraceHash(NSString *string, uint64_t salt)
+{
+	const uint64_t prime = 1099511628211ULL;
+	uint64_t hash = 14695981039346656037ULL ^ salt;
+	
+	unichar buffer[64];
+	NSUInteger length = string.length;
+	
+	for (NSUInteger offset = 0; offset < length; offset += 64)
+	{
+		NSUInteger count = MIN((NSUInteger)64, length - offset);
+		[string getCharacters:buffer range:NSMakeRange(offset, count)];
+		
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			hash ^= (uint8_t)(buffer[i]);      hash *= prime;
+			hash ^= (uint8_t)(buffer[i] >> 8); hash *= prime;
+		}
+	}
+	
+	return hash;
+}
+
+static uint64_t YapWorkloadTraceMicroseconds(uint64_t ticks)
+{
+	return (uint64_t)(YapDatabaseTicksToSeconds(ticks) * 1000000.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface YapDatabaseWorkloadTraceRecorder ()
+
+- (void)appendRecord:(NSData *)record;
+
+@end
+
+@interface YapDatabaseWorkloadTraceBuffer ()
+
+- (instancetype)initWithRecorder:(YapDatabaseWorkloadTraceRecorder *)recorder
+                            salt:(uint64_t)salt
+               recorderStartTime:(uint64_t)recorderStartTime
+                    connectionID:(uint32_t)connectionID
+                       readWrite:(BOOL)isReadWrite;
+
+@end
+
+@implementation YapDatabaseWorkloadTraceRecorder
+{
+	int fd;
+	dispatch_queue_t writeQueue;
+	
+	uint64_t salt;
+	uint64_t startTime;
+	
+	atomic_uint lastConnectionID;
+	atomic_ullong recordCount;
+}
+
+@synthesize path = path;
+
+- (instancetype)initWithPath:(NSString *)inPath
+{
+	if ((self = [super init]))
+	{
+		fd = -1;
+		if (inPath == nil) return nil;
+		
+		path = [inPath copy];
+		
+		fd = open([path fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			YDBLogError(@"Unable to create workload trace: %@ (errno: %d)", path, errno);
+			return nil;
+		}
+		
+		uint8_t header[YapDatabaseWorkloadTraceHeaderSize];
+		memcpy(header, YapDatabaseWorkloadTraceMagic, sizeof(YapDatabaseWorkloadTraceMagic));
+		header[8] = YapDatabaseWorkloadTraceVersion;
+		
+		if (write(fd, header, sizeof(header)) != (ssize_t)sizeof(header))
+		{
+			YDBLogError(@"Unable to write workload trace: %@ (errno: %d)", path, errno);
+			
+			close(fd);
+			fd = -1;
+			return nil;
+		}
+		
+		writeQueue = dispatch_queue_create("YapDatabaseWorkloadTraceRecorder", DISPATCH_QUEUE_SERIAL);
+		
+		arc4random_buf(&salt, sizeof(salt));
+		startTime = mach_absolute_time();
+		
+		atomic_init(&lastConnectionID, 0);
+		atomic_init(&recordCount, 0);
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+- (NSUInteger)transactionCount
+{
+	return (NSUInteger)atomic_load_explicit(&recordCount, memory_order_relaxed);
+}
+
+- (uint64_t)hashForCollection:(NSString *)collection
+{
+	return YapWorkloadTraceHash(collection ?: @"", salt);
+}
+
+- (uint32_t)nextConnectionID
+{
+	return atomic_fetch_add_explicit(&lastConnectionID, 1, memory_order_relaxed) + 1;
+}
+
+- (YapDatabaseWorkloadTraceBuffer *)beginTransactionWithConnectionID:(uint32_t)connectionID
+                                                          readWrite:(BOOL)isReadWrite
+{
+	return [[YapDatabaseWorkloadTraceBuffer alloc] initWithRecorder:self
+	                                                           salt:salt
+	                                              recorderStartTime:startTime
+	                                                   connectionID:connectionID
+	                                                      readWrite:isReadWrite];
+}
+
+- (void)appendRecord:(NSData *)record
+{
+	dispatch_async(writeQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (fd < 0) return; // closed
+		
+		const uint8_t *bytes = record.bytes;
+		size_t remaining = record.length;
+		
+		while (remaining > 0)
+		{
+			ssize_t written = write(fd, bytes, remaining);
+			if (written < 0)
+			{
+				if (errno == EINTR) continue;
+				
+				YDBLogError(@"Unable to write workload trace: %@ (errno: %d)", path, errno);
+				
+				// A partial record would corrupt the rest of the trace.
+				close(fd);
+				fd = -1;
+				return;
+			}
+			
+			bytes += written;
+			remaining -= (size_t)written;
+		}
+		
+		atomic_fetch_add_explicit(&recordCount, 1, memory_order_relaxed);
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (void)flush
+{
+	dispatch_sync(writeQueue, ^{});
+}
+
+- (void)close
+{
+	dispatch_sync(writeQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (fd >= 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	
+	#pragma clang diagnostic pop
+	});
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseWorkloadTraceBuffer
+{
+	YapDatabaseWorkloadTraceRecorder *recorder;
+	
+	uint64_t salt;
+	uint64_t recorderStartTime;
+	uint64_t startTime;
+	
+	uint32_t connectionID;
+	BOOL isReadWrite;
+	
+	NSMutableData *events;
+	NSUInteger eventCount;
+}
+
+- (instancetype)initWithRecorder:(YapDatabaseWorkloadTraceRecorder *)inRecorder
+                            salt:(uint64_t)inSalt
+               recorderStartTime:(uint64_t)inRecorderStartTime
+                    connectionID:(uint32_t)inConnectionID
+                       readWrite:(BOOL)inIsReadWrite
+{
+	if ((self = [super init]))
+	{
+		recorder = inRecorder;
+		salt = inSalt;
+		recorderStartTime = inRecorderStartTime;
+		startTime = mach_absolute_time();
+		
+		connectionID = inConnectionID;
+		isReadWrite = inIsReadWrite;
+		
+		events = [[NSMutableData alloc] initWithCapacity:256];
+	}
+	return self;
+}
+
+- (void)appendOperation:(YapDatabaseWorkloadTraceOperation)operation collection:(NSString *)collection
+{
+	YapWorkloadTraceAppendByte(events, operation);
+	YapWorkloadTraceAppendVarint(events, YapWorkloadTraceHash(collection ?: @"", salt));
+	
+	eventCount++;
+}
+
+- (void)appendOperation:(YapDatabaseWorkloadTraceOperation)operation
+             collection:(NSString *)collection
+                    key:(NSString *)key
+{
+	[self appendOperation:operation collection:collection];
+	YapWorkloadTraceAppendVarint(events, YapWorkloadTraceHash(key ?: @"", salt));
+}
+
+- (void)recordOperation:(YapDatabaseWorkloadTraceOperation)operation
+             collection:(NSString *)collection
+                    key:(NSString *)key
+{
+	[self appendOperation:operation collection:collection key:key];
+}
+
+- (void)recordEnumeration:(YapDatabaseWorkloadTraceEnumeration)enumeration
+             inCollection:(NSString *)collection
+{
+	[self appendOperation:YapDatabaseWorkloadTraceOperationEnumerate collection:collection];
+	YapWorkloadTraceAppendByte(events, enumeration);
+}
+
+- (void)recordSetRowWithCollection:(NSString *)collection
+                               key:(NSString *)key
+                        objectSize:(NSUInteger)objectSize
+                      metadataSize:(NSUInteger)metadataSize
+{
+	[self appendOperation:YapDatabaseWorkloadTraceOperationSetRow collection:collection key:key];
+	YapWorkloadTraceAppendVarint(events, objectSize);
+	YapWorkloadTraceAppendVarint(events, (metadataSize == NSNotFound) ? 0 : ((uint64_t)metadataSize + 1));
+}
+
+- (void)recordReplaceObjectWithCollection:(NSString *)collection key:(NSString *)key objectSize:(NSUInteger)size
+{
+	[self appendOperation:YapDatabaseWorkloadTraceOperationReplaceObject collection:collection key:key];
+	YapWorkloadTraceAppendVarint(events, size);
+}
+
+- (void)recordReplaceMetadataWithCollection:(NSString *)collection key:(NSString *)key metadataSize:(NSUInteger)size
+{
+	[self appendOperation:YapDatabaseWorkloadTraceOperationReplaceMetadata collection:collection key:key];
+	YapWorkloadTraceAppendVarint(events, (size == NSNotFound) ? 0 : ((uint64_t)size + 1));
+}
+
+- (void)recordRemoveCollection:(NSString *)collection
+{
+	[self appendOperation:YapDatabaseWorkloadTraceOperationRemoveCollection collection:collection];
+}
+
+- (void)recordRemoveAll
+{
+	YapWorkloadTraceAppendByte(events, YapDatabaseWorkloadTraceOperationRemoveAll);
+	eventCount++;
+}
+
+- (void)recordExtension:(NSString *)extensionName
+{
+	NSData *name = [extensionName dataUsingEncoding:NSUTF8StringEncoding];
+	
+	YapWorkloadTraceAppendByte(events, YapDatabaseWorkloadTraceOperationExtension);
+	YapWorkloadTraceAppendVarint(events, name.length);
+	[events appendData:name];
+	
+	eventCount++;
+}
+
+- (void)finishWithRollback:(BOOL)didRollback
+{
+	uint64_t endTime = mach_absolute_time();
+	
+	uint8_t flags = 0;
+	if (isReadWrite) flags |= YapDatabaseWorkloadTraceFlagReadWrite;
+	if (didRollback) flags |= YapDatabaseWorkloadTraceFlagRollback;
+	
+	NSMutableData *record = [[NSMutableData alloc] initWithCapacity:(events.length + 32)];
+	
+	YapWorkloadTraceAppendByte(record, YapDatabaseWorkloadTraceRecordTransaction);
+	YapWorkloadTraceAppendVarint(record, connectionID);
+	YapWorkloadTraceAppendByte(record, flags);
+	YapWorkloadTraceAppendVarint(record, YapWorkloadTraceMicroseconds(startTime - recorderStartTime));
+	YapWorkloadTraceAppendVarint(record, YapWorkloadTraceMicroseconds(endTime - startTime));
+	YapWorkloadTraceAppendVarint(record, eventCount);
+	[record appendData:events];
+	
+	[recorder appendRecord:record];
+	
+	events = nil;
+	eventCount = 0;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Replay
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+NSData * YapWorkloadTraceLoad(NSString *path)
+{
+	if (path == nil) return nil;
+	
+	NSData *fileData = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:NULL];
+	
+	if (fileData.length < YapDatabaseWorkloadTraceHeaderSize) return nil;
+	if (memcmp(fileData.bytes, YapDatabaseWorkloadTraceMagic, sizeof(YapDatabaseWorkloadTraceMagic)) != 0) return nil;
+	if (((const uint8_t *)fileData.bytes)[8] != YapDatabaseWorkloadTraceVersion) return nil;
+	
+	return fileData;
+}
+
+YapWorkloadTraceReader YapWorkloadTraceReaderMake(NSData *trace)
+{
+	YapWorkloadTraceReader reader = { trace.bytes, trace.length, YapDatabaseWorkloadTraceHeaderSize, NO };
+	return reader;
+}
+
+static uint8_t YapWorkloadTraceReadByte(YapWorkloadTraceReader *reader)
+{
+	if (reader->failed || reader->offset >= reader->length)
+	{
+		reader->failed = YES;
+		return 0;
+	}
+	
+	return reader->bytes[reader->offset++];
+}
+
+static uint64_t YapWorkloadTraceReadVarint(YapWorkloadTraceReader *reader)
+{
+	uint64_t value = 0;
+	
+	for (unsigned shift = 0; shift < 64; shift += 7)
+	{
+		uint8_t byte = YapWorkloadTraceReadByte(reader);
+		if (reader->failed) return 0;
+		
+		value |= ((uint64_t)(byte & 0x7F) << shift);
+		
+		if ((byte & 0x80) == 0) return value;
+	}
+	
+	reader->failed = YES;
+	return 0;
+}
+
+BOOL YapWorkloadTraceReadTransactionHeader(YapWorkloadTraceReader *reader, YapWorkloadTraceTransactionHeader *header)
+{
+	if (YapWorkloadTraceReadByte(reader) != YapDatabaseWorkloadTraceRecordTransaction) {
+		reader->failed = YES;
+	}
+	
+	header->connectionID = (uint32_t)YapWorkloadTraceReadVarint(reader);
+	header->flags        = YapWorkloadTraceReadByte(reader);
+	header->start        = YapWorkloadTraceReadVarint(reader);
+	header->duration     = YapWorkloadTraceReadVarint(reader);
+	header->eventCount   = YapWorkloadTraceReadVarint(reader);
+	
+	return !reader->failed;
+}
+
+BOOL YapWorkloadTraceReadEvent(YapWorkloadTraceReader *reader, YapWorkloadTraceEvent *event)
+{
+	event->operation = YapWorkloadTraceReadByte(reader);
+	
+	switch (event->operation)
+	{
+		case YapDatabaseWorkloadTraceOperationGetObject   :
+		case YapDatabaseWorkloadTraceOperationGetMetadata :
+		case YapDatabaseWorkloadTraceOperationGetRow      :
+		case YapDatabaseWorkloadTraceOperationHasKey      :
+		case YapDatabaseWorkloadTraceOperationRemove      :
+		{
+			event->collection = YapWorkloadTraceReadVarint(reader);
+			event->key = YapWorkloadTraceReadVarint(reader);
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationEnumerate :
+		{
+			event->collection = YapWorkloadTraceReadVarint(reader);
+			event->enumeration = YapWorkloadTraceReadByte(reader);
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationSetRow :
+		{
+			event->collection = YapWorkloadTraceReadVarint(reader);
+			event->key = YapWorkloadTraceReadVarint(reader);
+			event->size = YapWorkloadTraceReadVarint(reader);
+			event->metadataSize = YapWorkloadTraceReadVarint(reader);
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationReplaceObject   :
+		case YapDatabaseWorkloadTraceOperationReplaceMetadata :
+		{
+			event->collection = YapWorkloadTraceReadVarint(reader);
+			event->key = YapWorkloadTraceReadVarint(reader);
+			event->size = YapWorkloadTraceReadVarint(reader);
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemoveCollection :
+		{
+			event->collection = YapWorkloadTraceReadVarint(reader);
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemoveAll :
+		{
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationExtension :
+		{
+			uint64_t nameLength = YapWorkloadTraceReadVarint(reader);
+			if (reader->failed || nameLength > (reader->length - reader->offset))
+			{
+				reader->failed = YES;
+				break;
+			}
+			
+			event->name = reader->bytes + reader->offset;
+			event->nameLength = (size_t)nameLength;
+			reader->offset += (size_t)nameLength;
+			break;
+		}
+		default:
+		{
+			reader->failed = YES;
+			break;
+		}
+	}
+	
+	return !reader->failed;
+}
+
+#pragma mark -
+
+@interface YapDatabaseWorkloadTraceReplayStatistics ()
+
+@property (nonatomic, assign, readwrite) NSUInteger transactionCount;
+@property (nonatomic, assign, readwrite) NSUInteger readWriteTransactionCount;
+@property (nonatomic, assign, readwrite) NSUInteger operationCount;
+@property (nonatomic, assign, readwrite) NSTimeInterval recordedDuration;
+@property (nonatomic, assign, readwrite) NSTimeInterval replayedDuration;
+@property (nonatomic, assign, readwrite) NSTimeInterval p50Duration;
+@property (nonatomic, assign, readwrite) NSTimeInterval p99Duration;
+@property (nonatomic, assign, readwrite) NSTimeInterval maxDuration;
+
+@end
+
+@implementation YapDatabaseWorkloadTraceReplayStatistics
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseWorkloadTraceReplayStatistics[%p]: transactions(%lu) readWrite(%lu) operations(%lu)"
+	  @" recorded(%.6f) replayed(%.6f) p50(%.6f) p99(%.6f) max(%.6f)>", self,
+	  (unsigned long)_transactionCount, (unsigned long)_readWriteTransactionCount, (unsigned long)_operationCount,
+	  _recordedDuration, _replayedDuration, _p50Duration, _p99Duration, _maxDuration];
+}
+
+@end
+
+#pragma mark -
+
+@implementation YapDatabaseWorkloadTraceReplay
+{
+	NSData *data;
+	
+	NSUInteger operationCounts[YapDatabaseWorkloadTraceOperationExtension + 1]; // indexed by operation
+	
+	NSMutableDictionary<NSNumber *, NSString *> *collectionNames;
+	NSMutableDictionary<NSNumber *, NSString *> *keyNames;
+	
+	NSData *noise;
+}
+
+@synthesize transactionCount = transactionCount;
+@synthesize operationCount = totalOperationCount;
+@synthesize preservesTiming = preservesTiming;
+
+- (instancetype)initWithPath:(NSString *)path
+{
+	NSData *fileData = YapWorkloadTraceLoad(path);
+	if (fileData == nil) return nil;
+	
+	if ((self = [super init]))
+	{
+		data = fileData;
+		
+		// Validate the whole trace, and count the transactions & operations.
+		// The recorder only ever writes complete records, so a record that can't be read means the file
+		// is truncated or corrupt. In which case we refuse to load it (rather than replay a partial workload).
+		
+		YapWorkloadTraceReader reader = YapWorkloadTraceReaderMake(data);
+		
+		while (reader.offset < reader.length)
+		{
+			YapWorkloadTraceTransactionHeader header;
+			if (!YapWorkloadTraceReadTransactionHeader(&reader, &header)) break;
+			
+			YapWorkloadTraceEvent event;
+			for (uint64_t i = 0; i < header.eventCount; i++)
+			{
+				if (!YapWorkloadTraceReadEvent(&reader, &event)) break;
+				
+				operationCounts[event.operation]++;
+				totalOperationCount++;
+			}
+			
+			if (reader.failed) break;
+			transactionCount++;
+		}
+		
+		if (reader.failed)
+		{
+			YDBLogWarn(@"Unable to load workload trace (truncated or corrupt): %@", path);
+			return nil;
+		}
+		
+		collectionNames = [[NSMutableDictionary alloc] init];
+		keyNames = [[NSMutableDictionary alloc] init];
+		
+		// A deterministic (xorshift) noise buffer, which the synthetic values are sliced from.
+		
+		NSMutableData *noiseData = [NSMutableData dataWithLength:(64 * 1024)];
+		uint64_t *words = (uint64_t *)noiseData.mutableBytes;
+		uint64_t x = 0x9E3779B97F4A7C15ULL;
+		
+		for (NSUInteger i = 0; i < (noiseData.length / sizeof(uint64_t)); i++)
+		{
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			words[i] = x;
+		}
+		noise = noiseData;
+	}
+	return self;
+}
+
+- (NSUInteger)countOfOperation:(YapDatabaseWorkloadTraceOperation)operation
+{
+	if (operation > YapDatabaseWorkloadTraceOperationExtension) return 0;
+	
+	return operationCounts[operation];
+}
+
+- (NSString *)collectionForHash:(uint64_t)hash
+{
+	NSNumber *number = @(hash);
+	
+	NSString *collection = collectionNames[number];
+	if (collection == nil)
+	{
+		collection = [NSString stringWithFormat:@"c%016llx", hash];
+		collectionNames[number] = collection;
+	}
+	
+	return collection;
+}
+
+- (NSString *)keyForHash:(uint64_t)hash
+{
+	NSNumber *number = @(hash);
+	
+	NSString *key = keyNames[number];
+	if (key == nil)
+	{
+		key = [NSString stringWithFormat:@"k%016llx", hash];
+		keyNames[number] = key;
+	}
+	
+	return key;
+}
+
+/**
+ * The same (collection, key, size) always produces the same value, so the replay is deterministic.
+**/
+- (NSData *)valueWithSize:(uint64_t)size forKeyHash:(uint64_t)keyHash
+{
+	NSMutableData *value = [NSMutableData dataWithLength:(NSUInteger)size];
+	
+	uint8_t *dst = value.mutableBytes;
+	const uint8_t *src = noise.bytes;
+	NSUInteger noiseLength = noise.length;
+	
+	NSUInteger offset = (NSUInteger)(keyHash % noiseLength);
+	NSUInteger remaining = (NSUInteger)size;
+	
+	while (remaining > 0)
+	{
+		NSUInteger count = MIN(remaining, noiseLength - offset);
+		memcpy(dst, src + offset, count);
+		
+		dst += count;
+		remaining -= count;
+		offset = 0;
+	}
+	
+	return value;
+}
+
+- (void)replayEvent:(YapWorkloadTraceEvent *)event
+    withTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabaseReadWriteTransaction *rwTransaction = nil;
+	if ([transaction isKindOfClass:[YapDatabaseReadWriteTransaction class]]) {
+		rwTransaction = (YapDatabaseReadWriteTransaction *)transaction;
+	}
+	
+	switch (event->operation)
+	{
+		case YapDatabaseWorkloadTraceOperationGetObject :
+		{
+			(void)[transaction objectForKey:[self keyForHash:event->key]
+			                   inCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationGetMetadata :
+		{
+			(void)[transaction metadataForKey:[self keyForHash:event->key]
+			                     inCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationGetRow :
+		{
+			[transaction getObject:NULL
+			              metadata:NULL
+			                forKey:[self keyForHash:event->key]
+			          inCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationHasKey :
+		{
+			(void)[transaction hasObjectForKey:[self keyForHash:event->key]
+			                      inCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationEnumerate :
+		{
+			NSString *collection = [self collectionForHash:event->collection];
+			
+			switch (event->enumeration)
+			{
+				case YapDatabaseWorkloadTraceEnumerationKeys :
+				{
+					[transaction enumerateKeysInCollection:collection
+					                            usingBlock:^(NSString *key, BOOL *stop) {}];
+					break;
+				}
+				case YapDatabaseWorkloadTraceEnumerationObjects :
+				{
+					[transaction enumerateKeysAndObjectsInCollection:collection
+					                                      usingBlock:^(NSString *key, id object, BOOL *stop) {}];
+					break;
+				}
+				case YapDatabaseWorkloadTraceEnumerationMetadata :
+				{
+					[transaction enumerateKeysAndMetadataInCollection:collection
+					                                       usingBlock:^(NSString *key, id metadata, BOOL *stop) {}];
+					break;
+				}
+				default :
+				{
+					[transaction enumerateRowsInCollection:collection
+					                            usingBlock:^(NSString *key, id object, id metadata, BOOL *stop) {}];
+					break;
+				}
+			}
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationSetRow :
+		{
+			NSData *object = [self valueWithSize:event->size forKeyHash:event->key];
+			NSData *metadata = nil;
+			if (event->metadataSize > 0) {
+				metadata = [self valueWithSize:(event->metadataSize - 1) forKeyHash:~(event->key)];
+			}
+			
+			[rwTransaction setObject:object
+			                  forKey:[self keyForHash:event->key]
+			            inCollection:[self collectionForHash:event->collection]
+			            withMetadata:metadata];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationReplaceObject :
+		{
+			[rwTransaction replaceObject:[self valueWithSize:event->size forKeyHash:event->key]
+			                      forKey:[self keyForHash:event->key]
+			                inCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationReplaceMetadata :
+		{
+			NSData *metadata = nil;
+			if (event->size > 0) {
+				metadata = [self valueWithSize:(event->size - 1) forKeyHash:~(event->key)];
+			}
+			
+			[rwTransaction replaceMetadata:metadata
+			                        forKey:[self keyForHash:event->key]
+			                  inCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemove :
+		{
+			[rwTransaction removeObjectForKey:[self keyForHash:event->key]
+			                     inCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemoveCollection :
+		{
+			[rwTransaction removeAllObjectsInCollection:[self collectionForHash:event->collection]];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationRemoveAll :
+		{
+			[rwTransaction removeAllObjectsInAllCollections];
+			break;
+		}
+		case YapDatabaseWorkloadTraceOperationExtension :
+		{
+			NSString *extensionName = [[NSString alloc] initWithBytes:event->name
+			                                                   length:event->nameLength
+			                                                 encoding:NSUTF8StringEncoding];
+			if (extensionName) {
+				(void)[transaction ext:extensionName];
+			}
+			break;
+		}
+	}
+}
+
+- (YapDatabaseWorkloadTraceReplayStatistics *)replayWithDatabase:(YapDatabase *)database
+{
+	YapDatabaseWorkloadTraceReplayStatistics *statistics = [[YapDatabaseWorkloadTraceReplayStatistics alloc] init];
+	
+	NSMutableDictionary<NSNumber *, YapDatabaseConnection *> *connections = [NSMutableDictionary dictionary];
+	NSMutableArray<NSNumber *> *durations = [NSMutableArray arrayWithCapacity:transactionCount];
+	
+	__block YapWorkloadTraceReader reader = YapWorkloadTraceReaderMake(data);
+	
+	uint64_t firstStart = 0;
+	uint64_t recordedMicroseconds = 0;
+	NSUInteger operationCount = 0;
+	NSUInteger readWriteCount = 0;
+	
+	NSDate *replayStart = [NSDate date];
+	
+	for (NSUInteger i = 0; i < transactionCount; i++) { @autoreleasepool {
+		
+		YapWorkloadTraceTransactionHeader header;
+		if (!YapWorkloadTraceReadTransactionHeader(&reader, &header)) break;
+		
+		if (i == 0) firstStart = header.start;
+		
+		if (preservesTiming && (header.start > firstStart))
+		{
+			NSTimeInterval offset = (double)(header.start - firstStart) / 1000000.0;
+			NSTimeInterval delay = offset - ([replayStart timeIntervalSinceNow] * -1.0);
+			
+			if (delay > 0) {
+				[NSThread sleepForTimeInterval:delay];
+			}
+		}
+		
+		NSNumber *connectionID = @(header.connectionID);
+		YapDatabaseConnection *connection = connections[connectionID];
+		if (connection == nil)
+		{
+			connection = [database newConnection];
+			connections[connectionID] = connection;
+		}
+		
+		uint64_t eventCount = header.eventCount;
+		BOOL didRollback = (header.flags & YapDatabaseWorkloadTraceFlagRollback) != 0;
+		
+		void (^replayEvents)(YapDatabaseReadTransaction *) = ^(YapDatabaseReadTransaction *transaction) {
+			
+			YapWorkloadTraceEvent event;
+			for (uint64_t e = 0; e < eventCount; e++)
+			{
+				memset(&event, 0, sizeof(event));
+				if (!YapWorkloadTraceReadEvent(&reader, &event)) break;
+				
+				[self replayEvent:&event withTransaction:transaction];
+			}
+		};
+		
+		NSDate *start = [NSDate date];
+		
+		if (header.flags & YapDatabaseWorkloadTraceFlagReadWrite)
+		{
+			[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+				
+				replayEvents(transaction);
+				
+				if (didRollback) {
+					[transaction rollback];
+				}
+			}];
+			
+			readWriteCount++;
+		}
+		else
+		{
+			[connection readWithBlock:replayEvents];
+		}
+		
+		[durations addObject:@([start timeIntervalSinceNow] * -1.0)];
+		
+		if (reader.failed) break;
+		
+		recordedMicroseconds += header.duration;
+		operationCount += (NSUInteger)eventCount;
+	}}
+	
+	NSArray<NSNumber *> *sortedDurations = [durations sortedArrayUsingSelector:@selector(compare:)];
+	NSUInteger count = sortedDurations.count;
+	
+	double total = 0.0;
+	for (NSNumber *duration in durations)
+	{
+		total += [duration doubleValue];
+	}
+	
+	statistics.transactionCount = count;
+	statistics.readWriteTransactionCount = readWriteCount;
+	statistics.operationCount = operationCount;
+	statistics.recordedDuration = (double)recordedMicroseconds / 1000000.0;
+	statistics.replayedDuration = total;
+	
+	if (count > 0)
+	{
+		statistics.p50Duration = [sortedDurations[(count - 1) / 2] doubleValue];
+		statistics.p99Duration = [sortedDurations[MIN(count - 1, (NSUInteger)ceil(count * 0.99) - 1)] doubleValue];
+		statistics.maxDuration = [sortedDurations[count - 1] doubleValue];
+	}
+	
+	return statistics;
+}
+
+@end
@@ -0,0 +1,206 @@
+#import <Foundation/Foundation.h>
+
+#import "YapDatabase.h"
+#import "YapDatabaseConnection.h"
+#import "YapDatabaseTransaction.h"
+
+@class YapShardedDatabaseConnection;
+@class YapShardedReadWriteTransaction;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Welcome to YapDatabase!
+ *
+ * The project page has a wealth of documentation if you have any questions.
+ * https://github.com/yapstudios/YapDatabase
+ *
+ * If you're new to the project you may want to visit the wiki.
+ * https://github.com/yapstudios/YapDatabase/wiki
+ *
+ * SQLite allows only a single writer per database file.
+ * So every read-write transaction for a database is serialized, even if they touch unrelated collections.
+ *
+ * A sharded database maps collections to separate database files (shards).
+ * Each shard is a regular YapDatabase, with its own WAL and its own write queue.
+ * Thus read-write transactions in different shards run in parallel.
+ *
+ * Every collection that isn't explicitly mapped belongs to the default shard.
+ *
+ * Extensions are registered with individual shards.
+ * An extension only sees the collections of the shard it's registered with.
+**/
+@interface YapShardedDatabase : NSObject
+
+/**
+ * Opens or creates every shard.
+ *
+ * @param shardPaths
+ *   Maps each shard name to the path of its database file.
+ *
+ * @param collectionShards
+ *   Maps collections to shard names.
+ *   Every collection that isn't in the dictionary belongs to the defaultShard.
+ *
+ * @param defaultShard
+ *   The name of the shard for every unmapped collection.
+ *
+ * @param options
+ *   The options used to open every shard.
+ *
+ * @return
+ *   nil if the mapping refers to an unknown shard, or if any shard fails to open.
+**/
+- (nullable instancetype)initWithShardPaths:(NSDictionary<NSString *, NSString *> *)shardPaths
+                           collectionShards:(nullable NSDictionary<NSString *, NSString *> *)collectionShards
+                               defaultShard:(NSString *)defaultShard
+                                    options:(nullable YapDatabaseOptions *)options;
+
+/**
+ * The name of every shard (sorted).
+**/
+@property (nonatomic, copy, readonly) NSArray<NSString *> *shardNames;
+
+@property (nonatomic, copy, readonly) NSString *defaultShard;
+
+/**
+ * Returns the name of the shard the given collection belongs to.
+**/
+- (NSString *)shardForCollection:(nullable NSString *)collection;
+
+/**
+ * Returns the database for the given shard, or nil if there's no such shard.
+**/
+- (nullable YapDatabase *)databaseForShard:(NSString *)shard;
+
+/**
+ * Returns the database for the shard the given collection belongs to.
+**/
+- (YapDatabase *)databaseForCollection:(nullable NSString *)collection;
+
+/**
+ * Creates and returns a new connection, which has a connection to every shard.
+**/
+- (YapShardedDatabaseConnection *)newConnection;
+
+/**
+ * Registers the extension with the shard the given collection belongs to.
+ *
+ * Be sure to only use this for extensions that are limited to that collection (or shard).
+ * E.g. via the allowedCollections property of the extension's options.
+**/
+- (BOOL)registerExtension:(YapDatabaseExtension *)extension
+                 withName:(NSString *)extensionName
+            forCollection:(nullable NSString *)collection;
+
+/**
+ * Registers an extension (with the same name) in every shard that holds any of the given collections.
+ * Since an extension instance can only be registered with a single database,
+ * the block is invoked for each of those shards, and must return a new instance each time.
+ *
+ * @return
+ *   YES if every registration succeeded.
+**/
+- (BOOL)registerExtensionWithName:(NSString *)extensionName
+                   forCollections:(NSArray<NSString *> *)collections
+                       usingBlock:(YapDatabaseExtension* (^)(NSString *shard))block;
+
+@end
+
+#pragma mark -
+
+/**
+ * A sharded connection holds a regular YapDatabaseConnection for every shard.
+ *
+ * A read or read-write transaction for a single collection is simply executed on the connection of its shard.
+ * So it has the exact same semantics as a transaction on a regular database.
+ *
+ * A read-write transaction that spans multiple collections (and thus possibly multiple shards)
+ * opens a read-write transaction in each involved shard. The shards are always locked in the same order,
+ * so concurrent multi-shard transactions can't deadlock.
+ *
+ * Keep in mind that every shard commits separately.
+ * If the process is killed in the middle of committing a multi-shard transaction,
+ * some shards may contain the changes while others don't.
+ *
+ * A sharded connection has the same threading rules as a regular connection.
+**/
+@interface YapShardedDatabaseConnection : NSObject
+
+@property (nonatomic, strong, readonly) YapShardedDatabase *database;
+
+/**
+ * Returns the underlying connection for the given shard, or nil if there's no such shard.
+ * Use it for everything that's specific to a shard, such as long-lived read transactions.
+**/
+- (nullable YapDatabaseConnection *)connectionForShard:(NSString *)shard;
+
+/**
+ * Returns the underlying connection for the shard the given collection belongs to.
+**/
+- (YapDatabaseConnection *)connectionForCollection:(nullable NSString *)collection;
+
+/**
+ * Executes a read transaction on the shard the given collection belongs to.
+**/
+- (void)readForCollection:(nullable NSString *)collection
+                withBlock:(void (^)(YapDatabaseReadTransaction *transaction))block;
+
+/**
+ * Executes a read-write transaction on the shard the given collection belongs to.
+**/
+- (void)readWriteForCollection:(nullable NSString *)collection
+                     withBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block;
+
+/**
+ * Executes a read-write transaction on every shard the given collections belong to.
+ *
+ * Use -[YapShardedReadWriteTransaction transactionForCollection:] to get the transaction for a collection.
+ * If any of the shard transactions is rolled back, they're all rolled back.
+**/
+- (void)readWriteForCollections:(NSArray<NSString *> *)collections
+                      withBlock:(void (^)(YapShardedReadWriteTransaction *transaction))block;
+
+/**
+ * Asynchronous version of readWriteForCollections:withBlock:.
+ * The completionBlock is invoked on the main thread.
+**/
+- (void)asyncReadWriteForCollections:(NSArray<NSString *> *)collections
+                           withBlock:(void (^)(YapShardedReadWriteTransaction *transaction))block
+                     completionBlock:(nullable dispatch_block_t)completionBlock;
+
+@end
+
+#pragma mark -
+
+/**
+ * Groups the read-write transactions of a multi-shard transaction.
+ * Only valid within the block of readWriteForCollections:withBlock:.
+**/
+@interface YapShardedReadWriteTransaction : NSObject
+
+/**
+ * The names of the shards involved in the transaction (sorted).
+**/
+@property (nonatomic, copy, readonly) NSArray<NSString *> *shardNames;
+
+/**
+ * Returns the transaction for the shard the given collection belongs to.
+ * Returns nil if the shard isn't involved in the transaction.
+ * (I.e. the collection wasn't passed to readWriteForCollections:withBlock:.)
+**/
+- (nullable YapDatabaseReadWriteTransaction *)transactionForCollection:(nullable NSString *)collection;
+
+/**
+ * Returns the transaction for the given shard, or nil if the shard isn't involved in the transaction.
+**/
+- (nullable YapDatabaseReadWriteTransaction *)transactionForShard:(NSString *)shard;
+
+/**
+ * Rolls back the transaction in every involved shard.
+**/
+- (void)rollback;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,332 @@
+#import "YapShardedDatabase.h"
+#import "YapDatabasePrivate.h"
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+@interface YapShardedDatabase ()
+- (NSArray<NSString *> *)shardsForCollections:(NSArray<NSString *> *)collections;
+@end
+
+@interface YapShardedDatabaseConnection ()
+- (instancetype)initWithDatabase:(YapShardedDatabase *)database;
+@end
+
+@interface YapShardedReadWriteTransaction () {
+@public
+	NSDictionary<NSString *, YapDatabaseReadWriteTransaction *> *transactions;
+}
+- (instancetype)initWithDatabase:(YapShardedDatabase *)database
+                    transactions:(NSDictionary<NSString *, YapDatabaseReadWriteTransaction *> *)transactions;
+@end
+
+#pragma mark -
+
+@implementation YapShardedDatabase
+{
+	NSDictionary<NSString *, YapDatabase *> *databases;
+	NSDictionary<NSString *, NSString *> *collectionShards;
+}
+
+@synthesize shardNames = shardNames;
+@synthesize defaultShard = defaultShard;
+
+- (instancetype)initWithShardPaths:(NSDictionary<NSString *, NSString *> *)inShardPaths
+                  collectionShards:(NSDictionary<NSString *, NSString *> *)inCollectionShards
+                      defaultShard:(NSString *)inDefaultShard
+                           options:(YapDatabaseOptions *)options
+{
+	if ([inShardPaths objectForKey:inDefaultShard] == nil)
+	{
+		YDBLogError(@"%@ - defaultShard (%@) isn't one of the shards", THIS_METHOD, inDefaultShard);
+		return nil;
+	}
+	
+	for (NSString *shard in [inCollectionShards objectEnumerator])
+	{
+		if ([inShardPaths objectForKey:shard] == nil)
+		{
+			YDBLogError(@"%@ - collectionShards refers to unknown shard (%@)", THIS_METHOD, shard);
+			return nil;
+		}
+	}
+	
+	if ((self = [super init]))
+	{
+		NSMutableDictionary *newDatabases = [NSMutableDictionary dictionaryWithCapacity:[inShardPaths count]];
+		
+		for (NSString *shard in inShardPaths)
+		{
+			NSString *path = [inShardPaths objectForKey:shard];
+			
+			YapDatabase *database = [[YapDatabase alloc] initWithPath:path options:options];
+			if (database == nil)
+			{
+				YDBLogError(@"%@ - Unable to open shard (%@) at path: %@", THIS_METHOD, shard, path);
+				return nil;
+			}
+			
+			[newDatabases setObject:database forKey:shard];
+		}
+		
+		databases = [newDatabases copy];
+		collectionShards = inCollectionShards ? [inCollectionShards copy] : @{};
+		
+		shardNames = [[databases allKeys] sortedArrayUsingSelector:@selector(compare:)];
+		defaultShard = [inDefaultShard copy];
+	}
+	return self;
+}
+
+- (NSString *)shardForCollection:(NSString *)collection
+{
+	if (collection == nil)
+		collection = @"";
+	
+	return [collectionShards objectForKey:collection] ?: defaultShard;
+}
+
+- (YapDatabase *)databaseForShard:(NSString *)shard
+{
+	return [databases objectForKey:shard];
+}
+
+- (YapDatabase *)databaseForCollection:(NSString *)collection
+{
+	return [databases objectForKey:[self shardForCollection:collection]];
+}
+
+- (YapShardedDatabaseConnection *)newConnection
+{
+	return [[YapShardedDatabaseConnection alloc] initWithDatabase:self];
+}
+
+- (BOOL)registerExtension:(YapDatabaseExtension *)extension
+                 withName:(NSString *)extensionName
+            forCollection:(NSString *)collection
+{
+	return [[self databaseForCollection:collection] registerExtension:extension withName:extensionName];
+}
+
+- (BOOL)registerExtensionWithName:(NSString *)extensionName
+                   forCollections:(NSArray<NSString *> *)collections
+                       usingBlock:(YapDatabaseExtension* (^)(NSString *shard))block
+{
+	NSArray<NSString *> *shards = [self shardsForCollections:collections];
+	BOOL result = YES;
+	
+	for (NSString *shard in shards)
+	{
+		YapDatabaseExtension *extension = block(shard);
+		if (extension == nil)
+		{
+			YDBLogWarn(@"%@ - No extension returned for shard (%@)", THIS_METHOD, shard);
+			result = NO;
+			continue;
+		}
+		
+		if (![[databases objectForKey:shard] registerExtension:extension withName:extensionName])
+		{
+			result = NO;
+		}
+	}
+	
+	return result;
+}
+
+/**
+ * Returns the (sorted) shards that the given collections belong to.
+ * The order is important, as it's the order in which multi-shard transactions lock the shards.
+**/
+- (NSArray<NSString *> *)shardsForCollections:(NSArray<NSString *> *)collections
+{
+	NSMutableSet<NSString *> *shards = [NSMutableSet setWithCapacity:[collections count]];
+	
+	for (NSString *collection in collections)
+	{
+		[shards addObject:[self shardForCollection:collection]];
+	}
+	
+	return [[shards allObjects] sortedArrayUsingSelector:@selector(compare:)];
+}
+
+@end
+
+#pragma mark -
+
+@implementation YapShardedDatabaseConnection
+{
+	NSDictionary<NSString *, YapDatabaseConnection *> *connections;
+	dispatch_queue_t asyncQueue;
+}
+
+@synthesize database = database;
+
+- (instancetype)initWithDatabase:(YapShardedDatabase *)inDatabase
+{
+	if ((self = [super init]))
+	{
+		database = inDatabase;
+		
+		NSMutableDictionary *newConnections = [NSMutableDictionary dictionaryWithCapacity:[database.shardNames count]];
+		for (NSString *shard in database.shardNames)
+		{
+			[newConnections setObject:[[database databaseForShard:shard] newConnection] forKey:shard];
+		}
+		
+		connections = [newConnections copy];
+		asyncQueue = dispatch_queue_create("YapShardedDatabaseConnection", NULL);
+	}
+	return self;
+}
+
+- (YapDatabaseConnection *)connectionForShard:(NSString *)shard
+{
+	return [connections objectForKey:shard];
+}
+
+- (YapDatabaseConnection *)connectionForCollection:(NSString *)collection
+{
+	return [connections objectForKey:[database shardForCollection:collection]];
+}
+
+- (void)readForCollection:(NSString *)collection withBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+{
+	[[self connectionForCollection:collection] readWithBlock:block];
+}
+
+- (void)readWriteForCollection:(NSString *)collection
+                     withBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+{
+	[[self connectionForCollection:collection] readWriteWithBlock:block];
+}
+
+- (void)readWriteForCollections:(NSArray<NSString *> *)collections
+                      withBlock:(void (^)(YapShardedReadWriteTransaction *transaction))block
+{
+	NSArray<NSString *> *shards = [database shardsForCollections:collections];
+	NSMutableDictionary *transactions = [NSMutableDictionary dictionaryWithCapacity:[shards count]];
+	
+	[self _readWriteShards:shards index:0 transactions:transactions withBlock:block];
+}
+
+- (void)asyncReadWriteForCollections:(NSArray<NSString *> *)collections
+                           withBlock:(void (^)(YapShardedReadWriteTransaction *transaction))block
+                     completionBlock:(dispatch_block_t)completionBlock
+{
+	dispatch_async(asyncQueue, ^{ @autoreleasepool {
+		
+		[self readWriteForCollections:collections withBlock:block];
+		
+		if (completionBlock) {
+			dispatch_async(dispatch_get_main_queue(), completionBlock);
+		}
+	}});
+}
+
+/**
+ * Opens a read-write transaction on each shard (in order) by nesting them.
+ * Once every transaction is open, the block is invoked from within the innermost one.
+ * The shards then commit as the nested transactions unwind.
+**/
+- (void)_readWriteShards:(NSArray<NSString *> *)shards
+                   index:(NSUInteger)index
+            transactions:(NSMutableDictionary<NSString *, YapDatabaseReadWriteTransaction *> *)transactions
+               withBlock:(void (^)(YapShardedReadWriteTransaction *transaction))block
+{
+	if (index == [shards count])
+	{
+		YapShardedReadWriteTransaction *shardedTransaction =
+		  [[YapShardedReadWriteTransaction alloc] initWithDatabase:database transactions:[transactions copy]];
+		
+		block(shardedTransaction);
+		
+		// If any shard was rolled back, they all must be.
+		
+		BOOL rollback = NO;
+		for (YapDatabaseReadWriteTransaction *transaction in [transactions objectEnumerator])
+		{
+			rollback = rollback || transaction->rollback;
+		}
+		
+		if (rollback) {
+			[shardedTransaction rollback];
+		}
+		
+		shardedTransaction->transactions = nil;
+		return;
+	}
+	
+	NSString *shard = [shards objectAtIndex:index];
+	
+	[[connections objectForKey:shard] readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transactions setObject:transaction forKey:shard];
+		[self _readWriteShards:shards index:(index + 1) transactions:transactions withBlock:block];
+	}];
+}
+
+@end
+
+#pragma mark -
+
+@implementation YapShardedReadWriteTransaction
+{
+	YapShardedDatabase *database;
+}
+
+@synthesize shardNames = shardNames;
+
+- (instancetype)initWithDatabase:(YapShardedDatabase *)inDatabase
+                    transactions:(NSDictionary<NSString *, YapDatabaseReadWriteTransaction *> *)inTransactions
+{
+	if ((self = [super init]))
+	{
+		database = inDatabase;
+		transactions = inTransactions;
+		
+		shardNames = [[transactions allKeys] sortedArrayUsingSelector:@selector(compare:)];
+	}
+	return self;
+}
+
+- (YapDatabaseReadWriteTransaction *)transactionForCollection:(NSString *)collection
+{
+	NSString *shard = [database shardForCollection:collection];
+	
+	YapDatabaseReadWriteTransaction *transaction = [transactions objectForKey:shard];
+	if (transaction == nil)
+	{
+		YDBLogWarn(@"%@ - Shard (%@) of collection (%@) isn't part of the transaction", THIS_METHOD, shard, collection);
+	}
+	
+	return transaction;
+}
+
+- (YapDatabaseReadWriteTransaction *)transactionForShard:(NSString *)shard
+{
+	return [transactions objectForKey:shard];
+}
+
+- (void)rollback
+{
+	for (YapDatabaseReadWriteTransaction *transaction in [transactions objectEnumerator])
+	{
+		[transaction rollback];
+	}
+}
+
+@end
@@ -1,5 +1,7 @@
 #import <Foundation/Foundation.h>
 
+@class YapCollectionKey;
+
 NS_ASSUME_NONNULL_BEGIN
 
 typedef BOOL (^YapWhitelistBlacklistFilterBlock)(id item);
@@ -53,6 +55,15 @@ typedef BOOL (^YapWhitelistBlacklistFilterBlock)(id item);
 **/
 - (BOOL)isAllowed:(id)item;
 
+/**
+ * Equivalent to [self isAllowed:collectionKey.collection], but much faster when invoked repeatedly.
+ * 
+ * The result for each collection is computed once, and then remembered in a bitset over collection indexes
+ * (see YapCollectionKey.collectionIndex). So subsequent calls are a single bit test.
+ * Extensions use this within their per-row hooks.
+**/
+- (BOOL)isAllowedCollectionKey:(YapCollectionKey *)collectionKey;
+
 @end
 
 NS_ASSUME_NONNULL_END
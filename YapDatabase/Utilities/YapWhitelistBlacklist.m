@@ -1,4 +1,9 @@
 #import "YapWhitelistBlacklist.h"
+#import "YapCollectionKey.h"
+
+#import <stdatomic.h>
+
+#define YAP_WHITELIST_BLACKLIST_WORDS (YAP_COLLECTION_INTERN_LIMIT / 64)
 
 
 @implementation YapWhitelistBlacklist
@@ -7,6 +12,12 @@
 	NSSet *blacklist;
 	
 	YapWhitelistBlacklistFilterBlock filterBlock;
+	
+	// The results of isAllowedCollectionKey:, as a bitset over collection indexes (see YapCollectionKey).
+	// A bit in allowedBits is only meaningful once the same bit in knownBits is set.
+	// The result for a collection never changes (this includes the filterBlock, which must be immutable).
+	_Atomic(uint64_t) knownBits[YAP_WHITELIST_BLACKLIST_WORDS];
+	_Atomic(uint64_t) allowedBits[YAP_WHITELIST_BLACKLIST_WORDS];
 }
 
 // See header file for documentation
@@ -58,4 +69,31 @@
 	}
 }
 
+// See header file for documentation
+- (BOOL)isAllowedCollectionKey:(YapCollectionKey *)collectionKey
+{
+	NSUInteger index = collectionKey.collectionIndex;
+	if (index == NSNotFound)
+	{
+		return [self isAllowed:collectionKey.collection];
+	}
+	
+	NSUInteger word = index / 64;
+	uint64_t bit = (uint64_t)1 << (index % 64);
+	
+	if (atomic_load_explicit(&knownBits[word], memory_order_acquire) & bit)
+	{
+		return (atomic_load_explicit(&allowedBits[word], memory_order_relaxed) & bit) != 0;
+	}
+	
+	BOOL allowed = [self isAllowed:collectionKey.collection];
+	
+	if (allowed) {
+		atomic_fetch_or_explicit(&allowedBits[word], bit, memory_order_relaxed);
+	}
+	atomic_fetch_or_explicit(&knownBits[word], bit, memory_order_release);
+	
+	return allowed;
+}
+
 @end
@@ -5,6 +5,13 @@
 #import "YapDatabaseTransaction.h"
 #import "YapDatabaseExtension.h"
 #import "YapDatabaseConnectionConfig.h"
+#import "YapDatabaseIOStatistics.h"
+#import "YapDatabaseSlowQuery.h"
+#import "YapDatabaseWALPinning.h"
+#import "YapDatabaseIncrementalBackup.h"
+#import "YapDatabaseCacheSimulation.h"
+#import "YapDatabaseStorageReport.h"
+#import "YapDatabaseCollectionArchive.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -68,6 +75,19 @@ NS_ASSUME_NONNULL_BEGIN
 typedef NSData * __nonnull (^YapDatabaseSerializer)(NSString *collection, NSString *key, id object);
 typedef id __nonnull (^YapDatabaseDeserializer)(NSString *collection, NSString *key, NSData *data);
 
+/**
+ * An alternative deserializer entry point that reads directly from the sqlite column buffer.
+ *
+ * The bytes are ONLY valid for the duration of the call.
+ * So you must not retain them (or wrap them in an NSData with dataWithBytesNoCopy) beyond the call.
+ *
+ * To use it, wrap it with [YapDatabase deserializerWithBytesDeserializer:],
+ * and pass the result to YapDatabase's init method as you would any other deserializer.
+ * Whenever possible, the transaction will then invoke the bytes entry point directly.
+**/
+typedef id __nonnull (^YapDatabaseBytesDeserializer)(NSString *collection, NSString *key,
+                                                     const void *bytes, size_t length);
+
 /**
  * The sanitizer block allows you to enforce desired behavior of the objects you put into the database.
  *
@@ -177,6 +197,29 @@ extern NSString *const YapDatabaseModifiedNotification;
  **/
 extern NSString *const YapDatabaseModifiedExternallyNotification;
 
+/**
+ * If the modifiedNotificationCoalescingInterval is set, this notification is posted (on the main thread)
+ * at most once per interval, and carries every YapDatabaseModifiedNotification posted during the interval.
+ *
+ * This allows your UI to update once per interval, rather than once per commit.
+ * E.g. invoke beginLongLivedReadTransaction (and update your views) in response to this notification,
+ * instead of in response to each YapDatabaseModifiedNotification.
+ *
+ * The notification object will be the database instance itself.
+ *
+ * The userInfo dictionary will look like this:
+ * @{
+ *     YapDatabaseModifiedNotificationsKey : <NSArray of YapDatabaseModifiedNotification's, in commit order>
+ * }
+ *
+ * The YapDatabaseModifiedNotification's are still posted individually, as usual.
+ *
+ * This notification is always posted to the main thread.
+**/
+extern NSString *const YapDatabaseModifiedCoalescedNotification;
+
+extern NSString *const YapDatabaseModifiedNotificationsKey;
+
 extern NSString *const YapDatabaseSnapshotKey;
 extern NSString *const YapDatabaseConnectionKey;
 extern NSString *const YapDatabaseExtensionsKey;
@@ -187,6 +230,7 @@ extern NSString *const YapDatabaseMetadataChangesKey;
 extern NSString *const YapDatabaseInsertedKeysKey;
 extern NSString *const YapDatabaseRemovedKeysKey;
 extern NSString *const YapDatabaseRemovedCollectionsKey;
+extern NSString *const YapDatabaseResetCollectionsKey;
 extern NSString *const YapDatabaseAllKeysRemovedKey;
 extern NSString *const YapDatabaseModifiedExternallyKey;
 
@@ -199,6 +243,9 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
  *
  * Many of Apple's primary data types support NSCoding out of the box.
  * It's easy to add NSCoding support to your own custom objects.
+ *
+ * For a (much) faster alternative, see YapDatabaseBinaryCodec.
+ * Its deserializer also decodes rows that were written by the defaultSerializer.
 **/
 + (YapDatabaseSerializer)defaultSerializer;
 + (YapDatabaseDeserializer)defaultDeserializer;
@@ -220,6 +267,17 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
 + (YapDatabaseSerializer)timestampSerializer;
 + (YapDatabaseDeserializer)timestampDeserializer;
 
+/**
+ * Returns a regular deserializer (which can be passed to any of the init methods),
+ * that is backed by the given bytes deserializer.
+ *
+ * When YapDatabase detects such a deserializer, it skips creating an NSData for each row,
+ * and instead passes the sqlite column buffer straight to the bytes deserializer.
+ *
+ * @see YapDatabaseBytesDeserializer
+**/
++ (YapDatabaseDeserializer)deserializerWithBytesDeserializer:(YapDatabaseBytesDeserializer)bytesDeserializer;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Init
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -332,6 +390,18 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
 @property (nonatomic, strong, readonly) NSString *databasePath_wal;
 @property (nonatomic, strong, readonly) NSString *databasePath_shm;
 
+/**
+ * The directory containing the externally stored objects (see YapDatabaseOptions.externalStorageThresholds).
+ * The directory only exists if external storage has been used with the database.
+**/
+@property (nonatomic, strong, readonly) NSString *databasePath_blobs;
+
+/**
+ * The database file containing the objects that were moved into cold storage (see YapDatabaseOptions.coldCollections).
+ * The file only exists if cold storage has been used with the database.
+**/
+@property (nonatomic, strong, readonly) NSString *databasePath_cold;
+
 @property (nonatomic, copy, readonly) YapDatabaseSerializer objectSerializer;
 @property (nonatomic, copy, readonly) YapDatabaseDeserializer objectDeserializer;
 
@@ -414,6 +484,29 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
 **/
 @property (atomic, readonly) NSString *sqliteVersion;
 
+/**
+ * If a checkpoint policy is configured (YapDatabaseOptions.checkpointPolicy),
+ * returns a snapshot of the decisions it has made so far (how often each checkpoint mode was chosen, etc).
+ * 
+ * Returns nil if no checkpoint policy is configured.
+**/
+@property (atomic, readonly, nullable) YapDatabaseCheckpointStatistics *checkpointStatistics;
+
+/**
+ * If I/O statistics are enabled (YapDatabaseOptions.enableIOStatistics),
+ * returns a snapshot of every read, write, sync & truncate performed so far (counts, bytes & latency histograms),
+ * broken down by file (database file, WAL, journal).
+ * 
+ * Returns nil if I/O statistics aren't enabled.
+**/
+@property (atomic, readonly, nullable) YapDatabaseIOStatistics *ioStatistics;
+
+/**
+ * Resets the I/O statistics to zero.
+ * For example, you might reset the statistics before an operation, and then inspect them afterwards.
+**/
+- (void)resetIOStatistics;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Defaults
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -530,6 +623,65 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
 - (YapDatabaseConnection *)newConnection;
 - (YapDatabaseConnection *)newConnection:(nullable YapDatabaseConnectionConfig *)config;
 
+/**
+ * Returns the estimated number of bytes held by each subsystem, summed across every open connection.
+ * This includes the memory tables (e.g. non-persistent views) & the shared object cache.
+ *
+ * This method waits for each connection's queue,
+ * so it must NOT be invoked from within a transaction (as that would deadlock).
+ *
+ * @see -[YapDatabaseConnection memoryReport]
+**/
+- (YapDatabaseMemoryReport *)memoryReport;
+
+/**
+ * Returns a sample of the live statistics of the database:
+ * the current snapshot, the WAL size, the changeset backlog,
+ * plus the statistics of every open connection (and their caches summed across connections).
+ *
+ * This method waits for each connection's queue,
+ * so it must NOT be invoked from within a transaction (as that would deadlock).
+ *
+ * @see -[YapDatabaseConnection statistics]
+**/
+- (YapDatabaseStatistics *)statistics;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Parallel Enumeration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Enumerates every row in the given collection, using multiple read connections concurrently.
+ *
+ * This is designed for jobs that need to scan an entire (large) collection, but can process the rows in any order.
+ * For example: analytics, exports, or re-indexing.
+ *
+ * A dedicated read connection is created for each worker (with its caches disabled),
+ * and all of them are pinned to the same snapshot (via a long-lived read transaction).
+ * So every row is seen exactly once, and no commit that occurs during the enumeration is visible to it.
+ * The rowid range of the collection is then split into ranges, which the workers scan concurrently.
+ *
+ * This method is synchronous, and returns once every worker has finished.
+ * The block is invoked concurrently (from multiple threads), and in no particular order.
+ * Setting stop to YES stops every worker (although the other workers may each process one more row).
+ *
+ * This method waits for the writeQueue (in order to pin the snapshot),
+ * so it must NOT be invoked from within a transaction (as that would deadlock).
+ *
+ * @param collection
+ *   The collection to enumerate. A nil collection is treated as the empty string.
+ *
+ * @param workerCount
+ *   The number of concurrent workers (read connections).
+ *   If zero, the number of active processors is used.
+ *
+ * @param block
+ *   Invoked for each row in the collection. Must be thread-safe.
+**/
+- (void)parallelEnumerateCollection:(nullable NSString *)collection
+                            workers:(NSUInteger)workerCount
+                              block:(void (^)(NSString *key, id object, id _Nullable metadata, BOOL *stop))block;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Extensions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -713,6 +865,90 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
                completionQueue:(nullable dispatch_queue_t)completionQueue
                completionBlock:(nullable void(^)(BOOL ready))completionBlock;
 
+/**
+ * Registers multiple extensions with the database, within a single (synchronous) readwrite transaction.
+ *
+ * This is faster than registering each extension separately.
+ * Extensions that need to be populated (e.g. views, secondary indexes, full text search, relationships)
+ * share a single enumeration of the existing rows in the database,
+ * so each row is fetched (and each object deserialized) only once, no matter how many extensions need it.
+ *
+ * The extensions are registered in dependency order (regardless of the order of the dictionary).
+ * So, for example, a filteredView may be registered in the same batch as its parentView.
+ *
+ * The registration is all-or-nothing.
+ * If any extension fails to register, then none of the extensions are registered.
+ *
+ * @param extensions (required)
+ *     A dictionary, where the key is the registered name for the extension,
+ *     and the value is the YapDatabaseExtension subclass instance you wish to register.
+ *
+ * @param config (optional)
+ *     You may optionally pass a config for the internal databaseConnection used to perform
+ *     the extension registration process.
+ *
+ * @return
+ *     YES if every extension was properly registered. NO otherwise.
+ *
+ * @see asyncRegisterExtensions:config:completionQueue:completionBlock:
+**/
+- (BOOL)registerExtensions:(NSDictionary<NSString *, YapDatabaseExtension *> *)extensions
+                    config:(nullable YapDatabaseConnectionConfig *)config;
+
+/**
+ * Asynchronously registers multiple extensions with the database, within a single readwrite transaction.
+ *
+ * @param extensions (required)
+ *     A dictionary, where the key is the registered name for the extension,
+ *     and the value is the YapDatabaseExtension subclass instance you wish to register.
+ *
+ * @param config (optional)
+ *     You may optionally pass a config for the internal databaseConnection used to perform
+ *     the extension registration process.
+ *
+ * @param completionQueue (optional)
+ *     The dispatch_queue to invoke the completion block may optionally be specified.
+ *     If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @param completionBlock (optional)
+ *     An optional completion block may be used.
+ *     If every extension was registered successfully then the ready parameter will be YES.
+ *
+ * @see registerExtensions:config:
+**/
+- (void)asyncRegisterExtensions:(NSDictionary<NSString *, YapDatabaseExtension *> *)extensions
+                         config:(nullable YapDatabaseConnectionConfig *)config
+                completionQueue:(nullable dispatch_queue_t)completionQueue
+                completionBlock:(nullable void(^)(BOOL ready))completionBlock;
+
+/**
+ * Registers an extension without blocking (or waiting for) the registration process.
+ *
+ * This is designed to speed up app launch, when many extensions are registered.
+ * Deferred extensions are queued, and registered together in a single readwrite transaction,
+ * which uses a single query to check the persisted state (class, version, etc) of every extension.
+ * Extensions that are already up-to-date don't need to be re-populated, which makes the process fairly cheap.
+ * And their connections are only setup when first accessed (via [transaction ext:]).
+ *
+ * Similar to asyncRegisterExtension, the extension is not available until it's registered.
+ * All readWrite transactions that are started after invoking this method wait for the registration process.
+ * But read-only transactions may execute before the registration process completes,
+ * in which case [transaction ext:] returns nil for the deferred extension.
+ *
+ * If any of the deferred extensions fails to register, the others are still registered (individually).
+ *
+ * @param extension (required)
+ *     The YapDatabaseExtension subclass instance you wish to register.
+ *
+ * @param extensionName (required)
+ *     This is an arbitrary string you assign to the extension.
+ *
+ * @return
+ *     NO if the parameters are invalid, or if an extension with the same name is already pending.
+ *     YES otherwise (which doesn't guarantee the registration will succeed).
+**/
+- (BOOL)registerDeferredExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName;
+
 /**
  * This method unregisters an extension with the given name.
  * The associated underlying tables will be dropped from the database.
@@ -883,6 +1119,108 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
 **/
 @property (atomic, assign, readwrite) NSTimeInterval connectionPoolLifetime;
 
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Slow Query Log
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Extensions such as YapDatabaseSecondaryIndex, YapDatabaseFullTextSearch & YapDatabaseRTreeIndex
+ * generate their SQL dynamically (e.g. from a YapDatabaseQuery).
+ * So a query that accidentally falls back to a full table scan is easy to miss.
+ *
+ * If a threshold is set, any extension query that spends longer than the threshold within sqlite
+ * is reported to the slowQueryHandler, along with its SQL, parameter shapes, query plan & row count.
+ * (Time spent within your enumeration blocks isn't counted.)
+ *
+ * The default value is zero, which disables the slow query log.
+**/
+@property (atomic, assign, readwrite) NSTimeInterval slowQueryThreshold;
+
+/**
+ * The fraction of queries (from 0.0 to 1.0) that are timed when the slowQueryThreshold is enabled.
+ *
+ * Timing a query is cheap (a pair of clock reads per row), and the query plan is only generated for slow queries.
+ * But if you'd like to leave the slow query log enabled in release builds for hot code paths,
+ * you may wish to sample only a fraction of queries.
+ *
+ * The default value is 1.0 (every query is timed).
+**/
+@property (atomic, assign, readwrite) double slowQuerySampleRate;
+
+/**
+ * Sets the sink for slow query reports.
+ *
+ * The handler is invoked asynchronously on the given queue (the main queue if nil).
+ * If no handler is set, slow queries are logged (as warnings) via YapDatabaseLogging.
+ *
+ * @see slowQueryThreshold
+**/
+- (void)setSlowQueryHandler:(nullable YapDatabaseSlowQueryHandler)handler queue:(nullable dispatch_queue_t)queue;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Notification Coalescing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Under heavy background writes, a YapDatabaseModifiedNotification may be posted dozens of times per second.
+ *
+ * If an interval is set, the YapDatabaseModifiedNotification's are additionally collected on the main thread,
+ * and delivered via a single YapDatabaseModifiedCoalescedNotification once the interval has elapsed
+ * (measured from the first notification of the batch).
+ * For example, an interval of 1/60 coalesces the notifications of each frame.
+ *
+ * The default value is zero, which disables the YapDatabaseModifiedCoalescedNotification.
+ *
+ * @see YapDatabaseModifiedCoalescedNotification
+**/
+@property (atomic, assign, readwrite) NSTimeInterval modifiedNotificationCoalescingInterval;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark WAL Pinning
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns a report on the read transaction holding the oldest snapshot,
+ * if that snapshot is older than the latest commit (i.e. the reader is preventing the WAL from being reset).
+ * 
+ * Returns nil if there's no such reader.
+ * 
+ * @see YapDatabaseWALPinningReport
+**/
+- (nullable YapDatabaseWALPinningReport *)walPinningReport;
+
+/**
+ * When a block is set, the database checks for pinned snapshots after each commit.
+ * If the oldest reader has held its snapshot for at least the durationThreshold,
+ * and the WAL has grown to at least the frameThreshold, the block is invoked (asynchronously) with a report.
+ * 
+ * The block is invoked once per pinned snapshot.
+ * That is, the same reader is reported again only after it has moved to a newer (but still pinned) snapshot.
+ * 
+ * A typical culprit is a UI connection with a long-lived read transaction,
+ * which isn't updated in response to YapDatabaseModifiedNotification.
+ * See also -[YapDatabaseConnection longLivedReadTransactionIdleTimeout].
+ * 
+ * @param durationThreshold
+ *   The minimum duration (in seconds) for which the reader has held its snapshot.
+ * 
+ * @param frameThreshold
+ *   The minimum number of frames (i.e. pages) within the WAL.
+ * 
+ * @param block
+ *   The block to invoke with each report.
+ *   Pass nil to disable the check.
+ * 
+ * @param queue
+ *   The dispatch_queue to invoke the block on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)setWALPinningDurationThreshold:(NSTimeInterval)durationThreshold
+                        frameThreshold:(NSUInteger)frameThreshold
+                                 block:(nullable YapDatabaseWALPinningBlock)block
+                                 queue:(nullable dispatch_queue_t)queue;
+
 @end
 
 NS_ASSUME_NONNULL_END
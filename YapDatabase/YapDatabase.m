@@ -6,13 +6,48 @@
 #import "YapDatabaseManager.h"
 #import "YapDatabaseConnectionState.h"
 #import "YapDatabaseLogging.h"
+#import "YapDatabaseMemoryReportPrivate.h"
 #import "YapDatabaseString.h"
+#import "YapDatabaseCheckpointPolicyPrivate.h"
+#import "YapDatabaseIOStatisticsPrivate.h"
+#import "YapDatabaseSignposts.h"
+#import "YapDatabaseStatisticsPrivate.h"
+#import "YapDatabaseWALPinningPrivate.h"
+#import "YapDatabaseCryptoUtils.h"
+#import "YapTouch.h"
+#import "YapSet.h"
 
 #import "sqlite3.h"
 
 #import <mach/mach_time.h>
+#import <objc/runtime.h>
 #import <stdatomic.h>
 
+#if __has_include(<sys/clonefile.h>)
+#import <sys/clonefile.h>
+#define YAP_CLONEFILE_AVAILABLE 1
+#else
+#define YAP_CLONEFILE_AVAILABLE 0
+#endif
+
+#if YAP_CLONEFILE_AVAILABLE
+
+/**
+ * Wrapper around clonefile(), which isn't available on older OS versions (fails with ENOTSUP).
+**/
+static int YapDatabaseCloneFile(NSString *srcPath, NSString *dstPath)
+{
+	if (@available(macOS 10.12, iOS 10.0, tvOS 10.0, watchOS 3.0, *))
+	{
+		return clonefile([srcPath fileSystemRepresentation], [dstPath fileSystemRepresentation], CLONE_NOFOLLOW);
+	}
+	
+	errno = ENOTSUP;
+	return -1;
+}
+
+#endif
+
 #if ! __has_feature(objc_arc)
 #warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
 #endif
@@ -46,6 +81,9 @@ NSString *const YapDatabasePathShmKey = @"databasePath_shm";
 
 NSString *const YapDatabaseModifiedNotification = @"YapDatabaseModifiedNotification";
 NSString *const YapDatabaseModifiedExternallyNotification = @"YapDatabaseModifiedExternallyNotification";
+NSString *const YapDatabaseModifiedCoalescedNotification = @"YapDatabaseModifiedCoalescedNotification";
+
+NSString *const YapDatabaseModifiedNotificationsKey = @"notifications";
 
 NSString *const YapDatabaseSnapshotKey   = @"snapshot";
 NSString *const YapDatabaseConnectionKey = @"connection";
@@ -57,7 +95,10 @@ NSString *const YapDatabaseMetadataChangesKey    = @"metadataChanges";
 NSString *const YapDatabaseInsertedKeysKey       = @"insertedKeys";
 NSString *const YapDatabaseRemovedKeysKey        = @"removedKeys";
 NSString *const YapDatabaseRemovedCollectionsKey = @"removedCollections";
+NSString *const YapDatabaseResetCollectionsKey   = @"resetCollections";
 NSString *const YapDatabaseRemovedRowidsKey      = @"removedRowids";
+NSString *const YapDatabaseExtensionValuesChangedKey = @"extensionValuesChanged";
+NSString *const YapDatabaseOtherProcessKey       = @"otherProcess";
 NSString *const YapDatabaseAllKeysRemovedKey     = @"allKeysRemoved";
 NSString *const YapDatabaseModifiedExternallyKey = @"modifiedExternally";
 
@@ -75,6 +116,11 @@ static NSString *const YDBConnectionPoolValueKey_db        = @"db";
 static NSString *const YDBConnectionPoolValueKey_main_file = @"main_file";
 static NSString *const YDBConnectionPoolValueKey_wal_file  = @"wal_file";
 
+/**
+ * Associated object key, used to attach a YapDatabaseBytesDeserializer to a YapDatabaseDeserializer.
+**/
+static char YapDatabaseBytesDeserializerKey;
+
 /**
  * The database version is stored (via pragma user_version) to sqlite.
  * It is used to represent the version of the userlying architecture of YapDatabase.
@@ -84,6 +130,23 @@ static NSString *const YDBConnectionPoolValueKey_wal_file  = @"wal_file";
 **/
 #define YAP_DATABASE_CURRENT_VERION 3
 
+/**
+ * Version 4 is opt-in (via YapDatabaseOptions.enableCollectionIds).
+ * It interns collection names into the "collections" table, and stores rows in "database3",
+ * keyed on (collection_id, key). The "database2" table is replaced by a view with the old columns.
+**/
+#define YAP_DATABASE_COLLECTION_IDS_VERSION 4
+
+/**
+ * The "database2" view used by the collection-id schema.
+ * It exposes the same columns as the original "database2" table, so read statements work unmodified.
+**/
+#define YAP_DATABASE_COLLECTION_IDS_VIEW \
+  "CREATE VIEW \"database2\" AS" \
+  " SELECT \"d\".\"rowid\" AS \"rowid\", \"c\".\"collection\" AS \"collection\", \"d\".\"key\" AS \"key\"," \
+  "        \"d\".\"data\" AS \"data\", \"d\".\"metadata\" AS \"metadata\"" \
+  " FROM \"database3\" AS \"d\" JOIN \"collections\" AS \"c\" ON \"c\".\"collection_id\" = \"d\".\"collection_id\";"
+
 /**
  * Default values
 **/
@@ -110,8 +173,9 @@ static int connectionBusyHandler(void *ptr, int count) {
 	
 	sqlite3 *db; // Used for setup & checkpoints
 	
-	NSMutableArray *changesets;
-	uint64_t snapshot;
+	NSArray *changesets;             // Modified within snapshotQueue, published under changesetsLock
+	YAPUnfairLock changesetsLock;
+	atomic_uint_fast64_t snapshot;   // Modified within snapshotQueue, readable from any queue
 	
 	dispatch_queue_t internalQueue;
 	dispatch_queue_t checkpointQueue;
@@ -132,12 +196,74 @@ static int connectionBusyHandler(void *ptr, int count) {
 	NSMutableArray *connectionPoolValues;
 	NSMutableArray *connectionPoolDates;
 	
+	NSTimeInterval slowQueryThreshold;              // Must be on internalQueue
+	double slowQuerySampleRate;                     // Must be on internalQueue
+	YapDatabaseSlowQueryHandler slowQueryHandler;   // Must be on internalQueue
+	dispatch_queue_t slowQueryHandlerQueue;         // Must be on internalQueue
+	
+	atomic_uint_fast64_t coalescingIntervalNanos;   // Set within internalQueue
+	NSMutableArray *coalescedNotifications;         // Must be on main thread
+	
+	NSTimeInterval walPinningDurationThreshold;             // Must be on snapshotQueue
+	NSUInteger walPinningFrameThreshold;                    // Must be on snapshotQueue
+	YapDatabaseWALPinningBlock walPinningBlock;             // Must be on snapshotQueue
+	dispatch_queue_t walPinningQueue;                       // Must be on snapshotQueue
+	YapDatabaseConnectionState *walPinningReportedState;    // Must be on snapshotQueue
+	uint64_t walPinningReportedSnapshot;                    // Must be on snapshotQueue
+	
 	NSString *sqliteVersion;
 	uint64_t pageSize;
 	
+	NSDictionary *openFingerprint; // Non-nil (during setup) if the fast open path was taken
+	
 	atomic_flag pendingPassiveCheckpoint;
 	atomic_flag pendingAggressiveCheckpoint;
 	atomic_bool aggressiveCheckpointEnabled;
+	
+	atomic_flag pendingIncrementalVacuum;
+	
+	atomic_uint_fast64_t analyzeChangeCount; // rows changed since the last optimize step
+	atomic_flag pendingOptimize;
+	
+	id<YapDatabaseCheckpointPolicy> checkpointPolicy;
+	atomic_flag pendingPolicyCheckpoint;
+	
+	YAPUnfairLock checkpointPolicyLock;
+	YapDatabaseCheckpointStatistics *checkpointStatistics; // Must hold checkpointPolicyLock
+	NSUInteger walFrameCount;                              // Must hold checkpointPolicyLock
+	NSUInteger walCheckpointedFrameCount;                  // Must hold checkpointPolicyLock
+	double writeRate;                                      // Must hold checkpointPolicyLock
+	NSTimeInterval lastCommitTime;                         // Must hold checkpointPolicyLock
+	NSTimeInterval lastPolicyCheckpointTime;               // Must hold checkpointPolicyLock
+	uint64_t latestCommittedSnapshot;                      // Must hold checkpointPolicyLock
+	uint64_t latestCheckpointableSnapshot;                 // Must hold checkpointPolicyLock
+	uint64_t policyEvaluationGeneration;                   // Must hold checkpointPolicyLock
+	
+	YAPUnfairLock compressionLock;
+	NSMutableDictionary<NSNumber *, NSData *> *compressionDictionaries;         // Must hold compressionLock
+	NSMutableDictionary<NSString *, NSNumber *> *activeCompressionDictionaryIds; // Must hold compressionLock
+	
+	dispatch_queue_t externalStorageQueue;
+	YAPUnfairLock externalStorageLock;
+	NSMutableDictionary<NSString *, NSNumber *> *pendingExternalBlobDeletions; // Must hold externalStorageLock
+	
+	dispatch_queue_t coldStorageQueue;
+	sqlite3 *coldDb;                                                      // Must be on coldStorageQueue
+	NSTimeInterval coldDbLastAccessTime;                                  // Must be on coldStorageQueue
+	BOOL coldDbCloseScheduled;                                            // Must be on coldStorageQueue
+	NSMutableDictionary<NSNumber *, NSNumber *> *pendingColdBlobDeletions; // Must be on coldStorageQueue
+	
+	YAPUnfairLock deferredExtensionsLock;
+	NSMutableDictionary<NSString *, YapDatabaseExtension *> *deferredExtensions; // Must hold deferredExtensionsLock
+	
+	NSMutableArray<NSValue *> *pinnedSQLiteSnapshots; // Must be on checkpointQueue
+	sqlite3 *snapshotPinDbs[2];                       // Must be on checkpointQueue
+	sqlite3_snapshot *snapshotPin;                    // Must be on checkpointQueue
+	int snapshotPinIndex;                             // Must be on checkpointQueue
+	
+#ifdef SQLITE_HAS_CODEC
+	NSMutableData *cipherKeySpec; // Derived from the cipherKeyBlock (during init). Read-only afterwards.
+#endif
 }
 
 /**
@@ -220,20 +346,54 @@ static int connectionBusyHandler(void *ptr, int count) {
 **/
 + (YapDatabaseDeserializer)timestampDeserializer
 {
-	return ^ id (NSString __unused *collection, NSString __unused *key, NSData *data) {
+	return [self deserializerWithBytesDeserializer:
+	    ^ id (NSString __unused *collection, NSString __unused *key, const void *bytes, size_t length) {
 		
-		if ([data length] == sizeof(NSTimeInterval))
+		if (length == sizeof(NSTimeInterval))
 		{
 			NSTimeInterval timestamp;
-			memcpy((void *)&timestamp, [data bytes], sizeof(NSTimeInterval));
+			memcpy((void *)&timestamp, bytes, sizeof(NSTimeInterval));
 			
 			return [[NSDate alloc] initWithTimeIntervalSinceReferenceDate:timestamp];
 		}
 		else
 		{
+			NSData *data = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
 			return [NSKeyedUnarchiver unarchiveObjectWithData:data];
 		}
+	}];
+}
+
+/**
+ * Returns a regular deserializer backed by the given bytes deserializer.
+ * The bytes deserializer is attached to the returned block (as an associated object),
+ * which allows us to extract it again when the database is initialized.
+**/
++ (YapDatabaseDeserializer)deserializerWithBytesDeserializer:(YapDatabaseBytesDeserializer)inBytesDeserializer
+{
+	NSParameterAssert(inBytesDeserializer != nil);
+	
+	YapDatabaseBytesDeserializer bytesDeserializer = [inBytesDeserializer copy];
+	
+	YapDatabaseDeserializer deserializer = ^ id (NSString *collection, NSString *key, NSData *data) {
+		
+		return bytesDeserializer(collection, key, [data bytes], [data length]);
 	};
+	deserializer = [deserializer copy]; // must be on the heap before attaching the associated object
+	
+	objc_setAssociatedObject(deserializer, &YapDatabaseBytesDeserializerKey, bytesDeserializer,
+	                         OBJC_ASSOCIATION_COPY_NONATOMIC);
+	return deserializer;
+}
+
+/**
+ * Returns the bytes deserializer backing the given deserializer, if created via deserializerWithBytesDeserializer:.
+**/
++ (YapDatabaseBytesDeserializer)bytesDeserializerForDeserializer:(YapDatabaseDeserializer)deserializer
+{
+	if (deserializer == nil) return nil;
+	
+	return (YapDatabaseBytesDeserializer)objc_getAssociatedObject(deserializer, &YapDatabaseBytesDeserializerKey);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -243,6 +403,8 @@ static int connectionBusyHandler(void *ptr, int count) {
 @synthesize databasePath = databasePath;
 @dynamic databasePath_wal;
 @dynamic databasePath_shm;
+@dynamic databasePath_blobs;
+@dynamic databasePath_cold;
 
 @synthesize objectSerializer = objectSerializer;
 @synthesize objectDeserializer = objectDeserializer;
@@ -269,6 +431,26 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return [databasePath stringByAppendingString:@"-shm"];
 }
 
+- (NSString *)databasePath_blobs
+{
+	return [databasePath stringByAppendingString:@"-blobs"];
+}
+
+- (NSString *)databasePath_cold
+{
+	return [databasePath stringByAppendingString:@"-cold"];
+}
+
+- (NSString *)databasePath_yapshm
+{
+	return [databasePath stringByAppendingString:@"-yapshm"];
+}
+
+- (NSString *)databasePath_yapchg
+{
+	return [databasePath stringByAppendingString:@"-yapchg"];
+}
+
 - (YapDatabaseOptions *)options
 {
 	return [options copy];
@@ -290,6 +472,35 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return result;
 }
 
+- (YapDatabaseCheckpointStatistics *)checkpointStatistics
+{
+	if (checkpointPolicy == nil) return nil;
+	
+	YapDatabaseCheckpointStatistics *result = nil;
+	
+	YAPUnfairLockLock(&checkpointPolicyLock);
+	{
+		result = [checkpointStatistics copy];
+	}
+	YAPUnfairLockUnlock(&checkpointPolicyLock);
+	
+	return result;
+}
+
+- (YapDatabaseIOStatistics *)ioStatistics
+{
+	yap_io_file_stats stats[yap_file_kind_count];
+	
+	if (!yap_vfs_get_io_stats(yap_vfs_shim, stats)) return nil;
+	
+	return [[YapDatabaseIOStatistics alloc] initWithFileStats:stats];
+}
+
+- (void)resetIOStatistics
+{
+	yap_vfs_reset_io_stats(yap_vfs_shim);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Init
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -438,7 +649,78 @@ static int connectionBusyHandler(void *ptr, int count) {
 		databasePath = path;
 		options = inOptions ? [inOptions copy] : [[YapDatabaseOptions alloc] init];
 		
-		__block BOOL isNewDatabaseFile = ![[NSFileManager defaultManager] fileExistsAtPath:databasePath];
+		if (options.inMemory)
+		{
+			// Only this process can access the memory, and nothing is ever stored on disk.
+			
+			options.enableMultiProcessSupport = NO;
+			options.readOnlyImmutable = NO;
+			options.externalStorageThresholds = nil;
+			options.coldCollections = nil;
+		}
+		
+#ifdef SQLITE_HAS_CODEC
+		if ((options.cipherKeyBlock || options.cipherKeySpecBlock) && (options.externalStorageThresholds.count > 0))
+		{
+			// External files aren't encrypted.
+			// So with an encrypted database, every object is stored within the (encrypted) database file.
+			
+			YDBLogWarn(@"Ignoring externalStorageThresholds, as the database is encrypted.");
+			options.externalStorageThresholds = nil;
+		}
+		
+		if ((options.cipherKeyBlock || options.cipherKeySpecBlock) && options.enableIncrementalBackup)
+		{
+			// Incremental backups read the pages via sqlite_dbpage (i.e. through the pager),
+			// so the pages would be written to the backup file decrypted.
+			
+			YDBLogWarn(@"Ignoring enableIncrementalBackup, as the database is encrypted.");
+			options.enableIncrementalBackup = NO;
+		}
+#endif
+		
+		__block BOOL isNewDatabaseFile =
+		  options.inMemory || ![[NSFileManager defaultManager] fileExistsAtPath:databasePath];
+		
+		// Configure in-memory VFS (if needed).
+		//
+		// The database (and its WAL) are stored within it, instead of the default VFS.
+		// Everything else is unchanged, including the VFS shim, which simply wraps it.
+		
+		if (options.inMemory)
+		{
+			memory_vfs_name = [NSString stringWithFormat:@"yap_vfs_memory_%@", [[NSUUID UUID] UUIDString]];
+			
+			int status = yap_vfs_memory_register([memory_vfs_name UTF8String], &memory_vfs);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error registering in-memory VFS: %d", status);
+				return nil;
+			}
+		}
+		
+		// Configure VFS shim (for database connections).
+		//
+		// This is done before opening the database,
+		// because if I/O statistics are enabled, our own (internal) connection uses the shim too.
+		// That way the checkpoints performed on our connection are included in the statistics.
+		
+		yap_vfs_shim_name = [NSString stringWithFormat:@"yap_vfs_shim_%@", [[NSUUID UUID] UUIDString]];
+		yap_vfs_shim_register([yap_vfs_shim_name UTF8String], [memory_vfs_name UTF8String], &yap_vfs_shim);
+		
+		if (options.enableIOStatistics && yap_vfs_shim)
+		{
+			if (yap_vfs_enable_io_stats(yap_vfs_shim) != SQLITE_OK) {
+				YDBLogWarn(@"Unable to enable I/O statistics");
+			}
+		}
+		
+		if (options.enableIncrementalBackup && yap_vfs_shim)
+		{
+			if (yap_vfs_enable_page_tracking(yap_vfs_shim) != SQLITE_OK) {
+				YDBLogWarn(@"Unable to enable page tracking (for incremental backups)");
+			}
+		}
 		
 		BOOL(^openConfigCreate)(void) = ^BOOL (void) { @autoreleasepool {
 		#pragma clang diagnostic push
@@ -451,7 +733,10 @@ static int connectionBusyHandler(void *ptr, int count) {
             if (result) result = [self configureEncryptionForDatabase:db];
 #endif
 			if (result) result = [self configureDatabase:isNewDatabaseFile];
-			if (result) result = [self createTables];
+			if (result && !(options.enableFastOpen && !isNewDatabaseFile && [self readOpenFingerprint]))
+			{
+				result = options.readOnlyImmutable ? [self checkTables] : [self createTables];
+			}
 			
 			if (!result && db)
 			{
@@ -470,9 +755,13 @@ static int connectionBusyHandler(void *ptr, int count) {
 			// There are a few reasons why the database might not open.
 			// One possibility is if the database file has become corrupt.
 			
-			if (options.corruptAction == YapDatabaseCorruptAction_Fail)
+			if (options.corruptAction == YapDatabaseCorruptAction_Fail || options.readOnlyImmutable || options.inMemory)
 			{
 				// Fail - do not try to resolve
+				//
+				// A readOnlyImmutable database is never modified (and is likely bundled with the app),
+				// so we never rename or delete it.
+				// And an in-memory database doesn't have a file to rename or delete.
 			}
 			else if (options.corruptAction == YapDatabaseCorruptAction_Rename)
 			{
@@ -553,10 +842,9 @@ static int connectionBusyHandler(void *ptr, int count) {
 			return nil;
 		}
 		
-		// Configure VFS shim (for database connections).
-		
-		yap_vfs_shim_name = [NSString stringWithFormat:@"yap_vfs_shim_%@", [[NSUUID UUID] UUIDString]];
-		yap_vfs_shim_register([yap_vfs_shim_name UTF8String], NULL, &yap_vfs_shim);
+#ifdef SQLITE_HAS_CODEC
+		[self deriveCipherKeySpec];
+#endif
 		
 		// Initialize variables
 		
@@ -565,7 +853,8 @@ static int connectionBusyHandler(void *ptr, int count) {
 		snapshotQueue   = dispatch_queue_create("YapDatabase-Snapshot", NULL);
 		writeQueue      = dispatch_queue_create("YapDatabase-Write", NULL);
 		
-		changesets = [[NSMutableArray alloc] init];
+		changesets = [[NSArray alloc] init];
+		changesetsLock = YAP_UNFAIR_LOCK_INIT;
 		connectionStates = [[NSMutableArray alloc] init];
 		
 		connectionDefaults = [[YapDatabaseConnectionConfig alloc] init];
@@ -579,6 +868,12 @@ static int connectionBusyHandler(void *ptr, int count) {
 		maxConnectionPoolCount = DEFAULT_MAX_CONNECTION_POOL_COUNT;
 		connectionPoolLifetime = DEFAULT_CONNECTION_POOL_LIFETIME;
 		
+		slowQueryThreshold = 0.0;
+		slowQuerySampleRate = 1.0;
+		atomic_init(&slowQueryThresholdTicks, 0);
+		atomic_init(&slowQuerySampleThreshold, UINT32_MAX);
+		atomic_init(&coalescingIntervalNanos, 0);
+		
 		YapDatabaseSerializer defaultSerializer     = nil;
 		YapDatabaseDeserializer defaultDeserializer = nil;
 		
@@ -594,12 +889,106 @@ static int connectionBusyHandler(void *ptr, int count) {
 		metadataSerializer = (YapDatabaseSerializer)[inMetadataSerializer copy] ?: defaultSerializer;
 		metadataDeserializer = (YapDatabaseDeserializer)[inMetadataDeserializer copy] ?: defaultDeserializer;
 		
+		objectBytesDeserializer = [[self class] bytesDeserializerForDeserializer:objectDeserializer];
+		metadataBytesDeserializer = [[self class] bytesDeserializerForDeserializer:metadataDeserializer];
+		
 		objectPreSanitizer = (YapDatabasePreSanitizer)[inObjectPreSanitizer copy];
 		objectPostSanitizer = (YapDatabasePostSanitizer)[inObjectPostSanitizer copy];
 		
 		metadataPreSanitizer = (YapDatabasePreSanitizer)[inMetadataPreSanitizer copy];
 		metadataPostSanitizer = (YapDatabasePostSanitizer)[inMetadataPostSanitizer copy];
 		
+		groupCommitEnabled = options.enableGroupCommit &&
+		                     (options.pragmaSynchronous == YapDatabasePragmaSynchronous_Full);
+		
+		groupCommitCompletionQueues = [[NSMutableArray alloc] init];
+		groupCommitCompletionBlocks = [[NSMutableArray alloc] init];
+		
+		atomic_init(&priorityWritersWaitingCount, 0);
+		priorityWritersCondition = [[NSCondition alloc] init];
+		
+		atomic_init(&queueWaitTransactionCount, 0);
+		writeQueueHolder = [[YapDatabaseQueueHolder alloc] init];
+		snapshotQueueHolder = [[YapDatabaseQueueHolder alloc] init];
+		
+		relaxedDurabilityEnabled = (options.pragmaSynchronous == YapDatabasePragmaSynchronous_Full);
+		relaxedDurabilityTransactionLimit = options.relaxedDurabilityTransactionLimit;
+		relaxedDurabilityInterval = options.relaxedDurabilityInterval;
+		
+		checkpointPolicy = options.checkpointPolicy;
+		checkpointPolicyLock = YAP_UNFAIR_LOCK_INIT;
+		if (checkpointPolicy)
+		{
+			checkpointStatistics = [[YapDatabaseCheckpointStatistics alloc] init];
+			lastPolicyCheckpointTime = [NSDate timeIntervalSinceReferenceDate];
+		}
+		
+		if (options.enableSharedObjectCache && !options.enableMultiProcessSupport)
+		{
+			sharedObjectCache = [[YapSharedObjectCache alloc] initWithCountLimit:options.sharedObjectCacheLimit];
+		}
+		
+		if (options.enableMultiProcessSupport)
+		{
+			// If the file can't be mapped, every read-write transaction falls back to querying the snapshot.
+			
+			sharedSnapshot = yap_shared_snapshot_open([[self databasePath_yapshm] UTF8String]);
+			if (sharedSnapshot == NULL) {
+				YDBLogWarn(@"Unable to map shared snapshot file: %@", [self databasePath_yapshm]);
+			}
+			
+			// If the file can't be mapped, other processes flush their caches after each of our commits.
+			//
+			// The changelog stores collection/key names in plaintext.
+			// So it's disabled for encrypted databases (and any file left over from before is removed).
+			
+			BOOL isEncrypted = NO;
+		#ifdef SQLITE_HAS_CODEC
+			isEncrypted = (options.cipherKeyBlock || options.cipherKeySpecBlock);
+		#endif
+			
+			if (isEncrypted)
+			{
+				[[NSFileManager defaultManager] removeItemAtPath:[self databasePath_yapchg] error:NULL];
+			}
+			else
+			{
+				sharedChangelog = yap_shared_changelog_open([[self databasePath_yapchg] UTF8String], isNewDatabaseFile);
+				if (sharedChangelog == NULL) {
+					YDBLogWarn(@"Unable to map shared changelog file: %@", [self databasePath_yapchg]);
+				}
+			}
+		}
+		
+		compressionConfigs = options.compressionConfigs;
+		
+		compressionLock = YAP_UNFAIR_LOCK_INIT;
+		compressionDictionaries = [[NSMutableDictionary alloc] init];
+		activeCompressionDictionaryIds = [[NSMutableDictionary alloc] init];
+		
+		externalStorageThresholds = options.externalStorageThresholds;
+		
+		externalStorageQueue = dispatch_queue_create("YapDatabase-ExternalStorage", NULL);
+		externalStorageLock = YAP_UNFAIR_LOCK_INIT;
+		pendingExternalBlobDeletions = [[NSMutableDictionary alloc] init];
+		
+		coldCollections = options.coldCollections;
+		coldStorageAge = options.coldStorageAge;
+		
+		coldStorageQueue = dispatch_queue_create("YapDatabase-ColdStorage", NULL);
+		pendingColdBlobDeletions = [[NSMutableDictionary alloc] init];
+		
+		expiringCollections = options.expiringCollections;
+		
+		contentHashedCollections = options.contentHashedCollections;
+		
+		nativeMetadataTypes = options.nativeMetadataTypes.count > 0 ? options.nativeMetadataTypes : nil;
+		
+		objectHeaderExtractor = options.objectHeaderExtractor;
+		objectHeaderLength = options.objectHeaderLength;
+		
+		deferredExtensionsLock = YAP_UNFAIR_LOCK_INIT;
+		
 		// Mark the queues so we can identify them.
 		// There are several methods whose use is restricted to within a certain queue.
 		
@@ -615,6 +1004,8 @@ static int connectionBusyHandler(void *ptr, int count) {
 	
 			[self upgradeTable];
 			[self prepare];
+			
+			[self prewarmConnectionPool];
 		}});
 	}
 	return self;
@@ -653,13 +1044,46 @@ static int connectionBusyHandler(void *ptr, int count) {
 	if (connectionPoolTimer)
 		dispatch_source_cancel(connectionPoolTimer);
 	
+#ifdef SQLITE_HAS_CODEC
+	if (cipherKeySpec) {
+		[cipherKeySpec resetBytesInRange:NSMakeRange(0, cipherKeySpec.length)];
+		cipherKeySpec = nil;
+	}
+#endif
+	
 	if (db) {
 		sqlite3_close(db);
 		db = NULL;
 	}
+	if (coldDb) {
+		sqlite3_close(coldDb);
+		coldDb = NULL;
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (snapshotPinDbs[i]) {
+			sqlite3_close(snapshotPinDbs[i]);
+			snapshotPinDbs[i] = NULL;
+		}
+	}
+#ifdef SQLITE_ENABLE_SNAPSHOT
+	if (snapshotPin) {
+		sqlite3_snapshot_free(snapshotPin);
+		snapshotPin = NULL;
+	}
+#endif
 	if (yap_vfs_shim) {
 		yap_vfs_shim_unregister(&yap_vfs_shim);
 	}
+	if (memory_vfs) {
+		yap_vfs_memory_unregister(&memory_vfs);
+	}
+	if (sharedSnapshot) {
+		yap_shared_snapshot_close(&sharedSnapshot);
+	}
+	if (sharedChangelog) {
+		yap_shared_changelog_close(&sharedChangelog);
+	}
 	
 	[YapDatabaseManager deregisterDatabaseForPath:databasePath];
 	
@@ -695,8 +1119,20 @@ static int connectionBusyHandler(void *ptr, int count) {
 	// as we will be serializing access to the connection externally.
 	
 	int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
+	flags = [self sqliteOpenFlags:flags];
+	
+	// Our internal connection only goes through the shim if I/O statistics or page tracking are enabled.
+	// (It doesn't need any of the other functionality the shim provides for connections.)
+	// Page tracking needs it because our connection also writes to the WAL (e.g. incremental vacuum).
+	// 
+	// Otherwise it uses the in-memory VFS directly (if enabled), or the default VFS (NULL).
+	
+	const char *vfs = [memory_vfs_name UTF8String];
+	if (yap_vfs_shim && (yap_vfs_shim->io_stats || yap_vfs_shim->page_tracker)) {
+		vfs = [yap_vfs_shim_name UTF8String];
+	}
     
-	int status = sqlite3_open_v2([databasePath UTF8String], &db, flags, NULL);
+	int status = sqlite3_open_v2([[self sqliteOpenFilename] UTF8String], &db, flags, vfs);
 	if (status != SQLITE_OK)
 	{
 		// There are a few reasons why the database might not open.
@@ -721,6 +1157,41 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return YES;
 }
 
+/**
+ * The filename to pass to sqlite3_open_v2.
+ * 
+ * This is the databasePath, unless options.readOnlyImmutable is set,
+ * in which case it's a URI (e.g. "file:///path/to/db.sqlite?immutable=1").
+ * The same URI may be used to ATTACH the database to a connection of another (writable) database.
+**/
+- (NSString *)sqliteOpenFilename
+{
+	if (options.readOnlyImmutable)
+	{
+		// The path is percent-encoded by NSURL, and sqlite decodes it.
+		
+		NSString *fileURI = [[NSURL fileURLWithPath:databasePath] absoluteString];
+		return [fileURI stringByAppendingString:@"?immutable=1"];
+	}
+	
+	return databasePath;
+}
+
+/**
+ * Given the flags to pass to sqlite3_open_v2 (for a read-write connection),
+ * returns the flags to actually use, which differ if options.readOnlyImmutable is set.
+**/
+- (int)sqliteOpenFlags:(int)flags
+{
+	if (options.readOnlyImmutable)
+	{
+		flags &= ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+		flags |= (SQLITE_OPEN_READONLY | SQLITE_OPEN_URI);
+	}
+	
+	return flags;
+}
+
 /**
  * Configures the database connection.
  * This mainly means enabling WAL mode, and configuring the auto-checkpoint.
@@ -729,6 +1200,16 @@ static int connectionBusyHandler(void *ptr, int count) {
 {
 	int status;
 	
+	if (options.readOnlyImmutable)
+	{
+		// The file is never modified.
+		// So the only settings that apply are those that affect reads.
+		// (The journal_mode comes from the file, and there is never anything to checkpoint.)
+		
+		[self configureMMapSize];
+		return YES;
+	}
+	
 	// Set mandatory pragmas
 	
 	if (isNewDatabaseFile && (options.pragmaPageSize > 0))
@@ -750,14 +1231,41 @@ static int connectionBusyHandler(void *ptr, int count) {
 		return NO;
 	}
 	
+	BOOL incrementalVacuum = (options.pragmaAutoVacuum == YapDatabasePragmaAutoVacuum_Incremental);
+	
 	if (isNewDatabaseFile)
 	{
-		status = sqlite3_exec(db, "PRAGMA auto_vacuum = FULL; VACUUM;", NULL, NULL, NULL);
+		const char *pragma_auto_vacuum = incrementalVacuum
+		  ? "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;"
+		  : "PRAGMA auto_vacuum = FULL; VACUUM;";
+		
+		status = sqlite3_exec(db, pragma_auto_vacuum, NULL, NULL, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error setting PRAGMA auto_vacuum: %d %s", status, sqlite3_errmsg(db));
 		}
 	}
+	else
+	{
+		// Switching between FULL & INCREMENTAL doesn't require a VACUUM.
+		// (Whereas switching from NONE does, so we leave that to the vacuum method.)
+		
+		int64_t auto_vacuum = [YapDatabase pragma:@"auto_vacuum" using:db];
+		int64_t desired_auto_vacuum = incrementalVacuum ? 2 : 1;
+		
+		if (auto_vacuum > 0 && auto_vacuum != desired_auto_vacuum)
+		{
+			const char *pragma_auto_vacuum = incrementalVacuum
+			  ? "PRAGMA auto_vacuum = INCREMENTAL;"
+			  : "PRAGMA auto_vacuum = FULL;";
+			
+			status = sqlite3_exec(db, pragma_auto_vacuum, NULL, NULL, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error setting PRAGMA auto_vacuum: %d %s", status, sqlite3_errmsg(db));
+			}
+		}
+	}
 	
 	// Set synchronous to normal for THIS sqlite instance.
 	//
@@ -796,21 +1304,8 @@ static int connectionBusyHandler(void *ptr, int count) {
 	}
 	
 	// Set mmap_size (if needed).
-	//
-	// This configures memory mapped I/O.
 	
-	if (options.pragmaMMapSize > 0)
-	{
-		NSString *pragma_mmap_size =
-		  [NSString stringWithFormat:@"PRAGMA mmap_size = %ld;", (long)options.pragmaMMapSize];
-		
-		status = sqlite3_exec(db, [pragma_mmap_size UTF8String], NULL, NULL, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error setting PRAGMA mmap_size: %d %s", status, sqlite3_errmsg(db));
-			// This isn't critical, so we can continue.
-		}
-	}
+	[self configureMMapSize];
 	
 	// Disable autocheckpointing.
 	//
@@ -823,36 +1318,265 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return YES;
 }
 
-
-#ifdef SQLITE_HAS_CODEC
 /**
- * Configures database encryption via SQLCipher.
+ * Sets mmap_size (if needed).
+ * This configures memory mapped I/O.
 **/
-- (BOOL)configureEncryptionForDatabase:(sqlite3 *)sqlite
+- (void)configureMMapSize
 {
-    if (options.cipherKeyBlock ||
-        options.cipherKeySpecBlock)
+	if (options.pragmaMMapSizeMaximum > 0)
 	{
-        NSData *_Nullable keyData = nil;
-        if (options.cipherKeySpecBlock)
-        {
-            keyData = options.cipherKeySpecBlock();
-            if (!keyData)
-            {
-                NSAssert(NO, @"YapDatabaseOptions.cipherKeySpecBlock cannot return nil!");
-                return NO;
-            }
-        } else {
-            keyData = options.cipherKeyBlock();
-            if (!keyData)
-            {
-                NSAssert(NO, @"YapDatabaseOptions.cipherKeyBlock cannot return nil!");
-                return NO;
-            }
-        }
-        
-        //Setting the PBKDF2 default iteration number (this will have effect next time database is opened)
-        if (options.cipherDefaultkdfIterNumber > 0) {
+		[self updateMMapSizeTarget];
+		
+		NSString *pragma_mmap_size =
+		  [NSString stringWithFormat:@"PRAGMA mmap_size = %llu;", (unsigned long long)atomic_load(&mmapSizeTarget)];
+		
+		int status = sqlite3_exec(db, [pragma_mmap_size UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error setting PRAGMA mmap_size: %d %s", status, sqlite3_errmsg(db));
+			// This isn't critical, so we can continue.
+		}
+	}
+	else if (options.pragmaMMapSize > 0)
+	{
+		NSString *pragma_mmap_size =
+		  [NSString stringWithFormat:@"PRAGMA mmap_size = %ld;", (long)options.pragmaMMapSize];
+		
+		int status = sqlite3_exec(db, [pragma_mmap_size UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error setting PRAGMA mmap_size: %d %s", status, sqlite3_errmsg(db));
+			// This isn't critical, so we can continue.
+		}
+	}
+}
+
+/**
+ * The granularity of the adaptive mmap_size.
+ * Rounding the target up means it only changes once the file has grown by a meaningful amount.
+**/
+#define YAP_MMAP_SIZE_GRANULARITY (16 * 1024 * 1024)
+
+/**
+ * Returns the largest mmap_size we're willing to use (for adaptive sizing).
+ * 
+ * This is the configured maximum, limited to a quarter of the physical memory.
+ * On 32-bit devices the address space is the scarcer resource, so it's further limited to 256 MB.
+**/
+- (uint64_t)mmapSizeLimit
+{
+	uint64_t limit = (uint64_t)options.pragmaMMapSizeMaximum;
+	
+	limit = MIN(limit, [[NSProcessInfo processInfo] physicalMemory] / 4);
+	
+	if (sizeof(void *) < 8) {
+		limit = MIN(limit, (uint64_t)(256 * 1024 * 1024));
+	}
+	
+	return limit;
+}
+
+/**
+ * Recalculates the mmap_size that connections should use (if adaptive sizing is enabled).
+ * 
+ * In WAL mode the database file only grows when pages are checkpointed into it.
+ * So this is invoked during setup, and after each successful checkpoint.
+ * Connections adopt the new size at the start of their next transaction.
+**/
+- (void)updateMMapSizeTarget
+{
+	if (options.pragmaMMapSizeMaximum <= 0) return;
+	
+	NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:databasePath error:NULL];
+	uint64_t fileSize = [attributes fileSize];
+	
+	// Map a quarter beyond the current size, so the next checkpoints don't immediately outgrow the mapping.
+	
+	uint64_t target = fileSize + (fileSize / 4);
+	target = ((target / YAP_MMAP_SIZE_GRANULARITY) + 1) * YAP_MMAP_SIZE_GRANULARITY;
+	target = MIN(target, [self mmapSizeLimit]);
+	
+	uint64_t previous = atomic_exchange(&mmapSizeTarget, target);
+	if (previous != target)
+	{
+		YDBLogVerbose(@"Adaptive mmap_size: %llu -> %llu (file size %llu)", previous, target, fileSize);
+	}
+}
+
+
+#ifdef SQLITE_HAS_CODEC
+/**
+ * Keys the database with a raw key spec, using the "x'<hex>'" syntax.
+**/
+static int YapDatabaseSetCipherKeySpec(sqlite3 *sqlite, NSData *keySpec)
+{
+	static const char hexDigits[] = "0123456789abcdef";
+	
+	const uint8_t *bytes = (const uint8_t *)[keySpec bytes];
+	size_t length = (size_t)[keySpec length];
+	
+	size_t bufferLength = 3 + (length * 2);
+	char *buffer = malloc(bufferLength);
+	if (buffer == NULL) return SQLITE_NOMEM;
+	
+	buffer[0] = 'x';
+	buffer[1] = '\'';
+	for (size_t i = 0; i < length; i++)
+	{
+		buffer[2 + (i * 2)    ] = hexDigits[bytes[i] >> 4];
+		buffer[2 + (i * 2) + 1] = hexDigits[bytes[i] & 0x0F];
+	}
+	buffer[bufferLength - 1] = '\'';
+	
+	int status = sqlite3_key(sqlite, buffer, (int)bufferLength);
+	
+	memset_s(buffer, bufferLength, 0, bufferLength);
+	free(buffer);
+	
+	return status;
+}
+
+/**
+ * Fetches the (string) result of the given pragma, or nil if it isn't supported.
+**/
+static NSString* YapDatabaseCipherPragma(sqlite3 *sqlite, const char *pragma)
+{
+	sqlite3_stmt *statement = NULL;
+	NSString *result = nil;
+	
+	int status = sqlite3_prepare_v2(sqlite, pragma, -1, &statement, NULL);
+	if (status == SQLITE_OK)
+	{
+		if (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			const unsigned char *text = sqlite3_column_text(statement, SQLITE_COLUMN_START);
+			if (text) {
+				result = [NSString stringWithUTF8String:(const char *)text];
+			}
+		}
+	}
+	
+	sqlite3_finalize(statement);
+	return result;
+}
+
+/**
+ * Every sqlite3 instance runs the full (PBKDF2) key derivation when it's keyed with the cipherKeyBlock.
+ * Depending on kdf_iter, that's tens (or hundreds) of milliseconds for every new connection.
+ * 
+ * So, once the database has been opened (and thus the key has been verified), we derive the key spec ourselves,
+ * using the salt & kdf parameters that SQLCipher reports. Every other sqlite3 instance is then keyed with the
+ * raw key spec, which skips the key derivation.
+ * 
+ * The derived key spec is verified (using a separate sqlite3 instance) before it's used.
+ * If anything doesn't match, we simply continue to use the cipherKeyBlock.
+ * 
+ * The key spec is kept in memory for the lifetime of the database, and is zeroed in dealloc.
+**/
+- (void)deriveCipherKeySpec
+{
+	if (!options.cipherKeyBlock || options.cipherKeySpecBlock) return;
+	
+	NSData *password = options.cipherKeyBlock();
+	NSString *saltString = YapDatabaseCipherPragma(db, "PRAGMA cipher_salt;");
+	NSString *kdfIterString = YapDatabaseCipherPragma(db, "PRAGMA kdf_iter;");
+	NSString *kdfAlgorithm = YapDatabaseCipherPragma(db, "PRAGMA cipher_kdf_algorithm;"); // nil before SQLCipher 4
+	
+	NSUInteger kdfIter = (NSUInteger)[kdfIterString longLongValue];
+	
+	if (password.length == 0 || saltString.length != (kSQLCipherSaltLength * 2) || kdfIter == 0)
+	{
+		YDBLogVerbose(@"Unable to derive SQLCipher key spec. Continuing to use cipherKeyBlock.");
+		return;
+	}
+	
+	NSMutableData *saltData = [NSMutableData dataWithCapacity:kSQLCipherSaltLength];
+	for (NSUInteger i = 0; i < kSQLCipherSaltLength; i++)
+	{
+		unsigned int byte = 0;
+		NSScanner *scanner = [NSScanner scannerWithString:[saltString substringWithRange:NSMakeRange(i * 2, 2)]];
+		if (![scanner scanHexInt:&byte]) return;
+		
+		uint8_t b = (uint8_t)byte;
+		[saltData appendBytes:&b length:1];
+	}
+	
+	NSData *keySpec = [YapDatabaseCryptoUtils databaseKeySpecForPassword:password
+	                                                            saltData:saltData
+	                                                       kdfIterations:kdfIter
+	                                                        kdfAlgorithm:kdfAlgorithm];
+	if (keySpec.length != kSQLCipherKeySpecLength)
+	{
+		YDBLogWarn(@"Unable to derive SQLCipher key spec. Continuing to use cipherKeyBlock.");
+		return;
+	}
+	
+	// Verify the key spec using a separate sqlite3 instance
+	
+	cipherKeySpec = [keySpec mutableCopy];
+	
+	int flags = [self sqliteOpenFlags:(SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE)];
+	sqlite3 *verifyDb = NULL;
+	
+	BOOL verified = NO;
+	
+	int status = sqlite3_open_v2([[self sqliteOpenFilename] UTF8String], &verifyDb, flags, [memory_vfs_name UTF8String]);
+	if (status == SQLITE_OK && [self configureEncryptionForDatabase:verifyDb])
+	{
+		status = sqlite3_exec(verifyDb, "SELECT count(*) FROM sqlite_master;", NULL, NULL, NULL);
+		verified = (status == SQLITE_OK);
+	}
+	
+	if (verifyDb) {
+		sqlite3_close(verifyDb);
+	}
+	
+	if (!verified)
+	{
+		YDBLogWarn(@"Derived SQLCipher key spec doesn't match. Continuing to use cipherKeyBlock.");
+		
+		[cipherKeySpec resetBytesInRange:NSMakeRange(0, cipherKeySpec.length)];
+		cipherKeySpec = nil;
+	}
+}
+
+/**
+ * Configures database encryption via SQLCipher.
+**/
+- (BOOL)configureEncryptionForDatabase:(sqlite3 *)sqlite
+{
+    if (options.cipherKeyBlock ||
+        options.cipherKeySpecBlock)
+	{
+        // Once the key spec has been derived (see deriveCipherKeySpec),
+        // it's used instead of the cipherKeyBlock, which skips the (expensive) key derivation.
+        BOOL useKeySpec = (options.cipherKeySpecBlock != nil) || (cipherKeySpec != nil);
+        
+        NSData *_Nullable keyData = nil;
+        if (cipherKeySpec)
+        {
+            keyData = cipherKeySpec;
+        }
+        else if (options.cipherKeySpecBlock)
+        {
+            keyData = options.cipherKeySpecBlock();
+            if (!keyData)
+            {
+                NSAssert(NO, @"YapDatabaseOptions.cipherKeySpecBlock cannot return nil!");
+                return NO;
+            }
+        } else {
+            keyData = options.cipherKeyBlock();
+            if (!keyData)
+            {
+                NSAssert(NO, @"YapDatabaseOptions.cipherKeyBlock cannot return nil!");
+                return NO;
+            }
+        }
+        
+        //Setting the PBKDF2 default iteration number (this will have effect next time database is opened)
+        if (options.cipherDefaultkdfIterNumber > 0) {
             char *errorMsg;
             NSString *pragmaCommand = [NSString stringWithFormat:@"PRAGMA cipher_default_kdf_iter = %lu", (unsigned long)options.cipherDefaultkdfIterNumber];
             if (sqlite3_exec(sqlite, [pragmaCommand UTF8String], NULL, NULL, &errorMsg) != SQLITE_OK)
@@ -884,15 +1608,15 @@ static int connectionBusyHandler(void *ptr, int count) {
             }
         }
         
-        if (options.cipherKeySpecBlock) {
+        if (useKeySpec) {
             // Use a raw key spec, where the 96 hexadecimal digits are provided
             // (i.e. 64 hex for the 256 bit key, followed by 32 hex for the 128 bit salt)
             // using explicit BLOB syntax, e.g.:
             //
             // x'98483C6EB40B6C31A448C22A66DED3B5E5E8D5119CAC8327B655C8B5C483648101010101010101010101010101010101'
-            NSString *keySpecString = [NSString stringWithFormat:@"x'%@'", [self hexadecimalStringForData:keyData]];
-            NSData *keySpecStringData = [keySpecString dataUsingEncoding:NSUTF8StringEncoding];
-            int status = sqlite3_key(sqlite, [keySpecStringData bytes], (int)[keySpecStringData length]);
+            //
+            // The string is built in a buffer we can zero afterwards (unlike an NSString).
+            int status = YapDatabaseSetCipherKeySpec(sqlite, keyData);
             if (status != SQLITE_OK)
             {
                 YDBLogError(@"Error setting SQLCipher key: %d %s", status, sqlite3_errmsg(sqlite));
@@ -911,8 +1635,9 @@ static int connectionBusyHandler(void *ptr, int count) {
             (options.cipherKeySpecBlock ||
              options.cipherSaltBlock)) {
              
-            if (options.cipherKeySpecBlock) {
+            if (useKeySpec) {
                 // YapDatabase using cipher key spec and unencrypted header.
+                // (The key spec includes the salt.)
             } else {
                 // YapDatabase using cipher salt and unencrypted header.
                 
@@ -992,6 +1717,9 @@ static int connectionBusyHandler(void *ptr, int count) {
  * 
  * - yap2      : stores snapshot and metadata for extensions
  * - database2 : stores collection/key/value/metadata rows
+ * 
+ * If the database has already been upgraded to the collection-id schema,
+ * then "database2" is a view (see upgradeTable_3_4), and there's nothing else to create.
 **/
 - (BOOL)createTables
 {
@@ -1012,8 +1740,48 @@ static int connectionBusyHandler(void *ptr, int count) {
 		return NO;
 	}
 	
-	char *createDatabaseTableStatement =
-	    "CREATE TABLE IF NOT EXISTS \"database2\""
+	if (options.enableFastOpen)
+	{
+		// The open fingerprint caches the list of registered extensions.
+		// So the fingerprint is deleted whenever an extension appears in (or disappears from) the 'yap2' table.
+		// This works regardless of who modifies the table (e.g. another process, or an older version of YapDatabase).
+		
+		char *createTriggersStatement =
+		    "CREATE TRIGGER IF NOT EXISTS \"yap2_fingerprint_insert\" AFTER INSERT ON \"yap2\""
+		    " WHEN NEW.\"extension\" != '' AND NOT EXISTS"
+		    "  (SELECT 1 FROM \"yap2\" WHERE \"extension\" = NEW.\"extension\" AND \"key\" != NEW.\"key\")"
+		    " BEGIN"
+		    "  DELETE FROM \"yap2\" WHERE \"extension\" = '' AND \"key\" = 'openFingerprint';"
+		    " END;"
+		    "CREATE TRIGGER IF NOT EXISTS \"yap2_fingerprint_delete\" AFTER DELETE ON \"yap2\""
+		    " WHEN OLD.\"extension\" != '' AND NOT EXISTS"
+		    "  (SELECT 1 FROM \"yap2\" WHERE \"extension\" = OLD.\"extension\")"
+		    " BEGIN"
+		    "  DELETE FROM \"yap2\" WHERE \"extension\" = '' AND \"key\" = 'openFingerprint';"
+		    " END;";
+		
+		status = sqlite3_exec(db, createTriggersStatement, NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed creating 'yap2' fingerprint triggers: %d %s", status, sqlite3_errmsg(db));
+			return NO;
+		}
+	}
+	
+	if ([[self class] pragma:@"user_version" using:db] >= YAP_DATABASE_COLLECTION_IDS_VERSION)
+	{
+		return YES;
+	}
+	
+	char *createDatabaseTableStatement = options.storeMetadataBeforeData
+	  ? "CREATE TABLE IF NOT EXISTS \"database2\""
+	    " (\"rowid\" INTEGER PRIMARY KEY,"
+	    "  \"collection\" CHAR NOT NULL,"
+	    "  \"key\" CHAR NOT NULL,"
+	    "  \"metadata\" BLOB,"
+	    "  \"data\" BLOB"
+	    " );"
+	  : "CREATE TABLE IF NOT EXISTS \"database2\""
 	    " (\"rowid\" INTEGER PRIMARY KEY,"
 	    "  \"collection\" CHAR NOT NULL,"
 	    "  \"key\" CHAR NOT NULL,"
@@ -1041,6 +1809,37 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return YES;
 }
 
+/**
+ * The counterpart of createTables, for a readOnlyImmutable database.
+ * 
+ * Nothing can be created (or upgraded), so this ensures the file already has the tables we need,
+ * in the current format.
+**/
+- (BOOL)checkTables
+{
+	int64_t user_version = [[self class] pragma:@"user_version" using:db];
+	
+	if (user_version < YAP_DATABASE_CURRENT_VERION)
+	{
+		YDBLogError(@"Error opening immutable database: unsupported version (%lld). "
+		            @"The file must be opened (read-write) with this version of YapDatabase first.",
+		            (long long)user_version);
+		return NO;
+	}
+	
+	BOOL hasDatabaseTable = (user_version >= YAP_DATABASE_COLLECTION_IDS_VERSION)
+	  ? [[self class] tableExists:@"database3" using:db]
+	  : [[self class] tableExists:@"database2" using:db];
+	
+	if (![[self class] tableExists:@"yap2" using:db] || !hasDatabaseTable)
+	{
+		YDBLogError(@"Error opening immutable database: missing tables");
+		return NO;
+	}
+	
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1170,6 +1969,48 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return result;
 }
 
+/**
+ * Returns the (normalized) statement that created the given trigger, or nil if the trigger doesn't exist.
+**/
++ (NSString *)sqlForTrigger:(NSString *)triggerName using:(sqlite3 *)aDb
+{
+	if (triggerName == nil) return nil;
+	
+	sqlite3_stmt *statement;
+	char *stmt = "SELECT sql FROM sqlite_master WHERE type = 'trigger' AND name = ?";
+	
+	int status = sqlite3_prepare_v2(aDb, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement! %d %s", THIS_METHOD, status, sqlite3_errmsg(aDb));
+		return nil;
+	}
+	
+	NSString *result = nil;
+	
+	sqlite3_bind_text(statement, SQLITE_BIND_START, [triggerName UTF8String], -1, SQLITE_TRANSIENT);
+	
+	status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		const unsigned char *text = sqlite3_column_text(statement, SQLITE_COLUMN_START);
+		int textSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
+		
+		if (text) {
+			result = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		}
+	}
+	else if (status == SQLITE_ERROR)
+	{
+		YDBLogError(@"%@: Error executing statement! %d %s", THIS_METHOD, status, sqlite3_errmsg(aDb));
+	}
+	
+	sqlite3_finalize(statement);
+	statement = NULL;
+	
+	return result;
+}
+
 + (NSArray *)tableNamesUsing:(sqlite3 *)aDb
 {
 	sqlite3_stmt *statement;
@@ -1419,41 +2260,194 @@ static int connectionBusyHandler(void *ptr, int count) {
 }
 
 /**
- * Performs upgrade checks, and implements the upgrade "plumbing" by invoking the appropriate upgrade methods.
+ * In version 4 (opt-in via YapDatabaseOptions.enableCollectionIds),
+ * collection names are interned into the "collections" table, and rows are keyed on (collection_id, key).
  * 
- * To add custom upgrade logic, implement a method named "upgradeTable_X_Y",
- * where X is the previous version, and Y is the new version.
- * For example:
+ * This method migrates 'database2' to 'database3', preserving all rowids (which extensions depend upon).
+ * Afterwards, 'database2' is re-created as a read-only view that joins the two tables,
+ * so that read statements (and external tools) continue to work unmodified.
+**/
+- (BOOL)upgradeTable_3_4
+{
+	int status;
+	
+	char *stmt =
+	  "BEGIN TRANSACTION;"
+	  "CREATE TABLE \"collections\""
+	  " (\"collection_id\" INTEGER PRIMARY KEY,"
+	  "  \"collection\" CHAR NOT NULL UNIQUE"
+	  " );"
+	  "INSERT INTO \"collections\" (\"collection\") SELECT DISTINCT \"collection\" FROM \"database2\";"
+	  "CREATE TABLE \"database3\""
+	  " (\"rowid\" INTEGER PRIMARY KEY,"
+	  "  \"collection_id\" INTEGER NOT NULL,"
+	  "  \"key\" CHAR NOT NULL,"
+	  "  \"data\" BLOB,"
+	  "  \"metadata\" BLOB"
+	  " );"
+	  "INSERT INTO \"database3\" (\"rowid\", \"collection_id\", \"key\", \"data\", \"metadata\")"
+	  " SELECT \"d\".\"rowid\", \"c\".\"collection_id\", \"d\".\"key\", \"d\".\"data\", \"d\".\"metadata\""
+	  " FROM \"database2\" AS \"d\" JOIN \"collections\" AS \"c\" ON \"c\".\"collection\" = \"d\".\"collection\";"
+	  "DROP TABLE \"database2\";"
+	  "CREATE UNIQUE INDEX \"true_primary_key\" ON \"database3\" ( \"collection_id\", \"key\" );"
+	  YAP_DATABASE_COLLECTION_IDS_VIEW
+	  "COMMIT TRANSACTION;";
+	
+	status = sqlite3_exec(db, stmt, NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error migrating 'database2' to 'database3': %d %s", status, sqlite3_errmsg(db));
+		
+		sqlite3_exec(db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Invoked (after any version upgrades) if YapDatabaseOptions.storeMetadataBeforeData is enabled.
  * 
- * - (BOOL)upgradeTable_1_2 {
- *     // Upgrades from version 1 to version 2 of YapDatabase.
- *     // Return YES if successful.
- * }
+ * SQLite stores the columns of a row in order. So when the "data" column comes first,
+ * and the objects are large enough to spill onto overflow pages,
+ * reading just the "metadata" column requires walking the entire overflow chain.
  * 
- * IMPORTANT:
- * This is for upgrades of the database schema, and low-level operations of YapDatabase.
- * This is NOT for upgrading data within the database (i.e. objects, metadata, or keys).
- * Such data upgrades should be performed client side.
- *
- * This method is run asynchronously on the queue.
+ * This method rebuilds the primary table ("database2", or "database3" for the collection-id schema)
+ * with the "metadata" column stored before the "data" column. All statements reference columns by name,
+ * so nothing else needs to change. Rowids are preserved.
+ * 
+ * If the table already has the desired layout, this method does nothing.
 **/
-- (void)upgradeTable
+- (BOOL)upgradeMetadataColumnOrder
 {
-	int user_version = 0;
-	if (![self get_user_version:&user_version]) return;
+	NSString *table = usesCollectionIds ? @"database3" : @"database2";
 	
-	while (user_version < YAP_DATABASE_CURRENT_VERION)
+	NSArray *columnNames = [[self class] columnNamesForTable:table using:db];
+	
+	NSUInteger dataIndex = [columnNames indexOfObject:@"data"];
+	NSUInteger metadataIndex = [columnNames indexOfObject:@"metadata"];
+	
+	if (dataIndex == NSNotFound || metadataIndex == NSNotFound)
 	{
-		// Invoke method upgradeTable_X_Y
-		// where X == current_version, and Y == current_version+1.
-		//
-		// Do this until we're up-to-date.
-		
-		int new_user_version = user_version + 1;
-		
-		NSString *selName = [NSString stringWithFormat:@"upgradeTable_%d_%d", user_version, new_user_version];
-		SEL sel = NSSelectorFromString(selName);
-		
+		YDBLogError(@"%@: Unexpected columns in '%@' table: %@", THIS_METHOD, table, columnNames);
+		return NO;
+	}
+	
+	if (metadataIndex < dataIndex)
+	{
+		// Already stored in the desired order
+		return YES;
+	}
+	
+	YDBLogInfo(@"Rebuilding '%@' table of database (%@) with metadata before data...",
+	           table, [databasePath lastPathComponent]);
+	
+	NSString *collectionColumn = usesCollectionIds ? @"collection_id" : @"collection";
+	NSString *collectionType   = usesCollectionIds ? @"INTEGER" : @"CHAR";
+	
+	NSMutableString *stmt = [NSMutableString stringWithCapacity:1024];
+	
+	[stmt appendString:@"BEGIN TRANSACTION;"];
+	
+	if (usesCollectionIds) {
+		[stmt appendString:@"DROP VIEW IF EXISTS \"database2\";"];
+	}
+	
+	[stmt appendFormat:
+	  @"CREATE TABLE \"%1$@_tmp\""
+	  @" (\"rowid\" INTEGER PRIMARY KEY,"
+	  @"  \"%2$@\" %3$@ NOT NULL,"
+	  @"  \"key\" CHAR NOT NULL,"
+	  @"  \"metadata\" BLOB,"
+	  @"  \"data\" BLOB"
+	  @" );", table, collectionColumn, collectionType];
+	
+	[stmt appendFormat:
+	  @"INSERT INTO \"%1$@_tmp\" (\"rowid\", \"%2$@\", \"key\", \"metadata\", \"data\")"
+	  @" SELECT \"rowid\", \"%2$@\", \"key\", \"metadata\", \"data\" FROM \"%1$@\";", table, collectionColumn];
+	
+	[stmt appendFormat:@"DROP TABLE \"%1$@\";", table];
+	[stmt appendFormat:@"ALTER TABLE \"%1$@_tmp\" RENAME TO \"%1$@\";", table];
+	
+	[stmt appendFormat:
+	  @"CREATE UNIQUE INDEX \"true_primary_key\" ON \"%1$@\" ( \"%2$@\", \"key\" );", table, collectionColumn];
+	
+	if (usesCollectionIds) {
+		[stmt appendFormat:@"%s", YAP_DATABASE_COLLECTION_IDS_VIEW];
+	}
+	
+	[stmt appendString:@"COMMIT TRANSACTION;"];
+	
+	int status = sqlite3_exec(db, [stmt UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error rebuilding '%@' table: %d %s", table, status, sqlite3_errmsg(db));
+		
+		sqlite3_exec(db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Performs upgrade checks, and implements the upgrade "plumbing" by invoking the appropriate upgrade methods.
+ * 
+ * To add custom upgrade logic, implement a method named "upgradeTable_X_Y",
+ * where X is the previous version, and Y is the new version.
+ * For example:
+ * 
+ * - (BOOL)upgradeTable_1_2 {
+ *     // Upgrades from version 1 to version 2 of YapDatabase.
+ *     // Return YES if successful.
+ * }
+ * 
+ * IMPORTANT:
+ * This is for upgrades of the database schema, and low-level operations of YapDatabase.
+ * This is NOT for upgrading data within the database (i.e. objects, metadata, or keys).
+ * Such data upgrades should be performed client side.
+ *
+ * This method is run asynchronously on the queue.
+**/
+- (void)upgradeTable
+{
+	if (openFingerprint)
+	{
+		// The tables were already upgraded (with the same options) when the fingerprint was written.
+		
+		int user_version = [[openFingerprint objectForKey:@"userVersion"] intValue];
+		usesCollectionIds = (user_version >= YAP_DATABASE_COLLECTION_IDS_VERSION);
+		return;
+	}
+	
+	int user_version = 0;
+	if (![self get_user_version:&user_version]) return;
+	
+	if (options.readOnlyImmutable)
+	{
+		// The file can't be upgraded, so we use whatever format it has.
+		// (checkTables ensured it's a supported one.)
+		
+		usesCollectionIds = (user_version >= YAP_DATABASE_COLLECTION_IDS_VERSION);
+		return;
+	}
+	
+	int target_version = YAP_DATABASE_CURRENT_VERION;
+	if (options.enableCollectionIds)
+		target_version = YAP_DATABASE_COLLECTION_IDS_VERSION;
+	
+	while (user_version < target_version)
+	{
+		// Invoke method upgradeTable_X_Y
+		// where X == current_version, and Y == current_version+1.
+		//
+		// Do this until we're up-to-date.
+		
+		int new_user_version = user_version + 1;
+		
+		NSString *selName = [NSString stringWithFormat:@"upgradeTable_%d_%d", user_version, new_user_version];
+		SEL sel = NSSelectorFromString(selName);
+		
 		if ([self respondsToSelector:sel])
 		{
 			YDBLogInfo(@"Upgrading database (%@) from version %d to %d...",
@@ -1479,6 +2473,16 @@ static int connectionBusyHandler(void *ptr, int count) {
 		
 		user_version = new_user_version;
 	}
+	
+	usesCollectionIds = (user_version >= YAP_DATABASE_COLLECTION_IDS_VERSION);
+	
+	if (options.storeMetadataBeforeData)
+	{
+		if (![self upgradeMetadataColumnOrder])
+		{
+			YDBLogError(@"Error upgrading database (%@)", [databasePath lastPathComponent]);
+		}
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1494,17 +2498,40 @@ static int connectionBusyHandler(void *ptr, int count) {
 	
 	[self beginTransaction];
 	{
-		snapshot = [self readSnapshot];
+		atomic_store_explicit(&snapshot, [self readSnapshot], memory_order_release);
+		if (!options.readOnlyImmutable) {
+			[self noteLatestSnapshotForCheckpointPolicy:snapshot];
+		}
         
 		sqliteVersion = [YapDatabase sqliteVersionUsing:db];
 		YDBLogVerbose(@"sqlite version = %@", sqliteVersion);
 		
 		pageSize = (uint64_t)[YapDatabase pragma:@"page_size" using:db];
 		
-		[self fetchPreviouslyRegisteredExtensionNames];
+		if (openFingerprint)
+			previouslyRegisteredExtensionNames = [openFingerprint objectForKey:@"extensions"];
+		else
+			[self fetchPreviouslyRegisteredExtensionNames];
+		
+		[self prepareCompression];
+		[self prepareExternalStorage];
+		[self prepareExpiration];
+		[self prepareColdStorage];
+		[self prepareContentHashes];
+		[self prepareNativeMetadata];
+		
+		if (options.enableFastOpen && !options.readOnlyImmutable) {
+			[self writeOpenFingerprint];
+		}
+		openFingerprint = nil;
 	}
 	[self commitTransaction];
-	[self asyncCheckpoint:snapshot];
+	
+	if (!options.readOnlyImmutable) {
+		[self asyncCheckpoint:snapshot];
+		[self asyncExpirationSweep];
+		[self asyncColdStorageMigration];
+	}
 }
 
 - (void)beginTransaction
@@ -1609,1350 +2636,4726 @@ static int connectionBusyHandler(void *ptr, int count) {
 	previouslyRegisteredExtensionNames = extensionNames;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Defaults
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (YapDatabaseConnectionConfig *)connectionDefaults
-{
-	return connectionDefaults;
-}
-
-- (BOOL)defaultObjectCacheEnabled
-{
-	return connectionDefaults.objectCacheEnabled;
-}
-
-- (void)setDefaultObjectCacheEnabled:(BOOL)defaultObjectCacheEnabled
-{
-	connectionDefaults.objectCacheEnabled = defaultObjectCacheEnabled;
-}
-
-- (NSUInteger)defaultObjectCacheLimit
-{
-	return connectionDefaults.objectCacheLimit;
-}
-
-- (void)setDefaultObjectCacheLimit:(NSUInteger)defaultObjectCacheLimit
-{
-	connectionDefaults.objectCacheLimit = defaultObjectCacheLimit;
-}
-
-- (BOOL)defaultMetadataCacheEnabled
-{
-	return connectionDefaults.metadataCacheEnabled;
-}
-
-- (void)setDefaultMetadataCacheEnabled:(BOOL)defaultMetadataCacheEnabled
-{
-	connectionDefaults.metadataCacheEnabled = defaultMetadataCacheEnabled;
-}
-
-- (NSUInteger)defaultMetadataCacheLimit
-{
-	return connectionDefaults.metadataCacheLimit;
-}
-
-- (void)setDefaultMetadataCacheLimit:(NSUInteger)defaultMetadataCacheLimit
-{
-	connectionDefaults.metadataCacheLimit = defaultMetadataCacheLimit;
-}
-
-- (YapDatabasePolicy)defaultObjectPolicy
-{
-	return connectionDefaults.objectPolicy;
-}
-
-- (void)setDefaultObjectPolicy:(YapDatabasePolicy)defaultObjectPolicy
-{
-	connectionDefaults.objectPolicy = defaultObjectPolicy;
-}
-
-- (YapDatabasePolicy)defaultMetadataPolicy
-{
-	return connectionDefaults.metadataPolicy;
-}
-
-- (void)setDefaultMetadataPolicy:(YapDatabasePolicy)defaultMetadataPolicy
-{
-	connectionDefaults.metadataPolicy = defaultMetadataPolicy;
-}
-
-#if TARGET_OS_IOS || TARGET_OS_TV
-
-- (YapDatabaseConnectionFlushMemoryFlags)defaultAutoFlushMemoryFlags
-{
-	return connectionDefaults.autoFlushMemoryFlags;
-}
-
-- (void)setDefaultAutoFlushMemoryFlags:(YapDatabaseConnectionFlushMemoryFlags)defaultAutoFlushMemoryFlags
+/**
+ * The open fingerprint summarizes everything the (slow) open path figures out by introspecting the database.
+ * That is, the result of creating/upgrading the tables, and the list of previously registered extensions.
+ * 
+ * It's only valid if the file still has the same schema & user_version,
+ * and was opened with the same (relevant) options & version of YapDatabase.
+ * The list of extensions is kept valid via the triggers created in createTables.
+**/
+- (NSDictionary *)currentOpenFingerprintWithExtensionNames:(NSArray *)extensionNames
 {
-	connectionDefaults.autoFlushMemoryFlags = defaultAutoFlushMemoryFlags;
+	return @{
+		@"format"                  : @(1),
+		@"yapVersion"              : @(YAP_DATABASE_CURRENT_VERION),
+		@"schemaVersion"           : @([[self class] pragma:@"schema_version" using:db]),
+		@"userVersion"             : @([[self class] pragma:@"user_version" using:db]),
+		@"enableCollectionIds"     : @(options.enableCollectionIds),
+		@"storeMetadataBeforeData" : @(options.storeMetadataBeforeData),
+		@"extensions"              : (extensionNames ?: @[])
+	};
 }
 
-#endif
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Connections
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * This method is called from [self newConnection].
+ * Reads the open fingerprint (if any), and sets the openFingerprint ivar if it's still valid.
+ * In which case createTables, the upgrade introspection & fetchPreviouslyRegisteredExtensionNames are skipped.
 **/
-- (void)addConnection:(YapDatabaseConnection *)connection
+- (BOOL)readOpenFingerprint
 {
-	// We can asynchronously add the connection to the state table.
-	// This is safe as the connection itself must go through the same queue in order to do anything.
-	//
-	// The primary motivation in adding the asynchronous functionality is due to the following common use case:
-	//
-	// YapDatabase *database = [[YapDatabase alloc] initWithPath:path];
-	// YapDatabaseConnection *databaseConnection = [database newConnection];
-	//
-	// The YapDatabase init method is asynchronously preparing itself through the snapshot queue.
-	// We'd like to avoid blocking the very next line of code and allow the asynchronous prepare to continue.
+	if (options.readOnlyImmutable) return NO;
 	
-	dispatch_async(connection->connectionQueue, ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	sqlite3_stmt *statement;
+	
+	const char *stmt = "SELECT \"data\" FROM \"yap2\" WHERE \"extension\" = '' AND \"key\" = 'openFingerprint';";
+	
+	// Note: This fails if the 'yap2' table doesn't exist yet, in which case we simply take the slow path.
+	
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		return NO;
+	}
+	
+	NSDictionary *fingerprint = nil;
+	
+	status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		const void *blob = sqlite3_column_blob(statement, SQLITE_COLUMN_START);
+		int blobSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
 		
-		dispatch_sync(snapshotQueue, ^{ @autoreleasepool {
-			
-			// Add the connection to the state table
-			
-			YapDatabaseConnectionState *state = [[YapDatabaseConnectionState alloc] initWithConnection:connection];
-			[connectionStates addObject:state];
-			
-			YDBLogVerbose(@"Created new connection(%p) for <%@ %p: databaseName=%@, connectionCount=%lu>",
-			              connection, [self class], self, [databasePath lastPathComponent],
-			              (unsigned long)[connectionStates count]);
-			
-			// Invoke the one-time prepare method, so the connection can perform any needed initialization.
-			// Be sure to do this within the snapshotQueue, as the prepare method depends on this.
-			
-			[connection prepare];
-		}});
+		NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
+		id plist = [NSPropertyListSerialization propertyListWithData:data options:0 format:NULL error:NULL];
 		
-	#pragma clang diagnostic pop
-	});
+		if ([plist isKindOfClass:[NSDictionary class]]) {
+			fingerprint = (NSDictionary *)plist;
+		}
+	}
+	
+	sqlite3_finalize(statement);
+	statement = NULL;
+	
+	if (fingerprint == nil) return NO;
+	
+	NSArray *extensionNames = [fingerprint objectForKey:@"extensions"];
+	if (![extensionNames isKindOfClass:[NSArray class]]) return NO;
+	
+	if (![fingerprint isEqualToDictionary:[self currentOpenFingerprintWithExtensionNames:extensionNames]])
+	{
+		YDBLogVerbose(@"Open fingerprint doesn't match. Using the slow path.");
+		return NO;
+	}
+	
+	openFingerprint = fingerprint;
+	return YES;
 }
 
 /**
- * This method is called from YapDatabaseConnection's dealloc method.
+ * Writes the open fingerprint (if it changed).
+ * Must be invoked at the end of setup (within a transaction), after any schema changes.
 **/
-- (void)removeConnection:(YapDatabaseConnection *)connection
+- (void)writeOpenFingerprint
 {
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		NSUInteger index = 0;
-		for (YapDatabaseConnectionState *state in connectionStates)
-		{
-			if (state->connection == connection)
-			{
-				[connectionStates removeObjectAtIndex:index];
-				break;
-			}
-			
-			index++;
-		}
-		
-		YDBLogVerbose(@"Removed connection(%p) from <%@ %p: databaseName=%@, connectionCount=%lu>",
-		              connection, [self class], self, [databasePath lastPathComponent],
-		              (unsigned long)[connectionStates count]);
-		
-	#pragma clang diagnostic pop
-	}};
+	NSDictionary *fingerprint = [self currentOpenFingerprintWithExtensionNames:previouslyRegisteredExtensionNames];
 	
-	// We prefer to invoke this method synchronously.
-	//
-	// The connection may be the last object retaining the database.
-	// It's easier to trace object deallocations when they happen in a predictable order.
+	if (openFingerprint && [openFingerprint isEqualToDictionary:fingerprint]) {
+		return;
+	}
 	
-	if (dispatch_get_specific(IsOnSnapshotQueueKey))
-		block();
-	else
-		dispatch_sync(snapshotQueue, block);
+	NSData *data = [NSPropertyListSerialization dataWithPropertyList:fingerprint
+	                                                          format:NSPropertyListBinaryFormat_v1_0
+	                                                         options:0
+	                                                           error:NULL];
+	if (data == nil) return;
+	
+	sqlite3_stmt *statement;
+	
+	const char *stmt =
+	  "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\") VALUES ('', 'openFingerprint', ?);";
+	
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return;
+	}
+	
+	sqlite3_bind_blob(statement, SQLITE_BIND_START, data.bytes, (int)data.length, SQLITE_STATIC);
+	
+	status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_finalize(statement);
+	statement = NULL;
 }
 
 /**
- * This is a public method called to create a new connection.
+ * Loads the compression dictionaries (if any),
+ * and stores any new dictionaries that were provided via the compression configs.
+ * 
+ * Compressed rows are only looked for (during deserialization) if compression is configured,
+ * or if the database file has been used with compression in the past.
 **/
-- (YapDatabaseConnection *)newConnection
+- (void)prepareCompression
 {
-	YapDatabaseConnection *connection = [[YapDatabaseConnection alloc] initWithDatabase:self];
+	BOOL tableExists = [[self class] tableExists:@"yap_compression_dictionaries" using:db];
 	
-	[self addConnection:connection];
-	return connection;
+	if (!tableExists && (compressionConfigs.count == 0 || options.readOnlyImmutable)) return;
+	
+	int status;
+	sqlite3_stmt *statement;
+	
+	if (!tableExists)
+	{
+		char *createTableStatement =
+		    "CREATE TABLE IF NOT EXISTS \"yap_compression_dictionaries\""
+		    " (\"dictionary_id\" INTEGER PRIMARY KEY,"
+		    "  \"collection\" CHAR NOT NULL,"
+		    "  \"trained\" INTEGER NOT NULL,"
+		    "  \"data\" BLOB"
+		    " );";
+		
+		status = sqlite3_exec(db, createTableStatement, NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed creating 'yap_compression_dictionaries' table: %d %s", status, sqlite3_errmsg(db));
+			return;
+		}
+	}
+	
+	compressionEnabled = YES;
+	
+	// Load the existing dictionaries.
+	// The most recent dictionary for each collection is the active one.
+	
+	NSMutableDictionary<NSString *, NSData *> *providedDictionaries = [NSMutableDictionary dictionary];
+	
+	char *stmt =
+	  "SELECT \"dictionary_id\", \"collection\", \"trained\", \"data\""
+	  " FROM \"yap_compression_dictionaries\" ORDER BY \"dictionary_id\" ASC;";
+	
+	status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return;
+	}
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		uint32_t dictionaryId = (uint32_t)sqlite3_column_int64(statement, SQLITE_COLUMN_START + 0);
+		
+		const unsigned char *text = sqlite3_column_text(statement, SQLITE_COLUMN_START + 1);
+		int textSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START + 1);
+		
+		NSString *collection = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		BOOL trained = (sqlite3_column_int(statement, SQLITE_COLUMN_START + 2) != 0);
+		
+		const void *blob = sqlite3_column_blob(statement, SQLITE_COLUMN_START + 3);
+		int blobSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START + 3);
+		
+		NSData *dictionary = [NSData dataWithBytes:blob length:blobSize];
+		
+		compressionDictionaries[@(dictionaryId)] = dictionary;
+		activeCompressionDictionaryIds[collection] = @(dictionaryId);
+		
+		if (!trained) {
+			providedDictionaries[collection] = dictionary;
+		}
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_finalize(statement);
+	
+	// Store any dictionaries from the configs that we haven't seen before.
+	// These become the active dictionary for their collection (taking precedence over any trained dictionary).
+	//
+	// An immutable database can't store anything.
+	// But it doesn't need to either, as the stored dictionaries are all that's needed to decompress.
+	
+	if (options.readOnlyImmutable) return;
+	
+	sqlite3_stmt *insertStatement = NULL;
+	
+	for (NSString *collection in compressionConfigs)
+	{
+		NSData *dictionary = compressionConfigs[collection].dictionary;
+		if (dictionary.length == 0) continue;
+		
+		if (dictionary.length > YapDatabaseCompressionMaxDictionarySize)
+		{
+			NSUInteger offset = dictionary.length - YapDatabaseCompressionMaxDictionarySize;
+			dictionary = [dictionary subdataWithRange:NSMakeRange(offset, YapDatabaseCompressionMaxDictionarySize)];
+		}
+		
+		if ([providedDictionaries[collection] isEqualToData:dictionary]) continue;
+		
+		if (insertStatement == NULL)
+		{
+			char *insertStmt =
+			  "INSERT INTO \"yap_compression_dictionaries\" (\"collection\", \"trained\", \"data\") VALUES (?, 0, ?);";
+			
+			status = sqlite3_prepare_v2(db, insertStmt, (int)strlen(insertStmt)+1, &insertStatement, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+				break;
+			}
+		}
+		
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		sqlite3_bind_text(insertStatement, SQLITE_BIND_START + 0, _collection.str, _collection.length, SQLITE_STATIC);
+		sqlite3_bind_blob(insertStatement, SQLITE_BIND_START + 1, dictionary.bytes, (int)dictionary.length, SQLITE_STATIC);
+		
+		status = sqlite3_step(insertStatement);
+		if (status == SQLITE_DONE)
+		{
+			uint32_t dictionaryId = (uint32_t)sqlite3_last_insert_rowid(db);
+			
+			compressionDictionaries[@(dictionaryId)] = dictionary;
+			activeCompressionDictionaryIds[collection] = @(dictionaryId);
+		}
+		else
+		{
+			YDBLogError(@"Error inserting compression dictionary: %d %s", status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_clear_bindings(insertStatement);
+		sqlite3_reset(insertStatement);
+		FreeYapDatabaseString(&_collection);
+	}
+	
+	if (insertStatement) {
+		sqlite3_finalize(insertStatement);
+	}
 }
 
 /**
- * This is a public method called to create a new connection.
+ * Creates the table used to track references to externally stored objects (if needed),
+ * along with the triggers that maintain the reference counts.
+ * 
+ * The triggers are on the primary table, so every write path (including removeAllObjectsInAllCollections)
+ * updates the reference counts within the same (atomic) transaction as the rows themselves.
+ * 
+ * External references are only looked for (during deserialization) if external storage is configured,
+ * or if the database file has been used with external storage in the past.
 **/
-- (YapDatabaseConnection *)newConnection:(YapDatabaseConnectionConfig *)config
+- (void)prepareExternalStorage
 {
-	YapDatabaseConnection *connection = [[YapDatabaseConnection alloc] initWithDatabase:self config:config];
+	BOOL tableExists = [[self class] tableExists:@"yap_external_blobs" using:db];
 	
-	[self addConnection:connection];
-	return connection;
+	if (!tableExists && externalStorageThresholds.count == 0) return;
+	
+	if (options.readOnlyImmutable)
+	{
+		// If the table exists, then so do the triggers (and the blobs directory).
+		// And since nothing is ever removed, there aren't any unreferenced files to sweep.
+		
+		externalStorageEnabled = tableExists;
+		return;
+	}
+	
+	// An external reference is: X'FADBEB' + zero(4) + length(4) + hash(32)
+	
+	#define YAP_EXTERNAL_REFERENCE_MATCH(value) \
+	    " substr(" value ", 1, 3) = X'FADBEB' AND length(" value ") = 43 "
+	
+	#define YAP_EXTERNAL_REFERENCE_HASH(value) \
+	    " substr(" value ", 12, 32) "
+	
+	char *statements[] = {
+		
+		"CREATE TABLE IF NOT EXISTS \"yap_external_blobs\""
+		" (\"hash\" BLOB PRIMARY KEY,"
+		"  \"refcount\" INTEGER NOT NULL"
+		" );",
+		
+		"CREATE INDEX IF NOT EXISTS \"yap_external_blobs_garbage\""
+		" ON \"yap_external_blobs\" (\"refcount\") WHERE \"refcount\" <= 0;",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_external_blobs_insert\""
+		" AFTER INSERT ON \"database2\""
+		" WHEN" YAP_EXTERNAL_REFERENCE_MATCH("new.\"data\"")
+		" BEGIN"
+		"  INSERT OR IGNORE INTO \"yap_external_blobs\" (\"hash\", \"refcount\")"
+		"   VALUES (" YAP_EXTERNAL_REFERENCE_HASH("new.\"data\"") ", 0);"
+		"  UPDATE \"yap_external_blobs\" SET \"refcount\" = \"refcount\" + 1"
+		"   WHERE \"hash\" =" YAP_EXTERNAL_REFERENCE_HASH("new.\"data\"") ";"
+		" END;",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_external_blobs_delete\""
+		" AFTER DELETE ON \"database2\""
+		" WHEN" YAP_EXTERNAL_REFERENCE_MATCH("old.\"data\"")
+		" BEGIN"
+		"  UPDATE \"yap_external_blobs\" SET \"refcount\" = \"refcount\" - 1"
+		"   WHERE \"hash\" =" YAP_EXTERNAL_REFERENCE_HASH("old.\"data\"") ";"
+		" END;",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_external_blobs_update_old\""
+		" AFTER UPDATE OF \"data\" ON \"database2\""
+		" WHEN" YAP_EXTERNAL_REFERENCE_MATCH("old.\"data\"")
+		" BEGIN"
+		"  UPDATE \"yap_external_blobs\" SET \"refcount\" = \"refcount\" - 1"
+		"   WHERE \"hash\" =" YAP_EXTERNAL_REFERENCE_HASH("old.\"data\"") ";"
+		" END;",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_external_blobs_update_new\""
+		" AFTER UPDATE OF \"data\" ON \"database2\""
+		" WHEN" YAP_EXTERNAL_REFERENCE_MATCH("new.\"data\"")
+		" BEGIN"
+		"  INSERT OR IGNORE INTO \"yap_external_blobs\" (\"hash\", \"refcount\")"
+		"   VALUES (" YAP_EXTERNAL_REFERENCE_HASH("new.\"data\"") ", 0);"
+		"  UPDATE \"yap_external_blobs\" SET \"refcount\" = \"refcount\" + 1"
+		"   WHERE \"hash\" =" YAP_EXTERNAL_REFERENCE_HASH("new.\"data\"") ";"
+		" END;"
+	};
+	
+	#undef YAP_EXTERNAL_REFERENCE_MATCH
+	#undef YAP_EXTERNAL_REFERENCE_HASH
+	
+	// With the collection-id schema, "database2" is a view, and the rows live in "database3".
+	
+	for (size_t i = 0; i < (sizeof(statements) / sizeof(statements[0])); i++)
+	{
+		NSString *statement = @(statements[i]);
+		if (usesCollectionIds) {
+			statement = [statement stringByReplacingOccurrencesOfString:@"ON \"database2\""
+			                                                 withString:@"ON \"database3\""];
+		}
+		
+		int status = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed preparing 'yap_external_blobs': %d %s", status, sqlite3_errmsg(db));
+			return;
+		}
+	}
+	
+	externalStorageEnabled = YES;
+	
+	NSString *blobsPath = [self databasePath_blobs];
+	
+	NSError *error = nil;
+	if (![[NSFileManager defaultManager] createDirectoryAtPath:blobsPath
+	                               withIntermediateDirectories:YES
+	                                                attributes:nil
+	                                                     error:&error])
+	{
+		YDBLogError(@"Error creating external storage directory: %@", error);
+	}
+	
+	// Sweep any files that aren't referenced.
+	// These are left behind if the app is terminated before a garbage file is deleted,
+	// or before a rolled back transaction cleans up after itself.
+	// 
+	// Another process may be in the middle of a transaction (which hasn't been committed yet),
+	// so this is skipped when multi-process support is enabled.
+	
+	if (options.enableMultiProcessSupport) return;
+	
+	NSMutableSet<NSString *> *referencedFileNames = [NSMutableSet set];
+	
+	sqlite3_stmt *statement;
+	char *stmt = "SELECT hex(\"hash\") FROM \"yap_external_blobs\";";
+	
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return;
+	}
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		const unsigned char *text = sqlite3_column_text(statement, SQLITE_COLUMN_START);
+		int textSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
+		
+		NSString *fileName = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		if (fileName) {
+			[referencedFileNames addObject:fileName];
+		}
+	}
+	
+	sqlite3_finalize(statement);
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return; // Don't sweep based on partial results
+	}
+	
+	NSArray<NSString *> *fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:blobsPath error:NULL];
+	for (NSString *fileName in fileNames)
+	{
+		if (![referencedFileNames containsObject:fileName])
+		{
+			YDBLogVerbose(@"Deleting unreferenced external blob: %@", fileName);
+			
+			NSString *filePath = [blobsPath stringByAppendingPathComponent:fileName];
+			unlink([filePath fileSystemRepresentation]);
+		}
+	}
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Extensions
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Registers the extension with the database using the given name.
- * After registration everything works automatically using just the extension name.
- * 
- * The registration process is equivalent to a (synchronous) readwrite transaction.
- * It involves persisting various information about the extension to the database,
- * as well as possibly populating the extension by enumerating existing rows in the database.
- *
- * @param extension
- *     The YapDatabaseExtension subclass instance you wish to register.
- *     For example, this might be a YapDatabaseView instance.
+ * Creates the table used to store expiration dates (if needed), along with its index,
+ * and the trigger that removes the expiration date of a removed row.
  * 
- * @param extensionName
- *     This is an arbitrary string you assign to the extension.
- *     Once registered, you will generally access the extension instance via this name.
- *     For example: [[transaction ext:@"myView"] numberOfGroups];
- *
- * @return
- *     YES if the extension was properly registered.
- *     NO if an error occurred, such as the extensionName is already registered.
+ * The table is keyed by rowid, and indexed by expiration date.
+ * So finding the expired rows (in order) doesn't require scanning the collections.
  * 
- * @see asyncRegisterExtension:withName:completionBlock:
- * @see asyncRegisterExtension:withName:completionQueue:completionBlock:
+ * Expired rows are only hidden from reads if expiringCollections is configured,
+ * or if the database file has been used with expiration in the past.
 **/
-- (BOOL)registerExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName
+- (void)prepareExpiration
 {
-	return [self registerExtension:extension withName:extensionName config:nil];
+	BOOL tableExists = [[self class] tableExists:@"yap_expiration" using:db];
+	
+	if (!tableExists && expiringCollections.count == 0) return;
+	
+	if (options.readOnlyImmutable)
+	{
+		expirationEnabled = tableExists;
+		return;
+	}
+	
+	char *statements[] = {
+		
+		"CREATE TABLE IF NOT EXISTS \"yap_expiration\""
+		" (\"rowid\" INTEGER PRIMARY KEY,"
+		"  \"expires\" REAL NOT NULL"
+		" );",
+		
+		"CREATE INDEX IF NOT EXISTS \"yap_expiration_expires\" ON \"yap_expiration\" (\"expires\");",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_expiration_delete\""
+		" AFTER DELETE ON \"database2\""
+		" BEGIN"
+		"  DELETE FROM \"yap_expiration\" WHERE \"rowid\" = old.\"rowid\";"
+		" END;"
+	};
+	
+	// With the collection-id schema, "database2" is a view, and the rows live in "database3".
+	
+	for (size_t i = 0; i < (sizeof(statements) / sizeof(statements[0])); i++)
+	{
+		NSString *statement = @(statements[i]);
+		if (usesCollectionIds) {
+			statement = [statement stringByReplacingOccurrencesOfString:@"ON \"database2\""
+			                                                 withString:@"ON \"database3\""];
+		}
+		
+		int status = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed preparing 'yap_expiration': %d %s", status, sqlite3_errmsg(db));
+			return;
+		}
+	}
+	
+	expirationEnabled = YES;
 }
 
 /**
- * Registers the extension with the database using the given name.
- * After registration everything works automatically using just the extension name.
- *
- * The registration process is equivalent to a (synchronous) readwrite transaction.
- * It involves persisting various information about the extension to the database,
- * as well as possibly populating the extension by enumerating existing rows in the database.
+ * Creates the tables used by cold storage (if needed), along with their triggers.
  * 
- * @param extension (required)
- *     The YapDatabaseExtension subclass instance you wish to register.
- *     For example, this might be a YapDatabaseView instance.
- *
- * @param extensionName (required)
- *     This is an arbitrary string you assign to the extension.
- *     Once registered, you will generally access the extension instance via this name.
- *     For example: [[transaction ext:@"myView"] numberOfGroups];
+ * The "yap_cold_age" table tracks when each (not yet moved) object in a cold collection was last written.
+ * It's keyed by rowid, and indexed by time, so finding the objects to move doesn't require scanning the collections.
  * 
- * @param config (optional)
- *     You may optionally pass a config for the internal databaseConnection used to perform
- *     the extension registration process. This allows you to control things such as the
- *     cache size, which is sometimes important for performance tuning.
+ * The "yap_cold_garbage" table collects the references that were dropped (by removing or overwriting a moved object).
  * 
- * @see asyncRegisterExtension:withName:completionBlock:
- * @see asyncRegisterExtension:withName:completionQueue:completionBlock:
+ * Cold references are only looked for (during deserialization) if coldCollections is configured,
+ * or if the database file has been used with cold storage in the past.
 **/
-- (BOOL)registerExtension:(YapDatabaseExtension *)extension
-                 withName:(NSString *)extensionName
-                   config:(YapDatabaseConnectionConfig *)config
+- (void)prepareColdStorage
 {
-	__block BOOL ready = NO;
-	dispatch_sync(writeQueue, ^{ @autoreleasepool {
-		
-		ready = [self _registerExtension:extension withName:extensionName config:config];
-	}});
+	BOOL tableExists = [[self class] tableExists:@"yap_cold_garbage" using:db];
 	
-	return ready;
-}
-
+	if (!tableExists && coldCollections.count == 0) return;
+	
+	if (options.readOnlyImmutable)
+	{
+		coldStorageEnabled = tableExists;
+		return;
+	}
+	
+	// A cold reference is: X'FADBC0' + zero(4) + length(4) + id(8)
+	// Objects that are already outside the main file (cold or external references) aren't tracked.
+	
+	#define YAP_COLD_REFERENCE_MATCH(value) \
+	    " substr(" value ", 1, 3) = X'FADBC0' AND length(" value ") = 19 "
+	
+	#define YAP_COLD_UNMOVABLE_MATCH(value) \
+	    " substr(" value ", 1, 3) IN (X'FADBC0', X'FADBEB') "
+	
+	#define YAP_COLD_NOW \
+	    " ((julianday('now') - 2440587.5) * 86400.0) "
+	
+	char *statements[] = {
+		
+		"CREATE TABLE IF NOT EXISTS \"yap_cold_garbage\""
+		" (\"reference\" BLOB PRIMARY KEY"
+		" );",
+		
+		"CREATE TABLE IF NOT EXISTS \"yap_cold_age\""
+		" (\"rowid\" INTEGER PRIMARY KEY,"
+		"  \"written\" REAL NOT NULL"
+		" );",
+		
+		"CREATE INDEX IF NOT EXISTS \"yap_cold_age_written\" ON \"yap_cold_age\" (\"written\");",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_cold_garbage_delete\""
+		" AFTER DELETE ON \"database2\""
+		" WHEN" YAP_COLD_REFERENCE_MATCH("old.\"data\"")
+		" BEGIN"
+		"  INSERT OR IGNORE INTO \"yap_cold_garbage\" (\"reference\") VALUES (old.\"data\");"
+		" END;",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_cold_garbage_update\""
+		" AFTER UPDATE OF \"data\" ON \"database2\""
+		" WHEN" YAP_COLD_REFERENCE_MATCH("old.\"data\"") "AND old.\"data\" IS NOT new.\"data\""
+		" BEGIN"
+		"  INSERT OR IGNORE INTO \"yap_cold_garbage\" (\"reference\") VALUES (old.\"data\");"
+		" END;",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_cold_age_delete\""
+		" AFTER DELETE ON \"database2\""
+		" BEGIN"
+		"  DELETE FROM \"yap_cold_age\" WHERE \"rowid\" = old.\"rowid\";"
+		" END;"
+	};
+	
+	// With the collection-id schema, "database2" is a view, and the rows live in "database3".
+	
+	for (size_t i = 0; i < (sizeof(statements) / sizeof(statements[0])); i++)
+	{
+		NSString *statement = @(statements[i]);
+		if (usesCollectionIds) {
+			statement = [statement stringByReplacingOccurrencesOfString:@"ON \"database2\""
+			                                                 withString:@"ON \"database3\""];
+		}
+		
+		int status = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed preparing 'yap_cold_garbage': %d %s", status, sqlite3_errmsg(db));
+			return;
+		}
+	}
+	
+	coldStorageEnabled = YES;
+	
+	// The triggers that track the age depend upon the configured collections.
+	// So they're recreated whenever the configuration changes (and only then, to avoid bumping the schema version).
+	
+	NSString *table = usesCollectionIds ? @"database3" : @"database2";
+	
+	NSString *insertTrigger = nil;
+	NSString *updateTrigger = nil;
+	NSString *rowMatch = nil;
+	
+	if (coldCollections.count > 0)
+	{
+		NSArray<NSString *> *sortedCollections =
+		  [[coldCollections allObjects] sortedArrayUsingSelector:@selector(compare:)];
+		
+		NSMutableArray<NSString *> *quotedCollections = [NSMutableArray arrayWithCapacity:sortedCollections.count];
+		for (NSString *collection in sortedCollections)
+		{
+			NSString *escaped = [collection stringByReplacingOccurrencesOfString:@"'" withString:@"''"];
+			[quotedCollections addObject:[NSString stringWithFormat:@"'%@'", escaped]];
+		}
+		
+		NSString *collectionList = [quotedCollections componentsJoinedByString:@", "];
+		NSString *newMatch = nil;
+		
+		if (usesCollectionIds)
+		{
+			NSString *idList = [NSString stringWithFormat:
+			  @"(SELECT \"collection_id\" FROM \"collections\" WHERE \"collection\" IN (%@))", collectionList];
+			
+			rowMatch = [NSString stringWithFormat:@"\"collection_id\" IN %@", idList];
+			newMatch = [NSString stringWithFormat:@"new.\"collection_id\" IN %@", idList];
+		}
+		else
+		{
+			rowMatch = [NSString stringWithFormat:@"\"collection\" IN (%@)", collectionList];
+			newMatch = [NSString stringWithFormat:@"new.\"collection\" IN (%@)", collectionList];
+		}
+		
+		insertTrigger = [NSString stringWithFormat:
+		  @"CREATE TRIGGER \"yap_cold_age_insert\""
+		  @" AFTER INSERT ON \"%@\""
+		  @" WHEN %@ AND NOT (" YAP_COLD_UNMOVABLE_MATCH("new.\"data\"") @")"
+		  @" BEGIN"
+		  @"  INSERT OR REPLACE INTO \"yap_cold_age\" (\"rowid\", \"written\") VALUES (new.\"rowid\"," YAP_COLD_NOW @");"
+		  @" END", table, newMatch];
+		
+		updateTrigger = [NSString stringWithFormat:
+		  @"CREATE TRIGGER \"yap_cold_age_update\""
+		  @" AFTER UPDATE OF \"data\" ON \"%@\""
+		  @" WHEN %@ AND NOT (" YAP_COLD_UNMOVABLE_MATCH("new.\"data\"") @")"
+		  @" BEGIN"
+		  @"  INSERT OR REPLACE INTO \"yap_cold_age\" (\"rowid\", \"written\") VALUES (new.\"rowid\"," YAP_COLD_NOW @");"
+		  @" END", table, newMatch];
+	}
+	
+	NSString *existingInsertTrigger = [[self class] sqlForTrigger:@"yap_cold_age_insert" using:db];
+	NSString *existingUpdateTrigger = [[self class] sqlForTrigger:@"yap_cold_age_update" using:db];
+	
+	if ((existingInsertTrigger == insertTrigger || [existingInsertTrigger isEqualToString:insertTrigger]) &&
+	    (existingUpdateTrigger == updateTrigger || [existingUpdateTrigger isEqualToString:updateTrigger]))
+	{
+		// Unchanged
+		return;
+	}
+	
+	NSMutableArray<NSString *> *statementStrings = [NSMutableArray arrayWithCapacity:6];
+	
+	[statementStrings addObject:@"DROP TRIGGER IF EXISTS \"yap_cold_age_insert\";"];
+	[statementStrings addObject:@"DROP TRIGGER IF EXISTS \"yap_cold_age_update\";"];
+	
+	if (coldCollections.count == 0)
+	{
+		[statementStrings addObject:@"DELETE FROM \"yap_cold_age\";"];
+	}
+	else
+	{
+		// Forget the rows of collections that are no longer cold.
+		
+		[statementStrings addObject:[NSString stringWithFormat:
+		  @"DELETE FROM \"yap_cold_age\" WHERE \"rowid\" NOT IN (SELECT \"rowid\" FROM \"%@\" WHERE %@);",
+		  table, rowMatch]];
+		
+		[statementStrings addObject:[insertTrigger stringByAppendingString:@";"]];
+		[statementStrings addObject:[updateTrigger stringByAppendingString:@";"]];
+		
+		// Rows that existed before the collection was configured are considered written now.
+		// (The rowid check comes first, so the data of rows that are already tracked isn't read.)
+		
+		[statementStrings addObject:[NSString stringWithFormat:
+		  @"INSERT OR IGNORE INTO \"yap_cold_age\" (\"rowid\", \"written\")"
+		  @" SELECT \"rowid\"," YAP_COLD_NOW @" FROM \"%@\""
+		  @" WHERE %@ AND \"rowid\" NOT IN (SELECT \"rowid\" FROM \"yap_cold_age\")"
+		  @" AND NOT (" YAP_COLD_UNMOVABLE_MATCH("\"data\"") @");", table, rowMatch]];
+	}
+	
+	#undef YAP_COLD_REFERENCE_MATCH
+	#undef YAP_COLD_UNMOVABLE_MATCH
+	#undef YAP_COLD_NOW
+	
+	for (NSString *statement in statementStrings)
+	{
+		int status = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed preparing 'yap_cold_age': %d %s", status, sqlite3_errmsg(db));
+			return;
+		}
+	}
+}
+
 /**
- * Asynchronoulsy starts the extension registration process.
- * After registration everything works automatically using just the extension name.
+ * Creates the table used to skip identical writes (if needed), along with its triggers.
  * 
- * The registration process is equivalent to an asyncReadwrite transaction.
- * It involves persisting various information about the extension to the database,
- * as well as possibly populating the extension by enumerating existing rows in the database.
+ * The "yap_content_hash" table stores the hash of the serialized object & metadata of rows in contentHashedCollections.
+ * It's only written by setObject:... (which compares against it first).
+ * Any other change to the data or metadata of a row (from any code path, or another process) deletes the hash,
+ * via the triggers, so a stale hash can never cause a write to be skipped.
  * 
- * @param extension (required)
- *     The YapDatabaseExtension subclass instance you wish to register.
- *     For example, this might be a YapDatabaseView instance.
- *
- * @param extensionName (required)
- *     This is an arbitrary string you assign to the extension.
- *     Once registered, you will generally access the extension instance via this name.
- *     For example: [[transaction ext:@"myView"] numberOfGroups];
- *
- * @param completionBlock (optional)
- *     An optional completion block may be used.
- *     If the extension registration was successful then the ready parameter will be YES.
- *     The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+ * If contentHashedCollections is no longer configured, the table & triggers are dropped.
 **/
-- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
-                      withName:(NSString *)extensionName
-               completionBlock:(void(^)(BOOL ready))completionBlock
+- (void)prepareContentHashes
 {
-	[self asyncRegisterExtension:extension
-	                    withName:extensionName
-	                      config:nil
-	             completionQueue:NULL
-	             completionBlock:completionBlock];
+	if (options.readOnlyImmutable) return;
+	
+	BOOL tableExists = [[self class] tableExists:@"yap_content_hash" using:db];
+	
+	if (contentHashedCollections.count == 0)
+	{
+		if (!tableExists) return;
+		
+		char *statements[] = {
+			"DROP TRIGGER IF EXISTS \"yap_content_hash_update\";",
+			"DROP TRIGGER IF EXISTS \"yap_content_hash_delete\";",
+			"DROP TABLE IF EXISTS \"yap_content_hash\";"
+		};
+		
+		for (size_t i = 0; i < (sizeof(statements) / sizeof(statements[0])); i++)
+		{
+			int status = sqlite3_exec(db, statements[i], NULL, NULL, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Failed dropping 'yap_content_hash': %d %s", status, sqlite3_errmsg(db));
+				return;
+			}
+		}
+		
+		return;
+	}
+	
+	char *statements[] = {
+		
+		"CREATE TABLE IF NOT EXISTS \"yap_content_hash\""
+		" (\"rowid\" INTEGER PRIMARY KEY,"
+		"  \"data_hash\" INTEGER NOT NULL,"
+		"  \"metadata_hash\" INTEGER"
+		" );",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_content_hash_update\""
+		" AFTER UPDATE OF \"data\", \"metadata\" ON \"database2\""
+		" BEGIN"
+		"  DELETE FROM \"yap_content_hash\" WHERE \"rowid\" = old.\"rowid\";"
+		" END;",
+		
+		"CREATE TRIGGER IF NOT EXISTS \"yap_content_hash_delete\""
+		" AFTER DELETE ON \"database2\""
+		" BEGIN"
+		"  DELETE FROM \"yap_content_hash\" WHERE \"rowid\" = old.\"rowid\";"
+		" END;"
+	};
+	
+	// With the collection-id schema, "database2" is a view, and the rows live in "database3".
+	
+	for (size_t i = 0; i < (sizeof(statements) / sizeof(statements[0])); i++)
+	{
+		NSString *statement = @(statements[i]);
+		if (usesCollectionIds) {
+			statement = [statement stringByReplacingOccurrencesOfString:@"ON \"database2\""
+			                                                 withString:@"ON \"database3\""];
+		}
+		
+		int status = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Failed preparing 'yap_content_hash': %d %s", status, sqlite3_errmsg(db));
+			return;
+		}
+	}
+	
+	contentHashEnabled = YES;
 }
 
 /**
- * Asynchronoulsy starts the extension registration process.
- * After registration everything works automatically using just the extension name.
- *
- * The registration process is equivalent to an asyncReadwrite transaction.
- * It involves persisting various information about the extension to the database,
- * as well as possibly populating the extension by enumerating existing rows in the database.
+ * Creates the index on native metadata (if needed).
  * 
- * @param extension (required)
- *     The YapDatabaseExtension subclass instance you wish to register.
- *     For example, this might be a YapDatabaseView instance.
- *
- * @param extensionName (required)
- *     This is an arbitrary string you assign to the extension.
- *     Once registered, you will generally access the extension instance via this name.
- *     For example: [[transaction ext:@"myView"] numberOfGroups];
- *
- * @param completionQueue (optional)
- *     The dispatch_queue to invoke the completion block may optionally be specified.
- *     If NULL, dispatch_get_main_queue() is automatically used.
- *
- * @param completionBlock (optional)
- *     An optional completion block may be used.
- *     If the extension registration was successful then the ready parameter will be YES.
+ * It's a partial index, containing only the rows whose metadata is stored natively.
+ * Queries must therefore include the same condition (typeof("metadata") IN (...)) in order to use it.
+ * 
+ * @see YapDatabaseOptions.nativeMetadataTypes
+**/
+- (void)prepareNativeMetadata
+{
+	if (nativeMetadataTypes == nil) return;
+	if (options.readOnlyImmutable) return;
+	
+	NSString *statement = usesCollectionIds
+	  ? @"CREATE INDEX IF NOT EXISTS \"yap_native_metadata\" ON \"database3\" (\"collection_id\", \"metadata\")"
+	    @" WHERE typeof(\"metadata\") IN ('integer', 'real', 'text');"
+	  : @"CREATE INDEX IF NOT EXISTS \"yap_native_metadata\" ON \"database2\" (\"collection\", \"metadata\")"
+	    @" WHERE typeof(\"metadata\") IN ('integer', 'real', 'text');";
+	
+	int status = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Failed creating 'yap_native_metadata' index: %d %s", status, sqlite3_errmsg(db));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Compression
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSData *)compressionDictionaryWithId:(uint32_t)dictionaryId
+{
+	NSData *dictionary = nil;
+	
+	YAPUnfairLockLock(&compressionLock);
+	{
+		dictionary = compressionDictionaries[@(dictionaryId)];
+	}
+	YAPUnfairLockUnlock(&compressionLock);
+	
+	return dictionary;
+}
+
+- (NSData *)activeCompressionDictionaryForCollection:(NSString *)collection dictionaryId:(uint32_t *)dictionaryIdPtr
+{
+	NSNumber *dictionaryId = nil;
+	NSData *dictionary = nil;
+	
+	YAPUnfairLockLock(&compressionLock);
+	{
+		dictionaryId = activeCompressionDictionaryIds[collection];
+		if (dictionaryId) {
+			dictionary = compressionDictionaries[dictionaryId];
+		}
+	}
+	YAPUnfairLockUnlock(&compressionLock);
+	
+	if (dictionaryIdPtr) *dictionaryIdPtr = dictionary ? [dictionaryId unsignedIntValue] : 0;
+	return dictionary;
+}
+
+- (void)didInsertCompressionDictionary:(NSData *)dictionary
+                                withId:(uint32_t)dictionaryId
+                         forCollection:(NSString *)collection
+{
+	YAPUnfairLockLock(&compressionLock);
+	{
+		compressionDictionaries[@(dictionaryId)] = [dictionary copy];
+		activeCompressionDictionaryIds[collection] = @(dictionaryId);
+	}
+	YAPUnfairLockUnlock(&compressionLock);
+}
+
+/**
+ * Invoked (via YapDatabaseCompressObject) for every serialized object that's about to be written.
+**/
+- (NSData *)compressSerializedObject:(NSData *)serializedObject inCollection:(NSString *)collection
+{
+	YapDatabaseCompressionConfig *config = compressionConfigs[collection];
+	if (config && config.algorithm != YapDatabaseCompressionAlgorithmNone)
+	{
+		uint32_t dictionaryId = 0;
+		NSData *dictionary = [self activeCompressionDictionaryForCollection:collection dictionaryId:&dictionaryId];
+		
+		NSData *compressed = YapDatabaseCompressData(serializedObject, config, dictionaryId, dictionary);
+		if (compressed) {
+			return compressed;
+		}
+	}
+	
+	// Stored as-is.
+	// Unless it happens to look like a compressed row, in which case we need to wrap it.
+	
+	if (YapDatabaseCompressionHasHeader(serializedObject.bytes, serializedObject.length))
+		return YapDatabaseCompressionWrapData(serializedObject);
+	else
+		return serializedObject;
+}
+
+/**
+ * Invoked (via YapDatabaseDeserializeObject) for every compressed row that's read.
+**/
+- (const void *)decompressBytes:(const void *)bytes
+                         length:(size_t)length
+             decompressedLength:(size_t *)decompressedLengthPtr
+{
+	YapDatabaseCompressionAlgorithm algorithm = YapDatabaseCompressionAlgorithmNone;
+	uint32_t dictionaryId = 0;
+	
+	YapDatabaseCompressionReadHeader(bytes, length, &algorithm, &dictionaryId, NULL);
+	
+	NSData *dictionary = nil;
+	if (dictionaryId != 0)
+	{
+		dictionary = [self compressionDictionaryWithId:dictionaryId];
+		if (dictionary == nil)
+		{
+			// This may happen if another process trained a new dictionary (with enableMultiProcessSupport).
+			// The dictionary will be loaded the next time the database is opened.
+			
+			YDBLogError(@"Unable to decompress row: unknown compression dictionary (%u)", dictionaryId);
+			return NULL;
+		}
+	}
+	
+	const void *result = YapDatabaseDecompressBytes(bytes, length, dictionary, decompressedLengthPtr);
+	if (result == NULL)
+	{
+		YDBLogError(@"Unable to decompress row: algorithm(%d) dictionary(%u)", (int)algorithm, dictionaryId);
+	}
+	
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark External Storage
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (BOOL)writeExternalBlob:(NSData *)blob withFileName:(NSString *)fileName created:(BOOL *)createdPtr
+{
+	NSString *path = [[self databasePath_blobs] stringByAppendingPathComponent:fileName];
+	BOOL created = NO;
+	BOOL result = YES;
+	
+	// The lock is held while writing, so a pending deletion for the same file can't race with us.
+	// (Identical content => identical file name.)
+	
+	YAPUnfairLockLock(&externalStorageLock);
+	{
+		[pendingExternalBlobDeletions removeObjectForKey:fileName];
+		
+		if (access([path fileSystemRepresentation], F_OK) != 0)
+		{
+			result = YapDatabaseExternalBlobWrite(path, blob);
+			created = result;
+		}
+	}
+	YAPUnfairLockUnlock(&externalStorageLock);
+	
+	if (createdPtr) *createdPtr = created;
+	return result;
+}
+
+- (NSData *)externalBlobWithReference:(const void *)reference
+{
+	NSString *fileName = YapDatabaseExternalReferenceFileName(reference);
+	NSString *path = [[self databasePath_blobs] stringByAppendingPathComponent:fileName];
+	
+	NSError *error = nil;
+	NSData *blob = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:&error];
+	
+	if (blob == nil)
+	{
+		YDBLogError(@"Unable to read external blob: %@ (%@)", fileName, error);
+		return nil;
+	}
+	
+	if (blob.length != YapDatabaseExternalReferenceLength(reference))
+	{
+		YDBLogError(@"External blob has unexpected length: %@ (expected %u, found %lu)", fileName,
+		            YapDatabaseExternalReferenceLength(reference), (unsigned long)blob.length);
+		return nil;
+	}
+	
+	return blob;
+}
+
+- (void)deleteExternalBlobsWithFileNames:(NSArray<NSString *> *)fileNames
+{
+	NSString *blobsPath = [self databasePath_blobs];
+	
+	YAPUnfairLockLock(&externalStorageLock);
+	{
+		for (NSString *fileName in fileNames)
+		{
+			NSString *path = [blobsPath stringByAppendingPathComponent:fileName];
+			unlink([path fileSystemRepresentation]);
+		}
+	}
+	YAPUnfairLockUnlock(&externalStorageLock);
+}
+
+- (void)noteUnreferencedExternalBlobs:(NSArray<NSString *> *)fileNames atSnapshot:(uint64_t)garbageSnapshot
+{
+	// With multi-process support, another process may be in the middle of storing an identical object.
+	// And we have no way to coordinate with it. So we leave the files in place.
+	
+	if (options.enableMultiProcessSupport) return;
+	
+	YAPUnfairLockLock(&externalStorageLock);
+	{
+		for (NSString *fileName in fileNames)
+		{
+			pendingExternalBlobDeletions[fileName] = @(garbageSnapshot);
+		}
+	}
+	YAPUnfairLockUnlock(&externalStorageLock);
+}
+
+/**
+ * Deletes the unreferenced files that are no longer visible to any connection.
+ * That is, every connection is at or past the snapshot in which the file became unreferenced.
+**/
+- (void)asyncDeleteExternalBlobs:(uint64_t)maxCheckpointableSnapshot
+{
+	if (!externalStorageEnabled) return;
+	
+	BOOL hasPendingDeletions = NO;
+	
+	YAPUnfairLockLock(&externalStorageLock);
+	{
+		hasPendingDeletions = (pendingExternalBlobDeletions.count > 0);
+	}
+	YAPUnfairLockUnlock(&externalStorageLock);
+	
+	if (!hasPendingDeletions) return;
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_async(externalStorageQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		NSString *blobsPath = [strongSelf databasePath_blobs];
+		
+		YAPUnfairLockLock(&strongSelf->externalStorageLock);
+		{
+			NSMutableArray<NSString *> *deletedFileNames = [NSMutableArray array];
+			
+			[strongSelf->pendingExternalBlobDeletions enumerateKeysAndObjectsUsingBlock:
+			    ^(NSString *fileName, NSNumber *garbageSnapshot, BOOL __unused *stop)
+			{
+				if ([garbageSnapshot unsignedLongLongValue] <= maxCheckpointableSnapshot)
+				{
+					NSString *path = [blobsPath stringByAppendingPathComponent:fileName];
+					unlink([path fileSystemRepresentation]);
+					
+					[deletedFileNames addObject:fileName];
+				}
+			}];
+			
+			[strongSelf->pendingExternalBlobDeletions removeObjectsForKeys:deletedFileNames];
+		}
+		YAPUnfairLockUnlock(&strongSelf->externalStorageLock);
+	}});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Cold Storage
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the (open) cold storage file, opening it if needed.
+ * Every access pushes back the point at which the file is closed again.
+ * 
+ * Must be invoked on the coldStorageQueue.
+**/
+- (sqlite3 *)coldStorageDb
+{
+	if (coldDb == NULL)
+	{
+		NSString *path = [self databasePath_cold];
+		NSString *filename = path;
+		
+		int flags = (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE);
+		
+		if (options.readOnlyImmutable)
+		{
+			filename = [[[NSURL fileURLWithPath:path] absoluteString] stringByAppendingString:@"?immutable=1"];
+			flags = [self sqliteOpenFlags:flags];
+		}
+		
+		int status = sqlite3_open_v2([filename UTF8String], &coldDb, flags, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error opening cold storage: %d %s", status, (coldDb ? sqlite3_errmsg(coldDb) : "?"));
+			
+			if (coldDb) sqlite3_close(coldDb);
+			coldDb = NULL;
+			return NULL;
+		}
+		
+		BOOL configured = YES;
+		
+	#ifdef SQLITE_HAS_CODEC
+		// The cold file holds objects from the database, so it's encrypted in the same manner.
+		configured = [self configureEncryptionForDatabase:coldDb];
+	#endif
+		
+		if (configured) {
+			configured = YapDatabaseColdStorageSetup(coldDb, options.readOnlyImmutable);
+		}
+		
+		if (!configured)
+		{
+			sqlite3_close(coldDb);
+			coldDb = NULL;
+			return NULL;
+		}
+		
+		YDBLogVerbose(@"Opened cold storage: %@", [path lastPathComponent]);
+	}
+	
+	coldDbLastAccessTime = [NSDate timeIntervalSinceReferenceDate];
+	[self scheduleColdStorageCloseAfter:options.coldStorageIdleInterval];
+	
+	return coldDb;
+}
+
+/**
+ * Closes the cold storage file once it's been idle for the coldStorageIdleInterval.
+ * There's never more than a single close pending.
+ * 
+ * Must be invoked on the coldStorageQueue.
+**/
+- (void)scheduleColdStorageCloseAfter:(NSTimeInterval)delayInSeconds
+{
+	if (coldDbCloseScheduled) return;
+	coldDbCloseScheduled = YES;
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MAX(delayInSeconds, 0.0) * NSEC_PER_SEC));
+	dispatch_after(popTime, coldStorageQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		strongSelf->coldDbCloseScheduled = NO;
+		if (strongSelf->coldDb == NULL) return;
+		
+		NSTimeInterval idleInterval = strongSelf->options.coldStorageIdleInterval;
+		NSTimeInterval idle = [NSDate timeIntervalSinceReferenceDate] - strongSelf->coldDbLastAccessTime;
+		
+		if (idle < idleInterval)
+		{
+			[strongSelf scheduleColdStorageCloseAfter:(idleInterval - idle)];
+		}
+		else
+		{
+			sqlite3_close(strongSelf->coldDb);
+			strongSelf->coldDb = NULL;
+			
+			YDBLogVerbose(@"Closed cold storage (idle)");
+		}
+	}});
+}
+
+- (NSArray<NSNumber *> *)writeColdBlobs:(NSArray<NSData *> *)blobs
+{
+	__block NSArray<NSNumber *> *blobIds = nil;
+	
+	dispatch_sync(coldStorageQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		sqlite3 *cold = [self coldStorageDb];
+		if (cold) {
+			blobIds = YapDatabaseColdStorageInsert(cold, blobs);
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	return blobIds;
+}
+
+- (NSData *)coldBlobWithReference:(const void *)reference
+{
+	int64_t blobId = YapDatabaseColdReferenceBlobId(reference);
+	__block NSData *blob = nil;
+	
+	dispatch_sync(coldStorageQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		sqlite3 *cold = [self coldStorageDb];
+		if (cold) {
+			blob = YapDatabaseColdStorageRead(cold, blobId);
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	if (blob == nil)
+	{
+		YDBLogError(@"Unable to read cold blob: %lld", blobId);
+		return nil;
+	}
+	
+	if (blob.length != YapDatabaseColdReferenceLength(reference))
+	{
+		YDBLogError(@"Cold blob has unexpected length: %lld (expected %u, found %lu)", blobId,
+		            YapDatabaseColdReferenceLength(reference), (unsigned long)blob.length);
+		return nil;
+	}
+	
+	return blob;
+}
+
+- (void)deleteColdBlobsWithIds:(NSArray<NSNumber *> *)blobIds
+{
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_async(coldStorageQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		sqlite3 *cold = [strongSelf coldStorageDb];
+		if (cold) {
+			YapDatabaseColdStorageDelete(cold, blobIds);
+		}
+	}});
+}
+
+- (void)noteUnreferencedColdBlobs:(NSArray<NSNumber *> *)blobIds atSnapshot:(uint64_t)garbageSnapshot
+{
+	// With multi-process support, another process may still be reading an older snapshot.
+	// And we have no way to coordinate with it. So we leave the blobs in place.
+	
+	if (options.enableMultiProcessSupport) return;
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_async(coldStorageQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		for (NSNumber *blobId in blobIds)
+		{
+			strongSelf->pendingColdBlobDeletions[blobId] = @(garbageSnapshot);
+		}
+	}});
+}
+
+/**
+ * Deletes the unreferenced blobs that are no longer visible to any connection.
+ * That is, every connection is at or past the snapshot in which the blob became unreferenced.
+**/
+- (void)asyncDeleteColdBlobs:(uint64_t)maxCheckpointableSnapshot
+{
+	if (!coldStorageEnabled) return;
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_async(coldStorageQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		if (strongSelf->pendingColdBlobDeletions.count == 0) return;
+		
+		NSMutableArray<NSNumber *> *deletedBlobIds = [NSMutableArray array];
+		
+		[strongSelf->pendingColdBlobDeletions enumerateKeysAndObjectsUsingBlock:
+		    ^(NSNumber *blobId, NSNumber *garbageSnapshot, BOOL __unused *stop)
+		{
+			if ([garbageSnapshot unsignedLongLongValue] <= maxCheckpointableSnapshot)
+			{
+				[deletedBlobIds addObject:blobId];
+			}
+		}];
+		
+		if (deletedBlobIds.count == 0) return;
+		
+		sqlite3 *cold = [strongSelf coldStorageDb];
+		if (cold)
+		{
+			YapDatabaseColdStorageDelete(cold, deletedBlobIds);
+			[strongSelf->pendingColdBlobDeletions removeObjectsForKeys:deletedBlobIds];
+		}
+	}});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Defaults
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (YapDatabaseConnectionConfig *)connectionDefaults
+{
+	return connectionDefaults;
+}
+
+- (BOOL)defaultObjectCacheEnabled
+{
+	return connectionDefaults.objectCacheEnabled;
+}
+
+- (void)setDefaultObjectCacheEnabled:(BOOL)defaultObjectCacheEnabled
+{
+	connectionDefaults.objectCacheEnabled = defaultObjectCacheEnabled;
+}
+
+- (NSUInteger)defaultObjectCacheLimit
+{
+	return connectionDefaults.objectCacheLimit;
+}
+
+- (void)setDefaultObjectCacheLimit:(NSUInteger)defaultObjectCacheLimit
+{
+	connectionDefaults.objectCacheLimit = defaultObjectCacheLimit;
+}
+
+- (BOOL)defaultMetadataCacheEnabled
+{
+	return connectionDefaults.metadataCacheEnabled;
+}
+
+- (void)setDefaultMetadataCacheEnabled:(BOOL)defaultMetadataCacheEnabled
+{
+	connectionDefaults.metadataCacheEnabled = defaultMetadataCacheEnabled;
+}
+
+- (NSUInteger)defaultMetadataCacheLimit
+{
+	return connectionDefaults.metadataCacheLimit;
+}
+
+- (void)setDefaultMetadataCacheLimit:(NSUInteger)defaultMetadataCacheLimit
+{
+	connectionDefaults.metadataCacheLimit = defaultMetadataCacheLimit;
+}
+
+- (YapDatabasePolicy)defaultObjectPolicy
+{
+	return connectionDefaults.objectPolicy;
+}
+
+- (void)setDefaultObjectPolicy:(YapDatabasePolicy)defaultObjectPolicy
+{
+	connectionDefaults.objectPolicy = defaultObjectPolicy;
+}
+
+- (YapDatabasePolicy)defaultMetadataPolicy
+{
+	return connectionDefaults.metadataPolicy;
+}
+
+- (void)setDefaultMetadataPolicy:(YapDatabasePolicy)defaultMetadataPolicy
+{
+	connectionDefaults.metadataPolicy = defaultMetadataPolicy;
+}
+
+#if TARGET_OS_IOS || TARGET_OS_TV
+
+- (YapDatabaseConnectionFlushMemoryFlags)defaultAutoFlushMemoryFlags
+{
+	return connectionDefaults.autoFlushMemoryFlags;
+}
+
+- (void)setDefaultAutoFlushMemoryFlags:(YapDatabaseConnectionFlushMemoryFlags)defaultAutoFlushMemoryFlags
+{
+	connectionDefaults.autoFlushMemoryFlags = defaultAutoFlushMemoryFlags;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Connections
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * This method is called from [self newConnection].
+**/
+- (void)addConnection:(YapDatabaseConnection *)connection
+{
+	// We can asynchronously add the connection to the state table.
+	// This is safe as the connection itself must go through the same queue in order to do anything.
+	//
+	// The primary motivation in adding the asynchronous functionality is due to the following common use case:
+	//
+	// YapDatabase *database = [[YapDatabase alloc] initWithPath:path];
+	// YapDatabaseConnection *databaseConnection = [database newConnection];
+	//
+	// The YapDatabase init method is asynchronously preparing itself through the snapshot queue.
+	// We'd like to avoid blocking the very next line of code and allow the asynchronous prepare to continue.
+	
+	dispatch_async(connection->connectionQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		dispatch_sync(snapshotQueue, ^{ @autoreleasepool {
+			
+			// Add the connection to the state table
+			
+			YapDatabaseConnectionState *state = [[YapDatabaseConnectionState alloc] initWithConnection:connection];
+			[connectionStates addObject:state];
+			
+			YDBLogVerbose(@"Created new connection(%p) for <%@ %p: databaseName=%@, connectionCount=%lu>",
+			              connection, [self class], self, [databasePath lastPathComponent],
+			              (unsigned long)[connectionStates count]);
+			
+			[self updatePageCacheShare];
+			
+			// Invoke the one-time prepare method, so the connection can perform any needed initialization.
+			// Be sure to do this within the snapshotQueue, as the prepare method depends on this.
+			
+			[connection prepare];
+		}});
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+/**
+ * This method is called from YapDatabaseConnection's dealloc method.
+**/
+- (void)removeConnection:(YapDatabaseConnection *)connection
+{
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		NSUInteger index = 0;
+		for (YapDatabaseConnectionState *state in connectionStates)
+		{
+			if (state->connection == connection)
+			{
+				[connectionStates removeObjectAtIndex:index];
+				break;
+			}
+			
+			index++;
+		}
+		
+		YDBLogVerbose(@"Removed connection(%p) from <%@ %p: databaseName=%@, connectionCount=%lu>",
+		              connection, [self class], self, [databasePath lastPathComponent],
+		              (unsigned long)[connectionStates count]);
+		
+		[self updatePageCacheShare];
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	// We prefer to invoke this method synchronously.
+	//
+	// The connection may be the last object retaining the database.
+	// It's easier to trace object deallocations when they happen in a predictable order.
+	
+	if (dispatch_get_specific(IsOnSnapshotQueueKey))
+		block();
+	else
+		dispatch_sync(snapshotQueue, block);
+}
+
+/**
+ * The smallest page cache a connection is given (when a pageCacheBudget is configured).
+**/
+#define YAP_PAGE_CACHE_MIN_SHARE (64 * 1024)
+
+/**
+ * Divides the pageCacheBudget among the open connections.
+ * Each connection adopts its share (via "PRAGMA cache_size") at the start of its next transaction.
+ * 
+ * This method must be invoked within the snapshotQueue.
+**/
+- (void)updatePageCacheShare
+{
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	
+	if (options.pageCacheBudget == 0) return;
+	
+	NSUInteger connectionCount = MAX((NSUInteger)1, [connectionStates count]);
+	uint64_t share = MAX((uint64_t)(options.pageCacheBudget / connectionCount), (uint64_t)YAP_PAGE_CACHE_MIN_SHARE);
+	
+	atomic_store(&pageCacheShare, share);
+}
+
+/**
+ * This is a public method called to create a new connection.
+**/
+- (YapDatabaseConnection *)newConnection
+{
+	YapDatabaseConnection *connection = [[YapDatabaseConnection alloc] initWithDatabase:self];
+	
+	[self addConnection:connection];
+	return connection;
+}
+
+/**
+ * This is a public method called to create a new connection.
+**/
+- (YapDatabaseConnection *)newConnection:(YapDatabaseConnectionConfig *)config
+{
+	YapDatabaseConnection *connection = [[YapDatabaseConnection alloc] initWithDatabase:self config:config];
+	
+	[self addConnection:connection];
+	return connection;
+}
+
+/**
+ * This is a public method called to generate a memory report.
+**/
+- (YapDatabaseMemoryReport *)memoryReport
+{
+	NSMutableArray<YapDatabaseConnection *> *connections = [NSMutableArray array];
+	__block NSDictionary *memoryTables = nil;
+	
+	dispatch_sync(snapshotQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		for (YapDatabaseConnectionState *state in connectionStates)
+		{
+			__strong YapDatabaseConnection *connection = state->connection;
+			if (connection) {
+				[connections addObject:connection];
+			}
+		}
+		
+		memoryTables = registeredMemoryTables;
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	// Each connection report is generated on the connection's own queue (outside of the snapshotQueue).
+	
+	NSMutableArray<YapDatabaseMemoryReport *> *reports = [NSMutableArray arrayWithCapacity:([connections count] + 1)];
+	for (YapDatabaseConnection *connection in connections)
+	{
+		[reports addObject:[connection memoryReport]];
+	}
+	
+	uint64_t memoryTableBytes = 0;
+	for (YapMemoryTable *memoryTable in [memoryTables objectEnumerator])
+	{
+		memoryTableBytes += [memoryTable estimatedMemoryUsage];
+	}
+	
+	NSMutableDictionary<NSString *, NSNumber *> *components = [NSMutableDictionary dictionaryWithCapacity:2];
+	components[YapDatabaseMemoryComponentMemoryTables] = @(memoryTableBytes);
+	
+	if (sharedObjectCache) {
+		components[YapDatabaseMemoryComponentSharedObjectCache] = @([sharedObjectCache estimatedMemoryUsage]);
+	}
+	
+	[reports addObject:[[YapDatabaseMemoryReport alloc] initWithComponents:components]];
+	
+	return [YapDatabaseMemoryReport reportByMergingReports:reports];
+}
+
+/**
+ * This is a public method called to sample the database statistics.
+**/
+- (YapDatabaseStatistics *)statistics
+{
+	NSMutableArray<YapDatabaseConnection *> *connections = [NSMutableArray array];
+	__block uint64_t currentSnapshot = 0;
+	__block NSUInteger changesetBacklog = 0;
+	
+	dispatch_sync(snapshotQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		for (YapDatabaseConnectionState *state in connectionStates)
+		{
+			__strong YapDatabaseConnection *connection = state->connection;
+			if (connection) {
+				[connections addObject:connection];
+			}
+		}
+		
+		currentSnapshot = snapshot;
+		changesetBacklog = [changesets count];
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	// Each connection is sampled on the connection's own queue (outside of the snapshotQueue).
+	
+	NSMutableArray<YapDatabaseConnectionStatistics *> *connectionStatistics =
+	  [NSMutableArray arrayWithCapacity:[connections count]];
+	
+	for (YapDatabaseConnection *connection in connections)
+	{
+		[connectionStatistics addObject:[connection statistics]];
+	}
+	
+	NSDictionary *walAttributes =
+	  [[NSFileManager defaultManager] attributesOfItemAtPath:[self databasePath_wal] error:NULL];
+	NSDictionary *databaseAttributes =
+	  [[NSFileManager defaultManager] attributesOfItemAtPath:databasePath error:NULL];
+	
+	return [[YapDatabaseStatistics alloc] initWithSnapshot:currentSnapshot
+	                                               walSize:[walAttributes fileSize]
+	                                          databaseSize:[databaseAttributes fileSize]
+	                                      changesetBacklog:changesetBacklog
+	                                           connections:connectionStatistics];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Parallel Enumeration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The number of rowid ranges per worker.
+ * Using more ranges than workers balances the load when the rowids of the collection aren't evenly distributed.
+**/
+#define PARALLEL_ENUMERATION_RANGES_PER_WORKER 4
+
+/**
+ * This is a public method called to scan a collection across multiple connections.
+**/
+- (void)parallelEnumerateCollection:(NSString *)collection
+                            workers:(NSUInteger)workerCount
+                              block:(void (^)(NSString *key, id object, id metadata, BOOL *stop))block
+{
+	NSAssert(!dispatch_get_specific(IsOnWriteQueueKey), @"Cannot be invoked from within a transaction.");
+	
+	if (block == NULL) return;
+	if (collection == nil) collection = @"";
+	if (workerCount == 0) workerCount = [[NSProcessInfo processInfo] activeProcessorCount];
+	
+	// Create a dedicated connection for each worker.
+	// A full scan would only evict everything else from the caches, so they're disabled.
+	
+	NSMutableArray<YapDatabaseConnection *> *connections = [NSMutableArray arrayWithCapacity:workerCount];
+	for (NSUInteger i = 0; i < workerCount; i++)
+	{
+		YapDatabaseConnection *connection = [self newConnection];
+		connection.objectCacheEnabled = NO;
+		connection.metadataCacheEnabled = NO;
+		connection.name = [NSString stringWithFormat:@"parallelEnumerateCollection-%lu", (unsigned long)i];
+		
+		[connections addObject:connection];
+	}
+	
+	// Pin every connection to the same snapshot.
+	//
+	// Beginning the long-lived read transactions from within the writeQueue ensures that
+	// no (in-process) commit can occur in between them.
+	// But another process may still commit in between (with enableMultiProcessSupport),
+	// in which case we simply try again.
+	
+	BOOL sameSnapshot = NO;
+	do
+	{
+		dispatch_sync(writeQueue, ^{ @autoreleasepool {
+			
+			for (YapDatabaseConnection *connection in connections)
+			{
+				[connection beginLongLivedReadTransaction];
+			}
+		}});
+		
+		uint64_t firstSnapshot = [connections[0] snapshot];
+		
+		sameSnapshot = YES;
+		for (YapDatabaseConnection *connection in connections)
+		{
+			if ([connection snapshot] != firstSnapshot)
+			{
+				sameSnapshot = NO;
+				break;
+			}
+		}
+		
+		if (!sameSnapshot)
+		{
+			YDBLogVerbose(@"parallelEnumerateCollection: snapshot changed while pinning, retrying...");
+			
+			for (YapDatabaseConnection *connection in connections)
+			{
+				[connection endLongLivedReadTransaction];
+			}
+		}
+		
+	} while (!sameSnapshot);
+	
+	// Partition the rowid range of the collection.
+	
+	__block int64_t minRowid = 0;
+	__block int64_t maxRowid = 0;
+	__block BOOL found = NO;
+	
+	[connections[0] readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		found = [transaction _getMinRowid:&minRowid maxRowid:&maxRowid inCollection:collection];
+	}];
+	
+	if (found)
+	{
+		uint64_t rowidSpan = (uint64_t)(maxRowid - minRowid) + 1;
+		
+		uint64_t rangeCount = workerCount * PARALLEL_ENUMERATION_RANGES_PER_WORKER;
+		if (rangeCount > rowidSpan)
+			rangeCount = rowidSpan;
+		
+		uint64_t rangeSize = (rowidSpan + rangeCount - 1) / rangeCount;
+		
+		atomic_uint_fast64_t nextRange = 0;
+		atomic_bool stopped = false;
+		
+		atomic_uint_fast64_t *nextRangePtr = &nextRange;
+		atomic_bool *stoppedPtr = &stopped;
+		
+		dispatch_group_t group = dispatch_group_create();
+		dispatch_queue_t workerQueue = dispatch_get_global_queue(qos_class_self(), 0);
+		
+		for (YapDatabaseConnection *connection in connections)
+		{
+			dispatch_group_async(group, workerQueue, ^{ @autoreleasepool {
+				
+				[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+					
+					uint64_t rangeIndex;
+					while (!atomic_load(stoppedPtr) &&
+					       (rangeIndex = atomic_fetch_add(nextRangePtr, 1)) < rangeCount)
+					{
+						int64_t afterRowid = (minRowid - 1) + (int64_t)(rangeIndex * rangeSize);
+						int64_t throughRowid = MIN(afterRowid + (int64_t)rangeSize, maxRowid);
+						
+						[transaction _enumerateRowsInCollection:collection
+						                             afterRowid:afterRowid
+						                           throughRowid:throughRowid
+						                             usingBlock:
+						    ^(int64_t __unused rowid, NSString *key, id object, id metadata, BOOL *stop)
+						{
+							block(key, object, metadata, stop);
+							
+							if (*stop)
+								atomic_store(stoppedPtr, true);
+							else if (atomic_load_explicit(stoppedPtr, memory_order_relaxed))
+								*stop = YES;
+						}];
+					}
+				}];
+			}});
+		}
+		
+		dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	}
+	
+	for (YapDatabaseConnection *connection in connections)
+	{
+		[connection endLongLivedReadTransaction];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Extensions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Registers the extension with the database using the given name.
+ * After registration everything works automatically using just the extension name.
+ * 
+ * The registration process is equivalent to a (synchronous) readwrite transaction.
+ * It involves persisting various information about the extension to the database,
+ * as well as possibly populating the extension by enumerating existing rows in the database.
+ *
+ * @param extension
+ *     The YapDatabaseExtension subclass instance you wish to register.
+ *     For example, this might be a YapDatabaseView instance.
+ * 
+ * @param extensionName
+ *     This is an arbitrary string you assign to the extension.
+ *     Once registered, you will generally access the extension instance via this name.
+ *     For example: [[transaction ext:@"myView"] numberOfGroups];
+ *
+ * @return
+ *     YES if the extension was properly registered.
+ *     NO if an error occurred, such as the extensionName is already registered.
+ * 
+ * @see asyncRegisterExtension:withName:completionBlock:
+ * @see asyncRegisterExtension:withName:completionQueue:completionBlock:
+**/
+- (BOOL)registerExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName
+{
+	return [self registerExtension:extension withName:extensionName config:nil];
+}
+
+/**
+ * Registers the extension with the database using the given name.
+ * After registration everything works automatically using just the extension name.
+ *
+ * The registration process is equivalent to a (synchronous) readwrite transaction.
+ * It involves persisting various information about the extension to the database,
+ * as well as possibly populating the extension by enumerating existing rows in the database.
+ * 
+ * @param extension (required)
+ *     The YapDatabaseExtension subclass instance you wish to register.
+ *     For example, this might be a YapDatabaseView instance.
+ *
+ * @param extensionName (required)
+ *     This is an arbitrary string you assign to the extension.
+ *     Once registered, you will generally access the extension instance via this name.
+ *     For example: [[transaction ext:@"myView"] numberOfGroups];
+ * 
+ * @param config (optional)
+ *     You may optionally pass a config for the internal databaseConnection used to perform
+ *     the extension registration process. This allows you to control things such as the
+ *     cache size, which is sometimes important for performance tuning.
+ * 
+ * @see asyncRegisterExtension:withName:completionBlock:
+ * @see asyncRegisterExtension:withName:completionQueue:completionBlock:
+**/
+- (BOOL)registerExtension:(YapDatabaseExtension *)extension
+                 withName:(NSString *)extensionName
+                   config:(YapDatabaseConnectionConfig *)config
+{
+	__block BOOL ready = NO;
+	dispatch_sync(writeQueue, ^{ @autoreleasepool {
+		
+		ready = [self _registerExtension:extension withName:extensionName config:config];
+	}});
+	
+	return ready;
+}
+
+/**
+ * Asynchronoulsy starts the extension registration process.
+ * After registration everything works automatically using just the extension name.
+ * 
+ * The registration process is equivalent to an asyncReadwrite transaction.
+ * It involves persisting various information about the extension to the database,
+ * as well as possibly populating the extension by enumerating existing rows in the database.
+ * 
+ * @param extension (required)
+ *     The YapDatabaseExtension subclass instance you wish to register.
+ *     For example, this might be a YapDatabaseView instance.
+ *
+ * @param extensionName (required)
+ *     This is an arbitrary string you assign to the extension.
+ *     Once registered, you will generally access the extension instance via this name.
+ *     For example: [[transaction ext:@"myView"] numberOfGroups];
+ *
+ * @param completionBlock (optional)
+ *     An optional completion block may be used.
+ *     If the extension registration was successful then the ready parameter will be YES.
+ *     The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+**/
+- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
+                      withName:(NSString *)extensionName
+               completionBlock:(void(^)(BOOL ready))completionBlock
+{
+	[self asyncRegisterExtension:extension
+	                    withName:extensionName
+	                      config:nil
+	             completionQueue:NULL
+	             completionBlock:completionBlock];
+}
+
+/**
+ * Asynchronoulsy starts the extension registration process.
+ * After registration everything works automatically using just the extension name.
+ *
+ * The registration process is equivalent to an asyncReadwrite transaction.
+ * It involves persisting various information about the extension to the database,
+ * as well as possibly populating the extension by enumerating existing rows in the database.
+ * 
+ * @param extension (required)
+ *     The YapDatabaseExtension subclass instance you wish to register.
+ *     For example, this might be a YapDatabaseView instance.
+ *
+ * @param extensionName (required)
+ *     This is an arbitrary string you assign to the extension.
+ *     Once registered, you will generally access the extension instance via this name.
+ *     For example: [[transaction ext:@"myView"] numberOfGroups];
+ *
+ * @param completionQueue (optional)
+ *     The dispatch_queue to invoke the completion block may optionally be specified.
+ *     If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @param completionBlock (optional)
+ *     An optional completion block may be used.
+ *     If the extension registration was successful then the ready parameter will be YES.
+**/
+- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
+                      withName:(NSString *)extensionName
+               completionQueue:(dispatch_queue_t)completionQueue
+               completionBlock:(void(^)(BOOL ready))completionBlock
+{
+	[self asyncRegisterExtension:extension
+	                    withName:extensionName
+	                      config:nil
+	             completionQueue:completionQueue
+	             completionBlock:completionBlock];
+}
+
+/**
+ * Asynchronoulsy starts the extension registration process.
+ * After registration everything works automatically using just the extension name.
+ *
+ * The registration process is equivalent to an asyncReadwrite transaction.
+ * It involves persisting various information about the extension to the database,
+ * as well as possibly populating the extension by enumerating existing rows in the database.
+ * 
+ * @param extension (required)
+ *     The YapDatabaseExtension subclass instance you wish to register.
+ *     For example, this might be a YapDatabaseView instance.
+ *
+ * @param extensionName (required)
+ *     This is an arbitrary string you assign to the extension.
+ *     Once registered, you will generally access the extension instance via this name.
+ *     For example: [[transaction ext:@"myView"] numberOfGroups];
+ * 
+ * @param config (optional)
+ *     You may optionally pass a config for the internal databaseConnection used to perform
+ *     the extension registration process. This allows you to control things such as the
+ *     cache size, which is sometimes important for performance tuning.
+ *
+ * @param completionBlock (optional)
+ *     An optional completion block may be used.
+ *     If the extension registration was successful then the ready parameter will be YES.
+ *     The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+**/
+- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
+                      withName:(NSString *)extensionName
+                        config:(YapDatabaseConnectionConfig *)config
+               completionBlock:(void(^)(BOOL ready))completionBlock
+{
+	[self asyncRegisterExtension:extension
+	                    withName:extensionName
+	                      config:config
+	             completionQueue:NULL
+	             completionBlock:completionBlock];
+}
+
+/**
+ * Asynchronoulsy starts the extension registration process.
+ * After registration everything works automatically using just the extension name.
+ *
+ * The registration process is equivalent to an asyncReadwrite transaction.
+ * It involves persisting various information about the extension to the database,
+ * as well as possibly populating the extension by enumerating existing rows in the database.
+ * 
+ * @param extension (required)
+ *     The YapDatabaseExtension subclass instance you wish to register.
+ *     For example, this might be a YapDatabaseView instance.
+ *
+ * @param extensionName (required)
+ *     This is an arbitrary string you assign to the extension.
+ *     Once registered, you will generally access the extension instance via this name.
+ *     For example: [[transaction ext:@"myView"] numberOfGroups];
+ * 
+ * @param config (optional)
+ *     You may optionally pass a config for the internal databaseConnection used to perform
+ *     the extension registration process. This allows you to control things such as the
+ *     cache size, which is sometimes important for performance tuning.
+ *
+ * @param completionQueue (optional)
+ *     The dispatch_queue to invoke the completion block may optionally be specified.
+ *     If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @param completionBlock (optional)
+ *     An optional completion block may be used.
+ *     If the extension registration was successful then the ready parameter will be YES.
+**/
+- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
+                      withName:(NSString *)extensionName
+                        config:(YapDatabaseConnectionConfig *)config
+               completionQueue:(dispatch_queue_t)completionQueue
+               completionBlock:(void(^)(BOOL ready))completionBlock
+{
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
+	
+	if (config)
+		config = [config copy];
+	
+	dispatch_async(writeQueue, ^{ @autoreleasepool {
+		
+		BOOL ready = [self _registerExtension:extension withName:extensionName config:config];
+		
+		if (completionBlock)
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				
+				completionBlock(ready);
+			}});
+		}
+	}});
+}
+
+/**
+ * Registers multiple extensions with the database, within a single (synchronous) readwrite transaction.
+ * The extensions share a single enumeration of the database during population.
+ *
+ * @see [YapDatabase registerExtensions:config:]
+**/
+- (BOOL)registerExtensions:(NSDictionary<NSString *, YapDatabaseExtension *> *)extensions
+                    config:(YapDatabaseConnectionConfig *)config
+{
+	__block BOOL ready = NO;
+	dispatch_sync(writeQueue, ^{ @autoreleasepool {
+		
+		ready = [self _registerExtensions:extensions config:config];
+	}});
+	
+	return ready;
+}
+
+/**
+ * Asynchronously registers multiple extensions with the database, within a single readwrite transaction.
+ *
+ * @see [YapDatabase asyncRegisterExtensions:config:completionQueue:completionBlock:]
+**/
+- (void)asyncRegisterExtensions:(NSDictionary<NSString *, YapDatabaseExtension *> *)inExtensions
+                         config:(YapDatabaseConnectionConfig *)config
+                completionQueue:(dispatch_queue_t)completionQueue
+                completionBlock:(void(^)(BOOL ready))completionBlock
+{
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
+	
+	NSDictionary *extensions = [inExtensions copy];
+	
+	if (config)
+		config = [config copy];
+	
+	dispatch_async(writeQueue, ^{ @autoreleasepool {
+		
+		BOOL ready = [self _registerExtensions:extensions config:config];
+		
+		if (completionBlock)
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				
+				completionBlock(ready);
+			}});
+		}
+	}});
+}
+
+/**
+ * Registers the extension without waiting for the registration process.
+ * Deferred extensions are queued, and registered together (within a single readwrite transaction).
+ *
+ * @see [YapDatabase registerDeferredExtension:withName:]
+**/
+- (BOOL)registerDeferredExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName
+{
+	if (extension == nil || [extensionName length] == 0)
+	{
+		YDBLogError(@"Error registering deferred extension: extension or extensionName is nil");
+		return NO;
+	}
+	if (extension.registeredName != nil)
+	{
+		YDBLogError(@"Error registering deferred extension(%@): extension is already registered", extensionName);
+		return NO;
+	}
+	
+	BOOL isDuplicate = NO;
+	BOOL needsSchedule = NO;
+	
+	YAPUnfairLockLock(&deferredExtensionsLock);
+	{
+		if (deferredExtensions[extensionName] != nil)
+		{
+			isDuplicate = YES;
+		}
+		else
+		{
+			if (deferredExtensions == nil)
+			{
+				deferredExtensions = [[NSMutableDictionary alloc] init];
+				needsSchedule = YES;
+			}
+			
+			deferredExtensions[extensionName] = extension;
+		}
+	}
+	YAPUnfairLockUnlock(&deferredExtensionsLock);
+	
+	if (isDuplicate)
+	{
+		YDBLogError(@"Error registering deferred extension: extensionName(%@) already pending", extensionName);
+		return NO;
+	}
+	
+	if (needsSchedule)
+	{
+		// Every extension that's deferred before this block executes is registered with it.
+		// ReadWrite transactions queued afterwards are (FIFO) executed after the extensions are registered.
+		
+		dispatch_async(writeQueue, ^{ @autoreleasepool {
+			
+			[self _registerDeferredExtensions];
+		}});
+	}
+	
+	return YES;
+}
+
+/**
+ * This method unregisters an extension with the given name.
+ * The associated underlying tables will be dropped from the database.
+ * 
+ * The unregistration process is equivalent to a (synchronous) readwrite transaction.
+ * It involves deleting various information about the extension from the database,
+ * as well as possibly dropping related tables the extension may have been using.
+ *
+ * @param extensionName (required)
+ *     This is the arbitrary string you assigned to the extension when you registered it.
+ *
+ * Note 1:
+ *   You don't need to re-register an extension in order to unregister it. For example,
+ *   you've previously registered an extension (in previous app launches), but you no longer need the extension.
+ *   You don't have to bother creating and registering the unneeded extension,
+ *   just so you can unregister it and have the associated tables dropped.
+ *   The database persists information about registered extensions, including the associated class of an extension.
+ *   So you can simply pass the name of the extension, and the database system will use the associated class to
+ *   drop the appropriate tables.
+ *
+ * Note 2:
+ *   In fact, you don't even have to worry about unregistering extensions that you no longer need.
+ *   That database system will automatically handle it for you.
+ *   That is, upon completion of the first readWrite transaction (that makes changes), the database system will
+ *   check to see if there are any "orphaned" extensions. That is, previously registered extensions that are
+ *   no longer in use (and are now out-of-date because they didn't process the recent change(s) to the db).
+ *   And it will automatically unregister these orhpaned extensions for you.
+ *       
+ * @see asyncUnregisterExtensionWithName:completionBlock:
+ * @see asyncUnregisterExtensionWithName:completionQueue:completionBlock:
+**/
+- (void)unregisterExtensionWithName:(NSString *)extensionName
+{
+	dispatch_sync(writeQueue, ^{ @autoreleasepool {
+		
+		[self _unregisterExtensionWithName:extensionName];
+	}});
+}
+
+/**
+ * Asynchronoulsy starts the extension unregistration process.
+ *
+ * The unregistration process is equivalent to an asyncReadwrite transaction.
+ * It involves deleting various information about the extension from the database,
+ * as well as possibly dropping related tables the extension may have been using.
+ *
+ * @param extensionName (required)
+ *     This is the arbitrary string you assigned to the extension when you registered it.
+ *
+ * @param completionBlock (optional)
+ *     An optional completion block may be used.
+ *     The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+**/
+- (void)asyncUnregisterExtensionWithName:(NSString *)extensionName
+                         completionBlock:(dispatch_block_t)completionBlock
+{
+	[self asyncUnregisterExtensionWithName:extensionName
+	                       completionQueue:NULL
+	                       completionBlock:completionBlock];
+}
+
+/**
+ * Asynchronoulsy starts the extension unregistration process.
+ *
+ * The unregistration process is equivalent to an asyncReadwrite transaction.
+ * It involves deleting various information about the extension from the database,
+ * as well as possibly dropping related tables the extension may have been using.
+ *
+ * @param extensionName (required)
+ *     This is the arbitrary string you assigned to the extension when you registered it.
+ *
+ * @param completionQueue (optional)
+ *     The dispatch_queue to invoke the completion block may optionally be specified.
+ *     If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @param completionBlock (optional)
+ *     An optional completion block may be used.
+**/
+- (void)asyncUnregisterExtensionWithName:(NSString *)extensionName
+                         completionQueue:(dispatch_queue_t)completionQueue
+                         completionBlock:(dispatch_block_t)completionBlock
+{
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
+	
+	dispatch_async(writeQueue, ^{ @autoreleasepool {
+		
+		[self _unregisterExtensionWithName:extensionName];
+		
+		if (completionBlock)
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				
+				completionBlock();
+			}});
+		}
+	}});
+}
+
+/**
+ * Internal utility method.
+ * Handles lazy creation and destruction of short-lived registrationConnection instance.
+ * 
+ * @see _registerExtension:withName:
+ * @see _unregisterExtensionWithName:
+**/
+- (YapDatabaseConnection *)registrationConnection
+{
+	if (registrationConnection == nil)
+	{
+		registrationConnection = [self newConnection];
+		registrationConnection.name = @"YapDatabase_extensionRegistrationConnection";
+		
+		// These are the rules (regarding instance retainCount):
+		// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+		// - a YapDatabase instance cannot be deallocated if there are existing connections
+		//
+		// Thus, as long as registrationConnection is non-nil,
+		// 'self' (this YapDatabase instance) cannot be deallocated.
+		//
+		
+		__weak YapDatabase *weakSelf = self;
+		
+		NSTimeInterval delayInSeconds = 5.0;
+		dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
+		dispatch_after(popTime, writeQueue, ^(void){
+			
+			__strong YapDatabase *strongSelf = weakSelf;
+			if (strongSelf)
+			{
+				strongSelf->registrationConnection = nil;
+			}
+		});
+	}
+	
+	return registrationConnection;
+}
+
+/**
+ * Internal method that handles extension registration.
+ * This method must be invoked on the writeQueue.
+**/
+- (BOOL)_registerExtension:(YapDatabaseExtension *)extension
+                  withName:(NSString *)extensionName
+                    config:(YapDatabaseConnectionConfig *)config
+{
+	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
+	
+	// Validate parameters
+	
+	if (options.readOnlyImmutable)
+	{
+		YDBLogError(@"Error registering extension: database is readOnlyImmutable");
+		return NO;
+	}
+	if (extension == nil)
+	{
+		YDBLogError(@"Error registering extension: extension parameter is nil");
+		return NO;
+	}
+	if ([extensionName length] == 0)
+	{
+		YDBLogError(@"Error registering extension: extensionName parameter is nil or empty string");
+		return NO;
+	}
+	
+	// Check to ensure extension isn't already registered,
+	// or that the extensionName isn't already taken.
+	
+	NSDictionary *_registeredExtensions = [self registeredExtensions];
+	
+	if (extension.registeredName != nil)
+	{
+		YDBLogError(@"Error registering extension: extension is already registered");
+		return NO;
+	}
+	if ([_registeredExtensions objectForKey:extensionName] != nil)
+	{
+		YDBLogError(@"Error registering extension: extensionName(%@) already registered", extensionName);
+		return NO;
+	}
+	
+	// Attempt registration
+	
+	extension.registeredName = extensionName;
+	extension.registeredDatabase = self;
+	
+	BOOL result = [extension supportsDatabaseWithRegisteredExtensions:_registeredExtensions];
+	if (!result)
+	{
+		YDBLogError(@"Error registering extension: extension doesn't support database configuration");
+	}
+	else
+	{
+		YapDatabaseConnection *connection = [self registrationConnection];
+		
+		YapDatabaseConnectionConfig *originalConfig = nil;
+		if (config)
+		{
+			originalConfig = [connection copyConfig];
+			[connection applyConfig:config];
+		}
+		
+		result = [connection registerExtension:extension withName:extensionName];
+		
+		if (config)
+		{
+			[connection applyConfig:originalConfig];
+		}
+	}
+	
+	if (result)
+	{
+		[extension didRegisterExtension];
+		
+		if ([extension hasPendingPopulation]) {
+			[self _asyncPopulateExtension:extension withConnection:nil];
+		}
+	}
+	else
+	{
+		extension.registeredName = nil;
+		extension.registeredDatabase = nil;
+	}
+	
+	
+	return result;
+}
+
+/**
+ * Internal method that handles batch extension registration.
+ * This method must be invoked on the writeQueue.
+**/
+- (BOOL)_registerExtensions:(NSDictionary<NSString *, YapDatabaseExtension *> *)extensions
+                     config:(YapDatabaseConnectionConfig *)config
+{
+	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
+	
+	if ([extensions count] == 0) return YES;
+	
+	// Validate parameters
+	
+	if (options.readOnlyImmutable)
+	{
+		YDBLogError(@"Error registering extensions: database is readOnlyImmutable");
+		return NO;
+	}
+	
+	NSDictionary *_registeredExtensions = [self registeredExtensions];
+	
+	for (NSString *extensionName in extensions)
+	{
+		YapDatabaseExtension *extension = extensions[extensionName];
+		
+		if ([extensionName length] == 0)
+		{
+			YDBLogError(@"Error registering extensions: extensionName is empty string");
+			return NO;
+		}
+		if (extension.registeredName != nil)
+		{
+			YDBLogError(@"Error registering extensions: extension(%@) is already registered", extensionName);
+			return NO;
+		}
+		if ([_registeredExtensions objectForKey:extensionName] != nil)
+		{
+			YDBLogError(@"Error registering extensions: extensionName(%@) already registered", extensionName);
+			return NO;
+		}
+	}
+	
+	// Sort the extensions such that dependencies come first.
+	// Dependencies that aren't part of the batch must already be registered,
+	// which is checked by each extension's supportsDatabaseWithRegisteredExtensions: method.
+	
+	NSMutableArray<NSString *> *orderedNames = [NSMutableArray arrayWithCapacity:[extensions count]];
+	NSMutableArray<NSString *> *remainingNames =
+	  [[[extensions allKeys] sortedArrayUsingSelector:@selector(compare:)] mutableCopy];
+	
+	while ([remainingNames count] > 0)
+	{
+		NSUInteger orderedCount = [orderedNames count];
+		
+		for (NSString *extensionName in [remainingNames copy])
+		{
+			BOOL isReady = YES;
+			for (NSString *dependency in [extensions[extensionName] dependencies])
+			{
+				if (extensions[dependency] && ![orderedNames containsObject:dependency])
+				{
+					isReady = NO;
+					break;
+				}
+			}
+			
+			if (isReady)
+			{
+				[orderedNames addObject:extensionName];
+				[remainingNames removeObject:extensionName];
+			}
+		}
+		
+		if ([orderedNames count] == orderedCount)
+		{
+			YDBLogError(@"Error registering extensions: circular dependency between extensions(%@)", remainingNames);
+			return NO;
+		}
+	}
+	
+	// Attempt registration
+	
+	NSMutableArray<YapDatabaseExtension *> *orderedExtensions = [NSMutableArray arrayWithCapacity:[orderedNames count]];
+	NSMutableDictionary *pendingRegisteredExtensions = [_registeredExtensions mutableCopy];
+	
+	BOOL result = YES;
+	
+	for (NSString *extensionName in orderedNames)
+	{
+		YapDatabaseExtension *extension = extensions[extensionName];
+		
+		extension.registeredName = extensionName;
+		extension.registeredDatabase = self;
+		
+		[orderedExtensions addObject:extension];
+		
+		if (![extension supportsDatabaseWithRegisteredExtensions:pendingRegisteredExtensions])
+		{
+			YDBLogError(@"Error registering extension(%@): extension doesn't support database configuration",
+			            extensionName);
+			
+			result = NO;
+			break;
+		}
+		
+		pendingRegisteredExtensions[extensionName] = extension;
+	}
+	
+	if (result)
+	{
+		YapDatabaseConnection *connection = [self registrationConnection];
+		
+		YapDatabaseConnectionConfig *originalConfig = nil;
+		if (config)
+		{
+			originalConfig = [connection copyConfig];
+			[connection applyConfig:config];
+		}
+		
+		result = [connection registerExtensions:orderedExtensions withNames:orderedNames];
+		
+		if (config)
+		{
+			[connection applyConfig:originalConfig];
+		}
+	}
+	
+	for (YapDatabaseExtension *extension in orderedExtensions)
+	{
+		if (result)
+		{
+			[extension didRegisterExtension];
+			
+			if ([extension hasPendingPopulation]) {
+				[self _asyncPopulateExtension:extension withConnection:nil];
+			}
+		}
+		else
+		{
+			extension.registeredName = nil;
+			extension.registeredDatabase = nil;
+		}
+	}
+	
+	return result;
+}
+
+/**
+ * Internal method that registers all pending deferred extensions.
+ * This method must be invoked on the writeQueue.
+**/
+- (void)_registerDeferredExtensions
+{
+	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
+	
+	NSDictionary<NSString *, YapDatabaseExtension *> *extensions = nil;
+	
+	YAPUnfairLockLock(&deferredExtensionsLock);
+	{
+		extensions = deferredExtensions;
+		deferredExtensions = nil;
+	}
+	YAPUnfairLockUnlock(&deferredExtensionsLock);
+	
+	if ([extensions count] == 0) return;
+	
+	if ([self _registerExtensions:extensions config:nil]) return;
+	
+	// The batch registration is all-or-nothing.
+	// So one bad extension would otherwise prevent every other deferred extension from being registered.
+	// Fallback to registering them individually (dependencies first).
+	
+	NSMutableDictionary<NSString *, YapDatabaseExtension *> *remaining = [extensions mutableCopy];
+	BOOL madeProgress;
+	
+	do
+	{
+		madeProgress = NO;
+		
+		for (NSString *extensionName in [[remaining allKeys] sortedArrayUsingSelector:@selector(compare:)])
+		{
+			YapDatabaseExtension *extension = remaining[extensionName];
+			
+			BOOL isReady = YES;
+			for (NSString *dependency in [extension dependencies])
+			{
+				if (remaining[dependency] != nil)
+				{
+					isReady = NO;
+					break;
+				}
+			}
+			
+			if (!isReady) continue;
+			
+			if (![self _registerExtension:extension withName:extensionName config:nil])
+			{
+				YDBLogError(@"Error registering deferred extension(%@)", extensionName);
+			}
+			
+			[remaining removeObjectForKey:extensionName];
+			madeProgress = YES;
+		}
+		
+	} while (madeProgress && [remaining count] > 0);
+	
+	if ([remaining count] > 0)
+	{
+		YDBLogError(@"Error registering deferred extensions: circular dependency between extensions(%@)",
+		            [remaining allKeys]);
+	}
+}
+
+- (void)asyncPopulateExtension:(YapDatabaseExtension *)extension
+{
+	[self _asyncPopulateExtension:extension withConnection:nil];
+}
+
+/**
+ * Internal method that handles incremental extension population.
+ *
+ * Each chunk is populated within its own asyncReadWriteTransaction.
+ * Since the writeQueue is FIFO, other readWriteTransactions get to run in between chunks,
+ * as opposed to waiting for the entire population to complete.
+ *
+ * The process stops once the extension reports that it's complete,
+ * or if the extension is unregistered in the meantime.
+ * Note that the (dedicated) connection retains the database until the population is complete.
+**/
+- (void)_asyncPopulateExtension:(YapDatabaseExtension *)extension withConnection:(YapDatabaseConnection *)connection
+{
+	if (connection == nil)
+	{
+		connection = [self newConnection];
+		connection.name = [NSString stringWithFormat:@"YapDatabase_extensionPopulationConnection(%@)",
+		                   extension.registeredName];
+	}
+	
+	NSString *extensionName = extension.registeredName;
+	if (extensionName == nil) return;
+	
+	__block BOOL isComplete = YES;
+	
+	[connection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		YapDatabaseExtensionTransaction *extTransaction = [transaction ext:extensionName];
+		
+		// Make sure the extension wasn't unregistered (or replaced) since the previous chunk.
+		
+		if ([[extTransaction extensionConnection] extension] == extension)
+		{
+			isComplete = [extTransaction populateNextChunk];
+		}
+		
+	} completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0) completionBlock:^{
+		
+		if (isComplete)
+		{
+			YDBLogVerbose(@"Finished incremental population of extension(%@)", extensionName);
+		}
+		else
+		{
+			[self _asyncPopulateExtension:extension withConnection:connection];
+		}
+	}];
+}
+
+/**
+ * Internal method that handles extension unregistration.
+ * This method must be invoked on the writeQueue.
+**/
+- (void)_unregisterExtensionWithName:(NSString *)extensionName
+{
+	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
+	
+	// Validate parameters
+	
+	if ([extensionName length] == 0)
+	{
+		YDBLogError(@"Error unregistering extension: extensionName parameter is nil or empty string");
+		return;
+	}
+	
+	// Perform unregistration
+	
+	YapDatabaseConnection *connection = [self registrationConnection];
+	
+	[connection unregisterExtensionWithName:extensionName];
+}
+
+/**
+ * Returns the registered extension with the given name.
+**/
+- (id)registeredExtension:(NSString *)extensionName
+{
+	// This method is public
+	
+	__block YapDatabaseExtension *result = nil;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = [registeredExtensions objectForKey:extensionName];
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnSnapshotQueueKey))
+		block();
+	else
+		dispatch_sync(snapshotQueue, block);
+	
+	return result;
+}
+
+/**
+ * Returns all currently registered extensions as a dictionary.
+ * The key is the registed name (NSString), and the value is the extension (YapDatabaseExtension subclass).
+**/
+- (NSDictionary *)registeredExtensions
+{
+	// This method is public
+	
+	__block NSDictionary *extensionsCopy = nil;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		extensionsCopy = registeredExtensions;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnSnapshotQueueKey))
+		block();
+	else
+		dispatch_sync(snapshotQueue, block);
+	
+	return extensionsCopy;
+}
+
+/**
+ * This method is only accessible from within the snapshotQueue.
+ * Used by [YapDatabaseConnection prepare].
+**/
+- (NSArray *)extensionsOrder
+{
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	
+	return extensionsOrder;
+}
+
+/**
+ * This method is only accessible from within the snapshotQueue.
+ * Used by [YapDatabaseConnection prepare].
+**/
+- (NSDictionary *)extensionDependencies
+{
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	
+	return extensionDependencies;
+}
+
+/**
+ * Allows you to fetch the registered extension names from the last time the database was run.
+ * Typically this means from the last time the app was run.
+ *
+ * This may be used to assist in various tasks, such as cleanup or upgrade tasks.
+ *
+ * If you need this information, you should fetch it early on because YapDatabase only maintains this information
+ * until it sees you are done registering all your initial extensions. That is, after one initializes the database
+ * they then immediately register any needed initial extensions before they begin to use the database. Once a
+ * readWriteTransaction modifies the database, YapDatabase will take this opportunity to look for orphaned extensions.
+ * These are extensions that were registered at the end of the last database session,
+ * but which are no longer registered. YapDatabase will automatically cleanup these orphaned extensions,
+ * and also clear the previouslyRegisteredExtensionNames information at this point.
+**/
+- (NSArray *)previouslyRegisteredExtensionNames
+{
+	__block NSArray *result = nil;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = [previouslyRegisteredExtensionNames copy];
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnSnapshotQueueKey))
+		block();
+	else
+		dispatch_sync(snapshotQueue, block);
+	
+	return result;
+}
+
+/**
+ * It's sometimes useful to find out when all async registerExtension/unregisterExtension requests have completed.
+ *
+ * One way to accomplish this is simply to queue an asyncReadWriteTransaction on any databaseConnection.
+ * Since all async register/unregister extension requests are immediately dispatch_async'd through the
+ * internal serial writeQueue, you'll know that once your asyncReadWriteTransaction is running,
+ * all previously scheduled register/unregister requests have completed.
+ *
+ * Although the above technique works, the 'flushExtensionRequestsWithCompletionQueue::'
+ * is a more efficient way to accomplish this task. (And a more elegant & readable way too.)
+ *
+ * @param completionQueue
+ *   The dispatch_queue to invoke the completionBlock on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @param completionBlock
+ *   The block to invoke once all previously scheduled register/unregister extension requests have completed.
+ **/
+- (void)flushExtensionRequestsWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
+									       completionBlock:(nullable dispatch_block_t)completionBlock
+{
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
+	
+	dispatch_async(writeQueue, ^{ @autoreleasepool {
+		
+		if (completionBlock)
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				
+				completionBlock();
+			}});
+		}
+	}});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Pooling
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)maxConnectionPoolCount
+{
+	__block NSUInteger count = 0;
+	
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		count = maxConnectionPoolCount;
+		
+	#pragma clang diagnostic pop
+	});
+	
+	return count;
+}
+
+- (void)setMaxConnectionPoolCount:(NSUInteger)count
+{
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// Update ivar
+		maxConnectionPoolCount = count;
+		
+		// Immediately drop any excess connections
+		if ([connectionPoolValues count] > maxConnectionPoolCount)
+		{
+			do
+			{
+				sqlite3 *aDb = (sqlite3 *)[[connectionPoolValues objectAtIndex:0] pointerValue];
+				
+				int status = sqlite3_close(aDb);
+				if (status != SQLITE_OK)
+				{
+					YDBLogError(@"Error in sqlite_close: %d %s", status, sqlite3_errmsg(aDb));
+				}
+				
+				[connectionPoolValues removeObjectAtIndex:0];
+				[connectionPoolDates removeObjectAtIndex:0];
+				
+			} while ([connectionPoolValues count] > maxConnectionPoolCount);
+			
+			[self resetConnectionPoolTimer];
+		}
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+- (NSTimeInterval)connectionPoolLifetime
+{
+	__block NSTimeInterval lifetime = 0;
+	
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		lifetime = connectionPoolLifetime;
+		
+	#pragma clang diagnostic pop
+	});
+	
+	return lifetime;
+}
+
+- (void)setConnectionPoolLifetime:(NSTimeInterval)lifetime
+{
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// Update ivar
+		connectionPoolLifetime = lifetime;
+		
+		// Update timer (if needed)
+		[self resetConnectionPoolTimer];
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+/**
+ * Adds the given connection to the connection pool if possible.
+ * 
+ * Returns YES if the instance was added to the pool.
+ * If so, the YapDatabaseConnection must not close the instance.
+ * 
+ * Returns NO if the instance was not added to the pool.
+ * If so, the YapDatabaseConnection must close the instance.
+**/
+- (BOOL)connectionPoolEnqueue:(sqlite3 *)aDb main_file:(yap_file *)main_file wal_file:(yap_file *)wal_file
+{
+	__block BOOL result = NO;
+	
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if ([connectionPoolValues count] < maxConnectionPoolCount)
+		{
+			if (connectionPoolValues == nil)
+			{
+				connectionPoolValues = [[NSMutableArray alloc] init];
+				connectionPoolDates = [[NSMutableArray alloc] init];
+			}
+			
+			YDBLogVerbose(@"Enqueuing connection to pool: %p", aDb);
+			
+			NSDictionary *value = @{
+			  YDBConnectionPoolValueKey_db        : [NSValue valueWithPointer:(const void *)aDb],
+			  YDBConnectionPoolValueKey_main_file : [NSValue valueWithPointer:(const void *)main_file],
+			  YDBConnectionPoolValueKey_wal_file  : [NSValue valueWithPointer:(const void *)wal_file],
+			};
+			
+			[connectionPoolValues addObject:value];
+			[connectionPoolDates addObject:[NSDate date]];
+			
+			result = YES;
+			
+			if ([connectionPoolValues count] == 1)
+			{
+				[self resetConnectionPoolTimer];
+			}
+		}
+		
+	#pragma clang diagnostic pop
+	});
+	
+	return result;
+}
+
+/**
+ * Retrieves a connection from the connection pool if available.
+ * Returns NULL if no connections are available.
+**/
+- (BOOL)connectionPoolDequeue:(sqlite3 **)pDb main_file:(yap_file **)pMainFile wal_file:(yap_file **)pWalFile
+{
+	NSParameterAssert(pDb != NULL);
+	NSParameterAssert(pMainFile != NULL);
+	NSParameterAssert(pWalFile != NULL);
+	
+	__block sqlite3 *aDb = NULL;
+	__block yap_file *main_file = NULL;
+	__block yap_file *wal_file = NULL;
+	
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if ([connectionPoolValues count] > 0)
+		{
+			NSDictionary *value = [connectionPoolValues objectAtIndex:0];
+			
+			aDb       = (sqlite3 *)[[value objectForKey:YDBConnectionPoolValueKey_db] pointerValue];
+			main_file = (yap_file *)[[value objectForKey:YDBConnectionPoolValueKey_main_file] pointerValue];
+			wal_file  = (yap_file *)[[value objectForKey:YDBConnectionPoolValueKey_wal_file] pointerValue];
+			
+			YDBLogVerbose(@"Dequeuing connection from pool: %p", aDb);
+			
+			[connectionPoolValues removeObjectAtIndex:0];
+			[connectionPoolDates removeObjectAtIndex:0];
+			
+			[self resetConnectionPoolTimer];
+		}
+		
+	#pragma clang diagnostic pop
+	});
+	
+	*pDb = aDb;
+	*pMainFile = main_file;
+	*pWalFile = wal_file;
+	
+	return (aDb != NULL);
+}
+
+/**
+ * Opens & configures options.connectionPrewarmCount sqlite3 instances (in parallel),
+ * and adds them to the connection pool.
+ * 
+ * This method is invoked (once) after the database has been setup.
+**/
+- (void)prewarmConnectionPool
+{
+	if (options.connectionPrewarmCount == 0) return;
+	
+	dispatch_queue_t bgQueue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+	
+	__weak YapDatabase *weakSelf = self;
+	dispatch_async(bgQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		size_t count = (size_t)MIN(strongSelf.options.connectionPrewarmCount, strongSelf.maxConnectionPoolCount);
+		
+		// dispatch_apply runs the iterations in parallel (on a concurrent queue).
+		dispatch_apply(count, bgQueue, ^(size_t __unused i) { @autoreleasepool {
+			
+			[strongSelf prewarmConnectionHandle];
+		}});
+	}});
+}
+
+- (void)prewarmConnectionHandle
+{
+	sqlite3 *aDb = NULL;
+	
+	int status = [YapDatabaseConnection openDatabaseHandle:&aDb forDatabase:self];
+	if (status != SQLITE_OK)
+	{
+		if (aDb) {
+			sqlite3_close(aDb);
+		}
+		return;
+	}
+	
+	// Replaced by the busy handler of the connection that dequeues the instance.
+	sqlite3_busy_handler(aDb, connectionBusyHandler, (__bridge void *)self);
+	
+	yap_file *main_file = NULL;
+	yap_file *wal_file = NULL;
+	
+	sqlite3_file_control(aDb, "main", SQLITE_FCNTL_FILE_POINTER, &main_file);
+	
+#ifdef SQLITE_FCNTL_JOURNAL_POINTER
+	// Reading the schema requires a read transaction, which opens the WAL.
+	// Connections normally find their wal_file (after their first read) via yap_vfs_last_opened_wal,
+	// which isn't reliable here, as other instances are being opened in parallel.
+	// So we only read the schema if we can fetch the wal_file directly.
+	
+	if (!options.readOnlyImmutable)
+	{
+		status = sqlite3_exec(aDb, "SELECT count(*) FROM sqlite_master;", NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogWarn(@"Error prewarming connection: %d %s", status, sqlite3_errmsg(aDb));
+			sqlite3_close(aDb);
+			return;
+		}
+		
+		sqlite3_file_control(aDb, "main", SQLITE_FCNTL_JOURNAL_POINTER, &wal_file);
+	}
+#endif
+	
+	if (![self connectionPoolEnqueue:aDb main_file:main_file wal_file:wal_file])
+	{
+		sqlite3_close(aDb);
+	}
+}
+
+/**
+ * Internal utility method to handle setting/resetting the timer.
+**/
+- (void)resetConnectionPoolTimer
+{
+	YDBLogAutoTrace();
+	
+	if (connectionPoolLifetime <= 0.0 || [connectionPoolValues count] == 0)
+	{
+		if (connectionPoolTimer)
+		{
+			dispatch_source_cancel(connectionPoolTimer);
+			connectionPoolTimer = NULL;
+		}
+		
+		return;
+	}
+	
+	BOOL isNewTimer = NO;
+	
+	if (connectionPoolTimer == NULL)
+	{
+		connectionPoolTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, internalQueue);
+		
+		__weak YapDatabase *weakSelf = self;
+		dispatch_source_set_event_handler(connectionPoolTimer, ^{ @autoreleasepool {
+			
+			__strong YapDatabase *strongSelf = weakSelf;
+			if (strongSelf)
+			{
+				[strongSelf handleConnectionPoolTimerFire];
+			}
+		}});
+		
+		#if !OS_OBJECT_USE_OBJC
+		dispatch_source_t timer = connectionPoolTimer;
+		dispatch_source_set_cancel_handler(connectionPoolTimer, ^{
+			dispatch_release(timer);
+		});
+		#endif
+		
+		isNewTimer = YES;
+	}
+	
+	NSDate *date = [connectionPoolDates objectAtIndex:0];
+	NSTimeInterval interval = [date timeIntervalSinceNow] + connectionPoolLifetime;
+	
+	dispatch_time_t tt = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(interval * NSEC_PER_SEC));
+	dispatch_source_set_timer(connectionPoolTimer, tt, DISPATCH_TIME_FOREVER, 0);
+	
+	if (isNewTimer) {
+		dispatch_resume(connectionPoolTimer);
+	}
+}
+
+/**
+ * Internal method to handle removing stale connections from the connection pool.
+**/
+- (void)handleConnectionPoolTimerFire
+{
+	YDBLogAutoTrace();
+	
+	NSDate *now = [NSDate date];
+	
+	BOOL done = NO;
+	while ([connectionPoolValues count] > 0 && !done)
+	{
+		NSTimeInterval interval = [[connectionPoolDates objectAtIndex:0] timeIntervalSinceDate:now] * -1.0;
+		
+		if ((interval >= connectionPoolLifetime) || (interval < 0))
+		{
+			NSDictionary *value = [connectionPoolValues objectAtIndex:0];
+			
+			sqlite3 *aDb = (sqlite3 *)[[value objectForKey:YDBConnectionPoolValueKey_db] pointerValue];
+			
+			YDBLogVerbose(@"Closing connection from pool: %p", aDb);
+			
+			int status = sqlite3_close(aDb);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error in sqlite_close: %d %s", status, sqlite3_errmsg(aDb));
+			}
+			
+			[connectionPoolValues removeObjectAtIndex:0];
+			[connectionPoolDates removeObjectAtIndex:0];
+		}
+		else
+		{
+			done = YES;
+		}
+	}
+	
+	[self resetConnectionPoolTimer];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Slow Query Log
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSTimeInterval)slowQueryThreshold
+{
+	__block NSTimeInterval threshold = 0;
+	
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		threshold = slowQueryThreshold;
+		
+	#pragma clang diagnostic pop
+	});
+	
+	return threshold;
+}
+
+- (void)setSlowQueryThreshold:(NSTimeInterval)threshold
+{
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		slowQueryThreshold = MAX(threshold, 0.0);
+		
+		uint64_t ticks = YapDatabaseSlowQueryThresholdTicks(slowQueryThreshold);
+		atomic_store_explicit(&slowQueryThresholdTicks, ticks, memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+- (double)slowQuerySampleRate
+{
+	__block double rate = 0;
+	
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		rate = slowQuerySampleRate;
+		
+	#pragma clang diagnostic pop
+	});
+	
+	return rate;
+}
+
+- (void)setSlowQuerySampleRate:(double)rate
+{
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (isnan(rate)) rate = 0.0;
+		slowQuerySampleRate = MIN(MAX(rate, 0.0), 1.0);
+		
+		uint32_t sampleThreshold;
+		if (slowQuerySampleRate >= 1.0)
+			sampleThreshold = UINT32_MAX;
+		else
+			sampleThreshold = (uint32_t)(slowQuerySampleRate * (double)UINT32_MAX);
+		
+		atomic_store_explicit(&slowQuerySampleThreshold, sampleThreshold, memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+- (void)setSlowQueryHandler:(YapDatabaseSlowQueryHandler)handler queue:(dispatch_queue_t)queue
+{
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		slowQueryHandler = [handler copy];
+		slowQueryHandlerQueue = handler ? (queue ?: dispatch_get_main_queue()) : nil;
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+/**
+ * Invoked (via YapDatabaseQueryProfileReport) when an extension query exceeds the slowQueryThreshold.
+**/
+- (void)reportSlowQuery:(YapDatabaseSlowQuery *)slowQuery
+{
+	__block YapDatabaseSlowQueryHandler handler = nil;
+	__block dispatch_queue_t handlerQueue = nil;
+	
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		handler = slowQueryHandler;
+		handlerQueue = slowQueryHandlerQueue;
+		
+	#pragma clang diagnostic pop
+	});
+	
+	if (handler)
+	{
+		dispatch_async(handlerQueue, ^{ @autoreleasepool {
+			
+			handler(slowQuery);
+		}});
+	}
+	else
+	{
+		YDBLogWarn(@"Slow query: %@", slowQuery);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark WAL Pinning
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)setWALPinningDurationThreshold:(NSTimeInterval)durationThreshold
+                        frameThreshold:(NSUInteger)frameThreshold
+                                 block:(YapDatabaseWALPinningBlock)block
+                                 queue:(dispatch_queue_t)queue
+{
+	dispatch_sync(snapshotQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		walPinningDurationThreshold = MAX(durationThreshold, 0.0);
+		walPinningFrameThreshold = frameThreshold;
+		walPinningBlock = [block copy];
+		walPinningQueue = block ? (queue ?: dispatch_get_main_queue()) : nil;
+		
+		walPinningReportedState = nil;
+		walPinningReportedSnapshot = 0;
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+/**
+ * Returns the state of the active read transaction holding the oldest snapshot,
+ * or nil if every active read transaction is on the latest snapshot.
+ * 
+ * This method must be invoked from within the snapshotQueue.
+**/
+- (YapDatabaseConnectionState *)oldestPinningState
+{
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	
+	YapDatabaseConnectionState *oldestState = nil;
+	
+	for (YapDatabaseConnectionState *state in connectionStates)
+	{
+		if (!state->activeReadTransaction) continue;
+		if (state->lastTransactionSnapshot >= snapshot) continue;
+		
+		if (oldestState == nil ||
+		    state->lastTransactionSnapshot < oldestState->lastTransactionSnapshot ||
+		   (state->lastTransactionSnapshot == oldestState->lastTransactionSnapshot &&
+		    state->lastTransactionTime < oldestState->lastTransactionTime))
+		{
+			oldestState = state;
+		}
+	}
+	
+	return oldestState;
+}
+
+/**
+ * Creates the report for the given reader.
+ * This method is invoked outside of the snapshotQueue.
+**/
+- (YapDatabaseWALPinningReport *)walPinningReportWithConnection:(YapDatabaseConnection *)connection
+                                       longLivedReadTransaction:(BOOL)longLivedReadTransaction
+                                                       snapshot:(uint64_t)readerSnapshot
+                                               databaseSnapshot:(uint64_t)databaseSnapshot
+                                                       duration:(NSTimeInterval)duration
+                                                        walSize:(uint64_t)walSize
+{
+	return [[YapDatabaseWALPinningReport alloc] initWithConnectionName:connection.name
+	                                          longLivedReadTransaction:longLivedReadTransaction
+	                                                          snapshot:readerSnapshot
+	                                                  databaseSnapshot:databaseSnapshot
+	                                                          duration:duration
+	                                                           walSize:walSize
+	                                                     walFrameCount:YapDatabaseWALFrameCount(walSize, pageSize)];
+}
+
+- (uint64_t)walFileSize
+{
+	NSDictionary *walAttributes =
+	  [[NSFileManager defaultManager] attributesOfItemAtPath:[self databasePath_wal] error:NULL];
+	
+	return [walAttributes fileSize];
+}
+
+/**
+ * This is a public method called to sample the oldest reader.
+**/
+- (YapDatabaseWALPinningReport *)walPinningReport
+{
+	__block BOOL found = NO;
+	__block YapDatabaseConnection *connection = nil;
+	__block BOOL longLivedReadTransaction = NO;
+	__block uint64_t readerSnapshot = 0;
+	__block uint64_t databaseSnapshot = 0;
+	__block uint64_t transactionTime = 0;
+	
+	dispatch_sync(snapshotQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		YapDatabaseConnectionState *state = [self oldestPinningState];
+		if (state)
+		{
+			found = YES;
+			connection = state->connection;
+			longLivedReadTransaction = state->longLivedReadTransaction;
+			readerSnapshot = state->lastTransactionSnapshot;
+			transactionTime = state->lastTransactionTime;
+		}
+		
+		databaseSnapshot = snapshot;
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	if (!found) return nil;
+	
+	NSTimeInterval duration = YapDatabaseTicksToSeconds(mach_absolute_time() - transactionTime);
+	
+	return [self walPinningReportWithConnection:connection
+	                   longLivedReadTransaction:longLivedReadTransaction
+	                                   snapshot:readerSnapshot
+	                           databaseSnapshot:databaseSnapshot
+	                                   duration:duration
+	                                    walSize:[self walFileSize]];
+}
+
+/**
+ * Invoked after each commit (within the snapshotQueue).
+ * 
+ * Reports the oldest reader if it exceeds the thresholds, and hasn't already been reported at its current snapshot.
+ * The WAL size is only checked once the duration threshold is exceeded.
+**/
+- (void)checkWALPinning
+{
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	
+	if (walPinningBlock == nil) return;
+	
+	YapDatabaseConnectionState *state = [self oldestPinningState];
+	if (state == nil) return;
+	
+	if (state == walPinningReportedState && state->lastTransactionSnapshot == walPinningReportedSnapshot) {
+		return; // Already reported
+	}
+	
+	NSTimeInterval duration = YapDatabaseTicksToSeconds(mach_absolute_time() - state->lastTransactionTime);
+	if (duration < walPinningDurationThreshold) return;
+	
+	uint64_t walSize = [self walFileSize];
+	if (YapDatabaseWALFrameCount(walSize, pageSize) < walPinningFrameThreshold) return;
+	
+	walPinningReportedState = state;
+	walPinningReportedSnapshot = state->lastTransactionSnapshot;
+	
+	BOOL longLivedReadTransaction = state->longLivedReadTransaction;
+	uint64_t readerSnapshot = state->lastTransactionSnapshot;
+	uint64_t databaseSnapshot = snapshot;
+	
+	YDBLogWarn(@"A %@ read transaction is pinning the WAL at snapshot %llu (database snapshot %llu) for %.1f seconds",
+	           (longLivedReadTransaction ? @"long-lived" : @"regular"), readerSnapshot, databaseSnapshot, duration);
+	
+	// The report is created on the walPinningQueue, outside of the snapshotQueue.
+	// (The connection must not be deallocated within the snapshotQueue. See issues #437, #441.)
+	
+	__strong YapDatabaseConnection *connection = state->connection;
+	
+	YapDatabaseWALPinningBlock block = walPinningBlock;
+	
+	dispatch_async(walPinningQueue, ^{ @autoreleasepool {
+		
+		YapDatabaseWALPinningReport *report =
+		  [self walPinningReportWithConnection:connection
+		              longLivedReadTransaction:longLivedReadTransaction
+		                              snapshot:readerSnapshot
+		                      databaseSnapshot:databaseSnapshot
+		                              duration:duration
+		                               walSize:walSize];
+		
+		block(report);
+	}});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Notification Coalescing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSTimeInterval)modifiedNotificationCoalescingInterval
+{
+	uint64_t nanos = atomic_load_explicit(&coalescingIntervalNanos, memory_order_relaxed);
+	
+	return (NSTimeInterval)nanos / (NSTimeInterval)NSEC_PER_SEC;
+}
+
+- (void)setModifiedNotificationCoalescingInterval:(NSTimeInterval)interval
+{
+	dispatch_sync(internalQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t nanos = (interval > 0.0) ? (uint64_t)(interval * NSEC_PER_SEC) : 0;
+		atomic_store_explicit(&coalescingIntervalNanos, nanos, memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+/**
+ * Invoked by a connection (on the main thread) after it posts a YapDatabaseModifiedNotification.
+**/
+- (void)coalesceModifiedNotification:(NSNotification *)notification
+{
+	NSAssert([NSThread isMainThread], @"Must be invoked on the main thread");
+	
+	if (coalescedNotifications)
+	{
+		// A batch is already scheduled
+		[coalescedNotifications addObject:notification];
+		return;
+	}
+	
+	uint64_t nanos = atomic_load_explicit(&coalescingIntervalNanos, memory_order_relaxed);
+	if (nanos == 0) return;
+	
+	coalescedNotifications = [[NSMutableArray alloc] initWithObjects:notification, nil];
+	
+	__weak YapDatabase *weakSelf = self;
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)nanos), dispatch_get_main_queue(), ^{ @autoreleasepool {
+		
+		[weakSelf postCoalescedNotification];
+	}});
+}
+
+- (void)postCoalescedNotification
+{
+	NSArray *notifications = coalescedNotifications;
+	coalescedNotifications = nil;
+	
+	if ([notifications count] == 0) return;
+	
+	[[NSNotificationCenter defaultCenter] postNotificationName:YapDatabaseModifiedCoalescedNotification
+	                                                    object:self
+	                                                  userInfo:@{ YapDatabaseModifiedNotificationsKey: notifications }];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Memory Tables
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * This method is only accessible from within the snapshotQueue.
+ * Used by [YapDatabaseConnection prepare].
 **/
-- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
-                      withName:(NSString *)extensionName
-               completionQueue:(dispatch_queue_t)completionQueue
-               completionBlock:(void(^)(BOOL ready))completionBlock
+- (NSDictionary *)registeredMemoryTables
 {
-	[self asyncRegisterExtension:extension
-	                    withName:extensionName
-	                      config:nil
-	             completionQueue:completionQueue
-	             completionBlock:completionBlock];
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	
+	return registeredMemoryTables;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Snapshot Architecture
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * Asynchronoulsy starts the extension registration process.
- * After registration everything works automatically using just the extension name.
+ * The snapshot represents when the database was last modified by a read-write transaction.
+ * This information isn persisted to the 'yap' database, and is separately held in memory.
+ * It serves multiple purposes.
  *
- * The registration process is equivalent to an asyncReadwrite transaction.
- * It involves persisting various information about the extension to the database,
- * as well as possibly populating the extension by enumerating existing rows in the database.
- * 
- * @param extension (required)
- *     The YapDatabaseExtension subclass instance you wish to register.
- *     For example, this might be a YapDatabaseView instance.
+ * First is assists in validation of a connection's cache.
+ * When a connection begins a new transaction, it may have items sitting in the cache.
+ * However the connection doesn't know if the items are still valid because another connection may have made changes.
  *
- * @param extensionName (required)
- *     This is an arbitrary string you assign to the extension.
- *     Once registered, you will generally access the extension instance via this name.
- *     For example: [[transaction ext:@"myView"] numberOfGroups];
- * 
- * @param config (optional)
- *     You may optionally pass a config for the internal databaseConnection used to perform
- *     the extension registration process. This allows you to control things such as the
- *     cache size, which is sometimes important for performance tuning.
+ * The snapshot also assists in correcting for a race condition.
+ * It order to minimize blocking we allow read-write transactions to commit outside the context
+ * of the snapshotQueue. This is because the commit may be a time consuming operation, and we
+ * don't want to block read-only transactions during this period. The race condition occurs if a read-only
+ * transactions starts in the midst of a read-write commit, and the read-only transaction gets
+ * a "yap-level" snapshot that's out of sync with the "sql-level" snapshot. This is easily correctable if caught.
+ * Thus we maintain the snapshot in memory, and fetchable via a select query.
+ * One represents the "yap-level" snapshot, and the other represents the "sql-level" snapshot.
  *
- * @param completionBlock (optional)
- *     An optional completion block may be used.
- *     If the extension registration was successful then the ready parameter will be YES.
- *     The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+ * The snapshot is simply a 64-bit integer.
+ * It is reset when the YapDatabase instance is initialized,
+ * and incremented by each read-write transaction (if changes are actually made).
 **/
-- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
-                      withName:(NSString *)extensionName
-                        config:(YapDatabaseConnectionConfig *)config
-               completionBlock:(void(^)(BOOL ready))completionBlock
+- (uint64_t)snapshot
 {
-	[self asyncRegisterExtension:extension
-	                    withName:extensionName
-	                      config:config
-	             completionQueue:NULL
-	             completionBlock:completionBlock];
+	// This method is called on just about every transaction.
+	// The snapshot is only modified within the snapshotQueue, but it's published atomically,
+	// so it can be read from any queue without waiting for the snapshotQueue.
+	
+	return atomic_load_explicit(&snapshot, memory_order_acquire);
 }
 
 /**
- * Asynchronoulsy starts the extension registration process.
- * After registration everything works automatically using just the extension name.
- *
- * The registration process is equivalent to an asyncReadwrite transaction.
- * It involves persisting various information about the extension to the database,
- * as well as possibly populating the extension by enumerating existing rows in the database.
- * 
- * @param extension (required)
- *     The YapDatabaseExtension subclass instance you wish to register.
- *     For example, this might be a YapDatabaseView instance.
- *
- * @param extensionName (required)
- *     This is an arbitrary string you assign to the extension.
- *     Once registered, you will generally access the extension instance via this name.
- *     For example: [[transaction ext:@"myView"] numberOfGroups];
- * 
- * @param config (optional)
- *     You may optionally pass a config for the internal databaseConnection used to perform
- *     the extension registration process. This allows you to control things such as the
- *     cache size, which is sometimes important for performance tuning.
- *
- * @param completionQueue (optional)
- *     The dispatch_queue to invoke the completion block may optionally be specified.
- *     If NULL, dispatch_get_main_queue() is automatically used.
- *
- * @param completionBlock (optional)
- *     An optional completion block may be used.
- *     If the extension registration was successful then the ready parameter will be YES.
+ * Returns the changesets whose snapshot is within the range (connectionSnapshot, maxSnapshot].
 **/
-- (void)asyncRegisterExtension:(YapDatabaseExtension *)extension
-                      withName:(NSString *)extensionName
-                        config:(YapDatabaseConnectionConfig *)config
-               completionQueue:(dispatch_queue_t)completionQueue
-               completionBlock:(void(^)(BOOL ready))completionBlock
+static NSMutableArray * YapDatabaseChangesetsInRange(NSArray *changesets,
+                                                     uint64_t connectionSnapshot, uint64_t maxSnapshot)
 {
-	if (completionQueue == NULL && completionBlock != NULL)
-		completionQueue = dispatch_get_main_queue();
-	
-	if (config)
-		config = [config copy];
+	NSUInteger capacity = (NSUInteger)(maxSnapshot - connectionSnapshot);
+	NSMutableArray *relevantChangesets = [NSMutableArray arrayWithCapacity:capacity];
 	
-	dispatch_async(writeQueue, ^{ @autoreleasepool {
-		
-		BOOL ready = [self _registerExtension:extension withName:extensionName config:config];
+	for (NSDictionary *changeset in changesets)
+	{
+		uint64_t changesetSnapshot = [[changeset objectForKey:YapDatabaseSnapshotKey] unsignedLongLongValue];
 		
-		if (completionBlock)
+		if ((changesetSnapshot > connectionSnapshot) && (changesetSnapshot <= maxSnapshot))
 		{
-			dispatch_async(completionQueue, ^{ @autoreleasepool {
-				
-				completionBlock(ready);
-			}});
+			[relevantChangesets addObject:changeset];
 		}
-	}});
+	}
+	
+	return relevantChangesets;
 }
 
 /**
- * This method unregisters an extension with the given name.
- * The associated underlying tables will be dropped from the database.
- * 
- * The unregistration process is equivalent to a (synchronous) readwrite transaction.
- * It involves deleting various information about the extension from the database,
- * as well as possibly dropping related tables the extension may have been using.
- *
- * @param extensionName (required)
- *     This is the arbitrary string you assigned to the extension when you registered it.
- *
- * Note 1:
- *   You don't need to re-register an extension in order to unregister it. For example,
- *   you've previously registered an extension (in previous app launches), but you no longer need the extension.
- *   You don't have to bother creating and registering the unneeded extension,
- *   just so you can unregister it and have the associated tables dropped.
- *   The database persists information about registered extensions, including the associated class of an extension.
- *   So you can simply pass the name of the extension, and the database system will use the associated class to
- *   drop the appropriate tables.
+ * This method is only accessible from within the snapshotQueue.
  *
- * Note 2:
- *   In fact, you don't even have to worry about unregistering extensions that you no longer need.
- *   That database system will automatically handle it for you.
- *   That is, upon completion of the first readWrite transaction (that makes changes), the database system will
- *   check to see if there are any "orphaned" extensions. That is, previously registered extensions that are
- *   no longer in use (and are now out-of-date because they didn't process the recent change(s) to the db).
- *   And it will automatically unregister these orhpaned extensions for you.
- *       
- * @see asyncUnregisterExtensionWithName:completionBlock:
- * @see asyncUnregisterExtensionWithName:completionQueue:completionBlock:
+ * The changesets array is immutable. Each modification creates a new array, which is published (swapped in)
+ * under the changesetsLock. So connections can grab the current array without going through the snapshotQueue.
 **/
-- (void)unregisterExtensionWithName:(NSString *)extensionName
+- (void)publishChangesets:(NSArray *)newChangesets
 {
-	dispatch_sync(writeQueue, ^{ @autoreleasepool {
-		
-		[self _unregisterExtensionWithName:extensionName];
-	}});
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	
+	NSArray *oldChangesets = nil;
+	
+	YAPUnfairLockLock(&changesetsLock);
+	{
+		oldChangesets = changesets;
+		changesets = newChangesets;
+	}
+	YAPUnfairLockUnlock(&changesetsLock);
+	
+	// The old array is released here, outside of the lock.
+	oldChangesets = nil;
 }
 
 /**
- * Asynchronoulsy starts the extension unregistration process.
+ * This method may be invoked from any queue.
  *
- * The unregistration process is equivalent to an asyncReadwrite transaction.
- * It involves deleting various information about the extension from the database,
- * as well as possibly dropping related tables the extension may have been using.
+ * Returns the pending & committed changesets within the range (connectionSnapshot, maxSnapshot],
+ * based on the most recently published changesets array.
  *
- * @param extensionName (required)
- *     This is the arbitrary string you assigned to the extension when you registered it.
+ * This is safe (without going through the snapshotQueue) because a changeset is only dropped once every connection
+ * has processed it on its connectionQueue. So a connection invoking this method from within its connectionQueue
+ * is guaranteed to find every changeset it hasn't processed yet, up to the database snapshot it observed.
  *
- * @param completionBlock (optional)
- *     An optional completion block may be used.
- *     The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+ * Not for use with enableMultiProcessSupport. (See pendingAndCommittedChangesetsSince:until:)
 **/
-- (void)asyncUnregisterExtensionWithName:(NSString *)extensionName
-                         completionBlock:(dispatch_block_t)completionBlock
+- (NSArray *)publishedChangesetsSince:(uint64_t)connectionSnapshot until:(uint64_t)maxSnapshot
 {
-	[self asyncUnregisterExtensionWithName:extensionName
-	                       completionQueue:NULL
-	                       completionBlock:completionBlock];
+	NSArray *currentChangesets = nil;
+	
+	YAPUnfairLockLock(&changesetsLock);
+	{
+		currentChangesets = changesets;
+	}
+	YAPUnfairLockUnlock(&changesetsLock);
+	
+	return YapDatabaseChangesetsInRange(currentChangesets, connectionSnapshot, maxSnapshot);
 }
 
 /**
- * Asynchronoulsy starts the extension unregistration process.
+ * This method is only accessible from within the snapshotQueue.
+ * 
+ * Prior to starting the sqlite commit, the connection must report its changeset to the database.
+ * The database will store the changeset, and provide it to other connections if needed (due to a race condition).
+ * 
+ * The following MUST be in the dictionary:
  *
- * The unregistration process is equivalent to an asyncReadwrite transaction.
- * It involves deleting various information about the extension from the database,
- * as well as possibly dropping related tables the extension may have been using.
+ * - snapshot : NSNumber with the changeset's snapshot
+**/
+- (void)notePendingChangeset:(NSDictionary *)pendingChangeset fromConnection:(YapDatabaseConnection *)sender
+{
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	NSAssert([pendingChangeset objectForKey:YapDatabaseSnapshotKey], @"Missing required change key: snapshot");
+	
+	// The sender is preparing to start the sqlite commit.
+	// We save the changeset in advance to handle possible edge cases.
+	
+	[self publishChangesets:[changesets arrayByAddingObject:pendingChangeset]];
+	
+	// The shared object cache must learn about the changes before any connection can see the new snapshot.
+	// Objects can only be published if the sender shares them (i.e. treats them as immutable).
+	
+	if (sharedObjectCache)
+	{
+		BOOL publishObjects = (sender != nil) && (sender->objectPolicy == YapDatabasePolicyShare);
+		
+		[sharedObjectCache noteChangeset:pendingChangeset publishObjects:publishObjects];
+	}
+	
+	YDBLogVerbose(@"Adding pending changeset %@ for database: %@",
+	              [[changesets lastObject] objectForKey:YapDatabaseSnapshotKey], self);
+}
+
+/**
+ * This method is only accessible from within the snapshotQueue.
  *
- * @param extensionName (required)
- *     This is the arbitrary string you assigned to the extension when you registered it.
+ * This method is used if a transaction finds itself in a race condition.
+ * That is, the transaction started before it was able to process changesets from sibling connections.
  *
- * @param completionQueue (optional)
- *     The dispatch_queue to invoke the completion block may optionally be specified.
- *     If NULL, dispatch_get_main_queue() is automatically used.
+ * It should fetch the changesets needed and then process them via [connection noteCommittedChangeset:].
  *
- * @param completionBlock (optional)
- *     An optional completion block may be used.
+ * Returns `nil` if the number of changesets found is not the expected one, that is, one for each snapshot increase from `connectionSnapshot` to `maxSnapshot`.
+ * This can only happen in multiprocess mode, if another process has updated the database,
+ * and the summaries of its changesets aren't available in the shared changelog (see sharedChangesetsSince:until:).
+ * In this case the changesets are invalid, and we need to clear connection and extension caches.
 **/
-- (void)asyncUnregisterExtensionWithName:(NSString *)extensionName
-                         completionQueue:(dispatch_queue_t)completionQueue
-                         completionBlock:(dispatch_block_t)completionBlock
+- (NSArray *)pendingAndCommittedChangesetsSince:(uint64_t)connectionSnapshot until:(uint64_t)maxSnapshot
 {
-	if (completionQueue == NULL && completionBlock != NULL)
-		completionQueue = dispatch_get_main_queue();
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
 	
-	dispatch_async(writeQueue, ^{ @autoreleasepool {
-		
-		[self _unregisterExtensionWithName:extensionName];
-		
-		if (completionBlock)
+	NSUInteger capacity = (NSUInteger)(maxSnapshot - connectionSnapshot);
+	NSMutableArray *relevantChangesets = YapDatabaseChangesetsInRange(changesets, connectionSnapshot, maxSnapshot);
+    
+	if (options.enableMultiProcessSupport)
+	{
+		const uint64_t expectedSnapshotsCount = maxSnapshot - connectionSnapshot;
+		if (expectedSnapshotsCount != relevantChangesets.count)
 		{
-			dispatch_async(completionQueue, ^{ @autoreleasepool {
+			// The database has been modified from another process.
+			// Fill in the gaps with the changesets from the shared changelog (if they're still available).
+			
+			NSMutableDictionary *changesetsBySnapshot =
+			  [NSMutableDictionary dictionaryWithCapacity:relevantChangesets.count];
+			
+			for (NSDictionary *changeset in relevantChangesets)
+			{
+				changesetsBySnapshot[changeset[YapDatabaseSnapshotKey]] = changeset;
+			}
+			
+			NSMutableArray *mergedChangesets = [NSMutableArray arrayWithCapacity:capacity];
+			
+			uint64_t gapStart = connectionSnapshot;
+			for (uint64_t changesetSnapshot = connectionSnapshot + 1; changesetSnapshot <= maxSnapshot; changesetSnapshot++)
+			{
+				NSDictionary *changeset = changesetsBySnapshot[@(changesetSnapshot)];
+				if (changeset == nil) continue;
 				
-				completionBlock();
-			}});
+				if (gapStart < (changesetSnapshot - 1))
+				{
+					NSArray *sharedChangesets = [self sharedChangesetsSince:gapStart until:(changesetSnapshot - 1)];
+					if (sharedChangesets == nil)
+					{
+						mergedChangesets = nil;
+						break;
+					}
+					
+					[mergedChangesets addObjectsFromArray:sharedChangesets];
+				}
+				
+				[mergedChangesets addObject:changeset];
+				gapStart = changesetSnapshot;
+			}
+			
+			if (mergedChangesets && (gapStart < maxSnapshot))
+			{
+				NSArray *sharedChangesets = [self sharedChangesetsSince:gapStart until:maxSnapshot];
+				if (sharedChangesets)
+					[mergedChangesets addObjectsFromArray:sharedChangesets];
+				else
+					mergedChangesets = nil;
+			}
+			
+			if (mergedChangesets == nil)
+			{
+				YDBLogVerbose(@"Expected snapshot count not found: expected(%llu) != found(%llu)."
+				              @" Database seems to have been modified from another process. Discarding changeset.",
+				              expectedSnapshotsCount, (uint64_t)relevantChangesets.count);
+			}
+			
+			return mergedChangesets;
 		}
-	}});
+	}
+	
+	return relevantChangesets;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Shared Changelog
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * Internal utility method.
- * Handles lazy creation and destruction of short-lived registrationConnection instance.
- * 
- * @see _registerExtension:withName:
- * @see _unregisterExtensionWithName:
+ * Keys for the changeset summaries in the shared changelog.
+ * The collection/key pairs are stored as flat arrays: @[ collection, key, collection, key, ... ]
 **/
-- (YapDatabaseConnection *)registrationConnection
+static NSString *const changelog_key_objectChanges      = @"o";
+static NSString *const changelog_key_objectTouches      = @"ot";
+static NSString *const changelog_key_metadataChanges    = @"m";
+static NSString *const changelog_key_metadataTouches    = @"mt";
+static NSString *const changelog_key_insertedKeys       = @"i";
+static NSString *const changelog_key_removedKeys        = @"r";
+static NSString *const changelog_key_removedRowids      = @"rr";
+static NSString *const changelog_key_removedCollections = @"rc";
+static NSString *const changelog_key_resetCollections   = @"xc";
+static NSString *const changelog_key_allKeysRemoved     = @"a";
+
+static void YapDatabaseChangelogAddKeys(NSMutableArray *flat, id<NSFastEnumeration> collectionKeys)
 {
-	if (registrationConnection == nil)
+	for (YapCollectionKey *ck in collectionKeys)
 	{
-		registrationConnection = [self newConnection];
-		registrationConnection.name = @"YapDatabase_extensionRegistrationConnection";
-		
-		// These are the rules (regarding instance retainCount):
-		// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
-		// - a YapDatabase instance cannot be deallocated if there are existing connections
-		//
-		// Thus, as long as registrationConnection is non-nil,
-		// 'self' (this YapDatabase instance) cannot be deallocated.
-		//
+		[flat addObject:ck.collection];
+		[flat addObject:ck.key];
+	}
+}
+
+static BOOL YapDatabaseChangelogGetKeys(NSArray *flat, void (^block)(YapCollectionKey *ck))
+{
+	if (flat == nil) return YES;
+	if (![flat isKindOfClass:[NSArray class]] || ([flat count] % 2) != 0) return NO;
+	
+	NSUInteger count = [flat count];
+	for (NSUInteger i = 0; i < count; i += 2)
+	{
+		NSString *collection = flat[i];
+		NSString *key = flat[i+1];
 		
-		__weak YapDatabase *weakSelf = self;
+		if (![collection isKindOfClass:[NSString class]] || ![key isKindOfClass:[NSString class]]) return NO;
 		
-		NSTimeInterval delayInSeconds = 5.0;
-		dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
-		dispatch_after(popTime, writeQueue, ^(void){
-			
-			__strong YapDatabase *strongSelf = weakSelf;
-			if (strongSelf)
-			{
-				strongSelf->registrationConnection = nil;
-			}
-		});
+		block(YapCollectionKeyCreate(collection, key));
 	}
 	
-	return registrationConnection;
+	return YES;
 }
 
 /**
- * Internal method that handles extension registration.
- * This method must be invoked on the writeQueue.
+ * Returns the (binary plist) summary of the given changeset,
+ * or nil if the changeset cannot be summarized (e.g. it registered an extension).
 **/
-- (BOOL)_registerExtension:(YapDatabaseExtension *)extension
-                  withName:(NSString *)extensionName
-                    config:(YapDatabaseConnectionConfig *)config
+- (NSData *)sharedChangelogSummaryForChangeset:(NSDictionary *)changeset
 {
-	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
-	
-	// Validate parameters
-	
-	if (extension == nil)
-	{
-		YDBLogError(@"Error registering extension: extension parameter is nil");
-		return NO;
-	}
-	if ([extensionName length] == 0)
+	if (changeset[YapDatabaseRegisteredExtensionsKey] || changeset[YapDatabaseRegisteredMemoryTablesKey])
 	{
-		YDBLogError(@"Error registering extension: extensionName parameter is nil or empty string");
-		return NO;
+		// Other processes need to re-read the registered extensions (i.e. flush everything).
+		return nil;
 	}
 	
-	// Check to ensure extension isn't already registered,
-	// or that the extensionName isn't already taken.
-	
-	NSDictionary *_registeredExtensions = [self registeredExtensions];
+	NSMutableDictionary *summary = [NSMutableDictionary dictionaryWithCapacity:8];
 	
-	if (extension.registeredName != nil)
-	{
-		YDBLogError(@"Error registering extension: extension is already registered");
-		return NO;
-	}
-	if ([_registeredExtensions objectForKey:extensionName] != nil)
+	void (^addChanges)(NSDictionary*, NSString*, NSString*) =
+	  ^(NSDictionary *changes, NSString *changesKey, NSString *touchesKey)
 	{
-		YDBLogError(@"Error registering extension: extensionName(%@) already registered", extensionName);
-		return NO;
-	}
-	
-	// Attempt registration
+		if ([changes count] == 0) return;
+		
+		id yapTouch = [YapTouch touch];
+		
+		NSMutableArray *changed = [NSMutableArray arrayWithCapacity:([changes count] * 2)];
+		__block NSMutableArray *touched = nil;
+		
+		[changes enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL __unused *stop) {
+		
+			__unsafe_unretained YapCollectionKey *ck = (YapCollectionKey *)key;
+			
+			if (value == yapTouch)
+			{
+				if (touched == nil)
+					touched = [NSMutableArray array];
+				
+				[touched addObject:ck.collection];
+				[touched addObject:ck.key];
+			}
+			else
+			{
+				[changed addObject:ck.collection];
+				[changed addObject:ck.key];
+			}
+		}];
+		
+		if ([changed count] > 0) summary[changesKey] = changed;
+		if ([touched count] > 0) summary[touchesKey] = touched;
+	};
 	
-	extension.registeredName = extensionName;
-	extension.registeredDatabase = self;
+	addChanges(changeset[YapDatabaseObjectChangesKey],
+	           changelog_key_objectChanges, changelog_key_objectTouches);
+	addChanges(changeset[YapDatabaseMetadataChangesKey],
+	           changelog_key_metadataChanges, changelog_key_metadataTouches);
 	
-	BOOL result = [extension supportsDatabaseWithRegisteredExtensions:_registeredExtensions];
-	if (!result)
+	NSSet *insertedKeys = changeset[YapDatabaseInsertedKeysKey];
+	if ([insertedKeys count] > 0)
 	{
-		YDBLogError(@"Error registering extension: extension doesn't support database configuration");
+		NSMutableArray *flat = [NSMutableArray arrayWithCapacity:([insertedKeys count] * 2)];
+		YapDatabaseChangelogAddKeys(flat, insertedKeys);
+		
+		summary[changelog_key_insertedKeys] = flat;
 	}
-	else
+	
+	NSSet *removedKeys = changeset[YapDatabaseRemovedKeysKey];
+	if ([removedKeys count] > 0)
 	{
-		YapDatabaseConnection *connection = [self registrationConnection];
-		
-		YapDatabaseConnectionConfig *originalConfig = nil;
-		if (config)
-		{
-			originalConfig = [connection copyConfig];
-			[connection applyConfig:config];
-		}
-		
-		result = [connection registerExtension:extension withName:extensionName];
+		NSMutableArray *flat = [NSMutableArray arrayWithCapacity:([removedKeys count] * 2)];
+		YapDatabaseChangelogAddKeys(flat, removedKeys);
 		
-		if (config)
-		{
-			[connection applyConfig:originalConfig];
-		}
+		summary[changelog_key_removedKeys] = flat;
 	}
 	
-	if (result)
+	YapRowidSetBox *removedRowids = changeset[YapDatabaseRemovedRowidsKey];
+	if (removedRowids && YapRowidSetCount(removedRowids->set) > 0)
 	{
-		[extension didRegisterExtension];
+		NSMutableArray *rowids = [NSMutableArray arrayWithCapacity:YapRowidSetCount(removedRowids->set)];
+		YapRowidSetEnumerate(removedRowids->set, ^(int64_t rowid, BOOL __unused *stop) {
+			
+			[rowids addObject:@(rowid)];
+		});
+		
+		summary[changelog_key_removedRowids] = rowids;
 	}
-	else
+	
+	NSSet *removedCollections = changeset[YapDatabaseRemovedCollectionsKey];
+	if ([removedCollections count] > 0)
 	{
-		extension.registeredName = nil;
-		extension.registeredDatabase = nil;
+		summary[changelog_key_removedCollections] = [removedCollections allObjects];
 	}
 	
-	
-	return result;
-}
-
-/**
- * Internal method that handles extension unregistration.
- * This method must be invoked on the writeQueue.
-**/
-- (void)_unregisterExtensionWithName:(NSString *)extensionName
-{
-	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
-	
-	// Validate parameters
-	
-	if ([extensionName length] == 0)
+	NSSet *resetCollections = changeset[YapDatabaseResetCollectionsKey];
+	if ([resetCollections count] > 0)
 	{
-		YDBLogError(@"Error unregistering extension: extensionName parameter is nil or empty string");
-		return;
+		summary[changelog_key_resetCollections] = [resetCollections allObjects];
 	}
 	
-	// Perform unregistration
-	
-	YapDatabaseConnection *connection = [self registrationConnection];
+	if ([changeset[YapDatabaseAllKeysRemovedKey] boolValue])
+	{
+		summary[changelog_key_allKeysRemoved] = @(YES);
+	}
 	
-	[connection unregisterExtensionWithName:extensionName];
+	return [NSPropertyListSerialization dataWithPropertyList:summary
+	                                                  format:NSPropertyListBinaryFormat_v1_0
+	                                                 options:0
+	                                                   error:NULL];
 }
 
 /**
- * Returns the registered extension with the given name.
+ * Converts a summary (from the shared changelog) into a changeset.
+ *
+ * The changed keys map to YapNull (or YapTouch), which makes connections drop them from their caches.
+ * The changeset also includes a YapDatabaseModifiedNotification (for long-lived read transactions),
+ * without any extension changes (YapDatabaseExtensionsKey), since those aren't in the summary.
 **/
-- (id)registeredExtension:(NSString *)extensionName
+- (NSDictionary *)changesetFromSharedChangelogSummary:(NSDictionary *)summary snapshot:(uint64_t)changesetSnapshot
 {
-	// This method is public
+	if (![summary isKindOfClass:[NSDictionary class]]) return nil;
 	
-	__block YapDatabaseExtension *result = nil;
+	NSMutableDictionary *changeset = [NSMutableDictionary dictionaryWithCapacity:12];
+	NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithCapacity:8];
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	changeset[YapDatabaseSnapshotKey] = @(changesetSnapshot);
+	changeset[YapDatabaseOtherProcessKey] = @(YES);
+	
+	userInfo[YapDatabaseSnapshotKey] = @(changesetSnapshot);
+	
+	BOOL (^getChanges)(NSString*, NSString*, NSString*) =
+	  ^BOOL (NSString *changesKey, NSString *touchesKey, NSString *changesetKey)
+	{
+		NSMutableDictionary *changes = [NSMutableDictionary dictionary];
 		
-		result = [registeredExtensions objectForKey:extensionName];
+		id yapNull = [YapNull null];
+		id yapTouch = [YapTouch touch];
 		
-	#pragma clang diagnostic pop
+		if (!YapDatabaseChangelogGetKeys(summary[touchesKey], ^(YapCollectionKey *ck) {
+			changes[ck] = yapTouch;
+		})) return NO;
+		
+		if (!YapDatabaseChangelogGetKeys(summary[changesKey], ^(YapCollectionKey *ck) {
+			changes[ck] = yapNull;
+		})) return NO;
+		
+		if ([changes count] > 0)
+		{
+			changeset[changesetKey] = changes;
+			userInfo[changesetKey] = [[YapSet alloc] initWithDictionary:changes];
+		}
+		return YES;
 	};
 	
-	if (dispatch_get_specific(IsOnSnapshotQueueKey))
-		block();
-	else
-		dispatch_sync(snapshotQueue, block);
-	
-	return result;
-}
-
-/**
- * Returns all currently registered extensions as a dictionary.
- * The key is the registed name (NSString), and the value is the extension (YapDatabaseExtension subclass).
-**/
-- (NSDictionary *)registeredExtensions
-{
-	// This method is public
-	
-	__block NSDictionary *extensionsCopy = nil;
-	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	BOOL (^getKeys)(NSString*, NSString*) = ^BOOL (NSString *summaryKey, NSString *changesetKey)
+	{
+		NSMutableSet *keys = [NSMutableSet set];
 		
-		extensionsCopy = registeredExtensions;
+		if (!YapDatabaseChangelogGetKeys(summary[summaryKey], ^(YapCollectionKey *ck) {
+			[keys addObject:ck];
+		})) return NO;
 		
-	#pragma clang diagnostic pop
+		if ([keys count] > 0)
+		{
+			changeset[changesetKey] = keys;
+			userInfo[changesetKey] = [[YapSet alloc] initWithSet:keys];
+		}
+		return YES;
 	};
 	
-	if (dispatch_get_specific(IsOnSnapshotQueueKey))
-		block();
-	else
-		dispatch_sync(snapshotQueue, block);
-	
-	return extensionsCopy;
-}
-
-/**
- * This method is only accessible from within the snapshotQueue.
- * Used by [YapDatabaseConnection prepare].
-**/
-- (NSArray *)extensionsOrder
-{
-	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
-	
-	return extensionsOrder;
-}
-
-/**
- * This method is only accessible from within the snapshotQueue.
- * Used by [YapDatabaseConnection prepare].
-**/
-- (NSDictionary *)extensionDependencies
-{
-	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	BOOL (^getCollections)(NSString*, NSString*) = ^BOOL (NSString *summaryKey, NSString *changesetKey)
+	{
+		NSArray *collections = summary[summaryKey];
+		if (collections == nil) return YES;
+		if (![collections isKindOfClass:[NSArray class]]) return NO;
+		
+		NSMutableSet *set = [NSMutableSet setWithArray:collections];
+		
+		changeset[changesetKey] = set;
+		userInfo[changesetKey] = [[YapSet alloc] initWithSet:set];
+		return YES;
+	};
 	
-	return extensionDependencies;
-}
-
-/**
- * Allows you to fetch the registered extension names from the last time the database was run.
- * Typically this means from the last time the app was run.
- *
- * This may be used to assist in various tasks, such as cleanup or upgrade tasks.
- *
- * If you need this information, you should fetch it early on because YapDatabase only maintains this information
- * until it sees you are done registering all your initial extensions. That is, after one initializes the database
- * they then immediately register any needed initial extensions before they begin to use the database. Once a
- * readWriteTransaction modifies the database, YapDatabase will take this opportunity to look for orphaned extensions.
- * These are extensions that were registered at the end of the last database session,
- * but which are no longer registered. YapDatabase will automatically cleanup these orphaned extensions,
- * and also clear the previouslyRegisteredExtensionNames information at this point.
-**/
-- (NSArray *)previouslyRegisteredExtensionNames
-{
-	__block NSArray *result = nil;
+	if (!getChanges(changelog_key_objectChanges, changelog_key_objectTouches, YapDatabaseObjectChangesKey)       ||
+	    !getChanges(changelog_key_metadataChanges, changelog_key_metadataTouches, YapDatabaseMetadataChangesKey) ||
+	    !getKeys(changelog_key_insertedKeys, YapDatabaseInsertedKeysKey)                                         ||
+	    !getKeys(changelog_key_removedKeys, YapDatabaseRemovedKeysKey)                                           ||
+	    !getCollections(changelog_key_removedCollections, YapDatabaseRemovedCollectionsKey)                      ||
+	    !getCollections(changelog_key_resetCollections, YapDatabaseResetCollectionsKey))
+	{
+		return nil;
+	}
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	NSArray *rowids = summary[changelog_key_removedRowids];
+	if (rowids)
+	{
+		if (![rowids isKindOfClass:[NSArray class]]) return nil;
 		
-		result = [previouslyRegisteredExtensionNames copy];
+		YapRowidSet *removedRowids = YapRowidSetCreate(0);
+		for (NSNumber *rowid in rowids)
+		{
+			YapRowidSetAdd(removedRowids, [rowid longLongValue]);
+		}
 		
-	#pragma clang diagnostic pop
-	};
+		changeset[YapDatabaseRemovedRowidsKey] = [[YapRowidSetBox alloc] initWithRowidSet:removedRowids];
+	}
 	
-	if (dispatch_get_specific(IsOnSnapshotQueueKey))
-		block();
-	else
-		dispatch_sync(snapshotQueue, block);
+	if ([summary[changelog_key_allKeysRemoved] boolValue])
+	{
+		changeset[YapDatabaseAllKeysRemovedKey] = @(YES);
+		userInfo[YapDatabaseAllKeysRemovedKey] = @(YES);
+	}
 	
-	return result;
+	changeset[YapDatabaseNotificationKey] =
+	  [NSNotification notificationWithName:YapDatabaseModifiedNotification object:self userInfo:userInfo];
+	
+	return changeset;
 }
 
-/**
- * It's sometimes useful to find out when all async registerExtension/unregisterExtension requests have completed.
- *
- * One way to accomplish this is simply to queue an asyncReadWriteTransaction on any databaseConnection.
- * Since all async register/unregister extension requests are immediately dispatch_async'd through the
- * internal serial writeQueue, you'll know that once your asyncReadWriteTransaction is running,
- * all previously scheduled register/unregister requests have completed.
- *
- * Although the above technique works, the 'flushExtensionRequestsWithCompletionQueue::'
- * is a more efficient way to accomplish this task. (And a more elegant & readable way too.)
- *
- * @param completionQueue
- *   The dispatch_queue to invoke the completionBlock on.
- *   If NULL, dispatch_get_main_queue() is automatically used.
- *
- * @param completionBlock
- *   The block to invoke once all previously scheduled register/unregister extension requests have completed.
- **/
-- (void)flushExtensionRequestsWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
-									       completionBlock:(nullable dispatch_block_t)completionBlock
+- (void)willCommitSharedChangeset:(NSDictionary *)changeset
 {
-	if (completionQueue == NULL && completionBlock != NULL)
-		completionQueue = dispatch_get_main_queue();
+	if (sharedChangelog == NULL) return;
 	
-	dispatch_async(writeQueue, ^{ @autoreleasepool {
-		
-		if (completionBlock)
-		{
-			dispatch_async(completionQueue, ^{ @autoreleasepool {
-				
-				completionBlock();
-			}});
-		}
-	}});
+	uint64_t changesetSnapshot = [changeset[YapDatabaseSnapshotKey] unsignedLongLongValue];
+	NSData *summary = [self sharedChangelogSummaryForChangeset:changeset];
+	
+	if (summary && ([summary length] > yap_shared_changelog_capacity(sharedChangelog)))
+	{
+		YDBLogVerbose(@"Changeset %llu is too large for the shared changelog (%lu bytes)",
+		              changesetSnapshot, (unsigned long)[summary length]);
+	}
+	
+	// If the summary is nil (or too large), the slot is invalidated,
+	// and other processes flush their caches for this snapshot (as usual).
+	
+	yap_shared_changelog_will_commit(sharedChangelog, changesetSnapshot, [summary bytes], [summary length]);
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Pooling
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+- (void)didCommitSharedChangeset:(NSDictionary *)changeset success:(BOOL)didCommit
+{
+	if (sharedChangelog == NULL) return;
+	
+	uint64_t changesetSnapshot = [changeset[YapDatabaseSnapshotKey] unsignedLongLongValue];
+	
+	yap_shared_changelog_did_commit(sharedChangelog, changesetSnapshot, didCommit);
+}
 
-- (NSUInteger)maxConnectionPoolCount
+- (NSArray *)sharedChangesetsSince:(uint64_t)fromSnapshot until:(uint64_t)toSnapshot
 {
-	__block NSUInteger count = 0;
+	if (sharedChangelog == NULL || toSnapshot <= fromSnapshot) return nil;
 	
-	dispatch_sync(internalQueue, ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	NSUInteger count = (NSUInteger)(toSnapshot - fromSnapshot);
+	NSMutableArray *sharedChangesets = [NSMutableArray arrayWithCapacity:count];
+	
+	NSMutableData *buffer = [NSMutableData dataWithLength:yap_shared_changelog_capacity(sharedChangelog)];
+	
+	for (uint64_t changesetSnapshot = fromSnapshot + 1; changesetSnapshot <= toSnapshot; changesetSnapshot++)
+	{
+		size_t length = 0;
+		if (!yap_shared_changelog_read(sharedChangelog, changesetSnapshot, [buffer mutableBytes], &length))
+		{
+			YDBLogVerbose(@"Changeset %llu is not available in the shared changelog", changesetSnapshot);
+			return nil;
+		}
 		
-		count = maxConnectionPoolCount;
+		NSData *data = [NSData dataWithBytes:[buffer mutableBytes] length:length];
 		
-	#pragma clang diagnostic pop
-	});
+		id summary = [NSPropertyListSerialization propertyListWithData:data
+		                                                       options:NSPropertyListImmutable
+		                                                        format:NULL
+		                                                         error:NULL];
+		
+		NSDictionary *changeset = [self changesetFromSharedChangelogSummary:summary snapshot:changesetSnapshot];
+		if (changeset == nil)
+		{
+			YDBLogWarn(@"Invalid summary for changeset %llu in the shared changelog", changesetSnapshot);
+			return nil;
+		}
+		
+		[sharedChangesets addObject:changeset];
+	}
 	
-	return count;
+	return sharedChangesets;
 }
 
-- (void)setMaxConnectionPoolCount:(NSUInteger)count
+/**
+ * This method is only accessible from within the snapshotQueue.
+ *
+ * Upon completion of a readwrite transaction, the connection should report it's changeset to the database.
+ * The database will then forward the changes to all other connection's.
+ *
+ * The following MUST be in the dictionary:
+ *
+ * - snapshot : NSNumber with the changeset's snapshot
+**/
+- (void)noteCommittedChangeset:(NSDictionary *)changeset fromConnection:(YapDatabaseConnection *)sender
 {
-	dispatch_sync(internalQueue, ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		// Update ivar
-		maxConnectionPoolCount = count;
-		
-		// Immediately drop any excess connections
-		if ([connectionPoolValues count] > maxConnectionPoolCount)
+	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	NSAssert([changeset objectForKey:YapDatabaseSnapshotKey], @"Missing required change key: snapshot");
+    
+	// The sender has finished the sqlite commit, and all data is now written to disk.
+	
+	// Update the in-memory snapshot,
+	// which represents the most recent snapshot of the last committed readwrite transaction.
+	
+	uint64_t changesetSnapshot = [[changeset objectForKey:YapDatabaseSnapshotKey] unsignedLongLongValue];
+	
+	atomic_store_explicit(&snapshot, changesetSnapshot, memory_order_release);
+	[self noteLatestSnapshotForCheckpointPolicy:changesetSnapshot];
+	[self checkWALPinning];
+	
+	// Update registeredExtensions, if changed.
+	
+	NSDictionary *newRegisteredExtensions = [changeset objectForKey:YapDatabaseRegisteredExtensionsKey];
+	if (newRegisteredExtensions)
+	{
+		registeredExtensions = newRegisteredExtensions;
+		extensionsOrder = [changeset objectForKey:YapDatabaseExtensionsOrderKey];
+		extensionDependencies = [changeset objectForKey:YapDatabaseExtensionDependenciesKey];
+	}
+	
+	// Update registeredMemoryTables, if changed.
+	
+	NSDictionary *newRegisteredMemoryTables = [changeset objectForKey:YapDatabaseRegisteredMemoryTablesKey];
+	if (newRegisteredMemoryTables)
+	{
+		registeredMemoryTables = newRegisteredMemoryTables;
+	}
+	
+	// Forward the changeset to all extensions.
+	
+	[registeredExtensions enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *extName, YapDatabaseExtension *ext, BOOL __unused *stop)
+	{
+		[ext noteCommittedChangeset:changeset registeredName:extName];
+	}];
+	
+	// Forward the changeset to all other connections so they can perform any needed updates.
+	// Generally this means updating the in-memory components such as the cache.
+	
+	NSMutableArray<YapDatabaseConnection *> *strongConnections = nil;
+	dispatch_group_t group = NULL;
+	
+	for (YapDatabaseConnectionState *state in connectionStates)
+	{
+		if (state->connection != sender)
 		{
-			do
+			// Create strong reference (state->connection is weak)
+			__strong YapDatabaseConnection *connection = state->connection;
+			
+			if (connection)
 			{
-				sqlite3 *aDb = (sqlite3 *)[[connectionPoolValues objectAtIndex:0] pointerValue];
+				if (strongConnections == nil)
+					strongConnections = [NSMutableArray array];
 				
-				int status = sqlite3_close(aDb);
-				if (status != SQLITE_OK)
-				{
-					YDBLogError(@"Error in sqlite_close: %d %s", status, sqlite3_errmsg(aDb));
-				}
+				[strongConnections addObject:connection];
 				
-				[connectionPoolValues removeObjectAtIndex:0];
-				[connectionPoolDates removeObjectAtIndex:0];
+				if (group == NULL)
+					group = dispatch_group_create();
 				
-			} while ([connectionPoolValues count] > maxConnectionPoolCount);
-			
-			[self resetConnectionPoolTimer];
+				dispatch_group_async(group, connection->connectionQueue, ^{ @autoreleasepool {
+					
+					[connection noteCommittedChangeset:changeset];
+				}});
+			}
 		}
-		
-	#pragma clang diagnostic pop
-	});
-}
-
-- (NSTimeInterval)connectionPoolLifetime
-{
-	__block NSTimeInterval lifetime = 0;
+	}
 	
-	dispatch_sync(internalQueue, ^{
+	// Schedule block to be executed once all connections have processed the changes.
+	
+	BOOL isInternalChangeset = (sender == nil);
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_block_t block = ^{
 	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
 		
-		lifetime = connectionPoolLifetime;
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		// All connections have now processed the changes.
+		// So we no longer need to retain the changeset in memory.
+		
+		if (isInternalChangeset)
+		{
+			YDBLogVerbose(@"Completed internal changeset %@ for database: %@",
+			              [changeset objectForKey:YapDatabaseSnapshotKey], self);
+		}
+		else
+		{
+			YDBLogVerbose(@"Dropping processed changeset %@ for database: %@",
+			              [changeset objectForKey:YapDatabaseSnapshotKey], self);
+			
+			NSArray *remainingChangesets = strongSelf->changesets;
+			remainingChangesets = [remainingChangesets subarrayWithRange:NSMakeRange(1, remainingChangesets.count - 1)];
+			
+			[strongSelf publishChangesets:remainingChangesets];
+		}
+		
+		#if !OS_OBJECT_USE_OBJC
+		if (group)
+			dispatch_release(group);
+		#endif
 		
 	#pragma clang diagnostic pop
-	});
+	};
 	
-	return lifetime;
+	if (group)
+		dispatch_group_notify(group, snapshotQueue, block);
+	else
+		block();
+	
+	if (strongConnections)
+	{
+		// Edge case protection:
+		// Bug fix for issues: #437, #441
+		//
+		// Deadlock crash if:
+		// - YapDatabase is the last one holding a strong reference to a YapDatabaseConnection instance
+		// - The [connection dealloc] call occurs within the snapshotQueue
+		//
+		// This is a workaround to ensure that the dealloc occurs outside the snapshotQueue.
+		//
+		dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{ @autoreleasepool {
+			[strongConnections removeAllObjects];
+		}});
+	}
 }
 
-- (void)setConnectionPoolLifetime:(NSTimeInterval)lifetime
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark SQLite Snapshots
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A connection may "detach" its long-lived read transaction.
+ * That is, it captures an sqlite3_snapshot, and then releases its sqlite read transaction.
+ * Each subsequent read on the connection re-opens the snapshot via sqlite3_snapshot_open.
+ *
+ * However, sqlite3_snapshot_open fails if a checkpoint has since copied newer frames into the database file,
+ * or if the WAL has been restarted. So something still needs to hold a read transaction at the oldest snapshot.
+ * Rather than every detached connection holding its own read transaction (at its own snapshot),
+ * the database holds a single read transaction (the pin) on a dedicated sqlite connection, at the oldest snapshot.
+ *
+ * As soon as the oldest detached connection moves forward, the pin moves forward too.
+ * In order to do so without a window in which a checkpoint could overwrite the next oldest snapshot,
+ * a second pin connection opens the new snapshot before the old pin is released.
+ *
+ * Returns NO if the snapshot couldn't be pinned, in which case the connection must keep its read transaction.
+**/
+- (BOOL)pinSQLiteSnapshot:(sqlite3_snapshot *)sqliteSnapshot
 {
-	dispatch_sync(internalQueue, ^{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+	if (sqliteSnapshot == NULL) return NO;
+	if (options.enableMultiProcessSupport) return NO;
+	
+	__block BOOL result = NO;
+	
+	dispatch_sync(checkpointQueue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		// Update ivar
-		connectionPoolLifetime = lifetime;
+		if (pinnedSQLiteSnapshots == nil)
+			pinnedSQLiteSnapshots = [[NSMutableArray alloc] init];
 		
-		// Update timer (if needed)
-		[self resetConnectionPoolTimer];
+		[pinnedSQLiteSnapshots addObject:[NSValue valueWithPointer:sqliteSnapshot]];
+		
+		result = [self updateSnapshotPin];
+		if (!result)
+		{
+			[pinnedSQLiteSnapshots removeLastObject];
+		}
 		
 	#pragma clang diagnostic pop
-	});
+	}});
+	
+	return result;
+#else
+	return NO;
+#endif
 }
 
 /**
- * Adds the given connection to the connection pool if possible.
- * 
- * Returns YES if the instance was added to the pool.
- * If so, the YapDatabaseConnection must not close the instance.
- * 
- * Returns NO if the instance was not added to the pool.
- * If so, the YapDatabaseConnection must close the instance.
+ * Invoked when a detached connection no longer needs the given snapshot.
+ * The caller must not free the snapshot until this method returns.
 **/
-- (BOOL)connectionPoolEnqueue:(sqlite3 *)aDb main_file:(yap_file *)main_file wal_file:(yap_file *)wal_file
+- (void)unpinSQLiteSnapshot:(sqlite3_snapshot *)sqliteSnapshot
 {
-	__block BOOL result = NO;
+#ifdef SQLITE_ENABLE_SNAPSHOT
+	if (sqliteSnapshot == NULL) return;
 	
-	dispatch_sync(internalQueue, ^{
+	dispatch_sync(checkpointQueue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		if ([connectionPoolValues count] < maxConnectionPoolCount)
+		[pinnedSQLiteSnapshots removeObject:[NSValue valueWithPointer:sqliteSnapshot]];
+		
+		if (![self updateSnapshotPin])
 		{
-			if (connectionPoolValues == nil)
-			{
-				connectionPoolValues = [[NSMutableArray alloc] init];
-				connectionPoolDates = [[NSMutableArray alloc] init];
-			}
-			
-			YDBLogVerbose(@"Enqueuing connection to pool: %p", aDb);
-			
-			NSDictionary *value = @{
-			  YDBConnectionPoolValueKey_db        : [NSValue valueWithPointer:(const void *)aDb],
-			  YDBConnectionPoolValueKey_main_file : [NSValue valueWithPointer:(const void *)main_file],
-			  YDBConnectionPoolValueKey_wal_file  : [NSValue valueWithPointer:(const void *)wal_file],
-			};
-			
-			[connectionPoolValues addObject:value];
-			[connectionPoolDates addObject:[NSDate date]];
-			
-			result = YES;
-			
-			if ([connectionPoolValues count] == 1)
-			{
-				[self resetConnectionPoolTimer];
-			}
+			YDBLogError(@"Unable to move the sqlite snapshot pin forward. Detached snapshots may be lost.");
 		}
 		
 	#pragma clang diagnostic pop
-	});
-	
-	return result;
+	}});
+#endif
 }
 
+#ifdef SQLITE_ENABLE_SNAPSHOT
+
 /**
- * Retrieves a connection from the connection pool if available.
- * Returns NULL if no connections are available.
+ * Moves the pin to the oldest pinned snapshot (or releases it, if there aren't any).
+ * This method must be invoked on the checkpointQueue.
 **/
-- (BOOL)connectionPoolDequeue:(sqlite3 **)pDb main_file:(yap_file **)pMainFile wal_file:(yap_file **)pWalFile
+- (BOOL)updateSnapshotPin
 {
-	NSParameterAssert(pDb != NULL);
-	NSParameterAssert(pMainFile != NULL);
-	NSParameterAssert(pWalFile != NULL);
-	
-	__block sqlite3 *aDb = NULL;
-	__block yap_file *main_file = NULL;
-	__block yap_file *wal_file = NULL;
+	sqlite3_snapshot *oldest = NULL;
 	
-	dispatch_sync(internalQueue, ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	for (NSValue *value in pinnedSQLiteSnapshots)
+	{
+		sqlite3_snapshot *sqliteSnapshot = (sqlite3_snapshot *)[value pointerValue];
 		
-		if ([connectionPoolValues count] > 0)
+		if (oldest == NULL || sqlite3_snapshot_cmp(sqliteSnapshot, oldest) < 0) {
+			oldest = sqliteSnapshot;
+		}
+	}
+	
+	if (oldest == NULL)
+	{
+		if (snapshotPin)
 		{
-			NSDictionary *value = [connectionPoolValues objectAtIndex:0];
-			
-			aDb       = (sqlite3 *)[[value objectForKey:YDBConnectionPoolValueKey_db] pointerValue];
-			main_file = (yap_file *)[[value objectForKey:YDBConnectionPoolValueKey_main_file] pointerValue];
-			wal_file  = (yap_file *)[[value objectForKey:YDBConnectionPoolValueKey_wal_file] pointerValue];
-			
-			YDBLogVerbose(@"Dequeuing connection from pool: %p", aDb);
+			sqlite3_exec(snapshotPinDbs[snapshotPinIndex], "COMMIT TRANSACTION;", NULL, NULL, NULL);
 			
-			[connectionPoolValues removeObjectAtIndex:0];
-			[connectionPoolDates removeObjectAtIndex:0];
+			sqlite3_snapshot_free(snapshotPin);
+			snapshotPin = NULL;
+		}
+		
+		return YES;
+	}
+	
+	if (snapshotPin && sqlite3_snapshot_cmp(snapshotPin, oldest) == 0)
+	{
+		// Already pinned
+		return YES;
+	}
+	
+	int pinIndex = snapshotPin ? (1 - snapshotPinIndex) : snapshotPinIndex;
+	
+	if (snapshotPinDbs[pinIndex] == NULL)
+	{
+		int flags = [self sqliteOpenFlags:(SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE)];
+		
+		int status = sqlite3_open_v2([[self sqliteOpenFilename] UTF8String], &snapshotPinDbs[pinIndex], flags,
+		                             [memory_vfs_name UTF8String]);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error opening snapshot pin connection: %d", status);
 			
-			[self resetConnectionPoolTimer];
+			sqlite3_close(snapshotPinDbs[pinIndex]);
+			snapshotPinDbs[pinIndex] = NULL;
+			return NO;
 		}
 		
-	#pragma clang diagnostic pop
-	});
+	#ifdef SQLITE_HAS_CODEC
+		[self configureEncryptionForDatabase:snapshotPinDbs[pinIndex]];
+	#endif
+	}
 	
-	*pDb = aDb;
-	*pMainFile = main_file;
-	*pWalFile = wal_file;
+	sqlite3 *pinDb = snapshotPinDbs[pinIndex];
 	
-	return (aDb != NULL);
+	// Open the new pin before releasing the old one.
+	// The old pin protects the new (newer) snapshot in the meantime.
+	
+	sqlite3_exec(pinDb, "BEGIN DEFERRED TRANSACTION;", NULL, NULL, NULL);
+	
+	int status = sqlite3_snapshot_open(pinDb, "main", oldest);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error pinning sqlite snapshot: %d %s", status, sqlite3_errmsg(pinDb));
+		
+		sqlite3_exec(pinDb, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		return NO;
+	}
+	
+	sqlite3_snapshot *newPin = NULL;
+	sqlite3_snapshot_get(pinDb, "main", &newPin);
+	
+	if (snapshotPin)
+	{
+		sqlite3_exec(snapshotPinDbs[snapshotPinIndex], "COMMIT TRANSACTION;", NULL, NULL, NULL);
+		sqlite3_snapshot_free(snapshotPin);
+	}
+	
+	snapshotPin = newPin;
+	snapshotPinIndex = pinIndex;
+	
+	return YES;
 }
 
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Manual Checkpointing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * Internal utility method to handle setting/resetting the timer.
+ * This method should be called whenever the maximum checkpointable snapshot is incremented.
+ * That is, the state of every connection is known to the system.
+ * And a snaphot cannot be checkpointed until every connection is at or past that snapshot.
+ * Thus, we can know the point at which a snapshot becomes checkpointable,
+ * and we can thus optimize the checkpoint invocations such that
+ * each invocation is able to checkpoint one or more commits.
 **/
-- (void)resetConnectionPoolTimer
+- (void)asyncCheckpoint:(uint64_t)maxCheckpointableSnapshot
 {
-	YDBLogAutoTrace();
+	if (maxCheckpointableSnapshot > 0) {
+		YDBLogVerbose(@"Checkpoint possible up to snapshot %llu", maxCheckpointableSnapshot);
+	}
 	
-	if (connectionPoolLifetime <= 0.0 || [connectionPoolValues count] == 0)
+	[self asyncDeleteExternalBlobs:maxCheckpointableSnapshot];
+	[self asyncDeleteColdBlobs:maxCheckpointableSnapshot];
+	
+	if (checkpointPolicy)
 	{
-		if (connectionPoolTimer)
+		YAPUnfairLockLock(&checkpointPolicyLock);
 		{
-			dispatch_source_cancel(connectionPoolTimer);
-			connectionPoolTimer = NULL;
+			latestCheckpointableSnapshot = MAX(latestCheckpointableSnapshot, maxCheckpointableSnapshot);
 		}
+		YAPUnfairLockUnlock(&checkpointPolicyLock);
 		
+		[self asyncPolicyCheckpoint];
 		return;
 	}
 	
-	BOOL isNewTimer = NO;
-	
-	if (connectionPoolTimer == NULL)
+	bool aggressive = atomic_load(&aggressiveCheckpointEnabled);
+	if (aggressive)
 	{
-		connectionPoolTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, internalQueue);
+		[self asyncAggressiveCheckpoint];
+	}
+	else
+	{
+		[self asyncPassiveCheckpoint];
+	}
+}
+
+- (void)asyncPassiveCheckpoint
+{
+	bool hasPendingCheckpoint = atomic_flag_test_and_set(&pendingPassiveCheckpoint);
+	if (hasPendingCheckpoint) {
+		return;
+	}
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_async(checkpointQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
 		
-		__weak YapDatabase *weakSelf = self;
-		dispatch_source_set_event_handler(connectionPoolTimer, ^{ @autoreleasepool {
-			
-			__strong YapDatabase *strongSelf = weakSelf;
-			if (strongSelf)
-			{
-				[strongSelf handleConnectionPoolTimerFire];
-			}
-		}});
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
 		
-		#if !OS_OBJECT_USE_OBJC
-		dispatch_source_t timer = connectionPoolTimer;
-		dispatch_source_set_cancel_handler(connectionPoolTimer, ^{
-			dispatch_release(timer);
-		});
-		#endif
+		atomic_flag_clear(&strongSelf->pendingPassiveCheckpoint);
 		
-		isNewTimer = YES;
+		if (atomic_load(&strongSelf->aggressiveCheckpointEnabled)) {
+			return;
+		}
+		
+		YDBSignpostID signpost = YDBSignpostBegin("Checkpoint", "mode: %{public}s", "passive");
+		
+		[strongSelf passiveCheckpoint];
+		
+		YDBSignpostEnd(signpost, "Checkpoint");
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (void)asyncAggressiveCheckpoint
+{
+	bool hasPendingCheckpoint = atomic_flag_test_and_set(&pendingAggressiveCheckpoint);
+	if (hasPendingCheckpoint) {
+		return;
 	}
 	
-	NSDate *date = [connectionPoolDates objectAtIndex:0];
-	NSTimeInterval interval = [date timeIntervalSinceNow] + connectionPoolLifetime;
-	
-	dispatch_time_t tt = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(interval * NSEC_PER_SEC));
-	dispatch_source_set_timer(connectionPoolTimer, tt, DISPATCH_TIME_FOREVER, 0);
+	__weak YapDatabase *weakSelf = self;
 	
-	if (isNewTimer) {
-		dispatch_resume(connectionPoolTimer);
-	}
+	dispatch_async(writeQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		atomic_flag_clear(&strongSelf->pendingAggressiveCheckpoint);
+		
+		if (!atomic_load(&strongSelf->aggressiveCheckpointEnabled)) {
+			return;
+		}
+		
+		YDBSignpostID signpost = YDBSignpostBegin("Checkpoint", "mode: %{public}s", "aggressive");
+		
+		[strongSelf aggressiveCheckpoint];
+		
+		YDBSignpostEnd(signpost, "Checkpoint");
+		
+	#pragma clang diagnostic pop
+	});
 }
 
-/**
- * Internal method to handle removing stale connections from the connection pool.
-**/
-- (void)handleConnectionPoolTimerFire
+- (void)passiveCheckpoint
 {
-	YDBLogAutoTrace();
+	int checkpointResult = 0;
+	int totalFrameCount = 0;
+	int checkpointedFrameCount = 0;
 	
-	NSDate *now = [NSDate date];
+	// We're going to execute a passive checkpoint.
+	// That is, without disrupting any connections, we're going to write pages from the WAL into the database.
+	// The checkpoint can only write pages from snapshots if all connections are at or beyond the snapshot.
+	// Thus, this method is only called by a connection that moves the min snapshot forward.
+	
+	checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE,
+	                                             &totalFrameCount, &checkpointedFrameCount);
+	
+	// totalFrameCount        = total number of frames in the WAL file
+	// checkpointedFrameCount = total number of checkpointed frames (those copied into db file)
+	//                          (including any that were already checkpointed before the function was called)
+	
+	YDBLogVerbose(@"Post-checkpoint: src(a) mode(passive) result(%d) frames(%d) checkpointed(%d)",
+	              checkpointResult, totalFrameCount, checkpointedFrameCount);
 	
-	BOOL done = NO;
-	while ([connectionPoolValues count] > 0 && !done)
+	if (checkpointResult != SQLITE_OK)
 	{
-		NSTimeInterval interval = [[connectionPoolDates objectAtIndex:0] timeIntervalSinceDate:now] * -1.0;
-		
-		if ((interval >= connectionPoolLifetime) || (interval < 0))
-		{
-			NSDictionary *value = [connectionPoolValues objectAtIndex:0];
-			
-			sqlite3 *aDb = (sqlite3 *)[[value objectForKey:YDBConnectionPoolValueKey_db] pointerValue];
-			
-			YDBLogVerbose(@"Closing connection from pool: %p", aDb);
-			
-			int status = sqlite3_close(aDb);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"Error in sqlite_close: %d %s", status, sqlite3_errmsg(aDb));
-			}
-			
-			[connectionPoolValues removeObjectAtIndex:0];
-			[connectionPoolDates removeObjectAtIndex:0];
+		if (checkpointResult == SQLITE_BUSY) {
+			YDBLogVerbose(@"sqlite3_wal_checkpoint_v2 returned SQLITE_BUSY");
 		}
-		else
-		{
-			done = YES;
+		else {
+			YDBLogWarn(@"sqlite3_wal_checkpoint_v2 returned error code: %d", checkpointResult);
 		}
+		
+		return;// from_block
 	}
 	
-	[self resetConnectionPoolTimer];
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Memory Tables
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-/**
- * This method is only accessible from within the snapshotQueue.
- * Used by [YapDatabaseConnection prepare].
-**/
-- (NSDictionary *)registeredMemoryTables
-{
-	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	[self updateMMapSizeTarget];
+	[self asyncIncrementalVacuum];
+	[self asyncOptimize];
 	
-	return registeredMemoryTables;
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Snapshot Architecture
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-/**
- * The snapshot represents when the database was last modified by a read-write transaction.
- * This information isn persisted to the 'yap' database, and is separately held in memory.
- * It serves multiple purposes.
- *
- * First is assists in validation of a connection's cache.
- * When a connection begins a new transaction, it may have items sitting in the cache.
- * However the connection doesn't know if the items are still valid because another connection may have made changes.
- *
- * The snapshot also assists in correcting for a race condition.
- * It order to minimize blocking we allow read-write transactions to commit outside the context
- * of the snapshotQueue. This is because the commit may be a time consuming operation, and we
- * don't want to block read-only transactions during this period. The race condition occurs if a read-only
- * transactions starts in the midst of a read-write commit, and the read-only transaction gets
- * a "yap-level" snapshot that's out of sync with the "sql-level" snapshot. This is easily correctable if caught.
- * Thus we maintain the snapshot in memory, and fetchable via a select query.
- * One represents the "yap-level" snapshot, and the other represents the "sql-level" snapshot.
- *
- * The snapshot is simply a 64-bit integer.
- * It is reset when the YapDatabase instance is initialized,
- * and incremented by each read-write transaction (if changes are actually made).
-**/
-- (uint64_t)snapshot
-{
-	if (dispatch_get_specific(IsOnSnapshotQueueKey))
-	{
-		// Very common case.
-		// This method is called on just about every transaction.
-		return snapshot;
-	}
-	else
+	// Did we checkpoint the entire WAL file ?
+	
+	BOOL didCheckpointEntireWAL = (totalFrameCount == checkpointedFrameCount);
+	
+	if (didCheckpointEntireWAL)
 	{
-		// Non-common case.
-		// Public access implementation.
-		__block uint64_t result = 0;
+		// We've checkpointed every single frame in the WAL.
+		// This means the next read-write transaction may be able to reset the WAL (instead of appending to it).
+		//
+		// However, the WAL reset will get spoiled if there are active read-only transactions that
+		// were started before our checkpoint finished, and continue to exist during the next read-write.
+		// It's not a big deal if the occasional read-only transaction happens to spoil the WAL reset.
+		// In those cases, the WAL generally gets reset shortly thereafter (on a subsequent write).
+		// Long-lived read transactions are a different case entirely.
+		// These transactions spoil it every single time, and could potentially cause the WAL to grow indefinitely.
+		//
+		// The solution is to notify active long-lived connections, and tell them to re-begin their transaction
+		// on the same snapshot. But this time the sqlite machinery will read directly from the database,
+		// and thus unlock the WAL so it can be reset.
+		
+		__weak YapDatabase *weakSelf = self;
 		
-		dispatch_sync(snapshotQueue, ^{
+		dispatch_async(writeQueue, ^{ @autoreleasepool {
 		#pragma clang diagnostic push
-		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
+			
+			__strong YapDatabase *strongSelf = weakSelf;
+			if (strongSelf == nil) return;
 			
-			result = snapshot;
+			[strongSelf tryResetLongLivedReadTransactions];
 			
 		#pragma clang diagnostic pop
-		});
+		}});
+	}
+	
+	// Is the WAL file getting too big ?
+	
+	uint64_t walApproximateFileSize = totalFrameCount * pageSize;
+	BOOL needsAggressiveCheckpoint = (walApproximateFileSize >= options.aggressiveWALTruncationSize);
+	
+	if (needsAggressiveCheckpoint)
+	{
+		atomic_store(&aggressiveCheckpointEnabled, true);
 		
-		return result;
+		[self asyncAggressiveCheckpoint];
 	}
 }
 
-/**
- * This method is only accessible from within the snapshotQueue.
- * 
- * Prior to starting the sqlite commit, the connection must report its changeset to the database.
- * The database will store the changeset, and provide it to other connections if needed (due to a race condition).
- * 
- * The following MUST be in the dictionary:
- *
- * - snapshot : NSNumber with the changeset's snapshot
-**/
-- (void)notePendingChangeset:(NSDictionary *)pendingChangeset fromConnection:(YapDatabaseConnection __unused *)sender
+- (void)aggressiveCheckpoint
 {
-	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
-	NSAssert([pendingChangeset objectForKey:YapDatabaseSnapshotKey], @"Missing required change key: snapshot");
+	int checkpointResult = 0;
+	int totalFrameCount = 0;
+	int checkpointedFrameCount = 0;
 	
-	// The sender is preparing to start the sqlite commit.
-	// We save the changeset in advance to handle possible edge cases.
+	// First we set an adequate busy timeout on our database connection.
+	// We're going to run a non-passive checkpoint.
+	// Which may cause it to busy-wait while waiting on read transactions to complete.
 	
-	[changesets addObject:pendingChangeset];
+	sqlite3_busy_timeout(db, 50); // milliseconds
 	
-	YDBLogVerbose(@"Adding pending changeset %@ for database: %@",
-	              [[changesets lastObject] objectForKey:YapDatabaseSnapshotKey], self);
-}
-
-/**
- * This method is only accessible from within the snapshotQueue.
- *
- * This method is used if a transaction finds itself in a race condition.
- * That is, the transaction started before it was able to process changesets from sibling connections.
- *
- * It should fetch the changesets needed and then process them via [connection noteCommittedChangeset:].
- *
- * Returns `nil` if the number of changesets found is not the expected one, that is, one for each snapshot increase from `connectionSnapshot` to `maxSnapshot`.
- * This can only happen in multiprocess mode, if another process has updated the database.
- * In this case the changesets are invalid, and we need to clear connection and extension caches.
-**/
-- (NSArray *)pendingAndCommittedChangesetsSince:(uint64_t)connectionSnapshot until:(uint64_t)maxSnapshot
-{
-	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
+	// Step 1 of 3:
+	//
+	// Perform FULL checkpoint.
+	//
+	// This will checkpoint as many frames as possible,
+	// and busy-wait until all readers are on the latest commit.
 	
-	NSUInteger capacity = (NSUInteger)(maxSnapshot - connectionSnapshot);
-	NSMutableArray *relevantChangesets = [NSMutableArray arrayWithCapacity:capacity];
-    
-	for (NSDictionary *changeset in changesets)
+	checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_FULL,
+	                                             &totalFrameCount, &checkpointedFrameCount);
+	
+	YDBLogInfo(@"Post-checkpoint: src(b) mode(full) result(%d) frames(%d) checkpointed(%d)",
+	           checkpointResult, totalFrameCount, checkpointedFrameCount);
+	
+	if (checkpointResult == SQLITE_OK)
 	{
-		uint64_t changesetSnapshot = [[changeset objectForKey:YapDatabaseSnapshotKey] unsignedLongLongValue];
-		
-		if ((changesetSnapshot > connectionSnapshot) && (changesetSnapshot <= maxSnapshot))
-		{
-			[relevantChangesets addObject:changeset];
-		}
+		[self updateMMapSizeTarget];
 	}
-    
-	if (options.enableMultiProcessSupport)
+	
+	if (totalFrameCount != checkpointedFrameCount)
 	{
-		const uint64_t expectedSnapshotsCount = maxSnapshot - connectionSnapshot;
-		if (expectedSnapshotsCount != relevantChangesets.count)
-		{
-			YDBLogVerbose(@"Expected snapshot count not found: expected(%llu) != found(%llu)."
-			              @" Database seems to have been modified from another process. Discarding changeset.",
-			              expectedSnapshotsCount, (uint64_t)relevantChangesets.count);
-			return nil;
-		}
+		return;
 	}
 	
-	return relevantChangesets;
-}
-
-/**
- * This method is only accessible from within the snapshotQueue.
- *
- * Upon completion of a readwrite transaction, the connection should report it's changeset to the database.
- * The database will then forward the changes to all other connection's.
- *
- * The following MUST be in the dictionary:
- *
- * - snapshot : NSNumber with the changeset's snapshot
-**/
-- (void)noteCommittedChangeset:(NSDictionary *)changeset fromConnection:(YapDatabaseConnection *)sender
-{
-	NSAssert(dispatch_get_specific(IsOnSnapshotQueueKey), @"Must go through snapshotQueue for atomic access.");
-	NSAssert([changeset objectForKey:YapDatabaseSnapshotKey], @"Missing required change key: snapshot");
-    
-	// The sender has finished the sqlite commit, and all data is now written to disk.
+	// STEP 2 of 3:
+	//
+	// Check for longLivedReadTransactions, and attempt to silently move them to reading directly from the database.
+	// (As oppossed to reading from the latest commit in the WAL.)
 	
-	// Update the in-memory snapshot,
-	// which represents the most recent snapshot of the last committed readwrite transaction.
+	if (![self tryResetLongLivedReadTransactions])
+	{
+		YDBLogInfo(@"Aggressive checkpoint spoiled: longLivedReadTransaction is blocking");
+		return;
+	}
 	
-	snapshot = [[changeset objectForKey:YapDatabaseSnapshotKey] unsignedLongLongValue];
-
-	// Update registeredExtensions, if changed.
+	// STEP 3 of 3:
+	//
+	// Perform TRUNCATE checkpoint.
+	//
+	// At this point, we've checkpointed every single frame.
+	// And every connection should be reading directly from the database.
+	// So we should be able to truncate the WAL file now.
+	
+	// Can we use SQLITE_CHECKPOINT_TRUNCATE ?
+	//
+	// This feature was added in sqlite v3.8.8.
+	// But it was buggy until v3.8.8.2 when the following fix was added:
+	//
+	//   "Enhance sqlite3_wal_checkpoint_v2(TRUNCATE) interface so that it truncates the
+	//    WAL file even if there is no checkpoint work to be done."
+	//
+	//   http://www.sqlite.org/changes.html
+	//
+	// It is often the case, when we call checkpoint here, that there is no checkpoint work to be done.
+	// So we really can't depend on it until 3.8.8.2
+	
+	int checkpointMode = SQLITE_CHECKPOINT_RESTART;
+	
+	// Remember: The compiler defines (SQLITE_VERSION, SQLITE_VERSION_NUMBER) only tell us
+	// what version we're compiling against. But we may encounter an earlier sqlite version at runtime.
+	
+#ifndef SQLITE_VERSION_NUMBER_3_8_8
+#define SQLITE_VERSION_NUMBER_3_8_8 3008008
+#endif
+	
+#if SQLITE_VERSION_NUMBER > SQLITE_VERSION_NUMBER_3_8_8
 	
-	NSDictionary *newRegisteredExtensions = [changeset objectForKey:YapDatabaseRegisteredExtensionsKey];
-	if (newRegisteredExtensions)
-	{
-		registeredExtensions = newRegisteredExtensions;
-		extensionsOrder = [changeset objectForKey:YapDatabaseExtensionsOrderKey];
-		extensionDependencies = [changeset objectForKey:YapDatabaseExtensionDependenciesKey];
-	}
+	checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
 	
-	// Update registeredMemoryTables, if changed.
+#elif SQLITE_VERSION_NUMBER == SQLITE_VERSION_NUMBER_3_8_8
 	
-	NSDictionary *newRegisteredMemoryTables = [changeset objectForKey:YapDatabaseRegisteredMemoryTablesKey];
-	if (newRegisteredMemoryTables)
+	NSComparisonResult cmp = [strongSelf->sqliteVersion compare:@"3.8.8.2" options:NSNumericSearch];
+	if (cmp != NSOrderedAscending)
 	{
-		registeredMemoryTables = newRegisteredMemoryTables;
+		checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
 	}
 	
-	// Forward the changeset to all extensions.
-	
-	[registeredExtensions enumerateKeysAndObjectsUsingBlock:
-	    ^(NSString *extName, YapDatabaseExtension *ext, BOOL __unused *stop)
-	{
-		[ext noteCommittedChangeset:changeset registeredName:extName];
-	}];
+#endif
 	
-	// Forward the changeset to all other connections so they can perform any needed updates.
-	// Generally this means updating the in-memory components such as the cache.
+	checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", checkpointMode,
+	                                             &totalFrameCount, &checkpointedFrameCount);
 	
-	NSMutableArray<YapDatabaseConnection *> *strongConnections = nil;
-	dispatch_group_t group = NULL;
+	YDBLogInfo(@"Post-checkpoint: src(c) mode(%@) result(%d) frames(%d) checkpointed(%d)",
+	           (checkpointMode == SQLITE_CHECKPOINT_RESTART ? @"restart" : @"truncate"),
+	           checkpointResult, totalFrameCount, checkpointedFrameCount);
 	
-	for (YapDatabaseConnectionState *state in connectionStates)
+	if (checkpointResult == SQLITE_OK)
 	{
-		if (state->connection != sender)
+		if (checkpointMode == SQLITE_CHECKPOINT_RESTART)
 		{
-			// Create strong reference (state->connection is weak)
-			__strong YapDatabaseConnection *connection = state->connection;
+			// Write something to the database to force restart the WAL.
+			// We're just going to set a random value in the yap2 table.
 			
-			if (connection)
+			NSString *uuid = [[NSUUID UUID] UUIDString];
+			
+			[self beginTransaction];
+			
+			int status;
+			sqlite3_stmt *statement;
+			
+			char *stmt = "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\") VALUES (?, ?, ?);";
+			
+			int const bind_extension = SQLITE_BIND_START + 0;
+			int const bind_key       = SQLITE_BIND_START + 1;
+			int const bind_data      = SQLITE_BIND_START + 2;
+			
+			status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+			if (status != SQLITE_OK)
 			{
-				if (strongConnections == nil)
-					strongConnections = [NSMutableArray array];
+				YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			}
+			else
+			{
+				char *extension = "";
+				sqlite3_bind_text(statement, bind_extension, extension, (int)strlen(extension), SQLITE_STATIC);
 				
-				[strongConnections addObject:connection];
+				char *key = "random";
+				sqlite3_bind_text(statement, bind_key, key, (int)strlen(key), SQLITE_STATIC);
 				
-				if (group == NULL)
-					group = dispatch_group_create();
+				YapDatabaseString _uuid; MakeYapDatabaseString(&_uuid, uuid);
+				sqlite3_bind_text(statement, bind_data, _uuid.str, _uuid.length, SQLITE_STATIC);
 				
-				dispatch_group_async(group, connection->connectionQueue, ^{ @autoreleasepool {
-					
-					[connection noteCommittedChangeset:changeset];
-				}});
+				status = sqlite3_step(statement);
+				if (status != SQLITE_DONE)
+				{
+					YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+				}
+				
+				sqlite3_finalize(statement);
+				FreeYapDatabaseString(&_uuid);
 			}
+			
+			[self commitTransaction];
 		}
+		
+		atomic_store(&aggressiveCheckpointEnabled, false);
 	}
+}
+
+- (BOOL)tryResetLongLivedReadTransactions
+{
+	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
 	
-	// Schedule block to be executed once all connections have processed the changes.
+	__block NSMutableArray<YapDatabaseConnection *> *strongConnections = nil;
+	__block dispatch_group_t group = NULL;
 	
-	BOOL isInternalChangeset = (sender == nil);
-	__weak YapDatabase *weakSelf = self;
+	__block YAPUnfairLock spinLock = YAP_UNFAIR_LOCK_INIT;
+	__block atomic_bool hasWriteQueue = true;
 	
-	dispatch_block_t block = ^{
+	dispatch_sync(snapshotQueue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
-	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
-		
-		__strong YapDatabase *strongSelf = weakSelf;
-		if (strongSelf == nil) return;
-		
-		// All connections have now processed the changes.
-		// So we no longer need to retain the changeset in memory.
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		if (isInternalChangeset)
-		{
-			YDBLogVerbose(@"Completed internal changeset %@ for database: %@",
-			              [changeset objectForKey:YapDatabaseSnapshotKey], self);
-		}
-		else
+		for (YapDatabaseConnectionState *state in connectionStates)
 		{
-			YDBLogVerbose(@"Dropping processed changeset %@ for database: %@",
-			              [changeset objectForKey:YapDatabaseSnapshotKey], self);
-			
-			[strongSelf->changesets removeObjectAtIndex:0];
+			if (state->activeReadTransaction && state->longLivedReadTransaction)
+			{
+				// Create strong reference (state->connection is weak)
+				__strong YapDatabaseConnection *connection = state->connection;
+				
+				if (connection)
+				{
+					if (strongConnections == nil)
+						strongConnections = [NSMutableArray array];
+					
+					[strongConnections addObject:connection];
+					
+					if (group == NULL)
+						group = dispatch_group_create();
+					
+					dispatch_group_async(group, connection->connectionQueue, ^{
+						
+						YAPUnfairLockLock(&spinLock);
+						{
+							if (atomic_load(&hasWriteQueue))
+							{
+								[connection resetLongLivedReadTransaction];
+							}
+						}
+						YAPUnfairLockUnlock(&spinLock);
+					});
+				}
+			}
 		}
 		
-		#if !OS_OBJECT_USE_OBJC
-		if (group)
-			dispatch_release(group);
-		#endif
-		
 	#pragma clang diagnostic pop
-	};
-	
-	if (group)
-		dispatch_group_notify(group, snapshotQueue, block);
-	else
-		block();
+	}});
 	
 	if (strongConnections)
 	{
@@ -2965,429 +7368,792 @@ static int connectionBusyHandler(void *ptr, int count) {
 		//
 		// This is a workaround to ensure that the dealloc occurs outside the snapshotQueue.
 		//
-		dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{ @autoreleasepool {
-			[strongConnections removeAllObjects];
-		}});
+		[strongConnections removeAllObjects];
+	}
+	
+	// dispatch_group_wait():
+	// Returns zero on success (all blocks associated with the group completed before the specified timeout)
+	// or non-zero on error (timeout occurred).
+	//
+	long ready = 0;
+	if (group) {
+		ready = dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(50 * NSEC_PER_MSEC)));
+	}
+	
+	if (ready != 0)
+	{
+		YAPUnfairLockLock(&spinLock);
+		{
+			atomic_store(&hasWriteQueue, false);
+		}
+		YAPUnfairLockUnlock(&spinLock);
+		
+		return NO;
+	}
+	else
+	{
+		return YES;
 	}
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Manual Checkpointing
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * This method should be called whenever the maximum checkpointable snapshot is incremented.
- * That is, the state of every connection is known to the system.
- * And a snaphot cannot be checkpointed until every connection is at or past that snapshot.
- * Thus, we can know the point at which a snapshot becomes checkpointable,
- * and we can thus optimize the checkpoint invocations such that
- * each invocation is able to checkpoint one or more commits.
+ * Consulted by YapDatabaseConnection after performing a read-write transaction.
+ *
+ * When aggressive checkpointing is triggered,
+ * the connections will perform a checkpoint after every read-write transaction.
 **/
-- (void)asyncCheckpoint:(uint64_t)maxCheckpointableSnapshot
+- (BOOL)aggressiveCheckpointEnabled
 {
-	if (maxCheckpointableSnapshot > 0) {
-		YDBLogVerbose(@"Checkpoint possible up to snapshot %llu", maxCheckpointableSnapshot);
+	return atomic_load(&aggressiveCheckpointEnabled);
+}
+
+- (void)noteCheckpointWithTotalFrames:(int)totalFrameCount checkpointedFrames:(int)checkpointedFrameCount
+{
+	uint64_t walApproximateFileSize = totalFrameCount * pageSize;
+	
+	if (walApproximateFileSize < options.aggressiveWALTruncationSize)
+	{
+		atomic_store(&aggressiveCheckpointEnabled, false);
 	}
+}
+
+/**
+ * Creates a copy-on-write clone of the database file (see -[YapDatabaseConnection cloneBackupToPath:]).
+ *
+ * This method must be invoked within the writeQueue, so nothing can be committed while the clone is made.
+ * It truncates the WAL (so the database file contains every commit), and clones the file within the checkpointQueue
+ * (so a checkpoint can't be writing into the file at the same time).
+ *
+ * Returns NO if the clone couldn't be made (e.g. the filesystem doesn't support cloning, or the WAL couldn't be
+ * truncated because of a reader), in which case the caller should fall back to a regular backup.
+**/
+- (BOOL)cloneDatabaseFileToPath:(NSString *)clonePath
+{
+	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
 	
-	bool aggressive = atomic_load(&aggressiveCheckpointEnabled);
-	if (aggressive)
+#if YAP_CLONEFILE_AVAILABLE && (SQLITE_VERSION_NUMBER > 3008008)
+	
+	// Another process could write to the file while it's being cloned.
+	if (options.enableMultiProcessSupport) return NO;
+	
+	// The truncate checkpoint needs every reader off the WAL.
+	
+	if (![self tryResetLongLivedReadTransactions])
 	{
-		[self asyncAggressiveCheckpoint];
+		YDBLogInfo(@"Clone backup spoiled by longLivedReadTransaction");
+		return NO;
 	}
-	else
+	
+	// clonefile() fails if the destination exists.
+	// So we clone into a temporary file, and then atomically replace the destination.
+	
+	NSString *tempPath = [clonePath stringByAppendingFormat:@".%@.tmp", [[NSUUID UUID] UUIDString]];
+	
+	__block BOOL result = NO;
+	
+	dispatch_sync(checkpointQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		sqlite3_busy_timeout(db, 50); // milliseconds
+		
+		int totalFrameCount = 0;
+		int checkpointedFrameCount = 0;
+		
+		YDBSignpostID signpost = YDBSignpostBegin("Checkpoint", "mode: %{public}s", "truncate");
+		
+		int checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_TRUNCATE,
+		                                                 &totalFrameCount, &checkpointedFrameCount);
+		
+		YDBSignpostEnd(signpost, "Checkpoint", "frames: %d checkpointed: %d", totalFrameCount, checkpointedFrameCount);
+		
+		YDBLogVerbose(@"Post-checkpoint: src(clone) mode(truncate) result(%d) frames(%d) checkpointed(%d)",
+		              checkpointResult, totalFrameCount, checkpointedFrameCount);
+		
+		if (checkpointResult != SQLITE_OK || totalFrameCount != checkpointedFrameCount)
+		{
+			YDBLogInfo(@"Clone backup: unable to truncate the WAL: %d", checkpointResult);
+			return;// from_block
+		}
+		
+		[self noteCheckpointWithTotalFrames:totalFrameCount checkpointedFrames:checkpointedFrameCount];
+		
+		if (YapDatabaseCloneFile(databasePath, tempPath) != 0)
+		{
+			// ENOTSUP: the filesystem (or OS version) doesn't support cloning (i.e. not APFS)
+			// EXDEV  : the destination is on a different volume
+			YDBLogInfo(@"Clone backup: clonefile() failed: %d %s", errno, strerror(errno));
+			return;// from_block
+		}
+		
+		result = YES;
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	if (!result) return NO;
+	
+	// Anything left over from opening a previous backup at the destination no longer matches the file.
+	
+	[[NSFileManager defaultManager] removeItemAtPath:[clonePath stringByAppendingString:@"-wal"] error:NULL];
+	[[NSFileManager defaultManager] removeItemAtPath:[clonePath stringByAppendingString:@"-shm"] error:NULL];
+	
+	if (rename([tempPath fileSystemRepresentation], [clonePath fileSystemRepresentation]) != 0)
 	{
-		[self asyncPassiveCheckpoint];
+		YDBLogError(@"Clone backup: rename() failed: %d %s", errno, strerror(errno));
+		
+		unlink([tempPath fileSystemRepresentation]);
+		return NO;
 	}
+	
+	return YES;
+	
+#else
+	
+	return NO;
+	
+#endif
 }
 
-- (void)asyncPassiveCheckpoint
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Incremental Vacuum
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoked after a checkpoint.
+ * 
+ * With "auto_vacuum=INCREMENTAL", free pages stay in the freelist until "PRAGMA incremental_vacuum" is run.
+ * So we schedule a budgeted step, which runs after the incrementalVacuumIdleInterval,
+ * but only if nothing has been committed in the meantime.
+ * 
+ * If the database isn't idle, the step is skipped, and the next checkpoint schedules another one.
+**/
+- (void)asyncIncrementalVacuum
 {
-	bool hasPendingCheckpoint = atomic_flag_test_and_set(&pendingPassiveCheckpoint);
-	if (hasPendingCheckpoint) {
+	if (options.pragmaAutoVacuum != YapDatabasePragmaAutoVacuum_Incremental) return;
+	if (options.incrementalVacuumPageBudget == 0) return;
+	
+	bool hasPendingIncrementalVacuum = atomic_flag_test_and_set(&pendingIncrementalVacuum);
+	if (hasPendingIncrementalVacuum) {
 		return;
 	}
 	
+	uint64_t scheduledSnapshot = [self snapshot];
+	
 	__weak YapDatabase *weakSelf = self;
 	
-	dispatch_async(checkpointQueue, ^{ @autoreleasepool {
+	NSTimeInterval delayInSeconds = options.incrementalVacuumIdleInterval;
+	dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
+	dispatch_after(popTime, writeQueue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
 		
 		__strong YapDatabase *strongSelf = weakSelf;
 		if (strongSelf == nil) return;
 		
-		atomic_flag_clear(&strongSelf->pendingPassiveCheckpoint);
+		atomic_flag_clear(&strongSelf->pendingIncrementalVacuum);
 		
-		if (atomic_load(&strongSelf->aggressiveCheckpointEnabled)) {
+		if ([strongSelf snapshot] != scheduledSnapshot) {
 			return;
 		}
 		
-		[strongSelf passiveCheckpoint];
+		[strongSelf incrementalVacuumStep];
 		
 	#pragma clang diagnostic pop
 	}});
 }
 
-- (void)asyncAggressiveCheckpoint
+/**
+ * Reclaims up to incrementalVacuumPageBudget pages from the freelist.
+ * 
+ * This method must be invoked on the writeQueue.
+**/
+- (void)incrementalVacuumStep
 {
-	bool hasPendingCheckpoint = atomic_flag_test_and_set(&pendingAggressiveCheckpoint);
-	if (hasPendingCheckpoint) {
+	// Don't hold up a foreground writer that's queued up behind us.
+	
+	if (atomic_load(&priorityWritersWaitingCount) > 0) {
+		return;
+	}
+	
+	int64_t freelistCount = [YapDatabase pragma:@"freelist_count" using:db];
+	if (freelistCount <= 0) {
+		return;
+	}
+	
+	NSString *pragma_incremental_vacuum =
+	  [NSString stringWithFormat:@"PRAGMA incremental_vacuum(%lu);", (unsigned long)options.incrementalVacuumPageBudget];
+	
+	int status = sqlite3_exec(db, [pragma_incremental_vacuum UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		if (status == SQLITE_BUSY) {
+			YDBLogVerbose(@"PRAGMA incremental_vacuum returned SQLITE_BUSY");
+		}
+		else {
+			YDBLogWarn(@"Error executing PRAGMA incremental_vacuum: %d %s", status, sqlite3_errmsg(db));
+		}
+		
+		return;
+	}
+	
+	int64_t remainingFreelistCount = [YapDatabase pragma:@"freelist_count" using:db];
+	
+	YDBLogVerbose(@"Incremental vacuum: freelist(%lld) -> freelist(%lld)", freelistCount, remainingFreelistCount);
+	
+	if (remainingFreelistCount > 0)
+	{
+		// Continue in the next idle period.
+		[self asyncIncrementalVacuum];
+	}
+}
+
+/**
+ * Invoked by a connection after it commits a read-write transaction.
+ * The count is the number of rows inserted, updated or deleted by the transaction.
+**/
+- (void)noteCommittedRowChanges:(uint64_t)changeCount
+{
+	if (changeCount > 0) {
+		atomic_fetch_add(&analyzeChangeCount, changeCount);
+	}
+}
+
+/**
+ * Invoked after a checkpoint.
+ * 
+ * Once enough rows have changed (analyzeChangeThreshold), we schedule an optimize step,
+ * which runs after the incrementalVacuumIdleInterval, but only if nothing has been committed in the meantime.
+ * The step is budgeted with "PRAGMA analysis_limit", so it never holds up the writeQueue for long.
+**/
+- (void)asyncOptimize
+{
+	if (options.analyzeChangeThreshold == 0) return;
+	if (atomic_load(&analyzeChangeCount) < options.analyzeChangeThreshold) return;
+	
+	bool hasPendingOptimize = atomic_flag_test_and_set(&pendingOptimize);
+	if (hasPendingOptimize) {
 		return;
 	}
 	
+	uint64_t scheduledSnapshot = [self snapshot];
+	
 	__weak YapDatabase *weakSelf = self;
 	
-	dispatch_async(writeQueue, ^{
+	NSTimeInterval delayInSeconds = options.incrementalVacuumIdleInterval;
+	dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
+	dispatch_after(popTime, writeQueue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
 		
 		__strong YapDatabase *strongSelf = weakSelf;
 		if (strongSelf == nil) return;
 		
-		atomic_flag_clear(&strongSelf->pendingAggressiveCheckpoint);
+		atomic_flag_clear(&strongSelf->pendingOptimize);
 		
-		if (!atomic_load(&strongSelf->aggressiveCheckpointEnabled)) {
+		if ([strongSelf snapshot] != scheduledSnapshot) {
 			return;
 		}
 		
-		[strongSelf aggressiveCheckpoint];
+		[strongSelf optimizeStep];
 		
 	#pragma clang diagnostic pop
-	});
+	}});
 }
 
-- (void)passiveCheckpoint
+/**
+ * Runs "PRAGMA optimize", which analyzes the tables that need it (budgeted by the analysisLimit).
+ * 
+ * This method must be invoked on the writeQueue.
+**/
+- (void)optimizeStep
 {
-	int checkpointResult = 0;
-	int totalFrameCount = 0;
-	int checkpointedFrameCount = 0;
+	// Don't hold up a foreground writer that's queued up behind us.
 	
-	// We're going to execute a passive checkpoint.
-	// That is, without disrupting any connections, we're going to write pages from the WAL into the database.
-	// The checkpoint can only write pages from snapshots if all connections are at or beyond the snapshot.
-	// Thus, this method is only called by a connection that moves the min snapshot forward.
+	if (atomic_load(&priorityWritersWaitingCount) > 0) {
+		return;
+	}
 	
-	checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE,
-	                                             &totalFrameCount, &checkpointedFrameCount);
+	NSString *pragma_analysis_limit =
+	  [NSString stringWithFormat:@"PRAGMA analysis_limit = %lu;", (unsigned long)options.analysisLimit];
 	
-	// totalFrameCount        = total number of frames in the WAL file
-	// checkpointedFrameCount = total number of checkpointed frames (those copied into db file)
-	//                          (including any that were already checkpointed before the function was called)
+	int status = sqlite3_exec(db, [pragma_analysis_limit UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogWarn(@"Error setting PRAGMA analysis_limit: %d %s", status, sqlite3_errmsg(db));
+	}
 	
-	YDBLogVerbose(@"Post-checkpoint: src(a) mode(passive) result(%d) frames(%d) checkpointed(%d)",
-	              checkpointResult, totalFrameCount, checkpointedFrameCount);
+	// 0x10000 : consider every table (rather than those queried on this sqlite3 instance)
+	// 0x00002 : run ANALYZE on the tables that need it
+	//
+	// Older versions of sqlite ignore the 0x10000 flag,
+	// and our sqlite3 instance doesn't query the extension tables, so they'd never be analyzed.
 	
-	if (checkpointResult != SQLITE_OK)
+	const char *optimize = (sqlite3_libversion_number() >= 3046000) ? "PRAGMA optimize(0x10002);" : "ANALYZE;";
+	
+	uint64_t changeCount = atomic_load(&analyzeChangeCount);
+	
+	status = sqlite3_exec(db, optimize, NULL, NULL, NULL);
+	if (status != SQLITE_OK)
 	{
-		if (checkpointResult == SQLITE_BUSY) {
-			YDBLogVerbose(@"sqlite3_wal_checkpoint_v2 returned SQLITE_BUSY");
+		if (status == SQLITE_BUSY) {
+			YDBLogVerbose(@"%s returned SQLITE_BUSY", optimize);
 		}
 		else {
-			YDBLogWarn(@"sqlite3_wal_checkpoint_v2 returned error code: %d", checkpointResult);
+			YDBLogWarn(@"Error executing %s: %d %s", optimize, status, sqlite3_errmsg(db));
 		}
 		
-		return;// from_block
+		return;
 	}
 	
-	// Did we checkpoint the entire WAL file ?
+	// Only reset what was counted before the step, so nothing noted concurrently gets lost.
 	
-	BOOL didCheckpointEntireWAL = (totalFrameCount == checkpointedFrameCount);
+	atomic_fetch_sub(&analyzeChangeCount, changeCount);
 	
-	if (didCheckpointEntireWAL)
-	{
-		// We've checkpointed every single frame in the WAL.
-		// This means the next read-write transaction may be able to reset the WAL (instead of appending to it).
-		//
-		// However, the WAL reset will get spoiled if there are active read-only transactions that
-		// were started before our checkpoint finished, and continue to exist during the next read-write.
-		// It's not a big deal if the occasional read-only transaction happens to spoil the WAL reset.
-		// In those cases, the WAL generally gets reset shortly thereafter (on a subsequent write).
-		// Long-lived read transactions are a different case entirely.
-		// These transactions spoil it every single time, and could potentially cause the WAL to grow indefinitely.
-		//
-		// The solution is to notify active long-lived connections, and tell them to re-begin their transaction
-		// on the same snapshot. But this time the sqlite machinery will read directly from the database,
-		// and thus unlock the WAL so it can be reset.
-		
-		__weak YapDatabase *weakSelf = self;
+	YDBLogVerbose(@"Optimize: changes(%llu)", changeCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Expiration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Schedules the next sweep of expired objects, after the expirationSweepInterval.
+ * 
+ * This method is invoked once the database has been prepared, and after each sweep completes.
+ * So there's never more than a single sweep pending.
+**/
+- (void)asyncExpirationSweep
+{
+	if (!expirationEnabled) return;
+	if (options.expirationSweepInterval <= 0.0) return;
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	NSTimeInterval delayInSeconds = options.expirationSweepInterval;
+	dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
+	dispatch_after(popTime, internalQueue, ^{ @autoreleasepool {
 		
-		dispatch_async(writeQueue, ^{ @autoreleasepool {
-		#pragma clang diagnostic push
-		#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
-			
-			__strong YapDatabase *strongSelf = weakSelf;
-			if (strongSelf == nil) return;
-			
-			[strongSelf tryResetLongLivedReadTransactions];
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf)
+		{
+			YapDatabaseConnection *connection = [strongSelf newConnection];
+			connection.name = @"YapDatabase_expirationSweeperConnection";
 			
-		#pragma clang diagnostic pop
-		}});
-	}
-	
-	// Is the WAL file getting too big ?
+			[strongSelf expirationSweepWithConnection:connection];
+		}
+	}});
+}
+
+/**
+ * Removes a single batch of expired objects.
+ * If the batch was full, another batch immediately follows (in a separate transaction).
+ * Otherwise the next sweep is scheduled.
+ * 
+ * The connection is retained by the completion block, and is released once the sweep completes.
+**/
+- (void)expirationSweepWithConnection:(YapDatabaseConnection *)connection
+{
+	NSUInteger batchSize = MAX(options.expirationSweepBatchSize, (NSUInteger)1);
+	__block NSUInteger removedCount = 0;
 	
-	uint64_t walApproximateFileSize = totalFrameCount * pageSize;
-	BOOL needsAggressiveCheckpoint = (walApproximateFileSize >= options.aggressiveWALTruncationSize);
+	__weak YapDatabase *weakSelf = self;
 	
-	if (needsAggressiveCheckpoint)
-	{
-		atomic_store(&aggressiveCheckpointEnabled, true);
+	[connection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
 		
-		[self asyncAggressiveCheckpoint];
-	}
+		removedCount = [transaction removeExpiredObjectsWithLimit:batchSize];
+		
+	} completionQueue:internalQueue completionBlock:^{
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		YDBLogVerbose(@"Expiration sweep removed %lu object(s)", (unsigned long)removedCount);
+		
+		if (removedCount >= batchSize)
+			[strongSelf expirationSweepWithConnection:connection];
+		else
+			[strongSelf asyncExpirationSweep];
+	}];
 }
 
-- (void)aggressiveCheckpoint
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Cold Storage Migration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Schedules the next migration of old objects into cold storage, after the coldStorageMigrationInterval.
+ * 
+ * This method is invoked once the database has been prepared, and after each migration completes.
+ * So there's never more than a single migration pending.
+**/
+- (void)asyncColdStorageMigration
 {
-	int checkpointResult = 0;
-	int totalFrameCount = 0;
-	int checkpointedFrameCount = 0;
-	
-	// First we set an adequate busy timeout on our database connection.
-	// We're going to run a non-passive checkpoint.
-	// Which may cause it to busy-wait while waiting on read transactions to complete.
+	if (!coldStorageEnabled || coldCollections.count == 0) return;
+	if (options.coldStorageMigrationInterval <= 0.0) return;
 	
-	sqlite3_busy_timeout(db, 50); // milliseconds
+	__weak YapDatabase *weakSelf = self;
 	
-	// Step 1 of 3:
-	//
-	// Perform FULL checkpoint.
-	//
-	// This will checkpoint as many frames as possible,
-	// and busy-wait until all readers are on the latest commit.
+	NSTimeInterval delayInSeconds = options.coldStorageMigrationInterval;
+	dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delayInSeconds * NSEC_PER_SEC));
+	dispatch_after(popTime, internalQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf)
+		{
+			YapDatabaseConnection *connection = [strongSelf newConnection];
+			connection.name = @"YapDatabase_coldStorageMigrationConnection";
+			
+			[strongSelf coldStorageMigrationWithConnection:connection];
+		}
+	}});
+}
+
+/**
+ * Moves a single batch of old objects into cold storage.
+ * If the batch was full, another batch immediately follows (in a separate transaction).
+ * Otherwise the next migration is scheduled.
+ * 
+ * The connection is retained by the completion block, and is released once the migration completes.
+**/
+- (void)coldStorageMigrationWithConnection:(YapDatabaseConnection *)connection
+{
+	NSUInteger batchSize = MAX(options.coldStorageMigrationBatchSize, (NSUInteger)1);
+	__block NSUInteger movedCount = 0;
 	
-	checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_FULL,
-	                                             &totalFrameCount, &checkpointedFrameCount);
+	__weak YapDatabase *weakSelf = self;
 	
-	YDBLogInfo(@"Post-checkpoint: src(b) mode(full) result(%d) frames(%d) checkpointed(%d)",
-	           checkpointResult, totalFrameCount, checkpointedFrameCount);
+	[connection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		movedCount = [transaction moveObjectsToColdStorageWithLimit:batchSize];
+		
+	} completionQueue:internalQueue completionBlock:^{
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		YDBLogVerbose(@"Cold storage migration moved %lu object(s)", (unsigned long)movedCount);
+		
+		if (movedCount >= batchSize)
+			[strongSelf coldStorageMigrationWithConnection:connection];
+		else
+			[strongSelf asyncColdStorageMigration];
+	}];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Checkpoint Policy
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoked by the WAL hook of every connection (if a checkpointPolicy is configured),
+ * after a read-write transaction has been committed.
+ * 
+ * @param frameCount
+ *   The number of frames in the WAL (as reported by sqlite).
+**/
+- (void)noteCommitWithWALFrameCount:(int)frameCount
+{
+	NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
 	
-	if (totalFrameCount != checkpointedFrameCount)
+	YAPUnfairLockLock(&checkpointPolicyLock);
 	{
-		return;
+		if ((NSUInteger)frameCount < walFrameCount)
+		{
+			// The WAL was restarted (every frame had previously been checkpointed).
+			walCheckpointedFrameCount = 0;
+		}
+		walFrameCount = (NSUInteger)frameCount;
+		
+		// Exponentially decaying commit counter (with a time constant of 1 second),
+		// which approximates the number of commits per second.
+		
+		writeRate = (writeRate * exp(-(now - lastCommitTime))) + 1.0;
+		lastCommitTime = now;
 	}
+	YAPUnfairLockUnlock(&checkpointPolicyLock);
 	
-	// STEP 2 of 3:
-	//
-	// Check for longLivedReadTransactions, and attempt to silently move them to reading directly from the database.
-	// (As oppossed to reading from the latest commit in the WAL.)
+	[self asyncPolicyCheckpoint];
+}
+
+- (void)noteLatestSnapshotForCheckpointPolicy:(uint64_t)latestSnapshot
+{
+	if (checkpointPolicy == nil) return;
 	
-	if (![self tryResetLongLivedReadTransactions])
+	YAPUnfairLockLock(&checkpointPolicyLock);
 	{
-		YDBLogInfo(@"Aggressive checkpoint spoiled: longLivedReadTransaction is blocking");
+		latestCommittedSnapshot = latestSnapshot;
+	}
+	YAPUnfairLockUnlock(&checkpointPolicyLock);
+}
+
+- (void)asyncPolicyCheckpoint
+{
+	bool hasPendingCheckpoint = atomic_flag_test_and_set(&pendingPolicyCheckpoint);
+	if (hasPendingCheckpoint) {
 		return;
 	}
 	
-	// STEP 3 of 3:
-	//
-	// Perform TRUNCATE checkpoint.
-	//
-	// At this point, we've checkpointed every single frame.
-	// And every connection should be reading directly from the database.
-	// So we should be able to truncate the WAL file now.
+	__weak YapDatabase *weakSelf = self;
 	
-	// Can we use SQLITE_CHECKPOINT_TRUNCATE ?
-	//
-	// This feature was added in sqlite v3.8.8.
-	// But it was buggy until v3.8.8.2 when the following fix was added:
-	//
-	//   "Enhance sqlite3_wal_checkpoint_v2(TRUNCATE) interface so that it truncates the
-	//    WAL file even if there is no checkpoint work to be done."
-	//
-	//   http://www.sqlite.org/changes.html
-	//
-	// It is often the case, when we call checkpoint here, that there is no checkpoint work to be done.
-	// So we really can't depend on it until 3.8.8.2
+	dispatch_async(checkpointQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		atomic_flag_clear(&strongSelf->pendingPolicyCheckpoint);
+		
+		[strongSelf evaluateCheckpointPolicy];
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Consults the checkpointPolicy, and performs the checkpoint it decides upon (if any).
+ * This method is run on the checkpointQueue.
+**/
+- (void)evaluateCheckpointPolicy
+{
+	NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
 	
-	int checkpointMode = SQLITE_CHECKPOINT_RESTART;
+	YapDatabaseCheckpointContext *context = [[YapDatabaseCheckpointContext alloc] init];
+	uint64_t generation = 0;
 	
-	// Remember: The compiler defines (SQLITE_VERSION, SQLITE_VERSION_NUMBER) only tell us
-	// what version we're compiling against. But we may encounter an earlier sqlite version at runtime.
+	YAPUnfairLockLock(&checkpointPolicyLock);
+	{
+		context.walFrameCount = walFrameCount;
+		context.checkpointedFrameCount = walCheckpointedFrameCount;
+		context.snapshotLag = (latestCommittedSnapshot > latestCheckpointableSnapshot)
+		                    ? (latestCommittedSnapshot - latestCheckpointableSnapshot) : 0;
+		context.writeRate = writeRate * exp(-(now - lastCommitTime));
+		context.timeSinceLastCheckpoint = now - lastPolicyCheckpointTime;
+		
+		generation = ++policyEvaluationGeneration;
+	}
+	YAPUnfairLockUnlock(&checkpointPolicyLock);
 	
-#ifndef SQLITE_VERSION_NUMBER_3_8_8
-#define SQLITE_VERSION_NUMBER_3_8_8 3008008
-#endif
+	context.walApproximateFileSize = context.walFrameCount * pageSize;
+	context.aggressiveWALTruncationSize = options.aggressiveWALTruncationSize;
 	
-#if SQLITE_VERSION_NUMBER > SQLITE_VERSION_NUMBER_3_8_8
+	NSProcessInfo *processInfo = [NSProcessInfo processInfo];
+	if ([processInfo respondsToSelector:@selector(isLowPowerModeEnabled)]) {
+		context.lowPowerModeEnabled = [processInfo isLowPowerModeEnabled];
+	}
 	
-	checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
+	NSTimeInterval delay = 0;
+	YapDatabaseCheckpointMode mode = [checkpointPolicy checkpointModeForContext:context delay:&delay];
 	
-#elif SQLITE_VERSION_NUMBER == SQLITE_VERSION_NUMBER_3_8_8
+	YDBLogVerbose(@"Checkpoint policy: mode(%ld) delay(%.2f) %@", (long)mode, delay, context);
 	
-	NSComparisonResult cmp = [strongSelf->sqliteVersion compare:@"3.8.8.2" options:NSNumericSearch];
-	if (cmp != NSOrderedAscending)
+	YAPUnfairLockLock(&checkpointPolicyLock);
 	{
-		checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
+		checkpointStatistics->evaluationCount++;
+		checkpointStatistics->lastMode = mode;
+		checkpointStatistics->lastWALFrameCount = context.walFrameCount;
+		
+		if (mode == YapDatabaseCheckpointModeNone) {
+			checkpointStatistics->skippedCount++;
+		}
 	}
+	YAPUnfairLockUnlock(&checkpointPolicyLock);
 	
-#endif
-	
-	checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", checkpointMode,
-	                                             &totalFrameCount, &checkpointedFrameCount);
-	
-	YDBLogInfo(@"Post-checkpoint: src(c) mode(%@) result(%d) frames(%d) checkpointed(%d)",
-	           (checkpointMode == SQLITE_CHECKPOINT_RESTART ? @"restart" : @"truncate"),
-	           checkpointResult, totalFrameCount, checkpointedFrameCount);
-	
-	if (checkpointResult == SQLITE_OK)
+	if (mode == YapDatabaseCheckpointModeNone)
 	{
-		if (checkpointMode == SQLITE_CHECKPOINT_RESTART)
+		if (delay > 0)
 		{
-			// Write something to the database to force restart the WAL.
-			// We're just going to set a random value in the yap2 table.
-			
-			NSString *uuid = [[NSUUID UUID] UUIDString];
-			
-			[self beginTransaction];
-			
-			int status;
-			sqlite3_stmt *statement;
-			
-			char *stmt = "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\") VALUES (?, ?, ?);";
+			// Consult the policy again after the delay,
+			// unless it gets consulted again in the meantime (which would schedule its own delay, if needed).
 			
-			int const bind_extension = SQLITE_BIND_START + 0;
-			int const bind_key       = SQLITE_BIND_START + 1;
-			int const bind_data      = SQLITE_BIND_START + 2;
+			__weak YapDatabase *weakSelf = self;
 			
-			status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-			}
-			else
-			{
-				char *extension = "";
-				sqlite3_bind_text(statement, bind_extension, extension, (int)strlen(extension), SQLITE_STATIC);
+			dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC));
+			dispatch_after(when, checkpointQueue, ^{ @autoreleasepool {
+			#pragma clang diagnostic push
+			#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
 				
-				char *key = "random";
-				sqlite3_bind_text(statement, bind_key, key, (int)strlen(key), SQLITE_STATIC);
+				__strong YapDatabase *strongSelf = weakSelf;
+				if (strongSelf == nil) return;
 				
-				YapDatabaseString _uuid; MakeYapDatabaseString(&_uuid, uuid);
-				sqlite3_bind_text(statement, bind_data, _uuid.str, _uuid.length, SQLITE_STATIC);
+				BOOL isCurrent = NO;
 				
-				status = sqlite3_step(statement);
-				if (status != SQLITE_DONE)
+				YAPUnfairLockLock(&strongSelf->checkpointPolicyLock);
 				{
-					YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+					isCurrent = (strongSelf->policyEvaluationGeneration == generation);
 				}
+				YAPUnfairLockUnlock(&strongSelf->checkpointPolicyLock);
 				
-				sqlite3_finalize(statement);
-				FreeYapDatabaseString(&_uuid);
-			}
-			
-			[self commitTransaction];
+				if (isCurrent) {
+					[strongSelf evaluateCheckpointPolicy];
+				}
+				
+			#pragma clang diagnostic pop
+			}});
 		}
+	}
+	else if (mode == YapDatabaseCheckpointModePassive)
+	{
+		[self policyCheckpointWithMode:mode];
+	}
+	else
+	{
+		// Non-passive checkpoints block writers.
+		// So we execute them within the writeQueue, which prevents them from busy-waiting on our own writes.
 		
-		atomic_store(&aggressiveCheckpointEnabled, false);
+		__weak YapDatabase *weakSelf = self;
+		
+		dispatch_async(writeQueue, ^{ @autoreleasepool {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
+			
+			__strong YapDatabase *strongSelf = weakSelf;
+			if (strongSelf == nil) return;
+			
+			[strongSelf policyCheckpointWithMode:mode];
+			
+		#pragma clang diagnostic pop
+		}});
 	}
 }
 
-- (BOOL)tryResetLongLivedReadTransactions
+/**
+ * Performs a checkpoint that was requested by the checkpointPolicy.
+ * 
+ * Passive checkpoints are run on the checkpointQueue.
+ * All other modes are run within the writeQueue.
+**/
+- (void)policyCheckpointWithMode:(YapDatabaseCheckpointMode)mode
 {
-	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
+	int sqliteMode = SQLITE_CHECKPOINT_PASSIVE;
+	switch (mode)
+	{
+		case YapDatabaseCheckpointModeFull     : sqliteMode = SQLITE_CHECKPOINT_FULL;    break;
+		case YapDatabaseCheckpointModeRestart  : sqliteMode = SQLITE_CHECKPOINT_RESTART; break;
+		case YapDatabaseCheckpointModeTruncate : sqliteMode = SQLITE_CHECKPOINT_RESTART; break;
+		default                                : break;
+	}
 	
-	__block NSMutableArray<YapDatabaseConnection *> *strongConnections = nil;
-	__block dispatch_group_t group = NULL;
+#if SQLITE_VERSION_NUMBER > 3008008
 	
-	__block YAPUnfairLock spinLock = YAP_UNFAIR_LOCK_INIT;
-	__block atomic_bool hasWriteQueue = true;
+	// SQLITE_CHECKPOINT_TRUNCATE wasn't reliable until v3.8.8.2 (see aggressiveCheckpoint).
 	
-	dispatch_sync(snapshotQueue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	if (mode == YapDatabaseCheckpointModeTruncate) {
+		sqliteMode = SQLITE_CHECKPOINT_TRUNCATE;
+	}
+	
+#endif
+	
+	BOOL spoiled = NO;
+	
+	if (sqliteMode != SQLITE_CHECKPOINT_PASSIVE)
+	{
+		// We're going to run a non-passive checkpoint.
+		// Which may cause it to busy-wait while waiting on read transactions to complete.
 		
-		for (YapDatabaseConnectionState *state in connectionStates)
+		sqlite3_busy_timeout(db, 50); // milliseconds
+		
+		if (sqliteMode != SQLITE_CHECKPOINT_FULL)
 		{
-			if (state->activeReadTransaction && state->longLivedReadTransaction)
+			// Restart & truncate need every reader off the WAL,
+			// so we attempt to move long-lived read transactions to reading directly from the database.
+			// If that fails, we can still checkpoint every frame.
+			
+			if (![self tryResetLongLivedReadTransactions])
 			{
-				// Create strong reference (state->connection is weak)
-				__strong YapDatabaseConnection *connection = state->connection;
+				YDBLogInfo(@"Checkpoint policy: %@ spoiled by longLivedReadTransaction",
+				           (mode == YapDatabaseCheckpointModeRestart ? @"restart" : @"truncate"));
 				
-				if (connection)
-				{
-					if (strongConnections == nil)
-						strongConnections = [NSMutableArray array];
-					
-					[strongConnections addObject:connection];
-					
-					if (group == NULL)
-						group = dispatch_group_create();
-					
-					dispatch_group_async(group, connection->connectionQueue, ^{
-						
-						YAPUnfairLockLock(&spinLock);
-						{
-							if (atomic_load(&hasWriteQueue))
-							{
-								[connection resetLongLivedReadTransaction];
-							}
-						}
-						YAPUnfairLockUnlock(&spinLock);
-					});
-				}
+				sqliteMode = SQLITE_CHECKPOINT_FULL;
+				spoiled = YES;
 			}
 		}
-		
-	#pragma clang diagnostic pop
-	}});
+	}
 	
-	if (strongConnections)
+	int totalFrameCount = 0;
+	int checkpointedFrameCount = 0;
+	
+	YDBSignpostID signpost = YDBSignpostBegin("Checkpoint", "mode: %{public}s",
+	  (sqliteMode == SQLITE_CHECKPOINT_PASSIVE) ? "passive" :
+	  (sqliteMode == SQLITE_CHECKPOINT_FULL)    ? "full"    :
+	  (sqliteMode == SQLITE_CHECKPOINT_RESTART) ? "restart" : "truncate");
+	
+	int checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", sqliteMode,
+	                                                 &totalFrameCount, &checkpointedFrameCount);
+	
+	YDBSignpostEnd(signpost, "Checkpoint", "frames: %d checkpointed: %d", totalFrameCount, checkpointedFrameCount);
+	
+	YDBLogVerbose(@"Post-checkpoint: src(policy) mode(%d) result(%d) frames(%d) checkpointed(%d)",
+	              sqliteMode, checkpointResult, totalFrameCount, checkpointedFrameCount);
+	
+	if (checkpointResult != SQLITE_OK && checkpointResult != SQLITE_BUSY)
 	{
-		// Edge case protection:
-		// Bug fix for issues: #437, #441
-		//
-		// Deadlock crash if:
-		// - YapDatabase is the last one holding a strong reference to a YapDatabaseConnection instance
-		// - The [connection dealloc] call occurs within the snapshotQueue
-		//
-		// This is a workaround to ensure that the dealloc occurs outside the snapshotQueue.
-		//
-		[strongConnections removeAllObjects];
+		YDBLogWarn(@"sqlite3_wal_checkpoint_v2 returned error code: %d", checkpointResult);
 	}
 	
-	// dispatch_group_wait():
-	// Returns zero on success (all blocks associated with the group completed before the specified timeout)
-	// or non-zero on error (timeout occurred).
-	//
-	long ready = 0;
-	if (group) {
-		ready = dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(50 * NSEC_PER_MSEC)));
-	}
+	BOOL busy = spoiled || (checkpointResult == SQLITE_BUSY);
+	BOOL didCheckpointEntireWAL = (checkpointResult == SQLITE_OK) && (totalFrameCount == checkpointedFrameCount);
 	
-	if (ready != 0)
+	YAPUnfairLockLock(&checkpointPolicyLock);
 	{
-		YAPUnfairLockLock(&spinLock);
+		switch (mode)
 		{
-			atomic_store(&hasWriteQueue, false);
+			case YapDatabaseCheckpointModeFull     : checkpointStatistics->fullCount++;     break;
+			case YapDatabaseCheckpointModeRestart  : checkpointStatistics->restartCount++;  break;
+			case YapDatabaseCheckpointModeTruncate : checkpointStatistics->truncateCount++; break;
+			default                                : checkpointStatistics->passiveCount++;  break;
 		}
-		YAPUnfairLockUnlock(&spinLock);
 		
-		return NO;
+		if (busy) {
+			checkpointStatistics->busyCount++;
+		}
+		
+		if (totalFrameCount >= 0 && checkpointedFrameCount >= 0)
+		{
+			if ((NSUInteger)totalFrameCount < walFrameCount)
+			{
+				// The WAL has been restarted/truncated.
+				walCheckpointedFrameCount = 0;
+			}
+			
+			if ((NSUInteger)checkpointedFrameCount > walCheckpointedFrameCount) {
+				checkpointStatistics->checkpointedFrameCount += (checkpointedFrameCount - walCheckpointedFrameCount);
+			}
+			
+			walFrameCount = (NSUInteger)totalFrameCount;
+			walCheckpointedFrameCount = (NSUInteger)checkpointedFrameCount;
+		}
+		
+		lastPolicyCheckpointTime = [NSDate timeIntervalSinceReferenceDate];
 	}
-	else
-	{
-		return YES;
+	YAPUnfairLockUnlock(&checkpointPolicyLock);
+	
+	if (checkpointResult == SQLITE_OK) {
+		[self updateMMapSizeTarget];
+		[self asyncIncrementalVacuum];
+		[self asyncOptimize];
 	}
-}
-
-/**
- * Consulted by YapDatabaseConnection after performing a read-write transaction.
- *
- * When aggressive checkpointing is triggered,
- * the connections will perform a checkpoint after every read-write transaction.
-**/
-- (BOOL)aggressiveCheckpointEnabled
-{
-	return atomic_load(&aggressiveCheckpointEnabled);
-}
-
-- (void)noteCheckpointWithTotalFrames:(int)totalFrameCount checkpointedFrames:(int)checkpointedFrameCount
-{
-	uint64_t walApproximateFileSize = totalFrameCount * pageSize;
 	
-	if (walApproximateFileSize < options.aggressiveWALTruncationSize)
+	if (didCheckpointEntireWAL && sqliteMode == SQLITE_CHECKPOINT_PASSIVE)
 	{
-		atomic_store(&aggressiveCheckpointEnabled, false);
+		// Same as with our regular passive checkpoints:
+		// Allow the next read-write transaction to reset the WAL, by moving long-lived read transactions
+		// to reading directly from the database. (See passiveCheckpoint for a full discussion.)
+		
+		__weak YapDatabase *weakSelf = self;
+		
+		dispatch_async(writeQueue, ^{ @autoreleasepool {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic warning "-Wimplicit-retain-self" // Turning warnings *** ON ***
+			
+			__strong YapDatabase *strongSelf = weakSelf;
+			if (strongSelf == nil) return;
+			
+			[strongSelf tryResetLongLivedReadTransactions];
+			
+		#pragma clang diagnostic pop
+		}});
 	}
 }
 
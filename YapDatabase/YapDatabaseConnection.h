@@ -1,10 +1,20 @@
 #import <Foundation/Foundation.h>
 #import "YapCollectionKey.h"
+#import "YapCache.h"
+#import "YapDatabaseChangeSummary.h"
+#import "YapDatabaseMemoryReport.h"
+#import "YapDatabaseStatistics.h"
+#import "YapDatabaseStorageReport.h"
+#import "YapDatabaseTransactionMetrics.h"
+#import "YapDatabaseTransactionBudget.h"
+#import "YapDatabaseQueueWaitStatistics.h"
+#import "YapDatabaseWorkloadTrace.h"
 
 @class YapDatabase;
 @class YapDatabaseReadTransaction;
 @class YapDatabaseReadWriteTransaction;
 @class YapDatabaseExtensionConnection;
+@class YapDatabaseConnection;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -39,6 +49,63 @@ typedef NS_ENUM(NSInteger, YapDatabasePolicy) {
 	YapDatabasePolicyCopy        = 2,
 };
 
+/**
+ * A marker protocol for objects (and metadata) that are never mutated once they're created.
+ * For example, value-typed model objects, where every change produces a new instance.
+ * 
+ * Since such an object can be read by multiple threads without any risk,
+ * the objectPolicy & metadataPolicy don't apply to it.
+ * No matter the policy, an immutable object written by one connection is passed (by reference)
+ * to the caches of every other connection, and to the shared object cache (if enabled).
+ * It's never copied, and never needs to be deserialized again by the other connections.
+ * 
+ * Important: Only adopt this protocol if instances truly are immutable (including every object they reference).
+**/
+@protocol YapDatabaseImmutable <NSObject>
+@end
+
+/**
+ * Read-write transactions may optionally specify their durability.
+ * 
+ * YapDatabaseDurabilityFull:
+ *   The default. When the transaction completes, its changes are guaranteed to survive a crash or power loss
+ *   (assuming YapDatabaseOptions.pragmaSynchronous is YapDatabasePragmaSynchronous_Full).
+ * 
+ * YapDatabaseDurabilityRelaxed:
+ *   The transaction commits without syncing the WAL to disk, which takes the sync off the latency path.
+ *   Its changes are atomic & immediately visible to other connections (just like any other transaction),
+ *   but may be lost (in their entirety) if the device loses power before the next sync.
+ *   The next sync happens when one of the following occurs:
+ *   - a YapDatabaseDurabilityFull transaction commits
+ *   - flushDurabilityWithCompletionQueue:completionBlock: is invoked
+ *   - the limits given by YapDatabaseOptions.relaxedDurabilityTransactionLimit/Interval are reached
+ * 
+ * Note that relaxed transactions can never corrupt the database, nor cause a later full transaction to be lost.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseDurability) {
+	YapDatabaseDurabilityFull    = 0,
+	YapDatabaseDurabilityRelaxed = 1,
+};
+
+/**
+ * Read-write transactions are executed one at a time (among all sibling connections).
+ * The write priority of a connection determines which lane its read-write transactions wait in.
+ * 
+ * YapDatabaseWritePriorityDefault:
+ *   The default. Transactions go straight to the database's (FIFO) write queue.
+ * 
+ * YapDatabaseWritePriorityBackground:
+ *   Transactions wait until no default priority transactions are waiting, before joining the write queue.
+ *   This is designed for large background work (imports, migrations, sync, etc),
+ *   so that it doesn't delay user-initiated writes.
+ *   Combine with asyncIncrementalReadWriteWithBlock:completionQueue:completionBlock: to split the work into
+ *   chunks, which allows default priority transactions to run in between chunks.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseWritePriority) {
+	YapDatabaseWritePriorityDefault    = 0,
+	YapDatabaseWritePriorityBackground = 1,
+};
+
 #ifndef YapDatabaseEnforcePermittedTransactions
   #if DEBUG
     #define YapDatabaseEnforcePermittedTransactions 1
@@ -67,6 +134,12 @@ typedef NS_OPTIONS(NSUInteger, YapDatabasePermittedTransactions) {
 };
 #endif
 
+/**
+ * Used to calculate the cost of a cached object (or metadata). See objectCacheCostLimit.
+ * The unit of the cost is up to you (typically bytes).
+**/
+typedef NSUInteger (^YapDatabaseCacheCostBlock)(NSString *collection, NSString *key, id object);
+
 typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 	YapDatabaseConnectionFlushMemoryFlags_None       = 0,
 	YapDatabaseConnectionFlushMemoryFlags_Caches     = 1 << 0,
@@ -77,6 +150,35 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 	                                                    YapDatabaseConnectionFlushMemoryFlags_Internal   ),
 };
 
+/**
+ * Invoked with the metrics of each read-write transaction. See setTransactionMetricsBlock:queue:.
+**/
+typedef void (^YapDatabaseTransactionMetricsBlock)(YapDatabaseConnection *connection,
+                                                   YapDatabaseTransactionMetrics *metrics);
+
+/**
+ * Invoked when a transaction waits on a queue for longer than the threshold. See setQueueWaitThreshold:block:queue:.
+**/
+typedef void (^YapDatabaseQueueWaitBlock)(YapDatabaseConnection *connection, YapDatabaseQueueWaitEvent *event);
+
+/**
+ * Invoked when a transaction exceeds its budget. See setTransactionBudgetForReads:writes:block:queue:.
+**/
+typedef void (^YapDatabaseTransactionBudgetBlock)(YapDatabaseConnection *connection,
+                                                  YapDatabaseTransactionBudgetReport *report);
+
+/**
+ * Posted (on the main thread) after a long-lived read transaction is automatically moved to the latest commit.
+ * See longLivedReadTransactionIdleTimeout.
+ *
+ * The object is the connection, and the userInfo dictionary contains:
+ *
+ *     YapDatabaseModifiedNotificationsKey : <NSArray of YapDatabaseModifiedNotification's, in commit order>
+ *
+ * These are the notifications that beginLongLivedReadTransaction would have returned.
+**/
+extern NSString *const YapDatabaseLongLivedReadTransactionAdvancedNotification;
+
 
 
 @interface YapDatabaseConnection : NSObject
@@ -149,6 +251,100 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 @property (atomic, assign, readwrite) BOOL metadataCacheEnabled;
 @property (atomic, assign, readwrite) NSUInteger metadataCacheLimit;
 
+/**
+ * In addition to the count limits (objectCacheLimit & metadataCacheLimit),
+ * the caches may also be limited by the total cost of the items they contain.
+ * This is useful when the size of objects varies wildly between collections.
+ * For example, one collection may contain tiny objects, while another contains large decoded images.
+ *
+ * The cost of each item is calculated by the corresponding cost block (if set).
+ * The block is passed the collection, so it may calculate the cost differently for each collection.
+ * If no block is set, objects that implement the YapCacheCost protocol report their own cost.
+ * Otherwise an item's cost is zero.
+ *
+ * Both limits (count & cost) are enforced. Set a cost limit to zero to disable it.
+ *
+ * The default cost limits are zero (i.e. disabled), and the default cost blocks are nil.
+**/
+@property (atomic, assign, readwrite) NSUInteger objectCacheCostLimit;
+@property (atomic, assign, readwrite) NSUInteger metadataCacheCostLimit;
+
+@property (atomic, copy, readwrite, nullable) YapDatabaseCacheCostBlock objectCacheCostBlock;
+@property (atomic, copy, readwrite, nullable) YapDatabaseCacheCostBlock metadataCacheCostBlock;
+
+/**
+ * The admission policy used by the object & metadata caches.
+ *
+ * With the default policy (YapCacheAdmissionPolicyLRU), every object that's read (or written) is added to the cache,
+ * and the least recently used object is evicted to make room for it.
+ * This means a single large enumeration (e.g. a background export) can flush the hot working set
+ * (e.g. the objects backing the UI), and the UI then has to fetch everything from disk again.
+ *
+ * With YapCacheAdmissionPolicyTinyLFU, a new object is only admitted into a full cache
+ * if it has been accessed more frequently (recently) than the object it would replace.
+ * So objects that are only touched once by a scan don't displace the objects that are used over & over.
+ *
+ * The default value is YapCacheAdmissionPolicyLRU.
+**/
+@property (atomic, assign, readwrite) YapCacheAdmissionPolicy objectCacheAdmissionPolicy;
+@property (atomic, assign, readwrite) YapCacheAdmissionPolicy metadataCacheAdmissionPolicy;
+
+/**
+ * When enumerating with YapDatabaseEnumerationConcurrentDeserialization,
+ * this is the maximum number of rows that may be read from sqlite, but not yet delivered to your block.
+ * Larger windows keep more threads busy, at the cost of holding more (copied) blobs in memory.
+ * 
+ * If zero, a window of 4x the active processor count is used.
+ * 
+ * The default value is zero.
+ * 
+ * @see YapDatabaseEnumerationOptions
+**/
+@property (atomic, assign, readwrite) NSUInteger enumerationWindowSize;
+
+/**
+ * The size of the sqlite page cache of this connection ("PRAGMA cache_size").
+ * 
+ * Each connection has its own page cache, and they're used very differently.
+ * A read-mostly UI connection touches the same few pages over & over, and is fine with a small cache,
+ * while a connection doing a bulk import benefits from a much larger one.
+ * 
+ * If non-zero, this overrides the connection's share of YapDatabaseOptions.pageCacheBudget.
+ * Changes are adopted at the start of the next transaction.
+ * 
+ * The value is specified in BYTES.
+ * The default value is zero, meaning the connection uses its share of the pageCacheBudget (if configured),
+ * or the sqlite default cache_size.
+**/
+@property (atomic, assign, readwrite) NSUInteger pageCacheSize;
+
+/**
+ * Enables adaptive sizing of the page cache, up to the given size.
+ * 
+ * The connection samples its page cache hits & misses (at the start of each transaction).
+ * If it misses often, while the cache is full, then the cache is doubled (up to this maximum).
+ * The cache shrinks back to its regular size (pageCacheSize, or the pageCacheBudget share)
+ * when the connection is asked to flush its internal memory (see flushMemoryWithFlags:),
+ * e.g. when the app receives a memory warning.
+ * 
+ * The value is specified in BYTES.
+ * The default value is zero, meaning adaptive sizing is disabled.
+**/
+@property (atomic, assign, readwrite) NSUInteger pageCacheMaximumSize;
+
+/**
+ * Whether sqlite may spill dirty pages to the database file before the transaction commits ("PRAGMA cache_spill").
+ * 
+ * When a write transaction modifies more pages than fit in the page cache, sqlite normally writes some of them
+ * out early, which requires an exclusive lock mid-transaction. Disabling spilling keeps every dirty page in memory
+ * until commit. This suits a connection doing large imports (with a correspondingly large pageCacheSize).
+ * 
+ * Changes are adopted at the start of the next transaction.
+ * 
+ * The default value is YES.
+**/
+@property (atomic, assign, readwrite) BOOL pageCacheSpillEnabled;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Policy
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -164,6 +360,8 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
  *
  * These optimizations are discussed extensively in the wiki article "Performance Pro":
  * https://github.com/yapstudios/YapDatabase/wiki/Performance-Pro
+ *
+ * Objects that adopt the YapDatabaseImmutable protocol are always shared, regardless of the policy.
 **/
 @property (atomic, assign, readwrite) YapDatabasePolicy objectPolicy;
 @property (atomic, assign, readwrite) YapDatabasePolicy metadataPolicy;
@@ -294,6 +492,18 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 **/
 @property (atomic, assign, readonly) uint64_t pendingTransactionCount;
 
+/**
+ * Returns the moving average of the duration of the transactions executed by the connection,
+ * from the moment the transaction starts executing on the connection's queue, until it completes.
+ * (For read-write transactions, this includes waiting for the database's write lock.)
+ *
+ * Combined with the pendingTransactionCount, this estimates how long a new transaction would have to wait.
+ * It's used for load balancing by YapDatabaseConnectionPool.
+ *
+ * Returns zero if the connection hasn't executed any transactions yet.
+**/
+@property (atomic, assign, readonly) NSTimeInterval averageTransactionDuration;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Transactions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -359,6 +569,24 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
            completionQueue:(nullable dispatch_queue_t)completionQueue
            completionBlock:(nullable dispatch_block_t)completionBlock;
 
+/**
+ * When enabled, async read blocks are coalesced:
+ * the blocks queued on the connection (one after another) are executed back to back,
+ * within a single read transaction (and thus at a single snapshot).
+ * Then each of their completionBlocks is invoked.
+ *
+ * This amortizes the cost of starting & ending a transaction, which dominates when firing many tiny
+ * async reads (e.g. one per cell). The tradeoff is that the connection's queue is held for the entire batch,
+ * so a transaction queued behind it waits for all of its blocks.
+ *
+ * Ordering is preserved with respect to other transactions:
+ * an async read never executes before a transaction that was queued ahead of it on this connection.
+ *
+ * This only applies to the asyncReadWithBlock: methods.
+ * The default value is NO.
+**/
+@property (atomic, assign, readwrite) BOOL coalescesAsyncReads;
+
 /**
  * Read-write access to the database.
  * 
@@ -424,6 +652,306 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 - (void)flushTransactionsWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
                              completionBlock:(nullable dispatch_block_t)completionBlock;
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Durability
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Read-write access to the database, with the given durability.
+ * 
+ * This method is synchronous.
+ * 
+ * @see YapDatabaseDurability
+**/
+- (void)readWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+                durability:(YapDatabaseDurability)durability;
+
+/**
+ * Read-write access to the database, with the given durability.
+ * 
+ * This method is asynchronous.
+ * 
+ * An optional completion block may be used.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * Note that a relaxed transaction's completionBlock is invoked as soon as the transaction has committed.
+ * That is, the transaction's changes may not yet be durable.
+ * 
+ * @see YapDatabaseDurability
+**/
+- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+                     durability:(YapDatabaseDurability)durability
+                completionQueue:(nullable dispatch_queue_t)completionQueue
+                completionBlock:(nullable dispatch_block_t)completionBlock;
+
+/**
+ * A durability barrier.
+ * 
+ * Syncs the WAL to disk (if needed), and then invokes the completionBlock.
+ * At that point, every transaction that was committed before this method was invoked (from any connection),
+ * including YapDatabaseDurabilityRelaxed transactions, is guaranteed to be durable.
+ * 
+ * Like any other transaction, the barrier is queued onto this connection's serial queue.
+ * 
+ * @param completionQueue
+ *   The dispatch_queue to invoke the completionBlock on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * @param completionBlock
+ *   The block to invoke once the sync has completed.
+**/
+- (void)flushDurabilityWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
+                           completionBlock:(nullable dispatch_block_t)completionBlock;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Write Priority
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The priority of read-write transactions executed via this connection.
+ * The priority is captured when the transaction is queued.
+ * 
+ * Note that background transactions may be delayed indefinitely under a constant stream of default transactions.
+ * Also, a default transaction may still have to wait for a background transaction that is already executing.
+ * Use asyncIncrementalReadWriteWithBlock:completionQueue:completionBlock: to keep this delay short.
+ * 
+ * The default value is YapDatabaseWritePriorityDefault.
+ * 
+ * @see YapDatabaseWritePriority
+**/
+@property (atomic, assign, readwrite) YapDatabaseWritePriority writePriority;
+
+/**
+ * Read-write access to the database, split into multiple transactions (chunks).
+ * 
+ * The block is invoked repeatedly, each time within its own read-write transaction,
+ * until it returns YES (meaning the work is complete).
+ * Each chunk is committed before the next one is queued,
+ * so other read-write transactions (from any connection) get to run in between chunks.
+ * 
+ * Within the block, use -[YapDatabaseReadWriteTransaction shouldYield] as a yield point.
+ * That is, when it returns YES, finish the current unit of work and return NO,
+ * to commit the progress made so far and let the waiting transactions through.
+ * 
+ * This method is asynchronous.
+ * 
+ * @param completionQueue
+ *   The dispatch_queue to invoke the completionBlock on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * @param completionBlock
+ *   The block to invoke once the final chunk has completed.
+**/
+- (void)asyncIncrementalReadWriteWithBlock:(BOOL (^)(YapDatabaseReadWriteTransaction *transaction))block
+                           completionQueue:(nullable dispatch_queue_t)completionQueue
+                           completionBlock:(nullable dispatch_block_t)completionBlock;
+
+/**
+ * Read-write access to the database, processing the given work items in time-bounded chunks.
+ * 
+ * The block is invoked once per item (in order, within its own autorelease pool).
+ * Each chunk is committed as its own read-write transaction, and ends as soon as any of the following occurs:
+ * - the chunk has run for (at least) the given duration
+ * - a default priority transaction is waiting (see -[YapDatabaseReadWriteTransaction shouldYield])
+ * - the system reports memory pressure (in which case the connection's caches are also flushed)
+ * 
+ * Each chunk processes at least one item, so the work always makes progress.
+ * 
+ * This method is asynchronous.
+ * 
+ * @param items
+ *   The work items. Since the items are pulled lazily (via nextObject), this may be a generator,
+ *   such as a custom NSEnumerator subclass that reads from a file.
+ * 
+ * @param chunkDuration
+ *   The target duration of each chunk.
+ *   If zero (or negative), a duration of 8 milliseconds is used.
+ * 
+ * @param completionQueue
+ *   The dispatch_queue to invoke the completionBlock on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * @param completionBlock
+ *   The block to invoke once every item has been processed (or the progress has been cancelled).
+ * 
+ * @return
+ *   The progress of the work. The completedUnitCount is the number of processed items.
+ *   Since the number of items isn't known upfront, the totalUnitCount is -1 (indeterminate),
+ *   unless you set it yourself. Cancelling the progress stops the work after the current item.
+**/
+- (NSProgress *)asyncReadWriteWithItems:(NSEnumerator *)items
+                          chunkDuration:(NSTimeInterval)chunkDuration
+                             usingBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction, id item))block
+                        completionQueue:(nullable dispatch_queue_t)completionQueue
+                        completionBlock:(nullable dispatch_block_t)completionBlock;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Bulk Load
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Read-write access to the database, for loading a large number of rows (e.g. an initial import).
+ * 
+ * Keeping the index extensions up-to-date row by row is much slower than building them once the rows are in place.
+ * So within the block, the row hooks of the SecondaryIndex, FullTextSearch & RTreeIndex extensions are suspended.
+ * After the block, each of these extensions rebuilds its tables from scratch, using its bulk population path:
+ * - SecondaryIndex : the table is populated without its indexes, which are then created from the sorted values
+ * - FullTextSearch : the table is populated, and the segments are then merged into one (optimize)
+ * - RTreeIndex     : the boxes are inserted in STR order
+ * 
+ * All of this happens within a single read-write transaction.
+ * So other connections keep seeing the previous state of the database (including the extensions) until it commits,
+ * and then see the new rows along with the rebuilt extensions.
+ * 
+ * Important: Within the block, the suspended extensions are stale.
+ * That is, they don't reflect the changes made within the block, so don't query them there.
+ * 
+ * Extensions that are unaffected (e.g. views), or that another extension depends on, are processed as usual.
+ * As is an FTS extension with deferredIndexing, as it only queues the rows anyway.
+ * 
+ * Note that the rebuild processes every row (in the collections the extension is interested in),
+ * not just those that were loaded. So this is only worthwhile if the block writes a large portion of them.
+ * 
+ * If a rebuild fails, or the block invokes -[YapDatabaseReadWriteTransaction rollback],
+ * the transaction is rolled back.
+ * 
+ * This method is synchronous.
+**/
+- (void)bulkLoadWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block;
+
+/**
+ * Asynchronous version of bulkLoadWithBlock:.
+ * 
+ * @param completionQueue
+ *   The dispatch_queue to invoke the completionBlock on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * @param completionBlock
+ *   The block to invoke once the transaction has completed.
+**/
+- (void)asyncBulkLoadWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+               completionQueue:(nullable dispatch_queue_t)completionQueue
+               completionBlock:(nullable dispatch_block_t)completionBlock;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Metrics
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * When a transactionMetricsBlock is set, every read-write transaction on this connection is measured,
+ * and the block is invoked (asynchronously) with the metrics after each transaction completes.
+ * 
+ * The metrics break down the time spent within the transaction (your block, extension hooks, sqlite,
+ * deserialization, the commit, etc), so that the source of slow write transactions can be tracked down in the field.
+ * See YapDatabaseTransactionMetrics for the details.
+ * 
+ * The overhead is small, but it isn't zero. (Every measured operation requires a timestamp.)
+ * If no connection has a transactionMetricsBlock, there's no overhead at all.
+ * 
+ * @param block
+ *   The block to invoke with the metrics of each read-write transaction.
+ *   Pass nil to stop measuring transactions.
+ * 
+ * @param queue
+ *   The dispatch_queue to invoke the block on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)setTransactionMetricsBlock:(nullable YapDatabaseTransactionMetricsBlock)block
+                             queue:(nullable dispatch_queue_t)queue;
+
+/**
+ * When a workloadTraceRecorder is set, every transaction on this connection is recorded into the trace.
+ * The trace captures the shape of the workload (which collections & keys are read / written, value sizes,
+ * enumerations, extension accesses & timing), but none of the actual data.
+ * 
+ * A single recorder may be shared by multiple connections, in order to capture the workload of the whole app.
+ * The trace can later be replayed (against a fresh database) using YapDatabaseWorkloadTraceReplay.
+ * 
+ * Transactions that are already in progress when the recorder is set aren't recorded.
+ * The default value is nil. If nil, there's no overhead.
+**/
+@property (atomic, strong, readwrite, nullable) YapDatabaseWorkloadTraceRecorder *workloadTraceRecorder;
+
+/**
+ * Returns how long the transactions on this connection have spent waiting on the internal queues:
+ * the connectionQueue, the database's writeQueue & the database's snapshotQueue.
+ * (As well as how long they've held the snapshotQueue, which is time other connections may have waited.)
+ * 
+ * For example, if the writeQueue histogram dominates the total duration of your write transactions,
+ * then they're mostly waiting on read-write transactions from other connections.
+ * 
+ * The statistics are always recorded (the overhead is a couple of timestamps per queue),
+ * and accumulate until resetQueueWaitStatistics is invoked.
+ * This method may be invoked from any thread, and never waits on the connectionQueue.
+ * 
+ * @see YapDatabaseQueueWaitStatistics
+**/
+- (YapDatabaseQueueWaitStatistics *)queueWaitStatistics;
+
+/**
+ * Resets the queue wait statistics of this connection.
+**/
+- (void)resetQueueWaitStatistics;
+
+/**
+ * When a queueWaitBlock is set, it's invoked (asynchronously) whenever a transaction on this connection
+ * waits on a queue for at least the given threshold.
+ * 
+ * The event identifies the transaction that was holding the queue when the wait began (if any).
+ * So, for example, you can tell which connection's read-write transaction was blocking your UI's write.
+ * 
+ * @param threshold
+ *   The minimum duration (in seconds) of a reported wait.
+ * 
+ * @param block
+ *   The block to invoke with each wait that exceeded the threshold.
+ *   Pass nil to stop reporting waits. (The statistics are still recorded.)
+ * 
+ * @param queue
+ *   The dispatch_queue to invoke the block on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)setQueueWaitThreshold:(NSTimeInterval)threshold
+                        block:(nullable YapDatabaseQueueWaitBlock)block
+                        queue:(nullable dispatch_queue_t)queue;
+
+/**
+ * When a transactionBudgetBlock is set, every transaction on this connection is timed against its budget,
+ * and the block is invoked (asynchronously) with a report for each transaction that exceeds it.
+ * For example, a connection used on the main thread might use a 16ms budget for reads,
+ * while a background connection might use a 200ms budget for writes.
+ * 
+ * The report includes the metrics of the transaction, which phase consumed the time
+ * (your block, sqlite, extensions, or the commit), and a backtrace of the connection's thread
+ * sampled at the moment the budget was exceeded. So it points at the culprit while it's still running,
+ * rather than the code that happens to execute last.
+ * 
+ * When the budget is exceeded, the thread is briefly suspended in order to sample its stack.
+ * This happens at most once per transaction, and only for transactions that are already over budget.
+ * 
+ * Budgeted transactions are measured (see setTransactionMetricsBlock:queue:),
+ * read-only transactions included.
+ * 
+ * @param readBudget
+ *   The budget (in seconds) for read-only transactions. Pass zero to not budget read-only transactions.
+ * 
+ * @param writeBudget
+ *   The budget (in seconds) for read-write transactions. Pass zero to not budget read-write transactions.
+ * 
+ * @param block
+ *   The block to invoke with each transaction that exceeded its budget.
+ *   Pass nil to stop budgeting transactions.
+ * 
+ * @param queue
+ *   The dispatch_queue to invoke the block on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)setTransactionBudgetForReads:(NSTimeInterval)readBudget
+                              writes:(NSTimeInterval)writeBudget
+                               block:(nullable YapDatabaseTransactionBudgetBlock)block
+                               queue:(nullable dispatch_queue_t)queue;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Long-Lived Transactions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -441,6 +969,58 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 
 - (BOOL)isInLongLivedReadTransaction;
 
+/**
+ * Normally a long-lived read transaction holds an sqlite read transaction for its entire lifetime.
+ * Which prevents checkpoints from progressing past its snapshot, and thus allows the WAL to grow.
+ *
+ * If enabled, the long-lived read transaction instead captures an sqlite3_snapshot,
+ * and releases its sqlite read transaction. Each subsequent read (e.g. readWithBlock:) re-opens
+ * the same snapshot (via sqlite3_snapshot_open) for the duration of the block.
+ * The database then holds a single read transaction at the oldest such snapshot (on behalf of every connection),
+ * which moves forward as soon as the oldest connection moves forward.
+ *
+ * This requires sqlite to be compiled with SQLITE_ENABLE_SNAPSHOT,
+ * and YapDatabase to be compiled with the same flag (e.g. GCC_PREPROCESSOR_DEFINITIONS).
+ * Otherwise (or if multi-process support is enabled) this setting has no effect.
+ *
+ * Changes take effect the next time beginLongLivedReadTransaction is invoked.
+ *
+ * The default value is NO.
+**/
+@property (atomic, assign, readwrite) BOOL detachesLongLivedReadTransactions;
+
+/**
+ * A connection that falls behind (e.g. a long-lived read transaction that isn't updated for a while,
+ * or a connection that simply isn't used for a while) has to catch up on every commit it missed.
+ * Normally this means updating its caches once per missed changeset.
+ *
+ * If the number of missed changesets exceeds this threshold, the connection instead flushes its caches,
+ * and only updates the remaining (non-cache) state for each changeset.
+ * The notifications returned from endLongLivedReadTransaction are unaffected.
+ *
+ * If zero, the connection always processes each changeset individually.
+ *
+ * The default value is 64.
+**/
+@property (atomic, assign, readwrite) NSUInteger changesetBacklogFlushThreshold;
+
+/**
+ * A long-lived read transaction that isn't updated (i.e. beginLongLivedReadTransaction isn't invoked again
+ * in response to YapDatabaseModifiedNotification) prevents the WAL from being reset, and the WAL keeps growing.
+ *
+ * If set, a long-lived read transaction that has fallen behind (i.e. there have been commits since it began),
+ * and hasn't been used for at least this long (by a read transaction on this connection),
+ * is automatically moved to the latest commit, as if by invoking beginLongLivedReadTransaction.
+ * The notifications that beginLongLivedReadTransaction would have returned are then posted
+ * (on the main thread) via YapDatabaseLongLivedReadTransactionAdvancedNotification,
+ * so you can update your UI exactly as you would have otherwise.
+ *
+ * The default value is zero, which disables this feature.
+ *
+ * @see -[YapDatabase setWALPinningDurationThreshold:frameThreshold:block:queue:]
+**/
+@property (atomic, assign, readwrite) NSTimeInterval longLivedReadTransactionIdleTimeout;
+
 /**
  * A long-lived read-only transaction is most often setup on a connection that is designed to be read-only.
  * But sometimes we forget, and a read-write transaction gets added that uses the read-only connection.
@@ -475,6 +1055,16 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
  * https://github.com/yapstudios/YapDatabase/wiki/LongLivedReadTransactions
 **/
 
+/**
+ * Returns a summary of the given notifications, which answers each of the queries below via hash lookups.
+ * The notifications are scanned once, when the summary is created.
+ *
+ * The connection retains the most recent summary, and returns it again if invoked with the same notifications.
+ * The methods below use this, so repeatedly querying the same notifications is cheap either way.
+ * But if you alternate between multiple arrays of notifications, you may want to hold onto the summary yourself.
+**/
+- (YapDatabaseChangeSummary *)changeSummaryForNotifications:(NSArray<NSNotification *> *)notifications;
+
 // Query for any change to a collection
 
 - (BOOL)hasChangeForCollection:(NSString *)collection inNotifications:(NSArray<NSNotification *> *)notifications;
@@ -524,6 +1114,17 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 **/
 - (BOOL)didClearCollection:(NSString *)collection inNotifications:(NSArray<NSNotification *> *)notifications;
 
+/**
+ * Returns YES if the collection was changed by a transaction with coarseChangeset enabled
+ * during any of the commits represented by the given notifications.
+ * 
+ * Such a transaction reports which collections were changed, rather than which keys.
+ * So the changed keys within the collection won't show up while enumerating changedKeys.
+ * 
+ * @see -[YapDatabaseReadWriteTransaction coarseChangeset]
+**/
+- (BOOL)didResetCollection:(NSString *)collection inNotifications:(NSArray<NSNotification *> *)notifications;
+
 /**
  * Returns YES if [transaction removeAllObjectsInAllCollections] was invoked
  * during any of the commits represented by the given notifications.
@@ -617,6 +1218,43 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 **/
 - (void)flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags;
 
+/**
+ * Flushes memory holders (limited to those allowed by the given flags), most expensive first,
+ * until the estimated footprint of the connection is at or below the given targetBytes.
+ *
+ * For example, if a view's pageCache is the largest holder and flushing it is enough to reach the target,
+ * then the objectCache & pre-compiled statements remain intact.
+ *
+ * Passing a targetBytes of zero is equivalent to flushMemoryWithFlags:.
+ *
+ * @see memoryReport
+**/
+- (void)flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags targetBytes:(uint64_t)targetBytes;
+
+/**
+ * Returns the estimated number of bytes held by each subsystem of the connection.
+ * This includes the connection's caches, the memory used by its sqlite instance (via sqlite3_db_status),
+ * and the caches & statements for each extension (e.g. "myView.pageCache").
+ *
+ * The report is generated on the connection's queue.
+ * So it waits for any transaction in progress on this connection (unless invoked from within one).
+ *
+ * @see YapDatabaseMemoryReport
+**/
+- (YapDatabaseMemoryReport *)memoryReport;
+
+/**
+ * Returns a sample of the live statistics of the connection:
+ * cache hits/misses/evictions (including the caches of extensions), prepared statements,
+ * and how far the connection's snapshot is behind the database's.
+ *
+ * Sampling is cheap (no disk I/O), so it's fine to poll periodically.
+ * Like memoryReport, it's generated on the connection's queue.
+ *
+ * @see YapDatabaseConnectionStatistics
+**/
+- (YapDatabaseConnectionStatistics *)statistics;
+
 #if TARGET_OS_IOS || TARGET_OS_TV
 /**
  * When a UIApplicationDidReceiveMemoryWarningNotification is received,
@@ -629,6 +1267,87 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 @property (atomic, assign, readwrite) YapDatabaseConnectionFlushMemoryFlags autoFlushMemoryFlags;
 #endif
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Prefetch
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Warms up the objectCache & metadataCache in the background.
+ * For example, at launch, you may prefetch the objects needed by the first screen,
+ * so its transactions hit the cache instead of deserializing one object at a time.
+ *
+ * The prefetch runs on the connection's queue at a low QoS, in small batches (each in its own read transaction).
+ * Since the queue is serial, a foreground transaction waits for (at most) the current batch.
+ * And once a foreground transaction is pending, the prefetch stops early (and the remaining keys are skipped).
+ *
+ * Note that prefetching more objects than the objectCacheLimit simply evicts the earlier ones.
+ *
+ * The optional completionBlock is invoked when the prefetch finishes (or stops early).
+ * If the completionQueue is NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)prefetchObjectsForKeys:(NSArray<NSString *> *)keys inCollection:(nullable NSString *)collection;
+
+- (void)prefetchObjectsForKeys:(NSArray<NSString *> *)keys
+                  inCollection:(nullable NSString *)collection
+               completionQueue:(nullable dispatch_queue_t)completionQueue
+               completionBlock:(nullable dispatch_block_t)completionBlock;
+
+/**
+ * Warms up the caches with (up to limit) objects from the given collection.
+ * A limit of zero means no limit.
+ *
+ * @see prefetchObjectsForKeys:inCollection:
+**/
+- (void)prefetchCollection:(nullable NSString *)collection limit:(NSUInteger)limit;
+
+- (void)prefetchCollection:(nullable NSString *)collection
+                     limit:(NSUInteger)limit
+           completionQueue:(nullable dispatch_queue_t)completionQueue
+           completionBlock:(nullable dispatch_block_t)completionBlock;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Storage
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns a breakdown of the space used by the database file:
+ * the bytes & overflow pages of every table and index (e.g. "database2", "true_primary_key",
+ * and the tables of each extension), the bytes & average row size of each collection,
+ * the freelist, and the size of the WAL.
+ *
+ * Every page of the database is read (via the "dbstat" virtual table), as well as the length of every row.
+ * So this may take a while for a large database. Consider the asynchronous version below.
+ *
+ * The report is generated within a single read transaction.
+ * This method must not be invoked from within a transaction on this connection.
+ *
+ * @see YapDatabaseStorageReport
+**/
+- (YapDatabaseStorageReport *)storageReport;
+
+/**
+ * Generates the storage report incrementally, in the background.
+ *
+ * The work runs on the connection's queue at a low QoS, in small batches (each in its own read transaction).
+ * Since the queue is serial, a foreground transaction waits for (at most) the current batch.
+ * (Note that each table or index is measured within a single batch.)
+ *
+ * Since the batches are separate transactions, the report may be slightly inconsistent
+ * if the database is modified in the meantime. (See YapDatabaseStorageReport.consistent)
+ *
+ * @param completionQueue
+ *   The dispatch queue to invoke the completionBlock on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @param completionBlock
+ *   Invoked with the report, or with nil if the progress was cancelled.
+ *
+ * @return
+ *   A NSProgress instance that may be used to track (or cancel) the work.
+**/
+- (NSProgress *)asyncStorageReportWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
+                                      completionBlock:(void (^)(YapDatabaseStorageReport *_Nullable report))completionBlock;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Pragma
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -690,6 +1409,19 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 **/
 - (NSString *)pragmaAutoVacuum;
 
+/**
+ * Returns the number of unused pages in the database file, via "PRAGMA freelist_count;".
+ *
+ * With "auto_vacuum=INCREMENTAL", these are the pages that incrementalVacuumWithPageBudget: can give back.
+ * The size (in bytes) can be approximated by multiplying by pragmaPageSize.
+**/
+- (NSUInteger)pragmaFreelistCount;
+
+/**
+ * Returns the total number of pages in the database file, via "PRAGMA page_count;".
+**/
+- (NSUInteger)pragmaPageCount;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Vacuum
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -747,6 +1479,74 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 - (void)asyncVacuumWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
                        completionBlock:(nullable dispatch_block_t)completionBlock;
 
+/**
+ * Performs a "PRAGMA incremental_vacuum(N)" on the sqlite database.
+ * That is, up to pageBudget pages are removed from the freelist, and the file is truncated accordingly.
+ * A pageBudget of zero reclaims the entire freelist.
+ *
+ * Unlike a VACUUM, this doesn't rewrite the database file.
+ * Its cost is proportional to the number of pages reclaimed,
+ * so a small budget keeps other writers from being blocked for long.
+ *
+ * This method operates as a synchronous ReadWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * This only has an effect if the database is in "auto_vacuum=INCREMENTAL" mode.
+ * (See YapDatabaseOptions.pragmaAutoVacuum, which also allows these steps to be scheduled automatically.)
+ *
+ * @return
+ *   The number of pages that were reclaimed.
+ *
+ * @see pragmaFreelistCount
+**/
+- (NSUInteger)incrementalVacuumWithPageBudget:(NSUInteger)pageBudget;
+
+/**
+ * Performs a "PRAGMA incremental_vacuum(N)" on the sqlite database.
+ *
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * An optional completion block may be used, which is given the number of pages that were reclaimed.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @see incrementalVacuumWithPageBudget:
+**/
+- (void)asyncIncrementalVacuumWithPageBudget:(NSUInteger)pageBudget
+                             completionQueue:(nullable dispatch_queue_t)completionQueue
+                             completionBlock:(nullable void (^)(NSUInteger reclaimedPageCount))completionBlock;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Compression
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Trains a new compression dictionary for the given collection, and (if it's an improvement) rotates it in.
+ * The collection must have a compression config. (See YapDatabaseOptions.compressionConfigs)
+ * 
+ * The most recently inserted rows of the collection are sampled (up to config.trainingSampleCount),
+ * and a dictionary is built from the content that the samples have in common.
+ * If the new dictionary compresses the samples better than the current one, it's stored in the database,
+ * and is used for every object written to the collection from then on.
+ * Existing rows are not rewritten, but remain readable, as previous dictionaries are never deleted.
+ * 
+ * This method runs in the background. The samples are fetched within a read-only transaction,
+ * the training itself happens outside of any transaction, and the new dictionary is stored via a quick readWrite transaction.
+ * Since the dictionary only needs to reflect the general shape of the collection's objects,
+ * it's sufficient to invoke this method occasionally (e.g. after a large import, or when the app is backgrounded).
+ * 
+ * The completionBlock is invoked with rotated == YES if a new dictionary was stored.
+ * If the completionQueue is NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * Note: If enableMultiProcessSupport is enabled, other processes will only pick up the new dictionary
+ * the next time they open the database. So you should only train dictionaries in multi-process setups
+ * when all processes restart regularly (or when only a single process writes to the collection).
+**/
+- (void)asyncTrainCompressionDictionaryForCollection:(NSString *)collection
+                                     completionQueue:(nullable dispatch_queue_t)completionQueue
+                                     completionBlock:(nullable void (^)(BOOL rotated))completionBlock;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Backup
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -820,6 +1620,87 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
                   completionQueue:(nullable dispatch_queue_t)completionQueue
                   completionBlock:(nullable void (^)(NSError * _Nullable))completionBlock;
 
+/**
+ * This method backs up the database by cloning the database file, if the filesystem supports it (e.g. APFS).
+ * A clone is copy-on-write, so it takes about the same (short) time no matter how big the database is,
+ * and only uses additional disk space as the database (or the backup) is subsequently modified.
+ * 
+ * This method operates as a synchronous ReadWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ * 
+ * In order for the database file to contain every commit, the WAL is checkpointed & truncated first.
+ * This requires every read transaction to be off the WAL, so long-lived read transactions are reset
+ * (as with a truncate checkpoint). Writers are blocked for the duration.
+ * 
+ * If the database file can't be cloned (unsupported filesystem, different volume, enableMultiProcessSupport,
+ * or the WAL couldn't be truncated because of an active reader), this method falls back to backupToPath:.
+ * 
+ * Any existing file at the given path is replaced.
+ * As with backupToPath:, it is your responsibilty to ensure that nothing else is currently using it.
+**/
+- (nullable NSError *)cloneBackupToPath:(NSString *)backupDatabasePath;
+
+/**
+ * This method backs up the database by cloning the database file, if the filesystem supports it (e.g. APFS).
+ * 
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ * 
+ * An optional completion block may be used.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * @see cloneBackupToPath:
+ * 
+ * @return
+ *   A NSProgress instance that may be used to track the backup progress.
+ *   The progress is only cancellable if the backup falls back to asyncBackupToPath:.
+**/
+- (NSProgress *)asyncCloneBackupToPath:(NSString *)backupDatabasePath
+                       completionQueue:(nullable dispatch_queue_t)completionQueue
+                       completionBlock:(nullable void (^)(NSError * _Nullable))completionBlock;
+
+/**
+ * This method backs up the database by writing the pages that have changed since the previous incremental backup.
+ * If there isn't a previous incremental backup (from this database instance), every page is written (a full backup).
+ *
+ * This requires YapDatabaseOptions.enableIncrementalBackup,
+ * and a version of sqlite that includes the sqlite_dbpage virtual table (SQLITE_ENABLE_DBPAGE_VTAB).
+ * Encrypted databases aren't supported (an error is returned), as the pages would be written decrypted.
+ *
+ * This method operates as a synchronous ReadWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * Changes are tracked in memory, so the first incremental backup after the database is opened is always a full backup.
+ * (As is every incremental backup when enableMultiProcessSupport is set, since changes made by other processes aren't seen.)
+ * You can inspect the resulting file via YapDatabaseIncrementalBackup,
+ * and rebuild a database file from a chain of backups via
+ * +[YapDatabaseIncrementalBackup rebuildDatabaseAtPath:fromBackupsAtPaths:].
+ *
+ * If the backup fails, the next incremental backup will be a full backup.
+**/
+- (nullable NSError *)incrementalBackupToPath:(NSString *)backupPath;
+
+/**
+ * This method backs up the database by writing the pages that have changed since the previous incremental backup.
+ *
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * An optional completion block may be used.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+ *
+ * @see incrementalBackupToPath:
+ *
+ * @return
+ *   A NSProgress instance that may be used to track the backup progress.
+ *   The progress in cancellable, meaning that invoking [progress cancel] will abort the backup operation.
+**/
+- (NSProgress *)asyncIncrementalBackupToPath:(NSString *)backupPath
+                             completionQueue:(nullable dispatch_queue_t)completionQueue
+                             completionBlock:(nullable void (^)(NSError * _Nullable))completionBlock;
+
 @end
 
 NS_ASSUME_NONNULL_END
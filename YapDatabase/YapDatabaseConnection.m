@@ -2,10 +2,18 @@
 
 #import "YapCache.h"
 #import "YapCollectionKey.h"
+#import "YapDatabaseAtomic.h"
+#import "YapDatabaseChangeSummary.h"
 #import "YapDatabaseConnectionState.h"
 #import "YapDatabaseExtensionPrivate.h"
+#import "YapDatabaseIncrementalBackupPrivate.h"
 #import "YapDatabaseLogging.h"
+#import "YapDatabaseMemoryReportPrivate.h"
 #import "YapDatabasePrivate.h"
+#import "YapDatabaseSignposts.h"
+#import "YapDatabaseStatisticsPrivate.h"
+#import "YapDatabaseStorageReportPrivate.h"
+#import "YapDatabaseTransactionBudgetPrivate.h"
 #import "YapDatabaseString.h"
 #import "YapNull.h"
 #import "YapSet.h"
@@ -13,6 +21,7 @@
 
 #import <mach/mach_time.h>
 #import <objc/runtime.h>
+#import <pthread.h>
 #import <stdatomic.h>
 
 #if TARGET_OS_IOS || TARGET_OS_TV
@@ -36,9 +45,16 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+NSString *const YapDatabaseLongLivedReadTransactionAdvancedNotification =
+                @"YapDatabaseLongLivedReadTransactionAdvancedNotification";
+
 static NSUInteger const UNLIMITED_CACHE_LIMIT = 0;
 static NSUInteger const MIN_KEY_CACHE_LIMIT   = 500;
 
+static NSUInteger const PREFETCH_BATCH_SIZE   = 50;
+
+static NSTimeInterval const STORAGE_REPORT_BATCH_DURATION = 0.008;
+
 #if YapDatabaseEnforcePermittedTransactions
 
 typedef BOOL (*IMP_NSThread_isMainThread)(id, SEL);
@@ -84,19 +100,58 @@ static int connectionBusyHandler(void *ptr, int count)
 	return 1;
 }
 
+/**
+ * Installed on every connection when a checkpoint policy is configured.
+ * Invoked by sqlite after each commit, with the number of frames in the WAL.
+**/
+static int connectionWALHook(void *ptr, sqlite3 __unused *db, const char __unused *dbName, int frameCount)
+{
+	YapDatabase *database = (__bridge YapDatabase *)ptr;
+	[database noteCommitWithWALFrameCount:frameCount];
+	
+	return SQLITE_OK;
+}
+
+/**
+ * An async read block, waiting (in a batch) to be executed within a coalesced read transaction.
+ * See coalescesAsyncReads.
+**/
+@interface YapDatabaseCoalescedRead : NSObject {
+@public
+	
+	void (^block)(YapDatabaseReadTransaction *transaction);
+	dispatch_queue_t completionQueue;
+	dispatch_block_t completionBlock;
+}
+@end
+
+@implementation YapDatabaseCoalescedRead
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @implementation YapDatabaseConnection {
 @private
 	
 	uint64_t snapshot;
+	int lastTotalChanges; // sqlite3_total_changes after the last read-write transaction
 	
 	id sharedKeySetForInternalChangeset;
 	id sharedKeySetForExternalChangeset;
 	
 	YapDatabaseReadTransaction *longLivedReadTransaction;
 	BOOL throwExceptionsForImplicitlyEndingLongLivedReadTransaction;
+	sqlite3_snapshot *longLivedSQLiteSnapshot; // non-NULL if the longLivedReadTransaction is detached
+	uint64_t longLivedReadTransactionUseTicks; // When the longLivedReadTransaction was last used (or begun)
+	BOOL longLivedReadTransactionAdvanceScheduled;
+	
+	YapDatabaseReadTransaction *recycledReadTransaction;
 	NSMutableArray *pendingChangesets;
 	NSMutableArray *processedChangesets;
 	BOOL isFastForwarding;
+	BOOL isCatchingUpBacklog;
 	
 	NSDictionary *registeredExtensions;
 	BOOL registeredExtensionsChanged;
@@ -109,6 +164,61 @@ static int connectionBusyHandler(void *ptr, int count)
 	id sharedKeySetForExtensions;
 	
 	atomic_ullong pendingTransactionCount;
+	atomic_ullong averageTransactionTicks;
+	
+	atomic_bool chunkedWriteMemoryPressure;
+	
+	YAPUnfairLock coalescedReadsLock;
+	NSMutableArray<YapDatabaseCoalescedRead *> *coalescedReads; // The open batch (nil if none), protected by lock
+	
+	YAPUnfairLock changeSummaryLock;
+	YapDatabaseChangeSummary *lastChangeSummary;
+	
+	YapDatabaseTransactionMetricsBlock transactionMetricsBlock;
+	dispatch_queue_t transactionMetricsQueue;
+	
+	NSTimeInterval transactionReadBudget;
+	NSTimeInterval transactionWriteBudget;
+	YapDatabaseTransactionBudgetBlock transactionBudgetBlock;
+	dispatch_queue_t transactionBudgetQueue;
+	dispatch_source_t transactionBudgetTimer;
+	uint64_t transactionBudgetStartTicks;               // Zero if the current transaction isn't budgeted
+	YapDatabaseTransactionMetrics *transactionBudgetMetrics;
+	
+	YAPUnfairLock transactionBudgetLock;                 // Protects the ivars below (shared with the timer)
+	thread_t transactionBudgetThread;                     // The thread executing the budgeted transaction
+	BOOL transactionBudgetArmed;
+	NSUInteger transactionBudgetFrameCount;
+	uintptr_t transactionBudgetFrames[YAP_TRANSACTION_BUDGET_MAX_FRAMES];
+	
+	YapDatabaseWorkloadTraceRecorder *workloadTraceRecorder;
+	uint32_t workloadTraceConnectionID;
+	
+	YDBSignpostID transactionSignpost;
+	
+	uint64_t mmapSize;      // The mmap_size we last set (if adaptive sizing is enabled)
+	
+	NSUInteger pageCacheSize;
+	NSUInteger pageCacheMaximumSize;
+	BOOL pageCacheSpillEnabled;
+	
+	uint64_t appliedPageCacheSize;  // The cache_size (in bytes) we last set (zero if the sqlite default)
+	int appliedPageCacheSpill;      // The cache_spill we last set (-1 if unknown)
+	uint64_t adaptivePageCacheSize; // The size the page cache has grown to (zero if it hasn't)
+	uint64_t adaptivePageCacheHits;
+	uint64_t adaptivePageCacheMisses;
+	
+	yap_queue_wait_stats queueWaitStats[YAP_QUEUE_WAIT_COUNT];
+	YapDatabaseQueueHolder *connectionQueueHolder;
+	uint64_t queueWaitTransactionID;                // The current transaction (zero if none)
+	BOOL queueWaitReadWrite;
+	uint64_t writeQueueWaitTicks;
+	YapDatabaseQueueWaitEvent *writeQueueWaitEvent;
+	
+	atomic_bool queueWaitEventsEnabled;
+	NSTimeInterval queueWaitThreshold;
+	YapDatabaseQueueWaitBlock queueWaitBlock;
+	dispatch_queue_t queueWaitQueue;
 	
 	sqlite3_stmt *beginTransactionStatement;
 	sqlite3_stmt *beginImmediateTransactionStatement;
@@ -140,6 +250,11 @@ static int connectionBusyHandler(void *ptr, int count)
 	sqlite3_stmt *removeCollectionStatement;
 	sqlite3_stmt *removeAllStatement;
 	
+	sqlite3_stmt *getCollectionIdStatement;    // Only used with collection-id schema
+	sqlite3_stmt *insertCollectionStatement;   // Only used with collection-id schema
+	
+	NSMutableDictionary<NSString *, NSNumber *> *collectionIds; // Only used with collection-id schema
+	
 	sqlite3_stmt *enumerateCollectionsStatement;
 	sqlite3_stmt *enumerateCollectionsForKeyStatement;
 	sqlite3_stmt *enumerateKeysInCollectionStatement;
@@ -150,6 +265,19 @@ static int connectionBusyHandler(void *ptr, int count)
 	sqlite3_stmt *enumerateKeysAndObjectsInAllCollectionsStatement;
 	sqlite3_stmt *enumerateRowsInCollectionStatement;
 	sqlite3_stmt *enumerateRowsInAllCollectionsStatement;
+	sqlite3_stmt *enumerateKeysInRangeStatement;
+	sqlite3_stmt *enumerateKeysInRangeReverseStatement;
+	sqlite3_stmt *enumerateKeysAndObjectsInRangeStatement;
+	sqlite3_stmt *enumerateKeysAndObjectsInRangeReverseStatement;
+	sqlite3_stmt *enumerateRowsInCollectionPageStatement;
+	
+	sqlite3_stmt *getExpirationForRowidStatement;
+	sqlite3_stmt *setExpirationForRowidStatement;
+	sqlite3_stmt *removeExpirationForRowidStatement;
+	sqlite3_stmt *enumerateExpiredRowidsStatement;
+	
+	sqlite3_stmt *getContentHashForRowidStatement;
+	sqlite3_stmt *setContentHashForRowidStatement;
 }
 
 + (void)load
@@ -214,12 +342,22 @@ static int connectionBusyHandler(void *ptr, int count)
 		YapDatabaseOptions *options = database.options;
 		
 		enableMultiProcessSupport = options.enableMultiProcessSupport;
+		readOnlyImmutable = options.readOnlyImmutable;
 		
 		YapDatabaseConnectionConfig *defaults = inConfig ?: database.connectionDefaults;
 		
 		objectCacheLimit = defaults.objectCacheLimit;
 		metadataCacheLimit = defaults.metadataCacheLimit;
 		
+		objectCacheCostLimit = defaults.objectCacheCostLimit;
+		metadataCacheCostLimit = defaults.metadataCacheCostLimit;
+		
+		objectCacheCostBlock = defaults.objectCacheCostBlock;
+		metadataCacheCostBlock = defaults.metadataCacheCostBlock;
+		
+		objectCacheAdmissionPolicy = defaults.objectCacheAdmissionPolicy;
+		metadataCacheAdmissionPolicy = defaults.metadataCacheAdmissionPolicy;
+		
 		if (defaults.objectCacheEnabled)
 		{
 			[self initializeObjectCache];
@@ -231,23 +369,32 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSUInteger keyCacheLimit = [self calculateKeyCacheLimit];
 		
-		YapBidirectionalCacheCallBacks RowidCallBacks = kYapBidirectionalCacheDefaultCallBacks;
-		RowidCallBacks.shouldCopy = NO;
-		
 		YapBidirectionalCacheCallBacks YapCollectionKeyCallBacks = kYapBidirectionalCacheDefaultCallBacks;
 		YapCollectionKeyCallBacks.shouldCopy = NO;
 		YapCollectionKeyCallBacks.equal = (CFDictionaryEqualCallBack)YapCollectionKeyEqual;
 		YapCollectionKeyCallBacks.hash = (CFDictionaryHashCallBack)YapCollectionKeyHash;
 		
-		keyCache = [[YapBidirectionalCache alloc] initWithCountLimit:keyCacheLimit
-		                                                keyCallbacks:&RowidCallBacks
-		                                             objectCallbacks:&YapCollectionKeyCallBacks];
-		keyCache.allowedKeyClasses = [NSSet setWithObject:[NSNumber class]];
+		keyCache = [[YapRowidBidirectionalCache alloc] initWithCountLimit:keyCacheLimit
+		                                                  objectCallbacks:&YapCollectionKeyCallBacks];
 		keyCache.allowedObjectClasses = [NSSet setWithObject:[YapCollectionKey class]];
 		
 		objectPolicy = defaults.objectPolicy;
 		metadataPolicy = defaults.metadataPolicy;
 		
+		pageCacheSize = defaults.pageCacheSize;
+		pageCacheMaximumSize = defaults.pageCacheMaximumSize;
+		pageCacheSpillEnabled = defaults.pageCacheSpillEnabled;
+		appliedPageCacheSpill = 1;
+		
+		self.changesetBacklogFlushThreshold = 64;
+		
+		changeSummaryLock = YAP_UNFAIR_LOCK_INIT;
+		transactionBudgetLock = YAP_UNFAIR_LOCK_INIT;
+		coalescedReadsLock = YAP_UNFAIR_LOCK_INIT;
+		
+		connectionQueueHolder = [[YapDatabaseQueueHolder alloc] init];
+		atomic_init(&queueWaitEventsEnabled, false);
+		
 		#if YapDatabaseEnforcePermittedTransactions
 		self.permittedTransactions = YDB_AnyTransaction;
 		#endif
@@ -269,73 +416,17 @@ static int connectionBusyHandler(void *ptr, int count)
 			}
 			
 			sqlite3_busy_handler(db, connectionBusyHandler, (__bridge void *)self);
+			
+			// The page cache settings of the previous owner may still be in effect.
+			
+			appliedPageCacheSize = UINT64_MAX;
+			appliedPageCacheSpill = -1;
 		}
 		else
 		{
-			// Open the database connection.
-			//
-			// We use SQLITE_OPEN_NOMUTEX to use the multi-thread threading mode,
-			// as we will be serializing access to the connection externally.
-			
-			int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
-			
-			int status = sqlite3_open_v2([database.databasePath UTF8String], &db, flags,
-			                             [database->yap_vfs_shim_name UTF8String]);
-			if (status != SQLITE_OK)
-			{
-				// Sometimes the open function returns a db to allow us to query it for the error message
-				if (db) {
-					YDBLogWarn(@"Error opening database: %d %s", status, sqlite3_errmsg(db));
-				}
-				else {
-					YDBLogError(@"Error opening database: %d", status);
-				}
-			}
-			else
+			int status = [YapDatabaseConnection openDatabaseHandle:&db forDatabase:database];
+			if (status == SQLITE_OK)
 			{
-				// Set configurable pragmas
-				
-				YapDatabasePragmaSynchronous pragmaSynchronous = options.pragmaSynchronous;
-				
-				if (pragmaSynchronous == YapDatabasePragmaSynchronous_Off ||
-				    pragmaSynchronous == YapDatabasePragmaSynchronous_Normal)
-				{
-					char *pragma_stmt = NULL;
-					
-					if (pragmaSynchronous == YapDatabasePragmaSynchronous_Off)
-						pragma_stmt = "PRAGMA synchronous = OFF;";
-					else
-						pragma_stmt = "PRAGMA synchronous = NORMAL;";
-				
-					status = sqlite3_exec(db, pragma_stmt, NULL, NULL, NULL);
-					if (status != SQLITE_OK)
-					{
-						YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
-					}
-				}
-				
-				if (options.pragmaMMapSize > 0)
-				{
-					NSString *pragma_mmap_size =
-					  [NSString stringWithFormat:@"PRAGMA mmap_size = %ld;", (long)options.pragmaMMapSize];
-					
-					status = sqlite3_exec(db, [pragma_mmap_size UTF8String], NULL, NULL, NULL);
-					if (status != SQLITE_OK)
-					{
-						YDBLogError(@"Error setting PRAGMA mmap_size: %d %s", status, sqlite3_errmsg(db));
-						// This isn't critical, so we can continue.
-					}
-				}
-				
-				// Disable autocheckpointing.
-				//
-				// YapDatabase has its own optimized checkpointing algorithm built-in.
-				// It knows the state of every active connection for the database,
-				// so it can invoke the checkpoint methods at the precise time
-				// in which a checkpoint can be most effective.
-				
-				sqlite3_wal_autocheckpoint(db, 0);
-				
 				// Install busy handler.
 				//
 				// When multi-process support is ENABLED:
@@ -356,13 +447,8 @@ static int connectionBusyHandler(void *ptr, int count)
 				//   For now I'm setting a busy timeout as a temporary workaround.
 				//
 				//   Note: In all my testing, I've only seen the busy_handler called once per db.
-                
+				
 				sqlite3_busy_handler(db, connectionBusyHandler, (__bridge void *)self);
-                
-#ifdef SQLITE_HAS_CODEC
-				// Configure SQLCipher encryption (if needed)
-				[database configureEncryptionForDatabase:db];
-#endif
 			}
 		}
 		
@@ -376,6 +462,112 @@ static int connectionBusyHandler(void *ptr, int count)
 	return self;
 }
 
+/**
+ * Opens and configures a new sqlite3 instance, ready to be used by a connection.
+ * 
+ * This is used when a connection can't recycle an instance from the connection pool,
+ * and by YapDatabase to prewarm the connection pool (see YapDatabaseOptions.connectionPrewarmCount).
+ * 
+ * Note: The busy handler isn't installed, as it depends upon the owner of the instance.
+ * 
+ * @return
+ *   The status from sqlite3_open_v2. Note that sqlite may return a db, even if the open failed.
+**/
++ (int)openDatabaseHandle:(sqlite3 **)pDb forDatabase:(YapDatabase *)database
+{
+	YapDatabaseOptions *options = database.options;
+	sqlite3 *db = NULL;
+	
+	// Open the database connection.
+	//
+	// We use SQLITE_OPEN_NOMUTEX to use the multi-thread threading mode,
+	// as we will be serializing access to the connection externally.
+	
+	int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
+	flags = [database sqliteOpenFlags:flags];
+	
+	int result = sqlite3_open_v2([[database sqliteOpenFilename] UTF8String], &db, flags,
+	                             [database->yap_vfs_shim_name UTF8String]);
+	if (result != SQLITE_OK)
+	{
+		// Sometimes the open function returns a db to allow us to query it for the error message
+		if (db) {
+			YDBLogWarn(@"Error opening database: %d %s", result, sqlite3_errmsg(db));
+		}
+		else {
+			YDBLogError(@"Error opening database: %d", result);
+		}
+	}
+	else
+	{
+		int status;
+		
+		// Set configurable pragmas
+		
+		YapDatabasePragmaSynchronous pragmaSynchronous = options.pragmaSynchronous;
+		
+		if (pragmaSynchronous == YapDatabasePragmaSynchronous_Off ||
+		    pragmaSynchronous == YapDatabasePragmaSynchronous_Normal)
+		{
+			char *pragma_stmt = NULL;
+			
+			if (pragmaSynchronous == YapDatabasePragmaSynchronous_Off)
+				pragma_stmt = "PRAGMA synchronous = OFF;";
+			else
+				pragma_stmt = "PRAGMA synchronous = NORMAL;";
+		
+			status = sqlite3_exec(db, pragma_stmt, NULL, NULL, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
+			}
+		}
+		
+		if (options.pragmaMMapSizeMaximum > 0)
+		{
+			[self updateMMapSizeIfNeeded];
+		}
+		else if (options.pragmaMMapSize > 0)
+		{
+			NSString *pragma_mmap_size =
+			  [NSString stringWithFormat:@"PRAGMA mmap_size = %ld;", (long)options.pragmaMMapSize];
+			
+			status = sqlite3_exec(db, [pragma_mmap_size UTF8String], NULL, NULL, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error setting PRAGMA mmap_size: %d %s", status, sqlite3_errmsg(db));
+				// This isn't critical, so we can continue.
+			}
+		}
+		
+		// Disable autocheckpointing.
+		//
+		// YapDatabase has its own optimized checkpointing algorithm built-in.
+		// It knows the state of every active connection for the database,
+		// so it can invoke the checkpoint methods at the precise time
+		// in which a checkpoint can be most effective.
+		
+		sqlite3_wal_autocheckpoint(db, 0);
+		
+		// Install WAL hook (if needed).
+		//
+		// This allows the checkpoint policy to monitor the size of the WAL after every commit.
+		// Note that disabling autocheckpointing (above) removes any previously installed WAL hook.
+		
+		if (options.checkpointPolicy && !options.readOnlyImmutable) {
+			sqlite3_wal_hook(db, connectionWALHook, (__bridge void *)database);
+		}
+		
+#ifdef SQLITE_HAS_CODEC
+		// Configure SQLCipher encryption (if needed)
+		[database configureEncryptionForDatabase:db];
+#endif
+	}
+	
+	*pDb = db;
+	return result;
+}
+
 /**
  * This method will be invoked before any other method.
  * It can be used to do any setup that may be needed.
@@ -416,8 +608,15 @@ static int connectionBusyHandler(void *ptr, int count)
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
 		if (longLivedReadTransaction) {
+			
+			if (longLivedSQLiteSnapshot) {
+				[longLivedReadTransaction beginTransaction];
+			}
+			
 			[self postReadTransaction:longLivedReadTransaction];
 			longLivedReadTransaction = nil;
+			
+			[self releaseLongLivedSQLiteSnapshot];
 		}
 		
 	#pragma clang diagnostic pop
@@ -430,8 +629,20 @@ static int connectionBusyHandler(void *ptr, int count)
 	
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
 	
+	if (transactionMetricsBlock || transactionBudgetBlock) {
+		atomic_fetch_sub_explicit(&database->transactionMetricsConnectionCount, 1, memory_order_relaxed);
+	}
+	
+	if (transactionBudgetTimer) {
+		dispatch_source_cancel(transactionBudgetTimer);
+	}
+	
 	[extensions removeAllObjects];
 	
+	if (removedRowids) {
+		YapRowidSetRelease(removedRowids);
+	}
+	
 	[self _flushStatements];
 	
 	if (db)
@@ -505,6 +716,9 @@ static int connectionBusyHandler(void *ptr, int count)
 	sqlite_finalize_null(&removeCollectionStatement);
 	sqlite_finalize_null(&removeAllStatement);
 	
+	sqlite_finalize_null(&getCollectionIdStatement);
+	sqlite_finalize_null(&insertCollectionStatement);
+	
 	sqlite_finalize_null(&enumerateCollectionsStatement);
 	sqlite_finalize_null(&enumerateCollectionsForKeyStatement);
 	sqlite_finalize_null(&enumerateKeysInCollectionStatement);
@@ -515,6 +729,19 @@ static int connectionBusyHandler(void *ptr, int count)
 	sqlite_finalize_null(&enumerateKeysAndObjectsInAllCollectionsStatement);
 	sqlite_finalize_null(&enumerateRowsInCollectionStatement);
 	sqlite_finalize_null(&enumerateRowsInAllCollectionsStatement);
+	sqlite_finalize_null(&enumerateKeysInRangeStatement);
+	sqlite_finalize_null(&enumerateKeysInRangeReverseStatement);
+	sqlite_finalize_null(&enumerateKeysAndObjectsInRangeStatement);
+	sqlite_finalize_null(&enumerateKeysAndObjectsInRangeReverseStatement);
+	sqlite_finalize_null(&enumerateRowsInCollectionPageStatement);
+	
+	sqlite_finalize_null(&getExpirationForRowidStatement);
+	sqlite_finalize_null(&setExpirationForRowidStatement);
+	sqlite_finalize_null(&removeExpirationForRowidStatement);
+	sqlite_finalize_null(&enumerateExpiredRowidsStatement);
+	
+	sqlite_finalize_null(&getContentHashForRowidStatement);
+	sqlite_finalize_null(&setContentHashForRowidStatement);
 }
 
 - (void)_flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags
@@ -524,6 +751,9 @@ static int connectionBusyHandler(void *ptr, int count)
 		[keyCache removeAllObjects];
 		[objectCache removeAllObjects];
 		[metadataCache removeAllObjects];
+		[extensionValuesCache removeAllObjects];
+		
+		[database->sharedObjectCache removeAllObjects];
 	}
 	
 	if (flags & YapDatabaseConnectionFlushMemoryFlags_Statements)
@@ -533,7 +763,10 @@ static int connectionBusyHandler(void *ptr, int count)
 	
 	if (flags & YapDatabaseConnectionFlushMemoryFlags_Internal)
 	{
+		[self shrinkPageCache];
 		sqlite3_db_release_memory(db);
+		
+		recycledReadTransaction = nil;
 	}
 	
 	[extensions enumerateKeysAndObjectsUsingBlock:^(id __unused extNameObj, id extConnectionObj, BOOL __unused *stop) {
@@ -573,134 +806,148 @@ static int connectionBusyHandler(void *ptr, int count)
 		dispatch_async(connectionQueue, block);
 }
 
-#if TARGET_OS_IOS || TARGET_OS_TV
-- (void)didReceiveMemoryWarning:(NSNotification __unused *)notification
-{
-	[self flushMemoryWithFlags:[self autoFlushMemoryFlags]];
-}
-#endif
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Properties
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-@synthesize database = database;
-@synthesize name = _name;
-
-@dynamic objectCacheEnabled;
-@dynamic objectCacheLimit;
-
-@dynamic metadataCacheEnabled;
-@dynamic metadataCacheLimit;
-
-@dynamic objectPolicy;
-@dynamic metadataPolicy;
-
-#if YapDatabaseEnforcePermittedTransactions
-@synthesize permittedTransactions = _mustUseAtomicProperty_permittedTransactions;
-#endif
-
-#if TARGET_OS_IOS || TARGET_OS_TV
-@synthesize autoFlushMemoryFlags;
-#endif
-
-@dynamic snapshot;
-@dynamic pendingTransactionCount;
-
-- (BOOL)objectCacheEnabled
+/**
+ * Returns every (significant) memory holder of the connection, including those of the extensions.
+ * This method is only invoked on the connectionQueue.
+**/
+- (NSArray<YapDatabaseMemoryHolder *> *)memoryHolders
 {
-	__block BOOL result = NO;
+	NSMutableArray<YapDatabaseMemoryHolder *> *holders = [NSMutableArray array];
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push // silence warnings: synchronous access
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	void (^AddHolder)(NSString*, NSString*, uint64_t, YapDatabaseConnectionFlushMemoryFlags) =
+	^(NSString *component, NSString *extensionName, uint64_t bytes, YapDatabaseConnectionFlushMemoryFlags flushFlags){
 		
-		result = (objectCache != nil);
+		YapDatabaseMemoryHolder *holder = [[YapDatabaseMemoryHolder alloc] init];
+		holder->component = component;
+		holder->extensionName = extensionName;
+		holder->bytes = bytes;
+		holder->flushFlags = flushFlags;
 		
-	#pragma clang diagnostic pop
+		[holders addObject:holder];
 	};
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	AddHolder(YapDatabaseMemoryComponentObjectCache, nil,
+	          [objectCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+	AddHolder(YapDatabaseMemoryComponentMetadataCache, nil,
+	          [metadataCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
+	AddHolder(YapDatabaseMemoryComponentKeyCache, nil,
+	          [keyCache estimatedMemoryUsage], YapDatabaseConnectionFlushMemoryFlags_Caches);
 	
-	return result;
-}
-
-- (void)setObjectCacheEnabled:(BOOL)flag
-{
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	__block uint64_t extensionStatementBytes = 0;
+	
+	[extensions enumerateKeysAndObjectsUsingBlock:^(NSString *extName, id extConnectionObj, BOOL __unused *stop) {
 		
-		if (flag) // Enabled
+		[(YapDatabaseExtensionConnection *)extConnectionObj enumerateMemoryUsageWithBlock:
+		    ^(NSString *component, uint64_t bytes, YapDatabaseConnectionFlushMemoryFlags flushFlags)
 		{
-			if (objectCache == nil)
-			{
-				[self initializeObjectCache];
+			NSString *name = [NSString stringWithFormat:@"%@.%@", extName, component];
+			AddHolder(name, extName, bytes, flushFlags);
+			
+			if (flushFlags & YapDatabaseConnectionFlushMemoryFlags_Statements) {
+				extensionStatementBytes += bytes;
 			}
-		}
-		else // Disabled
-		{
-			objectCache = nil;
-		}
-		
-		keyCache.countLimit = [self calculateKeyCacheLimit];
-		
-	#pragma clang diagnostic pop
-	};
+		}];
+	}];
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_async(connectionQueue, block);
-}
-
-- (NSUInteger)objectCacheLimit
-{
-	__block NSUInteger result = 0;
+	int current = 0;
+	int highwater = 0;
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		result = objectCacheLimit;
+	if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0) == SQLITE_OK)
+	{
+		AddHolder(YapDatabaseMemoryComponentSQLitePageCache, nil,
+		          (uint64_t)MAX(current, 0), YapDatabaseConnectionFlushMemoryFlags_Internal);
+	}
+	
+	if (sqlite3_db_status(db, SQLITE_DBSTATUS_STMT_USED, &current, &highwater, 0) == SQLITE_OK)
+	{
+		// The extension statements are included in this number, but were already attributed to the extensions.
+		uint64_t statementBytes = (uint64_t)MAX(current, 0);
+		statementBytes -= MIN(statementBytes, extensionStatementBytes);
 		
-	#pragma clang diagnostic pop
-	};
+		AddHolder(YapDatabaseMemoryComponentSQLiteStatements, nil,
+		          statementBytes, YapDatabaseConnectionFlushMemoryFlags_Statements);
+	}
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	if (sqlite3_db_status(db, SQLITE_DBSTATUS_SCHEMA_USED, &current, &highwater, 0) == SQLITE_OK)
+	{
+		// Not flushable
+		AddHolder(YapDatabaseMemoryComponentSQLiteSchema, nil, (uint64_t)MAX(current, 0), 0);
+	}
 	
-	return result;
+	return holders;
 }
 
-- (void)setObjectCacheLimit:(NSUInteger)newObjectCacheLimit
+- (void)flushMemoryHolder:(YapDatabaseMemoryHolder *)holder
 {
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	if (holder->extensionName)
+	{
+		// Note: This may flush sibling holders too (e.g. both the mapCache & pageCache of a view).
 		
-		if (objectCacheLimit != newObjectCacheLimit)
+		YapDatabaseExtensionConnection *extConnection = extensions[holder->extensionName];
+		[extConnection _flushMemoryWithFlags:holder->flushFlags];
+	}
+	else if ([holder->component isEqualToString:YapDatabaseMemoryComponentObjectCache])
+	{
+		[objectCache removeAllObjects];
+	}
+	else if ([holder->component isEqualToString:YapDatabaseMemoryComponentMetadataCache])
+	{
+		[metadataCache removeAllObjects];
+	}
+	else if ([holder->component isEqualToString:YapDatabaseMemoryComponentKeyCache])
+	{
+		[keyCache removeAllObjects];
+	}
+	else if ([holder->component isEqualToString:YapDatabaseMemoryComponentSQLiteStatements])
+	{
+		[self _flushStatements];
+	}
+	else if ([holder->component isEqualToString:YapDatabaseMemoryComponentSQLitePageCache])
+	{
+		[self shrinkPageCache];
+		sqlite3_db_release_memory(db);
+	}
+}
+
+- (void)flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags targetBytes:(uint64_t)targetBytes
+{
+	if (targetBytes == 0)
+	{
+		[self flushMemoryWithFlags:flags];
+		return;
+	}
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
+		
+		NSArray<YapDatabaseMemoryHolder *> *holders = [self memoryHolders];
+		
+		uint64_t totalBytes = 0;
+		for (YapDatabaseMemoryHolder *holder in holders)
 		{
-			objectCacheLimit = newObjectCacheLimit;
-			
-			if (objectCache == nil)
-			{
-				// Limit changed, but objectCache is still disabled
-			}
-			else
-			{
-				objectCache.countLimit = objectCacheLimit;
-				keyCache.countLimit = [self calculateKeyCacheLimit];
-			}
+			totalBytes += holder->bytes;
 		}
 		
-	#pragma clang diagnostic pop
-	};
+		NSArray<YapDatabaseMemoryHolder *> *sortedHolders =
+		  [holders sortedArrayUsingComparator:^NSComparisonResult(YapDatabaseMemoryHolder *h1, YapDatabaseMemoryHolder *h2) {
+			
+			if (h1->bytes > h2->bytes) return NSOrderedAscending; // largest first
+			if (h1->bytes < h2->bytes) return NSOrderedDescending;
+			return NSOrderedSame;
+		}];
+		
+		for (YapDatabaseMemoryHolder *holder in sortedHolders)
+		{
+			if (totalBytes <= targetBytes) break;
+			
+			if (holder->bytes == 0) continue;
+			if ((holder->flushFlags & flags) == 0) continue;
+			
+			YDBLogVerbose(@"Flushing %@ (%llu bytes)", holder->component, holder->bytes);
+			
+			[self flushMemoryHolder:holder];
+			totalBytes -= holder->bytes;
+		}
+	}};
 	
 	if (dispatch_get_specific(IsOnConnectionQueueKey))
 		block();
@@ -708,206 +955,415 @@ static int connectionBusyHandler(void *ptr, int count)
 		dispatch_async(connectionQueue, block);
 }
 
-- (BOOL)metadataCacheEnabled
+- (YapDatabaseMemoryReport *)memoryReport
 {
-	__block BOOL result = NO;
+	__block YapDatabaseMemoryReport *report = nil;
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	dispatch_block_t block = ^{ @autoreleasepool {
 		
-		result = (metadataCache != nil);
+		NSArray<YapDatabaseMemoryHolder *> *holders = [self memoryHolders];
+		NSMutableDictionary<NSString *, NSNumber *> *components =
+		  [NSMutableDictionary dictionaryWithCapacity:[holders count]];
 		
-	#pragma clang diagnostic pop
-	};
+		for (YapDatabaseMemoryHolder *holder in holders)
+		{
+			components[holder->component] = @(holder->bytes);
+		}
+		
+		report = [[YapDatabaseMemoryReport alloc] initWithComponents:components];
+	}};
 	
 	if (dispatch_get_specific(IsOnConnectionQueueKey))
 		block();
 	else
 		dispatch_sync(connectionQueue, block);
 	
-	return result;
+	return report;
 }
 
-- (void)setMetadataCacheEnabled:(BOOL)flag
+- (YapDatabaseConnectionStatistics *)statistics
 {
-	dispatch_block_t block = ^{
+	YapDatabaseConnectionStatistics *statistics = [[YapDatabaseConnectionStatistics alloc] init];
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		if (flag) // Enabled
-		{
-			if (metadataCache == nil)
-			{
-				[self initializeMetadataCache];
-			}
-		}
-		else // Disabled
+		uint64_t dbSnapshot = [database snapshot];
+		
+		statistics->name = _name;
+		statistics->snapshot = snapshot;
+		statistics->snapshotLag = (dbSnapshot > snapshot) ? (dbSnapshot - snapshot) : 0;
+		statistics->hasLongLivedReadTransaction = (longLivedReadTransaction != nil);
+		statistics->pendingChangesetCount = [pendingChangesets count];
+		
+		NSUInteger statementCount = 0;
+		sqlite3_stmt *stmt = NULL;
+		while ((stmt = sqlite3_next_stmt(db, stmt)))
 		{
-			metadataCache = nil;
+			statementCount++;
 		}
+		statistics->preparedStatementCount = statementCount;
+		statistics->mmapSize = (uint64_t)MAX(0, [YapDatabase pragma:@"mmap_size" using:db]);
 		
-		keyCache.countLimit = [self calculateKeyCacheLimit];
+		int pageCacheUsed = 0;
+		int pageCacheHighwater = 0;
+		sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &pageCacheUsed, &pageCacheHighwater, 0);
+		
+		statistics->pageCacheUsed = (uint64_t)MAX(0, pageCacheUsed);
+		
+		statistics->objectCache = [[YapDatabaseCacheStatistics alloc] initWithCache:objectCache];
+		statistics->metadataCache = [[YapDatabaseCacheStatistics alloc] initWithCache:metadataCache];
+		
+		NSMutableDictionary<NSString *, YapDatabaseCacheStatistics *> *extensionCaches = [NSMutableDictionary dictionary];
+		
+		[extensions enumerateKeysAndObjectsUsingBlock:^(NSString *extName, id extConnectionObj, BOOL __unused *stop) {
+			
+			[(YapDatabaseExtensionConnection *)extConnectionObj enumerateCachesWithBlock:
+			    ^(NSString *cacheName, YapCache *cache)
+			{
+				NSString *name = [NSString stringWithFormat:@"%@.%@", extName, cacheName];
+				extensionCaches[name] = [[YapDatabaseCacheStatistics alloc] initWithCache:cache];
+			}];
+		}];
+		
+		statistics->extensionCaches = [extensionCaches copy];
 		
 	#pragma clang diagnostic pop
-	};
+	}};
 	
 	if (dispatch_get_specific(IsOnConnectionQueueKey))
 		block();
 	else
-		dispatch_async(connectionQueue, block);
+		dispatch_sync(connectionQueue, block);
+	
+	return statistics;
 }
 
-- (NSUInteger)metadataCacheLimit
+#if TARGET_OS_IOS || TARGET_OS_TV
+- (void)didReceiveMemoryWarning:(NSNotification __unused *)notification
 {
-	__block NSUInteger result = 0;
+	[self flushMemoryWithFlags:[self autoFlushMemoryFlags]];
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Prefetch
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)prefetchObjectsForKeys:(NSArray<NSString *> *)keys inCollection:(NSString *)collection
+{
+	[self prefetchObjectsForKeys:keys inCollection:collection completionQueue:NULL completionBlock:NULL];
+}
+
+- (void)prefetchObjectsForKeys:(NSArray<NSString *> *)inKeys
+                  inCollection:(NSString *)collection
+               completionQueue:(dispatch_queue_t)completionQueue
+               completionBlock:(dispatch_block_t)completionBlock
+{
+	NSArray<NSString *> *keys = [inKeys copy];
+	if (collection == nil) collection = @"";
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	[self prefetchObjectsWithKeysBlock:^NSArray<YapCollectionKey *> *(YapDatabaseReadTransaction __unused *transaction) {
 		
-		result = metadataCacheLimit;
+		NSMutableArray<YapCollectionKey *> *collectionKeys = [NSMutableArray arrayWithCapacity:keys.count];
+		for (NSString *key in keys)
+		{
+			[collectionKeys addObject:YapCollectionKeyCreate(collection, key)];
+		}
 		
-	#pragma clang diagnostic pop
-	};
-	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
-	
-	return result;
+		return collectionKeys;
+		
+	} completionQueue:completionQueue completionBlock:completionBlock];
 }
 
-- (void)setMetadataCacheLimit:(NSUInteger)newMetadataCacheLimit
+- (void)prefetchCollection:(NSString *)collection limit:(NSUInteger)limit
 {
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	[self prefetchCollection:collection limit:limit completionQueue:NULL completionBlock:NULL];
+}
+
+- (void)prefetchCollection:(NSString *)collection
+                     limit:(NSUInteger)limit
+           completionQueue:(dispatch_queue_t)completionQueue
+           completionBlock:(dispatch_block_t)completionBlock
+{
+	if (collection == nil) collection = @"";
+	
+	[self prefetchObjectsWithKeysBlock:^NSArray<YapCollectionKey *> *(YapDatabaseReadTransaction *transaction) {
 		
-		if (metadataCacheLimit != newMetadataCacheLimit)
-		{
-			metadataCacheLimit = newMetadataCacheLimit;
+		// Enumerating the keys is cheap (nothing is deserialized).
+		// The objects themselves are fetched in batches.
+		
+		NSMutableArray<YapCollectionKey *> *collectionKeys = [NSMutableArray array];
+		
+		[transaction enumerateKeysInCollection:collection usingBlock:^(NSString *key, BOOL *stop) {
 			
-			if (metadataCache == nil)
-			{
-				// Limit changed but metadataCache still disabled
-			}
-			else
-			{
-				metadataCache.countLimit = metadataCacheLimit;
-				keyCache.countLimit = [self calculateKeyCacheLimit];
+			[collectionKeys addObject:YapCollectionKeyCreate(collection, key)];
+			
+			if (limit > 0 && collectionKeys.count >= limit) {
+				*stop = YES;
 			}
-		}
+		}];
 		
-	#pragma clang diagnostic pop
-	};
-	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_async(connectionQueue, block);
+		return collectionKeys;
+		
+	} completionQueue:completionQueue completionBlock:completionBlock];
 }
 
-- (YapDatabasePolicy)objectPolicy
+/**
+ * The keysBlock is invoked within the first (background) read transaction.
+ * The returned keys are then fetched, PREFETCH_BATCH_SIZE at a time, each batch within its own read transaction.
+ * If the connection has a long-lived read transaction, it's used instead (so the cache matches the UI's snapshot).
+ *
+ * This method is also used by extension connections (e.g. views) to prefetch their rows.
+**/
+- (void)prefetchObjectsWithKeysBlock:(NSArray<YapCollectionKey *> * (^)(YapDatabaseReadTransaction *transaction))keysBlock
+                     completionQueue:(dispatch_queue_t)completionQueue
+                     completionBlock:(dispatch_block_t)completionBlock
 {
-	__block YapDatabasePolicy policy = YapDatabasePolicyContainment;
+	__block NSArray<YapCollectionKey *> *collectionKeys = nil;
+	__block NSUInteger offset = 0;
+	__block dispatch_block_t batchBlock = nil;
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	dispatch_block_t finish = ^{
 		
-		policy = objectPolicy;
+		batchBlock = nil; // break retain cycle
 		
-	#pragma clang diagnostic pop
+		if (completionBlock) {
+			dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
+		}
 	};
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
-	
-	return policy;
-}
-
-- (void)setObjectPolicy:(YapDatabasePolicy)newObjectPolicy
-{
-	dispatch_block_t block = ^{
+	batchBlock = ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		// sanity check
-		switch (newObjectPolicy)
+		// Stop early if a foreground transaction is waiting for the queue.
+		
+		if (atomic_load_explicit(&pendingTransactionCount, memory_order_relaxed) > 0)
 		{
-			case YapDatabasePolicyContainment :
-			case YapDatabasePolicyShare       :
-			case YapDatabasePolicyCopy        : objectPolicy = newObjectPolicy; break;
-			default                           : objectPolicy = YapDatabasePolicyContainment;
+			finish();
+			return;
+		}
+		
+		YapDatabaseReadTransaction *transaction = longLivedReadTransaction;
+		if (transaction == nil)
+		{
+			transaction = [self newReadTransaction];
+			[self preReadTransaction:transaction];
+		}
+		
+		if (collectionKeys == nil)
+		{
+			collectionKeys = keysBlock(transaction) ?: @[];
+		}
+		
+		NSUInteger end = MIN(offset + PREFETCH_BATCH_SIZE, collectionKeys.count);
+		
+		while (offset < end)
+		{
+			YapCollectionKey *ck = collectionKeys[offset];
+			offset++;
+			
+			if (![objectCache containsKey:ck] || ![metadataCache containsKey:ck])
+			{
+				id __unused object = nil;
+				id __unused metadata = nil;
+				[transaction getObject:&object metadata:&metadata forKey:ck.key inCollection:ck.collection];
+			}
+			
+			if (atomic_load_explicit(&pendingTransactionCount, memory_order_relaxed) > 0) break;
+		}
+		
+		if (transaction != longLivedReadTransaction)
+		{
+			[self postReadTransaction:transaction];
 		}
 		
+		if (offset < collectionKeys.count)
+			[self asyncPrefetchBatch:batchBlock];
+		else
+			finish();
+		
 	#pragma clang diagnostic pop
-	};
+	}};
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_async(connectionQueue, block);
+	[self asyncPrefetchBatch:batchBlock];
 }
 
-- (YapDatabasePolicy)metadataPolicy
+- (void)asyncPrefetchBatch:(dispatch_block_t)batchBlock
 {
-	__block YapDatabasePolicy policy = YapDatabasePolicyContainment;
+	dispatch_block_t block = dispatch_block_create_with_qos_class(DISPATCH_BLOCK_ENFORCE_QOS_CLASS,
+	                                                              QOS_CLASS_UTILITY, 0, batchBlock);
+	dispatch_async(connectionQueue, block);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Storage
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (YapDatabaseStorageReport *)storageReport
+{
+	__block YapDatabaseStorageReport *report = nil;
 	
-	dispatch_block_t block = ^{
+	[self readWithBlock:^(YapDatabaseReadTransaction __unused *transaction) {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		policy = metadataPolicy;
+		YapDatabaseStorageReportBuilder *builder =
+		  [[YapDatabaseStorageReportBuilder alloc] initWithWALPath:database.databasePath_wal
+		                                            extensionNames:[registeredExtensions allKeys]];
+		
+		while (![builder stepWithDatabase:db]) { }
+		
+		report = [builder report];
 		
 	#pragma clang diagnostic pop
-	};
-	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	}];
 	
-	return policy;
+	return report;
 }
 
-- (void)setMetadataPolicy:(YapDatabasePolicy)newMetadataPolicy
+- (NSProgress *)asyncStorageReportWithCompletionQueue:(dispatch_queue_t)completionQueue
+                                      completionBlock:(void (^)(YapDatabaseStorageReport *report))completionBlock
 {
-	dispatch_block_t block = ^{
+	NSParameterAssert(completionBlock != nil);
+	
+	if (completionQueue == NULL)
+		completionQueue = dispatch_get_main_queue();
+	
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:0];
+	
+	__block YapDatabaseStorageReportBuilder *builder = nil;
+	__block uint64_t builderSnapshot = 0;
+	__block dispatch_block_t batchBlock = nil;
+	
+	void (^finish)(YapDatabaseStorageReport *) = ^(YapDatabaseStorageReport *report){
+		
+		batchBlock = nil; // break retain cycle
+		
+		dispatch_async(completionQueue, ^{ @autoreleasepool {
+			completionBlock(report);
+		}});
+	};
+	
+	batchBlock = ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		// sanity check
-		switch (newMetadataPolicy)
+		if (progress.cancelled)
 		{
-			case YapDatabasePolicyContainment :
-			case YapDatabasePolicyShare       :
-			case YapDatabasePolicyCopy        : metadataPolicy = newMetadataPolicy; break;
-			default                           : metadataPolicy = YapDatabasePolicyContainment;
+			finish(nil);
+			return;
 		}
 		
+		YapDatabaseReadTransaction *transaction = longLivedReadTransaction;
+		if (transaction == nil)
+		{
+			transaction = [self newReadTransaction];
+			[self preReadTransaction:transaction];
+		}
+		
+		if (builder == nil)
+		{
+			builder = [[YapDatabaseStorageReportBuilder alloc] initWithWALPath:database.databasePath_wal
+			                                                    extensionNames:[registeredExtensions allKeys]];
+			builderSnapshot = snapshot;
+		}
+		else if (snapshot != builderSnapshot)
+		{
+			// The database was modified since the first batch
+			builder.consistent = NO;
+		}
+		
+		// Step until the batch has used up its time slice,
+		// or until a foreground transaction is waiting for the queue.
+		
+		NSTimeInterval deadline = [NSDate timeIntervalSinceReferenceDate] + STORAGE_REPORT_BATCH_DURATION;
+		BOOL done = NO;
+		
+		do {
+			done = [builder stepWithDatabase:db];
+			
+		} while (!done
+		      && ([NSDate timeIntervalSinceReferenceDate] < deadline)
+		      && (atomic_load_explicit(&pendingTransactionCount, memory_order_relaxed) == 0));
+		
+		if (transaction != longLivedReadTransaction)
+		{
+			[self postReadTransaction:transaction];
+		}
+		
+		progress.totalUnitCount = builder.totalUnitCount;
+		progress.completedUnitCount = builder.completedUnitCount;
+		
+		if (done)
+			finish([builder report]);
+		else
+			[self asyncPrefetchBatch:batchBlock];
+		
 	#pragma clang diagnostic pop
-	};
+	}};
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_async(connectionQueue, block);
+	[self asyncPrefetchBatch:batchBlock];
+	return progress;
 }
 
-- (uint64_t)snapshot
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Properties
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@synthesize database = database;
+@synthesize name = _name;
+
+@dynamic objectCacheEnabled;
+@dynamic objectCacheLimit;
+
+@dynamic metadataCacheEnabled;
+@dynamic metadataCacheLimit;
+
+@dynamic objectCacheCostLimit;
+@dynamic metadataCacheCostLimit;
+@dynamic objectCacheCostBlock;
+@dynamic metadataCacheCostBlock;
+@dynamic objectCacheAdmissionPolicy;
+@dynamic metadataCacheAdmissionPolicy;
+
+@dynamic objectPolicy;
+@dynamic metadataPolicy;
+
+@dynamic pageCacheSize;
+@dynamic pageCacheMaximumSize;
+@dynamic pageCacheSpillEnabled;
+
+@synthesize enumerationWindowSize = _mustUseAtomicProperty_enumerationWindowSize;
+@synthesize detachesLongLivedReadTransactions = _mustUseAtomicProperty_detachesLongLivedReadTransactions;
+@synthesize changesetBacklogFlushThreshold = _mustUseAtomicProperty_changesetBacklogFlushThreshold;
+@synthesize longLivedReadTransactionIdleTimeout = _mustUseAtomicProperty_longLivedReadTransactionIdleTimeout;
+@synthesize writePriority = _mustUseAtomicProperty_writePriority;
+@synthesize coalescesAsyncReads = _mustUseAtomicProperty_coalescesAsyncReads;
+
+#if YapDatabaseEnforcePermittedTransactions
+@synthesize permittedTransactions = _mustUseAtomicProperty_permittedTransactions;
+#endif
+
+#if TARGET_OS_IOS || TARGET_OS_TV
+@synthesize autoFlushMemoryFlags;
+#endif
+
+@dynamic snapshot;
+@dynamic pendingTransactionCount;
+@dynamic averageTransactionDuration;
+
+- (BOOL)objectCacheEnabled
 {
-	__block uint64_t result = 0;
+	__block BOOL result = NO;
 	
 	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
+	#pragma clang diagnostic push // silence warnings: synchronous access
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		result = snapshot;
+		result = (objectCache != nil);
 		
 	#pragma clang diagnostic pop
 	};
@@ -920,81 +1376,126 @@ static int connectionBusyHandler(void *ptr, int count)
 	return result;
 }
 
-- (uint64_t)pendingTransactionCount
-{
-	uint64_t result = atomic_load_explicit(&pendingTransactionCount, memory_order_relaxed);
-	return result;
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Utilities
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (void)initializeObjectCache
+- (void)setObjectCacheEnabled:(BOOL)flag
 {
-	objectCache = [[YapCache alloc] initWithCountLimit:objectCacheLimit
-	                                      keyCallbacks:[YapCollectionKey keyCallbacks]];
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (flag) // Enabled
+		{
+			if (objectCache == nil)
+			{
+				[self initializeObjectCache];
+			}
+		}
+		else // Disabled
+		{
+			objectCache = nil;
+		}
+		
+		keyCache.countLimit = [self calculateKeyCacheLimit];
+		
+	#pragma clang diagnostic pop
+	};
 	
-	objectCache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (void)initializeMetadataCache
+- (NSUInteger)objectCacheLimit
 {
-	metadataCache = [[YapCache alloc] initWithCountLimit:metadataCacheLimit
-	                                        keyCallbacks:[YapCollectionKey keyCallbacks]];
+	__block NSUInteger result = 0;
 	
-	metadataCache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = objectCacheLimit;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (NSUInteger)calculateKeyCacheLimit
+- (void)setObjectCacheLimit:(NSUInteger)newObjectCacheLimit
 {
-	NSUInteger keyCacheLimit = MIN_KEY_CACHE_LIMIT;
-	
-	if (keyCacheLimit != UNLIMITED_CACHE_LIMIT)
-	{
-		if (objectCache)
-		{
-			if (objectCacheLimit == UNLIMITED_CACHE_LIMIT)
-				keyCacheLimit = UNLIMITED_CACHE_LIMIT;
-			else
-				keyCacheLimit = MAX(keyCacheLimit, objectCacheLimit);
-		}
-	}
-	
-	if (keyCacheLimit != UNLIMITED_CACHE_LIMIT)
-	{
-		if (metadataCache)
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (objectCacheLimit != newObjectCacheLimit)
 		{
-			if (metadataCacheLimit == UNLIMITED_CACHE_LIMIT)
-				keyCacheLimit = UNLIMITED_CACHE_LIMIT;
+			objectCacheLimit = newObjectCacheLimit;
+			
+			if (objectCache == nil)
+			{
+				// Limit changed, but objectCache is still disabled
+			}
 			else
-				keyCacheLimit = MAX(keyCacheLimit, metadataCacheLimit);
+			{
+				objectCache.countLimit = objectCacheLimit;
+				keyCache.countLimit = [self calculateKeyCacheLimit];
+			}
 		}
-	}
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return keyCacheLimit;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (YapDatabaseConnectionConfig *)copyConfig
+- (BOOL)metadataCacheEnabled
 {
-	YapDatabaseConnectionConfig *config = [[YapDatabaseConnectionConfig alloc] init];
+	__block BOOL result = NO;
 	
 	dispatch_block_t block = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		config.objectCacheEnabled = (objectCache != nil);
-		config.objectCacheLimit = objectCacheLimit;
+		result = (metadataCache != nil);
 		
-		config.metadataCacheEnabled = (metadataCache != nil);
-		config.metadataCacheLimit = metadataCacheLimit;
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)setMetadataCacheEnabled:(BOOL)flag
+{
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		config.objectPolicy = objectPolicy;
-		config.metadataPolicy = metadataPolicy;
+		if (flag) // Enabled
+		{
+			if (metadataCache == nil)
+			{
+				[self initializeMetadataCache];
+			}
+		}
+		else // Disabled
+		{
+			metadataCache = nil;
+		}
 		
-	#if TARGET_OS_IOS || TARGET_OS_TV
-		config.autoFlushMemoryFlags = self.autoFlushMemoryFlags;
-	#endif
+		keyCache.countLimit = [self calculateKeyCacheLimit];
 		
 	#pragma clang diagnostic pop
 	};
@@ -1002,435 +1503,706 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (dispatch_get_specific(IsOnConnectionQueueKey))
 		block();
 	else
-		dispatch_sync(connectionQueue, block);
-	
-	return config;
+		dispatch_async(connectionQueue, block);
 }
 
-- (void)applyConfig:(YapDatabaseConnectionConfig *)config
+- (NSUInteger)metadataCacheLimit
 {
-	self.objectCacheEnabled = config.objectCacheEnabled;
-	self.objectCacheLimit = config.objectCacheLimit;
+	__block NSUInteger result = 0;
 	
-	self.metadataCacheEnabled = config.metadataCacheEnabled;
-	self.metadataCacheLimit = config.metadataCacheLimit;
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = metadataCacheLimit;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	self.objectPolicy = config.objectPolicy;
-	self.metadataPolicy = config.metadataPolicy;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
 	
-#if TARGET_OS_IOS || TARGET_OS_TV
-	self.autoFlushMemoryFlags = config.autoFlushMemoryFlags;
-#endif
+	return result;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Statements
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (sqlite3_stmt *)beginTransactionStatement
+- (void)setMetadataCacheLimit:(NSUInteger)newMetadataCacheLimit
 {
-	sqlite3_stmt **statement = &beginTransactionStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "BEGIN TRANSACTION;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
+		if (metadataCacheLimit != newMetadataCacheLimit)
 		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			metadataCacheLimit = newMetadataCacheLimit;
+			
+			if (metadataCache == nil)
+			{
+				// Limit changed but metadataCache still disabled
+			}
+			else
+			{
+				metadataCache.countLimit = metadataCacheLimit;
+				keyCache.countLimit = [self calculateKeyCacheLimit];
+			}
 		}
-	}
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)beginImmediateTransactionStatement
+- (NSUInteger)objectCacheCostLimit
 {
-    sqlite3_stmt **statement = &beginImmediateTransactionStatement;
-    if (*statement == NULL)
-    {
-        const char *stmt = "BEGIN IMMEDIATE TRANSACTION;";
-        int stmtLen = (int)strlen(stmt);
-        
-        int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-        if (status != SQLITE_OK)
-        {
-            YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-        }
-    }
-    
-    return *statement;
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = objectCacheCostLimit;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)commitTransactionStatement
+- (void)setObjectCacheCostLimit:(NSUInteger)newValue
 {
-	sqlite3_stmt **statement = &commitTransactionStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "COMMIT TRANSACTION;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		objectCacheCostLimit = newValue;
+		
+		objectCache.costLimit = objectCacheCostLimit;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)rollbackTransactionStatement
+- (NSUInteger)metadataCacheCostLimit
 {
-	sqlite3_stmt **statement = &rollbackTransactionStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "ROLLBACK TRANSACTION;";
-		int stmtLen = (int)strlen(stmt);
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = metadataCacheCostLimit;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)yapGetDataForKeyStatement
+- (void)setMetadataCacheCostLimit:(NSUInteger)newValue
 {
-	sqlite3_stmt **statement = &yapGetDataForKeyStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"data\" FROM \"yap2\" WHERE \"extension\" = ? AND \"key\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		metadataCacheCostLimit = newValue;
+		
+		metadataCache.costLimit = metadataCacheCostLimit;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)yapSetDataForKeyStatement
+- (YapDatabaseCacheCostBlock)objectCacheCostBlock
 {
-	sqlite3_stmt **statement = &yapSetDataForKeyStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\") VALUES (?, ?, ?);";
-		int stmtLen = (int)strlen(stmt);
+	__block YapDatabaseCacheCostBlock result = nil;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = objectCacheCostBlock;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)yapRemoveForKeyStatement
+- (void)setObjectCacheCostBlock:(YapDatabaseCacheCostBlock)newValue
 {
-	sqlite3_stmt **statement = &yapRemoveForKeyStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "DELETE FROM \"yap2\" WHERE \"extension\" = ? AND \"key\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		objectCacheCostBlock = [newValue copy];
+		
+		objectCache.costBlock = [self cacheCostBlockWithBlock:objectCacheCostBlock];
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)yapRemoveExtensionStatement
+- (YapDatabaseCacheCostBlock)metadataCacheCostBlock
 {
-	sqlite3_stmt **statement = &yapRemoveExtensionStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "DELETE FROM \"yap2\" WHERE \"extension\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block YapDatabaseCacheCostBlock result = nil;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = metadataCacheCostBlock;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)getCollectionCountStatement
+- (void)setMetadataCacheCostBlock:(YapDatabaseCacheCostBlock)newValue
 {
-	sqlite3_stmt **statement = &getCollectionCountStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT COUNT(DISTINCT collection) AS NumberOfRows FROM \"database2\";";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		metadataCacheCostBlock = [newValue copy];
+		
+		metadataCache.costBlock = [self cacheCostBlockWithBlock:metadataCacheCostBlock];
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)getKeyCountForCollectionStatement
+- (YapCacheAdmissionPolicy)objectCacheAdmissionPolicy
 {
-	sqlite3_stmt **statement = &getKeyCountForCollectionStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT COUNT(*) AS NumberOfRows FROM \"database2\" WHERE \"collection\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block YapCacheAdmissionPolicy result = YapCacheAdmissionPolicyLRU;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = objectCacheAdmissionPolicy;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)getKeyCountForAllStatement
+- (void)setObjectCacheAdmissionPolicy:(YapCacheAdmissionPolicy)newValue
 {
-	sqlite3_stmt **statement = &getKeyCountForAllStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT COUNT(*) AS NumberOfRows FROM \"database2\";";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		objectCacheAdmissionPolicy = newValue;
+		
+		objectCache.admissionPolicy = objectCacheAdmissionPolicy;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)getCountForRowidStatement
+- (YapCacheAdmissionPolicy)metadataCacheAdmissionPolicy
 {
-	sqlite3_stmt **statement = &getCountForRowidStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT COUNT(*) AS NumberOfRows FROM \"database2\" WHERE \"rowid\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block YapCacheAdmissionPolicy result = YapCacheAdmissionPolicyLRU;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = metadataCacheAdmissionPolicy;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)getRowidForKeyStatement
+- (void)setMetadataCacheAdmissionPolicy:(YapCacheAdmissionPolicy)newValue
 {
-	sqlite3_stmt **statement = &getRowidForKeyStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"rowid\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		metadataCacheAdmissionPolicy = newValue;
+		
+		metadataCache.admissionPolicy = metadataCacheAdmissionPolicy;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)getKeyForRowidStatement
+- (NSUInteger)pageCacheSize
 {
-	sqlite3_stmt **statement = &getKeyForRowidStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"collection\", \"key\" FROM \"database2\" WHERE \"rowid\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = pageCacheSize;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)getDataForRowidStatement
+- (void)setPageCacheSize:(NSUInteger)newValue
 {
-	sqlite3_stmt **statement = &getDataForRowidStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"data\" FROM \"database2\" WHERE \"rowid\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		pageCacheSize = newValue;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)getMetadataForRowidStatement
+- (NSUInteger)pageCacheMaximumSize
 {
-	sqlite3_stmt **statement = &getMetadataForRowidStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"metadata\" FROM \"database2\" WHERE \"rowid\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = pageCacheMaximumSize;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)getAllForRowidStatement
+- (void)setPageCacheMaximumSize:(NSUInteger)newValue
 {
-	sqlite3_stmt **statement = &getAllForRowidStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"data\", \"metadata\" FROM \"database2\" WHERE \"rowid\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		pageCacheMaximumSize = newValue;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)getDataForKeyStatement
+- (BOOL)pageCacheSpillEnabled
 {
-	sqlite3_stmt **statement = &getDataForKeyStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"rowid\", \"data\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block BOOL result = YES;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		result = pageCacheSpillEnabled;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
 }
 
-- (sqlite3_stmt *)getMetadataForKeyStatement
+- (void)setPageCacheSpillEnabled:(BOOL)newValue
 {
-	sqlite3_stmt **statement = &getMetadataForKeyStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"rowid\", \"metadata\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		pageCacheSpillEnabled = newValue;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)getAllForKeyStatement
+- (YapDatabasePolicy)objectPolicy
 {
-	sqlite3_stmt **statement = &getAllForKeyStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "SELECT \"rowid\", \"data\", \"metadata\" FROM \"database2\""
-		                   " WHERE \"collection\" = ? AND \"key\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block YapDatabasePolicy policy = YapDatabasePolicyContainment;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-		}
-	}
+		policy = objectPolicy;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return policy;
 }
 
-- (sqlite3_stmt *)insertForRowidStatement
+- (void)setObjectPolicy:(YapDatabasePolicy)newObjectPolicy
 {
-	sqlite3_stmt **statement = &insertForRowidStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "INSERT INTO \"database2\""
-		                   " (\"collection\", \"key\", \"data\", \"metadata\") VALUES (?, ?, ?, ?);";
-		int stmtLen = (int)strlen(stmt);
-		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// sanity check
+		switch (newObjectPolicy)
 		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			case YapDatabasePolicyContainment :
+			case YapDatabasePolicyShare       :
+			case YapDatabasePolicyCopy        : objectPolicy = newObjectPolicy; break;
+			default                           : objectPolicy = YapDatabasePolicyContainment;
 		}
-	}
+		
+	#pragma clang diagnostic pop
+	};
 	
-	return *statement;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
 }
 
-- (sqlite3_stmt *)updateAllForRowidStatement
+- (YapDatabasePolicy)metadataPolicy
 {
-	sqlite3_stmt **statement = &updateAllForRowidStatement;
-	if (*statement == NULL)
-	{
-		const char *stmt = "UPDATE \"database2\" SET \"data\" = ?, \"metadata\" = ? WHERE \"rowid\" = ?;";
-		int stmtLen = (int)strlen(stmt);
+	__block YapDatabasePolicy policy = YapDatabasePolicyContainment;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
-		if (status != SQLITE_OK)
+		policy = metadataPolicy;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return policy;
+}
+
+- (void)setMetadataPolicy:(YapDatabasePolicy)newMetadataPolicy
+{
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// sanity check
+		switch (newMetadataPolicy)
 		{
-			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+			case YapDatabasePolicyContainment :
+			case YapDatabasePolicyShare       :
+			case YapDatabasePolicyCopy        : metadataPolicy = newMetadataPolicy; break;
+			default                           : metadataPolicy = YapDatabasePolicyContainment;
+		}
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (uint64_t)snapshot
+{
+	__block uint64_t result = 0;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = snapshot;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (uint64_t)pendingTransactionCount
+{
+	uint64_t result = atomic_load_explicit(&pendingTransactionCount, memory_order_relaxed);
+	return result;
+}
+
+- (NSTimeInterval)averageTransactionDuration
+{
+	uint64_t ticks = atomic_load_explicit(&averageTransactionTicks, memory_order_relaxed);
+	return YapDatabaseTicksToSeconds(ticks);
+}
+
+/**
+ * Updates the moving average of the transaction duration (with a weight of 1/8 for the new sample).
+ * Only invoked from within the connectionQueue, so there's only one writer at a time.
+**/
+- (void)noteTransactionTicksSince:(uint64_t)startTicks
+{
+	int64_t sample = (int64_t)(mach_absolute_time() - startTicks);
+	int64_t average = (int64_t)atomic_load_explicit(&averageTransactionTicks, memory_order_relaxed);
+	
+	if (average == 0)
+		average = sample;
+	else
+		average += (sample - average) / 8;
+	
+	atomic_store_explicit(&averageTransactionTicks, (uint64_t)average, memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Utilities
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)initializeObjectCache
+{
+	objectCache = [[YapCache alloc] initWithCountLimit:objectCacheLimit
+	                                      keyCallbacks:[YapCollectionKey keyCallbacks]];
+	
+	objectCache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
+	objectCache.costBlock = [self cacheCostBlockWithBlock:objectCacheCostBlock];
+	objectCache.costLimit = objectCacheCostLimit;
+	objectCache.admissionPolicy = objectCacheAdmissionPolicy;
+}
+
+- (void)initializeMetadataCache
+{
+	metadataCache = [[YapCache alloc] initWithCountLimit:metadataCacheLimit
+	                                        keyCallbacks:[YapCollectionKey keyCallbacks]];
+	
+	metadataCache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
+	metadataCache.costBlock = [self cacheCostBlockWithBlock:metadataCacheCostBlock];
+	metadataCache.costLimit = metadataCacheCostLimit;
+	metadataCache.admissionPolicy = metadataCacheAdmissionPolicy;
+}
+
+/**
+ * Wraps the given block so it can be used by a YapCache (whose keys are YapCollectionKey's).
+**/
+- (NSUInteger (^)(YapCollectionKey *, id))cacheCostBlockWithBlock:(YapDatabaseCacheCostBlock)costBlock
+{
+	if (costBlock == nil) return nil;
+	
+	return ^NSUInteger (YapCollectionKey *cacheKey, id object) {
+		
+		return costBlock(cacheKey.collection, cacheKey.key, object);
+	};
+}
+
+- (NSUInteger)calculateKeyCacheLimit
+{
+	NSUInteger keyCacheLimit = MIN_KEY_CACHE_LIMIT;
+	
+	if (keyCacheLimit != UNLIMITED_CACHE_LIMIT)
+	{
+		if (objectCache)
+		{
+			if (objectCacheLimit == UNLIMITED_CACHE_LIMIT)
+				keyCacheLimit = UNLIMITED_CACHE_LIMIT;
+			else
+				keyCacheLimit = MAX(keyCacheLimit, objectCacheLimit);
 		}
 	}
 	
-	return *statement;
+	if (keyCacheLimit != UNLIMITED_CACHE_LIMIT)
+	{
+		if (metadataCache)
+		{
+			if (metadataCacheLimit == UNLIMITED_CACHE_LIMIT)
+				keyCacheLimit = UNLIMITED_CACHE_LIMIT;
+			else
+				keyCacheLimit = MAX(keyCacheLimit, metadataCacheLimit);
+		}
+	}
+	
+	return keyCacheLimit;
 }
 
-- (sqlite3_stmt *)updateObjectForRowidStatement
+- (YapDatabaseConnectionConfig *)copyConfig
 {
-	sqlite3_stmt **statement = &updateObjectForRowidStatement;
+	YapDatabaseConnectionConfig *config = [[YapDatabaseConnectionConfig alloc] init];
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		config.objectCacheEnabled = (objectCache != nil);
+		config.objectCacheLimit = objectCacheLimit;
+		
+		config.metadataCacheEnabled = (metadataCache != nil);
+		config.metadataCacheLimit = metadataCacheLimit;
+		
+		config.objectCacheCostLimit = objectCacheCostLimit;
+		config.metadataCacheCostLimit = metadataCacheCostLimit;
+		
+		config.objectCacheCostBlock = objectCacheCostBlock;
+		config.metadataCacheCostBlock = metadataCacheCostBlock;
+		
+		config.objectCacheAdmissionPolicy = objectCacheAdmissionPolicy;
+		config.metadataCacheAdmissionPolicy = metadataCacheAdmissionPolicy;
+		
+		config.objectPolicy = objectPolicy;
+		config.metadataPolicy = metadataPolicy;
+		
+		config.pageCacheSize = pageCacheSize;
+		config.pageCacheMaximumSize = pageCacheMaximumSize;
+		config.pageCacheSpillEnabled = pageCacheSpillEnabled;
+		
+	#if TARGET_OS_IOS || TARGET_OS_TV
+		config.autoFlushMemoryFlags = self.autoFlushMemoryFlags;
+	#endif
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return config;
+}
+
+- (void)applyConfig:(YapDatabaseConnectionConfig *)config
+{
+	self.objectCacheEnabled = config.objectCacheEnabled;
+	self.objectCacheLimit = config.objectCacheLimit;
+	
+	self.metadataCacheEnabled = config.metadataCacheEnabled;
+	self.metadataCacheLimit = config.metadataCacheLimit;
+	
+	self.objectCacheCostLimit = config.objectCacheCostLimit;
+	self.metadataCacheCostLimit = config.metadataCacheCostLimit;
+	
+	self.objectCacheCostBlock = config.objectCacheCostBlock;
+	self.metadataCacheCostBlock = config.metadataCacheCostBlock;
+	
+	self.objectCacheAdmissionPolicy = config.objectCacheAdmissionPolicy;
+	self.metadataCacheAdmissionPolicy = config.metadataCacheAdmissionPolicy;
+	
+	self.objectPolicy = config.objectPolicy;
+	self.metadataPolicy = config.metadataPolicy;
+	
+	self.pageCacheSize = config.pageCacheSize;
+	self.pageCacheMaximumSize = config.pageCacheMaximumSize;
+	self.pageCacheSpillEnabled = config.pageCacheSpillEnabled;
+	
+#if TARGET_OS_IOS || TARGET_OS_TV
+	self.autoFlushMemoryFlags = config.autoFlushMemoryFlags;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Statements
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (sqlite3_stmt *)beginTransactionStatement
+{
+	sqlite3_stmt **statement = &beginTransactionStatement;
 	if (*statement == NULL)
 	{
-		const char *stmt = "UPDATE \"database2\" SET \"data\" = ? WHERE \"rowid\" = ?;";
+		const char *stmt = "BEGIN TRANSACTION;";
 		int stmtLen = (int)strlen(stmt);
 		
 		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
@@ -1443,12 +2215,30 @@ static int connectionBusyHandler(void *ptr, int count)
 	return *statement;
 }
 
-- (sqlite3_stmt *)updateMetadataForRowidStatement
+- (sqlite3_stmt *)beginImmediateTransactionStatement
 {
-	sqlite3_stmt **statement = &updateMetadataForRowidStatement;
+    sqlite3_stmt **statement = &beginImmediateTransactionStatement;
+    if (*statement == NULL)
+    {
+        const char *stmt = "BEGIN IMMEDIATE TRANSACTION;";
+        int stmtLen = (int)strlen(stmt);
+        
+        int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+        if (status != SQLITE_OK)
+        {
+            YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+        }
+    }
+    
+    return *statement;
+}
+
+- (sqlite3_stmt *)commitTransactionStatement
+{
+	sqlite3_stmt **statement = &commitTransactionStatement;
 	if (*statement == NULL)
 	{
-		const char *stmt = "UPDATE \"database2\" SET \"metadata\" = ? WHERE \"rowid\" = ?;";
+		const char *stmt = "COMMIT TRANSACTION;";
 		int stmtLen = (int)strlen(stmt);
 		
 		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
@@ -1461,12 +2251,12 @@ static int connectionBusyHandler(void *ptr, int count)
 	return *statement;
 }
 
-- (sqlite3_stmt *)removeForRowidStatement
+- (sqlite3_stmt *)rollbackTransactionStatement
 {
-	sqlite3_stmt **statement = &removeForRowidStatement;
+	sqlite3_stmt **statement = &rollbackTransactionStatement;
 	if (*statement == NULL)
 	{
-		const char *stmt = "DELETE FROM \"database2\" WHERE \"rowid\" = ?;";
+		const char *stmt = "ROLLBACK TRANSACTION;";
 		int stmtLen = (int)strlen(stmt);
 		
 		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
@@ -1479,12 +2269,12 @@ static int connectionBusyHandler(void *ptr, int count)
 	return *statement;
 }
 
-- (sqlite3_stmt *)removeCollectionStatement
+- (sqlite3_stmt *)yapGetDataForKeyStatement
 {
-	sqlite3_stmt **statement = &removeCollectionStatement;
+	sqlite3_stmt **statement = &yapGetDataForKeyStatement;
 	if (*statement == NULL)
 	{
-		const char *stmt = "DELETE FROM \"database2\" WHERE \"collection\" = ?;";
+		const char *stmt = "SELECT \"data\" FROM \"yap2\" WHERE \"extension\" = ? AND \"key\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
 		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
@@ -1497,12 +2287,12 @@ static int connectionBusyHandler(void *ptr, int count)
 	return *statement;
 }
 
-- (sqlite3_stmt *)removeAllStatement
+- (sqlite3_stmt *)yapSetDataForKeyStatement
 {
-	sqlite3_stmt **statement = &removeAllStatement;
+	sqlite3_stmt **statement = &yapSetDataForKeyStatement;
 	if (*statement == NULL)
 	{
-		const char *stmt = "DELETE FROM \"database2\";";
+		const char *stmt = "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\") VALUES (?, ?, ?);";
 		int stmtLen = (int)strlen(stmt);
 		
 		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
@@ -1515,4224 +2305,7955 @@ static int connectionBusyHandler(void *ptr, int count)
 	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateCollectionsStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)yapRemoveForKeyStatement
 {
-	sqlite3_stmt **statement = &enumerateCollectionsStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT DISTINCT \"collection\" FROM \"database2\";";
+	sqlite3_stmt **statement = &yapRemoveForKeyStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "DELETE FROM \"yap2\" WHERE \"extension\" = ? AND \"key\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
-	
-	if (*statement == NULL)
-	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateCollectionsForKeyStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)yapRemoveExtensionStatement
 {
-	sqlite3_stmt **statement = &enumerateCollectionsForKeyStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"collection\" FROM \"database2\" WHERE \"key\" = ?;";
+	sqlite3_stmt **statement = &yapRemoveExtensionStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "DELETE FROM \"yap2\" WHERE \"extension\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
-	
-	if (*statement == NULL)
-	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateKeysInCollectionStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)getCollectionCountStatement
 {
-	sqlite3_stmt **statement = &enumerateKeysInCollectionStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"key\" FROM \"database2\" WHERE \"collection\" = ?;";
+	sqlite3_stmt **statement = &getCollectionCountStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = database->usesCollectionIds
+		  ? "SELECT COUNT(*) AS NumberOfRows FROM \"collections\" WHERE EXISTS"
+		    " (SELECT 1 FROM \"database3\" WHERE \"database3\".\"collection_id\" = \"collections\".\"collection_id\");"
+		  : "SELECT COUNT(DISTINCT collection) AS NumberOfRows FROM \"database2\";";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
-	
-	if (*statement == NULL)
-	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateKeysInAllCollectionsStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)getKeyCountForCollectionStatement
 {
-	sqlite3_stmt **statement = &enumerateKeysInAllCollectionsStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\" FROM \"database2\";";
+	sqlite3_stmt **statement = &getKeyCountForCollectionStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = database->usesCollectionIds
+		  ? "SELECT COUNT(*) AS NumberOfRows FROM \"database3\" WHERE \"collection_id\" ="
+		    " (SELECT \"collection_id\" FROM \"collections\" WHERE \"collection\" = ?);"
+		  : "SELECT COUNT(*) AS NumberOfRows FROM \"database2\" WHERE \"collection\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
+	}
 	
+	return *statement;
+}
+
+- (sqlite3_stmt *)getKeyCountForAllStatement
+{
+	sqlite3_stmt **statement = &getKeyCountForAllStatement;
 	if (*statement == NULL)
 	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
+		const char *stmt = database->usesCollectionIds
+		  ? "SELECT COUNT(*) AS NumberOfRows FROM \"database3\";"
+		  : "SELECT COUNT(*) AS NumberOfRows FROM \"database2\";";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateKeysAndMetadataInCollectionStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)getCountForRowidStatement
 {
-	sqlite3_stmt **statement = &enumerateKeysAndMetadataInCollectionStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"key\", \"metadata\" FROM \"database2\" WHERE collection = ?;";
+	sqlite3_stmt **statement = &getCountForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = database->usesCollectionIds
+		  ? "SELECT COUNT(*) AS NumberOfRows FROM \"database3\" WHERE \"rowid\" = ?;"
+		  : "SELECT COUNT(*) AS NumberOfRows FROM \"database2\" WHERE \"rowid\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
+	}
 	
+	return *statement;
+}
+
+- (sqlite3_stmt *)getRowidForKeyStatement
+{
+	sqlite3_stmt **statement = &getRowidForKeyStatement;
 	if (*statement == NULL)
 	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
+		const char *stmt = "SELECT \"rowid\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateKeysAndMetadataInAllCollectionsStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)getKeyForRowidStatement
 {
-	sqlite3_stmt **statement = &enumerateKeysAndMetadataInAllCollectionsStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\", \"metadata\""
-		                   " FROM \"database2\" ORDER BY \"collection\" ASC;";
+	sqlite3_stmt **statement = &getKeyForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"collection\", \"key\" FROM \"database2\" WHERE \"rowid\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
+	}
 	
+	return *statement;
+}
+
+- (sqlite3_stmt *)getDataForRowidStatement
+{
+	sqlite3_stmt **statement = &getDataForRowidStatement;
 	if (*statement == NULL)
 	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
+		const char *stmt = "SELECT \"data\" FROM \"database2\" WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateKeysAndObjectsInCollectionStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)getMetadataForRowidStatement
 {
-	sqlite3_stmt **statement = &enumerateKeysAndObjectsInCollectionStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"key\", \"data\" FROM \"database2\" WHERE \"collection\" = ?;";
+	sqlite3_stmt **statement = &getMetadataForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"metadata\" FROM \"database2\" WHERE \"rowid\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
+	}
 	
+	return *statement;
+}
+
+- (sqlite3_stmt *)getAllForRowidStatement
+{
+	sqlite3_stmt **statement = &getAllForRowidStatement;
 	if (*statement == NULL)
 	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
+		const char *stmt = "SELECT \"data\", \"metadata\" FROM \"database2\" WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateKeysAndObjectsInAllCollectionsStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)getDataForKeyStatement
 {
-	sqlite3_stmt **statement = &enumerateKeysAndObjectsInAllCollectionsStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\", \"data\""
-		                   " FROM \"database2\" ORDER BY \"collection\" ASC;";
+	sqlite3_stmt **statement = &getDataForKeyStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"rowid\", \"data\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
+	}
 	
+	return *statement;
+}
+
+- (sqlite3_stmt *)getMetadataForKeyStatement
+{
+	sqlite3_stmt **statement = &getMetadataForKeyStatement;
 	if (*statement == NULL)
 	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
+		const char *stmt = "SELECT \"rowid\", \"metadata\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateRowsInCollectionStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)getAllForKeyStatement
 {
-	sqlite3_stmt **statement = &enumerateRowsInCollectionStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"key\", \"data\", \"metadata\""
-		                   " FROM \"database2\" WHERE \"collection\" = ?;";
+	sqlite3_stmt **statement = &getAllForKeyStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"rowid\", \"data\", \"metadata\" FROM \"database2\""
+		                   " WHERE \"collection\" = ? AND \"key\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
+	}
 	
+	return *statement;
+}
+
+- (sqlite3_stmt *)insertForRowidStatement
+{
+	sqlite3_stmt **statement = &insertForRowidStatement;
 	if (*statement == NULL)
 	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
+		const char *stmt = database->usesCollectionIds
+		  ? "INSERT INTO \"database3\""
+		    " (\"collection_id\", \"key\", \"data\", \"metadata\") VALUES (?, ?, ?, ?);"
+		  : "INSERT INTO \"database2\""
+		    " (\"collection\", \"key\", \"data\", \"metadata\") VALUES (?, ?, ?, ?);";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-- (sqlite3_stmt *)enumerateRowsInAllCollectionsStatement:(BOOL *)needsFinalizePtr
+- (sqlite3_stmt *)updateAllForRowidStatement
 {
-	sqlite3_stmt **statement = &enumerateRowsInAllCollectionsStatement;
-	
-	sqlite3_stmt* (^CreateStatement)(void) = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\", \"data\", \"metadata\""
-		                   " FROM \"database2\" ORDER BY \"collection\" ASC;";
+	sqlite3_stmt **statement = &updateAllForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = database->usesCollectionIds
+		  ? "UPDATE \"database3\" SET \"data\" = ?, \"metadata\" = ? WHERE \"rowid\" = ?;"
+		  : "UPDATE \"database2\" SET \"data\" = ?, \"metadata\" = ? WHERE \"rowid\" = ?;";
 		int stmtLen = (int)strlen(stmt);
 		
-		sqlite3_stmt *result = NULL;
-		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
 		if (status != SQLITE_OK)
 		{
 			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		
-		return result;
-		
-	#pragma clang diagnostic pop
-	};
-	
-	BOOL needsFinalize = NO;
-	sqlite3_stmt *result = NULL;
+	}
 	
+	return *statement;
+}
+
+- (sqlite3_stmt *)updateObjectForRowidStatement
+{
+	sqlite3_stmt **statement = &updateObjectForRowidStatement;
 	if (*statement == NULL)
 	{
-		result = *statement = CreateStatement();
-	}
-	else if (sqlite3_stmt_busy(*statement))
-	{
-		result = CreateStatement();
-		needsFinalize = YES;
-	}
-	else
-	{
-		result = *statement;
+		const char *stmt = database->usesCollectionIds
+		  ? "UPDATE \"database3\" SET \"data\" = ? WHERE \"rowid\" = ?;"
+		  : "UPDATE \"database2\" SET \"data\" = ? WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
 	
-	NSParameterAssert(needsFinalizePtr != NULL);
-	*needsFinalizePtr = needsFinalize;
-	return result;
+	return *statement;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Transactions
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-/**
- * Read-only access to the database.
- *
- * The given block can run concurrently with sibling connections,
- * regardless of whether the sibling connections are executing read-only or read-write transactions.
- *
- * The only time this method ever blocks is if another thread is currently using this connection instance
- * to execute a readBlock or readWriteBlock. Recall that you may create multiple connections for concurrent access.
- *
- * This method is synchronous.
-**/
-- (void)readWithBlock:(void (^)(YapDatabaseReadTransaction *))block
+- (sqlite3_stmt *)updateMetadataForRowidStatement
 {
-#if YapDatabaseEnforcePermittedTransactions
-	YapDatabasePermittedTransactions flags = self.permittedTransactions;
-	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	sqlite3_stmt **statement = &updateMetadataForRowidStatement;
+	if (*statement == NULL)
 	{
-		@throw [self nonMainThreadException];
+		const char *stmt = database->usesCollectionIds
+		  ? "UPDATE \"database3\" SET \"metadata\" = ? WHERE \"rowid\" = ?;"
+		  : "UPDATE \"database2\" SET \"metadata\" = ? WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
-	if (!(flags & YDB_SyncReadTransaction))
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)removeForRowidStatement
+{
+	sqlite3_stmt **statement = &removeForRowidStatement;
+	if (*statement == NULL)
 	{
-		@throw [self unpermittedTransactionException:YDB_SyncReadTransaction];
+		const char *stmt = database->usesCollectionIds
+		  ? "DELETE FROM \"database3\" WHERE \"rowid\" = ?;"
+		  : "DELETE FROM \"database2\" WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
-#endif
 	
-#ifndef NS_BLOCK_ASSERTIONS
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
+	return *statement;
+}
+
+- (sqlite3_stmt *)removeCollectionStatement
+{
+	sqlite3_stmt **statement = &removeCollectionStatement;
+	if (*statement == NULL)
 	{
-		// You are attempting to execute a transaction within a transaction.
-		// This will result in deadlock.
-		// 
-		// For more information, see the "Thread Safety" wiki page:
-		// https://github.com/yapstudios/YapDatabase/wiki/Thread-Safety#connections-queues--deadlock
+		const char *stmt = database->usesCollectionIds
+		  ? "DELETE FROM \"database3\" WHERE \"collection_id\" ="
+		    " (SELECT \"collection_id\" FROM \"collections\" WHERE \"collection\" = ?);"
+		  : "DELETE FROM \"database2\" WHERE \"collection\" = ?;";
+		int stmtLen = (int)strlen(stmt);
 		
-		@throw [self deadlockDetectionException];
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
 	}
-#endif
 	
-	atomic_fetch_add_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
-	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+	return *statement;
+}
+
+- (sqlite3_stmt *)removeAllStatement
+{
+	sqlite3_stmt **statement = &removeAllStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = database->usesCollectionIds
+		  ? "DELETE FROM \"database3\";"
+		  : "DELETE FROM \"database2\";";
+		int stmtLen = (int)strlen(stmt);
 		
-	// IMPORTANT:
-	// We are purposefully retaining self here.
-	// Here are the rules:
-	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
-	// - a YapDatabase instance cannot be deallocated if there are existing connections
-	//
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)getCollectionIdStatement
+{
+	sqlite3_stmt **statement = &getCollectionIdStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"collection_id\" FROM \"collections\" WHERE \"collection\" = ?;";
+		int stmtLen = (int)strlen(stmt);
 		
-		if (longLivedReadTransaction)
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
 		{
-			block(longLivedReadTransaction);
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-		else
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)insertCollectionStatement
+{
+	sqlite3_stmt **statement = &insertCollectionStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "INSERT INTO \"collections\" (\"collection\") VALUES (?);";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
 		{
-			YapDatabaseReadTransaction *transaction = [self newReadTransaction];
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
+- (sqlite3_stmt *)enumerateCollectionsStatement:(BOOL *)needsFinalizePtr
+{
+	sqlite3_stmt **statement = &enumerateCollectionsStatement;
+	
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-			[self preReadTransaction:transaction];
-			block(transaction);
-			[self postReadTransaction:transaction];
+		const char *stmt = database->usesCollectionIds
+		  ? "SELECT \"collection\" FROM \"collections\" WHERE EXISTS"
+		    " (SELECT 1 FROM \"database3\" WHERE \"database3\".\"collection_id\" = \"collections\".\"collection_id\");"
+		  : "SELECT DISTINCT \"collection\" FROM \"database2\";";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		return result;
 		
 	#pragma clang diagnostic pop
-	}});
-}
-
-/**
- * Read-write access to the database.
- * 
- * Only a single read-write block can execute among all sibling connections.
- * Thus this method may block if another sibling connection is currently executing a read-write block.
- * 
- * This method is synchronous.
-**/
-- (void)readWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
-{
-#if YapDatabaseEnforcePermittedTransactions
-	YapDatabasePermittedTransactions flags = self.permittedTransactions;
-	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	};
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
+	
+	if (*statement == NULL)
 	{
-		@throw [self nonMainThreadException];
+		result = *statement = CreateStatement();
 	}
-	if (!(flags & YDB_SyncReadWriteTransaction))
+	else if (sqlite3_stmt_busy(*statement))
 	{
-		@throw [self unpermittedTransactionException:YDB_SyncReadWriteTransaction];
+		result = CreateStatement();
+		needsFinalize = YES;
 	}
-#endif
-	
-#ifndef NS_BLOCK_ASSERTIONS
-	if (dispatch_get_specific(IsOnConnectionQueueKey) ||
-	    dispatch_get_specific(database->IsOnWriteQueueKey))
+	else
 	{
-		// You are attempting to execute a transaction within a transaction.
-		// This will result in deadlock.
-		//
-		// For more information, see the "Thread Safety" wiki page:
-		// https://github.com/yapstudios/YapDatabase/wiki/Thread-Safety#connections-queues--deadlock
-		
-		@throw [self deadlockDetectionException];
+		result = *statement;
 	}
-#endif
-	
-	// Order matters.
-	// First go through the serial connection queue.
-	// Then go through serial write queue for the database.
-	//
-	// Once we're inside the database writeQueue, we know that we are the only write transaction.
-	// No other transaction can possibly modify the database except us, even in other connections.
 	
-	atomic_fetch_add_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
-	dispatch_sync(connectionQueue, ^{
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+- (sqlite3_stmt *)enumerateCollectionsForKeyStatement:(BOOL *)needsFinalizePtr
+{
+	sqlite3_stmt **statement = &enumerateCollectionsForKeyStatement;
 	
-	// IMPORTANT:
-	// We are purposefully retaining self here.
-	// Here are the rules:
-	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
-	// - a YapDatabase instance cannot be deallocated if there are existing connections
-	//
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		if (longLivedReadTransaction)
+		const char *stmt = "SELECT \"collection\" FROM \"database2\" WHERE \"key\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
 		{
-			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
-			{
-				@throw [self implicitlyEndingLongLivedReadTransactionException];
-			}
-			else
-			{
-				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
-				           self, database);
-				
-				[self endLongLivedReadTransaction];
-			}
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
-			
-			YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
-			
-			[self preReadWriteTransaction:transaction];
-			block(transaction);
-			[self postReadWriteTransaction:transaction];
-			
-			if (transaction->completionBlockStack)
-			{
-				NSUInteger count = transaction->completionBlockStack.count;
-				for (NSUInteger i = 0; i < count; i++)
-				{
-					dispatch_queue_t stackItemQueue = transaction->completionQueueStack[i];
-					dispatch_block_t stackItemBlock = transaction->completionBlockStack[i];
-					
-					dispatch_async(stackItemQueue, stackItemBlock);
-				}
-			}
-			
-		}}); // End dispatch_sync(database->writeQueue)
-		
-		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		return result;
 		
 	#pragma clang diagnostic pop
-	}); // End dispatch_sync(connectionQueue)
-}
-
-/**
- * Read-only access to the database.
- *
- * The given block can run concurrently with sibling connections,
- * regardless of whether the sibling connections are executing read-only or read-write transactions.
- *
- * This method is asynchronous.
-**/
-- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
-{
-	[self asyncReadWithBlock:block completionQueue:NULL completionBlock:NULL];
-}
-
-/**
- * Read-only access to the database.
- *
- * The given block can run concurrently with sibling connections,
- * regardless of whether the sibling connections are executing read-only or read-write transactions.
- *
- * This method is asynchronous.
- * 
- * An optional completion block may be used.
- * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
-**/
-- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
-           completionBlock:(dispatch_block_t)completionBlock
-{
-	[self asyncReadWithBlock:block completionQueue:NULL completionBlock:completionBlock];
-}
-
-/**
- * Read-only access to the database.
- *
- * The given block can run concurrently with sibling connections,
- * regardless of whether the sibling connections are executing read-only or read-write transactions.
- *
- * This method is asynchronous.
- * 
- * An optional completion block may be used.
- * Additionally the dispatch_queue to invoke the completion block may also be specified.
- * If NULL, dispatch_get_main_queue() is automatically used.
-**/
-- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
-           completionQueue:(dispatch_queue_t)completionQueue
-           completionBlock:(dispatch_block_t)completionBlock
-{
-#if YapDatabaseEnforcePermittedTransactions
-	YapDatabasePermittedTransactions flags = self.permittedTransactions;
-	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	};
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
+	
+	if (*statement == NULL)
 	{
-		@throw [self nonMainThreadException];
+		result = *statement = CreateStatement();
 	}
-	if (!(flags & YDB_AsyncReadTransaction))
+	else if (sqlite3_stmt_busy(*statement))
 	{
-		@throw [self unpermittedTransactionException:YDB_AsyncReadTransaction];
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
 	}
-#endif
 	
-	atomic_fetch_add_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
-	dispatch_async(connectionQueue, ^{ @autoreleasepool {
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+- (sqlite3_stmt *)enumerateKeysInCollectionStatement:(BOOL *)needsFinalizePtr
+{
+	sqlite3_stmt **statement = &enumerateKeysInCollectionStatement;
 	
-	// IMPORTANT:
-	// We are purposefully retaining self here.
-	// Here are the rules:
-	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
-	// - a YapDatabase instance cannot be deallocated if there are existing connections
-	//
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		if (longLivedReadTransaction)
-		{
-			block(longLivedReadTransaction);
-		}
-		else
-		{
-			YapDatabaseReadTransaction *transaction = [self newReadTransaction];
-			
-			[self preReadTransaction:transaction];
-			block(transaction);
-			[self postReadTransaction:transaction];
-		}
+		const char *stmt = "SELECT \"rowid\", \"key\" FROM \"database2\" WHERE \"collection\" = ?;";
+		int stmtLen = (int)strlen(stmt);
 		
-		if (completionBlock) {
-			dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		return result;
 		
 	#pragma clang diagnostic pop
-	}});
-}
-
-/**
- * Read-write access to the database.
- * 
- * Only a single read-write block can execute among all sibling connections.
- * Thus this method may block if another sibling connection is currently executing a read-write block.
- * 
- * This method is asynchronous.
-**/
-- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
-{
-	[self asyncReadWriteWithBlock:block completionQueue:NULL completionBlock:NULL];
-}
-
-/**
- * Read-write access to the database.
- *
- * Only a single read-write block can execute among all sibling connections.
- * Thus the execution of the block may be delayted if another sibling connection
- * is currently executing a read-write block.
- *
- * This method is asynchronous.
- * 
- * An optional completion block may be used.
- * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
-**/
-- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
-                completionBlock:(dispatch_block_t)completionBlock
-{
-	[self asyncReadWriteWithBlock:block completionQueue:NULL completionBlock:completionBlock];
+	};
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
+	
+	if (*statement == NULL)
+	{
+		result = *statement = CreateStatement();
+	}
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
+	}
+	
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
 }
 
-/**
- * Read-write access to the database.
- *
- * Only a single read-write block can execute among all sibling connections.
- * Thus the execution of the block may be delayted if another sibling connection
- * is currently executing a read-write block.
- *
- * This method is asynchronous.
- * 
- * An optional completion block may be used.
- * Additionally the dispatch_queue to invoke the completion block may also be specified.
- * If NULL, dispatch_get_main_queue() is automatically used.
-**/
-- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
-                completionQueue:(dispatch_queue_t)completionQueue
-                completionBlock:(dispatch_block_t)completionBlock
+- (sqlite3_stmt *)enumerateKeysInAllCollectionsStatement:(BOOL *)needsFinalizePtr
 {
-#if YapDatabaseEnforcePermittedTransactions
-	YapDatabasePermittedTransactions flags = self.permittedTransactions;
-	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	sqlite3_stmt **statement = &enumerateKeysInAllCollectionsStatement;
+	
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\" FROM \"database2\";";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		return result;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
+	
+	if (*statement == NULL)
 	{
-		@throw [self nonMainThreadException];
+		result = *statement = CreateStatement();
 	}
-	if (!(flags & YDB_AsyncReadWriteTransaction))
+	else if (sqlite3_stmt_busy(*statement))
 	{
-		@throw [self unpermittedTransactionException:YDB_AsyncReadWriteTransaction];
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
 	}
-#endif
 	
-	// Order matters.
-	// First go through the serial connection queue.
-	// Then go through serial write queue for the database.
-	//
-	// Once we're inside the database writeQueue, we know that we are the only write transaction.
-	// No other transaction can possibly modify the database except us, even in other connections.
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+- (sqlite3_stmt *)enumerateKeysAndMetadataInCollectionStatement:(BOOL *)needsFinalizePtr
+{
+	sqlite3_stmt **statement = &enumerateKeysAndMetadataInCollectionStatement;
 	
-	atomic_fetch_add_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
-	dispatch_async(connectionQueue, ^{
-		
-	// IMPORTANT:
-	// We are purposefully retaining self here.
-	// Here are the rules:
-	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
-	// - a YapDatabase instance cannot be deallocated if there are existing connections
-	//
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		if (longLivedReadTransaction)
+		const char *stmt = "SELECT \"rowid\", \"key\", \"metadata\" FROM \"database2\" WHERE collection = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
 		{
-			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
-			{
-				@throw [self implicitlyEndingLongLivedReadTransactionException];
-			}
-			else
-			{
-				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
-				           self, database);
-				
-				[self endLongLivedReadTransaction];
-			}
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
-			
-			YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
-			
-			[self preReadWriteTransaction:transaction];
-			block(transaction);
-			[self postReadWriteTransaction:transaction];
-			
-			if (transaction->completionBlockStack)
-			{
-				NSUInteger count = transaction->completionBlockStack.count;
-				for (NSUInteger i = 0; i < count; i++)
-				{
-					dispatch_queue_t stackItemQueue = transaction->completionQueueStack[i];
-					dispatch_block_t stackItemBlock = transaction->completionBlockStack[i];
-					
-					dispatch_async(stackItemQueue, stackItemBlock);
-				}
-			}
-			
-			if (completionBlock) {
-				dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
-			}
-			
-		}}); // End dispatch_sync(database->writeQueue)
-		
-		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		return result;
 		
 	#pragma clang diagnostic pop
-	}); // End dispatch_async(connectionQueue)
+	};
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
+	
+	if (*statement == NULL)
+	{
+		result = *statement = CreateStatement();
+	}
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
+	}
+	
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
 }
 
-/**
- * It's sometimes useful to find out when all previously queued transactions on a connection have completed.
- * For example, you may have multiple methods (perhaps scattered across multiple classes) that may queue
- * asyncReadWriteTransaction's on a particular databaseConnection. And you'd like to know when all
- * the queued readWriteTransactions have completed.
- * 
- * One way to accomplish this is simply to queue an asyncReadTransaction on the databaseConnection.
- * Since all transactions on a databaseConnection are queued onto a serial dispatch queue, you'll know that once
- * your asyncReadTransaction is running, all previously scheduled transactions have completed.
- *
- * Although the above technique works, the 'flushTransactionsWithCompletionQueue:completionBlock:'
- * is a more efficient way to accomplish this task. (And a more elegant & readable way too.)
- *
- * @param completionQueue
- *   The dispatch_queue to invoke the completionBlock on.
- *   If NULL, dispatch_get_main_queue() is automatically used.
- * 
- * @param completionBlock
- *   The block to invoke once all previously scheduled transactions have completed.
-**/
-- (void)flushTransactionsWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
-                             completionBlock:(nullable dispatch_block_t)completionBlock
+- (sqlite3_stmt *)enumerateKeysAndMetadataInAllCollectionsStatement:(BOOL *)needsFinalizePtr
 {
-	if (completionBlock == NULL) return;
+	sqlite3_stmt **statement = &enumerateKeysAndMetadataInAllCollectionsStatement;
 	
-	dispatch_async(connectionQueue, ^{
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
-	});
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Transaction States
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-/**
- * Required method.
- * Returns the proper type of transaction for this connection class.
-**/
-- (YapDatabaseReadTransaction *)newReadTransaction
-{
-	return [[YapDatabaseReadTransaction alloc] initWithConnection:self isReadWriteTransaction:NO];
-}
-
-/**
- * Required method.
- * Returns the proper type of transaction for this connection class.
-**/
-- (YapDatabaseReadWriteTransaction *)newReadWriteTransaction
-{
-	return [[YapDatabaseReadWriteTransaction alloc] initWithConnection:self isReadWriteTransaction:YES];
+		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\", \"metadata\""
+		                   " FROM \"database2\" ORDER BY \"collection\" ASC;";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		return result;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
+	
+	if (*statement == NULL)
+	{
+		result = *statement = CreateStatement();
+	}
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
+	}
+	
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
 }
 
-/**
- * This method executes the state transition steps required before executing a read-only transaction block.
- * 
- * This method must be invoked from within the connectionQueue.
-**/
-- (void)preReadTransaction:(YapDatabaseReadTransaction *)transaction
+- (sqlite3_stmt *)enumerateKeysAndObjectsInCollectionStatement:(BOOL *)needsFinalizePtr
 {
-	// Pre-Read-Transaction: Step 1 of 6
-	//
-	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
-	// Initialize the 'main_file', if we haven't already.
+	sqlite3_stmt **statement = &enumerateKeysAndObjectsInCollectionStatement;
 	
-	if (main_file == NULL)
-	{
-		sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &main_file);
-		if (main_file) {
-			main_file->yap_database_connection = (__bridge void *)self;
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		const char *stmt = "SELECT \"rowid\", \"key\", \"data\" FROM \"database2\" WHERE \"collection\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
-	}
+		
+		return result;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	// Pre-Read-Transaction: Step 2 of 6
-	//
-	// Execute "BEGIN TRANSACTION" on database connection.
-	// This is actually a deferred transaction, meaning the sqlite connection won't actually
-	// acquire a shared read lock until it executes a select statement.
-	// There are alternatives to this, including a "begin immediate transaction".
-	// However, this doesn't do what we want. Instead it blocks other read-only transactions.
-	// The deferred transaction is actually what we want, as many read-only transactions only
-	// hit our in-memory caches. Thus we avoid sqlite machinery when unneeded.
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
 	
-	[transaction beginTransaction];
+	if (*statement == NULL)
+	{
+		result = *statement = CreateStatement();
+	}
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
+	}
 	
-	__block uint64_t dbSnapshot = 0;
-	__block BOOL expectsChangesets = NO;
-	__block NSArray *changesets = nil;
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+- (sqlite3_stmt *)enumerateKeysAndObjectsInAllCollectionsStatement:(BOOL *)needsFinalizePtr
+{
+	sqlite3_stmt **statement = &enumerateKeysAndObjectsInAllCollectionsStatement;
 	
-	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		// Pre-Read-Transaction: Step 3 of 6
-		//
-		// Update our connection state within the state table.
-		//
-		// First we need to mark this connection as being within a read-only transaction.
-		// We do this by marking a "yap-level" shared read lock flag.
-		//
-		// Now recall from step 1 that our "sql-level" transaction is deferred.
-		// The sql internals won't actually acquire the shared read lock until a we perform a select.
-		// If there are write transactions in progress, this is a big problem for us.
-		// Here's why:
-		//
-		// We have an in-memory snapshot via the caches.
-		// This is kept in-sync with what's on disk (in the sqlite database file).
-		// But what happens if the write transaction commits its changes before we perform our select statement?
-		// Our select statement would acquire a different snapshot than our in-memory snapshot.
-		// Thus, we look to see if there are any write transactions.
-		// If there are, then we immediately acquire the "sql-level" shared read lock.
-		
-		BOOL hasActiveWriteTransaction = NO;
-		YapDatabaseConnectionState *myState = nil;
+		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\", \"data\""
+		                   " FROM \"database2\" ORDER BY \"collection\" ASC;";
+		int stmtLen = (int)strlen(stmt);
 		
-		for (YapDatabaseConnectionState *state in database->connectionStates)
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
 		{
-			if (state->connection == self)
-			{
-				myState = state;
-				myState->activeReadTransaction = YES;
-			}
-			else if (state->activeWriteTransaction)
-			{
-				hasActiveWriteTransaction = YES;
-			}
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		NSAssert(myState != nil, @"Missing state in database->connectionStates");
-		
-		// Pre-Read-Transaction: Step 4 of 5
-		//
-		// Compare our snapshot with the database's snapshot.
-		
-		if (hasActiveWriteTransaction || longLivedReadTransaction || wal_file == NULL || enableMultiProcessSupport)
-		{
-			// If there is a write transaction in progress,
-			// then it's not safe to proceed until we acquire a "sql-level" snapshot.
-			//
-			// If this is for a longLivedReadTransaction,
-			// then we need to immediately acquire a "sql-level" snapshot.
-			//
-			// If sqlite hasn't opened the wal_file yet,
-			// then we need to invoke the sql machinery so we can get access to it.
-			// We need the wal_file in order to properly receive notifications of
-			// when sqlite acquires an "sql-level" snapshot.
-			//
-			// In case of multiple processes accessing the database,
-			// we can't know for sure so we must make this assumption.
-			//
-			// During this process we ensure that our "yap-level" snapshot of the in-memory data (caches, etc)
-			// is in sync with our "sql-level" snapshot of the database.
-			//
-			// We can check this by comparing the connection's snapshot ivar with
-			// the snapshot read from disk (via sqlite select).
-			//
-			// If the two match then our snapshots are in sync.
-			// If they don't then we need to get caught up by processing changesets.
-			
-			dbSnapshot = [self readSnapshotFromDatabase];
-			if (wal_file == NULL)
-			{
-				wal_file = yap_vfs_last_opened_wal(database->yap_vfs_shim);
-				if (wal_file) {
-					wal_file->yap_database_connection = (__bridge void *)self;
-				}
-			}
-			
-			if (snapshot < dbSnapshot)
-			{
-				// The transaction can see the sqlite commit from another transaction,
-				// and it hasn't processed the changeset(s) yet.
-				// We need to fetch them now.
-				
-				expectsChangesets = YES;
-				changesets = [database pendingAndCommittedChangesetsSince:snapshot until:dbSnapshot];
-			}
-			
-			myState->longLivedReadTransaction = (longLivedReadTransaction != nil);
-			myState->sqlLevelSharedReadLock = YES;
-			needsMarkSqlLevelSharedReadLock = NO;
-		}
-		else
-		{
-			// There is NOT a write transaction in progress.
-			// Thus we are safe to proceed with only a "yap-level" snapshot.
-			//
-			// However, we MUST ensure that our "yap-level" snapshot of the in-memory data (caches, etc)
-			// are in sync with the rest of the system.
-			//
-			// That is, our connection may have started its transaction before it was
-			// able to process a changeset from a sibling connection.
-			// If this is the case then we need to get caught up by processing the changeset(s).
-			
-			dbSnapshot = [database snapshot];
-			
-			if (snapshot < dbSnapshot)
-			{
-				// The transaction hasn't processed recent changeset(s) yet.
-				// We need to fetch them now.
-				
-				expectsChangesets = YES;
-				changesets = [database pendingAndCommittedChangesetsSince:snapshot until:dbSnapshot];
-			}
-			
-			myState->sqlLevelSharedReadLock = NO;
-			needsMarkSqlLevelSharedReadLock = YES;
-		}
-		
-		myState->lastTransactionSnapshot = dbSnapshot;
-		myState->lastTransactionTime = mach_absolute_time();
+		return result;
 		
 	#pragma clang diagnostic pop
-	}});
+	};
 	
-	// Pre-Read-Transaction: Setp 5 of 6
-	//
-	// Update our in-memory data (caches, etc) if needed.
-	// Since this can be CPU intensive, we do this outside the snapshotQueue.
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
 	
-	if (expectsChangesets)
+	if (*statement == NULL)
 	{
-		if (!changesets) // we could not retrieve changeset due to a change from another process.
-		{
-			NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
-			                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
-			
-			[self _flushMemoryWithFlags:flags];
-			snapshot = dbSnapshot;
-		}
-		else
-		{
-			isFastForwarding = YES;
-			for (NSDictionary *changeset in changesets)
-			{
-				[self noteCommittedChangeset:changeset];
-			}
-			isFastForwarding = NO;
-			
-			// The noteCommittedChangeset method (invoked above) updates our 'snapshot' variable.
-			NSAssert(snapshot == dbSnapshot,
-			         @"Invalid connection state in preReadTransaction: snapshot(%llu) != dbSnapshot(%llu): %@",
-			         snapshot, dbSnapshot, changesets);
-		}
+		result = *statement = CreateStatement();
 	}
-	
-	// Pre-Read-Transaction: Step 6 of 6
-	//
-	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
-	// Initialize the 'wal_file', if we haven't already.
-	
-	if (needsMarkSqlLevelSharedReadLock)
+	else if (sqlite3_stmt_busy(*statement))
 	{
-		if (main_file)
-			main_file->xNotifyDidRead = yapNotifyDidRead;
-		
-		if (wal_file)
-			wal_file->xNotifyDidRead = yapNotifyDidRead;
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
 	}
+	
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
 }
 
-/**
- * This method executes the state transition steps required after executing a read-only transaction block.
- *
- * This method must be invoked from within the connectionQueue.
-**/
-- (void)postReadTransaction:(YapDatabaseReadTransaction *)transaction
+- (sqlite3_stmt *)enumerateRowsInCollectionStatement:(BOOL *)needsFinalizePtr
 {
-	// Post-Read-Transaction: Step 1 of 5
-	//
-	// 1. Execute "COMMIT TRANSACTION" on database connection.
-	// If we had acquired "sql-level" shared read lock, this will release associated resources.
-	// It may also free the auto-checkpointing architecture within sqlite to sync the WAL to the database.
-	
-	[transaction commitTransaction];
-	
-	// Post-Read-Transaction: Step 2 of 5
-	//
-	// Disable sqlite VFS shim listeners for read notifications (if needed).
-	
-	if (main_file)
-		main_file->xNotifyDidRead = NULL;
-	
-	if (wal_file)
-		wal_file->xNotifyDidRead = NULL;
-	
-	
-	__block uint64_t minSnapshot = 0;
-	__block YapDatabaseConnectionState *writeStateToSignal = nil;
+	sqlite3_stmt **statement = &enumerateRowsInCollectionStatement;
 	
-	// dispatch_sync: database->snapshotQueue
-	dispatch_block_t block = ^{ @autoreleasepool {
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		// Post-Read-Transaction: Step 3 of 5
-		//
-		// Update our connection state within the state table.
-		//
-		// First we need to mark this connection as no longer being within a read-only transaction.
-		// We do this by unmarking the "yap-level" and "sql-level" shared read lock flags.
-		//
-		// While we're doing this we also check to see if we were possibly blocking a write transaction.
-		// When does a write transaction get blocked?
-		//
-		// Recall from the discussion above that we don't always acquire a "sql-level" shared read lock.
-		// Our sql transaction is deferred until our first select statement.
-		// Now if a write transaction comes along and discovers there are existing read transactions that
-		// have an in-memory metadata snapshot, but haven't acquired an "sql-level" snapshot of the actual
-		// database, it will block until these read transctions either complete,
-		// or acquire the needed "sql-level" snapshot.
-		//
-		// So if we never acquired an "sql-level" snapshot of the database, and we were the last transaction
-		// in such a state, and there's a blocked write transaction, then we need to signal it.
-		
-		minSnapshot = [database snapshot];
-		
-		BOOL wasMaybeBlockingWriteTransaction = NO;
-		NSUInteger countOtherMaybeBlockingWriteTransaction = 0;
-		YapDatabaseConnectionState *blockedWriteState = nil;
-		
-		for (YapDatabaseConnectionState *state in database->connectionStates)
-		{
-			if (state->connection == self)
-			{
-				state->activeReadTransaction = NO;
-				state->longLivedReadTransaction = NO;
-				
-				wasMaybeBlockingWriteTransaction = !state->sqlLevelSharedReadLock;
-				state->sqlLevelSharedReadLock = NO;
-			}
-			else if (state->activeReadTransaction)
-			{
-				// Active sibling connection: read-only
-				
-				minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
-				
-				if (!state->sqlLevelSharedReadLock)
-					countOtherMaybeBlockingWriteTransaction++;
-			}
-			else if (state->activeWriteTransaction)
-			{
-				// Active sibling connection: read-write
-				
-				minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
-				
-				if (state->waitingForWriteLock)
-					blockedWriteState = state;
-			}
-		}
+		const char *stmt = "SELECT \"rowid\", \"key\", \"data\", \"metadata\""
+		                   " FROM \"database2\" WHERE \"collection\" = ?;";
+		int stmtLen = (int)strlen(stmt);
 		
-		if (wasMaybeBlockingWriteTransaction && countOtherMaybeBlockingWriteTransaction == 0 && blockedWriteState)
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
 		{
-			writeStateToSignal = blockedWriteState;
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		YDBLogVerbose(@"YapDatabaseConnection(%p) completing read-only transaction.", self);
+		return result;
 		
 	#pragma clang diagnostic pop
-	}};
-	
-	// Edge case protection:
-	// This method may be called from dealloc.
-	// Which may, in turn, mean we're already in the snapshotQueue.
-	//
-	// @see Issue #437
-	// https://github.com/yapstudios/YapDatabase/issues/437
-	//
-	if (dispatch_get_specific(database->IsOnSnapshotQueueKey))
-		block();
-	else
-		dispatch_sync(database->snapshotQueue, block);
+	};
 	
-	// Post-Read-Transaction: Step 4 of 5
-	//
-	// Check to see if this connection has been holding back the checkpoint process.
-	// That is, was this connection the last active connection on an old snapshot?
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
 	
-	if (snapshot < minSnapshot)
+	if (*statement == NULL)
 	{
-		// There are commits ahead of us that need to be checkpointed.
-		// And we were the oldest active connection,
-		// so we were previously preventing the checkpoint from progressing.
-		// Thus we can now continue the checkpoint operation.
-		
-		[database asyncCheckpoint:minSnapshot];
-		
-		[registeredMemoryTables enumerateKeysAndObjectsUsingBlock:^(id __unused key, id obj, BOOL __unused *stop) {
-			
-			[(YapMemoryTable *)obj asyncCheckpoint:minSnapshot];
-		}];
+		result = *statement = CreateStatement();
 	}
-	
-	// Post-Read-Transaction: Step 5 of 5
-	//
-	// If we discovered a blocked write transaction,
-	// and it was blocked waiting on us (because we had a "yap-level" snapshot without an "sql-level" snapshot),
-	// and it's no longer blocked on any other read transaction (that have "yap-level" snapshots
-	// without "sql-level snapshots"), then signal the write semaphore so the blocked thread wakes up.
-	
-	if (writeStateToSignal)
+	else if (sqlite3_stmt_busy(*statement))
 	{
-		YDBLogVerbose(@"YapDatabaseConnection(%p) signaling blocked write on connection(%p)",
-		                                    self, writeStateToSignal->connection);
-		
-		[writeStateToSignal signalWriteLock];
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
 	}
+	
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
 }
 
-/**
- * This method executes the state transition steps required before executing a read-write transaction block.
- * 
- * This method must be invoked from within the connectionQueue.
- * This method must be invoked from within the database.writeQueue.
-**/
-- (void)preReadWriteTransaction:(YapDatabaseReadWriteTransaction *)transaction
+- (sqlite3_stmt *)enumerateRowsInAllCollectionsStatement:(BOOL *)needsFinalizePtr
 {
-	// Pre-Write-Transaction: Step 1 of 7
-	//
-	// Add IsOnConnectionQueueKey flag to writeQueue.
-	// This allows various methods that depend on the flag to operate correctly.
+	sqlite3_stmt **statement = &enumerateRowsInAllCollectionsStatement;
 	
-	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, IsOnConnectionQueueKey, NULL);
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		const char *stmt = "SELECT \"rowid\", \"collection\", \"key\", \"data\", \"metadata\""
+		                   " FROM \"database2\" ORDER BY \"collection\" ASC;";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		return result;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	// Pre-Write-Transaction: Step 2 of 7
-	//
-	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
-	// Initialize the 'main_file', if we haven't already.
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
 	
-	if (main_file == NULL)
+	if (*statement == NULL)
 	{
-		sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &main_file);
-		if (main_file) {
-			main_file->yap_database_connection = (__bridge void *)self;
-		}
+		result = *statement = CreateStatement();
 	}
-	
-	// Pre-Write-Transaction: Step 3 of 7
-	//
-	// Execute "BEGIN TRANSACTION" on database connection.
-	// This is actually a deferred transaction, meaning the sqlite connection won't actually
-	// acquire any locks until it executes something.
-	// There are various alternatives to this, including "immediate" and "exclusive" transactions.
-	// However, these don't do what we want. Instead they block other read-only transactions.
-	// The deferred transaction allows other read-only transactions and even avoids
-	// sqlite operations if no modifications are made.
-	//
-	// Remember, we are the only active write transaction for this database.
-	// No other write transactions can occur until this transaction completes.
-	// Thus no other transactions can possibly modify the database during our transaction.
-	// Therefore it doesn't matter when we acquire our "sql-level" locks for writing.
-	
-	if (enableMultiProcessSupport) {
-		// In the multiprocess case, we don't use a deferred transaction in order to avoid race conditions
-		[transaction beginImmediateTransaction];
-	} else {
-		[transaction beginTransaction];
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
 	}
 	
-	__block uint64_t dbSnapshot = 0;
-	__block BOOL expectsChangesets = NO;
-	__block NSArray *changesets = nil;
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+/**
+ * The range statements are pushed down as range scans of the true_primary_key index (collection, key).
+ * 
+ * Both bounds are always bound, so that a single statement can be used for every combination:
+ * - The lower bound (inclusive) defaults to the empty string (which sorts before every key).
+ * - The upper bound (exclusive) defaults to an empty blob (sqlite sorts every TEXT value before every BLOB value).
+ * - The limit defaults to -1 (no limit).
+**/
+- (sqlite3_stmt *)enumerateKeysInRangeStatement:(BOOL *)needsFinalizePtr reverse:(BOOL)reverse
+{
+	sqlite3_stmt **statement = reverse ? &enumerateKeysInRangeReverseStatement : &enumerateKeysInRangeStatement;
 	
-	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		// Pre-Write-Transaction: Step 4 of 7
-		//
-		// Update our connection state within the state table.
-		//
-		// We are the only write transaction for this database.
-		// It is important for read-only transactions on other connections to know there's a writer.
-		
-		YapDatabaseConnectionState *myState = nil;
+		const char *stmt = reverse
+		  ? "SELECT \"rowid\", \"key\" FROM \"database2\""
+		    " WHERE \"collection\" = ? AND \"key\" >= ? AND \"key\" < ? ORDER BY \"key\" DESC LIMIT ?;"
+		  : "SELECT \"rowid\", \"key\" FROM \"database2\""
+		    " WHERE \"collection\" = ? AND \"key\" >= ? AND \"key\" < ? ORDER BY \"key\" ASC LIMIT ?;";
+		int stmtLen = (int)strlen(stmt);
 		
-		for (YapDatabaseConnectionState *state in database->connectionStates)
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
 		{
-			if (state->connection == self)
-			{
-				myState = state;
-				myState->activeWriteTransaction = YES;
-			}
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		NSAssert(myState != nil, @"Missing state in database->connectionStates");
+		return result;
 		
-		// Pre-Write-Transaction: Step 5 of 7
-		//
-		// Compare our snapshot with the database's snapshot.
+	#pragma clang diagnostic pop
+	};
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
+	
+	if (*statement == NULL)
+	{
+		result = *statement = CreateStatement();
+	}
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
+	}
+	
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+- (sqlite3_stmt *)enumerateKeysAndObjectsInRangeStatement:(BOOL *)needsFinalizePtr reverse:(BOOL)reverse
+{
+	sqlite3_stmt **statement =
+	  reverse ? &enumerateKeysAndObjectsInRangeReverseStatement : &enumerateKeysAndObjectsInRangeStatement;
+	
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		// In multiprocess mode, the snapshot number might have been externally updated
-		if (wal_file == NULL || enableMultiProcessSupport)
-		{
-			// If sqlite hasn't opened the wal_file yet,
-			// then we need to invoke the sql machinery so we can get access to it.
-			// We need the wal_file in order to properly receive notifications of
-			// when sqlite acquires an "sql-level" snapshot.
-			//
-			// In case of multiple processes accessing the database,
-			// we can't know for sure so we must make this assumption.
-			
-			if (enableMultiProcessSupport)
-			{
-				dbSnapshot = [self readSnapshotFromDatabase];
-			}
-			else
-			{
-				(void)[self readSnapshotFromDatabase]; // create wal_file
-				dbSnapshot = [database snapshot];
-			}
-			
-			if (wal_file == NULL)
-			{
-				wal_file = yap_vfs_last_opened_wal(database->yap_vfs_shim);
-				if (wal_file) {
-					wal_file->yap_database_connection = (__bridge void *)self;
-				}
-			}
-		}
-		else
-		{
-			// We can just grab the snapshot from YapDatabase's in-memory version.
-			
-			dbSnapshot = [database snapshot];
-		}
+		const char *stmt = reverse
+		  ? "SELECT \"rowid\", \"key\", \"data\" FROM \"database2\""
+		    " WHERE \"collection\" = ? AND \"key\" >= ? AND \"key\" < ? ORDER BY \"key\" DESC LIMIT ?;"
+		  : "SELECT \"rowid\", \"key\", \"data\" FROM \"database2\""
+		    " WHERE \"collection\" = ? AND \"key\" >= ? AND \"key\" < ? ORDER BY \"key\" ASC LIMIT ?;";
+		int stmtLen = (int)strlen(stmt);
 		
-		if (snapshot < dbSnapshot)
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
 		{
-			// The transaction hasn't processed recent changeset(s) yet.
-			// We need to fetch them now.
-			
-			expectsChangesets = YES;
-			changesets = [database pendingAndCommittedChangesetsSince:snapshot until:dbSnapshot];
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
 		
-		myState->lastTransactionSnapshot = dbSnapshot;
-		myState->lastTransactionTime = mach_absolute_time();
-		needsMarkSqlLevelSharedReadLock = NO;
-		
-		YDBLogVerbose(@"YapDatabaseConnection(%p) starting read-write transaction.", self);
+		return result;
 		
 	#pragma clang diagnostic pop
-	}});
+	};
 	
-	// Pre-Write-Transaction: Step 6 of 7
-	//
-	// Update our in-memory data (caches, etc) if needed.
-	// Since this can be CPU intensive, we do this outside the snapshotQueue.
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
 	
-	if (expectsChangesets)
+	if (*statement == NULL)
 	{
-		externallyModified = (changesets == nil);
-		
-		if (!changesets) // we could not retrieve changeset due to a change from another process.
-		{
-			NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
-			                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
-			
-			[self _flushMemoryWithFlags:flags];
-			snapshot = dbSnapshot;
-		}
-		else
-		{
-			isFastForwarding = YES;
-			for (NSDictionary *changeset in changesets)
-			{
-				[self noteCommittedChangeset:changeset];
-			}
-			isFastForwarding = NO;
-			
-			// The noteCommittedChangeset method (invoked above) updates our 'snapshot' variable.
-			NSAssert(snapshot == dbSnapshot,
-			         @"Invalid connection state in preReadWriteTransaction: snapshot(%llu) != dbSnapshot(%llu)",
-			         snapshot, dbSnapshot);
-		}
+		result = *statement = CreateStatement();
+	}
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
 	}
 	else
 	{
-		externallyModified = NO;
+		result = *statement;
 	}
 	
-	// Pre-Write-Transaction: Step 7 of 7
-	//
-	// Setup write state and changeset variables
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+/**
+ * Same as enumerateRowsInCollectionStatement, but returns a single page of rows (in rowid order),
+ * starting after the given rowid. This is used by rowid ordered cursors (keyset pagination).
+**/
+- (sqlite3_stmt *)enumerateRowsInCollectionPageStatement:(BOOL *)needsFinalizePtr
+{
+	sqlite3_stmt **statement = &enumerateRowsInCollectionPageStatement;
 	
-	hasDiskChanges = NO;
+	sqlite3_stmt* (^CreateStatement)(void) = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		const char *stmt = "SELECT \"rowid\", \"key\", \"data\" FROM \"database2\""
+		                   " WHERE \"collection\" = ? AND \"rowid\" > ? ORDER BY \"rowid\" ASC LIMIT ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		sqlite3_stmt *result = NULL;
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, &result, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		return result;
+		
+	#pragma clang diagnostic pop
+	};
 	
-	if (objectChanges == nil)
-		objectChanges = [[NSMutableDictionary alloc] init];
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *result = NULL;
 	
-	if (metadataChanges == nil)
-		metadataChanges = [[NSMutableDictionary alloc] init];
+	if (*statement == NULL)
+	{
+		result = *statement = CreateStatement();
+	}
+	else if (sqlite3_stmt_busy(*statement))
+	{
+		result = CreateStatement();
+		needsFinalize = YES;
+	}
+	else
+	{
+		result = *statement;
+	}
 	
-	if (insertedKeys == nil)
-		insertedKeys = [[NSMutableSet alloc] init];
+	NSParameterAssert(needsFinalizePtr != NULL);
+	*needsFinalizePtr = needsFinalize;
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Expiration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (sqlite3_stmt *)getExpirationForRowidStatement
+{
+	sqlite3_stmt **statement = &getExpirationForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"expires\" FROM \"yap_expiration\" WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
 	
-	if (removedKeys == nil)
-		removedKeys = [[NSMutableSet alloc] init];
+	return *statement;
+}
+
+- (sqlite3_stmt *)setExpirationForRowidStatement
+{
+	sqlite3_stmt **statement = &setExpirationForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "INSERT OR REPLACE INTO \"yap_expiration\" (\"rowid\", \"expires\") VALUES (?, ?);";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
 	
-	if (removedCollections == nil)
-		removedCollections = [[NSMutableSet alloc] init];
+	return *statement;
+}
+
+- (sqlite3_stmt *)removeExpirationForRowidStatement
+{
+	sqlite3_stmt **statement = &removeExpirationForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "DELETE FROM \"yap_expiration\" WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
 	
-	if (removedRowids == nil)
-		removedRowids = [[NSMutableSet alloc] init];
+	return *statement;
+}
+
+- (sqlite3_stmt *)enumerateExpiredRowidsStatement
+{
+	sqlite3_stmt **statement = &enumerateExpiredRowidsStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"rowid\" FROM \"yap_expiration\""
+		                   " WHERE \"expires\" <= ? ORDER BY \"expires\" ASC LIMIT ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
 	
-	allKeysRemoved = NO;
+	return *statement;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Content Hashes
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (sqlite3_stmt *)getContentHashForRowidStatement
+{
+	sqlite3_stmt **statement = &getContentHashForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "SELECT \"data_hash\", \"metadata_hash\" FROM \"yap_content_hash\" WHERE \"rowid\" = ?;";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
 	
-	if (mutationStack == nil)
-		mutationStack = [[YapMutationStack_Bool alloc] init];
+	return *statement;
+}
+
+- (sqlite3_stmt *)setContentHashForRowidStatement
+{
+	sqlite3_stmt **statement = &setContentHashForRowidStatement;
+	if (*statement == NULL)
+	{
+		const char *stmt = "INSERT OR REPLACE INTO \"yap_content_hash\""
+		                   " (\"rowid\", \"data_hash\", \"metadata_hash\") VALUES (?, ?, ?);";
+		int stmtLen = (int)strlen(stmt);
+		
+		int status = sqlite3_prepare_v2(db, stmt, stmtLen+1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Collection IDs
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * This method executes the state transition steps required after executing a read-only transaction block.
- *
- * This method must be invoked from within the connectionQueue.
- * This method must be invoked from within the database.writeQueue.
+ * Only for use with the collection-id schema (YapDatabaseOptions.enableCollectionIds).
+ * 
+ * Returns the collection_id for the given collection, inserting the collection into the "collections" table if needed.
+ * Rows in the "collections" table are never deleted (outside of a rollback),
+ * so a collection_id never changes once committed, and we can safely cache the mapping in memory.
+ * 
+ * This method must be invoked from within a read-write transaction.
 **/
-- (void)postReadWriteTransaction:(YapDatabaseReadWriteTransaction *)transaction
+- (BOOL)getCollectionId:(int64_t *)collectionIdPtr forCollection:(NSString *)collection
 {
-	if (transaction->rollback)
+	if (collection == nil) collection = @"";
+	
+	NSNumber *cachedId = [collectionIds objectForKey:collection];
+	if (cachedId)
 	{
-		YDBLogVerbose(@"YapDatabaseConnection(%p) rollback read-write transaction", self);
-		
-		// Rollback-Write-Transaction: Step 1 of 3
-		//
-		// Update our connection state within the state table.
-		//
-		// We are the only write transaction for this database.
-		// It is important for read-only transactions on other connections to know we're no longer a writer.
-		
-		dispatch_sync(database->snapshotQueue, ^{
-		#pragma clang diagnostic push
-		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		if (collectionIdPtr) *collectionIdPtr = [cachedId longLongValue];
+		return YES;
+	}
+	
+	sqlite3_stmt *statement = [self getCollectionIdStatement];
+	if (statement == NULL) return NO;
+	
+	BOOL found = NO;
+	int64_t collectionId = 0;
+	
+	// SELECT "collection_id" FROM "collections" WHERE "collection" = ?;
+	
+	int const column_idx_collection_id = SQLITE_COLUMN_START;
+	int const bind_idx_collection      = SQLITE_BIND_START;
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		collectionId = sqlite3_column_int64(statement, column_idx_collection_id);
+		found = YES;
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'getCollectionIdStatement': %d %s", status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	if (!found && (status == SQLITE_DONE))
+	{
+		statement = [self insertCollectionStatement];
+		if (statement)
+		{
+			// INSERT INTO "collections" ("collection") VALUES (?);
 			
-			for (YapDatabaseConnectionState *state in database->connectionStates)
+			sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+			
+			status = sqlite3_step(statement);
+			if (status == SQLITE_DONE)
 			{
-				if (state->connection == self)
-				{
-					state->activeWriteTransaction = NO;
-					break;
-				}
+				collectionId = sqlite3_last_insert_rowid(db);
+				found = YES;
+			}
+			else
+			{
+				YDBLogError(@"Error executing 'insertCollectionStatement': %d %s", status, sqlite3_errmsg(db));
 			}
 			
-		#pragma clang diagnostic pop
-		});
-		
-		// Rollback-Write-Transaction: Step 2 of 3
-		//
-		// Rollback sqlite database transaction.
-		
-		[transaction rollbackTransaction];
-		
-		// Rollback-Write-Transaction: Step 3 of 3
-		//
-		// Reset any in-memory variables which may be out-of-sync with the database.
-		
-		[objectCache removeAllObjects];
-		[metadataCache removeAllObjects];
-		
+			sqlite3_clear_bindings(statement);
+			sqlite3_reset(statement);
+		}
 	}
-	else // if (!transaction->rollback)
+	
+	FreeYapDatabaseString(&_collection);
+	
+	if (found)
 	{
-		// Post-Write-Transaction: Step 1 of 11
-		//
-		// Run any pre-commit operations.
-		// This allows extensions to to perform any cleanup before the changeset is requested.
-		
-		[transaction preCommitReadWriteTransaction];
-		
-		// Post-Write-Transaction: Step 2 of 11
-		//
-		// Fetch changesets.
-		// Then update the snapshot in the 'yap' database (if any changes were made).
-		// We use 'yap' database and snapshot value to check for a race condition.
-		//
-		// The "internal" changeset gets sent directly to sibling database connections.
-		// The "external" changeset gets plugged into the YapDatabaseModifiedNotification as the userInfo dict.
-		
-		NSNotification *notification = nil;
-		
-		NSMutableDictionary *changeset = nil;
-		NSMutableDictionary *userInfo = nil;
+		if (collectionIds == nil)
+			collectionIds = [[NSMutableDictionary alloc] init];
 		
-		[self getInternalChangeset:&changeset externalChangeset:&userInfo];
-		if (changeset || userInfo || hasDiskChanges)
-		{
-			// If hasDiskChanges is YES, then the database file was modified.
-			// In this case, we're sure to write the incremented snapshot number to the database.
-			//
-			// If hasDiskChanges is NO, then the database file was not modified.
-			// However, something was "touched" or an in-memory extension was changed.
-			
-			if (hasDiskChanges || enableMultiProcessSupport)
-				snapshot = [self incrementSnapshotInDatabase];
-			else
-				snapshot++;
-			
-			if (changeset == nil)
-				changeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+		[collectionIds setObject:@(collectionId) forKey:collection];
+	}
+	
+	if (collectionIdPtr) *collectionIdPtr = collectionId;
+	return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Transactions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Read-only access to the database.
+ *
+ * The given block can run concurrently with sibling connections,
+ * regardless of whether the sibling connections are executing read-only or read-write transactions.
+ *
+ * The only time this method ever blocks is if another thread is currently using this connection instance
+ * to execute a readBlock or readWriteBlock. Recall that you may create multiple connections for concurrent access.
+ *
+ * This method is synchronous.
+**/
+- (void)readWithBlock:(void (^)(YapDatabaseReadTransaction *))block
+{
+#if YapDatabaseEnforcePermittedTransactions
+	YapDatabasePermittedTransactions flags = self.permittedTransactions;
+	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	{
+		@throw [self nonMainThreadException];
+	}
+	if (!(flags & YDB_SyncReadTransaction))
+	{
+		@throw [self unpermittedTransactionException:YDB_SyncReadTransaction];
+	}
+#endif
+	
+#ifndef NS_BLOCK_ASSERTIONS
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+	{
+		// You are attempting to execute a transaction within a transaction.
+		// This will result in deadlock.
+		// 
+		// For more information, see the "Thread Safety" wiki page:
+		// https://github.com/yapstudios/YapDatabase/wiki/Thread-Safety#connections-queues--deadlock
+		
+		@throw [self deadlockDetectionException];
+	}
+#endif
+	
+	uint64_t queueWaitTicks = mach_absolute_time();
+	YapDatabaseQueueWaitEvent *queueWaitEvent = [self newQueueWaitEventForHolder:connectionQueueHolder];
+	
+	[self willQueueTransaction];
+	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+		
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t transactionStartTicks = mach_absolute_time();
+		[self didEnterConnectionQueueSinceTicks:queueWaitTicks readWrite:NO event:queueWaitEvent];
+		
+		if (longLivedReadTransaction && [self attachLongLivedReadTransaction])
+		{
+			[self beginWorkloadTraceWithReadWrite:NO];
+			YDBSignpostID signpost = YDBSignpostBegin("Read Transaction", "connection: %{public}@", _name);
+			[self beginReadTransactionMetrics];
 			
-			if (userInfo == nil)
-				userInfo = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
+			block(longLivedReadTransaction);
 			
-			[changeset setObject:@(snapshot) forKey:YapDatabaseSnapshotKey];
-			[userInfo setObject:@(snapshot) forKey:YapDatabaseSnapshotKey];
+			[self endReadTransactionMetrics];
+			YDBSignpostEnd(signpost, "Read Transaction");
+			[self endWorkloadTraceWithRollback:NO];
 			
-			[userInfo setObject:self forKey:YapDatabaseConnectionKey];
+			[self redetachLongLivedReadTransaction];
+			longLivedReadTransactionUseTicks = mach_absolute_time();
+		}
+		else
+		{
+			YapDatabaseReadTransaction *transaction = [self dequeueReadTransaction];
 		
-			if (externallyModified)
-				[changeset setObject:@(externallyModified) forKey:YapDatabaseModifiedExternallyKey];
-			
-			if (transaction->customObjectForNotification)
-				[userInfo setObject:transaction->customObjectForNotification forKey:YapDatabaseCustomKey];
-			
-			notification = [NSNotification notificationWithName:YapDatabaseModifiedNotification
-			                                             object:database
-			                                           userInfo:userInfo];
+			[self preReadTransaction:transaction];
+			[self beginReadTransactionMetrics];
+			block(transaction);
+			[self endReadTransactionMetrics];
+			[self postReadTransaction:transaction];
 			
-			[changeset setObject:notification forKey:YapDatabaseNotificationKey];
+			[self recycleReadTransaction:transaction];
 		}
 		
-		// Post-Write-Transaction: Step 3 of 11
-		//
-		// Auto-drop tables from previous extensions that aren't being used anymore.
+		[self willExitConnectionQueue];
+		[self noteTransactionTicksSince:transactionStartTicks];
+		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Read-write access to the database.
+ * 
+ * Only a single read-write block can execute among all sibling connections.
+ * Thus this method may block if another sibling connection is currently executing a read-write block.
+ * 
+ * This method is synchronous.
+**/
+- (void)readWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+{
+	[self readWriteWithBlock:block durability:YapDatabaseDurabilityFull];
+}
+
+/**
+ * Read-write access to the database, with the given durability.
+ * 
+ * This method is synchronous.
+**/
+- (void)readWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+                durability:(YapDatabaseDurability)durability
+{
+#if YapDatabaseEnforcePermittedTransactions
+	YapDatabasePermittedTransactions flags = self.permittedTransactions;
+	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	{
+		@throw [self nonMainThreadException];
+	}
+	if (!(flags & YDB_SyncReadWriteTransaction))
+	{
+		@throw [self unpermittedTransactionException:YDB_SyncReadWriteTransaction];
+	}
+#endif
+	
+#ifndef NS_BLOCK_ASSERTIONS
+	if (dispatch_get_specific(IsOnConnectionQueueKey) ||
+	    dispatch_get_specific(database->IsOnWriteQueueKey))
+	{
+		// You are attempting to execute a transaction within a transaction.
+		// This will result in deadlock.
 		//
-		// Note the timing of when this happens:
-		// - Only once
-		// - At the end of a readwrite transaction that has made modifications to the database
-		// - Only if the modifications weren't dedicated to registering/unregistring an extension
+		// For more information, see the "Thread Safety" wiki page:
+		// https://github.com/yapstudios/YapDatabase/wiki/Thread-Safety#connections-queues--deadlock
 		
-		BOOL clearPreviouslyRegisteredExtensionNames = NO;
+		@throw [self deadlockDetectionException];
+	}
+#endif
+	
+	// Order matters.
+	// First go through the serial connection queue.
+	// Then go through serial write queue for the database.
+	//
+	// Once we're inside the database writeQueue, we know that we are the only write transaction.
+	// No other transaction can possibly modify the database except us, even in other connections.
+	
+	YapDatabaseWritePriority priority = self.writePriority;
+	
+	uint64_t queueWaitTicks = mach_absolute_time();
+	YapDatabaseQueueWaitEvent *queueWaitEvent = [self newQueueWaitEventForHolder:connectionQueueHolder];
+	
+	[self willQueueTransaction];
+	dispatch_sync(connectionQueue, ^{
+	
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		if (changeset && !registeredExtensionsChanged && database->previouslyRegisteredExtensionNames)
+		uint64_t transactionStartTicks = mach_absolute_time();
+		[self didEnterConnectionQueueSinceTicks:queueWaitTicks readWrite:YES event:queueWaitEvent];
+		
+		if (longLivedReadTransaction)
 		{
-			for (NSString *prevExtensionName in database->previouslyRegisteredExtensionNames)
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
 			{
-				if ([registeredExtensions objectForKey:prevExtensionName] == nil)
-				{
-					[self _unregisterExtensionWithName:prevExtensionName transaction:transaction];
-				}
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+				           self, database);
+				
+				[self endLongLivedReadTransaction];
 			}
-			
-			clearPreviouslyRegisteredExtensionNames = YES;
 		}
 		
-		// Post-Write-Transaction: Step 4 of 11
-		//
-		// Check to see if it's safe to commit our changes.
-		//
-		// There may be read-only transactions that have acquired "yap-level" snapshots
-		// without "sql-level" snapshots. That is, these read-only transaction may have a snapshot
-		// of the in-memory metadata dictionary at the time they started, but as for the sqlite connection
-		// they only have a "BEGIN DEFERRED TRANSACTION", and haven't actually executed
-		// any "select" statements. Thus they haven't actually invoked the sqlite machinery to
-		// acquire the "sql-level" snapshot (last valid commit record in the WAL).
-		//
-		// It is our responsibility to block until all read-only transactions have either completed,
-		// or have acquired the necessary "sql-level" shared read lock.
-		//
-		// We avoid writer starvation by enforcing new read-only transactions that start after our writer
-		// started to immediately acquire "sql-level" shared read locks when they start.
-		// Thus we would only ever wait for read-only transactions that started before our
-		// read-write transaction started. And since most of the time the read-write transactions
-		// take longer than read-only transactions, we avoid any blocking in most cases.
-		
-		__block YapDatabaseConnectionState *myState = nil;
-		__block BOOL safeToCommit = NO;
+		[self preWriteQueueWithPriority:priority];
 		
-		do
-		{
-			__block BOOL waitForReadOnlyTransactions = NO;
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
 			
-			dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
-			#pragma clang diagnostic push
-			#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-				
-				for (YapDatabaseConnectionState *state in database->connectionStates)
-				{
-					if (state->connection == self)
-					{
-						myState = state;
-					}
-					else if (state->activeReadTransaction && !state->sqlLevelSharedReadLock)
-					{
-						waitForReadOnlyTransactions = YES;
-					}
-				}
-				
-				NSAssert(myState != nil, @"Missing state in database->connectionStates");
-				
-				if (waitForReadOnlyTransactions)
-				{
-					myState->waitingForWriteLock = YES;
-					[myState prepareWriteLock];
-				}
-				else
+			[self didEnterWriteQueueWithPriority:priority];
+			
+			BOOL relaxed = NO;
+			if (durability == YapDatabaseDurabilityRelaxed) {
+				relaxed = [self preRelaxedDurabilityTransaction];
+			}
+			
+			YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
+			
+			[self preReadWriteTransaction:transaction];
+			block(transaction);
+			[self postReadWriteTransaction:transaction];
+			
+			[self postDurabilityTransaction:transaction relaxed:relaxed];
+			
+			if (transaction->completionBlockStack)
+			{
+				NSUInteger count = transaction->completionBlockStack.count;
+				for (NSUInteger i = 0; i < count; i++)
 				{
-					myState->waitingForWriteLock = NO;
-					safeToCommit = YES;
+					dispatch_queue_t stackItemQueue = transaction->completionQueueStack[i];
+					dispatch_block_t stackItemBlock = transaction->completionBlockStack[i];
 					
-					// Post-Write-Transaction: Step 5 of 11
-					//
-					// Register pending changeset with database.
-					// Our commit is actually a two step process.
-					// First we execute the sqlite level commit.
-					// Second we execute the final stages of the yap level commit.
-					//
-					// This two step process means we have an edge case,
-					// where another connection could come around and begin its yap level transaction
-					// before this connection's yap level commit, but after this connection's sqlite level commit.
-					//
-					// By registering the pending changeset in advance,
-					// we provide a near seamless workaround for the edge case.
-					
-					if (changeset)
-					{
-						[database notePendingChangeset:changeset fromConnection:self];
-					}
-					
-					if (clearPreviouslyRegisteredExtensionNames)
-					{
-						// It's only safe to clear this ivar within the snapshot queue
-						database->previouslyRegisteredExtensionNames = nil;
-					}
+					dispatch_async(stackItemQueue, stackItemBlock);
 				}
-				
-			#pragma clang diagnostic pop
-			}});
-		
-			if (waitForReadOnlyTransactions)
-			{
-				// Block until a read-only transaction signals us.
-				// This will occur when the last read-only transaction (that started before our read-write
-				// transaction started) either completes or acquires an "sql-level" shared read lock.
-				//
-				// Note: Since we're using a dispatch semaphore, order doesn't matter.
-				// That is, it's fine if the read-only transaction signals our write lock before we start waiting on it.
-				// In this case we simply return immediately from the wait call.
-				
-				YDBLogVerbose(@"YapDatabaseConnection(%p) blocked waiting for write lock...", self);
-				
-				[myState waitForWriteLock];
 			}
 			
-		} while (!safeToCommit);
-	
-		// Post-Write-Transaction: Step 6 of 11
-		//
-		// Execute "COMMIT TRANSACTION" on database connection.
-		// This will write the changes to the WAL, and may invoke a checkpoint.
-		//
-		// Notice that we do this outside the context of the transactionStateQueue.
-		// We do this so we don't block read-only transactions from starting or finishing.
-		// However, this does leave us open for the possibility that a read-only transaction will
-		// get a "yap-level" snapshot of the metadata dictionary before this commit,
-		// but a "sql-level" snapshot of the sql database after this commit.
-		// This is rare but must be guarded against.
-		// The solution is pretty simple and straight-forward.
-		// When a read-only transaction starts, if there's an active write transaction,
-		// it immediately acquires an "sql-level" snapshot. It does this by invoking a select statement,
-		// which invokes the internal sqlite snapshot machinery for the transaction.
-		// So rather than using a dummy select statement that we ignore, we instead select a lastCommit number
-		// from the database. If it doesn't match what we expect, then we know we've run into the race condition,
-		// and we make the read-only transaction back out and try again.
+			[self willExitWriteQueue];
+			
+		}}); // End dispatch_sync(database->writeQueue)
 		
-		[transaction commitTransaction];
+		[self willExitConnectionQueue];
+		[self noteTransactionTicksSince:transactionStartTicks];
+		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
 		
-		__block uint64_t minSnapshot = UINT64_MAX;
+	#pragma clang diagnostic pop
+	}); // End dispatch_sync(connectionQueue)
+}
+
+/**
+ * Read-only access to the database.
+ *
+ * The given block can run concurrently with sibling connections,
+ * regardless of whether the sibling connections are executing read-only or read-write transactions.
+ *
+ * This method is asynchronous.
+**/
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+{
+	[self asyncReadWithBlock:block completionQueue:NULL completionBlock:NULL];
+}
+
+/**
+ * Read-only access to the database.
+ *
+ * The given block can run concurrently with sibling connections,
+ * regardless of whether the sibling connections are executing read-only or read-write transactions.
+ *
+ * This method is asynchronous.
+ * 
+ * An optional completion block may be used.
+ * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+**/
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionBlock:(dispatch_block_t)completionBlock
+{
+	[self asyncReadWithBlock:block completionQueue:NULL completionBlock:completionBlock];
+}
+
+/**
+ * Read-only access to the database.
+ *
+ * The given block can run concurrently with sibling connections,
+ * regardless of whether the sibling connections are executing read-only or read-write transactions.
+ *
+ * This method is asynchronous.
+ * 
+ * An optional completion block may be used.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionQueue:(dispatch_queue_t)completionQueue
+           completionBlock:(dispatch_block_t)completionBlock
+{
+#if YapDatabaseEnforcePermittedTransactions
+	YapDatabasePermittedTransactions flags = self.permittedTransactions;
+	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	{
+		@throw [self nonMainThreadException];
+	}
+	if (!(flags & YDB_AsyncReadTransaction))
+	{
+		@throw [self unpermittedTransactionException:YDB_AsyncReadTransaction];
+	}
+#endif
 	
-		dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
-		#pragma clang diagnostic push
-		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-			
-			// Post-Write-Transaction: Step 7 of 11
-			//
-			// Notify database of changes, and drop reference to set of changed keys.
+	if (self.coalescesAsyncReads)
+	{
+		[self coalesceAsyncReadWithBlock:block completionQueue:completionQueue completionBlock:completionBlock];
+		return;
+	}
+	
+	uint64_t queueWaitTicks = mach_absolute_time();
+	YapDatabaseQueueWaitEvent *queueWaitEvent = [self newQueueWaitEventForHolder:connectionQueueHolder];
+	
+	[self willQueueTransaction];
+	dispatch_async(connectionQueue, ^{ @autoreleasepool {
+	
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t transactionStartTicks = mach_absolute_time();
+		[self didEnterConnectionQueueSinceTicks:queueWaitTicks readWrite:NO event:queueWaitEvent];
+		
+		if (longLivedReadTransaction && [self attachLongLivedReadTransaction])
+		{
+			[self beginWorkloadTraceWithReadWrite:NO];
+			YDBSignpostID signpost = YDBSignpostBegin("Read Transaction", "connection: %{public}@", _name);
+			[self beginReadTransactionMetrics];
 			
-			if (changeset)
-			{
-				[database noteCommittedChangeset:changeset fromConnection:self];
-			}
+			block(longLivedReadTransaction);
 			
-			// Post-Write-Transaction: Step 8 of 11
-			//
-			// Update our connection state within the state table.
-			//
-			// We are the only write transaction for this database.
-			// It is important for read-only transactions on other connections to know we're no longer a writer.
+			[self endReadTransactionMetrics];
+			YDBSignpostEnd(signpost, "Read Transaction");
+			[self endWorkloadTraceWithRollback:NO];
 			
-			for (YapDatabaseConnectionState *state in database->connectionStates)
-			{
-				if (state->activeReadTransaction)
-				{
-					minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
-				}
-			}
+			[self redetachLongLivedReadTransaction];
+			longLivedReadTransactionUseTicks = mach_absolute_time();
+		}
+		else
+		{
+			YapDatabaseReadTransaction *transaction = [self dequeueReadTransaction];
 			
-			myState->activeWriteTransaction = NO;
-			myState->waitingForWriteLock = NO;
+			[self preReadTransaction:transaction];
+			[self beginReadTransactionMetrics];
+			block(transaction);
+			[self endReadTransactionMetrics];
+			[self postReadTransaction:transaction];
 			
-			YDBLogVerbose(@"YapDatabaseConnection(%p) completing read-write transaction.", self);
+			[self recycleReadTransaction:transaction];
+		}
+		
+		if (completionBlock) {
+			dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
+		}
+		
+		[self willExitConnectionQueue];
+		[self noteTransactionTicksSince:transactionStartTicks];
+		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Adds the read block to the open batch, if there is one.
+ * Otherwise opens a new batch, and queues it on the connectionQueue.
+ *
+ * Any other transaction queued on the connection seals the open batch (see willQueueTransaction).
+ * So a coalesced read never executes before a transaction that was queued ahead of it.
+**/
+- (void)coalesceAsyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+                   completionQueue:(dispatch_queue_t)completionQueue
+                   completionBlock:(dispatch_block_t)completionBlock
+{
+	YapDatabaseCoalescedRead *read = [[YapDatabaseCoalescedRead alloc] init];
+	read->block = block;
+	read->completionQueue = completionQueue ?: dispatch_get_main_queue();
+	read->completionBlock = completionBlock;
+	
+	NSMutableArray<YapDatabaseCoalescedRead *> *newBatch = nil;
+	
+	atomic_fetch_add_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+	
+	YAPUnfairLockLock(&coalescedReadsLock);
+	{
+		if (coalescedReads == nil)
+		{
+			coalescedReads = newBatch = [[NSMutableArray alloc] init];
+		}
+		
+		[coalescedReads addObject:read];
+	}
+	YAPUnfairLockUnlock(&coalescedReadsLock);
+	
+	if (newBatch)
+	{
+		uint64_t queueWaitTicks = mach_absolute_time();
+		YapDatabaseQueueWaitEvent *queueWaitEvent = [self newQueueWaitEventForHolder:connectionQueueHolder];
+		
+		dispatch_async(connectionQueue, ^{ @autoreleasepool {
 			
-		#pragma clang diagnostic pop
+			[self executeCoalescedReads:newBatch sinceTicks:queueWaitTicks event:queueWaitEvent];
 		}});
+	}
+}
+
+/**
+ * Executes the batch of coalesced reads, back to back, within a single read transaction.
+ * Then invokes each of their completion blocks.
+ *
+ * This method must be invoked from within the connectionQueue.
+**/
+- (void)executeCoalescedReads:(NSMutableArray<YapDatabaseCoalescedRead *> *)batch
+                   sinceTicks:(uint64_t)queueWaitTicks
+                        event:(YapDatabaseQueueWaitEvent *)queueWaitEvent
+{
+	// Close the batch (if it's still open), so no more reads can be added to it.
 	
-		if (changeset)
+	YAPUnfairLockLock(&coalescedReadsLock);
+	{
+		if (coalescedReads == batch) {
+			coalescedReads = nil;
+		}
+	}
+	YAPUnfairLockUnlock(&coalescedReadsLock);
+	
+	uint64_t transactionStartTicks = mach_absolute_time();
+	[self didEnterConnectionQueueSinceTicks:queueWaitTicks readWrite:NO event:queueWaitEvent];
+	
+	if (longLivedReadTransaction && [self attachLongLivedReadTransaction])
+	{
+		[self beginWorkloadTraceWithReadWrite:NO];
+		YDBSignpostID signpost = YDBSignpostBegin("Read Transaction", "connection: %{public}@", _name);
+		[self beginReadTransactionMetrics];
+		
+		for (YapDatabaseCoalescedRead *read in batch)
 		{
-			// Post-Write-Transaction: Step 9 of 11
-			//
-			// We added frames to the WAL.
-			// We can invoke a checkpoint if there are no other active connections.
-			
-			if (minSnapshot == UINT64_MAX)
-			{
-				[database asyncCheckpoint:snapshot];
-				
-				[registeredMemoryTables enumerateKeysAndObjectsUsingBlock:
-				    ^(id __unused key, YapMemoryTable *memoryTable, BOOL __unused *stop)
-				{
-				#pragma clang diagnostic push
-				#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-					
-					[memoryTable asyncCheckpoint:snapshot];
-					
-				#pragma clang diagnostic pop
-				}];
+			@autoreleasepool {
+				read->block(longLivedReadTransaction);
 			}
 		}
-	
-		// Post-Write-Transaction: Step 10 of 11
-		//
-		// If the WAL has gotten too big, then we perform a checkpoint right away.
-		// We purposefuly do this BEFORE posting the notification.
 		
-		if ([database aggressiveCheckpointEnabled])
+		[self endReadTransactionMetrics];
+		YDBSignpostEnd(signpost, "Read Transaction");
+		[self endWorkloadTraceWithRollback:NO];
+		
+		[self redetachLongLivedReadTransaction];
+		longLivedReadTransactionUseTicks = mach_absolute_time();
+	}
+	else
+	{
+		YapDatabaseReadTransaction *transaction = [self dequeueReadTransaction];
+		
+		[self preReadTransaction:transaction];
+		[self beginReadTransactionMetrics];
+		
+		for (YapDatabaseCoalescedRead *read in batch)
 		{
-			int totalFrameCount = 0;
-			int checkpointedFrameCount = 0;
+			@autoreleasepool {
+				read->block(transaction);
+			}
+		}
+		
+		[self endReadTransactionMetrics];
+		[self postReadTransaction:transaction];
+		
+		[self recycleReadTransaction:transaction];
+	}
+	
+	for (YapDatabaseCoalescedRead *read in batch)
+	{
+		if (read->completionBlock) {
+			dispatch_async(read->completionQueue, read->completionBlock);
+		}
+	}
+	
+	[self willExitConnectionQueue];
+	[self noteTransactionTicksSince:transactionStartTicks];
+	atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)batch.count, memory_order_relaxed);
+}
+
+/**
+ * Invoked (on any thread) right before a transaction (other than a coalesced read) is queued on the connectionQueue.
+ *
+ * Seals the open batch of coalesced reads (if any).
+ * So the reads queued after this transaction can't be added to a batch that's queued ahead of it.
+**/
+- (void)willQueueTransaction
+{
+	atomic_fetch_add_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+	
+	[self sealCoalescedReads];
+}
+
+- (void)sealCoalescedReads
+{
+	YAPUnfairLockLock(&coalescedReadsLock);
+	{
+		coalescedReads = nil;
+	}
+	YAPUnfairLockUnlock(&coalescedReadsLock);
+}
+
+/**
+ * Read-write access to the database.
+ * 
+ * Only a single read-write block can execute among all sibling connections.
+ * Thus this method may block if another sibling connection is currently executing a read-write block.
+ * 
+ * This method is asynchronous.
+**/
+- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+{
+	[self asyncReadWriteWithBlock:block completionQueue:NULL completionBlock:NULL];
+}
+
+/**
+ * Read-write access to the database.
+ *
+ * Only a single read-write block can execute among all sibling connections.
+ * Thus the execution of the block may be delayted if another sibling connection
+ * is currently executing a read-write block.
+ *
+ * This method is asynchronous.
+ * 
+ * An optional completion block may be used.
+ * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+**/
+- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+                completionBlock:(dispatch_block_t)completionBlock
+{
+	[self asyncReadWriteWithBlock:block completionQueue:NULL completionBlock:completionBlock];
+}
+
+/**
+ * Read-write access to the database.
+ *
+ * Only a single read-write block can execute among all sibling connections.
+ * Thus the execution of the block may be delayted if another sibling connection
+ * is currently executing a read-write block.
+ *
+ * This method is asynchronous.
+ * 
+ * An optional completion block may be used.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+                completionQueue:(dispatch_queue_t)completionQueue
+                completionBlock:(dispatch_block_t)completionBlock
+{
+	[self asyncReadWriteWithBlock:block
+	                   durability:YapDatabaseDurabilityFull
+	              completionQueue:completionQueue
+	              completionBlock:completionBlock];
+}
+
+/**
+ * Read-write access to the database, with the given durability.
+ * 
+ * This method is asynchronous.
+**/
+- (void)asyncReadWriteWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+                     durability:(YapDatabaseDurability)durability
+                completionQueue:(dispatch_queue_t)completionQueue
+                completionBlock:(dispatch_block_t)completionBlock
+{
+#if YapDatabaseEnforcePermittedTransactions
+	YapDatabasePermittedTransactions flags = self.permittedTransactions;
+	if ((flags & YDB_MainThreadOnly) && !YDBIsMainThread())
+	{
+		@throw [self nonMainThreadException];
+	}
+	if (!(flags & YDB_AsyncReadWriteTransaction))
+	{
+		@throw [self unpermittedTransactionException:YDB_AsyncReadWriteTransaction];
+	}
+#endif
+	
+	// Order matters.
+	// First go through the serial connection queue.
+	// Then go through serial write queue for the database.
+	//
+	// Once we're inside the database writeQueue, we know that we are the only write transaction.
+	// No other transaction can possibly modify the database except us, even in other connections.
+	
+	YapDatabaseWritePriority priority = self.writePriority;
+	
+	uint64_t queueWaitTicks = mach_absolute_time();
+	YapDatabaseQueueWaitEvent *queueWaitEvent = [self newQueueWaitEventForHolder:connectionQueueHolder];
+	
+	[self willQueueTransaction];
+	dispatch_async(connectionQueue, ^{
+		
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t transactionStartTicks = mach_absolute_time();
+		[self didEnterConnectionQueueSinceTicks:queueWaitTicks readWrite:YES event:queueWaitEvent];
+		
+		if (longLivedReadTransaction)
+		{
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+				           self, database);
+				
+				[self endLongLivedReadTransaction];
+			}
+		}
+		
+		[self preWriteQueueWithPriority:priority];
+		
+		// Relaxed transactions don't need to wait for a sync, so they never take part in a group commit.
+		BOOL groupCommitEnabled = database->groupCommitEnabled && (durability == YapDatabaseDurabilityFull);
+		if (groupCommitEnabled) {
+			atomic_fetch_add_explicit(&database->groupCommitWaitingCount, 1, memory_order_relaxed);
+		}
+		
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
 			
-			int checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE,
-			                                                 &totalFrameCount, &checkpointedFrameCount);
+			[self didEnterWriteQueueWithPriority:priority];
 			
-			YDBLogInfo(@"Post-checkpoint: src(d) mode(passive) result(%d) frames(%d) checkpointed(%d)",
-			           checkpointResult, totalFrameCount, checkpointedFrameCount);
+			BOOL deferred = NO;
+			BOOL relaxed = NO;
+			if (groupCommitEnabled)
+			{
+				atomic_fetch_sub_explicit(&database->groupCommitWaitingCount, 1, memory_order_relaxed);
+				deferred = [self preGroupCommitTransaction];
+			}
+			else if (durability == YapDatabaseDurabilityRelaxed)
+			{
+				relaxed = [self preRelaxedDurabilityTransaction];
+			}
+			
+			YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
+			
+			[self preReadWriteTransaction:transaction];
+			block(transaction);
+			[self postReadWriteTransaction:transaction];
+			
+			if (groupCommitEnabled)
+			{
+				[self postGroupCommitTransaction:transaction
+				                        deferred:deferred
+				                 completionQueue:completionQueue
+				                 completionBlock:completionBlock];
+			}
+			else
+			{
+				[self postDurabilityTransaction:transaction relaxed:relaxed];
+				
+				if (transaction->completionBlockStack)
+				{
+					NSUInteger count = transaction->completionBlockStack.count;
+					for (NSUInteger i = 0; i < count; i++)
+					{
+						dispatch_queue_t stackItemQueue = transaction->completionQueueStack[i];
+						dispatch_block_t stackItemBlock = transaction->completionBlockStack[i];
+						
+						dispatch_async(stackItemQueue, stackItemBlock);
+					}
+				}
+				
+				if (completionBlock) {
+					dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
+				}
+			}
+			
+			[self willExitWriteQueue];
+			
+		}}); // End dispatch_sync(database->writeQueue)
+		
+		[self willExitConnectionQueue];
+		[self noteTransactionTicksSince:transactionStartTicks];
+		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	}); // End dispatch_async(connectionQueue)
+}
+
+/**
+ * It's sometimes useful to find out when all previously queued transactions on a connection have completed.
+ * For example, you may have multiple methods (perhaps scattered across multiple classes) that may queue
+ * asyncReadWriteTransaction's on a particular databaseConnection. And you'd like to know when all
+ * the queued readWriteTransactions have completed.
+ * 
+ * One way to accomplish this is simply to queue an asyncReadTransaction on the databaseConnection.
+ * Since all transactions on a databaseConnection are queued onto a serial dispatch queue, you'll know that once
+ * your asyncReadTransaction is running, all previously scheduled transactions have completed.
+ *
+ * Although the above technique works, the 'flushTransactionsWithCompletionQueue:completionBlock:'
+ * is a more efficient way to accomplish this task. (And a more elegant & readable way too.)
+ *
+ * @param completionQueue
+ *   The dispatch_queue to invoke the completionBlock on.
+ *   If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * @param completionBlock
+ *   The block to invoke once all previously scheduled transactions have completed.
+**/
+- (void)flushTransactionsWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
+                             completionBlock:(nullable dispatch_block_t)completionBlock
+{
+	if (completionBlock == NULL) return;
+	
+	dispatch_async(connectionQueue, ^{
+		
+		dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
+	});
+}
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Write Priority
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Read-write access to the database, split into multiple transactions (chunks).
+ * See the header file for a discussion.
+**/
+- (void)asyncIncrementalReadWriteWithBlock:(BOOL (^)(YapDatabaseReadWriteTransaction *transaction))block
+                           completionQueue:(dispatch_queue_t)completionQueue
+                           completionBlock:(dispatch_block_t)completionBlock
+{
+	__block BOOL isComplete = YES;
+	
+	[self asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		isComplete = block(transaction);
+		
+	} completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0) completionBlock:^{
+		
+		if (isComplete)
+		{
+			if (completionBlock) {
+				dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
+			}
+		}
+		else
+		{
+			// Queue the next chunk.
+			// Since the previous chunk has been committed, any waiting transactions get to go first.
 			
-			if (checkpointResult == SQLITE_OK)
+			[self asyncIncrementalReadWriteWithBlock:block
+			                         completionQueue:completionQueue
+			                         completionBlock:completionBlock];
+		}
+	}];
+}
+
+/**
+ * The default duration of each chunk processed by asyncReadWriteWithItems:chunkDuration:usingBlock:....
+**/
+#define YAP_DEFAULT_CHUNK_DURATION 0.008
+
+/**
+ * Read-write access to the database, processing the given work items in time-bounded chunks.
+ * See the header file for a discussion.
+**/
+- (NSProgress *)asyncReadWriteWithItems:(NSEnumerator *)items
+                          chunkDuration:(NSTimeInterval)chunkDuration
+                             usingBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction, id item))block
+                        completionQueue:(dispatch_queue_t)completionQueue
+                        completionBlock:(dispatch_block_t)completionBlock
+{
+	if (chunkDuration <= 0.0)
+		chunkDuration = YAP_DEFAULT_CHUNK_DURATION;
+	
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:-1];
+	
+	// Under memory pressure we end the current chunk early (committing releases the transaction's memory),
+	// and flush the caches in between chunks.
+	
+	dispatch_source_t memoryPressureSource =
+	  dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+	                         DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+	                         dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+	
+	__weak YapDatabaseConnection *weakSelf = self;
+	dispatch_source_set_event_handler(memoryPressureSource, ^{
+		
+		__strong YapDatabaseConnection *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		atomic_store_explicit(&strongSelf->chunkedWriteMemoryPressure, true, memory_order_relaxed);
+		[strongSelf flushMemoryWithFlags:YapDatabaseConnectionFlushMemoryFlags_Caches];
+	});
+	
+	#if !OS_OBJECT_USE_OBJC
+	dispatch_source_set_cancel_handler(memoryPressureSource, ^{
+		dispatch_release(memoryPressureSource);
+	});
+	#endif
+	
+	dispatch_resume(memoryPressureSource);
+	
+	[self asyncIncrementalReadWriteWithBlock:^BOOL (YapDatabaseReadWriteTransaction *transaction) {
+		
+		atomic_store_explicit(&self->chunkedWriteMemoryPressure, false, memory_order_relaxed);
+		NSTimeInterval deadline = [NSDate timeIntervalSinceReferenceDate] + chunkDuration;
+		
+		do
+		{
+			if (progress.cancelled) return YES;
+			
+			id item = [items nextObject];
+			if (item == nil) return YES;
+			
+			@autoreleasepool {
+				block(transaction, item);
+			}
+			
+			progress.completedUnitCount = progress.completedUnitCount + 1;
+			
+		} while (([NSDate timeIntervalSinceReferenceDate] < deadline) &&
+		         ![transaction shouldYield] &&
+		         !atomic_load_explicit(&self->chunkedWriteMemoryPressure, memory_order_relaxed));
+		
+		return NO;
+		
+	} completionQueue:completionQueue completionBlock:^{
+		
+		dispatch_source_cancel(memoryPressureSource);
+		
+		if (progress.totalUnitCount < 0) {
+			progress.totalUnitCount = progress.completedUnitCount;
+		}
+		
+		if (completionBlock) {
+			completionBlock();
+		}
+	}];
+	
+	return progress;
+}
+
+/**
+ * Invoked (within the connectionQueue, but outside the writeQueue) before a read-write transaction
+ * joins the writeQueue. This is where the writeQueue wait starts.
+ * 
+ * Default priority transactions register themselves as waiting.
+ * Background priority transactions wait here until no default priority transactions are waiting.
+**/
+- (void)preWriteQueueWithPriority:(YapDatabaseWritePriority)priority
+{
+	writeQueueWaitTicks = mach_absolute_time();
+	writeQueueWaitEvent = [self newQueueWaitEventForHolder:database->writeQueueHolder];
+	
+	if (priority == YapDatabaseWritePriorityBackground)
+	{
+		NSCondition *condition = database->priorityWritersCondition;
+		
+		[condition lock];
+		while (atomic_load_explicit(&database->priorityWritersWaitingCount, memory_order_relaxed) > 0)
+		{
+			[condition wait];
+		}
+		[condition unlock];
+	}
+	else
+	{
+		atomic_fetch_add_explicit(&database->priorityWritersWaitingCount, 1, memory_order_relaxed);
+	}
+}
+
+/**
+ * Invoked (within the writeQueue) as soon as a read-write transaction has made it through the writeQueue.
+ * Records the writeQueue wait, and marks this transaction as the holder of the writeQueue.
+ * 
+ * Once the last waiting default priority transaction is through, any waiting background transactions are released.
+**/
+- (void)didEnterWriteQueueWithPriority:(YapDatabaseWritePriority)priority
+{
+	[self noteQueueWait:YapDatabaseQueueWaitWriteQueue sinceTicks:writeQueueWaitTicks event:writeQueueWaitEvent];
+	writeQueueWaitEvent = nil;
+	
+	[database->writeQueueHolder enterWithConnectionName:_name transactionID:queueWaitTransactionID readWrite:YES];
+	
+	if (priority == YapDatabaseWritePriorityBackground) return;
+	
+	unsigned int waitingCount =
+	  atomic_fetch_sub_explicit(&database->priorityWritersWaitingCount, 1, memory_order_relaxed);
+	
+	if (waitingCount == 1)
+	{
+		NSCondition *condition = database->priorityWritersCondition;
+		
+		[condition lock];
+		[condition broadcast];
+		[condition unlock];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Bulk Load
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Read-write access to the database, with the row hooks of the index extensions suspended.
+ * See the header file for a discussion.
+**/
+- (void)bulkLoadWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+{
+	[self readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction beginBulkLoad];
+		block(transaction);
+		[transaction endBulkLoad];
+	}];
+}
+
+- (void)asyncBulkLoadWithBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+               completionQueue:(dispatch_queue_t)completionQueue
+               completionBlock:(dispatch_block_t)completionBlock
+{
+	[self asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[transaction beginBulkLoad];
+		block(transaction);
+		[transaction endBulkLoad];
+		
+	} completionQueue:completionQueue completionBlock:completionBlock];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Group Commit
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The maximum number of transactions that may commit without syncing, before a sync is forced.
+ * This bounds the amount of time a completionBlock may be delayed, even under a constant stream of transactions.
+**/
+#define YAP_GROUP_COMMIT_MAX_DEFERRED 32
+
+/**
+ * Invoked (within the writeQueue) before an asyncReadWrite transaction begins, if group commit is enabled.
+ * 
+ * If other asyncReadWrite transactions are waiting for the writeQueue, then this transaction joins the group.
+ * That is, it commits without syncing the WAL, and its completionBlocks are held until the group is synced.
+ * 
+ * Note: The synchronous level cannot be changed within a transaction, so the decision has to be made here.
+ * 
+ * Returns YES if the transaction was deferred (joined the group).
+**/
+- (BOOL)preGroupCommitTransaction
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must be invoked within writeQueue");
+	
+	unsigned int waitingCount = atomic_load_explicit(&database->groupCommitWaitingCount, memory_order_relaxed);
+	
+	if (waitingCount == 0 || database->groupCommitDeferredCount >= YAP_GROUP_COMMIT_MAX_DEFERRED)
+	{
+		// We're the last transaction in the group (or the group is full).
+		// So we commit with the normal synchronous level, which syncs the WAL for the entire group.
+		return NO;
+	}
+	
+	int status = sqlite3_exec(db, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Invoked (within the writeQueue) after an asyncReadWrite transaction has completed, if group commit is enabled.
+ * 
+ * Adds the transaction's completionBlocks to the group.
+ * If the transaction closes the group, the group is synced, and all the completionBlocks are dispatched (in order).
+**/
+- (void)postGroupCommitTransaction:(YapDatabaseReadWriteTransaction *)transaction
+                          deferred:(BOOL)deferred
+                   completionQueue:(dispatch_queue_t)completionQueue
+                   completionBlock:(dispatch_block_t)completionBlock
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must be invoked within writeQueue");
+	
+	NSMutableArray<dispatch_queue_t> *groupQueues = database->groupCommitCompletionQueues;
+	NSMutableArray<dispatch_block_t> *groupBlocks = database->groupCommitCompletionBlocks;
+	
+	if (transaction->completionBlockStack)
+	{
+		[groupQueues addObjectsFromArray:transaction->completionQueueStack];
+		[groupBlocks addObjectsFromArray:transaction->completionBlockStack];
+	}
+	
+	if (completionBlock)
+	{
+		[groupQueues addObject:(completionQueue ?: dispatch_get_main_queue())];
+		[groupBlocks addObject:completionBlock];
+	}
+	
+	BOOL didCommitDiskChanges = hasDiskChanges && !transaction->rollback;
+	
+	if (deferred)
+	{
+		int status = sqlite3_exec(db, "PRAGMA synchronous = FULL;", NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
+		}
+		
+		if (didCommitDiskChanges) {
+			database->groupCommitDeferredCount++;
+		}
+		
+		// The completionBlocks are dispatched by the transaction that closes the group.
+		return;
+	}
+	
+	// We're closing the group.
+	//
+	// If we committed changes, then our commit already synced the WAL,
+	// which includes every commit that preceded it (the WAL is a single append-only file).
+	// Otherwise we need to explicitly sync on behalf of the deferred transactions.
+	
+	if (didCommitDiskChanges)
+	{
+		[self didSyncDurability];
+	}
+	else if (database->groupCommitDeferredCount > 0)
+	{
+		[self syncDurability];
+	}
+	
+	NSUInteger count = groupBlocks.count;
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		dispatch_async(groupQueues[i], groupBlocks[i]);
+	}
+	
+	[groupQueues removeAllObjects];
+	[groupBlocks removeAllObjects];
+	database->groupCommitDeferredCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Durability
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A durability barrier.
+ * 
+ * Syncs the WAL to disk (if needed), and then invokes the completionBlock.
+**/
+- (void)flushDurabilityWithCompletionQueue:(dispatch_queue_t)completionQueue
+                           completionBlock:(dispatch_block_t)completionBlock
+{
+	[self willQueueTransaction];
+	dispatch_async(connectionQueue, ^{
+		
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t transactionStartTicks = mach_absolute_time();
+		
+		if (longLivedReadTransaction)
+		{
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+				           self, database);
+				
+				[self endLongLivedReadTransaction];
+			}
+		}
+		
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			// If the database isn't using YapDatabasePragmaSynchronous_Full,
+			// then we don't track which commits were synced, so we always sync.
+			
+			if (!database->relaxedDurabilityEnabled || database->relaxedDurabilityPendingCount > 0)
+			{
+				[self syncDurability];
+			}
+			
+			if (completionBlock) {
+				dispatch_async(completionQueue ?: dispatch_get_main_queue(), completionBlock);
+			}
+			
+		}}); // End dispatch_sync(database->writeQueue)
+		
+		[self noteTransactionTicksSince:transactionStartTicks];
+		atomic_fetch_sub_explicit(&pendingTransactionCount, (uint64_t)1, memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	}); // End dispatch_async(connectionQueue)
+}
+
+/**
+ * Invoked (within the writeQueue) before a YapDatabaseDurabilityRelaxed transaction begins.
+ * 
+ * Note: The synchronous level cannot be changed within a transaction, so it has to be changed here.
+ * 
+ * Returns YES if the transaction will commit without syncing.
+**/
+- (BOOL)preRelaxedDurabilityTransaction
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must be invoked within writeQueue");
+	
+	if (!database->relaxedDurabilityEnabled)
+	{
+		// The database isn't syncing on commit anyway (pragmaSynchronous != Full).
+		return NO;
+	}
+	
+	int status = sqlite3_exec(db, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Invoked (within the writeQueue) after a read-write transaction has completed,
+ * unless it was deferred as part of a group commit.
+ * 
+ * Keeps track of the relaxed commits that haven't been synced yet,
+ * and forces a sync if the configured limits have been reached.
+**/
+- (void)postDurabilityTransaction:(YapDatabaseReadWriteTransaction *)transaction relaxed:(BOOL)relaxed
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must be invoked within writeQueue");
+	
+	if (!database->relaxedDurabilityEnabled) return;
+	
+	BOOL didCommitDiskChanges = hasDiskChanges && !transaction->rollback;
+	
+	if (!relaxed)
+	{
+		// A full commit syncs the WAL,
+		// which includes every commit that preceded it (the WAL is a single append-only file).
+		
+		if (didCommitDiskChanges) {
+			[self didSyncDurability];
+		}
+		return;
+	}
+	
+	int status = sqlite3_exec(db, "PRAGMA synchronous = FULL;", NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
+	}
+	
+	if (!didCommitDiskChanges) return;
+	
+	database->relaxedDurabilityPendingCount++;
+	
+	NSUInteger limit = database->relaxedDurabilityTransactionLimit;
+	if (limit > 0 && database->relaxedDurabilityPendingCount >= limit)
+	{
+		[self syncDurability];
+		return;
+	}
+	
+	NSTimeInterval interval = database->relaxedDurabilityInterval;
+	if (interval > 0 && database->relaxedDurabilityPendingCount == 1)
+	{
+		[self scheduleDurabilitySync:database->relaxedDurabilityGeneration afterInterval:interval];
+	}
+}
+
+/**
+ * Schedules a sync, unless one has already occurred by then (i.e. the generation has changed).
+ * 
+ * The sync goes through this connection's queue, as it requires the connection's sqlite handle.
+**/
+- (void)scheduleDurabilitySync:(uint64_t)generation afterInterval:(NSTimeInterval)interval
+{
+	dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(interval * NSEC_PER_SEC));
+	
+	__weak YapDatabaseConnection *weakSelf = self;
+	dispatch_after(when, connectionQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabaseConnection *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		if (strongSelf->longLivedReadTransaction)
+		{
+			// We can't start a write transaction here without implicitly ending the long-lived read transaction.
+			// So try again later.
+			[strongSelf scheduleDurabilitySync:generation afterInterval:interval];
+			return;
+		}
+		
+		dispatch_sync(strongSelf->database->writeQueue, ^{ @autoreleasepool {
+			
+			YapDatabase *database = strongSelf->database;
+			
+			if (database->relaxedDurabilityGeneration == generation && database->relaxedDurabilityPendingCount > 0)
+			{
+				[strongSelf syncDurability];
+			}
+		}});
+	}});
+}
+
+/**
+ * Forces a sync of the WAL, by committing a (tiny) write transaction with synchronous = FULL.
+ * 
+ * Sqlite only syncs when committing, and skips the commit entirely if nothing was modified.
+ * So we rewrite the snapshot row (as-is), which doesn't change anything seen by other connections.
+**/
+- (void)syncDurability
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must be invoked within writeQueue");
+	
+	BOOL changeSynchronous = !database->relaxedDurabilityEnabled;
+	if (changeSynchronous)
+	{
+		int status = sqlite3_exec(db, "PRAGMA synchronous = FULL;", NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
+		}
+	}
+	
+	char *sync_stmt =
+	  "BEGIN IMMEDIATE TRANSACTION;"
+	  "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\")"
+	  " SELECT \"extension\", \"key\", \"data\" FROM \"yap2\""
+	  " WHERE \"extension\" = '' AND \"key\" = 'snapshot';"
+	  "COMMIT TRANSACTION;";
+	
+	int status = sqlite3_exec(db, sync_stmt, NULL, NULL, NULL);
+	if (status == SQLITE_OK)
+	{
+		[self didSyncDurability];
+	}
+	else
+	{
+		YDBLogError(@"Error syncing database: %d %s", status, sqlite3_errmsg(db));
+		
+		if (!sqlite3_get_autocommit(db)) {
+			sqlite3_exec(db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		}
+	}
+	
+	if (changeSynchronous)
+	{
+		YapDatabasePragmaSynchronous pragmaSynchronous = database.options.pragmaSynchronous;
+		
+		char *pragma_stmt = (pragmaSynchronous == YapDatabasePragmaSynchronous_Off)
+		  ? "PRAGMA synchronous = OFF;"
+		  : "PRAGMA synchronous = NORMAL;";
+		
+		status = sqlite3_exec(db, pragma_stmt, NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error setting PRAGMA synchronous: %d %s", status, sqlite3_errmsg(db));
+		}
+	}
+}
+
+/**
+ * Invoked (within the writeQueue) whenever the WAL has been synced.
+ * Every pending relaxed commit is now durable.
+**/
+- (void)didSyncDurability
+{
+	database->relaxedDurabilityPendingCount = 0;
+	database->relaxedDurabilityGeneration++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Metrics
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef SQLITE_TRACE_PROFILE
+/**
+ * Invoked by sqlite when a statement finishes (if transaction metrics are enabled).
+ * The statement is executed on the same thread as the transaction, so we can use the current metrics.
+**/
+static int YapDatabaseConnectionTraceProfile(unsigned type, void __unused *context, void __unused *p, void *x)
+{
+	if (type == SQLITE_TRACE_PROFILE)
+	{
+		YapDatabaseTransactionMetrics *metrics = YapDatabaseTransactionMetricsGetCurrent();
+		if (metrics)
+		{
+			metrics->sqliteNanoseconds += (uint64_t)MAX(*(sqlite3_int64 *)x, 0);
+			metrics->sqliteStatementCount++;
+		}
+	}
+	
+	return 0;
+}
+#endif
+
+- (void)setTransactionMetricsBlock:(YapDatabaseTransactionMetricsBlock)inBlock queue:(dispatch_queue_t)inQueue
+{
+	YapDatabaseTransactionMetricsBlock newBlock = [inBlock copy];
+	dispatch_queue_t newQueue = inQueue ?: dispatch_get_main_queue();
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		BOOL wasMeasuring = [self isMeasuringTransactions];
+		
+		transactionMetricsBlock = newBlock;
+		transactionMetricsQueue = newBlock ? newQueue : nil;
+		
+		[self didChangeMeasuringTransactions:wasMeasuring];
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (void)setTransactionBudgetForReads:(NSTimeInterval)readBudget
+                              writes:(NSTimeInterval)writeBudget
+                               block:(YapDatabaseTransactionBudgetBlock)inBlock
+                               queue:(dispatch_queue_t)inQueue
+{
+	YapDatabaseTransactionBudgetBlock newBlock = [inBlock copy];
+	dispatch_queue_t newQueue = inQueue ?: dispatch_get_main_queue();
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		BOOL wasMeasuring = [self isMeasuringTransactions];
+		
+		transactionReadBudget = MAX(readBudget, 0.0);
+		transactionWriteBudget = MAX(writeBudget, 0.0);
+		transactionBudgetBlock = newBlock;
+		transactionBudgetQueue = newBlock ? newQueue : nil;
+		
+		[self didChangeMeasuringTransactions:wasMeasuring];
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+/**
+ * Transactions are measured if either the transactionMetricsBlock or the transactionBudgetBlock is set.
+ * 
+ * This method must be invoked from within the connectionQueue.
+**/
+- (BOOL)isMeasuringTransactions
+{
+	return (transactionMetricsBlock != nil || transactionBudgetBlock != nil);
+}
+
+/**
+ * Enables (or disables) the measurements that are shared by all transactions on this connection.
+ * 
+ * This method must be invoked from within the connectionQueue.
+**/
+- (void)didChangeMeasuringTransactions:(BOOL)wasMeasuring
+{
+	BOOL isMeasuring = [self isMeasuringTransactions];
+	
+	if (isMeasuring && !wasMeasuring)
+	{
+		atomic_fetch_add_explicit(&database->transactionMetricsConnectionCount, 1, memory_order_relaxed);
+	#ifdef SQLITE_TRACE_PROFILE
+		sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, YapDatabaseConnectionTraceProfile, NULL);
+	#endif
+	}
+	else if (!isMeasuring && wasMeasuring)
+	{
+		atomic_fetch_sub_explicit(&database->transactionMetricsConnectionCount, 1, memory_order_relaxed);
+	#ifdef SQLITE_TRACE_PROFILE
+		sqlite3_trace_v2(db, 0, NULL, NULL);
+	#endif
+	}
+}
+
+/**
+ * Invoked at the very beginning of a read-write transaction (within the writeQueue).
+**/
+- (void)beginTransactionMetrics
+{
+	if (transactionMetricsBlock == nil && transactionBudgetStartTicks == 0) return;
+	
+	transactionMetrics = [[YapDatabaseTransactionMetrics alloc] init];
+	transactionMetrics->startTime = mach_absolute_time();
+	
+	objectCache.lookupCounters = &transactionMetrics->objectCacheCounters;
+	metadataCache.lookupCounters = &transactionMetrics->metadataCacheCounters;
+	
+	YapDatabaseTransactionMetricsSetCurrent(transactionMetrics);
+}
+
+/**
+ * Invoked at the very end of a read-write transaction (within the writeQueue).
+ * Delivers the metrics to the transactionMetricsBlock.
+**/
+- (void)endTransactionMetrics
+{
+	YapDatabaseTransactionMetrics *metrics = transactionMetrics;
+	if (metrics == nil) return;
+	
+	metrics->totalTicks = YapDatabaseTransactionMetricsElapsed(metrics->startTime);
+	metrics->snapshot = snapshot;
+	
+	YapDatabaseTransactionMetricsSetCurrent(nil);
+	
+	objectCache.lookupCounters = NULL;
+	metadataCache.lookupCounters = NULL;
+	
+	transactionMetrics = nil;
+	
+	if (transactionBudgetStartTicks > 0) {
+		transactionBudgetMetrics = metrics;
+	}
+	
+	YapDatabaseTransactionMetricsBlock block = transactionMetricsBlock;
+	if (block)
+	{
+		dispatch_async(transactionMetricsQueue, ^{ @autoreleasepool {
+			
+			block(self, metrics);
+		}});
+	}
+}
+
+/**
+ * Invoked right before the block of a read-only transaction (within the connectionQueue).
+ * Read-only transactions are only measured if they're budgeted.
+**/
+- (void)beginReadTransactionMetrics
+{
+	if (transactionBudgetStartTicks == 0) return;
+	
+	transactionMetrics = [[YapDatabaseTransactionMetrics alloc] init];
+	transactionMetrics->startTime = mach_absolute_time();
+	transactionMetrics->blockStartTime = transactionMetrics->startTime;
+	
+	objectCache.lookupCounters = &transactionMetrics->objectCacheCounters;
+	metadataCache.lookupCounters = &transactionMetrics->metadataCacheCounters;
+	
+	YapDatabaseTransactionMetricsSetCurrent(transactionMetrics);
+}
+
+/**
+ * Invoked right after the block of a read-only transaction (within the connectionQueue).
+**/
+- (void)endReadTransactionMetrics
+{
+	YapDatabaseTransactionMetrics *metrics = transactionMetrics;
+	if (metrics == nil) return;
+	
+	metrics->blockTicks = YapDatabaseTransactionMetricsElapsed(metrics->blockStartTime);
+	metrics->totalTicks = metrics->blockTicks;
+	metrics->snapshot = snapshot;
+	
+	YapDatabaseTransactionMetricsSetCurrent(nil);
+	
+	objectCache.lookupCounters = NULL;
+	metadataCache.lookupCounters = NULL;
+	
+	transactionMetrics = nil;
+	transactionBudgetMetrics = metrics;
+}
+
+/**
+ * Invoked at the very beginning of a transaction (within the connectionQueue).
+ * Arms the timer that samples the thread if the transaction exceeds its budget.
+**/
+- (void)armTransactionBudgetWithReadWrite:(BOOL)isReadWrite
+{
+	transactionBudgetStartTicks = 0;
+	transactionBudgetMetrics = nil;
+	
+	if (transactionBudgetBlock == nil) return;
+	
+	NSTimeInterval budget = isReadWrite ? transactionWriteBudget : transactionReadBudget;
+	if (budget <= 0) return;
+	
+	transactionBudgetStartTicks = mach_absolute_time();
+	
+	YAPUnfairLockLock(&transactionBudgetLock);
+	{
+		transactionBudgetThread = pthread_mach_thread_np(pthread_self());
+		transactionBudgetFrameCount = 0;
+		transactionBudgetArmed = YES;
+	}
+	YAPUnfairLockUnlock(&transactionBudgetLock);
+	
+	BOOL isNewTimer = NO;
+	
+	if (transactionBudgetTimer == NULL)
+	{
+		// All connections share a single (high priority) queue for their timers.
+		// The sampling is quick, and the queue mustn't be one that a budgeted transaction could be waiting on.
+		
+		static dispatch_queue_t watchdogQueue;
+		static dispatch_once_t onceToken;
+		dispatch_once(&onceToken, ^{
+			
+			dispatch_queue_attr_t attr =
+			  dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INTERACTIVE, 0);
+			
+			watchdogQueue = dispatch_queue_create("YapDatabaseTransactionBudget", attr);
+		});
+		
+		transactionBudgetTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, watchdogQueue);
+		
+		__weak YapDatabaseConnection *weakSelf = self;
+		dispatch_source_set_event_handler(transactionBudgetTimer, ^{ @autoreleasepool {
+			
+			__strong YapDatabaseConnection *strongSelf = weakSelf;
+			if (strongSelf)
+			{
+				[strongSelf handleTransactionBudgetTimerFire];
+			}
+		}});
+		
+		#if !OS_OBJECT_USE_OBJC
+		dispatch_source_t timer = transactionBudgetTimer;
+		dispatch_source_set_cancel_handler(transactionBudgetTimer, ^{
+			dispatch_release(timer);
+		});
+		#endif
+		
+		isNewTimer = YES;
+	}
+	
+	dispatch_time_t tt = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(budget * NSEC_PER_SEC));
+	dispatch_source_set_timer(transactionBudgetTimer, tt, DISPATCH_TIME_FOREVER, (uint64_t)(budget * NSEC_PER_SEC / 10));
+	
+	if (isNewTimer) {
+		dispatch_resume(transactionBudgetTimer);
+	}
+}
+
+/**
+ * Invoked (within the watchdog queue) when a transaction has exceeded its budget.
+ * Samples the thread that's executing the transaction.
+ * 
+ * The lock prevents the transaction from ending (and its thread from moving on) while we're sampling.
+**/
+- (void)handleTransactionBudgetTimerFire
+{
+	YAPUnfairLockLock(&transactionBudgetLock);
+	{
+		if (transactionBudgetArmed && transactionBudgetFrameCount == 0)
+		{
+			transactionBudgetFrameCount =
+			  YapDatabaseSampleThread(transactionBudgetThread, transactionBudgetFrames, YAP_TRANSACTION_BUDGET_MAX_FRAMES);
+		}
+	}
+	YAPUnfairLockUnlock(&transactionBudgetLock);
+}
+
+/**
+ * Invoked at the very end of a transaction (within the connectionQueue).
+ * Disarms the timer, and reports the transaction if it exceeded its budget.
+**/
+- (void)disarmTransactionBudgetWithReadWrite:(BOOL)isReadWrite
+{
+	if (transactionBudgetStartTicks == 0) return;
+	
+	NSTimeInterval duration = YapDatabaseTicksToSeconds(mach_absolute_time() - transactionBudgetStartTicks);
+	transactionBudgetStartTicks = 0;
+	
+	if (transactionBudgetTimer) {
+		dispatch_source_set_timer(transactionBudgetTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+	}
+	
+	uintptr_t frames[YAP_TRANSACTION_BUDGET_MAX_FRAMES];
+	NSUInteger frameCount = 0;
+	
+	YAPUnfairLockLock(&transactionBudgetLock);
+	{
+		frameCount = transactionBudgetFrameCount;
+		memcpy(frames, transactionBudgetFrames, frameCount * sizeof(uintptr_t));
+		
+		transactionBudgetArmed = NO;
+		transactionBudgetFrameCount = 0;
+		transactionBudgetThread = MACH_PORT_NULL;
+	}
+	YAPUnfairLockUnlock(&transactionBudgetLock);
+	
+	YapDatabaseTransactionMetrics *metrics = transactionBudgetMetrics ?: [[YapDatabaseTransactionMetrics alloc] init];
+	transactionBudgetMetrics = nil;
+	
+	NSTimeInterval budget = isReadWrite ? transactionWriteBudget : transactionReadBudget;
+	YapDatabaseTransactionBudgetBlock block = transactionBudgetBlock;
+	
+	if (duration <= budget || block == nil) return;
+	
+	YDBLogWarn(@"%@ transaction on connection(%@) took %.1f ms (budget: %.1f ms)",
+	           (isReadWrite ? @"Read-write" : @"Read-only"), _name, (duration * 1000.0), (budget * 1000.0));
+	
+	NSData *framesData = [NSData dataWithBytes:frames length:(frameCount * sizeof(uintptr_t))];
+	NSString *connectionName = _name;
+	
+	// Symbolicating is slow, so we do it on the delivery queue (not within the connectionQueue).
+	
+	dispatch_async(transactionBudgetQueue, ^{ @autoreleasepool {
+		
+		NSArray<NSString *> *callStackSymbols =
+		  YapDatabaseSymbolicateAddresses((const uintptr_t *)framesData.bytes, frameCount);
+		
+		YapDatabaseTransactionBudgetReport *report =
+		  [[YapDatabaseTransactionBudgetReport alloc] initWithConnectionName:connectionName
+		                                                           readWrite:isReadWrite
+		                                                              budget:budget
+		                                                            duration:duration
+		                                                             metrics:metrics
+		                                                    callStackSymbols:callStackSymbols];
+		block(self, report);
+	}});
+}
+
+- (YapDatabaseWorkloadTraceRecorder *)workloadTraceRecorder
+{
+	__block YapDatabaseWorkloadTraceRecorder *result = nil;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = workloadTraceRecorder;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)setWorkloadTraceRecorder:(YapDatabaseWorkloadTraceRecorder *)recorder
+{
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (workloadTraceRecorder == recorder) return;
+		
+		workloadTraceRecorder = recorder;
+		workloadTraceConnectionID = [recorder nextConnectionID];
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+/**
+ * Invoked at the very beginning of a transaction (within the connectionQueue).
+**/
+- (void)beginWorkloadTraceWithReadWrite:(BOOL)isReadWrite
+{
+	if (workloadTraceRecorder == nil || workloadTrace) return;
+	
+	workloadTrace = [workloadTraceRecorder beginTransactionWithConnectionID:workloadTraceConnectionID
+	                                                              readWrite:isReadWrite];
+}
+
+/**
+ * Invoked at the very end of a transaction (within the connectionQueue).
+ * Hands the recorded events to the workloadTraceRecorder.
+**/
+- (void)endWorkloadTraceWithRollback:(BOOL)didRollback
+{
+	if (workloadTrace == nil) return;
+	
+	[workloadTrace finishWithRollback:didRollback];
+	workloadTrace = nil;
+}
+
+- (YapDatabaseQueueWaitStatistics *)queueWaitStatistics
+{
+	// The counters are atomic, so we don't dispatch onto the connectionQueue.
+	// (Which would, of course, have to wait on the connectionQueue.)
+	
+	return [[YapDatabaseQueueWaitStatistics alloc] initWithStats:queueWaitStats];
+}
+
+- (void)resetQueueWaitStatistics
+{
+	yap_queue_wait_stats_reset(queueWaitStats);
+}
+
+- (void)setQueueWaitThreshold:(NSTimeInterval)threshold
+                        block:(YapDatabaseQueueWaitBlock)inBlock
+                        queue:(dispatch_queue_t)inQueue
+{
+	YapDatabaseQueueWaitBlock newBlock = [inBlock copy];
+	dispatch_queue_t newQueue = inQueue ?: dispatch_get_main_queue();
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		queueWaitThreshold = threshold;
+		queueWaitBlock = newBlock;
+		queueWaitQueue = newBlock ? newQueue : nil;
+		
+		atomic_store_explicit(&queueWaitEventsEnabled, (newBlock != nil), memory_order_relaxed);
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+/**
+ * Invoked (on any thread) right before waiting on a queue.
+ * Returns an event identifying the current holder of the queue, or nil if there's no queueWaitBlock.
+**/
+- (YapDatabaseQueueWaitEvent *)newQueueWaitEventForHolder:(YapDatabaseQueueHolder *)holder
+{
+	if (!atomic_load_explicit(&queueWaitEventsEnabled, memory_order_relaxed)) return nil;
+	
+	return [holder newWaitEvent];
+}
+
+/**
+ * Invoked (within the connectionQueue) once a wait has ended.
+ * Records the wait, and delivers the event to the queueWaitBlock if the wait exceeded the threshold.
+ * 
+ * Returns the current time (i.e. the end of the wait).
+**/
+- (uint64_t)noteQueueWait:(YapDatabaseQueueWait)wait
+               sinceTicks:(uint64_t)startTicks
+                    event:(YapDatabaseQueueWaitEvent *)event
+{
+	uint64_t now = mach_absolute_time();
+	uint64_t ticks = now - startTicks;
+	
+	yap_queue_wait_stats_record(&queueWaitStats[wait], ticks);
+	
+	YapDatabaseQueueWaitBlock block = queueWaitBlock;
+	if (event && block)
+	{
+		NSTimeInterval duration = YapDatabaseTicksToSeconds(ticks);
+		if (duration >= queueWaitThreshold)
+		{
+			event->wait = wait;
+			event->duration = duration;
+			event->connectionName = _name;
+			event->transactionID = queueWaitTransactionID;
+			event->readWrite = queueWaitReadWrite;
+			
+			dispatch_async(queueWaitQueue, ^{ @autoreleasepool {
+				
+				block(self, event);
+			}});
+		}
+	}
+	
+	return now;
+}
+
+/**
+ * Invoked at the very beginning of a transaction (within the connectionQueue).
+ * Assigns the transaction its ID, and records how long it waited for the connectionQueue.
+**/
+- (void)didEnterConnectionQueueSinceTicks:(uint64_t)startTicks
+                                readWrite:(BOOL)isReadWrite
+                                    event:(YapDatabaseQueueWaitEvent *)event
+{
+	queueWaitTransactionID =
+	  atomic_fetch_add_explicit(&database->queueWaitTransactionCount, 1, memory_order_relaxed) + 1;
+	queueWaitReadWrite = isReadWrite;
+	
+	[self noteQueueWait:YapDatabaseQueueWaitConnectionQueue sinceTicks:startTicks event:event];
+	[connectionQueueHolder enterWithConnectionName:_name transactionID:queueWaitTransactionID readWrite:isReadWrite];
+	
+	[self armTransactionBudgetWithReadWrite:isReadWrite];
+}
+
+/**
+ * Invoked at the very end of a transaction (within the connectionQueue).
+**/
+- (void)willExitConnectionQueue
+{
+	[self disarmTransactionBudgetWithReadWrite:queueWaitReadWrite];
+	[connectionQueueHolder exit];
+	
+	queueWaitTransactionID = 0;
+	queueWaitReadWrite = NO;
+}
+
+/**
+ * Invoked (within the writeQueue) right before a read-write transaction leaves the writeQueue.
+**/
+- (void)willExitWriteQueue
+{
+	[database->writeQueueHolder exit];
+}
+
+/**
+ * Invoked as soon as the snapshotQueue has been entered (within the snapshotQueue).
+ * Records how long it took to get in, and returns the current time (i.e. the start of the hold).
+**/
+- (uint64_t)didEnterSnapshotQueueSinceTicks:(uint64_t)startTicks event:(YapDatabaseQueueWaitEvent *)event
+{
+	uint64_t now = [self noteQueueWait:YapDatabaseQueueWaitSnapshotQueue sinceTicks:startTicks event:event];
+	
+	[database->snapshotQueueHolder enterWithConnectionName:_name
+	                                         transactionID:queueWaitTransactionID
+	                                             readWrite:queueWaitReadWrite];
+	return now;
+}
+
+/**
+ * Invoked right before leaving the snapshotQueue (within the snapshotQueue).
+**/
+- (void)willExitSnapshotQueueSinceTicks:(uint64_t)holdStartTicks
+{
+	[database->snapshotQueueHolder exit];
+	[self noteQueueWait:YapDatabaseQueueWaitSnapshotQueueHold sinceTicks:holdStartTicks event:nil];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Transaction States
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Required method.
+ * Returns the proper type of transaction for this connection class.
+**/
+- (YapDatabaseReadTransaction *)newReadTransaction
+{
+	return [[YapDatabaseReadTransaction alloc] initWithConnection:self isReadWriteTransaction:NO];
+}
+
+/**
+ * Required method.
+ * Returns the proper type of transaction for this connection class.
+**/
+- (YapDatabaseReadWriteTransaction *)newReadWriteTransaction
+{
+	return [[YapDatabaseReadWriteTransaction alloc] initWithConnection:self isReadWriteTransaction:YES];
+}
+
+/**
+ * Read-only transactions are recycled.
+ * 
+ * A trivial read transaction would otherwise allocate the transaction object,
+ * its extensions containers, and every extension transaction it touches.
+ * Instead the connection holds onto the most recent (completed) read-only transaction, and hands it out again.
+ * Extension transactions are retained by the recycled transaction, and reused as long as the snapshot hasn't changed.
+ * 
+ * This is safe because a transaction must not be used outside of its block,
+ * and each connection only ever executes a single transaction at a time.
+**/
+- (YapDatabaseReadTransaction *)dequeueReadTransaction
+{
+	YapDatabaseReadTransaction *transaction = recycledReadTransaction;
+	if (transaction)
+	{
+		recycledReadTransaction = nil;
+		return transaction;
+	}
+	
+	return [self newReadTransaction];
+}
+
+- (void)recycleReadTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	[transaction prepareForReuse];
+	recycledReadTransaction = transaction;
+}
+
+/**
+ * This method executes the state transition steps required before executing a read-only transaction block.
+ * 
+ * This method must be invoked from within the connectionQueue.
+**/
+/**
+ * Adopts the mmap_size calculated by the database (if adaptive sizing is enabled, and the size has changed).
+ * 
+ * This must be invoked outside of a transaction (i.e. before "BEGIN TRANSACTION"),
+ * as sqlite doesn't resize the mapping while the connection holds pages from it.
+ * 
+ * @see YapDatabaseOptions.pragmaMMapSizeMaximum
+**/
+- (void)updateMMapSizeIfNeeded
+{
+	uint64_t target = atomic_load_explicit(&database->mmapSizeTarget, memory_order_relaxed);
+	if (target == mmapSize) return;
+	
+	NSString *pragma_mmap_size = [NSString stringWithFormat:@"PRAGMA mmap_size = %llu;", (unsigned long long)target];
+	
+	int status = sqlite3_exec(db, [pragma_mmap_size UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error setting PRAGMA mmap_size: %d %s", status, sqlite3_errmsg(db));
+		// This isn't critical, so we can continue.
+	}
+	
+	mmapSize = target;
+}
+
+/**
+ * The sqlite default cache_size (in KiB), which is restored when a connection no longer has a configured size.
+**/
+#define YAP_SQLITE_DEFAULT_CACHE_SIZE_KIB 2000
+
+/**
+ * With adaptive page cache sizing (pageCacheMaximumSize), the minimum number of page lookups between decisions,
+ * and the miss rate (over those lookups) above which the cache is grown.
+**/
+#define YAP_ADAPTIVE_PAGE_CACHE_SAMPLE    1000
+#define YAP_ADAPTIVE_PAGE_CACHE_MISS_RATE 0.10
+
+/**
+ * Adopts this connection's page cache settings (if they've changed):
+ * its pageCacheSize (or else its share of the database's pageCacheBudget), as grown by adaptive sizing,
+ * and pageCacheSpillEnabled.
+ * 
+ * @see YapDatabaseOptions.pageCacheBudget
+**/
+- (void)updatePageCacheSizeIfNeeded
+{
+	if (pageCacheMaximumSize > 0)
+	{
+		[self growPageCacheIfNeeded];
+	}
+	
+	[self applyPageCacheSettings];
+}
+
+- (void)applyPageCacheSettings
+{
+	uint64_t target = pageCacheSize;
+	if (target == 0) {
+		target = atomic_load_explicit(&database->pageCacheShare, memory_order_relaxed);
+	}
+	target = MAX(target, adaptivePageCacheSize);
+	
+	if (target != appliedPageCacheSize)
+	{
+		// A negative cache_size is the size of the cache in KiB (rather than in pages).
+		
+		uint64_t kib = (target > 0) ? MAX(target / 1024, (uint64_t)1) : YAP_SQLITE_DEFAULT_CACHE_SIZE_KIB;
+		
+		NSString *pragma_cache_size =
+		  [NSString stringWithFormat:@"PRAGMA cache_size = -%llu;", (unsigned long long)kib];
+		
+		int status = sqlite3_exec(db, [pragma_cache_size UTF8String], NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error setting PRAGMA cache_size: %d %s", status, sqlite3_errmsg(db));
+			// This isn't critical, so we can continue.
+		}
+		
+		appliedPageCacheSize = target;
+	}
+	
+	int spill = pageCacheSpillEnabled ? 1 : 0;
+	if (spill != appliedPageCacheSpill)
+	{
+		const char *pragma_cache_spill = spill ? "PRAGMA cache_spill = ON;" : "PRAGMA cache_spill = OFF;";
+		
+		int status = sqlite3_exec(db, pragma_cache_spill, NULL, NULL, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error setting PRAGMA cache_spill: %d %s", status, sqlite3_errmsg(db));
+			// This isn't critical, so we can continue.
+		}
+		
+		appliedPageCacheSpill = spill;
+	}
+}
+
+/**
+ * Doubles the page cache (up to pageCacheMaximumSize) if the connection has been missing the cache often,
+ * while the cache is full. If the cache isn't full, the misses are pages being read for the first time,
+ * and a bigger cache wouldn't help.
+**/
+- (void)growPageCacheIfNeeded
+{
+	int current = 0;
+	int highwater = 0;
+	
+	// These are counted since the last sample (resetFlag).
+	
+	if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &current, &highwater, 1) == SQLITE_OK) {
+		adaptivePageCacheHits += (uint64_t)MAX(current, 0);
+	}
+	if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &current, &highwater, 1) == SQLITE_OK) {
+		adaptivePageCacheMisses += (uint64_t)MAX(current, 0);
+	}
+	
+	uint64_t lookups = adaptivePageCacheHits + adaptivePageCacheMisses;
+	if (lookups < YAP_ADAPTIVE_PAGE_CACHE_SAMPLE) return;
+	
+	double missRate = (double)adaptivePageCacheMisses / (double)lookups;
+	
+	adaptivePageCacheHits = 0;
+	adaptivePageCacheMisses = 0;
+	
+	if (missRate < YAP_ADAPTIVE_PAGE_CACHE_MISS_RATE) return;
+	
+	uint64_t size = appliedPageCacheSize;
+	if (size == 0 || size == UINT64_MAX) {
+		size = YAP_SQLITE_DEFAULT_CACHE_SIZE_KIB * 1024;
+	}
+	
+	if (size >= pageCacheMaximumSize) return;
+	
+	if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0) != SQLITE_OK) return;
+	if ((uint64_t)MAX(current, 0) < (size * 3 / 4)) return;
+	
+	adaptivePageCacheSize = MIN(size * 2, (uint64_t)pageCacheMaximumSize);
+}
+
+/**
+ * Returns the page cache to its regular size (undoing any adaptive growth).
+ * Invoked when flushing the internal memory of the connection.
+**/
+- (void)shrinkPageCache
+{
+	adaptivePageCacheHits = 0;
+	adaptivePageCacheMisses = 0;
+	
+	if (adaptivePageCacheSize == 0) return;
+	
+	adaptivePageCacheSize = 0;
+	[self applyPageCacheSettings];
+}
+
+- (void)preReadTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	// The long-lived read transaction is traced per block (see readWithBlock:), not for its entire lifetime.
+	if (transaction != longLivedReadTransaction)
+	{
+		[self beginWorkloadTraceWithReadWrite:NO];
+		transactionSignpost = YDBSignpostBegin("Read Transaction", "connection: %{public}@", _name);
+	}
+	
+	[self updateMMapSizeIfNeeded];
+	[self updatePageCacheSizeIfNeeded];
+	
+	if (readOnlyImmutable)
+	{
+		// The database is never modified, so our snapshot is always the latest one.
+		// And sqlite doesn't take any locks on an immutable file.
+		// Thus there's no state to sync with the other connections (or the checkpoint process).
+		
+		[transaction beginTransaction];
+		return;
+	}
+	
+	// Pre-Read-Transaction: Step 1 of 6
+	//
+	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
+	// Initialize the 'main_file', if we haven't already.
+	
+	if (main_file == NULL)
+	{
+		sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &main_file);
+		if (main_file) {
+			main_file->yap_database_connection = (__bridge void *)self;
+		}
+	}
+	
+	// Pre-Read-Transaction: Step 2 of 6
+	//
+	// Execute "BEGIN TRANSACTION" on database connection.
+	// This is actually a deferred transaction, meaning the sqlite connection won't actually
+	// acquire a shared read lock until it executes a select statement.
+	// There are alternatives to this, including a "begin immediate transaction".
+	// However, this doesn't do what we want. Instead it blocks other read-only transactions.
+	// The deferred transaction is actually what we want, as many read-only transactions only
+	// hit our in-memory caches. Thus we avoid sqlite machinery when unneeded.
+	
+	[transaction beginTransaction];
+	
+	__block uint64_t dbSnapshot = 0;
+	__block BOOL expectsChangesets = NO;
+	__block NSArray *changesets = nil;
+	
+	uint64_t snapshotQueueWaitTicks = mach_absolute_time();
+	YapDatabaseQueueWaitEvent *snapshotQueueWaitEvent =
+	  [self newQueueWaitEventForHolder:database->snapshotQueueHolder];
+	
+	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t snapshotQueueHoldTicks = [self didEnterSnapshotQueueSinceTicks:snapshotQueueWaitTicks
+		                                                                  event:snapshotQueueWaitEvent];
+		
+		// Pre-Read-Transaction: Step 3 of 6
+		//
+		// Update our connection state within the state table.
+		//
+		// First we need to mark this connection as being within a read-only transaction.
+		// We do this by marking a "yap-level" shared read lock flag.
+		//
+		// Now recall from step 1 that our "sql-level" transaction is deferred.
+		// The sql internals won't actually acquire the shared read lock until a we perform a select.
+		// If there are write transactions in progress, this is a big problem for us.
+		// Here's why:
+		//
+		// We have an in-memory snapshot via the caches.
+		// This is kept in-sync with what's on disk (in the sqlite database file).
+		// But what happens if the write transaction commits its changes before we perform our select statement?
+		// Our select statement would acquire a different snapshot than our in-memory snapshot.
+		// Thus, we look to see if there are any write transactions.
+		// If there are, then we immediately acquire the "sql-level" shared read lock.
+		
+		BOOL hasActiveWriteTransaction = NO;
+		YapDatabaseConnectionState *myState = nil;
+		
+		for (YapDatabaseConnectionState *state in database->connectionStates)
+		{
+			if (state->connection == self)
+			{
+				myState = state;
+				myState->activeReadTransaction = YES;
+			}
+			else if (state->activeWriteTransaction)
+			{
+				hasActiveWriteTransaction = YES;
+			}
+		}
+		
+		NSAssert(myState != nil, @"Missing state in database->connectionStates");
+		
+		// Pre-Read-Transaction: Step 4 of 5
+		//
+		// Compare our snapshot with the database's snapshot.
+		
+		if (hasActiveWriteTransaction || longLivedReadTransaction || wal_file == NULL || enableMultiProcessSupport)
+		{
+			// If there is a write transaction in progress,
+			// then it's not safe to proceed until we acquire a "sql-level" snapshot.
+			//
+			// If this is for a longLivedReadTransaction,
+			// then we need to immediately acquire a "sql-level" snapshot.
+			//
+			// If sqlite hasn't opened the wal_file yet,
+			// then we need to invoke the sql machinery so we can get access to it.
+			// We need the wal_file in order to properly receive notifications of
+			// when sqlite acquires an "sql-level" snapshot.
+			//
+			// In case of multiple processes accessing the database,
+			// we can't know for sure so we must make this assumption.
+			//
+			// During this process we ensure that our "yap-level" snapshot of the in-memory data (caches, etc)
+			// is in sync with our "sql-level" snapshot of the database.
+			//
+			// We can check this by comparing the connection's snapshot ivar with
+			// the snapshot read from disk (via sqlite select).
+			//
+			// If the two match then our snapshots are in sync.
+			// If they don't then we need to get caught up by processing changesets.
+			
+			dbSnapshot = [self readSnapshotFromDatabase];
+			if (wal_file == NULL)
+			{
+				wal_file = yap_vfs_last_opened_wal(database->yap_vfs_shim);
+				if (wal_file) {
+					wal_file->yap_database_connection = (__bridge void *)self;
+				}
+			}
+			
+			if (snapshot < dbSnapshot)
+			{
+				// The transaction can see the sqlite commit from another transaction,
+				// and it hasn't processed the changeset(s) yet.
+				// We need to fetch them now.
+				
+				expectsChangesets = YES;
+				
+				if (enableMultiProcessSupport) {
+					changesets = [database pendingAndCommittedChangesetsSince:snapshot until:dbSnapshot];
+				}
+			}
+			
+			myState->longLivedReadTransaction = (longLivedReadTransaction != nil);
+			myState->sqlLevelSharedReadLock = YES;
+			needsMarkSqlLevelSharedReadLock = NO;
+		}
+		else
+		{
+			// There is NOT a write transaction in progress.
+			// Thus we are safe to proceed with only a "yap-level" snapshot.
+			//
+			// However, we MUST ensure that our "yap-level" snapshot of the in-memory data (caches, etc)
+			// are in sync with the rest of the system.
+			//
+			// That is, our connection may have started its transaction before it was
+			// able to process a changeset from a sibling connection.
+			// If this is the case then we need to get caught up by processing the changeset(s).
+			
+			dbSnapshot = [database snapshot];
+			
+			if (snapshot < dbSnapshot)
+			{
+				// The transaction hasn't processed recent changeset(s) yet.
+				// We need to fetch them (outside the snapshotQueue).
+				
+				expectsChangesets = YES;
+			}
+			
+			myState->sqlLevelSharedReadLock = NO;
+			needsMarkSqlLevelSharedReadLock = YES;
+		}
+		
+		myState->lastTransactionSnapshot = dbSnapshot;
+		myState->lastTransactionTime = mach_absolute_time();
+		
+		[self willExitSnapshotQueueSinceTicks:snapshotQueueHoldTicks];
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	// Pre-Read-Transaction: Setp 5 of 6
+	//
+	// Update our in-memory data (caches, etc) if needed.
+	// Since this can be CPU intensive, we do this outside the snapshotQueue.
+	//
+	// The changesets are published lock-free, so we fetch them outside the snapshotQueue too.
+	// (They can't be dropped before we process them, as that requires our connectionQueue.)
+	
+	if (expectsChangesets && !enableMultiProcessSupport)
+	{
+		changesets = [database publishedChangesetsSince:snapshot until:dbSnapshot];
+	}
+	
+	if (expectsChangesets)
+	{
+		if (!changesets) // we could not retrieve changeset due to a change from another process.
+		{
+			NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
+			                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
+			
+			[self _flushMemoryWithFlags:flags];
+			snapshot = dbSnapshot;
+		}
+		else
+		{
+			isFastForwarding = YES;
+			[self noteCommittedChangesets:changesets];
+			isFastForwarding = NO;
+			
+			// The noteCommittedChangeset method (invoked above) updates our 'snapshot' variable.
+			NSAssert(snapshot == dbSnapshot,
+			         @"Invalid connection state in preReadTransaction: snapshot(%llu) != dbSnapshot(%llu): %@",
+			         snapshot, dbSnapshot, changesets);
+		}
+	}
+	
+	// Pre-Read-Transaction: Step 6 of 6
+	//
+	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
+	// Initialize the 'wal_file', if we haven't already.
+	
+	if (needsMarkSqlLevelSharedReadLock)
+	{
+		if (main_file)
+			main_file->xNotifyDidRead = yapNotifyDidRead;
+		
+		if (wal_file)
+			wal_file->xNotifyDidRead = yapNotifyDidRead;
+	}
+}
+
+/**
+ * This method executes the state transition steps required after executing a read-only transaction block.
+ *
+ * This method must be invoked from within the connectionQueue.
+**/
+- (void)postReadTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (transaction != longLivedReadTransaction)
+	{
+		[self endWorkloadTraceWithRollback:NO];
+		
+		YDBSignpostEnd(transactionSignpost, "Read Transaction");
+		transactionSignpost = 0;
+	}
+	
+	if (readOnlyImmutable)
+	{
+		// See preReadTransaction
+		
+		[transaction commitTransaction];
+		return;
+	}
+	
+	// Post-Read-Transaction: Step 1 of 5
+	//
+	// 1. Execute "COMMIT TRANSACTION" on database connection.
+	// If we had acquired "sql-level" shared read lock, this will release associated resources.
+	// It may also free the auto-checkpointing architecture within sqlite to sync the WAL to the database.
+	
+	[transaction commitTransaction];
+	
+	// Post-Read-Transaction: Step 2 of 5
+	//
+	// Disable sqlite VFS shim listeners for read notifications (if needed).
+	
+	if (main_file)
+		main_file->xNotifyDidRead = NULL;
+	
+	if (wal_file)
+		wal_file->xNotifyDidRead = NULL;
+	
+	
+	__block uint64_t minSnapshot = 0;
+	__block YapDatabaseConnectionState *writeStateToSignal = nil;
+	
+	// dispatch_sync: database->snapshotQueue
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// Post-Read-Transaction: Step 3 of 5
+		//
+		// Update our connection state within the state table.
+		//
+		// First we need to mark this connection as no longer being within a read-only transaction.
+		// We do this by unmarking the "yap-level" and "sql-level" shared read lock flags.
+		//
+		// While we're doing this we also check to see if we were possibly blocking a write transaction.
+		// When does a write transaction get blocked?
+		//
+		// Recall from the discussion above that we don't always acquire a "sql-level" shared read lock.
+		// Our sql transaction is deferred until our first select statement.
+		// Now if a write transaction comes along and discovers there are existing read transactions that
+		// have an in-memory metadata snapshot, but haven't acquired an "sql-level" snapshot of the actual
+		// database, it will block until these read transctions either complete,
+		// or acquire the needed "sql-level" snapshot.
+		//
+		// So if we never acquired an "sql-level" snapshot of the database, and we were the last transaction
+		// in such a state, and there's a blocked write transaction, then we need to signal it.
+		
+		minSnapshot = [database snapshot];
+		
+		BOOL wasMaybeBlockingWriteTransaction = NO;
+		NSUInteger countOtherMaybeBlockingWriteTransaction = 0;
+		YapDatabaseConnectionState *blockedWriteState = nil;
+		
+		for (YapDatabaseConnectionState *state in database->connectionStates)
+		{
+			if (state->connection == self)
+			{
+				state->activeReadTransaction = NO;
+				state->longLivedReadTransaction = NO;
+				
+				wasMaybeBlockingWriteTransaction = !state->sqlLevelSharedReadLock;
+				state->sqlLevelSharedReadLock = NO;
+			}
+			else if (state->activeReadTransaction)
+			{
+				// Active sibling connection: read-only
+				
+				minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
+				
+				if (!state->sqlLevelSharedReadLock)
+					countOtherMaybeBlockingWriteTransaction++;
+			}
+			else if (state->activeWriteTransaction)
+			{
+				// Active sibling connection: read-write
+				
+				minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
+				
+				if (state->waitingForWriteLock)
+					blockedWriteState = state;
+			}
+		}
+		
+		if (wasMaybeBlockingWriteTransaction && countOtherMaybeBlockingWriteTransaction == 0 && blockedWriteState)
+		{
+			writeStateToSignal = blockedWriteState;
+		}
+		
+		YDBLogVerbose(@"YapDatabaseConnection(%p) completing read-only transaction.", self);
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	// Edge case protection:
+	// This method may be called from dealloc.
+	// Which may, in turn, mean we're already in the snapshotQueue.
+	//
+	// @see Issue #437
+	// https://github.com/yapstudios/YapDatabase/issues/437
+	//
+	if (dispatch_get_specific(database->IsOnSnapshotQueueKey))
+		block();
+	else
+		dispatch_sync(database->snapshotQueue, block);
+	
+	// Post-Read-Transaction: Step 4 of 5
+	//
+	// Check to see if this connection has been holding back the checkpoint process.
+	// That is, was this connection the last active connection on an old snapshot?
+	
+	if (snapshot < minSnapshot)
+	{
+		// There are commits ahead of us that need to be checkpointed.
+		// And we were the oldest active connection,
+		// so we were previously preventing the checkpoint from progressing.
+		// Thus we can now continue the checkpoint operation.
+		
+		[database asyncCheckpoint:minSnapshot];
+		
+		[registeredMemoryTables enumerateKeysAndObjectsUsingBlock:^(id __unused key, id obj, BOOL __unused *stop) {
+			
+			[(YapMemoryTable *)obj asyncCheckpoint:minSnapshot];
+		}];
+		
+		[database->sharedObjectCache checkpoint:minSnapshot];
+	}
+	
+	// Post-Read-Transaction: Step 5 of 5
+	//
+	// If we discovered a blocked write transaction,
+	// and it was blocked waiting on us (because we had a "yap-level" snapshot without an "sql-level" snapshot),
+	// and it's no longer blocked on any other read transaction (that have "yap-level" snapshots
+	// without "sql-level snapshots"), then signal the write semaphore so the blocked thread wakes up.
+	
+	if (writeStateToSignal)
+	{
+		YDBLogVerbose(@"YapDatabaseConnection(%p) signaling blocked write on connection(%p)",
+		                                    self, writeStateToSignal->connection);
+		
+		[writeStateToSignal signalWriteLock];
+	}
+}
+
+/**
+ * This method executes the state transition steps required before executing a read-write transaction block.
+ * 
+ * This method must be invoked from within the connectionQueue.
+ * This method must be invoked from within the database.writeQueue.
+**/
+- (void)preReadWriteTransaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	if (readOnlyImmutable)
+	{
+		@throw [self readOnlyImmutableException];
+	}
+	
+	// Pre-Write-Transaction: Step 1 of 7
+	//
+	// Add IsOnConnectionQueueKey flag to writeQueue.
+	// This allows various methods that depend on the flag to operate correctly.
+	
+	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, IsOnConnectionQueueKey, NULL);
+	
+	[self beginTransactionMetrics];
+	[self beginWorkloadTraceWithReadWrite:YES];
+	
+	transactionSignpost = YDBSignpostBegin("ReadWrite Transaction", "connection: %{public}@", _name);
+	
+	// Pre-Write-Transaction: Step 2 of 7
+	//
+	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
+	// Initialize the 'main_file', if we haven't already.
+	// And adopt the latest mmap_size & cache_size (if configured).
+	
+	if (main_file == NULL)
+	{
+		sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &main_file);
+		if (main_file) {
+			main_file->yap_database_connection = (__bridge void *)self;
+		}
+	}
+	
+	[self updateMMapSizeIfNeeded];
+	[self updatePageCacheSizeIfNeeded];
+	
+	// Pre-Write-Transaction: Step 3 of 7
+	//
+	// Execute "BEGIN TRANSACTION" on database connection.
+	// This is actually a deferred transaction, meaning the sqlite connection won't actually
+	// acquire any locks until it executes something.
+	// There are various alternatives to this, including "immediate" and "exclusive" transactions.
+	// However, these don't do what we want. Instead they block other read-only transactions.
+	// The deferred transaction allows other read-only transactions and even avoids
+	// sqlite operations if no modifications are made.
+	//
+	// Remember, we are the only active write transaction for this database.
+	// No other write transactions can occur until this transaction completes.
+	// Thus no other transactions can possibly modify the database during our transaction.
+	// Therefore it doesn't matter when we acquire our "sql-level" locks for writing.
+	
+	if (enableMultiProcessSupport) {
+		// In the multiprocess case, we don't use a deferred transaction in order to avoid race conditions
+		[transaction beginImmediateTransaction];
+	} else {
+		[transaction beginTransaction];
+	}
+	
+	__block uint64_t dbSnapshot = 0;
+	__block BOOL expectsChangesets = NO;
+	__block NSArray *changesets = nil;
+	
+	uint64_t snapshotQueueWaitTicks = mach_absolute_time();
+	YapDatabaseQueueWaitEvent *snapshotQueueWaitEvent =
+	  [self newQueueWaitEventForHolder:database->snapshotQueueHolder];
+	
+	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t snapshotQueueHoldTicks = [self didEnterSnapshotQueueSinceTicks:snapshotQueueWaitTicks
+		                                                                  event:snapshotQueueWaitEvent];
+		
+		// Pre-Write-Transaction: Step 4 of 7
+		//
+		// Update our connection state within the state table.
+		//
+		// We are the only write transaction for this database.
+		// It is important for read-only transactions on other connections to know there's a writer.
+		
+		YapDatabaseConnectionState *myState = nil;
+		
+		for (YapDatabaseConnectionState *state in database->connectionStates)
+		{
+			if (state->connection == self)
+			{
+				myState = state;
+				myState->activeWriteTransaction = YES;
+			}
+		}
+		
+		NSAssert(myState != nil, @"Missing state in database->connectionStates");
+		
+		// Pre-Write-Transaction: Step 5 of 7
+		//
+		// Compare our snapshot with the database's snapshot.
+		
+		// In multiprocess mode, the snapshot number might have been externally updated
+		if (wal_file == NULL || enableMultiProcessSupport)
+		{
+			// If sqlite hasn't opened the wal_file yet,
+			// then we need to invoke the sql machinery so we can get access to it.
+			// We need the wal_file in order to properly receive notifications of
+			// when sqlite acquires an "sql-level" snapshot.
+			//
+			// In case of multiple processes accessing the database,
+			// we can't know for sure so we must make this assumption.
+			
+			if (enableMultiProcessSupport)
+			{
+				// We hold the sqlite write lock (immediate transaction).
+				// So if the shared snapshot is clean, it's the latest commit (from any process),
+				// and we can skip the query.
+				
+				yap_shared_snapshot *shared = database->sharedSnapshot;
+				
+				if (wal_file == NULL || !yap_shared_snapshot_get(shared, &dbSnapshot))
+				{
+					dbSnapshot = [self readSnapshotFromDatabase];
+					yap_shared_snapshot_set(shared, dbSnapshot);
+				}
+			}
+			else
+			{
+				(void)[self readSnapshotFromDatabase]; // create wal_file
+				dbSnapshot = [database snapshot];
+			}
+			
+			if (wal_file == NULL)
+			{
+				wal_file = yap_vfs_last_opened_wal(database->yap_vfs_shim);
+				if (wal_file) {
+					wal_file->yap_database_connection = (__bridge void *)self;
+				}
+			}
+		}
+		else
+		{
+			// We can just grab the snapshot from YapDatabase's in-memory version.
+			
+			dbSnapshot = [database snapshot];
+		}
+		
+		if (snapshot < dbSnapshot)
+		{
+			// The transaction hasn't processed recent changeset(s) yet.
+			// We need to fetch them now.
+			
+			expectsChangesets = YES;
+			
+			if (enableMultiProcessSupport) {
+				changesets = [database pendingAndCommittedChangesetsSince:snapshot until:dbSnapshot];
+			}
+		}
+		
+		myState->lastTransactionSnapshot = dbSnapshot;
+		myState->lastTransactionTime = mach_absolute_time();
+		needsMarkSqlLevelSharedReadLock = NO;
+		
+		YDBLogVerbose(@"YapDatabaseConnection(%p) starting read-write transaction.", self);
+		
+		[self willExitSnapshotQueueSinceTicks:snapshotQueueHoldTicks];
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	// Pre-Write-Transaction: Step 6 of 7
+	//
+	// Update our in-memory data (caches, etc) if needed.
+	// Since this can be CPU intensive, we do this outside the snapshotQueue.
+	//
+	// As with read transactions, the changesets are fetched outside the snapshotQueue.
+	
+	if (expectsChangesets && !enableMultiProcessSupport)
+	{
+		changesets = [database publishedChangesetsSince:snapshot until:dbSnapshot];
+	}
+	
+	if (expectsChangesets)
+	{
+		externallyModified = (changesets == nil);
+		
+		if (!changesets) // we could not retrieve changeset due to a change from another process.
+		{
+			NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
+			                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
+			
+			[self _flushMemoryWithFlags:flags];
+			snapshot = dbSnapshot;
+		}
+		else
+		{
+			isFastForwarding = YES;
+			[self noteCommittedChangesets:changesets];
+			isFastForwarding = NO;
+			
+			// The noteCommittedChangeset method (invoked above) updates our 'snapshot' variable.
+			NSAssert(snapshot == dbSnapshot,
+			         @"Invalid connection state in preReadWriteTransaction: snapshot(%llu) != dbSnapshot(%llu)",
+			         snapshot, dbSnapshot);
+		}
+	}
+	else
+	{
+		externallyModified = NO;
+	}
+	
+	// Pre-Write-Transaction: Step 7 of 7
+	//
+	// Setup write state and changeset variables
+	
+	hasDiskChanges = NO;
+	
+	if (objectChanges == nil)
+		objectChanges = [[NSMutableDictionary alloc] init];
+	
+	if (metadataChanges == nil)
+		metadataChanges = [[NSMutableDictionary alloc] init];
+	
+	if (insertedKeys == nil)
+		insertedKeys = [[NSMutableSet alloc] init];
+	
+	if (removedKeys == nil)
+		removedKeys = [[NSMutableSet alloc] init];
+	
+	if (removedCollections == nil)
+		removedCollections = [[NSMutableSet alloc] init];
+	
+	if (resetCollections == nil)
+		resetCollections = [[NSMutableSet alloc] init];
+	
+	if (removedRowids == NULL)
+		removedRowids = YapRowidSetCreate(0);
+	
+	allKeysRemoved = NO;
+	
+	if (mutationStack == nil)
+		mutationStack = [[YapMutationStack_Bool alloc] init];
+	
+	if (transactionMetrics) {
+		transactionMetrics->blockStartTime = mach_absolute_time();
+	}
+}
+
+/**
+ * This method executes the state transition steps required after executing a read-only transaction block.
+ *
+ * This method must be invoked from within the connectionQueue.
+ * This method must be invoked from within the database.writeQueue.
+**/
+- (void)postReadWriteTransaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	YapDatabaseTransactionMetrics *metrics = transactionMetrics;
+	uint64_t metricsTime = 0;
+	
+	if (metrics) {
+		metrics->blockTicks = YapDatabaseTransactionMetricsElapsed(metrics->blockStartTime);
+	}
+	
+	if (transaction->rollback)
+	{
+		YDBLogVerbose(@"YapDatabaseConnection(%p) rollback read-write transaction", self);
+		
+		// Any collection_id's we inserted during the transaction have been rolled back too.
+		
+		[collectionIds removeAllObjects];
+		
+		// Rollback-Write-Transaction: Step 1 of 3
+		//
+		// Update our connection state within the state table.
+		//
+		// We are the only write transaction for this database.
+		// It is important for read-only transactions on other connections to know we're no longer a writer.
+		
+		dispatch_sync(database->snapshotQueue, ^{
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			for (YapDatabaseConnectionState *state in database->connectionStates)
+			{
+				if (state->connection == self)
+				{
+					state->activeWriteTransaction = NO;
+					break;
+				}
+			}
+			
+		#pragma clang diagnostic pop
+		});
+		
+		// Rollback-Write-Transaction: Step 2 of 3
+		//
+		// Rollback sqlite database transaction.
+		
+		metricsTime = YapDatabaseTransactionMetricsStart(metrics);
+		
+		[transaction rollbackTransaction];
+		
+		lastTotalChanges = sqlite3_total_changes(db); // rolled back changes don't count
+		
+		if (metrics)
+		{
+			metrics->didRollback = YES;
+			metrics->commitTicks = YapDatabaseTransactionMetricsElapsed(metricsTime);
+		}
+		
+		if (transaction->createdExternalBlobs)
+		{
+			// None of the rows referencing these files made it into the database.
+			
+			[database deleteExternalBlobsWithFileNames:transaction->createdExternalBlobs];
+		}
+		
+		if (transaction->createdColdBlobs)
+		{
+			[database deleteColdBlobsWithIds:transaction->createdColdBlobs];
+		}
+		
+		// Rollback-Write-Transaction: Step 3 of 3
+		//
+		// Reset any in-memory variables which may be out-of-sync with the database.
+		
+		[objectCache removeAllObjects];
+		[metadataCache removeAllObjects];
+		
+	}
+	else // if (!transaction->rollback)
+	{
+		// Post-Write-Transaction: Step 1 of 11
+		//
+		// Run any pre-commit operations.
+		// This allows extensions to to perform any cleanup before the changeset is requested.
+		
+		metricsTime = YapDatabaseTransactionMetricsStart(metrics);
+		
+		[transaction preCommitReadWriteTransaction];
+		
+		if (metrics) {
+			metrics->preCommitTicks = YapDatabaseTransactionMetricsElapsed(metricsTime);
+		}
+		
+		// Post-Write-Transaction: Step 2 of 11
+		//
+		// Fetch changesets.
+		// Then update the snapshot in the 'yap' database (if any changes were made).
+		// We use 'yap' database and snapshot value to check for a race condition.
+		//
+		// The "internal" changeset gets sent directly to sibling database connections.
+		// The "external" changeset gets plugged into the YapDatabaseModifiedNotification as the userInfo dict.
+		
+		NSNotification *notification = nil;
+		
+		NSMutableDictionary *changeset = nil;
+		NSMutableDictionary *userInfo = nil;
+		uint64_t sharedSnapshotBeforeCommit = 0;
+		BOOL needsSharedSnapshotCommit = NO;
+		
+		metricsTime = YapDatabaseTransactionMetricsStart(metrics);
+		
+		if (transaction->coarseChangeset || transaction->changesetSpilled)
+		{
+			[self coarsenChangeset];
+		}
+		
+		[self getInternalChangeset:&changeset externalChangeset:&userInfo];
+		if (changeset || userInfo || hasDiskChanges)
+		{
+			// If hasDiskChanges is YES, then the database file was modified.
+			// In this case, we're sure to write the incremented snapshot number to the database.
+			//
+			// If hasDiskChanges is NO, then the database file was not modified.
+			// However, something was "touched" or an in-memory extension was changed.
+			
+			if (enableMultiProcessSupport)
+			{
+				// Other processes must not trust the shared snapshot until we've committed.
+				sharedSnapshotBeforeCommit = snapshot;
+				needsSharedSnapshotCommit = YES;
+				yap_shared_snapshot_will_commit(database->sharedSnapshot, snapshot);
+			}
+			
+			if (hasDiskChanges || enableMultiProcessSupport)
+				snapshot = [self incrementSnapshotInDatabase];
+			else
+				snapshot++;
+			
+			if (changeset == nil)
+				changeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+			
+			if (userInfo == nil)
+				userInfo = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
+			
+			[changeset setObject:@(snapshot) forKey:YapDatabaseSnapshotKey];
+			[userInfo setObject:@(snapshot) forKey:YapDatabaseSnapshotKey];
+			
+			[userInfo setObject:self forKey:YapDatabaseConnectionKey];
+		
+			if (externallyModified)
+				[changeset setObject:@(externallyModified) forKey:YapDatabaseModifiedExternallyKey];
+			
+			if (transaction->customObjectForNotification)
+				[userInfo setObject:transaction->customObjectForNotification forKey:YapDatabaseCustomKey];
+			
+			notification = [NSNotification notificationWithName:YapDatabaseModifiedNotification
+			                                             object:database
+			                                           userInfo:userInfo];
+			
+			[changeset setObject:notification forKey:YapDatabaseNotificationKey];
+		}
+		
+		if (metrics) {
+			metrics->changesetTicks += YapDatabaseTransactionMetricsElapsed(metricsTime);
+		}
+		
+		// Post-Write-Transaction: Step 3 of 11
+		//
+		// Auto-drop tables from previous extensions that aren't being used anymore.
+		//
+		// Note the timing of when this happens:
+		// - Only once
+		// - At the end of a readwrite transaction that has made modifications to the database
+		// - Only if the modifications weren't dedicated to registering/unregistring an extension
+		
+		BOOL clearPreviouslyRegisteredExtensionNames = NO;
+		
+		if (changeset && !registeredExtensionsChanged && database->previouslyRegisteredExtensionNames)
+		{
+			for (NSString *prevExtensionName in database->previouslyRegisteredExtensionNames)
+			{
+				if ([registeredExtensions objectForKey:prevExtensionName] == nil)
+				{
+					[self _unregisterExtensionWithName:prevExtensionName transaction:transaction];
+				}
+			}
+			
+			clearPreviouslyRegisteredExtensionNames = YES;
+		}
+		
+		// Post-Write-Transaction: Step 4 of 11
+		//
+		// Check to see if it's safe to commit our changes.
+		//
+		// There may be read-only transactions that have acquired "yap-level" snapshots
+		// without "sql-level" snapshots. That is, these read-only transaction may have a snapshot
+		// of the in-memory metadata dictionary at the time they started, but as for the sqlite connection
+		// they only have a "BEGIN DEFERRED TRANSACTION", and haven't actually executed
+		// any "select" statements. Thus they haven't actually invoked the sqlite machinery to
+		// acquire the "sql-level" snapshot (last valid commit record in the WAL).
+		//
+		// It is our responsibility to block until all read-only transactions have either completed,
+		// or have acquired the necessary "sql-level" shared read lock.
+		//
+		// We avoid writer starvation by enforcing new read-only transactions that start after our writer
+		// started to immediately acquire "sql-level" shared read locks when they start.
+		// Thus we would only ever wait for read-only transactions that started before our
+		// read-write transaction started. And since most of the time the read-write transactions
+		// take longer than read-only transactions, we avoid any blocking in most cases.
+		
+		__block YapDatabaseConnectionState *myState = nil;
+		__block BOOL safeToCommit = NO;
+		
+		do
+		{
+			__block BOOL waitForReadOnlyTransactions = NO;
+			
+			uint64_t snapshotQueueWaitTicks = mach_absolute_time();
+			YapDatabaseQueueWaitEvent *snapshotQueueWaitEvent =
+			  [self newQueueWaitEventForHolder:database->snapshotQueueHolder];
+			
+			dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+			#pragma clang diagnostic push
+			#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+				
+				uint64_t snapshotQueueHoldTicks = [self didEnterSnapshotQueueSinceTicks:snapshotQueueWaitTicks
+				                                                                  event:snapshotQueueWaitEvent];
+				
+				for (YapDatabaseConnectionState *state in database->connectionStates)
+				{
+					if (state->connection == self)
+					{
+						myState = state;
+					}
+					else if (state->activeReadTransaction && !state->sqlLevelSharedReadLock)
+					{
+						waitForReadOnlyTransactions = YES;
+					}
+				}
+				
+				NSAssert(myState != nil, @"Missing state in database->connectionStates");
+				
+				if (waitForReadOnlyTransactions)
+				{
+					myState->waitingForWriteLock = YES;
+					[myState prepareWriteLock];
+				}
+				else
+				{
+					myState->waitingForWriteLock = NO;
+					safeToCommit = YES;
+					
+					// Post-Write-Transaction: Step 5 of 11
+					//
+					// Register pending changeset with database.
+					// Our commit is actually a two step process.
+					// First we execute the sqlite level commit.
+					// Second we execute the final stages of the yap level commit.
+					//
+					// This two step process means we have an edge case,
+					// where another connection could come around and begin its yap level transaction
+					// before this connection's yap level commit, but after this connection's sqlite level commit.
+					//
+					// By registering the pending changeset in advance,
+					// we provide a near seamless workaround for the edge case.
+					
+					if (changeset)
+					{
+						[database notePendingChangeset:changeset fromConnection:self];
+					}
+					
+					if (clearPreviouslyRegisteredExtensionNames)
+					{
+						// It's only safe to clear this ivar within the snapshot queue
+						database->previouslyRegisteredExtensionNames = nil;
+					}
+				}
+				
+				[self willExitSnapshotQueueSinceTicks:snapshotQueueHoldTicks];
+				
+			#pragma clang diagnostic pop
+			}});
+		
+			if (waitForReadOnlyTransactions)
+			{
+				// Block until a read-only transaction signals us.
+				// This will occur when the last read-only transaction (that started before our read-write
+				// transaction started) either completes or acquires an "sql-level" shared read lock.
+				//
+				// Note: Since we're using a dispatch semaphore, order doesn't matter.
+				// That is, it's fine if the read-only transaction signals our write lock before we start waiting on it.
+				// In this case we simply return immediately from the wait call.
+				
+				YDBLogVerbose(@"YapDatabaseConnection(%p) blocked waiting for write lock...", self);
+				
+				metricsTime = YapDatabaseTransactionMetricsStart(metrics);
+				
+				[myState waitForWriteLock];
+				
+				if (metrics) {
+					metrics->writeLockWaitTicks += YapDatabaseTransactionMetricsElapsed(metricsTime);
+				}
+			}
+			
+		} while (!safeToCommit);
+	
+		// Post-Write-Transaction: Step 6 of 11
+		//
+		// Execute "COMMIT TRANSACTION" on database connection.
+		// This will write the changes to the WAL, and may invoke a checkpoint.
+		//
+		// Notice that we do this outside the context of the transactionStateQueue.
+		// We do this so we don't block read-only transactions from starting or finishing.
+		// However, this does leave us open for the possibility that a read-only transaction will
+		// get a "yap-level" snapshot of the metadata dictionary before this commit,
+		// but a "sql-level" snapshot of the sql database after this commit.
+		// This is rare but must be guarded against.
+		// The solution is pretty simple and straight-forward.
+		// When a read-only transaction starts, if there's an active write transaction,
+		// it immediately acquires an "sql-level" snapshot. It does this by invoking a select statement,
+		// which invokes the internal sqlite snapshot machinery for the transaction.
+		// So rather than using a dummy select statement that we ignore, we instead select a lastCommit number
+		// from the database. If it doesn't match what we expect, then we know we've run into the race condition,
+		// and we make the read-only transaction back out and try again.
+		
+		metricsTime = YapDatabaseTransactionMetricsStart(metrics);
+		
+		if (needsSharedSnapshotCommit)
+		{
+			// Other processes use the summary of our changeset to update their caches (instead of flushing them).
+			[database willCommitSharedChangeset:changeset];
+		}
+		
+		YDBSignpostID commitSignpost = YDBSignpostBegin("Commit", "snapshot: %llu", snapshot);
+		
+		BOOL didCommit = [transaction commitTransaction];
+		
+		YDBSignpostEnd(commitSignpost, "Commit", "success: %d", (int)didCommit);
+		
+		if (metrics) {
+			metrics->commitTicks = YapDatabaseTransactionMetricsElapsed(metricsTime);
+		}
+		
+		if (needsSharedSnapshotCommit)
+		{
+			yap_shared_snapshot_did_commit(database->sharedSnapshot,
+			                               sharedSnapshotBeforeCommit, (didCommit ? snapshot : 0));
+			
+			[database didCommitSharedChangeset:changeset success:didCommit];
+		}
+		
+		if (didCommit)
+		{
+			// Externally stored (and cold) objects that are no longer referenced can be deleted
+			// once every connection has moved past this commit (see asyncCheckpoint below).
+			
+			if (transaction->externalBlobGarbage) {
+				[database noteUnreferencedExternalBlobs:transaction->externalBlobGarbage atSnapshot:snapshot];
+			}
+			if (transaction->coldBlobGarbage) {
+				[database noteUnreferencedColdBlobs:transaction->coldBlobGarbage atSnapshot:snapshot];
+			}
+			
+			// Keep track of the number of changed rows, so the tables get analyzed as they grow.
+			
+			int totalChanges = sqlite3_total_changes(db);
+			if (totalChanges > lastTotalChanges) {
+				[database noteCommittedRowChanges:(uint64_t)(totalChanges - lastTotalChanges)];
+			}
+		}
+		else
+		{
+			// The yap2 values flushed during pre-commit were applied to our cache, but never made it into the database.
+			
+			[extensionValuesCache removeAllObjects];
+			
+			if (transaction->createdExternalBlobs) {
+				[database deleteExternalBlobsWithFileNames:transaction->createdExternalBlobs];
+			}
+			if (transaction->createdColdBlobs) {
+				[database deleteColdBlobsWithIds:transaction->createdColdBlobs];
+			}
+		}
+		
+		lastTotalChanges = sqlite3_total_changes(db);
+		
+		__block uint64_t minSnapshot = UINT64_MAX;
+	
+		uint64_t snapshotQueueWaitTicks = mach_absolute_time();
+		YapDatabaseQueueWaitEvent *snapshotQueueWaitEvent =
+		  [self newQueueWaitEventForHolder:database->snapshotQueueHolder];
+		
+		dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			uint64_t snapshotQueueHoldTicks = [self didEnterSnapshotQueueSinceTicks:snapshotQueueWaitTicks
+			                                                                  event:snapshotQueueWaitEvent];
+			
+			// Post-Write-Transaction: Step 7 of 11
+			//
+			// Notify database of changes, and drop reference to set of changed keys.
+			
+			if (changeset)
+			{
+				uint64_t noteTime = YapDatabaseTransactionMetricsStart(metrics);
+				
+				[database noteCommittedChangeset:changeset fromConnection:self];
+				
+				if (metrics) {
+					metrics->changesetTicks += YapDatabaseTransactionMetricsElapsed(noteTime);
+				}
+			}
+			
+			// Post-Write-Transaction: Step 8 of 11
+			//
+			// Update our connection state within the state table.
+			//
+			// We are the only write transaction for this database.
+			// It is important for read-only transactions on other connections to know we're no longer a writer.
+			
+			for (YapDatabaseConnectionState *state in database->connectionStates)
+			{
+				if (state->activeReadTransaction)
+				{
+					minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
+				}
+			}
+			
+			myState->activeWriteTransaction = NO;
+			myState->waitingForWriteLock = NO;
+			
+			YDBLogVerbose(@"YapDatabaseConnection(%p) completing read-write transaction.", self);
+			
+			[self willExitSnapshotQueueSinceTicks:snapshotQueueHoldTicks];
+			
+		#pragma clang diagnostic pop
+		}});
+	
+		if (changeset)
+		{
+			// Post-Write-Transaction: Step 9 of 11
+			//
+			// We added frames to the WAL.
+			// We can invoke a checkpoint if there are no other active connections.
+			
+			if (minSnapshot == UINT64_MAX)
+			{
+				[database asyncCheckpoint:snapshot];
+				
+				[registeredMemoryTables enumerateKeysAndObjectsUsingBlock:
+				    ^(id __unused key, YapMemoryTable *memoryTable, BOOL __unused *stop)
+				{
+				#pragma clang diagnostic push
+				#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+					
+					[memoryTable asyncCheckpoint:snapshot];
+					
+				#pragma clang diagnostic pop
+				}];
+				
+				[database->sharedObjectCache checkpoint:snapshot];
+			}
+		}
+	
+		// Post-Write-Transaction: Step 10 of 11
+		//
+		// If the WAL has gotten too big, then we perform a checkpoint right away.
+		// We purposefuly do this BEFORE posting the notification.
+		
+		if ([database aggressiveCheckpointEnabled])
+		{
+			int totalFrameCount = 0;
+			int checkpointedFrameCount = 0;
+			
+			metricsTime = YapDatabaseTransactionMetricsStart(metrics);
+			YDBSignpostID checkpointSignpost = YDBSignpostBegin("Checkpoint", "mode: %{public}s", "passive");
+			
+			int checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE,
+			                                                 &totalFrameCount, &checkpointedFrameCount);
+			
+			YDBSignpostEnd(checkpointSignpost, "Checkpoint");
+			
+			if (metrics) {
+				metrics->checkpointTicks = YapDatabaseTransactionMetricsElapsed(metricsTime);
+			}
+			
+			YDBLogInfo(@"Post-checkpoint: src(d) mode(passive) result(%d) frames(%d) checkpointed(%d)",
+			           checkpointResult, totalFrameCount, checkpointedFrameCount);
+
+			
+			if (checkpointResult == SQLITE_OK)
+			{
+				[database noteCheckpointWithTotalFrames:totalFrameCount checkpointedFrames:checkpointedFrameCount];
+			}
+		}
+		
+		// Post-Write-Transaction: Step 11 of 11
+		//
+		// Post YapDatabaseModifiedNotification (if needed)
+		
+		if (notification)
+		{
+			YapDatabase *_database = database;
+			
+			dispatch_async(dispatch_get_main_queue(), ^{
+				[[NSNotificationCenter defaultCenter] postNotification:notification];
+				[_database coalesceModifiedNotification:notification];
+			});
+		}
+	
+	} // end else if (!transaction->rollback)
+	
+	
+	// Clear changeset variables (which are now a part of the notification)
+	
+	if ([objectChanges count] > 0)
+		objectChanges = nil;
+	
+	if ([metadataChanges count] > 0)
+		metadataChanges = nil;
+	
+	if ([insertedKeys count] > 0)
+		insertedKeys = nil;
+	
+	if ([removedKeys count] > 0)
+		removedKeys = nil;
+	
+	if ([removedCollections count] > 0)
+		removedCollections = nil;
+	
+	if ([resetCollections count] > 0)
+		resetCollections = nil;
+	
+	changedExtensionValues = nil;
+	
+	if (removedRowids)
+		YapRowidSetRemoveAll(removedRowids);
+	
+	[mutationStack clear];
+	
+	[self endTransactionMetrics];
+	[self endWorkloadTraceWithRollback:transaction->rollback];
+	
+	YDBSignpostEnd(transactionSignpost, "ReadWrite Transaction", "rollback: %d", (int)transaction->rollback);
+	transactionSignpost = 0;
+	
+	// Drop IsOnConnectionQueueKey flag from writeQueue since we're exiting writeQueue.
+	
+	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, NULL, NULL);
+}
+
+/**
+ * This method executes the state transition steps required before executing a pseudo read-write transaction.
+ *
+ * This method must be invoked from within the connectionQueue.
+ * This method must be invoked from within the database.writeQueue.
+**/
+- (void)prePseudoReadWriteTransaction
+{
+	if (readOnlyImmutable)
+	{
+		@throw [self readOnlyImmutableException];
+	}
+	
+	// This is similar to a read-write transaction,
+	// in that we intend to block other writers (go through the writeQueue).
+	//
+	// However, our operation cannot occur within a transaction. (no "BEGIN TRANSCTION;" or "COMMIT TRANSACTION;")
+	// Thus we cannot simply use preReadWriteTransaction & postReadWriteTransaction.
+	// Instead we use a select subset of them.
+	
+	// Pre-Pseudo-Write-Transaction: Step 1 of 5
+	//
+	// Add IsOnConnectionQueueKey flag to writeQueue.
+	// This allows various methods that depend on the flag to operate correctly.
+	
+	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, IsOnConnectionQueueKey, NULL);
+	
+	// Pre-Pseudo-Write-Transaction: Step 2 of 5
+	//
+	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
+	// Initialize the 'main_file', if we haven't already.
+	
+	if (main_file == NULL)
+	{
+		sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &main_file);
+		if (main_file) {
+			main_file->yap_database_connection = (__bridge void *)self;
+		}
+	}
+	
+	// Pre-Pseudo-Write-Transaction: Step 3 of 5
+	//
+	// Update our connection state within the state table.
+	//
+	// We are the only write transaction for this database.
+	// It is important for read-only transactions on other connections to know there's a writer.
+	
+	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		YapDatabaseConnectionState *myState = nil;
+		
+		for (YapDatabaseConnectionState *state in database->connectionStates)
+		{
+			if (state->connection == self)
+			{
+				myState = state;
+				myState->activeWriteTransaction = YES;
+			}
+		}
+		
+		NSAssert(myState != nil, @"Missing state in database->connectionStates");
+		
+		// Pre-Pseudo-Write-Transaction: Step 4 of 5
+		//
+		// Prep work: sqlite VFS shim listeners for read notifications (if needed).
+		// Initialize the 'wal_file', if we haven't already.
+		
+		if (wal_file == NULL)
+		{
+			// If sqlite hasn't opened the wal_file yet,
+			// then we need to invoke the sql machinery so we can get access to it.
+			// We need the wal_file in order to properly receive notifications of
+			// when sqlite acquires an "sql-level" snapshot.
+			
+			(void)[self readSnapshotFromDatabase];
+			
+			wal_file = yap_vfs_last_opened_wal(database->yap_vfs_shim);
+			if (wal_file) {
+				wal_file->yap_database_connection = (__bridge void *)self;
+			}
+		}
+		
+		myState->lastTransactionSnapshot = [database snapshot];
+		myState->lastTransactionTime = mach_absolute_time();
+		needsMarkSqlLevelSharedReadLock = YES;
+		
+		YDBLogVerbose(@"YapDatabaseConnection(%p) starting vacuum operation.", self);
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	// Pre-Pseudo-Write-Transaction: Step 5 of 5
+	//
+	// Setup write state and changeset variables.
+	
+	hasDiskChanges = NO;
+	
+	// Note: We don't need to setup all changeset variables.
+}
+
+/**
+ * This method executes the state transition steps required after executing a pseudo read-write transaction.
+ *
+ * This method must be invoked from within the connectionQueue.
+ * This method must be invoked from within the database.writeQueue.
+**/
+- (void)postPseudoReadWriteTransaction
+{
+	// This is similar to a read-write transaction,
+	// in that we intend to block other writers (go through the writeQueue).
+	//
+	// However, our operation cannot occur within a transaction. (no "BEGIN TRANSCTION;" or "COMMIT TRANSACTION;")
+	// Thus we cannot simply use preReadWriteTransaction & postReadWriteTransaction.
+	// Instead we use a select subset of them.
+	
+	// Post-Pseudo-Write-Transaction: Step 1 of 5
+	//
+	// Create changeset.
+	// We're doing this in order to increment the snapshot.
+	
+	NSMutableDictionary *changeset = nil;
+	NSMutableDictionary *userInfo = nil;
+	
+	NSNotification *notification = nil;
+	
+	if (hasDiskChanges)
+	{
+		snapshot++;
+		
+		changeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+		userInfo = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
+		
+		changeset[YapDatabaseSnapshotKey] = @(snapshot);
+		userInfo[YapDatabaseSnapshotKey] = @(snapshot);
+		
+		userInfo[YapDatabaseConnectionKey] = self;
+		
+		notification = [NSNotification notificationWithName:YapDatabaseModifiedNotification
+		                                             object:database
+		                                           userInfo:userInfo];
+		
+		changeset[YapDatabaseNotificationKey] = notification;
+	}
+	
+	__block YapDatabaseConnectionState *myState = nil;
+	__block uint64_t minSnapshot = UINT64_MAX;
+	
+	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// Post-Pseudo-Write-Transaction: Step 2 of 5
+		//
+		// Notify database of changes, and drop reference to set of changed keys.
+		
+		if (changeset)
+		{
+			[database notePendingChangeset:changeset fromConnection:self];
+			[database noteCommittedChangeset:changeset fromConnection:self];
+		}
+		
+		// Post-Pseudo-Write-Transaction: Step 3 of 5
+		//
+		// Update our connection state within the state table.
+		//
+		// We are the only write transaction for this database.
+		// It is important for read-only transactions on other connections to know we're no longer a writer.
+		
+		for (YapDatabaseConnectionState *state in database->connectionStates)
+		{
+			if (state->connection == self)
+			{
+				myState = state;
+			}
+			else if (state->activeReadTransaction)
+			{
+				minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
+			}
+		}
+		
+		NSAssert(myState != nil, @"Missing state in database->connectionStates");
+		
+		myState->activeWriteTransaction = NO;
+		myState->waitingForWriteLock = NO;
+		
+		YDBLogVerbose(@"YapDatabaseConnection(%p) completing read-write transaction.", self);
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	if (changeset)
+	{
+		// Post-Pseudo-Write-Transaction: Step 4 of 5
+		//
+		// We added frames to the WAL.
+		// We can invoke a checkpoint if there are no other active connections.
+		
+		if (minSnapshot == UINT64_MAX)
+		{
+			[database asyncCheckpoint:snapshot];
+			
+			// Note: We didn't actually change anything in the database.
+			// The vacuum operation just defragments the database file.
+			//
+			// So there's no need to do anything concerning registeredMemoryTables.
+		}
+	}
+	
+	// Post-Pseudo-Write-Transaction: Step 5 of 5
+	//
+	// Drop IsOnConnectionQueueKey flag from writeQueue since we're exiting writeQueue.
+	
+	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, NULL, NULL);
+}
+
+/**
+ * This method "kills two birds with one stone".
+ * 
+ * First, it invokes a SELECT statement on the database.
+ * This executes the sqlite machinery to acquire a "sql-level" snapshot of the database.
+ * That is, the encompassing transaction will now reference a specific commit record in the WAL,
+ * and will ignore any commits made after this record.
+ * 
+ * Second, it reads a specific value from the database, and tells us which commit record in the WAL its using.
+ * This allows us to validate the transaction, and check for a particular race condition.
+**/
+- (uint64_t)readSnapshotFromDatabase
+{
+	sqlite3_stmt *statement = [self yapGetDataForKeyStatement];
+	if (statement == NULL) return 0;
+	
+	uint64_t result = 0;
+	
+	// SELECT data FROM 'yap2' WHERE extension = ? AND key = ? ;
+	
+	int const bind_idx_extension = SQLITE_BIND_START + 0;
+	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	
+	const char *extension = "";
+	sqlite3_bind_text(statement, bind_idx_extension, extension, (int)strlen(extension), SQLITE_STATIC);
+	
+	const char *key = "snapshot";
+	sqlite3_bind_text(statement, bind_idx_key, key, (int)strlen(key), SQLITE_STATIC);
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		result = (uint64_t)sqlite3_column_int64(statement, SQLITE_COLUMN_START);
+	}
+	else if (status == SQLITE_ERROR)
+	{
+		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s",
+		                                                       status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return result;
+}
+
+/**
+ * This method updates the 'snapshot' row in the database.
+**/
+- (uint64_t)incrementSnapshotInDatabase
+{
+	uint64_t newSnapshot = snapshot + 1;
+	
+	sqlite3_stmt *statement = [self yapSetDataForKeyStatement];
+	if (statement == NULL) return newSnapshot;
+	
+	// INSERT OR REPLACE INTO "yap2" ("extension", "key", "data") VALUES (?, ?, ?);
+	
+	int const bind_idx_extension = SQLITE_BIND_START + 0;
+	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	int const bind_idx_data      = SQLITE_BIND_START + 2;
+	
+	const char *extension = "";
+	sqlite3_bind_text(statement, bind_idx_extension, extension, (int)strlen(extension), SQLITE_STATIC);
+	
+	const char *key = "snapshot";
+	sqlite3_bind_text(statement, bind_idx_key, key, (int)strlen(key), SQLITE_STATIC);
+	
+	sqlite3_bind_int64(statement, bind_idx_data, (sqlite3_int64)newSnapshot);
+	
+	int status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s",
+		                                                       status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return newSnapshot;
+}
+
+- (void)markSqlLevelSharedReadLockAcquired
+{
+	NSAssert(needsMarkSqlLevelSharedReadLock, @"Method called but unneeded. Unnecessary overhead.");
+	if (!needsMarkSqlLevelSharedReadLock) return;
+	
+	__block YapDatabaseConnectionState *writeStateToSignal = nil;
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// Update our connection state within the state table.
+		//
+		// We need to mark this connection as having acquired an "sql-level" shared read lock.
+		// That is, our sqlite connection has invoked a select statement, and has thus invoked the sqlite
+		// machinery that causes it to acquire the "sql-level" snapshot (last valid commit record in the WAL).
+		//
+		// While we're doing this we also check to see if we were possibly blocking a write transaction.
+		// When does a write transaction get blocked?
+		//
+		// If a write transaction goes to commit its changes and sees a read-only transaction with
+		// a "yap-level" snapshot of the in-memory metadata snapshot, but without an "sql-level" snapshot
+		// of the actual database, it will block until these read transctions either complete,
+		// or acquire the needed "sql-level" snapshot.
+		//
+		// So if we never acquired an "sql-level" snapshot of the database, and we were the last transaction
+		// in such a state, and there's a blocked write transaction, then we need to signal it.
+		
+		__block NSUInteger countOtherMaybeBlockingWriteTransaction = 0;
+		__block YapDatabaseConnectionState *blockedWriteState = nil;
+		
+		for (YapDatabaseConnectionState *state in database->connectionStates)
+		{
+			if (state->connection == self)
+			{
+				state->sqlLevelSharedReadLock = YES;
+			}
+			else if (state->activeReadTransaction && !state->sqlLevelSharedReadLock)
+			{
+				countOtherMaybeBlockingWriteTransaction++;
+			}
+			else if (state->waitingForWriteLock)
+			{
+				blockedWriteState = state;
+			}
+		}
+		
+		if (countOtherMaybeBlockingWriteTransaction == 0 && blockedWriteState)
+		{
+			writeStateToSignal = blockedWriteState;
+		}
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(database->IsOnSnapshotQueueKey))
+		block();
+	else
+		dispatch_sync(database->snapshotQueue, block);
+	
+	needsMarkSqlLevelSharedReadLock = NO;
+	
+	if (writeStateToSignal)
+	{
+		YDBLogVerbose(@"YapDatabaseConnection(%p) signaling blocked write on connection(%p)",
+											 self, writeStateToSignal->connection);
+		[writeStateToSignal signalWriteLock];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Long-Lived Transactions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSArray *)beginLongLivedReadTransaction
+{
+	[self sealCoalescedReads];
+	
+	__block NSMutableArray *notifications = nil;
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (longLivedReadTransaction)
+		{
+			// Caller using implicit atomic reBeginLongLivedReadTransaction
+			notifications = (NSMutableArray *)[self endLongLivedReadTransaction];
+		}
+		
+		longLivedReadTransaction = [self newReadTransaction];
+		[self preReadTransaction:longLivedReadTransaction];
+		
+		// The preReadTransaction method acquires the "sqlite-level" snapshot.
+		// In doing so, if it needs to fetch and process any changesets,
+		// then it adds them to the processedChangesets ivar for us.
+		
+		if (notifications == nil)
+			notifications = [NSMutableArray arrayWithCapacity:[processedChangesets count]];
+		
+		for (NSDictionary *changeset in processedChangesets)
+		{
+			// The changeset has already been processed.
+			
+			NSNotification *notification = [changeset objectForKey:YapDatabaseNotificationKey];
+			if (notification) {
+				[notifications addObject:notification];
+			}
+		}
+		
+		[processedChangesets removeAllObjects];
+		
+		if (self.detachesLongLivedReadTransactions) {
+			[self detachLongLivedReadTransaction];
+		}
+		
+		longLivedReadTransactionUseTicks = mach_absolute_time();
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return notifications;
+}
+
+- (NSArray *)endLongLivedReadTransaction
+{
+	[self sealCoalescedReads];
+	
+	__block NSMutableArray *notifications = nil;
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (longLivedReadTransaction)
+		{
+			// End the transaction (sqlite commit)
+			
+			if (longLivedSQLiteSnapshot)
+			{
+				// The sqlite read transaction was released when the transaction was detached.
+				// Begin a (deferred) transaction to balance the commit in postReadTransaction.
+				
+				[longLivedReadTransaction beginTransaction];
+			}
+			
+			[self postReadTransaction:longLivedReadTransaction];
+			longLivedReadTransaction = nil;
+			
+			[self releaseLongLivedSQLiteSnapshot];
+			
+			// Now process any changesets that were pending.
+			// And extract the corresponding external notifications to return the the caller.
+			
+			notifications = [NSMutableArray arrayWithCapacity:[pendingChangesets count]];
+			
+			[self noteCommittedChangesets:pendingChangesets];
+			
+			for (NSDictionary *changeset in pendingChangesets)
+			{
+				NSNotification *notification = [changeset objectForKey:YapDatabaseNotificationKey];
+				if (notification) {
+					[notifications addObject:notification];
+				}
+			}
+			
+			[pendingChangesets removeAllObjects];
+		}
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return notifications;
+}
+
+/**
+ * Captures an sqlite3_snapshot of the long-lived read transaction (if needed),
+ * and releases the sqlite read transaction. The snapshot is pinned by the database in the meantime.
+ *
+ * If the snapshot can't be captured (or pinned), the transaction simply remains attached.
+ *
+ * This method is only invoked by beginLongLivedReadTransaction (if detachesLongLivedReadTransactions is set),
+ * and by redetachLongLivedReadTransaction.
+ *
+ * This method must be invoked from within the connectionQueue.
+**/
+- (void)detachLongLivedReadTransaction
+{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+	if (longLivedReadTransaction == nil) return;
+	if (sqlite3_get_autocommit(db)) return; // sqlite transaction isn't open
+	
+	if (longLivedSQLiteSnapshot == NULL)
+	{
+		sqlite3_snapshot *sqliteSnapshot = NULL;
+		
+		int status = sqlite3_snapshot_get(db, "main", &sqliteSnapshot);
+		if (status != SQLITE_OK)
+		{
+			YDBLogVerbose(@"Unable to detach longLivedReadTransaction: sqlite3_snapshot_get: %d %s",
+			              status, sqlite3_errmsg(db));
+			return;
+		}
+		
+		if (![database pinSQLiteSnapshot:sqliteSnapshot])
+		{
+			sqlite3_snapshot_free(sqliteSnapshot);
+			return;
+		}
+		
+		longLivedSQLiteSnapshot = sqliteSnapshot;
+	}
+	
+	[longLivedReadTransaction commitTransaction];
+#endif
+}
+
+/**
+ * Invoked after each read on the long-lived read transaction.
+ *
+ * Releases the sqlite read transaction again, but only if the long-lived read transaction was detached
+ * (by beginLongLivedReadTransaction). Otherwise it remains attached, as detachesLongLivedReadTransactions is NO
+ * (or the snapshot couldn't be captured).
+ *
+ * This method must be invoked from within the connectionQueue.
+**/
+- (void)redetachLongLivedReadTransaction
+{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+	if (longLivedSQLiteSnapshot == NULL) return;
+	
+	[self detachLongLivedReadTransaction];
+#endif
+}
+
+/**
+ * Re-opens the sqlite3_snapshot of a detached long-lived read transaction.
+ * Returns YES if the transaction is ready to use (including if it was never detached).
+ *
+ * If the snapshot cannot be re-opened (which the pin should prevent),
+ * the long-lived read transaction is ended, and NO is returned.
+ *
+ * This method must be invoked from within the connectionQueue.
+**/
+- (BOOL)attachLongLivedReadTransaction
+{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+	if (longLivedSQLiteSnapshot == NULL) return YES;
+	if (!sqlite3_get_autocommit(db)) return YES; // already attached (nested read)
+	
+	[longLivedReadTransaction beginTransaction];
+	
+	int status = sqlite3_snapshot_open(db, "main", longLivedSQLiteSnapshot);
+	if (status != SQLITE_OK)
+	{
+		// The wal-index may need to be rebuilt (e.g. after the last connection to the database was closed).
+		
+		[longLivedReadTransaction rollbackTransaction];
+		sqlite3_snapshot_recover(db, "main");
+		
+		[longLivedReadTransaction beginTransaction];
+		status = sqlite3_snapshot_open(db, "main", longLivedSQLiteSnapshot);
+	}
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogWarn(@"Ending long-lived read transaction on connection %@:"
+		           @" unable to re-open sqlite snapshot: %d %s", self, status, sqlite3_errmsg(db));
+		
+		[longLivedReadTransaction rollbackTransaction];
+		[self endLongLivedReadTransaction];
+		
+		return NO;
+	}
+#endif
+	
+	return YES;
+}
+
+/**
+ * Unpins & frees the sqlite3_snapshot of the long-lived read transaction (if any).
+**/
+- (void)releaseLongLivedSQLiteSnapshot
+{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+	if (longLivedSQLiteSnapshot)
+	{
+		[database unpinSQLiteSnapshot:longLivedSQLiteSnapshot];
+		
+		sqlite3_snapshot_free(longLivedSQLiteSnapshot);
+		longLivedSQLiteSnapshot = NULL;
+	}
+#endif
+}
+
+/**
+ * Invoked (within the connectionQueue) after a changeset is stored for the long-lived read transaction.
+ * If an idle timeout is configured, schedules a check for when the timeout may have elapsed.
+**/
+- (void)scheduleLongLivedReadTransactionAdvance
+{
+	if (longLivedReadTransactionAdvanceScheduled) return;
+	
+	NSTimeInterval timeout = self.longLivedReadTransactionIdleTimeout;
+	if (timeout <= 0.0) return;
+	
+	NSTimeInterval idle = YapDatabaseTicksToSeconds(mach_absolute_time() - longLivedReadTransactionUseTicks);
+	NSTimeInterval delay = MAX(timeout - idle, 0.0);
+	
+	longLivedReadTransactionAdvanceScheduled = YES;
+	
+	dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC));
+	
+	__weak YapDatabaseConnection *weakSelf = self;
+	dispatch_after(when, connectionQueue, ^{ @autoreleasepool {
+		
+		__strong YapDatabaseConnection *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		strongSelf->longLivedReadTransactionAdvanceScheduled = NO;
+		[strongSelf advanceIdleLongLivedReadTransaction];
+	}});
+}
+
+/**
+ * Moves the long-lived read transaction to the latest commit,
+ * if it's behind and hasn't been used for at least the longLivedReadTransactionIdleTimeout.
+ * 
+ * The notifications (that would have been returned from beginLongLivedReadTransaction)
+ * are posted via YapDatabaseLongLivedReadTransactionAdvancedNotification.
+ * 
+ * This method must be invoked from within the connectionQueue.
+**/
+- (void)advanceIdleLongLivedReadTransaction
+{
+	if (longLivedReadTransaction == nil) return;
+	if ([pendingChangesets count] == 0) return;
+	
+	NSTimeInterval timeout = self.longLivedReadTransactionIdleTimeout;
+	if (timeout <= 0.0) return;
+	
+	NSTimeInterval idle = YapDatabaseTicksToSeconds(mach_absolute_time() - longLivedReadTransactionUseTicks);
+	if (idle < timeout)
+	{
+		// The transaction was used since the check was scheduled.
+		[self scheduleLongLivedReadTransactionAdvance];
+		return;
+	}
+	
+	YDBLogVerbose(@"Advancing idle long-lived read transaction on connection %@ (%lu pending changesets)",
+	              self, (unsigned long)[pendingChangesets count]);
+	
+	NSArray<NSNotification *> *notifications = [self beginLongLivedReadTransaction];
+	NSDictionary *userInfo = @{ YapDatabaseModifiedNotificationsKey : (notifications ?: @[]) };
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		
+		[[NSNotificationCenter defaultCenter] postNotificationName:YapDatabaseLongLivedReadTransactionAdvancedNotification
+		                                                    object:self
+		                                                  userInfo:userInfo];
+	});
+}
+
+- (BOOL)isInLongLivedReadTransaction
+{
+	__block BOOL result = NO;
+	
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = (longLivedReadTransaction != nil);
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)enableExceptionsForImplicitlyEndingLongLivedReadTransaction
+{
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		throwExceptionsForImplicitlyEndingLongLivedReadTransaction = YES;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (void)disableExceptionsForImplicitlyEndingLongLivedReadTransaction
+{
+	dispatch_block_t block = ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		throwExceptionsForImplicitlyEndingLongLivedReadTransaction = NO;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+/**
+ * Long-lived read transactions are a great way to achive stability, especially in places like the main-thread.
+ * However, they pose a unique problem. These long-lived transactions often start out by
+ * locking the WAL (write ahead log). This prevents the WAL from ever getting reset,
+ * and thus causes the WAL to potentially grow infinitely large. In order to allow the WAL to get properly reset,
+ * we need the long-lived read transactions to "reset". That is, without changing their stable state (their snapshot),
+ * we need them to restart the transaction, but this time without locking this WAL.
+ * 
+ * In other words, if commit X is the most recent commit, and the connection is reading commit X from the WAL,
+ * then we want to reset the connection such that it's reading commit X directly from the database file.
+ * This will mean the WAL is no longer locked, and can be reset on the next write.
+ * 
+ * We use this method as part of the solution to achieving this.
+**/
+- (BOOL)resetLongLivedReadTransaction
+{
+	if (longLivedReadTransaction && (snapshot == [database snapshot]))
+	{
+		NSArray *empty = [self beginLongLivedReadTransaction];
+	
+		if ([empty count] != 0)
+		{
+			YDBLogError(@"Core logic failure! "
+							@"Silent longLivedReadTransaction reset resulted in non-empty notification array!");
+		}
+		
+		return YES;
+	}
+	
+	return NO;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Changeset Architecture
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The creation of changeset dictionaries happens constantly.
+ * So, to optimize a bit, we use sharedKeySet's (part of NSDictionary).
+ * 
+ * See ivar 'sharedKeySetForInternalChangeset'
+**/
+- (NSArray *)internalChangesetKeys
+{
+	return @[ YapDatabaseSnapshotKey,
+	          YapDatabaseExtensionsKey,
+	          YapDatabaseRegisteredExtensionsKey,
+	          YapDatabaseRegisteredMemoryTablesKey,
+	          YapDatabaseExtensionsOrderKey,
+	          YapDatabaseExtensionDependenciesKey,
+	          YapDatabaseNotificationKey,
+	          YapDatabaseObjectChangesKey,
+	          YapDatabaseMetadataChangesKey,
+	          YapDatabaseRemovedKeysKey,
+	          YapDatabaseRemovedCollectionsKey,
+	          YapDatabaseResetCollectionsKey,
+	          YapDatabaseRemovedRowidsKey,
+	          YapDatabaseExtensionValuesChangedKey,
+	          YapDatabaseAllKeysRemovedKey,
+	          YapDatabaseModifiedExternallyKey ];
+}
+
+/**
+ * The creation of changeset dictionaries happens constantly.
+ * So, to optimize a bit, we use sharedKeySet's (part of NSDictionary).
+ *
+ * See ivar 'sharedKeySetForExternalChangeset'
+**/
+- (NSArray *)externalChangesetKeys
+{
+	return @[ YapDatabaseSnapshotKey,
+	          YapDatabaseConnectionKey,
+	          YapDatabaseExtensionsKey,
+	          YapDatabaseCustomKey,
+	          YapDatabaseObjectChangesKey,
+	          YapDatabaseMetadataChangesKey,
+	          YapDatabaseRemovedKeysKey,
+	          YapDatabaseRemovedCollectionsKey,
+	          YapDatabaseResetCollectionsKey,
+	          YapDatabaseAllKeysRemovedKey,
+	          YapDatabaseModifiedExternallyKey ];
+}
+
+/**
+ * Invoked (pre-commit) for transactions with coarseChangeset enabled,
+ * and during transactions whose changeset reaches the changesetSpillThreshold.
+ * Replaces the per-key change information with the set of collections that were changed.
+**/
+- (void)coarsenChangeset
+{
+	for (YapCollectionKey *collectionKey in [objectChanges keyEnumerator])
+	{
+		[resetCollections addObject:collectionKey.collection];
+	}
+	for (YapCollectionKey *collectionKey in [metadataChanges keyEnumerator])
+	{
+		[resetCollections addObject:collectionKey.collection];
+	}
+	for (YapCollectionKey *collectionKey in insertedKeys)
+	{
+		[resetCollections addObject:collectionKey.collection];
+	}
+	for (YapCollectionKey *collectionKey in removedKeys)
+	{
+		[resetCollections addObject:collectionKey.collection];
+	}
+	
+	// A cleared collection is already reported as such (which implies a reset)
+	[resetCollections minusSet:removedCollections];
+	
+	[objectChanges removeAllObjects];
+	[metadataChanges removeAllObjects];
+	[insertedKeys removeAllObjects];
+	[removedKeys removeAllObjects];
+	
+	// Every removed rowid belongs to a reset (or removed) collection,
+	// so receiving connections drop the corresponding keyCache entries anyway.
+	YapRowidSetRemoveAll(removedRowids);
+}
+
+/**
+ * Replaces the per-key change information of a single collection with a reset of the collection
+ * (regardless of the transaction's coarseChangeset setting).
+ *
+ * Used by bulk operations that don't track the changed keys, such as importCollectionFromStream:.
+ * Removed keys are left as-is, as they're still accurate.
+**/
+- (void)coarsenChangesetForCollection:(NSString *)collection
+{
+	NSMutableArray<YapCollectionKey *> *toRemove = [NSMutableArray array];
+	
+	for (YapCollectionKey *collectionKey in [objectChanges keyEnumerator])
+	{
+		if ([collectionKey.collection isEqualToString:collection])
+			[toRemove addObject:collectionKey];
+	}
+	[objectChanges removeObjectsForKeys:toRemove];
+	[toRemove removeAllObjects];
+	
+	for (YapCollectionKey *collectionKey in [metadataChanges keyEnumerator])
+	{
+		if ([collectionKey.collection isEqualToString:collection])
+			[toRemove addObject:collectionKey];
+	}
+	[metadataChanges removeObjectsForKeys:toRemove];
+	[toRemove removeAllObjects];
+	
+	for (YapCollectionKey *collectionKey in insertedKeys)
+	{
+		if ([collectionKey.collection isEqualToString:collection])
+			[toRemove addObject:collectionKey];
+	}
+	for (YapCollectionKey *collectionKey in toRemove)
+	{
+		[insertedKeys removeObject:collectionKey];
+	}
+	
+	// A cleared collection is already reported as such (which implies a reset)
+	if (![removedCollections containsObject:collection]) {
+		[resetCollections addObject:collection];
+	}
+}
+
+/**
+ * This method is invoked from within the postReadWriteTransaction operation.
+ * This method is invoked before anything has been committed.
+ *
+ * If changes have been made, it should return a changeset dictionary.
+ * If no changes have been made, it should return nil.
+ * 
+ * @see processChangeset:
+**/
+- (void)getInternalChangeset:(NSMutableDictionary **)internalChangesetPtr
+           externalChangeset:(NSMutableDictionary **)externalChangesetPtr
+{
+	// Step 1 of 2 - Process extensions
+	//
+	// Note: Use existing extensions (extensions ivar, not [self extensions]).
+	// There's no need to create any new extConnections at this point.
+	
+	__block NSMutableDictionary *internalChangeset_extensions = nil;
+	__block NSMutableDictionary *externalChangeset_extensions = nil;
+	
+	[extensions enumerateKeysAndObjectsUsingBlock:^(id extName, id extConnectionObj, BOOL __unused *stop) {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		__unsafe_unretained YapDatabaseExtensionConnection *extConnection = extConnectionObj;
+		
+		NSMutableDictionary *internal = nil;
+		NSMutableDictionary *external = nil;
+		BOOL extHasDiskChanges = NO;
+		
+		[extConnection getInternalChangeset:&internal
+		                  externalChangeset:&external
+		                     hasDiskChanges:&extHasDiskChanges];
+		
+		if (internal)
+		{
+			if (internalChangeset_extensions == nil)
+				internalChangeset_extensions =
+				    [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExtensions];
+			
+			[internalChangeset_extensions setObject:internal forKey:extName];
+		}
+		if (external)
+		{
+			if (externalChangeset_extensions == nil)
+				externalChangeset_extensions =
+				    [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExtensions];
+			
+			[externalChangeset_extensions setObject:external forKey:extName];
+		}
+		if (extHasDiskChanges && !hasDiskChanges)
+		{
+			hasDiskChanges = YES;
+		}
+		
+	#pragma clang diagnostic pop
+	}];
+	
+	NSMutableDictionary *internalChangeset = nil;
+	NSMutableDictionary *externalChangeset = nil;
+	
+	if (internalChangeset_extensions)
+	{
+		internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+		[internalChangeset setObject:internalChangeset_extensions forKey:YapDatabaseExtensionsKey];
+	}
+	
+	if (externalChangeset_extensions)
+	{
+		externalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
+		[externalChangeset setObject:externalChangeset_extensions forKey:YapDatabaseExtensionsKey];
+	}
+	
+	if (registeredExtensionsChanged)
+	{
+		if (internalChangeset == nil)
+			internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+		
+		[internalChangeset setObject:registeredExtensions forKey:YapDatabaseRegisteredExtensionsKey];
+		[internalChangeset setObject:extensionsOrder forKey:YapDatabaseExtensionsOrderKey];
+		[internalChangeset setObject:extensionDependencies forKey:YapDatabaseExtensionDependenciesKey];
+	}
+	
+	if (registeredMemoryTablesChanged)
+	{
+		if (internalChangeset == nil)
+			internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+		
+		[internalChangeset setObject:registeredMemoryTables forKey:YapDatabaseRegisteredMemoryTablesKey];
+	}
+	
+	if ([changedExtensionValues count] > 0)
+	{
+		if (internalChangeset == nil)
+			internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+		
+		[internalChangeset setObject:[changedExtensionValues copy] forKey:YapDatabaseExtensionValuesChangedKey];
+	}
+	
+	// Step 2 of 2 - Process database changes
+	//
+	// Throughout the readwrite transaction we've been keeping a list of what changed.
+	// Copy this change information into the changeset for processing by other connections.
+	
+	if ([objectChanges count]      > 0 ||
+	    [metadataChanges count]    > 0 ||
+	    [insertedKeys count]       > 0 ||
+	    [removedKeys count]        > 0 ||
+	    [removedCollections count] > 0 ||
+	    [resetCollections count]   > 0 ||
+	    YapRowidSetCount(removedRowids) > 0 || allKeysRemoved)
+	{
+		if (internalChangeset == nil)
+			internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
+		
+		if (externalChangeset == nil)
+			externalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
+		
+		if ([objectChanges count] > 0)
+		{
+			internalChangeset[YapDatabaseObjectChangesKey] = objectChanges;
+			
+			YapSet *immutableObjectChanges = [[YapSet alloc] initWithDictionary:objectChanges];
+			externalChangeset[YapDatabaseObjectChangesKey] = immutableObjectChanges;
+		}
+		
+		if ([metadataChanges count] > 0)
+		{
+			internalChangeset[YapDatabaseMetadataChangesKey] = metadataChanges;
+			
+			YapSet *immutableMetadataChanges = [[YapSet alloc] initWithDictionary:metadataChanges];
+			externalChangeset[YapDatabaseMetadataChangesKey] = immutableMetadataChanges;
+		}
+		
+		if ([insertedKeys count] > 0)
+		{
+			internalChangeset[YapDatabaseInsertedKeysKey] = insertedKeys;
+			
+			YapSet *immutableInsertedKeys = [[YapSet alloc] initWithSet:insertedKeys];
+			externalChangeset[YapDatabaseInsertedKeysKey] = immutableInsertedKeys;
+		}
+		
+		if ([removedKeys count] > 0)
+		{
+			internalChangeset[YapDatabaseRemovedKeysKey] = removedKeys;
+			
+			YapSet *immutableRemovedKeys = [[YapSet alloc] initWithSet:removedKeys];
+			externalChangeset[YapDatabaseRemovedKeysKey] = immutableRemovedKeys;
+		}
+		
+		if ([removedCollections count] > 0)
+		{
+			internalChangeset[YapDatabaseRemovedCollectionsKey] = removedCollections;
+			
+			YapSet *immutableRemovedCollections = [[YapSet alloc] initWithSet:removedCollections];
+			externalChangeset[YapDatabaseRemovedCollectionsKey] = immutableRemovedCollections;
+		}
+		
+		if ([resetCollections count] > 0)
+		{
+			internalChangeset[YapDatabaseResetCollectionsKey] = resetCollections;
+			
+			YapSet *immutableResetCollections = [[YapSet alloc] initWithSet:resetCollections];
+			externalChangeset[YapDatabaseResetCollectionsKey] = immutableResetCollections;
+		}
+		
+		if (YapRowidSetCount(removedRowids) > 0)
+		{
+			// The changeset takes ownership of the set (a new one is created for the next transaction).
+			// Sibling connections may retain the changeset for a while (e.g. during a long-lived read transaction),
+			// so the compact representation matters here.
+			
+			internalChangeset[YapDatabaseRemovedRowidsKey] = [[YapRowidSetBox alloc] initWithRowidSet:removedRowids];
+			removedRowids = NULL;
+		}
+		
+		if (allKeysRemoved)
+		{
+			internalChangeset[YapDatabaseAllKeysRemovedKey] = @(YES);
+			externalChangeset[YapDatabaseAllKeysRemovedKey] = @(YES);
+		}
+        
+        if (externallyModified)
+        {
+            internalChangeset[YapDatabaseModifiedExternallyKey] = @(YES);
+            externalChangeset[YapDatabaseModifiedExternallyKey] = @(YES);
+        }
+	}
+	
+	*internalChangesetPtr = internalChangeset;
+	*externalChangesetPtr = externalChangeset;
+}
+
+/**
+ * This method is invoked with the changeset from a sibling connection.
+ * The connection should update any in-memory components (such as the cache) to properly reflect the changeset.
+ *
+ * @see getInternalChangeset:externalChangeset:
+**/
+- (void)processChangeset:(NSDictionary *)changeset
+{
+	YDBSignpostID signpost = YDBSignpostBegin("Process Changeset", "receiver: %{public}@", _name);
+	
+	[self _processChangeset:changeset];
+	
+	YDBSignpostEnd(signpost, "Process Changeset");
+}
+
+- (void)_processChangeset:(NSDictionary *)changeset
+{
+	// Did registered extensions change ?
+	
+	NSDictionary *changeset_registeredExtensions = [changeset objectForKey:YapDatabaseRegisteredExtensionsKey];
+	if (changeset_registeredExtensions)
+	{
+		// Retain new lists
+		
+		registeredExtensions = changeset_registeredExtensions;
+		extensionsOrder = [changeset objectForKey:YapDatabaseExtensionsOrderKey];
+		extensionDependencies = [changeset objectForKey:YapDatabaseExtensionDependenciesKey];
+		
+		// Remove any extensions that have been dropped
+		
+		for (NSString *extName in [extensions allKeys])
+		{
+			if ([registeredExtensions objectForKey:extName] == nil)
 			{
-				[database noteCheckpointWithTotalFrames:totalFrameCount checkpointedFrames:checkpointedFrameCount];
+				YDBLogVerbose(@"Dropping extension: %@", extName);
+				
+				[extensions removeObjectForKey:extName];
 			}
 		}
 		
-		// Post-Write-Transaction: Step 11 of 11
-		//
-		// Post YapDatabaseModifiedNotification (if needed)
+		// Make a note if there are extensions for which we haven't instantiated an extConnection instance.
+		// We lazily load these later, if needed.
 		
-		if (notification)
-		{
-			dispatch_async(dispatch_get_main_queue(), ^{
-				[[NSNotificationCenter defaultCenter] postNotification:notification];
-			});
-		}
-	
-	} // end else if (!transaction->rollback)
-	
-	
-	// Clear changeset variables (which are now a part of the notification)
+		extensionsReady = ([registeredExtensions count] == [extensions count]);
+	}
 	
-	if ([objectChanges count] > 0)
-		objectChanges = nil;
+	// Did registered memory tables change ?
 	
-	if ([metadataChanges count] > 0)
-		metadataChanges = nil;
+	NSDictionary *changeset_registeredMemoryTables = [changeset objectForKey:YapDatabaseRegisteredMemoryTablesKey];
+	if (changeset_registeredMemoryTables)
+	{
+		registeredMemoryTables = changeset_registeredMemoryTables;
+	}
 	
-	if ([insertedKeys count] > 0)
-		insertedKeys = nil;
+	// Did yap2 values change ?
+	//
+	// The extensionValuesCache only holds entire extensions (as far as invalidation is concerned).
+	// So we drop the cached values of every extension that was modified.
 	
-	if ([removedKeys count] > 0)
-		removedKeys = nil;
+	NSSet *changeset_extensionValuesChanged = [changeset objectForKey:YapDatabaseExtensionValuesChangedKey];
+	for (NSString *extName in changeset_extensionValuesChanged)
+	{
+		[extensionValuesCache removeObjectForKey:extName];
+	}
 	
-	if ([removedCollections count] > 0)
-		removedCollections = nil;
+	// Process normal database changeset information
 	
-	if ([removedRowids count] > 0)
-		removedRowids = nil;
+	NSDictionary *changeset_objectChanges   =  [changeset objectForKey:YapDatabaseObjectChangesKey];
+	NSDictionary *changeset_metadataChanges =  [changeset objectForKey:YapDatabaseMetadataChangesKey];
 	
-	[mutationStack clear];
+	YapRowidSetBox *changeset_removedRowids = [changeset objectForKey:YapDatabaseRemovedRowidsKey];
+	NSSet *changeset_removedKeys        = [changeset objectForKey:YapDatabaseRemovedKeysKey];
+	NSSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
+	NSSet *changeset_resetCollections   = [changeset objectForKey:YapDatabaseResetCollectionsKey];
 	
-	// Drop IsOnConnectionQueueKey flag from writeQueue since we're exiting writeQueue.
+	if ([changeset_resetCollections count] > 0)
+	{
+		// As far as the caches are concerned, a reset collection is the same as a removed collection.
+		// That is, every cached entry for the collection is dropped.
+		
+		if ([changeset_removedCollections count] > 0)
+			changeset_removedCollections = [changeset_removedCollections setByAddingObjectsFromSet:changeset_resetCollections];
+		else
+			changeset_removedCollections = changeset_resetCollections;
+	}
 	
-	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, NULL, NULL);
-}
-
-/**
- * This method executes the state transition steps required before executing a pseudo read-write transaction.
- *
- * This method must be invoked from within the connectionQueue.
- * This method must be invoked from within the database.writeQueue.
-**/
-- (void)prePseudoReadWriteTransaction
-{
-	// This is similar to a read-write transaction,
-	// in that we intend to block other writers (go through the writeQueue).
-	//
-	// However, our operation cannot occur within a transaction. (no "BEGIN TRANSCTION;" or "COMMIT TRANSACTION;")
-	// Thus we cannot simply use preReadWriteTransaction & postReadWriteTransaction.
-	// Instead we use a select subset of them.
+	BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
+	BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
 	
-	// Pre-Pseudo-Write-Transaction: Step 1 of 5
-	//
-	// Add IsOnConnectionQueueKey flag to writeQueue.
-	// This allows various methods that depend on the flag to operate correctly.
+	BOOL hasObjectChanges      = [changeset_objectChanges count] > 0;
+	BOOL hasMetadataChanges    = [changeset_metadataChanges count] > 0;
+	BOOL hasRemovedKeys        = [changeset_removedKeys count] > 0;
+	BOOL hasRemovedCollections = [changeset_removedCollections count] > 0;
 	
-	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, IsOnConnectionQueueKey, NULL);
+	// Check for external modification (special case)
 	
-	// Pre-Pseudo-Write-Transaction: Step 2 of 5
-	//
-	// Prep work: sqlite VFS shim listeners for read notifications (if needed).
-	// Initialize the 'main_file', if we haven't already.
+	if (changeset_modifiedExternally)
+	{
+		NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
+		                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
+		
+		[self _flushMemoryWithFlags:flags];
+	}
+	else if ([[changeset objectForKey:YapDatabaseOtherProcessKey] boolValue])
+	{
+		// The changeset was committed by another process (see -[YapDatabase sharedChangesetsSince:until:]).
+		// Our own caches are updated below, since the changeset contains every key that changed.
+		// But the summary doesn't contain the changesets of the extensions,
+		// so their caches & state must be flushed (as well as the yap2 values).
+		
+		NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
+		                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
+		
+		[extensionValuesCache removeAllObjects];
+		
+		[extensions enumerateKeysAndObjectsUsingBlock:^(id __unused extNameObj, id extConnectionObj, BOOL __unused *stop) {
+			
+			[(YapDatabaseExtensionConnection *)extConnectionObj _flushMemoryWithFlags:flags];
+		}];
+	}
 	
-	if (main_file == NULL)
+	if (isCatchingUpBacklog)
 	{
-		sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &main_file);
-		if (main_file) {
-			main_file->yap_database_connection = (__bridge void *)self;
-		}
+		// The caches were flushed before catching up on the backlog (see noteCommittedChangesets:).
+		// So there's nothing in them to update.
+		
+		return;
 	}
 	
-	// Pre-Pseudo-Write-Transaction: Step 3 of 5
-	//
-	// Update our connection state within the state table.
-	//
-	// We are the only write transaction for this database.
-	// It is important for read-only transactions on other connections to know there's a writer.
+	// Update keyCache
 	
-	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		YapDatabaseConnectionState *myState = nil;
+	if (changeset_allKeysRemoved)
+	{
+		// Shortcut: Everything was removed from the database
 		
-		for (YapDatabaseConnectionState *state in database->connectionStates)
+		[keyCache removeAllObjects];
+	}
+	else
+	{
+		if (changeset_removedRowids)
 		{
-			if (state->connection == self)
+			YapRowidSet *rowids = changeset_removedRowids->set;
+			
+			if (YapRowidSetCount(rowids) <= [keyCache count])
 			{
-				myState = state;
-				myState->activeWriteTransaction = YES;
+				YapRowidSetEnumerate(rowids, ^(int64_t rowid, BOOL __unused *stop) {
+				#pragma clang diagnostic push
+				#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+					
+					[keyCache removeObjectForRowid:rowid];
+					
+				#pragma clang diagnostic pop
+				});
+			}
+			else
+			{
+				// More rowids were removed than we have cached.
+				// So it's cheaper to probe the (bitmap) set with each cached rowid.
+				
+				NSMutableArray *toRemove = [NSMutableArray array];
+				[keyCache enumerateRowidsWithBlock:^(int64_t rowid, BOOL __unused *stop) {
+					
+					if (YapRowidSetContains(rowids, rowid))
+					{
+						[toRemove addObject:@(rowid)];
+					}
+				}];
+				
+				[keyCache removeObjectsForRowids:toRemove];
 			}
 		}
 		
-		NSAssert(myState != nil, @"Missing state in database->connectionStates");
+		if (hasRemovedCollections)
+		{
+			__block NSMutableArray *toRemove = nil;
+			[keyCache enumerateRowidsAndObjectsWithBlock:^(int64_t rowid, id obj, BOOL __unused *stop) {
+				
+				__unsafe_unretained YapCollectionKey *collectionKey = (YapCollectionKey *)obj;
+				
+				if ([changeset_removedCollections containsObject:collectionKey.collection])
+				{
+					if (toRemove == nil)
+						toRemove = [NSMutableArray array];
+					
+					[toRemove addObject:@(rowid)];
+				}
+			}];
+			
+			[keyCache removeObjectsForRowids:toRemove];
+		}
+	}
+	
+	// Update objectCache
+	
+	if (changeset_allKeysRemoved && !hasObjectChanges)
+	{
+		// Shortcut: Everything was removed from the database
 		
-		// Pre-Pseudo-Write-Transaction: Step 4 of 5
-		//
-		// Prep work: sqlite VFS shim listeners for read notifications (if needed).
-		// Initialize the 'wal_file', if we haven't already.
+		[objectCache removeAllObjects];
+	}
+	else if ((hasObjectChanges || hasRemovedKeys) && !hasRemovedCollections && !changeset_allKeysRemoved &&
+	         (!hasRemovedKeys || ([changeset_objectChanges count] + [changeset_removedKeys count]) <= [objectCache count]))
+	{
+		// Shortcut: Only individual keys were changed/removed, and there are fewer of them than cached entries.
+		// So we can simply enumerate over the changes and update the cache inline as needed,
+		// rather than enumerating the cache and looking up every cached key in the changeset.
 		
-		if (wal_file == NULL)
+		for (YapCollectionKey *cacheKey in changeset_removedKeys)
 		{
-			// If sqlite hasn't opened the wal_file yet,
-			// then we need to invoke the sql machinery so we can get access to it.
-			// We need the wal_file in order to properly receive notifications of
-			// when sqlite acquires an "sql-level" snapshot.
-			
-			(void)[self readSnapshotFromDatabase];
+			// Order matters: a key may have been removed, and then set again (see below).
 			
-			wal_file = yap_vfs_last_opened_wal(database->yap_vfs_shim);
-			if (wal_file) {
-				wal_file->yap_database_connection = (__bridge void *)self;
+			if ([changeset_objectChanges objectForKey:cacheKey] == nil)
+			{
+				[objectCache removeObjectForKey:cacheKey];
 			}
 		}
 		
-		myState->lastTransactionSnapshot = [database snapshot];
-		myState->lastTransactionTime = mach_absolute_time();
-		needsMarkSqlLevelSharedReadLock = YES;
+		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
+		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
 		
-		YDBLogVerbose(@"YapDatabaseConnection(%p) starting vacuum operation.", self);
+		BOOL isPolicyContainment = (objectPolicy == YapDatabasePolicyContainment);
+		BOOL isPolicyShare       = (objectPolicy == YapDatabasePolicyShare);
 		
-	#pragma clang diagnostic pop
-	}});
-	
-	// Pre-Pseudo-Write-Transaction: Step 5 of 5
-	//
-	// Setup write state and changeset variables.
-	
-	hasDiskChanges = NO;
-	
-	// Note: We don't need to setup all changeset variables.
-}
-
-/**
- * This method executes the state transition steps required after executing a pseudo read-write transaction.
- *
- * This method must be invoked from within the connectionQueue.
- * This method must be invoked from within the database.writeQueue.
-**/
-- (void)postPseudoReadWriteTransaction
-{
-	// This is similar to a read-write transaction,
-	// in that we intend to block other writers (go through the writeQueue).
-	//
-	// However, our operation cannot occur within a transaction. (no "BEGIN TRANSCTION;" or "COMMIT TRANSACTION;")
-	// Thus we cannot simply use preReadWriteTransaction & postReadWriteTransaction.
-	// Instead we use a select subset of them.
-	
-	// Post-Pseudo-Write-Transaction: Step 1 of 5
-	//
-	// Create changeset.
-	// We're doing this in order to increment the snapshot.
-	
-	NSMutableDictionary *changeset = nil;
-	NSMutableDictionary *userInfo = nil;
-	
-	NSNotification *notification = nil;
-	
-	if (hasDiskChanges)
+		[changeset_objectChanges enumerateKeysAndObjectsUsingBlock:^(id key, id newObject, BOOL __unused *stop) {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			
+			if ([objectCache containsKey:cacheKey])
+			{
+				if (newObject == yapNull)
+				{
+					[objectCache removeObjectForKey:cacheKey];
+				}
+				else if (newObject != yapTouch)
+				{
+					if (isPolicyShare || YapDatabaseIsImmutable(newObject)) {
+						[objectCache setObject:newObject forKey:cacheKey];
+					}
+					else if (isPolicyContainment) {
+						[objectCache removeObjectForKey:cacheKey];
+					}
+					else // if (isPolicyCopy)
+					{
+						if ([newObject conformsToProtocol:@protocol(NSCopying)])
+							[objectCache setObject:[newObject copy] forKey:cacheKey];
+						else
+							[objectCache removeObjectForKey:cacheKey];
+					}
+				}
+			}
+			
+		#pragma clang diagnostic pop
+		}];
+	}
+	else if (hasObjectChanges || hasRemovedKeys || hasRemovedCollections)
 	{
-		snapshot++;
+		NSUInteger updateCapacity = MIN([objectCache count], [changeset_objectChanges count]);
+		NSUInteger removeCapacity = MIN([objectCache count], [changeset_removedKeys count]);
 		
-		changeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
-		userInfo = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
+		NSMutableArray *keysToUpdate = [NSMutableArray arrayWithCapacity:updateCapacity];
+		NSMutableArray *keysToRemove = [NSMutableArray arrayWithCapacity:removeCapacity];
 		
-		changeset[YapDatabaseSnapshotKey] = @(snapshot);
-		userInfo[YapDatabaseSnapshotKey] = @(snapshot);
+		[objectCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+			
+			// Order matters.
+			// Consider the following database change:
+			//
+			// [transaction removeAllObjectsInAllCollections];
+			// [transaction setObject:obj forKey:key inCollection:collection];
+			
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			
+			if ([changeset_objectChanges objectForKey:cacheKey])
+			{
+				[keysToUpdate addObject:key];
+			}
+			else if ([changeset_removedKeys containsObject:cacheKey] ||
+					 [changeset_removedCollections containsObject:cacheKey.collection] || changeset_allKeysRemoved)
+			{
+				[keysToRemove addObject:key];
+			}
+		}];
 		
-		userInfo[YapDatabaseConnectionKey] = self;
+		[objectCache removeObjectsForKeys:keysToRemove];
 		
-		notification = [NSNotification notificationWithName:YapDatabaseModifiedNotification
-		                                             object:database
-		                                           userInfo:userInfo];
+		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
+		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
 		
-		changeset[YapDatabaseNotificationKey] = notification;
+		BOOL isPolicyContainment = (objectPolicy == YapDatabasePolicyContainment);
+		BOOL isPolicyShare       = (objectPolicy == YapDatabasePolicyShare);
+		
+		for (YapCollectionKey *cacheKey in keysToUpdate)
+		{
+			id newObject = [changeset_objectChanges objectForKey:cacheKey];
+			
+			if (newObject == yapNull)
+			{
+				[objectCache removeObjectForKey:cacheKey];
+			}
+			else if (newObject != yapTouch)
+			{
+				if (isPolicyShare || YapDatabaseIsImmutable(newObject)) {
+					[objectCache setObject:newObject forKey:cacheKey];
+				}
+				else if (isPolicyContainment) {
+					[objectCache removeObjectForKey:cacheKey];
+				}
+				else // if (isPolicyCopy)
+				{
+					if ([newObject conformsToProtocol:@protocol(NSCopying)])
+						[objectCache setObject:[newObject copy] forKey:cacheKey];
+					else
+						[objectCache removeObjectForKey:cacheKey];
+				}
+			}
+		}
 	}
 	
-	__block YapDatabaseConnectionState *myState = nil;
-	__block uint64_t minSnapshot = UINT64_MAX;
+	// Update metadataCache
 	
-	dispatch_sync(database->snapshotQueue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	if (changeset_allKeysRemoved && !hasMetadataChanges)
+	{
+		// Shortcut: Everything was removed from the database
 		
-		// Post-Pseudo-Write-Transaction: Step 2 of 5
-		//
-		// Notify database of changes, and drop reference to set of changed keys.
+		[metadataCache removeAllObjects];
+	}
+	else if ((hasMetadataChanges || hasRemovedKeys) && !hasRemovedCollections && !changeset_allKeysRemoved &&
+	         (!hasRemovedKeys || ([changeset_metadataChanges count] + [changeset_removedKeys count]) <= [metadataCache count]))
+	{
+		// Shortcut: Only individual keys were changed/removed, and there are fewer of them than cached entries.
+		// So we can simply enumerate over the changes and update the cache inline as needed,
+		// rather than enumerating the cache and looking up every cached key in the changeset.
 		
-		if (changeset)
+		for (YapCollectionKey *cacheKey in changeset_removedKeys)
 		{
-			[database notePendingChangeset:changeset fromConnection:self];
-			[database noteCommittedChangeset:changeset fromConnection:self];
+			// Order matters: a key may have been removed, and then set again (see below).
+			
+			if ([changeset_metadataChanges objectForKey:cacheKey] == nil)
+			{
+				[metadataCache removeObjectForKey:cacheKey];
+			}
 		}
 		
-		// Post-Pseudo-Write-Transaction: Step 3 of 5
-		//
-		// Update our connection state within the state table.
-		//
-		// We are the only write transaction for this database.
-		// It is important for read-only transactions on other connections to know we're no longer a writer.
+		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
+		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
 		
-		for (YapDatabaseConnectionState *state in database->connectionStates)
-		{
-			if (state->connection == self)
+		BOOL isPolicyContainment = (metadataPolicy == YapDatabasePolicyContainment);
+		BOOL isPolicyShare       = (metadataPolicy == YapDatabasePolicyShare);
+		
+		[changeset_metadataChanges enumerateKeysAndObjectsUsingBlock:^(id key, id newMetadata, BOOL __unused *stop) {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			
+			if ([metadataCache containsKey:cacheKey])
 			{
-				myState = state;
+				if (newMetadata == yapNull)
+				{
+					[metadataCache removeObjectForKey:cacheKey];
+				}
+				else if (newMetadata != yapTouch)
+				{
+					if (isPolicyShare || YapDatabaseIsImmutable(newMetadata)) {
+						[metadataCache setObject:newMetadata forKey:cacheKey];
+					}
+					else if (isPolicyContainment) {
+						[metadataCache removeObjectForKey:cacheKey];
+					}
+					else // if (isPolicyCopy)
+					{
+						if ([newMetadata conformsToProtocol:@protocol(NSCopying)])
+							[metadataCache setObject:[newMetadata copy] forKey:cacheKey];
+						else
+							[metadataCache removeObjectForKey:cacheKey];
+					}
+				}
 			}
-			else if (state->activeReadTransaction)
+			
+		#pragma clang diagnostic pop
+		}];
+	}
+	else if (hasMetadataChanges || hasRemovedKeys || hasRemovedCollections)
+	{
+		NSUInteger updateCapacity = MIN([metadataCache count], [changeset_metadataChanges count]);
+		NSUInteger removeCapacity = MIN([metadataCache count], [changeset_removedKeys count]);
+		
+		NSMutableArray *keysToUpdate = [NSMutableArray arrayWithCapacity:updateCapacity];
+		NSMutableArray *keysToRemove = [NSMutableArray arrayWithCapacity:removeCapacity];
+		
+		[metadataCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+			
+			// Order matters.
+			// Consider the following database change:
+			//
+			// [transaction removeAllObjectsInAllCollections];
+			// [transaction setObject:obj forKey:key inCollection:collection];
+			
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			
+			if ([changeset_metadataChanges objectForKey:cacheKey])
 			{
-				minSnapshot = MIN(state->lastTransactionSnapshot, minSnapshot);
+				[keysToUpdate addObject:key];
 			}
-		}
-		
-		NSAssert(myState != nil, @"Missing state in database->connectionStates");
+			else if ([changeset_removedKeys containsObject:cacheKey] ||
+					 [changeset_removedCollections containsObject:cacheKey.collection] || changeset_allKeysRemoved)
+			{
+				[keysToRemove addObject:key];
+			}
+		}];
 		
-		myState->activeWriteTransaction = NO;
-		myState->waitingForWriteLock = NO;
+		[metadataCache removeObjectsForKeys:keysToRemove];
 		
-		YDBLogVerbose(@"YapDatabaseConnection(%p) completing read-write transaction.", self);
+		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
+		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
 		
-	#pragma clang diagnostic pop
-	}});
-	
-	if (changeset)
-	{
-		// Post-Pseudo-Write-Transaction: Step 4 of 5
-		//
-		// We added frames to the WAL.
-		// We can invoke a checkpoint if there are no other active connections.
+		BOOL isPolicyContainment = (metadataPolicy == YapDatabasePolicyContainment);
+		BOOL isPolicyShare       = (metadataPolicy == YapDatabasePolicyShare);
 		
-		if (minSnapshot == UINT64_MAX)
+		for (YapCollectionKey *cacheKey in keysToUpdate)
 		{
-			[database asyncCheckpoint:snapshot];
+			id newMetadata = [changeset_metadataChanges objectForKey:cacheKey];
 			
-			// Note: We didn't actually change anything in the database.
-			// The vacuum operation just defragments the database file.
-			//
-			// So there's no need to do anything concerning registeredMemoryTables.
-		}
-	}
-	
-	// Post-Pseudo-Write-Transaction: Step 5 of 5
-	//
-	// Drop IsOnConnectionQueueKey flag from writeQueue since we're exiting writeQueue.
-	
-	dispatch_queue_set_specific(database->writeQueue, IsOnConnectionQueueKey, NULL, NULL);
-}
-
-/**
- * This method "kills two birds with one stone".
- * 
- * First, it invokes a SELECT statement on the database.
- * This executes the sqlite machinery to acquire a "sql-level" snapshot of the database.
- * That is, the encompassing transaction will now reference a specific commit record in the WAL,
- * and will ignore any commits made after this record.
- * 
- * Second, it reads a specific value from the database, and tells us which commit record in the WAL its using.
- * This allows us to validate the transaction, and check for a particular race condition.
-**/
-- (uint64_t)readSnapshotFromDatabase
-{
-	sqlite3_stmt *statement = [self yapGetDataForKeyStatement];
-	if (statement == NULL) return 0;
-	
-	uint64_t result = 0;
-	
-	// SELECT data FROM 'yap2' WHERE extension = ? AND key = ? ;
-	
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
-	
-	const char *extension = "";
-	sqlite3_bind_text(statement, bind_idx_extension, extension, (int)strlen(extension), SQLITE_STATIC);
-	
-	const char *key = "snapshot";
-	sqlite3_bind_text(statement, bind_idx_key, key, (int)strlen(key), SQLITE_STATIC);
-	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_ROW)
-	{
-		result = (uint64_t)sqlite3_column_int64(statement, SQLITE_COLUMN_START);
-	}
-	else if (status == SQLITE_ERROR)
-	{
-		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s",
-		                                                       status, sqlite3_errmsg(db));
+			if (newMetadata == yapNull)
+			{
+				[metadataCache removeObjectForKey:cacheKey];
+			}
+			else if (newMetadata != yapTouch)
+			{
+				if (isPolicyShare || YapDatabaseIsImmutable(newMetadata)) {
+					[metadataCache setObject:newMetadata forKey:cacheKey];
+				}
+				else if (isPolicyContainment) {
+					[metadataCache removeObjectForKey:cacheKey];
+				}
+				else // if (isPolicyCopy)
+				{
+					if ([newMetadata conformsToProtocol:@protocol(NSCopying)])
+						[metadataCache setObject:[newMetadata copy] forKey:cacheKey];
+					else
+						[metadataCache removeObjectForKey:cacheKey];
+				}
+			}
+		}
 	}
-	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	
-	return result;
 }
 
 /**
- * This method updates the 'snapshot' row in the database.
+ * Internal method.
+ *
+ * This method is invoked with an ordered list of changesets the connection hasn't processed yet.
+ * E.g. when a transaction catches up on the commits it missed, or when a long-lived read transaction ends.
+ *
+ * If the backlog is large, updating the caches once per changeset would cost time proportional
+ * to the total size of every missed commit. Whereas flushing the caches costs time proportional to the cache size.
 **/
-- (uint64_t)incrementSnapshotInDatabase
+- (void)noteCommittedChangesets:(NSArray<NSDictionary *> *)changesets
 {
-	uint64_t newSnapshot = snapshot + 1;
-	
-	sqlite3_stmt *statement = [self yapSetDataForKeyStatement];
-	if (statement == NULL) return newSnapshot;
-	
-	// INSERT OR REPLACE INTO "yap2" ("extension", "key", "data") VALUES (?, ?, ?);
-	
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
-	int const bind_idx_data      = SQLITE_BIND_START + 2;
-	
-	const char *extension = "";
-	sqlite3_bind_text(statement, bind_idx_extension, extension, (int)strlen(extension), SQLITE_STATIC);
+	// This method must be invoked from within connectionQueue.
 	
-	const char *key = "snapshot";
-	sqlite3_bind_text(statement, bind_idx_key, key, (int)strlen(key), SQLITE_STATIC);
+	NSAssert(dispatch_get_specific(IsOnConnectionQueueKey), @"Must be invoked within connectionQueue");
 	
-	sqlite3_bind_int64(statement, bind_idx_data, (sqlite3_int64)newSnapshot);
+	NSUInteger threshold = self.changesetBacklogFlushThreshold;
 	
-	int status = sqlite3_step(statement);
-	if (status != SQLITE_DONE)
+	if ((threshold > 0) && ([changesets count] > threshold))
 	{
-		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s",
-		                                                       status, sqlite3_errmsg(db));
+		YDBLogVerbose(@"Flushing caches to catch up on %lu changesets for connection %@, database %@",
+		              (unsigned long)[changesets count], self, database);
+		
+		// Only our own caches are flushed.
+		// The sharedObjectCache is kept up-to-date by the database, independently of this connection.
+		
+		[keyCache removeAllObjects];
+		[objectCache removeAllObjects];
+		[metadataCache removeAllObjects];
+		[extensionValuesCache removeAllObjects];
+		
+		isCatchingUpBacklog = YES;
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	for (NSDictionary *changeset in changesets)
+	{
+		[self noteCommittedChangeset:changeset];
+	}
 	
-	return newSnapshot;
+	isCatchingUpBacklog = NO;
 }
 
-- (void)markSqlLevelSharedReadLockAcquired
+/**
+ * Internal method.
+ *
+ * This method is invoked with the changeset from a sibling connection.
+**/
+- (void)noteCommittedChangeset:(NSDictionary *)changeset
 {
-	NSAssert(needsMarkSqlLevelSharedReadLock, @"Method called but unneeded. Unnecessary overhead.");
-	if (!needsMarkSqlLevelSharedReadLock) return;
+	// This method must be invoked from within connectionQueue.
 	
-	__block YapDatabaseConnectionState *writeStateToSignal = nil;
+	NSAssert(dispatch_get_specific(IsOnConnectionQueueKey), @"Must be invoked within connectionQueue");
 	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		// Update our connection state within the state table.
-		//
-		// We need to mark this connection as having acquired an "sql-level" shared read lock.
-		// That is, our sqlite connection has invoked a select statement, and has thus invoked the sqlite
-		// machinery that causes it to acquire the "sql-level" snapshot (last valid commit record in the WAL).
-		//
-		// While we're doing this we also check to see if we were possibly blocking a write transaction.
-		// When does a write transaction get blocked?
+	// Grab the new snapshot.
+	// This tells us the minimum snapshot we could get if we started a transaction right now.
+	
+	uint64_t changesetSnapshot = [[changeset objectForKey:YapDatabaseSnapshotKey] unsignedLongLongValue];
+	
+	if (changesetSnapshot <= snapshot)
+	{
+		// We already noted this changeset.
 		//
-		// If a write transaction goes to commit its changes and sees a read-only transaction with
-		// a "yap-level" snapshot of the in-memory metadata snapshot, but without an "sql-level" snapshot
-		// of the actual database, it will block until these read transctions either complete,
-		// or acquire the needed "sql-level" snapshot.
+		// There is a "race condition" that occasionally happens when a readonly transaction is started
+		// around the same instant a readwrite transaction finishes committing its changes to disk.
+		// The readonly transaction enters our transaction state queue (to start) before
+		// the readwrite transaction enters our transaction state queue (to finish).
+		// However the readonly transaction gets a database snapshot post readwrite commit.
+		// That is, the readonly transaction can read the changes from the readwrite transaction at the sqlite layer,
+		// even though the readwrite transaction hasn't completed within the yap database layer.
 		//
-		// So if we never acquired an "sql-level" snapshot of the database, and we were the last transaction
-		// in such a state, and there's a blocked write transaction, then we need to signal it.
+		// This race condition is handled automatically within the preReadTransaction method.
+		// In fact, it invokes this method to handle the race condition.
+		// Thus this method could be invoked twice to handle the same changeset.
+		// So catching it here and ignoring it is simply a minor optimization to avoid duplicate work.
 		
-		__block NSUInteger countOtherMaybeBlockingWriteTransaction = 0;
-		__block YapDatabaseConnectionState *blockedWriteState = nil;
+		YDBLogVerbose(@"Ignoring previously processed changeset %lu for connection %@, database %@",
+		              (unsigned long)changesetSnapshot, self, database);
 		
-		for (YapDatabaseConnectionState *state in database->connectionStates)
+		return;
+	}
+	
+	if (longLivedReadTransaction)
+	{
+		if (isFastForwarding)
 		{
-			if (state->connection == self)
-			{
-				state->sqlLevelSharedReadLock = YES;
-			}
-			else if (state->activeReadTransaction && !state->sqlLevelSharedReadLock)
-			{
-				countOtherMaybeBlockingWriteTransaction++;
-			}
-			else if (state->waitingForWriteLock)
-			{
-				blockedWriteState = state;
-			}
+			// This method is being invoked from preReadTransaction or preReadWriteTransaction.
+			// We need to process the changeset for it.
+			
+			[processedChangesets addObject:changeset];
 		}
-		
-		if (countOtherMaybeBlockingWriteTransaction == 0 && blockedWriteState)
+		else
 		{
-			writeStateToSignal = blockedWriteState;
+			// This method is being invoked from [database noteCommittedChangeset:].
+			// We cannot process the changeset yet.
+			// We must wait for the longLivedReadTransaction to be reset.
+			
+			YDBLogVerbose(@"Storing pending changeset %lu for connection %@, database %@",
+			              (unsigned long)changesetSnapshot, self, database);
+			
+			[pendingChangesets addObject:changeset];
+			[self scheduleLongLivedReadTransactionAdvance];
+			return;
 		}
-		
-	#pragma clang diagnostic pop
-	}};
+	}
 	
-	if (dispatch_get_specific(database->IsOnSnapshotQueueKey))
-		block();
-	else
-		dispatch_sync(database->snapshotQueue, block);
+	// Changeset processing
 	
-	needsMarkSqlLevelSharedReadLock = NO;
+	YDBLogVerbose(@"Processing changeset %lu for connection %@, database %@",
+	              (unsigned long)changesetSnapshot, self, database);
 	
-	if (writeStateToSignal)
+	if (snapshot == changesetSnapshot - 1)
 	{
-		YDBLogVerbose(@"YapDatabaseConnection(%p) signaling blocked write on connection(%p)",
-											 self, writeStateToSignal->connection);
-		[writeStateToSignal signalWriteLock];
+		snapshot = changesetSnapshot;
+		[self processChangeset:changeset];
 	}
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Long-Lived Transactions
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (NSArray *)beginLongLivedReadTransaction
-{
-	__block NSMutableArray *notifications = nil;
-	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	else
+	{
+		// Snapshot numbers do not match: there might have been a modification from another process.
+		// If the other process left the summaries of its changesets in the shared changelog,
+		// then we can process those first (which brings us up to changesetSnapshot - 1).
+		// Otherwise we should flush cache and then process the changeset.
 		
-		if (longLivedReadTransaction)
+		NSArray *sharedChangesets = nil;
+		if (enableMultiProcessSupport)
 		{
-			// Caller using implicit atomic reBeginLongLivedReadTransaction
-			notifications = (NSMutableArray *)[self endLongLivedReadTransaction];
+			sharedChangesets = [database sharedChangesetsSince:snapshot until:(changesetSnapshot - 1)];
 		}
 		
-		longLivedReadTransaction = [self newReadTransaction];
-		[self preReadTransaction:longLivedReadTransaction];
-		
-		// The preReadTransaction method acquires the "sqlite-level" snapshot.
-		// In doing so, if it needs to fetch and process any changesets,
-		// then it adds them to the processedChangesets ivar for us.
-		
-		if (notifications == nil)
-			notifications = [NSMutableArray arrayWithCapacity:[processedChangesets count]];
-		
-		for (NSDictionary *changeset in processedChangesets)
+		if (sharedChangesets)
 		{
-			// The changeset has already been processed.
-			
-			NSNotification *notification = [changeset objectForKey:YapDatabaseNotificationKey];
-			if (notification) {
-				[notifications addObject:notification];
+			for (NSDictionary *sharedChangeset in sharedChangesets)
+			{
+				[self noteCommittedChangeset:sharedChangeset];
 			}
 		}
+		else
+		{
+			NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
+			                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
+			
+			[self _flushMemoryWithFlags:flags];
+		}
 		
-		[processedChangesets removeAllObjects];
-		
-	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+		snapshot = changesetSnapshot;
+		[self processChangeset:changeset];
+	}
 	
-	return notifications;
+	// Allow extensions to process their individual changesets
+	//
+	// Use existing extensions (extensions ivar, not [self extensions]).
+	// There's no need to create any new extConnections at this point.
+		
+	[extensions enumerateKeysAndObjectsUsingBlock:
+	    ^(NSString *extName, YapDatabaseExtensionConnection *extConnection, BOOL __unused *stop)
+	{
+		[extConnection noteCommittedChangeset:changeset registeredName:extName];
+	}];
 }
 
-- (NSArray *)endLongLivedReadTransaction
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Changeset Inspection
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns a summary of the given notifications.
+ *
+ * The most recent summary is retained, and returned again if invoked with the same notifications.
+ * So repeatedly querying the same notifications (e.g. once per visible cell) only scans them once.
+**/
+- (YapDatabaseChangeSummary *)changeSummaryForNotifications:(NSArray<NSNotification *> *)notifications
 {
-	__block NSMutableArray *notifications = nil;
+	YapDatabaseChangeSummary *summary = nil;
 	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	YAPUnfairLockLock(&changeSummaryLock);
+	{
+		NSArray *summarized = lastChangeSummary.notifications;
+		NSUInteger count = [summarized count];
 		
-		if (longLivedReadTransaction)
+		if (lastChangeSummary && ([notifications count] == count))
 		{
-			// End the transaction (sqlite commit)
-			
-			[self postReadTransaction:longLivedReadTransaction];
-			longLivedReadTransaction = nil;
-			
-			// Now process any changesets that were pending.
-			// And extract the corresponding external notifications to return the the caller.
+			// Compare by identity (each notification is unique to its commit)
 			
-			notifications = [NSMutableArray arrayWithCapacity:[pendingChangesets count]];
-			
-			for (NSDictionary *changeset in pendingChangesets)
-			{
-				[self noteCommittedChangeset:changeset];
-				
-				NSNotification *notification = [changeset objectForKey:YapDatabaseNotificationKey];
-				if (notification) {
-					[notifications addObject:notification];
+			BOOL matches = YES;
+			for (NSUInteger i = 0; i < count; i++)
+			{
+				if ([summarized objectAtIndex:i] != [notifications objectAtIndex:i])
+				{
+					matches = NO;
+					break;
 				}
 			}
 			
-			[pendingChangesets removeAllObjects];
+			if (matches) {
+				summary = lastChangeSummary;
+			}
 		}
+	}
+	YAPUnfairLockUnlock(&changeSummaryLock);
+	
+	if (summary == nil)
+	{
+		summary = [[YapDatabaseChangeSummary alloc] initWithNotifications:notifications];
 		
-	#pragma clang diagnostic pop
-	}};
+		YAPUnfairLockLock(&changeSummaryLock);
+		{
+			lastChangeSummary = summary;
+		}
+		YAPUnfairLockUnlock(&changeSummaryLock);
+	}
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	return summary;
+}
+
+- (BOOL)hasChangeForCollection:(NSString *)collection inNotifications:(NSArray *)notifications
+{
+	return [[self changeSummaryForNotifications:notifications] hasChangeForCollection:collection];
+}
+
+- (BOOL)hasObjectChangeForCollection:(NSString *)collection inNotifications:(NSArray *)notifications
+{
+	return [[self changeSummaryForNotifications:notifications] hasObjectChangeForCollection:collection];
+}
+
+- (BOOL)hasMetadataChangeForCollection:(NSString *)collection inNotifications:(NSArray *)notifications
+{
+	return [[self changeSummaryForNotifications:notifications] hasMetadataChangeForCollection:collection];
+}
+
+// Query for a change to a particular key/collection tuple
+
+- (BOOL)hasChangeForKey:(NSString *)key
+           inCollection:(NSString *)collection
+        inNotifications:(NSArray *)notifications
+{
+	if (key == nil) return NO;
 	
-	return notifications;
+	return [[self changeSummaryForNotifications:notifications] hasChangeForKey:key inCollection:collection];
 }
 
-- (BOOL)isInLongLivedReadTransaction
+- (BOOL)hasObjectChangeForKey:(NSString *)key
+                 inCollection:(NSString *)collection
+              inNotifications:(NSArray *)notifications
 {
-	__block BOOL result = NO;
+	if (key == nil) return NO;
 	
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		result = (longLivedReadTransaction != nil);
-		
-	#pragma clang diagnostic pop
-	};
+	return [[self changeSummaryForNotifications:notifications] hasObjectChangeForKey:key inCollection:collection];
+}
+
+- (BOOL)hasMetadataChangeForKey:(NSString *)key
+                   inCollection:(NSString *)collection
+                inNotifications:(NSArray *)notifications
+{
+	if (key == nil) return NO;
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	return [[self changeSummaryForNotifications:notifications] hasMetadataChangeForKey:key inCollection:collection];
+}
+
+// Query for a change to a particular set of keys in a collection
+
+- (BOOL)hasChangeForAnyKeys:(NSSet *)keys
+               inCollection:(NSString *)collection
+            inNotifications:(NSArray *)notifications
+{
+	if ([keys count] == 0) return NO;
 	
-	return result;
+	return [[self changeSummaryForNotifications:notifications] hasChangeForAnyKeys:keys inCollection:collection];
 }
 
-- (void)enableExceptionsForImplicitlyEndingLongLivedReadTransaction
+- (BOOL)hasObjectChangeForAnyKeys:(NSSet *)keys
+                     inCollection:(NSString *)collection
+                  inNotifications:(NSArray *)notifications
 {
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		throwExceptionsForImplicitlyEndingLongLivedReadTransaction = YES;
-		
-	#pragma clang diagnostic pop
-	};
+	if ([keys count] == 0) return NO;
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_async(connectionQueue, block);
+	return [[self changeSummaryForNotifications:notifications] hasObjectChangeForAnyKeys:keys inCollection:collection];
 }
 
-- (void)disableExceptionsForImplicitlyEndingLongLivedReadTransaction
+- (BOOL)hasMetadataChangeForAnyKeys:(NSSet *)keys
+                       inCollection:(NSString *)collection
+                    inNotifications:(NSArray *)notifications
 {
-	dispatch_block_t block = ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		throwExceptionsForImplicitlyEndingLongLivedReadTransaction = NO;
-		
-	#pragma clang diagnostic pop
-	};
+	if ([keys count] == 0) return NO;
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_async(connectionQueue, block);
+	return [[self changeSummaryForNotifications:notifications] hasMetadataChangeForAnyKeys:keys inCollection:collection];
 }
 
+// Advanced query techniques
+
 /**
- * Long-lived read transactions are a great way to achive stability, especially in places like the main-thread.
- * However, they pose a unique problem. These long-lived transactions often start out by
- * locking the WAL (write ahead log). This prevents the WAL from ever getting reset,
- * and thus causes the WAL to potentially grow infinitely large. In order to allow the WAL to get properly reset,
- * we need the long-lived read transactions to "reset". That is, without changing their stable state (their snapshot),
- * we need them to restart the transaction, but this time without locking this WAL.
+ * Returns YES if [transaction removeAllObjectsInCollection:] was invoked on the collection,
+ * or if [transaction removeAllObjectsInAllCollections] was invoked
+ * during any of the commits represented by the given notifications.
  * 
- * In other words, if commit X is the most recent commit, and the connection is reading commit X from the WAL,
- * then we want to reset the connection such that it's reading commit X directly from the database file.
- * This will mean the WAL is no longer locked, and can be reset on the next write.
+ * If this was the case then YapDatabase may not have tracked every single key within the collection.
+ * And thus a key that was removed via clearing the collection may not show up while enumerating changedKeys.
+ *
+ * This method is designed to be used in conjunction with the enumerateChangedKeys.... methods (below).
+ * The hasChange... methods (above) already take this into account.
+**/
+- (BOOL)didClearCollection:(NSString *)collection inNotifications:(NSArray *)notifications
+{
+	return [[self changeSummaryForNotifications:notifications] didClearCollection:collection];
+}
+
+/**
+ * Returns YES if the collection was changed by a transaction with coarseChangeset enabled,
+ * during any of the commits represented by the given notifications.
  * 
- * We use this method as part of the solution to achieving this.
+ * If this was the case then YapDatabase did not track the individual keys that were changed within the collection.
+ * And thus a changed key won't show up while enumerating changedKeys.
+ *
+ * This method is designed to be used in conjunction with the enumerateChangedKeys.... methods (below).
+ * The hasChange... methods (above) already take this into account.
 **/
-- (BOOL)resetLongLivedReadTransaction
+- (BOOL)didResetCollection:(NSString *)collection inNotifications:(NSArray *)notifications
 {
-	if (longLivedReadTransaction && (snapshot == [database snapshot]))
-	{
-		NSArray *empty = [self beginLongLivedReadTransaction];
-	
-		if ([empty count] != 0)
-		{
-			YDBLogError(@"Core logic failure! "
-							@"Silent longLivedReadTransaction reset resulted in non-empty notification array!");
-		}
-		
-		return YES;
-	}
-	
-	return NO;
+	return [[self changeSummaryForNotifications:notifications] didResetCollection:collection];
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Changeset Architecture
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Returns YES if [transaction removeAllObjectsInAllCollections] was invoked
+ * during any of the commits represented by the given notifications.
+ *
+ * If this was the case then YapDatabase may not have tracked every single key within every single collection.
+ * And thus a key that was removed via clearing the database may not show up while enumerating changedKeys.
+ *
+ * This method is designed to be used in conjunction with the enumerateChangedKeys.... methods (below).
+ * The hasChange... methods (above) already take this into account.
+**/
+- (BOOL)didClearAllCollectionsInNotifications:(NSArray *)notifications
+{
+	return [self changeSummaryForNotifications:notifications].didClearAllCollections;
+}
 
 /**
- * The creation of changeset dictionaries happens constantly.
- * So, to optimize a bit, we use sharedKeySet's (part of NSDictionary).
- * 
- * See ivar 'sharedKeySetForInternalChangeset'
+ * Allows you to enumerate all the changed keys in the given collection, for the given commits.
+ *
+ * Keep in mind that if [transaction removeAllObjectsInCollection:] was invoked on the given collection
+ * or [transaction removeAllObjectsInAllCollections] was invoked
+ * during any of the commits represented by the given notifications,
+ * then the key may not be included in the enumeration.
+ * You must use didClearCollection:inNotifications: or didClearAllCollectionsInNotifications:
+ * if you need to handle that case.
+ *
+ * @see didClearCollection:inNotifications:
+ * @see didClearAllCollectionsInNotifications:
 **/
-- (NSArray *)internalChangesetKeys
+- (void)enumerateChangedKeysInCollection:(NSString *)collection
+                         inNotifications:(NSArray *)notifications
+                              usingBlock:(void (^)(NSString *key, BOOL *stop))block
 {
-	return @[ YapDatabaseSnapshotKey,
-	          YapDatabaseExtensionsKey,
-	          YapDatabaseRegisteredExtensionsKey,
-	          YapDatabaseRegisteredMemoryTablesKey,
-	          YapDatabaseExtensionsOrderKey,
-	          YapDatabaseExtensionDependenciesKey,
-	          YapDatabaseNotificationKey,
-	          YapDatabaseObjectChangesKey,
-	          YapDatabaseMetadataChangesKey,
-	          YapDatabaseRemovedKeysKey,
-	          YapDatabaseRemovedCollectionsKey,
-	          YapDatabaseRemovedRowidsKey,
-	          YapDatabaseAllKeysRemovedKey,
-	          YapDatabaseModifiedExternallyKey ];
+	if (block == NULL) return;
+	
+	[[self changeSummaryForNotifications:notifications] enumerateChangedKeysInCollection:collection usingBlock:block];
 }
 
 /**
- * The creation of changeset dictionaries happens constantly.
- * So, to optimize a bit, we use sharedKeySet's (part of NSDictionary).
+ * Allows you to enumerate all the changed collection/key tuples for the given commits.
  *
- * See ivar 'sharedKeySetForExternalChangeset'
+ * Keep in mind that if [transaction removeAllObjectsInCollection:] was invoked on the given collection
+ * or [transaction removeAllObjectsInAllCollections] was invoked
+ * during any of the commits represented by the given notifications,
+ * then the collection/key tuple may not be included in the enumeration.
+ * You must use didClearCollection:inNotifications: or didClearAllCollectionsInNotifications:
+ * if you need to handle that case.
+ *
+ * @see didClearCollection:inNotifications:
+ * @see didClearAllCollectionsInNotifications:
 **/
-- (NSArray *)externalChangesetKeys
+- (void)enumerateChangedCollectionKeysInNotifications:(NSArray *)notifications
+                                           usingBlock:(void (^)(YapCollectionKey *ck, BOOL *stop))block
 {
-	return @[ YapDatabaseSnapshotKey,
-	          YapDatabaseConnectionKey,
-	          YapDatabaseExtensionsKey,
-	          YapDatabaseCustomKey,
-	          YapDatabaseObjectChangesKey,
-	          YapDatabaseMetadataChangesKey,
-	          YapDatabaseRemovedKeysKey,
-	          YapDatabaseRemovedCollectionsKey,
-	          YapDatabaseAllKeysRemovedKey,
-	          YapDatabaseModifiedExternallyKey ];
+	if (block == NULL) return;
+	
+	[[self changeSummaryForNotifications:notifications] enumerateChangedCollectionKeysUsingBlock:block];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Extensions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * This method is invoked from within the postReadWriteTransaction operation.
- * This method is invoked before anything has been committed.
+ * Creates or fetches the extension with the given name.
+ * If this connection has not yet initialized the proper extensions connection, it is done automatically.
  *
- * If changes have been made, it should return a changeset dictionary.
- * If no changes have been made, it should return nil.
- * 
- * @see processChangeset:
+ * @return
+ *     A subclass of YapDatabaseExtensionConnection,
+ *     according to the type of extension registered under the given name.
+ *
+ * One must register an extension with the database before it can be accessed from within connections or transactions.
+ * After registration everything works automatically using just the registered extension name.
+ *
+ * @see [YapDatabase registerExtension:withName:]
 **/
-- (void)getInternalChangeset:(NSMutableDictionary **)internalChangesetPtr
-           externalChangeset:(NSMutableDictionary **)externalChangesetPtr
+- (id)extension:(NSString *)extName
 {
-	// Step 1 of 2 - Process extensions
+	// This method is PUBLIC.
 	//
-	// Note: Use existing extensions (extensions ivar, not [self extensions]).
-	// There's no need to create any new extConnections at this point.
+	// This method returns a subclass of YapDatabaseExtensionConnection.
+	// To get:
+	// - YapDatabaseExtension            => [database registeredExtension:@"registeredNameOfExtension"]
+	// - YapDatabaseExtensionConnection  => [databaseConnection extension:@"registeredNameOfExtension"]
+	// - YapDatabaseExtensionTransaction => [databaseTransaction extension:@"registeredNameOfExtension"]
 	
-	__block NSMutableDictionary *internalChangeset_extensions = nil;
-	__block NSMutableDictionary *externalChangeset_extensions = nil;
+	__block id extConnection = nil;
 	
-	[extensions enumerateKeysAndObjectsUsingBlock:^(id extName, id extConnectionObj, BOOL __unused *stop) {
+	dispatch_block_t block = ^{
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		__unsafe_unretained YapDatabaseExtensionConnection *extConnection = extConnectionObj;
-		
-		NSMutableDictionary *internal = nil;
-		NSMutableDictionary *external = nil;
-		BOOL extHasDiskChanges = NO;
-		
-		[extConnection getInternalChangeset:&internal
-		                  externalChangeset:&external
-		                     hasDiskChanges:&extHasDiskChanges];
+		extConnection = [extensions objectForKey:extName];
 		
-		if (internal)
-		{
-			if (internalChangeset_extensions == nil)
-				internalChangeset_extensions =
-				    [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExtensions];
-			
-			[internalChangeset_extensions setObject:internal forKey:extName];
-		}
-		if (external)
+		if (!extConnection && !extensionsReady)
 		{
-			if (externalChangeset_extensions == nil)
-				externalChangeset_extensions =
-				    [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExtensions];
+			// We don't have an existing connection for the extension.
+			// Create one (if we can).
 			
-			[externalChangeset_extensions setObject:external forKey:extName];
-		}
-		if (extHasDiskChanges && !hasDiskChanges)
-		{
-			hasDiskChanges = YES;
+			YapDatabaseExtension *ext = [registeredExtensions objectForKey:extName];
+			if (ext)
+			{
+				extConnection = [ext newConnection:self];
+				[extensions setObject:extConnection forKey:extName];
+			}
 		}
 		
 	#pragma clang diagnostic pop
-	}];
-	
-	NSMutableDictionary *internalChangeset = nil;
-	NSMutableDictionary *externalChangeset = nil;
-	
-	if (internalChangeset_extensions)
-	{
-		internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
-		[internalChangeset setObject:internalChangeset_extensions forKey:YapDatabaseExtensionsKey];
-	}
-	
-	if (externalChangeset_extensions)
-	{
-		externalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
-		[externalChangeset setObject:externalChangeset_extensions forKey:YapDatabaseExtensionsKey];
-	}
-	
-	if (registeredExtensionsChanged)
-	{
-		if (internalChangeset == nil)
-			internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
-		
-		[internalChangeset setObject:registeredExtensions forKey:YapDatabaseRegisteredExtensionsKey];
-		[internalChangeset setObject:extensionsOrder forKey:YapDatabaseExtensionsOrderKey];
-		[internalChangeset setObject:extensionDependencies forKey:YapDatabaseExtensionDependenciesKey];
-	}
+	};
 	
-	if (registeredMemoryTablesChanged)
-	{
-		if (internalChangeset == nil)
-			internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
-		
-		[internalChangeset setObject:registeredMemoryTables forKey:YapDatabaseRegisteredMemoryTablesKey];
-	}
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
 	
-	// Step 2 of 2 - Process database changes
+	return extConnection;
+}
+
+- (id)ext:(NSString *)extensionName
+{
+	// The "+ (void)load" method swizzles the implementation of this class
+	// to point to the implementation of the extension: method.
 	//
-	// Throughout the readwrite transaction we've been keeping a list of what changed.
-	// Copy this change information into the changeset for processing by other connections.
+	// So the two methods are literally the same thing.
 	
-	if ([objectChanges count]      > 0 ||
-	    [metadataChanges count]    > 0 ||
-	    [insertedKeys count]       > 0 ||
-	    [removedKeys count]        > 0 ||
-	    [removedCollections count] > 0 ||
-	    [removedRowids count]      > 0 || allKeysRemoved)
+	return [self extension:extensionName]; // This method is swizzled !
+}
+
+- (NSDictionary *)extensions
+{
+	// This method is INTERNAL
+	
+	if (!extensionsReady)
 	{
-		if (internalChangeset == nil)
-			internalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForInternalChangeset];
-		
-		if (externalChangeset == nil)
-			externalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
-		
-		if ([objectChanges count] > 0)
-		{
-			internalChangeset[YapDatabaseObjectChangesKey] = objectChanges;
-			
-			YapSet *immutableObjectChanges = [[YapSet alloc] initWithDictionary:objectChanges];
-			externalChangeset[YapDatabaseObjectChangesKey] = immutableObjectChanges;
-		}
-		
-		if ([metadataChanges count] > 0)
-		{
-			internalChangeset[YapDatabaseMetadataChangesKey] = metadataChanges;
-			
-			YapSet *immutableMetadataChanges = [[YapSet alloc] initWithDictionary:metadataChanges];
-			externalChangeset[YapDatabaseMetadataChangesKey] = immutableMetadataChanges;
-		}
-		
-		if ([insertedKeys count] > 0)
-		{
-			internalChangeset[YapDatabaseInsertedKeysKey] = insertedKeys;
+		[registeredExtensions enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 			
-			YapSet *immutableInsertedKeys = [[YapSet alloc] initWithSet:insertedKeys];
-			externalChangeset[YapDatabaseInsertedKeysKey] = immutableInsertedKeys;
-		}
-		
-		if ([removedKeys count] > 0)
-		{
-			internalChangeset[YapDatabaseRemovedKeysKey] = removedKeys;
+			__unsafe_unretained NSString *extName = key;
+			__unsafe_unretained YapDatabaseExtension *ext = obj;
 			
-			YapSet *immutableRemovedKeys = [[YapSet alloc] initWithSet:removedKeys];
-			externalChangeset[YapDatabaseRemovedKeysKey] = immutableRemovedKeys;
-		}
-		
-		if ([removedCollections count] > 0)
-		{
-			internalChangeset[YapDatabaseRemovedCollectionsKey] = removedCollections;
+			if ([extensions objectForKey:extName] == nil)
+			{
+				id extConnection = [ext newConnection:self];
+				[extensions setObject:extConnection forKey:extName];
+			}
 			
-			YapSet *immutableRemovedCollections = [[YapSet alloc] initWithSet:removedCollections];
-			externalChangeset[YapDatabaseRemovedCollectionsKey] = immutableRemovedCollections;
-		}
-		
-		if ([removedRowids count] > 0)
-		{
-			internalChangeset[YapDatabaseRemovedRowidsKey] = removedRowids;
-		}
+		#pragma clang diagnostic pop
+		}];
 		
-		if (allKeysRemoved)
-		{
-			internalChangeset[YapDatabaseAllKeysRemovedKey] = @(YES);
-			externalChangeset[YapDatabaseAllKeysRemovedKey] = @(YES);
-		}
-        
-        if (externallyModified)
-        {
-            internalChangeset[YapDatabaseModifiedExternallyKey] = @(YES);
-            externalChangeset[YapDatabaseModifiedExternallyKey] = @(YES);
-        }
+		extensionsReady = YES;
 	}
 	
-	*internalChangesetPtr = internalChangeset;
-	*externalChangesetPtr = externalChangeset;
+	return extensions;
 }
 
-/**
- * This method is invoked with the changeset from a sibling connection.
- * The connection should update any in-memory components (such as the cache) to properly reflect the changeset.
- *
- * @see getInternalChangeset:externalChangeset:
-**/
-- (void)processChangeset:(NSDictionary *)changeset
+- (BOOL)registerExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName
 {
-	// Did registered extensions change ?
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must go through writeQueue.");
 	
-	NSDictionary *changeset_registeredExtensions = [changeset objectForKey:YapDatabaseRegisteredExtensionsKey];
-	if (changeset_registeredExtensions)
-	{
-		// Retain new lists
-		
-		registeredExtensions = changeset_registeredExtensions;
-		extensionsOrder = [changeset objectForKey:YapDatabaseExtensionsOrderKey];
-		extensionDependencies = [changeset objectForKey:YapDatabaseExtensionDependenciesKey];
-		
-		// Remove any extensions that have been dropped
+	__block BOOL result = NO;
+	
+	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		for (NSString *extName in [extensions allKeys])
-		{
-			if ([registeredExtensions objectForKey:extName] == nil)
-			{
-				YDBLogVerbose(@"Dropping extension: %@", extName);
-				
-				[extensions removeObjectForKey:extName];
-			}
-		}
+		YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
+		[self preReadWriteTransaction:transaction];
 		
-		// Make a note if there are extensions for which we haven't instantiated an extConnection instance.
-		// We lazily load these later, if needed.
+		YapDatabaseExtensionConnection *extensionConnection;
+		YapDatabaseExtensionTransaction *extensionTransaction;
 		
-		extensionsReady = ([registeredExtensions count] == [extensions count]);
-	}
-	
-	// Did registered memory tables change ?
-	
-	NSDictionary *changeset_registeredMemoryTables = [changeset objectForKey:YapDatabaseRegisteredMemoryTablesKey];
-	if (changeset_registeredMemoryTables)
-	{
-		registeredMemoryTables = changeset_registeredMemoryTables;
-	}
-	
-	// Process normal database changeset information
-	
-	NSDictionary *changeset_objectChanges   =  [changeset objectForKey:YapDatabaseObjectChangesKey];
-	NSDictionary *changeset_metadataChanges =  [changeset objectForKey:YapDatabaseMetadataChangesKey];
-	
-	NSSet *changeset_removedRowids      = [changeset objectForKey:YapDatabaseRemovedRowidsKey];
-	NSSet *changeset_removedKeys        = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-	NSSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-	
-	BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-	BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-	
-	BOOL hasObjectChanges      = [changeset_objectChanges count] > 0;
-	BOOL hasMetadataChanges    = [changeset_metadataChanges count] > 0;
-	BOOL hasRemovedKeys        = [changeset_removedKeys count] > 0;
-	BOOL hasRemovedCollections = [changeset_removedCollections count] > 0;
-	
-	// Check for external modification (special case)
-	
-	if (changeset_modifiedExternally)
-	{
-		NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
-		                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
+		extensionConnection = [extension newConnection:self];
+		extensionTransaction = [extensionConnection newReadWriteTransaction:transaction];
 		
-		[self _flushMemoryWithFlags:flags];
-	}
-	
-	// Update keyCache
-	
-	if (changeset_allKeysRemoved)
-	{
-		// Shortcut: Everything was removed from the database
+		// Fetch the persisted state of the extension (class, versionTag, etc) with a single query.
+		[transaction prefetchValuesForExtensions:@[ extensionName ]];
 		
-		[keyCache removeAllObjects];
-	}
-	else
-	{
-		if (changeset_removedRowids)
+		BOOL needsClassValue = NO;
+		[self willRegisterExtension:extension
+		                   withName:extensionName
+		                transaction:transaction
+		            needsClassValue:&needsClassValue];
+		
+		YDBSignpostID signpost = YDBSignpostBegin("Extension Populate", "extension: %{public}@", extensionName);
+		
+		result = [extensionTransaction createIfNeeded];
+		transaction->prefetchedValues = nil;
+		
+		YDBSignpostEnd(signpost, "Extension Populate", "success: %d", (int)result);
+		
+		if (result)
 		{
-			[keyCache removeObjectsForKeys:changeset_removedRowids];
+			[self didRegisterExtension:extension
+			                  withName:extensionName
+			               transaction:transaction
+			           needsClassValue:needsClassValue];
+			
+			[self addRegisteredExtensionConnection:extensionConnection withName:extensionName];
+			[transaction addRegisteredExtensionTransaction:extensionTransaction withName:extensionName];
 		}
-		
-		if (hasRemovedCollections)
+		else
 		{
-			__block NSMutableArray *toRemove = nil;
-			[keyCache enumerateKeysAndObjectsWithBlock:^(id key, id obj, BOOL __unused *stop) {
-				
-				__unsafe_unretained NSNumber *rowidNumber = (NSNumber *)key;
-				__unsafe_unretained YapCollectionKey *collectionKey = (YapCollectionKey *)obj;
-				
-				if ([changeset_removedCollections containsObject:collectionKey.collection])
-				{
-					if (toRemove == nil)
-						toRemove = [NSMutableArray array];
-					
-					[toRemove addObject:rowidNumber];
-				}
-			}];
+			// Registration failed.
 			
-			[keyCache removeObjectsForKeys:toRemove];
+			[transaction rollback];
 		}
-	}
+		
+		[self postReadWriteTransaction:transaction];
+		registeredExtensionsChanged = NO;
+		
+	#pragma clang diagnostic pop
+	}});
 	
-	// Update objectCache
+	return result;
+}
+
+/**
+ * Registers multiple extensions within a single readwrite transaction.
+ * The extensions must already be sorted such that dependencies come first.
+ *
+ * Extensions that support it defer their population to the transaction's extensionPopulation,
+ * which enumerates the database a single time for all of them.
+ * Before creating an extension that depends on a pending extension, the pending population is run,
+ * so the dependency is fully populated beforehand (e.g. a filteredView enumerates its parent view).
+ *
+ * The registration is all-or-nothing: if any extension fails, the transaction is rolled back.
+**/
+- (BOOL)registerExtensions:(NSArray<YapDatabaseExtension *> *)inExtensions withNames:(NSArray<NSString *> *)names
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must go through writeQueue.");
+	NSAssert([inExtensions count] == [names count], @"Mismatched extensions & names");
 	
-	if (changeset_allKeysRemoved && !hasObjectChanges)
-	{
-		// Shortcut: Everything was removed from the database
+	__block BOOL result = YES;
+	
+	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		[objectCache removeAllObjects];
-	}
-	else if (hasObjectChanges && !hasRemovedKeys && !hasRemovedCollections && !changeset_allKeysRemoved)
-	{
-		// Shortcut: Nothing was removed from the database.
-		// So we can simply enumerate over the changes and update the cache inline as needed.
+		YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
+		[self preReadWriteTransaction:transaction];
 		
-		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
-		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
+		YapDatabaseExtensionPopulation *population = [[YapDatabaseExtensionPopulation alloc] init];
+		transaction->extensionPopulation = population;
 		
-		BOOL isPolicyContainment = (objectPolicy == YapDatabasePolicyContainment);
-		BOOL isPolicyShare       = (objectPolicy == YapDatabasePolicyShare);
+		NSMutableArray<NSString *> *didRegisterNames = [NSMutableArray arrayWithCapacity:[names count]];
 		
-		[changeset_objectChanges enumerateKeysAndObjectsUsingBlock:^(id key, id newObject, BOOL __unused *stop) {
-		#pragma clang diagnostic push
-		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		// Fetch the persisted state of every extension in the batch (class, versionTag, etc) with a single query.
+		// In the common case (extensions that are already setup), createIfNeeded doesn't need to touch the disk.
+		[transaction prefetchValuesForExtensions:names];
 		
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+		NSUInteger index = 0;
+		for (YapDatabaseExtension *extension in inExtensions)
+		{
+			NSString *extensionName = names[index++];
 			
-			if ([objectCache containsKey:cacheKey])
+			for (NSString *dependency in [extension dependencies])
 			{
-				if (newObject == yapNull)
-				{
-					[objectCache removeObjectForKey:cacheKey];
-				}
-				else if (newObject != yapTouch)
+				if ([population hasParticipantWithName:dependency])
 				{
-					if (isPolicyContainment) {
-						[objectCache removeObjectForKey:cacheKey];
-					}
-					else if (isPolicyShare) {
-						[objectCache setObject:newObject forKey:cacheKey];
-					}
-					else // if (isPolicyCopy)
-					{
-						if ([newObject conformsToProtocol:@protocol(NSCopying)])
-							[objectCache setObject:[newObject copy] forKey:cacheKey];
-						else
-							[objectCache removeObjectForKey:cacheKey];
-					}
+					[population populateWithTransaction:transaction];
+					break;
 				}
 			}
 			
-		#pragma clang diagnostic pop
-		}];
-	}
-	else if (hasObjectChanges || hasRemovedKeys || hasRemovedCollections)
-	{
-		NSUInteger updateCapacity = MIN([objectCache count], [changeset_objectChanges count]);
-		NSUInteger removeCapacity = MIN([objectCache count], [changeset_removedKeys count]);
-		
-		NSMutableArray *keysToUpdate = [NSMutableArray arrayWithCapacity:updateCapacity];
-		NSMutableArray *keysToRemove = [NSMutableArray arrayWithCapacity:removeCapacity];
-		
-		[objectCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+			YapDatabaseExtensionConnection *extensionConnection = [extension newConnection:self];
+			YapDatabaseExtensionTransaction *extensionTransaction =
+			  [extensionConnection newReadWriteTransaction:transaction];
 			
-			// Order matters.
-			// Consider the following database change:
-			//
-			// [transaction removeAllObjectsInAllCollections];
-			// [transaction setObject:obj forKey:key inCollection:collection];
+			BOOL needsClassValue = NO;
+			[self willRegisterExtension:extension
+			                   withName:extensionName
+			                transaction:transaction
+			            needsClassValue:&needsClassValue];
 			
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			YDBSignpostID signpost = YDBSignpostBegin("Extension Populate", "extension: %{public}@", extensionName);
 			
-			if ([changeset_objectChanges objectForKey:cacheKey])
-			{
-				[keysToUpdate addObject:key];
-			}
-			else if ([changeset_removedKeys containsObject:cacheKey] ||
-					 [changeset_removedCollections containsObject:cacheKey.collection] || changeset_allKeysRemoved)
+			BOOL created = [extensionTransaction createIfNeeded];
+			
+			YDBSignpostEnd(signpost, "Extension Populate", "success: %d", (int)created);
+			
+			if (!created)
 			{
-				[keysToRemove addObject:key];
+				YDBLogError(@"Error registering extension(%@): createIfNeeded failed", extensionName);
+				
+				result = NO;
+				break;
 			}
-		}];
+			
+			[self didRegisterExtension:extension
+			                  withName:extensionName
+			               transaction:transaction
+			           needsClassValue:needsClassValue];
+			
+			[self addRegisteredExtensionConnection:extensionConnection withName:extensionName];
+			[transaction addRegisteredExtensionTransaction:extensionTransaction withName:extensionName];
+			
+			[didRegisterNames addObject:extensionName];
+		}
 		
-		[objectCache removeObjectsForKeys:keysToRemove];
+		transaction->prefetchedValues = nil;
 		
-		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
-		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
+		if (result)
+		{
+			[population populateWithTransaction:transaction];
+		}
 		
-		BOOL isPolicyContainment = (objectPolicy == YapDatabasePolicyContainment);
-		BOOL isPolicyShare       = (objectPolicy == YapDatabasePolicyShare);
+		transaction->extensionPopulation = nil;
 		
-		for (YapCollectionKey *cacheKey in keysToUpdate)
+		if (!result)
 		{
-			id newObject = [changeset_objectChanges objectForKey:cacheKey];
+			// Registration failed.
+			// Undo the registration of the extensions that were created before the failure.
 			
-			if (newObject == yapNull)
-			{
-				[objectCache removeObjectForKey:cacheKey];
-			}
-			else if (newObject != yapTouch)
+			[transaction rollback];
+		}
+		
+		[self postReadWriteTransaction:transaction];
+		
+		if (!result)
+		{
+			for (NSString *extensionName in [didRegisterNames reverseObjectEnumerator])
 			{
-				if (isPolicyContainment) {
-					[objectCache removeObjectForKey:cacheKey];
-				}
-				else if (isPolicyShare) {
-					[objectCache setObject:newObject forKey:cacheKey];
-				}
-				else // if (isPolicyCopy)
-				{
-					if ([newObject conformsToProtocol:@protocol(NSCopying)])
-						[objectCache setObject:[newObject copy] forKey:cacheKey];
-					else
-						[objectCache removeObjectForKey:cacheKey];
-				}
+				[self didUnregisterExtensionWithName:extensionName];
+				[self removeRegisteredExtensionConnectionWithName:extensionName];
 			}
 		}
-	}
-	
-	// Update metadataCache
-	
-	if (changeset_allKeysRemoved && !hasMetadataChanges)
-	{
-		// Shortcut: Everything was removed from the database
 		
-		[metadataCache removeAllObjects];
-	}
-	else if (hasMetadataChanges && !hasRemovedKeys && !hasRemovedCollections && !changeset_allKeysRemoved)
-	{
-		// Shortcut: Nothing was removed from the database.
-		// So we can simply enumerate over the changes and update the cache inline as needed.
+		registeredExtensionsChanged = NO;
 		
-		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
-		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
+	#pragma clang diagnostic pop
+	}});
+	
+	return result;
+}
+
+- (void)unregisterExtensionWithName:(NSString *)extensionName
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must go through writeQueue.");
+	
+	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		BOOL isPolicyContainment = (metadataPolicy == YapDatabasePolicyContainment);
-		BOOL isPolicyShare       = (metadataPolicy == YapDatabasePolicyShare);
+		YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
+		[self preReadWriteTransaction:transaction];
 		
-		[changeset_metadataChanges enumerateKeysAndObjectsUsingBlock:^(id key, id newMetadata, BOOL __unused *stop) {
-		#pragma clang diagnostic push
-		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-			
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			
-			if ([metadataCache containsKey:cacheKey])
-			{
-				if (newMetadata == yapNull)
-				{
-					[metadataCache removeObjectForKey:cacheKey];
-				}
-				else if (newMetadata != yapTouch)
-				{
-					if (isPolicyContainment) {
-						[metadataCache removeObjectForKey:cacheKey];
-					}
-					else if (isPolicyShare) {
-						[metadataCache setObject:newMetadata forKey:cacheKey];
-					}
-					else // if (isPolicyCopy)
-					{
-						if ([newMetadata conformsToProtocol:@protocol(NSCopying)])
-							[metadataCache setObject:[newMetadata copy] forKey:cacheKey];
-						else
-							[metadataCache removeObjectForKey:cacheKey];
-					}
-				}
-			}
-			
-		#pragma clang diagnostic pop
-		}];
-	}
-	else if (hasMetadataChanges || hasRemovedKeys || hasRemovedCollections)
-	{
-		NSUInteger updateCapacity = MIN([metadataCache count], [changeset_metadataChanges count]);
-		NSUInteger removeCapacity = MIN([metadataCache count], [changeset_removedKeys count]);
+		// Unregister the given extension
 		
-		NSMutableArray *keysToUpdate = [NSMutableArray arrayWithCapacity:updateCapacity];
-		NSMutableArray *keysToRemove = [NSMutableArray arrayWithCapacity:removeCapacity];
+		YapDatabaseExtension *extension = [registeredExtensions objectForKey:extensionName];
 		
-		[metadataCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
-			
-			// Order matters.
-			// Consider the following database change:
-			//
-			// [transaction removeAllObjectsInAllCollections];
-			// [transaction setObject:obj forKey:key inCollection:collection];
+		[self _unregisterExtensionWithName:extensionName transaction:transaction];
+		extension.registeredName = nil;
+		extension.registeredDatabase = nil;
+		
+		// Automatically unregister any extensions that were dependent upon this one.
+		
+		NSMutableArray *extensionNameStack = [NSMutableArray arrayWithCapacity:1];
+		[extensionNameStack addObject:extensionName];
+		
+		do
+		{
+			NSString *currentExtensionName = [extensionNameStack lastObject];
 			
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			__block NSString *dependentExtName = nil;
+			[extensionDependencies enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop){
+				
+			//	__unsafe_unretained NSString *extName = (NSString *)key;
+				__unsafe_unretained NSSet *extDependencies = (NSSet *)obj;
+				
+				if ([extDependencies containsObject:currentExtensionName])
+				{
+					dependentExtName = (NSString *)key;
+					*stop = YES;
+				}
+			}];
 			
-			if ([changeset_metadataChanges objectForKey:cacheKey])
+			if (dependentExtName)
 			{
-				[keysToUpdate addObject:key];
+				// We found an extension that was dependent upon the one we just unregistered.
+				// So we need to unregister it too.
+				
+				YapDatabaseExtension *dependentExt = [registeredExtensions objectForKey:dependentExtName];
+				
+				[self _unregisterExtensionWithName:dependentExtName transaction:transaction];
+				dependentExt.registeredName = nil;
+				
+				// And now we need to check and see if there were any extensions dependent upon this new one.
+				// So we add it to the top of the stack, and continue our search.
+				
+				[extensionNameStack addObject:dependentExtName];
 			}
-			else if ([changeset_removedKeys containsObject:cacheKey] ||
-					 [changeset_removedCollections containsObject:cacheKey.collection] || changeset_allKeysRemoved)
+			else
 			{
-				[keysToRemove addObject:key];
+				[extensionNameStack removeLastObject];
 			}
-		}];
+			
+		} while ([extensionNameStack count] > 0);
 		
-		[metadataCache removeObjectsForKeys:keysToRemove];
 		
-		id yapNull = [YapNull null];    // value == yapNull  : setPrimitive or containment policy
-		id yapTouch = [YapTouch touch]; // value == yapTouch : touchObjectForKey: was used
+		// Complete the transaction
+		[self postReadWriteTransaction:transaction];
 		
-		BOOL isPolicyContainment = (metadataPolicy == YapDatabasePolicyContainment);
-		BOOL isPolicyShare       = (metadataPolicy == YapDatabasePolicyShare);
+		// And reset the registeredExtensionsChanged ivar.
+		// The above method already processed it, and included the appropriate information in the changeset.
+		registeredExtensionsChanged = NO;
 		
-		for (YapCollectionKey *cacheKey in keysToUpdate)
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (void)_unregisterExtensionWithName:(NSString *)extensionName
+                         transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	NSString *className = nil;
+	Class extensionClass = NULL;
+    Class abstractExtClass = NSClassFromString(@"YapDatabaseExtension");
+	
+	BOOL wasPersistent;
+	
+	YapMemoryTableTransaction *memoryTableTransaction = [transaction yapMemoryTableTransaction];
+	YapCollectionKey *classKey = [[YapCollectionKey alloc] initWithCollection:extensionName key:ext_key_class];
+	
+	className = [memoryTableTransaction objectForKey:classKey];
+	if (className)
+	{
+		wasPersistent = NO;
+	}
+	else
+	{
+		className = [transaction stringValueForKey:ext_key_class extension:extensionName];
+		wasPersistent = YES;
+	}
+	
+	extensionClass = NSClassFromString(className);
+	
+	if (className == nil)
+	{
+		YDBLogWarn(@"Unable to unregister extension(%@). Doesn't appear to be registered.", extensionName);
+	}
+	else if (!extensionClass || ![extensionClass superclass])
+	{
+		YDBLogError(@"Unable to unregister extension(%@) with unknown class(%@)", extensionName, className);
+	}
+	else if (![extensionClass isSubclassOfClass:abstractExtClass])
+	{
+		YDBLogError(@"Unable to unregister extension(%@) with improper class(%@)", extensionName, className);
+	}
+	else
+	{
+		// Drop tables
+		[extensionClass dropTablesForRegisteredName:extensionName withTransaction:transaction wasPersistent:wasPersistent];
+		
+		// Drop preferences
+		if (wasPersistent)
 		{
-			id newMetadata = [changeset_metadataChanges objectForKey:cacheKey];
+			// remove rows in yap2 table (where extension == extensionName)
+			[transaction removeAllValuesForExtension:extensionName];
+		}
+		else
+		{
+			// remove rows in yap memory table (where collectionKey.collection == extensionName)
+			NSMutableArray *keysToRemove = [NSMutableArray array];
 			
-			if (newMetadata == yapNull)
-			{
-				[metadataCache removeObjectForKey:cacheKey];
-			}
-			else if (newMetadata != yapTouch)
-			{
-				if (isPolicyContainment) {
-					[metadataCache removeObjectForKey:cacheKey];
-				}
-				else if (isPolicyShare) {
-					[metadataCache setObject:newMetadata forKey:cacheKey];
-				}
-				else // if (isPolicyCopy)
+			[memoryTableTransaction enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+				
+				__unsafe_unretained YapCollectionKey *ck = (YapCollectionKey *)key;
+				if ([ck.collection isEqualToString:extensionName])
 				{
-					if ([newMetadata conformsToProtocol:@protocol(NSCopying)])
-						[metadataCache setObject:[newMetadata copy] forKey:cacheKey];
-					else
-						[metadataCache removeObjectForKey:cacheKey];
+					[keysToRemove addObject:ck];
 				}
-			}
+			}];
+			
+			[memoryTableTransaction removeObjectsForKeys:keysToRemove];
 		}
+		
+		// Remove from registeredExtensions, extensionsOrder & extensionDependencies (if needed)
+		[self didUnregisterExtensionWithName:extensionName];
+		
+		// Remove YapDatabaseExtensionConnection subclass instance (if needed)
+		[self removeRegisteredExtensionConnectionWithName:extensionName];
+		
+		// Remove YapDatabaseExtensionTransaction subclass instance (if needed)
+		[transaction removeRegisteredExtensionTransactionWithName:extensionName];
 	}
 }
 
-/**
- * Internal method.
- *
- * This method is invoked with the changeset from a sibling connection.
-**/
-- (void)noteCommittedChangeset:(NSDictionary *)changeset
+- (void)willRegisterExtension:(YapDatabaseExtension *)extension
+                     withName:(NSString *)extensionName
+                transaction:(YapDatabaseReadWriteTransaction *)transaction
+              needsClassValue:(BOOL *)needsClassValuePtr
 {
-	// This method must be invoked from within connectionQueue.
+	// This method is INTERNAL
 	
-	NSAssert(dispatch_get_specific(IsOnConnectionQueueKey), @"Must be invoked within connectionQueue");
+	// Check to see if we should create the YapMemoryTable.
+	// We create this on demand the first time an extension is registered.
 	
-	// Grab the new snapshot.
-	// This tells us the minimum snapshot we could get if we started a transaction right now.
+	if ([registeredMemoryTables objectForKey:@"yap"] == nil)
+	{
+		YapMemoryTable *memoryTable = [[YapMemoryTable alloc] initWithKeyClass:[YapCollectionKey class]];
+		
+		[self registerMemoryTable:memoryTable withName:@"yap"];
+	}
 	
-	uint64_t changesetSnapshot = [[changeset objectForKey:YapDatabaseSnapshotKey] unsignedLongLongValue];
+	// Special handling for non-persistent (in-memory only) extensions.
 	
-	if (changesetSnapshot <= snapshot)
+	if (![extension isPersistent])
 	{
-		// We already noted this changeset.
-		//
-		// There is a "race condition" that occasionally happens when a readonly transaction is started
-		// around the same instant a readwrite transaction finishes committing its changes to disk.
-		// The readonly transaction enters our transaction state queue (to start) before
-		// the readwrite transaction enters our transaction state queue (to finish).
-		// However the readonly transaction gets a database snapshot post readwrite commit.
-		// That is, the readonly transaction can read the changes from the readwrite transaction at the sqlite layer,
-		// even though the readwrite transaction hasn't completed within the yap database layer.
-		//
-		// This race condition is handled automatically within the preReadTransaction method.
-		// In fact, it invokes this method to handle the race condition.
-		// Thus this method could be invoked twice to handle the same changeset.
-		// So catching it here and ignoring it is simply a minor optimization to avoid duplicate work.
-		
-		YDBLogVerbose(@"Ignoring previously processed changeset %lu for connection %@, database %@",
-		              (unsigned long)changesetSnapshot, self, database);
-		
+		// First time registration
+		*needsClassValuePtr = YES;
 		return;
 	}
 	
-	if (longLivedReadTransaction)
+	// The class name of every registered extension is recorded in the yap2 table.
+	// We ensure that re-registrations under the same name use the same extension class.
+	// If we detect a change, we auto-unregister the previous extension.
+	//
+	// Note: @"class" is a reserved key for all extensions.
+	
+	NSString *prevExtensionClassName = [transaction stringValueForKey:ext_key_class extension:extensionName];
+	if (prevExtensionClassName == nil)
 	{
-		if (isFastForwarding)
-		{
-			// This method is being invoked from preReadTransaction or preReadWriteTransaction.
-			// We need to process the changeset for it.
-			
-			[processedChangesets addObject:changeset];
-		}
-		else
-		{
-			// This method is being invoked from [database noteCommittedChangeset:].
-			// We cannot process the changeset yet.
-			// We must wait for the longLivedReadTransaction to be reset.
-			
-			YDBLogVerbose(@"Storing pending changeset %lu for connection %@, database %@",
-			              (unsigned long)changesetSnapshot, self, database);
-			
-			[pendingChangesets addObject:changeset];
-			return;
-		}
+		// First time registration
+		*needsClassValuePtr = YES;
+		return;
 	}
 	
-	// Changeset processing
+	NSString *extensionClassName = NSStringFromClass([extension class]);
 	
-	YDBLogVerbose(@"Processing changeset %lu for connection %@, database %@",
-	              (unsigned long)changesetSnapshot, self, database);
+	if ([extensionClassName isEqualToString:prevExtensionClassName])
+	{
+		// Re-registration
+		*needsClassValuePtr = NO;
+		return;
+	}
 	
-	if (snapshot == changesetSnapshot - 1)
+	NSArray *otherValidClassNames = [[extension class] previousClassNames];
+	
+	if ([otherValidClassNames containsObject:prevExtensionClassName])
+	{
+		// The extension class was renamed.
+		// We should update the class value in the database.
+		*needsClassValuePtr = YES;
+		return;
+	}
+	
+	YDBLogWarn(@"Dropping tables for previously registered extension with name(%@), class(%@) for new class(%@)",
+	           extensionName, prevExtensionClassName, extensionClassName);
+	
+	Class abstractExtClass = NSClassFromString(@"YapDatabaseExtension");
+	Class prevExtensionClass = NSClassFromString(prevExtensionClassName);
+	
+	if (prevExtensionClass == NULL)
+	{
+		YDBLogError(@"Unable to drop tables for previously registered extension with name(%@), unknown class(%@)",
+		            extensionName, prevExtensionClassName);
+	}
+	else if (![prevExtensionClass isSubclassOfClass:abstractExtClass])
 	{
-		snapshot = changesetSnapshot;
-		[self processChangeset:changeset];
+		YDBLogError(@"Unable to drop tables for previously registered extension with name(%@), invalid class(%@)",
+		            extensionName, prevExtensionClassName);
 	}
 	else
 	{
-		// Snapshot numbers do not match: there might have been a modification from another process.
-		// We should flush cache and then process the changeset.
-		
-		snapshot = changesetSnapshot;
-		
-		NSUInteger flags = YapDatabaseConnectionFlushMemoryFlags_Caches |
-		                   YapDatabaseConnectionFlushMemoryFlags_Extension_State;
+		// Drop tables
+		[prevExtensionClass dropTablesForRegisteredName:extensionName withTransaction:transaction wasPersistent:YES];
 		
-		[self _flushMemoryWithFlags:flags];
-		[self processChangeset:changeset];
+		// Drop preferences (rows in yap2 table)
+		[transaction removeAllValuesForExtension:extensionName];
 	}
 	
-	// Allow extensions to process their individual changesets
-	//
-	// Use existing extensions (extensions ivar, not [self extensions]).
-	// There's no need to create any new extConnections at this point.
-		
-	[extensions enumerateKeysAndObjectsUsingBlock:
-	    ^(NSString *extName, YapDatabaseExtensionConnection *extConnection, BOOL __unused *stop)
-	{
-		[extConnection noteCommittedChangeset:changeset registeredName:extName];
-	}];
+	*needsClassValuePtr = YES;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Changeset Inspection
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (BOOL)hasChangeForCollection:(NSString *)collection
-               inNotifications:(NSArray *)notifications
-        includingObjectChanges:(BOOL)includeObjectChanges
-               metadataChanges:(BOOL)includeMetadataChanges
+- (void)didRegisterExtension:(YapDatabaseExtension *)extension
+                    withName:(NSString *)extensionName
+                 transaction:(YapDatabaseReadWriteTransaction *)transaction
+             needsClassValue:(BOOL)needsClassValue
 {
-	if (collection == nil)
-		collection = @"";
+	// This method is INTERNAL
 	
-	for (NSNotification *notification in notifications)
+	// Record the class name of the extension in the yap2 table (if needed)
+	
+	if (needsClassValue)
 	{
-		if (![notification isKindOfClass:[NSNotification class]])
-		{
-			YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
-			continue;
-		}
-		
-		NSDictionary *changeset = notification.userInfo;
-		
-		if (includeObjectChanges)
-		{
-			YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_objectChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					return YES;
-				}
-			}
-		}
+		NSString *extensionClassName = NSStringFromClass([extension class]);
 		
-		if (includeMetadataChanges)
+		if ([extension isPersistent])
 		{
-			YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_metadataChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					return YES;
-				}
-			}
+			[transaction setStringValue:extensionClassName forKey:ext_key_class extension:extensionName];
 		}
-		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *collectionKey in changeset_removedKeys)
+		else
 		{
-			if ([collectionKey.collection isEqualToString:collection])
-			{
-				return YES;
-			}
+			YapCollectionKey *classKey = [[YapCollectionKey alloc] initWithCollection:extensionName key:ext_key_class];
+			[[transaction yapMemoryTableTransaction] setObject:extensionClassName forKey:classKey];
 		}
-		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
-			return YES;
-		
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
-        
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
-			return YES;
 	}
 	
-	return NO;
-}
-
-- (BOOL)hasChangeForCollection:(NSString *)collection inNotifications:(NSArray *)notifications
-{
-	return [self hasChangeForCollection:collection
-	                    inNotifications:notifications
-	             includingObjectChanges:YES
-	                    metadataChanges:YES];
-}
-
-- (BOOL)hasObjectChangeForCollection:(NSString *)collection inNotifications:(NSArray *)notifications
-{
-	return [self hasChangeForCollection:collection
-	                    inNotifications:notifications
-	             includingObjectChanges:YES
-	                    metadataChanges:NO];
-}
-
-- (BOOL)hasMetadataChangeForCollection:(NSString *)collection inNotifications:(NSArray *)notifications
-{
-	return [self hasChangeForCollection:collection
-	                    inNotifications:notifications
-	             includingObjectChanges:NO
-	                    metadataChanges:YES];
-}
-
-// Query for a change to a particular key/collection tuple
-
-- (BOOL)hasChangeForKey:(NSString *)key
-           inCollection:(NSString *)collection
-        inNotifications:(NSArray *)notifications
- includingObjectChanges:(BOOL)includeObjectChanges
-        metadataChanges:(BOOL)includeMetadataChanges
-{
-	if (key == nil) return NO;
-	if (collection == nil)
-		collection = @"";
+	// Update the list of registered extensions.
 	
-	YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	NSMutableDictionary *newRegisteredExtensions = [registeredExtensions mutableCopy];
+	[newRegisteredExtensions setObject:extension forKey:extensionName];
 	
-	for (NSNotification *notification in notifications)
-	{
-		if (![notification isKindOfClass:[NSNotification class]])
-		{
-			YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
-			continue;
-		}
-		
-		NSDictionary *changeset = notification.userInfo;
-		
-		if (includeObjectChanges)
-		{
-			YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-			if ([changeset_objectChanges containsObject:collectionKey])
-				return YES;
-		}
-		
-		if (includeMetadataChanges)
-		{
-			YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-			if ([changeset_metadataChanges containsObject:collectionKey])
-				return YES;
-		}
-		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		if ([changeset_removedKeys containsObject:collectionKey])
-			return YES;
-		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
-			return YES;
-		
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
-        
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
-			return YES;
-	}
+	registeredExtensions = [newRegisteredExtensions copy];
+	extensionsOrder = [extensionsOrder arrayByAddingObject:extensionName];
 	
-	return NO;
-}
-
-- (BOOL)hasChangeForKey:(NSString *)key
-           inCollection:(NSString *)collection
-        inNotifications:(NSArray *)notifications
-{
-	return [self hasChangeForKey:key
-	                inCollection:collection
-	             inNotifications:notifications
-	      includingObjectChanges:YES
-	             metadataChanges:YES];
-}
-
-- (BOOL)hasObjectChangeForKey:(NSString *)key
-                 inCollection:(NSString *)collection
-              inNotifications:(NSArray *)notifications
-{
-	return [self hasChangeForKey:key
-	                inCollection:collection
-	             inNotifications:notifications
-	      includingObjectChanges:YES
-	             metadataChanges:NO];
-}
-
-- (BOOL)hasMetadataChangeForKey:(NSString *)key
-                   inCollection:(NSString *)collection
-                inNotifications:(NSArray *)notifications
-{
-	return [self hasChangeForKey:key
-	                inCollection:collection
-	             inNotifications:notifications
-	      includingObjectChanges:NO
-	             metadataChanges:YES];
+	NSSet *dependencies = [extension dependencies];
+	if (dependencies == nil)
+		dependencies = [NSSet set];
+	
+	NSMutableDictionary *newExtensionDependencies = [extensionDependencies mutableCopy];
+	[newExtensionDependencies setObject:dependencies forKey:extensionName];
+	
+	extensionDependencies = [newExtensionDependencies copy];
+	
+	extensionsReady = NO;
+	sharedKeySetForExtensions = [NSDictionary sharedKeySetForKeys:[registeredExtensions allKeys]];
+	
+	// Set the registeredExtensionsChanged flag.
+	// This will be consulted during the creation of the changeset,
+	// and will cause us to add the updated registeredExtensions to the list of changes.
+	// It will then get propogated to the database, and all other connections.
+	
+	registeredExtensionsChanged = YES;
 }
 
-// Query for a change to a particular set of keys in a collection
-
-- (BOOL)hasChangeForAnyKeys:(NSSet *)keys
-               inCollection:(NSString *)collection
-            inNotifications:(NSArray *)notifications
-     includingObjectChanges:(BOOL)includeObjectChanges
-            metadataChanges:(BOOL)includeMetadataChanges
+- (void)didUnregisterExtensionWithName:(NSString *)extensionName
 {
-	if ([keys count] == 0) return NO;
-	if (collection == nil)
-		collection = @"";
+	// This method is INTERNAL
 	
-	for (NSNotification *notification in notifications)
+	if ([registeredExtensions objectForKey:extensionName])
 	{
-		if (![notification isKindOfClass:[NSNotification class]])
-		{
-			YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
-			continue;
-		}
+		NSMutableDictionary *newRegisteredExtensions = [registeredExtensions mutableCopy];
+		[newRegisteredExtensions removeObjectForKey:extensionName];
 		
-		NSDictionary *changeset = notification.userInfo;
+		registeredExtensions = [newRegisteredExtensions copy];
 		
-		if (includeObjectChanges)
-		{
-			YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_objectChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					if ([keys containsObject:collectionKey.key])
-					{
-						return YES;
-					}
-				}
-			}
-		}
+		NSMutableArray *newExtensionsOrder = [extensionsOrder mutableCopy];
+		[newExtensionsOrder removeObject:extensionName];
 		
-		if (includeMetadataChanges)
-		{
-			YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_metadataChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					if ([keys containsObject:collectionKey.key])
-					{
-						return YES;
-					}
-				}
-			}
-		}
+		extensionsOrder = [newExtensionsOrder copy];
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *collectionKey in changeset_removedKeys)
-		{
-			if ([collectionKey.collection isEqualToString:collection])
-			{
-				if ([keys containsObject:collectionKey.key])
-				{
-					return YES;
-				}
-			}
-		}
+		NSMutableDictionary *newExtensionDependencies = [extensionDependencies mutableCopy];
+		[newExtensionDependencies removeObjectForKey:extensionName];
 		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
-			return YES;
-        
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
+		extensionDependencies = [newExtensionDependencies copy];
+		
+		extensionsReady = NO;
+		sharedKeySetForExtensions = [NSDictionary sharedKeySetForKeys:[registeredExtensions allKeys]];
+		
+		// Set the registeredExtensionsChanged flag.
+		// This will be consulted during the creation of the changeset,
+		// and will cause us to add the updated registeredExtensions to the list of changes.
+		// It will then get propogated to the database, and all other connections.
 		
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
-			return YES;
+		registeredExtensionsChanged = YES;
 	}
-	
-	return NO;
-}
-
-- (BOOL)hasChangeForAnyKeys:(NSSet *)keys
-               inCollection:(NSString *)collection
-            inNotifications:(NSArray *)notifications
-{
-	return [self hasChangeForAnyKeys:keys
-	                    inCollection:collection
-	                 inNotifications:notifications
-	          includingObjectChanges:YES
-	                 metadataChanges:YES];
 }
 
-- (BOOL)hasObjectChangeForAnyKeys:(NSSet *)keys
-                     inCollection:(NSString *)collection
-                  inNotifications:(NSArray *)notifications
+- (void)addRegisteredExtensionConnection:(YapDatabaseExtensionConnection *)extConnection withName:(NSString *)extName
 {
-	return [self hasChangeForAnyKeys:keys
-	                    inCollection:collection
-	                 inNotifications:notifications
-	          includingObjectChanges:YES
-	                 metadataChanges:NO];
+	// This method is INTERNAL
+	
+	if (extensions == nil)
+		extensions = [[NSMutableDictionary alloc] init];
+	
+	[extensions setObject:extConnection forKey:extName];
 }
 
-- (BOOL)hasMetadataChangeForAnyKeys:(NSSet *)keys
-                       inCollection:(NSString *)collection
-                    inNotifications:(NSArray *)notifications
+- (void)removeRegisteredExtensionConnectionWithName:(NSString *)extName
 {
-	return [self hasChangeForAnyKeys:keys
-	                    inCollection:collection
-	                 inNotifications:notifications
-	          includingObjectChanges:NO
-	                 metadataChanges:YES];
+	// This method is INTERNAL
+	
+	[extensions removeObjectForKey:extName];
 }
 
-// Advanced query techniques
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Pragma
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Returns YES if [transaction removeAllObjectsInCollection:] was invoked on the collection,
- * or if [transaction removeAllObjectsInAllCollections] was invoked
- * during any of the commits represented by the given notifications.
- * 
- * If this was the case then YapDatabase may not have tracked every single key within the collection.
- * And thus a key that was removed via clearing the collection may not show up while enumerating changedKeys.
- *
- * This method is designed to be used in conjunction with the enumerateChangedKeys.... methods (below).
- * The hasChange... methods (above) already take this into account.
+ * Returns the current synchronous configuration via "PRAGMA synchronous;".
+ * Allows you to verify that sqlite accepted your synchronous configuration request.
 **/
-- (BOOL)didClearCollection:(NSString *)collection inNotifications:(NSArray *)notifications
+- (NSString *)pragmaSynchronous
 {
-	if (collection == nil)
-		collection = @"";
+	__block int64_t value = -1;
 	
-	for (NSNotification *notification in notifications)
-	{
-		if (![notification isKindOfClass:[NSNotification class]])
-		{
-			YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
-			continue;
-		}
-		
-		NSDictionary *changeset = notification.userInfo;
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
-			return YES;
-        
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
+		value = [YapDatabase pragma:@"synchronous" using:db];
 		
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
-			return YES;
-	}
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
 	
-	return NO;
+	return [YapDatabase pragmaValueForSynchronous:value];
 }
 
 /**
- * Returns YES if [transaction removeAllObjectsInAllCollections] was invoked
- * during any of the commits represented by the given notifications.
- *
- * If this was the case then YapDatabase may not have tracked every single key within every single collection.
- * And thus a key that was removed via clearing the database may not show up while enumerating changedKeys.
- *
- * This method is designed to be used in conjunction with the enumerateChangedKeys.... methods (below).
- * The hasChange... methods (above) already take this into account.
+ * Returns the current page_size configuration via "PRAGMA page_size;".
+ * Allows you to verify that sqlite accepted your page_size configuration request.
 **/
-- (BOOL)didClearAllCollectionsInNotifications:(NSArray *)notifications
+- (NSInteger)pragmaPageSize
 {
-	for (NSNotification *notification in notifications)
-	{
-		if (![notification isKindOfClass:[NSNotification class]])
-		{
-			YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
-			continue;
-		}
+	__block int64_t value = -1;
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		NSDictionary *changeset = notification.userInfo;
+		value = [YapDatabase pragma:@"page_size" using:db];
 		
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
-        
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
-			return YES;
-	}
+	#pragma clang diagnostic pop
+	}};
 	
-	return NO;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return (NSInteger)value;
 }
 
 /**
- * Allows you to enumerate all the changed keys in the given collection, for the given commits.
- *
- * Keep in mind that if [transaction removeAllObjectsInCollection:] was invoked on the given collection
- * or [transaction removeAllObjectsInAllCollections] was invoked
- * during any of the commits represented by the given notifications,
- * then the key may not be included in the enumeration.
- * You must use didClearCollection:inNotifications: or didClearAllCollectionsInNotifications:
- * if you need to handle that case.
+ * Returns the currently memory mapped I/O configureation via "PRAGMA mmap_size;".
+ * Allows you to verify that sqlite accepted your mmap_size configuration request.
  *
- * @see didClearCollection:inNotifications:
- * @see didClearAllCollectionsInNotifications:
+ * Memory mapping may be disabled by sqlite's compile-time options.
+ * Or it may restrict the mmap_size to something smaller than requested.
 **/
-- (void)enumerateChangedKeysInCollection:(NSString *)collection
-                         inNotifications:(NSArray *)notifications
-                              usingBlock:(void (^)(NSString *key, BOOL *stop))block
+- (NSInteger)pragmaMMapSize
 {
-	if (block == NULL) return;
-	if (collection == nil)
-		collection = @"";
-	
-	BOOL stop = NO;
-	NSMutableSet *keys = [NSMutableSet set];
+	__block int64_t value = -1;
 	
-	for (NSNotification *notification in notifications)
-	{
-		if (![notification isKindOfClass:[NSNotification class]])
-		{
-			YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
-			continue;
-		}
-		
-		NSDictionary *changeset = notification.userInfo;
-		
-		YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-		for (YapCollectionKey *ck in changeset_objectChanges)
-		{
-			if ([ck.collection isEqualToString:collection])
-			{
-				if (![keys containsObject:ck.key])
-				{
-					block(ck.key, &stop);
-					if (stop) return;
-					
-					[keys addObject:ck.key];
-				}
-			}
-		}
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-		for (YapCollectionKey *ck in changeset_metadataChanges)
-		{
-			if ([ck.collection isEqualToString:collection])
-			{
-				if (![keys containsObject:ck.key])
-				{
-					block(ck.key, &stop);
-					if (stop) return;
-					
-					[keys addObject:ck.key];
-				}
-			}
-		}
+		value = [YapDatabase pragma:@"mmap_size" using:db];
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *ck in changeset_removedKeys)
-		{
-			if ([ck.collection isEqualToString:collection])
-			{
-				if (![keys containsObject:ck.key])
-				{
-					block(ck.key, &stop);
-					if (stop) return;
-					
-					[keys addObject:ck.key];
-				}
-			}
-		}
-	}
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return (NSInteger)value;
 }
 
 /**
- * Allows you to enumerate all the changed collection/key tuples for the given commits.
+ * Upgrade Notice:
  *
- * Keep in mind that if [transaction removeAllObjectsInCollection:] was invoked on the given collection
- * or [transaction removeAllObjectsInAllCollections] was invoked
- * during any of the commits represented by the given notifications,
- * then the collection/key tuple may not be included in the enumeration.
- * You must use didClearCollection:inNotifications: or didClearAllCollectionsInNotifications:
- * if you need to handle that case.
+ * The "auto_vacuum=FULL" was not properly set until YapDatabase v2.5.
+ * And thus if you have an app that was using YapDatabase prior to this version,
+ * then the existing database file will continue to operate in "auto_vacuum=NONE" mode.
+ * This means the existing database file won't be properly truncated as you delete information from the db.
+ * That is, the data will be removed, but the pages will be moved to the freelist,
+ * and the file itself will remain the same size on disk. (I.e. the file size can grow, but not shrink.)
+ * To correct this problem, you should run the vacuum operation is at least once.
+ * After it is run, the "auto_vacuum=FULL" mode will be set,
+ * and the database file size will automatically shrink in the future (as you delete data).
  *
- * @see didClearCollection:inNotifications:
- * @see didClearAllCollectionsInNotifications:
+ * @returns Result from "PRAGMA auto_vacuum;" command, as a readable string:
+ *   - NONE
+ *   - FULL
+ *   - INCREMENTAL
+ *   - UNKNOWN (future proofing)
+ *
+ * If the return value is NONE, then you should run the vacuum operation at some point
+ * in order to properly reconfigure the database.
+ *
+ * Concerning Method Invocation:
+ *
+ * You can invoke this method as a standalone method on the connection:
+ *
+ *   NSString *value = [databaseConnection pragmaAutoVacuum]
+ *
+ * Or you can invoke this method within a transaction:
+ *
+ * [databaseConnection asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction){
+ *     NSString *value = [databaseConnection pragmaAutoVacuum];
+ * }];
 **/
-- (void)enumerateChangedCollectionKeysInNotifications:(NSArray *)notifications
-                                           usingBlock:(void (^)(YapCollectionKey *ck, BOOL *stop))block
+- (NSString *)pragmaAutoVacuum
 {
-	if (block == NULL) return;
-	
-	BOOL stop = NO;
-	NSMutableSet *collectionKeys = [NSMutableSet set];
+	__block int64_t value = -1;
 	
-	for (NSNotification *notification in notifications)
-	{
-		if (![notification isKindOfClass:[NSNotification class]])
-		{
-			YDBLogWarn(@"%@ - notifications parameter contains non-NSNotification object", THIS_METHOD);
-			continue;
-		}
-		
-		NSDictionary *changeset = notification.userInfo;
-		
-		YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-		for (YapCollectionKey *ck in changeset_objectChanges)
-		{
-			if (![collectionKeys containsObject:ck])
-			{
-				block(ck, &stop);
-				if (stop) return;
-				
-				[collectionKeys addObject:ck];
-			}
-		}
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-		for (YapCollectionKey *ck in changeset_metadataChanges)
-		{
-			if (![collectionKeys containsObject:ck])
-			{
-				block(ck, &stop);
-				if (stop) return;
-				
-				[collectionKeys addObject:ck];
-			}
-		}
+		value = [YapDatabase pragma:@"auto_vacuum" using:db];
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *ck in changeset_removedKeys)
-		{
-			if (![collectionKeys containsObject:ck])
-			{
-				block(ck, &stop);
-				if (stop) return;
-				
-				[collectionKeys addObject:ck];
-			}
-		}
-	}
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return [YapDatabase pragmaValueForAutoVacuum:value];
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Extensions
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Creates or fetches the extension with the given name.
- * If this connection has not yet initialized the proper extensions connection, it is done automatically.
- *
- * @return
- *     A subclass of YapDatabaseExtensionConnection,
- *     according to the type of extension registered under the given name.
- *
- * One must register an extension with the database before it can be accessed from within connections or transactions.
- * After registration everything works automatically using just the registered extension name.
- *
- * @see [YapDatabase registerExtension:withName:]
+ * Returns the number of unused pages in the database file, via "PRAGMA freelist_count;".
 **/
-- (id)extension:(NSString *)extName
+- (NSUInteger)pragmaFreelistCount
 {
-	// This method is PUBLIC.
-	//
-	// This method returns a subclass of YapDatabaseExtensionConnection.
-	// To get:
-	// - YapDatabaseExtension            => [database registeredExtension:@"registeredNameOfExtension"]
-	// - YapDatabaseExtensionConnection  => [databaseConnection extension:@"registeredNameOfExtension"]
-	// - YapDatabaseExtensionTransaction => [databaseTransaction extension:@"registeredNameOfExtension"]
-	
-	__block id extConnection = nil;
+	__block int64_t value = 0;
 	
-	dispatch_block_t block = ^{
+	dispatch_block_t block = ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		extConnection = [extensions objectForKey:extName];
-		
-		if (!extConnection && !extensionsReady)
-		{
-			// We don't have an existing connection for the extension.
-			// Create one (if we can).
-			
-			YapDatabaseExtension *ext = [registeredExtensions objectForKey:extName];
-			if (ext)
-			{
-				extConnection = [ext newConnection:self];
-				[extensions setObject:extConnection forKey:extName];
-			}
-		}
+		value = [YapDatabase pragma:@"freelist_count" using:db];
 		
 	#pragma clang diagnostic pop
-	};
+	}};
 	
 	if (dispatch_get_specific(IsOnConnectionQueueKey))
 		block();
 	else
 		dispatch_sync(connectionQueue, block);
 	
-	return extConnection;
-}
-
-- (id)ext:(NSString *)extensionName
-{
-	// The "+ (void)load" method swizzles the implementation of this class
-	// to point to the implementation of the extension: method.
-	//
-	// So the two methods are literally the same thing.
-	
-	return [self extension:extensionName]; // This method is swizzled !
+	return (value > 0) ? (NSUInteger)value : 0;
 }
 
-- (NSDictionary *)extensions
+/**
+ * Returns the total number of pages in the database file, via "PRAGMA page_count;".
+**/
+- (NSUInteger)pragmaPageCount
 {
-	// This method is INTERNAL
+	__block int64_t value = 0;
 	
-	if (!extensionsReady)
-	{
-		[registeredExtensions enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
-		#pragma clang diagnostic push
-		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-			
-			__unsafe_unretained NSString *extName = key;
-			__unsafe_unretained YapDatabaseExtension *ext = obj;
-			
-			if ([extensions objectForKey:extName] == nil)
-			{
-				id extConnection = [ext newConnection:self];
-				[extensions setObject:extConnection forKey:extName];
-			}
-			
-		#pragma clang diagnostic pop
-		}];
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		extensionsReady = YES;
-	}
+		value = [YapDatabase pragma:@"page_count" using:db];
+		
+	#pragma clang diagnostic pop
+	}};
 	
-	return extensions;
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return (value > 0) ? (NSUInteger)value : 0;
 }
 
-- (BOOL)registerExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Vacuum
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The auto_vacuum mode is stored in the database file, and a VACUUM is what applies it.
+ * So we make sure to preserve the configured mode (rather than resetting it to FULL).
+**/
+- (const char *)pragmaAutoVacuumStatement
+{
+	if (database.options.pragmaAutoVacuum == YapDatabasePragmaAutoVacuum_Incremental)
+		return "PRAGMA auto_vacuum = INCREMENTAL;";
+	else
+		return "PRAGMA auto_vacuum = FULL;";
+}
+
+/**
+ * Performs a VACUUM on the sqlite database.
+ *
+ * This method operates as a synchronous ReadWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * For more infomation on the VACUUM operation, see the sqlite docs:
+ * http://sqlite.org/lang_vacuum.html
+ *
+ * Remember that YapDatabase operates in WAL mode, with "auto_vacuum=FULL" set.
+ *
+ * @see pragmaAutoVacuum
+**/
+- (void)vacuum
 {
-	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must go through writeQueue.");
-	
-	__block BOOL result = NO;
-	
 	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+		
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
-		[self preReadWriteTransaction:transaction];
-		
-		YapDatabaseExtensionConnection *extensionConnection;
-		YapDatabaseExtensionTransaction *extensionTransaction;
-		
-		extensionConnection = [extension newConnection:self];
-		extensionTransaction = [extensionConnection newReadWriteTransaction:transaction];
-		
-		BOOL needsClassValue = NO;
-		[self willRegisterExtension:extension
-		                   withName:extensionName
-		                transaction:transaction
-		            needsClassValue:&needsClassValue];
-		
-		result = [extensionTransaction createIfNeeded];
-		
-		if (result)
-		{
-			[self didRegisterExtension:extension
-			                  withName:extensionName
-			               transaction:transaction
-			           needsClassValue:needsClassValue];
-			
-			[self addRegisteredExtensionConnection:extensionConnection withName:extensionName];
-			[transaction addRegisteredExtensionTransaction:extensionTransaction withName:extensionName];
-		}
-		else
+		if (longLivedReadTransaction)
 		{
-			// Registration failed.
-			
-			[transaction rollback];
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+						   self, database);
+				
+				[self endLongLivedReadTransaction];
+			}
 		}
 		
-		[self postReadWriteTransaction:transaction];
-		registeredExtensionsChanged = NO;
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			[self prePseudoReadWriteTransaction];
+			
+			int status;
+			
+			status = sqlite3_exec(db, [self pragmaAutoVacuumStatement], NULL, NULL, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error setting PRAGMA auto_vacuum: %d %s", status, sqlite3_errmsg(db));
+			}
+			
+			YDBLogVerbose(@"Starting VACUUM ...");
+			
+			status = sqlite3_exec(db, "VACUUM;", NULL, NULL, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error performing VACUUM: %d %s", status, sqlite3_errmsg(db));
+			}
+			
+			YDBLogVerbose(@"VACUUM complete !");
+			
+			hasDiskChanges = YES;
+			[self postPseudoReadWriteTransaction];
+			
+		}}); // End dispatch_sync(database->writeQueue)
 		
 	#pragma clang diagnostic pop
-	}});
-	
-	return result;
+	}}); // End dispatch_sync(connectionQueue)
 }
 
-- (void)unregisterExtensionWithName:(NSString *)extensionName
+/**
+ * Performs a VACUUM on the sqlite database.
+ *
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * For more infomation on the VACUUM operation, see the sqlite docs:
+ * http://sqlite.org/lang_vacuum.html
+ *
+ * Remember that YapDatabase operates in WAL mode, with "auto_vacuum=FULL" set.
+ *
+ * An optional completion block may be used.
+ * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
+ *
+ * @see pragmaAutoVacuum
+**/
+- (void)asyncVacuumWithCompletionBlock:(dispatch_block_t)completionBlock
 {
-	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must go through writeQueue.");
+	[self asyncVacuumWithCompletionQueue:NULL completionBlock:completionBlock];
+}
+
+/**
+ * Performs a VACUUM on the sqlite database.
+ *
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * For more infomation on the VACUUM operation, see the sqlite docs:
+ * http://sqlite.org/lang_vacuum.html
+ *
+ * Remember that YapDatabase operates in WAL mode, with "auto_vacuum=FULL" set.
+ *
+ * An optional completion block may be used.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+ * 
+ * @see pragmaAutoVacuum
+**/
+- (void)asyncVacuumWithCompletionQueue:(dispatch_queue_t)completionQueue
+                       completionBlock:(dispatch_block_t)completionBlock
+{
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
 	
-	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+	dispatch_async(connectionQueue, ^{ @autoreleasepool {
+	
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
-		[self preReadWriteTransaction:transaction];
-		
-		// Unregister the given extension
-		
-		YapDatabaseExtension *extension = [registeredExtensions objectForKey:extensionName];
-		
-		[self _unregisterExtensionWithName:extensionName transaction:transaction];
-		extension.registeredName = nil;
-		extension.registeredDatabase = nil;
-		
-		// Automatically unregister any extensions that were dependent upon this one.
-		
-		NSMutableArray *extensionNameStack = [NSMutableArray arrayWithCapacity:1];
-		[extensionNameStack addObject:extensionName];
-		
-		do
+		if (longLivedReadTransaction)
 		{
-			NSString *currentExtensionName = [extensionNameStack lastObject];
-			
-			__block NSString *dependentExtName = nil;
-			[extensionDependencies enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop){
-				
-			//	__unsafe_unretained NSString *extName = (NSString *)key;
-				__unsafe_unretained NSSet *extDependencies = (NSSet *)obj;
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+						   self, database);
 				
-				if ([extDependencies containsObject:currentExtensionName])
-				{
-					dependentExtName = (NSString *)key;
-					*stop = YES;
-				}
-			}];
+				[self endLongLivedReadTransaction];
+			}
+		}
+		
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
 			
-			if (dependentExtName)
+			[self prePseudoReadWriteTransaction];
+			
+			int status;
+			
+			status = sqlite3_exec(db, [self pragmaAutoVacuumStatement], NULL, NULL, NULL);
+			if (status != SQLITE_OK)
 			{
-				// We found an extension that was dependent upon the one we just unregistered.
-				// So we need to unregister it too.
-				
-				YapDatabaseExtension *dependentExt = [registeredExtensions objectForKey:dependentExtName];
-				
-				[self _unregisterExtensionWithName:dependentExtName transaction:transaction];
-				dependentExt.registeredName = nil;
-				
-				// And now we need to check and see if there were any extensions dependent upon this new one.
-				// So we add it to the top of the stack, and continue our search.
-				
-				[extensionNameStack addObject:dependentExtName];
+				YDBLogError(@"Error setting PRAGMA auto_vacuum: %d %s", status, sqlite3_errmsg(db));
 			}
-			else
+			
+			YDBLogVerbose(@"Starting VACUUM ...");
+			
+			status = sqlite3_exec(db, "VACUUM;", NULL, NULL, NULL);
+			if (status != SQLITE_OK)
 			{
-				[extensionNameStack removeLastObject];
+				YDBLogError(@"Error performing VACUUM: %d %s", status, sqlite3_errmsg(db));
 			}
 			
-		} while ([extensionNameStack count] > 0);
-		
-		
-		// Complete the transaction
-		[self postReadWriteTransaction:transaction];
-		
-		// And reset the registeredExtensionsChanged ivar.
-		// The above method already processed it, and included the appropriate information in the changeset.
-		registeredExtensionsChanged = NO;
-		
+			YDBLogVerbose(@"VACUUM complete !");
+			
+			hasDiskChanges = YES;
+			[self postPseudoReadWriteTransaction];
+			
+			if (completionBlock) {
+				dispatch_async(completionQueue, completionBlock);
+			}
+			
+		}}); // End dispatch_sync(database->writeQueue)
+	
 	#pragma clang diagnostic pop
-	}});
+	}}); // End dispatch_async(connectionQueue)
 }
 
-- (void)_unregisterExtensionWithName:(NSString *)extensionName
-                         transaction:(YapDatabaseReadWriteTransaction *)transaction
+/**
+ * Executes "PRAGMA incremental_vacuum(N)", and returns the number of pages that were reclaimed.
+ *
+ * This method must be invoked from within the connectionQueue.
+ * This method must be invoked from within the database.writeQueue.
+**/
+- (NSUInteger)_incrementalVacuumWithPageBudget:(NSUInteger)pageBudget
 {
-	NSString *className = nil;
-	Class extensionClass = NULL;
-    Class abstractExtClass = NSClassFromString(@"YapDatabaseExtension");
+	[self prePseudoReadWriteTransaction];
 	
-	BOOL wasPersistent;
+	int64_t freelistCount = [YapDatabase pragma:@"freelist_count" using:db];
 	
-	YapMemoryTableTransaction *memoryTableTransaction = [transaction yapMemoryTableTransaction];
-	YapCollectionKey *classKey = [[YapCollectionKey alloc] initWithCollection:extensionName key:ext_key_class];
+	NSString *pragma_incremental_vacuum =
+	  [NSString stringWithFormat:@"PRAGMA incremental_vacuum(%lu);", (unsigned long)pageBudget];
 	
-	className = [memoryTableTransaction objectForKey:classKey];
-	if (className)
-	{
-		wasPersistent = NO;
-	}
-	else
+	int status = sqlite3_exec(db, [pragma_incremental_vacuum UTF8String], NULL, NULL, NULL);
+	if (status != SQLITE_OK)
 	{
-		className = [transaction stringValueForKey:ext_key_class extension:extensionName];
-		wasPersistent = YES;
+		YDBLogError(@"Error performing PRAGMA incremental_vacuum: %d %s", status, sqlite3_errmsg(db));
 	}
 	
-	extensionClass = NSClassFromString(className);
+	int64_t remainingFreelistCount = [YapDatabase pragma:@"freelist_count" using:db];
 	
-	if (className == nil)
-	{
-		YDBLogWarn(@"Unable to unregister extension(%@). Doesn't appear to be registered.", extensionName);
-	}
-	else if (!extensionClass || ![extensionClass superclass])
-	{
-		YDBLogError(@"Unable to unregister extension(%@) with unknown class(%@)", extensionName, className);
-	}
-	else if (![extensionClass isSubclassOfClass:abstractExtClass])
-	{
-		YDBLogError(@"Unable to unregister extension(%@) with improper class(%@)", extensionName, className);
+	NSUInteger reclaimedPageCount = 0;
+	if (freelistCount > remainingFreelistCount && remainingFreelistCount >= 0) {
+		reclaimedPageCount = (NSUInteger)(freelistCount - remainingFreelistCount);
 	}
-	else
-	{
-		// Drop tables
-		[extensionClass dropTablesForRegisteredName:extensionName withTransaction:transaction wasPersistent:wasPersistent];
+	
+	YDBLogVerbose(@"Incremental vacuum: reclaimed %lu page(s), %lld remaining",
+	              (unsigned long)reclaimedPageCount, remainingFreelistCount);
+	
+	hasDiskChanges = (reclaimedPageCount > 0);
+	[self postPseudoReadWriteTransaction];
+	
+	return reclaimedPageCount;
+}
+
+/**
+ * Performs a "PRAGMA incremental_vacuum(N)" on the sqlite database.
+ *
+ * This method operates as a synchronous ReadWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * @see pragmaFreelistCount
+**/
+- (NSUInteger)incrementalVacuumWithPageBudget:(NSUInteger)pageBudget
+{
+	__block NSUInteger reclaimedPageCount = 0;
+	
+	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
 		
-		// Drop preferences
-		if (wasPersistent)
-		{
-			// remove rows in yap2 table (where extension == extensionName)
-			[transaction removeAllValuesForExtension:extensionName];
-		}
-		else
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (longLivedReadTransaction)
 		{
-			// remove rows in yap memory table (where collectionKey.collection == extensionName)
-			NSMutableArray *keysToRemove = [NSMutableArray array];
-			
-			[memoryTableTransaction enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+						   self, database);
 				
-				__unsafe_unretained YapCollectionKey *ck = (YapCollectionKey *)key;
-				if ([ck.collection isEqualToString:extensionName])
-				{
-					[keysToRemove addObject:ck];
-				}
-			}];
-			
-			[memoryTableTransaction removeObjectsForKeys:keysToRemove];
+				[self endLongLivedReadTransaction];
+			}
 		}
 		
-		// Remove from registeredExtensions, extensionsOrder & extensionDependencies (if needed)
-		[self didUnregisterExtensionWithName:extensionName];
-		
-		// Remove YapDatabaseExtensionConnection subclass instance (if needed)
-		[self removeRegisteredExtensionConnectionWithName:extensionName];
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			reclaimedPageCount = [self _incrementalVacuumWithPageBudget:pageBudget];
+			
+		}}); // End dispatch_sync(database->writeQueue)
 		
-		// Remove YapDatabaseExtensionTransaction subclass instance (if needed)
-		[transaction removeRegisteredExtensionTransactionWithName:extensionName];
-	}
+	#pragma clang diagnostic pop
+	}}); // End dispatch_sync(connectionQueue)
+	
+	return reclaimedPageCount;
 }
 
-- (void)willRegisterExtension:(YapDatabaseExtension *)extension
-                     withName:(NSString *)extensionName
-                transaction:(YapDatabaseReadWriteTransaction *)transaction
-              needsClassValue:(BOOL *)needsClassValuePtr
+/**
+ * Performs a "PRAGMA incremental_vacuum(N)" on the sqlite database.
+ *
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * An optional completion block may be used, which is given the number of pages that were reclaimed.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
+**/
+- (void)asyncIncrementalVacuumWithPageBudget:(NSUInteger)pageBudget
+                             completionQueue:(dispatch_queue_t)completionQueue
+                             completionBlock:(void (^)(NSUInteger reclaimedPageCount))completionBlock
 {
-	// This method is INTERNAL
-	
-	// Check to see if we should create the YapMemoryTable.
-	// We create this on demand the first time an extension is registered.
-	
-	if ([registeredMemoryTables objectForKey:@"yap"] == nil)
-	{
-		YapMemoryTable *memoryTable = [[YapMemoryTable alloc] initWithKeyClass:[YapCollectionKey class]];
-		
-		[self registerMemoryTable:memoryTable withName:@"yap"];
-	}
-	
-	// Special handling for non-persistent (in-memory only) extensions.
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
 	
-	if (![extension isPersistent])
-	{
-		// First time registration
-		*needsClassValuePtr = YES;
-		return;
-	}
+	dispatch_async(connectionQueue, ^{ @autoreleasepool {
 	
-	// The class name of every registered extension is recorded in the yap2 table.
-	// We ensure that re-registrations under the same name use the same extension class.
-	// If we detect a change, we auto-unregister the previous extension.
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
 	//
-	// Note: @"class" is a reserved key for all extensions.
-	
-	NSString *prevExtensionClassName = [transaction stringValueForKey:ext_key_class extension:extensionName];
-	if (prevExtensionClassName == nil)
-	{
-		// First time registration
-		*needsClassValuePtr = YES;
-		return;
-	}
-	
-	NSString *extensionClassName = NSStringFromClass([extension class]);
-	
-	if ([extensionClassName isEqualToString:prevExtensionClassName])
-	{
-		// Re-registration
-		*needsClassValuePtr = NO;
-		return;
-	}
-	
-	NSArray *otherValidClassNames = [[extension class] previousClassNames];
-	
-	if ([otherValidClassNames containsObject:prevExtensionClassName])
-	{
-		// The extension class was renamed.
-		// We should update the class value in the database.
-		*needsClassValuePtr = YES;
-		return;
-	}
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (longLivedReadTransaction)
+		{
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+						   self, database);
+				
+				[self endLongLivedReadTransaction];
+			}
+		}
+		
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			NSUInteger reclaimedPageCount = [self _incrementalVacuumWithPageBudget:pageBudget];
+			
+			if (completionBlock) {
+				dispatch_async(completionQueue, ^{ @autoreleasepool {
+					completionBlock(reclaimedPageCount);
+				}});
+			}
+			
+		}}); // End dispatch_sync(database->writeQueue)
 	
-	YDBLogWarn(@"Dropping tables for previously registered extension with name(%@), class(%@) for new class(%@)",
-	           extensionName, prevExtensionClassName, extensionClassName);
+	#pragma clang diagnostic pop
+	}}); // End dispatch_async(connectionQueue)
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Compression
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Trains a new compression dictionary for the given collection, and (if it's an improvement) rotates it in.
+ * See the header file for a full discussion.
+**/
+- (void)asyncTrainCompressionDictionaryForCollection:(NSString *)collection
+                                     completionQueue:(dispatch_queue_t)completionQueue
+                                     completionBlock:(void (^)(BOOL rotated))completionBlock
+{
+	if (collection == nil) collection = @"";
 	
-	Class abstractExtClass = NSClassFromString(@"YapDatabaseExtension");
-	Class prevExtensionClass = NSClassFromString(prevExtensionClassName);
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
 	
-	if (prevExtensionClass == NULL)
-	{
-		YDBLogError(@"Unable to drop tables for previously registered extension with name(%@), unknown class(%@)",
-		            extensionName, prevExtensionClassName);
-	}
-	else if (![prevExtensionClass isSubclassOfClass:abstractExtClass])
-	{
-		YDBLogError(@"Unable to drop tables for previously registered extension with name(%@), invalid class(%@)",
-		            extensionName, prevExtensionClassName);
-	}
-	else
-	{
-		// Drop tables
-		[prevExtensionClass dropTablesForRegisteredName:extensionName withTransaction:transaction wasPersistent:YES];
+	dispatch_queue_t bgQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0);
+	dispatch_async(bgQueue, ^{ @autoreleasepool {
 		
-		// Drop preferences (rows in yap2 table)
-		[transaction removeAllValuesForExtension:extensionName];
-	}
-	
-	*needsClassValuePtr = YES;
+		BOOL rotated = [self trainCompressionDictionaryForCollection:collection];
+		
+		if (completionBlock)
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				
+				completionBlock(rotated);
+			}});
+		}
+	}});
 }
 
-- (void)didRegisterExtension:(YapDatabaseExtension *)extension
-                    withName:(NSString *)extensionName
-                 transaction:(YapDatabaseReadWriteTransaction *)transaction
-             needsClassValue:(BOOL)needsClassValue
+- (BOOL)trainCompressionDictionaryForCollection:(NSString *)collection
 {
-	// This method is INTERNAL
+	YapDatabaseCompressionConfig *config = database->compressionConfigs[collection];
+	if (config == nil || config.algorithm == YapDatabaseCompressionAlgorithmNone)
+	{
+		YDBLogWarn(@"Cannot train compression dictionary: no compression config for collection(%@)", collection);
+		return NO;
+	}
 	
-	// Record the class name of the extension in the yap2 table (if needed)
+	// Step 1:
+	// Fetch the samples (uncompressed).
 	
-	if (needsClassValue)
-	{
-		NSString *extensionClassName = NSStringFromClass([extension class]);
+	__block NSArray<NSData *> *samples = nil;
+	
+	[self readWithBlock:^(YapDatabaseReadTransaction __unused *transaction) {
 		
-		if ([extension isPersistent])
-		{
-			[transaction setStringValue:extensionClassName forKey:ext_key_class extension:extensionName];
-		}
-		else
-		{
-			YapCollectionKey *classKey = [[YapCollectionKey alloc] initWithCollection:extensionName key:ext_key_class];
-			[[transaction yapMemoryTableTransaction] setObject:extensionClassName forKey:classKey];
-		}
+		samples = [self compressionSamplesForCollection:collection limit:config.trainingSampleCount];
+	}];
+	
+	// Step 2:
+	// Train the new dictionary, and compare it against the current one.
+	//
+	// This happens outside of any transaction, as it may take a bit.
+	
+	NSData *dictionary = YapDatabaseTrainCompressionDictionary(samples, config.dictionarySize);
+	if (dictionary == nil)
+	{
+		YDBLogVerbose(@"Not enough shared content to train compression dictionary for collection(%@)", collection);
+		return NO;
 	}
 	
-	// Update the list of registered extensions.
+	NSData *currentDictionary = [database activeCompressionDictionaryForCollection:collection dictionaryId:NULL];
 	
-	NSMutableDictionary *newRegisteredExtensions = [registeredExtensions mutableCopy];
-	[newRegisteredExtensions setObject:extension forKey:extensionName];
+	NSUInteger currentLength = YapDatabaseCompressedLengthOfSamples(samples, config, currentDictionary);
+	NSUInteger trainedLength = YapDatabaseCompressedLengthOfSamples(samples, config, dictionary);
 	
-	registeredExtensions = [newRegisteredExtensions copy];
-	extensionsOrder = [extensionsOrder arrayByAddingObject:extensionName];
+	YDBLogVerbose(@"Trained compression dictionary for collection(%@): %lu bytes -> %lu bytes (samples: %lu)",
+	              collection, (unsigned long)currentLength, (unsigned long)trainedLength, (unsigned long)samples.count);
 	
-	NSSet *dependencies = [extension dependencies];
-	if (dependencies == nil)
-		dependencies = [NSSet set];
+	if (trainedLength >= currentLength) return NO;
 	
-	NSMutableDictionary *newExtensionDependencies = [extensionDependencies mutableCopy];
-	[newExtensionDependencies setObject:dependencies forKey:extensionName];
+	// Step 3:
+	// Store the new dictionary.
+	//
+	// It only becomes active after the transaction has been committed.
+	// Otherwise a concurrent write could reference a dictionary that doesn't (yet) exist in the database.
 	
-	extensionDependencies = [newExtensionDependencies copy];
+	__block int64_t dictionaryId = 0;
 	
-	extensionsReady = NO;
-	sharedKeySetForExtensions = [NSDictionary sharedKeySetForKeys:[registeredExtensions allKeys]];
+	[self readWriteWithBlock:^(YapDatabaseReadWriteTransaction __unused *transaction) {
+		
+		dictionaryId = [self insertCompressionDictionary:dictionary forCollection:collection];
+	}];
 	
-	// Set the registeredExtensionsChanged flag.
-	// This will be consulted during the creation of the changeset,
-	// and will cause us to add the updated registeredExtensions to the list of changes.
-	// It will then get propogated to the database, and all other connections.
+	if (dictionaryId <= 0 || dictionaryId > UINT32_MAX) return NO;
 	
-	registeredExtensionsChanged = YES;
+	[database didInsertCompressionDictionary:dictionary withId:(uint32_t)dictionaryId forCollection:collection];
+	return YES;
 }
 
-- (void)didUnregisterExtensionWithName:(NSString *)extensionName
+/**
+ * Must be invoked from within a transaction.
+**/
+- (NSArray<NSData *> *)compressionSamplesForCollection:(NSString *)collection limit:(NSUInteger)limit
 {
-	// This method is INTERNAL
+	NSMutableArray<NSData *> *samples = [NSMutableArray arrayWithCapacity:MIN(limit, (NSUInteger)1000)];
 	
-	if ([registeredExtensions objectForKey:extensionName])
+	sqlite3_stmt *statement;
+	
+	const char *stmt =
+	  "SELECT \"data\" FROM \"database2\" WHERE \"collection\" = ? ORDER BY \"rowid\" DESC LIMIT ?;";
+	
+	int const column_idx_data     = SQLITE_COLUMN_START;
+	int const bind_idx_collection = SQLITE_BIND_START + 0;
+	int const bind_idx_limit      = SQLITE_BIND_START + 1;
+	
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
 	{
-		NSMutableDictionary *newRegisteredExtensions = [registeredExtensions mutableCopy];
-		[newRegisteredExtensions removeObjectForKey:extensionName];
-		
-		registeredExtensions = [newRegisteredExtensions copy];
-		
-		NSMutableArray *newExtensionsOrder = [extensionsOrder mutableCopy];
-		[newExtensionsOrder removeObject:extensionName];
-		
-		extensionsOrder = [newExtensionsOrder copy];
-		
-		NSMutableDictionary *newExtensionDependencies = [extensionDependencies mutableCopy];
-		[newExtensionDependencies removeObjectForKey:extensionName];
-		
-		extensionDependencies = [newExtensionDependencies copy];
-		
-		extensionsReady = NO;
-		sharedKeySetForExtensions = [NSDictionary sharedKeySetForKeys:[registeredExtensions allKeys]];
-		
-		// Set the registeredExtensionsChanged flag.
-		// This will be consulted during the creation of the changeset,
-		// and will cause us to add the updated registeredExtensions to the list of changes.
-		// It will then get propogated to the database, and all other connections.
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return samples;
+	}
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	sqlite3_bind_int64(statement, bind_idx_limit, (sqlite3_int64)MIN(limit, (NSUInteger)INT64_MAX));
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		const void *blob = sqlite3_column_blob(statement, column_idx_data);
+		int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 		
-		registeredExtensionsChanged = YES;
+		NSData *sample = YapDatabaseCopySerializedObject(database, blob, blobSize);
+		if (sample.length > 0) {
+			[samples addObject:sample];
+		}
 	}
-}
-
-- (void)addRegisteredExtensionConnection:(YapDatabaseExtensionConnection *)extConnection withName:(NSString *)extName
-{
-	// This method is INTERNAL
 	
-	if (extensions == nil)
-		extensions = [[NSMutableDictionary alloc] init];
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@: Error executing statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
 	
-	[extensions setObject:extConnection forKey:extName];
-}
-
-- (void)removeRegisteredExtensionConnectionWithName:(NSString *)extName
-{
-	// This method is INTERNAL
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
 	
-	[extensions removeObjectForKey:extName];
+	return samples;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Pragma
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Returns the current synchronous configuration via "PRAGMA synchronous;".
- * Allows you to verify that sqlite accepted your synchronous configuration request.
+ * Must be invoked from within a readWrite transaction.
+ * Returns the dictionary_id, or zero on error.
 **/
-- (NSString *)pragmaSynchronous
+- (int64_t)insertCompressionDictionary:(NSData *)dictionary forCollection:(NSString *)collection
 {
-	__block int64_t value = -1;
+	sqlite3_stmt *statement;
 	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		value = [YapDatabase pragma:@"synchronous" using:db];
-		
-	#pragma clang diagnostic pop
-	}};
+	const char *stmt =
+	  "INSERT INTO \"yap_compression_dictionaries\" (\"collection\", \"trained\", \"data\") VALUES (?, 1, ?);";
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	int const bind_idx_collection = SQLITE_BIND_START + 0;
+	int const bind_idx_data       = SQLITE_BIND_START + 1;
 	
-	return [YapDatabase pragmaValueForSynchronous:value];
-}
-
-/**
- * Returns the current page_size configuration via "PRAGMA page_size;".
- * Allows you to verify that sqlite accepted your page_size configuration request.
-**/
-- (NSInteger)pragmaPageSize
-{
-	__block int64_t value = -1;
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return 0;
+	}
 	
-	dispatch_block_t block = ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		value = [YapDatabase pragma:@"page_size" using:db];
-		
-	#pragma clang diagnostic pop
-	}};
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	sqlite3_bind_blob(statement, bind_idx_data, dictionary.bytes, (int)dictionary.length, SQLITE_STATIC);
 	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
+	int64_t dictionaryId = 0;
+	
+	status = sqlite3_step(statement);
+	if (status == SQLITE_DONE)
+	{
+		dictionaryId = sqlite3_last_insert_rowid(db);
+		hasDiskChanges = YES;
+	}
 	else
-		dispatch_sync(connectionQueue, block);
+	{
+		YDBLogError(@"Error inserting compression dictionary: %d %s", status, sqlite3_errmsg(db));
+	}
 	
-	return (NSInteger)value;
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
+	
+	return dictionaryId;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Backup
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * Returns the currently memory mapped I/O configureation via "PRAGMA mmap_size;".
- * Allows you to verify that sqlite accepted your mmap_size configuration request.
+ * This method backs up the database by exporting all the tables to another sqlite database.
  *
- * Memory mapping may be disabled by sqlite's compile-time options.
- * Or it may restrict the mmap_size to something smaller than requested.
+ * This method operates as a synchronous ReadWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ *
+ * The database will be backed up as it exists at the moment this transaction operates.
+ * That is, it will backup everything in the sqlite file, as well as everything in the WAL file.
+ *
+ * For more information on the BACKUP operation, see the sqlite docs:
+ * https://www.sqlite.org/c3ref/backup_finish.html
+ *
+ * As stated in the sqlite docs, it is your responsibilty to ensure that nothing else is
+ * currently using the backupDatabase.
 **/
-- (NSInteger)pragmaMMapSize
+- (NSError *)backupToPath:(NSString *)backupDatabasePath
 {
-	__block int64_t value = -1;
+	__block NSError *error = nil;
 	
-	dispatch_block_t block = ^{ @autoreleasepool {
+	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+	
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		value = [YapDatabase pragma:@"mmap_size" using:db];
+		if (longLivedReadTransaction)
+		{
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+						   self, database);
+				
+				[self endLongLivedReadTransaction];
+			}
+		}
+		
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			[self prePseudoReadWriteTransaction];
+			
+			error = [self _backupToPath:backupDatabasePath withStep:1500 progress:nil];
+			
+			hasDiskChanges = NO; // backup does NOT make actually make changes
+			[self postPseudoReadWriteTransaction];
+			
+		}}); // End dispatch_sync(database->writeQueue)
 		
 	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	}}); // End dispatch_sync(connectionQueue)
 	
-	return (NSInteger)value;
+	return error;
 }
 
 /**
- * Upgrade Notice:
+ * This method backs up the database by exporting all the tables to another sqlite database.
  *
- * The "auto_vacuum=FULL" was not properly set until YapDatabase v2.5.
- * And thus if you have an app that was using YapDatabase prior to this version,
- * then the existing database file will continue to operate in "auto_vacuum=NONE" mode.
- * This means the existing database file won't be properly truncated as you delete information from the db.
- * That is, the data will be removed, but the pages will be moved to the freelist,
- * and the file itself will remain the same size on disk. (I.e. the file size can grow, but not shrink.)
- * To correct this problem, you should run the vacuum operation is at least once.
- * After it is run, the "auto_vacuum=FULL" mode will be set,
- * and the database file size will automatically shrink in the future (as you delete data).
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
+ * 
+ * The database will be backed up as it exists at the moment this transaction operates.
+ * That is, it will backup everything in the sqlite file, as well as everything in the WAL file.
+ * 
+ * An optional completion block may be used.
+ * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
  *
- * @returns Result from "PRAGMA auto_vacuum;" command, as a readable string:
- *   - NONE
- *   - FULL
- *   - INCREMENTAL
- *   - UNKNOWN (future proofing)
+ * For more information on the BACKUP operation, see the sqlite docs:
+ * https://www.sqlite.org/c3ref/backup_finish.html
+ *
+ * As stated in the sqlite docs, it is your responsibilty to ensure that nothing else is
+ * currently using the backupDatabase.
+ *
+ * @return
+ *   A NSProgress instance that may be used to track the backup progress.
+ *   The progress in cancellable, meaning that invoking [progress cancel] will abort the backup operation.
+**/
+- (NSProgress *)asyncBackupToPath:(NSString *)backupDatabasePath
+                  completionBlock:(nullable void (^)(NSError *error))completionBlock
+{
+	return [self asyncBackupToPath:backupDatabasePath completionQueue:NULL completionBlock:completionBlock];
+}
+
+/**
+ * This method backs up the database by exporting all the tables to another sqlite database.
  *
- * If the return value is NONE, then you should run the vacuum operation at some point
- * in order to properly reconfigure the database.
+ * This method operates as an asynchronous readWrite "transaction".
+ * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
  *
- * Concerning Method Invocation:
+ * The database will be backed up as it exists at the moment this transaction operates.
+ * That is, it will backup everything in the sqlite file, as well as everything in the WAL file.
  *
- * You can invoke this method as a standalone method on the connection:
+ * An optional completion block may be used.
+ * Additionally the dispatch_queue to invoke the completion block may also be specified.
+ * If NULL, dispatch_get_main_queue() is automatically used.
  *
- *   NSString *value = [databaseConnection pragmaAutoVacuum]
+ * For more information on the BACKUP operation, see the sqlite docs:
+ * https://www.sqlite.org/c3ref/backup_finish.html
  *
- * Or you can invoke this method within a transaction:
+ * As stated in the sqlite docs, it is your responsibilty to ensure that nothing else is
+ * currently using the backupDatabase.
  *
- * [databaseConnection asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction){
- *     NSString *value = [databaseConnection pragmaAutoVacuum];
- * }];
+ * @return
+ *   A NSProgress instance that may be used to track the backup progress.
+ *   The progress in cancellable, meaning that invoking [progress cancel] will abort the backup operation.
 **/
-- (NSString *)pragmaAutoVacuum
+- (NSProgress *)asyncBackupToPath:(NSString *)backupDatabasePath
+                  completionQueue:(nullable dispatch_queue_t)completionQueue
+                  completionBlock:(nullable void (^)(NSError *))completionBlock
 {
-	__block int64_t value = -1;
+	if (completionQueue == NULL && completionBlock != NULL)
+		completionQueue = dispatch_get_main_queue();
 	
-	dispatch_block_t block = ^{ @autoreleasepool {
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:0];
+	
+	dispatch_async(connectionQueue, ^{ @autoreleasepool {
+		
+	// IMPORTANT:
+	// We are purposefully retaining self here.
+	// Here are the rules:
+	// - a YapDatabaseConnection instance cannot be deallocated if there are existing/pending transactions
+	// - a YapDatabase instance cannot be deallocated if there are existing connections
+	//
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		value = [YapDatabase pragma:@"auto_vacuum" using:db];
+		if (longLivedReadTransaction)
+		{
+			if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+			{
+				@throw [self implicitlyEndingLongLivedReadTransactionException];
+			}
+			else
+			{
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+						   self, database);
+				
+				[self endLongLivedReadTransaction];
+			}
+		}
+		
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			[self prePseudoReadWriteTransaction];
+			
+			NSError *error = [self _backupToPath:backupDatabasePath withStep:1500 progress:progress];
+			
+			hasDiskChanges = NO; // backup does NOT make actually make changes
+			[self postPseudoReadWriteTransaction];
+			
+			if (completionBlock)
+			{
+				dispatch_async(completionQueue, ^{ @autoreleasepool {
+					completionBlock(error);
+				}});
+			}
+			
+		}}); // End dispatch_sync(database->writeQueue)
 		
 	#pragma clang diagnostic pop
-	}};
-	
-	if (dispatch_get_specific(IsOnConnectionQueueKey))
-		block();
-	else
-		dispatch_sync(connectionQueue, block);
+	}}); // End dispatch_async(connectionQueue)
 	
-	return [YapDatabase pragmaValueForAutoVacuum:value];
+	return progress;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Vacuum
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Performs a VACUUM on the sqlite database.
+ * This method backs up the database by cloning the database file (copy-on-write),
+ * falling back to backupToPath: if the filesystem doesn't support cloning.
  *
  * This method operates as a synchronous ReadWrite "transaction".
  * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
- *
- * For more infomation on the VACUUM operation, see the sqlite docs:
- * http://sqlite.org/lang_vacuum.html
- *
- * Remember that YapDatabase operates in WAL mode, with "auto_vacuum=FULL" set.
- *
- * @see pragmaAutoVacuum
 **/
-- (void)vacuum
+- (NSError *)cloneBackupToPath:(NSString *)backupDatabasePath
 {
+	__block NSError *error = nil;
+	
 	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
-		
+	
 	// IMPORTANT:
 	// We are purposefully retaining self here.
 	// Here are the rules:
@@ -5761,79 +10282,37 @@ static int connectionBusyHandler(void *ptr, int count)
 			
 			[self prePseudoReadWriteTransaction];
 			
-			int status;
-			
-			status = sqlite3_exec(db, "PRAGMA auto_vacuum = FULL;", NULL, NULL, NULL);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"Error setting PRAGMA auto_vacuum: %d %s", status, sqlite3_errmsg(db));
-			}
-			
-			YDBLogVerbose(@"Starting VACUUM ...");
-			
-			status = sqlite3_exec(db, "VACUUM;", NULL, NULL, NULL);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"Error performing VACUUM: %d %s", status, sqlite3_errmsg(db));
-			}
-			
-			YDBLogVerbose(@"VACUUM complete !");
+			error = [self _cloneBackupToPath:backupDatabasePath progress:nil];
 			
-			hasDiskChanges = YES;
+			hasDiskChanges = NO; // backup does NOT make actually make changes
 			[self postPseudoReadWriteTransaction];
 			
 		}}); // End dispatch_sync(database->writeQueue)
 		
 	#pragma clang diagnostic pop
 	}}); // End dispatch_sync(connectionQueue)
+	
+	return error;
 }
 
 /**
- * Performs a VACUUM on the sqlite database.
- *
- * This method operates as an asynchronous readWrite "transaction".
- * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
- *
- * For more infomation on the VACUUM operation, see the sqlite docs:
- * http://sqlite.org/lang_vacuum.html
- *
- * Remember that YapDatabase operates in WAL mode, with "auto_vacuum=FULL" set.
- *
- * An optional completion block may be used.
- * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
- *
- * @see pragmaAutoVacuum
-**/
-- (void)asyncVacuumWithCompletionBlock:(dispatch_block_t)completionBlock
-{
-	[self asyncVacuumWithCompletionQueue:NULL completionBlock:completionBlock];
-}
-
-/**
- * Performs a VACUUM on the sqlite database.
+ * This method backs up the database by cloning the database file (copy-on-write),
+ * falling back to asyncBackupToPath: if the filesystem doesn't support cloning.
  *
  * This method operates as an asynchronous readWrite "transaction".
  * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
- *
- * For more infomation on the VACUUM operation, see the sqlite docs:
- * http://sqlite.org/lang_vacuum.html
- *
- * Remember that YapDatabase operates in WAL mode, with "auto_vacuum=FULL" set.
- *
- * An optional completion block may be used.
- * Additionally the dispatch_queue to invoke the completion block may also be specified.
- * If NULL, dispatch_get_main_queue() is automatically used.
- * 
- * @see pragmaAutoVacuum
 **/
-- (void)asyncVacuumWithCompletionQueue:(dispatch_queue_t)completionQueue
-                       completionBlock:(dispatch_block_t)completionBlock
+- (NSProgress *)asyncCloneBackupToPath:(NSString *)backupDatabasePath
+                       completionQueue:(nullable dispatch_queue_t)completionQueue
+                       completionBlock:(nullable void (^)(NSError *))completionBlock
 {
 	if (completionQueue == NULL && completionBlock != NULL)
 		completionQueue = dispatch_get_main_queue();
 	
-	dispatch_async(connectionQueue, ^{ @autoreleasepool {
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:0];
 	
+	dispatch_async(connectionQueue, ^{ @autoreleasepool {
+		
 	// IMPORTANT:
 	// We are purposefully retaining self here.
 	// Here are the rules:
@@ -5851,68 +10330,163 @@ static int connectionBusyHandler(void *ptr, int count)
 			}
 			else
 			{
-				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
-						   self, database);
+				YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+						   self, database);
+				
+				[self endLongLivedReadTransaction];
+			}
+		}
+		
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			[self prePseudoReadWriteTransaction];
+			
+			NSError *error = [self _cloneBackupToPath:backupDatabasePath progress:progress];
+			
+			hasDiskChanges = NO; // backup does NOT make actually make changes
+			[self postPseudoReadWriteTransaction];
+			
+			if (completionBlock)
+			{
+				dispatch_async(completionQueue, ^{ @autoreleasepool {
+					completionBlock(error);
+				}});
+			}
+			
+		}}); // End dispatch_sync(database->writeQueue)
+		
+	#pragma clang diagnostic pop
+	}}); // End dispatch_async(connectionQueue)
+	
+	return progress;
+}
+
+- (NSError *)_cloneBackupToPath:(NSString *)backupDatabasePath progress:(NSProgress *)progress
+{
+	// We're on the writeQueue, so nothing can be committed while the file is cloned.
+	// The database truncates the WAL first, so the clone is a consistent & complete copy.
+	
+	if ([database cloneDatabaseFileToPath:backupDatabasePath])
+	{
+		progress.totalUnitCount = 1;
+		progress.completedUnitCount = 1;
+		
+		return nil;
+	}
+	
+	YDBLogInfo(@"Unable to clone the database file. Falling back to sqlite backup.");
+	
+	return [self _backupToPath:backupDatabasePath withStep:1500 progress:progress];
+}
+
+- (NSError *)_backupToPath:(NSString *)backupDatabasePath withStep:(int)nPages progress:(NSProgress *)progress
+{
+	// First try to open the backup database (using the given path).
+	
+	sqlite3 *backup_db;
+	
+	int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
+	
+	int status = sqlite3_open_v2([backupDatabasePath UTF8String], &backup_db, flags, NULL);
+	if (status != SQLITE_OK)
+	{
+		NSError *sqliteError = nil;
+		
+		// Sometimes the open function returns a db to allow us to query it for the error message
+		if (backup_db) {
+			sqliteError = [self sqliteErrorWithCode:status message:sqlite3_errmsg(backup_db)];
+		}
+		else {
+			sqliteError = [self sqliteErrorWithCode:status message:NULL];
+		}
+		
+		if (backup_db)
+		{
+			sqlite3_close(backup_db);
+			backup_db = NULL;
+		}
+		
+		return [self ydbErrorWithDescription:@"Error from: sqlite3_open_v2()" sqliteError:sqliteError];
+	}
+	
+	// Initialize backup instance
+	
+	sqlite3_backup *backup = sqlite3_backup_init(backup_db, "main", db, "main");
+	if (backup == NULL)
+	{
+		// From the docs:
+		//
+		// If an error occurs within sqlite3_backup_init(D,N,S,M), then NULL is returned and an error code
+		// and error message are stored in the destination database connection D. The error code and message for
+		// the failed call to sqlite3_backup_init() can be retrieved using the sqlite3_errcode(), sqlite3_errmsg().
+		
+		NSError *sqliteError = [self sqliteErrorWithCode:sqlite3_errcode(backup_db)
+												 message:sqlite3_errmsg(backup_db)];
+		
+		return [self ydbErrorWithDescription:@"Error from: sqlite3_backup_init()" sqliteError:sqliteError];
+	}
+	
+	// Loop through the backup process
+	
+	BOOL cancelled = progress.cancelled;
+	if (!cancelled)
+	{
+		while ((status = sqlite3_backup_step(backup, nPages)) == SQLITE_OK)
+		{
+			if (progress)
+			{
+				int pagecount = sqlite3_backup_pagecount(backup);
+				int remaining = sqlite3_backup_remaining(backup);
 				
-				[self endLongLivedReadTransaction];
+				progress.totalUnitCount = pagecount;
+				progress.completedUnitCount = (pagecount - remaining);
+				
+				cancelled = progress.cancelled;
+				if (cancelled) break;
 			}
 		}
-		
-		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
-			
-			[self prePseudoReadWriteTransaction];
-			
-			int status;
-			
-			status = sqlite3_exec(db, "PRAGMA auto_vacuum = FULL;", NULL, NULL, NULL);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"Error setting PRAGMA auto_vacuum: %d %s", status, sqlite3_errmsg(db));
-			}
-			
-			YDBLogVerbose(@"Starting VACUUM ...");
-			
-			status = sqlite3_exec(db, "VACUUM;", NULL, NULL, NULL);
-			if (status != SQLITE_OK)
+	}
+	
+	NSError *error = nil;
+	
+	if (cancelled)
+	{
+		error = [self ydbErrorWithDescription:@"Operation cancelled" sqliteError:nil];
+	}
+	else
+	{
+		if (status == SQLITE_DONE)
+		{
+			if (progress)
 			{
-				YDBLogError(@"Error performing VACUUM: %d %s", status, sqlite3_errmsg(db));
-			}
-			
-			YDBLogVerbose(@"VACUUM complete !");
-			
-			hasDiskChanges = YES;
-			[self postPseudoReadWriteTransaction];
-			
-			if (completionBlock) {
-				dispatch_async(completionQueue, completionBlock);
+				int pagecount = sqlite3_backup_pagecount(backup);
+				int remaining = sqlite3_backup_remaining(backup);
+				
+				progress.totalUnitCount = pagecount;
+				progress.completedUnitCount = (pagecount - remaining);
 			}
+		}
+		else // if (status != SQLITE_DONE)
+		{
+			NSError *sqliteError = [self sqliteErrorWithCode:status message:sqlite3_errstr(status)];
 			
-		}}); // End dispatch_sync(database->writeQueue)
+			error = [self ydbErrorWithDescription:@"Error from: sqlite3_backup_step()" sqliteError:sqliteError];
+		}
+	}
 	
-	#pragma clang diagnostic pop
-	}}); // End dispatch_async(connectionQueue)
+	sqlite3_backup_finish(backup);
+	sqlite3_close(backup_db);
+	
+	return error;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Backup
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * This method backs up the database by exporting all the tables to another sqlite database.
+ * This method backs up the database by writing the pages that have changed since the previous incremental backup.
  *
  * This method operates as a synchronous ReadWrite "transaction".
  * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
- *
- * The database will be backed up as it exists at the moment this transaction operates.
- * That is, it will backup everything in the sqlite file, as well as everything in the WAL file.
- *
- * For more information on the BACKUP operation, see the sqlite docs:
- * https://www.sqlite.org/c3ref/backup_finish.html
- *
- * As stated in the sqlite docs, it is your responsibilty to ensure that nothing else is
- * currently using the backupDatabase.
 **/
-- (NSError *)backupToPath:(NSString *)backupDatabasePath
+- (NSError *)incrementalBackupToPath:(NSString *)backupPath
 {
 	__block NSError *error = nil;
 	
@@ -5946,7 +10520,7 @@ static int connectionBusyHandler(void *ptr, int count)
 			
 			[self prePseudoReadWriteTransaction];
 			
-			error = [self _backupToPath:backupDatabasePath withStep:1500 progress:nil];
+			error = [self _incrementalBackupToPath:backupPath progress:nil];
 			
 			hasDiskChanges = NO; // backup does NOT make actually make changes
 			[self postPseudoReadWriteTransaction];
@@ -5960,59 +10534,22 @@ static int connectionBusyHandler(void *ptr, int count)
 }
 
 /**
- * This method backs up the database by exporting all the tables to another sqlite database.
- *
- * This method operates as an asynchronous readWrite "transaction".
- * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
- * 
- * The database will be backed up as it exists at the moment this transaction operates.
- * That is, it will backup everything in the sqlite file, as well as everything in the WAL file.
- * 
- * An optional completion block may be used.
- * The completionBlock will be invoked on the main thread (dispatch_get_main_queue()).
- *
- * For more information on the BACKUP operation, see the sqlite docs:
- * https://www.sqlite.org/c3ref/backup_finish.html
- *
- * As stated in the sqlite docs, it is your responsibilty to ensure that nothing else is
- * currently using the backupDatabase.
- *
- * @return
- *   A NSProgress instance that may be used to track the backup progress.
- *   The progress in cancellable, meaning that invoking [progress cancel] will abort the backup operation.
-**/
-- (NSProgress *)asyncBackupToPath:(NSString *)backupDatabasePath
-                  completionBlock:(nullable void (^)(NSError *error))completionBlock
-{
-	return [self asyncBackupToPath:backupDatabasePath completionQueue:NULL completionBlock:completionBlock];
-}
-
-/**
- * This method backs up the database by exporting all the tables to another sqlite database.
+ * This method backs up the database by writing the pages that have changed since the previous incremental backup.
  *
  * This method operates as an asynchronous readWrite "transaction".
  * That is, it behaves in a similar fashion, and you may treat it as if it is a ReadWrite transaction.
  *
- * The database will be backed up as it exists at the moment this transaction operates.
- * That is, it will backup everything in the sqlite file, as well as everything in the WAL file.
- *
  * An optional completion block may be used.
  * Additionally the dispatch_queue to invoke the completion block may also be specified.
  * If NULL, dispatch_get_main_queue() is automatically used.
  *
- * For more information on the BACKUP operation, see the sqlite docs:
- * https://www.sqlite.org/c3ref/backup_finish.html
- *
- * As stated in the sqlite docs, it is your responsibilty to ensure that nothing else is
- * currently using the backupDatabase.
- *
  * @return
  *   A NSProgress instance that may be used to track the backup progress.
  *   The progress in cancellable, meaning that invoking [progress cancel] will abort the backup operation.
 **/
-- (NSProgress *)asyncBackupToPath:(NSString *)backupDatabasePath
-                  completionQueue:(nullable dispatch_queue_t)completionQueue
-                  completionBlock:(nullable void (^)(NSError *))completionBlock
+- (NSProgress *)asyncIncrementalBackupToPath:(NSString *)backupPath
+                             completionQueue:(dispatch_queue_t)completionQueue
+                             completionBlock:(void (^)(NSError *))completionBlock
 {
 	if (completionQueue == NULL && completionBlock != NULL)
 		completionQueue = dispatch_get_main_queue();
@@ -6049,7 +10586,7 @@ static int connectionBusyHandler(void *ptr, int count)
 			
 			[self prePseudoReadWriteTransaction];
 			
-			NSError *error = [self _backupToPath:backupDatabasePath withStep:1500 progress:progress];
+			NSError *error = [self _incrementalBackupToPath:backupPath progress:progress];
 			
 			hasDiskChanges = NO; // backup does NOT make actually make changes
 			[self postPseudoReadWriteTransaction];
@@ -6069,104 +10606,178 @@ static int connectionBusyHandler(void *ptr, int count)
 	return progress;
 }
 
-- (NSError *)_backupToPath:(NSString *)backupDatabasePath withStep:(int)nPages progress:(NSProgress *)progress
+/**
+ * This method must be invoked from within the connectionQueue.
+ * This method must be invoked from within the database.writeQueue.
+**/
+- (NSError *)_incrementalBackupToPath:(NSString *)backupPath progress:(NSProgress *)progress
 {
-	// First try to open the backup database (using the given path).
+#ifdef SQLITE_HAS_CODEC
+	YapDatabaseOptions *options = database.options;
+	if (options.cipherKeyBlock || options.cipherKeySpecBlock)
+	{
+		return [self ydbErrorWithDescription:@"Incremental backups aren't supported for encrypted databases"
+		                         sqliteError:nil];
+	}
+#endif
 	
-	sqlite3 *backup_db;
+	yap_vfs *vfs = database->yap_vfs_shim;
+	if (vfs == NULL || vfs->page_tracker == NULL)
+	{
+		return [self ydbErrorWithDescription:@"Incremental backups require YapDatabaseOptions.enableIncrementalBackup"
+		                         sqliteError:nil];
+	}
 	
-	int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
+	// Since we're on the writeQueue, nothing else can be writing to the WAL.
+	// So the recorded pages are exactly the pages that have changed since the previous incremental backup.
+	//
+	// If anything below fails, the recorded pages are lost.
+	// So we forget the previous backup, which makes the next one a full backup.
 	
-	int status = sqlite3_open_v2([backupDatabasePath UTF8String], &backup_db, flags, NULL);
-	if (status != SQLITE_OK)
+	uint8_t *dirtyPages = NULL;
+	uint32_t dirtyPageCapacity = 0;
+	yap_vfs_take_dirty_pages(vfs, &dirtyPages, &dirtyPageCapacity);
+	
+	NSUUID *parentBackupId = database->lastIncrementalBackupId;
+	database->lastIncrementalBackupId = nil;
+	
+	if (enableMultiProcessSupport)
 	{
-		NSError *sqliteError = nil;
-		
-		// Sometimes the open function returns a db to allow us to query it for the error message
-		if (backup_db) {
-			sqliteError = [self sqliteErrorWithCode:status message:sqlite3_errmsg(backup_db)];
-		}
-		else {
-			sqliteError = [self sqliteErrorWithCode:status message:NULL];
-		}
-		
-		if (backup_db)
-		{
-			sqlite3_close(backup_db);
-			backup_db = NULL;
-		}
-		
-		return [self ydbErrorWithDescription:@"Error from: sqlite3_open_v2()" sqliteError:sqliteError];
+		// Other processes write to the WAL without going through our shim.
+		parentBackupId = nil;
 	}
 	
-	// Initialize backup instance
+	sqlite3_stmt *statement = NULL;
 	
-	sqlite3_backup *backup = sqlite3_backup_init(backup_db, "main", db, "main");
-	if (backup == NULL)
+	const char *stmt = "SELECT \"data\" FROM sqlite_dbpage WHERE \"pgno\" = ?;";
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
 	{
-		// From the docs:
-		//
-		// If an error occurs within sqlite3_backup_init(D,N,S,M), then NULL is returned and an error code
-		// and error message are stored in the destination database connection D. The error code and message for
-		// the failed call to sqlite3_backup_init() can be retrieved using the sqlite3_errcode(), sqlite3_errmsg().
-		
-		NSError *sqliteError = [self sqliteErrorWithCode:sqlite3_errcode(backup_db)
-												 message:sqlite3_errmsg(backup_db)];
+		sqlite3_free(dirtyPages);
 		
-		return [self ydbErrorWithDescription:@"Error from: sqlite3_backup_init()" sqliteError:sqliteError];
+		NSError *sqliteError = [self sqliteErrorWithCode:status message:sqlite3_errmsg(db)];
+		return [self ydbErrorWithDescription:@"Incremental backups require SQLITE_ENABLE_DBPAGE_VTAB"
+		                         sqliteError:sqliteError];
 	}
 	
-	// Loop through the backup process
+	// Read everything from a single snapshot.
 	
-	BOOL cancelled = progress.cancelled;
-	if (!cancelled)
+	sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+	
+	uint32_t pageSize = (uint32_t)[YapDatabase pragma:@"page_size" using:db];
+	uint32_t databasePageCount = (uint32_t)[YapDatabase pragma:@"page_count" using:db];
+	
+	// Figure out which pages to write
+	
+	uint32_t pageCount = 0;
+	
+	if (parentBackupId == nil)
 	{
-		while ((status = sqlite3_backup_step(backup, nPages)) == SQLITE_OK)
+		pageCount = databasePageCount;
+	}
+	else
+	{
+		for (uint32_t index = 0; index < MIN(dirtyPageCapacity, databasePageCount); index++)
 		{
-			if (progress)
-			{
-				int pagecount = sqlite3_backup_pagecount(backup);
-				int remaining = sqlite3_backup_remaining(backup);
-				
-				progress.totalUnitCount = pagecount;
-				progress.completedUnitCount = (pagecount - remaining);
-				
-				cancelled = progress.cancelled;
-				if (cancelled) break;
+			if (dirtyPages[index / 8] & (1 << (index % 8))) {
+				pageCount++;
 			}
 		}
 	}
 	
+	progress.totalUnitCount = pageCount;
+	
 	NSError *error = nil;
+	uint32_t writtenPageCount = 0;
 	
-	if (cancelled)
+	int fd = YapDatabaseIncrementalBackupCreate(backupPath);
+	if (fd < 0)
 	{
-		error = [self ydbErrorWithDescription:@"Operation cancelled" sqliteError:nil];
+		error = [self ydbErrorWithDescription:@"Unable to create backup file" sqliteError:nil];
 	}
-	else
+	
+	for (uint32_t index = 0; index < databasePageCount && error == nil; index++)
 	{
-		if (status == SQLITE_DONE)
+		if (parentBackupId)
+		{
+			if (index >= dirtyPageCapacity) break;
+			if ((dirtyPages[index / 8] & (1 << (index % 8))) == 0) continue;
+		}
+		
+		uint32_t pgno = index + 1;
+		
+		sqlite3_bind_int64(statement, SQLITE_BIND_START, pgno);
+		
+		status = sqlite3_step(statement);
+		if (status == SQLITE_ROW)
+		{
+			const void *page = sqlite3_column_blob(statement, SQLITE_COLUMN_START);
+			int pageLength = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
+			
+			if (page && (uint32_t)pageLength == pageSize)
+			{
+				if (!YapDatabaseIncrementalBackupWritePage(fd, pgno, page, pageSize)) {
+					error = [self ydbErrorWithDescription:@"Unable to write backup file" sqliteError:nil];
+				}
+			}
+			else
+			{
+				error = [self ydbErrorWithDescription:@"Unexpected page size from sqlite_dbpage" sqliteError:nil];
+			}
+		}
+		else
+		{
+			NSError *sqliteError = [self sqliteErrorWithCode:status message:sqlite3_errmsg(db)];
+			error = [self ydbErrorWithDescription:@"Error reading from sqlite_dbpage" sqliteError:sqliteError];
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		
+		if (error == nil)
 		{
+			writtenPageCount++;
+			
 			if (progress)
 			{
-				int pagecount = sqlite3_backup_pagecount(backup);
-				int remaining = sqlite3_backup_remaining(backup);
+				progress.completedUnitCount = writtenPageCount;
 				
-				progress.totalUnitCount = pagecount;
-				progress.completedUnitCount = (pagecount - remaining);
+				if (progress.cancelled) {
+					error = [self ydbErrorWithDescription:@"Operation cancelled" sqliteError:nil];
+				}
 			}
 		}
-		else // if (status != SQLITE_DONE)
+	}
+	
+	sqlite3_exec(db, "COMMIT TRANSACTION;", NULL, NULL, NULL);
+	sqlite3_finalize(statement);
+	sqlite3_free(dirtyPages);
+	
+	if (fd >= 0)
+	{
+		if (error)
 		{
-			NSError *sqliteError = [self sqliteErrorWithCode:status message:sqlite3_errstr(status)];
+			YapDatabaseIncrementalBackupAbort(fd, backupPath);
+		}
+		else
+		{
+			YapDatabaseIncrementalBackup *backup =
+			  [[YapDatabaseIncrementalBackup alloc] initWithPath:backupPath
+			                                            backupId:[NSUUID UUID]
+			                                      parentBackupId:parentBackupId
+			                                            pageSize:pageSize
+			                                   databasePageCount:databasePageCount
+			                                           pageCount:writtenPageCount];
 			
-			error = [self ydbErrorWithDescription:@"Error from: sqlite3_backup_step()" sqliteError:sqliteError];
+			if (YapDatabaseIncrementalBackupFinish(fd, backup)) {
+				database->lastIncrementalBackupId = backup.backupId;
+			}
+			else {
+				error = [self ydbErrorWithDescription:@"Unable to write backup file" sqliteError:nil];
+			}
 		}
 	}
 	
-	sqlite3_backup_finish(backup);
-	sqlite3_close(backup_db);
-	
 	return error;
 }
 
@@ -6345,4 +10956,20 @@ static int connectionBusyHandler(void *ptr, int count)
 	return [NSException exceptionWithName:@"YapDatabaseException" reason:reason userInfo:userInfo];
 }
 
+- (NSException *)readOnlyImmutableException
+{
+	NSString *connectionName = self.name;
+	NSString *nameInfo = ([connectionName length] > 0) ? [NSString stringWithFormat:@" <%@>", connectionName] : @"";
+	
+	NSString *reason = [NSString stringWithFormat:
+	    @"YapDatabaseConnection[%p]%@ - attempt to modify a readOnlyImmutable database", self, nameInfo];
+	
+	NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
+		@"The database was opened with YapDatabaseOptions.readOnlyImmutable, so it cannot be modified."
+		@" This includes read-write transactions, as well as operations such as vacuum & backup"
+		@" (which go through the writeQueue). To modify the file, open it without the readOnlyImmutable option."};
+	
+	return [NSException exceptionWithName:@"YapDatabaseException" reason:reason userInfo:userInfo];
+}
+
 @end
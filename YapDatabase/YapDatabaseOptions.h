@@ -1,5 +1,8 @@
 #import <Foundation/Foundation.h>
 
+#import "YapDatabaseCompression.h"
+#import "YapDatabaseCheckpointPolicy.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 /**
@@ -27,6 +30,21 @@ typedef NS_ENUM(NSInteger, YapDatabasePragmaSynchronous) {
 	YapDatabasePragmaSynchronous_Full   = 2,
 };
 
+typedef NS_ENUM(NSInteger, YapDatabasePragmaAutoVacuum) {
+	YapDatabasePragmaAutoVacuum_Full        = 1,
+	YapDatabasePragmaAutoVacuum_Incremental = 2,
+};
+
+typedef id _Nullable (^YapDatabaseHeaderExtractor)(NSString *collection, NSString *key,
+                                                   const void *bytes, size_t length);
+
+typedef NS_ENUM(NSInteger, YapDatabaseNativeMetadataType) {
+	YapDatabaseNativeMetadataType_Integer = 1, // NSNumber, stored as INTEGER
+	YapDatabaseNativeMetadataType_Real    = 2, // NSNumber, stored as REAL
+	YapDatabaseNativeMetadataType_Text    = 3, // NSString, stored as TEXT
+	YapDatabaseNativeMetadataType_Date    = 4, // NSDate,   stored as REAL (timeIntervalSinceReferenceDate)
+};
+
 #ifdef SQLITE_HAS_CODEC
 typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
 #endif
@@ -154,6 +172,122 @@ typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
 **/
 @property (nonatomic, assign, readwrite) NSInteger pragmaMMapSize;
 
+/**
+ * Enables adaptive memory mapped I/O, in which the mmap_size of each connection tracks the size of the database file.
+ * 
+ * A fixed pragmaMMapSize has to be chosen up front. For a database that grows over time,
+ * a small value leaves most of the file to be read via read() syscalls,
+ * while a large value reserves address space that may not be available (e.g. on 32-bit or low-memory devices).
+ * 
+ * When this is set, pragmaMMapSize is ignored. Instead the mmap_size is set to the size of the database file,
+ * plus some headroom (so it isn't changed after every checkpoint). The size is re-evaluated after checkpoints
+ * (which is when the file grows), and each connection adopts the new size at the start of its next transaction.
+ * 
+ * The mmap_size never exceeds this value, nor a fraction of the physical memory of the device
+ * (and it's further limited on 32-bit devices, where address space is scarce).
+ * 
+ * The value is specified in BYTES.
+ * The default value is zero, meaning adaptive sizing is disabled.
+ * 
+ * The same restrictions as pragmaMMapSize apply (memory mapping may not be available).
+ * The mapped fraction of the file is reported by -[YapDatabase statistics].
+**/
+@property (nonatomic, assign, readwrite) NSInteger pragmaMMapSizeMaximum;
+
+/**
+ * Caps the total memory used by the sqlite page caches of all the connections of the database.
+ * 
+ * Each connection has its own sqlite instance, and thus its own page cache (~2 MB by default).
+ * So the page cache memory of a database otherwise grows with the number of connections.
+ * 
+ * When this is set, the budget is divided evenly among the open connections,
+ * and each connection's "PRAGMA cache_size" is set to its share.
+ * As connections are opened (or deallocated) the shares are recalculated,
+ * and each connection adopts its new share at the start of its next transaction.
+ * (A connection that shrinks its cache evicts the least recently used pages.)
+ * 
+ * Each share is at least 64 KB, so with a great many connections the total may slightly exceed the budget.
+ * A connection with its own pageCacheSize (see YapDatabaseConnection) uses that instead of its share.
+ * 
+ * Note that the page caches themselves can't be shared. Each connection reads from its own snapshot,
+ * so the same page may legitimately have different contents in different connections.
+ * To cache hot pages once for all connections, combine this with memory mapped I/O (see pragmaMMapSizeMaximum):
+ * pages that are read via the mapping are served from the (shared) OS file cache, and not copied into each page cache.
+ * 
+ * The value is specified in BYTES.
+ * The default value is zero, meaning each connection uses the sqlite default cache_size.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger pageCacheBudget;
+
+/**
+ * Allows you to configure the sqlite "PRAGMA auto_vacuum" option.
+ * 
+ * For more information, see the sqlite docs:
+ * https://www.sqlite.org/pragma.html#pragma_auto_vacuum
+ * 
+ * - YapDatabasePragmaAutoVacuum_Full
+ *     Free pages are moved to the end of the file, and the file is truncated, on every commit.
+ *     Deleting a large amount of data thus makes that commit correspondingly slower.
+ * 
+ * - YapDatabasePragmaAutoVacuum_Incremental
+ *     Free pages are kept in the freelist (where they will be reused by subsequent writes),
+ *     and are only given back to the file system by "PRAGMA incremental_vacuum".
+ *     YapDatabase runs this in small steps when the database is idle (see incrementalVacuumPageBudget).
+ * 
+ * Switching between FULL & INCREMENTAL takes effect when the database is opened.
+ * (Database files that are in "auto_vacuum=NONE" mode still require a full vacuum, see pragmaAutoVacuum.)
+ * 
+ * The default value is YapDatabasePragmaAutoVacuum_Full.
+**/
+@property (nonatomic, assign, readwrite) YapDatabasePragmaAutoVacuum pragmaAutoVacuum;
+
+/**
+ * When pragmaAutoVacuum is YapDatabasePragmaAutoVacuum_Incremental,
+ * free pages are reclaimed in steps, each of which is a short pseudo write transaction.
+ * 
+ * incrementalVacuumPageBudget:
+ *   The maximum number of pages that are reclaimed per step.
+ *   Zero disables the automatic steps (you can still invoke incrementalVacuumWithPageBudget: manually).
+ *   The default value is 256.
+ * 
+ * incrementalVacuumIdleInterval:
+ *   A step is scheduled after a checkpoint, and runs after this delay (in seconds),
+ *   but only if nothing was committed in the meantime (i.e. the database was idle).
+ *   Steps continue in this fashion until the freelist is empty.
+ *   The default value is 2.0.
+ * 
+ * You can inspect the freelist via -[YapDatabaseConnection pragmaFreelistCount].
+**/
+@property (nonatomic, assign, readwrite) NSUInteger incrementalVacuumPageBudget;
+@property (nonatomic, assign, readwrite) NSTimeInterval incrementalVacuumIdleInterval;
+
+/**
+ * Extension tables (secondary indexes, relationship edges, rtrees, view pages, ...) start out empty,
+ * so sqlite never has any statistics for them, and the query planner may pick the wrong index as they grow.
+ * 
+ * YapDatabase keeps track of the number of rows changed by read-write transactions,
+ * and once it reaches the analyzeChangeThreshold, runs "PRAGMA optimize" after the next checkpoint
+ * (on the same idle schedule as incrementalVacuumIdleInterval).
+ * Sqlite tracks the growth of each table itself, and only analyzes the tables whose row count changed significantly
+ * since they were last analyzed (or which have never been analyzed).
+ * 
+ * analyzeChangeThreshold:
+ *   The number of changed rows (across all tables) that triggers an optimize step.
+ *   Zero disables the automatic optimize steps.
+ *   The default value is 10,000.
+ * 
+ * analysisLimit:
+ *   The value of "PRAGMA analysis_limit" used for the optimize step.
+ *   This limits the number of rows ANALYZE visits per index, so the step is short even for very large tables,
+ *   at the cost of approximate statistics. Zero means no limit.
+ *   The default value is 400 (as recommended by sqlite).
+ * 
+ * Note: "PRAGMA optimize" only considers every table (rather than the tables queried by the sqlite3 instance)
+ * as of sqlite 3.46. With older versions of sqlite, a budgeted "ANALYZE" is run instead.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger analyzeChangeThreshold;
+@property (nonatomic, assign, readwrite) NSUInteger analysisLimit;
+
 #ifdef SQLITE_HAS_CODEC
 /**
  * Set a block here that returns the key for the SQLCipher database.
@@ -168,6 +302,11 @@ typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
  * in your Podfile for this option to take effect.
  *
  * Important: If you do not set a cipherKeyBlock the database will NOT be configured with encryption.
+ *
+ * Note: Deriving the key from the passphrase is (deliberately) slow.
+ * So the key is only derived once, when the database is opened.
+ * Every connection after that is keyed with the resulting raw key spec, which is kept in memory
+ * (for the lifetime of the YapDatabase instance). Use cipherKeySpecBlock if that isn't acceptable.
 **/
 @property (nonatomic, copy, readwrite) YapDatabaseCipherKeyBlock cipherKeyBlock;
 
@@ -317,17 +456,42 @@ typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
 **/
 @property (nonatomic, assign, readwrite) unsigned long long aggressiveWALTruncationSize;
 
+/**
+ * An optional checkpoint policy, which replaces the built-in checkpoint logic described above.
+ * 
+ * When set, the policy is consulted whenever a checkpoint opportunity arises (after commits, and when readers move forward),
+ * and it decides when to checkpoint, and in which mode (passive, full, restart or truncate).
+ * The policy is given the current WAL frame counts, the snapshot lag of readers, the recent write rate,
+ * and the device power state. (See YapDatabaseCheckpointContext)
+ * 
+ * YapDatabaseAdaptiveCheckpointPolicy provides a reasonable default,
+ * which avoids checkpointing during bursts of writes, while still bounding the size of the WAL.
+ * 
+ * The decisions made by the policy can be inspected via -[YapDatabase checkpointStatistics].
+ * 
+ * The default value is nil (i.e. the built-in checkpoint logic is used).
+**/
+@property (nonatomic, strong, readwrite, nullable) id<YapDatabaseCheckpointPolicy> checkpointPolicy;
+
 /**
  * This option enables multiprocess access to the database.
  *
  * All read and write operations will continue to function as expected when multiple processes are
  * concurrently accessing the database, but some optimizations are disabled when using this mode.
  *
- * For instance, when a process updates the database, all other processes must clear their cache to
- * fetch fresh data from the database.
+ * For instance, when a process updates the database, all other processes must update their cache.
+ * Each commit leaves a summary of the keys that changed in a shared changelog (the "<path>-yapchg" file),
+ * which holds the summaries of the last 64 commits. So other processes only drop the changed keys from their caches.
+ * The caches of extensions (e.g. views) are still flushed, since their changes aren't in the summary.
+ * If a summary is unavailable (the process fell too far behind, the commit was too large,
+ * or it registered an extension), then all caches are flushed.
+ * The summaries contain collection/key names in plaintext. So the shared changelog is disabled
+ * if the database is encrypted (cipherKeyBlock or cipherKeySpecBlock), and all caches are flushed after every commit.
  *
- * In the future, we might communicate changes via IPC accross processes, and it might still be possible
- * to retain most of the cache in each process.
+ * When a long-lived read transaction catches up on commits from another process,
+ * it returns a YapDatabaseModifiedNotification for each of them.
+ * These contain the changed keys (e.g. for hasChangeForKey:inCollection:inNotifications:),
+ * but no extension changes (so reload your views on `YapDatabaseModifiedExternallyNotification`).
  *
  * If you want to be notified when another process has updated the database (for instance to reload a view),
  * you can add a `CrossProcessNotifier` extension to the database and receive a
@@ -340,6 +504,450 @@ typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
 **/
 @property (nonatomic, assign, readwrite) BOOL enableMultiProcessSupport;
 
+/**
+ * The default schema stores the collection name, as a string, within every row of the database
+ * (and again within the index on (collection, key)). When there are only a handful of collections,
+ * but a large number of rows, these repeated strings can account for a significant portion of the file.
+ * 
+ * Enabling this option upgrades the database to a schema in which collection names are interned
+ * into a separate "collections" table, and rows are keyed on (collection_id, key) instead.
+ * A view named "database2" is kept around, so external tools can continue to read the database as before.
+ * 
+ * The upgrade is performed (once) when the database is opened, and may take a while for large databases.
+ * It cannot be undone: once a database file has been upgraded, it will continue to use the new schema,
+ * regardless of the value of this option.
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL enableCollectionIds;
+
+/**
+ * SQLite stores the columns of each row in order, and by default the "data" column (the serialized object)
+ * comes before the "metadata" column. When objects are large enough to spill onto overflow pages,
+ * reading only the metadata (e.g. enumerateKeysAndMetadataInCollection:) requires sqlite to walk
+ * the entire overflow chain of the object first.
+ * 
+ * Enabling this option stores the metadata before the object data.
+ * Existing databases are rebuilt (once) when the database is opened, which may take a while for large databases.
+ * Disabling the option later does not rebuild the table again, as both layouts are fully supported.
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL storeMetadataBeforeData;
+
+/**
+ * With the default pragmaSynchronous (YapDatabasePragmaSynchronous_Full), every read-write transaction
+ * syncs the WAL to disk when it commits. When many asyncReadWrite transactions are queued up
+ * (e.g. from several connections), these syncs, rather than the transactions themselves, become the bottleneck.
+ * 
+ * Enabling this option groups the commits of queued asyncReadWrite transactions.
+ * If other asyncReadWrite transactions are already waiting for the write lock when a transaction starts,
+ * it commits without syncing the WAL, and the last transaction in the group performs the sync on behalf of everyone.
+ * Since the WAL is a single file, that one sync makes every commit in the group durable.
+ * 
+ * Each transaction is still its own sqlite transaction. So a transaction that rolls back only discards its own changes,
+ * and changesets & notifications are delivered exactly as before (per transaction, per connection).
+ * The only difference is timing: the completionBlock of a grouped transaction is invoked once the group has been synced,
+ * so when a completionBlock fires, the transaction's changes are guaranteed to be on disk.
+ * (Other connections may see the changes slightly earlier, as soon as they're committed.)
+ * 
+ * Synchronous read-write transactions are never grouped, and always sync before returning.
+ * This option has no effect unless pragmaSynchronous is YapDatabasePragmaSynchronous_Full.
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL enableGroupCommit;
+
+/**
+ * Read-write transactions executed with YapDatabaseDurabilityRelaxed commit without syncing the WAL.
+ * These options bound how much relaxed work may be lost in the event of a power failure,
+ * by forcing a sync once either limit is reached.
+ * 
+ * relaxedDurabilityTransactionLimit:
+ *   The maximum number of relaxed transactions (that modified the database) which may be pending a sync.
+ *   Zero means there's no limit.
+ *   The default value is 100.
+ * 
+ * relaxedDurabilityInterval:
+ *   The maximum amount of time (in seconds) after a relaxed transaction commits, before a sync is forced.
+ *   Zero means there's no limit.
+ *   The default value is 1.0.
+ * 
+ * Of course, the WAL is also synced whenever a YapDatabaseDurabilityFull transaction commits,
+ * or when -[YapDatabaseConnection flushDurabilityWithCompletionQueue:completionBlock:] is invoked.
+ * 
+ * These options have no effect unless pragmaSynchronous is YapDatabasePragmaSynchronous_Full.
+ * (With any other value, every transaction is already relaxed.)
+**/
+@property (nonatomic, assign, readwrite) NSUInteger relaxedDurabilityTransactionLimit;
+@property (nonatomic, assign, readwrite) NSTimeInterval relaxedDurabilityInterval;
+
+/**
+ * Every connection has its own objectCache. So if several connections (e.g. one per thread) read the same hot objects,
+ * each connection deserializes its own copy of every object, and keeps it in its own cache.
+ * 
+ * Enabling this option adds a database-wide (shared) object cache, which sits behind the objectCache of each connection.
+ * When a connection misses its own cache, it checks the shared cache before going to disk.
+ * And objects read from disk are added to the shared cache, so other connections can use the same instance.
+ * 
+ * The shared cache respects snapshots. A connection only sees objects that are valid for its current snapshot,
+ * even if other connections have since committed changes. Commits publish the new objects to the shared cache,
+ * and old versions are discarded once every connection has moved past them.
+ * 
+ * Since the same instance is handed out to multiple connections (on multiple threads),
+ * only connections with an objectPolicy of YapDatabasePolicyShare participate.
+ * (That is, your objects must be immutable, or treated as such.)
+ * Also, the shared cache is only used by read-only transactions.
+ * 
+ * The shared cache isn't available when enableMultiProcessSupport is enabled.
+ * 
+ * sharedObjectCacheLimit:
+ *   The maximum number of objects in the shared cache. Zero means there's no limit.
+ *   The default value is 1000.
+ * 
+ * The default value (of enableSharedObjectCache) is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL enableSharedObjectCache;
+@property (nonatomic, assign, readwrite) NSUInteger sharedObjectCacheLimit;
+
+/**
+ * When enabled, every read, write, sync & truncate that sqlite performs is counted & timed,
+ * and the results are available via -[YapDatabase ioStatistics].
+ * 
+ * This includes the I/O performed by every connection, as well as the checkpoints performed by the database.
+ * The overhead is small (a couple of atomic increments & a timestamp per operation),
+ * so it's reasonable to enable this in production builds.
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL enableIOStatistics;
+
+/**
+ * When enabled, the pages that are modified are tracked (via the WAL writes of every connection),
+ * which allows -[YapDatabaseConnection incrementalBackupToPath:] to write only the pages that
+ * have changed since the previous incremental backup.
+ * 
+ * The overhead is a bit per page (of memory), and a bit of bookkeeping per WAL frame written.
+ * 
+ * The backed up pages are read through sqlite (decrypted), so they would be written to the backup unencrypted.
+ * Thus this option is ignored if the database is encrypted (i.e. cipherKeyBlock or cipherKeySpecBlock is set),
+ * and -[YapDatabaseConnection incrementalBackupToPath:] returns an error.
+ * (-[YapDatabaseConnection cloneBackupToPath:] clones the database file itself, which remains encrypted.)
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL enableIncrementalBackup;
+
+/**
+ * Opens the database file as read-only, and immutable (via sqlite's "immutable=1" URI parameter).
+ * This is designed for bundled/prebuilt databases (e.g. a dictionary or an asset catalog shipped with the app),
+ * which are never modified while they're open.
+ * 
+ * Since sqlite can assume the file never changes, it doesn't take any locks, or look for a WAL file.
+ * And since YapDatabase can assume the same, it skips the bookkeeping of snapshots & checkpoints.
+ * Thus read transactions don't synchronize with each other at all,
+ * and there's no limit on the number of connections reading concurrently.
+ * 
+ * In exchange:
+ * - the file must already exist (it's never created, upgraded or repaired, and corruptAction is ignored)
+ * - read-write transactions are not allowed (attempting one throws an exception)
+ * - extensions cannot be registered (as registration writes to the database)
+ * - settings that only apply to writes are ignored (e.g. pragmaSynchronous, pragmaAutoVacuum, checkpointPolicy)
+ * 
+ * The file must be a complete database.
+ * That is, it must not have a (non-empty) WAL file, since it would be ignored.
+ * When preparing such a file, a checkpoint (e.g. via -[YapDatabaseConnection vacuum])
+ * or simply closing the database (with all of its connections) takes care of this.
+ * 
+ * Modifying the file while it's open (via any process) results in undefined behavior.
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL readOnlyImmutable;
+
+/**
+ * Stores the database in memory (in the heap), rather than in a file.
+ * This is designed for ephemeral data (e.g. session caches), and for unit tests.
+ * 
+ * The storage is shared by every connection of the database, and it supports WAL mode.
+ * So connections, snapshots, checkpoints & extensions (views, secondary indexes, etc) all work exactly
+ * as they do with a database file. There's just no file I/O (nor fsync).
+ * 
+ * The path given to YapDatabase's init method is only used as the name of the database.
+ * Nothing is written to (or read from) that location.
+ * As usual, only a single database instance is allowed per path.
+ * So use a unique path (e.g. containing a UUID) for each concurrent in-memory database.
+ * 
+ * Everything is freed when the database instance is deallocated.
+ * (The database can be copied to a file via -[YapDatabaseConnection backupToPath:] beforehand.)
+ * 
+ * The following options don't apply to an in-memory database, and are ignored:
+ * - enableMultiProcessSupport (only this process can access the memory)
+ * - readOnlyImmutable
+ * - externalStorageThresholds (which would write files)
+ * - coldCollections (likewise)
+ * - corruptAction
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL inMemory;
+
+/**
+ * Enables transparent compression of the serialized objects, on a per-collection basis.
+ * The dictionary is keyed by collection name.
+ * 
+ * Compression sits between your serializer and the database. Objects are compressed after they're serialized,
+ * and decompressed (directly from the sqlite column buffer) before they're deserialized.
+ * Metadata is never compressed.
+ * 
+ * Each compressed row is prefixed with a small header describing how it was compressed.
+ * Rows without the header (e.g. rows written before compression was enabled) are read as-is,
+ * so compression can be enabled for an existing database at any time.
+ * (The whole header is validated against the row, not just its leading magic bytes.
+ *  So an existing row that happens to start with the same bytes is also read as-is.)
+ * Similarly, rows that were compressed remain readable if the config is later changed or removed,
+ * as long as you don't switch to an older version of YapDatabase.
+ * 
+ * Dictionaries (both those provided via the config, and those trained by the database) are stored in the database file.
+ * See -[YapDatabaseConnection asyncTrainCompressionDictionaryForCollection:completionQueue:completionBlock:].
+ * 
+ * The default value is nil (no compression).
+**/
+@property (nonatomic, copy, readwrite, nullable)
+  NSDictionary<NSString *, YapDatabaseCompressionConfig *> *compressionConfigs;
+
+/**
+ * Moves large serialized objects out of the database file, and into external files, on a per-collection basis.
+ * The dictionary is keyed by collection name, and the value is the minimum length (in bytes) of a serialized object
+ * that is stored externally. Smaller objects are stored in the database as usual.
+ * 
+ * This is designed for large values (e.g. attachments or previews of several hundred KB).
+ * Such values bloat the database file, thrash the sqlite page cache, inflate the WAL, and slow down vacuum.
+ * 
+ * The files are stored in a directory next to the database file (see -[YapDatabase databasePath_blobs]),
+ * and are content-addressed (named after the SHA-256 of the serialized object).
+ * So identical objects share a single file. The row only stores a small reference to the file.
+ * 
+ * When read, the file is memory mapped, and the (mapped) NSData is handed directly to the deserializer.
+ * So a deserializer may hold onto the data (or a subrange of it) without copying it.
+ * 
+ * Files are written (and synced to disk) before the transaction is committed,
+ * and are deleted if the transaction is rolled back.
+ * Files that are no longer referenced by any row are deleted after the commit,
+ * once every connection has moved past the commit.
+ * (With enableMultiProcessSupport, unreferenced files are left in place,
+ *  as another process may be in the middle of storing an identical object.)
+ * 
+ * Externally stored objects are never compressed. Metadata is never stored externally.
+ * Rows that were stored externally remain readable if the thresholds are later changed or removed.
+ * 
+ * The external files are NOT encrypted.
+ * So this option is ignored if the database is encrypted (i.e. cipherKeyBlock or cipherKeySpecBlock is set),
+ * and every object is stored within the (encrypted) database file.
+ * 
+ * The default value is nil (everything is stored in the database).
+**/
+@property (nonatomic, copy, readwrite, nullable)
+  NSDictionary<NSString *, NSNumber *> *externalStorageThresholds;
+
+/**
+ * The collections whose objects may be given an expiration date.
+ * See -[YapDatabaseReadWriteTransaction setExpiration:forKey:inCollection:].
+ * 
+ * This is designed for collections that are used as caches.
+ * Each expiration is stored in an indexed table, separate from the objects.
+ * So finding the expired objects is proportional to the number of expired objects,
+ * rather than the size of the collection.
+ * 
+ * Within these collections, an expired object is treated as missing by
+ * objectForKey:, metadataForKey:, hasObjectForKey:, getObject:metadata:forKey: & getObjects:metadata:forKeys:,
+ * even before it's been removed. (Enumerations & counts include it until it's removed.)
+ * 
+ * Expired objects are removed by the sweeper (see expirationSweepInterval),
+ * or via -[YapDatabaseReadWriteTransaction removeExpiredObjectsWithLimit:].
+ * Removal is a regular remove, so extensions & changesets are updated as usual.
+ * 
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable) NSSet<NSString *> *expiringCollections;
+
+/**
+ * How often (in seconds) the database removes expired objects in the background.
+ * Set to zero to disable the sweeper (in which case you can remove them manually).
+ * 
+ * Each sweep removes the expired objects (oldest expiration first) in batches of expirationSweepBatchSize,
+ * using a separate read-write transaction for each batch.
+ * So the sweeper never holds up other writers for long.
+ * 
+ * The default value is 60 seconds.
+**/
+@property (nonatomic, assign, readwrite) NSTimeInterval expirationSweepInterval;
+
+/**
+ * The maximum number of expired objects the sweeper removes per read-write transaction.
+ * 
+ * The default value is 500.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger expirationSweepBatchSize;
+
+/**
+ * The collections whose objects are moved into a separate "cold" database file once they're old enough.
+ * 
+ * This is designed for archival collections, which hold most of the rows, yet are rarely read.
+ * Moving their objects out of the main file keeps its btree (and thus its page cache, WAL & checkpoints) small.
+ * 
+ * Only the object moves. The row itself stays in the main file, with its key & metadata,
+ * and the object is replaced by a small reference into the cold file.
+ * So rowids, extensions, enumerations & counts are unaffected, and reading a cold object is transparent.
+ * Overwriting a cold object stores the new object in the main file again (and the old one is deleted).
+ * 
+ * The cold file (databasePath_cold) is opened on first access, and closed again after coldStorageIdleInterval.
+ * 
+ * Objects are moved once they haven't been written for coldStorageAge (see coldStorageMigrationInterval),
+ * or via -[YapDatabaseReadWriteTransaction moveObjectsToColdStorageWithLimit:].
+ * Rows that already exist when a collection is first configured are considered written at that time.
+ * 
+ * Externally stored objects (see externalStorageThresholds) are already outside the main file,
+ * and thus aren't moved.
+ * 
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable) NSSet<NSString *> *coldCollections;
+
+/**
+ * How long (in seconds) an object in a cold collection has to go without being written, before it's moved.
+ * 
+ * The default value is 30 days.
+**/
+@property (nonatomic, assign, readwrite) NSTimeInterval coldStorageAge;
+
+/**
+ * How often (in seconds) the database moves old objects into the cold file in the background.
+ * Set to zero to disable the background migration (in which case you can move them manually).
+ * 
+ * Each migration moves the objects (least recently written first) in batches of coldStorageMigrationBatchSize,
+ * using a separate read-write transaction for each batch.
+ * 
+ * The default value is 600 seconds (10 minutes).
+**/
+@property (nonatomic, assign, readwrite) NSTimeInterval coldStorageMigrationInterval;
+
+/**
+ * The maximum number of objects the migration moves per read-write transaction.
+ * 
+ * The default value is 500.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger coldStorageMigrationBatchSize;
+
+/**
+ * How long (in seconds) the cold file stays open after it was last accessed.
+ * 
+ * The default value is 30 seconds.
+**/
+@property (nonatomic, assign, readwrite) NSTimeInterval coldStorageIdleInterval;
+
+/**
+ * The collections in which a write that wouldn't change anything is skipped.
+ * 
+ * This is designed for collections that are frequently re-saved with identical content (e.g. by a sync layer).
+ * Normally every setObject:forKey:inCollection: (and its variants) writes the row,
+ * which dirties pages & appends WAL frames, and is reported to every extension & in the changeset,
+ * even if the stored bytes are exactly the same as before.
+ * 
+ * Within these collections, a 64-bit hash of the serialized object & metadata is stored alongside each row
+ * (in a separate table). When the object & metadata are set again, and hash to the same value,
+ * then the write is dropped before it reaches sqlite, the extensions, or the changeset.
+ * 
+ * The comparison happens after the object is serialized (and compressed, if configured).
+ * So it only works for serializers that produce identical bytes for identical objects.
+ * Rows with native metadata (see nativeMetadataTypes) are always written.
+ * Writes that only touch the object or the metadata (replaceObject:, replaceMetadata:, touch..., etc)
+ * are always performed, and simply forget the stored hash.
+ * 
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable) NSSet<NSString *> *contentHashedCollections;
+
+/**
+ * The number of sqlite3 instances to open (in the background) as soon as the database has been setup.
+ * 
+ * Normally every new connection opens and configures its own sqlite3 instance
+ * (open, pragmas, encryption, reading the schema), unless it can recycle one from the connection pool.
+ * So the first few connections (typically created during app launch) each pay this cost serially.
+ * 
+ * When set, the given number of instances are opened & configured in parallel on background queues,
+ * and placed into the connection pool. Each instance also reads the database schema,
+ * so the first statements prepared by the connection don't have to.
+ * New connections then simply dequeue a ready instance.
+ * 
+ * The count is limited by -[YapDatabase maxConnectionPoolCount].
+ * Prewarmed instances are subject to the connectionPoolLifetime, like any other pooled instance.
+ * 
+ * The default value is 0 (disabled).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger connectionPrewarmCount;
+
+/**
+ * Opening an existing database normally involves a bit of introspection:
+ * creating the tables if needed, checking the version & format of the tables (for upgrades),
+ * and scanning the 'yap2' table for the names of previously registered extensions.
+ * 
+ * When enabled, the result is stored (as a small fingerprint) in the database.
+ * On the next open, if the fingerprint still matches (same schema, user_version, relevant options
+ * and version of YapDatabase), all of the above is skipped.
+ * 
+ * The fingerprint is kept in sync via triggers on the 'yap2' table,
+ * so it's invalidated whenever an extension is added or removed (by any process).
+ * 
+ * This option is ignored for readOnlyImmutable databases.
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL enableFastOpen;
+
+/**
+ * Maps collections to a native metadata type (YapDatabaseNativeMetadataType).
+ * 
+ * Normally metadata goes through the metadataSerializer, and is stored as a blob.
+ * Within these collections, metadata of the matching class (NSNumber, NSString or NSDate)
+ * is instead stored as a native sqlite value (INTEGER, REAL or TEXT).
+ * So reading it doesn't require deserialization, and it can be queried with SQL directly.
+ * See -[YapDatabaseReadTransaction enumerateKeysInCollection:matchingMetadataQuery:usingBlock:].
+ * 
+ * Metadata of any other class is serialized as usual.
+ * Rows written before a collection was configured keep their serialized metadata until they're updated.
+ * 
+ * When configured, an index is created on the native metadata (per collection),
+ * and is maintained for every collection. (Serialized metadata isn't part of the index.)
+ * 
+ * Note that the primitive accessors (e.g. serializedMetadataForKey:inCollection:) return native metadata
+ * run through the metadataSerializer, so they continue to return the serialized form.
+ * 
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable)
+  NSDictionary<NSString *, NSNumber *> *nativeMetadataTypes;
+
+/**
+ * Extracts a header (e.g. the version or type of the serialized object) from the first bytes of a serialized object.
+ * Used by -[YapDatabaseReadTransaction enumerateKeysAndHeadersInCollection:usingBlock:].
+ * 
+ * The bytes are the first objectHeaderLength bytes of the serialized object (or fewer, if the object is shorter).
+ * They are ONLY valid for the duration of the call.
+ * 
+ * If nil, the header is an NSData with the bytes.
+ * 
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable) YapDatabaseHeaderExtractor objectHeaderExtractor;
+
+/**
+ * The number of bytes (from the start of each serialized object) passed to the objectHeaderExtractor.
+ * 
+ * The default value is 16.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger objectHeaderLength;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -19,6 +19,13 @@
 @synthesize pragmaJournalSizeLimit = pragmaJournalSizeLimit;
 @synthesize pragmaPageSize = pragmaPageSize;
 @synthesize pragmaMMapSize = pragmaMMapSize;
+@synthesize pragmaMMapSizeMaximum = pragmaMMapSizeMaximum;
+@synthesize pageCacheBudget = pageCacheBudget;
+@synthesize pragmaAutoVacuum = pragmaAutoVacuum;
+@synthesize incrementalVacuumPageBudget = incrementalVacuumPageBudget;
+@synthesize incrementalVacuumIdleInterval = incrementalVacuumIdleInterval;
+@synthesize analyzeChangeThreshold = analyzeChangeThreshold;
+@synthesize analysisLimit = analysisLimit;
 #ifdef SQLITE_HAS_CODEC
 @synthesize cipherKeyBlock = cipherKeyBlock;
 @synthesize kdfIterNumber = kdfIterNumber;
@@ -31,6 +38,34 @@
 #endif
 @synthesize aggressiveWALTruncationSize = aggressiveWALTruncationSize;
 @synthesize enableMultiProcessSupport = enableMultiProcessSupport;
+@synthesize enableCollectionIds = enableCollectionIds;
+@synthesize storeMetadataBeforeData = storeMetadataBeforeData;
+@synthesize enableGroupCommit = enableGroupCommit;
+@synthesize relaxedDurabilityTransactionLimit = relaxedDurabilityTransactionLimit;
+@synthesize relaxedDurabilityInterval = relaxedDurabilityInterval;
+@synthesize enableSharedObjectCache = enableSharedObjectCache;
+@synthesize sharedObjectCacheLimit = sharedObjectCacheLimit;
+@synthesize enableIOStatistics = enableIOStatistics;
+@synthesize enableIncrementalBackup = enableIncrementalBackup;
+@synthesize readOnlyImmutable = readOnlyImmutable;
+@synthesize inMemory = inMemory;
+@synthesize compressionConfigs = compressionConfigs;
+@synthesize externalStorageThresholds = externalStorageThresholds;
+@synthesize expiringCollections = expiringCollections;
+@synthesize expirationSweepInterval = expirationSweepInterval;
+@synthesize expirationSweepBatchSize = expirationSweepBatchSize;
+@synthesize coldCollections = coldCollections;
+@synthesize coldStorageAge = coldStorageAge;
+@synthesize coldStorageMigrationInterval = coldStorageMigrationInterval;
+@synthesize coldStorageMigrationBatchSize = coldStorageMigrationBatchSize;
+@synthesize coldStorageIdleInterval = coldStorageIdleInterval;
+@synthesize contentHashedCollections = contentHashedCollections;
+@synthesize connectionPrewarmCount = connectionPrewarmCount;
+@synthesize enableFastOpen = enableFastOpen;
+@synthesize nativeMetadataTypes = nativeMetadataTypes;
+@synthesize objectHeaderExtractor = objectHeaderExtractor;
+@synthesize objectHeaderLength = objectHeaderLength;
+@synthesize checkpointPolicy = checkpointPolicy;
 
 - (id)init
 {
@@ -41,8 +76,35 @@
 		pragmaJournalSizeLimit = 0;
 		pragmaPageSize = 0;
 		pragmaMMapSize = 0;
+		pragmaMMapSizeMaximum = 0;
+		pageCacheBudget = 0;
+		pragmaAutoVacuum = YapDatabasePragmaAutoVacuum_Full;
+		incrementalVacuumPageBudget = 256;
+		incrementalVacuumIdleInterval = 2.0;
+		analyzeChangeThreshold = 10000;
+		analysisLimit = 400;
 		aggressiveWALTruncationSize = (1024 * 1024 * 4); // 4 MB
         enableMultiProcessSupport = NO;
+		enableCollectionIds = NO;
+		storeMetadataBeforeData = NO;
+		enableGroupCommit = NO;
+		relaxedDurabilityTransactionLimit = 100;
+		relaxedDurabilityInterval = 1.0;
+		enableSharedObjectCache = NO;
+		sharedObjectCacheLimit = 1000;
+		enableIOStatistics = NO;
+		enableIncrementalBackup = NO;
+		readOnlyImmutable = NO;
+		inMemory = NO;
+		expirationSweepInterval = 60.0;
+		expirationSweepBatchSize = 500;
+		coldStorageAge = (60 * 60 * 24 * 30);
+		coldStorageMigrationInterval = 600.0;
+		coldStorageMigrationBatchSize = 500;
+		coldStorageIdleInterval = 30.0;
+		connectionPrewarmCount = 0;
+		enableFastOpen = NO;
+		objectHeaderLength = 16;
 	}
 	return self;
 }
@@ -55,6 +117,13 @@
 	copy->pragmaJournalSizeLimit = pragmaJournalSizeLimit;
 	copy->pragmaPageSize = pragmaPageSize;
 	copy->pragmaMMapSize = pragmaMMapSize;
+	copy->pragmaMMapSizeMaximum = pragmaMMapSizeMaximum;
+	copy->pageCacheBudget = pageCacheBudget;
+	copy->pragmaAutoVacuum = pragmaAutoVacuum;
+	copy->incrementalVacuumPageBudget = incrementalVacuumPageBudget;
+	copy->incrementalVacuumIdleInterval = incrementalVacuumIdleInterval;
+	copy->analyzeChangeThreshold = analyzeChangeThreshold;
+	copy->analysisLimit = analysisLimit;
 #ifdef SQLITE_HAS_CODEC
     copy->cipherKeyBlock = cipherKeyBlock;
     copy->kdfIterNumber = kdfIterNumber;
@@ -66,6 +135,36 @@
 #endif
 	copy->aggressiveWALTruncationSize = aggressiveWALTruncationSize;
     copy->enableMultiProcessSupport = enableMultiProcessSupport;
+	copy->enableCollectionIds = enableCollectionIds;
+	copy->storeMetadataBeforeData = storeMetadataBeforeData;
+	copy->enableGroupCommit = enableGroupCommit;
+	copy->relaxedDurabilityTransactionLimit = relaxedDurabilityTransactionLimit;
+	copy->relaxedDurabilityInterval = relaxedDurabilityInterval;
+	copy->checkpointPolicy = checkpointPolicy;
+	copy->enableSharedObjectCache = enableSharedObjectCache;
+	copy->sharedObjectCacheLimit = sharedObjectCacheLimit;
+	copy->enableIOStatistics = enableIOStatistics;
+	copy->enableIncrementalBackup = enableIncrementalBackup;
+	copy->readOnlyImmutable = readOnlyImmutable;
+	copy->inMemory = inMemory;
+	copy->compressionConfigs = compressionConfigs
+	  ? [[NSDictionary alloc] initWithDictionary:compressionConfigs copyItems:YES]
+	  : nil;
+	copy->externalStorageThresholds = [externalStorageThresholds copy];
+	copy->expiringCollections = [expiringCollections copy];
+	copy->expirationSweepInterval = expirationSweepInterval;
+	copy->expirationSweepBatchSize = expirationSweepBatchSize;
+	copy->coldCollections = [coldCollections copy];
+	copy->coldStorageAge = coldStorageAge;
+	copy->coldStorageMigrationInterval = coldStorageMigrationInterval;
+	copy->coldStorageMigrationBatchSize = coldStorageMigrationBatchSize;
+	copy->coldStorageIdleInterval = coldStorageIdleInterval;
+	copy->contentHashedCollections = [contentHashedCollections copy];
+	copy->connectionPrewarmCount = connectionPrewarmCount;
+	copy->enableFastOpen = enableFastOpen;
+	copy->nativeMetadataTypes = [nativeMetadataTypes copy];
+	copy->objectHeaderExtractor = objectHeaderExtractor;
+	copy->objectHeaderLength = objectHeaderLength;
 	
 	return copy;
 }
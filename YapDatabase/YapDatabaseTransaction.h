@@ -1,10 +1,45 @@
 #import <Foundation/Foundation.h>
 
+#import "YapCollectionKey.h"
+#import "YapDatabaseBlobStream.h"
+#import "YapDatabaseCursor.h"
+#import "YapProxyObject.h"
+
 @class YapDatabaseConnection;
 @class YapDatabaseExtensionTransaction;
+@class YapDatabaseQuery;
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * Options for the enumeration methods that accept them.
+ *
+ * YapDatabaseEnumerationConcurrentDeserialization:
+ *   The sqlite statement continues to be stepped on the calling thread,
+ *   while a bounded number of rows are deserialized concurrently on background threads.
+ *   Your block is still invoked on the calling thread (serially), in the same order as a regular enumeration.
+ *   The number of rows that may be in-flight is configured via YapDatabaseConnection.enumerationWindowSize.
+ *   
+ *   IMPORTANT: Your deserializer(s) must be thread-safe to use this option.
+ *   (The default NSCoding based deserializer is.)
+ *   
+ *   Note: Blobs must be copied out of sqlite before being handed to a background thread.
+ *   So this option is only a win when deserialization is expensive (relative to a memcpy).
+ *
+ * YapDatabaseEnumerationUnordered:
+ *   Only applies when combined with YapDatabaseEnumerationConcurrentDeserialization.
+ *   Allows the block to be invoked as soon as each row has been deserialized, rather than in order.
+ *
+ * YapDatabaseEnumerationReverse:
+ *   Only applies to the key range enumerations (fromKey:toKey:).
+ *   Enumerates the range in descending key order.
+**/
+typedef NS_OPTIONS(NSUInteger, YapDatabaseEnumerationOptions) {
+	YapDatabaseEnumerationConcurrentDeserialization = 1 << 0,
+	YapDatabaseEnumerationUnordered                 = 1 << 1,
+	YapDatabaseEnumerationReverse                   = 1 << 2,
+};
+
 /**
  * Welcome to YapDatabase!
  *
@@ -45,6 +80,28 @@ NS_ASSUME_NONNULL_BEGIN
  *   (Read-write transactions go through a per-database serial queue.)
 **/
 
+/**
+ * Controls whether objects & metadata read from disk are added to the connection's caches.
+ * See YapDatabaseReadTransaction.cachePolicy.
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseTransactionCachePolicy) {
+	
+	/**
+	 * Objects & metadata read from disk are added to the objectCache & metadataCache (if enabled).
+	 * This is the default.
+	**/
+	YapDatabaseTransactionCachePolicyDefault = 0,
+	
+	/**
+	 * Objects & metadata read from disk are NOT added to the objectCache & metadataCache.
+	 * Items that are already in the caches are still used (and are still kept up-to-date by writes).
+	 *
+	 * This is designed for rows that are only touched once,
+	 * such as the scans performed by exports, migrations & reindexing.
+	**/
+	YapDatabaseTransactionCachePolicyBypass = 1,
+};
+
 /**
  * A YapDatabaseReadTransaction encompasses a single read-only database transaction.
  * You can execute multiple operations within a single transaction.
@@ -74,6 +131,22 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, strong, readwrite, nullable) id userInfo;
 
+/**
+ * Allows you to prevent the transaction from populating the connection's objectCache & metadataCache.
+ *
+ * For example, enumerating every row in the database (e.g. for an export) would normally
+ * push the recently used objects out of the cache, in favor of objects that won't be needed again.
+ * Setting the cachePolicy to YapDatabaseTransactionCachePolicyBypass avoids this,
+ * without the need for a separate connection (with its caches disabled).
+ *
+ * The policy may be changed at any point during the transaction.
+ * So to bypass the cache for a single call, simply set the policy before the call, and restore it afterwards.
+ *
+ * Keep in mind that the policy only applies to this transaction.
+ * Each transaction starts with YapDatabaseTransactionCachePolicyDefault.
+**/
+@property (nonatomic, assign, readwrite) YapDatabaseTransactionCachePolicy cachePolicy;
+
 #pragma mark Count
 
 /**
@@ -134,12 +207,62 @@ NS_ASSUME_NONNULL_BEGIN
            forKey:(NSString *)key
      inCollection:(nullable NSString *)collection;
 
+/**
+ * Provides access to the objects and/or metadata for many keys in a single call.
+ *
+ * This method is much faster than fetching each key individually.
+ * Items already in the cache are used directly,
+ * and all remaining keys are fetched from the database using as few queries as possible.
+ *
+ * @param objectsPtr
+ *   If non-null, set to a dictionary of (key -> object) for every key that exists in the database.
+ *
+ * @param metadataPtr
+ *   If non-null, set to a dictionary of (key -> metadata) for every key that exists in the database,
+ *   and has non-nil metadata.
+**/
+- (void)getObjects:(NSDictionary<NSString *, id> * __nullable * __nullable)objectsPtr
+          metadata:(NSDictionary<NSString *, id> * __nullable * __nullable)metadataPtr
+           forKeys:(NSArray<NSString *> *)keys
+      inCollection:(nullable NSString *)collection;
+
+/**
+ * Provides access to the objects for many collection/key pairs (from any number of collections) in a single call.
+ *
+ * Items already in the cache are used directly.
+ * The remaining keys are grouped by collection, and each group is fetched using as few queries as possible
+ * (as with getObjects:metadata:forKeys:inCollection:).
+ *
+ * @return
+ *   An array with the same count (and order) as the given collectionKeys.
+ *   For a collection/key pair that doesn't exist in the database, the array contains [NSNull null].
+**/
+- (NSArray<id> *)objectsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys;
+
 /**
  * Provides access to the metadata.
  * This fetches directly from the metadata dictionary stored in memory, and thus never hits the disk.
 **/
 - (nullable id)metadataForKey:(NSString *)key inCollection:(nullable NSString *)collection;
 
+/**
+ * Returns the value of a single field of the object, without deserializing the entire object.
+ *
+ * This is designed for extension blocks that only need one or two properties of an object.
+ * For example, a view sorting block (that sorts by date) can use a 'WithKey' block type,
+ * and fetch only the date of each row. Thus (re)populating the view doesn't deserialize every object.
+ *
+ * The field is read straight from the stored bytes if the object was serialized by the YapDatabaseBinaryCodec.
+ * In which case the object must either adopt YapDatabaseBinaryCoding (and the field is one of its encoded keys),
+ * or be a dictionary (and the field is a key).
+ *
+ * If the object is already in the cache (and is a dictionary), or was serialized by some other serializer,
+ * the field is read from the (deserialized) dictionary. For other objects this returns nil.
+ *
+ * @see YapDatabaseBinaryCodec
+**/
+- (nullable id)valueForField:(NSString *)field forKey:(NSString *)key inCollection:(nullable NSString *)collection;
+
 #pragma mark Primitive
 
 /**
@@ -178,6 +301,66 @@ NS_ASSUME_NONNULL_BEGIN
                      forKey:(NSString *)key
                inCollection:(nullable NSString *)collection;
 
+/**
+ * Primitive access.
+ * Opens a stream for incrementally reading the raw serializedObject from the database (via sqlite3_blob_read).
+ * 
+ * Unlike serializedObjectForKey:inCollection:, the full value is never materialized in memory.
+ * This allows you to hash, upload or decode a large value progressively.
+ * 
+ * Externally stored objects (see YapDatabaseOptions.externalStorageThresholds) are streamed from the mapped file.
+ * Compressed objects cannot be decompressed incrementally, and are thus decompressed into memory upfront.
+ * 
+ * The stream may only be used within this transaction, and is closed automatically when the transaction completes.
+ * 
+ * @return
+ *   The stream, or nil if the row doesn't exist.
+ * 
+ * @see YapDatabaseBlobReadStream
+**/
+- (nullable YapDatabaseBlobReadStream *)openReadStreamForKey:(NSString *)key
+                                                inCollection:(nullable NSString *)collection;
+
+#pragma mark Export
+
+/**
+ * Writes every row of the given collection to a collection archive (see YapDatabaseCollectionArchive).
+ *
+ * The serialized objects & metadata are copied straight from the database (without being deserialized),
+ * and written in chunks. So the archive is streamed, regardless of the size of the collection.
+ * Rows that are compressed or stored externally (see YapDatabaseOptions) are exported in their serialized form.
+ *
+ * The archive is written to a temporary file, and (atomically) moved to the given path once complete.
+ *
+ * @param collection
+ *   The collection to export.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+ *
+ * @param path
+ *   Where to write the archive. If a file already exists at this path, it is replaced.
+ *
+ * @param compressed
+ *   Whether to compress the chunks of the archive (with zlib).
+ *
+ * @return
+ *   nil if the archive was written. Otherwise an error describing the problem.
+**/
+- (nullable NSError *)exportCollection:(nullable NSString *)collection
+                                toPath:(NSString *)path
+                            compressed:(BOOL)compressed;
+
+/**
+ * Writes every row of the given collection to the given stream (e.g. a socket, or a bound pair of streams).
+ *
+ * If the stream isn't open yet, it's opened, and closed once the archive has been written.
+ * Streams that are already open are left open.
+ *
+ * @see exportCollection:toPath:compressed:
+**/
+- (nullable NSError *)exportCollection:(nullable NSString *)collection
+                              toStream:(NSOutputStream *)stream
+                            compressed:(BOOL)compressed;
+
 #pragma mark Enumerate
 
 /**
@@ -207,6 +390,60 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)enumerateKeysInCollection:(nullable NSString *)collection
                        usingBlock:(void (^)(NSString *key, BOOL *stop))block;
 
+/**
+ * Enumerates the keys in the given collection that begin with the given prefix, in ascending key order.
+ *
+ * Unlike a filter, this doesn't visit every key in the collection.
+ * It's executed as a range scan of the (collection, key) index.
+ * 
+ * Keys are compared bytewise (as UTF-8), which is the same ordering sqlite uses.
+**/
+- (void)enumerateKeysInCollection:(nullable NSString *)collection
+                       withPrefix:(NSString *)prefix
+                       usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
+/**
+ * Enumerates the keys in the given collection whose native metadata matches the given query.
+ * See YapDatabaseOptions.nativeMetadataTypes.
+ * 
+ * The query is executed by sqlite, against the native metadata column (named "metadata").
+ * For example:
+ * 
+ * [YapDatabaseQuery queryWithFormat:@"WHERE metadata >= ? ORDER BY metadata DESC LIMIT 10", minDate]
+ * 
+ * NSDate parameters are bound the same way native NSDate metadata is stored.
+ * Rows with serialized metadata (or no metadata) never match.
+ * 
+ * The query uses the native metadata index, so it doesn't need to visit every row in the collection.
+ * Aggregate queries aren't supported.
+**/
+- (void)enumerateKeysInCollection:(nullable NSString *)collection
+            matchingMetadataQuery:(YapDatabaseQuery *)query
+                       usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
+/**
+ * Enumerates the keys in the given collection, along with the header of each serialized object.
+ * The header is produced by YapDatabaseOptions.objectHeaderExtractor (or is the raw bytes, if not configured).
+ * 
+ * Only the first YapDatabaseOptions.objectHeaderLength bytes of each object are read from the database,
+ * and nothing is deserialized. So this is well suited for finding the rows that need to be migrated.
+ * (Compressed or externally stored objects have to be loaded in full to get to their header.)
+**/
+- (void)enumerateKeysAndHeadersInCollection:(nullable NSString *)collection
+                                 usingBlock:(void (^)(NSString *key, id _Nullable header, BOOL *stop))block;
+
+/**
+ * Enumerates the keys in the given collection within the range [fromKey, toKey).
+ * 
+ * @see enumerateKeysAndObjectsInCollection:fromKey:toKey:withOptions:limit:usingBlock:
+**/
+- (void)enumerateKeysInCollection:(nullable NSString *)collection
+                          fromKey:(nullable NSString *)fromKey
+                            toKey:(nullable NSString *)toKey
+                      withOptions:(YapDatabaseEnumerationOptions)options
+                            limit:(NSUInteger)limit
+                       usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
 /**
  * Fast enumeration over all keys in the given collection.
  *
@@ -240,6 +477,93 @@ NS_ASSUME_NONNULL_BEGIN
                                  usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
                                  withFilter:(nullable BOOL (^)(NSString *key))filter;
 
+/**
+ * Same as above, but allows you to opt in to concurrent deserialization.
+ * This can significantly speed up the enumeration of large collections with expensive deserialization.
+ * 
+ * @see YapDatabaseEnumerationOptions
+**/
+- (void)enumerateKeysAndObjectsInCollection:(nullable NSString *)collection
+                                withOptions:(YapDatabaseEnumerationOptions)options
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
+                                 withFilter:(nullable BOOL (^)(NSString *key))filter;
+
+/**
+ * Enumerates the objects in the given collection whose keys begin with the given prefix, in ascending key order.
+ * 
+ * Only the matching rows are read (and deserialized),
+ * as the query is executed as a range scan of the (collection, key) index.
+**/
+- (void)enumerateKeysAndObjectsInCollection:(nullable NSString *)collection
+                                 withPrefix:(NSString *)prefix
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block;
+
+/**
+ * Enumerates the objects in the given collection whose keys are within the range [fromKey, toKey).
+ * 
+ * @param fromKey
+ *   The first key of the range (inclusive). Pass nil to start at the first key in the collection.
+ * 
+ * @param toKey
+ *   The end of the range (exclusive). Pass nil to continue through the last key in the collection.
+ * 
+ * @param options
+ *   Pass YapDatabaseEnumerationReverse to enumerate in descending key order.
+ *   (The other options don't apply to range enumerations.)
+ * 
+ * @param limit
+ *   The maximum number of rows to enumerate, or zero for no limit.
+ *   The limit is applied by sqlite, so it's cheaper than stopping the enumeration from within the block.
+ * 
+ * Keys are compared bytewise (as UTF-8), which is the same ordering sqlite uses.
+**/
+- (void)enumerateKeysAndObjectsInCollection:(nullable NSString *)collection
+                                    fromKey:(nullable NSString *)fromKey
+                                      toKey:(nullable NSString *)toKey
+                                withOptions:(YapDatabaseEnumerationOptions)options
+                                      limit:(NSUInteger)limit
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block;
+
+/**
+ * Enumerates the next page of (at most limit) rows for the given cursor, and advances the cursor past them.
+ * 
+ * This allows a very large collection to be walked across many short transactions (keyset pagination).
+ * Each page resumes immediately after the last row returned by the previous page,
+ * and resuming is a seek, so the cost of each page doesn't grow with the position of the cursor.
+ * 
+ * The cursor is advanced past every row handed to the block (including the row for which the block sets stop).
+ * If the page contains fewer rows than the limit (and the block didn't stop the enumeration),
+ * the cursor's isExhausted property is set.
+ * 
+ * @param limit
+ *   The maximum number of rows to enumerate, or zero for no limit.
+ * 
+ * @return
+ *   The number of rows handed to the block.
+ * 
+ * @see YapDatabaseCursor
+**/
+- (NSUInteger)enumerateKeysAndObjectsWithCursor:(YapDatabaseCursor *)cursor
+                                          limit:(NSUInteger)limit
+                                     usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block;
+
+/**
+ * Enumerates the objects in the given collection, handing the block a proxy for each object.
+ * 
+ * The object is only deserialized if the block accesses the proxy (by messaging it, or via proxy.realObject).
+ * So a block that decides which rows it's interested in (e.g. by inspecting the key),
+ * doesn't pay for deserializing the rows it skips.
+ * A deserialized object is added to the cache, just as if it had been fetched via objectForKey:inCollection:.
+ * 
+ * This uses a "SELECT rowid, key FROM database WHERE collection = ?" operation,
+ * and an object is read from the database (by rowid) if the block accesses the proxy.
+ * 
+ * Important: The proxy is only valid within the block (for the current row), as it's reused for the next row.
+ * If you need to keep the object, keep proxy.realObject instead.
+**/
+- (void)enumerateKeysAndProxyObjectsInCollection:(nullable NSString *)collection
+                                      usingBlock:(void (^)(NSString *key, YapProxyObject *object, BOOL *stop))block;
+
 /**
  * Enumerates all key/object pairs in all collections.
  * 
@@ -351,6 +675,32 @@ NS_ASSUME_NONNULL_BEGIN
                        usingBlock:(void (^)(NSString *key, id object, __nullable id metadata, BOOL *stop))block
                        withFilter:(nullable BOOL (^)(NSString *key))filter;
 
+/**
+ * Same as above, but allows you to opt in to concurrent deserialization.
+ * This can significantly speed up the enumeration of large collections with expensive deserialization.
+ * 
+ * @see YapDatabaseEnumerationOptions
+**/
+- (void)enumerateRowsInCollection:(nullable NSString *)collection
+                      withOptions:(YapDatabaseEnumerationOptions)options
+                       usingBlock:(void (^)(NSString *key, id object, __nullable id metadata, BOOL *stop))block
+                       withFilter:(nullable BOOL (^)(NSString *key))filter;
+
+/**
+ * Enumerates the rows in the given collection, handing the block a proxy for each object & metadata.
+ * 
+ * The object & metadata are each only deserialized if the block accesses the corresponding proxy.
+ * 
+ * Important: The proxies are only valid within the block (for the current row), as they're reused for the next row.
+ * 
+ * @see enumerateKeysAndProxyObjectsInCollection:usingBlock:
+**/
+- (void)enumerateRowsWithProxiesInCollection:(nullable NSString *)collection
+                                  usingBlock:(void (^)(NSString *key,
+                                                       YapProxyObject *object,
+                                                       YapProxyObject *metadata,
+                                                       BOOL *stop))block;
+
 /**
  * Enumerates all rows in all collections.
  * 
@@ -427,6 +777,18 @@ NS_ASSUME_NONNULL_BEGIN
                 inCollection:(nullable NSString *)collection
          unorderedUsingBlock:(void (^)(NSUInteger keyIndex, __nullable id object, __nullable id metadata, BOOL *stop))block;
 
+#pragma mark Expiration
+
+/**
+ * Returns the expiration date of the given key/collection,
+ * or nil if the object doesn't have one (or doesn't exist).
+ * 
+ * Unlike objectForKey:inCollection:, this method returns the date even if it's already passed.
+ * 
+ * @see YapDatabaseOptions.expiringCollections
+**/
+- (nullable NSDate *)expirationForKey:(NSString *)key inCollection:(nullable NSString *)collection;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Extensions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -485,6 +847,60 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, strong, readwrite, nullable) id yapDatabaseModifiedNotificationCustomObject;
 
+/**
+ * Set to YES to report the changes made by this transaction per collection, rather than per key.
+ * 
+ * Normally the changeset tracks every changed key. When a transaction rewrites a large part of a collection
+ * (e.g. a sync touching 100k keys), building & processing this changeset becomes expensive:
+ * every other connection walks the changed keys to update its caches,
+ * and every YapDatabaseModifiedNotification listener filters them again.
+ * 
+ * With this option enabled, every collection that was changed is instead reported as "reset":
+ * - other connections simply drop any cached entries for those collections
+ * - the hasChange... methods of YapDatabaseConnection return YES for any key in those collections
+ * - the enumerateChanged... methods of YapDatabaseConnection don't enumerate any keys from those collections,
+ *   so use -[YapDatabaseConnection didResetCollection:inNotifications:] to detect this.
+ * 
+ * This only applies to the core changeset. Extensions (such as views) still report their own changes.
+ * 
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL coarseChangeset;
+
+/**
+ * Caps the amount of change information this transaction holds in memory.
+ * 
+ * Until commit, the changeset retains every changed key, along with the new object & metadata values.
+ * So a transaction that changes millions of rows (e.g. a migration) could run out of memory.
+ * 
+ * If this value is non-zero, then once the changeset holds this many changed keys,
+ * the transaction switches to a coarse changeset (see coarseChangeset).
+ * That is, the per-key changes (and the values they retain) are released,
+ * and the collections they belong to are reported as reset instead.
+ * This is repeated whenever the threshold is reached again, so memory usage stays flat, regardless of the number of changes.
+ * 
+ * This only applies to the core changeset. Extensions (such as views) still report their own changes.
+ * 
+ * The default value is 0 (no limit).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger changesetSpillThreshold;
+
+/**
+ * Returns YES if the changesetSpillThreshold was reached during this transaction,
+ * in which case the changeset reports changed collections as reset (as with coarseChangeset).
+**/
+@property (nonatomic, assign, readonly) BOOL changesetSpilled;
+
+/**
+ * Returns YES if default priority read-write transactions are waiting for this transaction to complete.
+ * 
+ * This is designed to be used as a yield point by long running (typically background priority) transactions,
+ * in conjunction with -[YapDatabaseConnection asyncIncrementalReadWriteWithBlock:completionQueue:completionBlock:].
+ * 
+ * @see YapDatabaseWritePriority
+**/
+- (BOOL)shouldYield;
+
 #pragma mark Object & Metadata
 
 /**
@@ -591,6 +1007,35 @@ NS_ASSUME_NONNULL_BEGIN
                             serializedObject:(nullable NSData *)preSerializedObject
                           serializedMetadata:(nullable NSData *)preSerializedMetadata;
 
+/**
+ * Sets multiple objects (with optional metadata) in the given collection.
+ *
+ * This is equivalent to invoking setObject:forKey:inCollection:withMetadata: for each key,
+ * but is considerably faster when importing large batches of items.
+ * The rowids are looked up in bulk, the same insert/update statements are re-used in a tight loop,
+ * and extensions are handed the entire batch at once.
+ *
+ * @param objects
+ *   The objects to store in the database. Must be the same count as keys.
+ *
+ * @param keys
+ *   The lookup keys. If a key appears multiple times, only the last occurrence is used.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+ *
+ * @param metadata
+ *   The metadata to store in the database. Optional.
+ *   If non-nil, it must be the same count as keys, and you can use [NSNull null] for items without metadata.
+**/
+- (void)setObjects:(NSArray *)objects
+           forKeys:(NSArray<NSString *> *)keys
+      inCollection:(nullable NSString *)collection
+      withMetadata:(nullable NSArray *)metadata;
+
+- (void)setObjects:(NSArray *)objects forKeys:(NSArray<NSString *> *)keys inCollection:(nullable NSString *)collection;
+
 /**
  * If a row with the given key/collection exists, then replaces the object for that row with the new value.
  * 
@@ -715,6 +1160,67 @@ NS_ASSUME_NONNULL_BEGIN
            inCollection:(nullable NSString *)collection
  withSerializedMetadata:(nullable NSData *)preSerializedMetadata;
 
+#pragma mark Streams
+
+/**
+ * Opens a stream for incrementally writing the serialized object for the given key/collection
+ * (via sqlite3_blob_write). If the row doesn't exist, it's created (without metadata).
+ * Otherwise the existing metadata is left untouched.
+ * 
+ * The bytes you write must be equal to what we would get if we ran the object through
+ * the database's configured objectSerializer. (As with the preSerializedObject parameter of other methods.)
+ * 
+ * The exact length of the serialized object must be known upfront, as sqlite reserves the space for the blob
+ * (without allocating it in memory), and the stream then fills it in place.
+ * 
+ * Streamed objects are never compressed or stored externally.
+ * 
+ * The stream may only be used within this transaction, and is closed automatically when the transaction commits.
+ * 
+ * @return
+ *   The stream, or nil if an error occurred.
+ * 
+ * @see YapDatabaseBlobWriteStream
+**/
+- (nullable YapDatabaseBlobWriteStream *)openWriteStreamForKey:(NSString *)key
+                                                  inCollection:(nullable NSString *)collection
+                                                        length:(NSUInteger)length;
+
+#pragma mark Import
+
+/**
+ * Loads a collection archive (see -[YapDatabaseReadTransaction exportCollection:toPath:compressed:])
+ * into the collection it was exported from.
+ *
+ * Existing rows with the same key are replaced. Other rows in the collection are left untouched.
+ * (So use removeAllObjectsInCollection: beforehand in order to replace the entire collection.)
+ *
+ * The rows are loaded a chunk at a time, so the archive is streamed rather than held in memory.
+ * If no extensions are registered for the collection, the serialized objects & metadata are written as-is,
+ * without being deserialized. Otherwise each chunk is deserialized (but not re-serialized),
+ * and handed to the extensions as a batch (as with setObjects:forKeys:inCollection:withMetadata:).
+ *
+ * The changes are reported per collection, rather than per key, as with coarseChangeset.
+ * That is, the collection is reported as reset in the YapDatabaseModifiedNotification.
+ * (See -[YapDatabaseConnection didResetCollection:inNotifications:].)
+ *
+ * @return
+ *   nil if the archive was imported. Otherwise an error describing the problem.
+ *   If the archive turns out to be truncated or corrupt, the rows that preceded the problem have been imported.
+ *   Invoke rollback if you'd rather discard them.
+**/
+- (nullable NSError *)importCollectionFromPath:(NSString *)path;
+
+/**
+ * Loads a collection archive from the given stream.
+ *
+ * If the stream isn't open yet, it's opened, and closed once the archive has been read.
+ * Streams that are already open are left open.
+ *
+ * @see importCollectionFromPath:
+**/
+- (nullable NSError *)importCollectionFromStream:(NSInputStream *)stream;
+
 #pragma mark Touch
 
 /**
@@ -757,6 +1263,15 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)touchMetadataForKey:(NSString *)key inCollection:(nullable NSString *)collection;
 - (void)touchRowForKey:(NSString *)key inCollection:(nullable NSString *)collection;
 
+/**
+ * Touches the object of every given key (that exists), as if touchObjectForKey:inCollection: was invoked for each.
+ *
+ * The touches are handed to each extension as a single batch,
+ * so extensions can process them in bulk. For example, a view whose grouping & sorting
+ * don't depend on touched objects simply records the updates, without invoking any of its blocks.
+**/
+- (void)touchObjectsForKeys:(NSArray<NSString *> *)keys inCollection:(nullable NSString *)collection;
+
 #pragma mark Remove
 
 /**
@@ -778,11 +1293,81 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (void)removeAllObjectsInCollection:(nullable NSString *)collection;
 
+/**
+ * Same as removeAllObjectsInCollection:, but optimized for very large collections.
+ * 
+ * removeAllObjectsInCollection: needs to learn every removed key (in order to notify the registered extensions).
+ * This method instead gives each extension the opportunity to handle the removal in bulk (typically with SQL).
+ * If every extension is able to do so, the rows are removed with a single DELETE,
+ * and the memory & time required no longer grows with the size of the collection.
+ * 
+ * Extensions that can't handle the removal in bulk (e.g. views, which need to know the removed keys)
+ * are notified of each removed key as usual. So with such an extension registered,
+ * this performs the same as removeAllObjectsInCollection:.
+ * 
+ * Either way, the commit notification records that the collection was cleared.
+ * Use -[YapDatabaseConnection didClearCollection:inNotifications:] to detect this.
+**/
+- (void)truncateCollection:(nullable NSString *)collection;
+
 /**
  * Removes every key/object pair in the entire database (from all collections).
 **/
 - (void)removeAllObjectsInAllCollections;
 
+#pragma mark Expiration
+
+/**
+ * Sets (or clears, if nil) the expiration date of the given key/collection.
+ * Once the date has passed, the object is treated as missing, and is eventually removed by the sweeper.
+ * 
+ * The collection must be one of the expiringCollections (see YapDatabaseOptions).
+ * If the key/collection doesn't exist, this method does nothing.
+ * 
+ * The expiration belongs to the row. It's cleared when the row is removed,
+ * but it isn't changed when the object or metadata is replaced.
+ * So set a new expiration (or clear it) when you overwrite an object.
+**/
+- (void)setExpiration:(nullable NSDate *)expiration forKey:(NSString *)key inCollection:(nullable NSString *)collection;
+
+/**
+ * Same as setObject:forKey:inCollection:withMetadata:, followed by setExpiration:forKey:inCollection:.
+**/
+- (void)setObject:(nullable id)object
+           forKey:(NSString *)key
+     inCollection:(nullable NSString *)collection
+     withMetadata:(nullable id)metadata
+       expiration:(nullable NSDate *)expiration;
+
+/**
+ * Removes up to limit expired objects (those whose expiration date has passed), oldest expiration first.
+ * This is the same as invoking removeObjectForKey:inCollection: for each of them.
+ * 
+ * Finding the expired objects uses the expiration index,
+ * so the cost is proportional to the number of objects removed, rather than the size of the collections.
+ * 
+ * @return
+ *   The number of removed objects.
+ *   If it's equal to the limit, there may be more expired objects.
+**/
+- (NSUInteger)removeExpiredObjectsWithLimit:(NSUInteger)limit;
+
+#pragma mark Cold Storage
+
+/**
+ * Moves up to limit objects of the coldCollections (see YapDatabaseOptions) into the cold storage file,
+ * least recently written first. Only objects that haven't been written for the coldStorageAge are moved.
+ * 
+ * This is what the background migration invokes (see coldStorageMigrationInterval).
+ * Moving an object doesn't change it (nor its metadata), so it doesn't appear in the changeset,
+ * and extensions aren't notified.
+ * 
+ * @return
+ *   The number of moved objects.
+ *   If it's equal to the limit, there may be more objects to move.
+**/
+- (NSUInteger)moveObjectsToColdStorageWithLimit:(NSUInteger)limit;
+
 #pragma mark Completion
 
 /**
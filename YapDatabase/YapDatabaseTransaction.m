@@ -3,10 +3,19 @@
 #import "YapDatabaseExtensionPrivate.h"
 #import "YapDatabaseString.h"
 #import "YapDatabaseLogging.h"
+#import "YapDatabaseSignposts.h"
 #import "YapCache.h"
 #import "YapCollectionKey.h"
 #import "YapTouch.h"
 #import "YapNull.h"
+#import "YapDeserializationPipeline.h"
+#import "YapDatabaseBlobStreamPrivate.h"
+#import "YapDatabaseCursorPrivate.h"
+#import "YapProxyObjectPrivate.h"
+#import "YapDatabaseCollectionArchivePrivate.h"
+#import "YapDatabaseBinaryCodec.h"
+#import "YapDatabaseQuery.h"
+#import "YapMurmurHash.h"
 
 #import <objc/runtime.h>
 
@@ -25,6 +34,68 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+/**
+ * Records the time spent within an extension hook (if transaction metrics are enabled).
+**/
+static void YapDatabaseTransactionMetricsAddHookTime(YapDatabaseTransactionMetrics *metrics,
+                                                     uint64_t startTime,
+                                                     YapDatabaseExtensionTransaction *extTransaction)
+{
+	if (metrics == nil) return;
+	
+	NSString *extName = [[[extTransaction extensionConnection] extension] registeredName];
+	[metrics addHookTicks:YapDatabaseTransactionMetricsElapsed(startTime) forExtension:extName];
+}
+
+/**
+ * Returns the smallest key (as UTF-8) that is greater than every key with the given prefix,
+ * or nil if there isn't one (i.e. the prefix is empty).
+ * 
+ * Keys are compared using memcmp (sqlite's BINARY collation).
+ * And since 0xFF never appears in UTF-8, incrementing the last byte is sufficient.
+**/
+static NSData *YapDatabaseKeyPrefixUpperBound(NSString *prefix)
+{
+	NSMutableData *bound = [[prefix dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+	uint8_t *bytes = (uint8_t *)bound.mutableBytes;
+	
+	NSUInteger length = bound.length;
+	while (length > 0)
+	{
+		if (bytes[length - 1] < 0xFF)
+		{
+			bytes[length - 1]++;
+			bound.length = length;
+			
+			return bound;
+		}
+		
+		length--;
+	}
+	
+	return nil;
+}
+
+/**
+ * Binds the (optional) bounds & limit of the range statements (see enumerateKeysInRangeStatement:reverse:).
+ * The data must remain valid until the statement is reset (SQLITE_STATIC).
+**/
+static void YapDatabaseBindKeyRange(sqlite3_stmt *statement, int bind_idx_lowerBound,
+                                    NSData *lowerBound, NSData *upperBound, NSUInteger limit)
+{
+	if (lowerBound)
+		sqlite3_bind_text(statement, bind_idx_lowerBound, lowerBound.bytes, (int)lowerBound.length, SQLITE_STATIC);
+	else
+		sqlite3_bind_text(statement, bind_idx_lowerBound, "", 0, SQLITE_STATIC);
+	
+	if (upperBound)
+		sqlite3_bind_text(statement, bind_idx_lowerBound + 1, upperBound.bytes, (int)upperBound.length, SQLITE_STATIC);
+	else
+		sqlite3_bind_zeroblob(statement, bind_idx_lowerBound + 1, 0);
+	
+	sqlite3_bind_int64(statement, bind_idx_lowerBound + 2, (limit == 0) ? -1 : (int64_t)MIN(limit, (NSUInteger)INT64_MAX));
+}
+
 
 @implementation YapDatabaseReadTransaction
 
@@ -57,6 +128,7 @@
 
 @synthesize connection = connection;
 @synthesize userInfo = _external_userInfo;
+@synthesize cachePolicy = cachePolicy;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Transaction States
@@ -94,8 +166,51 @@
     sqlite3_reset(statement);
 }
 
+/**
+ * Invoked by the connection after a read-only transaction has completed, before the transaction is recycled.
+ * Resets the per-transaction state, while retaining the (reusable) extension transactions.
+**/
+- (void)prepareForReuse
+{
+	_external_userInfo = nil;
+	cachePolicy = YapDatabaseTransactionCachePolicyDefault;
+	
+	yapMemoryTableTransaction = nil;
+	prefetchedValues = nil;
+	
+	[orderedExtensions removeAllObjects];
+	[orderedExtensionsByCollection removeAllObjects];
+	extensionsReady = NO;
+	
+	__block NSMutableArray *extNamesToRemove = nil;
+	
+	[extensions enumerateKeysAndObjectsUsingBlock:^(id extName, id extTransaction, BOOL __unused *stop) {
+		
+		if (![(YapDatabaseExtensionTransaction *)extTransaction prepareForReuse])
+		{
+			if (extNamesToRemove == nil)
+				extNamesToRemove = [NSMutableArray array];
+			
+			[extNamesToRemove addObject:extName];
+		}
+	}];
+	
+	if (extNamesToRemove) {
+		[extensions removeObjectsForKeys:extNamesToRemove];
+	}
+}
+
 - (void)preCommitReadWriteTransaction
 {
+	YapDatabaseTransactionMetrics *metrics = connection->transactionMetrics;
+	
+	// Step 0:
+	//
+	// Finish any write streams that are still open.
+	// This may invoke the extension hooks, so must be done before the extensions are flushed.
+	
+	[self closeBlobStreams];
+	
 	// Step 1:
 	//
 	// Allow extensions to flush changes to the main database table.
@@ -111,11 +226,17 @@
 		restart = NO;
 		prevExtModifiesMainDatabaseTable = NO;
 		
-		[extensions enumerateKeysAndObjectsUsingBlock:^(id __unused extNameObj, id extTransactionObj, BOOL *stop) {
+		[extensions enumerateKeysAndObjectsUsingBlock:^(id extNameObj, id extTransactionObj, BOOL *stop) {
+			
+			uint64_t flushTime = YapDatabaseTransactionMetricsStart(metrics);
 			
 			BOOL extModifiesMainDatabaseTable =
 			  [(YapDatabaseExtensionTransaction *)extTransactionObj flushPendingChangesToMainDatabaseTable];
 			
+			if (metrics) {
+				[metrics addFlushTicks:YapDatabaseTransactionMetricsElapsed(flushTime) forExtension:extNameObj];
+			}
+			
 			if (extModifiesMainDatabaseTable)
 			{
 				if (!mutation.isMutated)
@@ -141,26 +262,135 @@
 	
 	// Step 2:
 	//
+	// Allow extensions to prepare the changes for their own tables.
+	// This is the CPU-bound part of the flush (e.g. serialization), which doesn't touch the database.
+	// So if multiple extensions implement it, they prepare concurrently.
+	
+	NSMutableArray<NSString *> *preparingExtNames = nil;
+	
+	for (NSString *extName in extensions)
+	{
+		YapDatabaseExtensionTransaction *extTransaction = extensions[extName];
+		
+		if ([extTransaction overridesHook:@selector(prepareChangesForExtensionTables)])
+		{
+			if (preparingExtNames == nil)
+				preparingExtNames = [[NSMutableArray alloc] initWithCapacity:extensions.count];
+			
+			[preparingExtNames addObject:extName];
+		}
+	}
+	
+	NSUInteger preparingCount = preparingExtNames.count;
+	if (preparingCount == 1)
+	{
+		uint64_t prepareTime = YapDatabaseTransactionMetricsStart(metrics);
+		
+		[(YapDatabaseExtensionTransaction *)extensions[preparingExtNames[0]] prepareChangesForExtensionTables];
+		
+		if (metrics) {
+			[metrics addFlushTicks:YapDatabaseTransactionMetricsElapsed(prepareTime) forExtension:preparingExtNames[0]];
+		}
+	}
+	else if (preparingCount > 1)
+	{
+		NSMutableArray<YapDatabaseExtensionTransaction *> *preparingExtTransactions =
+		  [[NSMutableArray alloc] initWithCapacity:preparingCount];
+		
+		for (NSString *extName in preparingExtNames)
+		{
+			[preparingExtTransactions addObject:extensions[extName]];
+		}
+		
+		// The metrics aren't thread-safe, so each worker records its ticks in its own slot.
+		
+		uint64_t *prepareTicks = calloc(preparingCount, sizeof(uint64_t));
+		
+		dispatch_queue_t queue = dispatch_get_global_queue(qos_class_self(), 0);
+		dispatch_apply(preparingCount, queue, ^(size_t i) { @autoreleasepool {
+			
+			uint64_t prepareTime = YapDatabaseTransactionMetricsStart(metrics);
+			
+			[preparingExtTransactions[i] prepareChangesForExtensionTables];
+			
+			if (metrics) {
+				prepareTicks[i] = YapDatabaseTransactionMetricsElapsed(prepareTime);
+			}
+		}});
+		
+		if (metrics)
+		{
+			for (NSUInteger i = 0; i < preparingCount; i++)
+			{
+				[metrics addFlushTicks:prepareTicks[i] forExtension:preparingExtNames[i]];
+			}
+		}
+		
+		free(prepareTicks);
+	}
+	
+	// Step 3:
+	//
 	// Allow extensions to flush changes to their own tables,
 	// and perform any needed "cleanup" code needed before the changeset is requested.
+	//
+	// The writes go through the (single) sqlite connection, so this step is serialized.
 	
-	[extensions enumerateKeysAndObjectsUsingBlock:^(id __unused extNameObj, id extTransactionObj, BOOL __unused *stop) {
+	[extensions enumerateKeysAndObjectsUsingBlock:^(id extNameObj, id extTransactionObj, BOOL __unused *stop) {
+		
+		uint64_t flushTime = YapDatabaseTransactionMetricsStart(metrics);
+		YDBSignpostID signpost = YDBSignpostBegin("Extension Flush", "extension: %{public}@", extNameObj);
 		
 		[(YapDatabaseExtensionTransaction *)extTransactionObj flushPendingChangesToExtensionTables];
+		
+		YDBSignpostEnd(signpost, "Extension Flush");
+		
+		if (metrics) {
+			[metrics addFlushTicks:YapDatabaseTransactionMetricsElapsed(flushTime) forExtension:extNameObj];
+		}
 	}];
 	
 	[yapMemoryTableTransaction commit];
+	
+	// Step 4:
+	//
+	// Collect the externally stored (and cold) objects that are no longer referenced (by any row).
+	// The reference counts are maintained by triggers, so this covers every change made during the transaction.
+	
+	if (connection->database->externalStorageEnabled)
+	{
+		[(YapDatabaseReadWriteTransaction *)self collectUnreferencedExternalBlobs];
+	}
+	
+	if (connection->database->coldStorageEnabled)
+	{
+		[(YapDatabaseReadWriteTransaction *)self collectUnreferencedColdBlobs];
+	}
+	
+	// Step 5:
+	//
+	// Write the buffered yap2 values (extensions may have modified them in any of the steps above).
+	
+	[(YapDatabaseReadWriteTransaction *)self flushPendingExtensionValues];
 }
 
-- (void)commitTransaction
+- (BOOL)commitTransaction
 {
+	BOOL result = NO;
+	
+	[self closeBlobStreams];
+	
 	sqlite3_stmt *statement = [connection commitTransactionStatement];
 	if (statement)
 	{
 		// COMMIT TRANSACTION;
 		
 		int status = sqlite3_step(statement);
-		if (status != SQLITE_DONE)
+		if (status == SQLITE_DONE)
+		{
+			result = YES;
+		}
+		else
 		{
 			YDBLogError(@"Couldn't commit transaction: %d %s", status, sqlite3_errmsg(connection->db));
 		}
@@ -175,10 +405,14 @@
 			[(YapDatabaseExtensionTransaction *)extTransactionObj didCommitTransaction];
 		}];
 	}
+	
+	return result;
 }
 
 - (void)rollbackTransaction
 {
+	[self invalidateBlobStreams];
+	
 	sqlite3_stmt *statement = [connection rollbackTransactionStatement];
 	if (statement)
 	{
@@ -350,10 +584,10 @@
 		return NO;
 	}
 	
-	NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
-	if (cachedRowid != nil)
+	int64_t cachedRowid = 0;
+	if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
 	{
-		if (rowidPtr) *rowidPtr = [cachedRowid longLongValue];
+		if (rowidPtr) *rowidPtr = cachedRowid;
 		return YES;
 	}
 	
@@ -395,7 +629,7 @@
 	FreeYapDatabaseString(&_key);
 	
 	if (result) {
-		[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+		[connection->keyCache setObject:cacheKey forRowid:rowid];
 	}
 	
 	if (rowidPtr) *rowidPtr = rowid;
@@ -410,9 +644,7 @@
 
 - (YapCollectionKey *)collectionKeyForRowid:(int64_t)rowid
 {
-	NSNumber *rowidNumber = @(rowid);
-	
-	YapCollectionKey *collectionKey = [connection->keyCache objectForKey:rowidNumber];
+	YapCollectionKey *collectionKey = [connection->keyCache objectForRowid:rowid];
 	if (collectionKey)
 	{
 		return collectionKey;
@@ -445,7 +677,7 @@
 		
 		collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 		
-		[connection->keyCache setObject:collectionKey forKey:rowidNumber];
+		[connection->keyCache setObject:collectionKey forRowid:rowid];
 	}
 	else if (status == SQLITE_ERROR)
 	{
@@ -522,9 +754,55 @@
 	}
 }
 
+/**
+ * Batch version of getCollectionKey:object:metadata:forRowid:.
+ *
+ * Items are pulled from the caches, and every cache miss is fetched using a single "rowid IN (?, ?, ...)" query.
+ * (As opposed to a separate query per rowid.)
+ *
+ * Each returned array has the same count & order as the given rowids.
+ * Since arrays can't contain nil, NSNull is used in place of a nil object / metadata,
+ * or at every index of a rowid that doesn't exist.
+ *
+ * The objects and/or metadata are only fetched if the corresponding ptr is non-NULL.
+**/
+- (void)getCollectionKeys:(NSArray<YapCollectionKey *> **)collectionKeysPtr
+                  objects:(NSArray **)objectsPtr
+                 metadata:(NSArray **)metadataPtr
+                forRowids:(NSArray<NSNumber *> *)rowids
+{
+	NSUInteger count = rowids.count;
+	
+	NSMutableArray *collectionKeys = [NSMutableArray arrayWithCapacity:count];
+	NSMutableArray *objects = objectsPtr ? [NSMutableArray arrayWithCapacity:count] : nil;
+	NSMutableArray *metadata = metadataPtr ? [NSMutableArray arrayWithCapacity:count] : nil;
+	
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[collectionKeys addObject:[NSNull null]];
+		[objects addObject:[NSNull null]];
+		[metadata addObject:[NSNull null]];
+	}
+	
+	[self _enumerateRowsForRowids:rowids
+	                  withObjects:(objects != nil)
+	                     metadata:(metadata != nil)
+	          unorderedUsingBlock:^(NSUInteger rowidIndex, YapCollectionKey *ck, id object, id meta, BOOL __unused *stop)
+	{
+		collectionKeys[rowidIndex] = ck;
+		
+		if (object) objects[rowidIndex] = object;
+		if (meta) metadata[rowidIndex] = meta;
+	}];
+	
+	if (collectionKeysPtr) *collectionKeysPtr = [collectionKeys copy];
+	if (objectsPtr) *objectsPtr = [objects copy];
+	if (metadataPtr) *metadataPtr = [metadata copy];
+}
+
 - (BOOL)hasRowid:(int64_t)rowid
 {
-	if ([connection->keyCache containsKey:@(rowid)])
+	if ([connection->keyCache containsRowid:rowid])
 		return YES;
 	
 	sqlite3_stmt *statement = [connection getCountForRowidStatement];
@@ -562,6 +840,48 @@
 	return [self objectForCollectionKey:cacheKey withRowid:rowid];
 }
 
+/**
+ * The shared object cache (see YapDatabaseOptions.enableSharedObjectCache) is only used by read-only transactions,
+ * on connections that use YapDatabasePolicyShare (as the cached instances are handed to multiple connections).
+**/
+- (YapSharedObjectCache *)sharedObjectCache
+{
+	if (isReadWriteTransaction) return nil;
+	if (connection->objectPolicy != YapDatabasePolicyShare) return nil;
+	
+	return connection->database->sharedObjectCache;
+}
+
+/**
+ * Checks the shared object cache (after a miss in the connection's objectCache).
+ * If found, the object is also added to the connection's objectCache.
+**/
+- (id)sharedObjectCacheObjectForCollectionKey:(YapCollectionKey *)cacheKey
+{
+	YapSharedObjectCache *sharedObjectCache = [self sharedObjectCache];
+	if (sharedObjectCache == nil) return nil;
+	
+	id object = [sharedObjectCache objectForKey:cacheKey snapshot:[connection snapshot]];
+	
+	if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+		[connection->objectCache setObject:object forKey:cacheKey];
+	
+	return object;
+}
+
+/**
+ * Adds an object (that was read from disk) to the shared object cache.
+**/
+- (void)sharedObjectCacheSetObject:(id)object forCollectionKey:(YapCollectionKey *)cacheKey
+{
+	if (cachePolicy == YapDatabaseTransactionCachePolicyBypass) return;
+	
+	YapSharedObjectCache *sharedObjectCache = [self sharedObjectCache];
+	if (sharedObjectCache == nil) return;
+	
+	[sharedObjectCache setObject:object forKey:cacheKey snapshot:[connection snapshot]];
+}
+
 - (id)objectForCollectionKey:(YapCollectionKey *)cacheKey withRowid:(int64_t)rowid
 {
 	if (cacheKey == nil) return nil;
@@ -570,6 +890,10 @@
 	if (object)
 		return object;
 	
+	object = [self sharedObjectCacheObjectForCollectionKey:cacheKey];
+	if (object)
+		return object;
+	
 	sqlite3_stmt *statement = [connection getDataForRowidStatement];
 	if (statement == NULL) return nil;
 	
@@ -587,13 +911,15 @@
 		int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 		
 		// Performance tuning:
-		// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+		// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 		
-		NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-		object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, data);
+		object = YapDatabaseDeserializeObject(connection->database, cacheKey.collection, cacheKey.key, blob, blobSize);
 		
-		if (object)
+		if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+		{
 			[connection->objectCache setObject:object forKey:cacheKey];
+			[self sharedObjectCacheSetObject:object forCollectionKey:cacheKey];
+		}
 	}
 	else if (status == SQLITE_ERROR)
 	{
@@ -639,22 +965,16 @@
 	int status = sqlite3_step(statement);
 	if (status == SQLITE_ROW)
 	{
-		const void *blob = sqlite3_column_blob(statement, column_idx_metadata);
-		int blobSize = sqlite3_column_bytes(statement, column_idx_metadata);
+		metadata = YapDatabaseMetadataFromColumn(connection->database, cacheKey.collection, cacheKey.key,
+		                                         statement, column_idx_metadata);
 		
-		if (blobSize > 0)
+		if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
 		{
-			// Performance tuning:
-			// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-			
-			NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			metadata = connection->database->metadataDeserializer(cacheKey.collection, cacheKey.key, data);
+			if (metadata)
+				[connection->metadataCache setObject:metadata forKey:cacheKey];
+			else
+				[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 		}
-		
-		if (metadata)
-			[connection->metadataCache setObject:metadata forKey:cacheKey];
-		else
-			[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 	}
 	else if (status == SQLITE_ERROR)
 	{
@@ -688,6 +1008,9 @@
 	id object = [connection->objectCache objectForKey:cacheKey];
 	id metadata = [connection->metadataCache objectForKey:cacheKey];
 	
+	if (objectPtr && !object)
+		object = [self sharedObjectCacheObjectForCollectionKey:cacheKey];
+	
 	if (object || metadata)
 	{
 		if (objectPtr && !object)
@@ -731,33 +1054,29 @@
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
 				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+				// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, oData);
+				object = YapDatabaseDeserializeObject(connection->database, cacheKey.collection, cacheKey.key, oBlob, oBlobSize);
 				
-				if (object)
+				if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+				{
 					[connection->objectCache setObject:object forKey:cacheKey];
+					[self sharedObjectCacheSetObject:object forCollectionKey:cacheKey];
+				}
 			}
 			
 			if (metadataPtr)
 			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
+				metadata = YapDatabaseMetadataFromColumn(connection->database, cacheKey.collection, cacheKey.key,
+				                                         statement, column_idx_metadata);
 				
-				if (mBlobSize > 0)
+				if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
 				{
-					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-					
-					NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-					metadata = connection->database->metadataDeserializer(cacheKey.collection, cacheKey.key, mData);
+					if (metadata)
+						[connection->metadataCache setObject:metadata forKey:cacheKey];
+					else
+						[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 				}
-				
-				if (metadata)
-					[connection->metadataCache setObject:metadata forKey:cacheKey];
-				else
-					[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 			}
 			
 			found = YES;
@@ -786,8 +1105,14 @@
 	if (key == nil) return NO;
 	if (collection == nil) collection = @"";
 	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordOperation:YapDatabaseWorkloadTraceOperationHasKey collection:collection key:key];
+	}
+	
 	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
+	if ([self isExpiredCollectionKey:cacheKey]) return NO;
+	
 	// Shortcut:
 	// We may not need to query the database if we have the key in any of our caches.
 	
@@ -804,16 +1129,26 @@
 	if (key == nil) return nil;
 	if (collection == nil) collection = @"";
 	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordOperation:YapDatabaseWorkloadTraceOperationGetObject collection:collection key:key];
+	}
+	
 	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
+	if ([self isExpiredCollectionKey:cacheKey]) return nil;
+	
 	id object = [connection->objectCache objectForKey:cacheKey];
 	if (object)
 		return object;
 	
-	NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
-	if (cachedRowid != nil)
+	object = [self sharedObjectCacheObjectForCollectionKey:cacheKey];
+	if (object)
+		return object;
+	
+	int64_t cachedRowid = 0;
+	if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
 	{
-		int64_t rowid = [cachedRowid longLongValue];
+		int64_t rowid = cachedRowid;
 		
 		sqlite3_stmt *statement = [connection getDataForRowidStatement];
 		if (statement == NULL) return nil;
@@ -832,13 +1167,15 @@
 			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
 			// Performance tuning:
-			// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+			// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 			
-			NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, data);
+			object = YapDatabaseDeserializeObject(connection->database, cacheKey.collection, cacheKey.key, blob, blobSize);
 			
-			if (object)
+			if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+			{
 				[connection->objectCache setObject:object forKey:cacheKey];
+				[self sharedObjectCacheSetObject:object forCollectionKey:cacheKey];
+			}
 		}
 		else if (status == SQLITE_ERROR)
 		{
@@ -875,17 +1212,18 @@
 			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
 			// Performance tuning:
-			// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+			// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 			
-			NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			object = connection->database->objectDeserializer(collection, key, data);
+			object = YapDatabaseDeserializeObject(connection->database, collection, key, blob, blobSize);
 			
 			// Update caches
 			
-			[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
 			
-			if (object) {
+			if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+			{
 				[connection->objectCache setObject:object forKey:cacheKey];
+				[self sharedObjectCacheSetObject:object forCollectionKey:cacheKey];
 			}
 		}
 		else if (status == SQLITE_ERROR)
@@ -903,62 +1241,53 @@
 	return object;
 }
 
-- (id)metadataForKey:(NSString *)key inCollection:(NSString *)collection
+- (id)valueForField:(NSString *)field forKey:(NSString *)key inCollection:(NSString *)collection
 {
+	if (field == nil) return nil;
 	if (key == nil) return nil;
 	if (collection == nil) collection = @"";
 	
 	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
-	id metadata = [connection->metadataCache objectForKey:cacheKey];
-	if (metadata)
+	if ([self isExpiredCollectionKey:cacheKey]) return nil;
+	
+	id object = [connection->objectCache objectForKey:cacheKey];
+	if ([object isKindOfClass:[NSDictionary class]])
 	{
-		if (metadata == [YapNull null])
-			return nil;
-		else
-			return metadata;
+		return [(NSDictionary *)object objectForKey:field];
 	}
 	
-	NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
-	if (cachedRowid != nil)
+	// Read the field straight from the stored bytes (without deserializing the object)
+	
+	id value = nil;
+	BOOL found = NO;
+	BOOL isBinaryCodecRow = NO;
+	
+	int64_t cachedRowid = 0;
+	if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
 	{
-		int64_t rowid = [cachedRowid longLongValue];
-		
-		sqlite3_stmt *statement = [connection getMetadataForRowidStatement];
+		sqlite3_stmt *statement = [connection getDataForRowidStatement];
 		if (statement == NULL) return nil;
 		
-		// SELECT "metadata" FROM "database2" WHERE "rowid" = ?;
+		// SELECT "data" FROM "database2" WHERE "rowid" = ?;
 		
-		int const column_idx_metadata = SQLITE_COLUMN_START;
-		int const bind_idx_rowid      = SQLITE_BIND_START;
+		int const column_idx_data = SQLITE_COLUMN_START;
+		int const bind_idx_rowid  = SQLITE_BIND_START;
 		
-		sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+		sqlite3_bind_int64(statement, bind_idx_rowid, cachedRowid);
 		
 		int status = sqlite3_step(statement);
 		if (status == SQLITE_ROW)
 		{
-			const void *blob = sqlite3_column_blob(statement, column_idx_metadata);
-			int blobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-			
-			if (blobSize > 0)
-			{
-				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-				
-				NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-				metadata = connection->database->metadataDeserializer(cacheKey.collection, cacheKey.key, data);
-			}
-			
-			// Update cache
+			const void *blob = sqlite3_column_blob(statement, column_idx_data);
+			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
-			if (metadata)
-				[connection->metadataCache setObject:metadata forKey:cacheKey];
-			else
-				[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+			found = YES;
+			isBinaryCodecRow = [YapDatabaseBinaryCodec getValue:&value forField:field inBytes:blob length:blobSize];
 		}
 		else if (status == SQLITE_ERROR)
 		{
-			YDBLogError(@"Error executing 'getMetadataForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
+			YDBLogError(@"Error executing 'getDataForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
 		}
 		
 		sqlite3_clear_bindings(statement);
@@ -966,13 +1295,13 @@
 	}
 	else
 	{
-		sqlite3_stmt *statement = [connection getMetadataForKeyStatement];
+		sqlite3_stmt *statement = [connection getDataForKeyStatement];
 		if (statement == NULL) return nil;
 		
-		// SELECT "rowid", "metadata" FROM "database2" WHERE "collection" = ? AND "key" = ? ;
+		// SELECT "rowid", "data" FROM "database2" WHERE "collection" = ? AND "key" = ?;
 		
 		int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
-		int const column_idx_metadata = SQLITE_COLUMN_START + 1;
+		int const column_idx_data     = SQLITE_COLUMN_START + 1;
 		int const bind_idx_collection = SQLITE_BIND_START + 0;
 		int const bind_idx_key        = SQLITE_BIND_START + 1;
 		
@@ -987,31 +1316,143 @@
 		{
 			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 			
-			const void *blob = sqlite3_column_blob(statement, column_idx_metadata);
-			int blobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-			
-			if (blobSize > 0)
-			{
-				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-				
-				NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-				metadata = connection->database->metadataDeserializer(collection, key, data);
-			}
-			
-			// Update caches
+			const void *blob = sqlite3_column_blob(statement, column_idx_data);
+			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
-			[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+			found = YES;
+			isBinaryCodecRow = [YapDatabaseBinaryCodec getValue:&value forField:field inBytes:blob length:blobSize];
 			
-			if (metadata)
-				[connection->metadataCache setObject:metadata forKey:cacheKey];
-			else
-				[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
 		}
 		else if (status == SQLITE_ERROR)
 		{
-			YDBLogError(@"Error executing 'getMetadataForKeyStatement': %d %s",
-			                                                        status, sqlite3_errmsg(connection->db));
+			YDBLogError(@"Error executing 'getDataForKeyStatement': %d %s, key(%@)",
+			                                                    status, sqlite3_errmsg(connection->db), key);
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		FreeYapDatabaseString(&_collection);
+		FreeYapDatabaseString(&_key);
+	}
+	
+	if (found && !isBinaryCodecRow)
+	{
+		// The row wasn't serialized by the YapDatabaseBinaryCodec, so we have to deserialize the object.
+		
+		object = [self objectForKey:key inCollection:collection];
+		if ([object isKindOfClass:[NSDictionary class]])
+		{
+			value = [(NSDictionary *)object objectForKey:field];
+		}
+	}
+	
+	return value;
+}
+
+- (id)metadataForKey:(NSString *)key inCollection:(NSString *)collection
+{
+	if (key == nil) return nil;
+	if (collection == nil) collection = @"";
+	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordOperation:YapDatabaseWorkloadTraceOperationGetMetadata collection:collection key:key];
+	}
+	
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	
+	if ([self isExpiredCollectionKey:cacheKey]) return nil;
+	
+	id metadata = [connection->metadataCache objectForKey:cacheKey];
+	if (metadata)
+	{
+		if (metadata == [YapNull null])
+			return nil;
+		else
+			return metadata;
+	}
+	
+	int64_t cachedRowid = 0;
+	if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
+	{
+		int64_t rowid = cachedRowid;
+		
+		sqlite3_stmt *statement = [connection getMetadataForRowidStatement];
+		if (statement == NULL) return nil;
+		
+		// SELECT "metadata" FROM "database2" WHERE "rowid" = ?;
+		
+		int const column_idx_metadata = SQLITE_COLUMN_START;
+		int const bind_idx_rowid      = SQLITE_BIND_START;
+		
+		sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+		
+		int status = sqlite3_step(statement);
+		if (status == SQLITE_ROW)
+		{
+			metadata = YapDatabaseMetadataFromColumn(connection->database, cacheKey.collection, cacheKey.key,
+			                                         statement, column_idx_metadata);
+			
+			// Update cache
+			
+			if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
+			{
+				if (metadata)
+					[connection->metadataCache setObject:metadata forKey:cacheKey];
+				else
+					[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+			}
+		}
+		else if (status == SQLITE_ERROR)
+		{
+			YDBLogError(@"Error executing 'getMetadataForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+	}
+	else
+	{
+		sqlite3_stmt *statement = [connection getMetadataForKeyStatement];
+		if (statement == NULL) return nil;
+		
+		// SELECT "rowid", "metadata" FROM "database2" WHERE "collection" = ? AND "key" = ? ;
+		
+		int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+		int const column_idx_metadata = SQLITE_COLUMN_START + 1;
+		int const bind_idx_collection = SQLITE_BIND_START + 0;
+		int const bind_idx_key        = SQLITE_BIND_START + 1;
+		
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+		
+		YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
+		sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+		
+		int status = sqlite3_step(statement);
+		if (status == SQLITE_ROW)
+		{
+			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+			
+			metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+			                                         statement, column_idx_metadata);
+			
+			// Update caches
+			
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
+			
+			if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
+			{
+				if (metadata)
+					[connection->metadataCache setObject:metadata forKey:cacheKey];
+				else
+					[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+			}
+		}
+		else if (status == SQLITE_ERROR)
+		{
+			YDBLogError(@"Error executing 'getMetadataForKeyStatement': %d %s",
+			                                                        status, sqlite3_errmsg(connection->db));
 		}
 		
 		sqlite3_clear_bindings(statement);
@@ -1034,11 +1475,26 @@
 	}
 	if (collection == nil) collection = @"";
 	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordOperation:YapDatabaseWorkloadTraceOperationGetRow collection:collection key:key];
+	}
+	
 	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
+	if ([self isExpiredCollectionKey:cacheKey])
+	{
+		if (objectPtr) *objectPtr = nil;
+		if (metadataPtr) *metadataPtr = nil;
+		
+		return NO;
+	}
+	
 	id object = [connection->objectCache objectForKey:cacheKey];
 	id metadata = [connection->metadataCache objectForKey:cacheKey];
 	
+	if (objectPtr && !object)
+		object = [self sharedObjectCacheObjectForCollectionKey:cacheKey];
+	
 	BOOL found = NO;
 	
 	if (object || metadata)
@@ -1063,10 +1519,10 @@
 		// Both object and metadata are missing.
 		// Fetch via query.
 		
-		NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
-		if (cachedRowid != nil)
+		int64_t cachedRowid = 0;
+		if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
 		{
-			int64_t rowid = [cachedRowid longLongValue];
+			int64_t rowid = cachedRowid;
 			
 			sqlite3_stmt *statement = [connection getAllForRowidStatement];
 			if (statement == NULL) {
@@ -1092,33 +1548,29 @@
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 					
 					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+					// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 					
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, oData);
+					object = YapDatabaseDeserializeObject(connection->database, cacheKey.collection, cacheKey.key, oBlob, oBlobSize);
 					
-					if (object)
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+					{
 						[connection->objectCache setObject:object forKey:cacheKey];
+						[self sharedObjectCacheSetObject:object forCollectionKey:cacheKey];
+					}
 				}
 				
 				if (metadataPtr)
 				{
-					const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-					int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
+					metadata = YapDatabaseMetadataFromColumn(connection->database, cacheKey.collection, cacheKey.key,
+					                                         statement, column_idx_metadata);
 					
-					if (mBlobSize > 0)
+					if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
 					{
-						// Performance tuning:
-						// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-						
-						NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-						metadata = connection->database->metadataDeserializer(cacheKey.collection, cacheKey.key, mData);
+						if (metadata)
+							[connection->metadataCache setObject:metadata forKey:cacheKey];
+						else
+							[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 					}
-					
-					if (metadata)
-						[connection->metadataCache setObject:metadata forKey:cacheKey];
-					else
-						[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 				}
 				
 				found = YES;
@@ -1159,35 +1611,34 @@
 			{
 				int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 				
-				[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+				[connection->keyCache setObject:cacheKey forRowid:rowid];
 				
 				if (objectPtr)
 				{
 					const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(collection, key, oData);
+					object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
 					
-					if (object)
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+					{
 						[connection->objectCache setObject:object forKey:cacheKey];
+						[self sharedObjectCacheSetObject:object forCollectionKey:cacheKey];
+					}
 				}
 				
 				if (metadataPtr)
 				{
-					const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-					int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-					if (mBlobSize > 0)
+					metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+					                                         statement, column_idx_metadata);
+					
+					if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
 					{
-						NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-						metadata = connection->database->metadataDeserializer(collection, key, mData);
+						if (metadata)
+							[connection->metadataCache setObject:metadata forKey:cacheKey];
+						else
+							[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 					}
-					
-					if (metadata)
-						[connection->metadataCache setObject:metadata forKey:cacheKey];
-					else
-						[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
 				}
 				
 				found = YES;
@@ -1211,6 +1662,148 @@
 	return found;
 }
 
+/**
+ * Fetches the objects and/or metadata for the given list of keys.
+ *
+ * Items in the cache are returned immediately.
+ * All remaining keys are then fetched from the database using as few queries as possible,
+ * and the results are added to the cache.
+ *
+ * Keys that don't exist in the database are not included in the returned dictionaries.
+ * Rows with nil metadata are not included in the returned metadata dictionary.
+**/
+- (void)getObjects:(NSDictionary **)objectsPtr
+          metadata:(NSDictionary **)metadataPtr
+           forKeys:(NSArray *)keys
+      inCollection:(NSString *)collection
+{
+	BOOL withObjects = (objectsPtr != NULL);
+	BOOL withMetadata = (metadataPtr != NULL);
+	
+	if ((keys.count == 0) || (!withObjects && !withMetadata))
+	{
+		if (objectsPtr) *objectsPtr = [NSDictionary dictionary];
+		if (metadataPtr) *metadataPtr = [NSDictionary dictionary];
+		return;
+	}
+	
+	NSMutableDictionary *objects = withObjects ? [NSMutableDictionary dictionaryWithCapacity:keys.count] : nil;
+	NSMutableDictionary *metadata = withMetadata ? [NSMutableDictionary dictionaryWithCapacity:keys.count] : nil;
+	
+	NSString *expiringCollection = collection ?: @"";
+	BOOL checkExpiration = [connection->database->expiringCollections containsObject:expiringCollection];
+	
+	[self _enumerateRowsForKeys:keys
+	               inCollection:collection
+	                withObjects:withObjects
+	                   metadata:withMetadata
+	        unorderedUsingBlock:^(NSUInteger keyIndex, id object, id meta, BOOL __unused *stop)
+	{
+		NSString *key = keys[keyIndex];
+		
+		if (checkExpiration)
+		{
+			YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:expiringCollection key:key];
+			if ([self isExpiredCollectionKey:ck]) return;
+		}
+		
+		if (object) objects[key] = object;
+		if (meta) metadata[key] = meta;
+	}];
+	
+	if (objectsPtr) *objectsPtr = [objects copy];
+	if (metadataPtr) *metadataPtr = [metadata copy];
+}
+
+/**
+ * Fetches the objects for the given collection/key pairs, grouping the cache misses by collection.
+ * Each group is then fetched via _enumerateRowsForKeys:inCollection:withObjects:metadata:unorderedUsingBlock:,
+ * so a page of keys spread across a handful of collections costs a handful of queries.
+**/
+- (NSArray *)objectsForCollectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+{
+	NSUInteger count = collectionKeys.count;
+	if (count == 0) return @[];
+	
+	NSMutableArray *objects = [NSMutableArray arrayWithCapacity:count];
+	
+	// Check the cache first, and group the misses by collection.
+	// A collection/key pair may appear more than once, so each pair maps to every index it appears at.
+	
+	NSMutableDictionary<NSString *, NSMutableArray<NSString *> *> *missingKeys = nil;
+	NSMutableDictionary<YapCollectionKey *, NSMutableArray<NSNumber *> *> *missingIndexes = nil;
+	
+	NSUInteger index = 0;
+	for (YapCollectionKey *ck in collectionKeys)
+	{
+		id object = [connection->objectCache objectForKey:ck];
+		if (object == nil)
+			object = [self sharedObjectCacheObjectForCollectionKey:ck];
+		
+		if (object)
+		{
+			if ([self isExpiredCollectionKey:ck])
+				[objects addObject:[NSNull null]];
+			else
+				[objects addObject:object];
+		}
+		else
+		{
+			[objects addObject:[NSNull null]];
+			
+			if (missingKeys == nil)
+			{
+				missingKeys = [NSMutableDictionary dictionary];
+				missingIndexes = [NSMutableDictionary dictionary];
+			}
+			
+			NSMutableArray<NSNumber *> *indexes = missingIndexes[ck];
+			if (indexes == nil)
+			{
+				indexes = [NSMutableArray arrayWithCapacity:1];
+				missingIndexes[ck] = indexes;
+				
+				NSMutableArray<NSString *> *keys = missingKeys[ck.collection];
+				if (keys == nil)
+				{
+					keys = [NSMutableArray array];
+					missingKeys[ck.collection] = keys;
+				}
+				
+				[keys addObject:ck.key];
+			}
+			
+			[indexes addObject:@(index)];
+		}
+		
+		index++;
+	}
+	
+	for (NSString *collection in missingKeys)
+	{
+		NSArray<NSString *> *keys = missingKeys[collection];
+		
+		[self _enumerateRowsForKeys:keys
+		               inCollection:collection
+		                withObjects:YES
+		                   metadata:NO
+		        unorderedUsingBlock:^(NSUInteger keyIndex, id object, id __unused metadata, BOOL __unused *stop)
+		{
+			if (object == nil) return;
+			
+			YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:keys[keyIndex]];
+			if ([self isExpiredCollectionKey:ck]) return;
+			
+			for (NSNumber *objectIndex in missingIndexes[ck])
+			{
+				objects[[objectIndex unsignedIntegerValue]] = object;
+			}
+		}];
+	}
+	
+	return [objects copy];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Primitive
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1232,10 +1825,10 @@
 	NSData *result = nil;
 	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
-	NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
-	if (cachedRowid != nil)
+	int64_t cachedRowid = 0;
+	if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
 	{
-		int64_t rowid = [cachedRowid longLongValue];
+		int64_t rowid = cachedRowid;
 		
 		sqlite3_stmt *statement = [connection getDataForRowidStatement];
 		if (statement == NULL) return nil;
@@ -1253,7 +1846,7 @@
 			const void *blob = sqlite3_column_blob(statement, column_idx_data);
 			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
-			result = [[NSData alloc] initWithBytes:blob length:blobSize];
+			result = YapDatabaseCopySerializedObject(connection->database, blob, blobSize);
 		}
 		else if (status == SQLITE_ERROR)
 		{
@@ -1289,11 +1882,11 @@
 			const void *blob = sqlite3_column_blob(statement, column_idx_data);
 			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
-			result = [[NSData alloc] initWithBytes:blob length:blobSize];
+			result = YapDatabaseCopySerializedObject(connection->database, blob, blobSize);
 			
 			// Update cache
 			
-			[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
 		}
 		else if (status == SQLITE_ERROR)
 		{
@@ -1327,10 +1920,10 @@
 	NSData *result = nil;
 	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
-	NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
-	if (cachedRowid != nil)
+	int64_t cachedRowid = 0;
+	if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
 	{
-		int64_t rowid = [cachedRowid longLongValue];
+		int64_t rowid = cachedRowid;
 		
 		sqlite3_stmt *statement = [connection getMetadataForRowidStatement];
 		if (statement == NULL) return nil;
@@ -1345,10 +1938,8 @@
 		int status = sqlite3_step(statement);
 		if (status == SQLITE_ROW)
 		{
-			const void *blob = sqlite3_column_blob(statement, column_idx_metadata);
-			int blobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-			
-			result = [[NSData alloc] initWithBytes:blob length:blobSize];
+			result = YapDatabaseCopySerializedMetadata(connection->database, collection, key,
+			                                           statement, column_idx_metadata);
 		}
 		else if (status == SQLITE_ERROR)
 		{
@@ -1381,14 +1972,12 @@
 		{
 			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 			
-			const void *blob = sqlite3_column_blob(statement, column_idx_metadata);
-			int blobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-			
-			result = [[NSData alloc] initWithBytes:blob length:blobSize];
+			result = YapDatabaseCopySerializedMetadata(connection->database, collection, key,
+			                                           statement, column_idx_metadata);
 			
 			// Update cache
 			
-			[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
 		}
 		else if (status == SQLITE_ERROR)
 		{
@@ -1433,10 +2022,10 @@
 	
 	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
-	NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
-	if (cachedRowid != nil)
+	int64_t cachedRowid = 0;
+	if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
 	{
-		int64_t rowid = [cachedRowid longLongValue];
+		int64_t rowid = cachedRowid;
 		
 		sqlite3_stmt *statement = [connection getAllForRowidStatement];
 		if (statement == NULL) {
@@ -1461,15 +2050,13 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				serializedObject = [NSData dataWithBytes:(void *)oBlob length:oBlobSize];
+				serializedObject = YapDatabaseCopySerializedObject(connection->database, oBlob, oBlobSize);
 			}
 			
 			if (serializedMetadataPtr)
 			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-				serializedMetadata = [NSData dataWithBytes:(void *)mBlob length:mBlobSize];
+				serializedMetadata = YapDatabaseCopySerializedMetadata(connection->database, collection, key,
+				                                                       statement, column_idx_metadata);
 			}
 			
 			found = YES;
@@ -1515,22 +2102,20 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				serializedObject = [NSData dataWithBytes:(void *)oBlob length:oBlobSize];
+				serializedObject = YapDatabaseCopySerializedObject(connection->database, oBlob, oBlobSize);
 			}
 			
 			if (serializedMetadataPtr)
 			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-				serializedMetadata = [NSData dataWithBytes:(void *)mBlob length:mBlobSize];
+				serializedMetadata = YapDatabaseCopySerializedMetadata(connection->database, collection, key,
+				                                                       statement, column_idx_metadata);
 			}
 			
 			found = YES;
 			
 			// Update cache
 			
-			[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
 		}
 		else if (status == SQLITE_ERROR)
 		{
@@ -1550,47 +2135,374 @@
 	return found;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Enumerate
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Fast enumeration over all the collections in the database.
- * 
- * This uses a "SELECT collection FROM database" operation,
- * and then steps over the results invoking the given block handler.
+ * Primitive access.
+ * Opens a stream for incrementally reading the serialized object.
 **/
-- (void)enumerateCollectionsUsingBlock:(void (^)(NSString *collection, BOOL *stop))block
+- (YapDatabaseBlobReadStream *)openReadStreamForKey:(NSString *)key inCollection:(NSString *)collection
 {
-	if (block == NULL) return;
-	
-	BOOL needsFinalize;
-	sqlite3_stmt *statement = [connection enumerateCollectionsStatement:&needsFinalize];
-	if (statement == NULL) return;
+	if (key == nil) return nil;
+	if (collection == nil) collection = @"";
 	
-	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
-	BOOL stop = NO;
+	int64_t rowid = 0;
+	if (![self getRowid:&rowid forKey:key inCollection:collection]) return nil;
 	
-	// SELECT DISTINCT "collection" FROM "database2";
+	YapDatabase *database = connection->database;
 	
-	int const column_idx_collection = SQLITE_COLUMN_START;
+	sqlite3_blob *blob = NULL;
+	const char *table = database->usesCollectionIds ? "database3" : "database2";
 	
-	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	int status = sqlite3_blob_open(connection->db, "main", table, "data", rowid, 0, &blob);
+	if (status != SQLITE_OK)
 	{
-		const unsigned char *text = sqlite3_column_text(statement, column_idx_collection);
-		int textSize = sqlite3_column_bytes(statement, column_idx_collection);
-		
-		NSString *collection = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		YDBLogError(@"Error opening blob: %d %s", status, sqlite3_errmsg(connection->db));
 		
-		block(collection, &stop);
+		if (blob) sqlite3_blob_close(blob);
+		return nil;
+	}
+	
+	YapDatabaseBlobReadStream *stream = nil;
+	
+	size_t blobSize = (size_t)sqlite3_blob_bytes(blob);
+	uint8_t header[YAP_EXTERNAL_STORAGE_REFERENCE_SIZE];
+	
+	BOOL hasHeader = NO;
+	BOOL mayHaveHeader =
+	  (database->compressionEnabled || database->externalStorageEnabled || database->coldStorageEnabled);
+	
+	if (mayHaveHeader && blobSize >= YAP_COMPRESSION_HEADER_SIZE)
+	{
+		status = sqlite3_blob_read(blob, header, (int)MIN(blobSize, sizeof(header)), 0);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error reading blob: %d %s", status, sqlite3_errmsg(connection->db));
+			
+			sqlite3_blob_close(blob);
+			return nil;
+		}
 		
-		if (stop || mutation.isMutated) break;
+		hasHeader = YapDatabaseCompressionHasHeader(header, blobSize);
 	}
 	
-	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	YapDatabaseCompressionAlgorithm algorithm = YapDatabaseCompressionAlgorithmNone;
+	if (hasHeader)
 	{
-		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+		YapDatabaseCompressionReadHeader(header, blobSize, &algorithm, NULL, NULL);
+	}
+	
+	if (!hasHeader)
+	{
+		stream = [[YapDatabaseBlobReadStream alloc] initWithTransaction:self blob:blob baseOffset:0];
+	}
+	else if (YapDatabaseIsExternalReference(header, blobSize))
+	{
+		sqlite3_blob_close(blob);
+		
+		NSData *data = [database externalBlobWithReference:header]; // Memory mapped
+		if (data == nil) return nil;
+		
+		stream = [[YapDatabaseBlobReadStream alloc] initWithTransaction:self data:data];
+	}
+	else if (YapDatabaseIsColdReference(header, blobSize))
+	{
+		sqlite3_blob_close(blob);
+		
+		// The object is read from the cold storage file (and decompressed if needed).
+		
+		NSData *data = YapDatabaseCopySerializedObject(database, header, (int)blobSize);
+		if (data == nil) return nil;
+		
+		stream = [[YapDatabaseBlobReadStream alloc] initWithTransaction:self data:data];
+	}
+	else if (algorithm == YapDatabaseCompressionAlgorithmNone)
+	{
+		stream = [[YapDatabaseBlobReadStream alloc] initWithTransaction:self
+		                                                           blob:blob
+		                                                     baseOffset:YAP_COMPRESSION_HEADER_SIZE];
+	}
+	else
+	{
+		// Compressed rows can't be decompressed incrementally.
+		// So we decompress the whole thing, and stream from memory.
+		
+		NSMutableData *compressed = [NSMutableData dataWithLength:blobSize];
+		
+		status = sqlite3_blob_read(blob, compressed.mutableBytes, (int)blobSize, 0);
+		sqlite3_blob_close(blob);
+		
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error reading blob: %d %s", status, sqlite3_errmsg(connection->db));
+			return nil;
+		}
+		
+		size_t decompressedLength = 0;
+		const void *bytes = [database decompressBytes:compressed.bytes
+		                                       length:blobSize
+		                           decompressedLength:&decompressedLength];
+		if (bytes == NULL) return nil;
+		
+		NSData *data = [NSData dataWithBytes:bytes length:decompressedLength];
+		stream = [[YapDatabaseBlobReadStream alloc] initWithTransaction:self data:data];
+	}
+	
+	if (openBlobStreams == nil)
+		openBlobStreams = [[NSMutableArray alloc] init];
+	
+	[openBlobStreams addObject:stream];
+	return stream;
+}
+
+/**
+ * Invoked by a stream when it's closed (by the user, or via closeBlobStreams).
+**/
+- (void)blobStreamDidClose:(id)stream
+{
+	[openBlobStreams removeObjectIdenticalTo:stream];
+}
+
+/**
+ * Closes any streams that are still open.
+ * Invoked before the transaction is committed.
+**/
+- (void)closeBlobStreams
+{
+	if (openBlobStreams == nil) return;
+	
+	NSArray *streams = [openBlobStreams copy];
+	for (id stream in streams)
+	{
+		[stream close];
+	}
+	
+	openBlobStreams = nil;
+}
+
+/**
+ * Releases any streams that are still open (without processing any pending writes).
+ * Invoked before the transaction is rolled back.
+**/
+- (void)invalidateBlobStreams
+{
+	if (openBlobStreams == nil) return;
+	
+	for (id stream in openBlobStreams)
+	{
+		[stream invalidate];
+	}
+	
+	openBlobStreams = nil;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Export
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static NSError *YapDatabaseCollectionArchiveTransactionError(NSString *description)
+{
+	NSDictionary *userInfo = @{ NSLocalizedDescriptionKey: description };
+	return [NSError errorWithDomain:@"YapDatabase" code:0 userInfo:userInfo];
+}
+
+/**
+ * Writes the archive to a temporary file, which is then renamed (so an incomplete archive never exists at path).
+**/
+- (NSError *)exportCollection:(NSString *)collection toPath:(NSString *)path compressed:(BOOL)compressed
+{
+	if (path == nil) return YapDatabaseCollectionArchiveTransactionError(@"No path given");
+	
+	NSString *tmpPath = [path stringByAppendingPathExtension:@"tmp"];
+	
+	NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:tmpPath append:NO];
+	NSError *error = [self exportCollection:collection toStream:stream compressed:compressed];
+	
+	if (error == nil && rename([tmpPath fileSystemRepresentation], [path fileSystemRepresentation]) != 0)
+	{
+		error = YapDatabaseCollectionArchiveTransactionError(
+		  [NSString stringWithFormat:@"Unable to rename: %@ (errno: %d)", path, errno]);
+	}
+	
+	if (error) {
+		unlink([tmpPath fileSystemRepresentation]);
+	}
+	
+	return error;
+}
+
+- (NSError *)exportCollection:(NSString *)collection toStream:(NSOutputStream *)stream compressed:(BOOL)compressed
+{
+	if (stream == nil) return YapDatabaseCollectionArchiveTransactionError(@"No stream given");
+	if (collection == nil) collection = @"";
+	
+	YapDatabase *database = connection->database;
+	
+	YapDatabaseCollectionArchiveWriter *writer =
+	  [[YapDatabaseCollectionArchiveWriter alloc] initWithStream:stream collection:collection compressed:compressed];
+	
+	if (writer.error)
+	{
+		[writer finish];
+		return writer.error;
+	}
+	
+	// SELECT "key", "data", "metadata" FROM "database2" WHERE "collection" = ?;
+	
+	int const column_idx_key      = SQLITE_COLUMN_START + 0;
+	int const column_idx_data     = SQLITE_COLUMN_START + 1;
+	int const column_idx_metadata = SQLITE_COLUMN_START + 2;
+	int const bind_idx_collection = SQLITE_BIND_START;
+	
+	const char *query = "SELECT \"key\", \"data\", \"metadata\" FROM \"database2\" WHERE \"collection\" = ?;";
+	
+	sqlite3_stmt *statement;
+	
+	int status = sqlite3_prepare_v2(connection->db, query, -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating 'exportCollection' statement: %d %s", status, sqlite3_errmsg(connection->db));
+		
+		[writer finish];
+		return YapDatabaseCollectionArchiveTransactionError(
+		  [NSString stringWithFormat:@"Unable to read collection: %s", sqlite3_errmsg(connection->db)]);
+	}
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	NSError *error = nil;
+	BOOL mayHaveHeader =
+	  (database->compressionEnabled || database->externalStorageEnabled || database->coldStorageEnabled);
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		@autoreleasepool {
+			
+			const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+			int textSize = sqlite3_column_bytes(statement, column_idx_key);
+			
+			NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+			
+			// The object is exported in its serialized form.
+			// Compressed (or externally stored) rows are decoded, but not deserialized.
+			
+			const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+			int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+			
+			NSData *oData = nil;
+			if (mayHaveHeader && YapDatabaseCompressionHasHeader(oBlob, (size_t)oBlobSize))
+			{
+				oData = YapDatabaseCopySerializedObject(database, oBlob, oBlobSize);
+				if (oData == nil)
+				{
+					error = YapDatabaseCollectionArchiveTransactionError(
+					  [NSString stringWithFormat:@"Unable to decode row: collection(%@) key(%@)", collection, key]);
+					break;
+				}
+				
+				oBlob = oData.bytes;
+				oBlobSize = (int)oData.length;
+			}
+			
+			// Native metadata is serialized (as with the primitive accessors),
+			// so the archive doesn't depend on the nativeMetadataTypes of the database.
+			
+			const void *mBlob = NULL;
+			int mBlobSize = 0;
+			
+			NSData *mData = nil;
+			int metadataType = sqlite3_column_type(statement, column_idx_metadata);
+			
+			if (metadataType == SQLITE_BLOB)
+			{
+				mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
+				if (mBlobSize > 0) {
+					mBlob = sqlite3_column_blob(statement, column_idx_metadata);
+				}
+			}
+			else if (metadataType != SQLITE_NULL)
+			{
+				mData = YapDatabaseCopySerializedMetadata(database, collection, key, statement, column_idx_metadata);
+				if (mData)
+				{
+					mBlob = mData.bytes;
+					mBlobSize = (int)mData.length;
+				}
+			}
+			
+			if (![writer appendRowWithKey:key
+			                  objectBytes:oBlob
+			                 objectLength:(NSUInteger)oBlobSize
+			                metadataBytes:mBlob
+			               metadataLength:(NSUInteger)mBlobSize])
+			{
+				break;
+			}
+		}
+	}
+	
+	if ((status != SQLITE_DONE) && (status != SQLITE_ROW))
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+		
+		if (error == nil) {
+			error = YapDatabaseCollectionArchiveTransactionError(
+			  [NSString stringWithFormat:@"Unable to read collection: %s", sqlite3_errmsg(connection->db)]);
+		}
+	}
+	
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
+	
+	if (![writer finish] && error == nil) {
+		error = writer.error;
+	}
+	
+	YDBLogVerbose(@"Exported %lu rows from collection(%@)", (unsigned long)writer.rowCount, collection);
+	
+	return error;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Enumerate
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Fast enumeration over all the collections in the database.
+ * 
+ * This uses a "SELECT collection FROM database" operation,
+ * and then steps over the results invoking the given block handler.
+**/
+- (void)enumerateCollectionsUsingBlock:(void (^)(NSString *collection, BOOL *stop))block
+{
+	if (block == NULL) return;
+	
+	BOOL needsFinalize;
+	sqlite3_stmt *statement = [connection enumerateCollectionsStatement:&needsFinalize];
+	if (statement == NULL) return;
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	// SELECT DISTINCT "collection" FROM "database2";
+	
+	int const column_idx_collection = SQLITE_COLUMN_START;
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_collection);
+		int textSize = sqlite3_column_bytes(statement, column_idx_collection);
+		
+		NSString *collection = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		block(collection, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 	}
 	
 	sqlite_enum_reset(statement, needsFinalize);
@@ -1667,6 +2579,10 @@
 {
 	if (block == NULL) return;
 	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordEnumeration:YapDatabaseWorkloadTraceEnumerationKeys inCollection:collection];
+	}
+	
 	[self _enumerateKeysInCollection:collection usingBlock:^(int64_t __unused rowid, NSString *key, BOOL *stop) {
 		
 		block(key, stop);
@@ -1674,334 +2590,555 @@
 }
 
 /**
- * Fast enumeration over all keys in the given collection.
+ * Enumerates the keys in the given collection that begin with the given prefix (in ascending order).
  *
- * This uses a "SELECT collection, key FROM database" operation,
- * and then steps over the results invoking the given block handler.
+ * This uses a "SELECT key FROM database WHERE collection = ? AND key >= ? AND key < ?" operation,
+ * which is executed as a range scan of the (collection, key) index.
 **/
-- (void)enumerateKeysInAllCollectionsUsingBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block
+- (void)enumerateKeysInCollection:(NSString *)collection
+                       withPrefix:(NSString *)prefix
+                       usingBlock:(void (^)(NSString *key, BOOL *stop))block
 {
 	if (block == NULL) return;
 	
-	[self _enumerateKeysInAllCollectionsUsingBlock:^(int64_t __unused rowid, NSString *collection, NSString *key, BOOL *stop) {
-		
-		block(collection, key, stop);
+	NSData *lowerBound = [prefix dataUsingEncoding:NSUTF8StringEncoding];
+	NSData *upperBound = YapDatabaseKeyPrefixUpperBound(prefix);
+	
+	[self _enumerateKeysInCollection:collection
+	                      lowerBound:lowerBound
+	                      upperBound:upperBound
+	                         reverse:NO
+	                           limit:0
+	                      usingBlock:^(int64_t __unused rowid, NSString *key, BOOL *stop)
+	{
+		block(key, stop);
 	}];
 }
 
 /**
- * Fast enumeration over all objects in the database.
- *
- * This uses a "SELECT key, object from database WHERE collection = ?" operation, and then steps over the results,
- * deserializing each object, and then invoking the given block handler.
- *
- * If you only need to enumerate over certain objects (e.g. keys with a particular prefix),
- * consider using the alternative version below which provides a filter,
- * allowing you to skip the serialization step for those objects you're not interested in.
-**/
-- (void)enumerateKeysAndObjectsInCollection:(NSString *)collection
-                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
-{
-	[self enumerateKeysAndObjectsInCollection:collection usingBlock:block withFilter:NULL];
-}
-
-/**
- * Fast enumeration over objects in the database for which you're interested in.
- * The filter block allows you to decide which objects you're interested in.
+ * Enumerates the keys in the given collection whose native metadata matches the given query.
  *
- * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
- * If the filter block returns NO, then the block handler is skipped for the given key,
- * which avoids the cost associated with deserializing the object.
+ * The query is appended to a sub-select of the collection's native metadata rows.
+ * The sub-select repeats the condition of the partial "yap_native_metadata" index, so sqlite can use the index.
 **/
-- (void)enumerateKeysAndObjectsInCollection:(NSString *)collection
-                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
-                                 withFilter:(BOOL (^)(NSString *key))filter
+- (void)enumerateKeysInCollection:(NSString *)collection
+            matchingMetadataQuery:(YapDatabaseQuery *)query
+                       usingBlock:(void (^)(NSString *key, BOOL *stop))block
 {
 	if (block == NULL) return;
+	if (query == nil) return;
+	if (collection == nil) collection = @"";
 	
-	if (filter)
+	if (query.isAggregateQuery)
 	{
-		[self _enumerateKeysAndObjectsInCollection:collection
-		                                usingBlock:^(int64_t __unused rowid, NSString *key, id object, BOOL *stop) {
-			
-			block(key, object, stop);
-			
-		} withFilter:^BOOL(int64_t __unused rowid, NSString *key) {
-			
-			return filter(key);
-		}];
+		YDBLogWarn(@"%@ - Aggregate queries aren't supported", THIS_METHOD);
+		return;
 	}
-	else
+	
+	NSString *nativeRows = connection->database->usesCollectionIds
+	  ? @"SELECT \"key\", \"metadata\" FROM \"database3\" WHERE \"collection_id\" ="
+	    @" (SELECT \"collection_id\" FROM \"collections\" WHERE \"collection\" = ?)"
+	    @" AND typeof(\"metadata\") IN ('integer', 'real', 'text')"
+	  : @"SELECT \"key\", \"metadata\" FROM \"database2\" WHERE \"collection\" = ?"
+	    @" AND typeof(\"metadata\") IN ('integer', 'real', 'text')";
+	
+	NSString *queryString = [NSString stringWithFormat:@"SELECT \"key\" FROM (%@) %@;", nativeRows, query.queryString];
+	
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(connection->db, [queryString UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
 	{
-		[self _enumerateKeysAndObjectsInCollection:collection
-		                                usingBlock:^(int64_t __unused rowid, NSString *key, id object, BOOL *stop) {
-			
-			block(key, object, stop);
-			
-		} withFilter:NULL];
+		YDBLogError(@"%@ - Error preparing query (%@): %d %s",
+		            THIS_METHOD, queryString, status, sqlite3_errmsg(connection->db));
+		return;
+	}
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	int bind_idx = SQLITE_BIND_START + 1;
+	for (id value in query.queryParameters)
+	{
+		if ([value isKindOfClass:[NSNumber class]])
+		{
+			if (CFNumberIsFloatType((__bridge CFNumberRef)value))
+				sqlite3_bind_double(statement, bind_idx, [(NSNumber *)value doubleValue]);
+			else
+				sqlite3_bind_int64(statement, bind_idx, (sqlite3_int64)[(NSNumber *)value longLongValue]);
+		}
+		else if ([value isKindOfClass:[NSDate class]])
+		{
+			sqlite3_bind_double(statement, bind_idx, [(NSDate *)value timeIntervalSinceReferenceDate]);
+		}
+		else if ([value isKindOfClass:[NSString class]])
+		{
+			sqlite3_bind_text(statement, bind_idx, [(NSString *)value UTF8String], -1, SQLITE_TRANSIENT);
+		}
+		else
+		{
+			YDBLogWarn(@"%@ - Unable to bind value with unsupported class: %@",
+			           THIS_METHOD, NSStringFromClass([value class]));
+		}
+		
+		bind_idx++;
+	}
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		const unsigned char *text = sqlite3_column_text(statement, SQLITE_COLUMN_START);
+		int textSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
+		
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		block(key, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
 	}
 }
 
 /**
- * Enumerates all key/object pairs in all collections.
- *
- * The enumeration is sorted by collection. That is, it will enumerate fully over a single collection
- * before moving onto another collection.
- *
- * If you only need to enumerate over certain objects (e.g. subset of collections, or keys with a particular prefix),
- * consider using the alternative version below which provides a filter,
- * allowing you to skip the serialization step for those objects you're not interested in.
-**/
-- (void)enumerateKeysAndObjectsInAllCollectionsUsingBlock:
-                            (void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
-{
-	[self enumerateKeysAndObjectsInAllCollectionsUsingBlock:block withFilter:NULL];
-}
-
-/**
- * Enumerates all key/object pairs in all collections.
- * The filter block allows you to decide which objects you're interested in.
- *
- * The enumeration is sorted by collection. That is, it will enumerate fully over a single collection
- * before moving onto another collection.
+ * Enumerates the keys in the given collection, along with the header of each serialized object.
  *
- * From the filter block, simply return YES if you'd like the block handler to be invoked for the given
- * collection/key pair. If the filter block returns NO, then the block handler is skipped for the given pair,
- * which avoids the cost associated with deserializing the object.
+ * The prefix of each object is read via substr(), so sqlite only copies the first few bytes out of each row.
 **/
-- (void)enumerateKeysAndObjectsInAllCollectionsUsingBlock:
-                            (void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
-                 withFilter:(BOOL (^)(NSString *collection, NSString *key))filter
+- (void)enumerateKeysAndHeadersInCollection:(NSString *)collection
+                                 usingBlock:(void (^)(NSString *key, id header, BOOL *stop))block
 {
 	if (block == NULL) return;
+	if (collection == nil) collection = @"";
 	
-	if (filter)
+	YapDatabase *database = connection->database;
+	
+	YapDatabaseHeaderExtractor extractor = database->objectHeaderExtractor;
+	size_t headerLength = database->objectHeaderLength;
+	
+	// Compressed & externally stored objects start with their own header.
+	// We need enough bytes to detect it.
+	
+	BOOL mayHaveCompressionHeader =
+	  (database->compressionEnabled || database->externalStorageEnabled || database->coldStorageEnabled);
+	size_t prefixLength = headerLength;
+	
+	if (mayHaveCompressionHeader) {
+		prefixLength = MAX(prefixLength, YAP_COMPRESSION_HEADER_SIZE);
+	}
+	
+	NSString *queryString = database->usesCollectionIds
+	  ? @"SELECT \"key\", substr(\"data\", 1, ?), length(\"data\") FROM \"database3\" WHERE \"collection_id\" ="
+	    @" (SELECT \"collection_id\" FROM \"collections\" WHERE \"collection\" = ?);"
+	  : @"SELECT \"key\", substr(\"data\", 1, ?), length(\"data\") FROM \"database2\" WHERE \"collection\" = ?;";
+	
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(connection->db, [queryString UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
 	{
-		[self _enumerateKeysAndObjectsInAllCollectionsUsingBlock:
-		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, BOOL *stop) {
-			
-			block(collection, key, object, stop);
-			
-		} withFilter:^BOOL(int64_t __unused rowid, NSString *collection, NSString *key) {
-			
-			return filter(collection, key);
-		}];
+		YDBLogError(@"%@ - Error preparing query: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+		return;
 	}
-	else
+	
+	int const column_idx_key    = SQLITE_COLUMN_START + 0;
+	int const column_idx_prefix = SQLITE_COLUMN_START + 1;
+	int const column_idx_length = SQLITE_COLUMN_START + 2;
+	int const bind_idx_length     = SQLITE_BIND_START + 0;
+	int const bind_idx_collection = SQLITE_BIND_START + 1;
+	
+	sqlite3_bind_int64(statement, bind_idx_length, (sqlite3_int64)prefixLength);
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
-		[self _enumerateKeysAndObjectsInAllCollectionsUsingBlock:
-		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, BOOL *stop) {
-			
-			block(collection, key, object, stop);
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		const void *bytes = sqlite3_column_blob(statement, column_idx_prefix);
+		size_t length = (size_t)sqlite3_column_bytes(statement, column_idx_prefix);
+		
+		// The header is validated against the length of the whole row (not just the prefix).
+		size_t fullLength = (size_t)sqlite3_column_int64(statement, column_idx_length);
+		
+		__attribute__((objc_precise_lifetime)) NSData *serializedObject = nil;
+		
+		if (mayHaveCompressionHeader && YapDatabaseCompressionHasHeader(bytes, fullLength))
+		{
+			serializedObject = [self serializedObjectForKey:key inCollection:collection];
 			
-		} withFilter:NULL];
+			bytes = serializedObject.bytes;
+			length = serializedObject.length;
+		}
+		
+		length = MIN(length, headerLength);
+		
+		id header = nil;
+		if (extractor)
+			header = extractor(collection, key, bytes, length);
+		else
+			header = [NSData dataWithBytes:bytes length:length];
+		
+		block(key, header, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
 	}
 }
 
 /**
- * Fast enumeration over all keys and associated metadata in the given collection.
- * 
- * This uses a "SELECT key, metadata FROM database WHERE collection = ?" operation and steps over the results.
- * 
- * If you only need to enumerate over certain items (e.g. keys with a particular prefix),
- * consider using the alternative version below which provides a filter,
- * allowing you to skip the deserialization step for those items you're not interested in.
- * 
- * Keep in mind that you cannot modify the collection mid-enumeration (just like any other kind of enumeration).
+ * Enumerates the keys in the given collection within the range [fromKey, toKey).
+ *
+ * @see enumerateKeysAndObjectsInCollection:fromKey:toKey:withOptions:limit:usingBlock:
 **/
-- (void)enumerateKeysAndMetadataInCollection:(NSString *)collection
-                                  usingBlock:(void (^)(NSString *key, id metadata, BOOL *stop))block
+- (void)enumerateKeysInCollection:(NSString *)collection
+                          fromKey:(NSString *)fromKey
+                            toKey:(NSString *)toKey
+                      withOptions:(YapDatabaseEnumerationOptions)options
+                            limit:(NSUInteger)limit
+                       usingBlock:(void (^)(NSString *key, BOOL *stop))block
 {
-	[self enumerateKeysAndMetadataInCollection:collection usingBlock:block withFilter:NULL];
+	if (block == NULL) return;
+	
+	[self _enumerateKeysInCollection:collection
+	                      lowerBound:[fromKey dataUsingEncoding:NSUTF8StringEncoding]
+	                      upperBound:[toKey dataUsingEncoding:NSUTF8StringEncoding]
+	                         reverse:((options & YapDatabaseEnumerationReverse) != 0)
+	                           limit:limit
+	                      usingBlock:^(int64_t __unused rowid, NSString *key, BOOL *stop)
+	{
+		block(key, stop);
+	}];
 }
 
 /**
- * Fast enumeration over all keys and associated metadata in the given collection.
+ * Fast enumeration over all keys in the given collection.
  *
- * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
- * If the filter block returns NO, then the block handler is skipped for the given key,
- * which avoids the cost associated with deserializing the object.
- * 
- * Keep in mind that you cannot modify the collection mid-enumeration (just like any other kind of enumeration).
+ * This uses a "SELECT collection, key FROM database" operation,
+ * and then steps over the results invoking the given block handler.
 **/
-- (void)enumerateKeysAndMetadataInCollection:(NSString *)collection
-                                  usingBlock:(void (^)(NSString *key, id metadata, BOOL *stop))block
-                                  withFilter:(BOOL (^)(NSString *key))filter
+- (void)enumerateKeysInAllCollectionsUsingBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block
 {
 	if (block == NULL) return;
 	
-	if (filter)
-	{
-		[self _enumerateKeysAndMetadataInCollection:collection
-		                                 usingBlock:^(int64_t __unused rowid, NSString *key, id metadata, BOOL *stop) {
-		
-			block(key, metadata, stop);
-			
-		} withFilter:^BOOL(int64_t __unused rowid, NSString *key) {
-			
-			return filter(key);
-		}];
-	}
-	else
-	{
-		[self _enumerateKeysAndMetadataInCollection:collection
-		                                 usingBlock:^(int64_t __unused rowid, NSString *key, id metadata, BOOL *stop) {
+	[self _enumerateKeysInAllCollectionsUsingBlock:^(int64_t __unused rowid, NSString *collection, NSString *key, BOOL *stop) {
 		
-			block(key, metadata, stop);
-			
-		} withFilter:NULL];
-	}
+		block(collection, key, stop);
+	}];
 }
 
 /**
- * Fast enumeration over all key/metadata pairs in all collections.
- * 
- * This uses a "SELECT metadata FROM database ORDER BY collection ASC" operation, and steps over the results.
- * 
+ * Fast enumeration over all objects in the database.
+ *
+ * This uses a "SELECT key, object from database WHERE collection = ?" operation, and then steps over the results,
+ * deserializing each object, and then invoking the given block handler.
+ *
  * If you only need to enumerate over certain objects (e.g. keys with a particular prefix),
  * consider using the alternative version below which provides a filter,
- * allowing you to skip the deserialization step for those objects you're not interested in.
- * 
- * Keep in mind that you cannot modify the database mid-enumeration (just like any other kind of enumeration).
+ * allowing you to skip the serialization step for those objects you're not interested in.
 **/
-- (void)enumerateKeysAndMetadataInAllCollectionsUsingBlock:
-                                        (void (^)(NSString *collection, NSString *key, id metadata, BOOL *stop))block
+- (void)enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
 {
-	[self enumerateKeysAndMetadataInAllCollectionsUsingBlock:block withFilter:NULL];
+	[self enumerateKeysAndObjectsInCollection:collection usingBlock:block withFilter:NULL];
 }
 
 /**
- * Fast enumeration over all key/metadata pairs in all collections.
+ * Fast enumeration over objects in the database for which you're interested in.
+ * The filter block allows you to decide which objects you're interested in.
  *
- * This uses a "SELECT metadata FROM database ORDER BY collection ASC" operation and steps over the results.
- * 
  * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
  * If the filter block returns NO, then the block handler is skipped for the given key,
  * which avoids the cost associated with deserializing the object.
- *
- * Keep in mind that you cannot modify the database mid-enumeration (just like any other kind of enumeration).
- **/
-- (void)enumerateKeysAndMetadataInAllCollectionsUsingBlock:
-                                        (void (^)(NSString *collection, NSString *key, id metadata, BOOL *stop))block
-                             withFilter:(BOOL (^)(NSString *collection, NSString *key))filter
+**/
+- (void)enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
+                                 withFilter:(BOOL (^)(NSString *key))filter
 {
 	if (block == NULL) return;
 	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordEnumeration:YapDatabaseWorkloadTraceEnumerationObjects inCollection:collection];
+	}
+	
 	if (filter)
 	{
-		[self _enumerateKeysAndMetadataInAllCollectionsUsingBlock:
-		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id metadata, BOOL *stop) {
+		[self _enumerateKeysAndObjectsInCollection:collection
+		                                usingBlock:^(int64_t __unused rowid, NSString *key, id object, BOOL *stop) {
 			
-			block(collection, key, metadata, stop);
+			block(key, object, stop);
 			
-		} withFilter:^BOOL(int64_t __unused rowid, NSString *collection, NSString *key) {
+		} withFilter:^BOOL(int64_t __unused rowid, NSString *key) {
 			
-			return filter(collection, key);
+			return filter(key);
 		}];
 	}
 	else
 	{
-		[self _enumerateKeysAndMetadataInAllCollectionsUsingBlock:
-		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id metadata, BOOL *stop) {
+		[self _enumerateKeysAndObjectsInCollection:collection
+		                                usingBlock:^(int64_t __unused rowid, NSString *key, id object, BOOL *stop) {
 			
-			block(collection, key, metadata, stop);
+			block(key, object, stop);
 			
 		} withFilter:NULL];
 	}
 }
 
 /**
- * Fast enumeration over all rows in the database.
- *
- * This uses a "SELECT key, data, metadata from database WHERE collection = ?" operation,
- * and then steps over the results, deserializing each object & metadata, and then invoking the given block handler.
- *
- * If you only need to enumerate over certain rows (e.g. keys with a particular prefix),
- * consider using the alternative version below which provides a filter,
- * allowing you to skip the serialization step for those rows you're not interested in.
+ * Same as above, but allows you to opt in to concurrent deserialization.
+ * 
+ * @see YapDatabaseEnumerationOptions
 **/
-- (void)enumerateRowsInCollection:(NSString *)collection
-                       usingBlock:(void (^)(NSString *key, id object, id metadata, BOOL *stop))block
-{
-	[self enumerateRowsInCollection:collection usingBlock:block withFilter:NULL];
-}
-
-/**
- * Fast enumeration over rows in the database for which you're interested in.
- * The filter block allows you to decide which rows you're interested in.
- *
- * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
- * If the filter block returns NO, then the block handler is skipped for the given key,
- * which avoids the cost associated with deserializing the object & metadata.
-**/
-- (void)enumerateRowsInCollection:(NSString *)collection
-                       usingBlock:(void (^)(NSString *key, id object, id metadata, BOOL *stop))block
-                       withFilter:(BOOL (^)(NSString *key))filter
+- (void)enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                withOptions:(YapDatabaseEnumerationOptions)options
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
+                                 withFilter:(BOOL (^)(NSString *key))filter
 {
 	if (block == NULL) return;
 	
+	if ((options & YapDatabaseEnumerationConcurrentDeserialization) == 0)
+	{
+		[self enumerateKeysAndObjectsInCollection:collection usingBlock:block withFilter:filter];
+		return;
+	}
+	
+	BOOL unordered = (options & YapDatabaseEnumerationUnordered) != 0;
+	
+	BOOL (^_filter)(int64_t rowid, NSString *key) = NULL;
 	if (filter)
 	{
-		[self _enumerateRowsInCollection:collection
-		                      usingBlock:^(int64_t __unused rowid, NSString *key, id object, id metadata, BOOL *stop) {
-			
-			block(key, object, metadata, stop);
-			
-		} withFilter:^BOOL(int64_t __unused rowid, NSString *key) {
+		_filter = ^BOOL(int64_t __unused rowid, NSString *key) {
 			
 			return filter(key);
+		};
+	}
+	
+	[self _concurrentlyEnumerateRowsInCollection:collection
+	                             includeMetadata:NO
+	                                   unordered:unordered
+	                                  usingBlock:^(int64_t __unused rowid, NSString *key, id object, id __unused metadata, BOOL *stop) {
+		
+		block(key, object, stop);
+		
+	} withFilter:_filter];
+}
+
+/**
+ * Enumerates the objects in the given collection whose keys begin with the given prefix (in ascending order).
+ *
+ * This uses a "SELECT key, object FROM database WHERE collection = ? AND key >= ? AND key < ?" operation,
+ * which is executed as a range scan of the (collection, key) index.
+**/
+- (void)enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                 withPrefix:(NSString *)prefix
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
+{
+	if (block == NULL) return;
+	
+	NSData *lowerBound = [prefix dataUsingEncoding:NSUTF8StringEncoding];
+	NSData *upperBound = YapDatabaseKeyPrefixUpperBound(prefix);
+	
+	[self _enumerateKeysAndObjectsInCollection:collection
+	                                lowerBound:lowerBound
+	                                upperBound:upperBound
+	                                   reverse:NO
+	                                     limit:0
+	                                usingBlock:^(int64_t __unused rowid, NSString *key, id object, BOOL *stop)
+	{
+		block(key, object, stop);
+	}];
+}
+
+/**
+ * Enumerates the objects in the given collection whose keys are within the range [fromKey, toKey).
+ *
+ * This uses a "SELECT key, object FROM database WHERE collection = ? AND key >= ? AND key < ? ORDER BY key LIMIT ?"
+ * operation, which is executed as a range scan of the (collection, key) index.
+**/
+- (void)enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                    fromKey:(NSString *)fromKey
+                                      toKey:(NSString *)toKey
+                                withOptions:(YapDatabaseEnumerationOptions)options
+                                      limit:(NSUInteger)limit
+                                 usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
+{
+	if (block == NULL) return;
+	
+	[self _enumerateKeysAndObjectsInCollection:collection
+	                                lowerBound:[fromKey dataUsingEncoding:NSUTF8StringEncoding]
+	                                upperBound:[toKey dataUsingEncoding:NSUTF8StringEncoding]
+	                                   reverse:((options & YapDatabaseEnumerationReverse) != 0)
+	                                     limit:limit
+	                                usingBlock:^(int64_t __unused rowid, NSString *key, id object, BOOL *stop)
+	{
+		block(key, object, stop);
+	}];
+}
+
+/**
+ * Enumerates the next page of rows for the given cursor, and advances the cursor past them.
+ *
+ * For rowid ordered cursors, this uses a "SELECT rowid, key, object FROM database WHERE collection = ? AND rowid > ?"
+ * operation, and for key ordered cursors, a range scan of the (collection, key) index.
+ * Either way, resuming the cursor is a seek (and not a scan of the rows before it).
+**/
+- (NSUInteger)enumerateKeysAndObjectsWithCursor:(YapDatabaseCursor *)cursor
+                                          limit:(NSUInteger)limit
+                                     usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
+{
+	if (cursor == nil) return 0;
+	if (block == NULL) return 0;
+	
+	__block NSUInteger count = 0;
+	__block BOOL stopped = NO;
+	
+	if (cursor.order == YapDatabaseCursorOrderKey)
+	{
+		// The smallest key that's greater than lastKey is lastKey with a NUL byte appended.
+		
+		NSMutableData *lowerBound = nil;
+		if (cursor->lastKey)
+		{
+			uint8_t nul = 0;
+			lowerBound = [[cursor->lastKey dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+			[lowerBound appendBytes:&nul length:1];
+		}
+		
+		[self _enumerateKeysAndObjectsInCollection:cursor.collection
+		                                lowerBound:lowerBound
+		                                upperBound:nil
+		                                   reverse:NO
+		                                     limit:limit
+		                                usingBlock:^(int64_t rowid, NSString *key, id object, BOOL *stop)
+		{
+			cursor->lastRowid = rowid;
+			cursor->lastKey = key;
+			count++;
+			
+			block(key, object, stop);
+			stopped = *stop;
 		}];
 	}
 	else
 	{
-		[self _enumerateRowsInCollection:collection
-		                      usingBlock:^(int64_t __unused rowid, NSString *key, id object, id metadata, BOOL *stop) {
-			
-			block(key, object, metadata, stop);
+		[self _enumerateKeysAndObjectsInCollection:cursor.collection
+		                                afterRowid:cursor->lastRowid
+		                                     limit:limit
+		                                usingBlock:^(int64_t rowid, NSString *key, id object, BOOL *stop)
+		{
+			cursor->lastRowid = rowid;
+			cursor->lastKey = key;
+			count++;
 			
-		} withFilter:NULL];
+			block(key, object, stop);
+			stopped = *stop;
+		}];
 	}
+	
+	cursor->isExhausted = !stopped && ((limit == 0) || (count < limit));
+	return count;
 }
 
 /**
- * Enumerates all rows in all collections.
- * 
+ * Enumerates the objects in the given collection, handing the block a proxy for each object.
+ *
+ * This uses a "SELECT rowid, key FROM database WHERE collection = ?" operation,
+ * so the object column isn't read unless the block accesses the proxy.
+ * And then it's fetched via objectForCollectionKey:withRowid: (which checks & fills the cache).
+**/
+- (void)enumerateKeysAndProxyObjectsInCollection:(NSString *)collection
+                                      usingBlock:(void (^)(NSString *key, YapProxyObject *object, BOOL *stop))block
+{
+	if (block == NULL) return;
+	if (collection == nil) collection = @"";
+	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordEnumeration:YapDatabaseWorkloadTraceEnumerationObjects inCollection:collection];
+	}
+	
+	YapProxyObject *proxyObject = [[YapProxyObject alloc] init];
+	
+	[self _enumerateKeysInCollection:collection usingBlock:^(int64_t rowid, NSString *key, BOOL *stop) {
+		
+		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		[proxyObject resetWithRowid:rowid collectionKey:ck isMetadata:NO transaction:self];
+		
+		block(key, proxyObject, stop);
+	}];
+	
+	[proxyObject reset];
+}
+
+/**
+ * Enumerates all key/object pairs in all collections.
+ *
  * The enumeration is sorted by collection. That is, it will enumerate fully over a single collection
  * before moving onto another collection.
- * 
- * If you only need to enumerate over certain rows (e.g. subset of collections, or keys with a particular prefix),
+ *
+ * If you only need to enumerate over certain objects (e.g. subset of collections, or keys with a particular prefix),
  * consider using the alternative version below which provides a filter,
  * allowing you to skip the serialization step for those objects you're not interested in.
 **/
-- (void)enumerateRowsInAllCollectionsUsingBlock:
-                            (void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+- (void)enumerateKeysAndObjectsInAllCollectionsUsingBlock:
+                            (void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
 {
-	[self enumerateRowsInAllCollectionsUsingBlock:block withFilter:NULL];
+	[self enumerateKeysAndObjectsInAllCollectionsUsingBlock:block withFilter:NULL];
 }
 
 /**
- * Enumerates all rows in all collections.
+ * Enumerates all key/object pairs in all collections.
  * The filter block allows you to decide which objects you're interested in.
  *
  * The enumeration is sorted by collection. That is, it will enumerate fully over a single collection
  * before moving onto another collection.
- * 
+ *
  * From the filter block, simply return YES if you'd like the block handler to be invoked for the given
  * collection/key pair. If the filter block returns NO, then the block handler is skipped for the given pair,
  * which avoids the cost associated with deserializing the object.
 **/
-- (void)enumerateRowsInAllCollectionsUsingBlock:
-                            (void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+- (void)enumerateKeysAndObjectsInAllCollectionsUsingBlock:
+                            (void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
                  withFilter:(BOOL (^)(NSString *collection, NSString *key))filter
 {
 	if (block == NULL) return;
 	
 	if (filter)
 	{
-		[self _enumerateRowsInAllCollectionsUsingBlock:
-		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop) {
+		[self _enumerateKeysAndObjectsInAllCollectionsUsingBlock:
+		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, BOOL *stop) {
 			
-			block(collection, key, object, metadata, stop);
+			block(collection, key, object, stop);
 			
 		} withFilter:^BOOL(int64_t __unused rowid, NSString *collection, NSString *key) {
 			
@@ -2010,222 +3147,316 @@
 	}
 	else
 	{
-		[self _enumerateRowsInAllCollectionsUsingBlock:
-		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop) {
+		[self _enumerateKeysAndObjectsInAllCollectionsUsingBlock:
+		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, BOOL *stop) {
 			
-			block(collection, key, object, metadata, stop);
+			block(collection, key, object, stop);
 			
 		} withFilter:NULL];
 	}
 }
 
 /**
- * Enumerates over the given list of keys (unordered).
- *
- * This method is faster than fetching individual items as it optimizes cache access.
- * That is, it will first enumerate over items in the cache and then fetch items from the database,
- * thus optimizing the cache and reducing query size.
- *
- * If any keys are missing from the database, the 'object' parameter will be nil.
+ * Fast enumeration over all keys and associated metadata in the given collection.
+ * 
+ * This uses a "SELECT key, metadata FROM database WHERE collection = ?" operation and steps over the results.
+ * 
+ * If you only need to enumerate over certain items (e.g. keys with a particular prefix),
+ * consider using the alternative version below which provides a filter,
+ * allowing you to skip the deserialization step for those items you're not interested in.
+ * 
+ * Keep in mind that you cannot modify the collection mid-enumeration (just like any other kind of enumeration).
+**/
+- (void)enumerateKeysAndMetadataInCollection:(NSString *)collection
+                                  usingBlock:(void (^)(NSString *key, id metadata, BOOL *stop))block
+{
+	[self enumerateKeysAndMetadataInCollection:collection usingBlock:block withFilter:NULL];
+}
+
+/**
+ * Fast enumeration over all keys and associated metadata in the given collection.
  *
- * IMPORTANT:
- * Due to cache optimizations, the items may not be enumerated in the same order as the 'keys' parameter.
+ * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
+ * If the filter block returns NO, then the block handler is skipped for the given key,
+ * which avoids the cost associated with deserializing the object.
+ * 
+ * Keep in mind that you cannot modify the collection mid-enumeration (just like any other kind of enumeration).
 **/
-- (void)enumerateObjectsForKeys:(NSArray *)keys
-                   inCollection:(NSString *)collection
-            unorderedUsingBlock:(void (^)(NSUInteger keyIndex, id object, BOOL *stop))block
+- (void)enumerateKeysAndMetadataInCollection:(NSString *)collection
+                                  usingBlock:(void (^)(NSString *key, id metadata, BOOL *stop))block
+                                  withFilter:(BOOL (^)(NSString *key))filter
 {
 	if (block == NULL) return;
-	if ([keys count] == 0) return;
-	if (collection == nil) collection = @"";
-	
-	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
-	BOOL stop = NO;
-	
-	// Check the cache first (to optimize cache)
 	
-	NSMutableArray *missingIndexes = [NSMutableArray arrayWithCapacity:[keys count]];
-	NSUInteger keyIndex = 0;
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordEnumeration:YapDatabaseWorkloadTraceEnumerationMetadata inCollection:collection];
+	}
 	
-	for (NSString *key in keys)
+	if (filter)
 	{
-		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		[self _enumerateKeysAndMetadataInCollection:collection
+		                                 usingBlock:^(int64_t __unused rowid, NSString *key, id metadata, BOOL *stop) {
 		
-		id object = [connection->objectCache objectForKey:cacheKey];
-		if (object)
-		{
-			block(keyIndex, object, &stop);
+			block(key, metadata, stop);
 			
-			if (stop || mutation.isMutated) break;
-		}
-		else
-		{
-			[missingIndexes addObject:@(keyIndex)];
-		}
+		} withFilter:^BOOL(int64_t __unused rowid, NSString *key) {
+			
+			return filter(key);
+		}];
+	}
+	else
+	{
+		[self _enumerateKeysAndMetadataInCollection:collection
+		                                 usingBlock:^(int64_t __unused rowid, NSString *key, id metadata, BOOL *stop) {
 		
-		keyIndex++;
+			block(key, metadata, stop);
+			
+		} withFilter:NULL];
 	}
+}
+
+/**
+ * Fast enumeration over all key/metadata pairs in all collections.
+ * 
+ * This uses a "SELECT metadata FROM database ORDER BY collection ASC" operation, and steps over the results.
+ * 
+ * If you only need to enumerate over certain objects (e.g. keys with a particular prefix),
+ * consider using the alternative version below which provides a filter,
+ * allowing you to skip the deserialization step for those objects you're not interested in.
+ * 
+ * Keep in mind that you cannot modify the database mid-enumeration (just like any other kind of enumeration).
+**/
+- (void)enumerateKeysAndMetadataInAllCollectionsUsingBlock:
+                                        (void (^)(NSString *collection, NSString *key, id metadata, BOOL *stop))block
+{
+	[self enumerateKeysAndMetadataInAllCollectionsUsingBlock:block withFilter:NULL];
+}
+
+/**
+ * Fast enumeration over all key/metadata pairs in all collections.
+ *
+ * This uses a "SELECT metadata FROM database ORDER BY collection ASC" operation and steps over the results.
+ * 
+ * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
+ * If the filter block returns NO, then the block handler is skipped for the given key,
+ * which avoids the cost associated with deserializing the object.
+ *
+ * Keep in mind that you cannot modify the database mid-enumeration (just like any other kind of enumeration).
+ **/
+- (void)enumerateKeysAndMetadataInAllCollectionsUsingBlock:
+                                        (void (^)(NSString *collection, NSString *key, id metadata, BOOL *stop))block
+                             withFilter:(BOOL (^)(NSString *collection, NSString *key))filter
+{
+	if (block == NULL) return;
 	
-	if (stop) {
-		return;
-	}
-	if (mutation.isMutated) {
-		@throw [self mutationDuringEnumerationException];
-		return;
+	if (filter)
+	{
+		[self _enumerateKeysAndMetadataInAllCollectionsUsingBlock:
+		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id metadata, BOOL *stop) {
+			
+			block(collection, key, metadata, stop);
+			
+		} withFilter:^BOOL(int64_t __unused rowid, NSString *collection, NSString *key) {
+			
+			return filter(collection, key);
+		}];
 	}
-	if ([missingIndexes count] == 0) {
-		return;
+	else
+	{
+		[self _enumerateKeysAndMetadataInAllCollectionsUsingBlock:
+		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id metadata, BOOL *stop) {
+			
+			block(collection, key, metadata, stop);
+			
+		} withFilter:NULL];
 	}
+}
+
+/**
+ * Fast enumeration over all rows in the database.
+ *
+ * This uses a "SELECT key, data, metadata from database WHERE collection = ?" operation,
+ * and then steps over the results, deserializing each object & metadata, and then invoking the given block handler.
+ *
+ * If you only need to enumerate over certain rows (e.g. keys with a particular prefix),
+ * consider using the alternative version below which provides a filter,
+ * allowing you to skip the serialization step for those rows you're not interested in.
+**/
+- (void)enumerateRowsInCollection:(NSString *)collection
+                       usingBlock:(void (^)(NSString *key, id object, id metadata, BOOL *stop))block
+{
+	[self enumerateRowsInCollection:collection usingBlock:block withFilter:NULL];
+}
+
+/**
+ * Fast enumeration over rows in the database for which you're interested in.
+ * The filter block allows you to decide which rows you're interested in.
+ *
+ * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
+ * If the filter block returns NO, then the block handler is skipped for the given key,
+ * which avoids the cost associated with deserializing the object & metadata.
+**/
+- (void)enumerateRowsInCollection:(NSString *)collection
+                       usingBlock:(void (^)(NSString *key, id object, id metadata, BOOL *stop))block
+                       withFilter:(BOOL (^)(NSString *key))filter
+{
+	if (block == NULL) return;
 	
-	// Go to database for any missing keys (if needed)
-	
-	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
-	
-	NSMutableDictionary *keyIndexDict = nil;
-	
-	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
-	// We need to watch out for this in case a large array of keys is passed.
-	
-	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordEnumeration:YapDatabaseWorkloadTraceEnumerationRows inCollection:collection];
+	}
 	
-	do
+	if (filter)
 	{
-		// Determine how many parameters to use in the query
-		
-		NSUInteger numKeyParams = MIN([missingIndexes count], (maxHostParams-1)); // minus 1 for collection param
-		
-		// Create the SQL query:
-		//
-		// SELECT "key", "data" FROM "database2" WHERE "collection" = ? AND key IN (?, ?, ...);
-		
-		int const column_idx_key  = SQLITE_COLUMN_START + 0;
-		int const column_idx_data = SQLITE_COLUMN_START + 1;
-		
-		NSUInteger capacity = 80 + (numKeyParams * 3);
-		NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
-		
-		[query appendString:@"SELECT \"key\", \"data\" FROM \"database2\""];
-		[query appendString:@" WHERE \"collection\" = ? AND \"key\" IN ("];
-		
-		NSUInteger i;
-		for (i = 0; i < numKeyParams; i++)
-		{
-			if (i == 0)
-				[query appendString:@"?"];
-			else
-				[query appendString:@", ?"];
-		}
-		
-		[query appendString:@");"];
-		
-		sqlite3_stmt *statement;
-		
-		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating 'objectsForKeys' statement: %d %s",
-						status, sqlite3_errmsg(connection->db));
-			break; // Break from do/while. Still need to free _collection.
-		}
-		
-		// Bind parameters.
-		// And move objects from the missingIndexes array into keyIndexDict.
-		
-		if (keyIndexDict == nil)
-			keyIndexDict = [NSMutableDictionary dictionaryWithCapacity:numKeyParams];
-		else
-			[keyIndexDict removeAllObjects];
-		
-		sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
-		
-		for (i = 0; i < numKeyParams; i++)
-		{
-			NSNumber *keyIndexNumber = [missingIndexes objectAtIndex:i];
-			NSString *key = [keys objectAtIndex:[keyIndexNumber unsignedIntegerValue]];
-			
-			[keyIndexDict setObject:keyIndexNumber forKey:key];
-			
-			sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + 1 + i), [key UTF8String], -1, SQLITE_TRANSIENT);
-		}
-		
-		[missingIndexes removeObjectsInRange:NSMakeRange(0, numKeyParams)];
-		
-		// Execute the query and step over the results
-		
-		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
-		{
-			const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
-			int textSize = sqlite3_column_bytes(statement, column_idx_key);
-			
-			NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
-			keyIndex = [[keyIndexDict objectForKey:key] unsignedIntegerValue];
-			
-			// Note: We already checked the cache (above),
-			// so we already know this item is not in the cache.
+		[self _enumerateRowsInCollection:collection
+		                      usingBlock:^(int64_t __unused rowid, NSString *key, id object, id metadata, BOOL *stop) {
 			
-			const void *blob = sqlite3_column_blob(statement, column_idx_data);
-			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
+			block(key, object, metadata, stop);
 			
-			NSData *objectData = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			id object = connection->database->objectDeserializer(collection, key, objectData);
+		} withFilter:^BOOL(int64_t __unused rowid, NSString *key) {
 			
-			if (object)
-			{
-				YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-				[connection->objectCache setObject:object forKey:cacheKey];
-			}
+			return filter(key);
+		}];
+	}
+	else
+	{
+		[self _enumerateRowsInCollection:collection
+		                      usingBlock:^(int64_t __unused rowid, NSString *key, id object, id metadata, BOOL *stop) {
 			
-			block(keyIndex, object, &stop);
+			block(key, object, metadata, stop);
 			
-			[keyIndexDict removeObjectForKey:key];
+		} withFilter:NULL];
+	}
+}
+
+/**
+ * Same as above, but allows you to opt in to concurrent deserialization.
+ * 
+ * @see YapDatabaseEnumerationOptions
+**/
+- (void)enumerateRowsInCollection:(NSString *)collection
+                      withOptions:(YapDatabaseEnumerationOptions)options
+                       usingBlock:(void (^)(NSString *key, id object, id metadata, BOOL *stop))block
+                       withFilter:(BOOL (^)(NSString *key))filter
+{
+	if (block == NULL) return;
+	
+	if ((options & YapDatabaseEnumerationConcurrentDeserialization) == 0)
+	{
+		[self enumerateRowsInCollection:collection usingBlock:block withFilter:filter];
+		return;
+	}
+	
+	BOOL unordered = (options & YapDatabaseEnumerationUnordered) != 0;
+	
+	BOOL (^_filter)(int64_t rowid, NSString *key) = NULL;
+	if (filter)
+	{
+		_filter = ^BOOL(int64_t __unused rowid, NSString *key) {
 			
-			if (stop || mutation.isMutated) break;
-		}
+			return filter(key);
+		};
+	}
+	
+	[self _concurrentlyEnumerateRowsInCollection:collection
+	                             includeMetadata:YES
+	                                   unordered:unordered
+	                                  usingBlock:^(int64_t __unused rowid, NSString *key, id object, id metadata, BOOL *stop) {
 		
-		if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
-		{
-			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
-		}
+		block(key, object, metadata, stop);
 		
-		sqlite3_finalize(statement);
-		statement = NULL;
+	} withFilter:_filter];
+}
+
+/**
+ * Enumerates the rows in the given collection, handing the block a proxy for each object & metadata.
+ *
+ * @see enumerateKeysAndProxyObjectsInCollection:usingBlock:
+**/
+- (void)enumerateRowsWithProxiesInCollection:(NSString *)collection
+                                  usingBlock:(void (^)(NSString *key,
+                                                       YapProxyObject *object,
+                                                       YapProxyObject *metadata,
+                                                       BOOL *stop))block
+{
+	if (block == NULL) return;
+	if (collection == nil) collection = @"";
+	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordEnumeration:YapDatabaseWorkloadTraceEnumerationRows inCollection:collection];
+	}
+	
+	YapProxyObject *proxyObject = [[YapProxyObject alloc] init];
+	YapProxyObject *proxyMetadata = [[YapProxyObject alloc] init];
+	
+	[self _enumerateKeysInCollection:collection usingBlock:^(int64_t rowid, NSString *key, BOOL *stop) {
 		
-		if (stop) {
-			FreeYapDatabaseString(&_collection);
-			return;
-		}
-		if (mutation.isMutated) {
-			FreeYapDatabaseString(&_collection);
-			@throw [self mutationDuringEnumerationException];
-			return;
-		}
+		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 		
-		// If there are any remaining items in the keyIndexDict,
-		// then those items didn't exist in the database.
+		[proxyObject resetWithRowid:rowid collectionKey:ck isMetadata:NO transaction:self];
+		[proxyMetadata resetWithRowid:rowid collectionKey:ck isMetadata:YES transaction:self];
 		
-		for (NSNumber *keyIndexNumber in [keyIndexDict objectEnumerator])
-		{
-			block([keyIndexNumber unsignedIntegerValue], nil, &stop);
+		block(key, proxyObject, proxyMetadata, stop);
+	}];
+	
+	[proxyObject reset];
+	[proxyMetadata reset];
+}
+
+/**
+ * Enumerates all rows in all collections.
+ * 
+ * The enumeration is sorted by collection. That is, it will enumerate fully over a single collection
+ * before moving onto another collection.
+ * 
+ * If you only need to enumerate over certain rows (e.g. subset of collections, or keys with a particular prefix),
+ * consider using the alternative version below which provides a filter,
+ * allowing you to skip the serialization step for those objects you're not interested in.
+**/
+- (void)enumerateRowsInAllCollectionsUsingBlock:
+                            (void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+{
+	[self enumerateRowsInAllCollectionsUsingBlock:block withFilter:NULL];
+}
+
+/**
+ * Enumerates all rows in all collections.
+ * The filter block allows you to decide which objects you're interested in.
+ *
+ * The enumeration is sorted by collection. That is, it will enumerate fully over a single collection
+ * before moving onto another collection.
+ * 
+ * From the filter block, simply return YES if you'd like the block handler to be invoked for the given
+ * collection/key pair. If the filter block returns NO, then the block handler is skipped for the given pair,
+ * which avoids the cost associated with deserializing the object.
+**/
+- (void)enumerateRowsInAllCollectionsUsingBlock:
+                            (void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+                 withFilter:(BOOL (^)(NSString *collection, NSString *key))filter
+{
+	if (block == NULL) return;
+	
+	if (filter)
+	{
+		[self _enumerateRowsInAllCollectionsUsingBlock:
+		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop) {
 			
-			// Do NOT add keys to the cache that don't exist in the database.
+			block(collection, key, object, metadata, stop);
 			
-			if (stop || mutation.isMutated) break;
-		}
-		
-		if (stop) {
-			FreeYapDatabaseString(&_collection);
-			return;
-		}
-		if (mutation.isMutated) {
-			FreeYapDatabaseString(&_collection);
-			@throw [self mutationDuringEnumerationException];
-			return;
-		}
-		
-		
-	} while ([missingIndexes count] > 0);
-	
-	FreeYapDatabaseString(&_collection);
+		} withFilter:^BOOL(int64_t __unused rowid, NSString *collection, NSString *key) {
+			
+			return filter(collection, key);
+		}];
+	}
+	else
+	{
+		[self _enumerateRowsInAllCollectionsUsingBlock:
+		    ^(int64_t __unused rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop) {
+			
+			block(collection, key, object, metadata, stop);
+			
+		} withFilter:NULL];
+	}
 }
 
 /**
@@ -2235,160 +3466,245 @@
  * That is, it will first enumerate over items in the cache and then fetch items from the database,
  * thus optimizing the cache and reducing query size.
  *
- * If any keys are missing from the database, the 'metadata' parameter will be nil.
+ * If any keys are missing from the database, the 'object' parameter will be nil.
  *
  * IMPORTANT:
  * Due to cache optimizations, the items may not be enumerated in the same order as the 'keys' parameter.
 **/
-- (void)enumerateMetadataForKeys:(NSArray *)keys
+- (void)enumerateObjectsForKeys:(NSArray *)keys
+                   inCollection:(NSString *)collection
+            unorderedUsingBlock:(void (^)(NSUInteger keyIndex, id object, BOOL *stop))block
+{
+	if (block == NULL) return;
+	
+	[self _enumerateRowsForKeys:keys
+	               inCollection:collection
+	                withObjects:YES
+	                   metadata:NO
+	        unorderedUsingBlock:^(NSUInteger keyIndex, id object, id __unused metadata, BOOL *stop)
+	{
+		block(keyIndex, object, stop);
+	}];
+}
+
+/**
+ * Enumerates over the given list of keys (unordered).
+ *
+ * This method is faster than fetching individual items as it optimizes cache access.
+ * That is, it will first enumerate over items in the cache and then fetch items from the database,
+ * thus optimizing the cache and reducing query size.
+ *
+ * If any keys are missing from the database, the 'metadata' parameter will be nil.
+ *
+ * IMPORTANT:
+ * Due to cache optimizations, the items may not be enumerated in the same order as the 'keys' parameter.
+**/
+- (void)enumerateMetadataForKeys:(NSArray *)keys
                     inCollection:(NSString *)collection
              unorderedUsingBlock:(void (^)(NSUInteger keyIndex, id metadata, BOOL *stop))block
 {
 	if (block == NULL) return;
-	if ([keys count] == 0) return;
+	
+	[self _enumerateRowsForKeys:keys
+	               inCollection:collection
+	                withObjects:NO
+	                   metadata:YES
+	        unorderedUsingBlock:^(NSUInteger keyIndex, id __unused object, id metadata, BOOL *stop)
+	{
+		block(keyIndex, metadata, stop);
+	}];
+}
+
+/**
+ * Enumerates over the given list of keys (unordered).
+ *
+ * This method is faster than fetching individual items as it optimizes cache access.
+ * That is, it will first enumerate over items in the cache and then fetch items from the database,
+ * thus optimizing the cache and reducing query size.
+ *
+ * If any keys are missing from the database, the 'object' and 'metadata' parameter will be nil.
+ *
+ * IMPORTANT:
+ * Due to cache optimizations, the items may not be enumerated in the same order as the 'keys' parameter.
+**/
+- (void)enumerateRowsForKeys:(NSArray *)keys
+                inCollection:(NSString *)collection
+         unorderedUsingBlock:(void (^)(NSUInteger keyIndex, id object, id metadata, BOOL *stop))block
+{
+	if (block == NULL) return;
+	
+	[self _enumerateRowsForKeys:keys
+	               inCollection:collection
+	                withObjects:YES
+	                   metadata:YES
+	        unorderedUsingBlock:block];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Internal Enumerate (using rowid)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Fast enumeration over all keys in the given collection.
+ *
+ * This uses a "SELECT key FROM database WHERE collection = ?" operation,
+ * and then steps over the results invoking the given block handler.
+**/
+- (void)_enumerateKeysInCollection:(NSString *)collection
+                        usingBlock:(void (^)(int64_t rowid, NSString *key, BOOL *stop))block
+{
+	if (block == NULL) return;
 	if (collection == nil) collection = @"";
 	
+	BOOL needsFinalize;
+	sqlite3_stmt *statement = [connection enumerateKeysInCollectionStatement:&needsFinalize];
+	if (statement == NULL) return;
+	
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
 	BOOL stop = NO;
 	
-	// Check the cache first (to optimize cache)
+	// SELECT "rowid", "key" FROM "database2" WHERE collection = ?;
 	
-	NSMutableArray *missingIndexes = [NSMutableArray arrayWithCapacity:[keys count]];
-	NSUInteger keyIndex = 0;
+	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+	int const column_idx_key      = SQLITE_COLUMN_START + 1;
+	int const bind_idx_collection = SQLITE_BIND_START;
 	
-	for (NSString *key in keys)
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
-		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
-		id metadata = [connection->metadataCache objectForKey:cacheKey];
-		if (metadata)
-		{
-			if (metadata == [YapNull null])
-				block(keyIndex, nil, &stop);
-			else
-				block(keyIndex, metadata, &stop);
-			
-			if (stop || mutation.isMutated) break;
-		}
-		else
-		{
-			[missingIndexes addObject:@(keyIndex)];
-		}
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
 		
-		keyIndex++;
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		block(rowid, key, &stop);
+		
+		if (stop || mutation.isMutated) break;
 	}
 	
-	if (stop) {
-		return;
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 	}
-	if (mutation.isMutated) {
+	
+	sqlite_enum_reset(statement, needsFinalize);
+	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
 		@throw [self mutationDuringEnumerationException];
-		return;
-	}
-	if ([missingIndexes count] == 0) {
-		return;
 	}
+}
+
+/**
+ * Enumerates the keys in the given collection within the range [lowerBound, upperBound).
+ * Either bound may be nil (unbounded). A limit of zero means no limit.
+**/
+- (void)_enumerateKeysInCollection:(NSString *)collection
+                        lowerBound:(NSData *)lowerBound
+                        upperBound:(NSData *)upperBound
+                           reverse:(BOOL)reverse
+                             limit:(NSUInteger)limit
+                        usingBlock:(void (^)(int64_t rowid, NSString *key, BOOL *stop))block
+{
+	if (block == NULL) return;
+	if (collection == nil) collection = @"";
 	
-	// Go to database for any missing keys (if needed)
+	BOOL needsFinalize;
+	sqlite3_stmt *statement = [connection enumerateKeysInRangeStatement:&needsFinalize reverse:reverse];
+	if (statement == NULL) return;
 	
-	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
 	
-	NSMutableDictionary *keyIndexDict = nil;
+	// SELECT "rowid", "key" FROM "database2"
+	//  WHERE "collection" = ? AND "key" >= ? AND "key" < ? ORDER BY "key" ASC|DESC LIMIT ?;
 	
-	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
-	// We need to watch out for this in case a large array of keys is passed.
+	int const column_idx_rowid     = SQLITE_COLUMN_START + 0;
+	int const column_idx_key       = SQLITE_COLUMN_START + 1;
+	int const bind_idx_collection  = SQLITE_BIND_START + 0;
+	int const bind_idx_lowerBound  = SQLITE_BIND_START + 1;
 	
-	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 	
-	do
+	YapDatabaseBindKeyRange(statement, bind_idx_lowerBound, lowerBound, upperBound, limit);
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
-		// Determine how many parameters to use in the query
-		
-		NSUInteger numKeyParams = MIN([missingIndexes count], (maxHostParams-1)); // minus 1 for collection param
-		
-		// Create the SQL query:
-		//
-		// SELECT "key", "metadata" FROM "database2" WHERE "collection" = ? AND key IN (?, ?, ...);
-		
-		int const column_idx_key      = SQLITE_COLUMN_START + 0;
-		int const column_idx_metadata = SQLITE_COLUMN_START + 1;
-		
-		NSUInteger capacity = 80 + (numKeyParams * 3);
-		NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
-		
-		[query appendString:@"SELECT \"key\", \"metadata\" FROM \"database2\""];
-		[query appendString:@" WHERE \"collection\" = ? AND \"key\" IN ("];
-		
-		NSUInteger i;
-		for (i = 0; i < numKeyParams; i++)
-		{
-			if (i == 0)
-				[query appendString:@"?"];
-			else
-				[query appendString:@", ?"];
-		}
-		
-		[query appendString:@");"];
-		
-		sqlite3_stmt *statement;
-		
-		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating 'metadataForKeys' statement: %d %s",
-						status, sqlite3_errmsg(connection->db));
-			break; // Break from do/while. Still need to free _collection.
-		}
-		
-		// Bind parameters.
-		// And move objects from the missingIndexes array into keyIndexDict.
-		
-		if (keyIndexDict == nil)
-			keyIndexDict = [NSMutableDictionary dictionaryWithCapacity:numKeyParams];
-		else
-			[keyIndexDict removeAllObjects];
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
-		sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
 		
-		for (i = 0; i < numKeyParams; i++)
-		{
-			NSNumber *keyIndexNumber = [missingIndexes objectAtIndex:i];
-			NSString *key = [keys objectAtIndex:[keyIndexNumber unsignedIntegerValue]];
-			
-			[keyIndexDict setObject:keyIndexNumber forKey:key];
-			
-			sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + 1 + i), [key UTF8String], -1, SQLITE_TRANSIENT);
-		}
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
 		
-		[missingIndexes removeObjectsInRange:NSMakeRange(0, numKeyParams)];
+		block(rowid, key, &stop);
 		
-		// Execute the query and step over the results
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite_enum_reset(statement, needsFinalize);
+	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+}
+
+/**
+ * Fast enumeration over all keys in select collections.
+ *
+ * This uses a "SELECT key FROM database WHERE collection = ?" operation,
+ * and then steps over the results invoking the given block handler.
+**/
+- (void)_enumerateKeysInCollections:(NSArray *)collections
+                         usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, BOOL *stop))block
+{
+	if (block == NULL) return;
+	if ([collections count] == 0) return;
+	
+	BOOL needsFinalize;
+	sqlite3_stmt *statement = [connection enumerateKeysInCollectionStatement:&needsFinalize];
+	if (statement == NULL) return;
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	// SELECT "rowid", "key" FROM "database2" WHERE collection = ?;
+	
+	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+	int const column_idx_key      = SQLITE_COLUMN_START + 1;
+	int const bind_idx_collection = SQLITE_BIND_START;
+	
+	for (NSString *collection in collections)
+	{
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 		
+		int status;
 		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 		{
+			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+			
 			const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
 			int textSize = sqlite3_column_bytes(statement, column_idx_key);
 			
-			const void *blob = sqlite3_column_blob(statement, column_idx_metadata);
-			int blobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-			
 			NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
-			keyIndex = [[keyIndexDict objectForKey:key] unsignedIntegerValue];
 			
-			NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			
-			id metadata = data ? connection->database->metadataDeserializer(collection, key, data) : nil;
-			
-			if (metadata)
-			{
-				YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-				
-				[connection->metadataCache setObject:metadata forKey:cacheKey];
-			}
-			
-			block(keyIndex, metadata, &stop);
-			
-			[keyIndexDict removeObjectForKey:key];
+			block(rowid, collection, key, &stop);
 			
 			if (stop || mutation.isMutated) break;
 		}
@@ -2398,204 +3714,144 @@
 			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 		}
 		
-		sqlite3_finalize(statement);
-		statement = NULL;
+		sqlite_enum_reset(statement, needsFinalize);
+		FreeYapDatabaseString(&_collection);
 		
-		if (stop) {
-			FreeYapDatabaseString(&_collection);
-			return;
-		}
-		if (mutation.isMutated) {
-			FreeYapDatabaseString(&_collection);
+		if (!stop && mutation.isMutated)
+		{
 			@throw [self mutationDuringEnumerationException];
-			return;
 		}
-		
-		// If there are any remaining items in the keyIndexDict,
-		// then those items didn't exist in the database.
-		
-		for (NSNumber *keyIndexNumber in [keyIndexDict objectEnumerator])
-		{
-			block([keyIndexNumber unsignedIntegerValue], nil, &stop);
-			
-			// Do NOT add keys to the cache that don't exist in the database.
 			
-			if (stop || mutation.isMutated) break;
-		}
-		
-		if (stop) {
-			FreeYapDatabaseString(&_collection);
-			return;
-		}
-		if (mutation.isMutated) {
-			FreeYapDatabaseString(&_collection);
-			@throw [self mutationDuringEnumerationException];
-			return;
+		if (stop)
+		{
+			break;
 		}
 		
-		
-	} while ([missingIndexes count] > 0);
-	
-	FreeYapDatabaseString(&_collection);
+	} // end for (NSString *collection in collections)
 }
 
 /**
- * Enumerates over the given list of keys (unordered).
- *
- * This method is faster than fetching individual items as it optimizes cache access.
- * That is, it will first enumerate over items in the cache and then fetch items from the database,
- * thus optimizing the cache and reducing query size.
- *
- * If any keys are missing from the database, the 'object' parameter will be nil.
+ * Fast enumeration over all keys in the given collection.
  *
- * IMPORTANT:
- * Due to cache optimizations, the items may not be enumerated in the same order as the 'keys' parameter.
+ * This uses a "SELECT collection, key FROM database" operation,
+ * and then steps over the results invoking the given block handler.
 **/
-- (void)enumerateRowsForKeys:(NSArray *)keys
-                inCollection:(NSString *)collection
-         unorderedUsingBlock:(void (^)(NSUInteger keyIndex, id object, id metadata, BOOL *stop))block
+- (void)_enumerateKeysInAllCollectionsUsingBlock:
+                            (void (^)(int64_t rowid, NSString *collection, NSString *key, BOOL *stop))block
 {
 	if (block == NULL) return;
-	if ([keys count] == 0) return;
-	if (collection == nil) collection = @"";
+	
+	BOOL needsFinalize;
+	sqlite3_stmt *statement = [connection enumerateKeysInAllCollectionsStatement:&needsFinalize];
+	if (statement == NULL) return;
 	
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
-	__block BOOL stop = NO;
+	BOOL stop = NO;
 	
-	// Check the cache first (to optimize cache)
+	// SELECT "rowid", "collection", "key" FROM "database2";
 	
-	NSMutableArray *missingIndexes = [NSMutableArray arrayWithCapacity:[keys count]];
-	NSUInteger keyIndex = 0;
+	int const column_idx_rowid      = SQLITE_COLUMN_START + 0;
+	int const column_idx_collection = SQLITE_COLUMN_START + 1;
+	int const column_idx_key        = SQLITE_COLUMN_START + 2;
 	
-	for (NSString *key in keys)
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
-		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
-		id object = [connection->objectCache objectForKey:cacheKey];
-		if (object)
-		{
-			id metadata = [connection->metadataCache objectForKey:cacheKey];
-			if (metadata)
-			{
-				if (metadata == [YapNull null])
-					block(keyIndex, object, nil, &stop);
-				else
-					block(keyIndex, object, metadata, &stop);
-				
-				if (stop || mutation.isMutated) break;
-			}
-			else
-			{
-				[missingIndexes addObject:@(keyIndex)];
-			}
-		}
-		else
-		{
-			[missingIndexes addObject:@(keyIndex)];
-		}
+		const unsigned char *text1 = sqlite3_column_text(statement, column_idx_collection);
+		int textSize1 = sqlite3_column_bytes(statement, column_idx_collection);
 		
-		keyIndex++;
+		const unsigned char *text2 = sqlite3_column_text(statement, column_idx_key);
+		int textSize2 = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *collection, *key;
+		
+		collection = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+		key        = [[NSString alloc] initWithBytes:text2 length:textSize2 encoding:NSUTF8StringEncoding];
+		
+		block(rowid, collection, key, &stop);
+		
+		if (stop || mutation.isMutated) break;
 	}
 	
-	if (stop) {
-		return;
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 	}
-	if (mutation.isMutated) {
+	
+	sqlite_enum_reset(statement, needsFinalize);
+	
+	if (!stop && mutation.isMutated)
+	{
 		@throw [self mutationDuringEnumerationException];
-		return;
-	}
-	if ([missingIndexes count] == 0) {
-		return;
 	}
+}
+
+/**
+ * Fast enumeration over all objects in the database.
+ *
+ * This uses a "SELECT key, object from database WHERE collection = ?" operation, and then steps over the results,
+ * deserializing each object, and then invoking the given block handler.
+ *
+ * If you only need to enumerate over certain objects (e.g. keys with a particular prefix),
+ * consider using the alternative version below which provides a filter,
+ * allowing you to skip the serialization step for those objects you're not interested in.
+**/
+- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block
+{
+	[self _enumerateKeysAndObjectsInCollection:collection usingBlock:block withFilter:NULL];
+}
+
+/**
+ * Fast enumeration over objects in the database for which you're interested in.
+ * The filter block allows you to decide which objects you're interested in.
+ *
+ * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
+ * If the filter block returns NO, then the block handler is skipped for the given key,
+ * which avoids the cost associated with deserializing the object.
+**/
+- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block
+                                  withFilter:(BOOL (^)(int64_t rowid, NSString *key))filter
+{
+	if (block == NULL) return;
+	if (collection == nil) collection = @"";
 	
-	// Go to database for any missing keys (if needed)
+	BOOL needsFinalize;
+	sqlite3_stmt *statement = [connection enumerateKeysAndObjectsInCollectionStatement:&needsFinalize];
+	if (statement == NULL) return;
 	
-	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
 	
-	NSMutableDictionary *keyIndexDict = nil;
+	// SELECT "rowid", "key", "data", FROM "database2" WHERE "collection" = ?;
 	
-	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
-	// We need to watch out for this in case a large array of keys is passed.
+	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+	int const column_idx_key      = SQLITE_COLUMN_START + 1;
+	int const column_idx_data     = SQLITE_COLUMN_START + 2;
+	int const bind_idx_collection = SQLITE_BIND_START;
 	
-	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 	
-	do
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
+	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
-		// Determine how many parameters to use in the query
-		
-		NSUInteger numKeyParams = MIN([missingIndexes count], (maxHostParams-1)); // minus 1 for collection param
-		
-		// Create the SQL query:
-		//
-		// SELECT "key", "data", "metadata" FROM "database2" WHERE "collection" = ? AND key IN (?, ?, ...);
-		
-		int const column_idx_key      = SQLITE_COLUMN_START + 0;
-		int const column_idx_data     = SQLITE_COLUMN_START + 1;
-		int const column_idx_metadata = SQLITE_COLUMN_START + 2;
-		
-		NSUInteger capacity = 80 + (numKeyParams * 3);
-		NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
-		
-		[query appendString:@"SELECT \"key\", \"data\", \"metadata\" FROM \"database2\""];
-		[query appendString:@" WHERE \"collection\" = ? AND \"key\" IN ("];
-		
-		NSUInteger i;
-		for (i = 0; i < numKeyParams; i++)
-		{
-			if (i == 0)
-				[query appendString:@"?"];
-			else
-				[query appendString:@", ?"];
-		}
-		
-		[query appendString:@");"];
-		
-		sqlite3_stmt *statement;
-		
-		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-		if (status != SQLITE_OK)
-		{
-			YDBLogError(@"Error creating 'objectsAndMetadataForKeys' statement: %d %s",
-						status, sqlite3_errmsg(connection->db));
-			break; // Break from do/while. Still need to free _collection.
-		}
-		
-		// Bind parameters.
-		// And move objects from the missingIndexes array into keyIndexDict.
-		
-		if (keyIndexDict == nil)
-			keyIndexDict = [NSMutableDictionary dictionaryWithCapacity:numKeyParams];
-		else
-			[keyIndexDict removeAllObjects];
-		
-		sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
-		
-		for (i = 0; i < numKeyParams; i++)
-		{
-			NSNumber *keyIndexNumber = [missingIndexes objectAtIndex:i];
-			NSString *key = [keys objectAtIndex:[keyIndexNumber unsignedIntegerValue]];
-			
-			[keyIndexDict setObject:keyIndexNumber forKey:key];
-			
-			sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + 1 + i), [key UTF8String], -1, SQLITE_TRANSIENT);
-		}
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
-		[missingIndexes removeObjectsInRange:NSMakeRange(0, numKeyParams)];
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
 		
-		// Execute the query and step over the results
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
 		
-		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		BOOL invokeBlock = (filter == NULL) ? YES : filter(rowid, key);
+		if (invokeBlock)
 		{
-			const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
-			int textSize = sqlite3_column_bytes(statement, column_idx_key);
-			
-			NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
-			keyIndex = [[keyIndexDict objectForKey:key] unsignedIntegerValue];
-			
-			// Note: When we checked the caches (above),
-			// we could only process the item if the object & metadata were both cached.
-			// So it's worthwhile to check each individual cache here.
-			
 			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 			
 			id object = [connection->objectCache objectForKey:cacheKey];
@@ -2604,121 +3860,83 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				// Performance tuning:
+				// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 				
-				if (object)
-					[connection->objectCache setObject:object forKey:cacheKey];
+				object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
+				
+				// Cache considerations:
+				// Do we want to add the objects/metadata to the cache here?
+				// If the cache is unlimited then we should.
+				// Otherwise we should only add to the cache if it's not full.
+				// The cache should generally be reserved for items that are explicitly fetched,
+				// and we don't want to crowd them out during enumerations.
+				
+				if (!bypassCache && (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit))
+				{
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+						[connection->objectCache setObject:object forKey:cacheKey];
+				}
 			}
 			
-			id metadata = [connection->metadataCache objectForKey:cacheKey];
-			if (metadata)
-			{
-				if (metadata == [YapNull null])
-					metadata = nil;
-			}
-			else
-			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-				if (mBlobSize > 0)
-				{
-					NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-					metadata = connection->database->metadataDeserializer(collection, key, mData);
-				}
-				
-				if (metadata)
-					[connection->metadataCache setObject:metadata forKey:cacheKey];
-				else
-					[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
-			}
-			
-			block(keyIndex, object, metadata, &stop);
-			
-			[keyIndexDict removeObjectForKey:key];
-			
-			if (stop || mutation.isMutated) break;
-		}
-		
-		if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
-		{
-			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
-		}
-		
-		sqlite3_finalize(statement);
-		statement = NULL;
-		
-		if (stop) {
-			FreeYapDatabaseString(&_collection);
-			return;
-		}
-		if (mutation.isMutated) {
-			FreeYapDatabaseString(&_collection);
-			@throw [self mutationDuringEnumerationException];
-			return;
-		}
-		
-		// If there are any remaining items in the keyIndexDict,
-		// then those items didn't exist in the database.
-		
-		for (NSNumber *keyIndexNumber in [keyIndexDict objectEnumerator])
-		{
-			block([keyIndexNumber unsignedIntegerValue], nil, nil, &stop);
-			
-			// Do NOT add keys to the cache that don't exist in the database.
+			block(rowid, key, object, &stop);
 			
 			if (stop || mutation.isMutated) break;
 		}
-		
-		if (stop) {
-			FreeYapDatabaseString(&_collection);
-			return;
-		}
-		if (mutation.isMutated) {
-			FreeYapDatabaseString(&_collection);
-			@throw [self mutationDuringEnumerationException];
-			return;
-		}
-		
-		
-	} while ([missingIndexes count] > 0);
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
 	
+	sqlite_enum_reset(statement, needsFinalize);
 	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Internal Enumerate (using rowid)
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Fast enumeration over all keys in the given collection.
- *
- * This uses a "SELECT key FROM database WHERE collection = ?" operation,
- * and then steps over the results invoking the given block handler.
+ * Enumerates the objects in the given collection whose keys are within the range [lowerBound, upperBound).
+ * Either bound may be nil (unbounded). A limit of zero means no limit.
 **/
-- (void)_enumerateKeysInCollection:(NSString *)collection
-                        usingBlock:(void (^)(int64_t rowid, NSString *key, BOOL *stop))block
+- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                  lowerBound:(NSData *)lowerBound
+                                  upperBound:(NSData *)upperBound
+                                     reverse:(BOOL)reverse
+                                       limit:(NSUInteger)limit
+                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block
 {
 	if (block == NULL) return;
 	if (collection == nil) collection = @"";
 	
 	BOOL needsFinalize;
-	sqlite3_stmt *statement = [connection enumerateKeysInCollectionStatement:&needsFinalize];
+	sqlite3_stmt *statement = [connection enumerateKeysAndObjectsInRangeStatement:&needsFinalize reverse:reverse];
 	if (statement == NULL) return;
 	
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
 	BOOL stop = NO;
 	
-	// SELECT "rowid", "key" FROM "database2" WHERE collection = ?;
+	// SELECT "rowid", "key", "data" FROM "database2"
+	//  WHERE "collection" = ? AND "key" >= ? AND "key" < ? ORDER BY "key" ASC|DESC LIMIT ?;
 	
 	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
 	int const column_idx_key      = SQLITE_COLUMN_START + 1;
-	int const bind_idx_collection = SQLITE_BIND_START;
+	int const column_idx_data     = SQLITE_COLUMN_START + 2;
+	int const bind_idx_collection = SQLITE_BIND_START + 0;
+	int const bind_idx_lowerBound = SQLITE_BIND_START + 1;
 	
 	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
 	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 	
+	YapDatabaseBindKeyRange(statement, bind_idx_lowerBound, lowerBound, upperBound, limit);
+	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
+	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
+	
 	int status;
 	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
@@ -2729,7 +3947,26 @@
 		
 		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
 		
-		block(rowid, key, &stop);
+		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		id object = [connection->objectCache objectForKey:cacheKey];
+		if (object == nil)
+		{
+			const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+			int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+			
+			object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
+			
+			// See _enumerateKeysAndObjectsInCollection:usingBlock:withFilter: for cache considerations.
+			
+			if (!bypassCache && (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit))
+			{
+				if (object)
+					[connection->objectCache setObject:object forKey:cacheKey];
+			}
+		}
+		
+		block(rowid, key, object, &stop);
 		
 		if (stop || mutation.isMutated) break;
 	}
@@ -2749,112 +3986,73 @@
 }
 
 /**
- * Fast enumeration over all keys in select collections.
- *
- * This uses a "SELECT key FROM database WHERE collection = ?" operation,
- * and then steps over the results invoking the given block handler.
+ * Enumerates the rows in the given collection with a rowid greater than the given rowid, in rowid order.
+ * A limit of zero means no limit.
 **/
-- (void)_enumerateKeysInCollections:(NSArray *)collections
-                         usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, BOOL *stop))block
+- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                  afterRowid:(int64_t)afterRowid
+                                       limit:(NSUInteger)limit
+                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block
 {
 	if (block == NULL) return;
-	if ([collections count] == 0) return;
+	if (collection == nil) collection = @"";
 	
 	BOOL needsFinalize;
-	sqlite3_stmt *statement = [connection enumerateKeysInCollectionStatement:&needsFinalize];
+	sqlite3_stmt *statement = [connection enumerateRowsInCollectionPageStatement:&needsFinalize];
 	if (statement == NULL) return;
 	
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
 	BOOL stop = NO;
 	
-	// SELECT "rowid", "key" FROM "database2" WHERE collection = ?;
+	// SELECT "rowid", "key", "data" FROM "database2"
+	//  WHERE "collection" = ? AND "rowid" > ? ORDER BY "rowid" ASC LIMIT ?;
 	
 	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
 	int const column_idx_key      = SQLITE_COLUMN_START + 1;
-	int const bind_idx_collection = SQLITE_BIND_START;
-	
-	for (NSString *collection in collections)
-	{
-		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
-		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
-		
-		int status;
-		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
-		{
-			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
-			
-			const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
-			int textSize = sqlite3_column_bytes(statement, column_idx_key);
-			
-			NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
-			
-			block(rowid, collection, key, &stop);
-			
-			if (stop || mutation.isMutated) break;
-		}
-		
-		if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
-		{
-			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
-		}
-		
-		sqlite_enum_reset(statement, needsFinalize);
-		FreeYapDatabaseString(&_collection);
-		
-		if (!stop && mutation.isMutated)
-		{
-			@throw [self mutationDuringEnumerationException];
-		}
-			
-		if (stop)
-		{
-			break;
-		}
-		
-	} // end for (NSString *collection in collections)
-}
-
-/**
- * Fast enumeration over all keys in the given collection.
- *
- * This uses a "SELECT collection, key FROM database" operation,
- * and then steps over the results invoking the given block handler.
-**/
-- (void)_enumerateKeysInAllCollectionsUsingBlock:
-                            (void (^)(int64_t rowid, NSString *collection, NSString *key, BOOL *stop))block
-{
-	if (block == NULL) return;
-	
-	BOOL needsFinalize;
-	sqlite3_stmt *statement = [connection enumerateKeysInAllCollectionsStatement:&needsFinalize];
-	if (statement == NULL) return;
+	int const column_idx_data     = SQLITE_COLUMN_START + 2;
+	int const bind_idx_collection = SQLITE_BIND_START + 0;
+	int const bind_idx_rowid      = SQLITE_BIND_START + 1;
+	int const bind_idx_limit      = SQLITE_BIND_START + 2;
 	
-	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
-	BOOL stop = NO;
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 	
-	// SELECT "rowid", "collection", "key" FROM "database2";
+	sqlite3_bind_int64(statement, bind_idx_rowid, afterRowid);
+	sqlite3_bind_int64(statement, bind_idx_limit, (limit == 0) ? -1 : (int64_t)MIN(limit, (NSUInteger)INT64_MAX));
 	
-	int const column_idx_rowid      = SQLITE_COLUMN_START + 0;
-	int const column_idx_collection = SQLITE_COLUMN_START + 1;
-	int const column_idx_key        = SQLITE_COLUMN_START + 2;
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
+	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
 	
 	int status;
 	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 	{
 		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
-		const unsigned char *text1 = sqlite3_column_text(statement, column_idx_collection);
-		int textSize1 = sqlite3_column_bytes(statement, column_idx_collection);
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
 		
-		const unsigned char *text2 = sqlite3_column_text(statement, column_idx_key);
-		int textSize2 = sqlite3_column_bytes(statement, column_idx_key);
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
 		
-		NSString *collection, *key;
+		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 		
-		collection = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
-		key        = [[NSString alloc] initWithBytes:text2 length:textSize2 encoding:NSUTF8StringEncoding];
+		id object = [connection->objectCache objectForKey:cacheKey];
+		if (object == nil)
+		{
+			const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+			int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+			
+			object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
+			
+			// See _enumerateKeysAndObjectsInCollection:usingBlock:withFilter: for cache considerations.
+			
+			if (!bypassCache && (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit))
+			{
+				if (object)
+					[connection->objectCache setObject:object forKey:cacheKey];
+			}
+		}
 		
-		block(rowid, collection, key, &stop);
+		block(rowid, key, object, &stop);
 		
 		if (stop || mutation.isMutated) break;
 	}
@@ -2865,6 +4063,7 @@
 	}
 	
 	sqlite_enum_reset(statement, needsFinalize);
+	FreeYapDatabaseString(&_collection);
 	
 	if (!stop && mutation.isMutated)
 	{
@@ -2873,7 +4072,7 @@
 }
 
 /**
- * Fast enumeration over all objects in the database.
+ * Fast enumeration over selected objects in the database.
  *
  * This uses a "SELECT key, object from database WHERE collection = ?" operation, and then steps over the results,
  * deserializing each object, and then invoking the given block handler.
@@ -2882,10 +4081,10 @@
  * consider using the alternative version below which provides a filter,
  * allowing you to skip the serialization step for those objects you're not interested in.
 **/
-- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
-                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block
+- (void)_enumerateKeysAndObjectsInCollections:(NSArray *)collections usingBlock:
+                            (void (^)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop))block
 {
-	[self _enumerateKeysAndObjectsInCollection:collection usingBlock:block withFilter:NULL];
+	[self _enumerateKeysAndObjectsInCollections:collections usingBlock:block withFilter:NULL];
 }
 
 /**
@@ -2896,12 +4095,12 @@
  * If the filter block returns NO, then the block handler is skipped for the given key,
  * which avoids the cost associated with deserializing the object.
 **/
-- (void)_enumerateKeysAndObjectsInCollection:(NSString *)collection
-                                  usingBlock:(void (^)(int64_t rowid, NSString *key, id object, BOOL *stop))block
-                                  withFilter:(BOOL (^)(int64_t rowid, NSString *key))filter
+- (void)_enumerateKeysAndObjectsInCollections:(NSArray *)collections
+                 usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop))block
+                 withFilter:(BOOL (^)(int64_t rowid, NSString *collection, NSString *key))filter
 {
 	if (block == NULL) return;
-	if (collection == nil) collection = @"";
+	if ([collections count] == 0) return;
 	
 	BOOL needsFinalize;
 	sqlite3_stmt *statement = [connection enumerateKeysAndObjectsInCollectionStatement:&needsFinalize];
@@ -2910,6 +4109,9 @@
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
 	BOOL stop = NO;
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
+	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
+	
 	// SELECT "rowid", "key", "data", FROM "database2" WHERE "collection" = ?;
 	
 	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
@@ -2917,128 +4119,15 @@
 	int const column_idx_data     = SQLITE_COLUMN_START + 2;
 	int const bind_idx_collection = SQLITE_BIND_START;
 	
-	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
-	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
-	
-	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
-	
-	int status;
-	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	for (NSString *collection in collections)
 	{
-		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
-		
-		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
-		int textSize = sqlite3_column_bytes(statement, column_idx_key);
-		
-		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 		
-		BOOL invokeBlock = (filter == NULL) ? YES : filter(rowid, key);
-		if (invokeBlock)
+		int status;
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 		{
-			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-			
-			id object = [connection->objectCache objectForKey:cacheKey];
-			if (object == nil)
-			{
-				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
-				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
-				
-				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
-				
-				// Cache considerations:
-				// Do we want to add the objects/metadata to the cache here?
-				// If the cache is unlimited then we should.
-				// Otherwise we should only add to the cache if it's not full.
-				// The cache should generally be reserved for items that are explicitly fetched,
-				// and we don't want to crowd them out during enumerations.
-				
-				if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
-				{
-					if (object)
-						[connection->objectCache setObject:object forKey:cacheKey];
-				}
-			}
-			
-			block(rowid, key, object, &stop);
-			
-			if (stop || mutation.isMutated) break;
-		}
-	}
-	
-	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
-	{
-		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
-	}
-	
-	sqlite_enum_reset(statement, needsFinalize);
-	FreeYapDatabaseString(&_collection);
-	
-	if (!stop && mutation.isMutated)
-	{
-		@throw [self mutationDuringEnumerationException];
-	}
-}
-
-/**
- * Fast enumeration over selected objects in the database.
- *
- * This uses a "SELECT key, object from database WHERE collection = ?" operation, and then steps over the results,
- * deserializing each object, and then invoking the given block handler.
- *
- * If you only need to enumerate over certain objects (e.g. keys with a particular prefix),
- * consider using the alternative version below which provides a filter,
- * allowing you to skip the serialization step for those objects you're not interested in.
-**/
-- (void)_enumerateKeysAndObjectsInCollections:(NSArray *)collections usingBlock:
-                            (void (^)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop))block
-{
-	[self _enumerateKeysAndObjectsInCollections:collections usingBlock:block withFilter:NULL];
-}
-
-/**
- * Fast enumeration over objects in the database for which you're interested in.
- * The filter block allows you to decide which objects you're interested in.
- *
- * From the filter block, simply return YES if you'd like the block handler to be invoked for the given key.
- * If the filter block returns NO, then the block handler is skipped for the given key,
- * which avoids the cost associated with deserializing the object.
-**/
-- (void)_enumerateKeysAndObjectsInCollections:(NSArray *)collections
-                 usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop))block
-                 withFilter:(BOOL (^)(int64_t rowid, NSString *collection, NSString *key))filter
-{
-	if (block == NULL) return;
-	if ([collections count] == 0) return;
-	
-	BOOL needsFinalize;
-	sqlite3_stmt *statement = [connection enumerateKeysAndObjectsInCollectionStatement:&needsFinalize];
-	if (statement == NULL) return;
-	
-	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
-	BOOL stop = NO;
-	
-	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
-	
-	// SELECT "rowid", "key", "data", FROM "database2" WHERE "collection" = ?;
-	
-	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
-	int const column_idx_key      = SQLITE_COLUMN_START + 1;
-	int const column_idx_data     = SQLITE_COLUMN_START + 2;
-	int const bind_idx_collection = SQLITE_BIND_START;
-	
-	for (NSString *collection in collections)
-	{
-		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
-		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
-		
-		int status;
-		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
-		{
-			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 			
 			const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
 			int textSize = sqlite3_column_bytes(statement, column_idx_key);
@@ -3057,10 +4146,9 @@
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 					
 					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+					// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 					
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(collection, key, oData);
+					object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
 					
 					// Cache considerations:
 					// Do we want to add the objects/metadata to the cache here?
@@ -3069,10 +4157,10 @@
 					// The cache should generally be reserved for items that are explicitly fetched,
 					// and we don't want to crowd them out during enumerations.
 					
-					if (unlimitedObjectCacheLimit ||
-					    [connection->objectCache count] < connection->objectCacheLimit)
+					if (!bypassCache && (unlimitedObjectCacheLimit ||
+					                     [connection->objectCache count] < connection->objectCacheLimit))
 					{
-						if (object)
+						if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
 							[connection->objectCache setObject:object forKey:cacheKey];
 					}
 				}
@@ -3154,6 +4242,7 @@
 	int const column_idx_key        = SQLITE_COLUMN_START + 2;
 	int const column_idx_data       = SQLITE_COLUMN_START + 3;
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
 	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
 	
 	int status;
@@ -3183,12 +4272,11 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
 				
-				if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
+				if (!bypassCache && (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit))
 				{
-					if (object)
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
 						[connection->objectCache setObject:object forKey:cacheKey];
 				}
 			}
@@ -3262,6 +4350,7 @@
 	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
 	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
 	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
 	
 	int status;
@@ -3287,17 +4376,8 @@
 			}
 			else
 			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-				if (mBlobSize > 0)
-				{
-					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-					
-					NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-					metadata = connection->database->metadataDeserializer(collection, key, mData);
-				}
+				metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+				                                         statement, column_idx_metadata);
 				
 				// Cache considerations:
 				// Do we want to add the objects/metadata to the cache here?
@@ -3306,8 +4386,8 @@
 				// The cache should generally be reserved for items that are explicitly fetched,
 				// and we don't want to crowd them out during enumerations.
 				
-				if (unlimitedMetadataCacheLimit ||
-				    [connection->metadataCache count] < connection->metadataCacheLimit)
+				if (!bypassCache && (unlimitedMetadataCacheLimit ||
+				                     [connection->metadataCache count] < connection->metadataCacheLimit))
 				{
 					if (metadata)
 						[connection->metadataCache setObject:metadata forKey:cacheKey];
@@ -3376,6 +4456,7 @@
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
 	BOOL stop = NO;
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
 	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
 	
 	// SELECT "rowid", "key", "metadata" FROM "database2" WHERE "collection" = ?;
@@ -3413,17 +4494,8 @@
 				}
 				else
 				{
-					const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-					int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-					
-					if (mBlobSize > 0)
-					{
-						// Performance tuning:
-						// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-						
-						NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-						metadata = connection->database->metadataDeserializer(collection, key, mData);
-					}
+					metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+					                                         statement, column_idx_metadata);
 					
 					// Cache considerations:
 					// Do we want to add the objects/metadata to the cache here?
@@ -3432,8 +4504,8 @@
 					// The cache should generally be reserved for items that are explicitly fetched,
 					// and we don't want to crowd them out during enumerations.
 					
-					if (unlimitedMetadataCacheLimit ||
-					    [connection->metadataCache count] < connection->metadataCacheLimit)
+					if (!bypassCache && (unlimitedMetadataCacheLimit ||
+					                     [connection->metadataCache count] < connection->metadataCacheLimit))
 					{
 						if (metadata)
 							[connection->metadataCache setObject:metadata forKey:cacheKey];
@@ -3520,6 +4592,7 @@
 	int const column_idx_key        = SQLITE_COLUMN_START + 2;
 	int const column_idx_metadata   = SQLITE_COLUMN_START + 3;
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
 	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
 	
 	int status;
@@ -3551,17 +4624,8 @@
 			}
 			else
 			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-				if (mBlobSize > 0)
-				{
-					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-					
-					NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-					metadata = connection->database->metadataDeserializer(collection, key, mData);
-				}
+				metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+				                                         statement, column_idx_metadata);
 				
 				// Cache considerations:
 				// Do we want to add the objects/metadata to the cache here?
@@ -3570,8 +4634,8 @@
 				// The cache should generally be reserved for items that are explicitly fetched,
 				// and we don't want to crowd them out during enumerations.
 				
-				if (unlimitedMetadataCacheLimit ||
-				    [connection->metadataCache count] < connection->metadataCacheLimit)
+				if (!bypassCache && (unlimitedMetadataCacheLimit ||
+				                     [connection->metadataCache count] < connection->metadataCacheLimit))
 				{
 					if (metadata)
 						[connection->metadataCache setObject:metadata forKey:cacheKey];
@@ -3648,6 +4712,7 @@
 	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
 	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
 	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
 	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
 	
@@ -3673,10 +4738,9 @@
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
 				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+				// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
 				
 				// Cache considerations:
 				// Do we want to add the objects/metadata to the cache here?
@@ -3685,9 +4749,9 @@
 				// The cache should generally be reserved for items that are explicitly fetched,
 				// and we don't want to crowd them out during enumerations.
 				
-				if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
+				if (!bypassCache && (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit))
 				{
-					if (object)
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
 						[connection->objectCache setObject:object forKey:cacheKey];
 				}
 			}
@@ -3700,17 +4764,8 @@
 			}
 			else
 			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-				if (mBlobSize > 0)
-				{
-					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-					
-					NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-					metadata = connection->database->metadataDeserializer(collection, key, mData);
-				}
+				metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+				                                         statement, column_idx_metadata);
 				
 				// Cache considerations:
 				// Do we want to add the objects/metadata to the cache here?
@@ -3719,8 +4774,8 @@
 				// The cache should generally be reserved for items that are explicitly fetched,
 				// and we don't want to crowd them out during enumerations.
 				
-				if (unlimitedMetadataCacheLimit ||
-				    [connection->metadataCache count] < connection->metadataCacheLimit)
+				if (!bypassCache && (unlimitedMetadataCacheLimit ||
+				                     [connection->metadataCache count] < connection->metadataCacheLimit))
 				{
 					if (metadata)
 						[connection->metadataCache setObject:metadata forKey:cacheKey];
@@ -3749,6 +4804,196 @@
 	}
 }
 
+/**
+ * Concurrent version of _enumerateKeysAndObjectsInCollection & _enumerateRowsInCollection.
+ *
+ * The statement is stepped on the current thread, and the blobs (copied out of sqlite) are handed to
+ * a YapDeserializationPipeline, which deserializes them concurrently on background threads.
+ * The caches are only touched (and the block only invoked) from the current thread.
+ *
+ * If unordered is NO, the block is invoked in the same order as the non-concurrent version.
+**/
+- (void)_concurrentlyEnumerateRowsInCollection:(NSString *)collection
+                               includeMetadata:(BOOL)includeMetadata
+                                     unordered:(BOOL)unordered
+                                    usingBlock:
+                            (void (^)(int64_t rowid, NSString *key, id object, id metadata, BOOL *stop))block
+                                    withFilter:(BOOL (^)(int64_t rowid, NSString *key))filter
+{
+	if (block == NULL) return;
+	if (collection == nil) collection = @"";
+	
+	BOOL needsFinalize;
+	sqlite3_stmt *statement = includeMetadata
+	  ? [connection enumerateRowsInCollectionStatement:&needsFinalize]
+	  : [connection enumerateKeysAndObjectsInCollectionStatement:&needsFinalize];
+	if (statement == NULL) return;
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	__block BOOL stop = NO;
+	
+	// SELECT "rowid", "key", "data" FROM "database2" WHERE "collection" = ?;
+	// SELECT "rowid", "key", "data", "metadata" FROM "database2" WHERE "collection" = ?;
+	
+	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+	int const column_idx_key      = SQLITE_COLUMN_START + 1;
+	int const column_idx_data     = SQLITE_COLUMN_START + 2;
+	int const column_idx_metadata = SQLITE_COLUMN_START + 3;
+	int const bind_idx_collection = SQLITE_BIND_START;
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
+	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
+	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
+	
+	NSUInteger windowSize = connection.enumerationWindowSize;
+	if (windowSize == 0) {
+		windowSize = 4 * [[NSProcessInfo processInfo] activeProcessorCount];
+	}
+	
+	YapDatabase *database = connection->database;
+	
+	YapDeserializationPipelineWorker worker = ^(YapDeserializationItem *item) {
+		
+		NSData *oData = item->objectData;
+		if (oData)
+			item->object = YapDatabaseDeserializeObject(database, collection, item->key, oData.bytes, (int)oData.length);
+		
+		NSData *mData = item->metadataData;
+		if (mData)
+			item->metadata = YapDatabaseDeserializeMetadata(database, collection, item->key, mData.bytes, (int)mData.length);
+	};
+	
+	YapDeserializationPipelineHandler handler = ^(YapDeserializationItem *item, BOOL *pipelineStop) {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		// Cache considerations:
+		// Same as the non-concurrent version (see _enumerateRowsInCollection:usingBlock:withFilter:).
+		
+		if (item->cacheObject || item->cacheMetadata)
+		{
+			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:item->key];
+			
+			if (item->cacheObject && item->object)
+			{
+				if (!bypassCache && (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit))
+				{
+					[connection->objectCache setObject:item->object forKey:cacheKey];
+				}
+			}
+			
+			if (item->cacheMetadata)
+			{
+				if (!bypassCache && (unlimitedMetadataCacheLimit ||
+				                     [connection->metadataCache count] < connection->metadataCacheLimit))
+				{
+					if (item->metadata)
+						[connection->metadataCache setObject:item->metadata forKey:cacheKey];
+					else
+						[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+				}
+			}
+		}
+		
+		block(item->rowid, item->key, item->object, item->metadata, &stop);
+		
+		if (stop || mutation.isMutated) *pipelineStop = YES;
+		
+	#pragma clang diagnostic pop
+	};
+	
+	YapDeserializationPipeline *pipeline =
+	  [[YapDeserializationPipeline alloc] initWithWindowSize:windowSize
+	                                                 ordered:!unordered
+	                                                  worker:worker
+	                                                 handler:handler];
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		BOOL invokeBlock = (filter == NULL) ? YES : filter(rowid, key);
+		if (invokeBlock)
+		{
+			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			
+			YapDeserializationItem *item = [[YapDeserializationItem alloc] init];
+			item->rowid = rowid;
+			item->key = key;
+			
+			item->object = [connection->objectCache objectForKey:cacheKey];
+			if (item->object == nil)
+			{
+				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+				
+				// The blob is only valid until the next sqlite3_step, so it must be copied.
+				
+				item->objectData = [NSData dataWithBytes:oBlob length:oBlobSize];
+				item->cacheObject = YES;
+			}
+			
+			if (includeMetadata)
+			{
+				id metadata = [connection->metadataCache objectForKey:cacheKey];
+				if (metadata)
+				{
+					if (metadata != [YapNull null])
+						item->metadata = metadata;
+				}
+				else
+				{
+					if (sqlite3_column_type(statement, column_idx_metadata) == SQLITE_BLOB)
+					{
+						const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
+						int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
+						
+						if (mBlobSize > 0)
+						{
+							item->metadataData = [NSData dataWithBytes:mBlob length:mBlobSize];
+						}
+					}
+					else
+					{
+						// Native metadata doesn't need to be deserialized (by the pipeline workers)
+						
+						item->metadata = YapDatabaseMetadataFromColumn(database, collection, key,
+						                                               statement, column_idx_metadata);
+					}
+					
+					item->cacheMetadata = YES;
+				}
+			}
+			
+			if (![pipeline enqueue:item]) break;
+		}
+	}
+	
+	[pipeline finish];
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite_enum_reset(statement, needsFinalize);
+	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+}
+
 /**
  * Fast enumeration over select rows in the database.
  *
@@ -3787,6 +5032,7 @@
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
 	BOOL stop = NO;
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
 	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
 	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
 	
@@ -3825,10 +5071,9 @@
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 					
 					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
+					// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
 					
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(collection, key, oData);
+					object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
 					
 					// Cache considerations:
 					// Do we want to add the objects/metadata to the cache here?
@@ -3837,10 +5082,10 @@
 					// The cache should generally be reserved for items that are explicitly fetched,
 					// and we don't want to crowd them out during enumerations.
 					
-					if (unlimitedObjectCacheLimit ||
-					    [connection->objectCache count] < connection->objectCacheLimit)
+					if (!bypassCache && (unlimitedObjectCacheLimit ||
+					                     [connection->objectCache count] < connection->objectCacheLimit))
 					{
-						if (object)
+						if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
 							[connection->objectCache setObject:object forKey:cacheKey];
 					}
 				}
@@ -3853,17 +5098,8 @@
 				}
 				else
 				{
-					const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-					int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-					
-					if (mBlobSize > 0)
-					{
-						// Performance tuning:
-						// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-						
-						NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-						metadata = connection->database->metadataDeserializer(collection, key, mData);
-					}
+					metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+					                                         statement, column_idx_metadata);
 					
 					// Cache considerations:
 					// Do we want to add the objects/metadata to the cache here?
@@ -3872,8 +5108,8 @@
 					// The cache should generally be reserved for items that are explicitly fetched,
 					// and we don't want to crowd them out during enumerations.
 					
-					if (unlimitedMetadataCacheLimit ||
-					    [connection->metadataCache count] < connection->metadataCacheLimit)
+					if (!bypassCache && (unlimitedMetadataCacheLimit ||
+					                     [connection->metadataCache count] < connection->metadataCacheLimit))
 					{
 						if (metadata)
 							[connection->metadataCache setObject:metadata forKey:cacheKey];
@@ -3960,6 +5196,7 @@
 	int const column_idx_data       = SQLITE_COLUMN_START + 3;
 	int const column_idx_metadata   = SQLITE_COLUMN_START + 4;
 	
+	BOOL bypassCache = (cachePolicy == YapDatabaseTransactionCachePolicyBypass);
 	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
 	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
 	
@@ -3990,12 +5227,11 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
 				
-				if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
+				if (!bypassCache && (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit))
 				{
-					if (object)
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
 						[connection->objectCache setObject:object forKey:cacheKey];
 				}
 			}
@@ -4008,17 +5244,11 @@
 			}
 			else
 			{
-				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
-				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
-				
-				if (mBlobSize > 0)
-				{
-					NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
-					metadata = connection->database->metadataDeserializer(collection, key, mData);
-				}
+				metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+				                                         statement, column_idx_metadata);
 				
-				if (unlimitedMetadataCacheLimit ||
-				    [connection->metadataCache count] < connection->metadataCacheLimit)
+				if (!bypassCache && (unlimitedMetadataCacheLimit ||
+				                     [connection->metadataCache count] < connection->metadataCacheLimit))
 				{
 					if (metadata)
 						[connection->metadataCache setObject:metadata forKey:cacheKey];
@@ -4047,29 +5277,319 @@
 }
 
 /**
- * Fetches the rowid for each given key.
+ * Enumerates (at most) the given number of rows with a rowid greater than the given rowid, in rowid order.
  *
- * The rowids are delivered unordered, which is why the block has a keyIndex parameter.
- * If a key doesn't exist in the database, the block is never invoked for its keyIndex.
+ * This is designed for extensions that populate themselves incrementally, across multiple transactions.
+ * The caller persists the returned lastRowid, and passes it in to fetch the next batch.
+ *
+ * The filter block (optional) is invoked for every row, and allows the caller to skip the deserialization step.
+ * Rows skipped by the filter still count towards the limit, and still advance the lastRowid.
+ *
+ * Returns the number of rows that were stepped over.
+ * If this is less than the given limit, then there are no more rows after lastRowid.
 **/
-- (void)_enumerateRowidsForKeys:(NSArray *)keys
-                   inCollection:(NSString *)collection
-            unorderedUsingBlock:(void (^)(NSUInteger keyIndex, int64_t rowid, BOOL *stop))block
+- (NSUInteger)_enumerateRowsAfterRowid:(int64_t)afterRowid
+                                 limit:(NSUInteger)limit
+                           withObjects:(BOOL)withObjects
+                              metadata:(BOOL)withMetadata
+                             lastRowid:(int64_t *)lastRowidPtr
+                            usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key,
+                                                 id object, id metadata, BOOL *stop))block
+                            withFilter:(BOOL (^)(int64_t rowid, NSString *collection, NSString *key))filter
 {
-	if (block == NULL) return;
-	if (keys.count == 0) return;
-	if (collection == nil) collection = @"";
+	int64_t lastRowid = afterRowid;
+	NSUInteger count = 0;
 	
-	if (keys.count == 1)
+	if (block == NULL || limit == 0)
 	{
-		int64_t rowid = 0;
-		if ([self getRowid:&rowid forKey:[keys firstObject] inCollection:collection])
-		{
-			BOOL stop = NO;
-			block(0, rowid, &stop);
-		}
-		
-		return;
+		if (lastRowidPtr) *lastRowidPtr = lastRowid;
+		return count;
+	}
+	
+	// Create the SQL query:
+	//
+	// SELECT "rowid", "collection", "key", "data", "metadata" FROM "database2"
+	//   WHERE "rowid" > ? ORDER BY "rowid" ASC LIMIT ?;
+	//
+	// Note: The "data" and/or "metadata" columns are omitted if not requested.
+	
+	int const column_idx_rowid      = SQLITE_COLUMN_START + 0;
+	int const column_idx_collection = SQLITE_COLUMN_START + 1;
+	int const column_idx_key        = SQLITE_COLUMN_START + 2;
+	int const column_idx_data       = SQLITE_COLUMN_START + 3;
+	int const column_idx_metadata   = SQLITE_COLUMN_START + (withObjects ? 4 : 3);
+	int const bind_idx_rowid        = SQLITE_BIND_START + 0;
+	int const bind_idx_limit        = SQLITE_BIND_START + 1;
+	
+	NSMutableString *query = [NSMutableString stringWithCapacity:150];
+	
+	[query appendString:@"SELECT \"rowid\", \"collection\", \"key\""];
+	if (withObjects) {
+		[query appendString:@", \"data\""];
+	}
+	if (withMetadata) {
+		[query appendString:@", \"metadata\""];
+	}
+	[query appendString:@" FROM \"database2\" WHERE \"rowid\" > ? ORDER BY \"rowid\" ASC LIMIT ?;"];
+	
+	sqlite3_stmt *statement;
+	
+	int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating 'rowsAfterRowid' statement: %d %s",
+		            status, sqlite3_errmsg(connection->db));
+		
+		if (lastRowidPtr) *lastRowidPtr = lastRowid;
+		return count;
+	}
+	
+	sqlite3_bind_int64(statement, bind_idx_rowid, afterRowid);
+	sqlite3_bind_int64(statement, bind_idx_limit, (sqlite3_int64)limit);
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		lastRowid = rowid;
+		count++;
+		
+		const unsigned char *text1 = sqlite3_column_text(statement, column_idx_collection);
+		int textSize1 = sqlite3_column_bytes(statement, column_idx_collection);
+		
+		const unsigned char *text2 = sqlite3_column_text(statement, column_idx_key);
+		int textSize2 = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *collection, *key;
+		
+		collection = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+		key        = [[NSString alloc] initWithBytes:text2 length:textSize2 encoding:NSUTF8StringEncoding];
+		
+		BOOL invokeBlock = (filter == NULL) ? YES : filter(rowid, collection, key);
+		if (!invokeBlock) continue;
+		
+		YapCollectionKey *ck = nil;
+		if (withObjects || withMetadata)
+		{
+			ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		}
+		
+		id object = nil;
+		if (withObjects)
+		{
+			object = [connection->objectCache objectForKey:ck];
+			if (object == nil)
+			{
+				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+				
+				object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
+				
+				// Note: We don't add the object to the cache.
+				// The enumeration walks the entire database, and would simply evict everything else.
+			}
+		}
+		
+		id metadata = nil;
+		if (withMetadata)
+		{
+			metadata = [connection->metadataCache objectForKey:ck];
+			if (metadata)
+			{
+				if (metadata == [YapNull null])
+					metadata = nil;
+			}
+			else
+			{
+				metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+				                                         statement, column_idx_metadata);
+			}
+		}
+		
+		block(rowid, collection, key, object, metadata, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_finalize(statement);
+	
+	if (lastRowidPtr) *lastRowidPtr = lastRowid;
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+	
+	return count;
+}
+
+/**
+ * Fetches the smallest & largest rowid of the rows in the given collection.
+ * Returns NO if the collection is empty.
+ *
+ * This is designed for partitioning a collection into rowid ranges (see the method below).
+**/
+- (BOOL)_getMinRowid:(int64_t *)minRowidPtr maxRowid:(int64_t *)maxRowidPtr inCollection:(NSString *)collection
+{
+	if (collection == nil) collection = @"";
+	
+	int64_t minRowid = 0;
+	int64_t maxRowid = 0;
+	BOOL found = NO;
+	
+	sqlite3_stmt *statement;
+	const char *query = "SELECT min(\"rowid\"), max(\"rowid\"), count(*) FROM \"database2\" WHERE \"collection\" = ?;";
+	
+	int status = sqlite3_prepare_v2(connection->db, query, -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating 'minMaxRowid' statement: %d %s", status, sqlite3_errmsg(connection->db));
+	}
+	else
+	{
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
+		
+		status = sqlite3_step(statement);
+		if (status == SQLITE_ROW)
+		{
+			if (sqlite3_column_int64(statement, SQLITE_COLUMN_START + 2) > 0)
+			{
+				minRowid = sqlite3_column_int64(statement, SQLITE_COLUMN_START + 0);
+				maxRowid = sqlite3_column_int64(statement, SQLITE_COLUMN_START + 1);
+				found = YES;
+			}
+		}
+		else if (status == SQLITE_ERROR)
+		{
+			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+		}
+		
+		sqlite3_finalize(statement);
+		FreeYapDatabaseString(&_collection);
+	}
+	
+	if (minRowidPtr) *minRowidPtr = minRowid;
+	if (maxRowidPtr) *maxRowidPtr = maxRowid;
+	return found;
+}
+
+/**
+ * Enumerates the rows of the given collection within the rowid range (afterRowid, throughRowid], in rowid order.
+ *
+ * This is designed for scanning a collection in parallel (each range on its own connection, at the same snapshot).
+ * The rows are looked up via the rowid (i.e. the table's btree), so disjoint ranges touch disjoint pages.
+ * Like _enumerateRowsAfterRowid:, the objects aren't added to the cache.
+**/
+- (void)_enumerateRowsInCollection:(NSString *)collection
+                        afterRowid:(int64_t)afterRowid
+                      throughRowid:(int64_t)throughRowid
+                        usingBlock:(void (^)(int64_t rowid, NSString *key, id object, id metadata, BOOL *stop))block
+{
+	if (block == NULL || throughRowid <= afterRowid) return;
+	if (collection == nil) collection = @"";
+	
+	// SELECT "rowid", "key", "data", "metadata" FROM "database2"
+	//   WHERE "rowid" > ? AND "rowid" <= ? AND "collection" = ? ORDER BY "rowid" ASC;
+	
+	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+	int const column_idx_key      = SQLITE_COLUMN_START + 1;
+	int const column_idx_data     = SQLITE_COLUMN_START + 2;
+	int const column_idx_metadata = SQLITE_COLUMN_START + 3;
+	int const bind_idx_afterRowid   = SQLITE_BIND_START + 0;
+	int const bind_idx_throughRowid = SQLITE_BIND_START + 1;
+	int const bind_idx_collection   = SQLITE_BIND_START + 2;
+	
+	const char *query =
+	  "SELECT \"rowid\", \"key\", \"data\", \"metadata\" FROM \"database2\""
+	  " WHERE \"rowid\" > ? AND \"rowid\" <= ? AND \"collection\" = ? ORDER BY \"rowid\" ASC;";
+	
+	sqlite3_stmt *statement;
+	
+	int status = sqlite3_prepare_v2(connection->db, query, -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error creating 'rowsInCollectionRange' statement: %d %s",
+		            status, sqlite3_errmsg(connection->db));
+		return;
+	}
+	
+	sqlite3_bind_int64(statement, bind_idx_afterRowid, afterRowid);
+	sqlite3_bind_int64(statement, bind_idx_throughRowid, throughRowid);
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+		int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+		
+		id object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
+		id metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+		                                            statement, column_idx_metadata);
+		
+		block(rowid, key, object, metadata, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_finalize(statement);
+	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+}
+
+/**
+ * Fetches the rowid for each given key.
+ *
+ * The rowids are delivered unordered, which is why the block has a keyIndex parameter.
+ * If a key doesn't exist in the database, the block is never invoked for its keyIndex.
+**/
+- (void)_enumerateRowidsForKeys:(NSArray *)keys
+                   inCollection:(NSString *)collection
+            unorderedUsingBlock:(void (^)(NSUInteger keyIndex, int64_t rowid, BOOL *stop))block
+{
+	if (block == NULL) return;
+	if (keys.count == 0) return;
+	if (collection == nil) collection = @"";
+	
+	if (keys.count == 1)
+	{
+		int64_t rowid = 0;
+		if ([self getRowid:&rowid forKey:[keys firstObject] inCollection:collection])
+		{
+			BOOL stop = NO;
+			block(0, rowid, &stop);
+		}
+		
+		return;
 	}
 	
 	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
@@ -4191,1292 +5711,4145 @@
 	FreeYapDatabaseString(&_collection);
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Extensions
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Returns an extension transaction corresponding to the extension type registered under the given name.
- * If the extension has not yet been prepared, it is done so automatically.
- *
- * @return
- *     A subclass of YapDatabaseExtensionTransaction,
- *     according to the type of extension registered under the given name.
+ * Fetches the object and/or metadata for each given key.
  *
- * One must register an extension with the database before it can be accessed from within connections or transactions.
- * After registration everything works automatically using just the registered extension name.
+ * This is the underlying implementation for the various multi-key fetch methods.
+ * Items are first pulled from the objectCache & metadataCache.
+ * Any cache misses are then fetched from the database using as few queries as possible.
+ * That is, a single "key IN (?, ?, ...)" query per SQLITE_LIMIT_VARIABLE_NUMBER keys.
+ * Items fetched from the database are added to the caches (including the keyCache).
  *
- * @see [YapDatabase registerExtension:withName:]
+ * The items are delivered unordered, which is why the block has a keyIndex parameter.
+ * If a key doesn't exist in the database, the block is invoked with nil object & metadata.
 **/
-- (id)extension:(NSString *)extensionName
+- (void)_enumerateRowsForKeys:(NSArray *)keys
+                 inCollection:(NSString *)collection
+                  withObjects:(BOOL)withObjects
+                     metadata:(BOOL)withMetadata
+          unorderedUsingBlock:(void (^)(NSUInteger keyIndex, id object, id metadata, BOOL *stop))block
 {
-	// This method is PUBLIC
+	if (block == NULL) return;
+	if (keys.count == 0) return;
+	if (!withObjects && !withMetadata) return;
+	if (collection == nil) collection = @"";
 	
-	if (extensionsReady)
-		return [extensions objectForKey:extensionName];
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
 	
-	if (extensions == nil)
-		extensions = [[NSMutableDictionary alloc] init];
+	// Check the cache first (to optimize cache)
 	
-	YapDatabaseExtensionTransaction *extTransaction = [extensions objectForKey:extensionName];
-	if (extTransaction == nil)
+	NSMutableArray<NSNumber *> *missingIndexes = [NSMutableArray arrayWithCapacity:keys.count];
+	NSUInteger keyIndex = 0;
+	
+	for (NSString *key in keys)
 	{
-		YapDatabaseExtensionConnection *extConnection = [connection extension:extensionName];
-		if (extConnection)
+		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		id object = nil;
+		id metadata = nil;
+		BOOL cached = YES;
+		
+		if (withObjects)
 		{
-			if (isReadWriteTransaction)
-				extTransaction = [extConnection newReadWriteTransaction:(YapDatabaseReadWriteTransaction *)self];
-			else
-				extTransaction = [extConnection newReadTransaction:self];
+			object = [connection->objectCache objectForKey:cacheKey];
+			if (object == nil) cached = NO;
+		}
+		if (withMetadata && cached)
+		{
+			metadata = [connection->metadataCache objectForKey:cacheKey];
+			if (metadata == nil) cached = NO;
+		}
+		
+		if (cached)
+		{
+			if (metadata == [YapNull null])
+				metadata = nil;
 			
-			if ([extTransaction prepareIfNeeded])
-			{
-				[extensions setObject:extTransaction forKey:extensionName];
-			}
-			else
-			{
-				extTransaction = nil;
-			}
+			block(keyIndex, object, metadata, &stop);
+			
+			if (stop || mutation.isMutated) break;
 		}
-	}
-	
+		else
+		{
+			[missingIndexes addObject:@(keyIndex)];
+		}
+		
+		keyIndex++;
+	}
+	
+	if (stop) {
+		return;
+	}
+	if (mutation.isMutated) {
+		@throw [self mutationDuringEnumerationException];
+		return;
+	}
+	if (missingIndexes.count == 0) {
+		return;
+	}
+	
+	// Go to database for any missing keys (if needed)
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	
+	NSMutableDictionary<NSString *, NSNumber *> *keyIndexDict = nil;
+	
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// We need to watch out for this in case a large array of keys is passed.
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger offset = 0;
+	
+	do
+	{
+		// Determine how many parameters to use in the query
+		
+		NSUInteger left = missingIndexes.count - offset;
+		NSUInteger numKeyParams = MIN(left, (maxHostParams-1)); // minus 1 for collection param
+		
+		// Create the SQL query:
+		//
+		// SELECT "rowid", "key", "data", "metadata" FROM "database2" WHERE "collection" = ? AND key IN (?, ?, ...);
+		//
+		// Note: The "data" and/or "metadata" columns are omitted if not requested.
+		
+		int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+		int const column_idx_key      = SQLITE_COLUMN_START + 1;
+		int const column_idx_data     = SQLITE_COLUMN_START + 2;
+		int const column_idx_metadata = SQLITE_COLUMN_START + (withObjects ? 3 : 2);
+		
+		NSUInteger capacity = 100 + (numKeyParams * 3);
+		NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
+		
+		[query appendString:@"SELECT \"rowid\", \"key\""];
+		if (withObjects) {
+			[query appendString:@", \"data\""];
+		}
+		if (withMetadata) {
+			[query appendString:@", \"metadata\""];
+		}
+		[query appendString:@" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" IN ("];
+		
+		NSUInteger i;
+		for (i = 0; i < numKeyParams; i++)
+		{
+			if (i == 0)
+				[query appendString:@"?"];
+			else
+				[query appendString:@", ?"];
+		}
+		
+		[query appendString:@");"];
+		
+		sqlite3_stmt *statement;
+		
+		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating 'rowsForKeys' statement: %d %s",
+						status, sqlite3_errmsg(connection->db));
+			break; // Break from do/while. Still need to free _collection.
+		}
+		
+		// Bind parameters.
+		// And move objects from the missingIndexes array into keyIndexDict.
+		
+		if (keyIndexDict == nil)
+			keyIndexDict = [NSMutableDictionary dictionaryWithCapacity:numKeyParams];
+		else
+			[keyIndexDict removeAllObjects];
+		
+		sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
+		
+		for (i = 0; i < numKeyParams; i++)
+		{
+			NSNumber *keyIndexNumber = missingIndexes[offset + i];
+			NSString *key = keys[[keyIndexNumber unsignedIntegerValue]];
+			
+			keyIndexDict[key] = keyIndexNumber;
+			
+			sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + 1 + i), [key UTF8String], -1, SQLITE_TRANSIENT);
+		}
+		
+		offset += numKeyParams;
+		
+		// Execute the query and step over the results
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+			
+			const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+			int textSize = sqlite3_column_bytes(statement, column_idx_key);
+			
+			NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+			keyIndex = [keyIndexDict[key] unsignedIntegerValue];
+			
+			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
+			
+			// Note: When we checked the caches (above),
+			// we could only process the item if every requested value was cached.
+			// So it's worthwhile to check each individual cache here.
+			
+			id object = nil;
+			if (withObjects)
+			{
+				object = [connection->objectCache objectForKey:cacheKey];
+				if (object == nil)
+				{
+					const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+					
+					// Performance tuning:
+					// Deserialize straight from the column buffer to avoid an extra allocation and memcpy.
+					
+					object = YapDatabaseDeserializeObject(connection->database, collection, key, oBlob, oBlobSize);
+					
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+						[connection->objectCache setObject:object forKey:cacheKey];
+				}
+			}
+			
+			id metadata = nil;
+			if (withMetadata)
+			{
+				metadata = [connection->metadataCache objectForKey:cacheKey];
+				if (metadata)
+				{
+					if (metadata == [YapNull null])
+						metadata = nil;
+				}
+				else
+				{
+					metadata = YapDatabaseMetadataFromColumn(connection->database, collection, key,
+					                                         statement, column_idx_metadata);
+					
+					if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
+					{
+						if (metadata)
+							[connection->metadataCache setObject:metadata forKey:cacheKey];
+						else
+							[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+					}
+				}
+			}
+			
+			block(keyIndex, object, metadata, &stop);
+			
+			[keyIndexDict removeObjectForKey:key];
+			
+			if (stop || mutation.isMutated) break;
+		}
+		
+		if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+		{
+			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+		}
+		
+		sqlite3_finalize(statement);
+		statement = NULL;
+		
+		if (stop) {
+			FreeYapDatabaseString(&_collection);
+			return;
+		}
+		if (mutation.isMutated) {
+			FreeYapDatabaseString(&_collection);
+			@throw [self mutationDuringEnumerationException];
+			return;
+		}
+		
+		// If there are any remaining items in the keyIndexDict,
+		// then those items didn't exist in the database.
+		
+		for (NSNumber *keyIndexNumber in [keyIndexDict objectEnumerator])
+		{
+			block([keyIndexNumber unsignedIntegerValue], nil, nil, &stop);
+			
+			// Do NOT add keys to the cache that don't exist in the database.
+			
+			if (stop || mutation.isMutated) break;
+		}
+		
+		if (stop) {
+			FreeYapDatabaseString(&_collection);
+			return;
+		}
+		if (mutation.isMutated) {
+			FreeYapDatabaseString(&_collection);
+			@throw [self mutationDuringEnumerationException];
+			return;
+		}
+		
+	} while (offset < missingIndexes.count);
+	
+	FreeYapDatabaseString(&_collection);
+}
+
+/**
+ * Fetches the collection/key, and the object and/or metadata, for each given rowid.
+ *
+ * This is the rowid equivalent of _enumerateRowsForKeys:inCollection:withObjects:metadata:unorderedUsingBlock:.
+ * Items are first pulled from the keyCache, objectCache & metadataCache.
+ * Any cache misses are then fetched from the database using a single "rowid IN (?, ?, ...)" query
+ * per SQLITE_LIMIT_VARIABLE_NUMBER rowids.
+ *
+ * The items are delivered unordered, which is why the block has a rowidIndex parameter.
+ * If a rowid doesn't exist in the database, the block is never invoked for its rowidIndex.
+**/
+- (void)_enumerateRowsForRowids:(NSArray<NSNumber *> *)rowids
+                    withObjects:(BOOL)withObjects
+                       metadata:(BOOL)withMetadata
+            unorderedUsingBlock:(void (^)(NSUInteger rowidIndex, YapCollectionKey *ck,
+                                          id object, id metadata, BOOL *stop))block
+{
+	if (block == NULL) return;
+	if (rowids.count == 0) return;
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	// Check the cache first (to optimize cache)
+	
+	NSMutableArray<NSNumber *> *missingIndexes = [NSMutableArray arrayWithCapacity:rowids.count];
+	NSUInteger rowidIndex = 0;
+	
+	for (NSNumber *rowidNumber in rowids)
+	{
+		YapCollectionKey *ck = [connection->keyCache objectForRowid:[rowidNumber longLongValue]];
+		
+		id object = nil;
+		id metadata = nil;
+		BOOL cached = (ck != nil);
+		
+		if (withObjects && cached)
+		{
+			object = [connection->objectCache objectForKey:ck];
+			if (object == nil) cached = NO;
+		}
+		if (withMetadata && cached)
+		{
+			metadata = [connection->metadataCache objectForKey:ck];
+			if (metadata == nil) cached = NO;
+		}
+		
+		if (cached)
+		{
+			if (metadata == [YapNull null])
+				metadata = nil;
+			
+			block(rowidIndex, ck, object, metadata, &stop);
+			
+			if (stop || mutation.isMutated) break;
+		}
+		else
+		{
+			[missingIndexes addObject:@(rowidIndex)];
+		}
+		
+		rowidIndex++;
+	}
+	
+	if (stop) {
+		return;
+	}
+	if (mutation.isMutated) {
+		@throw [self mutationDuringEnumerationException];
+		return;
+	}
+	if (missingIndexes.count == 0) {
+		return;
+	}
+	
+	// Go to database for any missing rowids
+	
+	NSMutableDictionary<NSNumber *, NSNumber *> *rowidIndexDict = nil;
+	
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// We need to watch out for this in case a large array of rowids is passed.
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger offset = 0;
+	
+	do
+	{
+		NSUInteger left = missingIndexes.count - offset;
+		NSUInteger numRowidParams = MIN(left, maxHostParams);
+		
+		// Create the SQL query:
+		//
+		// SELECT "rowid", "collection", "key", "data", "metadata" FROM "database2" WHERE "rowid" IN (?, ?, ...);
+		//
+		// Note: The "data" and/or "metadata" columns are omitted if not requested.
+		
+		int const column_idx_rowid      = SQLITE_COLUMN_START + 0;
+		int const column_idx_collection = SQLITE_COLUMN_START + 1;
+		int const column_idx_key        = SQLITE_COLUMN_START + 2;
+		int const column_idx_data       = SQLITE_COLUMN_START + 3;
+		int const column_idx_metadata   = SQLITE_COLUMN_START + (withObjects ? 4 : 3);
+		
+		NSUInteger capacity = 100 + (numRowidParams * 3);
+		NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
+		
+		[query appendString:@"SELECT \"rowid\", \"collection\", \"key\""];
+		if (withObjects) {
+			[query appendString:@", \"data\""];
+		}
+		if (withMetadata) {
+			[query appendString:@", \"metadata\""];
+		}
+		[query appendString:@" FROM \"database2\" WHERE \"rowid\" IN ("];
+		
+		NSUInteger i;
+		for (i = 0; i < numRowidParams; i++)
+		{
+			if (i == 0)
+				[query appendString:@"?"];
+			else
+				[query appendString:@", ?"];
+		}
+		
+		[query appendString:@");"];
+		
+		sqlite3_stmt *statement;
+		
+		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating 'rowsForRowids' statement: %d %s",
+						status, sqlite3_errmsg(connection->db));
+			break;
+		}
+		
+		if (rowidIndexDict == nil)
+			rowidIndexDict = [NSMutableDictionary dictionaryWithCapacity:numRowidParams];
+		else
+			[rowidIndexDict removeAllObjects];
+		
+		for (i = 0; i < numRowidParams; i++)
+		{
+			NSNumber *rowidIndexNumber = missingIndexes[offset + i];
+			NSNumber *rowidNumber = rowids[[rowidIndexNumber unsignedIntegerValue]];
+			
+			rowidIndexDict[rowidNumber] = rowidIndexNumber;
+			
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), [rowidNumber longLongValue]);
+		}
+		
+		offset += numRowidParams;
+		
+		// Execute the query and step over the results
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+			NSNumber *rowidNumber = @(rowid);
+			
+			rowidIndex = [rowidIndexDict[rowidNumber] unsignedIntegerValue];
+			
+			YapCollectionKey *ck = [connection->keyCache objectForRowid:rowid];
+			if (ck == nil)
+			{
+				const unsigned char *text0 = sqlite3_column_text(statement, column_idx_collection);
+				int textSize0 = sqlite3_column_bytes(statement, column_idx_collection);
+				
+				const unsigned char *text1 = sqlite3_column_text(statement, column_idx_key);
+				int textSize1 = sqlite3_column_bytes(statement, column_idx_key);
+				
+				NSString *collection, *key;
+				
+				collection = [[NSString alloc] initWithBytes:text0 length:textSize0 encoding:NSUTF8StringEncoding];
+				key        = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+				
+				ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+				
+				[connection->keyCache setObject:ck forRowid:rowid];
+			}
+			
+			id object = nil;
+			if (withObjects)
+			{
+				object = [connection->objectCache objectForKey:ck];
+				if (object == nil)
+				{
+					const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+					
+					object = YapDatabaseDeserializeObject(connection->database, ck.collection, ck.key, oBlob, oBlobSize);
+					
+					if (object && (cachePolicy != YapDatabaseTransactionCachePolicyBypass))
+						[connection->objectCache setObject:object forKey:ck];
+				}
+			}
+			
+			id metadata = nil;
+			if (withMetadata)
+			{
+				metadata = [connection->metadataCache objectForKey:ck];
+				if (metadata)
+				{
+					if (metadata == [YapNull null])
+						metadata = nil;
+				}
+				else
+				{
+					metadata = YapDatabaseMetadataFromColumn(connection->database, ck.collection, ck.key,
+					                                         statement, column_idx_metadata);
+					
+					if (cachePolicy != YapDatabaseTransactionCachePolicyBypass)
+					{
+						if (metadata)
+							[connection->metadataCache setObject:metadata forKey:ck];
+						else
+							[connection->metadataCache setObject:[YapNull null] forKey:ck];
+					}
+				}
+			}
+			
+			block(rowidIndex, ck, object, metadata, &stop);
+			
+			if (stop || mutation.isMutated) break;
+		}
+		
+		if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+		{
+			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+		}
+		
+		sqlite3_finalize(statement);
+		statement = NULL;
+		
+		if (stop) {
+			return;
+		}
+		if (mutation.isMutated) {
+			@throw [self mutationDuringEnumerationException];
+			return;
+		}
+		
+	} while (offset < missingIndexes.count);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Expiration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Fetches the expiration date (as a timeIntervalSince1970) of the given row.
+ * Returns NO if the row doesn't have an expiration date.
+**/
+- (BOOL)getExpiration:(NSTimeInterval *)expirationPtr forRowid:(int64_t)rowid
+{
+	sqlite3_stmt *statement = [connection getExpirationForRowidStatement];
+	if (statement == NULL) return NO;
+	
+	// SELECT "expires" FROM "yap_expiration" WHERE "rowid" = ?;
+	
+	int const column_idx_expires = SQLITE_COLUMN_START;
+	int const bind_idx_rowid     = SQLITE_BIND_START;
+	
+	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+	
+	BOOL result = NO;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		if (expirationPtr) *expirationPtr = sqlite3_column_double(statement, column_idx_expires);
+		result = YES;
+	}
+	else if (status == SQLITE_ERROR)
+	{
+		YDBLogError(@"Error executing 'getExpirationForRowidStatement': %d %s",
+		            status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return result;
+}
+
+/**
+ * Returns YES if the collection is one of the expiringCollections,
+ * and the row has an expiration date that has passed.
+ * 
+ * This is checked before the caches, as an expired object may still be cached.
+**/
+- (BOOL)isExpiredCollectionKey:(YapCollectionKey *)cacheKey
+{
+	YapDatabase *database = connection->database;
+	
+	if (!database->expirationEnabled) return NO;
+	if (![database->expiringCollections containsObject:cacheKey.collection]) return NO;
+	
+	int64_t rowid = 0;
+	if (![self getRowid:&rowid forCollectionKey:cacheKey]) return NO;
+	
+	NSTimeInterval expiration = 0;
+	if (![self getExpiration:&expiration forRowid:rowid]) return NO;
+	
+	return (expiration <= [[NSDate date] timeIntervalSince1970]);
+}
+
+- (NSDate *)expirationForKey:(NSString *)key inCollection:(NSString *)collection
+{
+	if (key == nil) return nil;
+	if (collection == nil) collection = @"";
+	
+	if (!connection->database->expirationEnabled) return nil;
+	
+	int64_t rowid = 0;
+	if (![self getRowid:&rowid forKey:key inCollection:collection]) return nil;
+	
+	NSTimeInterval expiration = 0;
+	if (![self getExpiration:&expiration forRowid:rowid]) return nil;
+	
+	return [NSDate dateWithTimeIntervalSince1970:expiration];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Extensions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns an extension transaction corresponding to the extension type registered under the given name.
+ * If the extension has not yet been prepared, it is done so automatically.
+ *
+ * @return
+ *     A subclass of YapDatabaseExtensionTransaction,
+ *     according to the type of extension registered under the given name.
+ *
+ * One must register an extension with the database before it can be accessed from within connections or transactions.
+ * After registration everything works automatically using just the registered extension name.
+ *
+ * @see [YapDatabase registerExtension:withName:]
+**/
+- (id)extension:(NSString *)extensionName
+{
+	// This method is PUBLIC
+	
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordExtension:extensionName];
+	}
+	
+	if (extensionsReady)
+		return [extensions objectForKey:extensionName];
+	
+	if (extensions == nil)
+		extensions = [[NSMutableDictionary alloc] init];
+	else
+		[self discardStaleExtensions];
+	
+	YapDatabaseExtensionTransaction *extTransaction = [extensions objectForKey:extensionName];
+	if (extTransaction == nil)
+	{
+		YapDatabaseExtensionConnection *extConnection = [connection extension:extensionName];
+		if (extConnection)
+		{
+			if (isReadWriteTransaction)
+				extTransaction = [extConnection newReadWriteTransaction:(YapDatabaseReadWriteTransaction *)self];
+			else
+				extTransaction = [extConnection newReadTransaction:self];
+			
+			if ([extTransaction prepareIfNeeded])
+			{
+				[extensions setObject:extTransaction forKey:extensionName];
+			}
+			else
+			{
+				extTransaction = nil;
+			}
+		}
+	}
+	
 	return extTransaction;
 }
 
-- (id)ext:(NSString *)extensionName
+- (id)ext:(NSString *)extensionName
+{
+	// This method is PUBLIC
+	
+	// The "+ (void)load" method swizzles the implementation of this class
+	// to point to the implementation of the extension: method.
+	//
+	// So the two methods are literally the same thing.
+	
+	return [self extension:extensionName]; // This method is swizzled !
+}
+
+/**
+ * Extension transactions may be left over from a previous use of this (recycled) transaction.
+ * They're only valid if the snapshot hasn't changed since,
+ * as extension transactions may capture snapshot specific state (e.g. memory table transactions).
+**/
+- (void)discardStaleExtensions
+{
+	uint64_t snapshot = [connection snapshot];
+	
+	if (extensionsSnapshot != snapshot)
+	{
+		[extensions removeAllObjects];
+		extensionsSnapshot = snapshot;
+	}
+}
+
+- (void)prepareExtensions
+{
+	if (extensions == nil)
+		extensions = [[NSMutableDictionary alloc] init];
+	else
+		[self discardStaleExtensions];
+	
+	NSDictionary *extConnections = [connection extensions];
+	
+	[extConnections enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		__unsafe_unretained NSString *extName = key;
+		__unsafe_unretained YapDatabaseExtensionConnection *extConnection = obj;
+		
+		YapDatabaseExtensionTransaction *extTransaction = [extensions objectForKey:extName];
+		if (extTransaction == nil)
+		{
+			if (isReadWriteTransaction)
+				extTransaction = [extConnection newReadWriteTransaction:(YapDatabaseReadWriteTransaction *)self];
+			else
+				extTransaction = [extConnection newReadTransaction:self];
+			
+			if ([extTransaction prepareIfNeeded])
+			{
+				[extensions setObject:extTransaction forKey:extName];
+			}
+		}
+		
+	#pragma clang diagnostic pop
+	}];
+	
+	if (orderedExtensions == nil)
+		orderedExtensions = [[NSMutableArray alloc] initWithCapacity:[extensions count]];
+	
+	extensionsHaveInterestedCollections = NO;
+	
+	for (NSString *extName in connection->extensionsOrder)
+	{
+		YapDatabaseExtensionTransaction *extTransaction = [extensions objectForKey:extName];
+		if (extTransaction)
+		{
+			[orderedExtensions addObject:extTransaction];
+			
+			if ([[[extTransaction extensionConnection] extension] interestedCollections])
+				extensionsHaveInterestedCollections = YES;
+		}
+	}
+	
+	[orderedExtensionsByCollection removeAllObjects];
+	extensionsReady = YES;
+}
+
+- (NSDictionary *)extensions
+{
+	// This method is INTERNAL
+	
+	if (!extensionsReady)
+	{
+		[self prepareExtensions];
+	}
+	
+	return extensions;
+}
+
+- (NSArray *)orderedExtensions
+{
+	// This method is INTERNAL
+	
+	if (!extensionsReady)
+	{
+		[self prepareExtensions];
+	}
+	
+	return orderedExtensions;
+}
+
+/**
+ * Returns the orderedExtensions, minus those that aren't interested in the given collection.
+ * See -[YapDatabaseExtension interestedCollections].
+ *
+ * The row hooks use this, so an extension with allowedCollections doesn't receive (and ignore) every change.
+ * The result is cached per collection, for the duration of the transaction.
+ *
+ * During a bulk load, the extensions whose row hooks are suspended are excluded as well.
+**/
+- (NSArray *)orderedExtensionsForCollection:(NSString *)collection
+{
+	// This method is INTERNAL
+	
+	NSArray *allExtensions = [self orderedExtensions];
+	if (!extensionsHaveInterestedCollections && bulkLoadExtensions == nil) return allExtensions;
+	
+	if (collection == nil) collection = @"";
+	
+	NSArray *result = [orderedExtensionsByCollection objectForKey:collection];
+	if (result == nil)
+	{
+		NSMutableArray *interested = [NSMutableArray arrayWithCapacity:allExtensions.count];
+		
+		for (YapDatabaseExtensionTransaction *extTransaction in allExtensions)
+		{
+			if ([bulkLoadExtensions containsObject:extTransaction]) continue;
+			
+			YapWhitelistBlacklist *interestedCollections =
+			  [[[extTransaction extensionConnection] extension] interestedCollections];
+			
+			if (interestedCollections == nil || [interestedCollections isAllowed:collection])
+			{
+				[interested addObject:extTransaction];
+			}
+		}
+		
+		result = [interested copy];
+		
+		if (orderedExtensionsByCollection == nil)
+			orderedExtensionsByCollection = [[NSMutableDictionary alloc] init];
+		
+		[orderedExtensionsByCollection setObject:result forKey:collection];
+	}
+	
+	return result;
+}
+
+/**
+ * Sets the extensions whose row hooks are suspended (see -[YapDatabaseReadWriteTransaction beginBulkLoad]).
+**/
+- (void)setBulkLoadExtensions:(NSSet<YapDatabaseExtensionTransaction *> *)extTransactions
+{
+	// This method is INTERNAL
+	
+	bulkLoadExtensions = [extTransactions count] > 0 ? [extTransactions copy] : nil;
+	[orderedExtensionsByCollection removeAllObjects];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Memory Tables
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (YapMemoryTableTransaction *)memoryTableTransaction:(NSString *)tableName
+{
+	BOOL isYap = [tableName isEqualToString:@"yap"];
+	if (isYap && yapMemoryTableTransaction)
+		return yapMemoryTableTransaction;
+	
+	YapMemoryTableTransaction *memoryTableTransaction = nil;
+		
+	YapMemoryTable *table = [[connection registeredMemoryTables] objectForKey:tableName];
+	if (table)
+	{
+		uint64_t snapshot = [connection snapshot];
+		
+		if (isReadWriteTransaction)
+			memoryTableTransaction = [table newReadWriteTransactionWithSnapshot:(snapshot + 1)];
+		else
+			memoryTableTransaction = [table newReadTransactionWithSnapshot:snapshot];
+	}
+	
+	if (isYap) {
+		yapMemoryTableTransaction = memoryTableTransaction;
+	}
+	return memoryTableTransaction;
+}
+
+/**
+ * The system automatically creates a special YapMemoryTable that's available for any extension.
+ * This memoryTable is registered under the reserved name @"yap".
+ *
+ * The yapMemoryTableTransaction uses a keyClass of [YapCollectionKey class].
+ * Thus, when using it, you must pass a YapCollectionKey, where collectionKey.collection == extensionName.
+ * 
+ * This memory table is an in-memory alternative to using the yap sqlite table.
+**/
+- (YapMemoryTableTransaction *)yapMemoryTableTransaction
+{
+	return [self memoryTableTransaction:@"yap"];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Yap2 Table
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the value of a yap2 "data" column, in the form used by the (prefetched & cached) yap2 values.
+ * A NULL value is returned as NSNull.
+**/
+static id YapDatabaseExtensionValueFromColumn(sqlite3_stmt *statement, int column)
+{
+	switch (sqlite3_column_type(statement, column))
+	{
+		case SQLITE_INTEGER :
+		{
+			return @(sqlite3_column_int64(statement, column));
+		}
+		case SQLITE_FLOAT :
+		{
+			return @(sqlite3_column_double(statement, column));
+		}
+		case SQLITE_TEXT :
+		{
+			const unsigned char *text = sqlite3_column_text(statement, column);
+			int textSize = sqlite3_column_bytes(statement, column);
+			
+			return [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		}
+		case SQLITE_BLOB :
+		{
+			const void *blob = sqlite3_column_blob(statement, column);
+			int blobSize = sqlite3_column_bytes(statement, column);
+			
+			return [[NSData alloc] initWithBytes:blob length:blobSize];
+		}
+		default :
+		{
+			return [NSNull null];
+		}
+	}
+}
+
+/**
+ * Fetches every yap2 value for the given extensions (using a single query),
+ * and caches them for the remainder of the transaction.
+ *
+ * This is used when registering extensions, where each extension typically performs multiple lookups
+ * (class, classVersion, versionTag, ...) in order to determine if it's already setup.
+ * The cached values are consulted by the various getXValue:forKey:extension: methods.
+ * Modifying the values of an extension drops its cached values.
+**/
+- (void)prefetchValuesForExtensions:(NSArray<NSString *> *)extensionNames
+{
+	if ([extensionNames count] == 0) return;
+	
+	if (prefetchedValues == nil)
+		prefetchedValues = [NSMutableDictionary dictionaryWithCapacity:[extensionNames count]];
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSUInteger offset = 0;
+	
+	do
+	{
+		NSUInteger numParams = MIN([extensionNames count] - offset, maxHostParams);
+		NSArray<NSString *> *batch = [extensionNames subarrayWithRange:NSMakeRange(offset, numParams)];
+		
+		// SELECT "extension", "key", "data" FROM "yap2" WHERE "extension" IN (?, ?, ...);
+		
+		int const column_idx_extension = SQLITE_COLUMN_START + 0;
+		int const column_idx_key       = SQLITE_COLUMN_START + 1;
+		int const column_idx_data      = SQLITE_COLUMN_START + 2;
+		
+		NSMutableString *query = [NSMutableString stringWithCapacity:(70 + (numParams * 3))];
+		[query appendString:@"SELECT \"extension\", \"key\", \"data\" FROM \"yap2\" WHERE \"extension\" IN ("];
+		
+		NSUInteger i;
+		for (i = 0; i < numParams; i++)
+		{
+			if (i == 0)
+				[query appendString:@"?"];
+			else
+				[query appendString:@", ?"];
+		}
+		
+		[query appendString:@");"];
+		
+		sqlite3_stmt *statement;
+		
+		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"Error creating 'prefetchValuesForExtensions' statement: %d %s",
+			            status, sqlite3_errmsg(connection->db));
+			return;
+		}
+		
+		for (i = 0; i < numParams; i++)
+		{
+			NSString *extensionName = batch[i];
+			
+			sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + i), [extensionName UTF8String], -1, SQLITE_TRANSIENT);
+			
+			prefetchedValues[extensionName] = [NSMutableDictionary dictionary];
+		}
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			const unsigned char *text0 = sqlite3_column_text(statement, column_idx_extension);
+			int textSize0 = sqlite3_column_bytes(statement, column_idx_extension);
+			
+			const unsigned char *text1 = sqlite3_column_text(statement, column_idx_key);
+			int textSize1 = sqlite3_column_bytes(statement, column_idx_key);
+			
+			NSString *extensionName, *key;
+			
+			extensionName = [[NSString alloc] initWithBytes:text0 length:textSize0 encoding:NSUTF8StringEncoding];
+			key           = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+			
+			id value = YapDatabaseExtensionValueFromColumn(statement, column_idx_data);
+			
+			[prefetchedValues[extensionName] setObject:(value ?: [NSNull null]) forKey:key];
+		}
+		
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+			
+			[prefetchedValues removeObjectsForKeys:batch];
+		}
+		
+		sqlite3_finalize(statement);
+		offset += numParams;
+		
+	} while (offset < [extensionNames count]);
+}
+
+/**
+ * Returns YES if the values for the given extension were prefetched,
+ * in which case valuePtr is set to the cached value (or nil if there isn't a value for the key).
+ * Returns NO if the value must be fetched from the database.
+ *
+ * A NULL value is reported as NSNull.
+**/
+- (BOOL)getPrefetchedValue:(id *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (prefetchedValues == nil) return NO;
+	
+	NSDictionary *values = prefetchedValues[extensionName];
+	if (values == nil) return NO;
+	
+	if (valuePtr) *valuePtr = values[key];
+	return YES;
+}
+
+/**
+ * Drops the prefetched values for the given extension (if any).
+ * Invoked whenever the values for the extension are modified.
+**/
+- (void)dropPrefetchedValuesForExtension:(NSString *)extensionName
+{
+	[prefetchedValues removeObjectForKey:extensionName];
+}
+
+/**
+ * Returns YES if there's a yap2 row for the given extension & key,
+ * in which case valuePtr is set to its value (with a NULL value reported as NSNull).
+ *
+ * The value is looked up in:
+ * - the values modified during this (read-write) transaction, which are buffered until pre-commit
+ * - the values prefetched during extension registration
+ * - the yap2 values cached by the connection (which match the snapshot of the connection)
+ * - the database, in which case the value is added to the connection's cache
+**/
+- (BOOL)getExtensionValue:(id *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	id value = pendingExtensionValues[extensionName][key];
+	
+	if (value == nil && [pendingRemovedExtensions containsObject:extensionName])
+	{
+		value = [YapNull null];
+	}
+	
+	if (value == nil && [self getPrefetchedValue:&value forKey:key extension:extensionName])
+	{
+		if (value == nil)
+			value = [YapNull null];
+	}
+	
+	// The values of the database itself (empty extensionName) include the snapshot,
+	// which the connection reads & writes directly. So they're never cached.
+	
+	BOOL cacheable = ([extensionName length] > 0);
+	
+	if (value == nil && cacheable)
+	{
+		value = connection->extensionValuesCache[extensionName][key];
+	}
+	
+	if (value == nil)
+	{
+		value = [self fetchExtensionValueForKey:key extension:extensionName];
+		
+		if (value && cacheable)
+		{
+			if (connection->extensionValuesCache == nil)
+				connection->extensionValuesCache = [[NSMutableDictionary alloc] init];
+			
+			NSMutableDictionary *cachedValues = connection->extensionValuesCache[extensionName];
+			if (cachedValues == nil)
+			{
+				cachedValues = [[NSMutableDictionary alloc] init];
+				connection->extensionValuesCache[extensionName] = cachedValues;
+			}
+			
+			cachedValues[key] = value;
+		}
+	}
+	
+	if (value == nil || [value isKindOfClass:[YapNull class]])
+	{
+		if (valuePtr) *valuePtr = nil;
+		return NO;
+	}
+	
+	if (valuePtr) *valuePtr = value;
+	return YES;
+}
+
+/**
+ * Reads the value of the given yap2 row from the database.
+ *
+ * Returns YapNull if there's no such row, NSNull if the value is NULL, and nil on error.
+**/
+- (id)fetchExtensionValueForKey:(NSString *)key extension:(NSString *)extensionName
+{
+	sqlite3_stmt *statement = [connection yapGetDataForKeyStatement];
+	if (statement == NULL) return nil;
+	
+	id value = nil;
+	
+	// SELECT "data" FROM "yap2" WHERE "extension" = ? AND "key" = ? ;
+	
+	int const column_idx_data    = SQLITE_COLUMN_START;
+	int const bind_idx_extension = SQLITE_BIND_START + 0;
+	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	
+	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
+	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	
+	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
+	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		value = YapDatabaseExtensionValueFromColumn(statement, column_idx_data);
+	}
+	else if (status == SQLITE_DONE)
+	{
+		value = [YapNull null];
+	}
+	else
+	{
+		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	FreeYapDatabaseString(&_extension);
+	FreeYapDatabaseString(&_key);
+	
+	return value;
+}
+
+- (BOOL)getBoolValue:(BOOL *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	int intValue = 0;
+	BOOL result = [self getIntValue:&intValue forKey:key extension:extensionName];
+	
+	if (valuePtr) *valuePtr = (intValue == 0) ? NO : YES;
+	return result;
+}
+
+- (BOOL)getIntValue:(int *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (extensionName == nil)
+		extensionName = @"";
+	
+	id value = nil;
+	BOOL result = [self getExtensionValue:&value forKey:key extension:extensionName];
+	
+	if (valuePtr) *valuePtr = [value respondsToSelector:@selector(intValue)] ? [value intValue] : 0;
+	return result;
+}
+
+- (BOOL)getInt64Value:(int64_t *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (extensionName == nil)
+		extensionName = @"";
+	
+	id value = nil;
+	BOOL result = [self getExtensionValue:&value forKey:key extension:extensionName];
+	
+	if (valuePtr) *valuePtr = [value respondsToSelector:@selector(longLongValue)] ? [value longLongValue] : 0;
+	return result;
+}
+
+- (BOOL)getDoubleValue:(double *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (extensionName == nil)
+		extensionName = @"";
+	
+	id value = nil;
+	BOOL result = [self getExtensionValue:&value forKey:key extension:extensionName];
+	
+	if (valuePtr) *valuePtr = [value respondsToSelector:@selector(doubleValue)] ? [value doubleValue] : 0.0;
+	return result;
+}
+
+- (NSString *)stringValueForKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (extensionName == nil)
+		extensionName = @"";
+	
+	id value = nil;
+	[self getExtensionValue:&value forKey:key extension:extensionName];
+	
+	if (value == nil || [value isKindOfClass:[NSString class]])
+		return value;
+	else if ([value isKindOfClass:[NSNumber class]])
+		return [value stringValue];
+	else if ([value isKindOfClass:[NSData class]])
+		return [[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding];
+	else
+		return @""; // NULL
+}
+
+- (NSData *)dataValueForKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (extensionName == nil)
+		extensionName = @"";
+	
+	id value = nil;
+	[self getExtensionValue:&value forKey:key extension:extensionName];
+	
+	if (value == nil || [value isKindOfClass:[NSData class]])
+		return value;
+	else if ([value isKindOfClass:[NSString class]])
+		return [value dataUsingEncoding:NSUTF8StringEncoding];
+	else if ([value isKindOfClass:[NSNumber class]])
+		return [[value stringValue] dataUsingEncoding:NSUTF8StringEncoding];
+	else
+		return [NSData data]; // NULL
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Exceptions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSException *)mutationDuringEnumerationException
+{
+	NSString *reason = [NSString stringWithFormat:
+	    @"Database <%@: %p> was mutated while being enumerated.", NSStringFromClass([self class]), self];
+	
+	NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
+	    @"If you modify the database during enumeration"
+		@" you MUST set the 'stop' parameter of the enumeration block to YES (*stop = YES;)."};
+	
+	return [NSException exceptionWithName:@"YapDatabaseException" reason:reason userInfo:userInfo];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseReadWriteTransaction
+
+#pragma mark Transaction Control
+
+/**
+ * Under normal circumstances, when a read-write transaction block completes,
+ * the changes are automatically committed. If, however, something goes wrong and
+ * you'd like to abort and discard all changes made within the transaction,
+ * then invoke this method.
+ *
+ * You should generally return (exit the transaction block) after invoking this method.
+ * Any changes made within the the transaction before and after invoking this method will be discarded.
+ *
+ * Invoking this method from within a read-only transaction does nothing.
+**/
+- (void)rollback
+{
+	rollback = YES;
+}
+
+/**
+ * The YapDatabaseModifiedNotification is posted following a readwrite transaction which made changes.
+ * 
+ * These notifications are used in a variety of ways:
+ * - They may be used as a general notification mechanism to detect changes to the database.
+ * - They may be used by extensions to post change information.
+ *   For example, YapDatabaseView will post the index changes, which can easily be used to animate a tableView.
+ * - They are integrated into the architecture of long-lived transactions in order to maintain a steady state.
+ *
+ * Thus it is recommended you integrate your own notification information into this existing notification,
+ * as opposed to broadcasting your own separate notification.
+ * 
+ * For more information, and code samples, please see the wiki article:
+ * https://github.com/yapstudios/YapDatabase/wiki/YapDatabaseModifiedNotification
+**/
+@synthesize yapDatabaseModifiedNotificationCustomObject = customObjectForNotification;
+
+/**
+ * When enabled, the changeset reports which collections were changed, rather than which keys.
+ * See the header file for a discussion.
+**/
+@synthesize coarseChangeset = coarseChangeset;
+
+/**
+ * Caps the per-key change information held in memory by this transaction.
+ * See the header file for a discussion.
+**/
+@synthesize changesetSpillThreshold = changesetSpillThreshold;
+@synthesize changesetSpilled = changesetSpilled;
+
+/**
+ * Invoked before each change is recorded in the changeset.
+ *
+ * If the changeset has reached the changesetSpillThreshold, the per-key changes (and the objects they retain)
+ * are replaced by resets of the changed collections, and the rest of the transaction uses a coarse changeset.
+**/
+- (void)spillChangesetIfNeeded
+{
+	if (changesetSpillThreshold == 0) return;
+	
+	NSUInteger count = connection->objectChanges.count + connection->metadataChanges.count
+	                 + connection->insertedKeys.count + connection->removedKeys.count;
+	
+	if (count < changesetSpillThreshold) return;
+	
+	YDBLogVerbose(@"Spilling changeset: %lu changed keys", (unsigned long)count);
+	
+	[connection coarsenChangeset];
+	changesetSpilled = YES;
+}
+
+/**
+ * Yield point for long running transactions.
+ * See the header file for a discussion.
+**/
+- (BOOL)shouldYield
+{
+	return atomic_load_explicit(&connection->database->priorityWritersWaitingCount, memory_order_relaxed) > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Object & Metadata
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The hash of a serialized row, within the contentHashedCollections (see YapDatabaseOptions).
+**/
+typedef struct {
+	BOOL hashed;       // NO if the row isn't subject to content hashing
+	BOOL hasMetadata;
+	int64_t dataHash;
+	int64_t metadataHash;
+} YapDatabaseContentHash;
+
+/**
+ * Returns the hash of the given (encoded) serialized object & metadata.
+ * The result isn't hashed if the collection isn't one of the contentHashedCollections, or uses native metadata.
+**/
+- (YapDatabaseContentHash)contentHashForSerializedObject:(NSData *)serializedObject
+                                      serializedMetadata:(NSData *)serializedMetadata
+                                          nativeMetadata:(BOOL)nativeMetadata
+                                            inCollection:(NSString *)collection
+{
+	YapDatabaseContentHash hash = { NO, NO, 0, 0 };
+	
+	YapDatabase *database = connection->database;
+	if (!database->contentHashEnabled || nativeMetadata) return hash;
+	if (![database->contentHashedCollections containsObject:collection]) return hash;
+	
+	// Empty metadata is hashed the same as nil metadata (both are read back as nil).
+	
+	hash.hashed = YES;
+	hash.dataHash = (int64_t)YapMurmurHashData_64(serializedObject ?: [NSData data]);
+	
+	if (serializedMetadata.length > 0)
+	{
+		hash.hasMetadata = YES;
+		hash.metadataHash = (int64_t)YapMurmurHashData_64(serializedMetadata);
+	}
+	
+	return hash;
+}
+
+/**
+ * Returns YES if the row is currently stored with the given hash (i.e. writing it again wouldn't change anything).
+**/
+- (BOOL)matchesContentHash:(YapDatabaseContentHash)hash forRowid:(int64_t)rowid
+{
+	if (!hash.hashed) return NO;
+	
+	sqlite3_stmt *statement = [connection getContentHashForRowidStatement];
+	if (statement == NULL) return NO;
+	
+	// SELECT "data_hash", "metadata_hash" FROM "yap_content_hash" WHERE "rowid" = ?;
+	
+	int const column_idx_data_hash     = SQLITE_COLUMN_START + 0;
+	int const column_idx_metadata_hash = SQLITE_COLUMN_START + 1;
+	int const bind_idx_rowid           = SQLITE_BIND_START;
+	
+	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+	
+	BOOL matches = NO;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		int64_t dataHash = sqlite3_column_int64(statement, column_idx_data_hash);
+		
+		BOOL hasMetadata = (sqlite3_column_type(statement, column_idx_metadata_hash) != SQLITE_NULL);
+		int64_t metadataHash = hasMetadata ? sqlite3_column_int64(statement, column_idx_metadata_hash) : 0;
+		
+		matches = (dataHash == hash.dataHash) && (hasMetadata == hash.hasMetadata) && (metadataHash == hash.metadataHash);
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'getContentHashForRowidStatement': %d %s",
+		            status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return matches;
+}
+
+/**
+ * Stores the hash of a row that was just written.
+ * (Writing the row deleted any previous hash, via the triggers on the table.)
+**/
+- (void)setContentHash:(YapDatabaseContentHash)hash forRowid:(int64_t)rowid
+{
+	if (!hash.hashed) return;
+	
+	sqlite3_stmt *statement = [connection setContentHashForRowidStatement];
+	if (statement == NULL) return;
+	
+	// INSERT OR REPLACE INTO "yap_content_hash" ("rowid", "data_hash", "metadata_hash") VALUES (?, ?, ?);
+	
+	int const bind_idx_rowid         = SQLITE_BIND_START + 0;
+	int const bind_idx_data_hash     = SQLITE_BIND_START + 1;
+	int const bind_idx_metadata_hash = SQLITE_BIND_START + 2;
+	
+	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+	sqlite3_bind_int64(statement, bind_idx_data_hash, hash.dataHash);
+	
+	if (hash.hasMetadata)
+		sqlite3_bind_int64(statement, bind_idx_metadata_hash, hash.metadataHash);
+	else
+		sqlite3_bind_null(statement, bind_idx_metadata_hash);
+	
+	int status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'setContentHashForRowidStatement': %d %s",
+		            status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+}
+
+/**
+ * Sets the object for the given key/collection.
+ * The object is automatically serialized using the database's configured objectSerializer.
+ *
+ * If you pass nil for the object, then this method will remove the row from the database (if it exists).
+ * This method implicitly sets the associated metadata to nil.
+ *
+ * @param object
+ *   The object to store in the database.
+ *   This object is automatically serialized using the database's configured objectSerializer.
+ *
+ * @param key
+ *   The lookup key.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   This value should not be nil. If a nil key is passed, then this method does nothing.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+**/
+- (void)setObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
+{
+	[self setObject:object forKey:key inCollection:collection withMetadata:nil
+                                                          serializedObject:nil
+	                                                    serializedMetadata:nil];
+}
+
+/**
+ * Sets the object & metadata for the given key/collection.
+ *
+ * If you pass nil for the object, then this method will remove the row from the database (if it exists).
+ *
+ * @param object
+ *   The object to store in the database.
+ *   This object is automatically serialized using the database's configured objectSerializer.
+ *
+ * @param key
+ *   The lookup key.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   This value should not be nil. If a nil key is passed, then this method does nothing.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+ *
+ * @param metadata
+ *   The metadata to store in the database.
+ *   This metadata is automatically serialized using the database's configured metadataSerializer.
+ *   The metadata is optional. You can pass nil for the metadata is unneeded.
+ *   If non-nil then the metadata is also written to the database (metadata is also persistent).
+**/
+- (void)setObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection withMetadata:(id)metadata
+{
+	[self setObject:object forKey:key inCollection:collection withMetadata:metadata
+                                                          serializedObject:nil
+	                                                    serializedMetadata:nil];
+}
+
+/**
+ * Sets the object & metadata for the given key/collection.
+ * 
+ * This method allows for a bit of optimization if you happen to already have a serialized version of
+ * the object and/or metadata. For example, if you downloaded an object in serialized form,
+ * and you still have the raw NSData, then you can use this method to skip the serialization step
+ * when storing the object to the database.
+ *
+ * If you pass nil for the object, then this method will remove the row from the database (if it exists).
+ *
+ * @param object
+ *   The object to store in the database.
+ *   This object is automatically serialized using the database's configured objectSerializer.
+ *
+ * @param key
+ *   The lookup key.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   This value should not be nil. If a nil key is passed, then this method does nothing.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+ *
+ * @param metadata
+ *   The metadata to store in the database.
+ *   This metadata is automatically serialized using the database's configured metadataSerializer.
+ *   The metadata is optional. You can pass nil for the metadata is unneeded.
+ *   If non-nil then the metadata is also written to the database (metadata is also persistent).
+ * 
+ * @param preSerializedObject
+ *   This value is optional.
+ *   If non-nil then the object serialization step is skipped, and this value is used instead.
+ *   It is assumed that preSerializedObject is equal to what we would get if we ran the object through
+ *   the database's configured objectSerializer.
+ * 
+ * @param preSerializedMetadata
+ *   This value is optional.
+ *   If non-nil then the metadata serialization step is skipped, and this value is used instead.
+ *   It is assumed that preSerializedMetadata is equal to what we would get if we ran the metadata through
+ *   the database's configured metadataSerializer.
+ *
+ * The preSerializedObject is only used if object is non-nil.
+ * The preSerializedMetadata is only used if metadata is non-nil.
+**/
+- (void)setObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
+                                                    withMetadata:(id)metadata
+                                                serializedObject:(NSData *)preSerializedObject
+                                              serializedMetadata:(NSData *)preSerializedMetadata
+{
+	if (object == nil)
+	{
+		[self removeObjectForKey:key inCollection:collection];
+		return;
+	}
+	
+	if (key == nil) return;
+	if (collection == nil) collection = @"";
+	
+	if (connection->database->objectPreSanitizer)
+	{
+		object = connection->database->objectPreSanitizer(collection, key, object);
+		if (object == nil)
+		{
+			YDBLogWarn(@"The objectPreSanitizer returned nil for collection(%@) key(%@)", collection, key);
+			
+			[self removeObjectForKey:key inCollection:collection];
+			return;
+		}
+	}
+	if (metadata && connection->database->metadataPreSanitizer)
+	{
+		metadata = connection->database->metadataPreSanitizer(collection, key, metadata);
+		if (metadata == nil)
+		{
+			YDBLogWarn(@"The metadataPresanitizer returned nil for collection(%@) key(%@)", collection, key);
+		}
+	}
+	
+	// To use SQLITE_STATIC on our data, we use the objc_precise_lifetime attribute.
+	// This ensures the data isn't released until it goes out of scope.
+	
+	YapDatabaseTransactionMetrics *metrics = connection->transactionMetrics;
+	uint64_t serializationTime = YapDatabaseTransactionMetricsStart(metrics);
+	
+	__attribute__((objc_precise_lifetime)) NSData *serializedObject = nil;
+	if (preSerializedObject)
+		serializedObject = preSerializedObject;
+	else
+		serializedObject = connection->database->objectSerializer(collection, key, object);
+	
+	serializedObject = [self encodeSerializedObject:serializedObject inCollection:collection];
+	
+	// Native metadata (see YapDatabaseOptions.nativeMetadataTypes) is bound directly, and never serialized.
+	
+	BOOL nativeMetadata = YapDatabaseIsNativeMetadata(connection->database, collection, metadata);
+	
+	__attribute__((objc_precise_lifetime)) NSData *serializedMetadata = nil;
+	if (metadata && !nativeMetadata)
+	{
+		if (preSerializedMetadata)
+			serializedMetadata = preSerializedMetadata;
+		else
+			serializedMetadata = connection->database->metadataSerializer(collection, key, metadata);
+	}
+	
+	if (metrics)
+	{
+		metrics->serializationTicks += YapDatabaseTransactionMetricsElapsed(serializationTime);
+		metrics->serializationCount += (serializedMetadata ? 2 : 1);
+	}
+	
+	if (connection->workloadTrace)
+	{
+		[connection->workloadTrace recordSetRowWithCollection:collection
+		                                                  key:key
+		                                           objectSize:serializedObject.length
+		                                         metadataSize:(metadata ? serializedMetadata.length : NSNotFound)];
+	}
+	
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	
+	// Fetch rowid for <collection, key> tuple
+	
+	int64_t rowid = 0;
+	BOOL found = [self getRowid:&rowid forCollectionKey:cacheKey];
+	
+	// Within the contentHashedCollections (see YapDatabaseOptions),
+	// a row that's already stored exactly as given isn't written again.
+	
+	YapDatabaseContentHash contentHash =
+	  [self contentHashForSerializedObject:serializedObject
+	                    serializedMetadata:serializedMetadata
+	                        nativeMetadata:nativeMetadata
+	                          inCollection:collection];
+	
+	if (found && [self matchesContentHash:contentHash forRowid:rowid])
+	{
+		[connection->objectCache setObject:object forKey:cacheKey];
+		[connection->metadataCache setObject:(metadata ?: [YapNull null]) forKey:cacheKey];
+		
+		if (connection->database->objectPostSanitizer)
+		{
+			connection->database->objectPostSanitizer(collection, key, object);
+		}
+		if (metadata && connection->database->metadataPostSanitizer)
+		{
+			connection->database->metadataPostSanitizer(collection, key, metadata);
+		}
+		return;
+	}
+    
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
+	{
+		if (found)
+			[extTransaction willUpdateObject:object
+			                forCollectionKey:cacheKey
+			                    withMetadata:metadata
+			                           rowid:rowid];
+		else
+			[extTransaction willInsertObject:object
+			                forCollectionKey:cacheKey
+			                    withMetadata:metadata];
+	}
+	
+	BOOL set = YES;
+	
+	if (found) // update data for key
+	{
+		sqlite3_stmt *statement = [connection updateAllForRowidStatement];
+		if (statement == NULL) {
+			return;
+		}
+		
+		// UPDATE "database2" SET "data" = ?, "metadata" = ? WHERE "rowid" = ?;
+		
+		int const bind_idx_data     = SQLITE_BIND_START + 0;
+		int const bind_idx_metadata = SQLITE_BIND_START + 1;
+		int const bind_idx_rowid    = SQLITE_BIND_START + 2;
+		
+		sqlite3_bind_blob(statement, bind_idx_data,
+		                  serializedObject.bytes, (int)serializedObject.length, SQLITE_STATIC);
+		
+		if (nativeMetadata)
+			YapDatabaseBindNativeMetadata(connection->database, collection, metadata, statement, bind_idx_metadata);
+		else
+			sqlite3_bind_blob(statement, bind_idx_metadata,
+			                  serializedMetadata.bytes, (int)serializedMetadata.length, SQLITE_STATIC);
+		
+		sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+		
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'updateAllForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
+			set = NO;
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+	}
+	else // insert data for key
+	{
+		sqlite3_stmt *statement = [connection insertForRowidStatement];
+		if (statement == NULL) {
+			return;
+		}
+		
+		// INSERT INTO "database2" ("collection", "key", "data", "metadata") VALUES (?, ?, ?, ?);
+		//
+		// or, with the collection-id schema:
+		//
+		// INSERT INTO "database3" ("collection_id", "key", "data", "metadata") VALUES (?, ?, ?, ?);
+		
+		int64_t collectionId = 0;
+		if (connection->database->usesCollectionIds)
+		{
+			if (![connection getCollectionId:&collectionId forCollection:collection]) {
+				return;
+			}
+		}
+		
+		int const bind_idx_collection = SQLITE_BIND_START + 0;
+		int const bind_idx_key        = SQLITE_BIND_START + 1;
+		int const bind_idx_data       = SQLITE_BIND_START + 2;
+		int const bind_idx_metadata   = SQLITE_BIND_START + 3;
+		
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		if (connection->database->usesCollectionIds)
+			sqlite3_bind_int64(statement, bind_idx_collection, collectionId);
+		else
+			sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+		
+		YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
+		sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+		
+		sqlite3_bind_blob(statement, bind_idx_data,
+		                  serializedObject.bytes, (int)serializedObject.length, SQLITE_STATIC);
+		
+		if (nativeMetadata)
+			YapDatabaseBindNativeMetadata(connection->database, collection, metadata, statement, bind_idx_metadata);
+		else
+			sqlite3_bind_blob(statement, bind_idx_metadata,
+			                  serializedMetadata.bytes, (int)serializedMetadata.length, SQLITE_STATIC);
+		
+		int status = sqlite3_step(statement);
+		if (status == SQLITE_DONE)
+		{
+			rowid = sqlite3_last_insert_rowid(connection->db);
+			
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
+		}
+		else
+		{
+			YDBLogError(@"Error executing 'insertForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
+			set = NO;
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		FreeYapDatabaseString(&_collection);
+		FreeYapDatabaseString(&_key);
+	}
+	
+	if (!set) return;
+	
+	[self setContentHash:contentHash forRowid:rowid];
+	
+	connection->hasDiskChanges = YES;
+	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	[self spillChangesetIfNeeded];
+	
+	id _object = YapDatabaseChangesetValue(connection->objectPolicy, object);
+	
+	if (!found) {
+		[connection->insertedKeys addObject:cacheKey];
+	}
+	
+	[connection->objectCache setObject:object forKey:cacheKey];
+	[connection->objectChanges setObject:_object forKey:cacheKey];
+	
+	if (metadata)
+	{
+		id _metadata = YapDatabaseChangesetValue(connection->metadataPolicy, metadata);
+		
+		[connection->metadataCache setObject:metadata forKey:cacheKey];
+		[connection->metadataChanges setObject:_metadata forKey:cacheKey];
+	}
+	else
+	{
+		[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+		[connection->metadataChanges setObject:[YapNull null] forKey:cacheKey];
+	}
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
+	{
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		if (found)
+			[extTransaction didUpdateObject:object
+			               forCollectionKey:cacheKey
+			                   withMetadata:metadata
+			                          rowid:rowid];
+		else
+			[extTransaction didInsertObject:object
+			               forCollectionKey:cacheKey
+			                   withMetadata:metadata
+			                          rowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
+	}
+	
+	if (connection->database->objectPostSanitizer)
+	{
+		connection->database->objectPostSanitizer(collection, key, object);
+	}
+	if (metadata && connection->database->metadataPostSanitizer)
+	{
+		connection->database->metadataPostSanitizer(collection, key, metadata);
+	}
+}
+
+/**
+ * The number of rows per unit of work, when evaluating extension handlers concurrently.
+**/
+static NSUInteger const YapDatabaseConcurrentHandlerChunkSize = 128;
+
+/**
+ * Used by setObjects:forKeys:inCollection:withMetadata:
+ *
+ * Extensions that support concurrent handler evaluation (and don't have any dependencies)
+ * evaluate their handler blocks for the batch on background threads.
+ * Each (extension, chunk of rows) pair is an independent unit of work, with its own results array.
+ * Nothing is applied here. The results are handed to each extension (in order) right before its batch hook.
+ *
+ * On return, the results map each participating extTransaction to its results (one item per row).
+**/
+- (void)evaluateHandlersConcurrentlyForExtensions:(NSArray<YapDatabaseExtensionTransaction *> *)orderedExtensions
+                                   updatedObjects:(NSArray *)updatedObjects
+                                  updatedMetadata:(NSArray *)updatedMetadata
+                                 updatedCacheKeys:(NSArray<YapCollectionKey *> *)updatedCacheKeys
+                                  insertedObjects:(NSArray *)insertedObjects
+                                 insertedMetadata:(NSArray *)insertedMetadata
+                                insertedCacheKeys:(NSArray<YapCollectionKey *> *)insertedCacheKeys
+                                   updatedResults:(NSMapTable **)updatedResultsPtr
+                                  insertedResults:(NSMapTable **)insertedResultsPtr
 {
-	// This method is PUBLIC
+	NSUInteger updatedCount = updatedCacheKeys.count;
+	NSUInteger insertedCount = insertedCacheKeys.count;
+	
+	NSMutableArray<YapDatabaseExtensionTransaction *> *eligibleExtensions = nil;
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in orderedExtensions)
+	{
+		if (![extTransaction supportsConcurrentHandlerEvaluation]) continue;
+		
+		YapDatabaseExtension *ext = [[extTransaction extensionConnection] extension];
+		if ([[ext dependencies] count] > 0) continue;
+		
+		if (eligibleExtensions == nil)
+			eligibleExtensions = [[NSMutableArray alloc] initWithCapacity:orderedExtensions.count];
+		
+		[eligibleExtensions addObject:extTransaction];
+	}
+	
+	NSUInteger chunkSize = YapDatabaseConcurrentHandlerChunkSize;
+	
+	NSUInteger updatedChunks = (updatedCount + chunkSize - 1) / chunkSize;
+	NSUInteger insertedChunks = (insertedCount + chunkSize - 1) / chunkSize;
+	NSUInteger chunksPerExtension = updatedChunks + insertedChunks;
+	
+	NSUInteger unitCount = eligibleExtensions.count * chunksPerExtension;
+	if (unitCount < 2)
+	{
+		// Nothing to run concurrently.
+		// The extension (if any) evaluates its handler inline, as usual.
+		return;
+	}
+	
+	NSMutableArray<NSMutableArray *> *unitResults = [[NSMutableArray alloc] initWithCapacity:unitCount];
+	for (NSUInteger i = 0; i < unitCount; i++)
+	{
+		[unitResults addObject:[[NSMutableArray alloc] initWithCapacity:chunkSize]];
+	}
+	
+	NSArray<YapDatabaseExtensionTransaction *> *extensionsSnapshot = [eligibleExtensions copy];
+	NSArray<NSMutableArray *> *unitResultsSnapshot = [unitResults copy];
+	
+	dispatch_queue_t queue = dispatch_get_global_queue(qos_class_self(), 0);
+	dispatch_apply(unitCount, queue, ^(size_t unit) { @autoreleasepool {
+		
+		YapDatabaseExtensionTransaction *extTransaction = extensionsSnapshot[unit / chunksPerExtension];
+		NSUInteger chunk = unit % chunksPerExtension;
+		
+		BOOL isInsert = (chunk >= updatedChunks);
+		if (isInsert) chunk -= updatedChunks;
+		
+		NSUInteger count = isInsert ? insertedCount : updatedCount;
+		NSUInteger location = chunk * chunkSize;
+		NSRange range = NSMakeRange(location, MIN(chunkSize, count - location));
+		
+		if (isInsert)
+			[extTransaction evaluateHandlersForObjects:insertedObjects
+			                         forCollectionKeys:insertedCacheKeys
+			                              withMetadata:insertedMetadata
+			                                     range:range
+			                                  isInsert:YES
+			                                   results:unitResultsSnapshot[unit]];
+		else
+			[extTransaction evaluateHandlersForObjects:updatedObjects
+			                         forCollectionKeys:updatedCacheKeys
+			                              withMetadata:updatedMetadata
+			                                     range:range
+			                                  isInsert:NO
+			                                   results:unitResultsSnapshot[unit]];
+	}});
+	
+	// Concatenate the chunks (per extension)
+	
+	NSMapTable *updatedResults = [NSMapTable strongToStrongObjectsMapTable];
+	NSMapTable *insertedResults = [NSMapTable strongToStrongObjectsMapTable];
+	
+	NSUInteger unit = 0;
+	for (YapDatabaseExtensionTransaction *extTransaction in extensionsSnapshot)
+	{
+		NSMutableArray *extUpdatedResults = [[NSMutableArray alloc] initWithCapacity:updatedCount];
+		NSMutableArray *extInsertedResults = [[NSMutableArray alloc] initWithCapacity:insertedCount];
+		
+		for (NSUInteger chunk = 0; chunk < chunksPerExtension; chunk++)
+		{
+			if (chunk < updatedChunks)
+				[extUpdatedResults addObjectsFromArray:unitResults[unit]];
+			else
+				[extInsertedResults addObjectsFromArray:unitResults[unit]];
+			
+			unit++;
+		}
+		
+		// If the extension didn't provide a result for every row,
+		// then it doesn't receive any, and evaluates its handler inline (as usual).
+		
+		if (updatedCount > 0)
+		{
+			if (extUpdatedResults.count == updatedCount)
+				[updatedResults setObject:extUpdatedResults forKey:extTransaction];
+			else
+				YDBLogWarn(@"%@ - Extension(%@) returned incomplete handler results, evaluating inline",
+				           THIS_METHOD, [extTransaction class]);
+		}
+		
+		if (insertedCount > 0)
+		{
+			if (extInsertedResults.count == insertedCount)
+				[insertedResults setObject:extInsertedResults forKey:extTransaction];
+			else
+				YDBLogWarn(@"%@ - Extension(%@) returned incomplete handler results, evaluating inline",
+				           THIS_METHOD, [extTransaction class]);
+		}
+	}
+	
+	*updatedResultsPtr = updatedResults;
+	*insertedResultsPtr = insertedResults;
+}
+
+/**
+ * Sets multiple objects (with optional metadata) in the given collection.
+ *
+ * This is equivalent to invoking setObject:forKey:inCollection:withMetadata: for each key,
+ * but is considerably faster for large batches:
+ *
+ * - The rowids for all keys are looked up using a handful of queries (rather than one query per key)
+ * - The insert & update statements are bound & stepped in a tight loop
+ * - Extensions receive the entire batch via didInsertObjects:... & didUpdateObjects:...
+ *
+ * Note: If a key appears multiple times in the given array, only the last occurrence is used.
+**/
+- (void)setObjects:(NSArray *)objects forKeys:(NSArray *)keys inCollection:(NSString *)collection
+{
+	[self setObjects:objects forKeys:keys inCollection:collection withMetadata:nil];
+}
+
+/**
+ * Sets multiple objects & metadata in the given collection.
+ *
+ * The objects array must be the same size as the keys array.
+ * The metadata array is optional. If non-nil, it must be the same size as the keys array,
+ * and [NSNull null] may be used for any key that doesn't have metadata.
+ *
+ * Note: If a key appears multiple times in the given array, only the last occurrence is used.
+ *
+ * @see setObjects:forKeys:inCollection:
+**/
+- (void)setObjects:(NSArray *)objects
+           forKeys:(NSArray *)keys
+      inCollection:(NSString *)collection
+      withMetadata:(NSArray *)metadataArray
+{
+	[self _setObjects:objects
+	          forKeys:keys
+	     inCollection:collection
+	     withMetadata:metadataArray
+	serializedObjects:nil
+	serializedMetadata:nil];
+}
+
+/**
+ * Same as setObjects:forKeys:inCollection:withMetadata:, but the serialization step may be skipped.
+ *
+ * If non-nil, the serializedObjects array must be the same size as the keys array,
+ * and each value must be equal to what we would get if we ran the object through the objectSerializer.
+ * Likewise for the serializedMetadata array ([NSNull null] for any key that doesn't have metadata).
+ * (As with the preSerializedObject & preSerializedMetadata parameters of setObject:forKey:...)
+**/
+- (void)_setObjects:(NSArray *)objects
+            forKeys:(NSArray *)keys
+       inCollection:(NSString *)collection
+       withMetadata:(NSArray *)metadataArray
+  serializedObjects:(NSArray<NSData *> *)preSerializedObjects
+ serializedMetadata:(NSArray *)preSerializedMetadata
+{
+	NSUInteger keysCount = keys.count;
+	if (keysCount == 0) return;
+	
+	if (objects.count != keysCount)
+	{
+		YDBLogError(@"%@ - objects.count(%lu) != keys.count(%lu)", THIS_METHOD,
+		            (unsigned long)objects.count, (unsigned long)keysCount);
+		return;
+	}
+	if (metadataArray && (metadataArray.count != keysCount))
+	{
+		YDBLogError(@"%@ - metadata.count(%lu) != keys.count(%lu)", THIS_METHOD,
+		            (unsigned long)metadataArray.count, (unsigned long)keysCount);
+		return;
+	}
+	
+	if (keysCount == 1)
+	{
+		id metadata = [metadataArray firstObject];
+		if (metadata == [NSNull null]) metadata = nil;
+		
+		id serializedMetadata = [preSerializedMetadata firstObject];
+		if (serializedMetadata == [NSNull null]) serializedMetadata = nil;
+		
+		[self setObject:[objects firstObject]
+		         forKey:[keys firstObject]
+		   inCollection:collection
+		   withMetadata:metadata
+		serializedObject:[preSerializedObjects firstObject]
+		serializedMetadata:serializedMetadata];
+		return;
+	}
+	
+	if (collection == nil)
+		collection = @"";
+	else
+		collection = [collection copy]; // mutable string protection
+	
+	YapDatabase *database = connection->database;
+	id yapNull = [YapNull null];
+	id nsNull = [NSNull null];
+	
+	// Step 1 of 5:
+	//
+	// Remove duplicate keys (last one wins), run the pre-sanitizers & serialize everything.
+	
+	NSMutableDictionary<NSString *, NSNumber *> *lastIndexForKey = [NSMutableDictionary dictionaryWithCapacity:keysCount];
+	for (NSUInteger i = 0; i < keysCount; i++)
+	{
+		lastIndexForKey[keys[i]] = @(i);
+	}
+	
+	NSMutableArray<YapCollectionKey *> *cacheKeys = [NSMutableArray arrayWithCapacity:keysCount];
+	NSMutableArray *batchObjects   = [NSMutableArray arrayWithCapacity:keysCount];
+	NSMutableArray *batchMetadata  = [NSMutableArray arrayWithCapacity:keysCount]; // yapNull if nil metadata
+	NSMutableArray<NSData *> *serializedObjects  = [NSMutableArray arrayWithCapacity:keysCount];
+	NSMutableArray<NSData *> *serializedMetadata = [NSMutableArray arrayWithCapacity:keysCount]; // empty if nil
+	NSMutableArray<NSString *> *keysToRemove = nil;
+	
+	NSData *emptyData = [NSData data];
+	
+	for (NSUInteger i = 0; i < keysCount; i++)
+	{
+		NSString *key = keys[i];
+		if ([lastIndexForKey[key] unsignedIntegerValue] != i) continue; // duplicate key
+		
+		id object = objects[i];
+		id metadata = metadataArray ? metadataArray[i] : nil;
+		
+		if (metadata == nsNull) metadata = nil;
+		
+		if (database->objectPreSanitizer)
+		{
+			object = database->objectPreSanitizer(collection, key, object);
+			if (object == nil)
+			{
+				YDBLogWarn(@"The objectPreSanitizer returned nil for collection(%@) key(%@)", collection, key);
+				
+				if (keysToRemove == nil)
+					keysToRemove = [NSMutableArray array];
+				
+				[keysToRemove addObject:key];
+				continue;
+			}
+		}
+		if (metadata && database->metadataPreSanitizer)
+		{
+			metadata = database->metadataPreSanitizer(collection, key, metadata);
+			if (metadata == nil)
+			{
+				YDBLogWarn(@"The metadataPresanitizer returned nil for collection(%@) key(%@)", collection, key);
+			}
+		}
+		
+		uint64_t serializationTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		NSData *oData = preSerializedObjects ? preSerializedObjects[i] : database->objectSerializer(collection, key, object);
+		oData = [self encodeSerializedObject:oData inCollection:collection];
+		
+		BOOL nativeMetadata = YapDatabaseIsNativeMetadata(database, collection, metadata);
+		NSData *mData = nil;
+		if (metadata && !nativeMetadata)
+		{
+			mData = preSerializedMetadata ? preSerializedMetadata[i] : nil;
+			if (mData == nil || (id)mData == nsNull)
+				mData = database->metadataSerializer(collection, key, metadata);
+		}
+		
+		if (connection->transactionMetrics)
+		{
+			YapDatabaseTransactionMetrics *metrics = connection->transactionMetrics;
+			metrics->serializationTicks += YapDatabaseTransactionMetricsElapsed(serializationTime);
+			metrics->serializationCount += (mData ? 2 : 1);
+		}
+		
+		if (connection->workloadTrace)
+		{
+			[connection->workloadTrace recordSetRowWithCollection:collection
+			                                                  key:key
+			                                           objectSize:oData.length
+			                                         metadataSize:(metadata ? mData.length : NSNotFound)];
+		}
+		
+		[cacheKeys addObject:[[YapCollectionKey alloc] initWithCollection:collection key:key]];
+		[batchObjects addObject:object];
+		[batchMetadata addObject:(metadata ?: yapNull)];
+		[serializedObjects addObject:(oData ?: emptyData)];
+		[serializedMetadata addObject:(mData ?: emptyData)];
+	}
+	
+	if (keysToRemove)
+	{
+		[self removeObjectsForKeys:keysToRemove inCollection:collection];
+	}
+	
+	NSUInteger batchCount = cacheKeys.count;
+	if (batchCount == 0) return;
+	
+	// Step 2 of 5:
+	//
+	// Lookup the rowid for every key.
+	// Anything in the keyCache is free, and everything else is fetched in big batches.
+	
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray arrayWithCapacity:batchCount];
+	NSMutableArray<NSString *> *uncachedKeys = nil;
+	NSMutableArray<NSNumber *> *uncachedIndexes = nil;
+	
+	for (NSUInteger i = 0; i < batchCount; i++)
+	{
+		YapCollectionKey *cacheKey = cacheKeys[i];
+		
+		int64_t cachedRowid = 0;
+		if ([connection->keyCache getRowid:&cachedRowid forObject:cacheKey])
+		{
+			[rowids addObject:@(cachedRowid)];
+		}
+		else
+		{
+			[rowids addObject:@(0)];
+			
+			if (uncachedKeys == nil)
+			{
+				uncachedKeys = [NSMutableArray arrayWithCapacity:(batchCount - i)];
+				uncachedIndexes = [NSMutableArray arrayWithCapacity:(batchCount - i)];
+			}
+			
+			[uncachedKeys addObject:cacheKey.key];
+			[uncachedIndexes addObject:@(i)];
+		}
+	}
+	
+	if (uncachedKeys)
+	{
+		[self _enumerateRowidsForKeys:uncachedKeys
+		                 inCollection:collection
+		          unorderedUsingBlock:^(NSUInteger keyIndex, int64_t rowid, BOOL __unused *stop)
+		{
+		#pragma clang diagnostic push
+		#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+			
+			NSUInteger batchIndex = [uncachedIndexes[keyIndex] unsignedIntegerValue];
+			rowids[batchIndex] = @(rowid);
+			
+			[connection->keyCache setObject:cacheKeys[batchIndex] forRowid:rowid];
+			
+		#pragma clang diagnostic pop
+		}];
+	}
+	
+	// Within the contentHashedCollections (see YapDatabaseOptions),
+	// rows that are already stored exactly as given are dropped from the batch.
+	
+	NSMutableData *contentHashes = nil;
+	
+	if (database->contentHashEnabled && [database->contentHashedCollections containsObject:collection])
+	{
+		contentHashes = [NSMutableData dataWithLength:(batchCount * sizeof(YapDatabaseContentHash))];
+		YapDatabaseContentHash *hashes = (YapDatabaseContentHash *)contentHashes.mutableBytes;
+		
+		NSMutableIndexSet *unchanged = nil;
+		
+		for (NSUInteger i = 0; i < batchCount; i++)
+		{
+			hashes[i] = [self contentHashForSerializedObject:serializedObjects[i]
+			                              serializedMetadata:serializedMetadata[i]
+			                                  nativeMetadata:YapDatabaseIsNativeMetadata(database, collection, batchMetadata[i])
+			                                    inCollection:collection];
+			
+			int64_t rowid = [rowids[i] longLongValue];
+			if (rowid != 0 && [self matchesContentHash:hashes[i] forRowid:rowid])
+			{
+				if (unchanged == nil)
+					unchanged = [NSMutableIndexSet indexSet];
+				
+				[unchanged addIndex:i];
+			}
+		}
+		
+		if (unchanged)
+		{
+			NSUInteger keptCount = 0;
+			
+			for (NSUInteger i = 0; i < batchCount; i++)
+			{
+				if (![unchanged containsIndex:i])
+				{
+					hashes[keptCount++] = hashes[i];
+					continue;
+				}
+				
+				YapCollectionKey *cacheKey = cacheKeys[i];
+				id object = batchObjects[i];
+				id metadata = batchMetadata[i];
+				
+				[connection->objectCache setObject:object forKey:cacheKey];
+				[connection->metadataCache setObject:metadata forKey:cacheKey];
+				
+				if (database->objectPostSanitizer)
+				{
+					database->objectPostSanitizer(collection, cacheKey.key, object);
+				}
+				if ((metadata != yapNull) && database->metadataPostSanitizer)
+				{
+					database->metadataPostSanitizer(collection, cacheKey.key, metadata);
+				}
+			}
+			
+			[cacheKeys removeObjectsAtIndexes:unchanged];
+			[batchObjects removeObjectsAtIndexes:unchanged];
+			[batchMetadata removeObjectsAtIndexes:unchanged];
+			[serializedObjects removeObjectsAtIndexes:unchanged];
+			[serializedMetadata removeObjectsAtIndexes:unchanged];
+			[rowids removeObjectsAtIndexes:unchanged];
+			
+			batchCount = keptCount;
+			if (batchCount == 0) return;
+		}
+	}
+	
+	// Step 3 of 5:
+	//
+	// Pre-op extension hooks.
+	
+	NSArray *orderedExtensions = [self orderedExtensionsForCollection:collection];
+	
+	if (orderedExtensions.count > 0)
+	{
+		NSMutableArray *willInsertObjects   = [NSMutableArray array];
+		NSMutableArray *willInsertMetadata  = [NSMutableArray array];
+		NSMutableArray *willInsertCacheKeys = [NSMutableArray array];
+		
+		NSMutableArray *willUpdateObjects   = [NSMutableArray array];
+		NSMutableArray *willUpdateMetadata  = [NSMutableArray array];
+		NSMutableArray *willUpdateCacheKeys = [NSMutableArray array];
+		NSMutableArray *willUpdateRowids    = [NSMutableArray array];
+		
+		for (NSUInteger i = 0; i < batchCount; i++)
+		{
+			if ([rowids[i] longLongValue] != 0)
+			{
+				[willUpdateObjects addObject:batchObjects[i]];
+				[willUpdateMetadata addObject:batchMetadata[i]];
+				[willUpdateCacheKeys addObject:cacheKeys[i]];
+				[willUpdateRowids addObject:rowids[i]];
+			}
+			else
+			{
+				[willInsertObjects addObject:batchObjects[i]];
+				[willInsertMetadata addObject:batchMetadata[i]];
+				[willInsertCacheKeys addObject:cacheKeys[i]];
+			}
+		}
+		
+		for (YapDatabaseExtensionTransaction *extTransaction in orderedExtensions)
+		{
+			if (willUpdateCacheKeys.count > 0)
+				[extTransaction willUpdateObjects:willUpdateObjects
+				                forCollectionKeys:willUpdateCacheKeys
+				                     withMetadata:willUpdateMetadata
+				                           rowids:willUpdateRowids];
+			
+			if (willInsertCacheKeys.count > 0)
+				[extTransaction willInsertObjects:willInsertObjects
+				                forCollectionKeys:willInsertCacheKeys
+				                     withMetadata:willInsertMetadata];
+		}
+	}
 	
-	// The "+ (void)load" method swizzles the implementation of this class
-	// to point to the implementation of the extension: method.
+	// Step 4 of 5:
 	//
-	// So the two methods are literally the same thing.
+	// Write all the rows, re-using the same insert & update statements.
 	
-	return [self extension:extensionName]; // This method is swizzled !
-}
-
-- (void)prepareExtensions
-{
-	if (extensions == nil)
-		extensions = [[NSMutableDictionary alloc] init];
+	sqlite3_stmt *updateStatement = [connection updateAllForRowidStatement];
+	sqlite3_stmt *insertStatement = [connection insertForRowidStatement];
 	
-	NSDictionary *extConnections = [connection extensions];
+	if (updateStatement == NULL || insertStatement == NULL) {
+		return;
+	}
 	
-	[extConnections enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	NSMutableIndexSet *written = [NSMutableIndexSet indexSet];
+	NSMutableIndexSet *inserted = [NSMutableIndexSet indexSet];
+	
+	int64_t collectionId = 0; // Looked up on first insert (collection-id schema only)
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	
+	for (NSUInteger i = 0; i < batchCount; i++)
+	{
+		NSData *oData = serializedObjects[i];
+		NSData *mData = serializedMetadata[i];
 		
-		__unsafe_unretained NSString *extName = key;
-		__unsafe_unretained YapDatabaseExtensionConnection *extConnection = obj;
+		int64_t rowid = [rowids[i] longLongValue];
 		
-		YapDatabaseExtensionTransaction *extTransaction = [extensions objectForKey:extName];
-		if (extTransaction == nil)
+		if (rowid != 0) // update data for key
 		{
-			if (isReadWriteTransaction)
-				extTransaction = [extConnection newReadWriteTransaction:(YapDatabaseReadWriteTransaction *)self];
+			// UPDATE "database2" SET "data" = ?, "metadata" = ? WHERE "rowid" = ?;
+			
+			int const bind_idx_data     = SQLITE_BIND_START + 0;
+			int const bind_idx_metadata = SQLITE_BIND_START + 1;
+			int const bind_idx_rowid    = SQLITE_BIND_START + 2;
+			
+			sqlite3_bind_blob(updateStatement, bind_idx_data, oData.bytes, (int)oData.length, SQLITE_STATIC);
+			
+			if (mData.length > 0)
+				sqlite3_bind_blob(updateStatement, bind_idx_metadata, mData.bytes, (int)mData.length, SQLITE_STATIC);
+			else if (YapDatabaseIsNativeMetadata(database, collection, batchMetadata[i]))
+				YapDatabaseBindNativeMetadata(database, collection, batchMetadata[i], updateStatement, bind_idx_metadata);
+			
+			sqlite3_bind_int64(updateStatement, bind_idx_rowid, rowid);
+			
+			int status = sqlite3_step(updateStatement);
+			if (status == SQLITE_DONE)
+			{
+				[written addIndex:i];
+			}
 			else
-				extTransaction = [extConnection newReadTransaction:self];
+			{
+				YDBLogError(@"Error executing 'updateAllForRowidStatement': %d %s",
+				            status, sqlite3_errmsg(connection->db));
+			}
 			
-			if ([extTransaction prepareIfNeeded])
+			sqlite3_clear_bindings(updateStatement);
+			sqlite3_reset(updateStatement);
+		}
+		else // insert data for key
+		{
+			// INSERT INTO "database2" ("collection", "key", "data", "metadata") VALUES (?, ?, ?, ?);
+			
+			if (connection->database->usesCollectionIds && (collectionId == 0))
 			{
-				[extensions setObject:extTransaction forKey:extName];
+				if (![connection getCollectionId:&collectionId forCollection:collection]) {
+					continue;
+				}
+			}
+			
+			int const bind_idx_collection = SQLITE_BIND_START + 0;
+			int const bind_idx_key        = SQLITE_BIND_START + 1;
+			int const bind_idx_data       = SQLITE_BIND_START + 2;
+			int const bind_idx_metadata   = SQLITE_BIND_START + 3;
+			
+			if (connection->database->usesCollectionIds)
+				sqlite3_bind_int64(insertStatement, bind_idx_collection, collectionId);
+			else
+				sqlite3_bind_text(insertStatement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+			
+			YapDatabaseString _key; MakeYapDatabaseString(&_key, cacheKeys[i].key);
+			sqlite3_bind_text(insertStatement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+			
+			sqlite3_bind_blob(insertStatement, bind_idx_data, oData.bytes, (int)oData.length, SQLITE_STATIC);
+			
+			if (mData.length > 0)
+				sqlite3_bind_blob(insertStatement, bind_idx_metadata, mData.bytes, (int)mData.length, SQLITE_STATIC);
+			else if (YapDatabaseIsNativeMetadata(database, collection, batchMetadata[i]))
+				YapDatabaseBindNativeMetadata(database, collection, batchMetadata[i], insertStatement, bind_idx_metadata);
+			
+			int status = sqlite3_step(insertStatement);
+			if (status == SQLITE_DONE)
+			{
+				rowid = sqlite3_last_insert_rowid(connection->db);
+				rowids[i] = @(rowid);
+				
+				[connection->keyCache setObject:cacheKeys[i] forRowid:rowid];
+				
+				[written addIndex:i];
+				[inserted addIndex:i];
+			}
+			else
+			{
+				YDBLogError(@"Error executing 'insertForRowidStatement': %d %s",
+				            status, sqlite3_errmsg(connection->db));
 			}
+			
+			sqlite3_clear_bindings(insertStatement);
+			sqlite3_reset(insertStatement);
+			FreeYapDatabaseString(&_key);
 		}
+	}
+	
+	FreeYapDatabaseString(&_collection);
+	
+	if (written.count == 0) return;
+	
+	if (contentHashes)
+	{
+		const YapDatabaseContentHash *hashes = (const YapDatabaseContentHash *)contentHashes.bytes;
 		
-	#pragma clang diagnostic pop
-	}];
+		[written enumerateIndexesUsingBlock:^(NSUInteger i, BOOL __unused *stop) {
+			
+			[self setContentHash:hashes[i] forRowid:[rowids[i] longLongValue]];
+		}];
+	}
+	
+	connection->hasDiskChanges = YES;
+	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	[self spillChangesetIfNeeded];
+	
+	// Step 5 of 5:
+	//
+	// Update the caches & changeset, and then invoke the (batched) post-op extension hooks.
+	
+	NSUInteger insertedCount = inserted.count;
+	NSUInteger updatedCount = written.count - insertedCount;
+	
+	NSMutableArray *insertedObjects = [NSMutableArray arrayWithCapacity:insertedCount];
+	NSMutableArray *insertedMetadata = [NSMutableArray arrayWithCapacity:insertedCount];
+	NSMutableArray *insertedCacheKeys = [NSMutableArray arrayWithCapacity:insertedCount];
+	NSMutableArray *insertedRowids = [NSMutableArray arrayWithCapacity:insertedCount];
+	
+	NSMutableArray *updatedObjects = [NSMutableArray arrayWithCapacity:updatedCount];
+	NSMutableArray *updatedMetadata = [NSMutableArray arrayWithCapacity:updatedCount];
+	NSMutableArray *updatedCacheKeys = [NSMutableArray arrayWithCapacity:updatedCount];
+	NSMutableArray *updatedRowids = [NSMutableArray arrayWithCapacity:updatedCount];
+	
+	for (NSUInteger i = 0; i < batchCount; i++)
+	{
+		if (![written containsIndex:i]) continue;
+		
+		YapCollectionKey *cacheKey = cacheKeys[i];
+		id object = batchObjects[i];
+		id metadata = batchMetadata[i];
+		
+		id _object = YapDatabaseChangesetValue(connection->objectPolicy, object);
+		
+		[connection->objectCache setObject:object forKey:cacheKey];
+		[connection->objectChanges setObject:_object forKey:cacheKey];
+		
+		if (metadata != yapNull)
+		{
+			id _metadata = YapDatabaseChangesetValue(connection->metadataPolicy, metadata);
+			
+			[connection->metadataCache setObject:metadata forKey:cacheKey];
+			[connection->metadataChanges setObject:_metadata forKey:cacheKey];
+		}
+		else
+		{
+			[connection->metadataCache setObject:yapNull forKey:cacheKey];
+			[connection->metadataChanges setObject:yapNull forKey:cacheKey];
+		}
+		
+		if ([inserted containsIndex:i])
+		{
+			[connection->insertedKeys addObject:cacheKey];
+			
+			[insertedObjects addObject:object];
+			[insertedMetadata addObject:metadata];
+			[insertedCacheKeys addObject:cacheKey];
+			[insertedRowids addObject:rowids[i]];
+		}
+		else
+		{
+			[updatedObjects addObject:object];
+			[updatedMetadata addObject:metadata];
+			[updatedCacheKeys addObject:cacheKey];
+			[updatedRowids addObject:rowids[i]];
+		}
+	}
+	
+	// Evaluate the handler blocks of (eligible) extensions concurrently.
+	// The results are then applied in order (via the usual hooks) below.
+	
+	NSMapTable *updatedResults = nil;
+	NSMapTable *insertedResults = nil;
+	
+	[self evaluateHandlersConcurrentlyForExtensions:orderedExtensions
+	                                 updatedObjects:updatedObjects
+	                                updatedMetadata:updatedMetadata
+	                               updatedCacheKeys:updatedCacheKeys
+	                                insertedObjects:insertedObjects
+	                               insertedMetadata:insertedMetadata
+	                              insertedCacheKeys:insertedCacheKeys
+	                                 updatedResults:&updatedResults
+	                                insertedResults:&insertedResults];
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in orderedExtensions)
+	{
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		if (updatedCount > 0)
+		{
+			NSArray *results = [updatedResults objectForKey:extTransaction];
+			if (results) [extTransaction setEvaluatedHandlerResults:results];
+			
+			[extTransaction didUpdateObjects:updatedObjects
+			               forCollectionKeys:updatedCacheKeys
+			                    withMetadata:updatedMetadata
+			                          rowids:updatedRowids];
+			
+			if (results) [extTransaction setEvaluatedHandlerResults:nil];
+		}
+		
+		if (insertedCount > 0)
+		{
+			NSArray *results = [insertedResults objectForKey:extTransaction];
+			if (results) [extTransaction setEvaluatedHandlerResults:results];
+			
+			[extTransaction didInsertObjects:insertedObjects
+			               forCollectionKeys:insertedCacheKeys
+			                    withMetadata:insertedMetadata
+			                          rowids:insertedRowids];
+			
+			if (results) [extTransaction setEvaluatedHandlerResults:nil];
+		}
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
+	}
+	
+	if (database->objectPostSanitizer || database->metadataPostSanitizer)
+	{
+		for (NSUInteger i = 0; i < batchCount; i++)
+		{
+			if (![written containsIndex:i]) continue;
+			
+			NSString *key = cacheKeys[i].key;
+			id metadata = batchMetadata[i];
+			
+			if (database->objectPostSanitizer)
+			{
+				database->objectPostSanitizer(collection, key, batchObjects[i]);
+			}
+			if ((metadata != yapNull) && database->metadataPostSanitizer)
+			{
+				database->metadataPostSanitizer(collection, key, metadata);
+			}
+		}
+	}
+}
+
+/**
+ * If a row with the given key/collection exists, then replaces the object for that row with the new value.
+ *
+ * It only replaces the object. The metadata for the row doesn't change.
+ * If there is no row in the database for the given key/collection then this method does nothing.
+ *
+ * If you pass nil for the object, then this method will remove the row from the database (if it exists).
+ *
+ * @param object
+ *   The object to store in the database.
+ *   This object is automatically serialized using the database's configured objectSerializer.
+ *
+ * @param key
+ *   The lookup key.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   This value should not be nil. If a nil key is passed, then this method does nothing.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+**/
+- (void)replaceObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
+{
+	int64_t rowid = 0;
+	if ([self getRowid:&rowid forKey:key inCollection:collection])
+	{
+		[self replaceObject:object forKey:key inCollection:collection withRowid:rowid serializedObject:nil];
+	}
+}
+
+/**
+ * If a row with the given key/collection exists, then replaces the object for that row with the new value.
+ *
+ * It only replaces the object. The metadata for the row doesn't change.
+ * If there is no row in the database for the given key/collection then this method does nothing.
+ *
+ * If you pass nil for the object, then this method will remove the row from the database (if it exists).
+ * 
+ * This method allows for a bit of optimization if you happen to already have a serialized version of
+ * the object and/or metadata. For example, if you downloaded an object in serialized form,
+ * and you still have the raw serialized NSData, then you can use this method to skip the serialization step
+ * when storing the object to the database.
+ *
+ * @param object
+ *   The object to store in the database.
+ *   This object is automatically serialized using the database's configured objectSerializer.
+ *
+ * @param key
+ *   The lookup key.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   This value should not be nil. If a nil key is passed, then this method does nothing.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+ *
+ * @param preSerializedObject
+ *   This value is optional.
+ *   If non-nil then the object serialization step is skipped, and this value is used instead.
+ *   It is assumed that preSerializedObject is equal to what we would get if we ran the object through
+ *   the database's configured objectSerializer.
+**/
+- (void)replaceObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
+                                                withSerializedObject:(NSData *)preSerializedObject
+{
+	int64_t rowid = 0;
+	if ([self getRowid:&rowid forKey:key inCollection:collection])
+	{
+		[self replaceObject:object
+		             forKey:key
+		       inCollection:collection
+		          withRowid:rowid
+		   serializedObject:preSerializedObject];
+	}
+}
+
+/**
+ * Internal replaceObject method that takes a rowid.
+**/
+- (void)replaceObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
+                                                           withRowid:(int64_t)rowid
+                                                    serializedObject:(NSData *)preSerializedObject
+{
+	if (object == nil)
+	{
+		[self removeObjectForKey:key inCollection:collection withRowid:rowid];
+		return;
+	}
+	
+	NSAssert(key != nil, @"Internal error");
+	if (collection == nil) collection = @"";
+	
+	if (connection->database->objectPreSanitizer)
+	{
+		object = connection->database->objectPreSanitizer(collection, key, object);
+		if (object == nil)
+		{
+			YDBLogWarn(@"The objectPreSanitizer returned nil for collection(%@) key(%@)", collection, key);
+			
+			[self removeObjectForKey:key inCollection:collection withRowid:rowid];
+			return;
+		}
+	}
+	
+	// To use SQLITE_STATIC on our data blob, we use the objc_precise_lifetime attribute.
+	// This ensures the data isn't released until it goes out of scope.
+	
+	uint64_t serializationTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+	
+	__attribute__((objc_precise_lifetime)) NSData *serializedObject = nil;
+	if (preSerializedObject)
+		serializedObject = preSerializedObject;
+	else
+		serializedObject = connection->database->objectSerializer(collection, key, object);
 	
-	if (orderedExtensions == nil)
-		orderedExtensions = [[NSMutableArray alloc] initWithCapacity:[extensions count]];
+	serializedObject = [self encodeSerializedObject:serializedObject inCollection:collection];
 	
-	for (NSString *extName in connection->extensionsOrder)
+	if (connection->transactionMetrics)
 	{
-		YapDatabaseExtensionTransaction *extTransaction = [extensions objectForKey:extName];
-		if (extTransaction)
-		{
-			[orderedExtensions addObject:extTransaction];
-		}
+		connection->transactionMetrics->serializationTicks += YapDatabaseTransactionMetricsElapsed(serializationTime);
+		connection->transactionMetrics->serializationCount++;
 	}
 	
-	extensionsReady = YES;
-}
-
-- (NSDictionary *)extensions
-{
-	// This method is INTERNAL
+	if (connection->workloadTrace)
+	{
+		[connection->workloadTrace recordReplaceObjectWithCollection:collection
+		                                                         key:key
+		                                                  objectSize:serializedObject.length];
+	}
 	
-	if (!extensionsReady)
+	sqlite3_stmt *statement = [connection updateObjectForRowidStatement];
+	if (statement == NULL) return;
+	
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	
+	// Be sure to execute pre-hook BEFORE we bind query parameters.
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
 	{
-		[self prepareExtensions];
+		[extTransaction willReplaceObject:object forCollectionKey:cacheKey withRowid:rowid];
 	}
 	
-	return extensions;
-}
-
-- (NSArray *)orderedExtensions
-{
-	// This method is INTERNAL
+	// UPDATE "database2" SET "data" = ? WHERE "rowid" = ?;
 	
-	if (!extensionsReady)
+	int const bind_idx_data  = SQLITE_BIND_START + 0;
+	int const bind_idx_rowid = SQLITE_BIND_START + 1;
+	
+	sqlite3_bind_blob(statement, bind_idx_data, serializedObject.bytes, (int)serializedObject.length, SQLITE_STATIC);
+	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+	
+	BOOL updated = YES;
+	
+	int status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
 	{
-		[self prepareExtensions];
+		YDBLogError(@"Error executing 'updateObjectForRowidStatement': %d %s",
+		                                                    status, sqlite3_errmsg(connection->db));
+		updated = NO;
 	}
 	
-	return orderedExtensions;
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Memory Tables
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (YapMemoryTableTransaction *)memoryTableTransaction:(NSString *)tableName
-{
-	BOOL isYap = [tableName isEqualToString:@"yap"];
-	if (isYap && yapMemoryTableTransaction)
-		return yapMemoryTableTransaction;
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
 	
-	YapMemoryTableTransaction *memoryTableTransaction = nil;
-		
-	YapMemoryTable *table = [[connection registeredMemoryTables] objectForKey:tableName];
-	if (table)
+	if (!updated) return;
+	
+	connection->hasDiskChanges = YES;
+	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	[self spillChangesetIfNeeded];
+	
+	id _object = YapDatabaseChangesetValue(connection->objectPolicy, object);
+	
+	[connection->objectCache setObject:object forKey:cacheKey];
+	[connection->objectChanges setObject:_object forKey:cacheKey];
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
 	{
-		uint64_t snapshot = [connection snapshot];
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
 		
-		if (isReadWriteTransaction)
-			memoryTableTransaction = [table newReadWriteTransactionWithSnapshot:(snapshot + 1)];
-		else
-			memoryTableTransaction = [table newReadTransactionWithSnapshot:snapshot];
+		[extTransaction didReplaceObject:object forCollectionKey:cacheKey withRowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 	}
 	
-	if (isYap) {
-		yapMemoryTableTransaction = memoryTableTransaction;
+	if (connection->database->objectPostSanitizer)
+	{
+		connection->database->objectPostSanitizer(collection, key, object);
 	}
-	return memoryTableTransaction;
 }
 
 /**
- * The system automatically creates a special YapMemoryTable that's available for any extension.
- * This memoryTable is registered under the reserved name @"yap".
+ * If a row with the given key/collection exists, then replaces the metadata for that row with the new value.
  *
- * The yapMemoryTableTransaction uses a keyClass of [YapCollectionKey class].
- * Thus, when using it, you must pass a YapCollectionKey, where collectionKey.collection == extensionName.
- * 
- * This memory table is an in-memory alternative to using the yap sqlite table.
+ * It only replaces the metadata. The object for the row doesn't change.
+ * If there is no row in the database for the given key/collection then this method does nothing.
+ *
+ * If you pass nil for the metadata, any metadata previously associated with the key/collection is removed.
+ *
+ * @param metadata
+ *   The metadata to store in the database.
+ *   This metadata is automatically serialized using the database's configured metadataSerializer.
+ *
+ * @param key
+ *   The lookup key.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   This value should not be nil. If a nil key is passed, then this method does nothing.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
 **/
-- (YapMemoryTableTransaction *)yapMemoryTableTransaction
+- (void)replaceMetadata:(id)metadata forKey:(NSString *)key inCollection:(NSString *)collection
 {
-	return [self memoryTableTransaction:@"yap"];
+	int64_t rowid = 0;
+	if ([self getRowid:&rowid forKey:key inCollection:collection])
+	{
+		[self replaceMetadata:metadata forKey:key inCollection:collection withRowid:rowid serializedMetadata:nil];
+	}
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Yap2 Table
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (BOOL)getBoolValue:(BOOL *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+/**
+ * If a row with the given key/collection exists, then replaces the metadata for that row with the new value.
+ *
+ * It only replaces the metadata. The object for the row doesn't change.
+ * If there is no row in the database for the given key/collection then this method does nothing.
+ *
+ * If you pass nil for the metadata, any metadata previously associated with the key/collection is removed.
+ *
+ * This method allows for a bit of optimization if you happen to already have a serialized version of
+ * the object and/or metadata. For example, if you downloaded an object in serialized form,
+ * and you still have the raw serialized NSData, then you can use this method to skip the serialization step
+ * when storing the object to the database.
+ * 
+ * @param metadata
+ *   The metadata to store in the database.
+ *   This metadata is automatically serialized using the database's configured metadataSerializer.
+ *
+ * @param key
+ *   The lookup key.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   This value should not be nil. If a nil key is passed, then this method does nothing.
+ *
+ * @param collection
+ *   The lookup collection.
+ *   The <collection, key> tuple is used to uniquely identify the row in the database.
+ *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
+ * 
+ * @param preSerializedMetadata
+ *   This value is optional.
+ *   If non-nil then the metadata serialization step is skipped, and this value is used instead.
+ *   It is assumed that preSerializedMetadata is equal to what we would get if we ran the metadata through
+ *   the database's configured metadataSerializer.
+**/
+- (void)replaceMetadata:(id)metadata forKey:(NSString *)key inCollection:(NSString *)collection
+                                                  withSerializedMetadata:(NSData *)preSerializedMetadata
 {
-	int intValue = 0;
-	BOOL result = [self getIntValue:&intValue forKey:key extension:extensionName];
-	
-	if (valuePtr) *valuePtr = (intValue == 0) ? NO : YES;
-	return result;
+	int64_t rowid = 0;
+	if ([self getRowid:&rowid forKey:key inCollection:collection])
+	{
+		[self replaceMetadata:metadata
+		               forKey:key
+		         inCollection:collection
+		            withRowid:rowid
+		   serializedMetadata:preSerializedMetadata];
+	}
 }
 
-- (BOOL)getIntValue:(int *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+/**
+ * Internal replaceMetadata method that takes a rowid.
+**/
+- (void)replaceMetadata:(id)metadata
+                 forKey:(NSString *)key
+           inCollection:(NSString *)collection
+              withRowid:(int64_t)rowid
+     serializedMetadata:(NSData *)preSerializedMetadata
 {
-	if (extensionName == nil)
-		extensionName = @"";
+	NSAssert(key != nil, @"Internal error");
+	if (collection == nil) collection = @"";
 	
-	sqlite3_stmt *statement = [connection yapGetDataForKeyStatement];
-	if (statement == NULL) {
-		if (valuePtr) *valuePtr = 0;
-		return NO;
+	if (metadata && connection->database->metadataPreSanitizer)
+	{
+		metadata = connection->database->metadataPreSanitizer(collection, key, metadata);
+		if (metadata == nil)
+		{
+			YDBLogWarn(@"The metadataPreSanitizer returned nil for collection(%@) key(%@)", collection, key);
+		}
 	}
 	
-	BOOL result = NO;
-	int value = 0;
-	
-	// SELECT "data" FROM "yap2" WHERE "extension" = ? AND "key" = ? ;
+	// To use SQLITE_STATIC on our data blob, we use the objc_precise_lifetime attribute.
+	// This ensures the data isn't released until it goes out of scope.
 	
-	int const column_idx_data    = SQLITE_COLUMN_START;
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	uint64_t serializationTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
 	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	BOOL nativeMetadata = YapDatabaseIsNativeMetadata(connection->database, collection, metadata);
 	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	__attribute__((objc_precise_lifetime)) NSData *serializedMetadata = nil;
+	if (metadata && !nativeMetadata)
+	{
+		if (preSerializedMetadata)
+			serializedMetadata = preSerializedMetadata;
+		else
+			serializedMetadata = connection->database->metadataSerializer(collection, key, metadata);
+	}
 	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_ROW)
+	if (connection->transactionMetrics && serializedMetadata)
 	{
-		result = YES;
-		value = sqlite3_column_int(statement, column_idx_data);
+		connection->transactionMetrics->serializationTicks += YapDatabaseTransactionMetricsElapsed(serializationTime);
+		connection->transactionMetrics->serializationCount++;
 	}
-	else if (status == SQLITE_ERROR)
+	
+	if (connection->workloadTrace)
 	{
-		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		[connection->workloadTrace recordReplaceMetadataWithCollection:collection
+		                                                           key:key
+		                                                  metadataSize:(metadata ? serializedMetadata.length : NSNotFound)];
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
+	sqlite3_stmt *statement = [connection updateMetadataForRowidStatement];
+	if (statement == NULL) return;
 	
-	if (valuePtr) *valuePtr = value;
-	return result;
-}
-
-- (BOOL)getDoubleValue:(double *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
-{
-	if (extensionName == nil)
-		extensionName = @"";
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
-	sqlite3_stmt *statement = [connection yapGetDataForKeyStatement];
-	if (statement == NULL) {
-		if (valuePtr) *valuePtr = 0.0;
-		return NO;
+	// Be sure to execute pre-hook BEFORE we bind query parameters.
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
+	{
+		[extTransaction willReplaceMetadata:metadata forCollectionKey:cacheKey withRowid:rowid];
 	}
 	
-	BOOL result = NO;
-	double value = 0.0;
+	// UPDATE "database2" SET "metadata" = ? WHERE "rowid" = ?;
 	
-	// SELECT "data" FROM "yap2" WHERE "extension" = ? AND "key" = ? ;
+	int const bind_idx_metadata = SQLITE_BIND_START + 0;
+	int const bind_idx_rowid    = SQLITE_BIND_START + 1;
 	
-	int const column_idx_data    = SQLITE_COLUMN_START;
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	if (nativeMetadata)
+		YapDatabaseBindNativeMetadata(connection->database, collection, metadata, statement, bind_idx_metadata);
+	else
+		sqlite3_bind_blob(statement, bind_idx_metadata,
+		                  serializedMetadata.bytes, (int)serializedMetadata.length, SQLITE_STATIC);
 	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
 	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	BOOL updated = YES;
 	
 	int status = sqlite3_step(statement);
-	if (status == SQLITE_ROW)
-	{
-		result = YES;
-		value = sqlite3_column_double(statement, column_idx_data);
-	}
-	else if (status == SQLITE_ERROR)
+	if (status != SQLITE_DONE)
 	{
-		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		YDBLogError(@"Error executing 'updateMetadataForRowidStatement': %d %s",
+		                                                    status, sqlite3_errmsg(connection->db));
+		updated = NO;
 	}
 	
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
-	
-	if (valuePtr) *valuePtr = value;
-	return result;
-}
-
-- (NSString *)stringValueForKey:(NSString *)key extension:(NSString *)extensionName
-{
-	if (extensionName == nil)
-		extensionName = @"";
-	
-	sqlite3_stmt *statement = [connection yapGetDataForKeyStatement];
-	if (statement == NULL) return nil;
-	
-	NSString *value = nil;
-	
-	// SELECT "data" FROM "yap2" WHERE "extension" = ? AND "key" = ? ;
-	
-	int const column_idx_data    = SQLITE_COLUMN_START;
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
 	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	if (!updated) return;
 	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	connection->hasDiskChanges = YES;
+	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	[self spillChangesetIfNeeded];
 	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_ROW)
+	if (metadata)
 	{
-		const unsigned char *text = sqlite3_column_text(statement, column_idx_data);
-		int textSize = sqlite3_column_bytes(statement, column_idx_data);
+		id _metadata = YapDatabaseChangesetValue(connection->metadataPolicy, metadata);
 		
-		value = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		[connection->metadataCache setObject:metadata forKey:cacheKey];
+		[connection->metadataChanges setObject:_metadata forKey:cacheKey];
 	}
-	else if (status == SQLITE_ERROR)
+	else
 	{
-		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+		[connection->metadataChanges setObject:[YapNull null] forKey:cacheKey];
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
+	{
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		[extTransaction didReplaceMetadata:metadata forCollectionKey:cacheKey withRowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
+	}
 	
-	return value;
+	if (metadata && connection->database->metadataPostSanitizer)
+	{
+		connection->database->metadataPostSanitizer(collection, key, metadata);
+	}
 }
 
-- (NSData *)dataValueForKey:(NSString *)key extension:(NSString *)extensionName
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Streams
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Opens a stream for incrementally writing the serialized object.
+ * See YapDatabaseBlobWriteStream for the semantics.
+**/
+- (YapDatabaseBlobWriteStream *)openWriteStreamForKey:(NSString *)key
+                                         inCollection:(NSString *)collection
+                                               length:(NSUInteger)length
 {
-	if (extensionName == nil)
-		extensionName = @"";
+	if (key == nil) return nil;
+	if (collection == nil) collection = @"";
 	
-	sqlite3_stmt *statement = [connection yapGetDataForKeyStatement];
-	if (statement == NULL) return nil;
+	YapDatabase *database = connection->database;
 	
-	NSData *value = nil;
+	// We don't know the bytes upfront, so we can't tell if they'll happen to look like a compressed row.
+	// Thus we always prefix a YapDatabaseCompressionAlgorithmNone header (if the database might have such rows).
 	
-	// SELECT "data" FROM "yap2" WHERE "extension" = ? AND "key" = ? ;
+	NSUInteger baseOffset = 0;
+	if (database->compressionEnabled || database->externalStorageEnabled || database->coldStorageEnabled) {
+		baseOffset = YAP_COMPRESSION_HEADER_SIZE;
+	}
 	
-	int const column_idx_data    = SQLITE_COLUMN_START;
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	if ((length + baseOffset) > (NSUInteger)INT_MAX || length > UINT32_MAX)
+	{
+		YDBLogError(@"%@ - length (%lu) is too large", THIS_METHOD, (unsigned long)length);
+		return nil;
+	}
 	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	int blobSize = (int)(length + baseOffset);
 	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_ROW)
+	int64_t rowid = 0;
+	BOOL found = [self getRowid:&rowid forCollectionKey:cacheKey];
+	
+	if (found) // reserve space within the existing row (the metadata is untouched)
 	{
-		const void *blob = sqlite3_column_blob(statement, column_idx_data);
-		int blobSize = sqlite3_column_bytes(statement, column_idx_data);
+		sqlite3_stmt *statement = [connection updateObjectForRowidStatement];
+		if (statement == NULL) return nil;
+		
+		// UPDATE "database2" SET "data" = ? WHERE "rowid" = ?;
+		
+		int const bind_idx_data  = SQLITE_BIND_START + 0;
+		int const bind_idx_rowid = SQLITE_BIND_START + 1;
+		
+		sqlite3_bind_zeroblob(statement, bind_idx_data, blobSize);
+		sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+		
+		int status = sqlite3_step(statement);
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
 		
-		value = [[NSData alloc] initWithBytes:(void *)blob length:blobSize];
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'updateObjectForRowidStatement': %d %s",
+			                                                    status, sqlite3_errmsg(connection->db));
+			return nil;
+		}
 	}
-	else if (status == SQLITE_ERROR)
+	else // insert a new row (without metadata)
 	{
-		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		sqlite3_stmt *statement = [connection insertForRowidStatement];
+		if (statement == NULL) return nil;
+		
+		// INSERT INTO "database2" ("collection", "key", "data", "metadata") VALUES (?, ?, ?, ?);
+		//
+		// or, with the collection-id schema:
+		//
+		// INSERT INTO "database3" ("collection_id", "key", "data", "metadata") VALUES (?, ?, ?, ?);
+		
+		int64_t collectionId = 0;
+		if (database->usesCollectionIds)
+		{
+			if (![connection getCollectionId:&collectionId forCollection:collection]) {
+				return nil;
+			}
+		}
+		
+		int const bind_idx_collection = SQLITE_BIND_START + 0;
+		int const bind_idx_key        = SQLITE_BIND_START + 1;
+		int const bind_idx_data       = SQLITE_BIND_START + 2;
+		
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		if (database->usesCollectionIds)
+			sqlite3_bind_int64(statement, bind_idx_collection, collectionId);
+		else
+			sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+		
+		YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
+		sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+		
+		sqlite3_bind_zeroblob(statement, bind_idx_data, blobSize);
+		
+		int status = sqlite3_step(statement);
+		if (status == SQLITE_DONE)
+		{
+			rowid = sqlite3_last_insert_rowid(connection->db);
+			
+			[connection->keyCache setObject:cacheKey forRowid:rowid];
+		}
+		else
+		{
+			YDBLogError(@"Error executing 'insertForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		FreeYapDatabaseString(&_collection);
+		FreeYapDatabaseString(&_key);
+		
+		if (status != SQLITE_DONE) return nil;
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
+	connection->hasDiskChanges = YES;
+	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	[self spillChangesetIfNeeded];
 	
-	return value;
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Exceptions
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (NSException *)mutationDuringEnumerationException
-{
-	NSString *reason = [NSString stringWithFormat:
-	    @"Database <%@: %p> was mutated while being enumerated.", NSStringFromClass([self class]), self];
+	// The cached object (if any) no longer matches the row
 	
-	NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
-	    @"If you modify the database during enumeration"
-		@" you MUST set the 'stop' parameter of the enumeration block to YES (*stop = YES;)."};
+	[connection->objectCache removeObjectForKey:cacheKey];
 	
-	return [NSException exceptionWithName:@"YapDatabaseException" reason:reason userInfo:userInfo];
-}
-
-@end
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark -
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-@implementation YapDatabaseReadWriteTransaction
-
-#pragma mark Transaction Control
-
-/**
- * Under normal circumstances, when a read-write transaction block completes,
- * the changes are automatically committed. If, however, something goes wrong and
- * you'd like to abort and discard all changes made within the transaction,
- * then invoke this method.
- *
- * You should generally return (exit the transaction block) after invoking this method.
- * Any changes made within the the transaction before and after invoking this method will be discarded.
- *
- * Invoking this method from within a read-only transaction does nothing.
-**/
-- (void)rollback
-{
-	rollback = YES;
-}
-
-/**
- * The YapDatabaseModifiedNotification is posted following a readwrite transaction which made changes.
- * 
- * These notifications are used in a variety of ways:
- * - They may be used as a general notification mechanism to detect changes to the database.
- * - They may be used by extensions to post change information.
- *   For example, YapDatabaseView will post the index changes, which can easily be used to animate a tableView.
- * - They are integrated into the architecture of long-lived transactions in order to maintain a steady state.
- *
- * Thus it is recommended you integrate your own notification information into this existing notification,
- * as opposed to broadcasting your own separate notification.
- * 
- * For more information, and code samples, please see the wiki article:
- * https://github.com/yapstudios/YapDatabase/wiki/YapDatabaseModifiedNotification
-**/
-@synthesize yapDatabaseModifiedNotificationCustomObject = customObjectForNotification;
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Object & Metadata
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-/**
- * Sets the object for the given key/collection.
- * The object is automatically serialized using the database's configured objectSerializer.
- *
- * If you pass nil for the object, then this method will remove the row from the database (if it exists).
- * This method implicitly sets the associated metadata to nil.
- *
- * @param object
- *   The object to store in the database.
- *   This object is automatically serialized using the database's configured objectSerializer.
- *
- * @param key
- *   The lookup key.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   This value should not be nil. If a nil key is passed, then this method does nothing.
- *
- * @param collection
- *   The lookup collection.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
-**/
-- (void)setObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
-{
-	[self setObject:object forKey:key inCollection:collection withMetadata:nil
-                                                          serializedObject:nil
-	                                                    serializedMetadata:nil];
+	sqlite3_blob *blob = NULL;
+	const char *table = database->usesCollectionIds ? "database3" : "database2";
+	
+	int status = sqlite3_blob_open(connection->db, "main", table, "data", rowid, 1, &blob);
+	if (status == SQLITE_OK && baseOffset > 0)
+	{
+		uint8_t header[YAP_COMPRESSION_HEADER_SIZE] = {
+			YAP_COMPRESSION_MAGIC_0,
+			YAP_COMPRESSION_MAGIC_1,
+			(uint8_t)YapDatabaseCompressionAlgorithmNone,
+			0, 0, 0, 0,
+			(uint8_t)(length), (uint8_t)(length >> 8), (uint8_t)(length >> 16), (uint8_t)(length >> 24)
+		};
+		
+		status = sqlite3_blob_write(blob, header, (int)sizeof(header), 0);
+	}
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error opening blob: %d %s", status, sqlite3_errmsg(connection->db));
+		
+		if (blob) sqlite3_blob_close(blob);
+		
+		// The row has been zeroed, so it can't be left as-is
+		
+		[self removeObjectForCollectionKey:cacheKey withRowid:rowid];
+		return nil;
+	}
+	
+	YapDatabaseBlobWriteStream *stream =
+	  [[YapDatabaseBlobWriteStream alloc] initWithTransaction:self
+	                                                    blob:blob
+	                                              baseOffset:baseOffset
+	                                                  length:length
+	                                           collectionKey:cacheKey
+	                                                   rowid:rowid
+	                                                inserted:!found];
+	
+	if (openBlobStreams == nil)
+		openBlobStreams = [[NSMutableArray alloc] init];
+	
+	[openBlobStreams addObject:stream];
+	return stream;
 }
 
-/**
- * Sets the object & metadata for the given key/collection.
- *
- * If you pass nil for the object, then this method will remove the row from the database (if it exists).
- *
- * @param object
- *   The object to store in the database.
- *   This object is automatically serialized using the database's configured objectSerializer.
- *
- * @param key
- *   The lookup key.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   This value should not be nil. If a nil key is passed, then this method does nothing.
- *
- * @param collection
- *   The lookup collection.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
- *
- * @param metadata
- *   The metadata to store in the database.
- *   This metadata is automatically serialized using the database's configured metadataSerializer.
- *   The metadata is optional. You can pass nil for the metadata is unneeded.
- *   If non-nil then the metadata is also written to the database (metadata is also persistent).
-**/
-- (void)setObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection withMetadata:(id)metadata
+- (void)blobStreamDidClose:(id)stream
 {
-	[self setObject:object forKey:key inCollection:collection withMetadata:metadata
-                                                          serializedObject:nil
-	                                                    serializedMetadata:nil];
+	if ([stream isKindOfClass:[YapDatabaseBlobWriteStream class]])
+	{
+		__unsafe_unretained YapDatabaseBlobWriteStream *writeStream = (YapDatabaseBlobWriteStream *)stream;
+		
+		if ([writeStream isComplete])
+		{
+			[self didWriteObjectForCollectionKey:writeStream->collectionKey
+			                           withRowid:writeStream->rowid
+			                            inserted:writeStream->inserted];
+		}
+		else
+		{
+			YDBLogWarn(@"Write stream closed before the full length was written. Removing %@", writeStream->collectionKey);
+			
+			[self removeObjectForCollectionKey:writeStream->collectionKey withRowid:writeStream->rowid];
+		}
+	}
+	
+	[super blobStreamDidClose:stream];
 }
 
 /**
- * Sets the object & metadata for the given key/collection.
- * 
- * This method allows for a bit of optimization if you happen to already have a serialized version of
- * the object and/or metadata. For example, if you downloaded an object in serialized form,
- * and you still have the raw NSData, then you can use this method to skip the serialization step
- * when storing the object to the database.
- *
- * If you pass nil for the object, then this method will remove the row from the database (if it exists).
- *
- * @param object
- *   The object to store in the database.
- *   This object is automatically serialized using the database's configured objectSerializer.
- *
- * @param key
- *   The lookup key.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   This value should not be nil. If a nil key is passed, then this method does nothing.
- *
- * @param collection
- *   The lookup collection.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
- *
- * @param metadata
- *   The metadata to store in the database.
- *   This metadata is automatically serialized using the database's configured metadataSerializer.
- *   The metadata is optional. You can pass nil for the metadata is unneeded.
- *   If non-nil then the metadata is also written to the database (metadata is also persistent).
- * 
- * @param preSerializedObject
- *   This value is optional.
- *   If non-nil then the object serialization step is skipped, and this value is used instead.
- *   It is assumed that preSerializedObject is equal to what we would get if we ran the object through
- *   the database's configured objectSerializer.
- * 
- * @param preSerializedMetadata
- *   This value is optional.
- *   If non-nil then the metadata serialization step is skipped, and this value is used instead.
- *   It is assumed that preSerializedMetadata is equal to what we would get if we ran the metadata through
- *   the database's configured metadataSerializer.
- *
- * The preSerializedObject is only used if object is non-nil.
- * The preSerializedMetadata is only used if metadata is non-nil.
+ * Invoked when a write stream has been completely written.
+ * This is the equivalent of the bookkeeping performed by setObject:forKey:inCollection: & replaceObject:forKey:inCollection:.
 **/
-- (void)setObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
-                                                    withMetadata:(id)metadata
-                                                serializedObject:(NSData *)preSerializedObject
-                                              serializedMetadata:(NSData *)preSerializedMetadata
+- (void)didWriteObjectForCollectionKey:(YapCollectionKey *)cacheKey withRowid:(int64_t)rowid inserted:(BOOL)inserted
 {
+	[connection->objectCache removeObjectForKey:cacheKey];
+	[connection->objectChanges setObject:[YapNull null] forKey:cacheKey];
+	
+	if (inserted)
+	{
+		[connection->insertedKeys addObject:cacheKey];
+		
+		[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+		[connection->metadataChanges setObject:[YapNull null] forKey:cacheKey];
+	}
+	
+	NSArray *orderedExtensions = [self orderedExtensionsForCollection:cacheKey.collection];
+	if (orderedExtensions.count == 0) return;
+	
+	// The extensions need the object in order to process the change.
+	
+	id object = [self objectForKey:cacheKey.key inCollection:cacheKey.collection];
 	if (object == nil)
 	{
-		[self removeObjectForKey:key inCollection:collection];
+		YDBLogError(@"Unable to deserialize streamed object: %@", cacheKey);
 		return;
 	}
 	
-	if (key == nil) return;
-	if (collection == nil) collection = @"";
+	for (YapDatabaseExtensionTransaction *extTransaction in orderedExtensions)
+	{
+		if (inserted)
+			[extTransaction willInsertObject:object forCollectionKey:cacheKey withMetadata:nil];
+		else
+			[extTransaction willReplaceObject:object forCollectionKey:cacheKey withRowid:rowid];
+	}
 	
-	if (connection->database->objectPreSanitizer)
+	for (YapDatabaseExtensionTransaction *extTransaction in orderedExtensions)
 	{
-		object = connection->database->objectPreSanitizer(collection, key, object);
-		if (object == nil)
-		{
-			YDBLogWarn(@"The objectPreSanitizer returned nil for collection(%@) key(%@)", collection, key);
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		if (inserted)
+			[extTransaction didInsertObject:object forCollectionKey:cacheKey withMetadata:nil rowid:rowid];
+		else
+			[extTransaction didReplaceObject:object forCollectionKey:cacheKey withRowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Import
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSError *)importCollectionFromPath:(NSString *)path
+{
+	NSInputStream *stream = path ? [NSInputStream inputStreamWithFileAtPath:path] : nil;
+	if (stream == nil)
+	{
+		return YapDatabaseCollectionArchiveTransactionError([NSString stringWithFormat:@"Unable to open: %@", path]);
+	}
+	
+	return [self importCollectionFromStream:stream];
+}
+
+- (NSError *)importCollectionFromStream:(NSInputStream *)stream
+{
+	if (stream == nil) return YapDatabaseCollectionArchiveTransactionError(@"No stream given");
+	
+	YapDatabaseCollectionArchiveReader *reader = [[YapDatabaseCollectionArchiveReader alloc] initWithStream:stream];
+	if (![reader readHeader])
+	{
+		return reader.error;
+	}
+	
+	NSString *collection = reader.collection;
+	NSArray *orderedExtensions = [self orderedExtensionsForCollection:collection];
+	
+	NSMutableArray<NSString *> *keys = [NSMutableArray array];
+	NSMutableArray<NSData *> *serializedObjects = [NSMutableArray array];
+	NSMutableArray *serializedMetadata = [NSMutableArray array]; // NSNull if no metadata
+	
+	id nsNull = [NSNull null];
+	
+	for (;;)
+	{
+		@autoreleasepool {
 			
-			[self removeObjectForKey:key inCollection:collection];
-			return;
+			BOOL hasChunk = [reader readChunkWithBlock:^(NSString *key, NSData *oData, NSData *mData) {
+				
+				[keys addObject:key];
+				[serializedObjects addObject:oData];
+				[serializedMetadata addObject:(mData ?: nsNull)];
+			}];
+			
+			if (!hasChunk) break;
+			
+			// The data objects point into the chunk, so each chunk is written before the next one is read.
+			
+			if (orderedExtensions.count == 0)
+			{
+				[self _importSerializedObjects:serializedObjects
+				            serializedMetadata:serializedMetadata
+				                       forKeys:keys
+				                  inCollection:collection];
+			}
+			else
+			{
+				[self _importObjectsWithSerializedObjects:serializedObjects
+				                       serializedMetadata:serializedMetadata
+				                                  forKeys:keys
+				                             inCollection:collection];
+			}
+			
+			[keys removeAllObjects];
+			[serializedObjects removeAllObjects];
+			[serializedMetadata removeAllObjects];
 		}
 	}
-	if (metadata && connection->database->metadataPreSanitizer)
+	
+	if (reader.rowCount > 0)
 	{
-		metadata = connection->database->metadataPreSanitizer(collection, key, metadata);
-		if (metadata == nil)
-		{
-			YDBLogWarn(@"The metadataPresanitizer returned nil for collection(%@) key(%@)", collection, key);
-		}
+		[connection coarsenChangesetForCollection:collection];
 	}
 	
-	// To use SQLITE_STATIC on our data, we use the objc_precise_lifetime attribute.
-	// This ensures the data isn't released until it goes out of scope.
+	YDBLogVerbose(@"Imported %lu rows into collection(%@)", (unsigned long)reader.rowCount, collection);
 	
-	__attribute__((objc_precise_lifetime)) NSData *serializedObject = nil;
-	if (preSerializedObject)
-		serializedObject = preSerializedObject;
-	else
-		serializedObject = connection->database->objectSerializer(collection, key, object);
+	return reader.error;
+}
+
+/**
+ * Writes a chunk of an archive straight to the database (for collections without extensions).
+ *
+ * The caches are purged (rather than populated), as nothing is deserialized.
+ * The changeset is coarsened afterwards (see importCollectionFromStream:), so no per-key changes are recorded.
+**/
+- (void)_importSerializedObjects:(NSArray<NSData *> *)serializedObjects
+              serializedMetadata:(NSArray *)serializedMetadata
+                         forKeys:(NSArray<NSString *> *)keys
+                    inCollection:(NSString *)collection
+{
+	NSUInteger count = keys.count;
+	if (count == 0) return;
 	
-	__attribute__((objc_precise_lifetime)) NSData *serializedMetadata = nil;
-	if (metadata)
+	YapDatabase *database = connection->database;
+	id nsNull = [NSNull null];
+	
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray arrayWithCapacity:count];
+	for (NSUInteger i = 0; i < count; i++)
 	{
-		if (preSerializedMetadata)
-			serializedMetadata = preSerializedMetadata;
-		else
-			serializedMetadata = connection->database->metadataSerializer(collection, key, metadata);
+		[rowids addObject:@(0)];
 	}
 	
-	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	[self _enumerateRowidsForKeys:keys
+	                 inCollection:collection
+	          unorderedUsingBlock:^(NSUInteger keyIndex, int64_t rowid, BOOL __unused *stop)
+	{
+		rowids[keyIndex] = @(rowid);
+	}];
 	
-	// Fetch rowid for <collection, key> tuple
+	sqlite3_stmt *updateStatement = [connection updateAllForRowidStatement];
+	sqlite3_stmt *insertStatement = [connection insertForRowidStatement];
 	
-	int64_t rowid = 0;
-	BOOL found = [self getRowid:&rowid forCollectionKey:cacheKey];
-    
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		if (found)
-			[extTransaction willUpdateObject:object
-			                forCollectionKey:cacheKey
-			                    withMetadata:metadata
-			                           rowid:rowid];
-		else
-			[extTransaction willInsertObject:object
-			                forCollectionKey:cacheKey
-			                    withMetadata:metadata];
+	if (updateStatement == NULL || insertStatement == NULL) {
+		return;
 	}
 	
-	BOOL set = YES;
+	BOOL usesNativeMetadata = (YapDatabaseNativeMetadataTypeForCollection(database, collection) != 0);
+	int64_t collectionId = 0; // Looked up on first insert (collection-id schema only)
 	
-	if (found) // update data for key
+	NSUInteger writtenCount = 0;
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	
+	for (NSUInteger i = 0; i < count; i++)
 	{
-		sqlite3_stmt *statement = [connection updateAllForRowidStatement];
-		if (statement == NULL) {
-			return;
-		}
-		
-		// UPDATE "database2" SET "data" = ?, "metadata" = ? WHERE "rowid" = ?;
+		NSString *key = keys[i];
+		int64_t rowid = [rowids[i] longLongValue];
 		
-		int const bind_idx_data     = SQLITE_BIND_START + 0;
-		int const bind_idx_metadata = SQLITE_BIND_START + 1;
-		int const bind_idx_rowid    = SQLITE_BIND_START + 2;
+		__attribute__((objc_precise_lifetime)) NSData *oData =
+		  [self encodeSerializedObject:serializedObjects[i] inCollection:collection];
 		
-		sqlite3_bind_blob(statement, bind_idx_data,
-		                  serializedObject.bytes, (int)serializedObject.length, SQLITE_STATIC);
+		NSData *mData = serializedMetadata[i];
+		id nativeMetadata = nil;
 		
-		sqlite3_bind_blob(statement, bind_idx_metadata,
-		                  serializedMetadata.bytes, (int)serializedMetadata.length, SQLITE_STATIC);
+		if ((id)mData == nsNull)
+		{
+			mData = nil;
+		}
+		else if (usesNativeMetadata)
+		{
+			id metadata = database->metadataDeserializer(collection, key, mData);
+			if (YapDatabaseIsNativeMetadata(database, collection, metadata)) {
+				nativeMetadata = metadata;
+			}
+		}
 		
-		sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+		sqlite3_stmt *statement = (rowid != 0) ? updateStatement : insertStatement;
+		int bind_idx_data;
+		int bind_idx_metadata;
 		
-		int status = sqlite3_step(statement);
-		if (status != SQLITE_DONE)
+		if (rowid != 0)
 		{
-			YDBLogError(@"Error executing 'updateAllForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
-			set = NO;
+			// UPDATE "database2" SET "data" = ?, "metadata" = ? WHERE "rowid" = ?;
+			
+			bind_idx_data     = SQLITE_BIND_START + 0;
+			bind_idx_metadata = SQLITE_BIND_START + 1;
+			
+			int const bind_idx_rowid = SQLITE_BIND_START + 2;
+			
+			sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
 		}
-		
-		sqlite3_clear_bindings(statement);
-		sqlite3_reset(statement);
-	}
-	else // insert data for key
-	{
-		sqlite3_stmt *statement = [connection insertForRowidStatement];
-		if (statement == NULL) {
-			return;
+		else
+		{
+			// INSERT INTO "database2" ("collection", "key", "data", "metadata") VALUES (?, ?, ?, ?);
+			
+			if (database->usesCollectionIds && (collectionId == 0))
+			{
+				if (![connection getCollectionId:&collectionId forCollection:collection]) {
+					break;
+				}
+			}
+			
+			int const bind_idx_collection = SQLITE_BIND_START + 0;
+			int const bind_idx_key        = SQLITE_BIND_START + 1;
+			
+			bind_idx_data     = SQLITE_BIND_START + 2;
+			bind_idx_metadata = SQLITE_BIND_START + 3;
+			
+			if (database->usesCollectionIds)
+				sqlite3_bind_int64(statement, bind_idx_collection, collectionId);
+			else
+				sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+			
+			sqlite3_bind_text(statement, bind_idx_key, [key UTF8String], -1, SQLITE_TRANSIENT);
 		}
 		
-		// INSERT INTO "database2" ("collection", "key", "data", "metadata") VALUES (?, ?, ?, ?);
-		
-		int const bind_idx_collection = SQLITE_BIND_START + 0;
-		int const bind_idx_key        = SQLITE_BIND_START + 1;
-		int const bind_idx_data       = SQLITE_BIND_START + 2;
-		int const bind_idx_metadata   = SQLITE_BIND_START + 3;
-		
-		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
-		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
-		
-		YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-		sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
-		
-		sqlite3_bind_blob(statement, bind_idx_data,
-		                  serializedObject.bytes, (int)serializedObject.length, SQLITE_STATIC);
+		sqlite3_bind_blob(statement, bind_idx_data, oData.bytes, (int)oData.length, SQLITE_STATIC);
 		
-		sqlite3_bind_blob(statement, bind_idx_metadata,
-		                  serializedMetadata.bytes, (int)serializedMetadata.length, SQLITE_STATIC);
+		if (nativeMetadata)
+			YapDatabaseBindNativeMetadata(database, collection, nativeMetadata, statement, bind_idx_metadata);
+		else if (mData)
+			sqlite3_bind_blob(statement, bind_idx_metadata, mData.bytes, (int)mData.length, SQLITE_STATIC);
 		
 		int status = sqlite3_step(statement);
 		if (status == SQLITE_DONE)
 		{
-			rowid = sqlite3_last_insert_rowid(connection->db);
+			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			
+			if (rowid == 0)
+			{
+				rowid = sqlite3_last_insert_rowid(connection->db);
+				[connection->keyCache setObject:cacheKey forRowid:rowid];
+			}
+			
+			[connection->objectCache removeObjectForKey:cacheKey];
+			[connection->metadataCache removeObjectForKey:cacheKey];
 			
-			[connection->keyCache setObject:cacheKey forKey:@(rowid)];
+			writtenCount++;
 		}
 		else
 		{
-			YDBLogError(@"Error executing 'insertForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
-			set = NO;
+			YDBLogError(@"Error executing '%@': %d %s",
+			            (statement == updateStatement) ? @"updateAllForRowidStatement" : @"insertForRowidStatement",
+			            status, sqlite3_errmsg(connection->db));
 		}
 		
 		sqlite3_clear_bindings(statement);
 		sqlite3_reset(statement);
-		FreeYapDatabaseString(&_collection);
-		FreeYapDatabaseString(&_key);
 	}
 	
-	if (!set) return;
-	
-	connection->hasDiskChanges = YES;
-	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	FreeYapDatabaseString(&_collection);
 	
-	id _object = nil;
-	if (connection->objectPolicy == YapDatabasePolicyContainment) {
-		_object = [YapNull null];
-	}
-	else if (connection->objectPolicy == YapDatabasePolicyShare) {
-		_object = object;
-	}
-	else // if (connection->objectPolicy == YapDatabasePolicyCopy)
+	if (writtenCount > 0)
 	{
-		if ([object conformsToProtocol:@protocol(NSCopying)])
-			_object = [object copy];
-		else
-			_object = [YapNull null];
+		connection->hasDiskChanges = YES;
+		[connection->mutationStack markAsMutated];  // mutation during enumeration protection
 	}
+}
+
+/**
+ * Writes a chunk of an archive via the batched setObjects path (for collections with extensions),
+ * as the extensions need the objects in order to process the changes.
+ * The objects are deserialized, but the serialized forms from the archive are written as-is.
+**/
+- (void)_importObjectsWithSerializedObjects:(NSArray<NSData *> *)serializedObjects
+                         serializedMetadata:(NSArray *)serializedMetadata
+                                    forKeys:(NSArray<NSString *> *)keys
+                               inCollection:(NSString *)collection
+{
+	NSUInteger count = keys.count;
+	if (count == 0) return;
 	
-	if (!found) {
-		[connection->insertedKeys addObject:cacheKey];
-	}
+	YapDatabase *database = connection->database;
+	id nsNull = [NSNull null];
 	
-	[connection->objectCache setObject:object forKey:cacheKey];
-	[connection->objectChanges setObject:_object forKey:cacheKey];
+	NSMutableArray *batchKeys = [NSMutableArray arrayWithCapacity:count];
+	NSMutableArray *batchObjects = [NSMutableArray arrayWithCapacity:count];
+	NSMutableArray *batchMetadata = [NSMutableArray arrayWithCapacity:count];
+	NSMutableArray *batchSerializedObjects = [NSMutableArray arrayWithCapacity:count];
+	NSMutableArray *batchSerializedMetadata = [NSMutableArray arrayWithCapacity:count];
 	
-	if (metadata)
+	for (NSUInteger i = 0; i < count; i++)
 	{
-		id _metadata = nil;
-		if (connection->metadataPolicy == YapDatabasePolicyContainment) {
-			_metadata = [YapNull null];
-		}
-		else if (connection->metadataPolicy == YapDatabasePolicyShare) {
-			_metadata = metadata;
+		NSString *key = keys[i];
+		
+		// The archive contains the serialized forms (never compressed), so the deserializers are invoked directly.
+		
+		NSData *oData = serializedObjects[i];
+		id object = database->objectDeserializer(collection, key, oData);
+		if (object == nil)
+		{
+			YDBLogWarn(@"Unable to deserialize imported object: collection(%@) key(%@)", collection, key);
+			continue;
 		}
-		else // if (connection->metadataPolicy = YapDatabasePolicyCopy)
+		
+		NSData *mData = serializedMetadata[i];
+		id metadata = nil;
+		
+		if ((id)mData != nsNull)
 		{
-			if ([metadata conformsToProtocol:@protocol(NSCopying)])
-				_metadata = [metadata copy];
-			else
-				_metadata = [YapNull null];
+			metadata = database->metadataDeserializer(collection, key, mData);
 		}
 		
-		[connection->metadataCache setObject:metadata forKey:cacheKey];
-		[connection->metadataChanges setObject:_metadata forKey:cacheKey];
-	}
-	else
-	{
-		[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
-		[connection->metadataChanges setObject:[YapNull null] forKey:cacheKey];
+		// The data objects point into the archive's chunk, which is reused for the next chunk.
+		// But the serialized forms are only needed until setObjects returns.
+		
+		[batchKeys addObject:key];
+		[batchObjects addObject:object];
+		[batchMetadata addObject:(metadata ?: nsNull)];
+		[batchSerializedObjects addObject:oData];
+		[batchSerializedMetadata addObject:(metadata ? mData : nsNull)];
 	}
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		if (found)
-			[extTransaction didUpdateObject:object
-			               forCollectionKey:cacheKey
-			                   withMetadata:metadata
-			                          rowid:rowid];
-		else
-			[extTransaction didInsertObject:object
-			               forCollectionKey:cacheKey
-			                   withMetadata:metadata
-			                          rowid:rowid];
-	}
+	[self _setObjects:batchObjects
+	          forKeys:batchKeys
+	     inCollection:collection
+	     withMetadata:batchMetadata
+	serializedObjects:batchSerializedObjects
+	serializedMetadata:batchSerializedMetadata];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Touch
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)touchObjectForKey:(NSString *)key inCollection:(NSString *)collection
+{
+	if (collection == nil) collection = @"";
 	
-	if (connection->database->objectPostSanitizer)
-	{
-		connection->database->objectPostSanitizer(collection, key, object);
-	}
-	if (metadata && connection->database->metadataPostSanitizer)
+	int64_t rowid = 0;
+	if (![self getRowid:&rowid forKey:key inCollection:collection]) return;
+	
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	
+	[self spillChangesetIfNeeded];
+	
+	if ([connection->objectChanges objectForKey:cacheKey] == nil)
+		[connection->objectChanges setObject:[YapTouch touch] forKey:cacheKey];
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
 	{
-		connection->database->metadataPostSanitizer(collection, key, metadata);
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		[extTransaction didTouchObjectForCollectionKey:cacheKey withRowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 	}
 }
 
-/**
- * If a row with the given key/collection exists, then replaces the object for that row with the new value.
- *
- * It only replaces the object. The metadata for the row doesn't change.
- * If there is no row in the database for the given key/collection then this method does nothing.
- *
- * If you pass nil for the object, then this method will remove the row from the database (if it exists).
- *
- * @param object
- *   The object to store in the database.
- *   This object is automatically serialized using the database's configured objectSerializer.
- *
- * @param key
- *   The lookup key.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   This value should not be nil. If a nil key is passed, then this method does nothing.
- *
- * @param collection
- *   The lookup collection.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
-**/
-- (void)replaceObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
+- (void)touchObjectsForKeys:(NSArray<NSString *> *)keys inCollection:(NSString *)collection
 {
-	int64_t rowid = 0;
-	if ([self getRowid:&rowid forKey:key inCollection:collection])
+	if (keys.count == 0) return;
+	if (collection == nil)
+		collection = @"";
+	else
+		collection = [collection copy]; // mutable string protection
+	
+	NSMutableArray<YapCollectionKey *> *cacheKeys = [NSMutableArray arrayWithCapacity:keys.count];
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray arrayWithCapacity:keys.count];
+	
+	YapTouch *yapTouch = [YapTouch touch];
+	
+	for (NSString *key in keys)
 	{
-		[self replaceObject:object forKey:key inCollection:collection withRowid:rowid serializedObject:nil];
+		int64_t rowid = 0;
+		if (![self getRowid:&rowid forKey:key inCollection:collection]) continue;
+		
+		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		[self spillChangesetIfNeeded];
+		
+		if ([connection->objectChanges objectForKey:cacheKey] == nil)
+			[connection->objectChanges setObject:yapTouch forKey:cacheKey];
+		
+		[cacheKeys addObject:cacheKey];
+		[rowids addObject:@(rowid)];
+	}
+	
+	if (cacheKeys.count == 0) return;
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
+	{
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		[extTransaction didTouchObjectsForCollectionKeys:cacheKeys withRowids:rowids];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 	}
 }
 
-/**
- * If a row with the given key/collection exists, then replaces the object for that row with the new value.
- *
- * It only replaces the object. The metadata for the row doesn't change.
- * If there is no row in the database for the given key/collection then this method does nothing.
- *
- * If you pass nil for the object, then this method will remove the row from the database (if it exists).
- * 
- * This method allows for a bit of optimization if you happen to already have a serialized version of
- * the object and/or metadata. For example, if you downloaded an object in serialized form,
- * and you still have the raw serialized NSData, then you can use this method to skip the serialization step
- * when storing the object to the database.
- *
- * @param object
- *   The object to store in the database.
- *   This object is automatically serialized using the database's configured objectSerializer.
- *
- * @param key
- *   The lookup key.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   This value should not be nil. If a nil key is passed, then this method does nothing.
- *
- * @param collection
- *   The lookup collection.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
- *
- * @param preSerializedObject
- *   This value is optional.
- *   If non-nil then the object serialization step is skipped, and this value is used instead.
- *   It is assumed that preSerializedObject is equal to what we would get if we ran the object through
- *   the database's configured objectSerializer.
-**/
-- (void)replaceObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
-                                                withSerializedObject:(NSData *)preSerializedObject
+- (void)touchMetadataForKey:(NSString *)key inCollection:(NSString *)collection
 {
+	if (collection == nil) collection = @"";
+	
 	int64_t rowid = 0;
-	if ([self getRowid:&rowid forKey:key inCollection:collection])
+	if (![self getRowid:&rowid forKey:key inCollection:collection]) return;
+	
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	
+	[self spillChangesetIfNeeded];
+	
+	if ([connection->metadataChanges objectForKey:cacheKey] == nil)
+		[connection->metadataChanges setObject:[YapTouch touch] forKey:cacheKey];
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
 	{
-		[self replaceObject:object
-		             forKey:key
-		       inCollection:collection
-		          withRowid:rowid
-		   serializedObject:preSerializedObject];
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		[extTransaction didTouchMetadataForCollectionKey:cacheKey withRowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 	}
 }
 
-/**
- * Internal replaceObject method that takes a rowid.
-**/
-- (void)replaceObject:(id)object forKey:(NSString *)key inCollection:(NSString *)collection
-                                                           withRowid:(int64_t)rowid
-                                                    serializedObject:(NSData *)preSerializedObject
+- (void)touchRowForKey:(NSString *)key inCollection:(NSString *)collection
 {
-	if (object == nil)
-	{
-		[self removeObjectForKey:key inCollection:collection withRowid:rowid];
-		return;
-	}
-	
-	NSAssert(key != nil, @"Internal error");
 	if (collection == nil) collection = @"";
 	
-	if (connection->database->objectPreSanitizer)
+	int64_t rowid = 0;
+	if (![self getRowid:&rowid forKey:key inCollection:collection]) return;
+	
+	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	
+	[self spillChangesetIfNeeded];
+	
+	if ([connection->objectChanges objectForKey:cacheKey] == nil)
+		[connection->objectChanges setObject:[YapTouch touch] forKey:cacheKey];
+	
+	if ([connection->metadataChanges objectForKey:cacheKey] == nil)
+		[connection->metadataChanges setObject:[YapTouch touch] forKey:cacheKey];
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
 	{
-		object = connection->database->objectPreSanitizer(collection, key, object);
-		if (object == nil)
-		{
-			YDBLogWarn(@"The objectPreSanitizer returned nil for collection(%@) key(%@)", collection, key);
-			
-			[self removeObjectForKey:key inCollection:collection withRowid:rowid];
-			return;
-		}
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		[extTransaction didTouchRowForCollectionKey:cacheKey withRowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Remove
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)removeObjectForCollectionKey:(YapCollectionKey *)cacheKey withRowid:(int64_t)rowid;
+{
+	if (cacheKey == nil) return;
 	
-	// To use SQLITE_STATIC on our data blob, we use the objc_precise_lifetime attribute.
-	// This ensures the data isn't released until it goes out of scope.
-	
-	__attribute__((objc_precise_lifetime)) NSData *serializedObject = nil;
-	if (preSerializedObject)
-		serializedObject = preSerializedObject;
-	else
-		serializedObject = connection->database->objectSerializer(collection, key, object);
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordOperation:YapDatabaseWorkloadTraceOperationRemove
+		                                collection:cacheKey.collection
+		                                       key:cacheKey.key];
+	}
 	
-	sqlite3_stmt *statement = [connection updateObjectForRowidStatement];
+	sqlite3_stmt *statement = [connection removeForRowidStatement];
 	if (statement == NULL) return;
 	
-	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-	
+	// Issue #215
+	//
 	// Be sure to execute pre-hook BEFORE we bind query parameters.
+	// Because if the pre-hook deletes any rows in the database, this method would be called again,
+	// and our binding would get erased.
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:cacheKey.collection])
 	{
-		[extTransaction willReplaceObject:object forCollectionKey:cacheKey withRowid:rowid];
+		[extTransaction willRemoveObjectForCollectionKey:cacheKey withRowid:rowid];
 	}
 	
-	// UPDATE "database2" SET "data" = ? WHERE "rowid" = ?;
+	// DELETE FROM "database" WHERE "rowid" = ?;
 	
-	int const bind_idx_data  = SQLITE_BIND_START + 0;
-	int const bind_idx_rowid = SQLITE_BIND_START + 1;
+	int const bind_idx_rowid = SQLITE_BIND_START;
 	
-	sqlite3_bind_blob(statement, bind_idx_data, serializedObject.bytes, (int)serializedObject.length, SQLITE_STATIC);
 	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
 	
-	BOOL updated = YES;
+	BOOL removed = YES;
 	
 	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
 	{
-		YDBLogError(@"Error executing 'updateObjectForRowidStatement': %d %s",
-		                                                    status, sqlite3_errmsg(connection->db));
-		updated = NO;
+		YDBLogError(@"Error executing 'removeForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		removed = NO;
 	}
 	
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
-	if (!updated) return;
+	if (!removed) return;
 	
 	connection->hasDiskChanges = YES;
 	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	[self spillChangesetIfNeeded];
 	
-	id _object = nil;
-	if (connection->objectPolicy == YapDatabasePolicyContainment) {
-		_object = [YapNull null];
-	}
-	else if (connection->objectPolicy == YapDatabasePolicyShare) {
-		_object = object;
-	}
-	else // if (connection->objectPolicy = YapDatabasePolicyCopy)
-	{
-		if ([object conformsToProtocol:@protocol(NSCopying)])
-			_object = [object copy];
-		else
-			_object = [YapNull null];
-	}
-	
-	[connection->objectCache setObject:object forKey:cacheKey];
-	[connection->objectChanges setObject:_object forKey:cacheKey];
+	[connection->keyCache removeObjectForRowid:rowid];
+	[connection->objectCache removeObjectForKey:cacheKey];
+	[connection->metadataCache removeObjectForKey:cacheKey];
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		[extTransaction didReplaceObject:object forCollectionKey:cacheKey withRowid:rowid];
-	}
+	[connection->objectChanges removeObjectForKey:cacheKey];
+	[connection->metadataChanges removeObjectForKey:cacheKey];
+	[connection->insertedKeys removeObject:cacheKey];
+	[connection->removedKeys addObject:cacheKey];
+	YapRowidSetAdd(connection->removedRowids, rowid);
 	
-	if (connection->database->objectPostSanitizer)
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:cacheKey.collection])
 	{
-		connection->database->objectPostSanitizer(collection, key, object);
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		[extTransaction didRemoveObjectForCollectionKey:cacheKey withRowid:rowid];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 	}
 }
 
-/**
- * If a row with the given key/collection exists, then replaces the metadata for that row with the new value.
- *
- * It only replaces the metadata. The object for the row doesn't change.
- * If there is no row in the database for the given key/collection then this method does nothing.
- *
- * If you pass nil for the metadata, any metadata previously associated with the key/collection is removed.
- *
- * @param metadata
- *   The metadata to store in the database.
- *   This metadata is automatically serialized using the database's configured metadataSerializer.
- *
- * @param key
- *   The lookup key.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   This value should not be nil. If a nil key is passed, then this method does nothing.
- *
- * @param collection
- *   The lookup collection.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
-**/
-- (void)replaceMetadata:(id)metadata forKey:(NSString *)key inCollection:(NSString *)collection
+- (void)removeObjectForKey:(NSString *)key inCollection:(NSString *)collection withRowid:(int64_t)rowid
 {
-	int64_t rowid = 0;
-	if ([self getRowid:&rowid forKey:key inCollection:collection])
-	{
-		[self replaceMetadata:metadata forKey:key inCollection:collection withRowid:rowid serializedMetadata:nil];
-	}
+	YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	[self removeObjectForCollectionKey:ck withRowid:rowid];
 }
 
-/**
- * If a row with the given key/collection exists, then replaces the metadata for that row with the new value.
- *
- * It only replaces the metadata. The object for the row doesn't change.
- * If there is no row in the database for the given key/collection then this method does nothing.
- *
- * If you pass nil for the metadata, any metadata previously associated with the key/collection is removed.
- *
- * This method allows for a bit of optimization if you happen to already have a serialized version of
- * the object and/or metadata. For example, if you downloaded an object in serialized form,
- * and you still have the raw serialized NSData, then you can use this method to skip the serialization step
- * when storing the object to the database.
- * 
- * @param metadata
- *   The metadata to store in the database.
- *   This metadata is automatically serialized using the database's configured metadataSerializer.
- *
- * @param key
- *   The lookup key.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   This value should not be nil. If a nil key is passed, then this method does nothing.
- *
- * @param collection
- *   The lookup collection.
- *   The <collection, key> tuple is used to uniquely identify the row in the database.
- *   If a nil collection is passed, then the collection is implicitly the empty string (@"").
- * 
- * @param preSerializedMetadata
- *   This value is optional.
- *   If non-nil then the metadata serialization step is skipped, and this value is used instead.
- *   It is assumed that preSerializedMetadata is equal to what we would get if we ran the metadata through
- *   the database's configured metadataSerializer.
-**/
-- (void)replaceMetadata:(id)metadata forKey:(NSString *)key inCollection:(NSString *)collection
-                                                  withSerializedMetadata:(NSData *)preSerializedMetadata
+- (void)removeObjectForKey:(NSString *)key inCollection:(NSString *)collection
 {
 	int64_t rowid = 0;
 	if ([self getRowid:&rowid forKey:key inCollection:collection])
 	{
-		[self replaceMetadata:metadata
-		               forKey:key
-		         inCollection:collection
-		            withRowid:rowid
-		   serializedMetadata:preSerializedMetadata];
+		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		[self removeObjectForCollectionKey:ck withRowid:rowid];
 	}
 }
 
-/**
- * Internal replaceMetadata method that takes a rowid.
-**/
-- (void)replaceMetadata:(id)metadata
-                 forKey:(NSString *)key
-           inCollection:(NSString *)collection
-              withRowid:(int64_t)rowid
-     serializedMetadata:(NSData *)preSerializedMetadata
+- (void)removeObjectsForKeys:(NSArray *)keys inCollection:(NSString *)collection
 {
-	NSAssert(key != nil, @"Internal error");
-	if (collection == nil) collection = @"";
-	
-	if (metadata && connection->database->metadataPreSanitizer)
-	{
-		metadata = connection->database->metadataPreSanitizer(collection, key, metadata);
-		if (metadata == nil)
-		{
-			YDBLogWarn(@"The metadataPreSanitizer returned nil for collection(%@) key(%@)", collection, key);
-		}
-	}
-	
-	// To use SQLITE_STATIC on our data blob, we use the objc_precise_lifetime attribute.
-	// This ensures the data isn't released until it goes out of scope.
+	NSUInteger keysCount = [keys count];
 	
-	__attribute__((objc_precise_lifetime)) NSData *serializedMetadata = nil;
-	if (metadata)
-	{
-		if (preSerializedMetadata)
-			serializedMetadata = preSerializedMetadata;
-		else
-			serializedMetadata = connection->database->metadataSerializer(collection, key, metadata);
+	if (keysCount == 0) return;
+	if (keysCount == 1) {
+		[self removeObjectForKey:[keys objectAtIndex:0] inCollection:collection];
+		return;
 	}
 	
-	sqlite3_stmt *statement = [connection updateMetadataForRowidStatement];
-	if (statement == NULL) return;
-	
-	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-	
-	// Be sure to execute pre-hook BEFORE we bind query parameters.
+	if (collection == nil)
+		collection = @"";
+	else
+		collection = [collection copy]; // mutable string protection
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
+	if (connection->workloadTrace)
 	{
-		[extTransaction willReplaceMetadata:metadata forCollectionKey:cacheKey withRowid:rowid];
+		for (NSString *key in keys)
+		{
+			[connection->workloadTrace recordOperation:YapDatabaseWorkloadTraceOperationRemove
+			                                collection:collection
+			                                       key:key];
+		}
 	}
 	
-	// UPDATE "database2" SET "metadata" = ? WHERE "rowid" = ?;
-	
-	int const bind_idx_metadata = SQLITE_BIND_START + 0;
-	int const bind_idx_rowid    = SQLITE_BIND_START + 1;
-	
-	sqlite3_bind_blob(statement, bind_idx_metadata,
-	                  serializedMetadata.bytes, (int)serializedMetadata.length, SQLITE_STATIC);
-	
-	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+	NSMutableArray *foundKeys = nil;
+	NSMutableArray *foundRowids = nil;
 	
-	BOOL updated = YES;
-
-	int status = sqlite3_step(statement);
-	if (status != SQLITE_DONE)
-	{
-		YDBLogError(@"Error executing 'updateMetadataForRowidStatement': %d %s",
-		                                                    status, sqlite3_errmsg(connection->db));
-		updated = NO;
-	}
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// We need to watch out for this in case a large array of keys is passed.
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
 	
-	if (!updated) return;
+	// Loop over the keys, and remove them in big batches.
 	
-	connection->hasDiskChanges = YES;
-	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
 	
-	if (metadata)
+	NSUInteger keysIndex = 0;
+	do
 	{
-		id _metadata = nil;
-		if (connection->metadataPolicy == YapDatabasePolicyContainment) {
-			_metadata = [YapNull null];
+		NSUInteger left = keysCount - keysIndex;
+		NSUInteger numKeyParams = MIN(left, (maxHostParams-1)); // minus 1 for collectionParam
+		
+		if (foundKeys == nil)
+		{
+			foundKeys   = [NSMutableArray arrayWithCapacity:numKeyParams];
+			foundRowids = [NSMutableArray arrayWithCapacity:numKeyParams];
+		}
+		else
+		{
+			[foundKeys removeAllObjects];
+			[foundRowids removeAllObjects];
 		}
-		else if (connection->metadataPolicy == YapDatabasePolicyShare) {
-			_metadata = metadata;
+		
+		// Find rowids for keys
+		
+		if (YES)
+		{
+			// SELECT "rowid", "key" FROM "database2" WHERE "collection" = ? AND "key" IN (?, ?, ...);
+			
+			int const column_idx_rowid = SQLITE_COLUMN_START + 0;
+			int const column_idx_key   = SQLITE_COLUMN_START + 1;
+			
+			NSUInteger capacity = 100 + (numKeyParams * 3);
+			NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
+			
+			[query appendString:
+			    @"SELECT \"rowid\", \"key\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" IN ("];
+			
+			NSUInteger i;
+			for (i = 0; i < numKeyParams; i++)
+			{
+				if (i == 0)
+					[query appendString:@"?"];
+				else
+					[query appendString:@", ?"];
+			}
+			
+			[query appendString:@");"];
+			
+			sqlite3_stmt *statement;
+			
+			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error creating 'removeKeys:inCollection:' statement (A): %d %s",
+				                                                              status, sqlite3_errmsg(connection->db));
+				FreeYapDatabaseString(&_collection);
+				return;
+			}
+			
+			sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
+			
+			for (i = 0; i < numKeyParams; i++)
+			{
+				NSString *key = [keys objectAtIndex:(keysIndex + i)];
+				sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + 1 + i), [key UTF8String], -1, SQLITE_TRANSIENT);
+			}
+			
+			while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+			{
+				int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+				
+				const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+				int textSize = sqlite3_column_bytes(statement, column_idx_key);
+				
+				NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+				
+				[foundKeys addObject:key];
+				[foundRowids addObject:@(rowid)];
+			}
+			
+			if (status != SQLITE_DONE)
+			{
+				YDBLogError(@"Error executing 'removeKeys:inCollection:' statement (A): %d %s",
+				                                                               status, sqlite3_errmsg(connection->db));
+			}
+			
+			sqlite3_finalize(statement);
+			statement = NULL;
 		}
-		else // if (connection->metadataPolicy = YapDatabasePolicyCopy)
+		
+		// Now remove all the matching rows
+		
+		NSUInteger foundCount = [foundRowids count];
+		
+		if (foundCount > 0)
 		{
-			if ([metadata conformsToProtocol:@protocol(NSCopying)])
-				_metadata = [metadata copy];
-			else
-				_metadata = [YapNull null];
+			// DELETE FROM "database2" WHERE "rowid" in (?, ?, ...);
+			
+			NSUInteger capacity = 50 + (foundCount * 3);
+			NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
+			
+			[query appendString:(connection->database->usesCollectionIds
+			    ? @"DELETE FROM \"database3\" WHERE \"rowid\" IN ("
+			    : @"DELETE FROM \"database2\" WHERE \"rowid\" IN (")];
+			
+			NSUInteger i;
+			for (i = 0; i < foundCount; i++)
+			{
+				if (i == 0)
+					[query appendString:@"?"];
+				else
+					[query appendString:@", ?"];
+			}
+			
+			[query appendString:@");"];
+			
+			sqlite3_stmt *statement;
+			
+			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
+			if (status != SQLITE_OK)
+			{
+				YDBLogError(@"Error creating 'removeKeys:inCollection:' statement (B): %d %s",
+							status, sqlite3_errmsg(connection->db));
+				return;
+			}
+			
+            for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
+            {
+                [extTransaction willRemoveObjectsForKeys:foundKeys
+                                            inCollection:collection
+                                              withRowids:foundRowids];
+            }
+			
+			for (i = 0; i < foundCount; i++)
+			{
+				int64_t rowid = [[foundRowids objectAtIndex:i] longLongValue];
+				
+				sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
+			}
+            
+			status = sqlite3_step(statement);
+			if (status != SQLITE_DONE)
+			{
+				YDBLogError(@"Error executing 'removeKeys:inCollection:' statement (B): %d %s",
+							status, sqlite3_errmsg(connection->db));
+			}
+			
+			sqlite3_finalize(statement);
+			statement = NULL;
+			
+			connection->hasDiskChanges = YES;
+			[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+			[self spillChangesetIfNeeded];
+			
+			[connection->keyCache removeObjectsForRowids:foundRowids];
+			for (NSNumber *rowidNumber in foundRowids)
+			{
+				YapRowidSetAdd(connection->removedRowids, [rowidNumber longLongValue]);
+			}
+			
+			for (NSString *key in foundKeys)
+			{
+				YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+				
+				[connection->objectCache removeObjectForKey:cacheKey];
+				[connection->metadataCache removeObjectForKey:cacheKey];
+				
+				[connection->objectChanges removeObjectForKey:cacheKey];
+				[connection->metadataChanges removeObjectForKey:cacheKey];
+				[connection->insertedKeys removeObject:cacheKey];
+				[connection->removedKeys addObject:cacheKey];
+			}
+			
+			for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
+			{
+				uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+				
+				[extTransaction didRemoveObjectsForKeys:foundKeys
+				                           inCollection:collection
+				                             withRowids:foundRowids];
+				
+				YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
+			}
+			
 		}
 		
-		[connection->metadataCache setObject:metadata forKey:cacheKey];
-		[connection->metadataChanges setObject:_metadata forKey:cacheKey];
-	}
-	else
-	{
-		[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
-		[connection->metadataChanges setObject:[YapNull null] forKey:cacheKey];
-	}
+		// Move on to the next batch (if there's more)
+		
+		keysIndex += numKeyParams;
+		
+	} while (keysIndex < keysCount);
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		[extTransaction didReplaceMetadata:metadata forCollectionKey:cacheKey withRowid:rowid];
-	}
 	
-	if (metadata && connection->database->metadataPostSanitizer)
-	{
-		connection->database->metadataPostSanitizer(collection, key, metadata);
-	}
+	FreeYapDatabaseString(&_collection);
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Touch
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (void)touchObjectForKey:(NSString *)key inCollection:(NSString *)collection
+- (void)removeAllObjectsInCollection:(NSString *)collection
 {
-	if (collection == nil) collection = @"";
-	
-	int64_t rowid = 0;
-	if (![self getRowid:&rowid forKey:key inCollection:collection]) return;
-	
-	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-	
-	if ([connection->objectChanges objectForKey:cacheKey] == nil)
-		[connection->objectChanges setObject:[YapTouch touch] forKey:cacheKey];
-	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		[extTransaction didTouchObjectForCollectionKey:cacheKey withRowid:rowid];
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordRemoveCollection:(collection ?: @"")];
 	}
-}
-
-- (void)touchMetadataForKey:(NSString *)key inCollection:(NSString *)collection
-{
-	if (collection == nil) collection = @"";
-	
-	int64_t rowid = 0;
-	if (![self getRowid:&rowid forKey:key inCollection:collection]) return;
-	
-	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-	
-	if ([connection->metadataChanges objectForKey:cacheKey] == nil)
-		[connection->metadataChanges setObject:[YapTouch touch] forKey:cacheKey];
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		[extTransaction didTouchMetadataForCollectionKey:cacheKey withRowid:rowid];
-	}
+	[self _removeAllObjectsInCollection:collection notifyingExtensions:[self orderedExtensionsForCollection:collection]];
 }
 
-- (void)touchRowForKey:(NSString *)key inCollection:(NSString *)collection
+/**
+ * Truncates the collection with a single DELETE, without learning the removed keys,
+ * for every extension that's able to handle the removal in bulk (see handleRemoveAllObjectsInCollection:).
+ * Any remaining extensions are notified of the removed keys (in batches), as with removeAllObjectsInCollection:.
+**/
+- (void)truncateCollection:(NSString *)collection
 {
-	if (collection == nil) collection = @"";
-	
-	int64_t rowid = 0;
-	if (![self getRowid:&rowid forKey:key inCollection:collection]) return;
-	
-	YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	if (collection == nil)
+		collection  = @"";
+	else
+		collection = [collection copy]; // mutable string protection
 	
-	if ([connection->objectChanges objectForKey:cacheKey] == nil)
-		[connection->objectChanges setObject:[YapTouch touch] forKey:cacheKey];
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordRemoveCollection:collection];
+	}
 	
-	if ([connection->metadataChanges objectForKey:cacheKey] == nil)
-		[connection->metadataChanges setObject:[YapTouch touch] forKey:cacheKey];
+	NSMutableArray *remainingExtensions = nil;
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensionsForCollection:collection])
 	{
-		[extTransaction didTouchRowForCollectionKey:cacheKey withRowid:rowid];
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		if (![extTransaction handleRemoveAllObjectsInCollection:collection])
+		{
+			if (remainingExtensions == nil)
+				remainingExtensions = [NSMutableArray array];
+			
+			[remainingExtensions addObject:extTransaction];
+		}
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 	}
+	
+	[self _removeAllObjectsInCollection:collection notifyingExtensions:remainingExtensions];
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Remove
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (void)removeObjectForCollectionKey:(YapCollectionKey *)cacheKey withRowid:(int64_t)rowid;
+/**
+ * The given extensions receive the per-key hooks (willRemoveObjectsForKeys:... & didRemoveObjectsForKeys:...).
+ * If there aren't any, the rows are removed with a single DELETE.
+**/
+- (void)_removeAllObjectsInCollection:(NSString *)collection notifyingExtensions:(NSArray *)extensions
 {
-	if (cacheKey == nil) return;
+	if (collection == nil)
+		collection  = @"";
+	else
+		collection = [collection copy]; // mutable string protection
 	
-	sqlite3_stmt *statement = [connection removeForRowidStatement];
-	if (statement == NULL) return;
+	// Purge the caches and changesets
 	
-	// Issue #215
-	//
-	// Be sure to execute pre-hook BEFORE we bind query parameters.
-	// Because if the pre-hook deletes any rows in the database, this method would be called again,
-	// and our binding would get erased.
+	NSMutableArray *toRemove = [NSMutableArray array];
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		[extTransaction willRemoveObjectForCollectionKey:cacheKey withRowid:rowid];
+	{ // keyCache
+		
+		[connection->keyCache enumerateRowidsAndObjectsWithBlock:^(int64_t rowid, id obj, BOOL __unused *stop) {
+			
+			__unsafe_unretained YapCollectionKey *collectionKey = (YapCollectionKey *)obj;
+			if ([collectionKey.collection isEqualToString:collection])
+			{
+				[toRemove addObject:@(rowid)];
+			}
+		}];
+		
+		[connection->keyCache removeObjectsForRowids:toRemove];
+		[toRemove removeAllObjects];
 	}
 	
-	// DELETE FROM "database" WHERE "rowid" = ?;
-	
-	int const bind_idx_rowid = SQLITE_BIND_START;
-	
-	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+	{ // objectCache
+		
+		[connection->objectCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+			
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			if ([cacheKey.collection isEqualToString:collection])
+			{
+				[toRemove addObject:cacheKey];
+			}
+		}];
+		
+		[connection->objectCache removeObjectsForKeys:toRemove];
+		[toRemove removeAllObjects];
+	}
 	
-	BOOL removed = YES;
-
-	int status = sqlite3_step(statement);
-	if (status != SQLITE_DONE)
-	{
-		YDBLogError(@"Error executing 'removeForRowidStatement': %d %s", status, sqlite3_errmsg(connection->db));
-		removed = NO;
+	{ // objectChanges
+		
+		for (id key in [connection->objectChanges keyEnumerator])
+		{
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			if ([cacheKey.collection isEqualToString:collection])
+			{
+				[toRemove addObject:cacheKey];
+			}
+		}
+		
+		[connection->objectChanges removeObjectsForKeys:toRemove];
+		[toRemove removeAllObjects];
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	{ // metadataCache
+		
+		[connection->metadataCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+			
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			if ([cacheKey.collection isEqualToString:collection])
+			{
+				[toRemove addObject:cacheKey];
+			}
+		}];
+		
+		[connection->metadataCache removeObjectsForKeys:toRemove];
+		[toRemove removeAllObjects];
+	}
 	
-	if (!removed) return;
+	{ // metadataChanges
+		
+		for (id key in [connection->metadataChanges keyEnumerator])
+		{
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			if ([cacheKey.collection isEqualToString:collection])
+			{
+				[toRemove addObject:cacheKey];
+			}
+		}
+		
+		[connection->metadataChanges removeObjectsForKeys:toRemove];
+		[toRemove removeAllObjects];
+	}
 	
-	connection->hasDiskChanges = YES;
-	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	{ // insertedKeys
+		
+		for (NSString *key in connection->insertedKeys)
+		{
+			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+			if ([cacheKey.collection isEqualToString:collection])
+			{
+				[toRemove addObject:cacheKey];
+			}
+		}
+		
+		for (NSString *cacheKey in toRemove)
+		{
+			[connection->insertedKeys removeObject:cacheKey];
+		}
+	}
 	
-	[connection->keyCache removeObjectForKey:@(rowid)];
-	[connection->objectCache removeObjectForKey:cacheKey];
-	[connection->metadataCache removeObjectForKey:cacheKey];
+	[connection->removedCollections addObject:collection];
 	
-	[connection->objectChanges removeObjectForKey:cacheKey];
-	[connection->metadataChanges removeObjectForKey:cacheKey];
-	[connection->insertedKeys removeObject:cacheKey];
-	[connection->removedKeys addObject:cacheKey];
-	[connection->removedRowids addObject:@(rowid)];
+	// If there are no active extensions we can take a shortcut
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-	{
-		[extTransaction didRemoveObjectForCollectionKey:cacheKey withRowid:rowid];
-	}
-}
-
-- (void)removeObjectForKey:(NSString *)key inCollection:(NSString *)collection withRowid:(int64_t)rowid
-{
-	YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-	[self removeObjectForCollectionKey:ck withRowid:rowid];
-}
-
-- (void)removeObjectForKey:(NSString *)key inCollection:(NSString *)collection
-{
-	int64_t rowid = 0;
-	if ([self getRowid:&rowid forKey:key inCollection:collection])
+	if ([extensions count] == 0)
 	{
-		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-		
-		[self removeObjectForCollectionKey:ck withRowid:rowid];
-	}
-}
-
-- (void)removeObjectsForKeys:(NSArray *)keys inCollection:(NSString *)collection
-{
-	NSUInteger keysCount = [keys count];
+		sqlite3_stmt *statement = [connection removeCollectionStatement];
+		if (statement == NULL) return;
 	
-	if (keysCount == 0) return;
-	if (keysCount == 1) {
-		[self removeObjectForKey:[keys objectAtIndex:0] inCollection:collection];
+		// DELETE FROM "database2" WHERE "collection" = ?;
+		
+		int const bind_idx_collection = SQLITE_BIND_START;
+		
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+		
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'removeCollectionStatement': %d %s, collection(%@)",
+			                                                       status, sqlite3_errmsg(connection->db), collection);
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		FreeYapDatabaseString(&_collection);
+		
+		connection->hasDiskChanges = YES;
+		[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+		
 		return;
-	}
+	} // end shortcut
 	
-	if (collection == nil)
-		collection = @"";
-	else
-		collection = [collection copy]; // mutable string protection
+	
+	NSUInteger left = [self numberOfKeysInCollection:collection];
 	
 	NSMutableArray *foundKeys = nil;
 	NSMutableArray *foundRowids = nil;
@@ -5490,11 +9863,9 @@
 	
 	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
 	
-	NSUInteger keysIndex = 0;
 	do
 	{
-		NSUInteger left = keysCount - keysIndex;
-		NSUInteger numKeyParams = MIN(left, (maxHostParams-1)); // minus 1 for collectionParam
+		NSUInteger numKeyParams = MIN(left, maxHostParams-1); // minus 1 for collectionParam
 		
 		if (foundKeys == nil)
 		{
@@ -5507,51 +9878,28 @@
 			[foundRowids removeAllObjects];
 		}
 		
+		NSUInteger foundCount = 0;
+		
 		// Find rowids for keys
 		
 		if (YES)
 		{
-			// SELECT "rowid", "key" FROM "database2" WHERE "collection" = ? AND "key" IN (?, ?, ...);
-			
-			int const column_idx_rowid = SQLITE_COLUMN_START + 0;
-			int const column_idx_key   = SQLITE_COLUMN_START + 1;
-			
-			NSUInteger capacity = 100 + (numKeyParams * 3);
-			NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
-			
-			[query appendString:
-			    @"SELECT \"rowid\", \"key\" FROM \"database2\" WHERE \"collection\" = ? AND \"key\" IN ("];
-			
-			NSUInteger i;
-			for (i = 0; i < numKeyParams; i++)
-			{
-				if (i == 0)
-					[query appendString:@"?"];
-				else
-					[query appendString:@", ?"];
-			}
-			
-			[query appendString:@");"];
-			
-			sqlite3_stmt *statement;
-			
-			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"Error creating 'removeKeys:inCollection:' statement (A): %d %s",
-				                                                              status, sqlite3_errmsg(connection->db));
+			BOOL needsFinalize;
+			sqlite3_stmt *statement = [connection enumerateKeysInCollectionStatement:&needsFinalize];
+			if (statement == NULL) {
 				FreeYapDatabaseString(&_collection);
 				return;
 			}
 			
-			sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
+			// SELECT "rowid", "key" FROM "database2" WHERE "collection" = ?;
 			
-			for (i = 0; i < numKeyParams; i++)
-			{
-				NSString *key = [keys objectAtIndex:(keysIndex + i)];
-				sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + 1 + i), [key UTF8String], -1, SQLITE_TRANSIENT);
-			}
+			int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+			int const column_idx_key      = SQLITE_COLUMN_START + 1;
+			int const bind_idx_collection = SQLITE_BIND_START;
+			
+			sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
 			
+			int status;
 			while ((status = sqlite3_step(statement)) == SQLITE_ROW)
 			{
 				int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
@@ -5563,22 +9911,23 @@
 				
 				[foundKeys addObject:key];
 				[foundRowids addObject:@(rowid)];
+				
+				if (++foundCount >= numKeyParams)
+				{
+					break;
+				}
 			}
 			
-			if (status != SQLITE_DONE)
+			if ((foundCount < numKeyParams) && (status != SQLITE_DONE))
 			{
-				YDBLogError(@"Error executing 'removeKeys:inCollection:' statement (A): %d %s",
-				                                                               status, sqlite3_errmsg(connection->db));
+				YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 			}
 			
-			sqlite3_finalize(statement);
-			statement = NULL;
+			sqlite_enum_reset(statement, needsFinalize);
 		}
 		
 		// Now remove all the matching rows
 		
-		NSUInteger foundCount = [foundRowids count];
-		
 		if (foundCount > 0)
 		{
 			// DELETE FROM "database2" WHERE "rowid" in (?, ?, ...);
@@ -5586,7 +9935,9 @@
 			NSUInteger capacity = 50 + (foundCount * 3);
 			NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
 			
-			[query appendString:@"DELETE FROM \"database2\" WHERE \"rowid\" IN ("];
+			[query appendString:(connection->database->usesCollectionIds
+			    ? @"DELETE FROM \"database3\" WHERE \"rowid\" IN ("
+			    : @"DELETE FROM \"database2\" WHERE \"rowid\" IN (")];
 			
 			NSUInteger i;
 			for (i = 0; i < foundCount; i++)
@@ -5604,17 +9955,19 @@
 			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
 			if (status != SQLITE_OK)
 			{
-				YDBLogError(@"Error creating 'removeKeys:inCollection:' statement (B): %d %s",
-							status, sqlite3_errmsg(connection->db));
+				YDBLogError(@"Error creating 'removeAllObjectsInCollection:' statement: %d %s",
+				            status, sqlite3_errmsg(connection->db));
+				
+				FreeYapDatabaseString(&_collection);
 				return;
 			}
-			
-            for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-            {
-                [extTransaction willRemoveObjectsForKeys:foundKeys
-                                            inCollection:collection
-                                              withRowids:foundRowids];
-            }
+            
+			for (YapDatabaseExtensionTransaction *extTransaction in extensions)
+			{
+				[extTransaction willRemoveObjectsForKeys:foundKeys
+				                            inCollection:collection
+				                              withRowids:foundRowids];
+			}
 			
 			for (i = 0; i < foundCount; i++)
 			{
@@ -5622,12 +9975,12 @@
 				
 				sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
 			}
-            
+			
 			status = sqlite3_step(statement);
 			if (status != SQLITE_DONE)
 			{
-				YDBLogError(@"Error executing 'removeKeys:inCollection:' statement (B): %d %s",
-							status, sqlite3_errmsg(connection->db));
+				YDBLogError(@"Error executing 'removeAllObjectsInCollection:' statement: %d %s",
+				            status, sqlite3_errmsg(connection->db));
 			}
 			
 			sqlite3_finalize(statement);
@@ -5636,428 +9989,636 @@
 			connection->hasDiskChanges = YES;
 			[connection->mutationStack markAsMutated];  // mutation during enumeration protection
 			
-			[connection->keyCache removeObjectsForKeys:foundRowids];
-			[connection->removedRowids addObjectsFromArray:foundRowids];
-			
-			for (NSString *key in foundKeys)
+			for (NSNumber *rowidNumber in foundRowids)
 			{
-				YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
-				
-				[connection->objectCache removeObjectForKey:cacheKey];
-				[connection->metadataCache removeObjectForKey:cacheKey];
-				
-				[connection->objectChanges removeObjectForKey:cacheKey];
-				[connection->metadataChanges removeObjectForKey:cacheKey];
-				[connection->insertedKeys removeObject:cacheKey];
-				[connection->removedKeys addObject:cacheKey];
+				YapRowidSetAdd(connection->removedRowids, [rowidNumber longLongValue]);
 			}
 			
-			for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
+			for (YapDatabaseExtensionTransaction *extTransaction in extensions)
 			{
+				uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+				
 				[extTransaction didRemoveObjectsForKeys:foundKeys
 				                           inCollection:collection
 				                             withRowids:foundRowids];
+				
+				YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
 			}
-			
 		}
 		
 		// Move on to the next batch (if there's more)
 		
-		keysIndex += numKeyParams;
+		left -= foundCount;
 		
-	} while (keysIndex < keysCount);
+	} while((left > 0) && ([foundKeys count] > 0));
+	
+	
+	FreeYapDatabaseString(&_collection);
+}
+
+- (void)removeAllObjectsInAllCollections
+{
+	if (connection->workloadTrace) {
+		[connection->workloadTrace recordRemoveAll];
+	}
+	
+	sqlite3_stmt *statement = [connection removeAllStatement];
+	if (statement == NULL) return;
+
+    for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
+    {
+        [extTransaction willRemoveAllObjectsInAllCollections];
+    }
+	
+	int status = sqlite3_step(statement);
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'removeAllStatement': %d %s", status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_reset(statement);
 	
+	connection->hasDiskChanges = YES;
+	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
 	
-	FreeYapDatabaseString(&_collection);
+	[connection->keyCache removeAllObjects];
+	[connection->objectCache removeAllObjects];
+	[connection->metadataCache removeAllObjects];
+	
+	[connection->objectChanges removeAllObjects];
+	[connection->metadataChanges removeAllObjects];
+	[connection->insertedKeys removeAllObjects];
+	[connection->removedKeys removeAllObjects];
+	[connection->removedCollections removeAllObjects];
+	YapRowidSetRemoveAll(connection->removedRowids);
+	connection->allKeysRemoved = YES;
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
+	{
+		uint64_t hookTime = YapDatabaseTransactionMetricsStart(connection->transactionMetrics);
+		
+		[extTransaction didRemoveAllObjectsInAllCollections];
+		
+		YapDatabaseTransactionMetricsAddHookTime(connection->transactionMetrics, hookTime, extTransaction);
+	}
 }
 
-- (void)removeAllObjectsInCollection:(NSString *)collection
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Expiration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)setExpiration:(NSDate *)expiration forKey:(NSString *)key inCollection:(NSString *)collection
 {
-	if (collection == nil)
-		collection  = @"";
-	else
-		collection = [collection copy]; // mutable string protection
+	if (key == nil) return;
+	if (collection == nil) collection = @"";
 	
-	// Purge the caches and changesets
+	if (!connection->database->expirationEnabled ||
+	    ![connection->database->expiringCollections containsObject:collection])
+	{
+		YDBLogWarn(@"%@ - Collection (%@) isn't one of the expiringCollections", THIS_METHOD, collection);
+		return;
+	}
 	
-	NSMutableArray *toRemove = [NSMutableArray array];
+	int64_t rowid = 0;
+	if (![self getRowid:&rowid forKey:key inCollection:collection]) return;
 	
-	{ // keyCache
+	sqlite3_stmt *statement = NULL;
+	
+	if (expiration)
+	{
+		statement = [connection setExpirationForRowidStatement];
+		if (statement == NULL) return;
 		
-		[connection->keyCache enumerateKeysAndObjectsWithBlock:^(id key, id obj, BOOL __unused *stop) {
-			
-			__unsafe_unretained NSNumber *rowidNumber = (NSNumber *)key;
-			__unsafe_unretained YapCollectionKey *collectionKey = (YapCollectionKey *)obj;
-			if ([collectionKey.collection isEqualToString:collection])
-			{
-				[toRemove addObject:rowidNumber];
-			}
-		}];
+		// INSERT OR REPLACE INTO "yap_expiration" ("rowid", "expires") VALUES (?, ?);
 		
-		[connection->keyCache removeObjectsForKeys:toRemove];
-		[toRemove removeAllObjects];
+		sqlite3_bind_int64(statement, SQLITE_BIND_START + 0, rowid);
+		sqlite3_bind_double(statement, SQLITE_BIND_START + 1, [expiration timeIntervalSince1970]);
 	}
-	
-	{ // objectCache
+	else
+	{
+		statement = [connection removeExpirationForRowidStatement];
+		if (statement == NULL) return;
 		
-		[connection->objectCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
-			
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			if ([cacheKey.collection isEqualToString:collection])
-			{
-				[toRemove addObject:cacheKey];
-			}
-		}];
+		// DELETE FROM "yap_expiration" WHERE "rowid" = ?;
 		
-		[connection->objectCache removeObjectsForKeys:toRemove];
-		[toRemove removeAllObjects];
+		sqlite3_bind_int64(statement, SQLITE_BIND_START, rowid);
 	}
 	
-	{ // objectChanges
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_DONE)
+	{
+		connection->hasDiskChanges = YES;
+	}
+	else
+	{
+		YDBLogError(@"Error executing '%@': %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+}
+
+- (void)setObject:(id)object
+           forKey:(NSString *)key
+     inCollection:(NSString *)collection
+     withMetadata:(id)metadata
+       expiration:(NSDate *)expiration
+{
+	[self setObject:object forKey:key inCollection:collection withMetadata:metadata];
+	
+	if (object) {
+		[self setExpiration:expiration forKey:key inCollection:collection];
+	}
+}
+
+- (NSUInteger)removeExpiredObjectsWithLimit:(NSUInteger)limit
+{
+	if (!connection->database->expirationEnabled || limit == 0) return 0;
+	
+	sqlite3_stmt *statement = [connection enumerateExpiredRowidsStatement];
+	if (statement == NULL) return 0;
+	
+	// SELECT "rowid" FROM "yap_expiration" WHERE "expires" <= ? ORDER BY "expires" ASC LIMIT ?;
+	
+	int const column_idx_rowid = SQLITE_COLUMN_START;
+	int const bind_idx_expires = SQLITE_BIND_START + 0;
+	int const bind_idx_limit   = SQLITE_BIND_START + 1;
+	
+	sqlite3_bind_double(statement, bind_idx_expires, [[NSDate date] timeIntervalSince1970]);
+	sqlite3_bind_int64(statement, bind_idx_limit, (sqlite3_int64)MIN(limit, (NSUInteger)INT64_MAX));
+	
+	// The rows are removed after the statement is reset,
+	// as removing a row modifies the table we're enumerating (via the trigger).
+	
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray array];
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		[rowids addObject:@(sqlite3_column_int64(statement, column_idx_rowid))];
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'enumerateExpiredRowidsStatement': %d %s", status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	NSUInteger removedCount = 0;
+	
+	for (NSNumber *rowidNumber in rowids)
+	{
+		int64_t rowid = [rowidNumber longLongValue];
 		
-		for (id key in [connection->objectChanges keyEnumerator])
+		YapCollectionKey *ck = [self collectionKeyForRowid:rowid];
+		if (ck)
 		{
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			if ([cacheKey.collection isEqualToString:collection])
-			{
-				[toRemove addObject:cacheKey];
-			}
+			[self removeObjectForCollectionKey:ck withRowid:rowid];
+			removedCount++;
 		}
-		
-		[connection->objectChanges removeObjectsForKeys:toRemove];
-		[toRemove removeAllObjects];
 	}
 	
-	{ // metadataCache
-		
-		[connection->metadataCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
-			
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			if ([cacheKey.collection isEqualToString:collection])
-			{
-				[toRemove addObject:cacheKey];
-			}
-		}];
-		
-		[connection->metadataCache removeObjectsForKeys:toRemove];
-		[toRemove removeAllObjects];
+	return removedCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Cold Storage
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)moveObjectsToColdStorageWithLimit:(NSUInteger)limit
+{
+	YapDatabase *database = connection->database;
+	
+	if (!database->coldStorageEnabled || database->coldCollections.count == 0 || limit == 0) return 0;
+	
+	sqlite3 *db = connection->db;
+	NSString *table = database->usesCollectionIds ? @"database3" : @"database2";
+	
+	NSString *query = [NSString stringWithFormat:
+	  @"SELECT \"a\".\"rowid\", \"d\".\"data\" FROM \"yap_cold_age\" AS \"a\""
+	  @" JOIN \"%@\" AS \"d\" ON \"d\".\"rowid\" = \"a\".\"rowid\""
+	  @" WHERE \"a\".\"written\" <= ? ORDER BY \"a\".\"written\" ASC LIMIT ?;", table];
+	
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Error preparing query: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return 0;
 	}
 	
-	{ // metadataChanges
+	int const column_idx_rowid = SQLITE_COLUMN_START + 0;
+	int const column_idx_data  = SQLITE_COLUMN_START + 1;
+	int const bind_idx_written = SQLITE_BIND_START + 0;
+	int const bind_idx_limit   = SQLITE_BIND_START + 1;
+	
+	NSTimeInterval threshold = [[NSDate date] timeIntervalSince1970] - database->coldStorageAge;
+	
+	sqlite3_bind_double(statement, bind_idx_written, threshold);
+	sqlite3_bind_int64(statement, bind_idx_limit, (sqlite3_int64)MIN(limit, (NSUInteger)INT64_MAX));
+	
+	// The rows are updated after the statement is finalized,
+	// as moving a row modifies the tables we're enumerating.
+	// 
+	// Rows that needn't be moved (already moved, no bigger than a reference, or stored externally)
+	// are only forgotten.
+	
+	NSMutableArray<NSNumber *> *rowids = [NSMutableArray array];
+	NSMutableArray<id> *blobs = [NSMutableArray array];   // NSData, or NSNull if there's nothing to move
+	NSMutableArray<NSData *> *movableBlobs = [NSMutableArray array];
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
 		
-		for (id key in [connection->metadataChanges keyEnumerator])
+		const void *blob = sqlite3_column_blob(statement, column_idx_data);
+		int blobSize = sqlite3_column_bytes(statement, column_idx_data);
+		
+		[rowids addObject:@(rowid)];
+		
+		if (blob == NULL || (NSUInteger)blobSize <= YAP_COLD_STORAGE_REFERENCE_SIZE ||
+		    YapDatabaseIsExternalReference(blob, (size_t)blobSize))
 		{
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			if ([cacheKey.collection isEqualToString:collection])
-			{
-				[toRemove addObject:cacheKey];
-			}
+			[blobs addObject:[NSNull null]];
+		}
+		else
+		{
+			NSData *data = [NSData dataWithBytes:blob length:blobSize];
+			
+			[blobs addObject:data];
+			[movableBlobs addObject:data];
 		}
+	}
+	
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
+	
+	sqlite3_finalize(statement);
+	
+	if (rowids.count == 0) return 0;
+	
+	// The blobs are durable (in the cold storage file) before this transaction commits.
+	// If the transaction is rolled back, they're deleted again.
+	
+	NSArray<NSNumber *> *blobIds = nil;
+	if (movableBlobs.count > 0)
+	{
+		blobIds = [database writeColdBlobs:movableBlobs];
+		if (blobIds == nil) return 0;
 		
-		[connection->metadataChanges removeObjectsForKeys:toRemove];
-		[toRemove removeAllObjects];
+		if (createdColdBlobs == nil)
+			createdColdBlobs = [[NSMutableArray alloc] init];
+		
+		[createdColdBlobs addObjectsFromArray:blobIds];
 	}
 	
-	{ // insertedKeys
+	NSString *update = [NSString stringWithFormat:@"UPDATE \"%@\" SET \"data\" = ? WHERE \"rowid\" = ?;", table];
+	char *forget = "DELETE FROM \"yap_cold_age\" WHERE \"rowid\" = ?;";
+	
+	sqlite3_stmt *updateStatement = NULL;
+	sqlite3_stmt *forgetStatement = NULL;
+	
+	status = sqlite3_prepare_v2(db, [update UTF8String], -1, &updateStatement, NULL);
+	if (status == SQLITE_OK) {
+		status = sqlite3_prepare_v2(db, forget, (int)strlen(forget)+1, &forgetStatement, NULL);
+	}
+	
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@ - Error preparing statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		
-		for (NSString *key in connection->insertedKeys)
+		sqlite3_finalize(updateStatement);
+		sqlite3_finalize(forgetStatement);
+		return 0;
+	}
+	
+	NSUInteger movedCount = 0;
+	NSUInteger blobIndex = 0;
+	
+	for (NSUInteger i = 0; i < rowids.count; i++)
+	{
+		int64_t rowid = [rowids[i] longLongValue];
+		id blob = blobs[i];
+		
+		if (blob != [NSNull null])
 		{
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			if ([cacheKey.collection isEqualToString:collection])
+			int64_t blobId = [blobIds[blobIndex++] longLongValue];
+			NSData *reference = YapDatabaseColdReferenceCreate(blobId, [(NSData *)blob length]);
+			
+			if (reference)
 			{
-				[toRemove addObject:cacheKey];
+				sqlite3_bind_blob(updateStatement, SQLITE_BIND_START + 0,
+				                  reference.bytes, (int)reference.length, SQLITE_STATIC);
+				sqlite3_bind_int64(updateStatement, SQLITE_BIND_START + 1, rowid);
+				
+				status = sqlite3_step(updateStatement);
+				if (status == SQLITE_DONE)
+					movedCount++;
+				else
+					YDBLogError(@"%@ - Error moving row: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+				
+				sqlite3_clear_bindings(updateStatement);
+				sqlite3_reset(updateStatement);
 			}
 		}
 		
-		for (NSString *cacheKey in toRemove)
+		sqlite3_bind_int64(forgetStatement, SQLITE_BIND_START, rowid);
+		
+		status = sqlite3_step(forgetStatement);
+		if (status != SQLITE_DONE)
 		{
-			[connection->insertedKeys removeObject:cacheKey];
+			YDBLogError(@"%@ - Error forgetting row: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		}
+		
+		sqlite3_reset(forgetStatement);
 	}
 	
-	[connection->removedCollections addObject:collection];
+	sqlite3_finalize(updateStatement);
+	sqlite3_finalize(forgetStatement);
+	
+	return movedCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Completion
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * It's often useful to compose code into various reusable functions which take a
+ * YapDatabaseReadWriteTransaction as a parameter. However, the ability to compose code
+ * in this manner is often prevented by the need to perform a task after the commit has finished.
+ * 
+ * The end result is that programmers either end up copy-pasting code,
+ * or hack together a solution that involves functions returning completion blocks.
+ *
+ * This method solves the dilemma by allowing encapsulated code to register its own commit completionBlock.
+**/
+- (void)addCompletionQueue:(dispatch_queue_t)completionQueue
+           completionBlock:(dispatch_block_t)completionBlock
+{
+	if (completionBlock == nil)
+		return;
+	
+	if (completionQueue == nil)
+		completionQueue = dispatch_get_main_queue();
+	
+	if (completionQueueStack == nil)
+		completionQueueStack = [[NSMutableArray alloc] initWithCapacity:1];
+	
+	if (completionBlockStack == nil)
+		completionBlockStack = [[NSMutableArray alloc] initWithCapacity:1];
+	
+	[completionQueueStack addObject:completionQueue];
+	[completionBlockStack addObject:completionBlock];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Bulk Load
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoked by -[YapDatabaseConnection bulkLoadWithBlock:], before the block.
+ *
+ * Suspends the row hooks of every extension that supports it (see -[YapDatabaseExtensionTransaction supportsBulkLoad]).
+ * Extensions that another extension depends on are left alone,
+ * as the handler of the dependent extension may read them during the bulk load.
+**/
+- (void)beginBulkLoad
+{
+	// This method is INTERNAL
 	
-	// If there are no active extensions we can take a shortcut
+	NSArray *allExtensions = [self orderedExtensions];
 	
-	if ([[self extensions] count] == 0)
+	NSMutableSet<NSString *> *dependencies = [NSMutableSet set];
+	for (YapDatabaseExtensionTransaction *extTransaction in allExtensions)
 	{
-		sqlite3_stmt *statement = [connection removeCollectionStatement];
-		if (statement == NULL) return;
-	
-		// DELETE FROM "database2" WHERE "collection" = ?;
-		
-		int const bind_idx_collection = SQLITE_BIND_START;
-		
-		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
-		sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
-		
-		int status = sqlite3_step(statement);
-		if (status != SQLITE_DONE)
-		{
-			YDBLogError(@"Error executing 'removeCollectionStatement': %d %s, collection(%@)",
-			                                                       status, sqlite3_errmsg(connection->db), collection);
+		NSSet *extDependencies = [[[extTransaction extensionConnection] extension] dependencies];
+		if (extDependencies) {
+			[dependencies unionSet:extDependencies];
 		}
+	}
+	
+	NSMutableSet<YapDatabaseExtensionTransaction *> *suspended = [NSMutableSet setWithCapacity:allExtensions.count];
+	for (YapDatabaseExtensionTransaction *extTransaction in allExtensions)
+	{
+		if (![extTransaction supportsBulkLoad]) continue;
 		
-		sqlite3_clear_bindings(statement);
-		sqlite3_reset(statement);
-		FreeYapDatabaseString(&_collection);
-		
-		connection->hasDiskChanges = YES;
-		[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+		YapDatabaseExtension *ext = [[extTransaction extensionConnection] extension];
+		if ([dependencies containsObject:[ext registeredName]]) continue;
 		
-		return;
-	} // end shortcut
-	
-	
-	NSUInteger left = [self numberOfKeysInCollection:collection];
+		[suspended addObject:extTransaction];
+	}
 	
-	NSMutableArray *foundKeys = nil;
-	NSMutableArray *foundRowids = nil;
+	YDBLogVerbose(@"Bulk load: suspending the row hooks of %lu extension(s)", (unsigned long)suspended.count);
 	
-	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
-	// We need to watch out for this in case a large array of keys is passed.
+	[self setBulkLoadExtensions:suspended];
+}
+
+/**
+ * Invoked by -[YapDatabaseConnection bulkLoadWithBlock:], after the block.
+ *
+ * Resumes the row hooks, and has each of the suspended extensions rebuild its tables (in extension order).
+ * If a rebuild fails, the transaction is rolled back. (As is the case if the block invoked rollback.)
+**/
+- (void)endBulkLoad
+{
+	// This method is INTERNAL
 	
-	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	NSSet<YapDatabaseExtensionTransaction *> *suspended = bulkLoadExtensions;
+	[self setBulkLoadExtensions:nil];
 	
-	// Loop over the keys, and remove them in big batches.
+	if (rollback || suspended == nil) return;
 	
-	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	// An extension may have been unregistered during the bulk load, so only the current extensions are rebuilt.
 	
-	do
+	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
 	{
-		NSUInteger numKeyParams = MIN(left, maxHostParams-1); // minus 1 for collectionParam
+		if (![suspended containsObject:extTransaction]) continue;
 		
-		if (foundKeys == nil)
-		{
-			foundKeys   = [NSMutableArray arrayWithCapacity:numKeyParams];
-			foundRowids = [NSMutableArray arrayWithCapacity:numKeyParams];
-		}
-		else
+		if (![extTransaction rebuildAfterBulkLoad])
 		{
-			[foundKeys removeAllObjects];
-			[foundRowids removeAllObjects];
+			YDBLogError(@"%@ - Failed rebuilding extension(%@) after bulk load, rolling back",
+			            THIS_METHOD, [[[extTransaction extensionConnection] extension] registeredName]);
+			
+			rollback = YES;
+			return;
 		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Extensions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)addRegisteredExtensionTransaction:(YapDatabaseExtensionTransaction *)extTransaction withName:(NSString *)extName
+{
+	// This method is INTERNAL
+	
+	if (extensions == nil)
+		extensions = [[NSMutableDictionary alloc] init];
+	
+	[extensions setObject:extTransaction forKey:extName];
+}
+
+- (void)removeRegisteredExtensionTransactionWithName:(NSString *)extName
+{
+	// This method is INTERNAL
+	
+	[extensions removeObjectForKey:extName];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark External Storage
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoked for every serialized object that's about to be written.
+ * 
+ * If the object is large enough (see YapDatabaseOptions.externalStorageThresholds),
+ * it's written to an external file, and the returned reference is stored in the row instead.
+ * Otherwise the object is compressed (if configured).
+**/
+- (NSData *)encodeSerializedObject:(NSData *)serializedObject inCollection:(NSString *)collection
+{
+	YapDatabase *database = connection->database;
+	
+	if (database->externalStorageEnabled && serializedObject)
+	{
+		NSNumber *threshold = database->externalStorageThresholds[collection ?: @""];
 		
-		NSUInteger foundCount = 0;
-		
-		// Find rowids for keys
-		
-		if (YES)
+		if (threshold && serializedObject.length >= [threshold unsignedIntegerValue])
 		{
-			BOOL needsFinalize;
-			sqlite3_stmt *statement = [connection enumerateKeysInCollectionStatement:&needsFinalize];
-			if (statement == NULL) {
-				FreeYapDatabaseString(&_collection);
-				return;
-			}
-			
-			// SELECT "rowid", "key" FROM "database2" WHERE "collection" = ?;
-			
-			int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
-			int const column_idx_key      = SQLITE_COLUMN_START + 1;
-			int const bind_idx_collection = SQLITE_BIND_START;
-			
-			sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+			NSString *fileName = nil;
+			NSData *reference = YapDatabaseExternalReferenceCreate(serializedObject, &fileName);
 			
-			int status;
-			while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+			BOOL created = NO;
+			if (reference && [database writeExternalBlob:serializedObject withFileName:fileName created:&created])
 			{
-				int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
-				
-				const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
-				int textSize = sqlite3_column_bytes(statement, column_idx_key);
-				
-				NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
-				
-				[foundKeys addObject:key];
-				[foundRowids addObject:@(rowid)];
-				
-				if (++foundCount >= numKeyParams)
+				if (created)
 				{
-					break;
+					if (createdExternalBlobs == nil)
+						createdExternalBlobs = [[NSMutableArray alloc] init];
+					
+					[createdExternalBlobs addObject:fileName];
 				}
-			}
-			
-			if ((foundCount < numKeyParams) && (status != SQLITE_DONE))
-			{
-				YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
-			}
-			
-			sqlite_enum_reset(statement, needsFinalize);
-		}
-		
-		// Now remove all the matching rows
-		
-		if (foundCount > 0)
-		{
-			// DELETE FROM "database2" WHERE "rowid" in (?, ?, ...);
-			
-			NSUInteger capacity = 50 + (foundCount * 3);
-			NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
-			
-			[query appendString:@"DELETE FROM \"database2\" WHERE \"rowid\" IN ("];
-			
-			NSUInteger i;
-			for (i = 0; i < foundCount; i++)
-			{
-				if (i == 0)
-					[query appendString:@"?"];
-				else
-					[query appendString:@", ?"];
-			}
-			
-			[query appendString:@");"];
-			
-			sqlite3_stmt *statement;
-			
-			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"Error creating 'removeAllObjectsInCollection:' statement: %d %s",
-				            status, sqlite3_errmsg(connection->db));
-				
-				FreeYapDatabaseString(&_collection);
-				return;
-			}
-            
-			for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-			{
-				[extTransaction willRemoveObjectsForKeys:foundKeys
-				                            inCollection:collection
-				                              withRowids:foundRowids];
-			}
-			
-			for (i = 0; i < foundCount; i++)
-			{
-				int64_t rowid = [[foundRowids objectAtIndex:i] longLongValue];
 				
-				sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
-			}
-			
-			status = sqlite3_step(statement);
-			if (status != SQLITE_DONE)
-			{
-				YDBLogError(@"Error executing 'removeAllObjectsInCollection:' statement: %d %s",
-				            status, sqlite3_errmsg(connection->db));
+				return reference;
 			}
 			
-			sqlite3_finalize(statement);
-			statement = NULL;
-			
-			connection->hasDiskChanges = YES;
-			[connection->mutationStack markAsMutated];  // mutation during enumeration protection
-			
-			[connection->removedRowids addObjectsFromArray:foundRowids];
-			
-			for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-			{
-				[extTransaction didRemoveObjectsForKeys:foundKeys
-				                           inCollection:collection
-				                             withRowids:foundRowids];
-			}
+			// Fallback: store the object within the database
 		}
-		
-		// Move on to the next batch (if there's more)
-		
-		left -= foundCount;
-		
-	} while((left > 0) && ([foundKeys count] > 0));
-	
+	}
 	
-	FreeYapDatabaseString(&_collection);
+	return YapDatabaseCompressObject(database, collection, serializedObject);
 }
 
-- (void)removeAllObjectsInAllCollections
+/**
+ * Invoked (via preCommitReadWriteTransaction) if external storage is enabled.
+**/
+- (void)collectUnreferencedExternalBlobs
 {
-	sqlite3_stmt *statement = [connection removeAllStatement];
-	if (statement == NULL) return;
-
-    for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
-    {
-        [extTransaction willRemoveAllObjectsInAllCollections];
-    }
+	sqlite3 *db = connection->db;
 	
-	int status = sqlite3_step(statement);
-	if (status != SQLITE_DONE)
+	sqlite3_stmt *statement;
+	char *stmt = "SELECT hex(\"hash\") FROM \"yap_external_blobs\" WHERE \"refcount\" <= 0;";
+	
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
 	{
-		YDBLogError(@"Error executing 'removeAllStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return;
 	}
 	
-	sqlite3_reset(statement);
+	NSMutableArray<NSString *> *fileNames = nil;
 	
-	connection->hasDiskChanges = YES;
-	[connection->mutationStack markAsMutated];  // mutation during enumeration protection
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		const unsigned char *text = sqlite3_column_text(statement, SQLITE_COLUMN_START);
+		int textSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
+		
+		NSString *fileName = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		if (fileName)
+		{
+			if (fileNames == nil)
+				fileNames = [NSMutableArray array];
+			
+			[fileNames addObject:fileName];
+		}
+	}
 	
-	[connection->keyCache removeAllObjects];
-	[connection->objectCache removeAllObjects];
-	[connection->metadataCache removeAllObjects];
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
 	
-	[connection->objectChanges removeAllObjects];
-	[connection->metadataChanges removeAllObjects];
-	[connection->insertedKeys removeAllObjects];
-	[connection->removedKeys removeAllObjects];
-	[connection->removedCollections removeAllObjects];
-	[connection->removedRowids removeAllObjects];
-	connection->allKeysRemoved = YES;
+	sqlite3_finalize(statement);
 	
-	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
+	if (fileNames == nil) return;
+	
+	status = sqlite3_exec(db, "DELETE FROM \"yap_external_blobs\" WHERE \"refcount\" <= 0;", NULL, NULL, NULL);
+	if (status != SQLITE_OK)
 	{
-		[extTransaction didRemoveAllObjectsInAllCollections];
+		YDBLogError(@"%@: Error deleting unreferenced blobs: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return;
 	}
+	
+	externalBlobGarbage = fileNames;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Completion
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 /**
- * It's often useful to compose code into various reusable functions which take a
- * YapDatabaseReadWriteTransaction as a parameter. However, the ability to compose code
- * in this manner is often prevented by the need to perform a task after the commit has finished.
- * 
- * The end result is that programmers either end up copy-pasting code,
- * or hack together a solution that involves functions returning completion blocks.
- *
- * This method solves the dilemma by allowing encapsulated code to register its own commit completionBlock.
+ * Invoked (via preCommitReadWriteTransaction) if cold storage is enabled.
 **/
-- (void)addCompletionQueue:(dispatch_queue_t)completionQueue
-           completionBlock:(dispatch_block_t)completionBlock
+- (void)collectUnreferencedColdBlobs
 {
-	if (completionBlock == nil)
+	sqlite3 *db = connection->db;
+	
+	sqlite3_stmt *statement;
+	char *stmt = "SELECT \"reference\" FROM \"yap_cold_garbage\";";
+	
+	int status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
 		return;
+	}
 	
-	if (completionQueue == nil)
-		completionQueue = dispatch_get_main_queue();
+	NSMutableArray<NSNumber *> *blobIds = nil;
 	
-	if (completionQueueStack == nil)
-		completionQueueStack = [[NSMutableArray alloc] initWithCapacity:1];
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		const void *blob = sqlite3_column_blob(statement, SQLITE_COLUMN_START);
+		int blobSize = sqlite3_column_bytes(statement, SQLITE_COLUMN_START);
+		
+		if (YapDatabaseIsColdReference(blob, (size_t)blobSize))
+		{
+			if (blobIds == nil)
+				blobIds = [NSMutableArray array];
+			
+			[blobIds addObject:@(YapDatabaseColdReferenceBlobId(blob))];
+		}
+	}
 	
-	if (completionBlockStack == nil)
-		completionBlockStack = [[NSMutableArray alloc] initWithCapacity:1];
+	if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
 	
-	[completionQueueStack addObject:completionQueue];
-	[completionBlockStack addObject:completionBlock];
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Extensions
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (void)addRegisteredExtensionTransaction:(YapDatabaseExtensionTransaction *)extTransaction withName:(NSString *)extName
-{
-	// This method is INTERNAL
+	sqlite3_finalize(statement);
 	
-	if (extensions == nil)
-		extensions = [[NSMutableDictionary alloc] init];
+	if (blobIds == nil) return;
 	
-	[extensions setObject:extTransaction forKey:extName];
-}
-
-- (void)removeRegisteredExtensionTransactionWithName:(NSString *)extName
-{
-	// This method is INTERNAL
+	status = sqlite3_exec(db, "DELETE FROM \"yap_cold_garbage\";", NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error deleting unreferenced cold blobs: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		return;
+	}
 	
-	[extensions removeObjectForKey:extName];
+	coldBlobGarbage = blobIds;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -6071,129 +10632,176 @@
 
 - (void)setIntValue:(int)value forKey:(NSString *)key extension:(NSString *)extensionName
 {
-	if (extensionName == nil)
-		extensionName = @"";
-	
-	sqlite3_stmt *statement = [connection yapSetDataForKeyStatement];
-	if (statement == NULL) return;
-	
-	// INSERT OR REPLACE INTO "yap2" ("extension", "key", "data") VALUES (?, ?, ?);
-	
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
-	int const bind_idx_data      = SQLITE_BIND_START + 2;
+	[self setExtensionValue:@(value) forKey:key extension:extensionName];
+}
+
+- (void)setInt64Value:(int64_t)value forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	[self setExtensionValue:@(value) forKey:key extension:extensionName];
+}
+
+- (void)setDoubleValue:(double)value forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	[self setExtensionValue:@(value) forKey:key extension:extensionName];
+}
+
+- (void)setStringValue:(NSString *)value forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	[self setExtensionValue:([value copy] ?: [NSNull null]) forKey:key extension:extensionName];
+}
+
+- (void)setDataValue:(NSData *)value forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	[self setExtensionValue:([value copy] ?: [NSNull null]) forKey:key extension:extensionName];
+}
+
+- (void)removeValueForKey:(NSString *)key extension:(NSString *)extensionName
+{
+	// Be careful with this statement.
+	//
+	// The snapshot value is in the yap table, and uses an empty string for the extensionName.
+	// The snapshot value is critical to the underlying architecture of the system.
+	// Removing it could cripple the system.
 	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	NSAssert(key != nil, @"Invalid key!");
+	NSAssert(extensionName != nil, @"Invalid extensionName!");
 	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	[self setExtensionValue:[YapNull null] forKey:key extension:extensionName];
+}
+
+- (void)removeAllValuesForExtension:(NSString *)extensionName
+{
+	// Be careful with this statement.
+	//
+	// The snapshot value is in the yap table, and uses an empty string for the extensionName.
+	// The snapshot value is critical to the underlying architecture of the system.
+	// Removing it could cripple the system.
 	
-	sqlite3_bind_int(statement, bind_idx_data, value);
+	NSAssert(extensionName != nil, @"Invalid extensionName!");
 	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_DONE)
-	{
-		connection->hasDiskChanges = YES;
-	}
-	else
+	if ([extensionName length] == 0 || extensionValuesFlushed)
 	{
-		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		[self dropPrefetchedValuesForExtension:extensionName];
+		[connection->extensionValuesCache removeObjectForKey:extensionName];
+		
+		[self writeRemoveAllValuesForExtension:extensionName];
+		return;
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
+	[pendingExtensionValues removeObjectForKey:extensionName];
+	
+	if (pendingRemovedExtensions == nil)
+		pendingRemovedExtensions = [[NSMutableSet alloc] init];
+	
+	[pendingRemovedExtensions addObject:extensionName];
 }
 
-- (void)setDoubleValue:(double)value forKey:(NSString *)key extension:(NSString *)extensionName
+/**
+ * Extensions modify their yap2 values (versions, state, ...) throughout the transaction,
+ * and often modify the same value several times. So the modifications are buffered,
+ * and written to the database (once) during pre-commit. See flushPendingExtensionValues.
+ *
+ * The values of the database itself (empty extensionName) are always written immediately.
+ * As are modifications made after pre-commit (e.g. when dropping the tables of an old extension).
+ *
+ * The value may be an NSNumber, NSString, NSData, NSNull (for a NULL value), or YapNull (to remove the row).
+**/
+- (void)setExtensionValue:(id)value forKey:(NSString *)key extension:(NSString *)extensionName
 {
 	if (extensionName == nil)
 		extensionName = @"";
 	
-	sqlite3_stmt *statement = [connection yapSetDataForKeyStatement];
-	if (statement == NULL) return;
-	
-	// INSERT OR REPLACE INTO "yap2" ("extension", "key", "data") VALUES (?, ?, ?);
-	
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
-	int const bind_idx_data      = SQLITE_BIND_START + 2;
-	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
-	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
-	
-	sqlite3_bind_double(statement, bind_idx_data, value);
-	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_DONE)
+	if ([extensionName length] == 0 || extensionValuesFlushed)
 	{
-		connection->hasDiskChanges = YES;
+		[self dropPrefetchedValuesForExtension:extensionName];
+		[connection->extensionValuesCache removeObjectForKey:extensionName];
+		
+		[self writeExtensionValue:value forKey:key extension:extensionName];
+		return;
 	}
-	else
+	
+	if (pendingExtensionValues == nil)
+		pendingExtensionValues = [[NSMutableDictionary alloc] init];
+	
+	NSMutableDictionary *values = pendingExtensionValues[extensionName];
+	if (values == nil)
 	{
-		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		values = [[NSMutableDictionary alloc] init];
+		pendingExtensionValues[extensionName] = values;
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
+	values[key] = value;
 }
 
-- (void)setStringValue:(NSString *)value forKey:(NSString *)key extension:(NSString *)extensionName
+/**
+ * Invoked (via preCommitReadWriteTransaction) after the extensions have flushed their changes.
+ *
+ * Writes the buffered yap2 modifications to the database, and applies them to the connection's cache.
+ * The names of the modified extensions are added to the changeset,
+ * so the other connections drop their cached values for these extensions.
+**/
+- (void)flushPendingExtensionValues
 {
-	if (extensionName == nil)
-		extensionName = @"";
-	
-	sqlite3_stmt *statement = [connection yapSetDataForKeyStatement];
-	if (statement == NULL) return;
+	extensionValuesFlushed = YES;
 	
-	// INSERT OR REPLACE INTO "yap2" ("extension", "key", "data") VALUES (?, ?, ?);
-	
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
-	int const bind_idx_data      = SQLITE_BIND_START + 2;
-	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	if (pendingExtensionValues == nil && pendingRemovedExtensions == nil) return;
 	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	NSMutableSet<NSString *> *changedExtensions = [[NSMutableSet alloc] init];
 	
-	YapDatabaseString _value; MakeYapDatabaseString(&_value, value);
-	sqlite3_bind_text(statement, bind_idx_data, _value.str, _value.length, SQLITE_STATIC);
-	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_DONE)
+	for (NSString *extensionName in pendingRemovedExtensions)
 	{
-		connection->hasDiskChanges = YES;
+		[self dropPrefetchedValuesForExtension:extensionName];
+		[connection->extensionValuesCache removeObjectForKey:extensionName];
+		
+		[self writeRemoveAllValuesForExtension:extensionName];
+		[changedExtensions addObject:extensionName];
 	}
-	else
+	
+	for (NSString *extensionName in pendingExtensionValues)
 	{
-		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		NSDictionary *values = pendingExtensionValues[extensionName];
+		
+		[self dropPrefetchedValuesForExtension:extensionName];
+		
+		if (connection->extensionValuesCache == nil)
+			connection->extensionValuesCache = [[NSMutableDictionary alloc] init];
+		
+		NSMutableDictionary *cachedValues = connection->extensionValuesCache[extensionName];
+		if (cachedValues == nil)
+		{
+			cachedValues = [[NSMutableDictionary alloc] initWithCapacity:[values count]];
+			connection->extensionValuesCache[extensionName] = cachedValues;
+		}
+		
+		for (NSString *key in values)
+		{
+			id value = values[key];
+			
+			[self writeExtensionValue:value forKey:key extension:extensionName];
+			cachedValues[key] = value;
+		}
+		
+		[changedExtensions addObject:extensionName];
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
-	FreeYapDatabaseString(&_value);
+	pendingExtensionValues = nil;
+	pendingRemovedExtensions = nil;
+	
+	if (connection->changedExtensionValues)
+		[connection->changedExtensionValues unionSet:changedExtensions];
+	else
+		connection->changedExtensionValues = changedExtensions;
 }
 
-- (void)setDataValue:(NSData *)value forKey:(NSString *)key extension:(NSString *)extensionName
+- (void)writeExtensionValue:(id)value forKey:(NSString *)key extension:(NSString *)extensionName
 {
-	if (extensionName == nil)
-		extensionName = @"";
+	BOOL isRemove = [value isKindOfClass:[YapNull class]];
 	
-	sqlite3_stmt *statement = [connection yapSetDataForKeyStatement];
+	sqlite3_stmt *statement = isRemove ? [connection yapRemoveForKeyStatement] : [connection yapSetDataForKeyStatement];
 	if (statement == NULL) return;
 	
 	// INSERT OR REPLACE INTO "yap2" ("extension", "key", "data") VALUES (?, ?, ?);
+	// DELETE FROM "yap2" WHERE "extension" = ? AND "key" = ?;
 	
 	int const bind_idx_extension = SQLITE_BIND_START + 0;
 	int const bind_idx_key       = SQLITE_BIND_START + 1;
@@ -6205,77 +10813,57 @@
 	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
 	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
 	
-	__attribute__((objc_precise_lifetime)) NSData *data = value;
-	sqlite3_bind_blob(statement, bind_idx_data, data.bytes, (int)data.length, SQLITE_STATIC);
+	__attribute__((objc_precise_lifetime)) id data = value;
 	
-	int status = sqlite3_step(statement);
-	if (status == SQLITE_DONE)
+	YapDatabaseString _value;
+	MakeYapDatabaseString(&_value, ([data isKindOfClass:[NSString class]] ? (NSString *)data : nil));
+	
+	if (isRemove || [data isKindOfClass:[NSNull class]])
 	{
-		connection->hasDiskChanges = YES;
+		// Nothing to bind (a NULL value)
 	}
-	else
+	else if ([data isKindOfClass:[NSNumber class]])
 	{
-		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+		const char *type = [(NSNumber *)data objCType];
+		
+		if (strcmp(type, @encode(double)) == 0 || strcmp(type, @encode(float)) == 0)
+			sqlite3_bind_double(statement, bind_idx_data, [data doubleValue]);
+		else
+			sqlite3_bind_int64(statement, bind_idx_data, (sqlite3_int64)[data longLongValue]);
+	}
+	else if ([data isKindOfClass:[NSString class]])
+	{
+		sqlite3_bind_text(statement, bind_idx_data, _value.str, _value.length, SQLITE_STATIC);
+	}
+	else if ([data isKindOfClass:[NSData class]])
+	{
+		sqlite3_bind_blob(statement, bind_idx_data, [data bytes], (int)[data length], SQLITE_STATIC);
 	}
-	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
-	FreeYapDatabaseString(&_extension);
-	FreeYapDatabaseString(&_key);
-}
-
-- (void)removeValueForKey:(NSString *)key extension:(NSString *)extensionName
-{
-	// Be careful with this statement.
-	//
-	// The snapshot value is in the yap table, and uses an empty string for the extensionName.
-	// The snapshot value is critical to the underlying architecture of the system.
-	// Removing it could cripple the system.
-	
-	NSAssert(key != nil, @"Invalid key!");
-	NSAssert(extensionName != nil, @"Invalid extensionName!");
-	
-	sqlite3_stmt *statement = [connection yapRemoveForKeyStatement];
-	if (statement == NULL) return;
-	
-	// DELETE FROM "yap2" WHERE "extension" = ? AND "key" = ?;
-	
-	int const bind_idx_extension = SQLITE_BIND_START + 0;
-	int const bind_idx_key       = SQLITE_BIND_START + 1;
-	
-	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
-	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
-	
-	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
-	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
 	
 	int status = sqlite3_step(statement);
 	if (status == SQLITE_DONE)
 	{
 		connection->hasDiskChanges = YES;
 	}
-	else
+	else if (isRemove)
 	{
 		YDBLogError(@"Error executing 'yapRemoveForKeyStatement': %d %s, extension(%@)",
 					status, sqlite3_errmsg(connection->db), extensionName);
 	}
+	else
+	{
+		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+	}
 	
 	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	FreeYapDatabaseString(&_extension);
 	FreeYapDatabaseString(&_key);
+	FreeYapDatabaseString(&_value);
 }
 
-- (void)removeAllValuesForExtension:(NSString *)extensionName
+- (void)writeRemoveAllValuesForExtension:(NSString *)extensionName
 {
-	// Be careful with this statement.
-	//
-	// The snapshot value is in the yap table, and uses an empty string for the extensionName.
-	// The snapshot value is critical to the underlying architecture of the system.
-	// Removing it could cripple the system.
-	
-	NSAssert(extensionName != nil, @"Invalid extensionName!");
-	
 	sqlite3_stmt *statement = [connection yapRemoveExtensionStatement];
 	if (statement == NULL) return;
 	